@@ -19,7 +19,6 @@ struct point_light {
     float padding;
 };
 
-const int POINT_LIGHT_MAX = 10;
 const int MAX_TERRAIN_MATERIALS = 4;
 const int MAX_SHADOW_CASCADES = 4;
 const int TERRAIN_PER_MATERIAL_SAMP_COUNT = 3;
@@ -50,11 +49,23 @@ struct material_terrain_properties {
     vec4 padding2;
 };
 
+// Point lights, indexed by the light index list of each cluster.
+layout(std430, set = 0, binding = 1) readonly buffer point_light_buffer {
+    point_light lights[];
+} point_lights;
+
+// Point light clusters. The cells (an offset and count per cluster, ordered by slice, then row,
+// then column) come first in data, followed by the light index list they refer to.
+layout(std430, set = 0, binding = 2) readonly buffer light_cluster_buffer {
+    // x = tiles across, y = tiles down, z = slices, w = the start of the light index list in data.
+    uvec4 dimensions;
+    // x = slice scale, y = slice bias (slice = log2(depth) * x + y), z = near clip, w = far clip.
+    vec4 slice_params;
+    uint data[];
+} light_clusters;
+
 layout(set = 1, binding = 0) uniform instance_uniform_object {
     material_terrain_properties properties;
-    point_light p_lights[POINT_LIGHT_MAX];
-    vec3 padding;
-    int num_p_lights;
 } instance_ubo;
 
 
@@ -68,7 +79,8 @@ const float PI = 3.14159265359;
 // Material textures: albedo, normal, combined (metallic, roughness, ao)
 layout(set = 1, binding = 1) uniform sampler2DArray material_textures;
 // Shadow maps
-layout(set = 1, binding = 2) uniform sampler2DArray shadow_texture;
+// Sampled with depth comparison, returning the fraction of the texels around a point the reference is lit by.
+layout(set = 1, binding = 2) uniform sampler2DArrayShadow shadow_texture;
 // IBL irradiance
 layout(set = 1, binding = 3) uniform samplerCube irradiance_texture;
 
@@ -91,27 +103,36 @@ layout(location = 2) in struct dto {
 
 mat3 TBN;
 
-// Percentage-Closer Filtering
+// A Poisson disc of 16 points within the unit circle. Its first 4 and 8 points are also fairly well spread.
+const vec2 poisson_disc[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725), vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464), vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590), vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+// The radius of the Poisson disc, in shadow map texels.
+const float SHADOW_FILTER_RADIUS = 1.5;
+
+// Percentage-Closer Filtering, with the taps of the default shadow quality of PBR materials.
 float calculate_pcf(vec3 projected, int cascade_index) {
-    float shadow = 0.0;
+    int tap_count = 8;
     vec2 texel_size = 1.0 / textureSize(shadow_texture, 0).xy;
-    for(int x = -1; x <= 1; ++x) {
-        for(int y = -1; y <= 1; ++y) {
-            float pcf_depth = texture(shadow_texture, vec3(projected.xy + vec2(x, y) * texel_size, cascade_index)).r;
-            shadow += projected.z - in_dto.bias > pcf_depth ? 1.0 : 0.0;
-        }
+    // Rotate the disc per pixel (by interleaved gradient noise), trading banding for fine noise.
+    float angle = 6.28318530 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    vec2 rotation = vec2(cos(angle), sin(angle));
+    float reference = projected.z - in_dto.bias;
+    float lit = 0.0;
+    for(int i = 0; i < tap_count; ++i) {
+        vec2 p = poisson_disc[i];
+        vec2 offset = vec2(p.x * rotation.x - p.y * rotation.y, p.x * rotation.y + p.y * rotation.x) * SHADOW_FILTER_RADIUS * texel_size;
+        lit += texture(shadow_texture, vec4(projected.xy + offset, cascade_index, reference));
     }
-    shadow /= 9;
-    return 1.0 - shadow;
+    return lit / float(tap_count);
 }
 
 float calculate_unfiltered(vec3 projected, int cascade_index) {
-    // Sample the shadow map.
-    float map_depth = texture(shadow_texture, vec3(projected.xy, cascade_index)).r;
-
-    // TODO: cast/get rid of branch.
-    float shadow = projected.z - in_dto.bias > map_depth ? 0.0 : 1.0;
-    return shadow;
+    // A single comparison, still filtered over the nearest 2x2 texels by the sampler.
+    return texture(shadow_texture, vec4(projected.xy, cascade_index, projected.z - in_dto.bias));
 }
 
 // Compare the fragment position against the depth buffer, and if it is further 
@@ -141,6 +162,19 @@ float geometry_schlick_ggx(float normal_dot_direction, float roughness) {
     return normal_dot_direction / (normal_dot_direction * (1.0 - k) + k);
 }
 
+// Finds the cluster containing the given view space position. Returns the offset of its first
+// light in the light index list, and its light count.
+uvec2 light_cluster_get(vec4 position_view_space) {
+    uvec3 dimensions = light_clusters.dimensions.xyz;
+    vec4 clip = global_ubo.projection * position_view_space;
+    vec2 ndc = clip.xy / clip.w;
+    ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(dimensions.xy)), ivec2(0), ivec2(dimensions.xy) - 1);
+    float depth = max(-position_view_space.z, light_clusters.slice_params.z);
+    int slice = clamp(int(log2(depth) * light_clusters.slice_params.x + light_clusters.slice_params.y), 0, int(dimensions.z) - 1);
+    uint cluster = (uint(slice) * dimensions.y + uint(tile.y)) * dimensions.x + uint(tile.x);
+    return uvec2(light_clusters.data[cluster * 2], light_clusters.data[cluster * 2 + 1]);
+}
+
 vec3 calculate_point_light_radiance(point_light light, vec3 view_direction, vec3 frag_position_xyz);
 vec3 calculate_directional_light_radiance(directional_light light, vec3 view_direction);
 vec3 calculate_reflectance(vec3 albedo, vec3 normal, vec3 view_direction, vec3 light_direction, float metallic, float roughness, vec3 base_reflectivity, vec3 radiance);
@@ -266,9 +300,11 @@ void main() {
             total_reflectance += (shadow * calculate_reflectance(albedo.xyz, normal, view_direction, light_direction, metallic, roughness, base_reflectivity, radiance));
         }
 
-        // Point light radiance
-        for(int i = 0; i < instance_ubo.num_p_lights; ++i) {
-            point_light light = instance_ubo.p_lights[i];
+        // Point light radiance, from only the lights affecting this fragment's cluster.
+        uvec2 cluster_lights = light_cluster_get(frag_position_view_space);
+        uint light_index_start = light_clusters.dimensions.w + cluster_lights.x;
+        for(uint i = 0; i < cluster_lights.y; ++i) {
+            point_light light = point_lights.lights[light_clusters.data[light_index_start + i]];
             vec3 light_direction = normalize(light.position.xyz - in_dto.frag_position.xyz);
             vec3 radiance = calculate_point_light_radiance(light, view_direction, in_dto.frag_position.xyz);
 
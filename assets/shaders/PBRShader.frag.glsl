@@ -1,6 +1,9 @@
 #version 450
 
 layout(location = 0) out vec4 out_colour;
+// Weighted blended transparency outputs. Only written by the weighted_blend variant.
+layout(location = 1) out vec4 out_accumulation;
+layout(location = 2) out float out_coverage;
 
 struct directional_light {
     vec4 colour;
@@ -16,12 +19,32 @@ struct point_light {
     float linear;
     // Makes the light fall off slower at longer distances.
     float quadratic;
-    float padding;
+    // The index of the light's shadow in point_shadows, or -1 if it casts none.
+    int shadow_index;
+};
+
+// A point light's shadow, rendered into six faces of the point shadow atlas.
+struct point_shadow {
+    // Ordered +x, -x, +y, -y, +z, -z.
+    mat4 face_view_projections[6];
+    // x = the layer of the first static face, y = the layer of the first face of moving casters
+    // (or -1 if there are none), z = the depth bias.
+    vec4 params;
 };
 
-const int MAX_POINT_LIGHTS = 10;
 const int MAX_SHADOW_CASCADES = 4;
 
+// Specialization constants, fixed per shader variant. See Shader.PBRMaterial.shadercfg.
+// Materials without a normal map skip normal mapping.
+layout(constant_id = 0) const bool use_normal_map = true;
+// The shadow filtering quality. 0 takes a single tap, and 1, 2 and 3 take 4, 8 and 16 taps of a
+// rotated Poisson disc. Each tap is a hardware comparison filtered over 2x2 texels.
+layout(constant_id = 1) const int shadow_quality = 2;
+// The number of shadow cascades in use, at most MAX_SHADOW_CASCADES.
+layout(constant_id = 2) const int cascade_count = 4;
+// Accumulates into the weighted blended transparency attachments instead of blending over the colour.
+layout(constant_id = 3) const bool weighted_blend = false;
+
 struct pbr_properties {
     vec4 diffuse_colour;
     vec3 padding;
@@ -37,14 +60,39 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
 	int mode;
     int use_pcf;
     float bias;
-    vec2 padding;
+    // Non-zero once the prefiltered specular cube and BRDF lookup table are bound.
+    uint use_ibl_specular;
+    float padding;
 } global_ubo;
 
+
+// Point lights, indexed by the light index list of each cluster.
+layout(std430, set = 0, binding = 2) readonly buffer point_light_buffer {
+    point_light lights[];
+} point_lights;
+
+// Point light clusters. The cells (an offset and count per cluster, ordered by slice, then row,
+// then column) come first in data, followed by the light index list they refer to.
+layout(std430, set = 0, binding = 3) readonly buffer light_cluster_buffer {
+    // x = tiles across, y = tiles down, z = slices, w = the start of the light index list in data.
+    uvec4 dimensions;
+    // x = slice scale, y = slice bias (slice = log2(depth) * x + y), z = near clip, w = far clip.
+    vec4 slice_params;
+    uint data[];
+} light_clusters;
+
+// Material parameters, written when a material changes rather than per draw.
+layout(std430, set = 0, binding = 4) readonly buffer material_buffer {
+    pbr_properties materials[];
+} material_parameters;
+
+// The shadows of the point lights casting them, indexed by each light's shadow_index.
+layout(std430, set = 0, binding = 5) readonly buffer point_shadow_buffer {
+    point_shadow shadows[];
+} point_shadows;
+
 layout(set = 1, binding = 0) uniform instance_uniform_object {
     directional_light dir_light;
-    point_light p_lights[MAX_POINT_LIGHTS]; // TODO: move after props
-    pbr_properties properties;
-    int num_p_lights;
 } instance_ubo;
 
 const int PBR_MATERIAL_TEXTURE_COUNT = 3;
@@ -58,9 +106,15 @@ const float PI = 3.14159265359;
 // Material textures: albedo, normal, combined (metallic, roughness, ao)
 layout(set = 1, binding = 1) uniform sampler2D material_textures[3];
 // Shadow maps
-layout(set = 1, binding = 2) uniform sampler2DArray shadow_texture;
-// Environment map is at the last index.
+// Sampled with depth comparison, returning the fraction of the texels around a point the reference is lit by.
+layout(set = 1, binding = 2) uniform sampler2DArrayShadow shadow_texture;
+// Image based lighting: the diffuse irradiance, the specular reflections prefiltered by roughness
+// down the mip levels, and the split-sum BRDF scale (r) and bias (g) by n.v and roughness.
 layout(set = 1, binding = 3) uniform samplerCube irradiance_texture;
+layout(set = 1, binding = 4) uniform samplerCube ibl_specular_texture;
+layout(set = 1, binding = 5) uniform sampler2D ibl_brdf_lut;
+// Point light shadows, by depth comparison: the static faces of every light, then the faces of their moving casters.
+layout(set = 1, binding = 6) uniform sampler2DArrayShadow point_shadow_texture;
 
 layout(location = 0) flat in int in_mode;
 layout(location = 1) flat in int use_pcf;
@@ -77,31 +131,42 @@ layout(location = 2) in struct dto {
     float bias;
     vec3 padding;
 } in_dto;
+// Index of the material's parameters, from the scene object being drawn.
+layout(location = 15) flat in uint in_material_id;
 
 
 mat3 TBN;
 
-// Percentage-Closer Filtering
+// A Poisson disc of 16 points within the unit circle. Its first 4 and 8 points are also fairly well spread.
+const vec2 poisson_disc[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725), vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464), vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590), vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+// The radius of the Poisson disc, in shadow map texels.
+const float SHADOW_FILTER_RADIUS = 1.5;
+
+// Percentage-Closer Filtering, over the taps of the shadow quality.
 float calculate_pcf(vec3 projected, int cascade_index) {
-    float shadow = 0.0;
+    int tap_count = shadow_quality <= 1 ? 4 : shadow_quality == 2 ? 8 : 16;
     vec2 texel_size = 1.0 / textureSize(shadow_texture, 0).xy;
-    for(int x = -1; x <= 1; ++x) {
-        for(int y = -1; y <= 1; ++y) {
-            float pcf_depth = texture(shadow_texture, vec3(projected.xy + vec2(x, y) * texel_size, cascade_index)).r;
-            shadow += projected.z - in_dto.bias > pcf_depth ? 1.0 : 0.0;
-        }
+    // Rotate the disc per pixel (by interleaved gradient noise), trading banding for fine noise.
+    float angle = 6.28318530 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    vec2 rotation = vec2(cos(angle), sin(angle));
+    float reference = projected.z - in_dto.bias;
+    float lit = 0.0;
+    for(int i = 0; i < tap_count; ++i) {
+        vec2 p = poisson_disc[i];
+        vec2 offset = vec2(p.x * rotation.x - p.y * rotation.y, p.x * rotation.y + p.y * rotation.x) * SHADOW_FILTER_RADIUS * texel_size;
+        lit += texture(shadow_texture, vec4(projected.xy + offset, cascade_index, reference));
     }
-    shadow /= 9;
-    return 1.0 - shadow;
+    return lit / float(tap_count);
 }
 
 float calculate_unfiltered(vec3 projected, int cascade_index) {
-    // Sample the shadow map.
-    float map_depth = texture(shadow_texture, vec3(projected.xy, cascade_index)).r;
-
-    // TODO: cast/get rid of branch.
-    float shadow = projected.z - in_dto.bias > map_depth ? 0.0 : 1.0;
-    return shadow;
+    // A single comparison, still filtered over the nearest 2x2 texels by the sampler.
+    return texture(shadow_texture, vec4(projected.xy, cascade_index, projected.z - in_dto.bias));
 }
 
 // Compare the fragment position against the depth buffer, and if it is further 
@@ -116,13 +181,46 @@ float calculate_shadow(vec4 light_space_frag_pos, vec3 normal, directional_light
     // NOTE: Transform to NDC not needed for Vulkan, but would be for OpenGL.
     // projected.xy = projected.xy * 0.5 + 0.5;
 
-    if(use_pcf == 1) {
+    if(use_pcf == 1 && shadow_quality > 0) {
         return calculate_pcf(projected, cascade_index);
     } 
 
     return calculate_unfiltered(projected, cascade_index);
 }
 
+// The fraction of the point light reaching the fragment past its shadow casters. 1.0 = not in shadow.
+float calculate_point_shadow(point_light light) {
+    if(light.shadow_index < 0) {
+        return 1.0;
+    }
+    point_shadow s = point_shadows.shadows[light.shadow_index];
+
+    // Each face covers the directions of which its axis is the major one.
+    vec3 to_fragment = in_dto.frag_position - light.position.xyz;
+    vec3 a = abs(to_fragment);
+    int face;
+    if(a.x >= a.y && a.x >= a.z) {
+        face = to_fragment.x >= 0.0 ? 0 : 1;
+    } else if(a.y >= a.z) {
+        face = to_fragment.y >= 0.0 ? 2 : 3;
+    } else {
+        face = to_fragment.z >= 0.0 ? 4 : 5;
+    }
+
+    vec4 clip = s.face_view_projections[face] * vec4(in_dto.frag_position, 1.0);
+    vec3 projected = clip.xyz / clip.w;
+    // Need to reverse y, as for the directional shadow.
+    vec2 uv = vec2(projected.x * 0.5 + 0.5, 1.0 - (projected.y * 0.5 + 0.5));
+    float reference = projected.z - s.params.z;
+
+    float lit = texture(point_shadow_texture, vec4(uv, s.params.x + float(face), reference));
+    // Moving casters are kept in faces of their own, and shadow whatever the static ones don't.
+    if(s.params.y >= 0.0) {
+        lit = min(lit, texture(point_shadow_texture, vec4(uv, s.params.y + float(face), reference)));
+    }
+    return lit;
+}
+
 // Based on a combination of GGX and Schlick-Beckmann approximation to calculate probability
 // of overshadowing micro-facets.
 float geometry_schlick_ggx(float normal_dot_direction, float roughness) {
@@ -131,10 +229,28 @@ float geometry_schlick_ggx(float normal_dot_direction, float roughness) {
     return normal_dot_direction / (normal_dot_direction * (1.0 - k) + k);
 }
 
+// Finds the cluster containing the given view space position. Returns the offset of its first
+// light in the light index list, and its light count.
+uvec2 light_cluster_get(vec4 position_view_space) {
+    uvec3 dimensions = light_clusters.dimensions.xyz;
+    vec4 clip = global_ubo.projection * position_view_space;
+    vec2 ndc = clip.xy / clip.w;
+    ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(dimensions.xy)), ivec2(0), ivec2(dimensions.xy) - 1);
+    float depth = max(-position_view_space.z, light_clusters.slice_params.z);
+    int slice = clamp(int(log2(depth) * light_clusters.slice_params.x + light_clusters.slice_params.y), 0, int(dimensions.z) - 1);
+    uint cluster = (uint(slice) * dimensions.y + uint(tile.y)) * dimensions.x + uint(tile.x);
+    return uvec2(light_clusters.data[cluster * 2], light_clusters.data[cluster * 2 + 1]);
+}
+
 vec3 calculate_point_light_radiance(point_light light, vec3 view_direction, vec3 frag_position_xyz);
 vec3 calculate_directional_light_radiance(directional_light light, vec3 view_direction);
 vec3 calculate_reflectance(vec3 albedo, vec3 normal, vec3 view_direction, vec3 light_direction, float metallic, float roughness, vec3 base_reflectivity, vec3 radiance);
 
+// Fresnel-Schlick, with less reflection at grazing angles on rough surfaces, for light from the whole environment.
+vec3 fresnel_schlick_roughness(float cos_theta, vec3 base_reflectivity, float roughness) {
+    return base_reflectivity + (max(vec3(1.0 - roughness), base_reflectivity) - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
+
 void main() {
     vec3 normal = in_dto.normal;
     vec3 tangent = in_dto.tangent;
@@ -143,8 +259,12 @@ void main() {
     TBN = mat3(tangent, bitangent, normal);
 
     // Update the normal to use a sample from the normal map.
-    vec3 local_normal = 2.0 * texture(material_textures[SAMP_NORMAL], in_dto.tex_coord).rgb - 1.0;
-    normal = normalize(TBN * local_normal);
+    if(use_normal_map) {
+        vec3 local_normal = 2.0 * texture(material_textures[SAMP_NORMAL], in_dto.tex_coord).rgb - 1.0;
+        normal = normalize(TBN * local_normal);
+    } else {
+        normal = normalize(normal);
+    }
 
     vec4 albedo_samp = texture(material_textures[SAMP_ALBEDO], in_dto.tex_coord);
     vec3 albedo = pow(albedo_samp.rgb, vec3(2.2));
@@ -160,14 +280,14 @@ void main() {
     float depth = abs(frag_position_view_space).z;
     // Get the cascade index from the current fragment's position.
     int cascade_index = -1;
-    for(int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
+    for(int i = 0; i < cascade_count; ++i) {
         if(depth < in_dto.cascade_splits[i]) {
             cascade_index = i;
             break;
         }
     }
     if(cascade_index == -1) {
-        cascade_index = MAX_SHADOW_CASCADES;
+        cascade_index = cascade_count - 1;
     }
     float shadow = calculate_shadow(in_dto.light_space_frag_pos[cascade_index], normal, instance_ubo.dir_light, cascade_index);
 
@@ -204,11 +324,13 @@ void main() {
             total_reflectance += (shadow * calculate_reflectance(albedo, normal, view_direction, light_direction, metallic, roughness, base_reflectivity, radiance));
         }
 
-        // Point light radiance
-        for(int i = 0; i < instance_ubo.num_p_lights; ++i) {
-            point_light light = instance_ubo.p_lights[i];
+        // Point light radiance, from only the lights affecting this fragment's cluster.
+        uvec2 cluster_lights = light_cluster_get(frag_position_view_space);
+        uint light_index_start = light_clusters.dimensions.w + cluster_lights.x;
+        for(uint i = 0; i < cluster_lights.y; ++i) {
+            point_light light = point_lights.lights[light_clusters.data[light_index_start + i]];
             vec3 light_direction = normalize(light.position.xyz - in_dto.frag_position.xyz);
-            vec3 radiance = calculate_point_light_radiance(light, view_direction, in_dto.frag_position.xyz);
+            vec3 radiance = calculate_point_light_radiance(light, view_direction, in_dto.frag_position.xyz) * calculate_point_shadow(light);
 
             total_reflectance += calculate_reflectance(albedo, normal, view_direction, light_direction, metallic, roughness, base_reflectivity, radiance);
         }
@@ -219,6 +341,20 @@ void main() {
         // Combine irradiance with albedo and ambient occlusion. 
         // Also add in total accumulated reflectance.
         vec3 ambient = irradiance * albedo * ao;
+        if(global_ubo.use_ibl_specular != 0) {
+            // Split-sum indirect specular, with the reflections prefiltered for this roughness.
+            float normal_dot_view = max(dot(normal, view_direction), 0.0);
+            vec3 fresnel = fresnel_schlick_roughness(normal_dot_view, base_reflectivity, roughness);
+            vec3 reflection_direction = reflect(-view_direction, normal);
+            float max_lod = float(textureQueryLevels(ibl_specular_texture) - 1);
+            vec3 prefiltered = textureLod(ibl_specular_texture, reflection_direction, roughness * max_lod).rgb;
+            vec2 brdf = texture(ibl_brdf_lut, vec2(normal_dot_view, roughness)).rg;
+            vec3 specular = prefiltered * (fresnel * brdf.x + brdf.y);
+
+            // Only the light not reflected is diffused, and only by non-metals.
+            vec3 diffuse = (vec3(1.0) - fresnel) * (1.0 - metallic) * irradiance * albedo;
+            ambient = (diffuse + specular) * ao;
+        }
         // Modify total reflectance by the ambient colour.
         vec3 colour = ambient + total_reflectance;
 
@@ -249,6 +385,15 @@ void main() {
     } else if(in_mode == 2) {
         out_colour = vec4(abs(normal), 1.0);
     }
+
+    if (weighted_blend) {
+        // Weighted blended order-independent transparency (McGuire and Bavoil, 2013). Nearer, more
+        // opaque surfaces are weighted higher, so the composite approximates sorted blending.
+        float alpha = out_colour.a;
+        float weight = clamp(alpha * 3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);
+        out_accumulation = vec4(out_colour.rgb * alpha, alpha) * weight;
+        out_coverage = alpha;
+    }
 }
 
 vec3 calculate_reflectance(vec3 albedo, vec3 normal, vec3 view_direction, vec3 light_direction, float metallic, float roughness, vec3 base_reflectivity, vec3 radiance) {
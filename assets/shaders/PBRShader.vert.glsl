@@ -5,6 +5,8 @@ layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_texcoord;
 layout(location = 3) in vec4 in_colour;
 layout(location = 4) in vec3 in_tangent;
+// Per-instance. Index into the scene object buffer.
+layout(location = 5) in uint in_object_index;
 
 const int MAX_SHADOW_CASCADES = 4;
 
@@ -17,14 +19,20 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
 	int mode;
     int use_pcf;
     float bias;
-    vec2 padding;
+    // Non-zero once the prefiltered specular cube and BRDF lookup table are bound.
+    uint use_ibl_specular;
+    float padding;
 } global_ubo;
 
-layout(push_constant) uniform push_constants {
-	
-	// Only guaranteed a total of 128 bytes.
-	mat4 model; // 64 bytes
-} u_push_constants;
+struct scene_object {
+    mat4 model;
+    uint material_id;
+    uint padding[3];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer scene_object_buffer {
+    scene_object objects[];
+} scene_objects;
 
 layout(location = 0) out int out_mode;
 layout(location = 1) out int use_pcf;
@@ -42,7 +50,11 @@ layout(location = 2) out struct dto {
     float bias;
     vec3 padding;
 } out_dto;
+// Index of the material's parameters. Follows the locations taken by the DTO.
+layout(location = 15) flat out uint out_material_id;
 
+// NOTE: Must match the depth prepass, which the scene pass tests against for equality.
+invariant gl_Position;
 
 // Vulkan's Y axis is flipped and Z range is halved.
 const mat4 bias = mat4( 
@@ -53,17 +65,19 @@ const mat4 bias = mat4(
 );
 
 void main() {
+	mat4 model = scene_objects.objects[in_object_index].model;
+	out_material_id = scene_objects.objects[in_object_index].material_id;
 	out_dto.tex_coord = in_texcoord;
 	out_dto.colour = in_colour;
 	// Fragment position in world space.
-	out_dto.frag_position = vec3(u_push_constants.model * vec4(in_position, 1.0));
+	out_dto.frag_position = vec3(model * vec4(in_position, 1.0));
 	// Copy the normal over.
-	mat3 m3_model = mat3(u_push_constants.model);
+	mat3 m3_model = mat3(model);
 	out_dto.normal = normalize(m3_model * in_normal);
 	out_dto.tangent = normalize(m3_model * in_tangent);
 	out_dto.cascade_splits = global_ubo.cascade_splits;
 	out_dto.view_position = global_ubo.view_position;
-    gl_Position = global_ubo.projection * global_ubo.view * u_push_constants.model * vec4(in_position, 1.0);
+    gl_Position = global_ubo.projection * global_ubo.view * model * vec4(in_position, 1.0);
 
 	// Get a light-space-transformed fragment positions.
     for(int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
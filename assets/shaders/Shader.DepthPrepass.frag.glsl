@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only. Nothing is written besides the depth of the fragment.
+void main() {
+}
@@ -0,0 +1,33 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_texcoord;
+layout(location = 3) in vec4 in_colour;
+layout(location = 4) in vec3 in_tangent;
+// Per-instance. Index into the scene object buffer.
+layout(location = 5) in uint in_object_index;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+} global_ubo;
+
+struct scene_object {
+    mat4 model;
+    uint material_id;
+    uint padding[3];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer scene_object_buffer {
+    scene_object objects[];
+} scene_objects;
+
+// NOTE: The scene pass tests against this depth for equality, so the position must be
+// computed exactly as the PBR shader computes it.
+invariant gl_Position;
+
+void main() {
+	mat4 model = scene_objects.objects[in_object_index].model;
+    gl_Position = global_ubo.projection * global_ubo.view * model * vec4(in_position, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 450
+
+// Integrates the GGX specular BRDF over the hemisphere into a lookup table of the scale (r) and bias (g)
+// applied to the reflectance at normal incidence, indexed by n.v (u) and roughness (v).
+// NOTE: The push constants must match ibl_brdf_block in ibl.c.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+const float PI = 3.14159265358979323846;
+
+layout(set = 0, binding = 0, rgba8) uniform writeonly image2D target;
+
+layout(push_constant) uniform push_constants {
+    uint size;
+    uint sample_count;
+} local_ubo;
+
+vec2 hammersley(uint i, uint count) {
+    uint bits = bitfieldReverse(i);
+    return vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10);
+}
+
+// Schlick-GGX, with the k used for image based lighting.
+float geometry_schlick_ggx(float normal_dot_direction, float roughness) {
+    float k = (roughness * roughness) / 2.0;
+    return normal_dot_direction / (normal_dot_direction * (1.0 - k) + k);
+}
+
+vec2 integrate(float normal_dot_view, float roughness) {
+    vec3 view_direction = vec3(sqrt(1.0 - normal_dot_view * normal_dot_view), 0.0, normal_dot_view);
+    float alpha = roughness * roughness;
+    float alpha_sq = alpha * alpha;
+    float scale = 0.0;
+    float bias = 0.0;
+    for (uint i = 0u; i < local_ubo.sample_count; ++i) {
+        vec2 xi = hammersley(i, local_ubo.sample_count);
+        float phi = 2.0 * PI * xi.x;
+        float cos_theta = sqrt((1.0 - xi.y) / (1.0 + (alpha_sq - 1.0) * xi.y));
+        float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        vec3 halfway = vec3(cos(phi) * sin_theta, sin(phi) * sin_theta, cos_theta);
+        vec3 light_direction = normalize(2.0 * dot(view_direction, halfway) * halfway - view_direction);
+
+        float normal_dot_light = max(light_direction.z, 0.0);
+        float normal_dot_halfway = max(halfway.z, 0.0);
+        float view_dot_halfway = max(dot(view_direction, halfway), 0.0);
+        if (normal_dot_light > 0.0) {
+            float geometry = geometry_schlick_ggx(normal_dot_view, roughness) * geometry_schlick_ggx(normal_dot_light, roughness);
+            float visibility = (geometry * view_dot_halfway) / (normal_dot_halfway * normal_dot_view);
+            float fresnel = pow(1.0 - view_dot_halfway, 5.0);
+            scale += (1.0 - fresnel) * visibility;
+            bias += fresnel * visibility;
+        }
+    }
+    return vec2(scale, bias) / float(local_ubo.sample_count);
+}
+
+void main() {
+    uvec2 id = gl_GlobalInvocationID.xy;
+    if (id.x >= local_ubo.size || id.y >= local_ubo.size) {
+        return;
+    }
+
+    vec2 uv = (vec2(id) + 0.5) / float(local_ubo.size);
+    imageStore(target, ivec2(id), vec4(integrate(uv.x, uv.y), 0.0, 1.0));
+}
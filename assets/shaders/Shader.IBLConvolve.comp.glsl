@@ -0,0 +1,115 @@
+#version 450
+
+// Convolves an environment cubemap into one of the image based lighting cubes, a texel per invocation
+// and a face per z workgroup: either the diffuse irradiance, or one mip level of the specular reflections
+// prefiltered for a roughness.
+// NOTE: The push constants must match ibl_convolve_block in ibl.c.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+const uint MODE_IRRADIANCE = 0u;
+const uint MODE_SPECULAR = 1u;
+
+const float PI = 3.14159265358979323846;
+
+layout(set = 0, binding = 0) uniform samplerCube environment;
+layout(set = 0, binding = 1, rgba8) uniform writeonly imageCube target;
+
+layout(push_constant) uniform push_constants {
+    uint mode;
+    // The width and height of each face of the target.
+    uint size;
+    uint sample_count;
+    // The width and height of the base level of each face of the environment.
+    uint environment_size;
+    float roughness;
+} local_ubo;
+
+// The direction through the centre of a texel of the given face, with uv from -1 to 1.
+vec3 cube_direction(uint face, vec2 uv) {
+    switch (face) {
+        case 0: return normalize(vec3(1.0, -uv.y, -uv.x));
+        case 1: return normalize(vec3(-1.0, -uv.y, uv.x));
+        case 2: return normalize(vec3(uv.x, 1.0, uv.y));
+        case 3: return normalize(vec3(uv.x, -1.0, -uv.y));
+        case 4: return normalize(vec3(uv.x, -uv.y, 1.0));
+        default: return normalize(vec3(-uv.x, -uv.y, -1.0));
+    }
+}
+
+// A low-discrepancy point in the unit square.
+vec2 hammersley(uint i, uint count) {
+    uint bits = bitfieldReverse(i);
+    return vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10);
+}
+
+mat3 tangent_basis(vec3 normal) {
+    vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, normal));
+    return mat3(tangent, cross(normal, tangent), normal);
+}
+
+// The mip level of the environment whose texels cover about the solid angle of a sample with the given pdf.
+float environment_lod(float pdf) {
+    float texel_solid_angle = 4.0 * PI / (6.0 * float(local_ubo.environment_size * local_ubo.environment_size));
+    float sample_solid_angle = 1.0 / (float(local_ubo.sample_count) * pdf + 0.0001);
+    return max(0.5 * log2(sample_solid_angle / texel_solid_angle), 0.0);
+}
+
+// The cosine-weighted average of the incoming light, so albedo * irradiance is the diffuse reflection.
+vec3 irradiance(vec3 normal) {
+    mat3 basis = tangent_basis(normal);
+    vec3 total = vec3(0.0);
+    for (uint i = 0u; i < local_ubo.sample_count; ++i) {
+        vec2 xi = hammersley(i, local_ubo.sample_count);
+        float phi = 2.0 * PI * xi.x;
+        float cos_theta = sqrt(1.0 - xi.y);
+        float sin_theta = sqrt(xi.y);
+        vec3 direction = basis * vec3(cos(phi) * sin_theta, sin(phi) * sin_theta, cos_theta);
+        total += textureLod(environment, direction, environment_lod(cos_theta / PI)).rgb;
+    }
+    return total / float(local_ubo.sample_count);
+}
+
+// The environment prefiltered with the GGX distribution, taking the view and reflection directions to be the normal.
+vec3 specular(vec3 normal) {
+    if (local_ubo.roughness <= 0.0) {
+        return textureLod(environment, normal, 0.0).rgb;
+    }
+
+    mat3 basis = tangent_basis(normal);
+    float alpha = local_ubo.roughness * local_ubo.roughness;
+    float alpha_sq = alpha * alpha;
+    vec3 total = vec3(0.0);
+    float weight = 0.0;
+    for (uint i = 0u; i < local_ubo.sample_count; ++i) {
+        vec2 xi = hammersley(i, local_ubo.sample_count);
+        float phi = 2.0 * PI * xi.x;
+        float cos_theta = sqrt((1.0 - xi.y) / (1.0 + (alpha_sq - 1.0) * xi.y));
+        float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        vec3 halfway = basis * vec3(cos(phi) * sin_theta, sin(phi) * sin_theta, cos_theta);
+        vec3 light_direction = normalize(2.0 * dot(normal, halfway) * halfway - normal);
+
+        float normal_dot_light = dot(normal, light_direction);
+        if (normal_dot_light > 0.0) {
+            // With the view along the normal, the pdf of the reflected direction is D / 4.
+            float denom = cos_theta * cos_theta * (alpha_sq - 1.0) + 1.0;
+            float distribution = alpha_sq / (PI * denom * denom);
+            total += textureLod(environment, light_direction, environment_lod(distribution * 0.25)).rgb * normal_dot_light;
+            weight += normal_dot_light;
+        }
+    }
+    return total / max(weight, 0.0001);
+}
+
+void main() {
+    uvec3 id = gl_GlobalInvocationID;
+    if (id.x >= local_ubo.size || id.y >= local_ubo.size) {
+        return;
+    }
+
+    vec2 uv = (vec2(id.xy) + 0.5) / float(local_ubo.size) * 2.0 - 1.0;
+    vec3 direction = cube_direction(id.z, uv);
+    vec3 colour = local_ubo.mode == MODE_IRRADIANCE ? irradiance(direction) : specular(direction);
+    imageStore(target, ivec3(id.xy, id.z), vec4(colour, 1.0));
+}
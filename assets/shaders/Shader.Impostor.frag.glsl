@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) out vec4 out_colour;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+	vec4 view_position;
+	vec4 light_direction;
+	vec4 light_colour;
+} global_ubo;
+
+// Samplers. 0 is the unlit albedo, with coverage in alpha, and 1 the object-space normals.
+const int SAMP_ALBEDO = 0;
+const int SAMP_NORMAL = 1;
+layout(set = 1, binding = 0) uniform sampler2D atlases[2];
+
+// Data Transfer Object
+layout(location = 1) in struct dto {
+	vec2 texcoord;
+	vec3 axis_x;
+	vec3 axis_y;
+	vec3 axis_z;
+} in_dto;
+
+const float ambient = 0.15;
+
+void main() {
+	vec4 albedo = texture(atlases[SAMP_ALBEDO], in_dto.texcoord);
+	if (albedo.a < 0.5) {
+		discard;
+	}
+	vec3 n = texture(atlases[SAMP_NORMAL], in_dto.texcoord).xyz * 2.0 - 1.0;
+	vec3 normal = normalize(in_dto.axis_x * n.x + in_dto.axis_y * n.y + in_dto.axis_z * n.z);
+	float n_dot_l = max(dot(normal, -normalize(global_ubo.light_direction.xyz)), 0.0);
+	out_colour = vec4(albedo.rgb * (ambient + global_ubo.light_colour.rgb * n_dot_l), 1.0);
+}
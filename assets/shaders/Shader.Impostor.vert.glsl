@@ -0,0 +1,82 @@
+#version 450
+
+// A unit quad, from (0, 0) to (1, 1).
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec2 in_texcoord;
+// Per-instance. The world center and radius of the mesh, and its x and y axes.
+layout(location = 2) in vec4 in_center_radius;
+layout(location = 3) in vec4 in_axis_x;
+layout(location = 4) in vec4 in_axis_y;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+	vec4 view_position;
+	vec4 light_direction;
+	vec4 light_colour;
+} global_ubo;
+
+layout(push_constant) uniform push_constants {
+	// The number of frames along each side of the atlases.
+	uint frame_count;
+} u_push_constants;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec2 texcoord;
+	vec3 axis_x;
+	vec3 axis_y;
+	vec3 axis_z;
+} out_dto;
+
+// NOTE: The octahedral mapping and frame basis mirror those the tools bake impostors with, and
+// must be changed in both places.
+vec2 octahedral_encode(vec3 d) {
+	d /= abs(d.x) + abs(d.y) + abs(d.z);
+	vec2 p = d.xz;
+	if (d.y < 0.0) {
+		p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return p * 0.5 + 0.5;
+}
+
+vec3 octahedral_decode(vec2 uv) {
+	vec2 p = uv * 2.0 - 1.0;
+	vec3 d = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+	if (d.y < 0.0) {
+		d.xz = (1.0 - abs(d.zx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.z >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(d);
+}
+
+void main() {
+	vec3 axis_x = in_axis_x.xyz;
+	vec3 axis_y = in_axis_y.xyz;
+	vec3 axis_z = cross(axis_x, axis_y);
+
+	// The direction to the camera in the space of the mesh.
+	vec3 to_view = global_ubo.view_position.xyz - in_center_radius.xyz;
+	vec3 local_view = vec3(dot(to_view, axis_x), dot(to_view, axis_y), dot(to_view, axis_z));
+	if (dot(local_view, local_view) < 1e-8) {
+		local_view = vec3(0.0, 0.0, 1.0);
+	}
+
+	// Draw the frame baked nearest that direction, facing the way it was baked.
+	float last = float(max(u_push_constants.frame_count, 2u) - 1u);
+	vec2 frame = clamp(floor(octahedral_encode(normalize(local_view)) * last + 0.5), vec2(0.0), vec2(last));
+	vec3 d = octahedral_decode(frame / last);
+	vec3 world_up = abs(d.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(world_up, d));
+	vec3 up = cross(d, right);
+
+	vec3 world_right = axis_x * right.x + axis_y * right.y + axis_z * right.z;
+	vec3 world_up_axis = axis_x * up.x + axis_y * up.y + axis_z * up.z;
+	vec2 corner = in_position * 2.0 - 1.0;
+	vec3 world_position = in_center_radius.xyz + (world_right * corner.x + world_up_axis * corner.y) * in_center_radius.w;
+
+	out_dto.texcoord = (frame + in_texcoord) / (last + 1.0);
+	out_dto.axis_x = axis_x;
+	out_dto.axis_y = axis_y;
+	out_dto.axis_z = axis_z;
+	gl_Position = global_ubo.projection * global_ubo.view * vec4(world_position, 1.0);
+}
@@ -0,0 +1,203 @@
+#version 450
+
+// Generates up to 12 mip levels below the base level of an RGBA8 image in a single dispatch. Each
+// workgroup reduces a 64x64 tile of the base level down to one texel of level 6, and the last
+// workgroup of a layer to finish then reduces level 6 down to the remaining levels.
+// NOTE: The push constants must match mip_downsample_push_constants in vulkan_mip_downsample.c.
+
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+const uint FILTER_LINEAR = 0u;
+const uint FILTER_SRGB = 1u;
+const uint FILTER_NORMAL_MAP = 2u;
+
+layout(set = 0, binding = 0, rgba8) uniform readonly image2DArray mip_0;
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2DArray mip_1;
+layout(set = 0, binding = 2, rgba8) uniform writeonly image2DArray mip_2;
+layout(set = 0, binding = 3, rgba8) uniform writeonly image2DArray mip_3;
+layout(set = 0, binding = 4, rgba8) uniform writeonly image2DArray mip_4;
+layout(set = 0, binding = 5, rgba8) uniform writeonly image2DArray mip_5;
+// Read back by the last workgroup, after being written by all of them.
+layout(set = 0, binding = 6, rgba8) uniform coherent image2DArray mip_6;
+layout(set = 0, binding = 7, rgba8) uniform writeonly image2DArray mip_7;
+layout(set = 0, binding = 8, rgba8) uniform writeonly image2DArray mip_8;
+layout(set = 0, binding = 9, rgba8) uniform writeonly image2DArray mip_9;
+layout(set = 0, binding = 10, rgba8) uniform writeonly image2DArray mip_10;
+layout(set = 0, binding = 11, rgba8) uniform writeonly image2DArray mip_11;
+layout(set = 0, binding = 12, rgba8) uniform writeonly image2DArray mip_12;
+
+// The number of workgroups of each layer which have finished with level 6. Zeroed before each dispatch.
+layout(set = 0, binding = 13) coherent buffer counter_buffer {
+    uint counters[];
+};
+
+layout(push_constant) uniform push_constants {
+    // The size of the base level.
+    uvec2 size;
+    // The number of levels to generate below the base level.
+    uint mip_count;
+    // One of the FILTER_ values.
+    uint filter_mode;
+    // The number of workgroups per layer.
+    uint group_count;
+    // The index of the counter of the first layer.
+    uint counter_offset;
+} local_ubo;
+
+// One texel of each level from level 2 down, in decoded form, shared to produce the next level.
+shared vec4 texels[16][16];
+shared bool is_last;
+
+uvec2 level_size(uint level) {
+    return max(local_ubo.size >> level, uvec2(1u));
+}
+
+// Converts a stored texel to the space it is averaged in.
+vec4 decode(vec4 texel) {
+    if (local_ubo.filter_mode == FILTER_SRGB) {
+        vec3 low = texel.rgb / 12.92;
+        vec3 high = pow((texel.rgb + 0.055) / 1.055, vec3(2.4));
+        return vec4(mix(high, low, lessThanEqual(texel.rgb, vec3(0.04045))), texel.a);
+    }
+    if (local_ubo.filter_mode == FILTER_NORMAL_MAP) {
+        return vec4(texel.rgb * 2.0 - 1.0, texel.a);
+    }
+    return texel;
+}
+
+// The inverse of decode.
+vec4 encode(vec4 value) {
+    if (local_ubo.filter_mode == FILTER_SRGB) {
+        vec3 low = value.rgb * 12.92;
+        vec3 high = 1.055 * pow(value.rgb, vec3(1.0 / 2.4)) - 0.055;
+        return vec4(mix(high, low, lessThanEqual(value.rgb, vec3(0.0031308))), value.a);
+    }
+    if (local_ubo.filter_mode == FILTER_NORMAL_MAP) {
+        return vec4(value.rgb * 0.5 + 0.5, value.a);
+    }
+    return value;
+}
+
+// Averages a 2x2 block of decoded texels. Those with a weight of 0 lie past the edge of the level, which
+// happens when a side of it is odd or already 1.
+vec4 reduce(vec4 a, vec4 b, vec4 c, vec4 d, vec4 weights) {
+    float total = dot(weights, vec4(1.0));
+    if (total == 0.0) {
+        return vec4(0.0);
+    }
+    vec4 value = (a * weights.x + b * weights.y + c * weights.z + d * weights.w) / total;
+    if (local_ubo.filter_mode == FILTER_NORMAL_MAP) {
+        // Averaged normals shorten, and opposing ones may cancel out entirely.
+        float len = length(value.xyz);
+        value.xyz = len > 0.00001 ? value.xyz / len : vec3(0.0, 0.0, 1.0);
+    }
+    return value;
+}
+
+float texel_weight(uvec2 coord, uint level) {
+    return all(lessThan(coord, level_size(level))) ? 1.0 : 0.0;
+}
+
+// Only the base level, and level 6 for the last workgroup, are ever read.
+vec4 load_level(uint level, uvec2 coord, uint layer) {
+    ivec3 p = ivec3(ivec2(min(coord, level_size(level) - 1u)), int(layer));
+    return decode(level == 0u ? imageLoad(mip_0, p) : imageLoad(mip_6, p));
+}
+
+void store_level(uint level, uvec2 coord, uint layer, vec4 value) {
+    if (level > local_ubo.mip_count || texel_weight(coord, level) == 0.0) {
+        return;
+    }
+    ivec3 p = ivec3(ivec2(coord), int(layer));
+    vec4 texel = encode(value);
+    switch (level) {
+        case 1u: imageStore(mip_1, p, texel); break;
+        case 2u: imageStore(mip_2, p, texel); break;
+        case 3u: imageStore(mip_3, p, texel); break;
+        case 4u: imageStore(mip_4, p, texel); break;
+        case 5u: imageStore(mip_5, p, texel); break;
+        case 6u: imageStore(mip_6, p, texel); break;
+        case 7u: imageStore(mip_7, p, texel); break;
+        case 8u: imageStore(mip_8, p, texel); break;
+        case 9u: imageStore(mip_9, p, texel); break;
+        case 10u: imageStore(mip_10, p, texel); break;
+        case 11u: imageStore(mip_11, p, texel); break;
+        case 12u: imageStore(mip_12, p, texel); break;
+    }
+}
+
+// Reduces a 64x64 tile of the source level to the six levels below it. The tile is indexed in texels
+// of the lowest of those levels, of which it covers exactly one.
+void downsample_tile(uvec2 tile, uint source_level, uint layer) {
+    uint index = gl_LocalInvocationIndex;
+    uvec2 local = uvec2(index % 16u, index / 16u);
+
+    // The first level below: each invocation produces a 2x2 quad, from a 4x4 block of the source.
+    vec4 quad[4];
+    vec4 quad_weights;
+    for (uint i = 0u; i < 4u; ++i) {
+        uvec2 coord = tile * 32u + local * 2u + uvec2(i & 1u, i >> 1u);
+        vec4 source[4];
+        vec4 weights;
+        for (uint j = 0u; j < 4u; ++j) {
+            uvec2 source_coord = coord * 2u + uvec2(j & 1u, j >> 1u);
+            source[j] = load_level(source_level, source_coord, layer);
+            weights[j] = texel_weight(source_coord, source_level);
+        }
+        quad[i] = reduce(source[0], source[1], source[2], source[3], weights);
+        quad_weights[i] = texel_weight(coord, source_level + 1u);
+        store_level(source_level + 1u, coord, layer, quad[i]);
+    }
+
+    // The second, straight from the quad.
+    uvec2 coord = tile * 16u + local;
+    vec4 value = reduce(quad[0], quad[1], quad[2], quad[3], quad_weights);
+    store_level(source_level + 2u, coord, layer, value);
+    texels[local.y][local.x] = value;
+
+    // The rest, through shared memory, with a quarter of the invocations taking part in each.
+    uint side = 8u;
+    for (uint level = 3u; level <= 6u; ++level) {
+        barrier();
+        uvec2 q = uvec2(index % side, index / side);
+        if (index < side * side) {
+            vec4 source[4];
+            vec4 weights;
+            for (uint j = 0u; j < 4u; ++j) {
+                uvec2 source_local = q * 2u + uvec2(j & 1u, j >> 1u);
+                source[j] = texels[source_local.y][source_local.x];
+                weights[j] = texel_weight(tile * (side * 2u) + source_local, source_level + level - 1u);
+            }
+            value = reduce(source[0], source[1], source[2], source[3], weights);
+            store_level(source_level + level, tile * side + q, layer, value);
+        }
+        barrier();
+        if (index < side * side) {
+            texels[q.y][q.x] = value;
+        }
+        side /= 2u;
+    }
+}
+
+void main() {
+    uint layer = gl_WorkGroupID.z;
+    downsample_tile(gl_WorkGroupID.xy, 0u, layer);
+    if (local_ubo.mip_count <= 6u) {
+        return;
+    }
+
+    // Make this workgroup's texel of level 6 visible, then find out if it was the last one needed.
+    if (gl_LocalInvocationIndex == 0u) {
+        memoryBarrierImage();
+        uint finished = atomicAdd(counters[local_ubo.counter_offset + layer], 1u);
+        is_last = finished == local_ubo.group_count - 1u;
+    }
+    barrier();
+    if (!is_last) {
+        return;
+    }
+
+    // Level 6 is at most 64x64, so a single tile covers it.
+    memoryBarrierImage();
+    downsample_tile(uvec2(0u), 6u, layer);
+}
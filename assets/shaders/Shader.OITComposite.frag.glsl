@@ -0,0 +1,27 @@
+#version 450
+
+// Resolves weighted blended order-independent transparency (McGuire and Bavoil, 2013) over the
+// colour beneath it, which is blended with its standard alpha blending.
+layout(location = 0) out vec4 out_colour;
+
+layout(set = 1, binding = 0) uniform sampler2D accumulation;
+layout(set = 1, binding = 1) uniform sampler2D coverage;
+
+// Data Transfer Object
+layout(location = 1) in struct dto {
+	vec2 texcoord;
+} in_dto;
+
+void main() {
+	float alpha = texture(coverage, in_dto.texcoord).r;
+	// Nothing transparent was drawn here.
+	if (alpha < 0.00001) {
+		discard;
+	}
+
+	// The weighted average colour of the transparent surfaces, covering the colour beneath by their
+	// combined alpha.
+	vec4 accumulated = texture(accumulation, in_dto.texcoord);
+	vec3 average = accumulated.rgb / max(accumulated.a, 0.00001);
+	out_colour = vec4(average, alpha);
+}
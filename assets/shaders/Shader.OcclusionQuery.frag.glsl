@@ -0,0 +1,5 @@
+#version 450
+
+// Nothing is written. The samples passing the depth test are counted by the open occlusion query.
+void main() {
+}
@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+} global_ubo;
+
+void main() {
+    gl_Position = global_ubo.projection * global_ubo.view * vec4(in_position, 1.0);
+}
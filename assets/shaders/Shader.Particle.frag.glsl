@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) out vec4 out_colour;
+
+// Data Transfer Object
+layout(location = 1) in struct dto {
+	vec4 colour;
+	vec2 texcoord;
+} in_dto;
+
+void main() {
+	// A soft round falloff from the center of the quad to its edge.
+	float distance_from_center = length(in_dto.texcoord * 2.0 - 1.0);
+	float falloff = 1.0 - smoothstep(0.0, 1.0, distance_from_center);
+	float alpha = in_dto.colour.a * falloff;
+	if (alpha <= 0.0) {
+		discard;
+	}
+	out_colour = vec4(in_dto.colour.rgb, alpha);
+}
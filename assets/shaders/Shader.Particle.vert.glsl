@@ -0,0 +1,31 @@
+#version 450
+
+// A unit quad, from (0, 0) to (1, 1).
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec2 in_texcoord;
+// Per-instance. The world position and size of the particle, and its colour.
+layout(location = 2) in vec4 in_position_size;
+layout(location = 3) in vec4 in_colour;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+} global_ubo;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec4 colour;
+	vec2 texcoord;
+} out_dto;
+
+void main() {
+	// Faces the camera, using its right and up axes from the view matrix.
+	vec3 right = vec3(global_ubo.view[0][0], global_ubo.view[1][0], global_ubo.view[2][0]);
+	vec3 up = vec3(global_ubo.view[0][1], global_ubo.view[1][1], global_ubo.view[2][1]);
+	vec2 corner = (in_position - vec2(0.5)) * in_position_size.w;
+	vec3 world_position = in_position_size.xyz + right * corner.x + up * corner.y;
+
+	out_dto.colour = in_colour;
+	out_dto.texcoord = in_texcoord;
+	gl_Position = global_ubo.projection * global_ubo.view * vec4(world_position, 1.0);
+}
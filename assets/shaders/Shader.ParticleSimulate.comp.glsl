@@ -0,0 +1,213 @@
+#version 450
+
+// Runs one step of the particle simulation of an emitter over its range of the particle buffer.
+// NOTE: The hash and spawning below mirror particle_emitter.c, and must be changed in both places.
+
+layout(local_size_x = 64) in;
+
+const uint MODE_RESET = 0u;
+const uint MODE_SIMULATE_ADDITIVE = 1u;
+const uint MODE_SIMULATE_SORTED = 2u;
+const uint MODE_SORT = 3u;
+const uint MODE_GATHER = 4u;
+const uint MODE_CLEAR = 5u;
+
+const float PI = 3.14159265358979323846;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    vec4 view_position;
+} global_ubo;
+
+struct particle {
+    // xyz = position, w = age.
+    vec4 position_age;
+    // xyz = velocity, w = lifetime.
+    vec4 velocity_lifetime;
+};
+
+struct particle_instance {
+    vec4 position_size;
+    vec4 colour;
+};
+
+// Layout-compatible with renderer_indirect_draw_command.
+struct draw_command {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+layout(std430, set = 0, binding = 1) buffer particle_buffer {
+    particle particles[];
+};
+
+layout(std430, set = 0, binding = 2) buffer sort_key_buffer {
+    // x = distance bits (0 for dead particles), y = particle index within the emitter.
+    uvec2 sort_keys[];
+};
+
+layout(std430, set = 0, binding = 3) writeonly buffer instance_buffer {
+    particle_instance instances[];
+};
+
+layout(std430, set = 0, binding = 4) buffer command_buffer {
+    draw_command commands[];
+};
+
+layout(push_constant) uniform push_constants {
+    uint mode;
+    uint base_index;
+    uint capacity;
+    uint spawn_first;
+    uint spawn_count;
+    uint seed;
+    // The bitonic sort step: log2 of the compare distance in bits 0-7, log2 of the block size in bits 8-15.
+    uint sort_step;
+    uint command_index;
+    uint instance_base;
+    uint colour_start;
+    uint colour_end;
+    float delta_time;
+    float size_start;
+    float size_end;
+    float drag;
+    float spread_cos;
+    vec4 position_radius;
+    vec4 direction_lifetime_min;
+    vec4 gravity_lifetime_max;
+    vec2 speed;
+} local_ubo;
+
+uint particle_hash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float particle_random(uint particle_seed, uint n) {
+    return float(particle_hash(particle_seed + n) >> 8) * (1.0 / 16777216.0);
+}
+
+particle particle_spawn(uint index) {
+    uint particle_seed = particle_hash(index ^ local_ubo.seed);
+    particle p;
+
+    float lifetime = mix(local_ubo.direction_lifetime_min.w, local_ubo.gravity_lifetime_max.w, particle_random(particle_seed, 0u));
+
+    // Within a cone about the emission direction.
+    vec3 direction = local_ubo.direction_lifetime_min.xyz;
+    vec3 up = abs(direction.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, direction));
+    vec3 bitangent = cross(direction, tangent);
+    float speed = mix(local_ubo.speed.x, local_ubo.speed.y, particle_random(particle_seed, 1u));
+    float cos_theta = mix(local_ubo.spread_cos, 1.0, particle_random(particle_seed, 2u));
+    float sin_theta = sqrt(max(0.0, 1.0 - cos_theta * cos_theta));
+    float phi = 2.0 * PI * particle_random(particle_seed, 3u);
+    vec3 velocity = (tangent * (cos(phi) * sin_theta) + bitangent * (sin(phi) * sin_theta) + direction * cos_theta) * speed;
+
+    // Within a sphere about the emitter.
+    float z = particle_random(particle_seed, 4u) * 2.0 - 1.0;
+    float ring = sqrt(max(0.0, 1.0 - z * z));
+    float angle = 2.0 * PI * particle_random(particle_seed, 5u);
+    float radius = local_ubo.position_radius.w * pow(particle_random(particle_seed, 6u), 1.0 / 3.0);
+    vec3 position = local_ubo.position_radius.xyz + vec3(cos(angle) * ring, sin(angle) * ring, z) * radius;
+
+    p.position_age = vec4(position, 0.0);
+    p.velocity_lifetime = vec4(velocity, lifetime);
+    return p;
+}
+
+particle_instance particle_instance_make(particle p) {
+    float t = p.velocity_lifetime.w > 0.0 ? p.position_age.w / p.velocity_lifetime.w : 1.0;
+    particle_instance instance;
+    instance.position_size = vec4(p.position_age.xyz, mix(local_ubo.size_start, local_ubo.size_end, t));
+    instance.colour = mix(unpackUnorm4x8(local_ubo.colour_start), unpackUnorm4x8(local_ubo.colour_end), t);
+    return instance;
+}
+
+// Spawns or advances the particle, returning if it is alive afterward.
+bool particle_simulate(uint index, out particle p) {
+    uint slot = local_ubo.base_index + index;
+    if (((index - local_ubo.spawn_first) & (local_ubo.capacity - 1)) < local_ubo.spawn_count) {
+        p = particle_spawn(index);
+        particles[slot] = p;
+        return p.velocity_lifetime.w > 0.0;
+    }
+
+    p = particles[slot];
+    if (p.position_age.w >= p.velocity_lifetime.w) {
+        return false;
+    }
+    float dt = local_ubo.delta_time;
+    float damping = max(0.0, 1.0 - local_ubo.drag * dt);
+    p.velocity_lifetime.xyz = (p.velocity_lifetime.xyz + local_ubo.gravity_lifetime_max.xyz * dt) * damping;
+    p.position_age.xyz += p.velocity_lifetime.xyz * dt;
+    p.position_age.w += dt;
+    particles[slot] = p;
+    return p.position_age.w < p.velocity_lifetime.w;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+
+    if (local_ubo.mode == MODE_RESET) {
+        // Counts up from zero as live particles are found.
+        if (index == 0u) {
+            commands[local_ubo.command_index].index_count = 6u;
+            commands[local_ubo.command_index].instance_count = 0u;
+            commands[local_ubo.command_index].first_index = 0u;
+            commands[local_ubo.command_index].vertex_offset = 0;
+            commands[local_ubo.command_index].first_instance = local_ubo.instance_base;
+        }
+        return;
+    }
+
+    if (index >= local_ubo.capacity) {
+        return;
+    }
+
+    if (local_ubo.mode == MODE_CLEAR) {
+        particles[local_ubo.base_index + index].position_age = vec4(0.0);
+        particles[local_ubo.base_index + index].velocity_lifetime = vec4(0.0);
+    } else if (local_ubo.mode == MODE_SIMULATE_ADDITIVE) {
+        // Order doesn't matter when adding, so live particles are appended as found.
+        particle p;
+        if (particle_simulate(index, p)) {
+            uint slot = atomicAdd(commands[local_ubo.command_index].instance_count, 1u);
+            instances[local_ubo.instance_base + slot] = particle_instance_make(p);
+        }
+    } else if (local_ubo.mode == MODE_SIMULATE_SORTED) {
+        particle p;
+        uvec2 key = uvec2(0u, index);
+        if (particle_simulate(index, p)) {
+            atomicAdd(commands[local_ubo.command_index].instance_count, 1u);
+            // Squared distances are non-negative, so their bits order as they do. Live particles
+            // never have a key of 0, so dead ones sort after all of them.
+            vec3 offset = p.position_age.xyz - global_ubo.view_position.xyz;
+            key.x = max(floatBitsToUint(dot(offset, offset)), 1u);
+        }
+        sort_keys[local_ubo.base_index + index] = key;
+    } else if (local_ubo.mode == MODE_SORT) {
+        // One step of a bitonic sort, ordering keys from farthest to nearest.
+        uint j = 1u << (local_ubo.sort_step & 0xFFu);
+        uint k = 1u << ((local_ubo.sort_step >> 8) & 0xFFu);
+        uint partner = index ^ j;
+        if (partner > index) {
+            uvec2 a = sort_keys[local_ubo.base_index + index];
+            uvec2 b = sort_keys[local_ubo.base_index + partner];
+            bool descending = (index & k) == 0;
+            if (descending ? a.x < b.x : a.x > b.x) {
+                sort_keys[local_ubo.base_index + index] = b;
+                sort_keys[local_ubo.base_index + partner] = a;
+            }
+        }
+    } else if (local_ubo.mode == MODE_GATHER) {
+        // Live particles make up the front of the sorted keys.
+        uvec2 key = sort_keys[local_ubo.base_index + index];
+        if (key.x != 0u) {
+            instances[local_ubo.instance_base + index] = particle_instance_make(particles[local_ubo.base_index + key.y]);
+        }
+    }
+}
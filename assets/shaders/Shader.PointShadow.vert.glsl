@@ -0,0 +1,31 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_texcoord;
+layout(location = 3) in vec4 in_colour;
+layout(location = 4) in vec4 in_tangent;
+
+// 6 faces for each of the most point lights casting shadows at once.
+#define MAX_POINT_SHADOW_FACES 48
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 view_projections[MAX_POINT_SHADOW_FACES];
+} global_ubo;
+
+layout(push_constant) uniform push_constants {
+	
+	// Only guaranteed a total of 128 bytes.
+	mat4 model; // 64 bytes
+    uint face_index;
+} local_ubo;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec2 tex_coord;
+} out_dto;
+
+void main() {
+    out_dto.tex_coord = in_texcoord;
+    gl_Position = global_ubo.view_projections[local_ubo.face_index] * local_ubo.model * vec4(in_position, 1.0);
+}
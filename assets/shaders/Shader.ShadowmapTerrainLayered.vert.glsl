@@ -0,0 +1,38 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_texcoord;
+layout(location = 3) in vec4 in_colour;
+layout(location = 4) in vec4 in_tangent; 
+layout(location = 5) in vec4 in_mat_weights; // Supports 4 materials.
+
+#define MAX_CASCADES 4
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projections[MAX_CASCADES];
+	mat4 views[MAX_CASCADES];
+} global_ubo;
+
+layout(push_constant) uniform push_constants {
+	// Only guaranteed a total of 128 bytes.
+	mat4 model; // 64 bytes
+    // Bit i is set if the geometry is to be drawn into cascade i.
+    uint cascade_mask;
+} local_ubo;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec2 tex_coord;
+} out_dto;
+
+void main() {
+    out_dto.tex_coord = in_texcoord;
+    // Each view renders one cascade. Geometry outside of it collapses to a point outside the clip volume, which draws nothing.
+    if ((local_ubo.cascade_mask & (1u << gl_ViewIndex)) == 0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+    gl_Position = global_ubo.projections[gl_ViewIndex] * global_ubo.views[gl_ViewIndex] * local_ubo.model * vec4(in_position, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 450
+
+layout(location = 0) out vec4 out_colour;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+	vec4 light_direction;
+	vec4 light_colour;
+} global_ubo;
+
+// Data Transfer Object
+layout(location = 1) in struct dto {
+	vec3 normal;
+	vec2 texcoord;
+} in_dto;
+
+const vec3 albedo = vec3(0.8);
+const float ambient = 0.15;
+
+void main() {
+	// Materials aren't applied yet, so every skinned mesh is lit as a plain diffuse surface.
+	float n_dot_l = max(dot(normalize(in_dto.normal), -normalize(global_ubo.light_direction.xyz)), 0.0);
+	vec3 colour = albedo * (ambient + global_ubo.light_colour.rgb * n_dot_l);
+	out_colour = vec4(colour, 1.0);
+}
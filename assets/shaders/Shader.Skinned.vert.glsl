@@ -0,0 +1,44 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_texcoord;
+// The joints each vertex is bound to, and their weights, which sum to 1.
+layout(location = 3) in uvec4 in_joints;
+layout(location = 4) in vec4 in_weights;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+	vec4 light_direction;
+	vec4 light_colour;
+} global_ubo;
+
+layout(std430, set = 0, binding = 1) readonly buffer joint_palette_buffer {
+    mat4 joints[];
+} joint_palette;
+
+layout(push_constant) uniform push_constants {
+	mat4 model;
+	// The index of the first skinning matrix of this mesh in the palette.
+	uint palette_offset;
+} u_push_constants;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec3 normal;
+	vec2 texcoord;
+} out_dto;
+
+void main() {
+	uint base = u_push_constants.palette_offset;
+	mat4 skin = joint_palette.joints[base + in_joints.x] * in_weights.x +
+	            joint_palette.joints[base + in_joints.y] * in_weights.y +
+	            joint_palette.joints[base + in_joints.z] * in_weights.z +
+	            joint_palette.joints[base + in_joints.w] * in_weights.w;
+	mat4 model = u_push_constants.model * skin;
+
+	out_dto.normal = normalize(mat3(model) * in_normal);
+	out_dto.texcoord = in_texcoord;
+	gl_Position = global_ubo.projection * global_ubo.view * model * vec4(in_position, 1.0);
+}
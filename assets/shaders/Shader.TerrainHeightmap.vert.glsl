@@ -0,0 +1,119 @@
+#version 450
+
+// Pulls the vertices of a terrain chunk from the heightmap of the terrain. Each instance is one chunk,
+// drawn from a patch of grid coordinates shared by all of them.
+// NOTE: The outputs must match Builtin.TerrainShader.vert.glsl, whose fragment shader is shared.
+
+layout(location = 0) in vec2 in_position;
+
+// Per-instance. Must match terrain_patch_instance.
+layout(location = 1) in vec4 in_origin; // xy: the first column and row of the chunk.
+layout(location = 2) in vec4 in_scale;  // xyz: the tile scale in x and z, and the height scale in y.
+
+const int MAX_SHADOW_CASCADES = 4;
+
+struct directional_light {
+    vec4 colour;
+    vec4 direction;
+};
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+	mat4 view;
+	mat4 light_space[MAX_SHADOW_CASCADES];
+	vec4 cascade_splits;
+	directional_light dir_light;
+	vec3 view_position;
+	int mode;
+    int use_pcf;
+    float bias;
+    vec2 padding;
+} global_ubo;
+
+// Each height is a 24-bit integer spread over rgb.
+layout(set = 1, binding = 4) uniform sampler2D heightmap;
+
+layout(push_constant) uniform push_constants {
+	
+	// Only guaranteed a total of 128 bytes.
+	mat4 model; // 64 bytes
+} u_push_constants;
+
+layout(location = 0) out int out_mode;
+layout(location = 1) out int use_pcf;
+
+// Data Transfer Object
+layout(location = 2) out struct dto {
+	vec4 light_space_frag_pos[MAX_SHADOW_CASCADES];
+	vec4 cascade_splits;
+	vec2 tex_coord;
+	vec3 normal;
+	vec3 view_position;
+	vec3 frag_position;
+	vec4 colour;
+	vec3 tangent;
+    vec4 mat_weights;
+    float bias;
+    vec3 padding;
+} out_dto;
+
+// Vulkan's Y axis is flipped and Z range is halved.
+const mat4 bias = mat4( 
+	0.5, 0.0, 0.0, 0.0,
+	0.0, 0.5, 0.0, 0.0,
+	0.0, 0.0, 1.0, 0.0,
+	0.5, 0.5, 0.0, 1.0 
+);
+
+// The normalized height at the given grid coordinates, clamped to the edges of the terrain.
+float height_at(ivec2 grid, ivec2 max_grid) {
+    vec3 texel = round(texelFetch(heightmap, clamp(grid, ivec2(0), max_grid), 0).rgb * 255.0);
+    return dot(texel, vec3(65536.0, 256.0, 1.0)) / 16777215.0;
+}
+
+// Same as kattenuation_min_max.
+float attenuation_min_max(float min_value, float max_value, float x) {
+    float half_range = abs(max_value - min_value) * 0.5;
+    float mid = min_value + half_range;
+    return clamp((half_range - abs(x - mid)) / half_range, 0.0, 1.0);
+}
+
+void main() {
+    // Chunks on the far edges overhang the terrain by a tile, so clamp them onto it.
+    ivec2 max_grid = textureSize(heightmap, 0) - 1;
+    ivec2 grid = min(ivec2(in_origin.xy + in_position), max_grid);
+    float height = height_at(grid, max_grid);
+    vec3 position = vec3(grid.x * in_scale.x, height * in_scale.y, grid.y * in_scale.z);
+
+    // Central differences of the neighbouring heights.
+    float dx = (height_at(grid + ivec2(1, 0), max_grid) - height_at(grid - ivec2(1, 0), max_grid)) * in_scale.y;
+    float dz = (height_at(grid + ivec2(0, 1), max_grid) - height_at(grid - ivec2(0, 1), max_grid)) * in_scale.y;
+    vec3 normal = normalize(vec3(-dx * in_scale.z, 2.0 * in_scale.x * in_scale.z, -dz * in_scale.x));
+    vec3 tangent = normalize(vec3(2.0 * in_scale.x, dx, 0.0));
+
+	out_dto.tex_coord = vec2(grid);
+	out_dto.colour = vec4(1.0);
+	// Fragment position in world space.
+	out_dto.frag_position = vec3(u_push_constants.model * vec4(position, 1.0));
+	mat3 m3_model = mat3(u_push_constants.model);
+	out_dto.normal = normalize(m3_model * normal);
+	out_dto.tangent = normalize(m3_model * tangent);
+	out_dto.cascade_splits = global_ubo.cascade_splits;
+	out_dto.view_position = global_ubo.view_position;
+    // Default weights based on height, the same as those of vertex-based terrains.
+    out_dto.mat_weights = vec4(
+        attenuation_min_max(-0.2, 0.2, height),
+        attenuation_min_max(0.0, 0.3, height),
+        attenuation_min_max(0.15, 0.9, height),
+        attenuation_min_max(0.5, 1.2, height));
+    gl_Position = global_ubo.projection * global_ubo.view * vec4(out_dto.frag_position, 1.0);
+
+	// Get a light-space-transformed fragment positions.
+    for(int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
+	    out_dto.light_space_frag_pos[i] = (bias * global_ubo.light_space[i]) * vec4(out_dto.frag_position, 1.0);
+    }
+
+	out_mode = global_ubo.mode;
+    use_pcf = global_ubo.use_pcf;
+    out_dto.bias = global_ubo.bias;
+}
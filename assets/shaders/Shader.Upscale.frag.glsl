@@ -0,0 +1,60 @@
+#version 450
+
+layout(location = 0) out vec4 out_colour;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+	vec4 source_rect;
+	vec4 source_texel;
+} global_ubo;
+
+layout(set = 1, binding = 0) uniform sampler2D source;
+
+// Data Transfer Object
+layout(location = 1) in struct dto {
+	vec2 texcoord;
+} in_dto;
+
+// Clamps a sample to the texels which were rendered, so nothing outside of the region bleeds in.
+vec2 clamp_to_region(vec2 uv) {
+	vec2 half_texel = global_ubo.source_texel.xy * 0.5;
+	vec2 region_min = global_ubo.source_rect.xy + half_texel;
+	vec2 region_max = global_ubo.source_rect.xy + global_ubo.source_rect.zw - half_texel;
+	return clamp(uv, region_min, region_max);
+}
+
+// A Catmull-Rom filter over the 4x4 texels around the sample, made of 5 bilinear taps: the inner
+// two texels on each axis are folded into one tap, and the four corners, which contribute the
+// least, are dropped.
+vec4 sample_catmull_rom(vec2 uv) {
+	vec2 texel_size = global_ubo.source_texel.xy;
+	vec2 sample_position = uv * global_ubo.source_texel.zw;
+	vec2 texel_position1 = floor(sample_position - 0.5) + 0.5;
+	vec2 f = sample_position - texel_position1;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	vec2 w12 = w1 + w2;
+	vec2 offset12 = w2 / w12;
+
+	vec2 position0 = clamp_to_region((texel_position1 - 1.0) * texel_size);
+	vec2 position3 = clamp_to_region((texel_position1 + 2.0) * texel_size);
+	vec2 position12 = clamp_to_region((texel_position1 + offset12) * texel_size);
+
+	vec4 result = vec4(0.0);
+	result += texture(source, vec2(position12.x, position0.y)) * w12.x * w0.y;
+	result += texture(source, vec2(position0.x, position12.y)) * w0.x * w12.y;
+	result += texture(source, vec2(position12.x, position12.y)) * w12.x * w12.y;
+	result += texture(source, vec2(position3.x, position12.y)) * w3.x * w12.y;
+	result += texture(source, vec2(position12.x, position3.y)) * w12.x * w3.y;
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+
+	// The negative lobes can overshoot around hard edges.
+	return max(result / weight, vec4(0.0));
+}
+
+void main() {
+	out_colour = vec4(sample_catmull_rom(in_dto.texcoord).rgb, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 450
+
+// A unit quad, from (0, 0) to (1, 1), stretched over the viewport.
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec2 in_texcoord;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+	vec4 source_rect;
+	vec4 source_texel;
+} global_ubo;
+
+// Data Transfer Object
+layout(location = 1) out struct dto {
+	vec2 texcoord;
+} out_dto;
+
+void main() {
+	// The viewport is flipped, so the top of the quad is the top of the image, where v is 0.
+	vec2 uv = vec2(in_position.x, 1.0 - in_position.y);
+	out_dto.texcoord = global_ubo.source_rect.xy + uv * global_ubo.source_rect.zw;
+	gl_Position = vec4(in_position * 2.0 - 1.0, 0.0, 1.0);
+}
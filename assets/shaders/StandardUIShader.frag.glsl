@@ -2,23 +2,29 @@
 
 layout(location = 0) out vec4 out_colour;
 
-struct ui_properties {
-    vec4 diffuse_colour;
-};
-
-layout(set = 1, binding = 0) uniform local_uniform_object {
-    ui_properties properties;
-} object_ubo;
-
 // Samplers
 const int SAMP_DIFFUSE = 0;
-layout(set = 1, binding = 1) uniform sampler2D samplers[1];
+layout(set = 1, binding = 0) uniform sampler2D samplers[1];
+
+layout(push_constant) uniform push_constants {
+	// Non-zero if the diffuse texture holds a signed distance field, as for SDF fonts.
+	uint distance_field;
+} local_ubo;
 
 // Data Transfer Object
 layout(location = 1) in struct dto {
 	vec2 tex_coord;
+	vec4 colour;
 } in_dto;
 
 void main() {
-    out_colour = object_ubo.properties.diffuse_colour * texture(samplers[SAMP_DIFFUSE], in_dto.tex_coord);
+    if (local_ubo.distance_field != 0) {
+        // The outline lies at 0.5. Smooth across the width of a pixel, however large the text is drawn.
+        float distance = texture(samplers[SAMP_DIFFUSE], in_dto.tex_coord).r;
+        float width = fwidth(distance);
+        float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+        out_colour = vec4(in_dto.colour.rgb, in_dto.colour.a * alpha);
+    } else {
+        out_colour = in_dto.colour * texture(samplers[SAMP_DIFFUSE], in_dto.tex_coord);
+    }
 }
@@ -0,0 +1,200 @@
+#include "bench_manager.h"
+
+#include <containers/darray.h>
+#include <core/kclock.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <platform/filesystem.h>
+
+// Samples discarded before measuring, to warm caches and branch predictors.
+#define BENCH_WARMUP_SAMPLES 3
+// Samples measured per benchmark.
+#define BENCH_SAMPLE_COUNT 21
+// The shortest a single sample may take, in seconds. Iterations are scaled up to reach it.
+#define BENCH_MIN_SAMPLE_SECONDS 0.01
+
+typedef struct bench_entry {
+    const char* name;
+    PFN_benchmark_setup setup;
+    PFN_benchmark_run run;
+    PFN_benchmark_teardown teardown;
+    u32 ops_per_iteration;
+} bench_entry;
+
+typedef struct bench_result {
+    const char* name;
+    u64 iterations;
+    u32 ops_per_iteration;
+    // Nanoseconds per operation.
+    f64 median_ns;
+    f64 mad_ns;
+    f64 min_ns;
+    f64 max_ns;
+} bench_result;
+
+static bench_entry* benchmarks;
+
+// Written to through a volatile pointer, which the compiler can't assume is never read.
+static const void* volatile do_not_optimize_sink;
+
+void bench_do_not_optimize(const void* value) {
+    do_not_optimize_sink = value;
+}
+
+u32 bench_random(u32* state) {
+    // xorshift32
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void bench_manager_init(void) {
+    benchmarks = darray_create(bench_entry);
+}
+
+void bench_manager_register(const char* name, PFN_benchmark_setup setup, PFN_benchmark_run run, PFN_benchmark_teardown teardown, u32 ops_per_iteration) {
+    bench_entry e;
+    e.name = name;
+    e.setup = setup;
+    e.run = run;
+    e.teardown = teardown;
+    e.ops_per_iteration = ops_per_iteration ? ops_per_iteration : 1;
+    darray_push(benchmarks, e);
+}
+
+static f64 sample_time(const bench_entry* bench, void* state, u64 iterations) {
+    kclock clock;
+    kclock_start(&clock);
+    bench->run(state, iterations);
+    kclock_update(&clock);
+    return clock.elapsed;
+}
+
+static void sort_f64(f64* values, u32 count) {
+    for (u32 i = 1; i < count; ++i) {
+        f64 value = values[i];
+        u32 j = i;
+        while (j > 0 && values[j - 1] > value) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+static void bench_execute(const bench_entry* bench, bench_result* out_result) {
+    void* state = bench->setup ? bench->setup() : 0;
+
+    // The first run is often slow (cold caches, threads waking), so isn't used to calibrate.
+    sample_time(bench, state, 1);
+
+    // Grow the iterations until a sample takes at least the minimum time.
+    u64 iterations = 1;
+    for (u32 attempt = 0; attempt < 32; ++attempt) {
+        // The fastest of a few, so that one interrupted sample doesn't end calibration early.
+        f64 elapsed = sample_time(bench, state, iterations);
+        for (u32 i = 0; i < 2; ++i) {
+            elapsed = KMIN(elapsed, sample_time(bench, state, iterations));
+        }
+        if (elapsed >= BENCH_MIN_SAMPLE_SECONDS) {
+            break;
+        }
+        if (elapsed < BENCH_MIN_SAMPLE_SECONDS / 10) {
+            iterations *= 10;
+        } else {
+            iterations = (u64)(iterations * (BENCH_MIN_SAMPLE_SECONDS / elapsed) * 1.1) + 1;
+        }
+    }
+
+    for (u32 i = 0; i < BENCH_WARMUP_SAMPLES; ++i) {
+        sample_time(bench, state, iterations);
+    }
+
+    f64 samples[BENCH_SAMPLE_COUNT];
+    f64 ops = (f64)iterations * bench->ops_per_iteration;
+    for (u32 i = 0; i < BENCH_SAMPLE_COUNT; ++i) {
+        samples[i] = sample_time(bench, state, iterations) * 1000000000.0 / ops;
+    }
+
+    if (bench->teardown) {
+        bench->teardown(state);
+    }
+
+    // The median and median absolute deviation, which unlike the mean and standard deviation
+    // aren't thrown off by the odd sample interrupted by the OS.
+    sort_f64(samples, BENCH_SAMPLE_COUNT);
+    f64 median = samples[BENCH_SAMPLE_COUNT / 2];
+    f64 deviations[BENCH_SAMPLE_COUNT];
+    for (u32 i = 0; i < BENCH_SAMPLE_COUNT; ++i) {
+        deviations[i] = samples[i] > median ? samples[i] - median : median - samples[i];
+    }
+    sort_f64(deviations, BENCH_SAMPLE_COUNT);
+
+    out_result->name = bench->name;
+    out_result->iterations = iterations;
+    out_result->ops_per_iteration = bench->ops_per_iteration;
+    out_result->median_ns = median;
+    out_result->mad_ns = deviations[BENCH_SAMPLE_COUNT / 2];
+    out_result->min_ns = samples[0];
+    out_result->max_ns = samples[BENCH_SAMPLE_COUNT - 1];
+}
+
+static b8 results_write_json(const char* path, const bench_result* results, u32 count) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to open '%s' to write benchmark results.", path);
+        return false;
+    }
+
+    char line[512];
+    b8 result = filesystem_write_line(&f, "{");
+    string_format(line, "  \"samples\": %u,", BENCH_SAMPLE_COUNT);
+    result = result && filesystem_write_line(&f, line);
+    result = result && filesystem_write_line(&f, "  \"benchmarks\": [");
+    for (u32 i = 0; i < count && result; ++i) {
+        const bench_result* r = &results[i];
+        string_format(line, "    {\"name\": \"%s\", \"iterations\": %llu, \"ops_per_iteration\": %u, \"median_ns\": %.3f, \"mad_ns\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f}%s",
+                      r->name, r->iterations, r->ops_per_iteration, r->median_ns, r->mad_ns, r->min_ns, r->max_ns, i + 1 < count ? "," : "");
+        result = filesystem_write_line(&f, line);
+    }
+    result = result && filesystem_write_line(&f, "  ]");
+    result = result && filesystem_write_line(&f, "}");
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("Failed to write benchmark results to '%s'.", path);
+    }
+    return result;
+}
+
+b8 bench_manager_run(const char* filter, const char* json_path) {
+    u32 count = darray_length(benchmarks);
+    bench_result* results = darray_reserve(bench_result, count);
+
+    kclock total_time;
+    kclock_start(&total_time);
+
+    for (u32 i = 0; i < count; ++i) {
+        if (filter && (string_length(filter) > string_length(benchmarks[i].name) || string_index_of_str(benchmarks[i].name, filter) < 0)) {
+            continue;
+        }
+        bench_result r;
+        bench_execute(&benchmarks[i], &r);
+        darray_push(results, r);
+        KINFO("%-48s %12.2f ns/op  +/- %8.2f  (min %.2f, %llu x %u ops)", r.name, r.median_ns, r.mad_ns, r.min_ns, r.iterations, r.ops_per_iteration);
+    }
+
+    kclock_update(&total_time);
+    u32 result_count = darray_length(results);
+    KINFO("Ran %u benchmarks in %.2f sec.", result_count, total_time.elapsed);
+
+    b8 result = true;
+    if (json_path) {
+        result = results_write_json(json_path, results, result_count);
+    }
+    darray_destroy(results);
+    return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <defines.h>
+
+/** @brief Creates the state a benchmark runs against. Optional. */
+typedef void* (*PFN_benchmark_setup)(void);
+
+/** @brief Runs the measured operation the given number of times. */
+typedef void (*PFN_benchmark_run)(void* state, u64 iterations);
+
+/** @brief Destroys the state created by the benchmark's setup. Optional. */
+typedef void (*PFN_benchmark_teardown)(void* state);
+
+void bench_manager_init(void);
+
+/**
+ * @brief Registers a benchmark.
+ *
+ * @param name The name of the benchmark. Must be a string literal.
+ * @param setup Creates the benchmark's state before it is run. May be 0.
+ * @param run Runs the benchmark's operation a given number of times.
+ * @param teardown Destroys the benchmark's state after it is run. May be 0.
+ * @param ops_per_iteration The number of operations in a single iteration, which times are reported per.
+ */
+void bench_manager_register(const char* name, PFN_benchmark_setup setup, PFN_benchmark_run run, PFN_benchmark_teardown teardown, u32 ops_per_iteration);
+
+/**
+ * @brief Runs the registered benchmarks, logging the results.
+ *
+ * @param filter Only benchmarks whose names contain this are run. 0 runs all of them.
+ * @param json_path The path of a JSON file to write the results to. May be 0.
+ * @return True on success; otherwise false.
+ */
+b8 bench_manager_run(const char* filter, const char* json_path);
+
+/** @brief Keeps the compiler from optimizing away a result which is otherwise unused. */
+void bench_do_not_optimize(const void* value);
+
+/** @brief A small, fast pseudo-random number generator, so that inputs are the same on every run. */
+u32 bench_random(u32* state);
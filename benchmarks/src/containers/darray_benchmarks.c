@@ -0,0 +1,35 @@
+#include "darray_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <containers/darray.h>
+#include <defines.h>
+
+#define PUSH_COUNT 4096
+
+static void darray_bench_push_growing(void* state, u64 iterations) {
+    for (u64 i = 0; i < iterations; ++i) {
+        u32* array = darray_create(u32);
+        for (u32 v = 0; v < PUSH_COUNT; ++v) {
+            darray_push(array, v);
+        }
+        bench_do_not_optimize(array);
+        darray_destroy(array);
+    }
+}
+
+static void darray_bench_push_reserved(void* state, u64 iterations) {
+    u32* array = darray_reserve(u32, PUSH_COUNT);
+    for (u64 i = 0; i < iterations; ++i) {
+        darray_clear(array);
+        for (u32 v = 0; v < PUSH_COUNT; ++v) {
+            darray_push(array, v);
+        }
+        bench_do_not_optimize(array);
+    }
+    darray_destroy(array);
+}
+
+void darray_register_benchmarks(void) {
+    bench_manager_register("darray_push (growing)", 0, darray_bench_push_growing, 0, PUSH_COUNT);
+    bench_manager_register("darray_push (reserved)", 0, darray_bench_push_reserved, 0, PUSH_COUNT);
+}
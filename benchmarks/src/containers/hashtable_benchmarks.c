@@ -0,0 +1,62 @@
+#include "hashtable_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <containers/hashtable.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <defines.h>
+
+#define KEY_COUNT 1024
+// Half full, as tables throughout the engine are sized with room to spare.
+#define TABLE_SIZE (KEY_COUNT * 2)
+
+typedef struct hashtable_bench_state {
+    hashtable table;
+    u64* memory;
+    char keys[KEY_COUNT][32];
+} hashtable_bench_state;
+
+static void* hashtable_bench_setup(void) {
+    hashtable_bench_state* state = kallocate(sizeof(hashtable_bench_state), MEMORY_TAG_ENGINE);
+    state->memory = kallocate(sizeof(u64) * TABLE_SIZE, MEMORY_TAG_ENGINE);
+    hashtable_create(sizeof(u64), TABLE_SIZE, state->memory, false, &state->table);
+    for (u64 i = 0; i < KEY_COUNT; ++i) {
+        string_format(state->keys[i], "resource_name_%llu", i);
+        hashtable_set(&state->table, state->keys[i], &i);
+    }
+    return state;
+}
+
+static void hashtable_bench_teardown(void* state) {
+    hashtable_bench_state* typed_state = state;
+    hashtable_destroy(&typed_state->table);
+    kfree(typed_state->memory, sizeof(u64) * TABLE_SIZE, MEMORY_TAG_ENGINE);
+    kfree(typed_state, sizeof(hashtable_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void hashtable_bench_set(void* state, u64 iterations) {
+    hashtable_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u64 k = 0; k < KEY_COUNT; ++k) {
+            hashtable_set(&typed_state->table, typed_state->keys[k], &k);
+        }
+    }
+}
+
+static void hashtable_bench_get(void* state, u64 iterations) {
+    hashtable_bench_state* typed_state = state;
+    u64 total = 0;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 k = 0; k < KEY_COUNT; ++k) {
+            u64 value;
+            hashtable_get(&typed_state->table, typed_state->keys[k], &value);
+            total += value;
+        }
+    }
+    bench_do_not_optimize(&total);
+}
+
+void hashtable_register_benchmarks(void) {
+    bench_manager_register("hashtable set", hashtable_bench_setup, hashtable_bench_set, hashtable_bench_teardown, KEY_COUNT);
+    bench_manager_register("hashtable get", hashtable_bench_setup, hashtable_bench_get, hashtable_bench_teardown, KEY_COUNT);
+}
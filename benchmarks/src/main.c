@@ -0,0 +1,56 @@
+#include "bench_manager.h"
+
+#include "containers/darray_benchmarks.h"
+#include "containers/hashtable_benchmarks.h"
+#include "math/kmath_benchmarks.h"
+#include "memory/dynamic_allocator_benchmarks.h"
+#include "systems/job_system_benchmarks.h"
+#include "utils/sort_benchmarks.h"
+
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+
+static void print_help(void) {
+    KINFO("Usage: benchmarks [filter=<name substring>] [json=<output path>]");
+}
+
+int main(int argc, char** argv) {
+    const char* filter = 0;
+    const char* json_path = 0;
+    for (i32 i = 1; i < argc; ++i) {
+        if (strings_nequali(argv[i], "filter=", 7)) {
+            filter = argv[i] + 7;
+        } else if (strings_nequali(argv[i], "json=", 5)) {
+            json_path = argv[i] + 5;
+        } else {
+            print_help();
+            return -1;
+        }
+    }
+
+    // Allocations go through the memory system, as they do in the engine.
+    memory_system_configuration memory_config = {0};
+    memory_config.total_alloc_size = MEBIBYTES(512);
+    if (!memory_system_initialize(memory_config)) {
+        KERROR("Failed to initialize the memory system.");
+        return -2;
+    }
+
+    // Always initalize the bench manager first.
+    bench_manager_init();
+
+    dynamic_allocator_register_benchmarks();
+    hashtable_register_benchmarks();
+    darray_register_benchmarks();
+    sort_register_benchmarks();
+    kmath_register_benchmarks();
+    job_system_register_benchmarks();
+
+    KDEBUG("Starting benchmarks...");
+
+    b8 result = bench_manager_run(filter, json_path);
+
+    memory_system_shutdown(0);
+    return result ? 0 : -3;
+}
@@ -0,0 +1,160 @@
+#include "kmath_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <core/kmemory.h>
+#include <defines.h>
+#include <math/kmath.h>
+
+#define MATRIX_COUNT 256
+#define BOX_COUNT 4096
+#define ANGLE_COUNT 4096
+
+typedef struct matrix_bench_state {
+    mat4 matrices[MATRIX_COUNT];
+    mat4 results[MATRIX_COUNT];
+} matrix_bench_state;
+
+typedef struct frustum_bench_state {
+    frustum f;
+    vec3 centers[BOX_COUNT];
+    vec3 extents[BOX_COUNT];
+    f32 soa_data[6][BOX_COUNT];
+    aabb_soa bounds;
+    b8 results[BOX_COUNT];
+} frustum_bench_state;
+
+typedef struct angle_bench_state {
+    f32 angles[ANGLE_COUNT];
+    f32 results[ANGLE_COUNT];
+} angle_bench_state;
+
+static f32 random_range(u32* rng, f32 min, f32 max) {
+    return min + (max - min) * ((bench_random(rng) & 0xFFFFFF) / (f32)0xFFFFFF);
+}
+
+static void* matrix_setup(void) {
+    matrix_bench_state* state = kallocate(sizeof(matrix_bench_state), MEMORY_TAG_ENGINE);
+    u32 rng = 0xBEEF;
+    for (u32 i = 0; i < MATRIX_COUNT; ++i) {
+        vec3 position = vec3_create(random_range(&rng, -100, 100), random_range(&rng, -100, 100), random_range(&rng, -100, 100));
+        mat4 rotation = mat4_euler_xyz(random_range(&rng, -K_PI, K_PI), random_range(&rng, -K_PI, K_PI), random_range(&rng, -K_PI, K_PI));
+        state->matrices[i] = mat4_mul(rotation, mat4_translation(position));
+    }
+    return state;
+}
+
+static void matrix_teardown(void* state) {
+    kfree(state, sizeof(matrix_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void mat4_mul_run(void* state, u64 iterations) {
+    matrix_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 m = 0; m < MATRIX_COUNT; ++m) {
+            typed_state->results[m] = mat4_mul(typed_state->matrices[m], typed_state->matrices[(m + 1) % MATRIX_COUNT]);
+        }
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+static void mat4_inverse_run(void* state, u64 iterations) {
+    matrix_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 m = 0; m < MATRIX_COUNT; ++m) {
+            typed_state->results[m] = mat4_inverse(typed_state->matrices[m]);
+        }
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+static void* frustum_setup(void) {
+    frustum_bench_state* state = kallocate(sizeof(frustum_bench_state), MEMORY_TAG_ENGINE);
+    vec3 position = vec3_zero();
+    vec3 forward = vec3_forward();
+    vec3 right = vec3_right();
+    vec3 up = vec3_up();
+    state->f = frustum_create(&position, &forward, &right, &up, 16.0f / 9.0f, deg_to_rad(60.0f), 0.1f, 500.0f);
+
+    // Scattered all around the camera, so roughly a sixth of them are visible.
+    u32 rng = 0xF00D;
+    state->bounds.center.x = state->soa_data[0];
+    state->bounds.center.y = state->soa_data[1];
+    state->bounds.center.z = state->soa_data[2];
+    state->bounds.extents.x = state->soa_data[3];
+    state->bounds.extents.y = state->soa_data[4];
+    state->bounds.extents.z = state->soa_data[5];
+    for (u32 i = 0; i < BOX_COUNT; ++i) {
+        state->centers[i] = vec3_create(random_range(&rng, -400, 400), random_range(&rng, -400, 400), random_range(&rng, -400, 400));
+        f32 size = random_range(&rng, 0.5f, 10.0f);
+        state->extents[i] = vec3_create(size, size, size);
+        state->bounds.center.x[i] = state->centers[i].x;
+        state->bounds.center.y[i] = state->centers[i].y;
+        state->bounds.center.z[i] = state->centers[i].z;
+        state->bounds.extents.x[i] = size;
+        state->bounds.extents.y[i] = size;
+        state->bounds.extents.z[i] = size;
+    }
+    return state;
+}
+
+static void frustum_teardown(void* state) {
+    kfree(state, sizeof(frustum_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void frustum_intersects_aabb_run(void* state, u64 iterations) {
+    frustum_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 b = 0; b < BOX_COUNT; ++b) {
+            typed_state->results[b] = frustum_intersects_aabb(&typed_state->f, &typed_state->centers[b], &typed_state->extents[b]);
+        }
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+static void frustum_intersects_aabb_batch_run(void* state, u64 iterations) {
+    frustum_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        frustum_intersects_aabb_batch(&typed_state->f, BOX_COUNT, &typed_state->bounds, typed_state->results);
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+static void* angle_setup(void) {
+    angle_bench_state* state = kallocate(sizeof(angle_bench_state), MEMORY_TAG_ENGINE);
+    u32 rng = 0xCAFE;
+    for (u32 i = 0; i < ANGLE_COUNT; ++i) {
+        state->angles[i] = random_range(&rng, -4.0f * K_PI, 4.0f * K_PI);
+    }
+    return state;
+}
+
+static void angle_teardown(void* state) {
+    kfree(state, sizeof(angle_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void ksin_run(void* state, u64 iterations) {
+    angle_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 a = 0; a < ANGLE_COUNT; ++a) {
+            typed_state->results[a] = ksin(typed_state->angles[a]);
+        }
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+static void ksin_batch_run(void* state, u64 iterations) {
+    angle_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        ksin_batch(ANGLE_COUNT, typed_state->angles, typed_state->results);
+        bench_do_not_optimize(typed_state->results);
+    }
+}
+
+void kmath_register_benchmarks(void) {
+    bench_manager_register("mat4_mul", matrix_setup, mat4_mul_run, matrix_teardown, MATRIX_COUNT);
+    bench_manager_register("mat4_inverse", matrix_setup, mat4_inverse_run, matrix_teardown, MATRIX_COUNT);
+    bench_manager_register("frustum_intersects_aabb", frustum_setup, frustum_intersects_aabb_run, frustum_teardown, BOX_COUNT);
+    bench_manager_register("frustum_intersects_aabb_batch", frustum_setup, frustum_intersects_aabb_batch_run, frustum_teardown, BOX_COUNT);
+    bench_manager_register("ksin", angle_setup, ksin_run, angle_teardown, ANGLE_COUNT);
+    bench_manager_register("ksin_batch", angle_setup, ksin_batch_run, angle_teardown, ANGLE_COUNT);
+}
@@ -0,0 +1,95 @@
+#include "dynamic_allocator_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <core/kmemory.h>
+#include <defines.h>
+#include <memory/dynamic_allocator.h>
+
+#define MIXED_BLOCK_COUNT 256
+
+typedef struct allocator_bench_state {
+    dynamic_allocator allocator;
+    void* memory;
+    u64 memory_requirement;
+    void* blocks[MIXED_BLOCK_COUNT];
+    u64 sizes[MIXED_BLOCK_COUNT];
+    u32 free_order[MIXED_BLOCK_COUNT];
+} allocator_bench_state;
+
+static void* allocator_setup(void) {
+    allocator_bench_state* state = kallocate(sizeof(allocator_bench_state), MEMORY_TAG_ENGINE);
+    u64 total_size = MEBIBYTES(16);
+    dynamic_allocator_create(total_size, &state->memory_requirement, 0, 0);
+    state->memory = kallocate(state->memory_requirement, MEMORY_TAG_ENGINE);
+    dynamic_allocator_create(total_size, &state->memory_requirement, state->memory, &state->allocator);
+
+    // The same sizes and free order every run.
+    u32 rng = 0x12345678;
+    for (u32 i = 0; i < MIXED_BLOCK_COUNT; ++i) {
+        state->sizes[i] = 16 + bench_random(&rng) % 4096;
+        state->free_order[i] = i;
+    }
+    for (u32 i = MIXED_BLOCK_COUNT - 1; i > 0; --i) {
+        u32 j = bench_random(&rng) % (i + 1);
+        u32 temp = state->free_order[i];
+        state->free_order[i] = state->free_order[j];
+        state->free_order[j] = temp;
+    }
+    return state;
+}
+
+static void allocator_teardown(void* state) {
+    allocator_bench_state* typed_state = state;
+    dynamic_allocator_destroy(&typed_state->allocator);
+    kfree(typed_state->memory, typed_state->memory_requirement, MEMORY_TAG_ENGINE);
+    kfree(typed_state, sizeof(allocator_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void allocate_free_same_size(void* state, u64 iterations) {
+    allocator_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        void* block = dynamic_allocator_allocate(&typed_state->allocator, 64);
+        bench_do_not_optimize(block);
+        dynamic_allocator_free(&typed_state->allocator, block, 64);
+    }
+}
+
+static void allocate_mixed_free_shuffled(void* state, u64 iterations) {
+    allocator_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 b = 0; b < MIXED_BLOCK_COUNT; ++b) {
+            typed_state->blocks[b] = dynamic_allocator_allocate(&typed_state->allocator, typed_state->sizes[b]);
+        }
+        for (u32 b = 0; b < MIXED_BLOCK_COUNT; ++b) {
+            u32 index = typed_state->free_order[b];
+            dynamic_allocator_free(&typed_state->allocator, typed_state->blocks[index], typed_state->sizes[index]);
+        }
+    }
+}
+
+static void allocate_aligned_free_reverse(void* state, u64 iterations) {
+    allocator_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 b = 0; b < MIXED_BLOCK_COUNT; ++b) {
+            typed_state->blocks[b] = dynamic_allocator_allocate_aligned(&typed_state->allocator, typed_state->sizes[b], 16);
+        }
+        for (u32 b = MIXED_BLOCK_COUNT; b > 0; --b) {
+            dynamic_allocator_free_aligned(&typed_state->allocator, typed_state->blocks[b - 1]);
+        }
+    }
+}
+
+static void kallocate_free_small(void* state, u64 iterations) {
+    for (u64 i = 0; i < iterations; ++i) {
+        void* block = kallocate(48, MEMORY_TAG_ENGINE);
+        bench_do_not_optimize(block);
+        kfree(block, 48, MEMORY_TAG_ENGINE);
+    }
+}
+
+void dynamic_allocator_register_benchmarks(void) {
+    bench_manager_register("dynamic_allocator allocate/free 64B", allocator_setup, allocate_free_same_size, allocator_teardown, 1);
+    bench_manager_register("dynamic_allocator mixed sizes, shuffled frees", allocator_setup, allocate_mixed_free_shuffled, allocator_teardown, MIXED_BLOCK_COUNT);
+    bench_manager_register("dynamic_allocator aligned, reverse frees", allocator_setup, allocate_aligned_free_reverse, allocator_teardown, MIXED_BLOCK_COUNT);
+    bench_manager_register("kallocate/kfree 48B (thread cache)", 0, kallocate_free_small, 0, 1);
+}
@@ -0,0 +1,83 @@
+#include "job_system_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <core/kmemory.h>
+#include <defines.h>
+#include <systems/job_system.h>
+
+// A fixed count so results are comparable between machines with at least this many cores.
+#define JOB_THREAD_COUNT 4
+#define BATCH_JOB_COUNT 256
+
+typedef struct job_bench_state {
+    void* memory;
+    u64 memory_requirement;
+} job_bench_state;
+
+static b8 empty_job(void* param_data, void* result_data) {
+    return true;
+}
+
+static void empty_range(u32 start, u32 end, void* user_data) {
+    bench_do_not_optimize(user_data);
+}
+
+static void* job_bench_setup(void) {
+    job_bench_state* state = kallocate(sizeof(job_bench_state), MEMORY_TAG_ENGINE);
+    u32 type_masks[JOB_THREAD_COUNT];
+    for (u32 i = 0; i < JOB_THREAD_COUNT; ++i) {
+        type_masks[i] = JOB_TYPE_GENERAL | JOB_TYPE_RESOURCE_LOAD | JOB_TYPE_GPU_RESOURCE;
+    }
+    job_system_config config = {0};
+    config.max_job_thread_count = JOB_THREAD_COUNT;
+    config.type_masks = type_masks;
+    job_system_initialize(&state->memory_requirement, 0, &config);
+    state->memory = kallocate(state->memory_requirement, MEMORY_TAG_ENGINE);
+    job_system_initialize(&state->memory_requirement, state->memory, &config);
+    return state;
+}
+
+static void job_bench_teardown(void* state) {
+    job_bench_state* typed_state = state;
+    job_system_shutdown(typed_state->memory);
+    kfree(typed_state->memory, typed_state->memory_requirement, MEMORY_TAG_ENGINE);
+    kfree(typed_state, sizeof(job_bench_state), MEMORY_TAG_ENGINE);
+}
+
+// The round trip of a single job: submission, pickup by a job thread, and the wait seeing it complete.
+static void job_submit_wait_run(void* state, u64 iterations) {
+    job_counter counter = job_counter_create();
+    for (u64 i = 0; i < iterations; ++i) {
+        job_info info = job_create(empty_job, 0, 0, 0, 0, 0);
+        job_set_counters(&info, counter, (job_counter){0});
+        job_system_submit(info);
+        job_counter_wait(counter);
+    }
+    job_counter_destroy(counter);
+}
+
+// Many jobs in flight at once, so measuring throughput rather than latency.
+static void job_submit_batch_run(void* state, u64 iterations) {
+    job_counter counter = job_counter_create();
+    for (u64 i = 0; i < iterations; ++i) {
+        for (u32 j = 0; j < BATCH_JOB_COUNT; ++j) {
+            job_info info = job_create(empty_job, 0, 0, 0, 0, 0);
+            job_set_counters(&info, counter, (job_counter){0});
+            job_system_submit(info);
+        }
+        job_counter_wait(counter);
+    }
+    job_counter_destroy(counter);
+}
+
+static void job_parallel_for_run(void* state, u64 iterations) {
+    for (u64 i = 0; i < iterations; ++i) {
+        job_parallel_for(BATCH_JOB_COUNT, 1, empty_range, state);
+    }
+}
+
+void job_system_register_benchmarks(void) {
+    bench_manager_register("job submit/complete latency", job_bench_setup, job_submit_wait_run, job_bench_teardown, 1);
+    bench_manager_register("job submit/complete batch of 256", job_bench_setup, job_submit_batch_run, job_bench_teardown, BATCH_JOB_COUNT);
+    bench_manager_register("job_parallel_for 256 ranges", job_bench_setup, job_parallel_for_run, job_bench_teardown, BATCH_JOB_COUNT);
+}
@@ -0,0 +1,59 @@
+#include "sort_benchmarks.h"
+#include "../bench_manager.h"
+
+#include <core/kmemory.h>
+#include <defines.h>
+#include <utils/ksort.h>
+
+#define ELEMENT_COUNT 4096
+
+typedef struct sort_bench_state {
+    i32 source[ELEMENT_COUNT];
+    i32 data[ELEMENT_COUNT];
+} sort_bench_state;
+
+static i32 compare_i32(void* a, void* b) {
+    i32 a_value = *(i32*)a;
+    i32 b_value = *(i32*)b;
+    return (a_value > b_value) - (a_value < b_value);
+}
+
+static sort_bench_state* sort_state_create(void) {
+    return kallocate(sizeof(sort_bench_state), MEMORY_TAG_ENGINE);
+}
+
+static void* sort_setup_random(void) {
+    sort_bench_state* state = sort_state_create();
+    u32 rng = 0xC0FFEE;
+    for (u32 i = 0; i < ELEMENT_COUNT; ++i) {
+        state->source[i] = (i32)bench_random(&rng);
+    }
+    return state;
+}
+
+static void* sort_setup_sorted(void) {
+    sort_bench_state* state = sort_state_create();
+    for (u32 i = 0; i < ELEMENT_COUNT; ++i) {
+        state->source[i] = (i32)i;
+    }
+    return state;
+}
+
+static void sort_teardown(void* state) {
+    kfree(state, sizeof(sort_bench_state), MEMORY_TAG_ENGINE);
+}
+
+// NOTE: Includes restoring the unsorted input, which is a small part of the total.
+static void sort_run(void* state, u64 iterations) {
+    sort_bench_state* typed_state = state;
+    for (u64 i = 0; i < iterations; ++i) {
+        kcopy_memory(typed_state->data, typed_state->source, sizeof(typed_state->data));
+        kquick_sort(sizeof(i32), typed_state->data, 0, ELEMENT_COUNT - 1, compare_i32);
+    }
+    bench_do_not_optimize(typed_state->data);
+}
+
+void sort_register_benchmarks(void) {
+    bench_manager_register("kquick_sort 4096 random i32", sort_setup_random, sort_run, sort_teardown, ELEMENT_COUNT);
+    bench_manager_register("kquick_sort 4096 sorted i32", sort_setup_sorted, sort_run, sort_teardown, ELEMENT_COUNT);
+}
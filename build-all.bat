@@ -24,7 +24,7 @@ if "%ACTION%" == "build" (
 
 
 if "%PLATFORM%" == "windows" (
-    SET ENGINE_LINK=-luser32
+    SET ENGINE_LINK=-luser32 -lwinmm -lws2_32
 ) else (
     if "%PLATFORM%" == "linux" (
         SET ENGINE_LINK=
@@ -54,6 +54,10 @@ REM Vulkan Renderer lib
 make -f "Makefile.library.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=vulkan_renderer VER_MAJOR=0 VER_MINOR=1 DO_VERSION=no ADDL_INC_FLAGS="-Iengine\src -I%VULKAN_SDK%\include" ADDL_LINK_FLAGS="-lengine -lvulkan-1 -lshaderc_shared -L%VULKAN_SDK%\Lib"
 IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
 
+REM Null Renderer lib
+make -f "Makefile.library.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=null_renderer VER_MAJOR=0 VER_MINOR=1 DO_VERSION=no ADDL_INC_FLAGS="-Iengine\src" ADDL_LINK_FLAGS="-lengine"
+IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
+
 REM OpenAL plugin lib
 make -f "Makefile.library.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=plugin_audio_openal VER_MAJOR=0 VER_MINOR=1 DO_VERSION=no ADDL_INC_FLAGS="-Iengine\src -I'%programfiles(x86)%\OpenAL 1.1 SDK\include'" ADDL_LINK_FLAGS="-lengine -lopenal32 -L'%programfiles(x86)%\OpenAL 1.1 SDK\libs\win64'"
 IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
@@ -74,6 +78,10 @@ IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
 @REM make -f "Makefile.executable.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=tests ADDL_INC_FLAGS=-Iengine\src ADDL_LINK_FLAGS=-lengine
 @REM IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
 
+REM Benchmarks
+make -f "Makefile.executable.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=benchmarks ADDL_INC_FLAGS=-Iengine\src ADDL_LINK_FLAGS=-lengine
+IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
+
 REM Tools
 make -f "Makefile.executable.mak" %ACTION% TARGET=%TARGET% ASSEMBLY=tools ADDL_INC_FLAGS=-Iengine\src ADDL_LINK_FLAGS=-lengine
 IF %ERRORLEVEL% NEQ 0 (echo Error:%ERRORLEVEL% && exit)
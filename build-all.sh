@@ -56,6 +56,14 @@ then
 echo "error:"$errorlevel | sed -e "s/error/${txtred}error${txtrst}/g" && exit
 fi
 
+# Null Renderer Lib
+make -f Makefile.library.mak $ACTION TARGET=$TARGET ASSEMBLY=null_renderer VER_MAJOR=0 VER_MINOR=1 DO_VERSION=no ADDL_INC_FLAGS="-I./engine/src" ADDL_LINK_FLAGS="-lengine"
+ERRORLEVEL=$?
+if [ $ERRORLEVEL -ne 0 ]
+then
+echo "error:"$errorlevel | sed -e "s/error/${txtred}error${txtrst}/g" && exit
+fi
+
 # Standard UI Lib
 make -f Makefile.library.mak $ACTION TARGET=$TARGET ASSEMBLY=standard_ui VER_MAJOR=0 VER_MINOR=1 DO_VERSION=no ADDL_INC_FLAGS="-I./engine/src" ADDL_LINK_FLAGS="-lengine"
 ERRORLEVEL=$?
@@ -101,6 +109,14 @@ fi
 # echo "Error:"$ERRORLEVEL | sed -e "s/Error/${txtred}Error${txtrst}/g" && exit
 # fi
 
+# Benchmarks
+make -f Makefile.executable.mak $ACTION TARGET=$TARGET ASSEMBLY=benchmarks ADDL_INC_FLAGS="-I./engine/src" ADDL_LINK_FLAGS="-lengine"
+ERRORLEVEL=$?
+if [ $ERRORLEVEL -ne 0 ]
+then
+echo "Error:"$ERRORLEVEL | sed -e "s/Error/${txtred}Error${txtrst}/g" && exit
+fi
+
 # Tools
 make -f Makefile.executable.mak $ACTION TARGET=$TARGET ASSEMBLY=tools ADDL_INC_FLAGS="-I./engine/src" ADDL_LINK_FLAGS="-lengine"
 ERRORLEVEL=$?
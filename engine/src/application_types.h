@@ -103,6 +103,12 @@ typedef struct application {
     /** @brief The application stage of execution. */
     application_stage stage;
 
+    /** @brief The number of command-line arguments, including the executable. */
+    i32 argc;
+
+    /** @brief The command-line arguments the application was started with. */
+    char** argv;
+
     /** @brief application-specific state. Created and managed by the application. */
     void* state;
 
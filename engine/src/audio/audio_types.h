@@ -29,15 +29,30 @@ typedef struct audio_file {
     u32 sample_rate;
     // Used to track samples in streaming type files.
     u32 total_samples_left;
+    // The length of the file in samples, including all channels.
+    u64 total_samples;
     struct audio_file_internal* internal_data;
     struct audio_file_plugin_data* plugin_data;
 
     u64 (*load_samples)(struct audio_file* audio, u32 chunk_size, i32 count);
     void* (*stream_buffer_data)(struct audio_file* audio);
     void (*rewind)(struct audio_file* audio);
+    // Moves a stream to the given sample, counted per channel. Only used for streaming type files.
+    b8 (*seek)(struct audio_file* audio, u64 sample);
 
 } audio_file;
 
+/**
+ * @brief Invoked on the main thread once a sound effect loaded asynchronously is ready.
+ * @param name The name the file was loaded with.
+ * @param file A pointer to the loaded file, or 0 if loading failed.
+ * @param listener The listener passed when the load was requested.
+ */
+typedef void (*PFN_audio_chunk_loaded)(const char* name, struct audio_file* file, void* listener);
+
+/** @brief The distance beyond which an emitter is inaudible, when it does not give its own. */
+#define AUDIO_EMITTER_DEFAULT_MAX_DISTANCE 50.0f
+
 typedef struct audio_emitter {
     vec3 position;
     f32 volume;
@@ -45,6 +60,12 @@ typedef struct audio_emitter {
     b8 looping;
     struct audio_file* file;
     u32 source_id;
+    /** @brief The distance beyond which the emitter is inaudible. 0 uses AUDIO_EMITTER_DEFAULT_MAX_DISTANCE. */
+    f32 max_distance;
+    /** @brief Emitters with a higher priority are given real voices first, regardless of how loud they are. */
+    u8 priority;
+    /** @brief The audio system's identifier for an emitter being played, or INVALID_ID. Set by audio_system_emitter_play. */
+    u32 instance_id;
 } audio_emitter;
 
 typedef struct audio_plugin_config {
@@ -64,6 +85,9 @@ typedef struct audio_plugin_config {
      * The size to chunk streamed audio data in.
      */
     u32 chunk_size;
+
+    /** @brief Indicates if sound effects should be kept compressed in memory, if the plugin supports it. */
+    b8 compress_chunks;
 } audio_plugin_config;
 
 typedef struct audio_plugin {
@@ -111,11 +135,29 @@ typedef struct audio_plugin {
     b8 (*source_looping_set)(struct audio_plugin* plugin, u32 source_id, b8 looping);
 
     struct audio_file* (*chunk_load)(struct audio_plugin* plugin, const char* name);
+    /**
+     * @brief Loads a sound effect in the background, decoding it on a job thread.
+     * @param plugin A pointer to the plugin.
+     * @param name The name of the file to be loaded.
+     * @param callback Invoked on the main thread once the file is ready, or loading failed.
+     * @param listener Passed along to the callback.
+     * @returns True if loading was started; otherwise false, and the callback is not made.
+     */
+    b8 (*chunk_load_async)(struct audio_plugin* plugin, const char* name, PFN_audio_chunk_loaded callback, void* listener);
     struct audio_file* (*stream_load)(struct audio_plugin* plugin, const char* name);
     void (*audio_unload)(struct audio_plugin* plugin, struct audio_file* file);
 
     b8 (*source_play)(struct audio_plugin* plugin, i8 source_index);
     b8 (*play_on_source)(struct audio_plugin* plugin, struct audio_file* file, i8 source_index);
+    /**
+     * @brief Plays the file on the given source, starting part of the way through it.
+     * @param plugin A pointer to the plugin.
+     * @param file A pointer to the file to be played.
+     * @param source_index The index of the source to play on.
+     * @param offset_seconds The position to start playing from, in seconds.
+     * @returns True on success; otherwise false.
+     */
+    b8 (*play_on_source_at)(struct audio_plugin* plugin, struct audio_file* file, i8 source_index, f32 offset_seconds);
 
     b8 (*source_stop)(struct audio_plugin* plugin, i8 source_index);
     b8 (*source_pause)(struct audio_plugin* plugin, i8 source_index);
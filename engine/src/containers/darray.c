@@ -4,13 +4,32 @@
 #include "core/kmemory.h"
 #include "core/logger.h"
 
+// Set when the array lives in a buffer supplied by the caller, which is never freed by the array.
+#define DARRAY_FLAG_EXTERNAL_BUFFER 0x1
+
 typedef struct darray_header {
     u64 capacity;
     u64 length;
     u64 stride;
     frame_allocator_int* allocator;
+    // The factor the capacity is multiplied by when the array grows.
+    f32 growth_factor;
+    u32 flags;
+    // Keeps the header, and so the elements, 16-byte aligned.
+    u64 padding;
 } darray_header;
 
+STATIC_ASSERT(sizeof(darray_header) == DARRAY_HEADER_SIZE, "DARRAY_HEADER_SIZE must match the size of the darray header.");
+
+static void darray_header_init(darray_header* header, u64 capacity, u64 stride, frame_allocator_int* allocator, u32 flags) {
+    header->capacity = capacity;
+    header->length = 0;
+    header->stride = stride;
+    header->allocator = allocator;
+    header->growth_factor = DARRAY_RESIZE_FACTOR;
+    header->flags = flags;
+}
+
 void* _darray_create(u64 length, u64 stride, frame_allocator_int* allocator) {
     u64 header_size = sizeof(darray_header);
     u64 array_size = length * stride;
@@ -24,19 +43,31 @@ void* _darray_create(u64 length, u64 stride, frame_allocator_int* allocator) {
     if (length == 0) {
         KFATAL("_darray_create called with length of 0");
     }
-    darray_header* header = new_array;
-    header->capacity = length;
-    header->length = 0;
-    header->stride = stride;
-    header->allocator = allocator;
+    darray_header_init(new_array, length, stride, allocator, 0);
 
     return (void*)((u8*)new_array + header_size);
 }
 
+void* _darray_create_in_buffer(u64 buffer_size, u64 stride, void* buffer, frame_allocator_int* allocator) {
+    u64 header_size = sizeof(darray_header);
+    if (!buffer || buffer_size < header_size + stride) {
+        KERROR("_darray_create_in_buffer requires a buffer large enough for at least one element. Allocating instead.");
+        return _darray_create(DARRAY_DEFAULT_CAPACITY, stride, allocator);
+    }
+    kset_memory(buffer, 0, buffer_size);
+    darray_header_init(buffer, (buffer_size - header_size) / stride, stride, allocator, DARRAY_FLAG_EXTERNAL_BUFFER);
+
+    return (void*)((u8*)buffer + header_size);
+}
+
 void darray_destroy(void* array) {
     if (array) {
         u64 header_size = sizeof(darray_header);
         darray_header* header = (darray_header*)((u8*)array - header_size);
+        if (header->flags & DARRAY_FLAG_EXTERNAL_BUFFER) {
+            // The buffer belongs to the caller.
+            return;
+        }
         u64 total_size = header_size + header->capacity * header->stride;
         if (header->allocator) {
             header->allocator->free(header, total_size);
@@ -46,6 +77,41 @@ void darray_destroy(void* array) {
     }
 }
 
+// Changes the capacity of the array to exactly the given amount, which must be larger than the current.
+static void* darray_capacity_set(void* array, u64 capacity) {
+    u64 header_size = sizeof(darray_header);
+    darray_header* header = (darray_header*)((u8*)array - header_size);
+    u64 old_size = header_size + header->capacity * header->stride;
+    u64 new_size = header_size + capacity * header->stride;
+
+    // Arrays from an arena can often grow in place, leaving nothing behind.
+    if (!(header->flags & DARRAY_FLAG_EXTERNAL_BUFFER) && header->allocator && header->allocator->grow &&
+        header->allocator->grow(header, old_size, new_size)) {
+        kset_memory((u8*)header + old_size, 0, new_size - old_size);
+        header->capacity = capacity;
+        return array;
+    }
+
+    // Arrays on the heap can be reallocated, which also grows them in place where it can.
+    if (!(header->flags & DARRAY_FLAG_EXTERNAL_BUFFER) && !header->allocator) {
+        darray_header* new_header = kreallocate(header, old_size, new_size, MEMORY_TAG_DARRAY);
+        if (!new_header) {
+            return array;
+        }
+        new_header->capacity = capacity;
+        return (u8*)new_header + header_size;
+    }
+
+    void* temp = _darray_create(capacity, header->stride, header->allocator);
+    kcopy_memory(temp, array, header->length * header->stride);
+
+    darray_header* new_header = (darray_header*)((u8*)temp - header_size);
+    new_header->length = header->length;
+    new_header->growth_factor = header->growth_factor;
+    darray_destroy(array);
+    return temp;
+}
+
 void* _darray_resize(void* array) {
     u64 header_size = sizeof(darray_header);
     darray_header* header = (darray_header*)((u8*)array - header_size);
@@ -53,14 +119,26 @@ void* _darray_resize(void* array) {
         KFATAL("_darray_resize called on an array with 0 capacity. This should not be possible.");
         return 0;
     }
-    void* temp = _darray_create((DARRAY_RESIZE_FACTOR * header->capacity), header->stride, header->allocator);
+    // Always grow by at least one element, however small the factor.
+    u64 capacity = (u64)(header->capacity * header->growth_factor);
+    return darray_capacity_set(array, KMAX(capacity, header->capacity + 1));
+}
 
-    header = (darray_header*)((u8*)array - header_size);
-    kcopy_memory(temp, array, header->length * header->stride);
+void* _darray_reserve_exact(void* array, u64 capacity) {
+    if (capacity <= darray_capacity(array)) {
+        return array;
+    }
+    return darray_capacity_set(array, capacity);
+}
 
-    darray_length_set(temp, header->length);
-    darray_destroy(array);
-    return temp;
+void darray_growth_factor_set(void* array, f32 factor) {
+    if (factor <= 1.0f) {
+        KWARN("darray_growth_factor_set - Growth factor must be greater than 1, but %.2f was given. Ignoring.", factor);
+        return;
+    }
+    u64 header_size = sizeof(darray_header);
+    darray_header* header = (darray_header*)((u8*)array - header_size);
+    header->growth_factor = factor;
 }
 
 void* _darray_push(void* array, const void* value_ptr) {
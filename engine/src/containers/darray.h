@@ -8,6 +8,10 @@
  * - u64 capacity = number elements that can be held.
  * - u64 length = number of elements currently contained
  * - u64 stride = size of each element in bytes
+ * - frame_allocator_int* allocator = the allocator used, or 0 for dynamic allocations
+ * - f32 growth_factor = the factor the capacity grows by when full
+ * - u32 flags
+ * - u64 padding
  * - void* elements
  * @version 2.0
  * @date 2023-08-30
@@ -32,6 +36,18 @@ struct frame_allocator_int;
  */
 KAPI void* _darray_create(u64 length, u64 stride, struct frame_allocator_int* frame_allocator);
 
+/**
+ * @brief Creates a new darray within the given buffer, which must outlive it. No allocation is made
+ * until the array outgrows the buffer, at which point it moves to memory from the allocator.
+ * @note Avoid using this directly; use the darray_create_in_buffer macro instead.
+ * @param buffer_size The size of the buffer in bytes, including the DARRAY_HEADER_SIZE bytes of header.
+ * @param stride The size of each array element.
+ * @param buffer The buffer to hold the array. Must be at least 8-byte aligned.
+ * @param frame_allocator The allocator used if the array outgrows the buffer. 0 for dynamic allocations.
+ * @returns A pointer representing the block of memory containing the array.
+ */
+KAPI void* _darray_create_in_buffer(u64 buffer_size, u64 stride, void* buffer, struct frame_allocator_int* frame_allocator);
+
 /**
  * @brief Resizes the given array using internal resizing amounts.
  * Causes a new allocation.
@@ -41,6 +57,16 @@ KAPI void* _darray_create(u64 length, u64 stride, struct frame_allocator_int* fr
  */
 KAPI void* _darray_resize(void* array);
 
+/**
+ * @brief Ensures the array can hold at least the given number of elements, growing it to
+ * exactly that capacity if it cannot.
+ * @note Avoid using this directly; use the darray_reserve_exact macro instead.
+ * @param array The array to be reserved in.
+ * @param capacity The number of elements the array must be able to hold.
+ * @returns A pointer to the array block, which may have moved.
+ */
+KAPI void* _darray_reserve_exact(void* array, u64 capacity);
+
 /**
  * @brief Pushes a new entry to the given array. Resizes if necessary.
  * @note Avoid using this directly; call the darray_push macro instead.
@@ -67,6 +93,37 @@ KAPI void* _darray_insert_at(void* array, u64 index, void* value_ptr);
 /** @brief The default resize factor (doubles on resize) */
 #define DARRAY_RESIZE_FACTOR 2
 
+/** @brief The size of the header stored ahead of the elements of every darray, in bytes. */
+#define DARRAY_HEADER_SIZE 48
+
+/**
+ * @brief Declares a buffer named name able to hold a darray of up to capacity elements of the given
+ * type, for use with darray_create_in_buffer.
+ */
+#define darray_buffer_declare(type, name, capacity) \
+    u64 name[(DARRAY_HEADER_SIZE + sizeof(type) * (capacity) + sizeof(u64) - 1) / sizeof(u64)]
+
+/**
+ * @brief Creates a new darray within a buffer declared with darray_buffer_declare, such as one on
+ * the stack. Nothing is allocated unless the array outgrows the buffer.
+ * @param type The type to be used to create the darray.
+ * @param buffer The buffer declared with darray_buffer_declare.
+ * @param allocator A pointer to a frame allocator used if the array outgrows the buffer, or 0 for
+ * dynamic allocations.
+ * @returns A pointer to the array within the buffer.
+ */
+#define darray_create_in_buffer(type, buffer, allocator) \
+    _darray_create_in_buffer(sizeof(buffer), sizeof(type), buffer, allocator)
+
+/**
+ * @brief Ensures the array can hold at least the given number of elements without growing, to
+ * exactly that capacity. The array is reassigned, as it may move.
+ * @param array The array to be reserved in.
+ * @param capacity The number of elements the array must be able to hold.
+ */
+#define darray_reserve_exact(array, capacity) \
+    array = _darray_reserve_exact(array, capacity)
+
 /**
  * @brief Creates a new darray of the given type with the default capacity.
  * Performs a dynamic memory allocation.
@@ -113,6 +170,16 @@ KAPI void* _darray_insert_at(void* array, u64 index, void* value_ptr);
  */
 KAPI void darray_destroy(void* array);
 
+/**
+ * @brief Ensures the array can hold at least the given number of elements, growing it to
+ * exactly that capacity if it cannot.
+ * @note Avoid using this directly; use the darray_reserve_exact macro instead.
+ * @param array The array to be reserved in.
+ * @param capacity The number of elements the array must be able to hold.
+ * @returns A pointer to the array block, which may have moved.
+ */
+KAPI void* _darray_reserve_exact(void* array, u64 capacity);
+
 /**
  * @brief Pushes a new entry to the given array. Resizes if necessary.
  * @param array The array to be pushed to.
@@ -194,3 +261,11 @@ KAPI u64 darray_stride(void* array);
  * @param value The length to set the array to.
  */
 KAPI void darray_length_set(void* array, u64 value);
+
+/**
+ * @brief Sets the factor the capacity of the given array is multiplied by each time it grows.
+ * Defaults to DARRAY_RESIZE_FACTOR. Smaller factors waste less memory, at the cost of more frequent growth.
+ * @param array The array to set the growth factor of.
+ * @param factor The growth factor. Must be greater than 1.
+ */
+KAPI void darray_growth_factor_set(void* array, f32 factor);
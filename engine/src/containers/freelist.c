@@ -10,6 +10,8 @@ typedef struct freelist_node {
 } freelist_node;
 
 typedef struct internal_state {
+    // NOTE: Must be first, and match the TLSF state, so the strategy can be determined from either.
+    freelist_strategy strategy;
     u64 total_size;
     u64 max_entries;
     freelist_node* head;
@@ -19,7 +21,451 @@ typedef struct internal_state {
 static freelist_node* get_node(freelist* list);
 static void return_node(freelist_node* node);
 
+// NOTE: Begin TLSF.
+
+/*
+TLSF keeps free ranges in buckets indexed by a first level (the power of 2 of the size) and a
+second level (a linear subdivision of that power of 2). A bitmap of non-empty first levels and,
+per first level, a bitmap of non-empty second levels allow a bucket holding ranges at least as
+large as a request to be found with a couple of bit scans.
+
+Since a freelist only tracks offsets (the memory itself may not even be CPU-accessible), range
+metadata lives in a node array, and two hash maps (keyed by the start/end offset of each free
+range) are used to find the neighbours of a block being freed so they can be merged.
+*/
+
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 64
+
+typedef struct tlsf_node {
+    u64 offset;
+    u64 size;
+    // Links within the node's bucket. next is also used to chain unused nodes.
+    u32 prev;
+    u32 next;
+} tlsf_node;
+
+typedef struct tlsf_state {
+    // NOTE: Must be first, and match internal_state.
+    freelist_strategy strategy;
+    u64 total_size;
+    u64 max_entries;
+    u64 free_space;
+
+    u64 fl_bitmap;
+    u32 sl_bitmaps[TLSF_FL_COUNT];
+    // The head node of each bucket, or INVALID_ID if empty.
+    u32 buckets[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    // Nodes below this index have been used at some point. Unused nodes above it need no initialization.
+    u32 node_high_water;
+    // A chain of nodes which were used, but have been released.
+    u32 released_nodes;
+
+    // Capacity of each hash map. Always a power of 2 larger than max_entries.
+    u32 hash_capacity;
+    u32 hash_shift;
+
+    tlsf_node* nodes;
+    // Free range start offset -> node index + 1 (0 means an empty slot).
+    u32* start_map;
+    // Free range end offset -> node index + 1 (0 means an empty slot).
+    u32* end_map;
+} tlsf_state;
+
+static u64 tlsf_max_entries(u64 total_size) {
+    // Same number of entries as first fit, since both only track free ranges.
+    u64 max_entries = (total_size / (sizeof(void*) * sizeof(freelist_node)));
+    if (max_entries < 20) {
+        max_entries = 20;
+    }
+    return max_entries;
+}
+
+static u32 tlsf_hash_capacity(u64 max_entries, u32* out_shift) {
+    // Keep the load factor under ~2/3, even when every entry is in use.
+    u64 capacity = 32;
+    u32 shift = 64 - 5;
+    while (capacity < max_entries + (max_entries / 2)) {
+        capacity <<= 1;
+        shift--;
+    }
+    if (out_shift) {
+        *out_shift = shift;
+    }
+    return (u32)capacity;
+}
+
+static u64 tlsf_memory_requirement(u64 max_entries) {
+    u32 capacity = tlsf_hash_capacity(max_entries, 0);
+    return sizeof(tlsf_state) + (sizeof(tlsf_node) * max_entries) + (sizeof(u32) * capacity * 2);
+}
+
+static void tlsf_layout(tlsf_state* state) {
+    state->nodes = (tlsf_node*)((u8*)state + sizeof(tlsf_state));
+    state->start_map = (u32*)((u8*)state->nodes + (sizeof(tlsf_node) * state->max_entries));
+    state->end_map = state->start_map + state->hash_capacity;
+}
+
+KINLINE u32 tlsf_msb(u64 value) {
+    return 63 - (u32)__builtin_clzll(value);
+}
+
+// Obtains the bucket which the given size belongs to.
+static void tlsf_mapping(u64 size, u32* out_fl, u32* out_sl) {
+    if (size < TLSF_SL_COUNT) {
+        *out_fl = 0;
+        *out_sl = (u32)size;
+    } else {
+        u32 msb = tlsf_msb(size);
+        *out_fl = msb - TLSF_SL_LOG2 + 1;
+        *out_sl = (u32)(size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    }
+}
+
+// Obtains the first bucket in which every range is at least the given size.
+static void tlsf_mapping_round_up(u64 size, u32* out_fl, u32* out_sl) {
+    if (size >= TLSF_SL_COUNT) {
+        size += (1ull << (tlsf_msb(size) - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping(size, out_fl, out_sl);
+}
+
+KINLINE u64 tlsf_hash_key(tlsf_node* node, b8 end) {
+    return end ? node->offset + node->size : node->offset;
+}
+
+KINLINE u32 tlsf_hash_home(tlsf_state* state, u64 key) {
+    return (u32)((key * 0x9E3779B97F4A7C15ull) >> state->hash_shift);
+}
+
+static void tlsf_map_insert(tlsf_state* state, u32* map, b8 end, u32 node_index) {
+    u32 mask = state->hash_capacity - 1;
+    u32 slot = tlsf_hash_home(state, tlsf_hash_key(&state->nodes[node_index], end));
+    while (map[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    map[slot] = node_index + 1;
+}
+
+// Returns the slot holding the node with the given key, or INVALID_ID if not found.
+static u32 tlsf_map_find_slot(tlsf_state* state, u32* map, b8 end, u64 key) {
+    u32 mask = state->hash_capacity - 1;
+    u32 slot = tlsf_hash_home(state, key);
+    while (map[slot]) {
+        if (tlsf_hash_key(&state->nodes[map[slot] - 1], end) == key) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return INVALID_ID;
+}
+
+// Returns the index of the node with the given key, or INVALID_ID if not found.
+static u32 tlsf_map_find(tlsf_state* state, u32* map, b8 end, u64 key) {
+    u32 slot = tlsf_map_find_slot(state, map, end, key);
+    return slot == INVALID_ID ? INVALID_ID : map[slot] - 1;
+}
+
+static void tlsf_map_remove(tlsf_state* state, u32* map, b8 end, u32 node_index) {
+    u32 slot = tlsf_map_find_slot(state, map, end, tlsf_hash_key(&state->nodes[node_index], end));
+    if (slot == INVALID_ID) {
+        KERROR("TLSF freelist hash map is missing a node. Corruption possible?");
+        return;
+    }
+    // Shift back any following entries which would no longer be reachable past the hole.
+    u32 mask = state->hash_capacity - 1;
+    u32 hole = slot;
+    u32 next = (hole + 1) & mask;
+    while (map[next]) {
+        u32 home = tlsf_hash_home(state, tlsf_hash_key(&state->nodes[map[next] - 1], end));
+        // Move the entry if its home is not cyclically within (hole, next].
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map[hole] = map[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    map[hole] = 0;
+}
+
+static u32 tlsf_node_acquire(tlsf_state* state) {
+    if (state->released_nodes != INVALID_ID) {
+        u32 index = state->released_nodes;
+        state->released_nodes = state->nodes[index].next;
+        return index;
+    }
+    if (state->node_high_water < state->max_entries) {
+        return state->node_high_water++;
+    }
+    return INVALID_ID;
+}
+
+static void tlsf_node_release(tlsf_state* state, u32 index) {
+    state->nodes[index].next = state->released_nodes;
+    state->released_nodes = index;
+}
+
+static void tlsf_bucket_insert(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    u32 fl, sl;
+    tlsf_mapping(node->size, &fl, &sl);
+    node->prev = INVALID_ID;
+    node->next = state->buckets[fl][sl];
+    if (node->next != INVALID_ID) {
+        state->nodes[node->next].prev = index;
+    }
+    state->buckets[fl][sl] = index;
+    state->fl_bitmap |= (1ull << fl);
+    state->sl_bitmaps[fl] |= (1u << sl);
+}
+
+static void tlsf_bucket_remove(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    u32 fl, sl;
+    tlsf_mapping(node->size, &fl, &sl);
+    if (node->prev != INVALID_ID) {
+        state->nodes[node->prev].next = node->next;
+    } else {
+        state->buckets[fl][sl] = node->next;
+    }
+    if (node->next != INVALID_ID) {
+        state->nodes[node->next].prev = node->prev;
+    }
+    if (state->buckets[fl][sl] == INVALID_ID) {
+        state->sl_bitmaps[fl] &= ~(1u << sl);
+        if (!state->sl_bitmaps[fl]) {
+            state->fl_bitmap &= ~(1ull << fl);
+        }
+    }
+}
+
+// Adds a new free range, returning false if out of nodes.
+static b8 tlsf_add_range(tlsf_state* state, u64 offset, u64 size) {
+    u32 index = tlsf_node_acquire(state);
+    if (index == INVALID_ID) {
+        return false;
+    }
+    state->nodes[index].offset = offset;
+    state->nodes[index].size = size;
+    tlsf_map_insert(state, state->start_map, false, index);
+    tlsf_map_insert(state, state->end_map, true, index);
+    tlsf_bucket_insert(state, index);
+    return true;
+}
+
+static void tlsf_reset(tlsf_state* state) {
+    state->free_space = state->total_size;
+    state->fl_bitmap = 0;
+    kzero_memory(state->sl_bitmaps, sizeof(state->sl_bitmaps));
+    kset_memory(state->buckets, 0xFF, sizeof(state->buckets));
+    state->node_high_water = 0;
+    state->released_nodes = INVALID_ID;
+    kzero_memory(state->start_map, sizeof(u32) * state->hash_capacity * 2);
+    tlsf_add_range(state, 0, state->total_size);
+}
+
+static void tlsf_create(u64 total_size, u64 max_entries, void* memory) {
+    tlsf_state* state = memory;
+    state->strategy = FREELIST_STRATEGY_TLSF;
+    state->total_size = total_size;
+    state->max_entries = max_entries;
+    state->hash_capacity = tlsf_hash_capacity(max_entries, &state->hash_shift);
+    tlsf_layout(state);
+    tlsf_reset(state);
+}
+
+// Takes the given size from the front of the free range at the given index.
+static void tlsf_take_front(tlsf_state* state, u32 index, u64 size) {
+    tlsf_node* node = &state->nodes[index];
+    tlsf_bucket_remove(state, index);
+    tlsf_map_remove(state, state->start_map, false, index);
+    if (node->size == size) {
+        // Exact match, the range is used up entirely.
+        tlsf_map_remove(state, state->end_map, true, index);
+        tlsf_node_release(state, index);
+    } else {
+        // The end of the range stays the same.
+        node->offset += size;
+        node->size -= size;
+        tlsf_map_insert(state, state->start_map, false, index);
+        tlsf_bucket_insert(state, index);
+    }
+    state->free_space -= size;
+}
+
+static b8 tlsf_allocate_block(tlsf_state* state, u64 size, u64* out_offset) {
+    u32 index = INVALID_ID;
+
+    // Look for the first bucket in which any range will do.
+    u32 fl, sl;
+    tlsf_mapping_round_up(size, &fl, &sl);
+    if (fl < TLSF_FL_COUNT) {
+        u32 sl_map = state->sl_bitmaps[fl] & (~0u << sl);
+        if (!sl_map) {
+            u64 fl_map = (fl + 1 < TLSF_FL_COUNT) ? (state->fl_bitmap & (~0ull << (fl + 1))) : 0;
+            if (fl_map) {
+                fl = (u32)__builtin_ctzll(fl_map);
+                sl_map = state->sl_bitmaps[fl];
+            }
+        }
+        if (sl_map) {
+            index = state->buckets[fl][(u32)__builtin_ctz(sl_map)];
+        }
+    }
+
+    // Failing that, a range within the request's own bucket might still be large enough.
+    if (index == INVALID_ID) {
+        tlsf_mapping(size, &fl, &sl);
+        for (u32 i = state->buckets[fl][sl]; i != INVALID_ID; i = state->nodes[i].next) {
+            if (state->nodes[i].size >= size) {
+                index = i;
+                break;
+            }
+        }
+    }
+
+    if (index == INVALID_ID) {
+        KWARN("freelist_find_block, no block with enough free space found (requested: %lluB, available: %lluB).", size, state->free_space);
+        return false;
+    }
+
+    *out_offset = state->nodes[index].offset;
+    tlsf_take_front(state, index, size);
+    return true;
+}
+
+static b8 tlsf_allocate_block_at(tlsf_state* state, u64 size, u64 offset) {
+    u32 index = tlsf_map_find(state, state->start_map, false, offset);
+    if (index == INVALID_ID || state->nodes[index].size < size) {
+        return false;
+    }
+    tlsf_take_front(state, index, size);
+    return true;
+}
+
+static b8 tlsf_free_block(tlsf_state* state, u64 size, u64 offset) {
+    if (offset + size > state->total_size) {
+        KWARN("Unable to find block to be freed. Corruption possible?");
+        return false;
+    }
+    if (tlsf_map_find(state, state->start_map, false, offset) != INVALID_ID) {
+        KFATAL("Attempting to free already-freed block of memory at offset %llu", offset);
+        return false;
+    }
+
+    u32 left = tlsf_map_find(state, state->end_map, true, offset);
+    u32 right = tlsf_map_find(state, state->start_map, false, offset + size);
+    if (left != INVALID_ID && right != INVALID_ID) {
+        // Joins the ranges on both sides, so fold it and the right range into the left one.
+        tlsf_bucket_remove(state, left);
+        tlsf_map_remove(state, state->end_map, true, left);
+        tlsf_bucket_remove(state, right);
+        tlsf_map_remove(state, state->start_map, false, right);
+        tlsf_map_remove(state, state->end_map, true, right);
+        state->nodes[left].size += size + state->nodes[right].size;
+        tlsf_node_release(state, right);
+        tlsf_map_insert(state, state->end_map, true, left);
+        tlsf_bucket_insert(state, left);
+    } else if (left != INVALID_ID) {
+        tlsf_bucket_remove(state, left);
+        tlsf_map_remove(state, state->end_map, true, left);
+        state->nodes[left].size += size;
+        tlsf_map_insert(state, state->end_map, true, left);
+        tlsf_bucket_insert(state, left);
+    } else if (right != INVALID_ID) {
+        tlsf_bucket_remove(state, right);
+        tlsf_map_remove(state, state->start_map, false, right);
+        state->nodes[right].offset = offset;
+        state->nodes[right].size += size;
+        tlsf_map_insert(state, state->start_map, false, right);
+        tlsf_bucket_insert(state, right);
+    } else if (!tlsf_add_range(state, offset, size)) {
+        KERROR("freelist_free_block - out of nodes to track free ranges (max %llu).", state->max_entries);
+        return false;
+    }
+
+    state->free_space += size;
+    return true;
+}
+
+static b8 tlsf_resize(tlsf_state* old_state, u64* memory_requirement, void* new_memory, u64 new_size) {
+    u64 max_entries = tlsf_max_entries(new_size);
+    *memory_requirement = tlsf_memory_requirement(max_entries);
+    if (!new_memory) {
+        return true;
+    }
+
+    tlsf_state* state = new_memory;
+    // Buckets, bitmaps and node chains are index-based, so they carry over as-is.
+    kcopy_memory(state, old_state, sizeof(tlsf_state));
+    state->total_size = new_size;
+    state->max_entries = max_entries;
+    state->hash_capacity = tlsf_hash_capacity(max_entries, &state->hash_shift);
+    tlsf_layout(state);
+    kcopy_memory(state->nodes, old_state->nodes, sizeof(tlsf_node) * old_state->node_high_water);
+
+    // The maps have to be rebuilt for the new capacity. Every node in a bucket is a free range.
+    kzero_memory(state->start_map, sizeof(u32) * state->hash_capacity * 2);
+    for (u32 fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+        for (u32 sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+            for (u32 i = state->buckets[fl][sl]; i != INVALID_ID; i = state->nodes[i].next) {
+                tlsf_map_insert(state, state->start_map, false, i);
+                tlsf_map_insert(state, state->end_map, true, i);
+            }
+        }
+    }
+
+    // Free up the new space at the end, extending the last range if it reaches the old end.
+    u64 size_diff = new_size - old_state->total_size;
+    u32 last = tlsf_map_find(state, state->end_map, true, old_state->total_size);
+    if (last != INVALID_ID) {
+        tlsf_bucket_remove(state, last);
+        tlsf_map_remove(state, state->end_map, true, last);
+        state->nodes[last].size += size_diff;
+        tlsf_map_insert(state, state->end_map, true, last);
+        tlsf_bucket_insert(state, last);
+    } else {
+        tlsf_add_range(state, old_state->total_size, size_diff);
+    }
+    state->free_space += size_diff;
+    return true;
+}
+
+static u64 tlsf_largest_free_block(tlsf_state* state) {
+    if (!state->fl_bitmap) {
+        return 0;
+    }
+    // The largest range is somewhere in the highest non-empty bucket.
+    u32 fl = tlsf_msb(state->fl_bitmap);
+    u32 sl = 31 - (u32)__builtin_clz(state->sl_bitmaps[fl]);
+    u64 largest = 0;
+    for (u32 i = state->buckets[fl][sl]; i != INVALID_ID; i = state->nodes[i].next) {
+        if (state->nodes[i].size > largest) {
+            largest = state->nodes[i].size;
+        }
+    }
+    return largest;
+}
+
+// NOTE: End TLSF.
+
 void freelist_create(u64 total_size, u64* memory_requirement, void* memory, freelist* out_list) {
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_FIRST_FIT, memory_requirement, memory, out_list);
+}
+
+void freelist_create_strategy(u64 total_size, freelist_strategy strategy, u64* memory_requirement, void* memory, freelist* out_list) {
+    if (strategy == FREELIST_STRATEGY_TLSF) {
+        u64 max_entries = tlsf_max_entries(total_size);
+        *memory_requirement = tlsf_memory_requirement(max_entries);
+        if (memory) {
+            out_list->memory = memory;
+            tlsf_create(total_size, max_entries, memory);
+        }
+        return;
+    }
+
     // Enough space to hold state, plus array for all nodes.
     u64 max_entries = (total_size / (sizeof(void*) * sizeof(freelist_node)));  // NOTE: This might have a remainder, but that's ok.
 
@@ -47,6 +493,7 @@ void freelist_create(u64 total_size, u64* memory_requirement, void* memory, free
     // The block's layout is head* first, then array of available nodes.
     kzero_memory(out_list->memory, *memory_requirement);
     internal_state* state = out_list->memory;
+    state->strategy = FREELIST_STRATEGY_FIRST_FIT;
     state->nodes = (void*)(out_list->memory + sizeof(internal_state));
     state->max_entries = max_entries;
     state->total_size = total_size;
@@ -61,6 +508,12 @@ void freelist_create(u64 total_size, u64* memory_requirement, void* memory, free
 
 void freelist_destroy(freelist* list) {
     if (list && list->memory) {
+        if (((internal_state*)list->memory)->strategy == FREELIST_STRATEGY_TLSF) {
+            // Only the state needs clearing, the rest is rebuilt on creation.
+            kzero_memory(list->memory, sizeof(tlsf_state));
+            list->memory = 0;
+            return;
+        }
         // Just zero out the memory before giving it back.
         internal_state* state = list->memory;
         kzero_memory(list->memory, sizeof(internal_state) + sizeof(freelist_node) * state->max_entries);
@@ -73,6 +526,9 @@ b8 freelist_allocate_block(freelist* list, u64 size, u64* out_offset) {
         return false;
     }
     internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        return tlsf_allocate_block(list->memory, size, out_offset);
+    }
     freelist_node* node = state->head;
     freelist_node* previous = 0;
     while (node) {
@@ -109,11 +565,46 @@ b8 freelist_allocate_block(freelist* list, u64 size, u64* out_offset) {
     return false;
 }
 
+b8 freelist_allocate_block_at(freelist* list, u64 size, u64 offset) {
+    if (!list || !list->memory || !size) {
+        return false;
+    }
+    internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        return tlsf_allocate_block_at(list->memory, size, offset);
+    }
+    freelist_node* node = state->head;
+    freelist_node* previous = 0;
+    // Nodes are kept in order of offset, so the search can stop once past it.
+    while (node && node->offset < offset) {
+        previous = node;
+        node = node->next;
+    }
+    if (!node || node->offset != offset || node->size < size) {
+        return false;
+    }
+    if (node->size == size) {
+        if (previous) {
+            previous->next = node->next;
+        } else {
+            state->head = node->next;
+        }
+        return_node(node);
+    } else {
+        node->offset += size;
+        node->size -= size;
+    }
+    return true;
+}
+
 b8 freelist_free_block(freelist* list, u64 size, u64 offset) {
     if (!list || !list->memory || !size) {
         return false;
     }
     internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        return tlsf_free_block(list->memory, size, offset);
+    }
     freelist_node* node = state->head;
     freelist_node* previous = 0;
     if (!node) {
@@ -206,6 +697,17 @@ b8 freelist_resize(freelist* list, u64* memory_requirement, void* new_memory, u6
         return false;
     }
 
+    if (((internal_state*)list->memory)->strategy == FREELIST_STRATEGY_TLSF) {
+        if (!tlsf_resize(list->memory, memory_requirement, new_memory, new_size)) {
+            return false;
+        }
+        if (new_memory) {
+            *out_old_memory = list->memory;
+            list->memory = new_memory;
+        }
+        return true;
+    }
+
     // Enough space to hold state, plus array for all nodes.
     u64 max_entries = (new_size / sizeof(void*));  // NOTE: This might have a remainder, but that's ok.
 
@@ -298,6 +800,10 @@ void freelist_clear(freelist* list) {
     }
 
     internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        tlsf_reset(list->memory);
+        return;
+    }
     // Invalidate the offset for all but the first node. The invalid
     // value will be checked for when seeking a new node from the list.
     kzero_memory(state->nodes, sizeof(freelist_node) * state->max_entries);
@@ -315,6 +821,9 @@ u64 freelist_free_space(freelist* list) {
 
     u64 running_total = 0;
     internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        return ((tlsf_state*)list->memory)->free_space;
+    }
     freelist_node* node = state->head;
     while (node) {
         running_total += node->size;
@@ -324,6 +833,34 @@ u64 freelist_free_space(freelist* list) {
     return running_total;
 }
 
+f32 freelist_fragmentation(freelist* list) {
+    if (!list || !list->memory) {
+        return 0.0f;
+    }
+
+    u64 free_space = 0;
+    u64 largest = 0;
+    internal_state* state = list->memory;
+    if (state->strategy == FREELIST_STRATEGY_TLSF) {
+        free_space = ((tlsf_state*)list->memory)->free_space;
+        largest = tlsf_largest_free_block(list->memory);
+    } else {
+        freelist_node* node = state->head;
+        while (node) {
+            free_space += node->size;
+            if (node->size > largest) {
+                largest = node->size;
+            }
+            node = node->next;
+        }
+    }
+
+    if (free_space == 0) {
+        return 0.0f;
+    }
+    return 1.0f - ((f32)largest / (f32)free_space);
+}
+
 static freelist_node* get_node(freelist* list) {
     internal_state* state = list->memory;
     for (u64 i = 1; i < state->max_entries; ++i) {
@@ -13,6 +13,21 @@
 
 #include "defines.h"
 
+/** @brief The strategy a freelist uses to find a free block for an allocation. */
+typedef enum freelist_strategy {
+    /**
+     * @brief Walks a single list of free ranges sorted by offset, taking the first one large
+     * enough. Uses the least memory, but allocations and frees are linear in the number of free ranges.
+     */
+    FREELIST_STRATEGY_FIRST_FIT = 0,
+    /**
+     * @brief Two-Level Segregated Fit. Free ranges are bucketed by size class, with bitmaps used
+     * to find a suitable bucket, making allocations and frees O(1) regardless of fragmentation.
+     * Requires more memory for bookkeeping than first fit.
+     */
+    FREELIST_STRATEGY_TLSF = 1
+} freelist_strategy;
+
 /**
  * @brief A data structure to be used alongside an allocator for dynamic memory
  * allocation. Tracks free ranges of memory.
@@ -34,6 +49,19 @@ typedef struct freelist {
  */
 KAPI void freelist_create(u64 total_size, u64* memory_requirement, void* memory, freelist* out_list);
 
+/**
+ * @brief Creates a new freelist using the given strategy, or obtains the memory requirement for
+ * one. Call twice; once passing 0 to memory to obtain memory requirement, and a second
+ * time passing an allocated block to memory.
+ *
+ * @param total_size The total size in bytes that the free list should track.
+ * @param strategy The strategy used to find free blocks.
+ * @param memory_requirement A pointer to hold memory requirement for the free list itself.
+ * @param memory 0, or a pre-allocated block of memory for the free list to use.
+ * @param out_list A pointer to hold the created free list.
+ */
+KAPI void freelist_create_strategy(u64 total_size, freelist_strategy strategy, u64* memory_requirement, void* memory, freelist* out_list);
+
 /**
  * @brief Destroys the provided list.
  * 
@@ -51,6 +79,18 @@ KAPI void freelist_destroy(freelist* list);
  */
 KAPI b8 freelist_allocate_block(freelist* list, u64 size, u64* out_offset);
 
+/**
+ * @brief Attempts to allocate a block of the given size at exactly the given offset, which must
+ * be the start of a free block at least that large. Used to grow an allocated block into the
+ * free space directly after it.
+ *
+ * @param list A pointer to the list to allocate from.
+ * @param size The size to allocate.
+ * @param offset The offset to allocate at.
+ * @return b8 True if the block was free and has been allocated; otherwise false.
+ */
+KAPI b8 freelist_allocate_block_at(freelist* list, u64 size, u64 offset);
+
 /**
  * @brief Attempts to free a block of memory at the given offset, and of the given
  * size. Can fail if invalid data is passed.
@@ -86,11 +126,22 @@ KAPI b8 freelist_resize(freelist* list, u64* memory_requirement, void* new_memor
 KAPI void freelist_clear(freelist* list);
 
 /**
- * @brief Returns the amount of free space in this list. NOTE: Since this has
- * to iterate the entire internal list, this can be an expensive operation.
+ * @brief Returns the amount of free space in this list. NOTE: For first fit lists, this has
+ * to iterate the entire internal list, and thus can be an expensive operation.
  * Use sparingly.
  * 
  * @param list A pointer to the list to obtain from.
  * @return The amount of free space in bytes.
  */
 KAPI u64 freelist_free_space(freelist* list);
+
+/**
+ * @brief Returns the fragmentation of the free space in this list, which is the portion of
+ * free space not part of the largest free block. 0 means all free space is contiguous, while
+ * values approaching 1 mean the free space is split into many small ranges.
+ * NOTE: This iterates the list (or a bucket of it), so use sparingly.
+ *
+ * @param list A pointer to the list to obtain from.
+ * @return The fragmentation in the range [0, 1].
+ */
+KAPI f32 freelist_fragmentation(freelist* list);
@@ -0,0 +1,320 @@
+#include "hashmap.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+
+// Slots are never filled beyond this fraction (numerator over 8).
+#define HASHMAP_MAX_LOAD_EIGHTHS 7
+
+// A hash of 0 marks an empty slot, so actual hashes are never 0.
+KINLINE u64 hashmap_finalize_hash(u64 hash) {
+    return hash ? hash : 1;
+}
+
+static u64 hash_u64(u64 key) {
+    // splitmix64 finalizer, which spreads sequential keys (such as ids) across the table.
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBull;
+    key ^= key >> 31;
+    return hashmap_finalize_hash(key);
+}
+
+u64 hashmap_hash_string(const char* key) {
+    // FNV-1a, followed by a final mix so the low bits (which pick the slot) depend on the whole key.
+    u64 hash = 0xCBF29CE484222325ull;
+    for (const u8* c = (const u8*)key; *c; ++c) {
+        hash ^= *c;
+        hash *= 0x100000001B3ull;
+    }
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ull;
+    hash ^= hash >> 32;
+    return hashmap_finalize_hash(hash);
+}
+
+u64 hashmap_hash_stringi(const char* key) {
+    u64 hash = 0xCBF29CE484222325ull;
+    for (const u8* c = (const u8*)key; *c; ++c) {
+        u8 lower = (*c >= 'A' && *c <= 'Z') ? (*c + ('a' - 'A')) : *c;
+        hash ^= lower;
+        hash *= 0x100000001B3ull;
+    }
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ull;
+    hash ^= hash >> 32;
+    return hashmap_finalize_hash(hash);
+}
+
+static u32 hashmap_capacity_for(u32 max_entry_count) {
+    u64 capacity = 8;
+    while (capacity * HASHMAP_MAX_LOAD_EIGHTHS < (u64)max_entry_count * 8) {
+        capacity <<= 1;
+    }
+    return (u32)capacity;
+}
+
+KINLINE void* hashmap_value_at(hashmap* map, u32 slot) {
+    return (u8*)map->values + (map->element_size * slot);
+}
+
+// The distance of the entry in the given slot from the slot its hash maps to.
+KINLINE u32 hashmap_probe_distance(hashmap* map, u32 slot) {
+    return (slot - (u32)map->hashes[slot]) & (map->capacity - 1);
+}
+
+KINLINE b8 hashmap_keys_equal(hashmap* map, u32 slot, u64 key) {
+    if (map->key_type == HASHMAP_KEY_TYPE_STRING) {
+        return strings_equal((const char*)map->keys[slot], (const char*)key);
+    }
+    return map->keys[slot] == key;
+}
+
+// Returns the slot holding the given key, or INVALID_ID if not present.
+static u32 hashmap_find_slot(hashmap* map, u64 hash, u64 key) {
+    u32 mask = map->capacity - 1;
+    u32 slot = (u32)hash & mask;
+    for (u32 distance = 0;; ++distance) {
+        u64 slot_hash = map->hashes[slot];
+        // Give up on an empty slot, or once past where the key would have displaced another entry.
+        if (!slot_hash || hashmap_probe_distance(map, slot) < distance) {
+            return INVALID_ID;
+        }
+        if (slot_hash == hash && hashmap_keys_equal(map, slot, key)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static b8 hashmap_insert(hashmap* map, u64 hash, u64 key, const void* value) {
+    u32 slot = hashmap_find_slot(map, hash, key);
+    if (slot != INVALID_ID) {
+        // Already exists, just replace the value.
+        kcopy_memory(hashmap_value_at(map, slot), value, map->element_size);
+        return true;
+    }
+
+    if (map->count >= map->max_entry_count) {
+        KERROR("hashmap_set - map is full (max %u entries). Entry not added.", map->max_entry_count);
+        return false;
+    }
+
+    if (map->key_type == HASHMAP_KEY_TYPE_STRING) {
+        key = (u64)string_duplicate((const char*)key);
+    }
+
+    // The entry being placed. Whenever it is further from home than the resident of a slot,
+    // it takes that slot, and the resident carries on looking instead.
+    void* carried_value = map->scratch;
+    void* swap_value = (u8*)map->scratch + map->element_size;
+    kcopy_memory(carried_value, value, map->element_size);
+
+    u32 mask = map->capacity - 1;
+    slot = (u32)hash & mask;
+    for (u32 distance = 0;; ++distance) {
+        if (!map->hashes[slot]) {
+            map->hashes[slot] = hash;
+            map->keys[slot] = key;
+            kcopy_memory(hashmap_value_at(map, slot), carried_value, map->element_size);
+            map->count++;
+            return true;
+        }
+
+        u32 resident_distance = hashmap_probe_distance(map, slot);
+        if (resident_distance < distance) {
+            u64 resident_hash = map->hashes[slot];
+            u64 resident_key = map->keys[slot];
+            map->hashes[slot] = hash;
+            map->keys[slot] = key;
+            hash = resident_hash;
+            key = resident_key;
+
+            void* resident_value = hashmap_value_at(map, slot);
+            kcopy_memory(swap_value, resident_value, map->element_size);
+            kcopy_memory(resident_value, carried_value, map->element_size);
+            void* temp = carried_value;
+            carried_value = swap_value;
+            swap_value = temp;
+
+            distance = resident_distance;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static b8 hashmap_lookup(hashmap* map, u64 hash, u64 key, void* out_value) {
+    u32 slot = hashmap_find_slot(map, hash, key);
+    if (slot == INVALID_ID) {
+        return false;
+    }
+    if (out_value) {
+        kcopy_memory(out_value, hashmap_value_at(map, slot), map->element_size);
+    }
+    return true;
+}
+
+static b8 hashmap_erase(hashmap* map, u64 hash, u64 key) {
+    u32 slot = hashmap_find_slot(map, hash, key);
+    if (slot == INVALID_ID) {
+        return false;
+    }
+
+    if (map->key_type == HASHMAP_KEY_TYPE_STRING) {
+        string_free((char*)map->keys[slot]);
+    }
+
+    // Shift following entries back a slot until one is found that is already home (or empty).
+    u32 mask = map->capacity - 1;
+    u32 next = (slot + 1) & mask;
+    while (map->hashes[next] && hashmap_probe_distance(map, next) > 0) {
+        map->hashes[slot] = map->hashes[next];
+        map->keys[slot] = map->keys[next];
+        kcopy_memory(hashmap_value_at(map, slot), hashmap_value_at(map, next), map->element_size);
+        slot = next;
+        next = (next + 1) & mask;
+    }
+    map->hashes[slot] = 0;
+    map->keys[slot] = 0;
+    map->count--;
+    return true;
+}
+
+b8 hashmap_create(hashmap_key_type key_type, u64 element_size, u32 max_entry_count, u64* memory_requirement, void* memory, hashmap* out_map) {
+    if (!memory_requirement) {
+        KERROR("hashmap_create requires a valid pointer to memory_requirement.");
+        return false;
+    }
+    if (!element_size || !max_entry_count) {
+        KERROR("element_size and max_entry_count must be a positive non-zero value.");
+        return false;
+    }
+
+    u32 capacity = hashmap_capacity_for(max_entry_count);
+    // Hashes, keys and values for each slot, plus 2 values worth of scratch space.
+    *memory_requirement = (sizeof(u64) * 2 * capacity) + (element_size * capacity) + (element_size * 2);
+    if (!memory) {
+        return true;
+    }
+    if (!out_map) {
+        KERROR("hashmap_create requires a valid pointer to out_map.");
+        return false;
+    }
+
+    out_map->key_type = key_type;
+    out_map->element_size = element_size;
+    out_map->max_entry_count = max_entry_count;
+    out_map->capacity = capacity;
+    out_map->count = 0;
+    out_map->memory = memory;
+    out_map->hashes = memory;
+    out_map->keys = out_map->hashes + capacity;
+    out_map->values = out_map->keys + capacity;
+    out_map->scratch = (u8*)out_map->values + (element_size * capacity);
+    kzero_memory(memory, *memory_requirement);
+    return true;
+}
+
+void hashmap_destroy(hashmap* map) {
+    if (map) {
+        if (map->memory) {
+            hashmap_clear(map);
+        }
+        kzero_memory(map, sizeof(hashmap));
+    }
+}
+
+void hashmap_clear(hashmap* map) {
+    if (!map || !map->memory) {
+        return;
+    }
+    if (map->key_type == HASHMAP_KEY_TYPE_STRING) {
+        for (u32 i = 0; i < map->capacity; ++i) {
+            if (map->hashes[i]) {
+                string_free((char*)map->keys[i]);
+            }
+        }
+    }
+    kzero_memory(map->hashes, sizeof(u64) * 2 * map->capacity);
+    map->count = 0;
+}
+
+static b8 hashmap_check(hashmap* map, hashmap_key_type key_type, const char* func_name) {
+    if (!map || !map->memory) {
+        KERROR("%s requires a valid map.", func_name);
+        return false;
+    }
+    if (map->key_type != key_type) {
+        KERROR("%s called on a map using a different key type.", func_name);
+        return false;
+    }
+    return true;
+}
+
+b8 hashmap_set(hashmap* map, const char* key, const void* value) {
+    if (!key) {
+        KERROR("hashmap_set requires a key.");
+        return false;
+    }
+    return hashmap_set_hashed(map, hashmap_hash_string(key), key, value);
+}
+
+b8 hashmap_get(hashmap* map, const char* key, void* out_value) {
+    if (!key) {
+        KERROR("hashmap_get requires a key.");
+        return false;
+    }
+    return hashmap_get_hashed(map, hashmap_hash_string(key), key, out_value);
+}
+
+b8 hashmap_remove(hashmap* map, const char* key) {
+    if (!key) {
+        KERROR("hashmap_remove requires a key.");
+        return false;
+    }
+    return hashmap_remove_hashed(map, hashmap_hash_string(key), key);
+}
+
+b8 hashmap_set_hashed(hashmap* map, u64 hash, const char* key, const void* value) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_STRING, "hashmap_set") || !key || !value) {
+        return false;
+    }
+    return hashmap_insert(map, hashmap_finalize_hash(hash), (u64)key, value);
+}
+
+b8 hashmap_get_hashed(hashmap* map, u64 hash, const char* key, void* out_value) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_STRING, "hashmap_get") || !key) {
+        return false;
+    }
+    return hashmap_lookup(map, hashmap_finalize_hash(hash), (u64)key, out_value);
+}
+
+b8 hashmap_remove_hashed(hashmap* map, u64 hash, const char* key) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_STRING, "hashmap_remove") || !key) {
+        return false;
+    }
+    return hashmap_erase(map, hashmap_finalize_hash(hash), (u64)key);
+}
+
+b8 hashmap_set_u64(hashmap* map, u64 key, const void* value) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_U64, "hashmap_set_u64") || !value) {
+        return false;
+    }
+    return hashmap_insert(map, hash_u64(key), key, value);
+}
+
+b8 hashmap_get_u64(hashmap* map, u64 key, void* out_value) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_U64, "hashmap_get_u64")) {
+        return false;
+    }
+    return hashmap_lookup(map, hash_u64(key), key, out_value);
+}
+
+b8 hashmap_remove_u64(hashmap* map, u64 key) {
+    if (!hashmap_check(map, HASHMAP_KEY_TYPE_U64, "hashmap_remove_u64")) {
+        return false;
+    }
+    return hashmap_erase(map, hash_u64(key), key);
+}
@@ -0,0 +1,173 @@
+/**
+ * @file hashmap.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains an open-addressing hashmap implementation.
+ * @details Unlike hashtable, a hashmap stores the keys of its entries, so colliding keys
+ * never overwrite each other, and entries can be removed. Collisions are resolved using
+ * robin hood linear probing, which keeps probe sequences short enough that the map can be
+ * filled to a high load factor (up to 7/8 of its slots).
+ * @version 1.0
+ * @date 2023-11-16
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief The type of key used by a hashmap. */
+typedef enum hashmap_key_type {
+    /** @brief Null-terminated strings. The map keeps its own copy of each key. */
+    HASHMAP_KEY_TYPE_STRING,
+    /** @brief 64-bit unsigned integers, such as ids or handles. */
+    HASHMAP_KEY_TYPE_U64
+} hashmap_key_type;
+
+/**
+ * @brief Represents an open-addressing hashmap of fixed capacity. Members of this structure
+ * should not be modified outside the functions associated with it.
+ *
+ * The map retains a copy of each value. To store pointers, use an element_size of sizeof(void*)
+ * and pass the address of the pointer. The map does not take ownership of pointers or associated
+ * memory allocations, which should be managed externally.
+ */
+typedef struct hashmap {
+    /** @brief The type of key used by this map. */
+    hashmap_key_type key_type;
+    /** @brief The size of each value in bytes. */
+    u64 element_size;
+    /** @brief The maximum number of entries the map can hold. */
+    u32 max_entry_count;
+    /** @brief The number of slots in the map. Always a power of 2. */
+    u32 capacity;
+    /** @brief The number of entries currently in the map. */
+    u32 count;
+    /** @brief The hash of each slot's key, or 0 if the slot is empty. */
+    u64* hashes;
+    /** @brief The key of each slot. Either the u64 key, or a pointer to the copy of the string key. */
+    u64* keys;
+    /** @brief The value of each slot. */
+    void* values;
+    /** @brief Space used to hold values while they are being moved around. */
+    void* scratch;
+    /** @brief The block of memory used by the map. */
+    void* memory;
+} hashmap;
+
+/**
+ * @brief Creates a new hashmap or obtains the memory requirement for one. Call twice; once
+ * passing 0 to memory to obtain the memory requirement, and a second time passing an
+ * allocated block to memory.
+ *
+ * @param key_type The type of key to be used.
+ * @param element_size The size of each value in bytes.
+ * @param max_entry_count The maximum number of entries the map should hold.
+ * @param memory_requirement A pointer to hold the memory requirement for the map.
+ * @param memory 0, or a pre-allocated block of memory for the map to use.
+ * @param out_map A pointer to hold the created map.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 hashmap_create(hashmap_key_type key_type, u64 element_size, u32 max_entry_count, u64* memory_requirement, void* memory, hashmap* out_map);
+
+/**
+ * @brief Destroys the provided map, releasing any copies of string keys. The block of memory
+ * provided at creation is not freed, and should be released by the caller.
+ *
+ * @param map A pointer to the map to be destroyed.
+ */
+KAPI void hashmap_destroy(hashmap* map);
+
+/**
+ * @brief Obtains the hash of the given string, as used by string-keyed maps. Can be computed ahead
+ * of time and passed along to the _hashed functions to avoid rehashing the same key.
+ *
+ * @param key The string to be hashed. Required.
+ * @return The hash of the string.
+ */
+KAPI u64 hashmap_hash_string(const char* key);
+
+/**
+ * @brief Obtains a case-insensitive hash of the given string, for maps keyed by names which are
+ * compared case-insensitively. Only ASCII letters are folded. Such maps should use u64 keys with
+ * this hash, as string-keyed maps compare keys case-sensitively.
+ *
+ * @param key The string to be hashed. Required.
+ * @return The hash of the string. Equal to hashmap_hash_string() of its lowercase form.
+ */
+KAPI u64 hashmap_hash_stringi(const char* key);
+
+/**
+ * @brief Stores a copy of the value under the given string key, replacing any existing value.
+ *
+ * @param map A pointer to the map to set in. Must use string keys. Required.
+ * @param key The key of the entry to set. Required.
+ * @param value A pointer to the value to be copied in. Required.
+ * @return True on success; false if a null pointer is passed or the map is full.
+ */
+KAPI b8 hashmap_set(hashmap* map, const char* key, const void* value);
+
+/**
+ * @brief Obtains a copy of the value stored under the given string key.
+ *
+ * @param map A pointer to the map to get from. Must use string keys. Required.
+ * @param key The key of the entry to get. Required.
+ * @param out_value A pointer to hold a copy of the value. Optional, pass 0 to just check for existence.
+ * @return True if the entry exists; otherwise false.
+ */
+KAPI b8 hashmap_get(hashmap* map, const char* key, void* out_value);
+
+/**
+ * @brief Removes the entry stored under the given string key.
+ *
+ * @param map A pointer to the map to remove from. Must use string keys. Required.
+ * @param key The key of the entry to remove. Required.
+ * @return True if the entry existed and was removed; otherwise false.
+ */
+KAPI b8 hashmap_remove(hashmap* map, const char* key);
+
+/** @brief Same as hashmap_set, using a hash obtained from hashmap_hash_string(key). */
+KAPI b8 hashmap_set_hashed(hashmap* map, u64 hash, const char* key, const void* value);
+
+/** @brief Same as hashmap_get, using a hash obtained from hashmap_hash_string(key). */
+KAPI b8 hashmap_get_hashed(hashmap* map, u64 hash, const char* key, void* out_value);
+
+/** @brief Same as hashmap_remove, using a hash obtained from hashmap_hash_string(key). */
+KAPI b8 hashmap_remove_hashed(hashmap* map, u64 hash, const char* key);
+
+/**
+ * @brief Stores a copy of the value under the given u64 key, replacing any existing value.
+ *
+ * @param map A pointer to the map to set in. Must use u64 keys. Required.
+ * @param key The key of the entry to set.
+ * @param value A pointer to the value to be copied in. Required.
+ * @return True on success; false if a null pointer is passed or the map is full.
+ */
+KAPI b8 hashmap_set_u64(hashmap* map, u64 key, const void* value);
+
+/**
+ * @brief Obtains a copy of the value stored under the given u64 key.
+ *
+ * @param map A pointer to the map to get from. Must use u64 keys. Required.
+ * @param key The key of the entry to get.
+ * @param out_value A pointer to hold a copy of the value. Optional, pass 0 to just check for existence.
+ * @return True if the entry exists; otherwise false.
+ */
+KAPI b8 hashmap_get_u64(hashmap* map, u64 key, void* out_value);
+
+/**
+ * @brief Removes the entry stored under the given u64 key.
+ *
+ * @param map A pointer to the map to remove from. Must use u64 keys. Required.
+ * @param key The key of the entry to remove.
+ * @return True if the entry existed and was removed; otherwise false.
+ */
+KAPI b8 hashmap_remove_u64(hashmap* map, u64 key);
+
+/**
+ * @brief Removes all entries from the map.
+ *
+ * @param map A pointer to the map to be cleared.
+ */
+KAPI void hashmap_clear(hashmap* map);
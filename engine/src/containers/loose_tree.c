@@ -0,0 +1,385 @@
+#include "loose_tree.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+
+typedef enum loose_tree_query_type {
+    LOOSE_TREE_QUERY_TYPE_REGION,
+    LOOSE_TREE_QUERY_TYPE_SPHERE,
+    LOOSE_TREE_QUERY_TYPE_FRUSTUM
+} loose_tree_query_type;
+
+typedef struct loose_tree_query {
+    loose_tree_query_type type;
+    extents_3d region;
+    vec3 center;
+    f32 radius;
+    const frustum* f;
+} loose_tree_query;
+
+// The axes along which cells of the given type of tree are divided. Bit i of a child's index
+// selects the upper half of axis i of this list.
+static u32 split_axes_get(loose_tree_type type, const u32** out_axes) {
+    static const u32 octree_axes[3] = {0, 1, 2};
+    static const u32 quadtree_axes[2] = {0, 2};
+    if (type == LOOSE_TREE_TYPE_QUADTREE) {
+        *out_axes = quadtree_axes;
+        return 2;
+    }
+    *out_axes = octree_axes;
+    return 3;
+}
+
+static u32 node_allocate(loose_tree* tree, u32 parent, vec3 center, f32 half_size, u32 depth) {
+    u32 index;
+    if (tree->free_node != INVALID_ID) {
+        index = tree->free_node;
+        tree->free_node = tree->nodes[index].parent;
+    } else {
+        index = (u32)darray_length(tree->nodes);
+        loose_tree_node empty = {0};
+        darray_push(tree->nodes, empty);
+    }
+    loose_tree_node* node = &tree->nodes[index];
+    node->center = center;
+    node->half_size = half_size;
+    node->parent = parent;
+    for (u32 i = 0; i < 8; ++i) {
+        node->children[i] = INVALID_ID;
+    }
+    node->first_item = INVALID_ID;
+    node->item_count = 0;
+    node->depth = depth;
+    return index;
+}
+
+// Obtains the node which should hold an item of the given bounds, creating it and any of its
+// ancestors which don't exist yet. This is the deepest node whose cell holds the center of the
+// item and is at least as large as the item.
+static u32 node_for_bounds(loose_tree* tree, extents_3d bounds) {
+    const u32* axes;
+    u32 axis_count = split_axes_get(tree->type, &axes);
+    vec3 center = vec3_mul_scalar(vec3_add(bounds.min, bounds.max), 0.5f);
+    f32 size = 0.0f;
+    for (u32 a = 0; a < axis_count; ++a) {
+        u32 axis = axes[a];
+        size = KMAX(size, (bounds.max.elements[axis] - bounds.min.elements[axis]) * 0.5f);
+        // Anything centered outside of the tree is held by the root.
+        if (kabs(center.elements[axis] - tree->nodes[0].center.elements[axis]) > tree->nodes[0].half_size) {
+            return 0;
+        }
+    }
+
+    u32 index = 0;
+    while (tree->nodes[index].depth < tree->max_depth) {
+        const loose_tree_node* node = &tree->nodes[index];
+        f32 child_half_size = node->half_size * 0.5f;
+        if (size > child_half_size) {
+            break;
+        }
+        u32 child = 0;
+        vec3 child_center = node->center;
+        for (u32 a = 0; a < axis_count; ++a) {
+            u32 axis = axes[a];
+            if (center.elements[axis] >= node->center.elements[axis]) {
+                child |= 1 << a;
+                child_center.elements[axis] += child_half_size;
+            } else {
+                child_center.elements[axis] -= child_half_size;
+            }
+        }
+        if (node->children[child] == INVALID_ID) {
+            u32 depth = node->depth + 1;
+            // NOTE: Allocating may move the nodes, so the pointer to this one is not used after.
+            u32 child_index = node_allocate(tree, index, child_center, child_half_size, depth);
+            tree->nodes[index].children[child] = child_index;
+        }
+        index = tree->nodes[index].children[child];
+    }
+    return index;
+}
+
+static void item_link(loose_tree* tree, u32 handle, u32 node_index) {
+    loose_tree_item* item = &tree->items[handle];
+    loose_tree_node* node = &tree->nodes[node_index];
+    item->node = node_index;
+    item->previous = INVALID_ID;
+    item->next = node->first_item;
+    if (node->first_item != INVALID_ID) {
+        tree->items[node->first_item].previous = handle;
+    }
+    node->first_item = handle;
+    node->item_count++;
+}
+
+static void item_unlink(loose_tree* tree, u32 handle) {
+    loose_tree_item* item = &tree->items[handle];
+    loose_tree_node* node = &tree->nodes[item->node];
+    if (item->previous != INVALID_ID) {
+        tree->items[item->previous].next = item->next;
+    } else {
+        node->first_item = item->next;
+    }
+    if (item->next != INVALID_ID) {
+        tree->items[item->next].previous = item->previous;
+    }
+    node->item_count--;
+    item->node = INVALID_ID;
+}
+
+// Releases the given node if it is empty, along with any ancestors left empty by doing so.
+static void node_prune(loose_tree* tree, u32 index) {
+    // The root is never released.
+    while (index != 0) {
+        loose_tree_node* node = &tree->nodes[index];
+        if (node->item_count) {
+            return;
+        }
+        for (u32 i = 0; i < 8; ++i) {
+            if (node->children[i] != INVALID_ID) {
+                return;
+            }
+        }
+
+        u32 parent = node->parent;
+        loose_tree_node* parent_node = &tree->nodes[parent];
+        for (u32 i = 0; i < 8; ++i) {
+            if (parent_node->children[i] == index) {
+                parent_node->children[i] = INVALID_ID;
+                break;
+            }
+        }
+        node->parent = tree->free_node;
+        node->depth = INVALID_ID;
+        tree->free_node = index;
+        index = parent;
+    }
+}
+
+static b8 handle_valid(const loose_tree* tree, u32 handle) {
+    return tree && tree->items && handle < darray_length(tree->items) && tree->items[handle].node != INVALID_ID;
+}
+
+b8 loose_tree_create(loose_tree_type type, vec3 center, f32 half_size, u32 max_depth, loose_tree* out_tree) {
+    if (!out_tree) {
+        KERROR("loose_tree_create requires a valid pointer to hold the tree.");
+        return false;
+    }
+    if (half_size <= 0.0f) {
+        KERROR("loose_tree_create requires a positive half_size.");
+        return false;
+    }
+    if (max_depth > LOOSE_TREE_MAX_DEPTH) {
+        KWARN("loose_tree_create - max_depth of %u exceeds the maximum of %u, and has been clamped.", max_depth, LOOSE_TREE_MAX_DEPTH);
+        max_depth = LOOSE_TREE_MAX_DEPTH;
+    }
+
+    kzero_memory(out_tree, sizeof(loose_tree));
+    out_tree->type = type;
+    out_tree->max_depth = max_depth;
+    out_tree->nodes = darray_create(loose_tree_node);
+    out_tree->items = darray_create(loose_tree_item);
+    out_tree->free_node = INVALID_ID;
+    out_tree->free_item = INVALID_ID;
+    node_allocate(out_tree, INVALID_ID, center, half_size, 0);
+    return true;
+}
+
+void loose_tree_destroy(loose_tree* tree) {
+    if (!tree) {
+        return;
+    }
+    if (tree->nodes) {
+        darray_destroy(tree->nodes);
+    }
+    if (tree->items) {
+        darray_destroy(tree->items);
+    }
+    kzero_memory(tree, sizeof(loose_tree));
+}
+
+u32 loose_tree_insert(loose_tree* tree, extents_3d bounds, u64 user_data) {
+    if (!tree || !tree->nodes) {
+        KERROR("loose_tree_insert requires a valid tree.");
+        return INVALID_ID;
+    }
+
+    u32 handle;
+    if (tree->free_item != INVALID_ID) {
+        handle = tree->free_item;
+        tree->free_item = tree->items[handle].next;
+    } else {
+        handle = (u32)darray_length(tree->items);
+        loose_tree_item empty = {0};
+        darray_push(tree->items, empty);
+    }
+    loose_tree_item* item = &tree->items[handle];
+    item->bounds = bounds;
+    item->user_data = user_data;
+    item_link(tree, handle, node_for_bounds(tree, bounds));
+    tree->item_count++;
+    return handle;
+}
+
+b8 loose_tree_move(loose_tree* tree, u32 handle, extents_3d bounds) {
+    if (!handle_valid(tree, handle)) {
+        KERROR("loose_tree_move requires a valid tree and item handle.");
+        return false;
+    }
+
+    tree->items[handle].bounds = bounds;
+    u32 old_node = tree->items[handle].node;
+    u32 new_node = node_for_bounds(tree, bounds);
+    if (new_node != old_node) {
+        item_unlink(tree, handle);
+        item_link(tree, handle, new_node);
+        node_prune(tree, old_node);
+    }
+    return true;
+}
+
+b8 loose_tree_remove(loose_tree* tree, u32 handle) {
+    if (!handle_valid(tree, handle)) {
+        KERROR("loose_tree_remove requires a valid tree and item handle.");
+        return false;
+    }
+
+    u32 node = tree->items[handle].node;
+    item_unlink(tree, handle);
+    node_prune(tree, node);
+    tree->items[handle].next = tree->free_item;
+    tree->free_item = handle;
+    tree->item_count--;
+    return true;
+}
+
+// Indicates if the loose bounds of the given node, which extend half its cell size beyond the
+// cell, may hold items found by the query. Along the axes a quadtree doesn't divide, nodes extend
+// infinitely.
+static b8 node_overlaps(const loose_tree* tree, const loose_tree_node* node, const loose_tree_query* query) {
+    const u32* axes;
+    u32 axis_count = split_axes_get(tree->type, &axes);
+    f32 loose_half_size = node->half_size * 2.0f;
+    switch (query->type) {
+        case LOOSE_TREE_QUERY_TYPE_REGION:
+            for (u32 a = 0; a < axis_count; ++a) {
+                u32 axis = axes[a];
+                if (query->region.max.elements[axis] < node->center.elements[axis] - loose_half_size ||
+                    query->region.min.elements[axis] > node->center.elements[axis] + loose_half_size) {
+                    return false;
+                }
+            }
+            return true;
+        case LOOSE_TREE_QUERY_TYPE_SPHERE: {
+            f32 distance_squared = 0.0f;
+            for (u32 a = 0; a < axis_count; ++a) {
+                u32 axis = axes[a];
+                f32 offset = kabs(query->center.elements[axis] - node->center.elements[axis]) - loose_half_size;
+                if (offset > 0.0f) {
+                    distance_squared += offset * offset;
+                }
+            }
+            return distance_squared <= query->radius * query->radius;
+        }
+        case LOOSE_TREE_QUERY_TYPE_FRUSTUM:
+            for (u32 i = 0; i < FRUSTUM_SIDE_COUNT; ++i) {
+                const plane_3d* p = &query->f->sides[i];
+                if (tree->type == LOOSE_TREE_TYPE_QUADTREE && p->normal.y != 0.0f) {
+                    // A node extending infinitely along Y can't be entirely behind such a plane.
+                    continue;
+                }
+                f32 r = 0.0f;
+                for (u32 a = 0; a < axis_count; ++a) {
+                    r += loose_half_size * kabs(p->normal.elements[axes[a]]);
+                }
+                if (plane_signed_distance(p, &node->center) < -r) {
+                    return false;
+                }
+            }
+            return true;
+    }
+    return false;
+}
+
+static b8 item_overlaps(const loose_tree_item* item, const loose_tree_query* query) {
+    const extents_3d* bounds = &item->bounds;
+    switch (query->type) {
+        case LOOSE_TREE_QUERY_TYPE_REGION:
+            return bounds->min.x <= query->region.max.x && bounds->max.x >= query->region.min.x &&
+                   bounds->min.y <= query->region.max.y && bounds->max.y >= query->region.min.y &&
+                   bounds->min.z <= query->region.max.z && bounds->max.z >= query->region.min.z;
+        case LOOSE_TREE_QUERY_TYPE_SPHERE: {
+            f32 distance_squared = 0.0f;
+            for (u32 axis = 0; axis < 3; ++axis) {
+                f32 value = query->center.elements[axis];
+                f32 closest = KMAX(bounds->min.elements[axis], KMIN(value, bounds->max.elements[axis]));
+                distance_squared += (value - closest) * (value - closest);
+            }
+            return distance_squared <= query->radius * query->radius;
+        }
+        case LOOSE_TREE_QUERY_TYPE_FRUSTUM: {
+            vec3 center = vec3_mul_scalar(vec3_add(bounds->min, bounds->max), 0.5f);
+            vec3 extents = vec3_mul_scalar(vec3_sub(bounds->max, bounds->min), 0.5f);
+            return frustum_intersects_aabb(query->f, &center, &extents);
+        }
+    }
+    return false;
+}
+
+static void query_run(const loose_tree* tree, const loose_tree_query* query, PFN_loose_tree_item_found callback, void* context) {
+    if (!tree || !tree->nodes || !callback) {
+        return;
+    }
+
+    // Each level visited leaves at most seven siblings on the stack, plus the children of the
+    // deepest node.
+    u32 stack[8 * (LOOSE_TREE_MAX_DEPTH + 1)];
+    u32 top = 0;
+    stack[top++] = 0;
+    while (top) {
+        u32 index = stack[--top];
+        const loose_tree_node* node = &tree->nodes[index];
+        // The root also holds the items outside of the tree, so is always searched.
+        if (index != 0 && !node_overlaps(tree, node, query)) {
+            continue;
+        }
+        for (u32 handle = node->first_item; handle != INVALID_ID; handle = tree->items[handle].next) {
+            const loose_tree_item* item = &tree->items[handle];
+            if (item_overlaps(item, query) && !callback(handle, item->user_data, context)) {
+                return;
+            }
+        }
+        for (u32 i = 0; i < 8; ++i) {
+            if (node->children[i] != INVALID_ID) {
+                stack[top++] = node->children[i];
+            }
+        }
+    }
+}
+
+void loose_tree_query_region(const loose_tree* tree, extents_3d region, PFN_loose_tree_item_found callback, void* context) {
+    loose_tree_query query = {0};
+    query.type = LOOSE_TREE_QUERY_TYPE_REGION;
+    query.region = region;
+    query_run(tree, &query, callback, context);
+}
+
+void loose_tree_query_sphere(const loose_tree* tree, vec3 center, f32 radius, PFN_loose_tree_item_found callback, void* context) {
+    loose_tree_query query = {0};
+    query.type = LOOSE_TREE_QUERY_TYPE_SPHERE;
+    query.center = center;
+    query.radius = radius;
+    query_run(tree, &query, callback, context);
+}
+
+void loose_tree_query_frustum(const loose_tree* tree, const frustum* f, PFN_loose_tree_item_found callback, void* context) {
+    if (!f) {
+        return;
+    }
+    loose_tree_query query = {0};
+    query.type = LOOSE_TREE_QUERY_TYPE_FRUSTUM;
+    query.f = f;
+    query_run(tree, &query, callback, context);
+}
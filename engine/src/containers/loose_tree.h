@@ -0,0 +1,181 @@
+/**
+ * @file loose_tree.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains a loose octree and quadtree implementation, used to find the items
+ * within a region of space without visiting every item.
+ * @details Each node of a loose tree covers a cubic cell, but holds any item whose center lies
+ * within the cell and whose bounds lie within twice the cell's size. This lets the node of an item
+ * be determined directly from its center and size, so items can be inserted and moved without
+ * ever splitting nodes or being held by more than one. Nodes are created as items need them, and
+ * released once empty.
+ *
+ * An octree divides its cells along all three axes. A quadtree divides them along the X and Z
+ * axes only, which suits content spread over the ground such as terrain chunks. Items are bounded
+ * by boxes in either case, and queries are exact against those boxes. Items outside the space
+ * covered by the tree are held by its root, and so are always tested by queries.
+ * @version 1.0
+ * @date 2023-11-29
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+/** @brief The maximum depth of a loose tree, not counting the root. */
+#define LOOSE_TREE_MAX_DEPTH 16
+
+/** @brief The type of a loose tree, which determines the axes its cells are divided along. */
+typedef enum loose_tree_type {
+    /** @brief Cells are divided along the X, Y and Z axes into eight children. */
+    LOOSE_TREE_TYPE_OCTREE,
+    /** @brief Cells are divided along the X and Z axes into four children, and extend infinitely along Y. */
+    LOOSE_TREE_TYPE_QUADTREE
+} loose_tree_type;
+
+/** @brief A single item held by a loose tree. */
+typedef struct loose_tree_item {
+    /** @brief The bounds of the item. */
+    extents_3d bounds;
+    /** @brief The caller-provided value of the item, passed back by queries. */
+    u64 user_data;
+    /** @brief The index of the node holding the item, or INVALID_ID if the item is unused. */
+    u32 node;
+    /** @brief The index of the next item in the same node. For an unused item, the next unused item. */
+    u32 next;
+    /** @brief The index of the previous item in the same node. */
+    u32 previous;
+} loose_tree_item;
+
+/** @brief A single node of a loose tree. */
+typedef struct loose_tree_node {
+    /** @brief The center of the node's cell. */
+    vec3 center;
+    /** @brief Half the size of the node's cell. Items may extend up to this far beyond it. */
+    f32 half_size;
+    /** @brief The index of the parent node, or INVALID_ID for the root. For an unused node, the next unused node. */
+    u32 parent;
+    /** @brief The indices of the children, INVALID_ID where there is none. Only the first four are used by quadtrees. */
+    u32 children[8];
+    /** @brief The index of the first item held by this node, or INVALID_ID if none. */
+    u32 first_item;
+    /** @brief The number of items held by this node, not counting those of its children. */
+    u32 item_count;
+    /** @brief The depth of the node. 0 for the root. */
+    u32 depth;
+} loose_tree_node;
+
+/**
+ * @brief Represents a loose octree or quadtree. Members of this structure should not be modified
+ * outside the functions associated with it.
+ */
+typedef struct loose_tree {
+    /** @brief The type of this tree. */
+    loose_tree_type type;
+    /** @brief The maximum depth of nodes in this tree. */
+    u32 max_depth;
+    /** @brief darray of nodes. The root is always at index 0. */
+    loose_tree_node* nodes;
+    /** @brief darray of items. Item handles are indices into this array. */
+    loose_tree_item* items;
+    /** @brief The index of the first unused node, or INVALID_ID if none. */
+    u32 free_node;
+    /** @brief The index of the first unused item, or INVALID_ID if none. */
+    u32 free_item;
+    /** @brief The number of items in the tree. */
+    u32 item_count;
+} loose_tree;
+
+/**
+ * @brief Invoked for each item found by a query.
+ *
+ * @param handle The handle of the item.
+ * @param user_data The value of the item, as provided when it was inserted.
+ * @param context The context passed to the query.
+ * @return True to continue the query; false to stop it.
+ */
+typedef b8 (*PFN_loose_tree_item_found)(u32 handle, u64 user_data, void* context);
+
+/**
+ * @brief Creates a new loose tree covering the given cube of space.
+ *
+ * @param type The type of the tree.
+ * @param center The center of the space covered by the tree.
+ * @param half_size Half the size of the space covered by the tree along each axis. Along Y, ignored by quadtrees.
+ * @param max_depth The maximum depth of nodes, which should be chosen so that the smallest cells are about as
+ * large as the smallest items. Clamped to LOOSE_TREE_MAX_DEPTH.
+ * @param out_tree A pointer to hold the created tree.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 loose_tree_create(loose_tree_type type, vec3 center, f32 half_size, u32 max_depth, loose_tree* out_tree);
+
+/**
+ * @brief Destroys the given tree.
+ *
+ * @param tree A pointer to the tree to be destroyed.
+ */
+KAPI void loose_tree_destroy(loose_tree* tree);
+
+/**
+ * @brief Inserts an item into the tree.
+ *
+ * @param tree A pointer to the tree.
+ * @param bounds The bounds of the item.
+ * @param user_data A value identifying the item, passed back by queries.
+ * @return A handle to the item, used to move or remove it; or INVALID_ID on failure.
+ */
+KAPI u32 loose_tree_insert(loose_tree* tree, extents_3d bounds, u64 user_data);
+
+/**
+ * @brief Sets new bounds for the given item, moving it to another node if required.
+ *
+ * @param tree A pointer to the tree.
+ * @param handle The handle of the item, as returned by loose_tree_insert.
+ * @param bounds The new bounds of the item.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 loose_tree_move(loose_tree* tree, u32 handle, extents_3d bounds);
+
+/**
+ * @brief Removes the given item from the tree. Its handle may be reused by a later insertion.
+ *
+ * @param tree A pointer to the tree.
+ * @param handle The handle of the item, as returned by loose_tree_insert.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 loose_tree_remove(loose_tree* tree, u32 handle);
+
+/**
+ * @brief Finds the items whose bounds overlap the given region.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param region The region to search.
+ * @param callback Invoked for each item found.
+ * @param context Passed to the callback.
+ */
+KAPI void loose_tree_query_region(const loose_tree* tree, extents_3d region, PFN_loose_tree_item_found callback, void* context);
+
+/**
+ * @brief Finds the items whose bounds overlap the given sphere.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param center The center of the sphere.
+ * @param radius The radius of the sphere.
+ * @param callback Invoked for each item found.
+ * @param context Passed to the callback.
+ */
+KAPI void loose_tree_query_sphere(const loose_tree* tree, vec3 center, f32 radius, PFN_loose_tree_item_found callback, void* context);
+
+/**
+ * @brief Finds the items whose bounds are intersected by or contained within the given
+ * frustum, as frustum_intersects_aabb determines.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param f A constant pointer to the frustum.
+ * @param callback Invoked for each item found.
+ * @param context Passed to the callback.
+ */
+KAPI void loose_tree_query_frustum(const loose_tree* tree, const frustum* f, PFN_loose_tree_item_found callback, void* context);
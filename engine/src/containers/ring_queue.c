@@ -1,5 +1,6 @@
 #include "ring_queue.h"
 
+#include "core/katomic.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
 
@@ -83,3 +84,149 @@ b8 ring_queue_peek(const ring_queue* queue, void* out_value) {
     KERROR("ring_queue_peek requires valid pointers to queue and out_value.");
     return false;
 }
+
+// Rounds the capacity up to a power of 2, so positions can be wrapped with a mask.
+static u32 lock_free_capacity_get(u32 capacity) {
+    u32 result = 1;
+    while (result < capacity) {
+        result <<= 1;
+    }
+    return result;
+}
+
+b8 spsc_ring_queue_create(u32 stride, u32 capacity, spsc_ring_queue* out_queue) {
+    if (!out_queue || !stride || !capacity || capacity > 0x80000000u) {
+        KERROR("spsc_ring_queue_create requires a valid pointer to hold the queue, a stride, and a capacity of up to 2^31.");
+        return false;
+    }
+
+    kzero_memory(out_queue, sizeof(spsc_ring_queue));
+    capacity = lock_free_capacity_get(capacity);
+    out_queue->stride = stride;
+    out_queue->mask = capacity - 1;
+    out_queue->block = kallocate((u64)capacity * stride, MEMORY_TAG_RING_QUEUE);
+    return true;
+}
+
+void spsc_ring_queue_destroy(spsc_ring_queue* queue) {
+    if (queue && queue->block) {
+        kfree(queue->block, (u64)(queue->mask + 1) * queue->stride, MEMORY_TAG_RING_QUEUE);
+        kzero_memory(queue, sizeof(spsc_ring_queue));
+    }
+}
+
+b8 spsc_ring_queue_enqueue(spsc_ring_queue* queue, const void* value) {
+    u64 tail = queue->tail;
+    if (tail - queue->cached_head > queue->mask) {
+        // Looks full, so see how far the consumer has got.
+        queue->cached_head = katomic_load_u64(&queue->head, KATOMIC_ORDER_ACQUIRE);
+        if (tail - queue->cached_head > queue->mask) {
+            return false;
+        }
+    }
+
+    kcopy_memory((u8*)queue->block + (tail & queue->mask) * queue->stride, value, queue->stride);
+    katomic_store_u64(&queue->tail, tail + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+b8 spsc_ring_queue_dequeue(spsc_ring_queue* queue, void* out_value) {
+    u64 head = queue->head;
+    if (head == queue->cached_tail) {
+        // Looks empty, so see how far the producer has got.
+        queue->cached_tail = katomic_load_u64(&queue->tail, KATOMIC_ORDER_ACQUIRE);
+        if (head == queue->cached_tail) {
+            return false;
+        }
+    }
+
+    kcopy_memory(out_value, (u8*)queue->block + (head & queue->mask) * queue->stride, queue->stride);
+    katomic_store_u64(&queue->head, head + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+b8 mpmc_ring_queue_create(u32 stride, u32 capacity, mpmc_ring_queue* out_queue) {
+    if (!out_queue || !stride || !capacity || capacity > 0x80000000u) {
+        KERROR("mpmc_ring_queue_create requires a valid pointer to hold the queue, a stride, and a capacity of up to 2^31.");
+        return false;
+    }
+
+    kzero_memory(out_queue, sizeof(mpmc_ring_queue));
+    capacity = lock_free_capacity_get(capacity);
+    out_queue->stride = stride;
+    out_queue->mask = capacity - 1;
+    out_queue->block = kallocate((u64)capacity * stride, MEMORY_TAG_RING_QUEUE);
+    out_queue->sequences = kallocate(sizeof(u64) * capacity, MEMORY_TAG_RING_QUEUE);
+    // Slot i is free for the producer claiming position i.
+    for (u32 i = 0; i < capacity; ++i) {
+        out_queue->sequences[i] = i;
+    }
+    return true;
+}
+
+void mpmc_ring_queue_destroy(mpmc_ring_queue* queue) {
+    if (queue && queue->block) {
+        u64 capacity = (u64)queue->mask + 1;
+        kfree(queue->block, capacity * queue->stride, MEMORY_TAG_RING_QUEUE);
+        kfree((void*)queue->sequences, sizeof(u64) * capacity, MEMORY_TAG_RING_QUEUE);
+        kzero_memory(queue, sizeof(mpmc_ring_queue));
+    }
+}
+
+b8 mpmc_ring_queue_enqueue(mpmc_ring_queue* queue, const void* value) {
+    u64 pos = katomic_load_u64(&queue->enqueue_pos, KATOMIC_ORDER_RELAXED);
+    volatile u64* sequence;
+    while (true) {
+        sequence = &queue->sequences[pos & queue->mask];
+        i64 diff = (i64)katomic_load_u64(sequence, KATOMIC_ORDER_ACQUIRE) - (i64)pos;
+        if (diff == 0) {
+            // The slot is free for this lap. Claim the position, or try again from wherever it has moved to.
+            if (katomic_compare_exchange_u64(&queue->enqueue_pos, &pos, pos + 1, KATOMIC_ORDER_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The slot still holds the value from the previous lap, so the queue is full.
+            return false;
+        } else {
+            // Another producer claimed this position first.
+            pos = katomic_load_u64(&queue->enqueue_pos, KATOMIC_ORDER_RELAXED);
+        }
+    }
+
+    kcopy_memory((u8*)queue->block + (pos & queue->mask) * queue->stride, value, queue->stride);
+    // Hand the slot to the consumer of this position.
+    katomic_store_u64(sequence, pos + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+b8 mpmc_ring_queue_dequeue(mpmc_ring_queue* queue, void* out_value) {
+    u64 pos = katomic_load_u64(&queue->dequeue_pos, KATOMIC_ORDER_RELAXED);
+    volatile u64* sequence;
+    while (true) {
+        sequence = &queue->sequences[pos & queue->mask];
+        i64 diff = (i64)katomic_load_u64(sequence, KATOMIC_ORDER_ACQUIRE) - (i64)(pos + 1);
+        if (diff == 0) {
+            // The slot has been filled for this position. Claim it, or try again from wherever it has moved to.
+            if (katomic_compare_exchange_u64(&queue->dequeue_pos, &pos, pos + 1, KATOMIC_ORDER_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Nothing has been written here yet, so the queue is empty.
+            return false;
+        } else {
+            // Another consumer claimed this position first.
+            pos = katomic_load_u64(&queue->dequeue_pos, KATOMIC_ORDER_RELAXED);
+        }
+    }
+
+    kcopy_memory(out_value, (u8*)queue->block + (pos & queue->mask) * queue->stride, queue->stride);
+    // Free the slot for the producer of the same position in the next lap.
+    katomic_store_u64(sequence, pos + queue->mask + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+u32 mpmc_ring_queue_length(mpmc_ring_queue* queue) {
+    u64 dequeue_pos = katomic_load_u64(&queue->dequeue_pos, KATOMIC_ORDER_ACQUIRE);
+    u64 enqueue_pos = katomic_load_u64(&queue->enqueue_pos, KATOMIC_ORDER_ACQUIRE);
+    return enqueue_pos > dequeue_pos ? (u32)(enqueue_pos - dequeue_pos) : 0;
+}
@@ -70,3 +70,131 @@ b8 ring_queue_dequeue(ring_queue* queue, void* out_value);
  * @return True if success; otherwise false.
  */
 b8 ring_queue_peek(const ring_queue* queue, void* out_value);
+
+/** @brief The size the indices of the lock-free queues are padded to, so producers and consumers don't share a cache line. */
+#define RING_QUEUE_CACHE_LINE_SIZE 64
+
+/**
+ * @brief A bounded, lock-free ring queue for exactly one producer thread and one consumer thread.
+ * Capacity is always a power of 2, so indices wrap with a mask.
+ */
+typedef struct spsc_ring_queue {
+    /** @brief The position of the next write. Only written by the producer. */
+    volatile u64 tail;
+    /** @brief The consumer's position as last seen by the producer, to avoid reading it on every enqueue. */
+    u64 cached_head;
+    u8 pad0[RING_QUEUE_CACHE_LINE_SIZE - sizeof(u64) * 2];
+    /** @brief The position of the next read. Only written by the consumer. */
+    volatile u64 head;
+    /** @brief The producer's position as last seen by the consumer, to avoid reading it on every dequeue. */
+    u64 cached_tail;
+    u8 pad1[RING_QUEUE_CACHE_LINE_SIZE - sizeof(u64) * 2];
+    /** @brief The size of each element in bytes. */
+    u32 stride;
+    /** @brief The capacity minus one, used to wrap positions into the block. */
+    u32 mask;
+    /** @brief The block of memory holding capacity elements. */
+    void* block;
+} spsc_ring_queue;
+
+/**
+ * @brief Creates a new single-producer, single-consumer queue.
+ *
+ * @param stride The size of each element in bytes.
+ * @param capacity The number of elements the queue can hold. Rounded up to the next power of 2.
+ * @param out_queue A pointer to hold the newly created queue.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 spsc_ring_queue_create(u32 stride, u32 capacity, spsc_ring_queue* out_queue);
+
+/**
+ * @brief Destroys the given queue and frees its memory. No other thread may be using it.
+ *
+ * @param queue A pointer to the queue to destroy.
+ */
+KAPI void spsc_ring_queue_destroy(spsc_ring_queue* queue);
+
+/**
+ * @brief Adds a copy of the value to the queue, if there is room. Only call from the producer thread.
+ *
+ * @param queue A pointer to the queue to add to.
+ * @param value A pointer to the value to be copied in.
+ * @returns True if the value was added; false if the queue was full.
+ */
+KAPI b8 spsc_ring_queue_enqueue(spsc_ring_queue* queue, const void* value);
+
+/**
+ * @brief Removes the oldest value from the queue, if any. Only call from the consumer thread.
+ *
+ * @param queue A pointer to the queue to remove from.
+ * @param out_value A pointer to hold the removed value.
+ * @returns True if a value was removed; false if the queue was empty.
+ */
+KAPI b8 spsc_ring_queue_dequeue(spsc_ring_queue* queue, void* out_value);
+
+/**
+ * @brief A bounded, lock-free ring queue which any number of threads may enqueue to and dequeue from
+ * at once. Each slot carries a sequence number which tells producers and consumers whether it is
+ * theirs to use in the current lap around the ring, so threads only contend on claiming positions.
+ * Capacity is always a power of 2, so indices wrap with a mask.
+ */
+typedef struct mpmc_ring_queue {
+    /** @brief The position the next producer will claim. */
+    volatile u64 enqueue_pos;
+    u8 pad0[RING_QUEUE_CACHE_LINE_SIZE - sizeof(u64)];
+    /** @brief The position the next consumer will claim. */
+    volatile u64 dequeue_pos;
+    u8 pad1[RING_QUEUE_CACHE_LINE_SIZE - sizeof(u64)];
+    /** @brief The size of each element in bytes. */
+    u32 stride;
+    /** @brief The capacity minus one, used to wrap positions into the block. */
+    u32 mask;
+    /** @brief The sequence number of each slot. */
+    volatile u64* sequences;
+    /** @brief The block of memory holding capacity elements. */
+    void* block;
+} mpmc_ring_queue;
+
+/**
+ * @brief Creates a new multi-producer, multi-consumer queue.
+ *
+ * @param stride The size of each element in bytes.
+ * @param capacity The number of elements the queue can hold. Rounded up to the next power of 2.
+ * @param out_queue A pointer to hold the newly created queue.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 mpmc_ring_queue_create(u32 stride, u32 capacity, mpmc_ring_queue* out_queue);
+
+/**
+ * @brief Destroys the given queue and frees its memory. No other thread may be using it.
+ *
+ * @param queue A pointer to the queue to destroy.
+ */
+KAPI void mpmc_ring_queue_destroy(mpmc_ring_queue* queue);
+
+/**
+ * @brief Adds a copy of the value to the queue, if there is room. Safe to call from any thread.
+ *
+ * @param queue A pointer to the queue to add to.
+ * @param value A pointer to the value to be copied in.
+ * @returns True if the value was added; false if the queue was full.
+ */
+KAPI b8 mpmc_ring_queue_enqueue(mpmc_ring_queue* queue, const void* value);
+
+/**
+ * @brief Removes the oldest value from the queue, if any. Safe to call from any thread.
+ *
+ * @param queue A pointer to the queue to remove from.
+ * @param out_value A pointer to hold the removed value.
+ * @returns True if a value was removed; false if the queue was empty.
+ */
+KAPI b8 mpmc_ring_queue_dequeue(mpmc_ring_queue* queue, void* out_value);
+
+/**
+ * @brief Returns the number of values in the queue. Only a snapshot while other threads are using it,
+ * suitable for a cheap check before a dequeue.
+ *
+ * @param queue A pointer to the queue.
+ * @returns The number of values in the queue.
+ */
+KAPI u32 mpmc_ring_queue_length(mpmc_ring_queue* queue);
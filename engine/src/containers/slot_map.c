@@ -0,0 +1,133 @@
+#include "slot_map.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+
+static slot_map_handle handle_create(u32 index, u32 generation) {
+    return ((u64)generation << 32) | index;
+}
+
+// Gets the slot a handle refers to, if its element still exists.
+static slot_map_slot* slot_get(const slot_map* map, slot_map_handle handle) {
+    u32 index = slot_map_handle_index(handle);
+    if (handle == SLOT_MAP_INVALID_HANDLE || index >= map->capacity) {
+        return 0;
+    }
+    slot_map_slot* slot = &map->slots[index];
+    if (slot->dense_index == INVALID_ID || slot->generation != (u32)(handle >> 32)) {
+        return 0;
+    }
+    return slot;
+}
+
+u64 slot_map_memory_requirement(u32 stride, u32 capacity) {
+    // Elements first, so they keep the alignment of the block. Sizes are rounded to keep the rest aligned.
+    u64 element_size = ((u64)stride * capacity + 7) & ~(u64)7;
+    u64 dense_size = ((u64)sizeof(u32) * capacity + 7) & ~(u64)7;
+    return element_size + dense_size + sizeof(slot_map_slot) * capacity;
+}
+
+b8 slot_map_create(u32 stride, u32 capacity, void* memory, slot_map* out_map) {
+    if (!out_map || !stride || !capacity || capacity == INVALID_ID) {
+        KERROR("slot_map_create requires a valid pointer to hold the map, a stride and a capacity.");
+        return false;
+    }
+
+    kzero_memory(out_map, sizeof(slot_map));
+    out_map->stride = stride;
+    out_map->capacity = capacity;
+
+    u64 requirement = slot_map_memory_requirement(stride, capacity);
+    out_map->owns_memory = memory == 0;
+    if (!memory) {
+        memory = kallocate(requirement, MEMORY_TAG_ARRAY);
+    } else {
+        kzero_memory(memory, requirement);
+    }
+
+    u64 element_size = ((u64)stride * capacity + 7) & ~(u64)7;
+    u64 dense_size = ((u64)sizeof(u32) * capacity + 7) & ~(u64)7;
+    out_map->elements = memory;
+    out_map->dense = (u32*)((u8*)memory + element_size);
+    out_map->slots = (slot_map_slot*)((u8*)memory + element_size + dense_size);
+
+    // Link every slot into the free list, in order, so the lowest slots are used first.
+    for (u32 i = 0; i < capacity; ++i) {
+        out_map->slots[i].dense_index = INVALID_ID;
+        out_map->slots[i].next_free = i + 1 < capacity ? i + 1 : INVALID_ID;
+    }
+    out_map->free_head = 0;
+    return true;
+}
+
+void slot_map_destroy(slot_map* map) {
+    if (map) {
+        if (map->owns_memory && map->elements) {
+            kfree(map->elements, slot_map_memory_requirement(map->stride, map->capacity), MEMORY_TAG_ARRAY);
+        }
+        kzero_memory(map, sizeof(slot_map));
+    }
+}
+
+slot_map_handle slot_map_insert(slot_map* map, void** out_element) {
+    if (!map || map->free_head == INVALID_ID) {
+        return SLOT_MAP_INVALID_HANDLE;
+    }
+
+    u32 index = map->free_head;
+    slot_map_slot* slot = &map->slots[index];
+    map->free_head = slot->next_free;
+    slot->next_free = INVALID_ID;
+    slot->dense_index = map->count;
+    map->dense[map->count++] = index;
+
+    void* element = (u8*)map->elements + (u64)index * map->stride;
+    kzero_memory(element, map->stride);
+    if (out_element) {
+        *out_element = element;
+    }
+    return handle_create(index, slot->generation);
+}
+
+b8 slot_map_remove(slot_map* map, slot_map_handle handle) {
+    if (!map) {
+        return false;
+    }
+    slot_map_slot* slot = slot_get(map, handle);
+    if (!slot) {
+        return false;
+    }
+
+    // Keep the dense list packed by moving the last entry into the removed one's place.
+    u32 last = map->dense[--map->count];
+    map->dense[slot->dense_index] = last;
+    map->slots[last].dense_index = slot->dense_index;
+
+    u32 index = slot_map_handle_index(handle);
+    slot->dense_index = INVALID_ID;
+    slot->generation++;
+    slot->next_free = map->free_head;
+    map->free_head = index;
+    return true;
+}
+
+void* slot_map_get(const slot_map* map, slot_map_handle handle) {
+    if (!map || !slot_get(map, handle)) {
+        return 0;
+    }
+    return (u8*)map->elements + (u64)slot_map_handle_index(handle) * map->stride;
+}
+
+slot_map_handle slot_map_handle_get(const slot_map* map, u32 index) {
+    if (!map || index >= map->capacity || map->slots[index].dense_index == INVALID_ID) {
+        return SLOT_MAP_INVALID_HANDLE;
+    }
+    return handle_create(index, map->slots[index].generation);
+}
+
+void* slot_map_dense_get(const slot_map* map, u32 dense_index) {
+    if (!map || dense_index >= map->count) {
+        return 0;
+    }
+    return (u8*)map->elements + (u64)map->dense[dense_index] * map->stride;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file slot_map.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains a slot map, a fixed-capacity container which hands out generation-checked
+ * handles to its elements.
+ * @details Elements live in slots which never move, so pointers to them stay valid until they are
+ * removed, and the index of a slot can be used as a stable id. Free slots are kept on a list, so
+ * inserts and removes are O(1) rather than a search for a free slot. Each slot's generation is
+ * bumped when its element is removed, which makes any handle to the old element stale rather than
+ * silently referring to whatever occupies the slot next. A dense list of occupied slots is kept
+ * alongside, so the elements can be visited without walking every slot.
+ * @version 1.0
+ * @date 2023-12-03
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief A handle to an element of a slot map. The lower 32 bits hold the slot index, and the upper
+ * 32 bits the generation of the slot when the element was inserted.
+ */
+typedef u64 slot_map_handle;
+
+/** @brief A handle which never refers to an element. */
+#define SLOT_MAP_INVALID_HANDLE INVALID_ID_U64
+
+/** @brief The bookkeeping of a single slot. */
+typedef struct slot_map_slot {
+    /** @brief Incremented each time the slot's element is removed. */
+    u32 generation;
+    /** @brief The position of the slot in the dense list, or INVALID_ID if the slot is free. */
+    u32 dense_index;
+    /** @brief The next free slot, or INVALID_ID. Only meaningful while the slot is free. */
+    u32 next_free;
+} slot_map_slot;
+
+/** @brief A fixed-capacity slot map. */
+typedef struct slot_map {
+    /** @brief The size of each element in bytes. */
+    u32 stride;
+    /** @brief The number of slots. */
+    u32 capacity;
+    /** @brief The number of occupied slots. */
+    u32 count;
+    /** @brief The first free slot, or INVALID_ID if the map is full. */
+    u32 free_head;
+    /** @brief The bookkeeping of each slot. */
+    slot_map_slot* slots;
+    /** @brief The indices of the occupied slots, packed into the first count entries. */
+    u32* dense;
+    /** @brief The elements, indexed by slot. */
+    void* elements;
+    /** @brief Indicates if the map allocated its own memory. */
+    b8 owns_memory;
+} slot_map;
+
+/**
+ * @brief Gets the amount of memory required by a slot map of the given stride and capacity.
+ *
+ * @param stride The size of each element in bytes.
+ * @param capacity The number of slots.
+ * @returns The memory requirement in bytes.
+ */
+KAPI u64 slot_map_memory_requirement(u32 stride, u32 capacity);
+
+/**
+ * @brief Creates a slot map with every slot free.
+ *
+ * @param stride The size of each element in bytes.
+ * @param capacity The number of slots.
+ * @param memory A block of slot_map_memory_requirement bytes to hold the map, which must outlive it.
+ * If 0, a block is allocated and freed along with the map.
+ * @param out_map A pointer to hold the map.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 slot_map_create(u32 stride, u32 capacity, void* memory, slot_map* out_map);
+
+/**
+ * @brief Destroys the given slot map, freeing its memory if it allocated it.
+ *
+ * @param map A pointer to the map to be destroyed.
+ */
+KAPI void slot_map_destroy(slot_map* map);
+
+/**
+ * @brief Takes a free slot for a new element, which is zeroed.
+ *
+ * @param map A pointer to the map.
+ * @param out_element A pointer to hold a pointer to the new element. Optional.
+ * @returns A handle to the element, or SLOT_MAP_INVALID_HANDLE if the map is full.
+ */
+KAPI slot_map_handle slot_map_insert(slot_map* map, void** out_element);
+
+/**
+ * @brief Removes the element the handle refers to, freeing its slot and making every handle to it stale.
+ *
+ * @param map A pointer to the map.
+ * @param handle The handle of the element to be removed.
+ * @returns True if the element was removed; false if the handle was invalid or stale.
+ */
+KAPI b8 slot_map_remove(slot_map* map, slot_map_handle handle);
+
+/**
+ * @brief Gets the element the handle refers to.
+ *
+ * @param map A constant pointer to the map.
+ * @param handle The handle of the element.
+ * @returns A pointer to the element, or 0 if the handle is invalid or stale.
+ */
+KAPI void* slot_map_get(const slot_map* map, slot_map_handle handle);
+
+/**
+ * @brief Gets the handle of the element currently in the slot with the given index.
+ *
+ * @param map A constant pointer to the map.
+ * @param index The slot index.
+ * @returns The handle, or SLOT_MAP_INVALID_HANDLE if the slot is free or out of range.
+ */
+KAPI slot_map_handle slot_map_handle_get(const slot_map* map, u32 index);
+
+/**
+ * @brief Gets an element by its position in the dense list of occupied slots, for iteration.
+ * Positions run from 0 to count - 1, in no particular order, and change as elements are removed.
+ *
+ * @param map A constant pointer to the map.
+ * @param dense_index The position in the dense list.
+ * @returns A pointer to the element, or 0 if the position is out of range.
+ */
+KAPI void* slot_map_dense_get(const slot_map* map, u32 dense_index);
+
+/**
+ * @brief Gets the slot index of a handle, which stays the same for as long as the element exists.
+ *
+ * @param handle The handle.
+ * @returns The slot index.
+ */
+KINLINE u32 slot_map_handle_index(slot_map_handle handle) {
+    return (u32)(handle & 0xFFFFFFFF);
+}
@@ -3,7 +3,9 @@
 #include "asserts.h"
 
 #include "core/kstring.h"
+#include "core/logger.h"
 #include "containers/darray.h"
+#include "containers/hashmap.h"
 
 typedef struct console_consumer {
     PFN_console_consumer_write callback;
@@ -22,14 +24,20 @@ typedef struct console_state {
 
     // darray of registered commands.
     console_command* registered_commands;
+    // Indices into registered_commands, keyed by the case-insensitive hash of the command name.
+    hashmap command_lookup;
 } console_state;
 
 const u32 MAX_CONSUMER_COUNT = 10;
+#define MAX_COMMAND_COUNT 512
 
 static console_state* state_ptr;
 
 b8 console_initialize(u64* memory_requirement, void* memory, void* config) {
-    *memory_requirement = sizeof(console_state) + (sizeof(console_consumer) * MAX_CONSUMER_COUNT);
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), MAX_COMMAND_COUNT, &lookup_requirement, 0, 0);
+    u64 consumers_requirement = sizeof(console_consumer) * MAX_CONSUMER_COUNT;
+    *memory_requirement = sizeof(console_state) + consumers_requirement + lookup_requirement;
 
     if (!memory) {
         return true;
@@ -40,13 +48,23 @@ b8 console_initialize(u64* memory_requirement, void* memory, void* config) {
     state_ptr->consumers = (console_consumer*)((u64)memory + sizeof(console_state));
 
     state_ptr->registered_commands = darray_create(console_command);
+    void* lookup_block = (void*)((u64)memory + sizeof(console_state) + consumers_requirement);
+    if (!hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), MAX_COMMAND_COUNT, &lookup_requirement, lookup_block, &state_ptr->command_lookup)) {
+        KERROR("Failed to create console command lookup.");
+        return false;
+    }
 
     return true;
 }
 
 void console_shutdown(void* state) {
     if (state_ptr) {
+        u32 command_count = darray_length(state_ptr->registered_commands);
+        for (u32 i = 0; i < command_count; ++i) {
+            string_free((char*)state_ptr->registered_commands[i].name);
+        }
         darray_destroy(state_ptr->registered_commands);
+        hashmap_destroy(&state_ptr->command_lookup);
 
         kzero_memory(state, sizeof(console_state) + (sizeof(console_consumer) * MAX_CONSUMER_COUNT));
     }
@@ -88,16 +106,33 @@ void console_write_line(log_level level, const char* message) {
     }
 }
 
+// Finds the index of the registered command with the given name, or INVALID_ID if there is none.
+static u32 command_index_get(const char* name) {
+    u32 index = INVALID_ID;
+    if (!hashmap_get_u64(&state_ptr->command_lookup, hashmap_hash_stringi(name), &index)) {
+        return INVALID_ID;
+    }
+    // Guard against the (unlikely) case of two names with the same hash.
+    if (!strings_equali(state_ptr->registered_commands[index].name, name)) {
+        return INVALID_ID;
+    }
+    return index;
+}
+
 b8 console_command_register(const char* command, u8 arg_count, PFN_console_command func) {
     KASSERT_MSG(state_ptr && command, "console_register_command requires state and valid command");
 
     // Make sure it doesn't already exist.
-    u32 command_count = darray_length(state_ptr->registered_commands);
-    for (u32 i = 0; i < command_count; ++i) {
-        if (strings_equali(state_ptr->registered_commands[i].name, command)) {
-            KERROR("Command already registered: %s", command);
-            return false;
-        }
+    u64 hash = hashmap_hash_stringi(command);
+    if (hashmap_get_u64(&state_ptr->command_lookup, hash, 0)) {
+        KERROR("Command already registered: %s", command);
+        return false;
+    }
+
+    u32 index = darray_length(state_ptr->registered_commands);
+    if (!hashmap_set_u64(&state_ptr->command_lookup, hash, &index)) {
+        KERROR("Unable to register command '%s'; the maximum of %u commands has been reached.", command, MAX_COMMAND_COUNT);
+        return false;
     }
 
     console_command new_command = {};
@@ -112,18 +147,21 @@ b8 console_command_register(const char* command, u8 arg_count, PFN_console_comma
 b8 console_command_unregister(const char* command) {
     KASSERT_MSG(state_ptr && command, "console_update_command requires state and valid command");
 
-    // Make sure it doesn't already exist.
-    u32 command_count = darray_length(state_ptr->registered_commands);
-    for (u32 i = 0; i < command_count; ++i) {
-        if (strings_equali(state_ptr->registered_commands[i].name, command)) {
-            // Command found, remove it.
-            console_command popped_command;
-            darray_pop_at(state_ptr->registered_commands, i, &popped_command);
-            return true;
-        }
+    u32 index = command_index_get(command);
+    if (index == INVALID_ID) {
+        return false;
     }
 
-    return false;
+    // Command found, remove it. The last command takes its place, so only its index changes.
+    hashmap_remove_u64(&state_ptr->command_lookup, hashmap_hash_stringi(command));
+    string_free((char*)state_ptr->registered_commands[index].name);
+    u32 last = darray_length(state_ptr->registered_commands) - 1;
+    if (index != last) {
+        state_ptr->registered_commands[index] = state_ptr->registered_commands[last];
+        hashmap_set_u64(&state_ptr->command_lookup, hashmap_hash_stringi(state_ptr->registered_commands[index].name), &index);
+    }
+    darray_length_set(state_ptr->registered_commands, last);
+    return true;
 }
 
 b8 console_command_execute(const char* command) {
@@ -144,38 +182,34 @@ b8 console_command_execute(const char* command) {
     string_format(temp, "-->%s", command);
     console_write_line(LOG_LEVEL_INFO, temp);
 
-    // Yep, strings are slow. But it's a console. It doesn't need to be lightning fast...
     b8 has_error = false;
     b8 command_found = false;
-    u32 command_count = darray_length(state_ptr->registered_commands);
-    // Look through registered commands for a match.
-    for (u32 i = 0; i < command_count; ++i) {
-        console_command* cmd = &state_ptr->registered_commands[i];
-        if (strings_equali(cmd->name, parts[0])) {
-            command_found = true;
-            u8 arg_count = part_count - 1;
-            // Provided argument count must match expected number of arguments for the command.
-            if (state_ptr->registered_commands[i].arg_count != arg_count) {
-                KERROR("The console command '%s' requires %u arguments but %u were provided.", cmd->name, cmd->arg_count, arg_count);
-                has_error = true;
-            } else {
-                // Execute it, passing along arguments if needed.
-                console_command_context context = {};
-                context.argument_count = cmd->arg_count;
-                if (context.argument_count > 0) {
-                    context.arguments = kallocate(sizeof(console_command_argument) * cmd->arg_count, MEMORY_TAG_ARRAY);
-                    for (u8 j = 0; j < cmd->arg_count; ++j) {
-                        context.arguments[j].value = parts[j + 1];
-                    }
+    u32 index = command_index_get(parts[0]);
+    if (index != INVALID_ID) {
+        command_found = true;
+        // Copied, as the command may register others and move the array.
+        console_command cmd = state_ptr->registered_commands[index];
+        u8 arg_count = part_count - 1;
+        // Provided argument count must match expected number of arguments for the command.
+        if (cmd.arg_count != arg_count) {
+            KERROR("The console command '%s' requires %u arguments but %u were provided.", cmd.name, cmd.arg_count, arg_count);
+            has_error = true;
+        } else {
+            // Execute it, passing along arguments if needed.
+            console_command_context context = {};
+            context.argument_count = cmd.arg_count;
+            if (context.argument_count > 0) {
+                context.arguments = kallocate(sizeof(console_command_argument) * cmd.arg_count, MEMORY_TAG_ARRAY);
+                for (u8 j = 0; j < cmd.arg_count; ++j) {
+                    context.arguments[j].value = parts[j + 1];
                 }
+            }
 
-                cmd->func(context);
+            cmd.func(context);
 
-                if (context.arguments) {
-                    kfree(context.arguments, sizeof(console_command_argument) * cmd->arg_count, MEMORY_TAG_ARRAY);
-                }
+            if (context.arguments) {
+                kfree(context.arguments, sizeof(console_command_argument) * cmd.arg_count, MEMORY_TAG_ARRAY);
             }
-            break;
         }
     }
 
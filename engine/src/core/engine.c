@@ -3,25 +3,57 @@
 #include "application_types.h"
 #include "containers/darray.h"
 #include "core/kclock.h"
+#include "core/kcondvar.h"
 #include "core/event.h"
 #include "core/frame_data.h"
 #include "core/input.h"
+#include "core/katomic.h"
 #include "core/kmemory.h"
+#include "core/kmutex.h"
+#include "core/kprofiler.h"
 #include "core/kstring.h"
+#include "core/kthread.h"
+#include "core/kvar.h"
 #include "core/logger.h"
 #include "core/metrics.h"
 #include "core/uuid.h"
 #include "memory/linear_allocator.h"
+#include "memory/scratch_allocator.h"
 #include "platform/platform.h"
 #include "renderer/renderer_frontend.h"
 
 // systems
 #include "core/systems_manager.h"
 
+// How much of each new measurement is blended into the pacer's running estimates.
+#define FRAME_PACER_SMOOTHING 0.1
+// The shortest stretch spun at the end of each wait, for waits to end on time despite scheduler jitter.
+#define FRAME_PACER_MIN_SPIN_SECONDS 0.0002
+// The fraction of the frame time estimate added when starting frames late, to absorb variation.
+#define FRAME_PACER_LATENCY_MARGIN 0.25
+
+// The background frame rate used when the application doesn't choose one.
+#define ENGINE_DEFAULT_BACKGROUND_FRAME_RATE 15
+// How long to wait on window events at a time while hidden. Events posted from elsewhere are dispatched in between.
+#define ENGINE_HIDDEN_WAIT_SECONDS 0.1
+
+typedef struct frame_pacer {
+    // The time by which the current frame should be done. 0 while the frame rate is not limited.
+    f64 deadline;
+    // How late sleeps wake past the time asked for, smoothed. Waits wake this much early and spin the rest.
+    f64 wake_latency;
+    // How long frames take from start to finish, smoothed. Used to start frames late in low-latency mode.
+    f64 frame_time;
+} frame_pacer;
+
 typedef struct engine_state_t {
     application* game_inst;
     b8 is_running;
     b8 is_suspended;
+    // The window's state, as last reported by the platform layer. Frames are throttled in the background
+    // and skipped while hidden.
+    b8 is_focused;
+    b8 is_visible;
     i16 width;
     i16 height;
     kclock clock;
@@ -35,37 +67,176 @@ typedef struct engine_state_t {
 
     systems_manager_state sys_manager_state;
 
-    // An allocator used for per-frame allocations, that is reset every frame.
-    linear_allocator frame_allocator;
-
-    frame_data p_frame_data;
+    // Fixed-rate updates only. The seconds of simulation time not yet covered by an update.
+    f64 update_accumulator;
+
+    frame_pacer pacer;
+    kvar_handle max_fps_kvar;
+    kvar_handle low_latency_kvar;
+    kvar_handle background_max_fps_kvar;
+
+    // Arenas used for per-frame allocations. One is reset at the start of each frame, in turn,
+    // so allocations live for FRAME_ALLOCATOR_BUFFER_COUNT frames.
+    linear_allocator frame_allocators[FRAME_ALLOCATOR_BUFFER_COUNT];
+    // Incremented each frame. The current arena is the generation modulo the arena count.
+    volatile u64 frame_allocator_generation;
+
+    // Double-buffered when frames are pipelined: the main thread updates and prepares one while the
+    // render thread renders the other. Otherwise only the first is used.
+    frame_data frames[2];
+    // The index of the frame data currently being updated by the main thread.
+    u8 frame_index;
+
+    // Pipelined frames only.
+    b8 pipelined;
+    kthread render_thread;
+    kmutex render_mutex;
+    kcondvar render_condvar;
+    // The frame handed to the render thread, or 0 once it has been rendered.
+    frame_data* render_pending;
+    // The result of the last rendered frame.
+    b8 render_result;
+    // The time the last rendered frame took, in seconds, or negative once recorded.
+    f64 render_elapsed;
+    b8 render_thread_quit;
 } engine_state_t;
 
 static engine_state_t* engine_state;
 
 // frame allocator functions.
+
+// Threads take chunks of this size from the current arena, and then allocate from the chunk
+// without touching shared state.
+#define FRAME_ALLOCATOR_THREAD_CHUNK_SIZE KIBIBYTES(64)
+
+typedef struct frame_allocator_thread_chunk {
+    // The generation the chunk was taken in. Stale once it no longer matches.
+    u64 generation;
+    u8* next;
+    u8* end;
+} frame_allocator_thread_chunk;
+
+static _Thread_local frame_allocator_thread_chunk thread_chunk;
+
+// Allocates from the given arena. Safe to call from any thread.
+static void* frame_arena_allocate(linear_allocator* arena, u64 size) {
+    u64 offset = katomic_fetch_add_u64((volatile u64*)&arena->allocated, size, KATOMIC_ORDER_RELAXED);
+    if (offset + size > arena->total_size) {
+        u64 remaining = offset < arena->total_size ? arena->total_size - offset : 0;
+        KERROR("frame_allocator_allocate - Tried to allocate %lluB, only %lluB remaining.", size, remaining);
+        return 0;
+    }
+    // The arena commits its pages as allocations first reach them.
+    if (!linear_allocator_commit(arena, offset + size)) {
+        return 0;
+    }
+    return (u8*)arena->memory + offset;
+}
+
 static void* frame_allocator_allocate(u64 size) {
     if (!engine_state) {
         return 0;
     }
 
-    return linear_allocator_allocate(&engine_state->frame_allocator, size);
+    // Keep allocations 8-byte aligned.
+    size = (size + 7) & ~(u64)7;
+
+    u64 generation = katomic_load_u64(&engine_state->frame_allocator_generation, KATOMIC_ORDER_ACQUIRE);
+    linear_allocator* arena = &engine_state->frame_allocators[generation % FRAME_ALLOCATOR_BUFFER_COUNT];
+
+    // Large allocations go straight to the arena rather than wasting most of a chunk.
+    if (size > FRAME_ALLOCATOR_THREAD_CHUNK_SIZE / 4) {
+        return frame_arena_allocate(arena, size);
+    }
+
+    if (thread_chunk.generation != generation || thread_chunk.next + size > thread_chunk.end) {
+        u8* chunk = frame_arena_allocate(arena, FRAME_ALLOCATOR_THREAD_CHUNK_SIZE);
+        if (!chunk) {
+            return 0;
+        }
+        thread_chunk.generation = generation;
+        thread_chunk.next = chunk;
+        thread_chunk.end = chunk + FRAME_ALLOCATOR_THREAD_CHUNK_SIZE;
+    }
+
+    void* block = thread_chunk.next;
+    thread_chunk.next += size;
+    return block;
 }
 static void frame_allocator_free(void* block, u64 size) {
-    // NOTE: Linear allocator doesn't free, so this is a no-op
-    /* if (engine_state) {
-    } */
+    // NOTE: Linear allocator doesn't free, except for the latest allocation from this thread's chunk,
+    // which can simply be handed back.
+    if (engine_state && block) {
+        size = (size + 7) & ~(u64)7;
+        u64 generation = katomic_load_u64(&engine_state->frame_allocator_generation, KATOMIC_ORDER_ACQUIRE);
+        if (thread_chunk.generation == generation && (u8*)block + size == thread_chunk.next) {
+            thread_chunk.next = block;
+        }
+    }
+}
+
+static b8 frame_allocator_grow(void* block, u64 size, u64 new_size) {
+    if (!engine_state || !block) {
+        return false;
+    }
+
+    size = (size + 7) & ~(u64)7;
+    new_size = (new_size + 7) & ~(u64)7;
+    if (new_size <= size) {
+        return true;
+    }
+
+    u64 generation = katomic_load_u64(&engine_state->frame_allocator_generation, KATOMIC_ORDER_ACQUIRE);
+
+    // The latest allocation from this thread's chunk can take up the rest of the chunk.
+    if (thread_chunk.generation == generation && (u8*)block + size == thread_chunk.next && (u8*)block + new_size <= thread_chunk.end) {
+        thread_chunk.next = (u8*)block + new_size;
+        return true;
+    }
+
+    // Otherwise, the block can only grow if it ends where the arena does. This covers large allocations,
+    // as well as blocks at the end of a chunk which is itself the latest taken from the arena.
+    linear_allocator* arena = &engine_state->frame_allocators[generation % FRAME_ALLOCATOR_BUFFER_COUNT];
+    u8* base = arena->memory;
+    if ((u8*)block < base || (u8*)block + size > base + arena->total_size) {
+        return false;
+    }
+    u64 expected = (u64)((u8*)block - base) + size;
+    u64 desired = expected + (new_size - size);
+    if (desired > arena->total_size) {
+        return false;
+    }
+    if (!katomic_compare_exchange_u64((volatile u64*)&arena->allocated, &expected, desired, KATOMIC_ORDER_RELAXED)) {
+        return false;
+    }
+    if (!linear_allocator_commit(arena, desired)) {
+        // Nothing can have been allocated after the block, so the growth can be handed back.
+        katomic_compare_exchange_u64((volatile u64*)&arena->allocated, &desired, expected, KATOMIC_ORDER_RELAXED);
+        return false;
+    }
+
+    // If the block ended this thread's chunk, the chunk ends with it now.
+    if (thread_chunk.generation == generation && (u8*)block + size == thread_chunk.end) {
+        thread_chunk.end = (u8*)block + new_size;
+        thread_chunk.next = thread_chunk.end;
+    }
+    return true;
 }
 static void frame_allocator_free_all(void) {
     if (engine_state) {
+        // Move on to the next arena, which was last used FRAME_ALLOCATOR_BUFFER_COUNT - 1 frames ago.
+        // The older arenas are left alone, since their data may still be in use.
+        u64 generation = engine_state->frame_allocator_generation + 1;
         // Don't wipe the memory each time, to save on performance.
-        linear_allocator_free_all(&engine_state->frame_allocator, false);
+        linear_allocator_free_all(&engine_state->frame_allocators[generation % FRAME_ALLOCATOR_BUFFER_COUNT], false);
+        katomic_store_u64(&engine_state->frame_allocator_generation, generation, KATOMIC_ORDER_RELEASE);
     }
 }
 
 // Event handlers
 static b8 engine_on_event(u16 code, void* sender, void* listener_inst, event_context context);
 static b8 engine_on_resized(u16 code, void* sender, void* listener_inst, event_context context);
+static b8 engine_on_window_state_changed(u16 code, void* sender, void* listener_inst, event_context context);
 
 b8 engine_create(application* game_inst) {
     if (game_inst->engine_state) {
@@ -76,6 +247,7 @@ b8 engine_create(application* game_inst) {
     // Memory system must be the first thing to be stood up.
     memory_system_configuration memory_system_config = {};
     memory_system_config.total_alloc_size = GIBIBYTES(2);
+    memory_system_config.large_pages = game_inst->app_config.large_pages;
     if (!memory_system_initialize(memory_system_config)) {
         KERROR("Failed to initialize memory system; shutting down.");
         return false;
@@ -94,6 +266,8 @@ b8 engine_create(application* game_inst) {
     engine_state->game_inst = game_inst;
     engine_state->is_running = false;
     engine_state->is_suspended = false;
+    engine_state->is_focused = true;
+    engine_state->is_visible = true;
     engine_state->resizing = false;
     engine_state->frames_since_resize = 0;
 
@@ -105,6 +279,12 @@ b8 engine_create(application* game_inst) {
         return false;
     }
 
+    // Profiler and metrics commands, now that the console is available.
+    kprofiler_initialize();
+    kmutex_stats_initialize();
+    metrics_console_commands_register();
+    kmemory_console_commands_register();
+
     // Perform the game's boot sequence.
     game_inst->stage = APPLICATION_STAGE_BOOTING;
     if (!game_inst->boot(game_inst)) {
@@ -112,17 +292,37 @@ b8 engine_create(application* game_inst) {
         return false;
     }
 
-    // Setup the frame allocator.
-    linear_allocator_create(game_inst->app_config.frame_allocator_size, 0, &engine_state->frame_allocator);
-    engine_state->p_frame_data.allocator.allocate = frame_allocator_allocate;
-    engine_state->p_frame_data.allocator.free = frame_allocator_free;
-    engine_state->p_frame_data.allocator.free_all = frame_allocator_free_all;
-
-    // Allocate for the application's frame data.
-    if (game_inst->app_config.app_frame_data_size > 0) {
-        engine_state->p_frame_data.application_frame_data = kallocate(game_inst->app_config.app_frame_data_size, MEMORY_TAG_GAME);
-    } else {
-        engine_state->p_frame_data.application_frame_data = 0;
+    // Setup the frame allocator. The size is only reserved, and memory committed as frames use it.
+    for (u32 i = 0; i < FRAME_ALLOCATOR_BUFFER_COUNT; ++i) {
+        if (!linear_allocator_create_reserved(game_inst->app_config.frame_allocator_size, game_inst->app_config.large_pages, &engine_state->frame_allocators[i])) {
+            KFATAL("Failed to reserve the frame allocator; aborting application.");
+            return false;
+        }
+    }
+    if (game_inst->app_config.large_pages) {
+        if (engine_state->frame_allocators[0].large_pages) {
+            KINFO("Frame allocator is backed by large pages.");
+        } else {
+            KWARN("Large pages were requested for the frame allocator but not granted; using normal pages.");
+        }
+    }
+    engine_state->frame_allocator_generation = 0;
+    engine_state->pipelined = game_inst->app_config.pipelined_frames;
+    engine_state->frame_index = 0;
+    u32 frame_data_count = engine_state->pipelined ? 2 : 1;
+    for (u32 i = 0; i < frame_data_count; ++i) {
+        frame_data* f = &engine_state->frames[i];
+        f->allocator.allocate = frame_allocator_allocate;
+        f->allocator.free = frame_allocator_free;
+        f->allocator.free_all = frame_allocator_free_all;
+        f->allocator.grow = frame_allocator_grow;
+
+        // Allocate for the application's frame data.
+        if (game_inst->app_config.app_frame_data_size > 0) {
+            f->application_frame_data = kallocate(game_inst->app_config.app_frame_data_size, MEMORY_TAG_GAME);
+        } else {
+            f->application_frame_data = 0;
+        }
     }
 
     game_inst->stage = APPLICATION_STAGE_BOOT_COMPLETE;
@@ -143,43 +343,297 @@ b8 engine_create(application* game_inst) {
     return true;
 }
 
+// Sleeps for most of the time until the given absolute time, then spins for the rest.
+static void frame_pacer_wait_until(frame_pacer* pacer, f64 time) {
+    KPROFILE_SCOPE("frame_pacer_wait");
+    f64 now = platform_get_absolute_time();
+    f64 sleep_seconds = time - now - pacer->wake_latency - FRAME_PACER_MIN_SPIN_SECONDS;
+    if (sleep_seconds > 0) {
+        platform_sleep_precise(sleep_seconds);
+        f64 woken = platform_get_absolute_time();
+        f64 late = KMAX((woken - now) - sleep_seconds, 0.0);
+        pacer->wake_latency += (late - pacer->wake_latency) * FRAME_PACER_SMOOTHING;
+        now = woken;
+    }
+    while (now < time) {
+        now = platform_get_absolute_time();
+    }
+}
+
+// Called at the top of each frame. In low-latency mode, waits to start the frame as late as it can
+// while still finishing by its deadline.
+static void frame_pacer_frame_begin(frame_pacer* pacer, f64 period, b8 low_latency) {
+    if (period <= 0) {
+        pacer->deadline = 0;
+        return;
+    }
+    if (!pacer->deadline) {
+        pacer->deadline = platform_get_absolute_time() + period;
+        return;
+    }
+    if (low_latency) {
+        f64 lead = KMIN(pacer->frame_time * (1.0 + FRAME_PACER_LATENCY_MARGIN), period);
+        frame_pacer_wait_until(pacer, pacer->deadline - lead);
+    }
+}
+
+// Called once a frame is done, having started at the given time. Outside of low-latency mode,
+// waits out the rest of the frame. Then moves on to the next deadline.
+static void frame_pacer_frame_end(frame_pacer* pacer, f64 period, b8 low_latency, f64 frame_start_time) {
+    if (period <= 0 || !pacer->deadline) {
+        return;
+    }
+    f64 now = platform_get_absolute_time();
+    pacer->frame_time += ((now - frame_start_time) - pacer->frame_time) * FRAME_PACER_SMOOTHING;
+    if (!low_latency) {
+        frame_pacer_wait_until(pacer, pacer->deadline);
+        now = platform_get_absolute_time();
+    }
+
+    // Deadlines follow on from each other to keep a steady cadence. A frame finishing more than a
+    // frame late restarts the cadence though, rather than rushing the following frames to catch up.
+    pacer->deadline += period;
+    if (pacer->deadline < now) {
+        pacer->deadline = now + period;
+    }
+}
+
+// Renders the frames handed over by the main thread, one at a time, until told to quit.
+static u32 engine_render_thread_run(void* params) {
+    const kthread_affinity* affinity = &engine_state->sys_manager_state.render_thread_affinity;
+    if (affinity->processor_count && !kthread_affinity_set_current(affinity)) {
+        KWARN("The render thread could not be pinned to its core, and will run on any.");
+    }
+
+    kmutex_lock(&engine_state->render_mutex);
+    while (true) {
+        while (!engine_state->render_pending && !engine_state->render_thread_quit) {
+            kcondvar_wait(&engine_state->render_condvar, &engine_state->render_mutex);
+        }
+        if (!engine_state->render_pending) {
+            break;
+        }
+        frame_data* p_frame_data = engine_state->render_pending;
+        kmutex_unlock(&engine_state->render_mutex);
+
+        KPROFILE_BEGIN("game_render_frame");
+        f64 start = platform_get_absolute_time();
+        b8 result = engine_state->game_inst->render_frame(engine_state->game_inst, p_frame_data);
+        f64 elapsed = platform_get_absolute_time() - start;
+        KPROFILE_END();
+
+        kmutex_lock(&engine_state->render_mutex);
+        engine_state->render_result = result;
+        engine_state->render_elapsed = elapsed;
+        engine_state->render_pending = 0;
+        kcondvar_broadcast(&engine_state->render_condvar);
+    }
+    kmutex_unlock(&engine_state->render_mutex);
+    return 0;
+}
+
+static b8 engine_render_thread_start(void) {
+    engine_state->render_pending = 0;
+    engine_state->render_result = true;
+    engine_state->render_elapsed = -1;
+    engine_state->render_thread_quit = false;
+    if (!kmutex_create(&engine_state->render_mutex) || !kcondvar_create(&engine_state->render_condvar)) {
+        KERROR("Failed to create the render thread's synchronization objects.");
+        return false;
+    }
+    kmutex_name_set(&engine_state->render_mutex, "render thread");
+    if (!kthread_create(engine_render_thread_run, 0, false, &engine_state->render_thread)) {
+        KERROR("Failed to create the render thread.");
+        return false;
+    }
+    return true;
+}
+
+// Blocks until the frame handed to the render thread, if any, has been rendered.
+// Returns the result of its render_frame.
+static b8 engine_render_wait(void) {
+    KPROFILE_SCOPE("render_wait");
+    kmutex_lock(&engine_state->render_mutex);
+    while (engine_state->render_pending) {
+        kcondvar_wait(&engine_state->render_condvar, &engine_state->render_mutex);
+    }
+    b8 result = engine_state->render_result;
+    engine_state->render_result = true;
+    // Recorded here rather than on the render thread, where it would race with the reset in metrics_update.
+    if (engine_state->render_elapsed >= 0) {
+        metrics_timer_record(METRICS_TIMER_RENDER, engine_state->render_elapsed);
+        engine_state->render_elapsed = -1;
+    }
+    kmutex_unlock(&engine_state->render_mutex);
+    return result;
+}
+
+static void engine_render_submit(frame_data* p_frame_data) {
+    kmutex_lock(&engine_state->render_mutex);
+    engine_state->render_pending = p_frame_data;
+    kcondvar_signal(&engine_state->render_condvar);
+    kmutex_unlock(&engine_state->render_mutex);
+}
+
+static void engine_render_thread_stop(void) {
+    engine_render_wait();
+    kmutex_lock(&engine_state->render_mutex);
+    engine_state->render_thread_quit = true;
+    kcondvar_signal(&engine_state->render_condvar);
+    kmutex_unlock(&engine_state->render_mutex);
+    kthread_wait(&engine_state->render_thread);
+    kthread_destroy(&engine_state->render_thread);
+    kcondvar_destroy(&engine_state->render_condvar);
+    kmutex_destroy(&engine_state->render_mutex);
+}
+
+// The most fixed updates run in one frame, when the application does not say.
+#define DEFAULT_MAX_UPDATE_STEPS 5
+
+static b8 engine_game_update(frame_data* p_frame_data) {
+    KPROFILE_BEGIN("game_update");
+    f64 start = platform_get_absolute_time();
+    application* game_inst = engine_state->game_inst;
+    b8 result = true;
+
+    u16 rate = game_inst->app_config.fixed_update_rate;
+    if (!rate) {
+        p_frame_data->interpolation_alpha = 1.0f;
+        p_frame_data->update_step_count = 1;
+        result = game_inst->update(game_inst, p_frame_data);
+    } else {
+        f64 step = 1.0 / rate;
+        u8 max_steps = game_inst->app_config.max_update_steps ? game_inst->app_config.max_update_steps : DEFAULT_MAX_UPDATE_STEPS;
+        engine_state->update_accumulator += p_frame_data->delta_time;
+
+        // Each update sees the fixed step, rather than the frame time.
+        f32 frame_delta = p_frame_data->delta_time;
+        p_frame_data->delta_time = (f32)step;
+        p_frame_data->update_step_count = 0;
+        while (result && engine_state->update_accumulator >= step && p_frame_data->update_step_count < max_steps) {
+            result = game_inst->update(game_inst, p_frame_data);
+            engine_state->update_accumulator -= step;
+            p_frame_data->update_step_count++;
+        }
+        p_frame_data->delta_time = frame_delta;
+
+        // Drop the whole steps which could not be caught up on, keeping the fraction of a step left over.
+        if (engine_state->update_accumulator >= step) {
+            engine_state->update_accumulator -= step * (u64)(engine_state->update_accumulator / step);
+        }
+        p_frame_data->interpolation_alpha = (f32)(engine_state->update_accumulator / step);
+    }
+
+    metrics_timer_record(METRICS_TIMER_UPDATE, platform_get_absolute_time() - start);
+    KPROFILE_END();
+    if (!result) {
+        KFATAL("Game update failed, shutting down.");
+    }
+    return result;
+}
+
 b8 engine_run(application* game_inst) {
     game_inst->stage = APPLICATION_STAGE_RUNNING;
     engine_state->is_running = true;
     kclock_start(&engine_state->clock);
     kclock_update(&engine_state->clock);
     engine_state->last_time = engine_state->clock.elapsed;
-    // f64 running_time = 0;
-    // TODO: frame rate lock
-    // u8 frame_count = 0;
-    f64 target_frame_seconds = 1.0f / 60;
     f64 frame_elapsed_time = 0;
 
+    // The frame rate limit may be changed at runtime.
+    kzero_memory(&engine_state->pacer, sizeof(frame_pacer));
+    engine_state->update_accumulator = 0;
+    kvar_int_create("max_fps", game_inst->app_config.target_frame_rate);
+    kvar_int_create("low_latency", game_inst->app_config.low_latency_mode ? 1 : 0);
+    engine_state->max_fps_kvar = kvar_handle_get("max_fps");
+    engine_state->low_latency_kvar = kvar_handle_get("low_latency");
+    u16 background_frame_rate = game_inst->app_config.background_frame_rate ? game_inst->app_config.background_frame_rate : ENGINE_DEFAULT_BACKGROUND_FRAME_RATE;
+    kvar_int_create("background_max_fps", background_frame_rate);
+    engine_state->background_max_fps_kvar = kvar_handle_get("background_max_fps");
+
     KINFO(get_memory_usage_str());
 
+    if (engine_state->pipelined) {
+        if (!engine_render_thread_start()) {
+            KWARN("Unable to pipeline frames, falling back to rendering on the main thread.");
+            engine_state->pipelined = false;
+            engine_state->frame_index = 0;
+        } else {
+            KINFO("Pipelined frames enabled: frames render on a separate thread.");
+        }
+    }
+
     while (engine_state->is_running) {
-        if (!platform_pump_messages()) {
+        // Marked at the top of the loop, as frames may end early.
+        KPROFILE_FRAME_MARK();
+        KPROFILE_SCOPE("engine_frame");
+
+        // Nothing is drawn while minimized or hidden, so rather than spinning, wait for the window to change.
+        b8 is_idle = engine_state->is_suspended || !engine_state->is_visible;
+
+        i32 max_fps = kvar_int_value(engine_state->max_fps_kvar, 0);
+        f64 frame_period = (max_fps > 0 && !is_idle) ? 1.0 / max_fps : 0;
+        // In the background, the lower of the two limits applies.
+        i32 background_max_fps = kvar_int_value(engine_state->background_max_fps_kvar, 0);
+        if (!engine_state->is_focused && !is_idle && background_max_fps > 0) {
+            frame_period = KMAX(frame_period, 1.0 / background_max_fps);
+        }
+        b8 low_latency = kvar_int_value(engine_state->low_latency_kvar, 0) != 0;
+
+        // Done before anything is sampled, as in low-latency mode this may wait.
+        frame_pacer_frame_begin(&engine_state->pacer, frame_period, low_latency);
+        f64 frame_start_time = platform_get_absolute_time();
+
+        if (!platform_pump_messages(is_idle ? ENGINE_HIDDEN_WAIT_SECONDS : 0)) {
             engine_state->is_running = false;
         }
 
-        if (!engine_state->is_suspended) {
+        // Apply the gamepad changes sampled since the last frame.
+        input_process_gamepads();
+
+        // Fire the events posted since the last frame, including from other threads.
+        event_dispatch_posted();
+
+        // Window state changes were only just dispatched, so check again.
+        if (!engine_state->is_suspended && engine_state->is_visible) {
+            frame_data* p_frame_data = &engine_state->frames[engine_state->frame_index];
+
             // Update clock and get delta time.
             kclock_update(&engine_state->clock);
             f64 current_time = engine_state->clock.elapsed;
             f64 delta = (current_time - engine_state->last_time);
-            f64 frame_start_time = platform_get_absolute_time();
-
-            engine_state->p_frame_data.total_time = current_time;
-            engine_state->p_frame_data.delta_time = (f32)delta;
 
-            // Reset the frame allocator
-            engine_state->p_frame_data.allocator.free_all();
+            p_frame_data->total_time = current_time;
+            p_frame_data->delta_time = (f32)delta;
 
-            // Update systems.
-            systems_manager_update(&engine_state->sys_manager_state, &engine_state->p_frame_data);
+            // Reset the frame allocator. Allocations made by the frame still rendering stay valid,
+            // since its arena is not reused for another FRAME_ALLOCATOR_BUFFER_COUNT - 1 frames.
+            p_frame_data->allocator.free_all();
 
-            // update metrics
+            // Update metrics first, so the timers recorded below are stored with this frame.
             metrics_update(frame_elapsed_time);
+            kmemory_frame_end();
+
+            if (engine_state->pipelined) {
+                // Update the game while the previous frame is rendered. Anything touching the renderer,
+                // the systems included, waits until that is done.
+                if (!engine_game_update(p_frame_data)) {
+                    engine_state->is_running = false;
+                    break;
+                }
+                if (!engine_render_wait()) {
+                    KFATAL("Game render failed, shutting down.");
+                    engine_state->is_running = false;
+                    break;
+                }
+            }
+
+            // Update systems.
+            KPROFILE_BEGIN("systems_update");
+            f64 section_start = platform_get_absolute_time();
+            systems_manager_update(&engine_state->sys_manager_state, p_frame_data);
+            metrics_timer_record(METRICS_TIMER_UPDATE, platform_get_absolute_time() - section_start);
+            KPROFILE_END();
 
             // Make sure the window is not currently being resized by waiting a designated
             // number of frames after the last resize operation before performing the backend updates.
@@ -192,7 +646,7 @@ b8 engine_run(application* game_inst) {
 
                     // NOTE: Don't bother checking the result of this, since this will likely
                     // recreate the swapchain and boot to the next frame anyway.
-                    renderer_frame_prepare(&engine_state->p_frame_data);
+                    renderer_frame_prepare(p_frame_data);
 
                     // Notify the application of the resize.
                     engine_state->game_inst->on_resize(engine_state->game_inst, engine_state->width, engine_state->height);
@@ -202,14 +656,14 @@ b8 engine_run(application* game_inst) {
                 } else {
                     // Skip rendering the frame and try again next time.
                     // NOTE: Simulate a frame being "drawn" at 60 FPS.
-                    platform_sleep(16);
+                    platform_sleep_precise(1.0 / 60);
                 }
 
                 // Either way, don't process this frame any further while resizing.
                 // Try again next frame.
                 continue;
             }
-            if (!renderer_frame_prepare(&engine_state->p_frame_data)) {
+            if (!renderer_frame_prepare(p_frame_data)) {
                 // This can also happen not just from a resize above, but also if a renderer flag
                 // (such as VSync) changed, which may also require resource recreation. To handle this,
                 // Notify the application of a resize event, which it can then pass on to its rendergraph(s)
@@ -218,55 +672,59 @@ b8 engine_run(application* game_inst) {
                 continue;
             }
 
-            if (!engine_state->game_inst->update(engine_state->game_inst, &engine_state->p_frame_data)) {
-                KFATAL("Game update failed, shutting down.");
+            if (!engine_state->pipelined && !engine_game_update(p_frame_data)) {
                 engine_state->is_running = false;
                 break;
             }
 
             // Have the application generate the render packet.
-            b8 prepare_result = engine_state->game_inst->prepare_frame(engine_state->game_inst, &engine_state->p_frame_data);
+            KPROFILE_BEGIN("game_prepare_frame");
+            section_start = platform_get_absolute_time();
+            b8 prepare_result = engine_state->game_inst->prepare_frame(engine_state->game_inst, p_frame_data);
+            metrics_timer_record(METRICS_TIMER_RENDER_PREPARE, platform_get_absolute_time() - section_start);
+            KPROFILE_END();
             if (!prepare_result) {
                 continue;
             }
 
-            // Call the game's render routine.
-            if (!engine_state->game_inst->render_frame(engine_state->game_inst, &engine_state->p_frame_data)) {
-                KFATAL("Game render failed, shutting down.");
-                engine_state->is_running = false;
-                break;
-            }
-
-            // Figure out how long the frame took and, if below
-            f64 frame_end_time = platform_get_absolute_time();
-            frame_elapsed_time = frame_end_time - frame_start_time;
-            // running_time += frame_elapsed_time;
-            f64 remaining_seconds = target_frame_seconds - frame_elapsed_time;
-
-            if (remaining_seconds > 0) {
-                u64 remaining_ms = (remaining_seconds * 1000);
-
-                // If there is time left, give it back to the OS.
-                b8 limit_frames = false;
-                if (remaining_ms > 0 && limit_frames) {
-                    platform_sleep(remaining_ms - 1);
+            if (engine_state->pipelined) {
+                // Hand the prepared frame to the render thread, and move on to the other frame data.
+                engine_render_submit(p_frame_data);
+                engine_state->frame_index ^= 1;
+            } else {
+                // Call the game's render routine.
+                KPROFILE_BEGIN("game_render_frame");
+                section_start = platform_get_absolute_time();
+                b8 render_result = engine_state->game_inst->render_frame(engine_state->game_inst, p_frame_data);
+                metrics_timer_record(METRICS_TIMER_RENDER, platform_get_absolute_time() - section_start);
+                KPROFILE_END();
+                if (!render_result) {
+                    KFATAL("Game render failed, shutting down.");
+                    engine_state->is_running = false;
+                    break;
                 }
-
-                // TODO: frame rate lock
-                // frame_count++;
             }
 
+            // Figure out how long the frame took, then give any time left before the next one back to the OS.
+            frame_elapsed_time = platform_get_absolute_time() - frame_start_time;
+            frame_pacer_frame_end(&engine_state->pacer, frame_period, low_latency, frame_start_time);
+
             // NOTE: Input update/state copying should always be handled
             // after any input should be recorded; I.E. before this line.
             // As a safety, input is the last thing to be updated before
             // this frame ends.
-            input_update(&engine_state->p_frame_data);
+            input_update(p_frame_data);
 
             // Update last time
             engine_state->last_time = current_time;
         }
     }
 
+    // Let the last frame finish rendering before anything is shut down.
+    if (engine_state->pipelined) {
+        engine_render_thread_stop();
+    }
+
     engine_state->is_running = false;
     game_inst->stage = APPLICATION_STAGE_SHUTTING_DOWN;
 
@@ -276,6 +734,15 @@ b8 engine_run(application* game_inst) {
     // Unregister from events.
     event_unregister(EVENT_CODE_APPLICATION_QUIT, 0, engine_on_event);
 
+    // Release the frame allocator arenas while the memory system is still around.
+    for (u32 i = 0; i < FRAME_ALLOCATOR_BUFFER_COUNT; ++i) {
+        linear_allocator_destroy(&engine_state->frame_allocators[i]);
+    }
+    scratch_thread_shutdown();
+
+    // Shut down the profiler while the filesystem and memory system are still around.
+    kprofiler_shutdown();
+
     // Shut down all systems.
     systems_manager_shutdown(&engine_state->sys_manager_state);
 
@@ -288,10 +755,13 @@ void engine_on_event_system_initialized(void) {
     // Register for engine-level events.
     event_register(EVENT_CODE_APPLICATION_QUIT, 0, engine_on_event);
     event_register(EVENT_CODE_RESIZED, 0, engine_on_resized);
+    event_register(EVENT_CODE_WINDOW_FOCUS_CHANGED, 0, engine_on_window_state_changed);
+    event_register(EVENT_CODE_WINDOW_VISIBILITY_CHANGED, 0, engine_on_window_state_changed);
 }
 
 const struct frame_data* engine_frame_data_get(struct application* game_inst) {
-    return &((engine_state_t*)game_inst->engine_state)->p_frame_data;
+    engine_state_t* state = game_inst->engine_state;
+    return &state->frames[state->frame_index];
 }
 
 systems_manager_state* engine_systems_manager_state_get(struct application* game_inst) {
@@ -344,3 +814,17 @@ static b8 engine_on_resized(u16 code, void* sender, void* listener_inst, event_c
     // Event purposely not handled to allow other listeners to get this.
     return false;
 }
+
+static b8 engine_on_window_state_changed(u16 code, void* sender, void* listener_inst, event_context context) {
+    b8 value = context.data.u8[0] != 0;
+    if (code == EVENT_CODE_WINDOW_FOCUS_CHANGED && value != engine_state->is_focused) {
+        engine_state->is_focused = value;
+        KDEBUG("Window %s focus.", value ? "gained" : "lost");
+    } else if (code == EVENT_CODE_WINDOW_VISIBILITY_CHANGED && value != engine_state->is_visible) {
+        engine_state->is_visible = value;
+        KINFO(value ? "Window shown, resuming rendering." : "Window hidden, rendering paused until it is shown again.");
+    }
+
+    // Event purposely not handled to allow other listeners to get this.
+    return false;
+}
@@ -52,11 +52,69 @@ typedef struct application_config {
     renderer_plugin renderer_plugin;
     audio_plugin audio_plugin;
 
-    /** @brief The size of the frame allocator. */
+    /** @brief The size of each of the frame allocator's arenas (one per buffered frame). */
     u64 frame_allocator_size;
 
+    /**
+     * @brief Backs the engine's heap and the frame allocator's arenas with large pages, where the
+     * system grants them, to cut down on TLB misses. Must be set before engine_create, as the heap
+     * is created there. Whether they were granted is logged, and for the heap, reported by
+     * kmemory_large_pages_get.
+     */
+    b8 large_pages;
+
     /** @brief The size of the application-specific frame data. Set to 0 if not used. */
     u64 app_frame_data_size;
+
+    /** @brief The number of frames the CPU may record ahead of the GPU (2 or 3). 0 uses the renderer default. */
+    u8 frames_in_flight;
+
+    /**
+     * @brief Runs the application's render_frame on a render thread, overlapping it with the next
+     * frame's update. Both halves are handed their own frame_data (and application frame data), so
+     * render_frame must only read what prepare_frame produced for that frame, and not state which
+     * update changes. prepare_frame still runs on the main thread, between the two.
+     */
+    b8 pipelined_frames;
+
+    /**
+     * @brief Runs jobs on fibers, so a job waiting on a counter yields its job thread to other
+     * work until the counter completes, rather than blocking it. A waiting job resumes on the
+     * thread it started on.
+     */
+    b8 job_fibers;
+
+    /** @brief The most frames per second to run at. 0 for no limit. Changed at runtime with the "max_fps" kvar. */
+    u16 target_frame_rate;
+
+    /**
+     * @brief The most frames per second to run at while the window is visible but not focused, so
+     * background windows don't use the CPU and GPU for frames nobody is watching. 0 uses a default of 15.
+     * Changed at runtime with the "background_max_fps" kvar, where 0 removes the limit. Nothing is
+     * drawn at all while the window is hidden; the engine only waits on window events.
+     */
+    u16 background_frame_rate;
+
+    /**
+     * @brief When the frame rate is limited, starts each frame as late as it can while still finishing
+     * on time, rather than on time, so input is sampled closer to presentation. Changed at runtime
+     * with the "low_latency" kvar.
+     */
+    b8 low_latency_mode;
+
+    /**
+     * @brief The rate the application's update runs at, in steps per second. When set, update is called
+     * as many times each frame as needed to keep up with the clock, each seeing this fixed step as its
+     * delta_time, and rendering interpolates using the frame data's interpolation_alpha. 0 updates once
+     * per frame with the frame's delta time.
+     */
+    u16 fixed_update_rate;
+
+    /**
+     * @brief The most fixed steps run in a single frame. Time beyond that is dropped rather than caught
+     * up on, so a slow frame cannot snowball. 0 uses a default of 5.
+     */
+    u8 max_update_steps;
 } application_config;
 
 /**
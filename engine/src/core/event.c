@@ -1,5 +1,6 @@
 #include "core/event.h"
 
+#include "core/katomic.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
 #include "containers/darray.h"
@@ -7,20 +8,81 @@
 
 typedef struct registered_event {
     void* listener;
+    // 0 once unregistered. Removed entries are compacted away later, keeping the order of the rest.
     PFN_on_event callback;
+    // The index of the handle referring to this entry.
+    u32 handle_index;
 } registered_event;
 
+// A code in the registry, owning a contiguous span of the listener pool.
 typedef struct event_code_entry {
-    registered_event* events;
+    u16 code;
+    b8 occupied;
+    // Indicates if posted events of this code are coalesced.
+    b8 coalesce;
+    // The span of the listener pool, including removed entries.
+    u32 first;
+    u32 count;
+    u32 capacity;
+    u32 removed_count;
+    // The queue position of the most recent event of this code being dispatched, if coalesced.
+    u64 latest_posted;
 } event_code_entry;
 
-// This should be more than enough codes...
-#define MAX_MESSAGE_CODES 16384
+typedef struct event_handle_entry {
+    // Incremented each time the handle is released, so stale handles are rejected.
+    u32 generation;
+    // The index of the listener in the pool, or INVALID_ID if free.
+    u32 pool_index;
+    u16 code;
+    // The next free handle, if free.
+    u32 next_free;
+} event_handle_entry;
+
+// The number of code slots the registry starts with. Must be a power of 2.
+#define EVENT_REGISTRY_INITIAL_CAPACITY 64
+// The number of listeners a code's span starts with.
+#define EVENT_SPAN_INITIAL_CAPACITY 4
+
+// The number of events which may be posted between dispatches. Must be a power of 2.
+#define POSTED_EVENT_QUEUE_CAPACITY 4096
+
+typedef struct posted_event {
+    // Equal to the position the entry may next be written at, or one past the position
+    // once written and ready to be dispatched.
+    volatile u64 sequence;
+    u16 code;
+    void* sender;
+    event_context context;
+} posted_event;
 
 // State structure.
 typedef struct event_system_state {
-    // Lookup table for event codes.
-    event_code_entry registered[MAX_MESSAGE_CODES];
+    // Open-addressing map of event codes to their listener spans. Only codes in use have a slot.
+    event_code_entry* codes;
+    u32 code_capacity;
+    u32 code_count;
+
+    // The listeners of every code, each code's in one contiguous span.
+    registered_event* listeners;
+    u32 listener_capacity;
+    // The end of the last span.
+    u32 listener_used;
+    // Pool entries left behind by spans which moved.
+    u32 listener_abandoned;
+
+    // darray of handles, with a free list through next_free.
+    event_handle_entry* handles;
+    u32 free_handle;
+
+    // The depth of event_fire calls. Listeners don't move within their span while firing.
+    u32 fire_depth;
+
+    // A bounded multi-producer, single-consumer queue of posted events. Any thread may
+    // post without locking, and only the main thread dispatches.
+    posted_event posted[POSTED_EVENT_QUEUE_CAPACITY];
+    volatile u64 post_pos;
+    u64 dispatch_pos;
 } event_system_state;
 
 /**
@@ -28,14 +90,207 @@ typedef struct event_system_state {
  */
 static event_system_state* state_ptr;
 
+static u32 code_hash(u16 code, u32 capacity) {
+    return (u32)(((u32)code * 2654435761U) & (capacity - 1));
+}
+
+static event_code_entry* code_find(u16 code) {
+    u32 index = code_hash(code, state_ptr->code_capacity);
+    for (;;) {
+        event_code_entry* entry = &state_ptr->codes[index];
+        if (!entry->occupied) {
+            return 0;
+        }
+        if (entry->code == code) {
+            return entry;
+        }
+        index = (index + 1) & (state_ptr->code_capacity - 1);
+    }
+}
+
+static event_code_entry* code_insert_slot(event_code_entry* codes, u32 capacity, u16 code) {
+    u32 index = code_hash(code, capacity);
+    while (codes[index].occupied && codes[index].code != code) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &codes[index];
+}
+
+// Finds the entry for the given code, adding it if it isn't in the registry yet.
+static event_code_entry* code_acquire(u16 code) {
+    event_code_entry* entry = code_find(code);
+    if (entry) {
+        return entry;
+    }
+
+    // Keep the load below 3/4 so probes stay short.
+    if ((state_ptr->code_count + 1) * 4 > state_ptr->code_capacity * 3) {
+        u32 new_capacity = state_ptr->code_capacity * 2;
+        event_code_entry* new_codes = kallocate(sizeof(event_code_entry) * new_capacity, MEMORY_TAG_ENGINE);
+        for (u32 i = 0; i < state_ptr->code_capacity; ++i) {
+            if (state_ptr->codes[i].occupied) {
+                *code_insert_slot(new_codes, new_capacity, state_ptr->codes[i].code) = state_ptr->codes[i];
+            }
+        }
+        kfree(state_ptr->codes, sizeof(event_code_entry) * state_ptr->code_capacity, MEMORY_TAG_ENGINE);
+        state_ptr->codes = new_codes;
+        state_ptr->code_capacity = new_capacity;
+    }
+
+    entry = code_insert_slot(state_ptr->codes, state_ptr->code_capacity, code);
+    kzero_memory(entry, sizeof(event_code_entry));
+    entry->code = code;
+    entry->occupied = true;
+    state_ptr->code_count++;
+    return entry;
+}
+
+// Moves the live listeners of a span to the given position, in order, updating their handles.
+static u32 span_move(event_code_entry* entry, u32 destination) {
+    u32 live = 0;
+    for (u32 i = 0; i < entry->count; ++i) {
+        registered_event e = state_ptr->listeners[entry->first + i];
+        if (e.callback) {
+            state_ptr->listeners[destination + live] = e;
+            state_ptr->handles[e.handle_index].pool_index = destination + live;
+            live++;
+        }
+    }
+    return live;
+}
+
+// Rebuilds the pool with every span packed together, dropping abandoned space and removed listeners.
+static void listeners_compact(u32 extra_capacity) {
+    u32 needed = state_ptr->listener_used - state_ptr->listener_abandoned + extra_capacity;
+    u32 new_capacity = KMAX(state_ptr->listener_capacity, 64);
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    registered_event* old_listeners = state_ptr->listeners;
+    u32 old_capacity = state_ptr->listener_capacity;
+    state_ptr->listeners = kallocate(sizeof(registered_event) * new_capacity, MEMORY_TAG_ENGINE);
+    state_ptr->listener_capacity = new_capacity;
+    state_ptr->listener_used = 0;
+    state_ptr->listener_abandoned = 0;
+
+    for (u32 i = 0; i < state_ptr->code_capacity; ++i) {
+        event_code_entry* entry = &state_ptr->codes[i];
+        if (!entry->occupied || !entry->capacity) {
+            continue;
+        }
+        u32 first = state_ptr->listener_used;
+        u32 live = 0;
+        for (u32 j = 0; j < entry->count; ++j) {
+            registered_event e = old_listeners[entry->first + j];
+            // Removed listeners are kept while firing so that positions don't shift.
+            if (e.callback || state_ptr->fire_depth) {
+                state_ptr->listeners[first + live] = e;
+                if (e.callback) {
+                    state_ptr->handles[e.handle_index].pool_index = first + live;
+                }
+                live++;
+            }
+        }
+        entry->first = first;
+        entry->count = live;
+        entry->removed_count = state_ptr->fire_depth ? entry->removed_count : 0;
+        entry->capacity = KMAX(live, EVENT_SPAN_INITIAL_CAPACITY);
+        state_ptr->listener_used += entry->capacity;
+    }
+
+    if (old_listeners) {
+        kfree(old_listeners, sizeof(registered_event) * old_capacity, MEMORY_TAG_ENGINE);
+    }
+}
+
+// Makes room for one more listener at the end of the given code's span.
+static void span_reserve(u16 code) {
+    event_code_entry* entry = code_find(code);
+    if (entry->count < entry->capacity) {
+        return;
+    }
+
+    // Removed listeners can be squeezed out, unless firing, where positions must hold.
+    if (entry->removed_count && !state_ptr->fire_depth) {
+        entry->count = span_move(entry, entry->first);
+        entry->removed_count = 0;
+        return;
+    }
+
+    // Otherwise, move the span to the end of the pool with room to grow.
+    u32 new_capacity = KMAX(entry->capacity * 2, EVENT_SPAN_INITIAL_CAPACITY);
+    if (state_ptr->listener_used + new_capacity > state_ptr->listener_capacity) {
+        if (state_ptr->listener_abandoned * 2 > state_ptr->listener_used) {
+            // Mostly abandoned space, so pack everything.
+            listeners_compact(new_capacity);
+            entry = code_find(code);
+            if (entry->count < entry->capacity) {
+                return;
+            }
+        } else {
+            u32 grown_capacity = KMAX(state_ptr->listener_capacity * 2, 64);
+            while (grown_capacity < state_ptr->listener_used + new_capacity) {
+                grown_capacity *= 2;
+            }
+            registered_event* grown = kallocate(sizeof(registered_event) * grown_capacity, MEMORY_TAG_ENGINE);
+            if (state_ptr->listeners) {
+                kcopy_memory(grown, state_ptr->listeners, sizeof(registered_event) * state_ptr->listener_used);
+                kfree(state_ptr->listeners, sizeof(registered_event) * state_ptr->listener_capacity, MEMORY_TAG_ENGINE);
+            }
+            state_ptr->listeners = grown;
+            state_ptr->listener_capacity = grown_capacity;
+        }
+    }
+
+    u32 destination = state_ptr->listener_used;
+    for (u32 i = 0; i < entry->count; ++i) {
+        registered_event e = state_ptr->listeners[entry->first + i];
+        state_ptr->listeners[destination + i] = e;
+        if (e.callback) {
+            state_ptr->handles[e.handle_index].pool_index = destination + i;
+        }
+    }
+    state_ptr->listener_abandoned += entry->capacity;
+    state_ptr->listener_used += new_capacity;
+    entry->first = destination;
+    entry->capacity = new_capacity;
+}
+
+static u32 handle_acquire(void) {
+    if (state_ptr->free_handle != INVALID_ID) {
+        u32 index = state_ptr->free_handle;
+        state_ptr->free_handle = state_ptr->handles[index].next_free;
+        return index;
+    }
+    event_handle_entry handle = {0};
+    darray_push(state_ptr->handles, handle);
+    return darray_length(state_ptr->handles) - 1;
+}
+
+static event_listener_handle handle_make(u32 index) {
+    return ((u64)state_ptr->handles[index].generation << 32) | index;
+}
+
 b8 event_system_initialize(u64* memory_requirement, void* state, void* config) {
     *memory_requirement = sizeof(event_system_state);
     if (state == 0) {
         return true;
     }
-    kzero_memory(state, sizeof(state));
+    kzero_memory(state, sizeof(event_system_state));
     state_ptr = state;
 
+    state_ptr->code_capacity = EVENT_REGISTRY_INITIAL_CAPACITY;
+    state_ptr->codes = kallocate(sizeof(event_code_entry) * state_ptr->code_capacity, MEMORY_TAG_ENGINE);
+    state_ptr->handles = darray_create(event_handle_entry);
+    state_ptr->free_handle = INVALID_ID;
+
+    for (u64 i = 0; i < POSTED_EVENT_QUEUE_CAPACITY; ++i) {
+        state_ptr->posted[i].sequence = i;
+    }
+    // Only the latest of these is of interest.
+    code_acquire(EVENT_CODE_RESIZED)->coalesce = true;
+    code_acquire(EVENT_CODE_MOUSE_MOVED)->coalesce = true;
+
     // Notify the engine that the event system is ready for use.
     engine_on_event_system_initialized();
 
@@ -44,62 +299,104 @@ b8 event_system_initialize(u64* memory_requirement, void* state, void* config) {
 
 void event_system_shutdown(void* state) {
     if (state_ptr) {
-        // Free the events arrays. And objects pointed to should be destroyed on their own.
-        for (u16 i = 0; i < MAX_MESSAGE_CODES; ++i) {
-            if (state_ptr->registered[i].events != 0) {
-                darray_destroy(state_ptr->registered[i].events);
-                state_ptr->registered[i].events = 0;
-            }
+        // Objects pointed to by listeners should be destroyed on their own.
+        kfree(state_ptr->codes, sizeof(event_code_entry) * state_ptr->code_capacity, MEMORY_TAG_ENGINE);
+        if (state_ptr->listeners) {
+            kfree(state_ptr->listeners, sizeof(registered_event) * state_ptr->listener_capacity, MEMORY_TAG_ENGINE);
         }
+        darray_destroy(state_ptr->handles);
     }
     state_ptr = 0;
 }
 
-b8 event_register(u16 code, void* listener, PFN_on_event on_event) {
+b8 event_register_handle(u16 code, void* listener, PFN_on_event on_event, event_listener_handle* out_handle) {
+    if (out_handle) {
+        *out_handle = INVALID_ID_U64;
+    }
     if (!state_ptr) {
         return false;
     }
 
-    if (state_ptr->registered[code].events == 0) {
-        state_ptr->registered[code].events = darray_create(registered_event);
-    }
-
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        if (state_ptr->registered[code].events[i].listener == listener && state_ptr->registered[code].events[i].callback == on_event) {
+    event_code_entry* entry = code_acquire(code);
+    for (u32 i = 0; i < entry->count; ++i) {
+        registered_event* e = &state_ptr->listeners[entry->first + i];
+        if (e->callback && e->listener == listener && e->callback == on_event) {
             KWARN("Event has already been registered with the code %hu and the callback of %p", code, on_event);
             return false;
         }
     }
 
     // If at this point, no duplicate was found. Proceed with registration.
-    registered_event event;
-    event.listener = listener;
-    event.callback = on_event;
-    darray_push(state_ptr->registered[code].events, event);
+    span_reserve(code);
+    entry = code_find(code);
+    u32 handle_index = handle_acquire();
+    u32 pool_index = entry->first + entry->count;
+    entry->count++;
+
+    registered_event* event = &state_ptr->listeners[pool_index];
+    event->listener = listener;
+    event->callback = on_event;
+    event->handle_index = handle_index;
+
+    event_handle_entry* handle = &state_ptr->handles[handle_index];
+    handle->pool_index = pool_index;
+    handle->code = code;
+    handle->next_free = INVALID_ID;
+    if (out_handle) {
+        *out_handle = handle_make(handle_index);
+    }
 
     return true;
 }
 
+b8 event_register(u16 code, void* listener, PFN_on_event on_event) {
+    return event_register_handle(code, listener, on_event, 0);
+}
+
+b8 event_unregister_handle(event_listener_handle listener_handle) {
+    if (!state_ptr || listener_handle == INVALID_ID_U64) {
+        return false;
+    }
+
+    u32 index = (u32)(listener_handle & 0xFFFFFFFF);
+    u32 generation = (u32)(listener_handle >> 32);
+    if (index >= darray_length(state_ptr->handles)) {
+        return false;
+    }
+    event_handle_entry* handle = &state_ptr->handles[index];
+    if (handle->generation != generation || handle->pool_index == INVALID_ID) {
+        // Already unregistered.
+        return false;
+    }
+
+    // Leave a gap rather than shifting the rest, so unregistering is constant time and the
+    // order (and positions, if firing) of the other listeners holds.
+    state_ptr->listeners[handle->pool_index].callback = 0;
+    code_find(handle->code)->removed_count++;
+
+    handle->pool_index = INVALID_ID;
+    handle->generation++;
+    handle->next_free = state_ptr->free_handle;
+    state_ptr->free_handle = index;
+    return true;
+}
+
 b8 event_unregister(u16 code, void* listener, PFN_on_event on_event) {
     if (!state_ptr) {
         return false;
     }
 
     // On nothing is registered for the code, boot out.
-    if (state_ptr->registered[code].events == 0) {
-        // TODO: warn
+    event_code_entry* entry = code_find(code);
+    if (!entry) {
         return false;
     }
 
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        registered_event e = state_ptr->registered[code].events[i];
-        if (e.listener == listener && e.callback == on_event) {
+    for (u32 i = 0; i < entry->count; ++i) {
+        registered_event* e = &state_ptr->listeners[entry->first + i];
+        if (e->callback && e->listener == listener && e->callback == on_event) {
             // Found one, remove it
-            registered_event popped_event;
-            darray_pop_at(state_ptr->registered[code].events, i, &popped_event);
-            return true;
+            return event_unregister_handle(handle_make(e->handle_index));
         }
     }
 
@@ -113,19 +410,104 @@ b8 event_fire(u16 code, void* sender, event_context context) {
     }
 
     // If nothing is registered for the code, boot out.
-    if (state_ptr->registered[code].events == 0) {
+    event_code_entry* entry = code_find(code);
+    if (!entry || entry->count == entry->removed_count) {
         return false;
     }
 
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        registered_event e = state_ptr->registered[code].events[i];
-        if (e.callback(code, sender, e.listener, context)) {
+    // Listeners may register or unregister others, which can move the span or grow the
+    // registry, so both are looked up again each time. Positions within the span hold while firing.
+    b8 handled = false;
+    state_ptr->fire_depth++;
+    for (u32 i = 0; entry && i < entry->count; ++i) {
+        registered_event e = state_ptr->listeners[entry->first + i];
+        if (e.callback && e.callback(code, sender, e.listener, context)) {
             // Message has been handled, do not send to other listeners.
-            return true;
+            handled = true;
+            break;
         }
+        entry = code_find(code);
     }
+    state_ptr->fire_depth--;
 
-    // Not found.
-    return false;
+    return handled;
+}
+
+b8 event_post(u16 code, void* sender, event_context context) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    // Claim the next entry in the queue.
+    posted_event* entry = 0;
+    u64 pos = katomic_load_u64(&state_ptr->post_pos, KATOMIC_ORDER_RELAXED);
+    for (;;) {
+        entry = &state_ptr->posted[pos & (POSTED_EVENT_QUEUE_CAPACITY - 1)];
+        i64 diff = (i64)katomic_load_u64(&entry->sequence, KATOMIC_ORDER_ACQUIRE) - (i64)pos;
+        if (diff == 0) {
+            if (katomic_compare_exchange_u64(&state_ptr->post_pos, &pos, pos + 1, KATOMIC_ORDER_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full. Waiting would never end if this is the main thread, so the event is dropped.
+            KWARN("Posted event queue is full. Event with code %hu was dropped.", code);
+            return false;
+        } else {
+            // Another thread claimed it first.
+            pos = katomic_load_u64(&state_ptr->post_pos, KATOMIC_ORDER_RELAXED);
+        }
+    }
+
+    entry->code = code;
+    entry->sender = sender;
+    entry->context = context;
+    katomic_store_u64(&entry->sequence, pos + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+void event_coalesce_set(u16 code, b8 coalesce) {
+    if (state_ptr) {
+        code_acquire(code)->coalesce = coalesce;
+    }
+}
+
+void event_dispatch_posted(void) {
+    if (!state_ptr) {
+        return;
+    }
+
+    // Find the events posted so far, noting the latest of each coalesced code. Stops early at
+    // an entry which is still being written, since events must be fired in order.
+    u64 start = state_ptr->dispatch_pos;
+    u64 limit = katomic_load_u64(&state_ptr->post_pos, KATOMIC_ORDER_ACQUIRE);
+    u64 end = start;
+    while (end < limit) {
+        posted_event* entry = &state_ptr->posted[end & (POSTED_EVENT_QUEUE_CAPACITY - 1)];
+        if (katomic_load_u64(&entry->sequence, KATOMIC_ORDER_ACQUIRE) != end + 1) {
+            break;
+        }
+        event_code_entry* code_entry = code_find(entry->code);
+        if (code_entry && code_entry->coalesce) {
+            code_entry->latest_posted = end;
+        }
+        end++;
+    }
+
+    for (u64 pos = start; pos < end; ++pos) {
+        posted_event* entry = &state_ptr->posted[pos & (POSTED_EVENT_QUEUE_CAPACITY - 1)];
+        u16 code = entry->code;
+        void* sender = entry->sender;
+        event_context context = entry->context;
+
+        // Hand the entry back to posters before firing, as listeners may post more.
+        katomic_store_u64(&entry->sequence, pos + POSTED_EVENT_QUEUE_CAPACITY, KATOMIC_ORDER_RELEASE);
+        state_ptr->dispatch_pos = pos + 1;
+
+        event_code_entry* code_entry = code_find(code);
+        if (code_entry && code_entry->coalesce && code_entry->latest_posted != pos) {
+            // A later event of the same code replaces this one.
+            continue;
+        }
+        event_fire(code, sender, context);
+    }
 }
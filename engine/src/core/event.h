@@ -69,6 +69,12 @@ typedef struct event_context {
  */
 typedef b8 (*PFN_on_event)(u16 code, void* sender, void* listener_inst, event_context data);
 
+/**
+ * @brief A handle to a registered listener, used to unregister it in constant time.
+ * INVALID_ID_U64 if not registered.
+ */
+typedef u64 event_listener_handle;
+
 /**
  * @brief Initializes the event system.
  */
@@ -99,9 +105,31 @@ KAPI b8 event_register(u16 code, void* listener, PFN_on_event on_event);
  */
 KAPI b8 event_unregister(u16 code, void* listener, PFN_on_event on_event);
 
+/**
+ * @brief Register to listen for when events are sent with the provided code, obtaining a handle
+ * which can later unregister the listener in constant time. Events with duplicate
+ * listener/callback combos will not be registered again and will cause this to return false.
+ * @param code The event code to listen for.
+ * @param listener A pointer to a listener instance. Can be 0/NULL.
+ * @param on_event The callback function pointer to be invoked when the event code is fired.
+ * @param out_handle A pointer to hold the handle of the listener. Can be 0/NULL.
+ * @returns True if the event is successfully registered; otherwise false.
+ */
+KAPI b8 event_register_handle(u16 code, void* listener, PFN_on_event on_event, event_listener_handle* out_handle);
+
+/**
+ * @brief Unregisters the listener with the given handle. Handles are invalidated once
+ * unregistered, so unregistering twice returns false.
+ * @param handle The handle of the listener, as obtained from event_register_handle.
+ * @returns True if the listener is successfully unregistered; otherwise false.
+ */
+KAPI b8 event_unregister_handle(event_listener_handle handle);
+
 /**
  * @brief Fires an event to listeners of the given code. If an event handler returns
  * true, the event is considered handled and is not passed on to any more listeners.
+ * Listeners are invoked immediately on the calling thread, so this must only be called from
+ * the main thread. Use event_post from other threads.
  * @param code The event code to fire.
  * @param sender A pointer to the sender. Can be 0/NULL.
  * @param data The event data.
@@ -109,6 +137,33 @@ KAPI b8 event_unregister(u16 code, void* listener, PFN_on_event on_event);
  */
 KAPI b8 event_fire(u16 code, void* sender, event_context context);
 
+/**
+ * @brief Queues an event to be fired on the main thread the next time posted events are
+ * dispatched, which happens once per frame. Safe to call from any thread, without locking.
+ * For codes set to coalesce, only the most recent event posted before dispatch is fired.
+ * @param code The event code to post.
+ * @param sender A pointer to the sender. Can be 0/NULL. Must still be valid when the event is dispatched.
+ * @param context The event data, copied into the queue.
+ * @returns True if queued; otherwise false (i.e. if the queue is full).
+ */
+KAPI b8 event_post(u16 code, void* sender, event_context context);
+
+/**
+ * @brief Sets whether posted events of the given code are coalesced, so that only the most
+ * recent posted in a frame is fired. Enabled by default for EVENT_CODE_RESIZED and
+ * EVENT_CODE_MOUSE_MOVED, where only the latest state matters.
+ * @param code The event code.
+ * @param coalesce Indicates if posted events of the code should be coalesced.
+ */
+KAPI void event_coalesce_set(u16 code, b8 coalesce);
+
+/**
+ * @brief Fires every event posted before this call, in the order posted. Events posted by
+ * listeners while dispatching are left for the next call. Called once per frame by the engine
+ * on the main thread.
+ */
+KAPI void event_dispatch_posted(void);
+
 /** @brief System internal event codes. Application should use codes beyond 255. */
 typedef enum system_event_code {
     /** @brief Shuts the application down on the next frame. */
@@ -252,6 +307,93 @@ typedef enum system_event_code {
      */
     EVENT_CODE_MOUSE_DRAG_END = 0x22,
 
+    /**
+     * @brief An event fired by the resource system once the file of a watched resource
+     * has changed. See resource_system_watch.
+     * Context usage:
+     * u32 watch_id = context.data.u32[0];
+     */
+    EVENT_CODE_WATCHED_RESOURCE_CHANGED = 0x23,
+
+    /**
+     * @brief An event fired when a gamepad button is pressed.
+     *
+     * Context usage:
+     * u16 index = context.data.u16[0]
+     * u16 button = context.data.u16[1]
+     */
+    EVENT_CODE_GAMEPAD_BUTTON_PRESSED = 0x24,
+
+    /**
+     * @brief An event fired when a gamepad button is released.
+     *
+     * Context usage:
+     * u16 index = context.data.u16[0]
+     * u16 button = context.data.u16[1]
+     */
+    EVENT_CODE_GAMEPAD_BUTTON_RELEASED = 0x25,
+
+    /**
+     * @brief An event fired when a gamepad is connected.
+     *
+     * Context usage:
+     * u16 index = context.data.u16[0]
+     */
+    EVENT_CODE_GAMEPAD_CONNECTED = 0x26,
+
+    /**
+     * @brief An event fired when a gamepad is disconnected.
+     *
+     * Context usage:
+     * u16 index = context.data.u16[0]
+     */
+    EVENT_CODE_GAMEPAD_DISCONNECTED = 0x27,
+
+    /**
+     * @brief An event fired by the renderer when GPU-local memory use nears its budget, so that
+     * systems may release memory before the driver starts paging. Fired again periodically while
+     * the pressure lasts, and once more with 0 bytes to free when it has eased.
+     *
+     * Context usage:
+     * u64 bytes_to_free = context.data.u64[0]
+     * u64 budget = context.data.u64[1]
+     */
+    EVENT_CODE_GPU_MEMORY_PRESSURE = 0x28,
+
+    /**
+     * @brief The window gained or lost focus. Posted by the platform layer, with the window as the
+     * sender for windows created by platform_window_create, or 0 for the main window.
+     *
+     * Context usage:
+     * b8 focused = context.data.u8[0]
+     */
+    EVENT_CODE_WINDOW_FOCUS_CHANGED = 0x29,
+
+    /**
+     * @brief The window was hidden (i.e. minimized, unmapped or fully covered) or shown again.
+     * Posted by the platform layer.
+     *
+     * Context usage:
+     * b8 visible = context.data.u8[0]
+     */
+    EVENT_CODE_WINDOW_VISIBILITY_CHANGED = 0x2A,
+
+    /**
+     * @brief A window created by platform_window_create was resized. Posted by the platform layer,
+     * with the window as the sender. The main window's size changes are EVENT_CODE_RESIZED instead.
+     *
+     * Context usage:
+     * u16 width = context.data.u16[0]
+     * u16 height = context.data.u16[1]
+     */
+    EVENT_CODE_WINDOW_RESIZED = 0x2B,
+
+    /**
+     * @brief The user asked to close a window created by platform_window_create. Posted by the
+     * platform layer, with the window as the sender. The window stays open until it is destroyed.
+     */
+    EVENT_CODE_WINDOW_CLOSE_REQUESTED = 0x2C,
+
     /** @brief The maximum event code that can be used internally. */
     MAX_EVENT_CODE = 0xFF
 } system_event_code;
@@ -4,19 +4,44 @@
 
 struct linear_allocator;
 
+/**
+ * @brief The number of frame allocator arenas cycled through. Memory allocated from the frame
+ * allocator during frame N remains valid until the start of frame N + FRAME_ALLOCATOR_BUFFER_COUNT,
+ * which leaves enough time for the GPU to consume data for frames in flight.
+ */
+#define FRAME_ALLOCATOR_BUFFER_COUNT 3
+
 typedef struct frame_allocator_int {
     void* (*allocate)(u64 size);
     void (*free)(void* block, u64 size);
     void (*free_all)(void);
+    /**
+     * @brief Optional. Attempts to grow a block in place, without moving it. Only possible for the
+     * most recent allocation, since nothing has been placed after it yet.
+     * @returns True if the block now holds new_size bytes; otherwise false, and the block is unchanged.
+     */
+    b8 (*grow)(void* block, u64 size, u64 new_size);
 } frame_allocator_int;
 
 /**
  * @brief Engine-level current frame-specific data.
  */
 typedef struct frame_data {
-    /** @brief The time in seconds since the last frame. */
+    /**
+     * @brief The time in seconds since the last frame. When the application updates at a fixed rate,
+     * this is the fixed step during update instead.
+     */
     f32 delta_time;
 
+    /**
+     * @brief How far the frame is between the last two fixed updates, from 0 to 1, for rendering to
+     * interpolate between their states. Always 1 when updating once per frame.
+     */
+    f32 interpolation_alpha;
+
+    /** @brief The number of fixed updates run this frame. May be 0. Always 1 when updating once per frame. */
+    u8 update_step_count;
+
     /** @brief The total amount of time in seconds the application has been running. */
     f64 total_time;
 
@@ -26,7 +51,10 @@ typedef struct frame_data {
     /** @brief The number of meshes drawn in the shadow pass in the last frame. */
     u32 drawn_shadow_mesh_count;
 
-    /** @brief An allocator designed and used for per-frame allocations. */
+    /**
+     * @brief An allocator designed and used for per-frame allocations. Safe to use from any thread,
+     * including job threads. Allocations are valid for FRAME_ALLOCATOR_BUFFER_COUNT frames.
+     */
     frame_allocator_int allocator;
 
     /** @brief The current renderer frame number, typically used for data synchronization. */
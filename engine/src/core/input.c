@@ -1,11 +1,24 @@
 #include "core/input.h"
 
+#include "containers/darray.h"
 #include "containers/stack.h"
 #include "core/event.h"
 #include "core/frame_data.h"
+#include "core/katomic.h"
 #include "core/keymap.h"
 #include "core/kmemory.h"
+#include "core/kthread.h"
 #include "core/logger.h"
+#include "math/kmath.h"
+#include "platform/platform.h"
+
+// The number of sampled gamepad changes which may wait to be processed. Must be a power of two.
+#define GAMEPAD_CHANGE_QUEUE_SIZE 1024
+#define INPUT_DEFAULT_SAMPLE_FREQUENCY 1000
+// Stick deflections within this radius are treated as centred.
+#define GAMEPAD_STICK_DEAD_ZONE 0.15f
+// Axis movements smaller than this are not queued, so that noise does not fill the queue.
+#define GAMEPAD_AXIS_THRESHOLD (1.0f / 512.0f)
 
 typedef struct keyboard_state {
     b8 keys[256];
@@ -18,21 +31,100 @@ typedef struct mouse_state {
     b8 dragging[BUTTON_MAX_BUTTONS];
 } mouse_state;
 
+typedef struct gamepad_state {
+    b8 connected;
+    b8 buttons[GAMEPAD_BUTTON_MAX_BUTTONS];
+    f32 axes[GAMEPAD_AXIS_MAX_AXES];
+} gamepad_state;
+
+typedef enum gamepad_change_type {
+    GAMEPAD_CHANGE_TYPE_CONNECTED,
+    GAMEPAD_CHANGE_TYPE_DISCONNECTED,
+    GAMEPAD_CHANGE_TYPE_BUTTON,
+    GAMEPAD_CHANGE_TYPE_AXIS
+} gamepad_change_type;
+
+// A change to a gamepad, as sampled.
+typedef struct gamepad_change {
+    // The absolute time the change was sampled at.
+    f64 time;
+    // 1 or 0 for buttons, the new value for axes.
+    f32 value;
+    u8 type;
+    u8 index;
+    // The button or axis.
+    u8 code;
+} gamepad_change;
+
+// The number of combinations of keymap modifier bits.
+#define KEYMAP_MODIFIER_COMBINATIONS 8
+
+// A binding as dispatched, copied out of the keymap stack.
+typedef struct keymap_dispatch_binding {
+    keymap_entry_bind_type type;
+    keymap_modifier modifiers;
+    PFN_keybind_callback callback;
+    void* user_data;
+} keymap_dispatch_binding;
+
+// The bindings to be dispatched for a key and set of held modifiers.
+typedef struct keymap_dispatch_range {
+    u32 first;
+    u32 count;
+} keymap_dispatch_range;
+
 typedef struct input_state {
     keyboard_state keyboard_current;
     keyboard_state keyboard_previous;
     mouse_state mouse_current;
     mouse_state mouse_previous;
+    gamepad_state gamepads_current[INPUT_MAX_GAMEPADS];
+    gamepad_state gamepads_previous[INPUT_MAX_GAMEPADS];
+
+    // The gamepad states as of the last changes queued. Owned by whichever thread samples.
+    platform_gamepad_state gamepads_sampled[INPUT_MAX_GAMEPADS];
+    // Single producer, single consumer queue of sampled changes. The head is written by the
+    // sampling thread, the tail by the main thread.
+    gamepad_change changes[GAMEPAD_CHANGE_QUEUE_SIZE];
+    volatile u32 change_head;
+    volatile u32 change_tail;
+
+    kthread sample_thread;
+    volatile u32 sample_thread_running;
+    volatile u32 sample_thread_stopping;
+    u32 sample_interval_ms;
+
+    // The time the input event being processed happened at.
+    f64 event_time;
+
+    // The mouse movement since the last update. Raw deltas are summed as they arrive, however many
+    // there are per frame, so none are lost to coalescing.
+    f32 mouse_delta_x;
+    f32 mouse_delta_y;
+    // Set once the platform reports raw deltas, after which cursor moves no longer add to the delta.
+    b8 mouse_raw;
 
     stack keymap_stack;
     // keymap active_keymap;
     b8 allow_key_repeats;
+
+    // The keymap stack flattened into the bindings which fire for each key and set of held modifiers,
+    // in the order the stack would invoke them. Rebuilt whenever the stack changes.
+    keymap_dispatch_range dispatch_ranges[KEYS_MAX_KEYS][KEYMAP_MODIFIER_COMBINATIONS];
+    // darray of the bindings the ranges index into.
+    keymap_dispatch_binding* dispatch_bindings;
+    // The keys with any hold binding, which are the only ones checked each frame.
+    keys hold_keys[KEYS_MAX_KEYS];
+    u32 hold_key_count;
+    // Incremented on each rebuild, so that dispatch stops if a callback changes the stack.
+    u32 dispatch_generation;
 } input_state;
 
 // Internal input state pointer
 static input_state* state_ptr;
 
-static b8 check_modifiers(keymap_modifier modifiers);
+static keymap_modifier modifiers_get(void);
+static u32 sample_thread_run(void* params);
 
 b8 input_system_initialize(u64* memory_requirement, void* state, void* config) {
     *memory_requirement = sizeof(input_state);
@@ -44,46 +136,247 @@ b8 input_system_initialize(u64* memory_requirement, void* state, void* config) {
 
     // Create the keymap stack and an active keymap to apply to.
     stack_create(&state_ptr->keymap_stack, sizeof(keymap));
+    state_ptr->dispatch_bindings = darray_create(keymap_dispatch_binding);
     // state_ptr->active_keymap = keymap_create();
 
     state_ptr->allow_key_repeats = false;
 
+    input_system_config* typed_config = config;
+    if (typed_config && typed_config->sample_thread) {
+        u32 frequency = typed_config->sample_frequency ? typed_config->sample_frequency : INPUT_DEFAULT_SAMPLE_FREQUENCY;
+        state_ptr->sample_interval_ms = KMAX(1, 1000 / frequency);
+        if (kthread_create(sample_thread_run, 0, false, &state_ptr->sample_thread)) {
+            katomic_store_u32(&state_ptr->sample_thread_running, 1, KATOMIC_ORDER_RELEASE);
+        } else {
+            KWARN("Failed to create input sampling thread. Gamepads will be sampled once per frame.");
+        }
+    }
+
     KINFO("Input subsystem initialized.");
 
     return true;
 }
 
 void input_system_shutdown(void* state) {
-    // TODO: Add shutdown routines when needed.
+    if (state_ptr && katomic_load_u32(&state_ptr->sample_thread_running, KATOMIC_ORDER_ACQUIRE)) {
+        katomic_store_u32(&state_ptr->sample_thread_stopping, 1, KATOMIC_ORDER_RELEASE);
+        kthread_wait(&state_ptr->sample_thread);
+        kthread_destroy(&state_ptr->sample_thread);
+        katomic_store_u32(&state_ptr->sample_thread_running, 0, KATOMIC_ORDER_RELEASE);
+    }
+    platform_gamepads_release();
+    if (state_ptr) {
+        stack_destroy(&state_ptr->keymap_stack);
+        darray_destroy(state_ptr->dispatch_bindings);
+    }
     state_ptr = 0;
 }
 
+// Rescales a stick so that the dead zone reads as centred and full deflection is still 1.
+static void stick_dead_zone_apply(f32* x, f32* y) {
+    f32 length = ksqrt((*x) * (*x) + (*y) * (*y));
+    if (length <= GAMEPAD_STICK_DEAD_ZONE) {
+        *x = 0;
+        *y = 0;
+        return;
+    }
+    f32 scale = (KMIN(length, 1.0f) - GAMEPAD_STICK_DEAD_ZONE) / ((1.0f - GAMEPAD_STICK_DEAD_ZONE) * length);
+    *x *= scale;
+    *y *= scale;
+}
+
+static b8 gamepad_change_push(gamepad_change_type type, u8 index, u8 code, f32 value, f64 time) {
+    u32 head = katomic_load_u32(&state_ptr->change_head, KATOMIC_ORDER_RELAXED);
+    u32 tail = katomic_load_u32(&state_ptr->change_tail, KATOMIC_ORDER_ACQUIRE);
+    if (head - tail >= GAMEPAD_CHANGE_QUEUE_SIZE) {
+        // Full. The change is found again on the next sample, as the sampled state is not updated.
+        return false;
+    }
+    gamepad_change* change = &state_ptr->changes[head & (GAMEPAD_CHANGE_QUEUE_SIZE - 1)];
+    change->time = time;
+    change->value = value;
+    change->type = type;
+    change->index = index;
+    change->code = code;
+    katomic_store_u32(&state_ptr->change_head, head + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+// Samples every gamepad and queues whatever changed since the last sample.
+static void gamepads_sample(void) {
+    platform_gamepad_state states[INPUT_MAX_GAMEPADS];
+    platform_gamepads_sample(states);
+    f64 time = platform_get_absolute_time();
+
+    for (u8 i = 0; i < INPUT_MAX_GAMEPADS; ++i) {
+        platform_gamepad_state* current = &states[i];
+        platform_gamepad_state* last = &state_ptr->gamepads_sampled[i];
+
+        if (current->connected != last->connected) {
+            if (!gamepad_change_push(current->connected ? GAMEPAD_CHANGE_TYPE_CONNECTED : GAMEPAD_CHANGE_TYPE_DISCONNECTED, i, 0, 0, time)) {
+                continue;
+            }
+            kzero_memory(last, sizeof(platform_gamepad_state));
+            last->connected = current->connected;
+        }
+        if (!current->connected) {
+            continue;
+        }
+
+        u32 changed = current->buttons ^ last->buttons;
+        for (u8 b = 0; changed && b < GAMEPAD_BUTTON_MAX_BUTTONS; ++b) {
+            u32 bit = 1u << b;
+            if ((changed & bit) && gamepad_change_push(GAMEPAD_CHANGE_TYPE_BUTTON, i, b, (current->buttons & bit) ? 1.0f : 0.0f, time)) {
+                last->buttons ^= bit;
+            }
+        }
+
+        stick_dead_zone_apply(&current->axes[GAMEPAD_AXIS_LEFT_X], &current->axes[GAMEPAD_AXIS_LEFT_Y]);
+        stick_dead_zone_apply(&current->axes[GAMEPAD_AXIS_RIGHT_X], &current->axes[GAMEPAD_AXIS_RIGHT_Y]);
+        for (u8 a = 0; a < GAMEPAD_AXIS_MAX_AXES; ++a) {
+            f32 value = current->axes[a];
+            // Always report returning to rest, however small the step.
+            b8 moved = kabs(value - last->axes[a]) >= GAMEPAD_AXIS_THRESHOLD || (value == 0 && last->axes[a] != 0);
+            if (moved && gamepad_change_push(GAMEPAD_CHANGE_TYPE_AXIS, i, a, value, time)) {
+                last->axes[a] = value;
+            }
+        }
+    }
+}
+
+static u32 sample_thread_run(void* params) {
+    while (!katomic_load_u32(&state_ptr->sample_thread_stopping, KATOMIC_ORDER_ACQUIRE)) {
+        gamepads_sample();
+        platform_sleep(state_ptr->sample_interval_ms);
+    }
+    return 0;
+}
+
+static void gamepad_change_apply(const gamepad_change* change) {
+    gamepad_state* pad = &state_ptr->gamepads_current[change->index];
+    state_ptr->event_time = change->time;
+
+    event_context context = {0};
+    context.data.u16[0] = change->index;
+    switch (change->type) {
+        case GAMEPAD_CHANGE_TYPE_CONNECTED:
+            kzero_memory(pad, sizeof(gamepad_state));
+            pad->connected = true;
+            KINFO("Gamepad %u connected.", change->index);
+            event_fire(EVENT_CODE_GAMEPAD_CONNECTED, 0, context);
+            break;
+        case GAMEPAD_CHANGE_TYPE_DISCONNECTED:
+            // Held buttons are dropped without release events.
+            kzero_memory(pad, sizeof(gamepad_state));
+            KINFO("Gamepad %u disconnected.", change->index);
+            event_fire(EVENT_CODE_GAMEPAD_DISCONNECTED, 0, context);
+            break;
+        case GAMEPAD_CHANGE_TYPE_BUTTON: {
+            b8 pressed = change->value != 0;
+            pad->buttons[change->code] = pressed;
+            context.data.u16[1] = change->code;
+            event_fire(pressed ? EVENT_CODE_GAMEPAD_BUTTON_PRESSED : EVENT_CODE_GAMEPAD_BUTTON_RELEASED, 0, context);
+        } break;
+        case GAMEPAD_CHANGE_TYPE_AXIS:
+            pad->axes[change->code] = change->value;
+            break;
+    }
+}
+
+void input_process_gamepads(void) {
+    if (!state_ptr) {
+        return;
+    }
+
+    if (!katomic_load_u32(&state_ptr->sample_thread_running, KATOMIC_ORDER_ACQUIRE)) {
+        gamepads_sample();
+    }
+
+    // Changes are applied in the order they were sampled, each with the time it was sampled at.
+    u32 tail = katomic_load_u32(&state_ptr->change_tail, KATOMIC_ORDER_RELAXED);
+    u32 head = katomic_load_u32(&state_ptr->change_head, KATOMIC_ORDER_ACQUIRE);
+    while (tail != head) {
+        gamepad_change_apply(&state_ptr->changes[tail & (GAMEPAD_CHANGE_QUEUE_SIZE - 1)]);
+        tail++;
+    }
+    katomic_store_u32(&state_ptr->change_tail, tail, KATOMIC_ORDER_RELEASE);
+}
+
 void input_update(const struct frame_data* p_frame_data) {
     if (!state_ptr) {
         return;
     }
 
     // Handle hold bindings.
-    for (u32 k = 0; k < KEYS_MAX_KEYS; ++k) {
-        keys key = (keys)k;
+    keymap_modifier modifiers = modifiers_get();
+    u32 generation = state_ptr->dispatch_generation;
+    for (u32 k = 0; k < state_ptr->hold_key_count && generation == state_ptr->dispatch_generation; ++k) {
+        keys key = state_ptr->hold_keys[k];
         if (input_is_key_down(key) && input_was_key_down(key)) {
-            u32 map_count = state_ptr->keymap_stack.element_count;
-            keymap* maps = (keymap*)state_ptr->keymap_stack.memory;
+            keymap_dispatch_range* range = &state_ptr->dispatch_ranges[key][modifiers];
+            for (u32 b = 0; b < range->count && generation == state_ptr->dispatch_generation; ++b) {
+                keymap_dispatch_binding binding = state_ptr->dispatch_bindings[range->first + b];
+                if (binding.type == KEYMAP_BIND_TYPE_HOLD) {
+                    binding.callback(key, binding.type, binding.modifiers, binding.user_data);
+                }
+            }
+        }
+    }
+
+    // Copy current states to previous states.
+    kcopy_memory(&state_ptr->keyboard_previous, &state_ptr->keyboard_current, sizeof(keyboard_state));
+    kcopy_memory(&state_ptr->mouse_previous, &state_ptr->mouse_current, sizeof(mouse_state));
+    state_ptr->mouse_delta_x = 0;
+    state_ptr->mouse_delta_y = 0;
+    kcopy_memory(state_ptr->gamepads_previous, state_ptr->gamepads_current, sizeof(gamepad_state) * INPUT_MAX_GAMEPADS);
+}
+
+// Obtains the keymap modifiers currently held, as a set of keymap_modifier_bits.
+static keymap_modifier modifiers_get(void) {
+    keymap_modifier modifiers = KEYMAP_MODIFIER_NONE_BIT;
+    if (input_is_key_down(KEY_SHIFT) || input_is_key_down(KEY_LSHIFT) || input_is_key_down(KEY_RSHIFT)) {
+        modifiers |= KEYMAP_MODIFIER_SHIFT_BIT;
+    }
+    if (input_is_key_down(KEY_CONTROL) || input_is_key_down(KEY_LCONTROL) || input_is_key_down(KEY_RCONTROL)) {
+        modifiers |= KEYMAP_MODIFIER_CONTROL_BIT;
+    }
+    if (input_is_key_down(KEY_LALT) || input_is_key_down(KEY_RALT)) {
+        modifiers |= KEYMAP_MODIFIER_ALT_BIT;
+    }
+    return modifiers;
+}
+
+// Flattens the keymap stack into dispatch ranges. For each key and set of held modifiers, the maps are
+// walked top-down, taking every binding whose required modifiers are all held, until an unset binding
+// or a map which overrides all is reached.
+static void keymap_stack_compile(void) {
+    darray_length_set(state_ptr->dispatch_bindings, 0);
+    state_ptr->hold_key_count = 0;
+    state_ptr->dispatch_generation++;
+
+    u32 map_count = state_ptr->keymap_stack.element_count;
+    keymap* maps = (keymap*)state_ptr->keymap_stack.memory;
+    for (u32 k = 0; k < KEYS_MAX_KEYS; ++k) {
+        b8 has_hold = false;
+        for (keymap_modifier held = 0; held < KEYMAP_MODIFIER_COMBINATIONS; ++held) {
+            keymap_dispatch_range* range = &state_ptr->dispatch_ranges[k][held];
+            range->first = darray_length(state_ptr->dispatch_bindings);
             for (i32 m = map_count - 1; m >= 0; --m) {
                 keymap* map = &maps[m];
-                keymap_binding* binding = &map->entries[key].bindings[0];
+                keymap_binding* binding = map->entries[k].bindings;
                 b8 unset = false;
                 while (binding) {
                     // If an unset is detected, stop processing.
                     if (binding->type == KEYMAP_BIND_TYPE_UNSET) {
                         unset = true;
                         break;
-                    } else if (binding->type == KEYMAP_BIND_TYPE_HOLD) {
-                        if (binding->callback && check_modifiers(binding->modifiers)) {
-                            binding->callback(key, binding->type, binding->modifiers, binding->user_data);
-                        }
                     }
-
+                    b8 dispatched = binding->type == KEYMAP_BIND_TYPE_PRESS || binding->type == KEYMAP_BIND_TYPE_RELEASE || binding->type == KEYMAP_BIND_TYPE_HOLD;
+                    if (dispatched && binding->callback && (binding->modifiers & held) == binding->modifiers) {
+                        keymap_dispatch_binding entry = {binding->type, binding->modifiers, binding->callback, binding->user_data};
+                        darray_push(state_ptr->dispatch_bindings, entry);
+                        has_hold |= binding->type == KEYMAP_BIND_TYPE_HOLD;
+                    }
                     binding = binding->next;
                 }
                 // If an unset is detected or the map is marked to override all, stop processing.
@@ -91,32 +384,12 @@ void input_update(const struct frame_data* p_frame_data) {
                     break;
                 }
             }
+            range->count = darray_length(state_ptr->dispatch_bindings) - range->first;
         }
-    }
-
-    // Copy current states to previous states.
-    kcopy_memory(&state_ptr->keyboard_previous, &state_ptr->keyboard_current, sizeof(keyboard_state));
-    kcopy_memory(&state_ptr->mouse_previous, &state_ptr->mouse_current, sizeof(mouse_state));
-}
-
-static b8 check_modifiers(keymap_modifier modifiers) {
-    if (modifiers & KEYMAP_MODIFIER_SHIFT_BIT) {
-        if (!input_is_key_down(KEY_SHIFT) && !input_is_key_down(KEY_LSHIFT) && !input_is_key_down(KEY_RSHIFT)) {
-            return false;
+        if (has_hold) {
+            state_ptr->hold_keys[state_ptr->hold_key_count++] = (keys)k;
         }
     }
-    if (modifiers & KEYMAP_MODIFIER_CONTROL_BIT) {
-        if (!input_is_key_down(KEY_CONTROL) && !input_is_key_down(KEY_LCONTROL) && !input_is_key_down(KEY_RCONTROL)) {
-            return false;
-        }
-    }
-    if (modifiers & KEYMAP_MODIFIER_ALT_BIT) {
-        if (!input_is_key_down(KEY_LALT) && !input_is_key_down(KEY_RALT)) {
-            return false;
-        }
-    }
-
-    return true;
 }
 
 void input_process_key(keys key, b8 pressed) {
@@ -125,6 +398,8 @@ void input_process_key(keys key, b8 pressed) {
     }
     // keymap_entry* map_entry = &state_ptr->active_keymap.entries[key];
 
+    state_ptr->event_time = platform_get_absolute_time();
+
     // Only handle this if the state actually changed, or if repeats are allowed.
     b8 is_repeat = pressed && state_ptr->keyboard_current.keys[key];
     b8 changed = state_ptr->keyboard_current.keys[key] != pressed;
@@ -150,34 +425,14 @@ void input_process_key(keys key, b8 pressed) {
         //     KINFO("Right shift %s.", pressed ? "pressed" : "released");
         // }
 
-        // Check for key bindings
-        // Iterate keymaps top-down on the stack.
-        u32 map_count = state_ptr->keymap_stack.element_count;
-        keymap* maps = (keymap*)state_ptr->keymap_stack.memory;
-        for (i32 m = map_count - 1; m >= 0; --m) {
-            keymap* map = &maps[m];
-            keymap_binding* binding = &map->entries[key].bindings[0];
-            b8 unset = false;
-            while (binding) {
-                // If an unset is detected, stop processing.
-                if (binding->type == KEYMAP_BIND_TYPE_UNSET) {
-                    unset = true;
-                    break;
-                } else if (pressed && binding->type == KEYMAP_BIND_TYPE_PRESS) {
-                    if (binding->callback && check_modifiers(binding->modifiers)) {
-                        binding->callback(key, binding->type, binding->modifiers, binding->user_data);
-                    }
-                } else if (!pressed && binding->type == KEYMAP_BIND_TYPE_RELEASE) {
-                    if (binding->callback && check_modifiers(binding->modifiers)) {
-                        binding->callback(key, binding->type, binding->modifiers, binding->user_data);
-                    }
-                }
-
-                binding = binding->next;
-            }
-            // If an unset is detected or the map is marked to override all, stop processing.
-            if (unset || map->overrides_all) {
-                break;
+        // Invoke the key bindings for the held modifiers.
+        keymap_entry_bind_type type = pressed ? KEYMAP_BIND_TYPE_PRESS : KEYMAP_BIND_TYPE_RELEASE;
+        keymap_dispatch_range* range = &state_ptr->dispatch_ranges[key][modifiers_get()];
+        u32 generation = state_ptr->dispatch_generation;
+        for (u32 b = 0; b < range->count && generation == state_ptr->dispatch_generation; ++b) {
+            keymap_dispatch_binding binding = state_ptr->dispatch_bindings[range->first + b];
+            if (binding.type == type) {
+                binding.callback(key, binding.type, binding.modifiers, binding.user_data);
             }
         }
 
@@ -190,6 +445,8 @@ void input_process_key(keys key, b8 pressed) {
 }
 
 void input_process_button(buttons button, b8 pressed) {
+    state_ptr->event_time = platform_get_absolute_time();
+
     // If the state changed, fire an event.
     if (state_ptr->mouse_current.buttons[button] != pressed) {
         state_ptr->mouse_current.buttons[button] = pressed;
@@ -235,6 +492,11 @@ void input_process_mouse_move(i16 x, i16 y) {
         // KDEBUG("Mouse pos: %i, %i!", x, y);
 
         // Update internal state_ptr->
+        state_ptr->event_time = platform_get_absolute_time();
+        if (!state_ptr->mouse_raw) {
+            state_ptr->mouse_delta_x += (f32)(x - state_ptr->mouse_current.x);
+            state_ptr->mouse_delta_y += (f32)(y - state_ptr->mouse_current.y);
+        }
         state_ptr->mouse_current.x = x;
         state_ptr->mouse_current.y = y;
 
@@ -242,7 +504,7 @@ void input_process_mouse_move(i16 x, i16 y) {
         event_context context;
         context.data.i16[0] = x;
         context.data.i16[1] = y;
-        event_fire(EVENT_CODE_MOUSE_MOVED, 0, context);
+        event_post(EVENT_CODE_MOUSE_MOVED, 0, context);
 
         for (u16 i = 0; i < BUTTON_MAX_BUTTONS; ++i) {
             // Check if the button is down first.
@@ -272,8 +534,19 @@ void input_process_mouse_move(i16 x, i16 y) {
     }
 }
 
+void input_process_mouse_raw_move(f32 x_delta, f32 y_delta) {
+    if (!state_ptr) {
+        return;
+    }
+    state_ptr->event_time = platform_get_absolute_time();
+    state_ptr->mouse_raw = true;
+    state_ptr->mouse_delta_x += x_delta;
+    state_ptr->mouse_delta_y += y_delta;
+}
+
 void input_process_mouse_wheel(i8 z_delta) {
     // NOTE: no internal state to update.
+    state_ptr->event_time = platform_get_absolute_time();
 
     // Fire the event.
     event_context context;
@@ -362,6 +635,16 @@ void input_get_mouse_position(i32* x, i32* y) {
     *y = state_ptr->mouse_current.y;
 }
 
+void input_get_mouse_delta(f32* x, f32* y) {
+    if (!state_ptr) {
+        *x = 0;
+        *y = 0;
+        return;
+    }
+    *x = state_ptr->mouse_delta_x;
+    *y = state_ptr->mouse_delta_y;
+}
+
 void input_get_previous_mouse_position(i32* x, i32* y) {
     if (!state_ptr) {
         *x = 0;
@@ -372,6 +655,55 @@ void input_get_previous_mouse_position(i32* x, i32* y) {
     *y = state_ptr->mouse_previous.y;
 }
 
+b8 input_is_gamepad_connected(u8 index) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return false;
+    }
+    return state_ptr->gamepads_current[index].connected;
+}
+
+b8 input_is_gamepad_button_down(u8 index, gamepad_buttons button) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return false;
+    }
+    return state_ptr->gamepads_current[index].buttons[button] == true;
+}
+
+b8 input_is_gamepad_button_up(u8 index, gamepad_buttons button) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return true;
+    }
+    return state_ptr->gamepads_current[index].buttons[button] == false;
+}
+
+b8 input_was_gamepad_button_down(u8 index, gamepad_buttons button) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return false;
+    }
+    return state_ptr->gamepads_previous[index].buttons[button] == true;
+}
+
+b8 input_was_gamepad_button_up(u8 index, gamepad_buttons button) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return true;
+    }
+    return state_ptr->gamepads_previous[index].buttons[button] == false;
+}
+
+f32 input_gamepad_axis_get(u8 index, gamepad_axes axis) {
+    if (!state_ptr || index >= INPUT_MAX_GAMEPADS) {
+        return 0;
+    }
+    return state_ptr->gamepads_current[index].axes[axis];
+}
+
+f64 input_event_time_get(void) {
+    if (!state_ptr) {
+        return 0;
+    }
+    return state_ptr->event_time;
+}
+
 const char* input_keycode_str(keys key) {
     switch (key) {
         case KEY_BACKSPACE:
@@ -658,6 +990,7 @@ void input_keymap_push(const keymap* map) {
             KERROR("Failed to push keymap!");
             return;
         }
+        keymap_stack_compile();
     }
 }
 
@@ -665,7 +998,11 @@ b8 input_keymap_pop(void) {
     if (state_ptr) {
         // Pop the keymap from the stack, then re-apply the stack.
         keymap popped;
-        return stack_pop(&state_ptr->keymap_stack, &popped);
+        if (!stack_pop(&state_ptr->keymap_stack, &popped)) {
+            return false;
+        }
+        keymap_stack_compile();
+        return true;
     }
 
     return false;
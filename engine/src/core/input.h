@@ -2,7 +2,7 @@
  * @file input.h
  * @author Travis Vroman (travis@kohiengine.com)
  * @brief This file contains everything having to do with input on deskop
- * environments from keyboards and mice. Gamepads and touch controls will
+ * environments from keyboards, mice and gamepads. Touch controls will
  * likely be handled separately at a future date.
  * @version 1.0
  * @date 2022-01-10
@@ -308,13 +308,74 @@ typedef enum keys {
     KEYS_MAX_KEYS = 0xFF
 } keys;
 
+/** @brief The most gamepads which may be connected at once. */
+#define INPUT_MAX_GAMEPADS 4
+
+/**
+ * @brief Represents gamepad buttons, named after their positions on an Xbox controller.
+ */
+typedef enum gamepad_buttons {
+    /** @brief The bottom face button. */
+    GAMEPAD_BUTTON_A,
+    /** @brief The right face button. */
+    GAMEPAD_BUTTON_B,
+    /** @brief The left face button. */
+    GAMEPAD_BUTTON_X,
+    /** @brief The top face button. */
+    GAMEPAD_BUTTON_Y,
+    /** @brief The left shoulder button. */
+    GAMEPAD_BUTTON_LEFT_SHOULDER,
+    /** @brief The right shoulder button. */
+    GAMEPAD_BUTTON_RIGHT_SHOULDER,
+    /** @brief The back/select/view button. */
+    GAMEPAD_BUTTON_BACK,
+    /** @brief The start/menu button. */
+    GAMEPAD_BUTTON_START,
+    /** @brief The guide/home button, where the platform reports it. */
+    GAMEPAD_BUTTON_GUIDE,
+    /** @brief Pressing the left stick in. */
+    GAMEPAD_BUTTON_LEFT_STICK,
+    /** @brief Pressing the right stick in. */
+    GAMEPAD_BUTTON_RIGHT_STICK,
+    GAMEPAD_BUTTON_DPAD_UP,
+    GAMEPAD_BUTTON_DPAD_DOWN,
+    GAMEPAD_BUTTON_DPAD_LEFT,
+    GAMEPAD_BUTTON_DPAD_RIGHT,
+    GAMEPAD_BUTTON_MAX_BUTTONS
+} gamepad_buttons;
+
+/**
+ * @brief Represents gamepad axes. Sticks range from -1 to 1, with positive y pointing up.
+ * Triggers range from 0 to 1.
+ */
+typedef enum gamepad_axes {
+    GAMEPAD_AXIS_LEFT_X,
+    GAMEPAD_AXIS_LEFT_Y,
+    GAMEPAD_AXIS_RIGHT_X,
+    GAMEPAD_AXIS_RIGHT_Y,
+    GAMEPAD_AXIS_LEFT_TRIGGER,
+    GAMEPAD_AXIS_RIGHT_TRIGGER,
+    GAMEPAD_AXIS_MAX_AXES
+} gamepad_axes;
+
+/** @brief The configuration of the input system. */
+typedef struct input_system_config {
+    /**
+     * @brief Indicates if gamepads are sampled on a thread of their own, rather than once per frame.
+     * Changes are then timestamped when they happen instead of when the frame starts.
+     */
+    b8 sample_thread;
+    /** @brief The rate the sampling thread runs at, in samples per second, within the resolution of platform_sleep(). Defaults to 1000. */
+    u32 sample_frequency;
+} input_system_config;
+
 /**
  * @brief Initializes the input system. Call twice; once to obtain memory requirement (passing
  * state = 0), then a second time passing allocated memory to state.
  *
  * @param memory_requirement The required size of the state memory.
  * @param state Either 0 or the allocated block of state memory.
- * @param config Ignored.
+ * @param config A pointer to an input_system_config, or 0 to sample gamepads once per frame.
  * @returns True on success; otherwise false.
  */
 b8 input_system_initialize(u64* memory_requirement, void* state, void* config);
@@ -325,6 +386,12 @@ b8 input_system_initialize(u64* memory_requirement, void* state, void* config);
  */
 void input_system_shutdown(void* state);
 
+/**
+ * @brief Processes the gamepad changes sampled since it was last called. Called once
+ * per frame, before anything reads the input state.
+ */
+void input_process_gamepads(void);
+
 /**
  * @brief Updates the input system every frame.
  * @param p_frame_data A constant pointer to the current frame's data.
@@ -421,6 +488,16 @@ KAPI b8 input_is_button_dragging(buttons button);
  */
 KAPI void input_get_mouse_position(i32* x, i32* y);
 
+/**
+ * @brief Obtains how far the mouse moved this frame. Where the platform provides raw input, this is
+ * the sum of every raw movement reported since the last update, in device units and without
+ * pointer acceleration, and keeps counting when the cursor stops at the edge of the screen.
+ * Otherwise it is the change in cursor position, in pixels. Positive y is down.
+ * @param x A pointer to hold the movement on the x-axis.
+ * @param y A pointer to hold the movement on the y-axis.
+ */
+KAPI void input_get_mouse_delta(f32* x, f32* y);
+
 /**
  * @brief Obtains the previous mouse position.
  * @param x A pointer to hold the previous mouse position on the x-axis.
@@ -441,12 +518,75 @@ void input_process_button(buttons button, b8 pressed);
  */
 void input_process_mouse_move(i16 x, i16 y);
 
+/**
+ * @brief Adds raw, unaccelerated mouse movement to this frame's mouse delta. Called by the platform
+ * for each raw movement as it arrives. Once called, cursor moves no longer add to the delta.
+ * @param x_delta The movement on the x-axis, in device units.
+ * @param y_delta The movement on the y-axis, in device units, positive down.
+ */
+void input_process_mouse_raw_move(f32 x_delta, f32 y_delta);
+
 /**
  * @brief Processes mouse wheel scrolling.
  * @param z_delta The amount of scrolling which occurred on the z axis (mouse wheel)
  */
 void input_process_mouse_wheel(i8 z_delta);
 
+/**
+ * @brief Indicates if a gamepad is connected at the given index.
+ * @param index The gamepad index, less than INPUT_MAX_GAMEPADS.
+ * @returns True if connected; otherwise false.
+ */
+KAPI b8 input_is_gamepad_connected(u8 index);
+
+/**
+ * @brief Indicates if the given button of a gamepad is currently pressed.
+ * @param index The gamepad index.
+ * @param button The button to check.
+ * @returns True if currently pressed; otherwise false.
+ */
+KAPI b8 input_is_gamepad_button_down(u8 index, gamepad_buttons button);
+
+/**
+ * @brief Indicates if the given button of a gamepad is currently released.
+ * @param index The gamepad index.
+ * @param button The button to check.
+ * @returns True if currently released; otherwise false.
+ */
+KAPI b8 input_is_gamepad_button_up(u8 index, gamepad_buttons button);
+
+/**
+ * @brief Indicates if the given button of a gamepad was pressed in the last frame.
+ * @param index The gamepad index.
+ * @param button The button to check.
+ * @returns True if previously pressed; otherwise false.
+ */
+KAPI b8 input_was_gamepad_button_down(u8 index, gamepad_buttons button);
+
+/**
+ * @brief Indicates if the given button of a gamepad was released in the last frame.
+ * @param index The gamepad index.
+ * @param button The button to check.
+ * @returns True if previously released; otherwise false.
+ */
+KAPI b8 input_was_gamepad_button_up(u8 index, gamepad_buttons button);
+
+/**
+ * @brief Obtains the current value of a gamepad axis, with the dead zone already removed from sticks.
+ * @param index The gamepad index.
+ * @param axis The axis to read.
+ * @returns The axis value, or 0 if the gamepad is not connected.
+ */
+KAPI f32 input_gamepad_axis_get(u8 index, gamepad_axes axis);
+
+/**
+ * @brief Obtains the absolute time at which the input event being handled happened,
+ * as given by platform_get_absolute_time(). Gamepad events sampled on the sampling thread carry
+ * the time they were sampled rather than the time they were processed.
+ * @returns The time of the most recently processed input event in seconds, or 0 if there has been none.
+ */
+KAPI f64 input_event_time_get(void);
+
 /**
  * @brief Returns a string representation of the provided key. Ex. "tab" for the tab key.
  *
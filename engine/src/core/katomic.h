@@ -0,0 +1,153 @@
+/**
+ * @file katomic.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Atomic operations used by lock-free code throughout the engine.
+ * These wrap the compiler's __atomic builtins, which are available on all
+ * supported compilers (Clang on all platforms, as well as GCC).
+ * @version 1.0
+ * @date 2023-11-12
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief The memory ordering to be used for an atomic operation. */
+typedef enum katomic_order {
+    /** @brief No ordering constraints, only atomicity is guaranteed. */
+    KATOMIC_ORDER_RELAXED = __ATOMIC_RELAXED,
+    /** @brief No reads or writes in the current thread can be reordered before this load. */
+    KATOMIC_ORDER_ACQUIRE = __ATOMIC_ACQUIRE,
+    /** @brief No reads or writes in the current thread can be reordered after this store. */
+    KATOMIC_ORDER_RELEASE = __ATOMIC_RELEASE,
+    /** @brief Both acquire and release semantics, for read-modify-write operations. */
+    KATOMIC_ORDER_ACQ_REL = __ATOMIC_ACQ_REL,
+    /** @brief Acquire/release semantics plus a single total order of all such operations. */
+    KATOMIC_ORDER_SEQ_CST = __ATOMIC_SEQ_CST
+} katomic_order;
+
+// u32
+
+/** @brief Atomically loads the value at ptr. */
+KINLINE u32 katomic_load_u32(volatile u32* ptr, katomic_order order) {
+    return __atomic_load_n(ptr, order);
+}
+
+/** @brief Atomically stores the value to ptr. */
+KINLINE void katomic_store_u32(volatile u32* ptr, u32 value, katomic_order order) {
+    __atomic_store_n(ptr, value, order);
+}
+
+/** @brief Atomically replaces the value at ptr, returning the previous value. */
+KINLINE u32 katomic_exchange_u32(volatile u32* ptr, u32 value, katomic_order order) {
+    return __atomic_exchange_n(ptr, value, order);
+}
+
+/** @brief Atomically adds to the value at ptr, returning the previous value. */
+KINLINE u32 katomic_fetch_add_u32(volatile u32* ptr, u32 value, katomic_order order) {
+    return __atomic_fetch_add(ptr, value, order);
+}
+
+/** @brief Atomically subtracts from the value at ptr, returning the previous value. */
+KINLINE u32 katomic_fetch_sub_u32(volatile u32* ptr, u32 value, katomic_order order) {
+    return __atomic_fetch_sub(ptr, value, order);
+}
+
+/**
+ * @brief Atomically compares the value at ptr with expected, and if equal replaces it
+ * with desired. Otherwise, expected is updated with the current value.
+ * @returns True if the exchange took place; otherwise false.
+ */
+KINLINE b8 katomic_compare_exchange_u32(volatile u32* ptr, u32* expected, u32 desired, katomic_order order) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, order, __ATOMIC_RELAXED);
+}
+
+// u64
+
+/** @brief Atomically loads the value at ptr. */
+KINLINE u64 katomic_load_u64(volatile u64* ptr, katomic_order order) {
+    return __atomic_load_n(ptr, order);
+}
+
+/** @brief Atomically stores the value to ptr. */
+KINLINE void katomic_store_u64(volatile u64* ptr, u64 value, katomic_order order) {
+    __atomic_store_n(ptr, value, order);
+}
+
+/** @brief Atomically replaces the value at ptr, returning the previous value. */
+KINLINE u64 katomic_exchange_u64(volatile u64* ptr, u64 value, katomic_order order) {
+    return __atomic_exchange_n(ptr, value, order);
+}
+
+/** @brief Atomically adds to the value at ptr, returning the previous value. */
+KINLINE u64 katomic_fetch_add_u64(volatile u64* ptr, u64 value, katomic_order order) {
+    return __atomic_fetch_add(ptr, value, order);
+}
+
+/** @brief Atomically subtracts from the value at ptr, returning the previous value. */
+KINLINE u64 katomic_fetch_sub_u64(volatile u64* ptr, u64 value, katomic_order order) {
+    return __atomic_fetch_sub(ptr, value, order);
+}
+
+/** @copydoc katomic_compare_exchange_u32 */
+KINLINE b8 katomic_compare_exchange_u64(volatile u64* ptr, u64* expected, u64 desired, katomic_order order) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, order, __ATOMIC_RELAXED);
+}
+
+// i64
+
+/** @brief Atomically loads the value at ptr. */
+KINLINE i64 katomic_load_i64(volatile i64* ptr, katomic_order order) {
+    return __atomic_load_n(ptr, order);
+}
+
+/** @brief Atomically stores the value to ptr. */
+KINLINE void katomic_store_i64(volatile i64* ptr, i64 value, katomic_order order) {
+    __atomic_store_n(ptr, value, order);
+}
+
+/** @copydoc katomic_compare_exchange_u32 */
+KINLINE b8 katomic_compare_exchange_i64(volatile i64* ptr, i64* expected, i64 desired, katomic_order order) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, order, __ATOMIC_RELAXED);
+}
+
+// Pointers
+
+/** @brief Atomically loads the pointer at ptr. */
+KINLINE void* katomic_load_ptr(void* volatile* ptr, katomic_order order) {
+    return __atomic_load_n(ptr, order);
+}
+
+/** @brief Atomically stores the pointer to ptr. */
+KINLINE void katomic_store_ptr(void* volatile* ptr, void* value, katomic_order order) {
+    __atomic_store_n(ptr, value, order);
+}
+
+/** @brief Atomically replaces the pointer at ptr, returning the previous value. */
+KINLINE void* katomic_exchange_ptr(void* volatile* ptr, void* value, katomic_order order) {
+    return __atomic_exchange_n(ptr, value, order);
+}
+
+/** @copydoc katomic_compare_exchange_u32 */
+KINLINE b8 katomic_compare_exchange_ptr(void* volatile* ptr, void** expected, void* desired, katomic_order order) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, order, __ATOMIC_RELAXED);
+}
+
+// Fences
+
+/** @brief Issues a memory fence with the given ordering. */
+KINLINE void katomic_thread_fence(katomic_order order) {
+    __atomic_thread_fence(order);
+}
+
+/** @brief Hints to the processor that the calling thread is in a spin-wait loop. */
+KINLINE void katomic_pause(void) {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
@@ -0,0 +1,184 @@
+#include "kcompress.h"
+
+#include "core/kmemory.h"
+
+// Matches shorter than this are never encoded.
+#define MIN_MATCH 4
+// The format requires the last bytes of a block to be literals, and the last match to
+// start a little before the end.
+#define LAST_LITERALS 5
+#define MATCH_FIND_LIMIT 12
+// The farthest back a match may refer to, given its 16-bit offset.
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+
+KINLINE u32 read_u32(const u8* p) {
+    u32 value;
+    kcopy_memory(&value, p, sizeof(u32));
+    return value;
+}
+
+KINLINE u32 hash_u32(u32 value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Writes the extra bytes of a length which didn't fit in its 4 bits of the token.
+KINLINE u8* write_length(u8* op, u64 length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (u8)length;
+    return op;
+}
+
+// Writes a sequence of literals followed by a match. A match_length of 0 ends the block.
+static u8* write_sequence(u8* op, u8* op_end, const u8* literals, u64 literal_length, u64 offset, u64 match_length) {
+    u64 match_extra = match_length ? match_length - MIN_MATCH : 0;
+    u64 required = 1 + (literal_length / 255 + 1) + literal_length + (match_length ? 2 + match_extra / 255 + 1 : 0);
+    if ((u64)(op_end - op) < required) {
+        return 0;
+    }
+
+    u8* token = op++;
+    if (literal_length >= 15) {
+        *token = 15 << 4;
+        op = write_length(op, literal_length - 15);
+    } else {
+        *token = (u8)(literal_length << 4);
+    }
+    kcopy_memory(op, literals, literal_length);
+    op += literal_length;
+
+    if (match_length) {
+        *op++ = (u8)(offset & 0xFF);
+        *op++ = (u8)(offset >> 8);
+        if (match_extra >= 15) {
+            *token |= 15;
+            op = write_length(op, match_extra - 15);
+        } else {
+            *token |= (u8)match_extra;
+        }
+    }
+    return op;
+}
+
+u64 kcompress_bound(u64 size) {
+    return size + size / 255 + 16;
+}
+
+u64 kcompress(const u8* source, u64 source_size, u8* dest, u64 dest_capacity) {
+    if (!source || !dest) {
+        return 0;
+    }
+
+    u8* op = dest;
+    u8* op_end = dest + dest_capacity;
+    u64 anchor = 0;
+
+    if (source_size > MATCH_FIND_LIMIT) {
+        // Most recent position of each hashed 4-byte sequence. Stale entries are weeded out
+        // by comparing the bytes.
+        u32 table[1 << HASH_BITS];
+        kzero_memory(table, sizeof(table));
+
+        u64 match_find_end = source_size - MATCH_FIND_LIMIT;
+        u64 match_end = source_size - LAST_LITERALS;
+        u64 ip = 0;
+        while (ip < match_find_end) {
+            u32 sequence = read_u32(source + ip);
+            u32 hash = hash_u32(sequence);
+            u64 ref = table[hash];
+            table[hash] = (u32)ip;
+            if (ref >= ip || ip - ref > MAX_OFFSET || read_u32(source + ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            u64 length = MIN_MATCH;
+            while (ip + length < match_end && source[ref + length] == source[ip + length]) {
+                length++;
+            }
+            op = write_sequence(op, op_end, source + anchor, ip - anchor, ip - ref, length);
+            if (!op) {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    op = write_sequence(op, op_end, source + anchor, source_size - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+    return (u64)(op - dest);
+}
+
+// Reads the extra bytes of a length. Returns false if the data ends first.
+KINLINE b8 read_length(const u8* source, u64 source_size, u64* ip, u64* length) {
+    u8 byte;
+    do {
+        if (*ip >= source_size) {
+            return false;
+        }
+        byte = source[(*ip)++];
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+b8 kdecompress(const u8* source, u64 source_size, u8* dest, u64 dest_size) {
+    if (!source || !dest) {
+        return false;
+    }
+
+    u64 ip = 0;
+    u64 op = 0;
+    while (ip < source_size) {
+        u8 token = source[ip++];
+
+        u64 literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(source, source_size, &ip, &literal_length)) {
+            return false;
+        }
+        if (literal_length > source_size - ip || literal_length > dest_size - op) {
+            return false;
+        }
+        kcopy_memory(dest + op, source + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence has no match.
+        if (ip == source_size) {
+            break;
+        }
+
+        if (source_size - ip < 2) {
+            return false;
+        }
+        u64 offset = (u64)source[ip] | ((u64)source[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        u64 match_length = token & 15;
+        if (match_length == 15 && !read_length(source, source_size, &ip, &match_length)) {
+            return false;
+        }
+        match_length += MIN_MATCH;
+        if (match_length > dest_size - op) {
+            return false;
+        }
+        // Matches may overlap the bytes they produce, so copy forwards one at a time.
+        const u8* match = dest + op - offset;
+        u8* out = dest + op;
+        for (u64 i = 0; i < match_length; ++i) {
+            out[i] = match[i];
+        }
+        op += match_length;
+    }
+
+    return op == dest_size;
+}
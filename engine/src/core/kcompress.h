@@ -0,0 +1,48 @@
+/**
+ * @file kcompress.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Lossless compression of blocks of data. Uses the LZ4 block format, which favours
+ * decompression speed over ratio, so compressed assets cost little more to load than raw ones.
+ * @version 1.0
+ * @date 2023-11-27
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief Returns the largest size data of the given size can compress to, for sizing
+ * the destination buffer passed to kcompress.
+ *
+ * @param size The size of the uncompressed data in bytes.
+ * @return The worst-case compressed size in bytes.
+ */
+KAPI u64 kcompress_bound(u64 size);
+
+/**
+ * @brief Compresses a block of data.
+ *
+ * @param source The data to be compressed. Required.
+ * @param source_size The size of the data in bytes.
+ * @param dest The buffer to hold the compressed data. Required.
+ * @param dest_capacity The size of dest in bytes. Compression is guaranteed to succeed if
+ * this is at least kcompress_bound(source_size).
+ * @return The size of the compressed data in bytes, or 0 if it didn't fit in dest.
+ */
+KAPI u64 kcompress(const u8* source, u64 source_size, u8* dest, u64 dest_capacity);
+
+/**
+ * @brief Decompresses a block of data compressed with kcompress. Malformed data is detected
+ * and rejected, and never causes reads or writes out of bounds.
+ *
+ * @param source The compressed data. Required.
+ * @param source_size The size of the compressed data in bytes.
+ * @param dest The buffer to hold the decompressed data. Required.
+ * @param dest_size The size of the decompressed data in bytes, which must be known up front.
+ * @return True if the data decompressed to exactly dest_size bytes; otherwise false.
+ */
+KAPI b8 kdecompress(const u8* source, u64 source_size, u8* dest, u64 dest_size);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "defines.h"
+
+struct kmutex;
+
+/**
+ * A condition variable to be used for synchronization purposes. A condition
+ * variable allows one or more threads to block until notified by another
+ * thread, atomically releasing the associated mutex while waiting. Note that
+ * spurious wakeups are possible, so waiters should always re-check the
+ * condition they are waiting on once woken.
+ */
+typedef struct kcondvar {
+    void *internal_data;
+} kcondvar;
+
+/**
+ * Creates a condition variable.
+ * @param out_condvar A pointer to hold the created condition variable.
+ * @returns True if created successfully; otherwise false.
+ */
+KAPI b8 kcondvar_create(kcondvar *out_condvar);
+
+/**
+ * @brief Destroys the provided condition variable.
+ *
+ * @param condvar A pointer to the condition variable to be destroyed.
+ */
+KAPI void kcondvar_destroy(kcondvar *condvar);
+
+/**
+ * Blocks the calling thread until the condition variable is signaled. The
+ * provided mutex must be locked by the calling thread, is released while
+ * waiting and is locked again before this function returns.
+ * @param condvar A pointer to the condition variable to wait on.
+ * @param mutex A pointer to the (locked) mutex guarding the condition.
+ * @returns True if woken successfully; otherwise false.
+ */
+KAPI b8 kcondvar_wait(kcondvar *condvar, struct kmutex *mutex);
+
+/**
+ * Blocks the calling thread until the condition variable is signaled or the
+ * timeout elapses. The provided mutex must be locked by the calling thread, is
+ * released while waiting and is locked again before this function returns.
+ * @param condvar A pointer to the condition variable to wait on.
+ * @param mutex A pointer to the (locked) mutex guarding the condition.
+ * @param timeout_ms The maximum amount of time to wait in milliseconds.
+ * @returns True if woken before the timeout elapsed; otherwise false.
+ */
+KAPI b8 kcondvar_wait_timeout(kcondvar *condvar, struct kmutex *mutex, u64 timeout_ms);
+
+/**
+ * Wakes a single thread waiting on the given condition variable, if any.
+ * @param condvar A pointer to the condition variable to signal.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 kcondvar_signal(kcondvar *condvar);
+
+/**
+ * Wakes all threads waiting on the given condition variable, if any.
+ * @param condvar A pointer to the condition variable to broadcast to.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 kcondvar_broadcast(kcondvar *condvar);
@@ -13,7 +13,10 @@
  * adding a new binding for "a", then "a"'s binding will work,
  * and "escape" will do nothing. If "escape" were left undefined
  * in the second keymap, the original mapping is left unchanged.
- * Maps are pushed/popped as expected on a stack.
+ * Maps are pushed/popped as expected on a stack. Each push or pop
+ * flattens the stack into a table of the bindings to invoke for each key
+ * and combination of held modifiers, so bindings added to a map after it
+ * has been pushed take effect once the stack next changes.
  * @version 1.0
  * @date 2023-01-18
  * 
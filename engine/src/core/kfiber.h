@@ -0,0 +1,57 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Represents a fiber: a stack and a saved execution context which a thread can switch to and
+ * from cooperatively, such that work can be suspended partway through and resumed later.
+ * Generally should not be created directly in user code.
+ * This calls to the platform-specific fiber implementation.
+ */
+typedef struct kfiber {
+    void *internal_data;
+} kfiber;
+
+/**
+ * A function pointer to be invoked when the fiber is first switched to. It must never return;
+ * instead, it should switch to another fiber once it is done, and is destroyed from there.
+ */
+typedef void (*pfn_fiber_start)(void *);
+
+/**
+ * Converts the calling thread to a fiber, so that it can switch to other fibers and be switched
+ * back to. Must be done before the thread switches to any fiber.
+ * @param out_fiber A pointer to hold the fiber of the thread. Required.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 kfiber_thread_convert(kfiber *out_fiber);
+
+/**
+ * Converts the calling thread back from a fiber, once it is done switching to fibers. Must be
+ * called from the thread while it is running the fiber obtained from kfiber_thread_convert.
+ * @param fiber A pointer to the fiber of the thread.
+ */
+KAPI void kfiber_thread_revert(kfiber *fiber);
+
+/**
+ * Creates a new fiber, which starts running the function pointed to when first switched to.
+ * @param start_function_ptr The pointer to the function to be invoked. Required.
+ * @param params A pointer to any data to be passed to the start_function_ptr. Optional. Pass 0/NULL if not used.
+ * @param stack_size The size of the stack of the fiber in bytes. Rounded up to whole pages.
+ * @param out_fiber A pointer to hold the created fiber.
+ * @returns True if successfully created; otherwise false.
+ */
+KAPI b8 kfiber_create(pfn_fiber_start start_function_ptr, void *params, u64 stack_size, kfiber *out_fiber);
+
+/**
+ * Destroys the given fiber, releasing its stack. Must not be the fiber currently running.
+ */
+KAPI void kfiber_destroy(kfiber *fiber);
+
+/**
+ * Saves the state of the calling fiber into from, and switches to run the fiber to, on the
+ * calling thread. Returns once some fiber switches back to from.
+ * @param from A pointer to the fiber currently running on the calling thread.
+ * @param to A pointer to the fiber to switch to. Must not be running on any thread.
+ */
+KAPI void kfiber_switch(kfiber *from, kfiber *to);
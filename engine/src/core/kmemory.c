@@ -1,5 +1,7 @@
 #include "kmemory.h"
 
+#include "core/console.h"
+#include "core/katomic.h"
 #include "core/kmutex.h"
 #include "core/kstring.h"
 #include "core/logger.h"
@@ -10,11 +12,43 @@
 #include <stdio.h>
 #include <string.h>
 
+// The functions themselves are defined here.
+#undef kallocate
+#undef kallocate_aligned
+
 struct memory_stats {
     u64 total_allocated;
     u64 tagged_allocations[MEMORY_TAG_MAX_TAGS];
+    u64 tagged_peaks[MEMORY_TAG_MAX_TAGS];
+    u64 tagged_counts[MEMORY_TAG_MAX_TAGS];
+    // Counted since the last kmemory_frame_end.
+    u64 tagged_frame_counts[MEMORY_TAG_MAX_TAGS];
+    u64 tagged_frame_bytes[MEMORY_TAG_MAX_TAGS];
+    // The counts of the last frame.
+    u64 tagged_last_frame_counts[MEMORY_TAG_MAX_TAGS];
+    u64 tagged_last_frame_bytes[MEMORY_TAG_MAX_TAGS];
 };
 
+typedef struct callsite_entry {
+    // 0 if the entry is unused.
+    const char* file;
+    u32 line;
+    memory_tag tag;
+    u64 allocation_count;
+    u64 allocated_bytes;
+    u64 frame_allocation_count;
+    u64 frame_allocated_bytes;
+    u64 last_frame_allocation_count;
+    u64 last_frame_allocated_bytes;
+} callsite_entry;
+
+// A violation of a no-alloc scope which has been reported, so that it isn't again.
+typedef struct no_alloc_report {
+    const char* scope;
+    const char* file;
+    u32 line;
+} no_alloc_report;
+
 static const char* memory_tag_strings[MEMORY_TAG_MAX_TAGS] = {
     "UNKNOWN    ",
     "ARRAY      ",
@@ -45,22 +79,265 @@ static const char* memory_tag_strings[MEMORY_TAG_MAX_TAGS] = {
     "KEYMAP     ",
     "HASHTABLE  ",
     "UI         ",
-    "AUDIO      "};
+    "AUDIO      ",
+    "PHYSICS    ",
+    "NETWORK    "};
 
 typedef struct memory_system_state {
     memory_system_configuration config;
+    // NOTE: Stats are updated atomically, since the thread caches below allocate/free without taking the mutex.
     struct memory_stats stats;
-    u64 alloc_count;
+    volatile u64 alloc_count;
     u64 allocator_memory_requirement;
     dynamic_allocator allocator;
     void* allocator_block;
+    // The size of the whole reserved block, including the state.
+    u64 reserved_size;
+    // Indicates if the block is backed by large pages.
+    b8 large_pages;
     // A mutex for allocations/frees
     kmutex allocation_mutex;
+
+    // Call-site tracking. The table is allocated from the platform the first time tracking is enabled.
+    volatile u32 callsite_tracking;
+    kmutex callsite_mutex;
+    callsite_entry* callsites;
+    u32 callsite_count;
+
+    // Allocations made inside no-alloc scopes, counted since the last kmemory_frame_end, and in the last frame.
+    volatile u64 no_alloc_violations;
+    u64 last_frame_no_alloc_violations;
+    // The violations reported so far. Guarded by the call-site mutex.
+    no_alloc_report no_alloc_reports[KMEMORY_NO_ALLOC_MAX_REPORTS];
+    u32 no_alloc_report_count;
 } memory_system_state;
 
 // Pointer to system state.
 static memory_system_state* state_ptr;
 
+// NOTE: Begin thread caches.
+
+/*
+Small, unaligned (alignment of 1) allocations are rounded up to a size class and served from a
+cache local to the calling thread. Caches are refilled from, and overflow back to, the dynamic
+allocator in batches, so the allocation mutex is only taken once per batch rather than on every
+call. Blocks freed on a different thread than they were allocated on simply move to that thread's
+cache. Since the dynamic allocator stores the (rounded) size with each block, the size class of a
+block can always be recovered from the block itself.
+*/
+
+// The smallest size class, in bytes. Must be able to hold a pointer for the intrusive free list.
+#define KMEMORY_CACHE_MIN_SIZE 16
+// The number of size classes, each double the last (16, 32, ... 512 bytes).
+#define KMEMORY_CACHE_CLASS_COUNT 6
+// The largest size class, in bytes. Anything bigger goes straight to the dynamic allocator.
+#define KMEMORY_CACHE_MAX_SIZE (KMEMORY_CACHE_MIN_SIZE << (KMEMORY_CACHE_CLASS_COUNT - 1))
+// The number of blocks moved between a thread cache and the dynamic allocator at once.
+#define KMEMORY_CACHE_BATCH_SIZE 16
+// The max number of blocks a thread cache holds per size class before returning a batch.
+#define KMEMORY_CACHE_MAX_BLOCKS (KMEMORY_CACHE_BATCH_SIZE * 4)
+
+typedef struct kmemory_thread_cache {
+    // Matched against memory_epoch to detect caches left over from a previous memory system instance.
+    u64 epoch;
+    // Intrusive singly-linked free lists, one per size class.
+    void* heads[KMEMORY_CACHE_CLASS_COUNT];
+    u32 counts[KMEMORY_CACHE_CLASS_COUNT];
+} kmemory_thread_cache;
+
+static _Thread_local kmemory_thread_cache thread_cache;
+// Incremented each time the memory system is initialized.
+static u64 memory_epoch = 0;
+
+// The deepest no-alloc scopes are named. Deeper ones still count, under the name of the deepest named one.
+#define KMEMORY_NO_ALLOC_MAX_DEPTH 16
+// How deep the no-alloc scopes of this thread are nested, and the name of each.
+static _Thread_local u32 no_alloc_depth = 0;
+static _Thread_local const char* no_alloc_scopes[KMEMORY_NO_ALLOC_MAX_DEPTH];
+
+// Returns the size class index for the given allocation, or -1 if it is not served by the caches.
+static i32 cache_class_index(u64 size, u16 alignment) {
+    if (alignment != 1 || size == 0 || size > KMEMORY_CACHE_MAX_SIZE) {
+        return -1;
+    }
+    i32 index = 0;
+    u64 class_size = KMEMORY_CACHE_MIN_SIZE;
+    while (class_size < size) {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+KINLINE u64 cache_class_size(i32 index) {
+    return (u64)KMEMORY_CACHE_MIN_SIZE << index;
+}
+
+// The size which gets tracked for the given allocation, which is the rounded size for cached allocations.
+static u64 tracked_size(u64 size, u16 alignment) {
+    i32 index = cache_class_index(size, alignment);
+    return index < 0 ? size : cache_class_size(index);
+}
+
+static kmemory_thread_cache* thread_cache_get(void) {
+    if (thread_cache.epoch != memory_epoch) {
+        // Anything held belongs to an allocator which no longer exists.
+        kzero_memory(&thread_cache, sizeof(kmemory_thread_cache));
+        thread_cache.epoch = memory_epoch;
+    }
+    return &thread_cache;
+}
+
+// Indicates if the given block lies within the memory of the dynamic allocator. Blocks from before the
+// system was initialized come from the platform, and have no allocator header to be read.
+static b8 block_in_allocator(void* block) {
+    u8* start = (u8*)state_ptr->allocator_block;
+    return (u8*)block >= start && (u8*)block < start + state_ptr->allocator_memory_requirement;
+}
+
+// Returns the size class index of the given block if it is one handed out by the caches; otherwise -1.
+static i32 cache_class_index_of_block(void* block) {
+    if (!block_in_allocator(block)) {
+        return -1;
+    }
+    u64 size;
+    u16 alignment;
+    dynamic_allocator_get_size_alignment(block, &size, &alignment);
+    i32 index = cache_class_index(size, alignment);
+    if (index < 0 || cache_class_size(index) != size) {
+        return -1;
+    }
+    return index;
+}
+
+// Refills the given size class of the cache from the dynamic allocator. Returns false if nothing could be allocated.
+static b8 thread_cache_refill(kmemory_thread_cache* cache, i32 index) {
+    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
+        KFATAL("Error obtaining mutex lock during allocation.");
+        return false;
+    }
+    u64 size = cache_class_size(index);
+    for (u32 i = 0; i < KMEMORY_CACHE_BATCH_SIZE; ++i) {
+        void* block = dynamic_allocator_allocate_aligned(&state_ptr->allocator, size, 1);
+        if (!block) {
+            break;
+        }
+        *(void**)block = cache->heads[index];
+        cache->heads[index] = block;
+        cache->counts[index]++;
+    }
+    kmutex_unlock(&state_ptr->allocation_mutex);
+    return cache->heads[index] != 0;
+}
+
+// Returns up to count blocks of the given size class from the cache to the dynamic allocator.
+static void thread_cache_release(kmemory_thread_cache* cache, i32 index, u32 count) {
+    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
+        KFATAL("Unable to obtain mutex lock for free operation. Heap corruption is likely.");
+        return;
+    }
+    for (u32 i = 0; i < count && cache->heads[index]; ++i) {
+        void* block = cache->heads[index];
+        cache->heads[index] = *(void**)block;
+        cache->counts[index]--;
+        dynamic_allocator_free_aligned(&state_ptr->allocator, block);
+    }
+    kmutex_unlock(&state_ptr->allocation_mutex);
+}
+
+void kmemory_thread_cache_flush(void) {
+    if (!state_ptr) {
+        return;
+    }
+    kmemory_thread_cache* cache = thread_cache_get();
+    for (i32 i = 0; i < KMEMORY_CACHE_CLASS_COUNT; ++i) {
+        if (cache->counts[i]) {
+            thread_cache_release(cache, i, cache->counts[i]);
+        }
+    }
+}
+
+// NOTE: End thread caches.
+
+static void track_allocation(u64 size, memory_tag tag) {
+    struct memory_stats* stats = &state_ptr->stats;
+    katomic_fetch_add_u64(&stats->total_allocated, size, KATOMIC_ORDER_RELAXED);
+    u64 allocated = katomic_fetch_add_u64(&stats->tagged_allocations[tag], size, KATOMIC_ORDER_RELAXED) + size;
+    katomic_fetch_add_u64(&state_ptr->alloc_count, 1, KATOMIC_ORDER_RELAXED);
+    katomic_fetch_add_u64(&stats->tagged_counts[tag], 1, KATOMIC_ORDER_RELAXED);
+    katomic_fetch_add_u64(&stats->tagged_frame_counts[tag], 1, KATOMIC_ORDER_RELAXED);
+    katomic_fetch_add_u64(&stats->tagged_frame_bytes[tag], size, KATOMIC_ORDER_RELAXED);
+
+    // Raise the high-water mark, unless another thread already raised it further.
+    u64 peak = katomic_load_u64(&stats->tagged_peaks[tag], KATOMIC_ORDER_RELAXED);
+    while (allocated > peak && !katomic_compare_exchange_u64(&stats->tagged_peaks[tag], &peak, allocated, KATOMIC_ORDER_RELAXED)) {
+    }
+}
+
+static u32 callsite_hash(const char* file, u32 line, memory_tag tag) {
+    u64 key = (u64)file ^ ((u64)line << 32) ^ ((u64)tag << 20);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (u32)key;
+}
+
+static void track_callsite(u64 size, memory_tag tag, const char* file, u32 line) {
+    if (!kmutex_lock(&state_ptr->callsite_mutex)) {
+        return;
+    }
+
+    // Open addressing. The table never shrinks, so a full table simply stops adding call sites.
+    if (state_ptr->callsites) {
+        u32 index = callsite_hash(file, line, tag) % KMEMORY_MAX_CALLSITES;
+        for (u32 probe = 0; probe < KMEMORY_MAX_CALLSITES; ++probe) {
+            callsite_entry* entry = &state_ptr->callsites[index];
+            if (!entry->file) {
+                if (state_ptr->callsite_count >= KMEMORY_MAX_CALLSITES * 3 / 4) {
+                    break;
+                }
+                entry->file = file;
+                entry->line = line;
+                entry->tag = tag;
+                state_ptr->callsite_count++;
+            }
+            if (entry->file == file && entry->line == line && entry->tag == tag) {
+                entry->allocation_count++;
+                entry->allocated_bytes += size;
+                entry->frame_allocation_count++;
+                entry->frame_allocated_bytes += size;
+                break;
+            }
+            index = (index + 1) % KMEMORY_MAX_CALLSITES;
+        }
+    }
+
+    kmutex_unlock(&state_ptr->callsite_mutex);
+}
+
+static void track_free(u64 size, memory_tag tag) {
+    katomic_fetch_sub_u64(&state_ptr->stats.total_allocated, size, KATOMIC_ORDER_RELAXED);
+    katomic_fetch_sub_u64(&state_ptr->stats.tagged_allocations[tag], size, KATOMIC_ORDER_RELAXED);
+    katomic_fetch_sub_u64(&state_ptr->alloc_count, 1, KATOMIC_ORDER_RELAXED);
+}
+
+// Tracks a change in the size of an allocation, which stays the one allocation.
+static void track_resize(u64 old_size, u64 new_size, memory_tag tag) {
+    struct memory_stats* stats = &state_ptr->stats;
+    if (new_size < old_size) {
+        katomic_fetch_sub_u64(&stats->total_allocated, old_size - new_size, KATOMIC_ORDER_RELAXED);
+        katomic_fetch_sub_u64(&stats->tagged_allocations[tag], old_size - new_size, KATOMIC_ORDER_RELAXED);
+        return;
+    }
+    u64 growth = new_size - old_size;
+    katomic_fetch_add_u64(&stats->total_allocated, growth, KATOMIC_ORDER_RELAXED);
+    u64 allocated = katomic_fetch_add_u64(&stats->tagged_allocations[tag], growth, KATOMIC_ORDER_RELAXED) + growth;
+    katomic_fetch_add_u64(&stats->tagged_frame_bytes[tag], growth, KATOMIC_ORDER_RELAXED);
+    u64 peak = katomic_load_u64(&stats->tagged_peaks[tag], KATOMIC_ORDER_RELAXED);
+    while (allocated > peak && !katomic_compare_exchange_u64(&stats->tagged_peaks[tag], &peak, allocated, KATOMIC_ORDER_RELAXED)) {
+    }
+}
+
 b8 memory_system_initialize(memory_system_configuration config) {
     // The amount needed by the system state.
     u64 state_memory_requirement = sizeof(memory_system_state);
@@ -69,10 +346,23 @@ b8 memory_system_initialize(memory_system_configuration config) {
     u64 alloc_requirement = 0;
     dynamic_allocator_create(config.total_alloc_size, &alloc_requirement, 0, 0);
 
-    // Call the platform allocator to get the memory for the whole system, including the state.
-    // TODO: memory alignment
-    void* block = platform_allocate(state_memory_requirement + alloc_requirement, true);
-    if (!block) {
+    // Reserve the address space for the whole system, including the state. Only the state is
+    // committed here; the allocator commits its own memory as it is used, so the engine takes up
+    // as much memory as it has allocated at most, not the whole of total_alloc_size.
+    u64 reserved_size = state_memory_requirement + alloc_requirement;
+    b8 large_pages = false;
+    void* block = 0;
+    if (config.large_pages) {
+        // Reserved as whole large pages, so it is released as them too.
+        u64 large_page_size = platform_memory_large_page_size();
+        if (large_page_size) {
+            reserved_size = (reserved_size + large_page_size - 1) & ~(large_page_size - 1);
+        }
+        block = platform_memory_reserve_large(reserved_size, &large_pages);
+    } else {
+        block = platform_memory_reserve(reserved_size);
+    }
+    if (!block || !platform_memory_commit(block, state_memory_requirement)) {
         KFATAL("Memory system allocation failed and the system cannot continue.");
         return false;
     }
@@ -82,14 +372,17 @@ b8 memory_system_initialize(memory_system_configuration config) {
     state_ptr->config = config;
     state_ptr->alloc_count = 0;
     state_ptr->allocator_memory_requirement = alloc_requirement;
+    state_ptr->reserved_size = reserved_size;
+    state_ptr->large_pages = large_pages;
     platform_zero_memory(&state_ptr->stats, sizeof(state_ptr->stats));
     // The allocator block is in the same block of memory, but after the state.
     state_ptr->allocator_block = ((void*)block + state_memory_requirement);
 
-    if (!dynamic_allocator_create(
+    if (!dynamic_allocator_create_reserved(
             config.total_alloc_size,
             &state_ptr->allocator_memory_requirement,
             state_ptr->allocator_block,
+            large_pages,
             &state_ptr->allocator)) {
         KFATAL("Memory system is unable to setup internal allocator. Application cannot continue.");
         return false;
@@ -100,7 +393,26 @@ b8 memory_system_initialize(memory_system_configuration config) {
         KFATAL("Unable to create allocation mutex!");
         return false;
     }
-
+    if (!kmutex_create(&state_ptr->callsite_mutex)) {
+        KFATAL("Unable to create call-site mutex!");
+        return false;
+    }
+    kmutex_name_set(&state_ptr->allocation_mutex, "memory allocation");
+    kmutex_name_set(&state_ptr->callsite_mutex, "memory call sites");
+    state_ptr->callsite_tracking = false;
+    state_ptr->callsites = 0;
+    state_ptr->callsite_count = 0;
+
+    // Invalidate any thread caches from a previous run.
+    memory_epoch++;
+
+    if (config.large_pages) {
+        if (large_pages) {
+            KINFO("Memory system is backed by large pages.");
+        } else {
+            KWARN("Large pages were requested for the memory system but not granted; using normal pages.");
+        }
+    }
     KDEBUG("Memory system successfully allocated %llu bytes.", config.total_alloc_size);
     return true;
 }
@@ -109,39 +421,101 @@ void memory_system_shutdown(void* state) {
     if (state_ptr) {
         // Destroy allocation mutex
         kmutex_destroy(&state_ptr->allocation_mutex);
+        kmutex_destroy(&state_ptr->callsite_mutex);
+        if (state_ptr->callsites) {
+            platform_free(state_ptr->callsites, false);
+        }
 
         dynamic_allocator_destroy(&state_ptr->allocator);
-        // Free the entire block.
-        platform_free(state_ptr, state_ptr->allocator_memory_requirement + sizeof(memory_system_state));
+        // Release the entire block.
+        platform_memory_release(state_ptr, state_ptr->reserved_size);
     }
     state_ptr = 0;
 }
 
 void* kallocate(u64 size, memory_tag tag) {
-    return kallocate_aligned(size, 1, tag);
+    return kallocate_aligned_at(size, 1, tag, 0, 0);
 }
 
 void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
+    return kallocate_aligned_at(size, alignment, tag, 0, 0);
+}
+
+// Counts an allocation made inside a no-alloc scope, and reports it the first time it is made
+// from its call site within the scope.
+static void no_alloc_violation(u64 size, memory_tag tag, const char* file, u32 line) {
+    katomic_fetch_add_u64(&state_ptr->no_alloc_violations, 1, KATOMIC_ORDER_RELAXED);
+    const char* scope = no_alloc_scopes[KMIN(no_alloc_depth, KMEMORY_NO_ALLOC_MAX_DEPTH) - 1];
+
+    // Reporting allocates (i.e. the logger's buffers), which mustn't count as violations itself.
+    u32 depth = no_alloc_depth;
+    no_alloc_depth = 0;
+
+    b8 report = false;
+    if (kmutex_lock(&state_ptr->callsite_mutex)) {
+        report = state_ptr->no_alloc_report_count < KMEMORY_NO_ALLOC_MAX_REPORTS;
+        for (u32 i = 0; report && i < state_ptr->no_alloc_report_count; ++i) {
+            const no_alloc_report* r = &state_ptr->no_alloc_reports[i];
+            report = !(r->scope == scope && r->file == file && r->line == line);
+        }
+        if (report) {
+            state_ptr->no_alloc_reports[state_ptr->no_alloc_report_count++] = (no_alloc_report){scope, file, line};
+        }
+        kmutex_unlock(&state_ptr->callsite_mutex);
+    }
+    if (report) {
+        char tag_name[16];
+        string_ncopy(tag_name, memory_tag_strings[tag], sizeof(tag_name) - 1);
+        tag_name[sizeof(tag_name) - 1] = 0;
+        if (file) {
+            KWARN("Allocation of %llu bytes (%s) in no-alloc scope '%s', at %s:%u:", size, string_trim(tag_name), scope, file, line);
+        } else {
+            KWARN("Allocation of %llu bytes (%s) in no-alloc scope '%s', from an unknown call site:", size, string_trim(tag_name), scope);
+        }
+        // Leaves out this function and the allocation function.
+        platform_stack_trace_print(2);
+    }
+
+    no_alloc_depth = depth;
+}
+
+void* kallocate_aligned_at(u64 size, u16 alignment, memory_tag tag, const char* file, u32 line) {
     if (tag == MEMORY_TAG_UNKNOWN) {
         KWARN("kallocate_aligned called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
+#if KMEMORY_NO_ALLOC_CHECKS == 1
+    if (no_alloc_depth && state_ptr) {
+        no_alloc_violation(size, tag, file, line);
+    }
+#endif
 
     // Either allocate from the system's allocator or the OS. The latter shouldn't ever
     // really happen.
     void* block = 0;
     if (state_ptr) {
-        // Make sure multithreaded requests don't trample each other.
-        if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-            KFATAL("Error obtaining mutex lock during allocation.");
-            return 0;
+        i32 class_index = cache_class_index(size, alignment);
+        if (class_index >= 0) {
+            // Small allocation, take it from this thread's cache.
+            kmemory_thread_cache* cache = thread_cache_get();
+            if (cache->heads[class_index] || thread_cache_refill(cache, class_index)) {
+                block = cache->heads[class_index];
+                cache->heads[class_index] = *(void**)block;
+                cache->counts[class_index]--;
+                track_allocation(cache_class_size(class_index), tag);
+            }
+        } else {
+            // Make sure multithreaded requests don't trample each other.
+            if (!kmutex_lock(&state_ptr->allocation_mutex)) {
+                KFATAL("Error obtaining mutex lock during allocation.");
+                return 0;
+            }
+
+            block = dynamic_allocator_allocate_aligned(&state_ptr->allocator, size, alignment);
+            kmutex_unlock(&state_ptr->allocation_mutex);
+            if (block) {
+                track_allocation(size, tag);
+            }
         }
-
-        state_ptr->stats.total_allocated += size;
-        state_ptr->stats.tagged_allocations[tag] += size;
-        state_ptr->alloc_count++;
-
-        block = dynamic_allocator_allocate_aligned(&state_ptr->allocator, size, alignment);
-        kmutex_unlock(&state_ptr->allocation_mutex);
     } else {
         // If the system is not up yet, warn about it but give memory for now.
         KTRACE("Warning: kallocate_aligned called before the memory system is initialized.");
@@ -150,6 +524,9 @@ void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
     }
 
     if (block) {
+        if (file && state_ptr && katomic_load_u32(&state_ptr->callsite_tracking, KATOMIC_ORDER_RELAXED)) {
+            track_callsite(size, tag, file, line);
+        }
         platform_zero_memory(block, size);
         return block;
     }
@@ -159,15 +536,9 @@ void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
 }
 
 void kallocate_report(u64 size, memory_tag tag) {
-    // Make sure multithreaded requests don't trample each other.
-    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-        KFATAL("Error obtaining mutex lock during allocation reporting.");
-        return;
+    if (state_ptr) {
+        track_allocation(size, tag);
     }
-    state_ptr->stats.total_allocated += size;
-    state_ptr->stats.tagged_allocations[tag] += size;
-    state_ptr->alloc_count++;
-    kmutex_unlock(&state_ptr->allocation_mutex);
 }
 
 void kfree(void* block, u64 size, memory_tag tag) {
@@ -179,15 +550,26 @@ void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag) {
         KWARN("kfree_aligned called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
     if (state_ptr) {
+        // Small blocks go back to this thread's cache, returning a batch if it is getting too big.
+        i32 class_index = cache_class_index_of_block(block);
+        if (class_index >= 0) {
+            track_free(tracked_size(size, alignment), tag);
+            kmemory_thread_cache* cache = thread_cache_get();
+            *(void**)block = cache->heads[class_index];
+            cache->heads[class_index] = block;
+            cache->counts[class_index]++;
+            if (cache->counts[class_index] > KMEMORY_CACHE_MAX_BLOCKS) {
+                thread_cache_release(cache, class_index, KMEMORY_CACHE_BATCH_SIZE * 2);
+            }
+            return;
+        }
+
         // Make sure multithreaded requests don't trample each other.
         if (!kmutex_lock(&state_ptr->allocation_mutex)) {
             KFATAL("Unable to obtain mutex lock for free operation. Heap corruption is likely.");
             return;
         }
 
-        state_ptr->stats.total_allocated -= size;
-        state_ptr->stats.tagged_allocations[tag] -= size;
-        state_ptr->alloc_count--;
         b8 result = dynamic_allocator_free_aligned(&state_ptr->allocator, block);
 
         kmutex_unlock(&state_ptr->allocation_mutex);
@@ -199,6 +581,8 @@ void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag) {
         if (!result) {
             // TODO: Memory alignment
             platform_free(block, false);
+        } else {
+            track_free(tracked_size(size, alignment), tag);
         }
     } else {
         // TODO: Memory alignment
@@ -206,26 +590,78 @@ void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag) {
     }
 }
 
+void* kreallocate(void* block, u64 old_size, u64 new_size, memory_tag tag) {
+    return kreallocate_aligned(block, old_size, new_size, 1, tag);
+}
+
+void* kreallocate_aligned(void* block, u64 old_size, u64 new_size, u16 alignment, memory_tag tag) {
+    if (!block) {
+        return kallocate_aligned(new_size, alignment, tag);
+    }
+    if (!new_size) {
+        kfree_aligned(block, old_size, alignment, tag);
+        return 0;
+    }
+    if (new_size == old_size) {
+        return block;
+    }
+
+    if (state_ptr) {
+        i32 old_class = cache_class_index_of_block(block);
+        i32 new_class = cache_class_index(new_size, alignment);
+        if (old_class >= 0 && old_class == new_class) {
+            // Still fits the same size class, so nothing needs to move.
+            track_resize(tracked_size(old_size, alignment), tracked_size(new_size, alignment), tag);
+            if (new_size > old_size) {
+                platform_zero_memory((u8*)block + old_size, new_size - old_size);
+            }
+            return block;
+        }
+
+        u8* start = (u8*)state_ptr->allocator_block;
+        b8 in_allocator = (u8*)block >= start && (u8*)block < start + state_ptr->allocator_memory_requirement;
+        if (in_allocator && old_class < 0 && new_class < 0) {
+            // The allocator resizes in place where it can, and otherwise moves the block itself,
+            // all under a single lock.
+            if (!kmutex_lock(&state_ptr->allocation_mutex)) {
+                KFATAL("Error obtaining mutex lock during reallocation.");
+                return 0;
+            }
+            void* new_block = dynamic_allocator_reallocate(&state_ptr->allocator, block, new_size);
+            kmutex_unlock(&state_ptr->allocation_mutex);
+            if (!new_block) {
+                KFATAL("kreallocate_aligned failed to reallocate successfully.");
+                return 0;
+            }
+            track_resize(old_size, new_size, tag);
+            if (new_size > old_size) {
+                platform_zero_memory((u8*)new_block + old_size, new_size - old_size);
+            }
+            return new_block;
+        }
+    }
+
+    // Moving between the thread caches and the allocator, or to or from the platform.
+    void* new_block = kallocate_aligned(new_size, alignment, tag);
+    if (new_block) {
+        kcopy_memory(new_block, block, KMIN(old_size, new_size));
+        kfree_aligned(block, old_size, alignment, tag);
+    }
+    return new_block;
+}
+
 void kfree_report(u64 size, memory_tag tag) {
-    // Make sure multithreaded requests don't trample each other.
-    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-        KFATAL("Error obtaining mutex lock during allocation reporting.");
-        return;
+    if (state_ptr) {
+        track_free(size, tag);
     }
-    state_ptr->stats.total_allocated -= size;
-    state_ptr->stats.tagged_allocations[tag] -= size;
-    state_ptr->alloc_count--;
-    kmutex_unlock(&state_ptr->allocation_mutex);
 }
 
 b8 kmemory_get_size_alignment(void* block, u64* out_size, u16* out_alignment) {
-    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-        KFATAL("Error obtaining mutex lock during kmemory_get_size_alignment.");
+    if (!state_ptr || !block_in_allocator(block)) {
         return false;
     }
-    b8 result = dynamic_allocator_get_size_alignment(block, out_size, out_alignment);
-    kmutex_unlock(&state_ptr->allocation_mutex);
-    return result;
+    // NOTE: No lock needed, as the size and alignment are stored with the block, which is owned by the caller.
+    return dynamic_allocator_get_size_alignment(block, out_size, out_alignment);
 }
 
 void* kzero_memory(void* block, u64 size) {
@@ -262,8 +698,12 @@ char* get_memory_usage_str(void) {
     for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
         f32 amount = 1.0f;
         const char* unit = get_unit_for_size(state_ptr->stats.tagged_allocations[i], &amount);
+        f32 peak_amount = 1.0f;
+        const char* peak_unit = get_unit_for_size(state_ptr->stats.tagged_peaks[i], &peak_amount);
+        f32 frame_amount = 1.0f;
+        const char* frame_unit = get_unit_for_size(state_ptr->stats.tagged_last_frame_bytes[i], &frame_amount);
 
-        i32 length = snprintf(buffer + offset, 8000, "  %s: %.2f%s\n", memory_tag_strings[i], amount, unit);
+        i32 length = snprintf(buffer + offset, 8000 - offset, "  %s: %.2f%s (peak %.2f%s, last frame %llu allocs/%.2f%s)\n", memory_tag_strings[i], amount, unit, peak_amount, peak_unit, state_ptr->stats.tagged_last_frame_counts[i], frame_amount, frame_unit);
         offset += length;
     }
     {
@@ -280,7 +720,14 @@ char* get_memory_usage_str(void) {
 
         f64 percent_used = (f64)(used_space) / total_space;
 
-        i32 length = snprintf(buffer + offset, 8000, "Total memory usage: %.2f%s of %.2f%s (%.2f%%)\n", used_amount, used_unit, total_amount, total_unit, percent_used);
+        i32 length = snprintf(buffer + offset, 8000 - offset, "Total memory usage: %.2f%s of %.2f%s (%.2f%%)\n", used_amount, used_unit, total_amount, total_unit, percent_used);
+        offset += length;
+
+        f32 fragmentation = dynamic_allocator_fragmentation(&state_ptr->allocator);
+        length = snprintf(buffer + offset, 8000 - offset, "Free space fragmentation: %.2f%%\n", fragmentation * 100.0f);
+        offset += length;
+
+        length = snprintf(buffer + offset, 8000 - offset, "Large pages: %s\n", state_ptr->large_pages ? "yes" : "no");
         offset += length;
     }
 
@@ -288,9 +735,195 @@ char* get_memory_usage_str(void) {
     return out_string;
 }
 
+b8 kmemory_large_pages_get(void) {
+    return state_ptr ? state_ptr->large_pages : false;
+}
+
 u64 get_memory_alloc_count(void) {
     if (state_ptr) {
         return state_ptr->alloc_count;
     }
     return 0;
 }
+
+void kmemory_frame_end(void) {
+    if (!state_ptr) {
+        return;
+    }
+
+    struct memory_stats* stats = &state_ptr->stats;
+    for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
+        stats->tagged_last_frame_counts[i] = katomic_exchange_u64(&stats->tagged_frame_counts[i], 0, KATOMIC_ORDER_RELAXED);
+        stats->tagged_last_frame_bytes[i] = katomic_exchange_u64(&stats->tagged_frame_bytes[i], 0, KATOMIC_ORDER_RELAXED);
+    }
+    state_ptr->last_frame_no_alloc_violations = katomic_exchange_u64(&state_ptr->no_alloc_violations, 0, KATOMIC_ORDER_RELAXED);
+
+    if (state_ptr->callsites && kmutex_lock(&state_ptr->callsite_mutex)) {
+        for (u32 i = 0; i < KMEMORY_MAX_CALLSITES; ++i) {
+            callsite_entry* entry = &state_ptr->callsites[i];
+            entry->last_frame_allocation_count = entry->frame_allocation_count;
+            entry->last_frame_allocated_bytes = entry->frame_allocated_bytes;
+            entry->frame_allocation_count = 0;
+            entry->frame_allocated_bytes = 0;
+        }
+        kmutex_unlock(&state_ptr->callsite_mutex);
+    }
+}
+
+void kmemory_tag_stats_get(memory_tag tag, kmemory_tag_stats* out_stats) {
+    kzero_memory(out_stats, sizeof(kmemory_tag_stats));
+    if (!state_ptr || tag >= MEMORY_TAG_MAX_TAGS) {
+        return;
+    }
+
+    const struct memory_stats* stats = &state_ptr->stats;
+    out_stats->allocated_bytes = stats->tagged_allocations[tag];
+    out_stats->peak_bytes = stats->tagged_peaks[tag];
+    out_stats->allocation_count = stats->tagged_counts[tag];
+    out_stats->frame_allocation_count = stats->tagged_last_frame_counts[tag];
+    out_stats->frame_allocated_bytes = stats->tagged_last_frame_bytes[tag];
+}
+
+void kmemory_no_alloc_scope_begin(const char* name) {
+    if (no_alloc_depth < KMEMORY_NO_ALLOC_MAX_DEPTH) {
+        no_alloc_scopes[no_alloc_depth] = name ? name : "unnamed";
+    }
+    no_alloc_depth++;
+}
+
+void kmemory_no_alloc_scope_end(void) {
+    if (no_alloc_depth) {
+        no_alloc_depth--;
+    } else {
+        KWARN("kmemory_no_alloc_scope_end called without a matching kmemory_no_alloc_scope_begin.");
+    }
+}
+
+u64 kmemory_no_alloc_violations_get(void) {
+    return state_ptr ? state_ptr->last_frame_no_alloc_violations : 0;
+}
+
+u64 kmemory_frame_allocation_count_get(void) {
+    if (!state_ptr) {
+        return 0;
+    }
+    u64 count = 0;
+    for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
+        count += state_ptr->stats.tagged_last_frame_counts[i];
+    }
+    return count;
+}
+
+void kmemory_callsite_tracking_set(b8 enabled) {
+    if (!state_ptr || !kmutex_lock(&state_ptr->callsite_mutex)) {
+        return;
+    }
+
+    if (enabled) {
+        // NOTE: The table comes from the platform, so that it doesn't show up in the stats it gathers.
+        u64 table_size = sizeof(callsite_entry) * KMEMORY_MAX_CALLSITES;
+        if (!state_ptr->callsites) {
+            state_ptr->callsites = platform_allocate(table_size, false);
+        }
+        if (state_ptr->callsites) {
+            platform_zero_memory(state_ptr->callsites, table_size);
+        }
+        state_ptr->callsite_count = 0;
+    }
+    katomic_store_u32(&state_ptr->callsite_tracking, (enabled && state_ptr->callsites) ? 1 : 0, KATOMIC_ORDER_RELAXED);
+
+    kmutex_unlock(&state_ptr->callsite_mutex);
+}
+
+u32 kmemory_callsites_get(kmemory_callsite* out_callsites, u32 max_count) {
+    if (!state_ptr || !state_ptr->callsites || !max_count || !kmutex_lock(&state_ptr->callsite_mutex)) {
+        return 0;
+    }
+
+    // An insertion sort, keeping only the max_count busiest.
+    u32 count = 0;
+    for (u32 i = 0; i < KMEMORY_MAX_CALLSITES; ++i) {
+        const callsite_entry* entry = &state_ptr->callsites[i];
+        if (!entry->file || !entry->last_frame_allocation_count) {
+            continue;
+        }
+        if (count == max_count && entry->last_frame_allocation_count <= out_callsites[count - 1].frame_allocation_count) {
+            continue;
+        }
+
+        u32 position = count < max_count ? count++ : count - 1;
+        while (position > 0 && out_callsites[position - 1].frame_allocation_count < entry->last_frame_allocation_count) {
+            out_callsites[position] = out_callsites[position - 1];
+            position--;
+        }
+        kmemory_callsite* callsite = &out_callsites[position];
+        callsite->file = entry->file;
+        callsite->line = entry->line;
+        callsite->tag = entry->tag;
+        callsite->allocation_count = entry->allocation_count;
+        callsite->allocated_bytes = entry->allocated_bytes;
+        callsite->frame_allocation_count = entry->last_frame_allocation_count;
+        callsite->frame_allocated_bytes = entry->last_frame_allocated_bytes;
+    }
+
+    kmutex_unlock(&state_ptr->callsite_mutex);
+    return count;
+}
+
+static void kmemory_console_command_print(console_command_context context) {
+    char* usage = get_memory_usage_str();
+    console_write_line(LOG_LEVEL_INFO, usage);
+    string_free(usage);
+}
+
+static void kmemory_console_command_callsites(console_command_context context) {
+    i32 enabled = 0;
+    if (!string_to_i32(context.arguments[0].value, &enabled)) {
+        console_write_line(LOG_LEVEL_ERROR, "memory_callsites requires 0 or 1.");
+        return;
+    }
+    kmemory_callsite_tracking_set(enabled != 0);
+    console_write_line(LOG_LEVEL_INFO, enabled ? "Allocation call-site tracking enabled." : "Allocation call-site tracking disabled.");
+}
+
+static void kmemory_console_command_hot_print(console_command_context context) {
+    if (!state_ptr || !katomic_load_u32(&state_ptr->callsite_tracking, KATOMIC_ORDER_RELAXED)) {
+        console_write_line(LOG_LEVEL_INFO, "Call-site tracking is disabled. Enable it with 'memory_callsites 1'.");
+        return;
+    }
+
+    kmemory_callsite callsites[20];
+    u32 count = kmemory_callsites_get(callsites, 20);
+    if (!count) {
+        console_write_line(LOG_LEVEL_INFO, "Nothing was allocated in the last frame.");
+        return;
+    }
+
+    char line[512];
+    console_write_line(LOG_LEVEL_INFO, "Allocations in the last frame, by call site:");
+    for (u32 i = 0; i < count; ++i) {
+        f32 amount = 1.0f;
+        const char* unit = get_unit_for_size(callsites[i].frame_allocated_bytes, &amount);
+        string_format(line, "%6llu allocs %8.2f%-3s %s %s:%u", callsites[i].frame_allocation_count, amount, unit, memory_tag_strings[callsites[i].tag], callsites[i].file, callsites[i].line);
+        console_write_line(LOG_LEVEL_INFO, line);
+    }
+}
+
+static void kmemory_console_command_noalloc_print(console_command_context context) {
+    char line[256];
+    string_format(line, "Last frame: %llu heap allocations, %llu in no-alloc scopes.", kmemory_frame_allocation_count_get(), kmemory_no_alloc_violations_get());
+    console_write_line(LOG_LEVEL_INFO, line);
+
+    // Violations already reported are reported again from here on.
+    if (state_ptr && kmutex_lock(&state_ptr->callsite_mutex)) {
+        state_ptr->no_alloc_report_count = 0;
+        kmutex_unlock(&state_ptr->callsite_mutex);
+    }
+}
+
+void kmemory_console_commands_register(void) {
+    console_command_register("memory_print", 0, kmemory_console_command_print);
+    console_command_register("memory_callsites", 1, kmemory_console_command_callsites);
+    console_command_register("memory_hot_print", 0, kmemory_console_command_hot_print);
+    console_command_register("memory_noalloc_print", 0, kmemory_console_command_noalloc_print);
+}
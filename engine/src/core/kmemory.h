@@ -52,26 +52,91 @@ typedef enum memory_tag {
     MEMORY_TAG_HASHTABLE,
     MEMORY_TAG_UI,
     MEMORY_TAG_AUDIO,
+    MEMORY_TAG_PHYSICS,
+    MEMORY_TAG_NETWORK,
 
     MEMORY_TAG_MAX_TAGS
 } memory_tag;
 
+#ifndef KMEMORY_CALLSITES
+#ifdef _DEBUG
+/** @brief Indicates if allocations pass their file and line along, so that call-site tracking can be enabled. */
+#define KMEMORY_CALLSITES 1
+#else
+/** @brief Indicates if allocations pass their file and line along, so that call-site tracking can be enabled. */
+#define KMEMORY_CALLSITES 0
+#endif
+#endif
+
+/** @brief The most call sites tracked at once. Allocations from further call sites are not tracked. */
+#define KMEMORY_MAX_CALLSITES 4096
+
+#ifndef KMEMORY_NO_ALLOC_CHECKS
+#if KRELEASE == 1 && !(defined(KPROFILE_ENABLED) && KPROFILE_ENABLED == 1)
+/** @brief Indicates if allocations are checked against no-alloc scopes. On in debug and profiling builds. */
+#define KMEMORY_NO_ALLOC_CHECKS 0
+#else
+/** @brief Indicates if allocations are checked against no-alloc scopes. On in debug and profiling builds. */
+#define KMEMORY_NO_ALLOC_CHECKS 1
+#endif
+#endif
+
+/** @brief The most distinct violations of no-alloc scopes reported. Further ones are still counted. */
+#define KMEMORY_NO_ALLOC_MAX_REPORTS 256
+
+/** @brief Allocation statistics of a single memory tag. */
+typedef struct kmemory_tag_stats {
+    /** @brief The number of bytes currently allocated. */
+    u64 allocated_bytes;
+    /** @brief The most bytes allocated at once since the memory system was initialized. */
+    u64 peak_bytes;
+    /** @brief The number of allocations made since the memory system was initialized. */
+    u64 allocation_count;
+    /** @brief The number of allocations made in the last frame. */
+    u64 frame_allocation_count;
+    /** @brief The number of bytes allocated in the last frame. */
+    u64 frame_allocated_bytes;
+} kmemory_tag_stats;
+
+/** @brief Allocation statistics of a single call site. Only gathered when call-site tracking is enabled. */
+typedef struct kmemory_callsite {
+    /** @brief The file the allocation is made in. */
+    const char* file;
+    /** @brief The line the allocation is made on. */
+    u32 line;
+    /** @brief The tag of the allocations. */
+    memory_tag tag;
+    /** @brief The number of allocations made since tracking was enabled. */
+    u64 allocation_count;
+    /** @brief The number of bytes allocated since tracking was enabled. */
+    u64 allocated_bytes;
+    /** @brief The number of allocations made in the last frame. */
+    u64 frame_allocation_count;
+    /** @brief The number of bytes allocated in the last frame. */
+    u64 frame_allocated_bytes;
+} kmemory_callsite;
+
 /** @brief The configuration for the memory system. */
 typedef struct memory_system_configuration {
     /** @brief The total memory size in byes used by the internal allocator for this system. */
     u64 total_alloc_size;
+    /**
+     * @brief Indicates if the allocator's memory should be backed by large pages, which cut down on
+     * TLB misses. Falls back to normal pages if they are not granted; see kmemory_large_pages_get.
+     */
+    b8 large_pages;
 } memory_system_configuration;
 
 /**
  * @brief Initializes the memory system.
  * @param config The configuration for this system.
  */
-b8 memory_system_initialize(memory_system_configuration config);
+KAPI b8 memory_system_initialize(memory_system_configuration config);
 
 /**
  * @brief Shuts down the memory system.
  */
-void memory_system_shutdown(void* state);
+KAPI void memory_system_shutdown(void* state);
 
 /**
  * @brief Performs a memory allocation from the host of the given size. The allocation
@@ -93,6 +158,24 @@ KAPI void* kallocate(u64 size, memory_tag tag);
  */
 KAPI void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag);
 
+/**
+ * @brief Performs an aligned memory allocation, as kallocate_aligned, recording the call site
+ * it was made from if call-site tracking is enabled. When KMEMORY_CALLSITES is enabled,
+ * kallocate and kallocate_aligned call this with the file and line they are called from.
+ * @param size The size of the allocation.
+ * @param alignment The alignment in bytes.
+ * @param tag Indicates the use of the allocated block.
+ * @param file The file the allocation is made in. Must be a string literal, such as __FILE__.
+ * @param line The line the allocation is made on.
+ * @returns If successful, a pointer to a block of allocated memory; otherwise 0.
+ */
+KAPI void* kallocate_aligned_at(u64 size, u16 alignment, memory_tag tag, const char* file, u32 line);
+
+#if KMEMORY_CALLSITES == 1
+#define kallocate(size, tag) kallocate_aligned_at(size, 1, tag, __FILE__, __LINE__)
+#define kallocate_aligned(size, alignment, tag) kallocate_aligned_at(size, alignment, tag, __FILE__, __LINE__)
+#endif
+
 /**
  * @brief Reports an allocation associated with the application, but made externally.
  * This can be done for items allocated within 3rd party libraries, for example, to
@@ -119,6 +202,31 @@ KAPI void kfree(void* block, u64 size, memory_tag tag);
  */
 KAPI void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag);
 
+/**
+ * @brief Changes the size of the given block, keeping its contents up to the smaller of the
+ * two sizes, and tracks the change against the given tag. The block is grown in place where the
+ * memory after it is free, and only moved to a new block otherwise. Any bytes beyond the old size
+ * are zeroed, as kallocate does.
+ * @param block A pointer to the block to be resized. If 0, a new block is allocated.
+ * @param old_size The current size of the block.
+ * @param new_size The new size of the block. If 0, the block is freed.
+ * @param tag The tag indicating the block's use.
+ * @returns A pointer to the block, which may have moved, or 0 if it was freed or the reallocation failed.
+ */
+KAPI void* kreallocate(void* block, u64 old_size, u64 new_size, memory_tag tag);
+
+/**
+ * @brief Changes the size of a block allocated with kallocate_aligned, as kreallocate does,
+ * keeping its alignment.
+ * @param block A pointer to the block to be resized. If 0, a new block is allocated.
+ * @param old_size The current size of the block.
+ * @param new_size The new size of the block. If 0, the block is freed.
+ * @param alignment The alignment the block was allocated with.
+ * @param tag The tag indicating the block's use.
+ * @returns A pointer to the block, which may have moved, or 0 if it was freed or the reallocation failed.
+ */
+KAPI void* kreallocate_aligned(void* block, u64 old_size, u64 new_size, u16 alignment, memory_tag tag);
+
 /**
  * @brief Reports a free associated with the application, but made externally.
  * This can be done for items allocated within 3rd party libraries, for example, to
@@ -129,6 +237,13 @@ KAPI void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag);
  */
 KAPI void kfree_report(u64 size, memory_tag tag);
 
+/**
+ * @brief Returns all blocks held in the calling thread's allocation cache to the memory system.
+ * Small allocations are served from per-thread caches, so this should be called by threads
+ * (other than the main thread) before they exit, to avoid the cached blocks being lost.
+ */
+KAPI void kmemory_thread_cache_flush(void);
+
 /**
  * @brief Returns the size and alignment of the given block of memory.
  * NOTE: A failure result from this method most likely indicates heap corruption.
@@ -179,3 +294,86 @@ KAPI char* get_memory_usage_str(void);
  * @returns The total count of allocations since the system's initialization.
  */
 KAPI u64 get_memory_alloc_count(void);
+
+/**
+ * @brief Indicates if the memory system's allocator is backed by large pages.
+ * @returns True if large pages were asked for and granted; otherwise false.
+ */
+KAPI b8 kmemory_large_pages_get(void);
+
+/**
+ * @brief Ends the allocation counters of the frame; those counted since the last call become
+ * the last frame's. Called by the engine once per frame.
+ */
+KAPI void kmemory_frame_end(void);
+
+/**
+ * @brief Gets the allocation statistics of the given tag.
+ *
+ * @param tag The tag to get statistics for.
+ * @param out_stats A pointer to hold the statistics.
+ */
+KAPI void kmemory_tag_stats_get(memory_tag tag, kmemory_tag_stats* out_stats);
+
+/**
+ * @brief Enables or disables tracking of the call sites allocations are made from. Only
+ * allocations made from files compiled with KMEMORY_CALLSITES enabled are tracked. Tracking
+ * takes a lock on every allocation, so is disabled by default.
+ *
+ * @param enabled True to enable tracking; false to disable it. Enabling clears any previously tracked call sites.
+ */
+KAPI void kmemory_callsite_tracking_set(b8 enabled);
+
+/**
+ * @brief Gets the call sites which allocated the most times in the last frame, most first.
+ * Call sites which did not allocate in the last frame are not included.
+ *
+ * @param out_callsites An array of at least max_count elements to hold the call sites.
+ * @param max_count The most call sites to get.
+ * @return The number of call sites written to out_callsites.
+ */
+KAPI u32 kmemory_callsites_get(kmemory_callsite* out_callsites, u32 max_count);
+
+/**
+ * @brief Begins a no-alloc scope on the calling thread. Until it ends, every allocation made by the
+ * thread through the memory system is a violation. Each violation is counted, and the first from
+ * each call site within each scope is reported with its tag, call site and stack trace. Scopes
+ * nest; the innermost names the violations. Use KMEMORY_NO_ALLOC_BEGIN, which compiles out when
+ * KMEMORY_NO_ALLOC_CHECKS is disabled. Frame and scratch allocations are not violations.
+ *
+ * @param name The name of the scope, reported with its violations. Must outlive the scope, such as a string literal.
+ */
+KAPI void kmemory_no_alloc_scope_begin(const char* name);
+
+/**
+ * @brief Ends the innermost no-alloc scope of the calling thread.
+ */
+KAPI void kmemory_no_alloc_scope_end(void);
+
+/**
+ * @brief Gets the number of allocations made inside no-alloc scopes in the last frame.
+ * @returns The number of violations in the last frame.
+ */
+KAPI u64 kmemory_no_alloc_violations_get(void);
+
+/**
+ * @brief Gets the number of allocations made through the memory system in the last frame, of any
+ * tag. Frame and scratch allocations, which don't go through it, are not counted.
+ * @returns The number of heap allocations in the last frame.
+ */
+KAPI u64 kmemory_frame_allocation_count_get(void);
+
+#if KMEMORY_NO_ALLOC_CHECKS == 1
+/** @brief Begins a no-alloc scope of the given name on the calling thread. */
+#define KMEMORY_NO_ALLOC_BEGIN(name) kmemory_no_alloc_scope_begin(name)
+/** @brief Ends the innermost no-alloc scope of the calling thread. */
+#define KMEMORY_NO_ALLOC_END() kmemory_no_alloc_scope_end()
+#else
+#define KMEMORY_NO_ALLOC_BEGIN(name)
+#define KMEMORY_NO_ALLOC_END()
+#endif
+
+/**
+ * @brief Registers the memory console commands. Called once the console is available.
+ */
+KAPI void kmemory_console_commands_register(void);
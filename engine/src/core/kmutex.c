@@ -0,0 +1,226 @@
+#include "kmutex.h"
+
+#include "core/console.h"
+#include "core/katomic.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#define KMUTEX_NAME_MAX_LENGTH 64
+
+// The lock statistics of a single named mutex. Apart from the in_use flag, these are only written
+// by the thread holding the mutex, so need no synchronization of their own.
+typedef struct kmutex_stats {
+    volatile u32 in_use;
+    char name[KMUTEX_NAME_MAX_LENGTH];
+    // The name of the profiler zone covering a contended wait.
+    char wait_zone_name[KMUTEX_NAME_MAX_LENGTH + 16];
+
+    u64 lock_count;
+    u64 contended_count;
+    f64 wait_time_total;
+    f64 wait_time_max;
+    f64 hold_time_total;
+    f64 hold_time_max;
+
+    // The number of times the owning thread has locked the recursive mutex, and when it first did.
+    u32 depth;
+    f64 hold_start;
+} kmutex_stats;
+
+#if KMUTEX_INSTRUMENTED == 1
+static kmutex_stats stats_pool[KMUTEX_STATS_MAX_COUNT];
+
+// Set while the profiler is being called, as it may lock named mutexes itself.
+static _Thread_local b8 in_profiler = false;
+// Set while a wait zone is open on this thread.
+static _Thread_local b8 wait_zone_open = false;
+
+f64 kmutex_stats_contended(kmutex *mutex) {
+    kmutex_stats *stats = mutex->stats;
+    if (!in_profiler) {
+        in_profiler = true;
+        KPROFILE_BEGIN(stats->wait_zone_name);
+        in_profiler = false;
+        wait_zone_open = true;
+    }
+    return platform_get_absolute_time();
+}
+
+void kmutex_stats_acquired(kmutex *mutex, f64 wait_start) {
+    kmutex_stats *stats = mutex->stats;
+    if (!stats) {
+        return;
+    }
+    stats->depth++;
+
+    f64 now = 0;
+    if (wait_start != 0 || stats->depth == 1) {
+        now = platform_get_absolute_time();
+    }
+    if (wait_start != 0) {
+        f64 wait_time = now - wait_start;
+        stats->contended_count++;
+        stats->wait_time_total += wait_time;
+        stats->wait_time_max = KMAX(stats->wait_time_max, wait_time);
+        if (wait_zone_open && !in_profiler) {
+            wait_zone_open = false;
+            in_profiler = true;
+            KPROFILE_END();
+            in_profiler = false;
+        }
+    }
+    // Recursive locks count once, from the outermost lock to its unlock.
+    if (stats->depth == 1) {
+        stats->lock_count++;
+        stats->hold_start = now;
+    }
+}
+
+void kmutex_stats_releasing(kmutex *mutex) {
+    kmutex_stats *stats = mutex->stats;
+    if (!stats || stats->depth == 0) {
+        return;
+    }
+    if (stats->depth == 1) {
+        f64 hold_time = platform_get_absolute_time() - stats->hold_start;
+        stats->hold_time_total += hold_time;
+        stats->hold_time_max = KMAX(stats->hold_time_max, hold_time);
+    }
+    stats->depth--;
+}
+
+void kmutex_stats_release(kmutex *mutex) {
+    if (mutex && mutex->stats) {
+        katomic_store_u32(&mutex->stats->in_use, 0, KATOMIC_ORDER_RELEASE);
+        mutex->stats = 0;
+    }
+}
+#endif
+
+void kmutex_name_set(kmutex *mutex, const char *name) {
+#if KMUTEX_INSTRUMENTED == 1
+    if (!mutex || !name) {
+        return;
+    }
+    if (!mutex->stats) {
+        // Statically allocated, as the allocator's own mutex is among those named.
+        for (u32 i = 0; i < KMUTEX_STATS_MAX_COUNT; ++i) {
+            u32 expected = 0;
+            if (katomic_compare_exchange_u32(&stats_pool[i].in_use, &expected, 1, KATOMIC_ORDER_ACQ_REL)) {
+                kmutex_stats *stats = &stats_pool[i];
+                kzero_memory(stats->name, sizeof(stats->name));
+                stats->lock_count = stats->contended_count = 0;
+                stats->wait_time_total = stats->wait_time_max = 0;
+                stats->hold_time_total = stats->hold_time_max = 0;
+                stats->depth = 0;
+                mutex->stats = stats;
+                break;
+            }
+        }
+        if (!mutex->stats) {
+            KWARN("kmutex_name_set - Out of mutex statistics (%u). Mutex '%s' will not be instrumented.", KMUTEX_STATS_MAX_COUNT, name);
+            return;
+        }
+    }
+    string_ncopy(mutex->stats->name, name, KMUTEX_NAME_MAX_LENGTH - 1);
+    string_format(mutex->stats->wait_zone_name, "lock wait: %s", mutex->stats->name);
+#endif
+}
+
+void kmutex_stats_print(void) {
+#if KMUTEX_INSTRUMENTED == 1
+    // Combined by name, so that e.g. every job thread's mutex shows as one.
+    typedef struct kmutex_stats_group {
+        const char *name;
+        u32 mutex_count;
+        u64 lock_count;
+        u64 contended_count;
+        f64 wait_time_total;
+        f64 wait_time_max;
+        f64 hold_time_total;
+        f64 hold_time_max;
+    } kmutex_stats_group;
+    kmutex_stats_group groups[KMUTEX_STATS_MAX_COUNT];
+    u32 group_count = 0;
+
+    for (u32 i = 0; i < KMUTEX_STATS_MAX_COUNT; ++i) {
+        kmutex_stats *stats = &stats_pool[i];
+        if (!katomic_load_u32(&stats->in_use, KATOMIC_ORDER_ACQUIRE)) {
+            continue;
+        }
+        kmutex_stats_group *group = 0;
+        for (u32 g = 0; g < group_count; ++g) {
+            if (strings_equal(groups[g].name, stats->name)) {
+                group = &groups[g];
+                break;
+            }
+        }
+        if (!group) {
+            group = &groups[group_count++];
+            kzero_memory(group, sizeof(kmutex_stats_group));
+            group->name = stats->name;
+        }
+        group->mutex_count++;
+        group->lock_count += stats->lock_count;
+        group->contended_count += stats->contended_count;
+        group->wait_time_total += stats->wait_time_total;
+        group->wait_time_max = KMAX(group->wait_time_max, stats->wait_time_max);
+        group->hold_time_total += stats->hold_time_total;
+        group->hold_time_max = KMAX(group->hold_time_max, stats->hold_time_max);
+    }
+
+    // The mutexes waited on the longest are the ones worth replacing first.
+    for (u32 i = 1; i < group_count; ++i) {
+        kmutex_stats_group group = groups[i];
+        u32 j = i;
+        while (j > 0 && groups[j - 1].wait_time_total < group.wait_time_total) {
+            groups[j] = groups[j - 1];
+            j--;
+        }
+        groups[j] = group;
+    }
+
+    KINFO("Mutex statistics (times in ms):");
+    KINFO("%-32s %6s %10s %10s %7s %10s %9s %10s %9s", "name", "count", "locks", "contended", "%", "wait", "max wait", "hold", "max hold");
+    for (u32 i = 0; i < group_count; ++i) {
+        kmutex_stats_group *group = &groups[i];
+        f64 contended_percent = group->lock_count ? ((f64)group->contended_count / (f64)group->lock_count) * 100.0 : 0;
+        KINFO("%-32s %6u %10llu %10llu %6.2f%% %10.3f %9.3f %10.3f %9.3f",
+              group->name, group->mutex_count, group->lock_count, group->contended_count, contended_percent,
+              group->wait_time_total * 1000.0, group->wait_time_max * 1000.0, group->hold_time_total * 1000.0, group->hold_time_max * 1000.0);
+    }
+    if (!group_count) {
+        KINFO("No named mutexes.");
+    }
+#else
+    KINFO("Mutex statistics are unavailable, as KMUTEX_INSTRUMENTED is 0.");
+#endif
+}
+
+void kmutex_stats_reset(void) {
+#if KMUTEX_INSTRUMENTED == 1
+    // NOTE: Leaves the depth and hold start alone, as the mutexes may be held as this runs.
+    for (u32 i = 0; i < KMUTEX_STATS_MAX_COUNT; ++i) {
+        kmutex_stats *stats = &stats_pool[i];
+        stats->lock_count = stats->contended_count = 0;
+        stats->wait_time_total = stats->wait_time_max = 0;
+        stats->hold_time_total = stats->hold_time_max = 0;
+    }
+#endif
+}
+
+static void kmutex_console_command_stats(console_command_context context) {
+    kmutex_stats_print();
+}
+
+static void kmutex_console_command_stats_reset(console_command_context context) {
+    kmutex_stats_reset();
+    KINFO("Mutex statistics reset.");
+}
+
+void kmutex_stats_initialize(void) {
+    console_command_register("mutex_stats", 0, kmutex_console_command_stats);
+    console_command_register("mutex_stats_reset", 0, kmutex_console_command_stats_reset);
+}
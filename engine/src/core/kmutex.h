@@ -1,6 +1,20 @@
 #pragma once
 
 #include "defines.h"
+#include "core/kprofiler.h"
+
+#ifndef KMUTEX_INSTRUMENTED
+/**
+ * @brief Indicates if mutexes given a name with kmutex_name_set record how long they are
+ * waited on and held, and how often they are contended. On by default wherever profiling is.
+ */
+#define KMUTEX_INSTRUMENTED KPROFILE_ENABLED
+#endif
+
+/** @brief The most mutexes which may be named, and so instrumented, at once. */
+#define KMUTEX_STATS_MAX_COUNT 128
+
+struct kmutex_stats;
 
 /**
  * A mutex to be used for synchronization purposes. A mutex (or
@@ -9,6 +23,10 @@
  */
 typedef struct kmutex {
     void *internal_data;
+#if KMUTEX_INSTRUMENTED == 1
+    /** @brief The lock statistics of the mutex, if it has been named. Otherwise 0. */
+    struct kmutex_stats *stats;
+#endif
 } kmutex;
 
 /**
@@ -38,3 +56,66 @@ KAPI b8 kmutex_lock(kmutex *mutex);
  * @returns True if unlocked successfully; otherwise false.
  */
 KAPI b8 kmutex_unlock(kmutex *mutex);
+
+/**
+ * @brief Names the given mutex, which has its locks instrumented from then on. Waits on a
+ * contended lock show in profile captures as "lock wait: <name>" zones, and the totals are
+ * printed by the "mutex_stats" console command. Does nothing if KMUTEX_INSTRUMENTED is 0.
+ * Must be called after kmutex_create, before the mutex is shared between threads.
+ *
+ * @param mutex A pointer to the mutex.
+ * @param name The name of the mutex, which is copied. Mutexes may share a name.
+ */
+KAPI void kmutex_name_set(kmutex *mutex, const char *name);
+
+/**
+ * @brief Registers the mutex statistics console commands: "mutex_stats", which prints the
+ * statistics of each named mutex, and "mutex_stats_reset".
+ */
+KAPI void kmutex_stats_initialize(void);
+
+/**
+ * @brief Logs the lock statistics of each named mutex, the most waited on first. Mutexes which
+ * share a name are combined.
+ */
+KAPI void kmutex_stats_print(void);
+
+/**
+ * @brief Clears the lock statistics of every named mutex.
+ */
+KAPI void kmutex_stats_reset(void);
+
+#if KMUTEX_INSTRUMENTED == 1
+// NOTE: Called by the platform layer's mutex functions, only for mutexes with statistics.
+
+/**
+ * @brief Records that a lock of the given mutex must wait, as another thread holds it.
+ *
+ * @param mutex A pointer to the mutex.
+ * @return The time the wait began, to be passed to kmutex_stats_acquired.
+ */
+f64 kmutex_stats_contended(kmutex *mutex);
+
+/**
+ * @brief Records that the given mutex has been locked by the calling thread.
+ *
+ * @param mutex A pointer to the mutex.
+ * @param wait_start The time returned by kmutex_stats_contended, or 0 if the lock did not wait.
+ */
+void kmutex_stats_acquired(kmutex *mutex, f64 wait_start);
+
+/**
+ * @brief Records that the calling thread is about to unlock the given mutex, either by unlocking
+ * it or by waiting on a condition variable.
+ *
+ * @param mutex A pointer to the mutex.
+ */
+void kmutex_stats_releasing(kmutex *mutex);
+
+/**
+ * @brief Returns the statistics of the given mutex to the pool. Called as the mutex is destroyed.
+ *
+ * @param mutex A pointer to the mutex.
+ */
+void kmutex_stats_release(kmutex *mutex);
+#endif
@@ -0,0 +1,103 @@
+#include "kname.h"
+
+#include "containers/hashmap.h"
+#include "core/kmemory.h"
+#include "core/kmutex.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+
+// The maximum number of unique names that can be registered.
+#define KNAME_MAX_COUNT 16384
+
+typedef struct kname_system_state {
+    // Maps a kname to the (owned) string it was created from.
+    hashmap lookup;
+    // Guards the lookup, since names are created from job threads as well.
+    kmutex lock;
+} kname_system_state;
+
+static kname_system_state* state_ptr = 0;
+
+b8 kname_system_initialize(u64* memory_requirement, void* memory, void* config) {
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(char*), KNAME_MAX_COUNT, &lookup_requirement, 0, 0);
+    *memory_requirement = sizeof(kname_system_state) + lookup_requirement;
+
+    if (!memory) {
+        return true;
+    }
+
+    kname_system_state* state = memory;
+    kzero_memory(state, sizeof(kname_system_state));
+    void* lookup_block = (u8*)memory + sizeof(kname_system_state);
+    if (!hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(char*), KNAME_MAX_COUNT, &lookup_requirement, lookup_block, &state->lookup)) {
+        KERROR("Failed to create kname lookup.");
+        return false;
+    }
+    if (!kmutex_create(&state->lock)) {
+        KERROR("Failed to create kname mutex.");
+        return false;
+    }
+    kmutex_name_set(&state->lock, "kname");
+
+    state_ptr = state;
+    return true;
+}
+
+void kname_system_shutdown(void* state) {
+    if (state_ptr) {
+        kmutex_lock(&state_ptr->lock);
+        hashmap* lookup = &state_ptr->lookup;
+        for (u32 i = 0; i < lookup->capacity; ++i) {
+            if (lookup->hashes[i]) {
+                char** str = (char**)((u8*)lookup->values + (lookup->element_size * i));
+                string_free(*str);
+            }
+        }
+        hashmap_destroy(lookup);
+        kmutex_unlock(&state_ptr->lock);
+        kmutex_destroy(&state_ptr->lock);
+        state_ptr = 0;
+    }
+}
+
+kname kname_create(const char* str) {
+    if (!str) {
+        return INVALID_KNAME;
+    }
+
+    // The name is the same hash string-keyed hashmaps use, so it may be passed to them as-is.
+    kname name = hashmap_hash_string(str);
+    if (!state_ptr) {
+        return name;
+    }
+
+    kmutex_lock(&state_ptr->lock);
+    char* existing = 0;
+    if (hashmap_get_u64(&state_ptr->lookup, name, &existing)) {
+        if (!strings_equal(existing, str)) {
+            KERROR("kname collision: '%s' and '%s' produce the same name. One should be renamed.", existing, str);
+        }
+    } else {
+        char* copy = string_duplicate(str);
+        if (!hashmap_set_u64(&state_ptr->lookup, name, &copy)) {
+            KWARN("kname_create - unable to register '%s'. It will not be available via kname_string_get.", str);
+            string_free(copy);
+        }
+    }
+    kmutex_unlock(&state_ptr->lock);
+
+    return name;
+}
+
+const char* kname_string_get(kname name) {
+    if (!state_ptr || name == INVALID_KNAME) {
+        return 0;
+    }
+
+    char* str = 0;
+    kmutex_lock(&state_ptr->lock);
+    hashmap_get_u64(&state_ptr->lookup, name, &str);
+    kmutex_unlock(&state_ptr->lock);
+    return str;
+}
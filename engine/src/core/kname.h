@@ -0,0 +1,61 @@
+/**
+ * @file kname.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains the interned name system. A kname is a hash of a
+ * string that is computed once, and then can be used in place of the string
+ * for fast lookups and comparisons. The original string is retained by the
+ * system so it can be looked up again (i.e. for debugging or logging).
+ * @version 1.0
+ * @date 2023-11-17
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief An interned name. Created from a string via kname_create(). */
+typedef u64 kname;
+
+/** @brief Represents an invalid kname, which is never produced for a valid string. */
+#define INVALID_KNAME 0
+
+/**
+ * @brief Initializes the kname system. Call twice; once to obtain the memory requirement
+ * (passing memory = 0), and a second time passing an allocated block of memory.
+ *
+ * @param memory_requirement A pointer to hold the memory requirement in bytes.
+ * @param memory A block of memory to hold the state, or 0 if just obtaining the requirement.
+ * @param config Unused.
+ * @return True on success; otherwise false.
+ */
+b8 kname_system_initialize(u64* memory_requirement, void* memory, void* config);
+
+/**
+ * @brief Shuts the kname system down, releasing all stored strings.
+ *
+ * @param state The state block of memory.
+ */
+void kname_system_shutdown(void* state);
+
+/**
+ * @brief Creates a kname for the given string, registering the string with the system
+ * if it is not already known. Names are case-sensitive, and the same string always
+ * produces the same kname, so the result may be stored and reused.
+ * NOTE: Safe to call from any thread. If the system is not initialized, the kname is still
+ * returned but the string is not registered.
+ *
+ * @param str The string to create a name from.
+ * @return The kname for the string, or INVALID_KNAME if str is 0.
+ */
+KAPI kname kname_create(const char* str);
+
+/**
+ * @brief Obtains the string a kname was created from.
+ *
+ * @param name The name to look up.
+ * @return The original string, or 0 if the name has not been registered.
+ */
+KAPI const char* kname_string_get(kname name);
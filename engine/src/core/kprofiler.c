@@ -0,0 +1,316 @@
+#include "kprofiler.h"
+
+#include "core/console.h"
+#include "core/katomic.h"
+#include "core/kmemory.h"
+#include "core/kmutex.h"
+#include "core/kstring.h"
+#include "core/kthread.h"
+#include "core/logger.h"
+#include "platform/filesystem.h"
+#include "platform/platform.h"
+
+// The most threads which may record zones.
+#define KPROFILER_MAX_THREADS 64
+
+// A closed zone. Instant events, such as frame marks, have a negative duration.
+typedef struct kprofiler_zone_record {
+    const char* name;
+    f64 start;
+    f64 duration;
+} kprofiler_zone_record;
+
+typedef struct kprofiler_open_zone {
+    const char* name;
+    // 0 if opened outside a capture, in which case it isn't recorded.
+    f64 start;
+} kprofiler_open_zone;
+
+// The zones of a single thread. Only written by that thread, and only read once a capture ends.
+typedef struct kprofiler_thread_buffer {
+    kprofiler_zone_record* records;
+    // The number of records written, published with release so the exporter sees them complete.
+    volatile u32 count;
+    // The capture the records belong to. Records of earlier captures are discarded by the writer.
+    u32 capture_id;
+    u32 dropped_count;
+    u64 thread_id;
+
+    kprofiler_open_zone stack[KPROFILER_MAX_DEPTH];
+    u32 depth;
+} kprofiler_thread_buffer;
+
+typedef struct kprofiler_state {
+    // Guards creation of thread buffers.
+    kmutex mutex;
+    volatile b8 mutex_created;
+    kprofiler_thread_buffer* threads[KPROFILER_MAX_THREADS];
+    volatile u32 thread_count;
+
+    volatile u32 capturing;
+    volatile u32 capture_id;
+    f64 capture_start;
+    u32 frames_remaining;
+    char path[512];
+} kprofiler_state;
+
+static kprofiler_state state = {0};
+
+static _Thread_local kprofiler_thread_buffer* thread_buffer = 0;
+
+static kprofiler_thread_buffer* thread_buffer_get(void) {
+    // Once shut down, the buffers of other threads are gone.
+    if (!state.mutex_created) {
+        return 0;
+    }
+    if (thread_buffer) {
+        return thread_buffer;
+    }
+
+    kmutex_lock(&state.mutex);
+    u32 index = state.thread_count;
+    if (index < KPROFILER_MAX_THREADS) {
+        kprofiler_thread_buffer* buffer = kallocate(sizeof(kprofiler_thread_buffer), MEMORY_TAG_ENGINE);
+        buffer->thread_id = platform_current_thread_id();
+        buffer->capture_id = INVALID_ID;
+        state.threads[index] = buffer;
+        katomic_store_u32(&state.thread_count, index + 1, KATOMIC_ORDER_RELEASE);
+        thread_buffer = buffer;
+    }
+    kmutex_unlock(&state.mutex);
+    return thread_buffer;
+}
+
+static void record_write(kprofiler_thread_buffer* buffer, const char* name, f64 start, f64 duration) {
+    // The first record of a new capture discards those of the last.
+    u32 capture_id = katomic_load_u32(&state.capture_id, KATOMIC_ORDER_ACQUIRE);
+    if (buffer->capture_id != capture_id) {
+        if (!buffer->records) {
+            buffer->records = kallocate(sizeof(kprofiler_zone_record) * KPROFILER_THREAD_ZONE_CAPACITY, MEMORY_TAG_ENGINE);
+        }
+        buffer->capture_id = capture_id;
+        buffer->dropped_count = 0;
+        katomic_store_u32(&buffer->count, 0, KATOMIC_ORDER_RELEASE);
+    }
+
+    u32 count = buffer->count;
+    if (count >= KPROFILER_THREAD_ZONE_CAPACITY) {
+        buffer->dropped_count++;
+        return;
+    }
+    kprofiler_zone_record* record = &buffer->records[count];
+    record->name = name;
+    record->start = start;
+    record->duration = duration;
+    katomic_store_u32(&buffer->count, count + 1, KATOMIC_ORDER_RELEASE);
+}
+
+void kprofiler_zone_begin(const char* name) {
+    kprofiler_thread_buffer* buffer = thread_buffer_get();
+    if (!buffer) {
+        return;
+    }
+    // Zones are always tracked, so that a capture starting part way through one stays balanced.
+    if (buffer->depth < KPROFILER_MAX_DEPTH) {
+        kprofiler_open_zone* zone = &buffer->stack[buffer->depth];
+        zone->name = name;
+        zone->start = katomic_load_u32(&state.capturing, KATOMIC_ORDER_RELAXED) ? platform_get_absolute_time() : 0;
+    }
+    buffer->depth++;
+}
+
+void kprofiler_zone_end(void) {
+    // Once shut down, the buffers of other threads are gone.
+    kprofiler_thread_buffer* buffer = state.mutex_created ? thread_buffer : 0;
+    if (!buffer || buffer->depth == 0) {
+        return;
+    }
+    buffer->depth--;
+    if (buffer->depth >= KPROFILER_MAX_DEPTH) {
+        return;
+    }
+
+    kprofiler_open_zone* zone = &buffer->stack[buffer->depth];
+    if (zone->start != 0 && katomic_load_u32(&state.capturing, KATOMIC_ORDER_RELAXED)) {
+        record_write(buffer, zone->name, zone->start, platform_get_absolute_time() - zone->start);
+    }
+}
+
+void kprofiler_scoped_zone_end(kprofiler_scoped_zone* zone) {
+    kprofiler_zone_end();
+}
+
+static void profiler_console_command_capture(console_command_context context) {
+    i32 frame_count = 0;
+    if (!string_to_i32(context.arguments[0].value, &frame_count) || frame_count < 1) {
+        KERROR("profile_capture requires a frame count of at least 1.");
+        return;
+    }
+    if (kprofiler_capture_begin((u32)frame_count, "profile.json")) {
+        KINFO("Capturing %i frames to profile.json.", frame_count);
+    }
+}
+
+void kprofiler_initialize(void) {
+    if (!state.mutex_created) {
+        if (!kmutex_create(&state.mutex)) {
+            KERROR("Failed to create profiler mutex. Profiling will be unavailable.");
+            return;
+        }
+        state.mutex_created = true;
+    }
+    console_command_register("profile_capture", 1, profiler_console_command_capture);
+}
+
+void kprofiler_shutdown(void) {
+    if (katomic_load_u32(&state.capturing, KATOMIC_ORDER_ACQUIRE)) {
+        kprofiler_capture_end();
+    }
+    if (!state.mutex_created) {
+        return;
+    }
+    state.mutex_created = false;
+    for (u32 i = 0; i < state.thread_count; ++i) {
+        if (state.threads[i]->records) {
+            kfree(state.threads[i]->records, sizeof(kprofiler_zone_record) * KPROFILER_THREAD_ZONE_CAPACITY, MEMORY_TAG_ENGINE);
+        }
+        kfree(state.threads[i], sizeof(kprofiler_thread_buffer), MEMORY_TAG_ENGINE);
+        state.threads[i] = 0;
+    }
+    state.thread_count = 0;
+    // NOTE: Only clears the pointer of this thread. Other threads see the profiler is shut down and ignore theirs.
+    thread_buffer = 0;
+    kmutex_destroy(&state.mutex);
+}
+
+b8 kprofiler_capture_begin(u32 frame_count, const char* path) {
+    if (!state.mutex_created) {
+        KERROR("kprofiler_capture_begin called before the profiler was initialized.");
+        return false;
+    }
+    if (katomic_load_u32(&state.capturing, KATOMIC_ORDER_ACQUIRE)) {
+        KWARN("A profile capture is already in progress.");
+        return false;
+    }
+
+    string_ncopy(state.path, path, sizeof(state.path) - 1);
+    state.frames_remaining = frame_count;
+    state.capture_start = platform_get_absolute_time();
+    katomic_fetch_add_u32(&state.capture_id, 1, KATOMIC_ORDER_RELEASE);
+    katomic_store_u32(&state.capturing, 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+b8 kprofiler_capturing(void) {
+    return katomic_load_u32(&state.capturing, KATOMIC_ORDER_RELAXED) != 0;
+}
+
+void kprofiler_frame_mark(void) {
+    if (!katomic_load_u32(&state.capturing, KATOMIC_ORDER_RELAXED)) {
+        return;
+    }
+    kprofiler_thread_buffer* buffer = thread_buffer_get();
+    if (buffer) {
+        record_write(buffer, "Frame", platform_get_absolute_time(), -1.0);
+    }
+    if (state.frames_remaining && --state.frames_remaining == 0) {
+        kprofiler_capture_end();
+    }
+}
+
+// Writes the given name as a JSON string, escaping what needs it.
+static void json_name_write(char* out, const char* name) {
+    u32 length = 0;
+    for (const char* c = name; *c && length < 250; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out[length++] = '\\';
+        }
+        out[length++] = *c;
+    }
+    out[length] = 0;
+}
+
+b8 kprofiler_capture_end(void) {
+    if (!katomic_load_u32(&state.capturing, KATOMIC_ORDER_ACQUIRE)) {
+        return false;
+    }
+    katomic_store_u32(&state.capturing, 0, KATOMIC_ORDER_RELEASE);
+    u32 capture_id = katomic_load_u32(&state.capture_id, KATOMIC_ORDER_ACQUIRE);
+
+    file_handle f;
+    if (!filesystem_open(state.path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to open '%s' to write the profile capture.", state.path);
+        return false;
+    }
+
+    // Timestamps are in microseconds from the start of the capture.
+    b8 result = filesystem_write_line(&f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    char line[512];
+    char name[512];
+    b8 first = true;
+    u32 zone_count = 0;
+    u32 dropped_count = 0;
+    u32 thread_count = katomic_load_u32(&state.thread_count, KATOMIC_ORDER_ACQUIRE);
+    for (u32 t = 0; t < thread_count && result; ++t) {
+        kprofiler_thread_buffer* buffer = state.threads[t];
+        if (buffer->capture_id != capture_id) {
+            // Nothing recorded on this thread in the capture.
+            continue;
+        }
+        u32 count = katomic_load_u32(&buffer->count, KATOMIC_ORDER_ACQUIRE);
+        dropped_count += buffer->dropped_count;
+
+        string_format(line, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u (%#llx)\"}}", first ? "" : ",", t, t, buffer->thread_id);
+        result = filesystem_write_line(&f, line);
+        first = false;
+
+        for (u32 i = 0; i < count && result; ++i) {
+            const kprofiler_zone_record* record = &buffer->records[i];
+            json_name_write(name, record->name);
+            f64 ts = (record->start - state.capture_start) * 1000000.0;
+            if (record->duration < 0) {
+                string_format(line, ",{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}", name, t, ts);
+            } else {
+                string_format(line, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", name, t, ts, record->duration * 1000000.0);
+                zone_count++;
+            }
+            result = filesystem_write_line(&f, line);
+        }
+    }
+    result = result && filesystem_write_line(&f, "]}");
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("Failed to write the profile capture to '%s'.", state.path);
+        return false;
+    }
+    if (dropped_count) {
+        KWARN("%u profile zones were dropped, as their thread's buffer was full.", dropped_count);
+    }
+    KINFO("Wrote %u profile zones to '%s'. Open it with chrome://tracing or ui.perfetto.dev.", zone_count, state.path);
+    return true;
+}
+
+#if KPROFILE_ENABLED == 1 && defined(KPROFILE_TRACY)
+static _Thread_local TracyCZoneCtx tracy_zones[KPROFILER_MAX_DEPTH];
+static _Thread_local u32 tracy_zone_depth = 0;
+
+void kprofiler_tracy_zone_push(u32 line, const char* file, const char* function, const char* name) {
+    u64 location = ___tracy_alloc_srcloc_name(line, file, string_length(file), function, string_length(function), name, string_length(name), 0);
+    TracyCZoneCtx zone = ___tracy_emit_zone_begin_alloc(location, 1);
+    if (tracy_zone_depth < KPROFILER_MAX_DEPTH) {
+        tracy_zones[tracy_zone_depth] = zone;
+    }
+    tracy_zone_depth++;
+}
+
+void kprofiler_tracy_zone_pop(void) {
+    if (tracy_zone_depth == 0) {
+        return;
+    }
+    tracy_zone_depth--;
+    if (tracy_zone_depth < KPROFILER_MAX_DEPTH) {
+        TracyCZoneEnd(tracy_zones[tracy_zone_depth]);
+    }
+}
+#endif
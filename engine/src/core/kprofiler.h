@@ -0,0 +1,158 @@
+/**
+ * @file kprofiler.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A hierarchical CPU profiler, recording timed zones on any thread.
+ * @details Zones are marked with KPROFILE_SCOPE, which times the rest of the enclosing block,
+ * or with KPROFILE_BEGIN/KPROFILE_END pairs. Zones nest, per thread. Nothing is recorded until a
+ * capture is started, after which each thread appends its zones to its own buffer without
+ * locking. When the capture ends, the zones are written out as a chrome://tracing (or Perfetto)
+ * JSON file. Captures are started from code, or with the "profile_capture <frames>" console command.
+ *
+ * Defining KPROFILE_TRACY sends zones to a Tracy client instead, which must then be built
+ * and linked with the engine (TRACY_ENABLE, TracyClient.cpp, and tracy/TracyC.h on the include path).
+ *
+ * All instrumentation compiles out in release builds, unless KPROFILE_ENABLED is defined as 1.
+ * @version 1.0
+ * @date 2023-11-30
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+#ifndef KPROFILE_ENABLED
+#if KRELEASE == 1
+/** @brief Indicates if profiling instrumentation is compiled in. */
+#define KPROFILE_ENABLED 0
+#else
+/** @brief Indicates if profiling instrumentation is compiled in. */
+#define KPROFILE_ENABLED 1
+#endif
+#endif
+
+/** @brief The most zones each thread may record in a single capture. Further zones are dropped. */
+#define KPROFILER_THREAD_ZONE_CAPACITY 65536
+/** @brief The deepest zones may nest on a thread. */
+#define KPROFILER_MAX_DEPTH 64
+
+/**
+ * @brief Registers the profiler's console commands. Zones may be recorded without this.
+ */
+KAPI void kprofiler_initialize(void);
+
+/**
+ * @brief Ends any capture in progress and frees the profiler's buffers.
+ */
+KAPI void kprofiler_shutdown(void);
+
+/**
+ * @brief Starts capturing zones on every thread.
+ * @param frame_count The number of frames to capture before the capture ends by itself. 0 to capture until kprofiler_capture_end is called.
+ * @param path The path of the chrome://tracing JSON file written when the capture ends.
+ * @return True if started; otherwise false (i.e. if a capture is already in progress).
+ */
+KAPI b8 kprofiler_capture_begin(u32 frame_count, const char* path);
+
+/**
+ * @brief Ends the capture in progress and writes it out. Must be called from the thread which
+ * marks frames (the main thread).
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kprofiler_capture_end(void);
+
+/**
+ * @brief Indicates if a capture is in progress.
+ */
+KAPI b8 kprofiler_capturing(void);
+
+/**
+ * @brief Marks the end of a frame. Called by the engine once per frame, on the main thread.
+ */
+KAPI void kprofiler_frame_mark(void);
+
+/**
+ * @brief Opens a zone on the calling thread. Use the KPROFILE macros rather than calling this directly.
+ * @param name The name of the zone. Must outlive the capture, as string literals do.
+ */
+KAPI void kprofiler_zone_begin(const char* name);
+
+/**
+ * @brief Closes the innermost zone open on the calling thread. Use the KPROFILE macros rather than calling this directly.
+ */
+KAPI void kprofiler_zone_end(void);
+
+/** @brief A zone closed automatically at the end of its scope. Used by KPROFILE_SCOPE. */
+typedef struct kprofiler_scoped_zone {
+    u8 unused;
+} kprofiler_scoped_zone;
+
+/** @brief Closes a scoped zone. Invoked automatically when it goes out of scope. */
+KAPI void kprofiler_scoped_zone_end(kprofiler_scoped_zone* zone);
+
+/** @brief Opens a scoped zone. Used by KPROFILE_SCOPE. */
+KINLINE kprofiler_scoped_zone kprofiler_scoped_zone_begin(const char* name) {
+    kprofiler_zone_begin(name);
+    kprofiler_scoped_zone zone = {0};
+    return zone;
+}
+
+#define KPROFILE_CONCAT_INNER(a, b) a##b
+#define KPROFILE_CONCAT(a, b) KPROFILE_CONCAT_INNER(a, b)
+
+#if KPROFILE_ENABLED == 1 && defined(KPROFILE_TRACY)
+#include <tracy/TracyC.h>
+
+KINLINE void kprofiler_tracy_zone_end(TracyCZoneCtx* ctx) {
+    TracyCZoneEnd(*ctx);
+}
+
+/**
+ * @brief Times the rest of the enclosing scope as a zone with the given name.
+ * @param name The name of the zone. Must be a string literal.
+ */
+#define KPROFILE_SCOPE(name)                                                                                                                     \
+    static const struct ___tracy_source_location_data KPROFILE_CONCAT(kprofile_location_, __LINE__) = {name, __func__, __FILE__, __LINE__, 0}; \
+    __attribute__((cleanup(kprofiler_tracy_zone_end))) TracyCZoneCtx KPROFILE_CONCAT(kprofile_zone_, __LINE__) = ___tracy_emit_zone_begin(&KPROFILE_CONCAT(kprofile_location_, __LINE__), 1)
+/**
+ * @brief Opens a Tracy zone, kept on a per-thread stack so that it may be closed elsewhere. Used by KPROFILE_BEGIN.
+ * Names need not be literals, as Tracy copies them.
+ */
+KAPI void kprofiler_tracy_zone_push(u32 line, const char* file, const char* function, const char* name);
+/** @brief Closes the innermost zone opened by kprofiler_tracy_zone_push. Used by KPROFILE_END. */
+KAPI void kprofiler_tracy_zone_pop(void);
+
+/** @brief Opens a zone, which must be closed with KPROFILE_END. */
+#define KPROFILE_BEGIN(name) kprofiler_tracy_zone_push(__LINE__, __FILE__, __func__, name)
+/** @brief Closes the innermost zone opened by KPROFILE_BEGIN. */
+#define KPROFILE_END() kprofiler_tracy_zone_pop()
+/** @brief Marks the end of a frame. */
+#define KPROFILE_FRAME_MARK() TracyCFrameMark
+
+#elif KPROFILE_ENABLED == 1
+
+/**
+ * @brief Times the rest of the enclosing scope as a zone with the given name.
+ * @param name The name of the zone. Must be a string literal.
+ */
+#define KPROFILE_SCOPE(name) __attribute__((cleanup(kprofiler_scoped_zone_end))) kprofiler_scoped_zone KPROFILE_CONCAT(kprofile_zone_, __LINE__) = kprofiler_scoped_zone_begin(name)
+/** @brief Opens a zone, which must be closed with KPROFILE_END. */
+#define KPROFILE_BEGIN(name) kprofiler_zone_begin(name)
+/** @brief Closes the innermost zone opened by KPROFILE_BEGIN. */
+#define KPROFILE_END() kprofiler_zone_end()
+/** @brief Marks the end of a frame. */
+#define KPROFILE_FRAME_MARK() kprofiler_frame_mark()
+
+#else
+
+#define KPROFILE_SCOPE(name)
+#define KPROFILE_BEGIN(name)
+#define KPROFILE_END()
+#define KPROFILE_FRAME_MARK()
+
+#endif
+
+/** @brief Times the rest of the enclosing function as a zone named after it. */
+#define KPROFILE_FUNCTION() KPROFILE_SCOPE(__func__)
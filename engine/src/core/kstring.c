@@ -1,11 +1,14 @@
 #include "core/kstring.h"
 
-#include <ctype.h>  // isspace
+#include <ctype.h>  // isspace, tolower
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>  // strtod
 #include <string.h>
 
 #include "containers/darray.h"
+#include "core/frame_data.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
 #include "math/kmath.h"
@@ -149,13 +152,10 @@ i32 string_format(char* dest, const char* format, ...) {
 
 i32 string_format_v(char* dest, const char* format, void* va_listp) {
     if (dest) {
-        // Big, but can fit on the stack.
-        char buffer[32000];
-        i32 written = vsnprintf(buffer, 32000, format, va_listp);
-        buffer[written] = 0;
-        kcopy_memory(dest, buffer, written + 1);
-
-        return written;
+        // Format straight into the destination rather than through a scratch buffer. The bound is
+        // the size of the stack buffer this used to use.
+        i32 written = vsnprintf(dest, 32000, format, va_listp);
+        return KMIN(written, 31999);
     }
     return -1;
 }
@@ -337,41 +337,224 @@ void string_remove_at(char* dest, const char* src, u32 pos, u32 length) {
     dest[original_length - length] = 0;
 }
 
+// ----------------------
+// Number parsing. Locale-independent and allocation-free. Each parser reads one number from str,
+// stopping at end (or at the null terminator when end is 0), and returns a pointer just past it,
+// or 0 if no number was found.
+// ----------------------
+
+#define NUMBER_AT_END(p, end) ((end) ? (p) >= (end) : !*(p))
+
+static const char* number_skip_whitespace(const char* p, const char* end) {
+    while (!NUMBER_AT_END(p, end) && isspace((unsigned char)*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* number_parse_u64(const char* p, const char* end, u64* out_value) {
+    u64 base = 10;
+    if (!NUMBER_AT_END(p, end) && *p == '0' && !NUMBER_AT_END(p + 1, end) && (p[1] == 'x' || p[1] == 'X') &&
+        !NUMBER_AT_END(p + 2, end) && isxdigit((unsigned char)p[2])) {
+        base = 16;
+        p += 2;
+    }
+
+    u64 value = 0;
+    const char* start = p;
+    while (!NUMBER_AT_END(p, end)) {
+        char c = *p;
+        u64 digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        if (value > (UINT64_MAX - digit) / base) {
+            // Overflow.
+            return 0;
+        }
+        value = value * base + digit;
+        p++;
+    }
+    if (p == start) {
+        return 0;
+    }
+    *out_value = value;
+    return p;
+}
+
+static const char* number_parse_i64(const char* p, const char* end, i64* out_value) {
+    b8 negative = false;
+    if (!NUMBER_AT_END(p, end) && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    u64 magnitude;
+    p = number_parse_u64(p, end, &magnitude);
+    if (!p || magnitude > (u64)INT64_MAX + (negative ? 1 : 0)) {
+        return 0;
+    }
+    *out_value = negative ? (i64)(0 - magnitude) : (i64)magnitude;
+    return p;
+}
+
+// Matches the given lowercase word at p, ignoring case. Returns a pointer just past it, or 0.
+static const char* number_match_word(const char* p, const char* end, const char* word) {
+    for (; *word; ++word, ++p) {
+        if (NUMBER_AT_END(p, end) || tolower((unsigned char)*p) != *word) {
+            return 0;
+        }
+    }
+    return p;
+}
+
+// Powers of ten which are exactly representable as doubles.
+static const f64 exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const char* number_parse_f64(const char* p, const char* end, f64* out_value) {
+    const char* start = p;
+    b8 negative = false;
+    if (!NUMBER_AT_END(p, end) && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    // Infinity and NaN are spelled out, as strtod accepts them.
+    const char* word_end = number_match_word(p, end, "inf");
+    if (word_end) {
+        const char* long_end = number_match_word(word_end, end, "inity");
+        *out_value = negative ? -strtod("inf", 0) : strtod("inf", 0);
+        return long_end ? long_end : word_end;
+    }
+    word_end = number_match_word(p, end, "nan");
+    if (word_end) {
+        *out_value = negative ? -strtod("nan", 0) : strtod("nan", 0);
+        return word_end;
+    }
+
+    // Gather up to 19 significant digits, which always fit in a u64.
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    u32 digit_count = 0;
+    u32 significant_count = 0;
+    b8 truncated = false;
+    while (!NUMBER_AT_END(p, end) && *p >= '0' && *p <= '9') {
+        if (significant_count < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant_count += mantissa != 0;
+        } else {
+            exponent++;
+            truncated |= *p != '0';
+        }
+        digit_count++;
+        p++;
+    }
+    if (!NUMBER_AT_END(p, end) && *p == '.') {
+        p++;
+        while (!NUMBER_AT_END(p, end) && *p >= '0' && *p <= '9') {
+            if (significant_count < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant_count += mantissa != 0;
+                exponent--;
+            } else {
+                truncated |= *p != '0';
+            }
+            digit_count++;
+            p++;
+        }
+    }
+    if (!digit_count) {
+        return 0;
+    }
+
+    if (!NUMBER_AT_END(p, end) && (*p == 'e' || *p == 'E')) {
+        i64 exponent_value;
+        const char* exponent_end = number_parse_i64(p + 1, end, &exponent_value);
+        // A bare 'e' is not part of the number.
+        if (exponent_end && exponent_value > -10000 && exponent_value < 10000) {
+            exponent += (i32)exponent_value;
+            p = exponent_end;
+        }
+    }
+
+    f64 value;
+    if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        // Both the mantissa and the power of ten are exact, so a single operation rounds correctly.
+        value = (f64)mantissa;
+        value = exponent < 0 ? value / exact_powers_of_ten[-exponent] : value * exact_powers_of_ten[exponent];
+    } else {
+        // Rare in asset files. Hand the digits to strtod to be rounded correctly. The engine never
+        // changes the C locale, so the decimal point is always '.'.
+        char buffer[128];
+        u64 length = (u64)(p - start);
+        if (length >= sizeof(buffer)) {
+            return 0;
+        }
+        kcopy_memory(buffer, start, length);
+        buffer[length] = 0;
+        value = strtod(buffer, 0);
+        negative = false;
+    }
+
+    *out_value = negative ? -value : value;
+    return p;
+}
+
+// Parses up to max_count whitespace-separated floats. Returns the number parsed.
+static u32 string_to_f32_array(const char* str, f32* out_values, u32 max_count) {
+    u32 count = 0;
+    while (count < max_count) {
+        f64 value;
+        const char* next = number_parse_f64(number_skip_whitespace(str, 0), 0, &value);
+        if (!next) {
+            break;
+        }
+        out_values[count++] = (f32)value;
+        str = next;
+    }
+    return count;
+}
+
 b8 string_to_transform(const char* str, transform* out_transform) {
     if (!str || !out_transform) {
         return false;
     }
 
     kzero_memory(out_transform, sizeof(transform));
-    f32 values[7] = {0};
+    f32 values[10] = {0};
 
-    i32 count = sscanf(
-        str,
-        "%f %f %f %f %f %f %f %f %f %f",
-        &out_transform->position.x, &out_transform->position.y, &out_transform->position.z,
-        &values[0], &values[1], &values[2], &values[3], &values[4], &values[5], &values[6]);
+    u32 count = string_to_f32_array(str, values, 10);
+    out_transform->position = (vec3){values[0], values[1], values[2]};
 
     if (count == 10) {
         // Treat as quat, load directly.
-        out_transform->rotation.x = values[0];
-        out_transform->rotation.y = values[1];
-        out_transform->rotation.z = values[2];
-        out_transform->rotation.w = values[3];
+        out_transform->rotation.x = values[3];
+        out_transform->rotation.y = values[4];
+        out_transform->rotation.z = values[5];
+        out_transform->rotation.w = values[6];
 
         // Set scale
-        out_transform->scale.x = values[4];
-        out_transform->scale.y = values[5];
-        out_transform->scale.z = values[6];
+        out_transform->scale.x = values[7];
+        out_transform->scale.y = values[8];
+        out_transform->scale.z = values[9];
     } else if (count == 9) {
-        quat x_rot = quat_from_axis_angle((vec3){1.0f, 0, 0}, deg_to_rad(values[0]), true);
-        quat y_rot = quat_from_axis_angle((vec3){0, 1.0f, 0}, deg_to_rad(values[1]), true);
-        quat z_rot = quat_from_axis_angle((vec3){0, 0, 1.0f}, deg_to_rad(values[2]), true);
+        quat x_rot = quat_from_axis_angle((vec3){1.0f, 0, 0}, deg_to_rad(values[3]), true);
+        quat y_rot = quat_from_axis_angle((vec3){0, 1.0f, 0}, deg_to_rad(values[4]), true);
+        quat z_rot = quat_from_axis_angle((vec3){0, 0, 1.0f}, deg_to_rad(values[5]), true);
         out_transform->rotation = quat_mul(x_rot, quat_mul(y_rot, z_rot));
 
         // Set scale
-        out_transform->scale.x = values[3];
-        out_transform->scale.y = values[4];
-        out_transform->scale.z = values[5];
+        out_transform->scale.x = values[6];
+        out_transform->scale.y = values[7];
+        out_transform->scale.z = values[8];
     } else {
         KWARN("Format error: invalid transform provided. Identity transform will be used.");
         *out_transform = transform_create();
@@ -389,24 +572,7 @@ b8 string_to_mat4(const char* str, mat4* out_mat) {
     }
 
     kzero_memory(out_mat, sizeof(mat4));
-    i32 result = sscanf(str, "%f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f",
-                        &out_mat->data[0],
-                        &out_mat->data[1],
-                        &out_mat->data[2],
-                        &out_mat->data[3],
-                        &out_mat->data[4],
-                        &out_mat->data[5],
-                        &out_mat->data[6],
-                        &out_mat->data[7],
-                        &out_mat->data[8],
-                        &out_mat->data[9],
-                        &out_mat->data[10],
-                        &out_mat->data[11],
-                        &out_mat->data[12],
-                        &out_mat->data[13],
-                        &out_mat->data[14],
-                        &out_mat->data[15]);
-    return result != -1;
+    return string_to_f32_array(str, out_mat->data, 16) > 0;
 }
 
 b8 string_to_vec4(const char* str, vec4* out_vector) {
@@ -415,8 +581,7 @@ b8 string_to_vec4(const char* str, vec4* out_vector) {
     }
 
     kzero_memory(out_vector, sizeof(vec4));
-    i32 result = sscanf(str, "%f %f %f %f", &out_vector->x, &out_vector->y, &out_vector->z, &out_vector->w);
-    return result != -1;
+    return string_to_f32_array(str, out_vector->elements, 4) > 0;
 }
 
 b8 string_to_vec3(const char* str, vec3* out_vector) {
@@ -425,8 +590,7 @@ b8 string_to_vec3(const char* str, vec3* out_vector) {
     }
 
     kzero_memory(out_vector, sizeof(vec3));
-    i32 result = sscanf(str, "%f %f %f", &out_vector->x, &out_vector->y, &out_vector->z);
-    return result != -1;
+    return string_to_f32_array(str, out_vector->elements, 3) > 0;
 }
 
 b8 string_to_vec2(const char* str, vec2* out_vector) {
@@ -435,8 +599,51 @@ b8 string_to_vec2(const char* str, vec2* out_vector) {
     }
 
     kzero_memory(out_vector, sizeof(vec2));
-    i32 result = sscanf(str, "%f %f", &out_vector->x, &out_vector->y);
-    return result != -1;
+    return string_to_f32_array(str, out_vector->elements, 2) > 0;
+}
+
+const char* string_parse_f64(const char* str, f64* out_value) {
+    if (!str || !out_value) {
+        return 0;
+    }
+    return number_parse_f64(number_skip_whitespace(str, 0), 0, out_value);
+}
+
+const char* string_parse_f32(const char* str, f32* out_value) {
+    f64 value;
+    const char* next = string_parse_f64(str, out_value ? &value : 0);
+    if (next) {
+        *out_value = (f32)value;
+    }
+    return next;
+}
+
+const char* string_parse_i64(const char* str, i64* out_value) {
+    if (!str || !out_value) {
+        return 0;
+    }
+    return number_parse_i64(number_skip_whitespace(str, 0), 0, out_value);
+}
+
+const char* string_parse_u64(const char* str, u64* out_value) {
+    if (!str || !out_value) {
+        return 0;
+    }
+    const char* p = number_skip_whitespace(str, 0);
+    if (*p == '+') {
+        p++;
+    }
+    return number_parse_u64(p, 0, out_value);
+}
+
+const char* string_parse_u32(const char* str, u32* out_value) {
+    u64 value;
+    const char* next = string_parse_u64(str, out_value ? &value : 0);
+    if (!next || value > UINT32_MAX) {
+        return 0;
+    }
+    *out_value = (u32)value;
+    return next;
 }
 
 b8 string_to_f32(const char* str, f32* f) {
@@ -445,8 +652,7 @@ b8 string_to_f32(const char* str, f32* f) {
     }
 
     *f = 0;
-    i32 result = sscanf(str, "%f", f);
-    return result != -1;
+    return string_parse_f32(str, f) != 0;
 }
 
 b8 string_to_f64(const char* str, f64* f) {
@@ -455,8 +661,29 @@ b8 string_to_f64(const char* str, f64* f) {
     }
 
     *f = 0;
-    i32 result = sscanf(str, "%lf", f);
-    return result != -1;
+    return string_parse_f64(str, f) != 0;
+}
+
+// Parses a signed integer and checks it fits between min and max.
+static b8 string_to_int(const char* str, i64 min, i64 max, i64* out_value) {
+    *out_value = 0;
+    i64 value;
+    if (!string_parse_i64(str, &value) || value < min || value > max) {
+        return false;
+    }
+    *out_value = value;
+    return true;
+}
+
+// Parses an unsigned integer and checks it is no larger than max.
+static b8 string_to_uint(const char* str, u64 max, u64* out_value) {
+    *out_value = 0;
+    u64 value;
+    if (!string_parse_u64(str, &value) || value > max) {
+        return false;
+    }
+    *out_value = value;
+    return true;
 }
 
 b8 string_to_i8(const char* str, i8* i) {
@@ -464,9 +691,10 @@ b8 string_to_i8(const char* str, i8* i) {
         return false;
     }
 
-    *i = 0;
-    i32 result = sscanf(str, "%hhi", i);
-    return result != -1;
+    i64 value;
+    b8 result = string_to_int(str, INT8_MIN, INT8_MAX, &value);
+    *i = (i8)value;
+    return result;
 }
 
 b8 string_to_i16(const char* str, i16* i) {
@@ -474,9 +702,10 @@ b8 string_to_i16(const char* str, i16* i) {
         return false;
     }
 
-    *i = 0;
-    i32 result = sscanf(str, "%hi", i);
-    return result != -1;
+    i64 value;
+    b8 result = string_to_int(str, INT16_MIN, INT16_MAX, &value);
+    *i = (i16)value;
+    return result;
 }
 
 b8 string_to_i32(const char* str, i32* i) {
@@ -484,9 +713,10 @@ b8 string_to_i32(const char* str, i32* i) {
         return false;
     }
 
-    *i = 0;
-    i32 result = sscanf(str, "%i", i);
-    return result != -1;
+    i64 value;
+    b8 result = string_to_int(str, INT32_MIN, INT32_MAX, &value);
+    *i = (i32)value;
+    return result;
 }
 
 b8 string_to_i64(const char* str, i64* i) {
@@ -494,9 +724,7 @@ b8 string_to_i64(const char* str, i64* i) {
         return false;
     }
 
-    *i = 0;
-    i32 result = sscanf(str, "%lli", i);
-    return result != -1;
+    return string_to_int(str, INT64_MIN, INT64_MAX, i);
 }
 
 b8 string_to_u8(const char* str, u8* u) {
@@ -504,9 +732,10 @@ b8 string_to_u8(const char* str, u8* u) {
         return false;
     }
 
-    *u = 0;
-    i32 result = sscanf(str, "%hhu", u);
-    return result != -1;
+    u64 value;
+    b8 result = string_to_uint(str, UINT8_MAX, &value);
+    *u = (u8)value;
+    return result;
 }
 
 b8 string_to_u16(const char* str, u16* u) {
@@ -514,9 +743,10 @@ b8 string_to_u16(const char* str, u16* u) {
         return false;
     }
 
-    *u = 0;
-    i32 result = sscanf(str, "%hu", u);
-    return result != -1;
+    u64 value;
+    b8 result = string_to_uint(str, UINT16_MAX, &value);
+    *u = (u16)value;
+    return result;
 }
 
 b8 string_to_u32(const char* str, u32* u) {
@@ -524,9 +754,10 @@ b8 string_to_u32(const char* str, u32* u) {
         return false;
     }
 
-    *u = 0;
-    i32 result = sscanf(str, "%u", u);
-    return result != -1;
+    u64 value;
+    b8 result = string_to_uint(str, UINT32_MAX, &value);
+    *u = (u32)value;
+    return result;
 }
 
 b8 string_to_u64(const char* str, u64* u) {
@@ -534,9 +765,79 @@ b8 string_to_u64(const char* str, u64* u) {
         return false;
     }
 
-    *u = 0;
-    i32 result = sscanf(str, "%llu", u);
-    return result != -1;
+    return string_to_uint(str, UINT64_MAX, u);
+}
+
+// ----------------------
+// Number formatting
+// ----------------------
+
+u32 string_from_u64(char* dest, u64 value) {
+    // Written backwards, then copied out.
+    char digits[20];
+    u32 count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    for (u32 i = 0; i < count; ++i) {
+        dest[i] = digits[count - 1 - i];
+    }
+    dest[count] = 0;
+    return count;
+}
+
+u32 string_from_i64(char* dest, i64 value) {
+    if (value < 0) {
+        dest[0] = '-';
+        return 1 + string_from_u64(dest + 1, 0 - (u64)value);
+    }
+    return string_from_u64(dest, (u64)value);
+}
+
+u32 string_from_f64(char* dest, f64 value, u8 decimals) {
+    decimals = KMIN(decimals, 9);
+    if (value != value) {
+        string_copy(dest, "nan");
+        return 3;
+    }
+
+    u32 length = 0;
+    if (value < 0) {
+        dest[length++] = '-';
+        value = -value;
+    }
+
+    f64 scale = exact_powers_of_ten[decimals];
+    f64 scaled = value * scale + 0.5;
+    if (scaled >= 18446744073709551615.0) {
+        // Too large for the fixed-point path, and far beyond any value displayed to a user.
+        if (value > 1.7976931348623157e308) {
+            string_copy(dest + length, "inf");
+            return length + 3;
+        }
+        return length + (u32)snprintf(dest + length, STRING_NUMBER_MAX_LENGTH - length, "%.17g", value);
+    }
+
+    u64 fixed = (u64)scaled;
+    u64 unit = (u64)scale;
+    if (length && fixed == 0) {
+        // Don't print "-0.00" for values which round to zero.
+        length = 0;
+    }
+    length += string_from_u64(dest + length, fixed / unit);
+    if (decimals) {
+        dest[length++] = '.';
+        u64 fraction = fixed % unit;
+        for (i32 i = decimals - 1; i >= 0; --i) {
+            dest[length + i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        length += decimals;
+        dest[length] = 0;
+    }
+    return length;
 }
 
 b8 string_to_bool(const char* str, b8* b) {
@@ -545,7 +846,7 @@ b8 string_to_bool(const char* str, b8* b) {
     }
 
     *b = strings_equal(str, "1") || strings_equali(str, "true");
-    return *b;
+    return *b || strings_equal(str, "0") || strings_equali(str, "false");
 }
 
 u32 string_split(const char* str, char delimiter, char*** str_darray, b8 trim_entries, b8 include_empty) {
@@ -643,11 +944,19 @@ void string_append_string(char* dest, const char* src, const char* append) {
 }
 
 void string_append_int(char* dest, const char* source, i64 i) {
-    sprintf(dest, "%s%lli", source, i);
+    u64 length = string_length(source);
+    if (dest != source) {
+        kcopy_memory(dest, source, length);
+    }
+    string_from_i64(dest + length, i);
 }
 
 void string_append_float(char* dest, const char* source, f32 f) {
-    sprintf(dest, "%s%f", source, f);
+    u64 length = string_length(source);
+    if (dest != source) {
+        kcopy_memory(dest, source, length);
+    }
+    string_from_f64(dest + length, f, 6);
 }
 
 void string_append_bool(char* dest, const char* source, b8 b) {
@@ -721,42 +1030,62 @@ b8 string_parse_array_length(const char* str, u32* out_length) {
 // kstring implementation
 // ----------------------
 
+static char* kstring_allocate(const kstring* string, u32 size) {
+    if (string->allocator) {
+        return string->allocator->allocate(size);
+    }
+    return kallocate(size, MEMORY_TAG_STRING);
+}
+
+static void kstring_free(const kstring* string, char* data, u32 size) {
+    if (string->allocator) {
+        string->allocator->free(data, size);
+    } else {
+        kfree(data, size, MEMORY_TAG_STRING);
+    }
+}
+
 /**
- * @brief
+ * @brief Ensures the string has room for the given length plus a null terminator.
+ * Grows to at least double the current allocation, so repeated appends stay cheap.
  *
- * @param string
+ * @param string A pointer to the string.
  * @param length The string length not including the null terminator.
  */
-void kstring_ensure_allocated(kstring* string, u32 length) {
-    if (string) {
-        if (string->allocated < length + 1) {
-            char* new_data = kallocate(sizeof(char) * length + 1, MEMORY_TAG_STRING);
-            if (string->data) {
-                // Copy over data if there is data to copy.
-                if (string->length > 0) {
-                    string_ncopy(new_data, string->data, string->length);
-                }
-                // Clean up old data
-                kfree(string->data, sizeof(char) * string->length + 1, MEMORY_TAG_STRING);
-            }
+static void kstring_ensure_allocated(kstring* string, u32 length) {
+    if (string->allocated >= length + 1) {
+        return;
+    }
 
-            string->data = new_data;
-            string->length = length;
-            string->allocated = length + 1;
-        }
+    u32 new_allocated = KMAX(length + 1, string->allocated * 2);
+    new_allocated = KMAX(new_allocated, 16);
+    char* new_data = kstring_allocate(string, new_allocated);
+    if (string->data) {
+        // Copy over the existing contents, including the null terminator.
+        kcopy_memory(new_data, string->data, string->length + 1);
+        kstring_free(string, string->data, string->allocated);
+    } else {
+        new_data[0] = 0;
     }
+
+    string->data = new_data;
+    string->allocated = new_allocated;
 }
 
 void kstring_create(kstring* out_string) {
+    kstring_create_with_allocator(0, out_string);
+}
+
+void kstring_create_with_allocator(const struct frame_allocator_int* allocator, kstring* out_string) {
     if (!out_string) {
         KERROR("kstring_create requires a valid pointer to a string.");
         return;
     }
 
     kzero_memory(out_string, sizeof(kstring));
+    out_string->allocator = allocator;
 
     kstring_ensure_allocated(out_string, 0);
-    out_string->data[0] = 0;  // Null terminator.
 }
 
 void kstring_from_cstring(const char* source, kstring* out_string) {
@@ -765,18 +1094,15 @@ void kstring_from_cstring(const char* source, kstring* out_string) {
         return;
     }
 
-    u32 source_length = string_length(source);
-    kzero_memory(out_string, sizeof(kstring));
-
-    kstring_ensure_allocated(out_string, source_length);
-
-    string_ncopy(out_string->data, source, source_length);
-    out_string->data[source_length] = 0;
+    kstring_create(out_string);
+    kstring_append_str(out_string, source);
 }
 
 void kstring_destroy(kstring* string) {
     if (string) {
-        kfree(string->data, sizeof(char) * string->allocated, MEMORY_TAG_STRING);
+        if (string->data) {
+            kstring_free(string, string->data, string->allocated);
+        }
         kzero_memory(string, sizeof(kstring));
     }
 }
@@ -789,21 +1115,285 @@ u32 kstring_utf8_length(const kstring* string) {
     return string ? string_utf8_length(string->data) : 0;
 }
 
+void kstring_reserve(kstring* string, u32 capacity) {
+    if (string) {
+        kstring_ensure_allocated(string, capacity);
+    }
+}
+
+void kstring_clear(kstring* string) {
+    if (string && string->data) {
+        string->length = 0;
+        string->data[0] = 0;
+    }
+}
+
+static void kstring_append(kstring* string, const char* s, u32 length) {
+    kstring_ensure_allocated(string, string->length + length);
+    kcopy_memory(string->data + string->length, s, length);
+    string->length += length;
+    string->data[string->length] = 0;
+}
+
 void kstring_append_str(kstring* string, const char* s) {
     if (string && s) {
-        u32 length = string_length(s);
-        kstring_ensure_allocated(string, string->length + length);
-        string_ncopy(string->data + string->length, s, length);
-        string->data[string->length + length] = 0;
-        string->length = string->length + length;
+        kstring_append(string, s, string_length(s));
     }
 }
 
 void kstring_append_kstring(kstring* string, const kstring* other) {
-    if (string && other) {
-        kstring_ensure_allocated(string, string->length + other->length);
-        string_ncopy(string->data + string->length, other->data, other->length);
-        string->data[string->length + other->length] = 0;
-        string->length = string->length + other->length;
+    if (string && other && other->length) {
+        kstring_append(string, other->data, other->length);
+    }
+}
+
+void kstring_append_char(kstring* string, char c) {
+    if (string) {
+        kstring_append(string, &c, 1);
+    }
+}
+
+void kstring_append_int(kstring* string, i64 value) {
+    if (string) {
+        char buffer[STRING_NUMBER_MAX_LENGTH];
+        kstring_append(string, buffer, string_from_i64(buffer, value));
+    }
+}
+
+void kstring_append_float(kstring* string, f64 value, u8 decimals) {
+    if (string) {
+        char buffer[STRING_NUMBER_MAX_LENGTH];
+        kstring_append(string, buffer, string_from_f64(buffer, value, decimals));
+    }
+}
+
+void kstring_append_format(kstring* string, const char* format, ...) {
+    if (!string || !format) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    va_list measure_args;
+    va_copy(measure_args, args);
+    i32 length = vsnprintf(0, 0, format, measure_args);
+    va_end(measure_args);
+    if (length > 0) {
+        // Format straight into the string's storage.
+        kstring_ensure_allocated(string, string->length + length);
+        vsnprintf(string->data + string->length, length + 1, format, args);
+        string->length += length;
     }
+    va_end(args);
+}
+
+// ----------------------
+// kstring view implementation
+// ----------------------
+
+kstring_view kstring_view_create(const char* str, u64 length) {
+    kstring_view view = {str, str ? length : 0};
+    return view;
+}
+
+kstring_view kstring_view_from_cstring(const char* str) {
+    return kstring_view_create(str, str ? string_length(str) : 0);
+}
+
+kstring_view kstring_view_from_kstring(const kstring* string) {
+    return string ? kstring_view_create(string->data, string->length) : kstring_view_create(0, 0);
+}
+
+kstring_view kstring_view_trim(kstring_view view) {
+    while (view.length && isspace((unsigned char)view.str[0])) {
+        view.str++;
+        view.length--;
+    }
+    while (view.length && isspace((unsigned char)view.str[view.length - 1])) {
+        view.length--;
+    }
+    return view;
+}
+
+kstring_view kstring_view_mid(kstring_view view, u64 start, i64 length) {
+    if (start >= view.length) {
+        return kstring_view_create(view.str + view.length, 0);
+    }
+    u64 remaining = view.length - start;
+    u64 count = (length < 0 || (u64)length > remaining) ? remaining : (u64)length;
+    return kstring_view_create(view.str + start, count);
+}
+
+i64 kstring_view_index_of(kstring_view view, char c) {
+    for (u64 i = 0; i < view.length; ++i) {
+        if (view.str[i] == c) {
+            return (i64)i;
+        }
+    }
+    return -1;
+}
+
+b8 kstring_view_split_pair(kstring_view view, char delimiter, kstring_view* out_left, kstring_view* out_right) {
+    i64 index = kstring_view_index_of(view, delimiter);
+    if (index == -1) {
+        return false;
+    }
+    if (out_left) {
+        *out_left = kstring_view_create(view.str, (u64)index);
+    }
+    if (out_right) {
+        *out_right = kstring_view_create(view.str + index + 1, view.length - index - 1);
+    }
+    return true;
+}
+
+u32 kstring_view_split(kstring_view view, char delimiter, kstring_view* out_entries, u32 max_entries, b8 trim_entries) {
+    if (!view.length) {
+        return 0;
+    }
+
+    u32 count = 0;
+    u64 entry_start = 0;
+    for (u64 i = 0; i <= view.length; ++i) {
+        if (i == view.length || view.str[i] == delimiter) {
+            if (out_entries && count < max_entries) {
+                kstring_view entry = kstring_view_create(view.str + entry_start, i - entry_start);
+                out_entries[count] = trim_entries ? kstring_view_trim(entry) : entry;
+            }
+            count++;
+            entry_start = i + 1;
+        }
+    }
+    return count;
+}
+
+b8 kstring_view_equal(kstring_view view, const char* str) {
+    u64 length = str ? string_length(str) : 0;
+    return view.length == length && (length == 0 || strncmp(view.str, str, length) == 0);
+}
+
+b8 kstring_view_equali(kstring_view view, const char* str) {
+    u64 length = str ? string_length(str) : 0;
+    return view.length == length && (length == 0 || strings_nequali(view.str, str, length));
+}
+
+b8 kstring_view_starts_withi(kstring_view view, const char* str) {
+    u64 length = str ? string_length(str) : 0;
+    return view.length >= length && (length == 0 || strings_nequali(view.str, str, length));
+}
+
+b8 kstring_view_to_i64(kstring_view view, i64* out_value) {
+    if (!out_value) {
+        return false;
+    }
+    view = kstring_view_trim(view);
+    const char* end = view.str + view.length;
+    i64 value;
+    if (!view.length || number_parse_i64(view.str, end, &value) != end) {
+        return false;
+    }
+    *out_value = value;
+    return true;
+}
+
+b8 kstring_view_to_u64(kstring_view view, u64* out_value) {
+    if (!out_value) {
+        return false;
+    }
+    view = kstring_view_trim(view);
+    if (view.length && view.str[0] == '+') {
+        view.str++;
+        view.length--;
+    }
+    const char* end = view.str + view.length;
+    u64 value;
+    if (!view.length || number_parse_u64(view.str, end, &value) != end) {
+        return false;
+    }
+    *out_value = value;
+    return true;
+}
+
+b8 kstring_view_to_i32(kstring_view view, i32* out_value) {
+    i64 value;
+    if (!out_value || !kstring_view_to_i64(view, &value) || value < INT32_MIN || value > INT32_MAX) {
+        return false;
+    }
+    *out_value = (i32)value;
+    return true;
+}
+
+b8 kstring_view_to_u32(kstring_view view, u32* out_value) {
+    u64 value;
+    if (!out_value || !kstring_view_to_u64(view, &value) || value > UINT32_MAX) {
+        return false;
+    }
+    *out_value = (u32)value;
+    return true;
+}
+
+b8 kstring_view_to_u8(kstring_view view, u8* out_value) {
+    u64 value;
+    if (!out_value || !kstring_view_to_u64(view, &value) || value > UINT8_MAX) {
+        return false;
+    }
+    *out_value = (u8)value;
+    return true;
+}
+
+b8 kstring_view_to_f64(kstring_view view, f64* out_value) {
+    if (!out_value) {
+        return false;
+    }
+    view = kstring_view_trim(view);
+    const char* end = view.str + view.length;
+    f64 value;
+    if (!view.length || number_parse_f64(view.str, end, &value) != end) {
+        return false;
+    }
+    *out_value = value;
+    return true;
+}
+
+b8 kstring_view_to_f32(kstring_view view, f32* out_value) {
+    f64 value;
+    if (!out_value || !kstring_view_to_f64(view, &value)) {
+        return false;
+    }
+    *out_value = (f32)value;
+    return true;
+}
+
+b8 kstring_view_to_bool(kstring_view view, b8* out_value) {
+    if (!out_value) {
+        return false;
+    }
+    view = kstring_view_trim(view);
+    if (kstring_view_equal(view, "1") || kstring_view_equali(view, "true")) {
+        *out_value = true;
+        return true;
+    }
+    *out_value = false;
+    return kstring_view_equal(view, "0") || kstring_view_equali(view, "false");
+}
+
+u64 kstring_view_copy(char* dest, kstring_view view, u64 dest_size) {
+    if (!dest || !dest_size) {
+        return 0;
+    }
+    u64 count = KMIN(view.length, dest_size - 1);
+    if (count) {
+        kcopy_memory(dest, view.str, count);
+    }
+    dest[count] = 0;
+    return count;
+}
+
+char* kstring_view_duplicate(kstring_view view) {
+    char* copy = kallocate(view.length + 1, MEMORY_TAG_STRING);
+    if (view.length) {
+        kcopy_memory(copy, view.str, view.length);
+    }
+    copy[view.length] = 0;
+    return copy;
 }
@@ -332,13 +332,59 @@ KAPI b8 string_to_u32(const char* str, u32* u);
  */
 KAPI b8 string_to_u64(const char* str, u64* u);
 
+/**
+ * @brief Parses a floating point number from the start of the given string, skipping leading
+ * whitespace. Locale-independent, and does not allocate. Intended for reading several numbers
+ * out of one line, such as the components of an OBJ vertex.
+ *
+ * @param str The string to parse from.
+ * @param out_value A pointer to hold the value.
+ * @returns A pointer to the character just past the number, or 0 if no number was found.
+ */
+KAPI const char* string_parse_f64(const char* str, f64* out_value);
+/** @brief Parses an f32 from the start of the given string. See string_parse_f64. */
+KAPI const char* string_parse_f32(const char* str, f32* out_value);
+/** @brief Parses a signed integer from the start of the given string. Accepts hexadecimal with a "0x" prefix. See string_parse_f64. */
+KAPI const char* string_parse_i64(const char* str, i64* out_value);
+/** @brief Parses an unsigned integer from the start of the given string. See string_parse_i64. */
+KAPI const char* string_parse_u64(const char* str, u64* out_value);
+/** @brief Parses a u32 from the start of the given string, failing if it is out of range. See string_parse_i64. */
+KAPI const char* string_parse_u32(const char* str, u32* out_value);
+
+/** @brief The size of a buffer large enough to hold any number written by the string_from_* functions. */
+#define STRING_NUMBER_MAX_LENGTH 32
+
+/**
+ * @brief Writes an unsigned integer to dest as a null-terminated string, without going through printf.
+ *
+ * @param dest The buffer to write to. Must hold at least STRING_NUMBER_MAX_LENGTH characters.
+ * @param value The value to be written.
+ * @returns The number of characters written, not including the null terminator.
+ */
+KAPI u32 string_from_u64(char* dest, u64 value);
+/** @brief Writes a signed integer to dest as a null-terminated string. See string_from_u64. */
+KAPI u32 string_from_i64(char* dest, i64 value);
+
+/**
+ * @brief Writes a floating point number to dest with a fixed number of decimals, like "%.*f",
+ * without going through printf. Rounds half away from zero after scaling, so a value within an ulp
+ * of a tie may differ from printf in the last digit. Values too large for a fixed-point
+ * representation fall back to exponent notation.
+ *
+ * @param dest The buffer to write to. Must hold at least STRING_NUMBER_MAX_LENGTH characters.
+ * @param value The value to be written.
+ * @param decimals The number of decimal places, up to 9.
+ * @returns The number of characters written, not including the null terminator.
+ */
+KAPI u32 string_from_f64(char* dest, f64 value, u8 decimals);
+
 /**
  * @brief Attempts to parse a boolean from the provided string.
  * "true" or "1" are considered true; anything else is false.
  *
  * @param str The string to parse from. "true" or "1" are considered true; anything else is false.
  * @param b A pointer to the boolean to write to.
- * @return True if parsed successfully; otherwise false.
+ * @return True if parsed successfully, i.e. the string was "true", "false", "1" or "0"; otherwise false.
  */
 KAPI b8 string_to_bool(const char* str, b8* b);
 
@@ -445,27 +491,206 @@ KAPI b8 string_parse_array_length(const char* str, u32* out_length);
 // KString implementation
 // ----------------------
 
+struct frame_allocator_int;
+
 /**
  * @brief A kstring is a managed string for higher-level logic to use. It is
  * safer and, in some cases quicker than a typical cstring because it maintains
  * length/allocation information and doesn't have to use strlen on most of its
- * internal operations.
+ * internal operations. Its storage grows geometrically, so building a string
+ * with many appends only reallocates a handful of times.
  */
 typedef struct kstring {
     /** @brief The current length of the string in bytes. */
     u32 length;
     /** @brief The amount of currently allocated memory. Always accounts for a null terminator. */
     u32 allocated;
-    /** @brief The raw string data. */
+    /** @brief The raw string data. Always null-terminated. */
     char* data;
+    /** @brief The allocator the data comes from. 0 to use kallocate with MEMORY_TAG_STRING. */
+    const struct frame_allocator_int* allocator;
 } kstring;
 
 KAPI void kstring_create(kstring* out_string);
+/**
+ * @brief Creates an empty kstring whose storage comes from the given allocator, such as the
+ * frame allocator for strings which only need to live for a few frames.
+ *
+ * @param allocator A constant pointer to the allocator interface to use. Must outlive the string. Pass 0 to use kallocate.
+ * @param out_string A pointer to hold the string.
+ */
+KAPI void kstring_create_with_allocator(const struct frame_allocator_int* allocator, kstring* out_string);
 KAPI void kstring_from_cstring(const char* source, kstring* out_string);
 KAPI void kstring_destroy(kstring* string);
 
 KAPI u32 kstring_length(const kstring* string);
 KAPI u32 kstring_utf8_length(const kstring* string);
 
+/**
+ * @brief Ensures the string can hold at least the given number of bytes without reallocating.
+ *
+ * @param string A pointer to the string.
+ * @param capacity The length to reserve, not including the null terminator.
+ */
+KAPI void kstring_reserve(kstring* string, u32 capacity);
+/**
+ * @brief Empties the string, keeping its storage for reuse.
+ *
+ * @param string A pointer to the string.
+ */
+KAPI void kstring_clear(kstring* string);
+
 KAPI void kstring_append_str(kstring* string, const char* s);
 KAPI void kstring_append_kstring(kstring* string, const kstring* other);
+KAPI void kstring_append_char(kstring* string, char c);
+KAPI void kstring_append_int(kstring* string, i64 value);
+/** @brief Appends a floating point number with the given number of decimal places. See string_from_f64. */
+KAPI void kstring_append_float(kstring* string, f64 value, u8 decimals);
+/**
+ * @brief Appends formatted text to the string, growing it as required.
+ *
+ * @param string A pointer to the string.
+ * @param format The format string, as used by string_format.
+ * @param ... The format arguments.
+ */
+KAPI void kstring_append_format(kstring* string, const char* format, ...);
+
+// ----------------------
+// KString view
+// ----------------------
+
+/**
+ * @brief A non-owning view of a run of characters, which is not required to be null-terminated.
+ * Views are passed by value and never allocate, so text can be split, trimmed and parsed where
+ * it was read into instead of being copied into scratch buffers along the way. A view is only
+ * valid as long as the memory it points to.
+ */
+typedef struct kstring_view {
+    /** @brief The first character of the view. */
+    const char* str;
+    /** @brief The number of characters in the view. */
+    u64 length;
+} kstring_view;
+
+/** @brief Creates a view of the given number of characters, starting at str. */
+KAPI kstring_view kstring_view_create(const char* str, u64 length);
+/** @brief Creates a view of the whole of the given null-terminated string. An empty view if str is 0. */
+KAPI kstring_view kstring_view_from_cstring(const char* str);
+/** @brief Creates a view of the current contents of the given kstring. */
+KAPI kstring_view kstring_view_from_kstring(const kstring* string);
+
+/**
+ * @brief Gets a view of the given view without leading or trailing whitespace.
+ *
+ * @param view The view to be trimmed.
+ * @returns The trimmed view, which points into the same memory.
+ */
+KAPI kstring_view kstring_view_trim(kstring_view view);
+
+/**
+ * @brief Gets a view of part of the given view. Both ends are clamped to the view.
+ *
+ * @param view The view to take part of.
+ * @param start The index of the first character.
+ * @param length The number of characters. -1 for the rest of the view.
+ * @returns The view of the requested part.
+ */
+KAPI kstring_view kstring_view_mid(kstring_view view, u64 start, i64 length);
+
+/**
+ * @brief Gets the index of the first occurrence of a character in the given view.
+ *
+ * @param view The view to be searched.
+ * @param c The character to search for.
+ * @returns The index of the character if found; otherwise -1.
+ */
+KAPI i64 kstring_view_index_of(kstring_view view, char c);
+
+/**
+ * @brief Splits the given view around the first occurrence of the delimiter, such as the '=' of a
+ * "var=value" pair. Neither side is trimmed, nor includes the delimiter.
+ *
+ * @param view The view to be split.
+ * @param delimiter The character to split on.
+ * @param out_left A pointer to hold the view of the text before the delimiter.
+ * @param out_right A pointer to hold the view of the text after the delimiter.
+ * @returns True if the delimiter was found; otherwise false, and the outputs are left unchanged.
+ */
+KAPI b8 kstring_view_split_pair(kstring_view view, char delimiter, kstring_view* out_left, kstring_view* out_right);
+
+/**
+ * @brief Splits the given view by the delimiter into views of each entry, without allocating.
+ * Empty entries are included, so the entry count of "a,,b" is 3.
+ *
+ * @param view The view to be split.
+ * @param delimiter The character to split on.
+ * @param out_entries An array of max_entries views to hold the entries.
+ * @param max_entries The number of views out_entries can hold. Entries beyond this are counted but not written.
+ * @param trim_entries Trims each entry if true.
+ * @returns The number of entries in the view, which may be larger than max_entries.
+ */
+KAPI u32 kstring_view_split(kstring_view view, char delimiter, kstring_view* out_entries, u32 max_entries, b8 trim_entries);
+
+/** @brief Indicates if the view holds exactly the given null-terminated string. Case-sensitive. */
+KAPI b8 kstring_view_equal(kstring_view view, const char* str);
+/** @brief Indicates if the view holds exactly the given null-terminated string. Case-insensitive. */
+KAPI b8 kstring_view_equali(kstring_view view, const char* str);
+/** @brief Indicates if the view begins with the given null-terminated string. Case-insensitive. */
+KAPI b8 kstring_view_starts_withi(kstring_view view, const char* str);
+
+/**
+ * @brief Parses the whole of the view as a signed integer. Accepts an optional sign, and
+ * hexadecimal with a "0x" prefix. Leading and trailing whitespace is ignored.
+ *
+ * @param view The view to be parsed.
+ * @param out_value A pointer to hold the value. Left unchanged on failure.
+ * @returns True if the view holds an integer in range; otherwise false.
+ */
+KAPI b8 kstring_view_to_i64(kstring_view view, i64* out_value);
+/** @brief Parses the whole of the view as an unsigned integer. See kstring_view_to_i64. */
+KAPI b8 kstring_view_to_u64(kstring_view view, u64* out_value);
+/** @brief Parses the whole of the view as an i32. See kstring_view_to_i64. */
+KAPI b8 kstring_view_to_i32(kstring_view view, i32* out_value);
+/** @brief Parses the whole of the view as a u32. See kstring_view_to_i64. */
+KAPI b8 kstring_view_to_u32(kstring_view view, u32* out_value);
+/** @brief Parses the whole of the view as a u8. See kstring_view_to_i64. */
+KAPI b8 kstring_view_to_u8(kstring_view view, u8* out_value);
+
+/**
+ * @brief Parses the whole of the view as a floating point number. Leading and trailing whitespace is ignored.
+ *
+ * @param view The view to be parsed.
+ * @param out_value A pointer to hold the value. Left unchanged on failure.
+ * @returns True if the view holds a number; otherwise false.
+ */
+KAPI b8 kstring_view_to_f64(kstring_view view, f64* out_value);
+/** @brief Parses the whole of the view as an f32. See kstring_view_to_f64. */
+KAPI b8 kstring_view_to_f32(kstring_view view, f32* out_value);
+
+/**
+ * @brief Parses the view as a boolean. "1" and "true" are true, "0" and "false" are false, case-insensitive.
+ *
+ * @param view The view to be parsed.
+ * @param out_value A pointer to hold the value. Set to false if the view holds neither.
+ * @returns True if the view holds one of the recognised values; otherwise false.
+ */
+KAPI b8 kstring_view_to_bool(kstring_view view, b8* out_value);
+
+/**
+ * @brief Copies the view into the given buffer as a null-terminated string, truncating it to fit.
+ *
+ * @param dest The buffer to copy into.
+ * @param view The view to be copied.
+ * @param dest_size The size of dest in bytes, including room for the null terminator.
+ * @returns The number of characters copied, not including the null terminator.
+ */
+KAPI u64 kstring_view_copy(char* dest, kstring_view view, u64 dest_size);
+
+/**
+ * @brief Takes a null-terminated copy of the view, for text which needs to outlive the memory it
+ * was parsed from. Free it with string_free.
+ *
+ * @param view The view to be copied.
+ * @returns The copy.
+ */
+KAPI char* kstring_view_duplicate(kstring_view view);
@@ -12,6 +12,20 @@ typedef struct kthread {
     u64 thread_id;
 } kthread;
 
+/** @brief The most logical processors a thread's affinity can name. */
+#define KTHREAD_AFFINITY_MAX_PROCESSORS 8
+
+/**
+ * @brief A set of logical processors (hardware threads) a thread may run on, such as those of
+ * one physical core.
+ */
+typedef struct kthread_affinity {
+    /** @brief The number of processors in the set. 0 allows any. */
+    u32 processor_count;
+    /** @brief The indices of the logical processors, as numbered by the platform's CPU topology. */
+    u32 processors[KTHREAD_AFFINITY_MAX_PROCESSORS];
+} kthread_affinity;
+
 // A function pointer to be invoked when the thread starts.
 typedef u32 (*pfn_thread_start)(void *);
 
@@ -40,6 +54,13 @@ KAPI void kthread_detach(kthread *thread);
  */
 KAPI void kthread_cancel(kthread *thread);
 
+/**
+ * Blocks the calling thread until the given thread's work completes, then
+ * releases the thread's resources.
+ * @returns True if the thread was waited on successfully; otherwise false.
+ */
+KAPI b8 kthread_wait(kthread *thread);
+
 /**
  * Indicates if the thread is currently active.
  * @returns True if active; otherwise false.
@@ -52,6 +73,14 @@ KAPI b8 kthread_is_active(kthread *thread);
  */
 KAPI void kthread_sleep(kthread *thread, u64 ms);
 
+/**
+ * @brief Restricts the calling thread to run only on the given logical processors. Not all
+ * platforms allow this (e.g. macOS), in which case the thread runs anywhere.
+ * @param affinity A constant pointer to the processors. An empty set allows any.
+ * @returns True if the affinity was applied; otherwise false.
+ */
+KAPI b8 kthread_affinity_set_current(const kthread_affinity *affinity);
+
 /**
  * @brief Obtains the identifier for the current thread.
  */
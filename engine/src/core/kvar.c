@@ -1,5 +1,6 @@
 #include "kvar.h"
 
+#include "containers/hashmap.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
 #include "core/kstring.h"
@@ -7,24 +8,49 @@
 
 #include "core/console.h"
 
-typedef struct kvar_int_entry {
+typedef struct kvar_entry {
     const char* name;
-    i32 value;
-} kvar_int_entry;
+    kvar_types type;
+    union {
+        i32 i;
+        f32 f;
+        b8 b;
+        char* s;
+    } value;
+} kvar_entry;
 
-#define KVAR_INT_MAX_COUNT 200
+#define KVAR_MAX_COUNT 256
 
 typedef struct kvar_system_state {
-    // Integer kvars.
-    kvar_int_entry ints[KVAR_INT_MAX_COUNT];
+    // The number of kvars created. Handles index into entries, and are never reused.
+    u32 count;
+    kvar_entry entries[KVAR_MAX_COUNT];
+    // Handles, keyed by the case-insensitive hash of the kvar name.
+    hashmap lookup;
 } kvar_system_state;
 
 static kvar_system_state* state_ptr;
 
 static void kvar_console_commands_register(void);
 
+static const char* kvar_type_name(kvar_types type) {
+    switch (type) {
+        case KVAR_TYPE_INT:
+            return "int";
+        case KVAR_TYPE_FLOAT:
+            return "float";
+        case KVAR_TYPE_BOOL:
+            return "bool";
+        case KVAR_TYPE_STRING:
+            return "string";
+    }
+    return "unknown";
+}
+
 b8 kvar_initialize(u64* memory_requirement, void* memory, void* config) {
-    *memory_requirement = sizeof(kvar_system_state);
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(kvar_handle), KVAR_MAX_COUNT, &lookup_requirement, 0, 0);
+    *memory_requirement = sizeof(kvar_system_state) + lookup_requirement;
 
     if (!memory) {
         return true;
@@ -34,78 +60,273 @@ b8 kvar_initialize(u64* memory_requirement, void* memory, void* config) {
 
     kzero_memory(state_ptr, sizeof(kvar_system_state));
 
+    void* lookup_block = (void*)((u64)memory + sizeof(kvar_system_state));
+    if (!hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(kvar_handle), KVAR_MAX_COUNT, &lookup_requirement, lookup_block, &state_ptr->lookup)) {
+        KERROR("Failed to create kvar lookup.");
+        return false;
+    }
+
     kvar_console_commands_register();
 
     return true;
 }
 void kvar_shutdown(void* state) {
     if (state_ptr) {
+        for (u32 i = 0; i < state_ptr->count; ++i) {
+            kvar_entry* entry = &state_ptr->entries[i];
+            string_free((char*)entry->name);
+            if (entry->type == KVAR_TYPE_STRING) {
+                string_free(entry->value.s);
+            }
+        }
+        hashmap_destroy(&state_ptr->lookup);
         kzero_memory(state_ptr, sizeof(kvar_system_state));
+        state_ptr = 0;
     }
 }
 
-b8 kvar_int_create(const char* name, i32 value) {
+kvar_handle kvar_handle_get(const char* name) {
     if (!state_ptr || !name) {
+        return INVALID_ID;
+    }
+
+    kvar_handle handle = INVALID_ID;
+    if (!hashmap_get_u64(&state_ptr->lookup, hashmap_hash_stringi(name), &handle)) {
+        return INVALID_ID;
+    }
+    // Guard against the (unlikely) case of two names with the same hash.
+    if (!strings_equali(state_ptr->entries[handle].name, name)) {
+        return INVALID_ID;
+    }
+    return handle;
+}
+
+b8 kvar_type_get(kvar_handle handle, kvar_types* out_type) {
+    if (!state_ptr || handle >= state_ptr->count) {
         return false;
     }
+    *out_type = state_ptr->entries[handle].type;
+    return true;
+}
 
-    for (u32 i = 0; i < KVAR_INT_MAX_COUNT; ++i) {
-        kvar_int_entry* entry = &state_ptr->ints[i];
-        if (entry->name && strings_equali(entry->name, name)) {
-            KERROR("A int kvar named '%s' already exists.", name);
-            return false;
-        }
+// Creates a kvar of the given type, with its value still to be set.
+static kvar_entry* kvar_entry_create(const char* name, kvar_types type) {
+    if (!state_ptr || !name) {
+        return 0;
     }
 
-    for (u32 i = 0; i < KVAR_INT_MAX_COUNT; ++i) {
-        kvar_int_entry* entry = &state_ptr->ints[i];
-        if (!entry->name) {
-            entry->name = string_duplicate(name);
-            entry->value = value;
-            return true;
-        }
+    if (kvar_handle_get(name) != INVALID_ID) {
+        KERROR("A kvar named '%s' already exists.", name);
+        return 0;
+    }
+
+    if (state_ptr->count >= KVAR_MAX_COUNT) {
+        KERROR("kvar_create could not find a free slot to store an entry in.");
+        return 0;
+    }
+
+    kvar_handle handle = state_ptr->count;
+    if (!hashmap_set_u64(&state_ptr->lookup, hashmap_hash_stringi(name), &handle)) {
+        KERROR("Failed to register kvar '%s'.", name);
+        return 0;
+    }
+    state_ptr->count++;
+
+    kvar_entry* entry = &state_ptr->entries[handle];
+    entry->name = string_duplicate(name);
+    entry->type = type;
+    return entry;
+}
+
+// Finds the kvar of the given type with the given name, reporting an error if there is none.
+static kvar_entry* kvar_entry_get(const char* name, kvar_types type) {
+    kvar_handle handle = kvar_handle_get(name);
+    if (handle == INVALID_ID) {
+        KERROR("Could not find a kvar named '%s'.", name);
+        return 0;
     }
+    kvar_entry* entry = &state_ptr->entries[handle];
+    if (entry->type != type) {
+        KERROR("The kvar '%s' is a %s, not a %s.", name, kvar_type_name(entry->type), kvar_type_name(type));
+        return 0;
+    }
+    return entry;
+}
 
-    KERROR("kvar_create_int could not find a free slot to store an entry in.");
-    return false;
+static void kvar_changed(const kvar_entry* entry) {
+    // TODO: also pass type?
+    event_context context = {0};
+    string_ncopy(context.data.c, entry->name, sizeof(context.data.c) - 1);
+    event_fire(EVENT_CODE_KVAR_CHANGED, 0, context);
+}
+
+b8 kvar_int_create(const char* name, i32 value) {
+    kvar_entry* entry = kvar_entry_create(name, KVAR_TYPE_INT);
+    if (!entry) {
+        return false;
+    }
+    entry->value.i = value;
+    return true;
 }
 
 b8 kvar_int_get(const char* name, i32* out_value) {
-    if (!state_ptr || !name) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_INT);
+    if (!entry) {
         return false;
     }
+    *out_value = entry->value.i;
+    return true;
+}
 
-    for (u32 i = 0; i < KVAR_INT_MAX_COUNT; ++i) {
-        kvar_int_entry* entry = &state_ptr->ints[i];
-        if (entry->name && strings_equali(name, entry->name)) {
-            *out_value = entry->value;
-            return true;
-        }
+b8 kvar_int_set(const char* name, i32 value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_INT);
+    if (!entry) {
+        return false;
     }
+    entry->value.i = value;
+    kvar_changed(entry);
+    return true;
+}
 
-    KERROR("kvar_get_int could not find a kvar named '%s'.", name);
-    return false;
+b8 kvar_float_create(const char* name, f32 value) {
+    kvar_entry* entry = kvar_entry_create(name, KVAR_TYPE_FLOAT);
+    if (!entry) {
+        return false;
+    }
+    entry->value.f = value;
+    return true;
 }
 
-b8 kvar_int_set(const char* name, i32 value) {
-    if (!state_ptr || !name) {
+b8 kvar_float_get(const char* name, f32* out_value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_FLOAT);
+    if (!entry) {
         return false;
     }
+    *out_value = entry->value.f;
+    return true;
+}
 
-    for (u32 i = 0; i < KVAR_INT_MAX_COUNT; ++i) {
-        kvar_int_entry* entry = &state_ptr->ints[i];
-        if (entry->name && strings_equali(name, entry->name)) {
-            entry->value = value;
-            // TODO: also pass type?
-            event_context context = {0};
-            string_ncopy(context.data.c, name, 16);
-            event_fire(EVENT_CODE_KVAR_CHANGED, 0, context);
-            return true;
-        }
+b8 kvar_float_set(const char* name, f32 value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_FLOAT);
+    if (!entry) {
+        return false;
+    }
+    entry->value.f = value;
+    kvar_changed(entry);
+    return true;
+}
+
+b8 kvar_bool_create(const char* name, b8 value) {
+    kvar_entry* entry = kvar_entry_create(name, KVAR_TYPE_BOOL);
+    if (!entry) {
+        return false;
+    }
+    entry->value.b = value;
+    return true;
+}
+
+b8 kvar_bool_get(const char* name, b8* out_value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_BOOL);
+    if (!entry) {
+        return false;
+    }
+    *out_value = entry->value.b;
+    return true;
+}
+
+b8 kvar_bool_set(const char* name, b8 value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_BOOL);
+    if (!entry) {
+        return false;
+    }
+    entry->value.b = value;
+    kvar_changed(entry);
+    return true;
+}
+
+b8 kvar_string_create(const char* name, const char* value) {
+    if (!value) {
+        KERROR("kvar_string_create requires a value.");
+        return false;
     }
+    kvar_entry* entry = kvar_entry_create(name, KVAR_TYPE_STRING);
+    if (!entry) {
+        return false;
+    }
+    entry->value.s = string_duplicate(value);
+    return true;
+}
+
+b8 kvar_string_get(const char* name, const char** out_value) {
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_STRING);
+    if (!entry) {
+        return false;
+    }
+    *out_value = entry->value.s;
+    return true;
+}
+
+b8 kvar_string_set(const char* name, const char* value) {
+    if (!value) {
+        KERROR("kvar_string_set requires a value.");
+        return false;
+    }
+    kvar_entry* entry = kvar_entry_get(name, KVAR_TYPE_STRING);
+    if (!entry) {
+        return false;
+    }
+    string_free(entry->value.s);
+    entry->value.s = string_duplicate(value);
+    kvar_changed(entry);
+    return true;
+}
+
+i32 kvar_int_value(kvar_handle handle, i32 default_value) {
+    if (!state_ptr || handle >= state_ptr->count || state_ptr->entries[handle].type != KVAR_TYPE_INT) {
+        return default_value;
+    }
+    return state_ptr->entries[handle].value.i;
+}
+
+f32 kvar_float_value(kvar_handle handle, f32 default_value) {
+    if (!state_ptr || handle >= state_ptr->count || state_ptr->entries[handle].type != KVAR_TYPE_FLOAT) {
+        return default_value;
+    }
+    return state_ptr->entries[handle].value.f;
+}
+
+b8 kvar_bool_value(kvar_handle handle, b8 default_value) {
+    if (!state_ptr || handle >= state_ptr->count || state_ptr->entries[handle].type != KVAR_TYPE_BOOL) {
+        return default_value;
+    }
+    return state_ptr->entries[handle].value.b;
+}
+
+const char* kvar_string_value(kvar_handle handle) {
+    if (!state_ptr || handle >= state_ptr->count || state_ptr->entries[handle].type != KVAR_TYPE_STRING) {
+        return 0;
+    }
+    return state_ptr->entries[handle].value.s;
+}
 
-    KERROR("kvar_set_int could not find a kvar named '%s'.", name);
-    return false;
+// Writes "name = value" for the given kvar to the console.
+static void kvar_console_write(const kvar_entry* entry) {
+    char out_str[500] = {0};
+    switch (entry->type) {
+        case KVAR_TYPE_INT:
+            string_format(out_str, "%s = %i", entry->name, entry->value.i);
+            break;
+        case KVAR_TYPE_FLOAT:
+            string_format(out_str, "%s = %f", entry->name, entry->value.f);
+            break;
+        case KVAR_TYPE_BOOL:
+            string_format(out_str, "%s = %s", entry->name, entry->value.b ? "true" : "false");
+            break;
+        case KVAR_TYPE_STRING:
+            string_format(out_str, "%s = \"%s\"", entry->name, entry->value.s);
+            break;
+    }
+    console_write_line(LOG_LEVEL_INFO, out_str);
 }
 
 static void kvar_console_command_int_create(console_command_context context) {
@@ -127,65 +348,129 @@ static void kvar_console_command_int_create(console_command_context context) {
     }
 }
 
-static void kvar_console_command_int_print(console_command_context context) {
+static void kvar_console_command_float_create(console_command_context context) {
+    if (context.argument_count != 2) {
+        KERROR("kvar_console_command_float_create requires a context arg count of 2.");
+        return;
+    }
+
+    const char* name = context.arguments[0].value;
+    const char* val_str = context.arguments[1].value;
+    f32 value = 0;
+    if (!string_to_f32(val_str, &value)) {
+        KERROR("Failed to convert argument 1 to f32: '%s'.", val_str);
+        return;
+    }
+
+    if (!kvar_float_create(name, value)) {
+        KERROR("Failed to create float kvar.");
+    }
+}
+
+static void kvar_console_command_bool_create(console_command_context context) {
+    if (context.argument_count != 2) {
+        KERROR("kvar_console_command_bool_create requires a context arg count of 2.");
+        return;
+    }
+
+    const char* name = context.arguments[0].value;
+    const char* val_str = context.arguments[1].value;
+    b8 value = false;
+    if (!string_to_bool(val_str, &value)) {
+        KERROR("Failed to convert argument 1 to bool: '%s'.", val_str);
+        return;
+    }
+
+    if (!kvar_bool_create(name, value)) {
+        KERROR("Failed to create bool kvar.");
+    }
+}
+
+static void kvar_console_command_string_create(console_command_context context) {
+    if (context.argument_count != 2) {
+        KERROR("kvar_console_command_string_create requires a context arg count of 2.");
+        return;
+    }
+
+    if (!kvar_string_create(context.arguments[0].value, context.arguments[1].value)) {
+        KERROR("Failed to create string kvar.");
+    }
+}
+
+static void kvar_console_command_print(console_command_context context) {
     if (context.argument_count != 1) {
-        KERROR("kvar_console_command_int_print requires a context arg count of 1.");
+        KERROR("kvar_console_command_print requires a context arg count of 1.");
         return;
     }
 
     const char* name = context.arguments[0].value;
-    i32 value = 0;
-    if (!kvar_int_get(name, &value)) {
+    kvar_handle handle = kvar_handle_get(name);
+    if (handle == INVALID_ID) {
         KERROR("Failed to find kvar called '%s'.", name);
         return;
     }
 
-    char val_str[50] = {0};
-    string_format(val_str, "%i", value);
-
-    console_write_line(LOG_LEVEL_INFO, val_str);
+    kvar_console_write(&state_ptr->entries[handle]);
 }
 
-static void kvar_console_command_int_set(console_command_context context) {
+static void kvar_console_command_set(console_command_context context) {
     if (context.argument_count != 2) {
-        KERROR("kvar_console_command_int_set requires a context arg count of 2.");
+        KERROR("kvar_console_command_set requires a context arg count of 2.");
         return;
     }
 
     const char* name = context.arguments[0].value;
     const char* val_str = context.arguments[1].value;
-    i32 value = 0;
-    if (!string_to_i32(val_str, &value)) {
-        KERROR("Failed to convert argument 1 to i32: '%s'.", val_str);
+    kvar_handle handle = kvar_handle_get(name);
+    if (handle == INVALID_ID) {
+        KERROR("Failed to set kvar called '%s' because it doesn't exist.", name);
         return;
     }
 
-    if (!kvar_int_set(name, value)) {
-        KERROR("Failed to set int kvar called '%s' because it doesn't exist.", name);
+    // The value is parsed according to the type of the kvar.
+    kvar_entry* entry = &state_ptr->entries[handle];
+    b8 result = false;
+    switch (entry->type) {
+        case KVAR_TYPE_INT: {
+            i32 value = 0;
+            result = string_to_i32(val_str, &value) && kvar_int_set(name, value);
+        } break;
+        case KVAR_TYPE_FLOAT: {
+            f32 value = 0;
+            result = string_to_f32(val_str, &value) && kvar_float_set(name, value);
+        } break;
+        case KVAR_TYPE_BOOL: {
+            b8 value = false;
+            result = string_to_bool(val_str, &value) && kvar_bool_set(name, value);
+        } break;
+        case KVAR_TYPE_STRING:
+            result = kvar_string_set(name, val_str);
+            break;
     }
 
-    char out_str[500] = {0};
-    string_format(out_str, "%s = %i", name, value);
-    console_write_line(LOG_LEVEL_INFO, val_str);
+    if (!result) {
+        KERROR("Failed to set %s kvar '%s' to '%s'.", kvar_type_name(entry->type), name, val_str);
+        return;
+    }
+
+    kvar_console_write(entry);
 }
 
 static void kvar_console_command_print_all(console_command_context context) {
-    // Int kvars
-    for (u32 i = 0; i < KVAR_INT_MAX_COUNT; ++i) {
-        kvar_int_entry* entry = &state_ptr->ints[i];
-        if (entry->name) {
-            char val_str[500] = {0};
-            string_format(val_str, "%s = %i", entry->name, entry->value);
-            console_write_line(LOG_LEVEL_INFO, val_str);
-        }
+    for (u32 i = 0; i < state_ptr->count; ++i) {
+        kvar_console_write(&state_ptr->entries[i]);
     }
-
-    // TODO: Other variable types.
 }
 
 static void kvar_console_commands_register(void) {
     console_command_register("kvar_create_int", 2, kvar_console_command_int_create);
-    console_command_register("kvar_print_int", 1, kvar_console_command_int_print);
-    console_command_register("kvar_set_int", 2, kvar_console_command_int_set);
+    console_command_register("kvar_create_float", 2, kvar_console_command_float_create);
+    console_command_register("kvar_create_bool", 2, kvar_console_command_bool_create);
+    console_command_register("kvar_create_string", 2, kvar_console_command_string_create);
+    // The typed print and set commands are kept for existing scripts and bindings.
+    console_command_register("kvar_print_int", 1, kvar_console_command_print);
+    console_command_register("kvar_set_int", 2, kvar_console_command_set);
+    console_command_register("kvar_print", 1, kvar_console_command_print);
+    console_command_register("kvar_set", 2, kvar_console_command_set);
     console_command_register("kvar_print_all", 0, kvar_console_command_print_all);
 }
@@ -3,7 +3,11 @@
  * @author Travis Vroman (travis@kohiengine.com)
  * @brief A file that contains the KVar system. KVars are global variables
  * that are dynamically created and set/used within the engine and/or
- * application, and are accessible from anywhere.
+ * application, and are accessible from anywhere. KVars may hold ints,
+ * floats, bools or strings, and are found by name through a hashed lookup.
+ * Code which reads a kvar often (i.e. every frame) should obtain its
+ * handle once with kvar_handle_get() and read it through that, which
+ * involves no lookup at all.
  * @version 1.0
  * @date 2023-01-18
  * 
@@ -14,6 +18,17 @@
 
 #include "defines.h"
 
+/** @brief The types a kvar may hold. */
+typedef enum kvar_types {
+    KVAR_TYPE_INT,
+    KVAR_TYPE_FLOAT,
+    KVAR_TYPE_BOOL,
+    KVAR_TYPE_STRING
+} kvar_types;
+
+/** @brief A handle to a kvar, valid for the life of the kvar system. INVALID_ID if none. */
+typedef u32 kvar_handle;
+
 /**
  * @brief Initializes the KVar system. KVars are global variables
  * that are dynamically created and set/used within the engine and/or
@@ -36,8 +51,8 @@ b8 kvar_initialize(u64* memory_requirement, void* memory, void* config);
 void kvar_shutdown(void* state);
 
 /**
- * @brief Creates an integer variable type.
- * 
+ * @brief Creates an integer variable.
+ *
  * @param name The name of the variable.
  * @param value The value of the variable.
  * @return True on success; otherwise false.
@@ -45,9 +60,9 @@ void kvar_shutdown(void* state);
 KAPI b8 kvar_int_create(const char* name, i32 value);
 
 /**
- * @brief Attempts to obtain a variable value with the given
- * name. Returns false if not found.
- * 
+ * @brief Attempts to obtain the value of the integer variable with the
+ * given name. Returns false if not found, or if it is of another type.
+ *
  * @param name The name of the variable.
  * @param out_value A pointer to hold the variable.
  * @return True if the variable was found; otherwise false.
@@ -55,11 +70,156 @@ KAPI b8 kvar_int_create(const char* name, i32 value);
 KAPI b8 kvar_int_get(const char* name, i32* out_value);
 
 /**
- * @brief Attempts to set the value of an existing variable with
- * the given name. Returns false if the variable was not found.
- * 
+ * @brief Attempts to set the value of an existing integer variable with
+ * the given name. Returns false if the variable was not found, or if it is
+ * of another type.
+ *
  * @param name The name of the variable.
  * @param value The value to be set.
  * @return True if found and set, otherwise false.
  */
 KAPI b8 kvar_int_set(const char* name, i32 value);
+
+/**
+ * @brief Creates a floating-point variable.
+ *
+ * @param name The name of the variable.
+ * @param value The value of the variable.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kvar_float_create(const char* name, f32 value);
+
+/**
+ * @brief Attempts to obtain the value of the floating-point variable with the
+ * given name. Returns false if not found, or if it is of another type.
+ *
+ * @param name The name of the variable.
+ * @param out_value A pointer to hold the variable.
+ * @return True if the variable was found; otherwise false.
+ */
+KAPI b8 kvar_float_get(const char* name, f32* out_value);
+
+/**
+ * @brief Attempts to set the value of an existing floating-point variable with
+ * the given name. Returns false if the variable was not found, or if it is
+ * of another type.
+ *
+ * @param name The name of the variable.
+ * @param value The value to be set.
+ * @return True if found and set, otherwise false.
+ */
+KAPI b8 kvar_float_set(const char* name, f32 value);
+
+/**
+ * @brief Creates a boolean variable.
+ *
+ * @param name The name of the variable.
+ * @param value The value of the variable.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kvar_bool_create(const char* name, b8 value);
+
+/**
+ * @brief Attempts to obtain the value of the boolean variable with the
+ * given name. Returns false if not found, or if it is of another type.
+ *
+ * @param name The name of the variable.
+ * @param out_value A pointer to hold the variable.
+ * @return True if the variable was found; otherwise false.
+ */
+KAPI b8 kvar_bool_get(const char* name, b8* out_value);
+
+/**
+ * @brief Attempts to set the value of an existing boolean variable with
+ * the given name. Returns false if the variable was not found, or if it is
+ * of another type.
+ *
+ * @param name The name of the variable.
+ * @param value The value to be set.
+ * @return True if found and set, otherwise false.
+ */
+KAPI b8 kvar_bool_set(const char* name, b8 value);
+
+/**
+ * @brief Creates a string variable. The kvar keeps its own copy of the value.
+ *
+ * @param name The name of the variable.
+ * @param value The value of the variable. Required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kvar_string_create(const char* name, const char* value);
+
+/**
+ * @brief Attempts to obtain the value of the string variable with the
+ * given name. Returns false if not found, or if it is of another type.
+ *
+ * @param name The name of the variable.
+ * @param out_value A pointer to hold the value, which is owned by the kvar and
+ * remains valid until the value is next set.
+ * @return True if the variable was found; otherwise false.
+ */
+KAPI b8 kvar_string_get(const char* name, const char** out_value);
+
+/**
+ * @brief Attempts to set the value of an existing string variable with
+ * the given name. Returns false if the variable was not found, or if it is
+ * of another type.
+ *
+ * @param name The name of the variable.
+ * @param value The value to be set. Copied. Required.
+ * @return True if found and set, otherwise false.
+ */
+KAPI b8 kvar_string_set(const char* name, const char* value);
+
+/**
+ * @brief Obtains the handle of the variable with the given name.
+ *
+ * @param name The name of the variable.
+ * @return The handle of the variable, or INVALID_ID if it does not exist.
+ */
+KAPI kvar_handle kvar_handle_get(const char* name);
+
+/**
+ * @brief Obtains the type of the variable with the given handle.
+ *
+ * @param handle The handle of the variable.
+ * @param out_type A pointer to hold the type.
+ * @return True if the handle is valid; otherwise false.
+ */
+KAPI b8 kvar_type_get(kvar_handle handle, kvar_types* out_type);
+
+/**
+ * @brief Reads an integer variable through its handle.
+ *
+ * @param handle The handle of the variable.
+ * @param default_value Returned if the handle is invalid or the variable is of another type.
+ * @return The value of the variable.
+ */
+KAPI i32 kvar_int_value(kvar_handle handle, i32 default_value);
+
+/**
+ * @brief Reads a floating-point variable through its handle.
+ *
+ * @param handle The handle of the variable.
+ * @param default_value Returned if the handle is invalid or the variable is of another type.
+ * @return The value of the variable.
+ */
+KAPI f32 kvar_float_value(kvar_handle handle, f32 default_value);
+
+/**
+ * @brief Reads a boolean variable through its handle.
+ *
+ * @param handle The handle of the variable.
+ * @param default_value Returned if the handle is invalid or the variable is of another type.
+ * @return The value of the variable.
+ */
+KAPI b8 kvar_bool_value(kvar_handle handle, b8 default_value);
+
+/**
+ * @brief Reads a string variable through its handle.
+ *
+ * @param handle The handle of the variable.
+ * @return The value of the variable, valid until it is next set, or 0 if the handle
+ * is invalid or the variable is of another type.
+ */
+KAPI const char* kvar_string_value(kvar_handle handle);
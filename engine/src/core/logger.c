@@ -2,23 +2,124 @@
 #include "asserts.h"
 #include "platform/platform.h"
 #include "platform/filesystem.h"
+#include "core/katomic.h"
+#include "core/kcondvar.h"
+#include "core/kmutex.h"
 #include "core/kstring.h"
 #include "core/kmemory.h"
+#include "core/kthread.h"
 #include "console.h"
 
-// TODO: temporary
 #include <stdarg.h>
+#include <stdio.h>
+
+// The number of entries in the message queue. Must be a power of 2.
+#define LOG_QUEUE_CAPACITY 1024
+// The size of the message stored in each entry. Longer messages are allocated on their own.
+#define LOG_ENTRY_MESSAGE_SIZE 1024
+// The length of each of the level prefixes below.
+#define LOG_LEVEL_PREFIX_LENGTH 9
+// How long the logger thread sleeps at most when there is nothing to do.
+#define LOG_THREAD_WAIT_MS 50
+// The size of each thread's binary log buffer. Must be a power of 2.
+#define LOG_THREAD_BUFFER_SIZE KIBIBYTES(128)
+// The most threads which may have binary log buffers.
+#define LOG_MAX_THREAD_BUFFERS 64
+// The most binary log format strings which may be registered.
+#define LOG_BINARY_MAX_FORMATS 4096
+// The size of the largest possible arguments of a binary log message.
+#define LOG_BINARY_MAX_ARGS_SIZE (LOG_BINARY_MAX_ARGS * (sizeof(u32) + LOG_BINARY_MAX_STRING_LENGTH))
+
+static const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
+
+typedef struct log_queue_entry {
+    // Equal to the position the entry may next be written at, or one past the position
+    // once written and ready to be read.
+    volatile u64 sequence;
+    log_level level;
+    u32 length;
+    // Set instead of message for messages which don't fit in it. Freed once written.
+    char* long_message;
+    char message[LOG_ENTRY_MESSAGE_SIZE];
+} log_queue_entry;
+
+typedef enum log_binary_arg_type {
+    LOG_BINARY_ARG_TYPE_NONE,
+    LOG_BINARY_ARG_TYPE_I32,
+    LOG_BINARY_ARG_TYPE_I64,
+    LOG_BINARY_ARG_TYPE_F64,
+    LOG_BINARY_ARG_TYPE_POINTER,
+    LOG_BINARY_ARG_TYPE_STRING
+} log_binary_arg_type;
+
+// A single conversion specification of a format string, i.e. "%.*f".
+typedef struct log_binary_conversion {
+    // The number of '*' widths/precisions, each taking an int argument before the value.
+    u8 star_count;
+    // The type of the value, if it takes one.
+    log_binary_arg_type type;
+} log_binary_conversion;
+
+typedef struct log_binary_format {
+    const char* format;
+    log_level level;
+    u8 arg_count;
+    // The arguments of the format in order, parsed once when registered.
+    u8 arg_types[LOG_BINARY_MAX_ARGS];
+} log_binary_format;
+
+// A single-producer, single-consumer ring of binary log records. Written by its
+// thread, and read by the logger thread.
+typedef struct log_thread_buffer {
+    u8* data;
+    volatile u64 write_pos;
+    volatile u64 read_pos;
+    // The records which didn't fit since the logger thread last checked.
+    volatile u32 dropped_count;
+    u32 index;
+} log_thread_buffer;
 
 typedef struct logger_system_state {
     file_handle log_file_handle;
+    // The binary log, for decoding with the tools.
+    file_handle binary_log_file_handle;
+
+    // A bounded multi-producer, single-consumer queue. Any thread may push without locking,
+    // and only the logger thread pops.
+    log_queue_entry entries[LOG_QUEUE_CAPACITY];
+    volatile u64 enqueue_pos;
+    volatile u64 dequeue_pos;
+
+    kthread thread;
+    // Set once the logger thread is running. Until then, messages are written on the calling thread.
+    volatile u32 thread_running;
+    volatile u32 shutting_down;
+    // Set while the logger thread waits, so that producers only signal when needed.
+    volatile u32 thread_sleeping;
+    kmutex wake_mutex;
+    kcondvar wake_condvar;
+
+    // Guards registration of formats and thread buffers.
+    kmutex registry_mutex;
+    log_binary_format binary_formats[LOG_BINARY_MAX_FORMATS];
+    volatile u32 binary_format_count;
+    // The number of formats written to the binary log so far. Only used by the logger thread.
+    u32 binary_formats_written;
+    log_thread_buffer* thread_buffers[LOG_MAX_THREAD_BUFFERS];
+    volatile u32 thread_buffer_count;
+    // Indicates if binary messages are also formatted as text.
+    volatile u32 binary_text_enabled;
 } logger_system_state;
 
 static logger_system_state* state_ptr;
 
-static void append_to_log_file(const char* message) {
+static _Thread_local log_thread_buffer* thread_buffer = 0;
+
+static void log_output_v(log_level level, const char* message, __builtin_va_list args);
+
+static void append_to_log_file(const char* message, u64 length) {
     if (state_ptr && state_ptr->log_file_handle.is_valid) {
         // Since the message already contains a '\n', just write the bytes directly.
-        u64 length = string_length(message);
         u64 written = 0;
         if (!filesystem_write(&state_ptr->log_file_handle, length, message, &written)) {
             platform_console_write_error("ERROR writing to console.log.", LOG_LEVEL_ERROR);
@@ -26,13 +127,172 @@ static void append_to_log_file(const char* message) {
     }
 }
 
+static void write_message(log_level level, const char* message, u64 length) {
+    // Pass along to console consumers.
+    console_write_line(level, message);
+
+    // Print accordingly
+    if (level < LOG_LEVEL_WARN) {
+        platform_console_write_error(message, level);
+    } else {
+        platform_console_write(message, level);
+    }
+
+    append_to_log_file(message, length);
+}
+
+static void wake_logger_thread(void) {
+    if (katomic_load_u32(&state_ptr->thread_sleeping, KATOMIC_ORDER_SEQ_CST)) {
+        kmutex_lock(&state_ptr->wake_mutex);
+        kcondvar_signal(&state_ptr->wake_condvar);
+        kmutex_unlock(&state_ptr->wake_mutex);
+    }
+}
+
+// Writes out every entry in the queue. Must only be called from one thread at a time.
+static b8 drain_queue(void) {
+    b8 any = false;
+    for (;;) {
+        u64 pos = state_ptr->dequeue_pos;
+        log_queue_entry* entry = &state_ptr->entries[pos & (LOG_QUEUE_CAPACITY - 1)];
+        if (katomic_load_u64(&entry->sequence, KATOMIC_ORDER_ACQUIRE) != pos + 1) {
+            // Empty, or the next entry is still being written.
+            return any;
+        }
+
+        if (entry->long_message) {
+            write_message(entry->level, entry->long_message, entry->length);
+            kfree(entry->long_message, entry->length + 1, MEMORY_TAG_STRING);
+            entry->long_message = 0;
+        } else {
+            write_message(entry->level, entry->message, entry->length);
+        }
+
+        // Hand the entry back to the producers, one lap ahead.
+        katomic_store_u64(&entry->sequence, pos + LOG_QUEUE_CAPACITY, KATOMIC_ORDER_RELEASE);
+        katomic_store_u64(&state_ptr->dequeue_pos, pos + 1, KATOMIC_ORDER_RELEASE);
+        any = true;
+    }
+}
+
+// Returns the record size of binary arguments of the given size, keeping records 8-byte aligned.
+static u64 binary_record_size(u32 args_size) {
+    return (sizeof(log_binary_record_header) + args_size + 7) & ~7ULL;
+}
+
+static void binary_log_write(const void* data, u64 size) {
+    u64 written = 0;
+    if (!filesystem_write(&state_ptr->binary_log_file_handle, size, data, &written)) {
+        platform_console_write_error("ERROR writing to console.klog.", LOG_LEVEL_ERROR);
+    }
+}
+
+static void binary_message_write(const log_binary_record_header* header, const u8* args) {
+    const log_binary_format* format = &state_ptr->binary_formats[header->format_id];
+
+    if (state_ptr->binary_log_file_handle.is_valid) {
+        // Formats go into the file before the first message using them.
+        u32 format_count = katomic_load_u32(&state_ptr->binary_format_count, KATOMIC_ORDER_ACQUIRE);
+        while (state_ptr->binary_formats_written < format_count) {
+            const log_binary_format* f = &state_ptr->binary_formats[state_ptr->binary_formats_written];
+            log_binary_record_header format_header = {0};
+            format_header.type = LOG_BINARY_RECORD_TYPE_FORMAT;
+            format_header.level = f->level;
+            format_header.format_id = state_ptr->binary_formats_written;
+            format_header.size = string_length(f->format) + 1;
+            binary_log_write(&format_header, sizeof(log_binary_record_header));
+            binary_log_write(f->format, format_header.size);
+            state_ptr->binary_formats_written++;
+        }
+        binary_log_write(header, sizeof(log_binary_record_header));
+        binary_log_write(args, header->size);
+    }
+
+    if (katomic_load_u32(&state_ptr->binary_text_enabled, KATOMIC_ORDER_RELAXED)) {
+        char text[4096];
+        kcopy_memory(text, level_strings[format->level], LOG_LEVEL_PREFIX_LENGTH);
+        i32 written = log_binary_message_format(format->format, args, header->size, text + LOG_LEVEL_PREFIX_LENGTH, sizeof(text) - LOG_LEVEL_PREFIX_LENGTH - 1);
+        if (written < 0) {
+            written = string_format(text + LOG_LEVEL_PREFIX_LENGTH, "Malformed binary log message for format '%s'.", format->format);
+        }
+        u32 length = LOG_LEVEL_PREFIX_LENGTH + written;
+        text[length++] = '\n';
+        text[length] = 0;
+        write_message(format->level, text, length);
+    }
+}
+
+// Writes out every record in the thread buffers. Must only be called from one thread at a time.
+static b8 drain_thread_buffers(void) {
+    b8 any = false;
+    u32 buffer_count = katomic_load_u32(&state_ptr->thread_buffer_count, KATOMIC_ORDER_ACQUIRE);
+    for (u32 i = 0; i < buffer_count; ++i) {
+        log_thread_buffer* buffer = state_ptr->thread_buffers[i];
+
+        u32 dropped = katomic_exchange_u32(&buffer->dropped_count, 0, KATOMIC_ORDER_RELAXED);
+        if (dropped) {
+            char text[256];
+            u32 length = string_format(text, "%s%u binary log messages from thread %u were dropped, as its buffer was full.\n", level_strings[LOG_LEVEL_WARN], dropped, i);
+            write_message(LOG_LEVEL_WARN, text, length);
+        }
+
+        u64 write_pos = katomic_load_u64(&buffer->write_pos, KATOMIC_ORDER_ACQUIRE);
+        u64 read_pos = buffer->read_pos;
+        if (read_pos == write_pos) {
+            continue;
+        }
+        while (read_pos < write_pos) {
+            u64 offset = read_pos & (LOG_THREAD_BUFFER_SIZE - 1);
+            const log_binary_record_header* header = (const log_binary_record_header*)&buffer->data[offset];
+            if (header->type == LOG_BINARY_RECORD_TYPE_PAD) {
+                // The rest of the buffer was too small for the next record, which starts over at the beginning.
+                read_pos += LOG_THREAD_BUFFER_SIZE - offset;
+                continue;
+            }
+            binary_message_write(header, (const u8*)(header + 1));
+            read_pos += binary_record_size(header->size);
+        }
+        katomic_store_u64(&buffer->read_pos, read_pos, KATOMIC_ORDER_RELEASE);
+        any = true;
+    }
+    return any;
+}
+
+static u32 logger_thread_run(void* params) {
+    while (!katomic_load_u32(&state_ptr->shutting_down, KATOMIC_ORDER_ACQUIRE)) {
+        b8 any = drain_queue();
+        if (drain_thread_buffers() || any) {
+            continue;
+        }
+
+        // Check once more while holding the mutex, so that a push between the check and the
+        // wait still signals it.
+        kmutex_lock(&state_ptr->wake_mutex);
+        katomic_store_u32(&state_ptr->thread_sleeping, 1, KATOMIC_ORDER_SEQ_CST);
+        u64 pos = state_ptr->dequeue_pos;
+        log_queue_entry* entry = &state_ptr->entries[pos & (LOG_QUEUE_CAPACITY - 1)];
+        if (katomic_load_u64(&entry->sequence, KATOMIC_ORDER_SEQ_CST) != pos + 1 && !katomic_load_u32(&state_ptr->shutting_down, KATOMIC_ORDER_ACQUIRE)) {
+            kcondvar_wait_timeout(&state_ptr->wake_condvar, &state_ptr->wake_mutex, LOG_THREAD_WAIT_MS);
+        }
+        katomic_store_u32(&state_ptr->thread_sleeping, 0, KATOMIC_ORDER_SEQ_CST);
+        kmutex_unlock(&state_ptr->wake_mutex);
+    }
+    return 0;
+}
+
 b8 logging_initialize(u64* memory_requirement, void* state, void* config) {
     *memory_requirement = sizeof(logger_system_state);
     if (state == 0) {
         return true;
     }
 
+    kzero_memory(state, sizeof(logger_system_state));
     state_ptr = state;
+    state_ptr->binary_text_enabled = 1;
+
+    for (u64 i = 0; i < LOG_QUEUE_CAPACITY; ++i) {
+        state_ptr->entries[i].sequence = i;
+    }
 
     // Create new/wipe existing log file, then open it.
     if (!filesystem_open("console.log", FILE_MODE_WRITE, false, &state_ptr->log_file_handle)) {
@@ -40,50 +300,532 @@ b8 logging_initialize(u64* memory_requirement, void* state, void* config) {
         return false;
     }
 
+    if (filesystem_open("console.klog", FILE_MODE_WRITE, true, &state_ptr->binary_log_file_handle)) {
+        log_binary_file_header header = {LOG_BINARY_FILE_MAGIC, LOG_BINARY_FILE_VERSION};
+        binary_log_write(&header, sizeof(log_binary_file_header));
+    } else {
+        platform_console_write_error("ERROR: Unable to open console.klog for writing. Binary log messages will only be written as text.", LOG_LEVEL_ERROR);
+    }
+
+    if (!kmutex_create(&state_ptr->wake_mutex) || !kcondvar_create(&state_ptr->wake_condvar) || !kmutex_create(&state_ptr->registry_mutex)) {
+        platform_console_write_error("ERROR: Unable to create logger synchronization objects.", LOG_LEVEL_ERROR);
+        return false;
+    }
+    kmutex_name_set(&state_ptr->wake_mutex, "logger wake");
+    kmutex_name_set(&state_ptr->registry_mutex, "logger registry");
+
+    // Formatting and output are moved off the calling thread from here on.
+    if (!kthread_create(logger_thread_run, 0, false, &state_ptr->thread)) {
+        KWARN("Failed to create logger thread. Messages will be written on the calling thread.");
+        return true;
+    }
+    katomic_store_u32(&state_ptr->thread_running, 1, KATOMIC_ORDER_RELEASE);
+
     return true;
 }
 
 void logging_shutdown(void* state) {
-    // TODO: cleanup logging/write queued entries.
+    if (!state_ptr) {
+        return;
+    }
+
+    if (katomic_load_u32(&state_ptr->thread_running, KATOMIC_ORDER_ACQUIRE)) {
+        katomic_store_u32(&state_ptr->shutting_down, 1, KATOMIC_ORDER_RELEASE);
+        kmutex_lock(&state_ptr->wake_mutex);
+        kcondvar_signal(&state_ptr->wake_condvar);
+        kmutex_unlock(&state_ptr->wake_mutex);
+        kthread_wait(&state_ptr->thread);
+        kthread_destroy(&state_ptr->thread);
+        katomic_store_u32(&state_ptr->thread_running, 0, KATOMIC_ORDER_RELEASE);
+    }
+
+    // Write whatever was still queued.
+    drain_queue();
+    drain_thread_buffers();
+
+    for (u32 i = 0; i < state_ptr->thread_buffer_count; ++i) {
+        kfree(state_ptr->thread_buffers[i]->data, LOG_THREAD_BUFFER_SIZE, MEMORY_TAG_ENGINE);
+        kfree(state_ptr->thread_buffers[i], sizeof(log_thread_buffer), MEMORY_TAG_ENGINE);
+    }
+    // NOTE: Only clears the buffer of this thread. Others are expected to have stopped logging by now.
+    thread_buffer = 0;
+
+    kmutex_destroy(&state_ptr->registry_mutex);
+    kcondvar_destroy(&state_ptr->wake_condvar);
+    kmutex_destroy(&state_ptr->wake_mutex);
+    if (state_ptr->binary_log_file_handle.is_valid) {
+        filesystem_close(&state_ptr->binary_log_file_handle);
+    }
+    filesystem_close(&state_ptr->log_file_handle);
     state_ptr = 0;
 }
 
+void logging_flush(void) {
+    if (!state_ptr || !katomic_load_u32(&state_ptr->thread_running, KATOMIC_ORDER_ACQUIRE)) {
+        return;
+    }
+    // The logger thread can't wait on itself.
+    if (platform_current_thread_id() == state_ptr->thread.thread_id) {
+        return;
+    }
+
+    u64 target = katomic_load_u64(&state_ptr->enqueue_pos, KATOMIC_ORDER_ACQUIRE);
+    while (katomic_load_u64(&state_ptr->dequeue_pos, KATOMIC_ORDER_ACQUIRE) < target) {
+        wake_logger_thread();
+        platform_sleep(1);
+    }
+
+    u32 buffer_count = katomic_load_u32(&state_ptr->thread_buffer_count, KATOMIC_ORDER_ACQUIRE);
+    for (u32 i = 0; i < buffer_count; ++i) {
+        log_thread_buffer* buffer = state_ptr->thread_buffers[i];
+        u64 buffer_target = katomic_load_u64(&buffer->write_pos, KATOMIC_ORDER_ACQUIRE);
+        while (katomic_load_u64(&buffer->read_pos, KATOMIC_ORDER_ACQUIRE) < buffer_target) {
+            wake_logger_thread();
+            platform_sleep(1);
+        }
+    }
+}
+
 void log_output(log_level level, const char* message, ...) {
-    // TODO: These string operations are all pretty slow. This needs to be
-    // moved to another thread eventually, along with the file writes, to
-    // avoid slowing things down while the engine is trying to run.
-    const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
-    b8 is_error = level < LOG_LEVEL_WARN;
-
-    // Technically imposes a 32k character limit on a single log entry, but...
-    // DON'T DO THAT!
-    char out_message[32000];
-    kzero_memory(out_message, sizeof(out_message));
-
-    // Format original message.
     // NOTE: Oddly enough, MS's headers override the GCC/Clang va_list type with a "typedef char* va_list" in some
     // cases, and as a result throws a strange error here. The workaround for now is to just use __builtin_va_list,
     // which is the type GCC/Clang's va_start expects.
     __builtin_va_list arg_ptr;
     va_start(arg_ptr, message);
-    string_format_v(out_message, message, arg_ptr);
+    log_output_v(level, message, arg_ptr);
     va_end(arg_ptr);
+}
 
-    // Prepend log level to message.
-    string_format(out_message, "%s%s\n", level_strings[level], out_message);
+static void log_output_v(log_level level, const char* message, __builtin_va_list args) {
+    __builtin_va_list arg_ptr;
 
-    // Pass along to console consumers.
-    console_write_line(level, out_message);
+    // Before the logger thread starts, and on the logger thread itself (i.e. from a console
+    // consumer), the message is written straight away.
+    if (!state_ptr || !katomic_load_u32(&state_ptr->thread_running, KATOMIC_ORDER_ACQUIRE) || platform_current_thread_id() == state_ptr->thread.thread_id) {
+        // Technically imposes a 32k character limit on a single log entry, but...
+        // DON'T DO THAT!
+        char out_message[32000];
+        kcopy_memory(out_message, level_strings[level], LOG_LEVEL_PREFIX_LENGTH);
+        i32 written = vsnprintf(out_message + LOG_LEVEL_PREFIX_LENGTH, sizeof(out_message) - LOG_LEVEL_PREFIX_LENGTH - 1, message, args);
+        u32 length = LOG_LEVEL_PREFIX_LENGTH + KCLAMP(written, 0, (i32)(sizeof(out_message) - LOG_LEVEL_PREFIX_LENGTH - 2));
+        out_message[length++] = '\n';
+        out_message[length] = 0;
+        write_message(level, out_message, length);
+        return;
+    }
 
-    // Print accordingly
-    if (is_error) {
-        platform_console_write_error(out_message, level);
+    // Claim the next entry in the queue.
+    log_queue_entry* entry = 0;
+    u64 pos = katomic_load_u64(&state_ptr->enqueue_pos, KATOMIC_ORDER_RELAXED);
+    for (;;) {
+        entry = &state_ptr->entries[pos & (LOG_QUEUE_CAPACITY - 1)];
+        i64 diff = (i64)katomic_load_u64(&entry->sequence, KATOMIC_ORDER_ACQUIRE) - (i64)pos;
+        if (diff == 0) {
+            if (katomic_compare_exchange_u64(&state_ptr->enqueue_pos, &pos, pos + 1, KATOMIC_ORDER_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full, so wait for the logger thread to catch up.
+            wake_logger_thread();
+            platform_sleep(0);
+            pos = katomic_load_u64(&state_ptr->enqueue_pos, KATOMIC_ORDER_RELAXED);
+        } else {
+            // Another thread claimed it first.
+            pos = katomic_load_u64(&state_ptr->enqueue_pos, KATOMIC_ORDER_RELAXED);
+        }
+    }
+
+    // Format the message into the entry, leaving room for the newline. Arguments may not outlive
+    // this call, so this can't be deferred to the logger thread.
+    entry->level = level;
+    entry->long_message = 0;
+    kcopy_memory(entry->message, level_strings[level], LOG_LEVEL_PREFIX_LENGTH);
+    // The arguments may be needed again below, so are copied first.
+    va_copy(arg_ptr, args);
+    i32 written = vsnprintf(entry->message + LOG_LEVEL_PREFIX_LENGTH, LOG_ENTRY_MESSAGE_SIZE - LOG_LEVEL_PREFIX_LENGTH - 1, message, arg_ptr);
+    va_end(arg_ptr);
+    if (written < 0) {
+        written = 0;
+    }
+    u32 length = LOG_LEVEL_PREFIX_LENGTH + (u32)written + 1;
+    char* out_message = entry->message;
+    if (length + 1 > LOG_ENTRY_MESSAGE_SIZE) {
+        // Too long for the entry, so format it again into its own allocation.
+        out_message = kallocate(length + 1, MEMORY_TAG_STRING);
+        kcopy_memory(out_message, level_strings[level], LOG_LEVEL_PREFIX_LENGTH);
+        vsnprintf(out_message + LOG_LEVEL_PREFIX_LENGTH, written + 1, message, args);
+        entry->long_message = out_message;
+    }
+    out_message[length - 1] = '\n';
+    out_message[length] = 0;
+    entry->length = length;
+
+    // Publish the entry.
+    katomic_store_u64(&entry->sequence, pos + 1, KATOMIC_ORDER_SEQ_CST);
+    wake_logger_thread();
+
+    // Make sure fatal messages are out before the application goes down.
+    if (level == LOG_LEVEL_FATAL) {
+        logging_flush();
+    }
+}
+
+// Parses the conversion specification starting at the given '%', returning the character after it.
+static const char* conversion_parse(const char* c, log_binary_conversion* out_conversion) {
+    out_conversion->star_count = 0;
+    out_conversion->type = LOG_BINARY_ARG_TYPE_NONE;
+    c++;
+    if (*c == '%') {
+        return c + 1;
+    }
+
+    // Flags, width and precision.
+    while (*c == '-' || *c == '+' || *c == ' ' || *c == '#' || *c == '0') {
+        c++;
+    }
+    if (*c == '*') {
+        out_conversion->star_count++;
+        c++;
+    }
+    while (*c >= '0' && *c <= '9') {
+        c++;
+    }
+    if (*c == '.') {
+        c++;
+        if (*c == '*') {
+            out_conversion->star_count++;
+            c++;
+        }
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+    }
+
+    // Length modifiers.
+    u8 long_count = 0;
+    b8 size_length = false;
+    while (*c == 'h' || *c == 'l' || *c == 'z' || *c == 'j' || *c == 't') {
+        if (*c == 'l') {
+            long_count++;
+        } else if (*c != 'h') {
+            size_length = true;
+        }
+        c++;
+    }
+
+    switch (*c) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            // NOTE: long is only 64-bit on some platforms.
+            if (long_count >= 2 || size_length || (long_count == 1 && sizeof(long) == sizeof(i64))) {
+                out_conversion->type = LOG_BINARY_ARG_TYPE_I64;
+            } else {
+                out_conversion->type = LOG_BINARY_ARG_TYPE_I32;
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            out_conversion->type = LOG_BINARY_ARG_TYPE_F64;
+            break;
+        case 's':
+            out_conversion->type = LOG_BINARY_ARG_TYPE_STRING;
+            break;
+        case 'p':
+            out_conversion->type = LOG_BINARY_ARG_TYPE_POINTER;
+            break;
+        case 0:
+            // Cut off at the end of the string.
+            return c;
+        default:
+            break;
+    }
+    return c + 1;
+}
+
+static u32 binary_format_register(log_level level, const char* format) {
+    log_binary_format parsed = {0};
+    parsed.format = format;
+    parsed.level = level;
+    for (const char* c = format; *c;) {
+        if (*c != '%') {
+            c++;
+            continue;
+        }
+        log_binary_conversion conversion;
+        c = conversion_parse(c, &conversion);
+        u8 count = conversion.star_count + (conversion.type != LOG_BINARY_ARG_TYPE_NONE ? 1 : 0);
+        if (parsed.arg_count + count > LOG_BINARY_MAX_ARGS) {
+            return INVALID_ID;
+        }
+        for (u8 i = 0; i < conversion.star_count; ++i) {
+            parsed.arg_types[parsed.arg_count++] = LOG_BINARY_ARG_TYPE_I32;
+        }
+        if (conversion.type != LOG_BINARY_ARG_TYPE_NONE) {
+            parsed.arg_types[parsed.arg_count++] = conversion.type;
+        }
+    }
+
+    kmutex_lock(&state_ptr->registry_mutex);
+    u32 id = state_ptr->binary_format_count;
+    if (id < LOG_BINARY_MAX_FORMATS) {
+        state_ptr->binary_formats[id] = parsed;
+        katomic_store_u32(&state_ptr->binary_format_count, id + 1, KATOMIC_ORDER_RELEASE);
     } else {
-        platform_console_write(out_message, level);
+        id = INVALID_ID;
+    }
+    kmutex_unlock(&state_ptr->registry_mutex);
+    return id;
+}
+
+static log_thread_buffer* thread_buffer_get(void) {
+    if (thread_buffer) {
+        return thread_buffer;
+    }
+
+    kmutex_lock(&state_ptr->registry_mutex);
+    u32 index = state_ptr->thread_buffer_count;
+    if (index < LOG_MAX_THREAD_BUFFERS) {
+        log_thread_buffer* buffer = kallocate(sizeof(log_thread_buffer), MEMORY_TAG_ENGINE);
+        buffer->data = kallocate(LOG_THREAD_BUFFER_SIZE, MEMORY_TAG_ENGINE);
+        buffer->index = index;
+        state_ptr->thread_buffers[index] = buffer;
+        katomic_store_u32(&state_ptr->thread_buffer_count, index + 1, KATOMIC_ORDER_RELEASE);
+        thread_buffer = buffer;
+    }
+    kmutex_unlock(&state_ptr->registry_mutex);
+    return thread_buffer;
+}
+
+static void thread_buffer_write(log_thread_buffer* buffer, u32 format_id, log_level level, const u8* args, u32 args_size) {
+    u64 record_size = binary_record_size(args_size);
+    u64 write_pos = buffer->write_pos;
+    u64 read_pos = katomic_load_u64(&buffer->read_pos, KATOMIC_ORDER_ACQUIRE);
+    u64 offset = write_pos & (LOG_THREAD_BUFFER_SIZE - 1);
+    // Records are never split, so one which doesn't fit before the end starts over at the beginning.
+    u64 pad = offset + record_size > LOG_THREAD_BUFFER_SIZE ? LOG_THREAD_BUFFER_SIZE - offset : 0;
+    u64 used = write_pos + pad + record_size - read_pos;
+    if (used > LOG_THREAD_BUFFER_SIZE) {
+        // Never wait on the logger thread, just count what was lost.
+        katomic_fetch_add_u32(&buffer->dropped_count, 1, KATOMIC_ORDER_RELAXED);
+        wake_logger_thread();
+        return;
+    }
+
+    if (pad) {
+        buffer->data[offset] = LOG_BINARY_RECORD_TYPE_PAD;
+        offset = 0;
+    }
+    log_binary_record_header* header = (log_binary_record_header*)&buffer->data[offset];
+    header->type = LOG_BINARY_RECORD_TYPE_MESSAGE;
+    header->level = level;
+    header->reserved = 0;
+    header->format_id = format_id;
+    header->size = args_size;
+    header->thread_index = buffer->index;
+    kcopy_memory(header + 1, args, args_size);
+    katomic_store_u64(&buffer->write_pos, write_pos + pad + record_size, KATOMIC_ORDER_RELEASE);
+
+    // Otherwise, leave the logger thread to pick this up when it next wakes.
+    if (used > LOG_THREAD_BUFFER_SIZE / 2) {
+        wake_logger_thread();
+    }
+}
+
+void log_binary_output(u32* format_id, log_level level, const char* format, ...) {
+    __builtin_va_list arg_ptr;
+    va_start(arg_ptr, format);
+
+    // Without the logger thread, there is nothing to defer the formatting to.
+    if (!state_ptr || !katomic_load_u32(&state_ptr->thread_running, KATOMIC_ORDER_ACQUIRE)) {
+        log_output_v(level, format, arg_ptr);
+        va_end(arg_ptr);
+        return;
+    }
+
+    u32 id = katomic_load_u32(format_id, KATOMIC_ORDER_ACQUIRE);
+    if (id == INVALID_ID) {
+        // NOTE: Two threads may both register the same call site the first time. That's harmless.
+        id = binary_format_register(level, format);
+        katomic_store_u32(format_id, id, KATOMIC_ORDER_RELEASE);
+    }
+    log_thread_buffer* buffer = id != INVALID_ID ? thread_buffer_get() : 0;
+    if (!buffer) {
+        // Too many arguments, formats or threads.
+        log_output_v(level, format, arg_ptr);
+        va_end(arg_ptr);
+        return;
+    }
+
+    // Copy the raw arguments as the format describes them.
+    const log_binary_format* f = &state_ptr->binary_formats[id];
+    u8 args[LOG_BINARY_MAX_ARGS_SIZE];
+    u32 args_size = 0;
+    for (u8 i = 0; i < f->arg_count; ++i) {
+        switch (f->arg_types[i]) {
+            case LOG_BINARY_ARG_TYPE_I32: {
+                i32 value = va_arg(arg_ptr, i32);
+                kcopy_memory(&args[args_size], &value, sizeof(i32));
+                args_size += sizeof(i32);
+            } break;
+            case LOG_BINARY_ARG_TYPE_I64: {
+                i64 value = va_arg(arg_ptr, i64);
+                kcopy_memory(&args[args_size], &value, sizeof(i64));
+                args_size += sizeof(i64);
+            } break;
+            case LOG_BINARY_ARG_TYPE_F64: {
+                f64 value = va_arg(arg_ptr, f64);
+                kcopy_memory(&args[args_size], &value, sizeof(f64));
+                args_size += sizeof(f64);
+            } break;
+            case LOG_BINARY_ARG_TYPE_POINTER: {
+                u64 value = (u64)va_arg(arg_ptr, void*);
+                kcopy_memory(&args[args_size], &value, sizeof(u64));
+                args_size += sizeof(u64);
+            } break;
+            case LOG_BINARY_ARG_TYPE_STRING: {
+                // Strings may not outlive the call, so the characters themselves are copied.
+                const char* value = va_arg(arg_ptr, const char*);
+                if (!value) {
+                    value = "(null)";
+                }
+                u32 length = 0;
+                while (length < LOG_BINARY_MAX_STRING_LENGTH && value[length]) {
+                    length++;
+                }
+                kcopy_memory(&args[args_size], &length, sizeof(u32));
+                kcopy_memory(&args[args_size + sizeof(u32)], value, length);
+                args_size += sizeof(u32) + length;
+            } break;
+        }
+    }
+    va_end(arg_ptr);
+
+    thread_buffer_write(buffer, id, level, args, args_size);
+}
+
+void logging_binary_text_set(b8 enabled) {
+    if (state_ptr) {
+        katomic_store_u32(&state_ptr->binary_text_enabled, enabled ? 1 : 0, KATOMIC_ORDER_RELAXED);
+    }
+}
+
+i32 log_binary_message_format(const char* format, const u8* args, u32 args_size, char* out_text, u32 out_size) {
+    if (!out_size) {
+        return -1;
+    }
+
+    u32 length = 0;
+    u32 read = 0;
+    for (const char* c = format; *c;) {
+        if (*c != '%') {
+            if (length + 1 < out_size) {
+                out_text[length++] = *c;
+            }
+            c++;
+            continue;
+        }
+
+        const char* start = c;
+        log_binary_conversion conversion;
+        c = conversion_parse(c, &conversion);
+
+        // Rebuild the specification with the values of any '*' written in, so it takes one argument.
+        char spec[64];
+        u32 spec_length = 0;
+        for (const char* s = start; s < c && spec_length < sizeof(spec) - 16; ++s) {
+            if (*s == '*') {
+                i32 value;
+                if (read + sizeof(i32) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&value, &args[read], sizeof(i32));
+                read += sizeof(i32);
+                spec_length += snprintf(&spec[spec_length], sizeof(spec) - spec_length, "%d", value);
+            } else {
+                spec[spec_length++] = *s;
+            }
+        }
+        spec[spec_length] = 0;
+
+        char* out = &out_text[length];
+        u32 remaining = out_size - length;
+        i32 written = 0;
+        switch (conversion.type) {
+            case LOG_BINARY_ARG_TYPE_NONE:
+                // Either "%%", or a conversion which isn't supported and is shown as is.
+                written = snprintf(out, remaining, "%s", strings_equal(spec, "%%") ? "%" : spec);
+                break;
+            case LOG_BINARY_ARG_TYPE_I32: {
+                i32 value;
+                if (read + sizeof(i32) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&value, &args[read], sizeof(i32));
+                read += sizeof(i32);
+                written = snprintf(out, remaining, spec, value);
+            } break;
+            case LOG_BINARY_ARG_TYPE_I64: {
+                i64 value;
+                if (read + sizeof(i64) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&value, &args[read], sizeof(i64));
+                read += sizeof(i64);
+                written = snprintf(out, remaining, spec, value);
+            } break;
+            case LOG_BINARY_ARG_TYPE_F64: {
+                f64 value;
+                if (read + sizeof(f64) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&value, &args[read], sizeof(f64));
+                read += sizeof(f64);
+                written = snprintf(out, remaining, spec, value);
+            } break;
+            case LOG_BINARY_ARG_TYPE_POINTER: {
+                u64 value;
+                if (read + sizeof(u64) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&value, &args[read], sizeof(u64));
+                read += sizeof(u64);
+                written = snprintf(out, remaining, spec, (void*)value);
+            } break;
+            case LOG_BINARY_ARG_TYPE_STRING: {
+                u32 string_length;
+                if (read + sizeof(u32) > args_size) {
+                    return -1;
+                }
+                kcopy_memory(&string_length, &args[read], sizeof(u32));
+                read += sizeof(u32);
+                if (string_length > LOG_BINARY_MAX_STRING_LENGTH || read + string_length > args_size) {
+                    return -1;
+                }
+                char value[LOG_BINARY_MAX_STRING_LENGTH + 1];
+                kcopy_memory(value, &args[read], string_length);
+                value[string_length] = 0;
+                read += string_length;
+                written = snprintf(out, remaining, spec, value);
+            } break;
+        }
+        if (written > 0) {
+            length = KMIN(length + written, out_size - 1);
+        }
     }
 
-    // Queue a copy to be written to the log file.
-    append_to_log_file(out_message);
+    out_text[length] = 0;
+    return length;
 }
 
 void report_assertion_failure(const char* expression, const char* message, const char* file, i32 line) {
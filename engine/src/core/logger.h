@@ -62,6 +62,12 @@ b8 logging_initialize(u64* memory_requirement, void* state, void* config);
  */
 void logging_shutdown(void* state);
 
+/**
+ * @brief Blocks until every message logged so far has been written out by the logger thread.
+ * Called automatically for fatal messages. Does nothing on the logger thread itself.
+ */
+KAPI void logging_flush(void);
+
 /**
  * @brief Outputs logging at the given level.
  * @param level The log level to use.
@@ -155,3 +161,107 @@ KAPI void log_output(log_level level, const char* message, ...);
  */
 #define KTRACE(message, ...)
 #endif
+
+/** @brief The magic number at the start of a binary log file ("KLOG"). */
+#define LOG_BINARY_FILE_MAGIC 0x474F4C4B
+/** @brief The version of the binary log file format. */
+#define LOG_BINARY_FILE_VERSION 1
+/** @brief The most arguments a single binary log message may have. */
+#define LOG_BINARY_MAX_ARGS 16
+/** @brief The longest string argument stored in a binary log message. Longer strings are truncated. */
+#define LOG_BINARY_MAX_STRING_LENGTH 256
+
+/** @brief The header at the start of a binary log file. */
+typedef struct log_binary_file_header {
+    /** @brief Always LOG_BINARY_FILE_MAGIC. */
+    u32 magic;
+    /** @brief Always LOG_BINARY_FILE_VERSION. */
+    u32 version;
+} log_binary_file_header;
+
+/** @brief The types of record in a binary log. */
+typedef enum log_binary_record_type {
+    /** @brief Skipped when read. Used to fill the end of a thread's buffer. */
+    LOG_BINARY_RECORD_TYPE_PAD = 0,
+    /** @brief Registers a format string. Followed by the null-terminated string. */
+    LOG_BINARY_RECORD_TYPE_FORMAT = 1,
+    /** @brief A message. Followed by the raw arguments of its format string. */
+    LOG_BINARY_RECORD_TYPE_MESSAGE = 2
+} log_binary_record_type;
+
+/**
+ * @brief The header of each record in a binary log. Message arguments are stored in order: 4
+ * bytes for int-sized values, 8 bytes for 64-bit integers, doubles and pointers, and a u32 length
+ * followed by the characters (without a terminator) for strings.
+ */
+typedef struct log_binary_record_header {
+    /** @brief A log_binary_record_type. */
+    u8 type;
+    /** @brief The log_level of the format. */
+    u8 level;
+    u16 reserved;
+    /** @brief The id of the format string. */
+    u32 format_id;
+    /** @brief The size of the data following the header in bytes. */
+    u32 size;
+    /** @brief The index of the thread which logged the message. */
+    u32 thread_index;
+} log_binary_record_header;
+
+/**
+ * @brief Queues a message in the binary log. Only the format's id and the raw arguments are
+ * stored, into a buffer owned by the calling thread. Formatting, if any, is done later on the
+ * logger thread, or offline by decoding console.klog with the tools. Use the KLOG_BINARY macros
+ * rather than calling this directly.
+ * @param format_id A pointer to the id of the format, registered on first use. Should be static to the call site.
+ * @param level The log level to use.
+ * @param format The format string. Must outlive the logging system, as string literals do. %n and long doubles are not supported.
+ * @param ... The arguments of the format string.
+ */
+KAPI void log_binary_output(u32* format_id, log_level level, const char* format, ...);
+
+/**
+ * @brief Sets whether the logger thread also formats binary log messages as text, writing them
+ * to the console and console.log like any other. They are always written to console.klog.
+ * Enabled by default. Disabling it leaves only the cost of copying the arguments.
+ * @param enabled Indicates if binary log messages should be formatted as text.
+ */
+KAPI void logging_binary_text_set(b8 enabled);
+
+/**
+ * @brief Formats the raw arguments of a binary log message with its format string.
+ * @param format The format string of the message.
+ * @param args The raw arguments of the message.
+ * @param args_size The size of args in bytes.
+ * @param out_text The buffer to hold the formatted text. Always null-terminated.
+ * @param out_size The size of out_text in bytes.
+ * @return The length of the formatted text, or -1 if the arguments don't match the format.
+ */
+KAPI i32 log_binary_message_format(const char* format, const u8* args, u32 args_size, char* out_text, u32 out_size);
+
+/**
+ * @brief Logs a message at the given level to the binary log. Unlike the other logging
+ * macros, this is never compiled out, so may be left in hot paths of release builds.
+ * @param level The log level to use.
+ * @param message The message to be logged. Must be a string literal.
+ * @param ... Any formatted data that should be included in the log entry.
+ */
+#define KLOG_BINARY(level, message, ...)                                          \
+    do {                                                                          \
+        static u32 klog_binary_format_id = INVALID_ID;                            \
+        log_binary_output(&klog_binary_format_id, level, message, ##__VA_ARGS__); \
+    } while (0)
+
+/**
+ * @brief Logs a trace-level message to the binary log. Never compiled out.
+ * @param message The message to be logged. Must be a string literal.
+ * @param ... Any formatted data that should be included in the log entry.
+ */
+#define KTRACE_BINARY(message, ...) KLOG_BINARY(LOG_LEVEL_TRACE, message, ##__VA_ARGS__)
+
+/**
+ * @brief Logs a debug-level message to the binary log. Never compiled out.
+ * @param message The message to be logged. Must be a string literal.
+ * @param ... Any formatted data that should be included in the log entry.
+ */
+#define KDEBUG_BINARY(message, ...) KLOG_BINARY(LOG_LEVEL_DEBUG, message, ##__VA_ARGS__)
@@ -1,8 +1,42 @@
 #include "metrics.h"
+#include "core/console.h"
 #include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "platform/filesystem.h"
 
 #define AVG_COUNT 30
 
+// Frame time histograms are log-linear, like an HDR histogram: times below
+// HISTOGRAM_SUB_BUCKET_COUNT microseconds get a bucket each, and every doubling above that is
+// split into HISTOGRAM_SUB_BUCKET_COUNT / 2 buckets, keeping the error within 1 / 32.
+#define HISTOGRAM_SUB_BUCKET_BITS 6
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_COUNT (HISTOGRAM_SUB_BUCKET_COUNT / 2)
+// Times are clamped below 2^24 microseconds (~16.7 seconds).
+#define HISTOGRAM_MAX_BITS 24
+#define HISTOGRAM_BUCKET_COUNT (HISTOGRAM_SUB_BUCKET_COUNT + (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_COUNT)
+#define HISTOGRAM_MAX_US ((1u << HISTOGRAM_MAX_BITS) - 1)
+
+// Marks a timer as not recorded in a frame.
+#define TIMER_NOT_RECORDED -1.0f
+
+typedef struct metrics_timer_history {
+    // The bucket counts of the samples in the history.
+    u32 buckets[HISTOGRAM_BUCKET_COUNT];
+    u32 sample_count;
+    u32 over_budget_count;
+    u64 over_budget_total;
+} metrics_timer_history;
+
+static const char* timer_names[METRICS_TIMER_COUNT] = {
+    "frame",
+    "update",
+    "render_prepare",
+    "render",
+    "gpu_wait",
+    "present"};
+
 typedef struct metrics_state {
     u8 frame_avg_counter;
     f64 ms_times[AVG_COUNT];
@@ -10,6 +44,28 @@ typedef struct metrics_state {
     i32 frames;
     f64 accumulated_frame_ms;
     f64 fps;
+    metrics_gpu_memory gpu_memory;
+    u32 gpu_heap_count;
+    metrics_gpu_heap gpu_heaps[METRICS_MAX_GPU_HEAPS];
+    u8 latency_avg_counter;
+    f64 latency_ms_times[AVG_COUNT];
+    f64 latency_ms_avg;
+    u32 frames_queued;
+    u32 gpu_pass_count;
+    metrics_gpu_pass gpu_passes[METRICS_MAX_GPU_PASSES];
+    f64 gpu_frame_ms;
+
+    f64 frame_budget_ms;
+    // The timers of the frame in progress, in milliseconds.
+    f32 current_timers[METRICS_TIMER_COUNT];
+    // The timers of the last METRICS_HISTORY_FRAMES frames in milliseconds, as a ring of rows.
+    f32 history[METRICS_HISTORY_FRAMES][METRICS_TIMER_COUNT];
+    // The row the next frame is written to.
+    u32 history_head;
+    u32 history_count;
+    // The number of frames stored since startup.
+    u64 frame_number;
+    metrics_timer_history timer_histories[METRICS_TIMER_COUNT];
 } metrics_state;
 
 static metrics_state* state_ptr = 0;
@@ -17,7 +73,74 @@ static metrics_state* state_ptr = 0;
 void metrics_initialize(void) {
     if (!state_ptr) {
         state_ptr = kallocate(sizeof(metrics_state), MEMORY_TAG_ENGINE);
+        state_ptr->frame_budget_ms = 1000.0 / 60.0;
+        for (u32 i = 0; i < METRICS_TIMER_COUNT; ++i) {
+            state_ptr->current_timers[i] = TIMER_NOT_RECORDED;
+        }
+    }
+}
+
+static u32 histogram_bucket_index(f32 ms) {
+    f64 us_f = ms * 1000.0;
+    u32 us = us_f >= HISTOGRAM_MAX_US ? HISTOGRAM_MAX_US : (u32)us_f;
+    if (us < HISTOGRAM_SUB_BUCKET_COUNT) {
+        return us;
+    }
+
+    u32 msb = HISTOGRAM_SUB_BUCKET_BITS;
+    while ((us >> (msb + 1)) != 0) {
+        msb++;
+    }
+    u32 shift = msb - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    return HISTOGRAM_SUB_BUCKET_COUNT + (msb - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_COUNT + ((us >> shift) - HISTOGRAM_HALF_COUNT);
+}
+
+// The highest time in milliseconds which falls in the given bucket.
+static f64 histogram_bucket_value(u32 index) {
+    if (index < HISTOGRAM_SUB_BUCKET_COUNT) {
+        return index / 1000.0;
+    }
+
+    u32 magnitude = (index - HISTOGRAM_SUB_BUCKET_COUNT) / HISTOGRAM_HALF_COUNT;
+    u32 sub_bucket = (index - HISTOGRAM_SUB_BUCKET_COUNT) % HISTOGRAM_HALF_COUNT + HISTOGRAM_HALF_COUNT;
+    u32 shift = magnitude + 1;
+    u32 upper = ((sub_bucket + 1) << shift) - 1;
+    return upper / 1000.0;
+}
+
+// Moves the timers of the frame in progress into the history, evicting the oldest frame if full.
+static void history_commit(f64 frame_ms) {
+    state_ptr->current_timers[METRICS_TIMER_FRAME] = (f32)frame_ms;
+    f32* row = state_ptr->history[state_ptr->history_head];
+
+    for (u32 i = 0; i < METRICS_TIMER_COUNT; ++i) {
+        metrics_timer_history* timer = &state_ptr->timer_histories[i];
+        if (state_ptr->history_count == METRICS_HISTORY_FRAMES && row[i] != TIMER_NOT_RECORDED) {
+            timer->buckets[histogram_bucket_index(row[i])]--;
+            timer->sample_count--;
+            if (i == METRICS_TIMER_FRAME && row[i] > state_ptr->frame_budget_ms) {
+                timer->over_budget_count--;
+            }
+        }
+
+        f32 value = state_ptr->current_timers[i];
+        row[i] = value;
+        state_ptr->current_timers[i] = TIMER_NOT_RECORDED;
+        if (value != TIMER_NOT_RECORDED) {
+            timer->buckets[histogram_bucket_index(value)]++;
+            timer->sample_count++;
+            if (i == METRICS_TIMER_FRAME && value > state_ptr->frame_budget_ms) {
+                timer->over_budget_count++;
+                timer->over_budget_total++;
+            }
+        }
+    }
+
+    state_ptr->history_head = (state_ptr->history_head + 1) % METRICS_HISTORY_FRAMES;
+    if (state_ptr->history_count < METRICS_HISTORY_FRAMES) {
+        state_ptr->history_count++;
     }
+    state_ptr->frame_number++;
 }
 
 void metrics_update(f64 frame_elapsed_time) {
@@ -29,6 +152,7 @@ void metrics_update(f64 frame_elapsed_time) {
     f64 frame_ms = (frame_elapsed_time * 1000.0);
     state_ptr->ms_times[state_ptr->frame_avg_counter] = frame_ms;
     if (state_ptr->frame_avg_counter == AVG_COUNT - 1) {
+        state_ptr->ms_avg = 0;
         for (u8 i = 0; i < AVG_COUNT; ++i) {
             state_ptr->ms_avg += state_ptr->ms_times[i];
         }
@@ -48,6 +172,8 @@ void metrics_update(f64 frame_elapsed_time) {
 
     // Count all frames.
     state_ptr->frames++;
+
+    history_commit(frame_ms);
 }
 
 f64 metrics_fps(void) {
@@ -76,3 +202,285 @@ void metrics_frame(f64* out_fps, f64* out_frame_ms) {
     *out_fps = state_ptr->fps;
     *out_frame_ms = state_ptr->ms_avg;
 }
+
+void metrics_gpu_memory_set(const metrics_gpu_memory* stats) {
+    if (!state_ptr || !stats) {
+        return;
+    }
+
+    state_ptr->gpu_memory = *stats;
+}
+
+void metrics_gpu_memory_get(metrics_gpu_memory* out_stats) {
+    if (!state_ptr) {
+        kzero_memory(out_stats, sizeof(metrics_gpu_memory));
+        return;
+    }
+
+    *out_stats = state_ptr->gpu_memory;
+}
+
+void metrics_gpu_heaps_set(const metrics_gpu_heap* heaps, u32 count) {
+    if (!state_ptr || (count && !heaps)) {
+        return;
+    }
+
+    state_ptr->gpu_heap_count = KMIN(count, METRICS_MAX_GPU_HEAPS);
+    kcopy_memory(state_ptr->gpu_heaps, heaps, sizeof(metrics_gpu_heap) * state_ptr->gpu_heap_count);
+}
+
+u32 metrics_gpu_heaps_get(metrics_gpu_heap* out_heaps) {
+    if (!state_ptr) {
+        return 0;
+    }
+
+    kcopy_memory(out_heaps, state_ptr->gpu_heaps, sizeof(metrics_gpu_heap) * state_ptr->gpu_heap_count);
+    return state_ptr->gpu_heap_count;
+}
+
+void metrics_frame_latency_set(f64 latency_seconds, u32 frames_queued) {
+    if (!state_ptr) {
+        return;
+    }
+
+    state_ptr->latency_ms_times[state_ptr->latency_avg_counter] = latency_seconds * 1000.0;
+    if (state_ptr->latency_avg_counter == AVG_COUNT - 1) {
+        state_ptr->latency_ms_avg = 0;
+        for (u8 i = 0; i < AVG_COUNT; ++i) {
+            state_ptr->latency_ms_avg += state_ptr->latency_ms_times[i];
+        }
+
+        state_ptr->latency_ms_avg /= AVG_COUNT;
+    }
+    state_ptr->latency_avg_counter++;
+    state_ptr->latency_avg_counter %= AVG_COUNT;
+
+    state_ptr->frames_queued = frames_queued;
+}
+
+void metrics_frame_latency(f64* out_latency_ms, u32* out_frames_queued) {
+    if (!state_ptr) {
+        *out_latency_ms = 0;
+        *out_frames_queued = 0;
+        return;
+    }
+
+    *out_latency_ms = state_ptr->latency_ms_avg;
+    *out_frames_queued = state_ptr->frames_queued;
+}
+
+void metrics_gpu_passes_set(const metrics_gpu_pass* passes, u32 count) {
+    if (!state_ptr || (count && !passes)) {
+        return;
+    }
+
+    state_ptr->gpu_pass_count = KMIN(count, METRICS_MAX_GPU_PASSES);
+    kcopy_memory(state_ptr->gpu_passes, passes, sizeof(metrics_gpu_pass) * state_ptr->gpu_pass_count);
+}
+
+u32 metrics_gpu_passes_get(metrics_gpu_pass* out_passes) {
+    if (!state_ptr) {
+        return 0;
+    }
+
+    kcopy_memory(out_passes, state_ptr->gpu_passes, sizeof(metrics_gpu_pass) * state_ptr->gpu_pass_count);
+    return state_ptr->gpu_pass_count;
+}
+
+void metrics_gpu_frame_time_set(f64 ms) {
+    if (!state_ptr) {
+        return;
+    }
+
+    state_ptr->gpu_frame_ms = ms;
+}
+
+f64 metrics_gpu_frame_time(void) {
+    return state_ptr ? state_ptr->gpu_frame_ms : 0.0;
+}
+
+void metrics_timer_record(metrics_timer timer, f64 seconds) {
+    if (!state_ptr || timer >= METRICS_TIMER_COUNT) {
+        return;
+    }
+
+    f32* current = &state_ptr->current_timers[timer];
+    if (*current == TIMER_NOT_RECORDED) {
+        *current = 0;
+    }
+    *current += (f32)(seconds * 1000.0);
+}
+
+void metrics_timer_stats_get(metrics_timer timer, metrics_timer_stats* out_stats) {
+    kzero_memory(out_stats, sizeof(metrics_timer_stats));
+    if (!state_ptr || timer >= METRICS_TIMER_COUNT) {
+        return;
+    }
+
+    const metrics_timer_history* history = &state_ptr->timer_histories[timer];
+    out_stats->sample_count = history->sample_count;
+    out_stats->over_budget_count = history->over_budget_count;
+    out_stats->over_budget_total = history->over_budget_total;
+    if (!history->sample_count) {
+        return;
+    }
+
+    // The mean and maximum are exact, so are taken from the samples themselves.
+    f64 total = 0;
+    for (u32 i = 0; i < state_ptr->history_count; ++i) {
+        f32 value = state_ptr->history[i][timer];
+        if (value != TIMER_NOT_RECORDED) {
+            total += value;
+            out_stats->max_ms = KMAX(out_stats->max_ms, value);
+        }
+    }
+    out_stats->avg_ms = total / history->sample_count;
+
+    // Walk the histogram once for all percentiles, which are reported as the highest value of
+    // the bucket they fall in, but never more than the maximum.
+    const f64 percentiles[3] = {0.50, 0.95, 0.99};
+    f64* outputs[3] = {&out_stats->p50_ms, &out_stats->p95_ms, &out_stats->p99_ms};
+    u32 next = 0;
+    u32 cumulative = 0;
+    for (u32 b = 0; b < HISTOGRAM_BUCKET_COUNT && next < 3; ++b) {
+        cumulative += history->buckets[b];
+        while (next < 3 && cumulative >= percentiles[next] * history->sample_count) {
+            *outputs[next] = KMIN(histogram_bucket_value(b), out_stats->max_ms);
+            next++;
+        }
+    }
+}
+
+const char* metrics_timer_name(metrics_timer timer) {
+    return timer < METRICS_TIMER_COUNT ? timer_names[timer] : "unknown";
+}
+
+void metrics_frame_budget_set(f64 budget_ms) {
+    if (!state_ptr || budget_ms <= 0) {
+        return;
+    }
+
+    state_ptr->frame_budget_ms = budget_ms;
+
+    // Recount the frames in the history against the new budget.
+    metrics_timer_history* frame = &state_ptr->timer_histories[METRICS_TIMER_FRAME];
+    frame->over_budget_count = 0;
+    for (u32 i = 0; i < state_ptr->history_count; ++i) {
+        f32 value = state_ptr->history[i][METRICS_TIMER_FRAME];
+        if (value != TIMER_NOT_RECORDED && value > budget_ms) {
+            frame->over_budget_count++;
+        }
+    }
+}
+
+b8 metrics_dump_csv(const char* path) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("metrics_dump_csv - unable to open '%s' for writing.", path);
+        return false;
+    }
+
+    char line[512];
+    u32 length = string_format(line, "frame");
+    for (u32 t = 0; t < METRICS_TIMER_COUNT; ++t) {
+        length += string_format(line + length, ",%s_ms", timer_names[t]);
+    }
+    b8 result = filesystem_write_line(&f, line);
+
+    // The oldest row is at the head once the history is full.
+    u32 first = state_ptr->history_count == METRICS_HISTORY_FRAMES ? state_ptr->history_head : 0;
+    u64 frame_number = state_ptr->frame_number - state_ptr->history_count;
+    for (u32 i = 0; i < state_ptr->history_count && result; ++i) {
+        const f32* row = state_ptr->history[(first + i) % METRICS_HISTORY_FRAMES];
+        length = string_format(line, "%llu", frame_number + i);
+        for (u32 t = 0; t < METRICS_TIMER_COUNT; ++t) {
+            if (row[t] == TIMER_NOT_RECORDED) {
+                length += string_format(line + length, ",");
+            } else {
+                length += string_format(line + length, ",%.3f", row[t]);
+            }
+        }
+        result = filesystem_write_line(&f, line);
+    }
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("metrics_dump_csv - failed to write to '%s'.", path);
+    }
+    return result;
+}
+
+static void metrics_console_command_print(console_command_context context) {
+    if (!state_ptr) {
+        return;
+    }
+
+    char line[256];
+    string_format(line, "Last %u frames, budget %.2fms:", state_ptr->history_count, state_ptr->frame_budget_ms);
+    console_write_line(LOG_LEVEL_INFO, line);
+    string_format(line, "%-16s %8s %8s %8s %8s %8s", "timer", "avg", "p50", "p95", "p99", "max");
+    console_write_line(LOG_LEVEL_INFO, line);
+    for (u32 t = 0; t < METRICS_TIMER_COUNT; ++t) {
+        metrics_timer_stats stats;
+        metrics_timer_stats_get(t, &stats);
+        if (!stats.sample_count) {
+            continue;
+        }
+        string_format(line, "%-16s %7.2fms %7.2fms %7.2fms %7.2fms %7.2fms", timer_names[t], stats.avg_ms, stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+        console_write_line(LOG_LEVEL_INFO, line);
+    }
+    const metrics_timer_history* frame = &state_ptr->timer_histories[METRICS_TIMER_FRAME];
+    string_format(line, "Frames over budget: %u (%llu since startup)", frame->over_budget_count, frame->over_budget_total);
+    console_write_line(LOG_LEVEL_INFO, line);
+}
+
+static void metrics_console_command_gpu_memory(console_command_context context) {
+    if (!state_ptr) {
+        return;
+    }
+
+    char line[256];
+    if (!state_ptr->gpu_heap_count) {
+        console_write_line(LOG_LEVEL_INFO, "No GPU memory heaps have been reported.");
+        return;
+    }
+    string_format(line, "%-5s %-6s %10s %10s %10s %6s", "heap", "local", "usage", "budget", "size", "used");
+    console_write_line(LOG_LEVEL_INFO, line);
+    for (u32 i = 0; i < state_ptr->gpu_heap_count; ++i) {
+        const metrics_gpu_heap* heap = &state_ptr->gpu_heaps[i];
+        f64 used = heap->budget ? ((f64)heap->usage / (f64)heap->budget) * 100.0 : 0.0;
+        string_format(line, "%-5u %-6s %8.1fMiB %8.1fMiB %8.1fMiB %5.1f%%%s", i, heap->device_local ? "yes" : "no",
+                      heap->usage / (1024.0 * 1024.0), heap->budget / (1024.0 * 1024.0), heap->size / (1024.0 * 1024.0), used,
+                      heap->driver_reported ? "" : " (estimated)");
+        console_write_line(LOG_LEVEL_INFO, line);
+    }
+}
+
+static void metrics_console_command_dump(console_command_context context) {
+    const char* path = context.arguments[0].value;
+    if (metrics_dump_csv(path)) {
+        char line[256];
+        string_format(line, "Wrote frame timers to '%s'.", path);
+        console_write_line(LOG_LEVEL_INFO, line);
+    }
+}
+
+static void metrics_console_command_budget(console_command_context context) {
+    f32 budget_ms = 0;
+    if (!string_to_f32(context.arguments[0].value, &budget_ms) || budget_ms <= 0) {
+        console_write_line(LOG_LEVEL_ERROR, "metrics_budget_set requires a budget in milliseconds greater than 0.");
+        return;
+    }
+    metrics_frame_budget_set(budget_ms);
+}
+
+void metrics_console_commands_register(void) {
+    console_command_register("metrics_print", 0, metrics_console_command_print);
+    console_command_register("metrics_dump", 1, metrics_console_command_dump);
+    console_command_register("metrics_budget_set", 1, metrics_console_command_budget);
+    console_command_register("gpu_memory_print", 0, metrics_console_command_gpu_memory);
+}
@@ -2,13 +2,112 @@
 
 #include "defines.h"
 
+/** @brief GPU memory statistics, as reported by the renderer backend. */
+typedef struct metrics_gpu_memory {
+    /** @brief The number of large blocks which resources are sub-allocated from. */
+    u32 block_count;
+    /** @brief The total size of all blocks. */
+    u64 block_bytes;
+    /** @brief The number of bytes in use within blocks. */
+    u64 block_used_bytes;
+    /** @brief The number of resources sub-allocated from blocks. */
+    u32 block_allocation_count;
+    /** @brief The number of resources with a dedicated device allocation. */
+    u32 dedicated_count;
+    /** @brief The total size of all dedicated allocations. */
+    u64 dedicated_bytes;
+} metrics_gpu_memory;
+
+/** @brief The maximum number of GPU memory heaps for which budgets are recorded. */
+#define METRICS_MAX_GPU_HEAPS 16
+
+/** @brief The budget and usage of a single GPU memory heap, as reported by the renderer backend. */
+typedef struct metrics_gpu_heap {
+    /** @brief The total size of the heap. */
+    u64 size;
+    /**
+     * @brief The number of bytes the process may use from the heap before the driver is likely
+     * to start paging or failing allocations. Accounts for other processes, so may change over time.
+     */
+    u64 budget;
+    /** @brief The number of bytes of the heap in use by the process. */
+    u64 usage;
+    /** @brief Indicates if the heap is local to the GPU (i.e. VRAM on discrete GPUs). */
+    b8 device_local;
+    /** @brief Indicates if the budget and usage come from the driver, rather than being estimated from the backend's own allocations. */
+    b8 driver_reported;
+} metrics_gpu_heap;
+
+/** @brief The maximum number of passes for which GPU timings are recorded. */
+#define METRICS_MAX_GPU_PASSES 32
+/** @brief The maximum length of a GPU pass name, including the terminator. */
+#define METRICS_GPU_PASS_NAME_MAX 64
+
+/** @brief GPU timings of a single pass over a frame, as reported by the renderer backend. */
+typedef struct metrics_gpu_pass {
+    /** @brief The name of the pass. */
+    char name[METRICS_GPU_PASS_NAME_MAX];
+    /** @brief The time taken by the pass on the GPU in milliseconds, summed over all of its renderpasses. */
+    f64 ms;
+    /** @brief The number of vertex shader invocations in the pass. 0 if pipeline statistics are unavailable. */
+    u64 vertex_invocations;
+    /** @brief The number of fragment shader invocations in the pass. 0 if pipeline statistics are unavailable. */
+    u64 fragment_invocations;
+} metrics_gpu_pass;
+
+/** @brief The number of most recent frames over which timer statistics are kept. */
+#define METRICS_HISTORY_FRAMES 1024
+
+/** @brief The timers recorded each frame. Timers may overlap one another. */
+typedef enum metrics_timer {
+    /** @brief The whole frame, as passed to metrics_update. */
+    METRICS_TIMER_FRAME,
+    /** @brief System and game updates. */
+    METRICS_TIMER_UPDATE,
+    /** @brief The game's preparation of the frame for rendering. */
+    METRICS_TIMER_RENDER_PREPARE,
+    /** @brief The game's rendering of the frame, including presentation. */
+    METRICS_TIMER_RENDER,
+    /** @brief Time the CPU spent waiting on the GPU to finish an earlier frame. */
+    METRICS_TIMER_GPU_WAIT,
+    /** @brief Handing the frame over for presentation. */
+    METRICS_TIMER_PRESENT,
+    METRICS_TIMER_COUNT
+} metrics_timer;
+
+/** @brief Statistics of a timer over the last METRICS_HISTORY_FRAMES frames. */
+typedef struct metrics_timer_stats {
+    /** @brief The number of frames in which the timer was recorded. */
+    u32 sample_count;
+    /** @brief The mean time in milliseconds. */
+    f64 avg_ms;
+    /** @brief The median time in milliseconds. */
+    f64 p50_ms;
+    /** @brief The 95th percentile time in milliseconds. */
+    f64 p95_ms;
+    /** @brief The 99th percentile time in milliseconds. */
+    f64 p99_ms;
+    /** @brief The longest time in milliseconds. */
+    f64 max_ms;
+    /** @brief The number of samples over the frame budget. Only counted for METRICS_TIMER_FRAME. */
+    u32 over_budget_count;
+    /** @brief The number of samples over the frame budget since startup. Only counted for METRICS_TIMER_FRAME. */
+    u64 over_budget_total;
+} metrics_timer_stats;
+
 /**
  * @brief Initializes the metrics system.
  */
 KAPI void metrics_initialize(void);
 
 /**
- * @brief Updates metrics; should be called once per frame.
+ * @brief Registers the metrics console commands. Called once the console is available.
+ */
+KAPI void metrics_console_commands_register(void);
+
+/**
+ * @brief Updates metrics; should be called once per frame, before any timers of the frame are
+ * recorded. Timers recorded since the last call are stored along with the given frame time.
  *
  * @param frame_elapsed_time The amount of time elapsed on the previous frame.
  */
@@ -31,3 +130,122 @@ KAPI f64 metrics_frame_time(void);
  * @param out_frame_ms A pointer to hold the running average frametime in milliseconds.
  */
 KAPI void metrics_frame(f64* out_fps, f64* out_frame_ms);
+
+/**
+ * @brief Records the current GPU memory statistics. Called by the renderer backend whenever they change.
+ *
+ * @param stats A constant pointer to the statistics to record.
+ */
+KAPI void metrics_gpu_memory_set(const metrics_gpu_memory* stats);
+
+/**
+ * @brief Gets the most recently recorded GPU memory statistics.
+ *
+ * @param out_stats A pointer to hold the statistics. Zeroed if none have been recorded.
+ */
+KAPI void metrics_gpu_memory_get(metrics_gpu_memory* out_stats);
+
+/**
+ * @brief Records the budget and usage of each GPU memory heap. Called by the renderer backend each frame.
+ *
+ * @param heaps An array of heap budgets.
+ * @param count The number of heaps. Clamped to METRICS_MAX_GPU_HEAPS.
+ */
+KAPI void metrics_gpu_heaps_set(const metrics_gpu_heap* heaps, u32 count);
+
+/**
+ * @brief Gets the most recently recorded budget and usage of each GPU memory heap.
+ *
+ * @param out_heaps An array of at least METRICS_MAX_GPU_HEAPS elements to hold the heaps.
+ * @return The number of heaps written to out_heaps.
+ */
+KAPI u32 metrics_gpu_heaps_get(metrics_gpu_heap* out_heaps);
+
+/**
+ * @brief Records the latency of a frame, from the CPU beginning to prepare it to the GPU
+ * completing it. Called by the renderer backend as each frame is found to have completed.
+ *
+ * @param latency_seconds The latency of the frame in seconds.
+ * @param frames_queued The number of frames which were still queued on the GPU when it completed.
+ */
+KAPI void metrics_frame_latency_set(f64 latency_seconds, u32 frames_queued);
+
+/**
+ * @brief Gets the running average CPU-GPU frame latency.
+ *
+ * @param out_latency_ms A pointer to hold the running average frame latency in milliseconds.
+ * @param out_frames_queued A pointer to hold the number of frames queued on the GPU at last measurement.
+ */
+KAPI void metrics_frame_latency(f64* out_latency_ms, u32* out_frames_queued);
+
+/**
+ * @brief Records the GPU timings of each pass of the most recently completed frame. Called by
+ * the renderer backend as each frame is found to have completed.
+ *
+ * @param passes An array of pass timings.
+ * @param count The number of pass timings. Clamped to METRICS_MAX_GPU_PASSES.
+ */
+KAPI void metrics_gpu_passes_set(const metrics_gpu_pass* passes, u32 count);
+
+/**
+ * @brief Gets the most recently recorded GPU timings of each pass.
+ *
+ * @param out_passes An array of at least METRICS_MAX_GPU_PASSES elements to hold the timings.
+ * @return The number of passes written to out_passes.
+ */
+KAPI u32 metrics_gpu_passes_get(metrics_gpu_pass* out_passes);
+
+/**
+ * @brief Records the time the GPU took over the most recently completed frame, from the start
+ * of its first timed pass to the end of its last. Called by the renderer backend as each frame
+ * is found to have completed.
+ *
+ * @param ms The GPU time of the frame in milliseconds.
+ */
+KAPI void metrics_gpu_frame_time_set(f64 ms);
+
+/**
+ * @brief Gets the most recently recorded GPU time of a frame.
+ *
+ * @return The GPU time of the frame in milliseconds, or 0 if the backend has not reported one.
+ */
+KAPI f64 metrics_gpu_frame_time(void);
+
+/**
+ * @brief Adds to the time of the given timer for the current frame. Timers recorded more
+ * than once in a frame are summed.
+ *
+ * @param timer The timer to add to.
+ * @param seconds The time to add, in seconds.
+ */
+KAPI void metrics_timer_record(metrics_timer timer, f64 seconds);
+
+/**
+ * @brief Gets the statistics of the given timer over the last METRICS_HISTORY_FRAMES frames.
+ * Percentiles are taken from a histogram, and are accurate to within about 2%.
+ *
+ * @param timer The timer to get statistics for.
+ * @param out_stats A pointer to hold the statistics. Zeroed if none have been recorded.
+ */
+KAPI void metrics_timer_stats_get(metrics_timer timer, metrics_timer_stats* out_stats);
+
+/**
+ * @brief Gets the display name of the given timer.
+ */
+KAPI const char* metrics_timer_name(metrics_timer timer);
+
+/**
+ * @brief Sets the frame budget; frames which take longer are counted as over budget. Defaults to 60 FPS.
+ *
+ * @param budget_ms The frame budget in milliseconds.
+ */
+KAPI void metrics_frame_budget_set(f64 budget_ms);
+
+/**
+ * @brief Writes the timers of the last METRICS_HISTORY_FRAMES frames to a CSV file, oldest
+ * first, one frame per row. Timers not recorded in a frame are left blank.
+ *
+ * @param path The path of the file to write.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 metrics_dump_csv(const char* path);
@@ -9,7 +9,9 @@
 #include "core/event.h"
 #include "core/input.h"
 #include "core/kmemory.h"
+#include "core/kname.h"
 #include "core/kvar.h"
+#include "math/kmath.h"
 #include "platform/platform.h"
 #include "renderer/renderer_frontend.h"
 #include "systems/audio_system.h"
@@ -18,6 +20,8 @@
 #include "systems/job_system.h"
 #include "systems/light_system.h"
 #include "systems/material_system.h"
+#include "systems/network_system.h"
+#include "systems/physics_system.h"
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
@@ -35,8 +39,12 @@ static void shutdown_user_systems(systems_manager_state* state);
 static systems_manager_state* g_state;
 
 b8 systems_manager_initialize(systems_manager_state* state, application_config* app_config) {
-    // Create a linear allocator for all systems (except memory) to use.
-    linear_allocator_create(MEBIBYTES(64), 0, &state->systems_allocator);
+    // Create a linear allocator for all systems (except memory) to use. Only what the systems'
+    // states take up is committed.
+    if (!linear_allocator_create_reserved(MEBIBYTES(64), false, &state->systems_allocator)) {
+        KFATAL("Failed to reserve memory for system states.");
+        return false;
+    }
 
     g_state = state;
 
@@ -103,6 +111,199 @@ b8 systems_manager_register(
     return true;
 }
 
+// The progress of a system being initialized as part of a group.
+typedef enum group_entry_status {
+    GROUP_ENTRY_STATUS_PENDING,
+    GROUP_ENTRY_STATUS_RUNNING,
+    GROUP_ENTRY_STATUS_DONE
+} group_entry_status;
+
+typedef struct group_entry {
+    const k_system_registration* registration;
+    group_entry_status status;
+    // Signaled by the job initializing the system. Invalid if it is initialized on the calling thread.
+    job_counter counter;
+    // Written by whatever initializes the system, and only read once it is done.
+    b8 result;
+} group_entry;
+
+// Makes the second initialize call for the entry's system, whose state has already been allocated.
+static b8 group_entry_initialize(group_entry* entry) {
+    k_system* sys = &g_state->systems[entry->registration->type];
+    entry->result = sys->initialize(&sys->state_size, sys->state, entry->registration->config);
+    if (!entry->result) {
+        KERROR("Failed to register system %u - initialize call failed.", entry->registration->type);
+    }
+    return entry->result;
+}
+
+static b8 group_entry_job_start(void* params, void* result_data) {
+    return group_entry_initialize(*(group_entry**)params);
+}
+
+// Indicates if every system the entry depends on within the group is done. Those outside it were checked up front.
+static b8 group_entry_ready(const group_entry* entries, u32 count, const group_entry* entry) {
+    const k_system_registration* reg = entry->registration;
+    for (u8 d = 0; d < reg->dependency_count; ++d) {
+        for (u32 i = 0; i < count; ++i) {
+            if (entries[i].registration->type == reg->dependencies[d] && entries[i].status != GROUP_ENTRY_STATUS_DONE) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+b8 systems_manager_register_group(systems_manager_state* state, u32 count, const k_system_registration* registrations) {
+    f64 start_time = platform_get_absolute_time();
+
+    // Check that every dependency is either within the group or already registered.
+    for (u32 i = 0; i < count; ++i) {
+        const k_system_registration* reg = &registrations[i];
+        if (!reg->initialize) {
+            KERROR("Failed to register system %u - initialize is required for systems registered as part of a group.", reg->type);
+            return false;
+        }
+        if (reg->dependency_count > K_SYSTEM_MAX_DEPENDENCIES) {
+            KERROR("Failed to register system %u - it has more than %u dependencies.", reg->type, K_SYSTEM_MAX_DEPENDENCIES);
+            return false;
+        }
+        for (u8 d = 0; d < reg->dependency_count; ++d) {
+            u16 dependency = reg->dependencies[d];
+            b8 in_group = false;
+            for (u32 j = 0; j < count && !in_group; ++j) {
+                in_group = j != i && registrations[j].type == dependency;
+            }
+            if (!in_group && !state->systems[dependency].state) {
+                KERROR("Failed to register system %u - it depends on system %u, which is not registered.", reg->type, dependency);
+                return false;
+            }
+        }
+    }
+
+    // Get the memory requirements and allocate the states up front, as the allocator is not thread-safe.
+    for (u32 i = 0; i < count; ++i) {
+        const k_system_registration* reg = &registrations[i];
+        k_system* sys = &state->systems[reg->type];
+        sys->initialize = reg->initialize;
+        if (!sys->initialize(&sys->state_size, 0, reg->config)) {
+            KERROR("Failed to register system %u - initialize call failed.", reg->type);
+            return false;
+        }
+        sys->state = linear_allocator_allocate(&state->systems_allocator, sys->state_size);
+    }
+
+    // Without the job system everything is initialized here. GPU resources may only be created off the
+    // main thread by multithreaded renderers, and then only from the GPU resource job thread.
+    b8 use_jobs = state->systems[K_SYSTEM_TYPE_JOB].state != 0;
+    b8 gpu_jobs = use_jobs && state->systems[K_SYSTEM_TYPE_RENDERER].state && renderer_is_multithreaded();
+
+    group_entry* entries = kallocate(sizeof(group_entry) * count, MEMORY_TAG_ENGINE);
+    for (u32 i = 0; i < count; ++i) {
+        entries[i].registration = &registrations[i];
+    }
+
+    u32 done_count = 0;
+    u32 running_count = 0;
+    b8 gpu_busy = false;
+    b8 success = true;
+    while (done_count < count) {
+        // Pick up the systems whose jobs have finished.
+        for (u32 i = 0; i < count; ++i) {
+            group_entry* entry = &entries[i];
+            if (entry->status == GROUP_ENTRY_STATUS_RUNNING && job_counter_is_complete(entry->counter)) {
+                job_counter_destroy(entry->counter);
+                entry->status = GROUP_ENTRY_STATUS_DONE;
+                done_count++;
+                running_count--;
+                if (entry->registration->uses_gpu) {
+                    gpu_busy = false;
+                }
+                success = success && entry->result;
+            }
+        }
+
+        if (!success) {
+            // Let the systems already being initialized finish before bailing out.
+            if (!running_count) {
+                break;
+            }
+            for (u32 i = 0; i < count; ++i) {
+                if (entries[i].status == GROUP_ENTRY_STATUS_RUNNING) {
+                    job_counter_wait(entries[i].counter);
+                }
+            }
+            continue;
+        }
+
+        // Start every system which is ready as a job, and run the first one which cannot be on this thread.
+        group_entry* local_entry = 0;
+        b8 started = false;
+        for (u32 i = 0; i < count; ++i) {
+            group_entry* entry = &entries[i];
+            b8 uses_gpu = entry->registration->uses_gpu;
+            if (entry->status != GROUP_ENTRY_STATUS_PENDING || (uses_gpu && gpu_busy) || !group_entry_ready(entries, count, entry)) {
+                continue;
+            }
+
+            if (use_jobs && (!uses_gpu || gpu_jobs)) {
+                entry->counter = job_counter_create();
+                if (entry->counter.generation) {
+                    job_info job = job_create_type(group_entry_job_start, 0, 0, &entry, sizeof(group_entry*), 0, uses_gpu ? JOB_TYPE_GPU_RESOURCE : JOB_TYPE_GENERAL);
+                    job_set_counters(&job, entry->counter, (job_counter){0});
+                    job_system_submit(job);
+                    entry->status = GROUP_ENTRY_STATUS_RUNNING;
+                    running_count++;
+                    gpu_busy = gpu_busy || uses_gpu;
+                    started = true;
+                    continue;
+                }
+                // Out of counters, so fall back to initializing it here.
+            }
+            if (!local_entry) {
+                local_entry = entry;
+            }
+        }
+
+        if (local_entry) {
+            group_entry_initialize(local_entry);
+            local_entry->status = GROUP_ENTRY_STATUS_DONE;
+            done_count++;
+            success = local_entry->result;
+        } else if (!started) {
+            if (!running_count) {
+                KERROR("Failed to register system group - the remaining systems depend on one another.");
+                success = false;
+                break;
+            }
+            // Nothing else can start until a running system is done, so help out with the jobs meanwhile.
+            for (u32 i = 0; i < count; ++i) {
+                if (entries[i].status == GROUP_ENTRY_STATUS_RUNNING) {
+                    job_counter_wait(entries[i].counter);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Systems which failed or never started are left unregistered.
+    for (u32 i = 0; i < count; ++i) {
+        k_system* sys = &state->systems[registrations[i].type];
+        if (entries[i].status == GROUP_ENTRY_STATUS_DONE && entries[i].result) {
+            sys->shutdown = registrations[i].shutdown;
+            sys->update = registrations[i].update;
+        } else {
+            kzero_memory(sys, sizeof(k_system));
+        }
+    }
+    kfree(entries, sizeof(group_entry) * count, MEMORY_TAG_ENGINE);
+
+    if (success) {
+        KDEBUG("Initialized a group of %u systems in %.2fms.", count, (platform_get_absolute_time() - start_time) * K_SEC_TO_MS_MULTIPLIER);
+    }
+    return success;
+}
+
 void* systems_manager_get_state(u16 type) {
     if (g_state) {
         return g_state->systems[type].state;
@@ -118,6 +319,12 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
         return false;
     }
 
+    // KNames
+    if (!systems_manager_register(state, K_SYSTEM_TYPE_KNAME, kname_system_initialize, kname_system_shutdown, 0, 0)) {
+        KERROR("Failed to register kname system.");
+        return false;
+    }
+
     // Console
     if (!systems_manager_register(state, K_SYSTEM_TYPE_CONSOLE, console_initialize, console_shutdown, 0, 0)) {
         KERROR("Failed to register console system.");
@@ -151,7 +358,10 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
     KINFO("Kohi Engine v. %s (%s)", KVERSION, build_type);
 
     // Input
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_INPUT, input_system_initialize, input_system_shutdown, 0, 0)) {
+    input_system_config input_config = {0};
+    input_config.sample_thread = true;
+    input_config.sample_frequency = 1000;
+    if (!systems_manager_register(state, K_SYSTEM_TYPE_INPUT, input_system_initialize, input_system_shutdown, 0, &input_config)) {
         KERROR("Failed to register input system.");
         return false;
     }
@@ -169,10 +379,17 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
     }
 
     // Resource system.
-    resource_system_config resource_sys_config;
+    resource_system_config resource_sys_config = {0};
     resource_sys_config.asset_base_path = "../assets";  // TODO: The application should probably configure this.
     resource_sys_config.max_loader_count = 32;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_RESOURCE, resource_system_initialize, resource_system_shutdown, 0, &resource_sys_config)) {
+    resource_sys_config.max_cached_resource_count = 4096;
+    resource_sys_config.cache_budget = MEBIBYTES(256);
+#ifdef _DEBUG
+    resource_sys_config.hot_reload = true;
+#else
+    resource_sys_config.hot_reload = false;
+#endif
+    if (!systems_manager_register(state, K_SYSTEM_TYPE_RESOURCE, resource_system_initialize, resource_system_shutdown, resource_system_update, &resource_sys_config)) {
         KERROR("Failed to register resource system.");
         return false;
     }
@@ -192,6 +409,7 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
     renderer_system_config renderer_sys_config = {0};
     renderer_sys_config.application_name = app_config->name;
     renderer_sys_config.plugin = app_config->renderer_plugin;
+    renderer_sys_config.frames_in_flight = app_config->frames_in_flight;
     if (!systems_manager_register(state, K_SYSTEM_TYPE_RENDERER, renderer_system_initialize, renderer_system_shutdown, 0, &renderer_sys_config)) {
         KERROR("Failed to register renderer system.");
         return false;
@@ -199,8 +417,33 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
 
     b8 renderer_multithreaded = renderer_is_multithreaded();
 
-    // This is really a core count. Subtract 1 to account for the main thread already being in use.
-    i32 thread_count = platform_get_processor_count() - 1;
+    // Threads are placed by the layout of the CPU. The main thread, and the render thread if frames
+    // are pipelined, each keep a performance core to themselves, and the job threads get one each of
+    // the rest, so no two busy threads share a core's caches or its hyperthreads.
+    platform_cpu_topology topology;
+    b8 topology_known = platform_cpu_topology_get(&topology);
+    KINFO("CPU: %u logical processors, %u cores (%u performance, %u efficiency), %u NUMA node(s)%s.",
+          topology.logical_processor_count, topology.core_count, topology.performance_core_count,
+          topology.efficiency_core_count, topology.numa_node_count, topology_known ? "" : ", guessed");
+
+    u32 reserved_core_count = app_config->pipelined_frames ? 2 : 1;
+    b8 pin_threads = topology_known && topology.core_count > reserved_core_count;
+    state->render_thread_affinity.processor_count = 0;
+
+    i32 thread_count;
+    if (pin_threads) {
+        thread_count = topology.core_count - reserved_core_count;
+        if (!kthread_affinity_set_current(&topology.cores[0].processors)) {
+            KWARN("The main thread could not be pinned to its core.");
+        }
+        if (app_config->pipelined_frames) {
+            state->render_thread_affinity = topology.cores[1].processors;
+        }
+    } else {
+        // Too few cores to keep any apart, so leave it to the scheduler.
+        // This is really a core count. Subtract 1 to account for the main thread already being in use.
+        thread_count = platform_get_processor_count() - 1;
+    }
     if (thread_count < 1) {
         KFATAL("Error: Platform reported processor count (minus one for main thread) as %i. Need at least one additional thread for the job system.", thread_count);
         return false;
@@ -218,51 +461,61 @@ static b8 register_known_systems_pre_boot(systems_manager_state* state, applicat
     // Initialize the job system.
     // Requires knowledge of renderer multithread support, so should be initialized here.
     u32 job_thread_types[15];
+    kthread_affinity job_thread_affinities[15] = {0};
     for (u32 i = 0; i < 15; ++i) {
         job_thread_types[i] = JOB_TYPE_GENERAL;
     }
+    for (i32 i = 0; pin_threads && i < thread_count; ++i) {
+        job_thread_affinities[i] = topology.cores[reserved_core_count + i].processors;
+    }
 
-    if (max_thread_count == 1 || !renderer_multithreaded) {
-        // Everything on one job thread.
-        job_thread_types[0] |= (JOB_TYPE_GPU_RESOURCE | JOB_TYPE_RESOURCE_LOAD);
-    } else if (max_thread_count == 2) {
-        // Split things between the 2 threads
-        job_thread_types[0] |= JOB_TYPE_GPU_RESOURCE;
-        job_thread_types[1] |= JOB_TYPE_RESOURCE_LOAD;
+    // Resource loads get a pool of I/O threads of their own, so reads never hold up compute jobs.
+    // These mostly wait on the disk, so a couple keep several reads in flight without competing
+    // for the cores.
+    const u8 io_thread_count = 2;
+
+    // On hybrid CPUs, GPU resource work goes on the first performance core's thread.
+    i32 gpu_thread = 0;
+    for (i32 i = 0; pin_threads && i < thread_count; ++i) {
+        if (topology.cores[reserved_core_count + i].core_class == PLATFORM_CORE_CLASS_PERFORMANCE) {
+            gpu_thread = i;
+            break;
+        }
+    }
+    if (thread_count < 3 || !renderer_multithreaded) {
+        // Too few threads to dedicate one, so it shares with general jobs.
+        job_thread_types[gpu_thread] |= JOB_TYPE_GPU_RESOURCE;
     } else {
-        // Dedicate the first 2 threads to these things, pass off general tasks to other threads.
-        job_thread_types[0] = JOB_TYPE_GPU_RESOURCE;
-        job_thread_types[1] = JOB_TYPE_RESOURCE_LOAD;
+        // Dedicate a thread to GPU resources, pass off general tasks to the others.
+        job_thread_types[gpu_thread] = JOB_TYPE_GPU_RESOURCE;
     }
 
     job_system_config job_sys_config = {0};
     job_sys_config.max_job_thread_count = thread_count;
     job_sys_config.type_masks = job_thread_types;
+    job_sys_config.affinities = pin_threads ? job_thread_affinities : 0;
+    job_sys_config.io_thread_count = io_thread_count;
+    // Enough fibers for deep chains of jobs waiting on jobs. Stack pages are only committed once touched.
+    job_sys_config.fiber_count = app_config->job_fibers ? 128 : 0;
     if (!systems_manager_register(state, K_SYSTEM_TYPE_JOB, job_system_initialize, job_system_shutdown, job_system_update, &job_sys_config)) {
         KERROR("Failed to register job system.");
         return false;
     }
 
-    // Audio system
-    audio_system_config audio_sys_config = {0};
-    audio_sys_config.plugin = app_config->audio_plugin;
-    audio_sys_config.audio_channel_count = 8;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_AUDIO, audio_system_initialize, audio_system_shutdown, audio_system_update, &audio_sys_config)) {
-        KERROR("Failed to register audio system.");
-        return false;
-    }
-
     return true;
 }
 
 static void shutdown_known_systems(systems_manager_state* state) {
     state->systems[K_SYSTEM_TYPE_CAMERA].shutdown(state->systems[K_SYSTEM_TYPE_CAMERA].state);
     state->systems[K_SYSTEM_TYPE_FONT].shutdown(state->systems[K_SYSTEM_TYPE_FONT].state);
+    state->systems[K_SYSTEM_TYPE_LIGHT].shutdown(state->systems[K_SYSTEM_TYPE_LIGHT].state);
 
     state->systems[K_SYSTEM_TYPE_GEOMETRY].shutdown(state->systems[K_SYSTEM_TYPE_GEOMETRY].state);
     state->systems[K_SYSTEM_TYPE_MATERIAL].shutdown(state->systems[K_SYSTEM_TYPE_MATERIAL].state);
     state->systems[K_SYSTEM_TYPE_TEXTURE].shutdown(state->systems[K_SYSTEM_TYPE_TEXTURE].state);
 
+    state->systems[K_SYSTEM_TYPE_NETWORK].shutdown(state->systems[K_SYSTEM_TYPE_NETWORK].state);
+    state->systems[K_SYSTEM_TYPE_PHYSICS].shutdown(state->systems[K_SYSTEM_TYPE_PHYSICS].state);
     state->systems[K_SYSTEM_TYPE_AUDIO].shutdown(state->systems[K_SYSTEM_TYPE_AUDIO].state);
     state->systems[K_SYSTEM_TYPE_JOB].shutdown(state->systems[K_SYSTEM_TYPE_JOB].state);
     state->systems[K_SYSTEM_TYPE_SHADER].shutdown(state->systems[K_SYSTEM_TYPE_SHADER].state);
@@ -276,6 +529,8 @@ static void shutdown_known_systems(systems_manager_state* state) {
     state->systems[K_SYSTEM_TYPE_KVAR].shutdown(state->systems[K_SYSTEM_TYPE_KVAR].state);
     state->systems[K_SYSTEM_TYPE_CONSOLE].shutdown(state->systems[K_SYSTEM_TYPE_CONSOLE].state);
 
+    state->systems[K_SYSTEM_TYPE_KNAME].shutdown(state->systems[K_SYSTEM_TYPE_KNAME].state);
+
     state->systems[K_SYSTEM_TYPE_MEMORY].shutdown(state->systems[K_SYSTEM_TYPE_MEMORY].state);
 }
 
@@ -300,44 +555,52 @@ static b8 register_known_systems_post_boot(systems_manager_state* state, applica
     // Texture system.
     texture_system_config texture_sys_config;
     texture_sys_config.max_texture_count = 65536;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_TEXTURE, texture_system_initialize, texture_system_shutdown, 0, &texture_sys_config)) {
-        KERROR("Failed to register texture system.");
-        return false;
-    }
-
-    // Font system.
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_FONT, font_system_initialize, font_system_shutdown, 0, &app_config->font_config)) {
-        KERROR("Failed to register font system.");
-        return false;
-    }
+    texture_sys_config.streaming_budget = TEXTURE_STREAMING_DEFAULT_BUDGET;
 
     // Camera
     camera_system_config camera_sys_config;
     camera_sys_config.max_camera_count = 61;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_CAMERA, camera_system_initialize, camera_system_shutdown, 0, &camera_sys_config)) {
-        KERROR("Failed to register camera system.");
-        return false;
-    }
 
     // Material system.
     material_system_config material_sys_config;
     material_sys_config.max_material_count = 4096;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_MATERIAL, material_system_initialize, material_system_shutdown, 0, &material_sys_config)) {
-        KERROR("Failed to register material system.");
-        return false;
-    }
 
     // Geometry system.
     geometry_system_config geometry_sys_config;
     geometry_sys_config.max_geometry_count = 4096;
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_GEOMETRY, geometry_system_initialize, geometry_system_shutdown, 0, &geometry_sys_config)) {
-        KERROR("Failed to register geometry system.");
-        return false;
-    }
 
-    // Light system.
-    if (!systems_manager_register(state, K_SYSTEM_TYPE_LIGHT, light_system_initialize, light_system_shutdown, 0, 0)) {
-        KERROR("Failed to register light system.");
+    // Audio system. Does not need to be up until the application is initialized, so its device is
+    // opened here, alongside the creation of the default resources.
+    audio_system_config audio_sys_config = {0};
+    audio_sys_config.plugin = app_config->audio_plugin;
+    audio_sys_config.audio_channel_count = 8;
+
+    // Physics system. Steps at the default rate, solving islands on the job system.
+    physics_system_config physics_sys_config = {0};
+    physics_sys_config.max_body_count = 8192;
+    physics_sys_config.gravity = (vec3){0.0f, -9.81f, 0.0f};
+
+    // Network system. Idle until a server is started or a client connects.
+    network_system_config network_sys_config = {0};
+    network_sys_config.max_entity_count = 8192;
+    network_sys_config.max_client_count = 32;
+
+    // Each system starts as soon as those it depends on are up. Those which use the GPU (default textures,
+    // font atlases, default materials and geometries) are initialized one at a time, while the others
+    // are initialized alongside them on the job system.
+    k_system_registration registrations[] = {
+        {K_SYSTEM_TYPE_TEXTURE, texture_system_initialize, texture_system_shutdown, texture_system_update, &texture_sys_config, 2, {K_SYSTEM_TYPE_RENDERER, K_SYSTEM_TYPE_RESOURCE}, true},
+        {K_SYSTEM_TYPE_FONT, font_system_initialize, font_system_shutdown, 0, &app_config->font_config, 2, {K_SYSTEM_TYPE_TEXTURE, K_SYSTEM_TYPE_RESOURCE}, true},
+        {K_SYSTEM_TYPE_CAMERA, camera_system_initialize, camera_system_shutdown, 0, &camera_sys_config, 0, {0}, false},
+        {K_SYSTEM_TYPE_MATERIAL, material_system_initialize, material_system_shutdown, 0, &material_sys_config, 3, {K_SYSTEM_TYPE_TEXTURE, K_SYSTEM_TYPE_SHADER, K_SYSTEM_TYPE_RESOURCE}, true},
+        {K_SYSTEM_TYPE_GEOMETRY, geometry_system_initialize, geometry_system_shutdown, geometry_system_update, &geometry_sys_config, 2, {K_SYSTEM_TYPE_MATERIAL, K_SYSTEM_TYPE_RENDERER}, true},
+        {K_SYSTEM_TYPE_LIGHT, light_system_initialize, light_system_shutdown, 0, 0, 0, {0}, false},
+        {K_SYSTEM_TYPE_AUDIO, audio_system_initialize, audio_system_shutdown, audio_system_update, &audio_sys_config, 1, {K_SYSTEM_TYPE_JOB}, false},
+        {K_SYSTEM_TYPE_PHYSICS, physics_system_initialize, physics_system_shutdown, physics_system_update, &physics_sys_config, 1, {K_SYSTEM_TYPE_JOB}, false},
+        {K_SYSTEM_TYPE_NETWORK, network_system_initialize, network_system_shutdown, network_system_update, &network_sys_config, 1, {K_SYSTEM_TYPE_JOB}, false},
+    };
+    if (!systems_manager_register_group(state, sizeof(registrations) / sizeof(k_system_registration), registrations)) {
+        KERROR("Failed to register post-boot systems.");
         return false;
     }
 
@@ -12,6 +12,7 @@
  */
 #pragma once
 
+#include "core/kthread.h"
 #include "defines.h"
 #include "memory/linear_allocator.h"
 
@@ -44,6 +45,37 @@ typedef struct k_system {
 
 #define K_SYSTEM_TYPE_MAX_COUNT 512
 
+/** @brief The most systems a single system may depend on when registered as part of a group. */
+#define K_SYSTEM_MAX_DEPENDENCIES 8
+
+/**
+ * @brief Describes a system to be registered as part of a group. See systems_manager_register_group.
+ */
+typedef struct k_system_registration {
+    /** @brief The system type. For known types, a k_system_type. Otherwise a user type. */
+    u16 type;
+    /** @brief A function pointer for the initialize routine. Required. */
+    PFN_system_initialize initialize;
+    /** @brief A function pointer for the shutdown routine. Required. */
+    PFN_system_shutdown shutdown;
+    /** @brief A function pointer for the update routine. Optional. */
+    PFN_system_update update;
+    /** @brief A pointer to the configuration for the system, passed to initialize. */
+    void* config;
+    /** @brief The number of entries in dependencies. */
+    u8 dependency_count;
+    /**
+     * @brief The types of the systems which must be initialized before this one. Those outside the
+     * group must already be registered.
+     */
+    u16 dependencies[K_SYSTEM_MAX_DEPENDENCIES];
+    /**
+     * @brief Indicates if the system creates GPU resources while initializing. These systems are
+     * initialized one at a time, on the thread GPU resources are created from.
+     */
+    b8 uses_gpu;
+} k_system_registration;
+
 /**
  * @brief Represents the known system types within
  * the engine core up to K_SYSTEM_TYPE_KNOWN_MAX.
@@ -70,6 +102,9 @@ typedef enum k_system_type {
     K_SYSTEM_TYPE_GEOMETRY,
     K_SYSTEM_TYPE_LIGHT,
     K_SYSTEM_TYPE_AUDIO,
+    K_SYSTEM_TYPE_KNAME,
+    K_SYSTEM_TYPE_PHYSICS,
+    K_SYSTEM_TYPE_NETWORK,
 
     // NOTE: Anything between 127-254 is extension space.
     K_SYSTEM_TYPE_KNOWN_MAX = 127,
@@ -93,6 +128,8 @@ typedef struct systems_manager_state {
     linear_allocator systems_allocator;
     /** @brief The registered systems array. */
     k_system systems[K_SYSTEM_TYPE_MAX_COUNT];
+    /** @brief The processors of the core kept for the render thread. None if it was not given one. */
+    kthread_affinity render_thread_affinity;
 } systems_manager_state;
 
 struct application_config;
@@ -152,4 +189,21 @@ KAPI b8 systems_manager_register(
     PFN_system_update update,
     void* config);
 
+/**
+ * @brief Registers a group of systems to be managed, initializing each one as soon as the systems
+ * it depends on have been. Systems which do not use the GPU are initialized on the job system,
+ * alongside one another and alongside those which do. If the job system is not yet running, all
+ * are initialized on the calling thread in order of their dependencies. Returns once every system
+ * in the group is initialized, or one has failed.
+ *
+ * NOTE: The first call of each initialize routine, which only reports the memory requirement, is
+ * always made on the calling thread, in the order given.
+ *
+ * @param state A pointer to the system manager state.
+ * @param count The number of systems in the group.
+ * @param registrations An array of count systems to be registered.
+ * @return True if every system was registered; otherwise false.
+ */
+KAPI b8 systems_manager_register_group(systems_manager_state* state, u32 count, const k_system_registration* registrations);
+
 KAPI void* systems_manager_get_state(u16 type);
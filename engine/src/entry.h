@@ -52,11 +52,15 @@ extern b8 initialize_application(application* app);
 
 /**
  * @brief The main entry point of the application.
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments, made available to the application.
  * @returns 0 on successful execution; nonzero on error.
  */
-int main(void) {
+int main(int argc, char** argv) {
     // Request the application instance from the application.
     application app_inst = {0};
+    app_inst.argc = argc;
+    app_inst.argv = argv;
     if (!create_application(&app_inst)) {
         KFATAL("Could not create application!");
         return -1;
@@ -0,0 +1,489 @@
+#include "bvh.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "geometry_3d.h"
+#include "kmath.h"
+
+// The number of bins the centroids are sorted into when searching for the best split.
+#define BVH_BUILD_BIN_COUNT 12
+
+// The depth of the traversal stack held on the stack itself. Deeper trees use an allocated one.
+#define BVH_LOCAL_STACK_SIZE 64
+
+// Set on traversal stack entries whose bounds are known to pass, so their leaves are taken as is.
+#define BVH_ACCEPT_ALL 0x80000000u
+
+typedef enum bvh_test_result {
+    BVH_TEST_OUTSIDE,
+    BVH_TEST_INTERSECTS,
+    BVH_TEST_INSIDE
+} bvh_test_result;
+
+typedef bvh_test_result (*PFN_bvh_classify)(const extents_3d* bounds, void* context);
+
+static extents_3d extents_union(extents_3d a, extents_3d b) {
+    extents_3d result;
+    result.min = (vec3){KMIN(a.min.x, b.min.x), KMIN(a.min.y, b.min.y), KMIN(a.min.z, b.min.z)};
+    result.max = (vec3){KMAX(a.max.x, b.max.x), KMAX(a.max.y, b.max.y), KMAX(a.max.z, b.max.z)};
+    return result;
+}
+
+// Half the surface area of the box, which is all the heuristic needs.
+static f32 extents_area(extents_3d e) {
+    f32 x = e.max.x - e.min.x;
+    f32 y = e.max.y - e.min.y;
+    f32 z = e.max.z - e.min.z;
+    return x * y + y * z + z * x;
+}
+
+static b8 extents_equal(extents_3d a, extents_3d b) {
+    return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+           a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+static u32 node_allocate(bvh* tree) {
+    u32 index;
+    if (tree->free_list != INVALID_ID) {
+        index = tree->free_list;
+        tree->free_list = tree->nodes[index].parent;
+    } else {
+        index = (u32)darray_length(tree->nodes);
+        bvh_node empty = {0};
+        darray_push(tree->nodes, empty);
+    }
+    bvh_node* node = &tree->nodes[index];
+    node->parent = INVALID_ID;
+    node->children[0] = INVALID_ID;
+    node->children[1] = INVALID_ID;
+    node->user_data = INVALID_ID;
+    node->height = 0;
+    return index;
+}
+
+static void node_release(bvh* tree, u32 index) {
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = INVALID_ID;
+    tree->free_list = index;
+}
+
+static b8 is_leaf(const bvh* tree, u32 index) {
+    return index < darray_length(tree->nodes) && tree->nodes[index].height == 0;
+}
+
+// Recomputes the bounds and height of each node from the given one up to the root.
+static void ancestors_update(bvh* tree, u32 index) {
+    while (index != INVALID_ID) {
+        bvh_node* node = &tree->nodes[index];
+        const bvh_node* left = &tree->nodes[node->children[0]];
+        const bvh_node* right = &tree->nodes[node->children[1]];
+        node->bounds = extents_union(left->bounds, right->bounds);
+        node->height = 1 + KMAX(left->height, right->height);
+        index = node->parent;
+    }
+}
+
+b8 bvh_create(bvh* out_bvh) {
+    if (!out_bvh) {
+        KERROR("bvh_create requires a valid pointer to hold the hierarchy.");
+        return false;
+    }
+    out_bvh->nodes = darray_create(bvh_node);
+    out_bvh->root = INVALID_ID;
+    out_bvh->free_list = INVALID_ID;
+    out_bvh->leaf_count = 0;
+    return true;
+}
+
+void bvh_destroy(bvh* tree) {
+    if (!tree || !tree->nodes) {
+        return;
+    }
+    darray_destroy(tree->nodes);
+    kzero_memory(tree, sizeof(bvh));
+    tree->root = INVALID_ID;
+    tree->free_list = INVALID_ID;
+}
+
+void bvh_clear(bvh* tree) {
+    if (!tree || !tree->nodes) {
+        return;
+    }
+    darray_clear(tree->nodes);
+    tree->root = INVALID_ID;
+    tree->free_list = INVALID_ID;
+    tree->leaf_count = 0;
+}
+
+typedef struct bvh_build_context {
+    bvh* tree;
+    const extents_3d* bounds;
+    const u32* user_data;
+    u32* out_leaves;
+    // The centroid of each item.
+    vec3* centroids;
+    // The indices of the items, partitioned in place as the tree is built.
+    u32* items;
+} bvh_build_context;
+
+typedef struct bvh_build_bin {
+    extents_3d bounds;
+    u32 count;
+} bvh_build_bin;
+
+// Builds the subtree over items [start, end), returning the index of its root.
+static u32 build_range(bvh_build_context* context, u32 start, u32 end) {
+    bvh* tree = context->tree;
+    u32 count = end - start;
+    u32 index = node_allocate(tree);
+
+    if (count == 1) {
+        u32 item = context->items[start];
+        bvh_node* leaf = &tree->nodes[index];
+        leaf->bounds = context->bounds[item];
+        leaf->user_data = context->user_data ? context->user_data[item] : item;
+        if (context->out_leaves) {
+            context->out_leaves[item] = index;
+        }
+        return index;
+    }
+
+    // The split is chosen along the axes of the bounds of the centroids, rather than of the
+    // items themselves, so that each bin actually receives items.
+    vec3 centroid_min = context->centroids[context->items[start]];
+    vec3 centroid_max = centroid_min;
+    for (u32 i = start + 1; i < end; ++i) {
+        vec3 c = context->centroids[context->items[i]];
+        centroid_min = (vec3){KMIN(centroid_min.x, c.x), KMIN(centroid_min.y, c.y), KMIN(centroid_min.z, c.z)};
+        centroid_max = (vec3){KMAX(centroid_max.x, c.x), KMAX(centroid_max.y, c.y), KMAX(centroid_max.z, c.z)};
+    }
+
+    // Find the split, over all axes, which minimizes the sum of the area of each side
+    // weighted by the number of items in it.
+    f32 best_cost = K_INFINITY;
+    u32 best_axis = INVALID_ID;
+    u32 best_split = 0;
+    for (u32 axis = 0; axis < 3; ++axis) {
+        f32 axis_min = centroid_min.elements[axis];
+        f32 axis_extent = centroid_max.elements[axis] - axis_min;
+        if (axis_extent <= 0.0f) {
+            continue;
+        }
+        f32 scale = BVH_BUILD_BIN_COUNT / axis_extent;
+
+        bvh_build_bin bins[BVH_BUILD_BIN_COUNT] = {0};
+        for (u32 i = start; i < end; ++i) {
+            u32 item = context->items[i];
+            u32 bin = (u32)((context->centroids[item].elements[axis] - axis_min) * scale);
+            bin = KMIN(bin, BVH_BUILD_BIN_COUNT - 1);
+            bins[bin].bounds = bins[bin].count ? extents_union(bins[bin].bounds, context->bounds[item]) : context->bounds[item];
+            bins[bin].count++;
+        }
+
+        // Sweep from the right to obtain the cost of everything after each split, then from the
+        // left to complete it.
+        f32 right_costs[BVH_BUILD_BIN_COUNT] = {0};
+        extents_3d accumulated = {0};
+        u32 accumulated_count = 0;
+        for (u32 b = BVH_BUILD_BIN_COUNT - 1; b > 0; --b) {
+            if (bins[b].count) {
+                accumulated = accumulated_count ? extents_union(accumulated, bins[b].bounds) : bins[b].bounds;
+                accumulated_count += bins[b].count;
+            }
+            right_costs[b] = accumulated_count ? accumulated_count * extents_area(accumulated) : 0.0f;
+        }
+        accumulated_count = 0;
+        for (u32 split = 1; split < BVH_BUILD_BIN_COUNT; ++split) {
+            const bvh_build_bin* bin = &bins[split - 1];
+            if (bin->count) {
+                accumulated = accumulated_count ? extents_union(accumulated, bin->bounds) : bin->bounds;
+                accumulated_count += bin->count;
+            }
+            if (!accumulated_count || accumulated_count == count) {
+                continue;
+            }
+            f32 cost = accumulated_count * extents_area(accumulated) + right_costs[split];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    u32 middle = start + count / 2;
+    if (best_axis != INVALID_ID) {
+        // Partition the items into those before the split and those after.
+        f32 axis_min = centroid_min.elements[best_axis];
+        f32 scale = BVH_BUILD_BIN_COUNT / (centroid_max.elements[best_axis] - axis_min);
+        u32 left = start;
+        u32 right = end;
+        while (left < right) {
+            u32 item = context->items[left];
+            u32 bin = (u32)((context->centroids[item].elements[best_axis] - axis_min) * scale);
+            if (KMIN(bin, BVH_BUILD_BIN_COUNT - 1) < best_split) {
+                left++;
+            } else {
+                right--;
+                KSWAP(u32, context->items[left], context->items[right]);
+            }
+        }
+        if (left != start && left != end) {
+            middle = left;
+        }
+    }
+    // NOTE: If all centroids coincide there is nothing to split on, so the items are just halved.
+
+    u32 left_child = build_range(context, start, middle);
+    u32 right_child = build_range(context, middle, end);
+    bvh_node* node = &tree->nodes[index];
+    node->children[0] = left_child;
+    node->children[1] = right_child;
+    tree->nodes[left_child].parent = index;
+    tree->nodes[right_child].parent = index;
+    node->bounds = extents_union(tree->nodes[left_child].bounds, tree->nodes[right_child].bounds);
+    node->height = 1 + KMAX(tree->nodes[left_child].height, tree->nodes[right_child].height);
+    return index;
+}
+
+b8 bvh_build(bvh* tree, u32 count, const extents_3d* bounds, const u32* user_data, u32* out_leaves) {
+    if (!tree || !tree->nodes || (count && !bounds)) {
+        KERROR("bvh_build requires a valid hierarchy and bounds.");
+        return false;
+    }
+
+    bvh_clear(tree);
+    if (!count) {
+        return true;
+    }
+
+    bvh_build_context context = {0};
+    context.tree = tree;
+    context.bounds = bounds;
+    context.user_data = user_data;
+    context.out_leaves = out_leaves;
+    context.centroids = kallocate(sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    context.items = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < count; ++i) {
+        context.centroids[i] = vec3_mul_scalar(vec3_add(bounds[i].min, bounds[i].max), 0.5f);
+        context.items[i] = i;
+    }
+
+    tree->root = build_range(&context, 0, count);
+    tree->leaf_count = count;
+
+    kfree(context.items, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kfree(context.centroids, sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u32 bvh_insert(bvh* tree, extents_3d bounds, u32 user_data) {
+    if (!tree || !tree->nodes) {
+        KERROR("bvh_insert requires a valid hierarchy.");
+        return INVALID_ID;
+    }
+
+    u32 leaf = node_allocate(tree);
+    tree->nodes[leaf].bounds = bounds;
+    tree->nodes[leaf].user_data = user_data;
+    tree->leaf_count++;
+    if (tree->root == INVALID_ID) {
+        tree->root = leaf;
+        return leaf;
+    }
+
+    // Descend towards the sibling which adds the least area. Pairing the leaf with a node costs
+    // the area of the new parent, plus the growth of every ancestor along the way.
+    u32 index = tree->root;
+    while (tree->nodes[index].height > 0) {
+        const bvh_node* node = &tree->nodes[index];
+        f32 area = extents_area(node->bounds);
+        f32 combined_area = extents_area(extents_union(node->bounds, bounds));
+        f32 cost = 2.0f * combined_area;
+        f32 inheritance_cost = 2.0f * (combined_area - area);
+
+        f32 child_costs[2];
+        for (u32 c = 0; c < 2; ++c) {
+            const bvh_node* child = &tree->nodes[node->children[c]];
+            f32 child_area = extents_area(extents_union(child->bounds, bounds));
+            if (child->height > 0) {
+                child_area -= extents_area(child->bounds);
+            }
+            child_costs[c] = child_area + inheritance_cost;
+        }
+        if (cost < child_costs[0] && cost < child_costs[1]) {
+            break;
+        }
+        index = child_costs[0] < child_costs[1] ? node->children[0] : node->children[1];
+    }
+
+    u32 sibling = index;
+    u32 old_parent = tree->nodes[sibling].parent;
+    u32 new_parent = node_allocate(tree);
+    bvh_node* parent = &tree->nodes[new_parent];
+    parent->parent = old_parent;
+    parent->children[0] = sibling;
+    parent->children[1] = leaf;
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+    if (old_parent == INVALID_ID) {
+        tree->root = new_parent;
+    } else {
+        bvh_node* grandparent = &tree->nodes[old_parent];
+        grandparent->children[grandparent->children[0] == sibling ? 0 : 1] = new_parent;
+    }
+    ancestors_update(tree, new_parent);
+    return leaf;
+}
+
+b8 bvh_remove(bvh* tree, u32 leaf) {
+    if (!tree || !tree->nodes || !is_leaf(tree, leaf)) {
+        KERROR("bvh_remove requires a valid hierarchy and leaf.");
+        return false;
+    }
+
+    tree->leaf_count--;
+    u32 parent = tree->nodes[leaf].parent;
+    node_release(tree, leaf);
+    if (parent == INVALID_ID) {
+        tree->root = INVALID_ID;
+        return true;
+    }
+
+    // The sibling takes the place of the parent.
+    const bvh_node* parent_node = &tree->nodes[parent];
+    u32 sibling = parent_node->children[0] == leaf ? parent_node->children[1] : parent_node->children[0];
+    u32 grandparent = parent_node->parent;
+    tree->nodes[sibling].parent = grandparent;
+    if (grandparent == INVALID_ID) {
+        tree->root = sibling;
+    } else {
+        bvh_node* grandparent_node = &tree->nodes[grandparent];
+        grandparent_node->children[grandparent_node->children[0] == parent ? 0 : 1] = sibling;
+    }
+    node_release(tree, parent);
+    ancestors_update(tree, grandparent);
+    return true;
+}
+
+b8 bvh_refit(bvh* tree, u32 leaf, extents_3d bounds) {
+    if (!tree || !tree->nodes || !is_leaf(tree, leaf)) {
+        KERROR("bvh_refit requires a valid hierarchy and leaf.");
+        return false;
+    }
+
+    tree->nodes[leaf].bounds = bounds;
+    // Ancestors past the first one left unchanged by this are unaffected too.
+    for (u32 index = tree->nodes[leaf].parent; index != INVALID_ID; index = tree->nodes[index].parent) {
+        bvh_node* node = &tree->nodes[index];
+        extents_3d refit = extents_union(tree->nodes[node->children[0]].bounds, tree->nodes[node->children[1]].bounds);
+        if (extents_equal(refit, node->bounds)) {
+            break;
+        }
+        node->bounds = refit;
+    }
+    return true;
+}
+
+// Visits the nodes whose bounds aren't classified as outside, and reports the leaves among them.
+// The descendants of a node classified as inside are reported without being tested.
+static void traverse(const bvh* tree, PFN_bvh_classify classify, void* classify_context, PFN_bvh_item_found callback, void* context) {
+    if (!tree || !tree->nodes || tree->root == INVALID_ID || !callback) {
+        return;
+    }
+
+    // Each node pushes at most two entries and pops its own, so the stack never holds more than
+    // the height of the tree plus one.
+    u32 local_stack[BVH_LOCAL_STACK_SIZE];
+    u32* stack = local_stack;
+    u32 stack_size = tree->nodes[tree->root].height + 2;
+    if (stack_size > BVH_LOCAL_STACK_SIZE) {
+        stack = kallocate(sizeof(u32) * stack_size, MEMORY_TAG_ARRAY);
+    }
+
+    u32 top = 0;
+    stack[top++] = tree->root;
+    while (top) {
+        u32 entry = stack[--top];
+        u32 index = entry & ~BVH_ACCEPT_ALL;
+        const bvh_node* node = &tree->nodes[index];
+        u32 accept_all = entry & BVH_ACCEPT_ALL;
+        if (!accept_all) {
+            bvh_test_result result = classify(&node->bounds, classify_context);
+            if (result == BVH_TEST_OUTSIDE) {
+                continue;
+            }
+            accept_all = result == BVH_TEST_INSIDE ? BVH_ACCEPT_ALL : 0;
+        }
+        if (node->height == 0) {
+            if (!callback(node->user_data, context)) {
+                break;
+            }
+        } else {
+            stack[top++] = node->children[0] | accept_all;
+            stack[top++] = node->children[1] | accept_all;
+        }
+    }
+
+    if (stack != local_stack) {
+        kfree(stack, sizeof(u32) * stack_size, MEMORY_TAG_ARRAY);
+    }
+}
+
+typedef struct bvh_test_context {
+    PFN_bvh_bounds_test test;
+    void* context;
+} bvh_test_context;
+
+static bvh_test_result test_classify(const extents_3d* bounds, void* context) {
+    bvh_test_context* test_context = context;
+    return test_context->test(bounds, test_context->context) ? BVH_TEST_INTERSECTS : BVH_TEST_OUTSIDE;
+}
+
+void bvh_query(const bvh* tree, PFN_bvh_bounds_test test, PFN_bvh_item_found callback, void* context) {
+    if (!test) {
+        return;
+    }
+    bvh_test_context test_context = {test, context};
+    traverse(tree, test_classify, &test_context, callback, context);
+}
+
+static bvh_test_result frustum_classify(const extents_3d* bounds, void* context) {
+    const frustum* f = context;
+    vec3 center = vec3_mul_scalar(vec3_add(bounds->min, bounds->max), 0.5f);
+    vec3 extents = vec3_mul_scalar(vec3_sub(bounds->max, bounds->min), 0.5f);
+    bvh_test_result result = BVH_TEST_INSIDE;
+    for (u32 i = 0; i < FRUSTUM_SIDE_COUNT; ++i) {
+        const plane_3d* p = &f->sides[i];
+        // Matches plane_intersects_aabb, which this must agree with for leaves.
+        f32 r = extents.x * kabs(p->normal.x) + extents.y * kabs(p->normal.y) + extents.z * kabs(p->normal.z);
+        f32 distance = plane_signed_distance(p, &center);
+        if (distance < -r) {
+            return BVH_TEST_OUTSIDE;
+        }
+        if (distance < r) {
+            result = BVH_TEST_INTERSECTS;
+        }
+    }
+    return result;
+}
+
+void bvh_query_frustum(const bvh* tree, const frustum* f, PFN_bvh_item_found callback, void* context) {
+    if (!f) {
+        return;
+    }
+    traverse(tree, frustum_classify, (void*)f, callback, context);
+}
+
+static bvh_test_result ray_classify(const extents_3d* bounds, void* context) {
+    vec3 point;
+    return raycast_aabb(*bounds, context, &point) ? BVH_TEST_INTERSECTS : BVH_TEST_OUTSIDE;
+}
+
+void bvh_query_ray(const bvh* tree, const struct ray* r, PFN_bvh_item_found callback, void* context) {
+    if (!r) {
+        return;
+    }
+    traverse(tree, ray_classify, (void*)r, callback, context);
+}
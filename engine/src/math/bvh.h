@@ -0,0 +1,166 @@
+/**
+ * @file bvh.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A dynamic bounding volume hierarchy of axis-aligned boxes, used to speed up spatial
+ * queries (frustum culling, ray picking and the like) so they scale with the number of results
+ * rather than the number of objects.
+ *
+ * Each leaf holds the bounds of one item, identified by a caller-provided value. The tree is
+ * built top-down using the surface area heuristic (SAH), after which items may be inserted,
+ * removed or moved. Moving an item refits the bounds of its ancestors in place, which is cheap
+ * but lets the quality of the tree degrade over time; rebuilding it (e.g. once many items have
+ * changed) restores it.
+ * @version 1.0
+ * @date 2023-11-29
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "math_types.h"
+
+struct ray;
+
+/** @brief A single node of a bounding volume hierarchy. */
+typedef struct bvh_node {
+    /** @brief The bounds of the node, enclosing those of all of its children. */
+    extents_3d bounds;
+    /** @brief The index of the parent node, or INVALID_ID for the root. For an unused node, the index of the next unused node. */
+    u32 parent;
+    /** @brief The indices of the two children, or INVALID_ID for a leaf. */
+    u32 children[2];
+    /** @brief The caller-provided value of the item held by a leaf. */
+    u32 user_data;
+    /** @brief The height of the node above its deepest leaf. 0 for a leaf, INVALID_ID for an unused node. */
+    u32 height;
+} bvh_node;
+
+/** @brief A dynamic bounding volume hierarchy. */
+typedef struct bvh {
+    /** @brief darray of nodes. Indices remain valid until the node is released. */
+    bvh_node* nodes;
+    /** @brief The index of the root node, or INVALID_ID if the hierarchy is empty. */
+    u32 root;
+    /** @brief The index of the first unused node, or INVALID_ID if there are none. */
+    u32 free_list;
+    /** @brief The number of leaves, i.e. items, in the hierarchy. */
+    u32 leaf_count;
+} bvh;
+
+/**
+ * @brief A test applied to the bounds of each node visited by a query. Only the children of
+ * nodes which pass are visited.
+ *
+ * @param bounds A constant pointer to the bounds of the node.
+ * @param context The context passed to the query.
+ * @return True if the node's bounds pass the test; otherwise false.
+ */
+typedef b8 (*PFN_bvh_bounds_test)(const extents_3d* bounds, void* context);
+
+/**
+ * @brief Invoked for each item found by a query.
+ *
+ * @param user_data The value of the item, as provided when it was added.
+ * @param context The context passed to the query.
+ * @return True to continue the query; false to stop it.
+ */
+typedef b8 (*PFN_bvh_item_found)(u32 user_data, void* context);
+
+/**
+ * @brief Creates an empty bounding volume hierarchy.
+ *
+ * @param out_bvh A pointer to hold the created hierarchy.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 bvh_create(bvh* out_bvh);
+
+/**
+ * @brief Destroys the given hierarchy.
+ *
+ * @param tree A pointer to the hierarchy to be destroyed.
+ */
+KAPI void bvh_destroy(bvh* tree);
+
+/**
+ * @brief Removes all items from the given hierarchy.
+ *
+ * @param tree A pointer to the hierarchy.
+ */
+KAPI void bvh_clear(bvh* tree);
+
+/**
+ * @brief Replaces the contents of the hierarchy with the given items, building it top-down
+ * using the surface area heuristic. Produces a better tree than inserting the items one by one.
+ *
+ * @param tree A pointer to the hierarchy.
+ * @param count The number of items.
+ * @param bounds An array of count bounds, one per item.
+ * @param user_data An array of count values identifying the items. If 0, each item is identified by its index.
+ * @param out_leaves An optional array of count values, each to hold the leaf of the item at the same index. Pass 0 if not required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 bvh_build(bvh* tree, u32 count, const extents_3d* bounds, const u32* user_data, u32* out_leaves);
+
+/**
+ * @brief Inserts an item into the hierarchy, placed where it adds the least surface area.
+ *
+ * @param tree A pointer to the hierarchy.
+ * @param bounds The bounds of the item.
+ * @param user_data A value identifying the item, passed back by queries.
+ * @return The index of the leaf holding the item, used to move or remove it.
+ */
+KAPI u32 bvh_insert(bvh* tree, extents_3d bounds, u32 user_data);
+
+/**
+ * @brief Removes an item from the hierarchy.
+ *
+ * @param tree A pointer to the hierarchy.
+ * @param leaf The index of the leaf holding the item, as returned by bvh_insert or bvh_build.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 bvh_remove(bvh* tree, u32 leaf);
+
+/**
+ * @brief Sets the bounds of an item, refitting the bounds of its ancestors to match. The
+ * structure of the tree is left unchanged.
+ *
+ * @param tree A pointer to the hierarchy.
+ * @param leaf The index of the leaf holding the item, as returned by bvh_insert or bvh_build.
+ * @param bounds The new bounds of the item.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 bvh_refit(bvh* tree, u32 leaf, extents_3d bounds);
+
+/**
+ * @brief Finds the items whose bounds pass the given test, which is applied to each node
+ * visited. The test must pass for any node enclosing bounds which pass it.
+ *
+ * @param tree A constant pointer to the hierarchy.
+ * @param test The test applied to the bounds of each node.
+ * @param callback Invoked for each item found.
+ * @param context Passed to both the test and callback.
+ */
+KAPI void bvh_query(const bvh* tree, PFN_bvh_bounds_test test, PFN_bvh_item_found callback, void* context);
+
+/**
+ * @brief Finds the items whose bounds are intersected by or contained within the given
+ * frustum, as frustum_intersects_aabb determines.
+ *
+ * @param tree A constant pointer to the hierarchy.
+ * @param f A constant pointer to the frustum.
+ * @param callback Invoked for each item found.
+ * @param context Passed to the callback.
+ */
+KAPI void bvh_query_frustum(const bvh* tree, const frustum* f, PFN_bvh_item_found callback, void* context);
+
+/**
+ * @brief Finds the items whose bounds are hit by the given ray, as raycast_aabb determines.
+ *
+ * @param tree A constant pointer to the hierarchy.
+ * @param r A constant pointer to the ray.
+ * @param callback Invoked for each item found.
+ * @param context Passed to the callback.
+ */
+KAPI void bvh_query_ray(const bvh* tree, const struct ray* r, PFN_bvh_item_found callback, void* context);
@@ -1,5 +1,6 @@
 #include "geometry_utils.h"
 
+#include "containers/darray.h"
 #include "core/asserts.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
@@ -9,40 +10,67 @@
 #include "renderer/renderer_frontend.h"
 #include "resources/terrain.h"
 #include "systems/geometry_system.h"
+#include "systems/job_system.h"
 
-void geometry_generate_normals(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+// Describes where the attributes used by the utilities below lie within a vertex structure, so that
+// each is written once and shared by every vertex format.
+typedef struct vertex_layout {
+    u32 stride;
+    u32 position_offset;
+    u32 normal_offset;
+    u32 texcoord_offset;
+    u32 tangent_offset;
+    // The size of the tangent, which is either a vec3 or a vec4 (whose w is zeroed).
+    u32 tangent_size;
+} vertex_layout;
+
+static const vertex_layout vertex_3d_layout = {
+    sizeof(vertex_3d), offsetof(vertex_3d, position), offsetof(vertex_3d, normal), offsetof(vertex_3d, texcoord), offsetof(vertex_3d, tangent), sizeof(vec3)};
+static const vertex_layout terrain_vertex_layout = {
+    sizeof(terrain_vertex), offsetof(terrain_vertex, position), offsetof(terrain_vertex, normal), offsetof(terrain_vertex, texcoord), offsetof(terrain_vertex, tangent), sizeof(vec4)};
+
+#define VERTEX_ATTRIBUTE(type, layout, vertices, index, attribute) \
+    ((type *)((u8 *)(vertices) + (u64)(index) * (layout)->stride + (layout)->attribute##_offset))
+
+static void generate_normals(const vertex_layout *layout, void *vertices, u32 index_count, const u32 *indices) {
     for (u32 i = 0; i < index_count; i += 3) {
         u32 i0 = indices[i + 0];
         u32 i1 = indices[i + 1];
         u32 i2 = indices[i + 2];
 
-        vec3 edge1 = vec3_sub(vertices[i1].position, vertices[i0].position);
-        vec3 edge2 = vec3_sub(vertices[i2].position, vertices[i0].position);
+        vec3 p0 = *VERTEX_ATTRIBUTE(vec3, layout, vertices, i0, position);
+        vec3 edge1 = vec3_sub(*VERTEX_ATTRIBUTE(vec3, layout, vertices, i1, position), p0);
+        vec3 edge2 = vec3_sub(*VERTEX_ATTRIBUTE(vec3, layout, vertices, i2, position), p0);
 
         vec3 normal = vec3_normalized(vec3_cross(edge1, edge2));
 
         // NOTE: This just generates a face normal. Smoothing out should be done in
         // a separate pass if desired.
-        vertices[i0].normal = normal;
-        vertices[i1].normal = normal;
-        vertices[i2].normal = normal;
+        *VERTEX_ATTRIBUTE(vec3, layout, vertices, i0, normal) = normal;
+        *VERTEX_ATTRIBUTE(vec3, layout, vertices, i1, normal) = normal;
+        *VERTEX_ATTRIBUTE(vec3, layout, vertices, i2, normal) = normal;
     }
 }
 
-void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+static void generate_tangents(const vertex_layout *layout, void *vertices, u32 index_count, const u32 *indices) {
     for (u32 i = 0; i < index_count; i += 3) {
         u32 i0 = indices[i + 0];
         u32 i1 = indices[i + 1];
         u32 i2 = indices[i + 2];
 
-        vec3 edge1 = vec3_sub(vertices[i1].position, vertices[i0].position);
-        vec3 edge2 = vec3_sub(vertices[i2].position, vertices[i0].position);
+        vec3 p0 = *VERTEX_ATTRIBUTE(vec3, layout, vertices, i0, position);
+        vec3 edge1 = vec3_sub(*VERTEX_ATTRIBUTE(vec3, layout, vertices, i1, position), p0);
+        vec3 edge2 = vec3_sub(*VERTEX_ATTRIBUTE(vec3, layout, vertices, i2, position), p0);
 
-        f32 deltaU1 = vertices[i1].texcoord.x - vertices[i0].texcoord.x;
-        f32 deltaV1 = vertices[i1].texcoord.y - vertices[i0].texcoord.y;
+        vec2 uv0 = *VERTEX_ATTRIBUTE(vec2, layout, vertices, i0, texcoord);
+        vec2 uv1 = *VERTEX_ATTRIBUTE(vec2, layout, vertices, i1, texcoord);
+        vec2 uv2 = *VERTEX_ATTRIBUTE(vec2, layout, vertices, i2, texcoord);
 
-        f32 deltaU2 = vertices[i2].texcoord.x - vertices[i0].texcoord.x;
-        f32 deltaV2 = vertices[i2].texcoord.y - vertices[i0].texcoord.y;
+        f32 deltaU1 = uv1.x - uv0.x;
+        f32 deltaV1 = uv1.y - uv0.y;
+
+        f32 deltaU2 = uv2.x - uv0.x;
+        f32 deltaV2 = uv2.y - uv0.y;
 
         f32 dividend = (deltaU1 * deltaV2 - deltaU2 * deltaV1);
         f32 fc = 1.0f / dividend;
@@ -57,126 +85,149 @@ void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 index
         f32 tx = deltaV1, ty = deltaV2;
         f32 handedness = ((tx * sy - ty * sx) < 0.0f) ? -1.0f : 1.0f;
 
-        vec3 t4 = vec3_mul_scalar(tangent, handedness);
-        vertices[i0].tangent = t4;
-        vertices[i1].tangent = t4;
-        vertices[i2].tangent = t4;
+        vec4 t4 = vec4_from_vec3(vec3_mul_scalar(tangent, handedness), 0.0f);
+        kcopy_memory(VERTEX_ATTRIBUTE(vec4, layout, vertices, i0, tangent), &t4, layout->tangent_size);
+        kcopy_memory(VERTEX_ATTRIBUTE(vec4, layout, vertices, i1, tangent), &t4, layout->tangent_size);
+        kcopy_memory(VERTEX_ATTRIBUTE(vec4, layout, vertices, i2, tangent), &t4, layout->tangent_size);
     }
 }
 
-b8 vertex3d_equal(vertex_3d vert_0, vertex_3d vert_1) {
-    return vec3_compare(vert_0.position, vert_1.position, K_FLOAT_EPSILON) &&
-           vec3_compare(vert_0.normal, vert_1.normal, K_FLOAT_EPSILON) &&
-           vec2_compare(vert_0.texcoord, vert_1.texcoord, K_FLOAT_EPSILON) &&
-           vec4_compare(vert_0.colour, vert_1.colour, K_FLOAT_EPSILON) &&
-           vec3_compare(vert_0.tangent, vert_1.tangent, K_FLOAT_EPSILON);
+void geometry_generate_normals(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+    generate_normals(&vertex_3d_layout, vertices, index_count, indices);
 }
 
-void reassign_index(u32 index_count, u32 *indices, u32 from, u32 to) {
-    for (u32 i = 0; i < index_count; ++i) {
-        if (indices[i] == from) {
-            indices[i] = to;
-        } else if (indices[i] > from) {
-            // Pull in all indicies higher than 'from' by 1.
-            indices[i]--;
-        }
-    }
+void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+    generate_tangents(&vertex_3d_layout, vertices, index_count, indices);
 }
 
-void geometry_deduplicate_vertices(u32 vertex_count, vertex_3d *vertices,
-                                   u32 index_count, u32 *indices,
-                                   u32 *out_vertex_count,
-                                   vertex_3d **out_vertices) {
-    // Create new arrays for the collection to sit in.
-    vertex_3d *unique_verts =
-        kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
-    *out_vertex_count = 0;
+void terrain_geometry_generate_normals(u32 vertex_count, terrain_vertex *vertices, u32 index_count, u32 *indices) {
+    generate_normals(&terrain_vertex_layout, vertices, index_count, indices);
+}
 
-    u32 found_count = 0;
-    for (u32 v = 0; v < vertex_count; ++v) {
-        b8 found = false;
-        for (u32 u = 0; u < *out_vertex_count; ++u) {
-            if (vertex3d_equal(vertices[v], unique_verts[u])) {
-                // Reassign indices, do _not_ copy
-                reassign_index(index_count, indices, v - found_count, u);
-                found = true;
-                found_count++;
-                break;
-            }
-        }
+void terrain_geometry_generate_tangents(u32 vertex_count, terrain_vertex *vertices, u32 index_count, u32 *indices) {
+    generate_tangents(&terrain_vertex_layout, vertices, index_count, indices);
+}
 
-        if (!found) {
-            // Copy over to unique.
-            unique_verts[*out_vertex_count] = vertices[v];
-            (*out_vertex_count)++;
-        }
-    }
+// Vertex counts from which hashing and remapping are split across the job system.
+#define DEDUPLICATE_PARALLEL_THRESHOLD 65536
 
-    // Allocate new vertices array
-    *out_vertices =
-        kallocate(sizeof(vertex_3d) * (*out_vertex_count), MEMORY_TAG_ARRAY);
-    // Copy over unique
-    kcopy_memory(*out_vertices, unique_verts,
-                 sizeof(vertex_3d) * (*out_vertex_count));
-    // Destroy temp array
-    kfree(unique_verts, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+typedef struct deduplicate_job_data {
+    const vertex_layout *layout;
+    const void *vertices;
+    u32 *hashes;
+    u32 *indices;
+    const u32 *remap;
+} deduplicate_job_data;
 
-    KDEBUG("geometry_deduplicate_vertices: removed %d vertices, orig/now %d/%d.",
-           vertex_count - *out_vertex_count, vertex_count, *out_vertex_count);
+// Hashes the bits of every component of a vertex, treating -0 as 0 so that they match as they compare.
+static u32 vertex_hash(const vertex_layout *layout, const void *vertex) {
+    const f32 *components = vertex;
+    u32 hash = 2166136261u;
+    for (u32 c = 0; c < layout->stride / sizeof(f32); ++c) {
+        f32 value = components[c] == 0.0f ? 0.0f : components[c];
+        u32 bits;
+        kcopy_memory(&bits, &value, sizeof(u32));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
 }
 
-void terrain_geometry_generate_normals(u32 vertex_count, terrain_vertex *vertices, u32 index_count, u32 *indices) {
-    for (u32 i = 0; i < index_count; i += 3) {
-        u32 i0 = indices[i + 0];
-        u32 i1 = indices[i + 1];
-        u32 i2 = indices[i + 2];
-
-        vec3 edge1 = vec3_sub(vertices[i1].position, vertices[i0].position);
-        vec3 edge2 = vec3_sub(vertices[i2].position, vertices[i0].position);
+// Compares every component of two vertices within K_FLOAT_EPSILON.
+static b8 vertex_equal(const vertex_layout *layout, const void *vertex_0, const void *vertex_1) {
+    const f32 *components_0 = vertex_0;
+    const f32 *components_1 = vertex_1;
+    for (u32 c = 0; c < layout->stride / sizeof(f32); ++c) {
+        if (kabs(components_0[c] - components_1[c]) > K_FLOAT_EPSILON) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        vec3 normal = vec3_normalized(vec3_cross(edge1, edge2));
+static void deduplicate_hash_batch(u32 start, u32 end, void *user_data) {
+    deduplicate_job_data *data = user_data;
+    for (u32 v = start; v < end; ++v) {
+        data->hashes[v] = vertex_hash(data->layout, (const u8 *)data->vertices + (u64)v * data->layout->stride);
+    }
+}
 
-        // NOTE: This just generates a face normal. Smoothing out should be done in
-        // a separate pass if desired.
-        vertices[i0].normal = normal;
-        vertices[i1].normal = normal;
-        vertices[i2].normal = normal;
+static void deduplicate_remap_batch(u32 start, u32 end, void *user_data) {
+    deduplicate_job_data *data = user_data;
+    for (u32 i = start; i < end; ++i) {
+        data->indices[i] = data->remap[data->indices[i]];
     }
 }
 
-void terrain_geometry_generate_tangents(u32 vertex_count, terrain_vertex *vertices, u32 index_count, u32 *indices) {
-    for (u32 i = 0; i < index_count; i += 3) {
-        u32 i0 = indices[i + 0];
-        u32 i1 = indices[i + 1];
-        u32 i2 = indices[i + 2];
+// Keeps the first of each set of equal vertices, in their original order, and remaps the indices to
+// them. Equal vertices are found through a hash table of their exact values, so this is linear in the
+// number of vertices; vertices which differ only by rounding noise are kept apart. All components
+// of the vertex structure must be f32.
+static void deduplicate_vertices(const vertex_layout *layout, u32 vertex_count, const void *vertices, u32 index_count, u32 *indices, u32 *out_vertex_count, void **out_vertices) {
+    if (!vertex_count) {
+        *out_vertex_count = 0;
+        *out_vertices = 0;
+        return;
+    }
 
-        vec3 edge1 = vec3_sub(vertices[i1].position, vertices[i0].position);
-        vec3 edge2 = vec3_sub(vertices[i2].position, vertices[i0].position);
+    deduplicate_job_data data = {layout, vertices, 0, indices, 0};
+    data.hashes = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *remap = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    data.remap = remap;
+    u32 batch_size = vertex_count >= DEDUPLICATE_PARALLEL_THRESHOLD ? 0 : vertex_count;
+    job_parallel_for(vertex_count, batch_size, deduplicate_hash_batch, &data);
 
-        f32 deltaU1 = vertices[i1].texcoord.x - vertices[i0].texcoord.x;
-        f32 deltaV1 = vertices[i1].texcoord.y - vertices[i0].texcoord.y;
+    // Open addressing with linear probing, holding indices of unique vertices.
+    u32 capacity = 1;
+    while (capacity < vertex_count * 2) {
+        capacity <<= 1;
+    }
+    u32 *table = kallocate(sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < capacity; ++i) {
+        table[i] = INVALID_ID;
+    }
 
-        f32 deltaU2 = vertices[i2].texcoord.x - vertices[i0].texcoord.x;
-        f32 deltaV2 = vertices[i2].texcoord.y - vertices[i0].texcoord.y;
+    u8 *unique_verts = kallocate((u64)layout->stride * vertex_count, MEMORY_TAG_ARRAY);
+    u32 unique_count = 0;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        const u8 *vertex = (const u8 *)vertices + (u64)v * layout->stride;
+        for (u32 slot = data.hashes[v] & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+            u32 u = table[slot];
+            if (u == INVALID_ID) {
+                // Copy over to unique.
+                table[slot] = unique_count;
+                kcopy_memory(unique_verts + (u64)unique_count * layout->stride, vertex, layout->stride);
+                remap[v] = unique_count++;
+                break;
+            }
+            if (vertex_equal(layout, unique_verts + (u64)u * layout->stride, vertex)) {
+                remap[v] = u;
+                break;
+            }
+        }
+    }
+    kfree(table, sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
 
-        f32 dividend = (deltaU1 * deltaV2 - deltaU2 * deltaV1);
-        f32 fc = 1.0f / dividend;
+    batch_size = index_count >= DEDUPLICATE_PARALLEL_THRESHOLD ? 0 : index_count;
+    job_parallel_for(index_count, batch_size, deduplicate_remap_batch, &data);
 
-        vec3 tangent = (vec3){(fc * (deltaV2 * edge1.x - deltaV1 * edge2.x)),
-                              (fc * (deltaV2 * edge1.y - deltaV1 * edge2.y)),
-                              (fc * (deltaV2 * edge1.z - deltaV1 * edge2.z))};
+    // Allocate new vertices array, and copy over unique.
+    *out_vertex_count = unique_count;
+    *out_vertices = kallocate((u64)layout->stride * unique_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(*out_vertices, unique_verts, (u64)layout->stride * unique_count);
 
-        tangent = vec3_normalized(tangent);
+    kfree(unique_verts, (u64)layout->stride * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(data.hashes, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+}
 
-        f32 sx = deltaU1, sy = deltaU2;
-        f32 tx = deltaV1, ty = deltaV2;
-        f32 handedness = ((tx * sy - ty * sx) < 0.0f) ? -1.0f : 1.0f;
+void geometry_deduplicate_vertices(u32 vertex_count, vertex_3d *vertices,
+                                   u32 index_count, u32 *indices,
+                                   u32 *out_vertex_count,
+                                   vertex_3d **out_vertices) {
+    deduplicate_vertices(&vertex_3d_layout, vertex_count, vertices, index_count, indices, out_vertex_count, (void **)out_vertices);
 
-        vec4 t4 = vec4_from_vec3(vec3_mul_scalar(tangent, handedness), 0.0f);
-        vertices[i0].tangent = t4;
-        vertices[i1].tangent = t4;
-        vertices[i2].tangent = t4;
-    }
+    KDEBUG("geometry_deduplicate_vertices: removed %d vertices, orig/now %d/%d.",
+           vertex_count - *out_vertex_count, vertex_count, *out_vertex_count);
 }
 
 void generate_uvs_from_image_coords(u32 img_width, u32 img_height, u32 px_x, u32 px_y, f32 *out_tx, f32 *out_ty) {
@@ -522,3 +573,732 @@ b8 generate_nine_slice(const char *name, vec2i size, vec2i atlas_px_size, vec2i
 
     return true;
 }
+
+// The error quadric of a vertex: the area-weighted sum of the squared distances of a point from the planes
+// of the triangles around it, as the symmetric 4x4 matrix a00 a01 a02 a03 a11 a12 a13 a22 a23 a33, followed
+// by the total weight.
+typedef struct simplify_quadric {
+    f64 a[11];
+} simplify_quadric;
+
+typedef struct simplify_collapse {
+    u32 from;
+    u32 to;
+} simplify_collapse;
+
+static void simplify_quadric_add_plane(simplify_quadric *q, vec3 n, f32 d, f32 weight) {
+    f64 p[4] = {n.x, n.y, n.z, d};
+    u32 k = 0;
+    for (u32 r = 0; r < 4; ++r) {
+        for (u32 c = r; c < 4; ++c, ++k) {
+            q->a[k] += weight * p[r] * p[c];
+        }
+    }
+    q->a[10] += weight;
+}
+
+// Obtains the mean squared distance of the point from the planes of both quadrics.
+static f32 simplify_quadric_error(const simplify_quadric *q0, const simplify_quadric *q1, vec3 v) {
+    f64 a[11];
+    for (u32 k = 0; k < 11; ++k) {
+        a[k] = q0->a[k] + q1->a[k];
+    }
+    f64 x = v.x, y = v.y, z = v.z;
+    f64 error = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x +
+                a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+                a[7] * z * z + 2 * a[8] * z +
+                a[9];
+    return (f32)(error > 0 && a[10] > 0 ? error / a[10] : 0);
+}
+
+// Sorts the values by their keys, least first, 8 bits at a time.
+static void geometry_radix_sort(u32 count, u32 *keys, u32 *values, u32 *scratch_keys, u32 *scratch_values) {
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 offsets[256] = {0};
+        for (u32 i = 0; i < count; ++i) {
+            offsets[(keys[i] >> shift) & 0xFF]++;
+        }
+        for (u32 b = 0, total = 0; b < 256; ++b) {
+            u32 bucket_count = offsets[b];
+            offsets[b] = total;
+            total += bucket_count;
+        }
+        for (u32 i = 0; i < count; ++i) {
+            u32 slot = offsets[(keys[i] >> shift) & 0xFF]++;
+            scratch_keys[slot] = keys[i];
+            scratch_values[slot] = values[i];
+        }
+        KSWAP(u32 *, keys, scratch_keys);
+        KSWAP(u32 *, values, scratch_values);
+    }
+    // After an even number of passes, the sorted arrays are the originals again.
+}
+
+// Marks the vertices which share their position with another, i.e. those along seams in the texture
+// coordinates or normals. Collapsing them would tear the seam open.
+static void simplify_seams_find(u32 vertex_count, const vertex_3d *vertices, b8 *out_locked) {
+    u32 capacity = 1;
+    while (capacity < vertex_count * 2) {
+        capacity <<= 1;
+    }
+    u32 *table = kallocate(sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < capacity; ++i) {
+        table[i] = INVALID_ID;
+    }
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        const u32 *bits = (const u32 *)&vertices[v].position;
+        u32 hash = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        for (u32 slot = hash & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+            if (table[slot] == INVALID_ID) {
+                table[slot] = v;
+                break;
+            }
+            if (vec3_compare(vertices[table[slot]].position, vertices[v].position, 0.0f)) {
+                out_locked[table[slot]] = true;
+                out_locked[v] = true;
+                break;
+            }
+        }
+    }
+
+    kfree(table, sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+}
+
+u32 geometry_simplify(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, u32 target_index_count, f32 max_error, u32 *out_indices, f32 *out_error) {
+    kcopy_memory(out_indices, indices, sizeof(u32) * index_count);
+    if (out_error) {
+        *out_error = 0;
+    }
+    if (index_count <= target_index_count || !vertex_count) {
+        return index_count;
+    }
+
+    u32 triangle_capacity = index_count / 3;
+    simplify_quadric *quadrics = kallocate(sizeof(simplify_quadric) * vertex_count, MEMORY_TAG_ARRAY);
+    b8 *locked = kallocate(sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    b8 *touched = kallocate(sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *remap = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *offsets = kallocate(sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    u32 *vertex_triangles = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    u32 candidate_capacity = index_count * 2;
+    simplify_collapse *candidates = kallocate(sizeof(simplify_collapse) * candidate_capacity, MEMORY_TAG_ARRAY);
+    u32 *keys = kallocate(sizeof(u32) * candidate_capacity * 4, MEMORY_TAG_ARRAY);
+    u32 *order = keys + candidate_capacity;
+    u32 *scratch_keys = order + candidate_capacity;
+    u32 *scratch_order = scratch_keys + candidate_capacity;
+
+    // Each vertex starts with the quadric of the planes of the triangles around it.
+    for (u32 i = 0; i < index_count; i += 3) {
+        vec3 p0 = vertices[indices[i + 0]].position;
+        vec3 p1 = vertices[indices[i + 1]].position;
+        vec3 p2 = vertices[indices[i + 2]].position;
+        vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+        if (vec3_length_squared(n) == 0.0f) {
+            continue;
+        }
+        f32 area = vec3_length(n) * 0.5f;
+        n = vec3_normalized(n);
+        f32 d = -vec3_dot(n, p0);
+        for (u32 k = 0; k < 3; ++k) {
+            simplify_quadric_add_plane(&quadrics[indices[i + k]], n, d, area);
+        }
+    }
+    simplify_seams_find(vertex_count, vertices, locked);
+
+    f32 max_error_squared = max_error * max_error;
+    f32 result_error_squared = 0;
+    u32 count = index_count;
+    while (count > target_index_count) {
+        // Find the triangles around each vertex.
+        kzero_memory(offsets, sizeof(u32) * (vertex_count + 1));
+        for (u32 i = 0; i < count; ++i) {
+            offsets[out_indices[i] + 1]++;
+        }
+        for (u32 v = 0; v < vertex_count; ++v) {
+            offsets[v + 1] += offsets[v];
+        }
+        for (u32 i = 0; i < count; ++i) {
+            vertex_triangles[offsets[out_indices[i]]++] = i / 3;
+        }
+        for (u32 v = vertex_count; v > 0; --v) {
+            offsets[v] = offsets[v - 1];
+        }
+        offsets[0] = 0;
+
+        // A vertex on an open border has a neighbour shared by only one of its triangles. Moving
+        // such a vertex would pull in the edge of the mesh, so it is locked too.
+        for (u32 v = 0; v < vertex_count; ++v) {
+            if (locked[v]) {
+                continue;
+            }
+            for (u32 t = offsets[v]; t < offsets[v + 1] && !locked[v]; ++t) {
+                const u32 *tri = &out_indices[vertex_triangles[t] * 3];
+                for (u32 k = 0; k < 3 && !locked[v]; ++k) {
+                    u32 neighbour = tri[k];
+                    if (neighbour == v) {
+                        continue;
+                    }
+                    u32 shared = 0;
+                    for (u32 s = offsets[v]; s < offsets[v + 1]; ++s) {
+                        const u32 *other = &out_indices[vertex_triangles[s] * 3];
+                        shared += (other[0] == neighbour || other[1] == neighbour || other[2] == neighbour);
+                    }
+                    locked[v] = shared < 2;
+                }
+            }
+        }
+
+        // Gather every collapse of a vertex onto a neighbour, ordered by the error it would introduce.
+        u32 candidate_count = 0;
+        for (u32 i = 0; i < count; i += 3) {
+            for (u32 k = 0; k < 3; ++k) {
+                u32 ends[2] = {out_indices[i + k], out_indices[i + (k + 1) % 3]};
+                for (u32 dir = 0; dir < 2; ++dir) {
+                    u32 a = ends[dir];
+                    u32 b = ends[1 - dir];
+                    if (locked[a]) {
+                        continue;
+                    }
+                    f32 cost = simplify_quadric_error(&quadrics[a], &quadrics[b], vertices[b].position);
+                    candidates[candidate_count] = (simplify_collapse){a, b};
+                    // Non-negative floats order the same as their bits.
+                    kcopy_memory(&keys[candidate_count], &cost, sizeof(u32));
+                    order[candidate_count] = candidate_count;
+                    candidate_count++;
+                }
+            }
+        }
+        geometry_radix_sort(candidate_count, keys, order, scratch_keys, scratch_order);
+
+        // Apply the cheapest collapses, at most one per neighbourhood so that each is tested against
+        // the triangles as they are.
+        for (u32 v = 0; v < vertex_count; ++v) {
+            remap[v] = v;
+        }
+        kzero_memory(touched, sizeof(b8) * vertex_count);
+        u32 collapse_count = 0;
+        u32 remaining = count;
+        for (u32 c = 0; c < candidate_count && remaining > target_index_count; ++c) {
+            f32 cost;
+            kcopy_memory(&cost, &keys[c], sizeof(f32));
+            if (cost > max_error_squared) {
+                break;
+            }
+            simplify_collapse collapse = candidates[order[c]];
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            // Reject the collapse if it would flip, or turn sharply, any of the remaining triangles around the vertex.
+            b8 flips = false;
+            u32 removed = 0;
+            for (u32 t = offsets[collapse.from]; t < offsets[collapse.from + 1] && !flips; ++t) {
+                const u32 *tri = &out_indices[vertex_triangles[t] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    removed++;
+                    continue;
+                }
+                vec3 p[3];
+                vec3 moved[3];
+                for (u32 k = 0; k < 3; ++k) {
+                    p[k] = vertices[tri[k]].position;
+                    moved[k] = tri[k] == collapse.from ? vertices[collapse.to].position : p[k];
+                }
+                vec3 before = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+                vec3 after = vec3_cross(vec3_sub(moved[1], moved[0]), vec3_sub(moved[2], moved[0]));
+                f32 before_length = vec3_length(before);
+                f32 after_length = vec3_length(after);
+                flips = vec3_dot(before, after) <= 0.25f * before_length * after_length;
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            for (u32 k = 0; k < 11; ++k) {
+                quadrics[collapse.to].a[k] += quadrics[collapse.from].a[k];
+            }
+            for (u32 t = offsets[collapse.from]; t < offsets[collapse.from + 1]; ++t) {
+                const u32 *tri = &out_indices[vertex_triangles[t] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+            result_error_squared = KMAX(result_error_squared, cost);
+            remaining -= removed * 3;
+            collapse_count++;
+        }
+        if (!collapse_count) {
+            break;
+        }
+
+        // Remap the indices, dropping the triangles which collapsed.
+        u32 new_count = 0;
+        for (u32 i = 0; i < count; i += 3) {
+            u32 i0 = remap[out_indices[i + 0]];
+            u32 i1 = remap[out_indices[i + 1]];
+            u32 i2 = remap[out_indices[i + 2]];
+            if (i0 != i1 && i1 != i2 && i0 != i2) {
+                out_indices[new_count++] = i0;
+                out_indices[new_count++] = i1;
+                out_indices[new_count++] = i2;
+            }
+        }
+        count = new_count;
+    }
+
+    kfree(keys, sizeof(u32) * candidate_capacity * 4, MEMORY_TAG_ARRAY);
+    kfree(candidates, sizeof(simplify_collapse) * candidate_capacity, MEMORY_TAG_ARRAY);
+    kfree(vertex_triangles, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(offsets, sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(touched, sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(locked, sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(quadrics, sizeof(simplify_quadric) * vertex_count, MEMORY_TAG_ARRAY);
+
+    if (out_error) {
+        *out_error = ksqrt(result_error_squared);
+    }
+    KDEBUG("geometry_simplify: reduced %u triangles to %u (target %u).", triangle_capacity, count / 3, target_index_count / 3);
+    return count;
+}
+
+// A run of triangles emitted by the vertex cache optimization, kept together when sorting for overdraw.
+typedef struct optimize_cluster {
+    u32 start;
+    u32 count;
+    f32 sort_key;
+} optimize_cluster;
+
+// Sorts the clusters so that those facing away from the center of the geometry, which tend to hide the
+// others, are drawn first. Each cluster keeps the order of its triangles, and so its cache efficiency.
+static void optimize_clusters_sort(const vertex_3d *vertices, u32 index_count, u32 *indices, u32 cluster_count, optimize_cluster *clusters) {
+    vec3 center = vec3_zero();
+    f32 total_area = 0;
+    for (u32 i = 0; i < index_count; i += 3) {
+        vec3 p0 = vertices[indices[i + 0]].position;
+        vec3 p1 = vertices[indices[i + 1]].position;
+        vec3 p2 = vertices[indices[i + 2]].position;
+        f32 area = vec3_length(vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0)));
+        center = vec3_add(center, vec3_mul_scalar(vec3_add(vec3_add(p0, p1), p2), area / 3.0f));
+        total_area += area;
+    }
+    if (total_area <= 0) {
+        return;
+    }
+    center = vec3_div_scalar(center, total_area);
+
+    for (u32 c = 0; c < cluster_count; ++c) {
+        vec3 cluster_center = vec3_zero();
+        vec3 cluster_normal = vec3_zero();
+        f32 cluster_area = 0;
+        for (u32 i = clusters[c].start; i < clusters[c].start + clusters[c].count; i += 3) {
+            vec3 p0 = vertices[indices[i + 0]].position;
+            vec3 p1 = vertices[indices[i + 1]].position;
+            vec3 p2 = vertices[indices[i + 2]].position;
+            vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+            f32 area = vec3_length(n);
+            cluster_center = vec3_add(cluster_center, vec3_mul_scalar(vec3_add(vec3_add(p0, p1), p2), area / 3.0f));
+            cluster_normal = vec3_add(cluster_normal, n);
+            cluster_area += area;
+        }
+        clusters[c].sort_key = 0;
+        if (cluster_area > 0 && vec3_length_squared(cluster_normal) > 0) {
+            cluster_center = vec3_div_scalar(cluster_center, cluster_area);
+            clusters[c].sort_key = vec3_dot(vec3_sub(cluster_center, center), vec3_normalized(cluster_normal));
+        }
+    }
+
+    // Sort outward-facing clusters first. Flipping the bits of a float this way makes its bits order
+    // the same as its value, and inverting them again orders the greatest first.
+    u32 *keys = kallocate(sizeof(u32) * cluster_count * 4, MEMORY_TAG_ARRAY);
+    u32 *order = keys + cluster_count;
+    for (u32 c = 0; c < cluster_count; ++c) {
+        u32 bits;
+        kcopy_memory(&bits, &clusters[c].sort_key, sizeof(u32));
+        keys[c] = ~(bits & 0x80000000u ? ~bits : bits | 0x80000000u);
+        order[c] = c;
+    }
+    geometry_radix_sort(cluster_count, keys, order, order + cluster_count, order + cluster_count * 2);
+
+    u32 *sorted = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    for (u32 c = 0, i = 0; c < cluster_count; ++c) {
+        const optimize_cluster *cluster = &clusters[order[c]];
+        kcopy_memory(&sorted[i], &indices[cluster->start], sizeof(u32) * cluster->count);
+        i += cluster->count;
+    }
+    kcopy_memory(indices, sorted, sizeof(u32) * index_count);
+    kfree(sorted, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(keys, sizeof(u32) * cluster_count * 4, MEMORY_TAG_ARRAY);
+}
+
+void geometry_optimize_vertex_cache(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, b8 reduce_overdraw) {
+    u32 triangle_count = index_count / 3;
+    if (!triangle_count || !vertex_count) {
+        return;
+    }
+
+    // The triangles using each vertex, and how many of them are yet to be emitted.
+    u32 *offsets = kallocate(sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    u32 *live_counts = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *vertex_triangles = kallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        live_counts[indices[i]]++;
+    }
+    for (u32 v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live_counts[v];
+    }
+    u32 *cursors = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(cursors, offsets, sizeof(u32) * vertex_count);
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        vertex_triangles[cursors[indices[i]]++] = i / 3;
+    }
+
+    // The time each vertex last entered the cache, the vertices of recently emitted triangles (a
+    // stack to resume from at dead ends) and the candidates for the next fanning vertex.
+    u32 *cache_times = cursors;
+    kzero_memory(cache_times, sizeof(u32) * vertex_count);
+    u32 *dead_ends = kallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    u32 dead_end_count = 0;
+    u32 *candidates = kallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    b8 *emitted = kallocate(sizeof(b8) * triangle_count, MEMORY_TAG_ARRAY);
+    u32 *output = kallocate(sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    optimize_cluster *clusters = kallocate(sizeof(optimize_cluster) * triangle_count, MEMORY_TAG_ARRAY);
+    u32 cluster_count = 0;
+
+    // Tipsify (Sander et al., 2007), which fans out from one vertex at a time, choosing next whichever
+    // neighbour will stay longest in a cache of this many vertices.
+    const u32 cache_size = 16;
+    u32 time = cache_size + 1;
+    u32 output_count = 0;
+    u32 scan = 0;
+    u32 fanning = 0;
+    while (fanning != INVALID_ID) {
+        u32 candidate_count = 0;
+        for (u32 t = offsets[fanning]; t < offsets[fanning + 1]; ++t) {
+            u32 triangle = vertex_triangles[t];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (u32 k = 0; k < 3; ++k) {
+                u32 v = indices[triangle * 3 + k];
+                output[output_count++] = v;
+                dead_ends[dead_end_count++] = v;
+                candidates[candidate_count++] = v;
+                live_counts[v]--;
+                if (time - cache_times[v] > cache_size) {
+                    cache_times[v] = time++;
+                }
+            }
+        }
+
+        // Prefer the candidate which will remain in the cache for all of its remaining triangles, and
+        // of those, the one which entered it earliest.
+        u32 next = INVALID_ID;
+        i32 best_priority = -1;
+        for (u32 c = 0; c < candidate_count; ++c) {
+            u32 v = candidates[c];
+            if (!live_counts[v]) {
+                continue;
+            }
+            i32 priority = 0;
+            if (time - cache_times[v] + 2 * live_counts[v] <= cache_size) {
+                priority = (i32)(time - cache_times[v]);
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        // At a dead end, resume from a recently used vertex or, failing that, the next unfinished one.
+        // Either starts a new cluster.
+        if (next == INVALID_ID) {
+            while (dead_end_count && next == INVALID_ID) {
+                u32 v = dead_ends[--dead_end_count];
+                next = live_counts[v] ? v : INVALID_ID;
+            }
+            while (next == INVALID_ID && scan < vertex_count) {
+                next = live_counts[scan] ? scan : INVALID_ID;
+                scan++;
+            }
+            u32 cluster_start = cluster_count ? clusters[cluster_count - 1].start + clusters[cluster_count - 1].count : 0;
+            if (output_count > cluster_start) {
+                clusters[cluster_count++] = (optimize_cluster){cluster_start, output_count - cluster_start, 0};
+            }
+        }
+        fanning = next;
+    }
+    kcopy_memory(indices, output, sizeof(u32) * triangle_count * 3);
+
+    if (reduce_overdraw && vertices && cluster_count > 1) {
+        optimize_clusters_sort(vertices, triangle_count * 3, indices, cluster_count, clusters);
+    }
+
+    kfree(clusters, sizeof(optimize_cluster) * triangle_count, MEMORY_TAG_ARRAY);
+    kfree(output, sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    kfree(emitted, sizeof(b8) * triangle_count, MEMORY_TAG_ARRAY);
+    kfree(candidates, sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    kfree(dead_ends, sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    kfree(cursors, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(vertex_triangles, sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+    kfree(live_counts, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(offsets, sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+}
+
+void geometry_optimize_vertex_fetch(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+    if (!vertex_count) {
+        return;
+    }
+
+    // Number the vertices in the order the indices first use them. Unused vertices go last.
+    u32 *remap = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    for (u32 v = 0; v < vertex_count; ++v) {
+        remap[v] = INVALID_ID;
+    }
+    u32 next = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        if (remap[indices[i]] == INVALID_ID) {
+            remap[indices[i]] = next++;
+        }
+        indices[i] = remap[indices[i]];
+    }
+    for (u32 v = 0; v < vertex_count; ++v) {
+        if (remap[v] == INVALID_ID) {
+            remap[v] = next++;
+        }
+    }
+
+    vertex_3d *reordered = kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    for (u32 v = 0; v < vertex_count; ++v) {
+        reordered[remap[v]] = vertices[v];
+    }
+    kcopy_memory(vertices, reordered, sizeof(vertex_3d) * vertex_count);
+
+    kfree(reordered, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+}
+
+// Fills in the bounds and normal cone of a cluster from its triangles.
+static void cluster_bounds_compute(const vertex_3d *vertices, const u32 *indices, geometry_cluster *cluster) {
+    const u32 *cluster_indices = &indices[cluster->index_offset];
+    vec3 min = vertices[cluster_indices[0]].position;
+    vec3 max = min;
+    for (u32 i = 1; i < cluster->index_count; ++i) {
+        vec3 p = vertices[cluster_indices[i]].position;
+        min = vec3_create(KMIN(min.x, p.x), KMIN(min.y, p.y), KMIN(min.z, p.z));
+        max = vec3_create(KMAX(max.x, p.x), KMAX(max.y, p.y), KMAX(max.z, p.z));
+    }
+    cluster->center = vec3_mul_scalar(vec3_add(min, max), 0.5f);
+    cluster->radius = 0;
+    for (u32 i = 0; i < cluster->index_count; ++i) {
+        cluster->radius = KMAX(cluster->radius, vec3_distance(vertices[cluster_indices[i]].position, cluster->center));
+    }
+
+    // The axis is the average facing of the triangles, and the cone just wide enough to hold every one.
+    vec3 normal_sum = vec3_zero();
+    for (u32 i = 0; i < cluster->index_count; i += 3) {
+        vec3 p0 = vertices[cluster_indices[i]].position;
+        vec3 normal = vec3_cross(vec3_sub(vertices[cluster_indices[i + 1]].position, p0), vec3_sub(vertices[cluster_indices[i + 2]].position, p0));
+        f32 length = vec3_length(normal);
+        if (length > K_FLOAT_EPSILON) {
+            normal_sum = vec3_add(normal_sum, vec3_div_scalar(normal, length));
+        }
+    }
+    f32 sum_length = vec3_length(normal_sum);
+    cluster->cone_axis = sum_length > K_FLOAT_EPSILON ? vec3_div_scalar(normal_sum, sum_length) : vec3_zero();
+    cluster->cone_cutoff = 1.0f;
+    if (sum_length <= K_FLOAT_EPSILON) {
+        return;
+    }
+    f32 min_dot = 1.0f;
+    for (u32 i = 0; i < cluster->index_count; i += 3) {
+        vec3 p0 = vertices[cluster_indices[i]].position;
+        vec3 normal = vec3_cross(vec3_sub(vertices[cluster_indices[i + 1]].position, p0), vec3_sub(vertices[cluster_indices[i + 2]].position, p0));
+        f32 length = vec3_length(normal);
+        if (length > K_FLOAT_EPSILON) {
+            min_dot = KMIN(min_dot, vec3_dot(cluster->cone_axis, normal) / length);
+        }
+    }
+    // Clusters facing about a hemisphere or more could only be culled from a few points, so they never are.
+    if (min_dot > 0.1f) {
+        cluster->cone_cutoff = ksqrt(1.0f - min_dot * min_dot);
+    }
+}
+
+u32 geometry_build_clusters(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, geometry_cluster **out_clusters) {
+    *out_clusters = 0;
+    u32 triangle_count = index_count / 3;
+    if (!vertex_count || !triangle_count) {
+        return 0;
+    }
+
+    // The cluster which last used each vertex, so those already in the current cluster aren't counted again.
+    u32 *last_cluster = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    for (u32 v = 0; v < vertex_count; ++v) {
+        last_cluster[v] = INVALID_ID;
+    }
+
+    geometry_cluster *clusters = darray_create(geometry_cluster);
+    geometry_cluster current = {0};
+    u32 current_vertex_count = 0;
+    for (u32 t = 0; t < triangle_count; ++t) {
+        const u32 *tri = &indices[t * 3];
+        u32 cluster_id = darray_length(clusters);
+        u32 new_count = (last_cluster[tri[0]] != cluster_id) +
+                        (last_cluster[tri[1]] != cluster_id && tri[1] != tri[0]) +
+                        (last_cluster[tri[2]] != cluster_id && tri[2] != tri[0] && tri[2] != tri[1]);
+        if (current.index_count == GEOMETRY_CLUSTER_MAX_TRIANGLES * 3 || current_vertex_count + new_count > GEOMETRY_CLUSTER_MAX_VERTICES) {
+            // Close the current cluster and start another with this triangle, whose vertices are all new to it.
+            cluster_bounds_compute(vertices, indices, &current);
+            darray_push(clusters, current);
+            cluster_id++;
+            current = (geometry_cluster){0};
+            current.index_offset = t * 3;
+            current_vertex_count = 0;
+            new_count = 1 + (tri[1] != tri[0]) + (tri[2] != tri[0] && tri[2] != tri[1]);
+        }
+        last_cluster[tri[0]] = cluster_id;
+        last_cluster[tri[1]] = cluster_id;
+        last_cluster[tri[2]] = cluster_id;
+        current_vertex_count += new_count;
+        current.index_count += 3;
+    }
+    cluster_bounds_compute(vertices, indices, &current);
+    darray_push(clusters, current);
+    kfree(last_cluster, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+
+    u32 cluster_count = darray_length(clusters);
+    *out_clusters = kallocate(sizeof(geometry_cluster) * cluster_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(*out_clusters, clusters, sizeof(geometry_cluster) * cluster_count);
+    darray_destroy(clusters);
+    return cluster_count;
+}
+
+// Texture coordinates are only packed within this range, where half floats keep them within about
+// a thousandth of their actual value.
+#define PACKED_TEXCOORD_LIMIT 2.0f
+
+static u16 f32_to_f16(f32 value) {
+    union {
+        f32 f;
+        u32 u;
+    } bits = {value};
+    u16 sign = (u16)((bits.u >> 16) & 0x8000);
+    u32 magnitude = bits.u & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+        // Infinity or NaN.
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+    }
+    if (magnitude >= 0x477FF000) {
+        // Rounds to more than the largest half, 65504.
+        return sign | 0x7C00;
+    }
+    if (magnitude < 0x38800000) {
+        // Below the smallest normal half, 2^-14, so stored in steps of 2^-24.
+        bits.u = magnitude;
+        return sign | (u16)(bits.f * 16777216.0f + 0.5f);
+    }
+    // Rebias the exponent and round the mantissa to 10 bits. A carry correctly bumps the exponent.
+    return sign | (u16)((magnitude - 0x38000000 + 0x1000) >> 13);
+}
+
+static f32 f16_to_f32(u16 value) {
+    u32 sign = (u32)(value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1F;
+    u32 mantissa = value & 0x3FF;
+    if (exponent == 0) {
+        f32 magnitude = mantissa / 16777216.0f;
+        return sign ? -magnitude : magnitude;
+    }
+    union {
+        u32 u;
+        f32 f;
+    } bits;
+    bits.u = sign | (exponent == 31 ? 0x7F800000 : (exponent + 112) << 23) | (mantissa << 13);
+    return bits.f;
+}
+
+// Converts a value in [-1, 1] to a signed normalized integer whose largest value is max, rounding to nearest.
+static i32 snorm_from_f32(f32 value, f32 max) {
+    value = KCLAMP(value, -1.0f, 1.0f) * max;
+    return (i32)(value >= 0.0f ? value + 0.5f : value - 0.5f);
+}
+
+b8 geometry_pack_vertices(u32 vertex_count, const vertex_3d *vertices, vertex_3d_packed *out_vertices, vec3 *out_center, f32 *out_scale) {
+    if (!vertex_count || !vertices || !out_vertices || !out_center || !out_scale) {
+        return false;
+    }
+
+    // The box the positions are stored in, with the same size along each axis so that scaling out of it
+    // doesn't change the direction of normals.
+    vec3 min = vertices[0].position;
+    vec3 max = vertices[0].position;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        const vertex_3d *vertex = &vertices[v];
+        for (u32 c = 0; c < 3; ++c) {
+            min.elements[c] = KMIN(min.elements[c], vertex->position.elements[c]);
+            max.elements[c] = KMAX(max.elements[c], vertex->position.elements[c]);
+        }
+        for (u32 c = 0; c < 2; ++c) {
+            // Written so that NaN also fails.
+            if (!(kabs(vertex->texcoord.elements[c]) <= PACKED_TEXCOORD_LIMIT)) {
+                return false;
+            }
+        }
+    }
+    vec3 center = vec3_mul_scalar(vec3_add(min, max), 0.5f);
+    f32 scale = KMAX(KMAX(max.x - min.x, max.y - min.y), max.z - min.z) * 0.5f;
+    if (!(scale > 0.0f)) {
+        scale = 1.0f;
+    }
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        const vertex_3d *vertex = &vertices[v];
+        vertex_3d_packed *packed = &out_vertices[v];
+        for (u32 c = 0; c < 3; ++c) {
+            packed->position[c] = (i16)snorm_from_f32((vertex->position.elements[c] - center.elements[c]) / scale, 32767.0f);
+            packed->normal[c] = (i8)snorm_from_f32(vertex->normal.elements[c], 127.0f);
+            packed->tangent[c] = (i8)snorm_from_f32(vertex->tangent.elements[c], 127.0f);
+        }
+        packed->position[3] = 0;
+        packed->normal[3] = 0;
+        packed->tangent[3] = 0;
+        packed->texcoord[0] = f32_to_f16(vertex->texcoord.x);
+        packed->texcoord[1] = f32_to_f16(vertex->texcoord.y);
+        for (u32 c = 0; c < 4; ++c) {
+            packed->colour[c] = (u8)(KCLAMP(vertex->colour.elements[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+
+    *out_center = center;
+    *out_scale = scale;
+    return true;
+}
+
+void geometry_unpack_vertices(u32 vertex_count, const vertex_3d_packed *vertices, vec3 center, f32 scale, vertex_3d *out_vertices) {
+    for (u32 v = 0; v < vertex_count; ++v) {
+        const vertex_3d_packed *packed = &vertices[v];
+        vertex_3d *vertex = &out_vertices[v];
+        // Unpacked the way the GPU reads normalized integers.
+        for (u32 c = 0; c < 3; ++c) {
+            vertex->position.elements[c] = center.elements[c] + KMAX(packed->position[c] / 32767.0f, -1.0f) * scale;
+            vertex->normal.elements[c] = KMAX(packed->normal[c] / 127.0f, -1.0f);
+            vertex->tangent.elements[c] = KMAX(packed->tangent[c] / 127.0f, -1.0f);
+        }
+        vertex->texcoord.x = f16_to_f32(packed->texcoord[0]);
+        vertex->texcoord.y = f16_to_f32(packed->texcoord[1]);
+        for (u32 c = 0; c < 4; ++c) {
+            vertex->colour.elements[c] = packed->colour[c] / 255.0f;
+        }
+    }
+}
+
+mat4 geometry_quantized_model_get(const geometry *g, mat4 model) {
+    if (!g || g->vertex_format != GEOMETRY_VERTEX_FORMAT_PACKED) {
+        return model;
+    }
+    // Scale out of the quantization box and move to its center, then apply the model.
+    mat4 dequantization = mat4_mul(mat4_scale((vec3){g->quantization_scale, g->quantization_scale, g->quantization_scale}), mat4_translation(g->quantization_center));
+    return mat4_mul(dequantization, model);
+}
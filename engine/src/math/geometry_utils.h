@@ -3,6 +3,7 @@
 #include "math_types.h"
 
 struct geometry;
+struct geometry_cluster;
 typedef struct nine_slice {
     struct geometry *g;
     // Actual corner w/h
@@ -54,6 +55,105 @@ KAPI void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32
  */
 KAPI void geometry_deduplicate_vertices(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices, u32 *out_vertex_count, vertex_3d **out_vertices);
 
+/**
+ * @brief Simplifies the given triangles towards the target index count by
+ * collapsing edges in order of least quadric error. Collapses move a vertex onto
+ * a neighbour, so the result uses a subset of the original vertices and can share
+ * their buffer. Vertices along open borders, or sharing their position with
+ * another (i.e. seams), are never moved.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices An array of vertices. Not modified.
+ * @param index_count The number of indices.
+ * @param indices The array of indices to be simplified. Not modified.
+ * @param target_index_count The number of indices to stop at, if reached.
+ * @param max_error The largest error any collapse may introduce, as a distance in the units of the vertex positions.
+ * @param out_indices An array of index_count indices to hold the simplified indices.
+ * @param out_error A pointer to hold the largest error introduced. Optional.
+ * @return The number of simplified indices.
+ */
+KAPI u32 geometry_simplify(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, u32 target_index_count, f32 max_error, u32 *out_indices, f32 *out_error);
+
+/**
+ * @brief Reorders triangles so that their vertices are more often found in the
+ * GPU's post-transform vertex cache, using Tipsify. The winding of each triangle
+ * is kept. Optionally, runs of triangles are then sorted so that those facing
+ * outwards are drawn first, which reduces overdraw without undoing much of the
+ * cache efficiency. Modifies indices in place.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices An array of vertices. Only required to reduce overdraw.
+ * @param index_count The number of indices.
+ * @param indices The array of indices to be reordered.
+ * @param reduce_overdraw If true, also sorts runs of triangles to reduce overdraw.
+ */
+KAPI void geometry_optimize_vertex_cache(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, b8 reduce_overdraw);
+
+/**
+ * @brief Reorders vertices into the order in which the indices first use them,
+ * so that vertex fetches walk through memory. Vertices not used by any index are
+ * moved to the end. Modifies vertices and indices in place.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices The array of vertices to be reordered.
+ * @param index_count The number of indices.
+ * @param indices The array of indices, remapped to the new vertex order.
+ */
+KAPI void geometry_optimize_vertex_fetch(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices);
+
+/**
+ * @brief Splits the given triangles into clusters of at most GEOMETRY_CLUSTER_MAX_VERTICES
+ * vertices and GEOMETRY_CLUSTER_MAX_TRIANGLES triangles, each with the bounding sphere and normal
+ * cone needed to cull it on its own. Triangles are taken in the order given, which should already
+ * be optimized for the vertex cache so that nearby triangles are found together. The indices are
+ * not modified, so the clusters are consecutive runs of them.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices The array of vertices.
+ * @param index_count The number of indices.
+ * @param indices The array of indices.
+ * @param out_clusters A pointer to hold an array of the clusters, allocated with MEMORY_TAG_ARRAY. 0 if there are none.
+ * @return The number of clusters.
+ */
+KAPI u32 geometry_build_clusters(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, struct geometry_cluster **out_clusters);
+
+/**
+ * @brief Packs the given vertices into vertex_3d_packed, for use with GEOMETRY_VERTEX_FORMAT_PACKED.
+ * Positions are stored relative to a cube enclosing them, given by out_center and out_scale. Fails
+ * if the texture coordinates lie too far outside [0, 1] to be held as half floats without losing
+ * noticeable precision, in which case the vertices should be kept as they are.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices The array of vertices to be packed.
+ * @param out_vertices An array of vertex_count packed vertices, to be written.
+ * @param out_center A pointer to hold the center of the cube.
+ * @param out_scale A pointer to hold half the size of the cube.
+ * @return True if the vertices were packed; otherwise false.
+ */
+KAPI b8 geometry_pack_vertices(u32 vertex_count, const vertex_3d *vertices, vertex_3d_packed *out_vertices, vec3 *out_center, f32 *out_scale);
+
+/**
+ * @brief Unpacks vertices packed by geometry_pack_vertices, as the GPU reads them.
+ *
+ * @param vertex_count The number of vertices.
+ * @param vertices The array of packed vertices.
+ * @param center The center of the cube the positions are stored relative to.
+ * @param scale Half the size of that cube.
+ * @param out_vertices An array of vertex_count vertices, to be written.
+ */
+KAPI void geometry_unpack_vertices(u32 vertex_count, const vertex_3d_packed *vertices, vec3 center, f32 scale, vertex_3d *out_vertices);
+
+/**
+ * @brief Obtains the matrix which transforms the vertex positions stored by the given geometry as
+ * the given model matrix transforms its actual ones. For packed vertices, this includes scaling out
+ * of the geometry's quantization box; otherwise, it is the model matrix itself.
+ *
+ * @param g A constant pointer to the geometry.
+ * @param model The model matrix of the geometry.
+ * @return The matrix to be used in place of the model matrix when drawing the geometry.
+ */
+KAPI mat4 geometry_quantized_model_get(const struct geometry *g, mat4 model);
+
 struct terrain_vertex;
 
 KAPI void terrain_geometry_generate_normals(u32 vertex_count, struct terrain_vertex *vertices, u32 index_count, u32 *indices);
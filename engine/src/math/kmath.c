@@ -8,32 +8,6 @@
 
 static b8 rand_seeded = false;
 
-/**
- * Note that these are here in order to prevent having to import the
- * entire <math.h> everywhere.
- */
-f32 ksin(f32 x) { return sinf(x); }
-
-f32 kcos(f32 x) { return cosf(x); }
-
-f32 ktan(f32 x) { return tanf(x); }
-
-f32 katan(f32 x) { return atanf(x); }
-
-f32 kacos(f32 x) { return acosf(x); }
-
-f32 ksqrt(f32 x) { return sqrtf(x); }
-
-f32 kabs(f32 x) { return fabsf(x); }
-
-f32 kfloor(f32 x) { return floorf(x); }
-
-f32 kceil(f32 x) { return ceilf(x); }
-
-f32 klog2(f32 x) { return log2f(x); }
-
-f32 kpow(f32 x, f32 y) { return powf(x, y); }
-
 i32 krandom(void) {
     if (!rand_seeded) {
         srand((u32)platform_get_absolute_time());
@@ -163,6 +137,203 @@ b8 frustum_intersects_aabb(const frustum *f, const vec3 *center, const vec3 *ext
     return true;
 }
 
+void vec3_mul_mat4_batch(u32 count, const vec3_soa *points, mat4 m, vec3_soa *out_points) {
+    u32 i = 0;
+#if KSIMD_ENABLED
+    // Each element of the matrix scales the same element of every point.
+    ksimd_f32x4 m0 = ksimd_set1(m.data[0]), m1 = ksimd_set1(m.data[1]), m2 = ksimd_set1(m.data[2]);
+    ksimd_f32x4 m4 = ksimd_set1(m.data[4]), m5 = ksimd_set1(m.data[5]), m6 = ksimd_set1(m.data[6]);
+    ksimd_f32x4 m8 = ksimd_set1(m.data[8]), m9 = ksimd_set1(m.data[9]), m10 = ksimd_set1(m.data[10]);
+    ksimd_f32x4 m12 = ksimd_set1(m.data[12]), m13 = ksimd_set1(m.data[13]), m14 = ksimd_set1(m.data[14]);
+    for (; i + 4 <= count; i += 4) {
+        ksimd_f32x4 x = ksimd_load(points->x + i);
+        ksimd_f32x4 y = ksimd_load(points->y + i);
+        ksimd_f32x4 z = ksimd_load(points->z + i);
+        ksimd_store(out_points->x + i, ksimd_madd(x, m0, ksimd_madd(y, m4, ksimd_madd(z, m8, m12))));
+        ksimd_store(out_points->y + i, ksimd_madd(x, m1, ksimd_madd(y, m5, ksimd_madd(z, m9, m13))));
+        ksimd_store(out_points->z + i, ksimd_madd(x, m2, ksimd_madd(y, m6, ksimd_madd(z, m10, m14))));
+    }
+#endif
+    for (; i < count; ++i) {
+        vec3 p = vec3_mul_mat4((vec3){points->x[i], points->y[i], points->z[i]}, m);
+        out_points->x[i] = p.x;
+        out_points->y[i] = p.y;
+        out_points->z[i] = p.z;
+    }
+}
+
+void aabb_transform_batch(u32 count, const mat4 *models, const aabb_soa *bounds, aabb_soa *out_bounds) {
+    u32 i = 0;
+#if KSIMD_ENABLED
+    for (; i + 4 <= count; i += 4) {
+        // Gather the matrices so that lane j of m[r][c] holds element (r, c) of the matrix of box i + j.
+        ksimd_f32x4 m[4][4];
+        for (u32 r = 0; r < 4; ++r) {
+            m[r][0] = ksimd_load(models[i + 0].data + r * 4);
+            m[r][1] = ksimd_load(models[i + 1].data + r * 4);
+            m[r][2] = ksimd_load(models[i + 2].data + r * 4);
+            m[r][3] = ksimd_load(models[i + 3].data + r * 4);
+            ksimd_transpose(m[r][0], m[r][1], m[r][2], m[r][3]);
+        }
+
+        ksimd_f32x4 cx = ksimd_load(bounds->center.x + i);
+        ksimd_f32x4 cy = ksimd_load(bounds->center.y + i);
+        ksimd_f32x4 cz = ksimd_load(bounds->center.z + i);
+        ksimd_f32x4 ex = ksimd_load(bounds->extents.x + i);
+        ksimd_f32x4 ey = ksimd_load(bounds->extents.y + i);
+        ksimd_f32x4 ez = ksimd_load(bounds->extents.z + i);
+        f32 *out_centers[3] = {out_bounds->center.x, out_bounds->center.y, out_bounds->center.z};
+        f32 *out_extents[3] = {out_bounds->extents.x, out_bounds->extents.y, out_bounds->extents.z};
+        for (u32 c = 0; c < 3; ++c) {
+            // The center transforms as a point. The extents are projected onto each axis through the
+            // absolute values of the matrix, which encloses the box however it is rotated.
+            ksimd_f32x4 center = ksimd_madd(cx, m[0][c], m[3][c]);
+            center = ksimd_madd(cy, m[1][c], center);
+            ksimd_store(out_centers[c] + i, ksimd_madd(cz, m[2][c], center));
+            ksimd_f32x4 extents = ksimd_mul(ex, ksimd_abs(m[0][c]));
+            extents = ksimd_madd(ey, ksimd_abs(m[1][c]), extents);
+            ksimd_store(out_extents[c] + i, ksimd_madd(ez, ksimd_abs(m[2][c]), extents));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const f32 *m = models[i].data;
+        f32 cx = bounds->center.x[i], cy = bounds->center.y[i], cz = bounds->center.z[i];
+        f32 ex = bounds->extents.x[i], ey = bounds->extents.y[i], ez = bounds->extents.z[i];
+        f32 *out_centers[3] = {out_bounds->center.x, out_bounds->center.y, out_bounds->center.z};
+        f32 *out_extents[3] = {out_bounds->extents.x, out_bounds->extents.y, out_bounds->extents.z};
+        for (u32 c = 0; c < 3; ++c) {
+            out_centers[c][i] = cx * m[c] + cy * m[4 + c] + cz * m[8 + c] + m[12 + c];
+            out_extents[c][i] = ex * kabs(m[c]) + ey * kabs(m[4 + c]) + ez * kabs(m[8 + c]);
+        }
+    }
+}
+
+void frustum_intersects_sphere_batch(const frustum *f, u32 count, const vec3_soa *centers, const f32 *radii, b8 *out_results) {
+    u32 i = 0;
+#if KSIMD_ENABLED
+    for (; i + 4 <= count; i += 4) {
+        ksimd_f32x4 cx = ksimd_load(centers->x + i);
+        ksimd_f32x4 cy = ksimd_load(centers->y + i);
+        ksimd_f32x4 cz = ksimd_load(centers->z + i);
+        ksimd_f32x4 radius = ksimd_load(radii + i);
+        // The smallest margin by which the spheres are on the inner side of each plane.
+        ksimd_f32x4 margin = ksimd_set1(K_INFINITY);
+        for (u32 s = 0; s < FRUSTUM_SIDE_COUNT; ++s) {
+            const plane_3d *p = &f->sides[s];
+            ksimd_f32x4 distance = ksimd_madd(cx, ksimd_set1(p->normal.x), ksimd_set1(-p->distance));
+            distance = ksimd_madd(cy, ksimd_set1(p->normal.y), distance);
+            distance = ksimd_madd(cz, ksimd_set1(p->normal.z), distance);
+            margin = ksimd_min(margin, ksimd_add(distance, radius));
+        }
+        f32 margins[4];
+        ksimd_store(margins, margin);
+        for (u32 j = 0; j < 4; ++j) {
+            out_results[i + j] = margins[j] > 0.0f;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        vec3 center = {centers->x[i], centers->y[i], centers->z[i]};
+        out_results[i] = frustum_intersects_sphere(f, &center, radii[i]);
+    }
+}
+
+void frustum_intersects_aabb_batch(const frustum *f, u32 count, const aabb_soa *bounds, b8 *out_results) {
+    u32 i = 0;
+#if KSIMD_ENABLED
+    for (; i + 4 <= count; i += 4) {
+        ksimd_f32x4 cx = ksimd_load(bounds->center.x + i);
+        ksimd_f32x4 cy = ksimd_load(bounds->center.y + i);
+        ksimd_f32x4 cz = ksimd_load(bounds->center.z + i);
+        ksimd_f32x4 ex = ksimd_load(bounds->extents.x + i);
+        ksimd_f32x4 ey = ksimd_load(bounds->extents.y + i);
+        ksimd_f32x4 ez = ksimd_load(bounds->extents.z + i);
+        // The smallest margin by which the boxes are on the inner side of each plane.
+        ksimd_f32x4 margin = ksimd_set1(K_INFINITY);
+        for (u32 s = 0; s < FRUSTUM_SIDE_COUNT; ++s) {
+            const plane_3d *p = &f->sides[s];
+            ksimd_f32x4 distance = ksimd_madd(cx, ksimd_set1(p->normal.x), ksimd_set1(-p->distance));
+            distance = ksimd_madd(cy, ksimd_set1(p->normal.y), distance);
+            distance = ksimd_madd(cz, ksimd_set1(p->normal.z), distance);
+            // The projection of the extents onto the plane normal.
+            ksimd_f32x4 r = ksimd_mul(ex, ksimd_set1(kabs(p->normal.x)));
+            r = ksimd_madd(ey, ksimd_set1(kabs(p->normal.y)), r);
+            r = ksimd_madd(ez, ksimd_set1(kabs(p->normal.z)), r);
+            margin = ksimd_min(margin, ksimd_add(distance, r));
+        }
+        f32 margins[4];
+        ksimd_store(margins, margin);
+        for (u32 j = 0; j < 4; ++j) {
+            out_results[i + j] = margins[j] >= 0.0f;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        vec3 center = {bounds->center.x[i], bounds->center.y[i], bounds->center.z[i]};
+        vec3 extents = {bounds->extents.x[i], bounds->extents.y[i], bounds->extents.z[i]};
+        out_results[i] = frustum_intersects_aabb(f, &center, &extents);
+    }
+}
+
+#if KSIMD_ENABLED
+// Applies the given lane-wise function to count values, including those past the last full
+// register, so that every value is computed the same way.
+#define KSIMD_APPLY_BATCH(fn, count, x, out_values)             \
+    do {                                                       \
+        u32 i = 0;                                             \
+        for (; i + 4 <= count; i += 4) {                       \
+            ksimd_store(out_values + i, fn(ksimd_load(x + i))); \
+        }                                                      \
+        if (i < count) {                                       \
+            f32 tail[4] = {1.0f, 1.0f, 1.0f, 1.0f};            \
+            kcopy_memory(tail, x + i, sizeof(f32) * (count - i)); \
+            ksimd_store(tail, fn(ksimd_load(tail)));           \
+            kcopy_memory(out_values + i, tail, sizeof(f32) * (count - i)); \
+        }                                                      \
+    } while (0)
+#endif
+
+void ksin_batch(u32 count, const f32 *x, f32 *out_values) {
+#if KSIMD_ENABLED
+    KSIMD_APPLY_BATCH(ksimd_sin, count, x, out_values);
+#else
+    for (u32 i = 0; i < count; ++i) {
+        out_values[i] = ksin(x[i]);
+    }
+#endif
+}
+
+void kcos_batch(u32 count, const f32 *x, f32 *out_values) {
+#if KSIMD_ENABLED
+    KSIMD_APPLY_BATCH(ksimd_cos, count, x, out_values);
+#else
+    for (u32 i = 0; i < count; ++i) {
+        out_values[i] = kcos(x[i]);
+    }
+#endif
+}
+
+void katan_batch(u32 count, const f32 *x, f32 *out_values) {
+#if KSIMD_ENABLED
+    KSIMD_APPLY_BATCH(ksimd_atan, count, x, out_values);
+#else
+    for (u32 i = 0; i < count; ++i) {
+        out_values[i] = katan(x[i]);
+    }
+#endif
+}
+
+void krsqrt_batch(u32 count, const f32 *x, f32 *out_values) {
+#if KSIMD_ENABLED
+    KSIMD_APPLY_BATCH(ksimd_rsqrt, count, x, out_values);
+#else
+    for (u32 i = 0; i < count; ++i) {
+        out_values[i] = 1.0f / ksqrt(x[i]);
+    }
+#endif
+}
+
 void frustum_corner_points_world_space(mat4 projection_view, vec4 *corners) {
     mat4 inverse_view_proj = mat4_inverse(projection_view);
 
@@ -15,6 +15,7 @@
 #include "core/kmemory.h"
 #include "defines.h"
 #include "math_types.h"
+#include "ksimd.h"
 
 /** @brief An approximate representation of PI. */
 #define K_PI 3.14159265358979323846f
@@ -107,13 +108,27 @@ KINLINE f32 kstep(f32 edge, f32 x) {
     return x < edge ? 0.0f : 1.0f;
 }
 
+/*
+ * The functions below are inline so that they compile down to instructions (e.g. sqrtss) or direct
+ * calls at each use, rather than calls across the library boundary. Compiler builtins are used
+ * where available so that <math.h> isn't included everywhere.
+ */
+#if defined(__clang__) || defined(__GNUC__)
+#define KMATH_LIBM(fn) __builtin_##fn
+#else
+#include <math.h>
+#define KMATH_LIBM(fn) fn
+#endif
+
 /**
  * @brief Calculates the sine of x.
  *
  * @param x The number to calculate the sine of.
  * @return The sine of x.
  */
-KAPI f32 ksin(f32 x);
+KINLINE f32 ksin(f32 x) {
+    return KMATH_LIBM(sinf)(x);
+}
 
 /**
  * @brief Calculates the cosine of x.
@@ -121,7 +136,9 @@ KAPI f32 ksin(f32 x);
  * @param x The number to calculate the cosine of.
  * @return The cosine of x.
  */
-KAPI f32 kcos(f32 x);
+KINLINE f32 kcos(f32 x) {
+    return KMATH_LIBM(cosf)(x);
+}
 
 /**
  * @brief Calculates the tangent of x.
@@ -129,7 +146,9 @@ KAPI f32 kcos(f32 x);
  * @param x The number to calculate the tangent of.
  * @return The tangent of x.
  */
-KAPI f32 ktan(f32 x);
+KINLINE f32 ktan(f32 x) {
+    return KMATH_LIBM(tanf)(x);
+}
 
 /**
  * @brief Calculates the arctangent of x.
@@ -137,7 +156,9 @@ KAPI f32 ktan(f32 x);
  * @param x The number to calculate the arctangent of.
  * @return The arctangent of x.
  */
-KAPI f32 katan(f32 x);
+KINLINE f32 katan(f32 x) {
+    return KMATH_LIBM(atanf)(x);
+}
 
 /**
  * @brief Calculates the arc cosine of x.
@@ -145,7 +166,9 @@ KAPI f32 katan(f32 x);
  * @param x The number to calculate the arc cosine of.
  * @return The arc cosine of x.
  */
-KAPI f32 kacos(f32 x);
+KINLINE f32 kacos(f32 x) {
+    return KMATH_LIBM(acosf)(x);
+}
 
 /**
  * @brief Calculates the square root of x.
@@ -153,7 +176,9 @@ KAPI f32 kacos(f32 x);
  * @param x The number to calculate the square root of.
  * @return The square root of x.
  */
-KAPI f32 ksqrt(f32 x);
+KINLINE f32 ksqrt(f32 x) {
+    return KMATH_LIBM(sqrtf)(x);
+}
 
 /**
  * @brief Calculates the absolute value of x.
@@ -161,7 +186,9 @@ KAPI f32 ksqrt(f32 x);
  * @param x The number to get the absolute value of.
  * @return The absolute value of x.
  */
-KAPI f32 kabs(f32 x);
+KINLINE f32 kabs(f32 x) {
+    return KMATH_LIBM(fabsf)(x);
+}
 
 /**
  * @brief Returns the largest integer value less than or equal to x.
@@ -169,7 +196,9 @@ KAPI f32 kabs(f32 x);
  * @param x The value to be examined.
  * @return the largest integer value less than or equal to x.
  */
-KAPI f32 kfloor(f32 x);
+KINLINE f32 kfloor(f32 x) {
+    return KMATH_LIBM(floorf)(x);
+}
 
 /**
  * @brief Returns the smallest integer value greater than or equal to x.
@@ -177,7 +206,9 @@ KAPI f32 kfloor(f32 x);
  * @param x The value to be examined.
  * @return the smallest integer value greater than or equal to x.
  */
-KAPI f32 kceil(f32 x);
+KINLINE f32 kceil(f32 x) {
+    return KMATH_LIBM(ceilf)(x);
+}
 
 /**
  * @brief Computes the base-2 logarithm of x (i.e. how many times x can be divided by 2).
@@ -185,9 +216,21 @@ KAPI f32 kceil(f32 x);
  * @param x The value to be examined.
  * @return The base-2 logarithm of x.
  */
-KAPI f32 klog2(f32 x);
+KINLINE f32 klog2(f32 x) {
+    return KMATH_LIBM(log2f)(x);
+}
+
+/**
+ * @brief Computes x raised to the power of y.
+ *
+ * @param x The base.
+ * @param y The exponent.
+ * @return x raised to the power of y.
+ */
+KINLINE f32 kpow(f32 x, f32 y) {
+    return KMATH_LIBM(powf)(x, y);
+}
 
-KAPI f32 kpow(f32 x, f32 y);
 /**
  * @brief Indicates if the value is a power of 2. 0 is considered _not_ a power
  * of 2.
@@ -851,9 +894,13 @@ KINLINE vec4 vec4_one(void) { return (vec4){1.0f, 1.0f, 1.0f, 1.0f}; }
  */
 KINLINE vec4 vec4_add(vec4 vector_0, vec4 vector_1) {
     vec4 result;
+#if KSIMD_ENABLED
+    ksimd_store(result.elements, ksimd_add(ksimd_load(vector_0.elements), ksimd_load(vector_1.elements)));
+#else
     for (u64 i = 0; i < 4; ++i) {
         result.elements[i] = vector_0.elements[i] + vector_1.elements[i];
     }
+#endif
     return result;
 }
 
@@ -866,9 +913,13 @@ KINLINE vec4 vec4_add(vec4 vector_0, vec4 vector_1) {
  */
 KINLINE vec4 vec4_sub(vec4 vector_0, vec4 vector_1) {
     vec4 result;
+#if KSIMD_ENABLED
+    ksimd_store(result.elements, ksimd_sub(ksimd_load(vector_0.elements), ksimd_load(vector_1.elements)));
+#else
     for (u64 i = 0; i < 4; ++i) {
         result.elements[i] = vector_0.elements[i] - vector_1.elements[i];
     }
+#endif
     return result;
 }
 
@@ -881,9 +932,13 @@ KINLINE vec4 vec4_sub(vec4 vector_0, vec4 vector_1) {
  */
 KINLINE vec4 vec4_mul(vec4 vector_0, vec4 vector_1) {
     vec4 result;
+#if KSIMD_ENABLED
+    ksimd_store(result.elements, ksimd_mul(ksimd_load(vector_0.elements), ksimd_load(vector_1.elements)));
+#else
     for (u64 i = 0; i < 4; ++i) {
         result.elements[i] = vector_0.elements[i] * vector_1.elements[i];
     }
+#endif
     return result;
 }
 
@@ -896,7 +951,13 @@ KINLINE vec4 vec4_mul(vec4 vector_0, vec4 vector_1) {
  * @return A copy of the resulting vector.
  */
 KINLINE vec4 vec4_mul_scalar(vec4 vector_0, f32 scalar) {
+#if KSIMD_ENABLED
+    vec4 result;
+    ksimd_store(result.elements, ksimd_mul(ksimd_load(vector_0.elements), ksimd_set1(scalar)));
+    return result;
+#else
     return (vec4){vector_0.x * scalar, vector_0.y * scalar, vector_0.z * scalar, vector_0.w * scalar};
+#endif
 }
 
 /**
@@ -908,12 +969,18 @@ KINLINE vec4 vec4_mul_scalar(vec4 vector_0, f32 scalar) {
  * @return The resulting vector.
  */
 KINLINE vec4 vec4_mul_add(vec4 vector_0, vec4 vector_1, vec4 vector_2) {
+#if KSIMD_ENABLED
+    vec4 result;
+    ksimd_store(result.elements, ksimd_madd(ksimd_load(vector_0.elements), ksimd_load(vector_1.elements), ksimd_load(vector_2.elements)));
+    return result;
+#else
     return (vec4){
         vector_0.x * vector_1.x + vector_2.x,
         vector_0.y * vector_1.y + vector_2.y,
         vector_0.z * vector_1.z + vector_2.z,
         vector_0.w * vector_1.w + vector_2.w,
     };
+#endif
 }
 
 /**
@@ -925,17 +992,25 @@ KINLINE vec4 vec4_mul_add(vec4 vector_0, vec4 vector_1, vec4 vector_2) {
  */
 KINLINE vec4 vec4_div(vec4 vector_0, vec4 vector_1) {
     vec4 result;
+#if KSIMD_ENABLED
+    ksimd_store(result.elements, ksimd_div(ksimd_load(vector_0.elements), ksimd_load(vector_1.elements)));
+#else
     for (u64 i = 0; i < 4; ++i) {
         result.elements[i] = vector_0.elements[i] / vector_1.elements[i];
     }
+#endif
     return result;
 }
 
 KINLINE vec4 vec4_div_scalar(vec4 vector_0, f32 scalar) {
     vec4 result;
+#if KSIMD_ENABLED
+    ksimd_store(result.elements, ksimd_div(ksimd_load(vector_0.elements), ksimd_set1(scalar)));
+#else
     for (u64 i = 0; i < 4; ++i) {
         result.elements[i] = vector_0.elements[i] / scalar;
     }
+#endif
     return result;
 }
 
@@ -946,8 +1021,13 @@ KINLINE vec4 vec4_div_scalar(vec4 vector_0, f32 scalar) {
  * @return The squared length.
  */
 KINLINE f32 vec4_length_squared(vec4 vector) {
+#if KSIMD_ENABLED
+    ksimd_f32x4 v = ksimd_load(vector.elements);
+    return ksimd_dot(v, v);
+#else
     return vector.x * vector.x + vector.y * vector.y + vector.z * vector.z +
            vector.w * vector.w;
+#endif
 }
 
 /**
@@ -967,10 +1047,14 @@ KINLINE f32 vec4_length(vec4 vector) {
  */
 KINLINE void vec4_normalize(vec4 *vector) {
     const f32 length = vec4_length(*vector);
+#if KSIMD_ENABLED
+    ksimd_store(vector->elements, ksimd_div(ksimd_load(vector->elements), ksimd_set1(length)));
+#else
     vector->x /= length;
     vector->y /= length;
     vector->z /= length;
     vector->w /= length;
+#endif
 }
 
 /**
@@ -1065,6 +1149,18 @@ KINLINE mat4 mat4_identity(void) {
  * @return The result of the matrix multiplication.
  */
 KINLINE mat4 mat4_mul(mat4 matrix_0, mat4 matrix_1) {
+#if KSIMD_ENABLED
+    // Each row of the result is the rows of matrix_1 weighted by the same row of matrix_0.
+    mat4 out_matrix;
+    ksimd_f32x4 r0 = ksimd_load(matrix_1.data + 0);
+    ksimd_f32x4 r1 = ksimd_load(matrix_1.data + 4);
+    ksimd_f32x4 r2 = ksimd_load(matrix_1.data + 8);
+    ksimd_f32x4 r3 = ksimd_load(matrix_1.data + 12);
+    for (i32 i = 0; i < 16; i += 4) {
+        ksimd_store(out_matrix.data + i, ksimd_combine(ksimd_load(matrix_0.data + i), r0, r1, r2, r3));
+    }
+    return out_matrix;
+#else
     mat4 out_matrix = mat4_identity();
 
     const f32 *m1_ptr = matrix_0.data;
@@ -1080,6 +1176,7 @@ KINLINE mat4 mat4_mul(mat4 matrix_0, mat4 matrix_1) {
         m1_ptr += 4;
     }
     return out_matrix;
+#endif
 }
 
 /**
@@ -1205,6 +1302,19 @@ KINLINE mat4 mat4_look_at(vec3 position, vec3 target, vec3 up) {
  * @return A transposed copy of of the provided matrix.
  */
 KINLINE mat4 mat4_transposed(mat4 matrix) {
+#if KSIMD_ENABLED
+    mat4 out_matrix;
+    ksimd_f32x4 r0 = ksimd_load(matrix.data + 0);
+    ksimd_f32x4 r1 = ksimd_load(matrix.data + 4);
+    ksimd_f32x4 r2 = ksimd_load(matrix.data + 8);
+    ksimd_f32x4 r3 = ksimd_load(matrix.data + 12);
+    ksimd_transpose(r0, r1, r2, r3);
+    ksimd_store(out_matrix.data + 0, r0);
+    ksimd_store(out_matrix.data + 4, r1);
+    ksimd_store(out_matrix.data + 8, r2);
+    ksimd_store(out_matrix.data + 12, r3);
+    return out_matrix;
+#else
     mat4 out_matrix = mat4_identity();
     out_matrix.data[0] = matrix.data[0];
     out_matrix.data[1] = matrix.data[4];
@@ -1223,6 +1333,7 @@ KINLINE mat4 mat4_transposed(mat4 matrix) {
     out_matrix.data[14] = matrix.data[11];
     out_matrix.data[15] = matrix.data[15];
     return out_matrix;
+#endif
 }
 
 /**
@@ -1270,6 +1381,54 @@ KINLINE f32 mat4_determinant(mat4 matrix) {
  * @return A inverted copy of the provided matrix.
  */
 KINLINE mat4 mat4_inverse(mat4 matrix) {
+#if KSIMD_ENABLED
+    // Inverts the matrix blockwise, treating it as the 2x2 blocks | A B |
+    //                                                             | C D |
+    ksimd_f32x4 r0 = ksimd_load(matrix.data + 0);
+    ksimd_f32x4 r1 = ksimd_load(matrix.data + 4);
+    ksimd_f32x4 r2 = ksimd_load(matrix.data + 8);
+    ksimd_f32x4 r3 = ksimd_load(matrix.data + 12);
+    ksimd_f32x4 a = ksimd_shuffle(r0, r1, 0, 1, 0, 1);
+    ksimd_f32x4 b = ksimd_shuffle(r0, r1, 2, 3, 2, 3);
+    ksimd_f32x4 c = ksimd_shuffle(r2, r3, 0, 1, 0, 1);
+    ksimd_f32x4 d = ksimd_shuffle(r2, r3, 2, 3, 2, 3);
+
+    // The determinants of the blocks, as {|A|, |B|, |C|, |D|}.
+    ksimd_f32x4 det_sub = ksimd_sub(
+        ksimd_mul(ksimd_shuffle(r0, r2, 0, 2, 0, 2), ksimd_shuffle(r1, r3, 1, 3, 1, 3)),
+        ksimd_mul(ksimd_shuffle(r0, r2, 1, 3, 1, 3), ksimd_shuffle(r1, r3, 0, 2, 0, 2)));
+    ksimd_f32x4 det_a = ksimd_splat(det_sub, 0);
+    ksimd_f32x4 det_b = ksimd_splat(det_sub, 1);
+    ksimd_f32x4 det_c = ksimd_splat(det_sub, 2);
+    ksimd_f32x4 det_d = ksimd_splat(det_sub, 3);
+
+    // The inverse is 1/|M| * | X Y |, computed here as the adjugates of X, Y, Z and W.
+    //                        | Z W |
+    ksimd_f32x4 d_c = ksimd_mat2_adj_mul(d, c);
+    ksimd_f32x4 a_b = ksimd_mat2_adj_mul(a, b);
+    ksimd_f32x4 x = ksimd_sub(ksimd_mul(det_d, a), ksimd_mat2_mul(b, d_c));
+    ksimd_f32x4 w = ksimd_sub(ksimd_mul(det_a, d), ksimd_mat2_mul(c, a_b));
+    ksimd_f32x4 y = ksimd_sub(ksimd_mul(det_b, c), ksimd_mat2_mul_adj(d, a_b));
+    ksimd_f32x4 z = ksimd_sub(ksimd_mul(det_c, b), ksimd_mat2_mul_adj(a, d_c));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    f32 dets[4];
+    ksimd_store(dets, det_sub);
+    f32 det = dets[0] * dets[3] + dets[1] * dets[2] - ksimd_dot(a_b, ksimd_swizzle(d_c, 0, 2, 1, 3));
+    ksimd_f32x4 inv_det = ksimd_div(ksimd_set(1.0f, -1.0f, -1.0f, 1.0f), ksimd_set1(det));
+    x = ksimd_mul(x, inv_det);
+    y = ksimd_mul(y, inv_det);
+    z = ksimd_mul(z, inv_det);
+    w = ksimd_mul(w, inv_det);
+
+    // Take the adjugates of the blocks while reassembling the rows.
+    mat4 out_matrix;
+    ksimd_store(out_matrix.data + 0, ksimd_shuffle(x, y, 3, 1, 3, 1));
+    ksimd_store(out_matrix.data + 4, ksimd_shuffle(x, y, 2, 0, 2, 0));
+    ksimd_store(out_matrix.data + 8, ksimd_shuffle(z, w, 3, 1, 3, 1));
+    ksimd_store(out_matrix.data + 12, ksimd_shuffle(z, w, 2, 0, 2, 0));
+    return out_matrix;
+#else
     const f32 *m = matrix.data;
 
     f32 t0 = m[10] * m[15];
@@ -1341,6 +1500,7 @@ KINLINE mat4 mat4_inverse(mat4 matrix) {
                  (t20 * m[6] + t23 * m[10] + t17 * m[2]));
 
     return out_matrix;
+#endif
 }
 
 /**
@@ -1556,10 +1716,21 @@ KINLINE vec3 mat4_position(mat4 matrix) {
  * @return The transformed vector.
  */
 KINLINE vec3 mat4_mul_vec3(mat4 m, vec3 v) {
+#if KSIMD_ENABLED
+    ksimd_f32x4 c0 = ksimd_load(m.data + 0);
+    ksimd_f32x4 c1 = ksimd_load(m.data + 4);
+    ksimd_f32x4 c2 = ksimd_load(m.data + 8);
+    ksimd_f32x4 c3 = ksimd_load(m.data + 12);
+    ksimd_transpose(c0, c1, c2, c3);
+    f32 result[4];
+    ksimd_store(result, ksimd_combine(ksimd_set(v.x, v.y, v.z, 1.0f), c0, c1, c2, c3));
+    return (vec3){result[0], result[1], result[2]};
+#else
     return (vec3){v.x * m.data[0] + v.y * m.data[1] + v.z * m.data[2] + m.data[3],
                   v.x * m.data[4] + v.y * m.data[5] + v.z * m.data[6] + m.data[7],
                   v.x * m.data[8] + v.y * m.data[9] + v.z * m.data[10] +
                       m.data[11]};
+#endif
 }
 
 /**
@@ -1570,10 +1741,17 @@ KINLINE vec3 mat4_mul_vec3(mat4 m, vec3 v) {
  * @return The transformed vector.
  */
 KINLINE vec3 vec3_mul_mat4(vec3 v, mat4 m) {
+#if KSIMD_ENABLED
+    f32 result[4];
+    ksimd_store(result, ksimd_combine(ksimd_set(v.x, v.y, v.z, 1.0f), ksimd_load(m.data + 0), ksimd_load(m.data + 4),
+                                      ksimd_load(m.data + 8), ksimd_load(m.data + 12)));
+    return (vec3){result[0], result[1], result[2]};
+#else
     return (vec3){
         v.x * m.data[0] + v.y * m.data[4] + v.z * m.data[8] + m.data[12],
         v.x * m.data[1] + v.y * m.data[5] + v.z * m.data[9] + m.data[13],
         v.x * m.data[2] + v.y * m.data[6] + v.z * m.data[10] + m.data[14]};
+#endif
 }
 
 /**
@@ -1584,11 +1762,22 @@ KINLINE vec3 vec3_mul_mat4(vec3 v, mat4 m) {
  * @return The transformed vector.
  */
 KINLINE vec4 mat4_mul_vec4(mat4 m, vec4 v) {
+#if KSIMD_ENABLED
+    ksimd_f32x4 c0 = ksimd_load(m.data + 0);
+    ksimd_f32x4 c1 = ksimd_load(m.data + 4);
+    ksimd_f32x4 c2 = ksimd_load(m.data + 8);
+    ksimd_f32x4 c3 = ksimd_load(m.data + 12);
+    ksimd_transpose(c0, c1, c2, c3);
+    vec4 result;
+    ksimd_store(result.elements, ksimd_combine(ksimd_load(v.elements), c0, c1, c2, c3));
+    return result;
+#else
     return (vec4){
         v.x * m.data[0] + v.y * m.data[1] + v.z * m.data[2] + v.w * m.data[3],
         v.x * m.data[4] + v.y * m.data[5] + v.z * m.data[6] + v.w * m.data[7],
         v.x * m.data[8] + v.y * m.data[9] + v.z * m.data[10] + v.w * m.data[11],
         v.x * m.data[12] + v.y * m.data[13] + v.z * m.data[14] + v.w * m.data[15]};
+#endif
 }
 
 /**
@@ -1599,11 +1788,18 @@ KINLINE vec4 mat4_mul_vec4(mat4 m, vec4 v) {
  * @return The transformed vector.
  */
 KINLINE vec4 vec4_mul_mat4(vec4 v, mat4 m) {
+#if KSIMD_ENABLED
+    vec4 result;
+    ksimd_store(result.elements, ksimd_combine(ksimd_load(v.elements), ksimd_load(m.data + 0), ksimd_load(m.data + 4),
+                                               ksimd_load(m.data + 8), ksimd_load(m.data + 12)));
+    return result;
+#else
     return (vec4){
         v.x * m.data[0] + v.y * m.data[4] + v.z * m.data[8] + v.w * m.data[12],
         v.x * m.data[1] + v.y * m.data[5] + v.z * m.data[9] + v.w * m.data[13],
         v.x * m.data[2] + v.y * m.data[6] + v.z * m.data[10] + v.w * m.data[14],
         v.x * m.data[3] + v.y * m.data[7] + v.z * m.data[11] + v.w * m.data[15]};
+#endif
 }
 
 // ------------------------------------------
@@ -1624,7 +1820,12 @@ KINLINE quat quat_identity(void) { return (quat){0, 0, 0, 1.0f}; }
  * @return The normal of the provided quaternion.
  */
 KINLINE f32 quat_normal(quat q) {
+#if KSIMD_ENABLED
+    ksimd_f32x4 v = ksimd_load(q.elements);
+    return ksqrt(ksimd_dot(v, v));
+#else
     return ksqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+#endif
 }
 
 /**
@@ -1635,7 +1836,13 @@ KINLINE f32 quat_normal(quat q) {
  */
 KINLINE quat quat_normalize(quat q) {
     f32 normal = quat_normal(q);
+#if KSIMD_ENABLED
+    quat result;
+    ksimd_store(result.elements, ksimd_div(ksimd_load(q.elements), ksimd_set1(normal)));
+    return result;
+#else
     return (quat){q.x / normal, q.y / normal, q.z / normal, q.w / normal};
+#endif
 }
 
 /**
@@ -1664,7 +1871,16 @@ KINLINE quat quat_inverse(quat q) { return quat_normalize(quat_conjugate(q)); }
  */
 KINLINE quat quat_mul(quat q_0, quat q_1) {
     quat out_quaternion;
-
+#if KSIMD_ENABLED
+    // Each element of q_0 scales a signed permutation of q_1.
+    ksimd_f32x4 a = ksimd_load(q_0.elements);
+    ksimd_f32x4 b = ksimd_load(q_1.elements);
+    ksimd_f32x4 result = ksimd_mul(ksimd_splat(a, 3), b);
+    result = ksimd_madd(ksimd_splat(a, 0), ksimd_mul(ksimd_swizzle(b, 3, 2, 1, 0), ksimd_set(1.0f, -1.0f, 1.0f, -1.0f)), result);
+    result = ksimd_madd(ksimd_splat(a, 1), ksimd_mul(ksimd_swizzle(b, 2, 3, 0, 1), ksimd_set(1.0f, 1.0f, -1.0f, -1.0f)), result);
+    result = ksimd_madd(ksimd_splat(a, 2), ksimd_mul(ksimd_swizzle(b, 1, 0, 3, 2), ksimd_set(-1.0f, 1.0f, 1.0f, -1.0f)), result);
+    ksimd_store(out_quaternion.elements, result);
+#else
     out_quaternion.x =
         q_0.x * q_1.w + q_0.y * q_1.z - q_0.z * q_1.y + q_0.w * q_1.x;
 
@@ -1676,6 +1892,7 @@ KINLINE quat quat_mul(quat q_0, quat q_1) {
 
     out_quaternion.w =
         -q_0.x * q_1.x - q_0.y * q_1.y - q_0.z * q_1.z + q_0.w * q_1.w;
+#endif
 
     return out_quaternion;
 }
@@ -1688,7 +1905,11 @@ KINLINE quat quat_mul(quat q_0, quat q_1) {
  * @return The dot product of the provided quaternions.
  */
 KINLINE f32 quat_dot(quat q_0, quat q_1) {
+#if KSIMD_ENABLED
+    return ksimd_dot(ksimd_load(q_0.elements), ksimd_load(q_1.elements));
+#else
     return q_0.x * q_1.x + q_0.y * q_1.y + q_0.z * q_1.z + q_0.w * q_1.w;
+#endif
 }
 
 KINLINE vec3 vec3_min(vec3 vector_0, vec3 vector_1) {
@@ -2047,6 +2268,107 @@ KAPI b8 plane_intersects_aabb(const plane_3d *p, const vec3 *center,
 KAPI b8 frustum_intersects_aabb(const frustum *f, const vec3 *center,
                                 const vec3 *extents);
 
+/**
+ * @brief Transforms a batch of points by the same matrix, as vec3_mul_mat4 does
+ * for one. Processes several points at a time when SIMD is available.
+ *
+ * @param count The number of points.
+ * @param points A constant pointer to the points to be transformed.
+ * @param m The matrix to transform by.
+ * @param out_points A pointer to hold the transformed points. May be the same
+ * arrays as points.
+ */
+KAPI void vec3_mul_mat4_batch(u32 count, const vec3_soa *points, mat4 m,
+                              vec3_soa *out_points);
+
+/**
+ * @brief Transforms a batch of axis-aligned bounding boxes, each by its own
+ * matrix. The resulting boxes are axis-aligned in the destination space and
+ * enclose the transformed boxes, including when the matrices rotate. Processes
+ * several boxes at a time when SIMD is available.
+ *
+ * @param count The number of boxes.
+ * @param models An array of count matrices, one per box.
+ * @param bounds A constant pointer to the boxes to be transformed.
+ * @param out_bounds A pointer to hold the transformed boxes. May be the same
+ * arrays as bounds.
+ */
+KAPI void aabb_transform_batch(u32 count, const mat4 *models,
+                               const aabb_soa *bounds, aabb_soa *out_bounds);
+
+/**
+ * @brief Tests a batch of spheres against the frustum, as
+ * frustum_intersects_sphere does for one.
+ *
+ * @param f A constant pointer to a frustum.
+ * @param count The number of spheres.
+ * @param centers A constant pointer to the centers of the spheres.
+ * @param radii An array of count radii.
+ * @param out_results An array of count results, each set to true if the sphere
+ * is intersected by or contained within the frustum; otherwise false.
+ */
+KAPI void frustum_intersects_sphere_batch(const frustum *f, u32 count,
+                                          const vec3_soa *centers,
+                                          const f32 *radii, b8 *out_results);
+
+/**
+ * @brief Tests a batch of axis-aligned bounding boxes against the frustum, as
+ * frustum_intersects_aabb does for one.
+ *
+ * @param f A constant pointer to a frustum.
+ * @param count The number of boxes.
+ * @param bounds A constant pointer to the boxes.
+ * @param out_results An array of count results, each set to true if the box is
+ * intersected by or contained within the frustum; otherwise false.
+ */
+KAPI void frustum_intersects_aabb_batch(const frustum *f, u32 count,
+                                        const aabb_soa *bounds,
+                                        b8 *out_results);
+
+/**
+ * @brief Calculates the sine of each of a batch of values. Four values are
+ * calculated at a time when SIMD is available, by ksimd_sin, whose absolute
+ * error is below 3e-7 for |x| up to 1e4; otherwise each is calculated by ksin.
+ *
+ * @param count The number of values.
+ * @param x An array of count values, in radians.
+ * @param out_values An array to hold the count results. May be the same array as x.
+ */
+KAPI void ksin_batch(u32 count, const f32 *x, f32 *out_values);
+
+/**
+ * @brief Calculates the cosine of each of a batch of values. Four values are
+ * calculated at a time when SIMD is available, by ksimd_cos, whose absolute
+ * error is below 3e-7 for |x| up to 1e4; otherwise each is calculated by kcos.
+ *
+ * @param count The number of values.
+ * @param x An array of count values, in radians.
+ * @param out_values An array to hold the count results. May be the same array as x.
+ */
+KAPI void kcos_batch(u32 count, const f32 *x, f32 *out_values);
+
+/**
+ * @brief Calculates the arctangent of each of a batch of values. Four values
+ * are calculated at a time when SIMD is available, by ksimd_atan, whose
+ * absolute error is below 2e-7; otherwise each is calculated by katan.
+ *
+ * @param count The number of values.
+ * @param x An array of count values.
+ * @param out_values An array to hold the count results, in radians. May be the same array as x.
+ */
+KAPI void katan_batch(u32 count, const f32 *x, f32 *out_values);
+
+/**
+ * @brief Calculates the reciprocal square root of each of a batch of positive
+ * values. Four values are calculated at a time when SIMD is available, by
+ * ksimd_rsqrt, whose relative error is below 1e-6; otherwise each is 1 / ksqrt(x).
+ *
+ * @param count The number of values.
+ * @param x An array of count positive values.
+ * @param out_values An array to hold the count results. May be the same array as x.
+ */
+KAPI void krsqrt_batch(u32 count, const f32 *x, f32 *out_values);
+
 KINLINE b8 rect_2d_contains_point(rect_2d rect, vec2 point) {
     return (point.x >= rect.x && point.x <= rect.x + rect.width) && (point.y >= rect.y && point.y <= rect.y + rect.height);
 }
@@ -0,0 +1,306 @@
+/**
+ * @file ksimd.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A thin layer over the SIMD instruction sets used by the math library, which lets
+ * kmath implement its vector, matrix and quaternion functions once for SSE (x86) and NEON
+ * (ARM64).
+ *
+ * The backend is selected at compile time from the target architecture. Define
+ * KSIMD_FORCE_SCALAR before including kmath.h (or on the command line) to use the scalar
+ * implementations instead, which is useful for comparing results. When the target supports
+ * FMA (e.g. compiling with -mfma or -march=haswell), fused multiply-adds are used.
+ *
+ * All loads and stores are unaligned, so math types may be stored anywhere.
+ * @version 1.0
+ * @date 2023-11-28
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+#if !defined(KSIMD_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+/** @brief Indicates that SSE is used for math operations. */
+#define KSIMD_SSE 1
+#elif !defined(KSIMD_FORCE_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+/** @brief Indicates that NEON is used for math operations. */
+#define KSIMD_NEON 1
+#endif
+
+#if defined(KSIMD_SSE) || defined(KSIMD_NEON)
+/** @brief Indicates that a SIMD backend is in use. When 0, math operations are scalar. */
+#define KSIMD_ENABLED 1
+#else
+/** @brief Indicates that a SIMD backend is in use. When 0, math operations are scalar. */
+#define KSIMD_ENABLED 0
+#endif
+
+#if defined(KSIMD_SSE)
+#include <immintrin.h>
+
+/** @brief A register of four 32-bit floats. */
+typedef __m128 ksimd_f32x4;
+
+/** @brief Loads four floats from the given (unaligned) address. */
+#define ksimd_load(ptr) _mm_loadu_ps(ptr)
+/** @brief Stores four floats to the given (unaligned) address. */
+#define ksimd_store(ptr, a) _mm_storeu_ps(ptr, a)
+/** @brief Returns a register with all four lanes set to the given value. */
+#define ksimd_set1(value) _mm_set1_ps(value)
+/** @brief Returns a register with the lanes set to x, y, z and w in order. */
+#define ksimd_set(x, y, z, w) _mm_setr_ps(x, y, z, w)
+/** @brief Returns a + b. */
+#define ksimd_add(a, b) _mm_add_ps(a, b)
+/** @brief Returns a - b. */
+#define ksimd_sub(a, b) _mm_sub_ps(a, b)
+/** @brief Returns a * b. */
+#define ksimd_mul(a, b) _mm_mul_ps(a, b)
+/** @brief Returns a / b. */
+#define ksimd_div(a, b) _mm_div_ps(a, b)
+/** @brief Returns the lane-wise minimum of a and b. */
+#define ksimd_min(a, b) _mm_min_ps(a, b)
+/** @brief Returns the lane-wise maximum of a and b. */
+#define ksimd_max(a, b) _mm_max_ps(a, b)
+/** @brief Returns the lane-wise square root of a. */
+#define ksimd_sqrt(a) _mm_sqrt_ps(a)
+/** @brief Returns a mask with all bits of each lane set where a >= b, and clear elsewhere. */
+#define ksimd_cmpge(a, b) _mm_cmpge_ps(a, b)
+/** @brief Returns a mask with all bits of each lane set where a > b, and clear elsewhere. */
+#define ksimd_cmpgt(a, b) _mm_cmpgt_ps(a, b)
+/** @brief Returns the bitwise and of a and b, e.g. to keep only the lanes of a selected by mask b. */
+#define ksimd_and(a, b) _mm_and_ps(a, b)
+/** @brief Returns the lanes of a where mask is set, and of b elsewhere. */
+#define ksimd_select(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+/** @brief Returns the absolute value of a. */
+#define ksimd_abs(a) _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+/** @brief Returns a rounded to the nearest integer. Lanes must be within the range of an i32. */
+#define ksimd_round(a) _mm_cvtepi32_ps(_mm_cvtps_epi32(a))
+/**
+ * @brief Returns the lanes {a[x], a[y], b[z], b[w]}. The indices must be constants.
+ */
+#define ksimd_shuffle(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+#if defined(__FMA__)
+/** @brief Returns a * b + c. */
+#define ksimd_madd(a, b, c) _mm_fmadd_ps(a, b, c)
+#else
+/** @brief Returns a * b + c. */
+#define ksimd_madd(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#endif
+
+/**
+ * @brief Returns the sum of the four lanes of a.
+ */
+KINLINE f32 ksimd_hsum(ksimd_f32x4 a) {
+    ksimd_f32x4 sum = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum);
+}
+
+/**
+ * @brief Transposes the 4x4 matrix held in rows r0 to r3, in place.
+ */
+#define ksimd_transpose(r0, r1, r2, r3) _MM_TRANSPOSE4_PS(r0, r1, r2, r3)
+
+/**
+ * @brief Returns the reciprocal square root of a, which must be positive. The hardware estimate is
+ * refined by a Newton-Raphson step, for a relative error below 1e-6.
+ */
+KINLINE ksimd_f32x4 ksimd_rsqrt(ksimd_f32x4 a) {
+    ksimd_f32x4 e = _mm_rsqrt_ps(a);
+    ksimd_f32x4 half_a_e2 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), a), _mm_mul_ps(e, e));
+    return _mm_mul_ps(e, _mm_sub_ps(_mm_set1_ps(1.5f), half_a_e2));
+}
+
+#elif defined(KSIMD_NEON)
+#include <arm_neon.h>
+
+/** @brief A register of four 32-bit floats. */
+typedef float32x4_t ksimd_f32x4;
+
+/** @brief Loads four floats from the given (unaligned) address. */
+#define ksimd_load(ptr) vld1q_f32(ptr)
+/** @brief Stores four floats to the given (unaligned) address. */
+#define ksimd_store(ptr, a) vst1q_f32(ptr, a)
+/** @brief Returns a register with all four lanes set to the given value. */
+#define ksimd_set1(value) vdupq_n_f32(value)
+/** @brief Returns a + b. */
+#define ksimd_add(a, b) vaddq_f32(a, b)
+/** @brief Returns a - b. */
+#define ksimd_sub(a, b) vsubq_f32(a, b)
+/** @brief Returns a * b. */
+#define ksimd_mul(a, b) vmulq_f32(a, b)
+/** @brief Returns a / b. */
+#define ksimd_div(a, b) vdivq_f32(a, b)
+/** @brief Returns the lane-wise minimum of a and b. */
+#define ksimd_min(a, b) vminq_f32(a, b)
+/** @brief Returns the lane-wise maximum of a and b. */
+#define ksimd_max(a, b) vmaxq_f32(a, b)
+/** @brief Returns the lane-wise square root of a. */
+#define ksimd_sqrt(a) vsqrtq_f32(a)
+/** @brief Returns a mask with all bits of each lane set where a >= b, and clear elsewhere. */
+#define ksimd_cmpge(a, b) vreinterpretq_f32_u32(vcgeq_f32(a, b))
+/** @brief Returns a mask with all bits of each lane set where a > b, and clear elsewhere. */
+#define ksimd_cmpgt(a, b) vreinterpretq_f32_u32(vcgtq_f32(a, b))
+/** @brief Returns the bitwise and of a and b, e.g. to keep only the lanes of a selected by mask b. */
+#define ksimd_and(a, b) vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)))
+/** @brief Returns the lanes of a where mask is set, and of b elsewhere. */
+#define ksimd_select(mask, a, b) vbslq_f32(vreinterpretq_u32_f32(mask), a, b)
+/** @brief Returns the absolute value of a. */
+#define ksimd_abs(a) vabsq_f32(a)
+/** @brief Returns a rounded to the nearest integer. */
+#define ksimd_round(a) vrndnq_f32(a)
+/** @brief Returns a * b + c. */
+#define ksimd_madd(a, b, c) vfmaq_f32(c, a, b)
+/**
+ * @brief Returns the lanes {a[x], a[y], b[z], b[w]}. The indices must be constants.
+ */
+#define ksimd_shuffle(a, b, x, y, z, w) __builtin_shufflevector(a, b, x, y, (z) + 4, (w) + 4)
+
+/** @brief Returns a register with the lanes set to x, y, z and w in order. */
+KINLINE ksimd_f32x4 ksimd_set(f32 x, f32 y, f32 z, f32 w) {
+    const f32 values[4] = {x, y, z, w};
+    return vld1q_f32(values);
+}
+
+/**
+ * @brief Returns the sum of the four lanes of a.
+ */
+KINLINE f32 ksimd_hsum(ksimd_f32x4 a) {
+    return vaddvq_f32(a);
+}
+
+/**
+ * @brief Transposes the 4x4 matrix held in rows r0 to r3, in place.
+ */
+#define ksimd_transpose(r0, r1, r2, r3)                                    \
+    do {                                                                   \
+        float32x4x2_t t01 = vtrnq_f32(r0, r1);                             \
+        float32x4x2_t t23 = vtrnq_f32(r2, r3);                             \
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])); \
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])); \
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])); \
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])); \
+    } while (0)
+
+/**
+ * @brief Returns the reciprocal square root of a, which must be positive. The hardware estimate is
+ * refined by two Newton-Raphson steps, for a relative error below 1e-6.
+ */
+KINLINE ksimd_f32x4 ksimd_rsqrt(ksimd_f32x4 a) {
+    float32x4_t e = vrsqrteq_f32(a);
+    e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+    return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+#endif
+
+#if KSIMD_ENABLED
+/** @brief Returns a register with all four lanes set to lane i of a. */
+#define ksimd_splat(a, i) ksimd_shuffle(a, a, i, i, i, i)
+/** @brief Returns the lanes {a[x], a[y], a[z], a[w]}. The indices must be constants. */
+#define ksimd_swizzle(a, x, y, z, w) ksimd_shuffle(a, a, x, y, z, w)
+
+/**
+ * @brief Returns the dot product of a and b.
+ */
+KINLINE f32 ksimd_dot(ksimd_f32x4 a, ksimd_f32x4 b) {
+    return ksimd_hsum(ksimd_mul(a, b));
+}
+
+/**
+ * @brief Returns r0 * v[0] + r1 * v[1] + r2 * v[2] + r3 * v[3]; that is, the combination of
+ * four rows weighted by the lanes of v.
+ */
+KINLINE ksimd_f32x4 ksimd_combine(ksimd_f32x4 v, ksimd_f32x4 r0, ksimd_f32x4 r1, ksimd_f32x4 r2, ksimd_f32x4 r3) {
+    ksimd_f32x4 result = ksimd_mul(ksimd_splat(v, 0), r0);
+    result = ksimd_madd(ksimd_splat(v, 1), r1, result);
+    result = ksimd_madd(ksimd_splat(v, 2), r2, result);
+    return ksimd_madd(ksimd_splat(v, 3), r3, result);
+}
+
+// The 2x2 matrix helpers below hold a matrix in one register as {m00, m01, m10, m11}.
+
+/** @brief Returns the 2x2 matrix product a * b. */
+KINLINE ksimd_f32x4 ksimd_mat2_mul(ksimd_f32x4 a, ksimd_f32x4 b) {
+    return ksimd_madd(a, ksimd_swizzle(b, 0, 3, 0, 3), ksimd_mul(ksimd_swizzle(a, 1, 0, 3, 2), ksimd_swizzle(b, 2, 1, 2, 1)));
+}
+
+/** @brief Returns the 2x2 matrix product adj(a) * b, where adj is the adjugate. */
+KINLINE ksimd_f32x4 ksimd_mat2_adj_mul(ksimd_f32x4 a, ksimd_f32x4 b) {
+    return ksimd_sub(ksimd_mul(ksimd_swizzle(a, 3, 3, 0, 0), b), ksimd_mul(ksimd_swizzle(a, 1, 1, 2, 2), ksimd_swizzle(b, 2, 3, 0, 1)));
+}
+
+/** @brief Returns the 2x2 matrix product a * adj(b), where adj is the adjugate. */
+KINLINE ksimd_f32x4 ksimd_mat2_mul_adj(ksimd_f32x4 a, ksimd_f32x4 b) {
+    return ksimd_sub(ksimd_mul(a, ksimd_swizzle(b, 3, 0, 3, 0)), ksimd_mul(ksimd_swizzle(a, 1, 0, 3, 2), ksimd_swizzle(b, 2, 1, 2, 1)));
+}
+
+// The approximations below are minimax polynomials over a reduced range, evaluated with a few
+// multiply-adds and no branches, so that a loop of them compiles to straight-line code.
+
+/** @brief Returns a reduced to [-pi, pi] (a - 2pi * round(a / 2pi)). 2pi is split in two, so the reduction stays accurate for |a| up to 1e5. */
+KINLINE ksimd_f32x4 ksimd_reduce_2pi(ksimd_f32x4 a) {
+    ksimd_f32x4 k = ksimd_round(ksimd_mul(a, ksimd_set1(0.15915494309189533577f)));
+    ksimd_f32x4 x = ksimd_sub(a, ksimd_mul(k, ksimd_set1(6.28125f)));
+    return ksimd_sub(x, ksimd_mul(k, ksimd_set1(0.00193530717958647692f)));
+}
+
+/** @brief Returns the sine of x, which must be within [-pi/2, pi/2], by an 11th degree polynomial. */
+KINLINE ksimd_f32x4 ksimd_sin_reduced(ksimd_f32x4 x) {
+    ksimd_f32x4 x2 = ksimd_mul(x, x);
+    ksimd_f32x4 p = ksimd_madd(x2, ksimd_set1(-2.3889859e-08f), ksimd_set1(2.7525562e-06f));
+    p = ksimd_madd(x2, p, ksimd_set1(-1.9840874e-04f));
+    p = ksimd_madd(x2, p, ksimd_set1(8.3333310e-03f));
+    p = ksimd_madd(x2, p, ksimd_set1(-1.6666667e-01f));
+    p = ksimd_madd(x2, p, ksimd_set1(1.0f));
+    return ksimd_mul(x, p);
+}
+
+/**
+ * @brief Returns the sine of a, in radians. The absolute error is below 3e-7 for |a|
+ * up to 1e4, and below 2e-6 up to 1e5.
+ */
+KINLINE ksimd_f32x4 ksimd_sin(ksimd_f32x4 a) {
+    const ksimd_f32x4 pi = ksimd_set1(3.14159265358979323846f);
+    ksimd_f32x4 x = ksimd_reduce_2pi(a);
+    // Reflect the outer quarters into [-pi/2, pi/2], as sin(pi - x) = sin(x).
+    x = ksimd_max(ksimd_min(x, ksimd_sub(pi, x)), ksimd_sub(ksimd_set1(-3.14159265358979323846f), x));
+    return ksimd_sin_reduced(x);
+}
+
+/**
+ * @brief Returns the cosine of a, in radians. The absolute error is below 3e-7 for |a|
+ * up to 1e4, and below 2e-6 up to 1e5.
+ */
+KINLINE ksimd_f32x4 ksimd_cos(ksimd_f32x4 a) {
+    // cos(x) = sin(pi/2 - |x|), which is already within [-pi/2, pi/2].
+    ksimd_f32x4 x = ksimd_abs(ksimd_reduce_2pi(a));
+    return ksimd_sin_reduced(ksimd_sub(ksimd_set1(1.57079632679489661923f), x));
+}
+
+/**
+ * @brief Returns the arctangent of a, in radians. The absolute error is below 2e-7.
+ */
+KINLINE ksimd_f32x4 ksimd_atan(ksimd_f32x4 a) {
+    // Evaluated for t = min(|a|, 1 / |a|) in [0, 1], as atan(x) = pi/2 - atan(1 / x) for x > 0.
+    const ksimd_f32x4 one = ksimd_set1(1.0f);
+    ksimd_f32x4 abs_a = ksimd_abs(a);
+    ksimd_f32x4 inverted = ksimd_cmpgt(abs_a, one);
+    ksimd_f32x4 t = ksimd_min(abs_a, ksimd_div(one, abs_a));
+    ksimd_f32x4 t2 = ksimd_mul(t, t);
+    ksimd_f32x4 p = ksimd_madd(t2, ksimd_set1(-0.0040540580f), ksimd_set1(0.0218612288f));
+    p = ksimd_madd(t2, p, ksimd_set1(-0.0559098861f));
+    p = ksimd_madd(t2, p, ksimd_set1(0.0964200441f));
+    p = ksimd_madd(t2, p, ksimd_set1(-0.1390853351f));
+    p = ksimd_madd(t2, p, ksimd_set1(0.1994653599f));
+    p = ksimd_madd(t2, p, ksimd_set1(-0.3332985605f));
+    p = ksimd_madd(t2, p, ksimd_set1(0.9999993329f));
+    p = ksimd_mul(t, p);
+    p = ksimd_select(inverted, ksimd_sub(ksimd_set1(1.57079632679489661923f), p), p);
+    // atan is odd, so restore the sign.
+    return ksimd_select(ksimd_cmpge(a, ksimd_set1(0.0f)), p, ksimd_sub(ksimd_set1(0.0f), p));
+}
+#endif
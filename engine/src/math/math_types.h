@@ -185,6 +185,40 @@ typedef struct vertex_3d {
     vec3 tangent;
 } vertex_3d;
 
+/**
+ * @brief A vertex_3d packed into 24 bytes, in formats shaders read as floats without any decoding.
+ * Positions are stored relative to a box enclosing the geometry, whose center and half-size are
+ * kept alongside it.
+ */
+typedef struct vertex_3d_packed {
+    /** @brief The position within the box, as snorm16. The fourth component is unused. */
+    i16 position[4];
+    /** @brief The normal, as snorm8. The fourth component is unused. */
+    i8 normal[4];
+    /** @brief The texture coordinate, as half floats. */
+    u16 texcoord[2];
+    /** @brief The colour, as unorm8. */
+    u8 colour[4];
+    /** @brief The tangent, as snorm8. The fourth component is unused. */
+    i8 tangent[4];
+} vertex_3d_packed;
+
+/**
+ * @brief A vertex of a skinned geometry, deformed on the GPU by up to four joints of a skeleton.
+ */
+typedef struct vertex_3d_skinned {
+    /** @brief The position of the vertex in the bind pose. */
+    vec3 position;
+    /** @brief The normal of the vertex in the bind pose. */
+    vec3 normal;
+    /** @brief The texture coordinate of the vertex. */
+    vec2 texcoord;
+    /** @brief The indices of the joints influencing the vertex. */
+    u8 joints[4];
+    /** @brief The weight of each joint, as unorm8. They sum to 255. */
+    u8 weights[4];
+} vertex_3d_skinned;
+
 /**
  * @brief Represents a single vertex in 2D space.
  */
@@ -230,10 +264,18 @@ typedef struct transform {
      */
     mat4 local;
 
+    /** @brief Incremented each time the local matrix is recalculated or the parent changes. */
+    u32 generation;
+
     f32 determinant;
 
     /** @brief A pointer to a parent transform if one is assigned. Can also be null. */
     struct transform* parent;
+
+    /** @brief The hierarchy caching the world matrix of this transform, if any. */
+    struct transform_hierarchy* hierarchy;
+    /** @brief The index of this transform within its hierarchy. */
+    u32 hierarchy_index;
 } transform;
 
 typedef struct plane_3d {
@@ -257,6 +299,30 @@ typedef struct frustum {
     plane_3d sides[FRUSTUM_SIDE_COUNT];
 } frustum;
 
+/**
+ * @brief A batch of 3-element vectors in structure-of-arrays layout, used by the
+ * batched math functions. Each array holds one element per vector.
+ */
+typedef struct vec3_soa {
+    /** @brief The x elements. */
+    f32* x;
+    /** @brief The y elements. */
+    f32* y;
+    /** @brief The z elements. */
+    f32* z;
+} vec3_soa;
+
+/**
+ * @brief A batch of axis-aligned bounding boxes in structure-of-arrays layout,
+ * each represented by its center and half-extents.
+ */
+typedef struct aabb_soa {
+    /** @brief The centers of the boxes. */
+    vec3_soa center;
+    /** @brief The half-extents of the boxes. */
+    vec3_soa extents;
+} aabb_soa;
+
 /**
  * @brief A 2-element integer-based vector.
  */
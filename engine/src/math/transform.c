@@ -1,12 +1,16 @@
 #include "transform.h"
 
 #include "kmath.h"
+#include "transform_hierarchy.h"
 
 transform transform_create(void) {
     transform t;
     transform_position_rotation_scale_set(&t, vec3_zero(), quat_identity(), vec3_one());
     t.local = mat4_identity();
     t.parent = 0;
+    t.generation = 0;
+    t.hierarchy = 0;
+    t.hierarchy_index = INVALID_ID;
     return t;
 }
 
@@ -15,6 +19,9 @@ transform transform_from_position(vec3 position) {
     transform_position_rotation_scale_set(&t, position, quat_identity(), vec3_one());
     t.local = mat4_identity();
     t.parent = 0;
+    t.generation = 0;
+    t.hierarchy = 0;
+    t.hierarchy_index = INVALID_ID;
     return t;
 }
 
@@ -23,6 +30,9 @@ transform transform_from_rotation(quat rotation) {
     transform_position_rotation_scale_set(&t, vec3_zero(), rotation, vec3_one());
     t.local = mat4_identity();
     t.parent = 0;
+    t.generation = 0;
+    t.hierarchy = 0;
+    t.hierarchy_index = INVALID_ID;
     return t;
 }
 
@@ -31,6 +41,9 @@ transform transform_from_position_rotation(vec3 position, quat rotation) {
     transform_position_rotation_scale_set(&t, position, rotation, vec3_one());
     t.local = mat4_identity();
     t.parent = 0;
+    t.generation = 0;
+    t.hierarchy = 0;
+    t.hierarchy_index = INVALID_ID;
     return t;
 }
 
@@ -39,6 +52,9 @@ transform transform_from_position_rotation_scale(vec3 position, quat rotation, v
     transform_position_rotation_scale_set(&t, position, rotation, scale);
     t.local = mat4_identity();
     t.parent = 0;
+    t.generation = 0;
+    t.hierarchy = 0;
+    t.hierarchy_index = INVALID_ID;
     return t;
 }
 
@@ -52,6 +68,8 @@ transform* transform_parent_get(transform* t) {
 void transform_parent_set(transform* t, transform* parent) {
     if (t) {
         t->parent = parent;
+        // The world matrix changes with the parent, even if the local one doesn't.
+        t->generation++;
     }
 }
 
@@ -123,6 +141,7 @@ mat4 transform_local_get(transform* t) {
             tr = mat4_mul(mat4_scale(t->scale), tr);
             t->local = tr;
             t->is_dirty = false;
+            t->generation++;
         }
 
         return t->local;
@@ -132,6 +151,12 @@ mat4 transform_local_get(transform* t) {
 
 mat4 transform_world_get(transform* t) {
     if (t) {
+        // Use the matrix cached by the hierarchy if it is still current.
+        mat4 world;
+        if (transform_hierarchy_world_get(t, &world)) {
+            return world;
+        }
+
         mat4 l = transform_local_get(t);
         if (t->parent) {
             mat4 p = transform_world_get(t->parent);
@@ -146,3 +171,15 @@ mat4 transform_world_get(transform* t) {
     }
     return mat4_identity();
 }
+
+u32 transform_world_generation_get(transform* t) {
+    u32 generation = 0;
+    for (transform* current = t; current; current = current->parent) {
+        // Resolve any pending changes so they are reflected in the generation.
+        if (current->is_dirty) {
+            transform_local_get(current);
+        }
+        generation += current->generation;
+    }
+    return generation;
+}
@@ -185,3 +185,14 @@ KAPI mat4 transform_local_get(transform* t);
  * @return A copy of the world matrix.
  */
 KAPI mat4 transform_world_get(transform* t);
+
+/**
+ * @brief Obtains a value which changes whenever the world matrix of the given
+ * transform changes, whether from the transform itself or from one of its parents.
+ * Comparing this against a previously-obtained value is much cheaper than comparing
+ * world matrices, and allows unchanged transforms to be skipped entirely.
+ *
+ * @param t A pointer to the transform whose world generation to retrieve.
+ * @return The world generation of the transform.
+ */
+KAPI u32 transform_world_generation_get(transform* t);
@@ -0,0 +1,282 @@
+#include "transform_hierarchy.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "kmath.h"
+#include "transform.h"
+
+// The number of per-transform arrays in a hierarchy.
+#define HIERARCHY_ARRAY_COUNT 8
+
+b8 transform_hierarchy_contains(const transform_hierarchy* hierarchy, const transform* t) {
+    return t && hierarchy && hierarchy->transforms && t->hierarchy == hierarchy && t->hierarchy_index < darray_length(hierarchy->transforms) &&
+           hierarchy->transforms[t->hierarchy_index] == t;
+}
+
+// Obtains each of the per-transform arrays along with its element size, so the same operation
+// can be applied to all of them.
+static void hierarchy_arrays_get(transform_hierarchy* hierarchy, u8* out_arrays[HIERARCHY_ARRAY_COUNT], u64 out_strides[HIERARCHY_ARRAY_COUNT]) {
+    out_arrays[0] = (u8*)hierarchy->transforms;
+    out_arrays[1] = (u8*)hierarchy->parent_indices;
+    out_arrays[2] = (u8*)hierarchy->parents;
+    out_arrays[3] = (u8*)hierarchy->world_matrices;
+    out_arrays[4] = (u8*)hierarchy->local_generations;
+    out_arrays[5] = (u8*)hierarchy->parent_generations;
+    out_arrays[6] = (u8*)hierarchy->world_generations;
+    out_arrays[7] = (u8*)hierarchy->changed;
+    out_strides[0] = sizeof(transform*);
+    out_strides[1] = sizeof(u32);
+    out_strides[2] = sizeof(transform*);
+    out_strides[3] = sizeof(mat4);
+    out_strides[4] = sizeof(u32);
+    out_strides[5] = sizeof(u32);
+    out_strides[6] = sizeof(u32);
+    out_strides[7] = sizeof(b8);
+}
+
+b8 transform_hierarchy_create(transform_hierarchy* out_hierarchy) {
+    if (!out_hierarchy) {
+        KERROR("transform_hierarchy_create requires a valid pointer to hold the hierarchy.");
+        return false;
+    }
+    kzero_memory(out_hierarchy, sizeof(transform_hierarchy));
+    out_hierarchy->transforms = darray_create(transform*);
+    out_hierarchy->parent_indices = darray_create(u32);
+    out_hierarchy->parents = darray_create(transform*);
+    out_hierarchy->world_matrices = darray_create(mat4);
+    out_hierarchy->local_generations = darray_create(u32);
+    out_hierarchy->parent_generations = darray_create(u32);
+    out_hierarchy->world_generations = darray_create(u32);
+    out_hierarchy->changed = darray_create(b8);
+    return true;
+}
+
+void transform_hierarchy_destroy(transform_hierarchy* hierarchy) {
+    if (!hierarchy || !hierarchy->transforms) {
+        return;
+    }
+    transform_hierarchy_clear(hierarchy);
+    darray_destroy(hierarchy->transforms);
+    darray_destroy(hierarchy->parent_indices);
+    darray_destroy(hierarchy->parents);
+    darray_destroy(hierarchy->world_matrices);
+    darray_destroy(hierarchy->local_generations);
+    darray_destroy(hierarchy->parent_generations);
+    darray_destroy(hierarchy->world_generations);
+    darray_destroy(hierarchy->changed);
+    kzero_memory(hierarchy, sizeof(transform_hierarchy));
+}
+
+b8 transform_hierarchy_add(transform_hierarchy* hierarchy, transform* t) {
+    if (!hierarchy || !t) {
+        return false;
+    }
+    if (t->hierarchy && transform_hierarchy_contains(t->hierarchy, t)) {
+        KERROR("transform_hierarchy_add - The transform is already in a hierarchy.");
+        return false;
+    }
+
+    t->hierarchy = hierarchy;
+    t->hierarchy_index = (u32)darray_length(hierarchy->transforms);
+    darray_push(hierarchy->transforms, t);
+    u32 invalid = INVALID_ID;
+    darray_push(hierarchy->parent_indices, invalid);
+    transform* parent = t->parent;
+    darray_push(hierarchy->parents, parent);
+    mat4 world = mat4_identity();
+    darray_push(hierarchy->world_matrices, world);
+    // Differs from the transform's generation, so the world matrix is computed by the next update.
+    u32 local_generation = t->generation + 1;
+    darray_push(hierarchy->local_generations, local_generation);
+    darray_push(hierarchy->parent_generations, invalid);
+    darray_push(hierarchy->world_generations, invalid);
+    b8 changed = false;
+    darray_push(hierarchy->changed, changed);
+    hierarchy->is_order_dirty = true;
+    return true;
+}
+
+b8 transform_hierarchy_remove(transform_hierarchy* hierarchy, transform* t) {
+    if (!hierarchy || !transform_hierarchy_contains(hierarchy, t)) {
+        return false;
+    }
+
+    // Move the last entry into the vacated slot. The order is rebuilt by the next update.
+    u32 index = t->hierarchy_index;
+    u32 last = (u32)darray_length(hierarchy->transforms) - 1;
+    u8* arrays[HIERARCHY_ARRAY_COUNT];
+    u64 strides[HIERARCHY_ARRAY_COUNT];
+    hierarchy_arrays_get(hierarchy, arrays, strides);
+    for (u32 i = 0; i < HIERARCHY_ARRAY_COUNT; ++i) {
+        if (index != last) {
+            kcopy_memory(arrays[i] + strides[i] * index, arrays[i] + strides[i] * last, strides[i]);
+        }
+        darray_length_set(arrays[i], last);
+    }
+    if (index != last) {
+        hierarchy->transforms[index]->hierarchy_index = index;
+    }
+
+    t->hierarchy = 0;
+    t->hierarchy_index = INVALID_ID;
+    hierarchy->is_order_dirty = true;
+    return true;
+}
+
+void transform_hierarchy_clear(transform_hierarchy* hierarchy) {
+    if (!hierarchy || !hierarchy->transforms) {
+        return;
+    }
+    // The transforms are deliberately left alone, as they may have moved already. Their stale
+    // hierarchy indices are harmless, as membership is always confirmed against the arrays.
+    u8* arrays[HIERARCHY_ARRAY_COUNT];
+    u64 strides[HIERARCHY_ARRAY_COUNT];
+    hierarchy_arrays_get(hierarchy, arrays, strides);
+    for (u32 i = 0; i < HIERARCHY_ARRAY_COUNT; ++i) {
+        darray_clear(arrays[i]);
+    }
+    hierarchy->is_order_dirty = false;
+}
+
+// Reorders the entries so that parents come before their children, by sorting them by their
+// depth within the hierarchy, and resolves the index of each parent.
+static void hierarchy_order_rebuild(transform_hierarchy* hierarchy) {
+    u32 count = (u32)darray_length(hierarchy->transforms);
+    if (!count) {
+        hierarchy->is_order_dirty = false;
+        return;
+    }
+
+    u32* depths = kallocate(sizeof(u32) * count, MEMORY_TAG_TRANSFORM);
+    u32 max_depth = 0;
+    for (u32 i = 0; i < count; ++i) {
+        u32 depth = 0;
+        for (transform* parent = hierarchy->transforms[i]->parent; parent && transform_hierarchy_contains(hierarchy, parent); parent = parent->parent) {
+            depth++;
+            if (depth > count) {
+                KERROR("transform_hierarchy_update - Transforms have a cycle of parents. Their world matrices are invalid.");
+                break;
+            }
+        }
+        depths[i] = depth;
+        max_depth = KMAX(max_depth, depth);
+    }
+
+    // A counting sort by depth, which keeps the relative order of each depth.
+    u32 bucket_count = max_depth + 2;
+    u32* offsets = kallocate(sizeof(u32) * bucket_count, MEMORY_TAG_TRANSFORM);
+    for (u32 i = 0; i < count; ++i) {
+        offsets[depths[i] + 1]++;
+    }
+    for (u32 i = 1; i < bucket_count; ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    u32* new_indices = kallocate(sizeof(u32) * count, MEMORY_TAG_TRANSFORM);
+    for (u32 i = 0; i < count; ++i) {
+        new_indices[i] = offsets[depths[i]]++;
+    }
+
+    u8* arrays[HIERARCHY_ARRAY_COUNT];
+    u64 strides[HIERARCHY_ARRAY_COUNT];
+    hierarchy_arrays_get(hierarchy, arrays, strides);
+    // Large enough for the widest element, a world matrix.
+    u64 largest_stride = sizeof(mat4);
+    u8* scratch = kallocate(largest_stride * count, MEMORY_TAG_TRANSFORM);
+    for (u32 a = 0; a < HIERARCHY_ARRAY_COUNT; ++a) {
+        for (u32 i = 0; i < count; ++i) {
+            kcopy_memory(scratch + strides[a] * new_indices[i], arrays[a] + strides[a] * i, strides[a]);
+        }
+        kcopy_memory(arrays[a], scratch, strides[a] * count);
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        transform* t = hierarchy->transforms[i];
+        t->hierarchy_index = i;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        transform* t = hierarchy->transforms[i];
+        hierarchy->parents[i] = t->parent;
+        hierarchy->parent_indices[i] = transform_hierarchy_contains(hierarchy, t->parent) ? t->parent->hierarchy_index : INVALID_ID;
+    }
+
+    kfree(scratch, largest_stride * count, MEMORY_TAG_TRANSFORM);
+    kfree(new_indices, sizeof(u32) * count, MEMORY_TAG_TRANSFORM);
+    kfree(offsets, sizeof(u32) * bucket_count, MEMORY_TAG_TRANSFORM);
+    kfree(depths, sizeof(u32) * count, MEMORY_TAG_TRANSFORM);
+    hierarchy->is_order_dirty = false;
+}
+
+void transform_hierarchy_update(transform_hierarchy* hierarchy) {
+    if (!hierarchy || !hierarchy->transforms) {
+        return;
+    }
+
+    u32 count = (u32)darray_length(hierarchy->transforms);
+    for (u32 i = 0; i < count && !hierarchy->is_order_dirty; ++i) {
+        hierarchy->is_order_dirty = hierarchy->transforms[i]->parent != hierarchy->parents[i];
+    }
+    if (hierarchy->is_order_dirty) {
+        hierarchy_order_rebuild(hierarchy);
+    }
+
+    // Parents come first, so each parent is final by the time its children are visited.
+    for (u32 i = 0; i < count; ++i) {
+        transform* t = hierarchy->transforms[i];
+        b8 changed = t->is_dirty || t->generation != hierarchy->local_generations[i];
+        u32 parent_index = hierarchy->parent_indices[i];
+        if (parent_index != INVALID_ID) {
+            changed = changed || hierarchy->changed[parent_index];
+        } else if (t->parent) {
+            u32 parent_generation = transform_world_generation_get(t->parent);
+            changed = changed || parent_generation != hierarchy->parent_generations[i];
+            hierarchy->parent_generations[i] = parent_generation;
+        }
+        hierarchy->changed[i] = changed;
+        if (!changed) {
+            continue;
+        }
+
+        mat4 world = transform_local_get(t);
+        if (parent_index != INVALID_ID) {
+            world = mat4_mul(world, hierarchy->world_matrices[parent_index]);
+        } else if (t->parent) {
+            world = mat4_mul(world, transform_world_get(t->parent));
+        }
+        hierarchy->world_matrices[i] = world;
+        t->determinant = mat4_determinant(world);
+        hierarchy->local_generations[i] = t->generation;
+        if (hierarchy->next_world_generation == INVALID_ID) {
+            hierarchy->next_world_generation = 0;
+        }
+        hierarchy->world_generations[i] = hierarchy->next_world_generation++;
+    }
+}
+
+b8 transform_hierarchy_world_get(const transform* t, mat4* out_world) {
+    if (!t || !t->hierarchy) {
+        return false;
+    }
+    // The cache is current only if the whole chain is in the hierarchy, and nothing in it changed
+    // since the last update.
+    const transform_hierarchy* hierarchy = t->hierarchy;
+    for (const transform* current = t; current; current = current->parent) {
+        if (!transform_hierarchy_contains(hierarchy, current)) {
+            return false;
+        }
+        u32 index = current->hierarchy_index;
+        if (current->is_dirty || current->generation != hierarchy->local_generations[index] ||
+            current->parent != hierarchy->parents[index]) {
+            return false;
+        }
+    }
+    *out_world = hierarchy->world_matrices[t->hierarchy_index];
+    return true;
+}
+
+u32 transform_hierarchy_world_generation_get(const transform_hierarchy* hierarchy, const transform* t) {
+    if (!hierarchy || !transform_hierarchy_contains(hierarchy, t)) {
+        return INVALID_ID;
+    }
+    return hierarchy->world_generations[t->hierarchy_index];
+}
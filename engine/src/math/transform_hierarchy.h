@@ -0,0 +1,128 @@
+/**
+ * @file transform_hierarchy.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A transform hierarchy caches the world matrices of a set of transforms. Entries are
+ * kept in contiguous arrays ordered so that parents come before their children, which lets a
+ * single pass per frame recompute the world matrices of only those transforms which changed
+ * (or whose parents did). In the meantime, transform_world_get returns the cached matrix of
+ * any transform in a hierarchy which hasn't changed since, instead of walking its parents.
+ *
+ * A hierarchy holds pointers to transforms, so a transform must be removed before it is moved
+ * or freed, or the hierarchy cleared afterwards. The parents of a transform should be in the same
+ * hierarchy; a parent outside of it still works, but its world matrix is obtained on demand.
+ * @version 1.0
+ * @date 2023-11-28
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "math_types.h"
+
+/** @brief A set of transforms whose world matrices are cached. */
+typedef struct transform_hierarchy {
+    /** @brief darray of the transforms, ordered so that parents come before their children. */
+    transform** transforms;
+    /** @brief darray of the index of each transform's parent, or INVALID_ID if it has none in the hierarchy. */
+    u32* parent_indices;
+    /** @brief darray of the parent of each transform as of the last update, used to detect reparenting. */
+    transform** parents;
+    /** @brief darray of the cached world matrix of each transform. */
+    mat4* world_matrices;
+    /** @brief darray of the generation of each transform when its world matrix was last computed. */
+    u32* local_generations;
+    /** @brief darray of the world generation of each transform's parent, for parents outside the hierarchy. */
+    u32* parent_generations;
+    /** @brief darray of the world generation of each transform. See transform_hierarchy_world_generation_get. */
+    u32* world_generations;
+    /** @brief darray of flags set for each transform whose world matrix changed during the current update. */
+    b8* changed;
+    /** @brief The source of world generations. Never reset, so a generation is never reused. */
+    u32 next_world_generation;
+    /** @brief Indicates that the order must be rebuilt, as transforms were added, removed or reparented. */
+    b8 is_order_dirty;
+} transform_hierarchy;
+
+/**
+ * @brief Creates an empty transform hierarchy.
+ *
+ * @param out_hierarchy A pointer to hold the created hierarchy.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 transform_hierarchy_create(transform_hierarchy* out_hierarchy);
+
+/**
+ * @brief Destroys the given hierarchy. The transforms in it are not accessed, so they may
+ * already have been moved or freed.
+ *
+ * @param hierarchy A pointer to the hierarchy to be destroyed.
+ */
+KAPI void transform_hierarchy_destroy(transform_hierarchy* hierarchy);
+
+/**
+ * @brief Adds a transform to the hierarchy. Its world matrix is computed by the next update.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ * @param t A pointer to the transform to be added. Must not already be in a hierarchy.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 transform_hierarchy_add(transform_hierarchy* hierarchy, transform* t);
+
+/**
+ * @brief Removes a transform from the hierarchy.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ * @param t A pointer to the transform to be removed.
+ * @return True on success; otherwise false (i.e. the transform isn't in the hierarchy).
+ */
+KAPI b8 transform_hierarchy_remove(transform_hierarchy* hierarchy, transform* t);
+
+/**
+ * @brief Removes all transforms from the hierarchy. The transforms are not accessed, so this
+ * may be used after they have been moved or freed, e.g. to rebuild the hierarchy.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ */
+KAPI void transform_hierarchy_clear(transform_hierarchy* hierarchy);
+
+/**
+ * @brief Indicates if the given transform is in the hierarchy. A copy of a transform which is
+ * in a hierarchy is not in it.
+ *
+ * @param hierarchy A constant pointer to the hierarchy.
+ * @param t A constant pointer to the transform.
+ * @return True if the transform is in the hierarchy; otherwise false.
+ */
+KAPI b8 transform_hierarchy_contains(const transform_hierarchy* hierarchy, const transform* t);
+
+/**
+ * @brief Brings the cached world matrices up to date. Only the transforms which changed since
+ * the last update, and their children, are recomputed. Typically called once per frame, after
+ * transforms are modified and before they are rendered.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ */
+KAPI void transform_hierarchy_update(transform_hierarchy* hierarchy);
+
+/**
+ * @brief Obtains the cached world matrix of the given transform, if it is in a hierarchy and
+ * neither it nor any of its parents have changed since the hierarchy was last updated.
+ *
+ * @param t A constant pointer to the transform.
+ * @param out_world A pointer to hold the world matrix.
+ * @return True if the cached matrix is current and was obtained; otherwise false.
+ */
+KAPI b8 transform_hierarchy_world_get(const transform* t, mat4* out_world);
+
+/**
+ * @brief Obtains a value which changes whenever the hierarchy recomputes the world matrix of
+ * the given transform, as of the last update. Values are never reused by the same hierarchy,
+ * even after a transform is removed and added again.
+ *
+ * @param hierarchy A constant pointer to the hierarchy.
+ * @param t A constant pointer to the transform.
+ * @return The world generation of the transform, or INVALID_ID if it isn't in the hierarchy.
+ */
+KAPI u32 transform_hierarchy_world_generation_get(const transform_hierarchy* hierarchy, const transform* t);
@@ -4,12 +4,19 @@
 #include "core/kmemory.h"
 #include "core/logger.h"
 #include "containers/freelist.h"
+#include "platform/platform.h"
 
 typedef struct dynamic_allocator_state {
     u64 total_size;
     freelist list;
     void* freelist_block;
     void* memory_block;
+    // Indicates if the memory block is a reserved range, committed as allocations reach it.
+    b8 is_reserved;
+    // The amount of the memory block committed, from its start. Always total_size unless reserved.
+    u64 committed;
+    // The granularity memory is committed in, if reserved.
+    u64 commit_granularity;
 } dynamic_allocator_state;
 
 typedef struct alloc_header {
@@ -20,7 +27,7 @@ typedef struct alloc_header {
 // The storage size in bytes of a node's user memory block size
 #define KSIZE_STORAGE sizeof(u32)
 
-b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memory, dynamic_allocator* out_allocator) {
+static b8 allocator_create(u64 total_size, u64* memory_requirement, void* memory, b8 is_reserved, b8 large_pages, dynamic_allocator* out_allocator) {
     if (total_size < 1) {
         KERROR("dynamic_allocator_create cannot have a total_size of 0. Create failed.");
         return false;
@@ -31,7 +38,8 @@ b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memor
     }
     u64 freelist_requirement = 0;
     // Grab the memory requirement for the free list first.
-    freelist_create(total_size, &freelist_requirement, 0, 0);
+    // NOTE: TLSF keeps allocations O(1) no matter how fragmented the heap gets.
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &freelist_requirement, 0, 0);
 
     *memory_requirement = freelist_requirement + sizeof(dynamic_allocator_state) + total_size;
 
@@ -40,6 +48,12 @@ b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memor
         return true;
     }
 
+    // The state and free list are always in use, so are committed up front.
+    if (is_reserved && !platform_memory_commit(memory, sizeof(dynamic_allocator_state) + freelist_requirement)) {
+        KERROR("dynamic_allocator_create_reserved was unable to commit the allocator's state. Create failed.");
+        return false;
+    }
+
     // Memory layout:
     // state
     // freelist block
@@ -49,19 +63,37 @@ b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memor
     state->total_size = total_size;
     state->freelist_block = (void*)(out_allocator->memory + sizeof(dynamic_allocator_state));
     state->memory_block = (void*)(state->freelist_block + freelist_requirement);
+    state->is_reserved = is_reserved;
+    state->committed = is_reserved ? 0 : total_size;
+    state->commit_granularity = DYNAMIC_ALLOCATOR_COMMIT_GRANULARITY;
+    if (large_pages) {
+        state->commit_granularity = KMAX(platform_memory_large_page_size(), DYNAMIC_ALLOCATOR_COMMIT_GRANULARITY);
+    }
 
     // Actually create the freelist
-    freelist_create(total_size, &freelist_requirement, state->freelist_block, &state->list);
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &freelist_requirement, state->freelist_block, &state->list);
 
-    kzero_memory(state->memory_block, total_size);
+    // NOTE: Reserved memory reads as zero once committed, and touching it here would commit all of it.
+    if (!is_reserved) {
+        kzero_memory(state->memory_block, total_size);
+    }
     return true;
 }
 
+b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memory, dynamic_allocator* out_allocator) {
+    return allocator_create(total_size, memory_requirement, memory, false, false, out_allocator);
+}
+
+b8 dynamic_allocator_create_reserved(u64 total_size, u64* memory_requirement, void* memory, b8 large_pages, dynamic_allocator* out_allocator) {
+    return allocator_create(total_size, memory_requirement, memory, true, large_pages, out_allocator);
+}
+
 b8 dynamic_allocator_destroy(dynamic_allocator* allocator) {
     if (allocator) {
         dynamic_allocator_state* state = allocator->memory;
         freelist_destroy(&state->list);
-        kzero_memory(state->memory_block, state->total_size);
+        // Only what is committed can be touched.
+        kzero_memory(state->memory_block, state->committed);
         state->total_size = 0;
         allocator->memory = 0;
         return true;
@@ -71,6 +103,22 @@ b8 dynamic_allocator_destroy(dynamic_allocator* allocator) {
     return false;
 }
 
+// Commits as much more of a reserved block as reaches the given offset.
+static b8 commit_to(dynamic_allocator_state* state, u64 end) {
+    if (end <= state->committed) {
+        return true;
+    }
+    // Rounded by address rather than offset, so commits line up with large pages.
+    u64 base = (u64)state->memory_block;
+    u64 target = ((base + end + state->commit_granularity - 1) & ~(state->commit_granularity - 1)) - base;
+    target = KMIN(target, state->total_size);
+    if (!platform_memory_commit((u8*)state->memory_block + state->committed, target - state->committed)) {
+        return false;
+    }
+    state->committed = target;
+    return true;
+}
+
 void* dynamic_allocator_allocate(dynamic_allocator* allocator, u64 size) {
     return dynamic_allocator_allocate_aligned(allocator, size, 1);
 }
@@ -89,6 +137,12 @@ void* dynamic_allocator_allocate_aligned(dynamic_allocator* allocator, u64 size,
 
         u64 base_offset = 0;
         if (freelist_allocate_block(&state->list, required_size, &base_offset)) {
+            if (!commit_to(state, base_offset + required_size)) {
+                KERROR("dynamic_allocator_allocate_aligned was unable to commit memory for an allocation of %llu.", size);
+                freelist_free_block(&state->list, required_size, base_offset);
+                return 0;
+            }
+
             /*
             Memory layout:
             x bytes/void padding
@@ -153,6 +207,57 @@ b8 dynamic_allocator_free_aligned(dynamic_allocator* allocator, void* block) {
     return true;
 }
 
+void* dynamic_allocator_reallocate(dynamic_allocator* allocator, void* block, u64 new_size) {
+    if (!allocator || !block || !new_size) {
+        KERROR("dynamic_allocator_reallocate requires a valid allocator, block and new_size.");
+        return 0;
+    }
+    KASSERT_MSG(new_size < 4294967295U, "dynamic_allocator_reallocate called with required size > 4 GiB. Don't do that.");
+
+    dynamic_allocator_state* state = allocator->memory;
+    u32* block_size = (u32*)((u64)block - KSIZE_STORAGE);
+    u64 size = *block_size;
+    alloc_header header = *(alloc_header*)((u64)block + size);
+    if (new_size == size) {
+        return block;
+    }
+
+    u64 offset = (u64)header.start - (u64)state->memory_block;
+    u64 required_size = header.alignment + sizeof(alloc_header) + KSIZE_STORAGE + size;
+    if (new_size < size) {
+        // Shrinking always happens in place, handing back the tail.
+        if (!freelist_free_block(&state->list, size - new_size, offset + required_size - (size - new_size))) {
+            KERROR("dynamic_allocator_reallocate failed to free the tail of a block.");
+            return 0;
+        }
+    } else {
+        // Grow in place if the range right after the block is free and large enough.
+        u64 growth = new_size - size;
+        u64 end = offset + required_size;
+        b8 in_place = freelist_allocate_block_at(&state->list, growth, end);
+        if (in_place && !commit_to(state, end + growth)) {
+            freelist_free_block(&state->list, growth, end);
+            KERROR("dynamic_allocator_reallocate was unable to commit memory for a block of %llu.", new_size);
+            return 0;
+        }
+        if (!in_place) {
+            // Otherwise the block has to move.
+            void* new_block = dynamic_allocator_allocate_aligned(allocator, new_size, header.alignment);
+            if (!new_block) {
+                return 0;
+            }
+            kcopy_memory(new_block, block, size);
+            dynamic_allocator_free_aligned(allocator, block);
+            return new_block;
+        }
+    }
+
+    // The header moves along with the end of the block.
+    *block_size = (u32)new_size;
+    *(alloc_header*)((u64)block + new_size) = header;
+    return block;
+}
+
 b8 dynamic_allocator_get_size_alignment(void* block, u64* out_size, u16* out_alignment) {
     // Get the header.
     *out_size = *(u32*)((u64)block - KSIZE_STORAGE);
@@ -166,6 +271,11 @@ u64 dynamic_allocator_free_space(dynamic_allocator* allocator) {
     return freelist_free_space(&state->list);
 }
 
+f32 dynamic_allocator_fragmentation(dynamic_allocator* allocator) {
+    dynamic_allocator_state* state = allocator->memory;
+    return freelist_fragmentation(&state->list);
+}
+
 u64 dynamic_allocator_total_space(dynamic_allocator* allocator) {
     dynamic_allocator_state* state = allocator->memory;
     return state->total_size;
@@ -13,6 +13,9 @@
 
 #include "defines.h"
 
+/** @brief The granularity reserved allocators commit memory in, to keep the number of commits down. Larger when backed by large pages. */
+#define DYNAMIC_ALLOCATOR_COMMIT_GRANULARITY MEBIBYTES(1)
+
 /** @brief The dynamic allocator structure. */
 typedef struct dynamic_allocator {
     /** @brief The allocated memory block for this allocator to use. */
@@ -31,6 +34,22 @@ typedef struct dynamic_allocator {
  */
 KAPI b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memory, dynamic_allocator* out_allocator);
 
+/**
+ * @brief Creates a new dynamic allocator over a block of memory which has only been reserved
+ * (see platform_memory_reserve). The allocator's state is committed when it is created, and
+ * the rest of the block as allocations first reach into it, so the memory the allocator takes
+ * up follows the most it has had allocated at once rather than its total size. Called twice,
+ * as dynamic_allocator_create is.
+ *
+ * @param total_size The total size in bytes the allocator should hold. Note this size does _not_ include the size of the internal state.
+ * @param memory_requirement A pointer to hold the required memory for the internal state _plus_ total_size.
+ * @param memory A reserved block of memory, or 0 if just obtaining the requirement.
+ * @param large_pages Indicates if the block is backed by large pages, which are then committed whole.
+ * @param out_allocator A pointer to hold the allocator.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 dynamic_allocator_create_reserved(u64 total_size, u64* memory_requirement, void* memory, b8 large_pages, dynamic_allocator* out_allocator);
+
 /**
  * @brief Destroys the given allocator.
  *
@@ -89,6 +108,18 @@ KAPI b8 dynamic_allocator_free_aligned(dynamic_allocator* allocator, void* block
  */
 KAPI b8 dynamic_allocator_get_size_alignment(void* block, u64* out_size, u16* out_alignment);
 
+/**
+ * @brief Changes the size of the given block. Shrinking, and growing into free space directly
+ * after the block, happen in place. Otherwise a new block with the same alignment is allocated,
+ * the contents copied to it and the old block freed. Bytes beyond the old size are not cleared.
+ *
+ * @param allocator A pointer to the allocator the block belongs to.
+ * @param block The block to be resized.
+ * @param new_size The new size in bytes. Must be greater than 0.
+ * @return A pointer to the block, which may have moved, or 0 on failure, in which case the block is left as it is.
+ */
+KAPI void* dynamic_allocator_reallocate(dynamic_allocator* allocator, void* block, u64 new_size);
+
 /**
  * @brief Obtains the amount of free space left in the provided allocator.
  *
@@ -97,6 +128,15 @@ KAPI b8 dynamic_allocator_get_size_alignment(void* block, u64* out_size, u16* ou
  */
 KAPI u64 dynamic_allocator_free_space(dynamic_allocator* allocator);
 
+/**
+ * @brief Obtains the fragmentation of the free space in the provided allocator.
+ * @see freelist_fragmentation
+ *
+ * @param allocator A pointer to the allocator to be examined.
+ * @return The fragmentation in the range [0, 1].
+ */
+KAPI f32 dynamic_allocator_fragmentation(dynamic_allocator* allocator);
+
 /**
  * @brief Obtains the amount of total space originally available in the provided allocator.
  *
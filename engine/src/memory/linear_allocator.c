@@ -1,13 +1,29 @@
 #include "linear_allocator.h"
 
+#include "core/katomic.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
+#include "platform/platform.h"
+
+// The memory committed to a reserved allocator is tracked as a single allocation, resized as it changes.
+static void committed_report(u64 old_size, u64 new_size) {
+    if (old_size) {
+        kfree_report(old_size, MEMORY_TAG_LINEAR_ALLOCATOR);
+    }
+    if (new_size) {
+        kallocate_report(new_size, MEMORY_TAG_LINEAR_ALLOCATOR);
+    }
+}
 
 void linear_allocator_create(u64 total_size, void* memory, linear_allocator* out_allocator) {
     if (out_allocator) {
         out_allocator->total_size = total_size;
         out_allocator->allocated = 0;
         out_allocator->owns_memory = memory == 0;
+        out_allocator->is_reserved = false;
+        out_allocator->committed = total_size;
+        out_allocator->large_pages = false;
+        out_allocator->commit_granularity = LINEAR_ALLOCATOR_COMMIT_GRANULARITY;
         if (memory) {
             out_allocator->memory = memory;
         } else {
@@ -15,18 +31,86 @@ void linear_allocator_create(u64 total_size, void* memory, linear_allocator* out
         }
     }
 }
+
+b8 linear_allocator_create_reserved(u64 reserve_size, b8 large_pages, linear_allocator* out_allocator) {
+    if (!out_allocator || !reserve_size) {
+        KERROR("linear_allocator_create_reserved requires a valid pointer to out_allocator and a reserve_size > 0.");
+        return false;
+    }
+    out_allocator->large_pages = false;
+    out_allocator->commit_granularity = LINEAR_ALLOCATOR_COMMIT_GRANULARITY;
+    if (large_pages) {
+        // Reserved as whole large pages, so it is released as them too.
+        u64 large_page_size = platform_memory_large_page_size();
+        if (large_page_size) {
+            reserve_size = (reserve_size + large_page_size - 1) & ~(large_page_size - 1);
+        }
+        out_allocator->memory = platform_memory_reserve_large(reserve_size, &out_allocator->large_pages);
+        if (out_allocator->large_pages) {
+            // Commits of whole large pages let the system back them with one as they are touched.
+            out_allocator->commit_granularity = KMAX(large_page_size, LINEAR_ALLOCATOR_COMMIT_GRANULARITY);
+        }
+    } else {
+        out_allocator->memory = platform_memory_reserve(reserve_size);
+    }
+    if (!out_allocator->memory) {
+        KERROR("linear_allocator_create_reserved - unable to reserve %lluB.", reserve_size);
+        return false;
+    }
+    out_allocator->total_size = reserve_size;
+    out_allocator->allocated = 0;
+    out_allocator->owns_memory = true;
+    out_allocator->is_reserved = true;
+    out_allocator->committed = 0;
+    return true;
+}
+
 void linear_allocator_destroy(linear_allocator* allocator) {
     if (allocator) {
         allocator->allocated = 0;
         if (allocator->owns_memory && allocator->memory) {
-            kfree(allocator->memory, allocator->total_size, MEMORY_TAG_LINEAR_ALLOCATOR);
+            if (allocator->is_reserved) {
+                committed_report(allocator->committed, 0);
+                platform_memory_release(allocator->memory, allocator->total_size);
+            } else {
+                kfree(allocator->memory, allocator->total_size, MEMORY_TAG_LINEAR_ALLOCATOR);
+            }
         }
         allocator->memory = 0;
         allocator->total_size = 0;
         allocator->owns_memory = false;
+        allocator->is_reserved = false;
+        allocator->committed = 0;
+        allocator->large_pages = false;
     }
 }
 
+b8 linear_allocator_commit(linear_allocator* allocator, u64 size) {
+    if (size > allocator->total_size) {
+        return false;
+    }
+    if (!allocator->is_reserved) {
+        return true;
+    }
+
+    u64 committed = katomic_load_u64(&allocator->committed, KATOMIC_ORDER_ACQUIRE);
+    while (committed < size) {
+        u64 target = (size + allocator->commit_granularity - 1) & ~(allocator->commit_granularity - 1);
+        target = KMIN(target, allocator->total_size);
+        // Committing pages another thread is also committing is harmless, so whichever gets
+        // there first publishes the new size.
+        if (!platform_memory_commit((u8*)allocator->memory + committed, target - committed)) {
+            KERROR("linear_allocator_commit - unable to commit memory up to %lluB.", target);
+            return false;
+        }
+        if (katomic_compare_exchange_u64(&allocator->committed, &committed, target, KATOMIC_ORDER_ACQ_REL)) {
+            committed_report(committed, target);
+            return true;
+        }
+    }
+    return true;
+}
+
 void* linear_allocator_allocate(linear_allocator* allocator, u64 size) {
     if (allocator && allocator->memory) {
         if (allocator->allocated + size > allocator->total_size) {
@@ -34,6 +118,9 @@ void* linear_allocator_allocate(linear_allocator* allocator, u64 size) {
             KERROR("linear_allocator_allocate - Tried to allocate %lluB, only %lluB remaining.", size, remaining);
             return 0;
         }
+        if (allocator->allocated + size > allocator->committed && !linear_allocator_commit(allocator, allocator->allocated + size)) {
+            return 0;
+        }
 
         void* block = ((u8*)allocator->memory) + allocator->allocated;
         allocator->allocated += size;
@@ -48,7 +135,33 @@ void linear_allocator_free_all(linear_allocator* allocator, b8 clear) {
     if (allocator && allocator->memory) {
         allocator->allocated = 0;
         if (clear) {
-            kzero_memory(allocator->memory, allocator->total_size);
+            // Only what is committed can be touched.
+            kzero_memory(allocator->memory, allocator->committed);
         }
     }
 }
+
+u64 linear_allocator_marker_get(linear_allocator* allocator) {
+    return allocator ? allocator->allocated : 0;
+}
+
+void linear_allocator_free_to_marker(linear_allocator* allocator, u64 marker) {
+    if (allocator && marker < allocator->allocated) {
+        allocator->allocated = marker;
+    }
+}
+
+void linear_allocator_trim(linear_allocator* allocator, u64 retain_size) {
+    // NOTE: Large pages are not always able to be decommitted, and breaking them up would defeat them anyway.
+    if (!allocator || !allocator->memory || !allocator->is_reserved || allocator->large_pages) {
+        return;
+    }
+    u64 keep = KMAX(allocator->allocated, retain_size);
+    keep = (keep + allocator->commit_granularity - 1) & ~(allocator->commit_granularity - 1);
+    if (keep >= allocator->committed) {
+        return;
+    }
+    platform_memory_decommit((u8*)allocator->memory + keep, allocator->committed - keep);
+    committed_report(allocator->committed, keep);
+    allocator->committed = keep;
+}
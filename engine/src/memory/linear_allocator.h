@@ -8,6 +8,9 @@
  * not stored, and thus allocations made in this way are not individually freeable.
  * Only the entire thing can be freed. This comes with the benefit of speed at a cost
  * of flexibility.
+ * An allocator may instead reserve a range of address space, committing memory to it
+ * only as allocations reach it, so it can be made as large as it might ever need to be
+ * while only taking up the memory it actually uses.
  * @version 1.0
  * @date 2022-01-10
  *
@@ -19,6 +22,9 @@
 
 #include "defines.h"
 
+/** @brief The granularity reserved allocators commit memory in, to keep the number of commits down. Larger when backed by large pages. */
+#define LINEAR_ALLOCATOR_COMMIT_GRANULARITY KIBIBYTES(64)
+
 /**
  * @brief The data structure for a linear allocator.
  */
@@ -34,6 +40,14 @@ typedef struct linear_allocator {
      * performed the allocation itself) or whether it was provided by an outside source.
      */
     b8 owns_memory;
+    /** @brief Indicates if the memory is a reserved range, committed as it is needed. */
+    b8 is_reserved;
+    /** @brief The amount of memory committed so far. Always total_size unless reserved. */
+    u64 committed;
+    /** @brief Indicates if the reserved memory is backed by large pages, as they were asked for and granted. */
+    b8 large_pages;
+    /** @brief The granularity memory is committed in, if reserved. */
+    u64 commit_granularity;
 } linear_allocator;
 
 /**
@@ -46,6 +60,18 @@ typedef struct linear_allocator {
  */
 KAPI void linear_allocator_create(u64 total_size, void* memory, linear_allocator* out_allocator);
 
+/**
+ * @brief Creates a linear allocator which reserves a range of address space of the given size,
+ * and commits memory to it as allocations reach it.
+ *
+ * @param reserve_size The most in bytes the allocator will ever hold.
+ * @param large_pages Indicates if the range should be backed by large pages if the system grants them
+ * (see platform_memory_reserve_large). Whether it was is held in large_pages.
+ * @param out_allocator A pointer to hold the new allocator.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 linear_allocator_create_reserved(u64 reserve_size, b8 large_pages, linear_allocator* out_allocator);
+
 /**
  * @brief Destroys the given allocator. If the allocator owns its memory, it is freed at this time.
  *
@@ -70,3 +96,41 @@ KAPI void* linear_allocator_allocate(linear_allocator* allocator, u64 size);
  * @param clear Indicates whether or not to clear/zero the memory. Enabling this obviously takes more processing power.
  */
 KAPI void linear_allocator_free_all(linear_allocator* allocator, b8 clear);
+
+/**
+ * @brief Obtains a marker of the current position of the allocator, which can later be returned
+ * to with linear_allocator_free_to_marker. Markers are restored in the reverse of the order they
+ * are obtained, which lets the allocator be used as a stack of nested temporary allocations.
+ *
+ * @param allocator A pointer to the allocator.
+ * @return The marker.
+ */
+KAPI u64 linear_allocator_marker_get(linear_allocator* allocator);
+
+/**
+ * @brief Frees everything allocated since the given marker was obtained.
+ *
+ * @param allocator A pointer to the allocator.
+ * @param marker A marker obtained from linear_allocator_marker_get.
+ */
+KAPI void linear_allocator_free_to_marker(linear_allocator* allocator, u64 marker);
+
+/**
+ * @brief Ensures the memory of the given allocator is committed up to the given offset from its
+ * start. Allocations do this themselves, but it is here for those which take memory by moving
+ * allocated along directly. Safe to call from multiple threads at once.
+ *
+ * @param allocator A pointer to the allocator.
+ * @param size The offset up to which memory is required.
+ * @return True if the memory is committed; otherwise false, including if size is beyond total_size.
+ */
+KAPI b8 linear_allocator_commit(linear_allocator* allocator, u64 size);
+
+/**
+ * @brief Returns the committed memory of a reserved allocator which is beyond both what is
+ * allocated and the given amount to the system. Does nothing for other allocators.
+ *
+ * @param allocator A pointer to the allocator.
+ * @param retain_size The amount in bytes to keep committed, even if not allocated, to be reused.
+ */
+KAPI void linear_allocator_trim(linear_allocator* allocator, u64 retain_size);
@@ -0,0 +1,145 @@
+#include "pool_allocator.h"
+
+#include "core/katomic.h"
+#include "core/logger.h"
+
+// The link to the next free block is stored as an index within the block itself.
+#define BLOCK_NEXT(allocator, index) (*(u32*)((u8*)(allocator)->memory + ((u64)(index) * (allocator)->block_size)))
+
+static u64 pool_allocator_block_size(u64 block_size) {
+    // Must be able to hold the free list link, and keep blocks 8-byte aligned.
+    if (block_size < sizeof(u64)) {
+        block_size = sizeof(u64);
+    }
+    return (block_size + 7) & ~(u64)7;
+}
+
+static void pool_allocator_build_free_list(pool_allocator* allocator) {
+    for (u32 i = 0; i < allocator->block_count; ++i) {
+        BLOCK_NEXT(allocator, i) = (i + 1 < allocator->block_count) ? i + 1 : INVALID_ID;
+    }
+    allocator->free_head = allocator->block_count ? 0 : INVALID_ID;
+    allocator->allocated_count = 0;
+}
+
+u64 pool_allocator_memory_requirement(u64 block_size, u32 block_count) {
+    return pool_allocator_block_size(block_size) * block_count;
+}
+
+b8 pool_allocator_create(u64 block_size, u32 block_count, void* memory, memory_tag tag, b8 thread_safe, pool_allocator* out_allocator) {
+    if (!out_allocator) {
+        KERROR("pool_allocator_create requires a valid pointer to out_allocator.");
+        return false;
+    }
+    if (block_size == 0 || block_count == 0 || block_count == INVALID_ID) {
+        KERROR("pool_allocator_create - block_size must be nonzero and block_count must be in the range [1, %u).", INVALID_ID);
+        return false;
+    }
+
+    out_allocator->block_size = pool_allocator_block_size(block_size);
+    out_allocator->block_count = block_count;
+    out_allocator->tag = tag;
+    out_allocator->thread_safe = thread_safe;
+    out_allocator->owns_memory = memory == 0;
+    if (memory) {
+        out_allocator->memory = memory;
+    } else {
+        out_allocator->memory = kallocate(out_allocator->block_size * block_count, tag);
+    }
+
+    pool_allocator_build_free_list(out_allocator);
+    return true;
+}
+
+void pool_allocator_destroy(pool_allocator* allocator) {
+    if (allocator) {
+        if (allocator->owns_memory && allocator->memory) {
+            kfree(allocator->memory, allocator->block_size * allocator->block_count, allocator->tag);
+        }
+        allocator->memory = 0;
+        allocator->block_size = 0;
+        allocator->block_count = 0;
+        allocator->allocated_count = 0;
+        allocator->free_head = INVALID_ID;
+        allocator->owns_memory = false;
+    }
+}
+
+void* pool_allocator_allocate(pool_allocator* allocator) {
+    if (!allocator || !allocator->memory) {
+        KERROR("pool_allocator_allocate - provided allocator not initialized.");
+        return 0;
+    }
+
+    u32 index;
+    if (allocator->thread_safe) {
+        u64 old_head = katomic_load_u64(&allocator->free_head, KATOMIC_ORDER_ACQUIRE);
+        u64 new_head;
+        do {
+            index = (u32)old_head;
+            if (index == INVALID_ID) {
+                return 0;
+            }
+            // NOTE: The block may be handed out by another thread before the exchange below,
+            // in which case this read is garbage, but the tag then causes the exchange to fail.
+            u32 next = katomic_load_u32((volatile u32*)&BLOCK_NEXT(allocator, index), KATOMIC_ORDER_RELAXED);
+            new_head = (((old_head >> 32) + 1) << 32) | next;
+        } while (!katomic_compare_exchange_u64(&allocator->free_head, &old_head, new_head, KATOMIC_ORDER_ACQUIRE));
+        katomic_fetch_add_u32(&allocator->allocated_count, 1, KATOMIC_ORDER_RELAXED);
+    } else {
+        index = (u32)allocator->free_head;
+        if (index == INVALID_ID) {
+            return 0;
+        }
+        allocator->free_head = BLOCK_NEXT(allocator, index);
+        allocator->allocated_count++;
+    }
+
+    return (u8*)allocator->memory + ((u64)index * allocator->block_size);
+}
+
+b8 pool_allocator_free(pool_allocator* allocator, void* block) {
+    if (!allocator || !allocator->memory || !block) {
+        KERROR("pool_allocator_free requires a valid allocator and block.");
+        return false;
+    }
+
+    u64 offset = (u64)((u8*)block - (u8*)allocator->memory);
+    if ((u8*)block < (u8*)allocator->memory || offset >= allocator->block_size * allocator->block_count || offset % allocator->block_size != 0) {
+        KERROR("pool_allocator_free - block %p does not belong to this pool.", block);
+        return false;
+    }
+    u32 index = (u32)(offset / allocator->block_size);
+
+    if (allocator->thread_safe) {
+        u64 old_head = katomic_load_u64(&allocator->free_head, KATOMIC_ORDER_RELAXED);
+        u64 new_head;
+        do {
+            katomic_store_u32((volatile u32*)&BLOCK_NEXT(allocator, index), (u32)old_head, KATOMIC_ORDER_RELAXED);
+            new_head = (((old_head >> 32) + 1) << 32) | index;
+        } while (!katomic_compare_exchange_u64(&allocator->free_head, &old_head, new_head, KATOMIC_ORDER_RELEASE));
+        katomic_fetch_sub_u32(&allocator->allocated_count, 1, KATOMIC_ORDER_RELAXED);
+    } else {
+        BLOCK_NEXT(allocator, index) = (u32)allocator->free_head;
+        allocator->free_head = index;
+        allocator->allocated_count--;
+    }
+
+    return true;
+}
+
+void pool_allocator_free_all(pool_allocator* allocator, b8 clear) {
+    if (allocator && allocator->memory) {
+        if (clear) {
+            kzero_memory(allocator->memory, allocator->block_size * allocator->block_count);
+        }
+        pool_allocator_build_free_list(allocator);
+    }
+}
+
+u32 pool_allocator_free_count(pool_allocator* allocator) {
+    if (!allocator || !allocator->memory) {
+        return 0;
+    }
+    return allocator->block_count - katomic_load_u32(&allocator->allocated_count, KATOMIC_ORDER_RELAXED);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file pool_allocator.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains the pool allocator implementation.
+ * @details A pool allocator hands out fixed-size blocks from its internal block of memory.
+ * Free blocks are kept in an intrusive free list (the link is stored within the free block
+ * itself), so both allocation and freeing are O(1) with no per-block overhead. Optionally,
+ * the allocator can be made thread-safe, in which case the free list is lock-free.
+ * @version 1.0
+ * @date 2023-11-14
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "core/kmemory.h"
+#include "defines.h"
+
+/**
+ * @brief The data structure for a pool allocator.
+ */
+typedef struct pool_allocator {
+    /** @brief The size of each block in bytes. Rounded up to a multiple of 8. */
+    u64 block_size;
+    /** @brief The total number of blocks in the pool. */
+    u32 block_count;
+    /** @brief The number of blocks currently allocated. */
+    volatile u32 allocated_count;
+    /**
+     * @brief The head of the free list. The lower 32 bits hold the index of the first free block,
+     * and the upper 32 bits hold a tag which is incremented on each change to guard against ABA.
+     */
+    volatile u64 free_head;
+    /** @brief The internal block of memory used by the allocator. */
+    void* memory;
+    /** @brief The memory tag the internal block is reported under, if owned. */
+    memory_tag tag;
+    /**
+     * @brief Indicates if the allocator owns the memory (meaning it
+     * performed the allocation itself) or whether it was provided by an outside source.
+     */
+    b8 owns_memory;
+    /** @brief Indicates if allocations/frees may happen from multiple threads at once. */
+    b8 thread_safe;
+} pool_allocator;
+
+/**
+ * @brief Obtains the amount of memory required for a pool of the given block size and count.
+ *
+ * @param block_size The size of each block in bytes.
+ * @param block_count The number of blocks.
+ * @return The required memory in bytes.
+ */
+KAPI u64 pool_allocator_memory_requirement(u64 block_size, u32 block_count);
+
+/**
+ * @brief Creates a pool allocator of the given block size and count.
+ *
+ * @param block_size The size of each block in bytes. Rounded up to a multiple of 8.
+ * @param block_count The number of blocks the pool holds.
+ * @param memory Allocated block of memory of at least pool_allocator_memory_requirement bytes, or 0. If 0,
+ * a dynamic allocation is performed using the given tag and this allocator is considered to own that memory.
+ * @param tag The memory tag to report the owned memory under. Ignored if memory is provided.
+ * @param thread_safe Indicates if the pool may be allocated from/freed to by multiple threads at once.
+ * @param out_allocator A pointer to hold the new allocator.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 pool_allocator_create(u64 block_size, u32 block_count, void* memory, memory_tag tag, b8 thread_safe, pool_allocator* out_allocator);
+
+/**
+ * @brief Destroys the given allocator. If the allocator owns its memory, it is freed at this time.
+ *
+ * @param allocator A pointer to the allocator to be destroyed.
+ */
+KAPI void pool_allocator_destroy(pool_allocator* allocator);
+
+/**
+ * @brief Allocates a single block from the allocator.
+ *
+ * @param allocator A pointer to the allocator to allocate from.
+ * @return A pointer to the block of memory. If the pool is exhausted, 0 is returned.
+ */
+KAPI void* pool_allocator_allocate(pool_allocator* allocator);
+
+/**
+ * @brief Returns the given block to the allocator.
+ *
+ * @param allocator A pointer to the allocator the block was allocated from.
+ * @param block The block to be freed.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 pool_allocator_free(pool_allocator* allocator, void* block);
+
+/**
+ * @brief Returns all blocks to the allocator at once. Not thread-safe, even for thread-safe pools.
+ *
+ * @param allocator A pointer to the allocator to free.
+ * @param clear Indicates whether or not to clear/zero the memory. Enabling this obviously takes more processing power.
+ */
+KAPI void pool_allocator_free_all(pool_allocator* allocator, b8 clear);
+
+/**
+ * @brief Obtains the number of blocks still available in the given allocator.
+ *
+ * @param allocator A pointer to the allocator to check.
+ * @return The number of free blocks.
+ */
+KAPI u32 pool_allocator_free_count(pool_allocator* allocator);
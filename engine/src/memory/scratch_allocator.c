@@ -0,0 +1,106 @@
+#include "scratch_allocator.h"
+
+#include "core/frame_data.h"
+#include "core/logger.h"
+#include "memory/linear_allocator.h"
+
+#define SCRATCH_ALIGNMENT 16
+
+static _Thread_local linear_allocator thread_scratch;
+// The allocator set in place of the thread's own, if any.
+static _Thread_local linear_allocator* current_scratch = 0;
+
+static linear_allocator* thread_scratch_current(void) {
+    return current_scratch ? current_scratch : &thread_scratch;
+}
+
+static linear_allocator* thread_scratch_get(void) {
+    linear_allocator* allocator = thread_scratch_current();
+    if (!allocator->memory && !linear_allocator_create_reserved(SCRATCH_ALLOCATOR_RESERVE_SIZE, false, allocator)) {
+        KERROR("Unable to reserve scratch memory for this thread.");
+        return 0;
+    }
+    return allocator;
+}
+
+static void* scratch_int_allocate(u64 size) {
+    linear_allocator* allocator = thread_scratch_get();
+    if (!allocator) {
+        return 0;
+    }
+    allocator->allocated = (allocator->allocated + SCRATCH_ALIGNMENT - 1) & ~(u64)(SCRATCH_ALIGNMENT - 1);
+    return linear_allocator_allocate(allocator, size);
+}
+
+static void scratch_int_free(void* block, u64 size) {
+    // Only the latest block can be given back.
+    linear_allocator* allocator = thread_scratch_current();
+    if (block && (u8*)block + size == (u8*)allocator->memory + allocator->allocated) {
+        allocator->allocated -= size;
+    }
+}
+
+static void scratch_int_free_all(void) {
+    // NOTE: Scratch memory is only ever released by ending a scope.
+}
+
+static b8 scratch_int_grow(void* block, u64 size, u64 new_size) {
+    linear_allocator* allocator = thread_scratch_current();
+    if (!block || (u8*)block + size != (u8*)allocator->memory + allocator->allocated) {
+        return false;
+    }
+    u64 end = allocator->allocated - size + new_size;
+    if (end > allocator->total_size || !linear_allocator_commit(allocator, end)) {
+        return false;
+    }
+    allocator->allocated = end;
+    return true;
+}
+
+static frame_allocator_int scratch_interface = {
+    scratch_int_allocate,
+    scratch_int_free,
+    scratch_int_free_all,
+    scratch_int_grow};
+
+scratch_scope scratch_begin(void) {
+    scratch_scope scope = {0};
+    scope.allocator = thread_scratch_get();
+    scope.marker = linear_allocator_marker_get(scope.allocator);
+    return scope;
+}
+
+void* scratch_allocate(scratch_scope* scope, u64 size) {
+    if (!scope || !scope->allocator) {
+        return 0;
+    }
+    return scratch_int_allocate(size);
+}
+
+void scratch_end(scratch_scope* scope) {
+    if (!scope || !scope->allocator) {
+        return;
+    }
+    linear_allocator_free_to_marker(scope->allocator, scope->marker);
+    // Once nothing is in use, hand back all but enough to be reused cheaply.
+    if (scope->marker == 0) {
+        linear_allocator_trim(scope->allocator, SCRATCH_ALLOCATOR_RETAIN_SIZE);
+    }
+    scope->allocator = 0;
+}
+
+frame_allocator_int* scratch_allocator_int(void) {
+    return &scratch_interface;
+}
+
+linear_allocator* scratch_allocator_set(linear_allocator* allocator) {
+    linear_allocator* previous = current_scratch;
+    current_scratch = allocator;
+    return previous;
+}
+
+void scratch_thread_shutdown(void) {
+    if (thread_scratch.memory) {
+        linear_allocator_destroy(&thread_scratch);
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * @file scratch_allocator.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Per-thread scratch memory for temporary allocations, released all at once at the end
+ * of the scope which took them.
+ * @details Each thread has its own linear allocator over a large reserved range, used as a
+ * stack: a scope records the allocator's position when it begins, and returns to it when it
+ * ends, freeing everything allocated within it. Scopes nest, so a function can begin its own
+ * scope while its caller's is open, as long as the inner one ends first. Allocation is a
+ * pointer bump with no lock, and there is nothing to free individually, so it suits the many
+ * short-lived buffers of loading and importing assets. Scratch memory must not outlive the
+ * scope it was taken in, nor be handed to another thread to free.
+ * @version 1.0
+ * @date 2023-12-14
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+struct frame_allocator_int;
+struct linear_allocator;
+
+/** @brief The most scratch memory each thread may hold at once. Only what is used is committed. */
+#define SCRATCH_ALLOCATOR_RESERVE_SIZE GIBIBYTES(4)
+/** @brief The scratch memory a thread keeps committed once its outermost scope ends, to be reused. */
+#define SCRATCH_ALLOCATOR_RETAIN_SIZE MEBIBYTES(4)
+
+/** @brief An open scope of the calling thread's scratch memory. */
+typedef struct scratch_scope {
+    /** @brief The thread's scratch allocator. */
+    struct linear_allocator* allocator;
+    /** @brief The position of the allocator when the scope began. */
+    u64 marker;
+} scratch_scope;
+
+/**
+ * @brief Begins a scope of the calling thread's scratch memory, creating the thread's scratch
+ * allocator the first time.
+ *
+ * @return The scope, which must be ended with scratch_end on the same thread.
+ */
+KAPI scratch_scope scratch_begin(void);
+
+/**
+ * @brief Allocates from the given scope's scratch memory. The memory is 16-byte aligned, but
+ * not cleared.
+ *
+ * @param scope A pointer to the scope, which must be the innermost open one of the thread.
+ * @param size The size to allocate in bytes.
+ * @return A pointer to the memory, or 0 if the thread's scratch memory is used up.
+ */
+KAPI void* scratch_allocate(scratch_scope* scope, u64 size);
+
+/**
+ * @brief Ends the given scope, freeing everything allocated from scratch memory since it began,
+ * including by any darrays using scratch_allocator_int.
+ *
+ * @param scope A pointer to the scope.
+ */
+KAPI void scratch_end(scratch_scope* scope);
+
+/**
+ * @brief Obtains an allocator interface over the calling thread's scratch memory, such as for
+ * darray_create_with_allocator. Blocks it hands out belong to the innermost scope open when they
+ * are allocated, and so must be used on the thread they were allocated on. The latest block can
+ * grow in place, and is given back when freed.
+ *
+ * @return A pointer to the interface.
+ */
+KAPI struct frame_allocator_int* scratch_allocator_int(void);
+
+/**
+ * @brief Sets the scratch allocator the calling thread uses, for a context of work which is
+ * switched in and out of on the thread, such as a fiber, whose scopes would otherwise interleave
+ * with those of others. An allocator which is zeroed out reserves its memory once first used,
+ * and should be destroyed with linear_allocator_destroy once done with.
+ *
+ * @param allocator A pointer to the allocator to use, or 0 to go back to the thread's own.
+ * @return A pointer to the allocator which was in use before, or 0 if it was the thread's own.
+ */
+KAPI struct linear_allocator* scratch_allocator_set(struct linear_allocator* allocator);
+
+/**
+ * @brief Releases the calling thread's scratch memory. Should be called by threads which have
+ * used scratch memory before they exit. Any scratch memory still in use becomes invalid.
+ */
+KAPI void scratch_thread_shutdown(void);
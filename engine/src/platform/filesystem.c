@@ -2,12 +2,23 @@
 
 #include "core/logger.h"
 #include "core/kmemory.h"
+#include "platform/platform.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
-b8 filesystem_exists(const char* path) {
+// The contents of a file opened from the filesystem source.
+typedef struct memory_file {
+    const u8* data;
+    u64 size;
+    u64 position;
+    b8 owned;
+} memory_file;
+
+static filesystem_source source;
+
+static b8 disk_exists(const char* path) {
 #ifdef _MSC_VER
     struct _stat buffer;
     return _stat(path, &buffer) == 0;
@@ -17,9 +28,33 @@ b8 filesystem_exists(const char* path) {
 #endif
 }
 
+// Obtains the contents of a file from the source, unless it exists on disk.
+static b8 source_read(const char* path, const u8** out_data, u64* out_size, b8* out_owned) {
+    if (!source.read || disk_exists(path)) {
+        return false;
+    }
+    return source.read(path, out_data, out_size, out_owned, source.user_data);
+}
+
+void filesystem_source_set(const filesystem_source* new_source) {
+    if (new_source) {
+        source = *new_source;
+    } else {
+        kzero_memory(&source, sizeof(filesystem_source));
+    }
+}
+
+b8 filesystem_exists(const char* path) {
+    if (disk_exists(path)) {
+        return true;
+    }
+    return source.exists && source.exists(path, source.user_data);
+}
+
 b8 filesystem_open(const char* path, file_modes mode, b8 binary, file_handle* out_handle) {
     out_handle->is_valid = false;
     out_handle->handle = 0;
+    out_handle->is_memory = false;
     const char* mode_str;
 
     if ((mode & FILE_MODE_READ) != 0 && (mode & FILE_MODE_WRITE) != 0) {
@@ -33,6 +68,19 @@ b8 filesystem_open(const char* path, file_modes mode, b8 binary, file_handle* ou
         return false;
     }
 
+    // Files only provided by the source can be read, but not written.
+    if (mode == FILE_MODE_READ) {
+        memory_file contents = {0};
+        if (source_read(path, &contents.data, &contents.size, &contents.owned)) {
+            memory_file* file = kallocate(sizeof(memory_file), MEMORY_TAG_RESOURCE);
+            *file = contents;
+            out_handle->handle = file;
+            out_handle->is_memory = true;
+            out_handle->is_valid = true;
+            return true;
+        }
+    }
+
     // Attempt to open the file.
     FILE* file = fopen(path, mode_str);
     if (!file) {
@@ -47,7 +95,16 @@ b8 filesystem_open(const char* path, file_modes mode, b8 binary, file_handle* ou
 }
 
 void filesystem_close(file_handle* handle) {
-    if (handle->handle) {
+    if (handle->handle && handle->is_memory) {
+        memory_file* file = handle->handle;
+        if (file->owned) {
+            kfree((void*)file->data, file->size, MEMORY_TAG_RESOURCE);
+        }
+        kfree(file, sizeof(memory_file), MEMORY_TAG_RESOURCE);
+        handle->handle = 0;
+        handle->is_valid = false;
+        handle->is_memory = false;
+    } else if (handle->handle) {
         fclose((FILE*)handle->handle);
         handle->handle = 0;
         handle->is_valid = false;
@@ -55,6 +112,13 @@ void filesystem_close(file_handle* handle) {
 }
 
 b8 filesystem_size(file_handle* handle, u64* out_size) {
+    if (handle->handle && handle->is_memory) {
+        memory_file* file = handle->handle;
+        *out_size = file->size;
+        // Matches the rewind done for files on disk.
+        file->position = 0;
+        return true;
+    }
     if (handle->handle) {
         fseek((FILE*)handle->handle, 0, SEEK_END);
         *out_size = ftell((FILE*)handle->handle);
@@ -65,6 +129,25 @@ b8 filesystem_size(file_handle* handle, u64* out_size) {
 }
 
 b8 filesystem_read_line(file_handle* handle, u64 max_length, char** line_buf, u64* out_line_length) {
+    if (handle->handle && handle->is_memory && line_buf && out_line_length && max_length > 0) {
+        // Behaves like fgets, keeping the newline.
+        memory_file* file = handle->handle;
+        if (file->position >= file->size) {
+            return false;
+        }
+        char* buf = *line_buf;
+        u64 length = 0;
+        while (length < max_length - 1 && file->position < file->size) {
+            char c = (char)file->data[file->position++];
+            buf[length++] = c;
+            if (c == '\n') {
+                break;
+            }
+        }
+        buf[length] = 0;
+        *out_line_length = length;
+        return true;
+    }
     if (handle->handle && line_buf && out_line_length && max_length > 0) {
         char* buf = *line_buf;
         if (fgets(buf, max_length, (FILE*)handle->handle) != 0) {
@@ -76,7 +159,7 @@ b8 filesystem_read_line(file_handle* handle, u64 max_length, char** line_buf, u6
 }
 
 b8 filesystem_write_line(file_handle* handle, const char* text) {
-    if (handle->handle) {
+    if (handle->handle && !handle->is_memory) {
         i32 result = fputs(text, (FILE*)handle->handle);
         if (result != EOF) {
             result = fputc('\n', (FILE*)handle->handle);
@@ -90,7 +173,19 @@ b8 filesystem_write_line(file_handle* handle, const char* text) {
     return false;
 }
 
+// Reads from the current position of a memory file, like fread.
+static u64 memory_file_read(memory_file* file, u64 size, void* out_data) {
+    u64 count = KMIN(size, file->size - file->position);
+    kcopy_memory(out_data, file->data + file->position, count);
+    file->position += count;
+    return count;
+}
+
 b8 filesystem_read(file_handle* handle, u64 data_size, void* out_data, u64* out_bytes_read) {
+    if (handle->handle && handle->is_memory && out_data) {
+        *out_bytes_read = memory_file_read(handle->handle, data_size, out_data);
+        return *out_bytes_read == data_size;
+    }
     if (handle->handle && out_data) {
         *out_bytes_read = fread(out_data, 1, data_size, (FILE*)handle->handle);
         if (*out_bytes_read != data_size) {
@@ -109,7 +204,11 @@ b8 filesystem_read_all_bytes(file_handle* handle, u8* out_bytes, u64* out_bytes_
             return false;
         }
 
-        *out_bytes_read = fread(out_bytes, 1, size, (FILE*)handle->handle);
+        if (handle->is_memory) {
+            *out_bytes_read = memory_file_read(handle->handle, size, out_bytes);
+        } else {
+            *out_bytes_read = fread(out_bytes, 1, size, (FILE*)handle->handle);
+        }
         return *out_bytes_read == size;
     }
     return false;
@@ -123,14 +222,18 @@ b8 filesystem_read_all_text(file_handle* handle, char* out_text, u64* out_bytes_
             return false;
         }
 
-        *out_bytes_read = fread(out_text, 1, size, (FILE*)handle->handle);
+        if (handle->is_memory) {
+            *out_bytes_read = memory_file_read(handle->handle, size, out_text);
+        } else {
+            *out_bytes_read = fread(out_text, 1, size, (FILE*)handle->handle);
+        }
         return true;//*out_bytes_read == size;
     }
     return false;
 }
 
 b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* out_bytes_written) {
-    if (handle->handle) {
+    if (handle->handle && !handle->is_memory) {
         *out_bytes_written = fwrite(data, 1, data_size, (FILE*)handle->handle);
         if (*out_bytes_written != data_size) {
             return false;
@@ -140,3 +243,68 @@ b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* o
     }
     return false;
 }
+
+b8 filesystem_map(const char* path, u64 offset, u64 size, file_mapping* out_mapping) {
+    if (!path || !out_mapping) {
+        return false;
+    }
+    kzero_memory(out_mapping, sizeof(file_mapping));
+
+    const u8* data;
+    u64 file_size;
+    b8 owned;
+    if (source_read(path, &data, &file_size, &owned)) {
+        if (offset > file_size || size > file_size - offset || (size == 0 && offset == file_size)) {
+            KERROR("Range of %llu bytes at offset %llu is outside file '%s' of %llu bytes.", size, offset, path, file_size);
+            if (owned) {
+                kfree((void*)data, file_size, MEMORY_TAG_RESOURCE);
+            }
+            return false;
+        }
+        // Data held by the source is used in place. There is no view to unmap in that case.
+        out_mapping->data = data + offset;
+        out_mapping->size = size ? size : file_size - offset;
+        if (owned) {
+            out_mapping->view = (void*)data;
+            out_mapping->view_size = file_size;
+            out_mapping->is_copy = true;
+        }
+        return true;
+    }
+
+    return platform_file_map(path, offset, size, out_mapping);
+}
+
+void filesystem_unmap(file_mapping* mapping) {
+    if (mapping && mapping->view) {
+        if (mapping->is_copy) {
+            kfree(mapping->view, mapping->view_size, MEMORY_TAG_RESOURCE);
+        } else {
+            platform_file_unmap(mapping);
+        }
+        kzero_memory(mapping, sizeof(file_mapping));
+    }
+}
+
+b8 filesystem_read_async(const char* path, pfn_filesystem_read_complete callback, void* user_data) {
+    if (!path || !callback) {
+        return false;
+    }
+
+    const u8* data;
+    u64 size;
+    b8 owned;
+    if (source_read(path, &data, &size, &owned)) {
+        // Already in memory, so there is nothing to wait for. The callback takes ownership
+        // of the data, so copy it if it belongs to the source.
+        u8* copy = (u8*)data;
+        if (!owned) {
+            copy = kallocate(size, MEMORY_TAG_RESOURCE);
+            kcopy_memory(copy, data, size);
+        }
+        callback(true, copy, size, user_data);
+        return true;
+    }
+
+    return platform_file_read_async(path, callback, user_data);
+}
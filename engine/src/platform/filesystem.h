@@ -20,8 +20,64 @@ typedef struct file_handle {
     void* handle;
     /** @brief Indicates if this handle is valid. */
     b8 is_valid;
+    /**
+     * @brief Indicates if the handle reads from memory, e.g. a file provided by the
+     * filesystem source, rather than from a file on disk.
+     */
+    b8 is_memory;
 } file_handle;
 
+/**
+ * @brief A read-only view of a range of a file, mapped into memory. The
+ * mapping is independent of any open file handle, and stays valid until unmapped.
+ */
+typedef struct file_mapping {
+    /** @brief A pointer to the first byte of the mapped range. */
+    const u8* data;
+    /** @brief The size of the mapped range in bytes. */
+    u64 size;
+    /**
+     * @brief The start of the underlying view, which begins at the range's offset
+     * rounded down to the platform's allocation granularity.
+     */
+    void* view;
+    /** @brief The size of the underlying view in bytes. */
+    u64 view_size;
+    /**
+     * @brief Indicates if the view is a buffer owned by the mapping rather than a mapped view,
+     * as for files provided by the filesystem source which aren't held in memory as-is.
+     */
+    b8 is_copy;
+} file_mapping;
+
+/**
+ * @brief A source of files which don't exist on disk, such as mounted asset archives. Files
+ * provided by the source can be opened for reading, mapped and read like any other, while
+ * files on disk at the same path take precedence over them.
+ */
+typedef struct filesystem_source {
+    /**
+     * @brief Checks if the source holds a file at the given path.
+     * @param path The path of the file.
+     * @param user_data The user data of the source.
+     * @returns True if the source holds the file; otherwise false.
+     */
+    b8 (*exists)(const char* path, void* user_data);
+    /**
+     * @brief Obtains the contents of the file at the given path.
+     * @param path The path of the file.
+     * @param out_data A pointer to hold the contents.
+     * @param out_size A pointer to hold the size of the contents in bytes.
+     * @param out_owned A pointer set to true if the contents were allocated for the caller with
+     * MEMORY_TAG_RESOURCE, or false if they are held by the source and stay valid while it is set.
+     * @param user_data The user data of the source.
+     * @returns True if the source holds the file and its contents were obtained; otherwise false.
+     */
+    b8 (*read)(const char* path, const u8** out_data, u64* out_size, b8* out_owned, void* user_data);
+    /** @brief Passed to the functions of the source. */
+    void* user_data;
+} filesystem_source;
+
 /** @brief File open modes. Can be combined. */
 typedef enum file_modes {
     /** Read mode */
@@ -45,6 +101,13 @@ typedef enum file_modes {
         return false;                     \
     }
 
+/**
+ * @brief Sets the source of files which don't exist on disk, replacing any previous one.
+ * Should not be changed while files may be opened on other threads.
+ * @param source A pointer to the source to be copied, or 0 to remove the current one.
+ */
+KAPI void filesystem_source_set(const filesystem_source* source);
+
 /**
  * @brief Checks if a file with the given path exists.
  * @param path The path of the file to be checked.
@@ -133,3 +196,46 @@ KAPI b8 filesystem_read_all_text(file_handle* handle, char* out_text, u64* out_b
  * @returns True if successful; otherwise false.
  */
 KAPI b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* out_bytes_written);
+
+/**
+ * @brief Maps a read-only view of a range of the file located at path into memory,
+ * so its contents can be used in place without being read into a buffer first.
+ * Pages are loaded on first access.
+ * @param path The path of the file to be mapped.
+ * @param offset The offset in bytes from the beginning of the file of the range to be mapped.
+ * @param size The size of the range in bytes. Pass 0 to map everything from offset to the end of the file.
+ * @param out_mapping A pointer to a file_mapping structure which holds the mapping information.
+ * @returns True if successful; otherwise false.
+ */
+KAPI b8 filesystem_map(const char* path, u64 offset, u64 size, file_mapping* out_mapping);
+
+/**
+ * @brief Unmaps a view previously mapped with filesystem_map. The mapped data must no longer be used.
+ * @param mapping A pointer to the file_mapping structure to be unmapped.
+ */
+KAPI void filesystem_unmap(file_mapping* mapping);
+
+/**
+ * @brief A callback made when an asynchronous read started with filesystem_read_async completes.
+ * This is invoked on an I/O thread rather than the thread which started the read, and so should
+ * do little more than hand the data off, e.g. by submitting a job. Reads of files provided by the
+ * filesystem source complete immediately, with the callback made before filesystem_read_async returns.
+ * @param success Indicates if the whole file was read successfully.
+ * @param data A buffer holding the contents of the file, or 0 on failure. Ownership passes to the
+ * callback, which must release it with kfree(data, size, MEMORY_TAG_RESOURCE).
+ * @param size The size of the file in bytes.
+ * @param user_data The user data passed when starting the read.
+ */
+typedef void (*pfn_filesystem_read_complete)(b8 success, u8* data, u64 size, void* user_data);
+
+/**
+ * @brief Starts reading the entire contents of the file located at path without blocking
+ * the calling thread. Many reads may be outstanding at once, which keeps the storage device
+ * busy without parking a thread on each of them.
+ * @param path The path of the file to be read.
+ * @param callback The callback to be made once the read completes. Required.
+ * @param user_data Optional data to be passed to the callback.
+ * @returns True if the read was started, in which case the callback is always made; otherwise
+ * false, in which case it is not made at all.
+ */
+KAPI b8 filesystem_read_async(const char* path, pfn_filesystem_read_complete callback, void* user_data);
@@ -13,7 +13,10 @@
 
 #pragma once
 
+#include "core/input.h"
+#include "core/kthread.h"
 #include "defines.h"
+#include "platform/filesystem.h"
 
 typedef struct platform_system_config {
     /** @brief application_name The name of the application. */
@@ -28,6 +31,23 @@ typedef struct platform_system_config {
     i32 height;
 } platform_system_config;
 
+/** @brief The configuration of a window created in addition to the main one. */
+typedef struct platform_window_config {
+    /** @brief The title of the window. */
+    const char* title;
+    /** @brief The initial x position of the window. */
+    i32 x;
+    /** @brief The initial y position of the window. */
+    i32 y;
+    /** @brief The initial width of the window's client area. */
+    u32 width;
+    /** @brief The initial height of the window's client area. */
+    u32 height;
+} platform_window_config;
+
+/** @brief A window created in addition to the main one. Opaque, as its contents are platform-specific. */
+struct platform_window;
+
 typedef struct dynamic_library_function {
     const char* name;
     void* pfn;
@@ -44,6 +64,32 @@ typedef struct dynamic_library {
     dynamic_library_function* functions;
 } dynamic_library;
 
+/** @brief The sampled state of a gamepad. */
+typedef struct platform_gamepad_state {
+    /** @brief Indicates if a gamepad is connected. Nothing else is set otherwise. */
+    b8 connected;
+    /** @brief The pressed buttons, one bit per gamepad_buttons value. */
+    u32 buttons;
+    /** @brief The raw axis values, indexed by gamepad_axes, in the ranges described there. */
+    f32 axes[GAMEPAD_AXIS_MAX_AXES];
+} platform_gamepad_state;
+
+/** @brief An IPv4 address and port. */
+typedef struct platform_address {
+    /** @brief The address, in host byte order. */
+    u32 ip;
+    /** @brief The port, in host byte order. */
+    u16 port;
+} platform_address;
+
+/** @brief A non-blocking UDP socket. */
+typedef struct platform_socket {
+    /** @brief The platform's handle to the socket. */
+    u64 handle;
+    /** @brief Indicates if the socket is open. */
+    b8 is_open;
+} platform_socket;
+
 typedef enum platform_error_code {
     PLATFORM_ERROR_SUCCESS = 0,
     PLATFORM_ERROR_UNKNOWN = 1,
@@ -73,11 +119,13 @@ void platform_system_shutdown(void* plat_state);
 
 /**
  * @brief Performs any platform-specific message pumping that is required
- * for windowing, etc.
+ * for windowing, etc. Changes to the window's focus and visibility are posted as
+ * EVENT_CODE_WINDOW_FOCUS_CHANGED and EVENT_CODE_WINDOW_VISIBILITY_CHANGED.
  *
+ * @param max_wait_seconds If no messages are waiting, how long to block for one to arrive. 0 returns straight away.
  * @return True on success; otherwise false.
  */
-b8 platform_pump_messages(void);
+b8 platform_pump_messages(f64 max_wait_seconds);
 
 /**
  * @brief Performs platform-specific memory allocation of the given size.
@@ -96,6 +144,72 @@ void* platform_allocate(u64 size, b8 aligned);
  */
 void platform_free(void* block, b8 aligned);
 
+/**
+ * @brief Reserves a range of address space of the given size, without committing any memory
+ * to it. Pages must be committed with platform_memory_commit before they are used.
+ *
+ * @param size The size of the range in bytes. Rounded up to a whole number of pages.
+ * @return A pointer to the start of the range, which is page-aligned, or 0 on failure.
+ */
+void* platform_memory_reserve(u64 size);
+
+/**
+ * @brief Reserves a range of address space as platform_memory_reserve does, but asks for it to be
+ * backed by large pages (see platform_memory_large_page_size), which cut down on TLB misses when
+ * memory is touched all over. Falls back to normal pages if the system does not grant them.
+ * On Linux the range is aligned to a large page and marked for transparent huge pages, which the
+ * kernel uses as pages are committed. On Windows large pages cannot be committed on demand, so
+ * the whole range is committed up front; this needs the "Lock pages in memory" privilege, and
+ * decommitting does nothing.
+ *
+ * @param size The size of the range in bytes. Rounded up to a whole number of large pages.
+ * @param out_large_pages A pointer to hold whether large pages were granted. Required.
+ * @return A pointer to the start of the range, or 0 on failure.
+ */
+void* platform_memory_reserve_large(u64 size, b8* out_large_pages);
+
+/**
+ * @brief Commits memory to the pages of the given part of a reserved range, which read as zero
+ * until written to. Committing pages which are already committed leaves them as they are.
+ *
+ * @param address The start of the part to commit. Rounded down to the start of its page.
+ * @param size The size of the part in bytes. Rounded up to the end of its last page.
+ * @return True on success; otherwise false.
+ */
+b8 platform_memory_commit(void* address, u64 size);
+
+/**
+ * @brief Returns the memory of the pages of the given part of a reserved range to the system,
+ * leaving the range reserved. Their contents are lost.
+ *
+ * @param address The start of the part to decommit. Only whole pages within it are decommitted.
+ * @param size The size of the part in bytes.
+ */
+void platform_memory_decommit(void* address, u64 size);
+
+/**
+ * @brief Releases a range reserved with platform_memory_reserve, along with any memory committed to it.
+ *
+ * @param address The start of the range, as returned by platform_memory_reserve.
+ * @param size The size the range was reserved with.
+ */
+void platform_memory_release(void* address, u64 size);
+
+/**
+ * @brief Obtains the size of a page, the unit memory is committed and decommitted in.
+ *
+ * @return The size of a page in bytes.
+ */
+u64 platform_memory_page_size(void);
+
+/**
+ * @brief Obtains the size of a large page, or 0 if the system has none. Memory reserved with
+ * platform_memory_reserve_large is best committed in multiples of this.
+ *
+ * @return The size of a large page in bytes, or 0.
+ */
+u64 platform_memory_large_page_size(void);
+
 /**
  * @brief Performs platform-specific zeroing out of the given block of memory.
  *
@@ -159,12 +273,81 @@ f64 platform_get_absolute_time(void);
  */
 KAPI void platform_sleep(u64 ms);
 
+/**
+ * @brief Sleeps the calling thread for the provided number of seconds, using the highest
+ * resolution wait the OS offers. Much more precise than platform_sleep, although the thread
+ * may still wake late by the scheduler's latency. Callers needing to wake at an exact time
+ * should sleep for most of the wait and spin on platform_get_absolute_time() for the rest.
+ *
+ * @param seconds The number of seconds to sleep for.
+ */
+KAPI void platform_sleep_precise(f64 seconds);
+
 /**
  * @brief Obtains the number of logical processor cores.
  *
  * @return The number of logical processor cores.
  */
-i32 platform_get_processor_count(void);
+KAPI i32 platform_get_processor_count(void);
+
+/** @brief The most frames of the call stack written by platform_stack_trace_print. */
+#define PLATFORM_STACK_TRACE_MAX_FRAMES 32
+
+/**
+ * @brief Writes the call stack of the calling thread to the standard error stream, a frame per
+ * line, for diagnostics. Frames are named by symbol where the platform can do so without
+ * allocating, and by address otherwise.
+ *
+ * @param skip_count The number of innermost frames to leave out, i.e. those of the code reporting the trace.
+ */
+KAPI void platform_stack_trace_print(u32 skip_count);
+
+/** @brief The most physical cores tracked by the CPU topology. */
+#define PLATFORM_MAX_CPU_CORES 256
+
+/** @brief The class of a CPU core, on CPUs mixing fast and efficient cores. */
+typedef enum platform_core_class {
+    /** @brief A performance core, or any core of a CPU whose cores are all alike. */
+    PLATFORM_CORE_CLASS_PERFORMANCE,
+    /** @brief An efficiency core, which is slower but draws less power. */
+    PLATFORM_CORE_CLASS_EFFICIENCY
+} platform_core_class;
+
+/** @brief A physical CPU core. */
+typedef struct platform_cpu_core {
+    /** @brief The logical processors of the core, more than one with simultaneous multithreading. */
+    kthread_affinity processors;
+    /** @brief The class of the core. */
+    platform_core_class core_class;
+    /** @brief The NUMA node the core belongs to. */
+    u32 numa_node;
+} platform_cpu_core;
+
+/** @brief The layout of the cores of the CPU(s) available to the process. */
+typedef struct platform_cpu_topology {
+    /** @brief The number of logical processors available. */
+    u32 logical_processor_count;
+    /** @brief The number of physical cores available, of either class. */
+    u32 core_count;
+    /** @brief The number of performance cores. */
+    u32 performance_core_count;
+    /** @brief The number of efficiency cores. Only nonzero on hybrid CPUs. */
+    u32 efficiency_core_count;
+    /** @brief The number of NUMA nodes. */
+    u32 numa_node_count;
+    /** @brief The physical cores, performance cores first. */
+    platform_cpu_core cores[PLATFORM_MAX_CPU_CORES];
+} platform_cpu_topology;
+
+/**
+ * @brief Obtains the topology of the CPU(s) available to the process: its physical cores, the
+ * logical processors of each, which are efficiency cores on hybrid CPUs, and NUMA nodes. Where
+ * the platform does not say, each logical processor is reported as a performance core of its own.
+ *
+ * @param out_topology A pointer to hold the topology.
+ * @return True if the topology was obtained from the platform; false if it was guessed.
+ */
+b8 platform_cpu_topology_get(platform_cpu_topology* out_topology);
 
 /**
  * @brief Obtains the required memory amount for platform-specific handle data,
@@ -176,6 +359,44 @@ i32 platform_get_processor_count(void);
  */
 KAPI void platform_get_handle_info(u64* out_size, void* memory);
 
+/**
+ * @brief Creates and shows a window in addition to the main one. Input to it is processed as input to
+ * the main window is, its focus changes are posted as EVENT_CODE_WINDOW_FOCUS_CHANGED with it as the
+ * sender, and its size changes and close requests as EVENT_CODE_WINDOW_RESIZED and
+ * EVENT_CODE_WINDOW_CLOSE_REQUESTED. Closing it is up to the application.
+ *
+ * @param config A constant pointer to the configuration of the window.
+ * @return A pointer to the window if successful; otherwise 0.
+ */
+KAPI struct platform_window* platform_window_create(const platform_window_config* config);
+
+/**
+ * @brief Destroys the given window, which was created by platform_window_create.
+ *
+ * @param window A pointer to the window to destroy.
+ */
+KAPI void platform_window_destroy(struct platform_window* window);
+
+/**
+ * @brief Obtains the platform-specific handle data of the given window, laid out the same
+ * as the main window's is by platform_get_handle_info. Call twice, once with memory=0 to
+ * obtain size, then a second time where memory = allocated block.
+ *
+ * @param window A pointer to the window.
+ * @param out_size A pointer to hold the memory requirement.
+ * @param memory Allocated block of memory.
+ */
+KAPI void platform_window_get_handle_info(struct platform_window* window, u64* out_size, void* memory);
+
+/**
+ * @brief Obtains the current size of the client area of the given window.
+ *
+ * @param window A pointer to the window.
+ * @param out_width A pointer to hold the width.
+ * @param out_height A pointer to hold the height.
+ */
+KAPI void platform_window_size_get(const struct platform_window* window, u32* out_width, u32* out_height);
+
 /**
  * @brief Returns the device pixel ratio of the main window.
  */
@@ -227,8 +448,43 @@ KAPI const char* platform_dynamic_library_prefix(void);
  */
 KAPI platform_error_code platform_copy_file(const char *source, const char *dest, b8 overwrite_if_exists);
 
+struct file_mapping;
+
+/**
+ * @brief Maps a read-only view of a range of the file at the given path into memory.
+ *
+ * @param path The file path. Required.
+ * @param offset The offset in bytes from the beginning of the file of the range to be mapped.
+ * @param size The size of the range in bytes, or 0 for everything from offset to the end of the file.
+ * @param out_mapping A pointer to hold the mapping. Required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 platform_file_map(const char* path, u64 offset, u64 size, struct file_mapping* out_mapping);
+
+/**
+ * @brief Unmaps a view previously mapped with platform_file_map.
+ *
+ * @param mapping A pointer to the mapping to be unmapped.
+ */
+KAPI void platform_file_unmap(struct file_mapping* mapping);
+
+/**
+ * @brief Starts an asynchronous read of the entire file at the given path. The read is
+ * serviced by the platform's I/O thread, which also makes the callback.
+ *
+ * @param path The file path. Required.
+ * @param callback The callback to be made when the read completes. Required.
+ * @param user_data Optional data passed along to the callback.
+ * @return True if the read was started; otherwise false, and the callback is not made.
+ */
+KAPI b8 platform_file_read_async(const char* path, pfn_filesystem_read_complete callback, void* user_data);
+
 /**
  * @brief Watch a file at the given path.
+ * @details Changes are reported through EVENT_CODE_WATCHED_FILE_WRITTEN and EVENT_CODE_WATCHED_FILE_DELETED
+ * with the watch id in data.u32[0]. Where the platform supports it, the file's directory is watched for
+ * notifications rather than polling the file, and a change is reported once the file has stopped changing
+ * for a short while. A deleted file's watch is removed after it is reported.
  *
  * @param file_path The file path. Required.
  * @param out_watch_id A pointer to hold the watch identifier.
@@ -243,3 +499,66 @@ KAPI b8 platform_watch_file(const char* file_path, u32* out_watch_id);
  * @return True on success; otherwise false.
  */
 KAPI b8 platform_unwatch_file(u32 watch_id);
+
+/**
+ * @brief Samples the current state of every gamepad slot. Disconnected slots are checked
+ * for new gamepads at a reduced rate, as that can be slow. Does not depend on the platform
+ * system having started, but must only be called from one thread at a time.
+ *
+ * @param out_states An array of INPUT_MAX_GAMEPADS states to be filled in.
+ */
+KAPI void platform_gamepads_sample(platform_gamepad_state* out_states);
+
+/**
+ * @brief Releases the devices opened by platform_gamepads_sample(). Sampling again reopens them.
+ */
+KAPI void platform_gamepads_release(void);
+
+/**
+ * @brief Resolves the given host name or dotted address to an IPv4 address.
+ *
+ * @param host The host name or address, e.g. "127.0.0.1". Required.
+ * @param port The port.
+ * @param out_address A pointer to hold the address. Required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 platform_address_parse(const char* host, u16 port, platform_address* out_address);
+
+/**
+ * @brief Opens a non-blocking UDP socket bound to the given port on every interface.
+ *
+ * @param port The port to bind to, or 0 for any free port.
+ * @param out_socket A pointer to hold the socket. Required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 platform_udp_socket_open(u16 port, platform_socket* out_socket);
+
+/**
+ * @brief Closes a socket opened with platform_udp_socket_open.
+ *
+ * @param socket A pointer to the socket.
+ */
+KAPI void platform_udp_socket_close(platform_socket* socket);
+
+/**
+ * @brief Sends a datagram from the given socket. Never blocks; a datagram which cannot be sent
+ * right away is dropped, as it would be anywhere else along the way.
+ *
+ * @param socket A constant pointer to the socket.
+ * @param to A constant pointer to the address to send to.
+ * @param data The data to send.
+ * @param size The size of the data in bytes.
+ * @return True if the datagram was sent; otherwise false.
+ */
+KAPI b8 platform_udp_socket_send(const platform_socket* socket, const platform_address* to, const void* data, u32 size);
+
+/**
+ * @brief Receives the next datagram waiting on the given socket, if any. Never blocks.
+ *
+ * @param socket A constant pointer to the socket.
+ * @param out_from A pointer to hold the address the datagram came from. Required.
+ * @param buffer The buffer to receive into. Datagrams larger than it are truncated.
+ * @param capacity The size of the buffer in bytes.
+ * @return The size of the datagram in bytes, 0 if none is waiting, or -1 on error.
+ */
+KAPI i32 platform_udp_socket_receive(const platform_socket* socket, platform_address* out_from, void* buffer, u32 capacity);
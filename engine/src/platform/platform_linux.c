@@ -23,11 +23,13 @@
 #include <X11/keysym.h>
 #include <sys/time.h>
 #include <xcb/xcb.h>
+#include <xcb/xinput.h>  // sudo apt-get install libxcb-xinput-dev
 
 #include "containers/darray.h"
 #include "core/asserts.h"
 #include "core/event.h"
 #include "core/input.h"
+#include "core/kcondvar.h"
 #include "core/kmemory.h"
 #include "core/kmutex.h"
 #include "core/kstring.h"
@@ -45,9 +47,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/io_uring.h>
+#include <linux/joystick.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>  // Processor info
+#include <sys/uio.h>
 #include <unistd.h>
 
 typedef struct linux_handle_info {
@@ -55,12 +64,99 @@ typedef struct linux_handle_info {
     xcb_window_t window;
 } linux_handle_info;
 
+// The events listened for by every window.
+#define LINUX_WINDOW_EVENT_MASK (XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |   \
+                                 XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE |         \
+                                 XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_POINTER_MOTION |       \
+                                 XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_FOCUS_CHANGE | \
+                                 XCB_EVENT_MASK_VISIBILITY_CHANGE)
+
+typedef struct platform_window {
+    // Laid out as the main window's, so the renderer creates surfaces for both the same way.
+    linux_handle_info handle;
+    u32 width;
+    u32 height;
+} platform_window;
+
+// The time a watched file must go without changes before they are reported.
+#define FILE_WATCH_DEBOUNCE_SECONDS 0.1
+// The directory events that may change a watched file.
+#define FILE_WATCH_DIR_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+typedef enum linux_file_watch_pending {
+    FILE_WATCH_PENDING_NONE,
+    FILE_WATCH_PENDING_WRITTEN,
+    FILE_WATCH_PENDING_DELETED
+} linux_file_watch_pending;
+
 typedef struct linux_file_watch {
     u32 id;
     const char* file_path;
+    // Points into file_path.
+    const char* file_name;
     long last_write_time;
+    // The index of the watched directory holding the file, or INVALID_ID if the file is polled.
+    u32 dir_index;
+    linux_file_watch_pending pending;
+    // The time of the most recent event for the file.
+    f64 pending_time;
 } linux_file_watch;
 
+// An inotify watch on a directory, shared by every watched file in it.
+typedef struct linux_watch_dir {
+    // The watch descriptor, or -1 once removed.
+    i32 wd;
+    // The number of file watches using the directory. 0 if the slot is free.
+    u32 watch_count;
+} linux_watch_dir;
+
+// The maximum number of reads submitted to the ring at once. Any more wait their turn.
+#define ASYNC_IO_QUEUE_DEPTH 64
+
+typedef struct linux_async_read {
+    i32 fd;
+    u8* data;
+    u64 size;
+    // The number of bytes read so far.
+    u64 offset;
+    struct iovec iov;
+    pfn_filesystem_read_complete callback;
+    void* user_data;
+    // The next read waiting to be submitted.
+    struct linux_async_read* next;
+} linux_async_read;
+
+typedef struct linux_async_io {
+    b8 running;
+    // False if io_uring is unavailable, in which case reads are done in a blocking fashion on the I/O thread.
+    b8 use_uring;
+    i32 ring_fd;
+    // Submission queue ring.
+    void* sq_ptr;
+    u64 sq_ptr_size;
+    u32* sq_tail;
+    u32* sq_mask;
+    u32* sq_array;
+    struct io_uring_sqe* sqes;
+    u64 sqes_size;
+    // Completion queue ring. May share the mapping of the submission queue ring.
+    void* cq_ptr;
+    u64 cq_ptr_size;
+    u32* cq_head;
+    u32* cq_tail;
+    u32* cq_mask;
+    struct io_uring_cqe* cqes;
+    u32 queue_depth;
+    u32 in_flight;
+    // Guards everything below, as well as writes to the submission queue.
+    kmutex mutex;
+    kcondvar condvar;
+    // Reads waiting to be submitted, oldest first.
+    linux_async_read* pending_head;
+    linux_async_read* pending_tail;
+    kthread thread;
+} linux_async_io;
+
 typedef struct platform_state {
     Display* display;
     linux_handle_info handle;
@@ -70,12 +166,34 @@ typedef struct platform_state {
     i32 screen_count;
     // darray
     linux_file_watch* watches;
+    // darray
+    linux_watch_dir* watch_dirs;
+    // The inotify instance for file watches, or -1 if unavailable, in which case watched files are polled.
+    i32 inotify_fd;
+    // The number of inotify watches with a change waiting to be reported.
+    u32 pending_watch_count;
+    // The number of watches which could not be added to inotify, and are checked every update.
+    u32 polled_watch_count;
     f32 device_pixel_ratio;
+    linux_async_io async_io;
+    // The window is visible while mapped (i.e. not minimized) and not fully covered by other windows.
+    b8 window_mapped;
+    b8 window_obscured;
+    // darray of pointers to the windows created in addition to the main one.
+    platform_window** windows;
+    // The major opcode of the XInput extension, whose raw motion events carry unaccelerated mouse
+    // movement. 0 if XInput 2 is unavailable.
+    u8 xinput_opcode;
+    // Raw motion is reported wherever the pointer is, so is only used while one of the windows has focus.
+    b8 focused;
 } platform_state;
 
 static platform_state* state_ptr;
 
 static void platform_update_watches(void);
+static void raw_motion_select(void);
+static b8 async_io_startup(linux_async_io* io);
+static void async_io_shutdown(linux_async_io* io);
 // Key translation
 static keys translate_keycode(u32 x_keycode);
 
@@ -131,10 +249,7 @@ b8 platform_system_startup(u64* memory_requirement, void* state, void* config) {
     u32 event_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
 
     // Listen for keyboard and mouse buttons
-    u32 event_values = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |
-                       XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE |
-                       XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_POINTER_MOTION |
-                       XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+    u32 event_values = LINUX_WINDOW_EVENT_MASK;
 
     // Values to be sent over XCB (bg colour, events)
     u32 value_list[] = {state_ptr->screen->black_pixel, event_values};
@@ -296,6 +411,9 @@ b8 platform_system_startup(u64* memory_requirement, void* state, void* config) {
 
     // Map the window to the screen
     xcb_map_window(state_ptr->handle.connection, state_ptr->handle.window);
+    state_ptr->window_mapped = true;
+
+    raw_motion_select();
 
     // Flush the stream
     i32 stream_result = xcb_flush(state_ptr->handle.connection);
@@ -304,27 +422,130 @@ b8 platform_system_startup(u64* memory_requirement, void* state, void* config) {
         return false;
     }
 
+    if (!async_io_startup(&state_ptr->async_io)) {
+        KWARN("Failed to start asynchronous file I/O. Files will only be read synchronously.");
+    }
+
     return true;
 }
 
 void platform_system_shutdown(void* plat_state) {
     if (state_ptr) {
+        async_io_shutdown(&state_ptr->async_io);
+
+        if (state_ptr->watches && state_ptr->inotify_fd != -1) {
+            close(state_ptr->inotify_fd);
+            state_ptr->inotify_fd = -1;
+        }
+
         // Turn key repeats back on since this is global for the OS... just... wow.
         XAutoRepeatOn(state_ptr->display);
 
+        if (state_ptr->windows) {
+            while (darray_length(state_ptr->windows)) {
+                platform_window_destroy(state_ptr->windows[0]);
+            }
+            darray_destroy(state_ptr->windows);
+            state_ptr->windows = 0;
+        }
+
         xcb_destroy_window(state_ptr->handle.connection, state_ptr->handle.window);
     }
 }
 
-b8 platform_pump_messages(void) {
+// Posts a visibility change if the window has become visible or hidden.
+static void window_visibility_update(b8 mapped, b8 obscured) {
+    b8 was_visible = state_ptr->window_mapped && !state_ptr->window_obscured;
+    state_ptr->window_mapped = mapped;
+    state_ptr->window_obscured = obscured;
+    b8 visible = mapped && !obscured;
+    if (visible != was_visible) {
+        event_context context = {0};
+        context.data.u8[0] = visible;
+        event_post(EVENT_CODE_WINDOW_VISIBILITY_CHANGED, 0, context);
+    }
+}
+
+// Finds the window created by platform_window_create with the given id, if any. The main window is not one of them.
+static platform_window* window_find(xcb_window_t id) {
+    u32 window_count = state_ptr->windows ? darray_length(state_ptr->windows) : 0;
+    for (u32 i = 0; i < window_count; ++i) {
+        if (state_ptr->windows[i]->handle.window == id) {
+            return state_ptr->windows[i];
+        }
+    }
+    return 0;
+}
+
+// Asks for XInput 2 raw motion events from every pointer, which are not accelerated and are
+// reported for each movement, even once the cursor stops at the edge of the screen.
+static void raw_motion_select(void) {
+    xcb_connection_t* connection = state_ptr->handle.connection;
+    const xcb_query_extension_reply_t* extension = xcb_get_extension_data(connection, &xcb_input_id);
+    if (!extension || !extension->present) {
+        KWARN("The XInput extension is unavailable. Mouse deltas will follow the cursor instead.");
+        return;
+    }
+    xcb_input_xi_query_version_reply_t* version = xcb_input_xi_query_version_reply(connection, xcb_input_xi_query_version(connection, 2, 0), 0);
+    b8 supported = version && version->major_version >= 2;
+    free(version);
+    if (!supported) {
+        KWARN("XInput 2 is unavailable. Mouse deltas will follow the cursor instead.");
+        return;
+    }
+
+    struct {
+        xcb_input_event_mask_t head;
+        u32 mask;
+    } event_mask;
+    event_mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+    event_mask.head.mask_len = 1;
+    event_mask.mask = XCB_INPUT_XI_EVENT_MASK_RAW_MOTION;
+    // Raw events are only delivered to the root window.
+    xcb_input_xi_select_events(connection, state_ptr->screen->root, 1, &event_mask.head);
+    state_ptr->xinput_opcode = extension->major_opcode;
+}
+
+// Passes on the unaccelerated x and y movement of a raw motion event.
+static void raw_motion_process(const xcb_input_raw_motion_event_t* raw) {
+    if (xcb_input_raw_button_press_valuator_mask_length(raw) < 1) {
+        return;
+    }
+    u32 mask = xcb_input_raw_button_press_valuator_mask(raw)[0];
+    const xcb_input_fp3232_t* values = xcb_input_raw_button_press_axisvalues_raw(raw);
+    // Values are packed, one for each bit set in the mask. Valuators 0 and 1 are x and y.
+    f32 delta[2] = {0};
+    u32 value_index = 0;
+    for (u32 i = 0; i < 2; ++i) {
+        if (mask & (1u << i)) {
+            delta[i] = (f32)((f64)values[value_index].integral + (f64)values[value_index].frac / 4294967296.0);
+            value_index++;
+        }
+    }
+    if (delta[0] != 0 || delta[1] != 0) {
+        input_process_mouse_raw_move(delta[0], delta[1]);
+    }
+}
+
+b8 platform_pump_messages(f64 max_wait_seconds) {
     if (state_ptr) {
-        xcb_generic_event_t* event;
+        xcb_generic_event_t* event = xcb_poll_for_event(state_ptr->handle.connection);
         xcb_client_message_event_t* cm;
 
         b8 quit_flagged = false;
 
+        // If nothing is waiting, block on the connection until something arrives or the wait is up.
+        if (!event && max_wait_seconds > 0) {
+            xcb_flush(state_ptr->handle.connection);
+            struct pollfd fd = {0};
+            fd.fd = xcb_get_file_descriptor(state_ptr->handle.connection);
+            fd.events = POLLIN;
+            poll(&fd, 1, (i32)(max_wait_seconds * 1000.0));
+            event = xcb_poll_for_event(state_ptr->handle.connection);
+        }
+
         // Poll for events until null is returned.
-        while ((event = xcb_poll_for_event(state_ptr->handle.connection))) {
+        for (; event; event = xcb_poll_for_event(state_ptr->handle.connection)) {
             // Input events
             switch (event->response_type & ~0x80) {
                 case XCB_KEY_PRESS:
@@ -379,21 +600,79 @@ b8 platform_pump_messages(void) {
                     // The application layer can decide what to do with this.
                     xcb_configure_notify_event_t* configure_event = (xcb_configure_notify_event_t*)event;
 
+                    // Other windows only report actual size changes, as nothing shares their position.
+                    platform_window* window = window_find(configure_event->window);
+                    if (window) {
+                        if (window->width != configure_event->width || window->height != configure_event->height) {
+                            window->width = configure_event->width;
+                            window->height = configure_event->height;
+                            event_context context;
+                            context.data.u16[0] = configure_event->width;
+                            context.data.u16[1] = configure_event->height;
+                            event_post(EVENT_CODE_WINDOW_RESIZED, window, context);
+                        }
+                        break;
+                    }
+
                     // Fire the event. The application layer should pick this up, but not handle it
                     // as it shouldn be visible to other parts of the application.
                     event_context context;
                     context.data.u16[0] = configure_event->width;
                     context.data.u16[1] = configure_event->height;
-                    event_fire(EVENT_CODE_RESIZED, 0, context);
+                    event_post(EVENT_CODE_RESIZED, 0, context);
+
+                } break;
+
+                case XCB_FOCUS_IN:
+                case XCB_FOCUS_OUT: {
+                    // Focus moving because of a keyboard grab (i.e. by the window manager) isn't a real change.
+                    xcb_focus_in_event_t* focus_event = (xcb_focus_in_event_t*)event;
+                    if (focus_event->mode != XCB_NOTIFY_MODE_GRAB && focus_event->mode != XCB_NOTIFY_MODE_UNGRAB) {
+                        event_context context = {0};
+                        context.data.u8[0] = (event->response_type & ~0x80) == XCB_FOCUS_IN;
+                        state_ptr->focused = context.data.u8[0];
+                        event_post(EVENT_CODE_WINDOW_FOCUS_CHANGED, window_find(focus_event->event), context);
+                    }
+                } break;
+                // Only the main window's visibility is tracked.
+                case XCB_MAP_NOTIFY:
+                    if (((xcb_map_notify_event_t*)event)->window == state_ptr->handle.window) {
+                        window_visibility_update(true, state_ptr->window_obscured);
+                    }
+                    break;
+                case XCB_UNMAP_NOTIFY:
+                    // Minimized, or moved to another workspace.
+                    if (((xcb_unmap_notify_event_t*)event)->window == state_ptr->handle.window) {
+                        window_visibility_update(false, state_ptr->window_obscured);
+                    }
+                    break;
+                case XCB_VISIBILITY_NOTIFY: {
+                    xcb_visibility_notify_event_t* visibility_event = (xcb_visibility_notify_event_t*)event;
+                    if (visibility_event->window == state_ptr->handle.window) {
+                        window_visibility_update(state_ptr->window_mapped, visibility_event->state == XCB_VISIBILITY_FULLY_OBSCURED);
+                    }
+                } break;
 
+                case XCB_GE_GENERIC: {
+                    xcb_ge_generic_event_t* generic_event = (xcb_ge_generic_event_t*)event;
+                    if (state_ptr->xinput_opcode && generic_event->extension == state_ptr->xinput_opcode &&
+                        generic_event->event_type == XCB_INPUT_RAW_MOTION && state_ptr->focused) {
+                        raw_motion_process((xcb_input_raw_motion_event_t*)event);
+                    }
                 } break;
 
                 case XCB_CLIENT_MESSAGE: {
                     cm = (xcb_client_message_event_t*)event;
 
-                    // Window close
+                    // Window close. Closing any other window is up to the application.
                     if (cm->data.data32[0] == state_ptr->wm_delete_win) {
-                        quit_flagged = true;
+                        platform_window* window = window_find(cm->window);
+                        if (window) {
+                            event_context context = {0};
+                            event_post(EVENT_CODE_WINDOW_CLOSE_REQUESTED, window, context);
+                        } else {
+                            quit_flagged = true;
+                        }
                     }
                 } break;
                 default:
@@ -459,6 +738,18 @@ void platform_sleep(u64 ms) {
 #endif
 }
 
+void platform_sleep_precise(f64 seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (f64)ts.tv_sec) * 1000000000.0);
+    // Resume the remaining wait if interrupted by a signal.
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {
+    }
+}
+
 i32 platform_get_processor_count(void) {
     // Load processor info.
     i32 processor_count = get_nprocs_conf();
@@ -476,15 +767,121 @@ void platform_get_handle_info(u64* out_size, void* memory) {
     kcopy_memory(memory, &state_ptr->handle, *out_size);
 }
 
+platform_window* platform_window_create(const platform_window_config* config) {
+    if (!state_ptr || !config) {
+        return 0;
+    }
+
+    platform_window* window = kallocate(sizeof(platform_window), MEMORY_TAG_ENGINE);
+    window->handle.connection = state_ptr->handle.connection;
+    window->handle.window = xcb_generate_id(state_ptr->handle.connection);
+    window->width = config->width;
+    window->height = config->height;
+
+    // Created the same as the main window.
+    u32 value_list[] = {state_ptr->screen->black_pixel, LINUX_WINDOW_EVENT_MASK};
+    xcb_create_window(
+        state_ptr->handle.connection,
+        XCB_COPY_FROM_PARENT,
+        window->handle.window,
+        state_ptr->screen->root,
+        config->x,
+        config->y,
+        config->width,
+        config->height,
+        0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        state_ptr->screen->root_visual,
+        XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK,
+        value_list);
+
+    const char* title = config->title ? config->title : "";
+    xcb_change_property(
+        state_ptr->handle.connection,
+        XCB_PROP_MODE_REPLACE,
+        window->handle.window,
+        XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING,
+        8,
+        strlen(title),
+        title);
+
+    // Be told when the window manager attempts to close it, instead of it just going away.
+    xcb_change_property(
+        state_ptr->handle.connection,
+        XCB_PROP_MODE_REPLACE,
+        window->handle.window,
+        state_ptr->wm_protocols,
+        4,
+        32,
+        1,
+        &state_ptr->wm_delete_win);
+
+    xcb_map_window(state_ptr->handle.connection, window->handle.window);
+    if (xcb_flush(state_ptr->handle.connection) <= 0) {
+        KERROR("An error occurred when creating window '%s'.", title);
+        xcb_destroy_window(state_ptr->handle.connection, window->handle.window);
+        kfree(window, sizeof(platform_window), MEMORY_TAG_ENGINE);
+        return 0;
+    }
+
+    if (!state_ptr->windows) {
+        state_ptr->windows = darray_create(platform_window*);
+    }
+    darray_push(state_ptr->windows, window);
+    return window;
+}
+
+void platform_window_destroy(platform_window* window) {
+    if (!state_ptr || !window) {
+        return;
+    }
+
+    u32 window_count = state_ptr->windows ? darray_length(state_ptr->windows) : 0;
+    for (u32 i = 0; i < window_count; ++i) {
+        if (state_ptr->windows[i] == window) {
+            platform_window* popped;
+            darray_pop_at(state_ptr->windows, i, &popped);
+            break;
+        }
+    }
+
+    xcb_destroy_window(state_ptr->handle.connection, window->handle.window);
+    xcb_flush(state_ptr->handle.connection);
+    kfree(window, sizeof(platform_window), MEMORY_TAG_ENGINE);
+}
+
+void platform_window_get_handle_info(platform_window* window, u64* out_size, void* memory) {
+    *out_size = sizeof(linux_handle_info);
+    if (!memory || !window) {
+        return;
+    }
+
+    kcopy_memory(memory, &window->handle, *out_size);
+}
+
+void platform_window_size_get(const platform_window* window, u32* out_width, u32* out_height) {
+    *out_width = window ? window->width : 0;
+    *out_height = window ? window->height : 0;
+}
+
 // NOTE: Begin threads.
 
+// From platform_linux_cpu.c.
+void linux_thread_attributes_init(pthread_attr_t* attributes);
+
 b8 kthread_create(pfn_thread_start start_function_ptr, void* params, b8 auto_detach, kthread* out_thread) {
     if (!start_function_ptr) {
         return false;
     }
 
+    // Start on any processor the process may run on, rather than only those of the creating thread.
+    pthread_attr_t attributes;
+    linux_thread_attributes_init(&attributes);
+
     // pthread_create uses a function pointer that returns void*, so cold-cast to this type.
-    i32 result = pthread_create((pthread_t*)&out_thread->thread_id, 0, (void* (*)(void*))start_function_ptr, params);
+    i32 result = pthread_create((pthread_t*)&out_thread->thread_id, &attributes, (void* (*)(void*))start_function_ptr, params);
+    pthread_attr_destroy(&attributes);
     if (result != 0) {
         switch (result) {
             case EAGAIN:
@@ -569,6 +966,31 @@ void kthread_cancel(kthread* thread) {
     }
 }
 
+b8 kthread_wait(kthread* thread) {
+    if (thread && thread->internal_data) {
+        i32 result = pthread_join(*(pthread_t*)thread->internal_data, 0);
+        if (result != 0) {
+            switch (result) {
+                case EDEADLK:
+                    KERROR("Failed to wait on thread: a deadlock was detected.");
+                    break;
+                case ESRCH:
+                    KERROR("Failed to wait on thread: no thread with the id %#x could be found.", thread->thread_id);
+                    break;
+                default:
+                    KERROR("Failed to wait on thread: an unknown error has occurred. errno=%i", result);
+                    break;
+            }
+            return false;
+        }
+        platform_free(thread->internal_data, false);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+        return true;
+    }
+    return false;
+}
+
 b8 kthread_is_active(kthread* thread) {
     // TODO: Find a better way to verify this.
     return thread->internal_data != 0;
@@ -603,6 +1025,9 @@ b8 kmutex_create(kmutex* out_mutex) {
     // Save off the mutex handle.
     out_mutex->internal_data = platform_allocate(sizeof(pthread_mutex_t), false);
     *(pthread_mutex_t*)out_mutex->internal_data = mutex;
+#if KMUTEX_INSTRUMENTED == 1
+    out_mutex->stats = 0;
+#endif
 
     return true;
 }
@@ -627,6 +1052,9 @@ void kmutex_destroy(kmutex* mutex) {
 
         platform_free(mutex->internal_data, false);
         mutex->internal_data = 0;
+#if KMUTEX_INSTRUMENTED == 1
+        kmutex_stats_release(mutex);
+#endif
     }
 }
 
@@ -635,7 +1063,25 @@ b8 kmutex_lock(kmutex* mutex) {
         return false;
     }
     // Lock
+#if KMUTEX_INSTRUMENTED == 1
+    i32 result;
+    f64 wait_start = 0;
+    if (mutex->stats) {
+        // Only a lock which can't be taken straight away is contended.
+        result = pthread_mutex_trylock((pthread_mutex_t*)mutex->internal_data);
+        if (result == EBUSY) {
+            wait_start = kmutex_stats_contended(mutex);
+            result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+        }
+        if (result == 0) {
+            kmutex_stats_acquired(mutex, wait_start);
+        }
+    } else {
+        result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+    }
+#else
     i32 result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+#endif
     switch (result) {
         case 0:
             // Success, everything else is a failure.
@@ -664,6 +1110,9 @@ b8 kmutex_unlock(kmutex* mutex) {
         return false;
     }
     if (mutex->internal_data) {
+#if KMUTEX_INSTRUMENTED == 1
+        kmutex_stats_releasing(mutex);
+#endif
         i32 result = pthread_mutex_unlock((pthread_mutex_t*)mutex->internal_data);
         switch (result) {
             case 0:
@@ -685,6 +1134,111 @@ b8 kmutex_unlock(kmutex* mutex) {
 }
 // NOTE: End mutexes
 
+// NOTE: Begin condition variables
+b8 kcondvar_create(kcondvar* out_condvar) {
+    if (!out_condvar) {
+        return false;
+    }
+
+    out_condvar->internal_data = platform_allocate(sizeof(pthread_cond_t), false);
+    i32 result = pthread_cond_init((pthread_cond_t*)out_condvar->internal_data, 0);
+    if (result != 0) {
+        KERROR("Condition variable creation failure! errno=%i", result);
+        platform_free(out_condvar->internal_data, false);
+        out_condvar->internal_data = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void kcondvar_destroy(kcondvar* condvar) {
+    if (condvar && condvar->internal_data) {
+        i32 result = pthread_cond_destroy((pthread_cond_t*)condvar->internal_data);
+        switch (result) {
+            case 0:
+                break;
+            case EBUSY:
+                KERROR("Unable to destroy condition variable: it is currently being waited on.");
+                break;
+            default:
+                KERROR("An unhandled error has occurred while destroying a condition variable: errno=%i", result);
+                break;
+        }
+
+        platform_free(condvar->internal_data, false);
+        condvar->internal_data = 0;
+    }
+}
+
+b8 kcondvar_wait(kcondvar* condvar, kmutex* mutex) {
+    if (!condvar || !condvar->internal_data || !mutex || !mutex->internal_data) {
+        return false;
+    }
+
+#if KMUTEX_INSTRUMENTED == 1
+    // The mutex isn't held while waiting.
+    kmutex_stats_releasing(mutex);
+#endif
+    i32 result = pthread_cond_wait((pthread_cond_t*)condvar->internal_data, (pthread_mutex_t*)mutex->internal_data);
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_acquired(mutex, 0);
+#endif
+    if (result != 0) {
+        KERROR("An unhandled error has occurred while waiting on a condition variable: errno=%i", result);
+        return false;
+    }
+    return true;
+}
+
+b8 kcondvar_wait_timeout(kcondvar* condvar, kmutex* mutex, u64 timeout_ms) {
+    if (!condvar || !condvar->internal_data || !mutex || !mutex->internal_data) {
+        return false;
+    }
+
+    // pthread_cond_timedwait takes an absolute time on the realtime clock.
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_releasing(mutex);
+#endif
+    i32 result = pthread_cond_timedwait((pthread_cond_t*)condvar->internal_data, (pthread_mutex_t*)mutex->internal_data, &ts);
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_acquired(mutex, 0);
+#endif
+    switch (result) {
+        case 0:
+            return true;
+        case ETIMEDOUT:
+            return false;
+        default:
+            KERROR("An unhandled error has occurred while waiting on a condition variable: errno=%i", result);
+            return false;
+    }
+}
+
+b8 kcondvar_signal(kcondvar* condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    return pthread_cond_signal((pthread_cond_t*)condvar->internal_data) == 0;
+}
+
+b8 kcondvar_broadcast(kcondvar* condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    return pthread_cond_broadcast((pthread_cond_t*)condvar->internal_data) == 0;
+}
+// NOTE: End condition variables
+
 const char* platform_dynamic_library_extension(void) {
     return ".so";
 }
@@ -794,6 +1348,428 @@ close_handles:
     return ret_code;
 }
 
+// Completes a read, handing its data off to the callback. Must not be called with the mutex held.
+static void async_read_complete(linux_async_io* io, linux_async_read* read, b8 success) {
+    close(read->fd);
+    if (!success) {
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+        read->data = 0;
+    }
+    // Once shutdown begins, whatever the callbacks would hand data off to may already be gone.
+    if (io->running) {
+        read->callback(success, read->data, read->size, read->user_data);
+    } else if (read->data) {
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+    }
+    kfree(read, sizeof(linux_async_read), MEMORY_TAG_RESOURCE);
+}
+
+static void async_io_pending_push(linux_async_io* io, linux_async_read* read) {
+    read->next = 0;
+    if (io->pending_tail) {
+        io->pending_tail->next = read;
+    } else {
+        io->pending_head = read;
+    }
+    io->pending_tail = read;
+}
+
+static linux_async_read* async_io_pending_pop(linux_async_io* io) {
+    linux_async_read* read = io->pending_head;
+    if (read) {
+        io->pending_head = read->next;
+        if (!io->pending_head) {
+            io->pending_tail = 0;
+        }
+        read->next = 0;
+    }
+    return read;
+}
+
+// Writes an entry to the submission queue and submits it. Must be called with the mutex held.
+static b8 async_io_submit_entry(linux_async_io* io, u8 opcode, linux_async_read* read) {
+    // Only submitters write the tail, and they are serialized by the mutex.
+    u32 tail = *io->sq_tail;
+    u32 index = tail & *io->sq_mask;
+    struct io_uring_sqe* sqe = &io->sqes[index];
+    kzero_memory(sqe, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = -1;
+    sqe->user_data = (u64)read;
+    if (read) {
+        read->iov.iov_base = read->data + read->offset;
+        read->iov.iov_len = read->size - read->offset;
+        sqe->fd = read->fd;
+        sqe->addr = (u64)&read->iov;
+        sqe->len = 1;
+        sqe->off = read->offset;
+    }
+    io->sq_array[index] = index;
+    // Make the entry visible to the kernel before the new tail is.
+    __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    i32 result;
+    do {
+        result = syscall(__NR_io_uring_enter, io->ring_fd, 1, 0, 0, 0, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        KERROR("io_uring_enter failed to submit a read: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Submits the pending reads for which there is room in the ring. Must be called with the mutex held,
+// and returns the reads which failed to submit so they can be completed once it has been released.
+static void async_io_submit_pending(linux_async_io* io, linux_async_read*** failed) {
+    while (io->pending_head && io->in_flight < io->queue_depth) {
+        linux_async_read* read = async_io_pending_pop(io);
+        if (async_io_submit_entry(io, IORING_OP_READV, read)) {
+            io->in_flight++;
+        } else {
+            darray_push(*failed, read);
+        }
+    }
+}
+
+static u32 async_io_uring_thread(void* params) {
+    linux_async_io* io = params;
+    linux_async_read** finished = darray_create(linux_async_read*);
+    linux_async_read** failed = darray_create(linux_async_read*);
+    b8 stopping = false;
+
+    while (!stopping || io->in_flight) {
+        i32 result = syscall(__NR_io_uring_enter, io->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, 0, 0);
+        if (result < 0 && errno != EINTR) {
+            KERROR("io_uring_enter failed to wait for completions: %s", strerror(errno));
+            break;
+        }
+
+        kmutex_lock(&io->mutex);
+        // Reap everything which has completed.
+        u32 head = *io->cq_head;
+        u32 tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe* cqe = &io->cqes[head & *io->cq_mask];
+            linux_async_read* read = (linux_async_read*)cqe->user_data;
+            if (!read) {
+                // The wakeup sent by shutdown.
+                stopping = true;
+                continue;
+            }
+
+            io->in_flight--;
+            if (cqe->res <= 0) {
+                if (cqe->res < 0) {
+                    KERROR("Asynchronous read failed: %s", strerror(-cqe->res));
+                } else {
+                    KERROR("Asynchronous read ended early, at %llu of %llu bytes.", read->offset, read->size);
+                }
+                darray_push(failed, read);
+                continue;
+            }
+
+            read->offset += (u64)cqe->res;
+            if (read->offset < read->size) {
+                // A short read. Queue up the rest.
+                async_io_pending_push(io, read);
+            } else {
+                darray_push(finished, read);
+            }
+        }
+        // Hand the entries back to the kernel.
+        __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+
+        async_io_submit_pending(io, &failed);
+        kmutex_unlock(&io->mutex);
+
+        // Callbacks are made without the lock held, so they are free to start more reads.
+        u32 finished_count = darray_length(finished);
+        for (u32 i = 0; i < finished_count; ++i) {
+            async_read_complete(io, finished[i], true);
+        }
+        darray_clear(finished);
+        u32 failed_count = darray_length(failed);
+        for (u32 i = 0; i < failed_count; ++i) {
+            async_read_complete(io, failed[i], false);
+        }
+        darray_clear(failed);
+    }
+
+    darray_destroy(finished);
+    darray_destroy(failed);
+    return 0;
+}
+
+static u32 async_io_blocking_thread(void* params) {
+    linux_async_io* io = params;
+    while (true) {
+        kmutex_lock(&io->mutex);
+        while (io->running && !io->pending_head) {
+            kcondvar_wait(&io->condvar, &io->mutex);
+        }
+        if (!io->running) {
+            kmutex_unlock(&io->mutex);
+            break;
+        }
+        linux_async_read* read = async_io_pending_pop(io);
+        kmutex_unlock(&io->mutex);
+
+        while (read->offset < read->size) {
+            ssize_t result = pread(read->fd, read->data + read->offset, read->size - read->offset, read->offset);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                break;
+            }
+            read->offset += (u64)result;
+        }
+        async_read_complete(io, read, read->offset == read->size);
+    }
+    return 0;
+}
+
+static b8 async_io_uring_create(linux_async_io* io) {
+    struct io_uring_params params;
+    kzero_memory(&params, sizeof(struct io_uring_params));
+    io->ring_fd = syscall(__NR_io_uring_setup, ASYNC_IO_QUEUE_DEPTH, &params);
+    if (io->ring_fd < 0) {
+        KINFO("io_uring is unavailable (%s). Asynchronous reads will use a blocking I/O thread.", strerror(errno));
+        return false;
+    }
+
+    io->sq_ptr_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    io->cq_ptr_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    b8 single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        io->sq_ptr_size = KMAX(io->sq_ptr_size, io->cq_ptr_size);
+        io->cq_ptr_size = 0;
+    }
+
+    io->sq_ptr = mmap(0, io->sq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQ_RING);
+    if (io->sq_ptr == MAP_FAILED) {
+        io->sq_ptr = 0;
+        goto async_io_uring_create_failed;
+    }
+    if (single_mmap) {
+        io->cq_ptr = io->sq_ptr;
+    } else {
+        io->cq_ptr = mmap(0, io->cq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_CQ_RING);
+        if (io->cq_ptr == MAP_FAILED) {
+            io->cq_ptr = 0;
+            goto async_io_uring_create_failed;
+        }
+    }
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(0, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED) {
+        io->sqes = 0;
+        goto async_io_uring_create_failed;
+    }
+
+    u8* sq = io->sq_ptr;
+    io->sq_tail = (u32*)(sq + params.sq_off.tail);
+    io->sq_mask = (u32*)(sq + params.sq_off.ring_mask);
+    io->sq_array = (u32*)(sq + params.sq_off.array);
+    u8* cq = io->cq_ptr;
+    io->cq_head = (u32*)(cq + params.cq_off.head);
+    io->cq_tail = (u32*)(cq + params.cq_off.tail);
+    io->cq_mask = (u32*)(cq + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    // The completion queue is at least as big as the submission queue, so keeping the
+    // number in flight to the latter means completions are never dropped.
+    io->queue_depth = params.sq_entries;
+    return true;
+
+async_io_uring_create_failed:
+    KERROR("Failed to map io_uring rings: %s", strerror(errno));
+    if (io->sqes) {
+        munmap(io->sqes, io->sqes_size);
+    }
+    if (io->cq_ptr && io->cq_ptr != io->sq_ptr) {
+        munmap(io->cq_ptr, io->cq_ptr_size);
+    }
+    if (io->sq_ptr) {
+        munmap(io->sq_ptr, io->sq_ptr_size);
+    }
+    close(io->ring_fd);
+    io->ring_fd = -1;
+    return false;
+}
+
+static b8 async_io_startup(linux_async_io* io) {
+    kzero_memory(io, sizeof(linux_async_io));
+    io->ring_fd = -1;
+    if (!kmutex_create(&io->mutex)) {
+        return false;
+    }
+    if (!kcondvar_create(&io->condvar)) {
+        kmutex_destroy(&io->mutex);
+        return false;
+    }
+    io->use_uring = async_io_uring_create(io);
+    io->running = true;
+
+    pfn_thread_start thread_start = io->use_uring ? async_io_uring_thread : async_io_blocking_thread;
+    if (!kthread_create(thread_start, io, false, &io->thread)) {
+        async_io_shutdown(io);
+        return false;
+    }
+    return true;
+}
+
+static void async_io_shutdown(linux_async_io* io) {
+    if (!io->running) {
+        return;
+    }
+
+    kmutex_lock(&io->mutex);
+    io->running = false;
+    if (io->thread.internal_data) {
+        if (io->use_uring) {
+            // A no-op with no read attached tells the thread to finish up.
+            async_io_submit_entry(io, IORING_OP_NOP, 0);
+        } else {
+            kcondvar_broadcast(&io->condvar);
+        }
+    }
+    kmutex_unlock(&io->mutex);
+    if (io->thread.internal_data) {
+        kthread_wait(&io->thread);
+    }
+
+    // Reads which never made it to the ring are simply discarded.
+    linux_async_read* read;
+    while ((read = async_io_pending_pop(io))) {
+        async_read_complete(io, read, false);
+    }
+
+    if (io->ring_fd >= 0) {
+        munmap(io->sqes, io->sqes_size);
+        if (io->cq_ptr != io->sq_ptr) {
+            munmap(io->cq_ptr, io->cq_ptr_size);
+        }
+        munmap(io->sq_ptr, io->sq_ptr_size);
+        close(io->ring_fd);
+        io->ring_fd = -1;
+    }
+    kcondvar_destroy(&io->condvar);
+    kmutex_destroy(&io->mutex);
+}
+
+b8 platform_file_read_async(const char* path, pfn_filesystem_read_complete callback, void* user_data) {
+    if (!state_ptr || !state_ptr->async_io.running) {
+        return false;
+    }
+    linux_async_io* io = &state_ptr->async_io;
+
+    i32 fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        KERROR("platform_file_read_async - Unable to open file '%s': %s", path, strerror(errno));
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        KERROR("platform_file_read_async - Unable to get the size of file '%s', or it is empty.", path);
+        close(fd);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    linux_async_read* read = kallocate(sizeof(linux_async_read), MEMORY_TAG_RESOURCE);
+    read->fd = fd;
+    read->size = (u64)file_stat.st_size;
+    read->data = kallocate(read->size, MEMORY_TAG_RESOURCE);
+    read->callback = callback;
+    read->user_data = user_data;
+
+    b8 submitted = false;
+    kmutex_lock(&io->mutex);
+    if (io->use_uring && io->in_flight < io->queue_depth && !io->pending_head) {
+        submitted = async_io_submit_entry(io, IORING_OP_READV, read);
+        if (submitted) {
+            io->in_flight++;
+        }
+    } else {
+        // Wait for room in the ring, or for the blocking thread to get to it.
+        async_io_pending_push(io, read);
+        kcondvar_signal(&io->condvar);
+        submitted = true;
+    }
+    kmutex_unlock(&io->mutex);
+
+    if (!submitted) {
+        close(fd);
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+        kfree(read, sizeof(linux_async_read), MEMORY_TAG_RESOURCE);
+    }
+    return submitted;
+}
+
+// Splits a file path into its directory and file name. The directory is written to out_dir.
+static const char* watch_path_split(const char* file_path, char* out_dir, u64 dir_size) {
+    const char* slash = strrchr(file_path, '/');
+    if (!slash) {
+        string_ncopy(out_dir, ".", dir_size);
+        return file_path;
+    }
+    u64 length = KMIN((u64)(slash - file_path), dir_size - 1);
+    if (length == 0) {
+        // A file in the root directory.
+        length = 1;
+    }
+    kcopy_memory(out_dir, file_path, length);
+    out_dir[length] = 0;
+    return slash + 1;
+}
+
+// Starts watching the directory, or shares an existing watch of it. Returns the index of the directory, or INVALID_ID.
+static u32 watch_dir_acquire(const char* dir_path) {
+    if (state_ptr->inotify_fd == -1) {
+        return INVALID_ID;
+    }
+
+    // Adding a watch on an already watched directory returns the same descriptor, even through a different path.
+    i32 wd = inotify_add_watch(state_ptr->inotify_fd, dir_path, FILE_WATCH_DIR_MASK);
+    if (wd == -1) {
+        KWARN("Unable to watch directory '%s' (%s). Its files will be polled.", dir_path, strerror(errno));
+        return INVALID_ID;
+    }
+
+    u32 count = darray_length(state_ptr->watch_dirs);
+    u32 free_index = INVALID_ID;
+    for (u32 i = 0; i < count; ++i) {
+        linux_watch_dir* d = &state_ptr->watch_dirs[i];
+        if (d->watch_count && d->wd == wd) {
+            d->watch_count++;
+            return i;
+        }
+        if (!d->watch_count && free_index == INVALID_ID) {
+            free_index = i;
+        }
+    }
+
+    linux_watch_dir d = {0};
+    d.wd = wd;
+    d.watch_count = 1;
+    if (free_index != INVALID_ID) {
+        state_ptr->watch_dirs[free_index] = d;
+        return free_index;
+    }
+    darray_push(state_ptr->watch_dirs, d);
+    return count;
+}
+
+static void watch_dir_release(u32 dir_index) {
+    linux_watch_dir* d = &state_ptr->watch_dirs[dir_index];
+    d->watch_count--;
+    if (!d->watch_count && d->wd != -1) {
+        inotify_rm_watch(state_ptr->inotify_fd, d->wd);
+        d->wd = -1;
+    }
+}
+
 static b8 register_watch(const char* file_path, u32* out_watch_id) {
     if (!state_ptr || !file_path || !out_watch_id) {
         if (out_watch_id) {
@@ -805,6 +1781,11 @@ static b8 register_watch(const char* file_path, u32* out_watch_id) {
 
     if (!state_ptr->watches) {
         state_ptr->watches = darray_create(linux_file_watch);
+        state_ptr->watch_dirs = darray_create(linux_watch_dir);
+        state_ptr->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (state_ptr->inotify_fd == -1) {
+            KWARN("inotify is unavailable (%s). Watched files will be polled.", strerror(errno));
+        }
     }
 
     struct stat info;
@@ -816,24 +1797,29 @@ static b8 register_watch(const char* file_path, u32* out_watch_id) {
         return false;
     }
 
+    linux_file_watch w = {0};
+    w.file_path = string_duplicate(file_path);
+    w.last_write_time = info.st_mtime;
+    char dir_path[PATH_MAX];
+    w.file_name = watch_path_split(w.file_path, dir_path, PATH_MAX);
+    w.dir_index = watch_dir_acquire(dir_path);
+    if (w.dir_index == INVALID_ID) {
+        state_ptr->polled_watch_count++;
+    }
+
     u32 count = darray_length(state_ptr->watches);
     for (u32 i = 0; i < count; ++i) {
-        linux_file_watch* w = &state_ptr->watches[i];
-        if (w->id == INVALID_ID) {
+        if (state_ptr->watches[i].id == INVALID_ID) {
             // Found a free slot to use.
-            w->id = i;
-            w->file_path = string_duplicate(file_path);
-            w->last_write_time = info.st_mtime;
+            w.id = i;
+            state_ptr->watches[i] = w;
             *out_watch_id = i;
             return true;
         }
     }
 
     // If no empty slot is available, create and push a new entry.
-    linux_file_watch w = {0};
     w.id = count;
-    w.file_path = string_duplicate(file_path);
-    w.last_write_time = info.st_mtime;
     *out_watch_id = count;
     darray_push(state_ptr->watches, w);
 
@@ -851,11 +1837,21 @@ static b8 unregister_watch(u32 watch_id) {
     }
 
     linux_file_watch* w = &state_ptr->watches[watch_id];
-    w->id = INVALID_ID;
+    if (w->id == INVALID_ID) {
+        return false;
+    }
+    if (w->dir_index != INVALID_ID) {
+        watch_dir_release(w->dir_index);
+    } else {
+        state_ptr->polled_watch_count--;
+    }
+    if (w->pending != FILE_WATCH_PENDING_NONE) {
+        state_ptr->pending_watch_count--;
+    }
     u32 len = string_length(w->file_path);
     kfree((void*)w->file_path, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
-    w->file_path = 0;
-    kzero_memory(&w->last_write_time, sizeof(long));
+    kzero_memory(w, sizeof(linux_file_watch));
+    w->id = INVALID_ID;
 
     return true;
 }
@@ -868,42 +1864,278 @@ b8 platform_unwatch_file(u32 watch_id) {
     return unregister_watch(watch_id);
 }
 
+// How often a slot without a gamepad tries to open its device.
+#define GAMEPAD_OPEN_RETRY_SECONDS 1.0
+
+typedef struct linux_gamepad {
+    // The joystick device, or -1 if none is open.
+    i32 fd;
+    f64 next_open_time;
+    platform_gamepad_state state;
+} linux_gamepad;
+
+// Kept apart from the platform state, as gamepads are sampled by the input system, which
+// starts before the platform does and may sample on a thread of its own.
+static linux_gamepad gamepads[INPUT_MAX_GAMEPADS] = {[0 ... INPUT_MAX_GAMEPADS - 1] = {.fd = -1}};
+
+// Button numbers as reported through the joystick interface by the xpad driver, which most
+// gamepads are either handled by or mimic.
+static const gamepad_buttons linux_gamepad_buttons[] = {
+    GAMEPAD_BUTTON_A,
+    GAMEPAD_BUTTON_B,
+    GAMEPAD_BUTTON_X,
+    GAMEPAD_BUTTON_Y,
+    GAMEPAD_BUTTON_LEFT_SHOULDER,
+    GAMEPAD_BUTTON_RIGHT_SHOULDER,
+    GAMEPAD_BUTTON_BACK,
+    GAMEPAD_BUTTON_START,
+    GAMEPAD_BUTTON_GUIDE,
+    GAMEPAD_BUTTON_LEFT_STICK,
+    GAMEPAD_BUTTON_RIGHT_STICK};
+
+static void gamepad_button_set(platform_gamepad_state* state, gamepad_buttons button, b8 pressed) {
+    if (pressed) {
+        state->buttons |= (1u << button);
+    } else {
+        state->buttons &= ~(1u << button);
+    }
+}
+
+static void gamepad_axis_set(platform_gamepad_state* state, u8 number, i16 value) {
+    f32 v = KMAX(value / 32767.0f, -1.0f);
+    switch (number) {
+        case 0:
+            state->axes[GAMEPAD_AXIS_LEFT_X] = v;
+            break;
+        case 1:
+            // Reported with down as positive.
+            state->axes[GAMEPAD_AXIS_LEFT_Y] = -v;
+            break;
+        case 2:
+            // Triggers rest at -1.
+            state->axes[GAMEPAD_AXIS_LEFT_TRIGGER] = (v + 1.0f) * 0.5f;
+            break;
+        case 3:
+            state->axes[GAMEPAD_AXIS_RIGHT_X] = v;
+            break;
+        case 4:
+            state->axes[GAMEPAD_AXIS_RIGHT_Y] = -v;
+            break;
+        case 5:
+            state->axes[GAMEPAD_AXIS_RIGHT_TRIGGER] = (v + 1.0f) * 0.5f;
+            break;
+        case 6:
+            // The d-pad is reported as a hat on two axes.
+            gamepad_button_set(state, GAMEPAD_BUTTON_DPAD_LEFT, value < 0);
+            gamepad_button_set(state, GAMEPAD_BUTTON_DPAD_RIGHT, value > 0);
+            break;
+        case 7:
+            gamepad_button_set(state, GAMEPAD_BUTTON_DPAD_UP, value < 0);
+            gamepad_button_set(state, GAMEPAD_BUTTON_DPAD_DOWN, value > 0);
+            break;
+    }
+}
+
+static void gamepad_close(linux_gamepad* pad) {
+    if (pad->fd != -1) {
+        close(pad->fd);
+        pad->fd = -1;
+    }
+    kzero_memory(&pad->state, sizeof(platform_gamepad_state));
+}
+
+void platform_gamepads_sample(platform_gamepad_state* out_states) {
+    f64 now = platform_get_absolute_time();
+    for (u32 i = 0; i < INPUT_MAX_GAMEPADS; ++i) {
+        linux_gamepad* pad = &gamepads[i];
+        if (pad->fd == -1 && now >= pad->next_open_time) {
+            pad->next_open_time = now + GAMEPAD_OPEN_RETRY_SECONDS;
+            char path[32];
+            string_format(path, "/dev/input/js%u", i);
+            pad->fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (pad->fd != -1) {
+                // The current state follows as initial events.
+                kzero_memory(&pad->state, sizeof(platform_gamepad_state));
+                pad->state.connected = true;
+            }
+        }
+
+        if (pad->fd != -1) {
+            struct js_event events[32];
+            ssize_t bytes;
+            while ((bytes = read(pad->fd, events, sizeof(events))) > 0) {
+                u32 count = bytes / sizeof(struct js_event);
+                for (u32 e = 0; e < count; ++e) {
+                    u8 type = events[e].type & ~JS_EVENT_INIT;
+                    if (type == JS_EVENT_BUTTON) {
+                        if (events[e].number < sizeof(linux_gamepad_buttons) / sizeof(gamepad_buttons)) {
+                            gamepad_button_set(&pad->state, linux_gamepad_buttons[events[e].number], events[e].value != 0);
+                        }
+                    } else if (type == JS_EVENT_AXIS) {
+                        gamepad_axis_set(&pad->state, events[e].number, events[e].value);
+                    }
+                }
+            }
+            if (bytes == 0 || errno != EAGAIN) {
+                // Unplugged.
+                gamepad_close(pad);
+            }
+        }
+
+        out_states[i] = pad->state;
+    }
+}
+
+void platform_gamepads_release(void) {
+    for (u32 i = 0; i < INPUT_MAX_GAMEPADS; ++i) {
+        gamepad_close(&gamepads[i]);
+        gamepads[i].next_open_time = 0;
+    }
+}
+
+// Records a change to be reported once the file has been quiet for the debounce interval.
+static void watch_mark_pending(linux_file_watch* w, linux_file_watch_pending pending, f64 now) {
+    if (w->pending == FILE_WATCH_PENDING_NONE) {
+        state_ptr->pending_watch_count++;
+    }
+    w->pending = pending;
+    w->pending_time = now;
+}
+
+static void watch_events_read(f64 now) {
+    // Aligned for the event structures read into it.
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    u32 count = darray_length(state_ptr->watches);
+    u32 dir_count = darray_length(state_ptr->watch_dirs);
+
+    while (true) {
+        ssize_t length = read(state_ptr->inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length == -1 && errno != EAGAIN) {
+                KWARN("Failed to read file watch events: %s", strerror(errno));
+            }
+            return;
+        }
+
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* e = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + e->len;
+
+            if (e->mask & IN_Q_OVERFLOW) {
+                // Events were dropped, so anything may have changed. Check everything.
+                for (u32 i = 0; i < count; ++i) {
+                    if (state_ptr->watches[i].id != INVALID_ID && state_ptr->watches[i].dir_index != INVALID_ID) {
+                        watch_mark_pending(&state_ptr->watches[i], FILE_WATCH_PENDING_WRITTEN, now);
+                    }
+                }
+                continue;
+            }
+
+            u32 dir_index = INVALID_ID;
+            for (u32 d = 0; d < dir_count; ++d) {
+                if (state_ptr->watch_dirs[d].watch_count && state_ptr->watch_dirs[d].wd == e->wd) {
+                    dir_index = d;
+                    break;
+                }
+            }
+            if (dir_index == INVALID_ID) {
+                // A watch already released.
+                continue;
+            }
+
+            if (e->mask & IN_IGNORED) {
+                // The directory itself was removed, which also removed the watch on it.
+                state_ptr->watch_dirs[dir_index].wd = -1;
+                for (u32 i = 0; i < count; ++i) {
+                    linux_file_watch* w = &state_ptr->watches[i];
+                    if (w->id != INVALID_ID && w->dir_index == dir_index) {
+                        watch_mark_pending(w, FILE_WATCH_PENDING_DELETED, now);
+                    }
+                }
+                continue;
+            }
+
+            if (!e->len) {
+                continue;
+            }
+            linux_file_watch_pending pending = (e->mask & (IN_DELETE | IN_MOVED_FROM)) ? FILE_WATCH_PENDING_DELETED : FILE_WATCH_PENDING_WRITTEN;
+            for (u32 i = 0; i < count; ++i) {
+                linux_file_watch* w = &state_ptr->watches[i];
+                if (w->id != INVALID_ID && w->dir_index == dir_index && strings_equal(w->file_name, e->name)) {
+                    watch_mark_pending(w, pending, now);
+                }
+            }
+        }
+    }
+}
+
+static void watch_deleted(linux_file_watch* f) {
+    // File doesn't exist. Which means it was deleted. Remove the watch.
+    u32 id = f->id;
+    event_context context = {0};
+    context.data.u32[0] = id;
+    event_fire(EVENT_CODE_WATCHED_FILE_DELETED, 0, context);
+    KINFO("File watch id %d has been removed.", id);
+    unregister_watch(id);
+}
+
+static void watch_written(linux_file_watch* f, long write_time) {
+    KTRACE("File update found.");
+    f->last_write_time = write_time;
+    // Notify listeners.
+    event_context context = {0};
+    context.data.u32[0] = f->id;
+    event_fire(EVENT_CODE_WATCHED_FILE_WRITTEN, 0, context);
+}
+
 static void platform_update_watches(void) {
     if (!state_ptr || !state_ptr->watches) {
         return;
     }
 
+    f64 now = platform_get_absolute_time();
+    if (state_ptr->inotify_fd != -1) {
+        watch_events_read(now);
+    }
+    if (!state_ptr->pending_watch_count && !state_ptr->polled_watch_count) {
+        return;
+    }
+
     u32 count = darray_length(state_ptr->watches);
     for (u32 i = 0; i < count; ++i) {
         linux_file_watch* f = &state_ptr->watches[i];
-        if (f->id != INVALID_ID) {
-            struct stat info;
-            int result = stat(f->file_path, &info);
-            if (result != 0) {
-                if (errno == ENOENT) {
-                    // File doesn't exist. Which means it was deleted. Remove the watch.
-                    event_context context = {0};
-                    context.data.u32[0] = f->id;
-                    event_fire(EVENT_CODE_WATCHED_FILE_DELETED, 0, context);
-                    KINFO("File watch id %d has been removed.", f->id);
-                    unregister_watch(f->id);
-                    continue;
-                } else {
-                    KWARN("Some other error occurred on file watch id %d", f->id);
-                }
-                // NOTE: some other error has occurred. TODO: Handle?
+        if (f->id == INVALID_ID) {
+            continue;
+        }
+
+        if (f->dir_index != INVALID_ID) {
+            // Watched through inotify. Only report changes once the file has settled, so a save made up of
+            // several writes or a write-and-rename is reported once, after it is complete.
+            if (f->pending == FILE_WATCH_PENDING_NONE || now - f->pending_time < FILE_WATCH_DEBOUNCE_SECONDS) {
                 continue;
             }
+            f->pending = FILE_WATCH_PENDING_NONE;
+            state_ptr->pending_watch_count--;
+        }
 
-            // Check the file time to see if it has been changed and update/notify if so.
-            if (info.st_mtime - f->last_write_time != 0) {
-                KTRACE("File update found.");
-                f->last_write_time = info.st_mtime;
-                // Notify listeners.
-                event_context context = {0};
-                context.data.u32[0] = f->id;
-                event_fire(EVENT_CODE_WATCHED_FILE_WRITTEN, 0, context);
+        // Polled watches are checked every update, and settled changes are confirmed against the file itself.
+        // A file deleted and recreated in the meantime is reported as written.
+        struct stat info;
+        int result = stat(f->file_path, &info);
+        if (result != 0) {
+            if (errno == ENOENT) {
+                watch_deleted(f);
+            } else {
+                // NOTE: some other error has occurred. TODO: Handle?
+                KWARN("Some other error occurred on file watch id %d", f->id);
             }
+            continue;
+        }
+
+        // Check the file time to see if it has been changed and update/notify if so. A pending change is reported
+        // regardless, as times only have a resolution of a second.
+        if (f->dir_index != INVALID_ID || info.st_mtime - f->last_write_time != 0) {
+            watch_written(f, info.st_mtime);
         }
     }
 }
@@ -0,0 +1,195 @@
+// CPU topology and thread affinity for the Linux platform layer. Kept apart from the rest of it
+// since the affinity API needs _GNU_SOURCE, which clashes with the engine's own names elsewhere.
+#define _GNU_SOURCE
+#include "platform.h"
+
+#if KPLATFORM_LINUX
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+// Reads the first integer from the given sysfs file, or returns the default if it can't be read.
+static i64 sysfs_read_int(const char* path, i64 default_value) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return default_value;
+    }
+    long long value = default_value;
+    if (fscanf(file, "%lld", &value) != 1) {
+        value = default_value;
+    }
+    fclose(file);
+    return value;
+}
+
+// Sets the processors in a sysfs cpu list (e.g. "0-3,8,10-11") in the given set. Returns false if it can't be read.
+static b8 sysfs_read_cpu_list(const char* path, cpu_set_t* out_set) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char list[1024] = {0};
+    b8 result = fgets(list, sizeof(list), file) != 0;
+    fclose(file);
+    CPU_ZERO(out_set);
+    for (char* p = list; result && *p && *p != '\n';) {
+        char* end = 0;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, out_set);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return result;
+}
+
+// The processors the process may run on, taken before any thread is pinned. Threads inherit the
+// affinity of the thread creating them on Linux, so new threads are given this instead.
+static cpu_set_t process_affinity;
+static b8 process_affinity_valid = false;
+
+static cpu_set_t* process_affinity_get(void) {
+    if (!process_affinity_valid) {
+        if (sched_getaffinity(0, sizeof(process_affinity), &process_affinity) != 0) {
+            CPU_ZERO(&process_affinity);
+            for (i32 i = 0; i < get_nprocs() && i < CPU_SETSIZE; ++i) {
+                CPU_SET(i, &process_affinity);
+            }
+        }
+        process_affinity_valid = true;
+    }
+    return &process_affinity;
+}
+
+b8 platform_cpu_topology_get(platform_cpu_topology* out_topology) {
+    kzero_memory(out_topology, sizeof(platform_cpu_topology));
+
+    // Only the processors the process may run on count, which respects taskset and containers.
+    cpu_set_t allowed = *process_affinity_get();
+
+    // Intel hybrid CPUs list their efficiency cores under a PMU of their own. Other hybrid CPUs
+    // (e.g. ARM big.LITTLE) give their slower cores a lower capacity.
+    cpu_set_t efficiency;
+    b8 has_efficiency_list = sysfs_read_cpu_list("/sys/devices/cpu_atom/cpus", &efficiency);
+    i64 max_capacity = 0;
+    for (i32 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            char path[128];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+            max_capacity = KMAX(max_capacity, sysfs_read_int(path, 0));
+        }
+    }
+
+    b8 from_platform = true;
+    u32 node_count = 0;
+    i64 core_keys[PLATFORM_MAX_CPU_CORES];
+    for (u32 pass = 0; pass < 2; ++pass) {
+        platform_core_class wanted = pass == 0 ? PLATFORM_CORE_CLASS_PERFORMANCE : PLATFORM_CORE_CLASS_EFFICIENCY;
+        for (i32 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+            char path[128];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+            i64 capacity = sysfs_read_int(path, max_capacity);
+            b8 is_efficiency = has_efficiency_list ? CPU_ISSET(cpu, &efficiency) : capacity < max_capacity;
+            if ((is_efficiency ? PLATFORM_CORE_CLASS_EFFICIENCY : PLATFORM_CORE_CLASS_PERFORMANCE) != wanted) {
+                continue;
+            }
+
+            // Logical processors sharing a package and core id are SMT siblings of one physical core.
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+            i64 core_id = sysfs_read_int(path, -1);
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+            i64 package_id = sysfs_read_int(path, 0);
+            if (core_id < 0) {
+                from_platform = false;
+                core_id = cpu;
+            }
+            i64 key = (package_id << 32) | core_id;
+
+            u32 node = 0;
+            for (u32 n = 0; n < 64; ++n) {
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%u", cpu, n);
+                if (access(path, F_OK) == 0) {
+                    node = n;
+                    break;
+                }
+            }
+            node_count = KMAX(node_count, node + 1);
+
+            platform_cpu_core* core = 0;
+            for (u32 i = 0; i < out_topology->core_count; ++i) {
+                if (core_keys[i] == key) {
+                    core = &out_topology->cores[i];
+                    break;
+                }
+            }
+            if (!core) {
+                if (out_topology->core_count == PLATFORM_MAX_CPU_CORES) {
+                    continue;
+                }
+                core_keys[out_topology->core_count] = key;
+                core = &out_topology->cores[out_topology->core_count++];
+                core->core_class = wanted;
+                core->numa_node = node;
+                if (is_efficiency) {
+                    out_topology->efficiency_core_count++;
+                } else {
+                    out_topology->performance_core_count++;
+                }
+            }
+            if (core->processors.processor_count < KTHREAD_AFFINITY_MAX_PROCESSORS) {
+                core->processors.processors[core->processors.processor_count++] = (u32)cpu;
+            }
+            out_topology->logical_processor_count++;
+        }
+    }
+    out_topology->numa_node_count = KMAX(node_count, 1);
+    return from_platform;
+}
+
+void linux_thread_attributes_init(pthread_attr_t* attributes) {
+    pthread_attr_init(attributes);
+    pthread_attr_setaffinity_np(attributes, sizeof(cpu_set_t), process_affinity_get());
+}
+
+b8 kthread_affinity_set_current(const kthread_affinity* affinity) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (!affinity || !affinity->processor_count) {
+        // Any processor the process may run on.
+        set = *process_affinity_get();
+    } else {
+        for (u32 i = 0; i < affinity->processor_count; ++i) {
+            CPU_SET(affinity->processors[i], &set);
+        }
+    }
+    i32 result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0) {
+        KWARN("Unable to set the affinity of thread %#x: %s", (u64)pthread_self(), strerror(result));
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "core/input.h"
 #include "core/kthread.h"
 #include "core/kmutex.h"
+#include "core/kcondvar.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 
@@ -16,8 +17,15 @@
 #include <crt_externs.h>
 
 #include <copyfile.h>
+#include <dispatch/dispatch.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
 #include <sys/stat.h>
+#include <sys/sysctl.h>
+#include <time.h>
+#include <unistd.h>
 
 #import <Foundation/Foundation.h>
 #import <Cocoa/Cocoa.h>
@@ -41,6 +49,14 @@ typedef struct macos_file_watch {
     long last_write_time;
 } macos_file_watch;
  
+typedef struct macos_async_io {
+    b8 running;
+    // Serial, so callbacks are made one at a time as on the other platforms.
+    dispatch_queue_t queue;
+    // Tracks outstanding reads, so shutdown can wait for them.
+    dispatch_group_t group;
+} macos_async_io;
+
 typedef struct platform_state {
     ApplicationDelegate* app_delegate;
     WindowDelegate* wnd_delegate;
@@ -52,6 +68,7 @@ typedef struct platform_state {
     // darray
     macos_file_watch *watches;
     f32 device_pixel_ratio;
+    macos_async_io async_io;
 } platform_state;
 
 enum macos_modifier_keys {
@@ -142,6 +159,11 @@ static void platform_update_watches(void);
     i16 y = window_size.height - (pos.y * state_ptr->handle.layer.contentsScale);
     
     input_process_mouse_move(x, y);
+
+    // The deltas are kept apart from the position, so keep counting at the edge of the screen. Positive y is already down.
+    if ([event deltaX] != 0 || [event deltaY] != 0) {
+        input_process_mouse_raw_move((f32)[event deltaX], (f32)[event deltaY]);
+    }
 }
 
 - (void)rightMouseDown:(NSEvent *)event {
@@ -284,7 +306,7 @@ static const NSRange kEmptyRange = { NSNotFound, 0 };
 
     context.data.u16[0] = (u16)newDrawableSize.width;
     context.data.u16[1] = (u16)newDrawableSize.height;
-    event_fire(EVENT_CODE_RESIZED, 0, context);
+    event_post(EVENT_CODE_RESIZED, 0, context);
 }
 
 - (void)windowDidResize:(NSNotification *)notification {
@@ -298,7 +320,26 @@ static const NSRange kEmptyRange = { NSNotFound, 0 };
 
     context.data.u16[0] = (u16)newDrawableSize.width;
     context.data.u16[1] = (u16)newDrawableSize.height;
-    event_fire(EVENT_CODE_RESIZED, 0, context);
+    event_post(EVENT_CODE_RESIZED, 0, context);
+}
+
+- (void)windowDidBecomeKey:(NSNotification *)notification {
+    event_context context = {0};
+    context.data.u8[0] = true;
+    event_post(EVENT_CODE_WINDOW_FOCUS_CHANGED, 0, context);
+}
+
+- (void)windowDidResignKey:(NSNotification *)notification {
+    event_context context = {0};
+    context.data.u8[0] = false;
+    event_post(EVENT_CODE_WINDOW_FOCUS_CHANGED, 0, context);
+}
+
+- (void)windowDidChangeOcclusionState:(NSNotification *)notification {
+    // Covers being minimized, on another space or fully behind other windows.
+    event_context context = {0};
+    context.data.u8[0] = (state_ptr->window.occlusionState & NSWindowOcclusionStateVisible) != 0;
+    event_post(EVENT_CODE_WINDOW_VISIBILITY_CHANGED, 0, context);
 }
 
 - (void)windowDidMiniaturize:(NSNotification *)notification {
@@ -306,7 +347,7 @@ static const NSRange kEmptyRange = { NSNotFound, 0 };
     event_context context;
     context.data.u16[0] = 0;
     context.data.u16[1] = 0;
-    event_fire(EVENT_CODE_RESIZED, 0, context);
+    event_post(EVENT_CODE_RESIZED, 0, context);
 
     [state_ptr->window miniaturize:nil];
 }
@@ -322,7 +363,7 @@ static const NSRange kEmptyRange = { NSNotFound, 0 };
 
     context.data.u16[0] = (u16)newDrawableSize.width;
     context.data.u16[1] = (u16)newDrawableSize.height;
-    event_fire(EVENT_CODE_RESIZED, 0, context);
+    event_post(EVENT_CODE_RESIZED, 0, context);
 
     [state_ptr->window deminiaturize:nil];
 }
@@ -427,7 +468,11 @@ b8 platform_system_startup(u64* memory_requirement, void* state, void* config) {
     event_context context;
     context.data.u16[0] = (u16)state_ptr->handle.layer.drawableSize.width;
     context.data.u16[1] = (u16)state_ptr->handle.layer.drawableSize.height;
-    event_fire(EVENT_CODE_RESIZED, 0, context);
+    event_post(EVENT_CODE_RESIZED, 0, context);
+
+    state_ptr->async_io.queue = dispatch_queue_create("kohi.async_io", DISPATCH_QUEUE_SERIAL);
+    state_ptr->async_io.group = dispatch_group_create();
+    state_ptr->async_io.running = state_ptr->async_io.queue && state_ptr->async_io.group;
 
     return true;
 
@@ -436,6 +481,20 @@ b8 platform_system_startup(u64* memory_requirement, void* state, void* config) {
 
 void platform_system_shutdown(void* platform_state) {
     if (state_ptr) {
+        macos_async_io* io = &state_ptr->async_io;
+        if (io->running) {
+            // Outstanding reads still use their buffers, so wait for them. Their callbacks are skipped.
+            io->running = false;
+            dispatch_group_wait(io->group, DISPATCH_TIME_FOREVER);
+        }
+        if (io->group) {
+            dispatch_release(io->group);
+            io->group = 0;
+        }
+        if (io->queue) {
+            dispatch_release(io->queue);
+            io->queue = 0;
+        }
     @autoreleasepool {
 
         [state_ptr->window orderOut:nil];
@@ -458,18 +517,21 @@ void platform_system_shutdown(void* platform_state) {
     state_ptr = 0;
 }
 
-b8 platform_pump_messages(void) {
+b8 platform_pump_messages(f64 max_wait_seconds) {
     if (state_ptr) {
         @autoreleasepool {
 
         NSEvent* event;
 
+        // Only the first event is waited for, if nothing is waiting.
+        NSDate* until = max_wait_seconds > 0 ? [NSDate dateWithTimeIntervalSinceNow:max_wait_seconds] : [NSDate distantPast];
         for (;;) {
             event = [NSApp 
                 nextEventMatchingMask:NSEventMaskAny
-                untilDate:[NSDate distantPast]
+                untilDate:until
                 inMode:NSDefaultRunLoopMode
                 dequeue:YES];
+            until = [NSDate distantPast];
 
             if (!event)
                 break;
@@ -542,10 +604,69 @@ void platform_sleep(u64 ms) {
 #endif
 }
 
+void platform_sleep_precise(f64 seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (f64)ts.tv_sec) * 1000000000.0);
+    // Resume the remaining wait if interrupted by a signal.
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
 i32 platform_get_processor_count(void) {
     return [[NSProcessInfo processInfo] processorCount];
 }
 
+// Reads an integer sysctl, or returns the default if there is none.
+static i32 sysctl_int(const char *name, i32 default_value) {
+    i32 value = 0;
+    size_t size = sizeof(value);
+    return sysctlbyname(name, &value, &size, 0, 0) == 0 ? value : default_value;
+}
+
+b8 platform_cpu_topology_get(platform_cpu_topology *out_topology) {
+    kzero_memory(out_topology, sizeof(platform_cpu_topology));
+    out_topology->numa_node_count = 1;
+
+    // macOS does not say which logical processor is which, only how many cores each performance
+    // level has, fastest first. Logical processors are numbered in that order.
+    i32 level_count = sysctl_int("hw.nperflevels", 0);
+    b8 from_platform = level_count > 0;
+    if (!from_platform) {
+        level_count = 1;
+    }
+    u32 processor = 0;
+    for (i32 level = 0; level < level_count; ++level) {
+        char name[64];
+        snprintf(name, sizeof(name), "hw.perflevel%d.physicalcpu", level);
+        i32 physical = from_platform ? sysctl_int(name, 0) : sysctl_int("hw.physicalcpu", 1);
+        snprintf(name, sizeof(name), "hw.perflevel%d.logicalcpu", level);
+        i32 logical = from_platform ? sysctl_int(name, physical) : sysctl_int("hw.logicalcpu", physical);
+        i32 per_core = physical > 0 ? KMAX(logical / physical, 1) : 1;
+        platform_core_class core_class = level == 0 ? PLATFORM_CORE_CLASS_PERFORMANCE : PLATFORM_CORE_CLASS_EFFICIENCY;
+        for (i32 c = 0; c < physical && out_topology->core_count < PLATFORM_MAX_CPU_CORES; ++c) {
+            platform_cpu_core *core = &out_topology->cores[out_topology->core_count++];
+            core->core_class = core_class;
+            for (i32 t = 0; t < per_core; ++t) {
+                if (core->processors.processor_count < KTHREAD_AFFINITY_MAX_PROCESSORS) {
+                    core->processors.processors[core->processors.processor_count++] = processor;
+                }
+                processor++;
+            }
+            if (core_class == PLATFORM_CORE_CLASS_PERFORMANCE) {
+                out_topology->performance_core_count++;
+            } else {
+                out_topology->efficiency_core_count++;
+            }
+        }
+    }
+    out_topology->logical_processor_count = processor;
+    return from_platform;
+}
+
 void platform_get_handle_info(u64 *out_size, void *memory) {
 
     *out_size = sizeof(macos_handle_info);
@@ -556,12 +677,36 @@ void platform_get_handle_info(u64 *out_size, void *memory) {
     kcopy_memory(memory, &state_ptr->handle, *out_size);
 }
 
+// TODO: Additional windows, each with a view and metal layer of its own.
+struct platform_window *platform_window_create(const platform_window_config *config) {
+    KWARN("Additional windows are not yet supported on macOS.");
+    return 0;
+}
+
+void platform_window_destroy(struct platform_window *window) {
+}
+
+void platform_window_get_handle_info(struct platform_window *window, u64 *out_size, void *memory) {
+    *out_size = 0;
+}
+
+void platform_window_size_get(const struct platform_window *window, u32 *out_width, u32 *out_height) {
+    *out_width = 0;
+    *out_height = 0;
+}
+
 f32 platform_device_pixel_ratio(void) {
     return state_ptr->device_pixel_ratio;
 }
 
 // NOTE: Begin threads.
 
+b8 kthread_affinity_set_current(const kthread_affinity* affinity) {
+    // NOTE: macOS has no way to pin a thread to a processor; the scheduler places threads by
+    // their quality of service instead.
+    return !affinity || !affinity->processor_count;
+}
+
 b8 kthread_create(pfn_thread_start start_function_ptr, void* params, b8 auto_detach, kthread* out_thread) {
     if (!start_function_ptr) {
         return false;
@@ -653,6 +798,31 @@ void kthread_cancel(kthread* thread) {
     }
 }
 
+b8 kthread_wait(kthread* thread) {
+    if (thread && thread->internal_data) {
+        i32 result = pthread_join(*(pthread_t*)thread->internal_data, 0);
+        if (result != 0) {
+            switch (result) {
+                case EDEADLK:
+                    KERROR("Failed to wait on thread: a deadlock was detected.");
+                    break;
+                case ESRCH:
+                    KERROR("Failed to wait on thread: no thread with the id %#x could be found.", thread->thread_id);
+                    break;
+                default:
+                    KERROR("Failed to wait on thread: an unknown error has occurred. errno=%i", result);
+                    break;
+            }
+            return false;
+        }
+        platform_free(thread->internal_data, false);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+        return true;
+    }
+    return false;
+}
+
 b8 kthread_is_active(kthread* thread) {
     // TODO: Find a better way to verify this.
     return thread->internal_data != 0;
@@ -688,6 +858,9 @@ b8 kmutex_create(kmutex* out_mutex) {
     // Save off the mutex handle.
     out_mutex->internal_data = platform_allocate(sizeof(pthread_mutex_t), false);
     *(pthread_mutex_t*)out_mutex->internal_data = mutex;
+#if KMUTEX_INSTRUMENTED == 1
+    out_mutex->stats = 0;
+#endif
 
     return true;
 }
@@ -712,6 +885,9 @@ void kmutex_destroy(kmutex* mutex) {
 
         platform_free(mutex->internal_data, false);
         mutex->internal_data = 0;
+#if KMUTEX_INSTRUMENTED == 1
+        kmutex_stats_release(mutex);
+#endif
     }
 }
 
@@ -720,7 +896,25 @@ b8 kmutex_lock(kmutex* mutex) {
         return false;
     }
     // Lock
+#if KMUTEX_INSTRUMENTED == 1
+    i32 result;
+    f64 wait_start = 0;
+    if (mutex->stats) {
+        // Only a lock which can't be taken straight away is contended.
+        result = pthread_mutex_trylock((pthread_mutex_t*)mutex->internal_data);
+        if (result == EBUSY) {
+            wait_start = kmutex_stats_contended(mutex);
+            result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+        }
+        if (result == 0) {
+            kmutex_stats_acquired(mutex, wait_start);
+        }
+    } else {
+        result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+    }
+#else
     i32 result = pthread_mutex_lock((pthread_mutex_t*)mutex->internal_data);
+#endif
     switch (result) {
         case 0:
             // Success, everything else is a failure.
@@ -749,6 +943,9 @@ b8 kmutex_unlock(kmutex* mutex) {
         return false;
     }
     if (mutex->internal_data) {
+#if KMUTEX_INSTRUMENTED == 1
+        kmutex_stats_releasing(mutex);
+#endif
         i32 result = pthread_mutex_unlock((pthread_mutex_t*)mutex->internal_data);
         switch (result) {
             case 0:
@@ -770,6 +967,111 @@ b8 kmutex_unlock(kmutex* mutex) {
 }
 // NOTE: End mutexes
 
+// NOTE: Begin condition variables
+b8 kcondvar_create(kcondvar* out_condvar) {
+    if (!out_condvar) {
+        return false;
+    }
+
+    out_condvar->internal_data = platform_allocate(sizeof(pthread_cond_t), false);
+    i32 result = pthread_cond_init((pthread_cond_t*)out_condvar->internal_data, 0);
+    if (result != 0) {
+        KERROR("Condition variable creation failure! errno=%i", result);
+        platform_free(out_condvar->internal_data, false);
+        out_condvar->internal_data = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void kcondvar_destroy(kcondvar* condvar) {
+    if (condvar && condvar->internal_data) {
+        i32 result = pthread_cond_destroy((pthread_cond_t*)condvar->internal_data);
+        switch (result) {
+            case 0:
+                break;
+            case EBUSY:
+                KERROR("Unable to destroy condition variable: it is currently being waited on.");
+                break;
+            default:
+                KERROR("An unhandled error has occurred while destroying a condition variable: errno=%i", result);
+                break;
+        }
+
+        platform_free(condvar->internal_data, false);
+        condvar->internal_data = 0;
+    }
+}
+
+b8 kcondvar_wait(kcondvar* condvar, kmutex* mutex) {
+    if (!condvar || !condvar->internal_data || !mutex || !mutex->internal_data) {
+        return false;
+    }
+
+#if KMUTEX_INSTRUMENTED == 1
+    // The mutex isn't held while waiting.
+    kmutex_stats_releasing(mutex);
+#endif
+    i32 result = pthread_cond_wait((pthread_cond_t*)condvar->internal_data, (pthread_mutex_t*)mutex->internal_data);
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_acquired(mutex, 0);
+#endif
+    if (result != 0) {
+        KERROR("An unhandled error has occurred while waiting on a condition variable: errno=%i", result);
+        return false;
+    }
+    return true;
+}
+
+b8 kcondvar_wait_timeout(kcondvar* condvar, kmutex* mutex, u64 timeout_ms) {
+    if (!condvar || !condvar->internal_data || !mutex || !mutex->internal_data) {
+        return false;
+    }
+
+    // pthread_cond_timedwait takes an absolute time on the realtime clock.
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_releasing(mutex);
+#endif
+    i32 result = pthread_cond_timedwait((pthread_cond_t*)condvar->internal_data, (pthread_mutex_t*)mutex->internal_data, &ts);
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_acquired(mutex, 0);
+#endif
+    switch (result) {
+        case 0:
+            return true;
+        case ETIMEDOUT:
+            return false;
+        default:
+            KERROR("An unhandled error has occurred while waiting on a condition variable: errno=%i", result);
+            return false;
+    }
+}
+
+b8 kcondvar_signal(kcondvar* condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    return pthread_cond_signal((pthread_cond_t*)condvar->internal_data) == 0;
+}
+
+b8 kcondvar_broadcast(kcondvar* condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    return pthread_cond_broadcast((pthread_cond_t*)condvar->internal_data) == 0;
+}
+// NOTE: End condition variables
+
 const char *platform_dynamic_library_extension(void) {
     return ".dylib";
 }
@@ -797,6 +1099,72 @@ platform_error_code platform_copy_file(const char *source, const char *dest, b8
     return PLATFORM_ERROR_SUCCESS;
 }
 
+b8 platform_file_read_async(const char *path, pfn_filesystem_read_complete callback, void *user_data) {
+    if (!state_ptr || !state_ptr->async_io.running) {
+        return false;
+    }
+    macos_async_io *io = &state_ptr->async_io;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        KERROR("platform_file_read_async - Unable to open file '%s': %s", path, strerror(errno));
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        KERROR("platform_file_read_async - Unable to get the size of file '%s', or it is empty.", path);
+        close(fd);
+        return false;
+    }
+
+    // The channel owns the descriptor from here on, and closes it once it is done with it.
+    dispatch_io_t channel = dispatch_io_create(DISPATCH_IO_RANDOM, fd, io->queue, ^(int error) {
+        close(fd);
+    });
+    if (!channel) {
+        KERROR("platform_file_read_async - Unable to create an I/O channel for file '%s'.", path);
+        close(fd);
+        return false;
+    }
+
+    u64 size = (u64)file_stat.st_size;
+    u8 *data = kallocate(size, MEMORY_TAG_RESOURCE);
+    __block u64 offset = 0;
+    dispatch_group_enter(io->group);
+    dispatch_io_read(channel, 0, size, io->queue, ^(bool done, dispatch_data_t part, int error) {
+        if (part) {
+            // Parts arrive in order, each as one or more regions.
+            dispatch_data_apply(part, ^bool(dispatch_data_t region, size_t region_offset, const void *buffer, size_t buffer_size) {
+                u64 count = KMIN((u64)buffer_size, size - offset);
+                kcopy_memory(data + offset, buffer, count);
+                offset += count;
+                return true;
+            });
+        }
+        if (!done) {
+            return;
+        }
+
+        b8 success = error == 0 && offset == size;
+        if (!success) {
+            KERROR("Asynchronous read failed at %llu of %llu bytes: %s", offset, size, strerror(error));
+        }
+        // Once shutdown begins, whatever the callback would hand data off to may already be gone.
+        if (success && io->running) {
+            callback(true, data, size, user_data);
+        } else {
+            kfree(data, size, MEMORY_TAG_RESOURCE);
+            if (io->running) {
+                callback(false, 0, size, user_data);
+            }
+        }
+        dispatch_io_close(channel, 0);
+        dispatch_release(channel);
+        dispatch_group_leave(io->group);
+    });
+    return true;
+}
+
 static b8 register_watch(const char *file_path, u32 *out_watch_id) {
     if (!state_ptr || !file_path || !out_watch_id) {
         if (out_watch_id) {
@@ -871,6 +1239,14 @@ b8 platform_unwatch_file(u32 watch_id) {
     return unregister_watch(watch_id);
 }
 
+void platform_gamepads_sample(platform_gamepad_state *out_states) {
+    // TODO: Read gamepads through the GameController framework.
+    kzero_memory(out_states, sizeof(platform_gamepad_state) * INPUT_MAX_GAMEPADS);
+}
+
+void platform_gamepads_release(void) {
+}
+
 static void platform_update_watches(void) {
     if (!state_ptr || !state_ptr->watches) {
         return;
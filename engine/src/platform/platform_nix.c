@@ -17,8 +17,143 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "containers/darray.h"
+#include "platform/filesystem.h"
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+u64 platform_memory_page_size(void) {
+    static u64 page_size = 0;
+    if (!page_size) {
+        page_size = (u64)sysconf(_SC_PAGESIZE);
+    }
+    return page_size;
+}
+
+void *platform_memory_reserve(u64 size) {
+    u64 page_size = platform_memory_page_size();
+    size = (size + page_size - 1) & ~(page_size - 1);
+    // Inaccessible until committed, and not counted against the system's memory until then either.
+    void *address = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (address == MAP_FAILED) {
+        KERROR("Unable to reserve %llu bytes of address space: %s", size, strerror(errno));
+        return 0;
+    }
+    return address;
+}
+
+u64 platform_memory_large_page_size(void) {
+    static u64 large_page_size = (u64)-1;
+    if (large_page_size == (u64)-1) {
+        large_page_size = 0;
+#if defined(MADV_HUGEPAGE)
+        // Transparent huge pages must not be switched off entirely.
+        char mode[128] = {0};
+        FILE *file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if (file) {
+            if (!fgets(mode, sizeof(mode), file)) {
+                mode[0] = 0;
+            }
+            fclose(file);
+        }
+        if (mode[0] && !strstr(mode, "[never]")) {
+            large_page_size = MEBIBYTES(2);
+            file = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+            if (file) {
+                unsigned long long size = 0;
+                if (fscanf(file, "%llu", &size) == 1 && size) {
+                    large_page_size = size;
+                }
+                fclose(file);
+            }
+        }
+#endif
+    }
+    return large_page_size;
+}
+
+void *platform_memory_reserve_large(u64 size, b8 *out_large_pages) {
+    *out_large_pages = false;
+    u64 large_page_size = platform_memory_large_page_size();
+    if (!large_page_size) {
+        return platform_memory_reserve(size);
+    }
+
+    // Reserve a large page more than needed, so the range can be trimmed to start on one.
+    // NOTE: MAP_HUGETLB is not used, as it takes from a pool which must be set aside
+    // beforehand, and a fault once the pool runs dry kills the process rather than failing.
+    size = (size + large_page_size - 1) & ~(large_page_size - 1);
+    u8 *reserved = mmap(0, size + large_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        KERROR("Unable to reserve %llu bytes of address space: %s", size, strerror(errno));
+        return 0;
+    }
+    u8 *address = (u8 *)(((u64)reserved + large_page_size - 1) & ~(large_page_size - 1));
+    if (address > reserved) {
+        munmap(reserved, address - reserved);
+    }
+    u8 *reserved_end = reserved + size + large_page_size;
+    if (reserved_end > address + size) {
+        munmap(address + size, reserved_end - (address + size));
+    }
+
+#if defined(MADV_HUGEPAGE)
+    *out_large_pages = madvise(address, size, MADV_HUGEPAGE) == 0;
+#endif
+    return address;
+}
+
+b8 platform_memory_commit(void *address, u64 size) {
+    u64 page_size = platform_memory_page_size();
+    u64 start = (u64)address & ~(page_size - 1);
+    u64 end = ((u64)address + size + page_size - 1) & ~(page_size - 1);
+    if (mprotect((void *)start, end - start, PROT_READ | PROT_WRITE) != 0) {
+        KERROR("Unable to commit %llu bytes of memory: %s", end - start, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void platform_memory_decommit(void *address, u64 size) {
+    u64 page_size = platform_memory_page_size();
+    u64 start = ((u64)address + page_size - 1) & ~(page_size - 1);
+    u64 end = ((u64)address + size) & ~(page_size - 1);
+    if (end <= start) {
+        return;
+    }
+    // Drops the pages, which read as zero if committed again, and makes them inaccessible.
+    if (madvise((void *)start, end - start, MADV_DONTNEED) != 0 || mprotect((void *)start, end - start, PROT_NONE) != 0) {
+        KERROR("Unable to decommit %llu bytes of memory: %s", end - start, strerror(errno));
+    }
+}
+
+void platform_memory_release(void *address, u64 size) {
+    if (address) {
+        u64 page_size = platform_memory_page_size();
+        size = (size + page_size - 1) & ~(page_size - 1);
+        if (munmap(address, size) != 0) {
+            KERROR("Unable to release reserved memory: %s", strerror(errno));
+        }
+    }
+}
+
+void platform_stack_trace_print(u32 skip_count) {
+    void *frames[PLATFORM_STACK_TRACE_MAX_FRAMES];
+    i32 count = backtrace(frames, PLATFORM_STACK_TRACE_MAX_FRAMES);
+    // This function's own frame is left out too.
+    i32 skip = KMIN((i32)skip_count + 1, count);
+    backtrace_symbols_fd(frames + skip, count - skip, STDERR_FILENO);
+}
 
 b8 platform_dynamic_library_load(const char *name, dynamic_library *out_library) {
     if (!out_library) {
@@ -120,4 +255,157 @@ b8 platform_dynamic_library_load_function(const char *name, dynamic_library *lib
     return true;
 }
 
-#endif
\ No newline at end of file
+b8 platform_file_map(const char *path, u64 offset, u64 size, struct file_mapping *out_mapping) {
+    if (!path || !out_mapping) {
+        return false;
+    }
+
+    i32 fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        KERROR("Unable to open file '%s' for mapping: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        KERROR("Unable to get the size of file '%s' for mapping: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    u64 file_size = (u64)st.st_size;
+    if (offset > file_size || size > file_size - offset) {
+        KERROR("Range of %llu bytes at offset %llu is outside file '%s' of %llu bytes.", size, offset, path, file_size);
+        close(fd);
+        return false;
+    }
+    if (size == 0) {
+        size = file_size - offset;
+    }
+    if (size == 0) {
+        KERROR("Unable to map an empty range of file '%s'.", path);
+        close(fd);
+        return false;
+    }
+
+    // Views must begin on a page boundary.
+    u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+    u64 view_offset = offset - (offset % page_size);
+    u64 view_size = size + (offset - view_offset);
+    void *view = mmap(0, view_size, PROT_READ, MAP_PRIVATE, fd, (off_t)view_offset);
+    // The mapping holds its own reference to the file.
+    close(fd);
+    if (view == MAP_FAILED) {
+        KERROR("Unable to map file '%s': %s", path, strerror(errno));
+        return false;
+    }
+    // Mapped files are generally read soon after, so start paging them in now.
+    posix_madvise(view, view_size, POSIX_MADV_WILLNEED);
+
+    out_mapping->view = view;
+    out_mapping->view_size = view_size;
+    out_mapping->data = (const u8 *)view + (offset - view_offset);
+    out_mapping->size = size;
+    return true;
+}
+
+void platform_file_unmap(struct file_mapping *mapping) {
+    if (mapping && mapping->view) {
+        if (munmap(mapping->view, mapping->view_size) != 0) {
+            KERROR("Failed to unmap file view: %s", strerror(errno));
+        }
+    }
+}
+
+b8 platform_address_parse(const char *host, u16 port, platform_address *out_address) {
+    if (!host || !out_address) {
+        return false;
+    }
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *info = 0;
+    i32 result = getaddrinfo(host, 0, &hints, &info);
+    if (result != 0 || !info) {
+        KERROR("Unable to resolve address '%s': %s", host, gai_strerror(result));
+        return false;
+    }
+    out_address->ip = ntohl(((struct sockaddr_in *)info->ai_addr)->sin_addr.s_addr);
+    out_address->port = port;
+    freeaddrinfo(info);
+    return true;
+}
+
+b8 platform_udp_socket_open(u16 port, platform_socket *out_socket) {
+    if (!out_socket) {
+        return false;
+    }
+    kzero_memory(out_socket, sizeof(platform_socket));
+
+    i32 fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        KERROR("Unable to create socket: %s", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        KERROR("Unable to bind socket to port %hu: %s", port, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    i32 flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        KERROR("Unable to make socket non-blocking: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    out_socket->handle = (u64)fd;
+    out_socket->is_open = true;
+    return true;
+}
+
+void platform_udp_socket_close(platform_socket *socket) {
+    if (socket && socket->is_open) {
+        close((i32)socket->handle);
+        socket->is_open = false;
+    }
+}
+
+b8 platform_udp_socket_send(const platform_socket *socket, const platform_address *to, const void *data, u32 size) {
+    if (!socket || !socket->is_open || !to || !data) {
+        return false;
+    }
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(to->ip);
+    address.sin_port = htons(to->port);
+    ssize_t sent = sendto((i32)socket->handle, data, size, 0, (struct sockaddr *)&address, sizeof(address));
+    return sent == (ssize_t)size;
+}
+
+i32 platform_udp_socket_receive(const platform_socket *socket, platform_address *out_from, void *buffer, u32 capacity) {
+    if (!socket || !socket->is_open || !out_from || !buffer) {
+        return -1;
+    }
+    struct sockaddr_in address = {0};
+    socklen_t address_length = sizeof(address);
+    ssize_t received = recvfrom((i32)socket->handle, buffer, capacity, 0, (struct sockaddr *)&address, &address_length);
+    if (received < 0) {
+        // A refused connection is the ICMP response to an earlier send to a closed port, not an error of this socket.
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED) {
+            return 0;
+        }
+        KERROR("Unable to receive from socket: %s", strerror(errno));
+        return -1;
+    }
+    out_from->ip = ntohl(address.sin_addr.s_addr);
+    out_from->port = ntohs(address.sin_port);
+    return (i32)received;
+}
+
+#endif
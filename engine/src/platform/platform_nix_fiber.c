@@ -0,0 +1,109 @@
+// Fibers for unix-like platforms (i.e. Linux and macOS), built on ucontext. Kept apart from the
+// rest of the platform layer since macOS only declares the ucontext functions for _XOPEN_SOURCE,
+// which hides much else it uses.
+#if defined(__APPLE__)
+#define _XOPEN_SOURCE 700
+#define _DARWIN_C_SOURCE
+#endif
+#include "platform.h"
+
+#if defined(KPLATFORM_LINUX) || defined(KPLATFORM_APPLE)
+
+#include "core/kfiber.h"
+#include "core/logger.h"
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+typedef struct nix_fiber {
+    ucontext_t context;
+    // The stack, with a guard page below it. Not set for the fiber of a thread.
+    void *stack_memory;
+    u64 stack_memory_size;
+    pfn_fiber_start start;
+    void *params;
+} nix_fiber;
+
+// makecontext only passes ints, so the fiber is passed as two halves of its address.
+static void nix_fiber_entry(u32 low, u32 high) {
+    nix_fiber *fiber = (nix_fiber *)(((u64)high << 32) | low);
+    fiber->start(fiber->params);
+    // Returning would end the thread, since nothing is linked to run after.
+    KFATAL("A fiber returned from its start function. Fibers must switch away once done.");
+}
+
+b8 kfiber_thread_convert(kfiber *out_fiber) {
+    // The thread's own stack is used, and its context is filled in by the first switch away.
+    nix_fiber *fiber = platform_allocate(sizeof(nix_fiber), false);
+    platform_zero_memory(fiber, sizeof(nix_fiber));
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_thread_revert(kfiber *fiber) {
+    if (fiber->internal_data) {
+        platform_free(fiber->internal_data, false);
+        fiber->internal_data = 0;
+    }
+}
+
+b8 kfiber_create(pfn_fiber_start start_function_ptr, void *params, u64 stack_size, kfiber *out_fiber) {
+    if (!start_function_ptr || !out_fiber) {
+        return false;
+    }
+
+    u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+    stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+    u64 memory_size = stack_size + page_size;
+    void *memory = mmap(0, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (memory == MAP_FAILED) {
+        KERROR("kfiber_create - unable to map a stack of %lluB.", stack_size);
+        return false;
+    }
+    // Stacks grow down, so an overflow runs into the guard page and faults rather than corrupting memory.
+    mprotect(memory, page_size, PROT_NONE);
+
+    nix_fiber *fiber = platform_allocate(sizeof(nix_fiber), false);
+    platform_zero_memory(fiber, sizeof(nix_fiber));
+    fiber->stack_memory = memory;
+    fiber->stack_memory_size = memory_size;
+    fiber->start = start_function_ptr;
+    fiber->params = params;
+
+    if (getcontext(&fiber->context) != 0) {
+        KERROR("kfiber_create - unable to get the context.");
+        munmap(memory, memory_size);
+        platform_free(fiber, false);
+        return false;
+    }
+    fiber->context.uc_stack.ss_sp = (u8 *)memory + page_size;
+    fiber->context.uc_stack.ss_size = stack_size;
+    fiber->context.uc_link = 0;
+    u64 address = (u64)fiber;
+    makecontext(&fiber->context, (void (*)(void))nix_fiber_entry, 2, (u32)address, (u32)(address >> 32));
+
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_destroy(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        nix_fiber *internal = fiber->internal_data;
+        if (internal->stack_memory) {
+            munmap(internal->stack_memory, internal->stack_memory_size);
+        }
+        platform_free(internal, false);
+        fiber->internal_data = 0;
+    }
+}
+
+void kfiber_switch(kfiber *from, kfiber *to) {
+    nix_fiber *from_internal = from->internal_data;
+    nix_fiber *to_internal = to->internal_data;
+    if (swapcontext(&from_internal->context, &to_internal->context) != 0) {
+        KFATAL("kfiber_switch - unable to switch fibers.");
+    }
+}
+
+#endif
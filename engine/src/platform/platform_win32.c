@@ -6,44 +6,144 @@
 #include "containers/darray.h"
 #include "core/event.h"
 #include "core/input.h"
+#include "core/kcondvar.h"
+#include "core/kfiber.h"
 #include "core/kmemory.h"
 #include "core/kmutex.h"
 #include "core/kstring.h"
 #include "core/kthread.h"
 #include "core/logger.h"
+#include "platform/filesystem.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <stdlib.h>
+// NOTE: Winsock 2 must come before windows.h, which would otherwise pull in the original.
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <windowsx.h>  // param input extraction
+#include <mmsystem.h>  // timeBeginPeriod
+#include <xinput.h>
 
 typedef struct win32_handle_info {
     HINSTANCE h_instance;
     HWND hwnd;
 } win32_handle_info;
 
+typedef struct platform_window {
+    // Laid out as the main window's, so the renderer creates surfaces for both the same way.
+    win32_handle_info handle;
+    u32 width;
+    u32 height;
+} platform_window;
+
+// The style of every window.
+#define WIN32_WINDOW_STYLE (WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MAXIMIZEBOX | WS_MINIMIZEBOX | WS_THICKFRAME)
+#define WIN32_WINDOW_EX_STYLE WS_EX_APPWINDOW
+
+// The time a watched file must go without changes before they are reported.
+#define FILE_WATCH_DEBOUNCE_SECONDS 0.1
+// The size of the buffer directory changes are read into.
+#define FILE_WATCH_BUFFER_SIZE 16384
+// The directory changes that may change a watched file.
+#define FILE_WATCH_NOTIFY_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE)
+
+typedef enum win32_file_watch_pending {
+    FILE_WATCH_PENDING_NONE,
+    FILE_WATCH_PENDING_WRITTEN,
+    FILE_WATCH_PENDING_DELETED
+} win32_file_watch_pending;
+
+// A watch on a directory, shared by every watched file in it.
+typedef struct win32_watch_dir {
+    HANDLE handle;
+    char *path;
+    OVERLAPPED overlapped;
+    // Indicates if a read of changes is outstanding.
+    b8 reading;
+    // The number of file watches using the directory.
+    u32 watch_count;
+    // Directory changes are written here. Aligned as FILE_NOTIFY_INFORMATION requires.
+    DWORD buffer[FILE_WATCH_BUFFER_SIZE / sizeof(DWORD)];
+} win32_watch_dir;
+
 typedef struct win32_file_watch {
     u32 id;
     const char *file_path;
+    // Points into file_path.
+    const char *file_name;
     FILETIME last_write_time;
+    // The watched directory holding the file, or 0 if the file is polled.
+    win32_watch_dir *dir;
+    win32_file_watch_pending pending;
+    // The time of the most recent change to the file.
+    f64 pending_time;
 } win32_file_watch;
 
+// The largest single ReadFile call. Bigger files are read in several parts.
+#define ASYNC_IO_MAX_READ_SIZE (1u << 30)
+// Completion key of the packet which tells the I/O thread to finish up.
+#define ASYNC_IO_KEY_SHUTDOWN 1
+
+typedef struct win32_async_read {
+    // Must be first, as completions hand back a pointer to this.
+    OVERLAPPED overlapped;
+    HANDLE file;
+    u8 *data;
+    u64 size;
+    // The number of bytes read so far.
+    u64 offset;
+    pfn_filesystem_read_complete callback;
+    void *user_data;
+} win32_async_read;
+
+typedef struct win32_async_io {
+    b8 running;
+    HANDLE port;
+    volatile LONG in_flight;
+    kthread thread;
+} win32_async_io;
+
 typedef struct platform_state {
     win32_handle_info handle;
     CONSOLE_SCREEN_BUFFER_INFO std_output_csbi;
     CONSOLE_SCREEN_BUFFER_INFO err_output_csbi;
     // darray
     win32_file_watch *watches;
+    // darray of pointers, as each holds an OVERLAPPED in use by the system. Free slots are 0.
+    win32_watch_dir **watch_dirs;
+    // The number of directory watches with a change waiting to be reported.
+    u32 pending_watch_count;
+    // The number of watches whose directory could not be watched, and are checked every update.
+    u32 polled_watch_count;
     f32 device_pixel_ratio;
+    win32_async_io async_io;
+    // Indicates if the window is minimized, so that being restored is reported once.
+    b8 minimized;
+    // darray of pointers to the windows created in addition to the main one.
+    platform_window **windows;
 } platform_state;
 
 static platform_state *state_ptr;
 
 // Clock
 static f64 clock_frequency;
+// Winsock is started the first time a socket is needed, as few applications use it.
+static b8 winsock_started = false;
 static LARGE_INTEGER start_time;
 
+// Not defined by older SDKs. Available from Windows 10 version 1803.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Created on first use by each thread calling platform_sleep_precise.
+static _Thread_local HANDLE sleep_timer = 0;
+
 static void platform_update_watches(void);
+static void watch_dir_destroy(struct win32_watch_dir *d);
+static b8 async_io_startup(win32_async_io *io);
+static void async_io_shutdown(win32_async_io *io);
 LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARAM l_param);
 
 void clock_setup(void) {
@@ -101,12 +201,8 @@ b8 platform_system_startup(u64 *memory_requirement, void *state, void *config) {
     u32 window_width = client_width;
     u32 window_height = client_height;
 
-    u32 window_style = WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION;
-    u32 window_ex_style = WS_EX_APPWINDOW;
-
-    window_style |= WS_MAXIMIZEBOX;
-    window_style |= WS_MINIMIZEBOX;
-    window_style |= WS_THICKFRAME;
+    u32 window_style = WIN32_WINDOW_STYLE;
+    u32 window_ex_style = WIN32_WINDOW_EX_STYLE;
 
     // Obtain the size of the border.
     RECT border_rect = {0, 0, 0, 0};
@@ -141,21 +237,67 @@ b8 platform_system_startup(u64 *memory_requirement, void *state, void *config) {
     // If initially maximized, use SW_SHOWMAXIMIZED : SW_MAXIMIZE
     ShowWindow(state_ptr->handle.hwnd, show_window_command_flags);
 
+    // Ask for raw mouse input, which is unaccelerated and reported for every movement rather than once per cursor move.
+    RAWINPUTDEVICE mouse_device = {0};
+    mouse_device.usUsagePage = 0x01;  // HID_USAGE_PAGE_GENERIC
+    mouse_device.usUsage = 0x02;      // HID_USAGE_GENERIC_MOUSE
+    mouse_device.hwndTarget = state_ptr->handle.hwnd;
+    if (!RegisterRawInputDevices(&mouse_device, 1, sizeof(RAWINPUTDEVICE))) {
+        KWARN("Unable to register for raw mouse input. Mouse deltas will follow the cursor instead.");
+    }
+
     // Clock setup
     clock_setup();
 
+    // Have the scheduler tick every millisecond rather than every 15.6, so that sleeps wake on time.
+    timeBeginPeriod(1);
+
+    if (!async_io_startup(&state_ptr->async_io)) {
+        KWARN("Failed to start asynchronous file I/O. Files will only be read synchronously.");
+    }
+
     return true;
 }
 
 void platform_system_shutdown(void *plat_state) {
+    if (state_ptr) {
+        timeEndPeriod(1);
+
+        async_io_shutdown(&state_ptr->async_io);
+
+        if (state_ptr->watch_dirs) {
+            u32 dir_count = darray_length(state_ptr->watch_dirs);
+            for (u32 i = 0; i < dir_count; ++i) {
+                if (state_ptr->watch_dirs[i]) {
+                    watch_dir_destroy(state_ptr->watch_dirs[i]);
+                    state_ptr->watch_dirs[i] = 0;
+                }
+            }
+        }
+    }
+    if (state_ptr && state_ptr->windows) {
+        while (darray_length(state_ptr->windows)) {
+            platform_window_destroy(state_ptr->windows[0]);
+        }
+        darray_destroy(state_ptr->windows);
+        state_ptr->windows = 0;
+    }
     if (state_ptr && state_ptr->handle.hwnd) {
         DestroyWindow(state_ptr->handle.hwnd);
         state_ptr->handle.hwnd = 0;
     }
+    if (winsock_started) {
+        WSACleanup();
+        winsock_started = false;
+    }
 }
 
-b8 platform_pump_messages(void) {
+b8 platform_pump_messages(f64 max_wait_seconds) {
     if (state_ptr) {
+        // If nothing is waiting, block until something arrives or the wait is up.
+        if (max_wait_seconds > 0) {
+            MsgWaitForMultipleObjectsEx(0, 0, (DWORD)(max_wait_seconds * 1000.0), QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        }
         MSG message;
         while (PeekMessageA(&message, NULL, 0, 0, PM_REMOVE)) {
             TranslateMessage(&message);
@@ -176,6 +318,98 @@ void platform_free(void *block, b8 aligned) {
     HeapFree(GetProcessHeap(), 0, block);
 }
 
+u64 platform_memory_page_size(void) {
+    static u64 page_size = 0;
+    if (!page_size) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_size = info.dwPageSize;
+    }
+    return page_size;
+}
+
+void *platform_memory_reserve(u64 size) {
+    void *address = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (!address) {
+        KERROR("Unable to reserve %llu bytes of address space. Error: %u", size, GetLastError());
+    }
+    return address;
+}
+
+u64 platform_memory_large_page_size(void) {
+    return GetLargePageMinimum();
+}
+
+// Large pages can only be allocated by a process holding SeLockMemoryPrivilege, which must be
+// both granted to the user and enabled on the process' token.
+static b8 large_page_privilege_enable(void) {
+    static i32 enabled = -1;
+    if (enabled == -1) {
+        enabled = 0;
+        HANDLE token;
+        if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            TOKEN_PRIVILEGES privileges = {0};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            if (LookupPrivilegeValueA(0, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)) {
+                // Succeeds even if the privilege is not held, which the last error tells apart.
+                AdjustTokenPrivileges(token, FALSE, &privileges, 0, 0, 0);
+                enabled = GetLastError() == ERROR_SUCCESS;
+            }
+            CloseHandle(token);
+        }
+    }
+    return enabled == 1;
+}
+
+void *platform_memory_reserve_large(u64 size, b8 *out_large_pages) {
+    *out_large_pages = false;
+    u64 large_page_size = platform_memory_large_page_size();
+    if (large_page_size && large_page_privilege_enable()) {
+        size = (size + large_page_size - 1) & ~(large_page_size - 1);
+        void *address = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (address) {
+            *out_large_pages = true;
+            return address;
+        }
+        // Usually too little contiguous physical memory is free.
+        KWARN("Unable to allocate %llu bytes of large pages. Error: %u", size, GetLastError());
+    }
+    return platform_memory_reserve(size);
+}
+
+b8 platform_memory_commit(void *address, u64 size) {
+    // VirtualAlloc rounds the range out to whole pages itself.
+    if (!VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE)) {
+        // Large pages are committed from the start, and can't be committed again.
+        MEMORY_BASIC_INFORMATION info;
+        if (VirtualQuery(address, &info, sizeof(info)) && info.State == MEM_COMMIT && (u8 *)info.BaseAddress + info.RegionSize >= (u8 *)address + size) {
+            return true;
+        }
+        KERROR("Unable to commit %llu bytes of memory. Error: %u", size, GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void platform_memory_decommit(void *address, u64 size) {
+    u64 page_size = platform_memory_page_size();
+    u64 start = ((u64)address + page_size - 1) & ~(page_size - 1);
+    u64 end = ((u64)address + size) & ~(page_size - 1);
+    if (end <= start) {
+        return;
+    }
+    if (!VirtualFree((void *)start, end - start, MEM_DECOMMIT)) {
+        KERROR("Unable to decommit %llu bytes of memory. Error: %u", end - start, GetLastError());
+    }
+}
+
+void platform_memory_release(void *address, u64 size) {
+    if (address && !VirtualFree(address, 0, MEM_RELEASE)) {
+        KERROR("Unable to release reserved memory. Error: %u", GetLastError());
+    }
+}
+
 void *platform_zero_memory(void *block, u64 size) {
     return memset(block, 0, size);
 }
@@ -244,6 +478,45 @@ void platform_sleep(u64 ms) {
     Sleep(ms);
 }
 
+void platform_sleep_precise(f64 seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    if (!sleep_timer) {
+        sleep_timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!sleep_timer) {
+            // Older versions of Windows only have the regular timer, which is as precise as timeBeginPeriod allows.
+            sleep_timer = CreateWaitableTimerExW(0, 0, 0, TIMER_ALL_ACCESS);
+        }
+    }
+    if (!sleep_timer) {
+        Sleep((DWORD)(seconds * 1000.0));
+        return;
+    }
+
+    // Negative due times are relative, in 100 nanosecond intervals.
+    LARGE_INTEGER due_time;
+    due_time.QuadPart = -(LONGLONG)(seconds * 10000000.0);
+    if (SetWaitableTimerEx(sleep_timer, &due_time, 0, 0, 0, 0, 0)) {
+        WaitForSingleObject(sleep_timer, INFINITE);
+    } else {
+        Sleep((DWORD)(seconds * 1000.0));
+    }
+}
+
+void platform_stack_trace_print(u32 skip_count) {
+    // Symbols would take dbghelp, which allocates, so frames are given by address.
+    void *frames[PLATFORM_STACK_TRACE_MAX_FRAMES];
+    USHORT count = CaptureStackBackTrace(skip_count + 1, PLATFORM_STACK_TRACE_MAX_FRAMES, frames, 0);
+    char line[32];
+    HANDLE error_handle = GetStdHandle(STD_ERROR_HANDLE);
+    for (USHORT i = 0; i < count; ++i) {
+        i32 length = string_format(line, "  [%u] %p\n", i, frames[i]);
+        DWORD written = 0;
+        WriteFile(error_handle, line, (DWORD)length, &written, 0);
+    }
+}
+
 i32 platform_get_processor_count(void) {
     SYSTEM_INFO sysinfo;
     GetSystemInfo(&sysinfo);
@@ -251,6 +524,93 @@ i32 platform_get_processor_count(void) {
     return sysinfo.dwNumberOfProcessors;
 }
 
+b8 platform_cpu_topology_get(platform_cpu_topology *out_topology) {
+    kzero_memory(out_topology, sizeof(platform_cpu_topology));
+
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, 0, &length);
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *buffer = length ? platform_allocate(length, false) : 0;
+    if (!buffer || !GetLogicalProcessorInformationEx(RelationAll, buffer, &length)) {
+        if (buffer) {
+            platform_free(buffer, false);
+        }
+        // Guess one core per logical processor.
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        out_topology->logical_processor_count = info.dwNumberOfProcessors;
+        out_topology->core_count = KMIN(info.dwNumberOfProcessors, PLATFORM_MAX_CPU_CORES);
+        out_topology->performance_core_count = out_topology->core_count;
+        out_topology->numa_node_count = 1;
+        for (u32 i = 0; i < out_topology->core_count; ++i) {
+            out_topology->cores[i].processors.processor_count = 1;
+            out_topology->cores[i].processors.processors[0] = i;
+        }
+        return false;
+    }
+    u8 *end = (u8 *)buffer + length;
+
+    // Cores report an efficiency class, higher being faster. Below the highest is an efficiency core.
+    BYTE max_class = 0;
+    for (u8 *p = (u8 *)buffer; p < end; p += ((SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p)->Size) {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *entry = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p;
+        if (entry->Relationship == RelationProcessorCore) {
+            max_class = KMAX(max_class, entry->Processor.EfficiencyClass);
+        }
+    }
+
+    // Logical processors are numbered as 64 per processor group.
+    for (u32 pass = 0; pass < 2; ++pass) {
+        platform_core_class wanted = pass == 0 ? PLATFORM_CORE_CLASS_PERFORMANCE : PLATFORM_CORE_CLASS_EFFICIENCY;
+        for (u8 *p = (u8 *)buffer; p < end; p += ((SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p)->Size) {
+            SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *entry = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p;
+            if (entry->Relationship != RelationProcessorCore || out_topology->core_count == PLATFORM_MAX_CPU_CORES) {
+                continue;
+            }
+            b8 is_efficiency = entry->Processor.EfficiencyClass < max_class;
+            if ((is_efficiency ? PLATFORM_CORE_CLASS_EFFICIENCY : PLATFORM_CORE_CLASS_PERFORMANCE) != wanted) {
+                continue;
+            }
+            platform_cpu_core *core = &out_topology->cores[out_topology->core_count++];
+            core->core_class = wanted;
+            for (WORD g = 0; g < entry->Processor.GroupCount; ++g) {
+                GROUP_AFFINITY *group = &entry->Processor.GroupMask[g];
+                for (u32 bit = 0; bit < 64; ++bit) {
+                    if ((group->Mask >> bit) & 1) {
+                        if (core->processors.processor_count < KTHREAD_AFFINITY_MAX_PROCESSORS) {
+                            core->processors.processors[core->processors.processor_count++] = group->Group * 64 + bit;
+                        }
+                        out_topology->logical_processor_count++;
+                    }
+                }
+            }
+            if (is_efficiency) {
+                out_topology->efficiency_core_count++;
+            } else {
+                out_topology->performance_core_count++;
+            }
+        }
+    }
+
+    // Find the node of each core from its first processor.
+    for (u8 *p = (u8 *)buffer; p < end; p += ((SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p)->Size) {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *entry = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)p;
+        if (entry->Relationship != RelationNumaNode) {
+            continue;
+        }
+        out_topology->numa_node_count = KMAX(out_topology->numa_node_count, entry->NumaNode.NodeNumber + 1);
+        for (u32 i = 0; i < out_topology->core_count; ++i) {
+            u32 first = out_topology->cores[i].processors.processors[0];
+            if (first / 64 == entry->NumaNode.GroupMask.Group && ((entry->NumaNode.GroupMask.Mask >> (first % 64)) & 1)) {
+                out_topology->cores[i].numa_node = entry->NumaNode.NodeNumber;
+            }
+        }
+    }
+    out_topology->numa_node_count = KMAX(out_topology->numa_node_count, 1);
+
+    platform_free(buffer, false);
+    return true;
+}
+
 void platform_get_handle_info(u64 *out_size, void *memory) {
     *out_size = sizeof(win32_handle_info);
     if (!memory) {
@@ -260,6 +620,76 @@ void platform_get_handle_info(u64 *out_size, void *memory) {
     kcopy_memory(memory, &state_ptr->handle, *out_size);
 }
 
+platform_window *platform_window_create(const platform_window_config *config) {
+    if (!state_ptr || !config) {
+        return 0;
+    }
+
+    platform_window *window = kallocate(sizeof(platform_window), MEMORY_TAG_ENGINE);
+    window->handle.h_instance = state_ptr->handle.h_instance;
+    window->width = config->width;
+    window->height = config->height;
+
+    // Grow by the size of the OS border, as the main window does.
+    RECT border_rect = {0, 0, 0, 0};
+    AdjustWindowRectEx(&border_rect, WIN32_WINDOW_STYLE, 0, WIN32_WINDOW_EX_STYLE);
+    i32 window_x = config->x + border_rect.left;
+    i32 window_y = config->y + border_rect.top;
+    i32 window_width = config->width + border_rect.right - border_rect.left;
+    i32 window_height = config->height + border_rect.bottom - border_rect.top;
+
+    // The window is handed over on creation, so messages sent before CreateWindowExA returns know it too.
+    window->handle.hwnd = CreateWindowExA(
+        WIN32_WINDOW_EX_STYLE, "kohi_window_class", config->title ? config->title : "",
+        WIN32_WINDOW_STYLE, window_x, window_y, window_width, window_height,
+        0, 0, state_ptr->handle.h_instance, window);
+    if (!window->handle.hwnd) {
+        KERROR("Failed to create window '%s'.", config->title ? config->title : "");
+        kfree(window, sizeof(platform_window), MEMORY_TAG_ENGINE);
+        return 0;
+    }
+
+    ShowWindow(window->handle.hwnd, SW_SHOW);
+
+    if (!state_ptr->windows) {
+        state_ptr->windows = darray_create(platform_window *);
+    }
+    darray_push(state_ptr->windows, window);
+    return window;
+}
+
+void platform_window_destroy(platform_window *window) {
+    if (!state_ptr || !window) {
+        return;
+    }
+
+    u32 window_count = state_ptr->windows ? darray_length(state_ptr->windows) : 0;
+    for (u32 i = 0; i < window_count; ++i) {
+        if (state_ptr->windows[i] == window) {
+            platform_window *popped;
+            darray_pop_at(state_ptr->windows, i, &popped);
+            break;
+        }
+    }
+
+    DestroyWindow(window->handle.hwnd);
+    kfree(window, sizeof(platform_window), MEMORY_TAG_ENGINE);
+}
+
+void platform_window_get_handle_info(platform_window *window, u64 *out_size, void *memory) {
+    *out_size = sizeof(win32_handle_info);
+    if (!memory || !window) {
+        return;
+    }
+
+    kcopy_memory(memory, &window->handle, *out_size);
+}
+
+void platform_window_size_get(const platform_window *window, u32 *out_width, u32 *out_height) {
+    *out_width = window ? window->width : 0;
+    *out_height = window ? window->height : 0;
+}
+
 f32 platform_device_pixel_ratio(void) {
     return state_ptr->device_pixel_ratio;
 }
@@ -314,6 +744,17 @@ void kthread_cancel(kthread *thread) {
     }
 }
 
+b8 kthread_wait(kthread *thread) {
+    if (thread && thread->internal_data) {
+        DWORD exit_code = WaitForSingleObject(thread->internal_data, INFINITE);
+        if (exit_code == WAIT_OBJECT_0) {
+            kthread_destroy(thread);
+            return true;
+        }
+    }
+    return false;
+}
+
 b8 kthread_is_active(kthread *thread) {
     if (thread && thread->internal_data) {
         DWORD exit_code = WaitForSingleObject(thread->internal_data, 0);
@@ -328,6 +769,74 @@ void kthread_sleep(kthread *thread, u64 ms) {
     platform_sleep(ms);
 }
 
+// NOTE: Begin fibers.
+
+b8 kfiber_thread_convert(kfiber *out_fiber) {
+    out_fiber->internal_data = ConvertThreadToFiber(0);
+    if (!out_fiber->internal_data) {
+        KERROR("kfiber_thread_convert - unable to convert thread %#x to a fiber. Error: %u", GetCurrentThreadId(), GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void kfiber_thread_revert(kfiber *fiber) {
+    if (fiber->internal_data) {
+        ConvertFiberToThread();
+        fiber->internal_data = 0;
+    }
+}
+
+b8 kfiber_create(pfn_fiber_start start_function_ptr, void *params, u64 stack_size, kfiber *out_fiber) {
+    if (!start_function_ptr || !out_fiber) {
+        return false;
+    }
+    // Only the stack's size is reserved, with pages committed as it grows.
+    out_fiber->internal_data = CreateFiberEx(0, stack_size, 0, (LPFIBER_START_ROUTINE)start_function_ptr, params);
+    if (!out_fiber->internal_data) {
+        KERROR("kfiber_create - unable to create a fiber. Error: %u", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void kfiber_destroy(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        DeleteFiber(fiber->internal_data);
+        fiber->internal_data = 0;
+    }
+}
+
+void kfiber_switch(kfiber *from, kfiber *to) {
+    SwitchToFiber(to->internal_data);
+}
+
+// NOTE: End fibers.
+
+b8 kthread_affinity_set_current(const kthread_affinity *affinity) {
+    GROUP_AFFINITY group = {0};
+    if (!affinity || !affinity->processor_count) {
+        // Any processor the process may run on, within the thread's group.
+        DWORD_PTR process_mask, system_mask;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) || !SetThreadAffinityMask(GetCurrentThread(), process_mask)) {
+            return false;
+        }
+        return true;
+    }
+    // A thread can only be pinned within one processor group, that of the first processor.
+    group.Group = (WORD)(affinity->processors[0] / 64);
+    for (u32 i = 0; i < affinity->processor_count; ++i) {
+        if (affinity->processors[i] / 64 == group.Group) {
+            group.Mask |= (KAFFINITY)1 << (affinity->processors[i] % 64);
+        }
+    }
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &group, 0)) {
+        KWARN("Unable to set the affinity of thread %#x. Error: %u", GetCurrentThreadId(), GetLastError());
+        return false;
+    }
+    return true;
+}
+
 u64 platform_current_thread_id(void) {
     return (u64)GetCurrentThreadId();
 }
@@ -345,6 +854,9 @@ b8 kmutex_create(kmutex *out_mutex) {
         KERROR("Unable to create mutex.");
         return false;
     }
+#if KMUTEX_INSTRUMENTED == 1
+    out_mutex->stats = 0;
+#endif
     // KTRACE("Created mutex.");
     return true;
 }
@@ -354,6 +866,9 @@ void kmutex_destroy(kmutex *mutex) {
         CloseHandle(mutex->internal_data);
         // KTRACE("Destroyed mutex.");
         mutex->internal_data = 0;
+#if KMUTEX_INSTRUMENTED == 1
+        kmutex_stats_release(mutex);
+#endif
     }
 }
 
@@ -362,7 +877,25 @@ b8 kmutex_lock(kmutex *mutex) {
         return false;
     }
 
+#if KMUTEX_INSTRUMENTED == 1
+    DWORD result;
+    f64 wait_start = 0;
+    if (mutex->stats) {
+        // Only a lock which can't be taken straight away is contended.
+        result = WaitForSingleObject(mutex->internal_data, 0);
+        if (result == WAIT_TIMEOUT) {
+            wait_start = kmutex_stats_contended(mutex);
+            result = WaitForSingleObject(mutex->internal_data, INFINITE);
+        }
+        if (result == WAIT_OBJECT_0) {
+            kmutex_stats_acquired(mutex, wait_start);
+        }
+    } else {
+        result = WaitForSingleObject(mutex->internal_data, INFINITE);
+    }
+#else
     DWORD result = WaitForSingleObject(mutex->internal_data, INFINITE);
+#endif
     switch (result) {
         // The thread got ownership of the mutex
         case WAIT_OBJECT_0:
@@ -382,6 +915,9 @@ b8 kmutex_unlock(kmutex *mutex) {
     if (!mutex || !mutex->internal_data) {
         return false;
     }
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_releasing(mutex);
+#endif
     i32 result = ReleaseMutex(mutex->internal_data);
     // KTRACE("Mutex unlocked.");
     return result != 0;  // 0 is a failure
@@ -389,6 +925,97 @@ b8 kmutex_unlock(kmutex *mutex) {
 
 // NOTE: End mutexes.
 
+// NOTE: Begin condition variables
+// NOTE: Since kmutex is backed by a kernel mutex object on this platform, native
+// CONDITION_VARIABLEs cannot be used with it. Instead, a semaphore is used along
+// with a count of waiting threads. SignalObjectAndWait releases the mutex and
+// begins waiting atomically, so no wakeups are missed.
+typedef struct win32_condvar {
+    HANDLE semaphore;
+    volatile LONG waiter_count;
+} win32_condvar;
+
+b8 kcondvar_create(kcondvar *out_condvar) {
+    if (!out_condvar) {
+        return false;
+    }
+
+    HANDLE semaphore = CreateSemaphore(0, 0, MAXLONG, 0);
+    if (!semaphore) {
+        KERROR("Unable to create condition variable.");
+        return false;
+    }
+
+    win32_condvar *cv = platform_allocate(sizeof(win32_condvar), false);
+    cv->semaphore = semaphore;
+    cv->waiter_count = 0;
+    out_condvar->internal_data = cv;
+    return true;
+}
+
+void kcondvar_destroy(kcondvar *condvar) {
+    if (condvar && condvar->internal_data) {
+        win32_condvar *cv = condvar->internal_data;
+        CloseHandle(cv->semaphore);
+        platform_free(cv, false);
+        condvar->internal_data = 0;
+    }
+}
+
+static b8 win32_condvar_wait(kcondvar *condvar, kmutex *mutex, DWORD timeout_ms) {
+    if (!condvar || !condvar->internal_data || !mutex || !mutex->internal_data) {
+        return false;
+    }
+    win32_condvar *cv = condvar->internal_data;
+
+#if KMUTEX_INSTRUMENTED == 1
+    // The mutex isn't held while waiting.
+    kmutex_stats_releasing(mutex);
+#endif
+    InterlockedIncrement(&cv->waiter_count);
+    DWORD result = SignalObjectAndWait(mutex->internal_data, cv->semaphore, timeout_ms, FALSE);
+    InterlockedDecrement(&cv->waiter_count);
+
+    // Always reacquire the mutex before returning, regardless of the wait result.
+    WaitForSingleObject(mutex->internal_data, INFINITE);
+#if KMUTEX_INSTRUMENTED == 1
+    kmutex_stats_acquired(mutex, 0);
+#endif
+    return result == WAIT_OBJECT_0;
+}
+
+b8 kcondvar_wait(kcondvar *condvar, kmutex *mutex) {
+    return win32_condvar_wait(condvar, mutex, INFINITE);
+}
+
+b8 kcondvar_wait_timeout(kcondvar *condvar, kmutex *mutex, u64 timeout_ms) {
+    return win32_condvar_wait(condvar, mutex, (DWORD)timeout_ms);
+}
+
+b8 kcondvar_signal(kcondvar *condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    win32_condvar *cv = condvar->internal_data;
+    if (cv->waiter_count > 0) {
+        return ReleaseSemaphore(cv->semaphore, 1, 0) != 0;
+    }
+    return true;
+}
+
+b8 kcondvar_broadcast(kcondvar *condvar) {
+    if (!condvar || !condvar->internal_data) {
+        return false;
+    }
+    win32_condvar *cv = condvar->internal_data;
+    LONG count = cv->waiter_count;
+    if (count > 0) {
+        return ReleaseSemaphore(cv->semaphore, count, 0) != 0;
+    }
+    return true;
+}
+// NOTE: End condition variables.
+
 b8 platform_dynamic_library_load(const char *name, dynamic_library *out_library) {
     if (!out_library) {
         return false;
@@ -507,6 +1134,311 @@ platform_error_code platform_copy_file(const char *source, const char *dest, b8
     return PLATFORM_ERROR_SUCCESS;
 }
 
+b8 platform_file_map(const char *path, u64 offset, u64 size, struct file_mapping *out_mapping) {
+    if (!path || !out_mapping) {
+        return false;
+    }
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        KERROR("Unable to open file '%s' for mapping. Error: %u", path, GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER large_size;
+    if (!GetFileSizeEx(file, &large_size)) {
+        KERROR("Unable to get the size of file '%s' for mapping. Error: %u", path, GetLastError());
+        CloseHandle(file);
+        return false;
+    }
+    u64 file_size = (u64)large_size.QuadPart;
+    if (offset > file_size || size > file_size - offset) {
+        KERROR("Range of %llu bytes at offset %llu is outside file '%s' of %llu bytes.", size, offset, path, file_size);
+        CloseHandle(file);
+        return false;
+    }
+    if (size == 0) {
+        size = file_size - offset;
+    }
+    if (size == 0) {
+        KERROR("Unable to map an empty range of file '%s'.", path);
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    // The mapping object holds its own reference to the file.
+    CloseHandle(file);
+    if (!mapping) {
+        KERROR("Unable to create a mapping of file '%s'. Error: %u", path, GetLastError());
+        return false;
+    }
+
+    // Views must begin on a multiple of the allocation granularity.
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    u64 granularity = info.dwAllocationGranularity;
+    u64 view_offset = offset - (offset % granularity);
+    u64 view_size = size + (offset - view_offset);
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(view_offset >> 32), (DWORD)(view_offset & 0xFFFFFFFF), (SIZE_T)view_size);
+    // The view keeps the mapping object alive.
+    CloseHandle(mapping);
+    if (!view) {
+        KERROR("Unable to map a view of file '%s'. Error: %u", path, GetLastError());
+        return false;
+    }
+
+    out_mapping->view = view;
+    out_mapping->view_size = view_size;
+    out_mapping->data = (const u8 *)view + (offset - view_offset);
+    out_mapping->size = size;
+    return true;
+}
+
+void platform_file_unmap(struct file_mapping *mapping) {
+    if (mapping && mapping->view) {
+        if (!UnmapViewOfFile(mapping->view)) {
+            KERROR("Failed to unmap file view. Error: %u", GetLastError());
+        }
+    }
+}
+
+// Issues the read of the next part of the file. The completion is queued to the port either way.
+static b8 async_read_issue(win32_async_read *read) {
+    u64 remaining = read->size - read->offset;
+    DWORD part_size = (DWORD)KMIN(remaining, ASYNC_IO_MAX_READ_SIZE);
+    read->overlapped.Offset = (DWORD)(read->offset & 0xFFFFFFFF);
+    read->overlapped.OffsetHigh = (DWORD)(read->offset >> 32);
+    if (!ReadFile(read->file, read->data + read->offset, part_size, 0, &read->overlapped)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_PENDING) {
+            KERROR("Asynchronous read failed to start. Error: %u", error);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Completes a read, handing its data off to the callback.
+static void async_read_complete(win32_async_io *io, win32_async_read *read, b8 success) {
+    CloseHandle(read->file);
+    if (!success) {
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+        read->data = 0;
+    }
+    // Once shutdown begins, whatever the callbacks would hand data off to may already be gone.
+    if (io->running) {
+        read->callback(success, read->data, read->size, read->user_data);
+    } else if (read->data) {
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+    }
+    kfree(read, sizeof(win32_async_read), MEMORY_TAG_RESOURCE);
+}
+
+static u32 async_io_thread(void *params) {
+    win32_async_io *io = params;
+    b8 stopping = false;
+    while (!stopping || io->in_flight) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED *overlapped = 0;
+        BOOL ok = GetQueuedCompletionStatus(io->port, &bytes, &key, &overlapped, INFINITE);
+        if (!overlapped) {
+            if (key == ASYNC_IO_KEY_SHUTDOWN) {
+                stopping = true;
+                continue;
+            }
+            KERROR("GetQueuedCompletionStatus failed. Error: %u", GetLastError());
+            break;
+        }
+
+        win32_async_read *read = (win32_async_read *)overlapped;
+        if (!ok || bytes == 0) {
+            KERROR("Asynchronous read failed at %llu of %llu bytes. Error: %u", read->offset, read->size, GetLastError());
+            InterlockedDecrement(&io->in_flight);
+            async_read_complete(io, read, false);
+            continue;
+        }
+
+        read->offset += bytes;
+        if (read->offset < read->size) {
+            if (async_read_issue(read)) {
+                continue;
+            }
+            InterlockedDecrement(&io->in_flight);
+            async_read_complete(io, read, false);
+        } else {
+            InterlockedDecrement(&io->in_flight);
+            async_read_complete(io, read, true);
+        }
+    }
+    return 0;
+}
+
+static b8 async_io_startup(win32_async_io *io) {
+    kzero_memory(io, sizeof(win32_async_io));
+    io->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 1);
+    if (!io->port) {
+        KERROR("Failed to create I/O completion port. Error: %u", GetLastError());
+        return false;
+    }
+    io->running = true;
+    if (!kthread_create(async_io_thread, io, false, &io->thread)) {
+        CloseHandle(io->port);
+        io->port = 0;
+        io->running = false;
+        return false;
+    }
+    return true;
+}
+
+static void async_io_shutdown(win32_async_io *io) {
+    if (!io->running) {
+        return;
+    }
+    io->running = false;
+    // The thread keeps going until outstanding reads are done, as they still use their buffers.
+    PostQueuedCompletionStatus(io->port, 0, ASYNC_IO_KEY_SHUTDOWN, 0);
+    kthread_wait(&io->thread);
+    CloseHandle(io->port);
+    io->port = 0;
+}
+
+b8 platform_file_read_async(const char *path, pfn_filesystem_read_complete callback, void *user_data) {
+    if (!state_ptr || !state_ptr->async_io.running) {
+        return false;
+    }
+    win32_async_io *io = &state_ptr->async_io;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        KERROR("platform_file_read_async - Unable to open file '%s'. Error: %u", path, GetLastError());
+        return false;
+    }
+    LARGE_INTEGER large_size;
+    if (!GetFileSizeEx(file, &large_size) || large_size.QuadPart <= 0) {
+        KERROR("platform_file_read_async - Unable to get the size of file '%s', or it is empty.", path);
+        CloseHandle(file);
+        return false;
+    }
+    if (!CreateIoCompletionPort(file, io->port, 0, 0)) {
+        KERROR("platform_file_read_async - Unable to associate file '%s' with the completion port. Error: %u", path, GetLastError());
+        CloseHandle(file);
+        return false;
+    }
+
+    win32_async_read *read = kallocate(sizeof(win32_async_read), MEMORY_TAG_RESOURCE);
+    read->file = file;
+    read->size = (u64)large_size.QuadPart;
+    read->data = kallocate(read->size, MEMORY_TAG_RESOURCE);
+    read->callback = callback;
+    read->user_data = user_data;
+
+    InterlockedIncrement(&io->in_flight);
+    if (!async_read_issue(read)) {
+        InterlockedDecrement(&io->in_flight);
+        CloseHandle(file);
+        kfree(read->data, read->size, MEMORY_TAG_RESOURCE);
+        kfree(read, sizeof(win32_async_read), MEMORY_TAG_RESOURCE);
+        return false;
+    }
+    return true;
+}
+
+// Splits a file path into its directory and file name. The directory is written to out_dir.
+static const char *watch_path_split(const char *file_path, char *out_dir, u64 dir_size) {
+    const char *slash = 0;
+    for (const char *c = file_path; *c; ++c) {
+        if (*c == '/' || *c == '\\') {
+            slash = c;
+        }
+    }
+    if (!slash) {
+        string_ncopy(out_dir, ".", dir_size);
+        return file_path;
+    }
+    u64 length = KMIN((u64)(slash - file_path + 1), dir_size - 1);
+    kcopy_memory(out_dir, file_path, length);
+    out_dir[length] = 0;
+    return slash + 1;
+}
+
+// Queues the next read of changes in the directory.
+static b8 watch_dir_read_issue(win32_watch_dir *d) {
+    kzero_memory(&d->overlapped, sizeof(OVERLAPPED));
+    if (!ReadDirectoryChangesW(d->handle, d->buffer, FILE_WATCH_BUFFER_SIZE, FALSE, FILE_WATCH_NOTIFY_FILTER, 0, &d->overlapped, 0)) {
+        KWARN("Failed to read changes to directory '%s'. Error: %u", d->path, GetLastError());
+        return false;
+    }
+    return true;
+}
+
+// Stops watching the directory, waiting for any outstanding read to be cancelled before its buffer is released.
+static void watch_dir_destroy(win32_watch_dir *d) {
+    if (d->reading) {
+        DWORD bytes;
+        CancelIoEx(d->handle, &d->overlapped);
+        GetOverlappedResult(d->handle, &d->overlapped, &bytes, TRUE);
+    }
+    CloseHandle(d->handle);
+    string_free(d->path);
+    kfree(d, sizeof(win32_watch_dir), MEMORY_TAG_ENGINE);
+}
+
+// Starts watching the directory, or shares an existing watch of it. Returns the directory, or 0 if it cannot be watched.
+static win32_watch_dir *watch_dir_acquire(const char *dir_path) {
+    u32 count = darray_length(state_ptr->watch_dirs);
+    for (u32 i = 0; i < count; ++i) {
+        win32_watch_dir *d = state_ptr->watch_dirs[i];
+        if (d && strings_equali(d->path, dir_path)) {
+            d->watch_count++;
+            return d;
+        }
+    }
+
+    HANDLE handle = CreateFileA(dir_path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, 0);
+    if (handle == INVALID_HANDLE_VALUE) {
+        KWARN("Unable to watch directory '%s'. Its files will be polled. Error: %u", dir_path, GetLastError());
+        return 0;
+    }
+
+    // Allocated individually, as the OVERLAPPED must stay put while a read is outstanding.
+    win32_watch_dir *d = kallocate(sizeof(win32_watch_dir), MEMORY_TAG_ENGINE);
+    d->handle = handle;
+    d->path = string_duplicate(dir_path);
+    d->watch_count = 1;
+    d->reading = watch_dir_read_issue(d);
+    if (!d->reading) {
+        watch_dir_destroy(d);
+        return 0;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        if (!state_ptr->watch_dirs[i]) {
+            state_ptr->watch_dirs[i] = d;
+            return d;
+        }
+    }
+    darray_push(state_ptr->watch_dirs, d);
+    return d;
+}
+
+static void watch_dir_release(win32_watch_dir *dir) {
+    dir->watch_count--;
+    if (dir->watch_count) {
+        return;
+    }
+    u32 count = darray_length(state_ptr->watch_dirs);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watch_dirs[i] == dir) {
+            state_ptr->watch_dirs[i] = 0;
+            break;
+        }
+    }
+    watch_dir_destroy(dir);
+}
+
 static b8 register_watch(const char *file_path, u32 *out_watch_id) {
     if (!state_ptr || !file_path || !out_watch_id) {
         if (out_watch_id) {
@@ -518,6 +1450,7 @@ static b8 register_watch(const char *file_path, u32 *out_watch_id) {
 
     if (!state_ptr->watches) {
         state_ptr->watches = darray_create(win32_file_watch);
+        state_ptr->watch_dirs = darray_create(win32_watch_dir *);
     }
 
     WIN32_FIND_DATAA data;
@@ -530,24 +1463,29 @@ static b8 register_watch(const char *file_path, u32 *out_watch_id) {
         return false;
     }
 
+    win32_file_watch w = {0};
+    w.file_path = string_duplicate(file_path);
+    w.last_write_time = data.ftLastWriteTime;
+    char dir_path[MAX_PATH];
+    w.file_name = watch_path_split(w.file_path, dir_path, MAX_PATH);
+    w.dir = watch_dir_acquire(dir_path);
+    if (!w.dir) {
+        state_ptr->polled_watch_count++;
+    }
+
     u32 count = darray_length(state_ptr->watches);
     for (u32 i = 0; i < count; ++i) {
-        win32_file_watch *w = &state_ptr->watches[i];
-        if (w->id == INVALID_ID) {
+        if (state_ptr->watches[i].id == INVALID_ID) {
             // Found a free slot to use.
-            w->id = i;
-            w->file_path = string_duplicate(file_path);
-            w->last_write_time = data.ftLastWriteTime;
+            w.id = i;
+            state_ptr->watches[i] = w;
             *out_watch_id = i;
             return true;
         }
     }
 
     // If no empty slot is available, create and push a new entry.
-    win32_file_watch w = {0};
     w.id = count;
-    w.file_path = string_duplicate(file_path);
-    w.last_write_time = data.ftLastWriteTime;
     *out_watch_id = count;
     darray_push(state_ptr->watches, w);
 
@@ -565,11 +1503,21 @@ static b8 unregister_watch(u32 watch_id) {
     }
 
     win32_file_watch *w = &state_ptr->watches[watch_id];
-    w->id = INVALID_ID;
+    if (w->id == INVALID_ID) {
+        return false;
+    }
+    if (w->dir) {
+        watch_dir_release(w->dir);
+    } else {
+        state_ptr->polled_watch_count--;
+    }
+    if (w->pending != FILE_WATCH_PENDING_NONE) {
+        state_ptr->pending_watch_count--;
+    }
     u32 len = string_length(w->file_path);
     kfree((void *)w->file_path, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
-    w->file_path = 0;
-    kzero_memory(&w->last_write_time, sizeof(FILETIME));
+    kzero_memory(w, sizeof(win32_file_watch));
+    w->id = INVALID_ID;
 
     return true;
 }
@@ -582,55 +1530,273 @@ b8 platform_unwatch_file(u32 watch_id) {
     return unregister_watch(watch_id);
 }
 
+// How often an empty slot is checked for a gamepad. Querying one stalls for a while.
+#define GAMEPAD_CONNECT_RETRY_SECONDS 1.0
+
+typedef DWORD(WINAPI *PFN_XInputGetState)(DWORD user_index, XINPUT_STATE *state);
+
+// Kept apart from the platform state, as gamepads are sampled by the input system, which
+// starts before the platform does and may sample on a thread of its own. XInput is loaded
+// at runtime so that no particular version of it is required.
+static HMODULE xinput_library;
+static PFN_XInputGetState xinput_get_state;
+static b8 xinput_load_attempted;
+static f64 gamepad_next_connect_time[INPUT_MAX_GAMEPADS];
+
+static const struct {
+    WORD xinput_button;
+    gamepad_buttons button;
+} win32_gamepad_buttons[] = {
+    {XINPUT_GAMEPAD_A, GAMEPAD_BUTTON_A},
+    {XINPUT_GAMEPAD_B, GAMEPAD_BUTTON_B},
+    {XINPUT_GAMEPAD_X, GAMEPAD_BUTTON_X},
+    {XINPUT_GAMEPAD_Y, GAMEPAD_BUTTON_Y},
+    {XINPUT_GAMEPAD_LEFT_SHOULDER, GAMEPAD_BUTTON_LEFT_SHOULDER},
+    {XINPUT_GAMEPAD_RIGHT_SHOULDER, GAMEPAD_BUTTON_RIGHT_SHOULDER},
+    {XINPUT_GAMEPAD_BACK, GAMEPAD_BUTTON_BACK},
+    {XINPUT_GAMEPAD_START, GAMEPAD_BUTTON_START},
+    {XINPUT_GAMEPAD_LEFT_THUMB, GAMEPAD_BUTTON_LEFT_STICK},
+    {XINPUT_GAMEPAD_RIGHT_THUMB, GAMEPAD_BUTTON_RIGHT_STICK},
+    {XINPUT_GAMEPAD_DPAD_UP, GAMEPAD_BUTTON_DPAD_UP},
+    {XINPUT_GAMEPAD_DPAD_DOWN, GAMEPAD_BUTTON_DPAD_DOWN},
+    {XINPUT_GAMEPAD_DPAD_LEFT, GAMEPAD_BUTTON_DPAD_LEFT},
+    {XINPUT_GAMEPAD_DPAD_RIGHT, GAMEPAD_BUTTON_DPAD_RIGHT}};
+
+static f32 gamepad_stick_value(SHORT value) {
+    return KMAX(value / 32767.0f, -1.0f);
+}
+
+void platform_gamepads_sample(platform_gamepad_state *out_states) {
+    kzero_memory(out_states, sizeof(platform_gamepad_state) * INPUT_MAX_GAMEPADS);
+    if (!xinput_load_attempted) {
+        xinput_load_attempted = true;
+        xinput_library = LoadLibraryA("xinput1_4.dll");
+        if (!xinput_library) {
+            xinput_library = LoadLibraryA("xinput9_1_0.dll");
+        }
+        if (xinput_library) {
+            xinput_get_state = (PFN_XInputGetState)GetProcAddress(xinput_library, "XInputGetState");
+        }
+        if (!xinput_get_state) {
+            KWARN("XInput is not available. Gamepads will not be read.");
+        }
+    }
+    if (!xinput_get_state) {
+        return;
+    }
+
+    f64 now = platform_get_absolute_time();
+    for (DWORD i = 0; i < INPUT_MAX_GAMEPADS && i < XUSER_MAX_COUNT; ++i) {
+        if (now < gamepad_next_connect_time[i]) {
+            continue;
+        }
+
+        XINPUT_STATE xstate;
+        if (xinput_get_state(i, &xstate) != ERROR_SUCCESS) {
+            gamepad_next_connect_time[i] = now + GAMEPAD_CONNECT_RETRY_SECONDS;
+            continue;
+        }
+
+        platform_gamepad_state *state = &out_states[i];
+        state->connected = true;
+        for (u32 b = 0; b < sizeof(win32_gamepad_buttons) / sizeof(win32_gamepad_buttons[0]); ++b) {
+            if (xstate.Gamepad.wButtons & win32_gamepad_buttons[b].xinput_button) {
+                state->buttons |= (1u << win32_gamepad_buttons[b].button);
+            }
+        }
+        state->axes[GAMEPAD_AXIS_LEFT_X] = gamepad_stick_value(xstate.Gamepad.sThumbLX);
+        state->axes[GAMEPAD_AXIS_LEFT_Y] = gamepad_stick_value(xstate.Gamepad.sThumbLY);
+        state->axes[GAMEPAD_AXIS_RIGHT_X] = gamepad_stick_value(xstate.Gamepad.sThumbRX);
+        state->axes[GAMEPAD_AXIS_RIGHT_Y] = gamepad_stick_value(xstate.Gamepad.sThumbRY);
+        state->axes[GAMEPAD_AXIS_LEFT_TRIGGER] = xstate.Gamepad.bLeftTrigger / 255.0f;
+        state->axes[GAMEPAD_AXIS_RIGHT_TRIGGER] = xstate.Gamepad.bRightTrigger / 255.0f;
+    }
+}
+
+void platform_gamepads_release(void) {
+    if (xinput_library) {
+        FreeLibrary(xinput_library);
+        xinput_library = 0;
+    }
+    xinput_get_state = 0;
+    xinput_load_attempted = false;
+    kzero_memory(gamepad_next_connect_time, sizeof(gamepad_next_connect_time));
+}
+
+// Records a change to be reported once the file has been quiet for the debounce interval.
+static void watch_mark_pending(win32_file_watch *w, win32_file_watch_pending pending, f64 now) {
+    if (w->pending == FILE_WATCH_PENDING_NONE) {
+        state_ptr->pending_watch_count++;
+    }
+    w->pending = pending;
+    w->pending_time = now;
+}
+
+// Moves the files in a directory which can no longer be watched over to polling, and stops watching it.
+static void watch_dir_abandon(win32_watch_dir *d) {
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        win32_file_watch *w = &state_ptr->watches[i];
+        if (w->id != INVALID_ID && w->dir == d) {
+            if (w->pending != FILE_WATCH_PENDING_NONE) {
+                w->pending = FILE_WATCH_PENDING_NONE;
+                state_ptr->pending_watch_count--;
+            }
+            w->dir = 0;
+            state_ptr->polled_watch_count++;
+            d->watch_count--;
+        }
+    }
+    // Drops the last reference.
+    d->watch_count++;
+    watch_dir_release(d);
+}
+
+static void watch_dir_changes_read(win32_watch_dir *d, f64 now) {
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(d->handle, &d->overlapped, &bytes, FALSE)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_INCOMPLETE) {
+            KWARN("Failed to read changes to directory '%s'. Its files will be polled. Error: %u", d->path, error);
+            d->reading = false;
+            watch_dir_abandon(d);
+        }
+        return;
+    }
+
+    u32 count = darray_length(state_ptr->watches);
+    if (bytes == 0) {
+        // The buffer overflowed. Anything may have changed, so check everything in it.
+        for (u32 i = 0; i < count; ++i) {
+            if (state_ptr->watches[i].id != INVALID_ID && state_ptr->watches[i].dir == d) {
+                watch_mark_pending(&state_ptr->watches[i], FILE_WATCH_PENDING_WRITTEN, now);
+            }
+        }
+    } else {
+        for (u8 *p = (u8 *)d->buffer;;) {
+            FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)p;
+            char name[MAX_PATH];
+            i32 length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), name, MAX_PATH - 1, 0, 0);
+            name[length] = 0;
+
+            win32_file_watch_pending pending = (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME)
+                                                   ? FILE_WATCH_PENDING_DELETED
+                                                   : FILE_WATCH_PENDING_WRITTEN;
+            for (u32 i = 0; i < count; ++i) {
+                win32_file_watch *w = &state_ptr->watches[i];
+                if (w->id != INVALID_ID && w->dir == d && strings_equali(w->file_name, name)) {
+                    watch_mark_pending(w, pending, now);
+                }
+            }
+
+            if (!info->NextEntryOffset) {
+                break;
+            }
+            p += info->NextEntryOffset;
+        }
+    }
+
+    d->reading = watch_dir_read_issue(d);
+    if (!d->reading) {
+        watch_dir_abandon(d);
+    }
+}
+
+static void watch_deleted(win32_file_watch *f) {
+    // This means the file has been deleted, remove from watch.
+    u32 id = f->id;
+    event_context context = {0};
+    context.data.u32[0] = id;
+    event_fire(EVENT_CODE_WATCHED_FILE_DELETED, 0, context);
+    KINFO("File watch id %d has been removed.", id);
+    unregister_watch(id);
+}
+
 static void platform_update_watches(void) {
     if (!state_ptr || !state_ptr->watches) {
         return;
     }
 
+    f64 now = platform_get_absolute_time();
+    u32 dir_count = darray_length(state_ptr->watch_dirs);
+    for (u32 i = 0; i < dir_count; ++i) {
+        win32_watch_dir *d = state_ptr->watch_dirs[i];
+        if (d && d->reading) {
+            watch_dir_changes_read(d, now);
+        }
+    }
+    if (!state_ptr->pending_watch_count && !state_ptr->polled_watch_count) {
+        return;
+    }
+
     u32 count = darray_length(state_ptr->watches);
     for (u32 i = 0; i < count; ++i) {
         win32_file_watch *f = &state_ptr->watches[i];
-        if (f->id != INVALID_ID) {
-            WIN32_FIND_DATAA data;
-            HANDLE file_handle = FindFirstFileA(f->file_path, &data);
-            if (file_handle == INVALID_HANDLE_VALUE) {
-                // This means the file has been deleted, remove from watch.
-                event_context context = {0};
-                context.data.u32[0] = f->id;
-                event_fire(EVENT_CODE_WATCHED_FILE_DELETED, 0, context);
-                KINFO("File watch id %d has been removed.", f->id);
-                unregister_watch(f->id);
-                continue;
-            }
-            BOOL result = FindClose(file_handle);
-            if (result == 0) {
+        if (f->id == INVALID_ID) {
+            continue;
+        }
+
+        if (f->dir) {
+            // Watched through its directory. Only report changes once the file has settled, so a save made up of
+            // several writes or a write-and-rename is reported once, after it is complete.
+            if (f->pending == FILE_WATCH_PENDING_NONE || now - f->pending_time < FILE_WATCH_DEBOUNCE_SECONDS) {
                 continue;
             }
+            f->pending = FILE_WATCH_PENDING_NONE;
+            state_ptr->pending_watch_count--;
+        }
 
-            // Check the file time to see if it has been changed and update/notify if so.
-            if (CompareFileTime(&data.ftLastWriteTime, &f->last_write_time) != 0) {
-                f->last_write_time = data.ftLastWriteTime;
-                // Notify listeners.
-                event_context context = {0};
-                context.data.u32[0] = f->id;
-                event_fire(EVENT_CODE_WATCHED_FILE_WRITTEN, 0, context);
-            }
+        // Polled watches are checked every update, and settled changes are confirmed against the file itself.
+        // A file deleted and recreated in the meantime is reported as written.
+        WIN32_FIND_DATAA data;
+        HANDLE file_handle = FindFirstFileA(f->file_path, &data);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            watch_deleted(f);
+            continue;
+        }
+        BOOL result = FindClose(file_handle);
+        if (result == 0) {
+            continue;
+        }
+
+        // Check the file time to see if it has been changed and update/notify if so.
+        if (CompareFileTime(&data.ftLastWriteTime, &f->last_write_time) != 0) {
+            f->last_write_time = data.ftLastWriteTime;
+            // Notify listeners.
+            event_context context = {0};
+            context.data.u32[0] = f->id;
+            event_fire(EVENT_CODE_WATCHED_FILE_WRITTEN, 0, context);
         }
     }
 }
 
 LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARAM l_param) {
+    // Windows other than the main one are handed over on creation, and kept with the window.
+    if (msg == WM_NCCREATE) {
+        CREATESTRUCTA *create_struct = (CREATESTRUCTA *)l_param;
+        SetWindowLongPtrA(hwnd, GWLP_USERDATA, (LONG_PTR)create_struct->lpCreateParams);
+    }
+    platform_window *window = (platform_window *)GetWindowLongPtrA(hwnd, GWLP_USERDATA);
+
     switch (msg) {
         case WM_ERASEBKGND:
             // Notify the OS that erasing will be handled by the application to prevent flicker.
             return 1;
         case WM_CLOSE:
+            // Closing any other window is up to the application.
+            if (window) {
+                event_context close_context = {0};
+                event_post(EVENT_CODE_WINDOW_CLOSE_REQUESTED, window, close_context);
+                return 0;
+            }
             // TODO: Fire an event for the application to quit.
             event_context data = {};
             event_fire(EVENT_CODE_APPLICATION_QUIT, 0, data);
             return 0;
         case WM_DESTROY:
-            PostQuitMessage(0);
+            if (!window) {
+                PostQuitMessage(0);
+            }
             return 0;
         case WM_DPICHANGED:
             // x- and y-axis DPI are always the same, so just grab one.
@@ -648,6 +1814,17 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
             u32 width = r.right - r.left;
             u32 height = r.bottom - r.top;
 
+            if (window) {
+                // Minimizing other windows reports a size of 0, which their swapchains skip.
+                window->width = width;
+                window->height = height;
+                event_context resize_context;
+                resize_context.data.u16[0] = (u16)width;
+                resize_context.data.u16[1] = (u16)height;
+                event_post(EVENT_CODE_WINDOW_RESIZED, window, resize_context);
+                break;
+            }
+
             {
                 HMONITOR monitor = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
 
@@ -665,7 +1842,22 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
             event_context context;
             context.data.u16[0] = (u16)width;
             context.data.u16[1] = (u16)height;
-            event_fire(EVENT_CODE_RESIZED, 0, context);
+            event_post(EVENT_CODE_RESIZED, 0, context);
+
+            // Minimizing hides the window. Anything else shows it again.
+            b8 minimized = w_param == SIZE_MINIMIZED;
+            if (state_ptr && minimized != state_ptr->minimized) {
+                state_ptr->minimized = minimized;
+                event_context visibility_context = {0};
+                visibility_context.data.u8[0] = !minimized;
+                event_post(EVENT_CODE_WINDOW_VISIBILITY_CHANGED, 0, visibility_context);
+            }
+        } break;
+        case WM_SETFOCUS:
+        case WM_KILLFOCUS: {
+            event_context context = {0};
+            context.data.u8[0] = msg == WM_SETFOCUS;
+            event_post(EVENT_CODE_WINDOW_FOCUS_CHANGED, window, context);
         } break;
         case WM_KEYDOWN:
         case WM_SYSKEYDOWN:
@@ -704,6 +1896,17 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
             // Pass over to the input subsystem.
             input_process_mouse_move(x_position, y_position);
         } break;
+        case WM_INPUT: {
+            RAWINPUT raw;
+            UINT size = sizeof(RAWINPUT);
+            if (GetRawInputData((HRAWINPUT)l_param, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) != (UINT)-1 &&
+                raw.header.dwType == RIM_TYPEMOUSE && !(raw.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)) {
+                if (raw.data.mouse.lLastX || raw.data.mouse.lLastY) {
+                    input_process_mouse_raw_move((f32)raw.data.mouse.lLastX, (f32)raw.data.mouse.lLastY);
+                }
+            }
+            // Passed on, so that the system cleans up after the message.
+        } break;
         case WM_MOUSEWHEEL: {
             i32 z_delta = GET_WHEEL_DELTA_WPARAM(w_param);
             if (z_delta != 0) {
@@ -745,4 +1948,117 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
     return DefWindowProcA(hwnd, msg, w_param, l_param);
 }
 
+static b8 winsock_startup(void) {
+    if (!winsock_started) {
+        WSADATA data;
+        i32 result = WSAStartup(MAKEWORD(2, 2), &data);
+        if (result != 0) {
+            KERROR("Unable to start Winsock. Error: %i", result);
+            return false;
+        }
+        winsock_started = true;
+    }
+    return true;
+}
+
+b8 platform_address_parse(const char *host, u16 port, platform_address *out_address) {
+    if (!host || !out_address || !winsock_startup()) {
+        return false;
+    }
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *info = 0;
+    i32 result = getaddrinfo(host, 0, &hints, &info);
+    if (result != 0 || !info) {
+        KERROR("Unable to resolve address '%s'. Error: %i", host, result);
+        return false;
+    }
+    out_address->ip = ntohl(((struct sockaddr_in *)info->ai_addr)->sin_addr.s_addr);
+    out_address->port = port;
+    freeaddrinfo(info);
+    return true;
+}
+
+b8 platform_udp_socket_open(u16 port, platform_socket *out_socket) {
+    if (!out_socket) {
+        return false;
+    }
+    kzero_memory(out_socket, sizeof(platform_socket));
+    if (!winsock_startup()) {
+        return false;
+    }
+
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        KERROR("Unable to create socket. Error: %i", WSAGetLastError());
+        return false;
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(s, (struct sockaddr *)&address, sizeof(address)) == SOCKET_ERROR) {
+        KERROR("Unable to bind socket to port %hu. Error: %i", port, WSAGetLastError());
+        closesocket(s);
+        return false;
+    }
+
+    u_long non_blocking = 1;
+    if (ioctlsocket(s, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+        KERROR("Unable to make socket non-blocking. Error: %i", WSAGetLastError());
+        closesocket(s);
+        return false;
+    }
+
+    out_socket->handle = (u64)s;
+    out_socket->is_open = true;
+    return true;
+}
+
+void platform_udp_socket_close(platform_socket *socket) {
+    if (socket && socket->is_open) {
+        closesocket((SOCKET)socket->handle);
+        socket->is_open = false;
+    }
+}
+
+b8 platform_udp_socket_send(const platform_socket *socket, const platform_address *to, const void *data, u32 size) {
+    if (!socket || !socket->is_open || !to || !data) {
+        return false;
+    }
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(to->ip);
+    address.sin_port = htons(to->port);
+    i32 sent = sendto((SOCKET)socket->handle, (const char *)data, (i32)size, 0, (struct sockaddr *)&address, sizeof(address));
+    return sent == (i32)size;
+}
+
+i32 platform_udp_socket_receive(const platform_socket *socket, platform_address *out_from, void *buffer, u32 capacity) {
+    if (!socket || !socket->is_open || !out_from || !buffer) {
+        return -1;
+    }
+    struct sockaddr_in address = {0};
+    i32 address_length = sizeof(address);
+    i32 received = recvfrom((SOCKET)socket->handle, (char *)buffer, (i32)capacity, 0, (struct sockaddr *)&address, &address_length);
+    if (received == SOCKET_ERROR) {
+        i32 error = WSAGetLastError();
+        // A reset is the ICMP response to an earlier send to a closed port, and a datagram
+        // larger than the buffer has still been received, truncated.
+        if (error == WSAEWOULDBLOCK || error == WSAECONNRESET) {
+            return 0;
+        }
+        if (error != WSAEMSGSIZE) {
+            KERROR("Unable to receive from socket. Error: %i", error);
+            return -1;
+        }
+        received = (i32)capacity;
+    }
+    out_from->ip = ntohl(address.sin_addr.s_addr);
+    out_from->port = ntohs(address.sin_port);
+    return received;
+}
+
 #endif  // KPLATFORM_WINDOWS
@@ -0,0 +1,230 @@
+#include "debug_draw.h"
+
+#include "containers/darray.h"
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "renderer/renderer_frontend.h"
+
+b8 debug_draw_batch_create(const char* name, u32 max_vertex_count, debug_draw_batch* out_batch) {
+    if (!out_batch || !max_vertex_count) {
+        KERROR("debug_draw_batch_create requires a valid pointer to a batch and a nonzero vertex count.");
+        return false;
+    }
+
+    kzero_memory(out_batch, sizeof(debug_draw_batch));
+    out_batch->max_vertex_count = max_vertex_count;
+    out_batch->vertices = darray_reserve(colour_vertex_3d, max_vertex_count);
+
+    // One region per render target, so the vertices of a frame still in flight are never overwritten.
+    out_batch->region_count = renderer_window_attachment_count_get();
+    u64 buffer_size = sizeof(colour_vertex_3d) * max_vertex_count * out_batch->region_count;
+    if (!renderer_renderbuffer_create(name, RENDERBUFFER_TYPE_DYNAMIC_VERTEX, buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &out_batch->buffer)) {
+        KERROR("Failed to create debug draw vertex buffer.");
+        darray_destroy(out_batch->vertices);
+        out_batch->vertices = 0;
+        return false;
+    }
+    renderer_renderbuffer_bind(&out_batch->buffer, 0);
+
+    return true;
+}
+
+void debug_draw_batch_destroy(debug_draw_batch* batch) {
+    if (batch) {
+        if (batch->vertices) {
+            renderer_renderbuffer_unbind(&batch->buffer);
+            renderer_renderbuffer_destroy(&batch->buffer);
+            darray_destroy(batch->vertices);
+        }
+        kzero_memory(batch, sizeof(debug_draw_batch));
+    }
+}
+
+void debug_draw_batch_clear(debug_draw_batch* batch) {
+    if (batch && batch->vertices) {
+        darray_clear(batch->vertices);
+        batch->overflowed = false;
+    }
+}
+
+// Reserves room for the given number of vertices, returning where they go. 0 if they don't fit.
+static colour_vertex_3d* vertices_push(debug_draw_batch* batch, u32 count) {
+    if (!batch || !batch->vertices) {
+        return 0;
+    }
+    u32 length = darray_length(batch->vertices);
+    if (length + count > batch->max_vertex_count) {
+        batch->overflowed = true;
+        return 0;
+    }
+    darray_length_set(batch->vertices, length + count);
+    return &batch->vertices[length];
+}
+
+static void vertex_set(colour_vertex_3d* v, vec3 position, vec4 colour) {
+    v->position = (vec4){position.x, position.y, position.z, 1.0f};
+    v->colour = colour;
+}
+
+void debug_draw_line(debug_draw_batch* batch, vec3 point_0, vec3 point_1, vec4 colour) {
+    colour_vertex_3d* v = vertices_push(batch, 2);
+    if (v) {
+        vertex_set(&v[0], point_0, colour);
+        vertex_set(&v[1], point_1, colour);
+    }
+}
+
+void debug_draw_box(debug_draw_batch* batch, extents_3d extents, mat4 model, vec4 colour) {
+    // Corners are indexed by bit: x max = 1, y max = 2, z max = 4.
+    vec3 corners[8];
+    for (u32 i = 0; i < 8; ++i) {
+        vec3 corner = {
+            (i & 1) ? extents.max.x : extents.min.x,
+            (i & 2) ? extents.max.y : extents.min.y,
+            (i & 4) ? extents.max.z : extents.min.z};
+        corners[i] = vec3_transform(corner, 1.0f, model);
+    }
+
+    // Each edge joins two corners differing by a single bit.
+    static const u8 edges[12][2] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},  // Along x.
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},  // Along y.
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}   // Along z.
+    };
+    colour_vertex_3d* v = vertices_push(batch, 24);
+    if (v) {
+        for (u32 i = 0; i < 12; ++i) {
+            vertex_set(&v[i * 2 + 0], corners[edges[i][0]], colour);
+            vertex_set(&v[i * 2 + 1], corners[edges[i][1]], colour);
+        }
+    }
+}
+
+void debug_draw_grid(debug_draw_batch* batch, debug_grid_orientation orientation, u32 tile_count_dim_0, u32 tile_count_dim_1, f32 tile_scale, b8 use_third_axis) {
+    u32 element_index_0, element_index_1, element_index_2;
+    switch (orientation) {
+        default:
+        case DEBUG_GRID_ORIENTATION_XZ:
+            element_index_0 = 0;  // x
+            element_index_1 = 2;  // z
+            element_index_2 = 1;  // y
+            break;
+        case DEBUG_GRID_ORIENTATION_XY:
+            element_index_0 = 0;  // x
+            element_index_1 = 1;  // y
+            element_index_2 = 2;  // z
+            break;
+        case DEBUG_GRID_ORIENTATION_YZ:
+            element_index_0 = 1;  // y
+            element_index_1 = 2;  // z
+            element_index_2 = 0;  // x
+            break;
+    }
+
+    // Both axes, the optional third, and a line either side of each axis per tile.
+    u32 axis_count = use_third_axis ? 3 : 2;
+    u32 vertex_count = (axis_count * 2) + (tile_count_dim_0 * 4) + (tile_count_dim_1 * 4);
+    colour_vertex_3d* v = vertices_push(batch, vertex_count);
+    if (!v) {
+        return;
+    }
+    kzero_memory(v, sizeof(colour_vertex_3d) * vertex_count);
+
+    // Grid line lengths are the amount of spaces in the opposite direction.
+    f32 line_length_0 = tile_count_dim_1 * tile_scale;
+    f32 line_length_1 = tile_count_dim_0 * tile_scale;
+    f32 line_length_2 = KMAX(line_length_0, line_length_1);
+
+    // Axis lines, coloured by the axis they lie along.
+    u32 axis_elements[3] = {element_index_0, element_index_1, element_index_2};
+    f32 axis_lengths[3] = {line_length_1, line_length_0, line_length_2};
+    for (u32 a = 0; a < axis_count; ++a) {
+        colour_vertex_3d* line = &v[a * 2];
+        line[0].position.elements[axis_elements[a]] = -axis_lengths[a];
+        line[1].position.elements[axis_elements[a]] = axis_lengths[a];
+        line[0].colour.elements[axis_elements[a]] = 1.0f;
+        line[1].colour.elements[axis_elements[a]] = 1.0f;
+        line[0].position.w = line[1].position.w = 1.0f;
+        line[0].colour.a = line[1].colour.a = 1.0f;
+    }
+
+    vec4 alt_line_colour = (vec4){1.0f, 1.0f, 1.0f, 0.5f};
+    colour_vertex_3d* line = &v[axis_count * 2];
+
+    // Lines across the first dimension, either side of the second axis.
+    for (u32 j = 1; j <= tile_count_dim_0; ++j) {
+        for (i32 side = -1; side <= 1; side += 2) {
+            line[0].position.elements[element_index_0] = side * (f32)j * tile_scale;
+            line[0].position.elements[element_index_1] = line_length_0;
+            line[1].position.elements[element_index_0] = side * (f32)j * tile_scale;
+            line[1].position.elements[element_index_1] = -line_length_0;
+            line[0].position.w = line[1].position.w = 1.0f;
+            line[0].colour = line[1].colour = alt_line_colour;
+            line += 2;
+        }
+    }
+
+    // Lines across the second dimension, either side of the first axis.
+    for (u32 j = 1; j <= tile_count_dim_1; ++j) {
+        for (i32 side = -1; side <= 1; side += 2) {
+            line[0].position.elements[element_index_0] = -line_length_1;
+            line[0].position.elements[element_index_1] = side * (f32)j * tile_scale;
+            line[1].position.elements[element_index_0] = line_length_1;
+            line[1].position.elements[element_index_1] = side * (f32)j * tile_scale;
+            line[0].position.w = line[1].position.w = 1.0f;
+            line[0].colour = line[1].colour = alt_line_colour;
+            line += 2;
+        }
+    }
+}
+
+void debug_draw_vertices(debug_draw_batch* batch, u32 vertex_count, const colour_vertex_3d* vertices, mat4 model) {
+    if (!vertices || !vertex_count) {
+        return;
+    }
+    colour_vertex_3d* v = vertices_push(batch, vertex_count);
+    if (v) {
+        for (u32 i = 0; i < vertex_count; ++i) {
+            vec3 position = {vertices[i].position.x, vertices[i].position.y, vertices[i].position.z};
+            vertex_set(&v[i], vec3_transform(position, 1.0f, model), vertices[i].colour);
+        }
+    }
+}
+
+b8 debug_draw_batch_flush(debug_draw_batch* batch, const frame_data* p_frame_data, debug_draw_packet* out_packet) {
+    if (!batch || !batch->vertices || !p_frame_data || !out_packet) {
+        KERROR("debug_draw_batch_flush requires valid pointers to a created batch, frame data and a packet.");
+        return false;
+    }
+
+    kzero_memory(out_packet, sizeof(debug_draw_packet));
+    if (batch->overflowed) {
+        KWARN("Debug draw batch '%s' is full (%u vertices). Some shapes were not drawn.", batch->buffer.name, batch->max_vertex_count);
+    }
+
+    u32 vertex_count = darray_length(batch->vertices);
+    if (!vertex_count) {
+        return true;
+    }
+
+    u64 region_size = sizeof(colour_vertex_3d) * batch->max_vertex_count;
+    u64 offset = region_size * (p_frame_data->render_target_index % batch->region_count);
+    if (!renderer_renderbuffer_load_range(&batch->buffer, offset, sizeof(colour_vertex_3d) * vertex_count, batch->vertices)) {
+        KERROR("Failed to load debug draw vertices.");
+        return false;
+    }
+
+    out_packet->buffer = &batch->buffer;
+    out_packet->offset = offset;
+    out_packet->vertex_count = vertex_count;
+    return true;
+}
+
+b8 debug_draw_packet_draw(const debug_draw_packet* packet) {
+    if (!packet || !packet->buffer || !packet->vertex_count) {
+        return true;
+    }
+    return renderer_renderbuffer_draw(packet->buffer, packet->offset, packet->vertex_count, false);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file debug_draw.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Immediate-mode debug drawing of lines, boxes and grids.
+ * @details Shapes are appended to a batch each frame as world-space line vertices. Once the frame's
+ * shapes are in, the batch is flushed into its host-visible vertex buffer, which holds one region per
+ * render target so a frame still in flight is never overwritten. This produces a packet which draws
+ * every shape at once, in a single line list draw with the colour shader and an identity model.
+ * @version 1.0
+ * @date 2023-12-04
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+#include "renderer/renderer_types.h"
+#include "resources/debug/debug_grid.h"
+
+struct frame_data;
+
+/** @brief A batch of debug lines, rebuilt each frame. */
+typedef struct debug_draw_batch {
+    /** @brief The most vertices the batch may hold in a frame. Shapes which don't fit are dropped. */
+    u32 max_vertex_count;
+    /** @brief This frame's line vertices, in world space, two per line. Darray. */
+    colour_vertex_3d* vertices;
+    /** @brief Indicates if shapes were dropped this frame for lack of space. */
+    b8 overflowed;
+    /** @brief The vertex buffer flushed into, holding one region of max_vertex_count vertices per render target. */
+    renderbuffer buffer;
+    /** @brief The number of regions in the buffer. */
+    u8 region_count;
+} debug_draw_batch;
+
+/** @brief Everything needed to draw a frame's flushed batch. Safe to keep once the batch moves on to the next frame. */
+typedef struct debug_draw_packet {
+    /** @brief The buffer holding the vertices. 0 if there is nothing to draw. */
+    renderbuffer* buffer;
+    /** @brief The offset of the frame's vertices within the buffer, in bytes. */
+    u64 offset;
+    /** @brief The number of vertices to draw. */
+    u32 vertex_count;
+} debug_draw_packet;
+
+/**
+ * @brief Creates a debug draw batch and its vertex buffer. Requires the renderer to be initialized.
+ *
+ * @param name The name of the batch's buffer.
+ * @param max_vertex_count The most vertices the batch may hold in a frame (two per line).
+ * @param out_batch A pointer to hold the created batch.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 debug_draw_batch_create(const char* name, u32 max_vertex_count, debug_draw_batch* out_batch);
+
+/**
+ * @brief Destroys the given batch, releasing its vertex buffer.
+ *
+ * @param batch A pointer to the batch to be destroyed.
+ */
+KAPI void debug_draw_batch_destroy(debug_draw_batch* batch);
+
+/**
+ * @brief Removes every shape from the batch. Called at the start of each frame, before shapes are added.
+ *
+ * @param batch A pointer to the batch.
+ */
+KAPI void debug_draw_batch_clear(debug_draw_batch* batch);
+
+/**
+ * @brief Adds a line to the batch.
+ *
+ * @param batch A pointer to the batch.
+ * @param point_0 The start of the line, in world space.
+ * @param point_1 The end of the line, in world space.
+ * @param colour The colour of the line.
+ */
+KAPI void debug_draw_line(debug_draw_batch* batch, vec3 point_0, vec3 point_1, vec4 colour);
+
+/**
+ * @brief Adds the 12 edges of a box to the batch.
+ *
+ * @param batch A pointer to the batch.
+ * @param extents The extents of the box, in the space of the model matrix.
+ * @param model The transform placing the box in world space.
+ * @param colour The colour of the box.
+ */
+KAPI void debug_draw_box(debug_draw_batch* batch, extents_3d extents, mat4 model, vec4 colour);
+
+/**
+ * @brief Adds a grid centred on the origin to the batch, laid out like a debug_grid: its axes are
+ * coloured by the axis they lie along, and the rest of its lines are translucent white.
+ *
+ * @param batch A pointer to the batch.
+ * @param orientation The plane the grid lies on.
+ * @param tile_count_dim_0 The number of tiles in the first dimension, in each direction from the origin.
+ * @param tile_count_dim_1 The number of tiles in the second dimension, in each direction from the origin.
+ * @param tile_scale The size of each tile.
+ * @param use_third_axis Indicates if a line is drawn along the axis orthogonal to the grid.
+ */
+KAPI void debug_draw_grid(debug_draw_batch* batch, debug_grid_orientation orientation, u32 tile_count_dim_0, u32 tile_count_dim_1, f32 tile_scale, b8 use_third_axis);
+
+/**
+ * @brief Adds a line list to the batch, such as the vertices of an existing debug shape.
+ *
+ * @param batch A pointer to the batch.
+ * @param vertex_count The number of vertices, two per line.
+ * @param vertices The vertices, in the space of the model matrix.
+ * @param model The transform placing the vertices in world space.
+ */
+KAPI void debug_draw_vertices(debug_draw_batch* batch, u32 vertex_count, const colour_vertex_3d* vertices, mat4 model);
+
+/**
+ * @brief Copies the frame's shapes into the region of the batch's buffer belonging to the frame's
+ * render target. Must be called after renderer_frame_prepare, once every shape has been added.
+ *
+ * @param batch A pointer to the batch.
+ * @param p_frame_data A constant pointer to the current frame's data.
+ * @param out_packet A pointer to hold the packet drawing the shapes. Has nothing to draw if the batch is empty.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 debug_draw_batch_flush(debug_draw_batch* batch, const struct frame_data* p_frame_data, debug_draw_packet* out_packet);
+
+/**
+ * @brief Draws the shapes of a flushed batch in a single draw. The colour shader must be in use with
+ * its globals applied, and an identity model matrix set.
+ *
+ * @param packet A constant pointer to the packet to be drawn.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 debug_draw_packet_draw(const debug_draw_packet* packet);
@@ -0,0 +1,88 @@
+#include "dynamic_resolution.h"
+
+#include "core/kmemory.h"
+#include "math/kmath.h"
+
+// The weight of each new frame time in the smoothed time.
+#define SMOOTHING 0.1
+// The scale only rises once frames take less than this fraction of the target.
+#define RAISE_THRESHOLD 0.85
+// Rising aims for this fraction of the target, to leave some headroom.
+#define RAISE_HEADROOM 0.9
+// The frames waited after dropping or raising the scale before it may change again.
+#define DROP_COOLDOWN_FRAMES 4
+#define RAISE_COOLDOWN_FRAMES 30
+
+static f32 snap_to_step(const dynamic_resolution* controller, f32 scale) {
+    f32 step = controller->config.step;
+    // Snapped down, with a little leeway so values just under a step are not dropped a whole one.
+    scale = kfloor(scale / step + 0.001f) * step;
+    return KCLAMP(scale, controller->config.min_scale, controller->config.max_scale);
+}
+
+void dynamic_resolution_create(const dynamic_resolution_config* config, dynamic_resolution* out_controller) {
+    kzero_memory(out_controller, sizeof(dynamic_resolution));
+    if (config) {
+        out_controller->config = *config;
+    }
+    dynamic_resolution_config* c = &out_controller->config;
+    c->target_frame_ms = c->target_frame_ms > 0.0f ? c->target_frame_ms : 16.6f;
+    c->max_scale = c->max_scale > 0.0f ? KMIN(c->max_scale, 1.0f) : 1.0f;
+    c->min_scale = c->min_scale > 0.0f ? KMIN(c->min_scale, c->max_scale) : KMIN(0.5f, c->max_scale);
+    c->step = c->step > 0.0f ? c->step : 0.05f;
+
+    out_controller->scale = c->max_scale;
+    out_controller->enabled = true;
+}
+
+f32 dynamic_resolution_update(dynamic_resolution* controller, f64 gpu_frame_ms) {
+    if (!controller->enabled || gpu_frame_ms <= 0.0) {
+        return controller->scale;
+    }
+
+    if (controller->smoothed_ms <= 0.0) {
+        controller->smoothed_ms = gpu_frame_ms;
+    } else {
+        controller->smoothed_ms += (gpu_frame_ms - controller->smoothed_ms) * SMOOTHING;
+    }
+
+    if (controller->cooldown) {
+        controller->cooldown--;
+        return controller->scale;
+    }
+
+    f64 target = controller->config.target_frame_ms;
+    f32 scale = controller->scale;
+    f32 new_scale = scale;
+    u32 cooldown = 0;
+    if (controller->smoothed_ms > target) {
+        // Over budget, so drop straight to the scale expected to meet it.
+        new_scale = snap_to_step(controller, scale * (f32)ksqrt(target / controller->smoothed_ms));
+        cooldown = DROP_COOLDOWN_FRAMES;
+    } else if (controller->smoothed_ms < target * RAISE_THRESHOLD) {
+        // Well within budget, so rise towards the scale expected to just fit, a step at a time.
+        f32 desired = scale * (f32)ksqrt((target * RAISE_HEADROOM) / controller->smoothed_ms);
+        new_scale = snap_to_step(controller, KMIN(desired, scale + controller->config.step));
+        cooldown = RAISE_COOLDOWN_FRAMES;
+    }
+
+    if (new_scale != scale) {
+        // Frames still in flight were rendered at the old scale, so the smoothed time is moved to
+        // what it is expected to be at the new one, rather than reacting to them again.
+        f64 ratio = (f64)new_scale / (f64)scale;
+        controller->smoothed_ms *= ratio * ratio;
+        controller->scale = new_scale;
+        controller->cooldown = cooldown;
+    }
+
+    return controller->scale;
+}
+
+void dynamic_resolution_enabled_set(dynamic_resolution* controller, b8 enabled) {
+    controller->enabled = enabled;
+    if (!enabled) {
+        controller->scale = controller->config.max_scale;
+        controller->smoothed_ms = 0.0;
+        controller->cooldown = 0;
+    }
+}
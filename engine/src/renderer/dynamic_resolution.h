@@ -0,0 +1,72 @@
+/**
+ * @file dynamic_resolution.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains a controller which picks the scale the scene is rendered at, so that
+ * the GPU time of a frame stays within a target.
+ * @details Each frame is fed the GPU time of the most recently completed frame, which is smoothed
+ * to ride out single-frame spikes. As the cost of most passes follows the number of pixels, the
+ * scale is moved by the square root of the ratio of the target to the smoothed time. It drops as
+ * soon as frames run over the target, but only rises once they are comfortably within it, and
+ * never changes twice within a few frames, so it settles rather than oscillating. Scales are
+ * snapped to steps so small changes of the time do not move it at every frame.
+ * @version 1.0
+ * @date 2023-12-14
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief The configuration of a dynamic resolution controller. */
+typedef struct dynamic_resolution_config {
+    /** @brief The GPU time of a frame to aim for, in milliseconds. 0 defaults to 16.6. */
+    f32 target_frame_ms;
+    /** @brief The lowest scale of each dimension. 0 defaults to 0.5. */
+    f32 min_scale;
+    /** @brief The highest scale of each dimension. 0 defaults to 1.0. */
+    f32 max_scale;
+    /** @brief The steps scales are snapped to. 0 defaults to 0.05. */
+    f32 step;
+} dynamic_resolution_config;
+
+/** @brief The state of a dynamic resolution controller. */
+typedef struct dynamic_resolution {
+    dynamic_resolution_config config;
+    /** @brief The smoothed GPU time of a frame in milliseconds. 0 until the first is fed in. */
+    f64 smoothed_ms;
+    /** @brief The current scale of each dimension. */
+    f32 scale;
+    /** @brief The number of frames left before the scale may change again. */
+    u32 cooldown;
+    /** @brief Indicates if the scale is adjusted. If not, it is held at the highest scale. */
+    b8 enabled;
+} dynamic_resolution;
+
+/**
+ * @brief Creates a dynamic resolution controller, starting at the highest scale.
+ *
+ * @param config A constant pointer to the configuration. Optional; defaults are used if 0.
+ * @param out_controller A pointer to hold the controller.
+ */
+KAPI void dynamic_resolution_create(const dynamic_resolution_config* config, dynamic_resolution* out_controller);
+
+/**
+ * @brief Feeds in the GPU time of the most recently completed frame, and obtains the scale to
+ * render the next at.
+ *
+ * @param controller A pointer to the controller.
+ * @param gpu_frame_ms The GPU time of the frame in milliseconds. 0 if unknown, which leaves the scale as it is.
+ * @return The scale of each dimension to render at.
+ */
+KAPI f32 dynamic_resolution_update(dynamic_resolution* controller, f64 gpu_frame_ms);
+
+/**
+ * @brief Enables or disables adjustment of the scale. Once disabled, the highest scale is used.
+ *
+ * @param controller A pointer to the controller.
+ * @param enabled Indicates if the scale should be adjusted.
+ */
+KAPI void dynamic_resolution_enabled_set(dynamic_resolution* controller, b8 enabled);
@@ -0,0 +1,492 @@
+#include "ibl.h"
+
+#include <stddef.h>
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "platform/filesystem.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/renderer_utils.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+#include "systems/texture_system.h"
+
+#define CONVOLVE_SHADER_NAME "Shader.IBLConvolve"
+#define BRDF_SHADER_NAME "Shader.IBLBrdf"
+// Shared by all environments, as it only depends on the BRDF.
+#define BRDF_LUT_NAME "ibl_brdf_lut"
+// Must match local_size_x/y of both compute shaders.
+#define GROUP_SIZE 8
+// The bytes per texel of storage textures, which are always RGBA8.
+#define TEXEL_SIZE 4
+
+typedef enum ibl_convolve_mode {
+    IBL_CONVOLVE_MODE_IRRADIANCE = 0,
+    IBL_CONVOLVE_MODE_SPECULAR = 1
+} ibl_convolve_mode;
+
+// NOTE: Must match the push constants of Shader.IBLConvolve.
+typedef struct ibl_convolve_block {
+    u32 mode;
+    u32 size;
+    u32 sample_count;
+    u32 environment_size;
+    f32 roughness;
+} ibl_convolve_block;
+
+// NOTE: Must match the push constants of Shader.IBLBrdf.
+typedef struct ibl_brdf_block {
+    u32 size;
+    u32 sample_count;
+} ibl_brdf_block;
+
+// +X,-X,+Y,-Y,+Z,-Z, matching the names the texture system loads cube faces from.
+static const char* face_suffixes[6] = {"r", "l", "u", "d", "f", "b"};
+
+// Shaders can't be destroyed, so are created once and shared by all environments.
+static struct shader* convolve_shader = 0;
+static struct shader* brdf_shader = 0;
+
+static struct shader* compute_shader_get(const char* name, struct shader** cached) {
+    if (*cached) {
+        return *cached;
+    }
+
+    resource config_resource;
+    if (!resource_system_load(name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", name);
+        return 0;
+    }
+    // Compute shaders aren't used within a renderpass.
+    b8 created = shader_system_create(0, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!created) {
+        KERROR("Failed to create shader '%s'.", name);
+        return 0;
+    }
+    *cached = shader_system_get(name);
+    return *cached;
+}
+
+static void kbt_path_get(const char* image_base_path, const char* name, char* out_path) {
+    string_format(out_path, "%s/%s.kbt", image_base_path, name);
+}
+
+// Indicates if every face of the named cube is cached.
+static b8 cube_cached(const char* image_base_path, const char* name) {
+    char face_name[TEXTURE_NAME_MAX_LENGTH];
+    char path[512];
+    for (u32 i = 0; i < 6; ++i) {
+        string_format(face_name, "%s_%s", name, face_suffixes[i]);
+        kbt_path_get(image_base_path, face_name, path);
+        if (!filesystem_exists(path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static b8 kbt_file_write(const char* image_base_path, const char* name, const kbt_header* header, const u8* data) {
+    char path[512];
+    kbt_path_get(image_base_path, name, path);
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Unable to open file '%s' for writing.", path);
+        return false;
+    }
+
+    resource_header file_header;
+    file_header.magic_number = RESOURCE_MAGIC;
+    file_header.resource_type = RESOURCE_TYPE_IMAGE;
+    file_header.version = KBT_FILE_VERSION;
+    file_header.reserved = 0;
+
+    u64 written = 0;
+    b8 result = filesystem_write(&f, sizeof(resource_header), &file_header, &written) &&
+                filesystem_write(&f, sizeof(kbt_header), header, &written) &&
+                filesystem_write(&f, header->data_size, data, &written);
+    filesystem_close(&f);
+    if (!result) {
+        KERROR("Error writing file '%s'.", path);
+    }
+    return result;
+}
+
+static u32 group_count_get(u32 size) {
+    return (size + GROUP_SIZE - 1) / GROUP_SIZE;
+}
+
+static u32 specular_mip_size_get(const ibl_environment* environment, u32 mip) {
+    return KMAX(environment->config.specular_size >> mip, 1);
+}
+
+static b8 shaders_acquire(ibl_environment* environment) {
+    environment->convolve_shader = compute_shader_get(CONVOLVE_SHADER_NAME, &convolve_shader);
+    environment->brdf_shader = compute_shader_get(BRDF_SHADER_NAME, &brdf_shader);
+    if (!environment->convolve_shader || !environment->brdf_shader) {
+        return false;
+    }
+
+    struct shader* s = environment->convolve_shader;
+    environment->convolve_locations.environment = shader_system_uniform_location(s, "environment");
+    environment->convolve_locations.target = shader_system_uniform_location(s, "target");
+#define BLOCK_MEMBER(member) {#member, offsetof(ibl_convolve_block, member), sizeof(((ibl_convolve_block*)0)->member)}
+    shader_local_block_member convolve_members[] = {
+        BLOCK_MEMBER(mode), BLOCK_MEMBER(size), BLOCK_MEMBER(sample_count), BLOCK_MEMBER(environment_size), BLOCK_MEMBER(roughness)};
+#undef BLOCK_MEMBER
+    if (!shader_system_local_block_verify(s, sizeof(convolve_members) / sizeof(shader_local_block_member), convolve_members, sizeof(ibl_convolve_block))) {
+        return false;
+    }
+
+    s = environment->brdf_shader;
+    environment->brdf_target_location = shader_system_uniform_location(s, "target");
+#define BLOCK_MEMBER(member) {#member, offsetof(ibl_brdf_block, member), sizeof(((ibl_brdf_block*)0)->member)}
+    shader_local_block_member brdf_members[] = {BLOCK_MEMBER(size), BLOCK_MEMBER(sample_count)};
+#undef BLOCK_MEMBER
+    return shader_system_local_block_verify(s, sizeof(brdf_members) / sizeof(shader_local_block_member), brdf_members, sizeof(ibl_brdf_block));
+}
+
+static void targets_release(ibl_environment* environment) {
+    if (environment->irradiance_target) {
+        texture_system_release(environment->irradiance_target->name);
+        environment->irradiance_target = 0;
+    }
+    for (u32 i = 0; i < IBL_SPECULAR_MIP_COUNT; ++i) {
+        if (environment->specular_targets[i]) {
+            texture_system_release(environment->specular_targets[i]->name);
+            environment->specular_targets[i] = 0;
+        }
+    }
+    if (environment->brdf_target) {
+        texture_system_release(environment->brdf_target->name);
+        environment->brdf_target = 0;
+    }
+    if (environment->environment.texture) {
+        renderer_texture_map_resources_release(&environment->environment);
+        environment->environment.texture = 0;
+    }
+}
+
+static b8 targets_acquire(ibl_environment* environment) {
+    char name[TEXTURE_NAME_MAX_LENGTH];
+    if (environment->generate_irradiance) {
+        string_format(name, "%s_target", environment->irradiance_name);
+        environment->irradiance_target = texture_system_acquire_storage(name, environment->config.irradiance_size, environment->config.irradiance_size, TEXTURE_TYPE_CUBE, 6);
+        if (!environment->irradiance_target) {
+            return false;
+        }
+    }
+    if (environment->generate_specular) {
+        for (u32 i = 0; i < IBL_SPECULAR_MIP_COUNT; ++i) {
+            u32 size = specular_mip_size_get(environment, i);
+            string_format(name, "%s_target_%u", environment->specular_name, i);
+            environment->specular_targets[i] = texture_system_acquire_storage(name, size, size, TEXTURE_TYPE_CUBE, 6);
+            if (!environment->specular_targets[i]) {
+                return false;
+            }
+        }
+    }
+    if (environment->generate_brdf_lut) {
+        environment->brdf_target = texture_system_acquire_storage(BRDF_LUT_NAME "_target", environment->config.brdf_lut_size, environment->config.brdf_lut_size, TEXTURE_TYPE_2D, 1);
+        if (!environment->brdf_target) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static b8 outputs_load(ibl_environment* environment) {
+    environment->irradiance = texture_system_acquire_cube(environment->irradiance_name, false);
+    environment->specular = texture_system_acquire_cube(environment->specular_name, false);
+    environment->brdf_lut = texture_system_acquire(BRDF_LUT_NAME, false);
+    if (!environment->irradiance || !environment->specular || !environment->brdf_lut) {
+        KERROR("Failed to load the image based lighting of '%s'.", environment->config.cubemap_name);
+        return false;
+    }
+    return true;
+}
+
+b8 ibl_environment_create(const ibl_environment_config* config, texture* cubemap, ibl_environment* out_environment) {
+    if (!config || !config->cubemap_name || !cubemap || !out_environment) {
+        KERROR("ibl_environment_create requires a configuration naming the cubemap, the cubemap and a pointer to hold the environment.");
+        return false;
+    }
+    if (cubemap->type != TEXTURE_TYPE_CUBE) {
+        KERROR("ibl_environment_create requires '%s' to be a cubemap.", cubemap->name);
+        return false;
+    }
+
+    kzero_memory(out_environment, sizeof(ibl_environment));
+    ibl_environment* environment = out_environment;
+    environment->config = *config;
+    ibl_environment_config* c = &environment->config;
+    c->irradiance_size = c->irradiance_size ? c->irradiance_size : 32;
+    c->specular_size = c->specular_size ? c->specular_size : 128;
+    c->brdf_lut_size = c->brdf_lut_size ? c->brdf_lut_size : 128;
+    c->sample_count = c->sample_count ? c->sample_count : 512;
+    string_format(environment->irradiance_name, "%s_irradiance", c->cubemap_name);
+    string_format(environment->specular_name, "%s_specular", c->cubemap_name);
+
+    const char* image_base_path = resource_system_base_path_for_type(RESOURCE_TYPE_IMAGE);
+    if (!image_base_path) {
+        KERROR("Unable to query image base path. Cannot find the image based lighting cache as a result.");
+        environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+        return false;
+    }
+    char path[512];
+    kbt_path_get(image_base_path, BRDF_LUT_NAME, path);
+    environment->generate_irradiance = !cube_cached(image_base_path, environment->irradiance_name);
+    environment->generate_specular = !cube_cached(image_base_path, environment->specular_name);
+    environment->generate_brdf_lut = !filesystem_exists(path);
+    string_free((char*)image_base_path);
+
+    if (!environment->generate_irradiance && !environment->generate_specular && !environment->generate_brdf_lut) {
+        if (!outputs_load(environment)) {
+            ibl_environment_destroy(environment);
+            environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+            return false;
+        }
+        environment->state = IBL_ENVIRONMENT_STATE_READY;
+        return true;
+    }
+
+    KINFO("Generating image based lighting for '%s'.", c->cubemap_name);
+    environment->state = IBL_ENVIRONMENT_STATE_GENERATING;
+    environment->step_frame_number = INVALID_ID_U64;
+
+    // Sampled with trilinear filtering, so samples covering more of the environment read coarser mip levels.
+    environment->environment.texture = cubemap;
+    environment->environment.filter_magnify = environment->environment.filter_minify = TEXTURE_FILTER_MODE_LINEAR;
+    environment->environment.repeat_u = environment->environment.repeat_v = environment->environment.repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+    if (!renderer_texture_map_resources_acquire(&environment->environment)) {
+        KERROR("Unable to acquire resources for the environment map of '%s'.", c->cubemap_name);
+        environment->environment.texture = 0;
+        environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+        return false;
+    }
+
+    if (!shaders_acquire(environment) || !targets_acquire(environment)) {
+        KERROR("Unable to prepare generation of the image based lighting of '%s'.", c->cubemap_name);
+        targets_release(environment);
+        environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+        return false;
+    }
+
+    return true;
+}
+
+static void convolve_dispatch(ibl_environment* environment, texture* target, ibl_convolve_mode mode, f32 roughness, frame_data* p_frame_data) {
+    shader_system_use_by_id(environment->convolve_shader->id);
+    shader_system_uniform_set_by_location(environment->convolve_locations.environment, &environment->environment);
+    shader_system_storage_image_set_by_location(environment->convolve_locations.target, target);
+    shader_system_apply_global(true, p_frame_data);
+
+    ibl_convolve_block block = {0};
+    block.mode = mode;
+    block.size = target->width;
+    block.sample_count = environment->config.sample_count;
+    block.environment_size = environment->environment.texture->width;
+    block.roughness = roughness;
+    shader_system_local_block_push(&block, sizeof(ibl_convolve_block));
+    u32 group_count = group_count_get(target->width);
+    shader_system_dispatch(group_count, group_count, 6);
+}
+
+static void brdf_dispatch(ibl_environment* environment, frame_data* p_frame_data) {
+    shader_system_use_by_id(environment->brdf_shader->id);
+    shader_system_storage_image_set_by_location(environment->brdf_target_location, environment->brdf_target);
+    shader_system_apply_global(true, p_frame_data);
+
+    ibl_brdf_block block = {0};
+    block.size = environment->brdf_target->width;
+    block.sample_count = environment->config.sample_count;
+    shader_system_local_block_push(&block, sizeof(ibl_brdf_block));
+    u32 group_count = group_count_get(block.size);
+    shader_system_dispatch(group_count, group_count, 1);
+}
+
+// Dispatches the given step, if there is anything to do for it. Returns true if anything was dispatched.
+static b8 step_dispatch(ibl_environment* environment, u32 step, frame_data* p_frame_data) {
+    b8 dispatched = false;
+    if (step == 0) {
+        if (environment->generate_irradiance) {
+            convolve_dispatch(environment, environment->irradiance_target, IBL_CONVOLVE_MODE_IRRADIANCE, 0.0f, p_frame_data);
+            dispatched = true;
+        }
+        if (environment->generate_brdf_lut) {
+            brdf_dispatch(environment, p_frame_data);
+            dispatched = true;
+        }
+    } else if (environment->generate_specular) {
+        u32 mip = step - 1;
+        f32 roughness = (f32)mip / (f32)(IBL_SPECULAR_MIP_COUNT - 1);
+        convolve_dispatch(environment, environment->specular_targets[mip], IBL_CONVOLVE_MODE_SPECULAR, roughness, p_frame_data);
+        dispatched = true;
+    }
+    return dispatched;
+}
+
+// Reads back the faces of a storage cube, one after another.
+static u8* cube_read(texture* target, u64* out_size) {
+    *out_size = (u64)target->width * target->height * TEXEL_SIZE * 6;
+    u8* pixels = kallocate(*out_size, MEMORY_TAG_ARRAY);
+    void* out_memory = pixels;
+    renderer_texture_read_data(target, 0, (u32)*out_size, &out_memory);
+    return pixels;
+}
+
+static b8 irradiance_write(ibl_environment* environment, const char* image_base_path) {
+    u64 size = 0;
+    u8* pixels = cube_read(environment->irradiance_target, &size);
+    u64 face_size = size / 6;
+
+    kbt_header header = {0};
+    header.width = environment->irradiance_target->width;
+    header.height = environment->irradiance_target->height;
+    header.mip_levels = 1;
+    header.format = TEXTURE_FORMAT_RGBA8;
+    header.channel_count = TEXEL_SIZE;
+    header.data_size = face_size;
+
+    b8 result = true;
+    char face_name[TEXTURE_NAME_MAX_LENGTH];
+    for (u32 i = 0; i < 6 && result; ++i) {
+        string_format(face_name, "%s_%s", environment->irradiance_name, face_suffixes[i]);
+        result = kbt_file_write(image_base_path, face_name, &header, pixels + face_size * i);
+    }
+    kfree(pixels, size, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+static b8 specular_write(ibl_environment* environment, const char* image_base_path) {
+    u8* levels[IBL_SPECULAR_MIP_COUNT];
+    u64 level_sizes[IBL_SPECULAR_MIP_COUNT];
+    for (u32 i = 0; i < IBL_SPECULAR_MIP_COUNT; ++i) {
+        levels[i] = cube_read(environment->specular_targets[i], &level_sizes[i]);
+    }
+
+    kbt_header header = {0};
+    header.width = environment->config.specular_size;
+    header.height = environment->config.specular_size;
+    header.mip_levels = IBL_SPECULAR_MIP_COUNT;
+    header.format = TEXTURE_FORMAT_RGBA8;
+    header.channel_count = TEXEL_SIZE;
+    header.data_size = texture_format_chain_size(TEXTURE_FORMAT_RGBA8, header.width, header.height, header.mip_levels);
+    u8* chain = kallocate(header.data_size, MEMORY_TAG_ARRAY);
+
+    // Each face holds its own chain of levels, from largest to smallest.
+    b8 result = true;
+    char face_name[TEXTURE_NAME_MAX_LENGTH];
+    for (u32 i = 0; i < 6 && result; ++i) {
+        u64 offset = 0;
+        for (u32 m = 0; m < IBL_SPECULAR_MIP_COUNT; ++m) {
+            u64 face_size = level_sizes[m] / 6;
+            kcopy_memory(chain + offset, levels[m] + face_size * i, face_size);
+            offset += face_size;
+        }
+        string_format(face_name, "%s_%s", environment->specular_name, face_suffixes[i]);
+        result = kbt_file_write(image_base_path, face_name, &header, chain);
+    }
+
+    kfree(chain, header.data_size, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < IBL_SPECULAR_MIP_COUNT; ++i) {
+        kfree(levels[i], level_sizes[i], MEMORY_TAG_ARRAY);
+    }
+    return result;
+}
+
+static b8 brdf_lut_write(ibl_environment* environment, const char* image_base_path) {
+    texture* target = environment->brdf_target;
+    u64 size = (u64)target->width * target->height * TEXEL_SIZE;
+    u8* pixels = kallocate(size, MEMORY_TAG_ARRAY);
+    void* out_memory = pixels;
+    renderer_texture_read_data(target, 0, (u32)size, &out_memory);
+
+    kbt_header header = {0};
+    header.width = target->width;
+    header.height = target->height;
+    header.mip_levels = 1;
+    header.format = TEXTURE_FORMAT_RGBA8;
+    header.channel_count = TEXEL_SIZE;
+    // Rows are already in the order they are sampled in, which is how 2D textures are flipped on load.
+    header.flags = KBT_FLAG_FLIPPED_Y;
+    header.data_size = size;
+
+    b8 result = kbt_file_write(image_base_path, BRDF_LUT_NAME, &header, pixels);
+    kfree(pixels, size, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+// Reads back whatever was generated, caches it and loads the results.
+static b8 generation_complete(ibl_environment* environment) {
+    const char* image_base_path = resource_system_base_path_for_type(RESOURCE_TYPE_IMAGE);
+    if (!image_base_path) {
+        KERROR("Unable to query image base path. Cannot cache the image based lighting as a result.");
+        return false;
+    }
+    b8 result = (!environment->generate_irradiance || irradiance_write(environment, image_base_path)) &&
+                (!environment->generate_specular || specular_write(environment, image_base_path)) &&
+                (!environment->generate_brdf_lut || brdf_lut_write(environment, image_base_path));
+    string_free((char*)image_base_path);
+
+    targets_release(environment);
+    if (!result) {
+        KERROR("Failed to cache the image based lighting of '%s'.", environment->config.cubemap_name);
+        return false;
+    }
+    return outputs_load(environment);
+}
+
+b8 ibl_environment_update(ibl_environment* environment, frame_data* p_frame_data) {
+    if (!environment || environment->state != IBL_ENVIRONMENT_STATE_GENERATING) {
+        return environment && environment->state == IBL_ENVIRONMENT_STATE_READY;
+    }
+
+    // Each shader only has one set of global bindings per frame, so each step waits for the next frame.
+    if (environment->step_frame_number == p_frame_data->renderer_frame_number) {
+        return false;
+    }
+
+    while (environment->step <= IBL_SPECULAR_MIP_COUNT) {
+        u32 step = environment->step++;
+        if (step_dispatch(environment, step, p_frame_data)) {
+            environment->step_frame_number = p_frame_data->renderer_frame_number;
+            return false;
+        }
+    }
+
+    // Every step has been dispatched in an earlier frame, which has since been submitted.
+    if (!generation_complete(environment)) {
+        ibl_environment_destroy(environment);
+        environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+        return false;
+    }
+
+    KINFO("Image based lighting for '%s' is ready.", environment->config.cubemap_name);
+    environment->state = IBL_ENVIRONMENT_STATE_READY;
+    return true;
+}
+
+void ibl_environment_destroy(ibl_environment* environment) {
+    if (!environment) {
+        return;
+    }
+
+    targets_release(environment);
+    if (environment->irradiance) {
+        texture_system_release(environment->irradiance->name);
+        environment->irradiance = 0;
+    }
+    if (environment->specular) {
+        texture_system_release(environment->specular->name);
+        environment->specular = 0;
+    }
+    if (environment->brdf_lut) {
+        texture_system_release(environment->brdf_lut->name);
+        environment->brdf_lut = 0;
+    }
+    environment->state = IBL_ENVIRONMENT_STATE_FAILED;
+}
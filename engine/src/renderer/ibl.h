@@ -0,0 +1,124 @@
+/**
+ * @file ibl.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains the image based lighting of an environment cubemap: a small cube of
+ * the diffuse irradiance from each direction, a cube of the specular reflections prefiltered at
+ * increasing roughness down its mip levels, and a lookup table of the split-sum BRDF scale and bias.
+ * @details These are generated on the GPU by compute shaders, and cached as .kbt files next to the
+ * textures of the environment so they are only generated once. The shared BRDF lookup table does not
+ * depend on the environment. Each convolution only writes one storage image per frame, as the global
+ * descriptor sets of a shader are per-frame, so generation is spread over a few frames, after which the
+ * results are read back, cached and loaded. Delete the cached files to regenerate them.
+ * @version 1.0
+ * @date 2023-12-20
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "resources/resource_types.h"
+
+struct frame_data;
+struct shader;
+
+/** @brief The number of mip levels of the specular cube, from a roughness of 0 to 1. */
+#define IBL_SPECULAR_MIP_COUNT 5
+
+/** @brief The configuration of the image based lighting of an environment. */
+typedef struct ibl_environment_config {
+    /** @brief The name of the environment cubemap, used to name the cached cubes. */
+    const char* cubemap_name;
+    /** @brief The width and height of each face of the irradiance cube. 0 defaults to 32. */
+    u32 irradiance_size;
+    /** @brief The width and height of each face of the base level of the specular cube. 0 defaults to 128. */
+    u32 specular_size;
+    /** @brief The width and height of the BRDF lookup table. 0 defaults to 128. */
+    u32 brdf_lut_size;
+    /** @brief The number of samples taken per texel when generating. 0 defaults to 512. */
+    u32 sample_count;
+} ibl_environment_config;
+
+/** @brief The state of the image based lighting of an environment. */
+typedef enum ibl_environment_state {
+    /** @brief Generation is in progress. Its textures are not yet available. */
+    IBL_ENVIRONMENT_STATE_GENERATING,
+    /** @brief The textures are loaded and ready for use. */
+    IBL_ENVIRONMENT_STATE_READY,
+    /** @brief Generation or loading failed. Its textures are not available. */
+    IBL_ENVIRONMENT_STATE_FAILED
+} ibl_environment_state;
+
+/** @brief The uniform locations of the convolution shader. */
+typedef struct ibl_convolve_locations {
+    u16 environment;
+    u16 target;
+} ibl_convolve_locations;
+
+/** @brief The image based lighting of an environment cubemap. */
+typedef struct ibl_environment {
+    ibl_environment_config config;
+    ibl_environment_state state;
+
+    /** @brief The diffuse irradiance cube. Only valid once ready. */
+    texture* irradiance;
+    /** @brief The prefiltered specular cube, with IBL_SPECULAR_MIP_COUNT mip levels. Only valid once ready. */
+    texture* specular;
+    /** @brief The BRDF lookup table. Only valid once ready. */
+    texture* brdf_lut;
+
+    /** @brief The names of the cached cubes and lookup table. */
+    char irradiance_name[TEXTURE_NAME_MAX_LENGTH];
+    char specular_name[TEXTURE_NAME_MAX_LENGTH];
+
+    // Generation state.
+    /** @brief The next generation step. Step 0 convolves the irradiance and integrates the BRDF, each following one prefilters a specular mip level. */
+    u32 step;
+    /** @brief The renderer frame number in which the last step was dispatched. */
+    u64 step_frame_number;
+    /** @brief Indicates which of the outputs are missing from the cache, and so are generated. */
+    b8 generate_irradiance;
+    b8 generate_specular;
+    b8 generate_brdf_lut;
+    /** @brief The environment cubemap being convolved. */
+    texture_map environment;
+    /** @brief The storage textures being written, released once read back. */
+    texture* irradiance_target;
+    texture* specular_targets[IBL_SPECULAR_MIP_COUNT];
+    texture* brdf_target;
+    struct shader* convolve_shader;
+    ibl_convolve_locations convolve_locations;
+    struct shader* brdf_shader;
+    u16 brdf_target_location;
+} ibl_environment;
+
+/**
+ * @brief Creates the image based lighting of the given environment cubemap. If all of it is already
+ * cached it is loaded straight away, otherwise whatever is missing is generated by following calls to
+ * ibl_environment_update.
+ *
+ * @param config A constant pointer to the configuration.
+ * @param cubemap A pointer to the environment cubemap. Must stay loaded until the environment is ready or destroyed.
+ * @param out_environment A pointer to hold the environment.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 ibl_environment_create(const ibl_environment_config* config, texture* cubemap, ibl_environment* out_environment);
+
+/**
+ * @brief Advances the generation of the environment, if it is in progress. Must be called once per
+ * frame, after the frame has begun and outside of any renderpass, as compute work is recorded.
+ *
+ * @param environment A pointer to the environment.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @return True once the environment is ready; otherwise false.
+ */
+KAPI b8 ibl_environment_update(ibl_environment* environment, struct frame_data* p_frame_data);
+
+/**
+ * @brief Destroys the environment, releasing its textures.
+ *
+ * @param environment A pointer to the environment.
+ */
+KAPI void ibl_environment_destroy(ibl_environment* environment);
@@ -0,0 +1,376 @@
+#include "light_cluster.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "renderer/renderer_frontend.h"
+#include "systems/job_system.h"
+#include "systems/light_system.h"
+
+// The grid data starts with the header, followed by the cells, followed by the light index list.
+#define GRID_CELLS_OFFSET (sizeof(light_cluster_grid_header))
+#define GRID_INDICES_OFFSET (GRID_CELLS_OFFSET + sizeof(light_cluster_cell) * LIGHT_CLUSTER_COUNT)
+
+#define INITIAL_INDEX_CAPACITY 4096
+#define INITIAL_LIGHT_CAPACITY 64
+
+// Used for lights which never fall off, so that they reach every cluster.
+#define MAX_LIGHT_RADIUS 1.0e30f
+
+// A light which reaches the view frustum, bounded in view space.
+typedef struct cluster_light {
+    // The center of the bounding sphere. z is the view depth, positive in front of the camera.
+    vec3 center;
+    f32 radius;
+    // The index of the light in the light buffer.
+    u32 index;
+    u32 first_slice;
+    u32 last_slice;
+} cluster_light;
+
+typedef struct cluster_build_context {
+    light_cluster_grid* grid;
+    const cluster_light* lights;
+    u32 light_count;
+    // Maps view space x and y over depth to normalized device coordinates: ndc = scale * (v / depth) - offset.
+    f32 scale_x;
+    f32 scale_y;
+    f32 offset_x;
+    f32 offset_y;
+    // The view depth at the start of each slice, plus the end of the last.
+    f32 slice_depths[LIGHT_CLUSTER_SLICES + 1];
+    // Whether the light index list is written, or only the cell counts.
+    b8 fill;
+} cluster_build_context;
+
+static void grid_pointers_update(light_cluster_grid* grid) {
+    grid->header = (light_cluster_grid_header*)grid->grid_data;
+    grid->cells = (light_cluster_cell*)((u8*)grid->grid_data + GRID_CELLS_OFFSET);
+    grid->indices = (u32*)((u8*)grid->grid_data + GRID_INDICES_OFFSET);
+}
+
+// Ensures the grid data can hold the given number of light indices, preserving its contents.
+static void grid_data_ensure_capacity(light_cluster_grid* grid, u32 index_count) {
+    u64 required = GRID_INDICES_OFFSET + sizeof(u32) * index_count;
+    if (required <= grid->grid_data_size) {
+        return;
+    }
+
+    u64 new_size = grid->grid_data_size ? grid->grid_data_size : required;
+    while (new_size < required) {
+        new_size *= 2;
+    }
+
+    void* new_data = kallocate(new_size, MEMORY_TAG_RENDERER);
+    if (grid->grid_data) {
+        kcopy_memory(new_data, grid->grid_data, grid->grid_data_size);
+        kfree(grid->grid_data, grid->grid_data_size, MEMORY_TAG_RENDERER);
+    }
+    grid->grid_data = new_data;
+    grid->grid_data_size = new_size;
+    grid_pointers_update(grid);
+}
+
+// Ensures the given storage buffer can hold the given number of bytes, creating or growing it as needed.
+static b8 storage_buffer_ensure_capacity(renderbuffer* buffer, u64* buffer_size, const char* name, u64 required) {
+    if (required <= *buffer_size) {
+        return true;
+    }
+
+    u64 new_size = *buffer_size ? *buffer_size : required;
+    while (new_size < required) {
+        new_size *= 2;
+    }
+
+    if (!*buffer_size) {
+        if (!renderer_renderbuffer_create(name, RENDERBUFFER_TYPE_STORAGE, new_size, RENDERBUFFER_TRACK_TYPE_NONE, buffer)) {
+            KERROR("Failed to create light cluster buffer '%s'.", name);
+            return false;
+        }
+        renderer_renderbuffer_bind(buffer, 0);
+    } else if (!renderer_renderbuffer_resize(buffer, new_size)) {
+        KERROR("Failed to resize light cluster buffer '%s'.", name);
+        return false;
+    }
+
+    *buffer_size = new_size;
+    return true;
+}
+
+f32 light_cluster_point_light_radius(const point_light_data* light) {
+    f32 brightest = KMAX(light->colour.r, KMAX(light->colour.g, light->colour.b));
+    // Attenuation is 1 / (constant + linear * d + quadratic * d^2), so solve for the
+    // distance at which the denominator reaches brightest / cutoff.
+    f32 k = brightest / LIGHT_CLUSTER_ATTENUATION_CUTOFF - light->constant_f;
+    if (brightest <= 0.0f || k <= 0.0f) {
+        return 0.0f;
+    }
+    if (light->quadratic > K_FLOAT_EPSILON) {
+        return (-light->linear + ksqrt(light->linear * light->linear + 4.0f * light->quadratic * k)) / (2.0f * light->quadratic);
+    }
+    if (light->linear > K_FLOAT_EPSILON) {
+        return k / light->linear;
+    }
+    return MAX_LIGHT_RADIUS;
+}
+
+static u32 ndc_to_tile(f32 ndc, u32 tile_count) {
+    if (ndc <= -1.0f) {
+        return 0;
+    }
+    if (ndc >= 1.0f) {
+        return tile_count - 1;
+    }
+    u32 tile = (u32)((ndc * 0.5f + 0.5f) * tile_count);
+    return KMIN(tile, tile_count - 1);
+}
+
+// Finds the range of tiles along one axis covered by [min, max] between the given depths. False if there are none.
+static b8 tile_range_get(f32 min, f32 max, f32 near_depth, f32 far_depth, f32 scale, f32 offset, u32 tile_count, u32* out_first, u32* out_last) {
+    // The extremes of v / depth over the box.
+    f32 lowest = min >= 0.0f ? min / far_depth : min / near_depth;
+    f32 highest = max >= 0.0f ? max / near_depth : max / far_depth;
+    f32 ndc_min = scale * lowest - offset;
+    f32 ndc_max = scale * highest - offset;
+    if (ndc_min > ndc_max) {
+        f32 temp = ndc_min;
+        ndc_min = ndc_max;
+        ndc_max = temp;
+    }
+    if (ndc_max < -1.0f || ndc_min > 1.0f) {
+        return false;
+    }
+
+    *out_first = ndc_to_tile(ndc_min, tile_count);
+    *out_last = ndc_to_tile(ndc_max, tile_count);
+    return true;
+}
+
+static u32 depth_to_slice(const light_cluster_grid_header* header, f32 depth) {
+    if (depth <= header->near_clip) {
+        return 0;
+    }
+    f32 slice = klog2(depth) * header->slice_scale + header->slice_bias;
+    if (slice >= (f32)(header->slices - 1)) {
+        return header->slices - 1;
+    }
+    return slice > 0.0f ? (u32)slice : 0;
+}
+
+// Counts, or fills in, the lights of each cluster within a range of slices. Each slice is only
+// touched by one batch, so batches need no synchronization.
+static void cluster_slices_process(u32 start, u32 end, void* user_data) {
+    cluster_build_context* context = user_data;
+    light_cluster_grid* grid = context->grid;
+
+    for (u32 slice = start; slice < end; ++slice) {
+        light_cluster_cell* slice_cells = grid->cells + (slice * LIGHT_CLUSTER_TILES_X * LIGHT_CLUSTER_TILES_Y);
+        for (u32 i = 0; i < LIGHT_CLUSTER_TILES_X * LIGHT_CLUSTER_TILES_Y; ++i) {
+            // When filling, the count doubles as the write cursor.
+            slice_cells[i].count = 0;
+        }
+
+        f32 slab_near = context->slice_depths[slice];
+        f32 slab_far = context->slice_depths[slice + 1];
+        for (u32 i = 0; i < context->light_count; ++i) {
+            const cluster_light* l = &context->lights[i];
+            if (slice < l->first_slice || slice > l->last_slice) {
+                continue;
+            }
+
+            // Bound the part of the light's sphere within this slice.
+            f32 near_depth = KMAX(slab_near, l->center.z - l->radius);
+            f32 far_depth = KMIN(slab_far, l->center.z + l->radius);
+            u32 first_x, last_x, first_y, last_y;
+            if (!tile_range_get(l->center.x - l->radius, l->center.x + l->radius, near_depth, far_depth, context->scale_x, context->offset_x, LIGHT_CLUSTER_TILES_X, &first_x, &last_x) ||
+                !tile_range_get(l->center.y - l->radius, l->center.y + l->radius, near_depth, far_depth, context->scale_y, context->offset_y, LIGHT_CLUSTER_TILES_Y, &first_y, &last_y)) {
+                continue;
+            }
+
+            for (u32 y = first_y; y <= last_y; ++y) {
+                for (u32 x = first_x; x <= last_x; ++x) {
+                    light_cluster_cell* cell = &slice_cells[y * LIGHT_CLUSTER_TILES_X + x];
+                    if (context->fill) {
+                        grid->indices[cell->offset + cell->count] = l->index;
+                    }
+                    cell->count++;
+                }
+            }
+        }
+    }
+}
+
+b8 light_cluster_grid_create(light_cluster_grid* out_grid) {
+    if (!out_grid) {
+        KERROR("light_cluster_grid_create requires a valid pointer to out_grid.");
+        return false;
+    }
+
+    kzero_memory(out_grid, sizeof(light_cluster_grid));
+    grid_data_ensure_capacity(out_grid, INITIAL_INDEX_CAPACITY);
+    kzero_memory(out_grid->grid_data, GRID_INDICES_OFFSET);
+    return true;
+}
+
+void light_cluster_grid_destroy(light_cluster_grid* grid) {
+    if (!grid) {
+        return;
+    }
+
+    if (grid->light_buffer_size) {
+        renderer_renderbuffer_destroy(&grid->light_buffer);
+    }
+    if (grid->grid_buffer_size) {
+        renderer_renderbuffer_destroy(&grid->grid_buffer);
+    }
+    if (grid->grid_data) {
+        kfree(grid->grid_data, grid->grid_data_size, MEMORY_TAG_RENDERER);
+    }
+    if (grid->lights) {
+        kfree(grid->lights, sizeof(point_light_data) * grid->light_capacity, MEMORY_TAG_RENDERER);
+    }
+    kzero_memory(grid, sizeof(light_cluster_grid));
+}
+
+b8 light_cluster_grid_build(light_cluster_grid* grid, u32 light_count, const point_light_data* lights, const mat4* projection, const mat4* view, struct frame_data* p_frame_data) {
+    if (!grid || !grid->grid_data || !projection || !view || !p_frame_data || (light_count && !lights)) {
+        KERROR("light_cluster_grid_build requires a valid grid, projection, view, frame data and lights.");
+        return false;
+    }
+
+    // Keep a copy of the lights for upload.
+    if (light_count > grid->light_capacity) {
+        u32 new_capacity = grid->light_capacity ? grid->light_capacity : INITIAL_LIGHT_CAPACITY;
+        while (new_capacity < light_count) {
+            new_capacity *= 2;
+        }
+        if (grid->lights) {
+            kfree(grid->lights, sizeof(point_light_data) * grid->light_capacity, MEMORY_TAG_RENDERER);
+        }
+        grid->lights = kallocate(sizeof(point_light_data) * new_capacity, MEMORY_TAG_RENDERER);
+        grid->light_capacity = new_capacity;
+    }
+    if (light_count) {
+        kcopy_memory(grid->lights, lights, sizeof(point_light_data) * light_count);
+    }
+    grid->light_count = light_count;
+
+    // Recover the clipping distances from the projection. Only perspective projections divide by depth.
+    f32 near_clip = 0.0f;
+    f32 far_clip = 0.0f;
+    b8 perspective = projection->data[11] != 0.0f && projection->data[15] == 0.0f;
+    if (perspective) {
+        f32 a = projection->data[10];
+        f32 b = projection->data[14];
+        near_clip = b / (a - 1.0f);
+        far_clip = b / (a + 1.0f);
+        perspective = near_clip > 0.0f && far_clip > near_clip;
+    }
+
+    light_cluster_grid_header* header = grid->header;
+    if (!perspective) {
+        // A single cluster holding every light.
+        grid_data_ensure_capacity(grid, light_count);
+        header = grid->header;
+        kzero_memory(header, sizeof(light_cluster_grid_header));
+        header->tiles_x = 1;
+        header->tiles_y = 1;
+        header->slices = 1;
+        header->index_start = (GRID_INDICES_OFFSET - GRID_CELLS_OFFSET) / sizeof(u32);
+        grid->cells[0].offset = 0;
+        grid->cells[0].count = light_count;
+        for (u32 i = 0; i < light_count; ++i) {
+            grid->indices[i] = i;
+        }
+        grid->index_count = light_count;
+        return true;
+    }
+
+    header->tiles_x = LIGHT_CLUSTER_TILES_X;
+    header->tiles_y = LIGHT_CLUSTER_TILES_Y;
+    header->slices = LIGHT_CLUSTER_SLICES;
+    header->index_start = (GRID_INDICES_OFFSET - GRID_CELLS_OFFSET) / sizeof(u32);
+    header->near_clip = near_clip;
+    header->far_clip = far_clip;
+    f32 log_range = klog2(far_clip / near_clip);
+    header->slice_scale = LIGHT_CLUSTER_SLICES / log_range;
+    header->slice_bias = -(LIGHT_CLUSTER_SLICES * klog2(near_clip)) / log_range;
+
+    cluster_build_context context = {0};
+    context.grid = grid;
+    context.scale_x = projection->data[0];
+    context.scale_y = projection->data[5];
+    context.offset_x = projection->data[8];
+    context.offset_y = projection->data[9];
+    for (u32 i = 0; i <= LIGHT_CLUSTER_SLICES; ++i) {
+        context.slice_depths[i] = near_clip * kpow(far_clip / near_clip, (f32)i / LIGHT_CLUSTER_SLICES);
+    }
+
+    // Bound each light in view space, skipping those which cannot reach the frustum.
+    cluster_light* culled = p_frame_data->allocator.allocate(sizeof(cluster_light) * KMAX(light_count, 1));
+    u32 culled_count = 0;
+    for (u32 i = 0; i < light_count; ++i) {
+        f32 radius = light_cluster_point_light_radius(&lights[i]);
+        if (radius <= 0.0f) {
+            continue;
+        }
+        vec3 center = vec3_transform(vec3_create(lights[i].position.x, lights[i].position.y, lights[i].position.z), 1.0f, *view);
+        // The view looks down -z.
+        center.z = -center.z;
+        if (center.z + radius < near_clip || center.z - radius > far_clip) {
+            continue;
+        }
+
+        cluster_light* l = &culled[culled_count++];
+        l->center = center;
+        l->radius = radius;
+        l->index = i;
+        l->first_slice = depth_to_slice(header, center.z - radius);
+        l->last_slice = depth_to_slice(header, center.z + radius);
+    }
+    context.lights = culled;
+    context.light_count = culled_count;
+
+    // Count the lights of each cluster, then lay the lists out back to back and fill them in.
+    job_parallel_for(LIGHT_CLUSTER_SLICES, 1, cluster_slices_process, &context);
+
+    u32 index_count = 0;
+    for (u32 i = 0; i < LIGHT_CLUSTER_COUNT; ++i) {
+        grid->cells[i].offset = index_count;
+        index_count += grid->cells[i].count;
+    }
+    grid_data_ensure_capacity(grid, index_count);
+    grid->index_count = index_count;
+
+    context.fill = true;
+    job_parallel_for(LIGHT_CLUSTER_SLICES, 1, cluster_slices_process, &context);
+    return true;
+}
+
+b8 light_cluster_grid_upload(light_cluster_grid* grid) {
+    if (!grid || !grid->grid_data) {
+        return false;
+    }
+
+    // Both buffers must always exist to be bound, even when there are no lights.
+    u32 light_count = grid->light_count;
+    if (!storage_buffer_ensure_capacity(&grid->light_buffer, &grid->light_buffer_size, "renderbuffer_light_cluster_lights", sizeof(point_light_data) * KMAX(light_count, INITIAL_LIGHT_CAPACITY))) {
+        return false;
+    }
+    if (light_count && !renderer_renderbuffer_load_range(&grid->light_buffer, 0, sizeof(point_light_data) * light_count, grid->lights)) {
+        KERROR("Failed to upload light cluster lights.");
+        return false;
+    }
+
+    u64 grid_size = GRID_INDICES_OFFSET + sizeof(u32) * grid->index_count;
+    if (!storage_buffer_ensure_capacity(&grid->grid_buffer, &grid->grid_buffer_size, "renderbuffer_light_cluster_grid", KMAX(grid_size, GRID_INDICES_OFFSET + sizeof(u32) * INITIAL_INDEX_CAPACITY))) {
+        return false;
+    }
+    if (!renderer_renderbuffer_load_range(&grid->grid_buffer, 0, grid_size, grid->grid_data)) {
+        KERROR("Failed to upload light cluster grid.");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file light_cluster.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains a clustered light grid, used to cull point lights so that shaders
+ * only evaluate the lights affecting each fragment.
+ * @details The view frustum is divided into a grid of clusters (or "froxels"): tiles across
+ * the screen, and slices along the view depth. Slices are spaced logarithmically, so that
+ * clusters stay roughly cubic with distance. Each point light is bounded by the distance at
+ * which its attenuation falls below LIGHT_CLUSTER_ATTENUATION_CUTOFF, and added to the list of
+ * every cluster that sphere overlaps. Building runs in parallel over slices using the job system.
+ *
+ * The grid is uploaded to two storage buffers. The light buffer holds an array of
+ * point_light_data. The grid buffer holds a light_cluster_grid_header, followed by one
+ * light_cluster_cell per cluster (ordered by slice, then row, then column), followed by the
+ * light index list the cells refer to. Shaders find the cluster of a fragment from its
+ * normalized device coordinates and view depth, and loop over that cell's lights.
+ * @version 1.0
+ * @date 2023-11-29
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+#include "renderer/renderer_types.h"
+
+struct frame_data;
+struct point_light_data;
+
+/** @brief The number of cluster columns across the screen. */
+#define LIGHT_CLUSTER_TILES_X 16
+/** @brief The number of cluster rows down the screen. */
+#define LIGHT_CLUSTER_TILES_Y 9
+/** @brief The number of cluster slices along the view depth. */
+#define LIGHT_CLUSTER_SLICES 24
+/** @brief The total number of clusters in a grid. */
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_TILES_X * LIGHT_CLUSTER_TILES_Y * LIGHT_CLUSTER_SLICES)
+
+/**
+ * @brief The fraction of a light's brightest colour channel below which its contribution
+ * is ignored. Lights are culled from clusters beyond the distance where this is reached.
+ */
+#define LIGHT_CLUSTER_ATTENUATION_CUTOFF (1.0f / 256.0f)
+
+/** @brief The header at the start of the grid buffer. Layout-compatible with the shaders which read it. */
+typedef struct light_cluster_grid_header {
+    /** @brief The number of cluster columns. 1 if the grid was not built for a perspective projection. */
+    u32 tiles_x;
+    /** @brief The number of cluster rows. */
+    u32 tiles_y;
+    /** @brief The number of cluster slices. */
+    u32 slices;
+    /** @brief The offset of the light index list from the first cell, in 32-bit words. */
+    u32 index_start;
+    /** @brief Scales log2(view depth) to give the slice, before slice_bias is added. */
+    f32 slice_scale;
+    /** @brief Added to the scaled log2(view depth) to give the slice. */
+    f32 slice_bias;
+    /** @brief The near clipping distance the grid was built for. */
+    f32 near_clip;
+    /** @brief The far clipping distance the grid was built for. */
+    f32 far_clip;
+} light_cluster_grid_header;
+
+/** @brief The lights of a single cluster, as a range of the light index list. */
+typedef struct light_cluster_cell {
+    /** @brief The index of the cell's first entry in the light index list. */
+    u32 offset;
+    /** @brief The number of lights affecting the cluster. */
+    u32 count;
+} light_cluster_cell;
+
+/**
+ * @brief A clustered light grid, along with the storage buffers it is uploaded to. Members of
+ * this structure should not be modified outside the functions associated with it.
+ */
+typedef struct light_cluster_grid {
+    /** @brief The grid data as uploaded to the grid buffer: the header, cells and light index list, in that order. */
+    void* grid_data;
+    /** @brief The size of the grid data block in bytes. */
+    u64 grid_data_size;
+    /** @brief The header of the grid most recently built. Points into grid_data. */
+    light_cluster_grid_header* header;
+    /** @brief The cells of the grid most recently built. Points into grid_data. */
+    light_cluster_cell* cells;
+    /** @brief The light index list of the grid most recently built. Points into grid_data. */
+    u32* indices;
+    /** @brief The number of entries in the light index list. */
+    u32 index_count;
+
+    /** @brief A copy of the lights the grid was most recently built for. */
+    struct point_light_data* lights;
+    /** @brief The number of lights the grid was most recently built for. */
+    u32 light_count;
+    /** @brief The number of lights which fit in the lights array. */
+    u32 light_capacity;
+
+    /** @brief The storage buffer holding the lights. */
+    renderbuffer light_buffer;
+    /** @brief The size of the light buffer in bytes, or 0 if it has not been created. */
+    u64 light_buffer_size;
+    /** @brief The storage buffer holding the grid data. */
+    renderbuffer grid_buffer;
+    /** @brief The size of the grid buffer in bytes, or 0 if it has not been created. */
+    u64 grid_buffer_size;
+} light_cluster_grid;
+
+/**
+ * @brief Creates a new, empty light grid. Its storage buffers are created on first upload.
+ *
+ * @param out_grid A pointer to hold the created grid.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 light_cluster_grid_create(light_cluster_grid* out_grid);
+
+/**
+ * @brief Destroys the given grid, along with its storage buffers.
+ *
+ * @param grid A pointer to the grid to be destroyed.
+ */
+KAPI void light_cluster_grid_destroy(light_cluster_grid* grid);
+
+/**
+ * @brief Culls the given lights into the clusters of the given view. Perspective projections
+ * are divided into LIGHT_CLUSTER_COUNT clusters. Any other projection gets a single cluster
+ * holding every light.
+ *
+ * @param grid A pointer to the grid.
+ * @param light_count The number of lights.
+ * @param lights An array of light_count lights, in world space. Copied by the grid.
+ * @param projection A constant pointer to the projection matrix of the view.
+ * @param view A constant pointer to the view matrix of the view.
+ * @param p_frame_data A pointer to the current frame's data, used for temporary allocations.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 light_cluster_grid_build(light_cluster_grid* grid, u32 light_count, const struct point_light_data* lights, const mat4* projection, const mat4* view, struct frame_data* p_frame_data);
+
+/**
+ * @brief Uploads the grid most recently built to its storage buffers, creating or growing them as needed.
+ *
+ * @param grid A pointer to the grid.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 light_cluster_grid_upload(light_cluster_grid* grid);
+
+/**
+ * @brief Obtains the distance from the given light at which its brightest colour channel falls
+ * below LIGHT_CLUSTER_ATTENUATION_CUTOFF, beyond which it is culled from clusters.
+ *
+ * @param light A constant pointer to the light.
+ * @return The radius of the light, or 0 if it gives no light.
+ */
+KAPI f32 light_cluster_point_light_radius(const struct point_light_data* light);
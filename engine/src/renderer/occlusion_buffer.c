@@ -0,0 +1,321 @@
+#include "occlusion_buffer.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "math/ksimd.h"
+#include "resources/resource_types.h"
+#include "systems/job_system.h"
+
+// Vertices nearer than this view depth are clipped away, keeping reciprocal depths finite.
+#define OCCLUSION_NEAR_W 0.001f
+// Triangles of less than this many square pixels hide little, so are skipped.
+#define OCCLUSION_MIN_AREA 0.5f
+// Clipping a triangle against the near plane leaves at most this many vertices.
+#define OCCLUSION_CLIP_MAX_VERTICES 4
+
+b8 occlusion_buffer_create(u32 width, u32 height, occlusion_buffer* out_buffer) {
+    if (!out_buffer || !width || !height) {
+        KERROR("occlusion_buffer_create requires a valid pointer to a buffer and a nonzero size.");
+        return false;
+    }
+
+    kzero_memory(out_buffer, sizeof(occlusion_buffer));
+    out_buffer->width = (width + 3) & ~3u;
+    out_buffer->height = height;
+    out_buffer->depth = kallocate(sizeof(f32) * out_buffer->width * out_buffer->height, MEMORY_TAG_RENDERER);
+    out_buffer->view_projection = mat4_identity();
+    out_buffer->triangles = darray_create(occlusion_triangle);
+    return true;
+}
+
+void occlusion_buffer_destroy(occlusion_buffer* buffer) {
+    if (buffer) {
+        if (buffer->depth) {
+            kfree(buffer->depth, sizeof(f32) * buffer->width * buffer->height, MEMORY_TAG_RENDERER);
+        }
+        if (buffer->triangles) {
+            darray_destroy(buffer->triangles);
+        }
+        kzero_memory(buffer, sizeof(occlusion_buffer));
+    }
+}
+
+void occlusion_buffer_begin(occlusion_buffer* buffer, mat4 view_projection) {
+    if (!buffer || !buffer->depth) {
+        return;
+    }
+    buffer->view_projection = view_projection;
+    darray_clear(buffer->triangles);
+    buffer->rasterized_triangle_count = 0;
+    kzero_memory(buffer->depth, sizeof(f32) * buffer->width * buffer->height);
+}
+
+// Sets up a triangle given in clip space, all of whose vertices are in front of the near plane.
+static void triangle_setup(occlusion_buffer* buffer, const vec4* clip_0, const vec4* clip_1, const vec4* clip_2) {
+    const vec4* clip[3] = {clip_0, clip_1, clip_2};
+    f32 x[3], y[3], z[3];
+    for (u32 i = 0; i < 3; ++i) {
+        z[i] = 1.0f / clip[i]->w;
+        x[i] = (clip[i]->x * z[i] * 0.5f + 0.5f) * buffer->width;
+        y[i] = (clip[i]->y * z[i] * 0.5f + 0.5f) * buffer->height;
+    }
+
+    // Occluders are drawn from both sides, so make every triangle's winding the same.
+    f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area < 0.0f) {
+        f32 t;
+        t = x[1], x[1] = x[2], x[2] = t;
+        t = y[1], y[1] = y[2], y[2] = t;
+        t = z[1], z[1] = z[2], z[2] = t;
+        area = -area;
+    }
+    if (area < OCCLUSION_MIN_AREA) {
+        return;
+    }
+
+    occlusion_triangle tri;
+    tri.min_x = (i32)kfloor(KMIN(x[0], KMIN(x[1], x[2])));
+    tri.min_y = (i32)kfloor(KMIN(y[0], KMIN(y[1], y[2])));
+    tri.max_x = (i32)kceil(KMAX(x[0], KMAX(x[1], x[2])));
+    tri.max_y = (i32)kceil(KMAX(y[0], KMAX(y[1], y[2])));
+    tri.min_x = KMAX(tri.min_x, 0);
+    tri.min_y = KMAX(tri.min_y, 0);
+    tri.max_x = KMIN(tri.max_x, (i32)buffer->width - 1);
+    tri.max_y = KMIN(tri.max_y, (i32)buffer->height - 1);
+    if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) {
+        return;
+    }
+
+    // Each edge function is evaluated at pixel centers. Pixels exactly on an edge are covered by
+    // the triangles either side of it, so edges shared within a mesh never leave cracks.
+    for (u32 e = 0; e < 3; ++e) {
+        u32 a = e;
+        u32 b = (e + 1) % 3;
+        f32 ea = y[a] - y[b];
+        f32 eb = x[b] - x[a];
+        f32 ec = x[a] * y[b] - y[a] * x[b];
+        tri.edges[e][0] = ea;
+        tri.edges[e][1] = eb;
+        tri.edges[e][2] = ec;
+    }
+
+    // The depth plane is pulled back by half a pixel along both axes, giving the farthest (smallest)
+    // value the triangle has within each pixel.
+    f32 dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    f32 dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    tri.depth[0] = dzdx;
+    tri.depth[1] = dzdy;
+    tri.depth[2] = z[0] - dzdx * x[0] - dzdy * y[0] - 0.5f * (kabs(dzdx) + kabs(dzdy));
+
+    darray_push(buffer->triangles, tri);
+}
+
+// Clips a clip-space triangle against the near plane, setting up what remains.
+static void triangle_clip(occlusion_buffer* buffer, const vec4* v0, const vec4* v1, const vec4* v2) {
+    if (v0->w >= OCCLUSION_NEAR_W && v1->w >= OCCLUSION_NEAR_W && v2->w >= OCCLUSION_NEAR_W) {
+        triangle_setup(buffer, v0, v1, v2);
+        return;
+    }
+
+    const vec4* in[3] = {v0, v1, v2};
+    vec4 out[OCCLUSION_CLIP_MAX_VERTICES];
+    u32 out_count = 0;
+    for (u32 i = 0; i < 3; ++i) {
+        const vec4* a = in[i];
+        const vec4* b = in[(i + 1) % 3];
+        b8 a_inside = a->w >= OCCLUSION_NEAR_W;
+        b8 b_inside = b->w >= OCCLUSION_NEAR_W;
+        if (a_inside) {
+            out[out_count++] = *a;
+        }
+        if (a_inside != b_inside) {
+            f32 t = (OCCLUSION_NEAR_W - a->w) / (b->w - a->w);
+            out[out_count++] = vec4_add(*a, vec4_mul_scalar(vec4_sub(*b, *a), t));
+        }
+    }
+
+    for (u32 i = 2; i < out_count; ++i) {
+        triangle_setup(buffer, &out[0], &out[i - 1], &out[i]);
+    }
+}
+
+b8 occlusion_buffer_occluder_add(occlusion_buffer* buffer, const geometry* g, mat4 model) {
+    if (!buffer || !buffer->depth || !g) {
+        return false;
+    }
+    if (!g->vertices || !g->indices || g->index_element_size != sizeof(u32)) {
+        return false;
+    }
+
+    // Packed positions are stored as snorm16 within the quantization box.
+    b8 packed = g->vertex_format == GEOMETRY_VERTEX_FORMAT_PACKED;
+    mat4 mvp = model;
+    if (packed) {
+        mat4 dequantization = mat4_mul(mat4_scale((vec3){g->quantization_scale, g->quantization_scale, g->quantization_scale}), mat4_translation(g->quantization_center));
+        mvp = mat4_mul(dequantization, mvp);
+    }
+    mvp = mat4_mul(mvp, buffer->view_projection);
+
+    const u8* vertices = g->vertices;
+    const u32* indices = g->indices;
+    for (u32 i = 0; i + 2 < g->index_count; i += 3) {
+        vec4 clip[3];
+        for (u32 v = 0; v < 3; ++v) {
+            u32 index = indices[i + v];
+            if (index >= g->vertex_count) {
+                return false;
+            }
+            const void* vertex = vertices + (u64)index * g->vertex_element_size;
+            vec4 position;
+            if (packed) {
+                const vertex_3d_packed* p = vertex;
+                position = (vec4){p->position[0] / 32767.0f, p->position[1] / 32767.0f, p->position[2] / 32767.0f, 1.0f};
+            } else {
+                const vertex_3d* p = vertex;
+                position = vec4_from_vec3(p->position, 1.0f);
+            }
+            clip[v] = vec4_mul_mat4(position, mvp);
+        }
+        triangle_clip(buffer, &clip[0], &clip[1], &clip[2]);
+    }
+    return true;
+}
+
+// Rasterizes a triangle into the rows [row_start, row_end).
+static void triangle_rasterize(occlusion_buffer* buffer, const occlusion_triangle* tri, i32 row_start, i32 row_end) {
+    i32 y_start = KMAX(tri->min_y, row_start);
+    i32 y_end = KMIN(tri->max_y + 1, row_end);
+    // Rows are processed four pixels at a time, so start on a multiple of four.
+    i32 x_start = tri->min_x & ~3;
+    i32 x_end = tri->max_x + 1;
+
+#if KSIMD_ENABLED
+    ksimd_f32x4 zero = ksimd_set1(0.0f);
+    ksimd_f32x4 lane_offsets = ksimd_set(0.5f, 1.5f, 2.5f, 3.5f);
+    ksimd_f32x4 edge_steps[3];
+    for (u32 e = 0; e < 3; ++e) {
+        edge_steps[e] = ksimd_set1(tri->edges[e][0] * 4.0f);
+    }
+    ksimd_f32x4 depth_step = ksimd_set1(tri->depth[0] * 4.0f);
+#endif
+
+    for (i32 y = y_start; y < y_end; ++y) {
+        f32 py = y + 0.5f;
+        f32* row = buffer->depth + (u64)y * buffer->width;
+#if KSIMD_ENABLED
+        ksimd_f32x4 x_centers = ksimd_add(ksimd_set1((f32)x_start), lane_offsets);
+        ksimd_f32x4 edges[3];
+        for (u32 e = 0; e < 3; ++e) {
+            edges[e] = ksimd_madd(ksimd_set1(tri->edges[e][0]), x_centers, ksimd_set1(tri->edges[e][1] * py + tri->edges[e][2]));
+        }
+        ksimd_f32x4 depth = ksimd_madd(ksimd_set1(tri->depth[0]), x_centers, ksimd_set1(tri->depth[1] * py + tri->depth[2]));
+        for (i32 x = x_start; x < x_end; x += 4) {
+            // Covered where every edge function is non-negative.
+            ksimd_f32x4 coverage = ksimd_min(edges[0], ksimd_min(edges[1], edges[2]));
+            ksimd_f32x4 mask = ksimd_cmpge(coverage, zero);
+            ksimd_f32x4 covered_depth = ksimd_and(ksimd_max(depth, zero), mask);
+            ksimd_store(row + x, ksimd_max(ksimd_load(row + x), covered_depth));
+
+            for (u32 e = 0; e < 3; ++e) {
+                edges[e] = ksimd_add(edges[e], edge_steps[e]);
+            }
+            depth = ksimd_add(depth, depth_step);
+        }
+#else
+        for (i32 x = x_start; x < x_end; ++x) {
+            f32 px = x + 0.5f;
+            b8 covered = true;
+            for (u32 e = 0; e < 3 && covered; ++e) {
+                covered = tri->edges[e][0] * px + tri->edges[e][1] * py + tri->edges[e][2] >= 0.0f;
+            }
+            if (covered) {
+                f32 depth = KMAX(tri->depth[0] * px + tri->depth[1] * py + tri->depth[2], 0.0f);
+                row[x] = KMAX(row[x], depth);
+            }
+        }
+#endif
+    }
+}
+
+// Rasterizes every triangle into the given bands of rows. Bands never share rows, so run in parallel.
+static void bands_rasterize(u32 start, u32 end, void* user_data) {
+    occlusion_buffer* buffer = user_data;
+    u32 triangle_count = darray_length(buffer->triangles);
+    for (u32 band = start; band < end; ++band) {
+        i32 row_start = (i32)(band * OCCLUSION_BUFFER_BAND_HEIGHT);
+        i32 row_end = KMIN(row_start + OCCLUSION_BUFFER_BAND_HEIGHT, (i32)buffer->height);
+        for (u32 i = 0; i < triangle_count; ++i) {
+            const occlusion_triangle* tri = &buffer->triangles[i];
+            if (tri->max_y >= row_start && tri->min_y < row_end) {
+                triangle_rasterize(buffer, tri, row_start, row_end);
+            }
+        }
+    }
+}
+
+void occlusion_buffer_rasterize(occlusion_buffer* buffer) {
+    if (!buffer || !buffer->depth) {
+        return;
+    }
+    u32 triangle_count = darray_length(buffer->triangles);
+    if (!triangle_count) {
+        return;
+    }
+
+    u32 band_count = (buffer->height + OCCLUSION_BUFFER_BAND_HEIGHT - 1) / OCCLUSION_BUFFER_BAND_HEIGHT;
+    job_parallel_for(band_count, 1, bands_rasterize, buffer);
+    buffer->rasterized_triangle_count += triangle_count;
+    darray_clear(buffer->triangles);
+}
+
+b8 occlusion_buffer_aabb_visible(const occlusion_buffer* buffer, vec3 center, vec3 extents) {
+    if (!buffer || !buffer->depth || !buffer->rasterized_triangle_count) {
+        return true;
+    }
+
+    // Find the screen rectangle of the box, and the reciprocal depth of its nearest point.
+    f32 min_x = K_FLOAT_MAX, min_y = K_FLOAT_MAX;
+    f32 max_x = -K_FLOAT_MAX, max_y = -K_FLOAT_MAX;
+    f32 nearest = 0.0f;
+    for (u32 i = 0; i < 8; ++i) {
+        vec4 corner = {
+            center.x + ((i & 1) ? extents.x : -extents.x),
+            center.y + ((i & 2) ? extents.y : -extents.y),
+            center.z + ((i & 4) ? extents.z : -extents.z),
+            1.0f};
+        vec4 clip = vec4_mul_mat4(corner, buffer->view_projection);
+        if (clip.w < OCCLUSION_NEAR_W) {
+            return true;
+        }
+        f32 z = 1.0f / clip.w;
+        f32 x = (clip.x * z * 0.5f + 0.5f) * buffer->width;
+        f32 y = (clip.y * z * 0.5f + 0.5f) * buffer->height;
+        min_x = KMIN(min_x, x);
+        min_y = KMIN(min_y, y);
+        max_x = KMAX(max_x, x);
+        max_y = KMAX(max_y, y);
+        nearest = KMAX(nearest, z);
+    }
+
+    // Only the part of the box on screen can be seen.
+    i32 x_start = KMAX((i32)kfloor(min_x), 0);
+    i32 y_start = KMAX((i32)kfloor(min_y), 0);
+    i32 x_end = KMIN((i32)kceil(max_x), (i32)buffer->width);
+    i32 y_end = KMIN((i32)kceil(max_y), (i32)buffer->height);
+    if (x_start >= x_end || y_start >= y_end) {
+        return true;
+    }
+
+    // Hidden only if an occluder is nearer than the box everywhere it could appear.
+    for (i32 y = y_start; y < y_end; ++y) {
+        const f32* row = buffer->depth + (u64)y * buffer->width;
+        for (i32 x = x_start; x < x_end; ++x) {
+            if (row[x] <= nearest) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
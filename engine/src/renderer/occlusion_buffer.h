@@ -0,0 +1,122 @@
+/**
+ * @file occlusion_buffer.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains a low resolution software depth buffer, used to cull objects hidden
+ * behind large occluders on the CPU, for when culling can't be done on the GPU.
+ * @details A few large occluders are rasterized into the buffer each frame, after which the
+ * bounds of other objects are tested against it. A pixel takes an occluder's depth if the
+ * occluder covers its center, using the farthest depth the occluder has within the pixel, and
+ * objects are tested against every pixel their screen bounds touch. So an object is only culled
+ * if it is hidden, give or take half a pixel at the silhouettes of occluders.
+ *
+ * Depths are stored as reciprocal view depths (1 / w), which interpolate linearly in screen
+ * space, so larger values are nearer. Rows are split into bands rasterized in parallel on the
+ * job threads, four pixels at a time where SIMD is available.
+ * @version 1.0
+ * @date 2023-12-06
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct geometry;
+
+/** @brief The default width of an occlusion buffer, in pixels. */
+#define OCCLUSION_BUFFER_DEFAULT_WIDTH 256
+/** @brief The default height of an occlusion buffer, in pixels. */
+#define OCCLUSION_BUFFER_DEFAULT_HEIGHT 128
+/** @brief The number of rows rasterized by each job. */
+#define OCCLUSION_BUFFER_BAND_HEIGHT 16
+
+/** @brief A triangle of an occluder, set up for rasterization. */
+typedef struct occlusion_triangle {
+    /** @brief The coefficients (a, b, c) of each edge function, a * x + b * y + c, which is non-negative for pixel centers inside. */
+    f32 edges[3][3];
+    /** @brief The reciprocal depth plane (a, b, c), giving the farthest reciprocal depth of the triangle within each pixel. */
+    f32 depth[3];
+    /** @brief The pixel bounds of the triangle, inclusive, clamped to the buffer. */
+    i32 min_x;
+    i32 min_y;
+    i32 max_x;
+    i32 max_y;
+} occlusion_triangle;
+
+/**
+ * @brief A software depth buffer holding the nearest occluder at each pixel. Members of this
+ * structure should not be modified outside the functions associated with it.
+ */
+typedef struct occlusion_buffer {
+    /** @brief The width in pixels. Always a multiple of 4. */
+    u32 width;
+    /** @brief The height in pixels. */
+    u32 height;
+    /** @brief The reciprocal depth of the nearest occluder at each pixel, row by row. 0 where there is none. */
+    f32* depth;
+    /** @brief The view-projection occluders are drawn and bounds are tested with. */
+    mat4 view_projection;
+    /** @brief The triangles of the occluders added since the buffer was last begun. Darray. */
+    occlusion_triangle* triangles;
+    /** @brief The number of occluder triangles rasterized into the buffer. */
+    u32 rasterized_triangle_count;
+} occlusion_buffer;
+
+/**
+ * @brief Creates an occlusion buffer of the given size.
+ *
+ * @param width The width in pixels. Rounded up to a multiple of 4.
+ * @param height The height in pixels.
+ * @param out_buffer A pointer to hold the buffer.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 occlusion_buffer_create(u32 width, u32 height, occlusion_buffer* out_buffer);
+
+/**
+ * @brief Destroys the given occlusion buffer.
+ *
+ * @param buffer A pointer to the buffer.
+ */
+KAPI void occlusion_buffer_destroy(occlusion_buffer* buffer);
+
+/**
+ * @brief Clears the buffer and its occluders, ready for those of a new frame.
+ *
+ * @param buffer A pointer to the buffer.
+ * @param view_projection The view-projection occluders are drawn and bounds are tested with.
+ */
+KAPI void occlusion_buffer_begin(occlusion_buffer* buffer, mat4 view_projection);
+
+/**
+ * @brief Adds the triangles of the given geometry as an occluder, to be drawn by
+ * occlusion_buffer_rasterize. Vertices are read from the geometry's CPU copy, which must
+ * be indexed with 32-bit indices. Triangles crossing the near plane are clipped to it.
+ *
+ * @param buffer A pointer to the buffer.
+ * @param g A constant pointer to the geometry.
+ * @param model The world matrix of the geometry. For packed vertices, this should not include the dequantization.
+ * @return True if the geometry could be added; otherwise false.
+ */
+KAPI b8 occlusion_buffer_occluder_add(occlusion_buffer* buffer, const struct geometry* g, mat4 model);
+
+/**
+ * @brief Rasterizes the occluders added since the buffer was begun, in parallel on the job threads.
+ *
+ * @param buffer A pointer to the buffer.
+ */
+KAPI void occlusion_buffer_rasterize(occlusion_buffer* buffer);
+
+/**
+ * @brief Indicates if any part of the given world-space box may be visible past the occluders.
+ * Boxes reaching behind the near plane are always visible. Only the part of a box within the
+ * buffer is tested, since the rest is outside the view.
+ *
+ * @param buffer A constant pointer to the buffer.
+ * @param center The center of the box.
+ * @param extents The half-extents of the box.
+ * @return True if the box may be visible; false if it is certainly hidden.
+ */
+KAPI b8 occlusion_buffer_aabb_visible(const occlusion_buffer* buffer, vec3 center, vec3 extents);
@@ -0,0 +1,732 @@
+#include "point_shadow_pass.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "defines.h"
+#include "math/kmath.h"
+#include "math/math_types.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/renderer_types.h"
+#include "renderer/rendergraph.h"
+#include "renderer/viewport.h"
+#include "resources/resource_types.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+#include "systems/texture_system.h"
+
+#include <stddef.h>
+
+// The near clip of every face. Far enough out that depth precision holds up to the light's radius.
+#define POINT_SHADOW_NEAR_CLIP 0.1f
+// The depth bias sampled with, in the nonlinear depth the faces are rendered with.
+#define POINT_SHADOW_DEPTH_BIAS 0.0005f
+
+typedef struct point_shadow_shader_locations {
+    u16 view_projections_location;
+    u16 model_location;
+    u16 face_index_location;
+    u16 colour_map_location;
+    // Indicates the shader's locals match point_shadow_local_block, so can be pushed in one go.
+    b8 local_block_valid;
+} point_shadow_shader_locations;
+
+// The locals of the point shadow shader, laid out as they are pushed.
+typedef struct point_shadow_local_block {
+    mat4 model;
+    // The index of the view projection of the face being drawn, in the globals.
+    u32 face_index;
+} point_shadow_local_block;
+
+// What a slot's static faces of one frame's atlas were last rendered with.
+typedef struct point_shadow_slot_cache {
+    // Indicates the faces have been rendered at all.
+    b8 valid;
+    // The light the faces were rendered for.
+    struct point_light* light;
+    // A hash of the position, radius and static geometries.
+    u64 content_hash;
+    mat4 face_view_projections[POINT_SHADOW_FACE_COUNT];
+} point_shadow_slot_cache;
+
+typedef struct frame_point_shadow_cache {
+    point_shadow_slot_cache slots[MAX_POINT_LIGHT_SHADOWS];
+} frame_point_shadow_cache;
+
+typedef struct point_shadow_instance_data {
+    u64 render_frame_number;
+    u8 render_draw_index;
+} point_shadow_instance_data;
+
+typedef struct point_shadow_pass_internal_data {
+    point_shadow_pass_config config;
+
+    shader* s;
+    point_shadow_shader_locations locations;
+
+    // Internal viewport covering one face.
+    viewport face_viewport;
+
+    // One atlas per frame. The static faces of every slot come first, followed by their dynamic faces.
+    texture* depth_textures;
+    u32 layer_count;
+    // One target per layer, for each frame, ordered by frame then layer.
+    render_target* targets;
+
+    // The light holding each slot, or 0 if free. Kept across frames.
+    struct point_light* slot_lights[MAX_POINT_LIGHT_SHADOWS];
+    // What each frame's atlas holds, one per frame.
+    frame_point_shadow_cache* frame_caches;
+    // The frame the lights were last prepared for. If not the current one, nothing is drawn.
+    u64 prepared_frame_number;
+
+    // Set by point_shadow_pass_prepare for the current frame.
+    // The slot of each light of the extended data, or INVALID_ID if it has none.
+    u32 light_slots[MAX_POINT_LIGHT_SHADOWS];
+    // Indicates if the static faces of each light of the extended data are rendered.
+    b8 static_renders[MAX_POINT_LIGHT_SHADOWS];
+    // The view projection of each face of each slot, as set on the shader's globals.
+    mat4 face_view_projections[MAX_POINT_LIGHT_SHADOWS * POINT_SHADOW_FACE_COUNT];
+
+    // Track instance updates per frame
+    u32 instance_count;
+    // Default map to be used when materials aren't available.
+    texture_map default_colour_map;
+    u32 default_instance_id;
+    u64 default_instance_frame_number;
+    u8 default_instance_draw_index;
+
+    // Track instance data per instance. darray
+    point_shadow_instance_data* instances;
+} point_shadow_pass_internal_data;
+
+b8 point_shadow_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self || !config) {
+        KERROR("point_shadow_pass_create requires both a pointer to self and a valid config");
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(point_shadow_pass_internal_data), MEMORY_TAG_RENDERER);
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    internal_data->config = *((point_shadow_pass_config*)config);
+    if (!internal_data->config.resolution) {
+        internal_data->config.resolution = 256;
+    }
+    if (!internal_data->config.slot_count || internal_data->config.slot_count > MAX_POINT_LIGHT_SHADOWS) {
+        internal_data->config.slot_count = MAX_POINT_LIGHT_SHADOWS;
+    }
+    if (!internal_data->config.update_budget) {
+        internal_data->config.update_budget = 1;
+    }
+
+    self->pass_data.ext_data = kallocate(sizeof(point_shadow_pass_extended_data), MEMORY_TAG_RENDERER);
+
+    // Custom function pointers.
+    self->attachment_populate = point_shadow_pass_attachment_populate;
+    self->source_populate = point_shadow_pass_source_populate;
+
+    // Only uses its own shader and instances, so may be recorded alongside other passes.
+    self->parallel_recording = true;
+
+    return true;
+}
+
+static b8 local_block_verify(shader* s) {
+    const shader_local_block_member members[] = {
+        {"model", offsetof(point_shadow_local_block, model), sizeof(mat4)},
+        {"face_index", offsetof(point_shadow_local_block, face_index), sizeof(u32)}};
+    if (!shader_system_local_block_verify(s, 2, members, sizeof(point_shadow_local_block))) {
+        KWARN("Shader '%s' locals don't match the point shadow local block. Falling back to setting them individually.", s->name);
+        return false;
+    }
+    return true;
+}
+
+// Applies the locals of a draw, pushing them in one go when the layout allows.
+static void locals_apply(const point_shadow_shader_locations* locations, const mat4* model, u32 face_index, struct frame_data* p_frame_data) {
+    if (locations->local_block_valid) {
+        point_shadow_local_block block = {*model, face_index};
+        shader_system_local_block_push(&block, sizeof(point_shadow_local_block));
+        return;
+    }
+
+    shader_system_bind_local();
+    shader_system_uniform_set_by_location(locations->model_location, model);
+    shader_system_uniform_set_by_location(locations->face_index_location, &face_index);
+    shader_system_apply_local(p_frame_data);
+}
+
+b8 point_shadow_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+
+    // Create the atlases, one per frame.
+    u8 frame_count = renderer_window_attachment_count_get();
+    internal_data->layer_count = internal_data->config.slot_count * POINT_SHADOW_FACE_COUNT * 2;
+
+    internal_data->depth_textures = kallocate(sizeof(texture) * frame_count, MEMORY_TAG_RENDERER);
+    internal_data->frame_caches = kallocate(sizeof(frame_point_shadow_cache) * frame_count, MEMORY_TAG_RENDERER);
+    internal_data->prepared_frame_number = INVALID_ID_U64;
+
+    for (u8 i = 0; i < frame_count; ++i) {
+        texture* dt = &internal_data->depth_textures[i];
+        dt->type = TEXTURE_TYPE_2D_ARRAY;
+        dt->flags |= TEXTURE_FLAG_DEPTH | TEXTURE_FLAG_IS_WRITEABLE;
+        dt->width = internal_data->config.resolution;
+        dt->height = internal_data->config.resolution;
+        dt->array_size = internal_data->layer_count;
+        string_format(dt->name, "point_shadow_pass_res_%u_idx_%u_depth_texture", internal_data->config.resolution, i);
+        dt->mip_levels = 1;
+        dt->channel_count = 4;
+        dt->generation = INVALID_ID;
+        renderer_texture_create_writeable(dt);
+    }
+
+    // Setup the renderpass.
+    renderpass_config point_shadow_pass_config = {0};
+    point_shadow_pass_config.name = "Renderpass.PointShadow";
+    point_shadow_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.2f, 1.0f};
+    point_shadow_pass_config.clear_flags = RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG;
+    point_shadow_pass_config.depth = 1.0f;
+    point_shadow_pass_config.stencil = 0;
+    point_shadow_pass_config.target.attachment_count = 1;
+    point_shadow_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * point_shadow_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    point_shadow_pass_config.render_target_count = frame_count;
+
+    // Depth attachment.
+    render_target_attachment_config* target_depth = &point_shadow_pass_config.target.attachments[0];
+    target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_SELF;  // This owns the attachment.
+    target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    target_depth->present_after = true;
+
+    if (!renderer_renderpass_create(&point_shadow_pass_config, &self->pass)) {
+        KERROR("Point shadow rendergraph pass - Failed to create point shadow renderpass.");
+        return false;
+    }
+
+    // Load the point shadow shader. Attempt to to get the already-loaded shader if it doesn't exist.
+    const char* shader_name = "Shader.PointShadow";
+    internal_data->s = shader_system_get(shader_name);
+    if (!internal_data->s) {
+        KTRACE("Shader '%s' doesn't exist. Attempting to load it...", shader_name);
+        resource shader_config_resource;
+        if (!resource_system_load(shader_name, RESOURCE_TYPE_SHADER, 0, &shader_config_resource)) {
+            KERROR("Failed to load point shadow shader resource.");
+            return false;
+        }
+        shader_config* point_shadow_shader_config = (shader_config*)shader_config_resource.data;
+        if (!shader_system_create(&self->pass, point_shadow_shader_config)) {
+            KERROR("Failed to create point shadow shader.");
+            return false;
+        }
+
+        resource_system_unload(&shader_config_resource);
+        // Get a pointer to the shader.
+        internal_data->s = shader_system_get(shader_name);
+    } else {
+        KTRACE("Shader '%s' already exists, using it.", shader_name);
+    }
+    internal_data->locations.view_projections_location = shader_system_uniform_location(internal_data->s, "view_projections");
+    internal_data->locations.model_location = shader_system_uniform_location(internal_data->s, "model");
+    internal_data->locations.face_index_location = shader_system_uniform_location(internal_data->s, "face_index");
+    internal_data->locations.colour_map_location = shader_system_uniform_location(internal_data->s, "colour_map");
+    internal_data->locations.local_block_valid = local_block_verify(internal_data->s);
+
+    return true;
+}
+
+static void depth_target_create(struct rendergraph_pass* self, texture* depth_texture, u16 layer_index, render_target* target) {
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    target->attachment_count = 1;
+    target->attachments = kallocate(sizeof(render_target_attachment) * target->attachment_count, MEMORY_TAG_ARRAY);
+    target->attachments[0].type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    target->attachments[0].source = RENDER_TARGET_ATTACHMENT_SOURCE_SELF;
+    target->attachments[0].texture = depth_texture;
+    target->attachments[0].present_after = true;
+    target->attachments[0].load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    target->attachments[0].store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+
+    // Create the underlying render target.
+    renderer_render_target_create(
+        target->attachment_count,
+        target->attachments,
+        &self->pass,
+        internal_data->config.resolution,
+        internal_data->config.resolution,
+        layer_index,
+        target);
+}
+
+// Acquires an instance of the shader, sampling the default colour map until a material's is bound.
+static b8 instance_acquire(point_shadow_pass_internal_data* internal_data, u32* out_instance_id) {
+    texture_map* maps[1] = {&internal_data->default_colour_map};
+    shader* s = internal_data->s;
+    shader_instance_resource_config instance_resource_config = {0};
+    // Map count for this type is known.
+    shader_instance_uniform_texture_config colour_texture = {0};
+    colour_texture.uniform_location = s->uniforms[s->instance_sampler_indices[0]].index;
+    colour_texture.texture_map_count = 1;
+    colour_texture.texture_maps = maps;
+
+    instance_resource_config.uniform_config_count = 1;
+    instance_resource_config.uniform_configs = &colour_texture;
+    return renderer_shader_instance_resources_acquire(s, &instance_resource_config, out_instance_id);
+}
+
+b8 point_shadow_pass_load_resources(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+
+    // Create a texture map to be used across the board for the diffuse/albedo transparency sample.
+    internal_data->default_colour_map.mip_levels = 1;
+    internal_data->default_colour_map.generation = INVALID_ID;
+    internal_data->default_colour_map.repeat_u = internal_data->default_colour_map.repeat_v = internal_data->default_colour_map.repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+    internal_data->default_colour_map.filter_minify = internal_data->default_colour_map.filter_magnify = TEXTURE_FILTER_MODE_LINEAR;
+    internal_data->default_colour_map.texture = texture_system_get_default_diffuse_texture();
+    if (!renderer_texture_map_resources_acquire(&internal_data->default_colour_map)) {
+        KERROR("Failed to acquire texture map resources for default colour map in point shadow pass.");
+        return false;
+    }
+
+    // Reserve an instance id for the default "material" to render to.
+    if (!instance_acquire(internal_data, &internal_data->default_instance_id)) {
+        KERROR("Failed to acquire the default instance of the point shadow shader.");
+        return false;
+    }
+    internal_data->instances = darray_create(point_shadow_instance_data);
+    internal_data->instance_count = 1;
+
+    // NOTE: Only the viewport rect is used, as each face's view projection is set on the globals.
+    vec4 viewport_rect = {0, 0, internal_data->config.resolution, internal_data->config.resolution};
+    if (!viewport_create(viewport_rect, 0.0f, 0.0f, 0.0f, RENDERER_PROJECTION_MATRIX_TYPE_ORTHOGRAPHIC, &internal_data->face_viewport)) {
+        KERROR("Failed to create viewport for point shadow pass.");
+        return false;
+    }
+
+    // One render target per layer of each frame's atlas.
+    u8 frame_count = renderer_window_attachment_count_get();
+    internal_data->targets = kallocate(sizeof(render_target) * frame_count * internal_data->layer_count, MEMORY_TAG_ARRAY);
+    for (u32 f = 0; f < frame_count; ++f) {
+        for (u32 l = 0; l < internal_data->layer_count; ++l) {
+            depth_target_create(self, &internal_data->depth_textures[f], l, &internal_data->targets[f * internal_data->layer_count + l]);
+        }
+    }
+
+    return true;
+}
+
+// Ensures there is an instance for the material of every given geometry, indexed by the material's
+// internal id, +1 to account for the first id being taken by the default instance.
+static void instance_resources_ensure(point_shadow_pass_internal_data* internal_data, u32 geometry_count, const geometry_draw_record* geometries) {
+    u32 highest_id = 0;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        material* m = geometries[i].geometry->material;
+        if (m && m->internal_id + 1 > highest_id) {
+            highest_id = m->internal_id + 1;
+        }
+    }
+    // Count the default instance.
+    highest_id++;
+
+    if (highest_id > internal_data->instance_count) {
+        // Get more resources if needed, starting at the previous high point.
+        for (u32 i = KMAX(internal_data->instance_count, 1); i < highest_id; i++) {
+            u32 instance_id;
+            if (!instance_acquire(internal_data, &instance_id)) {
+                KERROR("Failed to acquire an instance of the point shadow shader.");
+                return;
+            }
+            point_shadow_instance_data instance = {INVALID_ID_U64, INVALID_ID_U8};
+            while (darray_length(internal_data->instances) <= instance_id) {
+                darray_push(internal_data->instances, instance);
+            }
+        }
+        internal_data->instance_count = highest_id;
+    }
+}
+
+// Binds and applies the instance of the shader used to draw the given geometry.
+static b8 geometry_instance_apply(point_shadow_pass_internal_data* internal_data, geometry_render_data* g, struct frame_data* p_frame_data) {
+    u32 bind_id = INVALID_ID;
+    texture_map* bind_map = 0;
+    u64* render_number = 0;
+    u8* draw_index = 0;
+
+    if (g->material && g->material->maps && g->material->internal_id + 1 < darray_length(internal_data->instances)) {
+        // NOTE: +1 to account for the first id being taken by the default instance.
+        bind_id = g->material->internal_id + 1;
+        // Use the current material's diffuse/albedo map, for its transparency.
+        bind_map = &g->material->maps[0];
+        point_shadow_instance_data* instance = &internal_data->instances[bind_id];
+        render_number = &instance->render_frame_number;
+        draw_index = &instance->render_draw_index;
+    } else {
+        bind_id = internal_data->default_instance_id;
+        bind_map = &internal_data->default_colour_map;
+        render_number = &internal_data->default_instance_frame_number;
+        draw_index = &internal_data->default_instance_draw_index;
+    }
+
+    // NOTE: An instance can only be updated once per frame. The map is the same for every face, so that's enough.
+    b8 needs_update = *render_number != p_frame_data->renderer_frame_number || *draw_index != p_frame_data->draw_index;
+
+    shader_system_bind_instance(bind_id);
+    if (!shader_system_uniform_set_by_location(internal_data->locations.colour_map_location, bind_map)) {
+        KERROR("Failed to apply point shadow colour_map uniform.");
+        return false;
+    }
+    shader_system_apply_instance(needs_update, p_frame_data);
+
+    // Sync the frame number and draw index.
+    *render_number = p_frame_data->renderer_frame_number;
+    *draw_index = p_frame_data->draw_index;
+    return true;
+}
+
+static u64 hash_combine(u64 hash, u64 value) {
+    hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static u64 hash_mat4(u64 hash, const mat4* m) {
+    const u32* bits = (const u32*)m->data;
+    for (u32 i = 0; i < 16; i += 2) {
+        hash = hash_combine(hash, ((u64)bits[i] << 32) | bits[i + 1]);
+    }
+    return hash;
+}
+
+// Per-geometry hashes are summed, so the order in which geometries are listed doesn't matter.
+static u64 draw_records_hash(u32 count, const geometry_draw_record* records, const mat4* models) {
+    u64 sum = count;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_draw_record* r = &records[i];
+        u64 hash = (u64)r->geometry;
+        hash = hash_combine(hash, ((u64)r->object_index << 32) | ((u64)r->lod << 1) | r->winding_inverted);
+        hash = hash_combine(hash, r->geometry->vertex_buffer_offset);
+        hash = hash_combine(hash, r->geometry->index_buffer_offset);
+        hash = hash_combine(hash, ((u64)r->first_index << 32) | r->index_count);
+        hash = hash_combine(hash, (u64)r->geometry->material);
+        if (models) {
+            hash = hash_mat4(hash, &models[r->object_index]);
+        }
+        sum += hash;
+    }
+    return sum;
+}
+
+static u64 light_content_hash(const point_shadow_light_data* light, const mat4* models) {
+    const u32* bits = (const u32*)light->position.elements;
+    u64 hash = hash_combine((u64)light->light, ((u64)bits[0] << 32) | bits[1]);
+    u32 radius_bits;
+    kcopy_memory(&radius_bits, &light->radius, sizeof(u32));
+    hash = hash_combine(hash, ((u64)bits[2] << 32) | radius_bits);
+    return hash_combine(hash, draw_records_hash(light->static_geometry_count, light->static_geometries, models));
+}
+
+// The view projections of the six faces about the given position, ordered +x, -x, +y, -y, +z, -z.
+static void face_view_projections_get(vec3 position, f32 radius, mat4* out_view_projections) {
+    const vec3 directions[POINT_SHADOW_FACE_COUNT] = {
+        {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+    const vec3 ups[POINT_SHADOW_FACE_COUNT] = {
+        {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}};
+    // A quarter turn across each face, so the six cover every direction, split by the major axis.
+    mat4 projection = mat4_perspective(K_HALF_PI, 1.0f, POINT_SHADOW_NEAR_CLIP, KMAX(radius, POINT_SHADOW_NEAR_CLIP * 2.0f));
+    for (u32 f = 0; f < POINT_SHADOW_FACE_COUNT; ++f) {
+        mat4 view = mat4_look_at(position, vec3_add(position, directions[f]), ups[f]);
+        out_view_projections[f] = mat4_mul(view, projection);
+    }
+}
+
+void point_shadow_pass_prepare(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return;
+    }
+
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    point_shadow_pass_extended_data* ext_data = self->pass_data.ext_data;
+    frame_point_shadow_cache* frame_cache = &internal_data->frame_caches[p_frame_data->render_target_index];
+    u32 slot_count = internal_data->config.slot_count;
+    u32 light_count = KMIN(ext_data->light_count, slot_count);
+
+    // Free the slots of lights no longer casting shadows.
+    for (u32 s = 0; s < slot_count; ++s) {
+        b8 found = false;
+        for (u32 i = 0; i < light_count && !found; ++i) {
+            found = ext_data->lights[i].light == internal_data->slot_lights[s];
+        }
+        if (!found) {
+            internal_data->slot_lights[s] = 0;
+        }
+    }
+
+    // Lights keep their slots, and newcomers take free ones.
+    for (u32 i = 0; i < light_count; ++i) {
+        point_shadow_light_data* light = &ext_data->lights[i];
+        internal_data->light_slots[i] = INVALID_ID;
+        internal_data->static_renders[i] = false;
+        light->has_shadow = false;
+        if (!light->light) {
+            continue;
+        }
+        for (u32 s = 0; s < slot_count; ++s) {
+            if (internal_data->slot_lights[s] == light->light) {
+                internal_data->light_slots[i] = s;
+                break;
+            }
+        }
+        if (internal_data->light_slots[i] == INVALID_ID) {
+            for (u32 s = 0; s < slot_count; ++s) {
+                if (!internal_data->slot_lights[s]) {
+                    internal_data->slot_lights[s] = light->light;
+                    internal_data->light_slots[i] = s;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Lights whose faces hold nothing usable are rendered first, then those which changed, within budget.
+    u64 content_hashes[MAX_POINT_LIGHT_SHADOWS];
+    u32 budget = internal_data->config.update_budget;
+    for (u32 pass = 0; pass < 2; ++pass) {
+        for (u32 i = 0; i < light_count; ++i) {
+            u32 slot = internal_data->light_slots[i];
+            if (slot == INVALID_ID) {
+                continue;
+            }
+            point_shadow_light_data* light = &ext_data->lights[i];
+            point_shadow_slot_cache* cached = &frame_cache->slots[slot];
+            if (pass == 0) {
+                content_hashes[i] = light_content_hash(light, ext_data->models);
+            }
+            b8 usable = cached->valid && cached->light == light->light;
+            b8 changed = !usable || cached->content_hash != content_hashes[i];
+            if (!changed || usable == (pass == 0) || !budget) {
+                continue;
+            }
+            budget--;
+            internal_data->static_renders[i] = true;
+            cached->valid = true;
+            cached->light = light->light;
+            cached->content_hash = content_hashes[i];
+            face_view_projections_get(light->position, light->radius, cached->face_view_projections);
+        }
+    }
+
+    // Shadow every light with usable faces, as they were rendered.
+    for (u32 i = 0; i < light_count; ++i) {
+        u32 slot = internal_data->light_slots[i];
+        point_shadow_light_data* light = &ext_data->lights[i];
+        if (slot == INVALID_ID || !frame_cache->slots[slot].valid || frame_cache->slots[slot].light != light->light) {
+            continue;
+        }
+        point_shadow_slot_cache* cached = &frame_cache->slots[slot];
+        light->has_shadow = true;
+        kcopy_memory(light->shadow.face_view_projections, cached->face_view_projections, sizeof(mat4) * POINT_SHADOW_FACE_COUNT);
+        kcopy_memory(&internal_data->face_view_projections[slot * POINT_SHADOW_FACE_COUNT], cached->face_view_projections, sizeof(mat4) * POINT_SHADOW_FACE_COUNT);
+        light->shadow.params.x = (f32)(slot * POINT_SHADOW_FACE_COUNT);
+        light->shadow.params.y = light->dynamic_geometry_count ? (f32)((slot_count + slot) * POINT_SHADOW_FACE_COUNT) : -1.0f;
+        light->shadow.params.z = POINT_SHADOW_DEPTH_BIAS;
+        light->shadow.params.w = 0.0f;
+    }
+
+    internal_data->prepared_frame_number = p_frame_data->renderer_frame_number;
+}
+
+// Draws the given geometries into a single face.
+static b8 face_render(struct rendergraph_pass* self, struct frame_data* p_frame_data, u32 layer, u32 face_index, u32 geometry_count, const geometry_draw_record* geometries) {
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    point_shadow_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    if (!renderer_renderpass_begin(&self->pass, &internal_data->targets[p_frame_data->render_target_index * internal_data->layer_count + layer])) {
+        KERROR("Point shadow pass failed to start.");
+        return false;
+    }
+
+    shader_system_use_by_id(internal_data->s->id);
+
+    // Using the shader selected the standard vertex format.
+    geometry_vertex_format current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        geometry_render_data data;
+        renderer_geometry_draw_record_resolve(&geometries[i], ext_data->models, &data);
+        geometry_render_data* g = &data;
+
+        // Switch vertex formats if needed.
+        if (g->vertex_format != current_vertex_format) {
+            if (!shader_system_vertex_format_set(g->vertex_format)) {
+                KWARN("Failed to set vertex format for point shadow geometry. Skipping draw.");
+                continue;
+            }
+            current_vertex_format = g->vertex_format;
+        }
+
+        if (!geometry_instance_apply(internal_data, g, p_frame_data)) {
+            return false;
+        }
+
+        locals_apply(&internal_data->locations, &g->model, face_index, p_frame_data);
+
+        // Invert if needed
+        if (g->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
+        }
+
+        renderer_geometry_draw(g);
+
+        // Change back if needed
+        if (g->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
+        }
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("Point shadow pass failed to end.");
+        return false;
+    }
+    return true;
+}
+
+b8 point_shadow_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    point_shadow_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    // Without preparation, it isn't known which faces the lights may use.
+    if (internal_data->prepared_frame_number != p_frame_data->renderer_frame_number) {
+        return true;
+    }
+
+    u32 slot_count = internal_data->config.slot_count;
+    u32 light_count = KMIN(ext_data->light_count, slot_count);
+    b8 any_render = false;
+    for (u32 i = 0; i < light_count; ++i) {
+        const point_shadow_light_data* light = &ext_data->lights[i];
+        instance_resources_ensure(internal_data, light->static_geometry_count, light->static_geometries);
+        instance_resources_ensure(internal_data, light->dynamic_geometry_count, light->dynamic_geometries);
+        any_render |= internal_data->static_renders[i] || (light->has_shadow && light->dynamic_geometry_count);
+    }
+    if (!any_render) {
+        return true;
+    }
+
+    // Bind the internal viewport - do not use one provided in pass data.
+    renderer_active_viewport_set(&internal_data->face_viewport);
+
+    // Apply globals, once for every face.
+    shader_system_use_by_id(internal_data->s->id);
+    renderer_shader_bind_globals(internal_data->s);
+    for (u32 i = 0; i < slot_count * POINT_SHADOW_FACE_COUNT; ++i) {
+        if (!shader_system_uniform_set_by_location_arrayed(internal_data->locations.view_projections_location, i, &internal_data->face_view_projections[i])) {
+            KERROR("Failed to apply point shadow view projection uniform.");
+            return false;
+        }
+    }
+    shader_system_apply_global(true, p_frame_data);
+
+    for (u32 i = 0; i < light_count; ++i) {
+        const point_shadow_light_data* light = &ext_data->lights[i];
+        u32 slot = internal_data->light_slots[i];
+        if (slot == INVALID_ID) {
+            continue;
+        }
+        for (u32 f = 0; f < POINT_SHADOW_FACE_COUNT; ++f) {
+            u32 face_index = slot * POINT_SHADOW_FACE_COUNT + f;
+            if (internal_data->static_renders[i]) {
+                if (!face_render(self, p_frame_data, face_index, face_index, light->static_geometry_count, light->static_geometries)) {
+                    return false;
+                }
+            }
+            // Moving casters are drawn into faces of their own, which are combined with the static ones when sampled.
+            if (light->has_shadow && light->dynamic_geometry_count) {
+                u32 dynamic_layer = slot_count * POINT_SHADOW_FACE_COUNT + face_index;
+                if (!face_render(self, p_frame_data, dynamic_layer, face_index, light->dynamic_geometry_count, light->dynamic_geometries)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void point_shadow_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            point_shadow_pass_internal_data* internal_data = self->internal_data;
+
+            u8 frame_count = renderer_window_attachment_count_get();
+            if (internal_data->targets) {
+                for (u32 i = 0; i < frame_count * internal_data->layer_count; ++i) {
+                    renderer_render_target_destroy(&internal_data->targets[i], true);
+                }
+                kfree(internal_data->targets, sizeof(render_target) * frame_count * internal_data->layer_count, MEMORY_TAG_ARRAY);
+            }
+
+            for (u8 i = 0; i < frame_count; ++i) {
+                renderer_texture_destroy(&internal_data->depth_textures[i]);
+            }
+            kfree(internal_data->depth_textures, sizeof(texture) * frame_count, MEMORY_TAG_RENDERER);
+            kfree(internal_data->frame_caches, sizeof(frame_point_shadow_cache) * frame_count, MEMORY_TAG_RENDERER);
+
+            renderer_texture_map_resources_release(&internal_data->default_colour_map);
+            renderer_shader_instance_resources_release(internal_data->s, internal_data->default_instance_id);
+            if (internal_data->instances) {
+                darray_destroy(internal_data->instances);
+            }
+
+            // Destroy the extended data.
+            if (self->pass_data.ext_data) {
+                kfree(self->pass_data.ext_data, sizeof(point_shadow_pass_extended_data), MEMORY_TAG_RENDERER);
+                self->pass_data.ext_data = 0;
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(point_shadow_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
+
+b8 point_shadow_pass_source_populate(struct rendergraph_pass* self, rendergraph_source* source) {
+    if (!self || !source) {
+        return false;
+    }
+
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    u32 frame_count = renderer_window_attachment_count_get();
+    if (!source->textures) {
+        source->textures = kallocate(sizeof(texture*) * frame_count, MEMORY_TAG_ARRAY);
+    }
+    if (strings_equali(source->name, "depthbuffer")) {
+        for (u32 i = 0; i < frame_count; ++i) {
+            source->textures[i] = &internal_data->depth_textures[i];
+        }
+        return true;
+    }
+    KERROR("point_shadow_pass_source_populate could not populate source '%s' as it is unrecognized.", source->name);
+    return false;
+}
+
+b8 point_shadow_pass_attachment_populate(struct rendergraph_pass* self, render_target_attachment* attachment) {
+    point_shadow_pass_internal_data* internal_data = self->internal_data;
+    if (attachment->type == RENDER_TARGET_ATTACHMENT_TYPE_DEPTH) {
+        attachment->texture = &internal_data->depth_textures[0];
+        return true;
+    }
+
+    return false;
+}
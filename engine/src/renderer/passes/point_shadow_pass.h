@@ -0,0 +1,77 @@
+#ifndef _POINT_SHADOW_PASS_H_
+#define _POINT_SHADOW_PASS_H_
+
+#include "defines.h"
+#include "math/math_types.h"
+#include "renderer/renderer_types.h"
+#include "systems/light_system.h"
+
+struct rendergraph_pass;
+struct rendergraph_source;
+struct frame_data;
+struct point_light;
+
+#define POINT_SHADOW_FACE_COUNT 6
+
+typedef struct point_shadow_light_data {
+    // The light casting the shadow. Keeps the slot of the atlas it was given for as long as it is passed.
+    struct point_light* light;
+    vec3 position;
+    // The distance at which the light no longer reaches, which is the far clip of its faces.
+    f32 radius;
+    // Draw records of the geometries within the radius which haven't moved lately. Their faces are
+    // only re-rendered when these, the position or the radius change.
+    u32 static_geometry_count;
+    struct geometry_draw_record* static_geometries;
+    // Draw records of the moving geometries within the radius, rendered into their own faces each frame.
+    u32 dynamic_geometry_count;
+    struct geometry_draw_record* dynamic_geometries;
+
+    // Set by point_shadow_pass_prepare. If false, the light has no shadow this frame, e.g. while
+    // waiting for its static faces to be rendered within the update budget.
+    b8 has_shadow;
+    // Set by point_shadow_pass_prepare. The shadow as rendered into this frame's atlas, to be
+    // handed to light_system_point_shadows_set.
+    point_light_shadow_data shadow;
+} point_shadow_light_data;
+
+typedef struct point_shadow_pass_extended_data {
+    // Persistent model matrices, indexed by the object index of each draw record.
+    const mat4* models;
+    // The lights casting shadows this frame, at most the slot count of the pass.
+    u32 light_count;
+    point_shadow_light_data lights[MAX_POINT_LIGHT_SHADOWS];
+} point_shadow_pass_extended_data;
+
+typedef struct point_shadow_pass_config {
+    // The resolution of each face.
+    u16 resolution;
+    // The number of lights the atlas holds faces for. At most MAX_POINT_LIGHT_SHADOWS.
+    u8 slot_count;
+    // The most lights whose static faces are re-rendered in a single frame.
+    u8 update_budget;
+} point_shadow_pass_config;
+
+KAPI b8 point_shadow_pass_create(struct rendergraph_pass* self, void* config);
+KAPI b8 point_shadow_pass_initialize(struct rendergraph_pass* self);
+KAPI b8 point_shadow_pass_load_resources(struct rendergraph_pass* self);
+KAPI b8 point_shadow_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+
+/**
+ * @brief Decides which lights need their static faces rendered this frame, once the lights and
+ * their geometries are set. A light's static faces are only re-rendered once its position, radius
+ * or static geometries change, and no more than the update budget of lights are re-rendered in a
+ * frame, lights without any faces yet going first. Lights kept waiting are shadowed as they were
+ * last rendered, or not at all if they never were. The dynamic faces of every shadowed light with
+ * moving geometries are rendered each frame. Sets the shadow of each light.
+ *
+ * @param self A pointer to the pass.
+ * @param p_frame_data A pointer to the current frame's data.
+ */
+KAPI void point_shadow_pass_prepare(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+KAPI void point_shadow_pass_destroy(struct rendergraph_pass* self);
+
+KAPI b8 point_shadow_pass_source_populate(struct rendergraph_pass* self, struct rendergraph_source* source);
+KAPI b8 point_shadow_pass_attachment_populate(struct rendergraph_pass* self, render_target_attachment* attachment);
+
+#endif
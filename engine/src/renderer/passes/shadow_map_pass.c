@@ -16,19 +16,45 @@
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
 
+#include <stddef.h>
+
 typedef struct shadow_map_shader_locations {
     u16 projections_location;
     u16 views_location;
     u16 model_location;
     u32 cascade_index_location;
+    u16 cascade_mask_location;
     u16 colour_map_location;
+    // Indicates the shader's locals match shadow_map_local_block, so can be pushed in one go.
+    b8 local_block_valid;
 } shadow_map_shader_locations;
 
+// The locals of every shadowmap shader, laid out as they are pushed.
+typedef struct shadow_map_local_block {
+    mat4 model;
+    // The cascade index, or the mask of cascades drawn into when layered.
+    u32 cascade;
+} shadow_map_local_block;
+
 typedef struct cascade_resources {
     // One target per frame.
     render_target* targets;
 } cascade_resources;
 
+// What a cascade's layer of one frame's depth texture was last rendered with.
+typedef struct cascade_cache {
+    // Indicates the layer has been rendered at all.
+    b8 valid;
+    mat4 view;
+    mat4 projection;
+    // A hash of the view, projection and geometries.
+    u64 content_hash;
+} cascade_cache;
+
+typedef struct frame_cascade_cache {
+    cascade_cache cascades[MAX_CASCADE_COUNT];
+} frame_cascade_cache;
+
 typedef struct shadow_shader_instance_data {
     u64 render_frame_number;
     u8 render_draw_index;
@@ -45,9 +71,20 @@ typedef struct shadow_map_pass_internal_data {
 
     texture* depth_textures;
 
-    // One per cascade.
+    // Indicates if all cascades are rendered in a single pass, each being a layer of the
+    // depth texture which every draw reaches at once.
+    b8 layered;
+    // One target per frame covering all cascades. Only used when layered.
+    render_target* layered_targets;
+
+    // One per cascade. Only used when not layered.
     cascade_resources cascades[MAX_CASCADE_COUNT];
 
+    // What each frame's depth texture holds, one per frame.
+    frame_cascade_cache* frame_caches;
+    // The frame the cascades were last prepared for. If not the current one, all are rendered.
+    u64 prepared_frame_number;
+
     // Track instance updates per frame
     b8* instance_updated;
     u32 instance_count;
@@ -85,9 +122,37 @@ b8 shadow_map_pass_create(struct rendergraph_pass* self, void* config) {
     self->attachment_populate = shadow_map_pass_attachment_populate;
     self->source_populate = shadow_map_pass_source_populate;
 
+    // Only uses its own shader and instances, so may be recorded alongside other passes.
+    self->parallel_recording = true;
+
+    return true;
+}
+
+static b8 local_block_verify(shader* s, b8 layered) {
+    const shader_local_block_member members[] = {
+        {"model", offsetof(shadow_map_local_block, model), sizeof(mat4)},
+        {layered ? "cascade_mask" : "cascade_index", offsetof(shadow_map_local_block, cascade), sizeof(u32)}};
+    if (!shader_system_local_block_verify(s, 2, members, sizeof(shadow_map_local_block))) {
+        KWARN("Shader '%s' locals don't match the shadowmap local block. Falling back to setting them individually.", s->name);
+        return false;
+    }
     return true;
 }
 
+// Applies the locals of a draw with the current shader, pushing them in one go when the layout allows.
+static void locals_apply(const shadow_map_shader_locations* locations, b8 layered, const mat4* model, u32 cascade, struct frame_data* p_frame_data) {
+    if (locations->local_block_valid) {
+        shadow_map_local_block block = {*model, cascade};
+        shader_system_local_block_push(&block, sizeof(shadow_map_local_block));
+        return;
+    }
+
+    shader_system_bind_local();
+    shader_system_uniform_set_by_location(locations->model_location, model);
+    shader_system_uniform_set_by_location(layered ? locations->cascade_mask_location : locations->cascade_index_location, &cascade);
+    shader_system_apply_local(p_frame_data);
+}
+
 b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     if (!self) {
         return false;
@@ -95,10 +160,16 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
 
     shadow_map_pass_internal_data* internal_data = self->internal_data;
 
+    // Render all cascades at once if possible, so the cost of the pass doesn't scale with their number.
+    internal_data->layered = renderer_multiview_supported(MAX_CASCADE_COUNT);
+    KINFO("Shadowmap pass renders %s.", internal_data->layered ? "all cascades in a single pass" : "one pass per cascade");
+
     // Create the depth attachments, one per frame.
     u8 frame_count = renderer_window_attachment_count_get();
 
     internal_data->depth_textures = kallocate(sizeof(texture) * frame_count, MEMORY_TAG_RENDERER);
+    internal_data->frame_caches = kallocate(sizeof(frame_cascade_cache) * frame_count, MEMORY_TAG_RENDERER);
+    internal_data->prepared_frame_number = INVALID_ID_U64;
 
     for (u8 i = 0; i < frame_count; ++i) {
         // Depth
@@ -125,6 +196,7 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     shadowmap_pass_config.target.attachment_count = 1;
     shadowmap_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * shadowmap_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
     shadowmap_pass_config.render_target_count = frame_count;
+    shadowmap_pass_config.view_count = internal_data->layered ? MAX_CASCADE_COUNT : 0;
 
     // Depth attachment.
     render_target_attachment_config* shadowpass_target_depth = &shadowmap_pass_config.target.attachments[0];
@@ -140,7 +212,7 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     }
 
     // Load shadowmap shader. Attempt to to get the already-loaded shader if it doesn't exist.
-    const char* shadowmap_shader_name = "Shader.Shadowmap";
+    const char* shadowmap_shader_name = internal_data->layered ? "Shader.ShadowmapLayered" : "Shader.Shadowmap";
     internal_data->s = shader_system_get(shadowmap_shader_name);
     if (!internal_data->s) {
         KTRACE("Shader '%s' doesn't exist. Attempting to load it...", shadowmap_shader_name);
@@ -164,11 +236,16 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     internal_data->locations.projections_location = shader_system_uniform_location(internal_data->s, "projections");
     internal_data->locations.views_location = shader_system_uniform_location(internal_data->s, "views");
     internal_data->locations.model_location = shader_system_uniform_location(internal_data->s, "model");
-    internal_data->locations.cascade_index_location = shader_system_uniform_location(internal_data->s, "cascade_index");
+    if (internal_data->layered) {
+        internal_data->locations.cascade_mask_location = shader_system_uniform_location(internal_data->s, "cascade_mask");
+    } else {
+        internal_data->locations.cascade_index_location = shader_system_uniform_location(internal_data->s, "cascade_index");
+    }
     internal_data->locations.colour_map_location = shader_system_uniform_location(internal_data->s, "colour_map");
+    internal_data->locations.local_block_valid = local_block_verify(internal_data->s, internal_data->layered);
 
     // Terrain shadowmap shader.
-    const char* terrain_shadowmap_shader_name = "Shader.ShadowmapTerrain";
+    const char* terrain_shadowmap_shader_name = internal_data->layered ? "Shader.ShadowmapTerrainLayered" : "Shader.ShadowmapTerrain";
     internal_data->ts = shader_system_get(terrain_shadowmap_shader_name);
     if (!internal_data->ts) {
         KTRACE("Shader '%s' doesn't exist. Attempting to load it...", terrain_shadowmap_shader_name);
@@ -193,12 +270,39 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     internal_data->terrain_locations.projections_location = shader_system_uniform_location(internal_data->ts, "projections");
     internal_data->terrain_locations.views_location = shader_system_uniform_location(internal_data->ts, "views");
     internal_data->terrain_locations.model_location = shader_system_uniform_location(internal_data->ts, "model");
-    internal_data->terrain_locations.cascade_index_location = shader_system_uniform_location(internal_data->ts, "cascade_index");
+    if (internal_data->layered) {
+        internal_data->terrain_locations.cascade_mask_location = shader_system_uniform_location(internal_data->ts, "cascade_mask");
+    } else {
+        internal_data->terrain_locations.cascade_index_location = shader_system_uniform_location(internal_data->ts, "cascade_index");
+    }
     internal_data->terrain_locations.colour_map_location = shader_system_uniform_location(internal_data->ts, "colour_map");
+    internal_data->terrain_locations.local_block_valid = local_block_verify(internal_data->ts, internal_data->layered);
 
     return true;
 }
 
+static void depth_target_create(struct rendergraph_pass* self, texture* depth_texture, u16 layer_index, render_target* target) {
+    shadow_map_pass_internal_data* internal_data = self->internal_data;
+    target->attachment_count = 1;
+    target->attachments = kallocate(sizeof(render_target_attachment) * target->attachment_count, MEMORY_TAG_ARRAY);
+    target->attachments[0].type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    target->attachments[0].source = RENDER_TARGET_ATTACHMENT_SOURCE_SELF;
+    target->attachments[0].texture = depth_texture;
+    target->attachments[0].present_after = true;
+    target->attachments[0].load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    target->attachments[0].store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+
+    // Create the underlying render target.
+    renderer_render_target_create(
+        target->attachment_count,
+        target->attachments,
+        &self->pass,
+        internal_data->config.resolution,
+        internal_data->config.resolution,
+        layer_index,
+        target);
+}
+
 b8 shadow_map_pass_load_resources(struct rendergraph_pass* self) {
     if (!self) {
         return false;
@@ -282,35 +386,439 @@ b8 shadow_map_pass_load_resources(struct rendergraph_pass* self) {
     // Create the depth attachments, one per frame.
     u8 frame_count = renderer_window_attachment_count_get();
     // Renderpass attachments.
-    for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
-        cascade_resources* cascade = &internal_data->cascades[i];
-        // Targets per frame
-        cascade->targets = kallocate(sizeof(render_target) * frame_count, MEMORY_TAG_ARRAY);
+    if (internal_data->layered) {
+        // A single target per frame renders all layers.
+        internal_data->layered_targets = kallocate(sizeof(render_target) * frame_count, MEMORY_TAG_ARRAY);
         for (u32 f = 0; f < frame_count; ++f) {
-            // One render target per pass
-            render_target* target = &cascade->targets[f];
-            target->attachment_count = 1;
-            // 2 attachments per target, (colour, depth)
-            target->attachments = kallocate(sizeof(render_target_attachment) * target->attachment_count, MEMORY_TAG_ARRAY);
-            target->attachments[0].type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
-            target->attachments[0].source = RENDER_TARGET_ATTACHMENT_SOURCE_SELF;
-            target->attachments[0].texture = &internal_data->depth_textures[f];
-            target->attachments[0].present_after = true;
-            target->attachments[0].load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
-            target->attachments[0].store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
-
-            // Create the underlying render target.
-            renderer_render_target_create(
-                target->attachment_count,
-                target->attachments,
-                &self->pass,
-                internal_data->config.resolution,
-                internal_data->config.resolution,
-                i,
-                target);
+            depth_target_create(self, &internal_data->depth_textures[f], 0, &internal_data->layered_targets[f]);
+        }
+    } else {
+        for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
+            cascade_resources* cascade = &internal_data->cascades[i];
+            // Targets per frame
+            cascade->targets = kallocate(sizeof(render_target) * frame_count, MEMORY_TAG_ARRAY);
+            for (u32 f = 0; f < frame_count; ++f) {
+                // One render target per pass
+                depth_target_create(self, &internal_data->depth_textures[f], i, &cascade->targets[f]);
+            }
+        }
+    }
+
+    return true;
+}
+
+// Verify enough instance resources for this frame.
+// This is done by taking the highest material instance id
+// and using that for the count. This will ensure enough resources
+// are present for the frame, and also allows for a quick mapping to
+// a shader instance for texture binding, as well as keeping track
+// of instance updates per frame.
+static void instance_resources_ensure(shadow_map_pass_internal_data* internal_data, u32 geometry_count, const geometry_draw_record* geometries) {
+    u32 highest_id = 0;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        material* m = geometries[i].geometry->material;
+        if (m && m->internal_id > highest_id) {
+            // NOTE: +1 to account for the first id being taken by the default instance.
+            highest_id = m->internal_id + 1;
+        }
+    }
+    // Terrains will be slightly different since a texture sample isn't
+    // really needed since terrains are never transparent. Therefore, only
+    // one more instance is needed, which can use the same default white
+    // texture as a sample.
+    highest_id++;
+
+    if (highest_id > internal_data->instance_count) {
+        if (internal_data->instances) {
+            darray_destroy(internal_data->instances);
+        }
+        internal_data->instances = darray_reserve(shadow_shader_instance_data, highest_id + 1);
+        // Get more resources if needed, starting at the previous high point.
+        for (u32 i = internal_data->instance_count; i < highest_id; i++) {
+            u32 instance_id;
+
+            // Use the same map for all.
+            texture_map* maps[1] = {&internal_data->default_colour_map};
+            shader* s = internal_data->s;
+            u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
+            shader_instance_resource_config instance_resource_config = {0};
+            // Map count for this type is known.
+            shader_instance_uniform_texture_config colour_texture = {0};
+            colour_texture.uniform_location = atlas_location;
+            colour_texture.texture_map_count = 1;
+            colour_texture.texture_maps = maps;
+
+            instance_resource_config.uniform_config_count = 1;
+            instance_resource_config.uniform_configs = &colour_texture;
+            renderer_shader_instance_resources_acquire(internal_data->s, &instance_resource_config, &instance_id);
+
+            shadow_shader_instance_data* instance = &internal_data->instances[instance_id];
+            instance->render_frame_number = INVALID_ID_U64;
+            instance->render_draw_index = INVALID_ID_U8;
+        }
+        internal_data->instance_count = highest_id;
+    }
+}
+
+// Binds and applies the instance of the shadowmap shader used to draw the given static geometry.
+static b8 static_geometry_instance_apply(shadow_map_pass_internal_data* internal_data, geometry_render_data* g, struct frame_data* p_frame_data) {
+    u32 bind_id = INVALID_ID;
+    texture_map* bind_map = 0;
+    u64* render_number = 0;
+    u8* draw_index = 0;
+
+    // Decide what bindings to use.
+    if (g->material && g->material->maps) {
+        // Use current material's internal id.
+        // NOTE: +1 to account for the first id being taken by the default instance.
+        bind_id = g->material->internal_id + 1;
+        // Use the current material's diffuse/albedo map.
+        bind_map = &g->material->maps[0];
+        // NOTE: can't update the _material's_ frame number/draw index because it still needs to be
+        // used for the actual scene render.
+        shadow_shader_instance_data* instance = &internal_data->instances[g->material->internal_id + 1];
+        render_number = &instance->render_frame_number;
+        draw_index = &instance->render_draw_index;
+    } else {
+        // Use the default instance.
+        bind_id = internal_data->default_instance_id;
+        // Use the default colour map.
+        bind_map = &internal_data->default_colour_map;
+        render_number = &internal_data->default_instance_frame_number;
+        draw_index = &internal_data->default_instance_draw_index;
+    }
+
+    // NOTE: When rendering one pass per cascade, this shader is used 4 times per frame, which means this
+    // needs to be updated 4 times, which it can't be, because the descriptors will have already been updated.
+    // Rendering all cascades in a single pass avoids this, where supported.
+    b8 needs_update = *render_number != p_frame_data->renderer_frame_number || *draw_index != p_frame_data->draw_index;
+
+    // Use the bindings.
+    shader_system_bind_instance(bind_id);
+    if (!shader_system_uniform_set_by_location(internal_data->locations.colour_map_location, bind_map)) {
+        KERROR("Failed to apply shadowmap color_map uniform to static geometry.");
+        return false;
+    }
+    shader_system_apply_instance(needs_update, p_frame_data);
+
+    // Sync the frame number and draw index.
+    *render_number = p_frame_data->renderer_frame_number;
+    *draw_index = p_frame_data->draw_index;
+    return true;
+}
+
+// Binds and applies the instance of the terrain shadowmap shader used to draw all terrains.
+static b8 terrain_instance_apply(shadow_map_pass_internal_data* internal_data, struct frame_data* p_frame_data) {
+    // Just draw these using the default instance and texture map.
+    texture_map* bind_map = &internal_data->default_terrain_colour_map;
+    u64* render_number = &internal_data->terrain_instance_frame_number;
+    u8* draw_index = &internal_data->terrain_instance_draw_index;
+
+    b8 needs_update = *render_number != p_frame_data->renderer_frame_number || *draw_index != p_frame_data->draw_index;
+
+    shader_system_bind_instance(internal_data->terrain_instance_id);
+    if (!shader_system_uniform_set_by_location(internal_data->terrain_locations.colour_map_location, bind_map)) {
+        KERROR("Failed to apply shadowmap color_map uniform to terrain geometry.");
+        return false;
+    }
+    shader_system_apply_instance(needs_update, p_frame_data);
+
+    // Sync the frame number and draw index.
+    *render_number = p_frame_data->renderer_frame_number;
+    *draw_index = p_frame_data->draw_index;
+    return true;
+}
+
+// Sets the projection and view of every cascade on the currently used shader's globals.
+static b8 cascade_globals_set(const shadow_map_shader_locations* locations, const shadow_map_pass_extended_data* ext_data) {
+    for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
+        if (!shader_system_uniform_set_by_location_arrayed(locations->projections_location, i, &ext_data->cascades[i].projection)) {
+            KERROR("Failed to apply shadowmap projection uniform.");
+            return false;
+        }
+        if (!shader_system_uniform_set_by_location_arrayed(locations->views_location, i, &ext_data->cascades[i].view)) {
+            KERROR("Failed to apply shadowmap view uniform.");
+            return false;
+        }
+    }
+    return true;
+}
+
+static u64 hash_combine(u64 hash, u64 value) {
+    hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static u64 hash_mat4(u64 hash, const mat4* m) {
+    const u32* bits = (const u32*)m->data;
+    for (u32 i = 0; i < 16; i += 2) {
+        hash = hash_combine(hash, ((u64)bits[i] << 32) | bits[i + 1]);
+    }
+    return hash;
+}
+
+// Per-geometry hashes are summed, so the order in which geometries are listed doesn't matter.
+static u64 draw_records_hash(u32 count, const geometry_draw_record* records, const mat4* models) {
+    u64 sum = count;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_draw_record* r = &records[i];
+        u64 hash = (u64)r->geometry;
+        hash = hash_combine(hash, ((u64)r->object_index << 32) | ((u64)r->lod << 1) | r->winding_inverted);
+        hash = hash_combine(hash, r->geometry->vertex_buffer_offset);
+        hash = hash_combine(hash, r->geometry->index_buffer_offset);
+        hash = hash_combine(hash, ((u64)r->first_index << 32) | r->index_count);
+        hash = hash_combine(hash, (u64)r->geometry->material);
+        if (models) {
+            hash = hash_mat4(hash, &models[r->object_index]);
+        }
+        sum += hash;
+    }
+    return sum;
+}
+
+static u64 geometries_hash(u32 count, const geometry_render_data* geometries) {
+    u64 sum = count;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_render_data* g = &geometries[i];
+        u64 hash = g->unique_id;
+        hash = hash_combine(hash, ((u64)g->object_index << 32) | g->index_count);
+        hash = hash_combine(hash, g->vertex_buffer_offset);
+        hash = hash_combine(hash, g->index_buffer_offset);
+        hash = hash_combine(hash, ((u64)g->vertex_count << 32) | g->winding_inverted);
+        hash = hash_combine(hash, (u64)g->material);
+        hash = hash_mat4(hash, &g->model);
+        sum += hash;
+    }
+    return sum;
+}
+
+// Far cascades cover more of the scene at less detail, so changes to them are picked up less often.
+static u32 cascade_update_interval(u32 cascade_index) {
+    return cascade_index < 2 ? 1 : 1u << (cascade_index - 1);
+}
+
+void shadow_map_pass_cascades_prepare(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return;
+    }
+
+    shadow_map_pass_internal_data* internal_data = self->internal_data;
+    shadow_map_pass_extended_data* ext_data = self->pass_data.ext_data;
+    frame_cascade_cache* frame_cache = &internal_data->frame_caches[p_frame_data->render_target_index];
+
+    b8 any_needs_render = false;
+    u64 content_hashes[MAX_CASCADE_COUNT];
+    for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+        shadow_map_cascade_data* cascade = &ext_data->cascades[c];
+        cascade_cache* cached = &frame_cache->cascades[c];
+
+        u64 hash = hash_mat4(0, &cascade->view);
+        hash = hash_mat4(hash, &cascade->projection);
+        hash = hash_combine(hash, draw_records_hash(cascade->geometry_count, cascade->geometries, ext_data->models));
+        hash = hash_combine(hash, geometries_hash(cascade->terrain_geometry_count, cascade->terrain_geometries));
+        content_hashes[c] = hash;
+
+        b8 changed = !cached->valid || cached->content_hash != hash;
+        b8 due = !cached->valid || ((p_frame_data->renderer_frame_number + c) % cascade_update_interval(c)) == 0;
+        cascade->needs_render = changed && due;
+        any_needs_render |= cascade->needs_render;
+    }
+
+    for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+        shadow_map_cascade_data* cascade = &ext_data->cascades[c];
+        cascade_cache* cached = &frame_cache->cascades[c];
+
+        // All layers are rendered at once when layered, so if any is, all are.
+        if (internal_data->layered) {
+            cascade->needs_render = any_needs_render;
+        }
+
+        if (cascade->needs_render) {
+            cached->valid = true;
+            cached->view = cascade->view;
+            cached->projection = cascade->projection;
+            cached->content_hash = content_hashes[c];
+        } else {
+            // Keep what was rendered, and sample it as it was rendered.
+            cascade->view = cached->view;
+            cascade->projection = cached->projection;
         }
     }
 
+    internal_data->prepared_frame_number = p_frame_data->renderer_frame_number;
+}
+
+// A geometry to be drawn by a layered shadow pass, along with the cascades it is drawn into.
+// Static geometries are kept by draw record, and terrains by render data.
+typedef struct layered_geometry {
+    const geometry_draw_record* record;
+    geometry_render_data* data;
+    // Bit i is set if the geometry is drawn into cascade i.
+    u32 cascade_mask;
+} layered_geometry;
+
+static b8 layered_record_matches(const geometry_draw_record* a, const geometry_draw_record* b) {
+    return a->geometry == b->geometry && a->object_index == b->object_index && a->lod == b->lod &&
+           a->first_index == b->first_index && a->index_count == b->index_count;
+}
+
+static b8 layered_geometry_matches(const geometry_render_data* a, const geometry_render_data* b) {
+    return a->unique_id == b->unique_id &&
+           a->object_index == b->object_index &&
+           a->vertex_buffer_offset == b->vertex_buffer_offset &&
+           a->index_buffer_offset == b->index_buffer_offset &&
+           a->index_count == b->index_count;
+}
+
+// Merges the static (or terrain) geometries of all cascades into a single list, so that each geometry
+// is drawn once for every cascade it is in. The list is allocated from the frame allocator.
+static layered_geometry* layered_geometries_merge(const shadow_map_pass_extended_data* ext_data, b8 terrain, struct frame_data* p_frame_data, u32* out_count) {
+    *out_count = 0;
+    u32 total_count = 0;
+    for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+        total_count += terrain ? ext_data->cascades[c].terrain_geometry_count : ext_data->cascades[c].geometry_count;
+    }
+    if (!total_count) {
+        return 0;
+    }
+
+    layered_geometry* merged = p_frame_data->allocator.allocate(sizeof(layered_geometry) * total_count);
+
+    // Geometries already in the list, found by open addressing. Kept at most half full.
+    u32 capacity = 16;
+    while (capacity < total_count * 2) {
+        capacity <<= 1;
+    }
+    u32* slots = p_frame_data->allocator.allocate(sizeof(u32) * capacity);
+    kset_memory(slots, 0xFF, sizeof(u32) * capacity);
+
+    for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+        const shadow_map_cascade_data* cascade = &ext_data->cascades[c];
+        u32 count = terrain ? cascade->terrain_geometry_count : cascade->geometry_count;
+        for (u32 i = 0; i < count; ++i) {
+            const geometry_draw_record* r = terrain ? 0 : &cascade->geometries[i];
+            geometry_render_data* g = terrain ? &cascade->terrain_geometries[i] : 0;
+            u64 hash;
+            if (r) {
+                hash = ((u64)r->geometry * 0x9E3779B97F4A7C15ull) ^ (((u64)r->object_index << 32) | r->lod);
+            } else {
+                hash = (g->unique_id * 0x9E3779B97F4A7C15ull) ^ (((u64)g->object_index << 32) | g->index_count) ^ (g->vertex_buffer_offset * 0xC2B2AE3D27D4EB4Full) ^ g->index_buffer_offset;
+            }
+            hash ^= hash >> 31;
+            u32 slot = (u32)hash & (capacity - 1);
+            while (slots[slot] != INVALID_ID && !(r ? layered_record_matches(merged[slots[slot]].record, r) : layered_geometry_matches(merged[slots[slot]].data, g))) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (slots[slot] == INVALID_ID) {
+                slots[slot] = *out_count;
+                merged[*out_count].record = r;
+                merged[*out_count].data = g;
+                merged[*out_count].cascade_mask = 0;
+                (*out_count)++;
+            }
+            merged[slots[slot]].cascade_mask |= 1u << c;
+        }
+    }
+
+    return merged;
+}
+
+// Renders all cascades in a single pass, each into its own layer of the depth texture. Each geometry
+// is drawn once, with a mask of the cascades it appears in.
+static b8 shadow_map_pass_execute_layered(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    shadow_map_pass_internal_data* internal_data = self->internal_data;
+    shadow_map_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    u32 geometry_count = 0;
+    layered_geometry* geometries = layered_geometries_merge(ext_data, false, p_frame_data, &geometry_count);
+    u32 terrain_geometry_count = 0;
+    layered_geometry* terrain_geometries = layered_geometries_merge(ext_data, true, p_frame_data, &terrain_geometry_count);
+
+    // Every material drawn is in at least one cascade's list.
+    for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+        instance_resources_ensure(internal_data, ext_data->cascades[c].geometry_count, ext_data->cascades[c].geometries);
+    }
+
+    if (!renderer_renderpass_begin(&self->pass, &internal_data->layered_targets[p_frame_data->render_target_index])) {
+        KERROR("Shadowmap pass failed to start.");
+        return false;
+    }
+
+    // Use the standard shadowmap shader.
+    shader_system_use_by_id(internal_data->s->id);
+
+    // Apply globals, once for all cascades.
+    renderer_shader_bind_globals(internal_data->s);
+    if (!cascade_globals_set(&internal_data->locations, ext_data)) {
+        return false;
+    }
+    shader_system_apply_global(true, p_frame_data);
+
+    // Static geometries. Using the shader selected the standard vertex format.
+    geometry_vertex_format current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        geometry_render_data data;
+        renderer_geometry_draw_record_resolve(geometries[i].record, ext_data->models, &data);
+        geometry_render_data* g = &data;
+
+        // Switch vertex formats if needed.
+        if (g->vertex_format != current_vertex_format) {
+            if (!shader_system_vertex_format_set(g->vertex_format)) {
+                KWARN("Failed to set vertex format for shadowmap static geometry. Skipping draw.");
+                continue;
+            }
+            current_vertex_format = g->vertex_format;
+        }
+
+        if (!static_geometry_instance_apply(internal_data, g, p_frame_data)) {
+            return false;
+        }
+
+        // Apply the locals
+        locals_apply(&internal_data->locations, true, &g->model, geometries[i].cascade_mask, p_frame_data);
+
+        // Invert if needed
+        if (g->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
+        }
+
+        // Draw it, into every cascade at once.
+        renderer_geometry_draw(g);
+
+        // Change back if needed
+        if (g->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
+        }
+    }
+
+    // Terrain - use the special terrain shadowmap shader.
+    shader_system_use_by_id(internal_data->ts->id);
+
+    renderer_shader_bind_globals(internal_data->ts);
+    if (!cascade_globals_set(&internal_data->terrain_locations, ext_data)) {
+        return false;
+    }
+    shader_system_apply_global(true, p_frame_data);
+
+    for (u32 i = 0; i < terrain_geometry_count; ++i) {
+        geometry_render_data* terrain = terrain_geometries[i].data;
+
+        if (!terrain_instance_apply(internal_data, p_frame_data)) {
+            return false;
+        }
+
+        // Apply the locals
+        locals_apply(&internal_data->terrain_locations, true, &terrain->model, terrain_geometries[i].cascade_mask, p_frame_data);
+
+        // Draw it.
+        renderer_geometry_draw(terrain);
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("Shadowmap pass failed to end.");
+        return false;
+    }
+
     return true;
 }
 
@@ -325,12 +833,29 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
     // Bind the internal viewport - do not use one provided in pass data.
     renderer_active_viewport_set(&internal_data->camera_viewport);
 
+    // Without preparation, nothing is known about what the depth textures hold, so render all cascades.
+    if (internal_data->prepared_frame_number != p_frame_data->renderer_frame_number) {
+        for (u32 p = 0; p < MAX_CASCADE_COUNT; ++p) {
+            ext_data->cascades[p].needs_render = true;
+            internal_data->frame_caches[p_frame_data->render_target_index].cascades[p].valid = false;
+        }
+    }
+
+    if (internal_data->layered) {
+        // All layers are rendered at once, or not at all.
+        if (!ext_data->cascades[0].needs_render) {
+            return true;
+        }
+        return shadow_map_pass_execute_layered(self, p_frame_data);
+    }
+
+    // Globals are applied by the first cascade rendered.
+    b8 globals_applied = false;
     for (u32 p = 0; p < MAX_CASCADE_COUNT; ++p) {
         shadow_map_cascade_data* cascade = &ext_data->cascades[p];
-        /* if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
-            KERROR("Shadowmap pass failed to start.");
-            return false;
-        } */
+        if (!cascade->needs_render) {
+            continue;
+        }
 
         if (!renderer_renderpass_begin(&self->pass, &internal_data->cascades[p].targets[p_frame_data->render_target_index])) {
             KERROR("Shadowmap pass failed to start.");
@@ -341,18 +866,12 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         shader_system_use_by_id(internal_data->s->id);
 
         // Apply globals, once per cascade.
-        b8 needs_update = p == 0;
+        b8 needs_update = !globals_applied;
+        globals_applied = true;
         if (needs_update) {
             renderer_shader_bind_globals(internal_data->s);
-            for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
-                if (!shader_system_uniform_set_by_location_arrayed(internal_data->locations.projections_location, i, &ext_data->cascades[i].projection)) {
-                    KERROR("Failed to apply shadowmap projection uniform.");
-                    return false;
-                }
-                if (!shader_system_uniform_set_by_location_arrayed(internal_data->locations.views_location, i, &ext_data->cascades[i].view)) {
-                    KERROR("Failed to apply shadowmap view uniform.");
-                    return false;
-                }
+            if (!cascade_globals_set(&internal_data->locations, ext_data)) {
+                return false;
             }
         }
         shader_system_apply_global(needs_update, p_frame_data);
@@ -360,117 +879,33 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         u32 geometry_count = cascade->geometry_count;
         u32 terrain_geometry_count = cascade->terrain_geometry_count;
 
-        // Verify enough instance resources for this frame.
-        // This is done by taking the highest material instance id
-        // and using that for the count. This will ensure enough resources
-        // are present for the frame, and also allows for a quick mapping to
-        // a shader instance for texture binding, as well as keeping track
-        // of instance updates per frame.
-        u32 highest_id = 0;
-        for (u32 i = 0; i < geometry_count; ++i) {
-            material* m = cascade->geometries[i].material;
-            if (m->internal_id > highest_id) {
-                // NOTE: +1 to account for the first id being taken by the default instance.
-                highest_id = m->internal_id + 1;
-            }
-        }
-        // Terrains will be slightly different since a texture sample isn't
-        // really needed since terrains are never transparent. Therefore, only
-        // one more instance is needed, which can use the same default white
-        // texture as a sample.
-        highest_id++;
-
-        if (highest_id > internal_data->instance_count) {
-            if (internal_data->instances) {
-                darray_destroy(internal_data->instances);
-            }
-            internal_data->instances = darray_reserve(shadow_shader_instance_data, highest_id + 1);
-            // Get more resources if needed, starting at the previous high point.
-            for (u32 i = internal_data->instance_count; i < highest_id; i++) {
-                u32 instance_id;
-
-                // Use the same map for all.
-                texture_map* maps[1] = {&internal_data->default_colour_map};
-                shader* s = internal_data->s;
-                u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
-                shader_instance_resource_config instance_resource_config = {0};
-                // Map count for this type is known.
-                shader_instance_uniform_texture_config colour_texture = {0};
-                colour_texture.uniform_location = atlas_location;
-                colour_texture.texture_map_count = 1;
-                colour_texture.texture_maps = maps;
-
-                instance_resource_config.uniform_config_count = 1;
-                instance_resource_config.uniform_configs = &colour_texture;
-                renderer_shader_instance_resources_acquire(internal_data->s, &instance_resource_config, &instance_id);
-
-                shadow_shader_instance_data* instance = &internal_data->instances[instance_id];
-                instance->render_frame_number = INVALID_ID_U64;
-                instance->render_draw_index = INVALID_ID_U8;
-            }
-            internal_data->instance_count = highest_id;
-        }
+        instance_resources_ensure(internal_data, geometry_count, cascade->geometries);
 
-        // Static geometries.
+        // Static geometries. Using the shader selected the standard vertex format.
+        geometry_vertex_format current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
         for (u32 i = 0; i < geometry_count; ++i) {
-            geometry_render_data* g = &cascade->geometries[i];
-
-            u32 bind_id = INVALID_ID;
-            texture_map* bind_map = 0;
-            u64* render_number = 0;
-            u8* draw_index = 0;
-
-            // Decide what bindings to use.
-            if (g->material && g->material->maps) {
-                // Use current material's internal id.
-                // NOTE: +1 to account for the first id being taken by the default instance.
-                bind_id = g->material->internal_id + 1;
-                // Use the current material's diffuse/albedo map.
-                bind_map = &g->material->maps[0];
-                // NOTE: can't update the _material's_ frame number/draw index because it still needs to be
-                // used for the actual scene render.
-                shadow_shader_instance_data* instance = &internal_data->instances[g->material->internal_id + 1];
-                render_number = &instance->render_frame_number;
-                draw_index = &instance->render_draw_index;
-            } else {
-                // Use the default instance.
-                bind_id = internal_data->default_instance_id;
-                // Use the default colour map.
-                bind_map = &internal_data->default_colour_map;
-                render_number = &internal_data->default_instance_frame_number;
-                draw_index = &internal_data->default_instance_draw_index;
+            geometry_render_data data;
+            renderer_geometry_draw_record_resolve(&cascade->geometries[i], ext_data->models, &data);
+            geometry_render_data* g = &data;
+
+            // Switch vertex formats if needed.
+            if (g->vertex_format != current_vertex_format) {
+                if (!shader_system_vertex_format_set(g->vertex_format)) {
+                    KWARN("Failed to set vertex format for shadowmap static geometry. Skipping draw.");
+                    continue;
+                }
+                current_vertex_format = g->vertex_format;
             }
 
-            // LEFTOFF: This shader is used 4 times per frame, which means this needs to be updated 4 times,
-            // which it can't be, because the descriptors will have already been updated.
-            // This means doing this in a single pass is now a requirement, unless I can somehow figure out a
-            // way to make this work without duplicating descriptors.
-            // This will also be needed to move the globals below back to where they should be.
-            // A short-term solution could be to array the matrices and index them by pass number, which may be
-            // the way to go before refactoring all of this. Then these could be updated once at the beginning.
-            // Bollocks.
-            b8 needs_update = *render_number != p_frame_data->renderer_frame_number || *draw_index != p_frame_data->draw_index;
-
-            // Use the bindings.
-            shader_system_bind_instance(bind_id);
-            if (!shader_system_uniform_set_by_location(internal_data->locations.colour_map_location, bind_map)) {
-                KERROR("Failed to apply shadowmap color_map uniform to static geometry.");
+            if (!static_geometry_instance_apply(internal_data, g, p_frame_data)) {
                 return false;
             }
-            shader_system_apply_instance(needs_update, p_frame_data);
-
-            // Sync the frame number and draw index.
-            *render_number = p_frame_data->renderer_frame_number;
-            *draw_index = p_frame_data->draw_index;
 
             // Apply the locals
-            shader_system_bind_local();
-            shader_system_uniform_set_by_location(internal_data->locations.model_location, &g->model);
-            shader_system_uniform_set_by_location(internal_data->locations.cascade_index_location, &p);
-            shader_system_apply_local(p_frame_data);
+            locals_apply(&internal_data->locations, false, &g->model, p, p_frame_data);
 
             // Invert if needed
-            if (cascade->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
             }
 
@@ -478,7 +913,7 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
             renderer_geometry_draw(g);
 
             // Change back if needed
-            if (cascade->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
             }
         }
@@ -489,16 +924,9 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         // Apply globals, once per cascade.
         renderer_shader_bind_globals(internal_data->ts);
         if (needs_update) {
-            for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
-                // NOTE: using the internal projection matrix, not one passed in.
-                if (!shader_system_uniform_set_by_location_arrayed(internal_data->terrain_locations.projections_location, i, &ext_data->cascades[i].projection)) {
-                    KERROR("Failed to apply terrain shadowmap projection uniform.");
-                    return false;
-                }
-                if (!shader_system_uniform_set_by_location_arrayed(internal_data->terrain_locations.views_location, i, &ext_data->cascades[i].view)) {
-                    KERROR("Failed to apply terrain shadowmap view uniform.");
-                    return false;
-                }
+            // NOTE: using the internal projection matrix, not one passed in.
+            if (!cascade_globals_set(&internal_data->terrain_locations, ext_data)) {
+                return false;
             }
         }
         shader_system_apply_global(needs_update, p_frame_data);
@@ -506,29 +934,12 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         for (u32 i = 0; i < terrain_geometry_count; ++i) {
             geometry_render_data* terrain = &cascade->terrain_geometries[i];
 
-            // Just draw these using the default instance and texture map.
-            texture_map* bind_map = &internal_data->default_terrain_colour_map;
-            u64* render_number = &internal_data->terrain_instance_frame_number;
-            u8* draw_index = &internal_data->terrain_instance_draw_index;
-
-            b8 needs_update = *render_number != p_frame_data->renderer_frame_number || *draw_index != p_frame_data->draw_index;
-
-            shader_system_bind_instance(internal_data->terrain_instance_id);
-            if (!shader_system_uniform_set_by_location(internal_data->terrain_locations.colour_map_location, bind_map)) {
-                KERROR("Failed to apply shadowmap color_map uniform to terrain geometry.");
+            if (!terrain_instance_apply(internal_data, p_frame_data)) {
                 return false;
             }
-            shader_system_apply_instance(needs_update, p_frame_data);
-
-            // Sync the frame number and draw index.
-            *render_number = p_frame_data->renderer_frame_number;
-            *draw_index = p_frame_data->draw_index;
 
             // Apply the locals
-            shader_system_bind_local();
-            shader_system_uniform_set_by_location(internal_data->terrain_locations.model_location, &terrain->model);
-            shader_system_uniform_set_by_location(internal_data->terrain_locations.cascade_index_location, &p);
-            shader_system_apply_local(p_frame_data);
+            locals_apply(&internal_data->terrain_locations, false, &terrain->model, p, p_frame_data);
 
             // Draw it.
             renderer_geometry_draw(terrain);
@@ -553,8 +964,17 @@ void shadow_map_pass_destroy(struct rendergraph_pass* self) {
             u8 attachment_count = renderer_window_attachment_count_get();
 
             // Renderpass attachments.
+            if (internal_data->layered_targets) {
+                for (u32 f = 0; f < attachment_count; ++f) {
+                    renderer_render_target_destroy(&internal_data->layered_targets[f], true);
+                }
+                kfree(internal_data->layered_targets, sizeof(render_target) * attachment_count, MEMORY_TAG_ARRAY);
+            }
             for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
                 cascade_resources* cascade = &internal_data->cascades[i];
+                if (!cascade->targets) {
+                    continue;
+                }
                 // Targets per frame
                 for (u32 f = 0; f < attachment_count; ++f) {
                     // One render target per pass
@@ -570,6 +990,7 @@ void shadow_map_pass_destroy(struct rendergraph_pass* self) {
                 renderer_texture_destroy(&internal_data->depth_textures[i]);
             }
             kfree(internal_data->depth_textures, sizeof(texture*) * attachment_count, MEMORY_TAG_ARRAY);
+            kfree(internal_data->frame_caches, sizeof(frame_cascade_cache) * attachment_count, MEMORY_TAG_RENDERER);
 
             renderer_texture_map_resources_release(&internal_data->default_colour_map);
             renderer_texture_map_resources_release(&internal_data->default_terrain_colour_map);
@@ -21,11 +21,17 @@ typedef struct shadow_map_cascade_data {
     u32 terrain_geometry_count;
     struct geometry_render_data* terrain_geometries;
     u32 geometry_count;
-    struct geometry_render_data* geometries;
+    // Draw records of static geometries, whose models are looked up in the extended data's models.
+    struct geometry_draw_record* geometries;
+    // Set by shadow_map_pass_cascades_prepare. If false, the cascade keeps what an earlier
+    // frame rendered, and its view and projection are replaced by the ones used then.
+    b8 needs_render;
 } shadow_map_cascade_data;
 
 typedef struct shadow_map_pass_extended_data {
     struct directional_light* light;
+    // Persistent model matrices, indexed by the object index of each static geometry's draw record.
+    const mat4* models;
     // Per-cascade data.
     shadow_map_cascade_data cascades[MAX_CASCADE_COUNT];
 } shadow_map_pass_extended_data;
@@ -38,6 +44,18 @@ KAPI b8 shadow_map_pass_create(struct rendergraph_pass* self, void* config);
 KAPI b8 shadow_map_pass_initialize(struct rendergraph_pass* self);
 KAPI b8 shadow_map_pass_load_resources(struct rendergraph_pass* self);
 KAPI b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+
+/**
+ * @brief Decides which cascades need to be rendered this frame, once their views, projections
+ * and geometries are set. A cascade is only re-rendered if any of those changed since it was last
+ * rendered into this frame's depth texture, so a still light over a still scene costs nothing.
+ * Far cascades pick up changes less often. Cascades which are kept have their view and projection
+ * replaced by those they were rendered with, which should be used to sample them.
+ *
+ * @param self A pointer to the pass.
+ * @param p_frame_data A pointer to the current frame's data.
+ */
+KAPI void shadow_map_pass_cascades_prepare(struct rendergraph_pass* self, struct frame_data* p_frame_data);
 KAPI void shadow_map_pass_destroy(struct rendergraph_pass* self);
 
 KAPI b8 shadow_map_pass_source_populate(struct rendergraph_pass* self, struct rendergraph_source* source);
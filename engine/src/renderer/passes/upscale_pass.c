@@ -0,0 +1,237 @@
+#include "upscale_pass.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "renderer/viewport.h"
+#include "systems/geometry_system.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+typedef struct upscale_shader_locations {
+    u16 source_rect;
+    u16 source_texel;
+    u16 source;
+} upscale_shader_locations;
+
+// The shader instance sampling the scaled colour target of one window attachment.
+typedef struct upscale_pass_source {
+    // Its address is held by the shader instance, so never moves.
+    texture_map map;
+    u32 instance_id;
+    u64 render_frame_number;
+    u8 draw_index;
+} upscale_pass_source;
+
+typedef struct upscale_pass_internal_data {
+    struct rendergraph* graph;
+    shader* s;
+    upscale_shader_locations locations;
+    geometry* quad;
+
+    u32 source_count;
+    upscale_pass_source* sources;
+} upscale_pass_internal_data;
+
+b8 upscale_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self || !config) {
+        KERROR("upscale_pass_create requires a pointer to the pass and its configuration.");
+        return false;
+    }
+
+    upscale_pass_config* typed_config = config;
+    if (!typed_config->graph) {
+        KERROR("upscale_pass_create requires the graph it upscales.");
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(upscale_pass_internal_data), MEMORY_TAG_RENDERER);
+    upscale_pass_internal_data* internal_data = self->internal_data;
+    internal_data->graph = typed_config->graph;
+
+    // Only uses its own shader and instances, so may be recorded alongside other passes.
+    self->parallel_recording = true;
+
+    return true;
+}
+
+b8 upscale_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    upscale_pass_internal_data* internal_data = self->internal_data;
+
+    // Covers the whole of the window's colour attachment, so it is never loaded.
+    renderpass_config upscale_pass_config = {0};
+    upscale_pass_config.name = "Renderpass.Upscale";
+    upscale_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    upscale_pass_config.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
+    upscale_pass_config.depth = 1.0f;
+    upscale_pass_config.stencil = 0;
+    upscale_pass_config.target.attachment_count = 1;
+    upscale_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * upscale_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    upscale_pass_config.render_target_count = renderer_window_attachment_count_get();
+
+    render_target_attachment_config* upscale_target_colour = &upscale_pass_config.target.attachments[0];
+    upscale_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+    upscale_target_colour->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    upscale_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    upscale_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    upscale_target_colour->present_after = false;
+
+    if (!renderer_renderpass_create(&upscale_pass_config, &self->pass)) {
+        KERROR("Failed to create upscale renderpass.");
+        return false;
+    }
+
+    const char* shader_name = "Shader.Upscale";
+    resource config_resource;
+    if (!resource_system_load(shader_name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", shader_name);
+        return false;
+    }
+    b8 created = shader_system_create(&self->pass, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!created) {
+        KERROR("Failed to create shader '%s'.", shader_name);
+        return false;
+    }
+    internal_data->s = shader_system_get(shader_name);
+    internal_data->locations.source_rect = shader_system_uniform_location(internal_data->s, "source_rect");
+    internal_data->locations.source_texel = shader_system_uniform_location(internal_data->s, "source_texel");
+    internal_data->locations.source = shader_system_uniform_location(internal_data->s, "source");
+
+    // A unit quad, stretched over the viewport by the vertex shader.
+    geometry_config quad_config = {0};
+    generate_quad_2d("upscale_quad", 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, &quad_config);
+    internal_data->quad = geometry_system_acquire_from_config(quad_config, true);
+    geometry_system_config_dispose(&quad_config);
+    if (!internal_data->quad) {
+        KERROR("Failed to create upscale quad geometry.");
+        return false;
+    }
+
+    // The graph creates its scaled targets before initializing passes, so they can be bound now.
+    u32 source_count = internal_data->graph->scaled_colour_count;
+    if (!source_count) {
+        KERROR("Upscale pass '%s' is in a graph with no resolution_scaled passes.", self->name);
+        return false;
+    }
+    internal_data->sources = kallocate(sizeof(upscale_pass_source) * source_count, MEMORY_TAG_RENDERER);
+    for (u32 i = 0; i < source_count; ++i) {
+        upscale_pass_source* source = &internal_data->sources[i];
+        texture_map* map = &source->map;
+        map->texture = rendergraph_scaled_colour_get(internal_data->graph, i);
+        // Bilinear taps are combined into the bicubic filter, and clamped to the rendered region.
+        map->filter_magnify = map->filter_minify = TEXTURE_FILTER_MODE_LINEAR;
+        map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+        if (!renderer_texture_map_resources_acquire(map)) {
+            KERROR("Unable to acquire resources for upscale source '%s'.", map->texture->name);
+            return false;
+        }
+
+        texture_map* maps[1] = {map};
+        shader_instance_uniform_texture_config source_texture = {0};
+        source_texture.uniform_location = internal_data->locations.source;
+        source_texture.texture_map_count = 1;
+        source_texture.texture_maps = maps;
+        shader_instance_resource_config instance_resource_config = {0};
+        instance_resource_config.uniform_config_count = 1;
+        instance_resource_config.uniform_configs = &source_texture;
+        if (!renderer_shader_instance_resources_acquire(internal_data->s, &instance_resource_config, &source->instance_id)) {
+            KERROR("Unable to acquire shader resources for upscale source '%s'.", map->texture->name);
+            renderer_texture_map_resources_release(map);
+            return false;
+        }
+        source->render_frame_number = INVALID_ID_U64;
+        internal_data->source_count++;
+    }
+
+    return true;
+}
+
+b8 upscale_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    upscale_pass_internal_data* internal_data = self->internal_data;
+    viewport* vp = self->pass_data.vp;
+
+    renderer_active_viewport_set(vp);
+
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("upscale renderpass failed to start.");
+        return false;
+    }
+
+    upscale_pass_source* source = &internal_data->sources[p_frame_data->render_target_index % internal_data->source_count];
+    texture* t = source->map.texture;
+
+    // The scaled passes rendered this viewport into this region of their targets.
+    rect_2d scaled = rendergraph_scaled_rect(internal_data->graph, vp->rect);
+    f32 width = (f32)t->width;
+    f32 height = (f32)t->height;
+    vec4 source_rect = (vec4){scaled.x / width, scaled.y / height, scaled.width / width, scaled.height / height};
+    vec4 source_texel = (vec4){1.0f / width, 1.0f / height, width, height};
+
+    shader* s = internal_data->s;
+    shader_system_use_by_id(s->id);
+    shader_system_uniform_set_by_location(internal_data->locations.source_rect, &source_rect);
+    shader_system_uniform_set_by_location(internal_data->locations.source_texel, &source_texel);
+    shader_system_apply_global(true, p_frame_data);
+
+    shader_system_bind_instance(source->instance_id);
+    b8 needs_update = source->render_frame_number != p_frame_data->renderer_frame_number || source->draw_index != p_frame_data->draw_index;
+    if (needs_update) {
+        shader_system_uniform_set_by_location(internal_data->locations.source, &source->map);
+    }
+    shader_system_apply_instance(needs_update, p_frame_data);
+    source->render_frame_number = p_frame_data->renderer_frame_number;
+    source->draw_index = p_frame_data->draw_index;
+
+    geometry_draw_record quad_record = {0};
+    quad_record.geometry = internal_data->quad;
+    geometry_render_data quad_data;
+    renderer_geometry_draw_record_resolve(&quad_record, 0, &quad_data);
+    renderer_geometry_draw(&quad_data);
+
+    // HACK: This should be handled somehow, every frame, by the shader system.
+    s->render_frame_number = p_frame_data->renderer_frame_number;
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("upscale renderpass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void upscale_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            upscale_pass_internal_data* internal_data = self->internal_data;
+
+            if (internal_data->sources) {
+                for (u32 i = 0; i < internal_data->source_count; ++i) {
+                    upscale_pass_source* source = &internal_data->sources[i];
+                    renderer_shader_instance_resources_release(internal_data->s, source->instance_id);
+                    renderer_texture_map_resources_release(&source->map);
+                }
+                kfree(internal_data->sources, sizeof(upscale_pass_source) * internal_data->graph->scaled_colour_count, MEMORY_TAG_RENDERER);
+            }
+            if (internal_data->quad) {
+                geometry_system_release(internal_data->quad);
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(upscale_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
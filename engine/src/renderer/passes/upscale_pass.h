@@ -0,0 +1,26 @@
+#ifndef _UPSCALE_PASS_H_
+#define _UPSCALE_PASS_H_
+
+#include "defines.h"
+
+struct rendergraph;
+struct rendergraph_pass;
+struct frame_data;
+
+/**
+ * @brief The configuration of an upscale pass, which draws the scaled colour targets of a
+ * rendergraph over its viewport with bicubic (Catmull-Rom) filtering. It renders to the window's
+ * colour attachments, so should sink the last scaled pass' colour and be followed by any passes
+ * drawn at full resolution, such as the UI.
+ */
+typedef struct upscale_pass_config {
+    /** @brief The graph whose scaled colour targets are upscaled. */
+    struct rendergraph* graph;
+} upscale_pass_config;
+
+KAPI b8 upscale_pass_create(struct rendergraph_pass* self, void* config);
+KAPI b8 upscale_pass_initialize(struct rendergraph_pass* self);
+KAPI b8 upscale_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+KAPI void upscale_pass_destroy(struct rendergraph_pass* self);
+
+#endif
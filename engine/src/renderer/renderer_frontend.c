@@ -3,13 +3,18 @@
 #include "containers/darray.h"
 #include "containers/freelist.h"
 #include "containers/hashtable.h"
+#include "core/console.h"
+#include "core/event.h"
 #include "core/frame_data.h"
+#include "core/katomic.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/kvar.h"
 #include "core/logger.h"
+#include "core/metrics.h"
 #include "core/systems_manager.h"
 #include "defines.h"
+#include "math/geometry_utils.h"
 #include "math/kmath.h"
 #include "math/math_types.h"
 #include "platform/platform.h"
@@ -23,6 +28,40 @@
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
 
+/** @brief A range of a renderbuffer no longer used, but which frames in flight may still be reading. */
+typedef struct renderer_deferred_free {
+    renderbuffer* buffer;
+    u64 offset;
+    u64 size;
+    // The frame number after which the range may be freed.
+    u64 free_after_frame;
+} renderer_deferred_free;
+
+/** @brief An attachment texture held by the attachment pool. */
+typedef struct renderer_pooled_attachment {
+    // Allocated on its own, so owners' pointers stay valid as the pool grows.
+    texture* t;
+    renderer_attachment_desc desc;
+    // The number of owners holding the texture. 0 if it is free for reuse.
+    u32 reference_count;
+    // The frame number in which the texture was last released.
+    u64 released_frame;
+} renderer_pooled_attachment;
+
+// The number of frames a released attachment is kept for reuse before it is destroyed.
+#define RENDERER_ATTACHMENT_POOL_IDLE_FRAMES 120
+
+// The number of frames a range is kept for when the number of frames in flight is not configured.
+#define RENDERER_DEFAULT_DEFERRED_FREE_FRAMES 3
+
+// The percentage of the GPU-local memory budget in use at which memory pressure is signalled, unless set by kvar.
+#define RENDERER_GPU_MEMORY_PRESSURE_DEFAULT_PERCENT 90
+// Pressure eases once use falls this many percentage points below the pressure level. Systems are
+// asked to free down to this level, so freeing a little does not bring the pressure straight back.
+#define RENDERER_GPU_MEMORY_PRESSURE_HYSTERESIS_PERCENT 10
+// While the pressure lasts, it is signalled again this often in frames, giving freed memory time to be reported.
+#define RENDERER_GPU_MEMORY_PRESSURE_INTERVAL_FRAMES 60
+
 typedef struct renderer_system_state {
     renderer_plugin plugin;
     // The number of render targets. Typically lines up with the amount of swapchain images.
@@ -37,8 +76,179 @@ typedef struct renderer_system_state {
     renderbuffer geometry_vertex_buffer;
     /** @brief The object index buffer, used to hold geometry indices. */
     renderbuffer geometry_index_buffer;
+    /** @brief Ranges of the geometry buffers left behind by relocated geometry, freed once no frame in flight can use them. Darray. */
+    renderer_deferred_free* deferred_frees;
+    /** @brief The number of frames a deferred range is kept for. */
+    u8 deferred_free_frames;
+    /** @brief The attachment textures shared by rendergraphs and passes. Darray. */
+    renderer_pooled_attachment* attachment_pool;
+
+    /** @brief The swapchain settings last handed to the backend. */
+    renderer_swapchain_settings swapchain_settings;
+    /** @brief The kvars the swapchain settings are read from each frame. */
+    kvar_handle present_mode_kvar;
+    kvar_handle swapchain_images_kvar;
+    kvar_handle frames_in_flight_kvar;
+
+    /** @brief The kvar holding the percentage of the GPU-local memory budget at which memory pressure is signalled. */
+    kvar_handle gpu_memory_pressure_kvar;
+    /** @brief Indicates if GPU memory pressure has been signalled and has not yet eased. */
+    b8 gpu_memory_pressure;
+    /** @brief Frames until GPU memory pressure may be signalled again. */
+    u32 gpu_memory_pressure_countdown;
+
+    /** @brief The state changes made so far this frame. Added to from any recording thread. */
+    renderer_bind_stats frame_bind_stats;
+    /** @brief The state changes made over the last frame. */
+    renderer_bind_stats last_frame_bind_stats;
+    /**
+     * @brief Incremented whenever previously-bound state may no longer be bound (e.g. a renderpass
+     * begins), which invalidates the bind cache of every thread.
+     */
+    volatile u32 bind_epoch;
 } renderer_system_state;
 
+/**
+ * @brief The state last bound by a recording thread, used to skip binds which would change nothing.
+ * Only valid while its epoch matches that of the renderer.
+ */
+typedef struct renderer_bind_cache {
+    u32 epoch;
+    shader* bound_shader;
+    renderbuffer* vertex_buffer;
+    u64 vertex_offset;
+    renderbuffer* index_buffer;
+    u64 index_offset;
+    renderbuffer* instance_buffer;
+    u64 instance_offset;
+} renderer_bind_cache;
+
+// Set while the calling thread is recording a command list, in which case the active
+// viewport is tracked per-thread so that passes recorded in parallel do not race on it.
+static _Thread_local b8 recording_command_list = false;
+static _Thread_local viewport* thread_active_viewport = 0;
+// The state bound by the calling thread. Command lists are recorded one per thread at a time.
+static _Thread_local renderer_bind_cache thread_bind_cache = {0};
+
+static void renderer_bind_cache_invalidate(renderer_system_state* state_ptr) {
+    katomic_fetch_add_u32(&state_ptr->bind_epoch, 1, KATOMIC_ORDER_RELAXED);
+}
+
+static renderer_bind_cache* renderer_bind_cache_get(renderer_system_state* state_ptr) {
+    u32 epoch = katomic_load_u32(&state_ptr->bind_epoch, KATOMIC_ORDER_RELAXED);
+    if (thread_bind_cache.epoch != epoch) {
+        kzero_memory(&thread_bind_cache, sizeof(renderer_bind_cache));
+        thread_bind_cache.epoch = epoch;
+    }
+    return &thread_bind_cache;
+}
+
+static void renderer_bind_stat_add(volatile u32* stat) {
+    katomic_fetch_add_u32(stat, 1, KATOMIC_ORDER_RELAXED);
+}
+
+static void renderer_console_command_gpu_timings_print(console_command_context context) {
+    metrics_gpu_pass passes[METRICS_MAX_GPU_PASSES];
+    u32 count = metrics_gpu_passes_get(passes);
+    if (!count) {
+        console_write_line(LOG_LEVEL_INFO, "No GPU timings have been recorded.");
+        return;
+    }
+
+    f64 total_ms = 0;
+    char line[256];
+    for (u32 i = 0; i < count; ++i) {
+        string_format(line, "%-40s %7.3fms  vs=%llu fs=%llu", passes[i].name, passes[i].ms, passes[i].vertex_invocations, passes[i].fragment_invocations);
+        console_write_line(LOG_LEVEL_INFO, line);
+        total_ms += passes[i].ms;
+    }
+    string_format(line, "%-40s %7.3fms", "Total", total_ms);
+    console_write_line(LOG_LEVEL_INFO, line);
+}
+
+// Reads the swapchain settings from their kvars, clamping them to the ranges their types can hold.
+static void swapchain_settings_from_kvars(renderer_system_state* state_ptr, renderer_swapchain_settings* out_settings) {
+    i32 present_mode = kvar_int_value(state_ptr->present_mode_kvar, RENDERER_PRESENT_MODE_AUTO);
+    out_settings->present_mode = (present_mode >= RENDERER_PRESENT_MODE_AUTO && present_mode <= RENDERER_PRESENT_MODE_IMMEDIATE) ? (renderer_present_mode)present_mode : RENDERER_PRESENT_MODE_AUTO;
+    out_settings->image_count = (u8)KCLAMP(kvar_int_value(state_ptr->swapchain_images_kvar, 0), 0, 255);
+    out_settings->frames_in_flight = (u8)KCLAMP(kvar_int_value(state_ptr->frames_in_flight_kvar, 0), 0, 255);
+}
+
+// Ranges are kept for one frame more than are in flight, so the frame being recorded is covered too.
+static void deferred_free_frames_update(renderer_system_state* state_ptr) {
+    u8 frames_in_flight = state_ptr->swapchain_settings.frames_in_flight;
+    state_ptr->deferred_free_frames = (frames_in_flight ? frames_in_flight : RENDERER_DEFAULT_DEFERRED_FREE_FRAMES) + 1;
+}
+
+static void swapchain_settings_apply(renderer_system_state* state_ptr, const renderer_swapchain_settings* settings) {
+    state_ptr->swapchain_settings = *settings;
+    deferred_free_frames_update(state_ptr);
+    state_ptr->plugin.swapchain_settings_set(&state_ptr->plugin, settings);
+}
+
+// Destroys the free pooled attachments which have not been used for at least the given number of frames.
+static void attachment_pool_trim(renderer_system_state* state_ptr, u64 idle_frames) {
+    u32 count = darray_length(state_ptr->attachment_pool);
+    for (u32 i = 0; i < count;) {
+        renderer_pooled_attachment* entry = &state_ptr->attachment_pool[i];
+        if (entry->reference_count || state_ptr->plugin.frame_number < entry->released_frame + idle_frames) {
+            ++i;
+            continue;
+        }
+        renderer_texture_destroy(entry->t);
+        kfree(entry->t, sizeof(texture), MEMORY_TAG_RENDERER);
+        // Order doesn't matter, so replace with the last entry.
+        state_ptr->attachment_pool[i] = state_ptr->attachment_pool[--count];
+    }
+    darray_length_set(state_ptr->attachment_pool, count);
+}
+
+// Signals GPU memory pressure once the memory local to the GPU nears its budget, as last reported by the backend.
+static void gpu_memory_pressure_check(renderer_system_state* state_ptr) {
+    if (state_ptr->gpu_memory_pressure_countdown) {
+        state_ptr->gpu_memory_pressure_countdown--;
+        return;
+    }
+
+    metrics_gpu_heap heaps[METRICS_MAX_GPU_HEAPS];
+    u32 heap_count = metrics_gpu_heaps_get(heaps);
+    u64 usage = 0;
+    u64 budget = 0;
+    for (u32 i = 0; i < heap_count; ++i) {
+        if (heaps[i].device_local) {
+            usage += heaps[i].usage;
+            budget += heaps[i].budget;
+        }
+    }
+    if (!budget) {
+        return;
+    }
+
+    i32 pressure_percent = KCLAMP(kvar_int_value(state_ptr->gpu_memory_pressure_kvar, RENDERER_GPU_MEMORY_PRESSURE_DEFAULT_PERCENT), 1, 100);
+    i32 eased_percent = KMAX(pressure_percent - RENDERER_GPU_MEMORY_PRESSURE_HYSTERESIS_PERCENT, 1);
+    u64 pressure_level = (budget / 100) * (u64)pressure_percent;
+    u64 eased_level = (budget / 100) * (u64)eased_percent;
+
+    event_context context = {0};
+    context.data.u64[1] = budget;
+    if (usage > pressure_level || (state_ptr->gpu_memory_pressure && usage > eased_level)) {
+        if (!state_ptr->gpu_memory_pressure) {
+            KWARN("GPU memory pressure: %lluMiB of a %lluMiB budget in use.", usage / MEBIBYTES(1), budget / MEBIBYTES(1));
+        }
+        state_ptr->gpu_memory_pressure = true;
+        // Free attachments are the cheapest memory to give back.
+        attachment_pool_trim(state_ptr, state_ptr->deferred_free_frames);
+        state_ptr->gpu_memory_pressure_countdown = RENDERER_GPU_MEMORY_PRESSURE_INTERVAL_FRAMES;
+        context.data.u64[0] = usage - eased_level;
+        event_fire(EVENT_CODE_GPU_MEMORY_PRESSURE, 0, context);
+    } else if (state_ptr->gpu_memory_pressure) {
+        KINFO("GPU memory pressure eased: %lluMiB of a %lluMiB budget in use.", usage / MEBIBYTES(1), budget / MEBIBYTES(1));
+        state_ptr->gpu_memory_pressure = false;
+        context.data.u64[0] = 0;
+        event_fire(EVENT_CODE_GPU_MEMORY_PRESSURE, 0, context);
+    }
+}
+
 b8 renderer_system_initialize(u64* memory_requirement, void* state, void* config) {
     renderer_system_config* typed_config = (renderer_system_config*)config;
     *memory_requirement = sizeof(renderer_system_state);
@@ -59,10 +269,36 @@ b8 renderer_system_initialize(u64* memory_requirement, void* state, void* config
     renderer_backend_config renderer_config = {};
     renderer_config.application_name = typed_config->application_name;
     // TODO: expose this to the application to configure.
-    renderer_config.flags = RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT | RENDERER_CONFIG_FLAG_POWER_SAVING_BIT;
+    renderer_config.flags = RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT | RENDERER_CONFIG_FLAG_POWER_SAVING_BIT | RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT;
+    state_ptr->deferred_frees = darray_create(renderer_deferred_free);
+    state_ptr->attachment_pool = darray_create(renderer_pooled_attachment);
+
+    // Swapchain settings, which may be changed at runtime. 0 uses the backend default. If an
+    // application created any of these first, its value is used.
+    kvar_int_create("present_mode", RENDERER_PRESENT_MODE_AUTO);
+    kvar_int_create("swapchain_images", 0);
+    kvar_int_create("frames_in_flight", typed_config->frames_in_flight);
+    state_ptr->present_mode_kvar = kvar_handle_get("present_mode");
+    state_ptr->swapchain_images_kvar = kvar_handle_get("swapchain_images");
+    state_ptr->frames_in_flight_kvar = kvar_handle_get("frames_in_flight");
+    swapchain_settings_from_kvars(state_ptr, &state_ptr->swapchain_settings);
+    deferred_free_frames_update(state_ptr);
+    renderer_config.present_mode = state_ptr->swapchain_settings.present_mode;
+    renderer_config.swapchain_image_count = state_ptr->swapchain_settings.image_count;
+    renderer_config.frames_in_flight = state_ptr->swapchain_settings.frames_in_flight;
+
+    // The percentage of the GPU-local memory budget at which systems are asked to release memory.
+    kvar_int_create("gpu_memory_pressure_percent", RENDERER_GPU_MEMORY_PRESSURE_DEFAULT_PERCENT);
+    state_ptr->gpu_memory_pressure_kvar = kvar_handle_get("gpu_memory_pressure_percent");
 
     // Create the vsync kvar
     kvar_int_create("vsync", (renderer_config.flags & RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT) ? 1 : 0);
+    // Variable rate shading, where supported.
+    kvar_int_create("variable_rate_shading", (renderer_config.flags & RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT) ? 1 : 0);
+
+    // Per-pass GPU timings. The kvar toggles their on-screen display, the command prints them.
+    kvar_int_create("gpu_timings", 0);
+    console_command_register("gpu_timings_print", 0, renderer_console_command_gpu_timings_print);
 
     // Initialize the backend.
     if (!state_ptr->plugin.initialize(&state_ptr->plugin, &renderer_config, &state_ptr->window_render_target_count)) {
@@ -100,10 +336,31 @@ void renderer_system_shutdown(void* state) {
     if (state) {
         renderer_system_state* typed_state = (renderer_system_state*)state;
 
-        // Destroy buffers.
+        console_command_unregister("gpu_timings_print");
+
+        // Destroy buffers. Deferred ranges go along with them.
+        if (typed_state->deferred_frees) {
+            darray_destroy(typed_state->deferred_frees);
+            typed_state->deferred_frees = 0;
+        }
         renderer_renderbuffer_destroy(&typed_state->geometry_vertex_buffer);
         renderer_renderbuffer_destroy(&typed_state->geometry_index_buffer);
 
+        // Destroy pooled attachments, including any still held.
+        if (typed_state->attachment_pool) {
+            u32 count = darray_length(typed_state->attachment_pool);
+            for (u32 i = 0; i < count; ++i) {
+                renderer_pooled_attachment* entry = &typed_state->attachment_pool[i];
+                if (entry->reference_count) {
+                    KWARN("Attachment '%s' is still held by %u owner(s) at renderer shutdown.", entry->t->name, entry->reference_count);
+                }
+                renderer_texture_destroy(entry->t);
+                kfree(entry->t, sizeof(texture), MEMORY_TAG_RENDERER);
+            }
+            darray_destroy(typed_state->attachment_pool);
+            typed_state->attachment_pool = 0;
+        }
+
         // Shutdown the plugin
         typed_state->plugin.shutdown(&typed_state->plugin);
     }
@@ -121,17 +378,53 @@ void renderer_on_resized(u16 width, u16 height) {
     }
 }
 
+// Frees the deferred ranges which no frame in flight can still be reading.
+static void deferred_frees_process(renderer_system_state* state_ptr) {
+    u32 count = darray_length(state_ptr->deferred_frees);
+    for (u32 i = 0; i < count;) {
+        renderer_deferred_free* entry = &state_ptr->deferred_frees[i];
+        if (state_ptr->plugin.frame_number <= entry->free_after_frame) {
+            ++i;
+            continue;
+        }
+        if (!renderer_renderbuffer_free(entry->buffer, entry->size, entry->offset)) {
+            KERROR("Failed to free a deferred renderbuffer range of %llu bytes at offset %llu.", entry->size, entry->offset);
+        }
+        // Order doesn't matter, so replace with the last entry.
+        state_ptr->deferred_frees[i] = state_ptr->deferred_frees[--count];
+    }
+    darray_length_set(state_ptr->deferred_frees, count);
+}
+
 b8 renderer_frame_prepare(struct frame_data* p_frame_data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
 
     // Increment the frame number.
     state_ptr->plugin.frame_number++;
 
+    deferred_frees_process(state_ptr);
+    attachment_pool_trim(state_ptr, RENDERER_ATTACHMENT_POOL_IDLE_FRAMES);
+
+    // Hand any changed swapchain settings to the backend, which recreates the swapchain as this frame is prepared.
+    renderer_swapchain_settings settings;
+    swapchain_settings_from_kvars(state_ptr, &settings);
+    if (settings.present_mode != state_ptr->swapchain_settings.present_mode ||
+        settings.image_count != state_ptr->swapchain_settings.image_count ||
+        settings.frames_in_flight != state_ptr->swapchain_settings.frames_in_flight) {
+        swapchain_settings_apply(state_ptr, &settings);
+    }
+
     // Reset the draw index for this frame.
     state_ptr->plugin.draw_index = 0;
 
+    // Keep the counts of the frame just finished, and start counting again.
+    state_ptr->last_frame_bind_stats = state_ptr->frame_bind_stats;
+    kzero_memory(&state_ptr->frame_bind_stats, sizeof(renderer_bind_stats));
+
     b8 result = state_ptr->plugin.frame_prepare(&state_ptr->plugin, p_frame_data);
 
+    gpu_memory_pressure_check(state_ptr);
+
     // Update the frame data with renderer info.
     u8 attachment_index = state_ptr->plugin.window_attachment_index_get(&state_ptr->plugin);
     p_frame_data->renderer_frame_number = state_ptr->plugin.frame_number;
@@ -143,6 +436,7 @@ b8 renderer_frame_prepare(struct frame_data* p_frame_data) {
 
 b8 renderer_begin(struct frame_data* p_frame_data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_cache_invalidate(state_ptr);
     return state_ptr->plugin.begin(&state_ptr->plugin, p_frame_data);
 }
 
@@ -210,6 +504,11 @@ void renderer_set_depth_test_enabled(b8 enabled) {
     state_ptr->plugin.set_depth_test_enabled(&state_ptr->plugin, enabled);
 }
 
+void renderer_set_depth_compare_op(renderer_compare_op compare_op) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    state_ptr->plugin.set_depth_compare_op(&state_ptr->plugin, compare_op);
+}
+
 void renderer_set_stencil_op(renderer_stencil_op fail_op, renderer_stencil_op pass_op, renderer_stencil_op depth_fail_op, renderer_compare_op compare_op) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     state_ptr->plugin.set_stencil_op(&state_ptr->plugin, fail_op, pass_op, depth_fail_op, compare_op);
@@ -230,6 +529,19 @@ void renderer_texture_create(const u8* pixels, struct texture* texture) {
     state_ptr->plugin.texture_create(&state_ptr->plugin, pixels, texture);
 }
 
+void renderer_texture_create_layered(const u8* const* layer_pixels, struct texture* texture) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    state_ptr->plugin.texture_create_layered(&state_ptr->plugin, layer_pixels, texture);
+}
+
+b8 renderer_texture_format_supported(texture_format format) {
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        return true;
+    }
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.texture_format_supported && state_ptr->plugin.texture_format_supported(&state_ptr->plugin, format);
+}
+
 void renderer_texture_destroy(struct texture* texture) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     state_ptr->plugin.texture_destroy(&state_ptr->plugin, texture);
@@ -245,6 +557,11 @@ void renderer_texture_write_data(texture* t, u32 offset, u32 size, const u8* pix
     state_ptr->plugin.texture_write_data(&state_ptr->plugin, t, offset, size, pixels);
 }
 
+void renderer_texture_write_region(texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    state_ptr->plugin.texture_write_region(&state_ptr->plugin, t, x, y, width, height, pixels);
+}
+
 void renderer_texture_read_data(texture* t, u32 offset, u32 size, void** out_memory) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     state_ptr->plugin.texture_read_data(&state_ptr->plugin, t, offset, size, out_memory);
@@ -255,11 +572,128 @@ void renderer_texture_read_pixel(texture* t, u32 x, u32 y, u8** out_rgba) {
     state_ptr->plugin.texture_read_pixel(&state_ptr->plugin, t, x, y, out_rgba);
 }
 
+b8 renderer_texture_read_pixel_async(texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    *out_ticket = INVALID_ID_U64;
+    return state_ptr->plugin.texture_read_pixel_async(&state_ptr->plugin, t, x, y, out_ticket);
+}
+
+renderer_readback_status renderer_readback_resolve(renderer_readback_ticket ticket, u32 size, void* out_data) {
+    if (ticket == INVALID_ID_U64) {
+        return RENDERER_READBACK_STATUS_INVALID;
+    }
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.readback_resolve(&state_ptr->plugin, ticket, size, out_data);
+}
+
 void renderer_texture_resize(texture* t, u32 new_width, u32 new_height) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     state_ptr->plugin.texture_resize(&state_ptr->plugin, t, new_width, new_height);
 }
 
+static b8 attachment_desc_matches(const renderer_attachment_desc* a, const renderer_attachment_desc* b) {
+    return a->type == b->type && a->width == b->width && a->height == b->height && a->format == b->format &&
+           a->channel_count == b->channel_count && a->flags == b->flags;
+}
+
+static renderer_pooled_attachment* attachment_pool_entry_get(renderer_system_state* state_ptr, const texture* t) {
+    u32 count = darray_length(state_ptr->attachment_pool);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->attachment_pool[i].t == t) {
+            return &state_ptr->attachment_pool[i];
+        }
+    }
+    return 0;
+}
+
+texture* renderer_attachment_acquire(const char* name, const renderer_attachment_desc* desc) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!desc || !desc->width || !desc->height) {
+        KERROR("renderer_attachment_acquire requires a description with a non-zero size.");
+        return 0;
+    }
+
+    renderer_attachment_desc key = *desc;
+    key.flags |= TEXTURE_FLAG_IS_WRITEABLE;
+
+    u32 count = darray_length(state_ptr->attachment_pool);
+    // Transient attachments are shared with anything else holding one of the same description and slot.
+    if (key.transient) {
+        for (u32 i = 0; i < count; ++i) {
+            renderer_pooled_attachment* entry = &state_ptr->attachment_pool[i];
+            if (entry->reference_count && entry->desc.transient && entry->desc.slot == key.slot && attachment_desc_matches(&entry->desc, &key)) {
+                entry->reference_count++;
+                return entry->t;
+            }
+        }
+    }
+
+    // Otherwise reuse a free one, if there is one.
+    for (u32 i = 0; i < count; ++i) {
+        renderer_pooled_attachment* entry = &state_ptr->attachment_pool[i];
+        if (!entry->reference_count && attachment_desc_matches(&entry->desc, &key)) {
+            entry->desc = key;
+            entry->reference_count = 1;
+            return entry->t;
+        }
+    }
+
+    // Create a new one.
+    texture* t = kallocate(sizeof(texture), MEMORY_TAG_RENDERER);
+    t->id = INVALID_ID;
+    t->type = key.type;
+    t->width = key.width;
+    t->height = key.height;
+    t->format = key.format;
+    t->channel_count = key.channel_count;
+    t->flags = key.flags;
+    t->array_size = 1;
+    t->mip_levels = 1;
+    t->generation = INVALID_ID;
+    string_format(t->name, "%s_%u", name ? name : "pooled_attachment", count);
+    renderer_texture_create_writeable(t);
+    if (!t->internal_data) {
+        KERROR("Failed to create pooled attachment '%s'.", t->name);
+        kfree(t, sizeof(texture), MEMORY_TAG_RENDERER);
+        return 0;
+    }
+
+    renderer_pooled_attachment entry = {0};
+    entry.t = t;
+    entry.desc = key;
+    entry.reference_count = 1;
+    darray_push(state_ptr->attachment_pool, entry);
+    return t;
+}
+
+void renderer_attachment_release(texture* t) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_pooled_attachment* entry = t ? attachment_pool_entry_get(state_ptr, t) : 0;
+    if (!entry || !entry->reference_count) {
+        KWARN("renderer_attachment_release called for a texture not held from the attachment pool. Nothing was done.");
+        return;
+    }
+    entry->reference_count--;
+    if (!entry->reference_count) {
+        entry->released_frame = state_ptr->plugin.frame_number;
+    }
+}
+
+void renderer_attachment_resize(texture* t, u32 new_width, u32 new_height) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_pooled_attachment* entry = t ? attachment_pool_entry_get(state_ptr, t) : 0;
+    if (!entry) {
+        KWARN("renderer_attachment_resize called for a texture not held from the attachment pool. Nothing was done.");
+        return;
+    }
+    if (entry->desc.width == new_width && entry->desc.height == new_height) {
+        return;
+    }
+    renderer_texture_resize(t, new_width, new_height);
+    t->width = entry->desc.width = new_width;
+    t->height = entry->desc.height = new_height;
+}
+
 renderbuffer* renderer_renderbuffer_get(renderbuffer_type type) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     switch (type) {
@@ -367,6 +801,60 @@ void renderer_geometry_vertex_update(geometry* g, u32 offset, u32 vertex_count,
     }
 }
 
+// Moves a range of a geometry buffer to a lower offset, if the buffer has room for it there.
+static b8 geometry_range_relocate(renderer_system_state* state_ptr, renderbuffer* buffer, u64 size, u64* offset, b8* out_moved) {
+    u64 new_offset = 0;
+    if (!renderer_renderbuffer_allocate(buffer, size, &new_offset)) {
+        // No room elsewhere, so stay put.
+        return true;
+    }
+    if (new_offset >= *offset) {
+        renderer_renderbuffer_free(buffer, size, new_offset);
+        return true;
+    }
+
+    // Copy on the GPU, so data written since the upload (i.e. vertex updates) comes along.
+    if (!renderer_renderbuffer_copy_range(buffer, *offset, buffer, new_offset, size)) {
+        KERROR("Failed to copy a geometry range during relocation.");
+        renderer_renderbuffer_free(buffer, size, new_offset);
+        return false;
+    }
+
+    renderer_deferred_free entry = {buffer, *offset, size, state_ptr->plugin.frame_number + state_ptr->deferred_free_frames};
+    darray_push(state_ptr->deferred_frees, entry);
+    *offset = new_offset;
+    *out_moved = true;
+    return true;
+}
+
+b8 renderer_geometry_relocate(geometry* g, b8* out_moved) {
+    *out_moved = false;
+    if (!g || g->generation == INVALID_ID_U16) {
+        return false;
+    }
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+
+    u64 vertex_size = (u64)g->vertex_element_size * g->vertex_count;
+    if (vertex_size && !geometry_range_relocate(state_ptr, &state_ptr->geometry_vertex_buffer, vertex_size, &g->vertex_buffer_offset, out_moved)) {
+        return false;
+    }
+    u64 index_size = (u64)g->index_element_size * g->index_count;
+    if (index_size && !geometry_range_relocate(state_ptr, &state_ptr->geometry_index_buffer, index_size, &g->index_buffer_offset, out_moved)) {
+        return false;
+    }
+    return true;
+}
+
+f32 renderer_geometry_fragmentation(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr) {
+        return 0.0f;
+    }
+    f32 vertex_fragmentation = freelist_fragmentation(&state_ptr->geometry_vertex_buffer.buffer_freelist);
+    f32 index_fragmentation = freelist_fragmentation(&state_ptr->geometry_index_buffer.buffer_freelist);
+    return KMAX(vertex_fragmentation, index_fragmentation);
+}
+
 void renderer_geometry_destroy(geometry* g) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
 
@@ -398,6 +886,34 @@ void renderer_geometry_destroy(geometry* g) {
     }
 }
 
+void renderer_geometry_draw_record_resolve(const geometry_draw_record* record, const mat4* models, geometry_render_data* out_data) {
+    const geometry* g = record->geometry;
+    kzero_memory(out_data, sizeof(geometry_render_data));
+    // Packed vertices also need dequantizing.
+    out_data->model = models ? geometry_quantized_model_get(g, models[record->object_index]) : mat4_identity();
+    out_data->material = g->material;
+    out_data->unique_id = INVALID_ID;
+    out_data->winding_inverted = record->winding_inverted;
+    out_data->object_index = record->object_index;
+    out_data->vertex_count = g->vertex_count;
+    out_data->vertex_element_size = g->vertex_element_size;
+    out_data->vertex_buffer_offset = g->vertex_buffer_offset;
+    out_data->vertex_format = g->vertex_format;
+    out_data->index_count = g->index_count;
+    out_data->index_element_size = g->index_element_size;
+    out_data->index_buffer_offset = g->index_buffer_offset;
+    if (g->lod_count) {
+        const geometry_lod* lod = &g->lods[KMIN(record->lod, g->lod_count - 1)];
+        out_data->index_count = lod->index_count;
+        out_data->index_buffer_offset = g->index_buffer_offset + (u64)lod->index_offset * g->index_element_size;
+    }
+    if (record->index_count) {
+        out_data->index_count = record->index_count;
+        out_data->index_buffer_offset = g->index_buffer_offset + (u64)record->first_index * g->index_element_size;
+    }
+    out_data->sort_key = record->sort_key;
+}
+
 void renderer_geometry_draw(geometry_render_data* data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     b8 includes_index_data = data->index_count > 0;
@@ -414,13 +930,232 @@ void renderer_geometry_draw(geometry_render_data* data) {
     }
 }
 
+void renderer_geometry_draw_instanced(geometry_render_data* data, renderbuffer* instance_buffer, u64 instance_offset, u32 instance_count) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!instance_buffer || (instance_buffer->type != RENDERBUFFER_TYPE_INSTANCE && instance_buffer->type != RENDERBUFFER_TYPE_STORAGE)) {
+        KERROR("renderer_geometry_draw_instanced requires a valid instance buffer.");
+        return;
+    }
+    if (!instance_count) {
+        return;
+    }
+
+    // Bind the per-instance data first.
+    if (!renderer_renderbuffer_draw(instance_buffer, instance_offset, instance_count, true)) {
+        KERROR("renderer_geometry_draw_instanced failed to bind instance buffer;");
+        return;
+    }
+
+    b8 includes_index_data = data->index_count > 0;
+    if (includes_index_data) {
+        if (!renderer_renderbuffer_draw(&state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, data->vertex_count, true)) {
+            KERROR("renderer_geometry_draw_instanced failed to bind vertex buffer;");
+            return;
+        }
+        if (!renderer_renderbuffer_draw_instanced(&state_ptr->geometry_index_buffer, data->index_buffer_offset, data->index_count, instance_count)) {
+            KERROR("renderer_geometry_draw_instanced failed to draw index buffer;");
+            return;
+        }
+    } else {
+        if (!renderer_renderbuffer_draw_instanced(&state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, data->vertex_count, instance_count)) {
+            KERROR("renderer_geometry_draw_instanced failed to draw vertex buffer;");
+            return;
+        }
+    }
+}
+
+b8 renderer_indirect_draw_supported(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.indirect_draw_supported && state_ptr->plugin.renderbuffer_draw_indirect && state_ptr->plugin.indirect_draw_supported(&state_ptr->plugin);
+}
+
+b8 renderer_multiview_supported(u8 view_count) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.multiview_supported && state_ptr->plugin.multiview_supported(&state_ptr->plugin, view_count);
+}
+
+b8 renderer_weighted_blend_supported(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.weighted_blend_supported && state_ptr->plugin.weighted_blend_supported(&state_ptr->plugin);
+}
+
+b8 renderer_variable_rate_shading_available(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.shading_rate_supported && state_ptr->plugin.shading_rate_set &&
+           state_ptr->plugin.shading_rate_supported(&state_ptr->plugin) &&
+           state_ptr->plugin.flag_enabled_get(&state_ptr->plugin, RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT);
+}
+
+void renderer_shading_rate_set(renderer_shading_rate rate) {
+    if (renderer_variable_rate_shading_available()) {
+        renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+        state_ptr->plugin.shading_rate_set(&state_ptr->plugin, rate);
+    }
+}
+
+b8 renderer_occlusion_queries_supported(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.occlusion_query_begin != 0;
+}
+
+b8 renderer_occlusion_query_begin(u32 query_index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.occlusion_query_begin || query_index >= RENDERER_MAX_OCCLUSION_QUERIES) {
+        return false;
+    }
+    return state_ptr->plugin.occlusion_query_begin(&state_ptr->plugin, query_index);
+}
+
+void renderer_occlusion_query_end(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (state_ptr->plugin.occlusion_query_end) {
+        state_ptr->plugin.occlusion_query_end(&state_ptr->plugin);
+    }
+}
+
+b8 renderer_occlusion_query_results_get(u32 max_count, u8* out_visible, u32* out_count, u64* out_frame_number) {
+    *out_count = 0;
+    *out_frame_number = 0;
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.occlusion_query_results_get) {
+        return false;
+    }
+    return state_ptr->plugin.occlusion_query_results_get(&state_ptr->plugin, max_count, out_visible, out_count, out_frame_number);
+}
+
+static b8 indirect_draw_run_submit(renderer_system_state* state_ptr, renderbuffer* indirect_buffer, u64 indirect_offset, u64 vertex_base, u32 run_start, u32 run_count) {
+    // Commands address vertices relative to the bound offset, and indices from the start of the buffer.
+    if (!renderer_renderbuffer_draw(&state_ptr->geometry_vertex_buffer, vertex_base, 0, true)) {
+        KERROR("renderer_geometry_draw_indirect failed to bind vertex buffer;");
+        return false;
+    }
+    if (!renderer_renderbuffer_draw(&state_ptr->geometry_index_buffer, 0, 0, true)) {
+        KERROR("renderer_geometry_draw_indirect failed to bind index buffer;");
+        return false;
+    }
+    u64 offset = indirect_offset + (sizeof(renderer_indirect_draw_command) * run_start);
+    renderer_bind_stat_add(&state_ptr->frame_bind_stats.draw_calls);
+    return state_ptr->plugin.renderbuffer_draw_indirect(&state_ptr->plugin, indirect_buffer, offset, run_count);
+}
+
+b8 renderer_geometry_draw_indirect(u32 draw_count, const renderer_indirect_draw* draws, renderbuffer* indirect_buffer, u64 indirect_offset) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!indirect_buffer || indirect_buffer->type != RENDERBUFFER_TYPE_INDIRECT) {
+        KERROR("renderer_geometry_draw_indirect requires a valid indirect buffer.");
+        return false;
+    }
+    if (!renderer_indirect_draw_supported()) {
+        KERROR("renderer_geometry_draw_indirect - the renderer does not support indirect draws.");
+        return false;
+    }
+    if (!draw_count) {
+        return true;
+    }
+
+    u64 size = sizeof(renderer_indirect_draw_command) * draw_count;
+    if (indirect_offset + size > indirect_buffer->total_size) {
+        KERROR("renderer_geometry_draw_indirect - %u commands at offset %llu do not fit in the indirect buffer.", draw_count, indirect_offset);
+        return false;
+    }
+
+    renderer_indirect_draw_command* commands = renderer_renderbuffer_map_memory(indirect_buffer, indirect_offset, size);
+    if (!commands) {
+        KERROR("renderer_geometry_draw_indirect failed to map the indirect buffer.");
+        return false;
+    }
+
+    // Only one vertex buffer offset can be bound per call, so consecutive draws whose vertex data sits
+    // at the same alignment (relative to their vertex size) are submitted together.
+    b8 result = true;
+    u32 run_start = 0;
+    u64 run_base = 0;
+    for (u32 i = 0; i < draw_count; ++i) {
+        geometry_render_data resolved;
+        renderer_geometry_draw_record_resolve(draws[i].record, 0, &resolved);
+        const geometry_render_data* data = &resolved;
+        if (!data->index_count || !data->vertex_element_size) {
+            KERROR("renderer_geometry_draw_indirect requires indexed geometry with a known vertex size.");
+            result = false;
+            break;
+        }
+
+        u64 base = data->vertex_buffer_offset % data->vertex_element_size;
+        if (i == run_start) {
+            run_base = base;
+        } else if (base != run_base) {
+            if (!indirect_draw_run_submit(state_ptr, indirect_buffer, indirect_offset, run_base, run_start, i - run_start)) {
+                result = false;
+                break;
+            }
+            run_start = i;
+            run_base = base;
+        }
+
+        renderer_indirect_draw_command* command = &commands[i];
+        command->index_count = data->index_count;
+        command->instance_count = draws[i].instance_count;
+        command->first_index = (u32)(data->index_buffer_offset / sizeof(u32));
+        command->vertex_offset = (i32)((data->vertex_buffer_offset - base) / data->vertex_element_size);
+        command->first_instance = draws[i].first_instance;
+    }
+
+    if (result) {
+        result = indirect_draw_run_submit(state_ptr, indirect_buffer, indirect_offset, run_base, run_start, draw_count - run_start);
+    }
+
+    renderer_renderbuffer_unmap_memory(indirect_buffer, indirect_offset, size);
+    return result;
+}
+
+b8 renderer_geometry_draw_indirect_instanced(geometry_render_data* data, renderbuffer* instance_buffer, u64 instance_offset, renderbuffer* indirect_buffer, u64 indirect_offset) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!instance_buffer || (instance_buffer->type != RENDERBUFFER_TYPE_INSTANCE && instance_buffer->type != RENDERBUFFER_TYPE_STORAGE)) {
+        KERROR("renderer_geometry_draw_indirect_instanced requires a valid instance buffer.");
+        return false;
+    }
+    if (!indirect_buffer || (indirect_buffer->type != RENDERBUFFER_TYPE_INDIRECT && indirect_buffer->type != RENDERBUFFER_TYPE_STORAGE)) {
+        KERROR("renderer_geometry_draw_indirect_instanced requires a valid indirect buffer.");
+        return false;
+    }
+    if (!data->index_count) {
+        KERROR("renderer_geometry_draw_indirect_instanced requires indexed geometry.");
+        return false;
+    }
+    if (!renderer_indirect_draw_supported()) {
+        KERROR("renderer_geometry_draw_indirect_instanced - the renderer does not support indirect draws.");
+        return false;
+    }
+    if (indirect_offset + sizeof(renderer_indirect_draw_command) > indirect_buffer->total_size) {
+        KERROR("renderer_geometry_draw_indirect_instanced - the command at offset %llu does not fit in the indirect buffer.", indirect_offset);
+        return false;
+    }
+
+    // The command addresses the geometry's data relative to the bound offsets.
+    if (!renderer_renderbuffer_draw(instance_buffer, instance_offset, 0, true)) {
+        KERROR("renderer_geometry_draw_indirect_instanced failed to bind instance buffer;");
+        return false;
+    }
+    if (!renderer_renderbuffer_draw(&state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, 0, true)) {
+        KERROR("renderer_geometry_draw_indirect_instanced failed to bind vertex buffer;");
+        return false;
+    }
+    if (!renderer_renderbuffer_draw(&state_ptr->geometry_index_buffer, data->index_buffer_offset, 0, true)) {
+        KERROR("renderer_geometry_draw_indirect_instanced failed to bind index buffer;");
+        return false;
+    }
+    renderer_bind_stat_add(&state_ptr->frame_bind_stats.draw_calls);
+    return state_ptr->plugin.renderbuffer_draw_indirect(&state_ptr->plugin, indirect_buffer, indirect_offset, 1);
+}
+
 b8 renderer_renderpass_begin(renderpass* pass, render_target* target) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_cache_invalidate(state_ptr);
     return state_ptr->plugin.renderpass_begin(&state_ptr->plugin, pass, target);
 }
 
 b8 renderer_renderpass_end(renderpass* pass) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_cache_invalidate(state_ptr);
     return state_ptr->plugin.renderpass_end(&state_ptr->plugin, pass);
 }
 
@@ -436,6 +1171,9 @@ b8 renderer_shader_create(shader* s, const shader_config* config, renderpass* pa
     // Number of samplers in the shader, per instance, per frame. NOT the number of descriptors needed (i.e could be an array).
     s->instance_uniform_sampler_count = 0;
     s->instance_sampler_indices = darray_create(u32);
+    // Number of storage buffers/images in the shader. These are always global.
+    s->global_uniform_storage_count = 0;
+    s->global_storage_indices = darray_create(u32);
     s->local_uniform_count = 0;
 
     // Examine the uniforms and determine scope as well as a count of samplers.
@@ -446,6 +1184,9 @@ b8 renderer_shader_create(shader* s, const shader_config* config, renderpass* pa
                 if (uniform_type_is_sampler(config->uniforms[i].type)) {
                     s->global_uniform_sampler_count++;
                     darray_push(s->global_sampler_indices, i);
+                } else if (uniform_type_is_storage(config->uniforms[i].type)) {
+                    s->global_uniform_storage_count++;
+                    darray_push(s->global_storage_indices, i);
                 } else {
                     s->global_uniform_count++;
                 }
@@ -471,10 +1212,19 @@ b8 renderer_shader_create(shader* s, const shader_config* config, renderpass* pa
     // regardless of what backend is being used.
 
     s->stage_configs = kallocate(sizeof(shader_stage_config) * config->stage_count, MEMORY_TAG_ARRAY);
+    s->shader_stage_count = config->stage_count;
     // Each stage.
     for (u8 i = 0; i < config->stage_count; ++i) {
         s->stage_configs[i].stage = config->stage_configs[i].stage;
         s->stage_configs[i].filename = string_duplicate(config->stage_configs[i].filename);
+        if (config->stage_configs[i].precompiled) {
+            // Compiled ahead of time into a shader bundle, so there is nothing to read.
+            s->stage_configs[i].source_length = config->stage_configs[i].source_length;
+            s->stage_configs[i].source = kallocate(config->stage_configs[i].source_length, MEMORY_TAG_RENDERER);
+            kcopy_memory(s->stage_configs[i].source, config->stage_configs[i].source, config->stage_configs[i].source_length);
+            s->stage_configs[i].precompiled = true;
+            continue;
+        }
         // Read the resource.
         resource text_resource;
         if (!resource_system_load(s->stage_configs[i].filename, RESOURCE_TYPE_TEXT, 0, &text_resource)) {
@@ -498,6 +1248,7 @@ b8 renderer_shader_create(shader* s, const shader_config* config, renderpass* pa
 
 void renderer_shader_destroy(shader* s) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_cache_invalidate(state_ptr);
     state_ptr->plugin.shader_destroy(&state_ptr->plugin, s);
 }
 
@@ -506,9 +1257,42 @@ b8 renderer_shader_initialize(shader* s) {
     return state_ptr->plugin.shader_initialize(&state_ptr->plugin, s);
 }
 
+b8 renderer_shader_reload(shader* s) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.shader_reload) {
+        KWARN("The renderer backend does not support reloading shaders.");
+        return false;
+    }
+    // The shader's pipelines are replaced, so anything bound from it is stale.
+    renderer_bind_cache_invalidate(state_ptr);
+    return state_ptr->plugin.shader_reload(&state_ptr->plugin, s);
+}
+
+b8 renderer_shader_dispatch(shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.shader_dispatch(&state_ptr->plugin, s, group_count_x, group_count_y, group_count_z);
+}
+
 b8 renderer_shader_use(shader* s) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
-    return state_ptr->plugin.shader_use(&state_ptr->plugin, s);
+    renderer_bind_cache* cache = renderer_bind_cache_get(state_ptr);
+    if (cache->bound_shader == s) {
+        // Already bound, but a use always starts from the standard vertex format.
+        return state_ptr->plugin.shader_vertex_format_set(&state_ptr->plugin, s, GEOMETRY_VERTEX_FORMAT_STANDARD);
+    }
+
+    if (!state_ptr->plugin.shader_use(&state_ptr->plugin, s)) {
+        cache->bound_shader = 0;
+        return false;
+    }
+    cache->bound_shader = s;
+    renderer_bind_stat_add(&state_ptr->frame_bind_stats.shader_binds);
+    return true;
+}
+
+b8 renderer_shader_vertex_format_set(shader* s, geometry_vertex_format format) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.shader_vertex_format_set(&state_ptr->plugin, s, format);
 }
 
 b8 renderer_shader_bind_globals(shader* s) {
@@ -528,11 +1312,13 @@ b8 renderer_shader_bind_local(shader* s) {
 
 b8 renderer_shader_apply_globals(shader* s, b8 needs_update, frame_data* p_frame_data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_stat_add(&state_ptr->frame_bind_stats.descriptor_binds);
     return state_ptr->plugin.shader_apply_globals(&state_ptr->plugin, s, needs_update, p_frame_data);
 }
 
 b8 renderer_shader_apply_instance(shader* s, b8 needs_update, frame_data* p_frame_data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_stat_add(&state_ptr->frame_bind_stats.descriptor_binds);
     return state_ptr->plugin.shader_apply_instance(&state_ptr->plugin, s, needs_update, p_frame_data);
 }
 
@@ -559,7 +1345,7 @@ shader_uniform* renderer_shader_uniform_get(shader* s, const char* name) {
     }
 
     u16 uniform_index;
-    if (!hashtable_get(&s->uniform_lookup, name, &uniform_index)) {
+    if (!hashmap_get_u64(&s->uniform_lookup, kname_create(name), &uniform_index)) {
         KERROR("Shader '%s' does not contain a uniform named '%s'.", s->name, name);
         return false;
     }
@@ -577,6 +1363,16 @@ b8 renderer_shader_apply_local(shader* s, frame_data* p_frame_data) {
     return state_ptr->plugin.shader_apply_local(&state_ptr->plugin, s, p_frame_data);
 }
 
+b8 renderer_shader_local_block_push(shader* s, const void* block, u32 size) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.shader_local_block_push(&state_ptr->plugin, s, block, size);
+}
+
+b8 renderer_shader_variant_use(shader* s, u32 variant_index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.shader_variant_use(&state_ptr->plugin, s, variant_index);
+}
+
 b8 renderer_texture_map_resources_acquire(struct texture_map* map) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     return state_ptr->plugin.texture_map_resources_acquire(&state_ptr->plugin, map);
@@ -587,6 +1383,19 @@ void renderer_texture_map_resources_release(struct texture_map* map) {
     state_ptr->plugin.texture_map_resources_release(&state_ptr->plugin, map);
 }
 
+b8 renderer_bindless_textures_supported(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.bindless_textures_supported && state_ptr->plugin.texture_map_bindless_index_get && state_ptr->plugin.bindless_textures_supported(&state_ptr->plugin);
+}
+
+u32 renderer_texture_map_bindless_index_get(const struct texture_map* map) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!renderer_bindless_textures_supported() || !map) {
+        return INVALID_ID;
+    }
+    return state_ptr->plugin.texture_map_bindless_index_get(&state_ptr->plugin, map);
+}
+
 void renderer_render_target_create(u8 attachment_count, render_target_attachment* attachments, renderpass* pass, u32 width, u32 height, u16 layer_index, render_target* out_target) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     state_ptr->plugin.render_target_create(&state_ptr->plugin, attachment_count, attachments, pass, width, height, layer_index, out_target);
@@ -621,6 +1430,88 @@ u8 renderer_window_attachment_count_get(void) {
     return state_ptr->plugin.window_attachment_count_get(&state_ptr->plugin);
 }
 
+renderer_window* renderer_window_create(struct platform_window* platform_window) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!platform_window) {
+        return 0;
+    }
+    if (!state_ptr->plugin.window_create) {
+        KWARN("The renderer can only render to the main window.");
+        return 0;
+    }
+
+    renderer_window* window = kallocate(sizeof(renderer_window), MEMORY_TAG_RENDERER);
+    window->platform_window = platform_window;
+    u32 width = 0;
+    u32 height = 0;
+    platform_window_size_get(platform_window, &width, &height);
+    window->width = (u16)width;
+    window->height = (u16)height;
+    if (!state_ptr->plugin.window_create(&state_ptr->plugin, window)) {
+        KERROR("Failed to create renderer window.");
+        kfree(window, sizeof(renderer_window), MEMORY_TAG_RENDERER);
+        return 0;
+    }
+    return window;
+}
+
+void renderer_window_destroy(renderer_window* window) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (window) {
+        state_ptr->plugin.window_destroy(&state_ptr->plugin, window);
+        kfree(window, sizeof(renderer_window), MEMORY_TAG_RENDERER);
+    }
+}
+
+void renderer_window_resized(renderer_window* window, u16 width, u16 height) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (window) {
+        window->width = width;
+        window->height = height;
+        state_ptr->plugin.window_resized(&state_ptr->plugin, window);
+    }
+}
+
+b8 renderer_window_acquire(renderer_window* window) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!window) {
+        return true;
+    }
+    return state_ptr->plugin.window_acquire(&state_ptr->plugin, window);
+}
+
+texture* renderer_window_colour_get(renderer_window* window, u8 index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!window) {
+        return state_ptr->plugin.window_attachment_get(&state_ptr->plugin, index);
+    }
+    return state_ptr->plugin.window_colour_get(&state_ptr->plugin, window, index);
+}
+
+texture* renderer_window_depth_get(renderer_window* window, u8 index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!window) {
+        return state_ptr->plugin.depth_attachment_get(&state_ptr->plugin, index);
+    }
+    return state_ptr->plugin.window_depth_get(&state_ptr->plugin, window, index);
+}
+
+u8 renderer_window_image_index_get(renderer_window* window) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!window) {
+        return state_ptr->plugin.window_attachment_index_get(&state_ptr->plugin);
+    }
+    return state_ptr->plugin.window_image_index_get(&state_ptr->plugin, window);
+}
+
+u8 renderer_window_image_count_get(renderer_window* window) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!window) {
+        return state_ptr->plugin.window_attachment_count_get(&state_ptr->plugin);
+    }
+    return state_ptr->plugin.window_image_count_get(&state_ptr->plugin, window);
+}
+
 b8 renderer_renderpass_create(const renderpass_config* config, renderpass* out_renderpass) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     if (!config) {
@@ -633,6 +1524,11 @@ b8 renderer_renderpass_create(const renderpass_config* config, renderpass* out_r
         return false;
     }
 
+    if (config->view_count > 1 && !renderer_multiview_supported(config->view_count)) {
+        KERROR("Renderpass '%s' renders %u layers at once, which is not supported by the renderer.", config->name, config->view_count);
+        return false;
+    }
+
     out_renderpass->render_target_count = config->render_target_count;
     out_renderpass->targets = kallocate(sizeof(render_target) * out_renderpass->render_target_count, MEMORY_TAG_ARRAY);
     out_renderpass->clear_flags = config->clear_flags;
@@ -681,6 +1577,84 @@ b8 renderer_is_multithreaded(void) {
     return state_ptr->plugin.is_multithreaded(&state_ptr->plugin);
 }
 
+b8 renderer_command_lists_supported(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return state_ptr->plugin.command_list_begin && state_ptr->plugin.command_list_end && state_ptr->plugin.command_list_execute;
+}
+
+b8 renderer_command_list_begin(u8 index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.command_list_begin) {
+        KERROR("renderer_command_list_begin - the renderer does not support command lists.");
+        return false;
+    }
+    if (!state_ptr->plugin.command_list_begin(&state_ptr->plugin, index)) {
+        return false;
+    }
+    recording_command_list = true;
+    thread_active_viewport = state_ptr->active_viewport;
+    renderer_bind_cache_invalidate(state_ptr);
+    return true;
+}
+
+b8 renderer_command_list_end(u8 index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    recording_command_list = false;
+    thread_active_viewport = 0;
+    renderer_bind_cache_invalidate(state_ptr);
+    if (!state_ptr->plugin.command_list_end) {
+        KERROR("renderer_command_list_end - the renderer does not support command lists.");
+        return false;
+    }
+    return state_ptr->plugin.command_list_end(&state_ptr->plugin, index);
+}
+
+b8 renderer_command_list_execute(u8 index) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.command_list_execute) {
+        KERROR("renderer_command_list_execute - the renderer does not support command lists.");
+        return false;
+    }
+    // Whatever the command list bound is left bound afterwards.
+    renderer_bind_cache_invalidate(state_ptr);
+    return state_ptr->plugin.command_list_execute(&state_ptr->plugin, index);
+}
+
+b8 renderer_async_compute_begin(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.async_compute_begin || !state_ptr->plugin.async_compute_begin(&state_ptr->plugin)) {
+        return false;
+    }
+    // Nothing bound to the frame's command buffer is bound for the compute queue, and vice versa.
+    renderer_bind_cache_invalidate(state_ptr);
+    return true;
+}
+
+void renderer_async_compute_end(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (state_ptr->plugin.async_compute_end) {
+        state_ptr->plugin.async_compute_end(&state_ptr->plugin);
+        renderer_bind_cache_invalidate(state_ptr);
+    }
+}
+
+b8 renderer_async_compute_wait(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.async_compute_wait) {
+        return true;
+    }
+    // The commands which follow may be recorded to a new command buffer, which starts with nothing
+    // bound and no dynamic state set.
+    renderer_bind_cache_invalidate(state_ptr);
+    if (!state_ptr->plugin.async_compute_wait(&state_ptr->plugin)) {
+        return false;
+    }
+    if (state_ptr->active_viewport) {
+        renderer_active_viewport_set(state_ptr->active_viewport);
+    }
+    return true;
+}
+
 b8 renderer_flag_enabled_get(renderer_config_flags flag) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     return state_ptr->plugin.flag_enabled_get(&state_ptr->plugin, flag);
@@ -691,6 +1665,20 @@ void renderer_flag_enabled_set(renderer_config_flags flag, b8 enabled) {
     state_ptr->plugin.flag_enabled_set(&state_ptr->plugin, flag, enabled);
 }
 
+void renderer_swapchain_settings_get(renderer_swapchain_settings* out_settings) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    *out_settings = state_ptr->swapchain_settings;
+}
+
+void renderer_swapchain_settings_set(const renderer_swapchain_settings* settings) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    // Keep the kvars in line, so the settings aren't undone when they are next read.
+    kvar_int_set("present_mode", settings->present_mode);
+    kvar_int_set("swapchain_images", settings->image_count);
+    kvar_int_set("frames_in_flight", settings->frames_in_flight);
+    swapchain_settings_apply(state_ptr, settings);
+}
+
 b8 renderer_renderbuffer_create(const char* name, renderbuffer_type type, u64 total_size, renderbuffer_track_type track_type, renderbuffer* out_buffer) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     if (!out_buffer) {
@@ -714,9 +1702,9 @@ b8 renderer_renderbuffer_create(const char* name, renderbuffer_type type, u64 to
 
     // Create the freelist, if needed.
     if (track_type == RENDERBUFFER_TRACK_TYPE_FREELIST) {
-        freelist_create(total_size, &out_buffer->freelist_memory_requirement, 0, 0);
+        freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &out_buffer->freelist_memory_requirement, 0, 0);
         out_buffer->freelist_block = kallocate(out_buffer->freelist_memory_requirement, MEMORY_TAG_RENDERER);
-        freelist_create(total_size, &out_buffer->freelist_memory_requirement, out_buffer->freelist_block, &out_buffer->buffer_freelist);
+        freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &out_buffer->freelist_memory_requirement, out_buffer->freelist_block, &out_buffer->buffer_freelist);
     } else if (track_type == RENDERBUFFER_TRACK_TYPE_LINEAR) {
         out_buffer->offset = 0;
     }
@@ -732,6 +1720,7 @@ b8 renderer_renderbuffer_create(const char* name, renderbuffer_type type, u64 to
 
 void renderer_renderbuffer_destroy(renderbuffer* buffer) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_bind_cache_invalidate(state_ptr);
     if (buffer) {
         if (buffer->track_type == RENDERBUFFER_TRACK_TYPE_FREELIST) {
             freelist_destroy(&buffer->buffer_freelist);
@@ -799,7 +1788,7 @@ b8 renderer_renderbuffer_resize(renderbuffer* buffer, u64 new_total_size) {
     if (buffer->track_type == RENDERBUFFER_TRACK_TYPE_FREELIST) {
         // Resize the freelist first, if used.
         u64 new_memory_requirement = 0;
-        freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, 0, 0, 0);
+        freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, 0, new_total_size, 0);
         void* new_block = kallocate(new_memory_requirement, MEMORY_TAG_RENDERER);
         void* old_block = 0;
         if (!freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, new_block, new_total_size, &old_block)) {
@@ -814,6 +1803,8 @@ b8 renderer_renderbuffer_resize(renderbuffer* buffer, u64 new_total_size) {
         buffer->freelist_block = new_block;
     }
 
+    // Resizing replaces the internal buffer, so it must be bound again.
+    renderer_bind_cache_invalidate(state_ptr);
     b8 result = state_ptr->plugin.renderbuffer_resize(&state_ptr->plugin, buffer, new_total_size);
     if (result) {
         buffer->total_size = new_total_size;
@@ -885,14 +1876,97 @@ b8 renderer_renderbuffer_copy_range(renderbuffer* source, u64 source_offset, ren
     return state_ptr->plugin.renderbuffer_copy_range(&state_ptr->plugin, source, source_offset, dest, dest_offset, size);
 }
 
+void renderer_upload_synchronous_set(b8 synchronous) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (state_ptr->plugin.upload_synchronous_set) {
+        state_ptr->plugin.upload_synchronous_set(&state_ptr->plugin, synchronous);
+    }
+}
+
+b8 renderer_upload_wait(void) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!state_ptr->plugin.upload_wait) {
+        return true;
+    }
+    return state_ptr->plugin.upload_wait(&state_ptr->plugin);
+}
+
+// Obtains the entry of the bind cache tracking the binding of the given buffer. Returns false if its type isn't tracked.
+static b8 renderer_bind_cache_slot_get(renderer_bind_cache* cache, renderbuffer* buffer, renderbuffer*** out_buffer, u64** out_offset) {
+    switch (buffer->type) {
+        case RENDERBUFFER_TYPE_VERTEX:
+        case RENDERBUFFER_TYPE_DYNAMIC_VERTEX:
+            *out_buffer = &cache->vertex_buffer;
+            *out_offset = &cache->vertex_offset;
+            return true;
+        case RENDERBUFFER_TYPE_INDEX:
+            *out_buffer = &cache->index_buffer;
+            *out_offset = &cache->index_offset;
+            return true;
+        case RENDERBUFFER_TYPE_INSTANCE:
+        // Storage buffers can only be bound as per-instance data.
+        case RENDERBUFFER_TYPE_STORAGE:
+            *out_buffer = &cache->instance_buffer;
+            *out_offset = &cache->instance_offset;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Draws (or binds) a buffer, skipping binds of a buffer already bound at the same offset and keeping count of those made.
+static b8 renderer_renderbuffer_draw_tracked(renderer_system_state* state_ptr, renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count, b8 instanced, b8 bind_only) {
+    renderer_bind_cache* cache = renderer_bind_cache_get(state_ptr);
+    renderbuffer** bound_buffer = 0;
+    u64* bound_offset = 0;
+    b8 tracked = renderer_bind_cache_slot_get(cache, buffer, &bound_buffer, &bound_offset);
+    if (bind_only && tracked && *bound_buffer == buffer && *bound_offset == offset) {
+        return true;
+    }
+
+    b8 result;
+    if (!instanced) {
+        result = state_ptr->plugin.renderbuffer_draw(&state_ptr->plugin, buffer, offset, element_count, bind_only);
+    } else {
+        result = state_ptr->plugin.renderbuffer_draw_instanced(&state_ptr->plugin, buffer, offset, element_count, instance_count);
+    }
+    if (tracked) {
+        *bound_buffer = result ? buffer : 0;
+        *bound_offset = offset;
+    }
+    if (result) {
+        renderer_bind_stat_add(&state_ptr->frame_bind_stats.vertex_buffer_binds);
+        if (!bind_only) {
+            renderer_bind_stat_add(&state_ptr->frame_bind_stats.draw_calls);
+        }
+    }
+    return result;
+}
+
 b8 renderer_renderbuffer_draw(renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
-    return state_ptr->plugin.renderbuffer_draw(&state_ptr->plugin, buffer, offset, element_count, bind_only);
+    return renderer_renderbuffer_draw_tracked(state_ptr, buffer, offset, element_count, 1, false, bind_only);
+}
+
+b8 renderer_renderbuffer_draw_instanced(renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    return renderer_renderbuffer_draw_tracked(state_ptr, buffer, offset, element_count, instance_count, true, false);
+}
+
+void renderer_bind_stats_get(renderer_bind_stats* out_stats) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (out_stats) {
+        *out_stats = state_ptr->last_frame_bind_stats;
+    }
 }
 
 void renderer_active_viewport_set(viewport* v) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
-    state_ptr->active_viewport = v;
+    if (recording_command_list) {
+        thread_active_viewport = v;
+    } else {
+        state_ptr->active_viewport = v;
+    }
 
     // rect_2d viewport_rect = (vec4){v->rect.x, v->rect.height - v->rect.y, v->rect.width, -v->rect.height};
     rect_2d viewport_rect = (vec4){v->rect.x, v->rect.y + v->rect.height, v->rect.width, -v->rect.height};
@@ -904,5 +1978,5 @@ void renderer_active_viewport_set(viewport* v) {
 
 viewport* renderer_active_viewport_get(void) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
-    return state_ptr->active_viewport;
+    return recording_command_list ? thread_active_viewport : state_ptr->active_viewport;
 }
@@ -24,6 +24,8 @@ struct viewport;
 typedef struct renderer_system_config {
     char* application_name;
     renderer_plugin plugin;
+    /** @brief The number of frames the CPU may record ahead of the GPU. 0 uses the backend default. */
+    u8 frames_in_flight;
 } renderer_system_config;
 
 /**
@@ -141,6 +143,13 @@ KAPI void renderer_set_stencil_reference(u32 reference);
  */
 KAPI void renderer_set_depth_test_enabled(b8 enabled);
 
+/**
+ * @brief Set the comparison operator used for depth testing.
+ *
+ * @param compare_op The comparison operator to use for subsequent draws. Reset to less at the start of each frame.
+ */
+KAPI void renderer_set_depth_compare_op(renderer_compare_op compare_op);
+
 /**
  * @brief Set stencil operation.
  *
@@ -173,6 +182,24 @@ KAPI void renderer_set_stencil_write_mask(u32 write_mask);
  */
 KAPI void renderer_texture_create(const u8* pixels, struct texture* texture);
 
+/**
+ * @brief Creates a new layered texture, uploading each layer from its own pixel data. Saves
+ * gathering the layers into a single block for renderer_texture_create.
+ *
+ * @param layer_pixels An array of pointers to the raw image data of each layer, one per array_size of the texture.
+ * @param texture A pointer to the texture to be loaded.
+ */
+KAPI void renderer_texture_create_layered(const u8* const* layer_pixels, struct texture* texture);
+
+/**
+ * @brief Indicates if textures of the given format can be created. Uncompressed
+ * formats are always supported.
+ *
+ * @param format The texture format.
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_texture_format_supported(texture_format format);
+
 /**
  * @brief Destroys the given texture, releasing internal resources from the GPU.
  *
@@ -198,6 +225,36 @@ KAPI void renderer_texture_create_writeable(texture* t);
  */
 KAPI void renderer_texture_resize(texture* t, u32 new_width, u32 new_height);
 
+/**
+ * @brief Obtains a writeable attachment texture of the given description from the attachment pool,
+ * reusing a released one of the same description if there is one. Transient attachments are shared
+ * with other owners of the same description and slot. The returned pointer stays valid until released.
+ *
+ * @param name The name given to the texture if one is created. Suffixed with a number.
+ * @param desc A constant pointer to the description of the attachment.
+ * @return A pointer to the texture on success; otherwise 0.
+ */
+KAPI texture* renderer_attachment_acquire(const char* name, const renderer_attachment_desc* desc);
+
+/**
+ * @brief Releases an attachment texture obtained from the attachment pool. Once no owner holds it,
+ * it is kept for reuse for a while, or until GPU memory pressure, and then destroyed.
+ *
+ * @param t A pointer to the texture to be released.
+ */
+KAPI void renderer_attachment_release(texture* t);
+
+/**
+ * @brief Resizes an attachment texture obtained from the attachment pool, in place, so that pointers
+ * to it stay valid. Shared transient attachments are resized for every owner, so their owners are
+ * expected to follow the same size, such as that of the window. Data is lost.
+ *
+ * @param t A pointer to the texture to be resized.
+ * @param new_width The new width in pixels.
+ * @param new_height The new height in pixels.
+ */
+KAPI void renderer_attachment_resize(texture* t, u32 new_width, u32 new_height);
+
 /**
  * @brief Writes the given data to the provided texture.
  *
@@ -208,6 +265,19 @@ KAPI void renderer_texture_resize(texture* t, u32 new_width, u32 new_height);
  */
 KAPI void renderer_texture_write_data(texture* t, u32 offset, u32 size, const u8* pixels);
 
+/**
+ * @brief Writes the given pixels to a rectangle of the provided texture, leaving the rest of
+ * its contents as they were. The texture must have been written in full at least once beforehand.
+ *
+ * @param t A pointer to the texture to be written to. NOTE: Must be a writeable texture.
+ * @param x The x coordinate of the rectangle in pixels.
+ * @param y The y coordinate of the rectangle in pixels.
+ * @param width The width of the rectangle in pixels.
+ * @param height The height of the rectangle in pixels.
+ * @param pixels The raw image data of the rectangle, tightly packed row by row.
+ */
+KAPI void renderer_texture_write_region(texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels);
+
 /**
  * @brief Reads the given data from the provided texture.
  *
@@ -228,6 +298,31 @@ KAPI void renderer_texture_read_data(texture* t, u32 offset, u32 size, void** ou
  */
 KAPI void renderer_texture_read_pixel(texture* t, u32 x, u32 y, u8** out_rgba);
 
+/**
+ * @brief Requests a pixel from the provided texture at the given x/y coordinate without stalling
+ * on the GPU. The result is fetched with renderer_readback_resolve a few frames later, once the
+ * frame recording the copy has completed. Must be called while a frame is being recorded, outside
+ * of a renderpass.
+ *
+ * @param t A pointer to the texture to be read from. Must be a colour attachment last written by a renderpass in this frame.
+ * @param x The pixel x-coordinate.
+ * @param y The pixel y-coordinate.
+ * @param out_ticket A pointer to hold the ticket used to fetch the result.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_texture_read_pixel_async(texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket);
+
+/**
+ * @brief Fetches the result of an asynchronous read, if it is ready. Results remain available for
+ * at least one frame after becoming ready, and are only returned once.
+ *
+ * @param ticket The ticket of the read.
+ * @param size The number of bytes to be copied to out_data (sizeof(u8) * 4 for a pixel).
+ * @param out_data A pointer to a block of memory to hold the result.
+ * @return The status of the read. out_data is only written when it is ready.
+ */
+KAPI renderer_readback_status renderer_readback_resolve(renderer_readback_ticket ticket, u32 size, void* out_data);
+
 /**
  * @brief Attempts retrieve the renderer's internal buffer of the given type.
  * @param type The type of buffer to retrieve.
@@ -267,6 +362,26 @@ KAPI b8 renderer_geometry_upload(geometry* geometry);
  */
 KAPI void renderer_geometry_vertex_update(geometry* g, u32 offset, u32 vertex_count, void* vertices);
 
+/**
+ * @brief Moves the vertex and index data of the given geometry to lower offsets within the global
+ * geometry buffers, if there is room there, so that free space collects at the ends of the buffers.
+ * The data is copied on the GPU, and the geometry's offsets are updated right away, so this should
+ * be called between frames. The old ranges are freed once no frame in flight can still be reading them.
+ *
+ * @param g A pointer to the geometry to be moved. Must have been uploaded.
+ * @param out_moved A pointer to hold whether either range was moved.
+ * @returns True on success, including when nothing moved; otherwise false.
+ */
+KAPI b8 renderer_geometry_relocate(geometry* g, b8* out_moved);
+
+/**
+ * @brief Gets the fragmentation of the free space in the global geometry buffers, whichever is worse.
+ * NOTE: This walks the free lists, so use sparingly.
+ *
+ * @returns The fragmentation in the range [0, 1]. See freelist_fragmentation.
+ */
+KAPI f32 renderer_geometry_fragmentation(void);
+
 /**
  * @brief Destroys the given geometry, releasing GPU resources.
  *
@@ -274,6 +389,16 @@ KAPI void renderer_geometry_vertex_update(geometry* g, u32 offset, u32 vertex_co
  */
 KAPI void renderer_geometry_destroy(geometry* geometry);
 
+/**
+ * @brief Expands the given draw record into the render data needed to draw it, looking up its
+ * vertex and index ranges (for its level of detail) and material from its geometry.
+ *
+ * @param record A pointer to the draw record.
+ * @param models An array of persistent model matrices, indexed by the record's object index. If 0, the model is the identity.
+ * @param out_data A pointer to hold the render data.
+ */
+KAPI void renderer_geometry_draw_record_resolve(const geometry_draw_record* record, const mat4* models, geometry_render_data* out_data);
+
 /**
  * @brief Draws the given geometry. Should only be called inside a renderpass, within a frame.
  *
@@ -281,6 +406,128 @@ KAPI void renderer_geometry_destroy(geometry* geometry);
  */
 KAPI void renderer_geometry_draw(geometry_render_data* data);
 
+/**
+ * @brief Draws multiple instances of the given geometry in a single call. The per-instance
+ * data (i.e. model matrices) is read from the provided instance buffer, starting at
+ * instance_offset. Should only be called inside a renderpass, within a frame, using a
+ * shader which declares per-instance attributes.
+ *
+ * @param data The render data of the geometry to be drawn. The model matrix is ignored.
+ * @param instance_buffer A pointer to a buffer of type RENDERBUFFER_TYPE_INSTANCE or RENDERBUFFER_TYPE_STORAGE holding the per-instance data.
+ * @param instance_offset The offset in bytes from the beginning of the instance buffer.
+ * @param instance_count The number of instances to be drawn.
+ */
+KAPI void renderer_geometry_draw_instanced(geometry_render_data* data, renderbuffer* instance_buffer, u64 instance_offset, u32 instance_count);
+
+/**
+ * @brief Indicates if the renderer supports indirect geometry draws (see renderer_geometry_draw_indirect).
+ *
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_indirect_draw_supported(void);
+
+/**
+ * @brief Indicates if the renderer supports renderpasses which render the given number of layers
+ * of their attachments at once (see renderpass_config.view_count), so that each draw reaches all
+ * of them.
+ *
+ * @param view_count The number of layers to be rendered at once.
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_multiview_supported(u8 view_count);
+
+/**
+ * @brief Indicates if the renderer supports weighted blended order-independent transparency, which
+ * accumulates into several colour attachments with a different blend state each
+ * (see SHADER_FLAG_BLEND_WEIGHTED), in 16 bit float formats.
+ *
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_weighted_blend_supported(void);
+
+/**
+ * @brief Indicates if draws may be shaded at coarser rates than one fragment per pixel (see
+ * renderer_shading_rate_set), i.e. the renderer supports it and RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT
+ * is enabled.
+ *
+ * @return True if available; otherwise false.
+ */
+KAPI b8 renderer_variable_rate_shading_available(void);
+
+/**
+ * @brief Sets the rate at which subsequent draws are shaded, e.g. 2x2 for distant or low-detail
+ * surfaces. Does nothing where variable rate shading isn't available, so may always be called.
+ *
+ * @param rate The shading rate to use for subsequent draws. Reset to 1x1 at the start of each frame.
+ */
+KAPI void renderer_shading_rate_set(renderer_shading_rate rate);
+
+/**
+ * @brief Indicates if the renderer supports occlusion queries.
+ *
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_occlusion_queries_supported(void);
+
+/**
+ * @brief Begins an occlusion query, which counts the samples of the draws made until
+ * renderer_occlusion_query_end that pass the depth test. Only one may be open at a time, and
+ * each index may only be issued once per frame. Should only be called inside a renderpass.
+ *
+ * @param query_index The index of the query within the frame. Must be less than RENDERER_MAX_OCCLUSION_QUERIES.
+ * @return True if the query was begun; false if not, or if occlusion queries aren't supported.
+ */
+KAPI b8 renderer_occlusion_query_begin(u32 query_index);
+
+/**
+ * @brief Ends the occlusion query begun last with renderer_occlusion_query_begin.
+ */
+KAPI void renderer_occlusion_query_end(void);
+
+/**
+ * @brief Obtains the results of the occlusion queries of the most recent frame to have completed
+ * on the GPU with any queries issued, which is usually a frame or more behind the current one.
+ * Indices which weren't issued that frame are reported as visible.
+ *
+ * @param max_count The most results to be copied.
+ * @param out_visible An array of at least max_count to hold, for each query, 1 if any sample passed; otherwise 0.
+ * @param out_count A pointer to hold the number of results copied.
+ * @param out_frame_number A pointer to hold the renderer frame number the queries were issued in. 0 if there are no results yet.
+ * @return True on success; false if occlusion queries aren't supported.
+ */
+KAPI b8 renderer_occlusion_query_results_get(u32 max_count, u8* out_visible, u32* out_count, u64* out_frame_number);
+
+/**
+ * @brief Draws the given indexed geometries with as few calls as possible by writing a draw
+ * command for each into the provided indirect buffer and having the GPU read them from there.
+ * Draws whose vertex data shares a common alignment within the geometry vertex buffer go out
+ * in a single call. Any per-instance data must already be bound (see renderer_renderbuffer_draw).
+ * Should only be called inside a renderpass, within a frame.
+ *
+ * @param draw_count The number of draws to be made.
+ * @param draws An array of draws. Each geometry must be indexed.
+ * @param indirect_buffer A pointer to a buffer of type RENDERBUFFER_TYPE_INDIRECT to write commands into.
+ * @param indirect_offset The offset in bytes within the indirect buffer at which the commands are written. draw_count commands are written.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_geometry_draw_indirect(u32 draw_count, const renderer_indirect_draw* draws, renderbuffer* indirect_buffer, u64 indirect_offset);
+
+/**
+ * @brief Draws instances of the given indexed geometry using a single draw command already
+ * present in the given buffer, typically written by a compute shader so that the instance
+ * count never has to be read back. The command's first_index and vertex_offset are relative
+ * to the geometry's own index and vertex data. Requires indirect draw support. Should only be
+ * called inside a renderpass, within a frame, using a shader which declares per-instance attributes.
+ *
+ * @param data The render data of the geometry to be drawn. Must be indexed. The model matrix is ignored.
+ * @param instance_buffer A pointer to a buffer of type RENDERBUFFER_TYPE_INSTANCE or RENDERBUFFER_TYPE_STORAGE holding the per-instance data.
+ * @param instance_offset The offset in bytes from the beginning of the instance buffer.
+ * @param indirect_buffer A pointer to a buffer of type RENDERBUFFER_TYPE_INDIRECT or RENDERBUFFER_TYPE_STORAGE holding the command.
+ * @param indirect_offset The offset in bytes of the command within the indirect buffer.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_geometry_draw_indirect_instanced(geometry_render_data* data, renderbuffer* instance_buffer, u64 instance_offset, renderbuffer* indirect_buffer, u64 indirect_offset);
+
 /**
  * @brief Begins the given renderpass.
  *
@@ -323,15 +570,48 @@ KAPI void renderer_shader_destroy(struct shader* s);
  */
 KAPI b8 renderer_shader_initialize(struct shader* s);
 
+/**
+ * @brief Recreates the programs of an initialized shader from the current source of its stages,
+ * keeping its uniforms and instances. The shader is left as it was on failure.
+ *
+ * @param s A pointer to the shader to be reloaded.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_shader_reload(struct shader* s);
+
 /**
  * @brief Uses the given shader, activating it for updates to attributes, uniforms and such,
- * and for use in draw calls.
+ * and for use in draw calls. If the calling thread already has it bound within the current
+ * renderpass, it is not bound again, though its vertex format is reset to the standard one.
  *
  * @param s A pointer to the shader to be used.
  * @return True on success; otherwise false.
  */
 KAPI b8 renderer_shader_use(struct shader* s);
 
+/**
+ * @brief Selects the vertex layout the given shader draws with, which must be in use. Using a shader
+ * selects GEOMETRY_VERTEX_FORMAT_STANDARD.
+ *
+ * @param s A pointer to the shader.
+ * @param format The vertex format of the geometry to be drawn next.
+ * @return True on success; otherwise false (i.e. the shader has no packed vertex layout).
+ */
+KAPI b8 renderer_shader_vertex_format_set(struct shader* s, geometry_vertex_format format);
+
+/**
+ * @brief Dispatches the given compute shader, which must be in use and have its globals applied.
+ * Must be called outside of a renderpass. Writes made by the dispatch are made visible to
+ * subsequent vertex input, indirect draws and shader reads.
+ *
+ * @param s A pointer to the compute shader to dispatch.
+ * @param group_count_x The number of workgroups to dispatch in the x dimension.
+ * @param group_count_y The number of workgroups to dispatch in the y dimension.
+ * @param group_count_z The number of workgroups to dispatch in the z dimension.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_shader_dispatch(struct shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z);
+
 /**
  * @brief Binds global resources for use and updating.
  *
@@ -427,6 +707,25 @@ KAPI b8 renderer_shader_uniform_set(struct shader* s, struct shader_uniform* uni
  */
 KAPI b8 renderer_shader_apply_local(struct shader* s, frame_data* p_frame_data);
 
+/**
+ * @brief Uploads every local uniform of the given shader at once from a packed block.
+ *
+ * @param s A pointer to the shader.
+ * @param block A constant pointer to the block, laid out as the shader's local uniforms are.
+ * @param size The size of the block in bytes.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_shader_local_block_push(struct shader* s, const void* block, u32 size);
+
+/**
+ * @brief Binds the given variant of the given shader, which must be in use.
+ *
+ * @param s A pointer to the shader.
+ * @param variant_index The index of the variant within the shader's variants.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_shader_variant_use(struct shader* s, u32 variant_index);
+
 /**
  * @brief Acquires internal resources for the given texture map.
  *
@@ -442,6 +741,24 @@ KAPI b8 renderer_texture_map_resources_acquire(struct texture_map* map);
  */
 KAPI void renderer_texture_map_resources_release(struct texture_map* map);
 
+/**
+ * @brief Indicates if the renderer supports bindless textures, where shaders configured with
+ * bindless_textures=1 index a single global texture array instead of binding per-instance samplers.
+ *
+ * @return True if supported; otherwise false.
+ */
+KAPI b8 renderer_bindless_textures_supported(void);
+
+/**
+ * @brief Obtains the index of the given texture map within the global bindless texture array.
+ * The index remains valid until the map's resources are released. Textures which are swapped
+ * out (i.e. finish loading) are picked up automatically.
+ *
+ * @param map A pointer to the texture map whose resources have been acquired.
+ * @return The bindless index, or INVALID_ID if bindless textures are unsupported or the array is full.
+ */
+KAPI u32 renderer_texture_map_bindless_index_get(const struct texture_map* map);
+
 /**
  * @brief Creates a new render target using the provided data.
  *
@@ -489,6 +806,74 @@ KAPI u8 renderer_window_attachment_index_get(void);
  */
 KAPI u8 renderer_window_attachment_count_get(void);
 
+/**
+ * @brief Creates what is needed to render to the given window in addition to the main one. Every
+ * resource of the renderer is shared with it, so it only costs its own swapchain and render targets.
+ * Render to it with a rendergraph of its own (see rendergraph_window_set).
+ *
+ * @param platform_window A pointer to the platform window to render to.
+ * @return A pointer to the renderer window if successful; otherwise 0, including if the renderer can only render to the main window.
+ */
+KAPI renderer_window* renderer_window_create(struct platform_window* platform_window);
+
+/**
+ * @brief Destroys the given renderer window. The platform window it rendered to is left as it is.
+ *
+ * @param window A pointer to the window to destroy.
+ */
+KAPI void renderer_window_destroy(renderer_window* window);
+
+/**
+ * @brief Notes that the given window was resized, i.e. on EVENT_CODE_WINDOW_RESIZED. Its attachments
+ * are recreated the next time it is acquired.
+ *
+ * @param window A pointer to the window.
+ * @param width The new width of the window.
+ * @param height The new height of the window.
+ */
+KAPI void renderer_window_resized(renderer_window* window, u16 width, u16 height);
+
+/**
+ * @brief Acquires the image of the given window to render to in the current frame, which is then
+ * presented along with the main window's. Must be called after the frame has been prepared.
+ *
+ * @param window A pointer to the window. 0 refers to the main window, which is always acquired.
+ * @return True if the window can be rendered to this frame; otherwise false.
+ */
+KAPI b8 renderer_window_acquire(renderer_window* window);
+
+/**
+ * @brief Obtains the colour attachment of the given window at the given index.
+ *
+ * @param window A pointer to the window. 0 refers to the main window.
+ * @param index The index of the attachment. Must be less than the window's attachment count.
+ * @return A pointer to the attachment if successful; otherwise 0.
+ */
+KAPI texture* renderer_window_colour_get(renderer_window* window, u8 index);
+
+/**
+ * @brief Obtains the depth attachment of the given window at the given index.
+ *
+ * @param window A pointer to the window. 0 refers to the main window.
+ * @param index The index of the attachment. Must be less than the window's attachment count.
+ * @return A pointer to the attachment if successful; otherwise 0.
+ */
+KAPI texture* renderer_window_depth_get(renderer_window* window, u8 index);
+
+/**
+ * @brief Returns the index of the attachments of the given window acquired for the current frame.
+ *
+ * @param window A pointer to the window. 0 refers to the main window.
+ */
+KAPI u8 renderer_window_image_index_get(renderer_window* window);
+
+/**
+ * @brief Returns the number of attachments of the given window.
+ *
+ * @param window A pointer to the window. 0 refers to the main window.
+ */
+KAPI u8 renderer_window_image_count_get(renderer_window* window);
+
 /**
  * @brief Creates a new renderpass.
  *
@@ -509,6 +894,63 @@ KAPI void renderer_renderpass_destroy(renderpass* pass);
  */
 KAPI b8 renderer_is_multithreaded(void);
 
+/**
+ * @brief Indicates if the renderer supports recording command lists on multiple threads.
+ */
+KAPI b8 renderer_command_lists_supported(void);
+
+/**
+ * @brief Begins recording the command list at the given index on the calling thread.
+ * The active viewport set on this thread while recording applies only to this thread,
+ * and starts out as the viewport active when the list is begun.
+ *
+ * @param index The index of the list to begin. Must be less than RENDERER_MAX_COMMAND_LISTS.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_command_list_begin(u8 index);
+
+/**
+ * @brief Ends recording of the command list at the given index on the calling thread.
+ *
+ * @param index The index of the list to end.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_command_list_end(u8 index);
+
+/**
+ * @brief Executes the commands recorded into the given list as part of the current frame.
+ * Must be called from the thread recording the frame.
+ *
+ * @param index The index of the list to execute.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_command_list_execute(u8 index);
+
+/**
+ * @brief Begins recording compute work for the async compute queue, where it overlaps with the
+ * graphics work recorded before the next call to renderer_async_compute_wait. Only dispatches may
+ * be recorded until renderer_async_compute_end is called, and only for work which does not read
+ * anything written by the frame's graphics work.
+ *
+ * @return True if compute work is now recorded for the async compute queue; false if it should be
+ * recorded inline instead, in which case renderer_async_compute_end must not be called.
+ */
+KAPI b8 renderer_async_compute_begin(void);
+
+/**
+ * @brief Ends recording compute work for the async compute queue.
+ */
+KAPI void renderer_async_compute_end(void);
+
+/**
+ * @brief Makes the commands recorded from here on wait for the compute work recorded for the async
+ * compute queue. Call before recording anything which consumes its results. Does nothing if there is
+ * no such work pending. Must be called outside of a renderpass.
+ *
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_async_compute_wait(void);
+
 /**
  * @brief Indicates if the provided renderer flag is enabled. If multiple
  * flags are passed, all must be set for this to return true.
@@ -526,6 +968,20 @@ KAPI b8 renderer_flag_enabled_get(renderer_config_flags flag);
  */
 KAPI void renderer_flag_enabled_set(renderer_config_flags flag, b8 enabled);
 
+/**
+ * @brief Obtains the swapchain settings currently requested.
+ *
+ * @param out_settings A pointer to hold the settings.
+ */
+KAPI void renderer_swapchain_settings_get(renderer_swapchain_settings* out_settings);
+/**
+ * @brief Requests new swapchain settings, updating the "present_mode", "swapchain_images" and
+ * "frames_in_flight" kvars to match. The swapchain is recreated with them as the next frame is prepared.
+ *
+ * @param settings A constant pointer to the settings.
+ */
+KAPI void renderer_swapchain_settings_set(const renderer_swapchain_settings* settings);
+
 /**
  * @brief Creates a new renderbuffer to hold data for a given purpose/use. Backed by a
  * renderer-backend-specific buffer resource.
@@ -655,6 +1111,7 @@ KAPI b8 renderer_renderbuffer_load_range(renderbuffer* buffer, u64 offset, u64 s
 
 /**
  * @brief Copies data in the specified rage fron the source to the destination buffer.
+ * The copy is ordered with uploads, and completes before any work submitted afterward.
  *
  * @param source A pointer to the source buffer to copy data from.
  * @param source_offset The offset in bytes from the beginning of the source buffer.
@@ -665,9 +1122,27 @@ KAPI b8 renderer_renderbuffer_load_range(renderbuffer* buffer, u64 offset, u64 s
  */
 KAPI b8 renderer_renderbuffer_copy_range(renderbuffer* source, u64 source_offset, renderbuffer* dest, u64 dest_offset, u64 size);
 
+/**
+ * @brief Sets whether each upload (texture writes, buffer loads and geometry uploads) is submitted
+ * and waited on as soon as it is made, rather than being batched with the others and submitted
+ * without waiting. Uploads are batched by default; this exists to compare the two.
+ *
+ * @param synchronous Indicates if uploads should be synchronous.
+ */
+KAPI void renderer_upload_synchronous_set(b8 synchronous);
+
+/**
+ * @brief Submits any pending uploads and waits for every upload made so far to complete.
+ *
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 renderer_upload_wait(void);
+
 /**
  * @brief Attempts to draw the contents of the provided buffer at the given offset
- * and element count. Only meant to be used with vertex and index buffers.
+ * and element count. Only meant to be used with vertex and index buffers. Instance
+ * buffers may also be passed, but can only be bound (bind_only must be true). Binding
+ * a buffer which the calling thread already has bound at the same offset is skipped.
  *
  * @param buffer A pointer to the buffer to be drawn.
  * @param offset The offset in bytes from the beginning of the buffer.
@@ -677,6 +1152,27 @@ KAPI b8 renderer_renderbuffer_copy_range(renderbuffer* source, u64 source_offset
  */
 KAPI b8 renderer_renderbuffer_draw(renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only);
 
+/**
+ * @brief Attempts to draw the given number of instances of the contents of the provided
+ * buffer at the given offset and element count. Only meant to be used with vertex and
+ * index buffers. Per-instance data must be bound beforehand (see renderer_renderbuffer_draw).
+ *
+ * @param buffer A pointer to the buffer to be drawn.
+ * @param offset The offset in bytes from the beginning of the buffer.
+ * @param element_count The number of elements to be drawn.
+ * @param instance_count The number of instances to be drawn.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 renderer_renderbuffer_draw_instanced(renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count);
+
+/**
+ * @brief Obtains the counts of state changes made by the renderer over the last complete frame.
+ * Useful to measure how well draws are sorted to share state.
+ *
+ * @param out_stats A pointer to hold the counts.
+ */
+KAPI void renderer_bind_stats_get(renderer_bind_stats* out_stats);
+
 /**
  * @brief Returns a pointer to the currently active viewport.
  */
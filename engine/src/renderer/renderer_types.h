@@ -13,6 +13,26 @@ struct viewport;
 struct camera;
 struct material;
 
+/** @brief The maximum number of command lists which may be recorded in parallel. */
+#define RENDERER_MAX_COMMAND_LISTS 8
+
+/** @brief The maximum number of occlusion queries which may be issued in a single frame. */
+#define RENDERER_MAX_OCCLUSION_QUERIES 1024
+
+/**
+ * @brief The size of the block of pixels shaded by a single fragment shader invocation, where
+ * variable rate shading is supported and enabled (see renderer_shading_rate_set).
+ */
+typedef enum renderer_shading_rate {
+    /** @brief Every pixel is shaded. The default. */
+    RENDERER_SHADING_RATE_1X1 = 0,
+    RENDERER_SHADING_RATE_1X2,
+    RENDERER_SHADING_RATE_2X1,
+    RENDERER_SHADING_RATE_2X2,
+    /** @brief Falls back to 2x2 where blocks this large aren't supported. */
+    RENDERER_SHADING_RATE_4X4
+} renderer_shading_rate;
+
 typedef struct geometry_render_data {
     mat4 model;
     // TODO: keep material id/handle instead.
@@ -21,6 +41,20 @@ typedef struct geometry_render_data {
     u64 unique_id;
     b8 winding_inverted;
     vec4 diffuse_colour;
+    /**
+     * @brief The index of this object's entry in a persistent GPU object buffer, for
+     * shaders which read their transforms from one rather than from the model above.
+     */
+    u32 object_index;
+    /**
+     * @brief The center of a world-space sphere enclosing the geometry, for passes which cull
+     * by screen coverage.
+     */
+    vec3 bounds_center;
+    /** @brief The radius of the sphere about bounds_center. 0 if unknown, in which case it is never culled. */
+    f32 bounds_radius;
+    /** @brief The rate the geometry may be shaded at, for passes which draw it on its own. 1x1 by default. */
+    renderer_shading_rate shading_rate;
 
     /** @brief The vertex count. */
     u32 vertex_count;
@@ -28,6 +62,11 @@ typedef struct geometry_render_data {
     u32 vertex_element_size;
     /** @brief The offset from the beginning of the vertex buffer. */
     u64 vertex_buffer_offset;
+    /**
+     * @brief The layout of the vertex data. For packed vertices, the model above already includes
+     * the transform out of the geometry's quantization box.
+     */
+    geometry_vertex_format vertex_format;
 
     /** @brief The index count. */
     u32 index_count;
@@ -35,8 +74,118 @@ typedef struct geometry_render_data {
     u32 index_element_size;
     /** @brief The offset from the beginning of the index buffer. */
     u64 index_buffer_offset;
+    /**
+     * @brief The key this geometry is drawn in order of, lowest first. See render_sort_key_create.
+     */
+    u64 sort_key;
 } geometry_render_data;
 
+/**
+ * @brief A compact record of a single draw of a persistent geometry, as kept in per-frame render
+ * lists. Everything else needed to draw it is looked up from the geometry itself and from the
+ * persistent arrays indexed by object_index. See renderer_geometry_draw_record_resolve.
+ */
+typedef struct geometry_draw_record {
+    /** @brief The key this geometry is drawn in order of, lowest first. See render_sort_key_create. */
+    u64 sort_key;
+    /** @brief The geometry to be drawn, whose material it is drawn with. */
+    struct geometry* geometry;
+    /** @brief The index of this object's transform, and of its entry in a persistent GPU object buffer. */
+    u32 object_index;
+    /** @brief The level of detail of the geometry to draw. Ignored if the geometry has none. */
+    u16 lod;
+    /** @brief Indicates if the object's transform inverts its winding order. */
+    b8 winding_inverted;
+    /** @brief If index_count is not 0, the index of the first index to draw, e.g. of a run of visible clusters. */
+    u32 first_index;
+    /** @brief The number of indices to draw. If 0, every index of the level of detail is drawn. */
+    u32 index_count;
+} geometry_draw_record;
+
+/**
+ * @brief The layers a pass's geometries are drawn in, in order. The layer is the highest part of
+ * a render sort key, so all geometries of one layer are drawn before any of the next.
+ */
+typedef enum render_sort_layer {
+    /** @brief Opaque geometries, sorted to minimize state changes and then front to back. */
+    RENDER_SORT_LAYER_OPAQUE = 0,
+    /** @brief Transparent geometries, sorted back to front and then to minimize state changes. */
+    RENDER_SORT_LAYER_TRANSPARENT = 1,
+    /**
+     * @brief Transparent geometries composited with weighted blended order-independent transparency.
+     * Their order does not matter, so they are sorted to minimize state changes like opaque ones.
+     */
+    RENDER_SORT_LAYER_WEIGHTED_BLENDED = 2
+} render_sort_layer;
+
+/**
+ * @brief Describes an attachment texture obtained from the renderer's attachment pool. Pooled
+ * textures of the same description are interchangeable, so released ones are reused by owners
+ * asking for the same description rather than destroyed and created again.
+ */
+typedef struct renderer_attachment_desc {
+    texture_type type;
+    u32 width;
+    u32 height;
+    texture_format format;
+    u8 channel_count;
+    /** @brief Flags of the texture. Pooled textures are always writeable. */
+    texture_flag_bits flags;
+    /**
+     * @brief Indicates the contents are only needed between being written and read within a single
+     * execution of a rendergraph. Transient attachments of the same description are shared by every
+     * owner asking for one, as rendergraphs are executed one after another.
+     */
+    b8 transient;
+    /**
+     * @brief The render target index the attachment is used by. Transient attachments are only shared
+     * within the same slot, so that frames in flight never share one.
+     */
+    u8 slot;
+} renderer_attachment_desc;
+
+/**
+ * @brief Counts of the state changes made by the renderer over a frame. Binds skipped because the
+ * state was already bound are not counted.
+ */
+typedef struct renderer_bind_stats {
+    /** @brief The number of times a shader (i.e. its pipeline) was bound. */
+    u32 shader_binds;
+    /** @brief The number of times global or instance descriptors were bound. */
+    u32 descriptor_binds;
+    /** @brief The number of times a vertex or index buffer was bound. */
+    u32 vertex_buffer_binds;
+    /** @brief The number of draw calls, including indirect ones. */
+    u32 draw_calls;
+} renderer_bind_stats;
+
+/**
+ * @brief A single indexed indirect draw command, as read by the GPU from an
+ * indirect renderbuffer. Layout-compatible with VkDrawIndexedIndirectCommand.
+ */
+typedef struct renderer_indirect_draw_command {
+    /** @brief The number of indices to draw. */
+    u32 index_count;
+    /** @brief The number of instances to draw. */
+    u32 instance_count;
+    /** @brief The first index, in elements, within the bound index buffer. */
+    u32 first_index;
+    /** @brief The offset, in vertices, added to each index before indexing into the bound vertex buffer. */
+    i32 vertex_offset;
+    /** @brief The first instance, in elements, within the bound instance buffer. */
+    u32 first_instance;
+} renderer_indirect_draw_command;
+
+/** @brief A single draw to be submitted via renderer_geometry_draw_indirect. */
+typedef struct renderer_indirect_draw {
+    /** @brief The record of the geometry to be drawn. Must be indexed. */
+    const geometry_draw_record* record;
+    /** @brief The number of instances to draw. */
+    u32 instance_count;
+    /** @brief The first instance, in elements, within the bound instance buffer. */
+    u32 first_instance;
+} renderer_indirect_draw;
+
 typedef enum renderer_debug_view_mode {
     RENDERER_VIEW_MODE_DEFAULT = 0,
     RENDERER_VIEW_MODE_LIGHTING = 1,
@@ -52,12 +201,17 @@ typedef enum render_target_attachment_type {
 
 typedef enum render_target_attachment_source {
     RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT = 0x1,
-    RENDER_TARGET_ATTACHMENT_SOURCE_SELF = 0x2
+    RENDER_TARGET_ATTACHMENT_SOURCE_SELF = 0x2,
+    // The rendergraph's colour target for passes rendered at a scaled resolution, the size of the
+    // window attachment it stands in for.
+    RENDER_TARGET_ATTACHMENT_SOURCE_SCALED = 0x4
 } render_target_attachment_source;
 
 typedef enum render_target_attachment_load_operation {
     RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE = 0x0,
-    RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD = 0x1
+    RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD = 0x1,
+    /** @brief Cleared to zero when the renderpass begins, regardless of the clear flags of the pass. Colour attachments only. */
+    RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_CLEAR = 0x2
 } render_target_attachment_load_operation;
 
 typedef enum render_target_attachment_store_operation {
@@ -111,12 +265,34 @@ typedef enum renderer_compare_op {
     RENDERER_COMPARE_OP_ALWAYS = 7
 } renderer_compare_op;
 
+/**
+ * @brief Describes how the contents of an attachment are used once a renderpass
+ * has finished writing them. Determines the layout the attachment is left in,
+ * whether its contents are stored and the barriers required.
+ */
+typedef enum render_target_attachment_usage {
+    /** @brief Not known; layouts are derived from the attachment configuration alone. */
+    RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN = 0,
+    /** @brief Not read by any later renderpass. */
+    RENDER_TARGET_ATTACHMENT_USAGE_DISCARD,
+    /** @brief Rendered to again by a later renderpass. */
+    RENDER_TARGET_ATTACHMENT_USAGE_ATTACHMENT,
+    /** @brief Sampled by a shader in a later renderpass. */
+    RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED,
+    /** @brief Presented once the frame is complete. Colour attachments only. */
+    RENDER_TARGET_ATTACHMENT_USAGE_PRESENT
+} render_target_attachment_usage;
+
 typedef struct render_target_attachment_config {
     render_target_attachment_type type;
     render_target_attachment_source source;
     render_target_attachment_load_operation load_operation;
     render_target_attachment_store_operation store_operation;
     b8 present_after;
+    /** @brief The format of a self-owned colour attachment. Others use the format of their source. */
+    texture_format format;
+    /** @brief How a colour attachment is used afterward. If unknown, the usage inferred for the pass by the rendergraph is used. */
+    render_target_attachment_usage usage;
 } render_target_attachment_config;
 
 typedef struct render_target_config {
@@ -139,8 +315,10 @@ typedef struct render_target {
     u8 attachment_count;
     /** @brief An array of attachments. */
     struct render_target_attachment* attachments;
-    /** @brief The renderer API internal framebuffer object. */
+    /** @brief The renderer API internal framebuffer object. 0 if the renderer API needs none. */
     void* internal_framebuffer;
+    /** @brief The layer of the attachments' textures rendered to, for textures with several layers. */
+    u16 layer_index;
 } render_target;
 
 /**
@@ -176,6 +354,13 @@ typedef struct renderpass_config {
     u8 render_target_count;
     /** @brief The render target configuration. */
     render_target_config target;
+
+    /**
+     * @brief The number of layers of the attachments rendered at once, each draw reaching all of
+     * them (see renderer_multiview_supported). Shaders select their layer by view index. 0 or 1
+     * to render to a single layer as usual.
+     */
+    u8 view_count;
 } renderpass_config;
 
 /**
@@ -199,6 +384,22 @@ typedef struct renderpass {
     /** @brief An array of render targets used by this renderpass. */
     render_target* targets;
 
+    /**
+     * @brief How the colour output of this renderpass is used afterward. Inferred by the
+     * rendergraph before the renderpass is created. Overrides present_after when known.
+     */
+    render_target_attachment_usage colour_usage;
+    /** @brief How the depth/stencil output of this renderpass is used afterward. @see colour_usage */
+    render_target_attachment_usage depth_stencil_usage;
+    /**
+     * @brief Indicates no earlier output is continued into the colour attachments, so their previous
+     * contents are never needed and are not loaded, whatever the attachment configuration. Inferred by
+     * the rendergraph before the renderpass is created.
+     */
+    b8 colour_contents_discarded;
+    /** @brief Indicates the previous depth/stencil contents are never needed. @see colour_contents_discarded */
+    b8 depth_stencil_contents_discarded;
+
     /** @brief Internal renderpass data */
     void* internal_data;
 } renderpass;
@@ -217,7 +418,13 @@ typedef enum renderbuffer_type {
     /** @brief Buffer is used for reading purposes (i.e copy to from device local, then read) */
     RENDERBUFFER_TYPE_READ,
     /** @brief Buffer is used for data storage. */
-    RENDERBUFFER_TYPE_STORAGE
+    RENDERBUFFER_TYPE_STORAGE,
+    /** @brief Buffer is used for per-instance vertex data (i.e. transforms), written by the host every frame. */
+    RENDERBUFFER_TYPE_INSTANCE,
+    /** @brief Buffer is used for indirect draw commands (see renderer_indirect_draw_command), written by the host every frame. */
+    RENDERBUFFER_TYPE_INDIRECT,
+    /** @brief Buffer is used for vertex data written by the host every frame (i.e. immediate-mode debug drawing). Drawn like a vertex buffer. */
+    RENDERBUFFER_TYPE_DYNAMIC_VERTEX
 } renderbuffer_type;
 
 typedef enum renderbuffer_track_type {
@@ -252,16 +459,57 @@ typedef enum renderer_config_flag_bits {
     RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT = 0x1,
     /** @brief Configures the renderer backend in a way that conserves power where possible. */
     RENDERER_CONFIG_FLAG_POWER_SAVING_BIT = 0x2,
+    /** @brief Allows draws to be shaded at coarser rates than one fragment per pixel, where supported. */
+    RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT = 0x4,
 } renderer_config_flag_bits;
 
 typedef u32 renderer_config_flags;
 
+/** @brief How finished frames are handed to the display. */
+typedef enum renderer_present_mode {
+    /** @brief Chosen from the vsync and power saving flags. */
+    RENDERER_PRESENT_MODE_AUTO = 0,
+    /** @brief Waits for vertical blank, queueing frames. Always supported. */
+    RENDERER_PRESENT_MODE_FIFO = 1,
+    /** @brief Waits for vertical blank, but presents a late frame immediately, allowing tearing. */
+    RENDERER_PRESENT_MODE_FIFO_RELAXED = 2,
+    /** @brief Waits for vertical blank, replacing the queued frame with the newest one. */
+    RENDERER_PRESENT_MODE_MAILBOX = 3,
+    /** @brief Presents immediately, allowing tearing. */
+    RENDERER_PRESENT_MODE_IMMEDIATE = 4,
+} renderer_present_mode;
+
+/** @brief Settings controlling the window's swapchain. Changing them recreates it. */
+typedef struct renderer_swapchain_settings {
+    /** @brief The present mode. Falls back to FIFO if unsupported. */
+    renderer_present_mode present_mode;
+    /**
+     * @brief The number of swapchain images. 0 uses the backend default. Clamped to what the surface
+     * supports, and never more than the number of window attachments the renderer started with.
+     */
+    u8 image_count;
+    /** @brief The number of frames the CPU may record ahead of the GPU. 0 uses the backend default. */
+    u8 frames_in_flight;
+} renderer_swapchain_settings;
+
 /** @brief The generic configuration for a renderer backend. */
 typedef struct renderer_backend_config {
     /** @brief The name of the application */
     const char* application_name;
     /** @brief Various configuration flags for renderer backend setup. */
     renderer_config_flags flags;
+    /**
+     * @brief The number of frames the CPU may record ahead of the GPU. Higher values smooth out
+     * spikes at the cost of latency. Clamped by the backend. 0 uses the backend default.
+     */
+    u8 frames_in_flight;
+    /** @brief The present mode to start with. */
+    renderer_present_mode present_mode;
+    /**
+     * @brief The number of swapchain images to start with, which is also the most that may be used
+     * later on. 0 uses the backend default.
+     */
+    u8 swapchain_image_count;
 } renderer_backend_config;
 
 /** @brief The winding order of vertices, used to determine what is the front-face of a triangle. */
@@ -302,6 +550,39 @@ typedef struct shader_instance_resource_config {
  * The frontend only interacts via this structure and has no knowledge of
  * the way things actually work on the backend.
  */
+/**
+ * @brief Identifies an asynchronous GPU readback, such as a pixel read for picking.
+ * INVALID_ID_U64 if none.
+ */
+typedef u64 renderer_readback_ticket;
+
+/** @brief The status of an asynchronous GPU readback. */
+typedef enum renderer_readback_status {
+    /** @brief The ticket is unknown, has already been resolved, or expired before being resolved. */
+    RENDERER_READBACK_STATUS_INVALID,
+    /** @brief The frame containing the copy has not completed on the GPU yet. */
+    RENDERER_READBACK_STATUS_PENDING,
+    /** @brief The result is available. */
+    RENDERER_READBACK_STATUS_READY
+} renderer_readback_status;
+
+/**
+ * @brief A window rendered to in addition to the main one. It shares the device and every resource
+ * of the renderer, so only its swapchain and the render targets using it are its own.
+ */
+typedef struct renderer_window {
+    /** @brief The platform window rendered to. */
+    struct platform_window* platform_window;
+    /** @brief The current width of the window. */
+    u16 width;
+    /** @brief The current height of the window. */
+    u16 height;
+    /** @brief Incremented whenever the window's attachments are recreated, after which render targets using them must be regenerated. */
+    u32 attachment_generation;
+    /** @brief The backend's data for the window. */
+    void* internal_data;
+} renderer_window;
+
 typedef struct renderer_plugin {
     /** @brief The current frame number. */
     u64 frame_number;
@@ -440,6 +721,14 @@ typedef struct renderer_plugin {
      */
     void (*set_depth_test_enabled)(struct renderer_plugin* plugin, b8 enabled);
 
+    /**
+     * @brief Set the comparison operator used for depth testing.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param compare_op The comparison operator to use for subsequent draws. Reset to less at the start of each frame.
+     */
+    void (*set_depth_compare_op)(struct renderer_plugin* plugin, renderer_compare_op compare_op);
+
     /**
      * @brief Set the stencil reference for testing.
      *
@@ -503,6 +792,25 @@ typedef struct renderer_plugin {
      */
     void (*texture_create)(struct renderer_plugin* plugin, const u8* pixels, struct texture* texture);
 
+    /**
+     * @brief Creates a renderer-backend-API-specific layered texture, with the pixels of each
+     * layer given separately rather than in a single block.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param layer_pixels An array of pointers to the raw image data of each layer, one per array_size of the texture.
+     * @param texture A pointer to the texture to hold the resources.
+     */
+    void (*texture_create_layered)(struct renderer_plugin* plugin, const u8* const* layer_pixels, struct texture* texture);
+
+    /**
+     * @brief Indicates if textures of the given format can be created.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param format The texture format.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*texture_format_supported)(struct renderer_plugin* plugin, texture_format format);
+
     /**
      * @brief Destroys the given texture, releasing internal resources.
      *
@@ -545,6 +853,21 @@ typedef struct renderer_plugin {
      */
     void (*texture_write_data)(struct renderer_plugin* plugin, texture* t, u32 offset, u32 size, const u8* pixels);
 
+    /**
+     * @brief Writes the given pixels to a rectangle of the base level of the provided texture,
+     * leaving the rest of its contents as they were. The texture must have been written in full
+     * at least once beforehand.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param t A pointer to the texture to be written to.
+     * @param x The x coordinate of the rectangle in pixels.
+     * @param y The y coordinate of the rectangle in pixels.
+     * @param width The width of the rectangle in pixels.
+     * @param height The height of the rectangle in pixels.
+     * @param pixels The raw image data of the rectangle, tightly packed row by row.
+     */
+    void (*texture_write_region)(struct renderer_plugin* plugin, texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels);
+
     /**
      * @brief Reads the given data from the provided texture.
      *
@@ -567,6 +890,32 @@ typedef struct renderer_plugin {
      */
     void (*texture_read_pixel)(struct renderer_plugin* plugin, texture* t, u32 x, u32 y, u8** out_rgba);
 
+    /**
+     * @brief Requests a pixel of the provided texture at the given x/y coordinate without waiting on
+     * the GPU. The copy is recorded into the current frame, and its result is fetched with
+     * readback_resolve once that frame has completed.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param t A pointer to the texture to be read from. Must be a colour attachment last written by a renderpass in this frame.
+     * @param x The pixel x-coordinate.
+     * @param y The pixel y-coordinate.
+     * @param out_ticket A pointer to hold the ticket used to fetch the result.
+     * @return True on success; false if no more reads can be requested this frame.
+     */
+    b8 (*texture_read_pixel_async)(struct renderer_plugin* plugin, texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket);
+
+    /**
+     * @brief Fetches the result of an asynchronous read, if it is ready. A ready result is only
+     * returned once, after which its ticket becomes invalid.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param ticket The ticket of the read.
+     * @param size The number of bytes to be copied to out_data.
+     * @param out_data A pointer to a block of memory to hold the result.
+     * @return The status of the read. out_data is only written when it is ready.
+     */
+    renderer_readback_status (*readback_resolve)(struct renderer_plugin* plugin, renderer_readback_ticket ticket, u32 size, void* out_data);
+
     /**
      * @brief Creates internal shader resources using the provided parameters.
      *
@@ -596,6 +945,16 @@ typedef struct renderer_plugin {
      */
     b8 (*shader_initialize)(struct renderer_plugin* plugin, struct shader* shader);
 
+    /**
+     * @brief Recreates the programs of an initialized shader from the current source of its
+     * stages, keeping all other resources. The shader is left as it was on failure.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param s A pointer to the shader to be reloaded.
+     * @return True on success; otherwise false.
+     */
+    b8 (*shader_reload)(struct renderer_plugin* plugin, struct shader* shader);
+
     /**
      * @brief Uses the given shader, activating it for updates to attributes, uniforms and such,
      * and for use in draw calls.
@@ -606,6 +965,16 @@ typedef struct renderer_plugin {
      */
     b8 (*shader_use)(struct renderer_plugin* plugin, struct shader* shader);
 
+    /**
+     * @brief Selects the vertex layout the given shader draws with, which must be in use.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param s A pointer to the shader.
+     * @param format The vertex format of the geometry to be drawn next.
+     * @return True on success; otherwise false.
+     */
+    b8 (*shader_vertex_format_set)(struct renderer_plugin* plugin, struct shader* s, geometry_vertex_format format);
+
     /**
      * @brief Binds global resources for use and updating.
      *
@@ -690,6 +1059,41 @@ typedef struct renderer_plugin {
 
     b8 (*shader_apply_local)(struct renderer_plugin* plugin, struct shader* s, struct frame_data* p_frame_data);
 
+    /**
+     * @brief Uploads the given shader's local uniforms at once from a packed block laid out as the
+     * shader's local uniforms are, as push constants would be.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param s A pointer to the shader.
+     * @param block A constant pointer to the block.
+     * @param size The size of the block in bytes.
+     * @return True on success; otherwise false.
+     */
+    b8 (*shader_local_block_push)(struct renderer_plugin* plugin, struct shader* s, const void* block, u32 size);
+
+    /**
+     * @brief Binds the given variant of the given shader, which must be in use, creating its
+     * pipelines from the variant's specialization constant values if it hasn't been used before.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param s A pointer to the shader.
+     * @param variant_index The index of the variant within the shader's variants.
+     * @return True on success; otherwise false.
+     */
+    b8 (*shader_variant_use)(struct renderer_plugin* plugin, struct shader* s, u32 variant_index);
+
+    /**
+     * @brief Dispatches the given compute shader, which must be in use. Must be called outside of a renderpass.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param s A pointer to the compute shader.
+     * @param group_count_x The number of workgroups to dispatch in the x dimension.
+     * @param group_count_y The number of workgroups to dispatch in the y dimension.
+     * @param group_count_z The number of workgroups to dispatch in the z dimension.
+     * @return True on success; otherwise false.
+     */
+    b8 (*shader_dispatch)(struct renderer_plugin* plugin, struct shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z);
+
     /**
      * @brief Acquires internal resources for the given texture map.
      *
@@ -707,6 +1111,25 @@ typedef struct renderer_plugin {
      */
     void (*texture_map_resources_release)(struct renderer_plugin* plugin, struct texture_map* map);
 
+    /**
+     * @brief Indicates if bindless textures are supported. If not, shaders configured with
+     * bindless_textures=1 cannot be created.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*bindless_textures_supported)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Obtains the index of the given texture map within the global bindless texture array,
+     * which shaders configured with bindless_textures=1 may sample from directly.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param map A pointer to the texture map whose resources have been acquired.
+     * @return The bindless index, or INVALID_ID if bindless textures are unsupported or the array is full.
+     */
+    u32 (*texture_map_bindless_index_get)(struct renderer_plugin* plugin, const struct texture_map* map);
+
     /**
      * @brief Creates a new render target using the provided data.
      *
@@ -786,6 +1209,67 @@ typedef struct renderer_plugin {
      */
     b8 (*is_multithreaded)(struct renderer_plugin* plugin);
 
+    /**
+     * @brief Begins recording the command list at the given index on the calling thread.
+     * Until the list is ended, renderpasses begun on this thread (and all commands
+     * recorded within them) are recorded into the list instead of the frame's command
+     * buffer. Only viewport and scissor state may be set outside of a renderpass while
+     * a list is being recorded. Optional; 0 if parallel recording is not supported.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param index The index of the list to begin. Must be less than RENDERER_MAX_COMMAND_LISTS.
+     * @return True on success; otherwise false.
+     */
+    b8 (*command_list_begin)(struct renderer_plugin* plugin, u8 index);
+
+    /**
+     * @brief Ends recording of the command list at the given index. Must be called on
+     * the same thread which began the list.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param index The index of the list to end.
+     * @return True on success; otherwise false.
+     */
+    b8 (*command_list_end)(struct renderer_plugin* plugin, u8 index);
+
+    /**
+     * @brief Executes the commands recorded into the given list as part of the frame's
+     * command buffer. Must be called from the thread recording the frame.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param index The index of the list to execute.
+     * @return True on success; otherwise false.
+     */
+    b8 (*command_list_execute)(struct renderer_plugin* plugin, u8 index);
+
+    /**
+     * @brief Begins recording compute work for the async compute queue. Until ended, dispatches
+     * (and the shader state they use) are recorded for that queue instead of the frame's command
+     * buffer. Optional; 0 if async compute is not supported.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True if compute work is now recorded for the async compute queue; false if it should
+     * be recorded inline, such as when the queue is unavailable or its work was already submitted this frame.
+     */
+    b8 (*async_compute_begin)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Ends recording compute work for the async compute queue, begun by async_compute_begin.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     */
+    void (*async_compute_end)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Submits the compute work recorded for the async compute queue, along with the frame's
+     * commands recorded so far, and makes the commands recorded afterward wait for the compute work
+     * to complete. Does nothing if no compute work is pending. Must be called outside of a renderpass.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True on success; otherwise false.
+     */
+    b8 (*async_compute_wait)(struct renderer_plugin* plugin);
+
     /**
      * @brief Indicates if the provided renderer flag is enabled. If multiple
      * flags are passed, all must be set for this to return true.
@@ -805,6 +1289,21 @@ typedef struct renderer_plugin {
      */
     void (*flag_enabled_set)(struct renderer_plugin* plugin, renderer_config_flags flag, b8 enabled);
 
+    /**
+     * @brief Obtains the swapchain settings last requested.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param out_settings A pointer to hold the settings.
+     */
+    void (*swapchain_settings_get)(struct renderer_plugin* plugin, renderer_swapchain_settings* out_settings);
+    /**
+     * @brief Requests new swapchain settings. The swapchain is recreated with them when the next frame is prepared.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param settings A constant pointer to the settings.
+     */
+    void (*swapchain_settings_set)(struct renderer_plugin* plugin, const renderer_swapchain_settings* settings);
+
     /**
      * @brief Creates and assigns the renderer-backend-specific buffer.
      *
@@ -911,6 +1410,7 @@ typedef struct renderer_plugin {
 
     /**
      * @brief Copies data in the specified rage fron the source to the destination buffer.
+     * The copy is ordered with uploads, and completes before any work submitted afterward.
      *
      * @param plugin A pointer to the renderer plugin interface.
      * @param source A pointer to the source buffer to copy data from.
@@ -922,6 +1422,25 @@ typedef struct renderer_plugin {
      */
     b8 (*renderbuffer_copy_range)(struct renderer_plugin* plugin, renderbuffer* source, u64 source_offset, renderbuffer* dest, u64 dest_offset, u64 size);
 
+    /**
+     * @brief Sets whether each upload is submitted and waited on as soon as it is made, rather than
+     * being batched with the others and submitted without waiting. Only for comparing the two.
+     * Optional; 0 if uploads always complete as they are made.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param synchronous Indicates if uploads should be synchronous.
+     */
+    void (*upload_synchronous_set)(struct renderer_plugin* plugin, b8 synchronous);
+
+    /**
+     * @brief Submits any pending uploads and waits for every upload made so far to complete.
+     * Optional; 0 if uploads always complete as they are made.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @returns True on success; otherwise false.
+     */
+    b8 (*upload_wait)(struct renderer_plugin* plugin);
+
     /**
      * @brief Attempts to draw the contents of the provided buffer at the given offset
      * and element count. Only meant for use with vertex and index buffers.
@@ -935,6 +1454,183 @@ typedef struct renderer_plugin {
      */
     b8 (*renderbuffer_draw)(struct renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only);
 
+    /**
+     * @brief Draws the given number of instances of the contents of the provided buffer
+     * at the given offset and element count. Per-instance data must already be bound
+     * via renderbuffer_draw with an instance buffer.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param buffer A pointer to the (vertex or index) buffer to be drawn.
+     * @param offset The offset in bytes from the beginning of the buffer.
+     * @param element_count The number of elements to be drawn.
+     * @param instance_count The number of instances to be drawn.
+     * @return True on success; otherwise false.
+     */
+    b8 (*renderbuffer_draw_instanced)(struct renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count);
+
+    /**
+     * @brief Indicates if indirect draws are supported, including a nonzero first instance.
+     * If not, renderbuffer_draw_indirect must not be called.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*indirect_draw_supported)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Indicates if renderpasses may render the given number of layers at once
+     * (see renderpass_config.view_count).
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param view_count The number of layers to be rendered at once.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*multiview_supported)(struct renderer_plugin* plugin, u8 view_count);
+
+    /**
+     * @brief Indicates if weighted blended transparency is supported, i.e. independent blend states
+     * per colour attachment (see SHADER_FLAG_BLEND_WEIGHTED) and blendable 16 bit float formats.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*weighted_blend_supported)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Indicates if per-draw variable rate shading is supported. Optional; 0 if not.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @return True if supported; otherwise false.
+     */
+    b8 (*shading_rate_supported)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Sets the rate at which subsequent draws are shaded. Only called where supported.
+     * Optional; 0 if per-draw variable rate shading is not supported.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param rate The shading rate to use for subsequent draws. Reset to 1x1 at the start of each frame.
+     */
+    void (*shading_rate_set)(struct renderer_plugin* plugin, renderer_shading_rate rate);
+
+    /**
+     * @brief Begins an occlusion query, which counts the samples of the draws made until it is ended
+     * that pass the depth test. Only one may be open at a time, and each index may only be issued once
+     * per frame. Should only be called inside a renderpass. Optional; 0 if occlusion queries are not
+     * supported, in which case neither are the other occlusion query functions set.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param query_index The index of the query within the frame. Must be less than RENDERER_MAX_OCCLUSION_QUERIES.
+     * @return True on success; otherwise false.
+     */
+    b8 (*occlusion_query_begin)(struct renderer_plugin* plugin, u32 query_index);
+
+    /**
+     * @brief Ends the open occlusion query.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     */
+    void (*occlusion_query_end)(struct renderer_plugin* plugin);
+
+    /**
+     * @brief Obtains the results of the occlusion queries of the most recent frame to have completed
+     * with any queries issued. Indices which weren't issued that frame are reported as visible.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param max_count The most results to be copied.
+     * @param out_visible An array of at least max_count to hold, for each query, 1 if any sample passed; otherwise 0.
+     * @param out_count A pointer to hold the number of results copied.
+     * @param out_frame_number A pointer to hold the renderer frame number the queries were issued in. 0 if there are no results yet.
+     * @return True on success; otherwise false.
+     */
+    b8 (*occlusion_query_results_get)(struct renderer_plugin* plugin, u32 max_count, u8* out_visible, u32* out_count, u64* out_frame_number);
+
+    /**
+     * @brief Creates what is needed to render to the given window. Optional; 0 if only the main
+     * window can be rendered to, in which case none of the other window functions are set.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window, whose platform window and size are set.
+     * @return True on success; otherwise false.
+     */
+    b8 (*window_create)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Destroys what was created to render to the given window.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     */
+    void (*window_destroy)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Notes that the size of the given window has changed. Its attachments are recreated
+     * the next time it is acquired.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window, whose new size is set.
+     */
+    void (*window_resized)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Acquires the image of the given window to render to in the current frame, which is
+     * presented along with the main window's at the end of the frame. Acquiring it again in the
+     * same frame does nothing.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     * @return True if the window can be rendered to this frame; false if not, i.e. while it is minimized.
+     */
+    b8 (*window_acquire)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Obtains the colour attachment of the given window at the given index.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     * @param index The index of the attachment. Must be less than the window's attachment count.
+     * @return A pointer to the attachment if successful; otherwise 0.
+     */
+    texture* (*window_colour_get)(struct renderer_plugin* plugin, renderer_window* window, u8 index);
+
+    /**
+     * @brief Obtains the depth attachment of the given window at the given index.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     * @param index The index of the attachment. Must be less than the window's attachment count.
+     * @return A pointer to the attachment if successful; otherwise 0.
+     */
+    texture* (*window_depth_get)(struct renderer_plugin* plugin, renderer_window* window, u8 index);
+
+    /**
+     * @brief Returns the index of the attachments of the given window acquired for the current frame.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     */
+    u8 (*window_image_index_get)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Returns the number of attachments of the given window, which render targets using them are made for.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param window A pointer to the window.
+     */
+    u8 (*window_image_count_get)(struct renderer_plugin* plugin, renderer_window* window);
+
+    /**
+     * @brief Issues draw_count indexed draws whose parameters are read by the GPU from the provided
+     * indirect buffer, using the currently bound vertex/index (and instance) buffers.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param buffer A pointer to the indirect buffer holding renderer_indirect_draw_commands.
+     * @param offset The offset in bytes from the beginning of the buffer to the first command.
+     * @param draw_count The number of consecutive commands to draw.
+     * @return True on success; otherwise false.
+     */
+    b8 (*renderbuffer_draw_indirect)(struct renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 draw_count);
+
 } renderer_plugin;
 
 struct render_view_packet;
@@ -14,3 +14,81 @@ b8 uniform_type_is_sampler(shader_uniform_type type) {
             return false;
     }
 }
+
+b8 uniform_type_is_storage(shader_uniform_type type) {
+    switch (type) {
+        case SHADER_UNIFORM_TYPE_STORAGE_BUFFER:
+        case SHADER_UNIFORM_TYPE_STORAGE_IMAGE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+b8 texture_format_is_compressed(texture_format format) {
+    return format != TEXTURE_FORMAT_RGBA8 && !texture_format_is_float(format);
+}
+
+b8 texture_format_is_float(texture_format format) {
+    return format == TEXTURE_FORMAT_RGBA16F || format == TEXTURE_FORMAT_R16F;
+}
+
+u64 texture_format_level_size(texture_format format, u32 width, u32 height) {
+    u64 blocks_wide = (width + 3) / 4;
+    u64 blocks_high = (height + 3) / 4;
+    switch (format) {
+        case TEXTURE_FORMAT_RGBA8:
+            return (u64)width * height * 4;
+        case TEXTURE_FORMAT_RGBA16F:
+            return (u64)width * height * 8;
+        case TEXTURE_FORMAT_R16F:
+            return (u64)width * height * 2;
+        case TEXTURE_FORMAT_BC1:
+            return blocks_wide * blocks_high * 8;
+        case TEXTURE_FORMAT_BC3:
+        case TEXTURE_FORMAT_BC5:
+        case TEXTURE_FORMAT_BC7:
+        case TEXTURE_FORMAT_ETC2_RGBA8:
+        case TEXTURE_FORMAT_ASTC_4X4:
+            return blocks_wide * blocks_high * 16;
+        default:
+            return 0;
+    }
+}
+
+u64 texture_format_chain_size(texture_format format, u32 width, u32 height, u32 mip_levels) {
+    u64 size = 0;
+    for (u32 i = 0; i < mip_levels; ++i) {
+        size += texture_format_level_size(format, width, height);
+        width = KMAX(width / 2, 1);
+        height = KMAX(height / 2, 1);
+    }
+    return size;
+}
+
+u64 render_sort_key_create(render_sort_layer layer, u32 shader_id, u32 material_id, u32 geometry_id, b8 winding_inverted, f32 depth) {
+    // The bits of a non-negative float increase along with its value, so its highest bits make
+    // an ordered depth without needing a known range.
+    union {
+        f32 f;
+        u32 u;
+    } depth_bits;
+    depth_bits.f = depth > 0.0f ? depth : 0.0f;
+
+    u64 state = ((u64)(shader_id & 0xFF) << 36) | ((u64)(material_id & 0xFFFF) << 20) | ((u64)(winding_inverted ? 1 : 0) << 19) | (u64)(geometry_id & 0x7FFFF);
+    u64 key = (u64)(layer & 0xF) << 60;
+    if (layer == RENDER_SORT_LAYER_TRANSPARENT) {
+        // layer:4 | inverted depth:16 | shader:8 | material:16 | winding:1 | geometry:19
+        u64 depth_key = (~depth_bits.u >> 15) & 0xFFFF;
+        key |= (depth_key << 44) | state;
+    } else {
+        // layer:4 | shader:8 | material:16 | winding:1 | geometry:19 | depth:16
+        u64 depth_key = (depth_bits.u >> 15) & 0xFFFF;
+        key |= (state << 16) | depth_key;
+    }
+    return key;
+}
+
+render_sort_layer render_sort_key_layer_get(u64 key) {
+    return (render_sort_layer)((key >> 60) & 0xF);
+}
@@ -4,3 +4,70 @@
 #include "resources/resource_types.h"
 
 KAPI b8 uniform_type_is_sampler(shader_uniform_type type);
+
+KAPI b8 uniform_type_is_storage(shader_uniform_type type);
+
+/**
+ * @brief Indicates if the given texture format is block-compressed.
+ *
+ * @param format The texture format.
+ * @return True if block-compressed; otherwise false.
+ */
+KAPI b8 texture_format_is_compressed(texture_format format);
+
+/**
+ * @brief Indicates if the given texture format stores floating point channels. These are only
+ * used for render targets.
+ *
+ * @param format The texture format.
+ * @return True if floating point; otherwise false.
+ */
+KAPI b8 texture_format_is_float(texture_format format);
+
+/**
+ * @brief Obtains the size in bytes of a single mip level of the given dimensions. Block-compressed
+ * formats are rounded up to whole 4x4 blocks.
+ *
+ * @param format The texture format.
+ * @param width The width of the mip level in texels.
+ * @param height The height of the mip level in texels.
+ * @return The size of the level in bytes, or 0 for an invalid format.
+ */
+KAPI u64 texture_format_level_size(texture_format format, u32 width, u32 height);
+
+/**
+ * @brief Obtains the size in bytes of a chain of mip levels, starting at the given base dimensions,
+ * with each level half the size of the one before it.
+ *
+ * @param format The texture format.
+ * @param width The width of the base level in texels.
+ * @param height The height of the base level in texels.
+ * @param mip_levels The number of levels in the chain.
+ * @return The size of the chain in bytes.
+ */
+KAPI u64 texture_format_chain_size(texture_format format, u32 width, u32 height, u32 mip_levels);
+
+/**
+ * @brief Creates a key by which geometries are sorted for drawing within a pass, lowest first.
+ * Opaque geometries are grouped by shader, then material, winding and geometry, so that binds are
+ * changed as rarely as possible and identical geometries can be instanced; the nearest are drawn
+ * first within each group. Transparent geometries are ordered back to front, and only then grouped.
+ * Weighted blended geometries need no order, and so are grouped like opaque ones.
+ *
+ * @param layer The layer of the geometry.
+ * @param shader_id An identifier of the shader used. Only the lowest 8 bits are used.
+ * @param material_id The identifier of the material used. Only the lowest 16 bits are used.
+ * @param geometry_id An identifier of the geometry drawn. Only the lowest 19 bits are used.
+ * @param winding_inverted Indicates if the winding of the geometry is inverted.
+ * @param depth The distance of the geometry from the view. Negative values are treated as 0.
+ * @return The sort key.
+ */
+KAPI u64 render_sort_key_create(render_sort_layer layer, u32 shader_id, u32 material_id, u32 geometry_id, b8 winding_inverted, f32 depth);
+
+/**
+ * @brief Obtains the layer of a key created by render_sort_key_create.
+ *
+ * @param key The sort key.
+ * @return The layer of the key.
+ */
+KAPI render_sort_layer render_sort_key_layer_get(u64 key);
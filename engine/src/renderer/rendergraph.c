@@ -4,13 +4,37 @@
 #include "containers/darray.h"
 #include "core/frame_data.h"
 #include "core/kmemory.h"
+#include "core/kprofiler.h"
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "defines.h"
+#include "math/kmath.h"
 #include "renderer/renderer_frontend.h"
 #include "renderer/renderer_types.h"
+#include "systems/job_system.h"
+
+// A run of independent passes recorded in parallel, one command list per pass.
+typedef struct parallel_recording_batch {
+    rendergraph_pass* passes[RENDERER_MAX_COMMAND_LISTS];
+    b8 results[RENDERER_MAX_COMMAND_LISTS];
+    frame_data* p_frame_data;
+} parallel_recording_batch;
 
 static b8 regenerate_render_targets(rendergraph* graph, rendergraph_pass* pass, u16 width, u16 height);
+static b8 resolve_pass_dependencies(rendergraph* graph);
+static b8 order_passes(rendergraph* graph, b8* direct, u32* pending_counts, u32* order, b8* ordered);
+static i32 source_owner_index(rendergraph* graph, const rendergraph_source* source);
+static void infer_attachment_usages(rendergraph* graph);
+static render_target_attachment_usage source_usage_get(rendergraph* graph, const rendergraph_source* source);
+static b8 pass_has_source_named(const rendergraph_pass* pass, const char* name);
+static b8 source_contents_continued(rendergraph* graph, const rendergraph_pass* pass, const rendergraph_source* source);
+static void assign_transient_alias_slots(rendergraph* graph);
+static void schedule_async_compute(rendergraph* graph);
+static u32 parallel_batch_gather(rendergraph* graph, u32 first, parallel_recording_batch* batch, u32* out_next);
+static void parallel_batch_record(u32 start, u32 end, void* user_data);
+static b8 execute_passes(rendergraph* graph, frame_data* p_frame_data);
+static b8 scaled_colours_create(rendergraph* graph);
+static void scaled_colours_destroy(rendergraph* graph);
 
 b8 rendergraph_create(const char* name, struct application* app, rendergraph* out_graph) {
     if (!out_graph) {
@@ -21,6 +45,14 @@ b8 rendergraph_create(const char* name, struct application* app, rendergraph* ou
     out_graph->app = app;
     out_graph->passes = darray_create(rendergraph_pass*);
     out_graph->global_sources = darray_create(rendergraph_source);
+    out_graph->execution_list = 0;
+    out_graph->dependencies = 0;
+    out_graph->resolution_scale = 1.0f;
+    // TODO: Get default resolution.
+    out_graph->width = 1280;
+    out_graph->height = 720;
+    out_graph->scaled_colour_count = 0;
+    out_graph->scaled_colours = 0;
 
     return true;
 }
@@ -34,18 +66,26 @@ void rendergraph_destroy(rendergraph* graph) {
             graph->name = 0;
         }
 
+        if (graph->dependencies) {
+            u32 pass_count = darray_length(graph->passes);
+            kfree(graph->dependencies, sizeof(b8) * pass_count * pass_count, MEMORY_TAG_ARRAY);
+            graph->dependencies = 0;
+        }
+
         if (graph->passes) {
             // Destroy render passes.
             u32 pass_count = darray_length(graph->passes);
             for (u32 i = 0; i < pass_count; ++i) {
                 rendergraph_pass* pass = graph->passes[i];
 
-                // Destroy render targets.
-                for (u32 p = 0; p < pass->pass.render_target_count; ++p) {
-                    render_target* target = &pass->pass.targets[p];
+                // Destroy render targets. Culled passes never had any created.
+                if (!pass->culled) {
+                    for (u32 p = 0; p < pass->pass.render_target_count; ++p) {
+                        render_target* target = &pass->pass.targets[p];
 
-                    // Destroy the target if it exists.
-                    renderer_render_target_destroy(target, true);
+                        // Destroy the target if it exists.
+                        renderer_render_target_destroy(target, true);
+                    }
                 }
 
                 // Destroy the pass itself.
@@ -57,10 +97,17 @@ void rendergraph_destroy(rendergraph* graph) {
             graph->passes = 0;
         }
 
+        if (graph->execution_list) {
+            darray_destroy(graph->execution_list);
+            graph->execution_list = 0;
+        }
+
         if (graph->global_sources) {
             darray_destroy(graph->global_sources);
             graph->global_sources = 0;
         }
+
+        scaled_colours_destroy(graph);
     }
 }
 
@@ -71,6 +118,7 @@ b8 rendergraph_global_source_add(rendergraph* graph, const char* name, rendergra
 
     rendergraph_source source = {0};
     source.name = string_duplicate(name);
+    source.alias_slot = INVALID_ID;
     source.type = type;
     source.origin = origin;
     darray_push(graph->global_sources, source);
@@ -94,6 +142,14 @@ b8 rendergraph_pass_create(rendergraph* graph, const char* name, b8 (*create_pfn
     }
 
     out_pass->name = string_duplicate(name);
+    out_pass->index = pass_count;
+    out_pass->culled = false;
+    out_pass->dependency_level = 0;
+    out_pass->presents_after = false;
+    out_pass->resolution_scaled = false;
+    out_pass->async_compute = false;
+    out_pass->async_scheduled = false;
+    out_pass->waits_async_compute = false;
     out_pass->sources = darray_create(rendergraph_source);
     out_pass->sinks = darray_create(rendergraph_sink);
 
@@ -138,6 +194,7 @@ b8 rendergraph_pass_source_add(rendergraph* graph, const char* pass_name, const
 
     rendergraph_source source = {0};
     source.name = string_duplicate(source_name);
+    source.alias_slot = INVALID_ID;
     source.type = type;
     source.origin = origin;
     darray_push(pass->sources, source);
@@ -271,13 +328,13 @@ b8 rendergraph_finalize(rendergraph* graph) {
     for (u32 i = 0; i < global_source_count; ++i) {
         rendergraph_source* source = &graph->global_sources[i];
         if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_GLOBAL) {
-            u32 attachment_count = renderer_window_attachment_count_get();
+            u32 attachment_count = renderer_window_image_count_get(graph->window);
             source->textures = kallocate(sizeof(texture*) * attachment_count, MEMORY_TAG_ARRAY);
             for (u32 j = 0; j < attachment_count; ++j) {
                 if (source->type == RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR) {
-                    source->textures[i] = renderer_window_attachment_get(i);
+                    source->textures[i] = renderer_window_colour_get(graph->window, i);
                 } else if (source->type == RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL) {
-                    source->textures[i] = renderer_depth_attachment_get(i);
+                    source->textures[i] = renderer_window_depth_get(graph->window, i);
                 } else {
                     KERROR("Unsupported source type: 0x%x", source->type);
                     return false;
@@ -307,96 +364,53 @@ b8 rendergraph_finalize(rendergraph* graph) {
         return false;
     }
 
-    // Traverse the entire list of all passes and verify that all sinks
-    // have sources bound.
-    // Then figure out what is the last render target source output and
-    // link that to the global sink backbuffer_global_sink.
-    for (u32 i = 0; i < pass_count; ++i) {
-        rendergraph_pass* pass = graph->passes[i];
+    // Work out the order the passes need to run in, and which can be culled.
+    if (!resolve_pass_dependencies(graph)) {
+        return false;
+    }
 
-        // Look for a "backbuffer" source for this pass, if there is one.
+    // With the order known, work out how each pass' outputs are used afterward so the
+    // renderpasses can be created with the correct layouts and barriers.
+    infer_attachment_usages(graph);
+    assign_transient_alias_slots(graph);
+    schedule_async_compute(graph);
+
+    // Hook up the textures of any self-sourced sources.
+    u32 execution_count = darray_length(graph->execution_list);
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
         u32 source_count = darray_length(pass->sources);
         for (u32 j = 0; j < source_count; ++j) {
             rendergraph_source* source = &pass->sources[j];
-            if (source->type == RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR) {
-                if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_OTHER) {
-                    // Other is a reference to the source output of another pass.
-                    // Search all other pass' sinks to see if any have this source
-                    // as a bound source.
-                    for (u32 k = 0; k < pass_count; ++k) {
-                        rendergraph_pass* ref_check_pass = graph->passes[k];
-                        u32 sink_count = darray_length(ref_check_pass->sinks);
-                        b8 found = false;
-                        for (u32 s = 0; s < sink_count; ++s) {
-                            if (ref_check_pass->sinks[s].bound_source == source) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            // End of the line. This source should be hooked into the backbuffer_global_sink.
-                            graph->backbuffer_global_sink.bound_source = source;
-                            pass->presents_after = true;
-                            break;
-                        }
-                    }
-                }
-            } else if (source->type == RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL) {
-                if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_OTHER) {
-                    // Other is a reference to the source output of another pass.
-                    // Search all other pass' sinks to see if any have this source
-                    // as a bound source.
-                    for (u32 k = 0; k < pass_count; ++k) {
-                        rendergraph_pass* ref_check_pass = graph->passes[k];
-                        u32 sink_count = darray_length(ref_check_pass->sinks);
-                        b8 found = false;
-                        for (u32 s = 0; s < sink_count; ++s) {
-                            if (ref_check_pass->sinks[s].bound_source == source) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            KWARN("No source found with depth stencil texture available.");
-                            break;
-                        }
-                    }
-                } else if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_SELF) {
-                    // If the origin is self, hook up the textures to the source.
-                    if (pass->source_populate) {
-                        if (!pass->source_populate(pass, source)) {
-                            KERROR("Failed to populate source '%s'.", source->name);
-                        }
-                    } else {
-                        KERROR("Rendergraph pass '%s': source '%s' is set to RENDERGRAPH_SOURCE_ORIGIN_SELF but does not have source_populate defined.");
-                        return false;
+            if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_SELF && source->type != RENDERGRAPH_SOURCE_TYPE_BUFFER) {
+                if (pass->source_populate) {
+                    if (!pass->source_populate(pass, source)) {
+                        KERROR("Failed to populate source '%s'.", source->name);
                     }
+                } else {
+                    KERROR("Rendergraph pass '%s': source '%s' is set to RENDERGRAPH_SOURCE_ORIGIN_SELF but does not have source_populate defined.", pass->name, source->name);
+                    return false;
                 }
             }
-            if (graph->backbuffer_global_sink.bound_source) {
-                break;
-            }
-        }
-        if (graph->backbuffer_global_sink.bound_source) {
-            break;
         }
     }
 
-    if (!graph->backbuffer_global_sink.bound_source) {
-        KERROR("Unable to link backbuffer_global_sink to a source because no source was found.");
+    // Scaled passes need their colour targets before any are initialized, so that passes which
+    // sample them can do so from initialization.
+    if (!scaled_colours_create(graph)) {
         return false;
     }
 
     // Once all linking is complete, initialize each pass.
-    for (u32 i = 0; i < pass_count; ++i) {
-        if (!graph->passes[i]->initialize(graph->passes[i])) {
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        if (!pass->initialize(pass)) {
             KERROR("Error intializing pass. Check logs for more info.");
             return false;
         }
 
         // Also generate render targets.
-        // TODO: Get default resolution.
-        if (!regenerate_render_targets(graph, graph->passes[i], 1280, 720)) {
+        if (!regenerate_render_targets(graph, pass, graph->width, graph->height)) {
             KERROR("Failed to rengenerate render targets");
             return false;
         }
@@ -405,26 +419,37 @@ b8 rendergraph_finalize(rendergraph* graph) {
     return true;
 }
 
-b8 rendergraph_load_resources(rendergraph* graph) {
-    if (!graph) {
+b8 rendergraph_passes_independent(const rendergraph* graph, const rendergraph_pass* a, const rendergraph_pass* b) {
+    if (!graph || !a || !b || !graph->dependencies) {
+        return false;
+    }
+    if (a == b) {
         return false;
     }
     u32 pass_count = darray_length(graph->passes);
+    return !graph->dependencies[a->index * pass_count + b->index] && !graph->dependencies[b->index * pass_count + a->index];
+}
+
+b8 rendergraph_load_resources(rendergraph* graph) {
+    if (!graph || !graph->execution_list) {
+        return false;
+    }
+    u32 pass_count = darray_length(graph->execution_list);
     for (u32 i = 0; i < pass_count; ++i) {
-        rendergraph_pass* pass = graph->passes[i];
+        rendergraph_pass* pass = graph->execution_list[i];
 
         // Before loading resources, ensure any self-sourced sources have textures loaded.
         u32 source_count = darray_length(pass->sources);
         for (u32 j = 0; j < source_count; ++j) {
             rendergraph_source* source = &pass->sources[j];
-            if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_SELF) {
+            if (source->origin == RENDERGRAPH_SOURCE_ORIGIN_SELF && source->type != RENDERGRAPH_SOURCE_TYPE_BUFFER) {
                 // If the origin is self, hook up the textures to the source.
                 if (pass->source_populate) {
                     if (!pass->source_populate(pass, source)) {
                         KERROR("Failed to populate source '%s'.", source->name);
                     }
                 } else {
-                    KERROR("Rendergraph pass '%s': source '%s' is set to RENDERGRAPH_SOURCE_ORIGIN_SELF but does not have source_populate defined.");
+                    KERROR("Rendergraph pass '%s': source '%s' is set to RENDERGRAPH_SOURCE_ORIGIN_SELF but does not have source_populate defined.", pass->name, source->name);
                     return false;
                 }
             }
@@ -439,38 +464,302 @@ b8 rendergraph_load_resources(rendergraph* graph) {
 }
 
 b8 rendergraph_execute_frame(rendergraph* graph, frame_data* p_frame_data) {
-    if (!graph) {
+    if (!graph || !graph->execution_list) {
         return false;
     }
 
-    // Passes will be executed in the order they are added.
-    u32 pass_count = darray_length(graph->passes);
-    for (u32 i = 0; i < pass_count; ++i) {
-        if (!graph->passes[i]->pass_data.do_execute) {
+    KPROFILE_FUNCTION();
+
+    // Other windows only have an image to render to once acquired, and none while minimized.
+    u64 main_render_target_index = p_frame_data->render_target_index;
+    if (graph->window) {
+        if (!renderer_window_acquire(graph->window)) {
+            return true;
+        }
+        // Acquiring may have recreated the window's attachments, so targets using them are regenerated.
+        if (graph->window_attachment_generation != graph->window->attachment_generation) {
+            rendergraph_on_resize(graph, graph->window->width, graph->window->height);
+            graph->window_attachment_generation = graph->window->attachment_generation;
+        }
+        p_frame_data->render_target_index = renderer_window_image_index_get(graph->window);
+    }
+
+    // Scaled passes execute against a scaled copy of their viewport, swapped in for the frame.
+    u32 pass_count = darray_length(graph->execution_list);
+    for (u32 p = 0; p < pass_count; ++p) {
+        rendergraph_pass* pass = graph->execution_list[p];
+        pass->unscaled_viewport = pass->pass_data.vp;
+        if (pass->resolution_scaled && pass->pass_data.vp) {
+            pass->scaled_viewport = *pass->pass_data.vp;
+            pass->scaled_viewport.rect = rendergraph_scaled_rect(graph, pass->pass_data.vp->rect);
+            pass->pass_data.vp = &pass->scaled_viewport;
+        }
+    }
+
+    b8 result = execute_passes(graph, p_frame_data);
+
+    for (u32 p = 0; p < pass_count; ++p) {
+        graph->execution_list[p]->pass_data.vp = graph->execution_list[p]->unscaled_viewport;
+    }
+    p_frame_data->render_target_index = main_render_target_index;
+
+    return result;
+}
+
+static b8 execute_passes(rendergraph* graph, frame_data* p_frame_data) {
+    u32 pass_count = darray_length(graph->execution_list);
+
+    // Async compute passes depend on nothing else, so run first. Where the renderer has no async
+    // compute queue for them, they are recorded inline.
+    b8 async_pending = false;
+    for (u32 p = 0; p < pass_count; ++p) {
+        rendergraph_pass* pass = graph->execution_list[p];
+        if (!pass->async_scheduled || !pass->pass_data.do_execute) {
             continue;
         }
-        if (!graph->passes[i]->execute(graph->passes[i], p_frame_data)) {
+        b8 async = renderer_async_compute_begin();
+        async_pending |= async;
+        KPROFILE_BEGIN(pass->name);
+        KMEMORY_NO_ALLOC_BEGIN(pass->name);
+        b8 executed = pass->execute(pass, p_frame_data);
+        KMEMORY_NO_ALLOC_END();
+        KPROFILE_END();
+        if (async) {
+            renderer_async_compute_end();
+        }
+        if (!executed) {
+            KERROR("Error executing pass. Check logs for additional details.");
+            return false;
+        }
+    }
+
+    // Passes are executed in dependency order, as resolved by rendergraph_finalize.
+    b8 command_lists_supported = renderer_command_lists_supported();
+    u32 i = 0;
+    while (i < pass_count) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        if (!pass->pass_data.do_execute || pass->async_scheduled) {
+            ++i;
+            continue;
+        }
+
+        // Consecutive passes which are independent of one another are recorded in parallel,
+        // then executed in their original order so the result is the same as recording inline.
+        if (command_lists_supported) {
+            parallel_recording_batch batch = {0};
+            batch.p_frame_data = p_frame_data;
+            u32 next = i;
+            u32 batch_count = parallel_batch_gather(graph, i, &batch, &next);
+            if (batch_count > 1) {
+                job_parallel_for(batch_count, 1, parallel_batch_record, &batch);
+                for (u32 b = 0; b < batch_count; ++b) {
+                    if (!batch.results[b]) {
+                        KERROR("Error recording pass '%s'. Check logs for additional details.", batch.passes[b]->name);
+                        return false;
+                    }
+                    if (async_pending && batch.passes[b]->waits_async_compute) {
+                        async_pending = false;
+                        if (!renderer_async_compute_wait()) {
+                            KERROR("Failed to wait on async compute work.");
+                            return false;
+                        }
+                    }
+                    if (!renderer_command_list_execute(b)) {
+                        KERROR("Error executing command list for pass '%s'.", batch.passes[b]->name);
+                        return false;
+                    }
+                }
+                i = next;
+                continue;
+            }
+        }
+
+        if (async_pending && pass->waits_async_compute) {
+            async_pending = false;
+            if (!renderer_async_compute_wait()) {
+                KERROR("Failed to wait on async compute work.");
+                return false;
+            }
+        }
+
+        // NOTE: Pass names live as long as the graph, so outlive any capture they're recorded in.
+        KPROFILE_BEGIN(pass->name);
+        KMEMORY_NO_ALLOC_BEGIN(pass->name);
+        b8 executed = pass->execute(pass, p_frame_data);
+        KMEMORY_NO_ALLOC_END();
+        KPROFILE_END();
+        if (!executed) {
             KERROR("Error executing pass. Check logs for additional details.");
             return false;
         }
+        ++i;
     }
 
     return true;
 }
 
+static u32 parallel_batch_gather(rendergraph* graph, u32 first, parallel_recording_batch* batch, u32* out_next) {
+    u32 pass_count = darray_length(graph->execution_list);
+    u32 count = 0;
+    u32 i = first;
+    for (; i < pass_count && count < RENDERER_MAX_COMMAND_LISTS; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        if (!pass->pass_data.do_execute || pass->async_scheduled) {
+            // Records nothing here, so it does not break up the run.
+            continue;
+        }
+        if (!pass->parallel_recording) {
+            break;
+        }
+        b8 independent = true;
+        for (u32 b = 0; b < count; ++b) {
+            if (!rendergraph_passes_independent(graph, pass, batch->passes[b])) {
+                independent = false;
+                break;
+            }
+        }
+        if (!independent) {
+            break;
+        }
+        batch->passes[count] = pass;
+        count++;
+    }
+
+    *out_next = i;
+    return count;
+}
+
+static void parallel_batch_record(u32 start, u32 end, void* user_data) {
+    parallel_recording_batch* batch = user_data;
+    for (u32 i = start; i < end; ++i) {
+        rendergraph_pass* pass = batch->passes[i];
+        if (!renderer_command_list_begin(i)) {
+            batch->results[i] = false;
+            continue;
+        }
+        KPROFILE_BEGIN(pass->name);
+        KMEMORY_NO_ALLOC_BEGIN(pass->name);
+        b8 executed = pass->execute(pass, batch->p_frame_data);
+        KMEMORY_NO_ALLOC_END();
+        KPROFILE_END();
+        // Always end the list, even on failure, so the thread is left in a sane state.
+        b8 ended = renderer_command_list_end(i);
+        batch->results[i] = executed && ended;
+    }
+}
+
 b8 rendergraph_on_resize(rendergraph* graph, u16 width, u16 height) {
-    if (!graph) {
+    if (!graph || !graph->execution_list) {
         return false;
     }
 
-    u32 pass_count = darray_length(graph->passes);
+    graph->width = width;
+    graph->height = height;
+
+    // Scaled targets follow the window, so they are resized before the targets using them regenerate.
+    for (u32 i = 0; i < graph->scaled_colour_count; ++i) {
+        renderer_attachment_resize(graph->scaled_colours[i], width, height);
+    }
+
+    u32 pass_count = darray_length(graph->execution_list);
     for (u32 i = 0; i < pass_count; ++i) {
-        regenerate_render_targets(graph, graph->passes[i], width, height);
+        regenerate_render_targets(graph, graph->execution_list[i], width, height);
     }
 
     return true;
 }
 
+void rendergraph_window_set(rendergraph* graph, struct renderer_window* window) {
+    if (graph) {
+        graph->window = window;
+        if (window) {
+            graph->width = window->width;
+            graph->height = window->height;
+            graph->window_attachment_generation = window->attachment_generation;
+        }
+    }
+}
+
+void rendergraph_resolution_scale_set(rendergraph* graph, f32 scale) {
+    if (graph) {
+        graph->resolution_scale = KCLAMP(scale, RENDERGRAPH_MIN_RESOLUTION_SCALE, 1.0f);
+    }
+}
+
+f32 rendergraph_resolution_scale_get(const rendergraph* graph) {
+    return graph ? graph->resolution_scale : 1.0f;
+}
+
+rect_2d rendergraph_scaled_rect(const rendergraph* graph, rect_2d rect) {
+    f32 scale = graph->resolution_scale;
+    rect_2d scaled;
+    // Whole pixels, so the region sampled when upscaling matches the one rendered exactly.
+    scaled.x = kfloor(rect.x * scale);
+    scaled.y = kfloor(rect.y * scale);
+    scaled.width = KMAX(kfloor(rect.width * scale), 1.0f);
+    scaled.height = KMAX(kfloor(rect.height * scale), 1.0f);
+    return scaled;
+}
+
+texture* rendergraph_scaled_colour_get(const rendergraph* graph, u32 index) {
+    if (!graph || index >= graph->scaled_colour_count) {
+        return 0;
+    }
+    return graph->scaled_colours[index];
+}
+
+render_target_attachment_source rendergraph_pass_colour_source(const rendergraph_pass* pass) {
+    return pass->resolution_scaled ? RENDER_TARGET_ATTACHMENT_SOURCE_SCALED : RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+}
+
+static b8 scaled_colours_create(rendergraph* graph) {
+    b8 any_scaled = false;
+    u32 execution_count = darray_length(graph->execution_list);
+    for (u32 i = 0; i < execution_count; ++i) {
+        if (graph->execution_list[i]->resolution_scaled) {
+            any_scaled = true;
+            break;
+        }
+    }
+    if (!any_scaled) {
+        return true;
+    }
+
+    u32 count = renderer_window_image_count_get(graph->window);
+    graph->scaled_colours = kallocate(sizeof(texture*) * count, MEMORY_TAG_RENDERER);
+    graph->scaled_colour_count = count;
+    for (u32 i = 0; i < count; ++i) {
+        // Only written by the scaled passes and read by the upscale within the graph, so transient.
+        renderer_attachment_desc desc = {0};
+        desc.type = TEXTURE_TYPE_2D;
+        desc.width = graph->width;
+        desc.height = graph->height;
+        desc.channel_count = 4;
+        desc.transient = true;
+        desc.slot = i;
+        graph->scaled_colours[i] = renderer_attachment_acquire("scaled_colour", &desc);
+        if (!graph->scaled_colours[i]) {
+            KERROR("Failed to acquire scaled colour target %u of rendergraph '%s'.", i, graph->name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void scaled_colours_destroy(rendergraph* graph) {
+    if (graph->scaled_colours) {
+        for (u32 i = 0; i < graph->scaled_colour_count; ++i) {
+            if (graph->scaled_colours[i]) {
+                renderer_attachment_release(graph->scaled_colours[i]);
+            }
+        }
+        kfree(graph->scaled_colours, sizeof(texture*) * graph->scaled_colour_count, MEMORY_TAG_RENDERER);
+        graph->scaled_colours = 0;
+        graph->scaled_colour_count = 0;
+    }
+}
+
 static b8 regenerate_render_targets(rendergraph* graph, rendergraph_pass* pass, u16 width, u16 height) {
     if (!graph || !pass) {
         return false;
@@ -487,13 +776,23 @@ static b8 regenerate_render_targets(rendergraph* graph, rendergraph_pass* pass,
             render_target_attachment* attachment = &target->attachments[a];
             if (attachment->source == RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT) {
                 if (attachment->type == RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
-                    attachment->texture = renderer_window_attachment_get(i);
+                    attachment->texture = renderer_window_colour_get(graph->window, i);
                 } else if (attachment->type & RENDER_TARGET_ATTACHMENT_TYPE_DEPTH || attachment->type & RENDER_TARGET_ATTACHMENT_TYPE_STENCIL) {
-                    attachment->texture = renderer_depth_attachment_get(i);
+                    attachment->texture = renderer_window_depth_get(graph->window, i);
                 } else {
                     KERROR("Unsupported attachment type: 0x%x", attachment->type);
                     return false;
                 }
+            } else if (attachment->source == RENDER_TARGET_ATTACHMENT_SOURCE_SCALED) {
+                if (attachment->type != RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
+                    KERROR("Rendergraph pass '%s': only colour attachments may use the scaled source.", pass->name);
+                    return false;
+                }
+                if (i >= graph->scaled_colour_count) {
+                    KERROR("Rendergraph pass '%s' uses a scaled colour attachment but is not marked resolution_scaled.", pass->name);
+                    return false;
+                }
+                attachment->texture = graph->scaled_colours[i];
             } else if (attachment->source == RENDER_TARGET_ATTACHMENT_SOURCE_SELF) {
                 // Regenerate, if needed/supported for this pass.
                 if (pass->attachment_textures_regenerate) {
@@ -527,3 +826,352 @@ static b8 regenerate_render_targets(rendergraph* graph, rendergraph_pass* pass,
 
     return true;
 }
+
+static i32 source_owner_index(rendergraph* graph, const rendergraph_source* source) {
+    u32 pass_count = darray_length(graph->passes);
+    for (u32 i = 0; i < pass_count; ++i) {
+        rendergraph_pass* pass = graph->passes[i];
+        u32 source_count = darray_length(pass->sources);
+        if (source >= pass->sources && source < pass->sources + source_count) {
+            return (i32)i;
+        }
+    }
+    // Global sources are not owned by any pass.
+    return -1;
+}
+
+static b8 resolve_pass_dependencies(rendergraph* graph) {
+    u32 pass_count = darray_length(graph->passes);
+
+    // Scratch space used while resolving.
+    b8* direct = kallocate(sizeof(b8) * pass_count * pass_count, MEMORY_TAG_ARRAY);
+    u32* pending_counts = kallocate(sizeof(u32) * pass_count, MEMORY_TAG_ARRAY);
+    u32* order = kallocate(sizeof(u32) * pass_count, MEMORY_TAG_ARRAY);
+    b8* ordered = kallocate(sizeof(b8) * pass_count, MEMORY_TAG_ARRAY);
+
+    b8 result = order_passes(graph, direct, pending_counts, order, ordered);
+
+    kfree(direct, sizeof(b8) * pass_count * pass_count, MEMORY_TAG_ARRAY);
+    kfree(pending_counts, sizeof(u32) * pass_count, MEMORY_TAG_ARRAY);
+    kfree(order, sizeof(u32) * pass_count, MEMORY_TAG_ARRAY);
+    kfree(ordered, sizeof(b8) * pass_count, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+static b8 order_passes(rendergraph* graph, b8* direct, u32* pending_counts, u32* order, b8* ordered) {
+    u32 pass_count = darray_length(graph->passes);
+
+    // Direct dependencies, taken from the sink linkages. direct[i * pass_count + j] is
+    // true if pass i has a sink bound to one of pass j's sources.
+    for (u32 i = 0; i < pass_count; ++i) {
+        rendergraph_pass* pass = graph->passes[i];
+        u32 sink_count = darray_length(pass->sinks);
+        for (u32 s = 0; s < sink_count; ++s) {
+            rendergraph_sink* sink = &pass->sinks[s];
+            if (!sink->bound_source) {
+                KERROR("Rendergraph configuration error: sink '%s' on pass '%s' is not bound to a source.", sink->name, pass->name);
+                return false;
+            }
+            i32 owner = source_owner_index(graph, sink->bound_source);
+            if (owner == (i32)i) {
+                KERROR("Rendergraph configuration error: pass '%s' has a sink bound to one of its own sources.", pass->name);
+                return false;
+            }
+            if (owner >= 0 && !direct[i * pass_count + owner]) {
+                direct[i * pass_count + owner] = true;
+                pending_counts[i]++;
+            }
+        }
+    }
+
+    // Topologically sort the passes. Of the passes that are ready to run, always take
+    // the one created first so independent passes keep their original relative order.
+    for (u32 n = 0; n < pass_count; ++n) {
+        u32 next = INVALID_ID;
+        for (u32 i = 0; i < pass_count; ++i) {
+            if (!ordered[i] && pending_counts[i] == 0) {
+                next = i;
+                break;
+            }
+        }
+        if (next == INVALID_ID) {
+            KERROR("Rendergraph configuration error: pass linkages contain a cycle. Unable to determine pass order.");
+            return false;
+        }
+        ordered[next] = true;
+        order[n] = next;
+        for (u32 i = 0; i < pass_count; ++i) {
+            if (direct[i * pass_count + next]) {
+                pending_counts[i]--;
+            }
+        }
+    }
+
+    // Build the full (transitive) dependency matrix and dependency levels. Since passes are
+    // visited in order, everything a pass depends on has already been resolved.
+    if (graph->dependencies) {
+        kfree(graph->dependencies, sizeof(b8) * pass_count * pass_count, MEMORY_TAG_ARRAY);
+    }
+    graph->dependencies = kallocate(sizeof(b8) * pass_count * pass_count, MEMORY_TAG_ARRAY);
+    for (u32 n = 0; n < pass_count; ++n) {
+        u32 i = order[n];
+        b8* row = &graph->dependencies[i * pass_count];
+        u32 level = 0;
+        for (u32 j = 0; j < pass_count; ++j) {
+            if (direct[i * pass_count + j]) {
+                row[j] = true;
+                const b8* dep_row = &graph->dependencies[j * pass_count];
+                for (u32 k = 0; k < pass_count; ++k) {
+                    row[k] |= dep_row[k];
+                }
+                level = KMAX(level, graph->passes[j]->dependency_level + 1);
+            }
+        }
+        graph->passes[i]->dependency_level = level;
+    }
+
+    // Find the final colour output. This is a colour source that no other pass consumes. If there is
+    // more than one, the one at the end of the longest chain of passes is used (with ties going to the
+    // one executed last). This is what gets presented.
+    graph->backbuffer_global_sink.bound_source = 0;
+    i32 presenting_pass = -1;
+    for (u32 n = 0; n < pass_count; ++n) {
+        rendergraph_pass* pass = graph->passes[order[n]];
+        pass->presents_after = false;
+        if (presenting_pass >= 0 && pass->dependency_level < graph->passes[presenting_pass]->dependency_level) {
+            continue;
+        }
+        u32 source_count = darray_length(pass->sources);
+        for (u32 j = 0; j < source_count; ++j) {
+            rendergraph_source* source = &pass->sources[j];
+            if (source->type != RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR) {
+                continue;
+            }
+            b8 consumed = false;
+            for (u32 k = 0; k < pass_count && !consumed; ++k) {
+                rendergraph_pass* ref_check_pass = graph->passes[k];
+                u32 sink_count = darray_length(ref_check_pass->sinks);
+                for (u32 s = 0; s < sink_count; ++s) {
+                    if (ref_check_pass->sinks[s].bound_source == source) {
+                        consumed = true;
+                        break;
+                    }
+                }
+            }
+            if (!consumed) {
+                graph->backbuffer_global_sink.bound_source = source;
+                presenting_pass = (i32)order[n];
+                break;
+            }
+        }
+    }
+
+    if (presenting_pass < 0) {
+        KERROR("Unable to link backbuffer_global_sink to a source because no source was found.");
+        return false;
+    }
+    graph->passes[presenting_pass]->presents_after = true;
+
+    // Cull anything the presenting pass does not depend on, and build the execution list.
+    if (graph->execution_list) {
+        darray_clear(graph->execution_list);
+    } else {
+        graph->execution_list = darray_create(rendergraph_pass*);
+    }
+    const b8* presenting_row = &graph->dependencies[presenting_pass * pass_count];
+    for (u32 n = 0; n < pass_count; ++n) {
+        u32 i = order[n];
+        rendergraph_pass* pass = graph->passes[i];
+        pass->culled = (i32)i != presenting_pass && !presenting_row[i];
+        if (pass->culled) {
+            KDEBUG("Rendergraph pass '%s' does not contribute to the final output and has been culled.", pass->name);
+        } else {
+            darray_push(graph->execution_list, pass);
+        }
+    }
+
+    return true;
+}
+
+static void infer_attachment_usages(rendergraph* graph) {
+    u32 execution_count = darray_length(graph->execution_list);
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        // Outputs a pass does not publish as a source are left to the pass' own configuration.
+        pass->pass.colour_usage = RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN;
+        pass->pass.depth_stencil_usage = RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN;
+        pass->pass.colour_contents_discarded = false;
+        pass->pass.depth_stencil_contents_discarded = false;
+
+        u32 source_count = darray_length(pass->sources);
+        for (u32 j = 0; j < source_count; ++j) {
+            rendergraph_source* source = &pass->sources[j];
+            if (source->type == RENDERGRAPH_SOURCE_TYPE_BUFFER) {
+                continue;
+            }
+            render_target_attachment_usage usage = source_usage_get(graph, source);
+            b8 discarded = !source_contents_continued(graph, pass, source);
+            if (source->type == RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR) {
+                pass->pass.colour_usage = usage;
+                pass->pass.colour_contents_discarded = discarded;
+            } else {
+                pass->pass.depth_stencil_usage = usage;
+                pass->pass.depth_stencil_contents_discarded = discarded;
+            }
+        }
+    }
+}
+
+static render_target_attachment_usage source_usage_get(rendergraph* graph, const rendergraph_source* source) {
+    if (source == graph->backbuffer_global_sink.bound_source) {
+        return RENDER_TARGET_ATTACHMENT_USAGE_PRESENT;
+    }
+
+    // A consuming pass which publishes a source of the same name as its sink carries on rendering
+    // to the attachment. Otherwise the consuming pass only reads it, by sampling.
+    b8 continued = false;
+    b8 sampled = false;
+    u32 execution_count = darray_length(graph->execution_list);
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        u32 sink_count = darray_length(pass->sinks);
+        for (u32 j = 0; j < sink_count; ++j) {
+            rendergraph_sink* sink = &pass->sinks[j];
+            if (sink->bound_source != source) {
+                continue;
+            }
+            if (pass_has_source_named(pass, sink->name)) {
+                continued = true;
+            } else {
+                sampled = true;
+            }
+        }
+    }
+
+    if (continued && sampled) {
+        KWARN("Rendergraph source '%s' is both rendered to and sampled by later passes. It will be left in a layout for rendering.", source->name);
+    }
+    if (continued) {
+        return RENDER_TARGET_ATTACHMENT_USAGE_ATTACHMENT;
+    }
+    if (sampled) {
+        return RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED;
+    }
+    return RENDER_TARGET_ATTACHMENT_USAGE_DISCARD;
+}
+
+static b8 pass_has_source_named(const rendergraph_pass* pass, const char* name) {
+    u32 source_count = darray_length(pass->sources);
+    for (u32 i = 0; i < source_count; ++i) {
+        if (strings_equal(pass->sources[i].name, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static b8 source_contents_continued(rendergraph* graph, const rendergraph_pass* pass, const rendergraph_source* source) {
+    // A pass carries on from an earlier pass' output through a sink of the same name as the source.
+    // Nothing writes the graph's global sources before it executes, so continuing from one needs nothing.
+    u32 sink_count = darray_length(pass->sinks);
+    for (u32 i = 0; i < sink_count; ++i) {
+        const rendergraph_sink* sink = &pass->sinks[i];
+        if (strings_equal(sink->name, source->name) && sink->bound_source && source_owner_index(graph, sink->bound_source) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void assign_transient_alias_slots(rendergraph* graph) {
+    // Self-sourced outputs only live from the pass that writes them until the last pass that reads
+    // them. Give each one the first slot of its type that is free by the time it is written
+    // (a greedy interval colouring in execution order).
+    rendergraph_source_type slot_types[RENDERGRAPH_MAX_ALIAS_SLOTS];
+    u32 slot_ends[RENDERGRAPH_MAX_ALIAS_SLOTS];
+    u32 slot_count = 0;
+    u32 transient_count = 0;
+
+    u32 execution_count = darray_length(graph->execution_list);
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        u32 source_count = darray_length(pass->sources);
+        for (u32 j = 0; j < source_count; ++j) {
+            rendergraph_source* source = &pass->sources[j];
+            source->alias_slot = INVALID_ID;
+            if (source->origin != RENDERGRAPH_SOURCE_ORIGIN_SELF || source->type == RENDERGRAPH_SOURCE_TYPE_BUFFER || source == graph->backbuffer_global_sink.bound_source) {
+                continue;
+            }
+
+            // The last position in the execution list at which the source is read.
+            u32 end = i;
+            for (u32 k = i + 1; k < execution_count; ++k) {
+                rendergraph_pass* consumer = graph->execution_list[k];
+                u32 sink_count = darray_length(consumer->sinks);
+                for (u32 s = 0; s < sink_count; ++s) {
+                    if (consumer->sinks[s].bound_source == source) {
+                        end = k;
+                        break;
+                    }
+                }
+            }
+
+            u32 slot = INVALID_ID;
+            for (u32 s = 0; s < slot_count; ++s) {
+                if (slot_types[s] == source->type && slot_ends[s] < i) {
+                    slot = s;
+                    break;
+                }
+            }
+            if (slot == INVALID_ID) {
+                if (slot_count == RENDERGRAPH_MAX_ALIAS_SLOTS) {
+                    KWARN("Rendergraph transient source '%s' could not be given an alias slot; max of %u reached.", source->name, RENDERGRAPH_MAX_ALIAS_SLOTS);
+                    continue;
+                }
+                slot = slot_count;
+                slot_types[slot] = source->type;
+                slot_count++;
+            }
+            slot_ends[slot] = end;
+            source->alias_slot = slot;
+            transient_count++;
+        }
+    }
+
+    graph->transient_alias_slot_count = slot_count;
+    if (transient_count) {
+        KDEBUG("Rendergraph '%s': %u transient source(s) assigned to %u alias slot(s).", graph->name, transient_count, slot_count);
+    }
+}
+
+static void schedule_async_compute(rendergraph* graph) {
+    // In execution order, so anything a pass depends on has already been scheduled.
+    u32 pass_count = darray_length(graph->passes);
+    u32 execution_count = darray_length(graph->execution_list);
+    u32 scheduled_count = 0;
+    for (u32 i = 0; i < execution_count; ++i) {
+        rendergraph_pass* pass = graph->execution_list[i];
+        const b8* row = &graph->dependencies[pass->index * pass_count];
+        b8 depends_on_scheduled = false;
+        b8 depends_on_other = false;
+        for (u32 j = 0; j < i; ++j) {
+            rendergraph_pass* dependency = graph->execution_list[j];
+            if (row[dependency->index]) {
+                if (dependency->async_scheduled) {
+                    depends_on_scheduled = true;
+                } else {
+                    depends_on_other = true;
+                }
+            }
+        }
+        pass->async_scheduled = pass->async_compute && !depends_on_other;
+        pass->waits_async_compute = !pass->async_scheduled && depends_on_scheduled;
+        if (pass->async_scheduled) {
+            scheduled_count++;
+        }
+    }
+
+    if (scheduled_count) {
+        KDEBUG("Rendergraph '%s': %u pass(es) scheduled for async compute.", graph->name, scheduled_count);
+    }
+}
@@ -4,14 +4,23 @@
 #include "core/frame_data.h"
 #include "defines.h"
 #include "renderer/renderer_types.h"
+#include "renderer/viewport.h"
 #include "resources/resource_types.h"
 
 struct application;
 struct texture;
 
+// The maximum number of alias slots transient sources can be assigned to.
+#define RENDERGRAPH_MAX_ALIAS_SLOTS 32
+// The lowest resolution scale, below which scaled passes are not worth upscaling.
+#define RENDERGRAPH_MIN_RESOLUTION_SCALE 0.25f
+
 typedef enum rendergraph_source_type {
     RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR,
-    RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL
+    RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL,
+    // A buffer written by the pass, such as by compute work. Has no textures and is never populated;
+    // it only orders the passes which consume it after the pass.
+    RENDERGRAPH_SOURCE_TYPE_BUFFER
 } rendergraph_source_type;
 
 typedef enum rendergraph_source_origin {
@@ -26,6 +35,10 @@ typedef struct rendergraph_source {
     rendergraph_source_origin origin;
     // Array of texture pointers.
     texture** textures;
+    // For transient (self-sourced) sources, assigned by rendergraph_finalize. Transient sources of
+    // the same type sharing a slot are never alive at the same time within a frame, so may share
+    // memory. INVALID_ID for sources which are not transient.
+    u32 alias_slot;
 } rendergraph_source;
 
 typedef struct rendergraph_sink {
@@ -57,6 +70,36 @@ typedef struct rendergraph_pass {
 
     b8 presents_after;
 
+    // The index of this pass in the order it was created.
+    u32 index;
+    // Set by rendergraph_finalize if none of this pass' outputs reach the backbuffer.
+    // Culled passes are never initialized, loaded or executed.
+    b8 culled;
+    // The length of the longest chain of passes this pass depends on. Passes with no
+    // dependencies are level 0. Passes at the same level never depend on one another.
+    u32 dependency_level;
+    // Indicates the pass may be recorded on a job thread, alongside other passes it is
+    // independent of. Such passes must only touch state owned by the pass (its own shaders
+    // and instances), and only record commands within renderpass begin/end.
+    b8 parallel_recording;
+    // Indicates the pass renders at the graph's resolution scale. While it executes, its viewport
+    // is swapped for a copy scaled towards the origin of its targets, which should be the graph's
+    // scaled colour targets (see rendergraph_pass_colour_source) and any depth shared with them.
+    b8 resolution_scaled;
+    // The scaled copy of the pass' viewport, used while it executes, and the viewport it stands in
+    // for, restored once the frame has executed.
+    viewport scaled_viewport;
+    viewport* unscaled_viewport;
+    // Indicates the pass only dispatches compute work, outside of any renderpass, so may run on the
+    // renderer's async compute queue where there is one, overlapping the graphics work before it.
+    b8 async_compute;
+    // Set by rendergraph_finalize for async_compute passes which only depend on other such passes.
+    // These run ahead of the rest of the graph. Other async_compute passes run inline.
+    b8 async_scheduled;
+    // Set by rendergraph_finalize for passes which depend on an async_scheduled pass, directly or not.
+    // The graphics work waits on the async compute work before the first of these executes.
+    b8 waits_async_compute;
+
     b8 (*initialize)(struct rendergraph_pass* self);
     b8 (*load_resources)(struct rendergraph_pass* self);
     b8 (*execute)(struct rendergraph_pass* self, struct frame_data* p_frame_data);
@@ -73,10 +116,38 @@ typedef struct rendergraph {
     // darray
     rendergraph_source* global_sources;
 
-    // darray of pointers to passes.
+    // darray of pointers to passes, in the order they were created.
     rendergraph_pass** passes;
 
+    // darray of pointers to passes in execution order, excluding culled passes.
+    // Populated by rendergraph_finalize.
+    rendergraph_pass** execution_list;
+
+    // A pass_count*pass_count matrix, indexed by pass index. Element [i * pass_count + j]
+    // is true if pass i depends on the output of pass j, directly or indirectly.
+    b8* dependencies;
+
+    // The number of alias slots assigned to transient sources. Populated by rendergraph_finalize.
+    u32 transient_alias_slot_count;
+
+    // The scale of each dimension resolution_scaled passes render at, from
+    // RENDERGRAPH_MIN_RESOLUTION_SCALE to 1.
+    f32 resolution_scale;
+    // The size render targets were last generated at.
+    u16 width;
+    u16 height;
+    // The colour targets of resolution_scaled passes, one per window attachment and the same size.
+    // Acquired from the renderer's attachment pool by rendergraph_finalize if any pass is scaled,
+    // otherwise 0. Transient, so graphs of the same size share them.
+    u32 scaled_colour_count;
+    struct texture** scaled_colours;
+
     rendergraph_sink backbuffer_global_sink;
+
+    // The window rendered to, or 0 for the main window. See rendergraph_window_set.
+    struct renderer_window* window;
+    // The attachment generation of the window when render targets were last generated.
+    u32 window_attachment_generation;
 } rendergraph;
 
 KAPI b8 rendergraph_create(const char* name, struct application* app, rendergraph* out_graph);
@@ -91,12 +162,90 @@ KAPI b8 rendergraph_pass_sink_add(rendergraph* graph, const char* pass_name, con
 
 KAPI b8 rendergraph_pass_set_sink_linkage(rendergraph* graph, const char* pass_name, const char* sink_name, const char* source_pass_name, const char* source_name);
 
+/**
+ * @brief Finalizes the graph. Builds a dependency graph from the sink linkages, sorts the passes
+ * so that each runs after all passes it depends on, and culls passes whose outputs never reach
+ * the backbuffer. Passes with no dependency between them keep the order they were created in.
+ * The remaining passes are then initialized in execution order.
+ *
+ * @param graph A pointer to the graph to finalize.
+ * @return True on success; otherwise false (including if the linkages contain a cycle).
+ */
 KAPI b8 rendergraph_finalize(rendergraph* graph);
 
+/**
+ * @brief Renders the graph to the given window instead of the main one, so that its global sources
+ * are the window's attachments. Must be called before the graph is finalized. When executed, the
+ * graph acquires the window's image, skips frames in which it can't be rendered to, and regenerates
+ * its render targets whenever the window's attachments are recreated.
+ *
+ * @param graph A pointer to the graph.
+ * @param window A pointer to the window to render to. 0 renders to the main window.
+ */
+KAPI void rendergraph_window_set(rendergraph* graph, struct renderer_window* window);
+
+/**
+ * @brief Indicates if two passes are independent of one another, meaning that neither depends
+ * on the output of the other, either directly or indirectly. Requires a finalized graph.
+ *
+ * @param graph A pointer to the graph containing the passes.
+ * @param a A pointer to the first pass.
+ * @param b A pointer to the second pass.
+ * @return True if the passes are independent; otherwise false.
+ */
+KAPI b8 rendergraph_passes_independent(const rendergraph* graph, const rendergraph_pass* a, const rendergraph_pass* b);
+
 KAPI b8 rendergraph_load_resources(rendergraph* graph);
 
 KAPI b8 rendergraph_execute_frame(rendergraph* graph, frame_data* p_frame_data);
 
 KAPI b8 rendergraph_on_resize(rendergraph* graph, u16 width, u16 height);
 
+/**
+ * @brief Sets the scale of each dimension that passes marked resolution_scaled render at. Takes
+ * effect from the next frame executed. Scaled passes render into the corner of full-size targets,
+ * so changing the scale never recreates them.
+ *
+ * @param graph A pointer to the graph.
+ * @param scale The scale, clamped to RENDERGRAPH_MIN_RESOLUTION_SCALE to 1.
+ */
+KAPI void rendergraph_resolution_scale_set(rendergraph* graph, f32 scale);
+
+/**
+ * @brief Gets the scale of each dimension that passes marked resolution_scaled render at.
+ *
+ * @param graph A constant pointer to the graph.
+ * @return The scale.
+ */
+KAPI f32 rendergraph_resolution_scale_get(const rendergraph* graph);
+
+/**
+ * @brief Obtains the region of its targets a scaled pass renders the given rectangle to at the
+ * graph's current resolution scale.
+ *
+ * @param graph A constant pointer to the graph.
+ * @param rect The unscaled rectangle, in pixels.
+ * @return The scaled rectangle, in pixels and at least one pixel across.
+ */
+KAPI rect_2d rendergraph_scaled_rect(const rendergraph* graph, rect_2d rect);
+
+/**
+ * @brief Obtains the scaled colour target of the given window attachment, to be sampled by a pass
+ * which upscales it.
+ *
+ * @param graph A constant pointer to the graph.
+ * @param index The index of the window attachment.
+ * @return A pointer to the texture, or 0 if no pass is scaled or the index is out of range.
+ */
+KAPI struct texture* rendergraph_scaled_colour_get(const rendergraph* graph, u32 index);
+
+/**
+ * @brief Obtains the source a pass' colour attachments should use: the graph's scaled colour
+ * targets for resolution_scaled passes, otherwise the window's.
+ *
+ * @param pass A constant pointer to the pass.
+ * @return The attachment source.
+ */
+KAPI render_target_attachment_source rendergraph_pass_colour_source(const rendergraph_pass* pass);
+
 #endif
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "core/identifier.h"
 #include "defines.h"
 #include "math/math_types.h"
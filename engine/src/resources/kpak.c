@@ -0,0 +1,125 @@
+#include "kpak.h"
+
+#include "containers/hashmap.h"
+#include "core/kcompress.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+
+u64 kpak_name_hash(const char* name) {
+    // Stored in archives, so changing this requires a new format version.
+    return hashmap_hash_string(name);
+}
+
+b8 kpak_open(const char* path, kpak_archive* out_archive) {
+    kzero_memory(out_archive, sizeof(kpak_archive));
+    file_mapping mapping;
+    if (!filesystem_map(path, 0, 0, &mapping)) {
+        KERROR("kpak_open - Unable to map archive '%s'.", path);
+        return false;
+    }
+
+    const u8* data = mapping.data;
+    u64 size = mapping.size;
+    if (size < sizeof(kpak_header)) {
+        KERROR("kpak_open - File '%s' is too small to be an archive.", path);
+        goto kpak_open_failed;
+    }
+    kpak_header header;
+    kcopy_memory(&header, data, sizeof(kpak_header));
+    if (header.magic != KPAK_MAGIC) {
+        KERROR("kpak_open - File '%s' is not an archive.", path);
+        goto kpak_open_failed;
+    }
+    if (header.version != KPAK_VERSION) {
+        KERROR("kpak_open - Archive '%s' is version %u, but only version %u is supported.", path, header.version, KPAK_VERSION);
+        goto kpak_open_failed;
+    }
+    u64 toc_size = (u64)header.entry_count * sizeof(kpak_entry);
+    if (header.toc_offset % sizeof(u64) != 0 || header.toc_offset > size || toc_size > size - header.toc_offset ||
+        header.names_offset > size || header.names_size > size - header.names_offset) {
+        KERROR("kpak_open - Archive '%s' has a table of contents outside of the file.", path);
+        goto kpak_open_failed;
+    }
+
+    // Validate every entry once, so lookups can trust them.
+    const kpak_entry* entries = (const kpak_entry*)(data + header.toc_offset);
+    const char* names = (const char*)(data + header.names_offset);
+    for (u32 i = 0; i < header.entry_count; ++i) {
+        const kpak_entry* e = &entries[i];
+        b8 valid = e->offset <= size && e->size <= size - e->offset &&
+                   (u64)e->name_offset + e->name_length < header.names_size && names[e->name_offset + e->name_length] == 0 &&
+                   (i == 0 || entries[i - 1].name_hash <= e->name_hash);
+        if (e->compression == KPAK_COMPRESSION_NONE) {
+            valid = valid && e->size == e->uncompressed_size;
+        } else if (e->compression != KPAK_COMPRESSION_LZ4) {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("kpak_open - Archive '%s' has an invalid entry at index %u.", path, i);
+            goto kpak_open_failed;
+        }
+    }
+
+    out_archive->mapping = mapping;
+    out_archive->entries = entries;
+    out_archive->entry_count = header.entry_count;
+    out_archive->names = names;
+    return true;
+
+kpak_open_failed:
+    filesystem_unmap(&mapping);
+    return false;
+}
+
+void kpak_close(kpak_archive* archive) {
+    if (archive) {
+        filesystem_unmap(&archive->mapping);
+        kzero_memory(archive, sizeof(kpak_archive));
+    }
+}
+
+const kpak_entry* kpak_find(const kpak_archive* archive, const char* name) {
+    if (!archive || !archive->entries || !name) {
+        return 0;
+    }
+
+    // Find the first entry with the hash, then check the names of all that share it.
+    u64 hash = kpak_name_hash(name);
+    u32 low = 0;
+    u32 high = archive->entry_count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (archive->entries[mid].name_hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (u32 i = low; i < archive->entry_count && archive->entries[i].name_hash == hash; ++i) {
+        const kpak_entry* e = &archive->entries[i];
+        if (strings_equal(archive->names + e->name_offset, name)) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+b8 kpak_entry_read(const kpak_archive* archive, const kpak_entry* entry, const u8** out_data, b8* out_owned) {
+    const u8* stored = archive->mapping.data + entry->offset;
+    if (entry->compression == KPAK_COMPRESSION_NONE) {
+        *out_data = stored;
+        *out_owned = false;
+        return true;
+    }
+
+    u8* data = kallocate(entry->uncompressed_size, MEMORY_TAG_RESOURCE);
+    if (!kdecompress(stored, entry->size, data, entry->uncompressed_size)) {
+        KERROR("kpak_entry_read - Failed to decompress entry '%s'.", archive->names + entry->name_offset);
+        kfree(data, entry->uncompressed_size, MEMORY_TAG_RESOURCE);
+        return false;
+    }
+    *out_data = data;
+    *out_owned = true;
+    return true;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file kpak.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief The .kpak (Kohi package) asset archive format. An archive packs many asset files
+ * into one, which is memory-mapped as a whole and looked up through a table of contents
+ * sorted by name hash, so loading an asset from it costs no more than a binary search.
+ * Entries are aligned so data stored uncompressed can be used in place, and may optionally
+ * be compressed with kcompress.
+ *
+ * Layout: kpak_header, entry data (each aligned to KPAK_ENTRY_ALIGNMENT), the table of
+ * contents (an array of kpak_entry), then the entry names (each null-terminated).
+ * @version 1.0
+ * @date 2023-11-27
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "platform/filesystem.h"
+
+/** @brief The file extension of asset archives. */
+#define KPAK_EXTENSION ".kpak"
+/** @brief Identifies a .kpak file. The characters "KPAK" in file order. */
+#define KPAK_MAGIC 0x4B41504B
+/** @brief The current version of the format. */
+#define KPAK_VERSION 1
+/** @brief Entry data in the archive begins on a multiple of this many bytes. */
+#define KPAK_ENTRY_ALIGNMENT 64
+
+/** @brief How an entry's data is stored. */
+typedef enum kpak_compression {
+    /** @brief Stored as-is. */
+    KPAK_COMPRESSION_NONE = 0,
+    /** @brief Compressed with kcompress. */
+    KPAK_COMPRESSION_LZ4 = 1
+} kpak_compression;
+
+/** @brief The header at the start of a .kpak file. */
+typedef struct kpak_header {
+    /** @brief Must be KPAK_MAGIC. */
+    u32 magic;
+    /** @brief Must be KPAK_VERSION. */
+    u32 version;
+    /** @brief The number of entries in the table of contents. */
+    u32 entry_count;
+    u32 reserved;
+    /** @brief The offset of the table of contents from the start of the file. */
+    u64 toc_offset;
+    /** @brief The offset of the entry names from the start of the file. */
+    u64 names_offset;
+    /** @brief The size of the entry names in bytes. */
+    u64 names_size;
+} kpak_header;
+
+/** @brief An entry in the table of contents. Entries are sorted by name hash. */
+typedef struct kpak_entry {
+    /** @brief The hash of the entry's name, from kpak_name_hash. */
+    u64 name_hash;
+    /** @brief The offset of the entry's data from the start of the file. */
+    u64 offset;
+    /** @brief The size of the entry's data as stored, in bytes. */
+    u64 size;
+    /** @brief The size of the entry's data once decompressed, in bytes. */
+    u64 uncompressed_size;
+    /** @brief The offset of the entry's name within the names. */
+    u32 name_offset;
+    /** @brief The length of the entry's name, not including the null terminator. */
+    u16 name_length;
+    /** @brief How the data is stored. A kpak_compression. */
+    u8 compression;
+    u8 reserved;
+} kpak_entry;
+
+/** @brief An archive opened for reading. */
+typedef struct kpak_archive {
+    /** @brief The mapping of the whole file. */
+    file_mapping mapping;
+    /** @brief The table of contents, within the mapping. */
+    const kpak_entry* entries;
+    /** @brief The number of entries. */
+    u32 entry_count;
+    /** @brief The entry names, within the mapping. */
+    const char* names;
+} kpak_archive;
+
+/**
+ * @brief Hashes an entry name. Names are paths relative to the root the archive was
+ * packed from, using '/' as the separator, e.g. "materials/grass.kmt".
+ *
+ * @param name The name to be hashed.
+ * @return The hash of the name.
+ */
+KAPI u64 kpak_name_hash(const char* name);
+
+/**
+ * @brief Opens the archive at the given path, validating its header and table of contents.
+ *
+ * @param path The path of the archive.
+ * @param out_archive A pointer to hold the opened archive.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kpak_open(const char* path, kpak_archive* out_archive);
+
+/**
+ * @brief Closes an archive. Data obtained from it must no longer be used.
+ *
+ * @param archive A pointer to the archive to be closed.
+ */
+KAPI void kpak_close(kpak_archive* archive);
+
+/**
+ * @brief Looks up the entry with the given name.
+ *
+ * @param archive A pointer to the archive.
+ * @param name The name of the entry.
+ * @return A pointer to the entry if found; otherwise 0.
+ */
+KAPI const kpak_entry* kpak_find(const kpak_archive* archive, const char* name);
+
+/**
+ * @brief Obtains the data of an entry. Uncompressed data is used in place, compressed data
+ * is decompressed into a new buffer.
+ *
+ * @param archive A pointer to the archive.
+ * @param entry A pointer to the entry, as obtained from kpak_find.
+ * @param out_data A pointer to hold the data.
+ * @param out_owned A pointer set to true if the data was allocated for the caller, who must then
+ * release it with kfree(data, entry->uncompressed_size, MEMORY_TAG_RESOURCE); otherwise false,
+ * and the data stays valid as long as the archive is open.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 kpak_entry_read(const kpak_archive* archive, const kpak_entry* entry, const u8** out_data, b8* out_owned);
@@ -6,6 +6,7 @@
 #include "loader_utils.h"
 #include "math/kmath.h"
 #include "platform/filesystem.h"
+#include "renderer/renderer_utils.h"
 #include "resources/resource_types.h"
 #include "systems/resource_system.h"
 
@@ -18,6 +19,127 @@
 #define IMAGE_EXTENSION_COUNT 4
 static char *supported_extensions[IMAGE_EXTENSION_COUNT] = {".tga", ".png", ".jpg", ".bmp"};
 
+// Baked textures are checked for before any of the source image extensions.
+#define KBT_EXTENSION ".kbt"
+
+// The size of the headers at the start of every .kbt file.
+#define KBT_HEADERS_SIZE (sizeof(resource_header) + sizeof(kbt_header))
+
+static b8 kbt_headers_parse(const u8 *data, u64 size, const char *path, kbt_header *out_header) {
+    if (size < KBT_HEADERS_SIZE) {
+        KERROR("KBT file '%s' is too small to hold its headers.", path);
+        return false;
+    }
+    resource_header header;
+    kcopy_memory(&header, data, sizeof(resource_header));
+    if (header.magic_number != RESOURCE_MAGIC || header.resource_type != RESOURCE_TYPE_IMAGE) {
+        KERROR("KBT file header of '%s' is invalid and cannot be read.", path);
+        return false;
+    }
+    if (header.version != KBT_FILE_VERSION) {
+        KERROR("KBT file '%s' is version %u, but only version %u is supported.", path, header.version, KBT_FILE_VERSION);
+        return false;
+    }
+
+    kcopy_memory(out_header, data + sizeof(resource_header), sizeof(kbt_header));
+    if (out_header->format >= TEXTURE_FORMAT_COUNT || texture_format_is_float(out_header->format) || !out_header->width || !out_header->height || !out_header->mip_levels ||
+        out_header->mip_levels > (u32)(kfloor(klog2(KMAX(out_header->width, out_header->height))) + 1)) {
+        KERROR("KBT file '%s' has invalid image properties.", path);
+        return false;
+    }
+    if (out_header->data_size != texture_format_chain_size(out_header->format, out_header->width, out_header->height, out_header->mip_levels)) {
+        KERROR("KBT file '%s' data size of %llu does not match its image properties.", path, out_header->data_size);
+        return false;
+    }
+    return true;
+}
+
+// Flips each mip level of uncompressed RGBA data on the y-axis in place.
+static void rgba8_levels_flip_y(u8 *pixels, u32 width, u32 height, u32 mip_levels) {
+    u8 row[4096 * 4];
+    for (u32 level = 0; level < mip_levels; ++level) {
+        u64 row_size = (u64)width * 4;
+        for (u32 y = 0; y < height / 2; ++y) {
+            u8 *top = pixels + row_size * y;
+            u8 *bottom = pixels + row_size * (height - 1 - y);
+            // Swap in chunks, since rows may be wider than the temporary buffer.
+            for (u64 offset = 0; offset < row_size; offset += sizeof(row)) {
+                u64 chunk = KMIN(sizeof(row), row_size - offset);
+                kcopy_memory(row, top + offset, chunk);
+                kcopy_memory(top + offset, bottom + offset, chunk);
+                kcopy_memory(bottom + offset, row, chunk);
+            }
+        }
+        pixels += row_size * height;
+        width = KMAX(width / 2, 1);
+        height = KMAX(height / 2, 1);
+    }
+}
+
+// Attempts to load a baked texture. Returns false if it can't be used, in which case the source image should be loaded instead.
+static b8 kbt_load(const char *path, const char *name, image_resource_params *params, image_resource_data *out_data) {
+    // The data is used straight from the mapped file where possible, without reading it into a buffer first.
+    file_mapping *mapping = kallocate(sizeof(file_mapping), MEMORY_TAG_TEXTURE);
+    if (!filesystem_map(path, 0, 0, mapping)) {
+        KERROR("Unable to map file: %s.", path);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_TEXTURE);
+        return false;
+    }
+
+    kbt_header header;
+    b8 compressed = false;
+    b8 flipped = false;
+    if (!kbt_headers_parse(mapping->data, mapping->size, path, &header)) {
+        goto kbt_load_skip;
+    }
+    if (mapping->size - KBT_HEADERS_SIZE < header.data_size) {
+        KERROR("KBT file '%s' is truncated.", path);
+        goto kbt_load_skip;
+    }
+
+    compressed = texture_format_is_compressed(header.format);
+    flipped = (header.flags & KBT_FLAG_FLIPPED_Y) != 0;
+    if (compressed && !params->allow_compressed) {
+        goto kbt_load_skip;
+    }
+    if (compressed && flipped != params->flip_y) {
+        // Blocks can't be flipped without re-encoding them.
+        KWARN("Baked texture '%s' was %sflipped on the y-axis, which doesn't match the load parameters. Re-bake it to match. Using the source image instead.", name, flipped ? "" : "not ");
+        goto kbt_load_skip;
+    }
+
+    const u8 *data = mapping->data + KBT_HEADERS_SIZE;
+    if (!compressed && flipped != params->flip_y) {
+        // Mapped pages are read-only, so take a copy to flip.
+        u8 *pixels = kallocate(header.data_size, MEMORY_TAG_TEXTURE);
+        kcopy_memory(pixels, data, header.data_size);
+        rgba8_levels_flip_y(pixels, header.width, header.height, header.mip_levels);
+        filesystem_unmap(mapping);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_TEXTURE);
+        mapping = 0;
+        out_data->pixels = pixels;
+    } else {
+        out_data->pixels = (u8 *)data;
+    }
+
+    out_data->mapping = mapping;
+    out_data->pixels_size = header.data_size;
+    out_data->width = header.width;
+    out_data->height = header.height;
+    out_data->format = header.format;
+    // Uncompressed data is always stored as RGBA.
+    out_data->channel_count = compressed ? header.channel_count : 4;
+    out_data->mip_levels = header.mip_levels;
+    out_data->precomputed_mips = true;
+    out_data->has_transparency = (header.flags & KBT_FLAG_HAS_TRANSPARENCY) != 0;
+    return true;
+
+kbt_load_skip:
+    filesystem_unmap(mapping);
+    kfree(mapping, sizeof(file_mapping), MEMORY_TAG_TEXTURE);
+    return false;
+}
+
 static b8 image_loader_load(struct resource_loader *self, const char *name,
                             void *params, resource *out_resource) {
     if (!self || !name || !out_resource) {
@@ -31,6 +153,21 @@ static b8 image_loader_load(struct resource_loader *self, const char *name,
     stbi_set_flip_vertically_on_load_thread(typed_params->flip_y);
     char full_file_path[512];
 
+    // Prefer a baked texture, if there is one which can be used.
+    string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, KBT_EXTENSION);
+    if (filesystem_exists(full_file_path)) {
+        image_resource_data kbt_data = {0};
+        if (kbt_load(full_file_path, name, typed_params, &kbt_data)) {
+            image_resource_data *resource_data = kallocate(sizeof(image_resource_data), MEMORY_TAG_TEXTURE);
+            *resource_data = kbt_data;
+            out_resource->full_path = string_duplicate(full_file_path);
+            out_resource->name = name;
+            out_resource->data = resource_data;
+            out_resource->data_size = sizeof(image_resource_data);
+            return true;
+        }
+    }
+
     // Try different extensions
     b8 found = false;
     for (u32 i = 0; i < IMAGE_EXTENSION_COUNT; ++i) {
@@ -54,45 +191,52 @@ static b8 image_loader_load(struct resource_loader *self, const char *name,
         return false;
     }
 
-    file_handle f;
-    if (!filesystem_open(full_file_path, FILE_MODE_READ, true, &f)) {
-        KERROR("Unable to read file: %s.", full_file_path);
-        filesystem_close(&f);
-        return false;
-    }
-
-    u64 file_size = 0;
-    if (!filesystem_size(&f, &file_size)) {
-        KERROR("Unable to get size of file: %s.", full_file_path);
-        filesystem_close(&f);
-        return false;
-    }
-
     i32 width;
     i32 height;
     i32 channel_count;
     // The final result of all operations from here down.
     b8 final_result = false;
 
-    u8 *raw_data = kallocate(file_size, MEMORY_TAG_TEXTURE);
-    if (!raw_data) {
-        KERROR("Unable to read file '%s'.", full_file_path);
-        filesystem_close(&f);
-        goto image_loader_load_return;
-    }
+    // The contents of the file may have already been read in by the caller.
+    u8 *raw_data = 0;
+    u64 file_size = 0;
+    if (typed_params->source_data) {
+        raw_data = (u8 *)typed_params->source_data;
+        file_size = typed_params->source_data_size;
+    } else {
+        file_handle f;
+        if (!filesystem_open(full_file_path, FILE_MODE_READ, true, &f)) {
+            KERROR("Unable to read file: %s.", full_file_path);
+            filesystem_close(&f);
+            return false;
+        }
 
-    u64 bytes_read = 0;
-    b8 read_result = filesystem_read_all_bytes(&f, raw_data, &bytes_read);
-    filesystem_close(&f);
+        if (!filesystem_size(&f, &file_size)) {
+            KERROR("Unable to get size of file: %s.", full_file_path);
+            filesystem_close(&f);
+            return false;
+        }
 
-    if (!read_result) {
-        KERROR("Unable to read file: '%s'", full_file_path);
-        goto image_loader_load_return;
-    }
+        raw_data = kallocate(file_size, MEMORY_TAG_TEXTURE);
+        if (!raw_data) {
+            KERROR("Unable to read file '%s'.", full_file_path);
+            filesystem_close(&f);
+            goto image_loader_load_return;
+        }
 
-    if (bytes_read != file_size) {
-        KERROR("File size if %llu does not match expected: %llu", bytes_read, file_size);
-        goto image_loader_load_return;
+        u64 bytes_read = 0;
+        b8 read_result = filesystem_read_all_bytes(&f, raw_data, &bytes_read);
+        filesystem_close(&f);
+
+        if (!read_result) {
+            KERROR("Unable to read file: '%s'", full_file_path);
+            goto image_loader_load_return;
+        }
+
+        if (bytes_read != file_size) {
+            KERROR("File size if %llu does not match expected: %llu", bytes_read, file_size);
+            goto image_loader_load_return;
+        }
     }
 
     u8 *data = stbi_load_from_memory(raw_data, file_size, &width, &height,
@@ -107,6 +251,17 @@ static b8 image_loader_load(struct resource_loader *self, const char *name,
     resource_data->width = width;
     resource_data->height = height;
     resource_data->channel_count = required_channel_count;
+    resource_data->format = TEXTURE_FORMAT_RGBA8;
+    resource_data->pixels_size = (u64)width * height * required_channel_count;
+    resource_data->precomputed_mips = false;
+    // Check for transparency
+    resource_data->has_transparency = false;
+    for (u64 i = 0; i < resource_data->pixels_size; i += required_channel_count) {
+        if (data[i + 3] < 255) {
+            resource_data->has_transparency = true;
+            break;
+        }
+    }
     // The number of mip levels is calculated by first taking the largest dimension
     // (either width or height), figuring out how many times that number can be divided
     // by 2, taking the floor value (rounding down) and adding 1 to represent the
@@ -119,19 +274,51 @@ static b8 image_loader_load(struct resource_loader *self, const char *name,
 
     // No matter the result, clean up and return.
 image_loader_load_return:
-    if (raw_data) {
+    if (raw_data && raw_data != typed_params->source_data) {
         kfree(raw_data, file_size, MEMORY_TAG_TEXTURE);
     }
     return final_result;
 }
 
 static void image_loader_unload(struct resource_loader *self, resource *resource) {
-    stbi_image_free(((image_resource_data *)resource->data)->pixels);
+    image_resource_data *data = (image_resource_data *)resource->data;
+    if (data->mapping) {
+        filesystem_unmap(data->mapping);
+        kfree(data->mapping, sizeof(file_mapping), MEMORY_TAG_TEXTURE);
+    } else if (data->precomputed_mips) {
+        kfree(data->pixels, data->pixels_size, MEMORY_TAG_TEXTURE);
+    } else {
+        stbi_image_free(data->pixels);
+    }
     if (!resource_unload(self, resource, MEMORY_TAG_TEXTURE)) {
         KWARN("image_loader_unload called with nullptr for self or resource.");
     }
 }
 
+b8 image_loader_source_path(const char *image_name, char *out_path) {
+    const char *image_base_path = resource_system_base_path_for_type(RESOURCE_TYPE_IMAGE);
+    if (!image_base_path) {
+        KERROR("Unable to query image base path. Cannot find image source path as a result");
+        return false;
+    }
+
+    char *format_str = "%s/%s%s";
+    // Baked textures are mapped rather than read, so they have no source to read in.
+    string_format(out_path, format_str, image_base_path, image_name, KBT_EXTENSION);
+    b8 found = false;
+    if (!filesystem_exists(out_path)) {
+        for (u32 i = 0; i < IMAGE_EXTENSION_COUNT; ++i) {
+            string_format(out_path, format_str, image_base_path, image_name, supported_extensions[i]);
+            if (filesystem_exists(out_path)) {
+                found = true;
+                break;
+            }
+        }
+    }
+    string_free((char *)image_base_path);
+    return found;
+}
+
 b8 image_loader_query_properties(const char *image_name, i32 *out_width, i32 *out_height, i32 *out_channels, u32 *out_mip_levels) {
     // Query the resource system for the "base path by resource type" and pass image.
     const char *image_base_path = resource_system_base_path_for_type(RESOURCE_TYPE_IMAGE);
@@ -144,6 +331,25 @@ b8 image_loader_query_properties(const char *image_name, i32 *out_width, i32 *ou
     stbi_set_flip_vertically_on_load_thread(true);
     char full_file_path[512];
 
+    // A baked texture has the same properties as its source image, and they can be read from its header.
+    string_format(full_file_path, format_str, image_base_path, image_name, KBT_EXTENSION);
+    if (filesystem_exists(full_file_path)) {
+        file_mapping mapping;
+        kbt_header header;
+        if (filesystem_map(full_file_path, 0, KBT_HEADERS_SIZE, &mapping)) {
+            b8 header_result = kbt_headers_parse(mapping.data, mapping.size, full_file_path, &header);
+            filesystem_unmap(&mapping);
+            if (header_result) {
+                string_free((char *)image_base_path);
+                *out_width = header.width;
+                *out_height = header.height;
+                *out_channels = header.channel_count;
+                *out_mip_levels = header.mip_levels;
+                return true;
+            }
+        }
+    }
+
     // Try each supported extension to see if the image file exists.
     b8 found = false;
     for (u32 i = 0; i < IMAGE_EXTENSION_COUNT; ++i) {
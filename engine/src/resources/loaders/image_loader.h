@@ -21,3 +21,14 @@
 resource_loader image_resource_loader_create(void);
 
 KAPI b8 image_loader_query_properties(const char *image_name, i32 *out_width, i32 *out_height, i32 *out_channels, u32 *out_mip_levels);
+
+/**
+ * @brief Finds the path of the source image file for the image with the given name, which
+ * can be read in ahead of time and passed to the loader via image_resource_params.source_data.
+ *
+ * @param image_name The name of the image.
+ * @param out_path A pointer to a buffer of at least 512 characters to hold the path.
+ * @return True if a source image was found; otherwise false. False is also returned if the
+ * image has a baked .kbt file, as those are mapped into memory rather than read.
+ */
+KAPI b8 image_loader_source_path(const char *image_name, char *out_path);
@@ -16,14 +16,14 @@ typedef enum material_parse_mode {
     MATERIAL_PARSE_MODE_PROPERTY
 } material_parse_mode;
 
-#define MATERIAL_PARSE_VERIFY_MODE(expected_mode, actual_mode, var_name, expected_mode_str)                                   \
-    if (actual_mode != expected_mode) {                                                                                       \
-        KERROR("Format error: unexpected variable '%s', should only exist inside a '%s' node.", var_name, expected_mode_str); \
-        return false;                                                                                                         \
+#define MATERIAL_PARSE_VERIFY_MODE(expected_mode, actual_mode, var_name, expected_mode_str)                                                               \
+    if (actual_mode != expected_mode) {                                                                                                                   \
+        KERROR("Format error: unexpected variable '%.*s', should only exist inside a '%s' node.", (i32)var_name.length, var_name.str, expected_mode_str); \
+        return false;                                                                                                                                     \
     }
 
-static b8 material_parse_filter(const char *trimmed_value, const char *trimmed_var_name, material_parse_mode parse_mode, texture_filter *filter) {
-    MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, trimmed_var_name, "map");
+static b8 material_parse_filter(const char *trimmed_value, kstring_view var_name, material_parse_mode parse_mode, texture_filter *filter) {
+    MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, var_name, "map");
     if (strings_equali(trimmed_value, "linear")) {
         *filter = TEXTURE_FILTER_MODE_LINEAR;
     } else if (strings_equali(trimmed_value, "nearest")) {
@@ -35,8 +35,8 @@ static b8 material_parse_filter(const char *trimmed_value, const char *trimmed_v
     return true;
 }
 
-static b8 material_parse_repeat(const char *trimmed_value, const char *trimmed_var_name, material_parse_mode parse_mode, texture_repeat *repeat) {
-    MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, trimmed_var_name, "map");
+static b8 material_parse_repeat(const char *trimmed_value, kstring_view var_name, material_parse_mode parse_mode, texture_repeat *repeat) {
+    MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, var_name, "map");
     if (strings_equali(trimmed_value, "repeat")) {
         *repeat = TEXTURE_REPEAT_REPEAT;
     } else if (strings_equali(trimmed_value, "clamp_to_edge")) {
@@ -243,9 +243,9 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                 }
             }
         }
-        // Split into var/value
-        i32 equal_index = string_index_of(trimmed, '=');
-        if (equal_index == -1) {
+        // Split into var/value. Both are views into the line buffer, so nothing is copied.
+        kstring_view var_name, value;
+        if (!kstring_view_split_pair(kstring_view_create(trimmed, line_length), '=', &var_name, &value)) {
             KWARN(
                 "Potential formatting issue found in file '%s': '=' token not "
                 "found. Skipping line %ui.",
@@ -253,28 +253,17 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
             line_number++;
             continue;
         }
-
-        // Assume a max of 64 characters for the variable name.
-        char raw_var_name[64];
-        kzero_memory(raw_var_name, sizeof(char) * 64);
-        string_mid(raw_var_name, trimmed, 0, equal_index);
-        char *trimmed_var_name = string_trim(raw_var_name);
-
-        // Assume a max of 511-65 (446) for the max length of the value to account
-        // for the variable name and the '='.
-        char raw_value[446];
-        kzero_memory(raw_value, sizeof(char) * 446);
-        string_mid(raw_value, trimmed, equal_index + 1,
-                   -1);  // Read the rest of the line
-        char *trimmed_value = string_trim(raw_value);
+        var_name = kstring_view_trim(var_name);
+        // The line is already trimmed, so the value runs to its null terminator and can be used as a string.
+        const char *trimmed_value = kstring_view_trim(value).str;
 
         // Process the variable.
-        if (strings_equali(trimmed_var_name, "version")) {
+        if (kstring_view_equali(var_name, "version")) {
             if (!string_to_u8(trimmed_value, &resource_data->version)) {
                 KERROR("Format error: failed to parse version. Aborting.");
                 return false;  // TODO: cleanup memory.
             }
-        } else if (strings_equali(trimmed_var_name, "name")) {
+        } else if (kstring_view_equali(var_name, "name")) {
             switch (parse_mode) {
                 default:
                 case MATERIAL_PARSE_MODE_GLOBAL:
@@ -293,7 +282,7 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     current_prop.name = string_duplicate(trimmed_value);
                     break;
             }
-        } else if (strings_equali(trimmed_var_name, "diffuse_map_name")) {
+        } else if (kstring_view_equali(var_name, "diffuse_map_name")) {
             if (resource_data->version == 1) {
                 material_map new_map = material_map_create_default("diffuse", trimmed_value);
                 darray_push(resource_data->maps, new_map);
@@ -302,7 +291,7 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: unexpected variable 'diffuse_map_name', this "
                     "should only exist for version 1 materials. Ignored.");
             }
-        } else if (strings_equali(trimmed_var_name, "specular_map_name")) {
+        } else if (kstring_view_equali(var_name, "specular_map_name")) {
             if (resource_data->version == 1) {
                 material_map new_map = material_map_create_default("specular", trimmed_value);
                 darray_push(resource_data->maps, new_map);
@@ -311,7 +300,7 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: unexpected variable 'diffuse_map_name', this "
                     "should only exist for version 1 materials. Ignored.");
             }
-        } else if (strings_equali(trimmed_var_name, "normal_map_name")) {
+        } else if (kstring_view_equali(var_name, "normal_map_name")) {
             if (resource_data->version == 1) {
                 material_map new_map = material_map_create_default("normal", trimmed_value);
                 darray_push(resource_data->maps, new_map);
@@ -320,7 +309,7 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: unexpected variable 'diffuse_map_name', this "
                     "should only exist for version 1 materials. Ignored.");
             }
-        } else if (strings_equali(trimmed_var_name, "diffuse_colour")) {
+        } else if (kstring_view_equali(var_name, "diffuse_colour")) {
             if (resource_data->version == 1) {
                 material_config_prop new_prop = material_config_prop_create(
                     "diffuse_colour", SHADER_UNIFORM_TYPE_FLOAT32_4, trimmed_value);
@@ -331,10 +320,10 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: unexpected variable 'diffuse_colour', this "
                     "should only exist for version 1 materials. Ignored.");
             }
-        } else if (strings_equali(trimmed_var_name, "shader")) {
+        } else if (kstring_view_equali(var_name, "shader")) {
             // Take a copy of the material name.
             resource_data->shader_name = string_duplicate(trimmed_value);
-        } else if (strings_equali(trimmed_var_name, "shininess")) {
+        } else if (kstring_view_equali(var_name, "shininess")) {
             if (resource_data->version == 1) {
                 material_config_prop new_prop = material_config_prop_create(
                     "shininess", SHADER_UNIFORM_TYPE_FLOAT32, trimmed_value);
@@ -344,7 +333,7 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: unexpected variable 'shininess', this "
                     "should only exist for version 1 materials. Ignored.");
             }
-        } else if (strings_equali(trimmed_var_name, "type")) {
+        } else if (kstring_view_equali(var_name, "type")) {
             if (resource_data->version >= 2) {
                 if (parse_mode == MATERIAL_PARSE_MODE_GLOBAL) {
                     if (strings_equali(trimmed_value, "phong")) {
@@ -370,31 +359,31 @@ static b8 material_loader_load(struct resource_loader *self, const char *name,
                     "Format error: Unexpected variable 'type', this should only "
                     "exist for version 2+ materials.");
             }
-        } else if (strings_equali(trimmed_var_name, "filter_min")) {
-            if (!material_parse_filter(trimmed_value, trimmed_var_name, parse_mode, &current_map.filter_min)) {
+        } else if (kstring_view_equali(var_name, "filter_min")) {
+            if (!material_parse_filter(trimmed_value, var_name, parse_mode, &current_map.filter_min)) {
                 // NOTE: Handled gracefully with a default.
             }
-        } else if (strings_equali(trimmed_var_name, "filter_mag")) {
-            if (!material_parse_filter(trimmed_value, trimmed_var_name, parse_mode, &current_map.filter_mag)) {
+        } else if (kstring_view_equali(var_name, "filter_mag")) {
+            if (!material_parse_filter(trimmed_value, var_name, parse_mode, &current_map.filter_mag)) {
                 // NOTE: Handled gracefully with a default.
             }
-        } else if (strings_equali(trimmed_var_name, "repeat_u")) {
-            if (!material_parse_repeat(trimmed_value, trimmed_var_name, parse_mode, &current_map.repeat_u)) {
+        } else if (kstring_view_equali(var_name, "repeat_u")) {
+            if (!material_parse_repeat(trimmed_value, var_name, parse_mode, &current_map.repeat_u)) {
                 // NOTE: Handled gracefully with a default.
             }
-        } else if (strings_equali(trimmed_var_name, "repeat_v")) {
-            if (!material_parse_repeat(trimmed_value, trimmed_var_name, parse_mode, &current_map.repeat_v)) {
+        } else if (kstring_view_equali(var_name, "repeat_v")) {
+            if (!material_parse_repeat(trimmed_value, var_name, parse_mode, &current_map.repeat_v)) {
                 // NOTE: Handled gracefully with a default.
             }
-        } else if (strings_equali(trimmed_var_name, "repeat_w")) {
-            if (!material_parse_repeat(trimmed_value, trimmed_var_name, parse_mode, &current_map.repeat_w)) {
+        } else if (kstring_view_equali(var_name, "repeat_w")) {
+            if (!material_parse_repeat(trimmed_value, var_name, parse_mode, &current_map.repeat_w)) {
                 // NOTE: Handled gracefully with a default.
             }
-        } else if (strings_equali(trimmed_var_name, "texture_name")) {
-            MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, trimmed_var_name, "map");
+        } else if (kstring_view_equali(var_name, "texture_name")) {
+            MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_MAP, parse_mode, var_name, "map");
             current_map.texture_name = string_duplicate(trimmed_value);
-        } else if (strings_equali(trimmed_var_name, "value")) {
-            MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_PROPERTY, parse_mode, trimmed_var_name, "prop");
+        } else if (kstring_view_equali(var_name, "value")) {
+            MATERIAL_PARSE_VERIFY_MODE(MATERIAL_PARSE_MODE_PROPERTY, parse_mode, var_name, "prop");
             material_prop_assign_value(&current_prop, trimmed_value);
         }
 
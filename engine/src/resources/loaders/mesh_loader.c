@@ -3,15 +3,18 @@
 #include <stdio.h>  //sscanf
 
 #include "containers/darray.h"
+#include "core/frame_data.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "loader_utils.h"
 #include "math/geometry_utils.h"
 #include "math/kmath.h"
+#include "memory/scratch_allocator.h"
 #include "platform/filesystem.h"
 #include "resources/resource_types.h"
 #include "systems/geometry_system.h"
+#include "systems/job_system.h"
 #include "systems/resource_system.h"
 
 typedef enum mesh_file_type {
@@ -39,19 +42,119 @@ typedef struct mesh_face_data {
 typedef struct mesh_group_data {
     // darray
     mesh_face_data *faces;
+    // The geometry the group is processed into. Its name and material name are set as the file is parsed.
+    geometry_config config;
 } mesh_group_data;
 
+/** @brief The number of bytes of an obj file parsed by each job. Each chunk is extended to the end of its last line. */
+#define OBJ_CHUNK_SIZE (256 * 1024)
+
+typedef enum obj_statement_type {
+    OBJ_STATEMENT_MTLLIB,
+    OBJ_STATEMENT_USEMTL,
+    OBJ_STATEMENT_GROUP
+} obj_statement_type;
+
+// A statement of an obj file which affects the faces following it.
+typedef struct obj_statement {
+    obj_statement_type type;
+    // The number of faces of the chunk found before the statement.
+    u32 face_index;
+    char value[512];
+} obj_statement;
+
+// A chunk of an obj file, and the data parsed from it in the order found.
+typedef struct obj_chunk {
+    const char *start;
+    u64 size;
+    // darrays
+    vec3 *positions;
+    vec3 *normals;
+    vec2 *tex_coords;
+    mesh_face_data *faces;
+    obj_statement *statements;
+} obj_chunk;
+
+/** @brief The version of ksm files written on import. Files of earlier versions can still be loaded. */
+#define KSM_VERSION 0x0006U
+/** @brief The earliest version of ksm files laid out to be mapped. Earlier ones are read sequentially. */
+#define KSM_VERSION_MAPPED 0x0004U
+/** @brief The size of each geometry table entry of a version 4 ksm file, which doesn't record it. */
+#define KSM_V4_ENTRY_SIZE 632
+/** @brief The alignment in bytes of the geometry table and of each vertex and index array in a ksm file. */
+#define KSM_DATA_ALIGNMENT 16
+/** @brief The size of the name fields of a ksm geometry entry, including the terminator. */
+#define KSM_NAME_MAX_LENGTH 256
+/** @brief The fewest triangles of a geometry whose full-detail level is split into clusters on import. */
+#define KSM_CLUSTER_MIN_TRIANGLES (GEOMETRY_CLUSTER_MAX_TRIANGLES * 8)
+
+/**
+ * @brief The header at the start of a ksm file, immediately followed by the name of the mesh.
+ * Everything else is found through the geometry table, so the whole file can be mapped and its
+ * vertex and index data used in place.
+ */
+typedef struct ksm_header {
+    /** @brief The version of the file. Must be KSM_VERSION. The first field of every version. */
+    u16 version;
+    u16 reserved;
+    /** @brief The length of the mesh name, including the terminator. */
+    u32 name_length;
+    /** @brief The number of entries in the geometry table. */
+    u32 geometry_count;
+    /** @brief The size of each entry in the geometry table. 0 in version 4 files. */
+    u32 entry_size;
+    /** @brief The offset of the geometry table from the start of the file. */
+    u64 table_offset;
+    /** @brief The size of the whole file in bytes. */
+    u64 file_size;
+} ksm_header;
+
+/** @brief An entry of the geometry table of a ksm file. All offsets are from the start of the file. */
+typedef struct ksm_geometry_entry {
+    u32 vertex_size;
+    u32 vertex_count;
+    u64 vertex_offset;
+    u32 index_size;
+    u32 index_count;
+    u64 index_offset;
+    char name[KSM_NAME_MAX_LENGTH];
+    char material_name[KSM_NAME_MAX_LENGTH];
+    vec3 center;
+    vec3 min_extents;
+    vec3 max_extents;
+    u32 lod_count;
+    geometry_lod lods[GEOMETRY_MAX_LOD_COUNT];
+    // Added in version 5.
+    /** @brief The format of the vertices. A geometry_vertex_format. */
+    u32 vertex_format;
+    /** @brief The center of the quantization cube of packed vertices. */
+    vec3 quantization_center;
+    /** @brief Half the size of the quantization cube of packed vertices. */
+    f32 quantization_scale;
+    // Added in version 6, in what was padding before.
+    /** @brief The number of clusters of the full-detail level. */
+    u32 cluster_count;
+    /** @brief The offset of the array of clusters. */
+    u64 cluster_offset;
+} ksm_geometry_entry;
+
+// The layout of these is part of the file format.
+STATIC_ASSERT(sizeof(ksm_header) == 32, "ksm_header must be 32 bytes.");
+STATIC_ASSERT(sizeof(ksm_geometry_entry) == 664, "ksm_geometry_entry must be 664 bytes.");
+STATIC_ASSERT(sizeof(geometry_cluster) == 40, "geometry_cluster must be 40 bytes.");
+
 static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
-                          geometry_config **out_geometries_darray);
+                          const char *material_directory, geometry_config **out_geometries_darray);
 static void process_subobject(vec3 *positions, vec3 *normals, vec2 *tex_coords,
                               mesh_face_data *faces, geometry_config *out_data);
-static b8 import_obj_material_library_file(const char *mtl_file_path);
+static b8 import_obj_material_library_file(const char *mtl_file_path, const char *material_directory);
 
-static b8 load_ksm_file(file_handle *ksm_file,
+static b8 load_ksm_file(const char *path,
                         geometry_config **out_geometries_darray);
 static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
                          geometry_config *geometries);
-static b8 write_kmt_file(const char *directory, material_config *config);
+static b8 write_kmt_file(const char *material_directory, material_config *config);
+static void generate_lods(geometry_config *g);
 
 static b8 mesh_loader_load(struct resource_loader *self, const char *name,
                            void *params, resource *out_resource) {
@@ -80,10 +183,14 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
     for (u32 i = 0; i < SUPPORTED_FILETYPE_COUNT; ++i) {
         string_format(full_file_path, format_str, resource_system_base_path(),
                       self->type_path, name, supported_filetypes[i].extension);
-        // If the file exists, open it and stop looking.
+        // If the file exists, open it and stop looking. Binary files are mapped instead. Text files
+        // are read whole, so are opened as binary too, keeping their size as reported.
         if (filesystem_exists(full_file_path)) {
-            if (filesystem_open(full_file_path, FILE_MODE_READ,
-                                supported_filetypes[i].is_binary, &f)) {
+            if (supported_filetypes[i].is_binary) {
+                type = supported_filetypes[i].type;
+                break;
+            }
+            if (filesystem_open(full_file_path, FILE_MODE_READ, true, &f)) {
                 type = supported_filetypes[i].type;
                 break;
             }
@@ -107,11 +214,16 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
             char ksm_file_name[512];
             string_format(ksm_file_name, "%s/%s/%s%s", resource_system_base_path(),
                           self->type_path, name, ".ksm");
-            result = import_obj_file(&f, ksm_file_name, &resource_data);
+            const char *material_directory = resource_system_base_path_for_type(RESOURCE_TYPE_MATERIAL);
+            result = material_directory && import_obj_file(&f, ksm_file_name, material_directory, &resource_data);
+            if (material_directory) {
+                string_free((char *)material_directory);
+            }
+            filesystem_close(&f);
             break;
         }
         case MESH_FILE_TYPE_KSM:
-            result = load_ksm_file(&f, &resource_data);
+            result = load_ksm_file(full_file_path, &resource_data);
             break;
         default:
         case MESH_FILE_TYPE_NOT_FOUND:
@@ -120,10 +232,12 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
             break;
     }
 
-    filesystem_close(&f);
-
     if (!result) {
         KERROR("Failed to process mesh file '%s'.", full_file_path);
+        u32 count = darray_length(resource_data);
+        for (u32 i = 0; i < count; ++i) {
+            geometry_system_config_dispose(&resource_data[i]);
+        }
         darray_destroy(resource_data);
         out_resource->data = 0;
         out_resource->data_size = 0;
@@ -139,85 +253,275 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
 
 static void mesh_loader_unload(struct resource_loader *self,
                                resource *resource) {
-    u32 count = darray_length(resource->data);
-    for (u32 i = 0; i < count; ++i) {
-        geometry_config *config = &((geometry_config *)resource->data)[i];
-        geometry_system_config_dispose(config);
-    }
-    darray_destroy(resource->data);
+    mesh_loader_geometries_free(resource->data);
     resource->data = 0;
     resource->data_size = 0;
 }
 
-static b8 load_ksm_file(file_handle *ksm_file,
-                        geometry_config **out_geometries_darray) {
+b8 mesh_loader_ksm_load(const char *path, geometry_config **out_geometries_darray) {
+    if (!path || !out_geometries_darray) {
+        return false;
+    }
+    geometry_config *geometries = darray_create(geometry_config);
+    if (!load_ksm_file(path, &geometries)) {
+        mesh_loader_geometries_free(geometries);
+        *out_geometries_darray = 0;
+        return false;
+    }
+    *out_geometries_darray = geometries;
+    return true;
+}
+
+b8 mesh_loader_obj_import(const char *obj_path, const char *out_ksm_path, const char *material_directory) {
+    if (!obj_path || !out_ksm_path || !material_directory) {
+        return false;
+    }
+    file_handle f;
+    if (!filesystem_open(obj_path, FILE_MODE_READ, true, &f)) {
+        KERROR("Unable to open obj file '%s'.", obj_path);
+        return false;
+    }
+    geometry_config *geometries = darray_create(geometry_config);
+    b8 result = import_obj_file(&f, out_ksm_path, material_directory, &geometries);
+    filesystem_close(&f);
+    mesh_loader_geometries_free(geometries);
+    return result;
+}
+
+void mesh_loader_geometries_free(geometry_config *geometries_darray) {
+    if (!geometries_darray) {
+        return;
+    }
+    u32 count = darray_length(geometries_darray);
+    // Configs loaded from a ksm file all share its mapping, released once they are disposed of.
+    file_mapping *mapping = count ? geometries_darray[0].mapping : 0;
+    for (u32 i = 0; i < count; ++i) {
+        geometry_system_config_dispose(&geometries_darray[i]);
+    }
+    if (mapping) {
+        filesystem_unmap(mapping);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+    }
+    darray_destroy(geometries_darray);
+}
+
+/**
+ * @brief Reads consecutive fields from a block of memory, such as a mapped file,
+ * without reading beyond its end. Once a read fails, all further reads fail.
+ */
+typedef struct ksm_reader {
+    const u8 *data;
+    u64 size;
+    u64 offset;
+    b8 failed;
+} ksm_reader;
+
+static b8 ksm_read(ksm_reader *reader, u64 size, void *out_data) {
+    if (reader->failed || size > reader->size - reader->offset) {
+        reader->failed = true;
+        return false;
+    }
+    kcopy_memory(out_data, reader->data + reader->offset, size);
+    reader->offset += size;
+    return true;
+}
+
+/** @brief Reads a length-prefixed string into out_string, truncating it to fit. */
+static b8 ksm_read_string(ksm_reader *reader, char *out_string, u32 max_length) {
+    u32 length = 0;
+    if (!ksm_read(reader, sizeof(u32), &length) || length > reader->size - reader->offset) {
+        reader->failed = true;
+        return false;
+    }
+    u32 copy_length = KMIN(length, max_length - 1);
+    kcopy_memory(out_string, reader->data + reader->offset, copy_length);
+    out_string[copy_length] = 0;
+    reader->offset += length;
+    return true;
+}
+
+/**
+ * @brief Loads a ksm file written before version 4, which stores each geometry's fields one after
+ * another. The vertex and index data are copied out, so the file may be unmapped afterward.
+ */
+static b8 load_ksm_file_legacy(const char *path, const file_mapping *mapping,
+                               geometry_config **out_geometries_darray) {
+    ksm_reader reader = {mapping->data, mapping->size, 0, false};
+
     // Version
-    u64 bytes_read = 0;
     u16 version = 0;
-    filesystem_read(ksm_file, sizeof(u16), &version, &bytes_read);
+    ksm_read(&reader, sizeof(u16), &version);
 
-    // Name length
-    u32 name_length = 0;
-    filesystem_read(ksm_file, sizeof(u32), &name_length, &bytes_read);
-    // Name + terminator
+    // Name
     char name[256];
-    filesystem_read(ksm_file, sizeof(char) * name_length, name, &bytes_read);
+    ksm_read_string(&reader, name, 256);
 
     // Geometry count
     u32 geometry_count = 0;
-    filesystem_read(ksm_file, sizeof(u32), &geometry_count, &bytes_read);
+    ksm_read(&reader, sizeof(u32), &geometry_count);
+
+    // Handles backward compatability for
+    // https://github.com/travisvroman/kohi/issues/130
+    u64 extent_size = sizeof(vec3);
+    if (version == 0x0001U) {
+        extent_size = sizeof(vertex_3d);
+    }
 
     // Each geometry
-    for (u32 i = 0; i < geometry_count; ++i) {
+    for (u32 i = 0; i < geometry_count && !reader.failed; ++i) {
         geometry_config g = {};
 
         // Vertices (size/count/array)
-        filesystem_read(ksm_file, sizeof(u32), &g.vertex_size, &bytes_read);
-        filesystem_read(ksm_file, sizeof(u32), &g.vertex_count, &bytes_read);
-        g.vertices = kallocate(g.vertex_size * g.vertex_count, MEMORY_TAG_ARRAY);
-        filesystem_read(ksm_file, g.vertex_size * g.vertex_count, g.vertices,
-                        &bytes_read);
+        ksm_read(&reader, sizeof(u32), &g.vertex_size);
+        ksm_read(&reader, sizeof(u32), &g.vertex_count);
+        u64 vertex_data_size = (u64)g.vertex_size * g.vertex_count;
+        if (reader.failed || vertex_data_size > reader.size - reader.offset) {
+            reader.failed = true;
+            break;
+        }
+        g.vertices = kallocate(vertex_data_size, MEMORY_TAG_ARRAY);
+        ksm_read(&reader, vertex_data_size, g.vertices);
 
         // Indices (size/count/array)
-        filesystem_read(ksm_file, sizeof(u32), &g.index_size, &bytes_read);
-        filesystem_read(ksm_file, sizeof(u32), &g.index_count, &bytes_read);
-        g.indices = kallocate(g.index_size * g.index_count, MEMORY_TAG_ARRAY);
-        filesystem_read(ksm_file, g.index_size * g.index_count, g.indices,
-                        &bytes_read);
-
-        // Name
-        u32 g_name_length = 0;
-        filesystem_read(ksm_file, sizeof(u32), &g_name_length, &bytes_read);
-        filesystem_read(ksm_file, sizeof(char) * g_name_length, g.name,
-                        &bytes_read);
-
-        // Material Name
-        u32 m_name_length = 0;
-        filesystem_read(ksm_file, sizeof(u32), &m_name_length, &bytes_read);
-        filesystem_read(ksm_file, sizeof(char) * m_name_length, g.material_name,
-                        &bytes_read);
-
-        // Handles backward compatability for
-        // https://github.com/travisvroman/kohi/issues/130
-        u64 extent_size = sizeof(vec3);
-        if (version == 0x0001U) {
-            extent_size = sizeof(vertex_3d);
+        ksm_read(&reader, sizeof(u32), &g.index_size);
+        ksm_read(&reader, sizeof(u32), &g.index_count);
+        u64 index_data_size = (u64)g.index_size * g.index_count;
+        if (reader.failed || index_data_size > reader.size - reader.offset) {
+            kfree(g.vertices, vertex_data_size, MEMORY_TAG_ARRAY);
+            reader.failed = true;
+            break;
         }
+        g.indices = kallocate(index_data_size, MEMORY_TAG_ARRAY);
+        ksm_read(&reader, index_data_size, g.indices);
+
+        // Name and material name
+        ksm_read_string(&reader, g.name, GEOMETRY_NAME_MAX_LENGTH);
+        ksm_read_string(&reader, g.material_name, MATERIAL_NAME_MAX_LENGTH);
+
+        // Center and extents (min/max)
+        ksm_read(&reader, extent_size, &g.center);
+        ksm_read(&reader, extent_size, &g.min_extents);
+        ksm_read(&reader, extent_size, &g.max_extents);
+
+        // Levels of detail (count/array), added in version 3.
+        if (version >= 0x0003U) {
+            ksm_read(&reader, sizeof(u32), &g.lod_count);
+            g.lod_count = KMIN(g.lod_count, GEOMETRY_MAX_LOD_COUNT);
+            ksm_read(&reader, sizeof(geometry_lod) * g.lod_count, g.lods);
+        }
+
+        // Add to the output array, where it is disposed of along with the rest on failure.
+        darray_push(*out_geometries_darray, g);
+    }
 
-        // Center
-        filesystem_read(ksm_file, extent_size, &g.center, &bytes_read);
+    if (reader.failed) {
+        KERROR("KSM file '%s' is truncated or corrupt.", path);
+        return false;
+    }
 
-        // Extents (min/max)
-        filesystem_read(ksm_file, extent_size, &g.min_extents, &bytes_read);
-        filesystem_read(ksm_file, extent_size, &g.max_extents, &bytes_read);
+    return true;
+}
+
+static b8 load_ksm_file(const char *path, geometry_config **out_geometries_darray) {
+    file_mapping *mapping = kallocate(sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+    if (!filesystem_map(path, 0, 0, mapping)) {
+        KERROR("Unable to map ksm file '%s'.", path);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+        return false;
+    }
+
+    u16 version = 0;
+    if (mapping->size >= sizeof(u16)) {
+        kcopy_memory(&version, mapping->data, sizeof(u16));
+    }
+
+    if (version < KSM_VERSION_MAPPED) {
+        b8 result = load_ksm_file_legacy(path, mapping, out_geometries_darray);
+        filesystem_unmap(mapping);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+        return result;
+    }
+
+    ksm_header header = {};
+    if (mapping->size < sizeof(ksm_header)) {
+        KERROR("KSM file '%s' is too small to hold its header.", path);
+        goto failed;
+    }
+    kcopy_memory(&header, mapping->data, sizeof(ksm_header));
+    if (header.version > KSM_VERSION) {
+        KERROR("KSM file '%s' has unsupported version %u.", path, header.version);
+        goto failed;
+    }
+    u32 entry_size = header.version == KSM_VERSION_MAPPED ? KSM_V4_ENTRY_SIZE : header.entry_size;
+    if (entry_size < KSM_V4_ENTRY_SIZE) {
+        KERROR("KSM file '%s' has an invalid geometry table entry size of %u.", path, entry_size);
+        goto failed;
+    }
+    if (header.table_offset > mapping->size ||
+        (u64)header.geometry_count * entry_size > mapping->size - header.table_offset) {
+        KERROR("KSM file '%s' is truncated. Its geometry table lies outside the file.", path);
+        goto failed;
+    }
+
+    for (u32 i = 0; i < header.geometry_count; ++i) {
+        // Entries of earlier versions are shorter. Fields they lack are left zeroed, which are their defaults.
+        ksm_geometry_entry read_entry = {};
+        kcopy_memory(&read_entry, mapping->data + header.table_offset + (u64)i * entry_size, KMIN(entry_size, sizeof(ksm_geometry_entry)));
+        const ksm_geometry_entry *entry = &read_entry;
+        if (entry->vertex_format >= GEOMETRY_VERTEX_FORMAT_COUNT ||
+            (entry->vertex_format == GEOMETRY_VERTEX_FORMAT_PACKED && entry->vertex_size != sizeof(vertex_3d_packed))) {
+            KERROR("KSM file '%s' has an invalid vertex format for geometry %u.", path, i);
+            goto failed;
+        }
+        u64 vertex_data_size = (u64)entry->vertex_size * entry->vertex_count;
+        u64 index_data_size = (u64)entry->index_size * entry->index_count;
+        u64 cluster_data_size = (u64)sizeof(geometry_cluster) * entry->cluster_count;
+        if (entry->vertex_offset > mapping->size || vertex_data_size > mapping->size - entry->vertex_offset ||
+            entry->index_offset > mapping->size || index_data_size > mapping->size - entry->index_offset ||
+            entry->cluster_offset > mapping->size || cluster_data_size > mapping->size - entry->cluster_offset) {
+            KERROR("KSM file '%s' is truncated. The data of geometry %u lies outside the file.", path, i);
+            goto failed;
+        }
+
+        // The vertex and index data are used in place, straight from the mapping.
+        geometry_config g = {};
+        g.vertex_size = entry->vertex_size;
+        g.vertex_count = entry->vertex_count;
+        g.vertices = (void *)(mapping->data + entry->vertex_offset);
+        g.index_size = entry->index_size;
+        g.index_count = entry->index_count;
+        g.indices = (void *)(mapping->data + entry->index_offset);
+        g.mapping = mapping;
+        string_ncopy(g.name, entry->name, GEOMETRY_NAME_MAX_LENGTH - 1);
+        string_ncopy(g.material_name, entry->material_name, MATERIAL_NAME_MAX_LENGTH - 1);
+        g.center = entry->center;
+        g.min_extents = entry->min_extents;
+        g.max_extents = entry->max_extents;
+        g.lod_count = KMIN(entry->lod_count, GEOMETRY_MAX_LOD_COUNT);
+        kcopy_memory(g.lods, entry->lods, sizeof(geometry_lod) * g.lod_count);
+        g.vertex_format = entry->vertex_format;
+        g.quantization_center = entry->quantization_center;
+        g.quantization_scale = entry->quantization_scale;
+        g.cluster_count = entry->cluster_count;
+        g.clusters = entry->cluster_count ? (geometry_cluster *)(mapping->data + entry->cluster_offset) : 0;
 
-        // Add to the output array.
         darray_push(*out_geometries_darray, g);
     }
 
-    filesystem_close(ksm_file);
+    if (header.geometry_count == 0) {
+        // Nothing refers to the mapping, so it isn't needed.
+        filesystem_unmap(mapping);
+        kfree(mapping, sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+    }
 
     return true;
+
+failed:
+    // Nothing pushed so far refers to memory of its own.
+    darray_clear(*out_geometries_darray);
+    filesystem_unmap(mapping);
+    kfree(mapping, sizeof(file_mapping), MEMORY_TAG_RESOURCE);
+    return false;
 }
 
 static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
@@ -226,63 +530,75 @@ static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
         KINFO("File '%s' already exists and will be overwritten.", path);
     }
 
-    file_handle f;
-    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
-        KERROR("Unable to open file '%s' for writing. KSM write failed.", path);
-        return false;
-    }
-
-    // Version
-    u64 written = 0;
-    u16 version = 0x0002U;
-    filesystem_write(&f, sizeof(u16), &version, &written);
-
-    // Name length
+    // Lay out the file: the header and name, followed by the geometry table and then the
+    // vertex and index data of each geometry, each aligned so it can be used in place.
     u32 name_length = string_length(name) + 1;
-    filesystem_write(&f, sizeof(u32), &name_length, &written);
-    // Name + terminator
-    filesystem_write(&f, sizeof(char) * name_length, name, &written);
-
-    // Geometry count
-    filesystem_write(&f, sizeof(u32), &geometry_count, &written);
-
-    // Each geometry
+    u64 table_offset = get_aligned(sizeof(ksm_header) + name_length, KSM_DATA_ALIGNMENT);
+    u64 file_size = table_offset + (u64)geometry_count * sizeof(ksm_geometry_entry);
+    ksm_geometry_entry *entries = kallocate(sizeof(ksm_geometry_entry) * KMAX(geometry_count, 1), MEMORY_TAG_ARRAY);
     for (u32 i = 0; i < geometry_count; ++i) {
         geometry_config *g = &geometries[i];
+        ksm_geometry_entry *entry = &entries[i];
+        entry->vertex_size = g->vertex_size;
+        entry->vertex_count = g->vertex_count;
+        entry->vertex_offset = get_aligned(file_size, KSM_DATA_ALIGNMENT);
+        file_size = entry->vertex_offset + (u64)g->vertex_size * g->vertex_count;
+        entry->index_size = g->index_size;
+        entry->index_count = g->index_count;
+        entry->index_offset = get_aligned(file_size, KSM_DATA_ALIGNMENT);
+        file_size = entry->index_offset + (u64)g->index_size * g->index_count;
+        entry->cluster_count = g->cluster_count;
+        entry->cluster_offset = get_aligned(file_size, KSM_DATA_ALIGNMENT);
+        file_size = entry->cluster_offset + sizeof(geometry_cluster) * g->cluster_count;
+        string_ncopy(entry->name, g->name, KSM_NAME_MAX_LENGTH - 1);
+        string_ncopy(entry->material_name, g->material_name, KSM_NAME_MAX_LENGTH - 1);
+        entry->center = g->center;
+        entry->min_extents = g->min_extents;
+        entry->max_extents = g->max_extents;
+        entry->lod_count = g->lod_count;
+        kcopy_memory(entry->lods, g->lods, sizeof(geometry_lod) * g->lod_count);
+        entry->vertex_format = g->vertex_format;
+        entry->quantization_center = g->quantization_center;
+        entry->quantization_scale = g->quantization_scale;
+    }
 
-        // Vertices (size/count/array)
-        filesystem_write(&f, sizeof(u32), &g->vertex_size, &written);
-        filesystem_write(&f, sizeof(u32), &g->vertex_count, &written);
-        filesystem_write(&f, g->vertex_size * g->vertex_count, g->vertices,
-                         &written);
-
-        // Indices (size/count/array)
-        filesystem_write(&f, sizeof(u32), &g->index_size, &written);
-        filesystem_write(&f, sizeof(u32), &g->index_count, &written);
-        filesystem_write(&f, g->index_size * g->index_count, g->indices, &written);
-
-        // Name
-        u32 g_name_length = string_length(g->name) + 1;
-        filesystem_write(&f, sizeof(u32), &g_name_length, &written);
-        filesystem_write(&f, sizeof(char) * g_name_length, g->name, &written);
-
-        // Material Name
-        u32 m_name_length = string_length(g->material_name) + 1;
-        filesystem_write(&f, sizeof(u32), &m_name_length, &written);
-        filesystem_write(&f, sizeof(char) * m_name_length, g->material_name,
-                         &written);
-
-        // Center
-        filesystem_write(&f, sizeof(vec3), &g->center, &written);
-
-        // Extents (min/max)
-        filesystem_write(&f, sizeof(vec3), &g->min_extents, &written);
-        filesystem_write(&f, sizeof(vec3), &g->max_extents, &written);
+    ksm_header header = {};
+    header.version = KSM_VERSION;
+    header.name_length = name_length;
+    header.geometry_count = geometry_count;
+    header.entry_size = sizeof(ksm_geometry_entry);
+    header.table_offset = table_offset;
+    header.file_size = file_size;
+
+    // Assemble the whole file in memory, so it can be written at once. Padding is left zeroed.
+    u8 *data = kallocate(file_size, MEMORY_TAG_ARRAY);
+    kcopy_memory(data, &header, sizeof(ksm_header));
+    kcopy_memory(data + sizeof(ksm_header), name, name_length);
+    kcopy_memory(data + table_offset, entries, sizeof(ksm_geometry_entry) * geometry_count);
+    for (u32 i = 0; i < geometry_count; ++i) {
+        kcopy_memory(data + entries[i].vertex_offset, geometries[i].vertices, (u64)entries[i].vertex_size * entries[i].vertex_count);
+        kcopy_memory(data + entries[i].index_offset, geometries[i].indices, (u64)entries[i].index_size * entries[i].index_count);
+        if (entries[i].cluster_count) {
+            kcopy_memory(data + entries[i].cluster_offset, geometries[i].clusters, sizeof(geometry_cluster) * entries[i].cluster_count);
+        }
     }
+    kfree(entries, sizeof(ksm_geometry_entry) * KMAX(geometry_count, 1), MEMORY_TAG_ARRAY);
 
-    filesystem_close(&f);
+    file_handle f;
+    b8 result = false;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Unable to open file '%s' for writing. KSM write failed.", path);
+    } else {
+        u64 written = 0;
+        result = filesystem_write(&f, file_size, data, &written) && written == file_size;
+        if (!result) {
+            KERROR("Failed to write ksm file '%s'.", path);
+        }
+        filesystem_close(&f);
+    }
 
-    return true;
+    kfree(data, file_size, MEMORY_TAG_ARRAY);
+    return result;
 }
 
 /**
@@ -295,204 +611,357 @@ static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
  * @param out_geometries_darray A darray of geometries parsed from the file.
  * @return True on success; otherwise false.
  */
-static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
-                          geometry_config **out_geometries_darray) {
-    // Positions
-    vec3 *positions = darray_reserve(vec3, 16384);
-
-    // Normals
-    vec3 *normals = darray_reserve(vec3, 16384);
-
-    // Normals
-    vec2 *tex_coords = darray_reserve(vec2, 16384);
-
-    // Groups
-    mesh_group_data *groups = darray_reserve(mesh_group_data, 4);
-
-    char material_file_name[512] = "";
+// Parses the three vertices of a face, following the 'f'. With indices, each vertex is
+// "pos/tex/norm"; otherwise it is just the position. Matches the old sscanf layout exactly.
+static b8 obj_face_parse(const char *str, b8 indexed, mesh_face_data *out_face) {
+    for (u32 i = 0; i < 3; ++i) {
+        mesh_vertex_index_data *v = &out_face->vertices[i];
+        if (!(str = string_parse_u32(str, &v->position_index))) {
+            return false;
+        }
+        if (indexed) {
+            if (*str != '/' || !(str = string_parse_u32(str + 1, &v->texcoord_index))) {
+                return false;
+            }
+            if (*str != '/' || !(str = string_parse_u32(str + 1, &v->normal_index))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    char name[512];
-    kzero_memory(name, sizeof(char) * 512);
-    u8 current_mat_name_count = 0;
-    char material_names[32][64];
+// Parses the lines of the given chunk of an obj file, keeping everything in the order found.
+static void obj_chunk_parse(obj_chunk *chunk) {
+    chunk->positions = darray_create(vec3);
+    chunk->normals = darray_create(vec3);
+    chunk->tex_coords = darray_create(vec2);
+    chunk->faces = darray_create(mesh_face_data);
+    chunk->statements = darray_create(obj_statement);
 
     char line_buf[512] = "";
-    char *p = &line_buf[0];
-    u64 line_length = 0;
-
-    // index 0 is previous, 1 is previous before that.
-    char prev_first_chars[2] = {0, 0};
-    while (true) {
-        if (!filesystem_read_line(obj_file, 511, &p, &line_length)) {
-            break;
+    const char *cursor = chunk->start;
+    const char *chunk_end = chunk->start + chunk->size;
+    while (cursor < chunk_end) {
+        // Copy out the line, so it can be scanned. Overlong lines are truncated.
+        const char *line_end = cursor;
+        while (line_end < chunk_end && *line_end != '\n') {
+            line_end++;
         }
+        u64 line_length = KMIN((u64)(line_end - cursor), sizeof(line_buf) - 1);
+        kcopy_memory(line_buf, cursor, line_length);
+        line_buf[line_length] = 0;
+        cursor = line_end + 1;
 
         // Skip blank lines.
         if (line_length < 1) {
             continue;
         }
 
-        char first_char = line_buf[0];
-
-        switch (first_char) {
+        switch (line_buf[0]) {
             case '#':
                 // Skip comments
                 continue;
             case 'v': {
-                char second_char = line_buf[1];
-                switch (second_char) {
+                switch (line_buf[1]) {
                     case ' ': {
                         // Vertex position
                         vec3 pos;
-                        char t[2];
-                        sscanf(line_buf, "%s %f %f %f", t, &pos.x, &pos.y, &pos.z);
-
-                        darray_push(positions, pos);
+                        string_to_vec3(line_buf + 2, &pos);
+                        darray_push(chunk->positions, pos);
                     } break;
                     case 'n': {
                         // Vertex normal
                         vec3 norm;
-                        char t[2];
-                        sscanf(line_buf, "%s %f %f %f", t, &norm.x, &norm.y, &norm.z);
-
-                        darray_push(normals, norm);
+                        string_to_vec3(line_buf + 2, &norm);
+                        darray_push(chunk->normals, norm);
                     } break;
                     case 't': {
                         // Vertex texture coords.
-                        vec2 tex_coord;
-                        char t[2];
-
                         // NOTE: Ignoring Z if present.
-                        sscanf(line_buf, "%s %f %f", t, &tex_coord.x, &tex_coord.y);
-
-                        darray_push(tex_coords, tex_coord);
+                        vec2 tex_coord;
+                        string_to_vec2(line_buf + 2, &tex_coord);
+                        darray_push(chunk->tex_coords, tex_coord);
                     } break;
                 }
             } break;
-            case 's': {
-            } break;
             case 'f': {
                 // face
                 // f 1/1/1 2/2/2 3/3/3  = pos/tex/norm pos/tex/norm pos/tex/norm
-                mesh_face_data face;
-                char t[2];
-
-                u64 normal_count = darray_length(normals);
-                u64 tex_coord_count = darray_length(tex_coords);
-
-                if (normal_count == 0 || tex_coord_count == 0) {
-                    sscanf(line_buf, "%s %d %d %d", t, &face.vertices[0].position_index,
-                           &face.vertices[1].position_index,
-                           &face.vertices[2].position_index);
-                } else {
-                    sscanf(line_buf, "%s %d/%d/%d %d/%d/%d %d/%d/%d", t,
-                           &face.vertices[0].position_index,
-                           &face.vertices[0].texcoord_index, &face.vertices[0].normal_index,
-
-                           &face.vertices[1].position_index,
-                           &face.vertices[1].texcoord_index, &face.vertices[1].normal_index,
-
-                           &face.vertices[2].position_index,
-                           &face.vertices[2].texcoord_index,
-                           &face.vertices[2].normal_index);
+                // Faces without texture coordinates and normals are just positions (f 1 2 3).
+                mesh_face_data face = {0};
+                b8 parsed = obj_face_parse(line_buf + 1, string_index_of(line_buf, '/') != -1, &face);
+                if (parsed) {
+                    darray_push(chunk->faces, face);
                 }
-                u64 group_index = darray_length(groups) - 1;
-                darray_push(groups[group_index].faces, face);
             } break;
-            case 'm': {
-                // Material library file.
-                char substr[7];
-
-                sscanf(line_buf, "%s %s", substr, material_file_name);
-
-                // If found, save off the material file name.
-                if (strings_nequali(substr, "mtllib", 6)) {
-                    // TODO: verification
+            case 'm':
+            case 'u':
+            case 'g': {
+                // mtllib, usemtl or g, each followed by a name.
+                char keyword[8] = "";
+                obj_statement statement = {};
+                statement.face_index = darray_length(chunk->faces);
+                sscanf(line_buf, "%7s %511s", keyword, statement.value);
+                if (strings_equal(keyword, "mtllib")) {
+                    statement.type = OBJ_STATEMENT_MTLLIB;
+                } else if (strings_equal(keyword, "usemtl")) {
+                    statement.type = OBJ_STATEMENT_USEMTL;
+                } else if (strings_equal(keyword, "g")) {
+                    statement.type = OBJ_STATEMENT_GROUP;
+                } else {
+                    break;
                 }
+                darray_push(chunk->statements, statement);
             } break;
-            case 'u': {
-                // Any time there is a usemtl, assume a new group.
-                // New named group or smoothing group, all faces coming after should be
-                // added to it.
-                mesh_group_data new_group;
-                new_group.faces = darray_reserve(mesh_face_data, 16384);
-                darray_push(groups, new_group);
+        }
+    }  // each line
+}
 
-                // usemtl
-                // Read the material name.
-                char t[8];
-                sscanf(line_buf, "%s %s", t, material_names[current_mat_name_count]);
-                current_mat_name_count++;
-            } break;
-            case 'g': {
-                u64 group_count = darray_length(groups);
-                // Process each group as a subobject.
-                for (u64 i = 0; i < group_count; ++i) {
-                    geometry_config new_data = {};
-                    string_ncopy(new_data.name, name, 255);
-                    if (i > 0) {
-                        string_append_int(new_data.name, new_data.name, i);
-                    }
-                    string_ncopy(new_data.material_name, material_names[i], 255);
+static void obj_chunk_parse_batch(u32 start, u32 end, void *user_data) {
+    obj_chunk *chunks = user_data;
+    for (u32 i = start; i < end; ++i) {
+        obj_chunk_parse(&chunks[i]);
+    }
+}
 
-                    process_subobject(positions, normals, tex_coords, groups[i].faces,
-                                      &new_data);
-                    new_data.vertex_count = darray_length(new_data.vertices);
-                    new_data.vertex_size = sizeof(vertex_3d);
-                    new_data.index_count = darray_length(new_data.indices);
-                    new_data.index_size = sizeof(u32);
+static void obj_chunk_destroy(obj_chunk *chunk) {
+    darray_destroy(chunk->positions);
+    darray_destroy(chunk->normals);
+    darray_destroy(chunk->tex_coords);
+    darray_destroy(chunk->faces);
+    darray_destroy(chunk->statements);
+}
 
-                    darray_push(*out_geometries_darray, new_data);
+// Appends the given parsed data to a combined darray. The array must already have the capacity to hold it.
+static void obj_data_append(void *array, const void *data) {
+    u64 length = darray_length(array);
+    u64 count = darray_length((void *)data);
+    kcopy_memory((u8 *)array + darray_stride(array) * length, data, darray_stride(array) * count);
+    darray_length_set(array, length + count);
+}
 
-                    // Increment the number of objects.
-                    darray_destroy(groups[i].faces);
-                    kzero_memory(material_names[i], 64);
-                }
+// Names the groups found since the last object or group name was found after it.
+static void obj_groups_name(mesh_group_data *groups, u32 first_group, const char *name) {
+    u32 group_count = darray_length(groups);
+    for (u32 i = first_group; i < group_count; ++i) {
+        string_ncopy(groups[i].config.name, name, GEOMETRY_NAME_MAX_LENGTH - 1);
+        if (i > first_group) {
+            string_append_int(groups[i].config.name, groups[i].config.name, i - first_group);
+        }
+    }
+}
 
-                current_mat_name_count = 0;
-                darray_clear(groups);
-                kzero_memory(name, 512);
+/**
+ * @brief Optimizes a geometry processed from an imported file into the form stored in a ksm
+ * file: its vertices de-duplicated, tangents generated, levels of detail generated, its vertices
+ * and indices reordered for drawing, and finally its vertices packed if they fit.
+ *
+ * @param g A pointer to the geometry config, whose vertices and indices must be darrays.
+ */
+static void geometry_import_optimize(geometry_config *g) {
+    KDEBUG(
+        "Geometry de-duplication process starting on geometry object named "
+        "'%s'...",
+        g->name);
+
+    u32 new_vert_count = 0;
+    vertex_3d *unique_verts = 0;
+    geometry_deduplicate_vertices(g->vertex_count, g->vertices, g->index_count,
+                                  g->indices, &new_vert_count, &unique_verts);
+
+    // Destroy the old, large array...
+    darray_destroy(g->vertices);
+
+    // And replace with the de-duplicated one.
+    g->vertices = unique_verts;
+    g->vertex_count = new_vert_count;
+
+    // Take a copy of the indices as a normal, non-darray
+    u32 *indices = kallocate(sizeof(u32) * g->index_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(indices, g->indices, sizeof(u32) * g->index_count);
+    // Destroy the darray
+    darray_destroy(g->indices);
+    // Replace with the non-darray version.
+    g->indices = indices;
+
+    // Also generate tangents here, this way tangents are also stored in the
+    // output file.
+    geometry_generate_tangents(g->vertex_count, g->vertices, g->index_count,
+                               g->indices);
+
+    // Generate the levels of detail, which are stored in the output file as well.
+    generate_lods(g);
+
+    // Reorder each level's triangles for the vertex cache and overdraw, then the vertices to
+    // match, so the file is stored ready to draw efficiently.
+    for (u32 l = 0; l < g->lod_count; ++l) {
+        geometry_optimize_vertex_cache(g->vertex_count, g->vertices, g->lods[l].index_count,
+                                       &((u32 *)g->indices)[g->lods[l].index_offset], true);
+    }
+    geometry_optimize_vertex_fetch(g->vertex_count, g->vertices, g->index_count, g->indices);
 
-                // Read the name
-                char t[2];
-                sscanf(line_buf, "%s %s", t, name);
+    // Split the full-detail level of large geometries into clusters, which can each be culled on
+    // their own. Done before packing, from the full precision positions.
+    if (g->lods[0].index_count >= KSM_CLUSTER_MIN_TRIANGLES * 3) {
+        g->cluster_count = geometry_build_clusters(g->vertex_count, g->vertices, g->lods[0].index_count, g->indices, &g->clusters);
+        KDEBUG("Split geometry '%s' into %u clusters.", g->name, g->cluster_count);
+    }
 
-            } break;
-        }
+    // Pack the vertices where they fit, which more than halves their size. Texture
+    // coordinates outside the packed range are left at full precision instead.
+    vertex_3d_packed *packed = kallocate(sizeof(vertex_3d_packed) * g->vertex_count, MEMORY_TAG_ARRAY);
+    if (geometry_pack_vertices(g->vertex_count, g->vertices, packed, &g->quantization_center, &g->quantization_scale)) {
+        kfree(g->vertices, sizeof(vertex_3d) * g->vertex_count, MEMORY_TAG_ARRAY);
+        g->vertices = packed;
+        g->vertex_size = sizeof(vertex_3d_packed);
+        g->vertex_format = GEOMETRY_VERTEX_FORMAT_PACKED;
+    } else {
+        KDEBUG("Geometry '%s' has texture coordinates outside the packed range. Its vertices will not be packed.", g->name);
+        kfree(packed, sizeof(vertex_3d_packed) * g->vertex_count, MEMORY_TAG_ARRAY);
+    }
+}
 
-        prev_first_chars[1] = prev_first_chars[0];
-        prev_first_chars[0] = first_char;
-    }  // each line
+// Shared by the jobs processing each group of an obj file into a geometry.
+typedef struct obj_process_context {
+    vec3 *positions;
+    vec3 *normals;
+    vec2 *tex_coords;
+    mesh_group_data *groups;
+} obj_process_context;
+
+static void obj_group_process_batch(u32 start, u32 end, void *user_data) {
+    obj_process_context *context = user_data;
+    for (u32 i = start; i < end; ++i) {
+        // The intermediate data of processing a group is only needed until it is optimized.
+        scratch_scope scratch = scratch_begin();
+        mesh_group_data *group = &context->groups[i];
+        geometry_config *g = &group->config;
+        process_subobject(context->positions, context->normals, context->tex_coords, group->faces, g);
+        g->vertex_count = darray_length(g->vertices);
+        g->vertex_size = sizeof(vertex_3d);
+        g->index_count = darray_length(g->indices);
+        g->index_size = sizeof(u32);
+        darray_destroy(group->faces);
+        group->faces = 0;
+
+        geometry_import_optimize(g);
+        scratch_end(&scratch);
+    }
+}
 
-    // Process the remaining group since the last one will not have been trigged
-    // by the finding of a new name.
-    // Process each group as a subobject.
-    u64 group_count = darray_length(groups);
-    for (u64 i = 0; i < group_count; ++i) {
-        geometry_config new_data = {};
-        string_ncopy(new_data.name, name, 255);
-        if (i > 0) {
-            string_append_int(new_data.name, new_data.name, i);
+static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
+                          const char *material_directory, geometry_config **out_geometries_darray) {
+    // Read the whole file, so it can be split into chunks to be parsed in parallel.
+    u64 file_size = 0;
+    if (!filesystem_size(obj_file, &file_size)) {
+        KERROR("Unable to obtain the size of obj file.");
+        return false;
+    }
+    // Everything but the geometries themselves is only needed during the import.
+    scratch_scope scratch = scratch_begin();
+    char *text = scratch_allocate(&scratch, KMAX(file_size, 1));
+    u64 bytes_read = 0;
+    if (!text || (file_size && !filesystem_read_all_bytes(obj_file, (u8 *)text, &bytes_read))) {
+        KERROR("Unable to read obj file.");
+        scratch_end(&scratch);
+        return false;
+    }
+
+    // Split the file into chunks, each extended to the end of the line it would end within.
+    obj_chunk *chunks = darray_create(obj_chunk);
+    u64 offset = 0;
+    while (offset < file_size) {
+        obj_chunk chunk = {};
+        chunk.start = text + offset;
+        u64 end = KMIN(offset + OBJ_CHUNK_SIZE, file_size);
+        while (end < file_size && text[end - 1] != '\n') {
+            end++;
         }
-        string_ncopy(new_data.material_name, material_names[i], 255);
+        chunk.size = end - offset;
+        darray_push(chunks, chunk);
+        offset = end;
+    }
+    u32 chunk_count = darray_length(chunks);
+    job_parallel_for(chunk_count, 1, obj_chunk_parse_batch, chunks);
+
+    // Combine the parsed data. Indices in faces are for the whole file, so the vertex data of each chunk just follows that of the last.
+    u64 position_count = 0;
+    u64 normal_count = 0;
+    u64 tex_coord_count = 0;
+    for (u32 i = 0; i < chunk_count; ++i) {
+        position_count += darray_length(chunks[i].positions);
+        normal_count += darray_length(chunks[i].normals);
+        tex_coord_count += darray_length(chunks[i].tex_coords);
+    }
+    // NOTE: Arrays in scratch memory are only added to on this thread.
+    frame_allocator_int *scratch_int = scratch_allocator_int();
+    vec3 *positions = darray_reserve_with_allocator(vec3, KMAX(position_count, 1), scratch_int);
+    vec3 *normals = darray_reserve_with_allocator(vec3, KMAX(normal_count, 1), scratch_int);
+    vec2 *tex_coords = darray_reserve_with_allocator(vec2, KMAX(tex_coord_count, 1), scratch_int);
 
-        process_subobject(positions, normals, tex_coords, groups[i].faces,
-                          &new_data);
-        new_data.vertex_count = darray_length(new_data.vertices);
-        new_data.vertex_size = sizeof(vertex_3d);
-        new_data.index_count = darray_length(new_data.indices);
-        new_data.index_size = sizeof(u32);
+    // Groups, in the order they appear. A new group starts with each usemtl, and is named
+    // after the object or group name found before the next one.
+    mesh_group_data *groups = darray_reserve_with_allocator(mesh_group_data, 4, scratch_int);
+    u32 first_unnamed_group = 0;
 
-        darray_push(*out_geometries_darray, new_data);
+    char material_file_name[512] = "";
+    char name[512] = "";
+
+    for (u32 c = 0; c < chunk_count; ++c) {
+        obj_chunk *chunk = &chunks[c];
+        obj_data_append(positions, chunk->positions);
+        obj_data_append(normals, chunk->normals);
+        obj_data_append(tex_coords, chunk->tex_coords);
+
+        u32 face_cursor = 0;
+        u32 face_count = darray_length(chunk->faces);
+        u32 statement_count = darray_length(chunk->statements);
+        for (u32 s = 0; s <= statement_count; ++s) {
+            // Faces before the statement belong to the current group.
+            u32 face_end = s < statement_count ? chunk->statements[s].face_index : face_count;
+            if (face_cursor < face_end && darray_length(groups) == first_unnamed_group) {
+                // Faces without a group of their own get one without a material.
+                mesh_group_data new_group = {};
+                new_group.faces = darray_reserve_with_allocator(mesh_face_data, 16384, scratch_int);
+                darray_push(groups, new_group);
+            }
+            for (; face_cursor < face_end; ++face_cursor) {
+                darray_push(groups[darray_length(groups) - 1].faces, chunk->faces[face_cursor]);
+            }
+            if (s == statement_count) {
+                break;
+            }
 
-        // Increment the number of objects.
-        darray_destroy(groups[i].faces);
+            obj_statement *statement = &chunk->statements[s];
+            switch (statement->type) {
+                case OBJ_STATEMENT_MTLLIB:
+                    // Material library file.
+                    string_ncopy(material_file_name, statement->value, sizeof(material_file_name) - 1);
+                    break;
+                case OBJ_STATEMENT_USEMTL: {
+                    // Any time there is a usemtl, assume a new group.
+                    // New named group or smoothing group, all faces coming after should be
+                    // added to it.
+                    mesh_group_data new_group = {};
+                    new_group.faces = darray_reserve_with_allocator(mesh_face_data, 16384, scratch_int);
+                    string_ncopy(new_group.config.material_name, statement->value, MATERIAL_NAME_MAX_LENGTH - 1);
+                    darray_push(groups, new_group);
+                } break;
+                case OBJ_STATEMENT_GROUP:
+                    // The groups so far belong to the previous name.
+                    obj_groups_name(groups, first_unnamed_group, name);
+                    first_unnamed_group = darray_length(groups);
+                    string_ncopy(name, statement->value, sizeof(name) - 1);
+                    break;
+            }
+        }
+        obj_chunk_destroy(chunk);
     }
+    darray_destroy(chunks);
 
-    darray_destroy(groups);
-    darray_destroy(positions);
-    darray_destroy(normals);
-    darray_destroy(tex_coords);
+    // Name the remaining groups, since they will not have been by the finding of a new name.
+    obj_groups_name(groups, first_unnamed_group, name);
 
     if (string_length(material_file_name) > 0) {
         // Load up the material file
@@ -503,60 +972,87 @@ static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
         string_append_string(full_mtl_path, full_mtl_path, material_file_name);
 
         // Process material library file.
-        if (!import_obj_material_library_file(full_mtl_path)) {
+        if (!import_obj_material_library_file(full_mtl_path, material_directory)) {
             KERROR("Error reading obj mtl file.");
         }
     }
 
-    // De-duplicate geometry
-    u32 count = darray_length(*out_geometries_darray);
-    for (u64 i = 0; i < count; ++i) {
-        geometry_config *g = &((*out_geometries_darray)[i]);
-        KDEBUG(
-            "Geometry de-duplication process starting on geometry object named "
-            "'%s'...",
-            g->name);
-
-        u32 new_vert_count = 0;
-        vertex_3d *unique_verts = 0;
-        geometry_deduplicate_vertices(g->vertex_count, g->vertices, g->index_count,
-                                      g->indices, &new_vert_count, &unique_verts);
-
-        // Destroy the old, large array...
-        darray_destroy(g->vertices);
-
-        // And replace with the de-duplicated one.
-        g->vertices = unique_verts;
-        g->vertex_count = new_vert_count;
-
-        // Take a copy of the indices as a normal, non-darray
-        u32 *indices = kallocate(sizeof(u32) * g->index_count, MEMORY_TAG_ARRAY);
-        kcopy_memory(indices, g->indices, sizeof(u32) * g->index_count);
-        // Destroy the darray
-        darray_destroy(g->indices);
-        // Replace with the non-darray version.
-        g->indices = indices;
-
-        // Also generate tangents here, this way tangents are also stored in the
-        // output file.
-        geometry_generate_tangents(g->vertex_count, g->vertices, g->index_count,
-                                   g->indices);
+    // Process each group as a subobject, each in its own job. Any parallelism within them
+    // (e.g. de-duplication) is shared among the same threads.
+    obj_process_context context = {positions, normals, tex_coords, groups};
+    u32 group_count = darray_length(groups);
+    job_parallel_for(group_count, 1, obj_group_process_batch, &context);
+    for (u32 i = 0; i < group_count; ++i) {
+        darray_push(*out_geometries_darray, groups[i].config);
     }
 
+    scratch_end(&scratch);
+
     // Output a ksm file, which will be loaded in the future.
-    return write_ksm_file(out_ksm_filename, name, count, *out_geometries_darray);
+    return write_ksm_file(out_ksm_filename, name, group_count, *out_geometries_darray);
+}
+
+/**
+ * @brief Generates a chain of simplified levels of detail for the given geometry, each with
+ * about half the triangles of the one before it. The indices of each level are appended to
+ * those of the geometry. Stops early once a level would no longer be much simpler.
+ *
+ * @param g A pointer to the geometry config, whose indices must be a plain (non-darray) array.
+ */
+static void generate_lods(geometry_config *g) {
+    g->lod_count = 1;
+    g->lods[0] = (geometry_lod){0, g->index_count, 0.0f};
+
+    // Small geometries are cheap enough as they are.
+    if (g->index_count < 3 * 256) {
+        return;
+    }
+
+    // The error allowed of any level, relative to the size of the geometry.
+    f32 radius = vec3_length(vec3_sub(g->max_extents, g->min_extents)) * 0.5f;
+    f32 max_error = radius * 0.1f;
+
+    scratch_scope scratch = scratch_begin();
+    u32 *lod_indices = scratch_allocate(&scratch, sizeof(u32) * g->index_count);
+    u32 total_count = g->index_count;
+    u32 *all_indices = g->indices;
+    while (g->lod_count < GEOMETRY_MAX_LOD_COUNT) {
+        geometry_lod *previous = &g->lods[g->lod_count - 1];
+        f32 error = 0;
+        u32 count = geometry_simplify(g->vertex_count, g->vertices, previous->index_count, &all_indices[previous->index_offset],
+                                      (previous->index_count / 6) * 3, max_error, lod_indices, &error);
+        if (count > previous->index_count * 3 / 4) {
+            break;
+        }
+
+        // Append the level's indices.
+        all_indices = kreallocate(all_indices, sizeof(u32) * total_count, sizeof(u32) * (total_count + count), MEMORY_TAG_ARRAY);
+        kcopy_memory(&all_indices[total_count], lod_indices, sizeof(u32) * count);
+
+        // Each level is simplified from the one before it, so the errors add up.
+        g->lods[g->lod_count] = (geometry_lod){total_count, count, g->lods[g->lod_count - 1].error + error};
+        g->lod_count++;
+        total_count += count;
+    }
+    scratch_end(&scratch);
+
+    g->indices = all_indices;
+    g->index_count = total_count;
+    KDEBUG("Generated %u levels of detail for geometry '%s'.", g->lod_count, g->name);
 }
 
 static void process_subobject(vec3 *positions, vec3 *normals, vec2 *tex_coords,
                               mesh_face_data *faces,
                               geometry_config *out_data) {
-    out_data->indices = darray_create(u32);
-    out_data->vertices = darray_create(vertex_3d);
+    u64 face_count = darray_length(faces);
+    // These are only needed until the geometry is optimized, so are taken from the caller's scratch scope.
+    frame_allocator_int *scratch_int = scratch_allocator_int();
+    out_data->indices = darray_reserve_with_allocator(u32, KMAX(face_count * 3, 1), scratch_int);
+    out_data->vertices = darray_reserve_with_allocator(vertex_3d, KMAX(face_count * 3, 1), scratch_int);
     b8 extent_set = false;
     kzero_memory(&out_data->min_extents, sizeof(vec3));
     kzero_memory(&out_data->max_extents, sizeof(vec3));
 
-    u64 face_count = darray_length(faces);
     u64 normal_count = darray_length(normals);
     u64 tex_coord_count = darray_length(tex_coords);
 
@@ -644,7 +1140,7 @@ static void process_subobject(vec3 *positions, vec3 *normals, vec2 *tex_coords,
 // the _original_ existing material name would be used, which would visually be
 // wrong and serve as additional reinforcement of the message for material
 // uniqueness. Material configs should not be returned or used here.
-static b8 import_obj_material_library_file(const char *mtl_file_path) {
+static b8 import_obj_material_library_file(const char *mtl_file_path, const char *material_directory) {
     KDEBUG("Importing obj .mtl file '%s'...", mtl_file_path);
     // Grab the .mtl file, if it exists, and read the material information.
     file_handle mtl_file;
@@ -811,7 +1307,7 @@ static b8 import_obj_material_library_file(const char *mtl_file_path) {
                     current_config.shader_name = "Shader.PBRMaterial";
                     if (hit_name) {
                         //  Write out a kmt file and move on.
-                        if (!write_kmt_file(mtl_file_path, &current_config)) {
+                        if (!write_kmt_file(material_directory, &current_config)) {
                             KERROR("Unable to write kmt file.");
                             return false;
                         }
@@ -845,7 +1341,7 @@ static b8 import_obj_material_library_file(const char *mtl_file_path) {
     // NOTE: Hardcoding default material shader name because all objects imported
     // this way will be treated the same.
     current_config.shader_name = "Shader.PBRMaterial";
-    if (!write_kmt_file(mtl_file_path, &current_config)) {
+    if (!write_kmt_file(material_directory, &current_config)) {
         KERROR("Unable to write kmt file.");
         return false;
     }
@@ -902,20 +1398,16 @@ static const char *string_from_type(shader_uniform_type type) {
  * @brief Write out a kohi material file from config. This gets loaded by name
  * later when the mesh is requested for load.
  *
- * @param mtl_file_path The filepath of the material library file which
- * originally contained the material definition.
+ * @param material_directory The directory the file is written to, ending in a separator.
  * @param config A pointer to the config to be converted to kmt.
  * @return True on success; otherwise false.
  */
-static b8 write_kmt_file(const char *mtl_file_path, material_config *config) {
-    // NOTE: The .obj file this came from (and resulting .mtl file) sit in the
-    // models directory. This moves up a level and back into the materials folder.
-    // TODO: Read from config and get an absolute path for output.
+static b8 write_kmt_file(const char *material_directory, material_config *config) {
     char *format_str = "%s%s%s";
     file_handle f;
 
     char full_file_path[512];
-    string_format(full_file_path, format_str, resource_system_base_path_for_type(RESOURCE_TYPE_MATERIAL), config->name, ".kmt");
+    string_format(full_file_path, format_str, material_directory, config->name, ".kmt");
     if (!filesystem_open(full_file_path, FILE_MODE_WRITE, false, &f)) {
         KERROR("Error opening material file for writing: '%s'", full_file_path);
         return false;
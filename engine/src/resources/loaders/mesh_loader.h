@@ -19,3 +19,32 @@
  * @return The newly created resource loader.
  */
 resource_loader mesh_resource_loader_create(void);
+
+/**
+ * @brief Loads the geometries of a ksm file at the given path, outside of the resource system,
+ * e.g. for tools which process meshes offline.
+ *
+ * @param path The path to the file.
+ * @param out_geometries_darray A pointer to hold a new darray of the geometry configs, to be freed with
+ * mesh_loader_geometries_free. Left 0 on failure.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 mesh_loader_ksm_load(const char* path, struct geometry_config** out_geometries_darray);
+
+/**
+ * @brief Imports an obj file into a ksm file, outside of the resource system, e.g. for tools which
+ * cook assets ahead of time. The materials of its material library are written as kmt files.
+ *
+ * @param obj_path The path to the obj file.
+ * @param out_ksm_path The path of the ksm file to be written.
+ * @param material_directory The directory the kmt files are written to, ending in a separator.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 mesh_loader_obj_import(const char* obj_path, const char* out_ksm_path, const char* material_directory);
+
+/**
+ * @brief Disposes of the geometry configs loaded by the mesh loader, then destroys their darray.
+ *
+ * @param geometries_darray The darray of geometry configs.
+ */
+KAPI void mesh_loader_geometries_free(struct geometry_config* geometries_darray);
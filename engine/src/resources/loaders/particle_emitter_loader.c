@@ -0,0 +1,198 @@
+#include "particle_emitter_loader.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "loader_utils.h"
+#include "math/kmath.h"
+#include "platform/filesystem.h"
+#include "resources/particle_emitter.h"
+#include "resources/resource_types.h"
+#include "systems/resource_system.h"
+
+// Parses a float, warning and keeping the current value if it isn't one.
+static void parse_f32(const char* var_name, const char* value, f32* out_value) {
+    if (!string_to_f32(value, out_value)) {
+        KWARN("Format error: failed to parse %s. Using default value.", var_name);
+    }
+}
+
+static b8 particle_emitter_loader_load(struct resource_loader* self, const char* name,
+                                       void* params, resource* out_resource) {
+    if (!self || !name || !out_resource) {
+        return false;
+    }
+
+    char* format_str = "%s/%s/%s%s";
+    char full_file_path[512];
+    string_format(full_file_path, format_str, resource_system_base_path(),
+                  self->type_path, name, ".kpe");
+
+    file_handle f;
+    if (!filesystem_open(full_file_path, FILE_MODE_READ, false, &f)) {
+        KERROR("particle_emitter_loader_load - unable to open particle emitter file for reading: '%s'.", full_file_path);
+        return false;
+    }
+
+    out_resource->full_path = string_duplicate(full_file_path);
+
+    particle_emitter_config* resource_data = kallocate(sizeof(particle_emitter_config), MEMORY_TAG_RESOURCE);
+    // Set some defaults.
+    resource_data->max_particles = 1024;
+    resource_data->spawn_rate = 100.0f;
+    resource_data->lifetime_min = 1.0f;
+    resource_data->lifetime_max = 2.0f;
+    resource_data->speed_min = 1.0f;
+    resource_data->speed_max = 2.0f;
+    resource_data->direction = vec3_up();
+    resource_data->spread = 30.0f * K_DEG2RAD_MULTIPLIER;
+    resource_data->size_start = 0.2f;
+    resource_data->size_end = 0.2f;
+    resource_data->colour_start = vec4_one();
+    resource_data->colour_end = (vec4){1.0f, 1.0f, 1.0f, 0.0f};
+    resource_data->blend = PARTICLE_BLEND_MODE_ALPHA;
+
+    u32 version = 0;
+
+    // Read each line of the file.
+    char line_buf[512] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    u32 line_number = 1;
+    while (filesystem_read_line(&f, 511, &p, &line_length)) {
+        // Trim the string.
+        char* trimmed = string_trim(line_buf);
+
+        // Get the trimmed length.
+        line_length = string_length(trimmed);
+
+        // Skip blank lines and comments.
+        if (line_length < 1 || trimmed[0] == '#') {
+            line_number++;
+            continue;
+        }
+
+        // Split into var/value
+        i32 equal_index = string_index_of(trimmed, '=');
+        if (equal_index == -1) {
+            KWARN("Potential formatting issue found in file '%s': '=' token not found. Skipping line %ui.", full_file_path, line_number);
+            line_number++;
+            continue;
+        }
+
+        // Assume a max of 64 characters for the variable name.
+        char raw_var_name[64];
+        kzero_memory(raw_var_name, sizeof(char) * 64);
+        string_mid(raw_var_name, trimmed, 0, equal_index);
+        char* trimmed_var_name = string_trim(raw_var_name);
+
+        // Assume a max of 511-65 (446) for the max length of the value to account for the variable name and the '='.
+        char raw_value[446];
+        kzero_memory(raw_value, sizeof(char) * 446);
+        string_mid(raw_value, trimmed, equal_index + 1, -1);  // Read the rest of the line
+        char* trimmed_value = string_trim(raw_value);
+
+        // Process the variable.
+        if (strings_equali(trimmed_var_name, "version")) {
+            if (!string_to_u32(trimmed_value, &version)) {
+                KWARN("Format error - invalid file version.");
+            }
+        } else if (strings_equali(trimmed_var_name, "name")) {
+            if (resource_data->name) {
+                string_free(resource_data->name);
+            }
+            resource_data->name = string_duplicate(trimmed_value);
+        } else if (strings_equali(trimmed_var_name, "max_particles")) {
+            if (!string_to_u32(trimmed_value, &resource_data->max_particles)) {
+                KWARN("Format error: failed to parse max_particles. Using default value.");
+            }
+        } else if (strings_equali(trimmed_var_name, "spawn_rate")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->spawn_rate);
+        } else if (strings_equali(trimmed_var_name, "spawn_radius")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->spawn_radius);
+        } else if (strings_equali(trimmed_var_name, "lifetime_min")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->lifetime_min);
+        } else if (strings_equali(trimmed_var_name, "lifetime_max")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->lifetime_max);
+        } else if (strings_equali(trimmed_var_name, "speed_min")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->speed_min);
+        } else if (strings_equali(trimmed_var_name, "speed_max")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->speed_max);
+        } else if (strings_equali(trimmed_var_name, "direction")) {
+            if (!string_to_vec3(trimmed_value, &resource_data->direction)) {
+                KWARN("Format error: failed to parse direction. Using default value.");
+            }
+        } else if (strings_equali(trimmed_var_name, "spread")) {
+            // Given in degrees.
+            f32 spread_degrees = resource_data->spread * K_RAD2DEG_MULTIPLIER;
+            parse_f32(trimmed_var_name, trimmed_value, &spread_degrees);
+            resource_data->spread = spread_degrees * K_DEG2RAD_MULTIPLIER;
+        } else if (strings_equali(trimmed_var_name, "gravity")) {
+            if (!string_to_vec3(trimmed_value, &resource_data->gravity)) {
+                KWARN("Format error: failed to parse gravity. Using default value.");
+            }
+        } else if (strings_equali(trimmed_var_name, "drag")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->drag);
+        } else if (strings_equali(trimmed_var_name, "size_start")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->size_start);
+        } else if (strings_equali(trimmed_var_name, "size_end")) {
+            parse_f32(trimmed_var_name, trimmed_value, &resource_data->size_end);
+        } else if (strings_equali(trimmed_var_name, "colour_start")) {
+            if (!string_to_vec4(trimmed_value, &resource_data->colour_start)) {
+                KWARN("Format error: failed to parse colour_start. Using default value.");
+            }
+        } else if (strings_equali(trimmed_var_name, "colour_end")) {
+            if (!string_to_vec4(trimmed_value, &resource_data->colour_end)) {
+                KWARN("Format error: failed to parse colour_end. Using default value.");
+            }
+        } else if (strings_equali(trimmed_var_name, "blend")) {
+            if (strings_equali(trimmed_value, "additive")) {
+                resource_data->blend = PARTICLE_BLEND_MODE_ADDITIVE;
+            } else if (strings_equali(trimmed_value, "alpha")) {
+                resource_data->blend = PARTICLE_BLEND_MODE_ALPHA;
+            } else {
+                KWARN("Format error: unknown blend mode '%s'. Using alpha blending.", trimmed_value);
+            }
+        } else {
+            KWARN("Unrecognized particle emitter property '%s' found in file '%s'. Skipping.", trimmed_var_name, full_file_path);
+        }
+
+        // Clear the line buffer.
+        kzero_memory(line_buf, sizeof(char) * 512);
+        line_number++;
+    }
+
+    filesystem_close(&f);
+
+    if (!resource_data->name) {
+        resource_data->name = string_duplicate(name);
+    }
+
+    out_resource->data = resource_data;
+    out_resource->data_size = sizeof(particle_emitter_config);
+
+    return true;
+}
+
+static void particle_emitter_loader_unload(struct resource_loader* self, resource* resource) {
+    particle_emitter_config* data = (particle_emitter_config*)resource->data;
+    if (data && data->name) {
+        string_free(data->name);
+        data->name = 0;
+    }
+
+    if (!resource_unload(self, resource, MEMORY_TAG_RESOURCE)) {
+        KWARN("particle_emitter_loader_unload called with nullptr for self or resource.");
+    }
+}
+
+resource_loader particle_emitter_resource_loader_create(void) {
+    resource_loader loader;
+    loader.type = RESOURCE_TYPE_PARTICLE_EMITTER;
+    loader.custom_type = 0;
+    loader.load = particle_emitter_loader_load;
+    loader.unload = particle_emitter_loader_unload;
+    loader.type_path = "particles";
+
+    return loader;
+}
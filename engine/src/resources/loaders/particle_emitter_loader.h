@@ -0,0 +1,21 @@
+/**
+ * @file particle_emitter_loader.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A resource loader that handles particle emitter config (.kpe) resources.
+ * @version 1.0
+ * @date 2023-12-07
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "systems/resource_system.h"
+
+/**
+ * @brief Creates and returns a particle emitter resource loader.
+ *
+ * @return The newly created resource loader.
+ */
+resource_loader particle_emitter_resource_loader_create(void);
@@ -11,38 +11,185 @@
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 
-static b8 shader_loader_load(struct resource_loader* self, const char* name, void* params, resource* out_resource) {
-    if (!self || !name || !out_resource) {
+/** @brief The most stages a shader config may list: vertex, geometry, fragment and compute. */
+#define SHADER_LOADER_MAX_STAGES 4
+/** @brief The most topology types a shader config may list. */
+#define SHADER_LOADER_MAX_TOPOLOGIES 6
+
+// The size of the headers at the start of every .ksbundle file.
+#define KSHADER_BUNDLE_HEADERS_SIZE (sizeof(resource_header) + sizeof(kshader_bundle_header))
+
+// Obtains the string at the given offset, if it is terminated within the strings.
+static const char* bundle_string_get(const char* strings, u32 string_size, u32 offset) {
+    for (u32 i = offset; i < string_size; ++i) {
+        if (strings[i] == 0) {
+            return strings + offset;
+        }
+    }
+    return 0;
+}
+
+// Fills out the config from the contents of a .ksbundle file. Everything is checked before anything
+// is taken from the file, so nothing needs to be cleaned up on failure.
+static b8 shader_bundle_parse(const char* path, const u8* data, u64 size, shader_config* out_config) {
+    if (size < KSHADER_BUNDLE_HEADERS_SIZE) {
+        KERROR("Shader bundle '%s' is too small to hold its headers.", path);
+        return false;
+    }
+    resource_header file_header;
+    kcopy_memory(&file_header, data, sizeof(resource_header));
+    if (file_header.magic_number != RESOURCE_MAGIC || file_header.resource_type != RESOURCE_TYPE_SHADER) {
+        KERROR("Shader bundle header of '%s' is invalid and cannot be read.", path);
+        return false;
+    }
+    if (file_header.version != KSHADER_BUNDLE_VERSION) {
+        KERROR("Shader bundle '%s' is version %u, but only version %u is supported.", path, file_header.version, KSHADER_BUNDLE_VERSION);
         return false;
     }
 
-    char* format_str = "%s/%s/%s%s";
-    char full_file_path[512];
-    string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, ".shadercfg");
+    kshader_bundle_header header;
+    kcopy_memory(&header, data + sizeof(resource_header), sizeof(kshader_bundle_header));
+    if (!header.stage_count || header.stage_count > SHADER_LOADER_MAX_STAGES || header.specialization_count > SHADER_MAX_SPECIALIZATIONS ||
+        header.attribute_count > 255 || header.uniform_count > 255) {
+        KERROR("Shader bundle '%s' has invalid shader properties.", path);
+        return false;
+    }
+    const kshader_bundle_attribute* attributes = (const kshader_bundle_attribute*)(data + KSHADER_BUNDLE_HEADERS_SIZE);
+    const kshader_bundle_uniform* uniforms = (const kshader_bundle_uniform*)(attributes + header.attribute_count);
+    const kshader_bundle_specialization* specializations = (const kshader_bundle_specialization*)(uniforms + header.uniform_count);
+    const kshader_bundle_stage* stages = (const kshader_bundle_stage*)(specializations + header.specialization_count);
+    const char* strings = (const char*)(stages + header.stage_count);
+    const u8* code = (const u8*)strings + header.string_size;
+    if ((u64)(code - data) + header.code_size != size) {
+        KERROR("Shader bundle '%s' size of %llu does not match its contents.", path, size);
+        return false;
+    }
+
+    b8 valid = bundle_string_get(strings, header.string_size, header.name_offset) != 0;
+    for (u32 i = 0; valid && i < header.attribute_count; ++i) {
+        valid = bundle_string_get(strings, header.string_size, attributes[i].name_offset) != 0;
+    }
+    for (u32 i = 0; valid && i < header.uniform_count; ++i) {
+        valid = bundle_string_get(strings, header.string_size, uniforms[i].name_offset) != 0;
+    }
+    for (u32 i = 0; valid && i < header.specialization_count; ++i) {
+        valid = bundle_string_get(strings, header.string_size, specializations[i].name_offset) != 0;
+    }
+    for (u32 i = 0; valid && i < header.stage_count; ++i) {
+        const kshader_bundle_stage* stage = &stages[i];
+        valid = bundle_string_get(strings, header.string_size, stage->name_offset) && bundle_string_get(strings, header.string_size, stage->filename_offset) &&
+                stage->code_size && stage->code_size % 4 == 0 && stage->code_offset % 4 == 0 && (u64)stage->code_offset + stage->code_size <= header.code_size;
+    }
+    if (!valid) {
+        KERROR("Shader bundle '%s' has invalid contents.", path);
+        return false;
+    }
+
+    out_config->name = string_duplicate(strings + header.name_offset);
+    out_config->max_instances = header.max_instances;
+    out_config->flags = header.flags;
+    out_config->topology_types = header.topology_types;
+    out_config->cull_mode = header.cull_mode;
+
+    for (u32 i = 0; i < header.attribute_count; ++i) {
+        shader_attribute_config attribute = {0};
+        attribute.name = string_duplicate(strings + attributes[i].name_offset);
+        attribute.name_length = string_length(attribute.name);
+        attribute.type = attributes[i].type;
+        attribute.size = attributes[i].size;
+        attribute.per_instance = attributes[i].per_instance;
+        attribute.packed = attributes[i].packed;
+        darray_push(out_config->attributes, attribute);
+    }
+    out_config->attribute_count = header.attribute_count;
+
+    for (u32 i = 0; i < header.uniform_count; ++i) {
+        shader_uniform_config uniform = {0};
+        uniform.name = string_duplicate(strings + uniforms[i].name_offset);
+        uniform.name_length = string_length(uniform.name);
+        uniform.type = uniforms[i].type;
+        uniform.scope = uniforms[i].scope;
+        uniform.size = uniforms[i].size;
+        uniform.array_length = uniforms[i].array_length;
+        darray_push(out_config->uniforms, uniform);
+    }
+    out_config->uniform_count = header.uniform_count;
+
+    for (u32 i = 0; i < header.specialization_count; ++i) {
+        shader_specialization_config* spec = &out_config->specializations[i];
+        spec->name = string_duplicate(strings + specializations[i].name_offset);
+        spec->id = specializations[i].id;
+        spec->default_value = specializations[i].default_value;
+    }
+    out_config->specialization_count = header.specialization_count;
+
+    out_config->stage_count = header.stage_count;
+    out_config->stage_configs = kallocate(sizeof(shader_stage_config) * header.stage_count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < header.stage_count; ++i) {
+        shader_stage_config* stage = &out_config->stage_configs[i];
+        stage->stage = stages[i].stage;
+        stage->name = string_duplicate(strings + stages[i].name_offset);
+        stage->filename = string_duplicate(strings + stages[i].filename_offset);
+        stage->source_length = stages[i].code_size;
+        stage->source = kallocate(stages[i].code_size, MEMORY_TAG_RESOURCE);
+        kcopy_memory(stage->source, code + stages[i].code_offset, stages[i].code_size);
+        stage->precompiled = true;
+    }
+    return true;
+}
 
+// Loads a .ksbundle file with a single read.
+static b8 shader_bundle_load(const char* path, shader_config* out_config) {
     file_handle f;
-    if (!filesystem_open(full_file_path, FILE_MODE_READ, false, &f)) {
-        KERROR("shader_loader_load - unable to open shader file for reading: '%s'.", full_file_path);
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        KERROR("Unable to open shader bundle for reading: '%s'.", path);
         return false;
     }
+    u64 size = 0;
+    u8* data = 0;
+    b8 result = filesystem_size(&f, &size) && size;
+    if (result) {
+        data = kallocate(size, MEMORY_TAG_RESOURCE);
+        u64 read = 0;
+        result = filesystem_read_all_bytes(&f, data, &read) && read == size;
+        if (!result) {
+            KERROR("Unable to read shader bundle '%s'.", path);
+        }
+    }
+    filesystem_close(&f);
 
-    out_resource->full_path = string_duplicate(full_file_path);
+    if (result) {
+        result = shader_bundle_parse(path, data, size, out_config);
+    }
+    if (data) {
+        kfree(data, size, MEMORY_TAG_RESOURCE);
+    }
+    return result;
+}
 
-    shader_config* resource_data = kallocate(sizeof(shader_config), MEMORY_TAG_RESOURCE);
-    // Set some defaults, create arrays.
-    resource_data->attribute_count = 0;
-    resource_data->attributes = darray_create(shader_attribute_config);
-    resource_data->uniform_count = 0;
-    resource_data->uniforms = darray_create(shader_uniform_config);
-    resource_data->stage_count = 0;
-    resource_data->stage_configs = 0;  // NOTE: initialized once count is known.
-    resource_data->cull_mode = FACE_CULL_MODE_BACK;
-    resource_data->topology_types = PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST;
-    resource_data->stage_count = 0;
+static void shader_config_defaults_set(shader_config* config) {
+    kzero_memory(config, sizeof(shader_config));
+    config->attributes = darray_create(shader_attribute_config);
+    config->uniforms = darray_create(shader_uniform_config);
+    config->cull_mode = FACE_CULL_MODE_BACK;
+    config->topology_types = PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST;
     // NOTE: This directly influences how much resources are available.
-    resource_data->max_instances = 1;
+    config->max_instances = 1;
+}
 
-    resource_data->name = 0;
+b8 shader_config_parse(const char* full_file_path, shader_config* out_config) {
+    if (!full_file_path || !out_config) {
+        return false;
+    }
+
+    shader_config* resource_data = out_config;
+    shader_config_defaults_set(resource_data);
+
+    file_handle f;
+    if (!filesystem_open(full_file_path, FILE_MODE_READ, false, &f)) {
+        KERROR("shader_config_parse - unable to open shader file for reading: '%s'.", full_file_path);
+        return false;
+    }
 
     // Read each line of the file.
     char line_buf[512] = "";
@@ -62,42 +209,38 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
             continue;
         }
 
-        // Split into var/value
-        i32 equal_index = string_index_of(trimmed, '=');
-        if (equal_index == -1) {
+        // Split into var/value. Both are views into the line buffer, so nothing is copied.
+        kstring_view var_name, value;
+        if (!kstring_view_split_pair(kstring_view_create(trimmed, line_length), '=', &var_name, &value)) {
             KWARN("Potential formatting issue found in file '%s': '=' token not found. Skipping line %ui.", full_file_path, line_number);
             line_number++;
             continue;
         }
-
-        // Assume a max of 64 characters for the variable name.
-        char raw_var_name[64];
-        kzero_memory(raw_var_name, sizeof(char) * 64);
-        string_mid(raw_var_name, trimmed, 0, equal_index);
-        char* trimmed_var_name = string_trim(raw_var_name);
-
-        // Assume a max of 511-65 (446) for the max length of the value to account for the variable name and the '='.
-        char raw_value[446];
-        kzero_memory(raw_value, sizeof(char) * 446);
-        string_mid(raw_value, trimmed, equal_index + 1, -1);  // Read the rest of the line
-        char* trimmed_value = string_trim(raw_value);
+        var_name = kstring_view_trim(var_name);
+        value = kstring_view_trim(value);
+        // The line is already trimmed, so the value runs to its null terminator and can be used as a string.
+        const char* trimmed_value = value.str;
 
         // Process the variable.
-        if (strings_equali(trimmed_var_name, "version")) {
+        if (kstring_view_equali(var_name, "version")) {
             // TODO: version
-        } else if (strings_equali(trimmed_var_name, "name")) {
+        } else if (kstring_view_equali(var_name, "name")) {
             resource_data->name = string_duplicate(trimmed_value);
-        } else if (strings_equali(trimmed_var_name, "renderpass")) {
+        } else if (kstring_view_equali(var_name, "renderpass")) {
             // resource_data->renderpass_name = string_duplicate(trimmed_value);
             // Ignore this now.
-        } else if (strings_equali(trimmed_var_name, "max_instances")) {
-            if (!string_to_u32(trimmed_value, &resource_data->max_instances)) {
+        } else if (kstring_view_equali(var_name, "max_instances")) {
+            if (!kstring_view_to_u32(value, &resource_data->max_instances)) {
                 KERROR("Invalid value for max_instances. Cannot be parsed to u32. Defaulting to &u", resource_data->max_instances);
             }
-        } else if (strings_equali(trimmed_var_name, "stages")) {
+        } else if (kstring_view_equali(var_name, "stages")) {
             // Parse the stages
-            char** stage_names = darray_create(char*);
-            u32 count = string_split(trimmed_value, ',', &stage_names, true, true);
+            kstring_view stage_names[SHADER_LOADER_MAX_STAGES];
+            u32 count = kstring_view_split(value, ',', stage_names, SHADER_LOADER_MAX_STAGES, true);
+            if (count > SHADER_LOADER_MAX_STAGES) {
+                KERROR("shader_loader_load: Invalid file layout. A shader may have at most %u stages.", SHADER_LOADER_MAX_STAGES);
+                return false;
+            }
             // Ensure stage name and stage file name count are the same, as they should align.
             if (resource_data->stage_count == 0) {
                 resource_data->stage_count = count;
@@ -108,25 +251,28 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
             }
             // Parse the stage names.
             for (u32 sn_idx = 0; sn_idx < count; ++sn_idx) {
-                resource_data->stage_configs[sn_idx].name = string_duplicate(stage_names[sn_idx]);
+                resource_data->stage_configs[sn_idx].name = kstring_view_duplicate(stage_names[sn_idx]);
                 // Parse the stage name and determine the actual configured stage.
-                if (strings_equali(stage_names[sn_idx], "frag") || strings_equali(stage_names[sn_idx], "fragment")) {
+                if (kstring_view_equali(stage_names[sn_idx], "frag") || kstring_view_equali(stage_names[sn_idx], "fragment")) {
                     resource_data->stage_configs[sn_idx].stage = SHADER_STAGE_FRAGMENT;
-                } else if (strings_equali(stage_names[sn_idx], "vert") || strings_equali(stage_names[sn_idx], "vertex")) {
+                } else if (kstring_view_equali(stage_names[sn_idx], "vert") || kstring_view_equali(stage_names[sn_idx], "vertex")) {
                     resource_data->stage_configs[sn_idx].stage = SHADER_STAGE_VERTEX;
-                } else if (strings_equali(stage_names[sn_idx], "geom") || strings_equali(stage_names[sn_idx], "geometry")) {
+                } else if (kstring_view_equali(stage_names[sn_idx], "geom") || kstring_view_equali(stage_names[sn_idx], "geometry")) {
                     resource_data->stage_configs[sn_idx].stage = SHADER_STAGE_GEOMETRY;
-                } else if (strings_equali(stage_names[sn_idx], "comp") || strings_equali(stage_names[sn_idx], "compute")) {
+                } else if (kstring_view_equali(stage_names[sn_idx], "comp") || kstring_view_equali(stage_names[sn_idx], "compute")) {
                     resource_data->stage_configs[sn_idx].stage = SHADER_STAGE_COMPUTE;
                 } else {
-                    KERROR("shader_loader_load: Invalid file layout. Unrecognized stage '%s'", stage_names[sn_idx]);
+                    KERROR("shader_loader_load: Invalid file layout. Unrecognized stage '%.*s'", (i32)stage_names[sn_idx].length, stage_names[sn_idx].str);
                 }
             }
-            string_cleanup_split_array(stage_names);
-        } else if (strings_equali(trimmed_var_name, "stagefiles")) {
+        } else if (kstring_view_equali(var_name, "stagefiles")) {
             // Parse the stage file names
-            char** stage_filenames = darray_create(char*);
-            u32 count = string_split(trimmed_value, ',', &stage_filenames, true, true);
+            kstring_view stage_filenames[SHADER_LOADER_MAX_STAGES];
+            u32 count = kstring_view_split(value, ',', stage_filenames, SHADER_LOADER_MAX_STAGES, true);
+            if (count > SHADER_LOADER_MAX_STAGES) {
+                KERROR("shader_loader_load: Invalid file layout. A shader may have at most %u stages.", SHADER_LOADER_MAX_STAGES);
+                return false;
+            }
             // Ensure stage name and stage file name count are the same, as they should align.
             if (resource_data->stage_count == 0) {
                 resource_data->stage_count = count;
@@ -137,10 +283,9 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
             }
             // Take a copy of each stage file name.
             for (u32 sn_idx = 0; sn_idx < count; ++sn_idx) {
-                resource_data->stage_configs[sn_idx].filename = string_duplicate(stage_filenames[sn_idx]);
+                resource_data->stage_configs[sn_idx].filename = kstring_view_duplicate(stage_filenames[sn_idx]);
             }
-            string_cleanup_split_array(stage_filenames);
-        } else if (strings_equali(trimmed_var_name, "cull_mode")) {
+        } else if (kstring_view_equali(var_name, "cull_mode")) {
             if (strings_equali(trimmed_value, "front")) {
                 resource_data->cull_mode = FACE_CULL_MODE_FRONT;
             } else if (strings_equali(trimmed_value, "front_and_back")) {
@@ -149,119 +294,176 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
                 resource_data->cull_mode = FACE_CULL_MODE_NONE;
             }
             // Any other value will use the default of BACK.
-        } else if (strings_equali(trimmed_var_name, "topology")) {
-            char** topologies = darray_create(char*);
-            u32 count = string_split(trimmed_value, ',', &topologies, true, true);
+        } else if (kstring_view_equali(var_name, "topology")) {
+            kstring_view topologies[SHADER_LOADER_MAX_TOPOLOGIES];
+            u32 count = KMIN(kstring_view_split(value, ',', topologies, SHADER_LOADER_MAX_TOPOLOGIES, true), SHADER_LOADER_MAX_TOPOLOGIES);
             // If there are no entries, default to triangle list, as this is the most common.
             if (count > 0) {
                 // If there is at least one entry, wipe out the default and only use what is configured.
                 resource_data->topology_types = PRIMITIVE_TOPOLOGY_TYPE_NONE;
                 for (u32 i = 0; i < count; ++i) {
-                    if (strings_equali(topologies[i], "triangle_list")) {
+                    if (kstring_view_equali(topologies[i], "triangle_list")) {
                         // NOTE: this is default, so we can skip this for now.
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST;
-                    } else if (strings_equali(topologies[i], "triangle_strip")) {
+                    } else if (kstring_view_equali(topologies[i], "triangle_strip")) {
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP;
-                    } else if (strings_equali(topologies[i], "triangle_fan")) {
+                    } else if (kstring_view_equali(topologies[i], "triangle_fan")) {
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN;
-                    } else if (strings_equali(topologies[i], "line_list")) {
+                    } else if (kstring_view_equali(topologies[i], "line_list")) {
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST;
-                    } else if (strings_equali(topologies[i], "line_strip")) {
+                    } else if (kstring_view_equali(topologies[i], "line_strip")) {
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP;
-                    } else if (strings_equali(topologies[i], "point_list")) {
+                    } else if (kstring_view_equali(topologies[i], "point_list")) {
                         resource_data->topology_types |= PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST;
                     } else {
-                        KERROR("Unrecognized topology type '%s'. Skipping.", topologies[i]);
+                        KERROR("Unrecognized topology type '%.*s'. Skipping.", (i32)topologies[i].length, topologies[i].str);
                     }
                 }
             }
-            string_cleanup_split_array(topologies);
-            darray_destroy(topologies);
-        } else if (strings_equali(trimmed_var_name, "depth_test")) {
+        } else if (kstring_view_equali(var_name, "depth_test")) {
             b8 depth_test;
-            string_to_bool(trimmed_value, &depth_test);
+            kstring_view_to_bool(value, &depth_test);
             if (depth_test) {
                 resource_data->flags |= SHADER_FLAG_DEPTH_TEST;
             }
-        } else if (strings_equali(trimmed_var_name, "depth_write")) {
+        } else if (kstring_view_equali(var_name, "depth_write")) {
             b8 depth_write;
-            string_to_bool(trimmed_value, &depth_write);
+            kstring_view_to_bool(value, &depth_write);
             if (depth_write) {
                 resource_data->flags |= SHADER_FLAG_DEPTH_WRITE;
             }
-        } else if (strings_equali(trimmed_var_name, "stencil_test")) {
+        } else if (kstring_view_equali(var_name, "colour_write")) {
+            // Colour is written unless explicitly disabled.
+            b8 colour_write;
+            if (kstring_view_to_bool(value, &colour_write) && !colour_write) {
+                resource_data->flags |= SHADER_FLAG_COLOUR_WRITE_DISABLED;
+            }
+        } else if (kstring_view_equali(var_name, "stencil_test")) {
             b8 stencil_test;
-            string_to_bool(trimmed_value, &stencil_test);
+            kstring_view_to_bool(value, &stencil_test);
             if (stencil_test) {
                 resource_data->flags |= SHADER_FLAG_STENCIL_TEST;
             }
-        } else if (strings_equali(trimmed_var_name, "wireframe")) {
+        } else if (kstring_view_equali(var_name, "wireframe")) {
             b8 wireframe;
-            string_to_bool(trimmed_value, &wireframe);
+            kstring_view_to_bool(value, &wireframe);
             if (wireframe) {
                 resource_data->flags |= SHADER_FLAG_WIREFRAME;
             }
-        } else if (strings_equali(trimmed_var_name, "attribute")) {
-            // Parse attribute.
-            char** fields = darray_create(char*);
-            u32 field_count = string_split(trimmed_value, ',', &fields, true, true);
+        } else if (kstring_view_equali(var_name, "bindless_textures")) {
+            b8 bindless_textures;
+            kstring_view_to_bool(value, &bindless_textures);
+            if (bindless_textures) {
+                resource_data->flags |= SHADER_FLAG_BINDLESS_TEXTURES;
+            }
+        } else if (kstring_view_equali(var_name, "blend")) {
+            // Blending mode of the colour output: alpha (default), additive or weighted.
+            if (kstring_view_equali(value, "additive")) {
+                resource_data->flags |= SHADER_FLAG_BLEND_ADDITIVE;
+            } else if (kstring_view_equali(value, "weighted")) {
+                resource_data->flags |= SHADER_FLAG_BLEND_WEIGHTED;
+            } else if (!kstring_view_equali(value, "alpha")) {
+                KERROR("Unrecognized blend mode '%.*s'. Using alpha blending.", (i32)value.length, value.str);
+            }
+        } else if (kstring_view_equali(var_name, "specialization")) {
+            // Parse a specialization constant: constant_id,name,default value.
+            kstring_view fields[3];
+            u32 field_count = kstring_view_split(value, ',', fields, 3, true);
+            if (field_count != 3) {
+                KERROR("shader_loader_load: Invalid file layout. Specialization fields must be 'id,name,default'. Skipping.");
+            } else if (resource_data->specialization_count >= SHADER_MAX_SPECIALIZATIONS) {
+                KERROR("shader_loader_load: A shader may have at most %u specialization constants. Skipping.", SHADER_MAX_SPECIALIZATIONS);
+            } else {
+                shader_specialization_config* spec = &resource_data->specializations[resource_data->specialization_count];
+                if (!kstring_view_to_u32(fields[0], &spec->id) || !kstring_view_to_u32(fields[2], &spec->default_value)) {
+                    KERROR("shader_loader_load: Specialization id and default must be unsigned integers. Skipping.");
+                } else {
+                    spec->name = kstring_view_duplicate(fields[1]);
+                    resource_data->specialization_count++;
+                }
+            }
+        } else if (kstring_view_equali(var_name, "attribute") || kstring_view_equali(var_name, "instance_attribute") || kstring_view_equali(var_name, "packed_attribute")) {
+            // Parse attribute. Instance attributes advance once per instance instead of once per vertex.
+            // Packed attributes make up an alternative per-vertex layout, used for packed geometry.
+            b8 per_instance = kstring_view_equali(var_name, "instance_attribute");
+            b8 packed = kstring_view_equali(var_name, "packed_attribute");
+            kstring_view fields[2];
+            u32 field_count = kstring_view_split(value, ',', fields, 2, true);
             if (field_count != 2) {
                 KERROR("shader_loader_load: Invalid file layout. Attribute fields must be 'type,name'. Skipping.");
             } else {
                 shader_attribute_config attribute;
+                attribute.per_instance = per_instance;
+                attribute.packed = packed;
                 // Parse field type
-                if (strings_equali(fields[0], "f32")) {
+                if (kstring_view_equali(fields[0], "f32")) {
                     attribute.type = SHADER_ATTRIB_TYPE_FLOAT32;
                     attribute.size = 4;
-                } else if (strings_equali(fields[0], "vec2")) {
+                } else if (kstring_view_equali(fields[0], "vec2")) {
                     attribute.type = SHADER_ATTRIB_TYPE_FLOAT32_2;
                     attribute.size = 8;
-                } else if (strings_equali(fields[0], "vec3")) {
+                } else if (kstring_view_equali(fields[0], "vec3")) {
                     attribute.type = SHADER_ATTRIB_TYPE_FLOAT32_3;
                     attribute.size = 12;
-                } else if (strings_equali(fields[0], "vec4")) {
+                } else if (kstring_view_equali(fields[0], "vec4")) {
                     attribute.type = SHADER_ATTRIB_TYPE_FLOAT32_4;
                     attribute.size = 16;
-                } else if (strings_equali(fields[0], "u8")) {
+                } else if (kstring_view_equali(fields[0], "mat4")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_MATRIX_4;
+                    attribute.size = 64;
+                } else if (kstring_view_equali(fields[0], "u8")) {
                     attribute.type = SHADER_ATTRIB_TYPE_UINT8;
                     attribute.size = 1;
-                } else if (strings_equali(fields[0], "u16")) {
+                } else if (kstring_view_equali(fields[0], "u16")) {
                     attribute.type = SHADER_ATTRIB_TYPE_UINT16;
                     attribute.size = 2;
-                } else if (strings_equali(fields[0], "u32")) {
+                } else if (kstring_view_equali(fields[0], "u32")) {
                     attribute.type = SHADER_ATTRIB_TYPE_UINT32;
                     attribute.size = 4;
-                } else if (strings_equali(fields[0], "i8")) {
+                } else if (kstring_view_equali(fields[0], "i8")) {
                     attribute.type = SHADER_ATTRIB_TYPE_INT8;
                     attribute.size = 1;
-                } else if (strings_equali(fields[0], "i16")) {
+                } else if (kstring_view_equali(fields[0], "i16")) {
                     attribute.type = SHADER_ATTRIB_TYPE_INT16;
                     attribute.size = 2;
-                } else if (strings_equali(fields[0], "i32")) {
+                } else if (kstring_view_equali(fields[0], "i32")) {
                     attribute.type = SHADER_ATTRIB_TYPE_INT32;
                     attribute.size = 4;
+                } else if (kstring_view_equali(fields[0], "snorm8_4")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_SNORM8_4;
+                    attribute.size = 4;
+                } else if (kstring_view_equali(fields[0], "snorm16_4")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_SNORM16_4;
+                    attribute.size = 8;
+                } else if (kstring_view_equali(fields[0], "unorm8_4")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_UNORM8_4;
+                    attribute.size = 4;
+                } else if (kstring_view_equali(fields[0], "f16_2")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_FLOAT16_2;
+                    attribute.size = 4;
+                } else if (kstring_view_equali(fields[0], "u8_4")) {
+                    attribute.type = SHADER_ATTRIB_TYPE_UINT8_4;
+                    attribute.size = 4;
                 } else {
-                    KERROR("shader_loader_load: Invalid file layout. Attribute type must be f32, vec2, vec3, vec4, i8, i16, i32, u8, u16, or u32.");
+                    KERROR("shader_loader_load: Invalid file layout. Attribute type must be f32, vec2, vec3, vec4, mat4, i8, i16, i32, u8, u16, u32, snorm8_4, snorm16_4, unorm8_4, f16_2 or u8_4.");
                     KWARN("Defaulting to f32.");
                     attribute.type = SHADER_ATTRIB_TYPE_FLOAT32;
                     attribute.size = 4;
                 }
 
                 // Take a copy of the attribute name.
-                attribute.name_length = string_length(fields[1]);
-                attribute.name = string_duplicate(fields[1]);
+                attribute.name_length = fields[1].length;
+                attribute.name = kstring_view_duplicate(fields[1]);
 
                 // Add the attribute.
                 darray_push(resource_data->attributes, attribute);
                 resource_data->attribute_count++;
             }
 
-            string_cleanup_split_array(fields);
-            darray_destroy(fields);
-        } else if (strings_equali(trimmed_var_name, "uniform")) {
+        } else if (kstring_view_equali(var_name, "uniform")) {
             // Parse uniform.
-            char** fields = darray_create(char*);
-            u32 field_count = string_split(trimmed_value, ',', &fields, true, true);
+            kstring_view fields[3];
+            u32 field_count = kstring_view_split(value, ',', fields, 3, true);
             if (field_count != 3) {
                 KERROR("shader_loader_load: Invalid file layout. Uniform fields must be 'type,scope,name'. Skipping.");
             } else {
@@ -269,94 +471,99 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
 
                 // Check if it's an array type.
                 u32 array_length = 1;  // An array length of 1 is just a single.
-                b8 is_array = string_parse_array_length(fields[0], &array_length);
+                kstring_view base_type = fields[0];
+                i64 open_index = kstring_view_index_of(fields[0], '[');
+                if (open_index != -1) {
+                    base_type = kstring_view_mid(fields[0], 0, open_index);
+                    i64 close_index = kstring_view_index_of(fields[0], ']');
+                    if (close_index > open_index && !kstring_view_to_u32(kstring_view_mid(fields[0], open_index + 1, close_index - open_index - 1), &array_length)) {
+                        array_length = 1;
+                    }
+                }
                 if (array_length < 1) {
                     KWARN("Cannot have an array with a length < 1. Defaulting to 1.");
                     array_length = 1;
                 }
-                char base_type[100];
-                if (is_array) {
-                    string_mid(base_type, fields[0], 0, string_index_of(fields[0], '['));
-                } else {
-                    string_copy(base_type, fields[0]);
-                }
 
                 uniform.size = 0;
                 uniform.array_length = array_length;
                 // Parse field type
-                if (strings_equali(base_type, "f32")) {
+                if (kstring_view_equali(base_type, "f32")) {
                     uniform.type = SHADER_UNIFORM_TYPE_FLOAT32;
                     uniform.size = 4;
-                } else if (strings_equali(base_type, "vec2")) {
+                } else if (kstring_view_equali(base_type, "vec2")) {
                     uniform.type = SHADER_UNIFORM_TYPE_FLOAT32_2;
                     uniform.size = 8;
-                } else if (strings_equali(base_type, "vec3")) {
+                } else if (kstring_view_equali(base_type, "vec3")) {
                     uniform.type = SHADER_UNIFORM_TYPE_FLOAT32_3;
                     uniform.size = 12;
-                } else if (strings_equali(base_type, "vec4")) {
+                } else if (kstring_view_equali(base_type, "vec4")) {
                     uniform.type = SHADER_UNIFORM_TYPE_FLOAT32_4;
                     uniform.size = 16;
-                } else if (strings_equali(base_type, "u8")) {
+                } else if (kstring_view_equali(base_type, "u8")) {
                     uniform.type = SHADER_UNIFORM_TYPE_UINT8;
                     uniform.size = 1;
-                } else if (strings_equali(base_type, "u16")) {
+                } else if (kstring_view_equali(base_type, "u16")) {
                     uniform.type = SHADER_UNIFORM_TYPE_UINT16;
                     uniform.size = 2;
-                } else if (strings_equali(base_type, "u32")) {
+                } else if (kstring_view_equali(base_type, "u32")) {
                     uniform.type = SHADER_UNIFORM_TYPE_UINT32;
                     uniform.size = 4;
-                } else if (strings_equali(base_type, "i8")) {
+                } else if (kstring_view_equali(base_type, "i8")) {
                     uniform.type = SHADER_UNIFORM_TYPE_INT8;
                     uniform.size = 1;
-                } else if (strings_equali(base_type, "i16")) {
+                } else if (kstring_view_equali(base_type, "i16")) {
                     uniform.type = SHADER_UNIFORM_TYPE_INT16;
                     uniform.size = 2;
-                } else if (strings_equali(base_type, "i32")) {
+                } else if (kstring_view_equali(base_type, "i32")) {
                     uniform.type = SHADER_UNIFORM_TYPE_INT32;
                     uniform.size = 4;
-                } else if (strings_equali(base_type, "mat4")) {
+                } else if (kstring_view_equali(base_type, "mat4")) {
                     uniform.type = SHADER_UNIFORM_TYPE_MATRIX_4;
                     uniform.size = 64;
-                } else if (string_starts_with(fields[0], "samp")) {
+                } else if (kstring_view_equali(base_type, "storagebuffer")) {
+                    // Storage resources are bound rather than being part of a UBO, so have no size.
+                    uniform.type = SHADER_UNIFORM_TYPE_STORAGE_BUFFER;
+                    uniform.size = 0;
+                } else if (kstring_view_equali(base_type, "storageimage")) {
+                    uniform.type = SHADER_UNIFORM_TYPE_STORAGE_IMAGE;
+                    uniform.size = 0;
+                } else if (kstring_view_starts_withi(fields[0], "samp")) {
                     // Sampler uniforms are handled entirely different from other uniforms, but
                     // share a lot of logic among each other.
 
                     // No shorthand for new sampler types.
-                    if (strings_equali(base_type, "sampler1d")) {
+                    if (kstring_view_equali(base_type, "sampler1d")) {
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_1D;
-                    } else if (strings_equali(base_type, "sampler2d") || strings_equali(base_type, "samp") || strings_equali(base_type, "sampler")) {
+                    } else if (kstring_view_equali(base_type, "sampler2d") || kstring_view_equali(base_type, "samp") || kstring_view_equali(base_type, "sampler")) {
                         // NOTE: Auto-converting samp/sampler to sampler2D for backward compatability.
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_2D;
-                    } else if (strings_equali(base_type, "sampler3d")) {
+                    } else if (kstring_view_equali(base_type, "sampler3d")) {
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_3D;
-                    } else if (strings_equali(base_type, "samplercube")) {
+                    } else if (kstring_view_equali(base_type, "samplercube")) {
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_CUBE;
-                    } else if (strings_equali(base_type, "sampler1darray")) {
+                    } else if (kstring_view_equali(base_type, "sampler1darray")) {
                         // NOTE: array textures are different from _an array __of__ textures_
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_1D_ARRAY;
-                    } else if (strings_equali(base_type, "sampler2darray")) {
+                    } else if (kstring_view_equali(base_type, "sampler2darray")) {
                         // NOTE: array textures are different from _an array __of__ textures_
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_2D_ARRAY;
-                    } else if (strings_equali(base_type, "samplercubearray")) {
+                    } else if (kstring_view_equali(base_type, "samplercubearray")) {
                         // NOTE: array textures are different from _an array __of__ textures_
                         uniform.type = SHADER_UNIFORM_TYPE_SAMPLER_CUBE_ARRAY;
                     } else {
                         // List out the entire unparsed field to make the error more useful.
-                        KERROR("Error in shader file: Unsupported sampler type '%s' found. %s:%u", fields[0], full_file_path, line_number);
+                        KERROR("Error in shader file: Unsupported sampler type '%.*s' found. %s:%u", (i32)fields[0].length, fields[0].str, full_file_path, line_number);
                         return false;
                     }
 
-                } else if (strings_nequali(fields[0], "struct", 6)) {
-                    u32 len = string_length(fields[0]);
-                    if (len <= 6) {
+                } else if (kstring_view_starts_withi(fields[0], "struct")) {
+                    if (fields[0].length <= 6) {
                         KERROR("shader_loader_load: Invalid struct uniform, size is missing. Shader load aborted.");
                         return false;
                     }
-                    // u32 diff = len - 6;
-                    char struct_size_str[32] = {0};
-                    string_mid(struct_size_str, fields[0], 6, -1);
                     u32 struct_size = 0;
-                    if (!string_to_u32(struct_size_str, &struct_size)) {
+                    if (!kstring_view_to_u32(kstring_view_mid(fields[0], 6, -1), &struct_size)) {
                         KERROR("Unable to parse struct uniform size. Shader load aborted.");
                         return false;
                     }
@@ -366,18 +573,18 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
                     // uniform=struct40,1,p_light_0
                     // uniform=struct40,1,p_light_1
                 } else {
-                    KERROR("shader_loader_load: Invalid file layout. Uniform type must be f32, vec2, vec3, vec4, i8, i16, i32, u8, u16, u32 or mat4.");
+                    KERROR("shader_loader_load: Invalid file layout. Uniform type must be f32, vec2, vec3, vec4, i8, i16, i32, u8, u16, u32, mat4, storagebuffer or storageimage.");
                     KWARN("Defaulting to f32.");
                     uniform.type = SHADER_UNIFORM_TYPE_FLOAT32;
                     uniform.size = 4;
                 }
 
                 // Parse the scope
-                if (strings_equal(fields[1], "0")) {
+                if (kstring_view_equal(fields[1], "0")) {
                     uniform.scope = SHADER_SCOPE_GLOBAL;
-                } else if (strings_equal(fields[1], "1")) {
+                } else if (kstring_view_equal(fields[1], "1")) {
                     uniform.scope = SHADER_SCOPE_INSTANCE;
-                } else if (strings_equal(fields[1], "2")) {
+                } else if (kstring_view_equal(fields[1], "2")) {
                     uniform.scope = SHADER_SCOPE_LOCAL;
                 } else {
                     KERROR("shader_loader_load: Invalid file layout: Uniform scope must be 0 for global, 1 for instance or 2 for local.");
@@ -386,16 +593,14 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
                 }
 
                 // Take a copy of the attribute name.
-                uniform.name_length = string_length(fields[2]);
-                uniform.name = string_duplicate(fields[2]);
+                uniform.name_length = fields[2].length;
+                uniform.name = kstring_view_duplicate(fields[2]);
 
                 // Add the attribute.
                 darray_push(resource_data->uniforms, uniform);
                 resource_data->uniform_count++;
             }
 
-            string_cleanup_split_array(fields);
-            darray_destroy(fields);
         }
 
         // TODO: more fields.
@@ -406,39 +611,88 @@ static b8 shader_loader_load(struct resource_loader* self, const char* name, voi
     }
 
     filesystem_close(&f);
-
-    out_resource->data = resource_data;
-    out_resource->data_size = sizeof(shader_config);
-
     return true;
 }
 
-static void shader_loader_unload(struct resource_loader* self, resource* resource) {
-    shader_config* data = (shader_config*)resource->data;
+void shader_config_destroy(shader_config* config) {
+    if (!config) {
+        return;
+    }
 
-    if (data->stage_configs && data->stage_count > 0) {
-        kfree(data->stage_configs, sizeof(shader_stage_config) * data->stage_count, MEMORY_TAG_ARRAY);
-        data->stage_count = 0;
+    if (config->stage_configs && config->stage_count > 0) {
+        for (u32 i = 0; i < config->stage_count; ++i) {
+            if (config->stage_configs[i].precompiled && config->stage_configs[i].source) {
+                kfree(config->stage_configs[i].source, config->stage_configs[i].source_length, MEMORY_TAG_RESOURCE);
+            }
+        }
+        kfree(config->stage_configs, sizeof(shader_stage_config) * config->stage_count, MEMORY_TAG_ARRAY);
+        config->stage_count = 0;
     }
 
     // Clean up attributes.
-    u32 count = darray_length(data->attributes);
+    u32 count = darray_length(config->attributes);
     for (u32 i = 0; i < count; ++i) {
-        u32 len = string_length(data->attributes[i].name);
-        kfree(data->attributes[i].name, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
+        u32 len = string_length(config->attributes[i].name);
+        kfree(config->attributes[i].name, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
     }
-    darray_destroy(data->attributes);
+    darray_destroy(config->attributes);
 
     // Clean up uniforms.
-    count = darray_length(data->uniforms);
+    count = darray_length(config->uniforms);
     for (u32 i = 0; i < count; ++i) {
-        u32 len = string_length(data->uniforms[i].name);
-        kfree(data->uniforms[i].name, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
+        u32 len = string_length(config->uniforms[i].name);
+        kfree(config->uniforms[i].name, sizeof(char) * (len + 1), MEMORY_TAG_STRING);
     }
-    darray_destroy(data->uniforms);
+    darray_destroy(config->uniforms);
 
-    kfree(data->name, sizeof(char) * (string_length(data->name) + 1), MEMORY_TAG_STRING);
-    kzero_memory(data, sizeof(shader_config));
+    for (u32 i = 0; i < config->specialization_count; ++i) {
+        string_free(config->specializations[i].name);
+    }
+
+    if (config->name) {
+        kfree(config->name, sizeof(char) * (string_length(config->name) + 1), MEMORY_TAG_STRING);
+    }
+    kzero_memory(config, sizeof(shader_config));
+}
+
+static b8 shader_loader_load(struct resource_loader* self, const char* name, void* params, resource* out_resource) {
+    if (!self || !name || !out_resource) {
+        return false;
+    }
+
+    shader_config* resource_data = kallocate(sizeof(shader_config), MEMORY_TAG_RESOURCE);
+
+    // A bundle built by the tools is preferred, as it is read at once and its stages need no compiling.
+    char* format_str = "%s/%s/%s%s";
+    char full_file_path[512];
+    string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, ".ksbundle");
+    b8 loaded = false;
+    if (filesystem_exists(full_file_path)) {
+        shader_config_defaults_set(resource_data);
+        loaded = shader_bundle_load(full_file_path, resource_data);
+        if (!loaded) {
+            shader_config_destroy(resource_data);
+            KWARN("Unable to use shader bundle '%s'. Loading the shader config instead.", full_file_path);
+        }
+    }
+    if (!loaded) {
+        string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, ".shadercfg");
+        if (!shader_config_parse(full_file_path, resource_data)) {
+            shader_config_destroy(resource_data);
+            kfree(resource_data, sizeof(shader_config), MEMORY_TAG_RESOURCE);
+            return false;
+        }
+    }
+
+    out_resource->full_path = string_duplicate(full_file_path);
+    out_resource->data = resource_data;
+    out_resource->data_size = sizeof(shader_config);
+
+    return true;
+}
+
+static void shader_loader_unload(struct resource_loader* self, resource* resource) {
+    shader_config_destroy((shader_config*)resource->data);
 
     if (!resource_unload(self, resource, MEMORY_TAG_RESOURCE)) {
         KWARN("shader_loader_unload called with nullptr for self or resource.");
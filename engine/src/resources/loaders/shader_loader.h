@@ -1,7 +1,8 @@
 /**
  * @file shader_loader.h
  * @author Travis Vroman (travis@kohiengine.com)
- * @brief A resource loader that handles shader config resources.
+ * @brief A resource loader that handles shader config resources. A .ksbundle shader bundle built by
+ * the tools is loaded in place of the .shadercfg file when present.
  * @version 1.0
  * @date 2022-02-28
  * 
@@ -19,3 +20,20 @@
  * @return The newly created resource loader.
  */
 resource_loader shader_resource_loader_create(void);
+
+/**
+ * @brief Parses the .shadercfg file at the given path. Stage sources are not read.
+ * Used by the loader, and by the tools to build shader bundles.
+ *
+ * @param full_file_path The path of the file to be parsed.
+ * @param out_config A pointer to hold the config. Destroy it with shader_config_destroy.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_config_parse(const char* full_file_path, shader_config* out_config);
+
+/**
+ * @brief Releases everything held by the given shader config, including the code of precompiled stages.
+ *
+ * @param config A pointer to the config.
+ */
+KAPI void shader_config_destroy(shader_config* config);
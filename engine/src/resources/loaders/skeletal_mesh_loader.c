@@ -0,0 +1,299 @@
+#include "skeletal_mesh_loader.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "loader_utils.h"
+#include "platform/filesystem.h"
+#include "resources/resource_types.h"
+#include "resources/skeletal_mesh.h"
+#include "systems/geometry_system.h"
+#include "systems/resource_system.h"
+
+STATIC_ASSERT(sizeof(ksa_header) == 56, "ksa_header must be 56 bytes.");
+STATIC_ASSERT(sizeof(ksa_joint) == 112, "ksa_joint must be 112 bytes.");
+STATIC_ASSERT(sizeof(ksa_clip) == 32, "ksa_clip must be 32 bytes.");
+STATIC_ASSERT(sizeof(ksa_geometry) == 72, "ksa_geometry must be 72 bytes.");
+STATIC_ASSERT(sizeof(animation_key) == 20, "animation_key must be 20 bytes.");
+STATIC_ASSERT(sizeof(animation_range) == 48, "animation_range must be 48 bytes.");
+STATIC_ASSERT(sizeof(vertex_3d_skinned) == 40, "vertex_3d_skinned must be 40 bytes.");
+
+// The size of the headers at the start of every .ksa file.
+#define KSA_HEADERS_SIZE (sizeof(resource_header) + sizeof(ksa_header))
+
+// Indicates if the array of count elements of the given size at offset lies within a ksa file.
+static b8 ksa_array_valid(const file_mapping* mapping, u64 offset, u64 count, u64 element_size) {
+    return offset <= mapping->size && count * element_size <= mapping->size - offset;
+}
+
+// Obtains a copy of the string at offset in the string table, or 0 if it lies outside it.
+static char* ksa_string_get(const char* table, u32 table_size, u32 offset) {
+    if (offset >= table_size) {
+        return 0;
+    }
+    // The table ends with a terminator, so every string within it is terminated.
+    return string_duplicate(table + offset);
+}
+
+// Frees everything held by a mesh, but not the mesh itself.
+static void skeletal_mesh_contents_free(skeletal_mesh* mesh) {
+    skeleton* s = &mesh->skeleton;
+    if (s->joint_names) {
+        for (u32 i = 0; i < s->joint_count; ++i) {
+            if (s->joint_names[i]) {
+                string_free(s->joint_names[i]);
+            }
+        }
+        kfree(s->joint_names, sizeof(char*) * s->joint_count, MEMORY_TAG_RESOURCE);
+    }
+    if (s->parents) {
+        kfree(s->parents, sizeof(i16) * s->joint_count, MEMORY_TAG_RESOURCE);
+    }
+    if (s->rest_pose) {
+        kfree(s->rest_pose, sizeof(animation_pose), MEMORY_TAG_RESOURCE);
+    }
+    if (s->inverse_bind_matrices) {
+        kfree(s->inverse_bind_matrices, sizeof(mat4) * s->joint_count, MEMORY_TAG_RESOURCE);
+    }
+
+    if (mesh->clips) {
+        for (u32 i = 0; i < mesh->clip_count; ++i) {
+            animation_clip* clip = &mesh->clips[i];
+            if (clip->name) {
+                string_free(clip->name);
+            }
+            if (clip->ranges) {
+                kfree(clip->ranges, sizeof(animation_range) * s->joint_count, MEMORY_TAG_RESOURCE);
+            }
+            if (clip->keys) {
+                kfree(clip->keys, sizeof(animation_key) * s->joint_count * clip->frame_count, MEMORY_TAG_RESOURCE);
+            }
+        }
+        kfree(mesh->clips, sizeof(animation_clip) * mesh->clip_count, MEMORY_TAG_RESOURCE);
+    }
+
+    if (mesh->geometries) {
+        for (u32 i = 0; i < mesh->geometry_count; ++i) {
+            geometry_system_config_dispose(&mesh->geometries[i]);
+        }
+        kfree(mesh->geometries, sizeof(geometry_config) * mesh->geometry_count, MEMORY_TAG_RESOURCE);
+    }
+
+    if (mesh->name) {
+        string_free(mesh->name);
+    }
+    kzero_memory(mesh, sizeof(skeletal_mesh));
+}
+
+static b8 load_ksa_file(const char* path, const char* name, skeletal_mesh** out_mesh) {
+    file_mapping mapping = {};
+    if (!filesystem_map(path, 0, 0, &mapping)) {
+        KERROR("Unable to map ksa file '%s'.", path);
+        return false;
+    }
+
+    skeletal_mesh* mesh = kallocate(sizeof(skeletal_mesh), MEMORY_TAG_RESOURCE);
+    mesh->name = string_duplicate(name);
+
+    if (mapping.size < KSA_HEADERS_SIZE) {
+        KERROR("KSA file '%s' is too small to hold its headers.", path);
+        goto failed;
+    }
+    resource_header file_header;
+    kcopy_memory(&file_header, mapping.data, sizeof(resource_header));
+    if (file_header.magic_number != RESOURCE_MAGIC || file_header.resource_type != RESOURCE_TYPE_SKELETAL_MESH) {
+        KERROR("KSA file header of '%s' is invalid and cannot be read.", path);
+        goto failed;
+    }
+    if (file_header.version != KSA_VERSION) {
+        KERROR("KSA file '%s' is version %u, but only version %u is supported.", path, file_header.version, KSA_VERSION);
+        goto failed;
+    }
+
+    ksa_header header;
+    kcopy_memory(&header, mapping.data + sizeof(resource_header), sizeof(ksa_header));
+    if (!header.joint_count || header.joint_count > SKELETON_MAX_JOINTS) {
+        KERROR("KSA file '%s' has %u joints, but skeletons must have between 1 and %u.", path, header.joint_count, SKELETON_MAX_JOINTS);
+        goto failed;
+    }
+    if (header.file_size != mapping.size ||
+        !ksa_array_valid(&mapping, header.string_table_offset, header.string_table_size, 1) ||
+        !ksa_array_valid(&mapping, header.joints_offset, header.joint_count, sizeof(ksa_joint)) ||
+        !ksa_array_valid(&mapping, header.clips_offset, header.clip_count, sizeof(ksa_clip)) ||
+        !ksa_array_valid(&mapping, header.geometries_offset, header.geometry_count, sizeof(ksa_geometry))) {
+        KERROR("KSA file '%s' is truncated. Its data lies outside the file.", path);
+        goto failed;
+    }
+    const char* strings = (const char*)(mapping.data + header.string_table_offset);
+    u32 strings_size = header.string_table_size;
+    if (!strings_size || strings[strings_size - 1] != 0) {
+        KERROR("KSA file '%s' has an unterminated string table.", path);
+        goto failed;
+    }
+
+    // The skeleton.
+    skeleton* s = &mesh->skeleton;
+    s->joint_count = header.joint_count;
+    s->joint_names = kallocate(sizeof(char*) * s->joint_count, MEMORY_TAG_RESOURCE);
+    s->parents = kallocate(sizeof(i16) * s->joint_count, MEMORY_TAG_RESOURCE);
+    s->rest_pose = kallocate(sizeof(animation_pose), MEMORY_TAG_RESOURCE);
+    s->inverse_bind_matrices = kallocate(sizeof(mat4) * s->joint_count, MEMORY_TAG_RESOURCE);
+    for (u32 i = 0; i < s->joint_count; ++i) {
+        ksa_joint joint;
+        kcopy_memory(&joint, mapping.data + header.joints_offset + sizeof(ksa_joint) * i, sizeof(ksa_joint));
+        // Parents must come first, so poses can be evaluated in order.
+        if (joint.parent < -1 || joint.parent >= (i32)i) {
+            KERROR("KSA file '%s' has joint %u with an invalid parent of %i.", path, i, joint.parent);
+            goto failed;
+        }
+        s->joint_names[i] = ksa_string_get(strings, strings_size, joint.name);
+        s->parents[i] = (i16)joint.parent;
+        s->inverse_bind_matrices[i] = joint.inverse_bind_matrix;
+        for (u32 c = 0; c < 4; ++c) {
+            s->rest_pose->channels[ANIMATION_CHANNEL_ROTATION_X + c][i] = joint.rest_rotation.elements[c];
+        }
+        for (u32 c = 0; c < 3; ++c) {
+            s->rest_pose->channels[ANIMATION_CHANNEL_TRANSLATION_X + c][i] = joint.rest_translation.elements[c];
+            s->rest_pose->channels[ANIMATION_CHANNEL_SCALE_X + c][i] = joint.rest_scale.elements[c];
+        }
+    }
+
+    // The clips.
+    if (header.clip_count) {
+        // Zeroed, so that clips not yet read are skipped when freed on failure.
+        mesh->clips = kallocate(sizeof(animation_clip) * header.clip_count, MEMORY_TAG_RESOURCE);
+        mesh->clip_count = header.clip_count;
+    }
+    for (u32 i = 0; i < header.clip_count; ++i) {
+        ksa_clip entry;
+        kcopy_memory(&entry, mapping.data + header.clips_offset + sizeof(ksa_clip) * i, sizeof(ksa_clip));
+        if (!entry.frame_count || !(entry.sample_rate > 0.0f) || !(entry.duration >= 0.0f)) {
+            KERROR("KSA file '%s' has clip %u with an invalid length or sample rate.", path, i);
+            goto failed;
+        }
+        u64 key_count = (u64)entry.frame_count * s->joint_count;
+        if (!ksa_array_valid(&mapping, entry.ranges_offset, s->joint_count, sizeof(animation_range)) ||
+            !ksa_array_valid(&mapping, entry.keys_offset, key_count, sizeof(animation_key))) {
+            KERROR("KSA file '%s' is truncated. The data of clip %u lies outside the file.", path, i);
+            goto failed;
+        }
+
+        animation_clip* clip = &mesh->clips[i];
+        clip->name = ksa_string_get(strings, strings_size, entry.name);
+        clip->duration = entry.duration;
+        clip->sample_rate = entry.sample_rate;
+        clip->frame_count = entry.frame_count;
+        clip->ranges = kallocate(sizeof(animation_range) * s->joint_count, MEMORY_TAG_RESOURCE);
+        kcopy_memory(clip->ranges, mapping.data + entry.ranges_offset, sizeof(animation_range) * s->joint_count);
+        clip->keys = kallocate(sizeof(animation_key) * key_count, MEMORY_TAG_RESOURCE);
+        kcopy_memory(clip->keys, mapping.data + entry.keys_offset, sizeof(animation_key) * key_count);
+    }
+
+    // The geometries.
+    if (header.geometry_count) {
+        mesh->geometries = kallocate(sizeof(geometry_config) * header.geometry_count, MEMORY_TAG_RESOURCE);
+        mesh->geometry_count = header.geometry_count;
+    }
+    for (u32 i = 0; i < header.geometry_count; ++i) {
+        ksa_geometry entry;
+        kcopy_memory(&entry, mapping.data + header.geometries_offset + sizeof(ksa_geometry) * i, sizeof(ksa_geometry));
+        if (!ksa_array_valid(&mapping, entry.vertices_offset, entry.vertex_count, sizeof(vertex_3d_skinned)) ||
+            !ksa_array_valid(&mapping, entry.indices_offset, entry.index_count, sizeof(u32))) {
+            KERROR("KSA file '%s' is truncated. The data of geometry %u lies outside the file.", path, i);
+            goto failed;
+        }
+
+        geometry_config* g = &mesh->geometries[i];
+        g->vertex_size = sizeof(vertex_3d_skinned);
+        g->vertex_count = entry.vertex_count;
+        g->vertices = kallocate(sizeof(vertex_3d_skinned) * entry.vertex_count, MEMORY_TAG_ARRAY);
+        kcopy_memory(g->vertices, mapping.data + entry.vertices_offset, sizeof(vertex_3d_skinned) * entry.vertex_count);
+        g->index_size = sizeof(u32);
+        g->index_count = entry.index_count;
+        g->indices = kallocate(sizeof(u32) * entry.index_count, MEMORY_TAG_ARRAY);
+        kcopy_memory(g->indices, mapping.data + entry.indices_offset, sizeof(u32) * entry.index_count);
+        g->vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+        g->center = entry.center;
+        g->min_extents = entry.min_extents;
+        g->max_extents = entry.max_extents;
+        if (entry.name < strings_size) {
+            string_ncopy(g->name, strings + entry.name, GEOMETRY_NAME_MAX_LENGTH - 1);
+        }
+        if (entry.material_name < strings_size) {
+            string_ncopy(g->material_name, strings + entry.material_name, MATERIAL_NAME_MAX_LENGTH - 1);
+        }
+
+        // Vertices referring to joints the skeleton doesn't have would read the matrices of other meshes.
+        const vertex_3d_skinned* vertices = g->vertices;
+        for (u32 v = 0; v < g->vertex_count; ++v) {
+            for (u32 k = 0; k < 4; ++k) {
+                if (vertices[v].joints[k] >= s->joint_count) {
+                    KERROR("KSA file '%s' has vertex %u of geometry %u influenced by joint %u, which doesn't exist.", path, v, i, vertices[v].joints[k]);
+                    goto failed;
+                }
+            }
+        }
+        const u32* indices = g->indices;
+        for (u32 n = 0; n < g->index_count; ++n) {
+            if (indices[n] >= g->vertex_count) {
+                KERROR("KSA file '%s' has index %u of geometry %u outside its vertices.", path, n, i);
+                goto failed;
+            }
+        }
+    }
+
+    filesystem_unmap(&mapping);
+    *out_mesh = mesh;
+    return true;
+
+failed:
+    filesystem_unmap(&mapping);
+    skeletal_mesh_contents_free(mesh);
+    kfree(mesh, sizeof(skeletal_mesh), MEMORY_TAG_RESOURCE);
+    return false;
+}
+
+static b8 skeletal_mesh_loader_load(struct resource_loader* self, const char* name,
+                                    void* params, resource* out_resource) {
+    if (!self || !name || !out_resource) {
+        return false;
+    }
+
+    char* format_str = "%s/%s/%s%s";
+    char full_file_path[512];
+    string_format(full_file_path, format_str, resource_system_base_path(),
+                  self->type_path, name, ".ksa");
+
+    skeletal_mesh* mesh = 0;
+    if (!load_ksa_file(full_file_path, name, &mesh)) {
+        KERROR("Failed to load skeletal mesh file '%s'.", full_file_path);
+        return false;
+    }
+
+    out_resource->full_path = string_duplicate(full_file_path);
+    out_resource->data = mesh;
+    out_resource->data_size = sizeof(skeletal_mesh);
+
+    return true;
+}
+
+static void skeletal_mesh_loader_unload(struct resource_loader* self, resource* resource) {
+    if (resource && resource->data) {
+        skeletal_mesh_contents_free(resource->data);
+    }
+
+    if (!resource_unload(self, resource, MEMORY_TAG_RESOURCE)) {
+        KWARN("skeletal_mesh_loader_unload called with nullptr for self or resource.");
+    }
+}
+
+resource_loader skeletal_mesh_resource_loader_create(void) {
+    resource_loader loader;
+    loader.type = RESOURCE_TYPE_SKELETAL_MESH;
+    loader.custom_type = 0;
+    loader.load = skeletal_mesh_loader_load;
+    loader.unload = skeletal_mesh_loader_unload;
+    loader.type_path = "models";
+
+    return loader;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file skeletal_mesh_loader.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A resource loader that handles skeletal mesh (.ksa) resources.
+ * @version 1.0
+ * @date 2023-12-08
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "systems/resource_system.h"
+
+/**
+ * @brief Creates and returns a skeletal mesh resource loader.
+ *
+ * @return The newly created resource loader.
+ */
+resource_loader skeletal_mesh_resource_loader_create(void);
@@ -24,7 +24,7 @@ typedef struct supported_system_font_filetype {
 } supported_system_font_filetype;
 
 static b8 import_fontconfig_file(file_handle* f, const char* type_path, const char* out_ksf_filename, system_font_resource_data* out_resource);
-static b8 read_ksf_file(file_handle* file, system_font_resource_data* data);
+static b8 read_ksf_file(const char* path, system_font_resource_data* data);
 static b8 write_ksf_file(const char* out_ksf_filename, system_font_resource_data* resource);
 
 static b8 system_font_loader_load(struct resource_loader* self, const char* name, void* params, resource* out_resource) {
@@ -78,7 +78,7 @@ static b8 system_font_loader_load(struct resource_loader* self, const char* name
             break;
         }
         case SYSTEM_FONT_FILE_TYPE_KSF:
-            result = read_ksf_file(&f, &resource_data);
+            result = read_ksf_file(full_file_path, &resource_data);
             break;
         case SYSTEM_FONT_FILE_TYPE_NOT_FOUND:
             KERROR("Unable to find system font of supported type called '%s'.", name);
@@ -103,9 +103,8 @@ static b8 system_font_loader_load(struct resource_loader* self, const char* name
 }
 
 static b8 import_fontconfig_file(file_handle* f, const char* type_path, const char* out_ksf_filename, system_font_resource_data* out_resource) {
+    kzero_memory(out_resource, sizeof(system_font_resource_data));
     out_resource->fonts = darray_create(system_font_face);
-    out_resource->binary_size = 0;
-    out_resource->font_binary = 0;
 
     // Read each line of the file.
     char line_buf[512] = "";
@@ -154,30 +153,20 @@ static b8 import_fontconfig_file(file_handle* f, const char* type_path, const ch
             char full_file_path[512];
             string_format(full_file_path, format_str, resource_system_base_path(), type_path, trimmed_value);
 
-            // Open and read the font file as binary, and save into an allocated
-            // buffer on the resource itself.
-            file_handle font_binary_handle;
-            if (!filesystem_open(full_file_path, FILE_MODE_READ, true, &font_binary_handle)) {
-                KERROR("Unable to open binary font file. Load process failed.");
-                return false;
-            }
-            u64 file_size;
-            if (!filesystem_size(&font_binary_handle, &file_size)) {
-                KERROR("Unable to get file size of binary font file. Load process failed.");
-                return false;
+            // Map the font file rather than reading it, as collections may be many megabytes, of
+            // which only the tables of the faces and glyphs used are ever touched.
+            if (out_resource->mapping.data) {
+                KWARN("Font configuration provides more than one binary. Only the last is used.");
+                filesystem_unmap(&out_resource->mapping);
             }
-            out_resource->font_binary = kallocate(file_size, MEMORY_TAG_RESOURCE);
-            if (!filesystem_read_all_bytes(&font_binary_handle, out_resource->font_binary, &out_resource->binary_size)) {
-                KERROR("Unable to perform binary read on font file. Load process failed.");
+            if (!filesystem_map(full_file_path, 0, 0, &out_resource->mapping)) {
+                KERROR("Unable to map binary font file. Load process failed.");
+                darray_destroy(out_resource->fonts);
+                out_resource->fonts = 0;
                 return false;
             }
-
-            // Might still work anyway, so continue.
-            if (out_resource->binary_size != file_size) {
-                KWARN("Mismatch between filesize and bytes read in font file. File may be corrupt.");
-            }
-
-            filesystem_close(&font_binary_handle);
+            out_resource->font_binary = (void*)out_resource->mapping.data;
+            out_resource->binary_size = out_resource->mapping.size;
         } else if (strings_equali(trimmed_var_name, "face")) {
             // Read in the font face and store it for later.
             system_font_face new_face;
@@ -195,58 +184,87 @@ static b8 import_fontconfig_file(file_handle* f, const char* type_path, const ch
     // Check here to make sure a binary was loaded, and at least one font face was found.
     if (!out_resource->font_binary || darray_length(out_resource->fonts) < 1) {
         KERROR("Font configuration did not provide a binary and at least one font face. Load process failed.");
+        filesystem_unmap(&out_resource->mapping);
+        darray_destroy(out_resource->fonts);
+        out_resource->fonts = 0;
         return false;
     }
 
     return write_ksf_file(out_ksf_filename, out_resource);
 }
 
-static b8 read_ksf_file(file_handle* file, system_font_resource_data* data) {
+// Reads the given number of bytes at the cursor of the mapped ksf file, advancing it.
+static b8 ksf_read(const file_mapping* mapping, u64* cursor, u64 size, void* out_data) {
+    if (size > mapping->size - *cursor) {
+        return false;
+    }
+    kcopy_memory(out_data, mapping->data + *cursor, size);
+    *cursor += size;
+    return true;
+}
+
+static b8 read_ksf_file(const char* path, system_font_resource_data* data) {
     kzero_memory(data, sizeof(system_font_resource_data));
 
-    u64 bytes_read = 0;
-    u32 read_size = 0;
+    // The whole file is mapped, and the font binary used in place within it.
+    if (!filesystem_map(path, 0, 0, &data->mapping)) {
+        KERROR("Unable to map KSF file '%s'.", path);
+        return false;
+    }
 
-    // Write the resource header first.
+    u64 cursor = 0;
     resource_header header;
-    read_size = sizeof(resource_header);
-    CLOSE_IF_FAILED(filesystem_read(file, read_size, &header, &bytes_read), file);
+    if (!ksf_read(&data->mapping, &cursor, sizeof(resource_header), &header)) {
+        goto ksf_invalid;
+    }
 
     // Verify header contents.
-    if (header.magic_number != RESOURCE_MAGIC && header.resource_type == RESOURCE_TYPE_SYSTEM_FONT) {
+    if (header.magic_number != RESOURCE_MAGIC || header.resource_type != RESOURCE_TYPE_SYSTEM_FONT) {
         KERROR("KSF file header is invalid and cannot be read.");
-        filesystem_close(file);
+        filesystem_unmap(&data->mapping);
         return false;
     }
 
     // TODO: read in/process file version.
 
-    // Size of font binary.
-    read_size = sizeof(u64);
-    CLOSE_IF_FAILED(filesystem_read(file, read_size, &data->binary_size, &bytes_read), file);
-
-    // The font binary itself
-    read_size = data->binary_size;
-    CLOSE_IF_FAILED(filesystem_read(file, read_size, &data->font_binary, &bytes_read), file);
+    // Size of font binary, followed by the binary itself.
+    if (!ksf_read(&data->mapping, &cursor, sizeof(u64), &data->binary_size) || data->binary_size > data->mapping.size - cursor) {
+        goto ksf_invalid;
+    }
+    data->font_binary = (void*)(data->mapping.data + cursor);
+    cursor += data->binary_size;
 
     // The number of fonts
-    u32 font_count = darray_length(data->fonts);
-    read_size = sizeof(u32);
-    CLOSE_IF_FAILED(filesystem_read(file, read_size, &font_count, &bytes_read), file);
+    u32 font_count = 0;
+    if (!ksf_read(&data->mapping, &cursor, sizeof(u32), &font_count)) {
+        goto ksf_invalid;
+    }
 
-    // Iterate faces metadata and output that as well.
+    // Iterate faces metadata.
+    data->fonts = darray_reserve(system_font_face, font_count ? font_count : 1);
     for (u32 i = 0; i < font_count; ++i) {
-        // Length of face name string.
-        u32 face_length = string_length(data->fonts[i].name);
-        read_size = sizeof(u32);
-        CLOSE_IF_FAILED(filesystem_read(file, read_size, &face_length, &bytes_read), file);
-
-        // Face string.
-        read_size = sizeof(char) * face_length + 1;
-        CLOSE_IF_FAILED(filesystem_read(file, read_size, data->fonts[i].name, &bytes_read), file);
+        // Length of face name string, followed by the string and its terminator.
+        u32 face_length = 0;
+        if (!ksf_read(&data->mapping, &cursor, sizeof(u32), &face_length) || face_length >= sizeof(((system_font_face*)0)->name)) {
+            goto ksf_invalid;
+        }
+        system_font_face face = {0};
+        if (!ksf_read(&data->mapping, &cursor, sizeof(char) * face_length + 1, face.name)) {
+            goto ksf_invalid;
+        }
+        darray_push(data->fonts, face);
     }
 
     return true;
+
+ksf_invalid:
+    KERROR("KSF file '%s' is truncated or corrupt and cannot be read.", path);
+    if (data->fonts) {
+        darray_destroy(data->fonts);
+    }
+    filesystem_unmap(&data->mapping);
+    kzero_memory(data, sizeof(system_font_resource_data));
+    return false;
 }
 
 static b8 write_ksf_file(const char* out_ksf_filename, system_font_resource_data* resource) {
@@ -262,11 +280,10 @@ static void system_font_loader_unload(struct resource_loader* self, resource* re
             data->fonts = 0;
         }
 
-        if (data->font_binary) {
-            kfree(data->font_binary, data->binary_size, MEMORY_TAG_RESOURCE);
-            data->font_binary = 0;
-            data->binary_size = 0;
-        }
+        // The binary is within the mapping.
+        filesystem_unmap(&data->mapping);
+        data->font_binary = 0;
+        data->binary_size = 0;
     }
 }
 
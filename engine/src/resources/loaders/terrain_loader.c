@@ -109,6 +109,10 @@ static b8 terrain_loader_load(struct resource_loader *self, const char *name,
             if (!string_to_f32(trimmed_value, &resource_data->tile_scale_z)) {
                 KWARN("Format error: failed to parse scale_z");
             }
+        } else if (strings_equali(trimmed_var_name, "vertex_pulling")) {
+            if (!string_to_bool(trimmed_value, &resource_data->vertex_pulling)) {
+                KWARN("Format error: failed to parse vertex_pulling");
+            }
         } else if (strings_equali(trimmed_var_name, "heightmap_file")) {
             heightmap_file = string_duplicate(trimmed_value);
         } else if (strings_nequali(trimmed_var_name, "material", 8)) {
@@ -4,135 +4,111 @@
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "math/kmath.h"
 #include "math/math_types.h"
 #include "renderer/renderer_types.h"
 #include "systems/geometry_system.h"
-#include "systems/job_system.h"
 #include "systems/resource_system.h"
-
-// Also used as result_data from job.
-typedef struct mesh_load_params {
-    const char* resource_name;
-    mesh* out_mesh;
-    resource mesh_resource;
-} mesh_load_params;
+#include "systems/texture_system.h"
+
+/** @brief The geometry of a loaded mesh which is still to be uploaded. See mesh_upload. */
+typedef struct mesh_pending_upload {
+    /** @brief The load of the mesh resource, which holds it until the upload is done. */
+    resource_request request;
+    const resource* mesh_resource;
+    /** @brief The index of the next geometry config to be uploaded. */
+    u32 next_geometry;
+    /**
+     * @brief For a reload, the new geometries, swapped in once all are uploaded. Otherwise 0, and
+     * geometries are uploaded straight into the mesh.
+     */
+    geometry** geometries;
+    /** @brief The number of geometries loaded. */
+    u16 geometry_count;
+    /** @brief The combined extents of the geometries loaded. */
+    extents_3d extents;
+} mesh_pending_upload;
+
+static void mesh_pending_upload_destroy(mesh_pending_upload* pending) {
+    if (pending->geometries) {
+        for (u32 i = 0; i < pending->next_geometry; ++i) {
+            if (pending->geometries[i]) {
+                geometry_system_release(pending->geometries[i]);
+            }
+        }
+        kfree(pending->geometries, sizeof(geometry*) * pending->geometry_count, MEMORY_TAG_ARRAY);
+    }
+    resource_request_release(pending->request);
+    kfree(pending, sizeof(mesh_pending_upload), MEMORY_TAG_RESOURCE);
+}
 
 /**
- * @brief Called when the job completes successfully.
+ * @brief Called once the mesh resource has loaded, or failed to.
  *
- * @param params The parameters passed from the job after completion.
+ * @param request The load of the mesh resource.
+ * @param mesh_resource The loaded mesh resource, or 0 on failure.
+ * @param m A pointer to the mesh being loaded.
+ * @param is_reload Indicates the mesh already has geometry, which is kept until the new geometry is uploaded.
  */
-static void mesh_load_job_success(void* params) {
-    mesh_load_params* mesh_params = (mesh_load_params*)params;
-
-    // This also handles the GPU upload. Can't be jobified until the renderer is multithreaded.
-    geometry_config* configs = (geometry_config*)mesh_params->mesh_resource.data;
-    mesh_params->out_mesh->geometry_count = mesh_params->mesh_resource.data_size;
-    mesh_params->out_mesh->geometries = kallocate(sizeof(geometry*) * mesh_params->out_mesh->geometry_count, MEMORY_TAG_ARRAY);
-    for (u32 i = 0; i < mesh_params->out_mesh->geometry_count; ++i) {
-        mesh_params->out_mesh->geometries[i] = geometry_system_acquire_from_config(configs[i], true);
-
-        // Calculate the geometry extents.
-        extents_3d* local_extents = &mesh_params->out_mesh->geometries[i]->extents;
-        vertex_3d* verts = configs[i].vertices;
-        for (u32 v = 0; v < configs[i].vertex_count; ++v) {
-            // Min
-            if (verts[v].position.x < local_extents->min.x) {
-                local_extents->min.x = verts[v].position.x;
-            }
-            if (verts[v].position.y < local_extents->min.y) {
-                local_extents->min.y = verts[v].position.y;
-            }
-            if (verts[v].position.z < local_extents->min.z) {
-                local_extents->min.z = verts[v].position.z;
-            }
-
-            // Max
-            if (verts[v].position.x > local_extents->max.x) {
-                local_extents->max.x = verts[v].position.x;
-            }
-            if (verts[v].position.y > local_extents->max.y) {
-                local_extents->max.y = verts[v].position.y;
-            }
-            if (verts[v].position.z > local_extents->max.z) {
-                local_extents->max.z = verts[v].position.z;
-            }
-        }
+static void mesh_on_loaded(resource_request request, const resource* mesh_resource, mesh* m, b8 is_reload) {
+    if (!mesh_resource) {
+        KERROR("Failed to load mesh '%s'.", m->config.resource_name);
+        resource_request_release(request);
+        return;
+    }
 
-        // Calculate overall extents for the mesh by getting the extents for each sub-mesh.
-        extents_3d* global_extents = &mesh_params->out_mesh->extents;
+    // NOTE: The GPU upload is left to mesh_upload, so it can be spread over as many frames as needed.
+    const geometry_config* configs = (const geometry_config*)mesh_resource->data;
+    mesh_pending_upload* pending = kallocate(sizeof(mesh_pending_upload), MEMORY_TAG_RESOURCE);
+    pending->request = request;
+    pending->mesh_resource = mesh_resource;
+    pending->next_geometry = 0;
+    pending->geometry_count = mesh_resource->data_size;
+
+    // The extents are known from the configs, so are available before any geometry is uploaded.
+    pending->extents = is_reload ? (extents_3d){0} : m->extents;
+    for (u32 i = 0; i < pending->geometry_count; ++i) {
+        pending->extents.min = vec3_min(pending->extents.min, configs[i].min_extents);
+        pending->extents.max = vec3_max(pending->extents.max, configs[i].max_extents);
+    }
 
-        // Min
-        if (local_extents->min.x < global_extents->min.x) {
-            global_extents->min.x = local_extents->min.x;
-        }
-        if (local_extents->min.y < global_extents->min.y) {
-            global_extents->min.y = local_extents->min.y;
-        }
-        if (local_extents->min.z < global_extents->min.z) {
-            global_extents->min.z = local_extents->min.z;
+    if (is_reload) {
+        // A reload finishing before an earlier one was uploaded replaces it.
+        if (m->pending_upload) {
+            mesh_pending_upload_destroy(m->pending_upload);
         }
+        pending->geometries = kallocate(sizeof(geometry*) * pending->geometry_count, MEMORY_TAG_ARRAY);
+    } else {
+        m->geometry_count = pending->geometry_count;
+        m->geometries = kallocate(sizeof(geometry*) * m->geometry_count, MEMORY_TAG_ARRAY);
+        m->extents = pending->extents;
 
-        // Max
-        if (local_extents->max.x > global_extents->max.x) {
-            global_extents->max.x = local_extents->max.x;
-        }
-        if (local_extents->max.y > global_extents->max.y) {
-            global_extents->max.y = local_extents->max.y;
-        }
-        if (local_extents->max.z > global_extents->max.z) {
-            global_extents->max.z = local_extents->max.z;
+        // Watch the file, so the mesh can be reloaded when it changes.
+        if (resource_system_hot_reload_enabled() && m->watch_id == INVALID_ID) {
+            resource_system_watch(mesh_resource->full_path, &m->watch_id);
         }
     }
-    mesh_params->out_mesh->generation++;
-
-    KTRACE("Successfully loaded mesh '%s'.", mesh_params->resource_name);
+    m->pending_upload = pending;
 
-    resource_system_unload(&mesh_params->mesh_resource);
+    KTRACE("Successfully loaded mesh '%s', pending upload.", m->config.resource_name);
 }
 
-/**
- * @brief Called when the job fails.
- *
- * @param params Parameters passed when a job fails.
- */
-static void mesh_load_job_fail(void* params) {
-    mesh_load_params* mesh_params = (mesh_load_params*)params;
-
-    KERROR("Failed to load mesh '%s'.", mesh_params->resource_name);
-
-    resource_system_unload(&mesh_params->mesh_resource);
+static void mesh_on_first_load(resource_request request, const resource* mesh_resource, void* listener) {
+    mesh_on_loaded(request, mesh_resource, listener, false);
 }
 
-/**
- * @brief Called when a mesh loading job begins.
- *
- * @param params Mesh loading parameters.
- * @param result_data Result data passed to the completion callback.
- * @return True on job success; otherwise false.
- */
-static b8 mesh_load_job_start(void* params, void* result_data) {
-    mesh_load_params* load_params = (mesh_load_params*)params;
-    b8 result = resource_system_load(load_params->resource_name, RESOURCE_TYPE_MESH, 0, &load_params->mesh_resource);
-
-    // NOTE: The load params are also used as the result data here, only the mesh_resource field is populated now.
-    kcopy_memory(result_data, load_params, sizeof(mesh_load_params));
-
-    return result;
+static void mesh_on_reload(resource_request request, const resource* mesh_resource, void* listener) {
+    mesh_on_loaded(request, mesh_resource, listener, true);
 }
 
-static b8 mesh_load_from_resource(const char* resource_name, mesh* out_mesh) {
-    out_mesh->generation = INVALID_ID_U8;
-
-    mesh_load_params params;
-    params.resource_name = resource_name;
-    params.out_mesh = out_mesh;
-    params.mesh_resource = (resource){};
-
-    job_info job = job_create(mesh_load_job_start, mesh_load_job_success, mesh_load_job_fail, &params, sizeof(mesh_load_params), sizeof(mesh_load_params));
-    job_system_submit(job);
+static b8 mesh_load_from_resource(const char* resource_name, mesh* out_mesh, b8 is_reload) {
+    if (!is_reload) {
+        out_mesh->generation = INVALID_ID_U8;
+    }
 
-    return true;
+    // Meshes are mapped from their baked files, so loading mostly waits on the disk.
+    resource_request request = resource_system_load_async(resource_name, RESOURCE_TYPE_MESH, 0, 0, is_reload ? mesh_on_reload : mesh_on_first_load, out_mesh);
+    return request.generation != 0;
 }
 
 b8 mesh_create(mesh_config config, mesh* out_mesh) {
@@ -144,6 +120,7 @@ b8 mesh_create(mesh_config config, mesh* out_mesh) {
 
     out_mesh->config = config;
     out_mesh->generation = INVALID_ID_U8;
+    out_mesh->watch_id = INVALID_ID;
     if (config.name) {
         out_mesh->name = string_duplicate(config.name);
     }
@@ -177,8 +154,18 @@ b8 mesh_load(mesh* m) {
 
     m->id = identifier_create();
 
+    if (m->config.impostor_name) {
+        char normal_name[TEXTURE_NAME_MAX_LENGTH];
+        string_format(normal_name, "%s_normal", m->config.impostor_name);
+        m->impostor_albedo = texture_system_acquire(m->config.impostor_name, true);
+        m->impostor_normal = texture_system_acquire(normal_name, true);
+        if (!m->impostor_albedo || !m->impostor_normal) {
+            KWARN("Failed to acquire the impostor atlases '%s' of mesh '%s'. It will always be drawn in full.", m->config.impostor_name, m->name ? m->name : "");
+        }
+    }
+
     if (m->config.resource_name) {
-        return mesh_load_from_resource(m->config.resource_name, m);
+        return mesh_load_from_resource(m->config.resource_name, m, false);
     } else {
         if (!m->config.g_configs) {
             return false;
@@ -197,17 +184,105 @@ b8 mesh_load(mesh* m) {
     return true;
 }
 
+u64 mesh_upload(mesh* m, u64 budget) {
+    if (!m || !m->pending_upload) {
+        return 0;
+    }
+
+    mesh_pending_upload* pending = m->pending_upload;
+    const geometry_config* configs = (const geometry_config*)pending->mesh_resource->data;
+    geometry** geometries = pending->geometries ? pending->geometries : m->geometries;
+    u64 uploaded = 0;
+    while (pending->next_geometry < pending->geometry_count) {
+        const geometry_config* config = &configs[pending->next_geometry];
+        u64 size = (u64)config->vertex_size * config->vertex_count + (u64)config->index_size * config->index_count;
+        // Always upload at least one geometry, so that one larger than the budget still gets there.
+        if (uploaded && uploaded + size > budget) {
+            break;
+        }
+
+        geometries[pending->next_geometry] = geometry_system_acquire_from_config(*config, true);
+        if (!geometries[pending->next_geometry]) {
+            KERROR("Failed to upload geometry '%s' of mesh '%s'.", config->name, m->config.resource_name);
+        }
+        pending->next_geometry++;
+        uploaded += size;
+    }
+
+    if (pending->next_geometry == pending->geometry_count) {
+        if (pending->geometries) {
+            // Swap in the reloaded geometry, and release the old.
+            for (u32 i = 0; i < m->geometry_count; ++i) {
+                if (m->geometries[i]) {
+                    geometry_system_release(m->geometries[i]);
+                }
+            }
+            kfree(m->geometries, sizeof(geometry*) * m->geometry_count, MEMORY_TAG_ARRAY);
+            m->geometries = pending->geometries;
+            m->geometry_count = pending->geometry_count;
+            m->extents = pending->extents;
+            pending->geometries = 0;
+        }
+        mesh_pending_upload_destroy(pending);
+        m->pending_upload = 0;
+
+        // All geometry is on the GPU, so the mesh can now be rendered.
+        m->generation++;
+        if (m->generation == INVALID_ID_U8) {
+            m->generation = 0;
+        }
+        KTRACE("Successfully uploaded mesh '%s'.", m->config.resource_name);
+    }
+
+    return uploaded;
+}
+
+b8 mesh_upload_pending(const mesh* m) {
+    return m && m->pending_upload;
+}
+
+b8 mesh_reload(mesh* m) {
+    if (!m || !m->config.resource_name) {
+        return false;
+    }
+
+    // Not yet loaded, and the load in progress reads the file anyway.
+    if (m->generation == INVALID_ID_U8) {
+        return true;
+    }
+
+    return mesh_load_from_resource(m->config.resource_name, m, true);
+}
+
 b8 mesh_unload(mesh* m) {
     if (m) {
+        if (m->watch_id != INVALID_ID) {
+            resource_system_unwatch(m->watch_id);
+        }
+
         for (u32 i = 0; i < m->geometry_count; ++i) {
-            geometry_system_release(m->geometries[i]);
+            if (m->geometries[i]) {
+                geometry_system_release(m->geometries[i]);
+            }
+        }
+
+        if (m->pending_upload) {
+            mesh_pending_upload_destroy(m->pending_upload);
         }
 
         kfree(m->geometries, sizeof(geometry*) * m->geometry_count, MEMORY_TAG_ARRAY);
+
+        if (m->impostor_albedo) {
+            texture_system_release(m->impostor_albedo->name);
+        }
+        if (m->impostor_normal) {
+            texture_system_release(m->impostor_normal->name);
+        }
         kzero_memory(m, sizeof(mesh));
 
         // For good measure, invalidate the geometry so it doesn't attempt to be rendered.
         m->generation = INVALID_ID_U8;
+        m->watch_id = INVALID_ID;
 
         return true;
     }
@@ -219,7 +294,7 @@ b8 mesh_destroy(mesh* m) {
         return false;
     }
 
-    if (m->geometries) {
+    if (m->geometries || m->pending_upload) {
         if (!mesh_unload(m)) {
             KERROR("mesh_destroy - failed to unload mesh.");
             return false;
@@ -243,6 +318,10 @@ b8 mesh_destroy(mesh* m) {
         kfree(m->config.parent_name, string_length(m->config.parent_name) + 1, MEMORY_TAG_STRING);
         m->config.parent_name = 0;
     }
+    if (m->config.impostor_name) {
+        kfree(m->config.impostor_name, string_length(m->config.impostor_name) + 1, MEMORY_TAG_STRING);
+        m->config.impostor_name = 0;
+    }
 
     return true;
 }
@@ -8,8 +8,44 @@ KAPI b8 mesh_create(mesh_config config, mesh* out_mesh);
 
 KAPI b8 mesh_initialize(mesh* m);
 
+/**
+ * @brief Loads the given mesh. For a mesh loaded from a resource, this happens in the background,
+ * after which its geometry must be uploaded by mesh_upload before it can be rendered.
+ *
+ * @param m A pointer to the mesh.
+ * @return True on success; otherwise false.
+ */
 KAPI b8 mesh_load(mesh* m);
 
+/**
+ * @brief Uploads the geometry of a loaded mesh, a few geometries at a time so that the cost can be
+ * spread over several frames. The mesh becomes renderable once all of its geometries are uploaded.
+ *
+ * @param m A pointer to the mesh.
+ * @param budget The number of bytes of vertex and index data which may be uploaded. At least one
+ * geometry is always uploaded if any are pending, even if it is larger than this.
+ * @return The number of bytes uploaded. 0 if nothing was pending.
+ */
+KAPI u64 mesh_upload(mesh* m, u64 budget);
+
+/**
+ * @brief Indicates if the given mesh has been loaded, but still has geometry waiting for mesh_upload.
+ *
+ * @param m A constant pointer to the mesh.
+ * @return True if geometry is waiting to be uploaded; otherwise false.
+ */
+KAPI b8 mesh_upload_pending(const mesh* m);
+
+/**
+ * @brief Loads the geometry of a mesh loaded from a resource again, such as after its file has changed.
+ * The mesh keeps rendering its current geometry until the new geometry has all been uploaded by
+ * mesh_upload, at which point it is swapped in.
+ *
+ * @param m A pointer to the mesh.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 mesh_reload(mesh* m);
+
 KAPI b8 mesh_unload(mesh* m);
 
 KAPI b8 mesh_destroy(mesh* m);
@@ -0,0 +1,265 @@
+#include "particle_emitter.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "systems/job_system.h"
+#include "utils/ksort.h"
+
+// The number of particles simulated by each job.
+#define PARTICLE_SIMULATE_BATCH_SIZE 4096
+
+// The number of emitters created, which seeds each one differently.
+static u32 emitter_seed_counter = 0;
+
+// NOTE: The hash and everything derived from it below is mirrored by the particle compute
+// shader (Shader.ParticleSimulate), and must be changed in both places.
+static u32 particle_hash(u32 value) {
+    u32 state = value * 747796405u + 2891336453u;
+    u32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Obtains the nth random value in [0, 1) of the particle with the given hash.
+static f32 particle_random(u32 particle_seed, u32 n) {
+    return (f32)(particle_hash(particle_seed + n) >> 8) * (1.0f / 16777216.0f);
+}
+
+static f32 particle_mix(f32 a, f32 b, f32 t) {
+    return a + (b - a) * t;
+}
+
+b8 particle_emitter_create(const particle_emitter_config* config, vec3 position, particle_emitter* out_emitter) {
+    if (!config || !out_emitter) {
+        KERROR("particle_emitter_create requires valid pointers to a config and out_emitter.");
+        return false;
+    }
+
+    kzero_memory(out_emitter, sizeof(particle_emitter));
+    out_emitter->config = *config;
+    out_emitter->config.name = config->name ? string_duplicate(config->name) : 0;
+    out_emitter->position = position;
+
+    // Round the capacity up to a power of two, so the ring wraps with a mask and sorts evenly.
+    u32 requested = KCLAMP(config->max_particles, PARTICLE_EMITTER_MIN_PARTICLES, PARTICLE_EMITTER_MAX_PARTICLES);
+    u32 capacity = PARTICLE_EMITTER_MIN_PARTICLES;
+    while (capacity < requested) {
+        capacity <<= 1;
+    }
+    if (capacity != config->max_particles) {
+        KTRACE("Particle emitter '%s' holds %u particles (%u requested).", config->name ? config->name : "", capacity, config->max_particles);
+    }
+    out_emitter->capacity = capacity;
+    out_emitter->config.max_particles = capacity;
+
+    if (vec3_length(out_emitter->config.direction) < K_FLOAT_EPSILON) {
+        out_emitter->config.direction = vec3_up();
+    }
+    out_emitter->config.direction = vec3_normalized(out_emitter->config.direction);
+    out_emitter->config.lifetime_max = KMAX(out_emitter->config.lifetime_min, out_emitter->config.lifetime_max);
+    out_emitter->config.speed_max = KMAX(out_emitter->config.speed_min, out_emitter->config.speed_max);
+
+    out_emitter->seed = particle_hash(++emitter_seed_counter);
+    return true;
+}
+
+void particle_emitter_destroy(particle_emitter* emitter) {
+    if (!emitter) {
+        return;
+    }
+
+    if (emitter->config.name) {
+        string_free(emitter->config.name);
+    }
+    if (emitter->cpu_allocated) {
+        u64 array_size = sizeof(f32) * emitter->capacity;
+        // All arrays are allocated as a single block, starting at position_x.
+        kfree(emitter->cpu.position_x, array_size * 12, MEMORY_TAG_ARRAY);
+    }
+    kzero_memory(emitter, sizeof(particle_emitter));
+}
+
+void particle_emitter_update(particle_emitter* emitter, f32 delta_time) {
+    if (!emitter || !emitter->capacity) {
+        return;
+    }
+
+    emitter->delta_time = KMAX(delta_time, 0.0f);
+    emitter->frame_index++;
+
+    emitter->spawn_accumulator += emitter->config.spawn_rate * emitter->delta_time;
+    f32 whole = kfloor(emitter->spawn_accumulator);
+    emitter->spawn_accumulator -= whole;
+    // More than a full ring would respawn slots twice, so the excess is dropped.
+    u32 spawn_count = whole >= (f32)emitter->capacity ? emitter->capacity : (u32)whole;
+
+    emitter->spawn_first = emitter->spawn_cursor;
+    emitter->spawn_count = spawn_count;
+    emitter->spawn_cursor = (emitter->spawn_cursor + spawn_count) & (emitter->capacity - 1);
+}
+
+u32 particle_emitter_frame_seed(const particle_emitter* emitter) {
+    return particle_hash(emitter->seed + emitter->frame_index * 0x9E3779B9u);
+}
+
+// The values shared by every particle simulated in a frame.
+typedef struct particle_simulate_params {
+    particle_emitter* emitter;
+    u32 frame_seed;
+    f32 spread_cos;
+    // The axes perpendicular to the emission direction.
+    vec3 tangent;
+    vec3 bitangent;
+} particle_simulate_params;
+
+static void particle_spawn(const particle_simulate_params* params, u32 index) {
+    const particle_emitter_config* config = &params->emitter->config;
+    particle_emitter_cpu_state* cpu = &params->emitter->cpu;
+    u32 particle_seed = particle_hash(index ^ params->frame_seed);
+
+    cpu->age[index] = 0.0f;
+    cpu->lifetime[index] = particle_mix(config->lifetime_min, config->lifetime_max, particle_random(particle_seed, 0));
+
+    // Within a cone about the emission direction.
+    f32 speed = particle_mix(config->speed_min, config->speed_max, particle_random(particle_seed, 1));
+    f32 cos_theta = particle_mix(params->spread_cos, 1.0f, particle_random(particle_seed, 2));
+    f32 sin_theta = ksqrt(KMAX(0.0f, 1.0f - cos_theta * cos_theta));
+    f32 phi = K_2PI * particle_random(particle_seed, 3);
+    f32 t = kcos(phi) * sin_theta;
+    f32 b = ksin(phi) * sin_theta;
+    cpu->velocity_x[index] = (params->tangent.x * t + params->bitangent.x * b + config->direction.x * cos_theta) * speed;
+    cpu->velocity_y[index] = (params->tangent.y * t + params->bitangent.y * b + config->direction.y * cos_theta) * speed;
+    cpu->velocity_z[index] = (params->tangent.z * t + params->bitangent.z * b + config->direction.z * cos_theta) * speed;
+
+    // Within a sphere about the emitter.
+    f32 z = particle_random(particle_seed, 4) * 2.0f - 1.0f;
+    f32 ring = ksqrt(KMAX(0.0f, 1.0f - z * z));
+    f32 angle = K_2PI * particle_random(particle_seed, 5);
+    f32 radius = config->spawn_radius * kpow(particle_random(particle_seed, 6), 1.0f / 3.0f);
+    cpu->position_x[index] = params->emitter->position.x + kcos(angle) * ring * radius;
+    cpu->position_y[index] = params->emitter->position.y + ksin(angle) * ring * radius;
+    cpu->position_z[index] = params->emitter->position.z + z * radius;
+}
+
+static void particle_simulate_range(u32 start, u32 end, void* user_data) {
+    const particle_simulate_params* params = user_data;
+    particle_emitter* emitter = params->emitter;
+    particle_emitter_cpu_state* cpu = &emitter->cpu;
+    u32 mask = emitter->capacity - 1;
+    f32 dt = emitter->delta_time;
+    vec3 gravity = emitter->config.gravity;
+    f32 damping = KMAX(0.0f, 1.0f - emitter->config.drag * dt);
+
+    for (u32 i = start; i < end; ++i) {
+        if (((i - emitter->spawn_first) & mask) < emitter->spawn_count) {
+            particle_spawn(params, i);
+            continue;
+        }
+        if (cpu->age[i] >= cpu->lifetime[i]) {
+            continue;
+        }
+        cpu->velocity_x[i] = (cpu->velocity_x[i] + gravity.x * dt) * damping;
+        cpu->velocity_y[i] = (cpu->velocity_y[i] + gravity.y * dt) * damping;
+        cpu->velocity_z[i] = (cpu->velocity_z[i] + gravity.z * dt) * damping;
+        cpu->position_x[i] += cpu->velocity_x[i] * dt;
+        cpu->position_y[i] += cpu->velocity_y[i] * dt;
+        cpu->position_z[i] += cpu->velocity_z[i] * dt;
+        cpu->age[i] += dt;
+    }
+}
+
+b8 particle_emitter_simulate_cpu(particle_emitter* emitter) {
+    if (!emitter || !emitter->capacity) {
+        return false;
+    }
+
+    if (!emitter->cpu_allocated) {
+        // A single zeroed block holds every array, so all particles start out dead.
+        u32 capacity = emitter->capacity;
+        f32* block = kallocate(sizeof(f32) * capacity * 12, MEMORY_TAG_ARRAY);
+        particle_emitter_cpu_state* cpu = &emitter->cpu;
+        cpu->position_x = block;
+        cpu->position_y = block + capacity;
+        cpu->position_z = block + capacity * 2;
+        cpu->velocity_x = block + capacity * 3;
+        cpu->velocity_y = block + capacity * 4;
+        cpu->velocity_z = block + capacity * 5;
+        cpu->age = block + capacity * 6;
+        cpu->lifetime = block + capacity * 7;
+        cpu->sort_keys = (u32*)(block + capacity * 8);
+        cpu->sort_values = (u32*)(block + capacity * 9);
+        cpu->sort_scratch_keys = (u32*)(block + capacity * 10);
+        cpu->sort_scratch_values = (u32*)(block + capacity * 11);
+        emitter->cpu_allocated = true;
+    }
+
+    particle_simulate_params params = {0};
+    params.emitter = emitter;
+    params.frame_seed = particle_emitter_frame_seed(emitter);
+    params.spread_cos = kcos(KCLAMP(emitter->config.spread, 0.0f, K_PI));
+    vec3 direction = emitter->config.direction;
+    vec3 up = kabs(direction.y) < 0.999f ? vec3_up() : vec3_right();
+    params.tangent = vec3_normalized(vec3_cross(up, direction));
+    params.bitangent = vec3_cross(direction, params.tangent);
+
+    job_parallel_for(emitter->capacity, PARTICLE_SIMULATE_BATCH_SIZE, particle_simulate_range, &params);
+    return true;
+}
+
+static void particle_instance_make(const particle_emitter* emitter, u32 index, particle_instance* out_instance) {
+    const particle_emitter_cpu_state* cpu = &emitter->cpu;
+    const particle_emitter_config* config = &emitter->config;
+    f32 t = cpu->lifetime[index] > 0.0f ? cpu->age[index] / cpu->lifetime[index] : 1.0f;
+    out_instance->position_size = (vec4){cpu->position_x[index], cpu->position_y[index], cpu->position_z[index], particle_mix(config->size_start, config->size_end, t)};
+    out_instance->colour = (vec4){
+        particle_mix(config->colour_start.r, config->colour_end.r, t),
+        particle_mix(config->colour_start.g, config->colour_end.g, t),
+        particle_mix(config->colour_start.b, config->colour_end.b, t),
+        particle_mix(config->colour_start.a, config->colour_end.a, t)};
+}
+
+u32 particle_emitter_instances_write(particle_emitter* emitter, vec3 view_position, u32 max_instances, particle_instance* out_instances) {
+    if (!emitter || !emitter->cpu_allocated || !out_instances) {
+        return 0;
+    }
+
+    particle_emitter_cpu_state* cpu = &emitter->cpu;
+    u32 count = 0;
+    if (emitter->config.blend == PARTICLE_BLEND_MODE_ADDITIVE) {
+        // Order doesn't matter when adding, so live particles are written as found.
+        for (u32 i = 0; i < emitter->capacity && count < max_instances; ++i) {
+            if (cpu->age[i] < cpu->lifetime[i]) {
+                particle_instance_make(emitter, i, &out_instances[count]);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // Sort live particles by distance, farthest first. Squared distances are non-negative, so
+    // their bits order as they do, and inverting them sorts farthest first.
+    u32 live_count = 0;
+    for (u32 i = 0; i < emitter->capacity; ++i) {
+        if (cpu->age[i] < cpu->lifetime[i]) {
+            f32 dx = cpu->position_x[i] - view_position.x;
+            f32 dy = cpu->position_y[i] - view_position.y;
+            f32 dz = cpu->position_z[i] - view_position.z;
+            f32 distance_squared = dx * dx + dy * dy + dz * dz;
+            u32 bits;
+            kcopy_memory(&bits, &distance_squared, sizeof(u32));
+            cpu->sort_keys[live_count] = ~bits;
+            cpu->sort_values[live_count] = i;
+            live_count++;
+        }
+    }
+    kradix_sort_u32(live_count, cpu->sort_keys, cpu->sort_values, cpu->sort_scratch_keys, cpu->sort_scratch_values);
+
+    // Should there be too many, the nearest are kept.
+    u32 first = live_count > max_instances ? live_count - max_instances : 0;
+    for (u32 i = first; i < live_count; ++i) {
+        particle_instance_make(emitter, cpu->sort_values[i], &out_instances[count]);
+        count++;
+    }
+    return count;
+}
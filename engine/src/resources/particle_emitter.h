@@ -0,0 +1,190 @@
+/**
+ * @file particle_emitter.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains particle emitters, which spawn particles at a steady rate and
+ * simulate them under gravity and drag until they expire.
+ * @details Particles are kept in a ring of a fixed power-of-two capacity. Each frame,
+ * particle_emitter_update works out which slots of the ring are respawned, after which the
+ * particles are simulated, either on the GPU by a compute shader or on the CPU by
+ * particle_emitter_simulate_cpu. Both derive the random values of a particle from the same
+ * hash of its slot and the frame, so they behave alike. Spawned particles replace the oldest
+ * ones, so the capacity should be at least the spawn rate times the longest lifetime.
+ * @version 1.0
+ * @date 2023-12-07
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+/** @brief The fewest particles an emitter holds. Also the granularity of its capacity. */
+#define PARTICLE_EMITTER_MIN_PARTICLES 64
+/** @brief The most particles a single emitter may hold. */
+#define PARTICLE_EMITTER_MAX_PARTICLES (1 << 18)
+
+/** @brief How the particles of an emitter are blended into the target. */
+typedef enum particle_blend_mode {
+    /** @brief Blended over the target by alpha, drawn back to front. */
+    PARTICLE_BLEND_MODE_ALPHA,
+    /** @brief Added to the target scaled by alpha, in any order. */
+    PARTICLE_BLEND_MODE_ADDITIVE
+} particle_blend_mode;
+
+/** @brief The configuration of a particle emitter, typically loaded from a .kpe file. */
+typedef struct particle_emitter_config {
+    /** @brief The name of the emitter. */
+    char* name;
+    /** @brief The number of particles held. Rounded up to a power of two, no less than PARTICLE_EMITTER_MIN_PARTICLES. */
+    u32 max_particles;
+    /** @brief The number of particles spawned per second. */
+    f32 spawn_rate;
+    /** @brief The radius of the sphere about the emitter particles are spawned within. */
+    f32 spawn_radius;
+    /** @brief The shortest lifetime of a particle, in seconds. */
+    f32 lifetime_min;
+    /** @brief The longest lifetime of a particle, in seconds. */
+    f32 lifetime_max;
+    /** @brief The slowest initial speed of a particle. */
+    f32 speed_min;
+    /** @brief The fastest initial speed of a particle. */
+    f32 speed_max;
+    /** @brief The direction particles are emitted in. Normalized. */
+    vec3 direction;
+    /** @brief The half-angle, in radians, of the cone about direction particles are emitted within. */
+    f32 spread;
+    /** @brief The acceleration applied to every particle. */
+    vec3 gravity;
+    /** @brief The fraction of its velocity a particle loses per second. */
+    f32 drag;
+    /** @brief The size of a particle when spawned. */
+    f32 size_start;
+    /** @brief The size of a particle when it expires. */
+    f32 size_end;
+    /** @brief The colour of a particle when spawned. */
+    vec4 colour_start;
+    /** @brief The colour of a particle when it expires. */
+    vec4 colour_end;
+    /** @brief How particles are blended. */
+    particle_blend_mode blend;
+} particle_emitter_config;
+
+/** @brief The per-instance data a particle is drawn with. Layout-compatible with the particle shaders. */
+typedef struct particle_instance {
+    /** @brief The world position of the particle in xyz, and its size in w. */
+    vec4 position_size;
+    /** @brief The colour of the particle. */
+    vec4 colour;
+} particle_instance;
+
+/**
+ * @brief The particles of an emitter simulated on the CPU, as a structure of arrays. Only
+ * allocated once the emitter is first simulated on the CPU.
+ */
+typedef struct particle_emitter_cpu_state {
+    f32* position_x;
+    f32* position_y;
+    f32* position_z;
+    f32* velocity_x;
+    f32* velocity_y;
+    f32* velocity_z;
+    /** @brief The time since each particle was spawned. A particle is dead once this reaches its lifetime. */
+    f32* age;
+    f32* lifetime;
+    /** @brief Scratch space for sorting particles back to front. */
+    u32* sort_keys;
+    u32* sort_values;
+    u32* sort_scratch_keys;
+    u32* sort_scratch_values;
+} particle_emitter_cpu_state;
+
+/**
+ * @brief A particle emitter. Members of this structure should not be modified outside the
+ * functions associated with it, except for position.
+ */
+typedef struct particle_emitter {
+    /** @brief The configuration of the emitter. Owns its name. */
+    particle_emitter_config config;
+    /** @brief The world position particles are spawned about. */
+    vec3 position;
+    /** @brief The number of particles held. Always a power of two. */
+    u32 capacity;
+    /** @brief A seed unique to this emitter, mixed into the random values of its particles. */
+    u32 seed;
+    /** @brief The number of updates made, mixed into the random values of spawned particles. */
+    u32 frame_index;
+    /** @brief The time step of the latest update, in seconds. */
+    f32 delta_time;
+    /** @brief The first slot respawned by the latest update. */
+    u32 spawn_first;
+    /** @brief The number of slots respawned by the latest update, wrapping around the ring. */
+    u32 spawn_count;
+    /** @brief The slot the next spawned particle goes into. */
+    u32 spawn_cursor;
+    /** @brief The fraction of a particle left over to be spawned by the next update. */
+    f32 spawn_accumulator;
+    /** @brief The CPU copy of the particles, if ever simulated on the CPU. */
+    particle_emitter_cpu_state cpu;
+    /** @brief Indicates if the CPU copy of the particles has been allocated. */
+    b8 cpu_allocated;
+} particle_emitter;
+
+/**
+ * @brief Creates a particle emitter from the given configuration, with no particles alive.
+ *
+ * @param config A constant pointer to the configuration. Copied, including its name.
+ * @param position The world position of the emitter.
+ * @param out_emitter A pointer to hold the emitter.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 particle_emitter_create(const particle_emitter_config* config, vec3 position, particle_emitter* out_emitter);
+
+/**
+ * @brief Destroys the given particle emitter.
+ *
+ * @param emitter A pointer to the emitter.
+ */
+KAPI void particle_emitter_destroy(particle_emitter* emitter);
+
+/**
+ * @brief Advances the emitter by the given time step, working out which slots are respawned
+ * this frame (see spawn_first and spawn_count). Should be called once per frame, before the
+ * particles are simulated.
+ *
+ * @param emitter A pointer to the emitter.
+ * @param delta_time The time step in seconds.
+ */
+KAPI void particle_emitter_update(particle_emitter* emitter, f32 delta_time);
+
+/**
+ * @brief Simulates the particles of the emitter on the CPU over the time step of the latest
+ * update, respawning those slots chosen by it. Runs in parallel on the job threads.
+ *
+ * @param emitter A pointer to the emitter.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 particle_emitter_simulate_cpu(particle_emitter* emitter);
+
+/**
+ * @brief Writes the instance data of the live particles simulated on the CPU. Particles of
+ * alpha-blended emitters are written back to front as seen from the given position.
+ *
+ * @param emitter A pointer to the emitter. Must have been simulated on the CPU.
+ * @param view_position The position particles are sorted by their distance from.
+ * @param max_instances The most instances which may be written.
+ * @param out_instances An array of at least max_instances instances to write into.
+ * @return The number of instances written.
+ */
+KAPI u32 particle_emitter_instances_write(particle_emitter* emitter, vec3 view_position, u32 max_instances, particle_instance* out_instances);
+
+/**
+ * @brief Obtains the seed of the random values of the particles spawned by the latest update.
+ * The particle compute shader combines it with each slot exactly as the CPU simulation does.
+ *
+ * @param emitter A constant pointer to the emitter.
+ * @return The seed.
+ */
+KAPI u32 particle_emitter_frame_seed(const particle_emitter* emitter);
@@ -13,6 +13,7 @@
 
 #include "core/identifier.h"
 #include "math/math_types.h"
+#include "platform/filesystem.h"
 
 #define TERRAIN_MAX_MATERIAL_COUNT 4
 
@@ -40,6 +41,10 @@ typedef enum resource_type {
     RESOURCE_TYPE_TERRAIN,
     /** @brief Audio resource type. */
     RESOURCE_TYPE_AUDIO,
+    /** @brief Particle emitter resource type (a particle_emitter_config). */
+    RESOURCE_TYPE_PARTICLE_EMITTER,
+    /** @brief Skeletal mesh resource type (a skeletal_mesh). */
+    RESOURCE_TYPE_SKELETAL_MESH,
     /** @brief Custom resource type. Used by loaders outside the core engine. */
     RESOURCE_TYPE_CUSTOM
 } resource_type;
@@ -78,6 +83,67 @@ typedef struct resource {
     void *data;
 } resource;
 
+/**
+ * @brief The formats texture data can be stored in. Block-compressed formats
+ * encode 4x4 blocks of texels and can only be loaded from .kbt files.
+ */
+typedef enum texture_format {
+    /** @brief Uncompressed, 8 bits per channel RGBA. */
+    TEXTURE_FORMAT_RGBA8 = 0,
+    /** @brief BC1 (DXT1). Opaque RGB, 8 bytes per block. */
+    TEXTURE_FORMAT_BC1 = 1,
+    /** @brief BC3 (DXT5). RGBA, 16 bytes per block. */
+    TEXTURE_FORMAT_BC3 = 2,
+    /** @brief BC5. Two channels, 16 bytes per block. Suited to normal maps. */
+    TEXTURE_FORMAT_BC5 = 3,
+    /** @brief BC7. High quality RGBA, 16 bytes per block. */
+    TEXTURE_FORMAT_BC7 = 4,
+    /** @brief ETC2 RGBA, 16 bytes per block. Common on mobile hardware. */
+    TEXTURE_FORMAT_ETC2_RGBA8 = 5,
+    /** @brief ASTC with 4x4 blocks, 16 bytes per block. Common on mobile hardware. */
+    TEXTURE_FORMAT_ASTC_4X4 = 6,
+    /** @brief Uncompressed, 16 bit float per channel RGBA. Render targets only; never loaded from files. */
+    TEXTURE_FORMAT_RGBA16F = 7,
+    /** @brief Uncompressed, a single 16 bit float channel. Render targets only; never loaded from files. */
+    TEXTURE_FORMAT_R16F = 8,
+    TEXTURE_FORMAT_COUNT
+} texture_format;
+
+/** @brief The current version of the .kbt file format. */
+#define KBT_FILE_VERSION 1
+
+/** @brief Flags stored in the header of .kbt files. */
+typedef enum kbt_flag {
+    /** @brief Indicates at least one texel of the image is not fully opaque. */
+    KBT_FLAG_HAS_TRANSPARENCY = 0x1,
+    /** @brief Indicates the image was flipped on the y-axis when baked. */
+    KBT_FLAG_FLIPPED_Y = 0x2
+} kbt_flag;
+
+/**
+ * @brief The header of a .kbt (Kohi binary texture) file, which follows the
+ * resource_header. It is followed by data_size bytes of texture data, holding
+ * every mip level in order from largest to smallest, each tightly packed.
+ */
+typedef struct kbt_header {
+    /** @brief The width of the base mip level. */
+    u32 width;
+    /** @brief The height of the base mip level. */
+    u32 height;
+    /** @brief The number of mip levels stored. Always at least 1. */
+    u32 mip_levels;
+    /** @brief The format of the data. Maps to the enum texture_format. */
+    u8 format;
+    /** @brief The number of meaningful channels in the source image. */
+    u8 channel_count;
+    /** @brief Flags for the image. Maps to the enum kbt_flag. */
+    u8 flags;
+    /** @brief Reserved for future header data. */
+    u8 reserved;
+    /** @brief The size of the data following this header, in bytes. */
+    u64 data_size;
+} kbt_header;
+
 /**
  * @brief A structure to hold image resource data.
  */
@@ -96,6 +162,22 @@ typedef struct image_resource_data {
      * Must always be at least 1.
      */
     u32 mip_levels;
+    /** @brief The format of the pixel data. */
+    texture_format format;
+    /** @brief The size of the pixel data in bytes, including any precomputed mip levels. */
+    u64 pixels_size;
+    /**
+     * @brief Indicates the pixel data was loaded from a .kbt file, and so holds
+     * every mip level rather than just the base level.
+     */
+    b8 precomputed_mips;
+    /** @brief Indicates at least one texel of the image is not fully opaque. */
+    b8 has_transparency;
+    /**
+     * @brief If not 0, the pixel data points into this read-only mapping of the
+     * .kbt file, which is unmapped when the resource is unloaded.
+     */
+    struct file_mapping *mapping;
 } image_resource_data;
 
 /** @brief Parameters used when loading an image. */
@@ -103,6 +185,20 @@ typedef struct image_resource_params {
     /** @brief Indicates if the image should be flipped on the y-axis when loaded.
      */
     b8 flip_y;
+    /**
+     * @brief Indicates if block-compressed .kbt files may be loaded. If false, these
+     * are skipped in favour of the source image. Uncompressed .kbt files are always
+     * allowed, and the base level of those can be used like that of any other image.
+     */
+    b8 allow_compressed;
+    /**
+     * @brief Optional contents of the source image file, already read into memory, for instance
+     * by filesystem_read_async. If set, these are decoded instead of reading the file. Ownership
+     * stays with the caller. Ignored if a baked .kbt file is loaded instead.
+     */
+    const u8* source_data;
+    /** @brief The size of source_data in bytes. */
+    u64 source_data_size;
 } image_resource_params;
 
 /** @brief Determines face culling mode during rendering. */
@@ -144,11 +240,31 @@ typedef enum texture_flag {
        creation. */
     TEXTURE_FLAG_IS_WRAPPED = 0x4,
     /** @brief Indicates the texture is a depth texture. */
-    TEXTURE_FLAG_DEPTH = 0x8
+    TEXTURE_FLAG_DEPTH = 0x8,
+    /**
+     * @brief Indicates the writeable texture can be bound as a storage image. Such textures are
+     * kept in a general layout and are meant to be produced by compute shaders, not uploaded.
+     */
+    TEXTURE_FLAG_IS_STORAGE = 0x10,
+    /** @brief Indicates the data the texture is created with includes every mip level, so none are generated. */
+    TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS = 0x20,
+    /**
+     * @brief Indicates the writeable texture is an attachment whose contents never leave the renderpass
+     * rendering to it: it is cleared or not loaded, not stored, and never sampled, copied or read back.
+     * On tiled GPUs it may then live in tile memory alone, without any backing memory.
+     */
+    TEXTURE_FLAG_MEMORYLESS = 0x40,
+    /**
+     * @brief Indicates the texture holds sRGB-encoded colour, such as albedo. Generated mip levels are
+     * averaged in linear space, so they don't darken. The texture is still sampled as stored.
+     */
+    TEXTURE_FLAG_IS_SRGB = 0x80,
+    /** @brief Indicates the texture holds tangent-space normals. Generated mip levels are renormalized. */
+    TEXTURE_FLAG_IS_NORMAL_MAP = 0x100
 } texture_flag;
 
 /** @brief Holds bit flags for textures.. */
-typedef u8 texture_flag_bits;
+typedef u16 texture_flag_bits;
 
 /**
  * @brief Represents various types of textures.
@@ -192,6 +308,8 @@ typedef struct texture {
     void *internal_data;
     /** @brief The number of mip maps the internal texture has. Must always be at least 1. */
     u32 mip_levels;
+    /** @brief The format of the texture data. */
+    texture_format format;
 } texture;
 
 /** @brief Represents supported texture filtering modes. */
@@ -238,6 +356,11 @@ typedef struct texture_map {
     texture_repeat repeat_v;
     /** @brief The repeat mode on the W axis (or Z, or U) */
     texture_repeat repeat_w;
+    /**
+     * @brief Indicates the map samples a depth texture with comparison (e.g. sampler2DArrayShadow),
+     * returning the filtered fraction of texels a reference depth is less than or equal to.
+     */
+    b8 compare_depth;
     /** @brief An identifier used for internal resource lookups/management. */
     u32 internal_id;
 } texture_map;
@@ -261,7 +384,9 @@ typedef struct font_kerning {
 } font_kerning;
 
 typedef enum font_type { FONT_TYPE_BITMAP,
-                         FONT_TYPE_SYSTEM } font_type;
+                         FONT_TYPE_SYSTEM,
+                         /** @brief A system font drawn from a signed distance field atlas, shared by all sizes of the font. */
+                         FONT_TYPE_SYSTEM_SDF } font_type;
 
 typedef struct font_data {
     font_type type;
@@ -277,6 +402,15 @@ typedef struct font_data {
     u32 kerning_count;
     font_kerning *kernings;
     f32 tab_x_advance;
+    /** @brief Scales glyph sizes, offsets, advances and kernings into the size of the font. Only
+     * differs from 1 for SDF fonts, whose glyphs are stored at the size of their shared atlas. */
+    f32 glyph_scale;
+    /** @brief Changes whenever glyphs already in the atlas move, such as when it grows. Text laid
+     * out with an earlier generation must be laid out again. Adding glyphs does not change it. */
+    u32 atlas_generation;
+    /** @brief Lookups of the glyphs and kernings by codepoint, built by the font system the first
+     * time they are needed, and again whenever glyphs or kernings are added. */
+    struct font_lookup *lookup;
     u32 internal_data_size;
     void *internal_data;
 } font_data;
@@ -300,7 +434,10 @@ typedef struct system_font_resource_data {
     // darray
     system_font_face *fonts;
     u64 binary_size;
+    // Points into mapping, so pages of the binary are only loaded once used.
     void *font_binary;
+    // The mapping of the file holding the binary.
+    file_mapping mapping;
 } system_font_resource_data;
 
 /** @brief The maximum length of a material name. */
@@ -311,6 +448,62 @@ struct material;
 /** @brief The maximum length of a geometry name. */
 #define GEOMETRY_NAME_MAX_LENGTH 256
 
+/** @brief The maximum number of levels of detail of a geometry, including the full-detail level. */
+#define GEOMETRY_MAX_LOD_COUNT 4
+
+/**
+ * @brief A single level of detail of a geometry. Every level shares the vertices of the
+ * geometry, and draws a range of its indices.
+ */
+typedef struct geometry_lod {
+    /** @brief The index of the first index of this level, within those of the geometry. */
+    u32 index_offset;
+    /** @brief The number of indices of this level. */
+    u32 index_count;
+    /** @brief The geometric error of this level relative to the full-detail level, in local units. */
+    f32 error;
+} geometry_lod;
+
+/** @brief The most vertices used by a single cluster of a geometry. */
+#define GEOMETRY_CLUSTER_MAX_VERTICES 64
+/** @brief The most triangles of a single cluster of a geometry. */
+#define GEOMETRY_CLUSTER_MAX_TRIANGLES 124
+
+/**
+ * @brief A small run of nearby triangles of a geometry's full-detail level, with bounds of its own
+ * so it can be culled apart from the rest of the geometry. Laid out as stored in ksm files.
+ */
+typedef struct geometry_cluster {
+    /** @brief The index of the first index of this cluster, within those of the geometry. */
+    u32 index_offset;
+    /** @brief The number of indices of this cluster. */
+    u32 index_count;
+    /** @brief The center of the cluster's bounding sphere, in local coordinates. */
+    vec3 center;
+    /** @brief The radius of the cluster's bounding sphere. */
+    f32 radius;
+    /** @brief The average direction the cluster's triangles face. */
+    vec3 cone_axis;
+    /**
+     * @brief The sine of the largest angle between the axis and any triangle's facing. The cluster faces
+     * wholly away from a point p if dot(center - p, cone_axis) >= cone_cutoff * |center - p| + radius.
+     * 1 if the triangles face too many ways for this to ever hold.
+     */
+    f32 cone_cutoff;
+} geometry_cluster;
+
+/** @brief The layouts in which the vertices of 3D geometry may be stored. */
+typedef enum geometry_vertex_format {
+    /** @brief Vertices are stored as given, i.e. as vertex_3d for most 3D geometry. */
+    GEOMETRY_VERTEX_FORMAT_STANDARD = 0,
+    /**
+     * @brief Vertices are stored as vertex_3d_packed, with positions relative to the geometry's
+     * quantization box. Drawn by shaders with a packed vertex layout.
+     */
+    GEOMETRY_VERTEX_FORMAT_PACKED = 1,
+    GEOMETRY_VERTEX_FORMAT_COUNT
+} geometry_vertex_format;
+
 /**
  * @brief Represents actual geometry in the world.
  * Typically (but not always, depending on use) paired with a material.
@@ -334,6 +527,12 @@ typedef struct geometry {
     void *vertices;
     /** @brief The offset from the beginning of the vertex buffer. */
     u64 vertex_buffer_offset;
+    /** @brief The layout of the vertex data. */
+    geometry_vertex_format vertex_format;
+    /** @brief For packed vertices, the center of the box their positions are stored relative to. */
+    vec3 quantization_center;
+    /** @brief For packed vertices, half the size of that box along each axis. */
+    f32 quantization_scale;
 
     /** @brief The index count. */
     u32 index_count;
@@ -344,6 +543,15 @@ typedef struct geometry {
     /** @brief The offset from the beginning of the index buffer. */
     u64 index_buffer_offset;
 
+    /** @brief The number of levels of detail. If 0, the geometry has only the one, drawn with all of its indices. */
+    u8 lod_count;
+    /** @brief The levels of detail, from full detail to least. */
+    geometry_lod lods[GEOMETRY_MAX_LOD_COUNT];
+    /** @brief The number of clusters the full-detail level is split into. If 0, it is culled as a whole. */
+    u32 cluster_count;
+    /** @brief The clusters of the full-detail level, in the order of its indices. */
+    geometry_cluster *clusters;
+
     /** @brief The geometry name. */
     char name[GEOMETRY_NAME_MAX_LENGTH];
     /** @brief A pointer to the material associated with this geometry.. */
@@ -357,6 +565,15 @@ typedef struct mesh_config {
     char *resource_name;
     u16 geometry_count;
     struct geometry_config *g_configs;
+    /**
+     * @brief The name of the octahedral impostor atlas baked for the mesh by the tools, if any. Its
+     * normals are in the texture of the same name suffixed by "_normal".
+     */
+    char *impostor_name;
+    /** @brief The number of frames along each side of the impostor atlas. */
+    u32 impostor_frame_count;
+    /** @brief The distance from the LOD view beyond which the impostor is drawn in place of the mesh. */
+    f32 impostor_distance;
 } mesh_config;
 
 typedef struct mesh {
@@ -370,6 +587,13 @@ typedef struct mesh {
     transform transform;
     extents_3d extents;
     void *debug_data;
+    // Geometry loaded but not yet uploaded, if any. See mesh_upload.
+    void *pending_upload;
+    // The resource system's watch of the mesh file for hot reloading, or INVALID_ID. See mesh_reload.
+    u32 watch_id;
+    // The albedo and normal atlases of the impostor, if the config names one.
+    struct texture *impostor_albedo;
+    struct texture *impostor_normal;
 } mesh;
 
 /** @brief Shader stages available in the system. */
@@ -386,6 +610,11 @@ typedef struct shader_stage_config {
     const char *filename;
     u32 source_length;
     char *source;
+    /**
+     * @brief Indicates the source holds SPIR-V compiled ahead of time by the tools, loaded from a
+     * .ksbundle shader bundle, rather than GLSL text to be compiled by the backend.
+     */
+    b8 precompiled;
 } shader_stage_config;
 
 /** @brief Available attribute types. */
@@ -401,6 +630,16 @@ typedef enum shader_attribute_type {
     SHADER_ATTRIB_TYPE_UINT16 = 8U,
     SHADER_ATTRIB_TYPE_INT32 = 9U,
     SHADER_ATTRIB_TYPE_UINT32 = 10U,
+    /** @brief Four signed 8-bit integers, read by shaders as floats in [-1, 1]. */
+    SHADER_ATTRIB_TYPE_SNORM8_4 = 11U,
+    /** @brief Four signed 16-bit integers, read by shaders as floats in [-1, 1]. */
+    SHADER_ATTRIB_TYPE_SNORM16_4 = 12U,
+    /** @brief Four unsigned 8-bit integers, read by shaders as floats in [0, 1]. */
+    SHADER_ATTRIB_TYPE_UNORM8_4 = 13U,
+    /** @brief Two 16-bit (half precision) floats. */
+    SHADER_ATTRIB_TYPE_FLOAT16_2 = 14U,
+    /** @brief Four unsigned 8-bit integers, read by shaders as a uvec4. */
+    SHADER_ATTRIB_TYPE_UINT8_4 = 15U,
 } shader_attribute_type;
 
 /** @brief Available uniform types. */
@@ -423,6 +662,10 @@ typedef enum shader_uniform_type {
     SHADER_UNIFORM_TYPE_SAMPLER_1D_ARRAY = 15U,
     SHADER_UNIFORM_TYPE_SAMPLER_2D_ARRAY = 16U,
     SHADER_UNIFORM_TYPE_SAMPLER_CUBE_ARRAY = 17U,
+    /** @brief A read/write storage buffer, bound to a renderbuffer. Global scope only. */
+    SHADER_UNIFORM_TYPE_STORAGE_BUFFER = 18U,
+    /** @brief A read/write storage image, bound to a texture created as storage. Global scope only. */
+    SHADER_UNIFORM_TYPE_STORAGE_IMAGE = 19U,
     SHADER_UNIFORM_TYPE_CUSTOM = 255U
 } shader_uniform_type;
 
@@ -450,6 +693,13 @@ typedef struct shader_attribute_config {
     u8 size;
     /** @brief The type of the attribute. */
     shader_attribute_type type;
+    /** @brief Indicates if the attribute advances per-instance rather than per-vertex. */
+    b8 per_instance;
+    /**
+     * @brief Indicates if the attribute belongs to the shader's packed vertex layout, used in place of
+     * its per-vertex attributes to draw geometry with GEOMETRY_VERTEX_FORMAT_PACKED.
+     */
+    b8 packed;
 } shader_attribute_config;
 
 /** @brief Configuration for a uniform. */
@@ -475,6 +725,22 @@ typedef struct shader_uniform_config {
  * destroyed by the shader resource loader, and set to the
  * properties found in a .shadercfg resource file.
  */
+/** @brief The most specialization constants a shader may declare. */
+#define SHADER_MAX_SPECIALIZATIONS 8
+
+/**
+ * @brief Configuration for a specialization constant, a value fixed into a shader's pipelines when
+ * they are created. Each combination of values used is a separate variant of the shader.
+ */
+typedef struct shader_specialization_config {
+    /** @brief The name of the constant, used to look it up when choosing a variant. */
+    char *name;
+    /** @brief The constant_id of the constant within the shader stages. */
+    u32 id;
+    /** @brief The value of the constant unless a variant says otherwise. Booleans are 0 or 1. */
+    u32 default_value;
+} shader_specialization_config;
+
 typedef struct shader_config {
     /** @brief The name of the shader to be created. */
     char *name;
@@ -506,8 +772,90 @@ typedef struct shader_config {
 
     /** @brief The flags set for this shader. */
     u32 flags;
+
+    /** @brief The number of specialization constants. */
+    u8 specialization_count;
+    /** @brief The specialization constants, in the order variant values are given. */
+    shader_specialization_config specializations[SHADER_MAX_SPECIALIZATIONS];
 } shader_config;
 
+/** @brief The current version of the .ksbundle file format. */
+#define KSHADER_BUNDLE_VERSION 1
+
+/**
+ * @brief The header of a .ksbundle (Kohi shader bundle) file, which follows the resource_header. A bundle
+ * holds a shader config already parsed, along with the compiled code of each of its stages, so that
+ * a shader is created from a single read with nothing to parse or compile. It is followed by
+ * attribute_count kshader_bundle_attribute records, uniform_count kshader_bundle_uniform records,
+ * specialization_count kshader_bundle_specialization records and stage_count kshader_bundle_stage
+ * records, then string_size bytes of null terminated strings, then code_size bytes of stage code.
+ * The code is shared by every variant, as specialization constants are only applied when pipelines
+ * are created.
+ */
+typedef struct kshader_bundle_header {
+    /** @brief The offset of the shader name within the strings. */
+    u32 name_offset;
+    u32 max_instances;
+    /** @brief Maps to shader_flags. */
+    u32 flags;
+    /** @brief Maps to primitive_topology_type. */
+    u32 topology_types;
+    /** @brief Maps to face_cull_mode. */
+    u8 cull_mode;
+    u8 stage_count;
+    u8 specialization_count;
+    /** @brief Reserved for future header data. */
+    u8 reserved;
+    u16 attribute_count;
+    u16 uniform_count;
+    /** @brief The size of the strings, in bytes. */
+    u32 string_size;
+    /** @brief The size of the stage code, in bytes. */
+    u32 code_size;
+} kshader_bundle_header;
+
+/** @brief An attribute of a .ksbundle file. */
+typedef struct kshader_bundle_attribute {
+    u32 name_offset;
+    /** @brief Maps to shader_attribute_type. */
+    u32 type;
+    u8 size;
+    u8 per_instance;
+    u8 packed;
+    u8 reserved;
+} kshader_bundle_attribute;
+
+/** @brief A uniform of a .ksbundle file. */
+typedef struct kshader_bundle_uniform {
+    u32 name_offset;
+    /** @brief Maps to shader_uniform_type. */
+    u32 type;
+    /** @brief Maps to shader_scope. */
+    u32 scope;
+    u32 array_length;
+    u16 size;
+    u16 reserved;
+} kshader_bundle_uniform;
+
+/** @brief A specialization constant of a .ksbundle file. */
+typedef struct kshader_bundle_specialization {
+    u32 name_offset;
+    u32 id;
+    u32 default_value;
+} kshader_bundle_specialization;
+
+/** @brief A stage of a .ksbundle file. */
+typedef struct kshader_bundle_stage {
+    u32 name_offset;
+    /** @brief The offset of the stage's source file name, kept so that the stage can be hot reloaded. */
+    u32 filename_offset;
+    /** @brief Maps to shader_stage. */
+    u32 stage;
+    /** @brief The offset of the stage's SPIR-V within the code, a multiple of 4. */
+    u32 code_offset;
+    u32 code_size;
+} kshader_bundle_stage;
+
 typedef enum material_type {
     // Invalid.
     MATERIAL_TYPE_UNKNOWN = 0,
@@ -619,6 +967,11 @@ typedef struct material {
 
     u32 shader_id;
 
+    /** @brief The variant of the shader used by the material, chosen by the features it needs. */
+    u32 shader_variant;
+    /** @brief The variant of the shader used when drawn with weighted blended transparency. */
+    u32 weighted_shader_variant;
+
     /** @brief Synced to the renderer's current frame number when the material has
      * been applied that frame. */
     u64 render_frame_number;
@@ -650,6 +1003,10 @@ typedef struct mesh_simple_scene_config {
     char *resource_name;
     transform transform;
     char *parent_name;  // optional
+    // optional. The impostor atlas drawn in place of the mesh beyond impostor_distance. See mesh_config.
+    char *impostor_name;
+    u32 impostor_frame_count;
+    f32 impostor_distance;
 } mesh_simple_scene_config;
 
 typedef struct terrain_simple_scene_config {
@@ -658,6 +1015,20 @@ typedef struct terrain_simple_scene_config {
     transform xform;
 } terrain_simple_scene_config;
 
+typedef struct particle_emitter_simple_scene_config {
+    char *name;
+    char *resource_name;
+    vec3 position;
+} particle_emitter_simple_scene_config;
+
+typedef struct skinned_mesh_simple_scene_config {
+    char *name;
+    char *resource_name;
+    transform transform;
+    /** @brief The clip played on a loop from when the scene loads. If 0, the rest pose is held. */
+    char *clip_name;
+} skinned_mesh_simple_scene_config;
+
 typedef struct simple_scene_config {
     char *name;
     char *description;
@@ -672,4 +1043,10 @@ typedef struct simple_scene_config {
 
     // darray
     terrain_simple_scene_config *terrains;
+
+    // darray
+    particle_emitter_simple_scene_config *particle_emitters;
+
+    // darray
+    skinned_mesh_simple_scene_config *skinned_meshes;
 } simple_scene_config;
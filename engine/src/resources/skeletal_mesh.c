@@ -0,0 +1,320 @@
+#include "skeletal_mesh.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "systems/job_system.h"
+
+// The number of animators evaluated by each job.
+#define SKELETAL_ANIMATION_BATCH_SIZE 8
+
+void animation_key_encode(quat rotation, vec3 translation, vec3 scale, const animation_range* range, animation_key* out_key) {
+    quat q = quat_normalize(rotation);
+    for (u32 i = 0; i < 4; ++i) {
+        out_key->rotation[i] = (i16)kfloor(KCLAMP(q.elements[i], -1.0f, 1.0f) * 32767.0f + 0.5f);
+    }
+    for (u32 i = 0; i < 3; ++i) {
+        f32 t_extent = range->translation_extent.elements[i];
+        f32 s_extent = range->scale_extent.elements[i];
+        f32 t = t_extent > 0.0f ? (translation.elements[i] - range->translation_min.elements[i]) / t_extent : 0.0f;
+        f32 s = s_extent > 0.0f ? (scale.elements[i] - range->scale_min.elements[i]) / s_extent : 0.0f;
+        out_key->translation[i] = (u16)kfloor(KCLAMP(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        out_key->scale[i] = (u16)kfloor(KCLAMP(s, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+}
+
+// Dequantizes a key into lane i of channels held 4 lanes apart.
+static void animation_key_decode(const animation_key* key, const animation_range* range, u32 lane, f32 out_channels[ANIMATION_CHANNEL_COUNT][4]) {
+    for (u32 c = 0; c < 4; ++c) {
+        out_channels[ANIMATION_CHANNEL_ROTATION_X + c][lane] = (f32)key->rotation[c] * (1.0f / 32767.0f);
+    }
+    for (u32 c = 0; c < 3; ++c) {
+        out_channels[ANIMATION_CHANNEL_TRANSLATION_X + c][lane] = range->translation_min.elements[c] + (f32)key->translation[c] * (range->translation_extent.elements[c] * (1.0f / 65535.0f));
+        out_channels[ANIMATION_CHANNEL_SCALE_X + c][lane] = range->scale_min.elements[c] + (f32)key->scale[c] * (range->scale_extent.elements[c] * (1.0f / 65535.0f));
+    }
+}
+
+/*
+ * Mixes four joints of a towards b by t, storing them in out. Channel c of lane i is found at
+ * [c * stride + i] for each of a, b and out. Translations and scales are mixed linearly and
+ * rotations by a normalized linear interpolation along the shorter arc.
+ */
+static void joints_mix4(const f32* a, u32 a_stride, const f32* b, u32 b_stride, f32 t, f32* out, u32 out_stride) {
+#if KSIMD_ENABLED
+    ksimd_f32x4 t4 = ksimd_set1(t);
+    for (u32 c = ANIMATION_CHANNEL_TRANSLATION_X; c < ANIMATION_CHANNEL_COUNT; ++c) {
+        ksimd_f32x4 va = ksimd_load(a + c * a_stride);
+        ksimd_f32x4 vb = ksimd_load(b + c * b_stride);
+        ksimd_store(out + c * out_stride, ksimd_madd(ksimd_sub(vb, va), t4, va));
+    }
+
+    ksimd_f32x4 ra[4];
+    ksimd_f32x4 rb[4];
+    for (u32 c = 0; c < 4; ++c) {
+        ra[c] = ksimd_load(a + c * a_stride);
+        rb[c] = ksimd_load(b + c * b_stride);
+    }
+    ksimd_f32x4 dot = ksimd_mul(ra[0], rb[0]);
+    dot = ksimd_madd(ra[1], rb[1], dot);
+    dot = ksimd_madd(ra[2], rb[2], dot);
+    dot = ksimd_madd(ra[3], rb[3], dot);
+    // 1 where the rotations are on the same side, -1 where b must be flipped to take the shorter arc.
+    ksimd_f32x4 sign = ksimd_sub(ksimd_and(ksimd_cmpge(dot, ksimd_set1(0.0f)), ksimd_set1(2.0f)), ksimd_set1(1.0f));
+    ksimd_f32x4 r[4];
+    ksimd_f32x4 length_squared = ksimd_set1(0.0f);
+    for (u32 c = 0; c < 4; ++c) {
+        r[c] = ksimd_madd(ksimd_sub(ksimd_mul(rb[c], sign), ra[c]), t4, ra[c]);
+        length_squared = ksimd_madd(r[c], r[c], length_squared);
+    }
+    ksimd_f32x4 length = ksimd_max(ksimd_sqrt(length_squared), ksimd_set1(K_FLOAT_EPSILON));
+    for (u32 c = 0; c < 4; ++c) {
+        ksimd_store(out + c * out_stride, ksimd_div(r[c], length));
+    }
+#else
+    for (u32 i = 0; i < 4; ++i) {
+        for (u32 c = ANIMATION_CHANNEL_TRANSLATION_X; c < ANIMATION_CHANNEL_COUNT; ++c) {
+            f32 va = a[c * a_stride + i];
+            out[c * out_stride + i] = va + (b[c * b_stride + i] - va) * t;
+        }
+        f32 dot = 0.0f;
+        for (u32 c = 0; c < 4; ++c) {
+            dot += a[c * a_stride + i] * b[c * b_stride + i];
+        }
+        f32 sign = dot >= 0.0f ? 1.0f : -1.0f;
+        f32 r[4];
+        f32 length_squared = 0.0f;
+        for (u32 c = 0; c < 4; ++c) {
+            f32 va = a[c * a_stride + i];
+            r[c] = va + (b[c * b_stride + i] * sign - va) * t;
+            length_squared += r[c] * r[c];
+        }
+        f32 length = KMAX(ksqrt(length_squared), K_FLOAT_EPSILON);
+        for (u32 c = 0; c < 4; ++c) {
+            out[c * out_stride + i] = r[c] / length;
+        }
+    }
+#endif
+}
+
+void animation_clip_sample(const animation_clip* clip, u32 joint_count, f32 time, animation_pose* out_pose) {
+    f32 frame_position = KCLAMP(time, 0.0f, clip->duration) * clip->sample_rate;
+    u32 frame_0 = (u32)frame_position;
+    u32 frame_1 = frame_0 + 1;
+    f32 t = frame_position - (f32)frame_0;
+    if (frame_1 >= clip->frame_count) {
+        frame_0 = clip->frame_count - 1;
+        frame_1 = frame_0;
+        t = 0.0f;
+    }
+    const animation_key* keys_0 = clip->keys + (u64)frame_0 * joint_count;
+    const animation_key* keys_1 = clip->keys + (u64)frame_1 * joint_count;
+
+    for (u32 j = 0; j < joint_count; j += 4) {
+        f32 a[ANIMATION_CHANNEL_COUNT][4];
+        f32 b[ANIMATION_CHANNEL_COUNT][4];
+        for (u32 lane = 0; lane < 4; ++lane) {
+            if (j + lane < joint_count) {
+                animation_key_decode(&keys_0[j + lane], &clip->ranges[j + lane], lane, a);
+                animation_key_decode(&keys_1[j + lane], &clip->ranges[j + lane], lane, b);
+            } else {
+                // Lanes past the last joint are given identity transforms, and never read.
+                for (u32 c = 0; c < ANIMATION_CHANNEL_COUNT; ++c) {
+                    f32 identity = (c == ANIMATION_CHANNEL_ROTATION_W || c >= ANIMATION_CHANNEL_SCALE_X) ? 1.0f : 0.0f;
+                    a[c][lane] = identity;
+                    b[c][lane] = identity;
+                }
+            }
+        }
+        joints_mix4(&a[0][0], 4, &b[0][0], 4, t, &out_pose->channels[0][j], SKELETON_MAX_JOINTS);
+    }
+}
+
+void animation_pose_blend(u32 joint_count, const animation_pose* a, const animation_pose* b, f32 weight, animation_pose* out_pose) {
+    for (u32 j = 0; j < joint_count; j += 4) {
+        joints_mix4(&a->channels[0][j], SKELETON_MAX_JOINTS, &b->channels[0][j], SKELETON_MAX_JOINTS, weight, &out_pose->channels[0][j], SKELETON_MAX_JOINTS);
+    }
+}
+
+// Builds the local matrix of a joint, scaling, then rotating, then translating (for row vectors).
+static mat4 joint_local_matrix(const animation_pose* pose, u32 j) {
+    const f32 x = pose->channels[ANIMATION_CHANNEL_ROTATION_X][j];
+    const f32 y = pose->channels[ANIMATION_CHANNEL_ROTATION_Y][j];
+    const f32 z = pose->channels[ANIMATION_CHANNEL_ROTATION_Z][j];
+    const f32 w = pose->channels[ANIMATION_CHANNEL_ROTATION_W][j];
+    const f32 sx = pose->channels[ANIMATION_CHANNEL_SCALE_X][j];
+    const f32 sy = pose->channels[ANIMATION_CHANNEL_SCALE_Y][j];
+    const f32 sz = pose->channels[ANIMATION_CHANNEL_SCALE_Z][j];
+
+    mat4 m;
+    m.data[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+    m.data[1] = 2.0f * (x * y + z * w) * sx;
+    m.data[2] = 2.0f * (x * z - y * w) * sx;
+    m.data[3] = 0.0f;
+    m.data[4] = 2.0f * (x * y - z * w) * sy;
+    m.data[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+    m.data[6] = 2.0f * (y * z + x * w) * sy;
+    m.data[7] = 0.0f;
+    m.data[8] = 2.0f * (x * z + y * w) * sz;
+    m.data[9] = 2.0f * (y * z - x * w) * sz;
+    m.data[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+    m.data[11] = 0.0f;
+    m.data[12] = pose->channels[ANIMATION_CHANNEL_TRANSLATION_X][j];
+    m.data[13] = pose->channels[ANIMATION_CHANNEL_TRANSLATION_Y][j];
+    m.data[14] = pose->channels[ANIMATION_CHANNEL_TRANSLATION_Z][j];
+    m.data[15] = 1.0f;
+    return m;
+}
+
+void skeleton_skinning_matrices(const skeleton* s, const animation_pose* pose, mat4* out_matrices) {
+    // The model space transform of each joint first, with parents always done before children.
+    for (u32 j = 0; j < s->joint_count; ++j) {
+        mat4 local = joint_local_matrix(pose, j);
+        i16 parent = s->parents[j];
+        out_matrices[j] = parent < 0 ? local : mat4_mul(local, out_matrices[parent]);
+    }
+    // Then the transform from the bind pose, now that no more children need them.
+    for (u32 j = 0; j < s->joint_count; ++j) {
+        out_matrices[j] = mat4_mul(s->inverse_bind_matrices[j], out_matrices[j]);
+    }
+}
+
+u32 skeletal_mesh_clip_index_get(const skeletal_mesh* mesh, const char* clip_name) {
+    if (!mesh || !clip_name) {
+        return INVALID_ID;
+    }
+    for (u32 i = 0; i < mesh->clip_count; ++i) {
+        if (mesh->clips[i].name && strings_equali(mesh->clips[i].name, clip_name)) {
+            return i;
+        }
+    }
+    return INVALID_ID;
+}
+
+void skeletal_animator_create(const skeletal_mesh* mesh, skeletal_animator* out_animator) {
+    kzero_memory(out_animator, sizeof(skeletal_animator));
+    out_animator->mesh = mesh;
+    out_animator->clip_index = INVALID_ID;
+    out_animator->previous_clip_index = INVALID_ID;
+    out_animator->speed = 1.0f;
+}
+
+b8 skeletal_animator_play(skeletal_animator* animator, const char* clip_name, b8 loop, f32 blend_duration) {
+    if (!animator || !animator->mesh) {
+        return false;
+    }
+
+    u32 clip_index = INVALID_ID;
+    if (clip_name) {
+        clip_index = skeletal_mesh_clip_index_get(animator->mesh, clip_name);
+        if (clip_index == INVALID_ID) {
+            KWARN("Skeletal mesh '%s' has no clip named '%s'.", animator->mesh->name, clip_name);
+            return false;
+        }
+    }
+
+    // Fade out from what is playing now, unless nothing will be visible of it.
+    if (blend_duration > 0.0f) {
+        animator->previous_clip_index = animator->clip_index;
+        animator->previous_time = animator->time;
+        animator->previous_loop = animator->loop;
+        animator->blend_duration = blend_duration;
+        animator->blend_elapsed = 0.0f;
+    } else {
+        animator->previous_clip_index = INVALID_ID;
+        animator->blend_duration = 0.0f;
+    }
+    animator->clip_index = clip_index;
+    animator->time = 0.0f;
+    animator->loop = loop;
+    return true;
+}
+
+u32 skeletal_animation_palette_assign(u32 animator_count, skeletal_animator* animators) {
+    u32 offset = 0;
+    for (u32 i = 0; i < animator_count; ++i) {
+        animators[i].palette_offset = offset;
+        offset += animators[i].mesh ? animators[i].mesh->skeleton.joint_count : 0;
+    }
+    return offset;
+}
+
+// Advances the time into a clip, wrapping it if looping, otherwise holding the last frame.
+static f32 clip_time_advance(const animation_clip* clip, f32 time, f32 delta_time, b8 loop) {
+    time += delta_time;
+    if (loop && clip->duration > 0.0f) {
+        time -= kfloor(time / clip->duration) * clip->duration;
+    } else {
+        time = KCLAMP(time, 0.0f, clip->duration);
+    }
+    return time;
+}
+
+// Samples the given clip of an animator, or its rest pose for INVALID_ID.
+static void animator_clip_sample(const skeletal_animator* animator, u32 clip_index, f32 time, animation_pose* out_pose) {
+    const skeletal_mesh* mesh = animator->mesh;
+    if (clip_index == INVALID_ID) {
+        for (u32 c = 0; c < ANIMATION_CHANNEL_COUNT; ++c) {
+            kcopy_memory(out_pose->channels[c], mesh->skeleton.rest_pose->channels[c], sizeof(f32) * mesh->skeleton.joint_count);
+        }
+    } else {
+        animation_clip_sample(&mesh->clips[clip_index], mesh->skeleton.joint_count, time, out_pose);
+    }
+}
+
+typedef struct skeletal_animation_update_data {
+    skeletal_animator* animators;
+    f32 delta_time;
+    mat4* palette;
+} skeletal_animation_update_data;
+
+static void skeletal_animation_update_batch(u32 start, u32 end, void* user_data) {
+    skeletal_animation_update_data* data = user_data;
+    // Held on the stack, since every job thread needs its own.
+    animation_pose pose;
+    animation_pose previous_pose;
+
+    for (u32 i = start; i < end; ++i) {
+        skeletal_animator* animator = &data->animators[i];
+        const skeletal_mesh* mesh = animator->mesh;
+        if (!mesh || !mesh->skeleton.joint_count) {
+            continue;
+        }
+
+        f32 step = data->delta_time * animator->speed;
+        if (animator->clip_index != INVALID_ID) {
+            animator->time = clip_time_advance(&mesh->clips[animator->clip_index], animator->time, step, animator->loop);
+        }
+        animator_clip_sample(animator, animator->clip_index, animator->time, &pose);
+
+        if (animator->blend_duration > 0.0f) {
+            animator->blend_elapsed += data->delta_time;
+            if (animator->blend_elapsed >= animator->blend_duration) {
+                // The crossfade is over.
+                animator->previous_clip_index = INVALID_ID;
+                animator->blend_duration = 0.0f;
+            } else {
+                if (animator->previous_clip_index != INVALID_ID) {
+                    animator->previous_time = clip_time_advance(&mesh->clips[animator->previous_clip_index], animator->previous_time, step, animator->previous_loop);
+                }
+                animator_clip_sample(animator, animator->previous_clip_index, animator->previous_time, &previous_pose);
+                f32 weight = animator->blend_elapsed / animator->blend_duration;
+                animation_pose_blend(mesh->skeleton.joint_count, &previous_pose, &pose, weight, &pose);
+            }
+        }
+
+        skeleton_skinning_matrices(&mesh->skeleton, &pose, data->palette + animator->palette_offset);
+    }
+}
+
+void skeletal_animation_update(u32 animator_count, skeletal_animator* animators, f32 delta_time, mat4* out_palette) {
+    if (!animator_count || !animators || !out_palette) {
+        return;
+    }
+
+    skeletal_animation_update_data data = {0};
+    data.animators = animators;
+    data.delta_time = delta_time;
+    data.palette = out_palette;
+    job_parallel_for(animator_count, SKELETAL_ANIMATION_BATCH_SIZE, skeletal_animation_update_batch, &data);
+}
@@ -0,0 +1,299 @@
+/**
+ * @file skeletal_mesh.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains skeletal meshes, which are geometries skinned to a skeleton and
+ * posed by animation clips, along with the animators which play those clips.
+ * @details Skeletal meshes are imported from glTF by the tools into .ksa files. Clips are
+ * resampled at a fixed rate on import and their keys quantized to 20 bytes per joint per
+ * frame, with rotations as four snorm16 components and translations and scales as unorm16
+ * within the range each joint covers over the clip.
+ *
+ * Poses are held as structures of arrays, so four joints are sampled and blended at once
+ * where SIMD is available. skeletal_animation_update evaluates every animator given to it in
+ * parallel on the job threads, writing the skinning matrices of each into a shared palette
+ * which the vertex shader of skinned geometry reads.
+ * @version 1.0
+ * @date 2023-12-08
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct geometry_config;
+
+/** @brief The most joints a skeleton may have. Joints are referred to by vertices as u8. */
+#define SKELETON_MAX_JOINTS 256
+/** @brief The version of .ksa files written by the tools. */
+#define KSA_VERSION 1
+
+/** @brief The channels of a joint in an animation_pose. */
+typedef enum animation_channel {
+    ANIMATION_CHANNEL_ROTATION_X,
+    ANIMATION_CHANNEL_ROTATION_Y,
+    ANIMATION_CHANNEL_ROTATION_Z,
+    ANIMATION_CHANNEL_ROTATION_W,
+    ANIMATION_CHANNEL_TRANSLATION_X,
+    ANIMATION_CHANNEL_TRANSLATION_Y,
+    ANIMATION_CHANNEL_TRANSLATION_Z,
+    ANIMATION_CHANNEL_SCALE_X,
+    ANIMATION_CHANNEL_SCALE_Y,
+    ANIMATION_CHANNEL_SCALE_Z,
+    ANIMATION_CHANNEL_COUNT
+} animation_channel;
+
+/**
+ * @brief The local transforms of every joint of a skeleton, relative to their parents, as a
+ * structure of arrays indexed by animation_channel and then joint.
+ */
+typedef struct animation_pose {
+    f32 channels[ANIMATION_CHANNEL_COUNT][SKELETON_MAX_JOINTS];
+} animation_pose;
+
+/** @brief The quantized local transform of a joint at one frame of a clip. */
+typedef struct animation_key {
+    /** @brief The rotation, as snorm16. */
+    i16 rotation[4];
+    /** @brief The translation within the range of the joint, as unorm16. */
+    u16 translation[3];
+    /** @brief The scale within the range of the joint, as unorm16. */
+    u16 scale[3];
+} animation_key;
+
+/** @brief The range covered by the translations and scales of a joint over a clip. */
+typedef struct animation_range {
+    vec3 translation_min;
+    vec3 translation_extent;
+    vec3 scale_min;
+    vec3 scale_extent;
+} animation_range;
+
+/** @brief An animation clip, sampled at a fixed rate for every joint of its skeleton. */
+typedef struct animation_clip {
+    /** @brief The name of the clip. */
+    char* name;
+    /** @brief The length of the clip in seconds. */
+    f32 duration;
+    /** @brief The number of frames per second. */
+    f32 sample_rate;
+    /** @brief The number of frames. Always at least 1. */
+    u32 frame_count;
+    /** @brief The range of each joint. */
+    animation_range* ranges;
+    /** @brief The keys of every joint at each frame, frame by frame. */
+    animation_key* keys;
+} animation_clip;
+
+/**
+ * @brief A hierarchy of joints. Every joint comes after its parent, so poses can be evaluated
+ * in order with each parent already done.
+ */
+typedef struct skeleton {
+    /** @brief The number of joints. */
+    u32 joint_count;
+    /** @brief The name of each joint. */
+    char** joint_names;
+    /** @brief The index of each joint's parent, or -1 for roots. */
+    i16* parents;
+    /** @brief The local transform of each joint when no clip is playing. */
+    animation_pose* rest_pose;
+    /** @brief The matrix taking each vertex from the space of the mesh to that of each joint when bound. */
+    mat4* inverse_bind_matrices;
+} skeleton;
+
+/** @brief A skeletal mesh, as loaded from a .ksa file. */
+typedef struct skeletal_mesh {
+    /** @brief The name of the mesh. */
+    char* name;
+    /** @brief The skeleton the geometries are skinned to. */
+    skeleton skeleton;
+    /** @brief The number of clips. */
+    u32 clip_count;
+    /** @brief The clips, which animate every joint of the skeleton. */
+    animation_clip* clips;
+    /** @brief The number of geometries. */
+    u32 geometry_count;
+    /** @brief The geometries, with vertices of type vertex_3d_skinned and 32-bit indices. */
+    struct geometry_config* geometries;
+} skeletal_mesh;
+
+/**
+ * @brief Plays the clips of a skeletal mesh, crossfading between them when switched. Members
+ * of this structure should not be modified outside the functions associated with it, except
+ * for speed.
+ */
+typedef struct skeletal_animator {
+    /** @brief The mesh whose clips are played. */
+    const skeletal_mesh* mesh;
+    /** @brief The index of the clip playing, or INVALID_ID to hold the rest pose. */
+    u32 clip_index;
+    /** @brief The time into the clip, in seconds. */
+    f32 time;
+    /** @brief The rate time advances at. 1 by default. */
+    f32 speed;
+    /** @brief Indicates if the clip repeats, rather than holding its last frame. */
+    b8 loop;
+    /** @brief The index of the clip being faded out, or INVALID_ID if none. */
+    u32 previous_clip_index;
+    /** @brief The time into the clip being faded out. */
+    f32 previous_time;
+    /** @brief Indicates if the clip being faded out repeats. */
+    b8 previous_loop;
+    /** @brief The length of the crossfade in seconds. */
+    f32 blend_duration;
+    /** @brief The time since the crossfade began. */
+    f32 blend_elapsed;
+    /** @brief The index of the first skinning matrix of this animator in the palette. Set by skeletal_animation_palette_assign. */
+    u32 palette_offset;
+} skeletal_animator;
+
+/** @brief The header of a .ksa (Kohi skeletal animation) file, which follows the resource_header. All offsets are from the start of the file. */
+typedef struct ksa_header {
+    u32 joint_count;
+    u32 clip_count;
+    u32 geometry_count;
+    /** @brief The size of the string table in bytes. Its last byte is always a terminator. */
+    u32 string_table_size;
+    u64 string_table_offset;
+    /** @brief An array of ksa_joint. */
+    u64 joints_offset;
+    /** @brief An array of ksa_clip. */
+    u64 clips_offset;
+    /** @brief An array of ksa_geometry. */
+    u64 geometries_offset;
+    /** @brief The size of the whole file in bytes. */
+    u64 file_size;
+} ksa_header;
+
+/** @brief A joint of a .ksa file. Strings are offsets into the string table. */
+typedef struct ksa_joint {
+    u32 name;
+    i32 parent;
+    vec3 rest_translation;
+    quat rest_rotation;
+    vec3 rest_scale;
+    mat4 inverse_bind_matrix;
+} ksa_joint;
+
+/** @brief A clip of a .ksa file, whose ranges and keys are stored elsewhere in the file. */
+typedef struct ksa_clip {
+    u32 name;
+    u32 frame_count;
+    f32 duration;
+    f32 sample_rate;
+    /** @brief An array of animation_range, one per joint. */
+    u64 ranges_offset;
+    /** @brief An array of animation_key, joint_count per frame. */
+    u64 keys_offset;
+} ksa_clip;
+
+/** @brief A geometry of a .ksa file, whose vertices and 32-bit indices are stored elsewhere in the file. */
+typedef struct ksa_geometry {
+    u32 name;
+    u32 material_name;
+    u32 vertex_count;
+    u32 index_count;
+    vec3 center;
+    vec3 min_extents;
+    vec3 max_extents;
+    u32 reserved;
+    /** @brief An array of vertex_3d_skinned. */
+    u64 vertices_offset;
+    u64 indices_offset;
+} ksa_geometry;
+
+/**
+ * @brief Quantizes a local joint transform into a key, within the given range.
+ *
+ * @param rotation The rotation. Need not be normalized.
+ * @param translation The translation, within the range.
+ * @param scale The scale, within the range.
+ * @param range A constant pointer to the range of the joint over the clip.
+ * @param out_key A pointer to hold the key.
+ */
+KAPI void animation_key_encode(quat rotation, vec3 translation, vec3 scale, const animation_range* range, animation_key* out_key);
+
+/**
+ * @brief Samples a clip at the given time, interpolating between the frames either side of it.
+ *
+ * @param clip A constant pointer to the clip.
+ * @param joint_count The number of joints of the skeleton the clip animates.
+ * @param time The time in seconds. Clamped to the length of the clip.
+ * @param out_pose A pointer to hold the pose.
+ */
+KAPI void animation_clip_sample(const animation_clip* clip, u32 joint_count, f32 time, animation_pose* out_pose);
+
+/**
+ * @brief Blends one pose towards another, linearly for translations and scales and along the
+ * shorter arc for rotations.
+ *
+ * @param joint_count The number of joints of the poses.
+ * @param a A constant pointer to the pose at a weight of 0.
+ * @param b A constant pointer to the pose at a weight of 1.
+ * @param weight The weight of b, in [0, 1].
+ * @param out_pose A pointer to hold the blended pose. May be either a or b.
+ */
+KAPI void animation_pose_blend(u32 joint_count, const animation_pose* a, const animation_pose* b, f32 weight, animation_pose* out_pose);
+
+/**
+ * @brief Calculates the skinning matrix of every joint of the given pose, taking vertices from
+ * the space of the mesh when bound to that of the mesh when posed.
+ *
+ * @param s A constant pointer to the skeleton.
+ * @param pose A constant pointer to the pose.
+ * @param out_matrices An array of joint_count matrices to hold the skinning matrices.
+ */
+KAPI void skeleton_skinning_matrices(const skeleton* s, const animation_pose* pose, mat4* out_matrices);
+
+/**
+ * @brief Obtains the index of the clip of the given name.
+ *
+ * @param mesh A constant pointer to the mesh.
+ * @param clip_name The name of the clip.
+ * @return The index of the clip, or INVALID_ID if the mesh has none of that name.
+ */
+KAPI u32 skeletal_mesh_clip_index_get(const skeletal_mesh* mesh, const char* clip_name);
+
+/**
+ * @brief Creates an animator for the given mesh, holding its rest pose.
+ *
+ * @param mesh A constant pointer to the mesh. Must outlive the animator.
+ * @param out_animator A pointer to hold the animator.
+ */
+KAPI void skeletal_animator_create(const skeletal_mesh* mesh, skeletal_animator* out_animator);
+
+/**
+ * @brief Starts playing the clip of the given name from its beginning, crossfading from
+ * whatever was playing before.
+ *
+ * @param animator A pointer to the animator.
+ * @param clip_name The name of the clip, or 0 to return to the rest pose.
+ * @param loop Indicates if the clip should repeat.
+ * @param blend_duration The length of the crossfade in seconds. 0 to switch at once.
+ * @return True on success; otherwise false, such as if the mesh has no clip of that name.
+ */
+KAPI b8 skeletal_animator_play(skeletal_animator* animator, const char* clip_name, b8 loop, f32 blend_duration);
+
+/**
+ * @brief Assigns each animator its range of the skinning palette, one matrix per joint.
+ *
+ * @param animator_count The number of animators.
+ * @param animators The animators.
+ * @return The number of matrices in the palette.
+ */
+KAPI u32 skeletal_animation_palette_assign(u32 animator_count, skeletal_animator* animators);
+
+/**
+ * @brief Advances every given animator by the time step, then writes the skinning matrices of
+ * each into its range of the palette. Animators are evaluated in parallel on the job threads.
+ *
+ * @param animator_count The number of animators.
+ * @param animators The animators, whose ranges of the palette must have been assigned.
+ * @param delta_time The time step in seconds.
+ * @param out_palette An array of matrices, big enough for the ranges of every animator.
+ */
+KAPI void skeletal_animation_update(u32 animator_count, skeletal_animator* animators, f32 delta_time, mat4* out_palette);
@@ -14,6 +14,13 @@
 #include "systems/light_system.h"
 #include "systems/material_system.h"
 #include "systems/shader_system.h"
+#include "systems/texture_system.h"
+
+// The number of vertices along each side of the patch of a vertex-pulled terrain.
+#define TERRAIN_PATCH_VERTEX_STRIDE (TERRAIN_CHUNK_TILE_COUNT + 1)
+
+static u32 terrain_chunk_indices_generate(u32 stride, u32 x_start, u32 z_start, u32 tiles_x, u32 tiles_z, u32 step, u32 *out_indices);
+static b8 terrain_heightmap_create(terrain *t);
 
 b8 terrain_create(const terrain_config *config, terrain *out_terrain) {
     if (!out_terrain) {
@@ -23,19 +30,20 @@ b8 terrain_create(const terrain_config *config, terrain *out_terrain) {
 
     out_terrain->name = string_duplicate(config->name);
 
-    if (!config->tile_count_x) {
-        KERROR("Tile count x cannot be less than one.");
+    // NOTE: Tile counts are the number of vertices along each axis, so at least two are needed for a tile.
+    if (config->tile_count_x < 2) {
+        KERROR("Tile count x cannot be less than two.");
         return false;
     }
 
-    if (!config->tile_count_z) {
-        KERROR("Tile count z cannot be less than one.");
+    if (config->tile_count_z < 2) {
+        KERROR("Tile count z cannot be less than two.");
         return false;
     }
 
     out_terrain->xform = config->xform;
 
-    // TODO: calculate based on actual terrain dimensions.
+    // Calculated from the vertices when initialized.
     out_terrain->extents = (extents_3d){0};
     out_terrain->origin = vec3_zero();
 
@@ -46,14 +54,41 @@ b8 terrain_create(const terrain_config *config, terrain *out_terrain) {
 
     out_terrain->scale_y = config->scale_y;
 
+    // Vertex-pulled terrains keep only their heights.
+    out_terrain->vertex_pulling = config->vertex_pulling;
     out_terrain->vertex_count = out_terrain->tile_count_x * out_terrain->tile_count_z;
-    out_terrain->vertices = kallocate(sizeof(terrain_vertex) * out_terrain->vertex_count, MEMORY_TAG_ARRAY);
+    out_terrain->vertices = out_terrain->vertex_pulling ? 0 : kallocate(sizeof(terrain_vertex) * out_terrain->vertex_count, MEMORY_TAG_ARRAY);
+    out_terrain->heightmap = 0;
 
     out_terrain->vertex_data_length = out_terrain->vertex_count;
     out_terrain->vertex_datas = kallocate(sizeof(terrain_vertex_data) * out_terrain->vertex_data_length, MEMORY_TAG_ARRAY);
     kcopy_memory(out_terrain->vertex_datas, config->vertex_datas, config->vertex_data_length * sizeof(terrain_vertex_data));
 
-    out_terrain->index_count = out_terrain->vertex_count * 6;
+    // Chunks are filled in when initialized. Those along the far edges may hold fewer tiles.
+    out_terrain->chunk_count_x = (out_terrain->tile_count_x - 1 + TERRAIN_CHUNK_TILE_COUNT - 1) / TERRAIN_CHUNK_TILE_COUNT;
+    out_terrain->chunk_count_z = (out_terrain->tile_count_z - 1 + TERRAIN_CHUNK_TILE_COUNT - 1) / TERRAIN_CHUNK_TILE_COUNT;
+    out_terrain->chunk_count = out_terrain->chunk_count_x * out_terrain->chunk_count_z;
+    out_terrain->chunks = kallocate(sizeof(terrain_chunk) * out_terrain->chunk_count, MEMORY_TAG_ARRAY);
+    out_terrain->lod_distance = TERRAIN_CHUNK_TILE_COUNT * KMAX(out_terrain->tile_scale_x, out_terrain->tile_scale_z) * 2.0f;
+
+    // Count the indices of every level of every chunk, or of the patch they all share.
+    out_terrain->index_count = 0;
+    if (out_terrain->vertex_pulling) {
+        for (u32 lod = 0, step = 1; lod < TERRAIN_CHUNK_LOD_COUNT; ++lod, step *= 2) {
+            out_terrain->index_count += terrain_chunk_indices_generate(TERRAIN_PATCH_VERTEX_STRIDE, 0, 0, TERRAIN_CHUNK_TILE_COUNT, TERRAIN_CHUNK_TILE_COUNT, step, 0);
+        }
+    }
+    for (u32 cz = 0; cz < out_terrain->chunk_count_z && !out_terrain->vertex_pulling; ++cz) {
+        for (u32 cx = 0; cx < out_terrain->chunk_count_x; ++cx) {
+            u32 x_start = cx * TERRAIN_CHUNK_TILE_COUNT;
+            u32 z_start = cz * TERRAIN_CHUNK_TILE_COUNT;
+            u32 tiles_x = KMIN(TERRAIN_CHUNK_TILE_COUNT, out_terrain->tile_count_x - 1 - x_start);
+            u32 tiles_z = KMIN(TERRAIN_CHUNK_TILE_COUNT, out_terrain->tile_count_z - 1 - z_start);
+            for (u32 lod = 0, step = 1; lod < TERRAIN_CHUNK_LOD_COUNT && tiles_x % step == 0 && tiles_z % step == 0; ++lod, step *= 2) {
+                out_terrain->index_count += terrain_chunk_indices_generate(out_terrain->tile_count_x, x_start, z_start, tiles_x, tiles_z, step, 0);
+            }
+        }
+    }
     out_terrain->indices = kallocate(sizeof(u32) * out_terrain->index_count, MEMORY_TAG_ARRAY);
 
     out_terrain->material_count = config->material_count;
@@ -89,6 +124,11 @@ void terrain_destroy(terrain *t) {
         t->indices = 0;
     }
 
+    if (t->chunks) {
+        kfree(t->chunks, sizeof(terrain_chunk) * t->chunk_count, MEMORY_TAG_ARRAY);
+        t->chunks = 0;
+    }
+
     if (t->material_names) {
         kfree(t->material_names, sizeof(char *) * t->material_count, MEMORY_TAG_ARRAY);
         t->material_names = 0;
@@ -108,6 +148,9 @@ void terrain_destroy(terrain *t) {
     t->tile_count_x = 0;
     t->tile_count_z = 0;
     t->vertex_data_length = 0;
+    t->chunk_count = 0;
+    t->chunk_count_x = 0;
+    t->chunk_count_z = 0;
     kzero_memory(&t->origin, sizeof(vec3));
     kzero_memory(&t->extents, sizeof(vec3));
 }
@@ -118,8 +161,19 @@ b8 terrain_initialize(terrain *t) {
         return false;
     }
 
+    // Vertex-pulled terrains share one patch, every level of which is drawn for every chunk, with
+    // the vertices beyond the far edges of the terrain clamped to them.
+    if (t->vertex_pulling) {
+        u32 i = 0;
+        for (u32 lod = 0, step = 1; lod < TERRAIN_CHUNK_LOD_COUNT; ++lod, step *= 2) {
+            t->patch_index_offsets[lod] = i;
+            t->patch_index_counts[lod] = terrain_chunk_indices_generate(TERRAIN_PATCH_VERTEX_STRIDE, 0, 0, TERRAIN_CHUNK_TILE_COUNT, TERRAIN_CHUNK_TILE_COUNT, step, &t->indices[i]);
+            i += t->patch_index_counts[lod];
+        }
+    }
+
     // Generate vertices.
-    for (u32 z = 0, i = 0; z < t->tile_count_z; z++) {
+    for (u32 z = 0, i = 0; z < t->tile_count_z && !t->vertex_pulling; z++) {
         for (u32 x = 0; x < t->tile_count_x; ++x, ++i) {
             terrain_vertex *v = &t->vertices[i];
             v->position.x = x * t->tile_scale_x;
@@ -158,26 +212,75 @@ b8 terrain_initialize(terrain *t) {
         }
     }
 
-    // Generate indices.
-    for (u32 z = 0, i = 0; z < t->tile_count_z - 1; z++) {
-        for (u32 x = 0; x < t->tile_count_x - 1; ++x, i += 6) {
-            u32 v0 = (z * t->tile_count_x) + x;
-            u32 v1 = (z * t->tile_count_x) + x + 1;
-            u32 v2 = ((z + 1) * t->tile_count_x) + x;
-            u32 v3 = ((z + 1) * t->tile_count_x) + x + 1;
-
-            // v0, v1, v2, v2, v1, v3
-            t->indices[i + 0] = v2;
-            t->indices[i + 1] = v1;
-            t->indices[i + 2] = v0;
-            t->indices[i + 3] = v3;
-            t->indices[i + 4] = v1;
-            t->indices[i + 5] = v2;
+    // Generate the full-resolution indices of each chunk, and its extents.
+    u32 i = 0;
+    for (u32 cz = 0; cz < t->chunk_count_z; ++cz) {
+        for (u32 cx = 0; cx < t->chunk_count_x; ++cx) {
+            terrain_chunk *chunk = &t->chunks[cz * t->chunk_count_x + cx];
+            u32 x_start = cx * TERRAIN_CHUNK_TILE_COUNT;
+            u32 z_start = cz * TERRAIN_CHUNK_TILE_COUNT;
+            u32 tiles_x = KMIN(TERRAIN_CHUNK_TILE_COUNT, t->tile_count_x - 1 - x_start);
+            u32 tiles_z = KMIN(TERRAIN_CHUNK_TILE_COUNT, t->tile_count_z - 1 - z_start);
+
+            if (t->vertex_pulling) {
+                chunk->lod_count = TERRAIN_CHUNK_LOD_COUNT;
+            } else {
+                chunk->lod_count = 1;
+                chunk->index_offsets[0] = i;
+                chunk->index_counts[0] = terrain_chunk_indices_generate(t->tile_count_x, x_start, z_start, tiles_x, tiles_z, 1, &t->indices[i]);
+                i += chunk->index_counts[0];
+            }
+
+            // The chunk spans the vertices from its first tile to the far corner of its last.
+            chunk->extents.min = (vec3){x_start * t->tile_scale_x, t->vertex_datas[z_start * t->tile_count_x + x_start].height * t->scale_y, z_start * t->tile_scale_z};
+            chunk->extents.max = chunk->extents.min;
+            for (u32 z = z_start; z <= z_start + tiles_z; z++) {
+                for (u32 x = x_start; x <= x_start + tiles_x; ++x) {
+                    // The same position the vertex is given, whether on the CPU or in the vertex shader.
+                    vec3 p = {x * t->tile_scale_x, t->vertex_datas[z * t->tile_count_x + x].height * t->scale_y, z * t->tile_scale_z};
+                    chunk->extents.min = (vec3){KMIN(chunk->extents.min.x, p.x), KMIN(chunk->extents.min.y, p.y), KMIN(chunk->extents.min.z, p.z)};
+                    chunk->extents.max = (vec3){KMAX(chunk->extents.max.x, p.x), KMAX(chunk->extents.max.y, p.y), KMAX(chunk->extents.max.z, p.z)};
+                }
+            }
+
+            if (cx == 0 && cz == 0) {
+                t->extents = chunk->extents;
+            } else {
+                t->extents.min = (vec3){KMIN(t->extents.min.x, chunk->extents.min.x), KMIN(t->extents.min.y, chunk->extents.min.y), KMIN(t->extents.min.z, chunk->extents.min.z)};
+                t->extents.max = (vec3){KMAX(t->extents.max.x, chunk->extents.max.x), KMAX(t->extents.max.y, chunk->extents.max.y), KMAX(t->extents.max.z, chunk->extents.max.z)};
+            }
         }
     }
 
-    terrain_geometry_generate_normals(t->vertex_count, t->vertices, t->index_count, t->indices);
-    terrain_geometry_generate_tangents(t->vertex_count, t->vertices, t->index_count, t->indices);
+    // The vertex shader lights and weights vertex-pulled terrains itself.
+    if (t->vertex_pulling) {
+        return true;
+    }
+
+    // Normals and tangents only need the full-resolution triangles.
+    terrain_geometry_generate_normals(t->vertex_count, t->vertices, i, t->indices);
+    terrain_geometry_generate_tangents(t->vertex_count, t->vertices, i, t->indices);
+
+    // Generate the remaining levels of detail. A chunk has a level only if its tiles divide evenly into those of the level.
+    for (u32 lod = 1, step = 2; lod < TERRAIN_CHUNK_LOD_COUNT; ++lod, step *= 2) {
+        for (u32 cz = 0; cz < t->chunk_count_z; ++cz) {
+            for (u32 cx = 0; cx < t->chunk_count_x; ++cx) {
+                terrain_chunk *chunk = &t->chunks[cz * t->chunk_count_x + cx];
+                u32 x_start = cx * TERRAIN_CHUNK_TILE_COUNT;
+                u32 z_start = cz * TERRAIN_CHUNK_TILE_COUNT;
+                u32 tiles_x = KMIN(TERRAIN_CHUNK_TILE_COUNT, t->tile_count_x - 1 - x_start);
+                u32 tiles_z = KMIN(TERRAIN_CHUNK_TILE_COUNT, t->tile_count_z - 1 - z_start);
+                if (chunk->lod_count != lod || tiles_x % step != 0 || tiles_z % step != 0) {
+                    continue;
+                }
+
+                chunk->index_offsets[lod] = i;
+                chunk->index_counts[lod] = terrain_chunk_indices_generate(t->tile_count_x, x_start, z_start, tiles_x, tiles_z, step, &t->indices[i]);
+                i += chunk->index_counts[lod];
+                chunk->lod_count++;
+            }
+        }
+    }
 
     return true;
 }
@@ -192,9 +295,28 @@ b8 terrain_load(terrain *t) {
 
     t->id = identifier_create();
 
-    if (!renderer_geometry_create(g, sizeof(terrain_vertex), t->vertex_count,
-                                  t->vertices, sizeof(u32), t->index_count,
-                                  t->indices)) {
+    if (t->vertex_pulling) {
+        // Only the grid coordinates of the patch are needed, everything else comes from the heightmap.
+        u32 patch_vertex_count = TERRAIN_PATCH_VERTEX_STRIDE * TERRAIN_PATCH_VERTEX_STRIDE;
+        vec2 *patch_vertices = kallocate(sizeof(vec2) * patch_vertex_count, MEMORY_TAG_ARRAY);
+        for (u32 z = 0, i = 0; z < TERRAIN_PATCH_VERTEX_STRIDE; ++z) {
+            for (u32 x = 0; x < TERRAIN_PATCH_VERTEX_STRIDE; ++x, ++i) {
+                patch_vertices[i] = (vec2){(f32)x, (f32)z};
+            }
+        }
+        b8 created = renderer_geometry_create(g, sizeof(vec2), patch_vertex_count, patch_vertices, sizeof(u32), t->index_count, t->indices);
+        kfree(patch_vertices, sizeof(vec2) * patch_vertex_count, MEMORY_TAG_ARRAY);
+        if (!created) {
+            return false;
+        }
+        if (!terrain_heightmap_create(t)) {
+            KERROR("Failed to create the heightmap texture of terrain '%s'.", t->name);
+            renderer_geometry_destroy(g);
+            return false;
+        }
+    } else if (!renderer_geometry_create(g, sizeof(terrain_vertex), t->vertex_count,
+                                         t->vertices, sizeof(u32), t->index_count,
+                                         t->indices)) {
         return false;
     }
     // Send the geometry off to the renderer to be uploaded to the GPU.
@@ -203,7 +325,7 @@ b8 terrain_load(terrain *t) {
     }
 
     // Copy over extents, center, etc.
-    g->center = t->origin;
+    g->center = vec3_mul_scalar(vec3_add(t->extents.min, t->extents.max), 0.5f);
     g->extents.min = t->extents.min;
     g->extents.max = t->extents.max;
     // TODO: offload generation increments to frontend. Also do this in geometry_system_create.
@@ -212,7 +334,16 @@ b8 terrain_load(terrain *t) {
     // Create a terrain material by copying the properties of these materials to a new terrain material.
     char terrain_material_name[MATERIAL_NAME_MAX_LENGTH] = {0};
     string_format(terrain_material_name, "terrain_mat_%s", t->name);
-    g->material = material_system_acquire_terrain_material(terrain_material_name, t->material_count, (const char **)t->material_names, true);
+    if (t->vertex_pulling) {
+        // The default terrain material can't draw from a heightmap, so there is nothing to fall back to.
+        g->material = material_system_acquire_heightmap_terrain_material(terrain_material_name, t->material_count, (const char **)t->material_names, t->heightmap, true);
+        if (!g->material) {
+            KERROR("Failed to acquire heightmap terrain material for terrain '%s'.", t->name);
+            return false;
+        }
+    } else {
+        g->material = material_system_acquire_terrain_material(terrain_material_name, t->material_count, (const char **)t->material_names, true);
+    }
     if (!g->material) {
         KWARN("Failed to acquire terrain material. Using defualt instead.");
         g->material = material_system_get_default_terrain();
@@ -224,6 +355,10 @@ b8 terrain_load(terrain *t) {
 b8 terrain_unload(terrain *t) {
     material_system_release(t->geo.material->name);
     renderer_geometry_destroy(&t->geo);
+    if (t->heightmap) {
+        texture_system_release(t->heightmap->name);
+        t->heightmap = 0;
+    }
 
     t->id.uniqueid = INVALID_ID_U64;
 
@@ -231,3 +366,89 @@ b8 terrain_unload(terrain *t) {
 }
 
 b8 terrain_update(terrain *t) { return true; }
+
+// Generates the indices of a chunk at the level of detail using every step-th vertex, of a grid of
+// vertices stride wide, returning their count.
+// If out_indices is 0, the indices are only counted. Cells away from the edges of the chunk are drawn as
+// two triangles, as the tiles of the full-resolution mesh are. Cells along the edges are drawn as a fan
+// about their center, taking in every vertex along the chunk's edges so that they match those of any
+// neighbour. Triangles are wound the same way as those of the full-resolution mesh.
+static u32 terrain_chunk_indices_generate(u32 stride, u32 x_start, u32 z_start, u32 tiles_x, u32 tiles_z, u32 step, u32 *out_indices) {
+    u32 count = 0;
+    u32 cells_x = tiles_x / step;
+    u32 cells_z = tiles_z / step;
+    for (u32 j = 0; j < cells_z; ++j) {
+        for (u32 i = 0; i < cells_x; ++i) {
+            u32 x = x_start + i * step;
+            u32 z = z_start + j * step;
+            b8 edges[4] = {j == 0, i == cells_x - 1, j == cells_z - 1, i == 0};
+            if (step == 1 || !(edges[0] || edges[1] || edges[2] || edges[3])) {
+                if (out_indices) {
+                    u32 v0 = (z * stride) + x;
+                    u32 v1 = (z * stride) + x + step;
+                    u32 v2 = ((z + step) * stride) + x;
+                    u32 v3 = ((z + step) * stride) + x + step;
+
+                    // v0, v1, v2, v2, v1, v3
+                    out_indices[count + 0] = v2;
+                    out_indices[count + 1] = v1;
+                    out_indices[count + 2] = v0;
+                    out_indices[count + 3] = v3;
+                    out_indices[count + 4] = v1;
+                    out_indices[count + 5] = v2;
+                }
+                count += 6;
+                continue;
+            }
+
+            // Walk the perimeter of the cell: along its near x edge, up its far z edge, then back.
+            u32 center = ((z + step / 2) * stride) + x + step / 2;
+            i32 directions[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+            u32 px = x;
+            u32 pz = z;
+            for (u32 e = 0; e < 4; ++e) {
+                u32 segment_length = edges[e] ? 1 : step;
+                for (u32 s = 0; s < step; s += segment_length) {
+                    u32 previous = (pz * stride) + px;
+                    px += directions[e][0] * (i32)segment_length;
+                    pz += directions[e][1] * (i32)segment_length;
+                    if (out_indices) {
+                        out_indices[count + 0] = (pz * stride) + px;
+                        out_indices[count + 1] = previous;
+                        out_indices[count + 2] = center;
+                    }
+                    count += 3;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Creates the heightmap texture of a vertex-pulled terrain, with each height encoded as a 24-bit
+// integer in the rgb channels as it is in heightmap images, so it is read back exactly.
+static b8 terrain_heightmap_create(terrain *t) {
+    char name[TEXTURE_NAME_MAX_LENGTH] = {0};
+    string_format(name, "terrain_heightmap_%s", t->name);
+    t->heightmap = texture_system_acquire_writeable(name, t->tile_count_x, t->tile_count_z, 4, false);
+    if (!t->heightmap) {
+        return false;
+    }
+
+    u32 size = t->vertex_count * 4;
+    u8 *pixels = kallocate(size, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < t->vertex_count; ++i) {
+        u32 height = (u32)(KCLAMP(t->vertex_datas[i].height, 0.0f, 1.0f) * 16777215.0f + 0.5f);
+        pixels[(i * 4) + 0] = (height >> 16) & 0xFF;
+        pixels[(i * 4) + 1] = (height >> 8) & 0xFF;
+        pixels[(i * 4) + 2] = height & 0xFF;
+        pixels[(i * 4) + 3] = 255;
+    }
+    b8 result = texture_system_write_data(t->heightmap, 0, size, pixels);
+    kfree(pixels, size, MEMORY_TAG_ARRAY);
+    if (!result) {
+        texture_system_release(t->heightmap->name);
+        t->heightmap = 0;
+    }
+    return result;
+}
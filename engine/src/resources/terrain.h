@@ -4,6 +4,7 @@
 #include "core/identifier.h"
 #include "defines.h"
 #include "math/math_types.h"
+#include "renderer/renderer_types.h"
 #include "resources/resource_types.h"
 
 /*
@@ -32,10 +33,69 @@ typedef struct terrain_vertex {
     f32 material_weights[TERRAIN_MAX_MATERIAL_COUNT];
 } terrain_vertex;
 
+/** @brief The number of tiles along each side of a terrain chunk. */
+#define TERRAIN_CHUNK_TILE_COUNT 16
+
+/**
+ * @brief The maximum number of levels of detail of a terrain chunk. Each level
+ * after the first uses every other vertex of the one before it.
+ */
+#define TERRAIN_CHUNK_LOD_COUNT 4
+
+/**
+ * @brief The first level of detail at which terrain chunks are shaded at 2x2, where variable rate
+ * shading is available. By then they are far enough away that the difference can't be seen.
+ */
+#define TERRAIN_CHUNK_COARSE_SHADING_LOD 2
+
+/**
+ * @brief A square section of a terrain, which is culled and drawn as a unit.
+ *
+ * Each level of detail of a chunk has its own contiguous range of the terrain's indices.
+ * Levels are stored one after another, each holding the chunks in row-major order, so
+ * neighbouring visible chunks in a row at the same level can be drawn together. Every level
+ * keeps the full-resolution vertices along the edges of the chunk, so neighbouring chunks
+ * meet without cracks whatever their levels.
+ */
+typedef struct terrain_chunk {
+    /** @brief The number of levels of detail of this chunk. Chunks along the far edges of a terrain may have fewer. */
+    u32 lod_count;
+    /** @brief The index of the first of the indices of each level, within those of the terrain. Unused when vertex pulling, as the ranges of the patch are drawn. */
+    u32 index_offsets[TERRAIN_CHUNK_LOD_COUNT];
+    /** @brief The number of indices of each level. */
+    u32 index_counts[TERRAIN_CHUNK_LOD_COUNT];
+    /** @brief The extents of the chunk, in the local space of the terrain. */
+    extents_3d extents;
+} terrain_chunk;
+
 typedef struct terrain_vertex_data {
     f32 height;
 } terrain_vertex_data;
 
+/**
+ * @brief A chunk of a vertex-pulled terrain, drawn as an instance of its patch.
+ * NOTE: Must match the instance attributes of Shader.Builtin.TerrainHeightmap.
+ */
+typedef struct terrain_patch_instance {
+    /** @brief The column and row of the first vertex of the chunk in x and y. z and w are unused. */
+    vec4 origin;
+    /** @brief The tile scale of the terrain along x in x and along z in z, and its height scale in y. w is unused. */
+    vec4 scale;
+} terrain_patch_instance;
+
+/**
+ * @brief A single draw of the patch of a vertex-pulled terrain at one level of detail, as a run of
+ * instances, one per visible chunk at that level.
+ */
+typedef struct terrain_patch_batch {
+    /** @brief The patch geometry and the terrain's material and transform, with the index range of the level of detail. */
+    geometry_render_data data;
+    /** @brief The index of the first instance of the batch. */
+    u32 first_instance;
+    /** @brief The number of instances of the batch. */
+    u32 instance_count;
+} terrain_patch_batch;
+
 typedef struct terrain_config {
     char *name;
     u32 tile_count_x;
@@ -54,6 +114,12 @@ typedef struct terrain_config {
 
     u32 material_count;
     char **material_names;
+
+    /**
+     * @brief If true, the terrain is drawn by pulling its vertices from a heightmap texture in the
+     * vertex shader, rather than from vertices built on the CPU. See terrain.vertex_pulling.
+     */
+    b8 vertex_pulling;
 } terrain_config;
 
 typedef struct terrain {
@@ -75,12 +141,37 @@ typedef struct terrain {
     extents_3d extents;
     vec3 origin;
 
+    /**
+     * @brief If true, only the heights are kept, in vertex_datas and in the heightmap texture. The
+     * terrain is drawn as instances of a single patch the size of a chunk, whose vertices are placed,
+     * lit and weighted by the vertex shader from the heightmap. Edge chunks with fewer tiles clamp
+     * the excess vertices of the patch to the edge of the terrain. vertices is then 0, and indices
+     * holds those of the patch.
+     */
+    b8 vertex_pulling;
+
     u32 vertex_count;
     terrain_vertex *vertices;
 
     u32 index_count;
     u32 *indices;
 
+    // When vertex pulling, the range of the patch's indices of each level of detail.
+    u32 patch_index_offsets[TERRAIN_CHUNK_LOD_COUNT];
+    u32 patch_index_counts[TERRAIN_CHUNK_LOD_COUNT];
+    // When vertex pulling, the heights of the terrain encoded as 24-bit integers in the rgb channels. 0 until loaded.
+    texture *heightmap;
+
+    // The number of chunks along the x and z axes.
+    u32 chunk_count_x;
+    u32 chunk_count_z;
+    // The chunks of the terrain, chunk_count_x * chunk_count_z in row-major order.
+    u32 chunk_count;
+    terrain_chunk *chunks;
+    // The distance within which chunks are drawn at full detail. Each level of detail after the first
+    // covers twice the distance of the one before it.
+    f32 lod_distance;
+
     geometry geo;
 
     u32 material_count;
@@ -1,9 +1,23 @@
 #include "audio_system.h"
 
 #include "audio/audio_types.h"
+#include "containers/darray.h"
+#include "containers/loose_tree.h"
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/kname.h"
 #include "core/logger.h"
 #include "core/systems_manager.h"
 #include "defines.h"
+#include "math/kmath.h"
+#include "utils/ksort.h"
+
+// Half the size of the space covered by the emitter tree. Emitters outside of it are still found, just less quickly.
+#define AUDIO_EMITTER_TREE_HALF_SIZE 1024.0f
+// Gives smallest cells of 32 units, about the size of a typical emitter's range.
+#define AUDIO_EMITTER_TREE_DEPTH 6
+// Emitters any quieter than this at the listener are not worth a voice.
+#define AUDIO_EMITTER_AUDIBLE_THRESHOLD 0.001f
 
 typedef struct audio_channel {
     f32 volume;
@@ -14,13 +28,58 @@ typedef struct audio_channel {
 
 } audio_channel;
 
+// A sound chunk shared by everything which loads it.
+typedef struct audio_bank_entry {
+    // The name the chunk was loaded with, or INVALID_KNAME if the slot is free.
+    kname name;
+    // The loaded file, or 0 while it is being preloaded.
+    audio_file* file;
+    // The number of loads and preloads holding the chunk.
+    u32 reference_count;
+} audio_bank_entry;
+
+// An emitter being played by audio_system_emitter_play.
+typedef struct audio_emitter_instance {
+    // The emitter being played, or 0 if the slot is free.
+    audio_emitter* emitter;
+    // The handle of the emitter's range in the emitter tree.
+    u32 tree_handle;
+    // The channel the emitter is being played through, or -1 while it is virtual.
+    i8 channel_id;
+    // How far into the file playback is. Kept going while virtual, so the emitter picks up where it should be.
+    f64 playback_seconds;
+} audio_emitter_instance;
+
+// An emitter within range of the listener, as ranked for a voice.
+typedef struct audio_emitter_rank {
+    u32 instance_id;
+    u8 priority;
+    // How loud the emitter is at the listener.
+    f32 audibility;
+} audio_emitter_rank;
+
 typedef struct audio_system_state {
     audio_system_config config;
     audio_plugin plugin;
     f32 master_volume;
     audio_channel channels[MAX_AUDIO_CHANNELS];
+
+    // darray of loaded sound chunks.
+    audio_bank_entry* bank;
+
+    // The most emitters which may have real voices at once.
+    u32 max_voices;
+    // darray of the emitters being played. An emitter's instance_id indexes this.
+    audio_emitter_instance* emitters;
+    // The range of every emitter being played, so those reaching the listener can be found quickly.
+    loose_tree emitter_tree;
+    // darray of the emitters within range of the listener. Kept between frames to avoid reallocating it.
+    audio_emitter_rank* audible;
 } audio_system_state;
 
+static void emitters_update(audio_system_state* state, f32 delta_time);
+static void emitter_instance_stop(audio_system_state* state, u32 instance_id);
+
 b8 audio_system_initialize(u64* memory_requirement, void* state, void* config) {
     if (!memory_requirement || !config) {
         KERROR("Audio system initialization requires valid pointers to memory_requirement and config.");
@@ -53,32 +112,72 @@ b8 audio_system_initialize(u64* memory_requirement, void* state, void* config) {
 
     typed_state->plugin = typed_config->plugin;
 
+    typed_state->max_voices = typed_config->max_voices ? typed_config->max_voices : typed_state->config.audio_channel_count / 2;
+    typed_state->max_voices = KMIN(typed_state->max_voices, typed_state->config.audio_channel_count);
+    typed_state->emitters = darray_create(audio_emitter_instance);
+    typed_state->audible = darray_create(audio_emitter_rank);
+    typed_state->bank = darray_create(audio_bank_entry);
+    if (!loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), AUDIO_EMITTER_TREE_HALF_SIZE, AUDIO_EMITTER_TREE_DEPTH, &typed_state->emitter_tree)) {
+        KERROR("Failed to create audio emitter tree.");
+        return false;
+    }
+
     audio_plugin_config plugin_config = {0};
     plugin_config.max_sources = typed_config->audio_channel_count;  // MAX_AUDIO_CHANNELS;
     plugin_config.max_buffers = 256;
     plugin_config.chunk_size = typed_config->chunk_size;
     plugin_config.frequency = typed_config->frequency;
     plugin_config.channel_count = typed_config->channel_count;
+    plugin_config.compress_chunks = typed_config->compress_sound_effects;
     return typed_state->plugin.initialize(&typed_state->plugin, plugin_config);
 }
 
 void audio_system_shutdown(void* state) {
     if (state) {
         audio_system_state* typed_state = (audio_system_state*)state;
+
+        // Anything still held is closed regardless.
+        if (typed_state->bank) {
+            u32 bank_count = darray_length(typed_state->bank);
+            for (u32 i = 0; i < bank_count; ++i) {
+                if (typed_state->bank[i].file) {
+                    typed_state->plugin.audio_unload(&typed_state->plugin, typed_state->bank[i].file);
+                }
+            }
+            darray_destroy(typed_state->bank);
+            typed_state->bank = 0;
+        }
+
         typed_state->plugin.shutdown(&typed_state->plugin);
+
+        loose_tree_destroy(&typed_state->emitter_tree);
+        if (typed_state->emitters) {
+            darray_destroy(typed_state->emitters);
+            typed_state->emitters = 0;
+        }
+        if (typed_state->audible) {
+            darray_destroy(typed_state->audible);
+            typed_state->audible = 0;
+        }
     }
 }
 
+static void channel_emitter_sync(audio_system_state* state, u32 channel_id) {
+    audio_channel* channel = &state->channels[channel_id];
+    // TODO: sync all properties
+    state->plugin.source_position_set(&state->plugin, channel_id, channel->emitter->position);
+    state->plugin.source_looping_set(&state->plugin, channel_id, channel->emitter->looping);
+    state->plugin.source_gain_set(&state->plugin, channel_id, state->master_volume * channel->volume * channel->emitter->volume);
+}
+
 b8 audio_system_update(void* state, struct frame_data* p_frame_data) {
     audio_system_state* typed_state = (audio_system_state*)state;
 
+    emitters_update(typed_state, p_frame_data->delta_time);
+
     for (u32 i = 0; i < typed_state->config.audio_channel_count; ++i) {
-        audio_channel* channel = &typed_state->channels[i];
-        if (channel->emitter) {
-            // TODO: sync all properties
-            typed_state->plugin.source_position_set(&typed_state->plugin, i, channel->emitter->position);
-            typed_state->plugin.source_looping_set(&typed_state->plugin, i, channel->emitter->looping);
-            typed_state->plugin.source_gain_set(&typed_state->plugin, i, typed_state->master_volume * typed_state->channels[i].volume * channel->emitter->volume);
+        if (typed_state->channels[i].emitter) {
+            channel_emitter_sync(typed_state, i);
         }
     }
 
@@ -92,9 +191,102 @@ b8 audio_system_listener_orientation_set(vec3 position, vec3 forward, vec3 up) {
     return true;
 }
 
+static audio_bank_entry* bank_entry_get(audio_system_state* state, kname name) {
+    u32 count = darray_length(state->bank);
+    for (u32 i = 0; i < count; ++i) {
+        if (state->bank[i].name == name) {
+            return &state->bank[i];
+        }
+    }
+    return 0;
+}
+
+static audio_bank_entry* bank_entry_add(audio_system_state* state, kname name) {
+    audio_bank_entry entry = {0};
+    entry.name = name;
+    u32 count = darray_length(state->bank);
+    for (u32 i = 0; i < count; ++i) {
+        if (state->bank[i].name == INVALID_KNAME) {
+            state->bank[i] = entry;
+            return &state->bank[i];
+        }
+    }
+    darray_push(state->bank, entry);
+    return &state->bank[count];
+}
+
+static void bank_entry_release(audio_system_state* state, audio_bank_entry* entry) {
+    entry->reference_count--;
+    if (entry->reference_count == 0) {
+        if (entry->file) {
+            state->plugin.audio_unload(&state->plugin, entry->file);
+        }
+        // A preload still in flight finds the entry gone and closes what it loaded.
+        kzero_memory(entry, sizeof(audio_bank_entry));
+        entry->name = INVALID_KNAME;
+    }
+}
+
 struct audio_file* audio_system_chunk_load(const char* path) {
     audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
-    return state->plugin.chunk_load(&state->plugin, path);
+    kname name = kname_create(path);
+    audio_bank_entry* entry = bank_entry_get(state, name);
+    if (entry && entry->file) {
+        entry->reference_count++;
+        return entry->file;
+    }
+
+    // Not loaded yet, or still being preloaded, in which case the preload is not waited on.
+    audio_file* file = state->plugin.chunk_load(&state->plugin, path);
+    if (!file) {
+        return 0;
+    }
+    if (!entry) {
+        entry = bank_entry_add(state, name);
+    }
+    entry->file = file;
+    entry->reference_count++;
+    return file;
+}
+
+static void chunk_preloaded(const char* path, struct audio_file* file, void* listener) {
+    audio_system_state* state = listener;
+    audio_bank_entry* entry = bank_entry_get(state, kname_create(path));
+    if (!file) {
+        KERROR("Failed to preload sound '%s'.", path);
+        return;
+    }
+    if (!entry || entry->file) {
+        // Released before it finished, or loaded by other means in the meantime.
+        state->plugin.audio_unload(&state->plugin, file);
+        return;
+    }
+    entry->file = file;
+}
+
+b8 audio_system_chunk_preload(const char* path) {
+    audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
+    kname name = kname_create(path);
+    audio_bank_entry* entry = bank_entry_get(state, name);
+    if (entry) {
+        entry->reference_count++;
+        return true;
+    }
+
+    if (!state->plugin.chunk_load_async(&state->plugin, path, chunk_preloaded, state)) {
+        return false;
+    }
+    entry = bank_entry_add(state, name);
+    entry->reference_count = 1;
+    return true;
+}
+
+void audio_system_chunk_release(const char* path) {
+    audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
+    audio_bank_entry* entry = bank_entry_get(state, kname_create(path));
+    if (entry) {
+        bank_entry_release(state, entry);
+    }
 }
 
 struct audio_file* audio_system_stream_load(const char* path) {
@@ -104,6 +296,15 @@ struct audio_file* audio_system_stream_load(const char* path) {
 
 void audio_system_close(struct audio_file* file) {
     audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
+    u32 count = darray_length(state->bank);
+    for (u32 i = 0; i < count; ++i) {
+        if (state->bank[i].file == file) {
+            bank_entry_release(state, &state->bank[i]);
+            return;
+        }
+    }
+
+    // Streams are never shared.
     state->plugin.audio_unload(&state->plugin, file);
 }
 
@@ -272,3 +473,226 @@ void audio_system_channel_resume(i8 channel_id) {
         state->plugin.source_resume(&state->plugin, channel_id);
     }
 }
+
+static f32 emitter_max_distance(const audio_emitter* emitter) {
+    return emitter->max_distance > 0.0f ? emitter->max_distance : AUDIO_EMITTER_DEFAULT_MAX_DISTANCE;
+}
+
+static extents_3d emitter_bounds(const audio_emitter* emitter) {
+    f32 range = emitter_max_distance(emitter);
+    vec3 half_extents = vec3_create(range, range, range);
+    extents_3d bounds;
+    bounds.min = vec3_sub(emitter->position, half_extents);
+    bounds.max = vec3_add(emitter->position, half_extents);
+    return bounds;
+}
+
+static f64 audio_file_length_seconds(const audio_file* file) {
+    if (!file->channels || !file->sample_rate) {
+        return 0;
+    }
+    return (f64)file->total_samples / file->channels / file->sample_rate;
+}
+
+typedef struct emitter_query_context {
+    audio_system_state* state;
+    vec3 listener_position;
+} emitter_query_context;
+
+static b8 emitter_found(u32 handle, u64 user_data, void* context) {
+    emitter_query_context* query = context;
+    audio_system_state* state = query->state;
+    audio_emitter* emitter = state->emitters[user_data].emitter;
+
+    // The tree only narrows it down to those whose range might reach the listener.
+    f32 distance = vec3_distance(emitter->position, query->listener_position);
+    if (distance > emitter_max_distance(emitter)) {
+        return true;
+    }
+
+    // Estimated the same way OpenAL attenuates by default, with a reference distance of 1.
+    f32 falloff = emitter->falloff > 0.0f ? emitter->falloff : 1.0f;
+    f32 attenuation = 1.0f / (1.0f + falloff * (KMAX(distance, 1.0f) - 1.0f));
+    audio_emitter_rank rank = {0};
+    rank.instance_id = (u32)user_data;
+    rank.priority = emitter->priority;
+    rank.audibility = emitter->volume * attenuation;
+    if (rank.audibility > AUDIO_EMITTER_AUDIBLE_THRESHOLD) {
+        darray_push(state->audible, rank);
+    }
+    return true;
+}
+
+// Highest priority first, then loudest first.
+static i32 emitter_rank_compare(void* a, void* b) {
+    audio_emitter_rank* x = a;
+    audio_emitter_rank* y = b;
+    if (x->priority != y->priority) {
+        return (i32)y->priority - (i32)x->priority;
+    }
+    return (y->audibility > x->audibility) - (y->audibility < x->audibility);
+}
+
+static void emitter_voice_release(audio_system_state* state, audio_emitter_instance* instance) {
+    if (instance->channel_id >= 0) {
+        audio_channel* channel = &state->channels[instance->channel_id];
+        if (channel->emitter == instance->emitter) {
+            state->plugin.source_stop(&state->plugin, instance->channel_id);
+            channel->emitter = 0;
+            channel->current = 0;
+        }
+        instance->channel_id = -1;
+    }
+}
+
+static void emitters_update(audio_system_state* state, f32 delta_time) {
+    u32 count = darray_length(state->emitters);
+    if (!count) {
+        return;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        audio_emitter_instance* instance = &state->emitters[i];
+        if (!instance->emitter) {
+            continue;
+        }
+
+        // Keep time whether the emitter is heard or not.
+        f64 length = audio_file_length_seconds(instance->emitter->file);
+        instance->playback_seconds += delta_time;
+        if (length > 0 && instance->playback_seconds >= length) {
+            if (!instance->emitter->looping) {
+                emitter_instance_stop(state, i);
+                continue;
+            }
+            instance->playback_seconds -= length * kfloor(instance->playback_seconds / length);
+        }
+
+        // A sound played on the channel directly takes the voice away.
+        if (instance->channel_id >= 0 && state->channels[instance->channel_id].emitter != instance->emitter) {
+            instance->channel_id = -1;
+        }
+
+        loose_tree_move(&state->emitter_tree, instance->tree_handle, emitter_bounds(instance->emitter));
+    }
+
+    // Rank the emitters whose range reaches the listener.
+    emitter_query_context query = {0};
+    query.state = state;
+    state->plugin.listener_position_query(&state->plugin, &query.listener_position);
+    darray_length_set(state->audible, 0);
+    loose_tree_query_sphere(&state->emitter_tree, query.listener_position, 0.0f, emitter_found, &query);
+    u32 audible_count = darray_length(state->audible);
+    if (audible_count > 1) {
+        kquick_sort(sizeof(audio_emitter_rank), state->audible, 0, audible_count - 1, emitter_rank_compare);
+    }
+    u32 voiced_count = KMIN(audible_count, state->max_voices);
+
+    // Emitters which no longer rank highly enough become virtual, freeing their voices first.
+    for (u32 i = 0; i < count; ++i) {
+        audio_emitter_instance* instance = &state->emitters[i];
+        if (!instance->emitter || instance->channel_id < 0) {
+            continue;
+        }
+        b8 voiced = false;
+        for (u32 r = 0; r < voiced_count; ++r) {
+            if (state->audible[r].instance_id == i) {
+                voiced = true;
+                break;
+            }
+        }
+        if (!voiced) {
+            emitter_voice_release(state, instance);
+        }
+    }
+
+    // Those that do rank highly enough get voices, starting from where they would be by now.
+    for (u32 r = 0; r < voiced_count; ++r) {
+        audio_emitter_instance* instance = &state->emitters[state->audible[r].instance_id];
+        if (instance->channel_id >= 0) {
+            continue;
+        }
+
+        i8 channel_id = -1;
+        for (u32 c = 0; c < state->config.audio_channel_count; ++c) {
+            if (!state->channels[c].current && !state->channels[c].emitter) {
+                channel_id = c;
+                break;
+            }
+        }
+        if (channel_id == -1) {
+            // Every channel is in use. This stays virtual until one frees up.
+            break;
+        }
+
+        audio_channel* channel = &state->channels[channel_id];
+        channel->emitter = instance->emitter;
+        channel->current = instance->emitter->file;
+        instance->channel_id = channel_id;
+        channel_emitter_sync(state, channel_id);
+        state->plugin.source_stop(&state->plugin, channel_id);
+        state->plugin.play_on_source_at(&state->plugin, instance->emitter->file, channel_id, (f32)instance->playback_seconds);
+    }
+}
+
+static void emitter_instance_stop(audio_system_state* state, u32 instance_id) {
+    audio_emitter_instance* instance = &state->emitters[instance_id];
+    emitter_voice_release(state, instance);
+    loose_tree_remove(&state->emitter_tree, instance->tree_handle);
+    instance->emitter->instance_id = INVALID_ID;
+    kzero_memory(instance, sizeof(audio_emitter_instance));
+    instance->channel_id = -1;
+}
+
+b8 audio_system_emitter_play(struct audio_emitter* emitter) {
+    if (!emitter || !emitter->file) {
+        return false;
+    }
+
+    audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
+    u32 count = darray_length(state->emitters);
+    if (emitter->instance_id < count && state->emitters[emitter->instance_id].emitter == emitter) {
+        // Already playing, so start over. Any voice is picked back up on the next update.
+        audio_emitter_instance* instance = &state->emitters[emitter->instance_id];
+        emitter_voice_release(state, instance);
+        instance->playback_seconds = 0;
+        return true;
+    }
+
+    u32 instance_id = count;
+    for (u32 i = 0; i < count; ++i) {
+        if (!state->emitters[i].emitter) {
+            instance_id = i;
+            break;
+        }
+    }
+
+    audio_emitter_instance instance = {0};
+    instance.emitter = emitter;
+    instance.channel_id = -1;
+    instance.tree_handle = loose_tree_insert(&state->emitter_tree, emitter_bounds(emitter), instance_id);
+    if (instance.tree_handle == INVALID_ID) {
+        KERROR("Failed to add emitter to the emitter tree.");
+        return false;
+    }
+
+    // Starts virtual. The next update gives it a voice if it ranks highly enough.
+    if (instance_id == count) {
+        darray_push(state->emitters, instance);
+    } else {
+        state->emitters[instance_id] = instance;
+    }
+    emitter->instance_id = instance_id;
+    return true;
+}
+
+void audio_system_emitter_stop(struct audio_emitter* emitter) {
+    if (!emitter) {
+        return;
+    }
+
+    audio_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_AUDIO);
+    if (emitter->instance_id < darray_length(state->emitters) && state->emitters[emitter->instance_id].emitter == emitter) {
+        emitter_instance_stop(state, emitter->instance_id);
+    }
+}
@@ -32,6 +32,19 @@ typedef struct audio_system_config {
      * can have its volume independently controlled. Not to be confused with channel_count above.
      */
     u32 audio_channel_count;
+
+    /**
+     * @brief The most emitters played through real voices (channels) at once. The rest of the emitters
+     * being played are virtual: they keep their place, but are not heard or decoded. 0 defaults to half
+     * of audio_channel_count.
+     */
+    u32 max_voices;
+
+    /**
+     * @brief Indicates if sound effects are kept IMA ADPCM compressed in memory, at about a quarter of the size,
+     * where the audio plugin supports it. Costs some quality.
+     */
+    b8 compress_sound_effects;
 } audio_system_config;
 
 /**
@@ -69,13 +82,30 @@ KAPI b8 audio_system_listener_orientation_set(vec3 position, vec3 forward, vec3
 
 /**
  * @brief Attempts to load a sound chunk at the given path. Returns a pointer
- * to a loaded sound. This dynamically allocates memory, so make sure to
+ * to a loaded sound. Sounds are shared: loading one which is already loaded or
+ * preloaded returns the same file without decoding it again. Make sure to
  * call audio_system_close() on it when done.
  * @param path The full path to the asset to be loaded.
  * @return A pointer to an audio_sound one success; otherwise null/0.
  */
 KAPI struct audio_file* audio_system_chunk_load(const char* path);
 
+/**
+ * @brief Starts loading a sound chunk in the background, so that a later audio_system_chunk_load()
+ * of it does not have to decode it. The preload holds a reference of its own, which keeps the
+ * sound loaded until released with audio_system_chunk_release().
+ * @param path The full path to the asset to be loaded.
+ * @return True if the sound is loaded or loading was started; otherwise false.
+ */
+KAPI b8 audio_system_chunk_preload(const char* path);
+
+/**
+ * @brief Releases the reference held by audio_system_chunk_preload(). The sound is closed once
+ * nothing else holds one.
+ * @param path The full path the asset was preloaded with.
+ */
+KAPI void audio_system_chunk_release(const char* path);
+
 /**
  * @brief Attempts to load a audio stream file at the given path. Returns a pointer
  * to a loaded music. This dynamically allocates memory, so make sure to
@@ -86,7 +116,8 @@ KAPI struct audio_file* audio_system_chunk_load(const char* path);
 KAPI struct audio_file* audio_system_stream_load(const char* path);
 
 /**
- * @brief Closes the given sound, releasing all internal resources.
+ * @brief Closes the given sound, releasing all internal resources. Shared sound
+ * chunks are only released once the last reference to them is closed.
  * @param file A pointer to the sound file to be closed.
  */
 KAPI void audio_system_close(struct audio_file* file);
@@ -142,6 +173,22 @@ KAPI b8 audio_system_channel_play(i8 channel_id, struct audio_file* file, b8 loo
  */
 KAPI b8 audio_system_channel_emitter_play(i8 channel_id, struct audio_emitter* emitter);
 
+/**
+ * @brief Plays an emitter with a voice managed by the audio system. Every frame, the emitters being played
+ * are ranked by priority and then by how loud they are at the listener, and only the top max_voices get
+ * real voices. The others, including any out of range, are virtual until they rank highly enough again.
+ * The emitter is read each frame until stopped, so must stay valid and should be updated directly.
+ * @param emitter A pointer to an emitter to be played. Its file is required.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 audio_system_emitter_play(struct audio_emitter* emitter);
+
+/**
+ * @brief Stops an emitter played with audio_system_emitter_play, releasing its voice if it has one.
+ * @param emitter A pointer to the emitter to be stopped.
+ */
+KAPI void audio_system_emitter_stop(struct audio_emitter* emitter);
+
 /**
  * Stops the given channel id.
  * @param channel_id The id of the channel to be stopped. If -1 is passed, all channels are stopped.
@@ -1,12 +1,15 @@
 #include "font_system.h"
 
 #include "containers/darray.h"
+#include "containers/hashmap.h"
 #include "containers/hashtable.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "math/kmath.h"
 #include "renderer/renderer_frontend.h"
 #include "resources/resource_types.h"
+#include "systems/job_system.h"
 #include "systems/resource_system.h"
 #include "systems/texture_system.h"
 
@@ -20,12 +23,92 @@ typedef struct bitmap_font_internal_data {
     bitmap_font_resource_data* resource_data;
 } bitmap_font_internal_data;
 
+// Packs glyphs in rows across a single-channel copy of an atlas, from the top down. Glyphs
+// never move once placed, except that growing the atlas changes its height.
+typedef struct glyph_atlas_packer {
+    u8* pixels;
+    u32 width;
+    u32 height;
+    // The height the atlas may grow to, doubling each time.
+    u32 max_height;
+    // The position of the next glyph, and the height of the current row.
+    u32 pen_x;
+    u32 pen_y;
+    u32 row_height;
+    // The rectangle placed into since the atlas was last uploaded. Empty if max_x is 0.
+    u32 dirty_min_x;
+    u32 dirty_min_y;
+    u32 dirty_max_x;
+    u32 dirty_max_y;
+    // Indicates the whole atlas must be uploaded, as it is new or has grown.
+    b8 needs_full_upload;
+} glyph_atlas_packer;
+
+// The width of system font atlases, along with the height they start at and may grow to.
+#define SYSTEM_FONT_ATLAS_WIDTH 1024
+#define SYSTEM_FONT_ATLAS_INITIAL_HEIGHT 256
+#define SYSTEM_FONT_ATLAS_MAX_HEIGHT 4096
+
 typedef struct system_font_variant_data {
     // darray
     i32* codepoints;
     f32 scale;
+    glyph_atlas_packer packer;
 } system_font_variant_data;
 
+// The pixel height SDF glyphs are generated at. Every size of an SDF font is drawn by scaling these.
+#define SDF_GLYPH_SIZE 32
+// How far in pixels the distance field extends beyond the outline of each glyph.
+#define SDF_GLYPH_PADDING 4
+// The value of the distance field on the outline of a glyph.
+#define SDF_ONEDGE_VALUE 128
+// The width of the SDF atlas of each font face, along with the height it starts at and may grow to.
+#define SDF_ATLAS_WIDTH 2048
+#define SDF_ATLAS_INITIAL_HEIGHT 512
+#define SDF_ATLAS_MAX_HEIGHT 4096
+
+// A signed distance field atlas, shared by every SDF size variant of a font face. Glyphs are
+// added as text needs them, and are never regenerated.
+typedef struct system_font_sdf_atlas {
+    texture* texture;
+    glyph_atlas_packer packer;
+    // darray of glyphs, with metrics in SDF_GLYPH_SIZE pixels.
+    font_glyph* glyphs;
+    // darray of kernings between the glyphs, in SDF_GLYPH_SIZE pixels.
+    font_kerning* kernings;
+    // The scale from font units to SDF_GLYPH_SIZE pixels.
+    f32 scale;
+    // darray of the size variants drawn from the atlas. Each is allocated on its own, so
+    // pointers returned by font_system_acquire stay valid as more are created.
+    font_data** variants;
+} system_font_sdf_atlas;
+
+// A glyph generated by a job, waiting to be packed into an SDF atlas.
+typedef struct sdf_glyph_bitmap {
+    i32 codepoint;
+    // Allocated by stb_truetype, and freed once packed. 0 for glyphs with no outline, such as spaces.
+    u8* pixels;
+    i32 width;
+    i32 height;
+    i32 x_offset;
+    i32 y_offset;
+    i32 x_advance;
+} sdf_glyph_bitmap;
+
+typedef struct sdf_generate_context {
+    const stbtt_fontinfo* info;
+    f32 scale;
+    sdf_glyph_bitmap* glyphs;
+} sdf_generate_context;
+
+typedef struct glyph_rasterize_context {
+    const stbtt_fontinfo* info;
+    f32 scale;
+    glyph_atlas_packer* packer;
+    // The glyphs to be rasterized, already placed in the atlas.
+    const font_glyph* glyphs;
+} glyph_rasterize_context;
+
 typedef struct bitmap_font_lookup {
     u16 id;
     u16 reference_count;
@@ -43,9 +126,55 @@ typedef struct system_font_lookup {
     void* font_binary;
     i32 offset;
     i32 index;
+    // info and offset are only set up the first time a variant is acquired, so faces of a
+    // collection which are never used never touch their pages of the mapped binary.
+    b8 is_initialized;
     stbtt_fontinfo info;
+    // The SDF atlas of this face, created the first time an SDF variant is acquired.
+    system_font_sdf_atlas* sdf_atlas;
 } system_font_lookup;
 
+// Glyphs of codepoints below this are found by indexing into a table, and the rest by hash.
+#define FONT_GLYPH_TABLE_SIZE 256
+
+// The measurement cache is split into sets by the hash of the text, each holding a few of the
+// most recently used measurements.
+#define FONT_MEASURE_CACHE_SET_COUNT 64
+#define FONT_MEASURE_CACHE_SET_SIZE 4
+// Only text shorter than this is cached, as a copy is kept to tell apart texts of the same hash.
+#define FONT_MEASURE_CACHE_TEXT_MAX 64
+
+// Lookups of the glyphs and kernings of a font_data. Built from the arrays and counts held here,
+// so rebuilt when any of these change.
+typedef struct font_lookup {
+    const font_glyph* glyphs;
+    u32 glyph_count;
+    const font_kerning* kernings;
+    u32 kerning_count;
+    // The index of the glyph of each codepoint below FONT_GLYPH_TABLE_SIZE, or INVALID_ID if there is none.
+    u32 table[FONT_GLYPH_TABLE_SIZE];
+    // The indices of the glyphs of the remaining codepoints, keyed by codepoint.
+    hashmap glyph_map;
+    u64 glyph_map_memory_requirement;
+    void* glyph_map_memory;
+    // Kerning amounts (i32), keyed by both codepoints of the pair.
+    hashmap kerning_map;
+    u64 kerning_map_memory_requirement;
+    void* kerning_map_memory;
+} font_lookup;
+
+// A measured string. The font lookup identifies the font, as font_data may be moved.
+typedef struct font_measure_entry {
+    const font_lookup* lookup;
+    u32 glyph_count;
+    u32 kerning_count;
+    u64 hash;
+    // The "time" the entry was last used. 0 for an empty entry.
+    u64 last_used;
+    vec2 extents;
+    char text[FONT_MEASURE_CACHE_TEXT_MAX];
+} font_measure_entry;
+
 typedef struct font_system_state {
     font_system_config config;
     hashtable bitmap_font_lookup;
@@ -54,13 +183,25 @@ typedef struct font_system_state {
     system_font_lookup* system_fonts;
     void* bitmap_hashtable_block;
     void* system_hashtable_block;
+    // darray of the loaded system font resources, which hold the mapped binaries of their faces.
+    resource* system_font_resources;
+    // Recently measured strings.
+    font_measure_entry measure_cache[FONT_MEASURE_CACHE_SET_COUNT][FONT_MEASURE_CACHE_SET_SIZE];
+    u64 measure_time;
 } font_system_state;
 
 static b8 setup_font_data(font_data* font);
 static void cleanup_font_data(font_data* font);
+static font_lookup* font_lookup_get(font_data* font);
+static void font_lookup_destroy(font_data* font);
+static vec2 measure_string(font_data* font, const char* text);
+static b8 system_font_lookup_initialize(system_font_lookup* lookup);
 static b8 create_system_font_variant(system_font_lookup* lookup, u16 size, const char* font_name, font_data* out_variant);
-static b8 rebuild_system_font_variant_atlas(system_font_lookup* lookup, font_data* variant);
+static b8 add_system_font_variant_glyphs(system_font_lookup* lookup, font_data* variant, u32 first_codepoint);
 static b8 verify_system_font_size_variant(system_font_lookup* lookup, font_data* variant, const char* text);
+static font_data* acquire_system_font_sdf_variant(system_font_lookup* lookup, u16 size);
+static b8 verify_system_font_sdf_atlas(system_font_lookup* lookup, const char* text);
+static void destroy_system_font_sdf_atlas(system_font_lookup* lookup);
 
 static font_system_state* state_ptr;
 
@@ -117,6 +258,7 @@ b8 font_system_initialize(u64* memory_requirement, void* memory, void* config) {
         state_ptr->system_fonts[i].id = INVALID_ID_U16;
         state_ptr->system_fonts[i].reference_count = 0;
     }
+    state_ptr->system_font_resources = darray_create(resource);
 
     // Load up any default fonts.
     // Bitmap fonts.
@@ -154,20 +296,40 @@ void font_system_shutdown(void* memory) {
                 for (u32 j = 0; j < variant_count; ++j) {
                     font_data* data = &state_ptr->system_fonts[i].size_variants[j];
                     cleanup_font_data(data);
+                    system_font_variant_data* internal_data = data->internal_data;
+                    if (internal_data) {
+                        darray_destroy(internal_data->codepoints);
+                        kfree(internal_data->packer.pixels, internal_data->packer.width * internal_data->packer.height, MEMORY_TAG_ARRAY);
+                        kfree(internal_data, data->internal_data_size, MEMORY_TAG_SYSTEM_FONT);
+                        data->internal_data = 0;
+                    }
                 }
                 state_ptr->bitmap_fonts[i].id = INVALID_ID_U16;
 
+                destroy_system_font_sdf_atlas(&state_ptr->system_fonts[i]);
+
                 darray_destroy(state_ptr->system_fonts[i].size_variants);
                 state_ptr->system_fonts[i].size_variants = 0;
             }
         }
+
+        // Release the binaries of the system fonts, now that no face refers to them.
+        if (state_ptr->system_font_resources) {
+            u32 resource_count = darray_length(state_ptr->system_font_resources);
+            for (u32 i = 0; i < resource_count; ++i) {
+                resource_system_unload(&state_ptr->system_font_resources[i]);
+            }
+            darray_destroy(state_ptr->system_font_resources);
+            state_ptr->system_font_resources = 0;
+        }
     }
 }
 
 b8 font_system_system_font_load(system_font_config* config) {
     // For system fonts, they can actually contain multiple fonts. For this reason,
-    // a copy of the resource's data will be held in each resulting variant, and the
-    // resource itself will be released.
+    // a copy of the resource's data will be held in each resulting lookup, and the
+    // resource itself is kept until shutdown. The binary is mapped, and each face is
+    // only set up, and its size variants created, when first acquired.
     resource loaded_resource;
     if (!resource_system_load(config->resource_name, RESOURCE_TYPE_SYSTEM_FONT, 0, &loaded_resource)) {
         KERROR("Failed to load system font.");
@@ -180,6 +342,7 @@ b8 font_system_system_font_load(system_font_config* config) {
     // Loop through the faces and create one lookup for each, as well as a default size
     // variant for each lookup.
     u32 font_face_count = darray_length(resource_data->fonts);
+    u32 registered_count = 0;
     for (u32 i = 0; i < font_face_count; ++i) {
         system_font_face* face = &resource_data->fonts[i];
 
@@ -190,9 +353,9 @@ b8 font_system_system_font_load(system_font_config* config) {
             return false;
         }
         if (id != INVALID_ID_U16) {
-            KWARN("A font named '%s' already exists and will not be loaded again.", config->name);
-            // Not a hard error, return success since it already exists and can be used.
-            return true;
+            KWARN("A font named '%s' already exists and will not be loaded again.", face->name);
+            // Not a hard error, since it already exists and can be used.
+            continue;
         }
 
         // Get a new id
@@ -213,40 +376,24 @@ b8 font_system_system_font_load(system_font_config* config) {
         lookup->font_binary = resource_data->font_binary;
         lookup->face = string_duplicate(face->name);
         lookup->index = i;
+        lookup->is_initialized = false;
         // To hold the size variants.
         lookup->size_variants = darray_create(font_data);
 
-        // The offset
-        lookup->offset = stbtt_GetFontOffsetForIndex(lookup->font_binary, i);
-        i32 result = stbtt_InitFont(&lookup->info, lookup->font_binary, lookup->offset);
-        if (result == 0) {
-            // Zero indicates failure.
-            KERROR("Failed to init system font %s at index %i.", loaded_resource.full_path, i);
-            return false;
-        }
-
-        // Create a default size variant.
-        font_data variant;
-        if (!create_system_font_variant(lookup, config->default_size, face->name, &variant)) {
-            KERROR("Failed to create variant: %s, index %i", face->name, i);
-            continue;
-        }
-
-        // Also perform setup for the variant
-        if (!setup_font_data(&variant)) {
-            KERROR("Failed to setup font data");
-            continue;
-        }
-
-        // Add to the lookup's size variants.
-        darray_push(lookup->size_variants, variant);
-
         // Set the entry id here last before updating the hashtable.
         lookup->id = id;
         if (!hashtable_set(&state_ptr->system_font_lookup, face->name, &id)) {
             KERROR("Hashtable set failed on font load.");
             return false;
         }
+        registered_count++;
+    }
+
+    // Keep the resource while any of its faces may be used.
+    if (registered_count) {
+        darray_push(state_ptr->system_font_resources, loaded_resource);
+    } else {
+        resource_system_unload(&loaded_resource);
     }
 
     return true;
@@ -339,6 +486,9 @@ font_data* font_system_acquire(const char* font_name, u16 font_size, font_type t
 
         // Get the lookup.
         system_font_lookup* lookup = &state_ptr->system_fonts[id];
+        if (!system_font_lookup_initialize(lookup)) {
+            return 0;
+        }
 
         // Search the size variants for the correct size.
         u32 count = darray_length(lookup->size_variants);
@@ -369,6 +519,31 @@ font_data* font_system_acquire(const char* font_name, u16 font_size, font_type t
         // Increment the reference.
         lookup->reference_count++;
         return &lookup->size_variants[length - 1];
+    } else if (type == FONT_TYPE_SYSTEM_SDF) {
+        u16 id = INVALID_ID_U16;
+        if (!hashtable_get(&state_ptr->system_font_lookup, font_name, &id)) {
+            KERROR("System font lookup failed on acquire.");
+            return 0;
+        }
+
+        if (id == INVALID_ID_U16) {
+            KERROR("A system font named '%s' was not found. Font acquisition failed.", font_name);
+            return 0;
+        }
+
+        system_font_lookup* lookup = &state_ptr->system_fonts[id];
+        if (!system_font_lookup_initialize(lookup)) {
+            return 0;
+        }
+        font_data* variant = acquire_system_font_sdf_variant(lookup, font_size);
+        if (!variant) {
+            KERROR("Failed to acquire SDF variant: %s, index %i, size %i", lookup->face, lookup->index, font_size);
+            return 0;
+        }
+
+        // Increment the reference.
+        lookup->reference_count++;
+        return variant;
     }
 
     KERROR("Unrecognized font type: %d", type);
@@ -400,13 +575,90 @@ b8 font_system_verify_atlas(font_data* font, const char* text) {
         system_font_lookup* lookup = &state_ptr->system_fonts[id];
 
         return verify_system_font_size_variant(lookup, font, text);
+    } else if (font->type == FONT_TYPE_SYSTEM_SDF) {
+        u16 id = INVALID_ID_U16;
+        if (!hashtable_get(&state_ptr->system_font_lookup, font->face, &id)) {
+            KERROR("System font lookup failed on acquire.");
+            return false;
+        }
+
+        if (id == INVALID_ID_U16) {
+            KERROR("A system font named '%s' was not found. Font atlas verification failed.", font->face);
+            return false;
+        }
+
+        // Every size shares the atlas of the face, so verifies against that.
+        return verify_system_font_sdf_atlas(&state_ptr->system_fonts[id], text);
     }
 
     KERROR("font_system_verify_atlas failed: Unknown font type.");
     return false;
 }
 
+font_glyph* font_system_glyph_get(font_data* font, i32 codepoint) {
+    font_lookup* lookup = font_lookup_get(font);
+    if (!lookup) {
+        return 0;
+    }
+
+    u32 index = INVALID_ID;
+    if (codepoint >= 0 && codepoint < FONT_GLYPH_TABLE_SIZE) {
+        index = lookup->table[codepoint];
+    } else if (!hashmap_get_u64(&lookup->glyph_map, (u64)(u32)codepoint, &index)) {
+        index = INVALID_ID;
+    }
+    return index == INVALID_ID ? 0 : &font->glyphs[index];
+}
+
+i32 font_system_kerning_get(font_data* font, i32 codepoint_0, i32 codepoint_1) {
+    font_lookup* lookup = font_lookup_get(font);
+    if (!lookup || !lookup->kerning_count) {
+        return 0;
+    }
+
+    i32 amount = 0;
+    u64 key = ((u64)(u32)codepoint_0 << 32) | (u32)codepoint_1;
+    if (!hashmap_get_u64(&lookup->kerning_map, key, &amount)) {
+        return 0;
+    }
+    return amount;
+}
+
 vec2 font_system_measure_string(font_data* font, const char* text) {
+    font_lookup* lookup = font_lookup_get(font);
+    u32 length = string_length(text);
+    if (!lookup || length >= FONT_MEASURE_CACHE_TEXT_MAX) {
+        return measure_string(font, text);
+    }
+
+    // Look the text up in its set, remembering the least recently used entry to replace if it isn't there.
+    u64 hash = hashmap_hash_string(text);
+    font_measure_entry* set = state_ptr->measure_cache[hash % FONT_MEASURE_CACHE_SET_COUNT];
+    font_measure_entry* oldest = &set[0];
+    state_ptr->measure_time++;
+    for (u32 i = 0; i < FONT_MEASURE_CACHE_SET_SIZE; ++i) {
+        font_measure_entry* entry = &set[i];
+        if (entry->last_used && entry->hash == hash && entry->lookup == lookup && entry->glyph_count == font->glyph_count &&
+            entry->kerning_count == font->kerning_count && strings_equal(entry->text, text)) {
+            entry->last_used = state_ptr->measure_time;
+            return entry->extents;
+        }
+        if (entry->last_used < oldest->last_used) {
+            oldest = entry;
+        }
+    }
+
+    oldest->lookup = lookup;
+    oldest->glyph_count = font->glyph_count;
+    oldest->kerning_count = font->kerning_count;
+    oldest->hash = hash;
+    oldest->last_used = state_ptr->measure_time;
+    oldest->extents = measure_string(font, text);
+    kcopy_memory(oldest->text, text, length + 1);
+    return oldest->extents;
+}
+
+static vec2 measure_string(font_data* font, const char* text) {
     vec2 extents = {0};
 
     u32 char_length = string_length(text);
@@ -441,23 +693,11 @@ vec2 font_system_measure_string(font_data* font, const char* text) {
             codepoint = -1;
         }
 
-        font_glyph* g = 0;
-        for (u32 i = 0; i < font->glyph_count; ++i) {
-            if (font->glyphs[i].codepoint == codepoint) {
-                g = &font->glyphs[i];
-                break;
-            }
-        }
-
+        font_glyph* g = font_system_glyph_get(font, codepoint);
         if (!g) {
             // If not found, use the codepoint -1
             codepoint = -1;
-            for (u32 i = 0; i < font->glyph_count; ++i) {
-                if (font->glyphs[i].codepoint == codepoint) {
-                    g = &font->glyphs[i];
-                    break;
-                }
-            }
+            g = font_system_glyph_get(font, codepoint);
         }
 
         if (g) {
@@ -476,16 +716,11 @@ vec2 font_system_measure_string(font_data* font, const char* text) {
                     KWARN("Invalid UTF-8 found in string, using unknown codepoint of -1");
                     codepoint = -1;
                 } else {
-                    for (u32 i = 0; i < font->kerning_count; ++i) {
-                        font_kerning* k = &font->kernings[i];
-                        if (k->codepoint_0 == codepoint && k->codepoint_1 == next_codepoint) {
-                            kerning = k->amount;
-                        }
-                    }
+                    kerning = font_system_kerning_get(font, codepoint, next_codepoint);
                 }
             }
 
-            x += g->x_advance + kerning;
+            x += (g->x_advance + kerning) * font->glyph_scale;
         } else {
             KERROR("Unable to find unknown codepoint. Skipping.");
             continue;
@@ -508,6 +743,11 @@ vec2 font_system_measure_string(font_data* font, const char* text) {
 }
 
 static b8 setup_font_data(font_data* font) {
+    // Glyphs are at the size of the font unless stated otherwise.
+    if (font->glyph_scale == 0) {
+        font->glyph_scale = 1.0f;
+    }
+
     // Create map resources
     font->atlas.filter_magnify = font->atlas.filter_minify = TEXTURE_FILTER_MODE_LINEAR;
     font->atlas.repeat_u = font->atlas.repeat_v = font->atlas.repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
@@ -545,7 +785,90 @@ static b8 setup_font_data(font_data* font) {
     return true;
 }
 
+static font_lookup* font_lookup_get(font_data* font) {
+    font_lookup* lookup = font->lookup;
+    if (lookup && lookup->glyphs == font->glyphs && lookup->glyph_count == font->glyph_count &&
+        lookup->kernings == font->kernings && lookup->kerning_count == font->kerning_count) {
+        return lookup;
+    }
+
+    // Glyphs or kernings have been added since the lookup was built, so build it again.
+    font_lookup_destroy(font);
+    lookup = kallocate(sizeof(font_lookup), font->type == FONT_TYPE_BITMAP ? MEMORY_TAG_BITMAP_FONT : MEMORY_TAG_SYSTEM_FONT);
+    lookup->glyphs = font->glyphs;
+    lookup->glyph_count = font->glyph_count;
+    lookup->kernings = font->kernings;
+    lookup->kerning_count = font->kerning_count;
+
+    u32 mapped_glyph_count = 0;
+    for (u32 i = 0; i < FONT_GLYPH_TABLE_SIZE; ++i) {
+        lookup->table[i] = INVALID_ID;
+    }
+    for (u32 i = 0; i < font->glyph_count; ++i) {
+        i32 codepoint = font->glyphs[i].codepoint;
+        if (codepoint >= 0 && codepoint < FONT_GLYPH_TABLE_SIZE) {
+            // The first glyph of a codepoint wins, as it does when searching.
+            if (lookup->table[codepoint] == INVALID_ID) {
+                lookup->table[codepoint] = i;
+            }
+        } else {
+            mapped_glyph_count++;
+        }
+    }
+
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), KMAX(mapped_glyph_count, 1), &lookup->glyph_map_memory_requirement, 0, 0);
+    lookup->glyph_map_memory = kallocate(lookup->glyph_map_memory_requirement, MEMORY_TAG_HASHTABLE);
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), KMAX(mapped_glyph_count, 1), &lookup->glyph_map_memory_requirement, lookup->glyph_map_memory, &lookup->glyph_map);
+    for (u32 i = font->glyph_count; i > 0; --i) {
+        // Added in reverse, so the first glyph of a codepoint wins.
+        i32 codepoint = font->glyphs[i - 1].codepoint;
+        if (codepoint < 0 || codepoint >= FONT_GLYPH_TABLE_SIZE) {
+            u32 index = i - 1;
+            hashmap_set_u64(&lookup->glyph_map, (u64)(u32)codepoint, &index);
+        }
+    }
+
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(i32), KMAX(font->kerning_count, 1), &lookup->kerning_map_memory_requirement, 0, 0);
+    lookup->kerning_map_memory = kallocate(lookup->kerning_map_memory_requirement, MEMORY_TAG_HASHTABLE);
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(i32), KMAX(font->kerning_count, 1), &lookup->kerning_map_memory_requirement, lookup->kerning_map_memory, &lookup->kerning_map);
+    for (u32 i = 0; i < font->kerning_count; ++i) {
+        // The last kerning of a pair wins, as it does when searching.
+        const font_kerning* k = &font->kernings[i];
+        u64 key = ((u64)(u32)k->codepoint_0 << 32) | (u32)k->codepoint_1;
+        i32 amount = k->amount;
+        hashmap_set_u64(&lookup->kerning_map, key, &amount);
+    }
+
+    font->lookup = lookup;
+    return lookup;
+}
+
+static void font_lookup_destroy(font_data* font) {
+    font_lookup* lookup = font->lookup;
+    if (!lookup) {
+        return;
+    }
+
+    // Forget the font's measurements, as another lookup may later be allocated at the same address.
+    for (u32 s = 0; s < FONT_MEASURE_CACHE_SET_COUNT; ++s) {
+        for (u32 i = 0; i < FONT_MEASURE_CACHE_SET_SIZE; ++i) {
+            if (state_ptr->measure_cache[s][i].lookup == lookup) {
+                kzero_memory(&state_ptr->measure_cache[s][i], sizeof(font_measure_entry));
+            }
+        }
+    }
+
+    hashmap_destroy(&lookup->glyph_map);
+    kfree(lookup->glyph_map_memory, lookup->glyph_map_memory_requirement, MEMORY_TAG_HASHTABLE);
+    hashmap_destroy(&lookup->kerning_map);
+    kfree(lookup->kerning_map_memory, lookup->kerning_map_memory_requirement, MEMORY_TAG_HASHTABLE);
+    kfree(lookup, sizeof(font_lookup), font->type == FONT_TYPE_BITMAP ? MEMORY_TAG_BITMAP_FONT : MEMORY_TAG_SYSTEM_FONT);
+    font->lookup = 0;
+}
+
 static void cleanup_font_data(font_data* font) {
+    font_lookup_destroy(font);
+
     // Release the texture map resources.
     renderer_texture_map_resources_release(&font->atlas);
 
@@ -556,10 +879,130 @@ static void cleanup_font_data(font_data* font) {
     font->atlas.texture = 0;
 }
 
+static void packer_create(u32 width, u32 height, u32 max_height, glyph_atlas_packer* out_packer) {
+    kzero_memory(out_packer, sizeof(glyph_atlas_packer));
+    out_packer->width = width;
+    out_packer->height = height;
+    out_packer->max_height = max_height;
+    out_packer->pixels = kallocate(width * height, MEMORY_TAG_ARRAY);
+    out_packer->needs_full_upload = true;
+}
+
+static void packer_destroy(glyph_atlas_packer* packer) {
+    if (packer->pixels) {
+        kfree(packer->pixels, packer->width * packer->height, MEMORY_TAG_ARRAY);
+    }
+    kzero_memory(packer, sizeof(glyph_atlas_packer));
+}
+
+// Finds a place for a glyph of the given size, growing the atlas if there is no room left.
+static b8 packer_place(glyph_atlas_packer* packer, u32 width, u32 height, u32* out_x, u32* out_y) {
+    if (width > packer->width) {
+        return false;
+    }
+    if (packer->pen_x + width > packer->width) {
+        packer->pen_x = 0;
+        packer->pen_y += packer->row_height;
+        packer->row_height = 0;
+    }
+    while (packer->pen_y + height > packer->height) {
+        u32 new_height = packer->height * 2;
+        if (new_height > packer->max_height) {
+            return false;
+        }
+        // Rows are kept as they are, so glyphs keep their pixel coordinates.
+        u8* new_pixels = kallocate(packer->width * new_height, MEMORY_TAG_ARRAY);
+        kcopy_memory(new_pixels, packer->pixels, packer->width * packer->height);
+        kfree(packer->pixels, packer->width * packer->height, MEMORY_TAG_ARRAY);
+        packer->pixels = new_pixels;
+        packer->height = new_height;
+        packer->needs_full_upload = true;
+    }
+
+    *out_x = packer->pen_x;
+    *out_y = packer->pen_y;
+    if (width && height) {
+        if (packer->dirty_max_x == 0) {
+            packer->dirty_min_x = *out_x;
+            packer->dirty_min_y = *out_y;
+        }
+        packer->dirty_min_x = KMIN(packer->dirty_min_x, *out_x);
+        packer->dirty_min_y = KMIN(packer->dirty_min_y, *out_y);
+        packer->dirty_max_x = KMAX(packer->dirty_max_x, *out_x + width);
+        packer->dirty_max_y = KMAX(packer->dirty_max_y, *out_y + height);
+    }
+
+    // Leave a pixel between glyphs so samples never bleed into neighbours.
+    packer->pen_x += width + 1;
+    packer->row_height = KMAX(packer->row_height, height + 1);
+    return true;
+}
+
+// Uploads whatever has changed in the packer's atlas to the given texture, expanding it to the
+// texture's channel count. Only the rectangle placed into is written, unless the atlas is new or has grown.
+static void packer_upload(glyph_atlas_packer* packer, texture* t) {
+    u32 x = packer->dirty_min_x;
+    u32 y = packer->dirty_min_y;
+    u32 width = packer->dirty_max_x - packer->dirty_min_x;
+    u32 height = packer->dirty_max_y - packer->dirty_min_y;
+    if (packer->needs_full_upload) {
+        if (t->width != packer->width || t->height != packer->height) {
+            // NOTE: Returns false once the internals are regenerated, which is not an error here.
+            texture_system_resize(t, packer->width, packer->height, true);
+        }
+        x = 0;
+        y = 0;
+        width = packer->width;
+        height = packer->height;
+    } else if (packer->dirty_max_x == 0) {
+        return;
+    }
+
+    u8 channel_count = t->channel_count;
+    u32 size = width * height * channel_count;
+    u8* pixels = kallocate(size, MEMORY_TAG_ARRAY);
+    for (u32 row = 0; row < height; ++row) {
+        const u8* source = &packer->pixels[(y + row) * packer->width + x];
+        u8* dest = &pixels[row * width * channel_count];
+        for (u32 col = 0; col < width; ++col) {
+            for (u8 c = 0; c < channel_count; ++c) {
+                dest[(col * channel_count) + c] = source[col];
+            }
+        }
+    }
+
+    if (packer->needs_full_upload) {
+        texture_system_write_data(t, 0, size, pixels);
+    } else {
+        texture_system_write_region(t, x, y, width, height, pixels);
+    }
+    kfree(pixels, size, MEMORY_TAG_ARRAY);
+
+    packer->needs_full_upload = false;
+    packer->dirty_min_x = packer->dirty_min_y = packer->dirty_max_x = packer->dirty_max_y = 0;
+}
+
+static b8 system_font_lookup_initialize(system_font_lookup* lookup) {
+    if (lookup->is_initialized) {
+        return true;
+    }
+
+    // Only the tables of this face are read, so only their pages of the binary are loaded.
+    lookup->offset = stbtt_GetFontOffsetForIndex(lookup->font_binary, lookup->index);
+    if (lookup->offset < 0 || stbtt_InitFont(&lookup->info, lookup->font_binary, lookup->offset) == 0) {
+        // Zero indicates failure.
+        KERROR("Failed to init system font face '%s' at index %i.", lookup->face, lookup->index);
+        return false;
+    }
+
+    lookup->is_initialized = true;
+    return true;
+}
+
 static b8 create_system_font_variant(system_font_lookup* lookup, u16 size, const char* font_name, font_data* out_variant) {
     kzero_memory(out_variant, sizeof(font_data));
-    out_variant->atlas_size_x = 1024;  // TODO: configurable size
-    out_variant->atlas_size_y = 1024;
+    out_variant->atlas_size_x = SYSTEM_FONT_ATLAS_WIDTH;
+    out_variant->atlas_size_y = SYSTEM_FONT_ATLAS_INITIAL_HEIGHT;
     out_variant->size = size;
     out_variant->type = FONT_TYPE_SYSTEM;
     string_ncopy(out_variant->face, font_name, 255);
@@ -576,10 +1019,11 @@ static b8 create_system_font_variant(system_font_lookup* lookup, u16 size, const
     }
     darray_length_set(internal_data->codepoints, 96);
 
-    // Create texture.
+    // Create texture. It starts small and grows as glyphs are added.
     char font_tex_name[255];
     string_format(font_tex_name, "__system_text_atlas_%s_i%i_sz%i__", font_name, lookup->index, size);
     out_variant->atlas.texture = texture_system_acquire_writeable(font_tex_name, out_variant->atlas_size_x, out_variant->atlas_size_y, 4, true);
+    packer_create(out_variant->atlas_size_x, out_variant->atlas_size_y, SYSTEM_FONT_ATLAS_MAX_HEIGHT, &internal_data->packer);
 
     // Obtain some metrics
     internal_data->scale = stbtt_ScaleForPixelHeight(&lookup->info, (f32)size);
@@ -587,110 +1031,118 @@ static b8 create_system_font_variant(system_font_lookup* lookup, u16 size, const
     stbtt_GetFontVMetrics(&lookup->info, &ascent, &descent, &line_gap);
     out_variant->line_height = (ascent - descent + line_gap) * internal_data->scale;
 
-    return rebuild_system_font_variant_atlas(lookup, out_variant);
-}
-
-static b8 rebuild_system_font_variant_atlas(system_font_lookup* lookup, font_data* variant) {
-    system_font_variant_data* internal_data = (system_font_variant_data*)variant->internal_data;
+    // Kernings don't depend on which glyphs are in the atlas, so are only obtained once.
+    out_variant->kerning_count = stbtt_GetKerningTableLength(&lookup->info);
+    if (out_variant->kerning_count) {
+        out_variant->kernings = kallocate(sizeof(font_kerning) * out_variant->kerning_count, MEMORY_TAG_ARRAY);
+        // Get the kerning table for the current font.
+        stbtt_kerningentry* kerning_table = kallocate(sizeof(stbtt_kerningentry) * out_variant->kerning_count, MEMORY_TAG_ARRAY);
+        u32 entry_count = stbtt_GetKerningTable(&lookup->info, kerning_table, out_variant->kerning_count);
+        if (entry_count != out_variant->kerning_count) {
+            KERROR("Kerning entry count mismatch: %u->%u", entry_count, out_variant->kerning_count);
+            return false;
+        }
 
-    u32 pack_image_size = variant->atlas_size_x * variant->atlas_size_y * sizeof(u8);
-    u8* pixels = kallocate(pack_image_size, MEMORY_TAG_ARRAY);
-    u32 codepoint_count = darray_length(internal_data->codepoints);
-    stbtt_packedchar* packed_chars = kallocate(sizeof(stbtt_packedchar) * codepoint_count, MEMORY_TAG_ARRAY);
-
-    // Begin packing all known characters into the atlas. This
-    // creates a single-channel image with rendered glyphs at the
-    // given size.
-    stbtt_pack_context context;
-    if (!stbtt_PackBegin(&context, pixels, variant->atlas_size_x, variant->atlas_size_y, 0, 1, 0)) {
-        KERROR("stbtt_PackBegin failed");
-        return false;
-    }
+        for (u32 i = 0; i < out_variant->kerning_count; ++i) {
+            font_kerning* k = &out_variant->kernings[i];
+            k->codepoint_0 = kerning_table[i].glyph1;
+            k->codepoint_1 = kerning_table[i].glyph2;
+            k->amount = kerning_table[i].advance;
+        }
 
-    // Fit all codepoints into a single range for packing.
-    stbtt_pack_range range;
-    range.first_unicode_codepoint_in_range = 0;
-    range.font_size = variant->size;
-    range.num_chars = codepoint_count;
-    range.chardata_for_range = packed_chars;
-    range.array_of_unicode_codepoints = internal_data->codepoints;
-    if (!stbtt_PackFontRanges(&context, lookup->font_binary, lookup->index, &range, 1)) {
-        KERROR("stbtt_PackFontRanges failed");
-        return false;
+        kfree(kerning_table, sizeof(stbtt_kerningentry) * out_variant->kerning_count, MEMORY_TAG_ARRAY);
+    } else {
+        out_variant->kernings = 0;
     }
 
-    stbtt_PackEnd(&context);
-    // Packing complete.
+    return add_system_font_variant_glyphs(lookup, out_variant, 0);
+}
 
-    // Convert from single-channel to RGBA, or pack_image_size * 4.
-    u8* rgba_pixels = kallocate(pack_image_size * 4, MEMORY_TAG_ARRAY);
-    for (u32 j = 0; j < pack_image_size; ++j) {
-        rgba_pixels[(j * 4) + 0] = pixels[j];
-        rgba_pixels[(j * 4) + 1] = pixels[j];
-        rgba_pixels[(j * 4) + 2] = pixels[j];
-        rgba_pixels[(j * 4) + 3] = pixels[j];
+static void glyphs_rasterize(u32 start, u32 end, void* user_data) {
+    glyph_rasterize_context* context = user_data;
+    glyph_atlas_packer* packer = context->packer;
+    for (u32 i = start; i < end; ++i) {
+        const font_glyph* g = &context->glyphs[i];
+        if (g->width && g->height) {
+            // Glyphs never overlap, so each can be drawn straight into the atlas.
+            u8* output = &packer->pixels[(g->y * packer->width) + g->x];
+            stbtt_MakeCodepointBitmap(context->info, output, g->width, g->height, packer->width, context->scale, context->scale, g->codepoint);
+        }
     }
+}
 
-    // Write texture data to atlas.
-    texture_system_write_data(variant->atlas.texture, 0, pack_image_size * 4, rgba_pixels);
+// Adds glyphs to the variant's atlas for the codepoints from first_codepoint onward, leaving
+// those already there as they are.
+static b8 add_system_font_variant_glyphs(system_font_lookup* lookup, font_data* variant, u32 first_codepoint) {
+    system_font_variant_data* internal_data = (system_font_variant_data*)variant->internal_data;
+    glyph_atlas_packer* packer = &internal_data->packer;
 
-    // Free pixel/rgba_pixel data.
-    kfree(pixels, pack_image_size, MEMORY_TAG_ARRAY);
-    kfree(rgba_pixels, pack_image_size * 4, MEMORY_TAG_ARRAY);
+    u32 codepoint_count = darray_length(internal_data->codepoints);
+    u32 old_height = packer->height;
+    b8 result = true;
 
-    // Regenerate glyphs
+    // Make room for the new glyphs, keeping the old.
+    font_glyph* glyphs = kallocate(sizeof(font_glyph) * codepoint_count, MEMORY_TAG_ARRAY);
     if (variant->glyphs && variant->glyph_count) {
+        kcopy_memory(glyphs, variant->glyphs, sizeof(font_glyph) * variant->glyph_count);
         kfree(variant->glyphs, sizeof(font_glyph) * variant->glyph_count, MEMORY_TAG_ARRAY);
     }
-    variant->glyph_count = codepoint_count;
-    variant->glyphs = kallocate(sizeof(font_glyph) * codepoint_count, MEMORY_TAG_ARRAY);
-    for (u16 i = 0; i < variant->glyph_count; ++i) {
-        stbtt_packedchar* pc = &packed_chars[i];
-        font_glyph* g = &variant->glyphs[i];
+    variant->glyphs = glyphs;
+
+    // Place each new glyph.
+    u32 placed_count = first_codepoint;
+    for (u32 i = first_codepoint; i < codepoint_count; ++i) {
+        font_glyph* g = &glyphs[i];
         g->codepoint = internal_data->codepoints[i];
         g->page_id = 0;
-        g->x_offset = pc->xoff;
-        g->y_offset = pc->yoff;
-        g->x = pc->x0;  // xmin;
-        g->y = pc->y0;
-        g->width = pc->x1 - pc->x0;
-        g->height = pc->y1 - pc->y0;
-        g->x_advance = pc->xadvance;
-    }
-
-    // Regenerate kernings
-    if (variant->kernings && variant->kerning_count) {
-        kfree(variant->kernings, sizeof(font_kerning) * variant->kerning_count, MEMORY_TAG_ARRAY);
-    }
-    variant->kerning_count = stbtt_GetKerningTableLength(&lookup->info);
-    if (variant->kerning_count) {
-        variant->kernings = kallocate(sizeof(font_kerning) * variant->kerning_count, MEMORY_TAG_ARRAY);
-        // Get the kerning table for the current font.
-        stbtt_kerningentry* kerning_table = kallocate(sizeof(stbtt_kerningentry) * variant->kerning_count, MEMORY_TAG_ARRAY);
-        u32 entry_count = stbtt_GetKerningTable(&lookup->info, kerning_table, variant->kerning_count);
-        if (entry_count != variant->kerning_count) {
-            KERROR("Kerning entry count mismatch: %u->%u", entry_count, variant->kerning_count);
-            return false;
-        }
 
-        for (u32 i = 0; i < variant->kerning_count; ++i) {
-            font_kerning* k = &variant->kernings[i];
-            k->codepoint_0 = kerning_table[i].glyph1;
-            k->codepoint_1 = kerning_table[i].glyph2;
-            k->amount = kerning_table[i].advance;
-        }
+        i32 x0, y0, x1, y1;
+        stbtt_GetCodepointBitmapBox(&lookup->info, g->codepoint, internal_data->scale, internal_data->scale, &x0, &y0, &x1, &y1);
+        i32 advance, left_side_bearing;
+        stbtt_GetCodepointHMetrics(&lookup->info, g->codepoint, &advance, &left_side_bearing);
 
-        kfree(kerning_table, sizeof(stbtt_kerningentry) * variant->kerning_count, MEMORY_TAG_ARRAY);
-    } else {
-        variant->kernings = 0;
+        u32 x, y;
+        if (!packer_place(packer, x1 - x0, y1 - y0, &x, &y)) {
+            // Text using glyphs past this point falls back to the unknown glyph.
+            KWARN("Font atlas for '%s' size %u is full. Remaining glyphs will not be added.", variant->face, variant->size);
+            result = false;
+            break;
+        }
+        g->x = x;
+        g->y = y;
+        g->width = x1 - x0;
+        g->height = y1 - y0;
+        g->x_offset = x0;
+        g->y_offset = y0;
+        g->x_advance = (i16)(advance * internal_data->scale + 0.5f);
+        placed_count++;
+    }
+    // Don't keep codepoints which didn't fit, so they are tried again later.
+    darray_length_set(internal_data->codepoints, placed_count);
+    variant->glyph_count = placed_count;
+
+    // Only the new glyphs are rasterized, in parallel on the job threads.
+    glyph_rasterize_context context = {0};
+    context.info = &lookup->info;
+    context.scale = internal_data->scale;
+    context.packer = packer;
+    context.glyphs = &glyphs[first_codepoint];
+    job_parallel_for(placed_count - first_codepoint, 0, glyphs_rasterize, &context);
+
+    if (packer->height != old_height) {
+        // Every glyph's texture coordinates change with the height of the atlas.
+        variant->atlas_size_y = packer->height;
+        variant->atlas_generation++;
     }
+    packer_upload(packer, variant->atlas.texture);
 
-    return true;
+    return result;
 }
 
 static b8 verify_system_font_size_variant(system_font_lookup* lookup, font_data* variant, const char* text) {
     system_font_variant_data* internal_data = (system_font_variant_data*)variant->internal_data;
 
+    u32 first_new_codepoint = darray_length(internal_data->codepoints);
     u32 char_length = string_length(text);
     u32 added_codepoint_count = 0;
     for (u32 i = 0; i < char_length;) {
@@ -722,11 +1174,275 @@ static b8 verify_system_font_size_variant(system_font_lookup* lookup, font_data*
         }
     }
 
-    // If codepoints were added, rebuild the atlas.
+    // If codepoints were added, add their glyphs to the atlas.
     if (added_codepoint_count > 0) {
-        return rebuild_system_font_variant_atlas(lookup, variant);
+        return add_system_font_variant_glyphs(lookup, variant, first_new_codepoint);
     }
 
     // Otherwise, proceed as normal.
     return true;
 }
+
+static b8 create_system_font_sdf_atlas(system_font_lookup* lookup) {
+    system_font_sdf_atlas* atlas = kallocate(sizeof(system_font_sdf_atlas), MEMORY_TAG_SYSTEM_FONT);
+    packer_create(SDF_ATLAS_WIDTH, SDF_ATLAS_INITIAL_HEIGHT, SDF_ATLAS_MAX_HEIGHT, &atlas->packer);
+    atlas->glyphs = darray_create(font_glyph);
+    atlas->kernings = darray_create(font_kerning);
+    atlas->variants = darray_create(font_data*);
+    atlas->scale = stbtt_ScaleForPixelHeight(&lookup->info, (f32)SDF_GLYPH_SIZE);
+
+    // A single channel is enough for a distance field.
+    char font_tex_name[255];
+    string_format(font_tex_name, "__system_text_sdf_atlas_%s_i%i__", lookup->face, lookup->index);
+    atlas->texture = texture_system_acquire_writeable(font_tex_name, SDF_ATLAS_WIDTH, SDF_ATLAS_INITIAL_HEIGHT, 1, true);
+    if (!atlas->texture) {
+        KERROR("Failed to create SDF atlas texture for font '%s'.", lookup->face);
+        packer_destroy(&atlas->packer);
+        darray_destroy(atlas->glyphs);
+        darray_destroy(atlas->kernings);
+        darray_destroy(atlas->variants);
+        kfree(atlas, sizeof(system_font_sdf_atlas), MEMORY_TAG_SYSTEM_FONT);
+        return false;
+    }
+
+    lookup->sdf_atlas = atlas;
+
+    // Start with the same default codepoints as other system fonts (ascii 32-127), plus a -1 for unknown.
+    char ascii[97];
+    for (i32 i = 0; i < 95; ++i) {
+        ascii[i] = (char)(i + 32);
+    }
+    ascii[95] = 0;
+    return verify_system_font_sdf_atlas(lookup, ascii);
+}
+
+static void destroy_system_font_sdf_atlas(system_font_lookup* lookup) {
+    system_font_sdf_atlas* atlas = lookup->sdf_atlas;
+    if (!atlas) {
+        return;
+    }
+
+    u32 variant_count = darray_length(atlas->variants);
+    for (u32 i = 0; i < variant_count; ++i) {
+        // The glyphs and kernings belong to the atlas.
+        cleanup_font_data(atlas->variants[i]);
+        kfree(atlas->variants[i], sizeof(font_data), MEMORY_TAG_SYSTEM_FONT);
+    }
+    darray_destroy(atlas->variants);
+    darray_destroy(atlas->glyphs);
+    darray_destroy(atlas->kernings);
+    packer_destroy(&atlas->packer);
+    kfree(atlas, sizeof(system_font_sdf_atlas), MEMORY_TAG_SYSTEM_FONT);
+    lookup->sdf_atlas = 0;
+}
+
+static font_data* acquire_system_font_sdf_variant(system_font_lookup* lookup, u16 size) {
+    if (!lookup->sdf_atlas && !create_system_font_sdf_atlas(lookup)) {
+        return 0;
+    }
+    system_font_sdf_atlas* atlas = lookup->sdf_atlas;
+
+    u32 variant_count = darray_length(atlas->variants);
+    for (u32 i = 0; i < variant_count; ++i) {
+        if (atlas->variants[i]->size == size) {
+            return atlas->variants[i];
+        }
+    }
+
+    // No variant of this size yet. It only needs its metrics, since the atlas is shared.
+    font_data* variant = kallocate(sizeof(font_data), MEMORY_TAG_SYSTEM_FONT);
+    variant->type = FONT_TYPE_SYSTEM_SDF;
+    variant->size = size;
+    string_ncopy(variant->face, lookup->face, 255);
+    variant->atlas_size_x = atlas->packer.width;
+    variant->atlas_size_y = atlas->packer.height;
+    variant->atlas.texture = atlas->texture;
+    variant->glyph_scale = (f32)size / SDF_GLYPH_SIZE;
+    variant->glyphs = atlas->glyphs;
+    variant->glyph_count = darray_length(atlas->glyphs);
+    variant->kernings = atlas->kernings;
+    variant->kerning_count = darray_length(atlas->kernings);
+
+    f32 scale = stbtt_ScaleForPixelHeight(&lookup->info, (f32)size);
+    i32 ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&lookup->info, &ascent, &descent, &line_gap);
+    variant->line_height = (ascent - descent + line_gap) * scale;
+
+    // Glyph advances are at the atlas size, so the tab advance is scaled here rather than in setup.
+    for (u32 i = 0; i < variant->glyph_count; ++i) {
+        if (variant->glyphs[i].codepoint == ' ') {
+            variant->tab_x_advance = variant->glyphs[i].x_advance * 4 * variant->glyph_scale;
+            break;
+        }
+    }
+
+    if (!setup_font_data(variant)) {
+        KERROR("Failed to setup font data");
+        kfree(variant, sizeof(font_data), MEMORY_TAG_SYSTEM_FONT);
+        return 0;
+    }
+
+    darray_push(atlas->variants, variant);
+    return variant;
+}
+
+static void sdf_glyphs_generate(u32 start, u32 end, void* user_data) {
+    sdf_generate_context* context = user_data;
+    for (u32 i = start; i < end; ++i) {
+        sdf_glyph_bitmap* g = &context->glyphs[i];
+        i32 advance, left_side_bearing;
+        stbtt_GetCodepointHMetrics(context->info, g->codepoint, &advance, &left_side_bearing);
+        g->x_advance = (i32)(advance * context->scale + 0.5f);
+        // Pixels are 0 for glyphs with no outline.
+        g->pixels = stbtt_GetCodepointSDF(context->info, context->scale, g->codepoint, SDF_GLYPH_PADDING, SDF_ONEDGE_VALUE, (f32)SDF_ONEDGE_VALUE / SDF_GLYPH_PADDING, &g->width, &g->height, &g->x_offset, &g->y_offset);
+        if (!g->pixels) {
+            g->width = g->height = g->x_offset = g->y_offset = 0;
+        }
+    }
+}
+
+static b8 sdf_atlas_contains(system_font_sdf_atlas* atlas, i32 codepoint) {
+    u32 glyph_count = darray_length(atlas->glyphs);
+    for (u32 i = 0; i < glyph_count; ++i) {
+        if (atlas->glyphs[i].codepoint == codepoint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static b8 verify_system_font_sdf_atlas(system_font_lookup* lookup, const char* text) {
+    system_font_sdf_atlas* atlas = lookup->sdf_atlas;
+
+    // Gather the codepoints which are not in the atlas yet, once each. Unknown is always included.
+    sdf_glyph_bitmap* added = darray_create(sdf_glyph_bitmap);
+    if (!sdf_atlas_contains(atlas, -1)) {
+        sdf_glyph_bitmap unknown = {0};
+        unknown.codepoint = -1;
+        darray_push(added, unknown);
+    }
+    u32 char_length = string_length(text);
+    for (u32 i = 0; i < char_length;) {
+        i32 codepoint;
+        u8 advance;
+        if (!bytes_to_codepoint(text, i, &codepoint, &advance)) {
+            KERROR("bytes_to_codepoint failed to get codepoint.");
+            ++i;
+            continue;
+        }
+        i += advance;
+        if (codepoint == '\n' || codepoint == '\t' || sdf_atlas_contains(atlas, codepoint)) {
+            continue;
+        }
+        b8 pending = false;
+        u32 added_count = darray_length(added);
+        for (u32 j = 0; j < added_count; ++j) {
+            if (added[j].codepoint == codepoint) {
+                pending = true;
+                break;
+            }
+        }
+        if (!pending) {
+            sdf_glyph_bitmap g = {0};
+            g.codepoint = codepoint;
+            darray_push(added, g);
+        }
+    }
+
+    u32 added_count = darray_length(added);
+    if (added_count == 0) {
+        darray_destroy(added);
+        return true;
+    }
+
+    // Only the new glyphs are generated, in parallel on the job threads.
+    sdf_generate_context context = {0};
+    context.info = &lookup->info;
+    context.scale = atlas->scale;
+    context.glyphs = added;
+    job_parallel_for(added_count, 0, sdf_glyphs_generate, &context);
+
+    // Pack the new glyphs into rows after those already there.
+    b8 result = true;
+    glyph_atlas_packer* packer = &atlas->packer;
+    u32 old_height = packer->height;
+    u32 first_new_glyph = darray_length(atlas->glyphs);
+    for (u32 i = 0; i < added_count; ++i) {
+        sdf_glyph_bitmap* b = &added[i];
+        u32 x, y;
+        if (!packer_place(packer, b->width, b->height, &x, &y)) {
+            // Text using glyphs past this point falls back to the unknown glyph.
+            KWARN("SDF atlas for font '%s' is full. Remaining glyphs will not be added.", lookup->face);
+            result = false;
+            break;
+        }
+
+        for (i32 row = 0; row < b->height; ++row) {
+            kcopy_memory(&packer->pixels[(y + row) * packer->width + x], &b->pixels[row * b->width], b->width);
+        }
+
+        font_glyph g = {0};
+        g.codepoint = b->codepoint;
+        g.x = x;
+        g.y = y;
+        g.width = b->width;
+        g.height = b->height;
+        g.x_offset = b->x_offset;
+        g.y_offset = b->y_offset;
+        g.x_advance = b->x_advance;
+        darray_push(atlas->glyphs, g);
+    }
+    for (u32 i = 0; i < added_count; ++i) {
+        if (added[i].pixels) {
+            stbtt_FreeSDF(added[i].pixels, 0);
+        }
+    }
+    darray_destroy(added);
+
+    // Kern the new glyphs against every glyph, in both orders.
+    u32 glyph_count = darray_length(atlas->glyphs);
+    for (u32 i = first_new_glyph; i < glyph_count; ++i) {
+        for (u32 j = 0; j < glyph_count; ++j) {
+            // Pairs of two new glyphs would otherwise be kerned from both sides.
+            if (j >= first_new_glyph && j < i) {
+                continue;
+            }
+            for (u32 order = 0; order < 2; ++order) {
+                if (order == 1 && i == j) {
+                    continue;
+                }
+                i32 first = order == 0 ? atlas->glyphs[i].codepoint : atlas->glyphs[j].codepoint;
+                i32 second = order == 0 ? atlas->glyphs[j].codepoint : atlas->glyphs[i].codepoint;
+                i32 amount = stbtt_GetCodepointKernAdvance(&lookup->info, first, second);
+                if (amount) {
+                    font_kerning k = {0};
+                    k.codepoint_0 = first;
+                    k.codepoint_1 = second;
+                    k.amount = (i16)(amount * atlas->scale + (amount < 0 ? -0.5f : 0.5f));
+                    if (k.amount) {
+                        darray_push(atlas->kernings, k);
+                    }
+                }
+            }
+        }
+    }
+
+    b8 grown = packer->height != old_height;
+    packer_upload(packer, atlas->texture);
+
+    // The arrays may have moved, so every variant is pointed at them again.
+    u32 variant_count = darray_length(atlas->variants);
+    for (u32 i = 0; i < variant_count; ++i) {
+        font_data* variant = atlas->variants[i];
+        if (grown) {
+            variant->atlas_size_y = packer->height;
+            variant->atlas_generation++;
+        }
+        variant->glyphs = atlas->glyphs;
+        variant->glyph_count = glyph_count;
+        variant->kernings = atlas->kernings;
+        variant->kerning_count = darray_length(atlas->kernings);
+    }
+
+    return result;
+}
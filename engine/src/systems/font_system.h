@@ -21,7 +21,7 @@
 typedef struct system_font_config {
     /** @brief The name of the font. */
     char* name;
-    /** @brief The default size of the font. */
+    /** @brief The default size of the font. Variants are only created once acquired, at the size requested. */
     u16 default_size;
     /** @brief The name of the resource containing the font data. */
     char* resource_name;
@@ -80,7 +80,8 @@ b8 font_system_initialize(u64* memory_requirement, void* memory, void* config);
 void font_system_shutdown(void* memory);
 
 /**
- * @brief Loads a system font from the following config.
+ * @brief Loads a system font from the following config. The font binary is mapped rather
+ * than read, and its faces are only set up when first acquired.
  *
  * @param config A pointer to the config to use for loading.
  * @return True on success; otherwise false.
@@ -124,8 +125,28 @@ KAPI b8 font_system_verify_atlas(font_data* font, const char* text);
 
 /**
  * @brief Measures the given string to find out how large it is at the widest/tallest point.
+ * Measurements of short strings are cached, so measuring the same text again is cheap.
  *
  * @param font A pointer to the font to use for measuring.
  * @param text The text to be measured.
  */
 KAPI vec2 font_system_measure_string(font_data* font, const char* text);
+
+/**
+ * @brief Finds the glyph of the given codepoint in the provided font.
+ *
+ * @param font A pointer to the font to search.
+ * @param codepoint The codepoint to find the glyph of.
+ * @return A pointer to the glyph if found; otherwise 0. Only valid until glyphs are added to the font.
+ */
+KAPI font_glyph* font_system_glyph_get(font_data* font, i32 codepoint);
+
+/**
+ * @brief Obtains the kerning between the given pair of codepoints in the provided font.
+ *
+ * @param font A pointer to the font to search.
+ * @param codepoint_0 The first codepoint of the pair.
+ * @param codepoint_1 The second codepoint of the pair.
+ * @return The kerning amount, unscaled by the glyph scale of the font. 0 if the pair isn't kerned.
+ */
+KAPI i32 font_system_kerning_get(font_data* font, i32 codepoint_0, i32 codepoint_1);
@@ -1,5 +1,8 @@
 #include "geometry_system.h"
 
+#include "containers/slot_map.h"
+#include "core/event.h"
+#include "core/frame_data.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
@@ -7,19 +10,38 @@
 #include "renderer/renderer_frontend.h"
 #include "systems/material_system.h"
 
+// How often the fragmentation of the geometry buffers is checked, in frames.
+#define GEOMETRY_COMPACT_CHECK_INTERVAL 120
+// The fragmentation of the geometry buffers at which a compaction pass starts.
+#define GEOMETRY_COMPACT_FRAGMENTATION_THRESHOLD 0.3f
+// The most geometries moved per frame during a compaction pass.
+#define GEOMETRY_COMPACT_MOVES_PER_FRAME 8
+
 typedef struct geometry_reference {
     u64 reference_count;
     geometry geometry;
     b8 auto_release;
+    // The compaction pass the geometry was last considered in.
+    u32 compact_pass;
 } geometry_reference;
 
 typedef struct geometry_system_state {
     geometry_system_config config;
 
     geometry default_geometry;
-
-    // Array of registered meshes.
-    geometry_reference* registered_geometries;
+    // Indicates if the default geometry has been created. It is created the first time it is asked for.
+    b8 default_geometry_created;
+
+    // Registered geometries. The slot index of each is its id.
+    slot_map registered_geometries;
+
+    // Indicates if a compaction pass is underway. Passes move geometries down to lower offsets of
+    // the geometry buffers, starting from the highest, a few per frame.
+    b8 compacting;
+    // The number of the current, or last, compaction pass.
+    u32 compact_pass;
+    // Frames until fragmentation is next checked.
+    u32 compact_check_countdown;
 } geometry_system_state;
 
 static geometry_system_state* state_ptr = 0;
@@ -27,6 +49,7 @@ static geometry_system_state* state_ptr = 0;
 static b8 create_default_geometries(geometry_system_state* state);
 static b8 create_geometry(geometry_system_state* state, geometry_config config, geometry* g);
 static void destroy_geometry(geometry_system_state* state, geometry* g);
+static b8 geometry_system_on_gpu_memory_pressure(u16 code, void* sender, void* listener_inst, event_context context);
 
 b8 geometry_system_initialize(u64* memory_requirement, void* state, void* config) {
     geometry_system_config* typed_config = (geometry_system_config*)config;
@@ -35,9 +58,9 @@ b8 geometry_system_initialize(u64* memory_requirement, void* state, void* config
         return false;
     }
 
-    // Block of memory will contain state structure, then block for array, then block for hashtable.
+    // Block of memory will contain state structure, then block for the slot map.
     u64 struct_requirement = sizeof(geometry_system_state);
-    u64 array_requirement = sizeof(geometry_reference) * typed_config->max_geometry_count;
+    u64 array_requirement = slot_map_memory_requirement(sizeof(geometry_reference), typed_config->max_geometry_count);
     *memory_requirement = struct_requirement + array_requirement;
 
     if (!state) {
@@ -47,33 +70,78 @@ b8 geometry_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr = state;
     state_ptr->config = *typed_config;
 
-    // The array block is after the state. Already allocated, so just set the pointer.
+    // The slot map block is after the state. Already allocated, so just create the map in it.
     void* array_block = state + struct_requirement;
-    state_ptr->registered_geometries = array_block;
-
-    // Invalidate all geometries in the array.
-    u32 count = state_ptr->config.max_geometry_count;
-    for (u32 i = 0; i < count; ++i) {
-        state_ptr->registered_geometries[i].geometry.id = INVALID_ID;
-        state_ptr->registered_geometries[i].geometry.generation = INVALID_ID_U16;
-    }
-
-    if (!create_default_geometries(state_ptr)) {
-        KFATAL("Failed to create default geometries. Application cannot continue.");
+    if (!slot_map_create(sizeof(geometry_reference), state_ptr->config.max_geometry_count, array_block, &state_ptr->registered_geometries)) {
+        KFATAL("geometry_system_initialize - Failed to create the geometry slot map.");
         return false;
     }
 
+    // NOTE: The default geometry, and the default material it uses, are created on first use.
+    state_ptr->default_geometry_created = false;
+
+    event_register(EVENT_CODE_GPU_MEMORY_PRESSURE, state_ptr, geometry_system_on_gpu_memory_pressure);
+
     return true;
 }
 
 void geometry_system_shutdown(void* state) {
-    // NOTE: nothing to do here.
+    if (state_ptr) {
+        event_unregister(EVENT_CODE_GPU_MEMORY_PRESSURE, state_ptr, geometry_system_on_gpu_memory_pressure);
+    }
+}
+
+b8 geometry_system_update(void* state, struct frame_data* p_frame_data) {
+    geometry_system_state* typed_state = state;
+    if (!typed_state->compacting) {
+        if (typed_state->compact_check_countdown > 0) {
+            typed_state->compact_check_countdown--;
+            return true;
+        }
+        typed_state->compact_check_countdown = GEOMETRY_COMPACT_CHECK_INTERVAL;
+        f32 fragmentation = renderer_geometry_fragmentation();
+        if (fragmentation < GEOMETRY_COMPACT_FRAGMENTATION_THRESHOLD) {
+            return true;
+        }
+        KDEBUG("Geometry buffers are %.0f%% fragmented, compacting.", fragmentation * 100.0f);
+        typed_state->compacting = true;
+        typed_state->compact_pass++;
+    }
+
+    slot_map* map = &typed_state->registered_geometries;
+    for (u32 moves = 0; moves < GEOMETRY_COMPACT_MOVES_PER_FRAME; ++moves) {
+        // Take the highest geometry not yet considered in this pass, so free space collects at the top.
+        geometry_reference* candidate = 0;
+        for (u32 i = 0; i < map->count; ++i) {
+            geometry_reference* ref = slot_map_dense_get(map, i);
+            if (ref->compact_pass == typed_state->compact_pass || ref->geometry.id == INVALID_ID || ref->geometry.generation == INVALID_ID_U16) {
+                continue;
+            }
+            if (!candidate || ref->geometry.vertex_buffer_offset > candidate->geometry.vertex_buffer_offset) {
+                candidate = ref;
+            }
+        }
+        if (!candidate) {
+            KDEBUG("Geometry compaction pass complete.");
+            typed_state->compacting = false;
+            break;
+        }
+
+        candidate->compact_pass = typed_state->compact_pass;
+        b8 moved = false;
+        if (!renderer_geometry_relocate(&candidate->geometry, &moved)) {
+            KWARN("Failed to relocate geometry '%s' during compaction.", candidate->geometry.name);
+        }
+    }
+
+    return true;
 }
 
 geometry* geometry_system_acquire_by_id(u32 id) {
-    if (id != INVALID_ID && state_ptr->registered_geometries[id].geometry.id != INVALID_ID) {
-        state_ptr->registered_geometries[id].reference_count++;
-        return &state_ptr->registered_geometries[id].geometry;
+    geometry_reference* ref = slot_map_get(&state_ptr->registered_geometries, slot_map_handle_get(&state_ptr->registered_geometries, id));
+    if (ref && ref->geometry.id != INVALID_ID) {
+        ref->reference_count++;
+        return &ref->geometry;
     }
 
     // NOTE: Should return default geometry instead?
@@ -82,25 +150,21 @@ geometry* geometry_system_acquire_by_id(u32 id) {
 }
 
 geometry* geometry_system_acquire_from_config(geometry_config config, b8 auto_release) {
-    geometry* g = 0;
-    for (u32 i = 0; i < state_ptr->config.max_geometry_count; ++i) {
-        if (state_ptr->registered_geometries[i].geometry.id == INVALID_ID) {
-            // Found empty slot.
-            state_ptr->registered_geometries[i].auto_release = auto_release;
-            state_ptr->registered_geometries[i].reference_count = 1;
-            g = &state_ptr->registered_geometries[i].geometry;
-            g->id = i;
-            break;
-        }
-    }
-
-    if (!g) {
+    geometry_reference* ref = 0;
+    slot_map_handle handle = slot_map_insert(&state_ptr->registered_geometries, (void**)&ref);
+    if (handle == SLOT_MAP_INVALID_HANDLE) {
         KERROR("Unable to obtain free slot for geometry. Adjust configuration to allow more space. Returning nullptr.");
         return 0;
     }
+    ref->auto_release = auto_release;
+    ref->reference_count = 1;
+    geometry* g = &ref->geometry;
+    g->id = slot_map_handle_index(handle);
+    g->generation = INVALID_ID_U16;
 
     if (!create_geometry(state_ptr, config, g)) {
         KERROR("Failed to create geometry. Returning nullptr.");
+        slot_map_remove(&state_ptr->registered_geometries, handle);
         return 0;
     }
 
@@ -109,23 +173,27 @@ geometry* geometry_system_acquire_from_config(geometry_config config, b8 auto_re
 
 void geometry_system_config_dispose(geometry_config* config) {
     if (config) {
-        if (config->vertices) {
+        // Data held by a mapping is released along with the mapping, by whoever created it.
+        if (config->vertices && !config->mapping) {
             kfree(config->vertices, config->vertex_size * config->vertex_count, MEMORY_TAG_ARRAY);
         }
-        if (config->vertices) {
+        if (config->indices && !config->mapping) {
             kfree(config->indices, config->index_size * config->index_count, MEMORY_TAG_ARRAY);
         }
+        if (config->clusters && !config->mapping) {
+            kfree(config->clusters, sizeof(geometry_cluster) * config->cluster_count, MEMORY_TAG_ARRAY);
+        }
         kzero_memory(config, sizeof(geometry_config));
     }
 }
 
 void geometry_system_release(geometry* geometry) {
     if (geometry && geometry->id != INVALID_ID) {
-        geometry_reference* ref = &state_ptr->registered_geometries[geometry->id];
-
         // Take a copy of the id;
         u32 id = geometry->id;
-        if (ref->geometry.id == id) {
+        slot_map_handle handle = slot_map_handle_get(&state_ptr->registered_geometries, id);
+        geometry_reference* ref = slot_map_get(&state_ptr->registered_geometries, handle);
+        if (ref && ref->geometry.id == id) {
             if (ref->reference_count > 0) {
                 ref->reference_count--;
             }
@@ -133,8 +201,7 @@ void geometry_system_release(geometry* geometry) {
             // Also blanks out the geometry id.
             if (ref->reference_count < 1 && ref->auto_release) {
                 destroy_geometry(state_ptr, &ref->geometry);
-                ref->reference_count = 0;
-                ref->auto_release = false;
+                slot_map_remove(&state_ptr->registered_geometries, handle);
             }
         } else {
             KFATAL("Geometry id mismatch. Check registration logic, as this should never occur.");
@@ -147,6 +214,12 @@ void geometry_system_release(geometry* geometry) {
 
 geometry* geometry_system_get_default(void) {
     if (state_ptr) {
+        if (!state_ptr->default_geometry_created) {
+            if (!create_default_geometries(state_ptr)) {
+                KFATAL("Failed to create default geometries. Application cannot continue.");
+            }
+            state_ptr->default_geometry_created = true;
+        }
         return &state_ptr->default_geometry;
     }
 
@@ -163,8 +236,6 @@ static b8 create_geometry(geometry_system_state* state, geometry_config config,
     if (!renderer_geometry_create(g, config.vertex_size, config.vertex_count, config.vertices, config.index_size, config.index_count, config.indices)) {
         KERROR("Geometry creation failed during renderer_geometry_create.");
         // Invalidate the entry.
-        state->registered_geometries[g->id].reference_count = 0;
-        state->registered_geometries[g->id].auto_release = false;
         g->id = INVALID_ID;
         g->generation = INVALID_ID_U16;
         return false;
@@ -173,8 +244,6 @@ static b8 create_geometry(geometry_system_state* state, geometry_config config,
     if (!renderer_geometry_upload(g)) {
         KERROR("Geometry creation failed during renderer_geometry_upload.");
         // Invalidate the entry.
-        state->registered_geometries[g->id].reference_count = 0;
-        state->registered_geometries[g->id].auto_release = false;
         g->id = INVALID_ID;
         g->generation = INVALID_ID_U16;
         return false;
@@ -184,8 +253,39 @@ static b8 create_geometry(geometry_system_state* state, geometry_config config,
     g->center = config.center;
     g->extents.min = config.min_extents;
     g->extents.max = config.max_extents;
+    g->vertex_format = config.vertex_format;
+    g->quantization_center = config.quantization_center;
+    g->quantization_scale = config.quantization_scale;
     g->generation++;
 
+    // Copy over the levels of detail, each of which must lie within the indices.
+    g->lod_count = 0;
+    for (u32 i = 0; i < config.lod_count && i < GEOMETRY_MAX_LOD_COUNT; ++i) {
+        if ((u64)config.lods[i].index_offset + config.lods[i].index_count > config.index_count) {
+            KWARN("Level of detail %u of geometry '%s' lies outside its indices and is ignored.", i, config.name);
+            break;
+        }
+        g->lods[g->lod_count++] = config.lods[i];
+    }
+
+    // Take a copy of the clusters, which must lie within the full-detail level.
+    g->cluster_count = 0;
+    g->clusters = 0;
+    if (config.cluster_count && config.clusters) {
+        u64 level_end = g->lod_count ? (u64)g->lods[0].index_offset + g->lods[0].index_count : config.index_count;
+        b8 clusters_valid = true;
+        for (u32 i = 0; i < config.cluster_count && clusters_valid; ++i) {
+            clusters_valid = (u64)config.clusters[i].index_offset + config.clusters[i].index_count <= level_end;
+        }
+        if (!clusters_valid) {
+            KWARN("The clusters of geometry '%s' lie outside its full-detail level and are ignored.", config.name);
+        } else {
+            g->cluster_count = config.cluster_count;
+            g->clusters = kallocate(sizeof(geometry_cluster) * g->cluster_count, MEMORY_TAG_ARRAY);
+            kcopy_memory(g->clusters, config.clusters, sizeof(geometry_cluster) * g->cluster_count);
+        }
+    }
+
     // Acquire the material
     if (string_length(config.material_name) > 0) {
         g->material = material_system_acquire(config.material_name);
@@ -199,6 +299,11 @@ static b8 create_geometry(geometry_system_state* state, geometry_config config,
 
 static void destroy_geometry(geometry_system_state* state, geometry* g) {
     renderer_geometry_destroy(g);
+    if (g->clusters) {
+        kfree(g->clusters, sizeof(geometry_cluster) * g->cluster_count, MEMORY_TAG_ARRAY);
+        g->clusters = 0;
+        g->cluster_count = 0;
+    }
     g->generation = INVALID_ID_U16;
     g->id = INVALID_ID;
 
@@ -211,6 +316,34 @@ static void destroy_geometry(geometry_system_state* state, geometry* g) {
     }
 }
 
+static b8 geometry_system_on_gpu_memory_pressure(u16 code, void* sender, void* listener_inst, event_context context) {
+    if (!context.data.u64[0]) {
+        return false;
+    }
+
+    // Geometries which are not auto-released are kept when no longer referenced, in case they are
+    // acquired again. Under pressure, those are given up instead. Walked backward, as removing an
+    // element moves the last of the dense list into its place.
+    slot_map* map = &state_ptr->registered_geometries;
+    u32 evicted = 0;
+    for (i32 i = (i32)map->count - 1; i >= 0; --i) {
+        geometry_reference* ref = slot_map_dense_get(map, (u32)i);
+        if (ref->reference_count > 0 || ref->auto_release || ref->geometry.id == INVALID_ID || ref->geometry.generation == INVALID_ID_U16) {
+            continue;
+        }
+        slot_map_handle handle = slot_map_handle_get(map, ref->geometry.id);
+        destroy_geometry(state_ptr, &ref->geometry);
+        slot_map_remove(map, handle);
+        evicted++;
+    }
+    if (evicted) {
+        KDEBUG("Evicted %u unused geometries under GPU memory pressure.", evicted);
+    }
+
+    // Other systems may also free memory.
+    return false;
+}
+
 static b8 create_default_geometries(geometry_system_state* state) {
     vertex_3d verts[4];
     kzero_memory(verts, sizeof(vertex_3d) * 4);
@@ -282,7 +415,7 @@ geometry_config geometry_system_generate_plane_config(f32 width, f32 height, u32
         tile_y = 1.0f;
     }
 
-    geometry_config config;
+    geometry_config config = {0};
     config.vertex_size = sizeof(vertex_3d);
     config.vertex_count = x_segment_count * y_segment_count * 4;  // 4 verts per segment
     config.vertices = kallocate(sizeof(vertex_3d) * config.vertex_count, MEMORY_TAG_ARRAY);
@@ -381,7 +514,7 @@ geometry_config geometry_system_generate_cube_config(f32 width, f32 height, f32
         tile_y = 1.0f;
     }
 
-    geometry_config config;
+    geometry_config config = {0};
     config.vertex_size = sizeof(vertex_3d);
     config.vertex_count = 4 * 6;  // 4 verts per side, 6 sides
     config.vertices = kallocate(sizeof(vertex_3d) * config.vertex_count, MEMORY_TAG_ARRAY);
@@ -14,6 +14,8 @@
 
 #include "renderer/renderer_types.h"
 
+struct frame_data;
+
 /** @brief The geometry system configuration. */
 typedef struct geometry_system_config {
     /**
@@ -41,6 +43,26 @@ typedef struct geometry_config {
     u32 index_count;
     /** @brief An array of indices. */
     void* indices;
+    /**
+     * @brief If not 0, the vertices and indices point into this read-only mapping of the file they
+     * were loaded from, rather than being owned by the config. It may be shared by several configs.
+     */
+    struct file_mapping* mapping;
+    /** @brief The layout of the vertices. */
+    geometry_vertex_format vertex_format;
+    /** @brief For packed vertices, the center of the box their positions are stored relative to. */
+    vec3 quantization_center;
+    /** @brief For packed vertices, half the size of that box along each axis. */
+    f32 quantization_scale;
+
+    /** @brief The number of levels of detail. If 0, the geometry has only the one, drawn with all of its indices. */
+    u32 lod_count;
+    /** @brief The levels of detail, from full detail to least. Each covers a range of the indices. */
+    geometry_lod lods[GEOMETRY_MAX_LOD_COUNT];
+    /** @brief The number of clusters the full-detail level is split into. 0 if it isn't. */
+    u32 cluster_count;
+    /** @brief The clusters of the full-detail level, in the order of its indices. */
+    geometry_cluster* clusters;
 
     vec3 center;
     vec3 min_extents;
@@ -74,6 +96,17 @@ b8 geometry_system_initialize(u64* memory_requirement, void* state, void* config
  */
 void geometry_system_shutdown(void* state);
 
+/**
+ * @brief Updates the geometry system. When the global geometry buffers become fragmented, this
+ * moves a few geometries each frame down to lower offsets, until free space is gathered at the end.
+ * Offsets change between frames, so render data built afterward picks them up.
+ *
+ * @param state The state block of memory.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @return True on success; otherwise false.
+ */
+b8 geometry_system_update(void* state, struct frame_data* p_frame_data);
+
 /**
  * @brief Acquires an existing geometry by id.
  *
@@ -2,150 +2,719 @@
 
 #include "containers/ring_queue.h"
 #include "core/frame_data.h"
+#include "core/katomic.h"
+#include "core/kcondvar.h"
+#include "core/kfiber.h"
 #include "core/kmemory.h"
 #include "core/kmutex.h"
+#include "core/kprofiler.h"
 #include "core/kthread.h"
 #include "core/logger.h"
+#include "memory/linear_allocator.h"
+#include "memory/scratch_allocator.h"
+#include "platform/platform.h"
+
+// The max number of jobs that can be in flight (queued or running) at once.
+#define MAX_JOBS 4096
+
+// The number of entries in each thread-owned deque. Must be a power of 2.
+#define JOB_DEQUE_CAPACITY 1024
+
+// The number of job priority levels (see job_priority).
+#define JOB_PRIORITY_COUNT 3
+
+// The number of distinct job types (see job_type), each of which has its own submission queues.
+#define JOB_TYPE_COUNT 3
+
+// The capacity of each of the shared submission queues.
+#define JOB_SUBMIT_QUEUE_CAPACITY 1024
+
+// The max number of job counters that can exist at once.
+#define MAX_JOB_COUNTERS 1024
+
+/** @brief A slot in the job pool holding a job which is queued, waiting on a dependency or running. */
+typedef struct job_entry {
+    job_info info;
+    // Index of the next free entry while this one is in the free list.
+    volatile u32 next_free;
+    // The next job waiting on the same counter, while this one is waiting on a dependency.
+    struct job_entry* next_waiter;
+} job_entry;
+
+/** @brief Internal state of a job counter. */
+typedef struct job_counter_slot {
+    // The number of outstanding jobs signaling this counter.
+    volatile u32 value;
+    // Spinlock guarding waiters, and the transition of value to zero.
+    volatile u32 lock;
+    // Must match the generation of a handle for it to be valid. Bumped whenever the slot is released.
+    volatile u32 generation;
+    // Indicates if the slot is in use.
+    b8 in_use;
+    // Linked list of jobs waiting for this counter to reach zero.
+    job_entry* waiters;
+    // Linked list of fibers of running jobs waiting for this counter to reach zero.
+    struct job_fiber* fiber_waiters;
+} job_counter_slot;
+
+/**
+ * @brief A fixed-size Chase-Lev work-stealing deque of job entries. The owning thread pushes
+ * and pops at the bottom (LIFO, for cache locality), while other threads steal from the top (FIFO).
+ * top and bottom are kept on separate cache lines to avoid false sharing between owner and thieves.
+ */
+typedef struct job_deque {
+    volatile i64 top;
+    u8 padding0[56];
+    volatile i64 bottom;
+    u8 padding1[56];
+    job_entry* volatile entries[JOB_DEQUE_CAPACITY];
+} job_deque;
 
 typedef struct job_thread {
     u8 index;
     kthread thread;
-    job_info info;
-    // A mutex to guard access to this thread's info.
-    kmutex info_mutex;
 
     // The types of jobs this thread can handle.
     u32 type_mask;
+    // The processors this thread is pinned to. None leaves it free to run anywhere.
+    kthread_affinity affinity;
+
+    // Deques owned by this thread, one per priority. Only ever hold jobs this thread can run.
+    job_deque deques[JOB_PRIORITY_COUNT];
+
+    // Set while the thread is (about to be) blocked waiting for work.
+    volatile u32 sleeping;
+    // Guards the sleep/wake handshake for this thread.
+    kmutex sleep_mutex;
+    // Signaled when work is submitted that this thread can handle, or when the system is shutting down.
+    kcondvar sleep_condvar;
+
+    // State for picking steal victims.
+    u32 rng_state;
+
+    // The fiber of the thread itself, which finds jobs and switches to the fibers running them.
+    // Not set if the thread does not use fibers.
+    kfiber scheduler_fiber;
+    // The fiber running on this thread, if any.
+    struct job_fiber* current_fiber;
+    // Fibers whose counters have completed, waiting to resume on this thread. Guarded by ready_lock.
+    struct job_fiber* volatile ready_fibers;
+    volatile u32 ready_lock;
 } job_thread;
 
+/** @brief A fiber which jobs run on, so they can be suspended while they wait. */
+typedef struct job_fiber {
+    kfiber fiber;
+    // Scratch memory of its own, since the jobs of a thread interleave while their fibers wait.
+    linear_allocator scratch;
+    // The job to run, handed over by the thread switching to the fiber for it.
+    job_entry* entry;
+    // The thread the fiber is running on, or waiting to resume on. A waiting fiber resumes on
+    // the same thread, so the thread-local state its job relies on stays the same.
+    job_thread* thread;
+    // The counter the fiber is about to wait on, for its thread to park it on once switched away.
+    job_counter wait_counter;
+    // Set once the job has finished, so the fiber can go back to the pool.
+    b8 finished;
+    // The next fiber in the free list, a counter's waiters or a thread's ready fibers.
+    struct job_fiber* next;
+} job_fiber;
+
 typedef struct job_result_entry {
-    u16 id;
+    // Sequence number used to hand the slot back and forth between producers and the consumer.
+    volatile u32 sequence;
     pfn_job_on_complete callback;
     u32 param_size;
     void* params;
 } job_result_entry;
 
-// The max number of job results that can be stored at once.
+// The max number of job results that can be stored at once. Must be a power of 2.
 #define MAX_JOB_RESULTS 512
 
+/**
+ * @brief A bounded multi-producer, single-consumer queue of results waiting to be processed by
+ * job_system_update. Any thread may push, only the main thread pops.
+ */
+typedef struct job_result_queue {
+    volatile u32 enqueue_pos;
+    u8 pad0[60];
+    // Only touched by the consumer.
+    u32 dequeue_pos;
+    u8 pad1[60];
+    job_result_entry entries[MAX_JOB_RESULTS];
+} job_result_queue;
+
+// The most job and I/O threads there can be between them.
+#define MAX_JOB_THREADS 32
+
 typedef struct job_system_state {
     b8 running;
+    // The total number of threads. The job threads come first, then the I/O threads.
     u8 thread_count;
-    job_thread job_threads[32];
+    // The number of job threads, which run compute work. Any others are I/O threads.
+    u8 compute_thread_count;
+    job_thread job_threads[MAX_JOB_THREADS];
+
+    // Pool of job entries, with a lock-free free list. The head packs an ABA tag in the upper 32 bits.
+    job_entry jobs[MAX_JOBS];
+    volatile u64 free_head;
+
+    // Shared queues of job entry pointers for jobs submitted from outside of job threads, or from
+    // job threads which cannot run the job themselves. Indexed by [priority][type index]. Lock-free,
+    // since jobs can be submitted and taken from any thread.
+    mpmc_ring_queue submit_queues[JOB_PRIORITY_COUNT][JOB_TYPE_COUNT];
 
-    ring_queue low_priority_queue;
-    ring_queue normal_priority_queue;
-    ring_queue high_priority_queue;
+    // Job counters, and a mutex guarding their creation/destruction.
+    job_counter_slot counters[MAX_JOB_COUNTERS];
+    kmutex counter_mutex;
 
-    // Mutexes for each queue, since a job could be kicked off from another job (thread).
-    kmutex low_pri_queue_mutex;
-    kmutex normal_pri_queue_mutex;
-    kmutex high_pri_queue_mutex;
+    // Results waiting for job_system_update to run their callbacks.
+    job_result_queue results;
+    job_result_overflow_policy result_overflow_policy;
+    volatile u64 discarded_result_count;
+    // The thread which runs job_system_update, and thus processes results.
+    u64 main_thread_id;
 
-    job_result_entry pending_results[MAX_JOB_RESULTS];
-    kmutex result_mutex;
-    // A mutex for the result array
+    // The pool of fibers jobs run on, if any, with a free list guarded by fiber_lock.
+    u32 fiber_count;
+    u32 fiber_capacity;
+    job_fiber* fibers;
+    job_fiber* free_fibers;
+    volatile u32 fiber_lock;
 } job_system_state;
 
 static job_system_state* state_ptr;
 
-static void store_result(pfn_job_on_complete callback, u32 param_size, void* params) {
-    // Create the new entry.
-    job_result_entry entry;
-    entry.id = INVALID_ID_U16;
-    entry.param_size = param_size;
-    entry.callback = callback;
-    if (entry.param_size > 0) {
-        // Take a copy, as the job is destroyed after this.
-        entry.params = kallocate(param_size, MEMORY_TAG_JOB);
-        kcopy_memory(entry.params, params, param_size);
-    } else {
-        entry.params = 0;
-    }
+// The index of the job thread the current thread is, or -1 if not a job thread.
+static _Thread_local i32 current_thread_index = -1;
 
-    // Lock, find a free space, store, unlock.
-    if (!kmutex_lock(&state_ptr->result_mutex)) {
-        KERROR("Failed to obtain mutex lock for storing a result! Result storage may be corrupted.");
+static u32 job_type_index(job_type type) {
+    switch (type) {
+        case JOB_TYPE_RESOURCE_LOAD:
+            return 1;
+        case JOB_TYPE_GPU_RESOURCE:
+            return 2;
+        case JOB_TYPE_GENERAL:
+        default:
+            return 0;
     }
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        if (state_ptr->pending_results[i].id == INVALID_ID_U16) {
-            state_ptr->pending_results[i] = entry;
-            state_ptr->pending_results[i].id = i;
-            break;
+}
+
+static const job_type job_types[JOB_TYPE_COUNT] = {JOB_TYPE_GENERAL, JOB_TYPE_RESOURCE_LOAD, JOB_TYPE_GPU_RESOURCE};
+
+// NOTE: Begin job entry pool.
+
+static void job_entry_release(job_entry* entry) {
+    u32 index = (u32)(entry - state_ptr->jobs);
+    u64 old_head = katomic_load_u64(&state_ptr->free_head, KATOMIC_ORDER_RELAXED);
+    u64 new_head;
+    do {
+        katomic_store_u32(&entry->next_free, (u32)old_head, KATOMIC_ORDER_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | index;
+    } while (!katomic_compare_exchange_u64(&state_ptr->free_head, &old_head, new_head, KATOMIC_ORDER_RELEASE));
+}
+
+static job_entry* job_entry_acquire(void) {
+    u64 old_head = katomic_load_u64(&state_ptr->free_head, KATOMIC_ORDER_ACQUIRE);
+    u64 new_head;
+    do {
+        u32 index = (u32)old_head;
+        if (index == INVALID_ID) {
+            return 0;
         }
+        u32 next = katomic_load_u32(&state_ptr->jobs[index].next_free, KATOMIC_ORDER_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | next;
+    } while (!katomic_compare_exchange_u64(&state_ptr->free_head, &old_head, new_head, KATOMIC_ORDER_ACQUIRE));
+    return &state_ptr->jobs[(u32)old_head];
+}
+
+// NOTE: End job entry pool.
+
+// NOTE: Begin work-stealing deque.
+
+// Pushes to the bottom of the deque. Owner thread only. Returns false if full.
+static b8 job_deque_push(job_deque* deque, job_entry* entry) {
+    i64 b = katomic_load_i64(&deque->bottom, KATOMIC_ORDER_RELAXED);
+    i64 t = katomic_load_i64(&deque->top, KATOMIC_ORDER_ACQUIRE);
+    if (b - t >= JOB_DEQUE_CAPACITY) {
+        return false;
     }
-    if (!kmutex_unlock(&state_ptr->result_mutex)) {
-        KERROR("Failed to release mutex lock for result storage, storage may be corrupted.");
+    katomic_store_ptr((void* volatile*)&deque->entries[b & (JOB_DEQUE_CAPACITY - 1)], entry, KATOMIC_ORDER_RELAXED);
+    katomic_thread_fence(KATOMIC_ORDER_RELEASE);
+    katomic_store_i64(&deque->bottom, b + 1, KATOMIC_ORDER_RELAXED);
+    return true;
+}
+
+// Pops from the bottom of the deque. Owner thread only. Returns 0 if empty.
+static job_entry* job_deque_pop(job_deque* deque) {
+    i64 b = katomic_load_i64(&deque->bottom, KATOMIC_ORDER_RELAXED) - 1;
+    katomic_store_i64(&deque->bottom, b, KATOMIC_ORDER_RELAXED);
+    katomic_thread_fence(KATOMIC_ORDER_SEQ_CST);
+    i64 t = katomic_load_i64(&deque->top, KATOMIC_ORDER_RELAXED);
+
+    job_entry* entry = 0;
+    if (t <= b) {
+        entry = katomic_load_ptr((void* volatile*)&deque->entries[b & (JOB_DEQUE_CAPACITY - 1)], KATOMIC_ORDER_RELAXED);
+        if (t == b) {
+            // Last entry, race against thieves for it.
+            if (!katomic_compare_exchange_i64(&deque->top, &t, t + 1, KATOMIC_ORDER_SEQ_CST)) {
+                entry = 0;
+            }
+            katomic_store_i64(&deque->bottom, b + 1, KATOMIC_ORDER_RELAXED);
+        }
+    } else {
+        // Empty.
+        katomic_store_i64(&deque->bottom, b + 1, KATOMIC_ORDER_RELAXED);
     }
+    return entry;
 }
 
-static u32 job_thread_run(void* params) {
-    u32 index = *(u32*)params;
-    job_thread* thread = &state_ptr->job_threads[index];
-    KTRACE("Starting job thread #%i (id=%#x, type=%#x).", thread->index, thread->thread.thread_id, thread->type_mask);
+// Steals from the top of the deque if the entry there can be run by a thread with the given type mask.
+// Any thread. Returns 0 if empty, incompatible or if another thread won the race.
+static job_entry* job_deque_steal(job_deque* deque, u32 type_mask) {
+    i64 t = katomic_load_i64(&deque->top, KATOMIC_ORDER_ACQUIRE);
+    katomic_thread_fence(KATOMIC_ORDER_SEQ_CST);
+    i64 b = katomic_load_i64(&deque->bottom, KATOMIC_ORDER_ACQUIRE);
+    if (t >= b) {
+        return 0;
+    }
 
-    // A mutex to lock info for this thread.
-    if (!kmutex_create(&thread->info_mutex)) {
-        KERROR("Failed to create job thread mutex! Aborting thread.");
+    job_entry* entry = katomic_load_ptr((void* volatile*)&deque->entries[t & (JOB_DEQUE_CAPACITY - 1)], KATOMIC_ORDER_RELAXED);
+    // NOTE: The entry may be taken by another thread after this check, in which case the
+    // exchange below fails and the (possibly stale) type is irrelevant.
+    if ((entry->info.type & type_mask) == 0) {
         return 0;
     }
+    if (!katomic_compare_exchange_i64(&deque->top, &t, t + 1, KATOMIC_ORDER_SEQ_CST)) {
+        return 0;
+    }
+    return entry;
+}
+
+// NOTE: End work-stealing deque.
+
+// NOTE: Begin result queue.
+
+static void job_result_queue_init(job_result_queue* queue) {
+    queue->enqueue_pos = 0;
+    queue->dequeue_pos = 0;
+    for (u32 i = 0; i < MAX_JOB_RESULTS; ++i) {
+        queue->entries[i].sequence = i;
+    }
+}
 
-    // Run forever, waiting for jobs.
+// Safe to call from any thread. Returns false if the queue is full.
+static b8 job_result_queue_push(job_result_queue* queue, pfn_job_on_complete callback, u32 param_size, void* params) {
+    u32 pos = katomic_load_u32(&queue->enqueue_pos, KATOMIC_ORDER_RELAXED);
     while (true) {
-        if (!state_ptr || !state_ptr->running || !thread) {
-            break;
+        job_result_entry* entry = &queue->entries[pos & (MAX_JOB_RESULTS - 1)];
+        u32 sequence = katomic_load_u32(&entry->sequence, KATOMIC_ORDER_ACQUIRE);
+        i32 diff = (i32)(sequence - pos);
+        if (diff == 0) {
+            // The slot is free for this position, try to claim it.
+            if (katomic_compare_exchange_u32(&queue->enqueue_pos, &pos, pos + 1, KATOMIC_ORDER_RELAXED)) {
+                entry->callback = callback;
+                entry->param_size = param_size;
+                entry->params = params;
+                katomic_store_u32(&entry->sequence, pos + 1, KATOMIC_ORDER_RELEASE);
+                return true;
+            }
+            // pos was updated by the failed exchange, try again.
+        } else if (diff < 0) {
+            // The consumer has not freed this slot yet, so the queue is full.
+            return false;
+        } else {
+            // Another producer got here first.
+            pos = katomic_load_u32(&queue->enqueue_pos, KATOMIC_ORDER_RELAXED);
         }
+    }
+}
 
-        // Lock and grab a copy of the info
-        if (!kmutex_lock(&thread->info_mutex)) {
-            KERROR("Failed to obtain lock on job thread mutex!");
-        }
-        job_info info = thread->info;
-        if (!kmutex_unlock(&thread->info_mutex)) {
-            KERROR("Failed to release lock on job thread mutex!");
+// Consumer only. Returns false if the queue is empty.
+static b8 job_result_queue_pop(job_result_queue* queue, job_result_entry* out_entry) {
+    u32 pos = queue->dequeue_pos;
+    job_result_entry* entry = &queue->entries[pos & (MAX_JOB_RESULTS - 1)];
+    u32 sequence = katomic_load_u32(&entry->sequence, KATOMIC_ORDER_ACQUIRE);
+    if (sequence != pos + 1) {
+        return false;
+    }
+    out_entry->callback = entry->callback;
+    out_entry->param_size = entry->param_size;
+    out_entry->params = entry->params;
+    queue->dequeue_pos = pos + 1;
+    // Hand the slot back to producers for the next lap.
+    katomic_store_u32(&entry->sequence, pos + MAX_JOB_RESULTS, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
+// NOTE: End result queue.
+
+// Runs the callbacks of up to max_count pending results. Must only be called from the main thread.
+static void process_results(u32 max_count) {
+    job_result_entry entry;
+    for (u32 i = 0; i < max_count && job_result_queue_pop(&state_ptr->results, &entry); ++i) {
+        entry.callback(entry.params);
+        if (entry.params) {
+            kfree(entry.params, entry.param_size, MEMORY_TAG_JOB);
         }
+    }
+}
 
-        if (info.entry_point) {
-            b8 result = info.entry_point(info.param_data, info.result_data);
+/**
+ * @brief Lets the main thread process results while it waits on the job system, since job
+ * threads may in turn be waiting on it for room in the result queue.
+ */
+static void process_results_if_main_thread(void) {
+    if (platform_current_thread_id() == state_ptr->main_thread_id) {
+        process_results(MAX_JOB_RESULTS);
+    }
+}
 
-            // Store the result to be executed on the main thread later.
-            // Note that store_result takes a copy of the result_data
-            // so it does not have to be held onto by this thread any longer.
-            if (result && info.on_success) {
-                store_result(info.on_success, info.result_data_size, info.result_data);
-            } else if (!result && info.on_fail) {
-                store_result(info.on_fail, info.result_data_size, info.result_data);
+/**
+ * @brief Queues the callback to be run on the main thread. Ownership of params (the job's
+ * result data) is passed along with it, so no copy needs to be made.
+ */
+static void store_result(pfn_job_on_complete callback, u32 param_size, void* params) {
+    u32 attempts = 0;
+    while (!job_result_queue_push(&state_ptr->results, callback, param_size, params)) {
+        if (state_ptr->result_overflow_policy == JOB_RESULT_OVERFLOW_POLICY_DISCARD) {
+            u64 discarded = katomic_fetch_add_u64(&state_ptr->discarded_result_count, 1, KATOMIC_ORDER_RELAXED) + 1;
+            KWARN("Job result queue is full, result discarded (%llu discarded so far).", discarded);
+            if (params) {
+                kfree(params, param_size, MEMORY_TAG_JOB);
             }
+            return;
+        }
 
-            // Clear the param data and result data.
-            if (info.param_data) {
-                kfree(info.param_data, info.param_data_size, MEMORY_TAG_JOB);
+        if (platform_current_thread_id() == state_ptr->main_thread_id) {
+            // The main thread would otherwise be waiting on itself, so make room here.
+            process_results(MAX_JOB_RESULTS);
+        } else {
+            if (attempts == 0) {
+                KWARN("Job result queue is full, waiting for results to be processed.");
             }
-            if (info.result_data) {
-                kfree(info.result_data, info.result_data_size, MEMORY_TAG_JOB);
+            platform_sleep(1);
+        }
+        attempts++;
+    }
+}
+
+static job_entry* take_submitted_job(job_priority priority, u32 type_index) {
+    job_entry* entry = 0;
+    if (!mpmc_ring_queue_dequeue(&state_ptr->submit_queues[priority][type_index], &entry)) {
+        return 0;
+    }
+    return entry;
+}
+
+static job_entry* steal_job(job_thread* thread, u32 type_mask, u32* rng_state, job_priority priority) {
+    // Threads only steal within their own pool, since the other pool never holds jobs they can run.
+    // Threads outside of the job system help the job threads.
+    b8 is_io = thread && thread->index >= state_ptr->compute_thread_count;
+    u8 first = is_io ? state_ptr->compute_thread_count : 0;
+    u8 thread_count = is_io ? state_ptr->thread_count - state_ptr->compute_thread_count : state_ptr->compute_thread_count;
+    if (thread_count < (thread ? 2 : 1)) {
+        return 0;
+    }
+
+    // Start at a random victim so thieves spread out.
+    *rng_state ^= *rng_state << 13;
+    *rng_state ^= *rng_state >> 17;
+    *rng_state ^= *rng_state << 5;
+    u32 start = *rng_state % thread_count;
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        job_thread* victim = &state_ptr->job_threads[first + (start + i) % thread_count];
+        if (victim == thread) {
+            continue;
+        }
+        job_entry* entry = job_deque_steal(&victim->deques[priority], type_mask);
+        if (entry) {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the next job for the given thread to run. Priorities are respected first, then
+ * within a priority jobs are taken from the thread's own deque, then from the shared submission
+ * queues of the types the thread supports, then stolen from other threads.
+ *
+ * @param thread The job thread looking for work, or 0 if the caller is not a job thread.
+ * @param type_mask The types of jobs the caller can run.
+ * @param rng_state State used to pick steal victims.
+ */
+static job_entry* find_job(job_thread* thread, u32 type_mask, u32* rng_state) {
+    for (i32 priority = JOB_PRIORITY_HIGH; priority >= JOB_PRIORITY_LOW; --priority) {
+        job_entry* entry = thread ? job_deque_pop(&thread->deques[priority]) : 0;
+        if (entry) {
+            return entry;
+        }
+
+        for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+            if (type_mask & job_types[t]) {
+                entry = take_submitted_job(priority, t);
+                if (entry) {
+                    return entry;
+                }
             }
+        }
+
+        entry = steal_job(thread, type_mask, rng_state, priority);
+        if (entry) {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+static void counter_signal_complete(job_counter counter);
+
+static void run_job(job_entry* entry) {
+    // Take a copy and return the entry to the pool right away.
+    job_info info = entry->info;
+    job_entry_release(entry);
+
+    KPROFILE_BEGIN("job");
+    b8 result = info.entry_point(info.param_data, info.result_data);
+    KPROFILE_END();
+
+    // Clear the param data.
+    if (info.param_data) {
+        kfree(info.param_data, info.param_data_size, MEMORY_TAG_JOB);
+    }
+
+    // Store the result to be executed on the main thread later.
+    // Note that store_result takes ownership of the result_data, so it
+    // is freed once the callback has been run.
+    pfn_job_on_complete callback = result ? info.on_success : info.on_fail;
+    if (callback) {
+        store_result(callback, info.result_data_size, info.result_data);
+    } else if (info.result_data) {
+        kfree(info.result_data, info.result_data_size, MEMORY_TAG_JOB);
+    }
+
+    // Let anything waiting on this job know it is done.
+    if (info.signal_counter.generation) {
+        counter_signal_complete(info.signal_counter);
+    }
+}
+
+/**
+ * @brief Wakes a single sleeping thread capable of running jobs of the given type, if there is one.
+ * The thread is claimed by clearing its sleeping flag, so that each of a burst of submissions wakes
+ * a different thread rather than signalling the same one again before it has run.
+ */
+static void wake_thread_for(job_type type) {
+    // The job was published with release stores only, which could otherwise be ordered after the
+    // loads of the flags below. A thread about to sleep would then miss the job, and go unwoken.
+    katomic_thread_fence(KATOMIC_ORDER_SEQ_CST);
+    for (u8 i = 0; i < state_ptr->thread_count; ++i) {
+        job_thread* thread = &state_ptr->job_threads[i];
+        u32 expected = 1;
+        if ((thread->type_mask & type) && katomic_load_u32(&thread->sleeping, KATOMIC_ORDER_RELAXED) &&
+            katomic_compare_exchange_u32(&thread->sleeping, &expected, 0, KATOMIC_ORDER_SEQ_CST)) {
+            kmutex_lock(&thread->sleep_mutex);
+            kcondvar_signal(&thread->sleep_condvar);
+            kmutex_unlock(&thread->sleep_mutex);
+            return;
+        }
+    }
+}
+
+// NOTE: Begin fibers.
+
+static void spin_lock(volatile u32* lock) {
+    while (katomic_exchange_u32(lock, 1, KATOMIC_ORDER_ACQUIRE)) {
+        while (katomic_load_u32(lock, KATOMIC_ORDER_RELAXED)) {
+            katomic_pause();
+        }
+    }
+}
+
+static void spin_unlock(volatile u32* lock) {
+    katomic_store_u32(lock, 0, KATOMIC_ORDER_RELEASE);
+}
+
+static job_fiber* fiber_acquire(void) {
+    if (!state_ptr->free_fibers) {
+        return 0;
+    }
+    spin_lock(&state_ptr->fiber_lock);
+    job_fiber* fiber = state_ptr->free_fibers;
+    if (fiber) {
+        state_ptr->free_fibers = fiber->next;
+        fiber->next = 0;
+    }
+    spin_unlock(&state_ptr->fiber_lock);
+    return fiber;
+}
+
+static void fiber_release(job_fiber* fiber) {
+    spin_lock(&state_ptr->fiber_lock);
+    fiber->next = state_ptr->free_fibers;
+    state_ptr->free_fibers = fiber;
+    spin_unlock(&state_ptr->fiber_lock);
+}
+
+static b8 fiber_ready_pending(job_thread* thread) {
+    return katomic_load_ptr((void* volatile*)&thread->ready_fibers, KATOMIC_ORDER_ACQUIRE) != 0;
+}
 
-            // Lock and reset the thread's info object
-            if (!kmutex_lock(&thread->info_mutex)) {
-                KERROR("Failed to obtain lock on job thread mutex!");
+// Hands a fiber whose counter has completed back to its thread to resume, waking it if need be.
+static void fiber_ready_push(job_fiber* fiber) {
+    job_thread* thread = fiber->thread;
+    spin_lock(&thread->ready_lock);
+    fiber->next = thread->ready_fibers;
+    thread->ready_fibers = fiber;
+    spin_unlock(&thread->ready_lock);
+
+    // Publish first, then check the flag, as submitters do for jobs.
+    katomic_thread_fence(KATOMIC_ORDER_SEQ_CST);
+    if (katomic_load_u32(&thread->sleeping, KATOMIC_ORDER_SEQ_CST)) {
+        kmutex_lock(&thread->sleep_mutex);
+        kcondvar_signal(&thread->sleep_condvar);
+        kmutex_unlock(&thread->sleep_mutex);
+    }
+}
+
+static job_fiber* fiber_ready_pop(job_thread* thread) {
+    if (!fiber_ready_pending(thread)) {
+        return 0;
+    }
+    spin_lock(&thread->ready_lock);
+    job_fiber* fiber = thread->ready_fibers;
+    if (fiber) {
+        thread->ready_fibers = fiber->next;
+        fiber->next = 0;
+    }
+    spin_unlock(&thread->ready_lock);
+    return fiber;
+}
+
+// Runs jobs handed to the fiber, switching back to the thread after each.
+static void job_fiber_run(void* params) {
+    job_fiber* fiber = params;
+    while (true) {
+        job_entry* entry = fiber->entry;
+        fiber->entry = 0;
+        run_job(entry);
+        fiber->finished = true;
+        // The next job may be on another thread, which is switched back from here.
+        kfiber_switch(&fiber->fiber, &fiber->thread->scheduler_fiber);
+    }
+}
+
+static job_counter_slot* counter_get(job_counter counter);
+static void counter_lock(job_counter_slot* slot);
+static void counter_unlock(job_counter_slot* slot);
+
+/**
+ * @brief Switches the given thread to run the given fiber, until it finishes its job or waits.
+ * Waiting fibers are parked on their counter only once switched away from, since until then
+ * their state is not saved and no other thread may resume them.
+ */
+static void fiber_switch_to(job_thread* thread, job_fiber* fiber) {
+    fiber->thread = thread;
+    thread->current_fiber = fiber;
+    scratch_allocator_set(&fiber->scratch);
+    kfiber_switch(&thread->scheduler_fiber, &fiber->fiber);
+    scratch_allocator_set(0);
+    thread->current_fiber = 0;
+
+    if (fiber->finished) {
+        fiber_release(fiber);
+        return;
+    }
+
+    job_counter counter = fiber->wait_counter;
+    fiber->wait_counter = (job_counter){0};
+    job_counter_slot* slot = counter_get(counter);
+    if (slot) {
+        counter_lock(slot);
+        if (katomic_load_u32(&slot->value, KATOMIC_ORDER_ACQUIRE) != 0) {
+            fiber->next = slot->fiber_waiters;
+            slot->fiber_waiters = fiber;
+            counter_unlock(slot);
+            return;
+        }
+        counter_unlock(slot);
+    }
+    // The counter completed in the meantime, so the fiber can resume right away.
+    fiber_ready_push(fiber);
+}
+
+// NOTE: End fibers.
+
+static u32 job_thread_run(void* params) {
+    u32 index = *(u8*)params;
+    job_thread* thread = &state_ptr->job_threads[index];
+    current_thread_index = index;
+    b8 is_io = index >= state_ptr->compute_thread_count;
+    KTRACE("Starting %s thread #%i (id=%#x, type=%#x).", is_io ? "I/O" : "job", thread->index, thread->thread.thread_id, thread->type_mask);
+    if (thread->affinity.processor_count && !kthread_affinity_set_current(&thread->affinity)) {
+        KWARN("Job thread #%i could not be pinned to its core, and will run on any.", thread->index);
+    }
+
+    b8 use_fibers = state_ptr->fiber_count && kfiber_thread_convert(&thread->scheduler_fiber);
+    if (state_ptr->fiber_count && !use_fibers) {
+        KWARN("Job thread #%i could not be converted to a fiber, so runs its jobs without.", thread->index);
+    }
+
+    // Run until the system shuts down, blocking while there is no work.
+    while (state_ptr->running) {
+        // Fibers which were waiting take precedence, as their jobs are already underway.
+        job_fiber* ready = use_fibers ? fiber_ready_pop(thread) : 0;
+        if (ready) {
+            fiber_switch_to(thread, ready);
+            continue;
+        }
+
+        job_entry* entry = find_job(thread, thread->type_mask, &thread->rng_state);
+        if (!entry) {
+            // Flag as sleeping first, then check again for work. Submitters push work first, then
+            // check the flag, so either this thread sees the new work or the submitter sees the flag.
+            kmutex_lock(&thread->sleep_mutex);
+            katomic_store_u32(&thread->sleeping, 1, KATOMIC_ORDER_SEQ_CST);
+            entry = find_job(thread, thread->type_mask, &thread->rng_state);
+            while (!entry && !fiber_ready_pending(thread) && state_ptr->running) {
+                kcondvar_wait(&thread->sleep_condvar, &thread->sleep_mutex);
+                // A waker clears the flag to claim this thread. Set it again before checking, in case
+                // the wake was spurious or another thread took the job first.
+                katomic_store_u32(&thread->sleeping, 1, KATOMIC_ORDER_SEQ_CST);
+                entry = find_job(thread, thread->type_mask, &thread->rng_state);
             }
-            kzero_memory(&thread->info, sizeof(job_info));
-            if (!kmutex_unlock(&thread->info_mutex)) {
-                KERROR("Failed to release lock on job thread mutex!");
+            katomic_store_u32(&thread->sleeping, 0, KATOMIC_ORDER_SEQ_CST);
+            kmutex_unlock(&thread->sleep_mutex);
+
+            if (!entry) {
+                if (!state_ptr->running) {
+                    break;
+                }
+                // Woken to resume a fiber.
+                continue;
             }
         }
 
-        if (state_ptr->running) {
-            // TODO: Should probably find a better way to do this, such as sleeping until
-            // a request comes through for a new job.
-            kthread_sleep(&thread->thread, 10);
+        job_fiber* fiber = use_fibers ? fiber_acquire() : 0;
+        if (fiber) {
+            fiber->entry = entry;
+            fiber->finished = false;
+            fiber_switch_to(thread, fiber);
         } else {
-            break;
+            run_job(entry);
         }
     }
 
-    // Destroy the mutex for this thread.
-    kmutex_destroy(&thread->info_mutex);
+    if (use_fibers) {
+        kfiber_thread_revert(&thread->scheduler_fiber);
+    }
+
+    // Hand any cached allocations and scratch memory back before the thread goes away.
+    kmemory_thread_cache_flush();
+    scratch_thread_shutdown();
+
     return 1;
 }
 
@@ -160,125 +729,196 @@ b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void*
 
     state_ptr = state;
     state_ptr->running = true;
+    state_ptr->compute_thread_count = typed_config->max_job_thread_count;
+    u32 io_thread_count = KMIN(typed_config->io_thread_count, MAX_JOB_THREADS - state_ptr->compute_thread_count);
+    state_ptr->thread_count = state_ptr->compute_thread_count + io_thread_count;
 
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->low_priority_queue);
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->normal_priority_queue);
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->high_priority_queue);
-    state_ptr->thread_count = typed_config->max_job_thread_count;
+    // Link up the free list of job entries.
+    for (u32 i = 0; i < MAX_JOBS; ++i) {
+        state_ptr->jobs[i].next_free = (i + 1 < MAX_JOBS) ? i + 1 : INVALID_ID;
+    }
+    state_ptr->free_head = 0;
 
-    // Invalidate all result slots
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        state_ptr->pending_results[i].id = INVALID_ID_U16;
+    // Create submission queues.
+    for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+        for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+            if (!mpmc_ring_queue_create(sizeof(job_entry*), JOB_SUBMIT_QUEUE_CAPACITY, &state_ptr->submit_queues[p][t])) {
+                KERROR("Failed to create submission queue!");
+                return false;
+            }
+        }
     }
 
-    KDEBUG("Main thread id is: %#x", platform_current_thread_id());
+    // Counter generations start at 1, since 0 marks an invalid handle.
+    for (u32 i = 0; i < MAX_JOB_COUNTERS; ++i) {
+        state_ptr->counters[i].generation = 1;
+    }
+    if (!kmutex_create(&state_ptr->counter_mutex)) {
+        KERROR("Failed to create counter mutex!.");
+        return false;
+    }
+    kmutex_name_set(&state_ptr->counter_mutex, "job counters");
 
-    KDEBUG("Spawning %i job threads.", state_ptr->thread_count);
+    job_result_queue_init(&state_ptr->results);
+    state_ptr->result_overflow_policy = typed_config->result_overflow_policy;
+    state_ptr->discarded_result_count = 0;
+
+    state_ptr->main_thread_id = platform_current_thread_id();
+    KDEBUG("Main thread id is: %#x", state_ptr->main_thread_id);
+
+    // Create the pool of fibers, if there is to be one. Fewer than asked for is still usable.
+    state_ptr->fiber_count = 0;
+    state_ptr->fibers = 0;
+    state_ptr->free_fibers = 0;
+    state_ptr->fiber_lock = 0;
+    if (typed_config->fiber_count) {
+        u64 stack_size = typed_config->fiber_stack_size ? typed_config->fiber_stack_size : JOB_FIBER_DEFAULT_STACK_SIZE;
+        state_ptr->fiber_capacity = typed_config->fiber_count;
+        state_ptr->fibers = kallocate(sizeof(job_fiber) * state_ptr->fiber_capacity, MEMORY_TAG_JOB);
+        for (u32 i = 0; i < typed_config->fiber_count; ++i) {
+            job_fiber* fiber = &state_ptr->fibers[state_ptr->fiber_count];
+            if (!kfiber_create(job_fiber_run, fiber, stack_size, &fiber->fiber)) {
+                KWARN("Only %u of %u job fibers could be created.", state_ptr->fiber_count, typed_config->fiber_count);
+                break;
+            }
+            fiber->next = state_ptr->free_fibers;
+            state_ptr->free_fibers = fiber;
+            state_ptr->fiber_count++;
+        }
+        KDEBUG("Created %u job fibers with %lluKiB stacks.", state_ptr->fiber_count, stack_size / 1024);
+    }
+
+    KDEBUG("Spawning %i job threads and %i I/O threads.", state_ptr->compute_thread_count, io_thread_count);
 
     for (u8 i = 0; i < state_ptr->thread_count; ++i) {
-        state_ptr->job_threads[i].index = i;
-        state_ptr->job_threads[i].type_mask = typed_config->type_masks[i];
-        if (!kthread_create(job_thread_run, &state_ptr->job_threads[i].index, false, &state_ptr->job_threads[i].thread)) {
-            KFATAL("OS Error in creating job thread. Application cannot continue.");
+        job_thread* thread = &state_ptr->job_threads[i];
+        thread->index = i;
+        if (i < state_ptr->compute_thread_count) {
+            thread->type_mask = typed_config->type_masks[i];
+            if (typed_config->affinities) {
+                thread->affinity = typed_config->affinities[i];
+            }
+        } else {
+            // I/O threads mostly sleep on the disk, so are left free to run anywhere.
+            thread->type_mask = JOB_TYPE_RESOURCE_LOAD;
+        }
+        thread->rng_state = 0x9E3779B9u * (i + 1);
+
+        // Synchronization objects must exist before the thread starts using them.
+        if (!kmutex_create(&thread->sleep_mutex)) {
+            KFATAL("Failed to create job thread mutex! Application cannot continue.");
+            return false;
+        }
+        kmutex_name_set(&thread->sleep_mutex, "job thread sleep");
+        if (!kcondvar_create(&thread->sleep_condvar)) {
+            KFATAL("Failed to create job thread condition variable! Application cannot continue.");
             return false;
         }
-        kzero_memory(&state_ptr->job_threads[i].info, sizeof(job_info));
     }
 
-    // Create needed mutexes
-    if (!kmutex_create(&state_ptr->result_mutex)) {
-        KERROR("Failed to create result mutex!.");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->low_pri_queue_mutex)) {
-        KERROR("Failed to create low priority queue mutex!.");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->normal_pri_queue_mutex)) {
-        KERROR("Failed to create normal priority queue mutex!.");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->high_pri_queue_mutex)) {
-        KERROR("Failed to create high priority queue mutex!.");
-        return false;
+    // Start the threads only once they all exist, since they steal from each other.
+    for (u8 i = 0; i < state_ptr->thread_count; ++i) {
+        job_thread* thread = &state_ptr->job_threads[i];
+        if (!kthread_create(job_thread_run, &thread->index, false, &thread->thread)) {
+            KFATAL("OS Error in creating job thread. Application cannot continue.");
+            return false;
+        }
     }
 
     return true;
 }
 
+static void discard_job(job_entry* entry) {
+    if (entry->info.param_data) {
+        kfree(entry->info.param_data, entry->info.param_data_size, MEMORY_TAG_JOB);
+    }
+    if (entry->info.result_data) {
+        kfree(entry->info.result_data, entry->info.result_data_size, MEMORY_TAG_JOB);
+    }
+}
+
 void job_system_shutdown(void* state) {
     if (state_ptr) {
         state_ptr->running = false;
 
         u64 thread_count = state_ptr->thread_count;
 
-        // Check for a free thread first.
+        // Wake all threads so they see the system is no longer running, then wait for them to exit.
         for (u8 i = 0; i < thread_count; ++i) {
-            kthread_destroy(&state_ptr->job_threads[i].thread);
+            job_thread* thread = &state_ptr->job_threads[i];
+            kmutex_lock(&thread->sleep_mutex);
+            kcondvar_broadcast(&thread->sleep_condvar);
+            kmutex_unlock(&thread->sleep_mutex);
         }
-        ring_queue_destroy(&state_ptr->low_priority_queue);
-        ring_queue_destroy(&state_ptr->normal_priority_queue);
-        ring_queue_destroy(&state_ptr->high_priority_queue);
-
-        // Destroy mutexes
-        kmutex_destroy(&state_ptr->result_mutex);
-        kmutex_destroy(&state_ptr->low_pri_queue_mutex);
-        kmutex_destroy(&state_ptr->normal_pri_queue_mutex);
-        kmutex_destroy(&state_ptr->high_pri_queue_mutex);
-
-        state_ptr = 0;
-    }
-}
-
-static void process_queue(ring_queue* queue, kmutex* queue_mutex) {
-    u64 thread_count = state_ptr->thread_count;
-
-    // Check for a free thread first.
-    while (queue->length > 0) {
-        job_info info;
-        if (!ring_queue_peek(queue, &info)) {
-            break;
+        for (u8 i = 0; i < thread_count; ++i) {
+            job_thread* thread = &state_ptr->job_threads[i];
+            kthread_wait(&thread->thread);
+            kthread_destroy(&thread->thread);
         }
 
-        b8 thread_found = false;
+        // Discard any jobs which never got to run. Safe to pop from any deque now that the threads are gone.
         for (u8 i = 0; i < thread_count; ++i) {
             job_thread* thread = &state_ptr->job_threads[i];
-            if ((thread->type_mask & info.type) == 0) {
-                continue;
-            }
-
-            // Check that the job thread can handle the job type.
-            if (!kmutex_lock(&thread->info_mutex)) {
-                KERROR("Failed to obtain lock on job thread mutex!");
-            }
-            if (!thread->info.entry_point) {
-                // Make sure to remove the entry from the queue.
-                if (!kmutex_lock(queue_mutex)) {
-                    KERROR("Failed to obtain lock on queue mutex!");
+            for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+                job_entry* entry;
+                while ((entry = job_deque_pop(&thread->deques[p]))) {
+                    discard_job(entry);
                 }
-                ring_queue_dequeue(queue, &info);
-                if (!kmutex_unlock(queue_mutex)) {
-                    KERROR("Failed to release lock on queue mutex!");
+            }
+            kcondvar_destroy(&thread->sleep_condvar);
+            kmutex_destroy(&thread->sleep_mutex);
+        }
+        for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+            for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+                job_entry* entry;
+                while ((entry = take_submitted_job(p, t))) {
+                    discard_job(entry);
                 }
-                thread->info = info;
-                KTRACE("Assigning job to thread: %u", thread->index);
-                thread_found = true;
+                mpmc_ring_queue_destroy(&state_ptr->submit_queues[p][t]);
             }
-            if (!kmutex_unlock(&thread->info_mutex)) {
-                KERROR("Failed to release lock on job thread mutex!");
+        }
+
+        // Discard any jobs still waiting on counters.
+        for (u32 i = 0; i < MAX_JOB_COUNTERS; ++i) {
+            job_entry* waiter = state_ptr->counters[i].waiters;
+            while (waiter) {
+                discard_job(waiter);
+                waiter = waiter->next_waiter;
             }
+        }
 
-            // Break after unlocking if an available thread was found.
-            if (thread_found) {
-                break;
+        // Fibers still in use belong to jobs which were waiting when the threads stopped, which
+        // are abandoned along with them.
+        if (state_ptr->fibers) {
+            u32 free_count = 0;
+            for (job_fiber* fiber = state_ptr->free_fibers; fiber; fiber = fiber->next) {
+                free_count++;
+            }
+            if (free_count < state_ptr->fiber_count) {
+                KWARN("%u jobs were still waiting on counters at shutdown, and were abandoned.", state_ptr->fiber_count - free_count);
             }
+            for (u32 i = 0; i < state_ptr->fiber_count; ++i) {
+                kfiber_destroy(&state_ptr->fibers[i].fiber);
+                if (state_ptr->fibers[i].scratch.memory) {
+                    linear_allocator_destroy(&state_ptr->fibers[i].scratch);
+                }
+            }
+            kfree(state_ptr->fibers, sizeof(job_fiber) * state_ptr->fiber_capacity, MEMORY_TAG_JOB);
+            state_ptr->fibers = 0;
         }
 
-        // This means all of the threads are currently handling a job,
-        // So wait until the next update and try again.
-        if (!thread_found) {
-            break;
+        // Release the data of any results which were never processed.
+        job_result_entry result;
+        while (job_result_queue_pop(&state_ptr->results, &result)) {
+            if (result.params) {
+                kfree(result.params, result.param_size, MEMORY_TAG_JOB);
+            }
         }
+
+        // Destroy mutexes
+        kmutex_destroy(&state_ptr->counter_mutex);
+
+        state_ptr = 0;
     }
 }
 
@@ -287,93 +927,375 @@ b8 job_system_update(void* state, struct frame_data* p_frame_data) {
         return false;
     }
 
-    process_queue(&state_ptr->high_priority_queue, &state_ptr->high_pri_queue_mutex);
-    process_queue(&state_ptr->normal_priority_queue, &state_ptr->normal_pri_queue_mutex);
-    process_queue(&state_ptr->low_priority_queue, &state_ptr->low_pri_queue_mutex);
+    // NOTE: Jobs are no longer dispatched from here. Job threads pick up submitted work themselves,
+    // so all that is left to do on the main thread is to run completion callbacks.
+    // Process pending results. Limited to one queue's worth, so a steady stream of
+    // completions cannot hold up the frame.
+    process_results(MAX_JOB_RESULTS);
 
-    // Process pending results.
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        // Lock and take a copy, unlock.
-        if (!kmutex_lock(&state_ptr->result_mutex)) {
-            KERROR("Failed to obtain lock on result mutex!");
+    return true;
+}
+
+/**
+ * @brief Makes the given job available to run, either on the calling job thread's own deque
+ * or on the shared submission queue for its priority and type.
+ */
+static void schedule_job(job_entry* entry) {
+    job_priority priority = entry->info.priority;
+    if (priority > JOB_PRIORITY_HIGH) {
+        priority = JOB_PRIORITY_HIGH;
+    }
+
+    // A job thread submitting a job it can run itself pushes it onto its own deque,
+    // where it will either be run by this thread or stolen by an idle one.
+    if (current_thread_index >= 0) {
+        job_thread* self = &state_ptr->job_threads[current_thread_index];
+        if ((self->type_mask & entry->info.type) && job_deque_push(&self->deques[priority], entry)) {
+            wake_thread_for(entry->info.type);
+            return;
         }
-        job_result_entry entry = state_ptr->pending_results[i];
-        if (!kmutex_unlock(&state_ptr->result_mutex)) {
-            KERROR("Failed to release lock on result mutex!");
+    }
+
+    // Otherwise it goes on the shared queue for its priority and type.
+    u32 type_index = job_type_index(entry->info.type);
+    mpmc_ring_queue* queue = &state_ptr->submit_queues[priority][type_index];
+
+    while (true) {
+        if (mpmc_ring_queue_enqueue(queue, &entry)) {
+            break;
         }
 
-        if (entry.id != INVALID_ID_U16) {
-            // Execute the callback.
-            entry.callback(entry.params);
+        // The queue is full. Rather than drop the job, a job thread which can run it does so
+        // right away, while anything else waits for the job threads to make room.
+        if (current_thread_index >= 0 && (state_ptr->job_threads[current_thread_index].type_mask & entry->info.type)) {
+            run_job(entry);
+            return;
+        }
+        wake_thread_for(entry->info.type);
+        process_results_if_main_thread();
+        platform_sleep(1);
+    }
 
-            if (entry.params) {
-                kfree(entry.params, entry.param_size, MEMORY_TAG_JOB);
-            }
+    wake_thread_for(entry->info.type);
+}
 
-            // Lock actual entry, invalidate and clear it
-            if (!kmutex_lock(&state_ptr->result_mutex)) {
-                KERROR("Failed to obtain lock on result mutex!");
-            }
-            kzero_memory(&state_ptr->pending_results[i], sizeof(job_result_entry));
-            state_ptr->pending_results[i].id = INVALID_ID_U16;
-            if (!kmutex_unlock(&state_ptr->result_mutex)) {
-                KERROR("Failed to release lock on result mutex!");
-            }
+// NOTE: Begin job counters.
+
+static job_counter_slot* counter_get(job_counter counter) {
+    if (!state_ptr || counter.generation == 0 || counter.index >= MAX_JOB_COUNTERS) {
+        return 0;
+    }
+    job_counter_slot* slot = &state_ptr->counters[counter.index];
+    if (katomic_load_u32(&slot->generation, KATOMIC_ORDER_ACQUIRE) != counter.generation) {
+        return 0;
+    }
+    return slot;
+}
+
+static void counter_lock(job_counter_slot* slot) {
+    spin_lock(&slot->lock);
+}
+
+static void counter_unlock(job_counter_slot* slot) {
+    spin_unlock(&slot->lock);
+}
+
+static void counter_signal_complete(job_counter counter) {
+    job_counter_slot* slot = counter_get(counter);
+    if (!slot) {
+        KWARN("A job completed with a stale or invalid signal counter. Was it destroyed too early?");
+        return;
+    }
+
+    // Take the waiters when the last outstanding job completes.
+    job_entry* waiters = 0;
+    job_fiber* fiber_waiters = 0;
+    counter_lock(slot);
+    if (katomic_fetch_sub_u32(&slot->value, 1, KATOMIC_ORDER_ACQ_REL) == 1) {
+        waiters = slot->waiters;
+        slot->waiters = 0;
+        fiber_waiters = slot->fiber_waiters;
+        slot->fiber_waiters = 0;
+    }
+    counter_unlock(slot);
+
+    // Resume the fibers that were waiting on it, each on its own thread.
+    while (fiber_waiters) {
+        job_fiber* next = fiber_waiters->next;
+        fiber_waiters->next = 0;
+        fiber_ready_push(fiber_waiters);
+        fiber_waiters = next;
+    }
+
+    // Release the jobs that were waiting on it.
+    while (waiters) {
+        job_entry* next = waiters->next_waiter;
+        waiters->next_waiter = 0;
+        schedule_job(waiters);
+        waiters = next;
+    }
+}
+
+job_counter job_counter_create(void) {
+    job_counter counter = {0};
+    if (!state_ptr) {
+        return counter;
+    }
+
+    kmutex_lock(&state_ptr->counter_mutex);
+    for (u32 i = 0; i < MAX_JOB_COUNTERS; ++i) {
+        job_counter_slot* slot = &state_ptr->counters[i];
+        if (!slot->in_use) {
+            slot->in_use = true;
+            slot->value = 0;
+            slot->waiters = 0;
+            slot->fiber_waiters = 0;
+            counter.index = i;
+            counter.generation = katomic_load_u32(&slot->generation, KATOMIC_ORDER_RELAXED);
+            break;
+        }
+    }
+    kmutex_unlock(&state_ptr->counter_mutex);
+
+    if (!counter.generation) {
+        KERROR("job_counter_create - no job counters available (max %u).", MAX_JOB_COUNTERS);
+    }
+    return counter;
+}
+
+void job_counter_destroy(job_counter counter) {
+    job_counter_slot* slot = counter_get(counter);
+    if (!slot) {
+        return;
+    }
+
+    kmutex_lock(&state_ptr->counter_mutex);
+    if (katomic_load_u32(&slot->value, KATOMIC_ORDER_ACQUIRE) != 0 || slot->waiters || slot->fiber_waiters) {
+        KWARN("job_counter_destroy - destroying a counter which still has outstanding or waiting jobs.");
+    }
+    // Bump the generation (skipping 0, which is invalid) so existing handles become stale.
+    u32 generation = slot->generation + 1;
+    katomic_store_u32(&slot->generation, generation ? generation : 1, KATOMIC_ORDER_RELEASE);
+    slot->in_use = false;
+    kmutex_unlock(&state_ptr->counter_mutex);
+}
+
+b8 job_counter_is_complete(job_counter counter) {
+    job_counter_slot* slot = counter_get(counter);
+    return !slot || katomic_load_u32(&slot->value, KATOMIC_ORDER_ACQUIRE) == 0;
+}
+
+void job_counter_wait(job_counter counter) {
+    job_counter_slot* slot = counter_get(counter);
+    if (!slot) {
+        return;
+    }
+
+    job_thread* self = current_thread_index >= 0 ? &state_ptr->job_threads[current_thread_index] : 0;
+
+    // A job on a fiber yields until the counter completes, leaving its thread to other jobs. It
+    // resumes on this same thread, so self stays valid.
+    if (self && self->current_fiber) {
+        job_fiber* fiber = self->current_fiber;
+        while ((slot = counter_get(counter)) && katomic_load_u32(&slot->value, KATOMIC_ORDER_ACQUIRE) != 0) {
+            fiber->wait_counter = counter;
+            kfiber_switch(&fiber->fiber, &self->scheduler_fiber);
         }
+        return;
+    }
+
+    // Help out while waiting. Threads outside of the job system only take general jobs.
+    u32 type_mask = self ? self->type_mask : JOB_TYPE_GENERAL;
+    u32 rng_state = self ? self->rng_state : 0x2545F491u;
+    u32 idle_spins = 0;
+    while (katomic_load_u32(&slot->value, KATOMIC_ORDER_ACQUIRE) != 0) {
+        job_entry* entry = find_job(self, type_mask, self ? &self->rng_state : &rng_state);
+        if (entry) {
+            run_job(entry);
+            idle_spins = 0;
+        } else if (++idle_spins < 64) {
+            katomic_pause();
+        } else {
+            // Nothing to help with, so give the time slice back.
+            process_results_if_main_thread();
+            platform_sleep(0);
+        }
+    }
+}
+
+void job_set_counters(job_info* info, job_counter signal_counter, job_counter dependency) {
+    if (info) {
+        info->signal_counter = signal_counter;
+        info->dependency = dependency;
     }
+}
+
+// NOTE: End job counters.
+
+// NOTE: Begin parallel for.
+
+/**
+ * @brief Shared state of a parallel-for. Heap-allocated and reference counted, so the caller can
+ * return as soon as all batches are done, even if some helper jobs have not started yet.
+ */
+typedef struct parallel_for_context {
+    pfn_job_parallel_for fn;
+    void* user_data;
+    u32 count;
+    u32 batch_size;
+    u32 batch_count;
+    // The next batch to be claimed.
+    volatile u32 next_batch;
+    // The number of batches which have finished.
+    volatile u32 completed_batches;
+    // The caller plus each helper job holds a reference.
+    volatile u32 ref_count;
+} parallel_for_context;
 
+static void parallel_for_context_release(parallel_for_context* context) {
+    if (katomic_fetch_sub_u32(&context->ref_count, 1, KATOMIC_ORDER_ACQ_REL) == 1) {
+        kfree(context, sizeof(parallel_for_context), MEMORY_TAG_JOB);
+    }
+}
+
+// Claims and runs batches until there are none left.
+static void parallel_for_run_batches(parallel_for_context* context) {
+    while (true) {
+        u32 batch = katomic_fetch_add_u32(&context->next_batch, 1, KATOMIC_ORDER_RELAXED);
+        if (batch >= context->batch_count) {
+            break;
+        }
+        u32 start = batch * context->batch_size;
+        u32 end = KMIN(start + context->batch_size, context->count);
+        context->fn(start, end, context->user_data);
+        katomic_fetch_add_u32(&context->completed_batches, 1, KATOMIC_ORDER_RELEASE);
+    }
+}
+
+static b8 parallel_for_job_start(void* params, void* result_data) {
+    parallel_for_context* context = *(parallel_for_context**)params;
+    parallel_for_run_batches(context);
+    parallel_for_context_release(context);
     return true;
 }
 
-void job_system_submit(job_info info) {
-    u64 thread_count = state_ptr->thread_count;
-    ring_queue* queue = &state_ptr->normal_priority_queue;
-    kmutex* queue_mutex = &state_ptr->normal_pri_queue_mutex;
+void job_parallel_for(u32 count, u32 batch_size, pfn_job_parallel_for fn, void* user_data) {
+    if (!fn || count == 0) {
+        return;
+    }
 
-    // If the job is high priority, try to kick it off immediately.
-    if (info.priority == JOB_PRIORITY_HIGH) {
-        queue = &state_ptr->high_priority_queue;
-        queue_mutex = &state_ptr->high_pri_queue_mutex;
+    // Count the threads which can help out.
+    u32 helper_threads = 0;
+    if (state_ptr) {
+        for (u8 i = 0; i < state_ptr->thread_count; ++i) {
+            if ((state_ptr->job_threads[i].type_mask & JOB_TYPE_GENERAL) && (i32)i != current_thread_index) {
+                helper_threads++;
+            }
+        }
+    }
 
-        // Check for a free thread that supports the job type first.
-        for (u8 i = 0; i < thread_count; ++i) {
-            job_thread* thread = &state_ptr->job_threads[i];
-            if (state_ptr->job_threads[i].type_mask & info.type) {
-                b8 found = false;
-                if (!kmutex_lock(&thread->info_mutex)) {
-                    KERROR("Failed to obtain lock on job thread mutex!");
-                }
-                if (!state_ptr->job_threads[i].info.entry_point) {
-                    KTRACE("Job immediately submitted on thread %i", state_ptr->job_threads[i].index);
-                    state_ptr->job_threads[i].info = info;
-                    found = true;
-                }
-                if (!kmutex_unlock(&thread->info_mutex)) {
-                    KERROR("Failed to release lock on job thread mutex!");
-                }
-                if (found) {
-                    return;
-                }
+    if (batch_size == 0) {
+        // Aim for a few batches per thread to even out the load.
+        batch_size = KMAX(1, count / ((helper_threads + 1) * 4));
+    }
+    u32 batch_count = (count + batch_size - 1) / batch_size;
+
+    // Not worth going wide, so just do it here.
+    if (batch_count == 1 || helper_threads == 0) {
+        fn(0, count, user_data);
+        return;
+    }
+
+    u32 helper_count = KMIN(helper_threads, batch_count - 1);
+
+    parallel_for_context* context = kallocate(sizeof(parallel_for_context), MEMORY_TAG_JOB);
+    context->fn = fn;
+    context->user_data = user_data;
+    context->count = count;
+    context->batch_size = batch_size;
+    context->batch_count = batch_count;
+    context->next_batch = 0;
+    context->completed_batches = 0;
+    context->ref_count = helper_count + 1;
+
+    for (u32 i = 0; i < helper_count; ++i) {
+        job_info job = job_create_priority(parallel_for_job_start, 0, 0, &context, sizeof(parallel_for_context*), 0, JOB_TYPE_GENERAL, JOB_PRIORITY_HIGH);
+        job_system_submit(job);
+    }
+
+    // Pitch in, then wait for any batches still running elsewhere.
+    parallel_for_run_batches(context);
+    u32 spins = 0;
+    while (katomic_load_u32(&context->completed_batches, KATOMIC_ORDER_ACQUIRE) < batch_count) {
+        if (++spins < 256) {
+            katomic_pause();
+        } else {
+            platform_sleep(0);
+        }
+    }
+
+    parallel_for_context_release(context);
+}
+
+// NOTE: End parallel for.
+
+void job_system_submit(job_info info) {
+    job_entry* entry = job_entry_acquire();
+    if (!entry) {
+        KWARN("job_system_submit - job pool exhausted (max %u in flight), waiting for a free slot.", MAX_JOBS);
+    }
+    while (!entry) {
+        // The pool is exhausted. A job thread helps drain it by running a job itself,
+        // anything else gives the job threads a chance to catch up.
+        if (current_thread_index >= 0) {
+            job_thread* self = &state_ptr->job_threads[current_thread_index];
+            job_entry* other = find_job(self, self->type_mask, &self->rng_state);
+            if (other) {
+                run_job(other);
             }
+        } else {
+            process_results_if_main_thread();
+            platform_sleep(1);
         }
+        entry = job_entry_acquire();
     }
+    entry->info = info;
+
 
-    // If this point is reached, all threads are busy (if high) or it can wait a frame.
-    // Add to the queue and try again next cycle.
-    if (info.priority == JOB_PRIORITY_LOW) {
-        queue = &state_ptr->low_priority_queue;
-        queue_mutex = &state_ptr->low_pri_queue_mutex;
+    // Count the job against its counter right away, so waiting on the counter covers it even
+    // before it is able to run.
+    if (info.signal_counter.generation) {
+        job_counter_slot* signal = counter_get(info.signal_counter);
+        if (signal) {
+            katomic_fetch_add_u32(&signal->value, 1, KATOMIC_ORDER_ACQ_REL);
+        } else {
+            KWARN("job_system_submit - stale or invalid signal counter ignored.");
+            entry->info.signal_counter = (job_counter){0};
+        }
     }
 
-    // NOTE: Locking here in case the job is submitted from another job/thread.
-    if (!kmutex_lock(queue_mutex)) {
-        KERROR("Failed to obtain lock on queue mutex!");
+    // If the job depends on a counter which has not reached zero yet, park it on that counter.
+    // It gets scheduled when the last job signaling the counter completes.
+    job_counter_slot* dependency = counter_get(info.dependency);
+    if (dependency) {
+        counter_lock(dependency);
+        if (katomic_load_u32(&dependency->value, KATOMIC_ORDER_ACQUIRE) != 0) {
+            entry->next_waiter = dependency->waiters;
+            dependency->waiters = entry;
+            counter_unlock(dependency);
+            return;
+        }
+        counter_unlock(dependency);
     }
-    ring_queue_enqueue(queue, &info);
-    if (!kmutex_unlock(queue_mutex)) {
-        KERROR("Failed to release lock on queue mutex!");
+
+    schedule_job(entry);
+}
+
+u64 job_system_discarded_result_count(void) {
+    if (!state_ptr) {
+        return 0;
     }
-    KTRACE("Job queued.");
+    return katomic_load_u64(&state_ptr->discarded_result_count, KATOMIC_ORDER_RELAXED);
 }
 
 job_info job_create(pfn_job_start entry_point, pfn_job_on_complete on_success, pfn_job_on_complete on_fail, void* param_data, u32 param_data_size, u32 result_data_size) {
@@ -407,5 +1329,8 @@ job_info job_create_priority(pfn_job_start entry_point, pfn_job_on_complete on_s
         job.result_data = 0;
     }
 
+    job.signal_counter = (job_counter){0};
+    job.dependency = (job_counter){0};
+
     return job;
 }
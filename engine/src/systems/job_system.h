@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/kthread.h"
 #include "defines.h"
 
 /** @brief A function pointer definition for jobs. */
@@ -8,6 +9,14 @@ typedef b8 (*pfn_job_start)(void*, void*);
 /** @brief A function pointer definition for completion of a job. */
 typedef void (*pfn_job_on_complete)(void*);
 
+/**
+ * @brief A function pointer definition for a batch of a parallel-for.
+ * @param start The first index of the batch.
+ * @param end One past the last index of the batch.
+ * @param user_data The user data passed to job_parallel_for.
+ */
+typedef void (*pfn_job_parallel_for)(u32 start, u32 end, void* user_data);
+
 struct frame_data;
 
 /** @brief Describes a type of job */
@@ -19,8 +28,10 @@ typedef enum job_type {
     JOB_TYPE_GENERAL = 0x02,
 
     /**
-     * @brief A resource loading job. Resources should always load on the same thread
-     * to avoid potential disk thrashing.
+     * @brief A resource loading job, which spends most of its time blocked on the disk. Run by
+     * the I/O threads when there are any (see job_system_config), so it never holds up compute
+     * jobs. Work on the loaded data which is heavy enough to be worth spreading out should be
+     * submitted from the job as general jobs.
      */
     JOB_TYPE_RESOURCE_LOAD = 0x04,
 
@@ -46,6 +57,23 @@ typedef enum job_priority {
     JOB_PRIORITY_HIGH
 } job_priority;
 
+/**
+ * @brief A handle to a job counter. A counter tracks the number of outstanding jobs which
+ * signal it, and reaches zero once they have all completed. Callers can wait on a counter,
+ * and jobs can depend on one so that they only start once it reaches zero, which allows
+ * chains and graphs of jobs to be built without bouncing through completion callbacks on
+ * the main thread. A zeroed-out handle is invalid (i.e. no counter).
+ *
+ * NOTE: A job depending on a counter which is already zero starts right away, so jobs
+ * signaling a counter should be submitted before the jobs which depend on it.
+ */
+typedef struct job_counter {
+    /** @brief The index of the counter within the job system. */
+    u32 index;
+    /** @brief The generation of the counter, used to detect stale handles. 0 is invalid. */
+    u32 generation;
+} job_counter;
+
 /**
  * @brief Describes a job to be run.
  */
@@ -76,8 +104,38 @@ typedef struct job_info {
 
     /** @brief The size of the data passed to the success/fail function. */
     u32 result_data_size;
+
+    /**
+     * @brief A counter which is incremented when this job is submitted and decremented once
+     * its entry point has completed (regardless of result). Optional.
+     */
+    job_counter signal_counter;
+
+    /** @brief A counter which must reach zero before this job can start. Optional. */
+    job_counter dependency;
 } job_info;
 
+/**
+ * @brief Determines what happens when a job completes while the queue of results waiting for
+ * job_system_update is full.
+ */
+typedef enum job_result_overflow_policy {
+    /**
+     * @brief The completing thread waits for the main thread to make room. If the main thread
+     * itself completes a job while the queue is full, pending results are processed right there.
+     * This is the default.
+     */
+    JOB_RESULT_OVERFLOW_POLICY_WAIT = 0,
+    /**
+     * @brief The result is discarded (its callback never runs) and a warning is logged. Discarded
+     * results can be counted via job_system_discarded_result_count.
+     */
+    JOB_RESULT_OVERFLOW_POLICY_DISCARD = 1
+} job_result_overflow_policy;
+
+/** @brief The size of each fiber's stack, unless configured otherwise. */
+#define JOB_FIBER_DEFAULT_STACK_SIZE KIBIBYTES(256)
+
 typedef struct job_system_config {
     /**
      * @param max_job_thread_count The maximum number of job threads to be spun up.
@@ -86,6 +144,28 @@ typedef struct job_system_config {
     u8 max_job_thread_count;
     /** @param type_masks A collection of type masks for each job thread. Must match max_job_thread_count. */
     u32* type_masks;
+    /** @param result_overflow_policy What to do when the result queue is full. Defaults to waiting. */
+    job_result_overflow_policy result_overflow_policy;
+    /**
+     * @param affinities The processors each job thread is pinned to, one per thread (matching
+     * max_job_thread_count). Optional; 0 leaves the threads free to run anywhere.
+     */
+    kthread_affinity* affinities;
+    /**
+     * @param io_thread_count The number of I/O threads, a pool apart from the job threads which
+     * runs only JOB_TYPE_RESOURCE_LOAD jobs from a queue of its own. 0 leaves these jobs to the job
+     * threads with that type in their masks.
+     */
+    u8 io_thread_count;
+    /**
+     * @param fiber_count The number of fibers jobs run on. A job on a fiber which waits on a
+     * counter yields, leaving its thread to run other jobs until the counter completes, then
+     * resumes on the same thread. 0 runs jobs on the threads themselves, where waiting blocks.
+     * Jobs run on their threads too while every fiber is in use.
+     */
+    u32 fiber_count;
+    /** @param fiber_stack_size The size of each fiber's stack in bytes. 0 defaults to JOB_FIBER_DEFAULT_STACK_SIZE. */
+    u64 fiber_stack_size;
 } job_system_config;
 
 /**
@@ -96,17 +176,24 @@ typedef struct job_system_config {
  * @param config A pointer to the configuration (job_system_config) of this system.
  * @returns True if the job system started up successfully; otherwise false.
  */
-b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void* config);
+KAPI b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void* config);
 
 /**
  * @brief Shuts the job system down.
  */
-void job_system_shutdown(void* state);
+KAPI void job_system_shutdown(void* state);
 
 /**
  * @brief Updates the job system. Should happen once an update cycle.
  */
-b8 job_system_update(void* state, struct frame_data* p_frame_data);
+KAPI b8 job_system_update(void* state, struct frame_data* p_frame_data);
+
+/**
+ * @brief Obtains the number of job results discarded so far because the result queue was full.
+ * Only ever non-zero when using JOB_RESULT_OVERFLOW_POLICY_DISCARD.
+ * @returns The number of discarded results.
+ */
+KAPI u64 job_system_discarded_result_count(void);
 
 /**
  * @brief Submits the provided job to be queued for execution.
@@ -114,6 +201,60 @@ b8 job_system_update(void* state, struct frame_data* p_frame_data);
  */
 KAPI void job_system_submit(job_info info);
 
+/**
+ * @brief Creates a new job counter with a count of zero, which can be used to wait on or
+ * chain from jobs which signal it.
+ * @returns A handle to the new counter. The handle is invalid (generation of 0) if no counters are available.
+ */
+KAPI job_counter job_counter_create(void);
+
+/**
+ * @brief Destroys the given job counter, releasing it for reuse. Should only be done once
+ * no jobs signal or depend on it any longer.
+ * @param counter The counter to destroy.
+ */
+KAPI void job_counter_destroy(job_counter counter);
+
+/**
+ * @brief Indicates if all jobs signaling the given counter have completed.
+ * @param counter The counter to check.
+ * @returns True if the count is zero, or if the handle is invalid/stale; otherwise false.
+ */
+KAPI b8 job_counter_is_complete(job_counter counter);
+
+/**
+ * @brief Blocks until all jobs signaling the given counter have completed. Called from a job on a
+ * fiber, the fiber yields until then and its thread goes on to other jobs. Otherwise, while
+ * waiting, the calling thread helps by running other jobs it is able to run.
+ *
+ * NOTE: Other jobs run on the thread while a fiber waits, so a job must not wait while in the
+ * middle of something relying on thread-local state, such as recording renderer commands. Each
+ * fiber has scratch memory of its own, so scratch scopes are safe to keep open.
+ * @param counter The counter to wait on.
+ */
+KAPI void job_counter_wait(job_counter counter);
+
+/**
+ * @brief Sets up the given job to signal the counter upon completion, and/or depend on another
+ * counter reaching zero before it starts.
+ * @param info A pointer to the job to configure.
+ * @param signal_counter The counter to signal when the job completes. Pass a zeroed handle if not used.
+ * @param dependency The counter to wait on before starting. Pass a zeroed handle if not used.
+ */
+KAPI void job_set_counters(job_info* info, job_counter signal_counter, job_counter dependency);
+
+/**
+ * @brief Splits the range [0, count) into batches of batch_size, runs them in parallel on the
+ * job threads (general job types only) as well as the calling thread, and returns once every
+ * batch has completed. Batches may run in any order and on any thread, so fn must be safe to
+ * call concurrently for different ranges. May be called from within a job.
+ * @param count The number of items in the range.
+ * @param batch_size The max number of items per batch. Pass 0 to pick one automatically.
+ * @param fn A pointer to the function to be invoked for each batch. Required.
+ * @param user_data Data to be passed to fn. Optional.
+ */
+KAPI void job_parallel_for(u32 count, u32 batch_size, pfn_job_parallel_for fn, void* user_data);
+
 /**
  * @brief Creates a new job with default type (Generic) and priority (Normal).
  * @param entry_point A pointer to a function to be invoked when the job starts. Required.
@@ -1,13 +1,29 @@
 #include "light_system.h"
 
+#include "containers/darray.h"
+#include "core/frame_data.h"
+#include "core/kmemory.h"
 #include "core/logger.h"
 #include "core/systems_manager.h"
-
-#define MAX_POINT_LIGHTS 10
+#include "renderer/light_cluster.h"
+#include "renderer/renderer_frontend.h"
 
 typedef struct light_system_state {
     directional_light* dir_light;
-    point_light* p_lights[MAX_POINT_LIGHTS];
+    // darray of point lights.
+    point_light** p_lights;
+    // Point lights culled into clusters for the view being rendered.
+    light_cluster_grid clusters;
+    // The frame the clusters were last built for.
+    u64 clusters_frame_number;
+
+    // The point lights casting shadows, and their shadows.
+    u32 shadow_count;
+    point_light* shadow_lights[MAX_POINT_LIGHT_SHADOWS];
+    point_light_shadow_data shadows[MAX_POINT_LIGHT_SHADOWS];
+    // Holds MAX_POINT_LIGHT_SHADOWS shadows. Created on first upload.
+    renderbuffer shadow_buffer;
+    b8 shadow_buffer_created;
 } light_system_state;
 
 b8 light_system_initialize(u64* memory_requirement, void* memory, void* config) {
@@ -16,13 +32,29 @@ b8 light_system_initialize(u64* memory_requirement, void* memory, void* config)
         return true;
     }
 
-    // NOTE: perform config/init here.
+    light_system_state* state = memory;
+    state->dir_light = 0;
+    state->p_lights = darray_create(point_light*);
+    if (!light_cluster_grid_create(&state->clusters)) {
+        KERROR("Failed to create light cluster grid.");
+        return false;
+    }
+    state->clusters_frame_number = INVALID_ID_U64;
     return true;
 }
 
 void light_system_shutdown(void* state) {
     if (state) {
-        // NOTE: perform teardown here.
+        light_system_state* typed_state = state;
+        light_cluster_grid_destroy(&typed_state->clusters);
+        if (typed_state->shadow_buffer_created) {
+            renderer_renderbuffer_destroy(&typed_state->shadow_buffer);
+            typed_state->shadow_buffer_created = false;
+        }
+        if (typed_state->p_lights) {
+            darray_destroy(typed_state->p_lights);
+            typed_state->p_lights = 0;
+        }
     }
 }
 
@@ -40,16 +72,8 @@ b8 light_system_point_add(point_light* light) {
         return false;
     }
     light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
-    for (u32 i = 0; i < MAX_POINT_LIGHTS; ++i) {
-        if (!state->p_lights[i]) {
-            state->p_lights[i] = light;
-            return true;
-        }
-    }
-
-    // We're full, so fail.
-    KERROR("light_system_add_point already has the max of %u lights. Light not added.", MAX_POINT_LIGHTS);
-    return false;
+    darray_push(state->p_lights, light);
+    return true;
 }
 
 b8 light_system_directional_remove(directional_light* light) {
@@ -70,9 +94,11 @@ b8 light_system_point_remove(point_light* light) {
         return false;
     }
     light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
-    for (u32 i = 0; i < MAX_POINT_LIGHTS; ++i) {
+    u32 count = darray_length(state->p_lights);
+    for (u32 i = 0; i < count; ++i) {
         if (state->p_lights[i] == light) {
-            state->p_lights[i] = 0;
+            point_light* removed;
+            darray_pop_at(state->p_lights, i, &removed);
             return true;
         }
     }
@@ -88,14 +114,7 @@ directional_light* light_system_directional_light_get(void) {
 
 u32 light_system_point_light_count(void) {
     light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
-    i32 count = 0;
-    for (u32 i = 0; i < MAX_POINT_LIGHTS; ++i) {
-        if (state->p_lights[i]) {
-            count++;
-        }
-    }
-
-    return count;
+    return darray_length(state->p_lights);
 }
 
 b8 light_system_point_lights_get(point_light* p_lights) {
@@ -103,12 +122,85 @@ b8 light_system_point_lights_get(point_light* p_lights) {
         return false;
     }
     light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
-    for (u32 i = 0, j = 0; i < MAX_POINT_LIGHTS; ++i) {
-        if (state->p_lights[i]) {
-            p_lights[j] = *(state->p_lights[i]);
-            j++;
+    u32 count = darray_length(state->p_lights);
+    for (u32 i = 0; i < count; ++i) {
+        p_lights[i] = *(state->p_lights[i]);
+    }
+
+    return true;
+}
+
+b8 light_system_clusters_update(struct frame_data* p_frame_data, const mat4* projection, const mat4* view) {
+    light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
+    if (state->clusters_frame_number == p_frame_data->renderer_frame_number) {
+        return true;
+    }
+
+    u32 count = darray_length(state->p_lights);
+    point_light_data* datas = p_frame_data->allocator.allocate(sizeof(point_light_data) * KMAX(count, 1));
+    for (u32 i = 0; i < count; ++i) {
+        datas[i] = state->p_lights[i]->data;
+        datas[i].shadow_index = -1;
+        for (u32 s = 0; s < state->shadow_count; ++s) {
+            if (state->shadow_lights[s] == state->p_lights[i]) {
+                datas[i].shadow_index = (i32)s;
+                break;
+            }
         }
     }
 
+    if (!light_cluster_grid_build(&state->clusters, count, datas, projection, view, p_frame_data)) {
+        KERROR("Failed to build point light clusters.");
+        return false;
+    }
+    if (!light_cluster_grid_upload(&state->clusters)) {
+        KERROR("Failed to upload point light clusters.");
+        return false;
+    }
+
+    // The shadow buffer must always exist to be bound, even when no light casts shadows.
+    if (!state->shadow_buffer_created) {
+        if (!renderer_renderbuffer_create("renderbuffer_point_light_shadows", RENDERBUFFER_TYPE_STORAGE, sizeof(point_light_shadow_data) * MAX_POINT_LIGHT_SHADOWS, RENDERBUFFER_TRACK_TYPE_NONE, &state->shadow_buffer)) {
+            KERROR("Failed to create point light shadow buffer.");
+            return false;
+        }
+        renderer_renderbuffer_bind(&state->shadow_buffer, 0);
+        state->shadow_buffer_created = true;
+    }
+    if (state->shadow_count && !renderer_renderbuffer_load_range(&state->shadow_buffer, 0, sizeof(point_light_shadow_data) * state->shadow_count, state->shadows)) {
+        KERROR("Failed to upload point light shadows.");
+        return false;
+    }
+
+    state->clusters_frame_number = p_frame_data->renderer_frame_number;
+    return true;
+}
+
+b8 light_system_point_shadows_set(u32 count, point_light* const* lights, const point_light_shadow_data* shadows) {
+    if (count > MAX_POINT_LIGHT_SHADOWS || (count && (!lights || !shadows))) {
+        KERROR("light_system_point_shadows_set requires at most %u lights, each with a shadow.", MAX_POINT_LIGHT_SHADOWS);
+        return false;
+    }
+    light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
+    state->shadow_count = count;
+    if (count) {
+        kcopy_memory(state->shadow_lights, lights, sizeof(point_light*) * count);
+        kcopy_memory(state->shadows, shadows, sizeof(point_light_shadow_data) * count);
+    }
     return true;
 }
+
+struct renderbuffer* light_system_point_light_buffer_get(void) {
+    light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
+    return state->clusters.light_buffer_size ? &state->clusters.light_buffer : 0;
+}
+
+struct renderbuffer* light_system_cluster_buffer_get(void) {
+    light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
+    return state->clusters.grid_buffer_size ? &state->clusters.grid_buffer : 0;
+}
+
+struct renderbuffer* light_system_point_shadow_buffer_get(void) {
+    light_system_state* state = systems_manager_get_state(K_SYSTEM_TYPE_LIGHT);
+    return state->shadow_buffer_created ? &state->shadow_buffer : 0;
+}
@@ -15,6 +15,9 @@
 
 #include "math/math_types.h"
 
+struct frame_data;
+struct renderbuffer;
+
 typedef struct directional_light_data {
     /** @brief The light colour. */
     vec4 colour;
@@ -45,10 +48,27 @@ typedef struct point_light_data {
     f32 linear;
     /** @brief Makes the light fall off slower at longer distances. */
     f32 quadratic;
-    /** @brief Additional padding used for memory alignment purposes. Ignored. */
-    f32 padding;
+    /** @brief The index of the light's shadow in the point shadow buffer, or -1 if it casts none. Set by the light system. */
+    i32 shadow_index;
 } point_light_data;
 
+/** @brief The most point lights which may cast shadows at once. */
+#define MAX_POINT_LIGHT_SHADOWS 8
+
+/**
+ * @brief The shadow of a point light, rendered into six faces of a depth atlas. Laid out to
+ * match the std430 layout read by shaders.
+ */
+typedef struct point_light_shadow_data {
+    /** @brief The view projection each face was rendered with, ordered +x, -x, +y, -y, +z, -z. */
+    mat4 face_view_projections[6];
+    /**
+     * @brief x = the atlas layer of the first static face, y = the atlas layer of the first face of
+     * dynamic casters, or -1 if there are none, z = the depth bias, w = unused.
+     */
+    vec4 params;
+} point_light_shadow_data;
+
 /**
  * @brief A point light, the most common light source, which radiates out from the
  * given position.
@@ -91,7 +111,8 @@ void light_system_shutdown(void* state);
 KAPI b8 light_system_directional_add(directional_light* light);
 
 /**
- * @brief Attempts to add a point light to the system.
+ * @brief Attempts to add a point light to the system. There is no limit on the
+ * number of point lights, as shaders only evaluate those affecting each cluster.
  *
  * @param light A pointer to the light to be added.
  * @return True on success; otherwise false.
@@ -140,3 +161,52 @@ KAPI u32 light_system_point_light_count(void);
  * @return True on success; otherwise false.
  */
 KAPI b8 light_system_point_lights_get(point_light* p_lights);
+
+/**
+ * @brief Culls the point lights into the clusters of the given view and uploads them
+ * to the buffers returned by light_system_point_light_buffer_get() and
+ * light_system_cluster_buffer_get(). Only the first call in a frame does anything, so
+ * every user of the buffers within a frame shares the first view passed.
+ *
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param projection A constant pointer to the projection matrix of the view.
+ * @param view A constant pointer to the view matrix of the view.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 light_system_clusters_update(struct frame_data* p_frame_data, const mat4* projection, const mat4* view);
+
+/**
+ * @brief Sets the point lights casting shadows, and their shadows. Kept until set again, and
+ * uploaded by the next light_system_clusters_update(), which points each light at its shadow.
+ *
+ * @param count The number of shadows. At most MAX_POINT_LIGHT_SHADOWS.
+ * @param lights An array of count pointers to the lights casting the shadows.
+ * @param shadows An array of count shadows, at the same index as their lights.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 light_system_point_shadows_set(u32 count, point_light* const* lights, const point_light_shadow_data* shadows);
+
+/**
+ * @brief Obtains the storage buffer holding the point lights, as an array of
+ * point_light_data. Null until light_system_clusters_update() has first been called.
+ *
+ * @return A pointer to the point light buffer.
+ */
+KAPI struct renderbuffer* light_system_point_light_buffer_get(void);
+
+/**
+ * @brief Obtains the storage buffer holding the point light clusters, laid out as
+ * described in light_cluster.h. Null until light_system_clusters_update() has first
+ * been called.
+ *
+ * @return A pointer to the light cluster buffer.
+ */
+KAPI struct renderbuffer* light_system_cluster_buffer_get(void);
+
+/**
+ * @brief Obtains the storage buffer holding the point light shadows, as an array of
+ * point_light_shadow_data. Null until light_system_clusters_update() has first been called.
+ *
+ * @return A pointer to the point shadow buffer.
+ */
+KAPI struct renderbuffer* light_system_point_shadow_buffer_get(void);
@@ -1,10 +1,11 @@
 #include "material_system.h"
 
 #include "containers/darray.h"
-#include "containers/hashtable.h"
+#include "containers/hashmap.h"
 #include "core/event.h"
 #include "core/frame_data.h"
 #include "core/kmemory.h"
+#include "core/kname.h"
 #include "core/kstring.h"
 #include "core/kvar.h"
 #include "core/logger.h"
@@ -13,13 +14,14 @@
 #include "renderer/renderer_frontend.h"
 #include "renderer/renderer_types.h"
 #include "resources/resource_types.h"
+#include "systems/job_system.h"
 #include "systems/light_system.h"
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
 
 #ifndef PBR_MAP_COUNT
-#define PBR_MAP_COUNT 5
+#define PBR_MAP_COUNT 8
 #endif
 
 #define MAX_SHADOW_CASCADE_COUNT 4
@@ -30,6 +32,9 @@ const u32 SAMP_NORMAL = 1;
 const u32 SAMP_COMBINED = 2;
 const u32 SAMP_SHADOW_MAP = 3;
 const u32 SAMP_IRRADIANCE_MAP = 4;
+const u32 SAMP_IBL_SPECULAR_MAP = 5;
+const u32 SAMP_IBL_BRDF_LUT_MAP = 6;
+const u32 SAMP_POINT_SHADOW_MAP = 7;
 
 // The number of textures for a PBR material
 #define PBR_MATERIAL_TEXTURE_COUNT 3
@@ -40,29 +45,38 @@ const u32 SAMP_TERRAIN_SHADOW_MAP = 1 + SAMP_TERRAIN_MATERIAL_ARRAY_MAP;
 const u32 SAMP_TERRAIN_IRRADIANCE_MAP = 1 + SAMP_TERRAIN_SHADOW_MAP;
 // 1 array map for terrain materials, 1 for shadow map, 1 for irradiance map
 const u32 TERRAIN_SAMP_COUNT = 3;
+// Heightmap terrain materials have one more, for the heightmap the terrain's vertices are pulled from.
+const u32 SAMP_TERRAIN_HEIGHTMAP = 1 + SAMP_TERRAIN_IRRADIANCE_MAP;
+const u32 HEIGHTMAP_TERRAIN_SAMP_COUNT = 4;
 
 #define MAX_TERRAIN_MATERIAL_COUNT 4
 
+// The number of entries the PBR parameter buffer starts with. Doubled whenever an instance id falls outside it.
+#define PARAMETER_BUFFER_INITIAL_CAPACITY 64
+
 typedef struct pbr_shader_uniform_locations {
     u16 projection;
     u16 view;
     u16 cascade_splits;
     u16 view_position;
-    u16 properties;
     u16 ibl_cube_texture;
+    u16 ibl_specular_texture;
+    u16 ibl_brdf_lut;
     u16 material_texures;
     u16 shadow_textures;
     u16 light_space_0;
     u16 light_space_1;
     u16 light_space_2;
     u16 light_space_3;
-    u16 model;
     u16 render_mode;
     u16 use_pcf;
     u16 bias;
+    u16 use_ibl_specular;
     u16 dir_light;
-    u16 p_lights;
-    u16 num_p_lights;
+    u16 point_lights;
+    u16 light_clusters;
+    u16 point_shadows;
+    u16 point_shadow_textures;
 } pbr_shader_uniform_locations;
 
 typedef struct ui_shader_uniform_locations {
@@ -82,8 +96,8 @@ typedef struct terrain_shader_locations {
     u16 model;
     u16 render_mode;
     u16 dir_light;
-    u16 p_lights;
-    u16 num_p_lights;
+    u16 point_lights;
+    u16 light_clusters;
 
     u16 properties;
     u16 ibl_cube_texture;
@@ -95,8 +109,33 @@ typedef struct terrain_shader_locations {
     u16 material_texures;
     u16 use_pcf;
     u16 bias;
+    // Only in the heightmap terrain shader.
+    u16 heightmap;
+    // Indicates the shader's only local is its model matrix, so it can be pushed as is.
+    b8 local_block_valid;
 } terrain_shader_locations;
 
+// A registered material reloaded when its file changes.
+typedef struct material_watch {
+    // The resource system's watch of the material file.
+    u32 watch_id;
+    // The handle of the material.
+    u32 handle;
+    // The name of the material resource, which may differ from the name in its config.
+    kname resource_name;
+} material_watch;
+
+// Tracks the materials using a PBR shader instance. Materials with identical parameters share one.
+typedef struct material_instance_share {
+    // The number of materials using the instance. 0 if the instance isn't tracked.
+    u32 material_count;
+    // Hash of the parameters of the materials using the instance.
+    u64 hash;
+    // The frame and draw the instance was last updated for, so it is updated once per draw however many materials use it.
+    u64 render_frame_number;
+    u8 render_draw_index;
+} material_instance_share;
+
 typedef struct material_system_state {
     material_system_config config;
 
@@ -106,28 +145,57 @@ typedef struct material_system_state {
     // Array of registered materials.
     material* registered_materials;
 
-    // Hashtable for material lookups.
-    hashtable registered_material_table;
+    // Lookup of material kname->material_reference.
+    hashmap registered_material_table;
 
     // Known locations for terrain shader.
     terrain_shader_locations terrain_locations;
     u32 terrain_shader_id;
     shader* terrain_shader;
 
+    // Known locations for the heightmap terrain shader, which draws vertex-pulled terrains. INVALID_ID if it doesn't exist.
+    terrain_shader_locations terrain_heightmap_locations;
+    u32 terrain_heightmap_shader_id;
+    shader* terrain_heightmap_shader;
+
     // Known locations for the PBR shader.
     pbr_shader_uniform_locations pbr_locations;
     u32 pbr_shader_id;
     shader* pbr_shader;
+    // The index of the PBR shader's normal mapping specialization constant. INVALID_ID_U8 if it has none.
+    u8 pbr_normal_map_specialization;
+    // The index of the PBR shader's weighted blending specialization constant. INVALID_ID_U8 if it has none.
+    u8 pbr_weighted_blend_specialization;
+    // The index of the PBR shader's shadow quality specialization constant. INVALID_ID_U8 if it has none.
+    u8 pbr_shadow_quality_specialization;
+    // Indicates materials are drawn with their weighted blended variants, until changed.
+    b8 weighted_blend;
+    // darray of the materials sharing each PBR shader instance, indexed by instance id.
+    material_instance_share* pbr_instance_shares;
+    // Storage buffer of the parameters of every PBR material, indexed by instance id.
+    renderbuffer parameter_buffer;
+    // The number of entries the parameter buffer holds. 0 if it hasn't been created.
+    u32 parameter_capacity;
 
     // The current irradiance cubemap texture to be used.
     texture* irradiance_cube_texture;
+    // The current prefiltered specular cubemap and BRDF lookup table. Both 0 while specular image based lighting is unavailable.
+    texture* ibl_specular_cube_texture;
+    texture* ibl_brdf_lut;
 
     // The current shadow texture to be used for the next draw.
     texture* shadow_texture;
+    // The current point shadow atlas to be used for the next draw.
+    texture* point_shadow_texture;
 
     mat4 directional_light_space[MAX_SHADOW_CASCADE_COUNT];
 
     i32 use_pcf;
+    // The shadow filtering quality of PBR materials, from 0 to MATERIAL_SHADOW_QUALITY_MAX. See the shadow_quality kvar.
+    i32 shadow_quality;
+
+    // darray of materials watched for hot reloading.
+    material_watch* watches;
 } material_system_state;
 
 typedef struct material_reference {
@@ -136,14 +204,43 @@ typedef struct material_reference {
     b8 auto_release;
 } material_reference;
 
+// Also used as result_data from job.
+typedef struct material_reload_params {
+    // The name of the material, to tell if its slot was reused before the job finished.
+    char name[MATERIAL_NAME_MAX_LENGTH];
+    // The name of the material resource to be loaded.
+    char resource_name[MATERIAL_NAME_MAX_LENGTH];
+    u32 handle;
+    resource material_resource;
+} material_reload_params;
+
 static material_system_state* state_ptr = 0;
 
+// Obtains a printable name for logging.
+static const char* material_name_get(kname name) {
+    const char* name_str = kname_string_get(name);
+    return name_str ? name_str : "<unknown>";
+}
+
 static b8 create_default_pbr_material(material_system_state* state);
 static b8 create_default_terrain_material(material_system_state* state);
 static b8 load_material(material_config* config, material* m);
 static void destroy_material(material* m);
-
-static b8 assign_map(texture_map* map, const material_map* config, const char* material_name, texture* default_tex);
+static material* default_pbr_material_get(void);
+static material* default_terrain_material_get(void);
+static void terrain_shader_locations_get(shader* s, terrain_shader_locations* out_locations);
+static const terrain_shader_locations* terrain_locations_get(u32 shader_id);
+static material* terrain_material_acquire(const char* material_name, u32 material_count, const char** material_names, texture* heightmap, b8 auto_release);
+
+static b8 assign_map(texture_map* map, const material_map* config, const char* material_name, texture* default_tex, b8 streamed);
+static void material_watch_remove(u32 handle);
+static material_instance_share* pbr_instance_share_get(const material* m);
+static b8 parameter_buffer_ensure_capacity(u32 count);
+static b8 pbr_parameters_upload(const material* m);
+static b8 material_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context);
+static u32 pbr_variant_get(const material* m, b8 weighted);
+static u64 pbr_instance_hash(const material* m);
+static void pbr_variants_refresh(void);
 
 static b8 material_system_on_event(u16 code, void* sender, void* listener_inst, event_context context) {
     if (code == EVENT_CODE_KVAR_CHANGED) {
@@ -151,6 +248,16 @@ static b8 material_system_on_event(u16 code, void* sender, void* listener_inst,
             kvar_int_get("use_pcf", &state_ptr->use_pcf);
             return true;
         }
+        if (strings_equali("shadow_quality", context.data.c)) {
+            i32 quality = 0;
+            kvar_int_get("shadow_quality", &quality);
+            quality = KCLAMP(quality, 0, MATERIAL_SHADOW_QUALITY_MAX);
+            if (quality != state_ptr->shadow_quality) {
+                state_ptr->shadow_quality = quality;
+                pbr_variants_refresh();
+            }
+            return true;
+        }
     }
 
     return false;
@@ -163,11 +270,12 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
         return false;
     }
 
-    // Block of memory will contain state structure, then block for array, then block for hashtable.
+    // Block of memory will contain state structure, then block for array, then block for the lookup.
     u64 struct_requirement = sizeof(material_system_state);
     u64 array_requirement = sizeof(material) * typed_config->max_material_count;
-    u64 hashtable_requirement = sizeof(material_reference) * typed_config->max_material_count;
-    *memory_requirement = struct_requirement + array_requirement + hashtable_requirement;
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(material_reference), typed_config->max_material_count, &lookup_requirement, 0, 0);
+    *memory_requirement = struct_requirement + array_requirement + lookup_requirement;
 
     if (!state) {
         return true;
@@ -179,20 +287,22 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->pbr_shader_id = INVALID_ID;
     state_ptr->pbr_locations.view = INVALID_ID_U16;
     state_ptr->pbr_locations.projection = INVALID_ID_U16;
-    state_ptr->pbr_locations.properties = INVALID_ID_U16;
     state_ptr->pbr_locations.ibl_cube_texture = INVALID_ID_U16;
+    state_ptr->pbr_locations.ibl_specular_texture = INVALID_ID_U16;
+    state_ptr->pbr_locations.ibl_brdf_lut = INVALID_ID_U16;
     state_ptr->pbr_locations.material_texures = INVALID_ID_U16;
     state_ptr->pbr_locations.shadow_textures = INVALID_ID_U16;
     state_ptr->pbr_locations.cascade_splits = INVALID_ID_U16;
-    state_ptr->pbr_locations.model = INVALID_ID_U16;
     state_ptr->pbr_locations.render_mode = INVALID_ID_U16;
-    state_ptr->pbr_locations.properties = INVALID_ID_U16;
     state_ptr->pbr_locations.light_space_0 = INVALID_ID_U16;
     state_ptr->pbr_locations.light_space_1 = INVALID_ID_U16;
     state_ptr->pbr_locations.light_space_2 = INVALID_ID_U16;
     state_ptr->pbr_locations.light_space_3 = INVALID_ID_U16;
     state_ptr->pbr_locations.use_pcf = INVALID_ID_U16;
     state_ptr->pbr_locations.bias = INVALID_ID_U16;
+    state_ptr->pbr_locations.use_ibl_specular = INVALID_ID_U16;
+    state_ptr->pbr_locations.point_shadows = INVALID_ID_U16;
+    state_ptr->pbr_locations.point_shadow_textures = INVALID_ID_U16;
 
     state_ptr->terrain_locations.projection = INVALID_ID_U16;
     state_ptr->terrain_locations.view = INVALID_ID_U16;
@@ -201,8 +311,8 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->terrain_locations.model = INVALID_ID_U16;
     state_ptr->terrain_locations.render_mode = INVALID_ID_U16;
     state_ptr->terrain_locations.dir_light = INVALID_ID_U16;
-    state_ptr->terrain_locations.p_lights = INVALID_ID_U16;
-    state_ptr->terrain_locations.num_p_lights = INVALID_ID_U16;
+    state_ptr->terrain_locations.point_lights = INVALID_ID_U16;
+    state_ptr->terrain_locations.light_clusters = INVALID_ID_U16;
     state_ptr->terrain_locations.properties = INVALID_ID_U16;
     state_ptr->terrain_locations.material_texures = INVALID_ID_U16;
     state_ptr->terrain_locations.ibl_cube_texture = INVALID_ID_U16;
@@ -213,23 +323,17 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->terrain_locations.light_space_3 = INVALID_ID_U16;
     state_ptr->terrain_locations.use_pcf = INVALID_ID_U16;
     state_ptr->terrain_locations.bias = INVALID_ID_U16;
+    state_ptr->terrain_locations.heightmap = INVALID_ID_U16;
 
     // The array block is after the state. Already allocated, so just set the pointer.
     void* array_block = state + struct_requirement;
     state_ptr->registered_materials = array_block;
 
-    // Hashtable block is after array.
-    void* hashtable_block = array_block + array_requirement;
+    // Lookup block is after array.
+    void* lookup_block = array_block + array_requirement;
 
-    // Create a hashtable for material lookups.
-    hashtable_create(sizeof(material_reference), typed_config->max_material_count, hashtable_block, false, &state_ptr->registered_material_table);
-
-    // Fill the hashtable with invalid references to use as a default.
-    material_reference invalid_ref;
-    invalid_ref.auto_release = false;
-    invalid_ref.handle = INVALID_ID;  // Primary reason for needing default values.
-    invalid_ref.reference_count = 0;
-    hashtable_fill(&state_ptr->registered_material_table, &invalid_ref);
+    // Create a lookup for materials by kname.
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(material_reference), typed_config->max_material_count, &lookup_requirement, lookup_block, &state_ptr->registered_material_table);
 
     // Invalidate all materials in the array.
     u32 count = state_ptr->config.max_material_count;
@@ -243,6 +347,13 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     // Get the uniform indices.
     // Save off the locations for known types for quick lookups.
     state_ptr->pbr_shader = shader_system_get("Shader.PBRMaterial");
+    state_ptr->pbr_normal_map_specialization = shader_system_specialization_index(state_ptr->pbr_shader, "use_normal_map");
+    state_ptr->pbr_weighted_blend_specialization = shader_system_specialization_index(state_ptr->pbr_shader, "weighted_blend");
+    state_ptr->pbr_shadow_quality_specialization = shader_system_specialization_index(state_ptr->pbr_shader, "shadow_quality");
+    state_ptr->pbr_instance_shares = darray_create(material_instance_share);
+    if (!parameter_buffer_ensure_capacity(PARAMETER_BUFFER_INITIAL_CAPACITY)) {
+        return false;
+    }
     state_ptr->pbr_shader_id = state_ptr->pbr_shader->id;
     state_ptr->pbr_locations.projection = shader_system_uniform_location(state_ptr->pbr_shader, "projection");
     state_ptr->pbr_locations.view = shader_system_uniform_location(state_ptr->pbr_shader, "view");
@@ -252,40 +363,31 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->pbr_locations.light_space_3 = shader_system_uniform_location(state_ptr->pbr_shader, "light_space_3");
     state_ptr->pbr_locations.cascade_splits = shader_system_uniform_location(state_ptr->pbr_shader, "cascade_splits");
     state_ptr->pbr_locations.view_position = shader_system_uniform_location(state_ptr->pbr_shader, "view_position");
-    state_ptr->pbr_locations.properties = shader_system_uniform_location(state_ptr->pbr_shader, "properties");
     state_ptr->pbr_locations.material_texures = shader_system_uniform_location(state_ptr->pbr_shader, "material_textures");
     state_ptr->pbr_locations.shadow_textures = shader_system_uniform_location(state_ptr->pbr_shader, "shadow_textures");
     state_ptr->pbr_locations.ibl_cube_texture = shader_system_uniform_location(state_ptr->pbr_shader, "ibl_cube_texture");
-    state_ptr->pbr_locations.model = shader_system_uniform_location(state_ptr->pbr_shader, "model");
+    state_ptr->pbr_locations.ibl_specular_texture = shader_system_uniform_location(state_ptr->pbr_shader, "ibl_specular_texture");
+    state_ptr->pbr_locations.ibl_brdf_lut = shader_system_uniform_location(state_ptr->pbr_shader, "ibl_brdf_lut");
     state_ptr->pbr_locations.render_mode = shader_system_uniform_location(state_ptr->pbr_shader, "mode");
     state_ptr->pbr_locations.dir_light = shader_system_uniform_location(state_ptr->pbr_shader, "dir_light");
-    state_ptr->pbr_locations.p_lights = shader_system_uniform_location(state_ptr->pbr_shader, "p_lights");
-    state_ptr->pbr_locations.num_p_lights = shader_system_uniform_location(state_ptr->pbr_shader, "num_p_lights");
+    state_ptr->pbr_locations.point_lights = shader_system_uniform_location(state_ptr->pbr_shader, "point_lights");
+    state_ptr->pbr_locations.light_clusters = shader_system_uniform_location(state_ptr->pbr_shader, "light_clusters");
+    state_ptr->pbr_locations.point_shadows = shader_system_uniform_location(state_ptr->pbr_shader, "point_shadows");
+    state_ptr->pbr_locations.point_shadow_textures = shader_system_uniform_location(state_ptr->pbr_shader, "point_shadow_textures");
     state_ptr->pbr_locations.use_pcf = shader_system_uniform_location(state_ptr->pbr_shader, "use_pcf");
     state_ptr->pbr_locations.bias = shader_system_uniform_location(state_ptr->pbr_shader, "bias");
+    state_ptr->pbr_locations.use_ibl_specular = shader_system_uniform_location(state_ptr->pbr_shader, "use_ibl_specular");
 
     state_ptr->terrain_shader = shader_system_get("Shader.Builtin.Terrain");
     state_ptr->terrain_shader_id = state_ptr->terrain_shader->id;
-    state_ptr->terrain_locations.projection = shader_system_uniform_location(state_ptr->terrain_shader, "projection");
-    state_ptr->terrain_locations.view = shader_system_uniform_location(state_ptr->terrain_shader, "view");
-    state_ptr->terrain_locations.light_space_0 = shader_system_uniform_location(state_ptr->terrain_shader, "light_space_0");
-    state_ptr->terrain_locations.light_space_1 = shader_system_uniform_location(state_ptr->terrain_shader, "light_space_1");
-    state_ptr->terrain_locations.light_space_2 = shader_system_uniform_location(state_ptr->terrain_shader, "light_space_2");
-    state_ptr->terrain_locations.light_space_3 = shader_system_uniform_location(state_ptr->terrain_shader, "light_space_3");
-    state_ptr->terrain_locations.cascade_splits = shader_system_uniform_location(state_ptr->terrain_shader, "cascade_splits");
-    state_ptr->terrain_locations.view_position = shader_system_uniform_location(state_ptr->terrain_shader, "view_position");
-    state_ptr->terrain_locations.model = shader_system_uniform_location(state_ptr->terrain_shader, "model");
-    state_ptr->terrain_locations.render_mode = shader_system_uniform_location(state_ptr->terrain_shader, "mode");
-    state_ptr->terrain_locations.dir_light = shader_system_uniform_location(state_ptr->terrain_shader, "dir_light");
-    state_ptr->terrain_locations.p_lights = shader_system_uniform_location(state_ptr->terrain_shader, "p_lights");
-    state_ptr->terrain_locations.num_p_lights = shader_system_uniform_location(state_ptr->terrain_shader, "num_p_lights");
-
-    state_ptr->terrain_locations.properties = shader_system_uniform_location(state_ptr->terrain_shader, "properties");
-    state_ptr->terrain_locations.material_texures = shader_system_uniform_location(state_ptr->terrain_shader, "material_textures");
-    state_ptr->terrain_locations.shadow_textures = shader_system_uniform_location(state_ptr->terrain_shader, "shadow_textures");
-    state_ptr->terrain_locations.ibl_cube_texture = shader_system_uniform_location(state_ptr->terrain_shader, "ibl_cube_texture");
-    state_ptr->terrain_locations.use_pcf = shader_system_uniform_location(state_ptr->terrain_shader, "use_pcf");
-    state_ptr->terrain_locations.bias = shader_system_uniform_location(state_ptr->terrain_shader, "bias");
+    terrain_shader_locations_get(state_ptr->terrain_shader, &state_ptr->terrain_locations);
+
+    // Only created when vertex-pulled terrains can be drawn.
+    state_ptr->terrain_heightmap_shader = shader_system_get("Shader.Builtin.TerrainHeightmap");
+    state_ptr->terrain_heightmap_shader_id = state_ptr->terrain_heightmap_shader ? state_ptr->terrain_heightmap_shader->id : INVALID_ID;
+    if (state_ptr->terrain_heightmap_shader) {
+        terrain_shader_locations_get(state_ptr->terrain_heightmap_shader, &state_ptr->terrain_heightmap_locations);
+    }
 
     // Grab the default cubemap texture as the irradiance texture.
     state_ptr->irradiance_cube_texture = texture_system_get_default_cube_texture();
@@ -299,18 +401,20 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     kvar_int_create("use_pcf", 1);  // On by default.
     kvar_int_get("use_pcf", &state_ptr->use_pcf);
 
+    // And one for the shadow filtering quality, which picks the PBR shader variant.
+    state_ptr->shadow_quality = MATERIAL_SHADOW_QUALITY_DEFAULT;
+    kvar_int_create("shadow_quality", state_ptr->shadow_quality);
+
     event_register(EVENT_CODE_KVAR_CHANGED, 0, material_system_on_event);
 
-    // Load up some default materials.
-    if (!create_default_pbr_material(state_ptr)) {
-        KFATAL("Failed to create default PBR material. Application cannot continue.");
-        return false;
+    if (resource_system_hot_reload_enabled()) {
+        state_ptr->watches = darray_create(material_watch);
+        event_register(EVENT_CODE_WATCHED_RESOURCE_CHANGED, state_ptr, material_system_on_resource_changed);
     }
 
-    if (!create_default_terrain_material(state_ptr)) {
-        KFATAL("Failed to create default terrain material. Application cannot continue.");
-        return false;
-    }
+    // NOTE: Default materials are created on first use. See default_pbr_material_get.
+    kzero_memory(&state_ptr->default_pbr_material, sizeof(material));
+    kzero_memory(&state_ptr->default_terrain_material, sizeof(material));
 
     return true;
 }
@@ -320,6 +424,16 @@ void material_system_shutdown(void* state) {
     if (s) {
         event_unregister(EVENT_CODE_KVAR_CHANGED, 0, material_system_on_event);
 
+        if (s->watches) {
+            event_unregister(EVENT_CODE_WATCHED_RESOURCE_CHANGED, s, material_system_on_resource_changed);
+            u32 watch_count = darray_length(s->watches);
+            for (u32 i = 0; i < watch_count; ++i) {
+                resource_system_unwatch(s->watches[i].watch_id);
+            }
+            darray_destroy(s->watches);
+            s->watches = 0;
+        }
+
         // Invalidate all materials in the array.
         u32 count = s->config.max_material_count;
         for (u32 i = 0; i < count; ++i) {
@@ -328,30 +442,74 @@ void material_system_shutdown(void* state) {
             }
         }
 
-        // Destroy the default material.
-        destroy_material(&s->default_pbr_material);
-        destroy_material(&s->default_terrain_material);
+        // Destroy the default materials, if they were used.
+        if (s->default_pbr_material.name[0]) {
+            destroy_material(&s->default_pbr_material);
+        }
+        if (s->default_terrain_material.name[0]) {
+            destroy_material(&s->default_terrain_material);
+        }
+
+        if (s->pbr_instance_shares) {
+            darray_destroy(s->pbr_instance_shares);
+            s->pbr_instance_shares = 0;
+        }
+
+        if (s->parameter_capacity) {
+            renderer_renderbuffer_destroy(&s->parameter_buffer);
+            s->parameter_capacity = 0;
+        }
+
+        hashmap_destroy(&s->registered_material_table);
     }
 
     state_ptr = 0;
 }
 
 material* material_system_acquire(const char* name) {
-    // Load material configuration from resource;
-    resource material_resource;
-    if (!resource_system_load(name, RESOURCE_TYPE_MATERIAL, 0, &material_resource)) {
+    return material_system_acquire_by_kname(kname_create(name));
+}
+
+material* material_system_acquire_by_kname(kname name) {
+    // If the material is already loaded, just add a reference rather than loading its config again.
+    material_reference ref;
+    if (state_ptr && hashmap_get_u64(&state_ptr->registered_material_table, name, &ref) && ref.handle != INVALID_ID) {
+        ref.reference_count++;
+        hashmap_set_u64(&state_ptr->registered_material_table, name, &ref);
+        return &state_ptr->registered_materials[ref.handle];
+    }
+
+    const char* name_str = kname_string_get(name);
+    if (!name_str) {
+        KERROR("material_system_acquire_by_kname called with an unregistered name. Use kname_create to obtain names.");
+        return 0;
+    }
+
+    // Load material configuration from resource. It is shared through the resource cache, so it is not modified.
+    const resource* material_resource;
+    if (!resource_system_acquire(name_str, RESOURCE_TYPE_MATERIAL, 0, 0, &material_resource)) {
         KERROR("Failed to load material resource, returning nullptr.");
         return 0;
     }
 
     // Now acquire from loaded config.
     material* m = 0;
-    if (material_resource.data) {
-        m = material_system_acquire_from_config((material_config*)material_resource.data);
+    if (material_resource->data) {
+        m = material_system_acquire_from_config((material_config*)material_resource->data);
+    }
+
+    // Watch the file of a newly-loaded material, so it can be reloaded when changed.
+    if (m && state_ptr->watches && m >= state_ptr->registered_materials && m < state_ptr->registered_materials + state_ptr->config.max_material_count) {
+        material_watch w = {0};
+        w.handle = m->id;
+        w.resource_name = name;
+        if (resource_system_watch(material_resource->full_path, &w.watch_id)) {
+            darray_push(state_ptr->watches, w);
+        }
     }
 
     // Clean up
-    resource_system_unload(&material_resource);
+    resource_system_release(material_resource);
 
     if (!m) {
         KERROR("Failed to load material resource, returning nullptr.");
@@ -361,8 +519,16 @@ material* material_system_acquire(const char* name) {
 }
 
 static material* material_system_acquire_reference(const char* name, b8 auto_release, b8* needs_creation) {
-    material_reference ref;
-    if (state_ptr && hashtable_get(&state_ptr->registered_material_table, name, &ref)) {
+    if (state_ptr) {
+        kname key = kname_create(name);
+        material_reference ref;
+        if (!hashmap_get_u64(&state_ptr->registered_material_table, key, &ref)) {
+            // Not yet registered, start off with an empty reference.
+            ref.reference_count = 0;
+            ref.handle = INVALID_ID;
+            ref.auto_release = false;
+        }
+
         // This can only be changed the first time a material is loaded.
         if (ref.reference_count == 0) {
             ref.auto_release = auto_release;
@@ -398,7 +564,10 @@ static material* material_system_acquire_reference(const char* name, b8 auto_rel
         }
 
         // Update the entry.
-        hashtable_set(&state_ptr->registered_material_table, name, &ref);
+        if (!hashmap_set_u64(&state_ptr->registered_material_table, key, &ref)) {
+            KERROR("material_system_acquire failed to store reference for material '%s'.", name);
+            return 0;
+        }
         return &state_ptr->registered_materials[ref.handle];
     }
 
@@ -410,9 +579,27 @@ static material* material_system_acquire_reference(const char* name, b8 auto_rel
 material* material_system_acquire_terrain_material(const char* material_name, u32 material_count, const char** material_names, b8 auto_release) {
     // Return default terrain material.
     if (strings_equali(material_name, DEFAULT_TERRAIN_MATERIAL_NAME)) {
-        return &state_ptr->default_terrain_material;
+        return default_terrain_material_get();
     }
 
+    return terrain_material_acquire(material_name, material_count, material_names, 0, auto_release);
+}
+
+material* material_system_acquire_heightmap_terrain_material(const char* material_name, u32 material_count, const char** material_names, texture* heightmap, b8 auto_release) {
+    if (!heightmap) {
+        KERROR("material_system_acquire_heightmap_terrain_material requires a heightmap.");
+        return 0;
+    }
+    if (state_ptr->terrain_heightmap_shader_id == INVALID_ID) {
+        KERROR("The heightmap terrain shader doesn't exist, so heightmap terrain material '%s' can't be created.", material_name);
+        return 0;
+    }
+
+    return terrain_material_acquire(material_name, material_count, material_names, heightmap, auto_release);
+}
+
+// Acquires a terrain material, drawn with the heightmap terrain shader from the given heightmap if there is one.
+static material* terrain_material_acquire(const char* material_name, u32 material_count, const char** material_names, texture* heightmap, b8 auto_release) {
     b8 needs_creation = false;
     material* m = material_system_acquire_reference(material_name, auto_release, &needs_creation);
     if (!m) {
@@ -425,16 +612,17 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
         const char** texture_names = kallocate(sizeof(const char*) * material_count * PBR_MATERIAL_TEXTURE_COUNT, MEMORY_TAG_ARRAY);
         for (u32 i = 0; i < material_count; ++i) {
             // Load material configuration from resource;
-            resource material_resource;
-            if (!resource_system_load(material_names[i], RESOURCE_TYPE_MATERIAL, 0, &material_resource)) {
+            const resource* material_resource;
+            if (!resource_system_acquire(material_names[i], RESOURCE_TYPE_MATERIAL, 0, 0, &material_resource)) {
                 KERROR("Failed to load material resource, returning nullptr.");
                 return 0;
             }
 
-            material_config* mat_config = (material_config*)material_resource.data;
+            const material_config* mat_config = (const material_config*)material_resource->data;
             // NOTE: For now, PBR materials are required for terrains.
             if (mat_config->type != MATERIAL_TYPE_PBR) {
                 KERROR("Terrain materials must be PBR materials.");
+                resource_system_release(material_resource);
                 return false;
             }
 
@@ -445,7 +633,7 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
             }
 
             // Clean up the resource.
-            resource_system_unload(&material_resource);
+            resource_system_release(material_resource);
         }
 
         // Create new material.
@@ -453,7 +641,8 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
         kzero_memory(m, sizeof(material));
         string_ncopy(m->name, material_name, MATERIAL_NAME_MAX_LENGTH);
 
-        shader* selected_shader = state_ptr->terrain_shader;
+        shader* selected_shader = heightmap ? state_ptr->terrain_heightmap_shader : state_ptr->terrain_shader;
+        const terrain_shader_locations* locations = heightmap ? &state_ptr->terrain_heightmap_locations : &state_ptr->terrain_locations;
         m->shader_id = selected_shader->id;
         m->type = MATERIAL_TYPE_TERRAIN;
 
@@ -465,9 +654,11 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
         properties->padding = vec3_zero();
         properties->padding2 = vec4_zero();
 
-        // 3 maps per material for PBR. Allocate enough slots for all materials. Also one more for irradiance map.
-        m->maps = darray_reserve(texture_map, TERRAIN_SAMP_COUNT);
-        darray_length_set(m->maps, TERRAIN_SAMP_COUNT);
+        // 3 maps per material for PBR. Allocate enough slots for all materials. Also one more for irradiance map,
+        // and one more for the heightmap if there is one.
+        u32 map_count = heightmap ? HEIGHTMAP_TERRAIN_SAMP_COUNT : TERRAIN_SAMP_COUNT;
+        m->maps = darray_reserve(texture_map, map_count);
+        darray_length_set(m->maps, map_count);
 
         // One map is needed for the entire material array.
         {
@@ -506,7 +697,8 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
             map_config.repeat_u = map_config.repeat_v = map_config.repeat_w = TEXTURE_REPEAT_CLAMP_TO_BORDER;
             map_config.name = "shadow_map";
             map_config.texture_name = "";
-            if (!assign_map(&m->maps[SAMP_TERRAIN_SHADOW_MAP], &map_config, m->name, texture_system_get_default_diffuse_texture())) {
+            m->maps[SAMP_TERRAIN_SHADOW_MAP].compare_depth = true;
+            if (!assign_map(&m->maps[SAMP_TERRAIN_SHADOW_MAP], &map_config, m->name, texture_system_get_default_diffuse_texture(), false)) {
                 KERROR("Failed to assign '%s' texture map for terrain shadow map.", map_config.name);
                 return false;
             }
@@ -520,12 +712,24 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
             map_config.name = "ibl_cube";
             map_config.texture_name = "";
             // Always assigned to the last index.
-            if (!assign_map(&m->maps[SAMP_TERRAIN_IRRADIANCE_MAP], &map_config, m->name, texture_system_get_default_cube_texture())) {
+            if (!assign_map(&m->maps[SAMP_TERRAIN_IRRADIANCE_MAP], &map_config, m->name, texture_system_get_default_cube_texture(), false)) {
                 KERROR("Failed to assign '%s' texture map for terrain irradiance map.", map_config.name);
                 return false;
             }
         }
 
+        // The heightmap, read texel for texel. The material holds its own reference to it.
+        if (heightmap) {
+            texture_map* map = &m->maps[SAMP_TERRAIN_HEIGHTMAP];
+            map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+            map->filter_minify = map->filter_magnify = TEXTURE_FILTER_MODE_NEAREST;
+            map->texture = texture_system_acquire(heightmap->name, false);
+            if (!renderer_texture_map_resources_acquire(map)) {
+                KERROR("Unable to acquire resources for heightmap texture map.");
+                return 0;
+            }
+        }
+
         // NOTE: 4 materials * 3 maps per will still be loaded in order (albedo/norm/combined(met/rough/ao) per mat)
         // Next group will be shadow mappings
         // Last irradiance map
@@ -533,30 +737,39 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
         // Setup a configuration to get instance resources for this material.
         shader_instance_resource_config instance_resource_config = {0};
         // Map count for this type is known.
-        instance_resource_config.uniform_config_count = 3;  // NOTE: This includes material maps, shadow maps and irradiance map.
+        instance_resource_config.uniform_config_count = heightmap ? 4 : 3;  // NOTE: This includes material maps, shadow maps, irradiance map and heightmap.
         instance_resource_config.uniform_configs = kallocate(sizeof(shader_instance_uniform_texture_config) * instance_resource_config.uniform_config_count, MEMORY_TAG_ARRAY);
 
         // Material textures (single array texture)
         shader_instance_uniform_texture_config* mat_textures = &instance_resource_config.uniform_configs[0];
-        mat_textures->uniform_location = state_ptr->terrain_locations.material_texures;
+        mat_textures->uniform_location = locations->material_texures;
         mat_textures->texture_map_count = 1;
         mat_textures->texture_maps = kallocate(sizeof(texture_map*) * mat_textures->texture_map_count, MEMORY_TAG_ARRAY);
         mat_textures->texture_maps[0] = &m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP];
 
         // Shadow textures
         shader_instance_uniform_texture_config* shadow_textures = &instance_resource_config.uniform_configs[1];
-        shadow_textures->uniform_location = state_ptr->terrain_locations.shadow_textures;
+        shadow_textures->uniform_location = locations->shadow_textures;
         shadow_textures->texture_map_count = 1;
         shadow_textures->texture_maps = kallocate(sizeof(texture_map*) * shadow_textures->texture_map_count, MEMORY_TAG_ARRAY);
         shadow_textures->texture_maps[0] = &m->maps[SAMP_TERRAIN_SHADOW_MAP];
 
         // IBL cube texture
         shader_instance_uniform_texture_config* ibl_cube_texture = &instance_resource_config.uniform_configs[2];
-        ibl_cube_texture->uniform_location = state_ptr->terrain_locations.ibl_cube_texture;
+        ibl_cube_texture->uniform_location = locations->ibl_cube_texture;
         ibl_cube_texture->texture_map_count = 1;
         ibl_cube_texture->texture_maps = kallocate(sizeof(texture_map*) * ibl_cube_texture->texture_map_count, MEMORY_TAG_ARRAY);
         ibl_cube_texture->texture_maps[0] = &m->maps[SAMP_TERRAIN_IRRADIANCE_MAP];
 
+        // Heightmap
+        if (heightmap) {
+            shader_instance_uniform_texture_config* heightmap_texture = &instance_resource_config.uniform_configs[3];
+            heightmap_texture->uniform_location = locations->heightmap;
+            heightmap_texture->texture_map_count = 1;
+            heightmap_texture->texture_maps = kallocate(sizeof(texture_map*) * heightmap_texture->texture_map_count, MEMORY_TAG_ARRAY);
+            heightmap_texture->texture_maps[0] = &m->maps[SAMP_TERRAIN_HEIGHTMAP];
+        }
+
         // Acquire the resources
         b8 result = renderer_shader_instance_resources_acquire(selected_shader, &instance_resource_config, &m->internal_id);
         if (!result) {
@@ -586,12 +799,12 @@ material* material_system_acquire_terrain_material(const char* material_name, u3
 material* material_system_acquire_from_config(material_config* config) {
     // Return default material.
     if (strings_equali(config->name, DEFAULT_PBR_MATERIAL_NAME)) {
-        return &state_ptr->default_pbr_material;
+        return default_pbr_material_get();
     }
 
     // Return default terrain material.
     if (strings_equali(config->name, DEFAULT_TERRAIN_MATERIAL_NAME)) {
-        return &state_ptr->default_terrain_material;
+        return default_terrain_material_get();
     }
 
     b8 needs_creation = false;
@@ -619,37 +832,42 @@ void material_system_release(const char* name) {
     if (strings_equali(name, DEFAULT_PBR_MATERIAL_NAME) || strings_equali(name, DEFAULT_TERRAIN_MATERIAL_NAME)) {
         return;
     }
+    material_system_release_by_kname(kname_create(name));
+}
+
+void material_system_release_by_kname(kname name) {
     material_reference ref;
-    if (state_ptr && hashtable_get(&state_ptr->registered_material_table, name, &ref)) {
+    if (state_ptr && hashmap_get_u64(&state_ptr->registered_material_table, name, &ref)) {
         if (ref.reference_count == 0) {
-            KWARN("Tried to release non-existent material: '%s'", name);
+            KWARN("Tried to release a material with no references: '%s'", material_name_get(name));
             return;
         }
 
-        // Take a copy of the name since it would be wiped out if destroyed,
-        // (as passed in name is generally a pointer to the actual material's name).
-        char name_copy[MATERIAL_NAME_MAX_LENGTH];
-        string_ncopy(name_copy, name, MATERIAL_NAME_MAX_LENGTH);
-
         ref.reference_count--;
         if (ref.reference_count == 0 && ref.auto_release) {
             material* m = &state_ptr->registered_materials[ref.handle];
+            material_watch_remove(ref.handle);
 
             // Destroy/reset material.
             destroy_material(m);
 
-            // Reset the reference.
-            ref.handle = INVALID_ID;
-            ref.auto_release = false;
-            // KTRACE("Released material '%s'., Material unloaded because reference count=0 and auto_release=true.", name_copy);
+            // The material is gone, so remove the entry entirely.
+            hashmap_remove_u64(&state_ptr->registered_material_table, name);
+            // KTRACE("Released material '%s'., Material unloaded because reference count=0 and auto_release=true.", kname_string_get(name));
+            return;
         } else {
-            // KTRACE("Released material '%s', now has a reference count of '%i' (auto_release=%s).", name_copy, ref.reference_count, ref.auto_release ? "true" : "false");
+            // KTRACE("Released material '%s', now has a reference count of '%i' (auto_release=%s).", kname_string_get(name), ref.reference_count, ref.auto_release ? "true" : "false");
         }
 
         // Update the entry.
-        hashtable_set(&state_ptr->registered_material_table, name_copy, &ref);
+        hashmap_set_u64(&state_ptr->registered_material_table, name, &ref);
     } else {
-        KERROR("material_system_release failed to release material '%s'.", name);
+        // Default materials are never registered, so quietly ignore them here too.
+        const char* name_str = kname_string_get(name);
+        if (name_str && (strings_equali(name_str, DEFAULT_PBR_MATERIAL_NAME) || strings_equali(name_str, DEFAULT_TERRAIN_MATERIAL_NAME))) {
+            return;
+        }
+        KERROR("material_system_release failed to release material '%s'.", material_name_get(name));
     }
 }
 
@@ -659,7 +877,7 @@ material* material_system_get_default(void) {
 
 material* material_system_get_default_pbr(void) {
     if (state_ptr) {
-        return &state_ptr->default_pbr_material;
+        return default_pbr_material_get();
     }
 
     KFATAL("material_system_get_default_pbr called before system is initialized.");
@@ -668,7 +886,7 @@ material* material_system_get_default_pbr(void) {
 
 material* material_system_get_default_terrain(void) {
     if (state_ptr) {
-        return &state_ptr->default_terrain_material;
+        return default_terrain_material_get();
     }
 
     KFATAL("material_system_get_default_terrain called before system is initialized.");
@@ -681,6 +899,10 @@ material* material_system_get_default_terrain(void) {
         return false;                                 \
     }
 
+renderbuffer* material_system_parameter_buffer_get(void) {
+    return state_ptr && state_ptr->parameter_capacity ? &state_ptr->parameter_buffer : 0;
+}
+
 b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_data, const mat4* projection, const mat4* view, const vec4* ambient_colour, const vec3* view_position, u32 render_mode) {
     shader* s = shader_system_get_by_id(shader_id);
     if (!s) {
@@ -690,31 +912,42 @@ b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_data,
         return true;
     }
 
-    if (shader_id == state_ptr->terrain_shader_id) {
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.projection, projection));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.view, view));
+    // Point lights are culled into clusters once per frame, and read by both shaders from storage buffers.
+    if (!light_system_clusters_update(p_frame_data, projection, view)) {
+        KERROR("material_system_apply_global(): Failed to update point light clusters.");
+        return false;
+    }
+
+    const terrain_shader_locations* terrain_locations = terrain_locations_get(shader_id);
+    if (terrain_locations) {
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->projection, projection));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->view, view));
         // TODO: set cascade splits like dir lights and shadow map, etc.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.cascade_splits, ambient_colour));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.view_position, view_position));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.render_mode, &render_mode));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->cascade_splits, ambient_colour));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->view_position, view_position));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->render_mode, &render_mode));
         // Light space for shadow mapping. Per cascade
         for (u32 i = 0; i < MAX_SHADOW_CASCADE_COUNT; ++i) {
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.light_space_0 + i, &state_ptr->directional_light_space[i]));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->light_space_0 + i, &state_ptr->directional_light_space[i]));
         }
         // Directional light - global for this shader..
         directional_light* dir_light = light_system_directional_light_get();
         if (dir_light) {
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.dir_light, &dir_light->data));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->dir_light, &dir_light->data));
         } else {
             directional_light_data data = {0};
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.dir_light, &data));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->dir_light, &data));
         }
         // Global shader options.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.use_pcf, &state_ptr->use_pcf));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->use_pcf, &state_ptr->use_pcf));
 
         // HACK: Read this in from somewhere (or have global setter?);
         f32 bias = 0.00005f;
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.bias, &bias));
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->bias, &bias));
+
+        // Point lights and their clusters.
+        MATERIAL_APPLY_OR_FAIL(shader_system_storage_buffer_set_by_location(terrain_locations->point_lights, light_system_point_light_buffer_get()));
+        MATERIAL_APPLY_OR_FAIL(shader_system_storage_buffer_set_by_location(terrain_locations->light_clusters, light_system_cluster_buffer_get()));
     } else if (shader_id == state_ptr->pbr_shader_id) {
         MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.projection, projection));
         MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.view, view));
@@ -732,6 +965,14 @@ b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_data,
         // HACK: Read this in from somewhere (or have global setter?);
         f32 bias = 0.00005f;
         MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.bias, &bias));
+
+        u32 use_ibl_specular = state_ptr->ibl_specular_cube_texture && state_ptr->ibl_brdf_lut;
+        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.use_ibl_specular, &use_ibl_specular));
+
+        // Point lights and their clusters.
+        MATERIAL_APPLY_OR_FAIL(shader_system_storage_buffer_set_by_location(state_ptr->pbr_locations.point_lights, light_system_point_light_buffer_get()));
+        MATERIAL_APPLY_OR_FAIL(shader_system_storage_buffer_set_by_location(state_ptr->pbr_locations.light_clusters, light_system_cluster_buffer_get()));
+        MATERIAL_APPLY_OR_FAIL(shader_system_storage_buffer_set_by_location(state_ptr->pbr_locations.point_shadows, light_system_point_shadow_buffer_get()));
     } else {
         KERROR("material_system_apply_global(): Unrecognized shader id '%d' ", shader_id);
         return false;
@@ -744,13 +985,25 @@ b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_data,
 }
 
 b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data, b8 needs_update) {
+    // Use the shader variant chosen for the material.
+    MATERIAL_APPLY_OR_FAIL(shader_system_variant_use(state_ptr->weighted_blend ? m->weighted_shader_variant : m->shader_variant));
+
+    // Materials sharing an instance are identical, so only the first of them drawn needs to update it.
+    material_instance_share* share = needs_update ? pbr_instance_share_get(m) : 0;
+    if (share) {
+        if (share->render_frame_number == p_frame_data->renderer_frame_number && share->render_draw_index == p_frame_data->draw_index) {
+            needs_update = false;
+        } else {
+            share->render_frame_number = p_frame_data->renderer_frame_number;
+            share->render_draw_index = p_frame_data->draw_index;
+        }
+    }
+
     // Apply instance-level uniforms.
     MATERIAL_APPLY_OR_FAIL(shader_system_bind_instance(m->internal_id));
     if (needs_update) {
         if (m->shader_id == state_ptr->pbr_shader_id) {
-            // PBR shader
-            // Properties
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.properties, m->properties));
+            // PBR shader. Properties are read from the parameter buffer, so only maps are set here.
             // Maps
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location_arrayed(state_ptr->pbr_locations.material_texures, SAMP_ALBEDO, &m->maps[SAMP_ALBEDO]));
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location_arrayed(state_ptr->pbr_locations.material_texures, SAMP_NORMAL, &m->maps[SAMP_NORMAL]));
@@ -759,11 +1012,20 @@ b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data,
             // Shadow Maps
             m->maps[SAMP_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.shadow_textures, &m->maps[SAMP_SHADOW_MAP]));
+            // Only sampled through the faces of lights casting shadows, so the default only needs to be valid.
+            m->maps[SAMP_POINT_SHADOW_MAP].texture = state_ptr->point_shadow_texture ? state_ptr->point_shadow_texture : texture_system_get_default_diffuse_texture();
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.point_shadow_textures, &m->maps[SAMP_POINT_SHADOW_MAP]));
 
             // Irradience map
             m->maps[SAMP_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.ibl_cube_texture, &m->maps[SAMP_IRRADIANCE_MAP]));
 
+            // Specular image based lighting. Not sampled while unavailable, so the defaults only need to be valid.
+            m->maps[SAMP_IBL_SPECULAR_MAP].texture = state_ptr->ibl_specular_cube_texture ? state_ptr->ibl_specular_cube_texture : texture_system_get_default_cube_texture();
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.ibl_specular_texture, &m->maps[SAMP_IBL_SPECULAR_MAP]));
+            m->maps[SAMP_IBL_BRDF_LUT_MAP].texture = state_ptr->ibl_brdf_lut ? state_ptr->ibl_brdf_lut : texture_system_get_default_texture();
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.ibl_brdf_lut, &m->maps[SAMP_IBL_BRDF_LUT_MAP]));
+
             // Directional light.
             directional_light* dir_light = light_system_directional_light_get();
             if (dir_light) {
@@ -772,57 +1034,30 @@ b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data,
                 directional_light_data data = {0};
                 MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.dir_light, &data));
             }
-            // Point lights.
-            u32 p_light_count = light_system_point_light_count();
-            if (p_light_count) {
-                point_light* p_lights = p_frame_data->allocator.allocate(sizeof(point_light) * p_light_count);
-                light_system_point_lights_get(p_lights);
-
-                point_light_data* p_light_datas = p_frame_data->allocator.allocate(sizeof(point_light_data) * p_light_count);
-                for (u32 i = 0; i < p_light_count; ++i) {
-                    p_light_datas[i] = p_lights[i].data;
-                }
-
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.p_lights, p_light_datas));
-            }
-
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.num_p_lights, &p_light_count));
-
-        } else if (m->shader_id == state_ptr->terrain_shader_id) {
+        } else if (terrain_locations_get(m->shader_id)) {
+            const terrain_shader_locations* terrain_locations = terrain_locations_get(m->shader_id);
             // Apply material maps, all as one layered texture.
             // m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_terrain_texture();
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.material_texures, &m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP]));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->material_texures, &m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP]));
 
             // NOTE: apply other maps separately.
 
             // Shadow Maps
             m->maps[SAMP_TERRAIN_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.shadow_textures, &m->maps[SAMP_TERRAIN_SHADOW_MAP]));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->shadow_textures, &m->maps[SAMP_TERRAIN_SHADOW_MAP]));
 
             // Irradience map
             m->maps[SAMP_TERRAIN_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.ibl_cube_texture, &m->maps[SAMP_TERRAIN_IRRADIANCE_MAP]));
+            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->ibl_cube_texture, &m->maps[SAMP_TERRAIN_IRRADIANCE_MAP]));
 
-            // Apply properties.
-            shader_system_uniform_set_by_location(state_ptr->terrain_locations.properties, m->properties);
-
-            // TODO: Duplicating above... move this to its own function, perhaps.
-
-            // Point lights.
-            u32 p_light_count = light_system_point_light_count();
-            if (p_light_count) {
-                point_light* p_lights = p_frame_data->allocator.allocate(sizeof(point_light) * p_light_count);
-                light_system_point_lights_get(p_lights);
-
-                point_light_data* p_light_datas = p_frame_data->allocator.allocate(sizeof(point_light_data) * p_light_count);
-                for (u32 i = 0; i < p_light_count; ++i) {
-                    p_light_datas[i] = p_lights[i].data;
-                }
-
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.p_lights, p_light_datas));
+            // The heightmap of a vertex-pulled terrain.
+            if (terrain_locations->heightmap != INVALID_ID_U16) {
+                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(terrain_locations->heightmap, &m->maps[SAMP_TERRAIN_HEIGHTMAP]));
             }
 
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.num_p_lights, &p_light_count));
+            // Apply properties.
+            shader_system_uniform_set_by_location(terrain_locations->properties, m->properties);
+
         } else {
             KERROR("material_system_apply_instance(): Unrecognized shader id '%d' on shader '%s'.", m->shader_id, m->name);
             return false;
@@ -834,12 +1069,22 @@ b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data,
 }
 
 b8 material_system_apply_local(material* m, const mat4* model, frame_data* p_frame_data) {
+    if (m->shader_id == state_ptr->pbr_shader_id) {
+        // NOTE: The PBR shader takes its model matrix as a per-instance attribute
+        // (see renderer_geometry_draw_instanced), so there are no locals to apply.
+        return true;
+    }
+
+    const terrain_shader_locations* terrain_locations = terrain_locations_get(m->shader_id);
+    if (terrain_locations && terrain_locations->local_block_valid) {
+        // The model matrix is the whole of the terrain locals, so it is pushed as is.
+        return shader_system_local_block_push(model, sizeof(mat4));
+    }
+
     shader_system_bind_local();
     b8 result = false;
-    if (m->shader_id == state_ptr->pbr_shader_id) {
-        result = shader_system_uniform_set_by_location(state_ptr->pbr_locations.model, model);
-    } else if (m->shader_id == state_ptr->terrain_shader_id) {
-        result = shader_system_uniform_set_by_location(state_ptr->terrain_locations.model, model);
+    if (terrain_locations) {
+        result = shader_system_uniform_set_by_location(terrain_locations->model, model);
     }
     shader_system_apply_local(p_frame_data);
 
@@ -857,6 +1102,14 @@ b8 material_system_shadow_map_set(texture* shadow_texture, u8 index) {
     return true;
 }
 
+b8 material_system_point_shadow_map_set(texture* point_shadow_texture) {
+    if (point_shadow_texture) {
+        state_ptr->point_shadow_texture = point_shadow_texture;
+    }
+
+    return true;
+}
+
 b8 material_system_irradiance_set(texture* irradiance_cube_texture) {
     if (irradiance_cube_texture) {
         if (irradiance_cube_texture->type != TEXTURE_TYPE_CUBE) {
@@ -872,15 +1125,36 @@ b8 material_system_irradiance_set(texture* irradiance_cube_texture) {
     return true;
 }
 
+b8 material_system_ibl_set(texture* irradiance_cube_texture, texture* specular_cube_texture, texture* brdf_lut) {
+    if ((specular_cube_texture && specular_cube_texture->type != TEXTURE_TYPE_CUBE) || (brdf_lut && brdf_lut->type != TEXTURE_TYPE_2D)) {
+        KERROR("material_system_ibl_set requires a cubemap type specular texture and a 2d BRDF lookup table.");
+        return false;
+    }
+    if (!material_system_irradiance_set(irradiance_cube_texture)) {
+        return false;
+    }
+
+    // Specular image based lighting needs both textures.
+    b8 has_specular = specular_cube_texture && brdf_lut;
+    state_ptr->ibl_specular_cube_texture = has_specular ? specular_cube_texture : 0;
+    state_ptr->ibl_brdf_lut = has_specular ? brdf_lut : 0;
+    return true;
+}
+
+void material_system_weighted_blend_set(b8 enabled) {
+    state_ptr->weighted_blend = enabled;
+}
+
 void material_system_directional_light_space_set(mat4 directional_light_space, u8 index) {
     state_ptr->directional_light_space[index] = directional_light_space;
 }
 
 void material_system_dump(void) {
-    material_reference* refs = (material_reference*)state_ptr->registered_material_table.memory;
-    for (u32 i = 0; i < state_ptr->registered_material_table.element_count; ++i) {
+    hashmap* table = &state_ptr->registered_material_table;
+    material_reference* refs = (material_reference*)table->values;
+    for (u32 i = 0; i < table->capacity; ++i) {
         material_reference* r = &refs[i];
-        if (r->reference_count > 0 || r->handle != INVALID_ID) {
+        if (table->hashes[i] && (r->reference_count > 0 || r->handle != INVALID_ID)) {
             KDEBUG("Found material ref (handle/refCount): (%u/%u)", r->handle, r->reference_count);
             if (r->handle != INVALID_ID) {
                 KTRACE("Material name: %s", state_ptr->registered_materials[r->handle].name);
@@ -889,7 +1163,7 @@ void material_system_dump(void) {
     }
 }
 
-static b8 assign_map(texture_map* map, const material_map* config, const char* material_name, texture* default_tex) {
+static b8 assign_map(texture_map* map, const material_map* config, const char* material_name, texture* default_tex, b8 streamed) {
     map->filter_minify = config->filter_min;
     map->filter_magnify = config->filter_mag;
     map->repeat_u = config->repeat_u;
@@ -897,7 +1171,11 @@ static b8 assign_map(texture_map* map, const material_map* config, const char* m
     map->repeat_w = config->repeat_w;
 
     if (string_length(config->texture_name) > 0) {
-        map->texture = texture_system_acquire(config->texture_name, true);
+        if (streamed) {
+            map->texture = texture_system_acquire_streamed(config->texture_name, true);
+        } else {
+            map->texture = texture_system_acquire(config->texture_name, true);
+        }
         if (!map->texture) {
             // Configured, but not found.
             KWARN("Unable to load texture '%s' for material '%s', using default.", config->texture_name, material_name);
@@ -914,8 +1192,197 @@ static b8 assign_map(texture_map* map, const material_map* config, const char* m
     return true;
 }
 
+// Obtains the variant of the PBR shader suited to the maps of the given material, so work the material
+// doesn't need is left out of its fragment shader. The weighted variant accumulates weighted blended
+// transparency instead, and is the same as the other if that isn't supported.
+static u32 pbr_variant_get(const material* m, b8 weighted) {
+    shader* s = state_ptr->pbr_shader;
+    u32 values[SHADER_MAX_SPECIALIZATIONS];
+    for (u32 i = 0; i < s->specialization_count; ++i) {
+        values[i] = s->specializations[i].default_value;
+    }
+    if (state_ptr->pbr_normal_map_specialization != INVALID_ID_U8) {
+        values[state_ptr->pbr_normal_map_specialization] = m->maps[SAMP_NORMAL].texture != texture_system_get_default_normal_texture();
+    }
+    if (state_ptr->pbr_shadow_quality_specialization != INVALID_ID_U8) {
+        values[state_ptr->pbr_shadow_quality_specialization] = (u32)state_ptr->shadow_quality;
+    }
+    if (weighted && state_ptr->pbr_weighted_blend_specialization != INVALID_ID_U8 && renderer_weighted_blend_supported()) {
+        values[state_ptr->pbr_weighted_blend_specialization] = 1;
+        return shader_system_variant_acquire_flagged(s, values, SHADER_FLAG_BLEND_WEIGHTED);
+    }
+    return shader_system_variant_acquire(s, values);
+}
+
+// Obtains the variants of every PBR material again, e.g. once the shadow quality changes. Each shared
+// instance is rehashed, as the variants are part of what its materials have in common.
+static void pbr_variants_refresh(void) {
+    u32 count = state_ptr->config.max_material_count;
+    for (u32 i = 0; i < count; ++i) {
+        material* m = &state_ptr->registered_materials[i];
+        if (m->id == INVALID_ID || m->shader_id != state_ptr->pbr_shader_id || !m->maps) {
+            continue;
+        }
+        m->shader_variant = pbr_variant_get(m, false);
+        m->weighted_shader_variant = pbr_variant_get(m, true);
+        material_instance_share* share = pbr_instance_share_get(m);
+        if (share) {
+            share->hash = pbr_instance_hash(m);
+        }
+    }
+
+    material* default_material = &state_ptr->default_pbr_material;
+    if (default_material->maps) {
+        default_material->shader_variant = pbr_variant_get(default_material, false);
+        default_material->weighted_shader_variant = pbr_variant_get(default_material, true);
+    }
+}
+
+// Ensures the parameter buffer holds the given number of entries, creating or growing it as needed.
+static b8 parameter_buffer_ensure_capacity(u32 count) {
+    if (count <= state_ptr->parameter_capacity) {
+        return true;
+    }
+
+    u32 new_capacity = state_ptr->parameter_capacity ? state_ptr->parameter_capacity : PARAMETER_BUFFER_INITIAL_CAPACITY;
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+
+    u64 new_size = sizeof(material_phong_properties) * new_capacity;
+    if (!state_ptr->parameter_capacity) {
+        if (!renderer_renderbuffer_create("renderbuffer_material_parameters", RENDERBUFFER_TYPE_STORAGE, new_size, RENDERBUFFER_TRACK_TYPE_NONE, &state_ptr->parameter_buffer)) {
+            KERROR("Failed to create material parameter buffer.");
+            return false;
+        }
+        renderer_renderbuffer_bind(&state_ptr->parameter_buffer, 0);
+    } else if (!renderer_renderbuffer_resize(&state_ptr->parameter_buffer, new_size)) {
+        // NOTE: Resizing preserves the existing contents, so other materials need not be uploaded again.
+        KERROR("Failed to resize material parameter buffer.");
+        return false;
+    }
+
+    state_ptr->parameter_capacity = new_capacity;
+    return true;
+}
+
+// Writes the parameters of a PBR material to its entry in the parameter buffer. Only needed when they change.
+static b8 pbr_parameters_upload(const material* m) {
+    if (!parameter_buffer_ensure_capacity(m->internal_id + 1)) {
+        return false;
+    }
+    u64 offset = sizeof(material_phong_properties) * m->internal_id;
+    if (!renderer_renderbuffer_load_range(&state_ptr->parameter_buffer, offset, sizeof(material_phong_properties), m->properties)) {
+        KERROR("Failed to upload the parameters of material '%s'.", m->name);
+        return false;
+    }
+    return true;
+}
+
+// Hashes everything about a PBR material which ends up in its shader instance.
+static u64 pbr_instance_hash(const material* m) {
+    u64 hash = 0xcbf29ce484222325ULL;
+    const u8* properties = m->properties;
+    for (u32 i = 0; i < m->property_struct_size; ++i) {
+        hash = (hash ^ properties[i]) * 0x100000001b3ULL;
+    }
+    u32 map_count = darray_length(m->maps);
+    for (u32 i = 0; i < map_count; ++i) {
+        const texture_map* map = &m->maps[i];
+        u64 values[6] = {(u64)map->texture, map->filter_minify, map->filter_magnify, map->repeat_u, map->repeat_v, map->repeat_w};
+        for (u32 v = 0; v < 6; ++v) {
+            hash = (hash ^ values[v]) * 0x100000001b3ULL;
+        }
+    }
+    hash = (hash ^ (u64)m->irradiance_texture) * 0x100000001b3ULL;
+    return (hash ^ m->shader_variant) * 0x100000001b3ULL;
+}
+
+static b8 pbr_instances_equal(const material* a, const material* b) {
+    if (a->type != b->type || a->shader_variant != b->shader_variant || a->irradiance_texture != b->irradiance_texture || a->property_struct_size != b->property_struct_size) {
+        return false;
+    }
+    const u8* properties_a = a->properties;
+    const u8* properties_b = b->properties;
+    for (u32 i = 0; i < a->property_struct_size; ++i) {
+        if (properties_a[i] != properties_b[i]) {
+            return false;
+        }
+    }
+    u32 map_count = darray_length(a->maps);
+    if (map_count != darray_length(b->maps)) {
+        return false;
+    }
+    for (u32 i = 0; i < map_count; ++i) {
+        const texture_map* map_a = &a->maps[i];
+        const texture_map* map_b = &b->maps[i];
+        if (map_a->texture != map_b->texture || map_a->filter_minify != map_b->filter_minify || map_a->filter_magnify != map_b->filter_magnify ||
+            map_a->repeat_u != map_b->repeat_u || map_a->repeat_v != map_b->repeat_v || map_a->repeat_w != map_b->repeat_w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static material_instance_share* pbr_instance_share_get(const material* m) {
+    if (m->shader_id != state_ptr->pbr_shader_id || m->internal_id == INVALID_ID || m->internal_id >= darray_length(state_ptr->pbr_instance_shares)) {
+        return 0;
+    }
+    material_instance_share* share = &state_ptr->pbr_instance_shares[m->internal_id];
+    return share->material_count ? share : 0;
+}
+
+// Points the material at the instance of a registered PBR material with identical parameters, if there is one.
+// Since applying a PBR material sets every sampler of its instance, the instance never relies on the maps of a
+// particular material once it has been applied.
+static b8 pbr_instance_share_acquire(material* m, u64 hash) {
+    u32 share_count = darray_length(state_ptr->pbr_instance_shares);
+    u32 material_count = state_ptr->config.max_material_count;
+    for (u32 i = 0; i < share_count; ++i) {
+        material_instance_share* share = &state_ptr->pbr_instance_shares[i];
+        if (!share->material_count || share->hash != hash) {
+            continue;
+        }
+        // Rule out hash collisions against a material using the instance.
+        for (u32 j = 0; j < material_count; ++j) {
+            const material* other = &state_ptr->registered_materials[j];
+            if (other != m && other->id != INVALID_ID && other->shader_id == m->shader_id && other->internal_id == i && pbr_instances_equal(m, other)) {
+                m->internal_id = i;
+                share->material_count++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void pbr_instance_share_track(u32 instance_id, u64 hash) {
+    while (darray_length(state_ptr->pbr_instance_shares) <= instance_id) {
+        material_instance_share empty = {0};
+        darray_push(state_ptr->pbr_instance_shares, empty);
+    }
+    material_instance_share* share = &state_ptr->pbr_instance_shares[instance_id];
+    share->material_count = 1;
+    share->hash = hash;
+    share->render_frame_number = INVALID_ID_U64;
+    share->render_draw_index = INVALID_ID_U8;
+}
+
+// Drops the material's use of a shared instance. Returns true if other materials still use it.
+static b8 pbr_instance_share_release(const material* m) {
+    material_instance_share* share = pbr_instance_share_get(m);
+    if (!share) {
+        return false;
+    }
+    share->material_count--;
+    return share->material_count > 0;
+}
+
 static b8 load_material(material_config* config, material* m) {
+    // The slot's handle is kept, as it was assigned when the slot was claimed.
+    u32 id = m->id;
     kzero_memory(m, sizeof(material));
+    m->id = id;
 
     // name
     string_ncopy(m->name, config->name, MATERIAL_NAME_MAX_LENGTH);
@@ -965,6 +1432,8 @@ static b8 load_material(material_config* config, material* m) {
             texture_system_get_default_diffuse_texture(),
             texture_system_get_default_normal_texture(),
             texture_system_get_default_combined_texture()};
+        // What each map holds, so its mips are filtered to suit. Combined maps are plain linear data.
+        const texture_flag_bits content_flags[PBR_MATERIAL_TEXTURE_COUNT] = {TEXTURE_FLAG_IS_SRGB, TEXTURE_FLAG_IS_NORMAL_MAP, 0};
 
         // Attempt to match configured names to those required by PBR materials.
         // This also ensures the maps are in the proper order.
@@ -972,9 +1441,11 @@ static b8 load_material(material_config* config, material* m) {
             b8 found = false;
             for (u32 tex_slot = 0; tex_slot < PBR_MATERIAL_TEXTURE_COUNT; ++tex_slot) {
                 if (strings_equali(config->maps[i].name, map_names[tex_slot])) {
-                    if (!assign_map(&m->maps[tex_slot], &config->maps[i], m->name, default_textures[tex_slot])) {
+                    // Surface maps are drawn at all distances, so only the mip levels in use are kept resident.
+                    if (!assign_map(&m->maps[tex_slot], &config->maps[i], m->name, default_textures[tex_slot], true)) {
                         return false;
                     }
+                    texture_system_content_flags_set(m->maps[tex_slot].texture, content_flags[tex_slot]);
                     mat_maps_assigned[tex_slot] = true;
                     found = true;
                     break;
@@ -987,7 +1458,7 @@ static b8 load_material(material_config* config, material* m) {
             // TODO: May not want this to be configurable as a map, but rather provided by the scene from a reflection probe.
             if (strings_equali(config->maps[i].name, "ibl_cube")) {
                 // TODO: just loading a default cube map for now. Need to get this from the probe instead.
-                if (!assign_map(&m->maps[SAMP_IRRADIANCE_MAP], &config->maps[i], m->name, texture_system_get_default_cube_texture())) {
+                if (!assign_map(&m->maps[SAMP_IRRADIANCE_MAP], &config->maps[i], m->name, texture_system_get_default_cube_texture(), false)) {
                     return false;
                 }
                 ibl_cube_assigned = true;
@@ -1005,7 +1476,7 @@ static b8 load_material(material_config* config, material* m) {
                 map_config.repeat_u = map_config.repeat_v = map_config.repeat_w = TEXTURE_REPEAT_REPEAT;
                 map_config.name = string_duplicate(map_names[i]);
                 map_config.texture_name = "";
-                b8 assign_result = assign_map(&m->maps[i], &map_config, m->name, default_textures[i]);
+                b8 assign_result = assign_map(&m->maps[i], &map_config, m->name, default_textures[i], false);
                 string_free(map_config.name);
                 if (!assign_result) {
                     return false;
@@ -1021,7 +1492,7 @@ static b8 load_material(material_config* config, material* m) {
             map_config.repeat_u = map_config.repeat_v = map_config.repeat_w = TEXTURE_REPEAT_REPEAT;
             map_config.name = "ibl_cube";
             map_config.texture_name = "";
-            if (!assign_map(&m->maps[SAMP_IRRADIANCE_MAP], &map_config, m->name, texture_system_get_default_cube_texture())) {
+            if (!assign_map(&m->maps[SAMP_IRRADIANCE_MAP], &map_config, m->name, texture_system_get_default_cube_texture(), false)) {
                 return false;
             }
         }
@@ -1033,15 +1504,41 @@ static b8 load_material(material_config* config, material* m) {
             map_config.repeat_u = map_config.repeat_v = map_config.repeat_w = TEXTURE_REPEAT_CLAMP_TO_BORDER;
             map_config.name = "shadow_map";
             map_config.texture_name = "";
-            if (!assign_map(&m->maps[SAMP_SHADOW_MAP], &map_config, m->name, texture_system_get_default_diffuse_texture())) {
+            // Sampled with depth comparison, so the hardware filters each shadow tap.
+            m->maps[SAMP_SHADOW_MAP].compare_depth = true;
+            if (!assign_map(&m->maps[SAMP_SHADOW_MAP], &map_config, m->name, texture_system_get_default_diffuse_texture(), false)) {
+                return false;
+            }
+            map_config.name = "point_shadow_map";
+            m->maps[SAMP_POINT_SHADOW_MAP].compare_depth = true;
+            if (!assign_map(&m->maps[SAMP_POINT_SHADOW_MAP], &map_config, m->name, texture_system_get_default_diffuse_texture(), false)) {
+                return false;
+            }
+        }
+
+        // Nor can the specular image based lighting maps, which are provided by the scene.
+        {
+            material_map map_config = {0};
+            map_config.filter_mag = map_config.filter_min = TEXTURE_FILTER_MODE_LINEAR;
+            map_config.repeat_u = map_config.repeat_v = map_config.repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+            map_config.name = "ibl_specular";
+            map_config.texture_name = "";
+            if (!assign_map(&m->maps[SAMP_IBL_SPECULAR_MAP], &map_config, m->name, texture_system_get_default_cube_texture(), false)) {
+                return false;
+            }
+            map_config.name = "ibl_brdf_lut";
+            if (!assign_map(&m->maps[SAMP_IBL_BRDF_LUT_MAP], &map_config, m->name, texture_system_get_default_texture(), false)) {
                 return false;
             }
         }
 
+        m->shader_variant = pbr_variant_get(m, false);
+        m->weighted_shader_variant = pbr_variant_get(m, true);
+
         // Gather a list of pointers to texture maps;
         // Send it off to the renderer to acquire resources.
         // Map count for this type is known.
-        instance_resource_config.uniform_config_count = 3;  // NOTE: This includes material maps, shadow maps and irradiance map.
+        instance_resource_config.uniform_config_count = 6;  // NOTE: This includes material maps, shadow maps, the irradiance, specular and BRDF maps and the point shadow map.
         instance_resource_config.uniform_configs = kallocate(sizeof(shader_instance_uniform_texture_config) * instance_resource_config.uniform_config_count, MEMORY_TAG_ARRAY);
 
         // Material textures
@@ -1067,6 +1564,27 @@ static b8 load_material(material_config* config, material* m) {
         ibl_cube_texture->texture_maps = kallocate(sizeof(texture_map*) * ibl_cube_texture->texture_map_count, MEMORY_TAG_ARRAY);
         ibl_cube_texture->texture_maps[0] = &m->maps[SAMP_IRRADIANCE_MAP];
 
+        // IBL specular texture
+        shader_instance_uniform_texture_config* ibl_specular_texture = &instance_resource_config.uniform_configs[3];
+        ibl_specular_texture->uniform_location = state_ptr->pbr_locations.ibl_specular_texture;
+        ibl_specular_texture->texture_map_count = 1;
+        ibl_specular_texture->texture_maps = kallocate(sizeof(texture_map*) * ibl_specular_texture->texture_map_count, MEMORY_TAG_ARRAY);
+        ibl_specular_texture->texture_maps[0] = &m->maps[SAMP_IBL_SPECULAR_MAP];
+
+        // IBL BRDF lookup table
+        shader_instance_uniform_texture_config* ibl_brdf_lut = &instance_resource_config.uniform_configs[4];
+        ibl_brdf_lut->uniform_location = state_ptr->pbr_locations.ibl_brdf_lut;
+        ibl_brdf_lut->texture_map_count = 1;
+        ibl_brdf_lut->texture_maps = kallocate(sizeof(texture_map*) * ibl_brdf_lut->texture_map_count, MEMORY_TAG_ARRAY);
+        ibl_brdf_lut->texture_maps[0] = &m->maps[SAMP_IBL_BRDF_LUT_MAP];
+
+        // Point shadow textures
+        shader_instance_uniform_texture_config* point_shadow_textures = &instance_resource_config.uniform_configs[5];
+        point_shadow_textures->uniform_location = state_ptr->pbr_locations.point_shadow_textures;
+        point_shadow_textures->texture_map_count = 1;
+        point_shadow_textures->texture_maps = kallocate(sizeof(texture_map*) * point_shadow_textures->texture_map_count, MEMORY_TAG_ARRAY);
+        point_shadow_textures->texture_maps[0] = &m->maps[SAMP_POINT_SHADOW_MAP];
+
     } else if (config->type == MATERIAL_TYPE_CUSTOM) {
         // Gather a list of pointers to texture maps;
         // Send it off to the renderer to acquire resources.
@@ -1147,7 +1665,7 @@ static b8 load_material(material_config* config, material* m) {
         for (u32 i = 0; i < map_count; ++i) {
             // No known mapping, so just map them in order.
             // Invalid textures will use the default texture because map type isn't known.
-            if (!assign_map(&m->maps[i], &config->maps[i], m->name, texture_system_get_default_texture())) {
+            if (!assign_map(&m->maps[i], &config->maps[i], m->name, texture_system_get_default_texture(), false)) {
                 return false;
             }
         }
@@ -1180,10 +1698,18 @@ static b8 load_material(material_config* config, material* m) {
         return false;
     }
 
-    // Acquire the instance resources for this material.
-    b8 result = renderer_shader_instance_resources_acquire(selected_shader, &instance_resource_config, &m->internal_id);
-    if (!result) {
-        KERROR("Failed to acquire renderer resources for material '%s'.", m->name);
+    // Acquire the instance resources for this material, unless a PBR material with identical parameters can share them.
+    b8 result = true;
+    u64 instance_hash = m->type == MATERIAL_TYPE_PBR ? pbr_instance_hash(m) : 0;
+    if (m->type != MATERIAL_TYPE_PBR || !pbr_instance_share_acquire(m, instance_hash)) {
+        result = renderer_shader_instance_resources_acquire(selected_shader, &instance_resource_config, &m->internal_id);
+        if (!result) {
+            KERROR("Failed to acquire renderer resources for material '%s'.", m->name);
+        } else if (m->type == MATERIAL_TYPE_PBR) {
+            pbr_instance_share_track(m->internal_id, instance_hash);
+            // A failed upload is logged, and only leaves the material drawn with stale parameters.
+            pbr_parameters_upload(m);
+        }
     }
 
     // Clean up the uniform configs.
@@ -1201,6 +1727,17 @@ static void destroy_material(material* m) {
     // KTRACE("Destroying material '%s'...", m->name);
 
     u32 length = darray_length(m->maps);
+    if (m->type == MATERIAL_TYPE_PBR && length == PBR_MAP_COUNT) {
+        // The shadow and image based lighting maps hold whatever the renderer last provided, which the
+        // material holds no reference to, and which may already be gone.
+        m->maps[SAMP_SHADOW_MAP].texture = 0;
+        m->maps[SAMP_POINT_SHADOW_MAP].texture = 0;
+        if (!m->irradiance_texture) {
+            m->maps[SAMP_IRRADIANCE_MAP].texture = 0;
+        }
+        m->maps[SAMP_IBL_SPECULAR_MAP].texture = 0;
+        m->maps[SAMP_IBL_BRDF_LUT_MAP].texture = 0;
+    }
     for (u32 i = 0; i < length; ++i) {
         // Release texture references.
         if (m->maps[i].texture) {
@@ -1211,10 +1748,11 @@ static void destroy_material(material* m) {
     }
 
     // Release renderer resources.
-    if (m->shader_id != INVALID_ID && m->internal_id != INVALID_ID) {
+    // Shared instances are kept until the last material using them is destroyed.
+    if (m->shader_id != INVALID_ID && m->internal_id != INVALID_ID && !pbr_instance_share_release(m)) {
         renderer_shader_instance_resources_release(shader_system_get_by_id(m->shader_id), m->internal_id);
-        m->shader_id = INVALID_ID;
     }
+    m->shader_id = INVALID_ID;
 
     // Release properties
     if (m->properties && m->property_struct_size) {
@@ -1229,6 +1767,103 @@ static void destroy_material(material* m) {
     m->render_frame_number = INVALID_ID;
 }
 
+static void material_watch_remove(u32 handle) {
+    if (!state_ptr->watches) {
+        return;
+    }
+
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watches[i].handle == handle) {
+            resource_system_unwatch(state_ptr->watches[i].watch_id);
+            // Order doesn't matter, so swap the last one into its place.
+            state_ptr->watches[i] = state_ptr->watches[count - 1];
+            darray_length_set(state_ptr->watches, count - 1);
+            return;
+        }
+    }
+}
+
+static b8 material_reload_job_start(void* params, void* result_data) {
+    material_reload_params* reload_params = (material_reload_params*)params;
+
+    b8 result = resource_system_load(reload_params->resource_name, RESOURCE_TYPE_MATERIAL, 0, &reload_params->material_resource);
+
+    // NOTE: The params are also used as the result data here, only the material_resource field is populated now.
+    kcopy_memory(result_data, reload_params, sizeof(material_reload_params));
+
+    return result;
+}
+
+static void material_reload_job_success(void* params) {
+    material_reload_params* reload_params = (material_reload_params*)params;
+
+    // The material may have been released while the job was running.
+    material* m = &state_ptr->registered_materials[reload_params->handle];
+    if (m->id == reload_params->handle && strings_equali(m->name, reload_params->name) && reload_params->material_resource.data) {
+        // Load into a temporary material first, so the old one is kept if the new one can't be loaded.
+        // Textures used by both keep their references, so are not loaded again.
+        material temp;
+        if (load_material((material_config*)reload_params->material_resource.data, &temp)) {
+            material old = *m;
+            *m = temp;
+            m->id = old.id;
+            m->generation = old.generation == INVALID_ID ? 0 : old.generation + 1;
+            m->render_frame_number = INVALID_ID;
+
+            // Renderer resources still in use by frames in flight are released once those frames are done.
+            destroy_material(&old);
+            KINFO("Reloaded material '%s'.", m->name);
+        } else {
+            KERROR("Failed to reload material '%s'. The previous version is kept.", reload_params->name);
+        }
+    }
+
+    resource_system_unload(&reload_params->material_resource);
+}
+
+static void material_reload_job_fail(void* params) {
+    material_reload_params* reload_params = (material_reload_params*)params;
+
+    KERROR("Failed to load material resource '%s' for reloading. The previous version is kept.", reload_params->resource_name);
+}
+
+static b8 material_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context) {
+    u32 watch_id = context.data.u32[0];
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watches[i].watch_id == watch_id) {
+            material* m = &state_ptr->registered_materials[state_ptr->watches[i].handle];
+
+            // Read and parse the file on a job thread. The material is swapped once that is done.
+            material_reload_params params = {0};
+            string_ncopy(params.name, m->name, MATERIAL_NAME_MAX_LENGTH);
+            string_ncopy(params.resource_name, material_name_get(state_ptr->watches[i].resource_name), MATERIAL_NAME_MAX_LENGTH);
+            params.handle = state_ptr->watches[i].handle;
+            job_info job = job_create(material_reload_job_start, material_reload_job_success, material_reload_job_fail, &params, sizeof(material_reload_params), sizeof(material_reload_params));
+            job_system_submit(job);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The default materials, along with the default textures they use, are created the first time they are
+// asked for rather than when the system starts. Most scenes never fall back to them.
+static material* default_pbr_material_get(void) {
+    if (!state_ptr->default_pbr_material.name[0] && !create_default_pbr_material(state_ptr)) {
+        KFATAL("Failed to create default PBR material. Application cannot continue.");
+    }
+    return &state_ptr->default_pbr_material;
+}
+
+static material* default_terrain_material_get(void) {
+    if (!state_ptr->default_terrain_material.name[0] && !create_default_terrain_material(state_ptr)) {
+        KFATAL("Failed to create default terrain material. Application cannot continue.");
+    }
+    return &state_ptr->default_terrain_material;
+}
+
 static b8 create_default_pbr_material(material_system_state* state) {
     kzero_memory(&state->default_pbr_material, sizeof(material));
     state->default_pbr_material.id = INVALID_ID;
@@ -1256,18 +1891,27 @@ static b8 create_default_pbr_material(material_system_state* state) {
     // Change the clamp mode on the default shadow map to border.
     texture_map* ssm = &state->default_pbr_material.maps[SAMP_SHADOW_MAP];
     ssm->repeat_u = ssm->repeat_v = ssm->repeat_w = TEXTURE_REPEAT_CLAMP_TO_BORDER;
+    ssm->compare_depth = true;
+    texture_map* psm = &state->default_pbr_material.maps[SAMP_POINT_SHADOW_MAP];
+    psm->repeat_u = psm->repeat_v = psm->repeat_w = TEXTURE_REPEAT_CLAMP_TO_BORDER;
+    psm->compare_depth = true;
 
     state->default_pbr_material.maps[SAMP_ALBEDO].texture = texture_system_get_default_texture();
     state->default_pbr_material.maps[SAMP_NORMAL].texture = texture_system_get_default_normal_texture();
     state->default_pbr_material.maps[SAMP_COMBINED].texture = texture_system_get_default_combined_texture();
     state->default_pbr_material.maps[SAMP_SHADOW_MAP].texture = texture_system_get_default_diffuse_texture();
+    state->default_pbr_material.maps[SAMP_POINT_SHADOW_MAP].texture = texture_system_get_default_diffuse_texture();
+    state->default_pbr_material.maps[SAMP_IBL_SPECULAR_MAP].texture = texture_system_get_default_cube_texture();
+    state->default_pbr_material.maps[SAMP_IBL_BRDF_LUT_MAP].texture = texture_system_get_default_texture();
     state->default_pbr_material.maps[SAMP_IRRADIANCE_MAP].texture = texture_system_get_default_cube_texture();
+    state->default_pbr_material.shader_variant = pbr_variant_get(&state->default_pbr_material, false);
+    state->default_pbr_material.weighted_shader_variant = pbr_variant_get(&state->default_pbr_material, true);
 
     // Setup a configuration to get instance resources for this material.
     material* m = &state->default_pbr_material;
     shader_instance_resource_config instance_resource_config = {0};
     // Map count for this type is known.
-    instance_resource_config.uniform_config_count = 3;  // NOTE: This includes material maps, shadow maps and irradiance map.
+    instance_resource_config.uniform_config_count = 6;  // NOTE: This includes material maps, shadow maps, the irradiance, specular and BRDF maps and the point shadow map.
     instance_resource_config.uniform_configs = kallocate(sizeof(shader_instance_uniform_texture_config) * instance_resource_config.uniform_config_count, MEMORY_TAG_ARRAY);
 
     // Material textures
@@ -1293,11 +1937,33 @@ static b8 create_default_pbr_material(material_system_state* state) {
     ibl_cube_texture->texture_maps = kallocate(sizeof(texture_map*) * ibl_cube_texture->texture_map_count, MEMORY_TAG_ARRAY);
     ibl_cube_texture->texture_maps[0] = &m->maps[SAMP_IRRADIANCE_MAP];
 
+    // IBL specular texture
+    shader_instance_uniform_texture_config* ibl_specular_texture = &instance_resource_config.uniform_configs[3];
+    ibl_specular_texture->uniform_location = state_ptr->pbr_locations.ibl_specular_texture;
+    ibl_specular_texture->texture_map_count = 1;
+    ibl_specular_texture->texture_maps = kallocate(sizeof(texture_map*) * ibl_specular_texture->texture_map_count, MEMORY_TAG_ARRAY);
+    ibl_specular_texture->texture_maps[0] = &m->maps[SAMP_IBL_SPECULAR_MAP];
+
+    // IBL BRDF lookup table
+    shader_instance_uniform_texture_config* ibl_brdf_lut = &instance_resource_config.uniform_configs[4];
+    ibl_brdf_lut->uniform_location = state_ptr->pbr_locations.ibl_brdf_lut;
+    ibl_brdf_lut->texture_map_count = 1;
+    ibl_brdf_lut->texture_maps = kallocate(sizeof(texture_map*) * ibl_brdf_lut->texture_map_count, MEMORY_TAG_ARRAY);
+    ibl_brdf_lut->texture_maps[0] = &m->maps[SAMP_IBL_BRDF_LUT_MAP];
+
+    // Point shadow textures
+    shader_instance_uniform_texture_config* point_shadow_textures = &instance_resource_config.uniform_configs[5];
+    point_shadow_textures->uniform_location = state_ptr->pbr_locations.point_shadow_textures;
+    point_shadow_textures->texture_map_count = 1;
+    point_shadow_textures->texture_maps = kallocate(sizeof(texture_map*) * point_shadow_textures->texture_map_count, MEMORY_TAG_ARRAY);
+    point_shadow_textures->texture_maps[0] = &m->maps[SAMP_POINT_SHADOW_MAP];
+
     shader* s = shader_system_get_by_id(state_ptr->pbr_shader_id);
     if (!renderer_shader_instance_resources_acquire(s, &instance_resource_config, &state->default_pbr_material.internal_id)) {
         KFATAL("Failed to acquire renderer resources for default PBR material. Application cannot continue.");
         return false;
     }
+    pbr_parameters_upload(&state->default_pbr_material);
 
     // Clean up the uniform configs.
     for (u32 i = 0; i < instance_resource_config.uniform_config_count; ++i) {
@@ -1340,6 +2006,7 @@ static b8 create_default_terrain_material(material_system_state* state) {
     // Change the clamp mode on the default shadow map to border.
     texture_map* ssm = &state->default_terrain_material.maps[SAMP_TERRAIN_SHADOW_MAP];
     ssm->repeat_u = ssm->repeat_v = ssm->repeat_w = TEXTURE_REPEAT_CLAMP_TO_BORDER;
+    ssm->compare_depth = true;
 
     // NOTE: PBR materials are required for terrains.
     // NOTE: 4 materials * 3 maps per will still be loaded in order (albedo/norm/met/rough/ao per mat)
@@ -1394,3 +2061,46 @@ static b8 create_default_terrain_material(material_system_state* state) {
 
     return true;
 }
+
+// Gets the locations of the uniforms of a terrain shader. The heightmap is only looked up in the
+// heightmap terrain shader, which has the same uniforms as the terrain shader besides.
+static void terrain_shader_locations_get(shader* s, terrain_shader_locations* out_locations) {
+    out_locations->projection = shader_system_uniform_location(s, "projection");
+    out_locations->view = shader_system_uniform_location(s, "view");
+    out_locations->light_space_0 = shader_system_uniform_location(s, "light_space_0");
+    out_locations->light_space_1 = shader_system_uniform_location(s, "light_space_1");
+    out_locations->light_space_2 = shader_system_uniform_location(s, "light_space_2");
+    out_locations->light_space_3 = shader_system_uniform_location(s, "light_space_3");
+    out_locations->cascade_splits = shader_system_uniform_location(s, "cascade_splits");
+    out_locations->view_position = shader_system_uniform_location(s, "view_position");
+    out_locations->model = shader_system_uniform_location(s, "model");
+    out_locations->render_mode = shader_system_uniform_location(s, "mode");
+    out_locations->dir_light = shader_system_uniform_location(s, "dir_light");
+    out_locations->point_lights = shader_system_uniform_location(s, "point_lights");
+    out_locations->light_clusters = shader_system_uniform_location(s, "light_clusters");
+
+    out_locations->properties = shader_system_uniform_location(s, "properties");
+    out_locations->material_texures = shader_system_uniform_location(s, "material_textures");
+    out_locations->shadow_textures = shader_system_uniform_location(s, "shadow_textures");
+    out_locations->ibl_cube_texture = shader_system_uniform_location(s, "ibl_cube_texture");
+    out_locations->use_pcf = shader_system_uniform_location(s, "use_pcf");
+    out_locations->bias = shader_system_uniform_location(s, "bias");
+    out_locations->heightmap = s == state_ptr->terrain_heightmap_shader ? shader_system_uniform_location(s, "heightmap") : INVALID_ID_U16;
+
+    const shader_local_block_member terrain_local_members[] = {{"model", 0, sizeof(mat4)}};
+    out_locations->local_block_valid = shader_system_local_block_verify(s, 1, terrain_local_members, sizeof(mat4));
+    if (!out_locations->local_block_valid) {
+        KWARN("Shader '%s' locals don't match the packed local block. Falling back to setting them individually.", s->name);
+    }
+}
+
+// Gets the locations of the terrain shader with the given id, or 0 if it isn't a terrain shader.
+static const terrain_shader_locations* terrain_locations_get(u32 shader_id) {
+    if (shader_id == state_ptr->terrain_shader_id) {
+        return &state_ptr->terrain_locations;
+    }
+    if (shader_id != INVALID_ID && shader_id == state_ptr->terrain_heightmap_shader_id) {
+        return &state_ptr->terrain_heightmap_locations;
+    }
+    return 0;
+}
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include "core/kname.h"
 #include "defines.h"
 #include "resources/resource_types.h"
 
@@ -21,6 +22,15 @@
 /** @brief The name of the default terrain material. */
 #define DEFAULT_TERRAIN_MATERIAL_NAME "default_terrain"
 
+/**
+ * @brief The highest shadow filtering quality of PBR materials, set by the shadow_quality kvar.
+ * 0 takes a single hardware filtered tap per fragment, and 1, 2 and 3 take 4, 8 and 16.
+ */
+#define MATERIAL_SHADOW_QUALITY_MAX 3
+
+/** @brief The shadow filtering quality of PBR materials until the shadow_quality kvar is changed. */
+#define MATERIAL_SHADOW_QUALITY_DEFAULT 2
+
 /** @brief The configuration for the material system. */
 typedef struct material_system_config {
     /** @brief The maximum number of loaded materials. */
@@ -58,6 +68,16 @@ void material_system_shutdown(void* state);
  */
 KAPI material* material_system_acquire(const char* name);
 
+/**
+ * @brief Attempts to acquire a material with the given name. Same as material_system_acquire,
+ * but avoids rehashing the name. If the material is already loaded, its configuration is
+ * not loaded again.
+ *
+ * @param name The kname of the material to find. Must have been obtained via kname_create.
+ * @return A pointer to the loaded material. Can be a pointer to the default material if not found.
+ */
+KAPI material* material_system_acquire_by_kname(kname name);
+
 /**
  * @brief Attempts to acquire a terrain material with the given name. If it has not yet been
  * loaded, this triggers it to be loaded from using the provided standard material names. If
@@ -71,6 +91,20 @@ KAPI material* material_system_acquire(const char* name);
  */
 KAPI material* material_system_acquire_terrain_material(const char* material_name, u32 material_count, const char** material_names, b8 auto_release);
 
+/**
+ * @brief Attempts to acquire a terrain material with the given name, drawn with the heightmap terrain
+ * shader, which pulls the vertices of the terrain from the given heightmap. Otherwise the same as
+ * material_system_acquire_terrain_material, except that there is no default to fall back to.
+ *
+ * @param name The name of the terrain material to find.
+ * @param material_count The number of standard source material names.
+ * @param material_names The names of the source materials to be used.
+ * @param heightmap A pointer to the heightmap texture of the terrain. The material holds a reference to it.
+ * @param auto_release Indicates if the material is released once it has no more references.
+ * @return A pointer to the loaded terrain material, or 0 if it could not be loaded.
+ */
+KAPI material* material_system_acquire_heightmap_terrain_material(const char* material_name, u32 material_count, const char** material_names, texture* heightmap, b8 auto_release);
+
 /**
  * @brief Attempts to acquire a material from the given configuration. If it has not yet been loaded,
  * this triggers it to load. If the material is not found, a pointer to the default material
@@ -90,6 +124,14 @@ KAPI material* material_system_acquire_from_config(material_config* config);
  */
 KAPI void material_system_release(const char* name);
 
+/**
+ * @brief Releases a material with the given name. Same as material_system_release,
+ * but avoids rehashing the name.
+ *
+ * @param name The kname of the material to unload.
+ */
+KAPI void material_system_release_by_kname(kname name);
+
 /**
  * @brief Gets a pointer to the default material. Does not reference count.
  */
@@ -105,6 +147,15 @@ KAPI material* material_system_get_default_pbr(void);
  */
 KAPI material* material_system_get_default_terrain(void);
 
+/**
+ * @brief Gets the storage buffer holding the parameters of every PBR material, indexed by the
+ * material's internal id (i.e. the material_id of a scene object). Entries are only written when a
+ * material is created or reloaded. Bound by passes which draw with the PBR shader.
+ *
+ * @return A pointer to the buffer. 0 if the material system is not initialized.
+ */
+KAPI struct renderbuffer* material_system_parameter_buffer_get(void);
+
 /**
  * @brief Applies global-level data for the material shader id.
  *
@@ -145,6 +196,14 @@ KAPI b8 material_system_apply_local(material* m, const mat4* model, struct frame
  * @returns True on success; otherwise false;
  */
 KAPI b8 material_system_shadow_map_set(texture* shadow_texture, u8 index);
+/**
+ * @brief Sets the provided point shadow atlas to be used for future binding/draw calls until changed.
+ * Its faces are found through the shadows uploaded by the light system.
+ *
+ * @param point_shadow_texture A pointer to the point shadow atlas to be used.
+ * @returns True on success; otherwise false;
+ */
+KAPI b8 material_system_point_shadow_map_set(texture* point_shadow_texture);
 /**
  * @brief Sets the provided cubemap texture to be used for future binding/draw calls until changed.
  *  NOTE: Provided texture must be a cubemap texture or this function will fail.
@@ -154,6 +213,27 @@ KAPI b8 material_system_shadow_map_set(texture* shadow_texture, u8 index);
  */
 KAPI b8 material_system_irradiance_set(texture* irradiance_cube_texture);
 
+/**
+ * @brief Sets the image based lighting textures to be used for future binding/draw calls until changed:
+ * the irradiance cubemap as with material_system_irradiance_set, as well as the prefiltered specular
+ * cubemap and BRDF lookup table. Specular image based lighting is only applied while both of those are set.
+ *
+ * @param irradiance_cube_texture A pointer to the irradiance cubemap texture to be used. If null, system falls back on default cubemap texuture.
+ * @param specular_cube_texture A pointer to the prefiltered specular cubemap texture, with roughness increasing down its mip levels. Optional.
+ * @param brdf_lut A pointer to the BRDF lookup table texture. Optional.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 material_system_ibl_set(texture* irradiance_cube_texture, texture* specular_cube_texture, texture* brdf_lut);
+
+/**
+ * @brief Sets whether materials are drawn with their weighted blended transparency variants for future
+ * draw calls until changed. These accumulate into the attachments of weighted blended transparency
+ * rather than blending over the colour (see SHADER_FLAG_BLEND_WEIGHTED). Has no effect if it isn't supported.
+ *
+ * @param enabled Indicates if the weighted blended variants are used.
+ */
+KAPI void material_system_weighted_blend_set(b8 enabled);
+
 /**
  * @brief Sets the current directional light-space matrix to be used for future binding calls that require it.
  *
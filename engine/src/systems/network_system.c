@@ -0,0 +1,1345 @@
+#include "network_system.h"
+
+#include "containers/darray.h"
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/bvh.h"
+#include "math/kmath.h"
+#include "math/transform.h"
+#include "platform/platform.h"
+#include "systems/job_system.h"
+#include "utils/kbitstream.h"
+#include "utils/ksort.h"
+
+// Identifies packets of this protocol, so stray datagrams are ignored.
+#define NETWORK_PROTOCOL_ID 0x4B4E4554
+#define NETWORK_PACKET_TYPE_BITS 3
+#define NETWORK_SEQUENCE_BITS 16
+// Enough to count back through the whole history.
+#define NETWORK_BASELINE_OFFSET_BITS 5
+
+// How often a connecting client repeats its request.
+#define NETWORK_CONNECT_RETRY_INTERVAL 0.25
+// The longest a connected client goes without sending, even with nothing to acknowledge.
+#define NETWORK_KEEPALIVE_INTERVAL 0.25
+
+// Entities known to a client are kept while within this multiple of the interest radius, so
+// those near its edge are not repeatedly removed and created again.
+#define NETWORK_INTEREST_HYSTERESIS 1.2f
+// How far the bounds kept in the hierarchy are grown beyond an entity, so small movements don't refit it.
+#define NETWORK_BOUNDS_MARGIN 1.0f
+
+// The bits per group of the variable length values sent.
+#define NETWORK_ID_GAP_GROUP_BITS 4
+#define NETWORK_COUNT_GROUP_BITS 6
+#define NETWORK_DELTA_GROUP_BITS 4
+#define NETWORK_STATE_GROUP_BITS 8
+
+// The bits of a snapshot packet which are not changes: the protocol id, type, sequence, baseline offset and change count.
+#define NETWORK_SNAPSHOT_HEADER_BITS (32 + NETWORK_PACKET_TYPE_BITS + NETWORK_SEQUENCE_BITS + NETWORK_BASELINE_OFFSET_BITS + 14)
+
+#define NETWORK_FIELD_POSITION 0x1
+#define NETWORK_FIELD_ROTATION 0x2
+#define NETWORK_FIELD_STATE 0x4
+#define NETWORK_FIELD_BITS 3
+
+typedef enum network_packet_type {
+    NETWORK_PACKET_TYPE_CONNECT_REQUEST,
+    NETWORK_PACKET_TYPE_CONNECT_ACCEPT,
+    NETWORK_PACKET_TYPE_CONNECT_DENIED,
+    NETWORK_PACKET_TYPE_SNAPSHOT,
+    NETWORK_PACKET_TYPE_ACK,
+    NETWORK_PACKET_TYPE_DISCONNECT
+} network_packet_type;
+
+typedef enum network_change_kind {
+    // An entity in the baseline with different fields.
+    NETWORK_CHANGE_KIND_UPDATE,
+    // An entity not in the baseline, or replacing one which was destroyed with the same id.
+    NETWORK_CHANGE_KIND_CREATE,
+    // An entity in the baseline which is no longer of interest, or was destroyed.
+    NETWORK_CHANGE_KIND_REMOVE
+} network_change_kind;
+#define NETWORK_CHANGE_KIND_BITS 2
+
+// The quantized state of an entity, as replicated.
+typedef struct network_record {
+    u32 id;
+    // Tells apart entities which have had the same id. Never sent.
+    u32 generation;
+    u32 position[3];
+    u32 rotation;
+    u32 state;
+} network_record;
+
+// The entities of a snapshot, as both ends of a connection know it.
+typedef struct network_snapshot {
+    b8 valid;
+    u16 sequence;
+    // darray, sorted by id.
+    network_record* records;
+} network_snapshot;
+
+// A difference of the snapshot being built for a client from its baseline.
+typedef struct network_change {
+    u32 id;
+    network_change_kind kind;
+    u32 fields;
+    // The index in the snapshot being built of the record the change is for.
+    u32 record_index;
+    f32 priority;
+    // An upper bound of the bits the change takes to send.
+    u32 bit_count;
+} network_change;
+
+// The quantization both ends of a session agree on.
+typedef struct network_session {
+    extents_3d world_bounds;
+    u32 position_bits;
+    u32 rotation_bits;
+} network_session;
+
+// A client, as the server sees it.
+typedef struct network_remote_client {
+    b8 connected;
+    platform_address address;
+    u32 salt;
+    f64 last_received_time;
+    vec3 view_position;
+    b8 has_ack;
+    u16 acked_sequence;
+    network_snapshot history[NETWORK_SNAPSHOT_HISTORY];
+    // The priority accumulated by each entity's changes while waiting to be sent, indexed by id.
+    f32* priorities;
+
+    // Used while building each snapshot. darrays.
+    u32* visible_ids;
+    network_change* changes;
+
+    u8 packet[NETWORK_MAX_PACKET_SIZE];
+    u32 packet_size;
+    u32 changes_deferred;
+} network_remote_client;
+
+typedef struct network_system_state {
+    network_system_config config;
+    network_role role;
+    platform_socket socket;
+    network_session session;
+    f64 time;
+    network_system_stats stats;
+
+    // Server.
+    network_server_config server_config;
+    network_remote_client* clients;
+    f64 snapshot_accumulator;
+    u16 sequence;
+    // Entities, indexed by id.
+    u8* entity_alive;
+    u32* entity_generations;
+    transform** entity_transforms;
+    vec3* entity_positions;
+    quat* entity_rotations;
+    u32* entity_states;
+    f32* entity_radii;
+    u32* entity_leaves;
+    extents_3d* entity_bounds;
+    // The records captured for the snapshot being built, indexed by id.
+    network_record* current;
+    // One past the highest id in use.
+    u32 entity_high_water;
+    u32 entity_count;
+    // darray
+    u32* free_ids;
+    bvh interest_tree;
+    u32 refit_count;
+    // Used when rebuilding the hierarchy. darrays.
+    extents_3d* build_bounds;
+    u32* build_ids;
+    u32* build_leaves;
+
+    // Client.
+    network_client_status client_status;
+    platform_address server_address;
+    u32 salt;
+    f64 connect_start_time;
+    f64 last_sent_time;
+    f64 last_received_time;
+    vec3 view_position;
+    network_snapshot received[NETWORK_SNAPSHOT_HISTORY];
+    b8 has_latest;
+    u16 latest_sequence;
+    b8 ack_pending;
+    // darray, sorted by id.
+    network_entity_state* entities;
+} network_system_state;
+
+static network_system_state* state_ptr = 0;
+
+// Indicates if sequence a comes after b, allowing for wrapping around.
+static b8 sequence_greater(u16 a, u16 b) {
+    return ((a > b) && (a - b <= 32768)) || ((a < b) && (b - a > 32768));
+}
+
+static u32 f32_bits(f32 value) {
+    u32 bits;
+    kcopy_memory(&bits, &value, sizeof(u32));
+    return bits;
+}
+
+static f32 bits_f32(u32 bits) {
+    f32 value;
+    kcopy_memory(&value, &bits, sizeof(f32));
+    return value;
+}
+
+static u32 zigzag(i32 value) {
+    return ((u32)value << 1) ^ (u32)(value >> 31);
+}
+
+static i32 unzigzag(u32 value) {
+    return (i32)(value >> 1) ^ -(i32)(value & 1);
+}
+
+// The number of bits kbitstream_write_varint takes for the given value.
+static u32 varint_bit_count(u32 value, u32 bits_per_group) {
+    u32 bits = 0;
+    do {
+        bits += bits_per_group + 1;
+        value >>= bits_per_group;
+    } while (value);
+    return bits;
+}
+
+static void position_quantize(const network_session* session, vec3 position, u32* out_position) {
+    out_position[0] = kquantize_f32(position.x, session->world_bounds.min.x, session->world_bounds.max.x, session->position_bits);
+    out_position[1] = kquantize_f32(position.y, session->world_bounds.min.y, session->world_bounds.max.y, session->position_bits);
+    out_position[2] = kquantize_f32(position.z, session->world_bounds.min.z, session->world_bounds.max.z, session->position_bits);
+}
+
+static vec3 position_dequantize(const network_session* session, const u32* position) {
+    return (vec3){{kdequantize_f32(position[0], session->world_bounds.min.x, session->world_bounds.max.x, session->position_bits),
+                   kdequantize_f32(position[1], session->world_bounds.min.y, session->world_bounds.max.y, session->position_bits),
+                   kdequantize_f32(position[2], session->world_bounds.min.z, session->world_bounds.max.z, session->position_bits)}};
+}
+
+static void packet_begin(kbitstream* stream, void* buffer, u32 capacity, network_packet_type type) {
+    kzero_memory(buffer, capacity);
+    kbitstream_create(buffer, capacity, stream);
+    kbitstream_write_bits(stream, NETWORK_PROTOCOL_ID, 32);
+    kbitstream_write_bits(stream, type, NETWORK_PACKET_TYPE_BITS);
+}
+
+static void packet_send(const platform_address* to, const kbitstream* stream) {
+    if (stream->overflowed) {
+        KERROR("Network packet overflowed; not sent.");
+        return;
+    }
+    u32 size = kbitstream_bytes_used(stream);
+    if (platform_udp_socket_send(&state_ptr->socket, to, stream->data, size)) {
+        state_ptr->stats.packets_sent++;
+        state_ptr->stats.bytes_sent += size;
+    }
+}
+
+static void snapshot_reset(network_snapshot* snapshot) {
+    snapshot->valid = false;
+    if (snapshot->records) {
+        darray_clear(snapshot->records);
+    }
+}
+
+static void session_end(void) {
+    network_system_state* state = state_ptr;
+    for (u32 i = 0; i < state->config.max_client_count; ++i) {
+        network_remote_client* client = &state->clients[i];
+        client->connected = false;
+        for (u32 h = 0; h < NETWORK_SNAPSHOT_HISTORY; ++h) {
+            snapshot_reset(&client->history[h]);
+        }
+    }
+    for (u32 i = 0; i < NETWORK_SNAPSHOT_HISTORY; ++i) {
+        snapshot_reset(&state->received[i]);
+    }
+    darray_clear(state->entities);
+    platform_udp_socket_close(&state->socket);
+    state->role = NETWORK_ROLE_NONE;
+    state->client_status = NETWORK_CLIENT_STATUS_DISCONNECTED;
+    state->has_latest = false;
+    state->ack_pending = false;
+    state->stats.client_count = 0;
+}
+
+b8 network_system_initialize(u64* memory_requirement, void* state, void* config) {
+    if (!memory_requirement || !config) {
+        KERROR("Network system initialization requires valid pointers to memory_requirement and config.");
+        return false;
+    }
+    network_system_config* typed_config = (network_system_config*)config;
+    if (typed_config->max_entity_count == 0 || typed_config->max_client_count == 0) {
+        KERROR("network_system_initialize - config.max_entity_count and config.max_client_count must be > 0.");
+        return false;
+    }
+
+    *memory_requirement = sizeof(network_system_state);
+    if (!state) {
+        return true;
+    }
+
+    kzero_memory(state, sizeof(network_system_state));
+    network_system_state* typed_state = (network_system_state*)state;
+    typed_state->config = *typed_config;
+
+    u32 entity_count = typed_config->max_entity_count;
+    typed_state->entity_alive = kallocate(sizeof(u8) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_generations = kallocate(sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_transforms = kallocate(sizeof(transform*) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_positions = kallocate(sizeof(vec3) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_rotations = kallocate(sizeof(quat) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_states = kallocate(sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_radii = kallocate(sizeof(f32) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_leaves = kallocate(sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->entity_bounds = kallocate(sizeof(extents_3d) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->current = kallocate(sizeof(network_record) * entity_count, MEMORY_TAG_NETWORK);
+    typed_state->free_ids = darray_create(u32);
+    typed_state->build_bounds = darray_create(extents_3d);
+    typed_state->build_ids = darray_create(u32);
+    typed_state->build_leaves = darray_create(u32);
+    if (!bvh_create(&typed_state->interest_tree)) {
+        KERROR("Failed to create the interest hierarchy of the network system.");
+        return false;
+    }
+
+    typed_state->clients = kallocate(sizeof(network_remote_client) * typed_config->max_client_count, MEMORY_TAG_NETWORK);
+    for (u32 i = 0; i < typed_config->max_client_count; ++i) {
+        network_remote_client* client = &typed_state->clients[i];
+        client->priorities = kallocate(sizeof(f32) * entity_count, MEMORY_TAG_NETWORK);
+        client->visible_ids = darray_create(u32);
+        client->changes = darray_create(network_change);
+        for (u32 h = 0; h < NETWORK_SNAPSHOT_HISTORY; ++h) {
+            client->history[h].records = darray_create(network_record);
+        }
+    }
+    for (u32 i = 0; i < NETWORK_SNAPSHOT_HISTORY; ++i) {
+        typed_state->received[i].records = darray_create(network_record);
+    }
+    typed_state->entities = darray_create(network_entity_state);
+
+    state_ptr = typed_state;
+    return true;
+}
+
+void network_system_shutdown(void* state) {
+    if (state) {
+        network_system_state* typed_state = (network_system_state*)state;
+        if (typed_state->role != NETWORK_ROLE_NONE) {
+            network_disconnect();
+        }
+
+        u32 entity_count = typed_state->config.max_entity_count;
+        for (u32 i = 0; i < typed_state->config.max_client_count; ++i) {
+            network_remote_client* client = &typed_state->clients[i];
+            for (u32 h = 0; h < NETWORK_SNAPSHOT_HISTORY; ++h) {
+                darray_destroy(client->history[h].records);
+            }
+            darray_destroy(client->changes);
+            darray_destroy(client->visible_ids);
+            kfree(client->priorities, sizeof(f32) * entity_count, MEMORY_TAG_NETWORK);
+        }
+        kfree(typed_state->clients, sizeof(network_remote_client) * typed_state->config.max_client_count, MEMORY_TAG_NETWORK);
+        for (u32 i = 0; i < NETWORK_SNAPSHOT_HISTORY; ++i) {
+            darray_destroy(typed_state->received[i].records);
+        }
+        darray_destroy(typed_state->entities);
+
+        bvh_destroy(&typed_state->interest_tree);
+        darray_destroy(typed_state->build_leaves);
+        darray_destroy(typed_state->build_ids);
+        darray_destroy(typed_state->build_bounds);
+        darray_destroy(typed_state->free_ids);
+        kfree(typed_state->current, sizeof(network_record) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_bounds, sizeof(extents_3d) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_leaves, sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_radii, sizeof(f32) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_states, sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_rotations, sizeof(quat) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_positions, sizeof(vec3) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_transforms, sizeof(transform*) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_generations, sizeof(u32) * entity_count, MEMORY_TAG_NETWORK);
+        kfree(typed_state->entity_alive, sizeof(u8) * entity_count, MEMORY_TAG_NETWORK);
+        kzero_memory(typed_state, sizeof(network_system_state));
+    }
+    state_ptr = 0;
+}
+
+// Server.
+
+static network_remote_client* client_find(const platform_address* address, u32 salt) {
+    for (u32 i = 0; i < state_ptr->config.max_client_count; ++i) {
+        network_remote_client* client = &state_ptr->clients[i];
+        if (client->connected && client->salt == salt && client->address.ip == address->ip && client->address.port == address->port) {
+            return client;
+        }
+    }
+    return 0;
+}
+
+static void client_drop(network_remote_client* client) {
+    client->connected = false;
+    for (u32 h = 0; h < NETWORK_SNAPSHOT_HISTORY; ++h) {
+        snapshot_reset(&client->history[h]);
+    }
+    state_ptr->stats.client_count--;
+}
+
+static void connect_accept_send(const network_remote_client* client) {
+    const network_session* session = &state_ptr->session;
+    u8 buffer[64];
+    kbitstream stream;
+    packet_begin(&stream, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_CONNECT_ACCEPT);
+    kbitstream_write_bits(&stream, client->salt, 32);
+    for (u32 i = 0; i < 3; ++i) {
+        kbitstream_write_bits(&stream, f32_bits(session->world_bounds.min.elements[i]), 32);
+        kbitstream_write_bits(&stream, f32_bits(session->world_bounds.max.elements[i]), 32);
+    }
+    kbitstream_write_bits(&stream, session->position_bits, 5);
+    kbitstream_write_bits(&stream, session->rotation_bits, 4);
+    packet_send(&client->address, &stream);
+}
+
+static void server_packet_handle(const platform_address* from, kbitstream* stream, network_packet_type type) {
+    network_system_state* state = state_ptr;
+    u32 salt = kbitstream_read_bits(stream, 32);
+    network_remote_client* client = client_find(from, salt);
+
+    switch (type) {
+        case NETWORK_PACKET_TYPE_CONNECT_REQUEST: {
+            if (stream->overflowed) {
+                return;
+            }
+            if (!client) {
+                for (u32 i = 0; i < state->config.max_client_count; ++i) {
+                    if (!state->clients[i].connected) {
+                        client = &state->clients[i];
+                        break;
+                    }
+                }
+                if (!client) {
+                    u8 buffer[16];
+                    kbitstream denied;
+                    packet_begin(&denied, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_CONNECT_DENIED);
+                    kbitstream_write_bits(&denied, salt, 32);
+                    packet_send(from, &denied);
+                    return;
+                }
+                client->connected = true;
+                client->address = *from;
+                client->salt = salt;
+                client->has_ack = false;
+                // Until the client says otherwise, it views the world from the center.
+                client->view_position = vec3_mul_scalar(vec3_add(state->session.world_bounds.min, state->session.world_bounds.max), 0.5f);
+                kzero_memory(client->priorities, sizeof(f32) * state->config.max_entity_count);
+                state->stats.client_count++;
+                KINFO("Network client connected (slot %u).", (u32)(client - state->clients));
+            }
+            client->last_received_time = state->time;
+            // Also repeated for requests retried because the acceptance was lost.
+            connect_accept_send(client);
+        } break;
+        case NETWORK_PACKET_TYPE_ACK: {
+            if (!client) {
+                return;
+            }
+            b8 has_ack = kbitstream_read_bool(stream);
+            u16 ack = (u16)kbitstream_read_bits(stream, NETWORK_SEQUENCE_BITS);
+            u32 view[3];
+            for (u32 i = 0; i < 3; ++i) {
+                view[i] = kbitstream_read_bits(stream, state->session.position_bits);
+            }
+            if (stream->overflowed) {
+                return;
+            }
+            client->last_received_time = state->time;
+            client->view_position = position_dequantize(&state->session, view);
+            if (has_ack && (!client->has_ack || sequence_greater(ack, client->acked_sequence))) {
+                client->has_ack = true;
+                client->acked_sequence = ack;
+            }
+        } break;
+        case NETWORK_PACKET_TYPE_DISCONNECT: {
+            if (client) {
+                KINFO("Network client disconnected (slot %u).", (u32)(client - state->clients));
+                client_drop(client);
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+static void interest_tree_rebuild(void) {
+    network_system_state* state = state_ptr;
+    darray_clear(state->build_bounds);
+    darray_clear(state->build_ids);
+    for (u32 id = 0; id < state->entity_high_water; ++id) {
+        if (state->entity_alive[id]) {
+            darray_push(state->build_bounds, state->entity_bounds[id]);
+            darray_push(state->build_ids, id);
+        }
+    }
+    u32 count = darray_length(state->build_ids);
+    darray_reserve_exact(state->build_leaves, count);
+    darray_length_set(state->build_leaves, count);
+    bvh_build(&state->interest_tree, count, state->build_bounds, state->build_ids, state->build_leaves);
+    for (u32 i = 0; i < count; ++i) {
+        state->entity_leaves[state->build_ids[i]] = state->build_leaves[i];
+    }
+    state->refit_count = 0;
+}
+
+// Captures the quantized state of every entity, and keeps the hierarchy in step with where they are.
+static void server_capture(void) {
+    network_system_state* state = state_ptr;
+    for (u32 id = 0; id < state->entity_high_water; ++id) {
+        if (!state->entity_alive[id]) {
+            continue;
+        }
+        vec3 position = state->entity_positions[id];
+        quat rotation = state->entity_rotations[id];
+        if (state->entity_transforms[id]) {
+            position = transform_position_get(state->entity_transforms[id]);
+            rotation = transform_rotation_get(state->entity_transforms[id]);
+        }
+
+        network_record* record = &state->current[id];
+        record->id = id;
+        record->generation = state->entity_generations[id];
+        position_quantize(&state->session, position, record->position);
+        record->rotation = kquantize_quat(quat_normalize(rotation), state->session.rotation_bits);
+        record->state = state->entity_states[id];
+
+        f32 radius = state->entity_radii[id];
+        extents_3d* bounds = &state->entity_bounds[id];
+        vec3 extent = vec3_create(radius, radius, radius);
+        vec3 min = vec3_sub(position, extent);
+        vec3 max = vec3_add(position, extent);
+        if (min.x < bounds->min.x || min.y < bounds->min.y || min.z < bounds->min.z ||
+            max.x > bounds->max.x || max.y > bounds->max.y || max.z > bounds->max.z) {
+            vec3 margin = vec3_create(NETWORK_BOUNDS_MARGIN, NETWORK_BOUNDS_MARGIN, NETWORK_BOUNDS_MARGIN);
+            bounds->min = vec3_sub(min, margin);
+            bounds->max = vec3_add(max, margin);
+            bvh_refit(&state->interest_tree, state->entity_leaves[id], *bounds);
+            state->refit_count++;
+        }
+    }
+
+    // Refitting leaves the structure of the tree as it was, so it is rebuilt once enough has moved.
+    if (state->refit_count > state->entity_count / 4 + 16) {
+        interest_tree_rebuild();
+    }
+}
+
+typedef struct interest_query {
+    vec3 center;
+    f32 radius_squared;
+    u32** out_ids;
+} interest_query;
+
+static b8 interest_test(const extents_3d* bounds, void* context) {
+    const interest_query* query = context;
+    if (query->radius_squared <= 0.0f) {
+        return true;
+    }
+    f32 distance_squared = 0.0f;
+    for (u32 i = 0; i < 3; ++i) {
+        f32 v = query->center.elements[i];
+        if (v < bounds->min.elements[i]) {
+            distance_squared += (bounds->min.elements[i] - v) * (bounds->min.elements[i] - v);
+        } else if (v > bounds->max.elements[i]) {
+            distance_squared += (v - bounds->max.elements[i]) * (v - bounds->max.elements[i]);
+        }
+    }
+    return distance_squared <= query->radius_squared;
+}
+
+static b8 interest_found(u32 user_data, void* context) {
+    interest_query* query = context;
+    darray_push(*query->out_ids, user_data);
+    return true;
+}
+
+static i32 id_compare(void* a, void* b) {
+    u32 id_a = *(u32*)a;
+    u32 id_b = *(u32*)b;
+    return id_a < id_b ? -1 : (id_a > id_b ? 1 : 0);
+}
+
+// Sorts changes by descending priority.
+static i32 change_priority_compare(void* a, void* b) {
+    f32 priority_a = ((network_change*)a)->priority;
+    f32 priority_b = ((network_change*)b)->priority;
+    return priority_a > priority_b ? -1 : (priority_a < priority_b ? 1 : 0);
+}
+
+static i32 change_id_compare(void* a, void* b) {
+    return id_compare(&((network_change*)a)->id, &((network_change*)b)->id);
+}
+
+static u32 position_delta_bit_count(const network_session* session, const u32* position, const u32* baseline, b8* out_absolute) {
+    u32 delta_bits = 0;
+    for (u32 i = 0; i < 3; ++i) {
+        delta_bits += varint_bit_count(zigzag((i32)position[i] - (i32)baseline[i]), NETWORK_DELTA_GROUP_BITS);
+    }
+    u32 absolute_bits = session->position_bits * 3;
+    *out_absolute = absolute_bits <= delta_bits;
+    return 1 + KMIN(delta_bits, absolute_bits);
+}
+
+static void position_write(kbitstream* stream, const network_session* session, const u32* position, const u32* baseline) {
+    b8 absolute = true;
+    if (baseline) {
+        position_delta_bit_count(session, position, baseline, &absolute);
+        kbitstream_write_bool(stream, absolute);
+    }
+    for (u32 i = 0; i < 3; ++i) {
+        if (absolute) {
+            kbitstream_write_bits(stream, position[i], session->position_bits);
+        } else {
+            kbitstream_write_varint(stream, zigzag((i32)position[i] - (i32)baseline[i]), NETWORK_DELTA_GROUP_BITS);
+        }
+    }
+}
+
+static void position_read(kbitstream* stream, const network_session* session, u32* position, const u32* baseline) {
+    b8 absolute = baseline ? kbitstream_read_bool(stream) : true;
+    for (u32 i = 0; i < 3; ++i) {
+        if (absolute) {
+            position[i] = kbitstream_read_bits(stream, session->position_bits);
+        } else {
+            position[i] = (u32)((i32)baseline[i] + unzigzag(kbitstream_read_varint(stream, NETWORK_DELTA_GROUP_BITS)));
+        }
+    }
+}
+
+// The weight an entity's changes gain each snapshot, more for those closer to the client's view.
+static f32 change_weight(const network_remote_client* client, u32 id, f32 radius) {
+    if (radius <= 0.0f) {
+        return 1.0f;
+    }
+    vec3 position = position_dequantize(&state_ptr->session, state_ptr->current[id].position);
+    f32 distance = vec3_distance(position, client->view_position);
+    return 1.0f + KMAX(0.0f, 1.0f - distance / radius) * 3.0f;
+}
+
+// An upper bound of the bits the given change takes to send.
+static u32 change_bit_count(const network_change* change, const network_record* current, const network_record* base) {
+    const network_session* session = &state_ptr->session;
+    // The id is sent as the gap from the one before, which is never more than the id itself.
+    u32 bits = varint_bit_count(change->id, NETWORK_ID_GAP_GROUP_BITS) + NETWORK_CHANGE_KIND_BITS;
+    b8 absolute;
+    switch (change->kind) {
+        case NETWORK_CHANGE_KIND_CREATE:
+            bits += session->position_bits * 3 + 2 + session->rotation_bits * 3;
+            bits += varint_bit_count(current->state, NETWORK_STATE_GROUP_BITS);
+            break;
+        case NETWORK_CHANGE_KIND_UPDATE:
+            bits += NETWORK_FIELD_BITS;
+            if (change->fields & NETWORK_FIELD_POSITION) {
+                bits += position_delta_bit_count(session, current->position, base->position, &absolute);
+            }
+            if (change->fields & NETWORK_FIELD_ROTATION) {
+                bits += 2 + session->rotation_bits * 3;
+            }
+            if (change->fields & NETWORK_FIELD_STATE) {
+                bits += varint_bit_count(current->state, NETWORK_STATE_GROUP_BITS);
+            }
+            break;
+        case NETWORK_CHANGE_KIND_REMOVE:
+            break;
+    }
+    return bits;
+}
+
+// Builds the snapshot of the current sequence for the given client, and encodes it into its packet.
+static void client_snapshot_build(network_remote_client* client) {
+    network_system_state* state = state_ptr;
+    const network_session* session = &state->session;
+    u16 sequence = state->sequence;
+    f32 radius = state->server_config.interest_radius;
+
+    // The most recent snapshot the client has acknowledged, if it is still in the history.
+    const network_snapshot* baseline = 0;
+    u32 baseline_offset = 0;
+    if (client->has_ack) {
+        u16 offset = (u16)(sequence - client->acked_sequence);
+        const network_snapshot* acked = &client->history[client->acked_sequence % NETWORK_SNAPSHOT_HISTORY];
+        if (offset > 0 && offset < NETWORK_SNAPSHOT_HISTORY && acked->valid && acked->sequence == client->acked_sequence) {
+            baseline = acked;
+            baseline_offset = offset;
+        }
+    }
+    // Built in the slot the current sequence is kept in, which the baseline is never in.
+    network_snapshot* snapshot = &client->history[sequence % NETWORK_SNAPSHOT_HISTORY];
+    snapshot_reset(snapshot);
+    snapshot->sequence = sequence;
+
+    // The entities of interest, sorted by id so they can be merged with the baseline.
+    darray_clear(client->visible_ids);
+    interest_query query = {client->view_position, 0.0f, &client->visible_ids};
+    if (radius > 0.0f) {
+        f32 outer = radius * NETWORK_INTEREST_HYSTERESIS;
+        query.radius_squared = outer * outer;
+    }
+    bvh_query(&state->interest_tree, interest_test, interest_found, &query);
+    u32 visible_count = darray_length(client->visible_ids);
+    if (visible_count > 1) {
+        kquick_sort(sizeof(u32), client->visible_ids, 0, (i32)visible_count - 1, id_compare);
+    }
+
+    // Merge the two, recording the differences.
+    darray_clear(client->changes);
+    u32 baseline_count = baseline ? darray_length(baseline->records) : 0;
+    u32 v = 0;
+    u32 b = 0;
+    while (v < visible_count || b < baseline_count) {
+        u32 visible_id = v < visible_count ? client->visible_ids[v] : INVALID_ID;
+        const network_record* base = b < baseline_count ? &baseline->records[b] : 0;
+        u32 base_id = base ? base->id : INVALID_ID;
+
+        network_change change = {0};
+        if (visible_id < base_id) {
+            // Entities new to the client only come into view within the inner radius.
+            v++;
+            const network_record* current = &state->current[visible_id];
+            if (radius > 0.0f && vec3_distance(position_dequantize(session, current->position), client->view_position) > radius + state->entity_radii[visible_id]) {
+                continue;
+            }
+            change.id = visible_id;
+            change.kind = NETWORK_CHANGE_KIND_CREATE;
+            change.record_index = darray_length(snapshot->records);
+            // Not part of the snapshot unless sent.
+            network_record pending = *current;
+            pending.id = INVALID_ID;
+            darray_push(snapshot->records, pending);
+        } else if (base_id < visible_id) {
+            b++;
+            change.id = base_id;
+            change.kind = NETWORK_CHANGE_KIND_REMOVE;
+            change.record_index = darray_length(snapshot->records);
+            darray_push(snapshot->records, *base);
+        } else {
+            v++;
+            b++;
+            const network_record* current = &state->current[visible_id];
+            // Kept as the baseline has it unless the change is sent.
+            change.record_index = darray_length(snapshot->records);
+            darray_push(snapshot->records, *base);
+            change.id = visible_id;
+            if (current->generation != base->generation) {
+                change.kind = NETWORK_CHANGE_KIND_CREATE;
+            } else {
+                if (current->position[0] != base->position[0] || current->position[1] != base->position[1] || current->position[2] != base->position[2]) {
+                    change.fields |= NETWORK_FIELD_POSITION;
+                }
+                if (current->rotation != base->rotation) {
+                    change.fields |= NETWORK_FIELD_ROTATION;
+                }
+                if (current->state != base->state) {
+                    change.fields |= NETWORK_FIELD_STATE;
+                }
+                if (!change.fields) {
+                    // Unchanged entities cost nothing.
+                    continue;
+                }
+                change.kind = NETWORK_CHANGE_KIND_UPDATE;
+            }
+        }
+
+        if (change.kind == NETWORK_CHANGE_KIND_REMOVE) {
+            // Removals are small, and leave stale entities behind until sent, so they always go first.
+            change.priority = K_FLOAT_MAX;
+        } else {
+            client->priorities[change.id] += change_weight(client, change.id, radius);
+            change.priority = client->priorities[change.id];
+        }
+        change.bit_count = change_bit_count(&change, &state->current[change.id], &snapshot->records[change.record_index]);
+        darray_push(client->changes, change);
+    }
+
+    // Take the changes which fit, most important first.
+    u32 change_count = darray_length(client->changes);
+    if (change_count > 1) {
+        kquick_sort(sizeof(network_change), client->changes, 0, (i32)change_count - 1, change_priority_compare);
+    }
+    u32 budget = NETWORK_MAX_PACKET_SIZE * 8 - NETWORK_SNAPSHOT_HEADER_BITS;
+    u32 used = 0;
+    u32 sent_count = 0;
+    client->changes_deferred = 0;
+    for (u32 i = 0; i < change_count; ++i) {
+        network_change* change = &client->changes[i];
+        if (used + change->bit_count > budget) {
+            client->changes_deferred++;
+            continue;
+        }
+        used += change->bit_count;
+        // Move the change into the sent part of the array.
+        network_change taken = *change;
+        client->changes[i] = client->changes[sent_count];
+        client->changes[sent_count] = taken;
+        sent_count++;
+    }
+    if (sent_count > 1) {
+        kquick_sort(sizeof(network_change), client->changes, 0, (i32)sent_count - 1, change_id_compare);
+    }
+
+    // Encode them, bringing the snapshot up to what the client will have once it receives it.
+    kbitstream stream;
+    packet_begin(&stream, client->packet, NETWORK_MAX_PACKET_SIZE, NETWORK_PACKET_TYPE_SNAPSHOT);
+    kbitstream_write_bits(&stream, sequence, NETWORK_SEQUENCE_BITS);
+    kbitstream_write_bits(&stream, baseline_offset, NETWORK_BASELINE_OFFSET_BITS);
+    kbitstream_write_varint(&stream, sent_count, NETWORK_COUNT_GROUP_BITS);
+    u32 previous_id = INVALID_ID;
+    for (u32 i = 0; i < sent_count; ++i) {
+        network_change* change = &client->changes[i];
+        network_record* record = &snapshot->records[change->record_index];
+        const network_record* current = &state->current[change->id];
+        kbitstream_write_varint(&stream, change->id - (previous_id + 1), NETWORK_ID_GAP_GROUP_BITS);
+        previous_id = change->id;
+        kbitstream_write_bits(&stream, change->kind, NETWORK_CHANGE_KIND_BITS);
+        switch (change->kind) {
+            case NETWORK_CHANGE_KIND_CREATE:
+                position_write(&stream, session, current->position, 0);
+                kbitstream_write_bits(&stream, current->rotation, 2 + session->rotation_bits * 3);
+                kbitstream_write_varint(&stream, current->state, NETWORK_STATE_GROUP_BITS);
+                *record = *current;
+                break;
+            case NETWORK_CHANGE_KIND_UPDATE:
+                kbitstream_write_bits(&stream, change->fields, NETWORK_FIELD_BITS);
+                if (change->fields & NETWORK_FIELD_POSITION) {
+                    position_write(&stream, session, current->position, record->position);
+                }
+                if (change->fields & NETWORK_FIELD_ROTATION) {
+                    kbitstream_write_bits(&stream, current->rotation, 2 + session->rotation_bits * 3);
+                }
+                if (change->fields & NETWORK_FIELD_STATE) {
+                    kbitstream_write_varint(&stream, current->state, NETWORK_STATE_GROUP_BITS);
+                }
+                *record = *current;
+                break;
+            case NETWORK_CHANGE_KIND_REMOVE:
+                record->id = INVALID_ID;
+                break;
+        }
+        client->priorities[change->id] = 0.0f;
+    }
+    client->packet_size = stream.overflowed ? 0 : kbitstream_bytes_used(&stream);
+
+    // Drop the records of entities which are not part of the snapshot after all.
+    u32 record_count = darray_length(snapshot->records);
+    u32 kept = 0;
+    for (u32 i = 0; i < record_count; ++i) {
+        if (snapshot->records[i].id != INVALID_ID) {
+            snapshot->records[kept++] = snapshot->records[i];
+        }
+    }
+    darray_length_set(snapshot->records, kept);
+    snapshot->valid = client->packet_size != 0;
+}
+
+static void client_snapshot_build_batch(u32 start, u32 end, void* user_data) {
+    network_system_state* state = user_data;
+    for (u32 i = start; i < end; ++i) {
+        network_remote_client* client = &state->clients[i];
+        client->packet_size = 0;
+        if (client->connected) {
+            client_snapshot_build(client);
+        }
+    }
+}
+
+static void server_update(void) {
+    network_system_state* state = state_ptr;
+    for (u32 i = 0; i < state->config.max_client_count; ++i) {
+        network_remote_client* client = &state->clients[i];
+        if (client->connected && state->time - client->last_received_time > NETWORK_TIMEOUT) {
+            KINFO("Network client timed out (slot %u).", i);
+            client_drop(client);
+        }
+    }
+
+    f64 interval = 1.0 / state->server_config.snapshot_rate;
+    if (state->snapshot_accumulator < interval) {
+        return;
+    }
+    // Snapshots which have fallen behind are skipped rather than sent in a burst.
+    state->snapshot_accumulator = KMIN(state->snapshot_accumulator - interval, interval);
+    state->sequence++;
+    if (!state->stats.client_count) {
+        return;
+    }
+
+    server_capture();
+    job_parallel_for(state->config.max_client_count, 1, client_snapshot_build_batch, state);
+    for (u32 i = 0; i < state->config.max_client_count; ++i) {
+        network_remote_client* client = &state->clients[i];
+        if (client->connected && client->packet_size) {
+            if (platform_udp_socket_send(&state->socket, &client->address, client->packet, client->packet_size)) {
+                state->stats.packets_sent++;
+                state->stats.bytes_sent += client->packet_size;
+            }
+            state->stats.changes_deferred += client->changes_deferred;
+        }
+    }
+}
+
+b8 network_server_start(const network_server_config* config) {
+    if (!state_ptr || !config) {
+        return false;
+    }
+    if (state_ptr->role != NETWORK_ROLE_NONE) {
+        KERROR("network_server_start - a session is already in progress.");
+        return false;
+    }
+
+    network_server_config* server_config = &state_ptr->server_config;
+    *server_config = *config;
+    if (server_config->snapshot_rate <= 0.0f) {
+        server_config->snapshot_rate = 20.0f;
+    }
+    if (server_config->position_bits == 0) {
+        server_config->position_bits = 18;
+    }
+    if (server_config->rotation_bits == 0) {
+        server_config->rotation_bits = 10;
+    }
+    server_config->position_bits = KMIN(server_config->position_bits, 24);
+    server_config->rotation_bits = KCLAMP(server_config->rotation_bits, 2, 10);
+    extents_3d bounds = server_config->world_bounds;
+    if (bounds.max.x <= bounds.min.x || bounds.max.y <= bounds.min.y || bounds.max.z <= bounds.min.z) {
+        bounds.min = vec3_create(-1024.0f, -1024.0f, -1024.0f);
+        bounds.max = vec3_create(1024.0f, 1024.0f, 1024.0f);
+    }
+
+    if (!platform_udp_socket_open(config->port, &state_ptr->socket)) {
+        KERROR("network_server_start - unable to listen on port %hu.", config->port);
+        return false;
+    }
+    state_ptr->session.world_bounds = bounds;
+    state_ptr->session.position_bits = server_config->position_bits;
+    state_ptr->session.rotation_bits = server_config->rotation_bits;
+    state_ptr->role = NETWORK_ROLE_SERVER;
+    state_ptr->snapshot_accumulator = 0.0;
+    kzero_memory(&state_ptr->stats, sizeof(network_system_stats));
+    KINFO("Network server listening on port %hu.", config->port);
+    return true;
+}
+
+u32 network_entity_create(transform* t, f32 radius) {
+    if (!state_ptr) {
+        return INVALID_ID;
+    }
+    network_system_state* state = state_ptr;
+    u32 id;
+    u32 free_count = darray_length(state->free_ids);
+    if (free_count) {
+        id = state->free_ids[free_count - 1];
+        darray_length_set(state->free_ids, free_count - 1);
+    } else if (state->entity_high_water < state->config.max_entity_count) {
+        id = state->entity_high_water++;
+    } else {
+        KERROR("network_entity_create - the maximum of %u entities has been reached.", state->config.max_entity_count);
+        return INVALID_ID;
+    }
+
+    state->entity_alive[id] = true;
+    state->entity_generations[id]++;
+    state->entity_transforms[id] = t;
+    state->entity_positions[id] = t ? transform_position_get(t) : vec3_zero();
+    state->entity_rotations[id] = t ? transform_rotation_get(t) : quat_identity();
+    state->entity_states[id] = 0;
+    state->entity_radii[id] = KMAX(radius, 0.0f);
+    // Grown to fit when first captured.
+    state->entity_bounds[id] = (extents_3d){state->entity_positions[id], state->entity_positions[id]};
+    state->entity_leaves[id] = bvh_insert(&state->interest_tree, state->entity_bounds[id], id);
+    state->entity_count++;
+    return id;
+}
+
+void network_entity_destroy(u32 entity_id) {
+    if (!state_ptr || entity_id >= state_ptr->entity_high_water || !state_ptr->entity_alive[entity_id]) {
+        return;
+    }
+    network_system_state* state = state_ptr;
+    bvh_remove(&state->interest_tree, state->entity_leaves[entity_id]);
+    state->entity_alive[entity_id] = false;
+    state->entity_transforms[entity_id] = 0;
+    state->entity_leaves[entity_id] = INVALID_ID;
+    for (u32 i = 0; i < state->config.max_client_count; ++i) {
+        state->clients[i].priorities[entity_id] = 0.0f;
+    }
+    darray_push(state->free_ids, entity_id);
+    state->entity_count--;
+}
+
+b8 network_entity_transform_set(u32 entity_id, vec3 position, quat rotation) {
+    if (!state_ptr || entity_id >= state_ptr->entity_high_water || !state_ptr->entity_alive[entity_id]) {
+        return false;
+    }
+    state_ptr->entity_positions[entity_id] = position;
+    state_ptr->entity_rotations[entity_id] = rotation;
+    return true;
+}
+
+b8 network_entity_state_set(u32 entity_id, u32 state) {
+    if (!state_ptr || entity_id >= state_ptr->entity_high_water || !state_ptr->entity_alive[entity_id]) {
+        return false;
+    }
+    state_ptr->entity_states[entity_id] = state;
+    return true;
+}
+
+// Client.
+
+static void ack_send(void) {
+    network_system_state* state = state_ptr;
+    u8 buffer[32];
+    kbitstream stream;
+    packet_begin(&stream, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_ACK);
+    kbitstream_write_bits(&stream, state->salt, 32);
+    kbitstream_write_bool(&stream, state->has_latest);
+    kbitstream_write_bits(&stream, state->latest_sequence, NETWORK_SEQUENCE_BITS);
+    u32 view[3];
+    position_quantize(&state->session, state->view_position, view);
+    for (u32 i = 0; i < 3; ++i) {
+        kbitstream_write_bits(&stream, view[i], state->session.position_bits);
+    }
+    packet_send(&state->server_address, &stream);
+    state->last_sent_time = state->time;
+    state->ack_pending = false;
+}
+
+static void entities_refresh(const network_snapshot* snapshot) {
+    network_system_state* state = state_ptr;
+    u32 count = darray_length(snapshot->records);
+    darray_reserve_exact(state->entities, count);
+    darray_length_set(state->entities, count);
+    for (u32 i = 0; i < count; ++i) {
+        const network_record* record = &snapshot->records[i];
+        network_entity_state* entity = &state->entities[i];
+        entity->id = record->id;
+        entity->position = position_dequantize(&state->session, record->position);
+        entity->rotation = kdequantize_quat(record->rotation, state->session.rotation_bits);
+        entity->state = record->state;
+    }
+}
+
+static void snapshot_receive(kbitstream* stream) {
+    network_system_state* state = state_ptr;
+    const network_session* session = &state->session;
+    u16 sequence = (u16)kbitstream_read_bits(stream, NETWORK_SEQUENCE_BITS);
+    u32 baseline_offset = kbitstream_read_bits(stream, NETWORK_BASELINE_OFFSET_BITS);
+    if (stream->overflowed) {
+        return;
+    }
+    // Too old to keep without overwriting a newer snapshot.
+    if (state->has_latest && !sequence_greater(sequence, state->latest_sequence) &&
+        (u16)(state->latest_sequence - sequence) >= NETWORK_SNAPSHOT_HISTORY - 1) {
+        return;
+    }
+
+    const network_snapshot* baseline = 0;
+    if (baseline_offset) {
+        u16 baseline_sequence = (u16)(sequence - baseline_offset);
+        baseline = &state->received[baseline_sequence % NETWORK_SNAPSHOT_HISTORY];
+        if (!baseline->valid || baseline->sequence != baseline_sequence) {
+            // The baseline has been lost, so this can't be rebuilt. The server falls back to an older one.
+            return;
+        }
+    }
+    network_snapshot* snapshot = &state->received[sequence % NETWORK_SNAPSHOT_HISTORY];
+    if (snapshot->valid && snapshot->sequence == sequence) {
+        // A duplicate.
+        return;
+    }
+    snapshot_reset(snapshot);
+    snapshot->sequence = sequence;
+
+    // Merge the changes, which are sorted by id, into the baseline.
+    u32 baseline_count = baseline ? darray_length(baseline->records) : 0;
+    u32 b = 0;
+    u32 change_count = kbitstream_read_varint(stream, NETWORK_COUNT_GROUP_BITS);
+    u32 id = INVALID_ID;
+    for (u32 i = 0; i < change_count && !stream->overflowed; ++i) {
+        id = id + 1 + kbitstream_read_varint(stream, NETWORK_ID_GAP_GROUP_BITS);
+        network_change_kind kind = (network_change_kind)kbitstream_read_bits(stream, NETWORK_CHANGE_KIND_BITS);
+        while (b < baseline_count && baseline->records[b].id < id) {
+            darray_push(snapshot->records, baseline->records[b]);
+            b++;
+        }
+        const network_record* base = (b < baseline_count && baseline->records[b].id == id) ? &baseline->records[b] : 0;
+        if (base) {
+            b++;
+        }
+
+        network_record record = {0};
+        record.id = id;
+        if (kind == NETWORK_CHANGE_KIND_CREATE) {
+            position_read(stream, session, record.position, 0);
+            record.rotation = kbitstream_read_bits(stream, 2 + session->rotation_bits * 3);
+            record.state = kbitstream_read_varint(stream, NETWORK_STATE_GROUP_BITS);
+        } else if (kind == NETWORK_CHANGE_KIND_UPDATE) {
+            if (!base) {
+                KWARN("Network snapshot %hu updates entity %u, which is not in its baseline.", sequence, id);
+                snapshot_reset(snapshot);
+                return;
+            }
+            record = *base;
+            u32 fields = kbitstream_read_bits(stream, NETWORK_FIELD_BITS);
+            if (fields & NETWORK_FIELD_POSITION) {
+                position_read(stream, session, record.position, base->position);
+            }
+            if (fields & NETWORK_FIELD_ROTATION) {
+                record.rotation = kbitstream_read_bits(stream, 2 + session->rotation_bits * 3);
+            }
+            if (fields & NETWORK_FIELD_STATE) {
+                record.state = kbitstream_read_varint(stream, NETWORK_STATE_GROUP_BITS);
+            }
+        } else {
+            continue;
+        }
+        darray_push(snapshot->records, record);
+    }
+    if (stream->overflowed) {
+        KWARN("Network snapshot %hu was truncated.", sequence);
+        snapshot_reset(snapshot);
+        return;
+    }
+    for (; b < baseline_count; ++b) {
+        darray_push(snapshot->records, baseline->records[b]);
+    }
+    snapshot->valid = true;
+
+    if (!state->has_latest || sequence_greater(sequence, state->latest_sequence)) {
+        state->has_latest = true;
+        state->latest_sequence = sequence;
+        entities_refresh(snapshot);
+        state->ack_pending = true;
+    }
+}
+
+static void client_packet_handle(const platform_address* from, kbitstream* stream, network_packet_type type) {
+    network_system_state* state = state_ptr;
+    if (from->ip != state->server_address.ip || from->port != state->server_address.port) {
+        return;
+    }
+
+    switch (type) {
+        case NETWORK_PACKET_TYPE_CONNECT_ACCEPT: {
+            u32 salt = kbitstream_read_bits(stream, 32);
+            network_session session;
+            for (u32 i = 0; i < 3; ++i) {
+                session.world_bounds.min.elements[i] = bits_f32(kbitstream_read_bits(stream, 32));
+                session.world_bounds.max.elements[i] = bits_f32(kbitstream_read_bits(stream, 32));
+            }
+            session.position_bits = kbitstream_read_bits(stream, 5);
+            session.rotation_bits = kbitstream_read_bits(stream, 4);
+            if (stream->overflowed || salt != state->salt || state->client_status != NETWORK_CLIENT_STATUS_CONNECTING) {
+                return;
+            }
+            state->session = session;
+            state->client_status = NETWORK_CLIENT_STATUS_CONNECTED;
+            state->last_received_time = state->time;
+            KINFO("Network client connected to server.");
+            ack_send();
+        } break;
+        case NETWORK_PACKET_TYPE_CONNECT_DENIED: {
+            if (kbitstream_read_bits(stream, 32) == state->salt && state->client_status == NETWORK_CLIENT_STATUS_CONNECTING) {
+                KWARN("Network server is full; connection denied.");
+                session_end();
+            }
+        } break;
+        case NETWORK_PACKET_TYPE_SNAPSHOT: {
+            if (state->client_status == NETWORK_CLIENT_STATUS_CONNECTED) {
+                state->last_received_time = state->time;
+                snapshot_receive(stream);
+            }
+        } break;
+        case NETWORK_PACKET_TYPE_DISCONNECT: {
+            if (kbitstream_read_bits(stream, 32) == state->salt) {
+                KINFO("Network server ended the session.");
+                session_end();
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+static void connect_request_send(void) {
+    u8 buffer[16];
+    kbitstream stream;
+    packet_begin(&stream, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_CONNECT_REQUEST);
+    kbitstream_write_bits(&stream, state_ptr->salt, 32);
+    packet_send(&state_ptr->server_address, &stream);
+    state_ptr->last_sent_time = state_ptr->time;
+}
+
+static void client_update(void) {
+    network_system_state* state = state_ptr;
+    if (state->client_status == NETWORK_CLIENT_STATUS_CONNECTING) {
+        if (state->time - state->connect_start_time > NETWORK_TIMEOUT) {
+            KWARN("Network client timed out connecting to server.");
+            session_end();
+        } else if (state->time - state->last_sent_time >= NETWORK_CONNECT_RETRY_INTERVAL) {
+            connect_request_send();
+        }
+    } else if (state->client_status == NETWORK_CLIENT_STATUS_CONNECTED) {
+        if (state->time - state->last_received_time > NETWORK_TIMEOUT) {
+            KWARN("Network client lost connection to server.");
+            session_end();
+        } else if (state->ack_pending || state->time - state->last_sent_time >= NETWORK_KEEPALIVE_INTERVAL) {
+            ack_send();
+        }
+    }
+}
+
+b8 network_client_connect(const char* host, u16 port) {
+    if (!state_ptr || !host) {
+        return false;
+    }
+    if (state_ptr->role != NETWORK_ROLE_NONE) {
+        KERROR("network_client_connect - a session is already in progress.");
+        return false;
+    }
+    if (!platform_address_parse(host, port, &state_ptr->server_address)) {
+        return false;
+    }
+    if (!platform_udp_socket_open(0, &state_ptr->socket)) {
+        KERROR("network_client_connect - unable to open a socket.");
+        return false;
+    }
+
+    state_ptr->role = NETWORK_ROLE_CLIENT;
+    state_ptr->client_status = NETWORK_CLIENT_STATUS_CONNECTING;
+    // Tells this connection apart from an earlier one from the same address.
+    state_ptr->salt = ((u32)krandom() << 16) ^ (u32)krandom();
+    state_ptr->connect_start_time = state_ptr->time;
+    state_ptr->has_latest = false;
+    kzero_memory(&state_ptr->stats, sizeof(network_system_stats));
+    connect_request_send();
+    return true;
+}
+
+void network_disconnect(void) {
+    if (!state_ptr || state_ptr->role == NETWORK_ROLE_NONE) {
+        return;
+    }
+    network_system_state* state = state_ptr;
+    u8 buffer[16];
+    kbitstream stream;
+    if (state->role == NETWORK_ROLE_SERVER) {
+        for (u32 i = 0; i < state->config.max_client_count; ++i) {
+            network_remote_client* client = &state->clients[i];
+            if (client->connected) {
+                packet_begin(&stream, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_DISCONNECT);
+                kbitstream_write_bits(&stream, client->salt, 32);
+                packet_send(&client->address, &stream);
+            }
+        }
+    } else if (state->client_status != NETWORK_CLIENT_STATUS_DISCONNECTED) {
+        packet_begin(&stream, buffer, sizeof(buffer), NETWORK_PACKET_TYPE_DISCONNECT);
+        kbitstream_write_bits(&stream, state->salt, 32);
+        packet_send(&state->server_address, &stream);
+    }
+    session_end();
+}
+
+b8 network_system_update(void* state, struct frame_data* p_frame_data) {
+    network_system_state* typed_state = (network_system_state*)state;
+    if (!typed_state || typed_state->role == NETWORK_ROLE_NONE) {
+        return true;
+    }
+    typed_state->time += p_frame_data->delta_time;
+    if (typed_state->role == NETWORK_ROLE_SERVER) {
+        typed_state->snapshot_accumulator += p_frame_data->delta_time;
+    }
+
+    u8 buffer[NETWORK_MAX_PACKET_SIZE];
+    platform_address from;
+    i32 size;
+    while (typed_state->role != NETWORK_ROLE_NONE && (size = platform_udp_socket_receive(&typed_state->socket, &from, buffer, sizeof(buffer))) > 0) {
+        typed_state->stats.packets_received++;
+        typed_state->stats.bytes_received += (u64)size;
+
+        kbitstream stream;
+        kbitstream_create(buffer, (u32)size, &stream);
+        if (kbitstream_read_bits(&stream, 32) != NETWORK_PROTOCOL_ID) {
+            continue;
+        }
+        network_packet_type type = (network_packet_type)kbitstream_read_bits(&stream, NETWORK_PACKET_TYPE_BITS);
+        if (typed_state->role == NETWORK_ROLE_SERVER) {
+            server_packet_handle(&from, &stream, type);
+        } else {
+            client_packet_handle(&from, &stream, type);
+        }
+    }
+
+    if (typed_state->role == NETWORK_ROLE_SERVER) {
+        server_update();
+    } else if (typed_state->role == NETWORK_ROLE_CLIENT) {
+        client_update();
+    }
+    return true;
+}
+
+network_role network_role_get(void) {
+    return state_ptr ? state_ptr->role : NETWORK_ROLE_NONE;
+}
+
+network_client_status network_client_status_get(void) {
+    return state_ptr ? state_ptr->client_status : NETWORK_CLIENT_STATUS_DISCONNECTED;
+}
+
+void network_client_view_set(vec3 position) {
+    if (state_ptr) {
+        state_ptr->view_position = position;
+    }
+}
+
+const network_entity_state* network_client_entities_get(u32* out_count) {
+    if (!state_ptr) {
+        *out_count = 0;
+        return 0;
+    }
+    *out_count = darray_length(state_ptr->entities);
+    return state_ptr->entities;
+}
+
+b8 network_client_entity_get(u32 entity_id, network_entity_state* out_state) {
+    if (!state_ptr || !out_state) {
+        return false;
+    }
+    u32 low = 0;
+    u32 high = darray_length(state_ptr->entities);
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        u32 id = state_ptr->entities[mid].id;
+        if (id == entity_id) {
+            *out_state = state_ptr->entities[mid];
+            return true;
+        }
+        if (id < entity_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+void network_system_stats_get(network_system_stats* out_stats) {
+    if (state_ptr && out_stats) {
+        *out_stats = state_ptr->stats;
+    }
+}
@@ -0,0 +1,232 @@
+/**
+ * @file network_system.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief The network system, which replicates the state of entities from a server to its
+ * clients over UDP as a stream of snapshots.
+ * @details At a fixed rate, the server captures the position, rotation and state of each
+ * replicated entity, quantized to the precision it is sent at. Each client is sent the entities
+ * within its area of interest, found from a bounding volume hierarchy of the entities, encoded
+ * as the difference from the last snapshot it acknowledged, so entities which have not changed
+ * cost nothing. Changes are bit-packed, and sent in order of a priority which accumulates while
+ * they wait, within the size of a single packet. Snapshots for each client are encoded on the
+ * job threads. Clients rebuild each snapshot from their copy of its baseline, and acknowledge
+ * the latest along with their view position.
+ * @version 1.0
+ * @date 2023-12-12
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct frame_data;
+
+/** @brief The largest packet sent, in bytes, which is within the MTU of nearly any path. */
+#define NETWORK_MAX_PACKET_SIZE 1200
+/** @brief The number of snapshots kept by each end, and so the furthest back a baseline can be. */
+#define NETWORK_SNAPSHOT_HISTORY 32
+/** @brief The time in seconds without hearing from the other end after which a connection is dropped. */
+#define NETWORK_TIMEOUT 5.0
+
+/** @brief The role of this end of a session. */
+typedef enum network_role {
+    NETWORK_ROLE_NONE,
+    NETWORK_ROLE_SERVER,
+    NETWORK_ROLE_CLIENT
+} network_role;
+
+/** @brief The status of a client's connection to a server. */
+typedef enum network_client_status {
+    NETWORK_CLIENT_STATUS_DISCONNECTED,
+    NETWORK_CLIENT_STATUS_CONNECTING,
+    NETWORK_CLIENT_STATUS_CONNECTED
+} network_client_status;
+
+/** @brief The configuration of the network system. */
+typedef struct network_system_config {
+    /** @brief The most entities which may be replicated at once. */
+    u32 max_entity_count;
+    /** @brief The most clients a server may have connected at once. */
+    u32 max_client_count;
+} network_system_config;
+
+/** @brief The configuration of a server. */
+typedef struct network_server_config {
+    /** @brief The port to listen on. */
+    u16 port;
+    /** @brief The number of snapshots sent to each client a second. 0 defaults to 20. */
+    f32 snapshot_rate;
+    /** @brief The distance from each client's view within which entities are sent to it. 0 sends every entity. */
+    f32 interest_radius;
+    /** @brief The bounds of the positions of entities, which are clamped to them. Zero defaults to +/-1024 on each axis. */
+    extents_3d world_bounds;
+    /** @brief The number of bits each axis of a position is quantized to, up to 24. 0 defaults to 18. */
+    u32 position_bits;
+    /** @brief The number of bits each of the three smallest components of a rotation is quantized to, up to 10. 0 defaults to 10. */
+    u32 rotation_bits;
+} network_server_config;
+
+/** @brief The state of a replicated entity, as received by a client. */
+typedef struct network_entity_state {
+    /** @brief The id of the entity, as given to it by the server. */
+    u32 id;
+    /** @brief The position. */
+    vec3 position;
+    /** @brief The rotation. */
+    quat rotation;
+    /** @brief The application-defined state of the entity's components. */
+    u32 state;
+} network_entity_state;
+
+/** @brief Statistics of the network system since the session began. */
+typedef struct network_system_stats {
+    /** @brief The number of clients connected to a server. */
+    u32 client_count;
+    /** @brief The number of packets sent. */
+    u64 packets_sent;
+    /** @brief The number of packets received. */
+    u64 packets_received;
+    /** @brief The number of bytes sent. */
+    u64 bytes_sent;
+    /** @brief The number of bytes received. */
+    u64 bytes_received;
+    /** @brief The number of entity changes left for a later snapshot as they did not fit. */
+    u64 changes_deferred;
+} network_system_stats;
+
+/**
+ * @brief Initializes the network system.
+ * Should be called twice; once to get the memory requirement (passing state=0), and a second
+ * time passing an allocated block of memory to actually initialize the system.
+ *
+ * @param memory_requirement A pointer to hold the memory requirement as it is calculated.
+ * @param state A block of memory to hold the state or, if gathering the memory requirement, 0.
+ * @param config The configuration (network_system_config) for this system.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 network_system_initialize(u64* memory_requirement, void* state, void* config);
+
+/**
+ * @brief Shuts down the network system, ending any session.
+ *
+ * @param state The state block of memory.
+ */
+KAPI void network_system_shutdown(void* state);
+
+/**
+ * @brief Receives and handles waiting packets, and sends snapshots or acknowledgements as
+ * they fall due. Should happen once an update cycle.
+ */
+KAPI b8 network_system_update(void* state, struct frame_data* p_frame_data);
+
+/**
+ * @brief Starts a server, which clients can then connect to.
+ *
+ * @param config A constant pointer to the configuration of the server.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 network_server_start(const network_server_config* config);
+
+/**
+ * @brief Starts connecting to the server at the given address. The connection is made, or
+ * fails, over the following updates; see network_client_status_get.
+ *
+ * @param host The host name or address of the server.
+ * @param port The port the server listens on.
+ * @return True if connecting started; otherwise false.
+ */
+KAPI b8 network_client_connect(const char* host, u16 port);
+
+/**
+ * @brief Ends the session, whether a server or a client, letting the other end know.
+ */
+KAPI void network_disconnect(void);
+
+/**
+ * @brief Obtains the role of this end of the session.
+ *
+ * @return The role, or NETWORK_ROLE_NONE if there is no session.
+ */
+KAPI network_role network_role_get(void);
+
+/**
+ * @brief Creates a replicated entity on the server. Its position and rotation are taken from
+ * the given transform when each snapshot is captured, or set with network_entity_transform_set
+ * if there is none. The transform's own position and rotation are used, so it should not have
+ * a parent.
+ *
+ * @param t A pointer to the transform to replicate. Must outlive the entity. Optional.
+ * @param radius The radius of the entity, used to find the clients it is of interest to.
+ * @return The id of the entity, or INVALID_ID if it could not be created.
+ */
+KAPI u32 network_entity_create(transform* t, f32 radius);
+
+/**
+ * @brief Destroys the replicated entity with the given id, removing it from clients.
+ *
+ * @param entity_id The id of the entity.
+ */
+KAPI void network_entity_destroy(u32 entity_id);
+
+/**
+ * @brief Sets the position and rotation of an entity created without a transform.
+ *
+ * @param entity_id The id of the entity.
+ * @param position The position.
+ * @param rotation The rotation.
+ * @return True if the entity exists; otherwise false.
+ */
+KAPI b8 network_entity_transform_set(u32 entity_id, vec3 position, quat rotation);
+
+/**
+ * @brief Sets the application-defined state of the entity's components, such as flags or
+ * the index of an animation, which is sent along with its transform.
+ *
+ * @param entity_id The id of the entity.
+ * @param state The state. Small values take fewer bits to send.
+ * @return True if the entity exists; otherwise false.
+ */
+KAPI b8 network_entity_state_set(u32 entity_id, u32 state);
+
+/**
+ * @brief Obtains the status of this client's connection.
+ *
+ * @return The status.
+ */
+KAPI network_client_status network_client_status_get(void);
+
+/**
+ * @brief Sets the position the client views the world from, sent to the server so it can pick
+ * the entities of interest.
+ *
+ * @param position The position.
+ */
+KAPI void network_client_view_set(vec3 position);
+
+/**
+ * @brief Obtains the entities of the latest snapshot received by this client.
+ *
+ * @param out_count A pointer to hold the number of entities.
+ * @return An array of the entities, sorted by id, valid until the next update.
+ */
+KAPI const network_entity_state* network_client_entities_get(u32* out_count);
+
+/**
+ * @brief Obtains the state of an entity in the latest snapshot received by this client.
+ *
+ * @param entity_id The id of the entity.
+ * @param out_state A pointer to hold the state.
+ * @return True if the entity is in the snapshot; otherwise false.
+ */
+KAPI b8 network_client_entity_get(u32 entity_id, network_entity_state* out_state);
+
+/**
+ * @brief Obtains the statistics of the current session.
+ *
+ * @param out_stats A pointer to hold the statistics.
+ */
+KAPI void network_system_stats_get(network_system_stats* out_stats);
@@ -0,0 +1,1620 @@
+#include "physics_system.h"
+
+#include "containers/darray.h"
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "core/systems_manager.h"
+#include "math/kmath.h"
+#include "math/transform.h"
+#include "resources/terrain.h"
+#include "systems/job_system.h"
+#include "utils/ksort.h"
+
+#define PHYSICS_BODY_FLAG_ALIVE 0x1
+#define PHYSICS_BODY_FLAG_AWAKE 0x2
+
+// The most contact points kept between a pair of colliders.
+#define PHYSICS_MANIFOLD_MAX_CONTACTS 4
+// The number of sorted bodies each batch of the sweep covers.
+#define PHYSICS_SWEEP_BATCH_SIZE 256
+
+// How far bounds are grown beyond their colliders, so contacts about to happen are found.
+#define PHYSICS_BOUNDS_MARGIN 0.05f
+// Contact points separated by up to this distance are kept, so resting contacts don't flicker.
+#define PHYSICS_CONTACT_MARGIN 0.02f
+// The penetration allowed before it is pushed out, which keeps resting contacts from jittering.
+#define PHYSICS_PENETRATION_SLOP 0.01f
+// The fraction of the remaining penetration pushed out each step.
+#define PHYSICS_BAUMGARTE 0.2f
+// Approach speeds below this do not bounce.
+#define PHYSICS_RESTITUTION_THRESHOLD 1.0f
+
+// Contacts within this distance of one from the previous step start from its impulses.
+#define PHYSICS_WARM_START_DISTANCE 0.05f
+
+// Bodies moving slower than these, for PHYSICS_TIME_TO_SLEEP seconds, may be put to sleep.
+#define PHYSICS_SLEEP_LINEAR_VELOCITY 0.05f
+#define PHYSICS_SLEEP_ANGULAR_VELOCITY 0.05f
+#define PHYSICS_TIME_TO_SLEEP 0.5f
+
+// The fractions of velocity lost each second.
+#define PHYSICS_LINEAR_DAMPING 0.01f
+#define PHYSICS_ANGULAR_DAMPING 0.05f
+
+typedef struct physics_pair {
+    u32 a;
+    u32 b;
+} physics_pair;
+
+typedef struct physics_contact {
+    // The point in the world midway between the surfaces.
+    vec3 position;
+    // How far the surfaces overlap. Negative while separated.
+    f32 depth;
+
+    // Solver data, set up each step from the above.
+    vec3 r_a;
+    vec3 r_b;
+    f32 normal_mass;
+    f32 tangent_mass[2];
+    f32 velocity_bias;
+    f32 normal_impulse;
+    f32 tangent_impulse[2];
+} physics_contact;
+
+// The contact points between two colliders, which share a normal.
+typedef struct physics_manifold {
+    // Identifies the pair of colliders from one step to the next.
+    u64 key;
+    u32 a;
+    // INVALID_ID for heightfields, which are static.
+    u32 b;
+    // The contact normal, pointing from a to b.
+    vec3 normal;
+    vec3 tangents[2];
+    f32 friction;
+    f32 restitution;
+    u32 contact_count;
+    physics_contact contacts[PHYSICS_MANIFOLD_MAX_CONTACTS];
+} physics_manifold;
+
+typedef struct physics_heightfield {
+    b8 alive;
+    // The number of vertices along each axis.
+    u32 vertex_count_x;
+    u32 vertex_count_z;
+    f32 tile_scale_x;
+    f32 tile_scale_z;
+    // The position of the first vertex.
+    vec3 origin;
+    // The height of each vertex, relative to the origin, in row-major order.
+    f32* heights;
+    extents_3d bounds;
+} physics_heightfield;
+
+// A group of bodies in contact with one another, solved independently of every other island.
+typedef struct physics_island {
+    u32 first_body;
+    u32 body_count;
+    u32 first_manifold;
+    u32 manifold_count;
+    // Set when the island comes to rest and is put to sleep.
+    b8 slept;
+} physics_island;
+
+// A collider placed in the world.
+typedef struct physics_collider {
+    physics_shape_type shape;
+    vec3 center;
+    vec3 axes[3];
+    // The half-extents of a box, or the radius of a sphere in x.
+    vec3 extents;
+} physics_collider;
+
+typedef struct physics_system_state {
+    physics_system_config config;
+    f32 accumulator;
+
+    // Bodies, as structures of arrays of max_body_count entries indexed by id.
+    u32 body_count;
+    // One past the highest id in use.
+    u32 body_id_end;
+    u8* flags;
+    physics_shape_type* shapes;
+    vec3* positions;
+    quat* rotations;
+    vec3* linear_velocities;
+    vec3* angular_velocities;
+    f32* inverse_masses;
+    // The inverse of the inertia along each local axis.
+    vec3* inverse_inertias;
+    vec3* extents;
+    f32* frictions;
+    f32* restitutions;
+    f32* sleep_timers;
+    void** user_datas;
+    extents_3d* bounds;
+    // darray of the ids freed for reuse.
+    u32* free_ids;
+
+    // darray of every body id, kept sorted by the minimum x of their bounds.
+    u32* sorted_ids;
+    // darray of the bounds of the sorted bodies, in the same order, for the sweep to read linearly.
+    extents_3d* sorted_bounds;
+    // darray of the number of pairs found by each batch of the sweep, then the offset each writes at.
+    u32* sweep_counts;
+    // darray of the pairs whose bounds overlap, with at least one awake.
+    physics_pair* pairs;
+
+    // darray of the dynamic bodies awake this step.
+    u32* awake_ids;
+    // darray of the manifold of each pair, followed by those of each awake body with each heightfield.
+    physics_manifold* manifolds;
+    // darray of the manifolds of the previous step, and of the keys of those with contacts, sorted,
+    // along with their indices. Contacts found again start from the impulses they ended with.
+    physics_manifold* previous_manifolds;
+    u64* previous_keys;
+    u32* previous_indices;
+    u64* scratch_keys;
+    u32* scratch_indices;
+
+    // The union-find parent of each body, and the island of each root. max_body_count entries.
+    u32* island_parents;
+    u32* island_indices;
+    // darrays of the islands, and of their bodies and manifolds, grouped by island.
+    physics_island* islands;
+    u32* island_bodies;
+    u32* island_manifolds;
+
+    // darray of heightfields, indexed by id.
+    physics_heightfield* heightfields;
+
+    physics_system_stats stats;
+} physics_system_state;
+
+static physics_system_state* state_ptr = 0;
+
+static void physics_step(physics_system_state* state, f32 dt);
+
+// Assigns the next piece of the block after the state, keeping each aligned.
+static void* physics_block_take(u8** cursor, u64 size) {
+    void* block = *cursor;
+    *cursor += (size + 15) & ~(u64)15;
+    return block;
+}
+
+static u64 physics_block_size(u32 max_body_count, u8* memory, physics_system_state* out_state) {
+    u8* cursor = memory + ((sizeof(physics_system_state) + 15) & ~(u64)15);
+    u8** c = &cursor;
+    u64 n = max_body_count;
+    void* blocks[] = {
+        physics_block_take(c, sizeof(u8) * n),
+        physics_block_take(c, sizeof(physics_shape_type) * n),
+        physics_block_take(c, sizeof(vec3) * n),
+        physics_block_take(c, sizeof(quat) * n),
+        physics_block_take(c, sizeof(vec3) * n),
+        physics_block_take(c, sizeof(vec3) * n),
+        physics_block_take(c, sizeof(f32) * n),
+        physics_block_take(c, sizeof(vec3) * n),
+        physics_block_take(c, sizeof(vec3) * n),
+        physics_block_take(c, sizeof(f32) * n),
+        physics_block_take(c, sizeof(f32) * n),
+        physics_block_take(c, sizeof(f32) * n),
+        physics_block_take(c, sizeof(void*) * n),
+        physics_block_take(c, sizeof(extents_3d) * n),
+        physics_block_take(c, sizeof(u32) * n),
+        physics_block_take(c, sizeof(u32) * n),
+    };
+    if (out_state) {
+        out_state->flags = blocks[0];
+        out_state->shapes = blocks[1];
+        out_state->positions = blocks[2];
+        out_state->rotations = blocks[3];
+        out_state->linear_velocities = blocks[4];
+        out_state->angular_velocities = blocks[5];
+        out_state->inverse_masses = blocks[6];
+        out_state->inverse_inertias = blocks[7];
+        out_state->extents = blocks[8];
+        out_state->frictions = blocks[9];
+        out_state->restitutions = blocks[10];
+        out_state->sleep_timers = blocks[11];
+        out_state->user_datas = blocks[12];
+        out_state->bounds = blocks[13];
+        out_state->island_parents = blocks[14];
+        out_state->island_indices = blocks[15];
+    }
+    return (u64)(cursor - memory);
+}
+
+b8 physics_system_initialize(u64* memory_requirement, void* state, void* config) {
+    if (!memory_requirement || !config) {
+        KERROR("Physics system initialization requires valid pointers to memory_requirement and config.");
+        return false;
+    }
+    physics_system_config* typed_config = (physics_system_config*)config;
+    if (typed_config->max_body_count == 0) {
+        KERROR("physics_system_initialize - config.max_body_count must be > 0.");
+        return false;
+    }
+
+    // The block is laid out the same way whatever its address, so the size can be found from 0.
+    *memory_requirement = physics_block_size(typed_config->max_body_count, 0, 0);
+    if (!state) {
+        return true;
+    }
+
+    kzero_memory(state, *memory_requirement);
+    physics_system_state* typed_state = (physics_system_state*)state;
+    typed_state->config = *typed_config;
+    if (typed_state->config.fixed_step <= 0.0f) {
+        typed_state->config.fixed_step = 1.0f / 60.0f;
+    }
+    if (typed_state->config.max_steps == 0) {
+        typed_state->config.max_steps = 4;
+    }
+    if (typed_state->config.solver_iterations == 0) {
+        typed_state->config.solver_iterations = 8;
+    }
+    physics_block_size(typed_config->max_body_count, state, typed_state);
+
+    typed_state->free_ids = darray_create(u32);
+    typed_state->sorted_ids = darray_create(u32);
+    typed_state->sorted_bounds = darray_create(extents_3d);
+    typed_state->sweep_counts = darray_create(u32);
+    typed_state->pairs = darray_create(physics_pair);
+    typed_state->awake_ids = darray_create(u32);
+    typed_state->manifolds = darray_create(physics_manifold);
+    typed_state->previous_manifolds = darray_create(physics_manifold);
+    typed_state->previous_keys = darray_create(u64);
+    typed_state->previous_indices = darray_create(u32);
+    typed_state->scratch_keys = darray_create(u64);
+    typed_state->scratch_indices = darray_create(u32);
+    typed_state->islands = darray_create(physics_island);
+    typed_state->island_bodies = darray_create(u32);
+    typed_state->island_manifolds = darray_create(u32);
+    typed_state->heightfields = darray_create(physics_heightfield);
+
+    state_ptr = typed_state;
+    return true;
+}
+
+void physics_system_shutdown(void* state) {
+    if (state) {
+        physics_system_state* typed_state = (physics_system_state*)state;
+        u32 heightfield_count = darray_length(typed_state->heightfields);
+        for (u32 i = 0; i < heightfield_count; ++i) {
+            physics_heightfield_destroy(i);
+        }
+        darray_destroy(typed_state->heightfields);
+        darray_destroy(typed_state->island_manifolds);
+        darray_destroy(typed_state->island_bodies);
+        darray_destroy(typed_state->islands);
+        darray_destroy(typed_state->scratch_indices);
+        darray_destroy(typed_state->scratch_keys);
+        darray_destroy(typed_state->previous_indices);
+        darray_destroy(typed_state->previous_keys);
+        darray_destroy(typed_state->previous_manifolds);
+        darray_destroy(typed_state->manifolds);
+        darray_destroy(typed_state->awake_ids);
+        darray_destroy(typed_state->pairs);
+        darray_destroy(typed_state->sweep_counts);
+        darray_destroy(typed_state->sorted_bounds);
+        darray_destroy(typed_state->sorted_ids);
+        darray_destroy(typed_state->free_ids);
+        kzero_memory(typed_state, sizeof(physics_system_state));
+    }
+    state_ptr = 0;
+}
+
+b8 physics_system_update(void* state, struct frame_data* p_frame_data) {
+    physics_system_state* typed_state = (physics_system_state*)state;
+    if (!typed_state || !typed_state->body_count) {
+        return true;
+    }
+
+    typed_state->accumulator += p_frame_data->delta_time;
+    u32 steps = 0;
+    while (typed_state->accumulator >= typed_state->config.fixed_step) {
+        if (steps == typed_state->config.max_steps) {
+            // Falling behind. Drop the time rather than spiralling further behind.
+            typed_state->accumulator = 0.0f;
+            break;
+        }
+        physics_step(typed_state, typed_state->config.fixed_step);
+        typed_state->accumulator -= typed_state->config.fixed_step;
+        steps++;
+    }
+
+    return true;
+}
+
+static b8 body_valid(const physics_system_state* state, u32 body_id) {
+    return state && body_id < state->body_id_end && (state->flags[body_id] & PHYSICS_BODY_FLAG_ALIVE);
+}
+
+static b8 body_dynamic(const physics_system_state* state, u32 body_id) {
+    return body_id != INVALID_ID && state->inverse_masses[body_id] > 0.0f;
+}
+
+static b8 body_awake(const physics_system_state* state, u32 body_id) {
+    return body_id != INVALID_ID && (state->flags[body_id] & PHYSICS_BODY_FLAG_AWAKE);
+}
+
+static void body_wake(physics_system_state* state, u32 body_id) {
+    if (body_dynamic(state, body_id)) {
+        state->flags[body_id] |= PHYSICS_BODY_FLAG_AWAKE;
+        state->sleep_timers[body_id] = 0.0f;
+    }
+}
+
+static void collider_get(const physics_system_state* state, u32 body_id, physics_collider* out_collider) {
+    out_collider->shape = state->shapes[body_id];
+    out_collider->center = state->positions[body_id];
+    out_collider->extents = state->extents[body_id];
+    quat q = state->rotations[body_id];
+    out_collider->axes[0] = vec3_rotate((vec3){1.0f, 0.0f, 0.0f}, q);
+    out_collider->axes[1] = vec3_rotate((vec3){0.0f, 1.0f, 0.0f}, q);
+    out_collider->axes[2] = vec3_rotate((vec3){0.0f, 0.0f, 1.0f}, q);
+}
+
+static void body_bounds_update(physics_system_state* state, u32 body_id) {
+    vec3 half;
+    if (state->shapes[body_id] == PHYSICS_SHAPE_TYPE_SPHERE) {
+        f32 r = state->extents[body_id].x;
+        half = (vec3){r, r, r};
+    } else {
+        physics_collider c;
+        collider_get(state, body_id, &c);
+        for (u32 i = 0; i < 3; ++i) {
+            half.elements[i] = kabs(c.axes[0].elements[i]) * c.extents.x + kabs(c.axes[1].elements[i]) * c.extents.y + kabs(c.axes[2].elements[i]) * c.extents.z;
+        }
+    }
+    half = vec3_add(half, (vec3){PHYSICS_BOUNDS_MARGIN, PHYSICS_BOUNDS_MARGIN, PHYSICS_BOUNDS_MARGIN});
+    state->bounds[body_id].min = vec3_sub(state->positions[body_id], half);
+    state->bounds[body_id].max = vec3_add(state->positions[body_id], half);
+}
+
+static b8 bounds_overlap(const extents_3d* a, const extents_3d* b) {
+    return a->min.x <= b->max.x && a->max.x >= b->min.x &&
+           a->min.y <= b->max.y && a->max.y >= b->min.y &&
+           a->min.z <= b->max.z && a->max.z >= b->min.z;
+}
+
+// Wakes every dynamic body whose bounds overlap the given ones.
+static void bodies_wake_in_bounds(physics_system_state* state, const extents_3d* bounds) {
+    for (u32 i = 0; i < state->body_id_end; ++i) {
+        if ((state->flags[i] & PHYSICS_BODY_FLAG_ALIVE) && bounds_overlap(bounds, &state->bounds[i])) {
+            body_wake(state, i);
+        }
+    }
+}
+
+// Applies the inverse inertia of the given body, in world space, to a vector.
+static vec3 inverse_inertia_apply(const physics_system_state* state, u32 body_id, vec3 v) {
+    if (!body_dynamic(state, body_id)) {
+        return vec3_zero();
+    }
+    quat q = state->rotations[body_id];
+    vec3 local = vec3_rotate(v, quat_conjugate(q));
+    local = vec3_mul(local, state->inverse_inertias[body_id]);
+    return vec3_rotate(local, q);
+}
+
+u32 physics_body_create(const physics_body_config* config) {
+    physics_system_state* state = state_ptr;
+    if (!state || !config) {
+        KERROR("physics_body_create requires a valid config and the physics system to be initialized.");
+        return INVALID_ID;
+    }
+    if (config->shape == PHYSICS_SHAPE_TYPE_SPHERE ? config->radius <= 0.0f : (config->half_extents.x <= 0.0f || config->half_extents.y <= 0.0f || config->half_extents.z <= 0.0f)) {
+        KERROR("physics_body_create - the collider of a body must have a positive size.");
+        return INVALID_ID;
+    }
+
+    u32 id;
+    u32 free_count = darray_length(state->free_ids);
+    if (free_count) {
+        id = state->free_ids[free_count - 1];
+        darray_length_set(state->free_ids, free_count - 1);
+    } else if (state->body_id_end < state->config.max_body_count) {
+        id = state->body_id_end++;
+    } else {
+        KERROR("physics_body_create - the most bodies allowed (%u) already exist.", state->config.max_body_count);
+        return INVALID_ID;
+    }
+
+    state->shapes[id] = config->shape;
+    state->positions[id] = config->position;
+    state->rotations[id] = quat_normalize(config->rotation);
+    if (quat_normal(config->rotation) < K_FLOAT_EPSILON) {
+        state->rotations[id] = quat_identity();
+    }
+    state->frictions[id] = KMAX(config->friction, 0.0f);
+    state->restitutions[id] = KCLAMP(config->restitution, 0.0f, 1.0f);
+    state->sleep_timers[id] = 0.0f;
+    state->user_datas[id] = config->user_data;
+
+    vec3 inertia;
+    if (config->shape == PHYSICS_SHAPE_TYPE_SPHERE) {
+        state->extents[id] = (vec3){config->radius, config->radius, config->radius};
+        f32 i = 0.4f * config->mass * config->radius * config->radius;
+        inertia = (vec3){i, i, i};
+    } else {
+        vec3 e = config->half_extents;
+        state->extents[id] = e;
+        f32 m = config->mass / 3.0f;
+        inertia = (vec3){m * (e.y * e.y + e.z * e.z), m * (e.x * e.x + e.z * e.z), m * (e.x * e.x + e.y * e.y)};
+    }
+
+    state->flags[id] = PHYSICS_BODY_FLAG_ALIVE;
+    if (config->mass > 0.0f) {
+        state->inverse_masses[id] = 1.0f / config->mass;
+        state->inverse_inertias[id] = (vec3){1.0f / inertia.x, 1.0f / inertia.y, 1.0f / inertia.z};
+        state->linear_velocities[id] = config->linear_velocity;
+        state->angular_velocities[id] = config->angular_velocity;
+        state->flags[id] |= PHYSICS_BODY_FLAG_AWAKE;
+    } else {
+        state->inverse_masses[id] = 0.0f;
+        state->inverse_inertias[id] = vec3_zero();
+        state->linear_velocities[id] = vec3_zero();
+        state->angular_velocities[id] = vec3_zero();
+    }
+    body_bounds_update(state, id);
+
+    // Inserted at the end, then sorted into place at the next step.
+    darray_push(state->sorted_ids, id);
+    state->body_count++;
+    return id;
+}
+
+void physics_body_destroy(u32 body_id) {
+    physics_system_state* state = state_ptr;
+    if (!body_valid(state, body_id)) {
+        return;
+    }
+
+    u32 sorted_count = darray_length(state->sorted_ids);
+    for (u32 i = 0; i < sorted_count; ++i) {
+        if (state->sorted_ids[i] == body_id) {
+            u32 removed;
+            darray_pop_at(state->sorted_ids, i, &removed);
+            break;
+        }
+    }
+
+    state->flags[body_id] = 0;
+    // Whatever was resting on it must fall.
+    bodies_wake_in_bounds(state, &state->bounds[body_id]);
+    state->user_datas[body_id] = 0;
+    darray_push(state->free_ids, body_id);
+    state->body_count--;
+}
+
+b8 physics_body_transform_get(u32 body_id, vec3* out_position, quat* out_rotation) {
+    physics_system_state* state = state_ptr;
+    if (!body_valid(state, body_id)) {
+        return false;
+    }
+    if (out_position) {
+        *out_position = state->positions[body_id];
+    }
+    if (out_rotation) {
+        *out_rotation = state->rotations[body_id];
+    }
+    return true;
+}
+
+b8 physics_body_transform_set(u32 body_id, vec3 position, quat rotation) {
+    physics_system_state* state = state_ptr;
+    if (!body_valid(state, body_id)) {
+        return false;
+    }
+    // Both where it was and where it is now may leave bodies unsupported or overlapped.
+    bodies_wake_in_bounds(state, &state->bounds[body_id]);
+    state->positions[body_id] = position;
+    state->rotations[body_id] = quat_normalize(rotation);
+    body_bounds_update(state, body_id);
+    bodies_wake_in_bounds(state, &state->bounds[body_id]);
+    return true;
+}
+
+b8 physics_body_velocity_set(u32 body_id, vec3 linear_velocity, vec3 angular_velocity) {
+    physics_system_state* state = state_ptr;
+    if (!body_valid(state, body_id) || !body_dynamic(state, body_id)) {
+        return false;
+    }
+    state->linear_velocities[body_id] = linear_velocity;
+    state->angular_velocities[body_id] = angular_velocity;
+    body_wake(state, body_id);
+    return true;
+}
+
+b8 physics_body_impulse_apply(u32 body_id, vec3 impulse, vec3 world_point) {
+    physics_system_state* state = state_ptr;
+    if (!body_valid(state, body_id) || !body_dynamic(state, body_id)) {
+        return false;
+    }
+    vec3 r = vec3_sub(world_point, state->positions[body_id]);
+    state->linear_velocities[body_id] = vec3_add(state->linear_velocities[body_id], vec3_mul_scalar(impulse, state->inverse_masses[body_id]));
+    state->angular_velocities[body_id] = vec3_add(state->angular_velocities[body_id], inverse_inertia_apply(state, body_id, vec3_cross(r, impulse)));
+    body_wake(state, body_id);
+    return true;
+}
+
+b8 physics_body_is_awake(u32 body_id) {
+    physics_system_state* state = state_ptr;
+    return body_valid(state, body_id) && body_awake(state, body_id);
+}
+
+void physics_body_wake(u32 body_id) {
+    physics_system_state* state = state_ptr;
+    if (body_valid(state, body_id)) {
+        body_wake(state, body_id);
+    }
+}
+
+void* physics_body_user_data_get(u32 body_id) {
+    physics_system_state* state = state_ptr;
+    return body_valid(state, body_id) ? state->user_datas[body_id] : 0;
+}
+
+u32 physics_heightfield_create_from_terrain(const struct terrain* t) {
+    physics_system_state* state = state_ptr;
+    if (!state || !t || !t->vertex_datas || t->tile_count_x < 2 || t->tile_count_z < 2) {
+        KERROR("physics_heightfield_create_from_terrain requires an initialized terrain and the physics system to be initialized.");
+        return INVALID_ID;
+    }
+
+    physics_heightfield h = {0};
+    h.alive = true;
+    h.vertex_count_x = t->tile_count_x;
+    h.vertex_count_z = t->tile_count_z;
+    h.tile_scale_x = t->tile_scale_x;
+    h.tile_scale_z = t->tile_scale_z;
+    h.origin = transform_position_get(&t->xform);
+    u32 count = h.vertex_count_x * h.vertex_count_z;
+    h.heights = kallocate(sizeof(f32) * count, MEMORY_TAG_PHYSICS);
+    f32 min_height = t->vertex_datas[0].height * t->scale_y;
+    f32 max_height = min_height;
+    for (u32 i = 0; i < count; ++i) {
+        // The same heights the terrain is drawn with. Vertex-pulled terrains only keep these.
+        h.heights[i] = t->vertex_datas[i].height * t->scale_y;
+        min_height = KMIN(min_height, h.heights[i]);
+        max_height = KMAX(max_height, h.heights[i]);
+    }
+    h.bounds.min = vec3_add(h.origin, (vec3){0.0f, min_height, 0.0f});
+    h.bounds.max = vec3_add(h.origin, (vec3){(h.vertex_count_x - 1) * h.tile_scale_x, max_height, (h.vertex_count_z - 1) * h.tile_scale_z});
+
+    u32 heightfield_count = darray_length(state->heightfields);
+    for (u32 i = 0; i < heightfield_count; ++i) {
+        if (!state->heightfields[i].alive) {
+            state->heightfields[i] = h;
+            return i;
+        }
+    }
+    darray_push(state->heightfields, h);
+    return heightfield_count;
+}
+
+void physics_heightfield_destroy(u32 heightfield_id) {
+    physics_system_state* state = state_ptr;
+    if (!state || heightfield_id >= darray_length(state->heightfields) || !state->heightfields[heightfield_id].alive) {
+        return;
+    }
+    physics_heightfield* h = &state->heightfields[heightfield_id];
+    bodies_wake_in_bounds(state, &h->bounds);
+    kfree(h->heights, sizeof(f32) * h->vertex_count_x * h->vertex_count_z, MEMORY_TAG_PHYSICS);
+    kzero_memory(h, sizeof(physics_heightfield));
+}
+
+void physics_system_stats_get(physics_system_stats* out_stats) {
+    if (out_stats) {
+        if (state_ptr) {
+            *out_stats = state_ptr->stats;
+            out_stats->body_count = state_ptr->body_count;
+        } else {
+            kzero_memory(out_stats, sizeof(physics_system_stats));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Narrowphase
+// ---------------------------------------------------------------------------------------------
+
+typedef struct contact_candidate {
+    vec3 position;
+    f32 depth;
+} contact_candidate;
+
+// Keeps at most PHYSICS_MANIFOLD_MAX_CONTACTS of the given candidates: the deepest, the one
+// farthest from it, then the two either side of the line between them which cover the most area.
+static u32 contacts_reduce(contact_candidate* candidates, u32 count, vec3 normal, physics_contact* out_contacts) {
+    if (count <= PHYSICS_MANIFOLD_MAX_CONTACTS) {
+        for (u32 i = 0; i < count; ++i) {
+            out_contacts[i].position = candidates[i].position;
+            out_contacts[i].depth = candidates[i].depth;
+        }
+        return count;
+    }
+
+    u32 chosen[PHYSICS_MANIFOLD_MAX_CONTACTS] = {0};
+    for (u32 i = 1; i < count; ++i) {
+        if (candidates[i].depth > candidates[chosen[0]].depth) {
+            chosen[0] = i;
+        }
+    }
+    f32 best = -1.0f;
+    for (u32 i = 0; i < count; ++i) {
+        f32 d = vec3_distance_squared(candidates[i].position, candidates[chosen[0]].position);
+        if (d > best) {
+            best = d;
+            chosen[1] = i;
+        }
+    }
+    vec3 p0 = candidates[chosen[0]].position;
+    vec3 p1 = candidates[chosen[1]].position;
+    f32 most = 0.0f;
+    f32 least = 0.0f;
+    chosen[2] = chosen[0];
+    chosen[3] = chosen[1];
+    for (u32 i = 0; i < count; ++i) {
+        f32 area = vec3_dot(vec3_cross(vec3_sub(p0, candidates[i].position), vec3_sub(p1, candidates[i].position)), normal);
+        if (area > most) {
+            most = area;
+            chosen[2] = i;
+        } else if (area < least) {
+            least = area;
+            chosen[3] = i;
+        }
+    }
+
+    u32 out_count = 0;
+    for (u32 i = 0; i < PHYSICS_MANIFOLD_MAX_CONTACTS; ++i) {
+        b8 duplicate = false;
+        for (u32 j = 0; j < i; ++j) {
+            duplicate |= chosen[j] == chosen[i];
+        }
+        if (!duplicate) {
+            out_contacts[out_count].position = candidates[chosen[i]].position;
+            out_contacts[out_count].depth = candidates[chosen[i]].depth;
+            out_count++;
+        }
+    }
+    return out_count;
+}
+
+static void collide_sphere_sphere(const physics_collider* a, const physics_collider* b, physics_manifold* m) {
+    vec3 d = vec3_sub(b->center, a->center);
+    f32 distance_squared = vec3_length_squared(d);
+    f32 radii = a->extents.x + b->extents.x;
+    if (distance_squared > (radii + PHYSICS_CONTACT_MARGIN) * (radii + PHYSICS_CONTACT_MARGIN)) {
+        return;
+    }
+    f32 distance = ksqrt(distance_squared);
+    m->normal = distance > K_FLOAT_EPSILON ? vec3_div_scalar(d, distance) : (vec3){0.0f, 1.0f, 0.0f};
+    f32 depth = radii - distance;
+    vec3 surface_a = vec3_add(a->center, vec3_mul_scalar(m->normal, a->extents.x));
+    m->contacts[0].position = vec3_sub(surface_a, vec3_mul_scalar(m->normal, depth * 0.5f));
+    m->contacts[0].depth = depth;
+    m->contact_count = 1;
+}
+
+// Finds the contact between a sphere and a box, with the normal pointing from the sphere to the box.
+static void collide_sphere_box(const physics_collider* sphere, const physics_collider* box, physics_manifold* m) {
+    f32 r = sphere->extents.x;
+    vec3 local = vec3_sub(sphere->center, box->center);
+    f32 d[3];
+    vec3 closest = box->center;
+    for (u32 i = 0; i < 3; ++i) {
+        d[i] = vec3_dot(local, box->axes[i]);
+        f32 clamped = KCLAMP(d[i], -box->extents.elements[i], box->extents.elements[i]);
+        closest = vec3_add(closest, vec3_mul_scalar(box->axes[i], clamped));
+    }
+
+    vec3 diff = vec3_sub(sphere->center, closest);
+    f32 distance_squared = vec3_length_squared(diff);
+    if (distance_squared > (r + PHYSICS_CONTACT_MARGIN) * (r + PHYSICS_CONTACT_MARGIN)) {
+        return;
+    }
+
+    if (distance_squared > K_FLOAT_EPSILON * K_FLOAT_EPSILON) {
+        f32 distance = ksqrt(distance_squared);
+        m->normal = vec3_div_scalar(diff, -distance);
+        f32 depth = r - distance;
+        vec3 surface_sphere = vec3_add(sphere->center, vec3_mul_scalar(m->normal, r));
+        m->contacts[0].position = vec3_mul_scalar(vec3_add(surface_sphere, closest), 0.5f);
+        m->contacts[0].depth = depth;
+    } else {
+        // The center is inside the box. Push out through the nearest face.
+        u32 axis = 0;
+        f32 nearest = box->extents.x - kabs(d[0]);
+        for (u32 i = 1; i < 3; ++i) {
+            f32 distance = box->extents.elements[i] - kabs(d[i]);
+            if (distance < nearest) {
+                nearest = distance;
+                axis = i;
+            }
+        }
+        m->normal = vec3_mul_scalar(box->axes[axis], d[axis] >= 0.0f ? -1.0f : 1.0f);
+        m->contacts[0].position = sphere->center;
+        m->contacts[0].depth = r + nearest;
+    }
+    m->contact_count = 1;
+}
+
+// Keeps the points of the polygon on the inner side of the plane dot(normal, p) <= offset.
+static u32 polygon_clip(const vec3* in, u32 count, vec3 normal, f32 offset, vec3* out) {
+    u32 out_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        vec3 p = in[i];
+        vec3 q = in[(i + 1) % count];
+        f32 dp = vec3_dot(normal, p) - offset;
+        f32 dq = vec3_dot(normal, q) - offset;
+        if (dp <= 0.0f) {
+            out[out_count++] = p;
+        }
+        if ((dp < 0.0f && dq > 0.0f) || (dp > 0.0f && dq < 0.0f)) {
+            f32 t = dp / (dp - dq);
+            out[out_count++] = vec3_add(p, vec3_mul_scalar(vec3_sub(q, p), t));
+        }
+    }
+    return out_count;
+}
+
+// Clips the face of the incident box most facing the reference face against it. The face normal
+// points out of the reference box toward the incident one.
+static u32 box_face_clip(const physics_collider* reference, u32 axis, vec3 face_normal, const physics_collider* incident, contact_candidate* out_candidates) {
+    u32 incident_axis = 0;
+    f32 most = -1.0f;
+    for (u32 i = 0; i < 3; ++i) {
+        f32 d = kabs(vec3_dot(incident->axes[i], face_normal));
+        if (d > most) {
+            most = d;
+            incident_axis = i;
+        }
+    }
+    vec3 incident_normal = vec3_mul_scalar(incident->axes[incident_axis], vec3_dot(incident->axes[incident_axis], face_normal) > 0.0f ? -1.0f : 1.0f);
+    vec3 face_center = vec3_add(incident->center, vec3_mul_scalar(incident_normal, incident->extents.elements[incident_axis]));
+    u32 i1 = (incident_axis + 1) % 3;
+    u32 i2 = (incident_axis + 2) % 3;
+    vec3 u = vec3_mul_scalar(incident->axes[i1], incident->extents.elements[i1]);
+    vec3 v = vec3_mul_scalar(incident->axes[i2], incident->extents.elements[i2]);
+
+    // Up to 8 points after clipping a quad by 4 planes.
+    vec3 buffers[2][8];
+    buffers[0][0] = vec3_add(face_center, vec3_add(u, v));
+    buffers[0][1] = vec3_add(face_center, vec3_sub(v, u));
+    buffers[0][2] = vec3_sub(face_center, vec3_add(u, v));
+    buffers[0][3] = vec3_add(face_center, vec3_sub(u, v));
+    u32 count = 4;
+    u32 current = 0;
+    for (u32 k = 1; k < 3 && count; ++k) {
+        u32 side = (axis + k) % 3;
+        vec3 side_normal = reference->axes[side];
+        f32 center_offset = vec3_dot(side_normal, reference->center);
+        f32 e = reference->extents.elements[side];
+        count = polygon_clip(buffers[current], count, side_normal, center_offset + e, buffers[1 - current]);
+        current = 1 - current;
+        count = polygon_clip(buffers[current], count, vec3_mul_scalar(side_normal, -1.0f), -center_offset + e, buffers[1 - current]);
+        current = 1 - current;
+    }
+
+    f32 face_offset = vec3_dot(face_normal, reference->center) + reference->extents.elements[axis];
+    u32 out_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        f32 separation = vec3_dot(face_normal, buffers[current][i]) - face_offset;
+        if (separation <= PHYSICS_CONTACT_MARGIN) {
+            out_candidates[out_count].position = vec3_sub(buffers[current][i], vec3_mul_scalar(face_normal, separation * 0.5f));
+            out_candidates[out_count].depth = -separation;
+            out_count++;
+        }
+    }
+    return out_count;
+}
+
+// Finds the contacts between two boxes by the separating axis test, clipping faces against each
+// other or, where edges meet, taking the closest points between them.
+static void collide_box_box(const physics_collider* a, const physics_collider* b, physics_manifold* m) {
+    vec3 t = vec3_sub(b->center, a->center);
+
+    f32 best_face = K_INFINITY;
+    u32 best_face_axis = 0;
+    vec3 best_face_normal = vec3_zero();
+    f32 best_edge = K_INFINITY;
+    u32 best_edge_axes[2] = {0};
+    vec3 best_edge_normal = vec3_zero();
+
+    for (u32 i = 0; i < 15; ++i) {
+        vec3 axis;
+        if (i < 3) {
+            axis = a->axes[i];
+        } else if (i < 6) {
+            axis = b->axes[i - 3];
+        } else {
+            axis = vec3_cross(a->axes[(i - 6) / 3], b->axes[(i - 6) % 3]);
+            f32 length = vec3_length(axis);
+            // Parallel edges are covered by the face axes.
+            if (length < 1e-3f) {
+                continue;
+            }
+            axis = vec3_div_scalar(axis, length);
+        }
+        f32 ra = kabs(vec3_dot(a->axes[0], axis)) * a->extents.x + kabs(vec3_dot(a->axes[1], axis)) * a->extents.y + kabs(vec3_dot(a->axes[2], axis)) * a->extents.z;
+        f32 rb = kabs(vec3_dot(b->axes[0], axis)) * b->extents.x + kabs(vec3_dot(b->axes[1], axis)) * b->extents.y + kabs(vec3_dot(b->axes[2], axis)) * b->extents.z;
+        f32 distance = vec3_dot(t, axis);
+        f32 overlap = ra + rb - kabs(distance);
+        if (overlap < -PHYSICS_CONTACT_MARGIN) {
+            return;
+        }
+        if (distance < 0.0f) {
+            axis = vec3_mul_scalar(axis, -1.0f);
+        }
+        if (i < 6) {
+            if (overlap < best_face) {
+                best_face = overlap;
+                best_face_axis = i;
+                best_face_normal = axis;
+            }
+        } else if (overlap < best_edge) {
+            best_edge = overlap;
+            best_edge_axes[0] = (i - 6) / 3;
+            best_edge_axes[1] = (i - 6) % 3;
+            best_edge_normal = axis;
+        }
+    }
+
+    // Faces are preferred unless an edge is clearly shallower, which keeps stacking stable.
+    if (best_edge < best_face * 0.95f - 0.01f) {
+        m->normal = best_edge_normal;
+        u32 ia = best_edge_axes[0];
+        u32 ib = best_edge_axes[1];
+        vec3 pa = a->center;
+        vec3 pb = b->center;
+        for (u32 k = 0; k < 3; ++k) {
+            if (k != ia) {
+                pa = vec3_add(pa, vec3_mul_scalar(a->axes[k], a->extents.elements[k] * (vec3_dot(a->axes[k], m->normal) > 0.0f ? 1.0f : -1.0f)));
+            }
+            if (k != ib) {
+                pb = vec3_add(pb, vec3_mul_scalar(b->axes[k], b->extents.elements[k] * (vec3_dot(b->axes[k], m->normal) > 0.0f ? -1.0f : 1.0f)));
+            }
+        }
+        vec3 da = a->axes[ia];
+        vec3 db = b->axes[ib];
+        vec3 r = vec3_sub(pa, pb);
+        f32 dab = vec3_dot(da, db);
+        f32 c = vec3_dot(da, r);
+        f32 f = vec3_dot(db, r);
+        f32 denominator = 1.0f - dab * dab;
+        f32 s = denominator > K_FLOAT_EPSILON ? (dab * f - c) / denominator : 0.0f;
+        s = KCLAMP(s, -a->extents.elements[ia], a->extents.elements[ia]);
+        f32 u = KCLAMP(f + dab * s, -b->extents.elements[ib], b->extents.elements[ib]);
+        vec3 ca = vec3_add(pa, vec3_mul_scalar(da, s));
+        vec3 cb = vec3_add(pb, vec3_mul_scalar(db, u));
+        m->contacts[0].position = vec3_mul_scalar(vec3_add(ca, cb), 0.5f);
+        m->contacts[0].depth = best_edge;
+        m->contact_count = 1;
+        return;
+    }
+
+    contact_candidate candidates[8];
+    u32 count;
+    if (best_face_axis < 3) {
+        m->normal = best_face_normal;
+        count = box_face_clip(a, best_face_axis, best_face_normal, b, candidates);
+    } else {
+        // Clipped from b's side, with its face normal pointing back toward a.
+        m->normal = best_face_normal;
+        count = box_face_clip(b, best_face_axis - 3, vec3_mul_scalar(best_face_normal, -1.0f), a, candidates);
+    }
+    m->contact_count = contacts_reduce(candidates, count, m->normal, m->contacts);
+}
+
+// Obtains the height and normal of the triangle of the heightfield beneath the given point.
+static b8 heightfield_sample(const physics_heightfield* h, f32 x, f32 z, f32* out_height, vec3* out_normal) {
+    f32 fx = (x - h->origin.x) / h->tile_scale_x;
+    f32 fz = (z - h->origin.z) / h->tile_scale_z;
+    if (fx < 0.0f || fz < 0.0f || fx > (f32)(h->vertex_count_x - 1) || fz > (f32)(h->vertex_count_z - 1)) {
+        return false;
+    }
+    u32 i = KMIN((u32)fx, h->vertex_count_x - 2);
+    u32 j = KMIN((u32)fz, h->vertex_count_z - 2);
+    f32 u = fx - i;
+    f32 v = fz - j;
+    f32 h0 = h->heights[j * h->vertex_count_x + i];
+    f32 h1 = h->heights[j * h->vertex_count_x + i + 1];
+    f32 h2 = h->heights[(j + 1) * h->vertex_count_x + i];
+    f32 h3 = h->heights[(j + 1) * h->vertex_count_x + i + 1];
+    f32 sx = h->tile_scale_x;
+    f32 sz = h->tile_scale_z;
+    // Each tile is split along the diagonal from (i + 1, j) to (i, j + 1), as the terrain is drawn.
+    if (u + v <= 1.0f) {
+        *out_height = h0 + u * (h1 - h0) + v * (h2 - h0);
+        *out_normal = vec3_normalized((vec3){-(h1 - h0) * sz, sx * sz, -(h2 - h0) * sx});
+    } else {
+        *out_height = h3 + (1.0f - u) * (h2 - h3) + (1.0f - v) * (h1 - h3);
+        *out_normal = vec3_normalized((vec3){-(h3 - h2) * sz, sx * sz, -(h3 - h1) * sx});
+    }
+    *out_height += h->origin.y;
+    return true;
+}
+
+// Finds the closest point to p on the triangle abc.
+static vec3 triangle_closest_point(vec3 p, vec3 a, vec3 b, vec3 c) {
+    vec3 ab = vec3_sub(b, a);
+    vec3 ac = vec3_sub(c, a);
+    vec3 ap = vec3_sub(p, a);
+    f32 d1 = vec3_dot(ab, ap);
+    f32 d2 = vec3_dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+    vec3 bp = vec3_sub(p, b);
+    f32 d3 = vec3_dot(ab, bp);
+    f32 d4 = vec3_dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+    f32 vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return vec3_add(a, vec3_mul_scalar(ab, d1 / (d1 - d3)));
+    }
+    vec3 cp = vec3_sub(p, c);
+    f32 d5 = vec3_dot(ab, cp);
+    f32 d6 = vec3_dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+    f32 vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return vec3_add(a, vec3_mul_scalar(ac, d2 / (d2 - d6)));
+    }
+    f32 va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return vec3_add(b, vec3_mul_scalar(vec3_sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+    f32 denominator = 1.0f / (va + vb + vc);
+    return vec3_add(a, vec3_add(vec3_mul_scalar(ab, vb * denominator), vec3_mul_scalar(ac, vc * denominator)));
+}
+
+static vec3 heightfield_vertex(const physics_heightfield* h, u32 x, u32 z) {
+    return (vec3){h->origin.x + x * h->tile_scale_x, h->origin.y + h->heights[z * h->vertex_count_x + x], h->origin.z + z * h->tile_scale_z};
+}
+
+// Finds the contact of a sphere with the triangles of a heightfield, with the normal pointing down into it.
+static void collide_sphere_heightfield(const physics_collider* sphere, const physics_heightfield* h, physics_manifold* m) {
+    f32 r = sphere->extents.x;
+    vec3 c = sphere->center;
+    i32 x0 = (i32)kfloor((c.x - r - h->origin.x) / h->tile_scale_x);
+    i32 x1 = (i32)kfloor((c.x + r - h->origin.x) / h->tile_scale_x);
+    i32 z0 = (i32)kfloor((c.z - r - h->origin.z) / h->tile_scale_z);
+    i32 z1 = (i32)kfloor((c.z + r - h->origin.z) / h->tile_scale_z);
+    x0 = KMAX(x0, 0);
+    z0 = KMAX(z0, 0);
+    x1 = KMIN(x1, (i32)h->vertex_count_x - 2);
+    z1 = KMIN(z1, (i32)h->vertex_count_z - 2);
+
+    f32 nearest = K_INFINITY;
+    vec3 nearest_point = vec3_zero();
+    for (i32 z = z0; z <= z1; ++z) {
+        for (i32 x = x0; x <= x1; ++x) {
+            vec3 v0 = heightfield_vertex(h, x, z);
+            vec3 v1 = heightfield_vertex(h, x + 1, z);
+            vec3 v2 = heightfield_vertex(h, x, z + 1);
+            vec3 v3 = heightfield_vertex(h, x + 1, z + 1);
+            vec3 q[2] = {triangle_closest_point(c, v0, v1, v2), triangle_closest_point(c, v3, v1, v2)};
+            for (u32 k = 0; k < 2; ++k) {
+                f32 d = vec3_distance_squared(c, q[k]);
+                if (d < nearest) {
+                    nearest = d;
+                    nearest_point = q[k];
+                }
+            }
+        }
+    }
+    if (nearest > (r + PHYSICS_CONTACT_MARGIN) * (r + PHYSICS_CONTACT_MARGIN)) {
+        return;
+    }
+
+    f32 surface_height;
+    vec3 up;
+    b8 above = true;
+    if (heightfield_sample(h, c.x, c.z, &surface_height, &up)) {
+        above = c.y >= surface_height;
+    }
+    f32 depth;
+    if (above && nearest > K_FLOAT_EPSILON * K_FLOAT_EPSILON) {
+        f32 distance = ksqrt(nearest);
+        up = vec3_div_scalar(vec3_sub(c, nearest_point), distance);
+        depth = r - distance;
+    } else {
+        // The center has passed through the surface. Push it back out the top.
+        depth = r + (surface_height - c.y) * up.y;
+    }
+    m->normal = vec3_mul_scalar(up, -1.0f);
+    m->contacts[0].position = vec3_sub(c, vec3_mul_scalar(up, r - depth * 0.5f));
+    m->contacts[0].depth = depth;
+    m->contact_count = 1;
+}
+
+// Finds the contacts of the corners of a box with a heightfield, with the normal pointing down into it.
+static void collide_box_heightfield(const physics_collider* box, const physics_heightfield* h, physics_manifold* m) {
+    contact_candidate candidates[8];
+    u32 count = 0;
+    f32 deepest = -K_INFINITY;
+    for (u32 i = 0; i < 8; ++i) {
+        vec3 p = box->center;
+        for (u32 k = 0; k < 3; ++k) {
+            f32 sign = (i >> k) & 1 ? 1.0f : -1.0f;
+            p = vec3_add(p, vec3_mul_scalar(box->axes[k], box->extents.elements[k] * sign));
+        }
+        f32 height;
+        vec3 up;
+        if (!heightfield_sample(h, p.x, p.z, &height, &up)) {
+            continue;
+        }
+        f32 separation = (p.y - height) * up.y;
+        if (separation <= PHYSICS_CONTACT_MARGIN) {
+            candidates[count].position = vec3_sub(p, vec3_mul_scalar(up, separation * 0.5f));
+            candidates[count].depth = -separation;
+            if (-separation > deepest) {
+                // The surface beneath the deepest corner gives the normal of the whole manifold.
+                deepest = -separation;
+                m->normal = vec3_mul_scalar(up, -1.0f);
+            }
+            count++;
+        }
+    }
+    m->contact_count = contacts_reduce(candidates, count, m->normal, m->contacts);
+}
+
+static void manifold_materials_set(const physics_system_state* state, physics_manifold* m) {
+    f32 friction_b = m->b != INVALID_ID ? state->frictions[m->b] : 0.6f;
+    f32 restitution_b = m->b != INVALID_ID ? state->restitutions[m->b] : 0.0f;
+    m->friction = ksqrt(state->frictions[m->a] * friction_b);
+    m->restitution = KMAX(state->restitutions[m->a], restitution_b);
+}
+
+typedef struct physics_narrowphase_context {
+    physics_system_state* state;
+    u32 heightfield_count;
+} physics_narrowphase_context;
+
+static void pairs_collide(u32 start, u32 end, void* user_data) {
+    physics_system_state* state = ((physics_narrowphase_context*)user_data)->state;
+    for (u32 i = start; i < end; ++i) {
+        physics_manifold* m = &state->manifolds[i];
+        m->a = state->pairs[i].a;
+        m->b = state->pairs[i].b;
+        m->key = ((u64)m->a << 32) | m->b;
+        m->contact_count = 0;
+        physics_collider a, b;
+        collider_get(state, m->a, &a);
+        collider_get(state, m->b, &b);
+        if (a.shape == PHYSICS_SHAPE_TYPE_SPHERE && b.shape == PHYSICS_SHAPE_TYPE_SPHERE) {
+            collide_sphere_sphere(&a, &b, m);
+        } else if (a.shape == PHYSICS_SHAPE_TYPE_SPHERE) {
+            collide_sphere_box(&a, &b, m);
+        } else if (b.shape == PHYSICS_SHAPE_TYPE_SPHERE) {
+            collide_sphere_box(&b, &a, m);
+            m->normal = vec3_mul_scalar(m->normal, -1.0f);
+        } else {
+            collide_box_box(&a, &b, m);
+        }
+        if (m->contact_count) {
+            manifold_materials_set(state, m);
+        }
+    }
+}
+
+static void heightfields_collide(u32 start, u32 end, void* user_data) {
+    physics_narrowphase_context* context = user_data;
+    physics_system_state* state = context->state;
+    u32 pair_count = darray_length(state->pairs);
+    for (u32 i = start; i < end; ++i) {
+        u32 body_id = state->awake_ids[i];
+        physics_collider c;
+        collider_get(state, body_id, &c);
+        for (u32 h = 0; h < context->heightfield_count; ++h) {
+            physics_manifold* m = &state->manifolds[pair_count + i * context->heightfield_count + h];
+            m->a = body_id;
+            m->b = INVALID_ID;
+            // Body ids never come near INVALID_ID, so these never clash with those of pairs.
+            m->key = ((u64)body_id << 32) | (INVALID_ID - h);
+            m->contact_count = 0;
+            const physics_heightfield* field = &state->heightfields[h];
+            if (!field->alive || !bounds_overlap(&state->bounds[body_id], &field->bounds)) {
+                continue;
+            }
+            if (c.shape == PHYSICS_SHAPE_TYPE_SPHERE) {
+                collide_sphere_heightfield(&c, field, m);
+            } else {
+                collide_box_heightfield(&c, field, m);
+            }
+            if (m->contact_count) {
+                manifold_materials_set(state, m);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Broadphase
+// ---------------------------------------------------------------------------------------------
+
+static void awake_bounds_update(u32 start, u32 end, void* user_data) {
+    physics_system_state* state = user_data;
+    for (u32 i = start; i < end; ++i) {
+        body_bounds_update(state, state->awake_ids[i]);
+    }
+}
+
+// Sorts the bodies by the minimum x of their bounds. Bodies move little between steps, so the
+// order is nearly kept and insertion sort takes close to linear time.
+static void sorted_ids_update(physics_system_state* state) {
+    u32 count = darray_length(state->sorted_ids);
+    u32* ids = state->sorted_ids;
+    for (u32 i = 1; i < count; ++i) {
+        u32 id = ids[i];
+        f32 key = state->bounds[id].min.x;
+        u32 j = i;
+        while (j > 0 && state->bounds[ids[j - 1]].min.x > key) {
+            ids[j] = ids[j - 1];
+            j--;
+        }
+        ids[j] = id;
+    }
+
+    darray_length_set(state->sorted_bounds, 0);
+    darray_reserve_exact(state->sorted_bounds, count);
+    darray_length_set(state->sorted_bounds, count);
+    for (u32 i = 0; i < count; ++i) {
+        state->sorted_bounds[i] = state->bounds[ids[i]];
+    }
+}
+
+// Sweeps the bodies of a batch forward along x for those their bounds overlap. Counts the
+// pairs when writing is false; otherwise writes them from the batch's offset.
+static u32 sweep_batch(physics_system_state* state, u32 batch, b8 write) {
+    u32 count = darray_length(state->sorted_ids);
+    u32 start = batch * PHYSICS_SWEEP_BATCH_SIZE;
+    u32 end = KMIN(start + PHYSICS_SWEEP_BATCH_SIZE, count);
+    u32 found = 0;
+    physics_pair* out = write ? &state->pairs[state->sweep_counts[batch]] : 0;
+    for (u32 i = start; i < end; ++i) {
+        const extents_3d* a = &state->sorted_bounds[i];
+        u32 id_a = state->sorted_ids[i];
+        b8 awake_a = body_awake(state, id_a);
+        b8 dynamic_a = body_dynamic(state, id_a);
+        for (u32 j = i + 1; j < count && state->sorted_bounds[j].min.x <= a->max.x; ++j) {
+            const extents_3d* b = &state->sorted_bounds[j];
+            if (a->min.y > b->max.y || a->max.y < b->min.y || a->min.z > b->max.z || a->max.z < b->min.z) {
+                continue;
+            }
+            u32 id_b = state->sorted_ids[j];
+            // Nothing changes between bodies which are static or asleep.
+            if (!awake_a && !body_awake(state, id_b)) {
+                continue;
+            }
+            if (!dynamic_a && !body_dynamic(state, id_b)) {
+                continue;
+            }
+            if (write) {
+                // Ordered by id, so the pairs don't depend on where bodies fall in the sort.
+                out[found].a = KMIN(id_a, id_b);
+                out[found].b = KMAX(id_a, id_b);
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+static void sweep_count(u32 start, u32 end, void* user_data) {
+    physics_system_state* state = user_data;
+    for (u32 b = start; b < end; ++b) {
+        state->sweep_counts[b] = sweep_batch(state, b, false);
+    }
+}
+
+static void sweep_write(u32 start, u32 end, void* user_data) {
+    physics_system_state* state = user_data;
+    for (u32 b = start; b < end; ++b) {
+        sweep_batch(state, b, true);
+    }
+}
+
+// Finds the pairs whose bounds overlap. The sweep runs twice in parallel: once to count the pairs
+// each batch finds, then again to write them, each batch from its own offset. Pairs are so found
+// in the same order whatever the number of threads, without any batch waiting on another.
+static void broadphase_update(physics_system_state* state) {
+    sorted_ids_update(state);
+
+    u32 count = darray_length(state->sorted_ids);
+    u32 batch_count = (count + PHYSICS_SWEEP_BATCH_SIZE - 1) / PHYSICS_SWEEP_BATCH_SIZE;
+    darray_reserve_exact(state->sweep_counts, batch_count);
+    darray_length_set(state->sweep_counts, batch_count);
+    job_parallel_for(batch_count, 1, sweep_count, state);
+
+    u32 total = 0;
+    for (u32 b = 0; b < batch_count; ++b) {
+        u32 found = state->sweep_counts[b];
+        state->sweep_counts[b] = total;
+        total += found;
+    }
+    darray_length_set(state->pairs, 0);
+    darray_reserve_exact(state->pairs, total);
+    darray_length_set(state->pairs, total);
+    job_parallel_for(batch_count, 1, sweep_write, state);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Islands
+// ---------------------------------------------------------------------------------------------
+
+static u32 island_find(u32* parents, u32 id) {
+    while (parents[id] != id) {
+        parents[id] = parents[parents[id]];
+        id = parents[id];
+    }
+    return id;
+}
+
+static void island_union(u32* parents, u32 a, u32 b) {
+    a = island_find(parents, a);
+    b = island_find(parents, b);
+    if (a != b) {
+        // The lower id becomes the root, so islands are found the same way every time.
+        if (a < b) {
+            parents[b] = a;
+        } else {
+            parents[a] = b;
+        }
+    }
+}
+
+// Groups the awake bodies into islands of those in contact, along with their manifolds. Static
+// bodies and heightfields don't join islands, so resting on the same ground keeps them apart.
+static void islands_build(physics_system_state* state) {
+    u32 awake_count = darray_length(state->awake_ids);
+    u32 manifold_count = darray_length(state->manifolds);
+    for (u32 i = 0; i < awake_count; ++i) {
+        u32 id = state->awake_ids[i];
+        state->island_parents[id] = id;
+        state->island_indices[id] = INVALID_ID;
+    }
+    for (u32 i = 0; i < manifold_count; ++i) {
+        const physics_manifold* m = &state->manifolds[i];
+        if (m->contact_count && body_dynamic(state, m->a) && body_dynamic(state, m->b)) {
+            island_union(state->island_parents, m->a, m->b);
+        }
+    }
+
+    darray_clear(state->islands);
+    for (u32 i = 0; i < awake_count; ++i) {
+        u32 root = island_find(state->island_parents, state->awake_ids[i]);
+        if (state->island_indices[root] == INVALID_ID) {
+            state->island_indices[root] = darray_length(state->islands);
+            physics_island island = {0};
+            darray_push(state->islands, island);
+        }
+        state->islands[state->island_indices[root]].body_count++;
+    }
+    for (u32 i = 0; i < manifold_count; ++i) {
+        const physics_manifold* m = &state->manifolds[i];
+        if (m->contact_count) {
+            u32 body = body_dynamic(state, m->a) ? m->a : m->b;
+            state->islands[state->island_indices[island_find(state->island_parents, body)]].manifold_count++;
+        }
+    }
+
+    // Counting sort the bodies and manifolds by island.
+    u32 island_count = darray_length(state->islands);
+    u32 body_offset = 0;
+    u32 manifold_offset = 0;
+    for (u32 i = 0; i < island_count; ++i) {
+        physics_island* island = &state->islands[i];
+        island->first_body = body_offset;
+        island->first_manifold = manifold_offset;
+        body_offset += island->body_count;
+        manifold_offset += island->manifold_count;
+        island->body_count = 0;
+        island->manifold_count = 0;
+    }
+    darray_reserve_exact(state->island_bodies, body_offset);
+    darray_length_set(state->island_bodies, body_offset);
+    darray_reserve_exact(state->island_manifolds, manifold_offset);
+    darray_length_set(state->island_manifolds, manifold_offset);
+    for (u32 i = 0; i < awake_count; ++i) {
+        u32 id = state->awake_ids[i];
+        physics_island* island = &state->islands[state->island_indices[island_find(state->island_parents, id)]];
+        state->island_bodies[island->first_body + island->body_count++] = id;
+    }
+    for (u32 i = 0; i < manifold_count; ++i) {
+        const physics_manifold* m = &state->manifolds[i];
+        if (m->contact_count) {
+            u32 body = body_dynamic(state, m->a) ? m->a : m->b;
+            physics_island* island = &state->islands[state->island_indices[island_find(state->island_parents, body)]];
+            state->island_manifolds[island->first_manifold + island->manifold_count++] = i;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Solver
+// ---------------------------------------------------------------------------------------------
+
+static vec3 body_point_velocity(const physics_system_state* state, u32 body_id, vec3 r) {
+    if (!body_dynamic(state, body_id)) {
+        return vec3_zero();
+    }
+    return vec3_add(state->linear_velocities[body_id], vec3_cross(state->angular_velocities[body_id], r));
+}
+
+static void body_impulse_apply(physics_system_state* state, u32 body_id, vec3 r, vec3 impulse) {
+    // Static bodies may touch several islands at once, so are never written to.
+    if (!body_dynamic(state, body_id)) {
+        return;
+    }
+    state->linear_velocities[body_id] = vec3_add(state->linear_velocities[body_id], vec3_mul_scalar(impulse, state->inverse_masses[body_id]));
+    state->angular_velocities[body_id] = vec3_add(state->angular_velocities[body_id], inverse_inertia_apply(state, body_id, vec3_cross(r, impulse)));
+}
+
+static f32 effective_mass(const physics_system_state* state, const physics_manifold* m, const physics_contact* c, vec3 direction) {
+    f32 k = 0.0f;
+    if (body_dynamic(state, m->a)) {
+        vec3 rn = vec3_cross(c->r_a, direction);
+        k += state->inverse_masses[m->a] + vec3_dot(rn, inverse_inertia_apply(state, m->a, rn));
+    }
+    if (body_dynamic(state, m->b)) {
+        vec3 rn = vec3_cross(c->r_b, direction);
+        k += state->inverse_masses[m->b] + vec3_dot(rn, inverse_inertia_apply(state, m->b, rn));
+    }
+    return k > K_FLOAT_EPSILON ? 1.0f / k : 0.0f;
+}
+
+// Finds the manifold of the previous step with the given key, or returns 0 if there was none.
+static const physics_manifold* previous_manifold_find(const physics_system_state* state, u64 key) {
+    u32 low = 0;
+    u32 high = darray_length(state->previous_keys);
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (state->previous_keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < darray_length(state->previous_keys) && state->previous_keys[low] == key) {
+        return &state->previous_manifolds[state->previous_indices[low]];
+    }
+    return 0;
+}
+
+static void manifold_prepare(physics_system_state* state, physics_manifold* m, f32 dt) {
+    // Any two directions perpendicular to the normal.
+    vec3 n = m->normal;
+    vec3 reference = kabs(n.x) < 0.57f ? (vec3){1.0f, 0.0f, 0.0f} : (vec3){0.0f, 1.0f, 0.0f};
+    m->tangents[0] = vec3_normalized(vec3_cross(n, reference));
+    m->tangents[1] = vec3_cross(n, m->tangents[0]);
+
+    for (u32 i = 0; i < m->contact_count; ++i) {
+        physics_contact* c = &m->contacts[i];
+        c->r_a = vec3_sub(c->position, state->positions[m->a]);
+        c->r_b = m->b != INVALID_ID ? vec3_sub(c->position, state->positions[m->b]) : vec3_zero();
+        c->normal_mass = effective_mass(state, m, c, n);
+        c->tangent_mass[0] = effective_mass(state, m, c, m->tangents[0]);
+        c->tangent_mass[1] = effective_mass(state, m, c, m->tangents[1]);
+        c->normal_impulse = 0.0f;
+        c->tangent_impulse[0] = 0.0f;
+        c->tangent_impulse[1] = 0.0f;
+
+        // Separating velocity to aim for: enough to push out penetration, and to bounce.
+        vec3 relative = vec3_sub(body_point_velocity(state, m->b, c->r_b), body_point_velocity(state, m->a, c->r_a));
+        f32 approach = vec3_dot(relative, n);
+        c->velocity_bias = PHYSICS_BAUMGARTE / dt * KMAX(c->depth - PHYSICS_PENETRATION_SLOP, 0.0f);
+        if (approach < -PHYSICS_RESTITUTION_THRESHOLD) {
+            c->velocity_bias = KMAX(c->velocity_bias, -m->restitution * approach);
+        }
+        // Contacts still separated may close by no more than the gap this step.
+        if (c->depth < 0.0f) {
+            c->velocity_bias = c->depth / dt;
+        }
+    }
+
+    // Warm start from the impulses of the same contacts last step, so stacks settle in few iterations.
+    const physics_manifold* previous = previous_manifold_find(state, m->key);
+    if (!previous) {
+        return;
+    }
+    for (u32 i = 0; i < m->contact_count; ++i) {
+        physics_contact* c = &m->contacts[i];
+        f32 nearest = PHYSICS_WARM_START_DISTANCE * PHYSICS_WARM_START_DISTANCE;
+        const physics_contact* match = 0;
+        for (u32 j = 0; j < previous->contact_count; ++j) {
+            f32 d = vec3_distance_squared(c->position, previous->contacts[j].position);
+            if (d < nearest) {
+                nearest = d;
+                match = &previous->contacts[j];
+            }
+        }
+        if (match) {
+            c->normal_impulse = match->normal_impulse;
+            c->tangent_impulse[0] = match->tangent_impulse[0];
+            c->tangent_impulse[1] = match->tangent_impulse[1];
+            vec3 impulse = vec3_add(vec3_mul_scalar(n, c->normal_impulse), vec3_add(vec3_mul_scalar(m->tangents[0], c->tangent_impulse[0]), vec3_mul_scalar(m->tangents[1], c->tangent_impulse[1])));
+            body_impulse_apply(state, m->a, c->r_a, vec3_mul_scalar(impulse, -1.0f));
+            body_impulse_apply(state, m->b, c->r_b, impulse);
+        }
+    }
+}
+
+static void manifold_solve(physics_system_state* state, physics_manifold* m) {
+    for (u32 i = 0; i < m->contact_count; ++i) {
+        physics_contact* c = &m->contacts[i];
+
+        // Friction, limited by the normal impulse so far.
+        f32 limit = m->friction * c->normal_impulse;
+        for (u32 t = 0; t < 2; ++t) {
+            vec3 relative = vec3_sub(body_point_velocity(state, m->b, c->r_b), body_point_velocity(state, m->a, c->r_a));
+            f32 lambda = -vec3_dot(relative, m->tangents[t]) * c->tangent_mass[t];
+            f32 previous = c->tangent_impulse[t];
+            c->tangent_impulse[t] = KCLAMP(previous + lambda, -limit, limit);
+            vec3 impulse = vec3_mul_scalar(m->tangents[t], c->tangent_impulse[t] - previous);
+            body_impulse_apply(state, m->a, c->r_a, vec3_mul_scalar(impulse, -1.0f));
+            body_impulse_apply(state, m->b, c->r_b, impulse);
+        }
+
+        // Normal, which may only push.
+        vec3 relative = vec3_sub(body_point_velocity(state, m->b, c->r_b), body_point_velocity(state, m->a, c->r_a));
+        f32 lambda = (c->velocity_bias - vec3_dot(relative, m->normal)) * c->normal_mass;
+        f32 previous = c->normal_impulse;
+        c->normal_impulse = KMAX(previous + lambda, 0.0f);
+        vec3 impulse = vec3_mul_scalar(m->normal, c->normal_impulse - previous);
+        body_impulse_apply(state, m->a, c->r_a, vec3_mul_scalar(impulse, -1.0f));
+        body_impulse_apply(state, m->b, c->r_b, impulse);
+    }
+}
+
+typedef struct physics_solve_context {
+    physics_system_state* state;
+    f32 dt;
+} physics_solve_context;
+
+// Solves, integrates and puts to sleep the given islands. Each touches only its own bodies and
+// manifolds, so islands may be solved alongside each other.
+static void islands_solve(u32 start, u32 end, void* user_data) {
+    physics_solve_context* context = user_data;
+    physics_system_state* state = context->state;
+    f32 dt = context->dt;
+    vec3 gravity_step = vec3_mul_scalar(state->config.gravity, dt);
+    f32 linear_damping = 1.0f / (1.0f + PHYSICS_LINEAR_DAMPING * dt);
+    f32 angular_damping = 1.0f / (1.0f + PHYSICS_ANGULAR_DAMPING * dt);
+
+    for (u32 i = start; i < end; ++i) {
+        physics_island* island = &state->islands[i];
+        const u32* bodies = &state->island_bodies[island->first_body];
+        const u32* manifolds = &state->island_manifolds[island->first_manifold];
+
+        for (u32 b = 0; b < island->body_count; ++b) {
+            u32 id = bodies[b];
+            state->linear_velocities[id] = vec3_mul_scalar(vec3_add(state->linear_velocities[id], gravity_step), linear_damping);
+            state->angular_velocities[id] = vec3_mul_scalar(state->angular_velocities[id], angular_damping);
+        }
+
+        for (u32 m = 0; m < island->manifold_count; ++m) {
+            manifold_prepare(state, &state->manifolds[manifolds[m]], dt);
+        }
+        for (u32 iteration = 0; iteration < state->config.solver_iterations; ++iteration) {
+            for (u32 m = 0; m < island->manifold_count; ++m) {
+                manifold_solve(state, &state->manifolds[manifolds[m]]);
+            }
+        }
+
+        f32 rest_time = K_INFINITY;
+        for (u32 b = 0; b < island->body_count; ++b) {
+            u32 id = bodies[b];
+            vec3 v = state->linear_velocities[id];
+            vec3 w = state->angular_velocities[id];
+            state->positions[id] = vec3_add(state->positions[id], vec3_mul_scalar(v, dt));
+            quat q = state->rotations[id];
+            quat spin = quat_mul((quat){w.x, w.y, w.z, 0.0f}, q);
+            q.x += spin.x * 0.5f * dt;
+            q.y += spin.y * 0.5f * dt;
+            q.z += spin.z * 0.5f * dt;
+            q.w += spin.w * 0.5f * dt;
+            state->rotations[id] = quat_normalize(q);
+
+            if (vec3_length_squared(v) < PHYSICS_SLEEP_LINEAR_VELOCITY * PHYSICS_SLEEP_LINEAR_VELOCITY &&
+                vec3_length_squared(w) < PHYSICS_SLEEP_ANGULAR_VELOCITY * PHYSICS_SLEEP_ANGULAR_VELOCITY) {
+                state->sleep_timers[id] += dt;
+            } else {
+                state->sleep_timers[id] = 0.0f;
+            }
+            rest_time = KMIN(rest_time, state->sleep_timers[id]);
+        }
+
+        // The island sleeps only once every body in it has been at rest long enough.
+        island->slept = rest_time >= PHYSICS_TIME_TO_SLEEP;
+        if (island->slept) {
+            for (u32 b = 0; b < island->body_count; ++b) {
+                u32 id = bodies[b];
+                state->linear_velocities[id] = vec3_zero();
+                state->angular_velocities[id] = vec3_zero();
+                state->flags[id] &= ~PHYSICS_BODY_FLAG_AWAKE;
+            }
+        }
+    }
+}
+
+static void physics_step(physics_system_state* state, f32 dt) {
+    darray_clear(state->awake_ids);
+    for (u32 i = 0; i < state->body_id_end; ++i) {
+        if ((state->flags[i] & PHYSICS_BODY_FLAG_ALIVE) && body_awake(state, i)) {
+            darray_push(state->awake_ids, i);
+        }
+    }
+
+    job_parallel_for(darray_length(state->awake_ids), 64, awake_bounds_update, state);
+    broadphase_update(state);
+
+    // A manifold for each pair, then one for each awake body with each heightfield.
+    u32 pair_count = darray_length(state->pairs);
+    physics_narrowphase_context narrowphase = {state, darray_length(state->heightfields)};
+    u32 manifold_count = pair_count + darray_length(state->awake_ids) * narrowphase.heightfield_count;
+    darray_reserve_exact(state->manifolds, manifold_count);
+    darray_length_set(state->manifolds, manifold_count);
+    job_parallel_for(pair_count, 32, pairs_collide, &narrowphase);
+    job_parallel_for(darray_length(state->awake_ids), 32, heightfields_collide, &narrowphase);
+
+    // Sleeping bodies touched by awake ones are woken, and join their islands this step.
+    for (u32 i = 0; i < pair_count; ++i) {
+        const physics_manifold* m = &state->manifolds[i];
+        if (m->contact_count) {
+            u32 ids[2] = {m->a, m->b};
+            for (u32 k = 0; k < 2; ++k) {
+                if (body_dynamic(state, ids[k]) && !body_awake(state, ids[k])) {
+                    body_wake(state, ids[k]);
+                    darray_push(state->awake_ids, ids[k]);
+                }
+            }
+        }
+    }
+
+    islands_build(state);
+
+    // Islands are solved wide, one per batch, as they vary widely in size.
+    physics_solve_context solve = {state, dt};
+    u32 island_count = darray_length(state->islands);
+    job_parallel_for(island_count, 1, islands_solve, &solve);
+
+    state->stats.awake_body_count = darray_length(state->awake_ids);
+    state->stats.pair_count = pair_count;
+    state->stats.island_count = island_count;
+    state->stats.contact_count = 0;
+    state->stats.sleeping_island_count = 0;
+    for (u32 i = 0; i < manifold_count; ++i) {
+        state->stats.contact_count += state->manifolds[i].contact_count;
+    }
+    for (u32 i = 0; i < island_count; ++i) {
+        state->stats.sleeping_island_count += state->islands[i].slept;
+    }
+
+    // Keep the manifolds for the next step to warm start from.
+    physics_manifold* swap = state->previous_manifolds;
+    state->previous_manifolds = state->manifolds;
+    state->manifolds = swap;
+    darray_clear(state->previous_keys);
+    darray_clear(state->previous_indices);
+    for (u32 i = 0; i < manifold_count; ++i) {
+        if (state->previous_manifolds[i].contact_count) {
+            darray_push(state->previous_keys, state->previous_manifolds[i].key);
+            darray_push(state->previous_indices, i);
+        }
+    }
+    u32 key_count = darray_length(state->previous_keys);
+    darray_reserve_exact(state->scratch_keys, key_count);
+    darray_reserve_exact(state->scratch_indices, key_count);
+    kradix_sort_u64(key_count, state->previous_keys, state->previous_indices, state->scratch_keys, state->scratch_indices);
+}
@@ -0,0 +1,214 @@
+/**
+ * @file physics_system.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief The physics system front-end, which simulates rigid bodies colliding with each other
+ * and with terrain heightfields at a fixed time step.
+ * @details Bodies are held as structures of arrays, indexed by their ids. Each step, the bounds
+ * of bodies which are awake are updated and kept sorted along the x axis, and overlapping pairs
+ * swept for in parallel. Bodies in contact are grouped into islands, each of which is solved,
+ * integrated and put to sleep independently of the others on the job threads. Islands which
+ * have come to rest are left asleep until something awake touches them, so the cost of a step
+ * follows the bodies which are moving rather than the number of them.
+ * @version 1.0
+ * @date 2023-12-11
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct frame_data;
+struct terrain;
+
+/** @brief The shapes of the colliders of bodies. */
+typedef enum physics_shape_type {
+    PHYSICS_SHAPE_TYPE_SPHERE,
+    PHYSICS_SHAPE_TYPE_BOX
+} physics_shape_type;
+
+/** @brief The configuration of a rigid body. */
+typedef struct physics_body_config {
+    /** @brief The shape of the body's collider. */
+    physics_shape_type shape;
+    /** @brief The radius of a sphere. */
+    f32 radius;
+    /** @brief The half-extents of a box along each of its axes. */
+    vec3 half_extents;
+    /** @brief The mass of the body. 0 for a static body, which never moves. */
+    f32 mass;
+    /** @brief The coefficient of friction. Combined with that of the other body in contact. */
+    f32 friction;
+    /** @brief The restitution, from 0 (no bounce) to 1. The greater of the two bodies in contact is used. */
+    f32 restitution;
+    /** @brief The initial position of the center of the body. */
+    vec3 position;
+    /** @brief The initial rotation of the body. */
+    quat rotation;
+    /** @brief The initial linear velocity of the body. */
+    vec3 linear_velocity;
+    /** @brief The initial angular velocity of the body. */
+    vec3 angular_velocity;
+    /** @brief Arbitrary data to associate with the body, such as the object it moves. Optional. */
+    void* user_data;
+} physics_body_config;
+
+/** @brief The configuration of the physics system. */
+typedef struct physics_system_config {
+    /** @brief The most bodies which may exist at once. */
+    u32 max_body_count;
+    /** @brief The acceleration due to gravity. */
+    vec3 gravity;
+    /** @brief The length of each step in seconds. 0 defaults to 1/60. */
+    f32 fixed_step;
+    /** @brief The most steps taken in a single update, after which time is dropped. 0 defaults to 4. */
+    u32 max_steps;
+    /** @brief The number of times contacts are solved each step. 0 defaults to 8. */
+    u32 solver_iterations;
+} physics_system_config;
+
+/** @brief Statistics of the most recent step of the physics system. */
+typedef struct physics_system_stats {
+    /** @brief The number of bodies. */
+    u32 body_count;
+    /** @brief The number of dynamic bodies which were awake. */
+    u32 awake_body_count;
+    /** @brief The number of pairs of bodies whose bounds overlapped. */
+    u32 pair_count;
+    /** @brief The number of contact points solved. */
+    u32 contact_count;
+    /** @brief The number of islands solved. */
+    u32 island_count;
+    /** @brief The number of islands put to sleep. */
+    u32 sleeping_island_count;
+} physics_system_stats;
+
+/**
+ * @brief Initializes the physics system.
+ * Should be called twice; once to get the memory requirement (passing state=0), and a second
+ * time passing an allocated block of memory to actually initialize the system.
+ *
+ * @param memory_requirement A pointer to hold the memory requirement as it is calculated.
+ * @param state A block of memory to hold the state or, if gathering the memory requirement, 0.
+ * @param config The configuration (physics_system_config) for this system.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 physics_system_initialize(u64* memory_requirement, void* state, void* config);
+
+/**
+ * @brief Shuts down the physics system.
+ *
+ * @param state The state block of memory.
+ */
+KAPI void physics_system_shutdown(void* state);
+
+/**
+ * @brief Advances the simulation by the time elapsed since the last update, in fixed steps.
+ * Should happen once an update cycle.
+ */
+KAPI b8 physics_system_update(void* state, struct frame_data* p_frame_data);
+
+/**
+ * @brief Creates a rigid body. Dynamic bodies start awake.
+ *
+ * @param config A constant pointer to the configuration of the body.
+ * @return The id of the body, or INVALID_ID if it could not be created.
+ */
+KAPI u32 physics_body_create(const physics_body_config* config);
+
+/**
+ * @brief Destroys the body with the given id. Bodies it was resting on or against are woken.
+ *
+ * @param body_id The id of the body.
+ */
+KAPI void physics_body_destroy(u32 body_id);
+
+/**
+ * @brief Obtains the position and rotation of the given body as of the last step.
+ *
+ * @param body_id The id of the body.
+ * @param out_position A pointer to hold the position of its center. Optional.
+ * @param out_rotation A pointer to hold its rotation. Optional.
+ * @return True if the body exists; otherwise false.
+ */
+KAPI b8 physics_body_transform_get(u32 body_id, vec3* out_position, quat* out_rotation);
+
+/**
+ * @brief Moves the given body to the given position and rotation, waking it.
+ *
+ * @param body_id The id of the body.
+ * @param position The position of its center.
+ * @param rotation Its rotation.
+ * @return True if the body exists; otherwise false.
+ */
+KAPI b8 physics_body_transform_set(u32 body_id, vec3 position, quat rotation);
+
+/**
+ * @brief Sets the velocities of the given dynamic body, waking it.
+ *
+ * @param body_id The id of the body.
+ * @param linear_velocity The linear velocity.
+ * @param angular_velocity The angular velocity.
+ * @return True if the body exists and is dynamic; otherwise false.
+ */
+KAPI b8 physics_body_velocity_set(u32 body_id, vec3 linear_velocity, vec3 angular_velocity);
+
+/**
+ * @brief Applies an impulse to the given dynamic body at a point in the world, waking it.
+ *
+ * @param body_id The id of the body.
+ * @param impulse The impulse.
+ * @param world_point The point in the world the impulse is applied at.
+ * @return True if the body exists and is dynamic; otherwise false.
+ */
+KAPI b8 physics_body_impulse_apply(u32 body_id, vec3 impulse, vec3 world_point);
+
+/**
+ * @brief Indicates if the given body is awake. Static bodies never are.
+ *
+ * @param body_id The id of the body.
+ * @return True if the body exists and is awake; otherwise false.
+ */
+KAPI b8 physics_body_is_awake(u32 body_id);
+
+/**
+ * @brief Wakes the given dynamic body, if asleep.
+ *
+ * @param body_id The id of the body.
+ */
+KAPI void physics_body_wake(u32 body_id);
+
+/**
+ * @brief Obtains the user data of the given body.
+ *
+ * @param body_id The id of the body.
+ * @return The user data, or 0 if there is none or the body does not exist.
+ */
+KAPI void* physics_body_user_data_get(u32 body_id);
+
+/**
+ * @brief Adds a static heightfield collider built from the vertex data of the given terrain, matching
+ * the triangles it is drawn with. Only the position of the terrain's transform is taken into account.
+ * The terrain must be initialized, and may be destroyed afterward.
+ *
+ * @param t A constant pointer to the terrain.
+ * @return The id of the heightfield, or INVALID_ID if it could not be created.
+ */
+KAPI u32 physics_heightfield_create_from_terrain(const struct terrain* t);
+
+/**
+ * @brief Destroys the heightfield with the given id, waking every body.
+ *
+ * @param heightfield_id The id of the heightfield.
+ */
+KAPI void physics_heightfield_destroy(u32 heightfield_id);
+
+/**
+ * @brief Obtains the statistics of the most recent step.
+ *
+ * @param out_stats A pointer to hold the statistics.
+ */
+KAPI void physics_system_stats_get(physics_system_stats* out_stats);
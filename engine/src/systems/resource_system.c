@@ -1,8 +1,19 @@
 #include "resource_system.h"
 
+#include "containers/darray.h"
+#include "containers/hashmap.h"
+#include "core/event.h"
+#include "core/kcondvar.h"
 #include "core/kmemory.h"
+#include "core/kmutex.h"
+#include "core/kprofiler.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "platform/filesystem.h"
+#include "platform/platform.h"
+#include "resources/kpak.h"
+#include "systems/geometry_system.h"
+#include "systems/job_system.h"
 
 // Known resource loaders.
 #include "resources/loaders/binary_loader.h"
@@ -10,21 +21,116 @@
 #include "resources/loaders/image_loader.h"
 #include "resources/loaders/material_loader.h"
 #include "resources/loaders/mesh_loader.h"
+#include "resources/loaders/particle_emitter_loader.h"
 #include "resources/loaders/shader_loader.h"
+#include "resources/loaders/skeletal_mesh_loader.h"
 #include "resources/loaders/system_font_loader.h"
 #include "resources/loaders/terrain_loader.h"
 #include "resources/loaders/text_loader.h"
 #include "resources/resource_types.h"
 
+// The maximum number of archives which may be mounted at once.
+#define RESOURCE_SYSTEM_MAX_ARCHIVES 8
+
+// A watched resource file. Its index in the watch array is its watch id.
+typedef struct resource_watch {
+    // The path of the file, or 0 if the slot is free.
+    char *full_path;
+    // The platform's watch of the file, or INVALID_ID while it is missing.
+    u32 platform_watch_id;
+    // Indicates the file changed since the last update.
+    b8 changed;
+} resource_watch;
+
+// The longest cache key, which combines a resource's type, params and name.
+#define RESOURCE_CACHE_MAX_KEY_LENGTH 512
+
+// A resource held in the cache. Its index in the entry array is its id.
+typedef struct resource_cache_entry {
+    // The key the entry is found by, or 0 if the slot is free.
+    char *key;
+    // A copy of the name, which the resource's name points to.
+    char *name;
+    resource resource;
+    // The size of the resource's data in bytes.
+    u64 size;
+    u32 reference_count;
+    // Set while the first caller to ask for it loads it. Others asking meanwhile wait for that load.
+    b8 loading;
+    // Set once loaded successfully.
+    b8 loaded;
+    // Set once taken out of the map because its file changed, so it is unloaded once released.
+    b8 detached;
+    // Links in the list of unreferenced entries, most recently released first. INVALID_ID at the ends.
+    u32 lru_prev;
+    u32 lru_next;
+    // The next free slot, while this one is free.
+    u32 next_free;
+} resource_cache_entry;
+
+// The number of asynchronous loads outstanding at once if not configured.
+#define RESOURCE_DEFAULT_MAX_REQUEST_COUNT 256
+
+// An asynchronous load of a resource.
+typedef struct resource_request_entry {
+    // Incremented each time the slot is freed, so stale handles are detected. Never 0.
+    u32 generation;
+    resource_request_status status;
+    // The name and params, copied as the caller's may go before the load starts.
+    char *name;
+    resource_type type;
+    void *params;
+    u64 params_size;
+    // The resource, once loaded. Acquired from the cache, and released along with the request.
+    const resource *resource;
+    pfn_resource_request_complete callback;
+    void *listener;
+    // Set if released while pending, so the load releases it once complete.
+    b8 released;
+    b8 in_use;
+    u32 next_free;
+} resource_request_entry;
+
 typedef struct resource_system_state {
     resource_system_config config;
     resource_loader *registered_loaders;
+    // The index of the loader of each built-in type, or INVALID_ID.
+    u32 type_loaders[RESOURCE_TYPE_CUSTOM];
+
+    // The cache of shared resources, by key. All of it is guarded by cache_mutex.
+    resource_cache_entry *cache_entries;
+    hashmap cache_map;
+    u32 cache_free_head;
+    u32 lru_head;
+    u32 lru_tail;
+    // Signaled whenever a load into the cache finishes.
+    kcondvar cache_condvar;
+    kmutex cache_mutex;
+    resource_cache_stats cache_stats;
+
+    // Asynchronous loads, guarded by request_mutex.
+    resource_request_entry *requests;
+    u32 request_free_head;
+    // Signaled whenever an asynchronous load completes.
+    kcondvar request_condvar;
+    kmutex request_mutex;
+    // Mounted archives. Later ones take precedence over earlier ones.
+    kpak_archive archives[RESOURCE_SYSTEM_MAX_ARCHIVES];
+    u32 archive_count;
+    // darray of watched resource files.
+    resource_watch *watches;
 } resource_system_state;
 
 static resource_system_state *state_ptr = 0;
 
 static b8 load(const char *name, resource_loader *loader, void *params,
                resource *out_resource);
+static void cache_detach_path(const char *full_path);
+static void cache_entry_unload(u32 index);
+static void request_entry_free(u32 index);
+static b8 archive_source_exists(const char *path, void *user_data);
+static b8 archive_source_read(const char *path, const u8 **out_data, u64 *out_size, b8 *out_owned, void *user_data);
+static b8 resource_system_on_watched_file(u16 code, void *sender, void *listener_inst, event_context context);
 
 b8 resource_system_initialize(u64 *memory_requirement, void *state,
                               void *config) {
@@ -36,9 +142,15 @@ b8 resource_system_initialize(u64 *memory_requirement, void *state,
         return false;
     }
 
-    *memory_requirement =
-        sizeof(resource_system_state) +
-        (sizeof(resource_loader) * typed_config->max_loader_count);
+    u64 loaders_size = sizeof(resource_loader) * typed_config->max_loader_count;
+    u64 entries_size = sizeof(resource_cache_entry) * typed_config->max_cached_resource_count;
+    u64 map_requirement = 0;
+    if (typed_config->max_cached_resource_count) {
+        hashmap_create(HASHMAP_KEY_TYPE_STRING, sizeof(u32), typed_config->max_cached_resource_count, &map_requirement, 0, 0);
+    }
+    u32 request_count = typed_config->max_request_count ? typed_config->max_request_count : RESOURCE_DEFAULT_MAX_REQUEST_COUNT;
+    u64 requests_size = sizeof(resource_request_entry) * request_count;
+    *memory_requirement = sizeof(resource_system_state) + loaders_size + entries_size + map_requirement + requests_size;
 
     if (!state) {
         return true;
@@ -46,6 +158,7 @@ b8 resource_system_initialize(u64 *memory_requirement, void *state,
 
     state_ptr = state;
     state_ptr->config = *typed_config;
+    state_ptr->config.max_request_count = request_count;
 
     void *array_block = state + sizeof(resource_system_state);
     state_ptr->registered_loaders = array_block;
@@ -55,6 +168,45 @@ b8 resource_system_initialize(u64 *memory_requirement, void *state,
     for (u32 i = 0; i < count; ++i) {
         state_ptr->registered_loaders[i].id = INVALID_ID;
     }
+    for (u32 i = 0; i < RESOURCE_TYPE_CUSTOM; ++i) {
+        state_ptr->type_loaders[i] = INVALID_ID;
+    }
+
+    // Set up the cache, with every slot free.
+    state_ptr->cache_entries = 0;
+    state_ptr->cache_free_head = INVALID_ID;
+    state_ptr->lru_head = INVALID_ID;
+    state_ptr->lru_tail = INVALID_ID;
+    kzero_memory(&state_ptr->cache_stats, sizeof(resource_cache_stats));
+    if (typed_config->max_cached_resource_count) {
+        state_ptr->cache_entries = (void *)((u8 *)array_block + loaders_size);
+        kzero_memory(state_ptr->cache_entries, entries_size);
+        for (u32 i = 0; i < typed_config->max_cached_resource_count; ++i) {
+            state_ptr->cache_entries[i].next_free = i + 1 < typed_config->max_cached_resource_count ? i + 1 : INVALID_ID;
+        }
+        state_ptr->cache_free_head = 0;
+        void *map_block = (u8 *)state_ptr->cache_entries + entries_size;
+        if (!hashmap_create(HASHMAP_KEY_TYPE_STRING, sizeof(u32), typed_config->max_cached_resource_count, &map_requirement, map_block, &state_ptr->cache_map) ||
+            !kmutex_create(&state_ptr->cache_mutex) || !kcondvar_create(&state_ptr->cache_condvar)) {
+            KERROR("resource_system_initialize - failed to create the resource cache.");
+            return false;
+        }
+        kmutex_name_set(&state_ptr->cache_mutex, "resource cache");
+    }
+
+    // Set up the asynchronous loads, with every slot free.
+    state_ptr->requests = (void *)((u8 *)array_block + loaders_size + entries_size + map_requirement);
+    kzero_memory(state_ptr->requests, requests_size);
+    for (u32 i = 0; i < request_count; ++i) {
+        state_ptr->requests[i].generation = 1;
+        state_ptr->requests[i].next_free = i + 1 < request_count ? i + 1 : INVALID_ID;
+    }
+    state_ptr->request_free_head = 0;
+    if (!kmutex_create(&state_ptr->request_mutex) || !kcondvar_create(&state_ptr->request_condvar)) {
+        KERROR("resource_system_initialize - failed to create the asynchronous load requests.");
+        return false;
+    }
+    kmutex_name_set(&state_ptr->request_mutex, "resource requests");
 
     // NOTE: Auto-register known loader types here.
     resource_system_loader_register(text_resource_loader_create());
@@ -66,19 +218,136 @@ b8 resource_system_initialize(u64 *memory_requirement, void *state,
     resource_system_loader_register(bitmap_font_resource_loader_create());
     resource_system_loader_register(system_font_resource_loader_create());
     resource_system_loader_register(terrain_resource_loader_create());
+    resource_system_loader_register(particle_emitter_resource_loader_create());
+    resource_system_loader_register(skeletal_mesh_resource_loader_create());
+
+    // Mount the archive of the assets, if they have been packed. Loose files still take
+    // precedence over its entries, so assets can be worked on without repacking.
+    char archive_path[512];
+    string_format(archive_path, "%s%s", typed_config->asset_base_path, KPAK_EXTENSION);
+    if (filesystem_exists(archive_path)) {
+        resource_system_archive_mount(archive_path);
+    }
 
-    KINFO("Resource system initialized with base path '%s'.",
-          typed_config->asset_base_path);
+    if (state_ptr->config.hot_reload) {
+        state_ptr->watches = darray_create(resource_watch);
+        event_register(EVENT_CODE_WATCHED_FILE_WRITTEN, state_ptr, resource_system_on_watched_file);
+        event_register(EVENT_CODE_WATCHED_FILE_DELETED, state_ptr, resource_system_on_watched_file);
+    }
+
+    KINFO("Resource system initialized with base path '%s'%s.",
+          typed_config->asset_base_path, state_ptr->config.hot_reload ? ", hot reloading enabled" : "");
 
     return true;
 }
 
 void resource_system_shutdown(void *state) {
     if (state_ptr) {
+        // Requests still held are released, so their resources go with the cache below.
+        for (u32 i = 0; i < state_ptr->config.max_request_count; ++i) {
+            resource_request_entry *r = &state_ptr->requests[i];
+            if (r->in_use) {
+                if (r->status == RESOURCE_REQUEST_STATUS_PENDING) {
+                    KWARN("resource_system_shutdown - the load of '%s' is still pending.", r->name);
+                    continue;
+                }
+                request_entry_free(i);
+            }
+        }
+        kcondvar_destroy(&state_ptr->request_condvar);
+        kmutex_destroy(&state_ptr->request_mutex);
+        if (state_ptr->cache_entries) {
+            // Anything still acquired is unloaded regardless, since its loader is going away.
+            for (u32 i = 0; i < state_ptr->config.max_cached_resource_count; ++i) {
+                if (state_ptr->cache_entries[i].key) {
+                    cache_entry_unload(i);
+                }
+            }
+            hashmap_destroy(&state_ptr->cache_map);
+            kcondvar_destroy(&state_ptr->cache_condvar);
+            kmutex_destroy(&state_ptr->cache_mutex);
+            state_ptr->cache_entries = 0;
+        }
+        if (state_ptr->watches) {
+            event_unregister(EVENT_CODE_WATCHED_FILE_WRITTEN, state_ptr, resource_system_on_watched_file);
+            event_unregister(EVENT_CODE_WATCHED_FILE_DELETED, state_ptr, resource_system_on_watched_file);
+            u32 count = darray_length(state_ptr->watches);
+            for (u32 i = 0; i < count; ++i) {
+                resource_system_unwatch(i);
+            }
+            darray_destroy(state_ptr->watches);
+            state_ptr->watches = 0;
+        }
+        if (state_ptr->archive_count) {
+            filesystem_source_set(0);
+            for (u32 i = 0; i < state_ptr->archive_count; ++i) {
+                kpak_close(&state_ptr->archives[i]);
+            }
+            state_ptr->archive_count = 0;
+        }
         state_ptr = 0;
     }
 }
 
+b8 resource_system_update(void *state, struct frame_data *p_frame_data) {
+    if (!state_ptr || !state_ptr->watches) {
+        return true;
+    }
+
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        resource_watch *w = &state_ptr->watches[i];
+        if (!w->full_path) {
+            continue;
+        }
+
+        // A file saved by replacing it is briefly missing. Watch it again once it is back,
+        // which counts as a change since its new contents were never seen.
+        if (w->platform_watch_id == INVALID_ID) {
+            if (platform_watch_file(w->full_path, &w->platform_watch_id)) {
+                w->changed = true;
+            }
+        }
+
+        if (w->changed) {
+            w->changed = false;
+            KINFO("Resource file '%s' changed, reloading.", w->full_path);
+            // Cached copies are out of date, so the next acquisition loads it afresh.
+            cache_detach_path(w->full_path);
+            event_context context = {0};
+            context.data.u32[0] = i;
+            event_fire(EVENT_CODE_WATCHED_RESOURCE_CHANGED, 0, context);
+        }
+    }
+
+    return true;
+}
+
+b8 resource_system_archive_mount(const char *path) {
+    if (!state_ptr || !path) {
+        return false;
+    }
+    if (state_ptr->archive_count >= RESOURCE_SYSTEM_MAX_ARCHIVES) {
+        KERROR("resource_system_archive_mount - Unable to mount '%s', the maximum of %u archives are already mounted.", path, RESOURCE_SYSTEM_MAX_ARCHIVES);
+        return false;
+    }
+
+    kpak_archive *archive = &state_ptr->archives[state_ptr->archive_count];
+    if (!kpak_open(path, archive)) {
+        KERROR("resource_system_archive_mount - Failed to open archive '%s'.", path);
+        return false;
+    }
+    state_ptr->archive_count++;
+
+    filesystem_source archive_source = {0};
+    archive_source.exists = archive_source_exists;
+    archive_source.read = archive_source_read;
+    filesystem_source_set(&archive_source);
+
+    KINFO("Mounted archive '%s' with %u entries.", path, archive->entry_count);
+    return true;
+}
+
 b8 resource_system_loader_register(resource_loader loader) {
     if (state_ptr) {
         u32 count = state_ptr->config.max_loader_count;
@@ -107,6 +376,9 @@ b8 resource_system_loader_register(resource_loader loader) {
             if (state_ptr->registered_loaders[i].id == INVALID_ID) {
                 state_ptr->registered_loaders[i] = loader;
                 state_ptr->registered_loaders[i].id = i;
+                if (loader.type < RESOURCE_TYPE_CUSTOM) {
+                    state_ptr->type_loaders[loader.type] = i;
+                }
                 KTRACE("Loader registered.");
                 return true;
             }
@@ -116,17 +388,44 @@ b8 resource_system_loader_register(resource_loader loader) {
     return false;
 }
 
+b8 resource_system_loader_rebind(resource_loader loader) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    u32 count = state_ptr->config.max_loader_count;
+    for (u32 i = 0; i < count; ++i) {
+        resource_loader *l = &state_ptr->registered_loaders[i];
+        if (l->id == INVALID_ID) {
+            continue;
+        }
+        b8 custom = loader.custom_type && string_length(loader.custom_type) > 0;
+        if ((custom && l->custom_type && strings_equali(l->custom_type, loader.custom_type)) || (!custom && l->type == loader.type)) {
+            *l = loader;
+            l->id = i;
+            KTRACE("Loader rebound.");
+            return true;
+        }
+    }
+
+    KERROR("resource_system_loader_rebind - No loader of type %d is registered to be rebound.", loader.type);
+    return false;
+}
+
+// Obtains the loader of a built-in resource type, or 0 if there is none.
+static resource_loader *loader_for_type(resource_type type) {
+    if (!state_ptr || type >= RESOURCE_TYPE_CUSTOM || state_ptr->type_loaders[type] == INVALID_ID) {
+        return 0;
+    }
+    return &state_ptr->registered_loaders[state_ptr->type_loaders[type]];
+}
+
 b8 resource_system_load(const char *name, resource_type type, void *params,
                         resource *out_resource) {
-    if (state_ptr && type != RESOURCE_TYPE_CUSTOM) {
-        // Select loader.
-        u32 count = state_ptr->config.max_loader_count;
-        for (u32 i = 0; i < count; ++i) {
-            resource_loader *l = &state_ptr->registered_loaders[i];
-            if (l->id != INVALID_ID && l->type == type) {
-                return load(name, l, params, out_resource);
-            }
-        }
+    KPROFILE_FUNCTION();
+    resource_loader *l = loader_for_type(type);
+    if (l) {
+        return load(name, l, params, out_resource);
     }
 
     out_resource->loader_id = INVALID_ID;
@@ -134,20 +433,427 @@ b8 resource_system_load(const char *name, resource_type type, void *params,
     return false;
 }
 
+// NOTE: Begin resource cache.
+
+// Hashes the bytes of a loader's params, which are part of the cache key.
+static u64 params_hash(const void *params, u64 size) {
+    u64 hash = 0xCBF29CE484222325ull;
+    for (u64 i = 0; params && i < size; ++i) {
+        hash ^= ((const u8 *)params)[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// The size of a resource's data in bytes, as counted against the cache budget. For most types
+// data_size is in bytes, but not for all.
+static u64 resource_data_size(resource_type type, const resource *r) {
+    switch (type) {
+        case RESOURCE_TYPE_IMAGE: {
+            const image_resource_data *image = r->data;
+            return sizeof(image_resource_data) + (image ? image->pixels_size : 0);
+        }
+        case RESOURCE_TYPE_MESH: {
+            // data_size is the number of geometries.
+            u64 size = sizeof(geometry_config) * r->data_size;
+            const geometry_config *configs = r->data;
+            for (u64 i = 0; configs && i < r->data_size; ++i) {
+                size += (u64)configs[i].vertex_size * configs[i].vertex_count + (u64)configs[i].index_size * configs[i].index_count;
+            }
+            return size;
+        }
+        default:
+            return r->data_size;
+    }
+}
+
+static void lru_remove(u32 index) {
+    resource_cache_entry *e = &state_ptr->cache_entries[index];
+    if (e->lru_prev != INVALID_ID) {
+        state_ptr->cache_entries[e->lru_prev].lru_next = e->lru_next;
+    } else {
+        state_ptr->lru_head = e->lru_next;
+    }
+    if (e->lru_next != INVALID_ID) {
+        state_ptr->cache_entries[e->lru_next].lru_prev = e->lru_prev;
+    } else {
+        state_ptr->lru_tail = e->lru_prev;
+    }
+    e->lru_prev = INVALID_ID;
+    e->lru_next = INVALID_ID;
+    state_ptr->cache_stats.unreferenced_bytes -= e->size;
+}
+
+static void lru_push_front(u32 index) {
+    resource_cache_entry *e = &state_ptr->cache_entries[index];
+    e->lru_prev = INVALID_ID;
+    e->lru_next = state_ptr->lru_head;
+    if (state_ptr->lru_head != INVALID_ID) {
+        state_ptr->cache_entries[state_ptr->lru_head].lru_prev = index;
+    } else {
+        state_ptr->lru_tail = index;
+    }
+    state_ptr->lru_head = index;
+    state_ptr->cache_stats.unreferenced_bytes += e->size;
+}
+
+// Unloads the resource of an entry, if it loaded, and frees its slot. Must hold the cache mutex.
+static void cache_entry_unload(u32 index) {
+    resource_cache_entry *e = &state_ptr->cache_entries[index];
+    if (!e->detached) {
+        hashmap_remove(&state_ptr->cache_map, e->key);
+    }
+    if (e->loaded) {
+        resource_system_unload(&e->resource);
+        state_ptr->cache_stats.resident_bytes -= e->size;
+    }
+    string_free(e->key);
+    string_free(e->name);
+    kzero_memory(e, sizeof(resource_cache_entry));
+    e->next_free = state_ptr->cache_free_head;
+    state_ptr->cache_free_head = index;
+    state_ptr->cache_stats.resource_count--;
+}
+
+// Drops a reference to an entry. Once unreferenced it is kept for reuse, unless it failed to
+// load or is out of date. Must hold the cache mutex.
+static void cache_entry_unreference(u32 index) {
+    resource_cache_entry *e = &state_ptr->cache_entries[index];
+    if (--e->reference_count > 0) {
+        return;
+    }
+    if (!e->loaded || e->detached) {
+        cache_entry_unload(index);
+        return;
+    }
+    lru_push_front(index);
+
+    // Unload the least recently used until back within the budget.
+    while (state_ptr->cache_stats.unreferenced_bytes > state_ptr->config.cache_budget && state_ptr->lru_tail != INVALID_ID) {
+        u32 victim = state_ptr->lru_tail;
+        lru_remove(victim);
+        cache_entry_unload(victim);
+        state_ptr->cache_stats.evictions++;
+    }
+}
+
+static void cache_detach_path(const char *full_path) {
+    if (!state_ptr->cache_entries) {
+        return;
+    }
+    kmutex_lock(&state_ptr->cache_mutex);
+    for (u32 i = 0; i < state_ptr->config.max_cached_resource_count; ++i) {
+        resource_cache_entry *e = &state_ptr->cache_entries[i];
+        if (!e->key || e->detached || !e->loaded || !e->resource.full_path || !strings_equal(e->resource.full_path, full_path)) {
+            continue;
+        }
+        if (e->reference_count == 0) {
+            lru_remove(i);
+            cache_entry_unload(i);
+        } else {
+            // Still in use, so it goes once released. Acquisitions from now on load it again.
+            hashmap_remove(&state_ptr->cache_map, e->key);
+            e->detached = true;
+        }
+    }
+    kmutex_unlock(&state_ptr->cache_mutex);
+}
+
+// Loads a resource outside of the cache, for when it is disabled or full. Released like any other.
+static b8 acquire_uncached(const char *name, resource_loader *l, const void *params, const resource **out_resource) {
+    resource *r = kallocate(sizeof(resource), MEMORY_TAG_RESOURCE);
+    if (!load(name, l, (void *)params, r)) {
+        kfree(r, sizeof(resource), MEMORY_TAG_RESOURCE);
+        return false;
+    }
+    *out_resource = r;
+    return true;
+}
+
+b8 resource_system_acquire(const char *name, resource_type type, const void *params, u64 params_size, const resource **out_resource) {
+    KPROFILE_FUNCTION();
+    *out_resource = 0;
+    resource_loader *l = loader_for_type(type);
+    if (!l || !name) {
+        KERROR("resource_system_acquire - No loader for type %d was found.", type);
+        return false;
+    }
+
+    char key[RESOURCE_CACHE_MAX_KEY_LENGTH];
+    if (!state_ptr->cache_entries || string_length(name) + 32 >= RESOURCE_CACHE_MAX_KEY_LENGTH) {
+        return acquire_uncached(name, l, params, out_resource);
+    }
+    string_format(key, "%u:%016llx:%s", type, params_hash(params, params_size), name);
+
+    kmutex_lock(&state_ptr->cache_mutex);
+    u32 index = INVALID_ID;
+    if (hashmap_get(&state_ptr->cache_map, key, &index)) {
+        resource_cache_entry *e = &state_ptr->cache_entries[index];
+        if (e->reference_count++ == 0 && e->loaded) {
+            lru_remove(index);
+        }
+        if (e->loading) {
+            // Someone else is loading it, so wait for that rather than load it twice.
+            state_ptr->cache_stats.coalesced++;
+            while (e->loading) {
+                kcondvar_wait(&state_ptr->cache_condvar, &state_ptr->cache_mutex);
+            }
+        } else {
+            state_ptr->cache_stats.hits++;
+        }
+        b8 loaded = e->loaded;
+        if (loaded) {
+            *out_resource = &e->resource;
+        } else {
+            cache_entry_unreference(index);
+        }
+        kmutex_unlock(&state_ptr->cache_mutex);
+        return loaded;
+    }
+
+    // Not cached, so take a slot, making room by dropping the least recently used if need be.
+    if (state_ptr->cache_free_head == INVALID_ID && state_ptr->lru_tail != INVALID_ID) {
+        u32 victim = state_ptr->lru_tail;
+        lru_remove(victim);
+        cache_entry_unload(victim);
+        state_ptr->cache_stats.evictions++;
+    }
+    index = state_ptr->cache_free_head;
+    if (index == INVALID_ID) {
+        kmutex_unlock(&state_ptr->cache_mutex);
+        KWARN("resource_system_acquire - The cache is full of resources in use, so '%s' is loaded outside of it.", name);
+        return acquire_uncached(name, l, params, out_resource);
+    }
+    resource_cache_entry *e = &state_ptr->cache_entries[index];
+    state_ptr->cache_free_head = e->next_free;
+    e->next_free = INVALID_ID;
+    e->key = string_duplicate(key);
+    e->name = string_duplicate(name);
+    e->reference_count = 1;
+    e->loading = true;
+    e->lru_prev = INVALID_ID;
+    e->lru_next = INVALID_ID;
+    hashmap_set(&state_ptr->cache_map, key, &index);
+    state_ptr->cache_stats.resource_count++;
+    state_ptr->cache_stats.misses++;
+    kmutex_unlock(&state_ptr->cache_mutex);
+
+    // Load without holding the lock, so other resources can be acquired meanwhile.
+    resource loaded_resource = {0};
+    b8 result = load(e->name, l, (void *)params, &loaded_resource);
+    // The name is the cache's own copy, since the caller's may not outlive the resource.
+    loaded_resource.name = e->name;
+
+    kmutex_lock(&state_ptr->cache_mutex);
+    e->resource = loaded_resource;
+    e->loading = false;
+    e->loaded = result;
+    if (result) {
+        e->size = resource_data_size(type, &e->resource);
+        state_ptr->cache_stats.resident_bytes += e->size;
+        *out_resource = &e->resource;
+    } else {
+        // Taken out of the map, so the next acquisition tries again rather than finding the failure.
+        hashmap_remove(&state_ptr->cache_map, e->key);
+        e->detached = true;
+        cache_entry_unreference(index);
+    }
+    kcondvar_broadcast(&state_ptr->cache_condvar);
+    kmutex_unlock(&state_ptr->cache_mutex);
+    return result;
+}
+
+void resource_system_release(const resource *r) {
+    if (!state_ptr || !r) {
+        return;
+    }
+    resource_cache_entry *entries = state_ptr->cache_entries;
+    if (!entries || (const u8 *)r < (const u8 *)entries || (const u8 *)r >= (const u8 *)(entries + state_ptr->config.max_cached_resource_count)) {
+        // Loaded outside of the cache.
+        resource_system_unload((resource *)r);
+        kfree((resource *)r, sizeof(resource), MEMORY_TAG_RESOURCE);
+        return;
+    }
+
+    u32 index = (u32)(((const u8 *)r - (const u8 *)entries) / sizeof(resource_cache_entry));
+    kmutex_lock(&state_ptr->cache_mutex);
+    cache_entry_unreference(index);
+    kmutex_unlock(&state_ptr->cache_mutex);
+}
+
+void resource_system_cache_stats_get(resource_cache_stats *out_stats) {
+    if (!state_ptr || !out_stats) {
+        return;
+    }
+    if (!state_ptr->cache_entries) {
+        kzero_memory(out_stats, sizeof(resource_cache_stats));
+        return;
+    }
+    kmutex_lock(&state_ptr->cache_mutex);
+    *out_stats = state_ptr->cache_stats;
+    kmutex_unlock(&state_ptr->cache_mutex);
+}
+
+// NOTE: End resource cache.
+
+// NOTE: Begin asynchronous loads.
+
+// Obtains the request of the given handle, or 0 if it is stale. Must hold the request mutex.
+static resource_request_entry *request_entry_get(resource_request request) {
+    if (!state_ptr || !request.generation || request.index >= state_ptr->config.max_request_count) {
+        return 0;
+    }
+    resource_request_entry *r = &state_ptr->requests[request.index];
+    return r->in_use && !r->released && r->generation == request.generation ? r : 0;
+}
+
+// Releases the resource of a request, if loaded, and frees its slot. Must hold the request mutex.
+static void request_entry_free(u32 index) {
+    resource_request_entry *r = &state_ptr->requests[index];
+    if (r->resource) {
+        resource_system_release(r->resource);
+    }
+    string_free(r->name);
+    if (r->params) {
+        kfree(r->params, r->params_size, MEMORY_TAG_RESOURCE);
+    }
+    u32 generation = r->generation + 1;
+    kzero_memory(r, sizeof(resource_request_entry));
+    r->generation = generation ? generation : 1;
+    r->next_free = state_ptr->request_free_head;
+    state_ptr->request_free_head = index;
+}
+
+static b8 request_job_start(void *params, void *result_data) {
+    resource_request request = *(resource_request *)params;
+    resource_request_entry *r = &state_ptr->requests[request.index];
+
+    // The name and params are not changed while pending, so can be read without the lock.
+    const resource *loaded = 0;
+    b8 result = resource_system_acquire(r->name, r->type, r->params, r->params_size, &loaded);
+
+    kmutex_lock(&state_ptr->request_mutex);
+    r->resource = loaded;
+    r->status = result ? RESOURCE_REQUEST_STATUS_LOADED : RESOURCE_REQUEST_STATUS_FAILED;
+    if (r->released) {
+        request_entry_free(request.index);
+    }
+    kcondvar_broadcast(&state_ptr->request_condvar);
+    kmutex_unlock(&state_ptr->request_mutex);
+
+    kcopy_memory(result_data, &request, sizeof(resource_request));
+    return result;
+}
+
+// Invoked on the main thread, whether the load succeeded or not.
+static void request_job_complete(void *result_data) {
+    resource_request request = *(resource_request *)result_data;
+
+    kmutex_lock(&state_ptr->request_mutex);
+    resource_request_entry *r = request_entry_get(request);
+    pfn_resource_request_complete callback = r ? r->callback : 0;
+    void *listener = r ? r->listener : 0;
+    const resource *loaded = r ? r->resource : 0;
+    kmutex_unlock(&state_ptr->request_mutex);
+
+    if (callback) {
+        callback(request, loaded, listener);
+    }
+}
+
+resource_request resource_system_load_async(const char *name, resource_type type, const void *params, u64 params_size, pfn_resource_request_complete callback, void *listener) {
+    resource_request request = {0};
+    if (!state_ptr || !name) {
+        return request;
+    }
+
+    kmutex_lock(&state_ptr->request_mutex);
+    u32 index = state_ptr->request_free_head;
+    if (index == INVALID_ID) {
+        kmutex_unlock(&state_ptr->request_mutex);
+        KERROR("resource_system_load_async - Too many loads are outstanding to load '%s'. Raise max_request_count.", name);
+        return request;
+    }
+    resource_request_entry *r = &state_ptr->requests[index];
+    state_ptr->request_free_head = r->next_free;
+    r->next_free = INVALID_ID;
+    r->in_use = true;
+    r->status = RESOURCE_REQUEST_STATUS_PENDING;
+    r->name = string_duplicate(name);
+    r->type = type;
+    if (params && params_size) {
+        r->params = kallocate(params_size, MEMORY_TAG_RESOURCE);
+        kcopy_memory(r->params, params, params_size);
+        r->params_size = params_size;
+    }
+    r->callback = callback;
+    r->listener = listener;
+    request.index = index;
+    request.generation = r->generation;
+    kmutex_unlock(&state_ptr->request_mutex);
+
+    // Loads mostly wait on the disk, so they go to the resource load threads.
+    job_info job = job_create_type(request_job_start, request_job_complete, request_job_complete, &request, sizeof(resource_request), sizeof(resource_request), JOB_TYPE_RESOURCE_LOAD);
+    job_system_submit(job);
+    return request;
+}
+
+resource_request_status resource_request_status_get(resource_request request) {
+    if (!state_ptr) {
+        return RESOURCE_REQUEST_STATUS_INVALID;
+    }
+    kmutex_lock(&state_ptr->request_mutex);
+    resource_request_entry *r = request_entry_get(request);
+    resource_request_status status = r ? r->status : RESOURCE_REQUEST_STATUS_INVALID;
+    kmutex_unlock(&state_ptr->request_mutex);
+    return status;
+}
+
+const resource *resource_request_wait(resource_request request) {
+    if (!state_ptr) {
+        return 0;
+    }
+    kmutex_lock(&state_ptr->request_mutex);
+    resource_request_entry *r = request_entry_get(request);
+    while (r && r->status == RESOURCE_REQUEST_STATUS_PENDING) {
+        kcondvar_wait(&state_ptr->request_condvar, &state_ptr->request_mutex);
+        // Released by another thread meanwhile makes the handle stale.
+        r = request_entry_get(request);
+    }
+    const resource *loaded = r ? r->resource : 0;
+    kmutex_unlock(&state_ptr->request_mutex);
+    return loaded;
+}
+
+void resource_request_release(resource_request request) {
+    if (!state_ptr) {
+        return;
+    }
+    kmutex_lock(&state_ptr->request_mutex);
+    resource_request_entry *r = request_entry_get(request);
+    if (r) {
+        if (r->status == RESOURCE_REQUEST_STATUS_PENDING) {
+            // The load frees it once done.
+            r->released = true;
+        } else {
+            request_entry_free(request.index);
+        }
+    }
+    kmutex_unlock(&state_ptr->request_mutex);
+}
+
+// NOTE: End asynchronous loads.
+
 const char *resource_system_base_path_for_type(resource_type type) {
     if (state_ptr && type != RESOURCE_TYPE_CUSTOM) {
-        // Select loader.
-        u32 count = state_ptr->config.max_loader_count;
-        for (u32 i = 0; i < count; ++i) {
-            resource_loader *l = &state_ptr->registered_loaders[i];
-            if (l->id != INVALID_ID && l->type == type) {
-                u32 type_length = string_length(l->type_path);
-                u32 base_length = string_length(state_ptr->config.asset_base_path);
-                u32 total_length = type_length + base_length + 3;
-                char *combined_path = kallocate(sizeof(char) * total_length, MEMORY_TAG_STRING);
-                string_format(combined_path, "%s/%s/", state_ptr->config.asset_base_path, l->type_path);
-                return combined_path;
-            }
+        resource_loader *l = loader_for_type(type);
+        if (l) {
+            u32 type_length = string_length(l->type_path);
+            u32 base_length = string_length(state_ptr->config.asset_base_path);
+            u32 total_length = type_length + base_length + 3;
+            char *combined_path = kallocate(sizeof(char) * total_length, MEMORY_TAG_STRING);
+            string_format(combined_path, "%s/%s/", state_ptr->config.asset_base_path, l->type_path);
+            return combined_path;
         }
         KERROR("Attempted to query for base asset path for unrecognized type. Null will be returned.");
         return 0;
@@ -197,6 +903,132 @@ const char *resource_system_base_path(void) {
     return "";
 }
 
+b8 resource_system_hot_reload_enabled(void) {
+    return state_ptr && state_ptr->config.hot_reload;
+}
+
+b8 resource_system_watch(const char *full_path, u32 *out_watch_id) {
+    *out_watch_id = INVALID_ID;
+    if (!state_ptr || !state_ptr->watches || !full_path) {
+        return false;
+    }
+
+    resource_watch w = {0};
+    if (!platform_watch_file(full_path, &w.platform_watch_id)) {
+        // Not on disk, so there is nothing to watch.
+        return false;
+    }
+    w.full_path = string_duplicate(full_path);
+
+    // Reuse a free slot if there is one.
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (!state_ptr->watches[i].full_path) {
+            state_ptr->watches[i] = w;
+            *out_watch_id = i;
+            return true;
+        }
+    }
+    darray_push(state_ptr->watches, w);
+    *out_watch_id = count;
+    return true;
+}
+
+void resource_system_unwatch(u32 watch_id) {
+    if (!state_ptr || !state_ptr->watches || watch_id >= darray_length(state_ptr->watches)) {
+        return;
+    }
+
+    resource_watch *w = &state_ptr->watches[watch_id];
+    if (!w->full_path) {
+        return;
+    }
+    if (w->platform_watch_id != INVALID_ID) {
+        platform_unwatch_file(w->platform_watch_id);
+    }
+    string_free(w->full_path);
+    kzero_memory(w, sizeof(resource_watch));
+    w->platform_watch_id = INVALID_ID;
+}
+
+static b8 resource_system_on_watched_file(u16 code, void *sender, void *listener_inst, event_context context) {
+    u32 platform_watch_id = context.data.u32[0];
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        resource_watch *w = &state_ptr->watches[i];
+        if (w->full_path && w->platform_watch_id == platform_watch_id) {
+            if (code == EVENT_CODE_WATCHED_FILE_WRITTEN) {
+                w->changed = true;
+            } else {
+                // The platform has dropped the watch. The update watches it again if it comes back.
+                w->platform_watch_id = INVALID_ID;
+            }
+            return true;
+        }
+    }
+
+    // Not a resource watch, so leave it to other listeners.
+    return false;
+}
+
+// Converts a path under the asset base path to the name of an archive entry, which is relative
+// to the base path with single '/' separators. Returns false for paths outside of the base path.
+static b8 archive_entry_name(const char *path, char *out_name, u32 max_length) {
+    const char *base_path = state_ptr->config.asset_base_path;
+    u32 base_length = string_length(base_path);
+    if (!strings_nequal(path, base_path, base_length) || (path[base_length] != '/' && path[base_length] != '\\')) {
+        return false;
+    }
+
+    u32 length = 0;
+    for (const char *c = path + base_length; *c; ++c) {
+        char ch = *c == '\\' ? '/' : *c;
+        // Skip leading and repeated separators, as paths are often joined with extra ones.
+        if (ch == '/' && (length == 0 || out_name[length - 1] == '/')) {
+            continue;
+        }
+        if (length + 1 >= max_length) {
+            return false;
+        }
+        out_name[length++] = ch;
+    }
+    out_name[length] = 0;
+    return length > 0;
+}
+
+static const kpak_entry *archive_entry_find(const char *path, const kpak_archive **out_archive) {
+    if (!state_ptr) {
+        return 0;
+    }
+    char name[512];
+    if (!archive_entry_name(path, name, 512)) {
+        return 0;
+    }
+    for (i32 i = (i32)state_ptr->archive_count - 1; i >= 0; --i) {
+        const kpak_entry *entry = kpak_find(&state_ptr->archives[i], name);
+        if (entry) {
+            *out_archive = &state_ptr->archives[i];
+            return entry;
+        }
+    }
+    return 0;
+}
+
+static b8 archive_source_exists(const char *path, void *user_data) {
+    const kpak_archive *archive;
+    return archive_entry_find(path, &archive) != 0;
+}
+
+static b8 archive_source_read(const char *path, const u8 **out_data, u64 *out_size, b8 *out_owned, void *user_data) {
+    const kpak_archive *archive;
+    const kpak_entry *entry = archive_entry_find(path, &archive);
+    if (!entry || !kpak_entry_read(archive, entry, out_data, out_owned)) {
+        return false;
+    }
+    *out_size = entry->uncompressed_size;
+    return true;
+}
+
 static b8 load(const char *name, resource_loader *loader, void *params,
                resource *out_resource) {
     if (!name || !loader || !loader->load || !out_resource) {
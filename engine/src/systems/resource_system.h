@@ -15,14 +15,79 @@
 
 #include "resources/resource_types.h"
 
+struct frame_data;
+
 /** @brief The configuration for the resource system */
 typedef struct resource_system_config {
     /** @brief The maximum number of loaders that can be registered with this system. */
     u32 max_loader_count;
     /** @brief The relative base path for assets. */
     char* asset_base_path;
+    /**
+     * @brief Indicates if the files of loaded resources are watched, so that systems may reload
+     * them in place when changed. Each watched file is checked every frame, so this is meant for development.
+     */
+    b8 hot_reload;
+    /** @brief The most resources the cache holds at once (see resource_system_acquire). 0 disables the cache. */
+    u32 max_cached_resource_count;
+    /**
+     * @brief The most bytes of resource data the cache keeps resident once no longer referenced,
+     * so it can be handed out again without loading. The least recently released go first.
+     */
+    u64 cache_budget;
+    /** @brief The most asynchronous loads which may be outstanding at once (see resource_system_load_async). 0 defaults to 256. */
+    u32 max_request_count;
 } resource_system_config;
 
+/**
+ * @brief A handle to an asynchronous load of a resource. A zeroed-out handle is invalid (i.e. no
+ * request), as is one whose request has been released.
+ */
+typedef struct resource_request {
+    /** @brief The index of the request within the resource system. */
+    u32 index;
+    /** @brief The generation of the request, used to detect stale handles. 0 is invalid. */
+    u32 generation;
+} resource_request;
+
+/** @brief The status of an asynchronous load of a resource. */
+typedef enum resource_request_status {
+    /** @brief The handle is invalid, or its request has been released. */
+    RESOURCE_REQUEST_STATUS_INVALID,
+    /** @brief The resource is still loading. */
+    RESOURCE_REQUEST_STATUS_PENDING,
+    /** @brief The resource loaded, and is held by the request until it is released. */
+    RESOURCE_REQUEST_STATUS_LOADED,
+    /** @brief The resource failed to load. */
+    RESOURCE_REQUEST_STATUS_FAILED
+} resource_request_status;
+
+/**
+ * @brief A function invoked on the main thread once an asynchronous load completes.
+ * @param request The handle of the request, which remains to be released.
+ * @param resource A pointer to the resource held by the request, or 0 if it failed to load.
+ * @param listener The listener given along with the request.
+ */
+typedef void (*pfn_resource_request_complete)(resource_request request, const resource* resource, void* listener);
+
+/** @brief Statistics of the resource cache. */
+typedef struct resource_cache_stats {
+    /** @brief The number of resources in the cache, whether referenced or not. */
+    u32 resource_count;
+    /** @brief The size of the data of every resource in the cache, in bytes. */
+    u64 resident_bytes;
+    /** @brief The size of the data of the resources in the cache no longer referenced, in bytes. */
+    u64 unreferenced_bytes;
+    /** @brief The number of acquisitions of resources already loaded. */
+    u64 hits;
+    /** @brief The number of acquisitions which had to load. */
+    u64 misses;
+    /** @brief The number of acquisitions which waited for another caller's load of the same resource. */
+    u64 coalesced;
+    /** @brief The number of unreferenced resources unloaded to keep within the budget. */
+    u64 evictions;
+} resource_cache_stats;
+
 /** @brief An "interface" for a resource loader. All registered loaders use this. */
 typedef struct resource_loader {
     /** @brief The loader identifier. */
@@ -70,6 +135,27 @@ b8 resource_system_initialize(u64* memory_requirement, void* state, void* config
  */
 void resource_system_shutdown(void* state);
 
+/**
+ * @brief Updates the resource system. Notifies listeners of watched resource files which have
+ * changed since the last update, at most once per file per update. Should be called once per frame.
+ *
+ * @param state The state block of memory for this system.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @return True on success; otherwise false.
+ */
+b8 resource_system_update(void* state, struct frame_data* p_frame_data);
+
+/**
+ * @brief Mounts the .kpak asset archive at the given path, so loaders read the assets packed
+ * in it as if they were loose files under the asset base path. Loose files still take precedence,
+ * and archives mounted later take precedence over those mounted earlier. The archive named for the
+ * asset base path (e.g. "../assets.kpak" for "../assets") is mounted automatically if it exists.
+ * NOTE: Not thread-safe. Archives should be mounted before resources are loaded on other threads.
+ * @param path The path of the archive.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 resource_system_archive_mount(const char* path);
+
 /**
  * @brief Registers the given resource loader with the system.
  *
@@ -79,7 +165,18 @@ void resource_system_shutdown(void* state);
 KAPI b8 resource_system_loader_register(resource_loader loader);
 
 /**
- * @brief Loads a resource of the given name.
+ * @brief Replaces the functions and paths of the registered loader of the same type as the one
+ * given, keeping its id. Used when the library a loader lives in is reloaded, so that resources
+ * already loaded through it are unloaded by the new code.
+ *
+ * @param loader The loader whose functions should replace the registered ones.
+ * @return True on success; false if no loader of the type is registered.
+ */
+KAPI b8 resource_system_loader_rebind(resource_loader loader);
+
+/**
+ * @brief Loads a resource of the given name. The resource belongs to the caller, which must
+ * unload it. See resource_system_acquire for resources shared through the cache.
  *
  * @param name The name of the resource to load.
  * @param type The type of resource to load.
@@ -89,6 +186,81 @@ KAPI b8 resource_system_loader_register(resource_loader loader);
  */
 KAPI b8 resource_system_load(const char* name, resource_type type, void* params, resource* out_resource);
 
+/**
+ * @brief Acquires a shared resource of the given name from the cache, loading it only if it is
+ * not already there. Callers asking for the same resource while it loads wait for that load
+ * rather than starting another. The resource stays loaded while acquired, and is kept in the
+ * cache for a while once released, within the cache budget. Thread-safe.
+ * NOTE: The resource is shared, so must not be changed or unloaded by the caller, only released.
+ *
+ * @param name The name of the resource.
+ * @param type The type of resource.
+ * @param params Parameters to be passed to the loader, or 0. Resources are cached by their type,
+ * name and the bytes of their params, so params must not hold pointers which differ between calls.
+ * @param params_size The size of params in bytes.
+ * @param out_resource A pointer to hold a pointer to the resource, valid until it is released.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 resource_system_acquire(const char* name, resource_type type, const void* params, u64 params_size, const resource** out_resource);
+
+/**
+ * @brief Releases a resource obtained from resource_system_acquire. Once no longer referenced,
+ * it stays cached until it is the least recently used and the cache is over budget.
+ *
+ * @param resource A pointer to the resource.
+ */
+KAPI void resource_system_release(const resource* resource);
+
+/**
+ * @brief Obtains the statistics of the resource cache.
+ *
+ * @param out_stats A pointer to hold the statistics.
+ */
+KAPI void resource_system_cache_stats_get(resource_cache_stats* out_stats);
+
+/**
+ * @brief Starts loading a resource in the background, on the resource load job threads. It is
+ * acquired from the cache (see resource_system_acquire), so loads of a resource already loaded or
+ * loading are shared. The request can be polled with resource_request_status_get or waited on
+ * with resource_request_wait, and the callback, if given, is invoked from the next job system
+ * update on the main thread after it completes. Either way, the request holds the resource until
+ * released with resource_request_release, which every request must eventually be.
+ *
+ * @param name The name of the resource. Copied.
+ * @param type The type of resource.
+ * @param params Parameters to be passed to the loader, or 0. Copied, so need not outlive the call.
+ * @param params_size The size of params in bytes.
+ * @param callback The function to invoke once the load completes. Optional.
+ * @param listener A pointer passed along to the callback. Optional.
+ * @return A handle to the request, which is invalid if too many are outstanding already.
+ */
+KAPI resource_request resource_system_load_async(const char* name, resource_type type, const void* params, u64 params_size, pfn_resource_request_complete callback, void* listener);
+
+/**
+ * @brief Obtains the status of an asynchronous load. Thread-safe.
+ *
+ * @param request The handle of the request.
+ * @return The status.
+ */
+KAPI resource_request_status resource_request_status_get(resource_request request);
+
+/**
+ * @brief Blocks until an asynchronous load completes. Thread-safe.
+ * NOTE: This blocks the calling thread outright, so should not be called from a resource load job.
+ *
+ * @param request The handle of the request.
+ * @return A pointer to the resource held by the request, or 0 if it failed to load or the handle is invalid.
+ */
+KAPI const resource* resource_request_wait(resource_request request);
+
+/**
+ * @brief Releases an asynchronous load along with the resource it holds, invalidating its handle.
+ * A request released while still pending is released once it completes, and its callback is not invoked.
+ *
+ * @param request The handle of the request. Invalid handles are ignored.
+ */
+KAPI void resource_request_release(resource_request request);
+
 /**
  * @brief Loads a resource of the given name and of a custom type.
  *
@@ -116,3 +288,28 @@ KAPI void resource_system_unload(resource* resource);
 
 /** @brief Returns the base path of the resource system. */
 KAPI const char* resource_system_base_path(void);
+
+/**
+ * @brief Indicates if resource files are watched for changes. See resource_system_config.hot_reload.
+ */
+KAPI b8 resource_system_hot_reload_enabled(void);
+
+/**
+ * @brief Starts watching the file of a loaded resource. Once the file changes, EVENT_CODE_WATCHED_RESOURCE_CHANGED
+ * is fired from the next update with the returned watch id. Files replaced by being deleted and written
+ * again, as many editors save them, keep being watched under the same id.
+ * NOTE: Does nothing and returns false if hot reloading is disabled, or for files which are not on disk
+ * (such as those in a mounted archive).
+ *
+ * @param full_path The path of the file, as found in resource.full_path.
+ * @param out_watch_id A pointer to hold the watch id. Set to INVALID_ID on failure.
+ * @return True if the file is now being watched; otherwise false.
+ */
+KAPI b8 resource_system_watch(const char* full_path, u32* out_watch_id);
+
+/**
+ * @brief Stops watching the file with the given watch id.
+ *
+ * @param watch_id The id obtained from resource_system_watch. INVALID_ID is ignored.
+ */
+KAPI void resource_system_unwatch(u32 watch_id);
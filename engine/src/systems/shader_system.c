@@ -1,6 +1,7 @@
 #include "shader_system.h"
 
 #include "containers/darray.h"
+#include "core/event.h"
 #include "core/frame_data.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
@@ -9,32 +10,63 @@
 #include "renderer/renderer_frontend.h"
 #include "renderer/renderer_utils.h"
 #include "resources/resource_types.h"
+#include "systems/job_system.h"
+#include "systems/resource_system.h"
 #include "systems/texture_system.h"
 
+// A shader stage file watched for hot reloading.
+typedef struct shader_watch {
+    // The resource system's watch of the stage file.
+    u32 watch_id;
+    // The id of the shader using the stage.
+    u32 shader_id;
+} shader_watch;
+
+// Also used as result_data from job.
+typedef struct shader_reload_params {
+    u32 shader_id;
+    // The name of the shader, to tell if its slot was reused before the job finished.
+    char* name;
+    u8 stage_count;
+    // Arrays of stage_count file names and the new sources read from them.
+    char** filenames;
+    char** sources;
+    u32* source_lengths;
+    // Set once the sources held are precompiled ones swapped out of the shader.
+    b8 precompiled;
+} shader_reload_params;
+
 // The internal shader system state.
 typedef struct shader_system_state {
     // This system's configuration.
     shader_system_config config;
-    // A lookup table for shader name->id
-    hashtable lookup;
+    // A lookup table for shader kname->id
+    hashmap lookup;
     // The memory used for the lookup table.
     void* lookup_memory;
-    // The identifier for the currently bound shader.
-    u32 current_shader_id;
     // A collection of created shaders.
     shader* shaders;
+    // darray of shader stage files watched for hot reloading.
+    shader_watch* watches;
 } shader_system_state;
 
 // A pointer to hold the internal system state.
 static shader_system_state* state_ptr = 0;
 
+// The identifier for the currently bound shader. Kept per-thread, since passes
+// may be recorded on several threads at once.
+static _Thread_local u32 current_shader_id = INVALID_ID;
+
 static b8 internal_attribute_add(shader* shader, const shader_attribute_config* config);
 static b8 internal_sampler_add(shader* shader, shader_uniform_config* config);
+static b8 internal_storage_add(shader* shader, shader_uniform_config* config);
 static u32 generate_new_shader_id(void);
 static b8 internal_uniform_add(shader* shader, const shader_uniform_config* config, u32 location);
 static b8 uniform_name_valid(shader* shader, const char* uniform_name);
 static b8 shader_uniform_add_state_valid(shader* shader);
 static void internal_shader_destroy(shader* s);
+static void shader_watches_add(shader* s);
+static b8 shader_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context);
 ///////////////////////
 
 b8 shader_system_initialize(u64* memory_requirement, void* memory, void* config) {
@@ -45,30 +77,29 @@ b8 shader_system_initialize(u64* memory_requirement, void* memory, void* config)
             KERROR("shader_system_initialize - config.max_shader_count must be greater than 0");
             return false;
         } else {
-            // This is to help avoid hashtable collisions.
             KWARN("shader_system_initialize - config.max_shader_count is recommended to be at least 512.");
         }
     }
 
-    // Figure out how large of a hashtable is needed.
-    // Block of memory will contain state structure then the block for the hashtable.
+    // Block of memory will contain state structure, then the block for the lookup, then the shader array.
     u64 struct_requirement = sizeof(shader_system_state);
-    u64 hashtable_requirement = sizeof(u32) * typed_config->max_shader_count;
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), typed_config->max_shader_count, &lookup_requirement, 0, 0);
     u64 shader_array_requirement = sizeof(shader) * typed_config->max_shader_count;
-    *memory_requirement = struct_requirement + hashtable_requirement + shader_array_requirement;
+    *memory_requirement = struct_requirement + lookup_requirement + shader_array_requirement;
 
     if (!memory) {
         return true;
     }
 
-    // Setup the state pointer, memory block, shader array, then create the hashtable.
+    // Setup the state pointer, memory block, shader array, then create the lookup.
     state_ptr = memory;
     u64 addr = (u64)memory;
     state_ptr->lookup_memory = (void*)(addr + struct_requirement);
-    state_ptr->shaders = (void*)((u64)state_ptr->lookup_memory + hashtable_requirement);
+    state_ptr->shaders = (void*)((u64)state_ptr->lookup_memory + lookup_requirement);
     state_ptr->config = *typed_config;
-    state_ptr->current_shader_id = INVALID_ID;
-    hashtable_create(sizeof(u32), typed_config->max_shader_count, state_ptr->lookup_memory, false, &state_ptr->lookup);
+    current_shader_id = INVALID_ID;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u32), typed_config->max_shader_count, &lookup_requirement, state_ptr->lookup_memory, &state_ptr->lookup);
 
     // Invalidate all shader ids.
     for (u32 i = 0; i < typed_config->max_shader_count; ++i) {
@@ -76,17 +107,15 @@ b8 shader_system_initialize(u64* memory_requirement, void* memory, void* config)
         state_ptr->shaders[i].render_frame_number = INVALID_ID_U64;
     }
 
-    // Fill the table with invalid ids.
-    u32 invalid_fill_id = INVALID_ID;
-    if (!hashtable_fill(&state_ptr->lookup, &invalid_fill_id)) {
-        KERROR("hashtable_fill failed.");
-        return false;
-    }
-
     for (u32 i = 0; i < state_ptr->config.max_shader_count; ++i) {
         state_ptr->shaders[i].id = INVALID_ID;
     }
 
+    if (resource_system_hot_reload_enabled()) {
+        state_ptr->watches = darray_create(shader_watch);
+        event_register(EVENT_CODE_WATCHED_RESOURCE_CHANGED, state_ptr, shader_system_on_resource_changed);
+    }
+
     return true;
 }
 
@@ -94,13 +123,22 @@ void shader_system_shutdown(void* state) {
     if (state) {
         // Destroy any shaders still in existence.
         shader_system_state* st = (shader_system_state*)state;
+        if (st->watches) {
+            event_unregister(EVENT_CODE_WATCHED_RESOURCE_CHANGED, st, shader_system_on_resource_changed);
+            u32 watch_count = darray_length(st->watches);
+            for (u32 i = 0; i < watch_count; ++i) {
+                resource_system_unwatch(st->watches[i].watch_id);
+            }
+            darray_destroy(st->watches);
+            st->watches = 0;
+        }
         for (u32 i = 0; i < st->config.max_shader_count; ++i) {
             shader* s = &st->shaders[i];
             if (s->id != INVALID_ID) {
                 internal_shader_destroy(s);
             }
         }
-        hashtable_destroy(&st->lookup);
+        hashmap_destroy(&st->lookup);
         kzero_memory(st, sizeof(shader_system_state));
     }
 
@@ -123,22 +161,21 @@ b8 shader_system_create(renderpass* pass, const shader_config* config) {
     out_shader->local_ubo_stride = 0;
     out_shader->bound_instance_id = INVALID_ID;
     out_shader->attribute_stride = 0;
+    out_shader->instance_attribute_stride = 0;
+    out_shader->packed_attribute_stride = 0;
 
     // Setup arrays
     out_shader->global_texture_maps = darray_create(texture_map*);
     out_shader->uniforms = darray_create(shader_uniform);
     out_shader->attributes = darray_create(shader_attribute);
+    out_shader->packed_attributes = darray_create(shader_attribute);
 
-    // Create a hashtable to store uniform array indexes. This provides a direct index into the
-    // 'uniforms' array stored in the shader for quick lookups by name.
-    u64 element_size = sizeof(u16);  // Indexes are stored as u16s.
-    u64 element_count = 1023;        // This is more uniforms than we will ever need, but a bigger table reduces collision chance.
-    out_shader->hashtable_block = kallocate(element_size * element_count, MEMORY_TAG_HASHTABLE);
-    hashtable_create(element_size, element_count, out_shader->hashtable_block, false, &out_shader->uniform_lookup);
-
-    // Invalidate all spots in the hashtable.
-    u32 invalid = INVALID_ID;
-    hashtable_fill(&out_shader->uniform_lookup, &invalid);
+    // Create a lookup to store uniform array indexes. This provides a direct index into the
+    // 'uniforms' array stored in the shader for quick lookups by kname.
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u16), state_ptr->config.max_uniform_count, &lookup_requirement, 0, 0);
+    out_shader->uniform_lookup_block = kallocate(lookup_requirement, MEMORY_TAG_HASHTABLE);
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u16), state_ptr->config.max_uniform_count, &lookup_requirement, out_shader->uniform_lookup_block, &out_shader->uniform_lookup);
 
     // A running total of the actual global uniform buffer object size.
     out_shader->global_ubo_size = 0;
@@ -154,6 +191,19 @@ b8 shader_system_create(renderpass* pass, const shader_config* config) {
     // Take a copy of the flags.
     out_shader->flags = config->flags;
 
+    // Specialization constants, and the default variant made from them.
+    out_shader->variants = darray_create(shader_variant);
+    shader_variant default_variant = {0};
+    out_shader->specialization_count = config->specialization_count;
+    for (u32 i = 0; i < config->specialization_count; ++i) {
+        shader_specialization* spec = &out_shader->specializations[i];
+        spec->name = kname_create(config->specializations[i].name);
+        spec->id = config->specializations[i].id;
+        spec->default_value = config->specializations[i].default_value;
+        default_variant.values[i] = spec->default_value;
+    }
+    darray_push(out_shader->variants, default_variant);
+
     if (!renderer_shader_create(out_shader, config, pass)) {
         KERROR("Error creating shader.");
         return false;
@@ -179,6 +229,11 @@ b8 shader_system_create(renderpass* pass, const shader_config* config) {
                 KERROR("Failed to add sampler '%s' to shader '%s'.", uc->name, config->name);
                 return false;
             }
+        } else if (uniform_type_is_storage(uc->type)) {
+            if (!internal_storage_add(out_shader, uc)) {
+                KERROR("Failed to add storage uniform '%s' to shader '%s'.", uc->name, config->name);
+                return false;
+            }
         } else {
             if (!internal_uniform_add(out_shader, uc, INVALID_ID)) {
                 KERROR("Failed to add uniform '%s' to shader '%s'.", uc->name, config->name);
@@ -194,24 +249,33 @@ b8 shader_system_create(renderpass* pass, const shader_config* config) {
         return false;
     }
 
-    // At this point, creation is successful, so store the shader id in the hashtable
+    // At this point, creation is successful, so store the shader id in the lookup
     // so this can be looked up by name later.
-    if (!hashtable_set(&state_ptr->lookup, config->name, &out_shader->id)) {
+    if (!hashmap_set_u64(&state_ptr->lookup, kname_create(config->name), &out_shader->id)) {
         // Dangit, we got so far... welp, nuke the shader and boot.
         renderer_shader_destroy(out_shader);
         return false;
     }
 
+    if (state_ptr->watches) {
+        shader_watches_add(out_shader);
+    }
+
     return true;
 }
 
 u32 shader_system_get_id(const char* shader_name) {
+    return shader_system_get_id_by_kname(kname_create(shader_name));
+}
+
+u32 shader_system_get_id_by_kname(kname shader_name) {
     u32 shader_id = INVALID_ID;
-    if (!hashtable_get(&state_ptr->lookup, shader_name, &shader_id)) {
-        KERROR("There is no shader registered named '%s'.", shader_name);
+    if (!hashmap_get_u64(&state_ptr->lookup, shader_name, &shader_id)) {
+        const char* name_str = kname_string_get(shader_name);
+        KERROR("There is no shader registered named '%s'.", name_str ? name_str : "<unknown>");
         return INVALID_ID;
     }
-    // KTRACE("Got id %u for shader named '%s'.", shader_id, shader_name);
+    // KTRACE("Got id %u for shader named '%s'.", shader_id, kname_string_get(shader_name));
     return shader_id;
 }
 
@@ -232,7 +296,11 @@ shader* shader_system_get_by_id(u32 shader_id) {
 }
 
 shader* shader_system_get(const char* shader_name) {
-    u32 shader_id = shader_system_get_id(shader_name);
+    return shader_system_get_by_kname(kname_create(shader_name));
+}
+
+shader* shader_system_get_by_kname(kname shader_name) {
+    u32 shader_id = shader_system_get_id_by_kname(shader_name);
     if (shader_id != INVALID_ID) {
         return shader_system_get_by_id(shader_id);
     }
@@ -240,6 +308,22 @@ shader* shader_system_get(const char* shader_name) {
 }
 
 static void internal_shader_destroy(shader* s) {
+    // Stop watching its stage files.
+    if (state_ptr && state_ptr->watches) {
+        u32 watch_count = darray_length(state_ptr->watches);
+        for (u32 i = 0; i < watch_count;) {
+            if (state_ptr->watches[i].shader_id == s->id) {
+                resource_system_unwatch(state_ptr->watches[i].watch_id);
+                // Order doesn't matter, so swap the last one into its place.
+                state_ptr->watches[i] = state_ptr->watches[watch_count - 1];
+                watch_count--;
+            } else {
+                i++;
+            }
+        }
+        darray_length_set(state_ptr->watches, watch_count);
+    }
+
     renderer_shader_destroy(s);
 
     // Set it to be unusable right away.
@@ -251,6 +335,32 @@ static void internal_shader_destroy(shader* s) {
     }
     darray_destroy(s->global_texture_maps);
 
+    shader_attribute* attribute_arrays[2] = {s->attributes, s->packed_attributes};
+    for (u32 a = 0; a < 2; ++a) {
+        if (attribute_arrays[a]) {
+            u32 attribute_count = darray_length(attribute_arrays[a]);
+            for (u32 i = 0; i < attribute_count; ++i) {
+                string_free(attribute_arrays[a][i].name);
+            }
+            darray_destroy(attribute_arrays[a]);
+        }
+    }
+    s->attributes = 0;
+    s->packed_attributes = 0;
+
+    if (s->variants) {
+        darray_destroy(s->variants);
+        s->variants = 0;
+    }
+
+    if (s->uniform_lookup_block) {
+        u64 lookup_requirement = 0;
+        hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(u16), state_ptr->config.max_uniform_count, &lookup_requirement, 0, 0);
+        hashmap_destroy(&s->uniform_lookup);
+        kfree(s->uniform_lookup_block, lookup_requirement, MEMORY_TAG_HASHTABLE);
+        s->uniform_lookup_block = 0;
+    }
+
     // Free the name.
     if (s->name) {
         u32 length = string_length(s->name);
@@ -271,7 +381,11 @@ void shader_system_destroy(const char* shader_name) {
 }
 
 b8 shader_system_use(const char* shader_name) {
-    u32 next_shader_id = shader_system_get_id(shader_name);
+    return shader_system_use_by_kname(kname_create(shader_name));
+}
+
+b8 shader_system_use_by_kname(kname shader_name) {
+    u32 next_shader_id = shader_system_get_id_by_kname(shader_name);
     if (next_shader_id == INVALID_ID) {
         return false;
     }
@@ -281,9 +395,9 @@ b8 shader_system_use(const char* shader_name) {
 
 b8 shader_system_use_by_id(u32 shader_id) {
     // Only perform the use if the shader id is different.
-    // if (state_ptr->current_shader_id != shader_id) {
+    // if (current_shader_id != shader_id) {
     shader* next_shader = shader_system_get_by_id(shader_id);
-    state_ptr->current_shader_id = shader_id;
+    current_shader_id = shader_id;
     if (!renderer_shader_use(next_shader)) {
         KERROR("Failed to use shader '%s'.", next_shader->name);
         return false;
@@ -297,30 +411,46 @@ b8 shader_system_use_by_id(u32 shader_id) {
 }
 
 u16 shader_system_uniform_location(shader* s, const char* uniform_name) {
+    return shader_system_uniform_location_by_kname(s, kname_create(uniform_name));
+}
+
+u16 shader_system_uniform_location_by_kname(shader* s, kname uniform_name) {
     if (!s || s->id == INVALID_ID) {
         KERROR("shader_system_uniform_location called with invalid shader.");
         return INVALID_ID_U16;
     }
 
     u16 index = INVALID_ID_U16;
-    if (!hashtable_get(&s->uniform_lookup, uniform_name, &index) || index == INVALID_ID_U16) {
-        KERROR("Shader '%s' does not have a registered uniform named '%s'", s->name, uniform_name);
+    if (!hashmap_get_u64(&s->uniform_lookup, uniform_name, &index)) {
+        const char* name_str = kname_string_get(uniform_name);
+        KERROR("Shader '%s' does not have a registered uniform named '%s'", s->name, name_str ? name_str : "<unknown>");
         return INVALID_ID_U16;
     }
     return s->uniforms[index].index;
 }
 
 b8 shader_system_uniform_set(const char* uniform_name, const void* value) {
-    return shader_system_uniform_set_arrayed(uniform_name, 0, value);
+    return shader_system_uniform_set_arrayed_by_kname(kname_create(uniform_name), 0, value);
+}
+
+b8 shader_system_uniform_set_by_kname(kname uniform_name, const void* value) {
+    return shader_system_uniform_set_arrayed_by_kname(uniform_name, 0, value);
 }
 
 b8 shader_system_uniform_set_arrayed(const char* uniform_name, u32 array_index, const void* value) {
-    if (state_ptr->current_shader_id == INVALID_ID) {
+    return shader_system_uniform_set_arrayed_by_kname(kname_create(uniform_name), array_index, value);
+}
+
+b8 shader_system_uniform_set_arrayed_by_kname(kname uniform_name, u32 array_index, const void* value) {
+    if (current_shader_id == INVALID_ID) {
         KERROR("shader_system_uniform_set called without a shader in use.");
         return false;
     }
-    shader* s = &state_ptr->shaders[state_ptr->current_shader_id];
-    u16 index = shader_system_uniform_location(s, uniform_name);
+    shader* s = &state_ptr->shaders[current_shader_id];
+    u16 index = shader_system_uniform_location_by_kname(s, uniform_name);
+    if (index == INVALID_ID_U16) {
+        return false;
+    }
     return shader_system_uniform_set_by_location_arrayed(index, array_index, value);
 }
 
@@ -328,6 +458,10 @@ b8 shader_system_sampler_set(const char* sampler_name, const texture* t) {
     return shader_system_sampler_set_arrayed(sampler_name, 0, t);
 }
 
+b8 shader_system_sampler_set_by_kname(kname sampler_name, const texture* t) {
+    return shader_system_uniform_set_arrayed_by_kname(sampler_name, 0, t);
+}
+
 b8 shader_system_sampler_set_arrayed(const char* sampler_name, u32 array_index, const texture* t) {
     return shader_system_uniform_set_arrayed(sampler_name, array_index, t);
 }
@@ -336,12 +470,20 @@ b8 shader_system_sampler_set_by_location(u16 location, const texture* t) {
     return shader_system_uniform_set_by_location_arrayed(location, 0, t);
 }
 
+b8 shader_system_storage_buffer_set_by_location(u16 location, const struct renderbuffer* buffer) {
+    return shader_system_uniform_set_by_location_arrayed(location, 0, buffer);
+}
+
+b8 shader_system_storage_image_set_by_location(u16 location, const texture* t) {
+    return shader_system_uniform_set_by_location_arrayed(location, 0, t);
+}
+
 b8 shader_system_uniform_set_by_location(u16 location, const void* value) {
     return shader_system_uniform_set_by_location_arrayed(location, 0, value);
 }
 
 b8 shader_system_uniform_set_by_location_arrayed(u16 location, u32 array_index, const void* value) {
-    shader* shader = &state_ptr->shaders[state_ptr->current_shader_id];
+    shader* shader = &state_ptr->shaders[current_shader_id];
     shader_uniform* uniform = &shader->uniforms[location];
     if (shader->bound_scope != uniform->scope) {
         if (uniform->scope == SHADER_SCOPE_GLOBAL) {
@@ -357,28 +499,280 @@ b8 shader_system_uniform_set_by_location_arrayed(u16 location, u32 array_index,
 }
 
 b8 shader_system_apply_global(b8 needs_update, frame_data* p_frame_data) {
-    return renderer_shader_apply_globals(&state_ptr->shaders[state_ptr->current_shader_id], needs_update, p_frame_data);
+    return renderer_shader_apply_globals(&state_ptr->shaders[current_shader_id], needs_update, p_frame_data);
 }
 b8 shader_system_apply_instance(b8 needs_update, frame_data* p_frame_data) {
-    return renderer_shader_apply_instance(&state_ptr->shaders[state_ptr->current_shader_id], needs_update, p_frame_data);
+    return renderer_shader_apply_instance(&state_ptr->shaders[current_shader_id], needs_update, p_frame_data);
 }
 
 b8 shader_system_bind_instance(u32 instance_id) {
-    shader* s = &state_ptr->shaders[state_ptr->current_shader_id];
+    shader* s = &state_ptr->shaders[current_shader_id];
     s->bound_instance_id = instance_id;
     return renderer_shader_bind_instance(s, instance_id);
 }
 
 b8 shader_system_apply_local(struct frame_data* p_frame_data) {
-    shader* s = &state_ptr->shaders[state_ptr->current_shader_id];
+    shader* s = &state_ptr->shaders[current_shader_id];
     return renderer_shader_apply_local(s, p_frame_data);
 }
 
+u8 shader_system_specialization_index(shader* s, const char* name) {
+    if (!s || !name) {
+        return INVALID_ID_U8;
+    }
+    kname spec_name = kname_create(name);
+    for (u8 i = 0; i < s->specialization_count; ++i) {
+        if (s->specializations[i].name == spec_name) {
+            return i;
+        }
+    }
+    KERROR("Shader '%s' has no specialization constant named '%s'.", s->name, name);
+    return INVALID_ID_U8;
+}
+
+u32 shader_system_variant_acquire(shader* s, const u32* values) {
+    if (!s || !values || !s->specialization_count) {
+        return 0;
+    }
+    return shader_system_variant_acquire_flagged(s, values, 0);
+}
+
+u32 shader_system_variant_acquire_flagged(shader* s, const u32* values, u32 flags) {
+    if (!s || (s->specialization_count && !values)) {
+        return 0;
+    }
+    if (!s->specialization_count && !flags) {
+        return 0;
+    }
+
+    u32 variant_count = darray_length(s->variants);
+    for (u32 i = 0; i < variant_count; ++i) {
+        b8 match = s->variants[i].flags == flags;
+        for (u32 c = 0; c < s->specialization_count && match; ++c) {
+            match = s->variants[i].values[c] == values[c];
+        }
+        if (match) {
+            return i;
+        }
+    }
+
+    if (variant_count >= SHADER_MAX_VARIANTS) {
+        KWARN("Shader '%s' has reached its limit of %u variants. Using the default variant instead.", s->name, SHADER_MAX_VARIANTS);
+        return 0;
+    }
+
+    shader_variant variant = {0};
+    if (s->specialization_count) {
+        kcopy_memory(variant.values, values, sizeof(u32) * s->specialization_count);
+    }
+    variant.flags = flags;
+    darray_push(s->variants, variant);
+    return variant_count;
+}
+
+b8 shader_system_variant_use(u32 variant_index) {
+    shader* s = &state_ptr->shaders[current_shader_id];
+    if (variant_index >= darray_length(s->variants)) {
+        KERROR("shader_system_variant_use: shader '%s' has no variant %u.", s->name, variant_index);
+        return false;
+    }
+    return renderer_shader_variant_use(s, variant_index);
+}
+
+b8 shader_system_local_block_verify(shader* s, u32 member_count, const shader_local_block_member* members, u32 block_size) {
+    if (!s || s->id == INVALID_ID || (member_count && !members)) {
+        KERROR("shader_system_local_block_verify requires a valid shader and an array of members.");
+        return false;
+    }
+
+    if (block_size != s->local_ubo_size || block_size > s->local_ubo_stride || (block_size % 4) != 0) {
+        KERROR("Local block of %u bytes doesn't match the %llu bytes of local uniforms of shader '%s'.", block_size, s->local_ubo_size, s->name);
+        return false;
+    }
+
+    // Every local uniform must be covered by a member, in the place the shader expects it.
+    u32 local_count = 0;
+    u32 uniform_count = darray_length(s->uniforms);
+    for (u32 i = 0; i < uniform_count; ++i) {
+        if (s->uniforms[i].scope == SHADER_SCOPE_LOCAL) {
+            local_count++;
+        }
+    }
+    if (local_count != member_count) {
+        KERROR("Local block describes %u members, but shader '%s' has %u local uniforms.", member_count, s->name, local_count);
+        return false;
+    }
+
+    for (u32 i = 0; i < member_count; ++i) {
+        u16 index = INVALID_ID_U16;
+        if (!members[i].name || !hashmap_get_u64(&s->uniform_lookup, kname_create(members[i].name), &index)) {
+            KERROR("Shader '%s' has no uniform named '%s' for its local block.", s->name, members[i].name ? members[i].name : "<unnamed>");
+            return false;
+        }
+        shader_uniform* u = &s->uniforms[index];
+        u32 size = u->size * KMAX(u->array_length, 1);
+        if (u->scope != SHADER_SCOPE_LOCAL || u->offset != members[i].offset || size != members[i].size) {
+            KERROR("Local block member '%s' (offset %u, size %u) doesn't match the layout of shader '%s'.", members[i].name, members[i].offset, members[i].size, s->name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+b8 shader_system_local_block_push(const void* block, u32 size) {
+    shader* s = &state_ptr->shaders[current_shader_id];
+    return renderer_shader_local_block_push(s, block, size);
+}
+
 b8 shader_system_bind_local(void) {
-    shader* s = &state_ptr->shaders[state_ptr->current_shader_id];
+    shader* s = &state_ptr->shaders[current_shader_id];
     return renderer_shader_bind_local(s);
 }
 
+b8 shader_system_vertex_format_set(geometry_vertex_format format) {
+    shader* s = &state_ptr->shaders[current_shader_id];
+    return renderer_shader_vertex_format_set(s, format);
+}
+
+b8 shader_system_dispatch(u32 group_count_x, u32 group_count_y, u32 group_count_z) {
+    shader* s = &state_ptr->shaders[current_shader_id];
+    return renderer_shader_dispatch(s, group_count_x, group_count_y, group_count_z);
+}
+
+static void shader_watches_add(shader* s) {
+    const char* base_path = resource_system_base_path_for_type(RESOURCE_TYPE_TEXT);
+    if (!base_path) {
+        return;
+    }
+
+    for (u8 i = 0; i < s->shader_stage_count; ++i) {
+        char path[512];
+        string_format(path, "%s%s", base_path, s->stage_configs[i].filename);
+        shader_watch w = {0};
+        w.shader_id = s->id;
+        if (resource_system_watch(path, &w.watch_id)) {
+            darray_push(state_ptr->watches, w);
+        }
+    }
+    string_free((char*)base_path);
+}
+
+static void shader_reload_params_free(shader_reload_params* params) {
+    for (u8 i = 0; i < params->stage_count; ++i) {
+        string_free(params->filenames[i]);
+        if (params->sources[i]) {
+            if (params->precompiled) {
+                kfree(params->sources[i], params->source_lengths[i], MEMORY_TAG_RENDERER);
+            } else {
+                string_free(params->sources[i]);
+            }
+        }
+    }
+    kfree(params->filenames, sizeof(char*) * params->stage_count, MEMORY_TAG_ARRAY);
+    kfree(params->sources, sizeof(char*) * params->stage_count, MEMORY_TAG_ARRAY);
+    kfree(params->source_lengths, sizeof(u32) * params->stage_count, MEMORY_TAG_ARRAY);
+    string_free(params->name);
+    kzero_memory(params, sizeof(shader_reload_params));
+}
+
+static b8 shader_reload_job_start(void* params, void* result_data) {
+    shader_reload_params* reload_params = (shader_reload_params*)params;
+
+    // Every stage is read again, as they are all compiled together.
+    b8 result = true;
+    for (u8 i = 0; i < reload_params->stage_count; ++i) {
+        resource text_resource;
+        if (!resource_system_load(reload_params->filenames[i], RESOURCE_TYPE_TEXT, 0, &text_resource)) {
+            KERROR("Unable to read shader file: %s.", reload_params->filenames[i]);
+            result = false;
+            break;
+        }
+        reload_params->source_lengths[i] = text_resource.data_size;
+        reload_params->sources[i] = string_duplicate(text_resource.data);
+        resource_system_unload(&text_resource);
+    }
+
+    // NOTE: The params are also used as the result data here.
+    kcopy_memory(result_data, reload_params, sizeof(shader_reload_params));
+
+    return result;
+}
+
+static void shader_reload_job_success(void* params) {
+    shader_reload_params* reload_params = (shader_reload_params*)params;
+
+    // The shader may have been destroyed while the job was running.
+    shader* s = &state_ptr->shaders[reload_params->shader_id];
+    if (s->id == reload_params->shader_id && s->name && strings_equal(s->name, reload_params->name) && s->shader_stage_count == reload_params->stage_count) {
+        // Swap in the new sources. Whichever set is not kept is freed along with the params.
+        // Reloaded sources are always GLSL, even if the shader was first created from a bundle.
+        b8 was_precompiled = s->stage_configs[0].precompiled;
+        for (u8 i = 0; i < reload_params->stage_count; ++i) {
+            s->stage_configs[i].precompiled = false;
+            char* old_source = s->stage_configs[i].source;
+            u32 old_length = s->stage_configs[i].source_length;
+            s->stage_configs[i].source = reload_params->sources[i];
+            s->stage_configs[i].source_length = reload_params->source_lengths[i];
+            reload_params->sources[i] = old_source;
+            reload_params->source_lengths[i] = old_length;
+        }
+        reload_params->precompiled = was_precompiled;
+
+        if (renderer_shader_reload(s)) {
+            KINFO("Reloaded shader '%s'.", s->name);
+        } else {
+            // Keep the sources matching what is actually in use.
+            for (u8 i = 0; i < reload_params->stage_count; ++i) {
+                s->stage_configs[i].precompiled = was_precompiled;
+                char* new_source = s->stage_configs[i].source;
+                u32 new_length = s->stage_configs[i].source_length;
+                s->stage_configs[i].source = reload_params->sources[i];
+                s->stage_configs[i].source_length = reload_params->source_lengths[i];
+                reload_params->sources[i] = new_source;
+                reload_params->source_lengths[i] = new_length;
+            }
+            reload_params->precompiled = false;
+            KERROR("Failed to reload shader '%s'. The previous version is kept.", s->name);
+        }
+    }
+
+    shader_reload_params_free(reload_params);
+}
+
+static void shader_reload_job_fail(void* params) {
+    shader_reload_params* reload_params = (shader_reload_params*)params;
+
+    KERROR("Failed to read the stages of shader '%s' for reloading. The previous version is kept.", reload_params->name);
+    shader_reload_params_free(reload_params);
+}
+
+static b8 shader_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context) {
+    u32 watch_id = context.data.u32[0];
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watches[i].watch_id == watch_id) {
+            shader* s = &state_ptr->shaders[state_ptr->watches[i].shader_id];
+
+            // Read the stage sources on a job thread. The shader is rebuilt once that is done.
+            shader_reload_params params = {0};
+            params.shader_id = s->id;
+            params.name = string_duplicate(s->name);
+            params.stage_count = s->shader_stage_count;
+            params.filenames = kallocate(sizeof(char*) * params.stage_count, MEMORY_TAG_ARRAY);
+            params.sources = kallocate(sizeof(char*) * params.stage_count, MEMORY_TAG_ARRAY);
+            params.source_lengths = kallocate(sizeof(u32) * params.stage_count, MEMORY_TAG_ARRAY);
+            for (u8 j = 0; j < params.stage_count; ++j) {
+                params.filenames[j] = string_duplicate(s->stage_configs[j].filename);
+            }
+            job_info job = job_create(shader_reload_job_start, shader_reload_job_success, shader_reload_job_fail, &params, sizeof(shader_reload_params), sizeof(shader_reload_params));
+            job_system_submit(job);
+            return true;
+        }
+    }
+    return false;
+}
+
 static b8 internal_attribute_add(shader* shader, const shader_attribute_config* config) {
     u32 size = 0;
     switch (config->type) {
@@ -393,8 +787,15 @@ static b8 internal_attribute_add(shader* shader, const shader_attribute_config*
         case SHADER_ATTRIB_TYPE_FLOAT32:
         case SHADER_ATTRIB_TYPE_INT32:
         case SHADER_ATTRIB_TYPE_UINT32:
+        case SHADER_ATTRIB_TYPE_SNORM8_4:
+        case SHADER_ATTRIB_TYPE_UNORM8_4:
+        case SHADER_ATTRIB_TYPE_FLOAT16_2:
+        case SHADER_ATTRIB_TYPE_UINT8_4:
             size = 4;
             break;
+        case SHADER_ATTRIB_TYPE_SNORM16_4:
+            size = 8;
+            break;
         case SHADER_ATTRIB_TYPE_FLOAT32_2:
             size = 8;
             break;
@@ -404,20 +805,39 @@ static b8 internal_attribute_add(shader* shader, const shader_attribute_config*
         case SHADER_ATTRIB_TYPE_FLOAT32_4:
             size = 16;
             break;
+        case SHADER_ATTRIB_TYPE_MATRIX_4:
+            size = 64;
+            break;
         default:
             KERROR("Unrecognized type %d, defaulting to size of 4. This probably is not what is desired.");
             size = 4;
             break;
     }
 
-    shader->attribute_stride += size;
+    if (config->packed && config->per_instance) {
+        KERROR("Packed attribute '%s' cannot also be per-instance.", config->name);
+        return false;
+    }
+
+    if (config->packed) {
+        shader->packed_attribute_stride += size;
+    } else if (config->per_instance) {
+        shader->instance_attribute_stride += size;
+    } else {
+        shader->attribute_stride += size;
+    }
 
     // Create/push the attribute.
     shader_attribute attrib = {};
     attrib.name = string_duplicate(config->name);
     attrib.size = size;
     attrib.type = config->type;
-    darray_push(shader->attributes, attrib);
+    attrib.per_instance = config->per_instance;
+    if (config->packed) {
+        darray_push(shader->packed_attributes, attrib);
+    } else {
+        darray_push(shader->attributes, attrib);
+    }
 
     return true;
 }
@@ -484,6 +904,35 @@ static b8 internal_sampler_add(shader* shader, shader_uniform_config* config) {
     return true;
 }
 
+static b8 internal_storage_add(shader* shader, shader_uniform_config* config) {
+    // Storage buffers/images are only bound once per frame, alongside the globals.
+    if (config->scope != SHADER_SCOPE_GLOBAL) {
+        KERROR("Storage uniform '%s' must be global-scoped.", config->name);
+        return false;
+    }
+
+    // Verify the name is valid and unique.
+    if (!uniform_name_valid(shader, config->name) || !shader_uniform_add_state_valid(shader)) {
+        return false;
+    }
+
+    // The location is the index among the storage bindings added so far.
+    u32 location = 0;
+    u32 uniform_count = darray_length(shader->uniforms);
+    for (u32 i = 0; i < uniform_count; ++i) {
+        if (uniform_type_is_storage(shader->uniforms[i].type)) {
+            location++;
+        }
+    }
+
+    if (!internal_uniform_add(shader, config, location)) {
+        KERROR("Unable to add storage uniform.");
+        return false;
+    }
+
+    return true;
+}
+
 static u32 generate_new_shader_id(void) {
     for (u32 i = 0; i < state_ptr->config.max_shader_count; ++i) {
         if (state_ptr->shaders[i].id == INVALID_ID) {
@@ -502,7 +951,8 @@ static b8 internal_uniform_add(shader* shader, const shader_uniform_config* conf
         KERROR("A shader can only accept a combined maximum of %d uniforms and samplers at global, instance and local scopes.", state_ptr->config.max_uniform_count);
         return false;
     }
-    b8 is_sampler = uniform_type_is_sampler(config->type);
+    // Samplers and storage buffers/images are bound as resources rather than living in a UBO.
+    b8 is_sampler = uniform_type_is_sampler(config->type) || uniform_type_is_storage(config->type);
     shader_uniform entry;
     entry.index = uniform_count;  // Index is saved to the hashtable for lookups.
     entry.scope = config->scope;
@@ -527,7 +977,7 @@ static b8 internal_uniform_add(shader* shader, const shader_uniform_config* conf
         entry.size = is_sampler ? 0 : config->size;
     }
 
-    if (!hashtable_set(&shader->uniform_lookup, config->name, &entry.index)) {
+    if (!hashmap_set_u64(&shader->uniform_lookup, kname_create(config->name), &entry.index)) {
         KERROR("Failed to add uniform.");
         return false;
     }
@@ -551,8 +1001,7 @@ static b8 uniform_name_valid(shader* shader, const char* uniform_name) {
         KERROR("Uniform name must exist.");
         return false;
     }
-    u16 location;
-    if (hashtable_get(&shader->uniform_lookup, uniform_name, &location) && location != INVALID_ID_U16) {
+    if (hashmap_get_u64(&shader->uniform_lookup, kname_create(uniform_name), 0)) {
         KERROR("A uniform by the name '%s' already exists on shader '%s'.", uniform_name, shader->name);
         return false;
     }
@@ -13,7 +13,8 @@
 
 #pragma once
 
-#include "containers/hashtable.h"
+#include "containers/hashmap.h"
+#include "core/kname.h"
 #include "defines.h"
 #include "renderer/renderer_types.h"
 #include "resources/resource_types.h"
@@ -52,12 +53,13 @@ typedef struct shader_uniform {
     u64 offset;
     /**
      * @brief The location to be used as a lookup. Typically the same as the index except for samplers,
-     * which is used to lookup texture index within the internal array at the given scope (global/instance).
+     * which is used to lookup texture index within the internal array at the given scope (global/instance),
+     * and storage buffers/images, which use their index among the shader's storage bindings.
      */
     u16 location;
     /** @brief Index into the internal uniform array. */
     u16 index;
-    /** @brief The size of the uniform, or 0 for samplers. */
+    /** @brief The size of the uniform, or 0 for samplers and storage buffers/images. */
     u16 size;
     /** @brief The index of the descriptor set the uniform belongs to (0=global, 1=instance, INVALID_ID=local). */
     u8 set_index;
@@ -69,6 +71,40 @@ typedef struct shader_uniform {
     u32 array_length;
 } shader_uniform;
 
+/**
+ * @brief Describes where a local uniform lives within a packed struct pushed through
+ * shader_system_local_block_push.
+ */
+typedef struct shader_local_block_member {
+    /** @brief The name of the local uniform. */
+    const char* name;
+    /** @brief The offset of the member within the struct, in bytes. */
+    u32 offset;
+    /** @brief The size of the member in bytes. */
+    u32 size;
+} shader_local_block_member;
+
+/** @brief The most variants a single shader may have. */
+#define SHADER_MAX_VARIANTS 32
+
+/** @brief A specialization constant of a shader. See shader_specialization_config. */
+typedef struct shader_specialization {
+    /** @brief The name of the constant. */
+    kname name;
+    /** @brief The constant_id of the constant within the shader stages. */
+    u32 id;
+    /** @brief The value of the constant in the default variant. */
+    u32 default_value;
+} shader_specialization;
+
+/** @brief A variant of a shader, given by the value of each of its specialization constants and any extra flags. */
+typedef struct shader_variant {
+    /** @brief The value of each specialization constant, in the order they are declared. */
+    u32 values[SHADER_MAX_SPECIALIZATIONS];
+    /** @brief Shader flags added to those of the shader for the pipelines of this variant. See shader_flags. */
+    u32 flags;
+} shader_variant;
+
 /**
  * @brief Represents a single shader vertex attribute.
  */
@@ -79,6 +115,8 @@ typedef struct shader_attribute {
     shader_attribute_type type;
     /** @brief The attribute size in bytes. */
     u32 size;
+    /** @brief Indicates if the attribute advances per-instance rather than per-vertex. */
+    b8 per_instance;
 } shader_attribute;
 
 typedef enum shader_flags {
@@ -87,7 +125,22 @@ typedef enum shader_flags {
     SHADER_FLAG_DEPTH_WRITE = 0x02,
     SHADER_FLAG_WIREFRAME = 0x04,
     SHADER_FLAG_STENCIL_TEST = 0x08,
-    SHADER_FLAG_STENCIL_WRITE = 0x10
+    SHADER_FLAG_STENCIL_WRITE = 0x10,
+    /**
+     * @brief The shader samples from the renderer's global bindless texture array, bound at the set
+     * following the shader's own global/instance sets. See renderer_texture_map_bindless_index_get.
+     */
+    SHADER_FLAG_BINDLESS_TEXTURES = 0x20,
+    /** @brief The shader's output is added to the colour already in the target, scaled by its alpha, rather than blended over it. */
+    SHADER_FLAG_BLEND_ADDITIVE = 0x40,
+    /**
+     * @brief The shader's output is accumulated for weighted blended order-independent transparency:
+     * weighted, premultiplied colour into the second colour attachment and coverage into the third.
+     * The first is not written, nor is depth. See scene_pass.
+     */
+    SHADER_FLAG_BLEND_WEIGHTED = 0x80,
+    /** @brief Nothing is written to the colour attachments, only depth (if enabled), e.g. for occlusion queries. */
+    SHADER_FLAG_COLOUR_WRITE_DISABLED = 0x100
 } shader_flags;
 
 typedef u32 shader_flag_bits;
@@ -149,10 +202,10 @@ typedef struct shader {
     /** @brief The currently bound instance's ubo offset. */
     u32 bound_ubo_offset;
 
-    /** @brief The block of memory used by the uniform hashtable. */
-    void* hashtable_block;
-    /** @brief A hashtable to store uniform index/locations by name. */
-    hashtable uniform_lookup;
+    /** @brief The block of memory used by the uniform lookup. */
+    void* uniform_lookup_block;
+    /** @brief A hashmap to store uniform indices by kname. */
+    hashmap uniform_lookup;
 
     /** @brief An array of uniforms in this shader. Darray. */
     shader_uniform* uniforms;
@@ -169,6 +222,10 @@ typedef struct shader {
     u8 instance_uniform_sampler_count;
     // darray Keeps the uniform indices of instance samplers for fast lookups.
     u32* instance_sampler_indices;
+    /** @brief The number of global storage buffer/image uniforms. */
+    u8 global_uniform_storage_count;
+    // darray Keeps the uniform indices of global storage buffers/images for fast lookups.
+    u32* global_storage_indices;
     /** @brief The number of local non-sampler uniforms. */
     u8 local_uniform_count;
 
@@ -178,9 +235,22 @@ typedef struct shader {
     /** @brief The internal state of the shader. */
     shader_state state;
 
-    /** @brief The size of all attributes combined, a.k.a. the size of a vertex. */
+    /** @brief The size of all per-vertex attributes combined, a.k.a. the size of a vertex. */
     u16 attribute_stride;
 
+    /** @brief The size of all per-instance attributes combined. 0 if the shader is not instanced. */
+    u16 instance_attribute_stride;
+
+    /**
+     * @brief An array of the attributes of the shader's packed vertex layout, used in place of its
+     * per-vertex attributes to draw geometry with GEOMETRY_VERTEX_FORMAT_PACKED. Empty if the shader
+     * can't draw packed geometry. Darray.
+     */
+    shader_attribute* packed_attributes;
+
+    /** @brief The size of all packed attributes combined, a.k.a. the size of a packed vertex. */
+    u16 packed_attribute_stride;
+
     /** @brief Used to ensure the shader's globals are only updated once per frame. */
     u64 render_frame_number;
     /** @brief Used to ensure the shader's globals are only updated once per draw. */
@@ -189,6 +259,16 @@ typedef struct shader {
     u8 shader_stage_count;
     shader_stage_config* stage_configs;
 
+    /** @brief The number of specialization constants. */
+    u8 specialization_count;
+    /** @brief The specialization constants, in the order variant values are given. */
+    shader_specialization specializations[SHADER_MAX_SPECIALIZATIONS];
+    /**
+     * @brief The variants of the shader acquired so far. The first always holds the default values.
+     * The renderer creates a variant's pipelines the first time it is used. Darray.
+     */
+    shader_variant* variants;
+
     /** @brief An opaque pointer to hold renderer API specific data. Renderer is responsible for creation and destruction of this.  */
     void* internal_data;
 } shader;
@@ -229,6 +309,14 @@ KAPI b8 shader_system_create(renderpass* pass, const shader_config* config);
  */
 KAPI u32 shader_system_get_id(const char* shader_name);
 
+/**
+ * @brief Gets the identifier of a shader by name.
+ *
+ * @param shader_name The kname of the shader.
+ * @return The shader id, if found; otherwise INVALID_ID.
+ */
+KAPI u32 shader_system_get_id_by_kname(kname shader_name);
+
 /**
  * @brief Returns a pointer to a shader with the given identifier.
  *
@@ -245,6 +333,14 @@ KAPI shader* shader_system_get_by_id(u32 shader_id);
  */
 KAPI shader* shader_system_get(const char* shader_name);
 
+/**
+ * @brief Returns a pointer to a shader with the given name.
+ *
+ * @param shader_name The kname to search for.
+ * @return A pointer to a shader, if found; otherwise 0.
+ */
+KAPI shader* shader_system_get_by_kname(kname shader_name);
+
 /**
  * @brief Uses the shader with the given name.
  *
@@ -253,6 +349,14 @@ KAPI shader* shader_system_get(const char* shader_name);
  */
 KAPI b8 shader_system_use(const char* shader_name);
 
+/**
+ * @brief Uses the shader with the given name.
+ *
+ * @param shader_name The kname of the shader to use.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_use_by_kname(kname shader_name);
+
 /**
  * @brief Uses the shader with the given identifier.
  *
@@ -270,6 +374,15 @@ KAPI b8 shader_system_use_by_id(u32 shader_id);
  */
 KAPI u16 shader_system_uniform_location(shader* s, const char* uniform_name);
 
+/**
+ * @brief Returns the uniform location for a uniform with the given name, if found.
+ *
+ * @param s A pointer to the shader to obtain the location from.
+ * @param uniform_name The kname of the uniform to search for.
+ * @return The uniform location, if found; otherwise INVALID_ID_U16.
+ */
+KAPI u16 shader_system_uniform_location_by_kname(shader* s, kname uniform_name);
+
 /**
  * @brief Sets the value of a uniform with the given name to the supplied value.
  * NOTE: Operates against the currently-used shader.
@@ -280,6 +393,16 @@ KAPI u16 shader_system_uniform_location(shader* s, const char* uniform_name);
  */
 KAPI b8 shader_system_uniform_set(const char* uniform_name, const void* value);
 
+/**
+ * @brief Sets the value of a uniform with the given name to the supplied value.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param uniform_name The kname of the uniform to be set.
+ * @param value The value to be set.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_uniform_set_by_kname(kname uniform_name, const void* value);
+
 /**
  * @brief Sets the value of an arrayed uniform with the given name to the supplied value.
  * NOTE: Operates against the currently-used shader.
@@ -291,6 +414,17 @@ KAPI b8 shader_system_uniform_set(const char* uniform_name, const void* value);
  */
 KAPI b8 shader_system_uniform_set_arrayed(const char* uniform_name, u32 array_index, const void* value);
 
+/**
+ * @brief Sets the value of an arrayed uniform with the given name to the supplied value.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param uniform_name The kname of the uniform to be set.
+ * @param array_index The index into the uniform array, if the uniform is in fact an array. Otherwise ignored.
+ * @param value The value to be set.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_uniform_set_arrayed_by_kname(kname uniform_name, u32 array_index, const void* value);
+
 /**
  * @brief Sets the texture of a sampler with the given name to the supplied texture.
  * NOTE: Operates against the currently-used shader.
@@ -301,6 +435,16 @@ KAPI b8 shader_system_uniform_set_arrayed(const char* uniform_name, u32 array_in
  */
 KAPI b8 shader_system_sampler_set(const char* sampler_name, const texture* t);
 
+/**
+ * @brief Sets the texture of a sampler with the given name to the supplied texture.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param sampler_name The kname of the sampler to be set.
+ * @param t A pointer to the texture to be set.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_sampler_set_by_kname(kname sampler_name, const texture* t);
+
 /**
  * @brief Sets the texture of an arrayed sampler with the given name to the supplied texture.
  * NOTE: Operates against the currently-used shader.
@@ -354,6 +498,26 @@ KAPI b8 shader_system_sampler_set_by_location(u16 location, const struct texture
  */
 KAPI b8 shader_system_sampler_set_by_location_arrayed(u16 location, u32 array_index, const struct texture* t);
 
+/**
+ * @brief Sets a storage buffer uniform by location. Storage buffers are global-scoped.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param location The location of the uniform.
+ * @param buffer A pointer to the renderbuffer to be bound. Must be a RENDERBUFFER_TYPE_STORAGE buffer.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_storage_buffer_set_by_location(u16 location, const struct renderbuffer* buffer);
+
+/**
+ * @brief Sets a storage image uniform by location. Storage images are global-scoped.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param location The location of the uniform.
+ * @param t A pointer to the texture to be bound. Must be created with TEXTURE_FLAG_IS_STORAGE.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_storage_image_set_by_location(u16 location, const struct texture* t);
+
 /**
  * @brief Applies global-scoped uniforms.
  * NOTE: Operates against the currently-used shader.
@@ -391,6 +555,77 @@ KAPI b8 shader_system_bind_instance(u32 instance_id);
  */
 KAPI b8 shader_system_apply_local(struct frame_data* p_frame_data);
 
+/**
+ * @brief Returns the index of the specialization constant with the given name, which is where
+ * its value goes in the values passed to shader_system_variant_acquire.
+ *
+ * @param s A pointer to the shader.
+ * @param name The name of the specialization constant.
+ * @return The index of the constant, if found; otherwise INVALID_ID_U8.
+ */
+KAPI u8 shader_system_specialization_index(shader* s, const char* name);
+
+/**
+ * @brief Obtains the variant of the given shader with the given specialization constant values,
+ * adding it if it doesn't exist yet. Its pipelines are only created when it is first used.
+ *
+ * @param s A pointer to the shader.
+ * @param values An array with a value for each of the shader's specialization constants, in order.
+ * Start from the defaults (see shader_variant) and change only those needed.
+ * @return The index of the variant. The default variant (0) if the shader has no specialization
+ * constants, or has run out of variants.
+ */
+KAPI u32 shader_system_variant_acquire(shader* s, const u32* values);
+
+/**
+ * @brief Obtains the variant of the given shader with the given specialization constant values and
+ * extra shader flags, adding it if it doesn't exist yet. Unlike shader_system_variant_acquire, the
+ * shader need not have any specialization constants.
+ *
+ * @param s A pointer to the shader.
+ * @param values An array with a value for each of the shader's specialization constants, in order.
+ * May be 0 if the shader has none.
+ * @param flags The shader flags added to those of the shader for this variant, e.g. SHADER_FLAG_BLEND_WEIGHTED.
+ * @return The index of the variant. The default variant (0) if it has run out of variants.
+ */
+KAPI u32 shader_system_variant_acquire_flagged(shader* s, const u32* values, u32 flags);
+
+/**
+ * @brief Binds the given variant of the currently-used shader, creating its pipelines if this is
+ * the first time it is used. Bound descriptor sets are kept. The variant stays bound until another
+ * is, including across uses of the shader.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param variant_index The index of the variant, as returned by shader_system_variant_acquire.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_variant_use(u32 variant_index);
+
+/**
+ * @brief Verifies that a packed struct matches the local uniform layout of the given shader, so it may
+ * be pushed whole with shader_system_local_block_push. Every local uniform must be described, at the
+ * offset and size the shader expects. Intended to be called once, when the shader's locations are obtained.
+ *
+ * @param s A pointer to the shader to verify against.
+ * @param member_count The number of members of the struct.
+ * @param members An array of member_count descriptions of the struct's members.
+ * @param block_size The size of the struct in bytes.
+ * @return True if the struct matches the layout; otherwise false.
+ */
+KAPI b8 shader_system_local_block_verify(shader* s, u32 member_count, const shader_local_block_member* members, u32 block_size);
+
+/**
+ * @brief Uploads every local uniform at once from a packed struct previously verified with
+ * shader_system_local_block_verify. Takes the place of setting each local uniform and applying them,
+ * skipping per-uniform lookups and validation on the draw path.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param block A constant pointer to the struct.
+ * @param size The size of the struct in bytes.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_local_block_push(const void* block, u32 size);
+
 /**
  * @brief Binds the instance with the given id for use. Must be done before setting
  * local-scoped uniforms.
@@ -399,3 +634,25 @@ KAPI b8 shader_system_apply_local(struct frame_data* p_frame_data);
  * @return True on success; otherwise false.
  */
 KAPI b8 shader_system_bind_local(void);
+
+/**
+ * @brief Selects the vertex layout the currently-used shader draws with, which must match the
+ * vertex format of the geometry drawn. Using a shader selects GEOMETRY_VERTEX_FORMAT_STANDARD.
+ * NOTE: Operates against the currently-used shader.
+ *
+ * @param format The vertex format of the geometry to be drawn next.
+ * @return True on success; otherwise false (i.e. the shader has no packed vertex layout).
+ */
+KAPI b8 shader_system_vertex_format_set(geometry_vertex_format format);
+
+/**
+ * @brief Dispatches the currently-used compute shader with the given number of workgroups.
+ * Globals must be applied first. Must be called outside of a renderpass. Writes made by the
+ * dispatch are visible to subsequent draws and dispatches in the same frame.
+ *
+ * @param group_count_x The number of workgroups to dispatch in the x dimension.
+ * @param group_count_y The number of workgroups to dispatch in the y dimension.
+ * @param group_count_z The number of workgroups to dispatch in the z dimension.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 shader_system_dispatch(u32 group_count_x, u32 group_count_y, u32 group_count_z);
@@ -1,30 +1,108 @@
 #include "texture_system.h"
 
-#include "containers/hashtable.h"
+#include "containers/darray.h"
+#include "containers/hashmap.h"
+#include "containers/slot_map.h"
+#include "core/event.h"
 #include "core/kmemory.h"
+#include "core/kname.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "platform/filesystem.h"
 #include "renderer/renderer_frontend.h"
+#include "renderer/renderer_utils.h"
 #include "resources/loaders/image_loader.h"
 #include "resources/resource_types.h"
 #include "systems/job_system.h"
 #include "systems/resource_system.h"
 
+/**
+ * @brief The streaming state of a registered texture. A streamed texture is created from its baked mip
+ * chain with some number of the largest levels left out (its "skip"), and recreated with more or fewer
+ * of them as they are requested and evicted.
+ */
+typedef struct texture_stream_entry {
+    // Indicates the texture was acquired to be streamed, even if it turns out it can't be.
+    b8 is_requested;
+    // Indicates the texture has baked mip levels, and so is being streamed.
+    b8 is_streamed;
+    // Indicates a load is in progress, after which the resident skip becomes the target skip.
+    b8 is_loading;
+    // Indicates the texture was requested since the last update.
+    b8 has_request;
+    // The format, dimensions and number of mip levels of the full texture.
+    texture_format format;
+    u32 width;
+    u32 height;
+    u32 mip_levels;
+    // The skip of the texture currently on the GPU.
+    u32 resident_skip;
+    // The skip of the texture once any load in progress is complete.
+    u32 target_skip;
+    // The skip of TEXTURE_STREAMING_LOW_MIP_SIZE, which is never evicted.
+    u32 low_skip;
+    // The skip wanted as of the last update, from the requests before it.
+    u32 wanted_skip;
+    // The smallest skip requested since the last update.
+    u32 request_skip;
+    // The frame number of the last request.
+    u64 last_request_frame;
+} texture_stream_entry;
+
+// A registered texture reloaded when its image file changes.
+typedef struct texture_watch {
+    // The resource system's watch of the image file.
+    u32 watch_id;
+    // The handle of the texture.
+    u32 handle;
+    // Indicates the file changed, and the texture is reloaded once no load of it is in progress.
+    b8 reload_pending;
+} texture_watch;
+
+// The width and height of each default texture.
+#define DEFAULT_TEXTURE_DIMENSION 16
+// The size of a single layer of a default texture.
+#define DEFAULT_TEXTURE_LAYER_SIZE (DEFAULT_TEXTURE_DIMENSION * DEFAULT_TEXTURE_DIMENSION * 4)
+// The flags describing what a texture holds, which are kept across loads of its data.
+#define TEXTURE_CONTENT_FLAGS (TEXTURE_FLAG_IS_SRGB | TEXTURE_FLAG_IS_NORMAL_MAP)
+
+typedef enum default_texture_type {
+    DEFAULT_TEXTURE_TYPE_BASE,
+    DEFAULT_TEXTURE_TYPE_DIFFUSE,
+    DEFAULT_TEXTURE_TYPE_SPECULAR,
+    DEFAULT_TEXTURE_TYPE_NORMAL,
+    DEFAULT_TEXTURE_TYPE_COMBINED,
+    DEFAULT_TEXTURE_TYPE_CUBE,
+    DEFAULT_TEXTURE_TYPE_TERRAIN,
+    DEFAULT_TEXTURE_TYPE_COUNT
+} default_texture_type;
+
 typedef struct texture_system_state {
     texture_system_config config;
-    texture default_texture;
-    texture default_diffuse_texture;
-    texture default_specular_texture;
-    texture default_normal_texture;
-    texture default_combined_texture;
-    texture default_cube_texture;
-    texture default_terrain_texture;
+    // The default textures, each created the first time it is asked for.
+    texture default_textures[DEFAULT_TEXTURE_TYPE_COUNT];
 
     // Array of registered textures.
+    // Registered textures. The slot index of each is its id, and the handle kept in its reference.
+    slot_map texture_slots;
+    // The elements of the slot map, which never move.
     texture* registered_textures;
 
-    // Hashtable for texture lookups.
-    hashtable registered_texture_table;
+    // Lookup of texture kname->texture_reference.
+    hashmap registered_texture_table;
+
+    // Array of the streaming state of each registered texture (at the same index).
+    texture_stream_entry* stream_entries;
+    // darray of the handles of the textures being streamed.
+    u32* streamed_handles;
+    // The number of bytes occupied by streamed textures as of the last update, counting loads in progress as done.
+    u64 streaming_resident_size;
+    // While the renderer reports GPU memory pressure, the lower budget streamed textures are held to. 0 if there is no pressure.
+    u64 pressure_budget;
+    // The number of updates so far, used to tell how recently streamed textures were requested.
+    u64 frame_number;
+    // darray of textures watched for hot reloading.
+    texture_watch* watches;
 } texture_system_state;
 
 typedef struct texture_reference {
@@ -40,6 +118,17 @@ typedef struct texture_load_params {
     texture temp_texture;
     u32 current_generation;
     resource image_resource;
+    // The contents of the source image file, if read in ahead of the job. Owned by the job.
+    u8* source_data;
+    u64 source_data_size;
+    // Indicates the mip levels of the texture are streamed. Cleared by the job if the image has no baked mip levels.
+    b8 is_streamed;
+    // For streamed textures, the number of the largest mip levels to leave out, or INVALID_ID to start from the low ones.
+    u32 mip_skip;
+    // The offset of the first mip level kept, within the pixel data.
+    u64 pixel_offset;
+    // Indicates the texture remains drawable while loading, as only the mip levels it has are being changed.
+    b8 keep_resident;
 } texture_load_params;
 
 typedef struct texture_load_layered_params {
@@ -54,28 +143,48 @@ typedef enum texture_load_job_code {
     TEXTURE_LOAD_JOB_CODE_FIRST_QUERY_FAILED,
     TEXTURE_LOAD_JOB_CODE_RESOURCE_LOAD_FAILED,
     TEXTURE_LOAD_JOB_CODE_RESOURCE_DIMENSION_MISMATCH,
+    TEXTURE_LOAD_JOB_CODE_COUNT
 } texture_load_job_code;
 
 typedef struct texture_load_layered_result {
     char* name;
     u32 layer_count;
     texture* out_texture;
-    u64 data_block_size;
-    u8* data_block;
+    // The decoded image of each layer, uploaded straight from these once the job completes.
+    const resource** layers;
     u32 current_generation;
     texture temp_texture;
     texture_load_job_code result_code;
 } texture_load_layered_result;
 
+// Shared by the batches decoding the layers of a layered texture, each of which writes only to its own layer's entries.
+typedef struct texture_layer_decode_context {
+    char** layer_names;
+    const resource** layers;
+    // The load result of each layer. Set to TEXTURE_LOAD_JOB_CODE_COUNT for those which loaded and match the first layer's size.
+    texture_load_job_code* layer_codes;
+    // Indicates if each layer's image was loaded, so needs unloading if the texture as a whole fails.
+    b8* loaded;
+    u32 width;
+    u32 height;
+} texture_layer_decode_context;
+
 static texture_system_state* state_ptr = 0;
 
-static b8 create_default_textures(texture_system_state* state);
+static texture* default_texture_get(default_texture_type type);
 static void destroy_default_textures(texture_system_state* state);
 static b8 load_texture(const char* texture_name, texture* t, const char** layer_names);
 static b8 load_cube_textures(const char texture_names[6][TEXTURE_NAME_MAX_LENGTH], texture* t);
 static void destroy_texture(texture* t);
-static b8 process_texture_reference(const char* name, i8 reference_diff, b8 auto_release, u32* out_texture_id, b8* needs_creation);
+static b8 process_texture_reference(kname name, const char* name_str, i8 reference_diff, b8 auto_release, u32* out_texture_id, b8* needs_creation);
+static texture* acquire_texture(kname name, const char* name_str, b8 auto_release, b8 streamed);
 static b8 create_texture(texture* t, texture_type type, u32 width, u32 height, u8 channel_count, u16 array_size, const char** layer_texture_names, b8 is_writeable, b8 skip_load);
+static texture_stream_entry* stream_entry_get(const texture* t);
+static void texture_watch_add(texture* t);
+static void texture_watch_remove(texture* t);
+static void texture_watches_update(void);
+static b8 texture_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context);
+static b8 texture_system_on_gpu_memory_pressure(u16 code, void* sender, void* listener_inst, event_context context);
 
 b8 texture_system_initialize(u64* memory_requirement, void* state, void* config) {
     texture_system_config* typed_config = (texture_system_config*)config;
@@ -84,11 +193,13 @@ b8 texture_system_initialize(u64* memory_requirement, void* state, void* config)
         return false;
     }
 
-    // Block of memory will contain state structure, then block for array, then block for hashtable.
+    // Block of memory will contain state structure, then block for the slot map, then block for the lookup.
     u64 struct_requirement = sizeof(texture_system_state);
-    u64 array_requirement = sizeof(texture) * typed_config->max_texture_count;
-    u64 hashtable_requirement = sizeof(texture_reference) * typed_config->max_texture_count;
-    *memory_requirement = struct_requirement + array_requirement + hashtable_requirement;
+    u64 array_requirement = slot_map_memory_requirement(sizeof(texture), typed_config->max_texture_count);
+    u64 lookup_requirement = 0;
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(texture_reference), typed_config->max_texture_count, &lookup_requirement, 0, 0);
+    u64 stream_requirement = sizeof(texture_stream_entry) * typed_config->max_texture_count;
+    *memory_requirement = struct_requirement + array_requirement + lookup_requirement + stream_requirement;
 
     if (!state) {
         return true;
@@ -97,22 +208,27 @@ b8 texture_system_initialize(u64* memory_requirement, void* state, void* config)
     state_ptr = state;
     state_ptr->config = *typed_config;
 
-    // The array block is after the state. Already allocated, so just set the pointer.
+    // The slot map block is after the state. Already allocated, so just create the map in it.
     void* array_block = state + struct_requirement;
-    state_ptr->registered_textures = array_block;
+    if (!slot_map_create(sizeof(texture), typed_config->max_texture_count, array_block, &state_ptr->texture_slots)) {
+        KFATAL("texture_system_initialize - Failed to create the texture slot map.");
+        return false;
+    }
+    state_ptr->registered_textures = state_ptr->texture_slots.elements;
 
-    // Hashtable block is after array.
-    void* hashtable_block = array_block + array_requirement;
+    // Lookup block is after array.
+    void* lookup_block = array_block + array_requirement;
 
-    // Create a hashtable for texture lookups.
-    hashtable_create(sizeof(texture_reference), typed_config->max_texture_count, hashtable_block, false, &state_ptr->registered_texture_table);
+    // Create a lookup for textures by kname.
+    hashmap_create(HASHMAP_KEY_TYPE_U64, sizeof(texture_reference), typed_config->max_texture_count, &lookup_requirement, lookup_block, &state_ptr->registered_texture_table);
 
-    // Fill the hashtable with invalid references to use as a default.
-    texture_reference invalid_ref;
-    invalid_ref.auto_release = false;
-    invalid_ref.handle = INVALID_ID;  // Primary reason for needing default values.
-    invalid_ref.reference_count = 0;
-    hashtable_fill(&state_ptr->registered_texture_table, &invalid_ref);
+    // Streaming entries are after the lookup.
+    state_ptr->stream_entries = lookup_block + lookup_requirement;
+    kzero_memory(state_ptr->stream_entries, sizeof(texture_stream_entry) * typed_config->max_texture_count);
+    state_ptr->streamed_handles = darray_create(u32);
+    if (!state_ptr->config.streaming_budget) {
+        state_ptr->config.streaming_budget = TEXTURE_STREAMING_DEFAULT_BUDGET;
+    }
 
     // Invalidate all textures in the array.
     u32 count = state_ptr->config.max_texture_count;
@@ -121,17 +237,35 @@ b8 texture_system_initialize(u64* memory_requirement, void* state, void* config)
         state_ptr->registered_textures[i].generation = INVALID_ID;
     }
 
-    // Create default textures for use in the system.
-    create_default_textures(state_ptr);
+    // NOTE: Default textures are created on first use. See default_texture_get.
+    kzero_memory(state_ptr->default_textures, sizeof(state_ptr->default_textures));
+
+    event_register(EVENT_CODE_GPU_MEMORY_PRESSURE, state_ptr, texture_system_on_gpu_memory_pressure);
+
+    if (resource_system_hot_reload_enabled()) {
+        state_ptr->watches = darray_create(texture_watch);
+        event_register(EVENT_CODE_WATCHED_RESOURCE_CHANGED, state_ptr, texture_system_on_resource_changed);
+    }
 
     return true;
 }
 
 void texture_system_shutdown(void* state) {
     if (state_ptr) {
+        event_unregister(EVENT_CODE_GPU_MEMORY_PRESSURE, state_ptr, texture_system_on_gpu_memory_pressure);
+        if (state_ptr->watches) {
+            event_unregister(EVENT_CODE_WATCHED_RESOURCE_CHANGED, state_ptr, texture_system_on_resource_changed);
+            u32 watch_count = darray_length(state_ptr->watches);
+            for (u32 i = 0; i < watch_count; ++i) {
+                resource_system_unwatch(state_ptr->watches[i].watch_id);
+            }
+            darray_destroy(state_ptr->watches);
+            state_ptr->watches = 0;
+        }
+
         // Destroy all loaded textures.
-        for (u32 i = 0; i < state_ptr->config.max_texture_count; ++i) {
-            texture* t = &state_ptr->registered_textures[i];
+        for (u32 i = 0; i < state_ptr->texture_slots.count; ++i) {
+            texture* t = slot_map_dense_get(&state_ptr->texture_slots, i);
             if (t->generation != INVALID_ID) {
                 renderer_texture_destroy(t);
             }
@@ -139,37 +273,57 @@ void texture_system_shutdown(void* state) {
 
         destroy_default_textures(state_ptr);
 
+        hashmap_destroy(&state_ptr->registered_texture_table);
+        darray_destroy(state_ptr->streamed_handles);
+
         state_ptr = 0;
     }
 }
 
 texture* texture_system_acquire(const char* name, b8 auto_release) {
+    return acquire_texture(kname_create(name), name, auto_release, false);
+}
+
+texture* texture_system_acquire_streamed(const char* name, b8 auto_release) {
+    return acquire_texture(kname_create(name), name, auto_release, true);
+}
+
+texture* texture_system_acquire_by_kname(kname name, b8 auto_release) {
+    const char* name_str = kname_string_get(name);
+    if (!name_str) {
+        KERROR("texture_system_acquire_by_kname called with an unregistered name. Use kname_create to obtain names.");
+        return 0;
+    }
+    return acquire_texture(name, name_str, auto_release, false);
+}
+
+static texture* acquire_texture(kname name, const char* name_str, b8 auto_release, b8 streamed) {
     // Return default texture, but warn about it since this should be returned via get_default_texture();
     // TODO: Check against other default texture names?
-    if (strings_equali(name, DEFAULT_TEXTURE_NAME)) {
+    if (strings_equali(name_str, DEFAULT_TEXTURE_NAME)) {
         KWARN("texture_system_acquire called for default texture. Use texture_system_get_default_texture for texture 'default'.");
-        return &state_ptr->default_texture;
+        return default_texture_get(DEFAULT_TEXTURE_TYPE_BASE);
     }
 
-    if (strings_equali(name, DEFAULT_DIFFUSE_TEXTURE_NAME)) {
+    if (strings_equali(name_str, DEFAULT_DIFFUSE_TEXTURE_NAME)) {
         KWARN("texture_system_acquire called for default diffuse texture. Use texture_system_get_default_diffuse_texture for texture 'default_DIFF'.");
-        return &state_ptr->default_diffuse_texture;
+        return default_texture_get(DEFAULT_TEXTURE_TYPE_DIFFUSE);
     }
 
-    if (strings_equali(name, DEFAULT_SPECULAR_TEXTURE_NAME)) {
+    if (strings_equali(name_str, DEFAULT_SPECULAR_TEXTURE_NAME)) {
         KWARN("texture_system_acquire called for default texture. Use texture_system_get_default_specular_texture for texture 'default_SPEC'.");
-        return &state_ptr->default_specular_texture;
+        return default_texture_get(DEFAULT_TEXTURE_TYPE_SPECULAR);
     }
 
-    if (strings_equali(name, DEFAULT_NORMAL_TEXTURE_NAME)) {
+    if (strings_equali(name_str, DEFAULT_NORMAL_TEXTURE_NAME)) {
         KWARN("texture_system_acquire called for default texture. Use texture_system_get_default_normal_texture for texture 'default_NORM'.");
-        return &state_ptr->default_normal_texture;
+        return default_texture_get(DEFAULT_TEXTURE_TYPE_NORMAL);
     }
 
     u32 id = INVALID_ID;
     b8 needs_creation = false;
     // NOTE: Increments reference count, or creates new entry.
-    if (!process_texture_reference(name, 1, auto_release, &id, &needs_creation)) {
+    if (!process_texture_reference(name, name_str, 1, auto_release, &id, &needs_creation)) {
         KERROR("texture_system_acquire failed to obtain a new texture id.");
         return 0;
     }
@@ -178,6 +332,7 @@ texture* texture_system_acquire(const char* name, b8 auto_release) {
 
     // Create it, if needed.
     if (needs_creation) {
+        state_ptr->stream_entries[id].is_requested = streamed;
         if (!create_texture(t, TEXTURE_TYPE_2D, 0, 0, 0, 1, 0, false, false)) {
             KERROR("texture_system_acquire failed to create new texture.");
             return 0;
@@ -192,13 +347,13 @@ texture* texture_system_acquire_cube(const char* name, b8 auto_release) {
     // TODO: Check against other default texture names?
     if (strings_equali(name, DEFAULT_TEXTURE_NAME)) {
         KWARN("texture_system_acquire_cube called for default texture. Use texture_system_get_default_texture for texture 'default'.");
-        return &state_ptr->default_texture;
+        return default_texture_get(DEFAULT_TEXTURE_TYPE_BASE);
     }
 
     u32 id = INVALID_ID;
     b8 needs_creation = false;
     // NOTE: Increments reference count, or creates new entry.
-    if (!process_texture_reference(name, 1, auto_release, &id, &needs_creation)) {
+    if (!process_texture_reference(kname_create(name), name, 1, auto_release, &id, &needs_creation)) {
         KERROR("texture_system_acquire_cube failed to obtain a new texture id.");
         return 0;
     }
@@ -223,7 +378,7 @@ texture* texture_system_acquire_writeable(const char* name, u32 width, u32 heigh
 texture* texture_system_acquire_writeable_arrayed(const char* name, u32 width, u32 height, u8 channel_count, b8 has_transparency, texture_type type, u16 array_size) {
     u32 id = INVALID_ID;
     b8 needs_creation = false;
-    if (!process_texture_reference(name, 1, false, &id, &needs_creation)) {
+    if (!process_texture_reference(kname_create(name), name, 1, false, &id, &needs_creation)) {
         KERROR("texture_system_acquire_writeable_arrayed failed to obtain a new texture id.");
         return 0;
     }
@@ -242,6 +397,28 @@ texture* texture_system_acquire_writeable_arrayed(const char* name, u32 width, u
     return t;
 }
 
+texture* texture_system_acquire_storage(const char* name, u32 width, u32 height, texture_type type, u16 array_size) {
+    u32 id = INVALID_ID;
+    b8 needs_creation = false;
+    if (!process_texture_reference(kname_create(name), name, 1, false, &id, &needs_creation)) {
+        KERROR("texture_system_acquire_storage failed to obtain a new texture id.");
+        return 0;
+    }
+
+    texture* t = &state_ptr->registered_textures[id];
+
+    // Create it, if needed. The storage flag must be set first, so the renderer can create it to be written by shaders.
+    if (needs_creation) {
+        t->flags |= TEXTURE_FLAG_IS_STORAGE;
+        if (!create_texture(t, type, width, height, 4, array_size, 0, true, true)) {
+            KERROR("texture_system_acquire_storage failed to create new texture.");
+            return 0;
+        }
+    }
+
+    return t;
+}
+
 texture* texture_system_acquire_textures_as_arrayed(const char* name, u32 layer_count, const char** layer_texture_names, b8 auto_release) {
     if (layer_count < 1) {
         KERROR("Must contain at least one layer.");
@@ -250,7 +427,7 @@ texture* texture_system_acquire_textures_as_arrayed(const char* name, u32 layer_
 
     b8 needs_creation = false;
     u32 id = INVALID_ID;
-    if (!process_texture_reference(name, 1, auto_release, &id, &needs_creation)) {
+    if (!process_texture_reference(kname_create(name), name, 1, auto_release, &id, &needs_creation)) {
         KERROR("texture_system_acquire_textures_as_arrayed failed to obtain a new texture id.");
         return 0;
     }
@@ -274,11 +451,16 @@ void texture_system_release(const char* name) {
     if (strings_equali(name, DEFAULT_TEXTURE_NAME)) {
         return;
     }
+    texture_system_release_by_kname(kname_create(name));
+}
+
+void texture_system_release_by_kname(kname name) {
     u32 id = INVALID_ID;
     b8 needs_creation;
     // NOTE: Decrement the reference count.
-    if (!process_texture_reference(name, -1, false, &id, &needs_creation)) {
-        KERROR("texture_system_release failed to release texture '%s' properly.", name);
+    if (!process_texture_reference(name, kname_string_get(name), -1, false, &id, &needs_creation)) {
+        const char* name_str = kname_string_get(name);
+        KERROR("texture_system_release failed to release texture '%s' properly.", name_str ? name_str : "<unknown>");
     }
 }
 
@@ -289,7 +471,7 @@ void texture_system_wrap_internal(const char* name, u32 width, u32 height, u8 ch
     if (register_texture) {
         // NOTE: Wrapped textures are never auto-released because it means that thier
         // resources are created and managed somewhere within the renderer internals.
-        if (!process_texture_reference(name, 1, false, &id, &needs_creation)) {
+        if (!process_texture_reference(kname_create(name), name, 1, false, &id, &needs_creation)) {
             KERROR("texture_system_wrap_internal failed to obtain a new texture id.");
             return;
         }
@@ -356,9 +538,28 @@ b8 texture_system_write_data(texture* t, u32 offset, u32 size, void* data) {
     return false;
 }
 
-#define RETURN_TEXT_PTR_OR_NULL(texture, func_name)                                              \
+b8 texture_system_write_region(texture* t, u32 x, u32 y, u32 width, u32 height, void* data) {
+    if (t) {
+        if (!(t->flags & TEXTURE_FLAG_IS_WRITEABLE)) {
+            KWARN("texture_system_write_region should not be called on textures that are not writeable.");
+            return false;
+        }
+        renderer_texture_write_region(t, x, y, width, height, data);
+        return true;
+    }
+    return false;
+}
+
+void texture_system_content_flags_set(texture* t, texture_flag_bits content_flags) {
+    if (!t || texture_system_is_default_texture(t)) {
+        return;
+    }
+    t->flags = (t->flags & ~TEXTURE_CONTENT_FLAGS) | (content_flags & TEXTURE_CONTENT_FLAGS);
+}
+
+#define RETURN_TEXT_PTR_OR_NULL(type, func_name)                                                 \
     if (state_ptr) {                                                                             \
-        return &texture;                                                                         \
+        return default_texture_get(type);                                                        \
     }                                                                                            \
     KERROR("%s called before texture system initialization! Null pointer returned.", func_name); \
     return 0;
@@ -367,258 +568,181 @@ b8 texture_system_is_default_texture(texture* t) {
     if (!state_ptr) {
         return false;
     }
-    return (t == &state_ptr->default_texture) ||
-           (t == &state_ptr->default_diffuse_texture) ||
-           (t == &state_ptr->default_normal_texture) ||
-           (t == &state_ptr->default_specular_texture) ||
-           (t == &state_ptr->default_combined_texture) ||
-           (t == &state_ptr->default_terrain_texture) ||
-           (t == &state_ptr->default_cube_texture);
+    return t >= state_ptr->default_textures && t < state_ptr->default_textures + DEFAULT_TEXTURE_TYPE_COUNT;
 }
 
 texture* texture_system_get_default_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_texture, "texture_system_get_default_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_BASE, "texture_system_get_default_texture");
 }
 
 texture* texture_system_get_default_diffuse_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_diffuse_texture, "texture_system_get_default_diffuse_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_DIFFUSE, "texture_system_get_default_diffuse_texture");
 }
 
 texture* texture_system_get_default_specular_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_specular_texture, "texture_system_get_default_specular_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_SPECULAR, "texture_system_get_default_specular_texture");
 }
 
 texture* texture_system_get_default_normal_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_normal_texture, "texture_system_get_default_normal_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_NORMAL, "texture_system_get_default_normal_texture");
 }
 
 texture* texture_system_get_default_combined_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_combined_texture, "texture_system_get_default_metallic_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_COMBINED, "texture_system_get_default_metallic_texture");
 }
 
 texture* texture_system_get_default_cube_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_cube_texture, "texture_system_get_default_cube_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_CUBE, "texture_system_get_default_cube_texture");
 }
 
 texture* texture_system_get_default_terrain_texture(void) {
-    RETURN_TEXT_PTR_OR_NULL(state_ptr->default_terrain_texture, "texture_system_get_default_terrain_texture");
+    RETURN_TEXT_PTR_OR_NULL(DEFAULT_TEXTURE_TYPE_TERRAIN, "texture_system_get_default_terrain_texture");
 }
 
-static void create_default_texture(texture* t, u8* pixels, u32 tex_dimension, const char* name) {
+static void create_default_texture(texture* t, texture_type type, u16 array_size, const u8* pixels, const char* name) {
     string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
-    t->width = tex_dimension;
-    t->height = tex_dimension;
+    t->width = DEFAULT_TEXTURE_DIMENSION;
+    t->height = DEFAULT_TEXTURE_DIMENSION;
     t->channel_count = 4;
     t->generation = INVALID_ID;
     t->flags = 0;
-    t->type = TEXTURE_TYPE_2D;
+    t->type = type;
     t->mip_levels = 1;
-    t->array_size = 1;
+    t->array_size = array_size;
     renderer_texture_create(pixels, t);
     // Manually set the texture generation to invalid since this is a default texture.
     t->generation = INVALID_ID;
 }
 
-static b8 create_default_cube_texture(texture* t, const char* name) {
-    const u32 tex_dimension = 16;
-    const u32 channels = 4;
-    const u32 pixel_count = tex_dimension * tex_dimension;
-    u8 cube_side_pixels[16 * 16 * 4];
-    kset_memory(cube_side_pixels, 255, sizeof(u8) * pixel_count * channels);
-
-    // Each pixel.
-    for (u64 row = 0; row < tex_dimension; ++row) {
-        for (u64 col = 0; col < tex_dimension; ++col) {
-            u64 index = (row * tex_dimension) + col;
-            u64 index_bpp = index * channels;
-            if (row % 2) {
-                if (col % 2) {
-                    cube_side_pixels[index_bpp + 1] = 0;
-                    cube_side_pixels[index_bpp + 2] = 0;
-                }
-            } else {
-                if (!(col % 2)) {
-                    cube_side_pixels[index_bpp + 1] = 0;
-                    cube_side_pixels[index_bpp + 2] = 0;
-                }
-            }
-        }
+// Fills a layer of a default texture with a single colour.
+static void default_pixels_fill(u8* pixels, u8 r, u8 g, u8 b, u8 a) {
+    for (u32 i = 0; i < DEFAULT_TEXTURE_DIMENSION * DEFAULT_TEXTURE_DIMENSION; ++i) {
+        pixels[i * 4 + 0] = r;
+        pixels[i * 4 + 1] = g;
+        pixels[i * 4 + 2] = b;
+        pixels[i * 4 + 3] = a;
     }
+}
 
-    u8* pixels = 0;
-    u64 image_size = 0;
-    for (u8 i = 0; i < 6; ++i) {
-        if (!pixels) {
-            t->width = tex_dimension;
-            t->height = tex_dimension;
-            t->channel_count = 4;
-            t->flags = 0;
-            t->generation = 0;
-            t->mip_levels = 1;
-            t->type = TEXTURE_TYPE_CUBE;
-            t->array_size = 6;
-            // Take a copy of the name.
-            string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
-
-            image_size = t->width * t->height * t->channel_count;
-            // NOTE: no need for transparency in cube maps, so not checking for it.
-
-            pixels = kallocate(sizeof(u8) * image_size * 6, MEMORY_TAG_ARRAY);
+// Fills a layer of a default texture with a checkerboard of the given colour and white.
+static void default_pixels_checkerboard(u8* pixels, u8 r, u8 g, u8 b) {
+    default_pixels_fill(pixels, 255, 255, 255, 255);
+    for (u32 row = 0; row < DEFAULT_TEXTURE_DIMENSION; ++row) {
+        // Squares where the row and column are both odd or both even are coloured.
+        for (u32 col = row % 2; col < DEFAULT_TEXTURE_DIMENSION; col += 2) {
+            u8* pixel = pixels + ((row * DEFAULT_TEXTURE_DIMENSION) + col) * 4;
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
         }
-
-        // Copy to the relevant portion of the array.
-        kcopy_memory(pixels + image_size * i, cube_side_pixels, image_size);
     }
-
-    // Acquire internal texture resources and upload to GPU.
-    renderer_texture_create(pixels, t);
-
-    kfree(pixels, sizeof(u8) * image_size * 6, MEMORY_TAG_ARRAY);
-    pixels = 0;
-
-    return true;
 }
 
-static void create_default_layered_texture(texture* t, u32 layer_count, u8* all_layer_pixels, u32 tex_dimension, const char* name) {
-    string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
-    t->width = tex_dimension;
-    t->height = tex_dimension;
-    t->channel_count = 4;
-    t->generation = INVALID_ID;
-    t->flags = 0;
-    t->type = TEXTURE_TYPE_2D_ARRAY;
-    t->mip_levels = 1;
-    t->array_size = layer_count;
-    renderer_texture_create(all_layer_pixels, t);
-    // Manually set the texture generation to invalid since this is a default texture.
-    t->generation = INVALID_ID;
-}
+// The default textures are each created the first time they are asked for rather than when the system starts,
+// so that none of them are made on the startup path and those the application never uses are never made at all.
+// Their uploads are batched with whatever else is pending.
+static texture* default_texture_get(default_texture_type type) {
+    texture* t = &state_ptr->default_textures[type];
+    if (t->name[0]) {
+        return t;
+    }
 
-static b8 create_default_textures(texture_system_state* state) {
-    // NOTE: Create default texture, a 256x256 blue/white checkerboard pattern.
-    // This is done in code to eliminate asset dependencies.
-    KTRACE("Creating default texture...");
-    const u32 tex_dimension = 16;
-    const u32 channels = 4;
-    const u32 pixel_count = tex_dimension * tex_dimension;
-    u8 pixels[16 * 16 * 4];
-    kset_memory(pixels, 255, sizeof(u8) * pixel_count * channels);
-
-    // Each pixel.
-    for (u64 row = 0; row < tex_dimension; ++row) {
-        for (u64 col = 0; col < tex_dimension; ++col) {
-            u64 index = (row * tex_dimension) + col;
-            u64 index_bpp = index * channels;
-            if (row % 2) {
-                if (col % 2) {
-                    pixels[index_bpp + 0] = 0;
-                    pixels[index_bpp + 1] = 0;
-                }
-            } else {
-                if (!(col % 2)) {
-                    pixels[index_bpp + 0] = 0;
-                    pixels[index_bpp + 1] = 0;
-                }
+    u8 pixels[DEFAULT_TEXTURE_LAYER_SIZE];
+    switch (type) {
+        case DEFAULT_TEXTURE_TYPE_BASE:
+            // NOTE: A blue/white checkerboard pattern. This is done in code to eliminate asset dependencies.
+            KTRACE("Creating default texture...");
+            default_pixels_checkerboard(pixels, 0, 0, 255);
+            create_default_texture(t, TEXTURE_TYPE_2D, 1, pixels, DEFAULT_TEXTURE_NAME);
+            break;
+        case DEFAULT_TEXTURE_TYPE_DIFFUSE:
+            // Default diffuse map is all white.
+            KTRACE("Creating default diffuse texture...");
+            default_pixels_fill(pixels, 255, 255, 255, 255);
+            create_default_texture(t, TEXTURE_TYPE_2D, 1, pixels, DEFAULT_DIFFUSE_TEXTURE_NAME);
+            break;
+        case DEFAULT_TEXTURE_TYPE_SPECULAR:
+            // Default spec map is black (no specular)
+            KTRACE("Creating default specular texture...");
+            default_pixels_fill(pixels, 0, 0, 0, 0);
+            create_default_texture(t, TEXTURE_TYPE_2D, 1, pixels, DEFAULT_SPECULAR_TEXTURE_NAME);
+            break;
+        case DEFAULT_TEXTURE_TYPE_NORMAL:
+            // Blue, the z-axis, by default.
+            KTRACE("Creating default normal texture...");
+            default_pixels_fill(pixels, 128, 128, 255, 255);
+            create_default_texture(t, TEXTURE_TYPE_2D, 1, pixels, DEFAULT_NORMAL_TEXTURE_NAME);
+            break;
+        case DEFAULT_TEXTURE_TYPE_COMBINED:
+            // Black metallic, medium grey roughness and white AO.
+            KTRACE("Creating default combined (metallic, roughness, AO) texture...");
+            default_pixels_fill(pixels, 0, 128, 255, 255);
+            create_default_texture(t, TEXTURE_TYPE_2D, 1, pixels, DEFAULT_COMBINED_TEXTURE_NAME);
+            break;
+        case DEFAULT_TEXTURE_TYPE_CUBE: {
+            // A red/white checkerboard on every side. NOTE: no need for transparency in cube maps.
+            KTRACE("Creating default cube texture...");
+            u8* sides = kallocate(DEFAULT_TEXTURE_LAYER_SIZE * 6, MEMORY_TAG_ARRAY);
+            default_pixels_checkerboard(pixels, 255, 0, 0);
+            for (u32 i = 0; i < 6; ++i) {
+                kcopy_memory(sides + DEFAULT_TEXTURE_LAYER_SIZE * i, pixels, DEFAULT_TEXTURE_LAYER_SIZE);
             }
-        }
-    }
-    create_default_texture(&state->default_texture, pixels, tex_dimension, DEFAULT_TEXTURE_NAME);
-
-    // Diffuse texture.
-    KTRACE("Creating default diffuse texture...");
-    u8 diff_pixels[16 * 16 * 4];
-    // Default diffuse map is all white.
-    kset_memory(diff_pixels, 255, sizeof(u8) * 16 * 16 * 4);
-    create_default_texture(&state->default_diffuse_texture, diff_pixels, 16, DEFAULT_DIFFUSE_TEXTURE_NAME);
-
-    // Specular texture.
-    KTRACE("Creating default specular texture...");
-    u8 spec_pixels[16 * 16 * 4];
-    // Default spec map is black (no specular)
-    kset_memory(spec_pixels, 0, sizeof(u8) * 16 * 16 * 4);
-    create_default_texture(&state->default_specular_texture, spec_pixels, 16, DEFAULT_SPECULAR_TEXTURE_NAME);
-
-    // Normal texture.
-    KTRACE("Creating default normal texture...");
-    u8 normal_pixels[16 * 16 * 4];  // w * h * channels
-    kset_memory(normal_pixels, 255, sizeof(u8) * 16 * 16 * 4);
-
-    // Each pixel.
-    for (u64 row = 0; row < 16; ++row) {
-        for (u64 col = 0; col < 16; ++col) {
-            u64 index = (row * 16) + col;
-            u64 index_bpp = index * channels;
-            // Set blue, z-axis by default and alpha.
-            normal_pixels[index_bpp + 0] = 128;
-            normal_pixels[index_bpp + 1] = 128;
-        }
-    }
-    create_default_texture(&state->default_normal_texture, normal_pixels, 16, DEFAULT_NORMAL_TEXTURE_NAME);
-
-    // Combined texture
-    KTRACE("Creating default combined (metallic, roughness, AO) texture...");
-    u8 combined_pixels[16 * 16 * 4];  // w * h * channels
-    kset_memory(combined_pixels, 255, sizeof(u8) * 16 * 16 * 4);
-
-    // Each pixel.
-    for (u64 row = 0; row < 16; ++row) {
-        for (u64 col = 0; col < 16; ++col) {
-            u64 index = (row * 16) + col;
-            u64 index_bpp = index * channels;
-            combined_pixels[index_bpp + 0] = 0;    // Default for metallic is black.
-            combined_pixels[index_bpp + 1] = 128;  // Default for roughness is medium grey
-            combined_pixels[index_bpp + 2] = 255;  // Default for AO is white.
-        }
+            create_default_texture(t, TEXTURE_TYPE_CUBE, 6, sides, DEFAULT_CUBE_TEXTURE_NAME);
+            // Unlike the other defaults, cube textures keep a valid generation.
+            t->generation = 0;
+            kfree(sides, DEFAULT_TEXTURE_LAYER_SIZE * 6, MEMORY_TAG_ARRAY);
+        } break;
+        case DEFAULT_TEXTURE_TYPE_TERRAIN: {
+            // 4 materials, 3 maps per, for 12 layers.
+            KTRACE("Creating default terrain texture...");
+            const u32 material_count = 4;
+            const u32 map_count = 3;
+            u32 layer_count = material_count * map_count;
+            u8* layers = kallocate(DEFAULT_TEXTURE_LAYER_SIZE * layer_count, MEMORY_TAG_ARRAY);
+            for (u32 i = 0; i < material_count; ++i) {
+                u8* material_layers = layers + DEFAULT_TEXTURE_LAYER_SIZE * map_count * i;
+                // Albedo NOTE: purposefully using checkerboard here instead of default diffuse white;
+                default_pixels_checkerboard(material_layers, 0, 0, 255);
+                // Normal
+                default_pixels_fill(material_layers + DEFAULT_TEXTURE_LAYER_SIZE, 128, 128, 255, 255);
+                // Combined
+                default_pixels_fill(material_layers + DEFAULT_TEXTURE_LAYER_SIZE * 2, 0, 128, 255, 255);
+            }
+            create_default_texture(t, TEXTURE_TYPE_2D_ARRAY, layer_count, layers, DEFAULT_TERRAIN_TEXTURE_NAME);
+            kfree(layers, DEFAULT_TEXTURE_LAYER_SIZE * layer_count, MEMORY_TAG_ARRAY);
+        } break;
+        default:
+            break;
     }
-    create_default_texture(&state->default_combined_texture, combined_pixels, 16, DEFAULT_COMBINED_TEXTURE_NAME);
-
-    // Cube texture.
-    KTRACE("Creating default cube texture...");
-    create_default_cube_texture(&state->default_cube_texture, DEFAULT_CUBE_TEXTURE_NAME);
-
-    // Default terrain textures. 4 materials, 3 maps per, for 12 layers.
-    u32 layer_size = sizeof(u8) * 16 * 16 * 4;
-    u32 terrain_material_count = 4;
-    u32 terrain_per_material_map_count = 3;
-    u32 layer_count = terrain_per_material_map_count * terrain_material_count;
-    u8* terrain_pixels = kallocate(layer_size * layer_count, MEMORY_TAG_ARRAY);
-    u32 material_size = layer_size * terrain_per_material_map_count;
-    for (u32 i = 0; i < terrain_material_count; ++i) {
-        // Albedo NOTE: purposefully using checkerboard here instead of default diffuse white;
-        kcopy_memory(terrain_pixels + (material_size * i) + (layer_size * 0), pixels, layer_size);
-        // Normal
-        kcopy_memory(terrain_pixels + (material_size * i) + (layer_size * 1), normal_pixels, layer_size);
-        // Combined
-        kcopy_memory(terrain_pixels + (material_size * i) + (layer_size * 2), combined_pixels, layer_size);
-    }
-    create_default_layered_texture(&state->default_terrain_texture, layer_count, terrain_pixels, 16, DEFAULT_TERRAIN_TEXTURE_NAME);
-    kfree(terrain_pixels, layer_size * layer_count, MEMORY_TAG_ARRAY);
-
-    return true;
+    return t;
 }
 
 static void destroy_default_textures(texture_system_state* state) {
     if (state) {
-        destroy_texture(&state->default_texture);
-        destroy_texture(&state->default_diffuse_texture);
-        destroy_texture(&state->default_specular_texture);
-        destroy_texture(&state->default_normal_texture);
-        destroy_texture(&state->default_combined_texture);
-        destroy_texture(&state->default_cube_texture);
-        destroy_texture(&state->default_terrain_texture);
+        for (u32 i = 0; i < DEFAULT_TEXTURE_TYPE_COUNT; ++i) {
+            // Only those which were asked for were created.
+            if (state->default_textures[i].name[0]) {
+                destroy_texture(&state->default_textures[i]);
+            }
+        }
     }
 }
 
 static b8 load_cube_textures(const char texture_names[6][TEXTURE_NAME_MAX_LENGTH], texture* t) {
     u8* pixels = 0;
-    u64 image_size = 0;
+    u64 pixels_size = 0;
+    b8 precomputed_mips = false;
     for (u8 i = 0; i < 6; ++i) {
-        image_resource_params params;
+        image_resource_params params = {0};
         params.flip_y = false;
+        params.allow_compressed = false;
 
         resource img_resource;
         if (!resource_system_load(texture_names[i], RESOURCE_TYPE_IMAGE, &params, &img_resource)) {
             KERROR("load_cube_textures() - Failed to load image resource for texture '%s'", texture_names[i]);
+            if (pixels) {
+                kfree(pixels, pixels_size, MEMORY_TAG_ARRAY);
+            }
             return false;
         }
 
@@ -627,48 +751,142 @@ static b8 load_cube_textures(const char texture_names[6][TEXTURE_NAME_MAX_LENGTH
             t->width = resource_data->width;
             t->height = resource_data->height;
             t->channel_count = resource_data->channel_count;
+            t->format = resource_data->format;
             t->flags = 0;
             t->generation = 0;
-            t->mip_levels = 1;
-
-            image_size = t->width * t->height * t->channel_count;
+            t->mip_levels = resource_data->mip_levels;
+            precomputed_mips = resource_data->precomputed_mips;
             // NOTE: no need for transparency in cube maps, so not checking for it.
 
-            pixels = kallocate(sizeof(u8) * image_size * 6, MEMORY_TAG_ARRAY);
+            // Faces loaded from .kbt files bring their own mip levels, otherwise they are generated on upload.
+            if (precomputed_mips) {
+                pixels_size = texture_format_chain_size(t->format, t->width, t->height, t->mip_levels) * 6;
+            } else {
+                pixels_size = (u64)t->width * t->height * t->channel_count * 6;
+            }
+            pixels = kallocate(pixels_size, MEMORY_TAG_ARRAY);
         } else {
             // Verify all textures are the same size.
-            if (t->width != resource_data->width || t->height != resource_data->height || t->channel_count != resource_data->channel_count) {
-                KERROR("load_cube_textures - All textures must be the same resolution and bit depth.");
-                kfree(pixels, sizeof(u8) * image_size * 6, MEMORY_TAG_ARRAY);
+            if (t->width != resource_data->width || t->height != resource_data->height || t->channel_count != resource_data->channel_count ||
+                t->format != resource_data->format || precomputed_mips != resource_data->precomputed_mips || t->mip_levels != resource_data->mip_levels) {
+                KERROR("load_cube_textures - All textures must be the same resolution, bit depth and number of mip levels.");
+                resource_system_unload(&img_resource);
+                kfree(pixels, pixels_size, MEMORY_TAG_ARRAY);
                 pixels = 0;
                 return false;
             }
         }
 
-        // Copy to the relevant portion of the array.
-        kcopy_memory(pixels + image_size * i, resource_data->pixels, image_size);
+        // Copy to the relevant portion of the array. Levels are stored one after another, with the faces of each level together.
+        u32 level_count = precomputed_mips ? t->mip_levels : 1;
+        u32 width = t->width;
+        u32 height = t->height;
+        u64 level_offset = 0;
+        u64 face_offset = 0;
+        for (u32 level = 0; level < level_count; ++level) {
+            u64 level_size = precomputed_mips ? texture_format_level_size(t->format, width, height) : (u64)width * height * t->channel_count;
+            kcopy_memory(pixels + level_offset + level_size * i, resource_data->pixels + face_offset, level_size);
+            level_offset += level_size * 6;
+            face_offset += level_size;
+            width = KMAX(width / 2, 1);
+            height = KMAX(height / 2, 1);
+        }
 
         // Clean up data.
         resource_system_unload(&img_resource);
     }
 
+    t->flags |= precomputed_mips ? TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS : 0;
+
     // Acquire internal texture resources and upload to GPU.
     renderer_texture_create(pixels, t);
 
-    kfree(pixels, sizeof(u8) * image_size * 6, MEMORY_TAG_ARRAY);
+    kfree(pixels, pixels_size, MEMORY_TAG_ARRAY);
     pixels = 0;
 
     return true;
 }
 
+// The number of the largest mip levels left out to bring a texture down to TEXTURE_STREAMING_LOW_MIP_SIZE.
+static u32 stream_low_skip_get(u32 width, u32 height, u32 mip_levels) {
+    u32 skip = 0;
+    while (skip + 1 < mip_levels && (KMAX(width, height) >> skip) > TEXTURE_STREAMING_LOW_MIP_SIZE) {
+        skip++;
+    }
+    return skip;
+}
+
+// The number of bytes a streamed texture occupies with the given skip.
+static u64 stream_size_get(const texture_stream_entry* entry, u32 skip) {
+    return texture_format_chain_size(entry->format, KMAX(entry->width >> skip, 1), KMAX(entry->height >> skip, 1), entry->mip_levels - skip);
+}
+
+static texture_stream_entry* stream_entry_get(const texture* t) {
+    if (!state_ptr || t < state_ptr->registered_textures || t >= state_ptr->registered_textures + state_ptr->config.max_texture_count) {
+        return 0;
+    }
+    return &state_ptr->stream_entries[t - state_ptr->registered_textures];
+}
+
+static void stream_entry_remove(texture_stream_entry* entry) {
+    u32 handle = (u32)(entry - state_ptr->stream_entries);
+    u32 count = darray_length(state_ptr->streamed_handles);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->streamed_handles[i] == handle) {
+            // Order doesn't matter, so swap the last one into its place.
+            state_ptr->streamed_handles[i] = state_ptr->streamed_handles[count - 1];
+            darray_length_set(state_ptr->streamed_handles, count - 1);
+            break;
+        }
+    }
+    entry->is_streamed = false;
+}
+
+// Records the mip levels a streamed texture now has on the GPU.
+static void stream_load_complete(const texture_load_params* params, const image_resource_data* resource_data) {
+    texture_stream_entry* entry = stream_entry_get(params->out_texture);
+    if (!entry || !entry->is_requested) {
+        return;
+    }
+
+    entry->is_loading = false;
+    if (!params->is_streamed) {
+        // The image turned out to have no baked mip levels, so is loaded in full.
+        if (entry->is_streamed) {
+            stream_entry_remove(entry);
+        }
+        return;
+    }
+
+    if (!entry->is_streamed) {
+        entry->is_streamed = true;
+        entry->format = resource_data->format;
+        entry->width = resource_data->width;
+        entry->height = resource_data->height;
+        entry->mip_levels = resource_data->mip_levels;
+        entry->low_skip = stream_low_skip_get(entry->width, entry->height, entry->mip_levels);
+        entry->wanted_skip = entry->low_skip;
+        entry->request_skip = entry->low_skip;
+        entry->last_request_frame = state_ptr->frame_number;
+        u32 handle = (u32)(entry - state_ptr->stream_entries);
+        darray_push(state_ptr->streamed_handles, handle);
+    }
+    entry->resident_skip = params->mip_skip;
+    entry->target_skip = params->mip_skip;
+}
+
 static void texture_load_job_success(void* params) {
     texture_load_params* texture_params = (texture_load_params*)params;
 
     // This also handles the GPU upload. Can't be jobified until the renderer is multithreaded.
     image_resource_data* resource_data = (image_resource_data*)texture_params->image_resource.data;
 
+    // What the texture holds may have been set since the load began, and decides how mips are generated.
+    texture_params->temp_texture.flags |= texture_params->out_texture->flags & TEXTURE_CONTENT_FLAGS;
+
     // Acquire internal texture resources and upload to GPU. Can't be jobified until the renderer is multithreaded.
-    renderer_texture_create(resource_data->pixels, &texture_params->temp_texture);
+    // Streamed textures start from the first of their mip levels to be kept.
+    renderer_texture_create(resource_data->pixels + texture_params->pixel_offset, &texture_params->temp_texture);
 
     // Take a copy of the old texture.
     texture old = *texture_params->out_texture;
@@ -688,6 +906,8 @@ static void texture_load_job_success(void* params) {
 
     KTRACE("Successfully loaded texture '%s'.", texture_params->resource_name);
 
+    stream_load_complete(texture_params, resource_data);
+
     // Clean up data.
     resource_system_unload(&texture_params->image_resource);
     if (texture_params->resource_name) {
@@ -702,44 +922,83 @@ static void texture_load_job_fail(void* params) {
 
     KERROR("Failed to load texture '%s'.", texture_params->resource_name);
 
+    // A streamed texture keeps whatever it had before.
+    texture_stream_entry* entry = stream_entry_get(texture_params->out_texture);
+    if (entry && entry->is_requested) {
+        entry->is_loading = false;
+        if (entry->is_streamed) {
+            entry->target_skip = entry->resident_skip;
+        }
+    }
+
     resource_system_unload(&texture_params->image_resource);
 }
 
 static b8 texture_load_job_start(void* params, void* result_data) {
     texture_load_params* load_params = (texture_load_params*)params;
 
-    image_resource_params resource_params;
+    image_resource_params resource_params = {0};
     resource_params.flip_y = true;
+    resource_params.allow_compressed = true;
+    resource_params.source_data = load_params->source_data;
+    resource_params.source_data_size = load_params->source_data_size;
 
     b8 result = resource_system_load(load_params->resource_name, RESOURCE_TYPE_IMAGE, &resource_params, &load_params->image_resource);
+    // The source data is decoded into a buffer of its own, so it is no longer needed either way.
+    if (load_params->source_data) {
+        kfree(load_params->source_data, load_params->source_data_size, MEMORY_TAG_RESOURCE);
+        load_params->source_data = 0;
+        load_params->source_data_size = 0;
+        resource_params.source_data = 0;
+        resource_params.source_data_size = 0;
+    }
 
     image_resource_data* resource_data = load_params->image_resource.data;
+    if (result && !renderer_texture_format_supported(resource_data->format)) {
+        KWARN("The renderer does not support the format of baked texture '%s'. Using the source image instead.", load_params->resource_name);
+        resource_system_unload(&load_params->image_resource);
+        resource_params.allow_compressed = false;
+        result = resource_system_load(load_params->resource_name, RESOURCE_TYPE_IMAGE, &resource_params, &load_params->image_resource);
+        resource_data = load_params->image_resource.data;
+    }
 
-    // Use a temporary texture to load into.
-    load_params->temp_texture.width = resource_data->width;
-    load_params->temp_texture.height = resource_data->height;
+    // Streamed textures leave out their largest mip levels, which are laid out first in baked data.
+    u32 skip = 0;
+    load_params->pixel_offset = 0;
+    if (load_params->is_streamed) {
+        if (result && resource_data->precomputed_mips && resource_data->mip_levels > 1) {
+            skip = load_params->mip_skip;
+            if (skip == INVALID_ID) {
+                skip = stream_low_skip_get(resource_data->width, resource_data->height, resource_data->mip_levels);
+            }
+            skip = KMIN(skip, resource_data->mip_levels - 1);
+            load_params->pixel_offset = texture_format_chain_size(resource_data->format, resource_data->width, resource_data->height, skip);
+        } else {
+            load_params->is_streamed = false;
+        }
+        load_params->mip_skip = skip;
+    }
+
+    // Use a temporary texture to load into. It takes the place of the texture, so keeps its identity.
+    load_params->temp_texture.id = load_params->out_texture->id;
+    load_params->temp_texture.type = load_params->out_texture->type;
+    load_params->temp_texture.width = KMAX(resource_data->width >> skip, 1);
+    load_params->temp_texture.height = KMAX(resource_data->height >> skip, 1);
     load_params->temp_texture.channel_count = resource_data->channel_count;
-    load_params->temp_texture.mip_levels = resource_data->mip_levels;
+    load_params->temp_texture.mip_levels = resource_data->mip_levels - skip;
+    load_params->temp_texture.format = resource_data->format;
 
     load_params->current_generation = load_params->out_texture->generation;
-    load_params->out_texture->generation = INVALID_ID;
-    load_params->out_texture->mip_levels = resource_data->mip_levels;
-
-    u64 total_size = load_params->temp_texture.width * load_params->temp_texture.height * load_params->temp_texture.channel_count;
-    // Check for transparency
-    b32 has_transparency = false;
-    for (u64 i = 0; i < total_size; i += load_params->temp_texture.channel_count) {
-        u8 a = resource_data->pixels[i + 3];
-        if (a < 255) {
-            has_transparency = true;
-            break;
-        }
+    if (!load_params->keep_resident) {
+        load_params->out_texture->generation = INVALID_ID;
+        load_params->out_texture->mip_levels = load_params->temp_texture.mip_levels;
     }
 
     // Take a copy of the name.
     string_ncopy(load_params->temp_texture.name, load_params->resource_name, TEXTURE_NAME_MAX_LENGTH);
     load_params->temp_texture.generation = INVALID_ID;
-    load_params->temp_texture.flags |= has_transparency ? TEXTURE_FLAG_HAS_TRANSPARENCY : 0;
+    load_params->temp_texture.flags |= resource_data->has_transparency ? TEXTURE_FLAG_HAS_TRANSPARENCY : 0;
+    load_params->temp_texture.flags |= resource_data->precomputed_mips ? TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS : 0;
 
     // NOTE: The load params are also used as the result data here, only the image_resource field is populated now.
     kcopy_memory(result_data, load_params, sizeof(texture_load_params));
@@ -751,8 +1010,21 @@ static b8 texture_load_job_start(void* params, void* result_data) {
 static void texture_load_layered_job_success(void* result) {
     texture_load_layered_result* typed_result = (texture_load_layered_result*)result;
 
-    // Acquire internal texture resources and upload to GPU. Can't be jobified until the renderer is multithreaded.
-    renderer_texture_create(typed_result->data_block, &typed_result->temp_texture);
+    // Acquire internal texture resources and upload each layer to the GPU straight from its decoded image.
+    // Can't be jobified until the renderer is multithreaded.
+    const u8** layer_pixels = kallocate(sizeof(u8*) * typed_result->layer_count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < typed_result->layer_count; ++i) {
+        layer_pixels[i] = ((image_resource_data*)typed_result->layers[i]->data)->pixels;
+    }
+    renderer_texture_create_layered(layer_pixels, &typed_result->temp_texture);
+    kfree(layer_pixels, sizeof(u8*) * typed_result->layer_count, MEMORY_TAG_ARRAY);
+
+    // The pixels are staged for upload, so the images are no longer needed here.
+    for (u32 i = 0; i < typed_result->layer_count; ++i) {
+        resource_system_release(typed_result->layers[i]);
+    }
+    kfree(typed_result->layers, sizeof(const resource*) * typed_result->layer_count, MEMORY_TAG_ARRAY);
+    typed_result->layers = 0;
 
     typed_result->out_texture->generation = INVALID_ID;
 
@@ -779,7 +1051,6 @@ static void texture_load_layered_job_success(void* result) {
     } else {
         KTRACE("Successfully loaded layered texture.");
     }
-    kfree(typed_result->data_block, typed_result->data_block_size, MEMORY_TAG_ARRAY);
 }
 
 static void texture_load_layered_job_fail(void* result_data) {
@@ -801,9 +1072,37 @@ static void texture_load_layered_job_fail(void* result_data) {
     }
 }
 
+// Decodes a batch of the layers of a layered texture. Run in parallel, one layer per batch.
+static void texture_layers_decode(u32 start, u32 end, void* user_data) {
+    texture_layer_decode_context* context = user_data;
+
+    image_resource_params resource_params = {0};
+    resource_params.flip_y = true;
+    resource_params.allow_compressed = false;
+
+    for (u32 layer = start; layer < end; ++layer) {
+        // Shared through the resource cache, so a layer used by several textures is only decoded once.
+        if (!resource_system_acquire(context->layer_names[layer], RESOURCE_TYPE_IMAGE, &resource_params, sizeof(image_resource_params), &context->layers[layer])) {
+            context->layer_codes[layer] = TEXTURE_LOAD_JOB_CODE_RESOURCE_LOAD_FAILED;
+            continue;
+        }
+        context->loaded[layer] = true;
+
+        // Verify the dimensions match that of the first layer's texture.
+        const image_resource_data* resource_data = context->layers[layer]->data;
+        if (resource_data->width != context->width || resource_data->height != context->height) {
+            context->layer_codes[layer] = TEXTURE_LOAD_JOB_CODE_RESOURCE_DIMENSION_MISMATCH;
+            continue;
+        }
+        context->layer_codes[layer] = TEXTURE_LOAD_JOB_CODE_COUNT;
+    }
+}
+
 static b8 texture_load_layered_job_start(void* params, void* result_data) {
     texture_load_layered_params* load_params = (texture_load_layered_params*)params;
     texture_load_layered_result* typed_result = result_data;
+    u32 layer_count = load_params->layer_count;
+    b8 success = false;
 
     // Query the dimensions of the first image. All subsequent images must match dimensions.
     // Channel count from the image is ignored.
@@ -811,19 +1110,13 @@ static b8 texture_load_layered_job_start(void* params, void* result_data) {
     u32 mip_levels;
     if (!image_loader_query_properties(load_params->layer_names[0], &first_width, &first_height, &channel_count, &mip_levels)) {
         typed_result->result_code = TEXTURE_LOAD_JOB_CODE_FIRST_QUERY_FAILED;
-        return false;
+        goto texture_load_layered_done;
     }
 
-    // Once the first image size is acquired, allocate enough memory for
-    // it's dimensions * channels * layer count. Note that 4 channels are always required here.
+    // Note that 4 channels are always required here.
     const u32 layer_channel_count = 4;
-    u32 layer_size = sizeof(u8) * (u32)first_width * (u32)first_height * layer_channel_count;
-    typed_result->data_block_size = layer_size * load_params->layer_count;
-    typed_result->data_block = kallocate(typed_result->data_block_size, MEMORY_TAG_ARRAY);
     typed_result->out_texture = load_params->out_texture;
 
-    b8 has_transparency = false;
-
     // Create a temporary texture to load into, so that if an existing texture is being used, we don't trash memory
     // that's currently in use for a draw, etc.
     typed_result->temp_texture = (texture){};
@@ -833,76 +1126,88 @@ static b8 texture_load_layered_job_start(void* params, void* result_data) {
     typed_result->temp_texture.height = first_height;
     typed_result->temp_texture.channel_count = layer_channel_count;
     typed_result->temp_texture.mip_levels = mip_levels;
-    typed_result->temp_texture.array_size = load_params->layer_count;
+    typed_result->temp_texture.array_size = layer_count;
     // Copy relevant properties from the original texture.
     typed_result->temp_texture.type = load_params->out_texture->type;
     typed_result->temp_texture.id = load_params->out_texture->id;
     typed_result->temp_texture.flags = load_params->out_texture->flags;
 
-    image_resource_params resource_params;
-    resource_params.flip_y = true;
-
-    u32 layer = 0;
-    for (; layer < load_params->layer_count; ++layer) {
-        resource image_resource;
-        if (!resource_system_load(load_params->layer_names[layer], RESOURCE_TYPE_IMAGE, &resource_params, &image_resource)) {
-            typed_result->result_code = TEXTURE_LOAD_JOB_CODE_RESOURCE_LOAD_FAILED;
-            goto texture_load_layered_failed;
-        }
+    // Decode every layer at once, each on its own batch. The images are kept as they are, and uploaded from directly.
+    texture_layer_decode_context decode = {0};
+    decode.layer_names = load_params->layer_names;
+    decode.layers = kallocate(sizeof(const resource*) * layer_count, MEMORY_TAG_ARRAY);
+    decode.layer_codes = kallocate(sizeof(texture_load_job_code) * layer_count, MEMORY_TAG_ARRAY);
+    decode.loaded = kallocate(sizeof(b8) * layer_count, MEMORY_TAG_ARRAY);
+    decode.width = (u32)first_width;
+    decode.height = (u32)first_height;
+    job_parallel_for(layer_count, 1, texture_layers_decode, &decode);
 
-        image_resource_data* resource_data = image_resource.data;
-
-        // Verify the dimensions match that of the first layer's texture.
-        if (resource_data->width != (u32)first_width || resource_data->height != (u32)first_height) {
-            typed_result->result_code = TEXTURE_LOAD_JOB_CODE_RESOURCE_DIMENSION_MISMATCH;
-            resource_system_unload(&image_resource);
-            goto texture_load_layered_failed;
+    b8 has_transparency = false;
+    success = true;
+    for (u32 layer = 0; layer < layer_count; ++layer) {
+        if (decode.layer_codes[layer] != TEXTURE_LOAD_JOB_CODE_COUNT) {
+            typed_result->result_code = decode.layer_codes[layer];
+            success = false;
+            break;
         }
+        has_transparency |= ((const image_resource_data*)decode.layers[layer]->data)->has_transparency;
+    }
 
-        // Check for transparency
-        if (!has_transparency) {
-            for (u64 i = 0; i < layer_size; i += typed_result->temp_texture.channel_count) {
-                u8 a = resource_data->pixels[i + 3];
-                if (a < 255) {
-                    has_transparency = true;
-                    break;
-                }
+    if (success) {
+        typed_result->temp_texture.flags |= has_transparency ? TEXTURE_FLAG_HAS_TRANSPARENCY : 0;
+        typed_result->name = string_duplicate(load_params->name);
+        typed_result->current_generation = load_params->out_texture->generation;
+        typed_result->layer_count = layer_count;
+        typed_result->layers = decode.layers;
+    } else {
+        for (u32 layer = 0; layer < layer_count; ++layer) {
+            if (decode.loaded[layer]) {
+                resource_system_release(decode.layers[layer]);
             }
         }
-
-        // Insert the pixels into the corresponding "layer".
-        u8* data_location = typed_result->data_block + (layer * layer_size);
-        kcopy_memory(data_location, resource_data->pixels, layer_size);
-
-        resource_system_unload(&image_resource);
+        kfree(decode.layers, sizeof(const resource*) * layer_count, MEMORY_TAG_ARRAY);
     }
+    kfree(decode.layer_codes, sizeof(texture_load_job_code) * layer_count, MEMORY_TAG_ARRAY);
+    kfree(decode.loaded, sizeof(b8) * layer_count, MEMORY_TAG_ARRAY);
 
-    typed_result->temp_texture.flags |= has_transparency ? TEXTURE_FLAG_HAS_TRANSPARENCY : 0;
-    typed_result->name = string_duplicate(load_params->name);
-    typed_result->current_generation = load_params->out_texture->generation;
-    typed_result->layer_count = load_params->layer_count;
-
-    for (u32 i = 0; i < typed_result->layer_count; ++i) {
+texture_load_layered_done:
+    for (u32 i = 0; i < layer_count; ++i) {
         string_free(load_params->layer_names[i]);
     }
-    kfree(load_params->layer_names, sizeof(char*) * load_params->layer_count, MEMORY_TAG_ARRAY);
+    kfree(load_params->layer_names, sizeof(char*) * layer_count, MEMORY_TAG_ARRAY);
     load_params->layer_names = 0;
 
-    return true;
+    return success;
+}
 
-texture_load_layered_failed:
-    // HACK: DRY
-    for (u32 i = 0; i < typed_result->layer_count; ++i) {
-        string_free(load_params->layer_names[i]);
+// Submits a job loading the texture with the given params. One which has to read its image
+// runs on the I/O threads, while one given the image already read only decodes it, so runs as
+// general work.
+static void texture_load_job_submit(texture_load_params* params) {
+    job_type type = params->source_data ? JOB_TYPE_GENERAL : JOB_TYPE_RESOURCE_LOAD;
+    job_info job = job_create_type(texture_load_job_start, texture_load_job_success, texture_load_job_fail, params, sizeof(texture_load_params), sizeof(texture_load_params), type);
+    job_system_submit(job);
+}
+
+static void texture_source_read_complete(b8 success, u8* data, u64 size, void* user_data) {
+    texture_load_params* params = user_data;
+    if (!state_ptr) {
+        // The system has shut down while the read was outstanding.
+        if (data) {
+            kfree(data, size, MEMORY_TAG_RESOURCE);
+        }
+        string_free(params->resource_name);
+        kfree(params, sizeof(texture_load_params), MEMORY_TAG_RESOURCE);
+        return;
     }
-    kfree(load_params->layer_names, sizeof(char*) * load_params->layer_count, MEMORY_TAG_ARRAY);
-    load_params->layer_names = 0;
 
-    if (typed_result->data_block) {
-        kfree(typed_result->data_block, layer_size * load_params->layer_count, MEMORY_TAG_ARRAY);
-        typed_result->data_block = 0;
+    // If the read failed, the job just reads the file itself.
+    if (success) {
+        params->source_data = data;
+        params->source_data_size = size;
     }
-    return false;
+    texture_load_job_submit(params);
+    kfree(params, sizeof(texture_load_params), MEMORY_TAG_RESOURCE);
 }
 
 static b8 load_texture(const char* texture_name, texture* t, const char** layer_names) {
@@ -916,9 +1221,25 @@ static b8 load_texture(const char* texture_name, texture* t, const char** layer_
         params.current_generation = t->generation;
         params.temp_texture = (texture){};
         params.temp_texture.array_size = t->array_size;
+        texture_stream_entry* entry = stream_entry_get(t);
+        if (entry && entry->is_requested) {
+            params.is_streamed = true;
+            params.mip_skip = INVALID_ID;
+        }
 
-        job_info job = job_create(texture_load_job_start, texture_load_job_success, texture_load_job_fail, &params, sizeof(texture_load_params), sizeof(texture_load_params));
-        job_system_submit(job);
+        // Read the source image asynchronously where possible, so the job doesn't tie up
+        // a job thread waiting on the disk. The job is submitted once the read completes.
+        char source_path[512];
+        if (image_loader_source_path(texture_name, source_path)) {
+            texture_load_params* async_params = kallocate(sizeof(texture_load_params), MEMORY_TAG_RESOURCE);
+            *async_params = params;
+            if (filesystem_read_async(source_path, texture_source_read_complete, async_params)) {
+                return true;
+            }
+            kfree(async_params, sizeof(texture_load_params), MEMORY_TAG_RESOURCE);
+        }
+
+        texture_load_job_submit(&params);
     } else if (t->type == TEXTURE_TYPE_2D_ARRAY) {
         texture_load_layered_params params = {0};
         params.layer_count = t->array_size;
@@ -946,7 +1267,257 @@ static b8 load_texture(const char* texture_name, texture* t, const char** layer_
     return true;
 }
 
+// Recreates a streamed texture with the given skip. It stays drawable with the mip levels it has until done.
+static void stream_load(texture* t, texture_stream_entry* entry, u32 skip) {
+    texture_load_params params = {0};
+    params.resource_name = string_duplicate(t->name);
+    params.out_texture = t;
+    params.current_generation = t->generation;
+    params.temp_texture = (texture){};
+    params.temp_texture.array_size = t->array_size;
+    params.is_streamed = true;
+    params.mip_skip = skip;
+    params.keep_resident = true;
+
+    entry->is_loading = true;
+    entry->target_skip = skip;
+    texture_load_job_submit(&params);
+}
+
+void texture_system_streaming_request(texture* t, f32 screen_size) {
+    texture_stream_entry* entry = stream_entry_get(t);
+    if (!entry || !entry->is_streamed) {
+        return;
+    }
+
+    // Leave out each mip level while the next one down still covers the screen size.
+    u32 skip = 0;
+    u32 size = KMAX(entry->width, entry->height);
+    while (skip < entry->low_skip && (f32)(size >> (skip + 1)) >= screen_size) {
+        skip++;
+    }
+
+    if (!entry->has_request || skip < entry->request_skip) {
+        entry->request_skip = skip;
+    }
+    entry->has_request = true;
+    entry->last_request_frame = state_ptr->frame_number;
+}
+
+void texture_system_streaming_budget_set(u64 budget) {
+    if (state_ptr) {
+        state_ptr->config.streaming_budget = budget ? budget : TEXTURE_STREAMING_DEFAULT_BUDGET;
+    }
+}
+
+u64 texture_system_streaming_resident_size(void) {
+    return state_ptr ? state_ptr->streaming_resident_size : 0;
+}
+
+b8 texture_system_update(void* state, struct frame_data* p_frame_data) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    state_ptr->frame_number++;
+
+    if (state_ptr->watches) {
+        texture_watches_update();
+    }
+
+    // Take in the requests made since the last update, and total up the memory in use.
+    u64 resident_size = 0;
+    u32 count = darray_length(state_ptr->streamed_handles);
+    for (u32 i = 0; i < count; ++i) {
+        texture_stream_entry* entry = &state_ptr->stream_entries[state_ptr->streamed_handles[i]];
+        if (entry->has_request) {
+            entry->wanted_skip = entry->request_skip;
+            entry->has_request = false;
+        } else if (state_ptr->frame_number - entry->last_request_frame > TEXTURE_STREAMING_IDLE_FRAMES) {
+            entry->wanted_skip = entry->low_skip;
+        }
+        resident_size += stream_size_get(entry, entry->target_skip);
+    }
+
+    u64 budget = state_ptr->config.streaming_budget;
+    if (state_ptr->pressure_budget) {
+        budget = KMIN(budget, state_ptr->pressure_budget);
+    }
+    u32 load_count = 0;
+
+    // Over budget, so evict mip levels. Those of textures resident in more detail than wanted go first,
+    // then those of the textures least recently requested.
+    while (resident_size > budget && load_count < TEXTURE_STREAMING_MAX_LOADS_PER_FRAME) {
+        u32 victim = INVALID_ID;
+        b8 victim_unwanted = false;
+        u64 victim_age = 0;
+        for (u32 i = 0; i < count; ++i) {
+            texture_stream_entry* entry = &state_ptr->stream_entries[state_ptr->streamed_handles[i]];
+            if (entry->is_loading || entry->target_skip >= entry->low_skip) {
+                continue;
+            }
+            b8 unwanted = entry->wanted_skip > entry->target_skip;
+            u64 age = state_ptr->frame_number - entry->last_request_frame;
+            if (victim == INVALID_ID || (unwanted && !victim_unwanted) || (unwanted == victim_unwanted && age > victim_age)) {
+                victim = i;
+                victim_unwanted = unwanted;
+                victim_age = age;
+            }
+        }
+        if (victim == INVALID_ID) {
+            break;
+        }
+
+        u32 handle = state_ptr->streamed_handles[victim];
+        texture_stream_entry* entry = &state_ptr->stream_entries[handle];
+        u32 skip = victim_unwanted ? entry->wanted_skip : entry->target_skip + 1;
+        resident_size -= stream_size_get(entry, entry->target_skip) - stream_size_get(entry, skip);
+        stream_load(&state_ptr->registered_textures[handle], entry, skip);
+        load_count++;
+    }
+
+    // Load requested mip levels while within budget, starting with the textures furthest from what they want.
+    while (load_count < TEXTURE_STREAMING_MAX_LOADS_PER_FRAME) {
+        u32 best = INVALID_ID;
+        u32 best_deficit = 0;
+        for (u32 i = 0; i < count; ++i) {
+            texture_stream_entry* entry = &state_ptr->stream_entries[state_ptr->streamed_handles[i]];
+            if (entry->is_loading || entry->wanted_skip >= entry->target_skip) {
+                continue;
+            }
+            u32 deficit = entry->target_skip - entry->wanted_skip;
+            if (deficit > best_deficit) {
+                best = i;
+                best_deficit = deficit;
+            }
+        }
+        if (best == INVALID_ID) {
+            break;
+        }
+
+        // Go as far towards the wanted detail as the budget allows.
+        u32 handle = state_ptr->streamed_handles[best];
+        texture_stream_entry* entry = &state_ptr->stream_entries[handle];
+        u64 current_size = stream_size_get(entry, entry->target_skip);
+        u32 skip = entry->wanted_skip;
+        while (skip < entry->target_skip && resident_size + stream_size_get(entry, skip) - current_size > budget) {
+            skip++;
+        }
+        if (skip == entry->target_skip) {
+            break;
+        }
+
+        resident_size += stream_size_get(entry, skip) - current_size;
+        stream_load(&state_ptr->registered_textures[handle], entry, skip);
+        load_count++;
+    }
+
+    state_ptr->streaming_resident_size = resident_size;
+    return true;
+}
+
+// Reloads a texture from its changed image file. It stays drawable as it was until done.
+static void texture_reload(texture* t, texture_stream_entry* entry) {
+    texture_load_params params = {0};
+    params.resource_name = string_duplicate(t->name);
+    params.out_texture = t;
+    params.current_generation = t->generation;
+    params.temp_texture = (texture){};
+    params.temp_texture.array_size = t->array_size;
+    params.keep_resident = true;
+
+    if (entry && entry->is_requested) {
+        // The image may have changed size or lost its baked mip levels, so stream it again from
+        // its low mip levels, as it was first loaded.
+        if (entry->is_streamed) {
+            stream_entry_remove(entry);
+        }
+        entry->is_loading = true;
+        params.is_streamed = true;
+        params.mip_skip = INVALID_ID;
+    }
+
+    texture_load_job_submit(&params);
+}
+
+static void texture_watch_add(texture* t) {
+    if (!state_ptr->watches || t->type != TEXTURE_TYPE_2D || (t->flags & TEXTURE_FLAG_IS_WRITEABLE)) {
+        return;
+    }
+
+    // Baked textures aren't reported as having a source, but their path is still given.
+    char path[512];
+    if (!image_loader_source_path(t->name, path) && !filesystem_exists(path)) {
+        return;
+    }
+
+    texture_watch w = {0};
+    w.handle = t->id;
+    if (resource_system_watch(path, &w.watch_id)) {
+        darray_push(state_ptr->watches, w);
+    }
+}
+
+static void texture_watch_remove(texture* t) {
+    if (!state_ptr->watches) {
+        return;
+    }
+
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watches[i].handle == t->id) {
+            resource_system_unwatch(state_ptr->watches[i].watch_id);
+            // Order doesn't matter, so swap the last one into its place.
+            state_ptr->watches[i] = state_ptr->watches[count - 1];
+            darray_length_set(state_ptr->watches, count - 1);
+            return;
+        }
+    }
+}
+
+// Reloads the textures whose files have changed, once any load of them already in progress is done.
+static void texture_watches_update(void) {
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        texture_watch* w = &state_ptr->watches[i];
+        if (!w->reload_pending) {
+            continue;
+        }
+        texture* t = &state_ptr->registered_textures[w->handle];
+        texture_stream_entry* entry = &state_ptr->stream_entries[w->handle];
+        if (t->generation == INVALID_ID || entry->is_loading) {
+            continue;
+        }
+        w->reload_pending = false;
+        KINFO("Reloading texture '%s'.", t->name);
+        texture_reload(t, entry);
+    }
+}
+
+static b8 texture_system_on_resource_changed(u16 code, void* sender, void* listener_inst, event_context context) {
+    u32 watch_id = context.data.u32[0];
+    u32 count = darray_length(state_ptr->watches);
+    for (u32 i = 0; i < count; ++i) {
+        if (state_ptr->watches[i].watch_id == watch_id) {
+            state_ptr->watches[i].reload_pending = true;
+            return true;
+        }
+    }
+    return false;
+}
+
 static void destroy_texture(texture* t) {
+    texture_watch_remove(t);
+
+    // Stop streaming it, if it was.
+    texture_stream_entry* entry = stream_entry_get(t);
+    if (entry) {
+        if (entry->is_streamed) {
+            stream_entry_remove(entry);
+        }
+        kzero_memory(entry, sizeof(texture_stream_entry));
+    }
+
     // Clean up backend resources.
     renderer_texture_destroy(t);
 
@@ -1001,6 +1572,7 @@ static b8 create_texture(texture* t, texture_type type, u32 width, u32 height, u
                     KERROR("Failed to load texture '%s'.", t->name);
                     return false;
                 }
+                texture_watch_add(t);
             } break;
             default: {
                 KERROR("Unrecognized texture type %u. Cannot process texture reference.", t->type);
@@ -1012,102 +1584,125 @@ static b8 create_texture(texture* t, texture_type type, u32 width, u32 height, u
     return true;
 }
 
-static b8 process_texture_reference(const char* name, i8 reference_diff, b8 auto_release, u32* out_texture_id, b8* needs_creation) {
+static b8 process_texture_reference(kname name, const char* name_str, i8 reference_diff, b8 auto_release, u32* out_texture_id, b8* needs_creation) {
     *out_texture_id = INVALID_ID;
     *needs_creation = false;
     if (state_ptr) {
+        if (!name_str) {
+            name_str = "<unknown>";
+        }
         texture_reference ref;
-        if (hashtable_get(&state_ptr->registered_texture_table, name, &ref)) {
-            // If the reference count starts off at zero, one of two things can be
-            // true. If incrementing references, this means the entry is new. If
-            // decrementing, then the texture doesn't exist _if_ not auto-releasing.
-            if (ref.reference_count == 0 && reference_diff > 0) {
-                if (reference_diff > 0) {
-                    // This can only be changed the first time a texture is loaded.
-                    ref.auto_release = auto_release;
+        if (!hashmap_get_u64(&state_ptr->registered_texture_table, name, &ref)) {
+            if (reference_diff < 0) {
+                KWARN("Tried to release non-existent texture: '%s'", name_str);
+                return false;
+            }
+            // Not yet registered, start off with an empty reference.
+            ref.reference_count = 0;
+            ref.handle = INVALID_ID;
+            ref.auto_release = false;
+        }
+
+        // If the reference count starts off at zero, one of two things can be
+        // true. If incrementing references, this means the entry is new. If
+        // decrementing, then the texture doesn't exist _if_ not auto-releasing.
+        if (ref.reference_count == 0) {
+            if (reference_diff > 0) {
+                // This can only be changed the first time a texture is loaded.
+                ref.auto_release = auto_release;
+            } else {
+                if (ref.auto_release) {
+                    KWARN("Tried to release non-existent texture: '%s'", name_str);
+                    return false;
                 } else {
-                    if (ref.auto_release) {
-                        KWARN("Tried to release non-existent texture: '%s'", name);
-                        return false;
-                    } else {
-                        KWARN("Tried to release a texture where autorelease=false, but references was already 0.");
-                        // Still count this as a success, but warn about it.
-                        return true;
-                    }
+                    KWARN("Tried to release a texture where autorelease=false, but references was already 0.");
+                    // Still count this as a success, but warn about it.
+                    return true;
                 }
             }
+        }
 
-            ref.reference_count += reference_diff;
+        ref.reference_count += reference_diff;
 
-            // Take a copy of the name since it would be wiped out if destroyed,
-            // (as passed in name is generally a pointer to the actual texture's name).
-            char name_copy[TEXTURE_NAME_MAX_LENGTH];
-            string_ncopy(name_copy, name, TEXTURE_NAME_MAX_LENGTH);
+        // If decrementing, this means a release.
+        if (reference_diff < 0) {
+            // Check if the reference count has reached 0. If it has, and the reference
+            // is set to auto-release, destroy the texture.
+            if (ref.reference_count == 0 && ref.auto_release) {
+                texture* t = &state_ptr->registered_textures[ref.handle];
 
-            // If decrementing, this means a release.
-            if (reference_diff < 0) {
-                // Check if the reference count has reached 0. If it has, and the reference
-                // is set to auto-release, destroy the texture.
-                if (ref.reference_count == 0 && ref.auto_release) {
-                    texture* t = &state_ptr->registered_textures[ref.handle];
+                // Destroy/reset texture, and free its slot.
+                destroy_texture(t);
+                slot_map_remove(&state_ptr->texture_slots, slot_map_handle_get(&state_ptr->texture_slots, ref.handle));
 
-                    // Destroy/reset texture.
-                    destroy_texture(t);
+                // The texture is gone, so remove the entry entirely.
+                hashmap_remove_u64(&state_ptr->registered_texture_table, name);
+                // KTRACE("Released texture '%s'., Texture unloaded because reference count=0 and auto_release=true.", name_str);
+                return true;
+            } else {
+                // KTRACE("Released texture '%s', now has a reference count of '%i' (auto_release=%s).", name_str, ref.reference_count, ref.auto_release ? "true" : "false");
+            }
 
-                    // Reset the reference.
-                    ref.handle = INVALID_ID;
-                    ref.auto_release = false;
-                    // KTRACE("Released texture '%s'., Texture unloaded because reference count=0 and auto_release=true.", name_copy);
-                } else {
-                    // KTRACE("Released texture '%s', now has a reference count of '%i' (auto_release=%s).", name_copy, ref.reference_count, ref.auto_release ? "true" : "false");
+        } else {
+            // Incrementing. Check if the handle is new or not.
+            if (ref.handle == INVALID_ID) {
+                // This means no texture exists here. Take a free slot first, and use its index as the handle.
+                slot_map_handle handle = slot_map_insert(&state_ptr->texture_slots, 0);
+                if (handle != SLOT_MAP_INVALID_HANDLE) {
+                    ref.handle = slot_map_handle_index(handle);
+                    *out_texture_id = ref.handle;
                 }
 
-            } else {
-                // Incrementing. Check if the handle is new or not.
-                if (ref.handle == INVALID_ID) {
-                    // This means no texture exists here. Find a free index first.
-                    u32 count = state_ptr->config.max_texture_count;
-
-                    for (u32 i = 0; i < count; ++i) {
-                        if (state_ptr->registered_textures[i].id == INVALID_ID) {
-                            // A free slot has been found. Use its index as the handle.
-                            ref.handle = i;
-                            *out_texture_id = i;
-                            break;
-                        }
-                    }
-
-                    // An empty slot was not found, bleat about it and boot out.
-                    if (*out_texture_id == INVALID_ID) {
-                        KFATAL("process_texture_reference - Texture system cannot hold anymore textures. Adjust configuration to allow more.");
-                        return false;
-                    } else {
-                        // Setup some basic properties on the texture.
-                        texture* t = &state_ptr->registered_textures[ref.handle];
-                        t->id = ref.handle;
-                        t->generation = INVALID_ID;
-                        t->internal_data = 0;
-                        // Make sure to hold onto the texture name.
-                        string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
-                        // KTRACE("Texture '%s' does not yet exist. Created, and ref_count is now %i.", name, ref.reference_count);
-                        *needs_creation = true;
-                    }
+                // An empty slot was not found, bleat about it and boot out.
+                if (*out_texture_id == INVALID_ID) {
+                    KFATAL("process_texture_reference - Texture system cannot hold anymore textures. Adjust configuration to allow more.");
+                    return false;
                 } else {
-                    *out_texture_id = ref.handle;
-                    // KTRACE("Texture '%s' already exists, ref_count increased to %i.", name, ref.reference_count);
+                    // Setup some basic properties on the texture.
+                    texture* t = &state_ptr->registered_textures[ref.handle];
+                    t->id = ref.handle;
+                    t->generation = INVALID_ID;
+                    t->internal_data = 0;
+                    // Make sure to hold onto the texture name.
+                    string_ncopy(t->name, name_str, TEXTURE_NAME_MAX_LENGTH);
+                    // KTRACE("Texture '%s' does not yet exist. Created, and ref_count is now %i.", name_str, ref.reference_count);
+                    *needs_creation = true;
                 }
+            } else {
+                *out_texture_id = ref.handle;
+                // KTRACE("Texture '%s' already exists, ref_count increased to %i.", name_str, ref.reference_count);
             }
+        }
 
-            // Either way, update the entry.
-            hashtable_set(&state_ptr->registered_texture_table, name_copy, &ref);
-            return true;
+        // Either way, update the entry.
+        if (!hashmap_set_u64(&state_ptr->registered_texture_table, name, &ref)) {
+            KERROR("process_texture_reference failed to store reference for name '%s'.", name_str);
+            return false;
         }
+        return true;
+    }
+
+    KERROR("process_texture_reference called before texture system is initialized.");
+    return false;
+}
 
-        // NOTE: This would only happen in the event something went wrong with the state.
-        KERROR("process_texture_reference failed to acquire id for name '%s'. INVALID_ID returned.", name);
+static b8 texture_system_on_gpu_memory_pressure(u16 code, void* sender, void* listener_inst, event_context context) {
+    u64 bytes_to_free = context.data.u64[0];
+    if (!bytes_to_free) {
+        // Eased, so detail may be streamed back in as the usual budget allows.
+        state_ptr->pressure_budget = 0;
         return false;
     }
 
-    KERROR("process_texture_reference called before texture system is initialized.");
+    // Mip levels are evicted over the following updates until streamed textures fit. Each time
+    // pressure is signalled the budget drops further, down to the low mip levels of every texture.
+    u64 resident = state_ptr->streaming_resident_size;
+    if (state_ptr->pressure_budget) {
+        resident = KMIN(resident, state_ptr->pressure_budget);
+    }
+    state_ptr->pressure_budget = KMAX(resident > bytes_to_free ? resident - bytes_to_free : 0, 1);
+    KDEBUG("Streamed textures held to %lluKiB under GPU memory pressure.", state_ptr->pressure_budget / 1024);
+
+    // Other systems may also free memory.
     return false;
 }
@@ -14,14 +14,34 @@
 
 #pragma once
 
+#include "core/kname.h"
 #include "renderer/renderer_types.h"
 
+struct frame_data;
+
 /** @brief The texture system configuration */
 typedef struct texture_system_config {
     /** @brief The maximum number of textures that can be loaded at once. */
     u32 max_texture_count;
+    /**
+     * @brief The number of bytes of GPU memory streamed textures may occupy. Once exceeded, the
+     * mip levels of the textures least recently drawn in detail are evicted. 0 uses TEXTURE_STREAMING_DEFAULT_BUDGET.
+     */
+    u64 streaming_budget;
 } texture_system_config;
 
+/** @brief The default number of bytes of GPU memory streamed textures may occupy. */
+#define TEXTURE_STREAMING_DEFAULT_BUDGET (1024ULL * 1024ULL * 1024ULL)
+
+/** @brief The size of the largest side of the low mip level a streamed texture is first loaded at, and falls back to when not in use. */
+#define TEXTURE_STREAMING_LOW_MIP_SIZE 64
+
+/** @brief The number of frames a streamed texture may go without being requested before its detail is no longer wanted. */
+#define TEXTURE_STREAMING_IDLE_FRAMES 120
+
+/** @brief The maximum number of streamed textures whose residency is changed per frame, so that streaming never causes a spike. */
+#define TEXTURE_STREAMING_MAX_LOADS_PER_FRAME 4
+
 /** @brief The default texture name. */
 #define DEFAULT_TEXTURE_NAME "default"
 
@@ -74,6 +94,31 @@ void texture_system_shutdown(void* state);
  */
 KAPI texture* texture_system_acquire(const char* name, b8 auto_release);
 
+/**
+ * @brief Attempts to acquire a texture with the given name, the mip levels of which are streamed.
+ * Otherwise the same as texture_system_acquire. If the texture has a baked .kbt file with mip levels,
+ * only its low mip levels are loaded at first. Higher ones are loaded as texture_system_streaming_request
+ * asks for them, and evicted again as required to stay within the streaming budget. Textures without
+ * baked mip levels, or which were already acquired without streaming, are loaded in full as usual.
+ *
+ * @param name The name of the texture to find.
+ * @param auto_release Indicates if the texture should auto-release when its reference count is 0.
+ * Only takes effect the first time the texture is acquired.
+ * @return A pointer to the loaded texture. Can be a pointer to the default texture if not found.
+ */
+KAPI texture* texture_system_acquire_streamed(const char* name, b8 auto_release);
+
+/**
+ * @brief Attempts to acquire a texture with the given name. Same as texture_system_acquire,
+ * but avoids rehashing the name.
+ *
+ * @param name The kname of the texture to find. Must have been obtained via kname_create.
+ * @param auto_release Indicates if the texture should auto-release when its reference count is 0.
+ * Only takes effect the first time the texture is acquired.
+ * @return A pointer to the loaded texture. Can be a pointer to the default texture if not found.
+ */
+KAPI texture* texture_system_acquire_by_kname(kname name, b8 auto_release);
+
 /**
  * @brief Attempts to acquire a cubemap texture with the given name. If it has not yet been loaded,
  * this triggers it to load. If the texture is not found, a pointer to the default texture
@@ -125,6 +170,20 @@ KAPI texture* texture_system_acquire_writeable(const char* name, u32 width, u32
  */
 KAPI texture* texture_system_acquire_writeable_arrayed(const char* name, u32 width, u32 height, u8 channel_count, b8 has_transparency, texture_type type, u16 array_size);
 
+/**
+ * @brief Attempts to acquire a storage texture with the given name, which shaders can write to as well
+ * as sample. This does not point to nor attempt to load a texture file. Does also increment the reference counter.
+ * NOTE: Storage textures are always RGBA, 8 bits per channel, with a single mip level, and are not auto-released.
+ *
+ * @param name The name of the texture to acquire.
+ * @param width The texture width in pixels.
+ * @param height The texture height in pixels.
+ * @param type The texture type.
+ * @param array_size The number of "layers" in the texture. Must be 6 for cube textures.
+ * @return A pointer to the generated texture.
+ */
+KAPI texture* texture_system_acquire_storage(const char* name, u32 width, u32 height, texture_type type, u16 array_size);
+
 /**
  * @brief Attempts to acquire an array texture with the given name. This uses the provided array
  * of texture names to load data from each in its own layer. All textures must be be of the same size.
@@ -147,6 +206,14 @@ texture* texture_system_acquire_textures_as_arrayed(const char* name, u32 layer_
  */
 KAPI void texture_system_release(const char* name);
 
+/**
+ * @brief Releases a texture with the given name. Same as texture_system_release,
+ * but avoids rehashing the name.
+ *
+ * @param name The kname of the texture to unload.
+ */
+KAPI void texture_system_release_by_kname(kname name);
+
 /**
  * @brief Wraps the provided internal data in a texture structure using the parameters
  * provided. This is best used for when the renderer system creates internal resources
@@ -200,6 +267,67 @@ KAPI b8 texture_system_resize(texture* t, u32 width, u32 height, b8 regenerate_i
  */
 KAPI b8 texture_system_write_data(texture* t, u32 offset, u32 size, void* data);
 
+/**
+ * @brief Writes the given data to a rectangle of the provided texture, keeping the rest of its
+ * contents. May only be used on writeable textures which have been written in full at least once.
+ *
+ * @param t A pointer to the texture to be written to.
+ * @param x The x coordinate of the rectangle in pixels.
+ * @param y The y coordinate of the rectangle in pixels.
+ * @param width The width of the rectangle in pixels.
+ * @param height The height of the rectangle in pixels.
+ * @param data A pointer to the data to be written, tightly packed row by row.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 texture_system_write_region(texture* t, u32 x, u32 y, u32 width, u32 height, void* data);
+
+/**
+ * @brief Sets what the given texture's contents represent, i.e. TEXTURE_FLAG_IS_SRGB or
+ * TEXTURE_FLAG_IS_NORMAL_MAP, so its mip levels are generated accordingly. Takes effect the next
+ * time its data is loaded, so should be called right after acquiring it. Ignored for default textures.
+ *
+ * @param t A pointer to the texture.
+ * @param content_flags The content flags to be set. Any other flags are ignored.
+ */
+KAPI void texture_system_content_flags_set(texture* t, texture_flag_bits content_flags);
+
+/**
+ * @brief Reports that the given texture is being drawn this frame, and how large it appears on screen.
+ * Used to decide which mip levels of streamed textures should be resident. Ignored for textures
+ * which aren't streamed, so may be called for any texture.
+ *
+ * @param t A pointer to the texture.
+ * @param screen_size The size in pixels covered on screen by the whole texture (i.e. one repeat of
+ * its texture coordinates) along its larger side. Mip levels larger than this are not requested.
+ */
+KAPI void texture_system_streaming_request(texture* t, f32 screen_size);
+
+/**
+ * @brief Sets the number of bytes of GPU memory streamed textures may occupy. If lowered, mip levels
+ * are evicted over the following frames until streamed textures fit within it.
+ *
+ * @param budget The budget in bytes. 0 uses TEXTURE_STREAMING_DEFAULT_BUDGET.
+ */
+KAPI void texture_system_streaming_budget_set(u64 budget);
+
+/**
+ * @brief Obtains the number of bytes of GPU memory occupied by streamed textures, as of the last update.
+ *
+ * @return The number of bytes.
+ */
+KAPI u64 texture_system_streaming_resident_size(void);
+
+/**
+ * @brief Updates the residency of streamed textures: loads the mip levels requested since the last
+ * frame within the streaming budget, and evicts those of the textures least recently used when over it.
+ * At most TEXTURE_STREAMING_MAX_LOADS_PER_FRAME textures are changed per frame.
+ *
+ * @param state The state block of memory for this system.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @return True on success; otherwise false.
+ */
+b8 texture_system_update(void* state, struct frame_data* p_frame_data);
+
 /**
  * @brief Indicates if the passed-in texture is a default texture.
  * Will return false if texture system is not yet initialized.
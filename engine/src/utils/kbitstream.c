@@ -0,0 +1,155 @@
+#include "kbitstream.h"
+
+#include "math/kmath.h"
+
+// The range of each of the three smallest components of a normalized quaternion.
+#define QUAT_COMPONENT_MAX 0.70710678118f
+
+void kbitstream_create(void* data, u32 capacity, kbitstream* out_stream) {
+    out_stream->data = data;
+    out_stream->capacity = capacity;
+    out_stream->bit_position = 0;
+    out_stream->overflowed = false;
+}
+
+void kbitstream_write_bits(kbitstream* stream, u32 value, u32 bit_count) {
+    if (stream->overflowed || bit_count == 0) {
+        return;
+    }
+    if (kbitstream_bits_remaining(stream) < bit_count) {
+        stream->overflowed = true;
+        return;
+    }
+    if (bit_count < 32) {
+        value &= (1u << bit_count) - 1;
+    }
+
+    // Fill the rest of the current byte, then whole bytes after it.
+    while (bit_count) {
+        u32 byte_index = stream->bit_position >> 3;
+        u32 bit_offset = stream->bit_position & 7;
+        u32 count = KMIN(8 - bit_offset, bit_count);
+        u8 mask = (u8)(((1u << count) - 1) << bit_offset);
+        stream->data[byte_index] = (u8)((stream->data[byte_index] & ~mask) | ((value << bit_offset) & mask));
+        value >>= count;
+        bit_count -= count;
+        stream->bit_position += count;
+    }
+}
+
+u32 kbitstream_read_bits(kbitstream* stream, u32 bit_count) {
+    if (stream->overflowed || bit_count == 0) {
+        return 0;
+    }
+    if (kbitstream_bits_remaining(stream) < bit_count) {
+        stream->overflowed = true;
+        return 0;
+    }
+
+    u32 value = 0;
+    u32 shift = 0;
+    while (bit_count) {
+        u32 byte_index = stream->bit_position >> 3;
+        u32 bit_offset = stream->bit_position & 7;
+        u32 count = KMIN(8 - bit_offset, bit_count);
+        u32 bits = (stream->data[byte_index] >> bit_offset) & ((1u << count) - 1);
+        value |= bits << shift;
+        shift += count;
+        bit_count -= count;
+        stream->bit_position += count;
+    }
+    return value;
+}
+
+void kbitstream_write_bool(kbitstream* stream, b8 value) {
+    kbitstream_write_bits(stream, value ? 1 : 0, 1);
+}
+
+b8 kbitstream_read_bool(kbitstream* stream) {
+    return kbitstream_read_bits(stream, 1) != 0;
+}
+
+void kbitstream_write_varint(kbitstream* stream, u32 value, u32 bits_per_group) {
+    u32 mask = (1u << bits_per_group) - 1;
+    do {
+        kbitstream_write_bits(stream, value & mask, bits_per_group);
+        value = bits_per_group < 32 ? value >> bits_per_group : 0;
+        kbitstream_write_bool(stream, value != 0);
+    } while (value && !stream->overflowed);
+}
+
+u32 kbitstream_read_varint(kbitstream* stream, u32 bits_per_group) {
+    u32 value = 0;
+    u32 shift = 0;
+    do {
+        u32 group = kbitstream_read_bits(stream, bits_per_group);
+        if (shift < 32) {
+            value |= group << shift;
+        }
+        shift += bits_per_group;
+    } while (kbitstream_read_bool(stream));
+    return value;
+}
+
+u32 kquantize_f32(f32 value, f32 min, f32 max, u32 bit_count) {
+    u64 steps = (1ull << bit_count) - 1;
+    f32 t = max > min ? (value - min) / (max - min) : 0.0f;
+    t = KCLAMP(t, 0.0f, 1.0f);
+    return (u32)(t * (f64)steps + 0.5);
+}
+
+f32 kdequantize_f32(u32 quantized, f32 min, f32 max, u32 bit_count) {
+    u64 steps = (1ull << bit_count) - 1;
+    return min + (f32)((f64)quantized / (f64)steps) * (max - min);
+}
+
+u32 kquantize_quat(quat rotation, u32 component_bits) {
+    f32 components[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+
+    u32 largest = 0;
+    for (u32 i = 1; i < 4; ++i) {
+        if (kabs(components[i]) > kabs(components[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, so the dropped component is always made positive.
+    f32 sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    u32 result = largest;
+    u32 shift = 2;
+    for (u32 i = 0; i < 4; ++i) {
+        if (i != largest) {
+            result |= kquantize_f32(components[i] * sign, -QUAT_COMPONENT_MAX, QUAT_COMPONENT_MAX, component_bits) << shift;
+            shift += component_bits;
+        }
+    }
+    return result;
+}
+
+quat kdequantize_quat(u32 quantized, u32 component_bits) {
+    u32 largest = quantized & 3;
+    u32 mask = (1u << component_bits) - 1;
+
+    f32 components[4];
+    f32 sum = 0.0f;
+    u32 shift = 2;
+    for (u32 i = 0; i < 4; ++i) {
+        if (i != largest) {
+            components[i] = kdequantize_f32((quantized >> shift) & mask, -QUAT_COMPONENT_MAX, QUAT_COMPONENT_MAX, component_bits);
+            sum += components[i] * components[i];
+            shift += component_bits;
+        }
+    }
+    components[largest] = ksqrt(KMAX(1.0f - sum, 0.0f));
+
+    return quat_normalize((quat){components[0], components[1], components[2], components[3]});
+}
+
+u32 kbitstream_bytes_used(const kbitstream* stream) {
+    return (stream->bit_position + 7) >> 3;
+}
+
+u32 kbitstream_bits_remaining(const kbitstream* stream) {
+    u64 total = (u64)stream->capacity * 8;
+    return stream->bit_position >= total ? 0 : (u32)(total - stream->bit_position);
+}
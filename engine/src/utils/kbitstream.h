@@ -0,0 +1,153 @@
+/**
+ * @file kbitstream.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Packing of values into, and out of, a buffer at the bit level, with the quantization
+ * of floating-point values and rotations to as few bits as they need.
+ * @details Bits are written from the least significant bit of each byte up. A stream which runs
+ * past the end of its buffer is marked as overflowed; writes after that point are dropped and
+ * reads return 0, so a sequence of operations only needs checking once at the end.
+ * @version 1.0
+ * @date 2023-12-12
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+/** @brief A stream of bits over a buffer, for either reading or writing. */
+typedef struct kbitstream {
+    /** @brief The buffer. Not owned by the stream. */
+    u8* data;
+    /** @brief The size of the buffer in bytes. */
+    u32 capacity;
+    /** @brief The position of the next bit to be read or written. */
+    u32 bit_position;
+    /** @brief Indicates if an operation ran past the end of the buffer. */
+    b8 overflowed;
+} kbitstream;
+
+/**
+ * @brief Creates a stream over the given buffer, positioned at its start. Writing does not
+ * clear the buffer first, so it should be zeroed if it is to be written to.
+ *
+ * @param data The buffer. Required.
+ * @param capacity The size of the buffer in bytes.
+ * @param out_stream A pointer to hold the stream. Required.
+ */
+KAPI void kbitstream_create(void* data, u32 capacity, kbitstream* out_stream);
+
+/**
+ * @brief Writes the lowest bits of the given value.
+ *
+ * @param stream A pointer to the stream.
+ * @param value The value. Bits above bit_count are ignored.
+ * @param bit_count The number of bits to write, from 1 to 32.
+ */
+KAPI void kbitstream_write_bits(kbitstream* stream, u32 value, u32 bit_count);
+
+/**
+ * @brief Reads a value of the given number of bits.
+ *
+ * @param stream A pointer to the stream.
+ * @param bit_count The number of bits to read, from 1 to 32.
+ * @return The value, or 0 if the stream has overflowed.
+ */
+KAPI u32 kbitstream_read_bits(kbitstream* stream, u32 bit_count);
+
+/**
+ * @brief Writes a single bit.
+ *
+ * @param stream A pointer to the stream.
+ * @param value The value of the bit.
+ */
+KAPI void kbitstream_write_bool(kbitstream* stream, b8 value);
+
+/**
+ * @brief Reads a single bit.
+ *
+ * @param stream A pointer to the stream.
+ * @return The value of the bit.
+ */
+KAPI b8 kbitstream_read_bool(kbitstream* stream);
+
+/**
+ * @brief Writes an unsigned value in as few bits as it needs: groups of bits_per_group, each
+ * followed by a bit indicating if another follows. Suited to values which are usually small.
+ *
+ * @param stream A pointer to the stream.
+ * @param value The value.
+ * @param bits_per_group The number of bits of the value in each group, from 1 to 31.
+ */
+KAPI void kbitstream_write_varint(kbitstream* stream, u32 value, u32 bits_per_group);
+
+/**
+ * @brief Reads a value written with kbitstream_write_varint.
+ *
+ * @param stream A pointer to the stream.
+ * @param bits_per_group The number of bits per group it was written with.
+ * @return The value.
+ */
+KAPI u32 kbitstream_read_varint(kbitstream* stream, u32 bits_per_group);
+
+/**
+ * @brief Quantizes the given value to an integer of the given number of bits over the given range.
+ * Values outside of the range are clamped to it.
+ *
+ * @param value The value.
+ * @param min The lowest value of the range.
+ * @param max The highest value of the range.
+ * @param bit_count The number of bits, from 1 to 32.
+ * @return The quantized value.
+ */
+KAPI u32 kquantize_f32(f32 value, f32 min, f32 max, u32 bit_count);
+
+/**
+ * @brief Obtains the value given quantized by kquantize_f32.
+ *
+ * @param quantized The quantized value.
+ * @param min The lowest value of the range.
+ * @param max The highest value of the range.
+ * @param bit_count The number of bits it was quantized to.
+ * @return The value, to within half of a step of the range.
+ */
+KAPI f32 kdequantize_f32(u32 quantized, f32 min, f32 max, u32 bit_count);
+
+/**
+ * @brief Quantizes the given rotation using the "smallest three" method: the largest component
+ * is dropped, as it can be recovered from the others, and its index stored in 2 bits followed by
+ * the remaining three, each of which lies within +/- 1/sqrt(2).
+ *
+ * @param rotation The rotation. Should be normalized.
+ * @param component_bits The number of bits for each remaining component, from 2 to 10.
+ * @return The quantized rotation, in 2 + 3 * component_bits bits.
+ */
+KAPI u32 kquantize_quat(quat rotation, u32 component_bits);
+
+/**
+ * @brief Obtains the rotation given quantized by kquantize_quat.
+ *
+ * @param quantized The quantized rotation.
+ * @param component_bits The number of bits for each remaining component it was quantized with.
+ * @return The normalized rotation.
+ */
+KAPI quat kdequantize_quat(u32 quantized, u32 component_bits);
+
+/**
+ * @brief Obtains the number of bytes of the buffer used so far, including a partly used last byte.
+ *
+ * @param stream A constant pointer to the stream.
+ * @return The number of bytes used.
+ */
+KAPI u32 kbitstream_bytes_used(const kbitstream* stream);
+
+/**
+ * @brief Obtains the number of bits which remain to be read or written before the end of the buffer.
+ *
+ * @param stream A constant pointer to the stream.
+ * @return The number of bits remaining.
+ */
+KAPI u32 kbitstream_bits_remaining(const kbitstream* stream);
@@ -1,6 +1,8 @@
 #include "ksort.h"
 
 #include "core/kmemory.h"
+#include "math/kmath.h"
+#include "systems/job_system.h"
 
 void ptr_swap(void* scratch_mem, u64 size, void* a, void* b) {
     kcopy_memory(scratch_mem, a, size);
@@ -12,39 +14,315 @@ static void* data_at_index(void* block, u64 element_size, u32 index) {
     return (void*)(((u64)block) + (element_size * index));
 }
 
-static i32 kquick_sort_partition(void* scratch_mem, u64 size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
-    void* pivot = data_at_index(data, size, high_index);
+// Ranges up to this size are finished off with an insertion sort.
+#define KSORT_INSERTION_THRESHOLD 16
 
-    i32 i = (low_index - 1);
-    void* datai = data_at_index(data, size, i);
+static void insertion_sort(void* scratch_mem, u64 size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
+    for (i32 i = low_index + 1; i <= high_index; ++i) {
+        kcopy_memory(scratch_mem, data_at_index(data, size, i), size);
+        i32 j = i - 1;
+        while (j >= low_index && compare_pfn(data_at_index(data, size, j), scratch_mem) > 0) {
+            kcopy_memory(data_at_index(data, size, j + 1), data_at_index(data, size, j), size);
+            j--;
+        }
+        kcopy_memory(data_at_index(data, size, j + 1), scratch_mem, size);
+    }
+}
 
-    for (i32 j = low_index; j <= high_index - 1; ++j) {
-        void* dataj = data_at_index(data, size, j);
-        i32 result = compare_pfn(dataj, pivot);
-        if (result < 0) {
-            ptr_swap(scratch_mem, size, datai, dataj);
-        } else if (result > 0) {
-            ptr_swap(scratch_mem, size, dataj, datai);
+static void heap_sift_down(void* scratch_mem, u64 size, void* base, i32 root, i32 count, PFN_kquicksort_compare compare_pfn) {
+    while (true) {
+        i32 child = root * 2 + 1;
+        if (child >= count) {
+            return;
+        }
+        if (child + 1 < count && compare_pfn(data_at_index(base, size, child), data_at_index(base, size, child + 1)) < 0) {
+            child++;
+        }
+        if (compare_pfn(data_at_index(base, size, root), data_at_index(base, size, child)) >= 0) {
+            return;
         }
+        ptr_swap(scratch_mem, size, data_at_index(base, size, root), data_at_index(base, size, child));
+        root = child;
     }
-    ptr_swap(scratch_mem, size, data_at_index(data, size, i + 1), data_at_index(data, size, high_index));
-    return i + 1;
 }
 
-static void kquick_sort_internal(void* scratch_mem, u64 size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
-    if (low_index < high_index) {
-        i32 partition_index = kquick_sort_partition(scratch_mem, size, data, low_index, high_index, compare_pfn);
-        kquick_sort_internal(scratch_mem, size, data, low_index, partition_index - 1, compare_pfn);
-        kquick_sort_internal(scratch_mem, size, data, partition_index + 1, high_index, compare_pfn);
+static void heap_sort(void* scratch_mem, u64 size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
+    void* base = data_at_index(data, size, low_index);
+    i32 count = high_index - low_index + 1;
+    for (i32 i = count / 2 - 1; i >= 0; --i) {
+        heap_sift_down(scratch_mem, size, base, i, count, compare_pfn);
+    }
+    for (i32 end = count - 1; end > 0; --end) {
+        ptr_swap(scratch_mem, size, base, data_at_index(base, size, end));
+        heap_sift_down(scratch_mem, size, base, 0, end, compare_pfn);
     }
 }
 
+// Partitions the range around the median of its first, middle and last elements, such that every element up to
+// the returned index is no greater than every element after it. The pivot is copied to pivot_mem, as it may move.
+static i32 kquick_sort_partition(void* scratch_mem, void* pivot_mem, u64 size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
+    i32 mid_index = low_index + (high_index - low_index) / 2;
+    void* low = data_at_index(data, size, low_index);
+    void* mid = data_at_index(data, size, mid_index);
+    void* high = data_at_index(data, size, high_index);
+    if (compare_pfn(mid, low) < 0) {
+        ptr_swap(scratch_mem, size, mid, low);
+    }
+    if (compare_pfn(high, low) < 0) {
+        ptr_swap(scratch_mem, size, high, low);
+    }
+    if (compare_pfn(high, mid) < 0) {
+        ptr_swap(scratch_mem, size, high, mid);
+    }
+    kcopy_memory(pivot_mem, mid, size);
+
+    i32 i = low_index - 1;
+    i32 j = high_index + 1;
+    while (true) {
+        do {
+            i++;
+        } while (compare_pfn(data_at_index(data, size, i), pivot_mem) < 0);
+        do {
+            j--;
+        } while (compare_pfn(data_at_index(data, size, j), pivot_mem) > 0);
+        if (i >= j) {
+            return j;
+        }
+        ptr_swap(scratch_mem, size, data_at_index(data, size, i), data_at_index(data, size, j));
+    }
+}
+
+static void kquick_sort_internal(void* scratch_mem, void* pivot_mem, u64 size, void* data, i32 low_index, i32 high_index, u32 depth_limit, PFN_kquicksort_compare compare_pfn) {
+    while (high_index - low_index + 1 > KSORT_INSERTION_THRESHOLD) {
+        // Too many poor pivots, so fall back to a heap sort to bound the worst case.
+        if (depth_limit == 0) {
+            heap_sort(scratch_mem, size, data, low_index, high_index, compare_pfn);
+            return;
+        }
+        depth_limit--;
+
+        // Recurse into the smaller side and loop over the larger, which bounds the stack depth.
+        i32 partition_index = kquick_sort_partition(scratch_mem, pivot_mem, size, data, low_index, high_index, compare_pfn);
+        if (partition_index - low_index < high_index - partition_index) {
+            kquick_sort_internal(scratch_mem, pivot_mem, size, data, low_index, partition_index, depth_limit, compare_pfn);
+            low_index = partition_index + 1;
+        } else {
+            kquick_sort_internal(scratch_mem, pivot_mem, size, data, partition_index + 1, high_index, depth_limit, compare_pfn);
+            high_index = partition_index;
+        }
+    }
+    insertion_sort(scratch_mem, size, data, low_index, high_index, compare_pfn);
+}
+
 void kquick_sort(u64 type_size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn) {
     if (low_index < high_index) {
-        void* scratch_mem = kallocate(type_size, MEMORY_TAG_ARRAY);
-        i32 partition_index = kquick_sort_partition(scratch_mem, type_size, data, low_index, high_index, compare_pfn);
-        kquick_sort_internal(scratch_mem, type_size, data, low_index, partition_index - 1, compare_pfn);
-        kquick_sort_internal(scratch_mem, type_size, data, partition_index + 1, high_index, compare_pfn);
-        kfree(scratch_mem, type_size, MEMORY_TAG_ARRAY);
+        // Allow twice the ideal depth before giving up on quicksort.
+        u32 depth_limit = 0;
+        for (u32 n = (u32)(high_index - low_index + 1); n > 1; n >>= 1) {
+            depth_limit += 2;
+        }
+
+        void* scratch_mem = kallocate(type_size * 2, MEMORY_TAG_ARRAY);
+        void* pivot_mem = (u8*)scratch_mem + type_size;
+        kquick_sort_internal(scratch_mem, pivot_mem, type_size, data, low_index, high_index, depth_limit, compare_pfn);
+        kfree(scratch_mem, type_size * 2, MEMORY_TAG_ARRAY);
+    }
+}
+
+typedef struct kparallel_sort_context {
+    u64 type_size;
+    u32 count;
+    u32 run_length;
+    u8* source;
+    u8* dest;
+    PFN_kquicksort_compare compare_pfn;
+} kparallel_sort_context;
+
+// Sorts each of the runs in the given range in place.
+static void kparallel_sort_runs(u32 start, u32 end, void* user_data) {
+    kparallel_sort_context* context = user_data;
+    for (u32 run = start; run < end; ++run) {
+        u32 low = run * context->run_length;
+        u32 high = KMIN(low + context->run_length, context->count) - 1;
+        kquick_sort(context->type_size, context->source, (i32)low, (i32)high, context->compare_pfn);
+    }
+}
+
+// Merges each pair of runs in the given range from the source into the destination.
+static void kparallel_sort_merge(u32 start, u32 end, void* user_data) {
+    kparallel_sort_context* context = user_data;
+    u64 size = context->type_size;
+    for (u32 pair = start; pair < end; ++pair) {
+        u32 left = pair * context->run_length * 2;
+        u32 middle = KMIN(left + context->run_length, context->count);
+        u32 right_end = KMIN(middle + context->run_length, context->count);
+        u32 l = left;
+        u32 r = middle;
+        u8* out = context->dest + left * size;
+        while (l < middle && r < right_end) {
+            // Take from the left on ties, so the merge itself is stable.
+            if (context->compare_pfn(context->source + r * size, context->source + l * size) < 0) {
+                kcopy_memory(out, context->source + r * size, size);
+                r++;
+            } else {
+                kcopy_memory(out, context->source + l * size, size);
+                l++;
+            }
+            out += size;
+        }
+        if (l < middle) {
+            kcopy_memory(out, context->source + l * size, (middle - l) * size);
+        } else if (r < right_end) {
+            kcopy_memory(out, context->source + r * size, (right_end - r) * size);
+        }
+    }
+}
+
+void kparallel_sort(u64 type_size, void* data, u32 count, PFN_kquicksort_compare compare_pfn) {
+    if (count < KSORT_PARALLEL_MIN_COUNT) {
+        if (count > 1) {
+            kquick_sort(type_size, data, 0, (i32)count - 1, compare_pfn);
+        }
+        return;
+    }
+
+    kparallel_sort_context context = {0};
+    context.type_size = type_size;
+    context.count = count;
+    context.compare_pfn = compare_pfn;
+    context.run_length = KMAX(KSORT_PARALLEL_MIN_RUN_LENGTH, (count + KSORT_PARALLEL_MAX_RUNS - 1) / KSORT_PARALLEL_MAX_RUNS);
+
+    // Sort the runs in parallel.
+    u32 run_count = (count + context.run_length - 1) / context.run_length;
+    context.source = data;
+    job_parallel_for(run_count, 1, kparallel_sort_runs, &context);
+
+    // Then merge pairs of them in parallel, back and forth between the data and a scratch copy, until one is left.
+    u8* scratch = kallocate(type_size * count, MEMORY_TAG_ARRAY);
+    context.dest = scratch;
+    while (context.run_length < count) {
+        u32 pair_count = (count + context.run_length * 2 - 1) / (context.run_length * 2);
+        job_parallel_for(pair_count, 1, kparallel_sort_merge, &context);
+        u8* temp = context.source;
+        context.source = context.dest;
+        context.dest = temp;
+        context.run_length = (u64)context.run_length * 2 >= count ? count : context.run_length * 2;
+    }
+
+    if (context.source != data) {
+        kcopy_memory(data, context.source, type_size * count);
+    }
+    kfree(scratch, type_size * count, MEMORY_TAG_ARRAY);
+}
+
+void kradix_sort_u32(u32 count, u32* keys, u32* values, u32* scratch_keys, u32* scratch_values) {
+    if (count < 2) {
+        return;
+    }
+
+    // Count the occurrences of each value of every byte in a single pass.
+    u32 histograms[4][256];
+    kzero_memory(histograms, sizeof(histograms));
+    for (u32 i = 0; i < count; ++i) {
+        u32 key = keys[i];
+        for (u32 b = 0; b < 4; ++b) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    u32* src_keys = keys;
+    u32* src_values = values;
+    u32* dst_keys = scratch_keys;
+    u32* dst_values = scratch_values;
+    for (u32 b = 0; b < 4; ++b) {
+        u32* histogram = histograms[b];
+        u32 shift = b * 8;
+        // If every key has the same value for this byte, the pass would change nothing.
+        if (histogram[(src_keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        // Turn the counts into the offset of each bucket.
+        u32 offset = 0;
+        for (u32 i = 0; i < 256; ++i) {
+            u32 bucket_count = histogram[i];
+            histogram[i] = offset;
+            offset += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 target = histogram[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[target] = src_keys[i];
+            dst_values[target] = src_values[i];
+        }
+
+        u32* temp_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = temp_keys;
+        u32* temp_values = src_values;
+        src_values = dst_values;
+        dst_values = temp_values;
+    }
+
+    // After an odd number of passes, the results are in the scratch arrays.
+    if (src_keys != keys) {
+        kcopy_memory(keys, src_keys, sizeof(u32) * count);
+        kcopy_memory(values, src_values, sizeof(u32) * count);
+    }
+}
+
+void kradix_sort_u64(u32 count, u64* keys, u32* values, u64* scratch_keys, u32* scratch_values) {
+    if (count < 2) {
+        return;
+    }
+
+    // Count the occurrences of each value of every byte in a single pass.
+    u32 histograms[8][256];
+    kzero_memory(histograms, sizeof(histograms));
+    for (u32 i = 0; i < count; ++i) {
+        u64 key = keys[i];
+        for (u32 b = 0; b < 8; ++b) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    u64* src_keys = keys;
+    u32* src_values = values;
+    u64* dst_keys = scratch_keys;
+    u32* dst_values = scratch_values;
+    for (u32 b = 0; b < 8; ++b) {
+        u32* histogram = histograms[b];
+        u32 shift = b * 8;
+        // If every key has the same value for this byte, the pass would change nothing.
+        if (histogram[(src_keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        // Turn the counts into the offset of each bucket.
+        u32 offset = 0;
+        for (u32 i = 0; i < 256; ++i) {
+            u32 bucket_count = histogram[i];
+            histogram[i] = offset;
+            offset += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 target = histogram[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[target] = src_keys[i];
+            dst_values[target] = src_values[i];
+        }
+
+        u64* temp_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = temp_keys;
+        u32* temp_values = src_values;
+        src_values = dst_values;
+        dst_values = temp_values;
+    }
+
+    // After an odd number of passes, the results are in the scratch arrays.
+    if (src_keys != keys) {
+        kcopy_memory(keys, src_keys, sizeof(u64) * count);
+        kcopy_memory(values, src_values, sizeof(u32) * count);
     }
 }
@@ -6,4 +6,63 @@ typedef i32 (*PFN_kquicksort_compare)(void* a, void* b);
 
 KAPI void ptr_swap(void* scratch_mem, u64 size, void* a, void* b);
 
+/** @brief Arrays of fewer elements than this are sorted by kparallel_sort on the calling thread alone. */
+#define KSORT_PARALLEL_MIN_COUNT 4096
+/** @brief The minimum number of elements sorted by each job of kparallel_sort before merging. */
+#define KSORT_PARALLEL_MIN_RUN_LENGTH 1024
+/** @brief The maximum number of runs kparallel_sort splits an array into before merging. */
+#define KSORT_PARALLEL_MAX_RUNS 16
+
+/**
+ * @brief Sorts the elements in the given inclusive range in place, in ascending order as
+ * determined by the compare function. This is an introsort: a quicksort using median-of-three
+ * pivots, which falls back to a heap sort when partitions keep coming out unbalanced and to an
+ * insertion sort for small ranges. It takes O(n log n) time in the worst case, including already
+ * sorted input. The sort is not stable.
+ *
+ * @param type_size The size of each element in bytes.
+ * @param data The array of elements.
+ * @param low_index The index of the first element to be sorted.
+ * @param high_index The index of the last element to be sorted.
+ * @param compare_pfn Returns a negative value if a comes before b, a positive one if after it, or 0 if neither.
+ */
 KAPI void kquick_sort(u64 type_size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn);
+
+/**
+ * @brief Sorts the given array in place, in ascending order as determined by the compare function.
+ * Large arrays are split into runs which are sorted on the job threads with kquick_sort, then
+ * merged in pairs, also in parallel. Smaller ones are sorted with kquick_sort directly. Blocks until
+ * sorted, and may be called from within a job. The sort is not stable.
+ *
+ * @param type_size The size of each element in bytes.
+ * @param data The array of elements.
+ * @param count The number of elements.
+ * @param compare_pfn Returns a negative value if a comes before b, a positive one if after it, or 0 if neither.
+ */
+KAPI void kparallel_sort(u64 type_size, void* data, u32 count, PFN_kquicksort_compare compare_pfn);
+
+/**
+ * @brief Sorts the given keys in ascending order, along with a value for each, using a least
+ * significant digit radix sort. The sort is stable, and takes linear time in the number of keys.
+ * Passes over bytes which are the same in every key are skipped.
+ *
+ * @param count The number of keys.
+ * @param keys The array of count keys to be sorted.
+ * @param values The array of count values, moved along with their keys.
+ * @param scratch_keys An array of count keys used while sorting.
+ * @param scratch_values An array of count values used while sorting.
+ */
+KAPI void kradix_sort_u32(u32 count, u32* keys, u32* values, u32* scratch_keys, u32* scratch_values);
+
+/**
+ * @brief Sorts the given keys in ascending order, along with a value for each, using a least
+ * significant digit radix sort. The sort is stable, and takes linear time in the number of keys.
+ * Passes over bytes which are the same in every key are skipped.
+ *
+ * @param count The number of keys.
+ * @param keys The array of count keys to be sorted.
+ * @param values The array of count values, moved along with their keys.
+ * @param scratch_keys An array of count keys used while sorting.
+ * @param scratch_values An array of count values used while sorting.
+ */
+KAPI void kradix_sort_u64(u32 count, u64* keys, u32* values, u64* scratch_keys, u32* scratch_values);
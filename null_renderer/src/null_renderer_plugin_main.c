@@ -0,0 +1,109 @@
+#include "null_renderer_plugin_main.h"
+
+#include <core/kmemory.h>
+
+#include "renderer/null/null_backend.h"
+
+b8 plugin_create(renderer_plugin* out_plugin) {
+    out_plugin->initialize = null_renderer_backend_initialize;
+    out_plugin->shutdown = null_renderer_backend_shutdown;
+    out_plugin->frame_prepare = null_renderer_frame_prepare;
+    out_plugin->begin = null_renderer_begin;
+    out_plugin->end = null_renderer_end;
+    out_plugin->present = null_renderer_present;
+    out_plugin->viewport_set = null_renderer_viewport_set;
+    out_plugin->viewport_reset = null_renderer_viewport_reset;
+    out_plugin->scissor_set = null_renderer_scissor_set;
+    out_plugin->scissor_reset = null_renderer_scissor_reset;
+
+    out_plugin->winding_set = null_renderer_winding_set;
+    out_plugin->set_stencil_test_enabled = null_renderer_set_stencil_test_enabled;
+    out_plugin->set_depth_test_enabled = null_renderer_set_depth_test_enabled;
+    out_plugin->set_depth_compare_op = null_renderer_set_depth_compare_op;
+    out_plugin->set_stencil_reference = null_renderer_set_stencil_reference;
+    out_plugin->set_stencil_op = null_renderer_set_stencil_op;
+    out_plugin->set_stencil_compare_mask = null_renderer_set_stencil_compare_mask;
+    out_plugin->set_stencil_write_mask = null_renderer_set_stencil_write_mask;
+
+    out_plugin->renderpass_begin = null_renderer_renderpass_begin;
+    out_plugin->renderpass_end = null_renderer_renderpass_end;
+    out_plugin->resized = null_renderer_backend_on_resized;
+    out_plugin->texture_create = null_renderer_texture_create;
+    out_plugin->texture_create_layered = null_renderer_texture_create_layered;
+    out_plugin->texture_format_supported = null_renderer_texture_format_supported;
+    out_plugin->texture_destroy = null_renderer_texture_destroy;
+    out_plugin->texture_create_writeable = null_renderer_texture_create_writeable;
+    out_plugin->texture_resize = null_renderer_texture_resize;
+    out_plugin->texture_write_data = null_renderer_texture_write_data;
+    out_plugin->texture_write_region = null_renderer_texture_write_region;
+    out_plugin->texture_read_data = null_renderer_texture_read_data;
+    out_plugin->texture_read_pixel = null_renderer_texture_read_pixel;
+    out_plugin->texture_read_pixel_async = null_renderer_texture_read_pixel_async;
+    out_plugin->readback_resolve = null_renderer_readback_resolve;
+
+    out_plugin->shader_create = null_renderer_shader_create;
+    out_plugin->shader_destroy = null_renderer_shader_destroy;
+    out_plugin->shader_uniform_set = null_renderer_uniform_set;
+    out_plugin->shader_initialize = null_renderer_shader_initialize;
+    out_plugin->shader_reload = null_renderer_shader_reload;
+    out_plugin->shader_use = null_renderer_shader_use;
+    out_plugin->shader_vertex_format_set = null_renderer_shader_vertex_format_set;
+    out_plugin->shader_bind_globals = null_renderer_shader_bind_globals;
+    out_plugin->shader_bind_instance = null_renderer_shader_bind_instance;
+    out_plugin->shader_bind_local = null_renderer_shader_bind_local;
+
+    out_plugin->shader_apply_globals = null_renderer_shader_apply_globals;
+    out_plugin->shader_apply_instance = null_renderer_shader_apply_instance;
+    out_plugin->shader_apply_local = null_renderer_shader_apply_local;
+    out_plugin->shader_local_block_push = null_renderer_shader_local_block_push;
+    out_plugin->shader_variant_use = null_renderer_shader_variant_use;
+    out_plugin->shader_dispatch = null_renderer_shader_dispatch;
+    out_plugin->shader_instance_resources_acquire = null_renderer_shader_instance_resources_acquire;
+    out_plugin->shader_instance_resources_release = null_renderer_shader_instance_resources_release;
+
+    out_plugin->texture_map_resources_acquire = null_renderer_texture_map_resources_acquire;
+    out_plugin->texture_map_resources_release = null_renderer_texture_map_resources_release;
+    out_plugin->bindless_textures_supported = null_renderer_bindless_textures_supported;
+    out_plugin->texture_map_bindless_index_get = null_renderer_texture_map_bindless_index_get;
+
+    out_plugin->render_target_create = null_renderer_render_target_create;
+    out_plugin->render_target_destroy = null_renderer_render_target_destroy;
+
+    out_plugin->renderpass_create = null_renderer_renderpass_create;
+    out_plugin->renderpass_destroy = null_renderer_renderpass_destroy;
+    out_plugin->window_attachment_get = null_renderer_window_attachment_get;
+    out_plugin->depth_attachment_get = null_renderer_depth_attachment_get;
+    out_plugin->window_attachment_index_get = null_renderer_window_attachment_index_get;
+    out_plugin->window_attachment_count_get = null_renderer_window_attachment_count_get;
+    out_plugin->is_multithreaded = null_renderer_is_multithreaded;
+    out_plugin->command_list_begin = null_renderer_command_list_begin;
+    out_plugin->command_list_end = null_renderer_command_list_end;
+    out_plugin->command_list_execute = null_renderer_command_list_execute;
+    out_plugin->flag_enabled_get = null_renderer_flag_enabled_get;
+    out_plugin->flag_enabled_set = null_renderer_flag_enabled_set;
+    out_plugin->swapchain_settings_get = null_renderer_swapchain_settings_get;
+    out_plugin->swapchain_settings_set = null_renderer_swapchain_settings_set;
+
+    out_plugin->renderbuffer_internal_create = null_renderer_buffer_create_internal;
+    out_plugin->renderbuffer_internal_destroy = null_renderer_buffer_destroy_internal;
+    out_plugin->renderbuffer_bind = null_renderer_buffer_bind;
+    out_plugin->renderbuffer_unbind = null_renderer_buffer_unbind;
+    out_plugin->renderbuffer_map_memory = null_renderer_buffer_map_memory;
+    out_plugin->renderbuffer_unmap_memory = null_renderer_buffer_unmap_memory;
+    out_plugin->renderbuffer_flush = null_renderer_buffer_flush;
+    out_plugin->renderbuffer_read = null_renderer_buffer_read;
+    out_plugin->renderbuffer_resize = null_renderer_buffer_resize;
+    out_plugin->renderbuffer_load_range = null_renderer_buffer_load_range;
+    out_plugin->renderbuffer_copy_range = null_renderer_buffer_copy_range;
+    out_plugin->renderbuffer_draw = null_renderer_buffer_draw;
+    out_plugin->renderbuffer_draw_instanced = null_renderer_buffer_draw_instanced;
+    out_plugin->indirect_draw_supported = null_renderer_buffer_indirect_draw_supported;
+    out_plugin->multiview_supported = null_renderer_renderpass_multiview_supported;
+    out_plugin->renderbuffer_draw_indirect = null_renderer_buffer_draw_indirect;
+
+    return true;
+}
+
+void plugin_destroy(renderer_plugin* plugin) {
+    kzero_memory(plugin, sizeof(renderer_plugin));
+}
@@ -0,0 +1,896 @@
+#include "null_backend.h"
+
+#include <containers/darray.h>
+#include <core/event.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <core/metrics.h>
+#include <math/kmath.h>
+#include <renderer/renderer_utils.h>
+#include <systems/shader_system.h>
+#include <systems/texture_system.h>
+
+#include "null_types.h"
+
+// The size a texture would occupy in device memory, including its mip chain.
+static u64 texture_size_get(const texture* t, u32 width, u32 height) {
+    u32 layer_count = t->type == TEXTURE_TYPE_CUBE ? 6 : KMAX(t->array_size, 1);
+    u32 mip_levels = KMAX(t->mip_levels, 1);
+    if (texture_format_is_compressed(t->format) || (t->flags & TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS)) {
+        return texture_format_chain_size(t->format, width, height, mip_levels) * layer_count;
+    }
+
+    u64 size = 0;
+    for (u32 i = 0; i < mip_levels; ++i) {
+        size += (u64)KMAX(width >> i, 1) * KMAX(height >> i, 1) * t->channel_count;
+    }
+    return size * layer_count;
+}
+
+static void texture_memory_track(null_context* context, null_texture* internal, u64 size) {
+    internal->size = size;
+    context->stats.texture_count++;
+    context->stats.texture_bytes += size;
+    kallocate_report(size, MEMORY_TAG_GPU_LOCAL);
+}
+
+static void texture_memory_untrack(null_context* context, null_texture* internal) {
+    context->stats.texture_count--;
+    context->stats.texture_bytes -= internal->size;
+    kfree_report(internal->size, MEMORY_TAG_GPU_LOCAL);
+    internal->size = 0;
+}
+
+// Creates the colour and depth textures standing in for swapchain images.
+static void window_attachments_create(null_context* context) {
+    for (u32 i = 0; i < NULL_RENDERER_WINDOW_ATTACHMENT_COUNT; ++i) {
+        char name[TEXTURE_NAME_MAX_LENGTH] = {0};
+        string_format(name, "__internal_null_swapchain_image_%u__", i);
+        null_texture* colour = kallocate(sizeof(null_texture), MEMORY_TAG_TEXTURE);
+        texture_system_wrap_internal(name, context->framebuffer_width, context->framebuffer_height, 4, false, true, false, colour, &context->render_textures[i]);
+        texture_memory_track(context, colour, (u64)context->framebuffer_width * context->framebuffer_height * 4);
+
+        string_format(name, "__kohi_default_depth_stencil_texture_%u", i);
+        null_texture* depth = kallocate(sizeof(null_texture), MEMORY_TAG_TEXTURE);
+        texture_system_wrap_internal(name, context->framebuffer_width, context->framebuffer_height, 4, false, true, false, depth, &context->depth_textures[i]);
+        texture_memory_track(context, depth, (u64)context->framebuffer_width * context->framebuffer_height * 4);
+    }
+}
+
+// Resizes the window attachments to the current framebuffer size, as recreating a swapchain would.
+static void window_attachments_resize(null_context* context) {
+    u32 width = context->framebuffer_width;
+    u32 height = context->framebuffer_height;
+    for (u32 i = 0; i < NULL_RENDERER_WINDOW_ATTACHMENT_COUNT; ++i) {
+        texture* targets[2] = {&context->render_textures[i], &context->depth_textures[i]};
+        for (u32 t = 0; t < 2; ++t) {
+            null_texture* internal = targets[t]->internal_data;
+            texture_memory_untrack(context, internal);
+            texture_system_resize(targets[t], width, height, false);
+            texture_memory_track(context, internal, (u64)width * height * 4);
+        }
+    }
+}
+
+static void window_attachments_destroy(null_context* context) {
+    for (u32 i = 0; i < NULL_RENDERER_WINDOW_ATTACHMENT_COUNT; ++i) {
+        texture* targets[2] = {&context->render_textures[i], &context->depth_textures[i]};
+        for (u32 t = 0; t < 2; ++t) {
+            if (targets[t]->internal_data) {
+                texture_memory_untrack(context, targets[t]->internal_data);
+                kfree(targets[t]->internal_data, sizeof(null_texture), MEMORY_TAG_TEXTURE);
+                targets[t]->internal_data = 0;
+            }
+        }
+    }
+}
+
+// Resolves the requested swapchain settings as a swapchain would, within the fixed window attachments.
+static void swapchain_settings_apply(null_context* context) {
+    u8 image_count = context->swapchain_settings.image_count ? context->swapchain_settings.image_count : NULL_RENDERER_WINDOW_ATTACHMENT_COUNT;
+    context->image_count = KCLAMP(image_count, 2, NULL_RENDERER_WINDOW_ATTACHMENT_COUNT);
+    u8 frames_in_flight = context->swapchain_settings.frames_in_flight ? context->swapchain_settings.frames_in_flight : NULL_RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+    context->frames_in_flight = KCLAMP(frames_in_flight, 1, context->image_count);
+    context->image_index = 0;
+    context->current_frame = 0;
+}
+
+b8 null_renderer_backend_initialize(renderer_plugin* plugin, const renderer_backend_config* config, u8* out_window_render_target_count) {
+    plugin->internal_context_size = sizeof(null_context);
+    plugin->internal_context = kallocate(plugin->internal_context_size, MEMORY_TAG_RENDERER);
+    null_context* context = (null_context*)plugin->internal_context;
+
+    // Overridden by the first resize, as with any backend.
+    context->framebuffer_width = 800;
+    context->framebuffer_height = 600;
+    context->flags = config->flags;
+    context->swapchain_settings.present_mode = config->present_mode;
+    context->swapchain_settings.image_count = config->swapchain_image_count;
+    context->swapchain_settings.frames_in_flight = config->frames_in_flight;
+    swapchain_settings_apply(context);
+
+    window_attachments_create(context);
+    *out_window_render_target_count = NULL_RENDERER_WINDOW_ATTACHMENT_COUNT;
+
+    context->samplers = darray_create(b8);
+
+    KINFO("Null renderer initialized successfully. No GPU work will be submitted.");
+    return true;
+}
+
+void null_renderer_backend_shutdown(renderer_plugin* plugin) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (!context) {
+        return;
+    }
+
+    window_attachments_destroy(context);
+
+    if (context->samplers) {
+        darray_destroy(context->samplers);
+        context->samplers = 0;
+    }
+
+    if (context->stats.buffer_count || context->stats.texture_count) {
+        KWARN("Null renderer shut down with %u buffers and %u textures still created.", context->stats.buffer_count, context->stats.texture_count);
+    }
+
+    kfree(plugin->internal_context, plugin->internal_context_size, MEMORY_TAG_RENDERER);
+    plugin->internal_context = 0;
+}
+
+void null_renderer_backend_on_resized(renderer_plugin* plugin, u16 width, u16 height) {
+    null_context* context = (null_context*)plugin->internal_context;
+    context->framebuffer_width = width;
+    context->framebuffer_height = height;
+    context->framebuffer_size_generation++;
+}
+
+b8 null_renderer_frame_prepare(renderer_plugin* plugin, struct frame_data* p_frame_data) {
+    null_context* context = (null_context*)plugin->internal_context;
+
+    // Resizes and flag changes recreate the window attachments and skip the frame, as a swapchain recreation does.
+    if (context->framebuffer_size_generation != context->framebuffer_size_last_generation || context->render_flag_changed) {
+        context->render_flag_changed = false;
+        if (context->framebuffer_width == 0 || context->framebuffer_height == 0) {
+            return false;
+        }
+
+        window_attachments_resize(context);
+        swapchain_settings_apply(context);
+        context->framebuffer_size_last_generation = context->framebuffer_size_generation;
+
+        event_context event_context = {0};
+        event_fire(EVENT_CODE_DEFAULT_RENDERTARGET_REFRESH_REQUIRED, 0, event_context);
+        return false;
+    }
+
+    // Each resource is reported as a dedicated allocation.
+    metrics_gpu_memory gpu_memory = {0};
+    gpu_memory.dedicated_count = context->stats.buffer_count + context->stats.texture_count;
+    gpu_memory.dedicated_bytes = context->stats.buffer_bytes + context->stats.texture_bytes;
+    metrics_gpu_memory_set(&gpu_memory);
+
+    return true;
+}
+
+b8 null_renderer_begin(renderer_plugin* plugin, struct frame_data* p_frame_data) {
+    return true;
+}
+
+b8 null_renderer_end(renderer_plugin* plugin, struct frame_data* p_frame_data) {
+    return true;
+}
+
+b8 null_renderer_present(renderer_plugin* plugin, struct frame_data* p_frame_data) {
+    null_context* context = (null_context*)plugin->internal_context;
+    context->image_index = (context->image_index + 1) % context->image_count;
+    context->current_frame = (context->current_frame + 1) % context->frames_in_flight;
+    return true;
+}
+
+void null_renderer_viewport_set(renderer_plugin* plugin, vec4 rect) {
+}
+
+void null_renderer_viewport_reset(renderer_plugin* plugin) {
+}
+
+void null_renderer_scissor_set(renderer_plugin* plugin, vec4 rect) {
+}
+
+void null_renderer_scissor_reset(renderer_plugin* plugin) {
+}
+
+void null_renderer_winding_set(struct renderer_plugin* plugin, renderer_winding winding) {
+}
+
+void null_renderer_set_stencil_test_enabled(struct renderer_plugin* plugin, b8 enabled) {
+}
+
+void null_renderer_set_depth_test_enabled(struct renderer_plugin* plugin, b8 enabled) {
+}
+
+void null_renderer_set_depth_compare_op(struct renderer_plugin* plugin, renderer_compare_op compare_op) {
+}
+
+void null_renderer_set_stencil_reference(struct renderer_plugin* plugin, u32 reference) {
+}
+
+void null_renderer_set_stencil_op(struct renderer_plugin* plugin, renderer_stencil_op fail_op, renderer_stencil_op pass_op, renderer_stencil_op depth_fail_op, renderer_compare_op compare_op) {
+}
+
+void null_renderer_set_stencil_compare_mask(struct renderer_plugin* plugin, u32 compare_mask) {
+}
+
+void null_renderer_set_stencil_write_mask(struct renderer_plugin* plugin, u32 write_mask) {
+}
+
+b8 null_renderer_renderpass_begin(renderer_plugin* plugin, renderpass* pass, render_target* target) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (context->active_renderpass) {
+        KERROR("null_renderer_renderpass_begin - renderpass '%s' begun while '%s' is still active.", pass->name, context->active_renderpass->name);
+        return false;
+    }
+    if (!target || !target->internal_framebuffer) {
+        KERROR("null_renderer_renderpass_begin - renderpass '%s' requires a valid render target.", pass->name);
+        return false;
+    }
+    context->active_renderpass = pass;
+    return true;
+}
+
+b8 null_renderer_renderpass_end(renderer_plugin* plugin, renderpass* pass) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (context->active_renderpass != pass) {
+        KERROR("null_renderer_renderpass_end - renderpass '%s' is not the active renderpass.", pass->name);
+        return false;
+    }
+    context->active_renderpass = 0;
+    return true;
+}
+
+b8 null_renderer_command_list_begin(renderer_plugin* plugin, u8 index) {
+    return true;
+}
+
+b8 null_renderer_command_list_end(renderer_plugin* plugin, u8 index) {
+    return true;
+}
+
+b8 null_renderer_command_list_execute(renderer_plugin* plugin, u8 index) {
+    return true;
+}
+
+void null_renderer_texture_create(renderer_plugin* plugin, const u8* pixels, texture* t) {
+    null_context* context = (null_context*)plugin->internal_context;
+    null_texture* internal = kallocate(sizeof(null_texture), MEMORY_TAG_TEXTURE);
+    t->internal_data = internal;
+    texture_memory_track(context, internal, texture_size_get(t, t->width, t->height));
+
+    // Stands in for uploading the pixels.
+    null_renderer_texture_write_data(plugin, t, 0, (u32)internal->size, pixels);
+
+    t->generation++;
+}
+
+void null_renderer_texture_create_layered(renderer_plugin* plugin, const u8* const* layer_pixels, texture* t) {
+    null_context* context = (null_context*)plugin->internal_context;
+    null_texture* internal = kallocate(sizeof(null_texture), MEMORY_TAG_TEXTURE);
+    t->internal_data = internal;
+    texture_memory_track(context, internal, texture_size_get(t, t->width, t->height));
+
+    // Stands in for uploading the layers.
+    null_renderer_texture_write_data(plugin, t, 0, (u32)internal->size, 0);
+
+    t->generation++;
+}
+
+b8 null_renderer_texture_format_supported(renderer_plugin* plugin, texture_format format) {
+    return true;
+}
+
+void null_renderer_texture_destroy(renderer_plugin* plugin, texture* t) {
+    null_context* context = (null_context*)plugin->internal_context;
+    null_texture* internal = (null_texture*)t->internal_data;
+    if (internal) {
+        texture_memory_untrack(context, internal);
+        kfree(internal, sizeof(null_texture), MEMORY_TAG_TEXTURE);
+    }
+    kzero_memory(t, sizeof(struct texture));
+}
+
+void null_renderer_texture_create_writeable(renderer_plugin* plugin, texture* t) {
+    null_context* context = (null_context*)plugin->internal_context;
+    null_texture* internal = kallocate(sizeof(null_texture), MEMORY_TAG_TEXTURE);
+    t->internal_data = internal;
+    texture_memory_track(context, internal, texture_size_get(t, t->width, t->height));
+    t->generation++;
+}
+
+void null_renderer_texture_resize(renderer_plugin* plugin, texture* t, u32 new_width, u32 new_height) {
+    null_context* context = (null_context*)plugin->internal_context;
+    null_texture* internal = (null_texture*)t->internal_data;
+    if (!internal) {
+        return;
+    }
+
+    // Recalculate mip levels if anything other than 1, as the other backends do.
+    if (t->mip_levels > 1) {
+        t->mip_levels = (u32)(kfloor(klog2(KMAX(new_width, new_height))) + 1);
+    }
+
+    texture_memory_untrack(context, internal);
+    texture_memory_track(context, internal, texture_size_get(t, new_width, new_height));
+    t->generation++;
+}
+
+void null_renderer_texture_write_data(renderer_plugin* plugin, texture* t, u32 offset, u32 size, const u8* pixels) {
+    t->generation++;
+}
+
+void null_renderer_texture_write_region(renderer_plugin* plugin, texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels) {
+    if (texture_format_is_compressed(t->format)) {
+        KERROR("Regions cannot be written to compressed texture '%s'.", t->name);
+        return;
+    }
+    t->generation++;
+}
+
+void null_renderer_texture_read_data(renderer_plugin* plugin, texture* t, u32 offset, u32 size, void** out_memory) {
+    // No pixels are kept, so reads come back cleared.
+    if (out_memory && *out_memory) {
+        kzero_memory(*out_memory, size);
+    }
+}
+
+void null_renderer_texture_read_pixel(renderer_plugin* plugin, texture* t, u32 x, u32 y, u8** out_rgba) {
+    // Pure white, which picking treats as nothing under the cursor.
+    if (out_rgba && *out_rgba) {
+        kset_memory(*out_rgba, 0xFF, sizeof(u8) * 4);
+    }
+}
+
+b8 null_renderer_texture_read_pixel_async(renderer_plugin* plugin, texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket) {
+    null_context* context = (null_context*)plugin->internal_context;
+    *out_ticket = context->next_readback_ticket++;
+    return true;
+}
+
+renderer_readback_status null_renderer_readback_resolve(renderer_plugin* plugin, renderer_readback_ticket ticket, u32 size, void* out_data) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (ticket >= context->next_readback_ticket) {
+        return RENDERER_READBACK_STATUS_INVALID;
+    }
+    // Nothing is waited on, so every read is ready at once. Like synchronous reads, it comes back pure white.
+    kset_memory(out_data, 0xFF, size);
+    return RENDERER_READBACK_STATUS_READY;
+}
+
+b8 null_renderer_shader_create(renderer_plugin* plugin, struct shader* s, const shader_config* config, renderpass* pass) {
+    b8 is_compute = false;
+    for (u8 i = 0; i < config->stage_count; ++i) {
+        if (config->stage_configs[i].stage == SHADER_STAGE_COMPUTE) {
+            is_compute = true;
+        }
+    }
+    if (is_compute && config->stage_count != 1) {
+        KERROR("null_renderer_shader_create: compute shader '%s' must have exactly one stage.", config->name);
+        return false;
+    }
+    if (!is_compute && !pass) {
+        KERROR("null_renderer_shader_create: graphics shader '%s' requires a renderpass.", config->name);
+        return false;
+    }
+
+    s->internal_data = kallocate(sizeof(null_shader), MEMORY_TAG_RENDERER);
+    null_shader* internal = (null_shader*)s->internal_data;
+    internal->max_instances = config->max_instances;
+    if (internal->max_instances) {
+        internal->instance_states = kallocate(sizeof(null_shader_instance_state) * internal->max_instances, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < internal->max_instances; ++i) {
+            internal->instance_states[i].id = INVALID_ID;
+        }
+    }
+
+    s->topology_types = config->topology_types;
+    return true;
+}
+
+void null_renderer_shader_destroy(renderer_plugin* plugin, struct shader* s) {
+    if (!s || !s->internal_data) {
+        return;
+    }
+
+    null_shader* internal = (null_shader*)s->internal_data;
+    if (internal->instance_states) {
+        kfree(internal->instance_states, sizeof(null_shader_instance_state) * internal->max_instances, MEMORY_TAG_ARRAY);
+    }
+    if (internal->uniform_block) {
+        kfree(internal->uniform_block, internal->uniform_block_size, MEMORY_TAG_RENDERER);
+    }
+    kfree(s->internal_data, sizeof(null_shader), MEMORY_TAG_RENDERER);
+    s->internal_data = 0;
+}
+
+b8 null_renderer_shader_initialize(renderer_plugin* plugin, struct shader* s) {
+    null_shader* internal = (null_shader*)s->internal_data;
+
+    s->required_ubo_alignment = NULL_RENDERER_UBO_ALIGNMENT;
+    s->global_ubo_stride = get_aligned(s->global_ubo_size, s->required_ubo_alignment);
+    s->ubo_stride = get_aligned(s->ubo_size, s->required_ubo_alignment);
+
+    // Uniform values are kept here, with the globals first followed by each instance's.
+    internal->uniform_block_size = s->global_ubo_stride + (s->ubo_stride * internal->max_instances);
+    if (internal->uniform_block_size > 0) {
+        internal->uniform_block = kallocate(internal->uniform_block_size, MEMORY_TAG_RENDERER);
+    }
+    s->global_ubo_offset = 0;
+    return true;
+}
+
+b8 null_renderer_shader_reload(renderer_plugin* plugin, struct shader* s) {
+    // No programs are compiled, so there is nothing to recreate.
+    return true;
+}
+
+b8 null_renderer_shader_use(renderer_plugin* plugin, struct shader* s) {
+    return true;
+}
+
+b8 null_renderer_shader_vertex_format_set(renderer_plugin* plugin, struct shader* s, geometry_vertex_format format) {
+    if (format == GEOMETRY_VERTEX_FORMAT_PACKED && !s->packed_attributes) {
+        KERROR("Shader '%s' has no pipeline for vertex format %u.", s->name, format);
+        return false;
+    }
+    return true;
+}
+
+b8 null_renderer_shader_bind_globals(renderer_plugin* plugin, struct shader* s) {
+    if (!s) {
+        return false;
+    }
+    s->bound_ubo_offset = s->global_ubo_offset;
+    return true;
+}
+
+b8 null_renderer_shader_bind_instance(renderer_plugin* plugin, struct shader* s, u32 instance_id) {
+    if (!s) {
+        KERROR("null_renderer_shader_bind_instance requires a valid pointer to a shader.");
+        return false;
+    }
+    null_shader* internal = (null_shader*)s->internal_data;
+    if (instance_id >= internal->max_instances || internal->instance_states[instance_id].id == INVALID_ID) {
+        KERROR("Cannot bind invalid instance %u of shader '%s'.", instance_id, s->name);
+        return false;
+    }
+
+    s->bound_instance_id = instance_id;
+    s->bound_ubo_offset = internal->instance_states[instance_id].offset;
+    return true;
+}
+
+b8 null_renderer_shader_bind_local(renderer_plugin* plugin, struct shader* s) {
+    return s != 0;
+}
+
+b8 null_renderer_shader_apply_globals(renderer_plugin* plugin, struct shader* s, b8 needs_update, struct frame_data* p_frame_data) {
+    return true;
+}
+
+b8 null_renderer_shader_apply_instance(renderer_plugin* plugin, struct shader* s, b8 needs_update, struct frame_data* p_frame_data) {
+    return true;
+}
+
+b8 null_renderer_shader_instance_resources_acquire(renderer_plugin* plugin, struct shader* s, const shader_instance_resource_config* config, u32* out_instance_id) {
+    null_shader* internal = (null_shader*)s->internal_data;
+
+    *out_instance_id = INVALID_ID;
+    for (u32 i = 0; i < internal->max_instances; ++i) {
+        if (internal->instance_states[i].id == INVALID_ID) {
+            internal->instance_states[i].id = i;
+            internal->instance_states[i].offset = s->global_ubo_stride + (s->ubo_stride * i);
+            *out_instance_id = i;
+            return true;
+        }
+    }
+
+    KERROR("null_renderer_shader_instance_resources_acquire failed to acquire new id for shader '%s', max instances=%u", s->name, internal->max_instances);
+    return false;
+}
+
+b8 null_renderer_shader_instance_resources_release(renderer_plugin* plugin, struct shader* s, u32 instance_id) {
+    null_shader* internal = (null_shader*)s->internal_data;
+    if (instance_id >= internal->max_instances) {
+        return false;
+    }
+    internal->instance_states[instance_id].id = INVALID_ID;
+    return true;
+}
+
+b8 null_renderer_uniform_set(renderer_plugin* plugin, struct shader* s, struct shader_uniform* uniform, u32 array_index, const void* value) {
+    // Samplers and storage resources have nothing to hold on to without a GPU.
+    if (uniform_type_is_storage(uniform->type) || uniform_type_is_sampler(uniform->type)) {
+        return true;
+    }
+
+    null_shader* internal = (null_shader*)s->internal_data;
+    if (uniform->scope == SHADER_SCOPE_LOCAL) {
+        u64 offset = uniform->offset + (uniform->size * array_index);
+        if (offset + uniform->size > NULL_RENDERER_LOCAL_BLOCK_SIZE) {
+            KERROR("null_renderer_uniform_set: local uniform of shader '%s' is out of range.", s->name);
+            return false;
+        }
+        kcopy_memory(internal->local_block + offset, value, uniform->size);
+    } else {
+        u64 offset = s->bound_ubo_offset + uniform->offset + (uniform->size * array_index);
+        if (offset + uniform->size > internal->uniform_block_size) {
+            KERROR("null_renderer_uniform_set: uniform of shader '%s' is out of range.", s->name);
+            return false;
+        }
+        kcopy_memory((u8*)internal->uniform_block + offset, value, uniform->size);
+    }
+    return true;
+}
+
+b8 null_renderer_shader_apply_local(renderer_plugin* plugin, struct shader* s, struct frame_data* p_frame_data) {
+    return true;
+}
+
+b8 null_renderer_shader_local_block_push(renderer_plugin* plugin, struct shader* s, const void* block, u32 size) {
+    null_shader* internal = (null_shader*)s->internal_data;
+    kcopy_memory(internal->local_block, block, KMIN(size, NULL_RENDERER_LOCAL_BLOCK_SIZE));
+    return true;
+}
+
+b8 null_renderer_shader_variant_use(renderer_plugin* plugin, struct shader* s, u32 variant_index) {
+    // Variants only differ in the pipelines created for them, of which there are none.
+    return true;
+}
+
+b8 null_renderer_shader_dispatch(renderer_plugin* plugin, struct shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z) {
+    return true;
+}
+
+b8 null_renderer_texture_map_resources_acquire(renderer_plugin* plugin, texture_map* map) {
+    null_context* context = (null_context*)plugin->internal_context;
+    // Find a free sampler slot.
+    u32 sampler_count = darray_length(context->samplers);
+    for (u32 i = 0; i < sampler_count; ++i) {
+        if (!context->samplers[i]) {
+            context->samplers[i] = true;
+            map->internal_id = i;
+            return true;
+        }
+    }
+    b8 in_use = true;
+    darray_push(context->samplers, in_use);
+    map->internal_id = sampler_count;
+    return true;
+}
+
+void null_renderer_texture_map_resources_release(renderer_plugin* plugin, texture_map* map) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (map && map->internal_id != INVALID_ID) {
+        if (map->internal_id < darray_length(context->samplers)) {
+            context->samplers[map->internal_id] = false;
+        }
+        map->internal_id = INVALID_ID;
+    }
+}
+
+b8 null_renderer_bindless_textures_supported(renderer_plugin* plugin) {
+    return false;
+}
+
+u32 null_renderer_texture_map_bindless_index_get(renderer_plugin* plugin, const texture_map* map) {
+    return INVALID_ID;
+}
+
+b8 null_renderer_renderpass_create(renderer_plugin* plugin, const renderpass_config* config, renderpass* out_renderpass) {
+    out_renderpass->internal_data = kallocate(sizeof(null_renderpass), MEMORY_TAG_RENDERER);
+    null_renderpass* internal = (null_renderpass*)out_renderpass->internal_data;
+    internal->view_count = KMAX(config->view_count, 1);
+    return true;
+}
+
+void null_renderer_renderpass_destroy(renderer_plugin* plugin, renderpass* pass) {
+    if (pass && pass->internal_data) {
+        kfree(pass->internal_data, sizeof(null_renderpass), MEMORY_TAG_RENDERER);
+        pass->internal_data = 0;
+    }
+}
+
+b8 null_renderer_renderpass_multiview_supported(renderer_plugin* plugin, u8 view_count) {
+    return view_count <= NULL_RENDERER_MAX_MULTIVIEW_VIEWS;
+}
+
+b8 null_renderer_render_target_create(renderer_plugin* plugin, u8 attachment_count, render_target_attachment* attachments, renderpass* pass, u32 width, u32 height, u16 layer_index, render_target* out_target) {
+    for (u32 i = 0; i < attachment_count; ++i) {
+        if (!attachments[i].texture || !attachments[i].texture->internal_data) {
+            KERROR("null_renderer_render_target_create - attachment %u of pass '%s' has no texture.", i, pass->name);
+            return false;
+        }
+    }
+    kcopy_memory(out_target->attachments, attachments, sizeof(render_target_attachment) * attachment_count);
+
+    null_framebuffer* framebuffer = kallocate(sizeof(null_framebuffer), MEMORY_TAG_RENDERER);
+    framebuffer->width = width;
+    framebuffer->height = height;
+    out_target->internal_framebuffer = framebuffer;
+    return true;
+}
+
+void null_renderer_render_target_destroy(renderer_plugin* plugin, render_target* target, b8 free_internal_memory) {
+    if (target && target->internal_framebuffer) {
+        kfree(target->internal_framebuffer, sizeof(null_framebuffer), MEMORY_TAG_RENDERER);
+        target->internal_framebuffer = 0;
+        if (free_internal_memory) {
+            kfree(target->attachments, sizeof(render_target_attachment) * target->attachment_count, MEMORY_TAG_ARRAY);
+            target->attachments = 0;
+            target->attachment_count = 0;
+        }
+    }
+}
+
+texture* null_renderer_window_attachment_get(renderer_plugin* plugin, u8 index) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (index >= NULL_RENDERER_WINDOW_ATTACHMENT_COUNT) {
+        KFATAL("Attempting to get colour attachment index out of range: %d. Attachment count: %d", index, NULL_RENDERER_WINDOW_ATTACHMENT_COUNT);
+        return 0;
+    }
+    return &context->render_textures[index];
+}
+
+texture* null_renderer_depth_attachment_get(renderer_plugin* plugin, u8 index) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (index >= NULL_RENDERER_WINDOW_ATTACHMENT_COUNT) {
+        KFATAL("Attempting to get depth attachment index out of range: %d. Attachment count: %d", index, NULL_RENDERER_WINDOW_ATTACHMENT_COUNT);
+        return 0;
+    }
+    return &context->depth_textures[index];
+}
+
+u8 null_renderer_window_attachment_index_get(renderer_plugin* plugin) {
+    null_context* context = (null_context*)plugin->internal_context;
+    return (u8)context->image_index;
+}
+
+u8 null_renderer_window_attachment_count_get(renderer_plugin* plugin) {
+    return NULL_RENDERER_WINDOW_ATTACHMENT_COUNT;
+}
+
+b8 null_renderer_is_multithreaded(renderer_plugin* plugin) {
+    return false;
+}
+
+b8 null_renderer_flag_enabled_get(renderer_plugin* plugin, renderer_config_flags flag) {
+    null_context* context = (null_context*)plugin->internal_context;
+    return (context->flags & flag);
+}
+
+void null_renderer_flag_enabled_set(renderer_plugin* plugin, renderer_config_flags flag, b8 enabled) {
+    null_context* context = (null_context*)plugin->internal_context;
+    context->flags = (enabled ? (context->flags | flag) : (context->flags & ~flag));
+    context->render_flag_changed = true;
+}
+
+void null_renderer_swapchain_settings_get(renderer_plugin* plugin, renderer_swapchain_settings* out_settings) {
+    null_context* context = (null_context*)plugin->internal_context;
+    *out_settings = context->swapchain_settings;
+}
+
+void null_renderer_swapchain_settings_set(renderer_plugin* plugin, const renderer_swapchain_settings* settings) {
+    null_context* context = (null_context*)plugin->internal_context;
+    context->swapchain_settings = *settings;
+    context->render_flag_changed = true;
+}
+
+// Indicates if the host may map or read back buffers of the given type. Matches the memory the Vulkan backend uses.
+static b8 buffer_type_is_host_visible(renderbuffer_type type) {
+    switch (type) {
+        case RENDERBUFFER_TYPE_UNIFORM:
+        case RENDERBUFFER_TYPE_STAGING:
+        case RENDERBUFFER_TYPE_READ:
+        case RENDERBUFFER_TYPE_INSTANCE:
+        case RENDERBUFFER_TYPE_INDIRECT:
+        case RENDERBUFFER_TYPE_DYNAMIC_VERTEX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Host-visible memory is a real allocation and is counted by it. Device-local memory has no backing, so is reported instead.
+static void buffer_memory_track(null_context* context, null_buffer* internal, u64 size) {
+    context->stats.buffer_bytes += size;
+    if (!internal->memory) {
+        kallocate_report(size, MEMORY_TAG_GPU_LOCAL);
+    }
+}
+
+static void buffer_memory_untrack(null_context* context, null_buffer* internal, u64 size) {
+    context->stats.buffer_bytes -= size;
+    if (!internal->memory) {
+        kfree_report(size, MEMORY_TAG_GPU_LOCAL);
+    }
+}
+
+b8 null_renderer_buffer_create_internal(renderer_plugin* plugin, renderbuffer* buffer) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (!buffer) {
+        KERROR("null_renderer_buffer_create_internal requires a valid pointer to a buffer.");
+        return false;
+    }
+    if (buffer->type == RENDERBUFFER_TYPE_UNKNOWN) {
+        KERROR("Unsupported buffer type: %i", buffer->type);
+        return false;
+    }
+
+    null_buffer* internal = kallocate(sizeof(null_buffer), MEMORY_TAG_RENDERER);
+    internal->size = buffer->total_size;
+    if (buffer_type_is_host_visible(buffer->type) && internal->size) {
+        internal->memory = kallocate(internal->size, MEMORY_TAG_RENDERER);
+    }
+    buffer->internal_data = internal;
+
+    context->stats.buffer_count++;
+    buffer_memory_track(context, internal, internal->size);
+    return true;
+}
+
+void null_renderer_buffer_destroy_internal(renderer_plugin* plugin, renderbuffer* buffer) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (!buffer || !buffer->internal_data) {
+        return;
+    }
+
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    context->stats.buffer_count--;
+    buffer_memory_untrack(context, internal, internal->size);
+    if (internal->memory) {
+        kfree(internal->memory, internal->size, MEMORY_TAG_RENDERER);
+    }
+
+    kfree(internal, sizeof(null_buffer), MEMORY_TAG_RENDERER);
+    buffer->internal_data = 0;
+}
+
+b8 null_renderer_buffer_resize(renderer_plugin* plugin, renderbuffer* buffer, u64 new_size) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (!buffer || !buffer->internal_data) {
+        return false;
+    }
+
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    buffer_memory_untrack(context, internal, internal->size);
+    if (internal->memory) {
+        void* new_memory = kallocate(new_size, MEMORY_TAG_RENDERER);
+        kcopy_memory(new_memory, internal->memory, KMIN(internal->size, new_size));
+        kfree(internal->memory, internal->size, MEMORY_TAG_RENDERER);
+        internal->memory = new_memory;
+    }
+    internal->size = new_size;
+    buffer_memory_track(context, internal, internal->size);
+    return true;
+}
+
+b8 null_renderer_buffer_bind(renderer_plugin* plugin, renderbuffer* buffer, u64 offset) {
+    if (!buffer || !buffer->internal_data) {
+        KERROR("null_renderer_buffer_bind requires a valid pointer to a buffer.");
+        return false;
+    }
+    return true;
+}
+
+b8 null_renderer_buffer_unbind(renderer_plugin* plugin, renderbuffer* buffer) {
+    if (!buffer || !buffer->internal_data) {
+        KERROR("null_renderer_buffer_unbind requires a valid pointer to a buffer.");
+        return false;
+    }
+    return true;
+}
+
+// Checks that the given range lies within the buffer.
+static b8 buffer_range_valid(const char* function_name, renderbuffer* buffer, u64 offset, u64 size) {
+    if (!buffer || !buffer->internal_data) {
+        KERROR("%s requires a valid pointer to a buffer.", function_name);
+        return false;
+    }
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    if (offset + size > internal->size) {
+        KERROR("%s - range %llu+%llu is outside of buffer '%s' of size %llu.", function_name, offset, size, buffer->name, internal->size);
+        return false;
+    }
+    return true;
+}
+
+void* null_renderer_buffer_map_memory(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u64 size) {
+    if (!buffer_range_valid("null_renderer_buffer_map_memory", buffer, offset, size)) {
+        return 0;
+    }
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    if (!internal->memory) {
+        KERROR("null_renderer_buffer_map_memory - buffer '%s' is device-local and cannot be mapped.", buffer->name);
+        return 0;
+    }
+    return (u8*)internal->memory + offset;
+}
+
+void null_renderer_buffer_unmap_memory(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u64 size) {
+}
+
+b8 null_renderer_buffer_flush(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u64 size) {
+    return buffer_range_valid("null_renderer_buffer_flush", buffer, offset, size);
+}
+
+b8 null_renderer_buffer_read(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u64 size, void** out_memory) {
+    if (!out_memory || !buffer_range_valid("null_renderer_buffer_read", buffer, offset, size)) {
+        return false;
+    }
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    if (internal->memory) {
+        kcopy_memory(*out_memory, (u8*)internal->memory + offset, size);
+    } else {
+        // Device-local contents would have been written by the GPU, so there is nothing to read.
+        kzero_memory(*out_memory, size);
+    }
+    return true;
+}
+
+b8 null_renderer_buffer_load_range(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u64 size, const void* data) {
+    if (!buffer_range_valid("null_renderer_buffer_load_range", buffer, offset, size)) {
+        return false;
+    }
+    null_buffer* internal = (null_buffer*)buffer->internal_data;
+    if (internal->memory && data && size) {
+        kcopy_memory((u8*)internal->memory + offset, data, size);
+    }
+    return true;
+}
+
+b8 null_renderer_buffer_copy_range(renderer_plugin* plugin, renderbuffer* source, u64 source_offset, renderbuffer* dest, u64 dest_offset, u64 size) {
+    if (!buffer_range_valid("null_renderer_buffer_copy_range", source, source_offset, size) ||
+        !buffer_range_valid("null_renderer_buffer_copy_range", dest, dest_offset, size)) {
+        return false;
+    }
+    null_buffer* internal_source = (null_buffer*)source->internal_data;
+    null_buffer* internal_dest = (null_buffer*)dest->internal_data;
+    if (internal_dest->memory && size) {
+        if (internal_source->memory) {
+            kcopy_memory((u8*)internal_dest->memory + dest_offset, (u8*)internal_source->memory + source_offset, size);
+        } else {
+            kzero_memory((u8*)internal_dest->memory + dest_offset, size);
+        }
+    }
+    return true;
+}
+
+b8 null_renderer_buffer_draw(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only) {
+    null_context* context = (null_context*)plugin->internal_context;
+    if (!buffer || !buffer->internal_data) {
+        KERROR("null_renderer_buffer_draw requires a valid pointer to a buffer.");
+        return false;
+    }
+    if (!bind_only && !context->active_renderpass) {
+        KERROR("null_renderer_buffer_draw - draws must be made within a renderpass.");
+        return false;
+    }
+    return true;
+}
+
+b8 null_renderer_buffer_draw_instanced(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count) {
+    return null_renderer_buffer_draw(plugin, buffer, offset, element_count, false);
+}
+
+b8 null_renderer_buffer_indirect_draw_supported(renderer_plugin* plugin) {
+    return true;
+}
+
+b8 null_renderer_buffer_draw_indirect(renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 draw_count) {
+    if (buffer->type != RENDERBUFFER_TYPE_INDIRECT && buffer->type != RENDERBUFFER_TYPE_STORAGE) {
+        KERROR("null_renderer_buffer_draw_indirect - buffer '%s' is not an indirect buffer.", buffer->name);
+        return false;
+    }
+    return null_renderer_buffer_draw(plugin, buffer, offset, 0, false);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file null_backend.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains the null implementation of the renderer backend.
+ * It needs no GPU: resources are created and tracked as a real backend would track
+ * them, buffer contents the host may read are kept in host memory, and everything
+ * else (draws, dispatches, uploads to device memory) is accepted and discarded.
+ * This lets the CPU side of rendering be profiled and tested on machines without a GPU.
+ * @version 1.0
+ * @date 2023-12-02
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "renderer/renderer_types.h"
+#include "resources/resource_types.h"
+#include "null_renderer_plugin_main.h"
+
+struct shader;
+struct shader_uniform;
+struct frame_data;
+
+b8 null_renderer_backend_initialize(renderer_plugin* backend, const renderer_backend_config* config, u8* out_window_render_target_count);
+void null_renderer_backend_shutdown(renderer_plugin* backend);
+void null_renderer_backend_on_resized(renderer_plugin* backend, u16 width, u16 height);
+b8 null_renderer_frame_prepare(renderer_plugin* backend, struct frame_data* p_frame_data);
+b8 null_renderer_begin(renderer_plugin* plugin, struct frame_data* p_frame_data);
+b8 null_renderer_end(renderer_plugin* plugin, struct frame_data* p_frame_data);
+b8 null_renderer_present(renderer_plugin* backend, struct frame_data* p_frame_data);
+void null_renderer_viewport_set(renderer_plugin* backend, vec4 rect);
+void null_renderer_viewport_reset(renderer_plugin* backend);
+void null_renderer_scissor_set(renderer_plugin* backend, vec4 rect);
+void null_renderer_scissor_reset(renderer_plugin* backend);
+void null_renderer_winding_set(struct renderer_plugin* plugin, renderer_winding winding);
+void null_renderer_set_stencil_test_enabled(struct renderer_plugin* plugin, b8 enabled);
+void null_renderer_set_depth_test_enabled(struct renderer_plugin* plugin, b8 enabled);
+void null_renderer_set_depth_compare_op(struct renderer_plugin* plugin, renderer_compare_op compare_op);
+void null_renderer_set_stencil_reference(struct renderer_plugin* plugin, u32 reference);
+void null_renderer_set_stencil_op(struct renderer_plugin* plugin, renderer_stencil_op fail_op, renderer_stencil_op pass_op, renderer_stencil_op depth_fail_op, renderer_compare_op compare_op);
+void null_renderer_set_stencil_compare_mask(struct renderer_plugin* plugin, u32 compare_mask);
+void null_renderer_set_stencil_write_mask(struct renderer_plugin* plugin, u32 write_mask);
+b8 null_renderer_renderpass_begin(renderer_plugin* backend, renderpass* pass, render_target* target);
+b8 null_renderer_renderpass_end(renderer_plugin* backend, renderpass* pass);
+b8 null_renderer_command_list_begin(renderer_plugin* backend, u8 index);
+b8 null_renderer_command_list_end(renderer_plugin* backend, u8 index);
+b8 null_renderer_command_list_execute(renderer_plugin* backend, u8 index);
+void null_renderer_texture_create(renderer_plugin* backend, const u8* pixels, texture* texture);
+void null_renderer_texture_create_layered(renderer_plugin* backend, const u8* const* layer_pixels, texture* t);
+b8 null_renderer_texture_format_supported(renderer_plugin* backend, texture_format format);
+void null_renderer_texture_destroy(renderer_plugin* backend, texture* texture);
+void null_renderer_texture_create_writeable(renderer_plugin* backend, texture* t);
+void null_renderer_texture_resize(renderer_plugin* backend, texture* t, u32 new_width, u32 new_height);
+void null_renderer_texture_write_data(renderer_plugin* backend, texture* t, u32 offset, u32 size, const u8* pixels);
+void null_renderer_texture_write_region(renderer_plugin* backend, texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels);
+void null_renderer_texture_read_data(renderer_plugin* backend, texture* t, u32 offset, u32 size, void** out_memory);
+void null_renderer_texture_read_pixel(renderer_plugin* backend, texture* t, u32 x, u32 y, u8** out_rgba);
+b8 null_renderer_texture_read_pixel_async(renderer_plugin* backend, texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket);
+renderer_readback_status null_renderer_readback_resolve(renderer_plugin* backend, renderer_readback_ticket ticket, u32 size, void* out_data);
+b8 null_renderer_shader_create(renderer_plugin* backend, struct shader* shader, const shader_config* config, renderpass* pass);
+void null_renderer_shader_destroy(renderer_plugin* backend, struct shader* shader);
+b8 null_renderer_shader_initialize(renderer_plugin* backend, struct shader* shader);
+b8 null_renderer_shader_reload(renderer_plugin* backend, struct shader* shader);
+b8 null_renderer_shader_use(renderer_plugin* backend, struct shader* shader);
+b8 null_renderer_shader_vertex_format_set(renderer_plugin* backend, struct shader* shader, geometry_vertex_format format);
+b8 null_renderer_shader_bind_globals(renderer_plugin* backend, struct shader* s);
+b8 null_renderer_shader_bind_instance(renderer_plugin* backend, struct shader* s, u32 instance_id);
+b8 null_renderer_shader_bind_local(renderer_plugin* backend, struct shader* s);
+b8 null_renderer_shader_apply_globals(renderer_plugin* backend, struct shader* s, b8 needs_update, struct frame_data* p_frame_data);
+b8 null_renderer_shader_apply_instance(renderer_plugin* backend, struct shader* s, b8 needs_update, struct frame_data* p_frame_data);
+b8 null_renderer_shader_instance_resources_acquire(renderer_plugin* backend, struct shader* s, const shader_instance_resource_config* config, u32* out_instance_id);
+b8 null_renderer_shader_instance_resources_release(renderer_plugin* backend, struct shader* s, u32 instance_id);
+b8 null_renderer_uniform_set(renderer_plugin* backend, struct shader* frontend_shader, struct shader_uniform* uniform, u32 array_index, const void* value);
+b8 null_renderer_shader_apply_local(renderer_plugin* plugin, struct shader* s, struct frame_data* p_frame_data);
+b8 null_renderer_shader_local_block_push(renderer_plugin* plugin, struct shader* s, const void* block, u32 size);
+b8 null_renderer_shader_variant_use(renderer_plugin* plugin, struct shader* s, u32 variant_index);
+b8 null_renderer_shader_dispatch(renderer_plugin* plugin, struct shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z);
+b8 null_renderer_texture_map_resources_acquire(renderer_plugin* backend, texture_map* map);
+void null_renderer_texture_map_resources_release(renderer_plugin* backend, texture_map* map);
+b8 null_renderer_bindless_textures_supported(renderer_plugin* plugin);
+u32 null_renderer_texture_map_bindless_index_get(renderer_plugin* plugin, const texture_map* map);
+b8 null_renderer_renderpass_create(renderer_plugin* backend, const renderpass_config* config, renderpass* out_renderpass);
+void null_renderer_renderpass_destroy(renderer_plugin* backend, renderpass* pass);
+b8 null_renderer_renderpass_multiview_supported(renderer_plugin* backend, u8 view_count);
+b8 null_renderer_render_target_create(renderer_plugin* backend, u8 attachment_count, render_target_attachment* attachments, renderpass* pass, u32 width, u32 height, u16 layer_index, render_target* out_target);
+void null_renderer_render_target_destroy(renderer_plugin* backend, render_target* target, b8 free_internal_memory);
+texture* null_renderer_window_attachment_get(renderer_plugin* backend, u8 index);
+texture* null_renderer_depth_attachment_get(renderer_plugin* backend, u8 index);
+u8 null_renderer_window_attachment_index_get(renderer_plugin* backend);
+u8 null_renderer_window_attachment_count_get(renderer_plugin* backend);
+b8 null_renderer_is_multithreaded(renderer_plugin* backend);
+b8 null_renderer_flag_enabled_get(renderer_plugin* backend, renderer_config_flags flag);
+void null_renderer_flag_enabled_set(renderer_plugin* backend, renderer_config_flags flag, b8 enabled);
+void null_renderer_swapchain_settings_get(renderer_plugin* backend, renderer_swapchain_settings* out_settings);
+void null_renderer_swapchain_settings_set(renderer_plugin* backend, const renderer_swapchain_settings* settings);
+b8 null_renderer_buffer_create_internal(renderer_plugin* backend, renderbuffer* buffer);
+void null_renderer_buffer_destroy_internal(renderer_plugin* backend, renderbuffer* buffer);
+b8 null_renderer_buffer_resize(renderer_plugin* backend, renderbuffer* buffer, u64 new_size);
+b8 null_renderer_buffer_bind(renderer_plugin* backend, renderbuffer* buffer, u64 offset);
+b8 null_renderer_buffer_unbind(renderer_plugin* backend, renderbuffer* buffer);
+void* null_renderer_buffer_map_memory(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size);
+void null_renderer_buffer_unmap_memory(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size);
+b8 null_renderer_buffer_flush(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size);
+b8 null_renderer_buffer_read(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size, void** out_memory);
+b8 null_renderer_buffer_load_range(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size, const void* data);
+b8 null_renderer_buffer_copy_range(renderer_plugin* backend, renderbuffer* source, u64 source_offset, renderbuffer* dest, u64 dest_offset, u64 size);
+b8 null_renderer_buffer_draw(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only);
+b8 null_renderer_buffer_draw_instanced(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count);
+b8 null_renderer_buffer_indirect_draw_supported(renderer_plugin* backend);
+b8 null_renderer_buffer_draw_indirect(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 draw_count);
@@ -0,0 +1,131 @@
+/**
+ * @file null_types.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief This file contains the types used by the null renderer backend, which
+ * keeps track of resources as a GPU backend would, but submits no GPU work.
+ * @version 1.0
+ * @date 2023-12-02
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "renderer/renderer_types.h"
+
+/** @brief The number of window attachments, matching a triple-buffered swapchain. */
+#define NULL_RENDERER_WINDOW_ATTACHMENT_COUNT 3
+/** @brief The number of frames which may be recorded ahead when the configuration does not say. */
+#define NULL_RENDERER_DEFAULT_FRAMES_IN_FLIGHT 2
+/** @brief The alignment applied to uniform buffer strides, matching the strictest common devices. */
+#define NULL_RENDERER_UBO_ALIGNMENT 256
+/** @brief The size of the push constant block kept for local uniforms, in bytes. */
+#define NULL_RENDERER_LOCAL_BLOCK_SIZE 128
+/** @brief The most views a single multiview renderpass may render to. */
+#define NULL_RENDERER_MAX_MULTIVIEW_VIEWS 6
+
+/** @brief The internal state of a texture. Only its size is kept, as no pixels are stored. */
+typedef struct null_texture {
+    /** @brief The size the texture would occupy in device memory, in bytes. */
+    u64 size;
+} null_texture;
+
+/** @brief The internal state of a renderbuffer. */
+typedef struct null_buffer {
+    /**
+     * @brief Host memory holding the buffer's contents, for buffer types the host may map or read.
+     * 0 for device-local buffers, whose contents are never needed without a GPU.
+     */
+    void* memory;
+    /** @brief The size of the buffer in bytes. */
+    u64 size;
+} null_buffer;
+
+/** @brief The internal state of a render target. */
+typedef struct null_framebuffer {
+    u32 width;
+    u32 height;
+} null_framebuffer;
+
+/** @brief The internal state of a renderpass. */
+typedef struct null_renderpass {
+    /** @brief The number of views the pass renders to at once. */
+    u8 view_count;
+} null_renderpass;
+
+/** @brief The state of a single shader instance. */
+typedef struct null_shader_instance_state {
+    /** @brief The instance id, or INVALID_ID if the slot is free. */
+    u32 id;
+    /** @brief The offset of the instance's uniforms within the uniform block. */
+    u64 offset;
+} null_shader_instance_state;
+
+/** @brief The internal state of a shader. */
+typedef struct null_shader {
+    /** @brief The maximum number of instances. */
+    u32 max_instances;
+    /** @brief An array of max_instances instance states. */
+    null_shader_instance_state* instance_states;
+    /** @brief Global and instance uniform values, globals first, as they would be copied to a uniform buffer. */
+    void* uniform_block;
+    /** @brief The size of the uniform block in bytes. */
+    u64 uniform_block_size;
+    /** @brief Local uniform values, as they would be pushed as constants. */
+    u8 local_block[NULL_RENDERER_LOCAL_BLOCK_SIZE];
+} null_shader;
+
+/** @brief Resources created through the backend, as would be reported by a device memory allocator. */
+typedef struct null_resource_stats {
+    u32 buffer_count;
+    u64 buffer_bytes;
+    u32 texture_count;
+    u64 texture_bytes;
+} null_resource_stats;
+
+/** @brief The internal state of the null renderer backend. */
+typedef struct null_context {
+    /** @brief The current framebuffer width. */
+    u32 framebuffer_width;
+    /** @brief The current framebuffer height. */
+    u32 framebuffer_height;
+    /** @brief Incremented on each resize. */
+    u64 framebuffer_size_generation;
+    /** @brief The generation the window attachments were last sized for. */
+    u64 framebuffer_size_last_generation;
+
+    /** @brief The renderer configuration flags in use. */
+    renderer_config_flags flags;
+    /** @brief Set when a flag changes, which recreates the window attachments as a swapchain would be. */
+    b8 render_flag_changed;
+
+    /** @brief The swapchain settings last requested, applied when the window attachments are next recreated. */
+    renderer_swapchain_settings swapchain_settings;
+    /** @brief The number of window attachments cycled through, as images of a swapchain would be. */
+    u8 image_count;
+    /** @brief The number of frames recorded ahead. */
+    u8 frames_in_flight;
+    /** @brief The index of the frame in flight currently being recorded. */
+    u32 current_frame;
+    /** @brief The index of the window attachment currently being rendered to. */
+    u32 image_index;
+
+    /** @brief The colour textures standing in for swapchain images. */
+    texture render_textures[NULL_RENDERER_WINDOW_ATTACHMENT_COUNT];
+    /** @brief The depth textures paired with each window attachment. */
+    texture depth_textures[NULL_RENDERER_WINDOW_ATTACHMENT_COUNT];
+
+    /** @brief Indicates which sampler slots are in use, by texture map internal id. Darray. */
+    b8* samplers;
+
+    /** @brief The renderpass currently begun, if any. */
+    renderpass* active_renderpass;
+
+    /** @brief Resources currently created. */
+    null_resource_stats stats;
+
+    /** @brief The ticket given to the next asynchronous read. */
+    u64 next_readback_ticket;
+} null_context;
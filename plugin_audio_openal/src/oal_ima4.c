@@ -0,0 +1,77 @@
+#include "oal_ima4.h"
+
+#include <math/kmath.h>
+
+static const i32 step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55,
+    60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371,
+    408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499,
+    2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+    18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const i32 index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+typedef struct ima4_channel_state {
+    i32 predictor;
+    i32 index;
+} ima4_channel_state;
+
+static u8 encode_sample(ima4_channel_state* state, i32 sample) {
+    i32 step = step_table[state->index];
+    i32 diff = sample - state->predictor;
+    u8 nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    // The magnitude nearest to what the decoder reconstructs: (2 * magnitude + 1) * step / 8.
+    i32 magnitude = KCLAMP((diff * 4) / step, 0, 7);
+    nibble |= (u8)magnitude;
+
+    // Track the value exactly as the decoder will, so errors do not accumulate.
+    i32 delta = ((2 * magnitude + 1) * step) / 8;
+    state->predictor += (nibble & 8) ? -delta : delta;
+    state->predictor = KCLAMP(state->predictor, -32768, 32767);
+    state->index = KCLAMP(state->index + index_table[nibble], 0, 88);
+    return nibble;
+}
+
+u64 oal_ima4_encoded_size(u64 frame_count, u32 channels) {
+    u64 block_count = (frame_count + OAL_IMA4_BLOCK_SAMPLES - 1) / OAL_IMA4_BLOCK_SAMPLES;
+    return block_count * OAL_IMA4_CHANNEL_BLOCK_SIZE * channels;
+}
+
+void oal_ima4_encode(const i16* pcm, u64 frame_count, u32 channels, u8* out_data) {
+    ima4_channel_state states[2] = {0};
+    u64 block_count = (frame_count + OAL_IMA4_BLOCK_SAMPLES - 1) / OAL_IMA4_BLOCK_SAMPLES;
+    u8* out = out_data;
+
+    for (u64 b = 0; b < block_count; ++b) {
+        u64 first = b * OAL_IMA4_BLOCK_SAMPLES;
+
+        // Each channel's header holds its first sample as-is, along with the step index.
+        for (u32 c = 0; c < channels; ++c) {
+            i16 sample = first < frame_count ? pcm[first * channels + c] : 0;
+            states[c].predictor = sample;
+            out[0] = (u8)(sample & 0xFF);
+            out[1] = (u8)((sample >> 8) & 0xFF);
+            out[2] = (u8)states[c].index;
+            out[3] = 0;
+            out += 4;
+        }
+
+        // The remaining 64 samples follow as 4 bytes of 8 samples per channel in turn, low nibble first.
+        for (u32 group = 0; group < (OAL_IMA4_BLOCK_SAMPLES - 1) / 8; ++group) {
+            for (u32 c = 0; c < channels; ++c) {
+                for (u32 i = 0; i < 8; i += 2) {
+                    u64 frame = first + 1 + group * 8 + i;
+                    i32 low = frame < frame_count ? pcm[frame * channels + c] : 0;
+                    i32 high = frame + 1 < frame_count ? pcm[(frame + 1) * channels + c] : 0;
+                    u8 low_nibble = encode_sample(&states[c], low);
+                    u8 high_nibble = encode_sample(&states[c], high);
+                    *out++ = low_nibble | (u8)(high_nibble << 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/**
+ * @file oal_ima4.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief IMA ADPCM encoding in the block layout of the AL_EXT_IMA4 extension, used to
+ * keep sound effects resident at a quarter of their 16-bit PCM size.
+ * @version 1.0
+ * @date 2023-12-04
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/** @brief The number of sample frames held by each IMA4 block, including the one in its header. */
+#define OAL_IMA4_BLOCK_SAMPLES 65
+/** @brief The size of each channel's part of an IMA4 block, in bytes. */
+#define OAL_IMA4_CHANNEL_BLOCK_SIZE 36
+
+/**
+ * @brief Obtains the size of the data the given PCM samples encode to.
+ *
+ * @param frame_count The number of sample frames, each holding one sample per channel.
+ * @param channels The number of channels. Must be 1 or 2.
+ * @return The size of the encoded data, in bytes.
+ */
+u64 oal_ima4_encoded_size(u64 frame_count, u32 channels);
+
+/**
+ * @brief Encodes interleaved 16-bit PCM samples as IMA4 blocks. The last block is padded with silence.
+ *
+ * @param pcm The interleaved samples to encode.
+ * @param frame_count The number of sample frames, each holding one sample per channel.
+ * @param channels The number of channels. Must be 1 or 2.
+ * @param out_data A block of memory to hold the encoded data, at least oal_ima4_encoded_size() bytes.
+ */
+void oal_ima4_encode(const i16* pcm, u64 frame_count, u32 channels, u8* out_data);
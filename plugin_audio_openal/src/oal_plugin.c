@@ -6,6 +6,8 @@
 #else
 #include <alloca.h>
 #endif
+#include <core/katomic.h>
+#include <core/kcondvar.h>
 #include <core/kmutex.h>
 #include <core/kthread.h>
 #include <math/kmath.h>
@@ -17,6 +19,7 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "defines.h"
+#include "oal_ima4.h"
 #include "resources/loaders/audio_loader.h"
 #include "resources/loaders/loader_utils.h"
 #include "resources/resource_types.h"
@@ -33,6 +36,20 @@
 #endif
 // The number of buffers used for streaming music file data.
 #define OAL_PLUGIN_MUSIC_BUFFER_COUNT 2
+// The number of chunks of a music stream decoded ahead of those queued. Must be a power of 2.
+#define OAL_PLUGIN_DECODE_AHEAD_COUNT 4
+// The number of commands which may wait for the mixer thread. Must be a power of 2.
+#define OAL_PLUGIN_COMMAND_QUEUE_SIZE 512
+// How often the mixer thread refills streams while any are playing, in milliseconds.
+#define OAL_PLUGIN_MIXER_INTERVAL_MS 5
+
+// A chunk of a music stream, decoded ahead of being queued.
+typedef struct oal_decoded_chunk {
+    // Points into the stream's decoded_samples.
+    i16* samples;
+    // The number of samples, including all channels. 0 marks the end of a stream which doesn't loop.
+    u64 sample_count;
+} oal_decoded_chunk;
 
 typedef struct audio_file_plugin_data {
     // The current buffer being used to play sound effect types.
@@ -41,7 +58,24 @@ typedef struct audio_file_plugin_data {
     ALuint buffers[OAL_PLUGIN_MUSIC_BUFFER_COUNT];
     // Indicates if the music file should loop.
     b8 is_looping;
-
+    // A sound effect's IMA4 encoded data, held only until it is uploaded.
+    u8* encoded;
+    u64 encoded_size;
+
+    // Single producer (decoding job), single consumer (mixer thread) ring of a music stream's decoded
+    // chunks, so that refilling a buffer is only a copy.
+    oal_decoded_chunk decoded[OAL_PLUGIN_DECODE_AHEAD_COUNT];
+    // The sample memory of all of the decoded chunks.
+    i16* decoded_samples;
+    u64 decoded_samples_size;
+    // The next chunk to be queued. Written by the mixer thread only.
+    volatile u32 decode_head;
+    // The next chunk to be decoded into. Written by the decoding job only.
+    volatile u32 decode_tail;
+    // Set while a decoding job is in flight. While it is, only the job touches the file's decoder.
+    volatile u32 decoding;
+    // Set by the decoder once the end of a stream which doesn't loop has been decoded.
+    b8 decode_ended;
 } audio_file_plugin_data;
 
 // Sources are used to play sounds, potentially at a space in 3D.
@@ -59,15 +93,46 @@ typedef struct audio_plugin_source {
     // Indicates if this souce is in use.
     b8 in_use;
 
-    // Worker thread for this source.
-    kthread thread;
-
-    kmutex data_mutex;  // everything from here down should be accessed/changed during lock.
+    // Everything from here down is owned by the mixer thread.
     struct audio_file* current;
-    b8 trigger_play;
-    b8 trigger_exit;
+    // Set while paused, so a stream is not restarted by its refill.
+    b8 paused;
 } audio_plugin_source;
 
+typedef enum oal_command_type {
+    OAL_COMMAND_TYPE_LISTENER_POSITION,
+    OAL_COMMAND_TYPE_LISTENER_ORIENTATION,
+    OAL_COMMAND_TYPE_SOURCE_GAIN,
+    OAL_COMMAND_TYPE_SOURCE_PITCH,
+    OAL_COMMAND_TYPE_SOURCE_POSITION,
+    OAL_COMMAND_TYPE_SOURCE_LOOPING,
+    OAL_COMMAND_TYPE_SOURCE_PLAY,
+    OAL_COMMAND_TYPE_SOURCE_PLAY_FILE,
+    OAL_COMMAND_TYPE_SOURCE_STOP,
+    OAL_COMMAND_TYPE_SOURCE_PAUSE,
+    OAL_COMMAND_TYPE_SOURCE_RESUME,
+    // Stops every source playing the file, so it may be closed.
+    OAL_COMMAND_TYPE_FILE_DETACH
+} oal_command_type;
+
+// A change from the game thread, applied by the mixer thread.
+typedef struct oal_command {
+    oal_command_type type;
+    u32 source_index;
+    // Where to start playing the file from, in seconds.
+    f32 offset_seconds;
+    union {
+        f32 value;
+        b8 flag;
+        vec3 position;
+        struct {
+            vec3 forward;
+            vec3 up;
+        } orientation;
+        struct audio_file* file;
+    };
+} oal_command;
+
 // The internal state for this audio plugin.
 typedef struct audio_plugin_state {
     // A copy of the configuration.
@@ -88,11 +153,29 @@ typedef struct audio_plugin_state {
     // The listener's current up vector.
     vec3 listener_up;
 
+    // Indicates if sound effects are kept IMA4 compressed. Requires AL_EXT_IMA4.
+    b8 use_ima4;
+
     // A collection of available sources. config.max_sources has the count of this.
     audio_plugin_source* sources;
 
     // An array to keep free/available buffer ids.
     u32* free_buffers;
+
+    // The mixer thread, which owns all sources and services every one of them.
+    kthread mixer_thread;
+    volatile u32 shutting_down;
+    // Set while the mixer thread waits, so it is only woken when it needs to be.
+    volatile u32 thread_sleeping;
+    kmutex wake_mutex;
+    kcondvar wake_condvar;
+
+    // Single producer (game thread), single consumer (mixer thread) queue of commands.
+    oal_command commands[OAL_PLUGIN_COMMAND_QUEUE_SIZE];
+    // The next command to be applied. Written by the mixer thread only.
+    volatile u32 command_head;
+    // The next command slot to be written. Written by the game thread only.
+    volatile u32 command_tail;
 } audio_plugin_state;
 
 static b8 oal_plugin_check_error(void);
@@ -100,38 +183,109 @@ static b8 oal_plugin_source_create(struct audio_plugin* plugin, audio_plugin_sou
 static void oal_plugin_source_destroy(struct audio_plugin* plugin, audio_plugin_source* source);
 static u32 oal_plugin_find_free_buffer(struct audio_plugin* plugin);
 
-static b8 oal_plugin_stream_music_data(audio_plugin* plugin, ALuint buffer, audio_file* audio) {
-    if (!plugin || !audio) {
-        return false;
-    }
-
+// Decodes the next chunk of the stream, starting over at the end if it loops. Returns the number of samples decoded, 0 at the end.
+static u64 oal_plugin_stream_decode_chunk(audio_file* audio, u32 chunk_size, i16* out_samples) {
     // Figure out how many samples can be taken.
-    u64 size = audio->load_samples(audio, plugin->internal_state->config.chunk_size, plugin->internal_state->config.chunk_size);
+    u64 size = audio->load_samples(audio, chunk_size, chunk_size);
+    if (size == 0 && audio->plugin_data->is_looping) {
+        // 0 means the end of the file has been reached, so start over at the beginning.
+        audio->rewind(audio);
+        size = audio->load_samples(audio, chunk_size, chunk_size);
+    }
     if (size == INVALID_ID_U64) {
         KERROR("Error streaming data. Check logs for more info.");
-        return false;
+        return 0;
     }
-
-    // 0 means the end of the file has been reached, and either the stream stops or needs to start over.
     if (size == 0) {
-        return false;
+        return 0;
     }
-    oal_plugin_check_error();
-    // Load the data into the buffer.
+
     void* streamed_data = audio->stream_buffer_data(audio);
-    if (streamed_data) {
-        alBufferData(buffer, audio->format, streamed_data, size * sizeof(ALshort), audio->sample_rate);
-        oal_plugin_check_error();
-    } else {
+    if (!streamed_data) {
         KERROR("Error streaming data. Check logs for more info.");
-        return false;
+        return 0;
     }
+    kcopy_memory(out_samples, streamed_data, size * sizeof(i16));
 
     // Update the samples remaining.
     audio->total_samples_left -= size;
+    return size;
+}
 
+// Decodes chunks of the stream until the ring is full or the stream has ended. Only one thread may run this at a time.
+static void oal_plugin_stream_decode_ahead(audio_file* audio, u32 chunk_size) {
+    audio_file_plugin_data* data = audio->plugin_data;
+    u32 tail = data->decode_tail;
+    while (!data->decode_ended && tail - katomic_load_u32(&data->decode_head, KATOMIC_ORDER_ACQUIRE) < OAL_PLUGIN_DECODE_AHEAD_COUNT) {
+        oal_decoded_chunk* chunk = &data->decoded[tail & (OAL_PLUGIN_DECODE_AHEAD_COUNT - 1)];
+        chunk->sample_count = oal_plugin_stream_decode_chunk(audio, chunk_size, chunk->samples);
+        data->decode_ended = chunk->sample_count == 0;
+        tail++;
+        katomic_store_u32(&data->decode_tail, tail, KATOMIC_ORDER_RELEASE);
+    }
+}
+
+typedef struct stream_decode_job_params {
+    audio_file* file;
+    u32 chunk_size;
+} stream_decode_job_params;
+
+static b8 stream_decode_job_start(void* params, void* result_data) {
+    stream_decode_job_params* job_params = params;
+    oal_plugin_stream_decode_ahead(job_params->file, job_params->chunk_size);
+    katomic_store_u32(&job_params->file->plugin_data->decoding, 0, KATOMIC_ORDER_RELEASE);
     return true;
 }
+
+// Starts decoding further ahead on a job thread, unless that is already underway or isn't needed. Mixer thread only.
+static void oal_plugin_stream_decode_kick(audio_plugin* plugin, audio_file* audio) {
+    audio_file_plugin_data* data = audio->plugin_data;
+    if (katomic_load_u32(&data->decoding, KATOMIC_ORDER_ACQUIRE)) {
+        return;
+    }
+    if (data->decode_ended || data->decode_tail - data->decode_head >= OAL_PLUGIN_DECODE_AHEAD_COUNT) {
+        return;
+    }
+
+    katomic_store_u32(&data->decoding, 1, KATOMIC_ORDER_RELEASE);
+    stream_decode_job_params params = {0};
+    params.file = audio;
+    params.chunk_size = plugin->internal_state->config.chunk_size;
+    job_info job = job_create_priority(stream_decode_job_start, 0, 0, &params, sizeof(stream_decode_job_params), 0, JOB_TYPE_GENERAL, JOB_PRIORITY_HIGH);
+    job_system_submit(job);
+}
+
+// Waits for any decoding job of the stream, after which the calling thread may use its decoder.
+static void oal_plugin_stream_decode_wait(audio_file* audio) {
+    while (katomic_load_u32(&audio->plugin_data->decoding, KATOMIC_ORDER_ACQUIRE)) {
+        platform_sleep(1);
+    }
+}
+
+// Copies the next decoded chunk of the stream into the given buffer. Returns false if there is none
+// yet, in which case out_ended is set if that is because the stream has ended.
+static b8 oal_plugin_stream_music_data(audio_plugin* plugin, ALuint buffer, audio_file* audio, b8* out_ended) {
+    audio_file_plugin_data* data = audio->plugin_data;
+    *out_ended = false;
+    u32 head = data->decode_head;
+    if (head == katomic_load_u32(&data->decode_tail, KATOMIC_ORDER_ACQUIRE)) {
+        return false;
+    }
+
+    oal_decoded_chunk* chunk = &data->decoded[head & (OAL_PLUGIN_DECODE_AHEAD_COUNT - 1)];
+    if (!chunk->sample_count) {
+        // The end marker stays, so nothing further is queued.
+        *out_ended = true;
+        return false;
+    }
+
+    oal_plugin_check_error();
+    alBufferData(buffer, audio->format, chunk->samples, chunk->sample_count * sizeof(ALshort), audio->sample_rate);
+    oal_plugin_check_error();
+    katomic_store_u32(&data->decode_head, head + 1, KATOMIC_ORDER_RELEASE);
+    return true;
+}
+
 static b8 oal_plugin_stream_update(audio_plugin* plugin, audio_file* audio, audio_plugin_source* source) {
     if (!plugin || !audio) {
         return false;
@@ -150,23 +304,16 @@ static b8 oal_plugin_stream_update(audio_plugin* plugin, audio_file* audio, audi
     ALint processed_buffer_count = 0;
     alGetSourcei(source->id, AL_BUFFERS_PROCESSED, &processed_buffer_count);
 
-    while (processed_buffer_count--) {
+    // Buffers are only unqueued once there is decoded data to refill them with. Otherwise they
+    // wait for the decoder to catch up, and are refilled on a later pass.
+    while (processed_buffer_count-- && katomic_load_u32(&audio->plugin_data->decode_tail, KATOMIC_ORDER_ACQUIRE) != audio->plugin_data->decode_head) {
         ALuint buffer_id = 0;
         alSourceUnqueueBuffers(source->id, 1, &buffer_id);
 
-        // If this returns false, there was nothing further to read (i.e at the end of the file).
-        if (!oal_plugin_stream_music_data(plugin, buffer_id, audio)) {
-            b8 done = true;
-
-            // If set to loop, start over at the beginning.
-            if (audio->plugin_data->is_looping) {
-                // Loop around.
-                audio->rewind(audio);
-                done = !oal_plugin_stream_music_data(plugin, buffer_id, audio);
-            }
-
-            // If not set to loop, the sound is done playing.
-            if (done) {
+        b8 ended = false;
+        if (!oal_plugin_stream_music_data(plugin, buffer_id, audio, &ended)) {
+            // Looping streams are started over by the decoder, so this is the end of one that doesn't loop.
+            if (ended) {
                 return false;
             }
         }
@@ -174,49 +321,207 @@ static b8 oal_plugin_stream_update(audio_plugin* plugin, audio_file* audio, audi
         alSourceQueueBuffers(source->id, 1, &buffer_id);
     }
 
+    // Keep decoding ahead of what was just queued.
+    oal_plugin_stream_decode_kick(plugin, audio);
     return true;
 }
 
-typedef struct source_work_thread_params {
-    struct audio_plugin* plugin;
-    audio_plugin_source* source;
-} source_work_thread_params;
+static void oal_plugin_mixer_wake(audio_plugin_state* state) {
+    if (katomic_load_u32(&state->thread_sleeping, KATOMIC_ORDER_SEQ_CST)) {
+        kmutex_lock(&state->wake_mutex);
+        kcondvar_signal(&state->wake_condvar);
+        kmutex_unlock(&state->wake_mutex);
+    }
+}
 
-static u32 source_work_thread(void* params) {
-    source_work_thread_params* typed_params = params;
-    audio_plugin* plugin = typed_params->plugin;
-    audio_plugin_source* source = typed_params->source;
+// Queues a command for the mixer thread. Called from the game thread only.
+static void oal_plugin_command_push(audio_plugin_state* state, const oal_command* command) {
+    u32 tail = state->command_tail;
+    while (tail - katomic_load_u32(&state->command_head, KATOMIC_ORDER_ACQUIRE) >= OAL_PLUGIN_COMMAND_QUEUE_SIZE) {
+        // Full. Make sure the mixer is draining it.
+        oal_plugin_mixer_wake(state);
+        platform_sleep(1);
+    }
+    state->commands[tail & (OAL_PLUGIN_COMMAND_QUEUE_SIZE - 1)] = *command;
+    katomic_store_u32(&state->command_tail, tail + 1, KATOMIC_ORDER_SEQ_CST);
+}
 
-    // Release this right away since it's no longer needed.
-    kfree(params, sizeof(source_work_thread_params), MEMORY_TAG_AUDIO);
+// Waits for the mixer thread to apply every queued command.
+static void oal_plugin_commands_flush(audio_plugin_state* state) {
+    while (katomic_load_u32(&state->command_head, KATOMIC_ORDER_ACQUIRE) != state->command_tail) {
+        oal_plugin_mixer_wake(state);
+        platform_sleep(1);
+    }
+}
 
-    KDEBUG("Audio source thread starting...");
+static void oal_plugin_source_stop_internal(audio_plugin_source* source) {
+    alSourceStop(source->id);
 
-    b8 do_break = false;
-    while (!do_break) {
-        if (!source->data_mutex.internal_data) {
-            // This can happen during unexpected shutdown, and if so kill the thread.
-            return 0;
-        }
-        kmutex_lock(&source->data_mutex);
-        if (source->trigger_exit) {
-            do_break = true;
-        }
-        if (source->trigger_play) {
+    // Detach all buffers.
+    alSourcei(source->id, AL_BUFFER, 0);
+    oal_plugin_check_error();
+
+    // Rewind.
+    alSourceRewind(source->id);
+
+    source->current = 0;
+    source->paused = false;
+}
+
+static void oal_plugin_command_apply(audio_plugin* plugin, const oal_command* command) {
+    audio_plugin_state* state = plugin->internal_state;
+    audio_plugin_source* source = &state->sources[command->source_index];
+    switch (command->type) {
+        case OAL_COMMAND_TYPE_LISTENER_POSITION:
+            alListener3f(AL_POSITION, command->position.x, command->position.y, command->position.z);
+            break;
+        case OAL_COMMAND_TYPE_LISTENER_ORIENTATION: {
+            vec3 f = command->orientation.forward;
+            vec3 u = command->orientation.up;
+            ALfloat listener_orientation[] = {f.x, f.y, f.z, u.x, u.y, u.z};
+            alListenerfv(AL_ORIENTATION, listener_orientation);
+        } break;
+        case OAL_COMMAND_TYPE_SOURCE_GAIN:
+            alSourcef(source->id, AL_GAIN, command->value);
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_PITCH:
+            alSourcef(source->id, AL_PITCH, command->value);
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_POSITION:
+            alSource3f(source->id, AL_POSITION, command->position.x, command->position.y, command->position.z);
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_LOOPING:
+            alSourcei(source->id, AL_LOOPING, command->flag ? AL_TRUE : AL_FALSE);
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_PLAY:
+            if (source->current) {
+                source->paused = false;
+                alSourcePlay(source->id);
+            }
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_PLAY_FILE: {
+            audio_file* file = command->file;
+            if (file->type == AUDIO_FILE_TYPE_SOUND_EFFECT) {
+                // Queue up sound buffer.
+                alSourceQueueBuffers(source->id, 1, &file->plugin_data->buffer);
+                oal_plugin_check_error();
+                if (command->offset_seconds > 0.0f) {
+                    alSourcef(source->id, AL_SEC_OFFSET, command->offset_seconds);
+                }
+            } else {
+                // Anything decoded ahead is from where the stream was before.
+                audio_file_plugin_data* data = file->plugin_data;
+                oal_plugin_stream_decode_wait(file);
+                data->decode_head = 0;
+                data->decode_tail = 0;
+                data->decode_ended = false;
+                if (command->offset_seconds > 0.0f) {
+                    file->seek(file, (u64)(command->offset_seconds * file->sample_rate));
+                } else {
+                    file->rewind(file);
+                }
+
+                // Decode the start here, so that it can be queued straight away. The rest is decoded ahead by jobs.
+                oal_plugin_stream_decode_ahead(file, state->config.chunk_size);
+                u32 queued = 0;
+                b8 ended = false;
+                while (queued < OAL_PLUGIN_MUSIC_BUFFER_COUNT && oal_plugin_stream_music_data(plugin, data->buffers[queued], file, &ended)) {
+                    queued++;
+                }
+                if (!queued) {
+                    KERROR("Failed to stream data to the buffers of a music file. File load failed.");
+                }
+                // Queue up new buffers.
+                alSourceQueueBuffers(source->id, queued, data->buffers);
+                oal_plugin_check_error();
+                oal_plugin_stream_decode_kick(plugin, file);
+            }
+
+            source->current = file;
+            source->paused = false;
             alSourcePlay(source->id);
-            source->trigger_play = false;
+        } break;
+        case OAL_COMMAND_TYPE_SOURCE_STOP:
+            oal_plugin_source_stop_internal(source);
+            break;
+        case OAL_COMMAND_TYPE_SOURCE_PAUSE: {
+            // Pause if the source is currently playing.
+            ALint source_state;
+            alGetSourcei(source->id, AL_SOURCE_STATE, &source_state);
+            if (source_state == AL_PLAYING) {
+                alSourcePause(source->id);
+                source->paused = true;
+            }
+        } break;
+        case OAL_COMMAND_TYPE_SOURCE_RESUME: {
+            // Resume if the source is currently paused.
+            ALint source_state;
+            alGetSourcei(source->id, AL_SOURCE_STATE, &source_state);
+            if (source_state == AL_PAUSED) {
+                alSourcePlay(source->id);
+            }
+            source->paused = false;
+        } break;
+        case OAL_COMMAND_TYPE_FILE_DETACH:
+            for (u32 i = 0; i < state->config.max_sources; ++i) {
+                if (state->sources[i].current == command->file) {
+                    oal_plugin_source_stop_internal(&state->sources[i]);
+                }
+            }
+            break;
+    }
+    oal_plugin_check_error();
+}
+
+static u32 oal_plugin_mixer_thread(void* params) {
+    audio_plugin* plugin = params;
+    audio_plugin_state* state = plugin->internal_state;
+
+    KDEBUG("Audio mixer thread starting...");
+
+    while (true) {
+        // Apply everything queued by the game thread since the last pass.
+        u32 head = state->command_head;
+        u32 tail = katomic_load_u32(&state->command_tail, KATOMIC_ORDER_ACQUIRE);
+        while (head != tail) {
+            oal_plugin_command_apply(plugin, &state->commands[head & (OAL_PLUGIN_COMMAND_QUEUE_SIZE - 1)]);
+            head++;
+            katomic_store_u32(&state->command_head, head, KATOMIC_ORDER_RELEASE);
+        }
+
+        if (katomic_load_u32(&state->shutting_down, KATOMIC_ORDER_ACQUIRE)) {
+            break;
         }
-        kmutex_unlock(&source->data_mutex);
 
-        if (source->current && source->current->type == AUDIO_FILE_TYPE_MUSIC_STREAM) {
-            // If currently playing stream, try updating the stream.
-            oal_plugin_stream_update(plugin, source->current, source);
+        // Refill every playing stream.
+        b8 streaming = false;
+        for (u32 i = 0; i < state->config.max_sources; ++i) {
+            audio_plugin_source* source = &state->sources[i];
+            if (source->current && source->current->type == AUDIO_FILE_TYPE_MUSIC_STREAM && !source->paused) {
+                if (oal_plugin_stream_update(plugin, source->current, source)) {
+                    streaming = true;
+                } else {
+                    // The end has been reached. The source plays out what is queued.
+                    source->current = 0;
+                }
+            }
         }
 
-        platform_sleep(2);
+        // Sleep until there are more commands, or until the streams need refilling.
+        kmutex_lock(&state->wake_mutex);
+        katomic_store_u32(&state->thread_sleeping, 1, KATOMIC_ORDER_SEQ_CST);
+        if (katomic_load_u32(&state->command_tail, KATOMIC_ORDER_SEQ_CST) == state->command_head && !katomic_load_u32(&state->shutting_down, KATOMIC_ORDER_ACQUIRE)) {
+            if (streaming) {
+                kcondvar_wait_timeout(&state->wake_condvar, &state->wake_mutex, OAL_PLUGIN_MIXER_INTERVAL_MS);
+            } else {
+                kcondvar_wait(&state->wake_condvar, &state->wake_mutex);
+            }
+        }
+        katomic_store_u32(&state->thread_sleeping, 0, KATOMIC_ORDER_SEQ_CST);
+        kmutex_unlock(&state->wake_mutex);
     }
 
-    KDEBUG("Audio source thread shutting down.");
+    KDEBUG("Audio mixer thread shutting down.");
     return 0;
 }
 
@@ -254,6 +559,25 @@ b8 oal_plugin_initialize(struct audio_plugin* plugin, audio_plugin_config config
             oal_plugin_check_error();
         }
 
+        // Start the mixer thread before anything is queued for it.
+        plugin->internal_state->sources = kallocate(sizeof(audio_plugin_source) * config.max_sources, MEMORY_TAG_AUDIO);
+        if (!kmutex_create(&plugin->internal_state->wake_mutex) || !kcondvar_create(&plugin->internal_state->wake_condvar)) {
+            KERROR("Unable to create audio mixer thread synchronization objects.");
+            return false;
+        }
+        kmutex_name_set(&plugin->internal_state->wake_mutex, "audio mixer wake");
+        if (!kthread_create(oal_plugin_mixer_thread, plugin, false, &plugin->internal_state->mixer_thread)) {
+            KERROR("Unable to create audio mixer thread.");
+            return false;
+        }
+
+        if (config.compress_chunks) {
+            plugin->internal_state->use_ima4 = alIsExtensionPresent("AL_EXT_IMA4");
+            if (!plugin->internal_state->use_ima4) {
+                KWARN("AL_EXT_IMA4 is not supported. Sound effects will be kept uncompressed.");
+            }
+        }
+
         // Configure the listener with some defaults.
         oal_plugin_listener_position_set(plugin, vec3_zero());
         oal_plugin_listener_orientation_set(plugin, vec3_forward(), vec3_up());
@@ -262,7 +586,6 @@ b8 oal_plugin_initialize(struct audio_plugin* plugin, audio_plugin_config config
         alListener3f(AL_VELOCITY, 0, 0, 0);
         oal_plugin_check_error();
 
-        plugin->internal_state->sources = kallocate(sizeof(audio_plugin_source) * config.max_sources, MEMORY_TAG_AUDIO);
         // Create all sources.
         for (u32 i = 0; i < config.max_sources; ++i) {
             if (!oal_plugin_source_create(plugin, &plugin->internal_state->sources[i])) {
@@ -296,6 +619,16 @@ b8 oal_plugin_initialize(struct audio_plugin* plugin, audio_plugin_config config
 void oal_plugin_shutdown(struct audio_plugin* plugin) {
     if (plugin) {
         if (plugin->internal_state) {
+            // Let the mixer thread finish up before its sources go away.
+            katomic_store_u32(&plugin->internal_state->shutting_down, 1, KATOMIC_ORDER_RELEASE);
+            kmutex_lock(&plugin->internal_state->wake_mutex);
+            kcondvar_signal(&plugin->internal_state->wake_condvar);
+            kmutex_unlock(&plugin->internal_state->wake_mutex);
+            kthread_wait(&plugin->internal_state->mixer_thread);
+            kthread_destroy(&plugin->internal_state->mixer_thread);
+            kcondvar_destroy(&plugin->internal_state->wake_condvar);
+            kmutex_destroy(&plugin->internal_state->wake_mutex);
+
             // Destroy sources.
             for (u32 i = 0; i < plugin->internal_state->config.max_sources; ++i) {
                 oal_plugin_source_destroy(plugin, &plugin->internal_state->sources[i]);
@@ -317,6 +650,9 @@ b8 oal_plugin_update(struct audio_plugin* plugin, struct frame_data* p_frame_dat
         return false;
     }
 
+    // Commands queued this frame are picked up now, rather than each one waking the mixer.
+    oal_plugin_mixer_wake(plugin->internal_state);
+
     return true;
 }
 
@@ -337,8 +673,8 @@ b8 oal_plugin_listener_position_set(struct audio_plugin* plugin, vec3 position)
     }
 
     plugin->internal_state->listener_position = position;
-    alListener3f(AL_POSITION, position.x, position.y, position.z);
-    oal_plugin_check_error();
+    oal_command command = {.type = OAL_COMMAND_TYPE_LISTENER_POSITION, .position = position};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
@@ -362,9 +698,9 @@ b8 oal_plugin_listener_orientation_set(struct audio_plugin* plugin, vec3 forward
 
     plugin->internal_state->listener_forward = forward;
     plugin->internal_state->listener_up = up;
-    ALfloat listener_orientation[] = {forward.x, forward.y, forward.z, up.x, up.y, up.z};
-    alListenerfv(AL_ORIENTATION, listener_orientation);
-    return oal_plugin_check_error();
+    oal_command command = {.type = OAL_COMMAND_TYPE_LISTENER_ORIENTATION, .orientation = {forward, up}};
+    oal_plugin_command_push(plugin->internal_state, &command);
+    return true;
 }
 
 static b8 source_set_defaults(struct audio_plugin* plugin, audio_plugin_source* source, b8 reset_use) {
@@ -410,15 +746,6 @@ static b8 oal_plugin_source_create(struct audio_plugin* plugin, audio_plugin_sou
         KERROR("Failed to set source defaults, and thus failed to create source.");
     }
 
-    // Create the source worker thread's mutex.
-    kmutex_create(&out_source->data_mutex);
-
-    // Also create the worker thread itself for this source.
-    source_work_thread_params* params = kallocate(sizeof(source_work_thread_params), MEMORY_TAG_AUDIO);
-    params->source = out_source;
-    params->plugin = plugin;
-    kthread_create(source_work_thread, params, true, &out_source->thread);
-
     return true;
 }
 
@@ -538,8 +865,9 @@ b8 oal_plugin_source_gain_set(struct audio_plugin* plugin, u32 source_index, f32
     if (plugin && source_index <= plugin->internal_state->config.max_sources) {
         audio_plugin_source* source = &plugin->internal_state->sources[source_index];
         source->gain = gain;
-        alSourcef(source->id, AL_GAIN, gain);
-        return oal_plugin_check_error();
+        oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_GAIN, .source_index = source_index, .value = gain};
+        oal_plugin_command_push(plugin->internal_state, &command);
+        return true;
     }
 
     KERROR("Plugin pointer invalid or source id is invalid: %u.", source_index);
@@ -560,8 +888,9 @@ b8 oal_plugin_source_pitch_set(struct audio_plugin* plugin, u32 source_index, f3
     if (plugin && source_index <= plugin->internal_state->config.max_sources) {
         audio_plugin_source* source = &plugin->internal_state->sources[source_index];
         source->pitch = pitch;
-        alSourcef(source->id, AL_PITCH, pitch);
-        return oal_plugin_check_error();
+        oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_PITCH, .source_index = source_index, .value = pitch};
+        oal_plugin_command_push(plugin->internal_state, &command);
+        return true;
     }
 
     KERROR("Plugin pointer invalid or source id is invalid: %u.", source_index);
@@ -582,8 +911,9 @@ b8 oal_plugin_source_position_set(struct audio_plugin* plugin, u32 source_index,
     if (plugin && source_index <= plugin->internal_state->config.max_sources) {
         audio_plugin_source* source = &plugin->internal_state->sources[source_index];
         source->position = position;
-        alSource3f(source->id, AL_POSITION, position.x, position.y, position.z);
-        return oal_plugin_check_error();
+        oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_POSITION, .source_index = source_index, .position = position};
+        oal_plugin_command_push(plugin->internal_state, &command);
+        return true;
     }
 
     KERROR("Plugin pointer invalid or source id is invalid: %u.", source_index);
@@ -604,8 +934,9 @@ b8 oal_plugin_source_looping_set(struct audio_plugin* plugin, u32 source_index,
     if (plugin && source_index <= plugin->internal_state->config.max_sources) {
         audio_plugin_source* source = &plugin->internal_state->sources[source_index];
         source->looping = looping;
-        alSourcei(source->id, AL_LOOPING, looping ? AL_TRUE : AL_FALSE);
-        return oal_plugin_check_error();
+        oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_LOOPING, .source_index = source_index, .flag = looping};
+        oal_plugin_command_push(plugin->internal_state, &command);
+        return true;
     }
 
     KERROR("Plugin pointer invalid or source id is invalid: %u.", source_index);
@@ -683,69 +1014,166 @@ struct audio_file* oal_plugin_stream_load(struct audio_plugin* plugin, const cha
 
     out_file->plugin_data->is_looping = true;
 
-    return out_file;
-}
-
-struct audio_file* oal_plugin_chunk_load(struct audio_plugin* plugin, const char* name) {
-    if (!plugin) {
-        return 0;
+    // Room for the chunks decoded ahead.
+    audio_file_plugin_data* data = out_file->plugin_data;
+    u32 chunk_size = plugin->internal_state->config.chunk_size;
+    data->decoded_samples_size = sizeof(i16) * chunk_size * OAL_PLUGIN_DECODE_AHEAD_COUNT;
+    data->decoded_samples = kallocate(data->decoded_samples_size, MEMORY_TAG_AUDIO);
+    for (u32 i = 0; i < OAL_PLUGIN_DECODE_AHEAD_COUNT; ++i) {
+        data->decoded[i].samples = data->decoded_samples + (u64)chunk_size * i;
     }
 
-    // Load up the sound file. This also loads the data into a buffer.
-    if (!plugin || !name) {
-        KERROR("oal_plugin_open_sound_file requires valid pointers to plugin and name.");
-        return 0;
-    }
+    return out_file;
+}
 
+// Loads and decodes a sound effect, encoding it for upload if compression is enabled. Safe to call from a job thread.
+static audio_file* oal_plugin_chunk_decode(const audio_plugin_config* config, b8 use_ima4, const char* name) {
     // Load up the resource.
     // NOTE: Audio resources hold a pointer to this created resource to they can be
     // freed later. There is no need to release the resource here, nor should it be.
-    audio_file* out_file = 0;
     audio_resource_loader_params params = {0};
     params.type = AUDIO_FILE_TYPE_SOUND_EFFECT;
-    params.chunk_size = plugin->internal_state->config.chunk_size;
+    params.chunk_size = config->chunk_size;
     resource* audio_resource = kallocate(sizeof(resource), MEMORY_TAG_RESOURCE);
     if (!resource_system_load(name, RESOURCE_TYPE_AUDIO, &params, audio_resource)) {
         KERROR("Failed to open audio resource. Load failed.");
+        kfree(audio_resource, sizeof(resource), MEMORY_TAG_RESOURCE);
         return 0;
     }
 
-    out_file = audio_resource->data;
+    audio_file* out_file = audio_resource->data;
+    if (!out_file->total_samples || (out_file->channels != 1 && out_file->channels != 2)) {
+        KERROR("Audio file '%s' has no samples or an unsupported channel count (%d).", name, out_file->channels);
+        resource_system_unload(audio_resource);
+        return 0;
+    }
 
     // Setup plugin state.
     out_file->plugin_data = kallocate(sizeof(audio_file_plugin_data), MEMORY_TAG_AUDIO);
+    out_file->plugin_data->buffer = INVALID_ID;
+
+    // Format.
+    out_file->format = AL_FORMAT_MONO16;
+    if (out_file->channels == 2) {
+        out_file->format = AL_FORMAT_STEREO16;
+    }
+
+    if (use_ima4) {
+        u64 frame_count = out_file->total_samples / out_file->channels;
+        audio_file_plugin_data* data = out_file->plugin_data;
+        data->encoded_size = oal_ima4_encoded_size(frame_count, out_file->channels);
+        data->encoded = kallocate(data->encoded_size, MEMORY_TAG_AUDIO);
+        oal_ima4_encode(out_file->stream_buffer_data(out_file), frame_count, out_file->channels, data->encoded);
+        out_file->format = out_file->channels == 2 ? alGetEnumValue("AL_FORMAT_STEREO_IMA4") : alGetEnumValue("AL_FORMAT_MONO_IMA4");
+    }
 
+    return out_file;
+}
+
+static void oal_plugin_chunk_destroy(audio_file* file) {
+    if (file->plugin_data->encoded) {
+        kfree(file->plugin_data->encoded, file->plugin_data->encoded_size, MEMORY_TAG_AUDIO);
+    }
+    kfree(file->plugin_data, sizeof(audio_file_plugin_data), MEMORY_TAG_AUDIO);
+    resource_system_unload(file->audio_resource);
+}
+
+// Copies a decoded sound effect into a buffer, where it stays resident. Main thread only.
+static b8 oal_plugin_chunk_upload(audio_plugin* plugin, audio_file* file) {
     // Get a buffer.
-    out_file->plugin_data->buffer = oal_plugin_find_free_buffer(plugin);
-    if (out_file->plugin_data->buffer == INVALID_ID) {
-        kfree(out_file->plugin_data, sizeof(audio_file_plugin_data), MEMORY_TAG_AUDIO);
-        resource_system_unload(audio_resource);
+    file->plugin_data->buffer = oal_plugin_find_free_buffer(plugin);
+    if (file->plugin_data->buffer == INVALID_ID) {
         KERROR("Unable to open audio file due to no buffers being available.");
         return false;
     }
     oal_plugin_check_error();
 
-    // Format.
-    out_file->format = AL_FORMAT_MONO16;
-    if (out_file->channels == 2) {
-        out_file->format = AL_FORMAT_STEREO16;
+    // Load the whole thing into the buffer.
+    audio_file_plugin_data* data = file->plugin_data;
+    if (data->encoded) {
+        alBufferData(data->buffer, file->format, data->encoded, data->encoded_size, file->sample_rate);
+        // OpenAL keeps its own copy.
+        kfree(data->encoded, data->encoded_size, MEMORY_TAG_AUDIO);
+        data->encoded = 0;
+        data->encoded_size = 0;
+    } else {
+        void* pcm = file->stream_buffer_data(file);
+        alBufferData(data->buffer, file->format, (i16*)pcm, file->total_samples * sizeof(i16), file->sample_rate);
     }
+    return oal_plugin_check_error();
+}
 
-    if (out_file->total_samples_left > 0) {
-        // Load the whole thing into the buffer.
-        void* pcm = out_file->stream_buffer_data(out_file);
-        oal_plugin_check_error();
-        alBufferData(out_file->plugin_data->buffer, out_file->format, (i16*)pcm, out_file->total_samples_left, out_file->sample_rate);
-        oal_plugin_check_error();
-        return out_file;
+struct audio_file* oal_plugin_chunk_load(struct audio_plugin* plugin, const char* name) {
+    if (!plugin || !name) {
+        KERROR("oal_plugin_chunk_load requires valid pointers to plugin and name.");
+        return 0;
     }
 
-    // Error condition, free up everything and return.
-    if (out_file && out_file->plugin_data) {
-        kfree(out_file->plugin_data, sizeof(audio_file_plugin_data), MEMORY_TAG_AUDIO);
+    audio_file* out_file = oal_plugin_chunk_decode(&plugin->internal_state->config, plugin->internal_state->use_ima4, name);
+    if (!out_file) {
+        return 0;
     }
-    resource_system_unload(audio_resource);
-    return 0;
+    if (!oal_plugin_chunk_upload(plugin, out_file)) {
+        // Error condition, free up everything and return.
+        oal_plugin_chunk_destroy(out_file);
+        return 0;
+    }
+    return out_file;
+}
+
+typedef struct chunk_load_job_params {
+    audio_plugin* plugin;
+    audio_plugin_config config;
+    b8 use_ima4;
+    char name[256];
+    PFN_audio_chunk_loaded callback;
+    void* listener;
+    audio_file* file;
+} chunk_load_job_params;
+
+static b8 chunk_load_job_start(void* params, void* result_data) {
+    chunk_load_job_params* job_params = params;
+    job_params->file = oal_plugin_chunk_decode(&job_params->config, job_params->use_ima4, job_params->name);
+    kcopy_memory(result_data, job_params, sizeof(chunk_load_job_params));
+    return job_params->file != 0;
+}
+
+static void chunk_load_job_success(void* params) {
+    chunk_load_job_params* job_params = params;
+    audio_file* file = job_params->file;
+    if (!oal_plugin_chunk_upload(job_params->plugin, file)) {
+        oal_plugin_chunk_destroy(file);
+        file = 0;
+    }
+    job_params->callback(job_params->name, file, job_params->listener);
+}
+
+static void chunk_load_job_fail(void* params) {
+    chunk_load_job_params* job_params = params;
+    job_params->callback(job_params->name, 0, job_params->listener);
+}
+
+b8 oal_plugin_chunk_load_async(struct audio_plugin* plugin, const char* name, PFN_audio_chunk_loaded callback, void* listener) {
+    if (!plugin || !name || !callback) {
+        KERROR("oal_plugin_chunk_load_async requires valid pointers to plugin, name and callback.");
+        return false;
+    }
+    if (string_length(name) >= sizeof(((chunk_load_job_params*)0)->name)) {
+        KERROR("Audio file name '%s' is too long to be loaded asynchronously.", name);
+        return false;
+    }
+
+    // Decoding is done on a job thread. The buffer upload happens on the main thread, once that is done.
+    chunk_load_job_params params = {0};
+    params.plugin = plugin;
+    params.config = plugin->internal_state->config;
+    params.use_ima4 = plugin->internal_state->use_ima4;
+    string_ncopy(params.name, name, sizeof(params.name) - 1);
+    params.callback = callback;
+    params.listener = listener;
+    job_info job = job_create(chunk_load_job_start, chunk_load_job_success, chunk_load_job_fail, &params, sizeof(chunk_load_job_params), sizeof(chunk_load_job_params));
+    job_system_submit(job);
+    return true;
 }
 
 void oal_plugin_audio_file_close(struct audio_plugin* plugin, struct audio_file* file) {
@@ -754,9 +1182,32 @@ void oal_plugin_audio_file_close(struct audio_plugin* plugin, struct audio_file*
         return;
     }
 
-    clear_buffer(plugin, &file->plugin_data->buffer, 0);
+    // The mixer thread may still be playing or streaming the file.
+    oal_command command = {.type = OAL_COMMAND_TYPE_FILE_DETACH, .file = file};
+    oal_plugin_command_push(plugin->internal_state, &command);
+    oal_plugin_commands_flush(plugin->internal_state);
+
+    // Nothing is using the buffers any more, so they may be handed out again.
+    audio_file_plugin_data* data = file->plugin_data;
+    if (file->type == AUDIO_FILE_TYPE_SOUND_EFFECT) {
+        if (data->buffer != INVALID_ID) {
+            darray_push(plugin->internal_state->free_buffers, data->buffer);
+        }
+    } else {
+        for (u32 i = 0; i < OAL_PLUGIN_MUSIC_BUFFER_COUNT; ++i) {
+            darray_push(plugin->internal_state->free_buffers, data->buffers[i]);
+        }
+        // A job may still be decoding ahead into it.
+        oal_plugin_stream_decode_wait(file);
+        if (data->decoded_samples) {
+            kfree(data->decoded_samples, data->decoded_samples_size, MEMORY_TAG_AUDIO);
+        }
+    }
 
     // Clear plugin data.
+    if (data->encoded) {
+        kfree(data->encoded, data->encoded_size, MEMORY_TAG_AUDIO);
+    }
     kfree(file->plugin_data, sizeof(audio_file_plugin_data), MEMORY_TAG_AUDIO);
 
     resource* r = file->audio_resource;
@@ -768,54 +1219,30 @@ b8 oal_plugin_source_play(struct audio_plugin* plugin, i8 source_index) {
         return false;
     }
 
+    // Plays whatever was last assigned to the source, if anything.
     audio_plugin_source* source = &plugin->internal_state->sources[source_index];
-    kmutex_lock(&source->data_mutex);
-    if (source->current) {
-        source->trigger_play = true;
-        source->in_use = true;
-    }
-    kmutex_unlock(&source->data_mutex);
+    source->in_use = true;
+    oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_PLAY, .source_index = source_index};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
 
 b8 oal_plugin_play_on_source(struct audio_plugin* plugin, struct audio_file* file, i8 source_index) {
+    return oal_plugin_play_on_source_at(plugin, file, source_index, 0.0f);
+}
+
+b8 oal_plugin_play_on_source_at(struct audio_plugin* plugin, struct audio_file* file, i8 source_index, f32 offset_seconds) {
     if (!plugin || !file || source_index < 0) {
         return false;
     }
     KTRACE("Play on source %d", source_index);
 
-    // Assign the sound's buffer to the source.
+    // The mixer thread assigns the sound's buffers to the source and starts it.
     audio_plugin_source* source = &plugin->internal_state->sources[source_index];
-    kmutex_lock(&source->data_mutex);
-
-    if (file->type == AUDIO_FILE_TYPE_SOUND_EFFECT) {
-        // Queue up sound buffer.
-        alSourceQueueBuffers(source->id, 1, &file->plugin_data->buffer);
-        oal_plugin_check_error();
-    } else {
-        // Load data into all buffers initially.
-        b8 result = true;
-        for (u32 i = 0; i < OAL_PLUGIN_MUSIC_BUFFER_COUNT; ++i) {
-            if (!oal_plugin_stream_music_data(plugin, file->plugin_data->buffers[i], file)) {
-                KERROR("Failed to stream data to buffer &u in music file. File load failed.", i);
-                result = false;
-                break;
-            }
-        }
-        // Queue up new buffers.
-        alSourceQueueBuffers(source->id, OAL_PLUGIN_MUSIC_BUFFER_COUNT, file->plugin_data->buffers);
-        oal_plugin_check_error();
-        if (!result) {
-            //
-        }
-    }
-
-    // Assign current, set flags, play, etc.
-    source->current = file;
     source->in_use = true;
-    alSourcePlay(source->id);
-    kmutex_unlock(&source->data_mutex);
+    oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_PLAY_FILE, .source_index = source_index, .offset_seconds = offset_seconds, .file = file};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
@@ -826,17 +1253,9 @@ b8 oal_plugin_source_stop(struct audio_plugin* plugin, i8 source_index) {
     }
 
     audio_plugin_source* source = &plugin->internal_state->sources[source_index];
-
-    alSourceStop(source->id);
-
-    // Detach all buffers.
-    alSourcei(source->id, AL_BUFFER, 0);
-    oal_plugin_check_error();
-
-    // Rewind.
-    alSourceRewind(source->id);
-
     source->in_use = false;
+    oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_STOP, .source_index = source_index};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
@@ -846,12 +1265,8 @@ b8 oal_plugin_source_pause(struct audio_plugin* plugin, i8 source_index) {
     }
 
     // Trigger a pause if the source is currently playing.
-    audio_plugin_source* source = &plugin->internal_state->sources[source_index];
-    ALint source_state;
-    alGetSourcei(source->id, AL_SOURCE_STATE, &source_state);
-    if (source_state == AL_PLAYING) {
-        alSourcePause(source->id);
-    }
+    oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_PAUSE, .source_index = source_index};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
@@ -861,12 +1276,8 @@ b8 oal_plugin_source_resume(struct audio_plugin* plugin, i8 source_index) {
     }
 
     // Trigger a resume if the source is currently paused.
-    audio_plugin_source* source = &plugin->internal_state->sources[source_index];
-    ALint source_state;
-    alGetSourcei(source->id, AL_SOURCE_STATE, &source_state);
-    if (source_state == AL_PAUSED) {
-        alSourcePlay(source->id);
-    }
+    oal_command command = {.type = OAL_COMMAND_TYPE_SOURCE_RESUME, .source_index = source_index};
+    oal_plugin_command_push(plugin->internal_state, &command);
 
     return true;
 }
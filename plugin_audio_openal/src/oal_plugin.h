@@ -30,12 +30,14 @@ b8 oal_plugin_source_looping_query(struct audio_plugin* plugin, u32 source_id, b
 b8 oal_plugin_source_looping_set(struct audio_plugin* plugin, u32 source_id, b8 looping);
 
 struct audio_file* oal_plugin_chunk_load(struct audio_plugin* plugin, const char* name);
+b8 oal_plugin_chunk_load_async(struct audio_plugin* plugin, const char* name, PFN_audio_chunk_loaded callback, void* listener);
 struct audio_file* oal_plugin_stream_load(struct audio_plugin* plugin, const char* name);
 void oal_plugin_audio_file_close(struct audio_plugin* plugin, struct audio_file* file);
 
 // new api
 b8 oal_plugin_source_play(struct audio_plugin* plugin, i8 source_index);
 b8 oal_plugin_play_on_source(struct audio_plugin* plugin, struct audio_file* file, i8 source_index);
+b8 oal_plugin_play_on_source_at(struct audio_plugin* plugin, struct audio_file* file, i8 source_index, f32 offset_seconds);
 
 b8 oal_plugin_source_stop(struct audio_plugin* plugin, i8 source_index);
 b8 oal_plugin_source_pause(struct audio_plugin* plugin, i8 source_index);
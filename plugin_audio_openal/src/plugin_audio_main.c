@@ -32,10 +32,12 @@ b8 plugin_create(struct audio_plugin* out_plugin) {
     out_plugin->source_looping_set = oal_plugin_source_looping_set;
 
     out_plugin->chunk_load = oal_plugin_chunk_load;
+    out_plugin->chunk_load_async = oal_plugin_chunk_load_async;
     out_plugin->stream_load = oal_plugin_stream_load;
     out_plugin->audio_unload = oal_plugin_audio_file_close;
     out_plugin->source_play = oal_plugin_source_play;
     out_plugin->play_on_source = oal_plugin_play_on_source;
+    out_plugin->play_on_source_at = oal_plugin_play_on_source_at;
 
     out_plugin->source_stop = oal_plugin_source_stop;
     out_plugin->source_pause = oal_plugin_source_pause;
@@ -19,14 +19,11 @@
 #define MINIMP3_IMPLEMENTATION
 #include "vendor/minimp3_ex.h"
 
-// MP3 decoder;
-static mp3dec_t decoder;
-
 typedef struct audio_file_internal {
     // The internal ogg vorbis file handle, if the file is ogg. Otherwise null.
     stb_vorbis* vorbis;
-    // The internal mp3 file handle.
-    mp3dec_file_info_t mp3_info;
+    // The internal mp3 decoder, if the file is mp3. Otherwise null. Decodes incrementally.
+    mp3dec_ex_t* mp3;
     // Pulse-code modulation buffer, or raw data to be fed into a buffer.
     // Only used for some formats.
     i16* pcm;  // ALshort
@@ -38,9 +35,14 @@ static u64 audio_file_load_samples(struct audio_file* audio, u32 chunk_size, i32
         i64 samples = stb_vorbis_get_samples_short_interleaved(audio->internal_data->vorbis, audio->channels, audio->internal_data->pcm, chunk_size);
         // Sample here does not include channels, so factor them in.
         return samples * audio->channels;
-    } else if (audio->internal_data->mp3_info.buffer) {
-        // samples count includes channels.
-        return KMIN(audio->total_samples_left, chunk_size);
+    } else if (audio->internal_data->mp3) {
+        // Decode just the next chunk. Sample counts here include channels.
+        u64 samples = mp3dec_ex_read(audio->internal_data->mp3, audio->internal_data->pcm, KMIN(chunk_size, audio->internal_data->pcm_size / sizeof(i16)));
+        if (samples == 0 && audio->internal_data->mp3->last_error) {
+            KERROR("Error decoding mp3 samples: %d", audio->internal_data->mp3->last_error);
+            return INVALID_ID_U64;
+        }
+        return samples;
     }
     KERROR("Error loading samples: Unknown file type.");
     return INVALID_ID_U64;
@@ -48,9 +50,8 @@ static u64 audio_file_load_samples(struct audio_file* audio, u32 chunk_size, i32
 static void* audio_file_stream_buffer_data(struct audio_file* audio) {
     if (audio->internal_data->vorbis) {
         return audio->internal_data->pcm;
-    } else if (audio->internal_data->mp3_info.buffer) {
-        u64 pos = audio->internal_data->mp3_info.samples - audio->total_samples_left;
-        return audio->internal_data->mp3_info.buffer + pos;
+    } else if (audio->internal_data->mp3) {
+        return audio->internal_data->pcm;
     } else {
         KERROR("Error streaming audio dta: Unknown file type. Null is returned.")
         return 0;
@@ -62,9 +63,10 @@ void audio_file_rewind(struct audio_file* audio) {
             stb_vorbis_seek_start(audio->internal_data->vorbis);
             // Reset sample counter.
             audio->total_samples_left = stb_vorbis_stream_length_in_samples(audio->internal_data->vorbis) * audio->channels;
-        } else if (audio->internal_data->mp3_info.buffer) {
+        } else if (audio->internal_data->mp3) {
+            mp3dec_ex_seek(audio->internal_data->mp3, 0);
             // Reset sample counter.
-            audio->total_samples_left = audio->internal_data->mp3_info.samples;
+            audio->total_samples_left = audio->internal_data->mp3->samples;
         } else {
             KERROR("Error rewinding audio file: unknown type.");
             return;
@@ -72,6 +74,29 @@ void audio_file_rewind(struct audio_file* audio) {
     }
 }
 
+static b8 audio_file_seek(struct audio_file* audio, u64 sample) {
+    if (audio) {
+        if (audio->internal_data->vorbis) {
+            if (!stb_vorbis_seek(audio->internal_data->vorbis, (u32)sample)) {
+                KERROR("Error seeking ogg file to sample %llu.", sample);
+                return false;
+            }
+        } else if (audio->internal_data->mp3) {
+            // Positions here include channels.
+            if (mp3dec_ex_seek(audio->internal_data->mp3, sample * audio->channels)) {
+                KERROR("Error seeking mp3 file to sample %llu.", sample);
+                return false;
+            }
+        } else {
+            KERROR("Error seeking audio file: unknown type.");
+            return false;
+        }
+        audio->total_samples_left = audio->total_samples - KMIN(sample * audio->channels, audio->total_samples);
+        return true;
+    }
+    return false;
+}
+
 static b8 audio_loader_load(struct resource_loader* self, const char* name, void* params, resource* out_resource) {
     if (!self || !name || !out_resource) {
         return false;
@@ -109,6 +134,7 @@ static b8 audio_loader_load(struct resource_loader* self, const char* name, void
         resource_data->sample_rate = info.sample_rate;
         // Samples including all channels.
         resource_data->total_samples_left = stb_vorbis_stream_length_in_samples(resource_data->internal_data->vorbis) * info.channels;
+        resource_data->total_samples = resource_data->total_samples_left;
 
         if (resource_data->type == AUDIO_FILE_TYPE_MUSIC_STREAM) {
             // Need a buffer to extract sample data into.
@@ -138,14 +164,39 @@ static b8 audio_loader_load(struct resource_loader* self, const char* name, void
     } else if (string_index_of_str(".mp3", full_file_path) != -1) {
         KTRACE("Processing MP3 file '%s'...", full_file_path);
 
-        mp3dec_load(&decoder, full_file_path, &resource_data->internal_data->mp3_info, 0, 0);
-        mp3dec_file_info_t* info = &resource_data->internal_data->mp3_info;
-        KDEBUG("mp3 freq: %dHz, avg kbit/s rate: %u", info->hz, info->avg_bitrate_kbps);
-        resource_data->channels = info->channels;
-        resource_data->sample_rate = info->hz;
+        // Opening only scans frame headers for the length. Nothing is decoded until samples are read.
+        mp3dec_ex_t* mp3 = kallocate(sizeof(mp3dec_ex_t), MEMORY_TAG_AUDIO);
+        i32 mp3_error = mp3dec_ex_open(mp3, full_file_path, MP3D_SEEK_TO_SAMPLE);
+        if (mp3_error || !mp3->samples) {
+            KERROR("Failed to open mp3 file with error: %d", mp3_error);
+            mp3dec_ex_close(mp3);
+            kfree(mp3, sizeof(mp3dec_ex_t), MEMORY_TAG_AUDIO);
+            return false;
+        }
+        resource_data->internal_data->mp3 = mp3;
+        KDEBUG("mp3 freq: %dHz, kbit/s rate: %u", mp3->info.hz, mp3->info.bitrate_kbps);
+        resource_data->channels = mp3->info.channels;
+        resource_data->sample_rate = mp3->info.hz;
 
         // Samples here include channels.
-        resource_data->total_samples_left = info->samples;
+        resource_data->total_samples_left = mp3->samples;
+        resource_data->total_samples = mp3->samples;
+
+        if (resource_data->type == AUDIO_FILE_TYPE_MUSIC_STREAM) {
+            // Each chunk is decoded into this as the stream is played.
+            u64 buffer_length = typed_params->chunk_size * sizeof(i16);
+            resource_data->internal_data->pcm = kallocate(buffer_length, MEMORY_TAG_AUDIO);
+            resource_data->internal_data->pcm_size = buffer_length;
+        } else {
+            // Sound effects are played from a single buffer, so decode it all at once.
+            u64 buffer_length = mp3->samples * sizeof(i16);
+            resource_data->internal_data->pcm = kallocate(buffer_length, MEMORY_TAG_AUDIO);
+            resource_data->internal_data->pcm_size = buffer_length;
+            u64 read_samples = mp3dec_ex_read(mp3, resource_data->internal_data->pcm, mp3->samples);
+            if (read_samples != mp3->samples) {
+                KWARN("Read/length mismatch while reading mp3 file. This might cause playback issues.");
+            }
+        }
     } else {
         KERROR("Unsupported audio file type.");
         return false;
@@ -155,6 +206,7 @@ static b8 audio_loader_load(struct resource_loader* self, const char* name, void
     resource_data->load_samples = audio_file_load_samples;
     resource_data->stream_buffer_data = audio_file_stream_buffer_data;
     resource_data->rewind = audio_file_rewind;
+    resource_data->seek = audio_file_seek;
 
     out_resource->data = resource_data;
     out_resource->data_size = sizeof(audio_file);
@@ -170,15 +222,16 @@ static void audio_loader_unload(struct resource_loader* self, resource* resource
         if (resource_data->internal_data) {
             if (resource_data->internal_data->vorbis) {
                 stb_vorbis_close(resource_data->internal_data->vorbis);
-            } else if (resource_data->internal_data->mp3_info.buffer) {
-                // TODO: dispose of mp3 data.
+            } else if (resource_data->internal_data->mp3) {
+                mp3dec_ex_close(resource_data->internal_data->mp3);
+                kfree(resource_data->internal_data->mp3, sizeof(mp3dec_ex_t), MEMORY_TAG_AUDIO);
             }
-            kfree(resource_data->internal_data, sizeof(audio_file_internal), MEMORY_TAG_RESOURCE);
 
             if (resource_data->internal_data->pcm) {
                 kfree(resource_data->internal_data->pcm, resource_data->internal_data->pcm_size, MEMORY_TAG_AUDIO);
                 resource_data->internal_data->pcm_size = 0;
             }
+            kfree(resource_data->internal_data, sizeof(audio_file_internal), MEMORY_TAG_RESOURCE);
         }
     }
 
@@ -188,9 +241,6 @@ static void audio_loader_unload(struct resource_loader* self, resource* resource
 }
 
 resource_loader audio_resource_loader_create(void) {
-    // Initialize mp3 decoder
-    mp3dec_init(&decoder);
-
     resource_loader loader;
     loader.type = RESOURCE_TYPE_AUDIO;
     loader.custom_type = 0;
@@ -57,6 +57,7 @@ b8 sui_button_control_height_set(struct sui_control* self, i32 height) {
     self->bounds.height = height;
 
     update_nine_slice(&typed_data->nslice, 0);
+    sui_control_dirty_set(self);
 
     return true;
 }
@@ -70,10 +71,11 @@ b8 sui_button_control_load(struct sui_control* self) {
     standard_ui_state* typed_state = systems_manager_get_state(K_SYSTEM_TYPE_STANDARD_UI_EXT);
 
     // HACK: TODO: remove hardcoded stuff.
-    /* vec2i atlas_size = (vec2i){typed_state->ui_atlas.texture->width, typed_state->ui_atlas.texture->height}; */
-    vec2i atlas_size = (vec2i){512, 512};
-    vec2i atlas_min = (vec2i){151, 12};
-    vec2i atlas_max = (vec2i){158, 19};
+    // Pixel coordinates within the standard UI image, moved to where it is in the atlas.
+    const sui_atlas_region* region = &typed_state->ui_atlas_region;
+    vec2i atlas_size = region->page_size;
+    vec2i atlas_min = (vec2i){region->offset.x + 151, region->offset.y + 12};
+    vec2i atlas_max = (vec2i){region->offset.x + 158, region->offset.y + 19};
     vec2i corner_px_size = (vec2i){3, 3};
     vec2i corner_size = (vec2i){10, 10};
     if (!generate_nine_slice(self->name, typed_data->size, atlas_size, atlas_min, atlas_max, corner_px_size, corner_size, &typed_data->nslice)) {
@@ -87,7 +89,7 @@ b8 sui_button_control_load(struct sui_control* self) {
     self->bounds.height = typed_data->size.y;
 
     // Acquire instance resources for this control.
-    texture_map* maps[1] = {&typed_state->ui_atlas};
+    texture_map* maps[1] = {region->map};
     shader* s = shader_system_get("Shader.StandardUI");
     u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
     shader_instance_resource_config instance_resource_config = {0};
@@ -135,6 +137,8 @@ b8 sui_button_control_render(struct sui_control* self, struct frame_data* p_fram
         renderable.render_data.index_count = typed_data->nslice.g->index_count;
         renderable.render_data.index_element_size = typed_data->nslice.g->index_element_size;
         renderable.render_data.index_buffer_offset = typed_data->nslice.g->index_buffer_offset;
+        renderable.vertices = typed_data->nslice.g->vertices;
+        renderable.indices = typed_data->nslice.g->indices;
         renderable.render_data.model = transform_world_get(&self->xform);
         renderable.render_data.diffuse_colour = vec4_one();  // white. TODO: pull from object properties.
 
@@ -156,6 +160,7 @@ void sui_button_on_mouse_out(struct sui_control* self, struct sui_mouse_event ev
         typed_data->nslice.atlas_px_max.x = 158;
         typed_data->nslice.atlas_px_max.y = 19;
         update_nine_slice(&typed_data->nslice, 0);
+        sui_control_dirty_set(self);
     }
 }
 
@@ -174,6 +179,7 @@ void sui_button_on_mouse_over(struct sui_control* self, struct sui_mouse_event e
             typed_data->nslice.atlas_px_max.y = 37;
         }
         update_nine_slice(&typed_data->nslice, 0);
+        sui_control_dirty_set(self);
     }
 }
 void sui_button_on_mouse_down(struct sui_control* self, struct sui_mouse_event event) {
@@ -184,6 +190,7 @@ void sui_button_on_mouse_down(struct sui_control* self, struct sui_mouse_event e
         typed_data->nslice.atlas_px_max.x = 158;
         typed_data->nslice.atlas_px_max.y = 28;
         update_nine_slice(&typed_data->nslice, 0);
+        sui_control_dirty_set(self);
     }
 }
 void sui_button_on_mouse_up(struct sui_control* self, struct sui_mouse_event event) {
@@ -202,5 +209,6 @@ void sui_button_on_mouse_up(struct sui_control* self, struct sui_mouse_event eve
             typed_data->nslice.atlas_px_max.y = 37;
         }
         update_nine_slice(&typed_data->nslice, 0);
+        sui_control_dirty_set(self);
     }
 }
@@ -4,13 +4,14 @@
 #include <core/kmemory.h>
 #include <core/kstring.h>
 #include <core/logger.h>
+#include <core/systems_manager.h>
 #include <math/kmath.h>
 #include <math/transform.h>
 #include <renderer/renderer_frontend.h>
 #include <systems/font_system.h>
 #include <systems/shader_system.h>
 
-static void regenerate_label_geometry(sui_control* self);
+static void regenerate_label_geometry(sui_control* self, u32 first_changed_char);
 
 b8 sui_label_control_create(const char* name, font_type type, const char* font_name, u16 font_size, const char* text, struct sui_control* out_control) {
     if (!sui_base_control_create(name, out_control)) {
@@ -46,15 +47,23 @@ b8 sui_label_control_create(const char* name, font_type type, const char* font_n
 
     typed_data->text = string_duplicate(text);
 
+    // Bitmap font pages never change, so can be packed into the UI atlas. System font atlases grow as
+    // glyphs are added, so are drawn on their own.
+    typed_data->atlas = &typed_data->data->atlas;
+    if (typed_data->type == FONT_TYPE_BITMAP && typed_data->data->atlas.texture) {
+        standard_ui_state* typed_state = systems_manager_get_state(K_SYSTEM_TYPE_STANDARD_UI_EXT);
+        typed_data->atlas_packed = standard_ui_system_atlas_image_acquire(typed_state, typed_data->data->atlas.texture->name, &typed_data->atlas_region);
+        if (typed_data->atlas_packed) {
+            typed_data->atlas = typed_data->atlas_region.map;
+        }
+    }
+
     typed_data->instance_id = INVALID_ID;
     typed_data->frame_number = INVALID_ID_U64;
 
-    typed_data->vertex_buffer_offset = INVALID_ID_U64;
-    typed_data->index_buffer_offset = INVALID_ID_U64;
-
     // Acquire resources for font texture map.
     // TODO: Should there be an override option for the shader?
-    texture_map* maps[1] = {&typed_data->data->atlas};
+    texture_map* maps[1] = {typed_data->atlas};
     shader* s = shader_system_get("Shader.StandardUI");
     u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
     shader_instance_resource_config instance_resource_config = {0};
@@ -90,28 +99,8 @@ b8 sui_label_control_load(struct sui_control* self) {
         return false;
     }
 
-    sui_label_internal_data* typed_data = self->internal_data;
-
-    if (typed_data->text && typed_data->text[0] != 0) {
-        static const u64 quad_vertex_size = (sizeof(vertex_2d) * 4);
-        static const u64 quad_index_size = (sizeof(u32) * 6);
-        u64 text_length = string_utf8_length(typed_data->text);
-
-        // Allocate space in the buffers.
-        renderbuffer* vertex_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_VERTEX);
-        if (!renderer_renderbuffer_allocate(vertex_buffer, quad_vertex_size * text_length, &typed_data->vertex_buffer_offset)) {
-            KERROR("sui_label_control_load failed to allocate from the renderer's vertex buffer!");
-            return false;
-        }
-
-        renderbuffer* index_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_INDEX);
-        if (!renderer_renderbuffer_allocate(index_buffer, quad_index_size * text_length, &typed_data->index_buffer_offset)) {
-            KERROR("sui_label_control_load failed to allocate from the renderer's index buffer!");
-            return false;
-        }
-    }
     // Generate geometry.
-    regenerate_label_geometry(self);
+    regenerate_label_geometry(self, 0);
 
     return true;
 }
@@ -125,29 +114,25 @@ void sui_label_control_unload(struct sui_control* self) {
         typed_data->text = 0;
     }
 
-    // Free from the vertex buffer.
-    renderbuffer* vertex_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_VERTEX);
+    // Free the geometry.
     if (typed_data->max_text_length > 0) {
-        renderer_renderbuffer_free(vertex_buffer, sizeof(vertex_2d) * 4 * typed_data->max_text_length, typed_data->vertex_buffer_offset);
-    }
-
-    // Free from the index buffer.
-    if (typed_data->vertex_buffer_offset != INVALID_ID_U64) {
-        static const u64 quad_index_size = (sizeof(u32) * 6);
-        renderbuffer* index_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_INDEX);
-        if (typed_data->max_text_length > 0) {
-            renderer_renderbuffer_free(index_buffer, quad_index_size * typed_data->max_text_length, typed_data->index_buffer_offset);
-        }
-        typed_data->vertex_buffer_offset = INVALID_ID_U64;
+        kfree(typed_data->vertices, sizeof(vertex_2d) * 4 * typed_data->max_text_length, MEMORY_TAG_ARRAY);
+        kfree(typed_data->indices, sizeof(u32) * 6 * typed_data->max_text_length, MEMORY_TAG_ARRAY);
+        kfree(typed_data->origins, sizeof(sui_label_char_origin) * typed_data->max_text_length, MEMORY_TAG_ARRAY);
+        typed_data->vertices = 0;
+        typed_data->indices = 0;
+        typed_data->origins = 0;
+        typed_data->max_text_length = 0;
+        typed_data->cached_ut8_length = 0;
     }
 
     // Release resources for font texture map.
-    if (typed_data->index_buffer_offset != INVALID_ID_U64) {
+    if (typed_data->instance_id != INVALID_ID) {
         shader* ui_shader = shader_system_get("Shader.StandardUI");  // TODO: text shader.
         if (!renderer_shader_instance_resources_release(ui_shader, typed_data->instance_id)) {
             KFATAL("Unable to release shader resources for font texture map.");
         }
-        typed_data->index_buffer_offset = INVALID_ID_U64;
+        typed_data->instance_id = INVALID_ID;
     }
 }
 
@@ -156,7 +141,12 @@ b8 sui_label_control_update(struct sui_control* self, struct frame_data* p_frame
         return false;
     }
 
-    //
+    // Another label using the same font may have grown its atlas, moving the glyphs of this one.
+    sui_label_internal_data* typed_data = self->internal_data;
+    if (typed_data->cached_ut8_length && typed_data->data->atlas_generation != typed_data->layout_atlas_generation) {
+        regenerate_label_geometry(self, 0);
+        sui_control_dirty_set(self);
+    }
 
     return true;
 }
@@ -173,14 +163,15 @@ b8 sui_label_control_render(struct sui_control* self, struct frame_data* p_frame
         renderable.render_data.unique_id = self->id.uniqueid;
         renderable.render_data.material = 0;
         renderable.render_data.vertex_count = typed_data->cached_ut8_length * 4;
-        renderable.render_data.vertex_buffer_offset = typed_data->vertex_buffer_offset;
         renderable.render_data.vertex_element_size = sizeof(vertex_2d);
         renderable.render_data.index_count = typed_data->cached_ut8_length * 6;
-        renderable.render_data.index_buffer_offset = typed_data->index_buffer_offset;
         renderable.render_data.index_element_size = sizeof(u32);
+        renderable.vertices = typed_data->vertices;
+        renderable.indices = typed_data->indices;
 
         // NOTE: Override the default UI atlas and use that of the loaded font instead.
-        renderable.atlas_override = &typed_data->data->atlas;
+        renderable.atlas_override = typed_data->atlas;
+        renderable.is_distance_field = typed_data->type == FONT_TYPE_SYSTEM_SDF;
 
         renderable.render_data.model = transform_world_get(&self->xform);
         renderable.render_data.diffuse_colour = typed_data->colour;
@@ -204,18 +195,36 @@ void sui_label_text_set(struct sui_control* self, const char* text) {
             return;
         }
 
+        // Find the first character which differs, counted in UTF-8 characters, and where it starts.
+        u32 first_changed_char = 0;
+        u32 first_changed_byte = 0;
+        if (typed_data->text) {
+            for (u32 i = 0; text[i] && text[i] == typed_data->text[i]; ++i) {
+                // Count lead bytes only, not continuation bytes.
+                if (((u8)text[i] & 0xC0) != 0x80) {
+                    first_changed_char++;
+                    first_changed_byte = i;
+                }
+            }
+            // The differing byte may be partway through the last character counted.
+            if (first_changed_char > 0) {
+                first_changed_char--;
+            }
+        }
+
         if (typed_data->text) {
             u32 text_length = string_length(typed_data->text);
             kfree(typed_data->text, sizeof(char) * text_length + 1, MEMORY_TAG_STRING);
         }
         typed_data->text = string_duplicate(text);
 
-        // Verify atlas has the glyphs needed.
-        if (!font_system_verify_atlas(typed_data->data, text)) {
+        // Verify atlas has the glyphs needed. Those of the unchanged characters already were.
+        if (!font_system_verify_atlas(typed_data->data, text + first_changed_byte)) {
             KERROR("Font atlas verification failed.");
         }
 
-        regenerate_label_geometry(self);
+        regenerate_label_geometry(self, first_changed_char);
+        sui_control_dirty_set(self);
     }
 }
 
@@ -227,7 +236,31 @@ const char* sui_label_text_get(struct sui_control* self) {
     return 0;
 }
 
-static void regenerate_label_geometry(sui_control* self) {
+f32 sui_label_pen_x_get(struct sui_control* self, u32 byte_offset) {
+    if (!self || !self->internal_data) {
+        return 0;
+    }
+    sui_label_internal_data* typed_data = self->internal_data;
+    u32 count = typed_data->cached_ut8_length;
+    if (!count || byte_offset == 0) {
+        return 0;
+    }
+
+    // Byte offsets of the characters only increase, so find the first at or past the offset.
+    u32 low = 0;
+    u32 high = count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (typed_data->origins[mid].byte_offset < byte_offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < count ? typed_data->origins[low].pen.x : typed_data->end_pen.x;
+}
+
+static void regenerate_label_geometry(sui_control* self, u32 first_changed_char) {
     sui_label_internal_data* typed_data = self->internal_data;
 
     // Get the UTF-8 string length
@@ -236,64 +269,86 @@ static void regenerate_label_geometry(sui_control* self) {
     // Also get the length in characters.
     u32 char_length = string_length(typed_data->text);
 
-    b8 needs_realloc = text_length_utf8 > typed_data->max_text_length;
-
     // Don't try to regenerate geometry for something that doesn't have any text.
     if (text_length_utf8 < 1) {
+        typed_data->end_pen = vec2_zero();
         return;
     }
 
-    // Calculate buffer sizes.
     static const u64 verts_per_quad = 4;
     static const u8 indices_per_quad = 6;
-    u64 prev_vertex_buffer_size = sizeof(vertex_2d) * verts_per_quad * typed_data->max_text_length;
-    u64 prev_index_buffer_size = sizeof(u32) * indices_per_quad * typed_data->max_text_length;
-    u64 vertex_buffer_size = sizeof(vertex_2d) * verts_per_quad * text_length_utf8;
-    u64 index_buffer_size = sizeof(u32) * indices_per_quad * text_length_utf8;
-
-    renderbuffer* vertex_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_VERTEX);
-    renderbuffer* index_buffer = renderer_renderbuffer_get(RENDERBUFFER_TYPE_INDEX);
 
-    if (needs_realloc) {
-        // Realloc from the vertex buffer.
-        if (typed_data->max_text_length > 0) {
-            if (!renderer_renderbuffer_free(vertex_buffer, prev_vertex_buffer_size, typed_data->vertex_buffer_offset)) {
-                KERROR("Failed to free from renderer vertex buffer: size=%u, offset=%u", vertex_buffer_size, typed_data->vertex_buffer_offset);
-            }
-        }
-        if (!renderer_renderbuffer_allocate(vertex_buffer, vertex_buffer_size, &typed_data->vertex_buffer_offset)) {
-            KERROR("regenerate_label_geometry failed to allocate from the renderer's vertex buffer!");
-            return;
+    // Grow to the next power of two, so that text which keeps changing length rarely needs to.
+    if (text_length_utf8 > typed_data->max_text_length) {
+        u32 new_max = typed_data->max_text_length ? typed_data->max_text_length : 16;
+        while (new_max < text_length_utf8) {
+            new_max *= 2;
         }
 
-        // Realloc from the index buffer.
         if (typed_data->max_text_length > 0) {
-            if (!renderer_renderbuffer_free(index_buffer, prev_index_buffer_size, typed_data->index_buffer_offset)) {
-                KERROR("Failed to free from renderer index buffer: size=%u, offset=%u", index_buffer_size, typed_data->index_buffer_offset);
-            }
+            kfree(typed_data->vertices, sizeof(vertex_2d) * verts_per_quad * typed_data->max_text_length, MEMORY_TAG_ARRAY);
+            kfree(typed_data->indices, sizeof(u32) * indices_per_quad * typed_data->max_text_length, MEMORY_TAG_ARRAY);
+            kfree(typed_data->origins, sizeof(sui_label_char_origin) * typed_data->max_text_length, MEMORY_TAG_ARRAY);
         }
-        if (!renderer_renderbuffer_allocate(index_buffer, index_buffer_size, &typed_data->index_buffer_offset)) {
-            KERROR("regenerate_label_geometry failed to allocate from the renderer's index buffer!");
-            return;
+        typed_data->vertices = kallocate(sizeof(vertex_2d) * verts_per_quad * new_max, MEMORY_TAG_ARRAY);
+        typed_data->indices = kallocate(sizeof(u32) * indices_per_quad * new_max, MEMORY_TAG_ARRAY);
+        typed_data->origins = kallocate(sizeof(sui_label_char_origin) * new_max, MEMORY_TAG_ARRAY);
+        typed_data->max_text_length = new_max;
+
+        // Every quad is indexed the same way regardless of its glyph, so indices only need
+        // generating once. Quads without a glyph are left with zeroed, degenerate vertices.
+        for (u32 q = 0; q < new_max; ++q) {
+            // Index data 210301
+            typed_data->indices[(q * 6) + 0] = (q * 4) + 2;
+            typed_data->indices[(q * 6) + 1] = (q * 4) + 1;
+            typed_data->indices[(q * 6) + 2] = (q * 4) + 0;
+            typed_data->indices[(q * 6) + 3] = (q * 4) + 3;
+            typed_data->indices[(q * 6) + 4] = (q * 4) + 0;
+            typed_data->indices[(q * 6) + 5] = (q * 4) + 1;
         }
+
+        // Nothing laid out before survived.
+        first_changed_char = 0;
     }
 
-    // Update the max length if the string is now longer.
-    if (text_length_utf8 > typed_data->max_text_length) {
-        typed_data->max_text_length = text_length_utf8;
+    // A grown atlas moves every glyph.
+    if (typed_data->data->atlas_generation != typed_data->layout_atlas_generation) {
+        typed_data->layout_atlas_generation = typed_data->data->atlas_generation;
+        first_changed_char = 0;
     }
 
-    // Generate new geometry for each character.
+    // The character before the first change is kerned against it, so lay out again from there.
+    u32 start_char = first_changed_char > 0 ? first_changed_char - 1 : 0;
+
     f32 x = 0;
     f32 y = 0;
-    // Temp arrays to hold vertex/index data.
-    vertex_2d* vertex_buffer_data = kallocate(vertex_buffer_size, MEMORY_TAG_ARRAY);
-    u32* index_buffer_data = kallocate(index_buffer_size, MEMORY_TAG_ARRAY);
+    u32 start_byte = 0;
+    if (start_char > 0) {
+        x = typed_data->origins[start_char].pen.x;
+        y = typed_data->origins[start_char].pen.y;
+        start_byte = typed_data->origins[start_char].byte_offset;
+    }
+
+    // Where glyph pixel coordinates are within the texture the label is drawn from.
+    vec2 atlas_offset = {0, 0};
+    vec2 atlas_size = {(f32)typed_data->data->atlas_size_x, (f32)typed_data->data->atlas_size_y};
+    if (typed_data->atlas_packed) {
+        atlas_offset = (vec2){(f32)typed_data->atlas_region.offset.x, (f32)typed_data->atlas_region.offset.y};
+        atlas_size = (vec2){(f32)typed_data->atlas_region.page_size.x, (f32)typed_data->atlas_region.page_size.y};
+    }
+
+    // Generate new geometry for each character from the start onward.
+    vertex_2d* vertex_buffer_data = typed_data->vertices;
+    // Characters without a glyph leave their quad degenerate.
+    kzero_memory(&vertex_buffer_data[start_char * verts_per_quad], sizeof(vertex_2d) * verts_per_quad * (text_length_utf8 - start_char));
 
     // Take the length in chars and get the correct codepoint from it.
-    for (u32 c = 0, uc = 0; c < char_length; ++c) {
+    for (u32 c = start_byte, uc = start_char; c < char_length; ++c) {
         i32 codepoint = typed_data->text[c];
 
+        typed_data->origins[uc].pen = (vec2){x, y};
+        typed_data->origins[uc].byte_offset = c;
+
         // Continue to next line for newline.
         if (codepoint == '\n') {
             x = 0;
@@ -316,37 +371,27 @@ static void regenerate_label_geometry(sui_control* self) {
             codepoint = -1;
         }
 
-        font_glyph* g = 0;
-        for (u32 i = 0; i < typed_data->data->glyph_count; ++i) {
-            if (typed_data->data->glyphs[i].codepoint == codepoint) {
-                g = &typed_data->data->glyphs[i];
-                break;
-            }
-        }
-
+        font_glyph* g = font_system_glyph_get(typed_data->data, codepoint);
         if (!g) {
             // If not found, use the codepoint -1
             codepoint = -1;
-            for (u32 i = 0; i < typed_data->data->glyph_count; ++i) {
-                if (typed_data->data->glyphs[i].codepoint == codepoint) {
-                    g = &typed_data->data->glyphs[i];
-                    break;
-                }
-            }
+            g = font_system_glyph_get(typed_data->data, codepoint);
         }
 
         if (g) {
             // Found the glyph. generate points.
-            f32 minx = x + g->x_offset;
-            f32 miny = y + g->y_offset;
-            f32 maxx = minx + g->width;
-            f32 maxy = miny + g->height;
-            f32 tminx = (f32)g->x / typed_data->data->atlas_size_x;
-            f32 tmaxx = (f32)(g->x + g->width) / typed_data->data->atlas_size_x;
-            f32 tminy = (f32)g->y / typed_data->data->atlas_size_y;
-            f32 tmaxy = (f32)(g->y + g->height) / typed_data->data->atlas_size_y;
+            // Glyphs of SDF fonts are stored at the size of their atlas, so get scaled to the font's.
+            f32 glyph_scale = typed_data->data->glyph_scale;
+            f32 minx = x + g->x_offset * glyph_scale;
+            f32 miny = y + g->y_offset * glyph_scale;
+            f32 maxx = minx + g->width * glyph_scale;
+            f32 maxy = miny + g->height * glyph_scale;
+            f32 tminx = (f32)(atlas_offset.x + g->x) / atlas_size.x;
+            f32 tmaxx = (f32)(atlas_offset.x + g->x + g->width) / atlas_size.x;
+            f32 tminy = (f32)(atlas_offset.y + g->y) / atlas_size.y;
+            f32 tmaxy = (f32)(atlas_offset.y + g->y + g->height) / atlas_size.y;
             // Flip the y axis for system text
-            if (typed_data->type == FONT_TYPE_SYSTEM) {
+            if (typed_data->type == FONT_TYPE_SYSTEM || typed_data->type == FONT_TYPE_SYSTEM_SDF) {
                 tminy = 1.0f - tminy;
                 tmaxy = 1.0f - tmaxy;
             }
@@ -376,15 +421,10 @@ static void regenerate_label_geometry(sui_control* self) {
                     KWARN("Invalid UTF-8 found in string, using unknown codepoint of -1");
                     codepoint = -1;
                 } else {
-                    for (u32 i = 0; i < typed_data->data->kerning_count; ++i) {
-                        font_kerning* k = &typed_data->data->kernings[i];
-                        if (k->codepoint_0 == codepoint && k->codepoint_1 == next_codepoint) {
-                            kerning = k->amount;
-                        }
-                    }
+                    kerning = font_system_kerning_get(typed_data->data, codepoint, next_codepoint);
                 }
             }
-            x += g->x_advance + kerning;
+            x += (g->x_advance + kerning) * glyph_scale;
 
         } else {
             KERROR("Unable to find unknown codepoint. Skipping.");
@@ -393,33 +433,11 @@ static void regenerate_label_geometry(sui_control* self) {
             continue;
         }
 
-        // Index data 210301
-        index_buffer_data[(uc * 6) + 0] = (uc * 4) + 2;
-        index_buffer_data[(uc * 6) + 1] = (uc * 4) + 1;
-        index_buffer_data[(uc * 6) + 2] = (uc * 4) + 0;
-        index_buffer_data[(uc * 6) + 3] = (uc * 4) + 3;
-        index_buffer_data[(uc * 6) + 4] = (uc * 4) + 0;
-        index_buffer_data[(uc * 6) + 5] = (uc * 4) + 1;
-
         // Now advance c
         c += advance - 1;  // Subtracting 1 because the loop always increments once for single-byte anyway.
         // Increment utf-8 character count.
         uc++;
     }
 
-    // Load up the data.
-    b8 vertex_load_result = renderer_renderbuffer_load_range(vertex_buffer, typed_data->vertex_buffer_offset, vertex_buffer_size, vertex_buffer_data);
-    b8 index_load_result = renderer_renderbuffer_load_range(index_buffer, typed_data->index_buffer_offset, index_buffer_size, index_buffer_data);
-
-    // Clean up.
-    kfree(vertex_buffer_data, vertex_buffer_size, MEMORY_TAG_ARRAY);
-    kfree(index_buffer_data, index_buffer_size, MEMORY_TAG_ARRAY);
-
-    // Verify results.
-    if (!vertex_load_result) {
-        KERROR("regenerate_geometry failed to load data into vertex buffer range.");
-    }
-    if (!index_load_result) {
-        KERROR("regenerate_geometry failed to load data into index buffer range.");
-    }
+    typed_data->end_pen = (vec2){x, y};
 }
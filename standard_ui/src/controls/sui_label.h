@@ -2,6 +2,14 @@
 
 #include "standard_ui_system.h"
 
+// Where a character of a label's text was laid out from.
+typedef struct sui_label_char_origin {
+    // The pen position before the character.
+    vec2 pen;
+    // The offset of the character within the text, in bytes.
+    u32 byte_offset;
+} sui_label_char_origin;
+
 typedef struct sui_label_internal_data {
     vec2i size;
     vec4 colour;
@@ -11,8 +19,24 @@ typedef struct sui_label_internal_data {
 
     font_type type;
     struct font_data* data;
-    u64 vertex_buffer_offset;
-    u64 index_buffer_offset;
+    // The texture the label is drawn from. Bitmap font pages are packed into the shared UI atlas,
+    // so labels draw together with other controls. Other fonts draw from their own atlas.
+    texture_map* atlas;
+    // Indicates the font's page was packed into the UI atlas, at atlas_region.
+    b8 atlas_packed;
+    sui_atlas_region atlas_region;
+    // Quads for up to max_text_length characters, drawn through the UI pass' per-frame stream.
+    // max_text_length is a power of two, so text which keeps changing length rarely reallocates.
+    vertex_2d* vertices;
+    u32* indices;
+    // The origin of each laid out character, so that text changes only lay out again from the
+    // first character which differs. Array of max_text_length.
+    sui_label_char_origin* origins;
+    // The pen position after the last laid out character.
+    vec2 end_pen;
+    // The atlas generation of the font when the text was laid out. Glyphs move when the atlas
+    // grows, which invalidates all earlier layout.
+    u32 layout_atlas_generation;
     char* text;
     u32 max_text_length;
     u32 cached_ut8_length;
@@ -34,3 +58,14 @@ KAPI b8 sui_label_control_render(struct sui_control* self, struct frame_data* p_
 KAPI void sui_label_text_set(struct sui_control* self, const char* text);
 
 KAPI const char* sui_label_text_get(struct sui_control* self);
+
+/**
+ * @brief Obtains the horizontal pen position of the given label before the character at the
+ * given byte offset of its text, as already laid out. Offsets at or past the end of the text
+ * give the position after its last character.
+ *
+ * @param self A pointer to the label.
+ * @param byte_offset The offset of the character within the text of the label, in bytes.
+ * @return The horizontal pen position, relative to the start of the text.
+ */
+KAPI f32 sui_label_pen_x_get(struct sui_control* self, u32 byte_offset);
@@ -46,10 +46,13 @@ b8 sui_panel_control_load(struct sui_control* self) {
 
     sui_panel_internal_data* typed_data = self->internal_data;
 
-    // Generate UVs.
+    standard_ui_state* typed_state = systems_manager_get_state(128);  // HACK: need standard way to get extension types.
+
+    // Generate UVs, within the standard UI image's region of the atlas.
+    const sui_atlas_region* region = &typed_state->ui_atlas_region;
     f32 xmin, ymin, xmax, ymax;
-    generate_uvs_from_image_coords(512, 512, 44, 7, &xmin, &ymin);
-    generate_uvs_from_image_coords(512, 512, 73, 36, &xmax, &ymax);
+    generate_uvs_from_image_coords(region->page_size.x, region->page_size.y, region->offset.x + 44, region->offset.y + 7, &xmin, &ymin);
+    generate_uvs_from_image_coords(region->page_size.x, region->page_size.y, region->offset.x + 73, region->offset.y + 36, &xmax, &ymax);
 
     // Create a simple plane.
     geometry_config ui_config = {0};
@@ -57,10 +60,8 @@ b8 sui_panel_control_load(struct sui_control* self) {
     // Get UI geometry from config. NOTE: this uploads to GPU
     typed_data->g = geometry_system_acquire_from_config(ui_config, true);
 
-    standard_ui_state* typed_state = systems_manager_get_state(128);  // HACK: need standard way to get extension types.
-
     // Acquire instance resources for this control.
-    texture_map* maps[1] = {&typed_state->ui_atlas};
+    texture_map* maps[1] = {region->map};
     shader* s = shader_system_get("Shader.StandardUI");
     u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
     shader_instance_resource_config instance_resource_config = {0};
@@ -107,6 +108,8 @@ b8 sui_panel_control_render(struct sui_control* self, struct frame_data* p_frame
         renderable.render_data.index_count = typed_data->g->index_count;
         renderable.render_data.index_element_size = typed_data->g->index_element_size;
         renderable.render_data.index_buffer_offset = typed_data->g->index_buffer_offset;
+        renderable.vertices = typed_data->g->vertices;
+        renderable.indices = typed_data->g->indices;
         renderable.render_data.model = transform_world_get(&self->xform);
         renderable.render_data.diffuse_colour = typed_data->colour;
 
@@ -143,6 +146,7 @@ b8 sui_panel_control_resize(struct sui_control* self, vec2 new_size) {
     vertices[2].position.y = new_size.y;
     vertices[3].position.x = new_size.x;
     renderer_geometry_vertex_update(typed_data->g, 0, typed_data->g->vertex_count, vertices);
+    sui_control_dirty_set(self);
 
     return true;
 }
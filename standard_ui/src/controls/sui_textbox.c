@@ -23,22 +23,10 @@
 
 static b8 sui_textbox_on_key(u16 code, void* sender, void* listener_inst, event_context context);
 
-static f32 sui_textbox_calculate_cursor_offset(u32 string_pos, const char* full_string, font_data* font) {
-    if (string_pos == 0) {
-        return 0;
-    }
-
-    char* mid_target = string_duplicate(full_string);
-    u32 original_length = string_length(mid_target);
-    string_mid(mid_target, full_string, 0, string_pos);
-
-    vec2 size = font_system_measure_string(font, mid_target);
-
-    // Make sure to cleanup the string.
-    kfree(mid_target, sizeof(char) * original_length + 1, MEMORY_TAG_STRING);
-
-    // Use the x-axis of the mesurement to place the cursor.
-    return size.x;
+// The offset of the given position in the text from its start. Comes from where the label laid out its
+// characters, so nothing is measured again.
+static f32 sui_textbox_calculate_cursor_offset(sui_textbox_internal_data* typed_data, u32 string_pos) {
+    return sui_label_pen_x_get(&typed_data->content_label, string_pos);
 }
 
 static void sui_textbox_update_highlight_box(sui_control* self) {
@@ -46,15 +34,15 @@ static void sui_textbox_update_highlight_box(sui_control* self) {
     sui_label_internal_data* label_data = typed_data->content_label.internal_data;
 
     if (typed_data->highlight_range.size == 0) {
-        typed_data->highlight_box.is_visible = false;
+        sui_control_visible_set(&typed_data->highlight_box, false);
         return;
     }
 
-    typed_data->highlight_box.is_visible = true;
+    sui_control_visible_set(&typed_data->highlight_box, true);
 
     // Offset from the start of the string.
-    f32 offset_start = sui_textbox_calculate_cursor_offset(typed_data->highlight_range.offset, label_data->text, label_data->data);
-    f32 offset_end = sui_textbox_calculate_cursor_offset(typed_data->highlight_range.offset + typed_data->highlight_range.size, label_data->text, label_data->data);
+    f32 offset_start = sui_textbox_calculate_cursor_offset(typed_data, typed_data->highlight_range.offset);
+    f32 offset_end = sui_textbox_calculate_cursor_offset(typed_data, typed_data->highlight_range.offset + typed_data->highlight_range.size);
     f32 width = offset_end - offset_start;
     /* f32 padding = typed_data->nslice.corner_size.x; */
 
@@ -62,14 +50,14 @@ static void sui_textbox_update_highlight_box(sui_control* self) {
     initial_pos.y = -label_data->data->line_height + 10.0f;
     transform_position_set(&typed_data->highlight_box.xform, (vec3){offset_start, initial_pos.y, initial_pos.z});
     transform_scale_set(&typed_data->highlight_box.xform, (vec3){width, 1.0f, 1.0f});
+    sui_control_dirty_set(&typed_data->highlight_box);
 }
 
 static void sui_textbox_update_cursor_position(sui_control* self) {
     sui_textbox_internal_data* typed_data = self->internal_data;
-    sui_label_internal_data* label_data = typed_data->content_label.internal_data;
 
     // Offset from the start of the string.
-    f32 offset = sui_textbox_calculate_cursor_offset(typed_data->cursor_position, label_data->text, label_data->data);
+    f32 offset = sui_textbox_calculate_cursor_offset(typed_data, typed_data->cursor_position);
     f32 padding = typed_data->nslice.corner_size.x;
 
     // The would-be cursor position, not yet taking padding into account.
@@ -103,6 +91,8 @@ static void sui_textbox_update_cursor_position(sui_control* self) {
 
     // Translate the cursor to it's new position.
     transform_position_set(&typed_data->cursor.xform, cursor_pos);
+    sui_control_dirty_set(&typed_data->content_label);
+    sui_control_dirty_set(&typed_data->cursor);
 }
 
 b8 sui_textbox_control_create(const char* name, font_type type, const char* font_name, u16 font_size, const char* text, struct sui_control* out_control) {
@@ -177,6 +167,7 @@ b8 sui_textbox_control_size_set(struct sui_control* self, i32 width, i32 height)
     self->bounds.width = width;
 
     update_nine_slice(&typed_data->nslice, 0);
+    sui_control_dirty_set(self);
 
     return true;
 }
@@ -198,10 +189,11 @@ b8 sui_textbox_control_load(struct sui_control* self) {
     standard_ui_state* typed_state = systems_manager_get_state(K_SYSTEM_TYPE_STANDARD_UI_EXT);
 
     // HACK: TODO: remove hardcoded stuff.
-    /* vec2i atlas_size = (vec2i){typed_state->ui_atlas.texture->width, typed_state->ui_atlas.texture->height}; */
-    vec2i atlas_size = (vec2i){512, 512};
-    vec2i atlas_min = (vec2i){180, 31};
-    vec2i atlas_max = (vec2i){193, 43};
+    // Pixel coordinates within the standard UI image, moved to where it is in the atlas.
+    const sui_atlas_region* region = &typed_state->ui_atlas_region;
+    vec2i atlas_size = region->page_size;
+    vec2i atlas_min = (vec2i){region->offset.x + 180, region->offset.y + 31};
+    vec2i atlas_max = (vec2i){region->offset.x + 193, region->offset.y + 43};
     vec2i corner_px_size = (vec2i){3, 3};
     vec2i corner_size = (vec2i){10, 10};
     if (!generate_nine_slice(self->name, typed_data->size, atlas_size, atlas_min, atlas_max, corner_px_size, corner_size, &typed_data->nslice)) {
@@ -239,7 +231,7 @@ b8 sui_textbox_control_load(struct sui_control* self) {
     transform_parent_set(&typed_data->clip_mask.clip_xform, &self->xform);
 
     // Acquire instance resources for this control.
-    texture_map* maps[1] = {&typed_state->ui_atlas};
+    texture_map* maps[1] = {region->map};
     shader* s = shader_system_get("Shader.StandardUI");
     u16 atlas_location = s->uniforms[s->instance_sampler_indices[0]].index;
     shader_instance_resource_config instance_resource_config = {0};
@@ -272,6 +264,8 @@ b8 sui_textbox_control_load(struct sui_control* self) {
         // TODO: Adjustable padding
         transform_position_set(&typed_data->content_label.xform, (vec3){typed_data->nslice.corner_size.x, label_data->data->line_height - 5.0f, 0.0f});  // padding/2 for y
         transform_parent_set(&typed_data->content_label.xform, &self->xform);
+        // Not a child, but the textbox's render output includes the label's, so changes to it must reach the textbox.
+        typed_data->content_label.parent = self;
         typed_data->content_label.is_active = true;
         if (!standard_ui_system_update_active(typed_state, &typed_data->content_label)) {
             KERROR("Unable to update active state for textbox system text.");
@@ -320,8 +314,9 @@ b8 sui_textbox_control_load(struct sui_control* self) {
         // Set an initial position.
         transform_position_set(&typed_data->highlight_box.xform, (vec3){typed_data->nslice.corner_size.x, label_data->data->line_height - 4.0f, 0.0f});
         transform_parent_set(&typed_data->highlight_box.xform, &typed_data->content_label.xform);
+        typed_data->highlight_box.parent = &typed_data->content_label;
         typed_data->highlight_box.is_active = true;
-        typed_data->highlight_box.is_visible = false;
+        sui_control_visible_set(&typed_data->highlight_box, false);
         if (!standard_ui_system_update_active(typed_state, &typed_data->highlight_box)) {
             KERROR("Unable to update active state for textbox highlight box.");
         }
@@ -369,6 +364,8 @@ b8 sui_textbox_control_render(struct sui_control* self, struct frame_data* p_fra
         renderable.render_data.index_count = typed_data->nslice.g->index_count;
         renderable.render_data.index_element_size = typed_data->nslice.g->index_element_size;
         renderable.render_data.index_buffer_offset = typed_data->nslice.g->index_buffer_offset;
+        renderable.vertices = typed_data->nslice.g->vertices;
+        renderable.indices = typed_data->nslice.g->indices;
         renderable.render_data.model = transform_world_get(&self->xform);
         renderable.render_data.diffuse_colour = typed_data->colour;
 
@@ -392,7 +389,7 @@ b8 sui_textbox_control_render(struct sui_control* self, struct frame_data* p_fra
         // Attach clipping mask to text, which would be the last element added.
         u32 renderable_count = darray_length(render_data->renderables);
         typed_data->clip_mask.render_data.model = transform_world_get(&typed_data->clip_mask.clip_xform);
-        render_data->renderables[renderable_count - 1].clip_mask_render_data = &typed_data->clip_mask.render_data;
+        render_data->renderables[renderable_count - 1].clip_mask = &typed_data->clip_mask;
     }
 
     // Only perform highlight_box logic if it is visible.
@@ -408,7 +405,7 @@ b8 sui_textbox_control_render(struct sui_control* self, struct frame_data* p_fra
         // Attach clipping mask to text, which would be the last element added.
         u32 renderable_count = darray_length(render_data->renderables);
         typed_data->clip_mask.render_data.model = transform_world_get(&typed_data->clip_mask.clip_xform);
-        render_data->renderables[renderable_count - 1].clip_mask_render_data = &typed_data->clip_mask.render_data;
+        render_data->renderables[renderable_count - 1].clip_mask = &typed_data->clip_mask;
     }
 
     return true;
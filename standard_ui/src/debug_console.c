@@ -5,6 +5,7 @@
 #include <core/event.h>
 #include <core/input.h>
 #include <core/kmemory.h>
+#include <core/kmutex.h>
 #include <core/kstring.h>
 #include <core/systems_manager.h>
 #include <math/transform.h>
@@ -17,6 +18,10 @@
 
 static void debug_console_entry_box_on_key(sui_control* self, sui_keyboard_event evt);
 
+KINLINE b8 is_line_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
 b8 debug_console_consumer_write(void* inst, log_level level, const char* message) {
     debug_console_state* state = (debug_console_state*)inst;
     if (state) {
@@ -24,32 +29,32 @@ b8 debug_console_consumer_write(void* inst, log_level level, const char* message
         if (!state->loaded) {
             return true;
         }
-        // For high-priority error/fatal messages, don't bother with splitting,
-        // just output them because something truly terrible could prevent this
-        // split from happening.
-        if (level <= LOG_LEVEL_ERROR) {
-            // NOTE: Trim the string to get rid of the newline appended at the console level.
-            darray_push(state->lines, string_trim(string_duplicate(message)));
-            state->dirty = true;
-            return true;
-        }
-        // Create a new copy of the string, and try splitting it
-        // by newlines to make each one count as a new line.
-        // NOTE: The lack of cleanup on the strings is intentional
-        // here because the strings need to live on so that they can
-        // be accessed by this debug console. Ordinarily a cleanup
-        // via string_cleanup_split_array would be warranted.
-        char** split_message = darray_create(char*);
-        u32 count = string_split(message, '\n', &split_message, true, false);
-        // Push each to the array as a new line.
-        for (u32 i = 0; i < count; ++i) {
-            darray_push(state->lines, split_message[i]);
+        // Each line of the message is trimmed and copied into the next slot of the ring, without
+        // allocating, so even error/fatal messages can be split safely. Empty lines are skipped.
+        kmutex_lock(&state->lines_mutex);
+        const char* start = message;
+        while (*start) {
+            const char* end = start;
+            while (*end && *end != '\n') {
+                end++;
+            }
+            const char* next = *end ? end + 1 : end;
+            while (start < end && is_line_space(*start)) {
+                start++;
+            }
+            while (end > start && is_line_space(end[-1])) {
+                end--;
+            }
+            if (end > start) {
+                u64 length = KMIN((u64)(end - start), DEBUG_CONSOLE_MAX_LINE_LENGTH - 1);
+                char* line = state->lines + (state->line_total % DEBUG_CONSOLE_MAX_LINES) * DEBUG_CONSOLE_MAX_LINE_LENGTH;
+                kcopy_memory(line, start, length);
+                line[length] = 0;
+                state->line_total++;
+            }
+            start = next;
         }
-
-        // DO clean up the temporary array itself though (just
-        // not its content in this case).
-        darray_destroy(split_message);
-        state->dirty = true;
+        kmutex_unlock(&state->lines_mutex);
     }
     return true;
 }
@@ -68,7 +73,10 @@ void debug_console_create(debug_console_state* out_console_state) {
     if (out_console_state) {
         out_console_state->line_display_count = 10;
         out_console_state->line_offset = 0;
-        out_console_state->lines = darray_create(char*);
+        out_console_state->lines = kallocate(DEBUG_CONSOLE_MAX_LINES * DEBUG_CONSOLE_MAX_LINE_LENGTH, MEMORY_TAG_STRING);
+        out_console_state->line_total = 0;
+        out_console_state->text_buffer = kallocate(out_console_state->line_display_count * DEBUG_CONSOLE_MAX_LINE_LENGTH, MEMORY_TAG_STRING);
+        kmutex_create(&out_console_state->lines_mutex);
         out_console_state->visible = false;
         out_console_state->history = darray_create(command_history_entry);
         out_console_state->history_offset = -1;
@@ -88,6 +96,26 @@ void debug_console_create(debug_console_state* out_console_state) {
     }
 }
 
+void debug_console_destroy(debug_console_state* state) {
+    if (state) {
+        console_consumer_update(state->console_consumer_id, 0, 0);
+        event_unregister(EVENT_CODE_RESIZED, state, debug_console_on_resize);
+
+        kfree(state->lines, DEBUG_CONSOLE_MAX_LINES * DEBUG_CONSOLE_MAX_LINE_LENGTH, MEMORY_TAG_STRING);
+        state->lines = 0;
+        kfree(state->text_buffer, state->line_display_count * DEBUG_CONSOLE_MAX_LINE_LENGTH, MEMORY_TAG_STRING);
+        state->text_buffer = 0;
+        kmutex_destroy(&state->lines_mutex);
+
+        u32 history_count = darray_length(state->history);
+        for (u32 i = 0; i < history_count; ++i) {
+            string_free((char*)state->history[i].command);
+        }
+        darray_destroy(state->history);
+        state->history = 0;
+    }
+}
+
 b8 debug_console_load(debug_console_state* state) {
     if (!state) {
         KFATAL("debug_console_load() called before console was initialized!");
@@ -112,7 +140,7 @@ b8 debug_console_load(debug_console_state* state) {
                     KERROR("Failed to parent background panel.");
                 } else {
                     state->bg_panel.is_active = true;
-                    state->bg_panel.is_visible = false;
+                    sui_control_visible_set(&state->bg_panel, false);
                     if (!standard_ui_system_update_active(sui_state, &state->bg_panel)) {
                         KERROR("Unable to update active state.");
                     }
@@ -188,40 +216,55 @@ void debug_console_unload(debug_console_state* state) {
     }
 }
 
+// The number of lines currently held. Must be called with the lines mutex held.
+static u32 line_count_get(const debug_console_state* state) {
+    return (u32)KMIN(state->line_total, DEBUG_CONSOLE_MAX_LINES);
+}
+
 void debug_console_update(debug_console_state* state) {
-    if (state && state->loaded && state->dirty) {
-        u32 line_count = darray_length(state->lines);
-        u32 max_lines = KMIN(state->line_display_count, KMAX(line_count, state->line_display_count));
-
-        // Calculate the min line first, taking into account the line offset as well.
-        u32 min_line = KMAX(line_count - max_lines - state->line_offset, 0);
-        u32 max_line = min_line + max_lines - 1;
-
-        // Hopefully big enough to handle most things.
-        char buffer[16384];
-        kzero_memory(buffer, sizeof(char) * 16384);
-        u32 buffer_pos = 0;
-        for (u32 i = min_line; i <= max_line; ++i) {
-            // TODO: insert colour codes for the message type.
-
-            const char* line = state->lines[i];
-            u32 line_length = string_length(line);
-            for (u32 c = 0; c < line_length; c++, buffer_pos++) {
-                buffer[buffer_pos] = line[c];
-            }
-            // Append a newline
-            buffer[buffer_pos] = '\n';
-            buffer_pos++;
-        }
+    // While hidden, nothing needs to be rebuilt no matter how much is logged.
+    if (!state || !state->loaded || !state->visible) {
+        return;
+    }
 
-        // Make sure the string is null-terminated
-        buffer[buffer_pos] = '\0';
+    // Lines are pushed from the logger thread.
+    kmutex_lock(&state->lines_mutex);
+    u64 line_total = state->line_total;
+    u32 line_count = line_count_get(state);
 
-        // Once the string is built, set the text.
-        sui_label_text_set(&state->text_control, buffer);
+    // A view scrolled back stays on the same lines as new ones arrive, until they scroll out of the ring.
+    if (state->line_offset > 0 && line_total > state->updated_line_total) {
+        state->line_offset += (u32)KMIN(line_total - state->updated_line_total, DEBUG_CONSOLE_MAX_LINES);
+    }
+    state->updated_line_total = line_total;
+    u32 visible_count = KMIN(line_count, state->line_display_count);
+    state->line_offset = KMIN(state->line_offset, line_count - visible_count);
+
+    // Only the visible lines are turned into text, and only when they have changed.
+    u64 first_line = line_total - state->line_offset - visible_count;
+    if (!state->dirty && first_line == state->built_first_line && visible_count == state->built_line_count) {
+        kmutex_unlock(&state->lines_mutex);
+        return;
+    }
 
-        state->dirty = false;
+    u32 buffer_pos = 0;
+    for (u64 i = first_line; i < first_line + visible_count; ++i) {
+        // TODO: insert colour codes for the message type.
+        const char* line = state->lines + (i % DEBUG_CONSOLE_MAX_LINES) * DEBUG_CONSOLE_MAX_LINE_LENGTH;
+        u32 line_length = string_length(line);
+        kcopy_memory(state->text_buffer + buffer_pos, line, line_length);
+        buffer_pos += line_length;
+        // Newlines go between lines, where the terminator of the last line fits.
+        state->text_buffer[buffer_pos++] = '\n';
     }
+    state->text_buffer[buffer_pos ? buffer_pos - 1 : 0] = '\0';
+    state->built_first_line = first_line;
+    state->built_line_count = visible_count;
+    state->dirty = false;
+    kmutex_unlock(&state->lines_mutex);
+
+    // Once the string is built, set the text.
+    sui_label_text_set(&state->text_control, state->text_buffer);
 }
 
 static void debug_console_entry_box_on_key(sui_control* self, sui_keyboard_event evt) {
@@ -290,7 +333,9 @@ b8 debug_console_visible(debug_console_state* state) {
 void debug_console_visible_set(debug_console_state* state, b8 visible) {
     if (state) {
         state->visible = visible;
-        state->bg_panel.is_visible = visible;
+        // Lines may have arrived while hidden.
+        state->dirty = true;
+        sui_control_visible_set(&state->bg_panel, visible);
         void* sui_state = systems_manager_get_state(K_SYSTEM_TYPE_STANDARD_UI_EXT);
         standard_ui_system_focus_control(sui_state, visible ? &state->entry_textbox : 0);
         input_key_repeats_enable(visible);
@@ -300,14 +345,16 @@ void debug_console_visible_set(debug_console_state* state, b8 visible) {
 void debug_console_move_up(debug_console_state* state) {
     if (state) {
         state->dirty = true;
-        u32 line_count = darray_length(state->lines);
+        kmutex_lock(&state->lines_mutex);
+        u32 line_count = line_count_get(state);
         // Don't bother with trying an offset, just reset and boot out.
         if (line_count <= state->line_display_count) {
             state->line_offset = 0;
-            return;
+        } else {
+            state->line_offset++;
+            state->line_offset = KMIN(state->line_offset, line_count - state->line_display_count);
         }
-        state->line_offset++;
-        state->line_offset = KMIN(state->line_offset, line_count - state->line_display_count);
+        kmutex_unlock(&state->lines_mutex);
     }
 }
 
@@ -317,29 +364,22 @@ void debug_console_move_down(debug_console_state* state) {
             return;
         }
         state->dirty = true;
-        u32 line_count = darray_length(state->lines);
-        // Don't bother with trying an offset, just reset and boot out.
-        if (line_count <= state->line_display_count) {
-            state->line_offset = 0;
-            return;
-        }
-
         state->line_offset--;
-        state->line_offset = KMAX(state->line_offset, 0);
     }
 }
 
 void debug_console_move_to_top(debug_console_state* state) {
     if (state) {
         state->dirty = true;
-        u32 line_count = darray_length(state->lines);
+        kmutex_lock(&state->lines_mutex);
+        u32 line_count = line_count_get(state);
         // Don't bother with trying an offset, just reset and boot out.
         if (line_count <= state->line_display_count) {
             state->line_offset = 0;
-            return;
+        } else {
+            state->line_offset = line_count - state->line_display_count;
         }
-
-        state->line_offset = line_count - state->line_display_count;
+        kmutex_unlock(&state->lines_mutex);
     }
 }
 
@@ -3,6 +3,13 @@
 #include "defines.h"
 #include "standard_ui_system.h"
 
+#include <core/kmutex.h>
+
+/** @brief The number of lines kept for scrollback. Once reached, the oldest lines are overwritten. */
+#define DEBUG_CONSOLE_MAX_LINES 1024
+/** @brief The space kept for each line, including the terminator. Longer lines are truncated. */
+#define DEBUG_CONSOLE_MAX_LINE_LENGTH 256
+
 typedef struct command_history_entry {
     const char* command;
 } command_history_entry;
@@ -15,8 +22,18 @@ typedef struct debug_console_state {
     u32 line_display_count;
     // Number of lines offset from bottom of list.
     u32 line_offset;
-    // darray
-    char** lines;
+    // Ring buffer of DEBUG_CONSOLE_MAX_LINES lines, each DEBUG_CONSOLE_MAX_LINE_LENGTH characters.
+    char* lines;
+    // The number of lines ever written. The newest is at (line_total - 1) % DEBUG_CONSOLE_MAX_LINES.
+    u64 line_total;
+    // Guards lines, which are pushed to from the logger thread.
+    kmutex lines_mutex;
+    // The text of the visible lines, as given to the text control.
+    char* text_buffer;
+    // The line total at the last update, and the first line and number of lines the text was built from.
+    u64 updated_line_total;
+    u64 built_first_line;
+    u32 built_line_count;
     // darray
     command_history_entry* history;
     i32 history_offset;
@@ -31,9 +48,14 @@ typedef struct debug_console_state {
 } debug_console_state;
 
 KAPI void debug_console_create(debug_console_state* out_console_state);
+KAPI void debug_console_destroy(debug_console_state* state);
 
 KAPI b8 debug_console_load(debug_console_state* state);
 KAPI void debug_console_unload(debug_console_state* state);
+/**
+ * @brief Rebuilds the displayed text if the visible lines have changed. Called once per frame,
+ * so that however many lines arrive in a frame, the text is rebuilt at most once.
+ */
 KAPI void debug_console_update(debug_console_state* state);
 
 KAPI void debug_console_on_lib_load(debug_console_state* state, b8 update_consumer);
@@ -3,6 +3,7 @@
 #include "containers/darray.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
+#include "math/kmath.h"
 #include "math/transform.h"
 #include "renderer/renderer_frontend.h"
 #include "renderer/renderer_types.h"
@@ -11,27 +12,85 @@
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 
-typedef struct ui_shader_locations {
-    u16 projection;
-    u16 view;
-    u16 model;
-    u16 diffuse_map;
-    u16 properties;
-} ui_shader_locations;
+// The maximum number of vertices and indices which can be drawn by the UI per frame.
+#define UI_PASS_MAX_VERTICES 65536
+#define UI_PASS_MAX_INDICES (UI_PASS_MAX_VERTICES * 3 / 2)
 
 typedef struct sui_shader_locations {
     u16 projection;
     u16 view;
-    u16 model;
-    u16 properties;
     u16 diffuse_map;
+    u16 distance_field;
 } sui_shader_locations;
 
+// A vertex of the UI stream, already in screen space.
+typedef struct ui_pass_vertex {
+    vec2 position;
+    vec2 texcoord;
+    vec4 colour;
+} ui_pass_vertex;
+
+// A run of consecutive renderables sharing an atlas and clip mask, drawn with a single call.
+typedef struct ui_pass_batch {
+    // The shader instance bound for the batch, taken from its first renderable. These point
+    // into the control which owns the renderable, so they outlive the frame's render data.
+    u32* instance_id;
+    u64* frame_number;
+    u8* draw_index;
+    texture_map* atlas;
+    sui_clip_mask* clip_mask;
+    // Non-zero if the atlas holds a signed distance field. A u32 as it is passed to the shader.
+    u32 distance_field;
+    // The range of the clip mask's indices within the stream, if there is one.
+    u32 clip_index_start;
+    u32 clip_index_count;
+    // The range of the batch's indices within the stream.
+    u32 index_start;
+    u32 index_count;
+} ui_pass_batch;
+
 typedef struct ui_pass_internal_data {
     shader* sui_shader;  // standard ui // TODO: different render pass?
     sui_shader_locations sui_locations;
+    // Indicates the shader's only local is the distance field flag, so it can be pushed as is.
+    b8 local_block_valid;
+
+    // The per-frame vertex and index streams. Each holds one region per render target, so a
+    // frame still in flight is never overwritten.
+    renderbuffer vertex_buffer;
+    renderbuffer index_buffer;
+    u8 region_count;
+
+    // The stream and batches as last built. These are only built again when the UI render data
+    // generation changes, which it does not while the UI is unchanged.
+    ui_pass_vertex* vertices;
+    u32* indices;
+    u32 vertex_count;
+    u32 index_count;
+    // darray
+    ui_pass_batch* batches;
+    u64 built_generation;
+    // The generation last uploaded to each region. Array of region_count.
+    u64* uploaded_generations;
 } ui_pass_internal_data;
 
+// Appends the given vertices, transformed into screen space, and indices to the stream.
+static void ui_pass_stream_append(ui_pass_vertex* vertices, u32* vertex_count, u32* indices, u32* index_count, const vertex_2d* source_vertices, u32 source_vertex_count, const u32* source_indices, u32 source_index_count, mat4 model, vec4 colour) {
+    u32 base = *vertex_count;
+    for (u32 i = 0; i < source_vertex_count; ++i) {
+        vec3 p = vec3_transform((vec3){source_vertices[i].position.x, source_vertices[i].position.y, 0.0f}, 1.0f, model);
+        ui_pass_vertex* v = &vertices[base + i];
+        v->position = (vec2){p.x, p.y};
+        v->texcoord = source_vertices[i].texcoord;
+        v->colour = colour;
+    }
+    for (u32 i = 0; i < source_index_count; ++i) {
+        indices[*index_count + i] = base + source_indices[i];
+    }
+    *vertex_count += source_vertex_count;
+    *index_count += source_index_count;
+}
+
 b8 ui_pass_create(struct rendergraph_pass* self, void* config) {
     if (!self) {
         return false;
@@ -51,7 +110,7 @@ b8 ui_pass_initialize(struct rendergraph_pass* self) {
     ui_pass_internal_data* internal_data = self->internal_data;
 
     // Renderpass config
-    renderpass_config ui_pass_config;
+    renderpass_config ui_pass_config = {0};
     ui_pass_config.name = "Renderpass.UI";
     ui_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.2f, 1.0f};
     ui_pass_config.clear_flags = RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG | RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG;
@@ -101,9 +160,36 @@ b8 ui_pass_initialize(struct rendergraph_pass* self) {
     internal_data->sui_shader = shader_system_get(sui_shader_name);
     internal_data->sui_locations.projection = shader_system_uniform_location(internal_data->sui_shader, "projection");
     internal_data->sui_locations.view = shader_system_uniform_location(internal_data->sui_shader, "view");
-    internal_data->sui_locations.properties = shader_system_uniform_location(internal_data->sui_shader, "properties");
-    internal_data->sui_locations.model = shader_system_uniform_location(internal_data->sui_shader, "model");
     internal_data->sui_locations.diffuse_map = shader_system_uniform_location(internal_data->sui_shader, "diffuse_texture");
+    internal_data->sui_locations.distance_field = shader_system_uniform_location(internal_data->sui_shader, "distance_field");
+    const shader_local_block_member local_members[] = {{"distance_field", 0, sizeof(u32)}};
+    internal_data->local_block_valid = shader_system_local_block_verify(internal_data->sui_shader, 1, local_members, sizeof(u32));
+
+    // Per-frame vertex and index streams.
+    internal_data->region_count = renderer_window_attachment_count_get();
+    u64 vertex_buffer_size = sizeof(ui_pass_vertex) * UI_PASS_MAX_VERTICES * internal_data->region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_vertexbuffer_ui", RENDERBUFFER_TYPE_VERTEX, vertex_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->vertex_buffer)) {
+        KERROR("Failed to create UI pass vertex buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->vertex_buffer, 0);
+
+    u64 index_buffer_size = sizeof(u32) * UI_PASS_MAX_INDICES * internal_data->region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_indexbuffer_ui", RENDERBUFFER_TYPE_INDEX, index_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->index_buffer)) {
+        KERROR("Failed to create UI pass index buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->index_buffer, 0);
+
+    // The stream as built on the CPU. Nothing has been built or uploaded yet.
+    internal_data->vertices = kallocate(sizeof(ui_pass_vertex) * UI_PASS_MAX_VERTICES, MEMORY_TAG_ARRAY);
+    internal_data->indices = kallocate(sizeof(u32) * UI_PASS_MAX_INDICES, MEMORY_TAG_ARRAY);
+    internal_data->batches = darray_create(ui_pass_batch);
+    internal_data->built_generation = INVALID_ID_U64;
+    internal_data->uploaded_generations = kallocate(sizeof(u64) * internal_data->region_count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < internal_data->region_count; ++i) {
+        internal_data->uploaded_generations[i] = INVALID_ID_U64;
+    }
 
     return true;
 }
@@ -141,74 +227,151 @@ b8 ui_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_dat
     // Sync the frame number.
     internal_data->sui_shader->render_frame_number = p_frame_data->renderer_frame_number;
 
-    u32 renderable_count = darray_length(ext_data->sui_render_data.renderables);
-    for (u32 i = 0; i < renderable_count; ++i) {
-        standard_ui_renderable* renderable = &ext_data->sui_render_data.renderables[i];
-
-        // Render clipping mask geometry if it exists.
-        if (renderable->clip_mask_render_data) {
-            // Enable writing, disable test.
-            renderer_set_stencil_test_enabled(true);
-            renderer_set_depth_test_enabled(false);
-            renderer_set_stencil_reference((u32)renderable->clip_mask_render_data->unique_id);
-            renderer_set_stencil_write_mask(0xFF);
-            renderer_set_stencil_op(
-                RENDERER_STENCIL_OP_REPLACE,
-                RENDERER_STENCIL_OP_REPLACE,
-                RENDERER_STENCIL_OP_REPLACE,
-                RENDERER_COMPARE_OP_ALWAYS);
-
-            shader_system_bind_local();
-            shader_system_uniform_set_by_location(internal_data->sui_locations.model, &renderable->clip_mask_render_data->model);
-            shader_system_apply_local(p_frame_data);
-            // Draw the clip mask geometry.
-            renderer_geometry_draw(renderable->clip_mask_render_data);
-
-            // Disable writing, enable test.
-            renderer_set_stencil_write_mask(0x00);
-            renderer_set_stencil_test_enabled(true);
-            renderer_set_stencil_compare_mask(0xFF);
-            renderer_set_stencil_op(
-                RENDERER_STENCIL_OP_KEEP,
-                RENDERER_STENCIL_OP_REPLACE,
-                RENDERER_STENCIL_OP_KEEP,
-                RENDERER_COMPARE_OP_EQUAL);
-        } else {
-            renderer_set_stencil_write_mask(0x00);
-            renderer_set_stencil_test_enabled(false);
+    // Transform every renderable (and clip mask) into a single screen space stream, splitting it
+    // into batches wherever the atlas or clip mask changes. Draw order is kept as-is. This is
+    // skipped entirely if nothing in the UI has been rendered again since the last build.
+    if (ext_data->sui_render_data.generation != internal_data->built_generation) {
+        internal_data->built_generation = ext_data->sui_render_data.generation;
+        internal_data->vertex_count = 0;
+        internal_data->index_count = 0;
+        darray_clear(internal_data->batches);
+
+        ui_pass_vertex* vertices = internal_data->vertices;
+        u32* indices = internal_data->indices;
+        u32 renderable_count = darray_length(ext_data->sui_render_data.renderables);
+        for (u32 i = 0; i < renderable_count; ++i) {
+            standard_ui_renderable* renderable = &ext_data->sui_render_data.renderables[i];
+            if (!renderable->vertices || !renderable->indices) {
+                continue;
+            }
+
+            // Anything past the capacity of the stream is dropped.
+            u32 needed_vertex_count = renderable->render_data.vertex_count;
+            u32 needed_index_count = renderable->render_data.index_count;
+            if (renderable->clip_mask) {
+                needed_vertex_count += renderable->clip_mask->clip_geometry->vertex_count;
+                needed_index_count += renderable->clip_mask->clip_geometry->index_count;
+            }
+            if (internal_data->vertex_count + needed_vertex_count > UI_PASS_MAX_VERTICES || internal_data->index_count + needed_index_count > UI_PASS_MAX_INDICES) {
+                KWARN("UI pass stream is full (%u vertices, %u indices). Remaining UI will not be drawn.", UI_PASS_MAX_VERTICES, UI_PASS_MAX_INDICES);
+                break;
+            }
+
+            texture_map* atlas = renderable->atlas_override ? renderable->atlas_override : ext_data->sui_render_data.ui_atlas;
+            u32 batch_count = darray_length(internal_data->batches);
+            ui_pass_batch* batch = batch_count ? &internal_data->batches[batch_count - 1] : 0;
+            if (!batch || batch->atlas != atlas || batch->clip_mask != renderable->clip_mask || batch->distance_field != (u32)renderable->is_distance_field) {
+                ui_pass_batch new_batch = {0};
+                new_batch.instance_id = renderable->instance_id;
+                new_batch.frame_number = renderable->frame_number;
+                new_batch.draw_index = renderable->draw_index;
+                new_batch.atlas = atlas;
+                new_batch.clip_mask = renderable->clip_mask;
+                new_batch.distance_field = renderable->is_distance_field;
+                if (new_batch.clip_mask) {
+                    // The clip mask gets drawn into the stencil buffer ahead of the batch.
+                    sui_clip_mask* mask = new_batch.clip_mask;
+                    new_batch.clip_index_start = internal_data->index_count;
+                    ui_pass_stream_append(vertices, &internal_data->vertex_count, indices, &internal_data->index_count, mask->clip_geometry->vertices, mask->clip_geometry->vertex_count, mask->clip_geometry->indices, mask->clip_geometry->index_count, mask->render_data.model, mask->render_data.diffuse_colour);
+                    new_batch.clip_index_count = internal_data->index_count - new_batch.clip_index_start;
+                }
+                new_batch.index_start = internal_data->index_count;
+                darray_push(internal_data->batches, new_batch);
+                batch = &internal_data->batches[batch_count];
+            }
+
+            ui_pass_stream_append(vertices, &internal_data->vertex_count, indices, &internal_data->index_count, renderable->vertices, renderable->render_data.vertex_count, renderable->indices, renderable->render_data.index_count, renderable->render_data.model, renderable->render_data.diffuse_colour);
+            batch->index_count = internal_data->index_count - batch->index_start;
         }
+    }
 
-        // Apply instance
-        b8 needs_update = *renderable->frame_number != p_frame_data->renderer_frame_number || *renderable->draw_index != p_frame_data->draw_index;
-        shader_system_bind_instance(*renderable->instance_id);
-        // NOTE: Expand this to a structure if more data is needed.
-        shader_system_uniform_set_by_location(internal_data->sui_locations.properties, &renderable->render_data.diffuse_colour);
-        texture_map* atlas = renderable->atlas_override ? renderable->atlas_override : ext_data->sui_render_data.ui_atlas;
-        shader_system_uniform_set_by_location(internal_data->sui_locations.diffuse_map, atlas);
-        shader_system_apply_instance(needs_update, p_frame_data);
-
-        // Apply local
-        shader_system_bind_local();
-        shader_system_uniform_set_by_location(internal_data->sui_locations.model, &renderable->render_data.model);
-        shader_system_apply_local(p_frame_data);
-
-        // Draw
-        renderer_geometry_draw(&renderable->render_data);
-
-        // Turn off stencil tests if they were on.
-        if (renderable->clip_mask_render_data) {
-            // Turn off stencil testing.
-            renderer_set_stencil_test_enabled(false);
-            renderer_set_stencil_op(
-                RENDERER_STENCIL_OP_KEEP,
-                RENDERER_STENCIL_OP_KEEP,
-                RENDERER_STENCIL_OP_KEEP,
-                RENDERER_COMPARE_OP_ALWAYS);
+    u32 batch_count = darray_length(internal_data->batches);
+    if (batch_count > 0) {
+        u32 region = p_frame_data->render_target_index % internal_data->region_count;
+        u64 vertex_region_offset = sizeof(ui_pass_vertex) * UI_PASS_MAX_VERTICES * region;
+        u64 index_region_offset = sizeof(u32) * UI_PASS_MAX_INDICES * region;
+        // Each region only needs uploading again if the stream has been built since it last was.
+        if (internal_data->uploaded_generations[region] != internal_data->built_generation) {
+            if (!renderer_renderbuffer_load_range(&internal_data->vertex_buffer, vertex_region_offset, sizeof(ui_pass_vertex) * internal_data->vertex_count, internal_data->vertices)) {
+                KERROR("Failed to upload UI pass vertex data. Render frame failed.");
+                return false;
+            }
+            if (!renderer_renderbuffer_load_range(&internal_data->index_buffer, index_region_offset, sizeof(u32) * internal_data->index_count, internal_data->indices)) {
+                KERROR("Failed to upload UI pass index data. Render frame failed.");
+                return false;
+            }
+            internal_data->uploaded_generations[region] = internal_data->built_generation;
         }
 
-        // Sync the frame number.
-        *renderable->frame_number = p_frame_data->renderer_frame_number;
-        *renderable->draw_index = p_frame_data->draw_index;
+        // Indices are relative to the start of this frame's region, so the vertices are only bound once.
+        renderer_renderbuffer_draw(&internal_data->vertex_buffer, vertex_region_offset, 0, true);
+
+        for (u32 b = 0; b < batch_count; ++b) {
+            ui_pass_batch* batch = &internal_data->batches[b];
+
+            // Apply instance. Every renderable in the batch shares the atlas, so that of the first is used.
+            b8 needs_update = *batch->frame_number != p_frame_data->renderer_frame_number || *batch->draw_index != p_frame_data->draw_index;
+            shader_system_bind_instance(*batch->instance_id);
+            shader_system_uniform_set_by_location(internal_data->sui_locations.diffuse_map, batch->atlas);
+            shader_system_apply_instance(needs_update, p_frame_data);
+
+            // Apply the locals
+            if (internal_data->local_block_valid) {
+                shader_system_local_block_push(&batch->distance_field, sizeof(u32));
+            } else {
+                shader_system_bind_local();
+                shader_system_uniform_set_by_location(internal_data->sui_locations.distance_field, &batch->distance_field);
+                shader_system_apply_local(p_frame_data);
+            }
+
+            // Render clipping mask geometry if it exists.
+            if (batch->clip_mask) {
+                // Enable writing, disable test.
+                renderer_set_stencil_test_enabled(true);
+                renderer_set_depth_test_enabled(false);
+                renderer_set_stencil_reference((u32)batch->clip_mask->render_data.unique_id);
+                renderer_set_stencil_write_mask(0xFF);
+                renderer_set_stencil_op(
+                    RENDERER_STENCIL_OP_REPLACE,
+                    RENDERER_STENCIL_OP_REPLACE,
+                    RENDERER_STENCIL_OP_REPLACE,
+                    RENDERER_COMPARE_OP_ALWAYS);
+
+                // Draw the clip mask geometry. It is transparent, so the batch's atlas does no harm.
+                renderer_renderbuffer_draw(&internal_data->index_buffer, index_region_offset + sizeof(u32) * batch->clip_index_start, batch->clip_index_count, false);
+
+                // Disable writing, enable test.
+                renderer_set_stencil_write_mask(0x00);
+                renderer_set_stencil_test_enabled(true);
+                renderer_set_stencil_compare_mask(0xFF);
+                renderer_set_stencil_op(
+                    RENDERER_STENCIL_OP_KEEP,
+                    RENDERER_STENCIL_OP_REPLACE,
+                    RENDERER_STENCIL_OP_KEEP,
+                    RENDERER_COMPARE_OP_EQUAL);
+            } else {
+                renderer_set_stencil_write_mask(0x00);
+                renderer_set_stencil_test_enabled(false);
+            }
+
+            // Draw
+            renderer_renderbuffer_draw(&internal_data->index_buffer, index_region_offset + sizeof(u32) * batch->index_start, batch->index_count, false);
+
+            // Turn off stencil tests if they were on.
+            if (batch->clip_mask) {
+                // Turn off stencil testing.
+                renderer_set_stencil_test_enabled(false);
+                renderer_set_stencil_op(
+                    RENDERER_STENCIL_OP_KEEP,
+                    RENDERER_STENCIL_OP_KEEP,
+                    RENDERER_STENCIL_OP_KEEP,
+                    RENDERER_COMPARE_OP_ALWAYS);
+            }
+
+            // Sync the frame number.
+            *batch->frame_number = p_frame_data->renderer_frame_number;
+            *batch->draw_index = p_frame_data->draw_index;
+        }
     }
 
     if (!renderer_renderpass_end(&self->pass)) {
@@ -222,6 +385,16 @@ b8 ui_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_dat
 void ui_pass_destroy(struct rendergraph_pass* self) {
     if (self) {
         if (self->internal_data) {
+            ui_pass_internal_data* internal_data = self->internal_data;
+            renderer_renderbuffer_destroy(&internal_data->vertex_buffer);
+            renderer_renderbuffer_destroy(&internal_data->index_buffer);
+            if (internal_data->vertices) {
+                kfree(internal_data->vertices, sizeof(ui_pass_vertex) * UI_PASS_MAX_VERTICES, MEMORY_TAG_ARRAY);
+                kfree(internal_data->indices, sizeof(u32) * UI_PASS_MAX_INDICES, MEMORY_TAG_ARRAY);
+                kfree(internal_data->uploaded_generations, sizeof(u64) * internal_data->region_count, MEMORY_TAG_ARRAY);
+                darray_destroy(internal_data->batches);
+            }
+
             // Destroy the pass.
             renderer_renderpass_destroy(&self->pass);
             kfree(self->internal_data, sizeof(ui_pass_internal_data), MEMORY_TAG_RENDERER);
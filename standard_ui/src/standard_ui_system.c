@@ -22,6 +22,8 @@
 #include "renderer/renderer_types.h"
 #include "systems/font_system.h"
 
+static void sui_control_parents_dirty_set(sui_control* self);
+
 static b8 standard_ui_system_mouse_down(u16 code, void* sender, void* listener_inst, event_context context) {
     standard_ui_state* typed_state = (standard_ui_state*)listener_inst;
 
@@ -179,20 +181,35 @@ b8 standard_ui_system_initialize(u64* memory_requirement, void* state, void* con
 
     sui_base_control_create("__ROOT__", &typed_state->root);
 
-    texture* atlas = texture_system_acquire("StandardUIAtlas", true);
-    if (!atlas) {
-        KWARN("Unable to load atlas texture, using default.");
-        atlas = texture_system_get_default_texture();
+    if (!sui_atlas_create(&typed_state->atlas)) {
+        KERROR("Unable to create the UI atlas. StandardUI cannot be initialized.");
+        return false;
     }
 
-    // Setup the texture map.
-    texture_map* map = &typed_state->ui_atlas;
-    map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
-    map->filter_minify = map->filter_magnify = TEXTURE_FILTER_MODE_NEAREST;
-    map->texture = atlas;
-    if (!renderer_texture_map_resources_acquire(map)) {
-        KERROR("Unable to acquire texture map resources. StandardUI cannot be initialized.");
-        return false;
+    // The standard UI image goes into the shared atlas, along with any bitmap font pages.
+    if (!sui_atlas_image_acquire(&typed_state->atlas, "StandardUIAtlas", &typed_state->ui_atlas_region)) {
+        KWARN("Unable to pack the standard UI image into the UI atlas. It will be drawn on its own.");
+        texture* atlas = texture_system_acquire("StandardUIAtlas", true);
+        if (!atlas) {
+            KWARN("Unable to load atlas texture, using default.");
+            atlas = texture_system_get_default_texture();
+        }
+
+        // Setup the texture map.
+        texture_map* map = &typed_state->ui_atlas;
+        map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+        map->filter_minify = map->filter_magnify = TEXTURE_FILTER_MODE_NEAREST;
+        map->texture = atlas;
+        if (!renderer_texture_map_resources_acquire(map)) {
+            KERROR("Unable to acquire texture map resources. StandardUI cannot be initialized.");
+            return false;
+        }
+
+        // Control texture coordinates were made for the 512x512 image.
+        typed_state->ui_atlas_region.map = map;
+        typed_state->ui_atlas_region.offset = (vec2i){0, 0};
+        typed_state->ui_atlas_region.size = (vec2i){512, 512};
+        typed_state->ui_atlas_region.page_size = (vec2i){512, 512};
     }
 
     // Listen for input events.
@@ -234,9 +251,10 @@ void standard_ui_system_shutdown(void* state) {
         if (typed_state->ui_atlas.texture) {
             texture_system_release(typed_state->ui_atlas.texture->name);
             typed_state->ui_atlas.texture = 0;
+            renderer_texture_map_resources_release(&typed_state->ui_atlas);
         }
 
-        renderer_texture_map_resources_release(&typed_state->ui_atlas);
+        sui_atlas_destroy(&typed_state->atlas);
     }
 }
 
@@ -246,10 +264,13 @@ b8 standard_ui_system_update(void* state, struct frame_data* p_frame_data) {
     }
 
     standard_ui_state* typed_state = (standard_ui_state*)state;
+    // Controls update every frame, so must do so without allocating.
+    KMEMORY_NO_ALLOC_BEGIN("standard ui update");
     for (u32 i = 0; i < typed_state->active_control_count; ++i) {
         sui_control* c = typed_state->active_controls[i];
         c->update(c, p_frame_data);
     }
+    KMEMORY_NO_ALLOC_END();
 
     return true;
 }
@@ -261,32 +282,58 @@ b8 standard_ui_system_render(void* state, sui_control* root, struct frame_data*
 
     standard_ui_state* typed_state = (standard_ui_state*)state;
 
-    render_data->ui_atlas = &typed_state->ui_atlas;
+    render_data->ui_atlas = typed_state->ui_atlas_region.map;
 
     if (!root) {
         root = &typed_state->root;
     }
 
-    if (root->render) {
-        if (!root->render(root, p_frame_data, render_data)) {
-            KERROR("Root element failed to render. See logs for more details");
-            return false;
+    // Only controls which have changed are rendered again. Otherwise, the output of the
+    // last time is reused, which includes that of all children.
+    if (root->is_dirty || !root->cached_renderables) {
+        if (root->cached_renderables) {
+            darray_clear(root->cached_renderables);
+        } else {
+            root->cached_renderables = darray_create(standard_ui_renderable);
         }
-    }
-
-    if (root->children) {
-        u32 length = darray_length(root->children);
-        for (u32 i = 0; i < length; ++i) {
-            sui_control* c = root->children[i];
-            if (!c->is_visible) {
-                continue;
-            }
-            if (!standard_ui_system_render(state, c, p_frame_data, render_data)) {
-                KERROR("Child element failed to render. See logs for more details");
+        standard_ui_render_data subtree_data = {0};
+        subtree_data.ui_atlas = render_data->ui_atlas;
+        subtree_data.renderables = root->cached_renderables;
+
+        if (root->render) {
+            if (!root->render(root, p_frame_data, &subtree_data)) {
+                KERROR("Root element failed to render. See logs for more details");
+                root->cached_renderables = subtree_data.renderables;
                 return false;
             }
         }
+
+        if (root->children) {
+            u32 length = darray_length(root->children);
+            for (u32 i = 0; i < length; ++i) {
+                sui_control* c = root->children[i];
+                if (!c->is_visible) {
+                    continue;
+                }
+                if (!standard_ui_system_render(state, c, p_frame_data, &subtree_data)) {
+                    KERROR("Child element failed to render. See logs for more details");
+                    root->cached_renderables = subtree_data.renderables;
+                    return false;
+                }
+            }
+        }
+
+        // Pushing may have moved the array.
+        root->cached_renderables = subtree_data.renderables;
+        root->is_dirty = false;
+        typed_state->render_generation++;
+    }
+
+    u32 cached_count = darray_length(root->cached_renderables);
+    for (u32 i = 0; i < cached_count; ++i) {
+        darray_push(render_data->renderables, root->cached_renderables[i]);
     }
+    render_data->generation = typed_state->render_generation;
 
     return true;
 }
@@ -359,8 +406,11 @@ b8 standard_ui_system_control_add_child(void* state, sui_control* parent, sui_co
     }
 
     darray_push(parent->children, child);
+    child->parent = parent;
 
     transform_parent_set(&child->xform, &parent->xform);
+    // Also marks the new parent, which now holds the child's output.
+    sui_control_dirty_set(child);
 
     return true;
 }
@@ -381,7 +431,11 @@ b8 standard_ui_system_control_remove_child(void* state, sui_control* parent, sui
             sui_control* popped;
             darray_pop_at(parent->children, i, &popped);
 
+            // The parent no longer holds the child's output.
+            sui_control_parents_dirty_set(child);
+            child->parent = 0;
             transform_parent_set(&child->xform, 0);
+            sui_control_dirty_set(child);
             return true;
         }
     }
@@ -395,6 +449,15 @@ void standard_ui_system_focus_control(void* state, sui_control* control) {
     typed_state->focused_id = control ? control->id.uniqueid : INVALID_ID_U64;
 }
 
+b8 standard_ui_system_atlas_image_acquire(void* state, const char* image_name, sui_atlas_region* out_region) {
+    if (!state) {
+        return false;
+    }
+
+    standard_ui_state* typed_state = (standard_ui_state*)state;
+    return sui_atlas_image_acquire(&typed_state->atlas, image_name, out_region);
+}
+
 b8 sui_base_control_create(const char* name, struct sui_control* out_control) {
     if (!out_control) {
         return false;
@@ -402,6 +465,8 @@ b8 sui_base_control_create(const char* name, struct sui_control* out_control) {
 
     // Set all controls to visible by default.
     out_control->is_visible = true;
+    // Nothing has been rendered yet.
+    out_control->is_dirty = true;
 
     // Assign function pointers.
     out_control->destroy = sui_base_control_destroy;
@@ -427,6 +492,9 @@ void sui_base_control_destroy(struct sui_control* self) {
         if (self->name) {
             string_free(self->name);
         }
+        if (self->cached_renderables) {
+            darray_destroy(self->cached_renderables);
+        }
         kzero_memory(self, sizeof(sui_control));
     }
 }
@@ -459,8 +527,51 @@ b8 sui_base_control_render(struct sui_control* self, struct frame_data* p_frame_
     return true;
 }
 
+static void sui_control_parents_dirty_set(sui_control* self) {
+    // Any parent already dirty has dirty parents as well.
+    sui_control* parent = self->parent;
+    while (parent && !parent->is_dirty) {
+        parent->is_dirty = true;
+        parent = parent->parent;
+    }
+}
+
+static void sui_control_subtree_dirty_set(sui_control* self) {
+    self->is_dirty = true;
+    if (self->children) {
+        u32 length = darray_length(self->children);
+        for (u32 i = 0; i < length; ++i) {
+            sui_control_subtree_dirty_set(self->children[i]);
+        }
+    }
+}
+
+void sui_control_dirty_set(struct sui_control* self) {
+    if (!self) {
+        return;
+    }
+
+    // Children are rendered with world transforms that include this control's, so they
+    // need rendering again too.
+    sui_control_subtree_dirty_set(self);
+
+    // Parents hold this control's output.
+    sui_control_parents_dirty_set(self);
+}
+
+void sui_control_visible_set(struct sui_control* self, b8 visible) {
+    if (!self || self->is_visible == visible) {
+        return;
+    }
+
+    self->is_visible = visible;
+    // Only the parents change, since they include or leave out this control's output.
+    sui_control_parents_dirty_set(self);
+}
+
 void sui_control_position_set(struct sui_control* self, vec3 position) {
     transform_position_set(&self->xform, position);
+    sui_control_dirty_set(self);
 }
 
 vec3 sui_control_position_get(struct sui_control* self) {
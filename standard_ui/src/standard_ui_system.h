@@ -19,6 +19,7 @@
 #include "defines.h"
 #include "renderer/renderer_types.h"
 #include "resources/resource_types.h"
+#include "sui_atlas.h"
 
 // FIXME: Need to maintain a list of extension types somewhere and pull from there.
 #define K_SYSTEM_TYPE_STANDARD_UI_EXT 128
@@ -30,19 +31,35 @@ typedef struct standard_ui_system_config {
     u64 max_control_count;
 } standard_ui_system_config;
 
+typedef struct sui_clip_mask {
+    u32 reference_id;
+    transform clip_xform;
+    struct geometry* clip_geometry;
+    geometry_render_data render_data;
+} sui_clip_mask;
+
 typedef struct standard_ui_renderable {
     u32* instance_id;
     u64* frame_number;
     texture_map* atlas_override;
     u8* draw_index;
     geometry_render_data render_data;
-    geometry_render_data* clip_mask_render_data;
+    // The vertices and indices of render_data, kept on the CPU in local space. Renderables
+    // are transformed into a single screen space stream and batched from these each frame.
+    const vertex_2d* vertices;
+    const u32* indices;
+    sui_clip_mask* clip_mask;
+    // Indicates the atlas holds a signed distance field rather than coverage, as for SDF fonts.
+    b8 is_distance_field;
 } standard_ui_renderable;
 
 typedef struct standard_ui_render_data {
     texture_map* ui_atlas;
     // darray
     standard_ui_renderable* renderables;
+    // Changes whenever any control is rendered again. Renderables gathered with the same
+    // generation as before are identical, so anything built from them can be reused.
+    u64 generation;
 } standard_ui_render_data;
 
 typedef struct sui_mouse_event {
@@ -61,13 +78,6 @@ typedef struct sui_keyboard_event {
     sui_keyboard_event_type type;
 } sui_keyboard_event;
 
-typedef struct sui_clip_mask {
-    u32 reference_id;
-    transform clip_xform;
-    struct geometry* clip_geometry;
-    geometry_render_data render_data;
-} sui_clip_mask;
-
 typedef struct sui_control {
     identifier id;
     transform xform;
@@ -77,6 +87,8 @@ typedef struct sui_control {
     b8 is_visible;
     b8 is_hovered;
     b8 is_pressed;
+    // Indicates the control, or something beneath it, has changed since it was last rendered.
+    b8 is_dirty;
     rect_2d bounds;
 
     struct sui_control* parent;
@@ -89,6 +101,10 @@ typedef struct sui_control {
     void* user_data;
     u64 user_data_size;
 
+    // darray of what this control and its visible children produced when last rendered. Reused
+    // as-is until the control is marked dirty.
+    standard_ui_renderable* cached_renderables;
+
     void (*destroy)(struct sui_control* self);
     b8 (*load)(struct sui_control* self);
     void (*unload)(struct sui_control* self);
@@ -129,10 +145,17 @@ typedef struct standard_ui_state {
     u32 inactive_control_count;
     sui_control** inactive_controls;
     sui_control root;
+    // UI images and bitmap font pages are packed into this, so controls drawn from different ones still batch.
+    sui_atlas atlas;
+    // Where the standard UI image is. Within the shared atlas, unless it couldn't be packed.
+    sui_atlas_region ui_atlas_region;
+    // The standard UI image on its own. Only used if it couldn't be packed.
     texture_map ui_atlas;
 
     u64 focused_id;
 
+    // Incremented each time any control is rendered again.
+    u64 render_generation;
 } standard_ui_state;
 
 /**
@@ -168,6 +191,17 @@ KAPI b8 standard_ui_system_control_remove_child(void* state, sui_control* parent
 
 KAPI void standard_ui_system_focus_control(void* state, sui_control* control);
 
+/**
+ * @brief Obtains the region of the UI image with the given name within the shared UI atlas,
+ * packing it in the first time. Controls drawn from the same atlas page are drawn together.
+ *
+ * @param state A pointer to the standard UI system state.
+ * @param image_name The name of the image resource.
+ * @param out_region A pointer to hold the region of the image.
+ * @return True on success; false if the image couldn't be packed, in which case it should be drawn on its own.
+ */
+KAPI b8 standard_ui_system_atlas_image_acquire(void* state, const char* image_name, sui_atlas_region* out_region);
+
 // ---------------------------
 // Base control
 // ---------------------------
@@ -180,6 +214,23 @@ KAPI void sui_base_control_unload(struct sui_control* self);
 KAPI b8 sui_base_control_update(struct sui_control* self, struct frame_data* p_frame_data);
 KAPI b8 sui_base_control_render(struct sui_control* self, struct frame_data* p_frame_data, standard_ui_render_data* render_data);
 
+/**
+ * @brief Marks the given control as changed, so that it and everything beneath it are rendered
+ * again, along with its parents which hold its output. Controls should call this whenever
+ * anything which affects their render output changes.
+ *
+ * @param self A pointer to the control to be marked dirty.
+ */
+KAPI void sui_control_dirty_set(struct sui_control* self);
+
+/**
+ * @brief Sets the visibility of the given control.
+ *
+ * @param self A pointer to the control whose visibility will be set.
+ * @param visible Indicates if the control should be visible.
+ */
+KAPI void sui_control_visible_set(struct sui_control* self, b8 visible);
+
 /**
  * @brief Sets the position on the given control.
  *
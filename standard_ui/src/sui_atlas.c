@@ -0,0 +1,171 @@
+#include "sui_atlas.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <renderer/renderer_frontend.h>
+#include <systems/resource_system.h>
+#include <systems/texture_system.h>
+
+// Pixels left between images, so that samples never bleed into neighbours.
+#define SUI_ATLAS_PADDING 1
+
+static b8 sui_atlas_page_create(sui_atlas* atlas, sui_atlas_page* out_page) {
+    char name[TEXTURE_NAME_MAX_LENGTH];
+    string_format(name, "__sui_atlas_page_%u__", atlas->page_count);
+    out_page->texture = texture_system_acquire_writeable(name, SUI_ATLAS_PAGE_SIZE, SUI_ATLAS_PAGE_SIZE, 4, true);
+    if (!out_page->texture) {
+        KERROR("Failed to create UI atlas page texture.");
+        return false;
+    }
+
+    // Start out transparent.
+    u32 size = SUI_ATLAS_PAGE_SIZE * SUI_ATLAS_PAGE_SIZE * 4;
+    u8* pixels = kallocate(size, MEMORY_TAG_TEXTURE);
+    texture_system_write_data(out_page->texture, 0, size, pixels);
+    kfree(pixels, size, MEMORY_TAG_TEXTURE);
+
+    // Sampled the same way as the standard UI image always was.
+    texture_map* map = &out_page->map;
+    map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+    map->filter_minify = map->filter_magnify = TEXTURE_FILTER_MODE_NEAREST;
+    map->texture = out_page->texture;
+    if (!renderer_texture_map_resources_acquire(map)) {
+        KERROR("Unable to acquire texture map resources for UI atlas page.");
+        texture_system_release(out_page->texture->name);
+        out_page->texture = 0;
+        return false;
+    }
+
+    out_page->pen_x = 0;
+    out_page->pen_y = 0;
+    out_page->row_height = 0;
+    return true;
+}
+
+// Finds a place for an image of the given size in the page, if there is room left.
+static b8 sui_atlas_page_place(sui_atlas_page* page, u32 width, u32 height, u32* out_x, u32* out_y) {
+    if (page->pen_x + width > SUI_ATLAS_PAGE_SIZE) {
+        // Start a new row.
+        page->pen_x = 0;
+        page->pen_y += page->row_height;
+        page->row_height = 0;
+    }
+    if (page->pen_x + width > SUI_ATLAS_PAGE_SIZE || page->pen_y + height > SUI_ATLAS_PAGE_SIZE) {
+        return false;
+    }
+
+    *out_x = page->pen_x;
+    *out_y = page->pen_y;
+    page->pen_x += width + SUI_ATLAS_PADDING;
+    page->row_height = KMAX(page->row_height, height + SUI_ATLAS_PADDING);
+    return true;
+}
+
+b8 sui_atlas_create(sui_atlas* out_atlas) {
+    if (!out_atlas) {
+        return false;
+    }
+
+    kzero_memory(out_atlas, sizeof(sui_atlas));
+    out_atlas->images = darray_create(sui_atlas_image);
+    return true;
+}
+
+void sui_atlas_destroy(sui_atlas* atlas) {
+    if (!atlas) {
+        return;
+    }
+
+    for (u32 i = 0; i < atlas->page_count; ++i) {
+        sui_atlas_page* page = &atlas->pages[i];
+        renderer_texture_map_resources_release(&page->map);
+        if (page->texture) {
+            texture_system_release(page->texture->name);
+        }
+    }
+    if (atlas->images) {
+        darray_destroy(atlas->images);
+    }
+    kzero_memory(atlas, sizeof(sui_atlas));
+}
+
+b8 sui_atlas_image_add(sui_atlas* atlas, const char* name, u32 width, u32 height, const u8* pixels, sui_atlas_region* out_region) {
+    if (!atlas || !name || !pixels || !out_region || !width || !height) {
+        return false;
+    }
+    if (width > SUI_ATLAS_PAGE_SIZE || height > SUI_ATLAS_PAGE_SIZE) {
+        KWARN("UI image '%s' (%ux%u) is larger than a UI atlas page, so can't be packed.", name, width, height);
+        return false;
+    }
+
+    // Try the existing pages first, then a new one.
+    u32 x = 0;
+    u32 y = 0;
+    sui_atlas_page* page = 0;
+    for (u32 i = 0; i < atlas->page_count && !page; ++i) {
+        if (sui_atlas_page_place(&atlas->pages[i], width, height, &x, &y)) {
+            page = &atlas->pages[i];
+        }
+    }
+    if (!page) {
+        if (atlas->page_count >= SUI_ATLAS_MAX_PAGE_COUNT) {
+            KWARN("UI atlas is full (%u pages). UI image '%s' can't be packed.", SUI_ATLAS_MAX_PAGE_COUNT, name);
+            return false;
+        }
+        page = &atlas->pages[atlas->page_count];
+        if (!sui_atlas_page_create(atlas, page)) {
+            return false;
+        }
+        atlas->page_count++;
+        sui_atlas_page_place(page, width, height, &x, &y);
+    }
+
+    texture_system_write_region(page->texture, x, y, width, height, (void*)pixels);
+
+    sui_atlas_image image = {0};
+    string_ncopy(image.name, name, TEXTURE_NAME_MAX_LENGTH - 1);
+    image.region.map = &page->map;
+    image.region.offset = (vec2i){(i32)x, (i32)y};
+    image.region.size = (vec2i){(i32)width, (i32)height};
+    image.region.page_size = (vec2i){SUI_ATLAS_PAGE_SIZE, SUI_ATLAS_PAGE_SIZE};
+    darray_push(atlas->images, image);
+
+    *out_region = image.region;
+    return true;
+}
+
+b8 sui_atlas_image_acquire(sui_atlas* atlas, const char* image_name, sui_atlas_region* out_region) {
+    if (!atlas || !image_name || !out_region) {
+        return false;
+    }
+
+    u32 image_count = darray_length(atlas->images);
+    for (u32 i = 0; i < image_count; ++i) {
+        if (strings_equali(atlas->images[i].name, image_name)) {
+            *out_region = atlas->images[i].region;
+            return true;
+        }
+    }
+
+    // Loaded as the texture system loads textures, so the rows are in the same order.
+    image_resource_params params = {0};
+    params.flip_y = true;
+    params.allow_compressed = false;
+    resource image_resource;
+    if (!resource_system_load(image_name, RESOURCE_TYPE_IMAGE, &params, &image_resource)) {
+        KWARN("Unable to load UI image '%s'.", image_name);
+        return false;
+    }
+
+    image_resource_data* data = image_resource.data;
+    b8 result = false;
+    if (data->format != TEXTURE_FORMAT_RGBA8 || data->channel_count != 4) {
+        KWARN("UI image '%s' is not RGBA8, so can't be packed.", image_name);
+    } else {
+        result = sui_atlas_image_add(atlas, image_name, data->width, data->height, data->pixels, out_region);
+    }
+    resource_system_unload(&image_resource);
+    return result;
+}
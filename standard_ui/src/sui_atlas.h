@@ -0,0 +1,101 @@
+/**
+ * @file sui_atlas.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A runtime atlas of UI images, such as the standard UI image and bitmap font pages.
+ * @details Images are packed into a few shared pages, so that controls drawn from different images
+ * still share a texture, and so draw together. Each packed image is found by a region of a page, and
+ * texture coordinates within the image are remapped into the page with it.
+ * @version 1.0
+ * @date 2023-12-22
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+#include "resources/resource_types.h"
+
+/** @brief The width and height of each page of a UI atlas, in pixels. */
+#define SUI_ATLAS_PAGE_SIZE 1024
+/** @brief The maximum number of pages of a UI atlas. */
+#define SUI_ATLAS_MAX_PAGE_COUNT 4
+
+/** @brief Where an image is within the texture it is drawn from. */
+typedef struct sui_atlas_region {
+    /** @brief The texture map of the page holding the image, or of the image itself if it couldn't be packed. */
+    texture_map* map;
+    /** @brief The pixel position of the image within the page. */
+    vec2i offset;
+    /** @brief The pixel size of the image. */
+    vec2i size;
+    /** @brief The pixel size of the page. Texture coordinates are pixel positions within the page divided by this. */
+    vec2i page_size;
+} sui_atlas_region;
+
+/** @brief A page of a UI atlas. Images are packed into rows, from the top down. */
+typedef struct sui_atlas_page {
+    texture* texture;
+    texture_map map;
+    // The position of the next image, and the height of the current row.
+    u32 pen_x;
+    u32 pen_y;
+    u32 row_height;
+} sui_atlas_page;
+
+/** @brief A named image packed into a UI atlas. */
+typedef struct sui_atlas_image {
+    char name[TEXTURE_NAME_MAX_LENGTH];
+    sui_atlas_region region;
+} sui_atlas_image;
+
+/** @brief A runtime atlas of UI images. */
+typedef struct sui_atlas {
+    u32 page_count;
+    /** @brief The pages, created as they are needed. A fixed array, so texture maps never move. */
+    sui_atlas_page pages[SUI_ATLAS_MAX_PAGE_COUNT];
+    /** @brief darray of the images packed so far. */
+    sui_atlas_image* images;
+} sui_atlas;
+
+/**
+ * @brief Creates an empty UI atlas. Pages are only created once images are added.
+ *
+ * @param out_atlas A pointer to hold the atlas.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 sui_atlas_create(sui_atlas* out_atlas);
+
+/**
+ * @brief Destroys the given UI atlas and its pages. Regions obtained from it are no longer valid.
+ *
+ * @param atlas A pointer to the atlas.
+ */
+KAPI void sui_atlas_destroy(sui_atlas* atlas);
+
+/**
+ * @brief Packs the given RGBA image into the atlas under the given name.
+ *
+ * @param atlas A pointer to the atlas.
+ * @param name The name of the image, by which it can be found again.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param pixels The RGBA pixels of the image, tightly packed row by row.
+ * @param out_region A pointer to hold the region of the image.
+ * @return True on success; false if the image doesn't fit into the atlas.
+ */
+KAPI b8 sui_atlas_image_add(sui_atlas* atlas, const char* name, u32 width, u32 height, const u8* pixels, sui_atlas_region* out_region);
+
+/**
+ * @brief Obtains the region of the image resource with the given name, loading and packing it into
+ * the atlas the first time. The image is loaded the same way as textures, so texture coordinates
+ * which were correct for the texture of the same name are correct within the region.
+ *
+ * @param atlas A pointer to the atlas.
+ * @param image_name The name of the image resource.
+ * @param out_region A pointer to hold the region of the image.
+ * @return True on success; false if the image couldn't be loaded or doesn't fit into the atlas.
+ */
+KAPI b8 sui_atlas_image_acquire(sui_atlas* atlas, const char* image_name, sui_atlas_region* out_region);
@@ -9,41 +9,70 @@ typedef b8 (*PFN_renderer_plugin_create)(renderer_plugin* out_plugin);
 typedef b8 (*PFN_audio_plugin_create)(audio_plugin* out_plugin);
 typedef u64 (*PFN_application_state_size)(void);
 
-b8 load_game_lib(application* app) {
-    // Dynamically load game library
-    if (!platform_dynamic_library_load("testbed_lib_loaded", &app->game_library)) {
-        return false;
-    }
+// The game library is loaded from one of two copies of itself in turn, so that the new build can
+// be loaded while the old one still is, and be discarded if it can't take over the old one's state.
+static const char* game_lib_copy_names[2] = {"testbed_lib_loaded_0", "testbed_lib_loaded_1"};
+static u32 game_lib_copy_index = 0;
+
+// The functions loaded from the game library, in the order they are held in its function list.
+static const char* game_lib_function_names[] = {
+    "application_boot",
+    "application_initialize",
+    "application_update",
+    "application_prepare_frame",
+    "application_render_frame",
+    "application_on_resize",
+    "application_shutdown",
+    "application_lib_on_load",
+    "application_lib_on_unload",
+    "application_state_size"};
+#define GAME_LIB_STATE_SIZE_FUNCTION 9
+
+// Copies the built game library to the given name, as the build overwrites the original.
+static b8 game_lib_copy(const char* target_name) {
+    const char* prefix = platform_dynamic_library_prefix();
+    const char* extension = platform_dynamic_library_extension();
+    char source_file[260];
+    char target_file[260];
+    string_format(source_file, "%stestbed_lib%s", prefix, extension);
+    string_format(target_file, "%s%s%s", prefix, target_name, extension);
 
-    if (!platform_dynamic_library_load_function("application_boot", &app->game_library)) {
-        return false;
-    }
-    if (!platform_dynamic_library_load_function("application_initialize", &app->game_library)) {
-        return false;
-    }
-    if (!platform_dynamic_library_load_function("application_update", &app->game_library)) {
-        return false;
-    }
-    if (!platform_dynamic_library_load_function("application_prepare_frame", &app->game_library)) {
-        return false;
-    }
-    if (!platform_dynamic_library_load_function("application_render_frame", &app->game_library)) {
-        return false;
-    }
-    if (!platform_dynamic_library_load_function("application_on_resize", &app->game_library)) {
-        return false;
+    platform_error_code err_code = PLATFORM_ERROR_FILE_LOCKED;
+    while (err_code == PLATFORM_ERROR_FILE_LOCKED) {
+        err_code = platform_copy_file(source_file, target_file, true);
+        if (err_code == PLATFORM_ERROR_FILE_LOCKED) {
+            platform_sleep(100);
+        }
     }
-    if (!platform_dynamic_library_load_function("application_shutdown", &app->game_library)) {
+    if (err_code != PLATFORM_ERROR_SUCCESS) {
+        KERROR("File copy failed!");
         return false;
     }
+    return true;
+}
 
-    if (!platform_dynamic_library_load_function("application_lib_on_load", &app->game_library)) {
+// Loads the given copy of the game library and the functions the application is bound to.
+static b8 game_lib_open(const char* name, dynamic_library* out_library) {
+    if (!platform_dynamic_library_load(name, out_library)) {
         return false;
     }
 
-    if (!platform_dynamic_library_load_function("application_lib_on_unload", &app->game_library)) {
-        return false;
+    u32 function_count = sizeof(game_lib_function_names) / sizeof(const char*);
+    for (u32 i = 0; i < function_count; ++i) {
+        if (!platform_dynamic_library_load_function(game_lib_function_names[i], out_library)) {
+            KERROR("Game library is missing function '%s'.", game_lib_function_names[i]);
+            platform_dynamic_library_unload(out_library);
+            return false;
+        }
     }
+    return true;
+}
+
+// Binds the application to the functions of the given loaded game library, which it then owns.
+static void game_lib_bind(application* app, dynamic_library* library) {
+    u32 watch_id = app->game_library.watch_id;
+    app->game_library = *library;
+    app->game_library.watch_id = watch_id;
 
     // assign function pointers
     app->boot = app->game_library.functions[0].pfn;
@@ -55,6 +84,15 @@ b8 load_game_lib(application* app) {
     app->shutdown = app->game_library.functions[6].pfn;
     app->lib_on_load = app->game_library.functions[7].pfn;
     app->lib_on_unload = app->game_library.functions[8].pfn;
+}
+
+b8 load_game_lib(application* app) {
+    // Dynamically load game library
+    dynamic_library library;
+    if (!game_lib_copy(game_lib_copy_names[game_lib_copy_index]) || !game_lib_open(game_lib_copy_names[game_lib_copy_index], &library)) {
+        return false;
+    }
+    game_lib_bind(app, &library);
 
     // Invoke the onload.
     app->lib_on_load(app);
@@ -65,45 +103,46 @@ b8 load_game_lib(application* app) {
 b8 watched_file_updated(u16 code, void* sender, void* listener_inst, event_context context) {
     if (code == EVENT_CODE_WATCHED_FILE_WRITTEN) {
         application* app = (application*)listener_inst;
-        if (context.data.u32[0] == app->game_library.watch_id) {
-            KINFO("Hot-Reloading game library.");
-        }
-
-        // Tell the app it is about to be unloaded.
-        app->lib_on_unload(app);
-
-        // Actually unload the app's lib.
-        if (!platform_dynamic_library_unload(&app->game_library)) {
-            KERROR("Failed to unload game library");
+        if (context.data.u32[0] != app->game_library.watch_id) {
+            // Some other watched file, such as a resource.
             return false;
         }
+        KINFO("Hot-Reloading game library.");
+        f64 start_time = platform_get_absolute_time();
 
         // Wait a bit before trying to copy the file.
         platform_sleep(100);
 
-        const char* prefix = platform_dynamic_library_prefix();
-        const char* extension = platform_dynamic_library_extension();
-        char source_file[260];
-        char target_file[260];
-        string_format(source_file, "%stestbed_lib%s", prefix, extension);
-        string_format(target_file, "%stestbed_lib_loaded%s", prefix, extension);
-
-        platform_error_code err_code = PLATFORM_ERROR_FILE_LOCKED;
-        while (err_code == PLATFORM_ERROR_FILE_LOCKED) {
-            err_code = platform_copy_file(source_file, target_file, true);
-            if (err_code == PLATFORM_ERROR_FILE_LOCKED) {
-                platform_sleep(100);
-            }
-        }
-        if (err_code != PLATFORM_ERROR_SUCCESS) {
-            KERROR("File copy failed!");
+        // Load the new build alongside the old one, which keeps running if the new one can't be used.
+        u32 next_index = (game_lib_copy_index + 1) % 2;
+        dynamic_library library;
+        if (!game_lib_copy(game_lib_copy_names[next_index]) || !game_lib_open(game_lib_copy_names[next_index], &library)) {
+            KERROR("Game lib reload failed. The previously loaded game library is kept.");
             return false;
         }
 
-        if (!load_game_lib(app)) {
-            KERROR("Game lib reload failed.");
+        // The state is handed over as it is, so its layout must not have changed.
+        PFN_application_state_size old_state_size = app->game_library.functions[GAME_LIB_STATE_SIZE_FUNCTION].pfn;
+        PFN_application_state_size new_state_size = library.functions[GAME_LIB_STATE_SIZE_FUNCTION].pfn;
+        if (old_state_size() != new_state_size()) {
+            KERROR("Game state size changed from %llu to %llu bytes, so it can't be handed over. Restart to pick up this change.", old_state_size(), new_state_size());
+            platform_dynamic_library_unload(&library);
             return false;
         }
+
+        // Tell the app it is about to be unloaded.
+        app->lib_on_unload(app);
+
+        // Actually unload the app's lib.
+        if (!platform_dynamic_library_unload(&app->game_library)) {
+            KWARN("Failed to unload previous game library.");
+        }
+
+        game_lib_bind(app, &library);
+        game_lib_copy_index = next_index;
+        app->lib_on_load(app);
+
+        KINFO("Game library reloaded in %.1f ms.", (platform_get_absolute_time() - start_time) * 1000.0);
     }
     return false;
 }
@@ -117,25 +156,6 @@ b8 create_application(application* out_application) {
     out_application->app_config.start_height = 720;
     out_application->app_config.name = "Kohi Engine Testbed";
 
-    platform_error_code err_code = PLATFORM_ERROR_FILE_LOCKED;
-    while (err_code == PLATFORM_ERROR_FILE_LOCKED) {
-        const char* prefix = platform_dynamic_library_prefix();
-        const char* extension = platform_dynamic_library_extension();
-        char source_file[260];
-        char target_file[260];
-        string_format(source_file, "%stestbed_lib%s", prefix, extension);
-        string_format(target_file, "%stestbed_lib_loaded%s", prefix, extension);
-
-        err_code = platform_copy_file(source_file, target_file, true);
-        if (err_code == PLATFORM_ERROR_FILE_LOCKED) {
-            platform_sleep(100);
-        }
-    }
-    if (err_code != PLATFORM_ERROR_SUCCESS) {
-        KERROR("File copy failed!");
-        return false;
-    }
-
     if (!load_game_lib(out_application)) {
         KERROR("Initial game lib load failed!");
     }
@@ -143,8 +163,14 @@ b8 create_application(application* out_application) {
     out_application->engine_state = 0;
     out_application->state = 0;
 
-    // Load the Vulkan renderer plugin.
-    if (!platform_dynamic_library_load("vulkan_renderer", &out_application->renderer_library)) {
+    // Load the renderer plugin. Vulkan unless "renderer=null" is passed, which submits no GPU work.
+    const char* renderer_library_name = "vulkan_renderer";
+    for (i32 i = 1; i < out_application->argc; ++i) {
+        if (strings_equali(out_application->argv[i], "renderer=null")) {
+            renderer_library_name = "null_renderer";
+        }
+    }
+    if (!platform_dynamic_library_load(renderer_library_name, &out_application->renderer_library)) {
         return false;
     }
 
@@ -244,6 +244,14 @@ void game_on_debug_vsync_toggle(keys key, keymap_entry_bind_type type, keymap_mo
     console_command_execute(cmd);
 }
 
+void game_on_frame_capture(keys key, keymap_entry_bind_type type, keymap_modifier modifiers, void* user_data) {
+    application* game_inst = (application*)user_data;
+    testbed_game_state* state = (testbed_game_state*)game_inst->state;
+
+    // Written once the next frame has been prepared.
+    state->frame_capture_pending = true;
+}
+
 void game_print_memory_metrics(keys key, keymap_entry_bind_type type, keymap_modifier modifiers, void* user_data) {
     application* game_inst = (application*)user_data;
     testbed_game_state* state = (testbed_game_state*)game_inst->state;
@@ -300,6 +308,7 @@ void game_setup_keymaps(application* game_inst) {
     keymap_binding_add(&testbed_keymap, KEY_P, KEYMAP_BIND_TYPE_PRESS, KEYMAP_MODIFIER_NONE_BIT, game_inst, game_on_debug_cam_position);
     keymap_binding_add(&testbed_keymap, KEY_V, KEYMAP_BIND_TYPE_PRESS, KEYMAP_MODIFIER_NONE_BIT, game_inst, game_on_debug_vsync_toggle);
     keymap_binding_add(&testbed_keymap, KEY_M, KEYMAP_BIND_TYPE_PRESS, KEYMAP_MODIFIER_NONE_BIT, game_inst, game_print_memory_metrics);
+    keymap_binding_add(&testbed_keymap, KEY_C, KEYMAP_BIND_TYPE_PRESS, KEYMAP_MODIFIER_CONTROL_BIT, game_inst, game_on_frame_capture);
 
     input_keymap_push(&testbed_keymap);
 
@@ -8,23 +8,41 @@
 
 #include "audio/audio_types.h"
 #include "editor/editor_gizmo.h"
+#include "renderer/debug_draw.h"
+#include "renderer/dynamic_resolution.h"
+#include "renderer/ibl.h"
+#include "renderer/occlusion_buffer.h"
 #include "renderer/viewport.h"
 #include "resources/simple_scene.h"
 
 // TODO: temp
 #include <core/kclock.h>
 #include <core/keymap.h>
+#include <core/kvar.h>
 #include <resources/debug/debug_box3d.h>
 #include <resources/skybox.h>
 #include <standard_ui_system.h>
 #include <systems/light_system.h>
 
 #include "debug_console.h"
+#include "render_benchmark.h"
+#include "upload_benchmark.h"
+#include "render_capture.h"
 struct debug_line3d;
 struct debug_box3d;
 struct transform;
 
 #define MAX_SHADOW_CASCADE_COUNT 4
+// The width and height of each shadow cascade, in texels.
+#define SHADOW_MAP_RESOLUTION 2048
+// The number of levels of detail coarser than the scene pass that shadow cascades draw meshes at.
+#define SHADOW_LOD_BIAS 1
+// The width and height of each face of a point light's shadow, in texels.
+#define POINT_SHADOW_RESOLUTION 256
+// The number of point lights nearest the camera which cast shadows.
+#define POINT_SHADOW_SLOT_COUNT 4
+// The most point lights whose static shadow faces are rendered again in a single frame.
+#define POINT_SHADOW_UPDATE_BUDGET 2
 
 typedef struct selected_object {
     u32 unique_id;
@@ -79,6 +97,12 @@ typedef struct testbed_game_state {
     struct debug_line3d* test_lines;
     struct debug_box3d* test_boxes;
 
+    // Debug shapes (grid, bounds, casts) drawn each frame by the scene pass.
+    debug_draw_batch debug_batch;
+
+    // Software depth buffer used to cull hidden objects on the CPU, when enabled.
+    occlusion_buffer occlusion_buffer;
+
     viewport world_viewport;
     viewport ui_viewport;
 
@@ -87,14 +111,30 @@ typedef struct testbed_game_state {
     rendergraph frame_graph;
     rendergraph_pass skybox_pass;
     rendergraph_pass shadowmap_pass;
+    rendergraph_pass point_shadow_pass;
+    rendergraph_pass depth_prepass;
     rendergraph_pass scene_pass;
+    rendergraph_pass oit_composite_pass;
+    rendergraph_pass skinned_pass;
+    rendergraph_pass impostor_pass;
+    rendergraph_pass particle_simulate_pass;
+    rendergraph_pass particle_pass;
     rendergraph_pass editor_pass;
+    rendergraph_pass upscale_pass;
     rendergraph_pass ui_pass;
+    // Picks the resolution scale of the scene's passes from the GPU time of each frame.
+    dynamic_resolution resolution_controller;
+    // The image based lighting of the main scene's skybox, and the skybox it was created for.
+    ibl_environment ibl;
+    struct skybox* ibl_skybox;
 
     u16 shadowmap_resolution;
 
     selected_object selection;
     b8 using_gizmo;
+    // The last mouse position moved to, hover tested against the gizmo once per frame if pending.
+    vec2 hover_position;
+    b8 hover_pending;
 
     u32 render_mode;
 
@@ -109,6 +149,25 @@ typedef struct testbed_game_state {
     u32 proj_box_index;
     u32 cam_proj_line_indices[24];
 
+    // The scripted benchmark run, if one was requested on the command line.
+    render_benchmark benchmark;
+    // The frame capture replayed by the benchmark, if it was asked to replay one.
+    render_capture replay;
+    // The GPU upload benchmark, if one was requested on the command line.
+    upload_benchmark upload_benchmark;
+    // Set to write the render input of the next prepared frame to a capture file.
+    b8 frame_capture_pending;
+    // The name of the scene resource the main scene was loaded from, as saved in frame captures.
+    char main_scene_name[256];
+
+    // Handles of the kvars read every frame.
+    kvar_handle depth_prepass_kvar;
+    kvar_handle gpu_timings_kvar;
+    kvar_handle occlusion_culling_kvar;
+    kvar_handle occlusion_queries_kvar;
+    kvar_handle particles_gpu_kvar;
+    kvar_handle dynamic_resolution_kvar;
+
     // TODO: end temp
 } testbed_game_state;
 
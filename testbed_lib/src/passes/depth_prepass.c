@@ -0,0 +1,221 @@
+#include "depth_prepass.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "defines.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "resources/resource_types.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+// The maximum number of static mesh instances which can be drawn per frame.
+#define DEPTH_PREPASS_MAX_INSTANCES 16384
+
+typedef struct depth_prepass_shader_locations {
+    u16 projection;
+    u16 view;
+    u16 scene_objects;
+} depth_prepass_shader_locations;
+
+typedef struct depth_prepass_internal_data {
+    shader* s;
+    depth_prepass_shader_locations locations;
+
+    // Per-instance scene object indices. Holds one region of DEPTH_PREPASS_MAX_INSTANCES
+    // per render target, so a frame still in flight is never overwritten.
+    renderbuffer instance_buffer;
+    u8 instance_region_count;
+} depth_prepass_internal_data;
+
+static b8 geometry_draw_record_instanceable(const geometry_draw_record* a, const geometry_draw_record* b) {
+    // Material doesn't matter here, only what is drawn and how.
+    return a->geometry == b->geometry && a->lod == b->lod && a->winding_inverted == b->winding_inverted &&
+           a->first_index == b->first_index && a->index_count == b->index_count;
+}
+
+b8 depth_prepass_create(struct rendergraph_pass* self, void* config) {
+    if (!self) {
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(depth_prepass_internal_data), MEMORY_TAG_RENDERER);
+    self->pass_data.ext_data = kallocate(sizeof(depth_prepass_extended_data), MEMORY_TAG_RENDERER);
+
+    return true;
+}
+
+b8 depth_prepass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    depth_prepass_internal_data* internal_data = self->internal_data;
+
+    // Renderpass config - depth prepass. Depth only, cleared here so later passes can load it.
+    renderpass_config prepass_config = {0};
+    prepass_config.name = "Renderpass.DepthPrepass";
+    prepass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    prepass_config.clear_flags = RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG | RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG;
+    prepass_config.depth = 1.0f;
+    prepass_config.stencil = 0;
+    prepass_config.target.attachment_count = 1;
+    prepass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * prepass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    prepass_config.render_target_count = renderer_window_attachment_count_get();
+
+    // Depth attachment
+    render_target_attachment_config* prepass_target_depth = &prepass_config.target.attachments[0];
+    prepass_target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    prepass_target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    prepass_target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    prepass_target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    prepass_target_depth->present_after = false;
+
+    if (!renderer_renderpass_create(&prepass_config, &self->pass)) {
+        KERROR("Failed to create depth prepass renderpass.");
+        return false;
+    }
+
+    // Load depth prepass shader.
+    const char* prepass_shader_name = "Shader.DepthPrepass";
+    resource prepass_shader_config_resource;
+    if (!resource_system_load(prepass_shader_name, RESOURCE_TYPE_SHADER, 0, &prepass_shader_config_resource)) {
+        KERROR("Failed to load depth prepass shader resource.");
+        return false;
+    }
+    shader_config* prepass_shader_config = (shader_config*)prepass_shader_config_resource.data;
+    if (!shader_system_create(&self->pass, prepass_shader_config)) {
+        KERROR("Failed to create depth prepass shader.");
+        return false;
+    }
+    resource_system_unload(&prepass_shader_config_resource);
+    // Save off a pointer to the shader.
+    internal_data->s = shader_system_get(prepass_shader_name);
+    internal_data->locations.projection = shader_system_uniform_location(internal_data->s, "projection");
+    internal_data->locations.view = shader_system_uniform_location(internal_data->s, "view");
+    internal_data->locations.scene_objects = shader_system_uniform_location(internal_data->s, "scene_objects");
+
+    // Instance buffer for per-instance scene object indices.
+    internal_data->instance_region_count = renderer_window_attachment_count_get();
+    u64 instance_buffer_size = sizeof(u32) * DEPTH_PREPASS_MAX_INSTANCES * internal_data->instance_region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_instancebuffer_depth_prepass", RENDERBUFFER_TYPE_INSTANCE, instance_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->instance_buffer)) {
+        KERROR("Failed to create depth prepass instance buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->instance_buffer, 0);
+
+    return true;
+}
+
+b8 depth_prepass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    // Bind the viewport
+    renderer_active_viewport_set(self->pass_data.vp);
+
+    // NOTE: Always begun, even when disabled, since this is where the depth buffer gets cleared.
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("depth prepass failed to start.");
+        return false;
+    }
+
+    depth_prepass_internal_data* internal_data = self->internal_data;
+    depth_prepass_extended_data* ext_data = self->pass_data.ext_data;
+
+    u32 count = ext_data->geometry_count;
+    if (ext_data->enabled && count > 0 && ext_data->object_buffer) {
+        shader_system_use_by_id(internal_data->s->id);
+
+        // Globals
+        shader_system_uniform_set_by_location(internal_data->locations.projection, &self->pass_data.projection_matrix);
+        shader_system_uniform_set_by_location(internal_data->locations.view, &self->pass_data.view_matrix);
+        if (!shader_system_storage_buffer_set_by_location(internal_data->locations.scene_objects, ext_data->object_buffer)) {
+            KERROR("Failed to set scene object buffer for depth prepass. Render frame failed.");
+            return false;
+        }
+        shader_system_apply_global(true, p_frame_data);
+
+        // Gather all object indices into this frame's region of the instance buffer.
+        if (count > DEPTH_PREPASS_MAX_INSTANCES) {
+            KWARN("Depth prepass geometry count %u exceeds maximum instance count of %u. Extra geometries will not be drawn.", count, DEPTH_PREPASS_MAX_INSTANCES);
+            count = DEPTH_PREPASS_MAX_INSTANCES;
+        }
+        u64 region_offset = sizeof(u32) * DEPTH_PREPASS_MAX_INSTANCES * (p_frame_data->render_target_index % internal_data->instance_region_count);
+        u32* object_indices = p_frame_data->allocator.allocate(sizeof(u32) * count);
+        for (u32 i = 0; i < count; ++i) {
+            object_indices[i] = ext_data->geometries[i].object_index;
+        }
+        if (!renderer_renderbuffer_load_range(&internal_data->instance_buffer, region_offset, sizeof(u32) * count, object_indices)) {
+            KERROR("Failed to upload depth prepass instance data. Render frame failed.");
+            return false;
+        }
+
+        // Using the shader selects the standard vertex format.
+        geometry_vertex_format current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+        // Runs of identical geometries are drawn as a single instanced batch.
+        u32 i = 0;
+        while (i < count) {
+            const geometry_draw_record* record = &ext_data->geometries[i];
+            u32 first_instance = i;
+            u32 instance_count = 1;
+            while (i + instance_count < count && geometry_draw_record_instanceable(record, &ext_data->geometries[i + instance_count])) {
+                instance_count++;
+            }
+            i += instance_count;
+
+            // Transforms come from the object buffer, so no model is needed.
+            geometry_render_data batch_data;
+            renderer_geometry_draw_record_resolve(record, 0, &batch_data);
+            geometry_render_data* batch = &batch_data;
+
+            // Switch vertex formats if needed.
+            if (batch->vertex_format != current_vertex_format) {
+                if (!shader_system_vertex_format_set(batch->vertex_format)) {
+                    KWARN("Failed to set vertex format for depth prepass. Skipping draw.");
+                    continue;
+                }
+                current_vertex_format = batch->vertex_format;
+            }
+
+            // Invert if needed
+            if (batch->winding_inverted) {
+                renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
+            }
+
+            u64 instance_offset = region_offset + (sizeof(u32) * first_instance);
+            renderer_geometry_draw_instanced(batch, &internal_data->instance_buffer, instance_offset, instance_count);
+
+            // Change back if needed
+            if (batch->winding_inverted) {
+                renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
+            }
+        }
+
+        // HACK: This should be handled somehow, every frame, by the shader system.
+        internal_data->s->render_frame_number = p_frame_data->renderer_frame_number;
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("depth prepass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void depth_prepass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            depth_prepass_internal_data* internal_data = self->internal_data;
+
+            renderer_renderbuffer_destroy(&internal_data->instance_buffer);
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(depth_prepass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
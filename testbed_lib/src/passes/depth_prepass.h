@@ -0,0 +1,27 @@
+#ifndef _DEPTH_PREPASS_H_
+#define _DEPTH_PREPASS_H_
+
+#include "defines.h"
+
+struct rendergraph_pass;
+struct frame_data;
+struct renderbuffer;
+
+struct geometry_draw_record;
+
+typedef struct depth_prepass_extended_data {
+    // If false, the depth buffer is only cleared.
+    b8 enabled;
+
+    u32 geometry_count;
+    struct geometry_draw_record* geometries;
+    // The scene's persistent object buffer, indexed by each record's object_index.
+    struct renderbuffer* object_buffer;
+} depth_prepass_extended_data;
+
+b8 depth_prepass_create(struct rendergraph_pass* self, void* config);
+b8 depth_prepass_initialize(struct rendergraph_pass* self);
+b8 depth_prepass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void depth_prepass_destroy(struct rendergraph_pass* self);
+
+#endif
@@ -17,6 +17,8 @@ typedef struct debug_shader_locations {
 typedef struct editor_pass_internal_data {
     shader* colour_shader;
     debug_shader_locations debug_locations;
+    // Indicates the colour shader's only local is its model matrix, so it can be pushed as is.
+    b8 debug_local_block_valid;
 } editor_pass_internal_data;
 
 b8 editor_pass_create(struct rendergraph_pass* self, void* config) {
@@ -51,7 +53,7 @@ b8 editor_pass_initialize(struct rendergraph_pass* self) {
     // Colour attachment
     render_target_attachment_config* editor_target_colour = &editor_pass_config.target.attachments[0];
     editor_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
-    editor_target_colour->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    editor_target_colour->source = rendergraph_pass_colour_source(self);
     editor_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
     editor_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
     editor_target_colour->present_after = false;
@@ -79,6 +81,8 @@ b8 editor_pass_initialize(struct rendergraph_pass* self) {
     internal_data->debug_locations.projection = shader_system_uniform_location(internal_data->colour_shader, "projection");
     internal_data->debug_locations.view = shader_system_uniform_location(internal_data->colour_shader, "view");
     internal_data->debug_locations.model = shader_system_uniform_location(internal_data->colour_shader, "model");
+    const shader_local_block_member debug_local_members[] = {{"model", 0, sizeof(mat4)}};
+    internal_data->debug_local_block_valid = shader_system_local_block_verify(internal_data->colour_shader, 1, debug_local_members, sizeof(mat4));
 
     return true;
 }
@@ -119,9 +123,13 @@ b8 editor_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame
         geometry_render_data* render_data = &ext_data->debug_geometries[i];
 
         // Set model matrix.
-        shader_system_bind_local();
-        shader_system_uniform_set_by_location(internal_data->debug_locations.model, &render_data->model);
-        shader_system_apply_local(p_frame_data);
+        if (internal_data->debug_local_block_valid) {
+            shader_system_local_block_push(&render_data->model, sizeof(mat4));
+        } else {
+            shader_system_bind_local();
+            shader_system_uniform_set_by_location(internal_data->debug_locations.model, &render_data->model);
+            shader_system_apply_local(p_frame_data);
+        }
 
         // Draw it.
         renderer_geometry_draw(render_data);
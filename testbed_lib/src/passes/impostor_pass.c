@@ -0,0 +1,317 @@
+#include "impostor_pass.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "math/kmath.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "resources/simple_scene.h"
+#include "systems/geometry_system.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+// The most impostor instances drawn per frame.
+#define IMPOSTOR_PASS_MAX_INSTANCES 65536
+// The most distinct pairs of atlases, each of which takes a shader instance.
+#define IMPOSTOR_PASS_MAX_ATLASES 64
+
+// The local uniforms of the impostor shader, pushed whole.
+typedef struct impostor_local_block {
+    u32 frame_count;
+} impostor_local_block;
+
+typedef struct impostor_locations {
+    u16 projection;
+    u16 view;
+    u16 view_position;
+    u16 light_direction;
+    u16 light_colour;
+    u16 atlases;
+} impostor_locations;
+
+// The shader instance of a pair of atlases.
+typedef struct impostor_pass_atlas {
+    // The albedo and normal maps. Their addresses are held by the shader instance, so never move.
+    texture_map maps[2];
+    u32 instance_id;
+    u64 render_frame_number;
+    u8 draw_index;
+} impostor_pass_atlas;
+
+typedef struct impostor_pass_internal_data {
+    shader* s;
+    impostor_locations locations;
+    geometry* quad;
+
+    // The instance buffer holds one region per render target, so instances still in use by a frame
+    // in flight are never overwritten. 0 until the buffer is created.
+    u8 region_count;
+    renderbuffer instance_buffer;
+
+    u32 atlas_count;
+    impostor_pass_atlas atlases[IMPOSTOR_PASS_MAX_ATLASES];
+} impostor_pass_internal_data;
+
+// Obtains the shader instance of the given atlases, acquiring one the first time they are drawn.
+static impostor_pass_atlas* impostor_pass_atlas_get(impostor_pass_internal_data* internal_data, texture* albedo, texture* normal) {
+    for (u32 i = 0; i < internal_data->atlas_count; ++i) {
+        impostor_pass_atlas* atlas = &internal_data->atlases[i];
+        if (atlas->maps[0].texture == albedo && atlas->maps[1].texture == normal) {
+            return atlas;
+        }
+    }
+    if (internal_data->atlas_count == IMPOSTOR_PASS_MAX_ATLASES) {
+        return 0;
+    }
+
+    impostor_pass_atlas* atlas = &internal_data->atlases[internal_data->atlas_count];
+    kzero_memory(atlas, sizeof(impostor_pass_atlas));
+    for (u32 i = 0; i < 2; ++i) {
+        texture_map* map = &atlas->maps[i];
+        map->texture = i == 0 ? albedo : normal;
+        map->filter_magnify = map->filter_minify = TEXTURE_FILTER_MODE_LINEAR;
+        // Frames are padded by the tools, and clamped so the last never reads past the edge.
+        map->repeat_u = map->repeat_v = map->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+        if (!renderer_texture_map_resources_acquire(map)) {
+            KERROR("Unable to acquire resources for impostor atlas '%s'.", map->texture->name);
+            if (i == 1) {
+                renderer_texture_map_resources_release(&atlas->maps[0]);
+            }
+            return 0;
+        }
+    }
+
+    texture_map* maps[2] = {&atlas->maps[0], &atlas->maps[1]};
+    shader_instance_uniform_texture_config atlas_textures = {0};
+    atlas_textures.uniform_location = internal_data->locations.atlases;
+    atlas_textures.texture_map_count = 2;
+    atlas_textures.texture_maps = maps;
+    shader_instance_resource_config instance_resource_config = {0};
+    instance_resource_config.uniform_config_count = 1;
+    instance_resource_config.uniform_configs = &atlas_textures;
+    if (!renderer_shader_instance_resources_acquire(internal_data->s, &instance_resource_config, &atlas->instance_id)) {
+        KERROR("Unable to acquire shader resources for impostor atlas '%s'.", albedo->name);
+        renderer_texture_map_resources_release(&atlas->maps[0]);
+        renderer_texture_map_resources_release(&atlas->maps[1]);
+        return 0;
+    }
+    atlas->render_frame_number = INVALID_ID_U64;
+
+    internal_data->atlas_count++;
+    return atlas;
+}
+
+b8 impostor_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self) {
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(impostor_pass_internal_data), MEMORY_TAG_RENDERER);
+    self->pass_data.ext_data = kallocate(sizeof(impostor_pass_extended_data), MEMORY_TAG_RENDERER);
+
+    return true;
+}
+
+b8 impostor_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    impostor_pass_internal_data* internal_data = self->internal_data;
+
+    // Renderpass config. Drawn into the scene, tested against and writing its depth.
+    renderpass_config impostor_pass_config = {0};
+    impostor_pass_config.name = "Renderpass.Testbed.Impostors";
+    impostor_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    impostor_pass_config.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
+    impostor_pass_config.depth = 1.0f;
+    impostor_pass_config.stencil = 0;
+    impostor_pass_config.target.attachment_count = 2;
+    impostor_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * impostor_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    impostor_pass_config.render_target_count = renderer_window_attachment_count_get();
+
+    // Colour attachment
+    render_target_attachment_config* impostor_target_colour = &impostor_pass_config.target.attachments[0];
+    impostor_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+    impostor_target_colour->source = rendergraph_pass_colour_source(self);
+    impostor_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    impostor_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    impostor_target_colour->present_after = false;
+
+    // Depth attachment
+    render_target_attachment_config* impostor_target_depth = &impostor_pass_config.target.attachments[1];
+    impostor_target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    impostor_target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    impostor_target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    impostor_target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    impostor_target_depth->present_after = false;
+
+    if (!renderer_renderpass_create(&impostor_pass_config, &self->pass)) {
+        KERROR("Failed to create impostor renderpass.");
+        return false;
+    }
+
+    const char* shader_name = "Shader.Impostor";
+    resource config_resource;
+    if (!resource_system_load(shader_name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", shader_name);
+        return false;
+    }
+    b8 created = shader_system_create(&self->pass, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!created) {
+        KERROR("Failed to create shader '%s'.", shader_name);
+        return false;
+    }
+    internal_data->s = shader_system_get(shader_name);
+    internal_data->locations.projection = shader_system_uniform_location(internal_data->s, "projection");
+    internal_data->locations.view = shader_system_uniform_location(internal_data->s, "view");
+    internal_data->locations.view_position = shader_system_uniform_location(internal_data->s, "view_position");
+    internal_data->locations.light_direction = shader_system_uniform_location(internal_data->s, "light_direction");
+    internal_data->locations.light_colour = shader_system_uniform_location(internal_data->s, "light_colour");
+    internal_data->locations.atlases = shader_system_uniform_location(internal_data->s, "atlases");
+
+#define BLOCK_MEMBER(member) {#member, offsetof(impostor_local_block, member), sizeof(((impostor_local_block*)0)->member)}
+    const shader_local_block_member members[] = {BLOCK_MEMBER(frame_count)};
+#undef BLOCK_MEMBER
+    if (!shader_system_local_block_verify(internal_data->s, sizeof(members) / sizeof(shader_local_block_member), members, sizeof(impostor_local_block))) {
+        KERROR("Impostor shader locals don't match impostor_local_block.");
+        return false;
+    }
+
+    // Every impostor is a unit quad, sized and faced toward the camera by the vertex shader.
+    geometry_config quad_config = {0};
+    generate_quad_2d("impostor_quad", 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, &quad_config);
+    internal_data->quad = geometry_system_acquire_from_config(quad_config, true);
+    geometry_system_config_dispose(&quad_config);
+    if (!internal_data->quad) {
+        KERROR("Failed to create impostor quad geometry.");
+        return false;
+    }
+
+    u8 region_count = renderer_window_attachment_count_get();
+    u64 instance_size = sizeof(simple_scene_impostor_instance) * IMPOSTOR_PASS_MAX_INSTANCES * region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_instancebuffer_impostors", RENDERBUFFER_TYPE_INSTANCE, instance_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->instance_buffer)) {
+        KERROR("Failed to create impostor instance buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->instance_buffer, 0);
+    internal_data->region_count = region_count;
+
+    return true;
+}
+
+b8 impostor_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    impostor_pass_internal_data* internal_data = self->internal_data;
+    impostor_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    u32 instance_count = KMIN(ext_data->instance_count, IMPOSTOR_PASS_MAX_INSTANCES);
+    if (instance_count < ext_data->instance_count) {
+        KWARN("Only the first %u of %u impostors fit within the instance buffer. The rest will not be drawn.", instance_count, ext_data->instance_count);
+    }
+
+    u32 region = p_frame_data->render_target_index % internal_data->region_count;
+    u64 region_offset = sizeof(simple_scene_impostor_instance) * (u64)region * IMPOSTOR_PASS_MAX_INSTANCES;
+    if (instance_count) {
+        if (!renderer_renderbuffer_load_range(&internal_data->instance_buffer, region_offset, sizeof(simple_scene_impostor_instance) * instance_count, ext_data->instances)) {
+            KERROR("Failed to upload impostor instance data. Render frame failed.");
+            return false;
+        }
+    }
+
+    // Bind the viewport
+    renderer_active_viewport_set(self->pass_data.vp);
+
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("impostor renderpass failed to start.");
+        return false;
+    }
+
+    if (instance_count) {
+        shader* s = internal_data->s;
+        shader_system_use_by_id(s->id);
+        vec4 view_position = vec4_from_vec3(self->pass_data.view_position, 1.0f);
+        shader_system_uniform_set_by_location(internal_data->locations.projection, &self->pass_data.projection_matrix);
+        shader_system_uniform_set_by_location(internal_data->locations.view, &self->pass_data.view_matrix);
+        shader_system_uniform_set_by_location(internal_data->locations.view_position, &view_position);
+        shader_system_uniform_set_by_location(internal_data->locations.light_direction, &ext_data->light_direction);
+        shader_system_uniform_set_by_location(internal_data->locations.light_colour, &ext_data->light_colour);
+        shader_system_apply_global(true, p_frame_data);
+
+        geometry_draw_record quad_record = {0};
+        quad_record.geometry = internal_data->quad;
+        geometry_render_data quad_data;
+        renderer_geometry_draw_record_resolve(&quad_record, 0, &quad_data);
+
+        for (u32 i = 0; i < ext_data->batch_count; ++i) {
+            const simple_scene_impostor_batch* batch = &ext_data->batches[i];
+            if (batch->first_instance >= instance_count) {
+                break;
+            }
+            impostor_pass_atlas* atlas = impostor_pass_atlas_get(internal_data, batch->albedo, batch->normal);
+            if (!atlas) {
+                continue;
+            }
+
+            shader_system_bind_instance(atlas->instance_id);
+            b8 needs_update = atlas->render_frame_number != p_frame_data->renderer_frame_number || atlas->draw_index != p_frame_data->draw_index;
+            if (needs_update) {
+                shader_system_uniform_set_by_location_arrayed(internal_data->locations.atlases, 0, &atlas->maps[0]);
+                shader_system_uniform_set_by_location_arrayed(internal_data->locations.atlases, 1, &atlas->maps[1]);
+            }
+            shader_system_apply_instance(needs_update, p_frame_data);
+            atlas->render_frame_number = p_frame_data->renderer_frame_number;
+            atlas->draw_index = p_frame_data->draw_index;
+
+            impostor_local_block block = {0};
+            block.frame_count = batch->frame_count;
+            shader_system_local_block_push(&block, sizeof(impostor_local_block));
+
+            u32 batch_instance_count = KMIN(batch->instance_count, instance_count - batch->first_instance);
+            u64 instance_offset = region_offset + sizeof(simple_scene_impostor_instance) * batch->first_instance;
+            renderer_geometry_draw_instanced(&quad_data, &internal_data->instance_buffer, instance_offset, batch_instance_count);
+        }
+
+        // HACK: This should be handled somehow, every frame, by the shader system.
+        s->render_frame_number = p_frame_data->renderer_frame_number;
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("impostor renderpass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void impostor_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            impostor_pass_internal_data* internal_data = self->internal_data;
+
+            for (u32 i = 0; i < internal_data->atlas_count; ++i) {
+                impostor_pass_atlas* atlas = &internal_data->atlases[i];
+                renderer_shader_instance_resources_release(internal_data->s, atlas->instance_id);
+                renderer_texture_map_resources_release(&atlas->maps[0]);
+                renderer_texture_map_resources_release(&atlas->maps[1]);
+            }
+            if (internal_data->region_count) {
+                renderer_renderbuffer_destroy(&internal_data->instance_buffer);
+            }
+            if (internal_data->quad) {
+                geometry_system_release(internal_data->quad);
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(impostor_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef _IMPOSTOR_PASS_H_
+#define _IMPOSTOR_PASS_H_
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct rendergraph_pass;
+struct frame_data;
+
+struct simple_scene_impostor_instance;
+struct simple_scene_impostor_batch;
+
+typedef struct impostor_pass_extended_data {
+    u32 instance_count;
+    // The impostor instances to draw, ordered by batch.
+    struct simple_scene_impostor_instance* instances;
+    u32 batch_count;
+    // Runs of instances sharing atlases, each drawn with a single instanced draw.
+    struct simple_scene_impostor_batch* batches;
+    // The directional light the impostors are lit by.
+    vec4 light_direction;
+    vec4 light_colour;
+} impostor_pass_extended_data;
+
+b8 impostor_pass_create(struct rendergraph_pass* self, void* config);
+b8 impostor_pass_initialize(struct rendergraph_pass* self);
+b8 impostor_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void impostor_pass_destroy(struct rendergraph_pass* self);
+
+#endif
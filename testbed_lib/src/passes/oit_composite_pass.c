@@ -0,0 +1,250 @@
+#include "oit_composite_pass.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "passes/scene_pass.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "renderer/viewport.h"
+#include "systems/geometry_system.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+typedef struct oit_composite_shader_locations {
+    u16 source_rect;
+    u16 accumulation;
+    u16 coverage;
+} oit_composite_shader_locations;
+
+// The shader instance sampling the weighted blended transparency targets of one render target.
+typedef struct oit_composite_source {
+    // Their addresses are held by the shader instance, so never move.
+    texture_map accumulation;
+    texture_map coverage;
+    u32 instance_id;
+    u64 render_frame_number;
+    u8 draw_index;
+} oit_composite_source;
+
+typedef struct oit_composite_pass_internal_data {
+    struct rendergraph_pass* scene_pass;
+    shader* s;
+    oit_composite_shader_locations locations;
+    geometry* quad;
+
+    u32 source_count;
+    oit_composite_source* sources;
+} oit_composite_pass_internal_data;
+
+b8 oit_composite_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self || !config) {
+        KERROR("oit_composite_pass_create requires a pointer to the pass and its configuration.");
+        return false;
+    }
+
+    oit_composite_pass_config* typed_config = config;
+    if (!typed_config->scene_pass) {
+        KERROR("oit_composite_pass_create requires the scene pass it composites.");
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(oit_composite_pass_internal_data), MEMORY_TAG_RENDERER);
+    oit_composite_pass_internal_data* internal_data = self->internal_data;
+    internal_data->scene_pass = typed_config->scene_pass;
+
+    // Only uses its own shader and instances, so may be recorded alongside other passes.
+    self->parallel_recording = true;
+
+    return true;
+}
+
+b8 oit_composite_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    oit_composite_pass_internal_data* internal_data = self->internal_data;
+
+    // Blends over the colour of the scene, so it is loaded.
+    renderpass_config composite_pass_config = {0};
+    composite_pass_config.name = "Renderpass.OITComposite";
+    composite_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    composite_pass_config.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
+    composite_pass_config.depth = 1.0f;
+    composite_pass_config.stencil = 0;
+    composite_pass_config.target.attachment_count = 1;
+    composite_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * composite_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    composite_pass_config.render_target_count = renderer_window_attachment_count_get();
+
+    render_target_attachment_config* composite_target_colour = &composite_pass_config.target.attachments[0];
+    composite_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+    composite_target_colour->source = rendergraph_pass_colour_source(self);
+    composite_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    composite_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    composite_target_colour->present_after = false;
+
+    if (!renderer_renderpass_create(&composite_pass_config, &self->pass)) {
+        KERROR("Failed to create OIT composite renderpass.");
+        return false;
+    }
+
+    // The scene pass is initialized first, so knows whether it accumulates transparency by now.
+    if (!scene_pass_weighted_blended(internal_data->scene_pass)) {
+        return true;
+    }
+
+    const char* shader_name = "Shader.OITComposite";
+    resource config_resource;
+    if (!resource_system_load(shader_name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", shader_name);
+        return false;
+    }
+    b8 created = shader_system_create(&self->pass, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!created) {
+        KERROR("Failed to create shader '%s'.", shader_name);
+        return false;
+    }
+    internal_data->s = shader_system_get(shader_name);
+    internal_data->locations.source_rect = shader_system_uniform_location(internal_data->s, "source_rect");
+    internal_data->locations.accumulation = shader_system_uniform_location(internal_data->s, "accumulation");
+    internal_data->locations.coverage = shader_system_uniform_location(internal_data->s, "coverage");
+
+    // A unit quad, stretched over the viewport by the vertex shader.
+    geometry_config quad_config = {0};
+    generate_quad_2d("oit_composite_quad", 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, &quad_config);
+    internal_data->quad = geometry_system_acquire_from_config(quad_config, true);
+    geometry_system_config_dispose(&quad_config);
+    if (!internal_data->quad) {
+        KERROR("Failed to create OIT composite quad geometry.");
+        return false;
+    }
+
+    // The scene pass creates its targets along with its render targets, before this is initialized.
+    u32 source_count = self->pass.render_target_count;
+    internal_data->sources = kallocate(sizeof(oit_composite_source) * source_count, MEMORY_TAG_RENDERER);
+    for (u32 i = 0; i < source_count; ++i) {
+        oit_composite_source* source = &internal_data->sources[i];
+        if (!scene_pass_weighted_blend_textures_get(internal_data->scene_pass, i, &source->accumulation.texture, &source->coverage.texture)) {
+            KERROR("Failed to get the weighted blended transparency targets of the scene pass.");
+            return false;
+        }
+
+        // Sampled texel for texel.
+        texture_map* maps[2] = {&source->accumulation, &source->coverage};
+        for (u32 m = 0; m < 2; ++m) {
+            maps[m]->filter_magnify = maps[m]->filter_minify = TEXTURE_FILTER_MODE_NEAREST;
+            maps[m]->repeat_u = maps[m]->repeat_v = maps[m]->repeat_w = TEXTURE_REPEAT_CLAMP_TO_EDGE;
+            if (!renderer_texture_map_resources_acquire(maps[m])) {
+                KERROR("Unable to acquire resources for OIT composite source '%s'.", maps[m]->texture->name);
+                return false;
+            }
+        }
+
+        shader_instance_uniform_texture_config source_textures[2] = {0};
+        source_textures[0].uniform_location = internal_data->locations.accumulation;
+        source_textures[0].texture_map_count = 1;
+        source_textures[0].texture_maps = &maps[0];
+        source_textures[1].uniform_location = internal_data->locations.coverage;
+        source_textures[1].texture_map_count = 1;
+        source_textures[1].texture_maps = &maps[1];
+        shader_instance_resource_config instance_resource_config = {0};
+        instance_resource_config.uniform_config_count = 2;
+        instance_resource_config.uniform_configs = source_textures;
+        if (!renderer_shader_instance_resources_acquire(internal_data->s, &instance_resource_config, &source->instance_id)) {
+            KERROR("Unable to acquire shader resources for OIT composite source %u.", i);
+            renderer_texture_map_resources_release(&source->accumulation);
+            renderer_texture_map_resources_release(&source->coverage);
+            return false;
+        }
+        source->render_frame_number = INVALID_ID_U64;
+        internal_data->source_count++;
+    }
+
+    return true;
+}
+
+b8 oit_composite_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    oit_composite_pass_internal_data* internal_data = self->internal_data;
+    viewport* vp = self->pass_data.vp;
+
+    renderer_active_viewport_set(vp);
+
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("OIT composite renderpass failed to start.");
+        return false;
+    }
+
+    if (internal_data->source_count) {
+        oit_composite_source* source = &internal_data->sources[p_frame_data->render_target_index % internal_data->source_count];
+        texture* t = source->accumulation.texture;
+
+        // The scene was rendered to this region of its targets, which is the viewport in use.
+        f32 width = (f32)t->width;
+        f32 height = (f32)t->height;
+        vec4 source_rect = (vec4){vp->rect.x / width, vp->rect.y / height, vp->rect.width / width, vp->rect.height / height};
+
+        shader* s = internal_data->s;
+        shader_system_use_by_id(s->id);
+        shader_system_uniform_set_by_location(internal_data->locations.source_rect, &source_rect);
+        shader_system_apply_global(true, p_frame_data);
+
+        shader_system_bind_instance(source->instance_id);
+        b8 needs_update = source->render_frame_number != p_frame_data->renderer_frame_number || source->draw_index != p_frame_data->draw_index;
+        if (needs_update) {
+            shader_system_uniform_set_by_location(internal_data->locations.accumulation, &source->accumulation);
+            shader_system_uniform_set_by_location(internal_data->locations.coverage, &source->coverage);
+        }
+        shader_system_apply_instance(needs_update, p_frame_data);
+        source->render_frame_number = p_frame_data->renderer_frame_number;
+        source->draw_index = p_frame_data->draw_index;
+
+        geometry_draw_record quad_record = {0};
+        quad_record.geometry = internal_data->quad;
+        geometry_render_data quad_data;
+        renderer_geometry_draw_record_resolve(&quad_record, 0, &quad_data);
+        renderer_geometry_draw(&quad_data);
+
+        // HACK: This should be handled somehow, every frame, by the shader system.
+        s->render_frame_number = p_frame_data->renderer_frame_number;
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("OIT composite renderpass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void oit_composite_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            oit_composite_pass_internal_data* internal_data = self->internal_data;
+
+            if (internal_data->sources) {
+                for (u32 i = 0; i < internal_data->source_count; ++i) {
+                    oit_composite_source* source = &internal_data->sources[i];
+                    renderer_shader_instance_resources_release(internal_data->s, source->instance_id);
+                    renderer_texture_map_resources_release(&source->accumulation);
+                    renderer_texture_map_resources_release(&source->coverage);
+                }
+                kfree(internal_data->sources, sizeof(oit_composite_source) * self->pass.render_target_count, MEMORY_TAG_RENDERER);
+            }
+            if (internal_data->quad) {
+                geometry_system_release(internal_data->quad);
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(oit_composite_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef _OIT_COMPOSITE_PASS_H_
+#define _OIT_COMPOSITE_PASS_H_
+
+#include "defines.h"
+
+struct rendergraph_pass;
+struct frame_data;
+
+/**
+ * @brief The configuration of an order-independent transparency composite pass, which resolves the
+ * weighted blended transparency accumulated by a scene pass over its colour. It should sink the scene
+ * pass' colour and be followed by whatever was drawn after it. Does nothing if the scene pass doesn't
+ * use weighted blended transparency.
+ */
+typedef struct oit_composite_pass_config {
+    /** @brief The scene pass whose transparency is composited. */
+    struct rendergraph_pass* scene_pass;
+} oit_composite_pass_config;
+
+b8 oit_composite_pass_create(struct rendergraph_pass* self, void* config);
+b8 oit_composite_pass_initialize(struct rendergraph_pass* self);
+b8 oit_composite_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void oit_composite_pass_destroy(struct rendergraph_pass* self);
+
+#endif
@@ -0,0 +1,591 @@
+#include "particle_pass.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "math/kmath.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "resources/particle_emitter.h"
+#include "systems/geometry_system.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+// The most emitters drawn per frame.
+#define PARTICLE_PASS_MAX_EMITTERS 64
+// The most particles of all emitters combined.
+#define PARTICLE_PASS_MAX_PARTICLES (1 << 18)
+// The number of invocations in each workgroup of the simulation shader.
+#define PARTICLE_PASS_WORKGROUP_SIZE 64
+
+// The steps of the simulation shader. Must match Shader.ParticleSimulate.
+typedef enum particle_simulate_mode {
+    // Zeroes the instance count of the emitter's draw command.
+    PARTICLE_SIMULATE_MODE_RESET = 0,
+    // Simulates, appending live particles to the instances in any order.
+    PARTICLE_SIMULATE_MODE_SIMULATE_ADDITIVE = 1,
+    // Simulates, writing a sort key for each particle.
+    PARTICLE_SIMULATE_MODE_SIMULATE_SORTED = 2,
+    // Runs one step of a bitonic sort of the keys.
+    PARTICLE_SIMULATE_MODE_SORT = 3,
+    // Writes the instances of live particles in the order of their sorted keys.
+    PARTICLE_SIMULATE_MODE_GATHER = 4,
+    // Kills every particle of the emitter's range.
+    PARTICLE_SIMULATE_MODE_CLEAR = 5
+} particle_simulate_mode;
+
+// The local uniforms of the simulation shader, pushed whole.
+typedef struct particle_simulate_block {
+    u32 mode;
+    u32 base_index;
+    u32 capacity;
+    u32 spawn_first;
+    u32 spawn_count;
+    u32 seed;
+    u32 sort_step;
+    u32 command_index;
+    u32 instance_base;
+    u32 colour_start;
+    u32 colour_end;
+    f32 delta_time;
+    f32 size_start;
+    f32 size_end;
+    f32 drag;
+    f32 spread_cos;
+    vec4 position_radius;
+    vec4 direction_lifetime_min;
+    vec4 gravity_lifetime_max;
+    vec2 speed;
+} particle_simulate_block;
+
+// The layout of the GPU copy of a particle.
+typedef struct gpu_particle {
+    vec4 position_age;
+    vec4 velocity_lifetime;
+} gpu_particle;
+
+typedef struct particle_simulate_locations {
+    u16 view_position;
+    u16 particles;
+    u16 sort_keys;
+    u16 instances;
+    u16 commands;
+} particle_simulate_locations;
+
+typedef struct particle_draw_locations {
+    u16 projection;
+    u16 view;
+} particle_draw_locations;
+
+// The range of the GPU particle buffer held by an emitter.
+typedef struct particle_pass_slot {
+    // The seed of the emitter whose particles are held. 0 if none.
+    u32 seed;
+    u32 base_index;
+    u32 capacity;
+} particle_pass_slot;
+
+// A draw of the instances of an emitter simulated on the CPU.
+typedef struct particle_cpu_draw {
+    u64 instance_offset;
+    u32 instance_count;
+} particle_cpu_draw;
+
+typedef struct particle_pass_internal_data {
+    shader* alpha_shader;
+    shader* additive_shader;
+    particle_draw_locations alpha_locations;
+    particle_draw_locations additive_locations;
+    geometry* quad;
+
+    // Each of these holds one region per render target, so a frame still in flight is never overwritten.
+    u8 region_count;
+
+    // GPU simulation. Only available if the compute shader could be created and indirect draws are supported.
+    b8 gpu_supported;
+    shader* simulate_shader;
+    particle_simulate_locations simulate_locations;
+    renderbuffer particle_buffer;
+    renderbuffer sort_key_buffer;
+    renderbuffer gpu_instance_buffer;
+    renderbuffer command_buffer;
+    particle_pass_slot slots[PARTICLE_PASS_MAX_EMITTERS];
+    // The renderer frame number the particles were last simulated on the GPU by a simulation pass.
+    u64 simulated_frame_number;
+
+    // CPU simulation. The instance buffer is only created once first needed.
+    b8 cpu_buffer_created;
+    renderbuffer cpu_instance_buffer;
+    particle_cpu_draw cpu_draws[PARTICLE_PASS_MAX_EMITTERS];
+} particle_pass_internal_data;
+
+typedef struct particle_simulate_pass_internal_data {
+    struct rendergraph_pass* particle_pass;
+} particle_simulate_pass_internal_data;
+
+static b8 particle_shader_create(struct rendergraph_pass* self, const char* name, shader** out_shader) {
+    resource config_resource;
+    if (!resource_system_load(name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", name);
+        return false;
+    }
+    b8 result = shader_system_create(&self->pass, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!result) {
+        KERROR("Failed to create shader '%s'.", name);
+        return false;
+    }
+    *out_shader = shader_system_get(name);
+    return *out_shader != 0;
+}
+
+// Creates everything needed to simulate on the GPU. Leaves gpu_supported false if it can't be.
+static void particle_pass_gpu_initialize(struct rendergraph_pass* self) {
+    particle_pass_internal_data* internal_data = self->internal_data;
+
+    if (!renderer_indirect_draw_supported()) {
+        KINFO("Indirect draws are not supported. Particles will be simulated on the CPU.");
+        return;
+    }
+    if (!particle_shader_create(self, "Shader.ParticleSimulate", &internal_data->simulate_shader)) {
+        KWARN("Particle simulation shader unavailable. Particles will be simulated on the CPU.");
+        return;
+    }
+    shader* s = internal_data->simulate_shader;
+    internal_data->simulate_locations.view_position = shader_system_uniform_location(s, "view_position");
+    internal_data->simulate_locations.particles = shader_system_uniform_location(s, "particles");
+    internal_data->simulate_locations.sort_keys = shader_system_uniform_location(s, "sort_keys");
+    internal_data->simulate_locations.instances = shader_system_uniform_location(s, "instances");
+    internal_data->simulate_locations.commands = shader_system_uniform_location(s, "commands");
+
+#define BLOCK_MEMBER(member) {#member, offsetof(particle_simulate_block, member), sizeof(((particle_simulate_block*)0)->member)}
+    const shader_local_block_member members[] = {
+        BLOCK_MEMBER(mode), BLOCK_MEMBER(base_index), BLOCK_MEMBER(capacity), BLOCK_MEMBER(spawn_first),
+        BLOCK_MEMBER(spawn_count), BLOCK_MEMBER(seed), BLOCK_MEMBER(sort_step), BLOCK_MEMBER(command_index),
+        BLOCK_MEMBER(instance_base), BLOCK_MEMBER(colour_start), BLOCK_MEMBER(colour_end), BLOCK_MEMBER(delta_time),
+        BLOCK_MEMBER(size_start), BLOCK_MEMBER(size_end), BLOCK_MEMBER(drag), BLOCK_MEMBER(spread_cos),
+        BLOCK_MEMBER(position_radius), BLOCK_MEMBER(direction_lifetime_min), BLOCK_MEMBER(gravity_lifetime_max), BLOCK_MEMBER(speed)};
+#undef BLOCK_MEMBER
+    if (!shader_system_local_block_verify(s, sizeof(members) / sizeof(shader_local_block_member), members, sizeof(particle_simulate_block))) {
+        KWARN("Particle simulation shader locals don't match particle_simulate_block. Particles will be simulated on the CPU.");
+        return;
+    }
+
+    u64 particle_size = sizeof(gpu_particle) * PARTICLE_PASS_MAX_PARTICLES;
+    u64 key_size = sizeof(u32) * 2 * PARTICLE_PASS_MAX_PARTICLES;
+    u64 instance_size = sizeof(particle_instance) * PARTICLE_PASS_MAX_PARTICLES * internal_data->region_count;
+    u64 command_size = sizeof(renderer_indirect_draw_command) * PARTICLE_PASS_MAX_EMITTERS * internal_data->region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_particles", RENDERBUFFER_TYPE_STORAGE, particle_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->particle_buffer) ||
+        !renderer_renderbuffer_create("renderbuffer_particle_sort_keys", RENDERBUFFER_TYPE_STORAGE, key_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->sort_key_buffer) ||
+        !renderer_renderbuffer_create("renderbuffer_particle_instances", RENDERBUFFER_TYPE_STORAGE, instance_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->gpu_instance_buffer) ||
+        !renderer_renderbuffer_create("renderbuffer_particle_commands", RENDERBUFFER_TYPE_STORAGE, command_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->command_buffer)) {
+        KWARN("Failed to create particle storage buffers. Particles will be simulated on the CPU.");
+        return;
+    }
+    renderer_renderbuffer_bind(&internal_data->particle_buffer, 0);
+    renderer_renderbuffer_bind(&internal_data->sort_key_buffer, 0);
+    renderer_renderbuffer_bind(&internal_data->gpu_instance_buffer, 0);
+    renderer_renderbuffer_bind(&internal_data->command_buffer, 0);
+
+    internal_data->gpu_supported = true;
+}
+
+b8 particle_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self) {
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(particle_pass_internal_data), MEMORY_TAG_RENDERER);
+    self->pass_data.ext_data = kallocate(sizeof(particle_pass_extended_data), MEMORY_TAG_RENDERER);
+    particle_pass_internal_data* internal_data = self->internal_data;
+    internal_data->simulated_frame_number = INVALID_ID_U64;
+
+    return true;
+}
+
+b8 particle_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    particle_pass_internal_data* internal_data = self->internal_data;
+
+    // Renderpass config. Drawn over the scene, tested against its depth.
+    renderpass_config particle_pass_config = {0};
+    particle_pass_config.name = "Renderpass.Testbed.Particles";
+    particle_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    particle_pass_config.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
+    particle_pass_config.depth = 1.0f;
+    particle_pass_config.stencil = 0;
+    particle_pass_config.target.attachment_count = 2;
+    particle_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * particle_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    particle_pass_config.render_target_count = renderer_window_attachment_count_get();
+
+    // Colour attachment
+    render_target_attachment_config* particle_target_colour = &particle_pass_config.target.attachments[0];
+    particle_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+    particle_target_colour->source = rendergraph_pass_colour_source(self);
+    particle_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    particle_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    particle_target_colour->present_after = false;
+
+    // Depth attachment
+    render_target_attachment_config* particle_target_depth = &particle_pass_config.target.attachments[1];
+    particle_target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    particle_target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    particle_target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    particle_target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    particle_target_depth->present_after = false;
+
+    if (!renderer_renderpass_create(&particle_pass_config, &self->pass)) {
+        KERROR("Failed to create particle renderpass.");
+        return false;
+    }
+
+    if (!particle_shader_create(self, "Shader.Particle", &internal_data->alpha_shader) ||
+        !particle_shader_create(self, "Shader.ParticleAdditive", &internal_data->additive_shader)) {
+        return false;
+    }
+    internal_data->alpha_locations.projection = shader_system_uniform_location(internal_data->alpha_shader, "projection");
+    internal_data->alpha_locations.view = shader_system_uniform_location(internal_data->alpha_shader, "view");
+    internal_data->additive_locations.projection = shader_system_uniform_location(internal_data->additive_shader, "projection");
+    internal_data->additive_locations.view = shader_system_uniform_location(internal_data->additive_shader, "view");
+
+    // Every particle is a unit quad, sized and faced toward the camera by the vertex shader.
+    geometry_config quad_config = {0};
+    generate_quad_2d("particle_quad", 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, &quad_config);
+    internal_data->quad = geometry_system_acquire_from_config(quad_config, true);
+    geometry_system_config_dispose(&quad_config);
+    if (!internal_data->quad) {
+        KERROR("Failed to create particle quad geometry.");
+        return false;
+    }
+
+    internal_data->region_count = renderer_window_attachment_count_get();
+    particle_pass_gpu_initialize(self);
+
+    return true;
+}
+
+// Packs a colour as 4 normalized bytes, as read by unpackUnorm4x8.
+static u32 colour_pack(vec4 colour) {
+    u32 r = (u32)(KCLAMP(colour.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 g = (u32)(KCLAMP(colour.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 b = (u32)(KCLAMP(colour.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 a = (u32)(KCLAMP(colour.a, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void simulate_dispatch(particle_simulate_block* block, particle_simulate_mode mode, u32 group_count) {
+    block->mode = mode;
+    shader_system_local_block_push(block, sizeof(particle_simulate_block));
+    shader_system_dispatch(group_count, 1, 1);
+}
+
+// Simulates every emitter with the compute shader, writing this frame's instances and draw commands.
+static b8 particle_pass_simulate_gpu(struct rendergraph_pass* self, u32 emitter_count, particle_emitter* emitters, u32 region, struct frame_data* p_frame_data) {
+    particle_pass_internal_data* internal_data = self->internal_data;
+    particle_simulate_locations* locations = &internal_data->simulate_locations;
+
+    shader_system_use_by_id(internal_data->simulate_shader->id);
+    vec4 view_position = vec4_from_vec3(self->pass_data.view_position, 1.0f);
+    shader_system_uniform_set_by_location(locations->view_position, &view_position);
+    if (!shader_system_storage_buffer_set_by_location(locations->particles, &internal_data->particle_buffer) ||
+        !shader_system_storage_buffer_set_by_location(locations->sort_keys, &internal_data->sort_key_buffer) ||
+        !shader_system_storage_buffer_set_by_location(locations->instances, &internal_data->gpu_instance_buffer) ||
+        !shader_system_storage_buffer_set_by_location(locations->commands, &internal_data->command_buffer)) {
+        KERROR("Failed to set particle storage buffers.");
+        return false;
+    }
+    shader_system_apply_global(true, p_frame_data);
+
+    u32 base_index = 0;
+    for (u32 i = 0; i < emitter_count; ++i) {
+        particle_emitter* e = &emitters[i];
+        const particle_emitter_config* config = &e->config;
+        particle_pass_slot* slot = &internal_data->slots[i];
+
+        particle_simulate_block block = {0};
+        block.base_index = base_index;
+        block.capacity = e->capacity;
+        block.spawn_first = e->spawn_first;
+        block.spawn_count = e->spawn_count;
+        block.seed = particle_emitter_frame_seed(e);
+        block.command_index = (region * PARTICLE_PASS_MAX_EMITTERS) + i;
+        block.instance_base = (region * PARTICLE_PASS_MAX_PARTICLES) + base_index;
+        block.colour_start = colour_pack(config->colour_start);
+        block.colour_end = colour_pack(config->colour_end);
+        block.delta_time = e->delta_time;
+        block.size_start = config->size_start;
+        block.size_end = config->size_end;
+        block.drag = config->drag;
+        block.spread_cos = kcos(KCLAMP(config->spread, 0.0f, K_PI));
+        block.position_radius = vec4_from_vec3(e->position, config->spawn_radius);
+        block.direction_lifetime_min = vec4_from_vec3(config->direction, config->lifetime_min);
+        block.gravity_lifetime_max = vec4_from_vec3(config->gravity, config->lifetime_max);
+        block.speed = (vec2){config->speed_min, config->speed_max};
+
+        u32 group_count = e->capacity / PARTICLE_PASS_WORKGROUP_SIZE;
+
+        // The range held garbage or another emitter's particles.
+        if (slot->seed != e->seed || slot->base_index != base_index || slot->capacity != e->capacity) {
+            simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_CLEAR, group_count);
+            slot->seed = e->seed;
+            slot->base_index = base_index;
+            slot->capacity = e->capacity;
+        }
+
+        simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_RESET, 1);
+        if (config->blend == PARTICLE_BLEND_MODE_ADDITIVE) {
+            simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_SIMULATE_ADDITIVE, group_count);
+        } else {
+            simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_SIMULATE_SORTED, group_count);
+            // A bitonic sort of the whole range, one dispatch per step.
+            u32 capacity_log2 = 0;
+            while ((1u << capacity_log2) < e->capacity) {
+                capacity_log2++;
+            }
+            for (u32 k_log2 = 1; k_log2 <= capacity_log2; ++k_log2) {
+                for (i32 j_log2 = (i32)k_log2 - 1; j_log2 >= 0; --j_log2) {
+                    block.sort_step = (u32)j_log2 | (k_log2 << 8);
+                    simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_SORT, group_count);
+                }
+            }
+            simulate_dispatch(&block, PARTICLE_SIMULATE_MODE_GATHER, group_count);
+        }
+
+        base_index += e->capacity;
+    }
+
+    return true;
+}
+
+// Simulates every emitter on the CPU, uploading this frame's instances.
+static b8 particle_pass_simulate_cpu(struct rendergraph_pass* self, u32 emitter_count, particle_emitter* emitters, u32 region, struct frame_data* p_frame_data) {
+    particle_pass_internal_data* internal_data = self->internal_data;
+
+    if (!internal_data->cpu_buffer_created) {
+        u64 size = sizeof(particle_instance) * PARTICLE_PASS_MAX_PARTICLES * internal_data->region_count;
+        if (!renderer_renderbuffer_create("renderbuffer_instancebuffer_particles", RENDERBUFFER_TYPE_INSTANCE, size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->cpu_instance_buffer)) {
+            KERROR("Failed to create particle instance buffer.");
+            return false;
+        }
+        renderer_renderbuffer_bind(&internal_data->cpu_instance_buffer, 0);
+        internal_data->cpu_buffer_created = true;
+    }
+
+    u32 total_count = 0;
+    for (u32 i = 0; i < emitter_count; ++i) {
+        total_count += emitters[i].capacity;
+    }
+    particle_instance* instances = p_frame_data->allocator.allocate(sizeof(particle_instance) * KMAX(total_count, 1));
+
+    u32 written = 0;
+    for (u32 i = 0; i < emitter_count; ++i) {
+        particle_emitter* e = &emitters[i];
+        particle_emitter_simulate_cpu(e);
+        u32 count = particle_emitter_instances_write(e, self->pass_data.view_position, e->capacity, instances + written);
+        internal_data->cpu_draws[i].instance_offset = sizeof(particle_instance) * ((u64)region * PARTICLE_PASS_MAX_PARTICLES + written);
+        internal_data->cpu_draws[i].instance_count = count;
+        written += count;
+    }
+
+    if (written) {
+        u64 region_offset = sizeof(particle_instance) * (u64)region * PARTICLE_PASS_MAX_PARTICLES;
+        if (!renderer_renderbuffer_load_range(&internal_data->cpu_instance_buffer, region_offset, sizeof(particle_instance) * written, instances)) {
+            KERROR("Failed to upload particle instance data.");
+            return false;
+        }
+    }
+    return true;
+}
+
+// The number of emitters which fit within the limits. Emitters beyond them are not drawn.
+static u32 particle_pass_emitter_count_get(const particle_pass_extended_data* ext_data) {
+    u32 emitter_count = KMIN(ext_data->emitter_count, PARTICLE_PASS_MAX_EMITTERS);
+    u32 particle_count = 0;
+    for (u32 i = 0; i < emitter_count; ++i) {
+        if (particle_count + ext_data->emitters[i].capacity > PARTICLE_PASS_MAX_PARTICLES) {
+            return i;
+        }
+        particle_count += ext_data->emitters[i].capacity;
+    }
+    return emitter_count;
+}
+
+b8 particle_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    particle_pass_internal_data* internal_data = self->internal_data;
+    particle_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    u32 emitter_count = particle_pass_emitter_count_get(ext_data);
+    if (emitter_count < ext_data->emitter_count) {
+        KWARN("Only the first %u of %u particle emitters fit within %u particles. The rest will not be drawn.", emitter_count, ext_data->emitter_count, PARTICLE_PASS_MAX_PARTICLES);
+    }
+
+    u32 region = p_frame_data->render_target_index % internal_data->region_count;
+    b8 use_gpu = ext_data->gpu_simulation && internal_data->gpu_supported;
+    // A simulation pass may have already simulated this frame's particles.
+    b8 simulated_already = use_gpu && internal_data->simulated_frame_number == p_frame_data->renderer_frame_number;
+
+    // Simulation is done before the renderpass begins, since compute can't run within one.
+    if (emitter_count && !simulated_already) {
+        b8 simulated = use_gpu ? particle_pass_simulate_gpu(self, emitter_count, ext_data->emitters, region, p_frame_data)
+                               : particle_pass_simulate_cpu(self, emitter_count, ext_data->emitters, region, p_frame_data);
+        if (!simulated) {
+            KERROR("Failed to simulate particles. Render frame failed.");
+            return false;
+        }
+    }
+
+    // Bind the viewport
+    renderer_active_viewport_set(self->pass_data.vp);
+
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("particle renderpass failed to start.");
+        return false;
+    }
+
+    geometry_draw_record quad_record = {0};
+    quad_record.geometry = internal_data->quad;
+    geometry_render_data quad_data;
+    renderer_geometry_draw_record_resolve(&quad_record, 0, &quad_data);
+
+    // Alpha-blended emitters first, so additive ones brighten them rather than being covered.
+    for (u32 pass_blend = 0; pass_blend < 2 && emitter_count; ++pass_blend) {
+        particle_blend_mode blend = pass_blend == 0 ? PARTICLE_BLEND_MODE_ALPHA : PARTICLE_BLEND_MODE_ADDITIVE;
+        shader* s = blend == PARTICLE_BLEND_MODE_ALPHA ? internal_data->alpha_shader : internal_data->additive_shader;
+        particle_draw_locations* locations = blend == PARTICLE_BLEND_MODE_ALPHA ? &internal_data->alpha_locations : &internal_data->additive_locations;
+
+        b8 shader_bound = false;
+        for (u32 i = 0; i < emitter_count; ++i) {
+            if (ext_data->emitters[i].config.blend != blend) {
+                continue;
+            }
+            if (!use_gpu && !internal_data->cpu_draws[i].instance_count) {
+                continue;
+            }
+
+            if (!shader_bound) {
+                shader_system_use_by_id(s->id);
+                shader_system_uniform_set_by_location(locations->projection, &self->pass_data.projection_matrix);
+                shader_system_uniform_set_by_location(locations->view, &self->pass_data.view_matrix);
+                shader_system_apply_global(true, p_frame_data);
+                shader_bound = true;
+            }
+
+            if (use_gpu) {
+                // The instance count is only known to the GPU, which wrote it into the command.
+                u64 command_offset = sizeof(renderer_indirect_draw_command) * ((region * PARTICLE_PASS_MAX_EMITTERS) + i);
+                if (!renderer_geometry_draw_indirect_instanced(&quad_data, &internal_data->gpu_instance_buffer, 0, &internal_data->command_buffer, command_offset)) {
+                    KERROR("Failed to draw particles.");
+                }
+            } else {
+                renderer_geometry_draw_instanced(&quad_data, &internal_data->cpu_instance_buffer, internal_data->cpu_draws[i].instance_offset, internal_data->cpu_draws[i].instance_count);
+            }
+        }
+        if (shader_bound) {
+            // HACK: This should be handled somehow, every frame, by the shader system.
+            s->render_frame_number = p_frame_data->renderer_frame_number;
+        }
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("particle renderpass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void particle_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            particle_pass_internal_data* internal_data = self->internal_data;
+
+            if (internal_data->gpu_supported) {
+                renderer_renderbuffer_destroy(&internal_data->particle_buffer);
+                renderer_renderbuffer_destroy(&internal_data->sort_key_buffer);
+                renderer_renderbuffer_destroy(&internal_data->gpu_instance_buffer);
+                renderer_renderbuffer_destroy(&internal_data->command_buffer);
+            }
+            if (internal_data->cpu_buffer_created) {
+                renderer_renderbuffer_destroy(&internal_data->cpu_instance_buffer);
+            }
+            if (internal_data->quad) {
+                geometry_system_release(internal_data->quad);
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(particle_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
+
+b8 particle_simulate_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self || !config) {
+        KERROR("particle_simulate_pass_create requires a pointer to the pass and its configuration.");
+        return false;
+    }
+
+    particle_simulate_pass_config* typed_config = config;
+    if (!typed_config->particle_pass) {
+        KERROR("particle_simulate_pass_create requires the particle pass it simulates.");
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(particle_simulate_pass_internal_data), MEMORY_TAG_RENDERER);
+    particle_simulate_pass_internal_data* internal_data = self->internal_data;
+    internal_data->particle_pass = typed_config->particle_pass;
+
+    // Only dispatches compute work, and only the particle pass consumes it.
+    self->async_compute = true;
+
+    return true;
+}
+
+b8 particle_simulate_pass_initialize(struct rendergraph_pass* self) {
+    // Everything it uses belongs to the particle pass.
+    return self != 0;
+}
+
+b8 particle_simulate_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    particle_simulate_pass_internal_data* internal_data = self->internal_data;
+    struct rendergraph_pass* particle_pass = internal_data->particle_pass;
+    particle_pass_internal_data* particle_data = particle_pass->internal_data;
+    particle_pass_extended_data* ext_data = particle_pass->pass_data.ext_data;
+
+    // Simulating on the CPU is left to the particle pass.
+    if (!particle_pass->pass_data.do_execute || !ext_data->gpu_simulation || !particle_data->gpu_supported) {
+        return true;
+    }
+
+    u32 emitter_count = particle_pass_emitter_count_get(ext_data);
+    if (emitter_count) {
+        u32 region = p_frame_data->render_target_index % particle_data->region_count;
+        if (!particle_pass_simulate_gpu(particle_pass, emitter_count, ext_data->emitters, region, p_frame_data)) {
+            KERROR("Failed to simulate particles. Render frame failed.");
+            return false;
+        }
+    }
+    particle_data->simulated_frame_number = p_frame_data->renderer_frame_number;
+
+    return true;
+}
+
+void particle_simulate_pass_destroy(struct rendergraph_pass* self) {
+    if (self && self->internal_data) {
+        kfree(self->internal_data, sizeof(particle_simulate_pass_internal_data), MEMORY_TAG_RENDERER);
+        self->internal_data = 0;
+    }
+}
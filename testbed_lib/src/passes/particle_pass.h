@@ -0,0 +1,41 @@
+#ifndef _PARTICLE_PASS_H_
+#define _PARTICLE_PASS_H_
+
+#include "defines.h"
+
+struct rendergraph_pass;
+struct frame_data;
+
+struct particle_emitter;
+
+typedef struct particle_pass_extended_data {
+    u32 emitter_count;
+    // The emitters to simulate and draw, already updated for this frame.
+    struct particle_emitter* emitters;
+    // Simulate on the GPU with compute shaders and draw indirectly. Falls back to simulating on
+    // the CPU when unsupported.
+    b8 gpu_simulation;
+} particle_pass_extended_data;
+
+/**
+ * @brief The configuration of a particle simulation pass, which runs the GPU simulation of a particle
+ * pass as its own async compute pass, so it may overlap the graphics work before the particles are
+ * drawn. The particle pass should sink its source. Does nothing when particles are simulated on the CPU,
+ * in which case the particle pass still simulates them itself.
+ */
+typedef struct particle_simulate_pass_config {
+    /** @brief The particle pass whose particles are simulated. */
+    struct rendergraph_pass* particle_pass;
+} particle_simulate_pass_config;
+
+b8 particle_pass_create(struct rendergraph_pass* self, void* config);
+b8 particle_pass_initialize(struct rendergraph_pass* self);
+b8 particle_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void particle_pass_destroy(struct rendergraph_pass* self);
+
+b8 particle_simulate_pass_create(struct rendergraph_pass* self, void* config);
+b8 particle_simulate_pass_initialize(struct rendergraph_pass* self);
+b8 particle_simulate_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void particle_simulate_pass_destroy(struct rendergraph_pass* self);
+
+#endif
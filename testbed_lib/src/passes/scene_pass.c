@@ -10,10 +10,24 @@
 #include "renderer/renderer_frontend.h"
 #include "renderer/rendergraph.h"
 #include "resources/resource_types.h"
+#include "resources/terrain.h"
 #include "systems/material_system.h"
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 
+// The maximum number of static mesh instances which can be drawn per frame.
+#define SCENE_PASS_MAX_INSTANCES 16384
+
+// The maximum number of vertex-pulled terrain chunks which can be drawn per frame.
+#define SCENE_PASS_MAX_TERRAIN_PATCHES 4096
+
+// The indices of the weighted blended transparency attachments, when used. Depth follows them.
+#define SCENE_PASS_ACCUMULATION_ATTACHMENT 1
+#define SCENE_PASS_COVERAGE_ATTACHMENT 2
+
+// The number of vertices of each occlusion queried box, two triangles per face.
+#define SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT 36
+
 typedef struct debug_shader_locations {
     u16 projection;
     u16 view;
@@ -22,18 +36,213 @@ typedef struct debug_shader_locations {
 
 typedef struct scene_pass_internal_data {
     shader* pbr_shader;
+    // Indicates if depth is loaded from a depth prepass.
+    b8 depth_prepass;
+    // Location of the PBR shader's scene object storage buffer.
+    u16 pbr_scene_objects_location;
+    // Location of the PBR shader's material parameter storage buffer.
+    u16 pbr_materials_location;
     shader* terrain_shader;
+    // Draws vertex-pulled terrains from their heightmaps.
+    shader* terrain_heightmap_shader;
     shader* colour_shader;
     debug_shader_locations debug_locations;
+    // Draws the boxes of occlusion queries, writing nothing.
+    shader* occlusion_query_shader;
+    u16 occlusion_query_projection_location;
+    u16 occlusion_query_view_location;
 
     rendergraph_source* shadowmap_source;
+    // The point light shadow atlases, if hooked up. Optional, as not every graph shadows point lights.
+    rendergraph_source* point_shadowmap_source;
     // One per frame.
     u32 frame_count;
 
     // One per frame.
     texture_map* shadow_maps;
+
+    // Per-instance scene object indices for static geometries. Holds one region of
+    // SCENE_PASS_MAX_INSTANCES per render target, so a frame still in flight is never overwritten.
+    renderbuffer instance_buffer;
+    u8 instance_region_count;
+
+    // Indirect draw commands for static geometries, with the same per-render-target regions.
+    renderbuffer indirect_buffer;
+
+    // Per-instance data of vertex-pulled terrain chunks, with the same per-render-target regions
+    // of SCENE_PASS_MAX_TERRAIN_PATCHES.
+    renderbuffer terrain_patch_buffer;
+
+    // The world-space triangles of the occlusion queried boxes, with the same per-render-target
+    // regions of RENDERER_MAX_OCCLUSION_QUERIES boxes.
+    renderbuffer occlusion_box_buffer;
+
+    // Indicates transparent geometries are accumulated for weighted blended transparency.
+    b8 weighted_blended;
+    // The weighted blended transparency targets, one of each per render target. 0 if unused.
+    // Transient attachments from the renderer's pool, so scene passes of the same size share them.
+    u32 weighted_blend_texture_count;
+    texture** accumulation_textures;
+    texture** coverage_textures;
 } scene_pass_internal_data;
 
+static b8 geometry_draw_record_same_bucket(const geometry_draw_record* a, const geometry_draw_record* b) {
+    return a->geometry->material == b->geometry->material && a->winding_inverted == b->winding_inverted && a->geometry->vertex_format == b->geometry->vertex_format;
+}
+
+static b8 geometry_draw_record_instanceable(const geometry_draw_record* a, const geometry_draw_record* b) {
+    return a->geometry == b->geometry && a->lod == b->lod && a->winding_inverted == b->winding_inverted &&
+           a->first_index == b->first_index && a->index_count == b->index_count;
+}
+
+// Returns the length of the run of identical geometries (an instance batch) beginning at start.
+static u32 instance_batch_length(const geometry_draw_record* records, u32 start, u32 count) {
+    u32 length = 1;
+    while (start + length < count && geometry_draw_record_instanceable(&records[start], &records[start + length])) {
+        length++;
+    }
+    return length;
+}
+
+// Draws the static geometries in [start, end), batching runs of identical geometries and, when
+// supported, each material bucket as a single indirect draw.
+static void static_geometries_draw(scene_pass_internal_data* internal_data, scene_pass_extended_data* ext_data, struct frame_data* p_frame_data, u32 start, u32 end, u64 region_offset, u64 indirect_region_offset, renderer_indirect_draw* draws, geometry_vertex_format* current_vertex_format) {
+    b8 use_indirect = draws != 0;
+    u32 current_material_id = INVALID_ID - 1;
+    // Draw geometries. Runs of geometries sharing the same geometry, material and winding
+    // (grouped together by the scene query) are drawn as a single instanced batch.
+    u32 i = start;
+    while (i < end) {
+        const geometry_draw_record* record = &ext_data->geometries[i];
+        u32 first_instance = i;
+        u32 instance_count = instance_batch_length(ext_data->geometries, i, end);
+        i += instance_count;
+
+        // Transforms come from the object buffer, so no model is needed.
+        geometry_render_data batch_data;
+        renderer_geometry_draw_record_resolve(record, 0, &batch_data);
+        geometry_render_data* batch = &batch_data;
+
+        material* m = 0;
+        if (batch->material) {
+            m = batch->material;
+        } else {
+            m = material_system_get_default();
+        }
+
+        // Only rebind/update the material if it's a new material. Duplicates can reuse the already-bound material.
+        if (m->internal_id != current_material_id) {
+            // Update the material if it hasn't already been this frame. This keeps the
+            // same material from being updated multiple times. It still needs to be bound
+            // either way, so this check result gets passed to the backend which either
+            // updates the internal shader bindings and binds them, or only binds them.
+            // Also need to check against the draw index.
+            b8 needs_update = m->render_frame_number != p_frame_data->renderer_frame_number || m->render_draw_index != p_frame_data->draw_index;
+            if (!material_system_apply_instance(m, p_frame_data, needs_update)) {
+                KWARN("Failed to apply material '%s'. Skipping draw.", m->name);
+                continue;
+            } else {
+                // Sync the frame number and draw index.
+                m->render_frame_number = p_frame_data->renderer_frame_number;
+                m->render_draw_index = p_frame_data->draw_index;
+            }
+            current_material_id = m->internal_id;
+        }
+
+        // Switch vertex formats if needed.
+        if (batch->vertex_format != *current_vertex_format) {
+            if (!shader_system_vertex_format_set(batch->vertex_format)) {
+                KWARN("Failed to set vertex format for material '%s'. Skipping draw.", m->name);
+                continue;
+            }
+            *current_vertex_format = batch->vertex_format;
+        }
+
+        // Invert if needed
+        if (batch->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
+        }
+
+        if (use_indirect && batch->index_count) {
+            // Gather the rest of the material bucket.
+            u32 draw_count = 0;
+            draws[draw_count++] = (renderer_indirect_draw){record, instance_count, first_instance};
+            while (i < end && geometry_draw_record_same_bucket(record, &ext_data->geometries[i]) && ext_data->geometries[i].geometry->index_count) {
+                u32 n = instance_batch_length(ext_data->geometries, i, end);
+                draws[draw_count++] = (renderer_indirect_draw){&ext_data->geometries[i], n, i};
+                i += n;
+            }
+
+            // Draw the bucket. Object indices come from the instance buffer, indexed by first instance.
+            renderer_renderbuffer_draw(&internal_data->instance_buffer, region_offset, 0, true);
+            u64 indirect_offset = indirect_region_offset + (sizeof(renderer_indirect_draw_command) * first_instance);
+            if (!renderer_geometry_draw_indirect(draw_count, draws, &internal_data->indirect_buffer, indirect_offset)) {
+                KWARN("Failed to draw material bucket for '%s'.", m->name);
+            }
+        } else {
+            // Draw the batch. Object indices come from the instance buffer.
+            u64 instance_offset = region_offset + (sizeof(u32) * first_instance);
+            renderer_geometry_draw_instanced(batch, &internal_data->instance_buffer, instance_offset, instance_count);
+        }
+
+        // Change back if needed
+        if (batch->winding_inverted) {
+            renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
+        }
+    }
+}
+
+// Draws each of the frame's occlusion queried boxes within the query of its index. Depth is
+// tested against what has been drawn so far, but nothing is written.
+static b8 occlusion_queries_draw(struct rendergraph_pass* self, scene_pass_internal_data* internal_data, scene_pass_extended_data* ext_data, struct frame_data* p_frame_data) {
+    u32 box_count = KMIN(ext_data->occlusion_query_count, RENDERER_MAX_OCCLUSION_QUERIES);
+    if (!box_count || !ext_data->occlusion_query_boxes) {
+        return true;
+    }
+
+    // Two triangles per face, in either winding, as neither face is culled.
+    static const u8 box_indices[SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT] = {
+        0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5,
+        0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6,
+        0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+    u64 box_size = sizeof(vec3) * SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT;
+    vec3* vertices = p_frame_data->allocator.allocate(box_size * box_count);
+    for (u32 i = 0; i < box_count; ++i) {
+        const extents_3d* box = &ext_data->occlusion_query_boxes[i];
+        vec3 corners[8];
+        for (u32 c = 0; c < 8; ++c) {
+            corners[c] = (vec3){(c & 1) ? box->max.x : box->min.x, (c & 2) ? box->max.y : box->min.y, (c & 4) ? box->max.z : box->min.z};
+        }
+        for (u32 v = 0; v < SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT; ++v) {
+            vertices[i * SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT + v] = corners[box_indices[v]];
+        }
+    }
+
+    // Upload to this render target's region, so boxes of a frame in flight aren't overwritten.
+    u64 region_offset = box_size * RENDERER_MAX_OCCLUSION_QUERIES * (p_frame_data->render_target_index % internal_data->instance_region_count);
+    if (!renderer_renderbuffer_load_range(&internal_data->occlusion_box_buffer, region_offset, box_size * box_count, vertices)) {
+        KERROR("Failed to upload occlusion query boxes. Render frame failed.");
+        return false;
+    }
+
+    if (!shader_system_use_by_id(internal_data->occlusion_query_shader->id)) {
+        KERROR("Failed to use occlusion query shader. Render frame failed.");
+        return false;
+    }
+    shader_system_uniform_set_by_location(internal_data->occlusion_query_projection_location, &self->pass_data.projection_matrix);
+    shader_system_uniform_set_by_location(internal_data->occlusion_query_view_location, &self->pass_data.view_matrix);
+    shader_system_apply_global(true, p_frame_data);
+
+    for (u32 i = 0; i < box_count; ++i) {
+        if (!renderer_occlusion_query_begin(i)) {
+            continue;
+        }
+        renderer_renderbuffer_draw(&internal_data->occlusion_box_buffer, region_offset + box_size * i, SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT, false);
+        renderer_occlusion_query_end();
+    }
+    return true;
+}
+
 b8 scene_pass_create(struct rendergraph_pass* self, void* config) {
     if (!self) {
         return false;
@@ -42,6 +251,18 @@ b8 scene_pass_create(struct rendergraph_pass* self, void* config) {
     self->internal_data = kallocate(sizeof(scene_pass_internal_data), MEMORY_TAG_RENDERER);
     self->pass_data.ext_data = kallocate(sizeof(scene_pass_extended_data), MEMORY_TAG_RENDERER);
 
+    if (config) {
+        scene_pass_config* typed_config = config;
+        scene_pass_internal_data* internal_data = self->internal_data;
+        internal_data->depth_prepass = typed_config->depth_prepass;
+        // Only requested for now. Whether it is supported is known once the renderer is up.
+        internal_data->weighted_blended = typed_config->weighted_blended_transparency;
+    }
+
+    // Custom function pointers, for the weighted blended transparency targets.
+    self->attachment_textures_regenerate = scene_pass_attachment_textures_regenerate;
+    self->attachment_populate = scene_pass_attachment_populate;
+
     return true;
 }
 
@@ -51,35 +272,60 @@ b8 scene_pass_initialize(struct rendergraph_pass* self) {
     }
 
     scene_pass_internal_data* internal_data = self->internal_data;
+    if (internal_data->weighted_blended && !renderer_weighted_blend_supported()) {
+        KINFO("Weighted blended transparency is not supported by the renderer. Transparent geometries will be sorted and blended instead.");
+        internal_data->weighted_blended = false;
+    }
 
     // Renderpass config - scene.
-    renderpass_config scene_pass_config = {0};
-    scene_pass_config.name = "Renderpass.World";
-    scene_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.2f, 1.0f};
-    scene_pass_config.clear_flags = RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG | RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG;
-    scene_pass_config.depth = 1.0f;
-    scene_pass_config.stencil = 0;
-    scene_pass_config.target.attachment_count = 2;
-    scene_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * scene_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
-    scene_pass_config.render_target_count = renderer_window_attachment_count_get();
+    renderpass_config world_pass_config = {0};
+    world_pass_config.name = "Renderpass.World";
+    world_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.2f, 1.0f};
+    // Depth is cleared by the depth prepass when there is one.
+    world_pass_config.clear_flags = internal_data->depth_prepass ? RENDERPASS_CLEAR_NONE_FLAG : (RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG | RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG);
+    world_pass_config.depth = 1.0f;
+    world_pass_config.stencil = 0;
+    world_pass_config.target.attachment_count = internal_data->weighted_blended ? 4 : 2;
+    world_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * world_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    world_pass_config.render_target_count = renderer_window_attachment_count_get();
 
     // Colour attachment
-    render_target_attachment_config* scene_target_colour = &scene_pass_config.target.attachments[0];
+    render_target_attachment_config* scene_target_colour = &world_pass_config.target.attachments[0];
     scene_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
-    scene_target_colour->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    scene_target_colour->source = rendergraph_pass_colour_source(self);
     scene_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
     scene_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
     scene_target_colour->present_after = false;
 
+    if (internal_data->weighted_blended) {
+        // Weighted blended transparency targets, owned by the pass. Cleared to zero and sampled by
+        // the composite afterward, regardless of how the colour is used.
+        render_target_attachment_config* accumulation = &world_pass_config.target.attachments[SCENE_PASS_ACCUMULATION_ATTACHMENT];
+        accumulation->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+        accumulation->source = RENDER_TARGET_ATTACHMENT_SOURCE_SELF;
+        accumulation->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_CLEAR;
+        accumulation->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+        accumulation->format = TEXTURE_FORMAT_RGBA16F;
+        accumulation->usage = RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED;
+
+        render_target_attachment_config* coverage = &world_pass_config.target.attachments[SCENE_PASS_COVERAGE_ATTACHMENT];
+        *coverage = *accumulation;
+        coverage->format = TEXTURE_FORMAT_R16F;
+
+        internal_data->weighted_blend_texture_count = world_pass_config.render_target_count;
+        internal_data->accumulation_textures = kallocate(sizeof(texture*) * internal_data->weighted_blend_texture_count, MEMORY_TAG_RENDERER);
+        internal_data->coverage_textures = kallocate(sizeof(texture*) * internal_data->weighted_blend_texture_count, MEMORY_TAG_RENDERER);
+    }
+
     // Depth attachment
-    render_target_attachment_config* scene_target_depth = &scene_pass_config.target.attachments[1];
+    render_target_attachment_config* scene_target_depth = &world_pass_config.target.attachments[world_pass_config.target.attachment_count - 1];
     scene_target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
     scene_target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
-    scene_target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
+    scene_target_depth->load_operation = internal_data->depth_prepass ? RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD : RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
     scene_target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
     scene_target_depth->present_after = false;
 
-    if (!renderer_renderpass_create(&scene_pass_config, &self->pass)) {
+    if (!renderer_renderpass_create(&world_pass_config, &self->pass)) {
         KERROR("Failed to create scene renderpass ");
         return false;
     }
@@ -99,6 +345,26 @@ b8 scene_pass_initialize(struct rendergraph_pass* self) {
     resource_system_unload(&pbr_config_resource);
     // Save off a pointer to the PBR shader.
     internal_data->pbr_shader = shader_system_get(pbr_shader_name);
+    internal_data->pbr_scene_objects_location = shader_system_uniform_location(internal_data->pbr_shader, "scene_objects");
+    internal_data->pbr_materials_location = shader_system_uniform_location(internal_data->pbr_shader, "materials");
+
+    // Instance buffer for the PBR shader's per-instance scene object indices. Model matrices
+    // themselves live in the scene's persistent object buffer.
+    internal_data->instance_region_count = renderer_window_attachment_count_get();
+    u64 instance_buffer_size = sizeof(u32) * SCENE_PASS_MAX_INSTANCES * internal_data->instance_region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_instancebuffer_scene", RENDERBUFFER_TYPE_INSTANCE, instance_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->instance_buffer)) {
+        KERROR("Failed to create scene pass instance buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->instance_buffer, 0);
+
+    // Indirect buffer, with room for one command per instance in each region.
+    u64 indirect_buffer_size = sizeof(renderer_indirect_draw_command) * SCENE_PASS_MAX_INSTANCES * internal_data->instance_region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_indirectbuffer_scene", RENDERBUFFER_TYPE_INDIRECT, indirect_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->indirect_buffer)) {
+        KERROR("Failed to create scene pass indirect buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->indirect_buffer, 0);
 
     // Load terrain shader.
     const char* terrain_shader_name = "Shader.Builtin.Terrain";
@@ -116,6 +382,28 @@ b8 scene_pass_initialize(struct rendergraph_pass* self) {
     // Save off a pointer to the terrain shader.
     internal_data->terrain_shader = shader_system_get(terrain_shader_name);
 
+    // Load heightmap terrain shader.
+    const char* terrain_heightmap_shader_name = "Shader.Builtin.TerrainHeightmap";
+    resource terrain_heightmap_shader_config_resource;
+    if (!resource_system_load(terrain_heightmap_shader_name, RESOURCE_TYPE_SHADER, 0, &terrain_heightmap_shader_config_resource)) {
+        KERROR("Failed to load heightmap terrain shader resource.");
+        return false;
+    }
+    shader_config* terrain_heightmap_shader_config = (shader_config*)terrain_heightmap_shader_config_resource.data;
+    if (!shader_system_create(&self->pass, terrain_heightmap_shader_config)) {
+        KERROR("Failed to create heightmap terrain shader.");
+        return false;
+    }
+    resource_system_unload(&terrain_heightmap_shader_config_resource);
+    internal_data->terrain_heightmap_shader = shader_system_get(terrain_heightmap_shader_name);
+
+    u64 terrain_patch_buffer_size = sizeof(terrain_patch_instance) * SCENE_PASS_MAX_TERRAIN_PATCHES * internal_data->instance_region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_terrainpatchbuffer_scene", RENDERBUFFER_TYPE_INSTANCE, terrain_patch_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->terrain_patch_buffer)) {
+        KERROR("Failed to create scene pass terrain patch buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->terrain_patch_buffer, 0);
+
     // Load debug colour3d shader.
     const char* colour3d_shader_name = "Shader.Builtin.ColourShader3D";
     resource colour3d_shader_config_resource;
@@ -139,6 +427,30 @@ b8 scene_pass_initialize(struct rendergraph_pass* self) {
         internal_data->debug_locations.model = shader_system_uniform_location(internal_data->colour_shader, "model");
     }
 
+    // Load occlusion query shader.
+    const char* occlusion_query_shader_name = "Shader.OcclusionQuery";
+    resource occlusion_query_shader_config_resource;
+    if (!resource_system_load(occlusion_query_shader_name, RESOURCE_TYPE_SHADER, 0, &occlusion_query_shader_config_resource)) {
+        KERROR("Failed to load occlusion query shader resource.");
+        return false;
+    }
+    shader_config* occlusion_query_shader_config = (shader_config*)occlusion_query_shader_config_resource.data;
+    if (!shader_system_create(&self->pass, occlusion_query_shader_config)) {
+        KERROR("Failed to create occlusion query shader.");
+        return false;
+    }
+    resource_system_unload(&occlusion_query_shader_config_resource);
+    internal_data->occlusion_query_shader = shader_system_get(occlusion_query_shader_name);
+    internal_data->occlusion_query_projection_location = shader_system_uniform_location(internal_data->occlusion_query_shader, "projection");
+    internal_data->occlusion_query_view_location = shader_system_uniform_location(internal_data->occlusion_query_shader, "view");
+
+    u64 occlusion_box_buffer_size = sizeof(vec3) * SCENE_PASS_OCCLUSION_BOX_VERTEX_COUNT * RENDERER_MAX_OCCLUSION_QUERIES * internal_data->instance_region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_occlusionboxbuffer_scene", RENDERBUFFER_TYPE_DYNAMIC_VERTEX, occlusion_box_buffer_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->occlusion_box_buffer)) {
+        KERROR("Failed to create scene pass occlusion box buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->occlusion_box_buffer, 0);
+
     return true;
 }
 
@@ -156,7 +468,8 @@ b8 scene_pass_load_resources(struct rendergraph_pass* self) {
         rendergraph_sink* sink = &self->sinks[i];
         if (strings_equali(sink->name, "shadowmap")) {
             internal_data->shadowmap_source = sink->bound_source;
-            break;
+        } else if (strings_equali(sink->name, "point_shadowmap")) {
+            internal_data->point_shadowmap_source = sink->bound_source;
         }
     }
     if (!internal_data->shadowmap_source) {
@@ -199,8 +512,8 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
     scene_pass_internal_data* internal_data = self->internal_data;
     scene_pass_extended_data* ext_data = self->pass_data.ext_data;
 
-    if (!material_system_irradiance_set(ext_data->irradiance_cube_texture)) {
-        KERROR("Failed to set irradiance texture, check the properties of said texture.");
+    if (!material_system_ibl_set(ext_data->irradiance_cube_texture, ext_data->ibl_specular_cube_texture, ext_data->ibl_brdf_lut)) {
+        KERROR("Failed to set image based lighting textures, check the properties of said textures.");
     }
 
     for (u8 i = 0; i < MAX_CASCADE_COUNT; ++i) {
@@ -208,6 +521,12 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
         material_system_directional_light_space_set(light_space, i);
         material_system_shadow_map_set(internal_data->shadowmap_source->textures[p_frame_data->render_target_index], i);
     }
+    if (internal_data->point_shadowmap_source) {
+        material_system_point_shadow_map_set(internal_data->point_shadowmap_source->textures[p_frame_data->render_target_index]);
+    }
+
+    // Terrains are shaded at the rate chosen for each draw, where variable rate shading is available.
+    renderer_shading_rate current_shading_rate = RENDERER_SHADING_RATE_1X1;
 
     // Use the appropriate shader and apply the global uniforms.
     u32 terrain_count = ext_data->terrain_geometry_count;
@@ -220,6 +539,7 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
             return false;
         }
 
+        u32 current_terrain_material_id = INVALID_ID - 1;
         for (u32 i = 0; i < terrain_count; ++i) {
             material* m = 0;
             if (ext_data->terrain_geometries[i].material) {
@@ -228,22 +548,27 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
                 m = material_system_get_default_terrain();
             }
 
-            // Update the material if it hasn't already been this frame. This keeps the
-            // same material from being updated multiple times. It still needs to be bound
-            // either way, so this check result gets passed to the backend which either
-            // updates the internal shader bindings and binds them, or only binds them.
-            // Also need to check against the renderer draw index.
-            // TODO: At least for now, the entire terrain shares one material, so a lot of this
-            // should probably be moved to global (i.e. texture maps and surface properties), but
-            // leave lighting at the instance level.
-            b8 needs_update = m->render_frame_number != p_frame_data->renderer_frame_number || m->render_draw_index != p_frame_data->draw_index;
-            if (!material_system_apply_instance(m, p_frame_data, needs_update)) {
-                KWARN("Failed to apply terrain material '%s'. Skipping draw.", m->name);
-                continue;
-            } else {
-                // Sync the frame number and draw index.
-                m->render_frame_number = p_frame_data->renderer_frame_number;
-                m->render_draw_index = p_frame_data->draw_index;
+            // Chunks sharing the material of the previous one don't need it bound again.
+            if (m->internal_id != current_terrain_material_id) {
+                // Update the material if it hasn't already been this frame. This keeps the
+                // same material from being updated multiple times. It still needs to be bound
+                // either way, so this check result gets passed to the backend which either
+                // updates the internal shader bindings and binds them, or only binds them.
+                // Also need to check against the renderer draw index.
+                // TODO: At least for now, the entire terrain shares one material, so a lot of this
+                // should probably be moved to global (i.e. texture maps and surface properties), but
+                // leave lighting at the instance level.
+                b8 needs_update = m->render_frame_number != p_frame_data->renderer_frame_number || m->render_draw_index != p_frame_data->draw_index;
+                if (!material_system_apply_instance(m, p_frame_data, needs_update)) {
+                    KWARN("Failed to apply terrain material '%s'. Skipping draw.", m->name);
+                    current_terrain_material_id = INVALID_ID - 1;
+                    continue;
+                } else {
+                    // Sync the frame number and draw index.
+                    m->render_frame_number = p_frame_data->renderer_frame_number;
+                    m->render_draw_index = p_frame_data->draw_index;
+                    current_terrain_material_id = m->internal_id;
+                }
             }
 
             // Apply the locals
@@ -251,77 +576,173 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
             material_system_apply_local(m, &ext_data->terrain_geometries[i].model, p_frame_data);
 
             // Draw it.
+            if (ext_data->terrain_geometries[i].shading_rate != current_shading_rate) {
+                current_shading_rate = ext_data->terrain_geometries[i].shading_rate;
+                renderer_shading_rate_set(current_shading_rate);
+            }
             renderer_geometry_draw(&ext_data->terrain_geometries[i]);
         }
     }
 
+    // Vertex-pulled terrains.
+    u32 patch_instance_count = ext_data->terrain_patch_instance_count;
+    if (ext_data->terrain_patch_batch_count > 0 && patch_instance_count > 0) {
+        if (patch_instance_count > SCENE_PASS_MAX_TERRAIN_PATCHES) {
+            KWARN("Scene pass terrain patch count of %u exceeds the max of %u. The rest will not be drawn.", patch_instance_count, SCENE_PASS_MAX_TERRAIN_PATCHES);
+            patch_instance_count = SCENE_PASS_MAX_TERRAIN_PATCHES;
+        }
+
+        // Upload to this render target's region, so patches of a frame in flight aren't overwritten.
+        u64 patch_region_offset = sizeof(terrain_patch_instance) * SCENE_PASS_MAX_TERRAIN_PATCHES * (p_frame_data->render_target_index % internal_data->instance_region_count);
+        if (!renderer_renderbuffer_load_range(&internal_data->terrain_patch_buffer, patch_region_offset, sizeof(terrain_patch_instance) * patch_instance_count, ext_data->terrain_patch_instances)) {
+            KERROR("Failed to upload terrain patches. Render frame failed.");
+            return false;
+        }
+
+        shader_system_use_by_id(internal_data->terrain_heightmap_shader->id);
+        if (!material_system_apply_global(internal_data->terrain_heightmap_shader->id, p_frame_data, &self->pass_data.projection_matrix, &self->pass_data.view_matrix, &ext_data->cascade_splits, &self->pass_data.view_position, ext_data->render_mode)) {
+            KERROR("Failed to use apply globals for heightmap terrain shader. Render frame failed.");
+            return false;
+        }
+
+        for (u32 i = 0; i < ext_data->terrain_patch_batch_count; ++i) {
+            terrain_patch_batch* batch = &ext_data->terrain_patch_batches[i];
+            if (batch->first_instance >= patch_instance_count) {
+                continue;
+            }
+            u32 instance_count = KMIN(batch->instance_count, patch_instance_count - batch->first_instance);
+
+            // Heightmap terrain materials are never the default, as it has no heightmap.
+            material* m = batch->data.material;
+            if (!m) {
+                continue;
+            }
+            b8 needs_update = m->render_frame_number != p_frame_data->renderer_frame_number || m->render_draw_index != p_frame_data->draw_index;
+            if (!material_system_apply_instance(m, p_frame_data, needs_update)) {
+                KWARN("Failed to apply heightmap terrain material '%s'. Skipping draw.", m->name);
+                continue;
+            }
+            m->render_frame_number = p_frame_data->renderer_frame_number;
+            m->render_draw_index = p_frame_data->draw_index;
+
+            material_system_apply_local(m, &batch->data.model, p_frame_data);
+
+            u64 instance_offset = patch_region_offset + sizeof(terrain_patch_instance) * batch->first_instance;
+            if (batch->data.shading_rate != current_shading_rate) {
+                current_shading_rate = batch->data.shading_rate;
+                renderer_shading_rate_set(current_shading_rate);
+            }
+            renderer_geometry_draw_instanced(&batch->data, &internal_data->terrain_patch_buffer, instance_offset, instance_count);
+        }
+    }
+
+    // Everything else is shaded at the full rate.
+    if (current_shading_rate != RENDERER_SHADING_RATE_1X1) {
+        renderer_shading_rate_set(RENDERER_SHADING_RATE_1X1);
+    }
+
     // Static geometries.
+    b8 occlusion_queried = false;
     u32 geometry_count = ext_data->geometry_count;
-    if (geometry_count > 0) {
+    if (geometry_count > 0 && !ext_data->object_buffer) {
+        KWARN("Scene pass has static geometries but no scene object buffer. They will not be drawn.");
+    } else if (geometry_count > 0) {
         // Update globals for material and PBR shaders.
         if (!shader_system_use_by_id(internal_data->pbr_shader->id)) {
             KERROR("Failed to use PBR shader. Render frame failed.");
             return false;
         }
 
+        // The scene's object buffer, indexed by each instance's object index.
+        if (!shader_system_storage_buffer_set_by_location(internal_data->pbr_scene_objects_location, ext_data->object_buffer)) {
+            KERROR("Failed to set scene object buffer for PBR shader. Render frame failed.");
+            return false;
+        }
+
+        // Material parameters, indexed by the material id of each scene object.
+        if (!shader_system_storage_buffer_set_by_location(internal_data->pbr_materials_location, material_system_parameter_buffer_get())) {
+            KERROR("Failed to set material parameter buffer for PBR shader. Render frame failed.");
+            return false;
+        }
+
         // Apply globals
         if (!material_system_apply_global(internal_data->pbr_shader->id, p_frame_data, &self->pass_data.projection_matrix, &self->pass_data.view_matrix, &ext_data->cascade_splits, &self->pass_data.view_position, ext_data->render_mode)) {
             KERROR("Failed to use apply globals for PBR shader. Render frame failed.");
             return false;
         }
 
-        u32 current_material_id = INVALID_ID - 1;
-        // Draw geometries.
+        // Gather all object indices into this frame's region of the instance buffer.
         u32 count = ext_data->geometry_count;
+        if (count > SCENE_PASS_MAX_INSTANCES) {
+            KWARN("Scene pass geometry count %u exceeds maximum instance count of %u. Extra geometries will not be drawn.", count, SCENE_PASS_MAX_INSTANCES);
+            count = SCENE_PASS_MAX_INSTANCES;
+        }
+        u64 region_offset = sizeof(u32) * SCENE_PASS_MAX_INSTANCES * (p_frame_data->render_target_index % internal_data->instance_region_count);
+        u32* object_indices = p_frame_data->allocator.allocate(sizeof(u32) * count);
         for (u32 i = 0; i < count; ++i) {
-            material* m = 0;
-            if (ext_data->geometries[i].material) {
-                m = ext_data->geometries[i].material;
-            } else {
-                m = material_system_get_default();
-            }
+            object_indices[i] = ext_data->geometries[i].object_index;
+        }
+        if (!renderer_renderbuffer_load_range(&internal_data->instance_buffer, region_offset, sizeof(u32) * count, object_indices)) {
+            KERROR("Failed to upload scene pass instance data. Render frame failed.");
+            return false;
+        }
 
-            // Only rebind/update the material if it's a new material. Duplicates can reuse the already-bound material.
-            if (m->internal_id != current_material_id) {
-                // Update the material if it hasn't already been this frame. This keeps the
-                // same material from being updated multiple times. It still needs to be bound
-                // either way, so this check result gets passed to the backend which either
-                // updates the internal shader bindings and binds them, or only binds them.
-                // Also need to check against the draw index.
-                b8 needs_update = m->render_frame_number != p_frame_data->renderer_frame_number || m->render_draw_index != p_frame_data->draw_index;
-                if (!material_system_apply_instance(m, p_frame_data, needs_update)) {
-                    KWARN("Failed to apply material '%s'. Skipping draw.", m->name);
-                    continue;
-                } else {
-                    // Sync the frame number and draw index.
-                    m->render_frame_number = p_frame_data->renderer_frame_number;
-                    m->render_draw_index = p_frame_data->draw_index;
-                }
-                current_material_id = m->id;
-            }
+        // Geometries already in the depth buffer are only shaded where they are the nearest surface.
+        // Only opaque geometries are drawn by the depth prepass.
+        u32 opaque_count = KMIN(ext_data->opaque_geometry_count, count);
+        b8 depth_equal = internal_data->depth_prepass && ext_data->depth_prepass_done;
+        if (depth_equal) {
+            renderer_set_depth_compare_op(RENDERER_COMPARE_OP_EQUAL);
+        }
 
-            // Apply the locals
-            material_system_apply_local(m, &ext_data->geometries[i].model, p_frame_data);
+        // When supported, each material bucket (consecutive batches sharing a material and winding)
+        // goes out as a single indirect draw. Commands are written into this frame's region of the
+        // indirect buffer, at the slot of the bucket's first instance, so buckets never overlap.
+        b8 use_indirect = renderer_indirect_draw_supported();
+        u64 indirect_region_offset = sizeof(renderer_indirect_draw_command) * SCENE_PASS_MAX_INSTANCES * (p_frame_data->render_target_index % internal_data->instance_region_count);
+        renderer_indirect_draw* draws = use_indirect ? p_frame_data->allocator.allocate(sizeof(renderer_indirect_draw) * count) : 0;
 
-            // Invert if needed
-            if (ext_data->geometries[i].winding_inverted) {
-                renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
-            }
+        // Using the shader selects the standard vertex format.
+        geometry_vertex_format current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+        static_geometries_draw(internal_data, ext_data, p_frame_data, 0, opaque_count, region_offset, indirect_region_offset, draws, &current_vertex_format);
 
-            // Draw it.
-            renderer_geometry_draw(&ext_data->geometries[i]);
+        if (depth_equal) {
+            renderer_set_depth_compare_op(RENDERER_COMPARE_OP_LESS);
+        }
 
-            // Change back if needed
-            if (ext_data->geometries[i].winding_inverted) {
-                renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
+        // Boxes are occlusion queried against the opaque geometries only, as the transparent ones
+        // don't hide what's behind them.
+        if (ext_data->occlusion_query_count > 0) {
+            if (!occlusion_queries_draw(self, internal_data, ext_data, p_frame_data)) {
+                return false;
+            }
+            occlusion_queried = true;
+            // Back to the PBR shader, with its globals as applied above.
+            if (opaque_count < count) {
+                if (!shader_system_use_by_id(internal_data->pbr_shader->id) || !shader_system_apply_global(false, p_frame_data)) {
+                    KERROR("Failed to use PBR shader. Render frame failed.");
+                    return false;
+                }
+                current_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
             }
         }
+
+        // Transparent geometries. With weighted blended transparency, they are accumulated in any order
+        // and composited afterward, otherwise they are blended in the back to front order they are sorted in.
+        if (opaque_count < count) {
+            material_system_weighted_blend_set(internal_data->weighted_blended);
+            static_geometries_draw(internal_data, ext_data, p_frame_data, opaque_count, count, region_offset, indirect_region_offset, draws, &current_vertex_format);
+            material_system_weighted_blend_set(false);
+        }
     }
 
-    // Debug geometries (i.e. grids, lines, boxes, gizmos, etc.)
-    // This goes through the same geometry system as anything else.
-    u32 debug_geometry_count = ext_data->debug_geometry_count;
-    if (debug_geometry_count > 0) {
+    // Without any static geometries, boxes are queried against the terrains alone.
+    if (!occlusion_queried && !occlusion_queries_draw(self, internal_data, ext_data, p_frame_data)) {
+        return false;
+    }
+
+    // Debug shapes (i.e. grids, lines, boxes, etc.), already in world space, in one draw.
+    if (ext_data->debug_packet.vertex_count > 0) {
         shader_system_use_by_id(internal_data->colour_shader->id);
 
         // Globals
@@ -330,15 +751,12 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
 
         shader_system_apply_global(true, p_frame_data);
 
-        // Each geometry.
-        for (u32 i = 0; i < debug_geometry_count; ++i) {
-            // NOTE: No instance-level uniforms to be set.
-
-            // Local
-            shader_system_uniform_set_by_location(internal_data->debug_locations.model, &ext_data->debug_geometries[i].model);
+        // NOTE: No instance-level uniforms to be set.
+        mat4 model = mat4_identity();
+        shader_system_uniform_set_by_location(internal_data->debug_locations.model, &model);
 
-            // Draw it.
-            renderer_geometry_draw(&ext_data->debug_geometries[i]);
+        if (!debug_draw_packet_draw(&ext_data->debug_packet)) {
+            KWARN("Failed to draw debug shapes.");
         }
 
         // HACK: This should be handled somehow, every frame, by the shader system.
@@ -363,6 +781,24 @@ void scene_pass_destroy(struct rendergraph_pass* self) {
                 renderer_texture_map_resources_release(&internal_data->shadow_maps[i]);
             }
 
+            renderer_renderbuffer_destroy(&internal_data->instance_buffer);
+            renderer_renderbuffer_destroy(&internal_data->indirect_buffer);
+            renderer_renderbuffer_destroy(&internal_data->terrain_patch_buffer);
+            renderer_renderbuffer_destroy(&internal_data->occlusion_box_buffer);
+
+            if (internal_data->weighted_blend_texture_count) {
+                for (u32 i = 0; i < internal_data->weighted_blend_texture_count; ++i) {
+                    if (internal_data->accumulation_textures[i]) {
+                        renderer_attachment_release(internal_data->accumulation_textures[i]);
+                    }
+                    if (internal_data->coverage_textures[i]) {
+                        renderer_attachment_release(internal_data->coverage_textures[i]);
+                    }
+                }
+                kfree(internal_data->accumulation_textures, sizeof(texture*) * internal_data->weighted_blend_texture_count, MEMORY_TAG_RENDERER);
+                kfree(internal_data->coverage_textures, sizeof(texture*) * internal_data->weighted_blend_texture_count, MEMORY_TAG_RENDERER);
+            }
+
             // Destroy the pass.
             renderer_renderpass_destroy(&self->pass);
             kfree(self->internal_data, sizeof(scene_pass_internal_data), MEMORY_TAG_RENDERER);
@@ -370,3 +806,71 @@ void scene_pass_destroy(struct rendergraph_pass* self) {
         }
     }
 }
+
+// Acquires the given weighted blended transparency target, or resizes it if it is held and the size changed.
+static b8 weighted_blend_texture_regenerate(texture** t, texture_format format, u8 channel_count, const char* name, u32 index, u16 width, u16 height) {
+    if (*t) {
+        renderer_attachment_resize(*t, width, height);
+        return true;
+    }
+
+    // Only written by the scene and read by the composite after it, so transient.
+    renderer_attachment_desc desc = {0};
+    desc.type = TEXTURE_TYPE_2D;
+    desc.format = format;
+    desc.width = width;
+    desc.height = height;
+    desc.channel_count = channel_count;
+    desc.transient = true;
+    desc.slot = index;
+    *t = renderer_attachment_acquire(name, &desc);
+    if (!*t) {
+        KERROR("Failed to acquire scene pass target '%s' %u.", name, index);
+        return false;
+    }
+    return true;
+}
+
+b8 scene_pass_attachment_textures_regenerate(struct rendergraph_pass* self, u16 width, u16 height) {
+    scene_pass_internal_data* internal_data = self->internal_data;
+    // NOTE: Called for each self-owned attachment of each target, so only does anything when the size changes.
+    for (u32 i = 0; i < internal_data->weighted_blend_texture_count; ++i) {
+        if (!weighted_blend_texture_regenerate(&internal_data->accumulation_textures[i], TEXTURE_FORMAT_RGBA16F, 4, "scene_oit_accumulation", i, width, height) ||
+            !weighted_blend_texture_regenerate(&internal_data->coverage_textures[i], TEXTURE_FORMAT_R16F, 1, "scene_oit_coverage", i, width, height)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+b8 scene_pass_attachment_populate(struct rendergraph_pass* self, render_target_attachment* attachment) {
+    scene_pass_internal_data* internal_data = self->internal_data;
+    for (u32 t = 0; t < internal_data->weighted_blend_texture_count; ++t) {
+        render_target* target = &self->pass.targets[t];
+        if (attachment == &target->attachments[SCENE_PASS_ACCUMULATION_ATTACHMENT]) {
+            attachment->texture = internal_data->accumulation_textures[t];
+            return true;
+        } else if (attachment == &target->attachments[SCENE_PASS_COVERAGE_ATTACHMENT]) {
+            attachment->texture = internal_data->coverage_textures[t];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+b8 scene_pass_weighted_blended(const struct rendergraph_pass* self) {
+    const scene_pass_internal_data* internal_data = self ? self->internal_data : 0;
+    return internal_data && internal_data->weighted_blend_texture_count > 0;
+}
+
+b8 scene_pass_weighted_blend_textures_get(struct rendergraph_pass* self, u32 index, struct texture** out_accumulation, struct texture** out_coverage) {
+    if (!scene_pass_weighted_blended(self) || !out_accumulation || !out_coverage) {
+        return false;
+    }
+    scene_pass_internal_data* internal_data = self->internal_data;
+    index %= internal_data->weighted_blend_texture_count;
+    *out_accumulation = internal_data->accumulation_textures[index];
+    *out_coverage = internal_data->coverage_textures[index];
+    return true;
+}
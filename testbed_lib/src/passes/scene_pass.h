@@ -4,27 +4,64 @@
 #include "defines.h"
 #include "game_state.h"
 #include "math/math_types.h"
+#include "renderer/debug_draw.h"
 
 struct rendergraph_pass;
 struct frame_data;
 struct texture;
+struct renderbuffer;
+struct render_target_attachment;
 
 struct geometry_render_data;
+struct geometry_draw_record;
+struct terrain_patch_batch;
+struct terrain_patch_instance;
+
+typedef struct scene_pass_config {
+    // If true, the depth buffer is loaded from a depth prepass instead of being cleared.
+    b8 depth_prepass;
+    // If true and supported by the renderer, transparent geometries are accumulated for weighted blended
+    // order-independent transparency, to be composited by an oit_composite_pass, rather than blended in order.
+    b8 weighted_blended_transparency;
+} scene_pass_config;
 
 typedef struct scene_pass_extended_data {
     u32 render_mode;
     vec4 cascade_splits;
 
     u32 geometry_count;
-    struct geometry_render_data* geometries;
+    struct geometry_draw_record* geometries;
+    // The number of opaque geometries, which come first. The rest are transparent.
+    u32 opaque_geometry_count;
+    // The scene's persistent object buffer, indexed by each record's object_index.
+    struct renderbuffer* object_buffer;
+    // If true, the static geometries have already been drawn to the depth buffer this frame,
+    // so only fragments matching it exactly are shaded.
+    b8 depth_prepass_done;
 
     u32 terrain_geometry_count;
     struct geometry_render_data* terrain_geometries;
 
-    u32 debug_geometry_count;
-    struct geometry_render_data* debug_geometries;
+    // The chunks of vertex-pulled terrains, drawn as instances of their shared patch. Each batch
+    // draws its run of the instances.
+    u32 terrain_patch_batch_count;
+    struct terrain_patch_batch* terrain_patch_batches;
+    u32 terrain_patch_instance_count;
+    struct terrain_patch_instance* terrain_patch_instances;
+
+    // World-space boxes drawn once the opaque geometries are, each within the occlusion query of the
+    // same index, so that what they find hidden can be skipped in later frames. At most
+    // RENDERER_MAX_OCCLUSION_QUERIES. See simple_scene_visibility_occlusion_query.
+    u32 occlusion_query_count;
+    extents_3d* occlusion_query_boxes;
+
+    // Debug shapes (grid, bounds, casts), drawn together in a single draw.
+    debug_draw_packet debug_packet;
 
     struct texture* irradiance_cube_texture;
+    // The prefiltered specular cubemap and BRDF lookup table. 0 while unavailable.
+    struct texture* ibl_specular_cube_texture;
+    struct texture* ibl_brdf_lut;
 
     mat4 directional_light_views[MAX_SHADOW_CASCADE_COUNT];
     mat4 directional_light_projections[MAX_SHADOW_CASCADE_COUNT];
@@ -35,5 +72,28 @@ b8 scene_pass_initialize(struct rendergraph_pass* self);
 b8 scene_pass_load_resources(struct rendergraph_pass* self);
 b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
 void scene_pass_destroy(struct rendergraph_pass* self);
+b8 scene_pass_attachment_textures_regenerate(struct rendergraph_pass* self, u16 width, u16 height);
+b8 scene_pass_attachment_populate(struct rendergraph_pass* self, struct render_target_attachment* attachment);
+
+/**
+ * @brief Indicates if the scene pass accumulates its transparent geometries for weighted blended
+ * transparency. Only known once the pass is initialized.
+ *
+ * @param self A pointer to the scene pass.
+ * @return True if it does; otherwise false.
+ */
+b8 scene_pass_weighted_blended(const struct rendergraph_pass* self);
+
+/**
+ * @brief Obtains the weighted blended transparency textures the scene pass accumulates into for the
+ * given render target: the weighted, premultiplied colour and alpha, and the coverage.
+ *
+ * @param self A pointer to the scene pass.
+ * @param index The index of the render target.
+ * @param out_accumulation A pointer to hold a pointer to the accumulation texture.
+ * @param out_coverage A pointer to hold a pointer to the coverage texture.
+ * @return True on success; false if the pass doesn't use weighted blended transparency.
+ */
+b8 scene_pass_weighted_blend_textures_get(struct rendergraph_pass* self, u32 index, struct texture** out_accumulation, struct texture** out_coverage);
 
 #endif
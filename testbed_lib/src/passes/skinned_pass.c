@@ -0,0 +1,225 @@
+#include "skinned_pass.h"
+
+#include "core/frame_data.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+#include "math/transform.h"
+#include "renderer/renderer_frontend.h"
+#include "renderer/rendergraph.h"
+#include "resources/simple_scene.h"
+#include "resources/skeletal_mesh.h"
+#include "systems/resource_system.h"
+#include "systems/shader_system.h"
+
+// The most skinning matrices of all skinned meshes combined.
+#define SKINNED_PASS_MAX_PALETTE_MATRICES 16384
+
+// The local uniforms of the skinned shader, pushed whole.
+typedef struct skinned_local_block {
+    mat4 model;
+    u32 palette_offset;
+} skinned_local_block;
+
+typedef struct skinned_locations {
+    u16 projection;
+    u16 view;
+    u16 light_direction;
+    u16 light_colour;
+    u16 joint_palette;
+} skinned_locations;
+
+typedef struct skinned_pass_internal_data {
+    shader* s;
+    skinned_locations locations;
+
+    // The palette buffer holds one region per render target, so a palette still in use by a frame in
+    // flight is never overwritten. 0 until the buffer is created.
+    u8 region_count;
+    renderbuffer palette_buffer;
+} skinned_pass_internal_data;
+
+b8 skinned_pass_create(struct rendergraph_pass* self, void* config) {
+    if (!self) {
+        return false;
+    }
+
+    self->internal_data = kallocate(sizeof(skinned_pass_internal_data), MEMORY_TAG_RENDERER);
+    self->pass_data.ext_data = kallocate(sizeof(skinned_pass_extended_data), MEMORY_TAG_RENDERER);
+
+    return true;
+}
+
+b8 skinned_pass_initialize(struct rendergraph_pass* self) {
+    if (!self) {
+        return false;
+    }
+
+    skinned_pass_internal_data* internal_data = self->internal_data;
+
+    // Renderpass config. Drawn into the scene, tested against and writing its depth.
+    renderpass_config skinned_pass_config = {0};
+    skinned_pass_config.name = "Renderpass.Testbed.Skinned";
+    skinned_pass_config.clear_colour = (vec4){0.0f, 0.0f, 0.0f, 1.0f};
+    skinned_pass_config.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
+    skinned_pass_config.depth = 1.0f;
+    skinned_pass_config.stencil = 0;
+    skinned_pass_config.target.attachment_count = 2;
+    skinned_pass_config.target.attachments = kallocate(sizeof(render_target_attachment_config) * skinned_pass_config.target.attachment_count, MEMORY_TAG_ARRAY);
+    skinned_pass_config.render_target_count = renderer_window_attachment_count_get();
+
+    // Colour attachment
+    render_target_attachment_config* skinned_target_colour = &skinned_pass_config.target.attachments[0];
+    skinned_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
+    skinned_target_colour->source = rendergraph_pass_colour_source(self);
+    skinned_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    skinned_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    skinned_target_colour->present_after = false;
+
+    // Depth attachment
+    render_target_attachment_config* skinned_target_depth = &skinned_pass_config.target.attachments[1];
+    skinned_target_depth->type = RENDER_TARGET_ATTACHMENT_TYPE_DEPTH;
+    skinned_target_depth->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    skinned_target_depth->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD;
+    skinned_target_depth->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
+    skinned_target_depth->present_after = false;
+
+    if (!renderer_renderpass_create(&skinned_pass_config, &self->pass)) {
+        KERROR("Failed to create skinned renderpass.");
+        return false;
+    }
+
+    const char* shader_name = "Shader.Skinned";
+    resource config_resource;
+    if (!resource_system_load(shader_name, RESOURCE_TYPE_SHADER, 0, &config_resource)) {
+        KERROR("Failed to load shader resource '%s'.", shader_name);
+        return false;
+    }
+    b8 created = shader_system_create(&self->pass, (shader_config*)config_resource.data);
+    resource_system_unload(&config_resource);
+    if (!created) {
+        KERROR("Failed to create shader '%s'.", shader_name);
+        return false;
+    }
+    internal_data->s = shader_system_get(shader_name);
+    internal_data->locations.projection = shader_system_uniform_location(internal_data->s, "projection");
+    internal_data->locations.view = shader_system_uniform_location(internal_data->s, "view");
+    internal_data->locations.light_direction = shader_system_uniform_location(internal_data->s, "light_direction");
+    internal_data->locations.light_colour = shader_system_uniform_location(internal_data->s, "light_colour");
+    internal_data->locations.joint_palette = shader_system_uniform_location(internal_data->s, "joint_palette");
+
+#define BLOCK_MEMBER(member) {#member, offsetof(skinned_local_block, member), sizeof(((skinned_local_block*)0)->member)}
+    const shader_local_block_member members[] = {BLOCK_MEMBER(model), BLOCK_MEMBER(palette_offset)};
+#undef BLOCK_MEMBER
+    if (!shader_system_local_block_verify(internal_data->s, sizeof(members) / sizeof(shader_local_block_member), members, sizeof(skinned_local_block))) {
+        KERROR("Skinned shader locals don't match skinned_local_block.");
+        return false;
+    }
+
+    u8 region_count = renderer_window_attachment_count_get();
+    u64 palette_size = sizeof(mat4) * SKINNED_PASS_MAX_PALETTE_MATRICES * region_count;
+    if (!renderer_renderbuffer_create("renderbuffer_skinning_palette", RENDERBUFFER_TYPE_STORAGE, palette_size, RENDERBUFFER_TRACK_TYPE_NONE, &internal_data->palette_buffer)) {
+        KERROR("Failed to create skinning palette buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&internal_data->palette_buffer, 0);
+    internal_data->region_count = region_count;
+
+    return true;
+}
+
+b8 skinned_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data) {
+    if (!self) {
+        return false;
+    }
+
+    skinned_pass_internal_data* internal_data = self->internal_data;
+    skinned_pass_extended_data* ext_data = self->pass_data.ext_data;
+
+    // Meshes whose ranges of the palette don't fit are not drawn.
+    u32 palette_count = KMIN(ext_data->palette_count, SKINNED_PASS_MAX_PALETTE_MATRICES);
+    if (palette_count < ext_data->palette_count) {
+        KWARN("Only %u of %u skinning matrices fit within the palette. Some skinned meshes will not be drawn.", palette_count, ext_data->palette_count);
+    }
+
+    u32 region = p_frame_data->render_target_index % internal_data->region_count;
+    u64 region_offset = sizeof(mat4) * (u64)region * SKINNED_PASS_MAX_PALETTE_MATRICES;
+    if (palette_count) {
+        if (!renderer_renderbuffer_load_range(&internal_data->palette_buffer, region_offset, sizeof(mat4) * palette_count, ext_data->palette)) {
+            KERROR("Failed to upload skinning palette. Render frame failed.");
+            return false;
+        }
+    }
+
+    // Bind the viewport
+    renderer_active_viewport_set(self->pass_data.vp);
+
+    if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
+        KERROR("skinned renderpass failed to start.");
+        return false;
+    }
+
+    if (palette_count) {
+        shader* s = internal_data->s;
+        shader_system_use_by_id(s->id);
+        shader_system_uniform_set_by_location(internal_data->locations.projection, &self->pass_data.projection_matrix);
+        shader_system_uniform_set_by_location(internal_data->locations.view, &self->pass_data.view_matrix);
+        shader_system_uniform_set_by_location(internal_data->locations.light_direction, &ext_data->light_direction);
+        shader_system_uniform_set_by_location(internal_data->locations.light_colour, &ext_data->light_colour);
+        if (!shader_system_storage_buffer_set_by_location(internal_data->locations.joint_palette, &internal_data->palette_buffer)) {
+            KERROR("Failed to set skinning palette buffer.");
+        }
+        shader_system_apply_global(true, p_frame_data);
+
+        for (u32 i = 0; i < ext_data->skinned_mesh_count; ++i) {
+            simple_scene_skinned_mesh* skinned = &ext_data->skinned_meshes[i];
+            const skeletal_animator* animator = &ext_data->animators[i];
+            if (animator->palette_offset + skinned->mesh->skeleton.joint_count > palette_count) {
+                continue;
+            }
+
+            skinned_local_block block = {0};
+            block.model = transform_world_get(&skinned->transform);
+            block.palette_offset = (region * SKINNED_PASS_MAX_PALETTE_MATRICES) + animator->palette_offset;
+            shader_system_local_block_push(&block, sizeof(skinned_local_block));
+
+            for (u32 g = 0; g < skinned->geometry_count; ++g) {
+                if (!skinned->geometries[g]) {
+                    continue;
+                }
+                geometry_draw_record record = {0};
+                record.geometry = skinned->geometries[g];
+                geometry_render_data render_data;
+                renderer_geometry_draw_record_resolve(&record, 0, &render_data);
+                renderer_geometry_draw(&render_data);
+            }
+        }
+
+        // HACK: This should be handled somehow, every frame, by the shader system.
+        s->render_frame_number = p_frame_data->renderer_frame_number;
+    }
+
+    if (!renderer_renderpass_end(&self->pass)) {
+        KERROR("skinned renderpass failed to end.");
+        return false;
+    }
+
+    return true;
+}
+
+void skinned_pass_destroy(struct rendergraph_pass* self) {
+    if (self) {
+        if (self->internal_data) {
+            skinned_pass_internal_data* internal_data = self->internal_data;
+
+            if (internal_data->region_count) {
+                renderer_renderbuffer_destroy(&internal_data->palette_buffer);
+            }
+
+            // Destroy the pass.
+            renderer_renderpass_destroy(&self->pass);
+            kfree(self->internal_data, sizeof(skinned_pass_internal_data), MEMORY_TAG_RENDERER);
+            self->internal_data = 0;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef _SKINNED_PASS_H_
+#define _SKINNED_PASS_H_
+
+#include "defines.h"
+#include "math/math_types.h"
+
+struct rendergraph_pass;
+struct frame_data;
+
+struct simple_scene_skinned_mesh;
+struct skeletal_animator;
+
+typedef struct skinned_pass_extended_data {
+    u32 skinned_mesh_count;
+    // The skinned meshes to draw, and their animators (at the same index), already updated for this frame.
+    struct simple_scene_skinned_mesh* skinned_meshes;
+    struct skeletal_animator* animators;
+    // The skinning matrices of every animator, each in the range assigned to it.
+    u32 palette_count;
+    mat4* palette;
+    // The directional light the meshes are lit by.
+    vec4 light_direction;
+    vec4 light_colour;
+} skinned_pass_extended_data;
+
+b8 skinned_pass_create(struct rendergraph_pass* self, void* config);
+b8 skinned_pass_initialize(struct rendergraph_pass* self);
+b8 skinned_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_data);
+void skinned_pass_destroy(struct rendergraph_pass* self);
+
+#endif
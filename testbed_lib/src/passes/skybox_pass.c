@@ -27,6 +27,9 @@ b8 skybox_pass_create(struct rendergraph_pass* self, void* config) {
     self->internal_data = kallocate(sizeof(skybox_pass_internal_data), MEMORY_TAG_RENDERER);
     self->pass_data.ext_data = kallocate(sizeof(skybox_pass_extended_data), MEMORY_TAG_RENDERER);
 
+    // Only uses its own shader and instance, so may be recorded alongside other passes.
+    self->parallel_recording = true;
+
     return true;
 }
 
@@ -53,7 +56,7 @@ b8 skybox_pass_initialize(struct rendergraph_pass* self) {
     // Color attachment.
     render_target_attachment_config* skybox_target_colour = &skybox_pass_config.target.attachments[0];
     skybox_target_colour->type = RENDER_TARGET_ATTACHMENT_TYPE_COLOUR;
-    skybox_target_colour->source = RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT;
+    skybox_target_colour->source = rendergraph_pass_colour_source(self);
     skybox_target_colour->load_operation = RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_DONT_CARE;
     skybox_target_colour->store_operation = RENDER_TARGET_ATTACHMENT_STORE_OPERATION_STORE;
     skybox_target_colour->present_after = false;
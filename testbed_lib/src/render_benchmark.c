@@ -0,0 +1,243 @@
+#include "render_benchmark.h"
+
+#include <core/frame_data.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <core/metrics.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <renderer/camera.h>
+#include <utils/ksort.h>
+
+/** @brief The percentiles reported for each timing. */
+static const f32 report_percentiles[] = {50.0f, 90.0f, 95.0f, 99.0f};
+#define REPORT_PERCENTILE_COUNT (sizeof(report_percentiles) / sizeof(f32))
+
+static b8 arg_value_get(const char* arg, const char* key, const char** out_value) {
+    u64 key_length = string_length(key);
+    if (string_length(arg) > key_length && strings_nequali(arg, key, key_length)) {
+        *out_value = arg + key_length;
+        return true;
+    }
+    return false;
+}
+
+b8 render_benchmark_parse(i32 argc, char** argv, render_benchmark* out_benchmark) {
+    kzero_memory(out_benchmark, sizeof(render_benchmark));
+    out_benchmark->frame_count = RENDER_BENCHMARK_DEFAULT_FRAMES;
+    out_benchmark->warmup_frames = RENDER_BENCHMARK_DEFAULT_WARMUP;
+
+    // The first argument is the executable.
+    for (i32 i = 1; i < argc; ++i) {
+        const char* value = 0;
+        if (arg_value_get(argv[i], "benchmark=", &value)) {
+            string_ncopy(out_benchmark->scene_name, value, sizeof(out_benchmark->scene_name) - 1);
+            out_benchmark->active = true;
+        } else if (arg_value_get(argv[i], "replay=", &value)) {
+            // The scene is named by the capture.
+            string_ncopy(out_benchmark->replay_path, value, sizeof(out_benchmark->replay_path) - 1);
+            out_benchmark->active = true;
+        } else if (arg_value_get(argv[i], "frames=", &value)) {
+            if (!string_to_u32(value, &out_benchmark->frame_count) || out_benchmark->frame_count == 0) {
+                KWARN("Invalid benchmark frame count '%s', using %u.", value, RENDER_BENCHMARK_DEFAULT_FRAMES);
+                out_benchmark->frame_count = RENDER_BENCHMARK_DEFAULT_FRAMES;
+            }
+        } else if (arg_value_get(argv[i], "warmup=", &value)) {
+            if (!string_to_u32(value, &out_benchmark->warmup_frames)) {
+                KWARN("Invalid benchmark warmup frame count '%s', using %u.", value, RENDER_BENCHMARK_DEFAULT_WARMUP);
+                out_benchmark->warmup_frames = RENDER_BENCHMARK_DEFAULT_WARMUP;
+            }
+        } else if (arg_value_get(argv[i], "output=", &value)) {
+            string_ncopy(out_benchmark->output_path, value, sizeof(out_benchmark->output_path) - 1);
+        }
+    }
+
+    return out_benchmark->active;
+}
+
+b8 render_benchmark_begin(render_benchmark* benchmark, camera* c) {
+    benchmark->samples = kallocate(sizeof(render_benchmark_sample) * benchmark->frame_count, MEMORY_TAG_GAME);
+    benchmark->frame_index = 0;
+    benchmark->sample_count = 0;
+
+    // Orbit the origin at the camera's starting distance and height, keeping the framing the scene was set up with.
+    vec3 position = camera_position_get(c);
+    benchmark->orbit_center = vec3_zero();
+    benchmark->orbit_radius = ksqrt(position.x * position.x + position.z * position.z);
+    benchmark->orbit_height = position.y;
+    if (benchmark->orbit_radius < K_FLOAT_EPSILON) {
+        benchmark->orbit_radius = 20.0f;
+    }
+
+    if (benchmark->replay_path[0]) {
+        KINFO("Replaying frame capture '%s': %u frames after %u warmup frames.", benchmark->replay_path, benchmark->frame_count, benchmark->warmup_frames);
+    } else {
+        KINFO("Benchmarking scene '%s': %u frames after %u warmup frames.", benchmark->scene_name, benchmark->frame_count, benchmark->warmup_frames);
+    }
+    return true;
+}
+
+void render_benchmark_camera_update(render_benchmark* benchmark, camera* c) {
+    // One full revolution over the recorded frames. Warmup frames hold the starting position.
+    f32 t = 0.0f;
+    if (benchmark->frame_index > benchmark->warmup_frames) {
+        t = (f32)(benchmark->frame_index - benchmark->warmup_frames) / (f32)benchmark->frame_count;
+    }
+    f32 angle = t * K_2PI;
+
+    vec3 position = vec3_create(
+        benchmark->orbit_center.x + ksin(angle) * benchmark->orbit_radius,
+        benchmark->orbit_center.y + benchmark->orbit_height,
+        benchmark->orbit_center.z + kcos(angle) * benchmark->orbit_radius);
+    camera_position_set(c, position);
+
+    // A yaw equal to the orbit angle faces the centre. Pitch down towards it.
+    f32 pitch = -katan(benchmark->orbit_height / benchmark->orbit_radius);
+    camera_rotation_euler_set(c, vec3_create(rad_to_deg(pitch), rad_to_deg(angle), 0.0f));
+}
+
+b8 render_benchmark_frame_end(render_benchmark* benchmark, const frame_data* p_frame_data, f64 cpu_seconds) {
+    benchmark->frame_index++;
+    if (benchmark->frame_index <= benchmark->warmup_frames) {
+        if (benchmark->frame_index == benchmark->warmup_frames) {
+            benchmark->start_alloc_count = get_memory_alloc_count();
+        }
+        return false;
+    }
+
+    if (benchmark->sample_count == 0 && benchmark->warmup_frames == 0) {
+        benchmark->start_alloc_count = get_memory_alloc_count();
+    }
+
+    if (benchmark->sample_count < benchmark->frame_count) {
+        metrics_gpu_pass passes[METRICS_MAX_GPU_PASSES];
+        u32 pass_count = metrics_gpu_passes_get(passes);
+        f64 gpu_ms = 0;
+        for (u32 i = 0; i < pass_count; ++i) {
+            gpu_ms += passes[i].ms;
+        }
+
+        render_benchmark_sample* sample = &benchmark->samples[benchmark->sample_count++];
+        sample->frame_ms = p_frame_data->delta_time * K_SEC_TO_MS_MULTIPLIER;
+        sample->cpu_ms = (f32)(cpu_seconds * K_SEC_TO_MS_MULTIPLIER);
+        sample->gpu_ms = (f32)gpu_ms;
+        sample->drawn_mesh_count = p_frame_data->drawn_mesh_count;
+        sample->drawn_shadow_mesh_count = p_frame_data->drawn_shadow_mesh_count;
+    }
+
+    return benchmark->sample_count >= benchmark->frame_count;
+}
+
+static i32 f32_compare(void* a, void* b) {
+    f32 x = *(f32*)a;
+    f32 y = *(f32*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the values in place, then logs their mean, percentiles and maximum.
+static void timing_report(const char* name, f32* values, u32 count) {
+    f64 sum = 0;
+    for (u32 i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+    kquick_sort(sizeof(f32), values, 0, (i32)count - 1, f32_compare);
+
+    char text[256];
+    i32 length = string_format(text, "%-6s mean %7.3fms", name, sum / count);
+    for (u32 p = 0; p < REPORT_PERCENTILE_COUNT; ++p) {
+        // Nearest-rank percentile.
+        u32 rank = (u32)kceil((report_percentiles[p] / 100.0f) * count);
+        u32 index = KMAX(rank, 1) - 1;
+        length += string_format(text + length, "  p%-2.0f %7.3fms", report_percentiles[p], values[KMIN(index, count - 1)]);
+    }
+    string_format(text + length, "  max %7.3fms", values[count - 1]);
+    KINFO("%s", text);
+}
+
+static b8 samples_write(const render_benchmark* benchmark) {
+    file_handle f;
+    if (!filesystem_open(benchmark->output_path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to open benchmark output file '%s'.", benchmark->output_path);
+        return false;
+    }
+
+    b8 result = filesystem_write_line(&f, "frame,frame_ms,cpu_ms,gpu_ms,drawn_mesh_count,drawn_shadow_mesh_count");
+    char line[256];
+    for (u32 i = 0; result && i < benchmark->sample_count; ++i) {
+        const render_benchmark_sample* s = &benchmark->samples[i];
+        string_format(line, "%u,%.4f,%.4f,%.4f,%u,%u", i, s->frame_ms, s->cpu_ms, s->gpu_ms, s->drawn_mesh_count, s->drawn_shadow_mesh_count);
+        result = filesystem_write_line(&f, line);
+    }
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("Failed to write benchmark output file '%s'.", benchmark->output_path);
+    }
+    return result;
+}
+
+void render_benchmark_report(const render_benchmark* benchmark) {
+    u32 count = benchmark->sample_count;
+    if (!count) {
+        KWARN("No benchmark frames were recorded.");
+        return;
+    }
+
+    KINFO("Benchmark results for scene '%s', %u frames:", benchmark->scene_name, count);
+
+    // Each timing is sorted separately, so copy them out of the samples.
+    f32* values = kallocate(sizeof(f32) * count, MEMORY_TAG_GAME);
+    u64 drawn_total = 0, drawn_shadow_total = 0;
+    u32 drawn_max = 0, drawn_shadow_max = 0;
+    for (u32 i = 0; i < count; ++i) {
+        values[i] = benchmark->samples[i].frame_ms;
+        drawn_total += benchmark->samples[i].drawn_mesh_count;
+        drawn_shadow_total += benchmark->samples[i].drawn_shadow_mesh_count;
+        drawn_max = KMAX(drawn_max, benchmark->samples[i].drawn_mesh_count);
+        drawn_shadow_max = KMAX(drawn_shadow_max, benchmark->samples[i].drawn_shadow_mesh_count);
+    }
+    timing_report("Frame", values, count);
+    for (u32 i = 0; i < count; ++i) {
+        values[i] = benchmark->samples[i].cpu_ms;
+    }
+    timing_report("CPU", values, count);
+    for (u32 i = 0; i < count; ++i) {
+        values[i] = benchmark->samples[i].gpu_ms;
+    }
+    timing_report("GPU", values, count);
+    kfree(values, sizeof(f32) * count, MEMORY_TAG_GAME);
+
+    KINFO("Drawn meshes: mean %.1f, max %u. Shadow pass: mean %.1f, max %u.",
+          (f64)drawn_total / count, drawn_max, (f64)drawn_shadow_total / count, drawn_shadow_max);
+
+    u64 allocations = get_memory_alloc_count() - benchmark->start_alloc_count;
+    KINFO("Allocations: %llu during the run, %.1f per frame.", allocations, (f64)allocations / count);
+
+    metrics_gpu_memory gpu_memory;
+    metrics_gpu_memory_get(&gpu_memory);
+    KINFO("GPU memory: %u blocks %.1fMiB (%.1fMiB used), %u dedicated (%.1fMiB).",
+          gpu_memory.block_count,
+          gpu_memory.block_bytes / (f64)MEBIBYTES(1),
+          gpu_memory.block_used_bytes / (f64)MEBIBYTES(1),
+          gpu_memory.dedicated_count,
+          gpu_memory.dedicated_bytes / (f64)MEBIBYTES(1));
+
+    char* usage = get_memory_usage_str();
+    KINFO("%s", usage);
+    string_free(usage);
+
+    if (benchmark->output_path[0]) {
+        if (samples_write(benchmark)) {
+            KINFO("Benchmark samples written to '%s'.", benchmark->output_path);
+        }
+    }
+}
+
+void render_benchmark_destroy(render_benchmark* benchmark) {
+    if (benchmark->samples) {
+        kfree(benchmark->samples, sizeof(render_benchmark_sample) * benchmark->frame_count, MEMORY_TAG_GAME);
+        benchmark->samples = 0;
+    }
+    benchmark->active = false;
+}
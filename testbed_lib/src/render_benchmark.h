@@ -0,0 +1,132 @@
+/**
+ * @file render_benchmark.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A scripted rendering benchmark for the testbed.
+ * @details Started from the command line with "benchmark=<scene>", optionally followed by
+ * "frames=<count>", "warmup=<count>" and "output=<path>". The named scene is loaded with vsync
+ * off, and the world camera is flown around it along a fixed orbit driven by the frame index
+ * rather than the clock, so that every run renders the same frames. Once the scene is loaded and
+ * the warmup frames are done, each frame's timings and draw counts are recorded. After the last
+ * one, percentiles are logged along with memory statistics, the samples are optionally written
+ * to a CSV file, and the application quits.
+ *
+ * Started with "replay=<capture>" instead, the scene of the given frame capture is loaded, and once
+ * its meshes have, the captured frame is submitted through the rendergraph again every frame with no
+ * game update, so that only renderer and driver costs are measured. See render_capture.h.
+ * @version 1.0
+ * @date 2023-12-01
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+#include <math/math_types.h>
+
+struct camera;
+struct frame_data;
+
+/** @brief The number of frames recorded when none is given. */
+#define RENDER_BENCHMARK_DEFAULT_FRAMES 1000
+/** @brief The number of frames rendered before recording starts when none is given. */
+#define RENDER_BENCHMARK_DEFAULT_WARMUP 120
+
+/** @brief The measurements of a single benchmark frame. */
+typedef struct render_benchmark_sample {
+    /** @brief The time since the previous frame, in milliseconds. */
+    f32 frame_ms;
+    /** @brief The CPU time spent updating, preparing and recording the frame, in milliseconds. */
+    f32 cpu_ms;
+    /** @brief The GPU time of the passes most recently resolved, in milliseconds. */
+    f32 gpu_ms;
+    /** @brief The number of meshes drawn by the scene pass. */
+    u32 drawn_mesh_count;
+    /** @brief The number of meshes drawn by the shadow pass. */
+    u32 drawn_shadow_mesh_count;
+} render_benchmark_sample;
+
+typedef struct render_benchmark {
+    /** @brief Indicates if a benchmark was requested. */
+    b8 active;
+    /** @brief The name of the scene resource to be loaded. */
+    char scene_name[256];
+    /** @brief The path of the CSV file the samples are written to. Empty to skip it. */
+    char output_path[256];
+    /** @brief The path of the frame capture to be replayed instead of orbiting the scene. Empty to orbit it. */
+    char replay_path[256];
+    /** @brief The number of frames to be recorded. */
+    u32 frame_count;
+    /** @brief The number of frames rendered after the scene loads, before recording starts. */
+    u32 warmup_frames;
+
+    /** @brief The number of frames rendered since the scene loaded. */
+    u32 frame_index;
+    /** @brief The number of frames recorded so far. */
+    u32 sample_count;
+    /** @brief An array of frame_count samples. */
+    render_benchmark_sample* samples;
+
+    /** @brief The centre of the camera orbit. */
+    vec3 orbit_center;
+    /** @brief The horizontal distance of the camera from the orbit centre. */
+    f32 orbit_radius;
+    /** @brief The height of the camera above the orbit centre. */
+    f32 orbit_height;
+
+    /** @brief The total allocation count when recording started. */
+    u64 start_alloc_count;
+} render_benchmark;
+
+/**
+ * @brief Reads the benchmark options from the command line.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @param out_benchmark A pointer to hold the benchmark. Marked active only if one was requested.
+ * @return True if a benchmark was requested; otherwise false.
+ */
+b8 render_benchmark_parse(i32 argc, char** argv, render_benchmark* out_benchmark);
+
+/**
+ * @brief Prepares the benchmark to run, orbiting at the distance and height of the camera's current position.
+ *
+ * @param benchmark A pointer to the benchmark.
+ * @param c A pointer to the camera to be flown.
+ * @return True on success; otherwise false.
+ */
+b8 render_benchmark_begin(render_benchmark* benchmark, struct camera* c);
+
+/**
+ * @brief Moves the camera to its position on the path for the current frame. Called once per frame,
+ * once the scene is loaded.
+ *
+ * @param benchmark A pointer to the benchmark.
+ * @param c A pointer to the camera to be flown.
+ */
+void render_benchmark_camera_update(render_benchmark* benchmark, struct camera* c);
+
+/**
+ * @brief Records a rendered frame. Called once per frame after it is presented, once the scene is loaded.
+ *
+ * @param benchmark A pointer to the benchmark.
+ * @param p_frame_data A constant pointer to the frame's data.
+ * @param cpu_seconds The CPU time spent on the frame, in seconds.
+ * @return True once every frame has been recorded; otherwise false.
+ */
+b8 render_benchmark_frame_end(render_benchmark* benchmark, const struct frame_data* p_frame_data, f64 cpu_seconds);
+
+/**
+ * @brief Logs the results of the benchmark, and writes its samples out if an output path was given.
+ *
+ * @param benchmark A constant pointer to the benchmark.
+ */
+void render_benchmark_report(const render_benchmark* benchmark);
+
+/**
+ * @brief Releases the samples of the benchmark.
+ *
+ * @param benchmark A pointer to the benchmark.
+ */
+void render_benchmark_destroy(render_benchmark* benchmark);
@@ -0,0 +1,371 @@
+#include "render_capture.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <platform/filesystem.h>
+#include <renderer/renderer_utils.h>
+#include <renderer/rendergraph.h>
+#include <renderer/viewport.h>
+#include <resources/resource_types.h>
+
+#include "passes/depth_prepass.h"
+#include "passes/scene_pass.h"
+#include "resources/simple_scene.h"
+
+// Long enough for a line holding a matrix, or a draw with two names.
+#define RENDER_CAPTURE_LINE_LENGTH 1024
+// The number of comma-separated entries of a draw line.
+#define RENDER_CAPTURE_DRAW_ENTRY_COUNT 10
+
+/** @brief The names of the draw lists, as written to capture files. */
+static const char* list_names[RENDER_CAPTURE_LIST_COUNT] = {"scene", "shadow"};
+
+// Finds the scene mesh the given geometry belongs to, and its index within it.
+static const mesh* geometry_owner_find(const simple_scene* scene, const geometry* g, u16* out_index) {
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        const mesh* m = &scene->meshes[i];
+        for (u16 j = 0; j < m->geometry_count; ++j) {
+            if (m->geometries[j] == g) {
+                *out_index = j;
+                return m;
+            }
+        }
+    }
+    return 0;
+}
+
+static const mesh* scene_mesh_find(const simple_scene* scene, const char* name) {
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (scene->meshes[i].name && strings_equal(scene->meshes[i].name, name)) {
+            return &scene->meshes[i];
+        }
+    }
+    return 0;
+}
+
+static b8 mat4_write(file_handle* f, const char* key, const mat4* m) {
+    char line[RENDER_CAPTURE_LINE_LENGTH];
+    i32 length = string_format(line, "%s=", key);
+    for (u32 i = 0; i < 16; ++i) {
+        length += string_format(line + length, i ? " %.9g" : "%.9g", m->data[i]);
+    }
+    return filesystem_write_line(f, line);
+}
+
+static b8 draws_write(file_handle* f, const simple_scene* scene, render_capture_list list, u32 count, const geometry_draw_record* records) {
+    char line[RENDER_CAPTURE_LINE_LENGTH];
+    u32 skipped = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_draw_record* r = &records[i];
+        u16 geometry_index = 0;
+        const mesh* m = r->geometry ? geometry_owner_find(scene, r->geometry, &geometry_index) : 0;
+        if (!m || !m->name) {
+            skipped++;
+            continue;
+        }
+
+        string_format(line, "draw=%s,%s,%s,%u,%u,%u,%llu,%u,%u,%u",
+                      list_names[list], m->name, r->geometry->name, geometry_index, r->object_index, r->lod,
+                      r->sort_key, r->winding_inverted ? 1 : 0, r->first_index, r->index_count);
+        if (!filesystem_write_line(f, line)) {
+            return false;
+        }
+    }
+
+    if (skipped) {
+        KWARN("%u %s draws were of geometries not belonging to a scene mesh, and were left out of the capture.", skipped, list_names[list]);
+    }
+    return true;
+}
+
+b8 render_capture_save(const char* path, const char* scene_name, const simple_scene* scene, const rendergraph_pass* scene_pass, const rendergraph_pass* depth_prepass, const rendergraph_pass* shadowmap_pass, f32 resolution_scale) {
+    if (!path || !scene_name || !scene || !scene_pass || !depth_prepass || !shadowmap_pass) {
+        return false;
+    }
+    if (!scene_pass->pass_data.do_execute || !scene_pass->pass_data.vp) {
+        KERROR("Can't capture a frame in which no scene was rendered.");
+        return false;
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to open frame capture file '%s'.", path);
+        return false;
+    }
+
+    const rendergraph_pass_data* data = &scene_pass->pass_data;
+    const scene_pass_extended_data* ext_data = data->ext_data;
+    const depth_prepass_extended_data* prepass_ext_data = depth_prepass->pass_data.ext_data;
+    const shadow_map_pass_extended_data* shadow_ext_data = shadowmap_pass->pass_data.ext_data;
+    b8 has_light = shadowmap_pass->pass_data.do_execute;
+
+    char line[RENDER_CAPTURE_LINE_LENGTH];
+    b8 result = filesystem_write_line(&f, "# Kohi frame capture file");
+    string_format(line, "version=%u", RENDER_CAPTURE_VERSION);
+    result = result && filesystem_write_line(&f, line);
+    string_format(line, "scene=%s", scene_name);
+    result = result && filesystem_write_line(&f, line);
+    string_format(line, "size=%u %u", (u32)data->vp->rect.width, (u32)data->vp->rect.height);
+    result = result && filesystem_write_line(&f, line);
+    result = result && mat4_write(&f, "view", &data->view_matrix);
+    string_format(line, "view_position=%.9g %.9g %.9g", data->view_position.x, data->view_position.y, data->view_position.z);
+    result = result && filesystem_write_line(&f, line);
+    result = result && mat4_write(&f, "projection", &data->projection_matrix);
+    string_format(line, "resolution_scale=%.9g", resolution_scale);
+    result = result && filesystem_write_line(&f, line);
+    string_format(line, "render_mode=%u", ext_data->render_mode);
+    result = result && filesystem_write_line(&f, line);
+    string_format(line, "depth_prepass=%s", prepass_ext_data->enabled ? "true" : "false");
+    result = result && filesystem_write_line(&f, line);
+    string_format(line, "light=%s", has_light ? "true" : "false");
+    result = result && filesystem_write_line(&f, line);
+
+    // The cascades as the scene pass samples them, which are also those the shadow pass last rendered.
+    for (u32 c = 0; result && c < MAX_CASCADE_COUNT; ++c) {
+        string_format(line, "cascade=%u", c);
+        result = filesystem_write_line(&f, line);
+        string_format(line, "cascade_split=%.9g", ext_data->cascade_splits.elements[c]);
+        result = result && filesystem_write_line(&f, line);
+        result = result && mat4_write(&f, "cascade_view", &ext_data->directional_light_views[c]);
+        result = result && mat4_write(&f, "cascade_projection", &ext_data->directional_light_projections[c]);
+    }
+
+    result = result && draws_write(&f, scene, RENDER_CAPTURE_LIST_SCENE, ext_data->geometry_count, ext_data->geometries);
+    // Every cascade draws the same list.
+    if (has_light) {
+        result = result && draws_write(&f, scene, RENDER_CAPTURE_LIST_SHADOW, shadow_ext_data->cascades[0].geometry_count, shadow_ext_data->cascades[0].geometries);
+    }
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("Failed to write frame capture file '%s'.", path);
+    }
+    return result;
+}
+
+static b8 draw_parse(const char* value, render_capture* capture) {
+    kstring_view entries[RENDER_CAPTURE_DRAW_ENTRY_COUNT];
+    if (kstring_view_split(kstring_view_from_cstring(value), ',', entries, RENDER_CAPTURE_DRAW_ENTRY_COUNT, true) != RENDER_CAPTURE_DRAW_ENTRY_COUNT) {
+        return false;
+    }
+
+    render_capture_list list = RENDER_CAPTURE_LIST_COUNT;
+    for (u32 i = 0; i < RENDER_CAPTURE_LIST_COUNT; ++i) {
+        if (kstring_view_equali(entries[0], list_names[i])) {
+            list = (render_capture_list)i;
+        }
+    }
+
+    u32 geometry_index = 0, lod = 0;
+    render_capture_draw draw = {0};
+    if (list == RENDER_CAPTURE_LIST_COUNT ||
+        !kstring_view_to_u32(entries[3], &geometry_index) ||
+        !kstring_view_to_u32(entries[4], &draw.record.object_index) ||
+        !kstring_view_to_u32(entries[5], &lod) ||
+        !kstring_view_to_u64(entries[6], &draw.record.sort_key) ||
+        !kstring_view_to_bool(entries[7], &draw.record.winding_inverted) ||
+        !kstring_view_to_u32(entries[8], &draw.record.first_index) ||
+        !kstring_view_to_u32(entries[9], &draw.record.index_count)) {
+        return false;
+    }
+    draw.geometry_index = (u16)geometry_index;
+    draw.record.lod = (u16)lod;
+    draw.mesh_name = kstring_view_duplicate(entries[1]);
+    draw.geometry_name = kstring_view_duplicate(entries[2]);
+    darray_push(capture->draws[list], draw);
+    return true;
+}
+
+b8 render_capture_load(const char* path, render_capture* out_capture) {
+    if (!path || !out_capture) {
+        return false;
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, false, &f)) {
+        KERROR("Unable to open frame capture file '%s'.", path);
+        return false;
+    }
+
+    kzero_memory(out_capture, sizeof(render_capture));
+    out_capture->resolution_scale = 1.0f;
+    for (u32 i = 0; i < RENDER_CAPTURE_LIST_COUNT; ++i) {
+        out_capture->draws[i] = darray_create(render_capture_draw);
+    }
+
+    u32 version = 0;
+    u32 cascade = 0;
+    b8 result = true;
+    char line_buf[RENDER_CAPTURE_LINE_LENGTH] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    u32 line_number = 1;
+    while (result && filesystem_read_line(&f, RENDER_CAPTURE_LINE_LENGTH - 1, &p, &line_length)) {
+        char* trimmed = string_trim(line_buf);
+        if (string_length(trimmed) < 1 || trimmed[0] == '#') {
+            line_number++;
+            continue;
+        }
+
+        i32 equal_index = string_index_of(trimmed, '=');
+        if (equal_index == -1) {
+            KWARN("Format error in frame capture '%s': '=' token not found. Skipping line %u.", path, line_number);
+            line_number++;
+            continue;
+        }
+        trimmed[equal_index] = 0;
+        const char* key = string_trim(trimmed);
+        const char* value = string_trim(trimmed + equal_index + 1);
+
+        b8 parsed = true;
+        if (strings_equali(key, "version")) {
+            parsed = string_to_u32(value, &version);
+            if (parsed && version != RENDER_CAPTURE_VERSION) {
+                KERROR("Frame capture '%s' is version %u, but only version %u can be replayed.", path, version, RENDER_CAPTURE_VERSION);
+                result = false;
+            }
+        } else if (strings_equali(key, "scene")) {
+            string_ncopy(out_capture->scene_name, value, sizeof(out_capture->scene_name) - 1);
+        } else if (strings_equali(key, "size")) {
+            vec2 size;
+            parsed = string_to_vec2(value, &size);
+            out_capture->width = (u32)size.x;
+            out_capture->height = (u32)size.y;
+        } else if (strings_equali(key, "view")) {
+            parsed = string_to_mat4(value, &out_capture->view);
+        } else if (strings_equali(key, "view_position")) {
+            parsed = string_to_vec3(value, &out_capture->view_position);
+        } else if (strings_equali(key, "projection")) {
+            parsed = string_to_mat4(value, &out_capture->projection);
+        } else if (strings_equali(key, "resolution_scale")) {
+            parsed = string_to_f32(value, &out_capture->resolution_scale);
+        } else if (strings_equali(key, "render_mode")) {
+            parsed = string_to_u32(value, &out_capture->render_mode);
+        } else if (strings_equali(key, "depth_prepass")) {
+            parsed = string_to_bool(value, &out_capture->depth_prepass_enabled);
+        } else if (strings_equali(key, "light")) {
+            parsed = string_to_bool(value, &out_capture->has_light);
+        } else if (strings_equali(key, "cascade")) {
+            parsed = string_to_u32(value, &cascade) && cascade < MAX_CASCADE_COUNT;
+        } else if (strings_equali(key, "cascade_split")) {
+            parsed = string_to_f32(value, &out_capture->cascade_splits[cascade]);
+        } else if (strings_equali(key, "cascade_view")) {
+            parsed = string_to_mat4(value, &out_capture->cascade_views[cascade]);
+        } else if (strings_equali(key, "cascade_projection")) {
+            parsed = string_to_mat4(value, &out_capture->cascade_projections[cascade]);
+        } else if (strings_equali(key, "draw")) {
+            parsed = draw_parse(value, out_capture);
+        } else {
+            KWARN("Unknown key '%s' in frame capture '%s' at line %u.", key, path, line_number);
+        }
+
+        if (!parsed) {
+            KERROR("Format error in frame capture '%s': invalid '%s' at line %u.", path, key, line_number);
+            result = false;
+        }
+        line_number++;
+    }
+    filesystem_close(&f);
+
+    if (result && !version) {
+        KERROR("Frame capture '%s' has no version.", path);
+        result = false;
+    }
+    if (result && !out_capture->scene_name[0]) {
+        KERROR("Frame capture '%s' does not name the scene it was taken in.", path);
+        result = false;
+    }
+
+    // The opaque draws come first, as they were sorted when captured.
+    render_capture_draw* scene_draws = out_capture->draws[RENDER_CAPTURE_LIST_SCENE];
+    u32 scene_draw_count = darray_length(scene_draws);
+    while (out_capture->opaque_count < scene_draw_count &&
+           render_sort_key_layer_get(scene_draws[out_capture->opaque_count].record.sort_key) == RENDER_SORT_LAYER_OPAQUE) {
+        out_capture->opaque_count++;
+    }
+
+    if (!result) {
+        render_capture_destroy(out_capture);
+    }
+    return result;
+}
+
+b8 render_capture_resolve(render_capture* capture, const simple_scene* scene) {
+    if (!capture || !scene) {
+        return false;
+    }
+    if (capture->resolved) {
+        return true;
+    }
+    if (scene->state < SIMPLE_SCENE_STATE_LOADED) {
+        return false;
+    }
+
+    // Wait until every mesh drawn has its geometry on the GPU.
+    for (u32 l = 0; l < RENDER_CAPTURE_LIST_COUNT; ++l) {
+        u32 draw_count = darray_length(capture->draws[l]);
+        for (u32 i = 0; i < draw_count; ++i) {
+            const mesh* m = scene_mesh_find(scene, capture->draws[l][i].mesh_name);
+            if (m && m->generation == INVALID_ID_U8) {
+                return false;
+            }
+        }
+    }
+
+    for (u32 l = 0; l < RENDER_CAPTURE_LIST_COUNT; ++l) {
+        u32 draw_count = darray_length(capture->draws[l]);
+        capture->records[l] = draw_count ? kallocate(sizeof(geometry_draw_record) * draw_count, MEMORY_TAG_GAME) : 0;
+        capture->record_counts[l] = 0;
+        u32 opaque_count = 0;
+        for (u32 i = 0; i < draw_count; ++i) {
+            render_capture_draw* draw = &capture->draws[l][i];
+            const mesh* m = scene_mesh_find(scene, draw->mesh_name);
+            geometry* g = (m && draw->geometry_index < m->geometry_count) ? m->geometries[draw->geometry_index] : 0;
+            if (!g) {
+                KWARN("Captured geometry %u of mesh '%s' was not found in the scene, and won't be drawn.", draw->geometry_index, draw->mesh_name);
+                continue;
+            }
+            if (!strings_equal(g->name, draw->geometry_name)) {
+                KWARN("Captured geometry %u of mesh '%s' was '%s', but is now '%s'. The scene may have changed since the capture.", draw->geometry_index, draw->mesh_name, draw->geometry_name, g->name);
+            }
+
+            draw->record.geometry = g;
+            capture->records[l][capture->record_counts[l]++] = draw->record;
+            if (l == RENDER_CAPTURE_LIST_SCENE && i < capture->opaque_count) {
+                opaque_count++;
+            }
+        }
+        // Leaving out draws may have shortened the opaque ones.
+        if (l == RENDER_CAPTURE_LIST_SCENE) {
+            capture->opaque_count = opaque_count;
+        }
+    }
+
+    capture->resolved = true;
+    return true;
+}
+
+void render_capture_destroy(render_capture* capture) {
+    if (!capture) {
+        return;
+    }
+
+    for (u32 l = 0; l < RENDER_CAPTURE_LIST_COUNT; ++l) {
+        if (capture->draws[l]) {
+            u32 draw_count = darray_length(capture->draws[l]);
+            for (u32 i = 0; i < draw_count; ++i) {
+                string_free(capture->draws[l][i].mesh_name);
+                string_free(capture->draws[l][i].geometry_name);
+            }
+            if (capture->records[l]) {
+                kfree(capture->records[l], sizeof(geometry_draw_record) * draw_count, MEMORY_TAG_GAME);
+            }
+            darray_destroy(capture->draws[l]);
+        }
+    }
+    kzero_memory(capture, sizeof(render_capture));
+}
@@ -0,0 +1,131 @@
+/**
+ * @file render_capture.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Captures of a frame's render input, for replaying that frame through the rendergraph.
+ * @details A capture holds what the world passes were given for a single frame: the scene it was
+ * taken in, the camera's view and projection, the shadow cascades, and the draw records of the scene
+ * and shadow passes. Geometries are saved by the name of the scene mesh they belong to and their
+ * index within it, and found again once the same scene is loaded. Replaying a capture re-submits the
+ * same frame with no game update or culling, so that only the renderer's costs are measured. Terrains,
+ * skinned meshes, impostors, particles and debug shapes are not captured.
+ * @version 1.0
+ * @date 2023-12-24
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+#include <math/math_types.h>
+#include <renderer/passes/shadow_map_pass.h>
+#include <renderer/renderer_types.h>
+
+struct rendergraph_pass;
+struct simple_scene;
+
+/** @brief The version of the capture files written. */
+#define RENDER_CAPTURE_VERSION 1
+/** @brief The path captures are written to when none is given. */
+#define RENDER_CAPTURE_DEFAULT_PATH "frame_capture.kfc"
+
+/** @brief The draw lists held by a capture. */
+typedef enum render_capture_list {
+    /** @brief The scene pass' geometries, opaque first. The depth prepass draws the opaque ones. */
+    RENDER_CAPTURE_LIST_SCENE,
+    /** @brief The geometries shared by each shadow cascade. */
+    RENDER_CAPTURE_LIST_SHADOW,
+    RENDER_CAPTURE_LIST_COUNT
+} render_capture_list;
+
+/** @brief A captured draw, referring to its geometry by name. */
+typedef struct render_capture_draw {
+    /** @brief The name of the scene mesh the geometry belongs to. */
+    char* mesh_name;
+    /** @brief The name of the geometry, checked against the one found when resolving. */
+    char* geometry_name;
+    /** @brief The index of the geometry within the mesh. */
+    u16 geometry_index;
+    /** @brief The draw record, whose geometry is only valid once resolved. */
+    geometry_draw_record record;
+} render_capture_draw;
+
+/** @brief The render input of a single frame. */
+typedef struct render_capture {
+    /** @brief The name of the scene resource the capture was taken in. */
+    char scene_name[256];
+    /** @brief The size of the world viewport when captured. */
+    u32 width;
+    u32 height;
+
+    mat4 view;
+    vec3 view_position;
+    mat4 projection;
+    /** @brief The resolution scale the scene was rendered at. */
+    f32 resolution_scale;
+    u32 render_mode;
+    /** @brief Indicates if the depth prepass drew the opaque geometries. */
+    b8 depth_prepass_enabled;
+
+    /** @brief Indicates if there was a directional light, and so if the shadow pass ran. */
+    b8 has_light;
+    /** @brief The view and projection of each shadow cascade, as sampled by the scene pass. */
+    mat4 cascade_views[MAX_CASCADE_COUNT];
+    mat4 cascade_projections[MAX_CASCADE_COUNT];
+    f32 cascade_splits[MAX_CASCADE_COUNT];
+
+    /** @brief darrays of the captured draws of each list. */
+    render_capture_draw* draws[RENDER_CAPTURE_LIST_COUNT];
+    /** @brief The number of opaque draws, which come first in the scene list. */
+    u32 opaque_count;
+
+    /** @brief Indicates if every draw's geometry has been found in the scene. */
+    b8 resolved;
+    /** @brief The resolved draw records of each list, in order, as handed to the passes. */
+    geometry_draw_record* records[RENDER_CAPTURE_LIST_COUNT];
+    /** @brief The number of resolved records of each list. */
+    u32 record_counts[RENDER_CAPTURE_LIST_COUNT];
+} render_capture;
+
+/**
+ * @brief Writes the render input the given passes were prepared with this frame to a capture file.
+ * Must be called after the frame is prepared, and before the next one.
+ *
+ * @param path The path of the file to be written.
+ * @param scene_name The name of the scene resource the scene was loaded from.
+ * @param scene A constant pointer to the scene, whose meshes the geometries are named by.
+ * @param scene_pass A constant pointer to the scene pass.
+ * @param depth_prepass A constant pointer to the depth prepass.
+ * @param shadowmap_pass A constant pointer to the shadow map pass.
+ * @param resolution_scale The resolution scale the scene is rendered at this frame.
+ * @return True on success; otherwise false.
+ */
+b8 render_capture_save(const char* path, const char* scene_name, const struct simple_scene* scene, const struct rendergraph_pass* scene_pass, const struct rendergraph_pass* depth_prepass, const struct rendergraph_pass* shadowmap_pass, f32 resolution_scale);
+
+/**
+ * @brief Reads a capture file. Its geometries must then be resolved against the loaded scene.
+ *
+ * @param path The path of the file to be read.
+ * @param out_capture A pointer to hold the capture.
+ * @return True on success; otherwise false.
+ */
+b8 render_capture_load(const char* path, render_capture* out_capture);
+
+/**
+ * @brief Finds the geometry of each of the capture's draws in the given scene. Draws whose geometry
+ * can't be found are left out with a warning. Called each frame until it succeeds, as the scene's
+ * meshes finish loading.
+ *
+ * @param capture A pointer to the capture.
+ * @param scene A constant pointer to the scene the capture was taken in.
+ * @return True once every mesh drawn has loaded and the draws are resolved; otherwise false.
+ */
+b8 render_capture_resolve(render_capture* capture, const struct simple_scene* scene);
+
+/**
+ * @brief Releases the draws of the given capture.
+ *
+ * @param capture A pointer to the capture.
+ */
+void render_capture_destroy(render_capture* capture);
@@ -11,6 +11,102 @@
 #include "resources/resource_types.h"
 #include "systems/resource_system.h"
 
+/** @brief The version of binary simple scene (ksb) files written. */
+#define KSB_VERSION 0x0004U
+/** @brief The alignment in bytes of each array in a ksb file. */
+#define KSB_DATA_ALIGNMENT 16
+/** @brief Marks a string of a ksb file which has no value. */
+#define KSB_NO_STRING INVALID_ID
+
+/** @brief The frames along each side of an impostor atlas if not given. Matches the default of the tools. */
+#define IMPOSTOR_DEFAULT_FRAME_COUNT 8
+/** @brief The distance beyond which a mesh's impostor is drawn if not given. */
+#define IMPOSTOR_DEFAULT_DISTANCE 100.0f
+
+/**
+ * @brief The header at the start of a binary simple scene (ksb) file. Strings are held by a
+ * single table, each referred to by its offset within it, and stored once however often used.
+ * The transforms of meshes, then terrains, then skinned meshes are flattened into arrays of positions, rotations
+ * and scales. All arrays are found through the offsets here, so the whole file can be read at once.
+ */
+typedef struct ksb_header {
+    /** @brief The version of the file. Must be KSB_VERSION. */
+    u16 version;
+    u16 reserved;
+    u32 point_light_count;
+    u32 mesh_count;
+    u32 terrain_count;
+    u32 particle_emitter_count;
+    u32 skinned_mesh_count;
+    u32 name;
+    u32 description;
+    u32 skybox_name;
+    u32 skybox_cubemap_name;
+    /** @brief The name of the directional light, or KSB_NO_STRING if there is none. */
+    u32 directional_light_name;
+    /** @brief The size of the string table in bytes. Its last byte is always a terminator. */
+    u32 string_table_size;
+    vec4 directional_light_colour;
+    vec4 directional_light_direction;
+    /** @brief The offsets of each array from the start of the file. */
+    u64 string_table_offset;
+    u64 point_lights_offset;
+    u64 meshes_offset;
+    u64 terrains_offset;
+    u64 particle_emitters_offset;
+    u64 skinned_meshes_offset;
+    u64 positions_offset;
+    u64 rotations_offset;
+    u64 scales_offset;
+    /** @brief The size of the whole file in bytes. */
+    u64 file_size;
+} ksb_header;
+
+typedef struct ksb_point_light {
+    u32 name;
+    vec4 colour;
+    vec4 position;
+    f32 constant_f;
+    f32 linear;
+    f32 quadratic;
+} ksb_point_light;
+
+typedef struct ksb_mesh {
+    u32 name;
+    u32 resource_name;
+    u32 parent_name;
+    /** @brief The impostor atlas, or KSB_NO_STRING if the mesh has none. */
+    u32 impostor_name;
+    u32 impostor_frame_count;
+    f32 impostor_distance;
+} ksb_mesh;
+
+typedef struct ksb_terrain {
+    u32 name;
+    u32 resource_name;
+} ksb_terrain;
+
+typedef struct ksb_particle_emitter {
+    u32 name;
+    u32 resource_name;
+    vec3 position;
+} ksb_particle_emitter;
+
+typedef struct ksb_skinned_mesh {
+    u32 name;
+    u32 resource_name;
+    /** @brief The clip played from load, or KSB_NO_STRING to hold the rest pose. */
+    u32 clip_name;
+} ksb_skinned_mesh;
+
+// The layout of these is part of the file format.
+STATIC_ASSERT(sizeof(ksb_header) == 160, "ksb_header must be 160 bytes.");
+STATIC_ASSERT(sizeof(ksb_point_light) == 48, "ksb_point_light must be 48 bytes.");
+STATIC_ASSERT(sizeof(ksb_mesh) == 24, "ksb_mesh must be 24 bytes.");
+STATIC_ASSERT(sizeof(ksb_terrain) == 8, "ksb_terrain must be 8 bytes.");
+STATIC_ASSERT(sizeof(ksb_particle_emitter) == 20, "ksb_particle_emitter must be 20 bytes.");
+STATIC_ASSERT(sizeof(ksb_skinned_mesh) == 12, "ksb_skinned_mesh must be 12 bytes.");
+
 typedef enum simple_scene_parse_mode {
     SIMPLE_SCENE_PARSE_MODE_ROOT,
     SIMPLE_SCENE_PARSE_MODE_SCENE,
@@ -19,9 +115,13 @@ typedef enum simple_scene_parse_mode {
     SIMPLE_SCENE_PARSE_MODE_POINT_LIGHT,
     SIMPLE_SCENE_PARSE_MODE_MESH,
     SIMPLE_SCENE_PARSE_MODE_TERRAIN,
+    SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER,
+    SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH,
 } simple_scene_parse_mode;
 
 static b8 try_change_mode(const char* value, simple_scene_parse_mode* current, simple_scene_parse_mode expected_current, simple_scene_parse_mode target);
+static b8 load_ksb_file(const char* path, simple_scene_config* out_config);
+static void simple_scene_config_free(simple_scene_config* data);
 
 static b8 simple_scene_loader_load(struct resource_loader* self, const char* name, void* params, resource* out_resource) {
     if (!self || !name || !out_resource) {
@@ -30,6 +130,26 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
 
     char* format_str = "%s/%s/%s%s";
     char full_file_path[512];
+
+    // A binary version of the scene takes priority. One is written whenever a text version is loaded.
+    string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, ".ksb");
+    if (filesystem_exists(full_file_path)) {
+        simple_scene_config* resource_data = kallocate(sizeof(simple_scene_config), MEMORY_TAG_RESOURCE);
+        if (load_ksb_file(full_file_path, resource_data)) {
+            if (!resource_data->name) {
+                resource_data->name = string_duplicate(name);
+            }
+            out_resource->full_path = string_duplicate(full_file_path);
+            out_resource->data = resource_data;
+            out_resource->data_size = sizeof(simple_scene_config);
+            return true;
+        }
+        // Such as one written by an older version. It is replaced once the text version is loaded.
+        KWARN("simple_scene_loader_load - failed to load binary simple scene file '%s'. Loading the text version instead.", full_file_path);
+        simple_scene_config_free(resource_data);
+        kfree(resource_data, sizeof(simple_scene_config), MEMORY_TAG_RESOURCE);
+    }
+
     string_format(full_file_path, format_str, resource_system_base_path(), self->type_path, name, ".kss");
 
     file_handle f;
@@ -49,6 +169,8 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
     resource_data->point_lights = darray_create(point_light_simple_scene_config);
     resource_data->meshes = darray_create(mesh_simple_scene_config);
     resource_data->terrains = darray_create(terrain_simple_scene_config);
+    resource_data->particle_emitters = darray_create(particle_emitter_simple_scene_config);
+    resource_data->skinned_meshes = darray_create(skinned_mesh_simple_scene_config);
 
     u32 version = 0;
     simple_scene_parse_mode mode = SIMPLE_SCENE_PARSE_MODE_ROOT;
@@ -58,6 +180,8 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
     point_light_simple_scene_config current_point_light_config = {0};
     mesh_simple_scene_config current_mesh_config = {0};
     terrain_simple_scene_config current_terrain_config = {0};
+    particle_emitter_simple_scene_config current_particle_emitter_config = {0};
+    skinned_mesh_simple_scene_config current_skinned_mesh_config = {0};
 
     // Read each line of the file.
     char line_buf[512] = "";
@@ -135,6 +259,14 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                     KWARN("Format error: meshes require both name and resource name. Mesh not added.");
                     continue;
                 }
+                if (current_mesh_config.impostor_name) {
+                    if (current_mesh_config.impostor_frame_count < 2) {
+                        current_mesh_config.impostor_frame_count = IMPOSTOR_DEFAULT_FRAME_COUNT;
+                    }
+                    if (current_mesh_config.impostor_distance <= 0) {
+                        current_mesh_config.impostor_distance = IMPOSTOR_DEFAULT_DISTANCE;
+                    }
+                }
                 // Push into the array, then cleanup.
                 darray_push(resource_data->meshes, current_mesh_config);
                 kzero_memory(&current_mesh_config, sizeof(mesh_simple_scene_config));
@@ -156,6 +288,40 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                 // Push into the array, then cleanup.
                 darray_push(resource_data->terrains, current_terrain_config);
                 kzero_memory(&current_mesh_config, sizeof(terrain_simple_scene_config));
+            } else if (strings_equali(trimmed, "[ParticleEmitter]")) {
+                if (!try_change_mode(trimmed, &mode, SIMPLE_SCENE_PARSE_MODE_ROOT, SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER)) {
+                    return false;
+                }
+                kzero_memory(&current_particle_emitter_config, sizeof(particle_emitter_simple_scene_config));
+            } else if (strings_equali(trimmed, "[/ParticleEmitter]")) {
+                if (!try_change_mode(trimmed, &mode, SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER, SIMPLE_SCENE_PARSE_MODE_ROOT)) {
+                    return false;
+                }
+                if (!current_particle_emitter_config.name || !current_particle_emitter_config.resource_name) {
+                    KWARN("Format error: Particle emitters require both name and resource name. Particle emitter not added.");
+                    continue;
+                }
+                // Push into the array, then cleanup.
+                darray_push(resource_data->particle_emitters, current_particle_emitter_config);
+                kzero_memory(&current_particle_emitter_config, sizeof(particle_emitter_simple_scene_config));
+            } else if (strings_equali(trimmed, "[SkinnedMesh]")) {
+                if (!try_change_mode(trimmed, &mode, SIMPLE_SCENE_PARSE_MODE_ROOT, SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH)) {
+                    return false;
+                }
+                kzero_memory(&current_skinned_mesh_config, sizeof(skinned_mesh_simple_scene_config));
+                // Also setup a default transform.
+                current_skinned_mesh_config.transform = transform_create();
+            } else if (strings_equali(trimmed, "[/SkinnedMesh]")) {
+                if (!try_change_mode(trimmed, &mode, SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH, SIMPLE_SCENE_PARSE_MODE_ROOT)) {
+                    return false;
+                }
+                if (!current_skinned_mesh_config.name || !current_skinned_mesh_config.resource_name) {
+                    KWARN("Format error: Skinned meshes require both name and resource name. Skinned mesh not added.");
+                    continue;
+                }
+                // Push into the array, then cleanup.
+                darray_push(resource_data->skinned_meshes, current_skinned_mesh_config);
+                kzero_memory(&current_skinned_mesh_config, sizeof(skinned_mesh_simple_scene_config));
             } else {
                 KERROR("Error loading simple scene file: format error. Unexpected object type '%s'", trimmed);
                 return false;
@@ -216,6 +382,12 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                     case SIMPLE_SCENE_PARSE_MODE_TERRAIN:
                         current_terrain_config.name = string_duplicate(trimmed_value);
                         break;
+                    case SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER:
+                        current_particle_emitter_config.name = string_duplicate(trimmed_value);
+                        break;
+                    case SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH:
+                        current_skinned_mesh_config.name = string_duplicate(trimmed_value);
+                        break;
                 }
             } else if (strings_equali(trimmed_var_name, "colour")) {
                 switch (mode) {
@@ -252,9 +424,41 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                     current_mesh_config.resource_name = string_duplicate(trimmed_value);
                 } else if (mode == SIMPLE_SCENE_PARSE_MODE_TERRAIN) {
                     current_terrain_config.resource_name = string_duplicate(trimmed_value);
+                } else if (mode == SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER) {
+                    current_particle_emitter_config.resource_name = string_duplicate(trimmed_value);
+                } else if (mode == SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH) {
+                    current_skinned_mesh_config.resource_name = string_duplicate(trimmed_value);
                 } else {
                     KWARN("Format warning: Cannot process resource_name in the current mode.");
                 }
+            } else if (strings_equali(trimmed_var_name, "clip")) {
+                if (mode == SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH) {
+                    current_skinned_mesh_config.clip_name = string_duplicate(trimmed_value);
+                } else {
+                    KWARN("Format warning: Cannot process clip in the current mode.");
+                }
+            } else if (strings_equali(trimmed_var_name, "impostor")) {
+                if (mode == SIMPLE_SCENE_PARSE_MODE_MESH) {
+                    current_mesh_config.impostor_name = string_duplicate(trimmed_value);
+                } else {
+                    KWARN("Format warning: Cannot process impostor in the current mode.");
+                }
+            } else if (strings_equali(trimmed_var_name, "impostor_frames")) {
+                if (mode == SIMPLE_SCENE_PARSE_MODE_MESH) {
+                    if (!string_to_u32(trimmed_value, &current_mesh_config.impostor_frame_count)) {
+                        KWARN("Error parsing impostor_frames. Using default value.");
+                    }
+                } else {
+                    KWARN("Format warning: Cannot process impostor_frames in the current mode.");
+                }
+            } else if (strings_equali(trimmed_var_name, "impostor_distance")) {
+                if (mode == SIMPLE_SCENE_PARSE_MODE_MESH) {
+                    if (!string_to_f32(trimmed_value, &current_mesh_config.impostor_distance)) {
+                        KWARN("Error parsing impostor_distance. Using default value.");
+                    }
+                } else {
+                    KWARN("Format warning: Cannot process impostor_distance in the current mode.");
+                }
             } else if (strings_equali(trimmed_var_name, "parent")) {
                 if (mode == SIMPLE_SCENE_PARSE_MODE_MESH) {
                     current_mesh_config.parent_name = string_duplicate(trimmed_value);
@@ -276,6 +480,11 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                         KWARN("Error parsing point light position as vec4. Using default value");
                         current_point_light_config.position = vec4_zero();
                     }
+                } else if (mode == SIMPLE_SCENE_PARSE_MODE_PARTICLE_EMITTER) {
+                    if (!string_to_vec3(trimmed_value, &current_particle_emitter_config.position)) {
+                        KWARN("Error parsing particle emitter position as vec3. Using default value");
+                        current_particle_emitter_config.position = vec3_zero();
+                    }
                 } else {
                     KWARN("Format warning: Cannot process position in the current mode.");
                 }
@@ -288,6 +497,10 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
                     if (!string_to_transform(trimmed_value, &current_terrain_config.xform)) {
                         KWARN("Error parsing terrain transform. Using default value.");
                     }
+                } else if (mode == SIMPLE_SCENE_PARSE_MODE_SKINNED_MESH) {
+                    if (!string_to_transform(trimmed_value, &current_skinned_mesh_config.transform)) {
+                        KWARN("Error parsing skinned mesh transform. Using default value.");
+                    }
                 } else {
                     KWARN("Format warning: Cannot process transform in the current mode.");
                 }
@@ -330,15 +543,21 @@ static b8 simple_scene_loader_load(struct resource_loader* self, const char* nam
 
     filesystem_close(&f);
 
+    // Write a binary version, which will be loaded in the future.
+    char ksb_file_path[512];
+    string_format(ksb_file_path, format_str, resource_system_base_path(), self->type_path, name, ".ksb");
+    if (!simple_scene_config_write_binary(ksb_file_path, resource_data)) {
+        KWARN("simple_scene_loader_load - unable to write binary simple scene file '%s'. The text version will be loaded again next time.", ksb_file_path);
+    }
+
     out_resource->data = resource_data;
     out_resource->data_size = sizeof(simple_scene_config);
 
     return true;
 }
 
-static void simple_scene_loader_unload(struct resource_loader* self, resource* resource) {
-    simple_scene_config* data = (simple_scene_config*)resource->data;
-
+// Frees everything held by the given config, but not the config itself.
+static void simple_scene_config_free(simple_scene_config* data) {
     if (data->meshes) {
         u32 length = darray_length(data->meshes);
         for (u32 i = 0; i < length; ++i) {
@@ -348,6 +567,9 @@ static void simple_scene_loader_unload(struct resource_loader* self, resource* r
             if (data->meshes[i].parent_name) {
                 kfree(data->meshes[i].parent_name, string_length(data->meshes[i].parent_name) + 1, MEMORY_TAG_STRING);
             }
+            if (data->meshes[i].impostor_name) {
+                kfree(data->meshes[i].impostor_name, string_length(data->meshes[i].impostor_name) + 1, MEMORY_TAG_STRING);
+            }
             if (data->meshes[i].resource_name) {
                 kfree(data->meshes[i].resource_name, string_length(data->meshes[i].resource_name) + 1, MEMORY_TAG_STRING);
             }
@@ -363,6 +585,45 @@ static void simple_scene_loader_unload(struct resource_loader* self, resource* r
         }
         darray_destroy(data->point_lights);
     }
+    if (data->terrains) {
+        u32 length = darray_length(data->terrains);
+        for (u32 i = 0; i < length; ++i) {
+            if (data->terrains[i].name) {
+                kfree(data->terrains[i].name, string_length(data->terrains[i].name) + 1, MEMORY_TAG_STRING);
+            }
+            if (data->terrains[i].resource_name) {
+                kfree(data->terrains[i].resource_name, string_length(data->terrains[i].resource_name) + 1, MEMORY_TAG_STRING);
+            }
+        }
+        darray_destroy(data->terrains);
+    }
+    if (data->particle_emitters) {
+        u32 length = darray_length(data->particle_emitters);
+        for (u32 i = 0; i < length; ++i) {
+            if (data->particle_emitters[i].name) {
+                kfree(data->particle_emitters[i].name, string_length(data->particle_emitters[i].name) + 1, MEMORY_TAG_STRING);
+            }
+            if (data->particle_emitters[i].resource_name) {
+                kfree(data->particle_emitters[i].resource_name, string_length(data->particle_emitters[i].resource_name) + 1, MEMORY_TAG_STRING);
+            }
+        }
+        darray_destroy(data->particle_emitters);
+    }
+    if (data->skinned_meshes) {
+        u32 length = darray_length(data->skinned_meshes);
+        for (u32 i = 0; i < length; ++i) {
+            if (data->skinned_meshes[i].name) {
+                kfree(data->skinned_meshes[i].name, string_length(data->skinned_meshes[i].name) + 1, MEMORY_TAG_STRING);
+            }
+            if (data->skinned_meshes[i].resource_name) {
+                kfree(data->skinned_meshes[i].resource_name, string_length(data->skinned_meshes[i].resource_name) + 1, MEMORY_TAG_STRING);
+            }
+            if (data->skinned_meshes[i].clip_name) {
+                kfree(data->skinned_meshes[i].clip_name, string_length(data->skinned_meshes[i].clip_name) + 1, MEMORY_TAG_STRING);
+            }
+        }
+        darray_destroy(data->skinned_meshes);
+    }
 
     if (data->directional_light_config.name) {
         kfree(data->directional_light_config.name, string_length(data->directional_light_config.name) + 1, MEMORY_TAG_STRING);
@@ -382,6 +643,10 @@ static void simple_scene_loader_unload(struct resource_loader* self, resource* r
     if (data->description) {
         kfree(data->description, string_length(data->description) + 1, MEMORY_TAG_STRING);
     }
+}
+
+static void simple_scene_loader_unload(struct resource_loader* self, resource* resource) {
+    simple_scene_config_free((simple_scene_config*)resource->data);
 
     if (!resource_unload(self, resource, MEMORY_TAG_RESOURCE)) {
         KWARN("simple_scene_loader_unload called with nullptr for self or resource.");
@@ -408,3 +673,328 @@ static b8 try_change_mode(const char* value, simple_scene_parse_mode* current, s
         return true;
     }
 }
+
+// Obtains a copy of the string at the given offset of a ksb string table, or 0 for KSB_NO_STRING.
+static char* ksb_string_get(const char* table, u32 table_size, u32 offset, b8* out_valid) {
+    if (offset == KSB_NO_STRING) {
+        return 0;
+    }
+    if (offset >= table_size) {
+        *out_valid = false;
+        return 0;
+    }
+    // The table ends with a terminator, so every string within it is terminated.
+    return string_duplicate(table + offset);
+}
+
+// Indicates if the array of count elements of the given size at offset lies within a ksb file.
+static b8 ksb_array_valid(const file_mapping* mapping, u64 offset, u64 count, u64 element_size) {
+    return offset <= mapping->size && count * element_size <= mapping->size - offset;
+}
+
+static b8 load_ksb_file(const char* path, simple_scene_config* out_config) {
+    kzero_memory(out_config, sizeof(simple_scene_config));
+    out_config->point_lights = darray_create(point_light_simple_scene_config);
+    out_config->meshes = darray_create(mesh_simple_scene_config);
+    out_config->terrains = darray_create(terrain_simple_scene_config);
+    out_config->particle_emitters = darray_create(particle_emitter_simple_scene_config);
+    out_config->skinned_meshes = darray_create(skinned_mesh_simple_scene_config);
+
+    file_mapping mapping = {};
+    if (!filesystem_map(path, 0, 0, &mapping)) {
+        KERROR("Unable to map ksb file '%s'.", path);
+        return false;
+    }
+
+    b8 valid = true;
+    ksb_header header = {};
+    if (mapping.size < sizeof(ksb_header)) {
+        KERROR("KSB file '%s' is too small to hold its header.", path);
+        goto failed;
+    }
+    kcopy_memory(&header, mapping.data, sizeof(ksb_header));
+    if (header.version != KSB_VERSION) {
+        KWARN("KSB file '%s' has unsupported version %u.", path, header.version);
+        goto failed;
+    }
+    u64 transform_count = (u64)header.mesh_count + header.terrain_count + header.skinned_mesh_count;
+    if (!ksb_array_valid(&mapping, header.string_table_offset, header.string_table_size, 1) ||
+        !ksb_array_valid(&mapping, header.point_lights_offset, header.point_light_count, sizeof(ksb_point_light)) ||
+        !ksb_array_valid(&mapping, header.meshes_offset, header.mesh_count, sizeof(ksb_mesh)) ||
+        !ksb_array_valid(&mapping, header.terrains_offset, header.terrain_count, sizeof(ksb_terrain)) ||
+        !ksb_array_valid(&mapping, header.particle_emitters_offset, header.particle_emitter_count, sizeof(ksb_particle_emitter)) ||
+        !ksb_array_valid(&mapping, header.skinned_meshes_offset, header.skinned_mesh_count, sizeof(ksb_skinned_mesh)) ||
+        !ksb_array_valid(&mapping, header.positions_offset, transform_count, sizeof(vec3)) ||
+        !ksb_array_valid(&mapping, header.rotations_offset, transform_count, sizeof(quat)) ||
+        !ksb_array_valid(&mapping, header.scales_offset, transform_count, sizeof(vec3))) {
+        KERROR("KSB file '%s' is truncated. Its data lies outside the file.", path);
+        goto failed;
+    }
+    const char* strings = (const char*)(mapping.data + header.string_table_offset);
+    u32 strings_size = header.string_table_size;
+    if (strings_size && strings[strings_size - 1] != 0) {
+        KERROR("KSB file '%s' has an unterminated string table.", path);
+        goto failed;
+    }
+
+    out_config->name = ksb_string_get(strings, strings_size, header.name, &valid);
+    out_config->description = ksb_string_get(strings, strings_size, header.description, &valid);
+    out_config->skybox_config.name = ksb_string_get(strings, strings_size, header.skybox_name, &valid);
+    out_config->skybox_config.cubemap_name = ksb_string_get(strings, strings_size, header.skybox_cubemap_name, &valid);
+    out_config->directional_light_config.name = ksb_string_get(strings, strings_size, header.directional_light_name, &valid);
+    out_config->directional_light_config.colour = header.directional_light_colour;
+    out_config->directional_light_config.direction = header.directional_light_direction;
+
+    for (u32 i = 0; i < header.point_light_count; ++i) {
+        ksb_point_light light;
+        kcopy_memory(&light, mapping.data + header.point_lights_offset + sizeof(ksb_point_light) * i, sizeof(ksb_point_light));
+        point_light_simple_scene_config config = {0};
+        config.name = ksb_string_get(strings, strings_size, light.name, &valid);
+        config.colour = light.colour;
+        config.position = light.position;
+        config.constant_f = light.constant_f;
+        config.linear = light.linear;
+        config.quadratic = light.quadratic;
+        darray_push(out_config->point_lights, config);
+    }
+
+    const u8* positions = mapping.data + header.positions_offset;
+    const u8* rotations = mapping.data + header.rotations_offset;
+    const u8* scales = mapping.data + header.scales_offset;
+    for (u64 i = 0; i < transform_count; ++i) {
+        vec3 position;
+        quat rotation;
+        vec3 scale;
+        kcopy_memory(&position, positions + sizeof(vec3) * i, sizeof(vec3));
+        kcopy_memory(&rotation, rotations + sizeof(quat) * i, sizeof(quat));
+        kcopy_memory(&scale, scales + sizeof(vec3) * i, sizeof(vec3));
+        transform xform = transform_from_position_rotation_scale(position, rotation, scale);
+
+        if (i < header.mesh_count) {
+            ksb_mesh mesh;
+            kcopy_memory(&mesh, mapping.data + header.meshes_offset + sizeof(ksb_mesh) * i, sizeof(ksb_mesh));
+            mesh_simple_scene_config config = {0};
+            config.name = ksb_string_get(strings, strings_size, mesh.name, &valid);
+            config.resource_name = ksb_string_get(strings, strings_size, mesh.resource_name, &valid);
+            config.parent_name = ksb_string_get(strings, strings_size, mesh.parent_name, &valid);
+            config.impostor_name = ksb_string_get(strings, strings_size, mesh.impostor_name, &valid);
+            config.impostor_frame_count = mesh.impostor_frame_count;
+            config.impostor_distance = mesh.impostor_distance;
+            config.transform = xform;
+            darray_push(out_config->meshes, config);
+        } else if (i < (u64)header.mesh_count + header.terrain_count) {
+            ksb_terrain terrain;
+            kcopy_memory(&terrain, mapping.data + header.terrains_offset + sizeof(ksb_terrain) * (i - header.mesh_count), sizeof(ksb_terrain));
+            terrain_simple_scene_config config = {0};
+            config.name = ksb_string_get(strings, strings_size, terrain.name, &valid);
+            config.resource_name = ksb_string_get(strings, strings_size, terrain.resource_name, &valid);
+            config.xform = xform;
+            darray_push(out_config->terrains, config);
+        } else {
+            ksb_skinned_mesh skinned;
+            u64 skinned_index = i - header.mesh_count - header.terrain_count;
+            kcopy_memory(&skinned, mapping.data + header.skinned_meshes_offset + sizeof(ksb_skinned_mesh) * skinned_index, sizeof(ksb_skinned_mesh));
+            skinned_mesh_simple_scene_config config = {0};
+            config.name = ksb_string_get(strings, strings_size, skinned.name, &valid);
+            config.resource_name = ksb_string_get(strings, strings_size, skinned.resource_name, &valid);
+            config.clip_name = ksb_string_get(strings, strings_size, skinned.clip_name, &valid);
+            config.transform = xform;
+            darray_push(out_config->skinned_meshes, config);
+        }
+    }
+
+    for (u32 i = 0; i < header.particle_emitter_count; ++i) {
+        ksb_particle_emitter emitter;
+        kcopy_memory(&emitter, mapping.data + header.particle_emitters_offset + sizeof(ksb_particle_emitter) * i, sizeof(ksb_particle_emitter));
+        particle_emitter_simple_scene_config config = {0};
+        config.name = ksb_string_get(strings, strings_size, emitter.name, &valid);
+        config.resource_name = ksb_string_get(strings, strings_size, emitter.resource_name, &valid);
+        config.position = emitter.position;
+        darray_push(out_config->particle_emitters, config);
+    }
+
+    if (!valid) {
+        KERROR("KSB file '%s' refers to strings outside its string table.", path);
+        goto failed;
+    }
+
+    filesystem_unmap(&mapping);
+    return true;
+
+failed:
+    filesystem_unmap(&mapping);
+    return false;
+}
+
+// Adds a string to the table being written, unless it is already there. Returns its offset, or KSB_NO_STRING for no string.
+static u32 ksb_string_add(char** table, const char* str) {
+    if (!str) {
+        return KSB_NO_STRING;
+    }
+    u64 table_size = darray_length(*table);
+    u64 offset = 0;
+    while (offset < table_size) {
+        const char* existing = *table + offset;
+        if (strings_equal(existing, str)) {
+            return (u32)offset;
+        }
+        offset += string_length(existing) + 1;
+    }
+    u32 length = string_length(str);
+    for (u32 i = 0; i <= length; ++i) {
+        darray_push(*table, str[i]);
+    }
+    return (u32)table_size;
+}
+
+b8 simple_scene_config_write_binary(const char* path, const simple_scene_config* config) {
+    if (!path || !config) {
+        return false;
+    }
+
+    u32 point_light_count = config->point_lights ? darray_length(config->point_lights) : 0;
+    u32 mesh_count = config->meshes ? darray_length(config->meshes) : 0;
+    u32 terrain_count = config->terrains ? darray_length(config->terrains) : 0;
+    u32 particle_emitter_count = config->particle_emitters ? darray_length(config->particle_emitters) : 0;
+    u32 skinned_mesh_count = config->skinned_meshes ? darray_length(config->skinned_meshes) : 0;
+    u32 transform_count = mesh_count + terrain_count + skinned_mesh_count;
+
+    ksb_header header = {};
+    header.version = KSB_VERSION;
+    header.point_light_count = point_light_count;
+    header.mesh_count = mesh_count;
+    header.terrain_count = terrain_count;
+    header.particle_emitter_count = particle_emitter_count;
+    header.skinned_mesh_count = skinned_mesh_count;
+
+    // Gather the strings and elements of each array.
+    char* strings = darray_create(char);
+    header.name = ksb_string_add(&strings, config->name);
+    header.description = ksb_string_add(&strings, config->description);
+    header.skybox_name = ksb_string_add(&strings, config->skybox_config.name);
+    header.skybox_cubemap_name = ksb_string_add(&strings, config->skybox_config.cubemap_name);
+    header.directional_light_name = ksb_string_add(&strings, config->directional_light_config.name);
+    header.directional_light_colour = config->directional_light_config.colour;
+    header.directional_light_direction = config->directional_light_config.direction;
+
+    ksb_point_light* point_lights = kallocate(sizeof(ksb_point_light) * KMAX(point_light_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < point_light_count; ++i) {
+        const point_light_simple_scene_config* light = &config->point_lights[i];
+        point_lights[i].name = ksb_string_add(&strings, light->name);
+        point_lights[i].colour = light->colour;
+        point_lights[i].position = light->position;
+        point_lights[i].constant_f = light->constant_f;
+        point_lights[i].linear = light->linear;
+        point_lights[i].quadratic = light->quadratic;
+    }
+
+    ksb_mesh* meshes = kallocate(sizeof(ksb_mesh) * KMAX(mesh_count, 1), MEMORY_TAG_ARRAY);
+    ksb_terrain* terrains = kallocate(sizeof(ksb_terrain) * KMAX(terrain_count, 1), MEMORY_TAG_ARRAY);
+    vec3* positions = kallocate(sizeof(vec3) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+    quat* rotations = kallocate(sizeof(quat) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+    vec3* scales = kallocate(sizeof(vec3) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        const mesh_simple_scene_config* mesh = &config->meshes[i];
+        meshes[i].name = ksb_string_add(&strings, mesh->name);
+        meshes[i].resource_name = ksb_string_add(&strings, mesh->resource_name);
+        meshes[i].parent_name = ksb_string_add(&strings, mesh->parent_name);
+        meshes[i].impostor_name = ksb_string_add(&strings, mesh->impostor_name);
+        meshes[i].impostor_frame_count = mesh->impostor_frame_count;
+        meshes[i].impostor_distance = mesh->impostor_distance;
+        positions[i] = mesh->transform.position;
+        rotations[i] = mesh->transform.rotation;
+        scales[i] = mesh->transform.scale;
+    }
+    for (u32 i = 0; i < terrain_count; ++i) {
+        const terrain_simple_scene_config* terrain = &config->terrains[i];
+        terrains[i].name = ksb_string_add(&strings, terrain->name);
+        terrains[i].resource_name = ksb_string_add(&strings, terrain->resource_name);
+        positions[mesh_count + i] = terrain->xform.position;
+        rotations[mesh_count + i] = terrain->xform.rotation;
+        scales[mesh_count + i] = terrain->xform.scale;
+    }
+    ksb_skinned_mesh* skinned_meshes = kallocate(sizeof(ksb_skinned_mesh) * KMAX(skinned_mesh_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < skinned_mesh_count; ++i) {
+        const skinned_mesh_simple_scene_config* skinned = &config->skinned_meshes[i];
+        u32 transform_index = mesh_count + terrain_count + i;
+        skinned_meshes[i].name = ksb_string_add(&strings, skinned->name);
+        skinned_meshes[i].resource_name = ksb_string_add(&strings, skinned->resource_name);
+        skinned_meshes[i].clip_name = ksb_string_add(&strings, skinned->clip_name);
+        positions[transform_index] = skinned->transform.position;
+        rotations[transform_index] = skinned->transform.rotation;
+        scales[transform_index] = skinned->transform.scale;
+    }
+
+    ksb_particle_emitter* particle_emitters = kallocate(sizeof(ksb_particle_emitter) * KMAX(particle_emitter_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < particle_emitter_count; ++i) {
+        const particle_emitter_simple_scene_config* emitter = &config->particle_emitters[i];
+        particle_emitters[i].name = ksb_string_add(&strings, emitter->name);
+        particle_emitters[i].resource_name = ksb_string_add(&strings, emitter->resource_name);
+        particle_emitters[i].position = emitter->position;
+    }
+    header.string_table_size = darray_length(strings);
+
+    // Lay out the file: the header, then each array aligned.
+    u64 file_size = sizeof(ksb_header);
+    header.string_table_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.string_table_offset + header.string_table_size;
+    header.point_lights_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.point_lights_offset + sizeof(ksb_point_light) * point_light_count;
+    header.meshes_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.meshes_offset + sizeof(ksb_mesh) * mesh_count;
+    header.terrains_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.terrains_offset + sizeof(ksb_terrain) * terrain_count;
+    header.particle_emitters_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.particle_emitters_offset + sizeof(ksb_particle_emitter) * particle_emitter_count;
+    header.skinned_meshes_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.skinned_meshes_offset + sizeof(ksb_skinned_mesh) * skinned_mesh_count;
+    header.positions_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.positions_offset + sizeof(vec3) * transform_count;
+    header.rotations_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.rotations_offset + sizeof(quat) * transform_count;
+    header.scales_offset = get_aligned(file_size, KSB_DATA_ALIGNMENT);
+    file_size = header.scales_offset + sizeof(vec3) * transform_count;
+    header.file_size = file_size;
+
+    // Build the file in memory, so it is written with a single call.
+    u8* data = kallocate(file_size, MEMORY_TAG_ARRAY);
+    kcopy_memory(data, &header, sizeof(ksb_header));
+    kcopy_memory(data + header.string_table_offset, strings, header.string_table_size);
+    kcopy_memory(data + header.point_lights_offset, point_lights, sizeof(ksb_point_light) * point_light_count);
+    kcopy_memory(data + header.meshes_offset, meshes, sizeof(ksb_mesh) * mesh_count);
+    kcopy_memory(data + header.terrains_offset, terrains, sizeof(ksb_terrain) * terrain_count);
+    kcopy_memory(data + header.particle_emitters_offset, particle_emitters, sizeof(ksb_particle_emitter) * particle_emitter_count);
+    kcopy_memory(data + header.skinned_meshes_offset, skinned_meshes, sizeof(ksb_skinned_mesh) * skinned_mesh_count);
+    kcopy_memory(data + header.positions_offset, positions, sizeof(vec3) * transform_count);
+    kcopy_memory(data + header.rotations_offset, rotations, sizeof(quat) * transform_count);
+    kcopy_memory(data + header.scales_offset, scales, sizeof(vec3) * transform_count);
+
+    darray_destroy(strings);
+    kfree(point_lights, sizeof(ksb_point_light) * KMAX(point_light_count, 1), MEMORY_TAG_ARRAY);
+    kfree(meshes, sizeof(ksb_mesh) * KMAX(mesh_count, 1), MEMORY_TAG_ARRAY);
+    kfree(terrains, sizeof(ksb_terrain) * KMAX(terrain_count, 1), MEMORY_TAG_ARRAY);
+    kfree(particle_emitters, sizeof(ksb_particle_emitter) * KMAX(particle_emitter_count, 1), MEMORY_TAG_ARRAY);
+    kfree(skinned_meshes, sizeof(ksb_skinned_mesh) * KMAX(skinned_mesh_count, 1), MEMORY_TAG_ARRAY);
+    kfree(positions, sizeof(vec3) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+    kfree(rotations, sizeof(quat) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+    kfree(scales, sizeof(vec3) * KMAX(transform_count, 1), MEMORY_TAG_ARRAY);
+
+    if (filesystem_exists(path)) {
+        KINFO("File '%s' already exists and will be overwritten.", path);
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Error opening ksb file '%s' for writing.", path);
+        kfree(data, file_size, MEMORY_TAG_ARRAY);
+        return false;
+    }
+    u64 written = 0;
+    b8 result = filesystem_write(&f, file_size, data, &written) && written == file_size;
+    if (!result) {
+        KERROR("Error writing ksb file '%s'.", path);
+    }
+    filesystem_close(&f);
+    kfree(data, file_size, MEMORY_TAG_ARRAY);
+    return result;
+}
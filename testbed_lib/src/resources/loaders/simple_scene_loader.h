@@ -1,7 +1,8 @@
 /**
  * @file simple_scene_loader.h
  * @author Travis Vroman (travis@kohiengine.com)
- * @brief Loader for simple scene files.
+ * @brief Loader for simple scene files. Text (.kss) files are written out as binary (.ksb) files
+ * when loaded, which are loaded in their place from then on.
  * @version 1.0
  * @date 2023-03-29
  * 
@@ -18,4 +19,15 @@
  * 
  * @return The newly created resource loader.
  */
-resource_loader simple_scene_resource_loader_create(void);
\ No newline at end of file
+resource_loader simple_scene_resource_loader_create(void);
+
+struct simple_scene_config;
+
+/**
+ * @brief Writes the given simple scene configuration to a binary simple scene (.ksb) file.
+ * 
+ * @param path The path of the file to be written. Overwritten if it exists.
+ * @param config A constant pointer to the configuration to be written.
+ * @return True on success; otherwise false.
+ */
+b8 simple_scene_config_write_binary(const char* path, const struct simple_scene_config* config);
@@ -2,26 +2,39 @@
 
 #include "../testbed_types.h"
 #include "containers/darray.h"
+#include "core/event.h"
 #include "core/frame_data.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "defines.h"
 #include "math/geometry_3d.h"
+#include "math/geometry_utils.h"
 #include "math/kmath.h"
 #include "math/math_types.h"
 #include "math/transform.h"
 #include "renderer/camera.h"
+#include "renderer/debug_draw.h"
+#include "renderer/occlusion_buffer.h"
+#include "renderer/renderer_frontend.h"
 #include "renderer/renderer_types.h"
+#include "renderer/renderer_utils.h"
 #include "renderer/viewport.h"
 #include "resources/debug/debug_box3d.h"
 #include "resources/debug/debug_line3d.h"
+#include "resources/loaders/simple_scene_loader.h"
 #include "resources/mesh.h"
 #include "resources/resource_types.h"
 #include "resources/skybox.h"
+#include "resources/particle_emitter.h"
+#include "resources/skeletal_mesh.h"
 #include "resources/terrain.h"
+#include "systems/geometry_system.h"
 #include "systems/light_system.h"
+#include "systems/job_system.h"
+#include "systems/material_system.h"
 #include "systems/resource_system.h"
+#include "systems/texture_system.h"
 #include "utils/ksort.h"
 
 static void
@@ -34,27 +47,78 @@ typedef struct simple_scene_debug_data {
     debug_line3d line;
 } simple_scene_debug_data;
 
-/** @brief A private structure used to sort geometry by distance from the camera. */
-typedef struct geometry_distance {
-    /** @brief The geometry render data. */
-    geometry_render_data g;
-    /** @brief The distance from the camera. */
-    f32 distance;
-} geometry_distance;
-
-static i32 geometry_render_data_compare(void *a, void *b) {
-    geometry_render_data *a_typed = a;
-    geometry_render_data *b_typed = b;
-    if (!a_typed->material || !b_typed->material) {
-        return 0;  // Don't sort invalid entries.
+// Points the transform component of each mesh at its transform. Needed whenever meshes are added or
+// removed, as they are held by value and so move.
+static void mesh_components_transforms_refresh(simple_scene *scene) {
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        c->transforms[i] = &scene->meshes[i].transform;
     }
-    return a_typed->material->id - b_typed->material->id;
+    c->transforms_moved = true;
+}
+
+// Adds the components of the mesh just pushed onto the end of the scene's meshes. Its bounds and
+// renderable components are filled in once its geometry is uploaded.
+static void mesh_components_push(simple_scene *scene) {
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    u8 flags = SIMPLE_SCENE_MESH_FLAG_LOADING;
+    darray_push(c->flags, flags);
+    transform *t = 0;
+    darray_push(c->transforms, t);
+    extents_3d extents = {0};
+    darray_push(c->extents, extents);
+    u16 geometry_count = 0;
+    darray_push(c->geometry_counts, geometry_count);
+    geometry **geometries = 0;
+    darray_push(c->geometries, geometries);
+    mesh_components_transforms_refresh(scene);
+}
+
+// Removes the components of the mesh at the given index, which is being removed from the scene's meshes.
+static void mesh_components_remove(simple_scene *scene, u32 index) {
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    u8 flags;
+    darray_pop_at(c->flags, index, &flags);
+    transform *t;
+    darray_pop_at(c->transforms, index, &t);
+    extents_3d extents;
+    darray_pop_at(c->extents, index, &extents);
+    u16 geometry_count;
+    darray_pop_at(c->geometry_counts, index, &geometry_count);
+    geometry **geometries;
+    darray_pop_at(c->geometries, index, &geometries);
+    mesh_components_transforms_refresh(scene);
+}
+
+// Copies the bounds and renderable components of the mesh at the given index, whose geometry is all uploaded.
+static void mesh_components_renderable_set(simple_scene *scene, u32 index) {
+    const mesh *m = &scene->meshes[index];
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    c->flags[index] |= SIMPLE_SCENE_MESH_FLAG_LOADED;
+    c->extents[index] = m->extents;
+    c->geometry_counts[index] = m->geometry_count;
+    c->geometries[index] = m->geometries;
 }
 
-static i32 geometry_distance_compare(void *a, void *b) {
-    geometry_distance *a_typed = a;
-    geometry_distance *b_typed = b;
-    return a_typed->distance - b_typed->distance;
+// Checks the meshes still loading for geometry to upload. Only these are read from, and only
+// their flags to find them.
+static void mesh_components_loading_update(simple_scene *scene) {
+    u8 *flags = scene->mesh_components.flags;
+    u32 mesh_count = darray_length(flags);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (!(flags[i] & SIMPLE_SCENE_MESH_FLAG_LOADING)) {
+            continue;
+        }
+        const mesh *m = &scene->meshes[i];
+        if (mesh_upload_pending(m)) {
+            flags[i] = (flags[i] & ~SIMPLE_SCENE_MESH_FLAG_LOADING) | SIMPLE_SCENE_MESH_FLAG_UPLOAD_PENDING;
+        } else if (m->generation != INVALID_ID_U8 && !(flags[i] & SIMPLE_SCENE_MESH_FLAG_LOADED)) {
+            // Meshes built from geometry configs are uploaded as they load.
+            flags[i] &= ~SIMPLE_SCENE_MESH_FLAG_LOADING;
+            mesh_components_renderable_set(scene, i);
+        }
+    }
 }
 
 b8 simple_scene_create(void *config, simple_scene *out_scene) {
@@ -75,7 +139,17 @@ b8 simple_scene_create(void *config, simple_scene *out_scene) {
     out_scene->dir_light = 0;
     out_scene->point_lights = darray_create(point_light);
     out_scene->meshes = darray_create(mesh);
+    out_scene->mesh_components.flags = darray_create(u8);
+    out_scene->mesh_components.transforms = darray_create(transform *);
+    out_scene->mesh_components.extents = darray_create(extents_3d);
+    out_scene->mesh_components.geometry_counts = darray_create(u16);
+    out_scene->mesh_components.geometries = darray_create(geometry **);
     out_scene->terrains = darray_create(terrain);
+    out_scene->emitters = darray_create(particle_emitter);
+    out_scene->skinned_meshes = darray_create(simple_scene_skinned_mesh);
+    out_scene->animators = darray_create(skeletal_animator);
+    out_scene->pending_meshes = darray_create(pending_mesh);
+    out_scene->upload_budget = SIMPLE_SCENE_DEFAULT_UPLOAD_BUDGET;
     out_scene->sb = 0;
 
     if (config) {
@@ -191,6 +265,11 @@ b8 simple_scene_initialize(simple_scene *scene) {
                 new_mesh_config.parent_name =
                     string_duplicate(scene->config->meshes[i].parent_name);
             }
+            if (scene->config->meshes[i].impostor_name) {
+                new_mesh_config.impostor_name = string_duplicate(scene->config->meshes[i].impostor_name);
+                new_mesh_config.impostor_frame_count = scene->config->meshes[i].impostor_frame_count;
+                new_mesh_config.impostor_distance = scene->config->meshes[i].impostor_distance;
+            }
             mesh new_mesh = {0};
             if (!mesh_create(new_mesh_config, &new_mesh)) {
                 KERROR("Failed to new mesh in simple scene.");
@@ -202,11 +281,15 @@ b8 simple_scene_initialize(simple_scene *scene) {
                     kfree(new_mesh_config.parent_name,
                           string_length(new_mesh_config.parent_name), MEMORY_TAG_STRING);
                 }
+                if (new_mesh_config.impostor_name) {
+                    string_free(new_mesh_config.impostor_name);
+                }
                 continue;
             }
             new_mesh.transform = scene->config->meshes[i].transform;
 
             darray_push(scene->meshes, new_mesh);
+            mesh_components_push(scene);
         }
 
         // Terrains
@@ -249,6 +332,74 @@ b8 simple_scene_initialize(simple_scene *scene) {
             darray_push(scene->terrains, new_terrain);
         }
 
+        // Particle emitters
+        u32 emitter_config_count = scene->config->particle_emitters ? darray_length(scene->config->particle_emitters) : 0;
+        for (u32 i = 0; i < emitter_config_count; ++i) {
+            particle_emitter_simple_scene_config *emitter_scene_config = &scene->config->particle_emitters[i];
+            resource emitter_resource;
+            if (!resource_system_load(emitter_scene_config->resource_name, RESOURCE_TYPE_PARTICLE_EMITTER, 0, &emitter_resource)) {
+                KWARN("Failed to load particle emitter resource '%s'.", emitter_scene_config->resource_name);
+                continue;
+            }
+
+            // Named as in the scene, so it can be found again when the scene is saved.
+            particle_emitter_config emitter_config = *(particle_emitter_config *)emitter_resource.data;
+            emitter_config.name = emitter_scene_config->name;
+
+            particle_emitter new_emitter = {0};
+            b8 created = particle_emitter_create(&emitter_config, emitter_scene_config->position, &new_emitter);
+            resource_system_unload(&emitter_resource);
+            if (!created) {
+                KWARN("Failed to create particle emitter '%s'.", emitter_scene_config->name);
+                continue;
+            }
+
+            darray_push(scene->emitters, new_emitter);
+        }
+
+        // Skinned meshes
+        u32 skinned_config_count = scene->config->skinned_meshes ? darray_length(scene->config->skinned_meshes) : 0;
+        for (u32 i = 0; i < skinned_config_count; ++i) {
+            skinned_mesh_simple_scene_config *skinned_config = &scene->config->skinned_meshes[i];
+            simple_scene_skinned_mesh new_skinned = {0};
+            if (!resource_system_load(skinned_config->resource_name, RESOURCE_TYPE_SKELETAL_MESH, 0, &new_skinned.mesh_resource)) {
+                KWARN("Failed to load skeletal mesh resource '%s'.", skinned_config->resource_name);
+                continue;
+            }
+            new_skinned.mesh = new_skinned.mesh_resource.data;
+            new_skinned.name = string_duplicate(skinned_config->name);
+            new_skinned.resource_name = string_duplicate(skinned_config->resource_name);
+            new_skinned.clip_name = skinned_config->clip_name ? string_duplicate(skinned_config->clip_name) : 0;
+            new_skinned.transform = skinned_config->transform;
+
+            // The geometries are uploaded now. Their configs stay with the mesh, which owns them.
+            new_skinned.geometry_count = new_skinned.mesh->geometry_count;
+            new_skinned.geometries = kallocate(sizeof(geometry *) * KMAX(new_skinned.geometry_count, 1), MEMORY_TAG_ARRAY);
+            for (u32 g = 0; g < new_skinned.geometry_count; ++g) {
+                new_skinned.geometries[g] = geometry_system_acquire_from_config(new_skinned.mesh->geometries[g], true);
+                if (!new_skinned.geometries[g]) {
+                    KWARN("Failed to create geometry %u of skeletal mesh '%s'.", g, new_skinned.name);
+                }
+            }
+
+            skeletal_animator animator;
+            skeletal_animator_create(new_skinned.mesh, &animator);
+            if (new_skinned.clip_name && !skeletal_animator_play(&animator, new_skinned.clip_name, true, 0.0f)) {
+                KWARN("Skeletal mesh '%s' has no clip '%s'. Its rest pose will be held.", new_skinned.name, new_skinned.clip_name);
+            }
+
+            darray_push(scene->skinned_meshes, new_skinned);
+            darray_push(scene->animators, animator);
+        }
+
+        // The palette is only sized once every animator is known.
+        u32 animator_count = darray_length(scene->animators);
+        if (animator_count) {
+            scene->skinning_palette_count = skeletal_animation_palette_assign(animator_count, scene->animators);
+            scene->skinning_palette = kallocate(sizeof(mat4) * scene->skinning_palette_count, MEMORY_TAG_ARRAY);
+            skeletal_animation_update(animator_count, scene->animators, 0.0f, scene->skinning_palette);
+        }
+
         if (!debug_grid_initialize(&scene->grid)) {
             return false;
         }
@@ -328,6 +479,24 @@ b8 simple_scene_initialize(simple_scene *scene) {
     return true;
 }
 
+// Reloads the mesh whose file changed, if it is in this scene.
+static b8 simple_scene_on_resource_changed(u16 code, void *sender, void *listener_inst, event_context context) {
+    simple_scene *scene = (simple_scene *)listener_inst;
+    u32 watch_id = context.data.u32[0];
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (scene->meshes[i].watch_id == watch_id) {
+            KINFO("Reloading mesh '%s'.", scene->meshes[i].name);
+            if (!mesh_reload(&scene->meshes[i])) {
+                KERROR("Failed to reload mesh '%s'.", scene->meshes[i].name);
+            }
+            scene->mesh_components.flags[i] |= SIMPLE_SCENE_MESH_FLAG_LOADING;
+            return true;
+        }
+    }
+    return false;
+}
+
 b8 simple_scene_load(simple_scene *scene) {
     if (!scene) {
         return false;
@@ -397,12 +566,138 @@ b8 simple_scene_load(simple_scene *scene) {
         }
     }
 
+    // Meshes are watched for changes once loaded, if hot reloading is enabled.
+    event_register(EVENT_CODE_WATCHED_RESOURCE_CHANGED, scene, simple_scene_on_resource_changed);
+
     // Update the state to show the scene is fully loaded.
     scene->state = SIMPLE_SCENE_STATE_LOADED;
 
     return true;
 }
 
+b8 simple_scene_save(simple_scene *scene, const char *path) {
+    if (!scene || !path) {
+        return false;
+    }
+
+    // Describe the scene as a configuration. Strings are only borrowed, since the config is just written.
+    simple_scene_config config = {0};
+    config.name = scene->name;
+    config.description = scene->description;
+    if (scene->sb) {
+        config.skybox_config.name = (scene->config && scene->config->skybox_config.name) ? scene->config->skybox_config.name : "skybox";
+        config.skybox_config.cubemap_name = (char *)scene->sb->config.cubemap_name;
+    }
+    if (scene->dir_light) {
+        config.directional_light_config.name = scene->dir_light->name;
+        config.directional_light_config.colour = scene->dir_light->data.colour;
+        config.directional_light_config.direction = scene->dir_light->data.direction;
+    }
+
+    config.point_lights = darray_create(point_light_simple_scene_config);
+    u32 point_light_count = darray_length(scene->point_lights);
+    for (u32 i = 0; i < point_light_count; ++i) {
+        point_light *light = &scene->point_lights[i];
+        point_light_simple_scene_config light_config = {0};
+        light_config.name = light->name;
+        light_config.colour = light->data.colour;
+        light_config.position = light->data.position;
+        light_config.constant_f = light->data.constant_f;
+        light_config.linear = light->data.linear;
+        light_config.quadratic = light->data.quadratic;
+        darray_push(config.point_lights, light_config);
+    }
+
+    config.meshes = darray_create(mesh_simple_scene_config);
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        mesh *m = &scene->meshes[i];
+        if (!m->config.name || !m->config.resource_name) {
+            continue;
+        }
+        mesh_simple_scene_config mesh_config = {0};
+        mesh_config.name = m->config.name;
+        mesh_config.resource_name = m->config.resource_name;
+        mesh_config.parent_name = m->config.parent_name;
+        mesh_config.impostor_name = m->config.impostor_name;
+        mesh_config.impostor_frame_count = m->config.impostor_frame_count;
+        mesh_config.impostor_distance = m->config.impostor_distance;
+        mesh_config.transform = m->transform;
+        darray_push(config.meshes, mesh_config);
+    }
+
+    config.terrains = darray_create(terrain_simple_scene_config);
+    u32 terrain_count = darray_length(scene->terrains);
+    u32 terrain_config_count = scene->config ? darray_length(scene->config->terrains) : 0;
+    for (u32 i = 0; i < terrain_count; ++i) {
+        terrain *t = &scene->terrains[i];
+        // Terrains are named by their resources, which may differ from the names given by the config.
+        terrain_simple_scene_config *source = 0;
+        for (u32 j = 0; j < terrain_config_count && t->name; ++j) {
+            terrain_simple_scene_config *candidate = &scene->config->terrains[j];
+            if ((candidate->name && strings_equal(candidate->name, t->name)) ||
+                (candidate->resource_name && strings_equal(candidate->resource_name, t->name))) {
+                source = candidate;
+                break;
+            }
+        }
+        if (!source) {
+            KWARN("Terrain '%s' has no resource name and will not be saved.", t->name ? t->name : "");
+            continue;
+        }
+        terrain_simple_scene_config terrain_config = {0};
+        terrain_config.name = source->name;
+        terrain_config.resource_name = source->resource_name;
+        terrain_config.xform = t->xform;
+        darray_push(config.terrains, terrain_config);
+    }
+
+    config.particle_emitters = darray_create(particle_emitter_simple_scene_config);
+    u32 emitter_count = darray_length(scene->emitters);
+    u32 emitter_config_count = (scene->config && scene->config->particle_emitters) ? darray_length(scene->config->particle_emitters) : 0;
+    for (u32 i = 0; i < emitter_count; ++i) {
+        particle_emitter *e = &scene->emitters[i];
+        particle_emitter_simple_scene_config *source = 0;
+        for (u32 j = 0; j < emitter_config_count; ++j) {
+            particle_emitter_simple_scene_config *candidate = &scene->config->particle_emitters[j];
+            if (candidate->name && strings_equal(candidate->name, e->config.name)) {
+                source = candidate;
+                break;
+            }
+        }
+        if (!source) {
+            KWARN("Particle emitter '%s' has no resource name and will not be saved.", e->config.name ? e->config.name : "");
+            continue;
+        }
+        particle_emitter_simple_scene_config emitter_config = {0};
+        emitter_config.name = source->name;
+        emitter_config.resource_name = source->resource_name;
+        emitter_config.position = e->position;
+        darray_push(config.particle_emitters, emitter_config);
+    }
+
+    config.skinned_meshes = darray_create(skinned_mesh_simple_scene_config);
+    u32 skinned_count = darray_length(scene->skinned_meshes);
+    for (u32 i = 0; i < skinned_count; ++i) {
+        simple_scene_skinned_mesh *skinned = &scene->skinned_meshes[i];
+        skinned_mesh_simple_scene_config skinned_config = {0};
+        skinned_config.name = skinned->name;
+        skinned_config.resource_name = skinned->resource_name;
+        skinned_config.clip_name = skinned->clip_name;
+        skinned_config.transform = skinned->transform;
+        darray_push(config.skinned_meshes, skinned_config);
+    }
+
+    b8 result = simple_scene_config_write_binary(path, &config);
+
+    darray_destroy(config.point_lights);
+    darray_destroy(config.meshes);
+    darray_destroy(config.terrains);
+    darray_destroy(config.particle_emitters);
+    darray_destroy(config.skinned_meshes);
+    return result;
+}
+
 b8 simple_scene_unload(simple_scene *scene, b8 immediate) {
     if (!scene) {
         return false;
@@ -419,6 +714,74 @@ b8 simple_scene_unload(simple_scene *scene, b8 immediate) {
     return true;
 }
 
+// Handlers are registered once the scene is loaded, and stay so until it is actually unloaded.
+static b8 simple_scene_handlers_registered(const simple_scene *scene) {
+    return scene->state == SIMPLE_SCENE_STATE_LOADED || scene->state == SIMPLE_SCENE_STATE_UNLOADING;
+}
+
+void simple_scene_on_lib_unload(simple_scene *scene) {
+    if (scene && simple_scene_handlers_registered(scene)) {
+        event_unregister(EVENT_CODE_WATCHED_RESOURCE_CHANGED, scene, simple_scene_on_resource_changed);
+    }
+}
+
+void simple_scene_on_lib_load(simple_scene *scene) {
+    if (scene && simple_scene_handlers_registered(scene)) {
+        event_register(EVENT_CODE_WATCHED_RESOURCE_CHANGED, scene, simple_scene_on_resource_changed);
+    }
+}
+
+/**
+ * @brief Uploads the geometry of loaded meshes within the scene's upload budget, nearest to
+ * the LOD view position first.
+ */
+static void simple_scene_mesh_uploads_update(simple_scene *scene) {
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    darray_clear(scene->pending_meshes);
+    u32 mesh_count = darray_length(c->flags);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (!(c->flags[i] & SIMPLE_SCENE_MESH_FLAG_UPLOAD_PENDING)) {
+            continue;
+        }
+
+        // Not yet in the bounds component until uploaded, but the extents are known once loaded.
+        const mesh *m = &scene->meshes[i];
+        vec3 center = vec3_mul_scalar(vec3_add(m->extents.min, m->extents.max), 0.5f);
+        vec3 world_center = vec3_mul_mat4(center, transform_world_get(c->transforms[i]));
+        pending_mesh pending = {i, vec3_distance(world_center, scene->lod_view_position)};
+        darray_push(scene->pending_meshes, pending);
+    }
+
+    // Uploads happen a few at a time, so picking the nearest each time is cheaper than sorting.
+    u64 remaining = scene->upload_budget;
+    u32 pending_count = darray_length(scene->pending_meshes);
+    while (pending_count) {
+        u32 nearest = 0;
+        for (u32 i = 1; i < pending_count; ++i) {
+            if (scene->pending_meshes[i].distance < scene->pending_meshes[nearest].distance) {
+                nearest = i;
+            }
+        }
+
+        u32 mesh_index = scene->pending_meshes[nearest].mesh_index;
+        mesh *m = &scene->meshes[mesh_index];
+        u64 uploaded = mesh_upload(m, remaining);
+        b8 done = !mesh_upload_pending(m);
+        if (done) {
+            c->flags[mesh_index] &= ~SIMPLE_SCENE_MESH_FLAG_UPLOAD_PENDING;
+            mesh_components_renderable_set(scene, mesh_index);
+        }
+        if (uploaded >= remaining || !done) {
+            break;
+        }
+        remaining -= uploaded;
+
+        // Done with this mesh, so swap the last one into its place.
+        pending_count--;
+        scene->pending_meshes[nearest] = scene->pending_meshes[pending_count];
+    }
+}
+
 b8 simple_scene_update(simple_scene *scene,
                        const struct frame_data *p_frame_data) {
     if (!scene) {
@@ -431,6 +794,9 @@ b8 simple_scene_update(simple_scene *scene,
     }
 
     if (scene->state >= SIMPLE_SCENE_STATE_LOADED) {
+        // Meshes may move from here on, so rays must be cast again.
+        scene->raycast_cache_valid = false;
+
         // TODO: Update directional light, if changed.
         if (scene->dir_light && scene->dir_light->debug_data) {
             simple_scene_debug_data *debug = scene->dir_light->debug_data;
@@ -457,15 +823,29 @@ b8 simple_scene_update(simple_scene *scene,
             }
         }
 
+        mesh_components_loading_update(scene);
+        simple_scene_mesh_uploads_update(scene);
+
+        u32 emitter_count = darray_length(scene->emitters);
+        for (u32 i = 0; i < emitter_count; ++i) {
+            particle_emitter_update(&scene->emitters[i], p_frame_data->delta_time);
+        }
+
+        u32 animator_count = darray_length(scene->animators);
+        if (animator_count) {
+            skeletal_animation_update(animator_count, scene->animators, p_frame_data->delta_time, scene->skinning_palette);
+        }
+
         // Check meshes to see if they have debug data. If not, add it here and init/load it.
         // Doing this here because mesh loading is multi-threaded, and may not yet be available
         // even though the object is present in the scene.
-        u32 mesh_count = darray_length(scene->meshes);
+        u8 *mesh_flags = scene->mesh_components.flags;
+        u32 mesh_count = darray_length(mesh_flags);
         for (u32 i = 0; i < mesh_count; ++i) {
-            mesh *m = &scene->meshes[i];
-            if (m->generation == INVALID_ID_U8) {
+            if ((mesh_flags[i] & (SIMPLE_SCENE_MESH_FLAG_LOADED | SIMPLE_SCENE_MESH_FLAG_DEBUG)) != SIMPLE_SCENE_MESH_FLAG_LOADED) {
                 continue;
             }
+            mesh *m = &scene->meshes[i];
             if (!m->debug_data) {
                 m->debug_data = kallocate(sizeof(simple_scene_debug_data), MEMORY_TAG_RESOURCE);
                 simple_scene_debug_data *debug = m->debug_data;
@@ -493,12 +873,352 @@ b8 simple_scene_update(simple_scene *scene,
                     debug_box3d_extents_set(&debug->box, m->extents);
                 }
             }
+            if (m->debug_data) {
+                mesh_flags[i] |= SIMPLE_SCENE_MESH_FLAG_DEBUG;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The initial number of objects the GPU object buffer is sized for. Doubled as needed.
+#define SIMPLE_SCENE_INITIAL_OBJECT_CAPACITY 1024
+
+// The number of f32 arrays in the cull bounds, besides the models.
+#define CULL_BOUNDS_ARRAY_COUNT 13
+
+static u64 cull_bounds_size(u32 capacity) {
+    return (sizeof(mat4) + sizeof(f32) * CULL_BOUNDS_ARRAY_COUNT) * capacity;
+}
+
+// Obtains pointers to each of the f32 arrays of the bounds.
+static void cull_bounds_arrays_get(simple_scene_cull_bounds *bounds, f32 **out_arrays[CULL_BOUNDS_ARRAY_COUNT]) {
+    aabb_soa *boxes[2] = {&bounds->local, &bounds->world};
+    for (u32 i = 0; i < 2; ++i) {
+        out_arrays[i * 6 + 0] = &boxes[i]->center.x;
+        out_arrays[i * 6 + 1] = &boxes[i]->center.y;
+        out_arrays[i * 6 + 2] = &boxes[i]->center.z;
+        out_arrays[i * 6 + 3] = &boxes[i]->extents.x;
+        out_arrays[i * 6 + 4] = &boxes[i]->extents.y;
+        out_arrays[i * 6 + 5] = &boxes[i]->extents.z;
+    }
+    out_arrays[12] = &bounds->radii;
+}
+
+// Ensures the bounds have room for the given number of objects, keeping the existing ones. All
+// the arrays share a single allocation.
+static void cull_bounds_reserve(simple_scene_cull_bounds *bounds, u32 count) {
+    if (count <= bounds->capacity) {
+        return;
+    }
+    u32 new_capacity = bounds->capacity ? bounds->capacity * 2 : 64;
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+
+    simple_scene_cull_bounds new_bounds = {0};
+    new_bounds.capacity = new_capacity;
+    new_bounds.models = kallocate(cull_bounds_size(new_capacity), MEMORY_TAG_SCENE);
+    f32 **new_arrays[CULL_BOUNDS_ARRAY_COUNT];
+    cull_bounds_arrays_get(&new_bounds, new_arrays);
+    f32 *next = (f32 *)(new_bounds.models + new_capacity);
+    for (u32 i = 0; i < CULL_BOUNDS_ARRAY_COUNT; ++i) {
+        *new_arrays[i] = next;
+        next += new_capacity;
+    }
+
+    if (bounds->capacity) {
+        kcopy_memory(new_bounds.models, bounds->models, sizeof(mat4) * bounds->capacity);
+        f32 **arrays[CULL_BOUNDS_ARRAY_COUNT];
+        cull_bounds_arrays_get(bounds, arrays);
+        for (u32 i = 0; i < CULL_BOUNDS_ARRAY_COUNT; ++i) {
+            kcopy_memory(*new_arrays[i], *arrays[i], sizeof(f32) * bounds->capacity);
+        }
+        kfree(bounds->models, cull_bounds_size(bounds->capacity), MEMORY_TAG_SCENE);
+    }
+    *bounds = new_bounds;
+}
+
+static void cull_bounds_destroy(simple_scene_cull_bounds *bounds) {
+    if (bounds->capacity) {
+        kfree(bounds->models, cull_bounds_size(bounds->capacity), MEMORY_TAG_SCENE);
+    }
+    kzero_memory(bounds, sizeof(simple_scene_cull_bounds));
+}
+
+// Returns the boxes starting at the given index.
+static aabb_soa aabb_soa_offset(const aabb_soa *boxes, u32 offset) {
+    aabb_soa result = {
+        {boxes->center.x + offset, boxes->center.y + offset, boxes->center.z + offset},
+        {boxes->extents.x + offset, boxes->extents.y + offset, boxes->extents.z + offset}};
+    return result;
+}
+
+// Sets the local-space bounds of the object at the given index from its geometry.
+static void cull_bounds_local_set(simple_scene_cull_bounds *bounds, u32 index, const geometry *g) {
+    bounds->local.center.x[index] = g->center.x;
+    bounds->local.center.y[index] = g->center.y;
+    bounds->local.center.z[index] = g->center.z;
+    // The center is not necessarily the middle of the extents, so take the larger side.
+    bounds->local.extents.x[index] = KMAX(kabs(g->extents.max.x - g->center.x), kabs(g->center.x - g->extents.min.x));
+    bounds->local.extents.y[index] = KMAX(kabs(g->extents.max.y - g->center.y), kabs(g->center.y - g->extents.min.y));
+    bounds->local.extents.z[index] = KMAX(kabs(g->extents.max.z - g->center.z), kabs(g->center.z - g->extents.min.z));
+}
+
+typedef struct cull_bounds_update_context {
+    const simple_scene_cull_object *objects;
+    simple_scene_cull_bounds *bounds;
+} cull_bounds_update_context;
+
+// Transforms the bounds of a batch of geometries into world space. Each object is independent.
+static void cull_bounds_update_batch(u32 start, u32 end, void *user_data) {
+    cull_bounds_update_context *context = user_data;
+    // Bounds only change along with the transform. A batch with any changes is transformed as a
+    // whole, which is cheaper than picking out the changed objects.
+    b8 any_dirty = false;
+    for (u32 i = start; i < end && !any_dirty; ++i) {
+        any_dirty = context->objects[i].is_dirty;
+    }
+    if (!any_dirty) {
+        return;
+    }
+
+    simple_scene_cull_bounds *bounds = context->bounds;
+    aabb_soa local = aabb_soa_offset(&bounds->local, start);
+    aabb_soa world = aabb_soa_offset(&bounds->world, start);
+    aabb_transform_batch(end - start, bounds->models + start, &local, &world);
+    for (u32 i = start; i < end; ++i) {
+        // The sphere through the corners of the world-space box.
+        f32 x = bounds->world.extents.x[i];
+        f32 y = bounds->world.extents.y[i];
+        f32 z = bounds->world.extents.z[i];
+        bounds->radii[i] = ksqrt(x * x + y * y + z * z);
+    }
+}
+
+static extents_3d cull_bounds_world_extents_get(const simple_scene_cull_bounds *bounds, u32 index) {
+    vec3 center = {bounds->world.center.x[index], bounds->world.center.y[index], bounds->world.center.z[index]};
+    vec3 extents = {bounds->world.extents.x[index], bounds->world.extents.y[index], bounds->world.extents.z[index]};
+    return (extents_3d){vec3_sub(center, extents), vec3_add(center, extents)};
+}
+
+// Brings the BVH up to date with the world bounds of the cull objects. Changed objects are refit
+// in place, and objects added or removed are inserted or removed. Each of these lowers the quality
+// of the tree a little, so once there have been as many as there are objects, it is rebuilt.
+static void cull_bvh_update(simple_scene *scene, u32 object_count, struct frame_data *p_frame_data) {
+    u32 leaf_count = darray_length(scene->cull_bvh_leaves);
+    u32 change_count = leaf_count > object_count ? leaf_count - object_count : object_count - leaf_count;
+    u32 common_count = KMIN(leaf_count, object_count);
+    for (u32 i = 0; i < common_count; ++i) {
+        change_count += scene->cull_objects[i].is_dirty;
+    }
+    if (!change_count) {
+        return;
+    }
+
+    if (scene->cull_bvh_change_count + change_count >= object_count) {
+        extents_3d *world_extents = p_frame_data->allocator.allocate(sizeof(extents_3d) * KMAX(object_count, 1));
+        for (u32 i = 0; i < object_count; ++i) {
+            world_extents[i] = cull_bounds_world_extents_get(&scene->cull_bounds, i);
+        }
+        darray_clear(scene->cull_bvh_leaves);
+        for (u32 i = 0; i < object_count; ++i) {
+            u32 leaf = INVALID_ID;
+            darray_push(scene->cull_bvh_leaves, leaf);
+        }
+        bvh_build(&scene->cull_bvh, object_count, world_extents, 0, scene->cull_bvh_leaves);
+        scene->cull_bvh_change_count = 0;
+        return;
+    }
+
+    for (u32 i = object_count; i < leaf_count; ++i) {
+        bvh_remove(&scene->cull_bvh, scene->cull_bvh_leaves[i]);
+    }
+    for (u32 i = 0; i < common_count; ++i) {
+        if (scene->cull_objects[i].is_dirty) {
+            bvh_refit(&scene->cull_bvh, scene->cull_bvh_leaves[i], cull_bounds_world_extents_get(&scene->cull_bounds, i));
+        }
+    }
+    darray_length_set(scene->cull_bvh_leaves, common_count);
+    for (u32 i = leaf_count; i < object_count; ++i) {
+        u32 leaf = bvh_insert(&scene->cull_bvh, cull_bounds_world_extents_get(&scene->cull_bounds, i), i);
+        darray_push(scene->cull_bvh_leaves, leaf);
+    }
+    scene->cull_bvh_change_count += change_count;
+}
+
+// Ensures the GPU object buffer can hold the given number of objects, creating or growing it as needed.
+static b8 object_buffer_ensure_capacity(simple_scene *scene, u32 object_count) {
+    if (object_count <= scene->object_capacity) {
+        return true;
+    }
+
+    u32 new_capacity = scene->object_capacity ? scene->object_capacity : SIMPLE_SCENE_INITIAL_OBJECT_CAPACITY;
+    while (new_capacity < object_count) {
+        new_capacity *= 2;
+    }
+
+    u64 new_size = sizeof(simple_scene_gpu_object) * new_capacity;
+    if (!scene->object_capacity) {
+        if (!renderer_renderbuffer_create("renderbuffer_objectbuffer_scene", RENDERBUFFER_TYPE_STORAGE, new_size, RENDERBUFFER_TRACK_TYPE_NONE, &scene->object_buffer)) {
+            KERROR("Failed to create scene object buffer.");
+            return false;
+        }
+        renderer_renderbuffer_bind(&scene->object_buffer, 0);
+    } else if (!renderer_renderbuffer_resize(&scene->object_buffer, new_size)) {
+        // NOTE: Resizing preserves the existing contents, so clean entries need not be re-uploaded.
+        KERROR("Failed to resize scene object buffer.");
+        return false;
+    }
+
+    scene->object_capacity = new_capacity;
+    return true;
+}
+
+b8 simple_scene_culling_update(simple_scene *scene, struct frame_data *p_frame_data) {
+    if (!scene) {
+        return false;
+    }
+
+    if (!scene->cull_objects) {
+        scene->cull_objects = darray_create(simple_scene_cull_object);
+        scene->gpu_objects = darray_create(simple_scene_gpu_object);
+        transform_hierarchy_create(&scene->hierarchy);
+        bvh_create(&scene->cull_bvh);
+        scene->cull_bvh_leaves = darray_create(u32);
+    }
+
+    // Meshes are held by value, so their transforms move whenever meshes are added or removed.
+    // Rebuild the hierarchy when they have, then bring it up to date so each world matrix is
+    // computed at most once this frame.
+    simple_scene_mesh_components *c = &scene->mesh_components;
+    u32 mesh_count = darray_length(c->flags);
+    if (c->transforms_moved || darray_length(scene->hierarchy.transforms) != mesh_count) {
+        transform_hierarchy_clear(&scene->hierarchy);
+        for (u32 i = 0; i < mesh_count; ++i) {
+            transform_hierarchy_add(&scene->hierarchy, c->transforms[i]);
+        }
+        c->transforms_moved = false;
+    }
+    transform_hierarchy_update(&scene->hierarchy);
+
+    // Walk the renderable components of the meshes in order. An object whose slot is still held by
+    // the same geometry, and whose world transform and material are unchanged, is left untouched.
+    // Anything else is (re)computed and marked dirty. World matrices are read from the hierarchy.
+    u32 previous_count = darray_length(scene->cull_objects);
+    u32 object_count = 0;
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (!(c->flags[i] & SIMPLE_SCENE_MESH_FLAG_LOADED)) {
+            continue;
+        }
+        mesh *m = &scene->meshes[i];
+        transform *t = c->transforms[i];
+        u32 world_generation = transform_hierarchy_world_generation_get(&scene->hierarchy, t);
+        b8 model_resolved = false;
+        mat4 model;
+        b8 winding_inverted = false;
+        u16 geometry_count = c->geometry_counts[i];
+        geometry **geometries = c->geometries[i];
+        for (u32 j = 0; j < geometry_count; ++j, ++object_count) {
+            geometry *g = geometries[j];
+            // Geometry without a material is drawn with the default, so it indexes the default's parameters.
+            u32 material_id = g->material ? g->material->internal_id : material_system_get_default()->internal_id;
+
+            if (object_count < previous_count) {
+                simple_scene_cull_object *existing = &scene->cull_objects[object_count];
+                if (existing->m == m && existing->g == g && existing->world_generation == world_generation &&
+                    scene->gpu_objects[object_count].material_id == material_id) {
+                    existing->is_dirty = false;
+                    continue;
+                }
+            } else {
+                simple_scene_cull_object empty_object = {0};
+                darray_push(scene->cull_objects, empty_object);
+                simple_scene_gpu_object empty_gpu_object = {0};
+                darray_push(scene->gpu_objects, empty_gpu_object);
+                cull_bounds_reserve(&scene->cull_bounds, object_count + 1);
+            }
+
+            // Resolve the world matrix once per mesh, and only if something actually changed.
+            if (!model_resolved) {
+                model = transform_world_get(t);
+                winding_inverted = t->determinant < 0;
+                model_resolved = true;
+            }
+
+            simple_scene_cull_object *obj = &scene->cull_objects[object_count];
+            obj->winding_inverted = winding_inverted;
+            obj->m = m;
+            obj->g = g;
+            obj->world_generation = world_generation;
+            obj->is_dirty = true;
+            obj->updated_frame_number = p_frame_data->renderer_frame_number;
+
+            simple_scene_gpu_object *gpu_obj = &scene->gpu_objects[object_count];
+            gpu_obj->model = geometry_quantized_model_get(g, model);
+            gpu_obj->material_id = material_id;
+
+            scene->cull_bounds.models[object_count] = model;
+            cull_bounds_local_set(&scene->cull_bounds, object_count, g);
+        }
+    }
+
+    // Drop any slots no longer occupied (i.e. meshes were unloaded).
+    darray_length_set(scene->cull_objects, object_count);
+    darray_length_set(scene->gpu_objects, object_count);
+
+    // Then transform the bounds of the changed geometries in parallel.
+    cull_bounds_update_context context = {scene->cull_objects, &scene->cull_bounds};
+    job_parallel_for(object_count, 64, cull_bounds_update_batch, &context);
+    cull_bvh_update(scene, object_count, p_frame_data);
+
+    if (!object_count) {
+        return true;
+    }
+
+    // Upload the dirty objects, coalescing consecutive ones into a single range each.
+    if (!object_buffer_ensure_capacity(scene, object_count)) {
+        return false;
+    }
+    u32 i = 0;
+    while (i < object_count) {
+        if (!scene->cull_objects[i].is_dirty) {
+            i++;
+            continue;
+        }
+        u32 range_start = i;
+        while (i < object_count && scene->cull_objects[i].is_dirty) {
+            i++;
+        }
+        u64 offset = sizeof(simple_scene_gpu_object) * range_start;
+        u64 size = sizeof(simple_scene_gpu_object) * (i - range_start);
+        if (!renderer_renderbuffer_load_range(&scene->object_buffer, offset, size, &scene->gpu_objects[range_start])) {
+            KERROR("Failed to upload scene objects %u-%u.", range_start, i - 1);
+            return false;
         }
     }
 
     return true;
 }
 
+void simple_scene_upload_budget_set(simple_scene *scene, u64 budget) {
+    if (scene) {
+        scene->upload_budget = budget;
+    }
+}
+
+void simple_scene_lod_view_set(simple_scene *scene, vec3 view_position, f32 fov, f32 view_height) {
+    if (!scene) {
+        return;
+    }
+
+    scene->lod_view_position = view_position;
+    // An object of unit size at unit distance covers this many pixels.
+    f32 half_tan_fov = ktan(fov * 0.5f);
+    scene->lod_scale = half_tan_fov > 0 ? view_height / (2.0f * half_tan_fov) : 0;
+}
+
 b8 simple_scene_populate_render_packet(simple_scene *scene, struct camera *current_camera, viewport *v, struct frame_data *p_frame_data, struct render_packet *packet) {
     /* if (!scene || !packet) {
         return false;
@@ -679,35 +1399,85 @@ b8 simple_scene_populate_render_packet(simple_scene *scene, struct camera *curre
     return true;
 }
 
+// Tests the ray against the oriented extents of the mesh, adding a hit to the result if it does.
+static void mesh_raycast(mesh *m, const struct ray *r, struct raycast_result *out_result) {
+    mat4 model = transform_world_get(&m->transform);
+    f32 dist;
+    if (raycast_oriented_extents(m->extents, model, r, &dist)) {
+        // Hit
+        if (!out_result->hits) {
+            out_result->hits = darray_create(raycast_hit);
+        }
+
+        raycast_hit hit = {0};
+        hit.distance = dist;
+        hit.type = RAYCAST_HIT_TYPE_OBB;
+        hit.position = vec3_add(r->origin, vec3_mul_scalar(r->direction, hit.distance));
+        hit.unique_id = m->id.uniqueid;
+
+        darray_push(out_result->hits, hit);
+    }
+}
+
+typedef struct mesh_raycast_query {
+    simple_scene *scene;
+    const struct ray *r;
+    struct raycast_result *out_result;
+    // Flags for each mesh which has been tested, as several of its geometries may be found.
+    b8 *tested;
+} mesh_raycast_query;
+
+static b8 mesh_raycast_object_found(u32 index, void *context) {
+    mesh_raycast_query *query = context;
+    mesh *m = query->scene->cull_objects[index].m;
+    u32 mesh_index = (u32)(m - query->scene->meshes);
+    if (!query->tested[mesh_index]) {
+        query->tested[mesh_index] = true;
+        mesh_raycast(m, query->r, query->out_result);
+    }
+    return true;
+}
+
+// Copies the given hits into a new darray for the caller, if there are any.
+static raycast_hit *raycast_hits_copy(const raycast_hit *hits) {
+    if (!hits) {
+        return 0;
+    }
+    u32 length = darray_length((void *)hits);
+    raycast_hit *copy = darray_reserve(raycast_hit, length);
+    kcopy_memory(copy, hits, sizeof(raycast_hit) * length);
+    darray_length_set(copy, length);
+    return copy;
+}
+
 b8 simple_scene_raycast(simple_scene *scene, const struct ray *r, struct raycast_result *out_result) {
     if (!scene || !r || !out_result || scene->state < SIMPLE_SCENE_STATE_LOADED) {
         return false;
     }
 
+    // Editor interaction casts the same ray several times a frame (e.g. gizmo and selection), so
+    // reuse the last result while nothing can have moved.
+    if (scene->raycast_cache_valid && vec3_compare(r->origin, scene->raycast_cache_origin, 0.0f) && vec3_compare(r->direction, scene->raycast_cache_direction, 0.0f)) {
+        out_result->hits = raycast_hits_copy(scene->raycast_cache_hits);
+        return out_result->hits != 0;
+    }
+
     // Only create if needed.
     out_result->hits = 0;
 
-    // Iterate meshes in the scene.
-    // TODO: This needs to be optimized. We need some sort of spatial partitioning to speed this up.
-    // Otherwise a scene with thousands of objects will be super slow!
     u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
-        mat4 model = transform_world_get(&m->transform);
-        f32 dist;
-        if (raycast_oriented_extents(m->extents, model, r, &dist)) {
-            // Hit
-            if (!out_result->hits) {
-                out_result->hits = darray_create(raycast_hit);
-            }
-
-            raycast_hit hit = {0};
-            hit.distance = dist;
-            hit.type = RAYCAST_HIT_TYPE_OBB;
-            hit.position = vec3_add(r->origin, vec3_mul_scalar(r->direction, hit.distance));
-            hit.unique_id = m->id.uniqueid;
-
-            darray_push(out_result->hits, hit);
+    if (scene->cull_objects && mesh_count && !scene->mesh_components.transforms_moved && darray_length(scene->hierarchy.transforms) == mesh_count) {
+        // Only test the meshes whose geometry bounds are hit, as found through the BVH. The bounds
+        // are those of the last culling update, at most a frame old.
+        mesh_raycast_query query = {scene, r, out_result, 0};
+        query.tested = kallocate(sizeof(b8) * mesh_count, MEMORY_TAG_ARRAY);
+        bvh_query_ray(&scene->cull_bvh, r, mesh_raycast_object_found, &query);
+        kfree(query.tested, sizeof(b8) * mesh_count, MEMORY_TAG_ARRAY);
+    } else {
+        // The cull objects don't refer to the current meshes (e.g. none have been culled yet), so
+        // test all of them.
+        for (u32 i = 0; i < mesh_count; ++i) {
+            mesh_raycast(&scene->meshes[i], r, out_result);
         }
     }
 
@@ -730,6 +1500,16 @@ b8 simple_scene_raycast(simple_scene *scene, const struct ray *r, struct raycast
             }
         }
     }
+
+    // Remember the result for the rest of the frame.
+    if (scene->raycast_cache_hits) {
+        darray_destroy(scene->raycast_cache_hits);
+    }
+    scene->raycast_cache_hits = raycast_hits_copy(out_result->hits);
+    scene->raycast_cache_origin = r->origin;
+    scene->raycast_cache_direction = r->direction;
+    scene->raycast_cache_valid = true;
+
     return out_result->hits != 0;
 }
 
@@ -858,7 +1638,8 @@ b8 simple_scene_mesh_add(simple_scene *scene, const char *name,
         }
     }
 
-    darray_push(scene->meshes, m);
+    darray_push(scene->meshes, *m);
+    mesh_components_push(scene);
 
     return true;
 }
@@ -910,7 +1691,7 @@ b8 simple_scene_terrain_add(simple_scene *scene, const char *name,
         }
     }
 
-    darray_push(scene->terrains, t);
+    darray_push(scene->terrains, *t);
 
     return true;
 }
@@ -1009,6 +1790,7 @@ b8 simple_scene_mesh_remove(simple_scene *scene, const char *name) {
 
             mesh rubbish = {0};
             darray_pop_at(scene->meshes, i, &rubbish);
+            mesh_components_remove(scene, i);
 
             return true;
         }
@@ -1125,336 +1907,689 @@ struct terrain *simple_scene_terrain_get(simple_scene *scene,
     return 0;
 }
 
-b8 simple_scene_debug_render_data_query(simple_scene *scene, u32 *data_count, geometry_render_data **debug_geometries) {
-    if (!scene || !data_count) {
-        return false;
+void simple_scene_debug_draw(simple_scene *scene, debug_draw_batch *batch) {
+    if (!scene || !batch) {
+        return;
     }
 
-    *data_count = 0;
-
     // TODO: Check if grid exists.
-    {
-        if (debug_geometries) {
-            geometry_render_data data = {0};
-            data.model = mat4_identity();
+    debug_draw_vertices(batch, scene->grid.vertex_count, scene->grid.vertices, mat4_identity());
 
-            geometry *g = &scene->grid.geo;
-            data.material = g->material;
-            data.vertex_count = g->vertex_count;
-            data.vertex_buffer_offset = g->vertex_buffer_offset;
-            data.index_count = g->index_count;
-            data.index_buffer_offset = g->index_buffer_offset;
-            data.unique_id = INVALID_ID;
+    // Directional light.
+    if (scene->dir_light && scene->dir_light->debug_data) {
+        simple_scene_debug_data *debug = scene->dir_light->debug_data;
+        debug_draw_vertices(batch, debug->line.vertex_count, debug->line.vertices, transform_world_get(&debug->line.xform));
+    }
 
-            (*debug_geometries)[(*data_count)] = data;
+    // Point lights
+    u32 point_light_count = darray_length(scene->point_lights);
+    for (u32 i = 0; i < point_light_count; ++i) {
+        if (scene->point_lights[i].debug_data) {
+            simple_scene_debug_data *debug = (simple_scene_debug_data *)scene->point_lights[i].debug_data;
+            debug_draw_vertices(batch, debug->box.vertex_count, debug->box.vertices, transform_world_get(&debug->box.xform));
         }
-        (*data_count)++;
     }
 
-    // Directional light.
-    {
-        if (scene->dir_light && scene->dir_light->debug_data) {
-            if (debug_geometries) {
-                simple_scene_debug_data *debug = scene->dir_light->debug_data;
+    // Mesh debug shapes
+    u8 *mesh_flags = scene->mesh_components.flags;
+    u32 mesh_count = darray_length(mesh_flags);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        if (mesh_flags[i] & SIMPLE_SCENE_MESH_FLAG_DEBUG) {
+            simple_scene_debug_data *debug = (simple_scene_debug_data *)scene->meshes[i].debug_data;
+            debug_draw_vertices(batch, debug->box.vertex_count, debug->box.vertices, transform_world_get(&debug->box.xform));
+        }
+    }
+}
 
-                // Debug line 3d
-                geometry_render_data data = {0};
-                data.model = transform_world_get(&debug->line.xform);
-                geometry *g = &debug->line.geo;
-                data.material = g->material;
-                data.vertex_count = g->vertex_count;
-                data.vertex_buffer_offset = g->vertex_buffer_offset;
-                data.index_count = g->index_count;
-                data.index_buffer_offset = g->index_buffer_offset;
-                data.unique_id = debug->line.id.uniqueid;
+// Chooses the level of detail of a cull object: the least detail whose error, projected from the LOD view, stays
+// within SIMPLE_SCENE_LOD_MAX_ERROR_PIXELS; then lod_bias levels coarser. Errors are scaled from local to world
+// units by the ratio of the object's bounding radii.
+static u32 cull_object_lod_get(const simple_scene *scene, const simple_scene_cull_object *obj, u32 lod_bias) {
+    const geometry *g = obj->g;
+    if (g->lod_count < 2) {
+        return 0;
+    }
 
-                (*debug_geometries)[(*data_count)] = data;
+    u32 lod = 0;
+    if (scene->lod_scale > 0) {
+        u32 index = (u32)(obj - scene->cull_objects);
+        const simple_scene_cull_bounds *bounds = &scene->cull_bounds;
+        vec3 world_center = {bounds->world.center.x[index], bounds->world.center.y[index], bounds->world.center.z[index]};
+        f32 local_radius = vec3_length(vec3_sub(g->extents.max, g->extents.min)) * 0.5f;
+        f32 world_scale = local_radius > 0 ? bounds->radii[index] / local_radius : 1.0f;
+        f32 distance = vec3_distance(world_center, scene->lod_view_position) - bounds->radii[index];
+        if (distance > K_FLOAT_EPSILON) {
+            f32 pixels_per_unit = world_scale * scene->lod_scale / distance;
+            while (lod + 1 < g->lod_count && g->lods[lod + 1].error * pixels_per_unit <= SIMPLE_SCENE_LOD_MAX_ERROR_PIXELS) {
+                lod++;
             }
-            (*data_count)++;
         }
     }
+    return KMIN(lod + lod_bias, (u32)g->lod_count - 1);
+}
 
-    // Point lights
-    {
-        u32 point_light_count = darray_length(scene->point_lights);
-        for (u32 i = 0; i < point_light_count; ++i) {
-            if (scene->point_lights[i].debug_data) {
-                if (debug_geometries) {
-                    simple_scene_debug_data *debug = (simple_scene_debug_data *)scene->point_lights[i].debug_data;
+// Reports the size on screen of the textures of a cull object's material, so their mip levels can be streamed.
+// A texture is assumed to be stretched once across the object. Without a LOD view, full detail is requested.
+static void cull_object_textures_request(const simple_scene *scene, const simple_scene_cull_object *obj) {
+    material *m = obj->g->material;
+    if (!m || !m->maps) {
+        return;
+    }
 
-                    // Debug box 3d
-                    geometry_render_data data = {0};
-                    data.model = transform_world_get(&debug->box.xform);
-                    geometry *g = &debug->box.geo;
-                    data.material = g->material;
-                    data.vertex_count = g->vertex_count;
-                    data.vertex_buffer_offset = g->vertex_buffer_offset;
-                    data.index_count = g->index_count;
-                    data.index_buffer_offset = g->index_buffer_offset;
-                    data.unique_id = debug->box.id.uniqueid;
-
-                    (*debug_geometries)[(*data_count)] = data;
-                }
-                (*data_count)++;
-            }
+    f32 screen_size = K_FLOAT_MAX;
+    if (scene->lod_scale > 0) {
+        u32 index = (u32)(obj - scene->cull_objects);
+        const simple_scene_cull_bounds *bounds = &scene->cull_bounds;
+        vec3 world_center = {bounds->world.center.x[index], bounds->world.center.y[index], bounds->world.center.z[index]};
+        f32 distance = vec3_distance(world_center, scene->lod_view_position) - bounds->radii[index];
+        if (distance > K_FLOAT_EPSILON) {
+            screen_size = 2.0f * bounds->radii[index] * scene->lod_scale / distance;
         }
     }
 
-    // Mesh debug shapes
-    {
-        u32 mesh_count = darray_length(scene->meshes);
-        for (u32 i = 0; i < mesh_count; ++i) {
-            if (scene->meshes[i].debug_data) {
-                if (debug_geometries) {
-                    simple_scene_debug_data *debug = (simple_scene_debug_data *)scene->meshes[i].debug_data;
+    u32 map_count = darray_length(m->maps);
+    for (u32 i = 0; i < map_count; ++i) {
+        if (m->maps[i].texture) {
+            texture_system_streaming_request(m->maps[i].texture, screen_size);
+        }
+    }
+}
 
-                    // Debug box 3d
-                    geometry_render_data data = {0};
-                    data.model = transform_world_get(&debug->box.xform);
-                    geometry *g = &debug->box.geo;
-                    data.material = g->material;
-                    data.vertex_count = g->vertex_count;
-                    data.vertex_buffer_offset = g->vertex_buffer_offset;
-                    data.index_count = g->index_count;
-                    data.index_buffer_offset = g->index_buffer_offset;
-                    data.unique_id = debug->box.id.uniqueid;
-
-                    (*debug_geometries)[(*data_count)] = data;
-                }
-                (*data_count)++;
-            }
+// Indicates if a mesh is far enough from the LOD view to be drawn from its impostor, given its world matrix.
+// Decided by the mesh's origin, so every geometry of the mesh agrees. Never without a LOD view or loaded atlases.
+static b8 mesh_impostor_active(const simple_scene *scene, const mesh *m, const mat4 *model) {
+    if (!m->config.impostor_name || scene->lod_scale <= 0) {
+        return false;
+    }
+    if (!m->impostor_albedo || !m->impostor_normal || m->impostor_albedo->generation == INVALID_ID || m->impostor_normal->generation == INVALID_ID) {
+        return false;
+    }
+    vec3 origin = {model->data[12], model->data[13], model->data[14]};
+    return vec3_distance(origin, scene->lod_view_position) > m->config.impostor_distance;
+}
+
+static geometry_draw_record cull_object_draw_record_get(const simple_scene *scene, const simple_scene_cull_object *obj, u32 lod_bias, render_sort_layer layer, f32 depth) {
+    geometry *g = obj->g;
+    geometry_draw_record record = {0};
+    record.geometry = g;
+    record.object_index = (u32)(obj - scene->cull_objects);
+    record.winding_inverted = obj->winding_inverted;
+    if (g->lod_count) {
+        record.lod = (u16)cull_object_lod_get(scene, obj, lod_bias);
+    }
+    // Each LOD of a geometry is drawn as a geometry of its own, so they are kept apart for instancing.
+    material *m = g->material;
+    record.sort_key = render_sort_key_create(layer, m ? m->shader_id : 0, m ? m->id : 0, (g->id << 2) | record.lod, obj->winding_inverted, depth);
+    return record;
+}
+
+// Writes draw records for the clusters of a cull object's full-detail geometry which may be visible in a
+// frustum view: those within its frustum, and not wholly facing away from its center. Runs of consecutive
+// visible clusters share a single record, based on the given one. Returns the number of records written,
+// which is at most half the cluster count, rounded up.
+static u32 cull_object_cluster_records_get(const simple_scene *scene, const simple_scene_cull_view *view, const geometry_draw_record *record, geometry_draw_record *out_records) {
+    const geometry *g = record->geometry;
+    mat4 model = scene->cull_bounds.models[record->object_index];
+
+    // Normal cones only keep their shape under uniform scale, so they aren't used otherwise.
+    f32 scale_x = vec3_length(vec3_create(model.data[0], model.data[1], model.data[2]));
+    f32 scale_y = vec3_length(vec3_create(model.data[4], model.data[5], model.data[6]));
+    f32 scale_z = vec3_length(vec3_create(model.data[8], model.data[9], model.data[10]));
+    f32 max_scale = KMAX(scale_x, KMAX(scale_y, scale_z));
+    f32 min_scale = KMIN(scale_x, KMIN(scale_y, scale_z));
+    b8 cones_valid = max_scale - min_scale <= max_scale * 0.01f;
+
+    u32 count = 0;
+    b8 in_run = false;
+    for (u32 c = 0; c < g->cluster_count; ++c) {
+        const geometry_cluster *cluster = &g->clusters[c];
+        vec3 center = vec3_transform(cluster->center, 1.0f, model);
+        f32 radius = cluster->radius * max_scale;
+        b8 visible = frustum_intersects_sphere(view->f, &center, radius);
+        if (visible && cones_valid && cluster->cone_cutoff < 1.0f) {
+            vec3 axis = vec3_normalized(vec3_transform(cluster->cone_axis, 0.0f, model));
+            vec3 to_center = vec3_sub(center, view->center);
+            visible = vec3_dot(to_center, axis) < cluster->cone_cutoff * vec3_length(to_center) + radius;
+        }
+
+        if (!visible) {
+            in_run = false;
+        } else if (in_run) {
+            out_records[count - 1].index_count += cluster->index_count;
+        } else {
+            out_records[count] = *record;
+            out_records[count].first_index = cluster->index_offset;
+            out_records[count].index_count = cluster->index_count;
+            count++;
+            in_run = true;
         }
     }
+    return count;
+}
+
+// Pushes the given draw records onto the given darray in order of their sort keys, grouping those
+// which share state (and so can be drawn without rebinding, or instanced) and ordering transparent
+// ones back to front. Returns the darray, which may have been reallocated.
+static geometry_draw_record *geometry_draw_records_sorted_push(geometry_draw_record *out_records, const geometry_draw_record *unsorted, u32 count, frame_data *p_frame_data) {
+    if (!count) {
+        return out_records;
+    }
+
+    // The keys are sorted along with the index of their record.
+    u64 *keys = p_frame_data->allocator.allocate(sizeof(u64) * count * 2);
+    u32 *order = p_frame_data->allocator.allocate(sizeof(u32) * count * 2);
+    for (u32 i = 0; i < count; ++i) {
+        keys[i] = unsorted[i].sort_key;
+        order[i] = i;
+    }
+    kradix_sort_u64(count, keys, order, keys + count, order + count);
+
+    u32 length = darray_length(out_records);
+    darray_reserve_exact(out_records, length + count);
+    for (u32 i = 0; i < count; ++i) {
+        out_records[length + i] = unsorted[order[i]];
+    }
+    darray_length_set(out_records, length + count);
+    return out_records;
+}
+
+static b8 cull_object_has_transparency(const simple_scene_cull_object *obj) {
+    material *mat = obj->g->material;
+    if (mat->type == MATERIAL_TYPE_PBR) {
+        // Check diffuse map (slot 0).
+        return (mat->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) != 0;
+    }
+    return false;
+}
+
+typedef struct cull_views_query {
+    const simple_scene_cull_bounds *bounds;
+    u32 view_count;
+    const simple_scene_cull_view *views;
+    u32 *objects;
+    u8 *view_masks;
+} cull_views_query;
+
+// Tests the bounds of a BVH node against a single view. Must pass for any node holding an object
+// which passes the test in cull_views_object_mask.
+static b8 cull_view_bounds_test(const simple_scene_cull_view *view, const extents_3d *node_bounds) {
+    vec3 node_center = vec3_mul_scalar(vec3_add(node_bounds->min, node_bounds->max), 0.5f);
+    if (view->type == SIMPLE_SCENE_CULL_VIEW_TYPE_LINE) {
+        // The bounding sphere of anything within the node lies within K_SQRT_TWO times the node's own.
+        f32 node_radius = vec3_length(vec3_sub(node_bounds->max, node_center)) * K_SQRT_TWO;
+        return vec3_distance_to_line(node_center, view->center, view->direction) - node_radius <= view->radius;
+    }
+    if (view->type == SIMPLE_SCENE_CULL_VIEW_TYPE_SPHERE) {
+        f32 node_radius = vec3_length(vec3_sub(node_bounds->max, node_center)) * K_SQRT_TWO;
+        return vec3_distance(node_center, view->center) - node_radius <= view->radius;
+    }
+    if (!view->f) {
+        return true;
+    }
+    vec3 node_extents = vec3_mul_scalar(vec3_sub(node_bounds->max, node_bounds->min), 0.5f);
+    return frustum_intersects_aabb(view->f, &node_center, &node_extents);
+}
+
+// A node is visited if it may hold an object visible in any of the views.
+static b8 cull_views_bounds_test(const extents_3d *node_bounds, void *context) {
+    const cull_views_query *query = context;
+    for (u32 v = 0; v < query->view_count; ++v) {
+        if (cull_view_bounds_test(&query->views[v], node_bounds)) {
+            return true;
+        }
+    }
+    return false;
+}
 
+// Tests an object against every view, returning a mask of the views it is visible in.
+static u8 cull_views_object_mask(const cull_views_query *query, u32 index) {
+    const simple_scene_cull_bounds *bounds = query->bounds;
+    vec3 center = {bounds->world.center.x[index], bounds->world.center.y[index], bounds->world.center.z[index]};
+    vec3 extents = {bounds->world.extents.x[index], bounds->world.extents.y[index], bounds->world.extents.z[index]};
+    f32 radius = bounds->radii[index];
+
+    u8 mask = 0;
+    for (u32 v = 0; v < query->view_count; ++v) {
+        const simple_scene_cull_view *view = &query->views[v];
+        b8 visible;
+        if (view->type == SIMPLE_SCENE_CULL_VIEW_TYPE_LINE) {
+            visible = vec3_distance_to_line(center, view->center, view->direction) - radius <= view->radius;
+        } else if (view->type == SIMPLE_SCENE_CULL_VIEW_TYPE_SPHERE) {
+            visible = vec3_distance(center, view->center) - radius <= view->radius;
+        } else {
+            visible = !view->f || frustum_intersects_aabb(view->f, &center, &extents);
+        }
+        if (visible) {
+            mask |= (u8)(1u << v);
+        }
+    }
+    return mask;
+}
+
+static b8 cull_views_object_found(u32 index, void *context) {
+    cull_views_query *query = context;
+    u8 mask = cull_views_object_mask(query, index);
+    if (mask) {
+        darray_push(query->objects, index);
+        darray_push(query->view_masks, mask);
+    }
     return true;
 }
 
-b8 simple_scene_mesh_render_data_query_from_line(const simple_scene *scene, vec3 direction, vec3 center, f32 radius, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data *out_geometries) {
-    if (!scene) {
+b8 simple_scene_visibility_query(const simple_scene *scene, u32 view_count, const simple_scene_cull_view *views, frame_data *p_frame_data, simple_scene_visibility *out_visibility) {
+    if (!scene || !views || !out_visibility || !view_count || view_count > SIMPLE_SCENE_MAX_CULL_VIEWS) {
+        KERROR("simple_scene_visibility_query requires a valid scene, visibility and between 1 and %u views.", SIMPLE_SCENE_MAX_CULL_VIEWS);
         return false;
     }
 
-    geometry_distance *transparent_geometries = darray_create_with_allocator(geometry_distance, &p_frame_data->allocator);
+    kzero_memory(out_visibility, sizeof(simple_scene_visibility));
+    out_visibility->view_count = view_count;
+    kcopy_memory(out_visibility->views, views, sizeof(simple_scene_cull_view) * view_count);
 
-    u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
-        if (m->generation != INVALID_ID_U8) {
-            mat4 model = transform_world_get(&m->transform);
-            b8 winding_inverted = m->transform.determinant < 0;
-
-            for (u32 j = 0; j < m->geometry_count; ++j) {
-                geometry *g = m->geometries[j];
-
-                // TODO: cache this somewhere...
-                //
-                // Translate/scale the extents.
-                vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
-                // Translate/scale the center.
-                vec3 transformed_center = vec3_mul_mat4(g->center, model);
-                // Find the one furthest from the center.
-                f32 mesh_radius = KMAX(vec3_distance(extents_min, transformed_center), vec3_distance(extents_max, transformed_center));
-
-                f32 dist_to_line = vec3_distance_to_line(transformed_center, center, direction);
-
-                // Is within distance, so include it
-                if ((dist_to_line - mesh_radius) <= radius) {
-                    // Add it to the list to be rendered.
-                    geometry_render_data data = {0};
-                    data.model = model;
-                    data.material = g->material;
-                    data.vertex_count = g->vertex_count;
-                    data.vertex_buffer_offset = g->vertex_buffer_offset;
-                    data.index_count = g->index_count;
-                    data.index_buffer_offset = g->index_buffer_offset;
-                    data.unique_id = m->id.uniqueid;
-                    data.winding_inverted = winding_inverted;
-
-                    // Check if transparent. If so, put into a separate, temp array to be
-                    // sorted by distance from the camera. Otherwise, put into the
-                    // ext_data->geometries array directly.
-                    b8 has_transparency = false;
-                    if (g->material->type == MATERIAL_TYPE_PBR) {
-                        // Check diffuse map (slot 0).
-                        has_transparency = ((g->material->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) != 0);
-                    }
+    // No more objects than the scene has can be visible, so the lists never need to grow.
+    u32 object_count = darray_length(scene->cull_objects);
+    cull_views_query query = {&scene->cull_bounds, view_count, out_visibility->views, 0, 0};
+    query.objects = darray_reserve_with_allocator(u32, KMAX(1, object_count), &p_frame_data->allocator);
+    query.view_masks = darray_reserve_with_allocator(u8, KMAX(1, object_count), &p_frame_data->allocator);
 
-                    if (has_transparency) {
-                        // For meshes _with_ transparency, add them to a separate list to be sorted by distance later.
-                        // Get the center, extract the global position from the model matrix and add it to the center,
-                        // then calculate the distance between it and the camera, and finally save it to a list to be sorted.
-                        // NOTE: This isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
-                        vec3 geometry_center = vec3_transform(g->center, 1.0f, model);
-                        f32 distance = vec3_distance(geometry_center, center);
-
-                        geometry_distance gdist;
-                        gdist.distance = kabs(distance);
-                        gdist.g = data;
-                        darray_push(transparent_geometries, gdist);
-                    } else {
-                        darray_push(out_geometries, data);
-                    }
-                    p_frame_data->drawn_mesh_count++;
-                }
-            }
+    // A view without a frustum sees everything, so the hierarchy can't rule anything out.
+    b8 unbounded = false;
+    for (u32 v = 0; v < view_count; ++v) {
+        unbounded |= views[v].type == SIMPLE_SCENE_CULL_VIEW_TYPE_FRUSTUM && !views[v].f;
+    }
+    if (unbounded) {
+        for (u32 i = 0; i < object_count; ++i) {
+            cull_views_object_found(i, &query);
         }
+    } else {
+        bvh_query(&scene->cull_bvh, cull_views_bounds_test, cull_views_object_found, &query);
     }
 
-    // Sort opaque geometries by material.
-    kquick_sort(sizeof(geometry_render_data), out_geometries, 0, darray_length(out_geometries) - 1, geometry_render_data_compare);
+    out_visibility->object_count = darray_length(query.objects);
+    out_visibility->objects = query.objects;
+    out_visibility->view_masks = query.view_masks;
+    return true;
+}
 
-    // Sort transparent geometries, then add them to the ext_data->geometries array.
-    u32 transparent_geometry_count = darray_length(transparent_geometries);
-    // TODO: Why does this segfault?
-    /* kquick_sort(sizeof(geometry_distance), transparent_geometries, 0, transparent_geometry_count - 1, geometry_distance_compare); */
-    for (u32 i = 0; i < transparent_geometry_count; ++i) {
-        darray_push(out_geometries, transparent_geometries[i].g);
+b8 simple_scene_object_is_moving(const simple_scene *scene, u32 object_index, const frame_data *p_frame_data) {
+    if (!scene || object_index >= darray_length(scene->cull_objects)) {
+        return false;
+    }
+    u64 updated = scene->cull_objects[object_index].updated_frame_number;
+    return p_frame_data->renderer_frame_number - updated < SIMPLE_SCENE_MOVING_FRAME_COUNT;
+}
+
+b8 simple_scene_visibility_render_data_get(const simple_scene *scene, const simple_scene_visibility *visibility, u32 view_index, frame_data *p_frame_data, u32 *out_count, struct geometry_draw_record *out_records) {
+    if (!scene || !visibility || view_index >= visibility->view_count) {
+        return false;
+    }
+
+    const simple_scene_cull_view *view = &visibility->views[view_index];
+    const simple_scene_cull_bounds *bounds = &scene->cull_bounds;
+    u8 view_bit = (u8)(1u << view_index);
+    b8 culls_clusters = view->culls_clusters && view->type == SIMPLE_SCENE_CULL_VIEW_TYPE_FRUSTUM && view->f;
+
+    // An object takes a record for each run of visible clusters, which are never more than half of them.
+    u32 capacity = visibility->object_count;
+    if (culls_clusters) {
+        for (u32 n = 0; n < visibility->object_count; ++n) {
+            capacity += (scene->cull_objects[visibility->objects[n]].g->cluster_count + 1) / 2;
+        }
+    }
+    geometry_draw_record *unsorted = p_frame_data->allocator.allocate(sizeof(geometry_draw_record) * capacity);
+    u32 count = 0;
+    for (u32 n = 0; n < visibility->object_count; ++n) {
+        if (!(visibility->view_masks[n] & view_bit)) {
+            continue;
+        }
+        u32 i = visibility->objects[n];
+        const simple_scene_cull_object *obj = &scene->cull_objects[i];
+        if (view->draws_impostors && mesh_impostor_active(scene, obj->m, &bounds->models[i])) {
+            continue;
+        }
+        vec3 obj_center = {bounds->world.center.x[i], bounds->world.center.y[i], bounds->world.center.z[i]};
+        // Transparent meshes are drawn after the rest, sorted by distance from the view.
+        // NOTE: This isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
+        render_sort_layer layer = RENDER_SORT_LAYER_OPAQUE;
+        if (cull_object_has_transparency(obj)) {
+            layer = view->weighted_blended ? RENDER_SORT_LAYER_WEIGHTED_BLENDED : RENDER_SORT_LAYER_TRANSPARENT;
+        }
+        geometry_draw_record record = cull_object_draw_record_get(scene, obj, view->lod_bias, layer, vec3_distance(obj_center, view->center));
+        if (culls_clusters && obj->g->cluster_count && record.lod == 0) {
+            count += cull_object_cluster_records_get(scene, view, &record, &unsorted[count]);
+        } else {
+            unsorted[count++] = record;
+        }
+        if (view->streams_textures) {
+            cull_object_textures_request(scene, obj);
+        }
+        p_frame_data->drawn_mesh_count++;
     }
 
-    *out_count = darray_length(out_geometries);
+    out_records = geometry_draw_records_sorted_push(out_records, unsorted, count, p_frame_data);
+    *out_count = darray_length(out_records);
 
     return true;
 }
 
-b8 simple_scene_mesh_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data *out_geometries) {
-    if (!scene) {
+b8 simple_scene_visibility_impostors_get(const simple_scene *scene, const simple_scene_visibility *visibility, u32 view_index, frame_data *p_frame_data, u32 *out_instance_count, simple_scene_impostor_instance **out_instances, u32 *out_batch_count, simple_scene_impostor_batch **out_batches) {
+    if (!scene || !visibility || view_index >= visibility->view_count || !out_instance_count || !out_instances || !out_batch_count || !out_batches) {
         return false;
     }
 
-    geometry_distance *transparent_geometries = darray_create_with_allocator(geometry_distance, &p_frame_data->allocator);
+    *out_instance_count = 0;
+    *out_instances = 0;
+    *out_batch_count = 0;
+    *out_batches = 0;
+    const simple_scene_cull_view *view = &visibility->views[view_index];
+    if (!view->draws_impostors) {
+        return true;
+    }
 
+    // Each mesh is found once per visible geometry, but takes a single instance.
     u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
-        if (m->generation != INVALID_ID_U8) {
-            mat4 model = transform_world_get(&m->transform);
-            b8 winding_inverted = m->transform.determinant < 0;
-
-            for (u32 j = 0; j < m->geometry_count; ++j) {
-                geometry *g = m->geometries[j];
-
-                // TODO: Distance-from-line detection per object (e.g. light direction and center pos, then distance check from that line.)
-                //
-                // // Bounding sphere calculation.
-                // {
-                //     // Translate/scale the extents.
-                //     vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                //     vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
-
-                //     f32 min = KMIN(KMIN(extents_min.x, extents_min.y),
-                //     extents_min.z); f32 max = KMAX(KMAX(extents_max.x,
-                //     extents_max.y), extents_max.z); f32 diff = kabs(max - min);
-                //     f32 radius = diff * 0.5f;
-
-                //     // Translate/scale the center.
-                //     vec3 center = vec3_mul_mat4(g->center, model);
-
-                //     if (frustum_intersects_sphere(&state->camera_frustum,
-                //     &center, radius)) {
-                //         // Add it to the list to be rendered.
-                //         geometry_render_data data = {0};
-                //         data.model = model;
-                //         data.geometry = g;
-                //         data.unique_id = m->unique_id;
-                //         darray_push(game_inst->frame_data.world_geometries,
-                //         data);
-
-                //         draw_count++;
-                //     }
-                // }
-
-                // AABB calculation
-                {
-                    // Translate/scale the extents.
-                    // vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                    vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
-
-                    // Translate/scale the center.
-                    vec3 center = vec3_mul_mat4(g->center, model);
-                    vec3 half_extents = {
-                        kabs(extents_max.x - center.x),
-                        kabs(extents_max.y - center.y),
-                        kabs(extents_max.z - center.z),
-                    };
-
-                    if (!f || frustum_intersects_aabb(f, &center, &half_extents)) {
-                        // Add it to the list to be rendered.
-                        geometry_render_data data = {0};
-                        data.model = model;
-                        data.material = g->material;
-                        data.vertex_count = g->vertex_count;
-                        data.vertex_buffer_offset = g->vertex_buffer_offset;
-                        data.index_count = g->index_count;
-                        data.index_buffer_offset = g->index_buffer_offset;
-                        data.unique_id = m->id.uniqueid;
-                        data.winding_inverted = winding_inverted;
-
-                        // Check if transparent. If so, put into a separate, temp array to be
-                        // sorted by distance from the camera. Otherwise, put into the
-                        // ext_data->geometries array directly.
-                        b8 has_transparency = false;
-                        if (g->material->type == MATERIAL_TYPE_PBR) {
-                            // Check diffuse map (slot 0).
-                            has_transparency = ((g->material->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) != 0);
-                        }
+    u8 *mesh_taken = p_frame_data->allocator.allocate(sizeof(u8) * KMAX(mesh_count, 1));
+    kzero_memory(mesh_taken, sizeof(u8) * KMAX(mesh_count, 1));
+    const mesh **meshes = p_frame_data->allocator.allocate(sizeof(mesh *) * KMAX(visibility->object_count, 1));
+    simple_scene_impostor_instance *unsorted = p_frame_data->allocator.allocate(sizeof(simple_scene_impostor_instance) * KMAX(visibility->object_count, 1));
+    u32 count = 0;
+    u8 view_bit = (u8)(1u << view_index);
+    for (u32 n = 0; n < visibility->object_count; ++n) {
+        if (!(visibility->view_masks[n] & view_bit)) {
+            continue;
+        }
+        u32 i = visibility->objects[n];
+        const mesh *m = scene->cull_objects[i].m;
+        u32 mesh_index = (u32)(m - scene->meshes);
+        const mat4 *model = &scene->cull_bounds.models[i];
+        if (mesh_taken[mesh_index] || !mesh_impostor_active(scene, m, model)) {
+            continue;
+        }
+        mesh_taken[mesh_index] = 1;
+
+        // The atlases are baked from the combined bounds of the geometries, as here.
+        extents_3d local = scene->cull_objects[i].g->extents;
+        for (u32 g = 0; g < m->geometry_count; ++g) {
+            if (m->geometries[g]) {
+                local.min = vec3_min(local.min, m->geometries[g]->extents.min);
+                local.max = vec3_max(local.max, m->geometries[g]->extents.max);
+            }
+        }
+        vec3 axes[3];
+        f32 scale = 0;
+        for (u32 a = 0; a < 3; ++a) {
+            axes[a] = (vec3){model->data[a * 4 + 0], model->data[a * 4 + 1], model->data[a * 4 + 2]};
+            f32 axis_length = vec3_length(axes[a]);
+            scale = KMAX(scale, axis_length);
+            axes[a] = axis_length > K_FLOAT_EPSILON ? vec3_div_scalar(axes[a], axis_length) : vec3_zero();
+        }
+        vec3 local_center = vec3_mul_scalar(vec3_add(local.min, local.max), 0.5f);
+        f32 radius = vec3_length(vec3_sub(local.max, local_center)) * scale;
 
-                        if (has_transparency) {
-                            // For meshes _with_ transparency, add them to a separate list to be sorted by distance later.
-                            // Get the center, extract the global position from the model matrix and add it to the center,
-                            // then calculate the distance between it and the camera, and finally save it to a list to be sorted.
-                            // NOTE: This isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
-                            vec3 geometry_center = vec3_transform(g->center, 1.0f, model);
-                            f32 distance = vec3_distance(geometry_center, center);
-
-                            geometry_distance gdist;
-                            gdist.distance = kabs(distance);
-                            gdist.g = data;
-                            darray_push(transparent_geometries, gdist);
-                        } else {
-                            darray_push(out_geometries, data);
-                        }
-                        p_frame_data->drawn_mesh_count++;
-                    }
-                }
+        meshes[count] = m;
+        simple_scene_impostor_instance *instance = &unsorted[count++];
+        instance->center_radius = vec4_from_vec3(vec3_mul_mat4(local_center, *model), radius);
+        instance->axis_x = vec4_from_vec3(axes[0], 0);
+        instance->axis_y = vec4_from_vec3(axes[1], 0);
+    }
+    if (!count) {
+        return true;
+    }
+
+    // Group the instances by atlas, keeping the order within each.
+    simple_scene_impostor_instance *instances = p_frame_data->allocator.allocate(sizeof(simple_scene_impostor_instance) * count);
+    simple_scene_impostor_batch *batches = p_frame_data->allocator.allocate(sizeof(simple_scene_impostor_batch) * count);
+    u8 *placed = p_frame_data->allocator.allocate(sizeof(u8) * count);
+    kzero_memory(placed, sizeof(u8) * count);
+    u32 written = 0;
+    u32 batch_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (placed[i]) {
+            continue;
+        }
+        simple_scene_impostor_batch *batch = &batches[batch_count++];
+        batch->albedo = meshes[i]->impostor_albedo;
+        batch->normal = meshes[i]->impostor_normal;
+        batch->frame_count = meshes[i]->config.impostor_frame_count;
+        batch->first_instance = written;
+        for (u32 j = i; j < count; ++j) {
+            if (!placed[j] && meshes[j]->impostor_albedo == batch->albedo && meshes[j]->impostor_normal == batch->normal) {
+                instances[written++] = unsorted[j];
+                placed[j] = 1;
             }
         }
+        batch->instance_count = written - batch->first_instance;
+    }
+
+    *out_instance_count = count;
+    *out_instances = instances;
+    *out_batch_count = batch_count;
+    *out_batches = batches;
+    return true;
+}
+
+b8 simple_scene_visibility_occlusion_cull(const simple_scene *scene, simple_scene_visibility *visibility, u32 view_index, mat4 view_projection, occlusion_buffer *buffer, u32 *out_culled_count) {
+    if (out_culled_count) {
+        *out_culled_count = 0;
+    }
+    if (!scene || !visibility || !buffer || view_index >= visibility->view_count) {
+        return false;
+    }
+
+    const simple_scene_cull_view *view = &visibility->views[view_index];
+    const simple_scene_cull_bounds *bounds = &scene->cull_bounds;
+    u8 view_bit = (u8)(1u << view_index);
+
+    // Pick the largest opaque objects on screen as occluders, kept in order of size, largest first.
+    u32 occluders[SIMPLE_SCENE_MAX_OCCLUDERS];
+    f32 occluder_sizes[SIMPLE_SCENE_MAX_OCCLUDERS];
+    u32 occluder_count = 0;
+    for (u32 n = 0; n < visibility->object_count; ++n) {
+        if (!(visibility->view_masks[n] & view_bit)) {
+            continue;
+        }
+        u32 i = visibility->objects[n];
+        const simple_scene_cull_object *obj = &scene->cull_objects[i];
+        if (!obj->g->vertices || !obj->g->indices || cull_object_has_transparency(obj)) {
+            continue;
+        }
+        vec3 obj_center = {bounds->world.center.x[i], bounds->world.center.y[i], bounds->world.center.z[i]};
+        f32 distance = KMAX(vec3_distance(obj_center, view->center) - bounds->radii[i], K_FLOAT_EPSILON);
+        f32 size = bounds->radii[i] / distance;
+        if (size < SIMPLE_SCENE_OCCLUDER_MIN_SIZE || (occluder_count == SIMPLE_SCENE_MAX_OCCLUDERS && size <= occluder_sizes[occluder_count - 1])) {
+            continue;
+        }
+        u32 slot = KMIN(occluder_count, SIMPLE_SCENE_MAX_OCCLUDERS - 1);
+        while (slot > 0 && occluder_sizes[slot - 1] < size) {
+            occluders[slot] = occluders[slot - 1];
+            occluder_sizes[slot] = occluder_sizes[slot - 1];
+            slot--;
+        }
+        occluders[slot] = n;
+        occluder_sizes[slot] = size;
+        occluder_count = KMIN(occluder_count + 1, SIMPLE_SCENE_MAX_OCCLUDERS);
+    }
+
+    occlusion_buffer_begin(buffer, view_projection);
+    if (!occluder_count) {
+        return true;
+    }
+    for (u32 o = 0; o < occluder_count; ++o) {
+        u32 i = visibility->objects[occluders[o]];
+        occlusion_buffer_occluder_add(buffer, scene->cull_objects[i].g, bounds->models[i]);
+    }
+    occlusion_buffer_rasterize(buffer);
+
+    // Occluders are never tested, since each would be found behind itself.
+    u32 culled_count = 0;
+    for (u32 n = 0; n < visibility->object_count; ++n) {
+        if (!(visibility->view_masks[n] & view_bit)) {
+            continue;
+        }
+        b8 is_occluder = false;
+        for (u32 o = 0; o < occluder_count && !is_occluder; ++o) {
+            is_occluder = occluders[o] == n;
+        }
+        if (is_occluder) {
+            continue;
+        }
+        u32 i = visibility->objects[n];
+        vec3 center = {bounds->world.center.x[i], bounds->world.center.y[i], bounds->world.center.z[i]};
+        vec3 extents = {bounds->world.extents.x[i], bounds->world.extents.y[i], bounds->world.extents.z[i]};
+        if (!occlusion_buffer_aabb_visible(buffer, center, extents)) {
+            visibility->view_masks[n] &= (u8)~view_bit;
+            culled_count++;
+        }
+    }
+
+    if (out_culled_count) {
+        *out_culled_count = culled_count;
+    }
+    return true;
+}
+
+b8 simple_scene_mesh_render_data_query_from_line(const simple_scene *scene, vec3 direction, vec3 center, f32 radius, u32 lod_bias, frame_data *p_frame_data, u32 *out_count, struct geometry_draw_record *out_records) {
+    simple_scene_cull_view view = {0};
+    view.type = SIMPLE_SCENE_CULL_VIEW_TYPE_LINE;
+    view.direction = direction;
+    view.radius = radius;
+    view.center = center;
+    view.lod_bias = lod_bias;
+
+    simple_scene_visibility visibility;
+    if (!scene || !simple_scene_visibility_query(scene, 1, &view, p_frame_data, &visibility)) {
+        return false;
+    }
+    return simple_scene_visibility_render_data_get(scene, &visibility, 0, p_frame_data, out_count, out_records);
+}
+
+b8 simple_scene_mesh_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, u32 lod_bias, frame_data *p_frame_data, u32 *out_count, struct geometry_draw_record *out_records) {
+    simple_scene_cull_view view = {0};
+    view.type = SIMPLE_SCENE_CULL_VIEW_TYPE_FRUSTUM;
+    view.f = f;
+    view.center = center;
+    view.lod_bias = lod_bias;
+    view.streams_textures = true;
+
+    simple_scene_visibility visibility;
+    if (!scene || !simple_scene_visibility_query(scene, 1, &view, p_frame_data, &visibility)) {
+        return false;
+    }
+    return simple_scene_visibility_render_data_get(scene, &visibility, 0, p_frame_data, out_count, out_records);
+}
+
+u32 simple_scene_terrain_chunk_count_get(const simple_scene *scene) {
+    if (!scene) {
+        return 0;
+    }
+
+    u32 chunk_count = 0;
+    u32 terrain_count = darray_length(scene->terrains);
+    for (u32 i = 0; i < terrain_count; ++i) {
+        chunk_count += scene->terrains[i].chunk_count;
     }
+    return chunk_count;
+}
 
-    // Sort opaque geometries by material.
-    kquick_sort(sizeof(geometry_render_data), out_geometries, 0, darray_length(out_geometries) - 1, geometry_render_data_compare);
+// Transforms the bounds of the given chunk of a terrain to world space, enclosing the result in a new box.
+static void terrain_chunk_world_bounds_get(const terrain_chunk *chunk, const mat4 *model, vec3 *out_center, vec3 *out_half) {
+    vec3 local_center = vec3_mul_scalar(vec3_add(chunk->extents.min, chunk->extents.max), 0.5f);
+    vec3 local_half = vec3_mul_scalar(vec3_sub(chunk->extents.max, chunk->extents.min), 0.5f);
+    *out_center = vec3_mul_mat4(local_center, *model);
+    *out_half = (vec3){
+        kabs(model->data[0]) * local_half.x + kabs(model->data[4]) * local_half.y + kabs(model->data[8]) * local_half.z,
+        kabs(model->data[1]) * local_half.x + kabs(model->data[5]) * local_half.y + kabs(model->data[9]) * local_half.z,
+        kabs(model->data[2]) * local_half.x + kabs(model->data[6]) * local_half.y + kabs(model->data[10]) * local_half.z};
+}
+
+// Indicates if the terrain chunk at the given index among those of every terrain was found hidden this frame.
+static b8 terrain_chunk_hidden(const simple_scene *scene, u32 index) {
+    return scene->terrain_chunk_occlusion && index < darray_length(scene->terrain_chunk_occlusion) && scene->terrain_chunk_occlusion[index].hidden;
+}
 
-    // Sort transparent geometries, then add them to the ext_data->geometries array.
-    u32 transparent_geometry_count = darray_length(transparent_geometries);
-    kquick_sort(sizeof(geometry_distance), transparent_geometries, 0, transparent_geometry_count - 1, geometry_distance_compare);
-    for (u32 i = 0; i < transparent_geometry_count; ++i) {
-        darray_push(out_geometries, transparent_geometries[i].g);
+// Indicates if the given chunk of a terrain is visible in the frustum (or always, without one), and if so
+// chooses its level of detail by the distance of its bounds from the center.
+static b8 terrain_chunk_lod_select(const terrain *t, const terrain_chunk *chunk, const mat4 *model, const frustum *f, vec3 center, u32 *out_lod) {
+    *out_lod = 0;
+    if (!chunk->lod_count) {
+        return false;
     }
 
-    *out_count = darray_length(out_geometries);
+    vec3 world_center;
+    vec3 world_half;
+    terrain_chunk_world_bounds_get(chunk, model, &world_center, &world_half);
+    if (f && !frustum_intersects_aabb(f, &world_center, &world_half)) {
+        return false;
+    }
 
+    vec3 outside = {
+        KMAX(kabs(center.x - world_center.x) - world_half.x, 0.0f),
+        KMAX(kabs(center.y - world_center.y) - world_half.y, 0.0f),
+        KMAX(kabs(center.z - world_center.z) - world_half.z, 0.0f)};
+    f32 distance = vec3_length(outside);
+    f32 lod_distance = t->lod_distance;
+    u32 lod = 0;
+    while (lod + 1 < chunk->lod_count && distance > lod_distance) {
+        lod++;
+        lod_distance *= 2.0f;
+    }
+    *out_lod = lod;
     return true;
 }
 
-b8 simple_scene_terrain_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data *out_terrain_geometries) {
+b8 simple_scene_terrain_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, b8 skip_hidden, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data *out_terrain_geometries) {
     if (!scene) {
         return false;
     }
 
     u32 terrain_count = darray_length(scene->terrains);
+    u32 chunk_base = 0;
     for (u32 i = 0; i < terrain_count; ++i) {
-        // TODO: Frustum culling
+        const terrain *t = &scene->terrains[i];
+        u32 first_chunk = chunk_base;
+        chunk_base += t->chunk_count;
+        // Vertex-pulled terrains have no vertices of their own to draw. See simple_scene_terrain_patch_query.
+        if (t->vertex_pulling) {
+            continue;
+        }
+        const geometry *g = &t->geo;
         geometry_render_data data = {0};
         data.model = transform_world_get(&scene->terrains[i].xform);
-        geometry *g = &scene->terrains[i].geo;
         data.material = g->material;
         data.vertex_count = g->vertex_count;
         data.vertex_buffer_offset = g->vertex_buffer_offset;
-        data.index_count = g->index_count;
-        data.index_buffer_offset = g->index_buffer_offset;
-        data.unique_id = scene->terrains[i].id.uniqueid;
+        data.unique_id = t->id.uniqueid;
+
+        // Each visible chunk is drawn from the range of the terrain's indices for its level of detail, chosen
+        // by the distance of its bounds from the center. Neighbouring visible chunks in a row at the same level
+        // have adjacent ranges, so these are merged into a single draw.
+        u32 run_start = INVALID_ID;
+        u32 run_end = 0;
+        for (u32 c = 0; c <= t->chunk_count; ++c) {
+            u32 lod = 0;
+            const terrain_chunk *chunk = c < t->chunk_count ? &t->chunks[c] : 0;
+            b8 is_visible = chunk && terrain_chunk_lod_select(t, chunk, &data.model, f, center, &lod) &&
+                            !(skip_hidden && terrain_chunk_hidden(scene, first_chunk + c));
+
+            if (is_visible && run_start != INVALID_ID && chunk->index_offsets[lod] == run_end) {
+                run_end += chunk->index_counts[lod];
+                continue;
+            }
 
-        darray_push(out_terrain_geometries, data);
+            // The current run, if any, has ended.
+            if (run_start != INVALID_ID) {
+                data.index_count = run_end - run_start;
+                data.index_buffer_offset = g->index_buffer_offset + run_start * sizeof(u32);
+                darray_push(out_terrain_geometries, data);
+                run_start = INVALID_ID;
+            }
+            if (is_visible) {
+                run_start = chunk->index_offsets[lod];
+                run_end = chunk->index_offsets[lod] + chunk->index_counts[lod];
+                // Runs only merge chunks at the same level, so this holds for the whole run.
+                data.shading_rate = lod >= TERRAIN_CHUNK_COARSE_SHADING_LOD ? RENDERER_SHADING_RATE_2X2 : RENDERER_SHADING_RATE_1X1;
+            }
+        }
     }
 
     *out_count = darray_length(out_terrain_geometries);
@@ -1462,7 +2597,252 @@ b8 simple_scene_terrain_render_data_query(const simple_scene *scene, const frust
     return true;
 }
 
+b8 simple_scene_terrain_patch_query(const simple_scene *scene, const frustum *f, vec3 center, b8 skip_hidden, frame_data *p_frame_data, u32 *out_batch_count, struct terrain_patch_batch *out_batches, u32 *out_instance_count, struct terrain_patch_instance *out_instances) {
+    if (!scene) {
+        return false;
+    }
+
+    u32 terrain_count = darray_length(scene->terrains);
+    u32 chunk_base = 0;
+    for (u32 i = 0; i < terrain_count; ++i) {
+        const terrain *t = &scene->terrains[i];
+        u32 first_chunk = chunk_base;
+        chunk_base += t->chunk_count;
+        if (!t->vertex_pulling || !t->chunk_count) {
+            continue;
+        }
+        const geometry *g = &t->geo;
+        mat4 model = transform_world_get(&scene->terrains[i].xform);
+
+        // Choose the level of each chunk once, INVALID_ID if hidden.
+        u32 *chunk_lods = p_frame_data->allocator.allocate(sizeof(u32) * t->chunk_count);
+        for (u32 c = 0; c < t->chunk_count; ++c) {
+            u32 lod = 0;
+            b8 is_visible = terrain_chunk_lod_select(t, &t->chunks[c], &model, f, center, &lod) && !(skip_hidden && terrain_chunk_hidden(scene, first_chunk + c));
+            chunk_lods[c] = is_visible ? lod : INVALID_ID;
+        }
+
+        // All chunks at a level are instances of the same range of the patch, so one batch is drawn per level.
+        terrain_patch_instance instance = {0};
+        instance.scale = (vec4){t->tile_scale_x, t->scale_y, t->tile_scale_z, 0.0f};
+        for (u32 lod = 0; lod < TERRAIN_CHUNK_LOD_COUNT; ++lod) {
+            terrain_patch_batch batch = {0};
+            batch.first_instance = darray_length(out_instances);
+            for (u32 c = 0; c < t->chunk_count; ++c) {
+                if (chunk_lods[c] != lod) {
+                    continue;
+                }
+                instance.origin.x = (f32)((c % t->chunk_count_x) * TERRAIN_CHUNK_TILE_COUNT);
+                instance.origin.y = (f32)((c / t->chunk_count_x) * TERRAIN_CHUNK_TILE_COUNT);
+                darray_push(out_instances, instance);
+                batch.instance_count++;
+            }
+            if (!batch.instance_count) {
+                continue;
+            }
+
+            batch.data.model = model;
+            batch.data.material = g->material;
+            batch.data.vertex_count = g->vertex_count;
+            batch.data.vertex_buffer_offset = g->vertex_buffer_offset;
+            batch.data.index_count = t->patch_index_counts[lod];
+            batch.data.index_buffer_offset = g->index_buffer_offset + t->patch_index_offsets[lod] * sizeof(u32);
+            batch.data.unique_id = t->id.uniqueid;
+            batch.data.shading_rate = lod >= TERRAIN_CHUNK_COARSE_SHADING_LOD ? RENDERER_SHADING_RATE_2X2 : RENDERER_SHADING_RATE_1X1;
+            darray_push(out_batches, batch);
+        }
+    }
+
+    *out_batch_count = darray_length(out_batches);
+    *out_instance_count = darray_length(out_instances);
+
+    return true;
+}
+
+// Applies the latest occlusion query results to what they were of, if they haven't been already.
+static void occlusion_query_results_apply(simple_scene *scene) {
+    u8 visible[RENDERER_MAX_OCCLUSION_QUERIES];
+    u32 result_count = 0;
+    u64 frame_number = 0;
+    if (!renderer_occlusion_query_results_get(RENDERER_MAX_OCCLUSION_QUERIES, visible, &result_count, &frame_number) ||
+        !frame_number || frame_number <= scene->occlusion_applied_frame_number) {
+        return;
+    }
+    scene->occlusion_applied_frame_number = frame_number;
+
+    // Results too far behind are no longer remembered, and would be too old to act on anyway.
+    const simple_scene_occlusion_query_frame *queries = &scene->occlusion_query_frames[frame_number % SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT];
+    if (queries->frame_number != frame_number) {
+        return;
+    }
+
+    u32 count = KMIN(result_count, queries->query_count);
+    u32 object_count = darray_length(scene->cull_objects);
+    u32 chunk_count = darray_length(scene->terrain_chunk_occlusion);
+    for (u32 q = 0; q < count; ++q) {
+        u32 target = queries->targets[q];
+        simple_scene_occlusion_state *state = 0;
+        if (target & SIMPLE_SCENE_OCCLUSION_TARGET_TERRAIN_BIT) {
+            u32 index = target & ~SIMPLE_SCENE_OCCLUSION_TARGET_TERRAIN_BIT;
+            state = index < chunk_count ? &scene->terrain_chunk_occlusion[index] : 0;
+        } else if (target < object_count) {
+            simple_scene_cull_object *obj = &scene->cull_objects[target];
+            // Says nothing of an object which has moved (or whose slot was taken by another) since.
+            if (obj->updated_frame_number > frame_number) {
+                continue;
+            }
+            state = &obj->occlusion;
+            // Results from before it last moved no longer count towards it being hidden.
+            if (obj->updated_frame_number > state->result_frame_number) {
+                state->hidden_count = 0;
+            }
+        }
+        if (!state) {
+            continue;
+        }
+        state->hidden_count = visible[q] ? 0 : (u8)KMIN(state->hidden_count + 1, 255);
+        state->result_frame_number = frame_number;
+    }
+}
+
+// Indicates if enough recent results in a row found something hidden for it to be left out.
+static b8 occlusion_state_hidden(const simple_scene_occlusion_state *state, u64 frame_number) {
+    return state->hidden_count >= SIMPLE_SCENE_OCCLUSION_QUERY_HIDDEN_COUNT && state->result_frame_number &&
+           frame_number - state->result_frame_number <= SIMPLE_SCENE_OCCLUSION_QUERY_MAX_AGE;
+}
+
+// Adds a query of the given world-space bounds, enlarged a little. Returns false if the view position is
+// within them, where the box's faces would be clipped away and it would always seem hidden, or if the
+// frame is out of queries.
+static b8 occlusion_query_add(simple_scene_occlusion_query_frame *queries, u32 target, vec3 center, vec3 half, vec3 view_position, f32 near_clip, extents_3d *out_boxes) {
+    half = vec3_mul_scalar(half, 1.0f + SIMPLE_SCENE_OCCLUSION_QUERY_MARGIN);
+    // The near plane reaches out past the view position, further towards its corners.
+    f32 inside_margin = near_clip * 2.0f;
+    if (kabs(view_position.x - center.x) <= half.x + inside_margin &&
+        kabs(view_position.y - center.y) <= half.y + inside_margin &&
+        kabs(view_position.z - center.z) <= half.z + inside_margin) {
+        return false;
+    }
+    if (queries->query_count >= RENDERER_MAX_OCCLUSION_QUERIES) {
+        return false;
+    }
+
+    out_boxes[queries->query_count] = (extents_3d){vec3_sub(center, half), vec3_add(center, half)};
+    queries->targets[queries->query_count++] = target;
+    return true;
+}
+
+b8 simple_scene_visibility_occlusion_query(simple_scene *scene, simple_scene_visibility *visibility, u32 view_index, f32 near_clip, frame_data *p_frame_data, u32 *out_box_count, extents_3d *out_boxes, u32 *out_culled_count) {
+    *out_box_count = 0;
+    if (out_culled_count) {
+        *out_culled_count = 0;
+    }
+    if (!scene || !visibility || view_index >= visibility->view_count) {
+        return false;
+    }
+    if (!renderer_occlusion_queries_supported()) {
+        return true;
+    }
+
+    // What is known of each terrain chunk, forgotten whenever the terrains change.
+    u32 chunk_total = simple_scene_terrain_chunk_count_get(scene);
+    if (!scene->terrain_chunk_occlusion) {
+        scene->terrain_chunk_occlusion = darray_create(simple_scene_occlusion_state);
+    }
+    if (darray_length(scene->terrain_chunk_occlusion) != chunk_total) {
+        darray_clear(scene->terrain_chunk_occlusion);
+        simple_scene_occlusion_state empty_state = {0};
+        for (u32 i = 0; i < chunk_total; ++i) {
+            darray_push(scene->terrain_chunk_occlusion, empty_state);
+        }
+    }
+    for (u32 i = 0; i < chunk_total; ++i) {
+        scene->terrain_chunk_occlusion[i].hidden = false;
+    }
+
+    if (!scene->occlusion_query_frames) {
+        scene->occlusion_query_frames = kallocate(sizeof(simple_scene_occlusion_query_frame) * SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT, MEMORY_TAG_SCENE);
+    }
+    occlusion_query_results_apply(scene);
+
+    u64 frame_number = p_frame_data->renderer_frame_number;
+    simple_scene_occlusion_query_frame *queries = &scene->occlusion_query_frames[frame_number % SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT];
+    queries->frame_number = frame_number;
+    queries->query_count = 0;
+
+    const simple_scene_cull_view *view = &visibility->views[view_index];
+    const simple_scene_cull_bounds *bounds = &scene->cull_bounds;
+    u8 view_bit = (u8)(1u << view_index);
+    u32 culled_count = 0;
+
+    // Hidden objects are queried too, so that they are drawn again once a result finds them in view.
+    for (u32 n = 0; n < visibility->object_count; ++n) {
+        if (!(visibility->view_masks[n] & view_bit)) {
+            continue;
+        }
+        u32 i = visibility->objects[n];
+        simple_scene_cull_object *obj = &scene->cull_objects[i];
+        obj->occlusion.hidden = false;
+        u32 element_count = obj->g->index_count ? obj->g->index_count : obj->g->vertex_count;
+        if (element_count < SIMPLE_SCENE_OCCLUSION_QUERY_MIN_INDEX_COUNT) {
+            continue;
+        }
+
+        vec3 center = {bounds->world.center.x[i], bounds->world.center.y[i], bounds->world.center.z[i]};
+        vec3 half = {bounds->world.extents.x[i], bounds->world.extents.y[i], bounds->world.extents.z[i]};
+        if (!occlusion_query_add(queries, i, center, half, view->center, near_clip, out_boxes)) {
+            obj->occlusion.hidden_count = 0;
+            continue;
+        }
+        if (occlusion_state_hidden(&obj->occlusion, frame_number) && obj->updated_frame_number <= obj->occlusion.result_frame_number) {
+            obj->occlusion.hidden = true;
+            visibility->view_masks[n] &= (u8)~view_bit;
+            culled_count++;
+        }
+    }
+
+    // Terrain chunks in view, indexed among those of every terrain in order.
+    u32 terrain_count = darray_length(scene->terrains);
+    u32 chunk_base = 0;
+    for (u32 t = 0; t < terrain_count; ++t) {
+        terrain *ter = &scene->terrains[t];
+        mat4 model = transform_world_get(&ter->xform);
+        for (u32 c = 0; c < ter->chunk_count; ++c) {
+            const terrain_chunk *chunk = &ter->chunks[c];
+            if (!chunk->lod_count) {
+                continue;
+            }
+            vec3 center;
+            vec3 half;
+            terrain_chunk_world_bounds_get(chunk, &model, &center, &half);
+            if (view->f && !frustum_intersects_aabb(view->f, &center, &half)) {
+                continue;
+            }
+
+            u32 index = chunk_base + c;
+            simple_scene_occlusion_state *state = &scene->terrain_chunk_occlusion[index];
+            if (!occlusion_query_add(queries, SIMPLE_SCENE_OCCLUSION_TARGET_TERRAIN_BIT | index, center, half, view->center, near_clip, out_boxes)) {
+                state->hidden_count = 0;
+                continue;
+            }
+            if (occlusion_state_hidden(state, frame_number)) {
+                state->hidden = true;
+                culled_count++;
+            }
+        }
+        chunk_base += ter->chunk_count;
+    }
+
+    *out_box_count = queries->query_count;
+    if (out_culled_count) {
+        *out_culled_count = culled_count;
+    }
+    return true;
+}
+
 static void simple_scene_actual_unload(simple_scene *scene) {
+    event_unregister(EVENT_CODE_WATCHED_RESOURCE_CHANGED, scene, simple_scene_on_resource_changed);
+
     if (scene->sb) {
         if (!skybox_unload(scene->sb)) {
             KERROR("Failed to unload skybox");
@@ -1501,6 +2881,33 @@ static void simple_scene_actual_unload(simple_scene *scene) {
         terrain_destroy(&scene->terrains[i]);
     }
 
+    u32 emitter_count = darray_length(scene->emitters);
+    for (u32 i = 0; i < emitter_count; ++i) {
+        particle_emitter_destroy(&scene->emitters[i]);
+    }
+
+    u32 skinned_count = darray_length(scene->skinned_meshes);
+    for (u32 i = 0; i < skinned_count; ++i) {
+        simple_scene_skinned_mesh *skinned = &scene->skinned_meshes[i];
+        for (u32 g = 0; g < skinned->geometry_count; ++g) {
+            if (skinned->geometries[g]) {
+                geometry_system_release(skinned->geometries[g]);
+            }
+        }
+        kfree(skinned->geometries, sizeof(geometry *) * KMAX(skinned->geometry_count, 1), MEMORY_TAG_ARRAY);
+        resource_system_unload(&skinned->mesh_resource);
+        string_free(skinned->name);
+        string_free(skinned->resource_name);
+        if (skinned->clip_name) {
+            string_free(skinned->clip_name);
+        }
+    }
+    if (scene->skinning_palette) {
+        kfree(scene->skinning_palette, sizeof(mat4) * scene->skinning_palette_count, MEMORY_TAG_ARRAY);
+        scene->skinning_palette = 0;
+        scene->skinning_palette_count = 0;
+    }
+
     // Debug grid.
     if (!debug_grid_unload(&scene->grid)) {
         KWARN("Debug grid unload failed.");
@@ -1552,10 +2959,66 @@ static void simple_scene_actual_unload(simple_scene *scene) {
         darray_destroy(scene->meshes);
     }
 
+    if (scene->mesh_components.flags) {
+        darray_destroy(scene->mesh_components.flags);
+        darray_destroy(scene->mesh_components.transforms);
+        darray_destroy(scene->mesh_components.extents);
+        darray_destroy(scene->mesh_components.geometry_counts);
+        darray_destroy(scene->mesh_components.geometries);
+    }
+
     if (scene->terrains) {
         darray_destroy(scene->terrains);
     }
 
+    if (scene->emitters) {
+        darray_destroy(scene->emitters);
+    }
+
+    if (scene->skinned_meshes) {
+        darray_destroy(scene->skinned_meshes);
+    }
+
+    if (scene->animators) {
+        darray_destroy(scene->animators);
+    }
+
+    if (scene->pending_meshes) {
+        darray_destroy(scene->pending_meshes);
+    }
+
+    if (scene->cull_objects) {
+        darray_destroy(scene->cull_objects);
+    }
+    cull_bounds_destroy(&scene->cull_bounds);
+    bvh_destroy(&scene->cull_bvh);
+    if (scene->cull_bvh_leaves) {
+        darray_destroy(scene->cull_bvh_leaves);
+    }
+    transform_hierarchy_destroy(&scene->hierarchy);
+
+    if (scene->terrain_chunk_occlusion) {
+        darray_destroy(scene->terrain_chunk_occlusion);
+    }
+    if (scene->occlusion_query_frames) {
+        kfree(scene->occlusion_query_frames, sizeof(simple_scene_occlusion_query_frame) * SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT, MEMORY_TAG_SCENE);
+    }
+
+    if (scene->raycast_cache_hits) {
+        darray_destroy(scene->raycast_cache_hits);
+        scene->raycast_cache_hits = 0;
+    }
+    scene->raycast_cache_valid = false;
+
+    if (scene->gpu_objects) {
+        darray_destroy(scene->gpu_objects);
+    }
+
+    if (scene->object_capacity) {
+        renderer_renderbuffer_destroy(&scene->object_buffer);
+        scene->object_capacity = 0;
+    }
+
     kzero_memory(scene, sizeof(simple_scene));
 }
 
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "defines.h"
+#include "math/bvh.h"
 #include "math/math_types.h"
+#include "math/transform_hierarchy.h"
+#include "renderer/renderer_types.h"
 #include "resources/debug/debug_grid.h"
 
 struct frame_data;
@@ -14,11 +17,28 @@ struct geometry_config;
 struct camera;
 struct simple_scene_config;
 struct terrain;
+struct particle_emitter;
+struct skeletal_mesh;
+struct skeletal_animator;
+struct geometry;
 struct ray;
 struct raycast_result;
+struct raycast_hit;
 struct transform;
 struct viewport;
 struct geometry_render_data;
+struct geometry_draw_record;
+struct terrain_patch_batch;
+struct terrain_patch_instance;
+struct debug_draw_batch;
+struct occlusion_buffer;
+struct texture;
+
+/** @brief The default number of bytes of mesh geometry uploaded by a scene per frame. */
+#define SIMPLE_SCENE_DEFAULT_UPLOAD_BUDGET (4 * 1024 * 1024)
+
+/** @brief The largest error, in pixels, with which a mesh geometry's level of detail may be drawn. */
+#define SIMPLE_SCENE_LOD_MAX_ERROR_PIXELS 1.0f
 
 typedef enum simple_scene_state {
     /** @brief created, but nothing more. */
@@ -35,13 +55,243 @@ typedef enum simple_scene_state {
     SIMPLE_SCENE_STATE_UNLOADED
 } simple_scene_state;
 
-typedef struct pending_mesh {
+/**
+ * @brief The world-space culling data of a single mesh geometry. Updated once per
+ * frame by simple_scene_culling_update, then shared by every render data query made
+ * that frame (camera and each shadow cascade) instead of each recomputing it. An object
+ * keeps its slot for as long as the same geometry occupies it, and is only recomputed
+ * when its world transform changes.
+ */
+/** @brief What is known of whether an object or terrain chunk is hidden, from the occlusion queries of earlier frames. */
+typedef struct simple_scene_occlusion_state {
+    /** @brief The number of consecutive query results which found it hidden. */
+    u8 hidden_count;
+    /** @brief Indicates if it is hidden this frame, and so isn't drawn. */
+    b8 hidden;
+    /** @brief The renderer frame number of the latest query result, 0 if it was never queried. */
+    u64 result_frame_number;
+} simple_scene_occlusion_state;
+
+typedef struct simple_scene_cull_object {
+    /** @brief Indicates if the winding order is inverted (i.e. the mesh is negatively scaled). */
+    b8 winding_inverted;
+    /** @brief A pointer to the owning mesh. */
     struct mesh* m;
+    /** @brief A pointer to the geometry. */
+    struct geometry* g;
+    /** @brief The world generation of the owning mesh's transform when last updated. */
+    u32 world_generation;
+    /** @brief Indicates if the object was updated this frame, and so must be uploaded. */
+    b8 is_dirty;
+    /** @brief The renderer frame number at which the object was last updated. See simple_scene_object_is_moving. */
+    u64 updated_frame_number;
+    /** @brief Whether the object was found hidden. See simple_scene_visibility_occlusion_query. */
+    simple_scene_occlusion_state occlusion;
+} simple_scene_cull_object;
+
+/**
+ * @brief The bounds of every cull object, at the same index as the object. Kept in
+ * structure-of-arrays layout so they can be transformed and tested against frustums
+ * several objects at a time.
+ */
+typedef struct simple_scene_cull_bounds {
+    /** @brief The number of objects the arrays have room for. */
+    u32 capacity;
+    /** @brief The world matrix of the mesh owning each object. */
+    mat4* models;
+    /** @brief The bounds of each object's geometry, in local space. */
+    aabb_soa local;
+    /** @brief The bounds of each object, in world space. */
+    aabb_soa world;
+    /** @brief The radius of a sphere about each world-space center which encloses the world-space bounds. */
+    f32* radii;
+} simple_scene_cull_bounds;
+
+/**
+ * @brief The entry of a single object in the scene's GPU object buffer. Laid out
+ * to match the std430 layout read by shaders.
+ */
+typedef struct simple_scene_gpu_object {
+    /** @brief The world matrix of the object. */
+    mat4 model;
+    /** @brief The internal id of the object's material, indexing the material parameter buffer. */
+    u32 material_id;
+    /** @brief Padding to a multiple of 16 bytes. */
+    u32 padding[3];
+} simple_scene_gpu_object;
+
+/** @brief The number of frames an object must go without being updated before it is no longer considered moving. */
+#define SIMPLE_SCENE_MOVING_FRAME_COUNT 30
+
+/** @brief The most views simple_scene_visibility_query can cull at once. */
+#define SIMPLE_SCENE_MAX_CULL_VIEWS 8
+
+/** @brief The most occluders drawn by simple_scene_visibility_occlusion_cull. */
+#define SIMPLE_SCENE_MAX_OCCLUDERS 16
+/** @brief The smallest ratio of an object's bounding radius to its distance at which it is drawn as an occluder. */
+#define SIMPLE_SCENE_OCCLUDER_MIN_SIZE 0.25f
+
+/** @brief The fewest indices (or vertices, if unindexed) of an object for it to be occlusion queried, as cheaper ones aren't worth it. */
+#define SIMPLE_SCENE_OCCLUSION_QUERY_MIN_INDEX_COUNT 3072
+/** @brief The number of consecutive query results which must find something hidden before it is left out. */
+#define SIMPLE_SCENE_OCCLUSION_QUERY_HIDDEN_COUNT 2
+/** @brief The most frames a query result may lag behind the current frame and still leave something out. */
+#define SIMPLE_SCENE_OCCLUSION_QUERY_MAX_AGE 4
+/** @brief The number of frames of queries remembered until their results are in. More than the frames in flight. */
+#define SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT 8
+/** @brief The fraction by which queried boxes are enlarged, so that what is about to come into view is drawn a little early. */
+#define SIMPLE_SCENE_OCCLUSION_QUERY_MARGIN 0.05f
+/** @brief Set in the target of a query for a terrain chunk, the rest being the index of the chunk among those of every terrain. */
+#define SIMPLE_SCENE_OCCLUSION_TARGET_TERRAIN_BIT 0x80000000u
+
+/** @brief The occlusion queries issued in a single frame, kept until their results are read back. */
+typedef struct simple_scene_occlusion_query_frame {
+    /** @brief The renderer frame number the queries were issued in. */
+    u64 frame_number;
+    /** @brief The number of queries. */
+    u32 query_count;
+    /** @brief What each query was of: a cull object index, or a terrain chunk index with SIMPLE_SCENE_OCCLUSION_TARGET_TERRAIN_BIT set. */
+    u32 targets[RENDERER_MAX_OCCLUSION_QUERIES];
+} simple_scene_occlusion_query_frame;
+
+/** @brief The shapes of the volumes a cull view keeps objects within. */
+typedef enum simple_scene_cull_view_type {
+    /** @brief Objects intersecting a frustum are visible. */
+    SIMPLE_SCENE_CULL_VIEW_TYPE_FRUSTUM,
+    /** @brief Objects within a distance of a line, e.g. casting shadows from a directional light, are visible. */
+    SIMPLE_SCENE_CULL_VIEW_TYPE_LINE,
+    /** @brief Objects within a distance of center, e.g. casting shadows from a point light, are visible. */
+    SIMPLE_SCENE_CULL_VIEW_TYPE_SPHERE
+} simple_scene_cull_view_type;
+
+/** @brief A single view of the scene culled by simple_scene_visibility_query. */
+typedef struct simple_scene_cull_view {
+    simple_scene_cull_view_type type;
+    /** @brief For frustum views, a constant pointer to the frustum. If 0, every object is visible. */
+    const frustum* f;
+    /** @brief For line views, the direction of the line. */
+    vec3 direction;
+    /** @brief For line and sphere views, the greatest distance from the line or center at which objects are visible. */
+    f32 radius;
+    /** @brief The position transparent geometries are sorted by distance from. Line views also pass through it, and sphere views are centered on it. */
+    vec3 center;
+    /** @brief The number of levels of detail coarser than those chosen for the LOD view to use, e.g. for shadow casters. */
+    u32 lod_bias;
+    /** @brief If true, the textures of visible objects are streamed in at the detail this view needs. */
+    b8 streams_textures;
+    /**
+     * @brief If true, the clusters of geometries drawn at full detail are culled one by one, against the
+     * frustum and by facing away from center, and only runs of those left are drawn. Not for views
+     * drawing shadows, which need back faces too.
+     */
+    b8 culls_clusters;
+    /**
+     * @brief If true, meshes with impostors which lie beyond their impostor distance from the LOD view
+     * are left out, to be drawn from their impostors instead. See simple_scene_visibility_impostors_get.
+     */
+    b8 draws_impostors;
+    /**
+     * @brief If true, transparent geometries are drawn with weighted blended order-independent
+     * transparency, so are placed in RENDER_SORT_LAYER_WEIGHTED_BLENDED instead of being sorted back to front.
+     */
+    b8 weighted_blended;
+} simple_scene_cull_view;
+
+/**
+ * @brief A billboard drawn in place of a distant mesh, facing the camera and showing the frame of
+ * the mesh's impostor atlas baked nearest the direction it is seen from. Laid out to match the
+ * instance attributes of the impostor shader.
+ */
+typedef struct simple_scene_impostor_instance {
+    /** @brief The world-space center of the mesh's bounds, and the radius of a sphere enclosing them. */
+    vec4 center_radius;
+    /** @brief The world-space x axis of the mesh, normalized. */
+    vec4 axis_x;
+    /** @brief The world-space y axis of the mesh, normalized. Its z axis is their cross product. */
+    vec4 axis_y;
+} simple_scene_impostor_instance;
+
+/** @brief A run of impostor instances sharing the same atlases, drawn with a single instanced draw. */
+typedef struct simple_scene_impostor_batch {
+    struct texture* albedo;
+    struct texture* normal;
+    /** @brief The number of frames along each side of the atlases. */
+    u32 frame_count;
+    /** @brief The index of the first instance of the batch. */
+    u32 first_instance;
+    u32 instance_count;
+} simple_scene_impostor_batch;
 
-    const char* mesh_resource_name;
+/**
+ * @brief The objects of a scene found visible by simple_scene_visibility_query, each with a mask
+ * of the views it is visible in. Allocated from the frame allocator, so only valid for the frame.
+ */
+typedef struct simple_scene_visibility {
+    /** @brief The number of views culled. */
+    u32 view_count;
+    /** @brief The views culled. */
+    simple_scene_cull_view views[SIMPLE_SCENE_MAX_CULL_VIEWS];
+    /** @brief The number of objects visible in at least one view. */
+    u32 object_count;
+    /** @brief The index of each visible cull object. */
+    u32* objects;
+    /** @brief For each visible object, bit i is set if it is visible in view i. */
+    u8* view_masks;
+} simple_scene_visibility;
+
+/** @brief A skeletal mesh placed in a scene, posed each frame by the animator at the same index. */
+typedef struct simple_scene_skinned_mesh {
+    char* name;
+    char* resource_name;
+    // The clip played on a loop, or 0 to hold the rest pose.
+    char* clip_name;
+    transform transform;
+    // Holds the skeletal mesh, whose skeleton and clips are used by its animator.
+    resource mesh_resource;
+    struct skeletal_mesh* mesh;
+    u32 geometry_count;
+    struct geometry** geometries;
+} simple_scene_skinned_mesh;
+
+/** @brief The state of a mesh, held as flags in its components. */
+typedef enum simple_scene_mesh_flag {
+    /** @brief All of the mesh's geometry is uploaded, so its bounds and renderable components are current. */
+    SIMPLE_SCENE_MESH_FLAG_LOADED = 0x01,
+    /** @brief Geometry of the mesh is waiting to be uploaded by simple_scene_update. */
+    SIMPLE_SCENE_MESH_FLAG_UPLOAD_PENDING = 0x02,
+    /** @brief The mesh is being loaded or reloaded, so is checked each update for geometry to upload. */
+    SIMPLE_SCENE_MESH_FLAG_LOADING = 0x04,
+    /** @brief The mesh's debug box has been created. */
+    SIMPLE_SCENE_MESH_FLAG_DEBUG = 0x08
+} simple_scene_mesh_flag;
 
-    u32 geometry_config_count;
-    struct geometry_config** g_configs;
+/**
+ * @brief The components of the scene's meshes which are read every frame, each a darray of its own
+ * at the same index as the mesh. The passes made over the meshes each frame (uploads, debug shapes
+ * and culling) read only the components they need, contiguously, rather than striding over the
+ * mesh structs. A mesh itself is only read from while it is loading.
+ */
+typedef struct simple_scene_mesh_components {
+    /** @brief The flags of each mesh. See simple_scene_mesh_flag. */
+    u8* flags;
+    /** @brief The transform component, pointing to the transform of each mesh. */
+    transform** transforms;
+    /** @brief The bounds component, holding the local-space extents of each loaded mesh. */
+    extents_3d* extents;
+    /** @brief The renderable component, holding the number of geometries of each loaded mesh... */
+    u16* geometry_counts;
+    /** @brief ...and the geometries themselves. */
+    struct geometry*** geometries;
+    /** @brief Set when meshes were added or removed, moving their transforms, until the next culling update. */
+    b8 transforms_moved;
+} simple_scene_mesh_components;
+
+/** @brief A mesh whose geometry is waiting to be uploaded. See simple_scene_update. */
+typedef struct pending_mesh {
+    /** @brief The index of the mesh in the scene's meshes. */
+    u32 mesh_index;
+    /** @brief The distance from the LOD view position to the mesh, which orders the uploads. */
+    f32 distance;
 } pending_mesh;
 
 typedef struct simple_scene {
@@ -62,12 +312,26 @@ typedef struct simple_scene {
 
     // darray of meshes.
     struct mesh* meshes;
+    // The components of the meshes read each frame, at the same index as each mesh.
+    simple_scene_mesh_components mesh_components;
 
     // darray of terrains.
     struct terrain* terrains;
 
-    // darray of meshes to be loaded.`
+    // darray of particle emitters, updated by simple_scene_update.
+    struct particle_emitter* emitters;
+
+    // darray of skinned meshes, and of their animators (at the same index), updated by simple_scene_update.
+    simple_scene_skinned_mesh* skinned_meshes;
+    struct skeletal_animator* animators;
+    // The skinning matrices of every animator, each in the range assigned to it.
+    mat4* skinning_palette;
+    u32 skinning_palette_count;
+
+    // darray of meshes with geometry waiting to be uploaded, gathered each frame by simple_scene_update.
     pending_mesh* pending_meshes;
+    // The number of bytes of mesh geometry which may be uploaded per frame. See simple_scene_upload_budget_set.
+    u64 upload_budget;
 
     // Singlular pointer to a skybox.
     struct skybox* sb;
@@ -78,6 +342,44 @@ typedef struct simple_scene {
     // A pointer to the scene configuration, if provided.
     struct simple_scene_config* config;
 
+    // darray of per-geometry culling data, updated each frame by simple_scene_culling_update.
+    simple_scene_cull_object* cull_objects;
+    // The bounds of the cull objects, updated along with them.
+    simple_scene_cull_bounds cull_bounds;
+    // A bounding volume hierarchy over the world bounds of the cull objects, used by spatial queries.
+    bvh cull_bvh;
+    // darray of the leaf of cull_bvh holding each cull object (at the same index).
+    u32* cull_bvh_leaves;
+    // The number of leaves inserted, removed or refit since cull_bvh was last built.
+    u32 cull_bvh_change_count;
+    // Caches the world matrices of the mesh transforms, updated once per frame by simple_scene_culling_update.
+    transform_hierarchy hierarchy;
+
+    // darray of whether each chunk of the terrains (in order) was found hidden. See simple_scene_visibility_occlusion_query.
+    simple_scene_occlusion_state* terrain_chunk_occlusion;
+    // The queries of each of the last several frames, at the frame number modulo SIMPLE_SCENE_OCCLUSION_QUERY_FRAME_COUNT. 0 until first queried.
+    simple_scene_occlusion_query_frame* occlusion_query_frames;
+    // The renderer frame number of the last query results applied.
+    u64 occlusion_applied_frame_number;
+
+    // darray of GPU object entries, one per cull object (at the same index).
+    simple_scene_gpu_object* gpu_objects;
+    // A persistent storage buffer of gpu_objects. Only dirty ranges are uploaded each frame.
+    renderbuffer object_buffer;
+    // The number of objects the object buffer can hold. 0 if not yet created.
+    u32 object_capacity;
+
+    // The position from which mesh levels of detail are chosen. See simple_scene_lod_view_set.
+    vec3 lod_view_position;
+    // The size in pixels of one unit at a distance of one unit from lod_view_position. 0 always chooses full detail.
+    f32 lod_scale;
+
+    // The last ray cast this frame, and a darray of its hits (null if none), returned again for an
+    // identical ray until the next simple_scene_update.
+    b8 raycast_cache_valid;
+    vec3 raycast_cache_origin;
+    vec3 raycast_cache_direction;
+    struct raycast_hit* raycast_cache_hits;
 } simple_scene;
 
 /**
@@ -118,7 +420,37 @@ KAPI b8 simple_scene_load(simple_scene* scene);
 KAPI b8 simple_scene_unload(simple_scene* scene, b8 immediate);
 
 /**
- * @brief Performs any required scene updates for the given frame.
+ * @brief Releases the scene's hold on code in the game library before it is unloaded, by
+ * unregistering its event handlers. The scene's data and resources are kept as they are.
+ *
+ * @param scene A pointer to the scene.
+ */
+KAPI void simple_scene_on_lib_unload(simple_scene* scene);
+
+/**
+ * @brief Rebinds the scene to code in the newly loaded game library, by registering its
+ * event handlers again.
+ *
+ * @param scene A pointer to the scene.
+ */
+KAPI void simple_scene_on_lib_load(simple_scene* scene);
+
+/**
+ * @brief Saves the current state of the given scene to a binary simple scene (.ksb) file, such
+ * that loading it recreates the scene with its lights, meshes and terrains as they are now.
+ * Terrains are only saved if they came from the scene's configuration, which names their resources.
+ *
+ * @param scene A pointer to the scene to be saved.
+ * @param path The path of the file to be written. Overwritten if it exists.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_save(simple_scene* scene, const char* path);
+
+/**
+ * @brief Performs any required scene updates for the given frame. This includes uploading
+ * the geometry of meshes which have finished loading, nearest to the LOD view position first,
+ * within the scene's upload budget. Meshes are rendered as soon as all of their geometry is
+ * uploaded, using default textures until their own are loaded.
  *
  * @param scene A pointer to the scene to be updated.
  * @param p_frame_data A constant pointer to the current frame's data.
@@ -126,6 +458,39 @@ KAPI b8 simple_scene_unload(simple_scene* scene, b8 immediate);
  */
 KAPI b8 simple_scene_update(simple_scene* scene, const struct frame_data* p_frame_data);
 
+/**
+ * @brief Sets the number of bytes of mesh geometry the scene may upload per frame, so that
+ * streaming a scene in is spread over frames rather than causing a spike. A mesh geometry
+ * larger than the budget is still uploaded, on a frame of its own.
+ *
+ * @param scene A pointer to the scene.
+ * @param budget The number of bytes per frame. 0 uploads one geometry per frame.
+ */
+KAPI void simple_scene_upload_budget_set(simple_scene* scene, u64 budget);
+
+/**
+ * @brief Updates the scene's culling data (world matrices and bounds of every loaded
+ * mesh geometry) for objects whose transforms changed, and uploads those objects to the
+ * GPU object buffer. Must be called once per frame before any mesh render data queries.
+ *
+ * @param scene A pointer to the scene.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_culling_update(simple_scene* scene, struct frame_data* p_frame_data);
+
+/**
+ * @brief Sets the view from which the levels of detail of meshes are chosen by render data
+ * queries. Each geometry is drawn at the least detail whose error, projected from this view,
+ * stays within SIMPLE_SCENE_LOD_MAX_ERROR_PIXELS. Until set, full detail is always used.
+ *
+ * @param scene A pointer to the scene.
+ * @param view_position The position of the view.
+ * @param fov The vertical field of view of the view, in radians.
+ * @param view_height The height of the view, in pixels.
+ */
+KAPI void simple_scene_lod_view_set(simple_scene* scene, vec3 view_position, f32 fov, f32 view_height);
+
 /**
  * @brief Populate the given render packet with data from the provided scene.
  *
@@ -172,9 +537,156 @@ KAPI struct terrain* simple_scene_terrain_get(simple_scene* scene, const char* n
 
 KAPI struct transform* simple_scene_transform_get_by_id(simple_scene* scene, u64 unique_id);
 
-KAPI b8 simple_scene_debug_render_data_query(simple_scene* scene, u32* data_count, struct geometry_render_data** debug_geometries);
+/**
+ * @brief Adds the scene's debug shapes (its grid, and the bounds of its lights and meshes) to the given batch.
+ *
+ * @param scene A pointer to the scene.
+ * @param batch A pointer to the batch to add the shapes to.
+ */
+KAPI void simple_scene_debug_draw(simple_scene* scene, struct debug_draw_batch* batch);
+
+/**
+ * @brief Queries the scene for draw records of the mesh geometries within the given frustum.
+ * Each record's object index selects its model from cull_bounds.models and its entry in the
+ * object buffer.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param f A constant pointer to the frustum. If 0, every geometry is included.
+ * @param center The position transparent geometries are sorted by distance from.
+ * @param lod_bias The number of levels of detail coarser than those chosen for the view to use, e.g. for shadow casters.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param out_count A pointer to hold the number of records in out_records.
+ * @param out_records A darray to which the draw records are added, in draw order.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_mesh_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, u32 lod_bias, struct frame_data* p_frame_data, u32* out_count, struct geometry_draw_record* out_records);
+KAPI b8 simple_scene_mesh_render_data_query_from_line(const simple_scene* scene, vec3 direction, vec3 center, f32 radius, u32 lod_bias, struct frame_data* p_frame_data, u32* out_count, struct geometry_draw_record* out_records);
+
+/**
+ * @brief Culls the scene's meshes against several views at once, in a single pass over the scene's
+ * bounding volume hierarchy. Each object is tested against every view, so its bounds are only
+ * read once per frame however many views there are. Draw records for each view are then obtained
+ * with simple_scene_visibility_render_data_get.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param view_count The number of views. At most SIMPLE_SCENE_MAX_CULL_VIEWS.
+ * @param views An array of view_count views.
+ * @param p_frame_data A pointer to the current frame's data, whose allocator the results are taken from.
+ * @param out_visibility A pointer to hold the visible objects.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_visibility_query(const simple_scene* scene, u32 view_count, const simple_scene_cull_view* views, struct frame_data* p_frame_data, simple_scene_visibility* out_visibility);
+
+/**
+ * @brief Indicates if the given cull object has been updated (e.g. its transform changed) within
+ * the last SIMPLE_SCENE_MOVING_FRAME_COUNT frames, such as to keep it out of cached shadows.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param object_index The index of the cull object, e.g. the object index of a draw record.
+ * @param p_frame_data A constant pointer to the current frame's data.
+ * @return True if the object is moving; otherwise false.
+ */
+KAPI b8 simple_scene_object_is_moving(const simple_scene* scene, u32 object_index, const struct frame_data* p_frame_data);
 
-KAPI b8 simple_scene_mesh_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data* out_geometries);
-KAPI b8 simple_scene_mesh_render_data_query_from_line(const simple_scene* scene, vec3 direction, vec3 center, f32 radius, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data* out_geometries);
+/**
+ * @brief Adds draw records for the mesh geometries visible in a single view of the given visibility,
+ * in draw order, as simple_scene_mesh_render_data_query does for its frustum.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param visibility A constant pointer to the visibility, as obtained from simple_scene_visibility_query.
+ * @param view_index The index of the view within the visibility.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param out_count A pointer to hold the number of records in out_records.
+ * @param out_records A darray to which the draw records are added, in draw order.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_visibility_render_data_get(const simple_scene* scene, const simple_scene_visibility* visibility, u32 view_index, struct frame_data* p_frame_data, u32* out_count, struct geometry_draw_record* out_records);
 
-KAPI b8 simple_scene_terrain_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data* out_terrain_geometries);
+/**
+ * @brief Obtains the impostor instances of the meshes left out of a single view of the given
+ * visibility for lying beyond their impostor distance, one per mesh, grouped into batches by atlas.
+ * Only views with draws_impostors set leave any out.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param visibility A constant pointer to the visibility, as obtained from simple_scene_visibility_query.
+ * @param view_index The index of the view within the visibility.
+ * @param p_frame_data A pointer to the current frame's data, whose allocator the results are taken from.
+ * @param out_instance_count A pointer to hold the number of instances.
+ * @param out_instances A pointer to hold the instances, ordered by batch.
+ * @param out_batch_count A pointer to hold the number of batches.
+ * @param out_batches A pointer to hold the batches.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_visibility_impostors_get(const simple_scene* scene, const simple_scene_visibility* visibility, u32 view_index, struct frame_data* p_frame_data, u32* out_instance_count, simple_scene_impostor_instance** out_instances, u32* out_batch_count, simple_scene_impostor_batch** out_batches);
+
+/**
+ * @brief Removes the objects hidden behind others from a single view of the given visibility, on
+ * the CPU. The largest opaque objects on screen in the view (up to SIMPLE_SCENE_MAX_OCCLUDERS)
+ * are drawn into the occlusion buffer, and every other object visible in the view is tested
+ * against it. Intended for when culling can't be done on the GPU.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param visibility A pointer to the visibility, as obtained from simple_scene_visibility_query.
+ * @param view_index The index of the view within the visibility. Should be a frustum view.
+ * @param view_projection The view-projection matrix of the view.
+ * @param buffer A pointer to the occlusion buffer to draw the occluders into.
+ * @param out_culled_count A pointer to hold the number of objects found hidden. Optional.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_visibility_occlusion_cull(const simple_scene* scene, simple_scene_visibility* visibility, u32 view_index, mat4 view_projection, struct occlusion_buffer* buffer, u32* out_culled_count);
+
+/**
+ * @brief Removes the objects found hidden by the renderer's occlusion queries of earlier frames from a
+ * single view of the given visibility, marks the terrain chunks found hidden so they are skipped by
+ * the terrain queries, and obtains the boxes to query this frame. Intended for when culling can't be
+ * done on the GPU, or as well as simple_scene_visibility_occlusion_cull.
+ *
+ * Objects with at least SIMPLE_SCENE_OCCLUSION_QUERY_MIN_INDEX_COUNT indices and terrain chunks visible
+ * in the view are queried each frame by drawing their (slightly enlarged) bounds behind what has been
+ * drawn of the scene. As the results arrive a frame or more later, something is only left out once
+ * SIMPLE_SCENE_OCCLUSION_QUERY_HIDDEN_COUNT results in a row found it hidden, the latest no more than
+ * SIMPLE_SCENE_OCCLUSION_QUERY_MAX_AGE frames ago and issued since it last moved. Anything the view
+ * position is within the bounds of is always drawn. Hidden things are still queried, so they are drawn
+ * again as soon as a result finds them in view. Does nothing if occlusion queries aren't supported.
+ *
+ * @param scene A pointer to the scene.
+ * @param visibility A pointer to the visibility, as obtained from simple_scene_visibility_query.
+ * @param view_index The index of the view within the visibility. Should be the frustum view the boxes are drawn in.
+ * @param near_clip The near clip distance of the view, within which of a box it counts as being inside it.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param out_box_count A pointer to hold the number of boxes to query. Each is queried with its own index, in order.
+ * @param out_boxes An array of at least RENDERER_MAX_OCCLUSION_QUERIES to hold the world-space boxes to query.
+ * @param out_culled_count A pointer to hold the number of objects and terrain chunks left out. Optional.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_visibility_occlusion_query(simple_scene* scene, simple_scene_visibility* visibility, u32 view_index, f32 near_clip, struct frame_data* p_frame_data, u32* out_box_count, extents_3d* out_boxes, u32* out_culled_count);
+
+/**
+ * @brief Obtains the total number of chunks of the terrains in the scene, which is the most
+ * geometries simple_scene_terrain_render_data_query can add.
+ *
+ * @param scene A constant pointer to the scene.
+ * @return The number of terrain chunks in the scene.
+ */
+KAPI u32 simple_scene_terrain_chunk_count_get(const simple_scene* scene);
+
+KAPI b8 simple_scene_terrain_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, b8 skip_hidden, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data* out_terrain_geometries);
+
+/**
+ * @brief Obtains the visible chunks of the vertex-pulled terrains in the scene as instances of their
+ * patches, with one batch per terrain and level of detail, each drawing its run of the instances.
+ * Levels of detail are chosen as they are by simple_scene_terrain_render_data_query, which skips these
+ * terrains. At most simple_scene_terrain_chunk_count_get instances and batches are added.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param f A constant pointer to the frustum to cull chunks against. Optional.
+ * @param center The position levels of detail are chosen by the distance from.
+ * @param skip_hidden Indicates if chunks found hidden by simple_scene_visibility_occlusion_query this frame are skipped.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param out_batch_count A pointer to hold the number of batches.
+ * @param out_batches A darray to push the batches to.
+ * @param out_instance_count A pointer to hold the number of instances.
+ * @param out_instances A darray to push the instances to.
+ * @return True on success; otherwise false.
+ */
+KAPI b8 simple_scene_terrain_patch_query(const simple_scene* scene, const frustum* f, vec3 center, b8 skip_hidden, struct frame_data* p_frame_data, u32* out_batch_count, struct terrain_patch_batch* out_batches, u32* out_instance_count, struct terrain_patch_instance* out_instances);
@@ -8,14 +8,17 @@
 #include <core/kclock.h>
 #include <core/kmemory.h>
 #include <core/kstring.h>
+#include <core/kvar.h>
 #include <core/logger.h>
 #include <core/metrics.h>
 #include <math/geometry_2d.h>
 #include <math/geometry_3d.h>
 #include <math/kmath.h>
 #include <renderer/camera.h>
+#include <renderer/debug_draw.h>
 #include <renderer/renderer_frontend.h>
 #include <renderer/renderer_types.h>
+#include <renderer/renderer_utils.h>
 #include <resources/terrain.h>
 
 #include "core/engine.h"
@@ -36,11 +39,19 @@
 
 // Rendergraph and passes.
 #include "passes/editor_pass.h"
+#include "passes/depth_prepass.h"
+#include "passes/impostor_pass.h"
+#include "passes/oit_composite_pass.h"
+#include "passes/particle_pass.h"
+#include "passes/skinned_pass.h"
 #include "passes/scene_pass.h"
 #include "passes/skybox_pass.h"
 #include "renderer/rendergraph.h"
 // Core shadow map pass.
+#include <renderer/light_cluster.h>
+#include <renderer/passes/point_shadow_pass.h>
 #include <renderer/passes/shadow_map_pass.h>
+#include <renderer/passes/upscale_pass.h>
 
 // Views
 /* #include "editor/render_view_wireframe.h"
@@ -77,19 +88,19 @@
 #include "game_keybinds.h"
 // TODO: end temp
 
-/** @brief A private structure used to sort geometry by distance from the camera. */
-typedef struct geometry_distance {
-    /** @brief The geometry render data. */
-    geometry_render_data g;
-    /** @brief The distance from the camera. */
-    f32 distance;
-} geometry_distance;
+// The most debug shape vertices drawn per frame: the bounds of 16k meshes, at 24 vertices each.
+#define TESTBED_DEBUG_DRAW_MAX_VERTICES (16384 * 24)
+// The camera rotation per unit of raw mouse movement while looking around, in radians.
+#define TESTBED_MOUSE_LOOK_SENSITIVITY 0.0025f
 
 b8 configure_render_views(application_config* config);
 void application_register_events(struct application* game_inst);
 void application_unregister_events(struct application* game_inst);
-static b8 load_main_scene(struct application* game_inst);
+static b8 load_main_scene(struct application* game_inst, const char* scene_name);
 static b8 configure_rendergraph(application* app);
+static b8 replay_ready(testbed_game_state* state);
+static void overlay_passes_prepare(testbed_game_state* state, frame_data* p_frame_data);
+static void refresh_rendergraph_pfns(application* app);
 
 static void clear_debug_objects(struct application* game_inst) {
     testbed_game_state* state = (testbed_game_state*)game_inst->state;
@@ -186,7 +197,7 @@ b8 game_on_debug_event(u16 code, void* sender, void* listener_inst, event_contex
     } else if (code == EVENT_CODE_DEBUG1) {
         if (state->main_scene.state < SIMPLE_SCENE_STATE_LOADING) {
             KDEBUG("Loading main scene...");
-            if (!load_main_scene(game_inst)) {
+            if (!load_main_scene(game_inst, "test_scene")) {
                 KERROR("Error loading main scene");
             }
         }
@@ -195,6 +206,8 @@ b8 game_on_debug_event(u16 code, void* sender, void* listener_inst, event_contex
         if (state->main_scene.state == SIMPLE_SCENE_STATE_LOADED) {
             KDEBUG("Unloading scene...");
 
+            ibl_environment_destroy(&state->ibl);
+            state->ibl_skybox = 0;
             simple_scene_unload(&state->main_scene, false);
             clear_debug_objects(game_inst);
             KDEBUG("Done.");
@@ -214,13 +227,12 @@ b8 game_on_debug_event(u16 code, void* sender, void* listener_inst, event_contex
             static b8 playing = true;
             playing = !playing;
             if (playing) {
-                // Play on channel 6
-                if (!audio_system_channel_emitter_play(6, &state->test_emitter)) {
+                // The audio system gives it a voice while it is in range.
+                if (!audio_system_emitter_play(&state->test_emitter)) {
                     KERROR("Failed to play test emitter.");
                 }
             } else {
-                // Stop channel 6.
-                audio_system_channel_stop(6);
+                audio_system_emitter_stop(&state->test_emitter);
             }
         }
     }
@@ -357,6 +369,7 @@ b8 game_on_button(u16 code, void* sender, void* listener_inst, event_context con
                                 }
                             }
                         }
+                        darray_destroy(r_result.hits);
                     } else {
                         KINFO("No hit");
 
@@ -396,18 +409,9 @@ static b8 game_on_mouse_move(u16 code, void* sender, void* listener_inst, event_
 
         testbed_game_state* state = (testbed_game_state*)listener_inst;
 
-        mat4 view = camera_view_get(state->world_camera);
-        vec3 origin = camera_position_get(state->world_camera);
-
-        viewport* v = &state->world_viewport;
-        ray r = ray_from_screen(
-            vec2_create((f32)x, (f32)y),
-            (v->rect),
-            origin,
-            view,
-            v->projection);
-
-        editor_gizmo_handle_interaction(&state->gizmo, state->world_camera, &r, EDITOR_GIZMO_INTERACTION_TYPE_MOUSE_HOVER);
+        // Several moves may arrive per frame, so only the last is hover tested, in application_update.
+        state->hover_position = vec2_create((f32)x, (f32)y);
+        state->hover_pending = true;
     }
     return false;  // Allow other event handlers to recieve this event.
 }
@@ -476,6 +480,15 @@ b8 application_boot(struct application* game_inst) {
     // Console commands
     game_setup_commands(game_inst);
 
+    // Benchmark mode, if requested on the command line.
+    testbed_game_state* boot_state = (testbed_game_state*)game_inst->state;
+    if (render_benchmark_parse(game_inst->argc, game_inst->argv, &boot_state->benchmark)) {
+        KINFO("Starting in benchmark mode.");
+    }
+    if (upload_benchmark_parse(game_inst->argc, game_inst->argv, &boot_state->upload_benchmark)) {
+        KINFO("Starting in upload benchmark mode.");
+    }
+
     return true;
 }
 
@@ -507,9 +520,38 @@ b8 application_initialize(struct application* game_inst) {
 
     debug_console_load(&state->debug_console);
 
+    // Draw static geometry to depth before shading it, so each pixel is only shaded once.
+    kvar_int_create("depth_prepass", 1);
+    state->depth_prepass_kvar = kvar_handle_get("depth_prepass");
+    state->gpu_timings_kvar = kvar_handle_get("gpu_timings");
+    // Cull objects hidden behind large occluders on the CPU. Off by default, since it costs CPU time every frame.
+    kvar_int_create("occlusion_culling", 0);
+    state->occlusion_culling_kvar = kvar_handle_get("occlusion_culling");
+    // Skips what the GPU found hidden in earlier frames, when the renderer supports it.
+    kvar_int_create("occlusion_queries", 0);
+    state->occlusion_queries_kvar = kvar_handle_get("occlusion_queries");
+    // Simulate particles with compute shaders where supported, otherwise on the CPU.
+    kvar_int_create("particles_gpu", 1);
+    state->particles_gpu_kvar = kvar_handle_get("particles_gpu");
+    // Scale the resolution of the scene to keep the GPU time of a frame within its target.
+    kvar_int_create("dynamic_resolution", 1);
+    state->dynamic_resolution_kvar = kvar_handle_get("dynamic_resolution");
+    dynamic_resolution_create(0, &state->resolution_controller);
+
     state->test_lines = darray_create(debug_line3d);
     state->test_boxes = darray_create(debug_box3d);
 
+    // Room for the bounds of every mesh in a large scene, in a single draw.
+    if (!debug_draw_batch_create("renderbuffer_debug_draw", TESTBED_DEBUG_DRAW_MAX_VERTICES, &state->debug_batch)) {
+        KERROR("Failed to create debug draw batch. Cannot start application.");
+        return false;
+    }
+
+    if (!occlusion_buffer_create(OCCLUSION_BUFFER_DEFAULT_WIDTH, OCCLUSION_BUFFER_DEFAULT_HEIGHT, &state->occlusion_buffer)) {
+        KERROR("Failed to create occlusion buffer. Cannot start application.");
+        return false;
+    }
+
     // Viewport setup.
     // World Viewport
     rect_2d world_vp_rect = vec4_create(20.0f, 20.0f, 1280.0f - 40.0f, 720.0f - 40.0f);
@@ -635,7 +677,7 @@ b8 application_initialize(struct application* game_inst) {
         }
     }
 
-    if (!sui_label_control_create("testbed_UTF_test_sys_text", FONT_TYPE_SYSTEM, "Noto Sans CJK JP", 31, "Press 'L' to load a \n\tscene!\n\n\tこんにちは 한", &state->test_sys_text)) {
+    if (!sui_label_control_create("testbed_UTF_test_sys_text", FONT_TYPE_SYSTEM_SDF, "Noto Sans CJK JP", 31, "Press 'L' to load a \n\tscene!\n\n\tこんにちは 한", &state->test_sys_text)) {
         KERROR("Failed to load basic ui system text.");
         return false;
     } else {
@@ -697,6 +739,8 @@ b8 application_initialize(struct application* game_inst) {
     state->test_emitter.looping = true;
     state->test_emitter.falloff = 1.0f;
     state->test_emitter.position = vec3_create(10.0f, 0.8f, 20.0f);
+    state->test_emitter.max_distance = 40.0f;
+    state->test_emitter.instance_id = INVALID_ID;
 
     // Set some channel volumes.
     audio_system_master_volume_set(0.9f);
@@ -714,6 +758,32 @@ b8 application_initialize(struct application* game_inst) {
     }
     audio_system_channel_play(7, state->test_music, true); */
 
+    // Benchmark runs load their scene straight away, and shouldn't be held to the display's refresh rate.
+    if (state->benchmark.active) {
+        renderer_flag_enabled_set(RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT, false);
+        // A replay loads the scene its capture was taken in.
+        if (state->benchmark.replay_path[0]) {
+            if (!render_capture_load(state->benchmark.replay_path, &state->replay)) {
+                KERROR("Failed to load frame capture '%s' to replay.", state->benchmark.replay_path);
+                return false;
+            }
+            string_ncopy(state->benchmark.scene_name, state->replay.scene_name, sizeof(state->benchmark.scene_name) - 1);
+        }
+        if (!render_benchmark_begin(&state->benchmark, state->world_camera) || !load_main_scene(game_inst, state->benchmark.scene_name)) {
+            KERROR("Failed to start benchmark of scene '%s'.", state->benchmark.scene_name);
+            return false;
+        }
+    }
+
+    // The upload benchmark times its operations straight away, then measures bursts over the frames that follow.
+    if (state->upload_benchmark.active) {
+        renderer_flag_enabled_set(RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT, false);
+        if (!upload_benchmark_begin(&state->upload_benchmark)) {
+            KERROR("Failed to start upload benchmark.");
+            return false;
+        }
+    }
+
     state->running = true;
 
     return true;
@@ -732,18 +802,51 @@ b8 application_update(struct application* game_inst, struct frame_data* p_frame_
 
     kclock_start(&state->update_clock);
 
+    if (state->upload_benchmark.active) {
+        upload_benchmark_frame_begin(&state->upload_benchmark);
+    }
+
     // TODO: testing resize
     static f32 button_height = 50.0f;
     button_height = 50.0f + (ksin(p_frame_data->total_time) * 20.0f);
     sui_button_control_height_set(&state->test_button, (i32)button_height);
 
-    if (state->main_scene.state >= SIMPLE_SCENE_STATE_LOADED) {
+    if (state->main_scene.state >= SIMPLE_SCENE_STATE_LOADED && !replay_ready(state)) {
+        if (state->benchmark.active) {
+            render_benchmark_camera_update(&state->benchmark, state->world_camera);
+        } else if (input_is_button_down(BUTTON_RIGHT)) {
+            // Holding the right mouse button looks around with the mouse.
+            f32 mouse_dx, mouse_dy;
+            input_get_mouse_delta(&mouse_dx, &mouse_dy);
+            camera_yaw(state->world_camera, -mouse_dx * TESTBED_MOUSE_LOOK_SENSITIVITY);
+            camera_pitch(state->world_camera, -mouse_dy * TESTBED_MOUSE_LOOK_SENSITIVITY);
+        }
+
         if (!simple_scene_update(&state->main_scene, p_frame_data)) {
             KWARN("Failed to update main scene.");
         }
 
         editor_gizmo_update(&state->gizmo);
 
+        // Hover test the last mouse position of the frame, if it moved, against the updated gizmo.
+        if (state->hover_pending) {
+            state->hover_pending = false;
+            if (!input_is_button_dragging(BUTTON_LEFT)) {
+                mat4 view = camera_view_get(state->world_camera);
+                vec3 origin = camera_position_get(state->world_camera);
+
+                viewport* v = &state->world_viewport;
+                ray r = ray_from_screen(
+                    state->hover_position,
+                    (v->rect),
+                    origin,
+                    view,
+                    v->projection);
+
+                editor_gizmo_handle_interaction(&state->gizmo, state->world_camera, &r, EDITOR_GIZMO_INTERACTION_TYPE_MOUSE_HOVER);
+            }
+        }
+
         // // Perform a small rotation on the first mesh.
         // quat rotation = quat_from_axis_angle((vec3){0, 1, 0}, -0.5f * p_frame_data->delta_time, false);
         // transform_rotate(&state->meshes[0].transform, rotation);
@@ -786,6 +889,11 @@ b8 application_update(struct application* game_inst, struct frame_data* p_frame_
 
     f64 fps, frame_time;
     metrics_frame(&fps, &frame_time);
+    metrics_gpu_memory gpu_memory;
+    metrics_gpu_memory_get(&gpu_memory);
+    f64 latency_ms;
+    u32 frames_queued;
+    metrics_frame_latency(&latency_ms, &frames_queued);
 
     // Keep a running average of update and render timers over the last ~1 second.
     static f64 accumulated_ms = 0;
@@ -821,6 +929,8 @@ b8 application_update(struct application* game_inst, struct frame_data* p_frame_
     }
 
     char* vsync_text = renderer_flag_enabled_get(RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT) ? "YES" : " NO";
+    renderer_bind_stats bind_stats;
+    renderer_bind_stats_get(&bind_stats);
     char text_buffer[2048];
     string_format(
         text_buffer,
@@ -828,7 +938,10 @@ b8 application_update(struct application* game_inst, struct frame_data* p_frame_
 FPS: %5.1f(%4.1fms)        Pos=[%7.3f %7.3f %7.3f] Rot=[%7.3f, %7.3f, %7.3f]\n\
 Upd: %8.3fus, Prep: %8.3fus, Rend: %8.3fus, Pres: %8.3fus, Tot: %8.3fus \n\
 Mouse: X=%-5d Y=%-5d   L=%s R=%s   NDC: X=%.6f, Y=%.6f\n\
-VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u",
+VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u\n\
+GPU: %u blocks %.1fMiB (%.1fMiB used), %u allocs, %u dedicated (%.1fMiB)\n\
+Binds: %u shader, %u descriptor, %u buffer, %u draws\n\
+Latency: %5.2fms (%u queued)",
         fps,
         frame_time,
         pos.x, pos.y, pos.z,
@@ -847,7 +960,33 @@ VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u",
         p_frame_data->drawn_mesh_count,
         p_frame_data->drawn_shadow_mesh_count,
         state->hovered_object_id == INVALID_ID ? "none" : "",
-        state->hovered_object_id == INVALID_ID ? 0 : state->hovered_object_id);
+        state->hovered_object_id == INVALID_ID ? 0 : state->hovered_object_id,
+        gpu_memory.block_count,
+        gpu_memory.block_bytes / (f64)MEBIBYTES(1),
+        gpu_memory.block_used_bytes / (f64)MEBIBYTES(1),
+        gpu_memory.block_allocation_count,
+        gpu_memory.dedicated_count,
+        gpu_memory.dedicated_bytes / (f64)MEBIBYTES(1),
+        bind_stats.shader_binds,
+        bind_stats.descriptor_binds,
+        bind_stats.vertex_buffer_binds,
+        bind_stats.draw_calls,
+        latency_ms,
+        frames_queued);
+
+    // Per-pass GPU timings, if enabled.
+    i32 show_gpu_timings = kvar_int_value(state->gpu_timings_kvar, 0);
+    if (show_gpu_timings) {
+        metrics_gpu_pass passes[METRICS_MAX_GPU_PASSES];
+        u32 pass_count = metrics_gpu_passes_get(passes);
+        for (u32 i = 0; i < pass_count; ++i) {
+            u32 length = string_length(text_buffer);
+            if (length + 128 >= sizeof(text_buffer)) {
+                break;
+            }
+            string_format(text_buffer + length, "\n%-32s %7.3fms", passes[i].name, passes[i].ms);
+        }
+    }
     if (state->running) {
         sui_label_text_set(&state->test_text, text_buffer);
     }
@@ -864,6 +1003,244 @@ VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u",
     return true;
 }
 
+// Indicates if a frame capture is being replayed, and its geometries have been found in the loaded scene.
+static b8 replay_ready(testbed_game_state* state) {
+    if (!state->benchmark.replay_path[0] || state->main_scene.state != SIMPLE_SCENE_STATE_LOADED) {
+        return false;
+    }
+    if (state->replay.resolved) {
+        return true;
+    }
+    if (!render_capture_resolve(&state->replay, &state->main_scene)) {
+        return false;
+    }
+
+    if (state->replay.width != (u32)state->world_viewport.rect.width || state->replay.height != (u32)state->world_viewport.rect.height) {
+        KWARN("Frame capture was taken at %ux%u, but is replayed at %ux%u.",
+              state->replay.width, state->replay.height, (u32)state->world_viewport.rect.width, (u32)state->world_viewport.rect.height);
+    }
+    KINFO("Replaying %u scene and %u shadow draws.", state->replay.record_counts[RENDER_CAPTURE_LIST_SCENE], state->replay.record_counts[RENDER_CAPTURE_LIST_SHADOW]);
+    return true;
+}
+
+// Image based lighting comes from the skybox. Its convolved cubes are generated, or loaded from the cache, when it changes.
+static void scene_pass_lighting_set(testbed_game_state* state, scene_pass_extended_data* ext_data) {
+    skybox* sb = state->main_scene.sb;
+    if (sb && state->ibl_skybox != sb) {
+        ibl_environment_destroy(&state->ibl);
+        state->ibl_skybox = sb;
+        ibl_environment_config ibl_config = {0};
+        ibl_config.cubemap_name = sb->config.cubemap_name;
+        if (!ibl_environment_create(&ibl_config, sb->cubemap.texture, &state->ibl)) {
+            KWARN("Failed to create image based lighting for the skybox. The skybox itself will be used as irradiance.");
+        }
+    }
+    if (state->ibl.state == IBL_ENVIRONMENT_STATE_READY) {
+        ext_data->irradiance_cube_texture = state->ibl.irradiance;
+        ext_data->ibl_specular_cube_texture = state->ibl.specular;
+        ext_data->ibl_brdf_lut = state->ibl.brdf_lut;
+    } else {
+        // Until then, fall back to the skybox cubemap as the irradiance texture.
+        ext_data->irradiance_cube_texture = sb ? sb->cubemap.texture : 0;
+        ext_data->ibl_specular_cube_texture = 0;
+        ext_data->ibl_brdf_lut = 0;
+    }
+}
+
+// Picks the point lights nearest the camera to cast shadows, as many as the atlas holds, and gathers
+// the meshes within reach of each. Meshes which moved lately are kept apart, as they are drawn every frame.
+static void point_shadows_prepare(testbed_game_state* state, frame_data* p_frame_data) {
+    rendergraph_pass* pass = &state->point_shadow_pass;
+    point_shadow_pass_extended_data* ext_data = pass->pass_data.ext_data;
+    simple_scene* scene = &state->main_scene;
+    vec3 camera_position = camera_position_get(state->world_camera);
+
+    // Sorted by the distance from the camera to the edge of their reach, nearest first.
+    point_light* lights[POINT_SHADOW_SLOT_COUNT];
+    f32 radii[POINT_SHADOW_SLOT_COUNT];
+    f32 distances[POINT_SHADOW_SLOT_COUNT];
+    u32 light_count = 0;
+    u32 point_light_count = scene->point_lights ? darray_length(scene->point_lights) : 0;
+    for (u32 i = 0; i < point_light_count; ++i) {
+        point_light* light = &scene->point_lights[i];
+        f32 radius = light_cluster_point_light_radius(&light->data);
+        if (radius <= 0.0f) {
+            continue;
+        }
+        f32 distance = KMAX(vec3_distance(vec3_from_vec4(light->data.position), camera_position) - radius, 0.0f);
+        u32 j = light_count < POINT_SHADOW_SLOT_COUNT ? light_count++ : POINT_SHADOW_SLOT_COUNT;
+        while (j > 0 && distances[j - 1] > distance) {
+            if (j < POINT_SHADOW_SLOT_COUNT) {
+                lights[j] = lights[j - 1];
+                radii[j] = radii[j - 1];
+                distances[j] = distances[j - 1];
+            }
+            j--;
+        }
+        if (j < POINT_SHADOW_SLOT_COUNT) {
+            lights[j] = light;
+            radii[j] = radius;
+            distances[j] = distance;
+        }
+    }
+
+    pass->pass_data.do_execute = light_count > 0;
+    ext_data->light_count = light_count;
+    ext_data->models = scene->cull_bounds.models;
+    if (!light_count) {
+        light_system_point_shadows_set(0, 0, 0);
+        return;
+    }
+
+    // The meshes within reach of every light are culled together, a view for each.
+    simple_scene_cull_view views[POINT_SHADOW_SLOT_COUNT] = {0};
+    for (u32 i = 0; i < light_count; ++i) {
+        views[i].type = SIMPLE_SCENE_CULL_VIEW_TYPE_SPHERE;
+        views[i].center = vec3_from_vec4(lights[i]->data.position);
+        views[i].radius = radii[i];
+        views[i].lod_bias = SHADOW_LOD_BIAS;
+    }
+    simple_scene_visibility visibility = {0};
+    if (!simple_scene_visibility_query(scene, light_count, views, p_frame_data, &visibility)) {
+        KERROR("Failed to cull point shadow meshes.");
+    }
+
+    for (u32 i = 0; i < light_count; ++i) {
+        point_shadow_light_data* data = &ext_data->lights[i];
+        data->light = lights[i];
+        data->position = views[i].center;
+        data->radius = radii[i];
+        data->static_geometry_count = 0;
+        data->dynamic_geometry_count = 0;
+
+        u32 geometry_count = 0;
+        geometry_draw_record* geometries = darray_reserve_with_allocator(geometry_draw_record, 512, &p_frame_data->allocator);
+        if (visibility.view_count && !simple_scene_visibility_render_data_get(scene, &visibility, i, p_frame_data, &geometry_count, geometries)) {
+            KERROR("Failed to query point shadow meshes.");
+            geometry_count = 0;
+        }
+        data->static_geometries = p_frame_data->allocator.allocate(sizeof(geometry_draw_record) * KMAX(geometry_count, 1));
+        data->dynamic_geometries = p_frame_data->allocator.allocate(sizeof(geometry_draw_record) * KMAX(geometry_count, 1));
+        for (u32 g = 0; g < geometry_count; ++g) {
+            if (simple_scene_object_is_moving(scene, geometries[g].object_index, p_frame_data)) {
+                data->dynamic_geometries[data->dynamic_geometry_count++] = geometries[g];
+            } else {
+                data->static_geometries[data->static_geometry_count++] = geometries[g];
+            }
+        }
+        p_frame_data->drawn_shadow_mesh_count += geometry_count;
+    }
+
+    point_shadow_pass_prepare(pass, p_frame_data);
+
+    // Only the lights whose faces have been rendered are shadowed.
+    point_light* shadowed_lights[POINT_SHADOW_SLOT_COUNT];
+    point_light_shadow_data shadows[POINT_SHADOW_SLOT_COUNT];
+    u32 shadowed_count = 0;
+    for (u32 i = 0; i < light_count; ++i) {
+        if (ext_data->lights[i].has_shadow) {
+            shadowed_lights[shadowed_count] = ext_data->lights[i].light;
+            shadows[shadowed_count] = ext_data->lights[i].shadow;
+            shadowed_count++;
+        }
+    }
+    light_system_point_shadows_set(shadowed_count, shadowed_lights, shadows);
+}
+
+// Hands the captured frame to the passes, in place of culling the scene. Whatever wasn't captured isn't drawn.
+static void replay_frame_prepare(testbed_game_state* state, frame_data* p_frame_data) {
+    render_capture* capture = &state->replay;
+    rendergraph_resolution_scale_set(&state->frame_graph, capture->resolution_scale);
+
+    rendergraph_pass* world_passes[] = {&state->skybox_pass, &state->depth_prepass, &state->scene_pass, &state->editor_pass};
+    for (u32 i = 0; i < sizeof(world_passes) / sizeof(rendergraph_pass*); ++i) {
+        world_passes[i]->pass_data.do_execute = true;
+        world_passes[i]->pass_data.vp = &state->world_viewport;
+        world_passes[i]->pass_data.view_matrix = capture->view;
+        world_passes[i]->pass_data.view_position = capture->view_position;
+        world_passes[i]->pass_data.projection_matrix = capture->projection;
+    }
+    skybox_pass_extended_data* skybox_pass_ext_data = state->skybox_pass.pass_data.ext_data;
+    skybox_pass_ext_data->sb = state->main_scene.sb;
+
+    // Shadows. Cascades which were already rendered with the same views are kept, just as they would be for a still frame.
+    shadow_map_pass_extended_data* sp_ext_data = state->shadowmap_pass.pass_data.ext_data;
+    state->shadowmap_pass.pass_data.do_execute = capture->has_light && state->main_scene.dir_light;
+    p_frame_data->drawn_shadow_mesh_count = 0;
+    if (state->shadowmap_pass.pass_data.do_execute) {
+        sp_ext_data->light = state->main_scene.dir_light;
+        sp_ext_data->models = state->main_scene.cull_bounds.models;
+        for (u32 c = 0; c < MAX_SHADOW_CASCADE_COUNT; c++) {
+            shadow_map_cascade_data* cascade = &sp_ext_data->cascades[c];
+            cascade->cascade_index = c;
+            cascade->view = capture->cascade_views[c];
+            cascade->projection = capture->cascade_projections[c];
+            cascade->split_depth = capture->cascade_splits[c];
+            cascade->geometry_count = capture->record_counts[RENDER_CAPTURE_LIST_SHADOW];
+            cascade->geometries = capture->records[RENDER_CAPTURE_LIST_SHADOW];
+            cascade->terrain_geometry_count = 0;
+            cascade->terrain_geometries = 0;
+        }
+        shadow_map_pass_cascades_prepare(&state->shadowmap_pass, p_frame_data);
+        p_frame_data->drawn_shadow_mesh_count = capture->record_counts[RENDER_CAPTURE_LIST_SHADOW];
+    }
+
+    // Scene pass.
+    scene_pass_extended_data* ext_data = state->scene_pass.pass_data.ext_data;
+    for (u32 c = 0; c < MAX_SHADOW_CASCADE_COUNT; c++) {
+        if (state->shadowmap_pass.pass_data.do_execute) {
+            ext_data->directional_light_views[c] = sp_ext_data->cascades[c].view;
+            ext_data->directional_light_projections[c] = sp_ext_data->cascades[c].projection;
+        } else {
+            ext_data->directional_light_views[c] = capture->cascade_views[c];
+            ext_data->directional_light_projections[c] = capture->cascade_projections[c];
+        }
+        ext_data->cascade_splits.elements[c] = capture->cascade_splits[c];
+    }
+    ext_data->render_mode = capture->render_mode;
+    scene_pass_lighting_set(state, ext_data);
+    ext_data->geometry_count = capture->record_counts[RENDER_CAPTURE_LIST_SCENE];
+    ext_data->geometries = capture->records[RENDER_CAPTURE_LIST_SCENE];
+    ext_data->opaque_geometry_count = capture->opaque_count;
+    ext_data->object_buffer = state->main_scene.object_capacity ? &state->main_scene.object_buffer : 0;
+    ext_data->terrain_geometry_count = 0;
+    ext_data->terrain_geometries = 0;
+    ext_data->terrain_patch_batch_count = 0;
+    ext_data->terrain_patch_batches = 0;
+    ext_data->terrain_patch_instance_count = 0;
+    ext_data->terrain_patch_instances = 0;
+    ext_data->occlusion_query_count = 0;
+    ext_data->occlusion_query_boxes = 0;
+    kzero_memory(&ext_data->debug_packet, sizeof(debug_draw_packet));
+    p_frame_data->drawn_mesh_count = ext_data->geometry_count;
+
+    depth_prepass_extended_data* prepass_ext_data = state->depth_prepass.pass_data.ext_data;
+    prepass_ext_data->enabled = capture->depth_prepass_enabled;
+    prepass_ext_data->geometry_count = ext_data->opaque_geometry_count;
+    prepass_ext_data->geometries = ext_data->geometries;
+    prepass_ext_data->object_buffer = ext_data->object_buffer;
+    ext_data->depth_prepass_done = prepass_ext_data->enabled && prepass_ext_data->object_buffer;
+
+    state->oit_composite_pass.pass_data.do_execute = scene_pass_weighted_blended(&state->scene_pass);
+    state->oit_composite_pass.pass_data.vp = &state->world_viewport;
+
+    state->skinned_pass.pass_data.do_execute = false;
+    state->impostor_pass.pass_data.do_execute = false;
+    state->particle_pass.pass_data.do_execute = false;
+    state->particle_simulate_pass.pass_data.do_execute = false;
+
+    // Point light shadows aren't captured.
+    state->point_shadow_pass.pass_data.do_execute = false;
+    light_system_point_shadows_set(0, 0, 0);
+
+    // The editor pass ends the scaled passes, so still runs, drawing nothing.
+    editor_pass_extended_data* editor_ext_data = state->editor_pass.pass_data.ext_data;
+    editor_ext_data->debug_geometry_count = 0;
+    editor_ext_data->debug_geometries = 0;
+
+    overlay_passes_prepare(state, p_frame_data);
+}
+
 b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_frame_data) {
     testbed_game_state* state = (testbed_game_state*)app_inst->state;
     if (!state->running) {
@@ -872,6 +1249,18 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
 
     kclock_start(&state->prepare_clock);
 
+    // A replayed frame is handed to the passes just as it was captured.
+    if (replay_ready(state)) {
+        replay_frame_prepare(state, p_frame_data);
+        kclock_update(&state->prepare_clock);
+        return true;
+    }
+
+    // Pick the resolution the scene renders at from how long the GPU took over the last frame.
+    dynamic_resolution_enabled_set(&state->resolution_controller, kvar_int_value(state->dynamic_resolution_kvar, 1) != 0);
+    f32 resolution_scale = dynamic_resolution_update(&state->resolution_controller, metrics_gpu_frame_time());
+    rendergraph_resolution_scale_set(&state->frame_graph, resolution_scale);
+
     // Skybox pass. This pass must always run, as it is what clears the screen.
     skybox_pass_extended_data* skybox_pass_ext_data = state->skybox_pass.pass_data.ext_data;
     state->skybox_pass.pass_data.vp = &state->world_viewport;
@@ -884,10 +1273,20 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
 
     // Tell our scene to generate relevant packet data. NOTE: Generates skybox and world packets.
     if (state->main_scene.state == SIMPLE_SCENE_STATE_LOADED) {
+        // Render lists are built from the frame allocator alone, so any heap allocation here is reported.
+        KMEMORY_NO_ALLOC_BEGIN("render list building");
         {
             skybox_pass_ext_data->sb = state->main_scene.sb;
         }
 
+        // Rebuild the scene's culling data once, to be shared by the shadow and scene queries below.
+        if (!simple_scene_culling_update(&state->main_scene, p_frame_data)) {
+            KERROR("Failed to update scene culling data.");
+        }
+
+        // Mesh levels of detail are chosen from the world camera, for the shadow cascades as well as the scene pass.
+        simple_scene_lod_view_set(&state->main_scene, camera_position_get(state->world_camera), state->world_viewport.fov, state->world_viewport.rect.height);
+
         camera* view_camera = state->world_camera;
         viewport* view_viewport = &state->world_viewport;
 
@@ -912,6 +1311,26 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
             splits.elements[c] = (d - near) / clip_range;
         }
 
+        // The camera frustum, used to cull the scene pass meshes.
+        vec3 camera_forward_dir = camera_forward(view_camera);
+        vec3 camera_right_dir = camera_right(view_camera);
+        vec3 camera_up_dir = camera_up(view_camera);
+        frustum camera_frustum = frustum_create(&view_camera->position, &camera_forward_dir, &camera_right_dir,
+                                                &camera_up_dir, view_viewport->rect.width / view_viewport->rect.height, view_viewport->fov, view_viewport->near_clip, view_viewport->far_clip);
+
+        // The scene's meshes are culled against the camera and the light's view together, in a single
+        // pass over the scene. The light's view is added below once its volume is known.
+        simple_scene_cull_view cull_views[2] = {0};
+        cull_views[0].type = SIMPLE_SCENE_CULL_VIEW_TYPE_FRUSTUM;
+        cull_views[0].f = &camera_frustum;
+        cull_views[0].center = view_camera->position;
+        cull_views[0].streams_textures = true;
+        cull_views[0].culls_clusters = true;
+        cull_views[0].draws_impostors = true;
+        cull_views[0].weighted_blended = scene_pass_weighted_blended(&state->scene_pass);
+        u32 cull_view_count = 1;
+        simple_scene_visibility visibility = {0};
+
         // Default values to use in the event there is no directional light.
         // These are required because the scene pass needs them.
         mat4 shadow_camera_lookats[MAX_SHADOW_CASCADE_COUNT];
@@ -924,6 +1343,7 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
         }
 
         // Shadowmap pass - only runs if there is a directional light.
+        p_frame_data->drawn_shadow_mesh_count = 0;
         if (state->main_scene.dir_light) {
             f32 last_split_dist = 0.0f;
             rendergraph_pass* pass = &state->shadowmap_pass;
@@ -971,9 +1391,6 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
                     center = vec3_add(center, vec3_from_vec4(corners[i]));
                 }
                 center = vec3_div_scalar(center, 8.0f);  // size
-                if (c == MAX_CASCADE_COUNT - 1) {
-                    culling_center = center;
-                }
 
                 // Get the furthest-out point from the center and use that as the extents.
                 f32 radius = 0.0f;
@@ -981,7 +1398,21 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
                     f32 distance = vec3_distance(vec3_from_vec4(corners[i]), center);
                     radius = KMAX(radius, distance);
                 }
+
+                // Round the radius up and snap the center to whole texels in light space, so the cascade
+                // only ever moves by whole texels as the camera does. This keeps shadow edges from shimmering,
+                // and lets the shadow map pass keep cascades which haven't moved.
+                radius = kceil(radius * 16.0f) / 16.0f;
+                f32 texel_size = (radius * 2.0f) / SHADOW_MAP_RESOLUTION;
+                mat4 light_rotation = mat4_look_at(vec3_zero(), light_dir, vec3_up());
+                vec4 light_space_center = vec4_mul_mat4(vec4_from_vec3(center, 1.0f), light_rotation);
+                light_space_center.x = kfloor(light_space_center.x / texel_size) * texel_size;
+                light_space_center.y = kfloor(light_space_center.y / texel_size) * texel_size;
+                light_space_center.z = kfloor(light_space_center.z / texel_size) * texel_size;
+                center = vec3_from_vec4(vec4_mul_mat4(light_space_center, mat4_transposed(light_rotation)));
+
                 if (c == MAX_CASCADE_COUNT - 1) {
+                    culling_center = center;
                     culling_radius = radius;
                 }
 
@@ -1025,6 +1456,28 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
                 last_split_dist = split_dist;
             }
 
+            // Every cascade draws the meshes near the line through the outermost cascade along the light.
+            cull_views[1].type = SIMPLE_SCENE_CULL_VIEW_TYPE_LINE;
+            cull_views[1].direction = light_dir;
+            cull_views[1].center = culling_center;
+            cull_views[1].radius = culling_radius;
+            cull_views[1].lod_bias = SHADOW_LOD_BIAS;
+            cull_view_count = 2;
+            if (!simple_scene_visibility_query(&state->main_scene, cull_view_count, cull_views, p_frame_data, &visibility)) {
+                KERROR("Failed to cull scene meshes.");
+            }
+
+            // The cascades share a single list of static meshes. Their draw records index the scene's models.
+            ext_data->models = state->main_scene.cull_bounds.models;
+            u32 shadow_geometry_count = 0;
+            geometry_draw_record* shadow_geometries = darray_reserve_with_allocator(geometry_draw_record, 512, &p_frame_data->allocator);
+            if (visibility.view_count && !simple_scene_visibility_render_data_get(&state->main_scene, &visibility, 1, p_frame_data, &shadow_geometry_count, shadow_geometries)) {
+                KERROR("Failed to query shadow map pass meshes.");
+            }
+
+            // Track the number of meshes drawn in the shadow pass.
+            p_frame_data->drawn_shadow_mesh_count = shadow_geometry_count;
+
             // Gather the geometries to be rendered.
             for (u32 c = 0; c < MAX_SHADOW_CASCADE_COUNT; c++) {
                 shadow_map_cascade_data* cascade = &ext_data->cascades[c];
@@ -1032,39 +1485,22 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
                 // Shadow frustum culling and count
                 mat4 shadow_view = mat4_mul(shadow_camera_lookats[c], shadow_camera_projections[c]);
                 frustum shadow_frustum = frustum_from_view_projection(shadow_view);
-                /* if (c == MAX_CASCADE_COUNT - 1) {
-                    culling_frustum = shadow_frustum;
-                } */
 
                 simple_scene* scene = &state->main_scene;
 
-                // Iterate the scene and get a list of all geometries within the view of the light.
-                cascade->geometries = darray_reserve_with_allocator(geometry_render_data, 512, &p_frame_data->allocator);
-
-                // Query the scene for static meshes using the shadow frustum.
-                /* b8 shadow_clipping_enabled = false; */
-
-                if (!simple_scene_mesh_render_data_query_from_line(
-                        scene,
-                        light_dir,
-                        culling_center,
-                        culling_radius,
-                        p_frame_data,
-                        &cascade->geometry_count, cascade->geometries)) {
-                    KERROR("Failed to query shadow map pass meshes.");
-                }
-
-                // Track the number of meshes drawn in the shadow pass.
-                p_frame_data->drawn_shadow_mesh_count = cascade->geometry_count;
+                cascade->geometry_count = shadow_geometry_count;
+                cascade->geometries = shadow_geometries;
 
                 // Add terrain(s)
-                cascade->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, 16, &p_frame_data->allocator);
+                cascade->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, KMAX(16, simple_scene_terrain_chunk_count_get(scene)), &p_frame_data->allocator);
 
-                // Query the scene for terrain meshes using the camera frustum.
+                // Query the scene for terrain meshes using the camera frustum. Levels of detail are chosen
+                // from the view camera, so that the terrain casting shadows matches that receiving them.
                 if (!simple_scene_terrain_render_data_query(
                         scene,
                         &shadow_frustum,
-                        shadow_camera_positions[c],
+                        view_camera->position,
+                        false,
                         p_frame_data,
                         &cascade->terrain_geometry_count, cascade->terrain_geometries)) {
                     KERROR("Failed to query shadow map pass terrain geometries.");
@@ -1075,6 +1511,26 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
 
                 // end shadowmap pass
             }  // end cascade
+
+            // Only cascades whose contents changed are rendered again. The rest keep the view and
+            // projection they were rendered with, which the scene pass samples them with below.
+            shadow_map_pass_cascades_prepare(pass, p_frame_data);
+        }
+
+        // Without a light, only the camera's view is culled.
+        if (!visibility.view_count && !simple_scene_visibility_query(&state->main_scene, cull_view_count, cull_views, p_frame_data, &visibility)) {
+            KERROR("Failed to cull scene meshes.");
+        }
+
+        // Point light shadows, culled apart from the camera and directional light views.
+        point_shadows_prepare(state, p_frame_data);
+
+        // Remove what's hidden behind the largest objects in the camera's view.
+        if (visibility.view_count && kvar_int_value(state->occlusion_culling_kvar, 0)) {
+            mat4 camera_view_projection = mat4_mul(camera_view_get(view_camera), view_viewport->projection);
+            if (!simple_scene_visibility_occlusion_cull(&state->main_scene, &visibility, 0, camera_view_projection, &state->occlusion_buffer, 0)) {
+                KERROR("Failed to occlusion cull scene meshes.");
+            }
         }
 
         // Scene pass.
@@ -1093,52 +1549,77 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
             scene_pass_extended_data* ext_data = state->scene_pass.pass_data.ext_data;
             // Pass over shadow map "camera" view and projection matrices (one per cascade).
             for (u32 c = 0; c < MAX_SHADOW_CASCADE_COUNT; c++) {
-                ext_data->directional_light_views[c] = shadow_camera_lookats[c];
-                ext_data->directional_light_projections[c] = shadow_camera_projections[c];
-
                 shadow_map_pass_extended_data* sp_ext_data = state->shadowmap_pass.pass_data.ext_data;
+                if (state->main_scene.dir_light) {
+                    ext_data->directional_light_views[c] = sp_ext_data->cascades[c].view;
+                    ext_data->directional_light_projections[c] = sp_ext_data->cascades[c].projection;
+                } else {
+                    ext_data->directional_light_views[c] = shadow_camera_lookats[c];
+                    ext_data->directional_light_projections[c] = shadow_camera_projections[c];
+                }
+
                 ext_data->cascade_splits.elements[c] = sp_ext_data->cascades[c].split_depth;
             }
             ext_data->render_mode = state->render_mode;
-            // HACK: use the skybox cubemap as the irradiance texture for now.
-            ext_data->irradiance_cube_texture = state->main_scene.sb->cubemap.texture;
+            scene_pass_lighting_set(state, ext_data);
 
             // Populate scene pass data.
             simple_scene* scene = &state->main_scene;
 
-            // Camera frustum culling and count
-            viewport* v = &state->world_viewport;
-            vec3 forward = camera_forward(current_camera);
-            vec3 right = camera_right(current_camera);
-            vec3 up = camera_up(current_camera);
-            frustum camera_frustum = frustum_create(&current_camera->position, &forward, &right,
-                                                    &up, v->rect.width / v->rect.height, v->fov, v->near_clip, v->far_clip);
-
             p_frame_data->drawn_mesh_count = 0;
 
-            ext_data->geometries = darray_reserve_with_allocator(geometry_render_data, 512, &p_frame_data->allocator);
+            ext_data->geometries = darray_reserve_with_allocator(geometry_draw_record, 512, &p_frame_data->allocator);
 
-            // Query the scene for static meshes using the camera frustum.
-            if (!simple_scene_mesh_render_data_query(
-                    scene,
-                    &camera_frustum,
-                    current_camera->position,
-                    p_frame_data,
-                    &ext_data->geometry_count, ext_data->geometries)) {
+            // Skip what earlier frames' occlusion queries found hidden, and query it all again this frame.
+            b8 skip_hidden = false;
+            ext_data->occlusion_query_count = 0;
+            ext_data->occlusion_query_boxes = 0;
+            if (visibility.view_count && kvar_int_value(state->occlusion_queries_kvar, 0) && renderer_occlusion_queries_supported()) {
+                ext_data->occlusion_query_boxes = p_frame_data->allocator.allocate(sizeof(extents_3d) * RENDERER_MAX_OCCLUSION_QUERIES);
+                skip_hidden = simple_scene_visibility_occlusion_query(scene, &visibility, 0, state->world_viewport.near_clip, p_frame_data, &ext_data->occlusion_query_count, ext_data->occlusion_query_boxes, 0);
+            }
+
+            // Gather the static meshes found within the camera frustum.
+            ext_data->geometry_count = 0;
+            if (visibility.view_count && !simple_scene_visibility_render_data_get(scene, &visibility, 0, p_frame_data, &ext_data->geometry_count, ext_data->geometries)) {
                 KERROR("Failed to query scene pass meshes.");
             }
 
+            // Opaque geometries are sorted first, followed by the transparent ones.
+            ext_data->opaque_geometry_count = 0;
+            while (ext_data->opaque_geometry_count < ext_data->geometry_count &&
+                   render_sort_key_layer_get(ext_data->geometries[ext_data->opaque_geometry_count].sort_key) == RENDER_SORT_LAYER_OPAQUE) {
+                ext_data->opaque_geometry_count++;
+            }
+
             // Track the number of meshes drawn in the shadow pass.
             p_frame_data->drawn_mesh_count = ext_data->geometry_count;
+            ext_data->object_buffer = scene->object_capacity ? &scene->object_buffer : 0;
+
+            // The depth prepass draws the same opaque static geometries, with the same camera. It always
+            // runs since it clears the depth buffer, but only draws when enabled.
+            i32 depth_prepass_enabled = kvar_int_value(state->depth_prepass_kvar, 1);
+            depth_prepass_extended_data* prepass_ext_data = state->depth_prepass.pass_data.ext_data;
+            state->depth_prepass.pass_data.do_execute = true;
+            state->depth_prepass.pass_data.vp = &state->world_viewport;
+            state->depth_prepass.pass_data.view_matrix = camera_view;
+            state->depth_prepass.pass_data.view_position = state->scene_pass.pass_data.view_position;
+            state->depth_prepass.pass_data.projection_matrix = camera_projection;
+            prepass_ext_data->enabled = depth_prepass_enabled != 0;
+            prepass_ext_data->geometry_count = ext_data->opaque_geometry_count;
+            prepass_ext_data->geometries = ext_data->geometries;
+            prepass_ext_data->object_buffer = ext_data->object_buffer;
+            ext_data->depth_prepass_done = prepass_ext_data->enabled && prepass_ext_data->object_buffer;
 
             // Add terrain(s)
-            ext_data->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, 16, &p_frame_data->allocator);
+            ext_data->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, KMAX(16, simple_scene_terrain_chunk_count_get(scene)), &p_frame_data->allocator);
 
             // Query the scene for terrain meshes using the camera frustum.
             if (!simple_scene_terrain_render_data_query(
                     scene,
                     &camera_frustum,
                     current_camera->position,
+                    skip_hidden,
                     p_frame_data,
                     &ext_data->terrain_geometry_count, ext_data->terrain_geometries)) {
                 KERROR("Failed to query scene pass terrain geometries.");
@@ -1147,53 +1628,117 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
             // TODO: Counter for terrain geometries.
             p_frame_data->drawn_mesh_count += ext_data->terrain_geometry_count;
 
-            // Debug geometry
-            if (!simple_scene_debug_render_data_query(scene, &ext_data->debug_geometry_count, 0)) {
-                KERROR("Failed to obtain count of debug render objects.");
-                return false;
+            // Vertex-pulled terrains, as instances of their patches.
+            u32 terrain_chunk_count = KMAX(16, simple_scene_terrain_chunk_count_get(scene));
+            ext_data->terrain_patch_batches = darray_reserve_with_allocator(terrain_patch_batch, terrain_chunk_count, &p_frame_data->allocator);
+            ext_data->terrain_patch_instances = darray_reserve_with_allocator(terrain_patch_instance, terrain_chunk_count, &p_frame_data->allocator);
+            if (!simple_scene_terrain_patch_query(
+                    scene,
+                    &camera_frustum,
+                    current_camera->position,
+                    skip_hidden,
+                    p_frame_data,
+                    &ext_data->terrain_patch_batch_count, ext_data->terrain_patch_batches,
+                    &ext_data->terrain_patch_instance_count, ext_data->terrain_patch_instances)) {
+                KERROR("Failed to query scene pass terrain patches.");
             }
-            ext_data->debug_geometries = darray_reserve_with_allocator(geometry_render_data, ext_data->debug_geometry_count, &p_frame_data->allocator);
+            p_frame_data->drawn_mesh_count += ext_data->terrain_patch_batch_count;
 
-            if (!simple_scene_debug_render_data_query(scene, &ext_data->debug_geometry_count, &ext_data->debug_geometries)) {
-                KERROR("Failed to obtain debug render objects.");
-                return false;
-            }
-            // Make sure the count is correct before pushing.
-            darray_length_set(ext_data->debug_geometries, ext_data->debug_geometry_count);
+            // Debug shapes, drawn in a single batch.
+            debug_draw_batch_clear(&state->debug_batch);
+            simple_scene_debug_draw(scene, &state->debug_batch);
 
-            // HACK: Inject raycast debug geometries into scene pass data.
+            // HACK: Inject raycast debug shapes into the batch.
             if (state->main_scene.state == SIMPLE_SCENE_STATE_LOADED) {
                 u32 line_count = darray_length(state->test_lines);
                 for (u32 i = 0; i < line_count; ++i) {
-                    geometry_render_data rd = {0};
-                    rd.model = transform_world_get(&state->test_lines[i].xform);
-                    geometry* g = &state->test_lines[i].geo;
-                    rd.material = g->material;
-                    rd.vertex_count = g->vertex_count;
-                    rd.vertex_buffer_offset = g->vertex_buffer_offset;
-                    rd.index_count = g->index_count;
-                    rd.index_buffer_offset = g->index_buffer_offset;
-                    rd.unique_id = INVALID_ID_U16;
-                    darray_push(ext_data->debug_geometries, rd);
-                    ext_data->debug_geometry_count++;
+                    debug_line3d* line = &state->test_lines[i];
+                    debug_draw_vertices(&state->debug_batch, line->vertex_count, line->vertices, transform_world_get(&line->xform));
                 }
                 u32 box_count = darray_length(state->test_boxes);
                 for (u32 i = 0; i < box_count; ++i) {
-                    geometry_render_data rd = {0};
-                    rd.model = transform_world_get(&state->test_boxes[i].xform);
-                    geometry* g = &state->test_boxes[i].geo;
-                    rd.material = g->material;
-                    rd.vertex_count = g->vertex_count;
-                    rd.vertex_buffer_offset = g->vertex_buffer_offset;
-                    rd.index_count = g->index_count;
-                    rd.index_buffer_offset = g->index_buffer_offset;
-                    rd.unique_id = INVALID_ID_U16;
-                    darray_push(ext_data->debug_geometries, rd);
-                    ext_data->debug_geometry_count++;
+                    debug_box3d* box = &state->test_boxes[i];
+                    debug_draw_vertices(&state->debug_batch, box->vertex_count, box->vertices, transform_world_get(&box->xform));
                 }
             }
+            if (!debug_draw_batch_flush(&state->debug_batch, p_frame_data, &ext_data->debug_packet)) {
+                KERROR("Failed to flush debug shapes.");
+            }
+
+            // Resolves the weighted blended transparency of the scene over it, if it has any.
+            state->oit_composite_pass.pass_data.do_execute = scene_pass_weighted_blended(&state->scene_pass);
+            state->oit_composite_pass.pass_data.vp = &state->world_viewport;
         }  // scene loaded.
 
+        // Skinned pass
+        {
+            // Enable this pass for this frame.
+            state->skinned_pass.pass_data.do_execute = true;
+            state->skinned_pass.pass_data.vp = &state->world_viewport;
+            state->skinned_pass.pass_data.view_matrix = camera_view_get(current_camera);
+            state->skinned_pass.pass_data.view_position = camera_position_get(current_camera);
+            state->skinned_pass.pass_data.projection_matrix = state->world_viewport.projection;
+
+            skinned_pass_extended_data* ext_data = state->skinned_pass.pass_data.ext_data;
+            ext_data->skinned_mesh_count = darray_length(state->main_scene.skinned_meshes);
+            ext_data->skinned_meshes = state->main_scene.skinned_meshes;
+            ext_data->animators = state->main_scene.animators;
+            ext_data->palette_count = state->main_scene.skinning_palette_count;
+            ext_data->palette = state->main_scene.skinning_palette;
+            if (state->main_scene.dir_light) {
+                ext_data->light_direction = state->main_scene.dir_light->data.direction;
+                ext_data->light_colour = state->main_scene.dir_light->data.colour;
+            } else {
+                ext_data->light_direction = (vec4){0.0f, -1.0f, 0.0f, 0.0f};
+                ext_data->light_colour = vec4_one();
+            }
+        }
+
+        // Impostor pass
+        {
+            // Enable this pass for this frame.
+            state->impostor_pass.pass_data.do_execute = true;
+            state->impostor_pass.pass_data.vp = &state->world_viewport;
+            state->impostor_pass.pass_data.view_matrix = camera_view_get(current_camera);
+            state->impostor_pass.pass_data.view_position = camera_position_get(current_camera);
+            state->impostor_pass.pass_data.projection_matrix = state->world_viewport.projection;
+
+            impostor_pass_extended_data* ext_data = state->impostor_pass.pass_data.ext_data;
+            ext_data->instance_count = 0;
+            ext_data->batch_count = 0;
+            // The meshes culled from the camera's view for lying beyond their impostor distance.
+            if (visibility.view_count && !simple_scene_visibility_impostors_get(&state->main_scene, &visibility, 0, p_frame_data, &ext_data->instance_count, &ext_data->instances, &ext_data->batch_count, &ext_data->batches)) {
+                KERROR("Failed to obtain the impostors of the scene.");
+                ext_data->instance_count = 0;
+                ext_data->batch_count = 0;
+            }
+            if (state->main_scene.dir_light) {
+                ext_data->light_direction = state->main_scene.dir_light->data.direction;
+                ext_data->light_colour = state->main_scene.dir_light->data.colour;
+            } else {
+                ext_data->light_direction = (vec4){0.0f, -1.0f, 0.0f, 0.0f};
+                ext_data->light_colour = vec4_one();
+            }
+        }
+
+        // Particle pass
+        {
+            // Enable this pass for this frame.
+            state->particle_pass.pass_data.do_execute = true;
+            state->particle_pass.pass_data.vp = &state->world_viewport;
+            state->particle_pass.pass_data.view_matrix = camera_view_get(current_camera);
+            state->particle_pass.pass_data.view_position = camera_position_get(current_camera);
+            state->particle_pass.pass_data.projection_matrix = state->world_viewport.projection;
+
+            particle_pass_extended_data* ext_data = state->particle_pass.pass_data.ext_data;
+            ext_data->emitter_count = darray_length(state->main_scene.emitters);
+            ext_data->emitters = state->main_scene.emitters;
+            ext_data->gpu_simulation = kvar_int_value(state->particles_gpu_kvar, 1) != 0;
+
+            // Reads the particle pass' data, so only needs enabling.
+            state->particle_simulate_pass.pass_data.do_execute = true;
+        }
+
         // Editor pass
         {
             // Enable this pass for this frame.
@@ -1266,13 +1811,51 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
                 return false;
             }
         } */
+        KMEMORY_NO_ALLOC_END();
     } else {
         // Do not run these passes if the scene is not loaded.
         state->scene_pass.pass_data.do_execute = false;
+        state->oit_composite_pass.pass_data.do_execute = false;
+        state->depth_prepass.pass_data.do_execute = false;
         state->shadowmap_pass.pass_data.do_execute = false;
-        state->editor_pass.pass_data.do_execute = false;
+        state->point_shadow_pass.pass_data.do_execute = false;
+        state->skinned_pass.pass_data.do_execute = false;
+        state->impostor_pass.pass_data.do_execute = false;
+        state->particle_pass.pass_data.do_execute = false;
+        state->particle_simulate_pass.pass_data.do_execute = false;
+        light_system_point_shadows_set(0, 0, 0);
+
+        // The editor pass ends the scaled passes, leaving their colour ready to be upscaled, so it
+        // still runs, drawing nothing.
+        editor_pass_extended_data* ext_data = state->editor_pass.pass_data.ext_data;
+        ext_data->debug_geometry_count = 0;
+        ext_data->debug_geometries = 0;
+        state->editor_pass.pass_data.do_execute = true;
+        state->editor_pass.pass_data.vp = &state->world_viewport;
+        state->editor_pass.pass_data.view_matrix = camera_view_get(current_camera);
+        state->editor_pass.pass_data.view_position = camera_position_get(current_camera);
+        state->editor_pass.pass_data.projection_matrix = state->world_viewport.projection;
+    }
+
+    // Save what the passes were just given, if asked to.
+    if (state->frame_capture_pending) {
+        state->frame_capture_pending = false;
+        if (render_capture_save(RENDER_CAPTURE_DEFAULT_PATH, state->main_scene_name, &state->main_scene, &state->scene_pass, &state->depth_prepass, &state->shadowmap_pass, resolution_scale)) {
+            KINFO("Frame captured to '%s'.", RENDER_CAPTURE_DEFAULT_PATH);
+        }
     }
 
+    overlay_passes_prepare(state, p_frame_data);
+
+    kclock_update(&state->prepare_clock);
+    return true;
+}
+
+static void overlay_passes_prepare(testbed_game_state* state, frame_data* p_frame_data) {
+    // Upscale the scene to the window, ahead of the UI.
+    state->upscale_pass.pass_data.do_execute = true;
+    state->upscale_pass.pass_data.vp = &state->world_viewport;
+
     // UI
     {
         ui_pass_extended_data* ext_data = state->ui_pass.pass_data.ext_data;
@@ -1284,9 +1867,11 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
         // Renderables.
         ext_data->sui_render_data.renderables = darray_create_with_allocator(standard_ui_renderable, &p_frame_data->allocator);
         void* sui_state = systems_manager_get_state(K_SYSTEM_TYPE_STANDARD_UI_EXT);
+        KMEMORY_NO_ALLOC_BEGIN("standard ui render");
         if (!standard_ui_system_render(sui_state, 0, p_frame_data, &ext_data->sui_render_data)) {
             KERROR("The standard ui system failed to render.");
         }
+        KMEMORY_NO_ALLOC_END();
     }
 
     // Pick
@@ -1308,9 +1893,6 @@ b8 application_prepare_frame(struct application* app_inst, struct frame_data* p_
         }
     }*/
     // TODO: end temp
-
-    kclock_update(&state->prepare_clock);
-    return true;
 }
 
 b8 application_render_frame(struct application* game_inst, struct frame_data* p_frame_data) {
@@ -1325,6 +1907,11 @@ b8 application_render_frame(struct application* game_inst, struct frame_data* p_
         //
     }
 
+    // Image based lighting is generated by compute work, which is recorded outside of the rendergraph's passes.
+    if (state->main_scene.state == SIMPLE_SCENE_STATE_LOADED && state->ibl_skybox && state->ibl_skybox == state->main_scene.sb) {
+        ibl_environment_update(&state->ibl, p_frame_data);
+    }
+
     if (!rendergraph_execute_frame(&state->frame_graph, p_frame_data)) {
         KERROR("Failed to execute rendergraph frame.");
         return false;
@@ -1342,6 +1929,21 @@ b8 application_render_frame(struct application* game_inst, struct frame_data* p_
     }
     kclock_update(&state->present_clock);
 
+    if (state->benchmark.active && state->main_scene.state == SIMPLE_SCENE_STATE_LOADED && (!state->benchmark.replay_path[0] || state->replay.resolved)) {
+        f64 cpu_seconds = state->last_update_elapsed + state->prepare_clock.elapsed + state->render_clock.elapsed;
+        if (render_benchmark_frame_end(&state->benchmark, p_frame_data, cpu_seconds)) {
+            render_benchmark_report(&state->benchmark);
+            render_benchmark_destroy(&state->benchmark);
+            event_fire(EVENT_CODE_APPLICATION_QUIT, 0, (event_context){});
+        }
+    }
+
+    if (state->upload_benchmark.active && upload_benchmark_frame_end(&state->upload_benchmark)) {
+        upload_benchmark_report(&state->upload_benchmark);
+        upload_benchmark_destroy(&state->upload_benchmark);
+        event_fire(EVENT_CODE_APPLICATION_QUIT, 0, (event_context){});
+    }
+
     return true;
 }
 
@@ -1391,6 +1993,8 @@ void application_shutdown(struct application* game_inst) {
     if (state->main_scene.state == SIMPLE_SCENE_STATE_LOADED) {
         KDEBUG("Unloading scene...");
 
+        ibl_environment_destroy(&state->ibl);
+        state->ibl_skybox = 0;
         simple_scene_unload(&state->main_scene, true);
         clear_debug_objects(game_inst);
 
@@ -1404,22 +2008,42 @@ void application_shutdown(struct application* game_inst) {
 
     // Destroy rendergraph(s)
     rendergraph_destroy(&state->frame_graph);
+
+    debug_draw_batch_destroy(&state->debug_batch);
+    occlusion_buffer_destroy(&state->occlusion_buffer);
+
+    render_benchmark_destroy(&state->benchmark);
+    upload_benchmark_destroy(&state->upload_benchmark);
+    render_capture_destroy(&state->replay);
+
+    debug_console_destroy(&state->debug_console);
 }
 
 void application_lib_on_unload(struct application* game_inst) {
+    testbed_game_state* state = (testbed_game_state*)game_inst->state;
     application_unregister_events(game_inst);
-    debug_console_on_lib_unload(&((testbed_game_state*)game_inst->state)->debug_console);
+    debug_console_on_lib_unload(&state->debug_console);
     game_remove_commands(game_inst);
     game_remove_keymaps(game_inst);
+    simple_scene_on_lib_unload(&state->main_scene);
 }
 
 void application_lib_on_load(struct application* game_inst) {
+    testbed_game_state* state = (testbed_game_state*)game_inst->state;
     application_register_events(game_inst);
-    debug_console_on_lib_load(&((testbed_game_state*)game_inst->state)->debug_console, game_inst->stage >= APPLICATION_STAGE_BOOT_COMPLETE);
+    debug_console_on_lib_load(&state->debug_console, game_inst->stage >= APPLICATION_STAGE_BOOT_COMPLETE);
     if (game_inst->stage >= APPLICATION_STAGE_BOOT_COMPLETE) {
         game_setup_commands(game_inst);
         game_setup_keymaps(game_inst);
     }
+    if (game_inst->stage >= APPLICATION_STAGE_INITIALIZED) {
+        // Everything the state holds is kept across a reload. Only what points into this
+        // library's code is rebound to the newly loaded copy of it.
+        refresh_rendergraph_pfns(game_inst);
+        state->test_button.on_click = sui_test_button_on_click;
+        resource_system_loader_rebind(simple_scene_resource_loader_create());
+        simple_scene_on_lib_load(&state->main_scene);
+    }
 }
 
 static void toggle_vsync(void) {
@@ -1431,6 +2055,10 @@ static void toggle_vsync(void) {
 static b8 game_on_kvar_changed(u16 code, void* sender, void* listener_inst, event_context data) {
     if (code == EVENT_CODE_KVAR_CHANGED && strings_equali(data.data.c, "vsync")) {
         toggle_vsync();
+    } else if (code == EVENT_CODE_KVAR_CHANGED && strings_equali(data.data.c, "variable_rate_shading")) {
+        i32 enabled = 1;
+        kvar_int_get("variable_rate_shading", &enabled);
+        renderer_flag_enabled_set(RENDERER_CONFIG_FLAG_VARIABLE_RATE_SHADING_BIT, enabled != 0);
     }
     return false;
 }
@@ -1499,15 +2127,48 @@ static void refresh_rendergraph_pfns(application* app) {
     state->shadowmap_pass.load_resources = shadow_map_pass_load_resources;
     /* state->shadowmap_pass.source_populate = shadow_map_pass_source_populate; */
 
+    state->point_shadow_pass.initialize = point_shadow_pass_initialize;
+    state->point_shadow_pass.execute = point_shadow_pass_execute;
+    state->point_shadow_pass.destroy = point_shadow_pass_destroy;
+    state->point_shadow_pass.load_resources = point_shadow_pass_load_resources;
+
+    state->depth_prepass.initialize = depth_prepass_initialize;
+    state->depth_prepass.execute = depth_prepass_execute;
+    state->depth_prepass.destroy = depth_prepass_destroy;
+
     state->scene_pass.initialize = scene_pass_initialize;
     state->scene_pass.execute = scene_pass_execute;
     state->scene_pass.destroy = scene_pass_destroy;
     state->scene_pass.load_resources = scene_pass_load_resources;
 
+    state->oit_composite_pass.initialize = oit_composite_pass_initialize;
+    state->oit_composite_pass.execute = oit_composite_pass_execute;
+    state->oit_composite_pass.destroy = oit_composite_pass_destroy;
+
+    state->skinned_pass.initialize = skinned_pass_initialize;
+    state->skinned_pass.execute = skinned_pass_execute;
+    state->skinned_pass.destroy = skinned_pass_destroy;
+
+    state->impostor_pass.initialize = impostor_pass_initialize;
+    state->impostor_pass.execute = impostor_pass_execute;
+    state->impostor_pass.destroy = impostor_pass_destroy;
+
+    state->particle_simulate_pass.initialize = particle_simulate_pass_initialize;
+    state->particle_simulate_pass.execute = particle_simulate_pass_execute;
+    state->particle_simulate_pass.destroy = particle_simulate_pass_destroy;
+
+    state->particle_pass.initialize = particle_pass_initialize;
+    state->particle_pass.execute = particle_pass_execute;
+    state->particle_pass.destroy = particle_pass_destroy;
+
     state->editor_pass.initialize = editor_pass_initialize;
     state->editor_pass.execute = editor_pass_execute;
     state->editor_pass.destroy = editor_pass_destroy;
 
+    state->upscale_pass.initialize = upscale_pass_initialize;
+    state->upscale_pass.execute = upscale_pass_execute;
+    state->upscale_pass.destroy = upscale_pass_destroy;
+
     state->ui_pass.initialize = ui_pass_initialize;
     state->ui_pass.execute = ui_pass_execute;
     state->ui_pass.destroy = ui_pass_destroy;
@@ -1540,20 +2201,86 @@ static b8 configure_rendergraph(application* app) {
     // Shadowmap pass
     const char* shadowmap_pass_name = "shadowmap_pass";
     shadow_map_pass_config shadow_pass_config = {0};
-    shadow_pass_config.resolution = 2048;
+    shadow_pass_config.resolution = SHADOW_MAP_RESOLUTION;
     RG_CHECK(rendergraph_pass_create(&state->frame_graph, shadowmap_pass_name, shadow_map_pass_create, &shadow_pass_config, &state->shadowmap_pass));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, shadowmap_pass_name, "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_SELF));
 
+    // Point light shadow pass. Keeps the faces of each shadowed light in an atlas between frames.
+    point_shadow_pass_config point_shadow_config = {0};
+    point_shadow_config.resolution = POINT_SHADOW_RESOLUTION;
+    point_shadow_config.slot_count = POINT_SHADOW_SLOT_COUNT;
+    point_shadow_config.update_budget = POINT_SHADOW_UPDATE_BUDGET;
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "point_shadow_pass", point_shadow_pass_create, &point_shadow_config, &state->point_shadow_pass));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "point_shadow_pass", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_SELF));
+
+    // Depth prepass. Its depth is also exposed as a source for anything else which needs scene depth
+    // before shading.
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "depth_prepass", depth_prepass_create, 0, &state->depth_prepass));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "depth_prepass", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "depth_prepass", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_GLOBAL));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "depth_prepass", "depthbuffer", 0, "depthbuffer"));
+
     // Scene pass
-    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "scene", scene_pass_create, 0, &state->scene_pass));
+    scene_pass_config scene_config = {0};
+    scene_config.depth_prepass = true;
+    // Falls back to sorted alpha blending if the renderer doesn't support it.
+    scene_config.weighted_blended_transparency = true;
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "scene", scene_pass_create, &scene_config, &state->scene_pass));
     RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "scene", "colourbuffer"));
     RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "scene", "depthbuffer"));
     RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "scene", "shadowmap"));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "scene", "point_shadowmap"));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "scene", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "scene", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_GLOBAL));
     RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "scene", "colourbuffer", "skybox", "colourbuffer"));
-    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "scene", "depthbuffer", 0, "depthbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "scene", "depthbuffer", "depth_prepass", "depthbuffer"));
     RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "scene", "shadowmap", "shadowmap_pass", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "scene", "point_shadowmap", "point_shadow_pass", "depthbuffer"));
+
+    // OIT composite pass. Resolves the scene's weighted blended transparency over its colour.
+    oit_composite_pass_config oit_composite_config = {0};
+    oit_composite_config.scene_pass = &state->scene_pass;
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "oit_composite", oit_composite_pass_create, &oit_composite_config, &state->oit_composite_pass));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "oit_composite", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "oit_composite", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "oit_composite", "colourbuffer", "scene", "colourbuffer"));
+
+    // Skinned pass. Drawn into the scene, tested against and writing its depth.
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "skinned", skinned_pass_create, 0, &state->skinned_pass));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "skinned", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "skinned", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "skinned", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "skinned", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "skinned", "colourbuffer", "oit_composite", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "skinned", "depthbuffer", "scene", "depthbuffer"));
+
+    // Impostor pass. Drawn into the scene, tested against and writing its depth.
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "impostors", impostor_pass_create, 0, &state->impostor_pass));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "impostors", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "impostors", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "impostors", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "impostors", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "impostors", "colourbuffer", "skinned", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "impostors", "depthbuffer", "skinned", "depthbuffer"));
+
+    // Particle pass. Drawn over the scene and tested against its depth, without writing it.
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "particles", particle_pass_create, 0, &state->particle_pass));
+
+    // Particle simulation pass. Simulates the particle pass' particles on the async compute queue,
+    // overlapping the passes before it.
+    particle_simulate_pass_config particle_simulate_config = {0};
+    particle_simulate_config.particle_pass = &state->particle_pass;
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "particle_simulate", particle_simulate_pass_create, &particle_simulate_config, &state->particle_simulate_pass));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "particle_simulate", "particles", RENDERGRAPH_SOURCE_TYPE_BUFFER, RENDERGRAPH_SOURCE_ORIGIN_SELF));
+
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "particles", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "particles", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "particles", "particle_buffer"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "particles", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "particles", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "particles", "colourbuffer", "impostors", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "particles", "depthbuffer", "impostors", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "particles", "particle_buffer", "particle_simulate", "particles"));
 
     // Editor pass
     RG_CHECK(rendergraph_pass_create(&state->frame_graph, "editor", editor_pass_create, 0, &state->editor_pass));
@@ -1561,8 +2288,26 @@ static b8 configure_rendergraph(application* app) {
     RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "editor", "depthbuffer"));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "editor", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "editor", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
-    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "editor", "colourbuffer", "scene", "colourbuffer"));
-    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "editor", "depthbuffer", "scene", "depthbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "editor", "colourbuffer", "particles", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "editor", "depthbuffer", "particles", "depthbuffer"));
+
+    // Upscale pass. Samples the scene, rendered at the graph's resolution scale, into the window.
+    upscale_pass_config upscale_config = {0};
+    upscale_config.graph = &state->frame_graph;
+    RG_CHECK(rendergraph_pass_create(&state->frame_graph, "upscale", upscale_pass_create, &upscale_config, &state->upscale_pass));
+    RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "upscale", "scene_colour"));
+    RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "upscale", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "upscale", "scene_colour", "editor", "colourbuffer"));
+
+    // The passes drawing the scene render at the graph's resolution scale.
+    state->skybox_pass.resolution_scaled = true;
+    state->depth_prepass.resolution_scaled = true;
+    state->scene_pass.resolution_scaled = true;
+    state->oit_composite_pass.resolution_scaled = true;
+    state->skinned_pass.resolution_scaled = true;
+    state->impostor_pass.resolution_scaled = true;
+    state->particle_pass.resolution_scaled = true;
+    state->editor_pass.resolution_scaled = true;
 
     // UI pass
     RG_CHECK(rendergraph_pass_create(&state->frame_graph, "ui", ui_pass_create, 0, &state->ui_pass));
@@ -1570,7 +2315,7 @@ static b8 configure_rendergraph(application* app) {
     RG_CHECK(rendergraph_pass_sink_add(&state->frame_graph, "ui", "depthbuffer"));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "ui", "colourbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_COLOUR, RENDERGRAPH_SOURCE_ORIGIN_OTHER));
     RG_CHECK(rendergraph_pass_source_add(&state->frame_graph, "ui", "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_GLOBAL));
-    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "ui", "colourbuffer", "editor", "colourbuffer"));
+    RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "ui", "colourbuffer", "upscale", "colourbuffer"));
     RG_CHECK(rendergraph_pass_set_sink_linkage(&state->frame_graph, "ui", "depthbuffer", 0, "depthbuffer"));
 
     refresh_rendergraph_pfns(app);
@@ -1771,7 +2516,7 @@ static b8 configure_rendergraph(application* app) {
         ui_view.passes = kallocate(sizeof(renderpass) * ui_view.renderpass_count, MEMORY_TAG_ARRAY);
 
         // Renderpass config
-        renderpass_config ui_pass;
+        renderpass_config ui_pass = {0};
         ui_pass.name = "Renderpass.Builtin.UI";
         ui_pass.clear_colour = (vec4){0.0f, 0.0f, 0.2f, 1.0f};
         ui_pass.clear_flags = RENDERPASS_CLEAR_NONE_FLAG;
@@ -1886,13 +2631,13 @@ static b8 configure_rendergraph(application* app) {
     return true;
 } */
 
-static b8 load_main_scene(struct application* game_inst) {
+static b8 load_main_scene(struct application* game_inst, const char* scene_name) {
     testbed_game_state* state = (testbed_game_state*)game_inst->state;
 
     // Load up config file
     // TODO: clean up resource.
     resource simple_scene_resource;
-    if (!resource_system_load("test_scene", RESOURCE_TYPE_SIMPLE_SCENE, 0, &simple_scene_resource)) {
+    if (!resource_system_load(scene_name, RESOURCE_TYPE_SIMPLE_SCENE, 0, &simple_scene_resource)) {
         KERROR("Failed to load scene file, check above logs.");
         return false;
     }
@@ -1904,6 +2649,7 @@ static b8 load_main_scene(struct application* game_inst) {
         KERROR("Failed to create main scene");
         return false;
     }
+    string_ncopy(state->main_scene_name, scene_name, sizeof(state->main_scene_name) - 1);
 
     // Add objects to scene
 
@@ -0,0 +1,348 @@
+#include "upload_benchmark.h"
+
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <renderer/renderer_frontend.h>
+#include <resources/resource_types.h>
+#include <systems/texture_system.h>
+#include <utils/ksort.h>
+
+// The size of each buffer load making up a burst, as a stream of small uploads would be.
+#define BURST_CHUNK_SIZE MEBIBYTES(1)
+// The size of the buffer bursts are loaded into, which is also the largest burst.
+#define BURST_BUFFER_SIZE MEBIBYTES(64)
+// The size of each vertex of the geometries uploaded.
+#define GEOMETRY_VERTEX_SIZE 16
+
+static const char* mode_names[UPLOAD_BENCHMARK_MODE_COUNT] = {"synchronous", "batched"};
+static const char* operation_names[UPLOAD_BENCHMARK_OPERATION_COUNT] = {"texture_write", "buffer_load", "geometry_upload", "texture_read"};
+
+// 64KiB, four times larger each, which keeps the textures square.
+static u64 size_get(u32 size_index) {
+    return KIBIBYTES(64) << (2 * size_index);
+}
+
+// Nothing, then 1MiB, four times larger each.
+static u64 burst_size_get(u32 burst_index) {
+    return burst_index ? MEBIBYTES(1) << (2 * (burst_index - 1)) : 0;
+}
+
+static b8 arg_value_get(const char* arg, const char* key, const char** out_value) {
+    u64 key_length = string_length(key);
+    if (string_length(arg) > key_length && strings_nequali(arg, key, key_length)) {
+        *out_value = arg + key_length;
+        return true;
+    }
+    return false;
+}
+
+b8 upload_benchmark_parse(i32 argc, char** argv, upload_benchmark* out_benchmark) {
+    kzero_memory(out_benchmark, sizeof(upload_benchmark));
+    out_benchmark->iterations = UPLOAD_BENCHMARK_DEFAULT_ITERATIONS;
+
+    // The first argument is the executable.
+    for (i32 i = 1; i < argc; ++i) {
+        const char* value = 0;
+        if (arg_value_get(argv[i], "upload_benchmark=", &value)) {
+            if (!string_to_u32(value, &out_benchmark->iterations) || out_benchmark->iterations == 0) {
+                KWARN("Invalid upload benchmark iteration count '%s', using %u.", value, UPLOAD_BENCHMARK_DEFAULT_ITERATIONS);
+                out_benchmark->iterations = UPLOAD_BENCHMARK_DEFAULT_ITERATIONS;
+            }
+            out_benchmark->active = true;
+        } else if (arg_value_get(argv[i], "upload_output=", &value)) {
+            string_ncopy(out_benchmark->output_path, value, sizeof(out_benchmark->output_path) - 1);
+        }
+    }
+
+    return out_benchmark->active;
+}
+
+// The resources a single operation is timed with at a single size.
+typedef struct operation_target {
+    texture* t;
+    char texture_name[64];
+    geometry g;
+} operation_target;
+
+static b8 target_create(upload_benchmark* benchmark, upload_benchmark_operation operation, u32 size_index, operation_target* out_target) {
+    kzero_memory(out_target, sizeof(operation_target));
+    u64 size = size_get(size_index);
+    switch (operation) {
+        case UPLOAD_BENCHMARK_OPERATION_TEXTURE_WRITE:
+        case UPLOAD_BENCHMARK_OPERATION_TEXTURE_READ: {
+            u32 dimension = 128 << size_index;
+            string_format(out_target->texture_name, "__upload_benchmark_%u__", size_index);
+            out_target->t = texture_system_acquire_writeable(out_target->texture_name, dimension, dimension, 4, false);
+            if (!out_target->t) {
+                KERROR("Failed to create a %ux%u texture to benchmark.", dimension, dimension);
+                return false;
+            }
+            // Written once to be read back.
+            renderer_texture_write_data(out_target->t, 0, (u32)size, benchmark->data);
+        } break;
+        case UPLOAD_BENCHMARK_OPERATION_GEOMETRY_UPLOAD:
+            if (!renderer_geometry_create(&out_target->g, GEOMETRY_VERTEX_SIZE, (u32)(size / GEOMETRY_VERTEX_SIZE), benchmark->data, 0, 0, 0)) {
+                return false;
+            }
+            // The first upload allocates its range of the geometry buffer. Later ones only load it.
+            if (!renderer_geometry_upload(&out_target->g)) {
+                KERROR("Failed to upload a %llu byte geometry to benchmark. The geometry buffer may be too small.", size);
+                renderer_geometry_destroy(&out_target->g);
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+    return renderer_upload_wait();
+}
+
+static void target_destroy(upload_benchmark_operation operation, operation_target* target) {
+    renderer_upload_wait();
+    if (target->t) {
+        texture_system_release(target->texture_name);
+    }
+    if (operation == UPLOAD_BENCHMARK_OPERATION_GEOMETRY_UPLOAD) {
+        renderer_geometry_destroy(&target->g);
+    }
+}
+
+static void operation_run(upload_benchmark* benchmark, upload_benchmark_operation operation, u64 size, operation_target* target) {
+    switch (operation) {
+        case UPLOAD_BENCHMARK_OPERATION_TEXTURE_WRITE:
+            renderer_texture_write_data(target->t, 0, (u32)size, benchmark->data);
+            break;
+        case UPLOAD_BENCHMARK_OPERATION_BUFFER_LOAD:
+            renderer_renderbuffer_load_range(&benchmark->burst_buffer, 0, size, benchmark->data);
+            break;
+        case UPLOAD_BENCHMARK_OPERATION_GEOMETRY_UPLOAD:
+            renderer_geometry_upload(&target->g);
+            break;
+        case UPLOAD_BENCHMARK_OPERATION_TEXTURE_READ: {
+            void* out_memory = benchmark->readback;
+            renderer_texture_read_data(target->t, 0, (u32)size, &out_memory);
+        } break;
+        default:
+            break;
+    }
+}
+
+static void operation_time(upload_benchmark* benchmark, upload_benchmark_operation operation, u32 size_index, upload_benchmark_result* out_result) {
+    kzero_memory(out_result, sizeof(upload_benchmark_result));
+    operation_target target;
+    if (!target_create(benchmark, operation, size_index, &target)) {
+        KWARN("Skipping %s of %llu bytes.", operation_names[operation], size_get(size_index));
+        return;
+    }
+
+    u64 size = size_get(size_index);
+    kclock clock;
+    f64 call_total = 0;
+    f64 latency_total = 0;
+    for (u32 i = 0; i < benchmark->iterations; ++i) {
+        kclock_start(&clock);
+        operation_run(benchmark, operation, size, &target);
+        kclock_update(&clock);
+        call_total += clock.elapsed;
+        renderer_upload_wait();
+        kclock_update(&clock);
+        latency_total += clock.elapsed;
+    }
+
+    // Back to back, only waiting once all of them are made.
+    kclock_start(&clock);
+    for (u32 i = 0; i < benchmark->iterations; ++i) {
+        operation_run(benchmark, operation, size, &target);
+    }
+    renderer_upload_wait();
+    kclock_update(&clock);
+
+    out_result->call_ms = (f32)(call_total * K_SEC_TO_MS_MULTIPLIER / benchmark->iterations);
+    out_result->latency_ms = (f32)(latency_total * K_SEC_TO_MS_MULTIPLIER / benchmark->iterations);
+    if (clock.elapsed > 0) {
+        out_result->throughput_mibs = (f32)((size * benchmark->iterations) / (f64)MEBIBYTES(1) / clock.elapsed);
+    }
+
+    target_destroy(operation, &target);
+}
+
+b8 upload_benchmark_begin(upload_benchmark* benchmark) {
+    u64 data_size = size_get(UPLOAD_BENCHMARK_SIZE_COUNT - 1);
+    benchmark->data = kallocate(data_size, MEMORY_TAG_GAME);
+    benchmark->readback = kallocate(data_size, MEMORY_TAG_GAME);
+    // Something other than zeroes, in case anything along the way treats those specially.
+    for (u64 i = 0; i < data_size; ++i) {
+        benchmark->data[i] = (u8)(i * 31);
+    }
+
+    if (!renderer_renderbuffer_create("renderbuffer_upload_benchmark", RENDERBUFFER_TYPE_VERTEX, BURST_BUFFER_SIZE, RENDERBUFFER_TRACK_TYPE_NONE, &benchmark->burst_buffer)) {
+        KERROR("Failed to create the upload benchmark buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&benchmark->burst_buffer, 0);
+
+    KINFO("Benchmarking uploads: %u iterations of each operation at each size...", benchmark->iterations);
+    for (u32 m = 0; m < UPLOAD_BENCHMARK_MODE_COUNT; ++m) {
+        renderer_upload_synchronous_set(m == UPLOAD_BENCHMARK_MODE_SYNCHRONOUS);
+        for (u32 o = 0; o < UPLOAD_BENCHMARK_OPERATION_COUNT; ++o) {
+            for (u32 s = 0; s < UPLOAD_BENCHMARK_SIZE_COUNT; ++s) {
+                operation_time(benchmark, (upload_benchmark_operation)o, s, &benchmark->results[m][o][s]);
+            }
+        }
+    }
+
+    // The bursts start with the first mode.
+    benchmark->burst_step = 0;
+    benchmark->burst_frame = 0;
+    renderer_upload_synchronous_set(true);
+    kclock_start(&benchmark->frame_clock);
+    KINFO("Measuring frame times with upload bursts: %u frames of each of %u sizes.", UPLOAD_BENCHMARK_BURST_FRAMES, UPLOAD_BENCHMARK_BURST_COUNT);
+    return true;
+}
+
+void upload_benchmark_frame_begin(upload_benchmark* benchmark) {
+    if (benchmark->burst_step >= UPLOAD_BENCHMARK_MODE_COUNT * UPLOAD_BENCHMARK_BURST_COUNT) {
+        return;
+    }
+    u64 burst_size = burst_size_get(benchmark->burst_step % UPLOAD_BENCHMARK_BURST_COUNT);
+    for (u64 offset = 0; offset < burst_size; offset += BURST_CHUNK_SIZE) {
+        renderer_renderbuffer_load_range(&benchmark->burst_buffer, offset, BURST_CHUNK_SIZE, benchmark->data);
+    }
+}
+
+static i32 f32_compare(void* a, void* b) {
+    f32 x = *(f32*)a;
+    f32 y = *(f32*)b;
+    return (x > y) - (x < y);
+}
+
+b8 upload_benchmark_frame_end(upload_benchmark* benchmark) {
+    u32 step_count = UPLOAD_BENCHMARK_MODE_COUNT * UPLOAD_BENCHMARK_BURST_COUNT;
+    if (benchmark->burst_step >= step_count) {
+        return true;
+    }
+
+    // From the end of the last frame, so that this frame's burst is included.
+    kclock_update(&benchmark->frame_clock);
+    f32 frame_ms = (f32)(benchmark->frame_clock.elapsed * K_SEC_TO_MS_MULTIPLIER);
+    kclock_start(&benchmark->frame_clock);
+
+    benchmark->burst_frame++;
+    if (benchmark->burst_frame <= UPLOAD_BENCHMARK_BURST_WARMUP) {
+        return false;
+    }
+    u32 sample_index = benchmark->burst_frame - UPLOAD_BENCHMARK_BURST_WARMUP - 1;
+    benchmark->burst_samples[sample_index] = frame_ms;
+    if (sample_index + 1 < UPLOAD_BENCHMARK_BURST_FRAMES) {
+        return false;
+    }
+
+    // This burst is done.
+    f32* samples = benchmark->burst_samples;
+    u32 count = UPLOAD_BENCHMARK_BURST_FRAMES;
+    f64 sum = 0;
+    for (u32 i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+    kquick_sort(sizeof(f32), samples, 0, (i32)count - 1, f32_compare);
+    u32 mode = benchmark->burst_step / UPLOAD_BENCHMARK_BURST_COUNT;
+    upload_benchmark_burst_result* result = &benchmark->burst_results[mode][benchmark->burst_step % UPLOAD_BENCHMARK_BURST_COUNT];
+    result->mean_ms = (f32)(sum / count);
+    // Nearest-rank percentile.
+    result->p99_ms = samples[KMIN((u32)kceil(0.99f * count), count) - 1];
+    result->max_ms = samples[count - 1];
+
+    benchmark->burst_step++;
+    benchmark->burst_frame = 0;
+    if (benchmark->burst_step >= step_count) {
+        renderer_upload_synchronous_set(false);
+        return true;
+    }
+    renderer_upload_synchronous_set(benchmark->burst_step / UPLOAD_BENCHMARK_BURST_COUNT == UPLOAD_BENCHMARK_MODE_SYNCHRONOUS);
+    return false;
+}
+
+static b8 results_write(const upload_benchmark* benchmark) {
+    file_handle f;
+    if (!filesystem_open(benchmark->output_path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to open upload benchmark output file '%s'.", benchmark->output_path);
+        return false;
+    }
+
+    // Bursts are listed as operations of their own, with only the frame times filled in.
+    b8 result = filesystem_write_line(&f, "mode,operation,bytes,call_ms,latency_ms,throughput_mibs,frame_mean_ms,frame_p99_ms,frame_max_ms");
+    char line[256];
+    for (u32 m = 0; m < UPLOAD_BENCHMARK_MODE_COUNT; ++m) {
+        for (u32 o = 0; result && o < UPLOAD_BENCHMARK_OPERATION_COUNT; ++o) {
+            for (u32 s = 0; result && s < UPLOAD_BENCHMARK_SIZE_COUNT; ++s) {
+                const upload_benchmark_result* r = &benchmark->results[m][o][s];
+                string_format(line, "%s,%s,%llu,%.4f,%.4f,%.2f,0,0,0", mode_names[m], operation_names[o], size_get(s), r->call_ms, r->latency_ms, r->throughput_mibs);
+                result = filesystem_write_line(&f, line);
+            }
+        }
+        for (u32 b = 0; result && b < UPLOAD_BENCHMARK_BURST_COUNT; ++b) {
+            const upload_benchmark_burst_result* r = &benchmark->burst_results[m][b];
+            string_format(line, "%s,burst,%llu,0,0,0,%.4f,%.4f,%.4f", mode_names[m], burst_size_get(b), r->mean_ms, r->p99_ms, r->max_ms);
+            result = filesystem_write_line(&f, line);
+        }
+    }
+    filesystem_close(&f);
+
+    if (!result) {
+        KERROR("Failed to write upload benchmark output file '%s'.", benchmark->output_path);
+    }
+    return result;
+}
+
+void upload_benchmark_report(const upload_benchmark* benchmark) {
+    KINFO("Upload benchmark results, %u iterations each (times in ms, throughput in MiB/s):", benchmark->iterations);
+    KINFO("%-16s %-12s %9s %9s %9s %10s", "operation", "mode", "KiB", "call", "latency", "throughput");
+    for (u32 o = 0; o < UPLOAD_BENCHMARK_OPERATION_COUNT; ++o) {
+        for (u32 s = 0; s < UPLOAD_BENCHMARK_SIZE_COUNT; ++s) {
+            for (u32 m = 0; m < UPLOAD_BENCHMARK_MODE_COUNT; ++m) {
+                const upload_benchmark_result* r = &benchmark->results[m][o][s];
+                KINFO("%-16s %-12s %9llu %9.3f %9.3f %10.1f", operation_names[o], mode_names[m], size_get(s) / KIBIBYTES(1), r->call_ms, r->latency_ms, r->throughput_mibs);
+            }
+        }
+    }
+
+    KINFO("Frame times with a burst of %lluKiB buffer loads every frame, %u frames each:", BURST_CHUNK_SIZE / KIBIBYTES(1), UPLOAD_BENCHMARK_BURST_FRAMES);
+    KINFO("%-12s %9s %9s %9s %9s", "mode", "KiB", "mean", "p99", "max");
+    for (u32 b = 0; b < UPLOAD_BENCHMARK_BURST_COUNT; ++b) {
+        for (u32 m = 0; m < UPLOAD_BENCHMARK_MODE_COUNT; ++m) {
+            const upload_benchmark_burst_result* r = &benchmark->burst_results[m][b];
+            KINFO("%-12s %9llu %9.3f %9.3f %9.3f", mode_names[m], burst_size_get(b) / KIBIBYTES(1), r->mean_ms, r->p99_ms, r->max_ms);
+        }
+    }
+
+    if (benchmark->output_path[0]) {
+        if (results_write(benchmark)) {
+            KINFO("Upload benchmark results written to '%s'.", benchmark->output_path);
+        }
+    }
+}
+
+void upload_benchmark_destroy(upload_benchmark* benchmark) {
+    if (!benchmark->active) {
+        return;
+    }
+    renderer_upload_synchronous_set(false);
+    renderer_upload_wait();
+    if (benchmark->burst_buffer.internal_data) {
+        renderer_renderbuffer_unbind(&benchmark->burst_buffer);
+        renderer_renderbuffer_destroy(&benchmark->burst_buffer);
+    }
+    u64 data_size = size_get(UPLOAD_BENCHMARK_SIZE_COUNT - 1);
+    if (benchmark->data) {
+        kfree(benchmark->data, data_size, MEMORY_TAG_GAME);
+        benchmark->data = 0;
+    }
+    if (benchmark->readback) {
+        kfree(benchmark->readback, data_size, MEMORY_TAG_GAME);
+        benchmark->readback = 0;
+    }
+    benchmark->active = false;
+}
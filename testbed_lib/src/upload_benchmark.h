@@ -0,0 +1,152 @@
+/**
+ * @file upload_benchmark.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A benchmark of moving data to and from the GPU, for the testbed.
+ * @details Started from the command line with "upload_benchmark=<iterations>", optionally followed
+ * by "upload_output=<path>". Texture writes, buffer loads, geometry uploads and texture reads are
+ * first timed at a range of sizes, each one with uploads submitted and waited on one at a time
+ * (as they were before being batched) and then batched, as they are by default. For each, the CPU
+ * time of a call, the time until the GPU has the data and the throughput of back to back calls are
+ * measured. Then, for each way of submitting uploads again, bursts of buffer loads of a range of
+ * sizes are made every frame for a number of frames, to measure their impact on the frame time.
+ * Once done, the results are logged, optionally written to a CSV file, and the application quits.
+ * @version 1.0
+ * @date 2023-12-28
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <core/kclock.h>
+#include <defines.h>
+#include <renderer/renderer_types.h>
+
+/** @brief The number of times each operation is timed at each size when none is given. */
+#define UPLOAD_BENCHMARK_DEFAULT_ITERATIONS 16
+/** @brief The number of sizes each operation is timed at, from 64KiB up, four times larger each. */
+#define UPLOAD_BENCHMARK_SIZE_COUNT 5
+/** @brief The number of burst sizes the frame time is measured with, from nothing up. */
+#define UPLOAD_BENCHMARK_BURST_COUNT 5
+/** @brief The number of frames recorded for each burst size. */
+#define UPLOAD_BENCHMARK_BURST_FRAMES 120
+/** @brief The number of frames made with each burst size before recording starts. */
+#define UPLOAD_BENCHMARK_BURST_WARMUP 10
+
+/** @brief The ways of submitting uploads which are compared. */
+typedef enum upload_benchmark_mode {
+    /** @brief Each upload is submitted and waited on as soon as it is made. */
+    UPLOAD_BENCHMARK_MODE_SYNCHRONOUS,
+    /** @brief Uploads are batched and submitted without waiting, the renderer's default. */
+    UPLOAD_BENCHMARK_MODE_BATCHED,
+    UPLOAD_BENCHMARK_MODE_COUNT
+} upload_benchmark_mode;
+
+/** @brief The operations which are timed. */
+typedef enum upload_benchmark_operation {
+    /** @brief renderer_texture_write_data */
+    UPLOAD_BENCHMARK_OPERATION_TEXTURE_WRITE,
+    /** @brief renderer_renderbuffer_load_range, to a device-local buffer. */
+    UPLOAD_BENCHMARK_OPERATION_BUFFER_LOAD,
+    /** @brief renderer_geometry_upload */
+    UPLOAD_BENCHMARK_OPERATION_GEOMETRY_UPLOAD,
+    /** @brief renderer_texture_read_data */
+    UPLOAD_BENCHMARK_OPERATION_TEXTURE_READ,
+    UPLOAD_BENCHMARK_OPERATION_COUNT
+} upload_benchmark_operation;
+
+/** @brief The timings of a single operation at a single size. */
+typedef struct upload_benchmark_result {
+    /** @brief The mean CPU time of a single call, in milliseconds. */
+    f32 call_ms;
+    /** @brief The mean time from the start of a call until the GPU has the data, in milliseconds. */
+    f32 latency_ms;
+    /** @brief The rate at which back to back calls complete, in MiB per second. */
+    f32 throughput_mibs;
+} upload_benchmark_result;
+
+/** @brief The frame times with uploads of a single burst size made every frame, in milliseconds. */
+typedef struct upload_benchmark_burst_result {
+    f32 mean_ms;
+    f32 p99_ms;
+    f32 max_ms;
+} upload_benchmark_burst_result;
+
+typedef struct upload_benchmark {
+    /** @brief Indicates if the benchmark was requested. */
+    b8 active;
+    /** @brief The path of the CSV file the results are written to. Empty to skip it. */
+    char output_path[256];
+    /** @brief The number of times each operation is timed at each size. */
+    u32 iterations;
+
+    /** @brief The timings of each operation at each size, for each mode. */
+    upload_benchmark_result results[UPLOAD_BENCHMARK_MODE_COUNT][UPLOAD_BENCHMARK_OPERATION_COUNT][UPLOAD_BENCHMARK_SIZE_COUNT];
+    /** @brief The frame times with each burst size, for each mode. */
+    upload_benchmark_burst_result burst_results[UPLOAD_BENCHMARK_MODE_COUNT][UPLOAD_BENCHMARK_BURST_COUNT];
+
+    /** @brief The burst being measured, counting through every burst size of each mode in turn. */
+    u32 burst_step;
+    /** @brief The number of frames made with the current burst. */
+    u32 burst_frame;
+    /** @brief The frame times recorded for the current burst. */
+    f32 burst_samples[UPLOAD_BENCHMARK_BURST_FRAMES];
+    /** @brief Times each frame, from the end of the one before. */
+    kclock frame_clock;
+    /** @brief The device-local buffer bursts are loaded into. */
+    renderbuffer burst_buffer;
+
+    /** @brief The data uploaded, as large as the largest upload. */
+    u8* data;
+    /** @brief Holds what is read back, as large as the largest read. */
+    u8* readback;
+} upload_benchmark;
+
+/**
+ * @brief Reads the upload benchmark options from the command line.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @param out_benchmark A pointer to hold the benchmark. Marked active only if one was requested.
+ * @return True if the benchmark was requested; otherwise false.
+ */
+b8 upload_benchmark_parse(i32 argc, char** argv, upload_benchmark* out_benchmark);
+
+/**
+ * @brief Times each operation at each size, in each mode, then prepares for the bursts which are
+ * made over the following frames. Blocks until the timings are done. Must be called between frames.
+ *
+ * @param benchmark A pointer to the benchmark.
+ * @return True on success; otherwise false.
+ */
+b8 upload_benchmark_begin(upload_benchmark* benchmark);
+
+/**
+ * @brief Makes the current frame's burst of uploads. Called once per frame, before it is rendered.
+ *
+ * @param benchmark A pointer to the benchmark.
+ */
+void upload_benchmark_frame_begin(upload_benchmark* benchmark);
+
+/**
+ * @brief Records a rendered frame. Called once per frame after it is presented.
+ *
+ * @param benchmark A pointer to the benchmark.
+ * @return True once every burst has been measured; otherwise false.
+ */
+b8 upload_benchmark_frame_end(upload_benchmark* benchmark);
+
+/**
+ * @brief Logs the results of the benchmark, and writes them out if an output path was given.
+ *
+ * @param benchmark A constant pointer to the benchmark.
+ */
+void upload_benchmark_report(const upload_benchmark* benchmark);
+
+/**
+ * @brief Releases the resources of the benchmark, restoring batched uploads.
+ *
+ * @param benchmark A pointer to the benchmark.
+ */
+void upload_benchmark_destroy(upload_benchmark* benchmark);
@@ -16,6 +16,12 @@
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 
+// The most pixel reads which may be waiting on the GPU at once. Covers every frame in flight.
+#define PICK_MAX_PENDING_READS 4
+// The width and height of the region around the mouse which is rendered, in pixels. Only the pixel under the
+// mouse is read, but a few either side keep the result stable against rounding of the cursor position.
+#define PICK_REGION_SIZE 8
+
 typedef struct render_view_pick_shader_info {
     shader* s;
     renderpass* pass;
@@ -41,6 +47,15 @@ typedef struct render_view_pick_internal_data {
 
     i16 mouse_x, mouse_y;
     // u32 render_mode;
+
+    // The rectangle around the mouse the passes are scissored to, in pixels. Set when the packet is built.
+    vec4 region;
+    // The number of world geometries covering the region, which come first in the packet's geometries.
+    u32 world_geometry_count;
+
+    // Reads of the pixel under the mouse which haven't resolved yet, oldest first.
+    renderer_readback_ticket pending_reads[PICK_MAX_PENDING_READS];
+    u32 pending_read_count;
 } render_view_pick_internal_data;
 
 static b8 on_mouse_moved(u16 code, void* sender, void* listener_inst, event_context event_data) {
@@ -74,6 +89,46 @@ static b8 render_view_on_event(u16 code, void* sender, void* listener_inst, even
     return false;
 }
 
+// Indicates if the given geometry's bounds could cover any pixel of the pick region once projected. Errs on the
+// side of keeping the geometry, which is always kept if its bounds are unknown or reach the near clipping plane.
+static b8 pick_region_covered(const render_view_pick_internal_data* data, const viewport* v, const mat4* view, const geometry_render_data* geo) {
+    if (geo->bounds_radius <= 0.0f || v->rect.width <= 0.0f || v->rect.height <= 0.0f) {
+        return true;
+    }
+
+    // The camera looks down -z in view space.
+    vec3 p = vec3_mul_mat4(geo->bounds_center, *view);
+    f32 r = geo->bounds_radius;
+    f32 ndc_x, ndc_y, ndc_radius_x, ndc_radius_y;
+    if (v->projection_matrix_type == RENDERER_PROJECTION_MATRIX_TYPE_PERSPECTIVE) {
+        f32 depth = -p.z;
+        if (depth - r <= v->near_clip) {
+            return true;
+        }
+        ndc_x = v->projection.data[0] * p.x / depth;
+        ndc_y = v->projection.data[5] * p.y / depth;
+        // Off the axis, the nearer side of the sphere is spread further than its center, so widen the radius to
+        // enclose its projection at its nearest depth.
+        ndc_radius_x = v->projection.data[0] * r * (1.0f + kabs(p.x) / depth) / (depth - r);
+        ndc_radius_y = v->projection.data[5] * r * (1.0f + kabs(p.y) / depth) / (depth - r);
+    } else {
+        ndc_x = v->projection.data[0] * p.x + v->projection.data[12];
+        ndc_y = v->projection.data[5] * p.y + v->projection.data[13];
+        ndc_radius_x = kabs(v->projection.data[0]) * r;
+        ndc_radius_y = kabs(v->projection.data[5]) * r;
+    }
+
+    // To pixels, with y running down the screen as the mouse coordinates do.
+    f32 x = v->rect.x + (ndc_x * 0.5f + 0.5f) * v->rect.width;
+    f32 y = v->rect.y + (0.5f - ndc_y * 0.5f) * v->rect.height;
+    f32 radius_x = ndc_radius_x * 0.5f * v->rect.width;
+    f32 radius_y = ndc_radius_y * 0.5f * v->rect.height;
+
+    const vec4* region = &data->region;
+    return x + radius_x >= region->x && x - radius_x <= region->x + region->z &&
+           y + radius_y >= region->y && y - radius_y <= region->y + region->w;
+}
+
 static void acquire_shader_instances(const struct render_view* self) {
     render_view_pick_internal_data* data = self->internal_data;
 
@@ -270,6 +325,14 @@ b8 render_view_pick_on_packet_build(const struct render_view* self, struct frame
     internal_data->world_shader_info.view = camera_view_get(c);
     internal_data->terrain_shader_info.view = camera_view_get(c);
 
+    // Only the region around the mouse is rendered, so only geometries covering it need to be drawn.
+    vec4 region;
+    region.z = KMIN(PICK_REGION_SIZE, v->rect.width);
+    region.w = KMIN(PICK_REGION_SIZE, v->rect.height);
+    region.x = KCLAMP(internal_data->mouse_x - region.z * 0.5f, v->rect.x, v->rect.x + v->rect.width - region.z);
+    region.y = KCLAMP(internal_data->mouse_y - region.w * 0.5f, v->rect.y, v->rect.y + v->rect.height - region.w);
+    internal_data->region = region;
+
     // Set the pick packet data to extended data.
     packet_data->ui_geometry_count = 0;
     out_packet->extended_data = p_frame_data->allocator.allocate(sizeof(pick_packet_data));
@@ -277,9 +340,14 @@ b8 render_view_pick_on_packet_build(const struct render_view* self, struct frame
     u32 world_geometry_count = !packet_data->world_mesh_data ? 0 : darray_length(packet_data->world_mesh_data);
 
     u32 highest_instance_id = 0;
+    internal_data->world_geometry_count = 0;
     // Iterate all geometries in world data.
     for (u32 i = 0; i < world_geometry_count; ++i) {
+        if (!pick_region_covered(internal_data, v, &internal_data->world_shader_info.view, &packet_data->world_mesh_data[i])) {
+            continue;
+        }
         darray_push(out_packet->geometries, packet_data->world_mesh_data[i]);
+        internal_data->world_geometry_count++;
 
         // Count all geometries as a single id.
         if (packet_data->world_mesh_data[i].unique_id > highest_instance_id) {
@@ -292,6 +360,9 @@ b8 render_view_pick_on_packet_build(const struct render_view* self, struct frame
 
     // Iterate all geometries in terrain data.
     for (u32 i = 0; i < terrain_geometry_count; ++i) {
+        if (!pick_region_covered(internal_data, v, &internal_data->terrain_shader_info.view, &packet_data->terrain_mesh_data[i])) {
+            continue;
+        }
         darray_push(out_packet->terrain_geometries, packet_data->terrain_mesh_data[i]);
 
         // Count all geometries as a single id.
@@ -304,7 +375,7 @@ b8 render_view_pick_on_packet_build(const struct render_view* self, struct frame
     for (u32 i = 0; i < packet_data->ui_mesh_data.mesh_count; ++i) {
         mesh* m = packet_data->ui_mesh_data.meshes[i];
         for (u32 j = 0; j < m->geometry_count; ++j) {
-            geometry_render_data render_data;
+            geometry_render_data render_data = {0};
             geometry* g = m->geometries[j];
             render_data.material = g->material;
             render_data.vertex_count = g->vertex_count;
@@ -377,6 +448,7 @@ b8 render_view_pick_on_render(const struct render_view* self, const struct rende
             KERROR("render_view_ui_on_render pass index %u failed to start.", p);
             return false;
         }
+        renderer_scissor_set(data->region);
 
         u64 current_instance_id = 0;
 
@@ -397,7 +469,7 @@ b8 render_view_pick_on_render(const struct render_view* self, const struct rende
         shader_system_apply_global(true, p_frame_data);
 
         // Draw geometries. Start from 0 since world geometries are added first, and stop at the world geometry count.
-        u32 world_geometry_count = !packet_data->world_mesh_data ? 0 : darray_length(packet_data->world_mesh_data);
+        u32 world_geometry_count = data->world_geometry_count;
         for (u32 i = 0; i < world_geometry_count; ++i) {
             geometry_render_data* geo = &packet->geometries[i];
             current_instance_id = geo->unique_id;
@@ -444,7 +516,7 @@ b8 render_view_pick_on_render(const struct render_view* self, const struct rende
         shader_system_apply_global(true, p_frame_data);
 
         // Draw geometries. Start from 0 since terrain geometries are added first, and stop at the terrain geometry count.
-        u32 terrain_geometry_count = !packet_data->terrain_mesh_data ? 0 : darray_length(packet_data->terrain_mesh_data);
+        u32 terrain_geometry_count = darray_length(packet->terrain_geometries);
         for (u32 i = 0; i < terrain_geometry_count; ++i) {
             geometry_render_data* geo = &packet->terrain_geometries[i];
             current_instance_id = geo->unique_id;
@@ -486,6 +558,7 @@ b8 render_view_pick_on_render(const struct render_view* self, const struct rende
             KERROR("render_view_pick_on_render pass index %u failed to start.", p);
             return false;
         }
+        renderer_scissor_set(data->region);
 
         // UI
         if (!shader_system_use_by_id(data->ui_shader_info.s->id)) {
@@ -570,29 +643,46 @@ b8 render_view_pick_on_render(const struct render_view* self, const struct rende
         }
     }
 
-    // Read pixel data.
-    texture* t = &data->colour_target_attachment_texture;
-
-    // Read the pixel at the mouse coordinate.
-    u8 pixel_rgba[4] = {0};
-    u8* pixel = &pixel_rgba[0];
+    // Pick up the reads of earlier frames which have completed. Going oldest first, the last one
+    // resolved is the most recent thing seen under the mouse.
+    b8 resolved = false;
+    u32 id = INVALID_ID;
+    u32 still_pending = 0;
+    for (u32 i = 0; i < data->pending_read_count; ++i) {
+        u8 pixel[4] = {0};
+        renderer_readback_status status = renderer_readback_resolve(data->pending_reads[i], sizeof(pixel), pixel);
+        if (status == RENDERER_READBACK_STATUS_READY) {
+            // Extract the id from the sampled colour.
+            rgbu_to_u32(pixel[0], pixel[1], pixel[2], &id);
+            if (id == 0x00FFFFFF) {
+                // This is pure white.
+                id = INVALID_ID;
+            }
+            resolved = true;
+        } else if (status == RENDERER_READBACK_STATUS_PENDING) {
+            data->pending_reads[still_pending++] = data->pending_reads[i];
+        }
+    }
+    data->pending_read_count = still_pending;
 
-    // Clamp to image size
-    u16 x_coord = KCLAMP(data->mouse_x, 0, self->width - 1);
-    u16 y_coord = KCLAMP(data->mouse_y, 0, self->height - 1);
-    renderer_texture_read_pixel(t, x_coord, y_coord, &pixel);
+    // Request the pixel at the mouse coordinate, to be picked up once this frame completes.
+    if (data->pending_read_count < PICK_MAX_PENDING_READS) {
+        texture* t = &data->colour_target_attachment_texture;
 
-    // Extract the id from the sampled colour.
-    u32 id = INVALID_ID;
-    rgbu_to_u32(pixel[0], pixel[1], pixel[2], &id);
-    if (id == 0x00FFFFFF) {
-        // This is pure white.
-        id = INVALID_ID;
+        // Clamp to image size
+        u16 x_coord = KCLAMP(data->mouse_x, 0, self->width - 1);
+        u16 y_coord = KCLAMP(data->mouse_y, 0, self->height - 1);
+        renderer_readback_ticket ticket;
+        if (renderer_texture_read_pixel_async(t, x_coord, y_coord, &ticket)) {
+            data->pending_reads[data->pending_read_count++] = ticket;
+        }
     }
 
-    event_context context;
-    context.data.u32[0] = id;
-    event_fire(EVENT_CODE_OBJECT_HOVER_ID_CHANGED, 0, context);
+    if (resolved) {
+        event_context context;
+        context.data.u32[0] = id;
+        event_fire(EVENT_CODE_OBJECT_HOVER_ID_CHANGED, 0, context);
+    }
 
     return true;
 }
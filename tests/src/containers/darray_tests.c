@@ -0,0 +1,147 @@
+#include "darray_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/darray.h>
+#include <core/frame_data.h>
+#include <memory/linear_allocator.h>
+
+// An arena standing in for the frame allocator, which can grow its latest allocation in place.
+static linear_allocator test_arena;
+static void* test_arena_last_block;
+
+static void* test_arena_allocate(u64 size) {
+    test_arena_last_block = linear_allocator_allocate(&test_arena, size);
+    return test_arena_last_block;
+}
+
+static void test_arena_free(void* block, u64 size) {
+}
+
+static void test_arena_free_all(void) {
+    linear_allocator_free_all(&test_arena, false);
+    test_arena_last_block = 0;
+}
+
+static b8 test_arena_grow(void* block, u64 size, u64 new_size) {
+    if (block != test_arena_last_block || test_arena.allocated - size + new_size > test_arena.total_size) {
+        return false;
+    }
+    test_arena.allocated += new_size - size;
+    return true;
+}
+
+u8 darray_should_grow_and_keep_values(void) {
+    u32* array = darray_create(u32);
+    for (u32 i = 0; i < 100; ++i) {
+        darray_push(array, i);
+    }
+    expect_should_be(100, darray_length(array));
+    expect_to_be_true(darray_capacity(array) >= 100);
+    for (u32 i = 0; i < 100; ++i) {
+        expect_should_be(i, array[i]);
+    }
+
+    // A smaller factor grows more gradually, but by at least one element.
+    darray_growth_factor_set(array, 1.01f);
+    u64 capacity = darray_capacity(array);
+    while (darray_length(array) < capacity) {
+        u32 value = 0;
+        darray_push(array, value);
+    }
+    u32 value = 0;
+    darray_push(array, value);
+    expect_should_be(capacity + 1, darray_capacity(array));
+
+    // Factors of 1 or less are ignored.
+    darray_growth_factor_set(array, 0.5f);
+    capacity = darray_capacity(array);
+    while (darray_length(array) <= capacity) {
+        darray_push(array, value);
+    }
+    expect_to_be_true(darray_capacity(array) > capacity);
+
+    darray_destroy(array);
+    return true;
+}
+
+u8 darray_should_reserve_exact(void) {
+    u32* array = darray_create(u32);
+    darray_push(array, 7u);
+
+    darray_reserve_exact(array, 37);
+    expect_should_be(37, darray_capacity(array));
+    expect_should_be(1, darray_length(array));
+    expect_should_be(7, array[0]);
+
+    // Never shrinks.
+    darray_reserve_exact(array, 10);
+    expect_should_be(37, darray_capacity(array));
+
+    darray_destroy(array);
+    return true;
+}
+
+u8 darray_should_grow_in_place_in_arena(void) {
+    linear_allocator_create(KIBIBYTES(4), 0, &test_arena);
+    frame_allocator_int allocator = {test_arena_allocate, test_arena_free, test_arena_free_all, test_arena_grow};
+
+    u32* array = darray_create_with_allocator(u32, &allocator);
+    void* first = array;
+    for (u32 i = 0; i < 64; ++i) {
+        darray_push(array, i);
+    }
+    // The array was the latest allocation throughout, so it never moved or left anything behind.
+    expect_should_be(first, array);
+    expect_should_be(DARRAY_HEADER_SIZE + darray_capacity(array) * sizeof(u32), test_arena.allocated);
+
+    // Once something else is allocated behind it, growing has to move the array.
+    test_arena_allocate(16);
+    u64 capacity = darray_capacity(array);
+    while (darray_length(array) <= capacity) {
+        u32 value = 1;
+        darray_push(array, value);
+    }
+    expect_should_not_be(first, array);
+    for (u32 i = 0; i < 64; ++i) {
+        expect_should_be(i, array[i]);
+    }
+
+    linear_allocator_destroy(&test_arena);
+    return true;
+}
+
+u8 darray_should_use_buffer_until_outgrown(void) {
+    darray_buffer_declare(u32, buffer, 8);
+    u32* array = darray_create_in_buffer(u32, buffer, 0);
+    expect_should_be((u8*)buffer + DARRAY_HEADER_SIZE, (u8*)array);
+    expect_should_be(8, darray_capacity(array));
+
+    for (u32 i = 0; i < 8; ++i) {
+        darray_push(array, i);
+    }
+    expect_should_be((u8*)buffer + DARRAY_HEADER_SIZE, (u8*)array);
+
+    // Outgrowing the buffer moves the array to dynamic memory, which must then be destroyed.
+    darray_push(array, 8u);
+    expect_should_not_be((u8*)buffer + DARRAY_HEADER_SIZE, (u8*)array);
+    expect_should_be(9, darray_length(array));
+    for (u32 i = 0; i < 9; ++i) {
+        expect_should_be(i, array[i]);
+    }
+    darray_destroy(array);
+
+    // Destroying an array still in its buffer does nothing.
+    u32* in_buffer = darray_create_in_buffer(u32, buffer, 0);
+    darray_push(in_buffer, 1u);
+    darray_destroy(in_buffer);
+    return true;
+}
+
+void darray_register_tests(void) {
+    test_manager_register_test(darray_should_grow_and_keep_values, "Darray should grow by its growth factor and keep its values");
+    test_manager_register_test(darray_should_reserve_exact, "Darray should reserve an exact capacity");
+    test_manager_register_test(darray_should_grow_in_place_in_arena, "Darray should grow in place at the top of an arena");
+    test_manager_register_test(darray_should_use_buffer_until_outgrown, "Darray should use its buffer until outgrown");
+}
@@ -326,7 +326,7 @@ u8 util_freelist_free(freelist* list, alloc_data* data, u64* currently_allocated
     return true;
 }
 
-u8 freelist_multiple_alloc_and_free_random(void) {
+static u8 multiple_alloc_and_free_random(freelist_strategy strategy) {
     freelist list;
 
     // Pick random sizes.
@@ -346,11 +346,11 @@ u8 freelist_multiple_alloc_and_free_random(void) {
 
     // Get the memory requirement
     u64 memory_requirement = 0;
-    freelist_create(total_size, &memory_requirement, 0, 0);
+    freelist_create_strategy(total_size, strategy, &memory_requirement, 0, 0);
 
     // Allocate and create the freelist.
     void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
-    freelist_create(total_size, &memory_requirement, block, &list);
+    freelist_create_strategy(total_size, strategy, &memory_requirement, block, &list);
 
     // Verify free space.
     u64 free_space = freelist_free_space(&list);
@@ -411,6 +411,147 @@ u8 freelist_multiple_alloc_and_free_random(void) {
     return true;
 }
 
+u8 freelist_multiple_alloc_and_free_random(void) {
+    return multiple_alloc_and_free_random(FREELIST_STRATEGY_FIRST_FIT);
+}
+
+u8 freelist_tlsf_multiple_alloc_and_free_random(void) {
+    return multiple_alloc_and_free_random(FREELIST_STRATEGY_TLSF);
+}
+
+u8 freelist_tlsf_should_allocate_free_and_merge(void) {
+    freelist list;
+
+    // Get the memory requirement
+    u64 memory_requirement = 0;
+    u64 total_size = 512;
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, 0, 0);
+
+    // Allocate and create the freelist.
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, block, &list);
+    expect_should_be(total_size, freelist_free_space(&list));
+
+    // Allocations are taken from the front of the only free range.
+    u64 offsets[4];
+    for (u32 i = 0; i < 4; ++i) {
+        offsets[i] = INVALID_ID;
+        expect_to_be_true(freelist_allocate_block(&list, 64, &offsets[i]));
+        expect_should_be(i * 64, offsets[i]);
+    }
+    expect_should_be(total_size - 256, freelist_free_space(&list));
+
+    // Free the 2nd and 3rd blocks, which should merge into a single range.
+    expect_to_be_true(freelist_free_block(&list, 64, offsets[1]));
+    expect_to_be_true(freelist_free_block(&list, 64, offsets[2]));
+    expect_should_be(total_size - 128, freelist_free_space(&list));
+
+    // Freeing the same block again should fail.
+    KDEBUG("The following fatal message is intentional.");
+    expect_to_be_false(freelist_free_block(&list, 64, offsets[1]));
+
+    // A 128B allocation fits exactly in the merged range, even though the end of the list is larger.
+    u64 offset = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 128, &offset));
+    expect_should_be(64, offset);
+
+    // Free everything, which should leave a single range covering everything.
+    expect_to_be_true(freelist_free_block(&list, 128, offset));
+    expect_to_be_true(freelist_free_block(&list, 64, offsets[0]));
+    expect_to_be_true(freelist_free_block(&list, 64, offsets[3]));
+    expect_should_be(total_size, freelist_free_space(&list));
+    expect_float_to_be(0.0f, freelist_fragmentation(&list));
+    expect_to_be_true(freelist_allocate_block(&list, total_size, &offset));
+    expect_should_be(0, offset);
+
+    freelist_destroy(&list);
+    expect_should_be(0, list.memory);
+    kfree(block, memory_requirement, MEMORY_TAG_ENGINE);
+
+    return true;
+}
+
+u8 freelist_tlsf_should_allocate_to_full_and_fail_to_allocate_more(void) {
+    freelist list;
+
+    // Get the memory requirement
+    u64 memory_requirement = 0;
+    u64 total_size = 1000;
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, 0, 0);
+
+    // Allocate and create the freelist.
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, block, &list);
+
+    // Allocate all space at once. Not a power of 2, so it is not found by the rounded-up search.
+    u64 offset = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, total_size, &offset));
+    expect_should_be(0, offset);
+    expect_should_be(0, freelist_free_space(&list));
+
+    // Now try allocating some more
+    u64 offset2 = INVALID_ID;
+    KDEBUG("The following warning message is intentional.");
+    expect_to_be_false(freelist_allocate_block(&list, 64, &offset2));
+
+    // Clearing should make all of it available again.
+    freelist_clear(&list);
+    expect_should_be(total_size, freelist_free_space(&list));
+
+    freelist_destroy(&list);
+    expect_should_be(0, list.memory);
+    kfree(block, memory_requirement, MEMORY_TAG_ENGINE);
+
+    return true;
+}
+
+u8 freelist_tlsf_should_resize_and_report_fragmentation(void) {
+    freelist list;
+
+    // Get the memory requirement
+    u64 memory_requirement = 0;
+    u64 total_size = 512;
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, 0, 0);
+
+    // Allocate and create the freelist.
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_strategy(total_size, FREELIST_STRATEGY_TLSF, &memory_requirement, block, &list);
+
+    // Fill it with 8 blocks, then free every other one so the free space is split into 4 equal ranges.
+    u64 offsets[8];
+    for (u32 i = 0; i < 8; ++i) {
+        expect_to_be_true(freelist_allocate_block(&list, 64, &offsets[i]));
+    }
+    for (u32 i = 0; i < 8; i += 2) {
+        expect_to_be_true(freelist_free_block(&list, 64, offsets[i]));
+    }
+    expect_should_be(256, freelist_free_space(&list));
+    expect_float_to_be(0.75f, freelist_fragmentation(&list));
+
+    // Grow the list. The last block is still allocated, so the new space becomes a new range.
+    u64 new_size = 1024;
+    u64 new_requirement = 0;
+    expect_to_be_true(freelist_resize(&list, &new_requirement, 0, new_size, 0));
+    void* new_block = kallocate(new_requirement, MEMORY_TAG_ENGINE);
+    void* old_block = 0;
+    expect_to_be_true(freelist_resize(&list, &new_requirement, new_block, new_size, &old_block));
+    expect_should_be(block, old_block);
+    kfree(old_block, memory_requirement, MEMORY_TAG_ENGINE);
+    expect_should_be(256 + 512, freelist_free_space(&list));
+
+    // Existing ranges should still be intact and mergeable.
+    expect_to_be_true(freelist_free_block(&list, 64, offsets[7]));
+    u64 offset = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 576, &offset));
+    expect_should_be(offsets[6], offset);
+
+    freelist_destroy(&list);
+    expect_should_be(0, list.memory);
+    kfree(new_block, new_requirement, MEMORY_TAG_ENGINE);
+
+    return true;
+}
+
 void freelist_register_tests(void) {
     test_manager_register_test(freelist_should_create_and_destroy, "Freelist should create and destroy");
     test_manager_register_test(freelist_should_allocate_one_and_free_one, "Freelist allocate and free one entry.");
@@ -418,4 +559,8 @@ void freelist_register_tests(void) {
     test_manager_register_test(freelist_should_allocate_one_and_free_multi_varying_sizes, "Freelist allocate and free multiple entries of varying sizes.");
     test_manager_register_test(freelist_should_allocate_to_full_and_fail_to_allocate_more, "Freelist allocate to full and fail when trying to allocate more.");
     test_manager_register_test(freelist_multiple_alloc_and_free_random, "Freelist should randomly allocate and free.");
+    test_manager_register_test(freelist_tlsf_should_allocate_free_and_merge, "TLSF freelist allocate, free and merge entries.");
+    test_manager_register_test(freelist_tlsf_should_allocate_to_full_and_fail_to_allocate_more, "TLSF freelist allocate to full and fail when trying to allocate more.");
+    test_manager_register_test(freelist_tlsf_should_resize_and_report_fragmentation, "TLSF freelist resize and report fragmentation.");
+    test_manager_register_test(freelist_tlsf_multiple_alloc_and_free_random, "TLSF freelist should randomly allocate and free.");
 }
@@ -0,0 +1,257 @@
+#include "hashmap_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/hashmap.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+
+// String keys are copied into memory from the memory system, so it must be running.
+static void memory_begin(void) {
+    memory_system_configuration config = {0};
+    config.total_alloc_size = MEBIBYTES(16);
+    memory_system_initialize(config);
+}
+
+static void memory_end(void) {
+    memory_system_shutdown(0);
+}
+
+static void* create_map(hashmap_key_type key_type, u64 element_size, u32 max_entry_count, u64* memory_requirement, hashmap* out_map) {
+    hashmap_create(key_type, element_size, max_entry_count, memory_requirement, 0, 0);
+    void* memory = kallocate(*memory_requirement, MEMORY_TAG_ENGINE);
+    hashmap_create(key_type, element_size, max_entry_count, memory_requirement, memory, out_map);
+    return memory;
+}
+
+u8 hashmap_should_create_and_destroy(void) {
+    memory_begin();
+    hashmap map;
+    u64 memory_requirement = 0;
+    expect_to_be_true(hashmap_create(HASHMAP_KEY_TYPE_STRING, sizeof(u64), 7, &memory_requirement, 0, 0));
+    expect_should_not_be(0, memory_requirement);
+
+    void* memory = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    expect_to_be_true(hashmap_create(HASHMAP_KEY_TYPE_STRING, sizeof(u64), 7, &memory_requirement, memory, &map));
+    expect_should_be(memory, map.memory);
+    expect_should_be(sizeof(u64), map.element_size);
+    expect_should_be(7, map.max_entry_count);
+    expect_should_be(0, map.count);
+    // Capacity is a power of 2 that keeps the map at or below 7/8 full.
+    expect_should_be(8, map.capacity);
+
+    hashmap_destroy(&map);
+    expect_should_be(0, map.memory);
+    expect_should_be(0, map.capacity);
+
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_set_get_and_overwrite(void) {
+    memory_begin();
+    hashmap map;
+    u64 memory_requirement = 0;
+    void* memory = create_map(HASHMAP_KEY_TYPE_STRING, sizeof(u64), 16, &memory_requirement, &map);
+
+    u64 value = 23;
+    expect_to_be_true(hashmap_set(&map, "test1", &value));
+    value = 0;
+    expect_to_be_true(hashmap_get(&map, "test1", &value));
+    expect_should_be(23, value);
+
+    // Overwriting should not add another entry.
+    value = 42;
+    expect_to_be_true(hashmap_set(&map, "test1", &value));
+    expect_should_be(1, map.count);
+    value = 0;
+    expect_to_be_true(hashmap_get(&map, "test1", &value));
+    expect_should_be(42, value);
+
+    // Non-existent entries should not be found, and should leave the output untouched.
+    value = 99;
+    expect_to_be_false(hashmap_get(&map, "test2", &value));
+    expect_should_be(99, value);
+
+    // The map should hold its own copy of the key.
+    char key[16];
+    string_ncopy(key, "temp", 16);
+    expect_to_be_true(hashmap_set(&map, key, &value));
+    string_ncopy(key, "xxxx", 16);
+    expect_to_be_true(hashmap_get(&map, "temp", 0));
+    expect_to_be_false(hashmap_get(&map, "xxxx", 0));
+
+    hashmap_destroy(&map);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_keep_colliding_keys_separate(void) {
+    memory_begin();
+    hashmap map;
+    const u32 max_count = 700;
+    u64 memory_requirement = 0;
+    void* memory = create_map(HASHMAP_KEY_TYPE_STRING, sizeof(u32), max_count, &memory_requirement, &map);
+
+    // Fill the map completely, which forces many probe collisions.
+    char key[32];
+    for (u32 i = 0; i < max_count; ++i) {
+        string_format(key, "entry_%u", i);
+        expect_to_be_true(hashmap_set(&map, key, &i));
+    }
+    expect_should_be(max_count, map.count);
+
+    for (u32 i = 0; i < max_count; ++i) {
+        string_format(key, "entry_%u", i);
+        u32 value = INVALID_ID;
+        expect_to_be_true(hashmap_get(&map, key, &value));
+        expect_should_be(i, value);
+    }
+
+    // The map is full, so new keys should be rejected, but existing ones may still be updated.
+    u32 value = 0;
+    expect_to_be_false(hashmap_set(&map, "one_too_many", &value));
+    expect_to_be_true(hashmap_set(&map, "entry_0", &value));
+    expect_should_be(max_count, map.count);
+
+    hashmap_destroy(&map);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_remove_entries(void) {
+    memory_begin();
+    hashmap map;
+    const u32 max_count = 256;
+    u64 memory_requirement = 0;
+    void* memory = create_map(HASHMAP_KEY_TYPE_STRING, sizeof(u32), max_count, &memory_requirement, &map);
+
+    char key[32];
+    for (u32 i = 0; i < max_count; ++i) {
+        string_format(key, "entry_%u", i);
+        hashmap_set(&map, key, &i);
+    }
+
+    // Remove every other entry.
+    for (u32 i = 0; i < max_count; i += 2) {
+        string_format(key, "entry_%u", i);
+        expect_to_be_true(hashmap_remove(&map, key));
+    }
+    expect_should_be(max_count / 2, map.count);
+    expect_to_be_false(hashmap_remove(&map, "entry_0"));
+
+    // Remaining entries should be unaffected by the removals.
+    for (u32 i = 0; i < max_count; ++i) {
+        string_format(key, "entry_%u", i);
+        u32 value = INVALID_ID;
+        b8 found = hashmap_get(&map, key, &value);
+        if (i % 2) {
+            expect_to_be_true(found);
+            expect_should_be(i, value);
+        } else {
+            expect_to_be_false(found);
+        }
+    }
+
+    // Freed slots should be reusable.
+    for (u32 i = 0; i < max_count; i += 2) {
+        string_format(key, "again_%u", i);
+        expect_to_be_true(hashmap_set(&map, key, &i));
+    }
+    expect_should_be(max_count, map.count);
+
+    hashmap_clear(&map);
+    expect_should_be(0, map.count);
+    expect_to_be_false(hashmap_get(&map, "entry_1", 0));
+
+    hashmap_destroy(&map);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_set_get_and_remove_u64_keys(void) {
+    memory_begin();
+    hashmap map;
+    const u32 max_count = 512;
+    u64 memory_requirement = 0;
+    void* memory = create_map(HASHMAP_KEY_TYPE_U64, sizeof(u64), max_count, &memory_requirement, &map);
+
+    // Sequential ids, as well as keys that are the same modulo the capacity.
+    for (u64 i = 0; i < max_count; ++i) {
+        u64 key = (i % 2) ? i : (i << 32);
+        u64 value = i * 3;
+        expect_to_be_true(hashmap_set_u64(&map, key, &value));
+    }
+    for (u64 i = 0; i < max_count; ++i) {
+        u64 key = (i % 2) ? i : (i << 32);
+        u64 value = 0;
+        expect_to_be_true(hashmap_get_u64(&map, key, &value));
+        expect_should_be(i * 3, value);
+    }
+
+    expect_to_be_true(hashmap_remove_u64(&map, 5));
+    expect_to_be_false(hashmap_get_u64(&map, 5, 0));
+    expect_should_be(max_count - 1, map.count);
+
+    // String functions should not work on a u64 map.
+    u64 value = 0;
+    expect_to_be_false(hashmap_set(&map, "test", &value));
+
+    hashmap_destroy(&map);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_use_precomputed_hash(void) {
+    memory_begin();
+    hashmap map;
+    u64 memory_requirement = 0;
+    void* memory = create_map(HASHMAP_KEY_TYPE_STRING, sizeof(u64), 16, &memory_requirement, &map);
+
+    const char* key = "precomputed";
+    u64 hash = hashmap_hash_string(key);
+    expect_should_not_be(0, hash);
+
+    u64 value = 77;
+    expect_to_be_true(hashmap_set_hashed(&map, hash, key, &value));
+    value = 0;
+    // Both the hashed and non-hashed functions should find the entry.
+    expect_to_be_true(hashmap_get(&map, key, &value));
+    expect_should_be(77, value);
+    value = 0;
+    expect_to_be_true(hashmap_get_hashed(&map, hash, key, &value));
+    expect_should_be(77, value);
+    expect_to_be_true(hashmap_remove_hashed(&map, hash, key));
+    expect_should_be(0, map.count);
+
+    hashmap_destroy(&map);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    memory_end();
+    return true;
+}
+
+u8 hashmap_should_hash_strings_case_insensitively(void) {
+    // The case-insensitive hash of a string matches the plain hash of its lowercase form.
+    expect_should_be(hashmap_hash_string("kvar_set_int"), hashmap_hash_stringi("KVar_Set_INT"));
+    expect_should_be(hashmap_hash_stringi("vsync"), hashmap_hash_stringi("VSYNC"));
+    expect_should_not_be(hashmap_hash_stringi("vsync"), hashmap_hash_stringi("vsynd"));
+    // Characters other than letters are left alone.
+    expect_should_not_be(hashmap_hash_stringi("a_b"), hashmap_hash_stringi("a b"));
+    return true;
+}
+
+void hashmap_register_tests(void) {
+    test_manager_register_test(hashmap_should_create_and_destroy, "Hashmap should create and destroy");
+    test_manager_register_test(hashmap_should_set_get_and_overwrite, "Hashmap should set, get and overwrite entries");
+    test_manager_register_test(hashmap_should_keep_colliding_keys_separate, "Hashmap should keep colliding keys separate when full");
+    test_manager_register_test(hashmap_should_remove_entries, "Hashmap should remove entries and reuse their slots");
+    test_manager_register_test(hashmap_should_set_get_and_remove_u64_keys, "Hashmap should set, get and remove u64 keys");
+    test_manager_register_test(hashmap_should_use_precomputed_hash, "Hashmap should use precomputed hashes");
+    test_manager_register_test(hashmap_should_hash_strings_case_insensitively, "Hashmap should hash strings case-insensitively");
+}
@@ -0,0 +1,241 @@
+#include "loose_tree_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/darray.h>
+#include <containers/loose_tree.h>
+#include <core/kmemory.h>
+#include <math/kmath.h>
+
+#define ITEM_COUNT 500
+
+typedef struct found_items {
+    // The number of times each item was found, indexed by user data.
+    u32 counts[ITEM_COUNT];
+    u32 total;
+} found_items;
+
+static b8 item_found(u32 handle, u64 user_data, void* context) {
+    found_items* found = context;
+    found->counts[user_data]++;
+    found->total++;
+    return true;
+}
+
+// A small deterministic generator, so failures are reproducible.
+static f32 random_range(u32* seed, f32 min, f32 max) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return min + (max - min) * ((*seed >> 8) / 16777216.0f);
+}
+
+static extents_3d random_bounds(u32* seed, f32 range, f32 max_size) {
+    vec3 center = {random_range(seed, -range, range), random_range(seed, -range, range), random_range(seed, -range, range)};
+    vec3 extents = {random_range(seed, 0.0f, max_size), random_range(seed, 0.0f, max_size), random_range(seed, 0.0f, max_size)};
+    return (extents_3d){vec3_sub(center, extents), vec3_add(center, extents)};
+}
+
+static b8 bounds_overlap(extents_3d a, extents_3d b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+u8 loose_tree_should_create_and_destroy(void) {
+    loose_tree tree;
+    expect_to_be_true(loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), 100.0f, 6, &tree));
+    expect_should_be(0, tree.item_count);
+    expect_should_be(1, darray_length(tree.nodes));
+    expect_should_be(6, tree.max_depth);
+
+    // Depth is clamped, and the size must be positive.
+    loose_tree clamped;
+    expect_to_be_true(loose_tree_create(LOOSE_TREE_TYPE_QUADTREE, vec3_zero(), 100.0f, 100, &clamped));
+    expect_should_be(LOOSE_TREE_MAX_DEPTH, clamped.max_depth);
+    loose_tree_destroy(&clamped);
+    expect_to_be_false(loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), 0.0f, 6, &clamped));
+
+    loose_tree_destroy(&tree);
+    expect_should_be(0, tree.nodes);
+    expect_should_be(0, tree.items);
+    return true;
+}
+
+u8 loose_tree_should_find_items_in_region(void) {
+    loose_tree tree;
+    loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), 100.0f, 8, &tree);
+    extents_3d bounds[ITEM_COUNT];
+    u32 seed = 1;
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        bounds[i] = random_bounds(&seed, 100.0f, 5.0f);
+        expect_should_not_be(INVALID_ID, loose_tree_insert(&tree, bounds[i], i));
+    }
+    expect_should_be(ITEM_COUNT, tree.item_count);
+    // Small items should have been spread out into deeper nodes.
+    expect_to_be_true((darray_length(tree.nodes) > 8));
+
+    for (u32 q = 0; q < 20; ++q) {
+        extents_3d region = random_bounds(&seed, 100.0f, 30.0f);
+        found_items found = {0};
+        loose_tree_query_region(&tree, region, item_found, &found);
+        for (u32 i = 0; i < ITEM_COUNT; ++i) {
+            expect_should_be((bounds_overlap(bounds[i], region) ? 1 : 0), found.counts[i]);
+        }
+    }
+
+    loose_tree_destroy(&tree);
+    return true;
+}
+
+u8 loose_tree_should_find_items_in_sphere_and_frustum(void) {
+    loose_tree tree;
+    loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), 100.0f, 8, &tree);
+    extents_3d bounds[ITEM_COUNT];
+    u32 seed = 2;
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        // Some items lie outside the tree, and must be found regardless.
+        bounds[i] = random_bounds(&seed, 150.0f, 5.0f);
+        loose_tree_insert(&tree, bounds[i], i);
+    }
+
+    for (u32 q = 0; q < 20; ++q) {
+        vec3 center = {random_range(&seed, -120.0f, 120.0f), random_range(&seed, -120.0f, 120.0f), random_range(&seed, -120.0f, 120.0f)};
+        f32 radius = random_range(&seed, 1.0f, 40.0f);
+        found_items found = {0};
+        loose_tree_query_sphere(&tree, center, radius, item_found, &found);
+        for (u32 i = 0; i < ITEM_COUNT; ++i) {
+            vec3 closest = {KMAX(bounds[i].min.x, KMIN(center.x, bounds[i].max.x)), KMAX(bounds[i].min.y, KMIN(center.y, bounds[i].max.y)), KMAX(bounds[i].min.z, KMIN(center.z, bounds[i].max.z))};
+            expect_should_be((vec3_distance_squared(closest, center) <= radius * radius ? 1 : 0), found.counts[i]);
+        }
+
+        vec3 forward = vec3_normalized((vec3){random_range(&seed, -1.0f, 1.0f), random_range(&seed, -0.5f, 0.5f), random_range(&seed, -1.0f, 1.0f)});
+        vec3 right = vec3_normalized(vec3_cross(forward, vec3_up()));
+        vec3 up = vec3_cross(right, forward);
+        frustum f = frustum_create(&center, &forward, &right, &up, 1.5f, deg_to_rad(60.0f), 0.1f, 150.0f);
+        kzero_memory(&found, sizeof(found_items));
+        loose_tree_query_frustum(&tree, &f, item_found, &found);
+        for (u32 i = 0; i < ITEM_COUNT; ++i) {
+            vec3 item_center = vec3_mul_scalar(vec3_add(bounds[i].min, bounds[i].max), 0.5f);
+            vec3 item_extents = vec3_mul_scalar(vec3_sub(bounds[i].max, bounds[i].min), 0.5f);
+            expect_should_be((frustum_intersects_aabb(&f, &item_center, &item_extents) ? 1 : 0), found.counts[i]);
+        }
+    }
+
+    loose_tree_destroy(&tree);
+    return true;
+}
+
+u8 loose_tree_should_move_and_remove_items(void) {
+    loose_tree tree;
+    loose_tree_create(LOOSE_TREE_TYPE_OCTREE, vec3_zero(), 100.0f, 8, &tree);
+    extents_3d bounds[ITEM_COUNT];
+    u32 handles[ITEM_COUNT];
+    u32 seed = 3;
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        bounds[i] = random_bounds(&seed, 100.0f, 5.0f);
+        handles[i] = loose_tree_insert(&tree, bounds[i], i);
+    }
+
+    // Move every other item, and remove every third.
+    b8 removed[ITEM_COUNT] = {0};
+    for (u32 i = 0; i < ITEM_COUNT; i += 2) {
+        bounds[i] = random_bounds(&seed, 100.0f, 20.0f);
+        expect_to_be_true(loose_tree_move(&tree, handles[i], bounds[i]));
+    }
+    for (u32 i = 0; i < ITEM_COUNT; i += 3) {
+        expect_to_be_true(loose_tree_remove(&tree, handles[i]));
+        removed[i] = true;
+    }
+    // A removed handle is no longer valid.
+    expect_to_be_false(loose_tree_remove(&tree, handles[0]));
+    expect_to_be_false(loose_tree_move(&tree, handles[0], bounds[0]));
+
+    extents_3d everything = {{-200.0f, -200.0f, -200.0f}, {200.0f, 200.0f, 200.0f}};
+    found_items found = {0};
+    loose_tree_query_region(&tree, everything, item_found, &found);
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        expect_should_be((removed[i] ? 0 : 1), found.counts[i]);
+    }
+    expect_should_be(tree.item_count, found.total);
+
+    extents_3d region = {{-30.0f, -30.0f, -30.0f}, {30.0f, 30.0f, 30.0f}};
+    kzero_memory(&found, sizeof(found_items));
+    loose_tree_query_region(&tree, region, item_found, &found);
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        expect_should_be((!removed[i] && bounds_overlap(bounds[i], region) ? 1 : 0), found.counts[i]);
+    }
+
+    // Removed handles are reused, the most recent first.
+    u32 last_removed = ((ITEM_COUNT - 1) / 3) * 3;
+    u32 handle = loose_tree_insert(&tree, bounds[0], 0);
+    expect_should_be(handles[last_removed], handle);
+
+    // Once empty, all nodes but the root are released.
+    loose_tree_remove(&tree, handle);
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        if (!removed[i]) {
+            loose_tree_remove(&tree, handles[i]);
+        }
+    }
+    expect_should_be(0, tree.item_count);
+    for (u32 i = 0; i < 8; ++i) {
+        expect_should_be(INVALID_ID, tree.nodes[0].children[i]);
+    }
+
+    loose_tree_destroy(&tree);
+    return true;
+}
+
+u8 loose_tree_quadtree_should_ignore_height(void) {
+    loose_tree tree;
+    loose_tree_create(LOOSE_TREE_TYPE_QUADTREE, vec3_zero(), 100.0f, 8, &tree);
+    extents_3d bounds[ITEM_COUNT];
+    u32 seed = 4;
+    for (u32 i = 0; i < ITEM_COUNT; ++i) {
+        bounds[i] = random_bounds(&seed, 100.0f, 5.0f);
+        // Heights far beyond the size of the tree still divide by X and Z.
+        bounds[i].min.y *= 50.0f;
+        bounds[i].max.y *= 50.0f;
+        loose_tree_insert(&tree, bounds[i], i);
+    }
+    // Only the first four children are used.
+    for (u32 i = 4; i < 8; ++i) {
+        expect_should_be(INVALID_ID, tree.nodes[0].children[i]);
+    }
+    expect_to_be_true((darray_length(tree.nodes) > 4));
+
+    for (u32 q = 0; q < 20; ++q) {
+        extents_3d region = random_bounds(&seed, 100.0f, 30.0f);
+        region.min.y *= 50.0f;
+        region.max.y *= 50.0f;
+        found_items found = {0};
+        loose_tree_query_region(&tree, region, item_found, &found);
+        for (u32 i = 0; i < ITEM_COUNT; ++i) {
+            expect_should_be((bounds_overlap(bounds[i], region) ? 1 : 0), found.counts[i]);
+        }
+
+        // Looking down at the ground.
+        vec3 position = {random_range(&seed, -100.0f, 100.0f), 3000.0f, random_range(&seed, -100.0f, 100.0f)};
+        vec3 forward = vec3_down();
+        vec3 right = vec3_right();
+        vec3 up = vec3_cross(right, forward);
+        frustum f = frustum_create(&position, &forward, &right, &up, 1.0f, deg_to_rad(2.0f), 0.1f, 6000.0f);
+        kzero_memory(&found, sizeof(found_items));
+        loose_tree_query_frustum(&tree, &f, item_found, &found);
+        for (u32 i = 0; i < ITEM_COUNT; ++i) {
+            vec3 item_center = vec3_mul_scalar(vec3_add(bounds[i].min, bounds[i].max), 0.5f);
+            vec3 item_extents = vec3_mul_scalar(vec3_sub(bounds[i].max, bounds[i].min), 0.5f);
+            expect_should_be((frustum_intersects_aabb(&f, &item_center, &item_extents) ? 1 : 0), found.counts[i]);
+        }
+    }
+
+    loose_tree_destroy(&tree);
+    return true;
+}
+
+void loose_tree_register_tests(void) {
+    test_manager_register_test(loose_tree_should_create_and_destroy, "Loose tree should create and destroy");
+    test_manager_register_test(loose_tree_should_find_items_in_region, "Loose tree should find items in a region");
+    test_manager_register_test(loose_tree_should_find_items_in_sphere_and_frustum, "Loose tree should find items in a sphere and frustum");
+    test_manager_register_test(loose_tree_should_move_and_remove_items, "Loose tree should move and remove items");
+    test_manager_register_test(loose_tree_quadtree_should_ignore_height, "Loose quadtree should divide along X and Z only");
+}
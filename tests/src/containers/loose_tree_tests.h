@@ -0,0 +1,3 @@
+#pragma once
+
+void loose_tree_register_tests(void);
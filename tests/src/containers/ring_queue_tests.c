@@ -0,0 +1,74 @@
+#include "ring_queue_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/ring_queue.h>
+
+u8 spsc_ring_queue_should_enqueue_and_dequeue_in_order(void) {
+    spsc_ring_queue queue;
+    // Rounded up to a power of 2.
+    expect_to_be_true(spsc_ring_queue_create(sizeof(u32), 6, &queue));
+    expect_should_be(7, queue.mask);
+
+    u32 value = 0;
+    expect_to_be_false(spsc_ring_queue_dequeue(&queue, &value));
+
+    // Several laps around the ring, filling it each time.
+    u32 next_in = 0, next_out = 0;
+    for (u32 lap = 0; lap < 5; ++lap) {
+        while (spsc_ring_queue_enqueue(&queue, &next_in)) {
+            next_in++;
+        }
+        expect_should_be(8, next_in - next_out);
+        while (spsc_ring_queue_dequeue(&queue, &value)) {
+            expect_should_be(next_out, value);
+            next_out++;
+        }
+        expect_should_be(next_in, next_out);
+    }
+
+    spsc_ring_queue_destroy(&queue);
+    expect_should_be(0, queue.block);
+    return true;
+}
+
+u8 mpmc_ring_queue_should_enqueue_and_dequeue_in_order(void) {
+    mpmc_ring_queue queue;
+    expect_to_be_true(mpmc_ring_queue_create(sizeof(u64), 16, &queue));
+    expect_should_be(15, queue.mask);
+
+    u64 value = 0;
+    expect_to_be_false(mpmc_ring_queue_dequeue(&queue, &value));
+
+    u64 next_in = 0, next_out = 0;
+    for (u32 lap = 0; lap < 5; ++lap) {
+        // Interleave, leaving the queue partly full between laps.
+        for (u32 i = 0; i < 12; ++i) {
+            expect_to_be_true(mpmc_ring_queue_enqueue(&queue, &next_in));
+            next_in++;
+        }
+        expect_should_be(12, mpmc_ring_queue_length(&queue));
+        for (u32 i = 0; i < 12; ++i) {
+            expect_to_be_true(mpmc_ring_queue_dequeue(&queue, &value));
+            expect_should_be(next_out, value);
+            next_out++;
+        }
+    }
+
+    // Exactly the capacity fits.
+    for (u32 i = 0; i < 16; ++i) {
+        expect_to_be_true(mpmc_ring_queue_enqueue(&queue, &next_in));
+    }
+    expect_to_be_false(mpmc_ring_queue_enqueue(&queue, &next_in));
+    expect_should_be(16, mpmc_ring_queue_length(&queue));
+
+    mpmc_ring_queue_destroy(&queue);
+    expect_should_be(0, queue.block);
+    return true;
+}
+
+void ring_queue_register_tests(void) {
+    test_manager_register_test(spsc_ring_queue_should_enqueue_and_dequeue_in_order, "SPSC ring queue should enqueue and dequeue in order");
+    test_manager_register_test(mpmc_ring_queue_should_enqueue_and_dequeue_in_order, "MPMC ring queue should enqueue and dequeue in order");
+}
@@ -0,0 +1,88 @@
+#include "slot_map_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/slot_map.h>
+
+typedef struct test_item {
+    u32 value;
+    u32 padding;
+} test_item;
+
+u8 slot_map_should_insert_get_and_remove(void) {
+    slot_map map;
+    expect_to_be_true(slot_map_create(sizeof(test_item), 4, 0, &map));
+
+    slot_map_handle handles[4];
+    for (u32 i = 0; i < 4; ++i) {
+        test_item* item = 0;
+        handles[i] = slot_map_insert(&map, (void**)&item);
+        expect_should_not_be(SLOT_MAP_INVALID_HANDLE, handles[i]);
+        expect_should_be(i, slot_map_handle_index(handles[i]));
+        item->value = i * 10;
+    }
+    expect_should_be(4, map.count);
+
+    // Full.
+    expect_should_be(SLOT_MAP_INVALID_HANDLE, slot_map_insert(&map, 0));
+
+    test_item* item = slot_map_get(&map, handles[2]);
+    expect_should_be(20, item->value);
+
+    // Removing makes the handle stale, and frees the slot for the next insert.
+    expect_to_be_true(slot_map_remove(&map, handles[1]));
+    expect_should_be(0, slot_map_get(&map, handles[1]));
+    expect_to_be_false(slot_map_remove(&map, handles[1]));
+    expect_should_be(SLOT_MAP_INVALID_HANDLE, slot_map_handle_get(&map, 1));
+    expect_should_be(3, map.count);
+
+    slot_map_handle reused = slot_map_insert(&map, (void**)&item);
+    expect_should_be(1, slot_map_handle_index(reused));
+    expect_should_not_be(handles[1], reused);
+    expect_should_be(0, item->value);
+    expect_should_be(reused, slot_map_handle_get(&map, 1));
+    expect_should_be(0, slot_map_get(&map, handles[1]));
+
+    // Other elements never moved.
+    item = slot_map_get(&map, handles[3]);
+    expect_should_be(30, item->value);
+
+    slot_map_destroy(&map);
+    return true;
+}
+
+u8 slot_map_should_iterate_occupied_slots(void) {
+    slot_map map;
+    expect_to_be_true(slot_map_create(sizeof(test_item), 16, 0, &map));
+
+    slot_map_handle handles[16];
+    for (u32 i = 0; i < 16; ++i) {
+        test_item* item = 0;
+        handles[i] = slot_map_insert(&map, (void**)&item);
+        item->value = i;
+    }
+    // Remove the odd ones.
+    for (u32 i = 1; i < 16; i += 2) {
+        expect_to_be_true(slot_map_remove(&map, handles[i]));
+    }
+    expect_should_be(8, map.count);
+
+    // Each even element is visited exactly once.
+    u32 seen = 0;
+    for (u32 i = 0; i < map.count; ++i) {
+        test_item* item = slot_map_dense_get(&map, i);
+        expect_should_be(0, item->value % 2);
+        seen |= 1u << item->value;
+    }
+    expect_should_be(0x5555, seen);
+    expect_should_be(0, slot_map_dense_get(&map, map.count));
+
+    slot_map_destroy(&map);
+    return true;
+}
+
+void slot_map_register_tests(void) {
+    test_manager_register_test(slot_map_should_insert_get_and_remove, "Slot map should insert, get and remove with generation-checked handles");
+    test_manager_register_test(slot_map_should_iterate_occupied_slots, "Slot map should iterate only occupied slots");
+}
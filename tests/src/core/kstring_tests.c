@@ -0,0 +1,168 @@
+#include "kstring_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <stdint.h>
+#include <core/kstring.h>
+
+u8 kstring_should_parse_signed_integers(void) {
+    i32 i = 0;
+    expect_to_be_true(string_to_i32("42", &i));
+    expect_should_be(42, i);
+    expect_to_be_true(string_to_i32("-42", &i));
+    expect_should_be(-42, i);
+    expect_to_be_true(string_to_i32("+7", &i));
+    expect_should_be(7, i);
+    // Leading whitespace is skipped.
+    expect_to_be_true(string_to_i32("  \t13", &i));
+    expect_should_be(13, i);
+
+    // The limits of the type parse, anything beyond them does not.
+    expect_to_be_true(string_to_i32("2147483647", &i));
+    expect_should_be(2147483647, i);
+    expect_to_be_true(string_to_i32("-2147483648", &i));
+    expect_should_be(-2147483647 - 1, i);
+    expect_to_be_false(string_to_i32("2147483648", &i));
+    expect_should_be(0, i);
+    expect_to_be_false(string_to_i32("-2147483649", &i));
+
+    i64 l = 0;
+    expect_to_be_true(string_to_i64("-9223372036854775808", &l));
+    expect_to_be_true((l == INT64_MIN));
+    expect_to_be_false(string_to_i64("9223372036854775808", &l));
+    expect_to_be_false(string_to_i64("99999999999999999999", &l));
+    return true;
+}
+
+u8 kstring_should_parse_unsigned_integers(void) {
+    u32 u = 0;
+    expect_to_be_true(string_to_u32("4294967295", &u));
+    expect_to_be_true((u == 4294967295u));
+    expect_to_be_false(string_to_u32("4294967296", &u));
+    expect_should_be(0, u);
+    expect_to_be_true(string_to_u32("+3", &u));
+    expect_should_be(3, u);
+    // Unsigned types take no minus sign.
+    expect_to_be_false(string_to_u32("-3", &u));
+
+    u64 l = 0;
+    expect_to_be_true(string_to_u64("18446744073709551615", &l));
+    expect_to_be_true((l == UINT64_MAX));
+    expect_to_be_false(string_to_u64("18446744073709551616", &l));
+
+    u8 b = 0;
+    expect_to_be_true(string_to_u8("255", &b));
+    expect_should_be(255, b);
+    expect_to_be_false(string_to_u8("256", &b));
+    return true;
+}
+
+u8 kstring_should_parse_hex_integers(void) {
+    i32 i = 0;
+    expect_to_be_true(string_to_i32("0x1F", &i));
+    expect_should_be(31, i);
+    expect_to_be_true(string_to_i32("-0x10", &i));
+    expect_should_be(-16, i);
+    expect_to_be_false(string_to_i32("0x80000000", &i));
+
+    u32 u = 0;
+    expect_to_be_true(string_to_u32("0xffffffff", &u));
+    expect_to_be_true((u == 0xffffffffu));
+    expect_to_be_false(string_to_u32("0x100000000", &u));
+
+    // With no digits after it, the prefix is just a zero followed by other text.
+    expect_to_be_true(string_to_u32("0x", &u));
+    expect_should_be(0, u);
+    expect_to_be_true(string_to_u32("0xg", &u));
+    expect_should_be(0, u);
+    return true;
+}
+
+u8 kstring_should_parse_floats(void) {
+    f32 f = 0;
+    expect_to_be_true(string_to_f32("1.5", &f));
+    expect_float_to_be(1.5f, f);
+    expect_to_be_true(string_to_f32("-2.5e3", &f));
+    expect_float_to_be(-2500.0f, f);
+    expect_to_be_true(string_to_f32(".25", &f));
+    expect_float_to_be(0.25f, f);
+    expect_to_be_true(string_to_f32("3.", &f));
+    expect_float_to_be(3.0f, f);
+    expect_to_be_true(string_to_f32("+1E-2", &f));
+    expect_float_to_be(0.01f, f);
+    // A bare exponent marker is not part of the number.
+    expect_to_be_true(string_to_f32("4e", &f));
+    expect_float_to_be(4.0f, f);
+
+    f64 d = 0;
+    // More digits than the fast path handles are still rounded correctly.
+    expect_to_be_true(string_to_f64("3.14159265358979323846264338327950288", &d));
+    expect_to_be_true((d == 3.141592653589793));
+    expect_to_be_true(string_to_f64("1e300", &d));
+    expect_to_be_true((d == 1e300));
+    expect_to_be_true(string_to_f64("-0", &d));
+    expect_to_be_true((d == 0.0));
+
+    // Infinity and NaN are spelled out, in any case.
+    expect_to_be_true(string_to_f64("inf", &d));
+    expect_to_be_true((d > 1e308));
+    expect_to_be_true(string_to_f64("-Infinity", &d));
+    expect_to_be_true((d < -1e308));
+    expect_to_be_true(string_to_f32("NaN", &f));
+    expect_to_be_true((f != f));
+    return true;
+}
+
+u8 kstring_should_stop_at_a_garbage_suffix(void) {
+    // As with sscanf before, the number at the start is taken and the rest is left alone.
+    i32 i = 0;
+    expect_to_be_true(string_to_i32("12abc", &i));
+    expect_should_be(12, i);
+    f32 f = 0;
+    expect_to_be_true(string_to_f32("1.5px", &f));
+    expect_float_to_be(1.5f, f);
+
+    // The cursor-style parsers report where the number ended.
+    const char* str = "10 -20 junk";
+    i64 value = 0;
+    const char* next = string_parse_i64(str, &value);
+    expect_to_be_true((next == str + 2));
+    expect_should_be(10, value);
+    next = string_parse_i64(next, &value);
+    expect_to_be_true((next == str + 6));
+    expect_should_be(-20, value);
+    expect_to_be_true((string_parse_i64(next, &value) == 0));
+    return true;
+}
+
+u8 kstring_should_reject_empty_and_non_numeric_strings(void) {
+    i32 i = 5;
+    expect_to_be_false(string_to_i32("", &i));
+    expect_should_be(0, i);
+    expect_to_be_false(string_to_i32("   ", &i));
+    expect_to_be_false(string_to_i32("abc", &i));
+    expect_to_be_false(string_to_i32("-", &i));
+    expect_to_be_false(string_to_i32(0, &i));
+
+    u64 u = 0;
+    expect_to_be_false(string_to_u64("", &u));
+    expect_to_be_false(string_to_u64("+", &u));
+
+    f32 f = 5.0f;
+    expect_to_be_false(string_to_f32("", &f));
+    expect_float_to_be(0.0f, f);
+    expect_to_be_false(string_to_f32(".", &f));
+    expect_to_be_false(string_to_f32("e5", &f));
+    expect_to_be_false(string_to_f32("-", &f));
+    return true;
+}
+
+void kstring_register_tests(void) {
+    test_manager_register_test(kstring_should_parse_signed_integers, "kstring should parse signed integers within range");
+    test_manager_register_test(kstring_should_parse_unsigned_integers, "kstring should parse unsigned integers within range");
+    test_manager_register_test(kstring_should_parse_hex_integers, "kstring should parse hexadecimal integers");
+    test_manager_register_test(kstring_should_parse_floats, "kstring should parse floats, infinity and NaN");
+    test_manager_register_test(kstring_should_stop_at_a_garbage_suffix, "kstring should parse the number before a garbage suffix");
+    test_manager_register_test(kstring_should_reject_empty_and_non_numeric_strings, "kstring should reject empty and non-numeric strings");
+}
@@ -2,8 +2,16 @@
 
 #include "memory/linear_allocator_tests.h"
 #include "containers/hashtable_tests.h"
+#include "containers/hashmap_tests.h"
 #include "containers/freelist_tests.h"
+#include "containers/loose_tree_tests.h"
+#include "containers/darray_tests.h"
+#include "containers/ring_queue_tests.h"
+#include "containers/slot_map_tests.h"
 #include "memory/dynamic_allocator_tests.h"
+#include "memory/pool_allocator_tests.h"
+#include "core/kstring_tests.h"
+#include "utils/ksort_tests.h"
 
 #include <core/logger.h>
 
@@ -14,8 +22,16 @@ int main(void) {
     // TODO: add test registrations here.
     linear_allocator_register_tests();
     hashtable_register_tests();
+    hashmap_register_tests();
     freelist_register_tests();
+    loose_tree_register_tests();
+    darray_register_tests();
+    ring_queue_register_tests();
+    slot_map_register_tests();
     dynamic_allocator_register_tests();
+    pool_allocator_register_tests();
+    kstring_register_tests();
+    ksort_register_tests();
 
     KDEBUG("Starting tests...");
 
@@ -687,6 +687,53 @@ u8 dynamic_allocator_multiple_alloc_and_free_aligned_different_alignments_random
     return true;
 }
 
+u8 dynamic_allocator_reallocate_in_place_and_moved(void) {
+    dynamic_allocator alloc;
+    u64 memory_requirement = 0;
+    b8 result = dynamic_allocator_create(4096, &memory_requirement, 0, 0);
+    expect_to_be_true(result);
+    void* memory = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    result = dynamic_allocator_create(4096, &memory_requirement, memory, &alloc);
+    expect_to_be_true(result);
+
+    u8* block = dynamic_allocator_allocate_aligned(&alloc, 64, 16);
+    expect_should_not_be(0, block);
+    for (u32 i = 0; i < 64; ++i) {
+        block[i] = (u8)i;
+    }
+
+    // Nothing follows it yet, so it grows in place and shrinks in place.
+    u8* grown = dynamic_allocator_reallocate(&alloc, block, 512);
+    expect_should_be(block, grown);
+    u8* shrunk = dynamic_allocator_reallocate(&alloc, grown, 128);
+    expect_should_be(block, shrunk);
+
+    // Once something follows it, growing moves it, keeping its contents and alignment.
+    void* blocker = dynamic_allocator_allocate_aligned(&alloc, 64, 1);
+    expect_should_not_be(0, blocker);
+    u8* moved = dynamic_allocator_reallocate(&alloc, shrunk, 1024);
+    expect_should_not_be(0, moved);
+    expect_should_not_be(block, moved);
+    u64 size = 0;
+    u16 alignment = 0;
+    dynamic_allocator_get_size_alignment(moved, &size, &alignment);
+    expect_should_be(1024, size);
+    expect_should_be(16, alignment);
+    expect_should_be(0, (u64)moved % 16);
+    for (u32 i = 0; i < 64; ++i) {
+        expect_should_be(i, moved[i]);
+    }
+
+    // Everything can still be freed, leaving all the space free.
+    expect_to_be_true(dynamic_allocator_free_aligned(&alloc, moved));
+    expect_to_be_true(dynamic_allocator_free_aligned(&alloc, blocker));
+    expect_should_be(4096, dynamic_allocator_free_space(&alloc));
+
+    dynamic_allocator_destroy(&alloc);
+    kfree(memory, memory_requirement, MEMORY_TAG_ENGINE);
+    return true;
+}
+
 void dynamic_allocator_register_tests(void) {
     test_manager_register_test(dynamic_allocator_should_create_and_destroy, "Dynamic allocator should create and destroy");
     test_manager_register_test(dynamic_allocator_single_allocation_all_space, "Dynamic allocator single alloc for all space");
@@ -697,4 +744,5 @@ void dynamic_allocator_register_tests(void) {
     test_manager_register_test(dynamic_allocator_multiple_alloc_aligned_different_alignments, "Dynamic allocator multiple aligned allocations with different alignments");
     test_manager_register_test(dynamic_allocator_multiple_alloc_aligned_different_alignments_random, "Dynamic allocator multiple aligned allocations with different alignments in random order.");
     test_manager_register_test(dynamic_allocator_multiple_alloc_and_free_aligned_different_alignments_random, "Dynamic allocator randomization test.");
+    test_manager_register_test(dynamic_allocator_reallocate_in_place_and_moved, "Dynamic allocator reallocates in place, or moves when it must");
 }
@@ -108,10 +108,66 @@ u8 linear_allocator_multi_allocation_all_space_then_free(void) {
     return true;
 }
 
+u8 linear_allocator_reserved_commits_on_demand(void) {
+    linear_allocator alloc;
+    expect_to_be_true(linear_allocator_create_reserved(MEBIBYTES(16), false, &alloc));
+    expect_should_be(0, alloc.committed);
+
+    // Allocations commit only as far as they reach, and the memory is writable.
+    u8* block = linear_allocator_allocate(&alloc, KIBIBYTES(100));
+    expect_should_not_be(0, block);
+    expect_should_be(LINEAR_ALLOCATOR_COMMIT_GRANULARITY * 2, alloc.committed);
+    block[KIBIBYTES(100) - 1] = 1;
+
+    block = linear_allocator_allocate(&alloc, MEBIBYTES(16) - KIBIBYTES(100));
+    expect_should_not_be(0, block);
+    expect_should_be(MEBIBYTES(16), alloc.committed);
+    block[MEBIBYTES(16) - KIBIBYTES(100) - 1] = 1;
+
+    // Trimming after a reset keeps only what is asked for.
+    linear_allocator_free_all(&alloc, false);
+    linear_allocator_trim(&alloc, KIBIBYTES(1));
+    expect_should_be(LINEAR_ALLOCATOR_COMMIT_GRANULARITY, alloc.committed);
+
+    linear_allocator_destroy(&alloc);
+    expect_should_be(0, alloc.memory);
+
+    return true;
+}
+
+u8 linear_allocator_free_to_marker_nested(void) {
+    linear_allocator alloc;
+    linear_allocator_create(KIBIBYTES(4), 0, &alloc);
+
+    void* outer = linear_allocator_allocate(&alloc, 100);
+    expect_should_not_be(0, outer);
+    u64 outer_marker = linear_allocator_marker_get(&alloc);
+    expect_should_be(100, outer_marker);
+
+    linear_allocator_allocate(&alloc, 200);
+    u64 inner_marker = linear_allocator_marker_get(&alloc);
+    linear_allocator_allocate(&alloc, 300);
+
+    // Inner scopes are freed first, then outer ones, leaving what came before alone.
+    linear_allocator_free_to_marker(&alloc, inner_marker);
+    expect_should_be(300, alloc.allocated);
+    linear_allocator_free_to_marker(&alloc, outer_marker);
+    expect_should_be(100, alloc.allocated);
+
+    // Space freed to a marker is reused.
+    void* reused = linear_allocator_allocate(&alloc, 50);
+    expect_should_be((u8*)outer + 100, reused);
+
+    linear_allocator_destroy(&alloc);
+    return true;
+}
+
 void linear_allocator_register_tests(void) {
     test_manager_register_test(linear_allocator_should_create_and_destroy, "Linear allocator should create and destroy");
     test_manager_register_test(linear_allocator_single_allocation_all_space, "Linear allocator single alloc for all space");
     test_manager_register_test(linear_allocator_multi_allocation_all_space, "Linear allocator multi alloc for all space");
     test_manager_register_test(linear_allocator_multi_allocation_over_allocate, "Linear allocator try over allocate");
     test_manager_register_test(linear_allocator_multi_allocation_all_space_then_free, "Linear allocator allocated should be 0 after free_all");
+    test_manager_register_test(linear_allocator_reserved_commits_on_demand, "Linear allocator reserved commits on demand");
+    test_manager_register_test(linear_allocator_free_to_marker_nested, "Linear allocator frees to nested markers");
 }
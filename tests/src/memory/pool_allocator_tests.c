@@ -0,0 +1,130 @@
+#include "pool_allocator_tests.h"
+
+#include <core/kmemory.h>
+#include <defines.h>
+#include <memory/pool_allocator.h>
+
+#include "../expect.h"
+#include "../test_manager.h"
+
+u8 pool_allocator_should_create_and_destroy(void) {
+    pool_allocator alloc;
+    expect_to_be_true(pool_allocator_create(sizeof(u32), 16, 0, MEMORY_TAG_UNKNOWN, false, &alloc));
+
+    expect_should_not_be(0, alloc.memory);
+    // Rounded up to hold the free list link.
+    expect_should_be(sizeof(u64), alloc.block_size);
+    expect_should_be(16, alloc.block_count);
+    expect_should_be(16, pool_allocator_free_count(&alloc));
+
+    pool_allocator_destroy(&alloc);
+
+    expect_should_be(0, alloc.memory);
+    expect_should_be(0, alloc.block_count);
+
+    return true;
+}
+
+u8 pool_allocator_multi_allocation_all_space(void) {
+    const u32 block_count = 64;
+    pool_allocator alloc;
+    expect_to_be_true(pool_allocator_create(24, block_count, 0, MEMORY_TAG_UNKNOWN, false, &alloc));
+
+    void* blocks[64];
+    for (u32 i = 0; i < block_count; ++i) {
+        blocks[i] = pool_allocator_allocate(&alloc);
+        expect_should_not_be(0, blocks[i]);
+        expect_should_be(block_count - (i + 1), pool_allocator_free_count(&alloc));
+        // Make sure blocks do not overlap.
+        kset_memory(blocks[i], (i32)i, 24);
+    }
+    for (u32 i = 0; i < block_count; ++i) {
+        expect_should_be(i, ((u8*)blocks[i])[23]);
+    }
+
+    KDEBUG("Note: The pool is intentionally exhausted by this test.");
+    expect_should_be(0, pool_allocator_allocate(&alloc));
+
+    pool_allocator_destroy(&alloc);
+
+    return true;
+}
+
+u8 pool_allocator_free_and_reallocate(void) {
+    const u32 block_count = 8;
+    pool_allocator alloc;
+    expect_to_be_true(pool_allocator_create(32, block_count, 0, MEMORY_TAG_UNKNOWN, true, &alloc));
+
+    void* blocks[8];
+    for (u32 i = 0; i < block_count; ++i) {
+        blocks[i] = pool_allocator_allocate(&alloc);
+        expect_should_not_be(0, blocks[i]);
+    }
+    expect_should_be(0, pool_allocator_free_count(&alloc));
+
+    // Free a couple, then allocating again should hand the same blocks back.
+    expect_to_be_true(pool_allocator_free(&alloc, blocks[3]));
+    expect_to_be_true(pool_allocator_free(&alloc, blocks[5]));
+    expect_should_be(2, pool_allocator_free_count(&alloc));
+
+    void* a = pool_allocator_allocate(&alloc);
+    void* b = pool_allocator_allocate(&alloc);
+    expect_to_be_true((a == blocks[3] && b == blocks[5]) || (a == blocks[5] && b == blocks[3]));
+    expect_should_be(0, pool_allocator_allocate(&alloc));
+
+    pool_allocator_destroy(&alloc);
+
+    return true;
+}
+
+u8 pool_allocator_free_invalid_block(void) {
+    pool_allocator alloc;
+    expect_to_be_true(pool_allocator_create(16, 4, 0, MEMORY_TAG_UNKNOWN, false, &alloc));
+
+    u8* block = pool_allocator_allocate(&alloc);
+    expect_should_not_be(0, block);
+
+    KDEBUG("Note: The following errors are intentionally caused by this test.");
+    u64 outside = 0;
+    expect_to_be_false(pool_allocator_free(&alloc, &outside));
+    expect_to_be_false(pool_allocator_free(&alloc, block + 1));
+    expect_should_be(3, pool_allocator_free_count(&alloc));
+
+    pool_allocator_destroy(&alloc);
+
+    return true;
+}
+
+u8 pool_allocator_provided_memory_free_all(void) {
+    const u32 block_count = 10;
+    u64 requirement = pool_allocator_memory_requirement(12, block_count);
+    expect_should_be(16 * block_count, requirement);
+    void* memory = kallocate(requirement, MEMORY_TAG_UNKNOWN);
+
+    pool_allocator alloc;
+    expect_to_be_true(pool_allocator_create(12, block_count, memory, MEMORY_TAG_UNKNOWN, false, &alloc));
+    expect_should_be(memory, alloc.memory);
+    expect_to_be_false(alloc.owns_memory);
+
+    for (u32 i = 0; i < block_count; ++i) {
+        expect_should_not_be(0, pool_allocator_allocate(&alloc));
+    }
+    expect_should_be(0, pool_allocator_free_count(&alloc));
+
+    pool_allocator_free_all(&alloc, true);
+    expect_should_be(block_count, pool_allocator_free_count(&alloc));
+    expect_should_be(memory, pool_allocator_allocate(&alloc));
+
+    pool_allocator_destroy(&alloc);
+    kfree(memory, requirement, MEMORY_TAG_UNKNOWN);
+
+    return true;
+}
+
+void pool_allocator_register_tests(void) {
+    test_manager_register_test(pool_allocator_should_create_and_destroy, "Pool allocator should create and destroy");
+    test_manager_register_test(pool_allocator_multi_allocation_all_space, "Pool allocator multi alloc for all space");
+    test_manager_register_test(pool_allocator_free_and_reallocate, "Pool allocator reuses freed blocks");
+    test_manager_register_test(pool_allocator_free_invalid_block, "Pool allocator rejects foreign blocks");
+    test_manager_register_test(pool_allocator_provided_memory_free_all, "Pool allocator with provided memory free_all");
+}
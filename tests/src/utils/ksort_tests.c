@@ -0,0 +1,193 @@
+#include "ksort_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <core/kmemory.h>
+#include <utils/ksort.h>
+
+// The reference sort.
+#include <stdlib.h>
+
+typedef enum sort_input_pattern {
+    SORT_INPUT_RANDOM,
+    SORT_INPUT_SORTED,
+    SORT_INPUT_REVERSE,
+    // Only a handful of distinct values, so most compare equal.
+    SORT_INPUT_DUPLICATES,
+    SORT_INPUT_PATTERN_COUNT
+} sort_input_pattern;
+
+// The sizes cover the empty and one element cases, the serial path, and parallel sorts where the
+// last run comes out shorter than the rest.
+static const u32 sort_sizes[] = {
+    0,
+    1,
+    2,
+    100,
+    KSORT_PARALLEL_MIN_COUNT - 1,
+    KSORT_PARALLEL_MIN_COUNT,
+    KSORT_PARALLEL_MIN_COUNT + 1,
+    KSORT_PARALLEL_MIN_COUNT + KSORT_PARALLEL_MIN_RUN_LENGTH / 2,
+    10000,
+    KSORT_PARALLEL_MIN_RUN_LENGTH * KSORT_PARALLEL_MAX_RUNS * 2 + 7,
+};
+
+static u64 sort_test_random(u64* state) {
+    // xorshift64
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static u64 sort_input_value(sort_input_pattern pattern, u32 index, u32 count, u64* state) {
+    switch (pattern) {
+        case SORT_INPUT_SORTED:
+            return index;
+        case SORT_INPUT_REVERSE:
+            return count - index;
+        case SORT_INPUT_DUPLICATES:
+            return sort_test_random(state) % 7;
+        case SORT_INPUT_RANDOM:
+        default:
+            return sort_test_random(state);
+    }
+}
+
+static i32 compare_i32(void* a, void* b) {
+    i32 x = *(i32*)a;
+    i32 y = *(i32*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static int reference_compare_i32(const void* a, const void* b) {
+    return compare_i32((void*)a, (void*)b);
+}
+
+typedef struct sort_test_record {
+    u64 key;
+    u32 value;
+} sort_test_record;
+
+// Ties are broken by the value, which holds the original index, so this gives the stable order.
+static int reference_compare_record(const void* a, const void* b) {
+    const sort_test_record* x = a;
+    const sort_test_record* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return x->value < y->value ? -1 : (x->value > y->value ? 1 : 0);
+}
+
+u8 kparallel_sort_should_match_reference_sort(void) {
+    u64 state = 0x9E3779B97F4A7C15ull;
+    for (u32 s = 0; s < sizeof(sort_sizes) / sizeof(sort_sizes[0]); ++s) {
+        u32 count = sort_sizes[s];
+        u64 size = sizeof(i32) * KMAX(count, 1);
+        i32* data = kallocate(size, MEMORY_TAG_ARRAY);
+        i32* expected = kallocate(size, MEMORY_TAG_ARRAY);
+
+        for (u32 p = 0; p < SORT_INPUT_PATTERN_COUNT; ++p) {
+            for (u32 i = 0; i < count; ++i) {
+                // Negative values too, to catch unsigned comparisons.
+                data[i] = (i32)(sort_input_value(p, i, count, &state) - (u64)count / 2);
+            }
+            kcopy_memory(expected, data, sizeof(i32) * count);
+            qsort(expected, count, sizeof(i32), reference_compare_i32);
+
+            kparallel_sort(sizeof(i32), data, count, compare_i32);
+            for (u32 i = 0; i < count; ++i) {
+                expect_should_be(expected[i], data[i]);
+            }
+        }
+
+        kfree(data, size, MEMORY_TAG_ARRAY);
+        kfree(expected, size, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+u8 kradix_sort_u32_should_match_stable_reference_sort(void) {
+    u64 state = 0x2545F4914F6CDD1Dull;
+    for (u32 s = 0; s < sizeof(sort_sizes) / sizeof(sort_sizes[0]); ++s) {
+        u32 count = sort_sizes[s];
+        u32 alloc_count = KMAX(count, 1);
+        u32* keys = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        u32* values = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        u32* scratch_keys = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        u32* scratch_values = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        sort_test_record* expected = kallocate(sizeof(sort_test_record) * alloc_count, MEMORY_TAG_ARRAY);
+
+        for (u32 p = 0; p < SORT_INPUT_PATTERN_COUNT; ++p) {
+            for (u32 i = 0; i < count; ++i) {
+                keys[i] = (u32)sort_input_value(p, i, count, &state);
+                values[i] = i;
+                expected[i].key = keys[i];
+                expected[i].value = i;
+            }
+            qsort(expected, count, sizeof(sort_test_record), reference_compare_record);
+
+            kradix_sort_u32(count, keys, values, scratch_keys, scratch_values);
+            for (u32 i = 0; i < count; ++i) {
+                expect_should_be(expected[i].key, keys[i]);
+                expect_should_be(expected[i].value, values[i]);
+            }
+        }
+
+        kfree(keys, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(values, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(scratch_keys, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(scratch_values, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(expected, sizeof(sort_test_record) * alloc_count, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+u8 kradix_sort_u64_should_match_stable_reference_sort(void) {
+    u64 state = 0xD1B54A32D192ED03ull;
+    for (u32 s = 0; s < sizeof(sort_sizes) / sizeof(sort_sizes[0]); ++s) {
+        u32 count = sort_sizes[s];
+        u32 alloc_count = KMAX(count, 1);
+        u64* keys = kallocate(sizeof(u64) * alloc_count, MEMORY_TAG_ARRAY);
+        u32* values = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        u64* scratch_keys = kallocate(sizeof(u64) * alloc_count, MEMORY_TAG_ARRAY);
+        u32* scratch_values = kallocate(sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        sort_test_record* expected = kallocate(sizeof(sort_test_record) * alloc_count, MEMORY_TAG_ARRAY);
+
+        for (u32 p = 0; p < SORT_INPUT_PATTERN_COUNT; ++p) {
+            for (u32 i = 0; i < count; ++i) {
+                keys[i] = sort_input_value(p, i, count, &state);
+                // Set the top byte too, so every pass does some work.
+                if (p != SORT_INPUT_DUPLICATES) {
+                    keys[i] |= (u64)(i & 0x3) << 62;
+                }
+                values[i] = i;
+                expected[i].key = keys[i];
+                expected[i].value = i;
+            }
+            qsort(expected, count, sizeof(sort_test_record), reference_compare_record);
+
+            kradix_sort_u64(count, keys, values, scratch_keys, scratch_values);
+            for (u32 i = 0; i < count; ++i) {
+                expect_should_be(expected[i].key, keys[i]);
+                expect_should_be(expected[i].value, values[i]);
+            }
+        }
+
+        kfree(keys, sizeof(u64) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(values, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(scratch_keys, sizeof(u64) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(scratch_values, sizeof(u32) * alloc_count, MEMORY_TAG_ARRAY);
+        kfree(expected, sizeof(sort_test_record) * alloc_count, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+void ksort_register_tests(void) {
+    test_manager_register_test(kparallel_sort_should_match_reference_sort, "kparallel_sort should match a reference sort");
+    test_manager_register_test(kradix_sort_u32_should_match_stable_reference_sort, "kradix_sort_u32 should match a stable reference sort");
+    test_manager_register_test(kradix_sort_u64_should_match_stable_reference_sort, "kradix_sort_u64 should match a stable reference sort");
+}
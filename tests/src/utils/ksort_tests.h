@@ -0,0 +1,3 @@
+#pragma once
+
+void ksort_register_tests(void);
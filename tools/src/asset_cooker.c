@@ -0,0 +1,499 @@
+#include "asset_cooker.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/kthread.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <platform/platform.h>
+#include <resources/loaders/mesh_loader.h>
+
+#include "kbt_baker.h"
+#include "kpak_packer.h"
+#include "shader_builder.h"
+
+#define DEFAULT_IN_DIRECTORY "assets"
+#define DEFAULT_CACHE_PATH "assets.cookcache"
+#define MAX_JOB_COUNT 64
+#define PATH_MAX_LENGTH 512
+// Hashed ahead of every source. Bump it when cooked output changes, so everything is cooked again.
+#define COOK_VERSION 1
+
+// The source image extensions baked to .kbt, as looked for by the image loader.
+static const char* image_extensions[] = {".tga", ".png", ".jpg", ".bmp"};
+
+typedef enum cook_kind {
+    COOK_KIND_TEXTURE,
+    COOK_KIND_MESH
+} cook_kind;
+
+// A single asset to be cooked.
+typedef struct cook_job {
+    char source_path[PATH_MAX_LENGTH];
+    char output_path[PATH_MAX_LENGTH];
+    cook_kind kind;
+    // Hash of the source and the files it depends on.
+    u64 hash;
+    // Set if the output is out of date.
+    b8 cook;
+    b8 succeeded;
+} cook_job;
+
+// A source hash from a previous cook.
+typedef struct cook_cache_entry {
+    char* source_path;
+    u64 hash;
+} cook_cache_entry;
+
+// What the walk of the asset directory finds.
+typedef struct cook_gather {
+    cook_job* jobs;
+    // darray of the shader configs, built together by the shader builder.
+    char** shader_configs;
+} cook_gather;
+
+// A thread cooking every job_stride'th job, starting at first_job.
+typedef struct cook_worker {
+    cook_job* jobs;
+    u32 first_job;
+    u32 job_stride;
+    // Where the materials of imported meshes are written, ending in a separator.
+    const char* material_directory;
+    kthread thread;
+} cook_worker;
+
+static b8 arg_value_get(const char* arg, const char* key, const char** out_value) {
+    u64 key_length = string_length(key);
+    if (string_length(arg) > key_length && strings_nequali(arg, key, key_length)) {
+        *out_value = arg + key_length;
+        return true;
+    }
+    return false;
+}
+
+static b8 ends_with(const char* str, const char* suffix) {
+    u64 length = string_length(str);
+    u64 suffix_length = string_length(suffix);
+    return length >= suffix_length && strings_equali(str + length - suffix_length, suffix);
+}
+
+// FNV-1a, continued from the given hash.
+static u64 hash_bytes(u64 hash, const void* data, u64 size) {
+    const u8* bytes = data;
+    for (u64 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static b8 read_bytes(const char* path, u8** out_data, u64* out_size) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        return false;
+    }
+    u64 size = 0;
+    b8 result = filesystem_size(&f, &size);
+    *out_data = 0;
+    *out_size = 0;
+    if (result && size) {
+        *out_data = kallocate(size, MEMORY_TAG_ARRAY);
+        u64 read = 0;
+        result = filesystem_read_all_bytes(&f, *out_data, &read);
+        if (result) {
+            *out_size = size;
+        } else {
+            kfree(*out_data, size, MEMORY_TAG_ARRAY);
+            *out_data = 0;
+        }
+    }
+    filesystem_close(&f);
+    return result;
+}
+
+// Hashes the file at the given path by name and content. A missing file is still hashed by name,
+// so its dependents are cooked again once it appears.
+static u64 hash_file(u64 hash, const char* path, u8** out_data, u64* out_size) {
+    hash = hash_bytes(hash, path, string_length(path));
+    u8* data = 0;
+    u64 size = 0;
+    if (read_bytes(path, &data, &size)) {
+        hash = hash_bytes(hash, data, size);
+    }
+    if (out_data) {
+        *out_data = data;
+        *out_size = size;
+    } else if (data) {
+        kfree(data, size, MEMORY_TAG_ARRAY);
+    }
+    return hash;
+}
+
+// Hashes the material libraries an obj file names with mtllib, which sit next to it.
+static u64 hash_obj_dependencies(u64 hash, const char* obj_path, const u8* data, u64 size) {
+    char directory[PATH_MAX_LENGTH] = {0};
+    string_directory_from_path(directory, obj_path);
+
+    u64 line_start = 0;
+    while (line_start < size) {
+        u64 line_end = line_start;
+        while (line_end < size && data[line_end] != '\n') {
+            line_end++;
+        }
+        u64 length = line_end - line_start;
+        if (length > 7 && strings_nequal((const char*)data + line_start, "mtllib ", 7)) {
+            char name[PATH_MAX_LENGTH] = {0};
+            string_ncopy(name, (const char*)data + line_start + 7, KMIN(length - 7, PATH_MAX_LENGTH - 1));
+            char path[PATH_MAX_LENGTH * 2];
+            string_format(path, "%s%s", directory, string_trim(name));
+            hash = hash_file(hash, path, 0, 0);
+        }
+        line_start = line_end + 1;
+    }
+    return hash;
+}
+
+static b8 job_hash(cook_job* job) {
+    u32 version = COOK_VERSION;
+    u64 hash = hash_bytes(0xcbf29ce484222325ULL, &version, sizeof(u32));
+    hash = hash_bytes(hash, &job->kind, sizeof(cook_kind));
+    if (job->kind == COOK_KIND_MESH) {
+        u8* data = 0;
+        u64 size = 0;
+        hash = hash_file(hash, job->source_path, &data, &size);
+        if (!data) {
+            KERROR("Unable to read mesh '%s'.", job->source_path);
+            return false;
+        }
+        hash = hash_obj_dependencies(hash, job->source_path, data, size);
+        kfree(data, size, MEMORY_TAG_ARRAY);
+    } else {
+        hash = hash_file(hash, job->source_path, 0, 0);
+    }
+    job->hash = hash;
+    return true;
+}
+
+static void job_add(cook_job** jobs, const char* path, cook_kind kind, const char* output_extension) {
+    cook_job job = {0};
+    string_ncopy(job.source_path, path, PATH_MAX_LENGTH - 1);
+    char stem[PATH_MAX_LENGTH] = {0};
+    string_ncopy(stem, path, PATH_MAX_LENGTH - 1);
+    char* dot = stem + string_length(stem);
+    while (dot > stem && *dot != '.') {
+        dot--;
+    }
+    *dot = 0;
+    string_format(job.output_path, "%s%s", stem, output_extension);
+    job.kind = kind;
+    darray_push(*jobs, job);
+}
+
+// Sorts the files of the asset directory into what each is cooked by, going by where they sit.
+static void cook_file_visit(const char* path, const char* name, void* user_data) {
+    cook_gather* gather = user_data;
+    if (strings_nequali(name, "textures/", 9)) {
+        u32 count = sizeof(image_extensions) / sizeof(image_extensions[0]);
+        for (u32 i = 0; i < count; ++i) {
+            if (ends_with(name, image_extensions[i])) {
+                job_add(&gather->jobs, path, COOK_KIND_TEXTURE, ".kbt");
+                return;
+            }
+        }
+    } else if (strings_nequali(name, "models/", 7) && ends_with(name, ".obj")) {
+        job_add(&gather->jobs, path, COOK_KIND_MESH, ".ksm");
+    } else if (strings_nequali(name, "shaders/", 8) && ends_with(name, ".shadercfg")) {
+        char* config_path = string_duplicate(path);
+        darray_push(gather->shader_configs, config_path);
+    }
+}
+
+static b8 cache_load(const char* path, cook_cache_entry** entries) {
+    if (!filesystem_exists(path)) {
+        return true;
+    }
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, false, &f)) {
+        KERROR("Unable to open cook cache '%s'.", path);
+        return false;
+    }
+    // Each line is: hash source_path
+    char line_buf[PATH_MAX_LENGTH + 32] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    while (filesystem_read_line(&f, sizeof(line_buf) - 1, &p, &line_length)) {
+        char* trimmed = string_trim(line_buf);
+        i32 space_index = string_index_of(trimmed, ' ');
+        if (space_index <= 0) {
+            continue;
+        }
+        trimmed[space_index] = 0;
+        cook_cache_entry entry;
+        if (string_to_u64(trimmed, &entry.hash)) {
+            entry.source_path = string_duplicate(string_trim(trimmed + space_index + 1));
+            darray_push(*entries, entry);
+        }
+    }
+    filesystem_close(&f);
+    return true;
+}
+
+static cook_cache_entry* cache_find(cook_cache_entry* entries, const char* source_path) {
+    u32 count = darray_length(entries);
+    for (u32 i = 0; i < count; ++i) {
+        if (strings_equal(entries[i].source_path, source_path)) {
+            return &entries[i];
+        }
+    }
+    return 0;
+}
+
+static b8 cache_write(const char* path, cook_cache_entry* entries) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to write cook cache '%s'.", path);
+        return false;
+    }
+    b8 result = true;
+    char line[PATH_MAX_LENGTH + 32];
+    u32 count = darray_length(entries);
+    for (u32 i = 0; result && i < count; ++i) {
+        // Failed cooks are kept out of the cache, so they are tried again next time.
+        if (entries[i].hash) {
+            string_format(line, "%llu %s", entries[i].hash, entries[i].source_path);
+            result = filesystem_write_line(&f, line);
+        }
+    }
+    filesystem_close(&f);
+    return result;
+}
+
+static b8 job_cook(cook_job* job, const char* material_directory) {
+    switch (job->kind) {
+        case COOK_KIND_TEXTURE: {
+            // Baked with the defaults of the bake mode, which match how the engine loads images.
+            char in_arg[PATH_MAX_LENGTH + 16];
+            char out_arg[PATH_MAX_LENGTH + 16];
+            string_format(in_arg, "infile=%s", job->source_path);
+            string_format(out_arg, "outfile=%s", job->output_path);
+            char* args[] = {"tools", "bake", in_arg, out_arg};
+            return bake_texture(4, args) == 0;
+        }
+        case COOK_KIND_MESH:
+            return mesh_loader_obj_import(job->source_path, job->output_path, material_directory);
+    }
+    return false;
+}
+
+static u32 cook_worker_run(void* params) {
+    cook_worker* worker = params;
+    u32 job_count = darray_length(worker->jobs);
+    for (u32 i = worker->first_job; i < job_count; i += worker->job_stride) {
+        cook_job* job = &worker->jobs[i];
+        if (!job->cook) {
+            continue;
+        }
+        job->succeeded = job_cook(job, worker->material_directory);
+        if (job->succeeded) {
+            KINFO("Cooked '%s'.", job->source_path);
+        } else {
+            KERROR("Failed to cook '%s'.", job->source_path);
+        }
+    }
+    return 0;
+}
+
+// Cooks the out of date jobs across up to the given number of threads.
+static void jobs_cook(cook_job* jobs, u32 thread_count, u32 cook_count, const char* material_directory) {
+    u32 worker_count = KMIN(KMIN(thread_count, cook_count), MAX_JOB_COUNT);
+    cook_worker workers[MAX_JOB_COUNT] = {0};
+    for (u32 i = 0; i < worker_count; ++i) {
+        workers[i].jobs = jobs;
+        workers[i].first_job = i;
+        workers[i].job_stride = worker_count;
+        workers[i].material_directory = material_directory;
+    }
+    // When a thread can't be started, its jobs are cooked here instead.
+    for (u32 i = 1; i < worker_count; ++i) {
+        if (!kthread_create(cook_worker_run, &workers[i], false, &workers[i].thread)) {
+            cook_worker_run(&workers[i]);
+        }
+    }
+    if (worker_count) {
+        cook_worker_run(&workers[0]);
+    }
+    for (u32 i = 1; i < worker_count; ++i) {
+        kthread_wait(&workers[i].thread);
+    }
+}
+
+// Builds the shader configs with the shader builder, which keeps its own cache of compiled stages.
+static b8 shaders_build(char** config_paths, u32 job_count, b8 force) {
+    u32 config_count = darray_length(config_paths);
+    if (!config_count) {
+        return true;
+    }
+    char jobs_arg[32];
+    char force_arg[16];
+    string_format(jobs_arg, "jobs=%u", job_count);
+    string_format(force_arg, "force=%u", force ? 1 : 0);
+
+    char** args = darray_create(char*);
+    char* program_arg = "tools";
+    char* mode_arg = "shaders";
+    char* jobs_ptr = jobs_arg;
+    char* force_ptr = force_arg;
+    darray_push(args, program_arg);
+    darray_push(args, mode_arg);
+    darray_push(args, jobs_ptr);
+    darray_push(args, force_ptr);
+    for (u32 i = 0; i < config_count; ++i) {
+        darray_push(args, config_paths[i]);
+    }
+    b8 result = build_shaders((i32)darray_length(args), args) == 0;
+    darray_destroy(args);
+    return result;
+}
+
+i32 cook_assets(i32 argc, char** argv) {
+    char in_directory[PATH_MAX_LENGTH] = DEFAULT_IN_DIRECTORY;
+    char out_file_path[PATH_MAX_LENGTH] = {0};
+    const char* cache_path = DEFAULT_CACHE_PATH;
+    u32 job_count = (u32)KMAX(platform_get_processor_count(), 1);
+    b8 force = false;
+    b8 compress = true;
+    b8 pack = true;
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        const char* value = 0;
+        b8 valid = true;
+        if (arg_value_get(argv[i], "indir=", &value)) {
+            string_ncopy(in_directory, value, PATH_MAX_LENGTH - 1);
+        } else if (arg_value_get(argv[i], "outfile=", &value)) {
+            string_ncopy(out_file_path, value, PATH_MAX_LENGTH - 1);
+        } else if (arg_value_get(argv[i], "cache=", &value)) {
+            cache_path = value;
+        } else if (arg_value_get(argv[i], "jobs=", &value)) {
+            valid = string_to_u32(value, &job_count) && job_count > 0;
+        } else if (arg_value_get(argv[i], "force=", &value)) {
+            valid = string_to_bool(value, &force);
+        } else if (arg_value_get(argv[i], "compress=", &value)) {
+            valid = string_to_bool(value, &compress);
+        } else if (arg_value_get(argv[i], "pack=", &value)) {
+            valid = string_to_bool(value, &pack);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'.", argv[i]);
+            return -5;
+        }
+    }
+
+    // Paths are built with '/' separators and no trailing one.
+    u32 in_length = string_length(in_directory);
+    while (in_length > 1 && (in_directory[in_length - 1] == '/' || in_directory[in_length - 1] == '\\')) {
+        in_directory[--in_length] = 0;
+    }
+    if (out_file_path[0] == 0) {
+        string_format(out_file_path, "%s.kpak", in_directory);
+    }
+    char material_directory[PATH_MAX_LENGTH + 16];
+    string_format(material_directory, "%s/materials/", in_directory);
+
+    cook_gather gather = {0};
+    gather.jobs = darray_create(cook_job);
+    gather.shader_configs = darray_create(char*);
+    cook_cache_entry* entries = darray_create(cook_cache_entry);
+    i32 result = 0;
+
+    if (!pack_directory_walk(in_directory, "", cook_file_visit, &gather)) {
+        result = -6;
+        goto cook_assets_cleanup;
+    }
+    if (!cache_load(cache_path, &entries)) {
+        result = -7;
+        goto cook_assets_cleanup;
+    }
+
+    u32 total_count = darray_length(gather.jobs);
+    u32 cook_count = 0;
+    for (u32 i = 0; i < total_count; ++i) {
+        cook_job* job = &gather.jobs[i];
+        if (!job_hash(job)) {
+            // Unreadable sources are reported as failed cooks.
+            job->cook = true;
+            cook_count++;
+            continue;
+        }
+        cook_cache_entry* entry = cache_find(entries, job->source_path);
+        job->cook = force || !entry || entry->hash != job->hash || !filesystem_exists(job->output_path);
+        cook_count += job->cook ? 1 : 0;
+    }
+    KINFO("%u of %u assets are out of date. Cooking on %u threads.", cook_count, total_count, KMIN(job_count, KMAX(cook_count, 1)));
+
+    jobs_cook(gather.jobs, job_count, cook_count, material_directory);
+
+    u32 failed_count = 0;
+    for (u32 i = 0; i < total_count; ++i) {
+        const cook_job* job = &gather.jobs[i];
+        if (!job->cook) {
+            continue;
+        }
+        cook_cache_entry* entry = cache_find(entries, job->source_path);
+        if (!entry) {
+            cook_cache_entry new_entry = {string_duplicate(job->source_path), 0};
+            darray_push(entries, new_entry);
+            entry = &entries[darray_length(entries) - 1];
+        }
+        entry->hash = job->succeeded ? job->hash : 0;
+        failed_count += job->succeeded ? 0 : 1;
+    }
+    if (cook_count && !cache_write(cache_path, entries)) {
+        result = -9;
+        goto cook_assets_cleanup;
+    }
+    if (failed_count) {
+        KERROR("%u of %u assets failed to cook.", failed_count, cook_count);
+        result = -8;
+        goto cook_assets_cleanup;
+    }
+
+    if (!shaders_build(gather.shader_configs, job_count, force)) {
+        KERROR("Failed to build shaders.");
+        result = -10;
+        goto cook_assets_cleanup;
+    }
+
+    if (pack) {
+        // Everything is packed, sources included, as they remain the fallback of whatever asks for
+        // a form which wasn't cooked (e.g. uncompressed images).
+        char in_arg[PATH_MAX_LENGTH + 16];
+        char out_arg[PATH_MAX_LENGTH + 16];
+        char compress_arg[16];
+        string_format(in_arg, "indir=%s", in_directory);
+        string_format(out_arg, "outfile=%s", out_file_path);
+        string_format(compress_arg, "compress=%u", compress ? 1 : 0);
+        char* args[] = {"tools", "pack", in_arg, out_arg, compress_arg};
+        if (pack_assets(5, args) != 0) {
+            result = -11;
+            goto cook_assets_cleanup;
+        }
+    }
+
+    KINFO("Successfully cooked all assets.");
+
+cook_assets_cleanup:
+    for (u32 i = 0; i < darray_length(entries); ++i) {
+        string_free(entries[i].source_path);
+    }
+    darray_destroy(entries);
+    for (u32 i = 0; i < darray_length(gather.shader_configs); ++i) {
+        string_free(gather.shader_configs[i]);
+    }
+    darray_destroy(gather.shader_configs);
+    darray_destroy(gather.jobs);
+    return result;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file asset_cooker.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Cooks a directory of assets into the binary forms the engine loads, and packs them into
+ * a .kpak archive, so that no import work is left for the first run. Images in textures/ are baked
+ * to .kbt, obj meshes in models/ are imported to .ksm (with their LODs and clusters) and shader
+ * configs in shaders/ are built into .ksbundle shader bundles. A hash of each source and the files it depends
+ * on is kept in a cook cache file, and only the assets whose hash changed are cooked, in parallel.
+ * @version 1.0
+ * @date 2023-12-26
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the cook mode of the tools using the given command line arguments.
+ * Usage: tools cook [indir=assets] [outfile=[filename]] [jobs=N] [cache=[filename]] [force=1|0]
+ * [compress=1|0] [pack=1|0]
+ * Cooked files are written next to their sources, where the engine looks for them first. The
+ * archive defaults to the name of the asset directory with .kpak appended, which the engine mounts.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 cook_assets(i32 argc, char** argv);
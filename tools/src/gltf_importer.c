@@ -0,0 +1,1581 @@
+#include "gltf_importer.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <resources/resource_types.h>
+#include <resources/skeletal_mesh.h>
+
+// For parsing numbers.
+#include <stdlib.h>
+
+// The alignment in bytes of each array in a ksa file.
+#define KSA_DATA_ALIGNMENT 16
+// The deepest nesting of JSON arrays and objects parsed.
+#define JSON_MAX_DEPTH 64
+// The most frames a single clip may be resampled to.
+#define KSA_MAX_FRAME_COUNT 65536
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+#define GLTF_COMPONENT_BYTE 5120
+#define GLTF_COMPONENT_UNSIGNED_BYTE 5121
+#define GLTF_COMPONENT_SHORT 5122
+#define GLTF_COMPONENT_UNSIGNED_SHORT 5123
+#define GLTF_COMPONENT_UNSIGNED_INT 5125
+#define GLTF_COMPONENT_FLOAT 5126
+
+#define GLTF_MODE_TRIANGLES 4
+
+/* ---------------------------------------------------------------------------------------------
+ * JSON
+ *
+ * Documents are parsed into a flat array of values in document order, so the elements or
+ * members of an array or object immediately follow it, each followed by everything within it.
+ * ------------------------------------------------------------------------------------------ */
+
+typedef enum json_type {
+    JSON_TYPE_NULL,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_STRING,
+    JSON_TYPE_ARRAY,
+    JSON_TYPE_OBJECT
+} json_type;
+
+typedef struct json_value {
+    json_type type;
+    // The index just past this value and everything within it, which is that of its next sibling.
+    u32 end;
+    // The number of elements or members of an array or object.
+    u32 count;
+    // The key of a member of an object, as it appears between the quotes.
+    const char* key;
+    u32 key_length;
+    // The characters of a string, as they appear between the quotes.
+    const char* string;
+    u32 string_length;
+    f64 number;
+    b8 boolean;
+} json_value;
+
+typedef struct json_parser {
+    const char* text;
+    u64 length;
+    u64 position;
+    json_value* values;
+} json_parser;
+
+static void json_whitespace_skip(json_parser* p) {
+    while (p->position < p->length) {
+        char c = p->text[p->position];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        p->position++;
+    }
+}
+
+// Parses a string, obtaining the characters between its quotes with escapes left as-is.
+static b8 json_string_parse(json_parser* p, const char** out_string, u32* out_length) {
+    if (p->position >= p->length || p->text[p->position] != '"') {
+        return false;
+    }
+    u64 start = ++p->position;
+    while (p->position < p->length && p->text[p->position] != '"') {
+        // Skip whatever is escaped, so escaped quotes don't end the string.
+        p->position += p->text[p->position] == '\\' ? 2 : 1;
+    }
+    if (p->position >= p->length) {
+        return false;
+    }
+    *out_string = p->text + start;
+    *out_length = (u32)(p->position - start);
+    p->position++;
+    return true;
+}
+
+static b8 json_value_parse(json_parser* p, u32 depth, const char* key, u32 key_length) {
+    json_whitespace_skip(p);
+    if (p->position >= p->length || depth > JSON_MAX_DEPTH) {
+        return false;
+    }
+
+    u32 index = (u32)darray_length(p->values);
+    json_value value = {0};
+    value.key = key;
+    value.key_length = key_length;
+    darray_push(p->values, value);
+
+    const char* text = p->text + p->position;
+    u64 remaining = p->length - p->position;
+    char c = text[0];
+    if (c == '{' || c == '[') {
+        b8 is_object = c == '{';
+        char close = is_object ? '}' : ']';
+        p->values[index].type = is_object ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY;
+        p->position++;
+        json_whitespace_skip(p);
+        u32 count = 0;
+        if (p->position < p->length && p->text[p->position] == close) {
+            p->position++;
+        } else {
+            while (true) {
+                const char* member_key = 0;
+                u32 member_key_length = 0;
+                if (is_object) {
+                    json_whitespace_skip(p);
+                    if (!json_string_parse(p, &member_key, &member_key_length)) {
+                        return false;
+                    }
+                    json_whitespace_skip(p);
+                    if (p->position >= p->length || p->text[p->position] != ':') {
+                        return false;
+                    }
+                    p->position++;
+                }
+                if (!json_value_parse(p, depth + 1, member_key, member_key_length)) {
+                    return false;
+                }
+                count++;
+                json_whitespace_skip(p);
+                if (p->position >= p->length) {
+                    return false;
+                }
+                char separator = p->text[p->position++];
+                if (separator == close) {
+                    break;
+                } else if (separator != ',') {
+                    return false;
+                }
+            }
+        }
+        p->values[index].count = count;
+    } else if (c == '"') {
+        p->values[index].type = JSON_TYPE_STRING;
+        if (!json_string_parse(p, &p->values[index].string, &p->values[index].string_length)) {
+            return false;
+        }
+    } else if (remaining >= 4 && strings_nequal(text, "true", 4)) {
+        p->values[index].type = JSON_TYPE_BOOL;
+        p->values[index].boolean = true;
+        p->position += 4;
+    } else if (remaining >= 5 && strings_nequal(text, "false", 5)) {
+        p->values[index].type = JSON_TYPE_BOOL;
+        p->position += 5;
+    } else if (remaining >= 4 && strings_nequal(text, "null", 4)) {
+        p->values[index].type = JSON_TYPE_NULL;
+        p->position += 4;
+    } else {
+        // The text is terminated, so strtod can't read beyond it.
+        char* number_end = 0;
+        f64 number = strtod(text, &number_end);
+        if (number_end == text) {
+            return false;
+        }
+        p->values[index].type = JSON_TYPE_NUMBER;
+        p->values[index].number = number;
+        p->position += (u64)(number_end - text);
+    }
+
+    p->values[index].end = (u32)darray_length(p->values);
+    return true;
+}
+
+// Obtains the index of the member of an object with the given key, or INVALID_ID if it has none.
+static u32 json_member(const json_value* values, u32 object, const char* key) {
+    if (object == INVALID_ID || values[object].type != JSON_TYPE_OBJECT) {
+        return INVALID_ID;
+    }
+    u32 key_length = (u32)string_length(key);
+    u32 child = object + 1;
+    for (u32 i = 0; i < values[object].count; ++i) {
+        if (values[child].key_length == key_length && strings_nequal(values[child].key, key, key_length)) {
+            return child;
+        }
+        child = values[child].end;
+    }
+    return INVALID_ID;
+}
+
+// Obtains the index of the given element of an array, or INVALID_ID if it has none.
+static u32 json_element(const json_value* values, u32 array, u32 element) {
+    if (array == INVALID_ID || values[array].type != JSON_TYPE_ARRAY || element >= values[array].count) {
+        return INVALID_ID;
+    }
+    u32 child = array + 1;
+    for (u32 i = 0; i < element; ++i) {
+        child = values[child].end;
+    }
+    return child;
+}
+
+static u32 json_count(const json_value* values, u32 array) {
+    return (array != INVALID_ID && values[array].type == JSON_TYPE_ARRAY) ? values[array].count : 0;
+}
+
+static f64 json_number(const json_value* values, u32 index, f64 default_value) {
+    return (index != INVALID_ID && values[index].type == JSON_TYPE_NUMBER) ? values[index].number : default_value;
+}
+
+static u32 json_member_u32(const json_value* values, u32 object, const char* key, u32 default_value) {
+    f64 number = json_number(values, json_member(values, object, key), -1.0);
+    return number >= 0.0 && number < 4294967295.0 ? (u32)number : default_value;
+}
+
+// Reads up to count numbers of an array into out_numbers, leaving the rest as they are.
+static void json_numbers_read(const json_value* values, u32 array, u32 count, f32* out_numbers) {
+    u32 element_count = KMIN(json_count(values, array), count);
+    u32 child = array + 1;
+    for (u32 i = 0; i < element_count; ++i) {
+        out_numbers[i] = (f32)json_number(values, child, out_numbers[i]);
+        child = values[child].end;
+    }
+}
+
+// Copies a string, unescaping it. Escaped unicode characters outside ASCII become '_'.
+static void json_string_copy(const json_value* values, u32 index, char* out_string, u32 max_length) {
+    u32 length = 0;
+    if (index != INVALID_ID && values[index].type == JSON_TYPE_STRING) {
+        const char* s = values[index].string;
+        u32 s_length = values[index].string_length;
+        for (u32 i = 0; i < s_length && length + 1 < max_length; ++i) {
+            char c = s[i];
+            if (c == '\\' && i + 1 < s_length) {
+                char e = s[++i];
+                if (e == 'n') {
+                    c = '\n';
+                } else if (e == 't') {
+                    c = '\t';
+                } else if (e == 'r') {
+                    c = '\r';
+                } else if (e == 'b' || e == 'f') {
+                    c = ' ';
+                } else if (e == 'u') {
+                    u32 code = 0;
+                    for (u32 d = 0; d < 4 && i + 1 < s_length; ++d) {
+                        char h = s[++i];
+                        code = code * 16 + (u32)(h >= '0' && h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+                    }
+                    c = code < 128 ? (char)code : '_';
+                } else {
+                    c = e;
+                }
+            }
+            out_string[length++] = c;
+        }
+    }
+    out_string[length] = 0;
+}
+
+static b8 json_string_equals(const json_value* values, u32 index, const char* str) {
+    if (index == INVALID_ID || values[index].type != JSON_TYPE_STRING) {
+        return false;
+    }
+    u32 length = (u32)string_length(str);
+    return values[index].string_length == length && strings_nequal(values[index].string, str, length);
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * glTF
+ * ------------------------------------------------------------------------------------------ */
+
+typedef struct gltf_buffer {
+    u8* data;
+    u64 size;
+} gltf_buffer;
+
+typedef struct gltf_accessor {
+    // The first element.
+    const u8* data;
+    u32 count;
+    u32 component_type;
+    u32 component_count;
+    // The distance in bytes between elements.
+    u32 stride;
+    b8 normalized;
+} gltf_accessor;
+
+typedef enum gltf_interpolation {
+    GLTF_INTERPOLATION_LINEAR,
+    GLTF_INTERPOLATION_STEP,
+    GLTF_INTERPOLATION_CUBICSPLINE
+} gltf_interpolation;
+
+typedef struct gltf_sampler {
+    gltf_accessor input;
+    gltf_accessor output;
+    gltf_interpolation interpolation;
+} gltf_sampler;
+
+typedef struct gltf_document {
+    // A terminated copy of the JSON.
+    char* json;
+    u64 json_size;
+    json_value* values;
+    u32 root;
+    u32 nodes;
+    u32 node_count;
+    // The parent of each node, or -1 for roots.
+    i32* node_parents;
+    // A darray of the data of each buffer.
+    gltf_buffer* buffers;
+} gltf_document;
+
+static b8 file_read_all(const char* path, u8** out_data, u64* out_size) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        KERROR("Unable to open file '%s' for reading.", path);
+        return false;
+    }
+    u64 size = 0;
+    if (!filesystem_size(&f, &size)) {
+        KERROR("Unable to obtain the size of file '%s'.", path);
+        filesystem_close(&f);
+        return false;
+    }
+    // One extra byte, zeroed, so text can be used as a terminated string.
+    u8* data = kallocate(size + 1, MEMORY_TAG_ARRAY);
+    u64 read = 0;
+    b8 result = filesystem_read_all_bytes(&f, data, &read) && read == size;
+    filesystem_close(&f);
+    if (!result) {
+        KERROR("Unable to read file '%s'.", path);
+        kfree(data, size + 1, MEMORY_TAG_ARRAY);
+        return false;
+    }
+    *out_data = data;
+    *out_size = size;
+    return true;
+}
+
+static i32 base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+' || c == '-') {
+        return 62;
+    } else if (c == '/' || c == '_') {
+        return 63;
+    }
+    return -1;
+}
+
+// Decodes base64 text, ignoring padding. The result is allocated with one extra byte.
+static b8 base64_decode(const char* text, u32 length, u8** out_data, u64* out_size) {
+    u64 capacity = (u64)length * 3 / 4 + 1;
+    u8* data = kallocate(capacity + 1, MEMORY_TAG_ARRAY);
+    u64 size = 0;
+    u32 bits = 0;
+    u32 bit_count = 0;
+    for (u32 i = 0; i < length && text[i] != '='; ++i) {
+        i32 value = base64_value(text[i]);
+        if (value < 0) {
+            kfree(data, capacity + 1, MEMORY_TAG_ARRAY);
+            return false;
+        }
+        bits = (bits << 6) | (u32)value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            data[size++] = (u8)(bits >> bit_count);
+        }
+    }
+    // Shrink to fit, so the size freed later is known from the size alone.
+    u8* fitted = kallocate(size + 1, MEMORY_TAG_ARRAY);
+    kcopy_memory(fitted, data, size);
+    kfree(data, capacity + 1, MEMORY_TAG_ARRAY);
+    *out_data = fitted;
+    *out_size = size;
+    return true;
+}
+
+static void gltf_document_destroy(gltf_document* doc) {
+    if (doc->buffers) {
+        u32 buffer_count = (u32)darray_length(doc->buffers);
+        for (u32 i = 0; i < buffer_count; ++i) {
+            if (doc->buffers[i].data) {
+                kfree(doc->buffers[i].data, doc->buffers[i].size + 1, MEMORY_TAG_ARRAY);
+            }
+        }
+        darray_destroy(doc->buffers);
+    }
+    if (doc->node_parents) {
+        kfree(doc->node_parents, sizeof(i32) * KMAX(doc->node_count, 1), MEMORY_TAG_ARRAY);
+    }
+    if (doc->values) {
+        darray_destroy(doc->values);
+    }
+    if (doc->json) {
+        kfree(doc->json, doc->json_size + 1, MEMORY_TAG_ARRAY);
+    }
+    kzero_memory(doc, sizeof(gltf_document));
+}
+
+static b8 gltf_document_load(const char* path, gltf_document* out_doc) {
+    kzero_memory(out_doc, sizeof(gltf_document));
+    out_doc->buffers = darray_create(gltf_buffer);
+
+    u8* file_data = 0;
+    u64 file_size = 0;
+    if (!file_read_all(path, &file_data, &file_size)) {
+        return false;
+    }
+
+    // Binary glTF holds the JSON and the first buffer as chunks of the one file.
+    const u8* bin_chunk = 0;
+    u64 bin_chunk_size = 0;
+    u32 magic = 0;
+    if (file_size >= 12) {
+        kcopy_memory(&magic, file_data, sizeof(u32));
+    }
+    if (magic == GLB_MAGIC) {
+        u64 offset = 12;
+        while (offset + 8 <= file_size) {
+            u32 chunk_length = 0;
+            u32 chunk_type = 0;
+            kcopy_memory(&chunk_length, file_data + offset, sizeof(u32));
+            kcopy_memory(&chunk_type, file_data + offset + 4, sizeof(u32));
+            offset += 8;
+            if (chunk_length > file_size - offset) {
+                KERROR("GLB file '%s' is truncated.", path);
+                kfree(file_data, file_size + 1, MEMORY_TAG_ARRAY);
+                return false;
+            }
+            if (chunk_type == GLB_CHUNK_JSON && !out_doc->json) {
+                out_doc->json_size = chunk_length;
+                out_doc->json = kallocate(chunk_length + 1, MEMORY_TAG_ARRAY);
+                kcopy_memory(out_doc->json, file_data + offset, chunk_length);
+            } else if (chunk_type == GLB_CHUNK_BIN && !bin_chunk) {
+                bin_chunk = file_data + offset;
+                bin_chunk_size = chunk_length;
+            }
+            offset += get_aligned(chunk_length, 4);
+        }
+        if (!out_doc->json) {
+            KERROR("GLB file '%s' has no JSON chunk.", path);
+            kfree(file_data, file_size + 1, MEMORY_TAG_ARRAY);
+            return false;
+        }
+    } else {
+        // The read data is already terminated.
+        out_doc->json = (char*)file_data;
+        out_doc->json_size = file_size;
+        file_data = 0;
+    }
+
+    json_parser parser = {0};
+    parser.text = out_doc->json;
+    parser.length = out_doc->json_size;
+    parser.values = darray_create(json_value);
+    b8 parsed = json_value_parse(&parser, 0, 0, 0);
+    out_doc->values = parser.values;
+    if (!parsed || out_doc->values[0].type != JSON_TYPE_OBJECT) {
+        KERROR("glTF file '%s' has invalid JSON near byte %llu.", path, parser.position);
+        goto failed;
+    }
+    const json_value* values = out_doc->values;
+    out_doc->root = 0;
+
+    // The buffers.
+    char directory[1024] = {0};
+    string_directory_from_path(directory, path);
+    u32 buffers = json_member(values, out_doc->root, "buffers");
+    u32 buffer_count = json_count(values, buffers);
+    for (u32 i = 0; i < buffer_count; ++i) {
+        u32 buffer = json_element(values, buffers, i);
+        u32 uri = json_member(values, buffer, "uri");
+        u64 byte_length = (u64)json_number(values, json_member(values, buffer, "byteLength"), 0.0);
+        gltf_buffer b = {0};
+        if (uri == INVALID_ID) {
+            if (!bin_chunk || bin_chunk_size < byte_length) {
+                KERROR("glTF file '%s' has buffer %u without data.", path, i);
+                goto failed;
+            }
+            b.size = bin_chunk_size;
+            b.data = kallocate(b.size + 1, MEMORY_TAG_ARRAY);
+            kcopy_memory(b.data, bin_chunk, b.size);
+        } else if (values[uri].string_length > 5 && strings_nequal(values[uri].string, "data:", 5)) {
+            // Data URIs hold the buffer as base64, following the first comma.
+            const char* s = values[uri].string;
+            u32 length = values[uri].string_length;
+            u32 comma = 0;
+            while (comma < length && s[comma] != ',') {
+                comma++;
+            }
+            if (comma >= length || !base64_decode(s + comma + 1, length - comma - 1, &b.data, &b.size)) {
+                KERROR("glTF file '%s' has buffer %u with an invalid data URI.", path, i);
+                goto failed;
+            }
+        } else {
+            char file_name[512];
+            json_string_copy(values, uri, file_name, 512);
+            char buffer_path[1536];
+            string_format(buffer_path, "%s%s", directory, file_name);
+            if (!file_read_all(buffer_path, &b.data, &b.size)) {
+                goto failed;
+            }
+        }
+        if (b.size < byte_length) {
+            KERROR("glTF file '%s' has buffer %u smaller than its byte length.", path, i);
+            kfree(b.data, b.size + 1, MEMORY_TAG_ARRAY);
+            goto failed;
+        }
+        darray_push(out_doc->buffers, b);
+    }
+
+    // The parents of the nodes, which the file only records as children.
+    out_doc->nodes = json_member(values, out_doc->root, "nodes");
+    out_doc->node_count = json_count(values, out_doc->nodes);
+    out_doc->node_parents = kallocate(sizeof(i32) * KMAX(out_doc->node_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < out_doc->node_count; ++i) {
+        out_doc->node_parents[i] = -1;
+    }
+    for (u32 i = 0; i < out_doc->node_count; ++i) {
+        u32 children = json_member(values, json_element(values, out_doc->nodes, i), "children");
+        u32 child_count = json_count(values, children);
+        for (u32 c = 0; c < child_count; ++c) {
+            f64 child = json_number(values, json_element(values, children, c), -1.0);
+            if (child >= 0.0 && child < out_doc->node_count) {
+                out_doc->node_parents[(u32)child] = (i32)i;
+            }
+        }
+    }
+
+    if (file_data) {
+        kfree(file_data, file_size + 1, MEMORY_TAG_ARRAY);
+    }
+    return true;
+
+failed:
+    if (file_data) {
+        kfree(file_data, file_size + 1, MEMORY_TAG_ARRAY);
+    }
+    gltf_document_destroy(out_doc);
+    return false;
+}
+
+static u32 gltf_component_size(u32 component_type) {
+    switch (component_type) {
+        case GLTF_COMPONENT_BYTE:
+        case GLTF_COMPONENT_UNSIGNED_BYTE:
+            return 1;
+        case GLTF_COMPONENT_SHORT:
+        case GLTF_COMPONENT_UNSIGNED_SHORT:
+            return 2;
+        case GLTF_COMPONENT_UNSIGNED_INT:
+        case GLTF_COMPONENT_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static u32 gltf_type_component_count(const json_value* values, u32 type) {
+    if (json_string_equals(values, type, "SCALAR")) {
+        return 1;
+    } else if (json_string_equals(values, type, "VEC2")) {
+        return 2;
+    } else if (json_string_equals(values, type, "VEC3")) {
+        return 3;
+    } else if (json_string_equals(values, type, "VEC4") || json_string_equals(values, type, "MAT2")) {
+        return 4;
+    } else if (json_string_equals(values, type, "MAT3")) {
+        return 9;
+    } else if (json_string_equals(values, type, "MAT4")) {
+        return 16;
+    }
+    return 0;
+}
+
+// Obtains the accessor of the given index, checking that all of its data lies within its buffer.
+static b8 gltf_accessor_get(const gltf_document* doc, u32 accessor_index, gltf_accessor* out_accessor) {
+    const json_value* values = doc->values;
+    u32 accessor = json_element(values, json_member(values, doc->root, "accessors"), accessor_index);
+    if (accessor == INVALID_ID) {
+        KERROR("glTF accessor %u doesn't exist.", accessor_index);
+        return false;
+    }
+    if (json_member(values, accessor, "sparse") != INVALID_ID) {
+        KERROR("glTF accessor %u is sparse, which isn't supported.", accessor_index);
+        return false;
+    }
+
+    kzero_memory(out_accessor, sizeof(gltf_accessor));
+    out_accessor->count = json_member_u32(values, accessor, "count", 0);
+    out_accessor->component_type = json_member_u32(values, accessor, "componentType", 0);
+    out_accessor->component_count = gltf_type_component_count(values, json_member(values, accessor, "type"));
+    u32 normalized = json_member(values, accessor, "normalized");
+    out_accessor->normalized = normalized != INVALID_ID && values[normalized].type == JSON_TYPE_BOOL && values[normalized].boolean;
+    u32 component_size = gltf_component_size(out_accessor->component_type);
+    if (!component_size || !out_accessor->component_count) {
+        KERROR("glTF accessor %u has an invalid type.", accessor_index);
+        return false;
+    }
+    u32 element_size = component_size * out_accessor->component_count;
+
+    u32 view_index = json_member_u32(values, accessor, "bufferView", INVALID_ID);
+    u32 view = json_element(values, json_member(values, doc->root, "bufferViews"), view_index);
+    u32 buffer_index = json_member_u32(values, view, "buffer", INVALID_ID);
+    if (view == INVALID_ID || buffer_index >= darray_length(doc->buffers)) {
+        KERROR("glTF accessor %u has no valid buffer view.", accessor_index);
+        return false;
+    }
+    const gltf_buffer* buffer = &doc->buffers[buffer_index];
+    u64 view_offset = (u64)json_number(values, json_member(values, view, "byteOffset"), 0.0);
+    u64 view_length = (u64)json_number(values, json_member(values, view, "byteLength"), 0.0);
+    u64 accessor_offset = (u64)json_number(values, json_member(values, accessor, "byteOffset"), 0.0);
+    out_accessor->stride = json_member_u32(values, view, "byteStride", element_size);
+    if (out_accessor->stride < element_size) {
+        out_accessor->stride = element_size;
+    }
+    if (view_offset > buffer->size || view_length > buffer->size - view_offset || accessor_offset > view_length ||
+        (out_accessor->count && (u64)(out_accessor->count - 1) * out_accessor->stride + element_size > view_length - accessor_offset)) {
+        KERROR("glTF accessor %u lies outside its buffer.", accessor_index);
+        return false;
+    }
+    out_accessor->data = buffer->data + view_offset + accessor_offset;
+    return true;
+}
+
+// Reads up to count components of an element as floats, leaving any the accessor lacks as they are.
+static void gltf_accessor_read_f32(const gltf_accessor* a, u32 element, u32 count, f32* out_values) {
+    const u8* data = a->data + (u64)element * a->stride;
+    u32 n = KMIN(count, a->component_count);
+    for (u32 c = 0; c < n; ++c) {
+        f32 value = 0.0f;
+        switch (a->component_type) {
+            case GLTF_COMPONENT_FLOAT: {
+                kcopy_memory(&value, data + c * 4, 4);
+            } break;
+            case GLTF_COMPONENT_UNSIGNED_BYTE: {
+                value = a->normalized ? data[c] / 255.0f : data[c];
+            } break;
+            case GLTF_COMPONENT_BYTE: {
+                i8 v = (i8)data[c];
+                value = a->normalized ? KMAX(v / 127.0f, -1.0f) : v;
+            } break;
+            case GLTF_COMPONENT_UNSIGNED_SHORT: {
+                u16 v;
+                kcopy_memory(&v, data + c * 2, 2);
+                value = a->normalized ? v / 65535.0f : v;
+            } break;
+            case GLTF_COMPONENT_SHORT: {
+                i16 v;
+                kcopy_memory(&v, data + c * 2, 2);
+                value = a->normalized ? KMAX(v / 32767.0f, -1.0f) : v;
+            } break;
+            case GLTF_COMPONENT_UNSIGNED_INT: {
+                u32 v;
+                kcopy_memory(&v, data + c * 4, 4);
+                value = (f32)v;
+            } break;
+        }
+        out_values[c] = value;
+    }
+}
+
+// Reads a component of an element as an unsigned integer.
+static u32 gltf_accessor_read_u32(const gltf_accessor* a, u32 element, u32 component) {
+    const u8* data = a->data + (u64)element * a->stride;
+    switch (a->component_type) {
+        case GLTF_COMPONENT_UNSIGNED_BYTE:
+            return data[component];
+        case GLTF_COMPONENT_UNSIGNED_SHORT: {
+            u16 v;
+            kcopy_memory(&v, data + component * 2, 2);
+            return v;
+        }
+        case GLTF_COMPONENT_UNSIGNED_INT: {
+            u32 v;
+            kcopy_memory(&v, data + component * 4, 4);
+            return v;
+        }
+        default: {
+            f32 components[16] = {0};
+            gltf_accessor_read_f32(a, element, component + 1, components);
+            return components[component] > 0.0f ? (u32)components[component] : 0;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * Transforms, as row-vector matrices scaling, then rotating, then translating.
+ * ------------------------------------------------------------------------------------------ */
+
+static mat4 trs_to_mat4(vec3 t, quat r, vec3 s) {
+    const f32 x = r.x, y = r.y, z = r.z, w = r.w;
+    mat4 m;
+    m.data[0] = (1.0f - 2.0f * (y * y + z * z)) * s.x;
+    m.data[1] = 2.0f * (x * y + z * w) * s.x;
+    m.data[2] = 2.0f * (x * z - y * w) * s.x;
+    m.data[3] = 0.0f;
+    m.data[4] = 2.0f * (x * y - z * w) * s.y;
+    m.data[5] = (1.0f - 2.0f * (x * x + z * z)) * s.y;
+    m.data[6] = 2.0f * (y * z + x * w) * s.y;
+    m.data[7] = 0.0f;
+    m.data[8] = 2.0f * (x * z + y * w) * s.z;
+    m.data[9] = 2.0f * (y * z - x * w) * s.z;
+    m.data[10] = (1.0f - 2.0f * (x * x + y * y)) * s.z;
+    m.data[11] = 0.0f;
+    m.data[12] = t.x;
+    m.data[13] = t.y;
+    m.data[14] = t.z;
+    m.data[15] = 1.0f;
+    return m;
+}
+
+// Splits a matrix of the form made by trs_to_mat4 back into its parts. Shear is lost.
+static void mat4_to_trs(mat4 m, vec3* out_t, quat* out_r, vec3* out_s) {
+    *out_t = (vec3){m.data[12], m.data[13], m.data[14]};
+    f32 s[3];
+    for (u32 i = 0; i < 3; ++i) {
+        s[i] = ksqrt(m.data[i * 4 + 0] * m.data[i * 4 + 0] + m.data[i * 4 + 1] * m.data[i * 4 + 1] + m.data[i * 4 + 2] * m.data[i * 4 + 2]);
+        if (s[i] < K_FLOAT_EPSILON) {
+            s[i] = K_FLOAT_EPSILON;
+        }
+    }
+    // A mirrored basis is kept as a negative scale along x.
+    f32 determinant = m.data[0] * (m.data[5] * m.data[10] - m.data[6] * m.data[9]) -
+                      m.data[1] * (m.data[4] * m.data[10] - m.data[6] * m.data[8]) +
+                      m.data[2] * (m.data[4] * m.data[9] - m.data[5] * m.data[8]);
+    if (determinant < 0.0f) {
+        s[0] = -s[0];
+    }
+    *out_s = (vec3){s[0], s[1], s[2]};
+
+    // The rotation matrix, as it would be applied to column vectors.
+    f32 r[3][3];
+    for (u32 i = 0; i < 3; ++i) {
+        for (u32 k = 0; k < 3; ++k) {
+            r[k][i] = m.data[i * 4 + k] / s[i];
+        }
+    }
+    quat q;
+    f32 trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0.0f) {
+        f32 f = 0.5f / ksqrt(trace + 1.0f);
+        q.w = 0.25f / f;
+        q.x = (r[2][1] - r[1][2]) * f;
+        q.y = (r[0][2] - r[2][0]) * f;
+        q.z = (r[1][0] - r[0][1]) * f;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        f32 f = 2.0f * ksqrt(1.0f + r[0][0] - r[1][1] - r[2][2]);
+        q.w = (r[2][1] - r[1][2]) / f;
+        q.x = 0.25f * f;
+        q.y = (r[0][1] + r[1][0]) / f;
+        q.z = (r[0][2] + r[2][0]) / f;
+    } else if (r[1][1] > r[2][2]) {
+        f32 f = 2.0f * ksqrt(1.0f + r[1][1] - r[0][0] - r[2][2]);
+        q.w = (r[0][2] - r[2][0]) / f;
+        q.x = (r[0][1] + r[1][0]) / f;
+        q.y = 0.25f * f;
+        q.z = (r[1][2] + r[2][1]) / f;
+    } else {
+        f32 f = 2.0f * ksqrt(1.0f + r[2][2] - r[0][0] - r[1][1]);
+        q.w = (r[1][0] - r[0][1]) / f;
+        q.x = (r[0][2] + r[2][0]) / f;
+        q.y = (r[1][2] + r[2][1]) / f;
+        q.z = 0.25f * f;
+    }
+    *out_r = quat_normalize(q);
+}
+
+// Obtains the local transform of a node.
+static void gltf_node_trs(const gltf_document* doc, u32 node_index, vec3* out_t, quat* out_r, vec3* out_s) {
+    const json_value* values = doc->values;
+    u32 node = json_element(values, doc->nodes, node_index);
+    u32 matrix = json_member(values, node, "matrix");
+    if (matrix != INVALID_ID) {
+        // Column-major for column vectors, which is the same layout as row-major for row vectors.
+        mat4 m = mat4_identity();
+        json_numbers_read(values, matrix, 16, m.data);
+        mat4_to_trs(m, out_t, out_r, out_s);
+        return;
+    }
+    *out_t = vec3_zero();
+    *out_r = quat_identity();
+    *out_s = vec3_one();
+    json_numbers_read(values, json_member(values, node, "translation"), 3, out_t->elements);
+    json_numbers_read(values, json_member(values, node, "rotation"), 4, out_r->elements);
+    json_numbers_read(values, json_member(values, node, "scale"), 3, out_s->elements);
+    *out_r = quat_normalize(*out_r);
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * Import
+ * ------------------------------------------------------------------------------------------ */
+
+typedef struct import_joint {
+    u32 node;
+    i32 parent;
+    char name[256];
+    // The transform of any nodes between this joint and its parent joint, which aren't joints.
+    mat4 between;
+    b8 has_between;
+    vec3 rest_translation;
+    quat rest_rotation;
+    vec3 rest_scale;
+    mat4 inverse_bind_matrix;
+} import_joint;
+
+typedef struct import_clip {
+    char name[256];
+    u32 frame_count;
+    f32 duration;
+    f32 sample_rate;
+    animation_range* ranges;
+    animation_key* keys;
+} import_clip;
+
+typedef struct import_geometry {
+    char name[GEOMETRY_NAME_MAX_LENGTH];
+    char material_name[MATERIAL_NAME_MAX_LENGTH];
+    vertex_3d_skinned* vertices;
+    u32* indices;
+    vec3 min_extents;
+    vec3 max_extents;
+} import_geometry;
+
+typedef struct import_state {
+    gltf_document doc;
+    u32 skin_index;
+    u32 joint_count;
+    import_joint joints[SKELETON_MAX_JOINTS];
+    // The joint of each node, or INVALID_ID for nodes which aren't joints.
+    u32* node_joints;
+    // The joint each entry of the skin's joint list became once sorted.
+    u32 skin_joint_remap[SKELETON_MAX_JOINTS];
+    import_clip* clips;
+    import_geometry* geometries;
+} import_state;
+
+// Applies the transform of the nodes between a joint and its parent joint to a local transform.
+static void joint_transform_resolve(const import_joint* joint, vec3* t, quat* r, vec3* s) {
+    if (joint->has_between) {
+        mat4 m = mat4_mul(trs_to_mat4(*t, *r, *s), joint->between);
+        mat4_to_trs(m, t, r, s);
+    }
+}
+
+static b8 import_skeleton(import_state* state) {
+    gltf_document* doc = &state->doc;
+    const json_value* values = doc->values;
+    u32 skin = json_element(values, json_member(values, doc->root, "skins"), state->skin_index);
+    u32 skin_joints = json_member(values, skin, "joints");
+    u32 count = json_count(values, skin_joints);
+    if (!count) {
+        KERROR("glTF skin %u has no joints.", state->skin_index);
+        return false;
+    }
+    if (count > SKELETON_MAX_JOINTS) {
+        KERROR("glTF skin %u has %u joints, but at most %u are supported.", state->skin_index, count, SKELETON_MAX_JOINTS);
+        return false;
+    }
+
+    u32 joint_nodes[SKELETON_MAX_JOINTS];
+    u32 depths[SKELETON_MAX_JOINTS];
+    for (u32 i = 0; i < count; ++i) {
+        f64 node = json_number(values, json_element(values, skin_joints, i), -1.0);
+        if (node < 0.0 || node >= doc->node_count) {
+            KERROR("glTF skin %u refers to node %f, which doesn't exist.", state->skin_index, node);
+            return false;
+        }
+        joint_nodes[i] = (u32)node;
+        depths[i] = 0;
+        // Bounded, in case of cycles in an invalid file.
+        for (i32 p = doc->node_parents[joint_nodes[i]]; p >= 0 && depths[i] <= doc->node_count; p = doc->node_parents[p]) {
+            depths[i]++;
+        }
+    }
+
+    // Order the joints by depth, so every parent comes before its children.
+    u32 order[SKELETON_MAX_JOINTS];
+    for (u32 i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    for (u32 i = 1; i < count; ++i) {
+        u32 value = order[i];
+        u32 j = i;
+        while (j > 0 && depths[order[j - 1]] > depths[value]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = value;
+    }
+    state->joint_count = count;
+    for (u32 i = 0; i < count; ++i) {
+        state->skin_joint_remap[order[i]] = i;
+        state->joints[i].node = joint_nodes[order[i]];
+        state->node_joints[joint_nodes[order[i]]] = i;
+    }
+
+    gltf_accessor inverse_binds = {0};
+    b8 has_inverse_binds = false;
+    u32 inverse_binds_index = json_member_u32(values, skin, "inverseBindMatrices", INVALID_ID);
+    if (inverse_binds_index != INVALID_ID) {
+        if (!gltf_accessor_get(doc, inverse_binds_index, &inverse_binds)) {
+            return false;
+        }
+        if (inverse_binds.count < count || inverse_binds.component_count != 16) {
+            KERROR("glTF skin %u has too few inverse bind matrices.", state->skin_index);
+            return false;
+        }
+        has_inverse_binds = true;
+    }
+
+    u32 nodes = doc->nodes;
+    for (u32 i = 0; i < count; ++i) {
+        import_joint* joint = &state->joints[i];
+        json_string_copy(values, json_member(values, json_element(values, nodes, joint->node), "name"), joint->name, 256);
+
+        // Find the parent joint, gathering the transforms of any other nodes on the way.
+        joint->parent = -1;
+        joint->between = mat4_identity();
+        u32 steps = 0;
+        for (i32 p = doc->node_parents[joint->node]; p >= 0 && steps <= doc->node_count; p = doc->node_parents[p], ++steps) {
+            if (state->node_joints[p] != INVALID_ID) {
+                joint->parent = (i32)state->node_joints[p];
+                break;
+            }
+            vec3 t, s;
+            quat r;
+            gltf_node_trs(doc, (u32)p, &t, &r, &s);
+            joint->between = mat4_mul(joint->between, trs_to_mat4(t, r, s));
+            joint->has_between = true;
+        }
+
+        gltf_node_trs(doc, joint->node, &joint->rest_translation, &joint->rest_rotation, &joint->rest_scale);
+        joint_transform_resolve(joint, &joint->rest_translation, &joint->rest_rotation, &joint->rest_scale);
+
+        joint->inverse_bind_matrix = mat4_identity();
+        if (has_inverse_binds) {
+            // Column-major for column vectors, which is the same layout as row-major for row vectors.
+            gltf_accessor_read_f32(&inverse_binds, order[i], 16, joint->inverse_bind_matrix.data);
+        }
+    }
+    return true;
+}
+
+// Samples a channel at the given time.
+static void gltf_sampler_sample(const gltf_sampler* s, f32 time, u32 components, b8 is_rotation, f32* out_value) {
+    u32 key_count = s->input.count;
+    b8 cubic = s->interpolation == GLTF_INTERPOLATION_CUBICSPLINE;
+    // Cubic splines store an in-tangent, the value, then an out-tangent for each key.
+    u32 per_key = cubic ? 3 : 1;
+    u32 value_offset = cubic ? 1 : 0;
+
+    f32 first = 0.0f;
+    f32 last = 0.0f;
+    gltf_accessor_read_f32(&s->input, 0, 1, &first);
+    gltf_accessor_read_f32(&s->input, key_count - 1, 1, &last);
+    if (key_count == 1 || time <= first) {
+        gltf_accessor_read_f32(&s->output, value_offset, components, out_value);
+        return;
+    }
+    if (time >= last) {
+        gltf_accessor_read_f32(&s->output, (key_count - 1) * per_key + value_offset, components, out_value);
+        return;
+    }
+
+    // The last key at or before the time.
+    u32 low = 0;
+    u32 high = key_count - 1;
+    while (high - low > 1) {
+        u32 mid = (low + high) / 2;
+        f32 mid_time = 0.0f;
+        gltf_accessor_read_f32(&s->input, mid, 1, &mid_time);
+        if (mid_time <= time) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    f32 t0 = 0.0f;
+    f32 t1 = 0.0f;
+    gltf_accessor_read_f32(&s->input, low, 1, &t0);
+    gltf_accessor_read_f32(&s->input, high, 1, &t1);
+    f32 dt = t1 - t0;
+    f32 t = dt > 0.0f ? (time - t0) / dt : 0.0f;
+
+    f32 v0[4] = {0};
+    f32 v1[4] = {0};
+    gltf_accessor_read_f32(&s->output, low * per_key + value_offset, components, v0);
+    gltf_accessor_read_f32(&s->output, high * per_key + value_offset, components, v1);
+
+    if (s->interpolation == GLTF_INTERPOLATION_STEP) {
+        kcopy_memory(out_value, v0, sizeof(f32) * components);
+    } else if (cubic) {
+        f32 out_tangent[4] = {0};
+        f32 in_tangent[4] = {0};
+        gltf_accessor_read_f32(&s->output, low * per_key + 2, components, out_tangent);
+        gltf_accessor_read_f32(&s->output, high * per_key, components, in_tangent);
+        f32 t2 = t * t;
+        f32 t3 = t2 * t;
+        for (u32 c = 0; c < components; ++c) {
+            out_value[c] = (2.0f * t3 - 3.0f * t2 + 1.0f) * v0[c] + (t3 - 2.0f * t2 + t) * dt * out_tangent[c] +
+                           (-2.0f * t3 + 3.0f * t2) * v1[c] + (t3 - t2) * dt * in_tangent[c];
+        }
+        if (is_rotation) {
+            quat q = quat_normalize((quat){out_value[0], out_value[1], out_value[2], out_value[3]});
+            kcopy_memory(out_value, q.elements, sizeof(quat));
+        }
+    } else if (is_rotation) {
+        quat q = quat_slerp((quat){v0[0], v0[1], v0[2], v0[3]}, (quat){v1[0], v1[1], v1[2], v1[3]}, t);
+        kcopy_memory(out_value, q.elements, sizeof(quat));
+    } else {
+        for (u32 c = 0; c < components; ++c) {
+            out_value[c] = v0[c] + (v1[c] - v0[c]) * t;
+        }
+    }
+}
+
+typedef struct joint_channels {
+    // The sampler of each of translation, rotation and scale, or INVALID_ID if not animated.
+    u32 samplers[3];
+} joint_channels;
+
+static b8 import_animation(import_state* state, u32 animation_index, f32 sample_rate) {
+    gltf_document* doc = &state->doc;
+    const json_value* values = doc->values;
+    u32 animation = json_element(values, json_member(values, doc->root, "animations"), animation_index);
+    u32 samplers_array = json_member(values, animation, "samplers");
+    u32 channels = json_member(values, animation, "channels");
+    u32 sampler_count = json_count(values, samplers_array);
+    u32 channel_count = json_count(values, channels);
+
+    import_clip clip = {0};
+    json_string_copy(values, json_member(values, animation, "name"), clip.name, 256);
+    if (!clip.name[0]) {
+        string_format(clip.name, "animation_%u", animation_index);
+    }
+
+    gltf_sampler* samplers = kallocate(sizeof(gltf_sampler) * KMAX(sampler_count, 1), MEMORY_TAG_ARRAY);
+    joint_channels* joint_samplers = kallocate(sizeof(joint_channels) * state->joint_count, MEMORY_TAG_ARRAY);
+    for (u32 j = 0; j < state->joint_count; ++j) {
+        for (u32 c = 0; c < 3; ++c) {
+            joint_samplers[j].samplers[c] = INVALID_ID;
+        }
+    }
+    b8 result = false;
+
+    f32 duration = 0.0f;
+    for (u32 i = 0; i < sampler_count; ++i) {
+        u32 sampler = json_element(values, samplers_array, i);
+        gltf_sampler* s = &samplers[i];
+        if (!gltf_accessor_get(doc, json_member_u32(values, sampler, "input", INVALID_ID), &s->input) ||
+            !gltf_accessor_get(doc, json_member_u32(values, sampler, "output", INVALID_ID), &s->output)) {
+            KERROR("Animation '%s' has sampler %u with invalid data.", clip.name, i);
+            goto done;
+        }
+        u32 interpolation = json_member(values, sampler, "interpolation");
+        if (json_string_equals(values, interpolation, "STEP")) {
+            s->interpolation = GLTF_INTERPOLATION_STEP;
+        } else if (json_string_equals(values, interpolation, "CUBICSPLINE")) {
+            s->interpolation = GLTF_INTERPOLATION_CUBICSPLINE;
+        } else {
+            s->interpolation = GLTF_INTERPOLATION_LINEAR;
+        }
+        u32 per_key = s->interpolation == GLTF_INTERPOLATION_CUBICSPLINE ? 3 : 1;
+        if (!s->input.count || s->output.count < s->input.count * per_key) {
+            KERROR("Animation '%s' has sampler %u with too few keys.", clip.name, i);
+            goto done;
+        }
+        f32 last = 0.0f;
+        gltf_accessor_read_f32(&s->input, s->input.count - 1, 1, &last);
+        duration = KMAX(duration, last);
+    }
+
+    for (u32 i = 0; i < channel_count; ++i) {
+        u32 channel = json_element(values, channels, i);
+        u32 target = json_member(values, channel, "target");
+        u32 path = json_member(values, target, "path");
+        u32 node = json_member_u32(values, target, "node", INVALID_ID);
+        u32 sampler = json_member_u32(values, channel, "sampler", INVALID_ID);
+        if (node >= doc->node_count || sampler >= sampler_count || state->node_joints[node] == INVALID_ID) {
+            // Only joints are animated.
+            continue;
+        }
+        u32 slot = INVALID_ID;
+        if (json_string_equals(values, path, "translation")) {
+            slot = 0;
+        } else if (json_string_equals(values, path, "rotation")) {
+            slot = 1;
+        } else if (json_string_equals(values, path, "scale")) {
+            slot = 2;
+        }
+        if (slot != INVALID_ID) {
+            joint_samplers[state->node_joints[node]].samplers[slot] = sampler;
+        }
+    }
+
+    f32 frame_span = duration * sample_rate;
+    clip.frame_count = (u32)KMIN(kfloor(frame_span + 0.5f), (f32)(KSA_MAX_FRAME_COUNT - 1)) + 1;
+    clip.sample_rate = sample_rate;
+    clip.duration = (f32)(clip.frame_count - 1) / sample_rate;
+
+    // Sample every joint at every frame first, to find the range each covers.
+    u32 joint_count = state->joint_count;
+    u64 key_count = (u64)clip.frame_count * joint_count;
+    vec3* translations = kallocate(sizeof(vec3) * key_count, MEMORY_TAG_ARRAY);
+    quat* rotations = kallocate(sizeof(quat) * key_count, MEMORY_TAG_ARRAY);
+    vec3* scales = kallocate(sizeof(vec3) * key_count, MEMORY_TAG_ARRAY);
+    for (u32 f = 0; f < clip.frame_count; ++f) {
+        f32 time = (f32)f / sample_rate;
+        for (u32 j = 0; j < joint_count; ++j) {
+            import_joint* joint = &state->joints[j];
+            vec3 t, s;
+            quat r;
+            gltf_node_trs(doc, joint->node, &t, &r, &s);
+            const joint_channels* js = &joint_samplers[j];
+            if (js->samplers[0] != INVALID_ID) {
+                gltf_sampler_sample(&samplers[js->samplers[0]], time, 3, false, t.elements);
+            }
+            if (js->samplers[1] != INVALID_ID) {
+                gltf_sampler_sample(&samplers[js->samplers[1]], time, 4, true, r.elements);
+            }
+            if (js->samplers[2] != INVALID_ID) {
+                gltf_sampler_sample(&samplers[js->samplers[2]], time, 3, false, s.elements);
+            }
+            joint_transform_resolve(joint, &t, &r, &s);
+            u64 k = (u64)f * joint_count + j;
+            translations[k] = t;
+            rotations[k] = quat_normalize(r);
+            scales[k] = s;
+        }
+    }
+
+    clip.ranges = kallocate(sizeof(animation_range) * joint_count, MEMORY_TAG_ARRAY);
+    clip.keys = kallocate(sizeof(animation_key) * key_count, MEMORY_TAG_ARRAY);
+    for (u32 j = 0; j < joint_count; ++j) {
+        vec3 t_min = translations[j];
+        vec3 t_max = t_min;
+        vec3 s_min = scales[j];
+        vec3 s_max = s_min;
+        for (u32 f = 1; f < clip.frame_count; ++f) {
+            u64 k = (u64)f * joint_count + j;
+            t_min = vec3_min(t_min, translations[k]);
+            t_max = vec3_max(t_max, translations[k]);
+            s_min = vec3_min(s_min, scales[k]);
+            s_max = vec3_max(s_max, scales[k]);
+        }
+        animation_range* range = &clip.ranges[j];
+        range->translation_min = t_min;
+        range->translation_extent = vec3_sub(t_max, t_min);
+        range->scale_min = s_min;
+        range->scale_extent = vec3_sub(s_max, s_min);
+    }
+    for (u64 k = 0; k < key_count; ++k) {
+        animation_key_encode(rotations[k], translations[k], scales[k], &clip.ranges[k % joint_count], &clip.keys[k]);
+    }
+    kfree(translations, sizeof(vec3) * key_count, MEMORY_TAG_ARRAY);
+    kfree(rotations, sizeof(quat) * key_count, MEMORY_TAG_ARRAY);
+    kfree(scales, sizeof(vec3) * key_count, MEMORY_TAG_ARRAY);
+
+    darray_push(state->clips, clip);
+    KINFO("Imported animation '%s': %u frames over %.3f seconds.", clip.name, clip.frame_count, clip.duration);
+    result = true;
+
+done:
+    kfree(samplers, sizeof(gltf_sampler) * KMAX(sampler_count, 1), MEMORY_TAG_ARRAY);
+    kfree(joint_samplers, sizeof(joint_channels) * state->joint_count, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+static b8 import_primitive(import_state* state, u32 primitive, const char* name) {
+    gltf_document* doc = &state->doc;
+    const json_value* values = doc->values;
+    if (json_member_u32(values, primitive, "mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES) {
+        KWARN("Skipping primitive of '%s', which isn't made of triangles.", name);
+        return true;
+    }
+    u32 attributes = json_member(values, primitive, "attributes");
+    u32 position_index = json_member_u32(values, attributes, "POSITION", INVALID_ID);
+    u32 joints_index = json_member_u32(values, attributes, "JOINTS_0", INVALID_ID);
+    u32 weights_index = json_member_u32(values, attributes, "WEIGHTS_0", INVALID_ID);
+    if (position_index == INVALID_ID || joints_index == INVALID_ID || weights_index == INVALID_ID) {
+        KWARN("Skipping primitive of '%s', which isn't skinned.", name);
+        return true;
+    }
+
+    gltf_accessor positions, joints, weights, normals = {0}, texcoords = {0};
+    if (!gltf_accessor_get(doc, position_index, &positions) ||
+        !gltf_accessor_get(doc, joints_index, &joints) ||
+        !gltf_accessor_get(doc, weights_index, &weights)) {
+        return false;
+    }
+    u32 normal_index = json_member_u32(values, attributes, "NORMAL", INVALID_ID);
+    u32 texcoord_index = json_member_u32(values, attributes, "TEXCOORD_0", INVALID_ID);
+    b8 has_normals = normal_index != INVALID_ID && gltf_accessor_get(doc, normal_index, &normals);
+    b8 has_texcoords = texcoord_index != INVALID_ID && gltf_accessor_get(doc, texcoord_index, &texcoords);
+    u32 vertex_count = positions.count;
+    if (joints.count < vertex_count || weights.count < vertex_count ||
+        (has_normals && normals.count < vertex_count) || (has_texcoords && texcoords.count < vertex_count)) {
+        KERROR("Primitive of '%s' has attributes with too few elements.", name);
+        return false;
+    }
+
+    import_geometry g = {0};
+    string_ncopy(g.name, name, GEOMETRY_NAME_MAX_LENGTH - 1);
+    u32 material = json_element(values, json_member(values, doc->root, "materials"), json_member_u32(values, primitive, "material", INVALID_ID));
+    json_string_copy(values, json_member(values, material, "name"), g.material_name, MATERIAL_NAME_MAX_LENGTH);
+    g.vertices = darray_reserve(vertex_3d_skinned, KMAX(vertex_count, 1));
+    g.min_extents = vec3_create(K_INFINITY, K_INFINITY, K_INFINITY);
+    g.max_extents = vec3_create(-K_INFINITY, -K_INFINITY, -K_INFINITY);
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        vertex_3d_skinned vertex = {0};
+        gltf_accessor_read_f32(&positions, v, 3, vertex.position.elements);
+        vertex.normal = vec3_create(0.0f, 1.0f, 0.0f);
+        if (has_normals) {
+            gltf_accessor_read_f32(&normals, v, 3, vertex.normal.elements);
+        }
+        if (has_texcoords) {
+            gltf_accessor_read_f32(&texcoords, v, 2, vertex.texcoord.elements);
+            // glTF places the origin of texture coordinates at the top left, but images are loaded flipped.
+            vertex.texcoord.y = 1.0f - vertex.texcoord.y;
+        }
+        g.min_extents = vec3_min(g.min_extents, vertex.position);
+        g.max_extents = vec3_max(g.max_extents, vertex.position);
+
+        f32 w[4] = {0};
+        gltf_accessor_read_f32(&weights, v, 4, w);
+        f32 sum = 0.0f;
+        for (u32 k = 0; k < 4; ++k) {
+            u32 joint = gltf_accessor_read_u32(&joints, v, KMIN(k, joints.component_count - 1));
+            if (w[k] > 0.0f && joint >= state->joint_count) {
+                KERROR("Primitive of '%s' has vertex %u influenced by joint %u, which the skin doesn't have.", name, v, joint);
+                darray_destroy(g.vertices);
+                return false;
+            }
+            vertex.joints[k] = joint < state->joint_count ? (u8)state->skin_joint_remap[joint] : 0;
+            w[k] = KMAX(w[k], 0.0f);
+            sum += w[k];
+        }
+        // Quantize the weights so they sum to exactly 255, giving anything lost to rounding to the largest.
+        if (sum <= 0.0f) {
+            vertex.weights[0] = 255;
+        } else {
+            u32 total = 0;
+            u32 largest = 0;
+            for (u32 k = 0; k < 4; ++k) {
+                vertex.weights[k] = (u8)kfloor(w[k] / sum * 255.0f + 0.5f);
+                total += vertex.weights[k];
+                if (w[k] > w[largest]) {
+                    largest = k;
+                }
+            }
+            vertex.weights[largest] = (u8)((i32)vertex.weights[largest] + 255 - (i32)total);
+        }
+        darray_push(g.vertices, vertex);
+    }
+
+    u32 indices_index = json_member_u32(values, primitive, "indices", INVALID_ID);
+    if (indices_index != INVALID_ID) {
+        gltf_accessor indices;
+        if (!gltf_accessor_get(doc, indices_index, &indices)) {
+            darray_destroy(g.vertices);
+            return false;
+        }
+        g.indices = darray_reserve(u32, KMAX(indices.count, 1));
+        for (u32 i = 0; i < indices.count; ++i) {
+            u32 index = gltf_accessor_read_u32(&indices, i, 0);
+            if (index >= vertex_count) {
+                KERROR("Primitive of '%s' has index %u outside its vertices.", name, i);
+                darray_destroy(g.vertices);
+                darray_destroy(g.indices);
+                return false;
+            }
+            darray_push(g.indices, index);
+        }
+    } else {
+        g.indices = darray_reserve(u32, KMAX(vertex_count, 1));
+        for (u32 i = 0; i < vertex_count; ++i) {
+            darray_push(g.indices, i);
+        }
+    }
+
+    darray_push(state->geometries, g);
+    return true;
+}
+
+static b8 import_geometries(import_state* state) {
+    gltf_document* doc = &state->doc;
+    const json_value* values = doc->values;
+    u32 meshes = json_member(values, doc->root, "meshes");
+    for (u32 n = 0; n < doc->node_count; ++n) {
+        u32 node = json_element(values, doc->nodes, n);
+        u32 mesh_index = json_member_u32(values, node, "mesh", INVALID_ID);
+        if (mesh_index == INVALID_ID || json_member_u32(values, node, "skin", INVALID_ID) != state->skin_index) {
+            continue;
+        }
+        u32 mesh = json_element(values, meshes, mesh_index);
+        char mesh_name[200];
+        json_string_copy(values, json_member(values, mesh, "name"), mesh_name, 200);
+        if (!mesh_name[0]) {
+            string_format(mesh_name, "mesh_%u", mesh_index);
+        }
+        u32 primitives = json_member(values, mesh, "primitives");
+        u32 primitive_count = json_count(values, primitives);
+        for (u32 p = 0; p < primitive_count; ++p) {
+            char name[GEOMETRY_NAME_MAX_LENGTH];
+            if (primitive_count > 1) {
+                string_format(name, "%s_%u", mesh_name, p);
+            } else {
+                string_ncopy(name, mesh_name, GEOMETRY_NAME_MAX_LENGTH - 1);
+                name[GEOMETRY_NAME_MAX_LENGTH - 1] = 0;
+            }
+            if (!import_primitive(state, json_element(values, primitives, p), name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static u32 ksa_string_add(char** table, const char* str) {
+    u32 offset = (u32)darray_length(*table);
+    u32 length = (u32)string_length(str);
+    for (u32 i = 0; i <= length; ++i) {
+        darray_push(*table, str[i]);
+    }
+    return offset;
+}
+
+static b8 write_ksa_file(const char* path, const import_state* state) {
+    u32 joint_count = state->joint_count;
+    u32 clip_count = (u32)darray_length(state->clips);
+    u32 geometry_count = (u32)darray_length(state->geometries);
+
+    char* strings = darray_create(char);
+    ksa_joint* joints = kallocate(sizeof(ksa_joint) * joint_count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < joint_count; ++i) {
+        const import_joint* joint = &state->joints[i];
+        joints[i].name = ksa_string_add(&strings, joint->name);
+        joints[i].parent = joint->parent;
+        joints[i].rest_translation = joint->rest_translation;
+        joints[i].rest_rotation = joint->rest_rotation;
+        joints[i].rest_scale = joint->rest_scale;
+        joints[i].inverse_bind_matrix = joint->inverse_bind_matrix;
+    }
+    ksa_clip* clips = kallocate(sizeof(ksa_clip) * KMAX(clip_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < clip_count; ++i) {
+        clips[i].name = ksa_string_add(&strings, state->clips[i].name);
+        clips[i].frame_count = state->clips[i].frame_count;
+        clips[i].duration = state->clips[i].duration;
+        clips[i].sample_rate = state->clips[i].sample_rate;
+    }
+    ksa_geometry* geometries = kallocate(sizeof(ksa_geometry) * KMAX(geometry_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const import_geometry* g = &state->geometries[i];
+        geometries[i].name = ksa_string_add(&strings, g->name);
+        geometries[i].material_name = ksa_string_add(&strings, g->material_name);
+        geometries[i].vertex_count = (u32)darray_length(g->vertices);
+        geometries[i].index_count = (u32)darray_length(g->indices);
+        geometries[i].min_extents = g->min_extents;
+        geometries[i].max_extents = g->max_extents;
+        geometries[i].center = vec3_mul_scalar(vec3_add(g->min_extents, g->max_extents), 0.5f);
+    }
+
+    ksa_header header = {0};
+    header.joint_count = joint_count;
+    header.clip_count = clip_count;
+    header.geometry_count = geometry_count;
+    header.string_table_size = (u32)darray_length(strings);
+
+    // Lay out the file: the headers, then each array aligned.
+    u64 file_size = sizeof(resource_header) + sizeof(ksa_header);
+    header.string_table_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+    file_size = header.string_table_offset + header.string_table_size;
+    header.joints_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+    file_size = header.joints_offset + sizeof(ksa_joint) * joint_count;
+    header.clips_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+    file_size = header.clips_offset + sizeof(ksa_clip) * clip_count;
+    header.geometries_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+    file_size = header.geometries_offset + sizeof(ksa_geometry) * geometry_count;
+    for (u32 i = 0; i < clip_count; ++i) {
+        clips[i].ranges_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+        file_size = clips[i].ranges_offset + sizeof(animation_range) * joint_count;
+        clips[i].keys_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+        file_size = clips[i].keys_offset + sizeof(animation_key) * joint_count * clips[i].frame_count;
+    }
+    for (u32 i = 0; i < geometry_count; ++i) {
+        geometries[i].vertices_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+        file_size = geometries[i].vertices_offset + sizeof(vertex_3d_skinned) * geometries[i].vertex_count;
+        geometries[i].indices_offset = get_aligned(file_size, KSA_DATA_ALIGNMENT);
+        file_size = geometries[i].indices_offset + sizeof(u32) * geometries[i].index_count;
+    }
+    header.file_size = file_size;
+
+    resource_header file_header;
+    file_header.magic_number = RESOURCE_MAGIC;
+    file_header.resource_type = RESOURCE_TYPE_SKELETAL_MESH;
+    file_header.version = KSA_VERSION;
+    file_header.reserved = 0;
+
+    // Build the file in memory, so it is written with a single call.
+    u8* data = kallocate(file_size, MEMORY_TAG_ARRAY);
+    kcopy_memory(data, &file_header, sizeof(resource_header));
+    kcopy_memory(data + sizeof(resource_header), &header, sizeof(ksa_header));
+    kcopy_memory(data + header.string_table_offset, strings, header.string_table_size);
+    kcopy_memory(data + header.joints_offset, joints, sizeof(ksa_joint) * joint_count);
+    kcopy_memory(data + header.clips_offset, clips, sizeof(ksa_clip) * clip_count);
+    kcopy_memory(data + header.geometries_offset, geometries, sizeof(ksa_geometry) * geometry_count);
+    for (u32 i = 0; i < clip_count; ++i) {
+        kcopy_memory(data + clips[i].ranges_offset, state->clips[i].ranges, sizeof(animation_range) * joint_count);
+        kcopy_memory(data + clips[i].keys_offset, state->clips[i].keys, sizeof(animation_key) * joint_count * clips[i].frame_count);
+    }
+    for (u32 i = 0; i < geometry_count; ++i) {
+        kcopy_memory(data + geometries[i].vertices_offset, state->geometries[i].vertices, sizeof(vertex_3d_skinned) * geometries[i].vertex_count);
+        kcopy_memory(data + geometries[i].indices_offset, state->geometries[i].indices, sizeof(u32) * geometries[i].index_count);
+    }
+
+    darray_destroy(strings);
+    kfree(joints, sizeof(ksa_joint) * joint_count, MEMORY_TAG_ARRAY);
+    kfree(clips, sizeof(ksa_clip) * KMAX(clip_count, 1), MEMORY_TAG_ARRAY);
+    kfree(geometries, sizeof(ksa_geometry) * KMAX(geometry_count, 1), MEMORY_TAG_ARRAY);
+
+    b8 result = false;
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Unable to open file '%s' for writing.", path);
+    } else {
+        u64 written = 0;
+        result = filesystem_write(&f, file_size, data, &written) && written == file_size;
+        filesystem_close(&f);
+        if (!result) {
+            KERROR("Error writing file '%s'.", path);
+        }
+    }
+    kfree(data, file_size, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+static void import_state_destroy(import_state* state) {
+    if (state->clips) {
+        u32 clip_count = (u32)darray_length(state->clips);
+        for (u32 i = 0; i < clip_count; ++i) {
+            import_clip* clip = &state->clips[i];
+            kfree(clip->ranges, sizeof(animation_range) * state->joint_count, MEMORY_TAG_ARRAY);
+            kfree(clip->keys, sizeof(animation_key) * state->joint_count * clip->frame_count, MEMORY_TAG_ARRAY);
+        }
+        darray_destroy(state->clips);
+    }
+    if (state->geometries) {
+        u32 geometry_count = (u32)darray_length(state->geometries);
+        for (u32 i = 0; i < geometry_count; ++i) {
+            darray_destroy(state->geometries[i].vertices);
+            darray_destroy(state->geometries[i].indices);
+        }
+        darray_destroy(state->geometries);
+    }
+    if (state->node_joints) {
+        kfree(state->node_joints, sizeof(u32) * KMAX(state->doc.node_count, 1), MEMORY_TAG_ARRAY);
+    }
+    gltf_document_destroy(&state->doc);
+}
+
+i32 import_skeletal_mesh(i32 argc, char** argv) {
+    if (argc < 4) {
+        KERROR("Animation import mode requires at least an infile and outfile. Usage: infile=[filename] outfile=[filename]");
+        return -3;
+    }
+
+    char in_file_path[1024] = {0};
+    char out_file_path[1024] = {0};
+    f32 sample_rate = 30.0f;
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        char** parts = darray_create(char*);
+        string_split(argv[i], '=', &parts, true, false);
+        if (darray_length(parts) != 2) {
+            KERROR("Unrecognized argument '%s'. Arguments take the form name=value.", argv[i]);
+            string_cleanup_split_array(parts);
+            darray_destroy(parts);
+            return -5;
+        }
+
+        b8 valid = true;
+        if (strings_equali(parts[0], "infile")) {
+            string_ncopy(in_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "outfile")) {
+            string_ncopy(out_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "rate")) {
+            valid = string_to_f32(parts[1], &sample_rate) && sample_rate > 0.0f;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'.", argv[i]);
+        }
+        string_cleanup_split_array(parts);
+        darray_destroy(parts);
+        if (!valid) {
+            return -5;
+        }
+    }
+    if (in_file_path[0] == 0 || out_file_path[0] == 0) {
+        KERROR("Parameters infile and outfile are required. Usage: infile=[filename] outfile=[filename]");
+        return -4;
+    }
+
+    // Large, so kept off the stack.
+    import_state* state = kallocate(sizeof(import_state), MEMORY_TAG_ARRAY);
+    if (!gltf_document_load(in_file_path, &state->doc)) {
+        kfree(state, sizeof(import_state), MEMORY_TAG_ARRAY);
+        return -6;
+    }
+    state->clips = darray_create(import_clip);
+    state->geometries = darray_create(import_geometry);
+    state->node_joints = kallocate(sizeof(u32) * KMAX(state->doc.node_count, 1), MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < state->doc.node_count; ++i) {
+        state->node_joints[i] = INVALID_ID;
+    }
+
+    i32 result = 0;
+    const json_value* values = state->doc.values;
+    u32 skin_count = json_count(values, json_member(values, state->doc.root, "skins"));
+    if (!skin_count) {
+        KERROR("glTF file '%s' has no skins to import.", in_file_path);
+        result = -7;
+        goto done;
+    }
+    if (skin_count > 1) {
+        KWARN("glTF file '%s' has %u skins. Only the first is imported.", in_file_path, skin_count);
+    }
+    state->skin_index = 0;
+    if (!import_skeleton(state) || !import_geometries(state)) {
+        result = -8;
+        goto done;
+    }
+    u32 animation_count = json_count(values, json_member(values, state->doc.root, "animations"));
+    for (u32 i = 0; i < animation_count; ++i) {
+        if (!import_animation(state, i, sample_rate)) {
+            result = -8;
+            goto done;
+        }
+    }
+    if (!darray_length(state->geometries)) {
+        KWARN("glTF file '%s' has no geometry skinned to its skin. Only the skeleton and animations are imported.", in_file_path);
+    }
+
+    if (!write_ksa_file(out_file_path, state)) {
+        result = -9;
+        goto done;
+    }
+    KINFO("Imported %u joints, %u animations and %u geometries from '%s' to '%s'.", state->joint_count,
+          (u32)darray_length(state->clips), (u32)darray_length(state->geometries), in_file_path, out_file_path);
+
+done:
+    import_state_destroy(state);
+    kfree(state, sizeof(import_state), MEMORY_TAG_ARRAY);
+    return result;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file gltf_importer.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Imports the skeleton, skinned geometry and animations of glTF (.gltf and .glb)
+ * files into .ksa (Kohi skeletal animation) files, resampling every animation at a fixed
+ * rate and quantizing its keys.
+ * @version 1.0
+ * @date 2023-12-08
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the animation import mode of the tools using the given command line arguments.
+ * Usage: tools anim|ksa infile=[filename] outfile=[filename] [rate=30]
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 import_skeletal_mesh(i32 argc, char** argv);
@@ -0,0 +1,432 @@
+#include "impostor_baker.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <resources/loaders/mesh_loader.h>
+#include <resources/resource_types.h>
+#include <systems/geometry_system.h>
+
+#include "vendor/stb_image.h"
+#include "vendor/stb_image_write.h"
+
+// The number of passes spreading the colours of covered texels into empty ones, so filtering
+// at the silhouette never blends in the background.
+#define IMPOSTOR_DILATE_PASSES 4
+
+// A vertex of the mesh, unpacked from whichever format it is stored in.
+typedef struct bake_vertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texcoord;
+    vec4 colour;
+} bake_vertex;
+
+// An image sampled for the albedo, flipped as the engine loads it so texcoords match.
+typedef struct bake_image {
+    i32 width;
+    i32 height;
+    u8* pixels;
+} bake_image;
+
+// The atlases being baked, with both stored bottom row first.
+typedef struct bake_atlas {
+    u32 size;
+    f32* depth;
+    vec4* albedo;
+    vec3* normal;
+    u8* coverage;
+} bake_atlas;
+
+static f32 half_to_f32(u16 h) {
+    u32 sign = (u32)(h >> 15) << 31;
+    i32 exponent = (h >> 10) & 0x1F;
+    u32 mantissa = h & 0x3FF;
+    u32 bits;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Subnormal. Renormalize into a float.
+            exponent = 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FF;
+            bits = sign | ((u32)(exponent + 112) << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 31) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((u32)(exponent + 112) << 23) | (mantissa << 13);
+    }
+    f32 result;
+    kcopy_memory(&result, &bits, sizeof(f32));
+    return result;
+}
+
+static void vertex_unpack(const geometry_config* config, u32 index, bake_vertex* out_vertex) {
+    if (config->vertex_format == GEOMETRY_VERTEX_FORMAT_PACKED) {
+        const vertex_3d_packed* v = &((const vertex_3d_packed*)config->vertices)[index];
+        for (u32 c = 0; c < 3; ++c) {
+            f32 p = KMAX(v->position[c] / 32767.0f, -1.0f);
+            out_vertex->position.elements[c] = p * config->quantization_scale + config->quantization_center.elements[c];
+            out_vertex->normal.elements[c] = KMAX(v->normal[c] / 127.0f, -1.0f);
+        }
+        out_vertex->texcoord = (vec2){half_to_f32(v->texcoord[0]), half_to_f32(v->texcoord[1])};
+        for (u32 c = 0; c < 4; ++c) {
+            out_vertex->colour.elements[c] = v->colour[c] / 255.0f;
+        }
+    } else {
+        const vertex_3d* v = &((const vertex_3d*)config->vertices)[index];
+        out_vertex->position = v->position;
+        out_vertex->normal = v->normal;
+        out_vertex->texcoord = v->texcoord;
+        out_vertex->colour = v->colour;
+    }
+}
+
+static u32 index_get(const geometry_config* config, u32 i) {
+    return config->index_size == sizeof(u16) ? ((const u16*)config->indices)[i] : ((const u32*)config->indices)[i];
+}
+
+// NOTE: The octahedral mapping and frame basis mirror those of the impostor shader, and must
+// be changed in both places.
+static vec3 octahedral_decode(f32 u, f32 v) {
+    f32 px = u * 2.0f - 1.0f;
+    f32 pz = v * 2.0f - 1.0f;
+    vec3 d = (vec3){px, 1.0f - kabs(px) - kabs(pz), pz};
+    if (d.y < 0.0f) {
+        f32 x = (1.0f - kabs(d.z)) * (d.x >= 0.0f ? 1.0f : -1.0f);
+        f32 z = (1.0f - kabs(d.x)) * (d.z >= 0.0f ? 1.0f : -1.0f);
+        d.x = x;
+        d.z = z;
+    }
+    return vec3_normalized(d);
+}
+
+static void frame_basis(vec3 d, vec3* out_right, vec3* out_up) {
+    vec3 world_up = kabs(d.y) > 0.999f ? (vec3){0.0f, 0.0f, 1.0f} : (vec3){0.0f, 1.0f, 0.0f};
+    *out_right = vec3_normalized(vec3_cross(world_up, d));
+    *out_up = vec3_cross(d, *out_right);
+}
+
+static vec4 image_sample(const bake_image* image, vec2 texcoord) {
+    if (!image->pixels) {
+        return vec4_one();
+    }
+    // Textures repeat by default.
+    f32 u = texcoord.x - kfloor(texcoord.x);
+    f32 v = texcoord.y - kfloor(texcoord.y);
+    i32 x = KMIN((i32)(u * image->width), image->width - 1);
+    i32 y = KMIN((i32)(v * image->height), image->height - 1);
+    const u8* p = image->pixels + ((u64)y * image->width + x) * 4;
+    return (vec4){p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f};
+}
+
+static f32 edge_function(f32 ax, f32 ay, f32 bx, f32 by, f32 px, f32 py) {
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// Rasterizes a triangle, already projected into pixels of the whole atlas, into the given tile.
+static void triangle_rasterize(bake_atlas* atlas, u32 tile_x, u32 tile_y, u32 tile_size, const vec3 projected[3], const bake_vertex* vertices[3], const bake_image* image) {
+    f32 area = edge_function(projected[0].x, projected[0].y, projected[1].x, projected[1].y, projected[2].x, projected[2].y);
+    if (kabs(area) < 1e-12f) {
+        return;
+    }
+
+    f32 min_x = KMIN(projected[0].x, KMIN(projected[1].x, projected[2].x));
+    f32 max_x = KMAX(projected[0].x, KMAX(projected[1].x, projected[2].x));
+    f32 min_y = KMIN(projected[0].y, KMIN(projected[1].y, projected[2].y));
+    f32 max_y = KMAX(projected[0].y, KMAX(projected[1].y, projected[2].y));
+    i32 x0 = KMAX((i32)kfloor(min_x), (i32)tile_x);
+    i32 x1 = KMIN((i32)kfloor(max_x), (i32)(tile_x + tile_size) - 1);
+    i32 y0 = KMAX((i32)kfloor(min_y), (i32)tile_y);
+    i32 y1 = KMIN((i32)kfloor(max_y), (i32)(tile_y + tile_size) - 1);
+
+    for (i32 y = y0; y <= y1; ++y) {
+        for (i32 x = x0; x <= x1; ++x) {
+            f32 px = x + 0.5f;
+            f32 py = y + 0.5f;
+            // Either winding is accepted, as impostors are seen from every side.
+            f32 w0 = edge_function(projected[1].x, projected[1].y, projected[2].x, projected[2].y, px, py) / area;
+            f32 w1 = edge_function(projected[2].x, projected[2].y, projected[0].x, projected[0].y, px, py) / area;
+            f32 w2 = 1.0f - w0 - w1;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                continue;
+            }
+
+            // Larger depths are nearer the viewer.
+            f32 depth = projected[0].z * w0 + projected[1].z * w1 + projected[2].z * w2;
+            u64 texel = (u64)y * atlas->size + x;
+            if (atlas->coverage[texel] && depth <= atlas->depth[texel]) {
+                continue;
+            }
+            atlas->depth[texel] = depth;
+            atlas->coverage[texel] = 1;
+
+            vec3 normal = vec3_add(vec3_add(vec3_mul_scalar(vertices[0]->normal, w0), vec3_mul_scalar(vertices[1]->normal, w1)), vec3_mul_scalar(vertices[2]->normal, w2));
+            atlas->normal[texel] = vec3_length_squared(normal) > K_FLOAT_EPSILON ? vec3_normalized(normal) : (vec3){0.0f, 1.0f, 0.0f};
+
+            vec2 texcoord = (vec2){
+                vertices[0]->texcoord.x * w0 + vertices[1]->texcoord.x * w1 + vertices[2]->texcoord.x * w2,
+                vertices[0]->texcoord.y * w0 + vertices[1]->texcoord.y * w1 + vertices[2]->texcoord.y * w2};
+            vec4 colour = vec4_add(vec4_add(vec4_mul_scalar(vertices[0]->colour, w0), vec4_mul_scalar(vertices[1]->colour, w1)), vec4_mul_scalar(vertices[2]->colour, w2));
+            vec4 sampled = image_sample(image, texcoord);
+            atlas->albedo[texel] = (vec4){sampled.x * colour.x, sampled.y * colour.y, sampled.z * colour.z, 1.0f};
+        }
+    }
+}
+
+// Spreads the colours and normals of covered texels into the empty texels next to them, within
+// each tile, leaving them uncovered.
+static void atlas_dilate(bake_atlas* atlas, u32 tile_size) {
+    u64 texel_count = (u64)atlas->size * atlas->size;
+    u8* filled = kallocate(texel_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(filled, atlas->coverage, texel_count);
+    u8* next = kallocate(texel_count, MEMORY_TAG_ARRAY);
+
+    for (u32 pass = 0; pass < IMPOSTOR_DILATE_PASSES; ++pass) {
+        kcopy_memory(next, filled, texel_count);
+        for (u32 y = 0; y < atlas->size; ++y) {
+            for (u32 x = 0; x < atlas->size; ++x) {
+                u64 texel = (u64)y * atlas->size + x;
+                if (filled[texel]) {
+                    continue;
+                }
+                vec4 albedo = vec4_zero();
+                vec3 normal = vec3_zero();
+                u32 count = 0;
+                for (i32 dy = -1; dy <= 1; ++dy) {
+                    for (i32 dx = -1; dx <= 1; ++dx) {
+                        i32 nx = (i32)x + dx;
+                        i32 ny = (i32)y + dy;
+                        // Never across the edge of a tile.
+                        if (nx < 0 || ny < 0 || nx >= (i32)atlas->size || ny >= (i32)atlas->size || (u32)nx / tile_size != x / tile_size || (u32)ny / tile_size != y / tile_size) {
+                            continue;
+                        }
+                        u64 neighbour = (u64)ny * atlas->size + nx;
+                        if (filled[neighbour]) {
+                            albedo = vec4_add(albedo, atlas->albedo[neighbour]);
+                            normal = vec3_add(normal, atlas->normal[neighbour]);
+                            count++;
+                        }
+                    }
+                }
+                if (count) {
+                    albedo = vec4_mul_scalar(albedo, 1.0f / count);
+                    albedo.w = 0.0f;
+                    atlas->albedo[texel] = albedo;
+                    atlas->normal[texel] = vec3_length_squared(normal) > K_FLOAT_EPSILON ? vec3_normalized(normal) : (vec3){0.0f, 1.0f, 0.0f};
+                    next[texel] = 1;
+                }
+            }
+        }
+        kcopy_memory(filled, next, texel_count);
+    }
+
+    kfree(next, texel_count, MEMORY_TAG_ARRAY);
+    kfree(filled, texel_count, MEMORY_TAG_ARRAY);
+}
+
+static u8 unorm8(f32 value) {
+    return (u8)(KCLAMP(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Writes the atlases as PNGs, flipped so they load the right way up with flip_y.
+static b8 atlas_write(const bake_atlas* atlas, const char* albedo_path, const char* normal_path) {
+    u64 texel_count = (u64)atlas->size * atlas->size;
+    u8* pixels = kallocate(texel_count * 4, MEMORY_TAG_ARRAY);
+    stbi_flip_vertically_on_write(1);
+    b8 success = true;
+
+    for (u64 t = 0; t < texel_count; ++t) {
+        pixels[t * 4 + 0] = unorm8(atlas->albedo[t].x);
+        pixels[t * 4 + 1] = unorm8(atlas->albedo[t].y);
+        pixels[t * 4 + 2] = unorm8(atlas->albedo[t].z);
+        pixels[t * 4 + 3] = atlas->coverage[t] ? 255 : 0;
+    }
+    if (!stbi_write_png(albedo_path, atlas->size, atlas->size, 4, pixels, atlas->size * 4)) {
+        KERROR("Failed to write impostor atlas '%s'.", albedo_path);
+        success = false;
+    }
+
+    for (u64 t = 0; success && t < texel_count; ++t) {
+        pixels[t * 4 + 0] = unorm8(atlas->normal[t].x * 0.5f + 0.5f);
+        pixels[t * 4 + 1] = unorm8(atlas->normal[t].y * 0.5f + 0.5f);
+        pixels[t * 4 + 2] = unorm8(atlas->normal[t].z * 0.5f + 0.5f);
+        pixels[t * 4 + 3] = atlas->coverage[t] ? 255 : 0;
+    }
+    if (success && !stbi_write_png(normal_path, atlas->size, atlas->size, 4, pixels, atlas->size * 4)) {
+        KERROR("Failed to write impostor atlas '%s'.", normal_path);
+        success = false;
+    }
+
+    kfree(pixels, texel_count * 4, MEMORY_TAG_ARRAY);
+    return success;
+}
+
+i32 bake_impostor(i32 argc, char** argv) {
+    if (argc < 4) {
+        KERROR("Impostor bake mode requires at least an infile and outfile. Usage: infile=[filename] outfile=[filename]");
+        return -3;
+    }
+
+    char in_file_path[1024] = {0};
+    char out_file_path[1024] = {0};
+    char albedo_path[1024] = {0};
+    u32 frame_count = 8;
+    u32 tile_size = 128;
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        char** parts = darray_create(char*);
+        string_split(argv[i], '=', &parts, true, false);
+        if (darray_length(parts) != 2) {
+            KERROR("Unrecognized argument '%s'. Arguments take the form name=value.", argv[i]);
+            string_cleanup_split_array(parts);
+            darray_destroy(parts);
+            return -5;
+        }
+
+        b8 valid = true;
+        if (strings_equali(parts[0], "infile")) {
+            string_ncopy(in_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "outfile")) {
+            string_ncopy(out_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "albedo")) {
+            string_ncopy(albedo_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "frames")) {
+            valid = string_to_u32(parts[1], &frame_count) && frame_count >= 2 && frame_count <= 32;
+        } else if (strings_equali(parts[0], "size")) {
+            valid = string_to_u32(parts[1], &tile_size) && tile_size >= 8 && tile_size <= 1024;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'.", argv[i]);
+        }
+        string_cleanup_split_array(parts);
+        darray_destroy(parts);
+        if (!valid) {
+            return -5;
+        }
+    }
+    if (in_file_path[0] == 0 || out_file_path[0] == 0) {
+        KERROR("Parameters infile and outfile are required. Usage: infile=[filename] outfile=[filename]");
+        return -4;
+    }
+
+    // The normal atlas sits next to the albedo one, named as mesh.c expects.
+    char normal_path[1100] = {0};
+    const char* extension = 0;
+    for (const char* c = out_file_path; *c; ++c) {
+        if (*c == '.') {
+            extension = c;
+        } else if (*c == '/' || *c == '\\') {
+            extension = 0;
+        }
+    }
+    u32 stem_length = extension ? (u32)(extension - out_file_path) : string_length(out_file_path);
+    string_format(normal_path, "%.*s_normal%s", stem_length, out_file_path, extension ? extension : ".png");
+
+    geometry_config* geometries = 0;
+    if (!mesh_loader_ksm_load(in_file_path, &geometries)) {
+        KERROR("Failed to load mesh '%s'.", in_file_path);
+        return -6;
+    }
+    u32 geometry_count = darray_length(geometries);
+    if (!geometry_count) {
+        KERROR("Mesh '%s' has no geometry to bake.", in_file_path);
+        mesh_loader_geometries_free(geometries);
+        return -6;
+    }
+
+    bake_image image = {0};
+    if (albedo_path[0]) {
+        i32 channels;
+        stbi_set_flip_vertically_on_load(1);
+        image.pixels = stbi_load(albedo_path, &image.width, &image.height, &channels, 4);
+        if (!image.pixels) {
+            KERROR("Failed to load albedo image '%s': %s", albedo_path, stbi_failure_reason());
+            mesh_loader_geometries_free(geometries);
+            return -6;
+        }
+    }
+
+    // The combined bounds of every geometry, as the scene places impostors by.
+    vec3 min_extents = geometries[0].min_extents;
+    vec3 max_extents = geometries[0].max_extents;
+    for (u32 g = 1; g < geometry_count; ++g) {
+        min_extents = vec3_min(min_extents, geometries[g].min_extents);
+        max_extents = vec3_max(max_extents, geometries[g].max_extents);
+    }
+    vec3 center = vec3_mul_scalar(vec3_add(min_extents, max_extents), 0.5f);
+    f32 radius = vec3_length(vec3_sub(max_extents, center));
+    if (radius < K_FLOAT_EPSILON) {
+        radius = 1.0f;
+    }
+
+    bake_atlas atlas = {0};
+    atlas.size = frame_count * tile_size;
+    u64 texel_count = (u64)atlas.size * atlas.size;
+    atlas.depth = kallocate(sizeof(f32) * texel_count, MEMORY_TAG_ARRAY);
+    atlas.albedo = kallocate(sizeof(vec4) * texel_count, MEMORY_TAG_ARRAY);
+    atlas.normal = kallocate(sizeof(vec3) * texel_count, MEMORY_TAG_ARRAY);
+    atlas.coverage = kallocate(texel_count, MEMORY_TAG_ARRAY);
+
+    u32 triangle_count = 0;
+    for (u32 fy = 0; fy < frame_count; ++fy) {
+        for (u32 fx = 0; fx < frame_count; ++fx) {
+            vec3 d = octahedral_decode((f32)fx / (frame_count - 1), (f32)fy / (frame_count - 1));
+            vec3 right, up;
+            frame_basis(d, &right, &up);
+            u32 tile_x = fx * tile_size;
+            u32 tile_y = fy * tile_size;
+
+            for (u32 g = 0; g < geometry_count; ++g) {
+                const geometry_config* config = &geometries[g];
+                // Only the full detail level is baked.
+                u32 index_count = config->lod_count ? config->lods[0].index_count : config->index_count;
+                u32 first_index = config->lod_count ? config->lods[0].index_offset : 0;
+                for (u32 t = 0; t + 2 < index_count; t += 3) {
+                    bake_vertex vertices[3];
+                    const bake_vertex* vertex_pointers[3];
+                    vec3 projected[3];
+                    for (u32 c = 0; c < 3; ++c) {
+                        vertex_unpack(config, index_get(config, first_index + t + c), &vertices[c]);
+                        vertex_pointers[c] = &vertices[c];
+                        vec3 r = vec3_sub(vertices[c].position, center);
+                        projected[c].x = tile_x + (vec3_dot(r, right) / radius * 0.5f + 0.5f) * tile_size;
+                        projected[c].y = tile_y + (vec3_dot(r, up) / radius * 0.5f + 0.5f) * tile_size;
+                        projected[c].z = vec3_dot(r, d);
+                    }
+                    triangle_rasterize(&atlas, tile_x, tile_y, tile_size, projected, vertex_pointers, &image);
+                    if (fx == 0 && fy == 0) {
+                        triangle_count++;
+                    }
+                }
+            }
+        }
+    }
+
+    atlas_dilate(&atlas, tile_size);
+    b8 written = atlas_write(&atlas, out_file_path, normal_path);
+
+    kfree(atlas.depth, sizeof(f32) * texel_count, MEMORY_TAG_ARRAY);
+    kfree(atlas.albedo, sizeof(vec4) * texel_count, MEMORY_TAG_ARRAY);
+    kfree(atlas.normal, sizeof(vec3) * texel_count, MEMORY_TAG_ARRAY);
+    kfree(atlas.coverage, texel_count, MEMORY_TAG_ARRAY);
+    if (image.pixels) {
+        stbi_image_free(image.pixels);
+    }
+    mesh_loader_geometries_free(geometries);
+    if (!written) {
+        return -7;
+    }
+
+    KINFO("Baked %u triangles of '%s' into %ux%u impostor frames of %u pixels: '%s' and '%s'.", triangle_count, in_file_path, frame_count, frame_count, tile_size, out_file_path, normal_path);
+    return 0;
+}
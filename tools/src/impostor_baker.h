@@ -0,0 +1,27 @@
+/**
+ * @file impostor_baker.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Bakes octahedral impostor atlases of .ksm meshes, which distant instances of the mesh
+ * are drawn from in place of its geometry. Each atlas is a grid of frames, each an orthographic
+ * view of the mesh from a direction spread over the sphere by an octahedral mapping, holding
+ * its unlit albedo and, in a second atlas, its object-space normals.
+ * @version 1.0
+ * @date 2023-12-10
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the impostor bake mode of the tools using the given command line arguments.
+ * Usage: tools impostor|kimp infile=[filename] outfile=[filename] [frames=8] [size=128] [albedo=[filename]]
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 bake_impostor(i32 argc, char** argv);
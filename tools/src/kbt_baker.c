@@ -0,0 +1,388 @@
+#include "kbt_baker.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <renderer/renderer_utils.h>
+#include <resources/resource_types.h>
+
+#include "vendor/stb_image.h"
+
+// A single mip level of RGBA pixels.
+typedef struct mip_level {
+    u32 width;
+    u32 height;
+    u8* pixels;
+} mip_level;
+
+// Builds the next level down by averaging each 2x2 group of pixels, clamping at the edges of odd dimensions.
+static void mip_level_downsample(const mip_level* source, mip_level* out_level) {
+    out_level->width = KMAX(source->width / 2, 1);
+    out_level->height = KMAX(source->height / 2, 1);
+    out_level->pixels = kallocate((u64)out_level->width * out_level->height * 4, MEMORY_TAG_TEXTURE);
+
+    for (u32 y = 0; y < out_level->height; ++y) {
+        u32 y0 = KMIN(y * 2, source->height - 1);
+        u32 y1 = KMIN(y * 2 + 1, source->height - 1);
+        for (u32 x = 0; x < out_level->width; ++x) {
+            u32 x0 = KMIN(x * 2, source->width - 1);
+            u32 x1 = KMIN(x * 2 + 1, source->width - 1);
+            const u8* p00 = source->pixels + ((u64)y0 * source->width + x0) * 4;
+            const u8* p01 = source->pixels + ((u64)y0 * source->width + x1) * 4;
+            const u8* p10 = source->pixels + ((u64)y1 * source->width + x0) * 4;
+            const u8* p11 = source->pixels + ((u64)y1 * source->width + x1) * 4;
+            u8* dest = out_level->pixels + ((u64)y * out_level->width + x) * 4;
+            for (u32 c = 0; c < 4; ++c) {
+                dest[c] = (u8)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+            }
+        }
+    }
+}
+
+// Gathers the 4x4 block of RGBA pixels at the given block coordinates, clamping at the edges.
+static void block_fetch(const mip_level* level, u32 block_x, u32 block_y, u8 out_block[64]) {
+    for (u32 y = 0; y < 4; ++y) {
+        u32 py = KMIN(block_y * 4 + y, level->height - 1);
+        for (u32 x = 0; x < 4; ++x) {
+            u32 px = KMIN(block_x * 4 + x, level->width - 1);
+            kcopy_memory(out_block + (y * 4 + x) * 4, level->pixels + ((u64)py * level->width + px) * 4, 4);
+        }
+    }
+}
+
+static u16 rgb_to_565(i32 r, i32 g, i32 b) {
+    return (u16)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static void rgb_from_565(u16 value, i32 out_rgb[3]) {
+    i32 r = (value >> 11) & 31;
+    i32 g = (value >> 5) & 63;
+    i32 b = value & 31;
+    out_rgb[0] = (r << 3) | (r >> 2);
+    out_rgb[1] = (g << 2) | (g >> 4);
+    out_rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Encodes the colour of a block as 8 bytes in the four-colour mode of BC1, with endpoints
+// taken from the (slightly inset) bounding box of the block's colours.
+static void color_block_encode(const u8 block[64], u8* out) {
+    i32 min[3] = {255, 255, 255};
+    i32 max[3] = {0, 0, 0};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < 3; ++c) {
+            min[c] = KMIN(min[c], block[i * 4 + c]);
+            max[c] = KMAX(max[c], block[i * 4 + c]);
+        }
+    }
+    // Insetting the box reduces the error of the colours near its corners.
+    for (u32 c = 0; c < 3; ++c) {
+        i32 inset = (max[c] - min[c]) >> 4;
+        min[c] += inset;
+        max[c] -= inset;
+    }
+
+    u16 c0 = rgb_to_565(max[0], max[1], max[2]);
+    u16 c1 = rgb_to_565(min[0], min[1], min[2]);
+    if (c0 < c1) {
+        u16 temp = c0;
+        c0 = c1;
+        c1 = temp;
+    }
+
+    u32 indices = 0;
+    // With equal endpoints, every index refers to the same colour.
+    if (c0 != c1) {
+        i32 palette[4][3];
+        rgb_from_565(c0, palette[0]);
+        rgb_from_565(c1, palette[1]);
+        for (u32 c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (u32 i = 0; i < 16; ++i) {
+            u32 best = 0;
+            i32 best_distance = 0x7FFFFFFF;
+            for (u32 p = 0; p < 4; ++p) {
+                i32 dr = block[i * 4 + 0] - palette[p][0];
+                i32 dg = block[i * 4 + 1] - palette[p][1];
+                i32 db = block[i * 4 + 2] - palette[p][2];
+                i32 distance = dr * dr + dg * dg + db * db;
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    out[0] = (u8)(c0 & 0xFF);
+    out[1] = (u8)(c0 >> 8);
+    out[2] = (u8)(c1 & 0xFF);
+    out[3] = (u8)(c1 >> 8);
+    out[4] = (u8)(indices & 0xFF);
+    out[5] = (u8)((indices >> 8) & 0xFF);
+    out[6] = (u8)((indices >> 16) & 0xFF);
+    out[7] = (u8)(indices >> 24);
+}
+
+// Encodes one channel of a block as 8 bytes in the eight-value mode of BC4, as used for
+// the alpha of BC3 and both channels of BC5.
+static void channel_block_encode(const u8 block[64], u32 channel, u8* out) {
+    i32 min = 255;
+    i32 max = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        min = KMIN(min, block[i * 4 + channel]);
+        max = KMAX(max, block[i * 4 + channel]);
+    }
+
+    u64 indices = 0;
+    if (max != min) {
+        // Index 0 and 1 are the endpoints, and 2-7 are interpolated between them.
+        i32 palette[8];
+        palette[0] = max;
+        palette[1] = min;
+        for (i32 p = 1; p < 7; ++p) {
+            palette[p + 1] = ((7 - p) * max + p * min) / 7;
+        }
+        for (u32 i = 0; i < 16; ++i) {
+            u64 best = 0;
+            i32 best_distance = 0x7FFFFFFF;
+            for (u32 p = 0; p < 8; ++p) {
+                i32 d = block[i * 4 + channel] - palette[p];
+                if (d * d < best_distance) {
+                    best_distance = d * d;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 3);
+        }
+    }
+
+    out[0] = (u8)max;
+    out[1] = (u8)min;
+    for (u32 i = 0; i < 6; ++i) {
+        out[2 + i] = (u8)((indices >> (i * 8)) & 0xFF);
+    }
+}
+
+// Encodes a level in the given format into out_data, which must be large enough to hold it.
+static void level_encode(const mip_level* level, texture_format format, u8* out_data) {
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        kcopy_memory(out_data, level->pixels, (u64)level->width * level->height * 4);
+        return;
+    }
+
+    u32 blocks_wide = (level->width + 3) / 4;
+    u32 blocks_high = (level->height + 3) / 4;
+    u8 block[64];
+    for (u32 by = 0; by < blocks_high; ++by) {
+        for (u32 bx = 0; bx < blocks_wide; ++bx) {
+            block_fetch(level, bx, by, block);
+            switch (format) {
+                case TEXTURE_FORMAT_BC1:
+                    color_block_encode(block, out_data);
+                    out_data += 8;
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    channel_block_encode(block, 3, out_data);
+                    color_block_encode(block, out_data + 8);
+                    out_data += 16;
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    channel_block_encode(block, 0, out_data);
+                    channel_block_encode(block, 1, out_data + 8);
+                    out_data += 16;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static b8 format_parse(const char* str, b8 has_transparency, texture_format* out_format) {
+    if (strings_equali(str, "auto")) {
+        *out_format = has_transparency ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+    } else if (strings_equali(str, "rgba8")) {
+        *out_format = TEXTURE_FORMAT_RGBA8;
+    } else if (strings_equali(str, "bc1")) {
+        *out_format = TEXTURE_FORMAT_BC1;
+    } else if (strings_equali(str, "bc3")) {
+        *out_format = TEXTURE_FORMAT_BC3;
+    } else if (strings_equali(str, "bc5")) {
+        *out_format = TEXTURE_FORMAT_BC5;
+    } else {
+        // BC7, ETC2 and ASTC can be loaded by the engine, but must be encoded by an external tool.
+        KERROR("Unsupported format '%s'. Supported formats are: auto, rgba8, bc1, bc3, bc5.", str);
+        return false;
+    }
+    return true;
+}
+
+static b8 kbt_file_write(const char* path, const kbt_header* header, const u8* data) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Unable to open file '%s' for writing.", path);
+        return false;
+    }
+
+    resource_header file_header;
+    file_header.magic_number = RESOURCE_MAGIC;
+    file_header.resource_type = RESOURCE_TYPE_IMAGE;
+    file_header.version = KBT_FILE_VERSION;
+    file_header.reserved = 0;
+
+    u64 written = 0;
+    b8 result = filesystem_write(&f, sizeof(resource_header), &file_header, &written) &&
+                filesystem_write(&f, sizeof(kbt_header), header, &written) &&
+                filesystem_write(&f, header->data_size, data, &written);
+    filesystem_close(&f);
+    if (!result) {
+        KERROR("Error writing file '%s'.", path);
+    }
+    return result;
+}
+
+i32 bake_texture(i32 argc, char** argv) {
+    if (argc < 4) {
+        KERROR("Bake mode requires at least an infile and outfile. Usage: infile=[filename] outfile=[filename]");
+        return -3;
+    }
+
+    char in_file_path[1024] = {0};
+    char out_file_path[1024] = {0};
+    char format_str[32] = "auto";
+    b8 flip_y = true;
+    b8 generate_mips = true;
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        char** parts = darray_create(char*);
+        string_split(argv[i], '=', &parts, true, false);
+        if (darray_length(parts) != 2) {
+            KERROR("Unrecognized argument '%s'. Arguments take the form name=value.", argv[i]);
+            string_cleanup_split_array(parts);
+            darray_destroy(parts);
+            return -5;
+        }
+
+        b8 valid = true;
+        if (strings_equali(parts[0], "infile")) {
+            string_ncopy(in_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "outfile")) {
+            string_ncopy(out_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "format")) {
+            string_ncopy(format_str, parts[1], 31);
+        } else if (strings_equali(parts[0], "flip")) {
+            valid = string_to_bool(parts[1], &flip_y);
+        } else if (strings_equali(parts[0], "mips")) {
+            valid = string_to_bool(parts[1], &generate_mips);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'.", argv[i]);
+        }
+        string_cleanup_split_array(parts);
+        darray_destroy(parts);
+        if (!valid) {
+            return -5;
+        }
+    }
+    if (in_file_path[0] == 0 || out_file_path[0] == 0) {
+        KERROR("Parameters infile and outfile are required. Usage: infile=[filename] outfile=[filename]");
+        return -4;
+    }
+
+    // Flip the same way the engine does when loading source images, so baked textures match them.
+    stbi_set_flip_vertically_on_load_thread(flip_y);
+    i32 width, height, channels_in_file;
+    u8* source = stbi_load(in_file_path, &width, &height, &channels_in_file, 4);
+    if (!source) {
+        KERROR("Failed to load file '%s'", in_file_path);
+        return -6;
+    }
+
+    b8 has_transparency = false;
+    u64 pixel_count = (u64)width * height;
+    for (u64 i = 0; i < pixel_count; ++i) {
+        if (source[i * 4 + 3] < 255) {
+            has_transparency = true;
+            break;
+        }
+    }
+
+    texture_format format;
+    if (!format_parse(format_str, has_transparency, &format)) {
+        stbi_image_free(source);
+        return -7;
+    }
+    if (format == TEXTURE_FORMAT_BC1 && has_transparency) {
+        KWARN("Image '%s' has transparency, which BC1 doesn't store. Use bc3 to keep it.", in_file_path);
+    }
+
+    kbt_header header = {0};
+    header.width = (u32)width;
+    header.height = (u32)height;
+    // The number of mip levels is calculated by first taking the largest dimension
+    // (either width or height), figuring out how many times that number can be divided
+    // by 2, taking the floor value (rounding down) and adding 1 to represent the
+    // base level. This always leaves a value of at least 1.
+    header.mip_levels = generate_mips ? (u32)(kfloor(klog2(KMAX(header.width, header.height))) + 1) : 1;
+    header.format = (u8)format;
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+            header.channel_count = 3;
+            break;
+        case TEXTURE_FORMAT_BC5:
+            header.channel_count = 2;
+            break;
+        case TEXTURE_FORMAT_BC3:
+            header.channel_count = 4;
+            break;
+        default:
+            header.channel_count = (u8)channels_in_file;
+            break;
+    }
+    // BC1 and BC5 don't store alpha, so the texture is opaque once baked to them.
+    if (has_transparency && format != TEXTURE_FORMAT_BC1 && format != TEXTURE_FORMAT_BC5) {
+        header.flags |= KBT_FLAG_HAS_TRANSPARENCY;
+    }
+    if (flip_y) {
+        header.flags |= KBT_FLAG_FLIPPED_Y;
+    }
+    header.data_size = texture_format_chain_size(format, header.width, header.height, header.mip_levels);
+
+    u8* data = kallocate(header.data_size, MEMORY_TAG_TEXTURE);
+    u8* write_ptr = data;
+    mip_level level = {header.width, header.height, source};
+    for (u32 i = 0; i < header.mip_levels; ++i) {
+        level_encode(&level, format, write_ptr);
+        write_ptr += texture_format_level_size(format, level.width, level.height);
+
+        if (i + 1 < header.mip_levels) {
+            mip_level next;
+            mip_level_downsample(&level, &next);
+            if (level.pixels != source) {
+                kfree(level.pixels, (u64)level.width * level.height * 4, MEMORY_TAG_TEXTURE);
+            }
+            level = next;
+        }
+    }
+    if (level.pixels != source) {
+        kfree(level.pixels, (u64)level.width * level.height * 4, MEMORY_TAG_TEXTURE);
+    }
+    stbi_image_free(source);
+
+    b8 result = kbt_file_write(out_file_path, &header, data);
+    kfree(data, header.data_size, MEMORY_TAG_TEXTURE);
+    if (!result) {
+        return -9;
+    }
+
+    KINFO("Baked '%s' to '%s' (%ux%u, %u mip levels, %llu bytes).", in_file_path, out_file_path, header.width, header.height, header.mip_levels, header.data_size);
+    return 0;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file kbt_baker.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Bakes source images into .kbt (Kohi binary texture) files, which hold a full
+ * precomputed mip chain, optionally block-compressed, so textures can be loaded straight
+ * into staging memory at runtime without decoding or generating mips.
+ * @version 1.0
+ * @date 2023-11-25
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the bake mode of the tools using the given command line arguments.
+ * Usage: tools bake|kbt infile=[filename] outfile=[filename] [format=auto|rgba8|bc1|bc3|bc5] [flip=1|0] [mips=1|0]
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 bake_texture(i32 argc, char** argv);
@@ -0,0 +1,143 @@
+#include "klog_decoder.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <platform/filesystem.h>
+
+#include <stdio.h>
+
+static const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
+
+i32 decode_log(i32 argc, char** argv) {
+    if (argc < 3) {
+        KERROR("Decode mode requires at least an infile. Usage: infile=[filename] [outfile=[filename]]");
+        return -3;
+    }
+
+    char in_file_path[1024] = {0};
+    char out_file_path[1024] = {0};
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        char** parts = darray_create(char*);
+        string_split(argv[i], '=', &parts, true, false);
+        b8 valid = darray_length(parts) == 2;
+        if (valid && strings_equali(parts[0], "infile")) {
+            string_ncopy(in_file_path, parts[1], 1023);
+        } else if (valid && strings_equali(parts[0], "outfile")) {
+            string_ncopy(out_file_path, parts[1], 1023);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'. Arguments take the form name=value.", argv[i]);
+        }
+        string_cleanup_split_array(parts);
+        darray_destroy(parts);
+        if (!valid) {
+            return -5;
+        }
+    }
+    if (in_file_path[0] == 0) {
+        KERROR("Parameter infile is required. Usage: infile=[filename] [outfile=[filename]]");
+        return -4;
+    }
+
+    file_handle in_file;
+    if (!filesystem_open(in_file_path, FILE_MODE_READ, true, &in_file)) {
+        KERROR("Unable to open '%s' for reading.", in_file_path);
+        return -6;
+    }
+    u64 size = 0;
+    u8* data = 0;
+    b8 read_result = filesystem_size(&in_file, &size) && size >= sizeof(log_binary_file_header);
+    if (read_result) {
+        data = kallocate(size, MEMORY_TAG_ARRAY);
+        u64 read = 0;
+        read_result = filesystem_read_all_bytes(&in_file, data, &read);
+    }
+    filesystem_close(&in_file);
+    if (!read_result) {
+        KERROR("Unable to read '%s'.", in_file_path);
+        if (data) {
+            kfree(data, size, MEMORY_TAG_ARRAY);
+        }
+        return -6;
+    }
+
+    i32 result = 0;
+    // Decoded text goes to the console, unless an outfile is given.
+    file_handle out_file = {0};
+    const char** formats = darray_create(const char*);
+    u64 message_count = 0;
+
+    log_binary_file_header* file_header = (log_binary_file_header*)data;
+    if (file_header->magic != LOG_BINARY_FILE_MAGIC || file_header->version != LOG_BINARY_FILE_VERSION) {
+        KERROR("'%s' is not a binary log of a supported version.", in_file_path);
+        result = -7;
+        goto decode_log_cleanup;
+    }
+    if (out_file_path[0] && !filesystem_open(out_file_path, FILE_MODE_WRITE, false, &out_file)) {
+        KERROR("Unable to open '%s' for writing.", out_file_path);
+        result = -6;
+        goto decode_log_cleanup;
+    }
+
+    u64 offset = sizeof(log_binary_file_header);
+    while (offset + sizeof(log_binary_record_header) <= size) {
+        log_binary_record_header header;
+        kcopy_memory(&header, &data[offset], sizeof(log_binary_record_header));
+        offset += sizeof(log_binary_record_header);
+        if (offset + header.size > size) {
+            // The engine may have stopped part way through a record.
+            KWARN("Binary log ends part way through a record. Remaining data is ignored.");
+            break;
+        }
+        const u8* payload = &data[offset];
+        offset += header.size;
+
+        if (header.type == LOG_BINARY_RECORD_TYPE_FORMAT) {
+            // Formats are written in order of id, and point into the file data.
+            if (header.format_id != darray_length(formats) || header.size == 0 || payload[header.size - 1] != 0) {
+                KERROR("Malformed format record for id %u.", header.format_id);
+                result = -8;
+                break;
+            }
+            const char* format = (const char*)payload;
+            darray_push(formats, format);
+        } else if (header.type == LOG_BINARY_RECORD_TYPE_MESSAGE) {
+            if (header.format_id >= darray_length(formats)) {
+                KERROR("Message refers to unknown format id %u.", header.format_id);
+                result = -8;
+                break;
+            }
+            char text[4096];
+            u8 level = KMIN(header.level, LOG_LEVEL_TRACE);
+            i32 length = log_binary_message_format(formats[header.format_id], payload, header.size, text, sizeof(text));
+            if (length < 0) {
+                string_format(text, "<arguments do not match format '%s'>", formats[header.format_id]);
+            }
+            if (out_file.is_valid) {
+                char line[4200];
+                string_format(line, "%s%s", level_strings[level], text);
+                filesystem_write_line(&out_file, line);
+            } else {
+                printf("%s%s\n", level_strings[level], text);
+            }
+            message_count++;
+        }
+    }
+
+    if (result == 0) {
+        KINFO("Decoded %llu messages using %u formats from '%s'.", message_count, darray_length(formats), in_file_path);
+    }
+
+decode_log_cleanup:
+    if (out_file.is_valid) {
+        filesystem_close(&out_file);
+    }
+    darray_destroy(formats);
+    kfree(data, size, MEMORY_TAG_ARRAY);
+    return result;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file klog_decoder.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Decodes a binary log (console.klog) written by the engine's binary logging into text,
+ * formatting each message with the format string registered for it.
+ * @version 1.0
+ * @date 2023-11-29
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the decode mode of the tools using the given command line arguments.
+ * Usage: tools decode|klog infile=[filename] [outfile=[filename]]
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 decode_log(i32 argc, char** argv);
@@ -0,0 +1,336 @@
+#include "kpak_packer.h"
+
+#include <containers/darray.h>
+#include <core/kcompress.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <platform/filesystem.h>
+#include <resources/kpak.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef KPLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Compressed data is only kept if it saves at least this fraction of the size.
+#define MIN_SAVING 0.1
+
+// A file to be packed.
+typedef struct pack_file {
+    // Path of the file on disk.
+    char* path;
+    // Name of the entry in the archive.
+    char* name;
+    u64 name_hash;
+} pack_file;
+
+// The extensions of files which are either compressed already or meant to be used in place.
+static const char* uncompressed_extensions[] = {".png", ".jpg", ".jpeg", ".kbt", ".ogg", ".mp3", ".kpak"};
+
+static b8 should_compress(const char* name) {
+    u32 count = sizeof(uncompressed_extensions) / sizeof(uncompressed_extensions[0]);
+    u32 length = string_length(name);
+    for (u32 i = 0; i < count; ++i) {
+        u32 ext_length = string_length(uncompressed_extensions[i]);
+        if (length >= ext_length && strings_equali(name + length - ext_length, uncompressed_extensions[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void pack_file_add(const char* path, const char* name, void* user_data) {
+    pack_file** files = user_data;
+    pack_file file;
+    file.path = string_duplicate(path);
+    file.name = string_duplicate(name);
+    file.name_hash = kpak_name_hash(name);
+    darray_push(*files, file);
+}
+
+b8 pack_directory_walk(const char* directory, const char* relative, pfn_pack_file_visit visit, void* user_data) {
+    char path[1024];
+    char name[1024];
+#ifdef KPLATFORM_WINDOWS
+    char pattern[1024];
+    string_format(pattern, "%s/*", directory);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        KERROR("Unable to read directory '%s'.", directory);
+        return false;
+    }
+    b8 result = true;
+    do {
+        const char* entry_name = data.cFileName;
+        if (strings_equal(entry_name, ".") || strings_equal(entry_name, "..")) {
+            continue;
+        }
+        string_format(path, "%s/%s", directory, entry_name);
+        string_format(name, relative[0] ? "%s/%s" : "%s%s", relative, entry_name);
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            result = pack_directory_walk(path, name, visit, user_data);
+        } else {
+            visit(path, name, user_data);
+        }
+    } while (result && FindNextFileA(find, &data));
+    FindClose(find);
+    return result;
+#else
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        KERROR("Unable to read directory '%s'.", directory);
+        return false;
+    }
+    b8 result = true;
+    struct dirent* entry;
+    while (result && (entry = readdir(dir))) {
+        const char* entry_name = entry->d_name;
+        if (strings_equal(entry_name, ".") || strings_equal(entry_name, "..")) {
+            continue;
+        }
+        string_format(path, "%s/%s", directory, entry_name);
+        string_format(name, relative[0] ? "%s/%s" : "%s%s", relative, entry_name);
+        struct stat entry_stat;
+        if (stat(path, &entry_stat) != 0) {
+            KWARN("Unable to stat '%s', skipping it.", path);
+            continue;
+        }
+        if (S_ISDIR(entry_stat.st_mode)) {
+            result = pack_directory_walk(path, name, visit, user_data);
+        } else if (S_ISREG(entry_stat.st_mode)) {
+            visit(path, name, user_data);
+        }
+    }
+    closedir(dir);
+    return result;
+#endif
+}
+
+static i32 pack_file_compare(const void* a, const void* b) {
+    const pack_file* file_a = a;
+    const pack_file* file_b = b;
+    if (file_a->name_hash != file_b->name_hash) {
+        return file_a->name_hash < file_b->name_hash ? -1 : 1;
+    }
+    return 0;
+}
+
+static b8 write_padding(file_handle* f, u64* offset, u64 alignment) {
+    static const u8 zeroes[KPAK_ENTRY_ALIGNMENT] = {0};
+    u64 padding = (alignment - (*offset % alignment)) % alignment;
+    u64 written = 0;
+    if (padding && !filesystem_write(f, padding, zeroes, &written)) {
+        return false;
+    }
+    *offset += padding;
+    return true;
+}
+
+static b8 read_file(const char* path, u8** out_data, u64* out_size) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        return false;
+    }
+    u64 size = 0;
+    b8 result = filesystem_size(&f, &size);
+    *out_data = 0;
+    if (result && size) {
+        *out_data = kallocate(size, MEMORY_TAG_ARRAY);
+        u64 read = 0;
+        result = filesystem_read_all_bytes(&f, *out_data, &read);
+        if (!result) {
+            kfree(*out_data, size, MEMORY_TAG_ARRAY);
+            *out_data = 0;
+        }
+    }
+    filesystem_close(&f);
+    *out_size = size;
+    return result;
+}
+
+i32 pack_assets(i32 argc, char** argv) {
+    if (argc < 4) {
+        KERROR("Pack mode requires at least an indir and outfile. Usage: indir=[directory] outfile=[filename]");
+        return -3;
+    }
+
+    char in_directory[1024] = {0};
+    char out_file_path[1024] = {0};
+    b8 compress = true;
+
+    for (u32 i = 2; i < (u32)argc; ++i) {
+        char** parts = darray_create(char*);
+        string_split(argv[i], '=', &parts, true, false);
+        if (darray_length(parts) != 2) {
+            KERROR("Unrecognized argument '%s'. Arguments take the form name=value.", argv[i]);
+            string_cleanup_split_array(parts);
+            darray_destroy(parts);
+            return -5;
+        }
+
+        b8 valid = true;
+        if (strings_equali(parts[0], "indir")) {
+            string_ncopy(in_directory, parts[1], 1023);
+        } else if (strings_equali(parts[0], "outfile")) {
+            string_ncopy(out_file_path, parts[1], 1023);
+        } else if (strings_equali(parts[0], "compress")) {
+            valid = string_to_bool(parts[1], &compress);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            KERROR("Unrecognized argument '%s'.", argv[i]);
+        }
+        string_cleanup_split_array(parts);
+        darray_destroy(parts);
+        if (!valid) {
+            return -5;
+        }
+    }
+    if (in_directory[0] == 0 || out_file_path[0] == 0) {
+        KERROR("Parameters indir and outfile are required. Usage: indir=[directory] outfile=[filename]");
+        return -4;
+    }
+    // Entry names are looked up with '/' separators and no trailing one.
+    u32 in_length = string_length(in_directory);
+    while (in_length > 1 && (in_directory[in_length - 1] == '/' || in_directory[in_length - 1] == '\\')) {
+        in_directory[--in_length] = 0;
+    }
+
+    pack_file* files = darray_create(pack_file);
+    i32 result = 0;
+    if (!pack_directory_walk(in_directory, "", pack_file_add, &files)) {
+        result = -6;
+        goto pack_assets_cleanup;
+    }
+    u32 file_count = darray_length(files);
+    qsort(files, file_count, sizeof(pack_file), pack_file_compare);
+    for (u32 i = 1; i < file_count; ++i) {
+        // Distinct names sharing a hash are supported, but worth knowing about.
+        if (files[i].name_hash == files[i - 1].name_hash) {
+            KWARN("Entries '%s' and '%s' share a name hash.", files[i - 1].name, files[i].name);
+        }
+    }
+
+    file_handle f;
+    if (!filesystem_open(out_file_path, FILE_MODE_WRITE, true, &f)) {
+        KERROR("Unable to open '%s' for writing.", out_file_path);
+        result = -7;
+        goto pack_assets_cleanup;
+    }
+
+    kpak_entry* entries = kallocate(sizeof(kpak_entry) * KMAX(file_count, 1), MEMORY_TAG_ARRAY);
+    kpak_header header = {0};
+    header.magic = KPAK_MAGIC;
+    header.version = KPAK_VERSION;
+    header.entry_count = file_count;
+
+    // The header is written again once the offsets are known.
+    u64 offset = 0;
+    u64 written = 0;
+    b8 write_result = filesystem_write(&f, sizeof(kpak_header), &header, &written);
+    offset += sizeof(kpak_header);
+
+    u64 raw_total = 0;
+    u64 stored_total = 0;
+    u32 names_size = 0;
+    for (u32 i = 0; i < file_count && write_result; ++i) {
+        u8* data;
+        u64 size;
+        if (!read_file(files[i].path, &data, &size)) {
+            KERROR("Unable to read file '%s'.", files[i].path);
+            write_result = false;
+            break;
+        }
+
+        kpak_entry* entry = &entries[i];
+        entry->name_hash = files[i].name_hash;
+        entry->uncompressed_size = size;
+        entry->compression = KPAK_COMPRESSION_NONE;
+        entry->name_offset = names_size;
+        entry->name_length = (u16)string_length(files[i].name);
+        names_size += entry->name_length + 1;
+
+        const u8* stored = data;
+        u64 stored_size = size;
+        u8* compressed = 0;
+        u64 compressed_capacity = 0;
+        if (compress && size && should_compress(files[i].name)) {
+            compressed_capacity = kcompress_bound(size);
+            compressed = kallocate(compressed_capacity, MEMORY_TAG_ARRAY);
+            u64 compressed_size = kcompress(data, size, compressed, compressed_capacity);
+            if (compressed_size && compressed_size <= (u64)((f64)size * (1.0 - MIN_SAVING))) {
+                stored = compressed;
+                stored_size = compressed_size;
+                entry->compression = KPAK_COMPRESSION_LZ4;
+            }
+        }
+
+        write_result = write_padding(&f, &offset, KPAK_ENTRY_ALIGNMENT);
+        entry->offset = offset;
+        entry->size = stored_size;
+        if (write_result && stored_size) {
+            write_result = filesystem_write(&f, stored_size, stored, &written);
+        }
+        offset += stored_size;
+        raw_total += size;
+        stored_total += stored_size;
+
+        KTRACE("Packed '%s' (%llu -> %llu bytes).", files[i].name, size, stored_size);
+        if (compressed) {
+            kfree(compressed, compressed_capacity, MEMORY_TAG_ARRAY);
+        }
+        if (data) {
+            kfree(data, size, MEMORY_TAG_ARRAY);
+        }
+    }
+
+    if (write_result) {
+        write_result = write_padding(&f, &offset, sizeof(u64));
+        header.toc_offset = offset;
+        if (write_result && file_count) {
+            write_result = filesystem_write(&f, sizeof(kpak_entry) * file_count, entries, &written);
+        }
+        offset += sizeof(kpak_entry) * file_count;
+        header.names_offset = offset;
+        header.names_size = names_size;
+        for (u32 i = 0; i < file_count && write_result; ++i) {
+            write_result = filesystem_write(&f, entries[i].name_length + 1, files[i].name, &written);
+        }
+    }
+    filesystem_close(&f);
+    kfree(entries, sizeof(kpak_entry) * KMAX(file_count, 1), MEMORY_TAG_ARRAY);
+
+    // Now that the offsets are known, fill in the header. The filesystem can't seek or update
+    // files in place, so this is done through stdio.
+    if (write_result) {
+        FILE* patch = fopen(out_file_path, "r+b");
+        write_result = patch && fwrite(&header, sizeof(kpak_header), 1, patch) == 1;
+        if (patch) {
+            fclose(patch);
+        }
+    }
+
+    if (!write_result) {
+        KERROR("Failed to write archive '%s'.", out_file_path);
+        result = -8;
+    } else {
+        KINFO("Packed %u files into '%s' (%llu -> %llu bytes).", file_count, out_file_path, raw_total, stored_total);
+    }
+
+pack_assets_cleanup:
+    for (u32 i = 0; i < darray_length(files); ++i) {
+        string_free(files[i].path);
+        string_free(files[i].name);
+    }
+    darray_destroy(files);
+    return result;
+}
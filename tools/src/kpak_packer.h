@@ -0,0 +1,45 @@
+/**
+ * @file kpak_packer.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Packs a directory of assets into a .kpak archive, which the engine mounts in the
+ * resource system so assets load from one mapped file instead of many loose ones.
+ * @version 1.0
+ * @date 2023-11-27
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Called for each file found by pack_directory_walk.
+ *
+ * @param path The path of the file on disk.
+ * @param name The path of the file relative to the directory walked, with '/' separators.
+ * @param user_data The user data given to the walk.
+ */
+typedef void (*pfn_pack_file_visit)(const char* path, const char* name, void* user_data);
+
+/**
+ * @brief Visits every file under the given directory and its subdirectories, in no particular order.
+ *
+ * @param directory The directory to walk.
+ * @param relative The name the directory is known by, prefixed to the names of its files. "" for the root.
+ * @param visit The function called for each file.
+ * @param user_data Passed to each call of visit.
+ * @return True on success; false if a directory couldn't be read.
+ */
+b8 pack_directory_walk(const char* directory, const char* relative, pfn_pack_file_visit visit, void* user_data);
+
+/**
+ * @brief Runs the pack mode of the tools using the given command line arguments.
+ * Usage: tools pack|kpak indir=[directory] outfile=[filename] [compress=1|0]
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 pack_assets(i32 argc, char** argv);
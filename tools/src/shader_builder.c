@@ -0,0 +1,644 @@
+#include "shader_builder.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/kthread.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <resources/loaders/shader_loader.h>
+#include <resources/resource_types.h>
+#include <systems/shader_system.h>
+
+// For executing the compiler.
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CACHE_PATH "shaders.buildcache"
+#define DEFAULT_JOB_COUNT 4
+#define MAX_JOB_COUNT 64
+// Guards against include cycles.
+#define MAX_INCLUDE_DEPTH 16
+#define PATH_MAX_LENGTH 512
+
+// The stages which may be compiled, by the suffix before .glsl. These are also the glslc stage names.
+static const char* stage_names[] = {"vert", "frag", "geom", "comp"};
+
+// A single stage to be compiled.
+typedef struct shader_build_job {
+    char source_path[PATH_MAX_LENGTH];
+    char output_path[PATH_MAX_LENGTH];
+    const char* stage;
+    // Hash of the source, its includes and the compiler flags.
+    u64 hash;
+    // Set if the output is out of date.
+    b8 compile;
+    b8 succeeded;
+} shader_build_job;
+
+// A source hash from a previous build.
+typedef struct shader_cache_entry {
+    char* source_path;
+    u64 hash;
+} shader_cache_entry;
+
+// A thread compiling every job_stride'th job, starting at first_job.
+typedef struct shader_build_worker {
+    shader_build_job* jobs;
+    u32 first_job;
+    u32 job_stride;
+    const char* compiler;
+    const char* flags;
+    kthread thread;
+} shader_build_worker;
+
+static b8 arg_value_get(const char* arg, const char* key, const char** out_value) {
+    u64 key_length = string_length(key);
+    if (string_length(arg) > key_length && strings_nequali(arg, key, key_length)) {
+        *out_value = arg + key_length;
+        return true;
+    }
+    return false;
+}
+
+static b8 ends_with(const char* str, const char* suffix) {
+    u64 length = string_length(str);
+    u64 suffix_length = string_length(suffix);
+    return length >= suffix_length && strings_equali(str + length - suffix_length, suffix);
+}
+
+// FNV-1a, continued from the given hash.
+static u64 hash_bytes(u64 hash, const void* data, u64 size) {
+    const u8* bytes = data;
+    for (u64 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static b8 read_text(const char* path, char** out_text, u64* out_size) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, false, &f)) {
+        return false;
+    }
+    u64 size = 0;
+    b8 result = filesystem_size(&f, &size);
+    if (result) {
+        *out_text = kallocate(size + 1, MEMORY_TAG_STRING);
+        u64 read = 0;
+        result = filesystem_read_all_text(&f, *out_text, &read);
+        if (result) {
+            (*out_text)[read] = 0;
+            *out_size = read;
+        } else {
+            kfree(*out_text, size + 1, MEMORY_TAG_STRING);
+            *out_text = 0;
+        }
+    }
+    filesystem_close(&f);
+    return result;
+}
+
+// Hashes the file at the given path, followed by every file it includes with #include "name",
+// resolved relative to the including file. Includes with angle brackets are left to the compiler.
+static u64 hash_source(u64 hash, const char* path, u32 depth) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        KWARN("Includes are nested more than %u deep at '%s'. Stopping there.", MAX_INCLUDE_DEPTH, path);
+        return hash;
+    }
+
+    hash = hash_bytes(hash, path, string_length(path));
+    char* text = 0;
+    u64 size = 0;
+    if (!read_text(path, &text, &size)) {
+        // Still hashed by name, so the stage recompiles once the file appears. The compiler reports it.
+        KWARN("Unable to read shader source '%s'.", path);
+        return hash;
+    }
+    hash = hash_bytes(hash, text, size);
+
+    char directory[PATH_MAX_LENGTH] = {0};
+    string_directory_from_path(directory, path);
+
+    const char* line = text;
+    while (line && *line) {
+        const char* c = line;
+        while (*c == ' ' || *c == '\t') {
+            c++;
+        }
+        if (strings_nequal(c, "#include", 8)) {
+            c += 8;
+            while (*c == ' ' || *c == '\t') {
+                c++;
+            }
+            if (*c == '"') {
+                const char* name = c + 1;
+                const char* end = name;
+                while (*end && *end != '"' && *end != '\n') {
+                    end++;
+                }
+                if (*end == '"') {
+                    char include_path[PATH_MAX_LENGTH];
+                    char include_name[PATH_MAX_LENGTH] = {0};
+                    string_ncopy(include_name, name, KMIN((u64)(end - name), PATH_MAX_LENGTH - 1));
+                    string_format(include_path, "%s%s", directory, include_name);
+                    hash = hash_source(hash, include_path, depth + 1);
+                }
+            }
+        }
+        line = strchr(line, '\n');
+        if (line) {
+            line++;
+        }
+    }
+
+    kfree(text, size + 1, MEMORY_TAG_STRING);
+    return hash;
+}
+
+static b8 job_add(shader_build_job** jobs, const char* source_path) {
+    if (!ends_with(source_path, ".glsl")) {
+        KERROR("Shader source '%s' must end in <stage>.glsl.", source_path);
+        return false;
+    }
+    char* stem = string_duplicate(source_path);
+    stem[string_length(stem) - 5] = 0;
+
+    const char* stage = 0;
+    u32 stage_count = sizeof(stage_names) / sizeof(stage_names[0]);
+    for (u32 i = 0; i < stage_count; ++i) {
+        char suffix[8];
+        string_format(suffix, ".%s", stage_names[i]);
+        if (ends_with(stem, suffix)) {
+            stage = stage_names[i];
+            break;
+        }
+    }
+    if (!stage) {
+        KERROR("Unable to determine the stage of '%s'. Supported stages are vert, frag, geom and comp.", source_path);
+        string_free(stem);
+        return false;
+    }
+
+    // The same stage may be named by more than one shader config.
+    u32 job_count = darray_length(*jobs);
+    for (u32 i = 0; i < job_count; ++i) {
+        if (strings_equal((*jobs)[i].source_path, source_path)) {
+            string_free(stem);
+            return true;
+        }
+    }
+
+    shader_build_job job = {0};
+    string_ncopy(job.source_path, source_path, PATH_MAX_LENGTH - 1);
+    string_format(job.output_path, "%s.spv", stem);
+    job.stage = stage;
+    darray_push(*jobs, job);
+    string_free(stem);
+    return true;
+}
+
+// Adds the stage files of a shader config as jobs, and reports the variants its specialization
+// constants allow. Stage files are named relative to the asset directory above the config's.
+static b8 shader_config_add(shader_build_job** jobs, const char* config_path) {
+    file_handle f;
+    if (!filesystem_open(config_path, FILE_MODE_READ, false, &f)) {
+        KERROR("Unable to open shader config '%s'.", config_path);
+        return false;
+    }
+
+    char directory[PATH_MAX_LENGTH] = {0};
+    string_directory_from_path(directory, config_path);
+
+    b8 result = true;
+    char name[256] = {0};
+    u32 specialization_count = 0;
+    u32 switch_count = 0;
+    char line_buf[512] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    while (result && filesystem_read_line(&f, 511, &p, &line_length)) {
+        char* trimmed = string_trim(line_buf);
+        i32 equal_index = string_index_of(trimmed, '=');
+        if (trimmed[0] == '#' || equal_index == -1) {
+            continue;
+        }
+        trimmed[equal_index] = 0;
+        char* var_name = string_trim(trimmed);
+        char* value = string_trim(trimmed + equal_index + 1);
+
+        if (strings_equali(var_name, "name")) {
+            string_ncopy(name, value, 255);
+        } else if (strings_equali(var_name, "stagefiles")) {
+            char** stage_files = darray_create(char*);
+            u32 count = string_split(value, ',', &stage_files, true, false);
+            for (u32 i = 0; result && i < count; ++i) {
+                char source_path[PATH_MAX_LENGTH];
+                string_format(source_path, "%s../%s", directory, stage_files[i]);
+                result = job_add(jobs, source_path);
+            }
+            string_cleanup_split_array(stage_files);
+            darray_destroy(stage_files);
+        } else if (strings_equali(var_name, "specialization")) {
+            // constant_id,name,default value.
+            char** fields = darray_create(char*);
+            u32 count = string_split(value, ',', &fields, true, false);
+            u32 id = 0, default_value = 0;
+            if (count == 3 && string_to_u32(fields[0], &id) && string_to_u32(fields[2], &default_value)) {
+                b8 is_switch = default_value <= 1;
+                KINFO("  Specialization constant '%s' (id %u), default %u%s.", fields[1], id, default_value, is_switch ? ", switch" : "");
+                specialization_count++;
+                switch_count += is_switch ? 1 : 0;
+            } else {
+                KWARN("Invalid specialization '%s' in '%s'. Expected constant_id,name,default.", value, config_path);
+            }
+            string_cleanup_split_array(fields);
+            darray_destroy(fields);
+        }
+    }
+    filesystem_close(&f);
+
+    if (specialization_count) {
+        // Only switches are treated as permutations. Other constants tune a variant rather than define one.
+        u64 permutation_count = 1ULL << KMIN(switch_count, 63);
+        KINFO("Shader '%s': %u specialization constants, %u switches, %llu permutations.", name, specialization_count, switch_count, permutation_count);
+        if (permutation_count > SHADER_MAX_VARIANTS) {
+            KWARN("Shader '%s' allows more permutations than the %u variants a shader may create at runtime.", name, SHADER_MAX_VARIANTS);
+        }
+    }
+    return result;
+}
+
+static b8 cache_load(const char* path, shader_cache_entry** entries) {
+    if (!filesystem_exists(path)) {
+        return true;
+    }
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, false, &f)) {
+        KERROR("Unable to open shader build cache '%s'.", path);
+        return false;
+    }
+    // Each line is: hash source_path
+    char line_buf[PATH_MAX_LENGTH + 32] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    while (filesystem_read_line(&f, sizeof(line_buf) - 1, &p, &line_length)) {
+        char* trimmed = string_trim(line_buf);
+        i32 space_index = string_index_of(trimmed, ' ');
+        if (space_index <= 0) {
+            continue;
+        }
+        trimmed[space_index] = 0;
+        shader_cache_entry entry;
+        if (string_to_u64(trimmed, &entry.hash)) {
+            entry.source_path = string_duplicate(string_trim(trimmed + space_index + 1));
+            darray_push(*entries, entry);
+        }
+    }
+    filesystem_close(&f);
+    return true;
+}
+
+static shader_cache_entry* cache_find(shader_cache_entry* entries, const char* source_path) {
+    u32 count = darray_length(entries);
+    for (u32 i = 0; i < count; ++i) {
+        if (strings_equal(entries[i].source_path, source_path)) {
+            return &entries[i];
+        }
+    }
+    return 0;
+}
+
+static b8 cache_write(const char* path, shader_cache_entry* entries) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("Unable to write shader build cache '%s'.", path);
+        return false;
+    }
+    b8 result = true;
+    char line[PATH_MAX_LENGTH + 32];
+    u32 count = darray_length(entries);
+    for (u32 i = 0; result && i < count; ++i) {
+        // Failed compiles are kept out of the cache, so they are tried again next time.
+        if (entries[i].hash) {
+            string_format(line, "%llu %s", entries[i].hash, entries[i].source_path);
+            result = filesystem_write_line(&f, line);
+        }
+    }
+    filesystem_close(&f);
+    return result;
+}
+
+// Appends a null terminated string to the strings of a bundle, and returns its offset.
+static u32 bundle_string_add(char** strings, const char* str) {
+    u32 offset = darray_length(*strings);
+    u64 length = string_length(str);
+    for (u64 i = 0; i <= length; ++i) {
+        darray_push(*strings, str[i]);
+    }
+    return offset;
+}
+
+// Writes a .ksbundle shader bundle next to the given shader config, holding the parsed config and the compiled
+// code of each of its stages, so that the engine can create the shader from a single read.
+static b8 shader_bundle_write(const char* config_path) {
+    shader_config config;
+    if (!shader_config_parse(config_path, &config)) {
+        shader_config_destroy(&config);
+        return false;
+    }
+    if (!config.name || !config.stage_count) {
+        KERROR("Shader config '%s' has no name or stages, so can't be bundled.", config_path);
+        shader_config_destroy(&config);
+        return false;
+    }
+
+    char directory[PATH_MAX_LENGTH] = {0};
+    string_directory_from_path(directory, config_path);
+
+    b8 result = true;
+    kshader_bundle_header header = {0};
+    char* strings = darray_create(char);
+    u8* code = darray_create(u8);
+    kshader_bundle_attribute* attributes = darray_create(kshader_bundle_attribute);
+    kshader_bundle_uniform* uniforms = darray_create(kshader_bundle_uniform);
+    kshader_bundle_specialization* specializations = darray_create(kshader_bundle_specialization);
+    kshader_bundle_stage* stages = darray_create(kshader_bundle_stage);
+
+    header.name_offset = bundle_string_add(&strings, config.name);
+    header.max_instances = config.max_instances;
+    header.flags = config.flags;
+    header.topology_types = config.topology_types;
+    header.cull_mode = (u8)config.cull_mode;
+    for (u32 i = 0; i < config.attribute_count; ++i) {
+        const shader_attribute_config* a = &config.attributes[i];
+        kshader_bundle_attribute attribute = {bundle_string_add(&strings, a->name), a->type, a->size, a->per_instance, a->packed, 0};
+        darray_push(attributes, attribute);
+    }
+    for (u32 i = 0; i < config.uniform_count; ++i) {
+        const shader_uniform_config* u = &config.uniforms[i];
+        kshader_bundle_uniform uniform = {bundle_string_add(&strings, u->name), u->type, u->scope, u->array_length, u->size, 0};
+        darray_push(uniforms, uniform);
+    }
+    for (u32 i = 0; i < config.specialization_count; ++i) {
+        const shader_specialization_config* s = &config.specializations[i];
+        kshader_bundle_specialization spec = {bundle_string_add(&strings, s->name), s->id, s->default_value};
+        darray_push(specializations, spec);
+    }
+
+    // The compiled stages are found the same way as they were named when added as jobs.
+    for (u32 i = 0; result && i < config.stage_count; ++i) {
+        const shader_stage_config* sc = &config.stage_configs[i];
+        if (!sc->name || !sc->filename) {
+            KERROR("Shader config '%s' names fewer stage files than stages.", config_path);
+            result = false;
+            break;
+        }
+        char stem[PATH_MAX_LENGTH];
+        char spv_path[PATH_MAX_LENGTH];
+        string_format(stem, "%s../%s", directory, sc->filename);
+        if (ends_with(stem, ".glsl")) {
+            stem[string_length(stem) - 5] = 0;
+        }
+        string_format(spv_path, "%s.spv", stem);
+
+        file_handle f;
+        u64 size = 0;
+        if (!filesystem_open(spv_path, FILE_MODE_READ, true, &f)) {
+            KERROR("Unable to open compiled stage '%s'.", spv_path);
+            result = false;
+            break;
+        }
+        result = filesystem_size(&f, &size) && size && size % 4 == 0;
+        if (result) {
+            kshader_bundle_stage stage = {bundle_string_add(&strings, sc->name), bundle_string_add(&strings, sc->filename), sc->stage, darray_length(code), (u32)size};
+            u8* bytes = kallocate(size, MEMORY_TAG_ARRAY);
+            u64 read = 0;
+            result = filesystem_read_all_bytes(&f, bytes, &read) && read == size;
+            for (u64 b = 0; result && b < size; ++b) {
+                darray_push(code, bytes[b]);
+            }
+            kfree(bytes, size, MEMORY_TAG_ARRAY);
+            darray_push(stages, stage);
+        }
+        filesystem_close(&f);
+        if (!result) {
+            KERROR("Compiled stage '%s' is invalid or can't be read.", spv_path);
+        }
+    }
+
+    if (result) {
+        header.stage_count = config.stage_count;
+        header.specialization_count = config.specialization_count;
+        header.attribute_count = config.attribute_count;
+        header.uniform_count = config.uniform_count;
+        header.string_size = darray_length(strings);
+        header.code_size = darray_length(code);
+
+        char stem[PATH_MAX_LENGTH] = {0};
+        char bundle_path[PATH_MAX_LENGTH];
+        string_ncopy(stem, config_path, PATH_MAX_LENGTH - 1);
+        stem[string_length(stem) - string_length(".shadercfg")] = 0;
+        string_format(bundle_path, "%s.ksbundle", stem);
+
+        resource_header file_header = {0};
+        file_header.magic_number = RESOURCE_MAGIC;
+        file_header.resource_type = RESOURCE_TYPE_SHADER;
+        file_header.version = KSHADER_BUNDLE_VERSION;
+
+        file_handle f;
+        u64 written = 0;
+        result = filesystem_open(bundle_path, FILE_MODE_WRITE, true, &f);
+        if (result) {
+            result = filesystem_write(&f, sizeof(resource_header), &file_header, &written) &&
+                     filesystem_write(&f, sizeof(kshader_bundle_header), &header, &written) &&
+                     filesystem_write(&f, sizeof(kshader_bundle_attribute) * header.attribute_count, attributes, &written) &&
+                     filesystem_write(&f, sizeof(kshader_bundle_uniform) * header.uniform_count, uniforms, &written) &&
+                     filesystem_write(&f, sizeof(kshader_bundle_specialization) * header.specialization_count, specializations, &written) &&
+                     filesystem_write(&f, sizeof(kshader_bundle_stage) * header.stage_count, stages, &written) &&
+                     filesystem_write(&f, header.string_size, strings, &written) &&
+                     filesystem_write(&f, header.code_size, code, &written);
+            filesystem_close(&f);
+        }
+        if (result) {
+            KINFO("Bundled shader '%s' to '%s'.", config.name, bundle_path);
+        } else {
+            KERROR("Unable to write shader bundle '%s'.", bundle_path);
+        }
+    }
+
+    darray_destroy(strings);
+    darray_destroy(code);
+    darray_destroy(attributes);
+    darray_destroy(uniforms);
+    darray_destroy(specializations);
+    darray_destroy(stages);
+    shader_config_destroy(&config);
+    return result;
+}
+
+static u32 build_worker(void* params) {
+    shader_build_worker* worker = params;
+    u32 job_count = darray_length(worker->jobs);
+    for (u32 i = worker->first_job; i < job_count; i += worker->job_stride) {
+        shader_build_job* job = &worker->jobs[i];
+        if (!job->compile) {
+            continue;
+        }
+        char command[PATH_MAX_LENGTH * 3];
+        string_format(command, "\"%s\" -fshader-stage=%s %s \"%s\" -o \"%s\"", worker->compiler, job->stage, worker->flags, job->source_path, job->output_path);
+        job->succeeded = system(command) == 0;
+        if (job->succeeded) {
+            KINFO("Compiled '%s'.", job->source_path);
+        } else {
+            KERROR("Failed to compile '%s'.", job->source_path);
+        }
+    }
+    return 0;
+}
+
+i32 build_shaders(i32 argc, char** argv) {
+    if (argc < 3) {
+        KERROR("Build shaders mode requires at least one additional argument.");
+        return -3;
+    }
+
+    const char* flags = "";
+    const char* cache_path = DEFAULT_CACHE_PATH;
+    u32 job_count = DEFAULT_JOB_COUNT;
+    b8 force = false;
+    char compiler[PATH_MAX_LENGTH] = "glslc";
+    const char* sdk_path = getenv("VULKAN_SDK");
+    if (sdk_path) {
+        string_format(compiler, "%s/bin/glslc", sdk_path);
+    }
+
+    i32 error = 0;
+    shader_build_job* jobs = darray_create(shader_build_job);
+    const char** config_paths = darray_create(const char*);
+    for (u32 i = 2; !error && i < (u32)argc; ++i) {
+        const char* value = 0;
+        if (arg_value_get(argv[i], "flags=", &value)) {
+            flags = value;
+        } else if (arg_value_get(argv[i], "cache=", &value)) {
+            cache_path = value;
+        } else if (arg_value_get(argv[i], "compiler=", &value)) {
+            string_ncopy(compiler, value, PATH_MAX_LENGTH - 1);
+        } else if (arg_value_get(argv[i], "jobs=", &value)) {
+            if (!string_to_u32(value, &job_count) || job_count == 0) {
+                KERROR("Invalid job count '%s'.", value);
+                error = -5;
+            }
+        } else if (arg_value_get(argv[i], "force=", &value)) {
+            if (!string_to_bool(value, &force)) {
+                KERROR("Invalid value for force '%s'.", value);
+                error = -5;
+            }
+        } else if (ends_with(argv[i], ".shadercfg")) {
+            KINFO("Shader config '%s':", argv[i]);
+            error = shader_config_add(&jobs, argv[i]) ? 0 : -6;
+            darray_push(config_paths, (const char*)argv[i]);
+        } else {
+            error = job_add(&jobs, argv[i]) ? 0 : -6;
+        }
+    }
+    if (error) {
+        darray_destroy(config_paths);
+        darray_destroy(jobs);
+        return error;
+    }
+
+    shader_cache_entry* entries = darray_create(shader_cache_entry);
+    if (!cache_load(cache_path, &entries)) {
+        darray_destroy(entries);
+        darray_destroy(config_paths);
+        darray_destroy(jobs);
+        return -7;
+    }
+
+    // Anything changing the output changes the hash, so the flags are hashed ahead of each source.
+    u64 flags_hash = hash_bytes(0xcbf29ce484222325ULL, flags, string_length(flags));
+    u32 total_count = darray_length(jobs);
+    u32 compile_count = 0;
+    for (u32 i = 0; i < total_count; ++i) {
+        shader_build_job* job = &jobs[i];
+        job->hash = hash_source(flags_hash, job->source_path, 0);
+        shader_cache_entry* entry = cache_find(entries, job->source_path);
+        job->compile = force || !entry || entry->hash != job->hash || !filesystem_exists(job->output_path);
+        compile_count += job->compile ? 1 : 0;
+    }
+    KINFO("%u of %u shader stages are out of date.", compile_count, total_count);
+
+    u32 worker_count = KMIN(KMIN(job_count, compile_count), MAX_JOB_COUNT);
+    shader_build_worker workers[MAX_JOB_COUNT] = {0};
+    for (u32 i = 0; i < worker_count; ++i) {
+        workers[i].jobs = jobs;
+        workers[i].first_job = i;
+        workers[i].job_stride = worker_count;
+        workers[i].compiler = compiler;
+        workers[i].flags = flags;
+    }
+    // When a thread can't be started, its jobs are compiled here instead.
+    for (u32 i = 1; i < worker_count; ++i) {
+        if (!kthread_create(build_worker, &workers[i], false, &workers[i].thread)) {
+            build_worker(&workers[i]);
+        }
+    }
+    if (worker_count) {
+        build_worker(&workers[0]);
+    }
+    for (u32 i = 1; i < worker_count; ++i) {
+        kthread_wait(&workers[i].thread);
+    }
+
+    u32 failed_count = 0;
+    for (u32 i = 0; i < total_count; ++i) {
+        const shader_build_job* job = &jobs[i];
+        if (!job->compile) {
+            continue;
+        }
+        shader_cache_entry* entry = cache_find(entries, job->source_path);
+        if (!entry) {
+            shader_cache_entry new_entry = {string_duplicate(job->source_path), 0};
+            darray_push(entries, new_entry);
+            entry = &entries[darray_length(entries) - 1];
+        }
+        entry->hash = job->succeeded ? job->hash : 0;
+        failed_count += job->succeeded ? 0 : 1;
+    }
+
+    b8 cache_written = !compile_count || cache_write(cache_path, entries);
+
+    u32 entry_count = darray_length(entries);
+    for (u32 i = 0; i < entry_count; ++i) {
+        string_free(entries[i].source_path);
+    }
+    darray_destroy(entries);
+    darray_destroy(jobs);
+
+    if (failed_count) {
+        darray_destroy(config_paths);
+        KERROR("%u of %u shader stages failed to compile.", failed_count, compile_count);
+        return -8;
+    }
+
+    // Bundles are always rewritten, as they are cheap to build and the config may have changed.
+    u32 bundle_failed_count = 0;
+    u32 config_count = darray_length(config_paths);
+    for (u32 i = 0; i < config_count; ++i) {
+        bundle_failed_count += shader_bundle_write(config_paths[i]) ? 0 : 1;
+    }
+    darray_destroy(config_paths);
+
+    if (!cache_written) {
+        return -9;
+    }
+    if (bundle_failed_count) {
+        KERROR("%u of %u shader bundles failed to build.", bundle_failed_count, config_count);
+        return -10;
+    }
+    KINFO("Successfully built all shaders.");
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file shader_builder.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Compiles GLSL shader stages to SPIR-V with glslc, recompiling only the stages whose
+ * source, included files or compiler flags changed since the last build. A hash of each is kept
+ * in a build cache file, and out of date stages are compiled in parallel.
+ * @version 1.0
+ * @date 2023-12-05
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include <defines.h>
+
+/**
+ * @brief Runs the build shaders mode of the tools using the given command line arguments.
+ * Usage: tools buildshaders|shaders [files...] [flags="..."] [jobs=N] [cache=[filename]]
+ * [compiler=[filename]] [force=1|0]
+ * Files ending in <stage>.glsl are compiled to <stage>.spv next to the source. Files ending
+ * in .shadercfg compile each of their stage files, and report their specialization variants.
+ * Once every stage has compiled, each config is written with the SPIR-V of its stages to a .ksbundle
+ * shader bundle next to it, which the engine loads in place of the config.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on success; otherwise a negative error code.
+ */
+i32 build_shaders(i32 argc, char** argv);
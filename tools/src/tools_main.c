@@ -3,6 +3,14 @@
 #include <core/logger.h>
 #include <defines.h>
 
+#include "asset_cooker.h"
+#include "gltf_importer.h"
+#include "impostor_baker.h"
+#include "kbt_baker.h"
+#include "klog_decoder.h"
+#include "kpak_packer.h"
+#include "shader_builder.h"
+
 // For executing shell commands.
 #include <stdlib.h>
 
@@ -24,8 +32,22 @@ i32 main(i32 argc, char** argv) {
     }
 
     // The second argument tells us what mode to go into.
-    if (strings_equali(argv[1], "combine") || strings_equali(argv[1], "cmaps")) {
+    if (strings_equali(argv[1], "buildshaders") || strings_equali(argv[1], "shaders")) {
+        return build_shaders(argc, argv);
+    } else if (strings_equali(argv[1], "combine") || strings_equali(argv[1], "cmaps")) {
         return combine_texture_maps(argc, argv);
+    } else if (strings_equali(argv[1], "bake") || strings_equali(argv[1], "kbt")) {
+        return bake_texture(argc, argv);
+    } else if (strings_equali(argv[1], "pack") || strings_equali(argv[1], "kpak")) {
+        return pack_assets(argc, argv);
+    } else if (strings_equali(argv[1], "decode") || strings_equali(argv[1], "klog")) {
+        return decode_log(argc, argv);
+    } else if (strings_equali(argv[1], "anim") || strings_equali(argv[1], "ksa")) {
+        return import_skeletal_mesh(argc, argv);
+    } else if (strings_equali(argv[1], "impostor") || strings_equali(argv[1], "kimp")) {
+        return bake_impostor(argc, argv);
+    } else if (strings_equali(argv[1], "cook")) {
+        return cook_assets(argc, argv);
     } else {
         KERROR("Unrecognized argument '%s'.", argv[1]);
         print_help();
@@ -193,11 +215,48 @@ void print_help(void) {
   usage:  tools%s <mode> [arguments...]\n\
   \n\
   modes:\n\
-    buildshaders -  Builds shaders provided in arguments. For example,\n\
+    buildshaders|shaders - Builds shaders provided in arguments. For example,\n\
                     to compile Vulkan shaders to .spv from GLSL, a list of filenames\n\
                     should be provided that all end in <stage>.glsl, where <stage> is\n\
                     replaced by one of the following supported stages:\n\
                         vert, frag, geom, comp\n\
-                    The compiled .spv file is output to the same path as the input file.\n",
+                    The compiled .spv file is output to the same path as the input file.\n\
+                    A .shadercfg may be given instead to build its stage files and list\n\
+                    its specialization variants. Only stages whose source, includes or\n\
+                    flags changed since the last build are compiled.\n\
+                    usage: [files...] [flags=\"...\"] [jobs=N] [cache=[filename]]\n\
+                    [compiler=[filename]] [force=1|0]. The cache defaults to\n\
+                    shaders.buildcache and the compiler to glslc from VULKAN_SDK.\n\
+    bake|kbt -      Bakes an image into a .kbt texture, with a full mip chain.\n\
+                    usage: infile=[filename] outfile=[filename] [format=auto|rgba8|bc1|bc3|bc5]\n\
+                    [flip=1|0] [mips=1|0]. The auto format uses bc3 for images with\n\
+                    transparency and bc1 otherwise. Place the .kbt next to the source image\n\
+                    (i.e. assets/textures/<name>.kbt) for the engine to load it instead.\n\
+    pack|kpak -     Packs a directory of assets into a .kpak archive.\n\
+                    usage: indir=[directory] outfile=[filename] [compress=1|0]\n\
+                    Name the archive after the asset directory (i.e. assets.kpak next to\n\
+                    assets/) for the engine to mount it. Loose files still override it.\n\
+    decode|klog -   Decodes a binary log written by KLOG_BINARY and friends into text.\n\
+                    usage: infile=[filename] [outfile=[filename]]\n\
+                    The engine writes the binary log to console.klog. Text is printed\n\
+                    to the console unless an outfile is given.\n\
+    anim|ksa -      Imports the first skin of a glTF (.gltf or .glb) file, along with the\n\
+                    geometry skinned to it and every animation, into a .ksa skeletal mesh.\n\
+                    usage: infile=[filename] outfile=[filename] [rate=30]\n\
+                    Animations are resampled at rate frames per second. Place the .ksa in\n\
+                    assets/models/ for the engine to load it as a skeletal mesh.\n\
+    impostor|kimp - Bakes octahedral impostor atlases of a .ksm mesh, viewed from\n\
+                    frames x frames directions, into outfile and <outfile>_normal.\n\
+                    usage: infile=[filename] outfile=[filename] [frames=8] [size=128]\n\
+                    [albedo=[filename]]. Each frame is size pixels square. Place the\n\
+                    atlases in assets/textures/ and name them as the impostor of the mesh\n\
+                    in the scene, with the same number of frames, for it to be drawn.\n\
+    cook -          Cooks an asset directory ahead of time and packs it into a .kpak.\n\
+                    Images in textures/ are baked to .kbt, obj meshes in models/ are\n\
+                    imported to .ksm and shader configs in shaders/ are built to .ksbundle.\n\
+                    usage: [indir=assets] [outfile=[filename]] [jobs=N] [cache=[filename]]\n\
+                    [force=1|0] [compress=1|0] [pack=1|0]. Only assets whose source or\n\
+                    dependencies changed are cooked, on as many threads as there are cores.\n\
+                    The cache defaults to assets.cookcache and the archive to <indir>.kpak.\n",
         extension);
 }
@@ -15,7 +15,9 @@
 #include <defines.h>
 
 struct platform_state;
+struct platform_window;
 struct vulkan_context;
+struct vulkan_window;
 
 /**
  * @brief Creates and assigns a surface to the given context.
@@ -25,6 +27,16 @@ struct vulkan_context;
  */
 b8 platform_create_vulkan_surface(struct vulkan_context* context);
 
+/**
+ * @brief Creates a surface for a window created in addition to the main one, and assigns it to the given Vulkan window.
+ * 
+ * @param context A pointer to the Vulkan context.
+ * @param window A pointer to the platform window.
+ * @param out_window A pointer to the Vulkan window to hold the surface.
+ * @return True on success; otherwise false.
+ */
+b8 platform_create_vulkan_window_surface(struct vulkan_context* context, struct platform_window* window, struct vulkan_window* out_window);
+
 /**
  * @brief Appends the names of required extensions for this platform to
  * the names_darray, which should be created and passed in.
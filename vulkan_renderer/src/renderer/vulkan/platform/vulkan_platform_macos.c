@@ -47,4 +47,25 @@ b8 platform_create_vulkan_surface(vulkan_context *context) {
     return true;
 }
 
+b8 platform_create_vulkan_window_surface(vulkan_context *context, struct platform_window *window, vulkan_window *out_window) {
+    macos_handle_info handle = {0};
+    u64 size = 0;
+    platform_window_get_handle_info(window, &size, 0);
+    if (size != sizeof(macos_handle_info)) {
+        return false;
+    }
+    platform_window_get_handle_info(window, &size, &handle);
+
+    VkMetalSurfaceCreateInfoEXT create_info = {VK_STRUCTURE_TYPE_METAL_SURFACE_CREATE_INFO_EXT};
+    create_info.pLayer = handle.layer;
+
+    VkResult result = vkCreateMetalSurfaceEXT(context->instance, &create_info, context->allocator, &out_window->surface);
+    if (result != VK_SUCCESS) {
+        KERROR("Vulkan window surface creation failed.");
+        return false;
+    }
+
+    return true;
+}
+
 #endif
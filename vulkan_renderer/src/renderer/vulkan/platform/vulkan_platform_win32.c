@@ -49,4 +49,26 @@ b8 platform_create_vulkan_surface(vulkan_context *context) {
     return true;
 }
 
+b8 platform_create_vulkan_window_surface(vulkan_context *context, struct platform_window *window, vulkan_window *out_window) {
+    win32_handle_info handle = {0};
+    u64 size = 0;
+    platform_window_get_handle_info(window, &size, 0);
+    if (size != sizeof(win32_handle_info)) {
+        return false;
+    }
+    platform_window_get_handle_info(window, &size, &handle);
+
+    VkWin32SurfaceCreateInfoKHR create_info = {VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR};
+    create_info.hinstance = handle.h_instance;
+    create_info.hwnd = handle.hwnd;
+
+    VkResult result = vkCreateWin32SurfaceKHR(context->instance, &create_info, context->allocator, &out_window->surface);
+    if (result != VK_SUCCESS) {
+        KERROR("Vulkan window surface creation failed.");
+        return false;
+    }
+
+    return true;
+}
+
 #endif
@@ -9,6 +9,7 @@
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "core/metrics.h"
 #include "defines.h"
 #include "math/kmath.h"
 #include "math/math_types.h"
@@ -23,11 +24,21 @@
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
 #include "vulkan_command_buffer.h"
+#include "vulkan_deferred_deletion.h"
+#include "vulkan_descriptor_allocator.h"
 #include "vulkan_device.h"
+#include "vulkan_frame_sync.h"
+#include "vulkan_gpu_profiler.h"
 #include "vulkan_image.h"
+#include "vulkan_memory.h"
+#include "vulkan_mip_downsample.h"
+#include "vulkan_occlusion_query.h"
 #include "vulkan_pipeline.h"
 #include "vulkan_swapchain.h"
+#include "vulkan_upload.h"
 #include "vulkan_types.h"
+#include "vulkan_readback.h"
+#include "vulkan_uniform_ring.h"
 #include "vulkan_utils.h"
 
 // For runtime shader compilation.
@@ -43,6 +54,9 @@
 #define KVULKAN_USE_CUSTOM_ALLOCATOR 1
 #endif
 
+// The file the pipeline cache is loaded from at startup and saved to at shutdown, relative to the working directory.
+#define KVULKAN_PIPELINE_CACHE_PATH "vulkan_pipeline_cache.bin"
+
 VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
     VkDebugUtilsMessageTypeFlagsEXT message_types,
@@ -54,10 +68,44 @@ static i32 find_memory_index(vulkan_context *context, u32 type_filter,
 static void create_command_buffers(vulkan_context *context);
 static b8 recreate_swapchain(vulkan_context *context);
 static b8 create_shader_module(vulkan_context *context, shader *s, shader_stage_config *config, vulkan_shader_stage *out_stage);
+static b8 shader_pipelines_create(vulkan_context *context, shader *s, vulkan_shader *internal_shader, const shader_variant *variant);
+static void shader_pipelines_destroy(vulkan_context *context, vulkan_shader *internal_shader, b8 deferred);
+static void shader_variants_destroy(vulkan_context *context, vulkan_shader *internal_shader, b8 deferred);
 static b8 vulkan_buffer_copy_range_internal(vulkan_context *context,
                                             VkBuffer source, u64 source_offset,
                                             VkBuffer dest, u64 dest_offset,
                                             u64 size);
+static void dynamic_state_defaults_set(renderer_plugin *plugin);
+static vulkan_command_buffer *current_command_buffer_get(vulkan_context *context);
+static vulkan_command_buffer *graphics_command_buffer_get(vulkan_context *context);
+static b8 async_compute_submit(vulkan_context *context);
+static void command_list_destroy(vulkan_context *context, vulkan_command_list *list);
+static vulkan_renderpass_attachment renderpass_attachment_from_description(const VkAttachmentDescription *description);
+static void dynamic_rendering_prepare(renderpass *pass, render_target *target, const viewport *v, vulkan_dynamic_rendering *out_rendering);
+static void dynamic_rendering_begin(vulkan_context *context, VkCommandBuffer command_buffer, const vulkan_dynamic_rendering *rendering, VkRenderingFlagsKHR flags);
+static void dynamic_rendering_end(vulkan_context *context, VkCommandBuffer command_buffer, const vulkan_dynamic_rendering *rendering);
+static b8 bindless_textures_create(vulkan_context *context);
+static void bindless_textures_destroy(vulkan_context *context);
+static void bindless_slot_sync(vulkan_context *context, u32 frame_index, u32 slot_index);
+static void window_resources_destroy(vulkan_context *context, vulkan_window *window);
+
+/**
+ * @brief The per-thread state used while recording a command list. Secondary command
+ * buffers do not inherit dynamic state, so viewport and scissor set outside of a
+ * renderpass are held here and applied to each secondary buffer as it is begun.
+ */
+typedef struct vulkan_command_list_recording {
+    /** @brief The list being recorded on this thread, or 0 if commands go to the primary buffer. */
+    vulkan_command_list *list;
+    /** @brief The secondary command buffer of the renderpass being recorded, if any. */
+    vulkan_command_buffer *buffer;
+    b8 has_viewport;
+    VkViewport viewport;
+    b8 has_scissor;
+    VkRect2D scissor;
+} vulkan_command_list_recording;
+
+static _Thread_local vulkan_command_list_recording recording;
 
 #if KVULKAN_USE_CUSTOM_ALLOCATOR == 1
 /**
@@ -520,7 +568,22 @@ b8 vulkan_renderer_backend_initialize(renderer_plugin *plugin,
         return false;
     }
 
+    // Pipeline cache. Failure is not fatal, pipelines are just created without one.
+    if (!vulkan_pipeline_cache_create(context, KVULKAN_PIPELINE_CACHE_PATH)) {
+        KWARN("Failed to create pipeline cache. Pipelines will be compiled from scratch.");
+    }
+
+    // Device memory allocator, used by all images and buffers from here on.
+    if (!vulkan_memory_allocator_create(context)) {
+        KERROR("Failed to create device memory allocator!");
+        return false;
+    }
+
     // Swapchain
+    context->swapchain_settings.present_mode = config->present_mode;
+    context->swapchain_settings.image_count = config->swapchain_image_count;
+    context->swapchain_settings.frames_in_flight = config->frames_in_flight;
+    context->swapchain.surface = context->surface;
     vulkan_swapchain_create(context, context->framebuffer_width,
                             context->framebuffer_height, config->flags,
                             &context->swapchain);
@@ -532,42 +595,68 @@ b8 vulkan_renderer_backend_initialize(renderer_plugin *plugin,
     // Create command buffers.
     create_command_buffers(context);
 
+    // Async compute command buffers, one per frame in flight as they are only submitted once per frame.
+    // The compute queue belongs to the graphics family, so they come from the same pool.
+    if (context->device.compute_queue) {
+        for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+            vulkan_command_buffer_allocate(context, context->device.graphics_command_pool, true, &context->async_compute_command_buffers[i]);
+        }
+    }
+
     // Create sync objects.
-    context->image_available_semaphores =
-        darray_reserve(VkSemaphore, context->swapchain.max_frames_in_flight);
-    context->queue_complete_semaphores =
-        darray_reserve(VkSemaphore, context->swapchain.max_frames_in_flight);
-
-    for (u8 i = 0; i < context->swapchain.max_frames_in_flight; ++i) {
-        VkSemaphoreCreateInfo semaphore_create_info = {
-            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-        vkCreateSemaphore(context->device.logical_device, &semaphore_create_info,
-                          context->allocator,
-                          &context->image_available_semaphores[i]);
-        vkCreateSemaphore(context->device.logical_device, &semaphore_create_info,
-                          context->allocator,
-                          &context->queue_complete_semaphores[i]);
-
-        // Create the fence in a signaled state, indicating that the first frame has
-        // already been "rendered". This will prevent the application from waiting
-        // indefinitely for the first frame to render since it cannot be rendered
-        // until a frame is "rendered" before it.
-        VkFenceCreateInfo fence_create_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        VK_CHECK(vkCreateFence(context->device.logical_device, &fence_create_info,
-                               context->allocator, &context->in_flight_fences[i]));
+    if (!vulkan_frame_sync_create(context)) {
+        KERROR("Failed to create frame synchronization objects.");
+        return false;
+    }
+
+    // GPU profiling queries.
+    if (!vulkan_gpu_profiler_create(context)) {
+        KERROR("Failed to create GPU profiler.");
+        return false;
+    }
+
+    // Occlusion queries, for the frontend to skip what was hidden.
+    if (!vulkan_occlusion_queries_create(context)) {
+        KERROR("Failed to create occlusion queries.");
+        return false;
     }
 
     // Samplers array.
     context->samplers = darray_create(VkSampler);
+    context->sampler_cache = darray_create(vulkan_sampler_cache_entry);
+
+    // Global bindless texture array, if supported.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_BINDLESS_TEXTURES_BIT) {
+        if (!bindless_textures_create(context)) {
+            KERROR("Failed to create bindless texture resources.");
+            return false;
+        }
+    }
 
-    // Staging buffer.
+    // Uploads, staged through a ring buffer.
     const u64 staging_buffer_size = 256 * 1000 * 1000;
-    if (!renderer_renderbuffer_create("staging", RENDERBUFFER_TYPE_STAGING, staging_buffer_size, RENDERBUFFER_TRACK_TYPE_LINEAR, &context->staging)) {
-        KERROR("Failed to create staging buffer.");
+    if (!vulkan_upload_create(context, staging_buffer_size)) {
+        KERROR("Failed to create upload staging ring.");
+        return false;
+    }
+
+    // Global and instance uniforms are written into a ring each frame.
+    if (!vulkan_uniform_ring_create(context, VULKAN_UNIFORM_RING_FRAME_SIZE)) {
+        KERROR("Failed to create uniform ring.");
+        return false;
+    }
+
+    // Descriptor sets needed for a single frame come from pools reset once their frame completes.
+    if (!vulkan_transient_descriptors_create(context)) {
+        KERROR("Failed to create transient descriptor pools.");
+        return false;
+    }
+
+    // Asynchronous image reads are copied into a ring, and picked up once their frame completes.
+    if (!vulkan_readback_ring_create(context, VULKAN_READBACK_RING_FRAME_SIZE)) {
+        KERROR("Failed to create readback ring.");
         return false;
     }
-    renderer_renderbuffer_bind(&context->staging, 0);
 
     // Create a shader compiler to be used.
     context->shader_compiler = shaderc_compiler_initialize();
@@ -589,30 +678,21 @@ void vulkan_renderer_backend_shutdown(renderer_plugin *plugin) {
 
     // Destroy in the opposite order of creation.
     // Destroy buffers
-    renderer_renderbuffer_destroy(&context->staging);
+    vulkan_readback_ring_destroy(context);
+    vulkan_transient_descriptors_destroy(context);
+    vulkan_uniform_ring_destroy(context);
+    vulkan_upload_destroy(context);
+    vulkan_mip_downsample_destroy(context);
 
-    // Sync objects
-    for (u8 i = 0; i < context->swapchain.max_frames_in_flight; ++i) {
-        if (context->image_available_semaphores[i]) {
-            vkDestroySemaphore(context->device.logical_device,
-                               context->image_available_semaphores[i],
-                               context->allocator);
-            context->image_available_semaphores[i] = 0;
-        }
-        if (context->queue_complete_semaphores[i]) {
-            vkDestroySemaphore(context->device.logical_device,
-                               context->queue_complete_semaphores[i],
-                               context->allocator);
-            context->queue_complete_semaphores[i] = 0;
-        }
-        vkDestroyFence(context->device.logical_device, context->in_flight_fences[i],
-                       context->allocator);
-    }
-    darray_destroy(context->image_available_semaphores);
-    context->image_available_semaphores = 0;
+    vulkan_gpu_profiler_destroy(context);
+    vulkan_occlusion_queries_destroy(context);
 
-    darray_destroy(context->queue_complete_semaphores);
-    context->queue_complete_semaphores = 0;
+    bindless_textures_destroy(context);
+
+    // Command lists
+    for (u32 i = 0; i < RENDERER_MAX_COMMAND_LISTS; ++i) {
+        command_list_destroy(context, &context->command_lists[i]);
+    }
 
     // Command buffers
     for (u32 i = 0; i < context->swapchain.image_count; ++i) {
@@ -624,10 +704,60 @@ void vulkan_renderer_backend_shutdown(renderer_plugin *plugin) {
     }
     darray_destroy(context->graphics_command_buffers);
     context->graphics_command_buffers = 0;
+    if (context->graphics_split_command_buffers) {
+        for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+            if (context->graphics_split_command_buffers[i].handle) {
+                vulkan_command_buffer_free(context, context->device.graphics_command_pool,
+                                           &context->graphics_split_command_buffers[i]);
+            }
+        }
+        darray_destroy(context->graphics_split_command_buffers);
+        context->graphics_split_command_buffers = 0;
+    }
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (context->async_compute_command_buffers[i].handle) {
+            vulkan_command_buffer_free(context, context->device.graphics_command_pool,
+                                       &context->async_compute_command_buffers[i]);
+        }
+    }
+
+    // Any other windows still being rendered to, before the main window's swapchain.
+    for (u32 i = 0; i < VULKAN_MAX_WINDOWS; ++i) {
+        if (context->windows[i]) {
+            window_resources_destroy(context, context->windows[i]);
+            context->windows[i] = 0;
+        }
+    }
 
     // Swapchain
     vulkan_swapchain_destroy(context, &context->swapchain);
 
+    // Sync objects. After the swapchain, which waits on them when destroyed.
+    vulkan_frame_sync_destroy(context);
+
+    // Samplers of texture maps which were never released.
+    if (context->sampler_cache) {
+        u32 sampler_count = darray_length(context->sampler_cache);
+        for (u32 i = 0; i < sampler_count; ++i) {
+            vulkan_deferred_deletion_sampler(context, context->sampler_cache[i].sampler);
+        }
+        darray_destroy(context->sampler_cache);
+        context->sampler_cache = 0;
+    }
+    if (context->samplers) {
+        darray_destroy(context->samplers);
+        context->samplers = 0;
+    }
+
+    // The device is idle, so anything still waiting on frames in flight can go.
+    vulkan_deferred_deletion_flush(context);
+
+    // Everything should already be released, any remaining memory is freed here.
+    vulkan_memory_allocator_destroy(context);
+
+    // Save the pipeline cache for the next run.
+    vulkan_pipeline_cache_destroy(context, KVULKAN_PIPELINE_CACHE_PATH);
+
     KDEBUG("Destroying Vulkan device...");
     vulkan_device_destroy(context);
 
@@ -682,15 +812,9 @@ void vulkan_renderer_backend_on_resized(renderer_plugin *plugin, u16 width,
 b8 vulkan_renderer_frame_prepare(renderer_plugin *plugin, struct frame_data *p_frame_data) {
     // Cold-cast the context
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_device *device = &context->device;
 
     // Check if recreating swap chain and boot out.
     if (context->recreating_swapchain) {
-        VkResult result = vkDeviceWaitIdle(device->logical_device);
-        if (!vulkan_result_is_success(result)) {
-            KERROR("vulkan_renderer_backend_begin_frame vkDeviceWaitIdle (1) failed: '%s'", vulkan_result_string(result, true));
-            return false;
-        }
         KINFO("Recreating swapchain, booting.");
         return false;
     }
@@ -699,12 +823,6 @@ b8 vulkan_renderer_frame_prepare(renderer_plugin *plugin, struct frame_data *p_f
     // created. Also include a vsync changed check.
     if (context->framebuffer_size_generation != context->framebuffer_size_last_generation ||
         context->render_flag_changed) {
-        VkResult result = vkDeviceWaitIdle(device->logical_device);
-        if (!vulkan_result_is_success(result)) {
-            KERROR("vulkan_renderer_backend_begin_frame vkDeviceWaitIdle (2) failed: '%s'", vulkan_result_string(result, true));
-            return false;
-        }
-
         if (context->render_flag_changed) {
             context->render_flag_changed = false;
         }
@@ -719,26 +837,30 @@ b8 vulkan_renderer_frame_prepare(renderer_plugin *plugin, struct frame_data *p_f
         return false;
     }
 
-    // Reset staging buffer.
-    if (!renderer_renderbuffer_clear(&context->staging, false)) {
-        KERROR("Failed to clear staging buffer.");
+    // Wait for the execution of the current frame to complete. The frame being
+    // done will allow this one to move on.
+    f64 wait_start = platform_get_absolute_time();
+    if (!vulkan_frame_sync_wait(context, context->current_frame)) {
         return false;
     }
+    metrics_timer_record(METRICS_TIMER_GPU_WAIT, platform_get_absolute_time() - wait_start);
 
-    // Wait for the execution of the current frame to complete. The fence being
-    // free will allow this one to move on.
-    VkResult result = vkWaitForFences(
-        context->device.logical_device, 1,
-        &context->in_flight_fences[context->current_frame], true, UINT64_MAX);
-    if (!vulkan_result_is_success(result)) {
-        KFATAL("In-flight fence wait failure! error: %s", vulkan_result_string(result, true));
-        return false;
-    }
+    // Heap usage changes as resources come and go, and the budget as other processes use memory.
+    vulkan_memory_budget_report(context);
+
+    // Now that the frame is done, its GPU timings and any asynchronous reads can be read back.
+    vulkan_gpu_profiler_resolve(context, context->current_frame);
+    vulkan_occlusion_queries_resolve(context, context->current_frame);
+    vulkan_readback_ring_frame_begin(context, context->current_frame);
+
+    // The frame last submitted in this slot (and everything before it) is done, so
+    // anything released up until then can now be destroyed.
+    vulkan_deferred_deletion_process(context, context->completed_frame_number);
 
     // Acquire the next image from the swap chain. Pass along the semaphore that
     // should signaled when this completes. This same semaphore will later be
     // waited on by the queue submission to ensure this image is available.
-    result = vkAcquireNextImageKHR(
+    VkResult result = vkAcquireNextImageKHR(
         context->device.logical_device,
         context->swapchain.handle,
         UINT64_MAX,
@@ -755,8 +877,30 @@ b8 vulkan_renderer_frame_prepare(renderer_plugin *plugin, struct frame_data *p_f
         return false;
     }
 
-    // Reset the fence for use on the next frame
-    VK_CHECK(vkResetFences(context->device.logical_device, 1, &context->in_flight_fences[context->current_frame]));
+    vulkan_frame_sync_begin(context, context->current_frame);
+
+    // The wait also guarantees nothing still reads this frame's region of the uniform ring, or its transient descriptor sets.
+    vulkan_uniform_ring_frame_begin(context, context->current_frame);
+    vulkan_descriptor_allocator_reset(context, &context->transient_descriptors[context->current_frame]);
+
+    // The wait guarantees that the command lists recorded for this frame last time around are
+    // no longer in use, so their pools can be reset and buffers reused.
+    for (u32 i = 0; i < RENDERER_MAX_COMMAND_LISTS; ++i) {
+        vulkan_command_list *list = &context->command_lists[i];
+        if (list->pools[context->current_frame]) {
+            VK_CHECK(vkResetCommandPool(context->device.logical_device, list->pools[context->current_frame], 0));
+            list->buffer_used_counts[context->current_frame] = 0;
+        }
+    }
+
+    // The same wait guarantees this frame's bindless set is no longer in use, so bring it up to
+    // date with any textures which have been acquired, released or swapped out since.
+    if (context->bindless_textures) {
+        u32 slot_count = KMIN(darray_length(context->samplers), VULKAN_MAX_BINDLESS_TEXTURES);
+        for (u32 i = 0; i < slot_count; ++i) {
+            bindless_slot_sync(context, context->current_frame, i);
+        }
+    }
 
     return true;
 }
@@ -768,9 +912,19 @@ b8 vulkan_renderer_begin(renderer_plugin *plugin, struct frame_data *p_frame_dat
 
     vulkan_command_buffer_reset(command_buffer);
     vulkan_command_buffer_begin(command_buffer, false, false, false);
+    context->graphics_split = false;
+    context->async_compute_state = VULKAN_ASYNC_COMPUTE_STATE_IDLE;
 
-    // Dynamic state
+    if (plugin->draw_index == 0) {
+        vulkan_gpu_profiler_frame_begin(context, command_buffer->handle);
+        vulkan_occlusion_queries_frame_begin(context, command_buffer->handle, p_frame_data->renderer_frame_number);
+    }
 
+    dynamic_state_defaults_set(plugin);
+    return true;
+}
+
+static void dynamic_state_defaults_set(renderer_plugin *plugin) {
     vulkan_renderer_winding_set(plugin, RENDERER_WINDING_COUNTER_CLOCKWISE);
 
     vulkan_renderer_set_stencil_reference(plugin, 0);
@@ -783,67 +937,121 @@ b8 vulkan_renderer_begin(renderer_plugin *plugin, struct frame_data *p_frame_dat
         RENDERER_COMPARE_OP_ALWAYS);
     vulkan_renderer_set_stencil_test_enabled(plugin, false);
     vulkan_renderer_set_depth_test_enabled(plugin, true);
+    vulkan_renderer_set_depth_compare_op(plugin, RENDERER_COMPARE_OP_LESS);
     // Disable stencil writing.
     vulkan_renderer_set_stencil_write_mask(plugin, 0x00);
-    return true;
+    // Shade every pixel.
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) {
+        vulkan_renderer_shading_rate_set(plugin, RENDERER_SHADING_RATE_1X1);
+    }
 }
 
 b8 vulkan_renderer_end(renderer_plugin *plugin, struct frame_data *p_frame_data) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = graphics_command_buffer_get(context);
 
     vulkan_command_buffer_end(command_buffer);
 
-    // Submit the queue and wait for the operation to complete.
+    // Compute work nothing waited on still has to be submitted, ahead of the frame which waits on it.
+    if (context->async_compute_state == VULKAN_ASYNC_COMPUTE_STATE_PENDING && !async_compute_submit(context)) {
+        return false;
+    }
+
+    // Pending uploads must be submitted first, so this frame sees them.
+    if (!vulkan_upload_flush(context)) {
+        KERROR("Failed to flush pending uploads.");
+        return false;
+    }
+
     // Begin queue submission
-    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    if (!vulkan_frame_sync_submit(context, command_buffer->handle, plugin->draw_index)) {
+        return false;
+    }
+
+    vulkan_command_buffer_update_submitted(command_buffer);
+    // End queue submission
+
+    context->graphics_split = false;
+    context->async_compute_state = VULKAN_ASYNC_COMPUTE_STATE_IDLE;
+    return true;
+}
 
-    // Command buffer(s) to be executed.
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer->handle;
+static b8 async_compute_submit(vulkan_context *context) {
+    vulkan_command_buffer *compute_buffer = &context->async_compute_command_buffers[context->current_frame];
+    vulkan_command_buffer_end(compute_buffer);
 
-    // The semaphore(s) to be signaled when the queue is complete.
-    if (plugin->draw_index == 0) {
-        submit_info.signalSemaphoreCount = 1;
-        submit_info.pSignalSemaphores = &context->queue_complete_semaphores[context->current_frame];
-    } else {
-        submit_info.signalSemaphoreCount = 0;
+    // Uploads the compute work reads must be submitted before it.
+    if (!vulkan_upload_flush(context)) {
+        KERROR("Failed to flush pending uploads.");
+        return false;
     }
+    if (!vulkan_frame_sync_submit_async_compute(context, compute_buffer->handle)) {
+        return false;
+    }
+    vulkan_command_buffer_update_submitted(compute_buffer);
+    context->async_compute_state = VULKAN_ASYNC_COMPUTE_STATE_SUBMITTED;
+    return true;
+}
 
-    // Wait semaphore ensures that the operation cannot begin until the image is
-    // available.
-    if (plugin->draw_index == 0) {
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = &context->image_available_semaphores[context->current_frame];
-    } else {
-        submit_info.waitSemaphoreCount = 0;
+b8 vulkan_renderer_async_compute_begin(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    // Without a spare queue, or outside of the first submission of a frame, the work is recorded inline.
+    // It is submitted once per frame, so anything recorded afterward is inline as well.
+    if (!context->device.compute_queue || plugin->draw_index != 0 || context->async_compute_state == VULKAN_ASYNC_COMPUTE_STATE_SUBMITTED) {
+        return false;
     }
+    if (recording.list) {
+        KERROR("vulkan_renderer_async_compute_begin - Cannot record async compute work while recording a command list.");
+        return false;
+    }
+    if (context->async_compute_recording) {
+        KERROR("vulkan_renderer_async_compute_begin - Async compute work is already being recorded.");
+        return false;
+    }
+
+    if (context->async_compute_state == VULKAN_ASYNC_COMPUTE_STATE_IDLE) {
+        vulkan_command_buffer *compute_buffer = &context->async_compute_command_buffers[context->current_frame];
+        vulkan_command_buffer_reset(compute_buffer);
+        vulkan_command_buffer_begin(compute_buffer, true, false, false);
+        context->async_compute_state = VULKAN_ASYNC_COMPUTE_STATE_PENDING;
+    }
+    context->async_compute_recording = true;
+    return true;
+}
 
-    // Each semaphore waits on the corresponding pipeline stage to complete. 1:1
-    // ratio. VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT prevents subsequent
-    // colour attachment writes from executing until the semaphore signals (i.e.
-    // one frame is presented at a time)
-    VkPipelineStageFlags flags[1] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.pWaitDstStageMask = flags;
+void vulkan_renderer_async_compute_end(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    context->async_compute_recording = false;
+}
 
-    VkResult result =
-        vkQueueSubmit(context->device.graphics_queue, 1, &submit_info,
-                      context->in_flight_fences[context->current_frame]);
-    if (result != VK_SUCCESS) {
-        KERROR("vkQueueSubmit failed with result: %s",
-               vulkan_result_string(result, true));
+b8 vulkan_renderer_async_compute_wait(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (context->async_compute_state != VULKAN_ASYNC_COMPUTE_STATE_PENDING) {
+        return true;
+    }
+    vulkan_command_buffer *command_buffer = graphics_command_buffer_get(context);
+    if (recording.list || context->async_compute_recording || command_buffer->state == COMMAND_BUFFER_STATE_IN_RENDER_PASS) {
+        KERROR("vulkan_renderer_async_compute_wait - Must be called outside of any renderpass, command list or async compute recording.");
         return false;
     }
 
+    // Split the frame here: the part recorded so far overlaps the compute work, and the rest,
+    // submitted when the frame ends, waits on it.
+    vulkan_command_buffer_end(command_buffer);
+    if (!async_compute_submit(context)) {
+        return false;
+    }
+    if (!vulkan_frame_sync_submit_partial(context, command_buffer->handle, plugin->draw_index)) {
+        return false;
+    }
     vulkan_command_buffer_update_submitted(command_buffer);
-    // End queue submission
-
-    // For timing purposes, wait for the queue to complete.
-    // This gives an accurate picture of how long the render takes, including the
-    // work submitted to the actual queue.
-    // TODO: may want a semaphore here instead to monitor this.
-    // vkWaitForFences(context->device.logical_device, 1, &context->in_flight_fences[context->current_frame], true, UINT64_MAX);
 
+    context->graphics_split = true;
+    vulkan_command_buffer *split_buffer = graphics_command_buffer_get(context);
+    vulkan_command_buffer_reset(split_buffer);
+    vulkan_command_buffer_begin(split_buffer, false, false, false);
+    dynamic_state_defaults_set(plugin);
     return true;
 }
 
@@ -851,14 +1059,37 @@ b8 vulkan_renderer_present(renderer_plugin *plugin, struct frame_data *p_frame_d
     // Cold-cast the context
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
 
+    // Other windows rendered to this frame are presented along with the main one, as the frame's
+    // completion covers their rendering too.
+    VkSwapchainKHR swapchains[1 + VULKAN_MAX_WINDOWS];
+    u32 image_indices[1 + VULKAN_MAX_WINDOWS];
+    VkResult results[1 + VULKAN_MAX_WINDOWS];
+    vulkan_window *windows[1 + VULKAN_MAX_WINDOWS];
+    swapchains[0] = context->swapchain.handle;
+    image_indices[0] = context->image_index;
+    windows[0] = 0;
+    u32 swapchain_count = 1;
+    for (u32 i = 0; i < VULKAN_MAX_WINDOWS; ++i) {
+        vulkan_window *window = context->windows[i];
+        if (window && window->acquired_frame_number == context->frame_number) {
+            swapchains[swapchain_count] = window->swapchain.handle;
+            image_indices[swapchain_count] = window->image_index;
+            windows[swapchain_count] = window;
+            swapchain_count++;
+        }
+    }
+    for (u32 i = 0; i < swapchain_count; ++i) {
+        results[i] = VK_SUCCESS;
+    }
+
     // Return the image to the swapchain for presentation.
     VkPresentInfoKHR present_info = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
     present_info.waitSemaphoreCount = 1;
     present_info.pWaitSemaphores = &context->queue_complete_semaphores[context->current_frame];
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = &context->swapchain.handle;
-    present_info.pImageIndices = &context->image_index;
-    present_info.pResults = 0;
+    present_info.swapchainCount = swapchain_count;
+    present_info.pSwapchains = swapchains;
+    present_info.pImageIndices = image_indices;
+    present_info.pResults = results;
 
     // HACK: By waiting on the transfer queue, we avoid a segfault here for some reason. This shouldn't
     // be needed since it _should_ be waiting on the pWaitSemaphores, which _should_ be
@@ -866,7 +1097,18 @@ b8 vulkan_renderer_present(renderer_plugin *plugin, struct frame_data *p_frame_d
     // _transfer_ queue, even though the one being used for presentation here is the present queue.
     // TODO: Need to dive a bit deeper on this to figure it out.
     /* vkQueueWaitIdle(context->device.transfer_queue); */
+    f64 present_start = platform_get_absolute_time();
     VkResult result = vkQueuePresentKHR(context->device.present_queue, &present_info);
+    metrics_timer_record(METRICS_TIMER_PRESENT, platform_get_absolute_time() - present_start);
+    if (swapchain_count > 1 && (result == VK_SUCCESS || result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)) {
+        // The call reports the worst of all windows, so each window goes by its own result.
+        for (u32 i = 1; i < swapchain_count; ++i) {
+            if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR) {
+                windows[i]->recreate_pending = true;
+            }
+        }
+        result = results[0];
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         // Swapchain is out of date, suboptimal or a framebuffer resize has occurred. Trigger swapchain recreation.
         vulkan_swapchain_recreate(context, context->framebuffer_width, context->framebuffer_height, &context->swapchain);
@@ -875,6 +1117,9 @@ b8 vulkan_renderer_present(renderer_plugin *plugin, struct frame_data *p_frame_d
         KFATAL("Failed to present swap chain image!");
     }
 
+    // Pick up any frames which have completed in the meantime, for latency measurement.
+    vulkan_frame_sync_poll(context);
+
     // Increment (and loop) the index.
     context->current_frame = (context->current_frame + 1) % context->swapchain.max_frames_in_flight;
 
@@ -893,8 +1138,16 @@ void vulkan_renderer_viewport_set(renderer_plugin *plugin, vec4 rect) {
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
-    vulkan_command_buffer *command_buffer =
-        &context->graphics_command_buffers[context->image_index];
+    if (recording.list) {
+        // Held for renderpasses begun later on this thread.
+        recording.viewport = viewport;
+        recording.has_viewport = true;
+        if (!recording.buffer) {
+            return;
+        }
+    }
+
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     vkCmdSetViewport(command_buffer->handle, 0, 1, &viewport);
 }
@@ -915,8 +1168,16 @@ void vulkan_renderer_scissor_set(renderer_plugin *plugin, vec4 rect) {
     scissor.extent.width = rect.z;
     scissor.extent.height = rect.w;
 
-    vulkan_command_buffer *command_buffer =
-        &context->graphics_command_buffers[context->image_index];
+    if (recording.list) {
+        // Held for renderpasses begun later on this thread.
+        recording.scissor = scissor;
+        recording.has_scissor = true;
+        if (!recording.buffer) {
+            return;
+        }
+    }
+
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     vkCmdSetScissor(command_buffer->handle, 0, 1, &scissor);
 }
@@ -930,7 +1191,7 @@ void vulkan_renderer_scissor_reset(renderer_plugin *plugin) {
 
 void vulkan_renderer_winding_set(struct renderer_plugin *plugin, renderer_winding winding) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     VkFrontFace vk_winding = winding == RENDERER_WINDING_COUNTER_CLOCKWISE ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
     if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
@@ -992,7 +1253,7 @@ static VkCompareOp vulkan_renderer_get_compare_op(renderer_compare_op op) {
 
 void vulkan_renderer_set_stencil_test_enabled(struct renderer_plugin *plugin, b8 enabled) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
         vkCmdSetStencilTestEnable(command_buffer->handle, (VkBool32)enabled);
@@ -1005,7 +1266,7 @@ void vulkan_renderer_set_stencil_test_enabled(struct renderer_plugin *plugin, b8
 
 void vulkan_renderer_set_depth_test_enabled(struct renderer_plugin *plugin, b8 enabled) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
         vkCmdSetDepthTestEnable(command_buffer->handle, (VkBool32)enabled);
@@ -1016,16 +1277,29 @@ void vulkan_renderer_set_depth_test_enabled(struct renderer_plugin *plugin, b8 e
     }
 }
 
+void vulkan_renderer_set_depth_compare_op(struct renderer_plugin *plugin, renderer_compare_op compare_op) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
+        vkCmdSetDepthCompareOp(command_buffer->handle, vulkan_renderer_get_compare_op(compare_op));
+    } else if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_STATE_BIT) {
+        context->vkCmdSetDepthCompareOpEXT(command_buffer->handle, vulkan_renderer_get_compare_op(compare_op));
+    } else {
+        KFATAL("renderer_set_depth_compare_op cannot be used on a device without dynamic state support.");
+    }
+}
+
 void vulkan_renderer_set_stencil_reference(struct renderer_plugin *plugin, u32 reference) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     vkCmdSetStencilReference(command_buffer->handle, VK_STENCIL_FACE_FRONT_AND_BACK, reference);
 }
 
 void vulkan_renderer_set_stencil_op(struct renderer_plugin *plugin, renderer_stencil_op fail_op, renderer_stencil_op pass_op, renderer_stencil_op depth_fail_op, renderer_compare_op compare_op) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
         vkCmdSetStencilOp(
@@ -1050,7 +1324,7 @@ void vulkan_renderer_set_stencil_op(struct renderer_plugin *plugin, renderer_ste
 
 void vulkan_renderer_set_stencil_compare_mask(struct renderer_plugin *plugin, u32 compare_mask) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     // Supported as of vulkan 1.0, so no need to check for dynamic state support.
     vkCmdSetStencilCompareMask(command_buffer->handle, VK_STENCIL_FACE_FRONT_AND_BACK, compare_mask);
@@ -1058,7 +1332,7 @@ void vulkan_renderer_set_stencil_compare_mask(struct renderer_plugin *plugin, u3
 
 void vulkan_renderer_set_stencil_write_mask(struct renderer_plugin *plugin, u32 write_mask) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
     // Supported as of vulkan 1.0, so no need to check for dynamic state support.
     vkCmdSetStencilWriteMask(command_buffer->handle, VK_STENCIL_FACE_FRONT_AND_BACK, write_mask);
@@ -1067,7 +1341,11 @@ void vulkan_renderer_set_stencil_write_mask(struct renderer_plugin *plugin, u32
 b8 vulkan_renderer_renderpass_begin(renderer_plugin *plugin, renderpass *pass, render_target *target) {
     // Cold-cast the context
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
+    vulkan_command_buffer *command_buffer = graphics_command_buffer_get(context);
+    if (recording.buffer) {
+        KERROR("vulkan_renderer_renderpass_begin - A renderpass is already being recorded on this thread.");
+        return false;
+    }
 
     // Begin the render pass.
     vulkan_renderpass *internal_data = pass->internal_data;
@@ -1087,42 +1365,85 @@ b8 vulkan_renderer_renderpass_begin(renderer_plugin *plugin, renderpass *pass, r
     begin_info.clearValueCount = 0;
     begin_info.pClearValues = 0;
 
-    VkClearValue clear_values[2];
-    kzero_memory(clear_values, sizeof(VkClearValue) * 2);
+    // Each attachment must have a clear value, even if it isn't cleared. These are indexed as the
+    // attachments are, colour attachments first.
+    VkClearValue clear_values[VULKAN_MAX_COLOUR_ATTACHMENTS + 1];
+    kzero_memory(clear_values, sizeof(VkClearValue) * (VULKAN_MAX_COLOUR_ATTACHMENTS + 1));
     b8 do_clear_colour = (pass->clear_flags & RENDERPASS_CLEAR_COLOUR_BUFFER_FLAG) != 0;
-    if (do_clear_colour) {
-        kcopy_memory(clear_values[begin_info.clearValueCount].color.float32, pass->clear_colour.elements, sizeof(f32) * 4);
-        begin_info.clearValueCount++;
-    } else {
-        // If the first attachment is colour, add a clear value anyway, but don't bother copying data since it will be ignored.
-        // This must be done because each attachment must have a clear value, even if it isn't used.
-        if (target->attachments[0].type == RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
-            begin_info.clearValueCount++;
-        }
-    }
-
-    b8 do_clear_depth = (pass->clear_flags & RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG) != 0;
     b8 do_clear_stencil = (pass->clear_flags & RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG) != 0;
-    if (do_clear_depth || do_clear_stencil) {
-        kcopy_memory(clear_values[begin_info.clearValueCount].color.float32, pass->clear_colour.elements, sizeof(f32) * 4);
-        clear_values[begin_info.clearValueCount].depthStencil.depth = internal_data->depth;
-
-        clear_values[begin_info.clearValueCount].depthStencil.stencil = do_clear_stencil ? internal_data->stencil : 0;
-        begin_info.clearValueCount++;
-    } else {
-        for (u32 i = 0; i < target->attachment_count; ++i) {
-            if (target->attachments[i].type & RENDER_TARGET_ATTACHMENT_TYPE_DEPTH || target->attachments[i].type & RENDER_TARGET_ATTACHMENT_TYPE_STENCIL) {
-                // If there is a depth/stencil attachment, make sure to add the clear count, but
-                // don't bother copying the data.
-                begin_info.clearValueCount++;
+    u32 attachment_count = KMIN(target->attachment_count, VULKAN_MAX_COLOUR_ATTACHMENTS + 1);
+    for (u32 i = 0; i < attachment_count; ++i) {
+        render_target_attachment *attachment = &target->attachments[i];
+        if (attachment->type == RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
+            // Attachments cleared by their load operation are cleared to zero.
+            if (do_clear_colour && attachment->load_operation != RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_CLEAR) {
+                kcopy_memory(clear_values[i].color.float32, pass->clear_colour.elements, sizeof(f32) * 4);
             }
+        } else {
+            clear_values[i].depthStencil.depth = internal_data->depth;
+            clear_values[i].depthStencil.stencil = do_clear_stencil ? internal_data->stencil : 0;
         }
     }
+    begin_info.clearValueCount = attachment_count;
 
     begin_info.pClearValues = begin_info.clearValueCount > 0 ? clear_values : 0;
 
-    vkCmdBeginRenderPass(command_buffer->handle, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-    command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
+    if (recording.list) {
+        // Recording a command list. The renderpass is begun on the primary command buffer
+        // when the list is executed, so just hold onto the begin info and record into a
+        // secondary command buffer instead.
+        vulkan_command_list *list = recording.list;
+        if (list->segment_count >= VULKAN_COMMAND_LIST_MAX_SEGMENTS) {
+            KERROR("vulkan_renderer_renderpass_begin - Command list segment limit of %u reached.", VULKAN_COMMAND_LIST_MAX_SEGMENTS);
+            return false;
+        }
+        vulkan_command_list_segment *segment = &list->segments[list->segment_count];
+        kcopy_memory(segment->clear_values, clear_values, sizeof(VkClearValue) * (VULKAN_MAX_COLOUR_ATTACHMENTS + 1));
+        segment->begin_info = begin_info;
+        segment->begin_info.pClearValues = begin_info.clearValueCount > 0 ? segment->clear_values : 0;
+        segment->name = pass->name;
+        segment->dynamic = internal_data->dynamic;
+        if (segment->dynamic) {
+            dynamic_rendering_prepare(pass, target, v, &segment->rendering);
+        }
+
+        // Reuse a secondary buffer from this frame's pool if there is one, otherwise allocate a new one.
+        u32 frame = context->current_frame;
+        segment->buffer_index = list->buffer_used_counts[frame];
+        if (segment->buffer_index >= darray_length(list->buffers[frame])) {
+            vulkan_command_buffer new_buffer;
+            vulkan_command_buffer_allocate(context, list->pools[frame], false, &new_buffer);
+            darray_push(list->buffers[frame], new_buffer);
+        }
+        list->buffer_used_counts[frame]++;
+        list->segment_count++;
+
+        command_buffer = &list->buffers[frame][segment->buffer_index];
+        if (segment->dynamic) {
+            vulkan_command_buffer_begin_secondary_rendering(command_buffer, &segment->rendering);
+        } else {
+            vulkan_command_buffer_begin_secondary(command_buffer, internal_data->handle, target->internal_framebuffer);
+        }
+        recording.buffer = command_buffer;
+
+        // Secondary command buffers do not inherit dynamic state, so it must be set again.
+        dynamic_state_defaults_set(plugin);
+        if (recording.has_viewport) {
+            vkCmdSetViewport(command_buffer->handle, 0, 1, &recording.viewport);
+        }
+        if (recording.has_scissor) {
+            vkCmdSetScissor(command_buffer->handle, 0, 1, &recording.scissor);
+        }
+    } else {
+        vulkan_gpu_profiler_pass_begin(context, command_buffer->handle, pass->name, true);
+        if (internal_data->dynamic) {
+            dynamic_rendering_prepare(pass, target, v, &context->inline_rendering);
+            dynamic_rendering_begin(context, command_buffer->handle, &context->inline_rendering, 0);
+        } else {
+            vkCmdBeginRenderPass(command_buffer->handle, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        }
+        command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
+    }
 
 #ifdef _DEBUG
     f32 r = kfrandom_in_range(0.0f, 1.0f);
@@ -1136,80 +1457,433 @@ b8 vulkan_renderer_renderpass_begin(renderer_plugin *plugin, renderpass *pass, r
 
 b8 vulkan_renderer_renderpass_end(renderer_plugin *plugin, renderpass *pass) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer =
-        &context->graphics_command_buffers[context->image_index];
+    if (recording.list) {
+        if (!recording.buffer) {
+            KERROR("vulkan_renderer_renderpass_end - No renderpass is being recorded on this thread.");
+            return false;
+        }
+        // The renderpass itself is ended on the primary command buffer when the list is executed.
+        VK_END_DEBUG_LABEL(context, recording.buffer->handle);
+        vulkan_command_buffer_end(recording.buffer);
+        recording.buffer = 0;
+        return true;
+    }
+
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+
     // End the renderpass.
-    vkCmdEndRenderPass(command_buffer->handle);
+    if (((vulkan_renderpass *)pass->internal_data)->dynamic) {
+        dynamic_rendering_end(context, command_buffer->handle, &context->inline_rendering);
+    } else {
+        vkCmdEndRenderPass(command_buffer->handle);
+    }
+    vulkan_gpu_profiler_pass_end(context, command_buffer->handle);
     VK_END_DEBUG_LABEL(context, command_buffer->handle);
 
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING;
     return true;
 }
 
-VKAPI_ATTR VkBool32 VKAPI_CALL
-vk_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-                  VkDebugUtilsMessageTypeFlagsEXT message_types,
-                  const VkDebugUtilsMessengerCallbackDataEXT *callback_data,
-                  void *user_data) {
-    switch (message_severity) {
-        default:
-        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-            KERROR(callback_data->pMessage);
-            break;
-        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-            KWARN(callback_data->pMessage);
-            break;
-        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-            KINFO(callback_data->pMessage);
-            break;
-        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-            KTRACE(callback_data->pMessage);
-            break;
+b8 vulkan_renderer_command_list_begin(renderer_plugin *plugin, u8 index) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (index >= RENDERER_MAX_COMMAND_LISTS) {
+        KERROR("vulkan_renderer_command_list_begin - index %u is out of range (max %u).", index, RENDERER_MAX_COMMAND_LISTS);
+        return false;
+    }
+    if (recording.list) {
+        KERROR("vulkan_renderer_command_list_begin - A command list is already being recorded on this thread.");
+        return false;
     }
-    return VK_FALSE;
-}
-
-static i32 find_memory_index(vulkan_context *context, u32 type_filter,
-                             u32 property_flags) {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(context->device.physical_device,
-                                        &memory_properties);
 
-    for (u32 i = 0; i < memory_properties.memoryTypeCount; ++i) {
-        // Check each memory type to see if its bit is set to 1.
-        if (type_filter & (1 << i) &&
-            (memory_properties.memoryTypes[i].propertyFlags & property_flags) ==
-                property_flags) {
-            return i;
+    vulkan_command_list *list = &context->command_lists[index];
+    // Pools are created the first time a list is used. Each list only ever records on one
+    // thread at a time, which satisfies the external synchronization requirement of pools.
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (!list->pools[i]) {
+            VkCommandPoolCreateInfo pool_create_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+            pool_create_info.queueFamilyIndex = context->device.graphics_queue_index;
+            pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            VkResult result = vkCreateCommandPool(context->device.logical_device, &pool_create_info, context->allocator, &list->pools[i]);
+            if (!vulkan_result_is_success(result)) {
+                KERROR("vkCreateCommandPool failed for command list %u: '%s'", index, vulkan_result_string(result, true));
+                return false;
+            }
+            list->buffers[i] = darray_create(vulkan_command_buffer);
+            list->buffer_used_counts[i] = 0;
         }
     }
 
-    KWARN("Unable to find suitable memory type!");
-    return -1;
+    list->segment_count = 0;
+    kzero_memory(&recording, sizeof(vulkan_command_list_recording));
+    recording.list = list;
+    return true;
 }
 
-static void create_command_buffers(vulkan_context *context) {
-    if (!context->graphics_command_buffers) {
-        context->graphics_command_buffers =
-            darray_reserve(vulkan_command_buffer, context->swapchain.image_count);
-        for (u32 i = 0; i < context->swapchain.image_count; ++i) {
-            kzero_memory(&context->graphics_command_buffers[i],
-                         sizeof(vulkan_command_buffer));
-        }
+b8 vulkan_renderer_command_list_end(renderer_plugin *plugin, u8 index) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (index >= RENDERER_MAX_COMMAND_LISTS || recording.list != &context->command_lists[index]) {
+        KERROR("vulkan_renderer_command_list_end - Command list %u is not being recorded on this thread.", index);
+        return false;
     }
 
-    for (u32 i = 0; i < context->swapchain.image_count; ++i) {
-        if (context->graphics_command_buffers[i].handle) {
-            vulkan_command_buffer_free(context, context->device.graphics_command_pool,
-                                       &context->graphics_command_buffers[i]);
-        }
-        kzero_memory(&context->graphics_command_buffers[i],
-                     sizeof(vulkan_command_buffer));
+    b8 result = true;
+    if (recording.buffer) {
+        // Close off the dangling renderpass so the buffer can be reused, but discard what was recorded.
+        KERROR("vulkan_renderer_command_list_end - Command list %u ended within a renderpass.", index);
+        vulkan_command_buffer_end(recording.buffer);
+        recording.list->segment_count = 0;
+        result = false;
+    }
+
+    kzero_memory(&recording, sizeof(vulkan_command_list_recording));
+    return result;
+}
+
+b8 vulkan_renderer_command_list_execute(renderer_plugin *plugin, u8 index) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (index >= RENDERER_MAX_COMMAND_LISTS) {
+        KERROR("vulkan_renderer_command_list_execute - index %u is out of range (max %u).", index, RENDERER_MAX_COMMAND_LISTS);
+        return false;
+    }
+    if (recording.list) {
+        KERROR("vulkan_renderer_command_list_execute - Cannot execute a command list while recording one.");
+        return false;
+    }
+
+    vulkan_command_list *list = &context->command_lists[index];
+    if (!list->segment_count) {
+        return true;
+    }
+
+    vulkan_command_buffer *command_buffer = graphics_command_buffer_get(context);
+    u32 frame = context->current_frame;
+    for (u32 i = 0; i < list->segment_count; ++i) {
+        vulkan_command_list_segment *segment = &list->segments[i];
+        // Pipeline statistics queries can't be active while executing secondary command buffers
+        // without inherited queries, so these are only timed.
+        vulkan_gpu_profiler_pass_begin(context, command_buffer->handle, segment->name, false);
+        if (segment->dynamic) {
+            dynamic_rendering_begin(context, command_buffer->handle, &segment->rendering, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR);
+            vkCmdExecuteCommands(command_buffer->handle, 1, &list->buffers[frame][segment->buffer_index].handle);
+            dynamic_rendering_end(context, command_buffer->handle, &segment->rendering);
+        } else {
+            vkCmdBeginRenderPass(command_buffer->handle, &segment->begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(command_buffer->handle, 1, &list->buffers[frame][segment->buffer_index].handle);
+            vkCmdEndRenderPass(command_buffer->handle);
+        }
+        vulkan_gpu_profiler_pass_end(context, command_buffer->handle);
+    }
+    list->segment_count = 0;
+
+    // Dynamic state of the primary buffer is undefined after executing secondary buffers.
+    dynamic_state_defaults_set(plugin);
+    return true;
+}
+
+static vulkan_command_buffer *current_command_buffer_get(vulkan_context *context) {
+    if (recording.list) {
+        KASSERT_MSG(recording.buffer, "Commands recorded into a command list must be within a renderpass.");
+        return recording.buffer;
+    }
+    if (context->async_compute_recording) {
+        return &context->async_compute_command_buffers[context->current_frame];
+    }
+    return graphics_command_buffer_get(context);
+}
+
+static vulkan_command_buffer *graphics_command_buffer_get(vulkan_context *context) {
+    if (context->graphics_split) {
+        return &context->graphics_split_command_buffers[context->image_index];
+    }
+    return &context->graphics_command_buffers[context->image_index];
+}
+
+static b8 format_has_stencil(VkFormat format) {
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_S8_UINT;
+}
+
+static vulkan_renderpass_attachment renderpass_attachment_from_description(const VkAttachmentDescription *description) {
+    vulkan_renderpass_attachment attachment;
+    attachment.format = description->format;
+    attachment.load_op = description->loadOp;
+    attachment.store_op = description->storeOp;
+    attachment.stencil_load_op = description->stencilLoadOp;
+    attachment.stencil_store_op = description->stencilStoreOp;
+    attachment.initial_layout = description->initialLayout;
+    attachment.final_layout = description->finalLayout;
+    return attachment;
+}
+
+// Fills out a barrier on the part of the image rendered to by a target, which is either one layer
+// of it, or all of them.
+static void attachment_barrier_fill(VkImageMemoryBarrier *barrier, vulkan_image *image, b8 single_layer, u16 layer_index, VkImageAspectFlags aspect) {
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->pNext = 0;
+    barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->image = image->handle;
+    barrier->subresourceRange.aspectMask = aspect;
+    barrier->subresourceRange.baseMipLevel = 0;
+    barrier->subresourceRange.levelCount = 1;
+    barrier->subresourceRange.baseArrayLayer = single_layer ? layer_index : 0;
+    barrier->subresourceRange.layerCount = single_layer ? 1 : VK_REMAINING_ARRAY_LAYERS;
+}
+
+static void dynamic_rendering_prepare(renderpass *pass, render_target *target, const viewport *v, vulkan_dynamic_rendering *out_rendering) {
+    vulkan_renderpass *internal_data = pass->internal_data;
+    kzero_memory(out_rendering, sizeof(vulkan_dynamic_rendering));
+
+    // Multiview passes render to all layers at once, so use the view encapsulating them.
+    b8 is_multiview = internal_data->view_count > 1;
+    b8 do_clear_colour = (pass->clear_flags & RENDERPASS_CLEAR_COLOUR_BUFFER_FLAG) != 0;
+    b8 do_clear_stencil = (pass->clear_flags & RENDERPASS_CLEAR_STENCIL_BUFFER_FLAG) != 0;
+
+    // Previous writes to these attachments must complete, and sampling of any
+    // of them by earlier passes must be done before they are overwritten. The window image is
+    // acquired at the colour output stage, so that stage must always be waited on.
+    out_rendering->begin_src_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    u32 colour_index = 0;
+    for (u32 i = 0; i < target->attachment_count; ++i) {
+        render_target_attachment *attachment = &target->attachments[i];
+        vulkan_image *image = (vulkan_image *)attachment->texture->internal_data;
+        b8 single_layer = image->layer_views && !is_multiview;
+        VkImageView view = single_layer ? image->layer_views[target->layer_index] : image->view;
+
+        VkImageMemoryBarrier *begin_barrier = &out_rendering->begin_barriers[out_rendering->begin_barrier_count];
+        VkImageMemoryBarrier *end_barrier = &out_rendering->end_barriers[out_rendering->end_barrier_count];
+        if (attachment->type == RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
+            if (colour_index >= internal_data->colour_attachment_count) {
+                continue;
+            }
+            const vulkan_renderpass_attachment *desc = &internal_data->colour_attachments[colour_index];
+            VkRenderingAttachmentInfoKHR *info = &out_rendering->colour_attachments[colour_index];
+            info->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            info->imageView = view;
+            info->imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            info->resolveMode = VK_RESOLVE_MODE_NONE;
+            info->loadOp = desc->load_op;
+            info->storeOp = desc->store_op;
+            if (do_clear_colour && attachment->load_operation != RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_CLEAR) {
+                kcopy_memory(info->clearValue.color.float32, pass->clear_colour.elements, sizeof(f32) * 4);
+            }
+            out_rendering->colour_formats[colour_index] = desc->format;
+            colour_index++;
+
+            attachment_barrier_fill(begin_barrier, image, single_layer, target->layer_index, VK_IMAGE_ASPECT_COLOR_BIT);
+            begin_barrier->oldLayout = desc->initial_layout;
+            begin_barrier->newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            begin_barrier->srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            begin_barrier->dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            out_rendering->begin_dst_stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            out_rendering->begin_barrier_count++;
+
+            if (desc->final_layout != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
+                attachment_barrier_fill(end_barrier, image, single_layer, target->layer_index, VK_IMAGE_ASPECT_COLOR_BIT);
+                end_barrier->oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                end_barrier->newLayout = desc->final_layout;
+                end_barrier->srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                out_rendering->end_src_stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                if (desc->final_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+                    end_barrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    out_rendering->end_dst_stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                } else {
+                    // Presentation waits on a semaphore, so only the transition is needed.
+                    end_barrier->dstAccessMask = 0;
+                    out_rendering->end_dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                }
+                out_rendering->end_barrier_count++;
+            }
+        } else if ((attachment->type & RENDER_TARGET_ATTACHMENT_TYPE_DEPTH || attachment->type & RENDER_TARGET_ATTACHMENT_TYPE_STENCIL) && internal_data->has_depth_attachment) {
+            const vulkan_renderpass_attachment *desc = &internal_data->depth_attachment;
+            b8 has_stencil = format_has_stencil(desc->format);
+            VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (has_stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+            VkRenderingAttachmentInfoKHR *info = &out_rendering->depth_attachment;
+            info->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            info->imageView = view;
+            info->imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            info->resolveMode = VK_RESOLVE_MODE_NONE;
+            info->loadOp = desc->load_op;
+            info->storeOp = desc->store_op;
+            info->clearValue.depthStencil.depth = internal_data->depth;
+            info->clearValue.depthStencil.stencil = do_clear_stencil ? internal_data->stencil : 0;
+            out_rendering->info.pDepthAttachment = info;
+            out_rendering->depth_format = desc->format;
+            if (has_stencil) {
+                // The stencil is the same image, but loaded and stored by its own operations.
+                out_rendering->stencil_attachment = *info;
+                out_rendering->stencil_attachment.loadOp = desc->stencil_load_op;
+                out_rendering->stencil_attachment.storeOp = desc->stencil_store_op;
+                out_rendering->info.pStencilAttachment = &out_rendering->stencil_attachment;
+                out_rendering->stencil_format = desc->format;
+            }
+
+            attachment_barrier_fill(begin_barrier, image, single_layer, target->layer_index, aspect);
+            begin_barrier->oldLayout = desc->initial_layout;
+            begin_barrier->newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            begin_barrier->srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            begin_barrier->dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            out_rendering->begin_src_stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            out_rendering->begin_dst_stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            out_rendering->begin_barrier_count++;
+
+            if (desc->final_layout != VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+                attachment_barrier_fill(end_barrier, image, single_layer, target->layer_index, aspect);
+                end_barrier->oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                end_barrier->newLayout = desc->final_layout;
+                end_barrier->srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                end_barrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                out_rendering->end_src_stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                out_rendering->end_dst_stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                out_rendering->end_barrier_count++;
+            }
+        }
+    }
+
+    VkRenderingInfoKHR *info = &out_rendering->info;
+    info->sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    info->renderArea.offset.x = v->rect.x;
+    info->renderArea.offset.y = v->rect.y;
+    info->renderArea.extent.width = v->rect.width;
+    info->renderArea.extent.height = v->rect.height;
+    info->layerCount = 1;
+    info->viewMask = is_multiview ? (1u << internal_data->view_count) - 1 : 0;
+    info->colorAttachmentCount = colour_index;
+    info->pColorAttachments = colour_index ? out_rendering->colour_attachments : 0;
+    if (!out_rendering->begin_dst_stages) {
+        out_rendering->begin_dst_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+}
+
+static void dynamic_rendering_begin(vulkan_context *context, VkCommandBuffer command_buffer, const vulkan_dynamic_rendering *rendering, VkRenderingFlagsKHR flags) {
+    // Performs what the incoming subpass dependency and initial layouts of a renderpass object would.
+    if (rendering->begin_barrier_count) {
+        vkCmdPipelineBarrier(
+            command_buffer,
+            rendering->begin_src_stages, rendering->begin_dst_stages, 0,
+            0, 0, 0, 0,
+            rendering->begin_barrier_count, rendering->begin_barriers);
+    }
+
+    VkRenderingInfoKHR info = rendering->info;
+    info.flags = flags;
+    context->vkCmdBeginRendering(command_buffer, &info);
+}
+
+static void dynamic_rendering_end(vulkan_context *context, VkCommandBuffer command_buffer, const vulkan_dynamic_rendering *rendering) {
+    context->vkCmdEndRendering(command_buffer);
+
+    // Performs what the outgoing subpass dependency and final layouts of a renderpass object would.
+    if (rendering->end_barrier_count) {
+        vkCmdPipelineBarrier(
+            command_buffer,
+            rendering->end_src_stages, rendering->end_dst_stages, 0,
+            0, 0, 0, 0,
+            rendering->end_barrier_count, rendering->end_barriers);
+    }
+}
+
+static void command_list_destroy(vulkan_context *context, vulkan_command_list *list) {
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (list->pools[i]) {
+            // Destroying the pool also frees its buffers.
+            vkDestroyCommandPool(context->device.logical_device, list->pools[i], context->allocator);
+            list->pools[i] = 0;
+        }
+        if (list->buffers[i]) {
+            darray_destroy(list->buffers[i]);
+            list->buffers[i] = 0;
+        }
+        list->buffer_used_counts[i] = 0;
+    }
+    list->segment_count = 0;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL
+vk_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+                  VkDebugUtilsMessageTypeFlagsEXT message_types,
+                  const VkDebugUtilsMessengerCallbackDataEXT *callback_data,
+                  void *user_data) {
+    switch (message_severity) {
+        default:
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
+            KERROR(callback_data->pMessage);
+            break;
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+            KWARN(callback_data->pMessage);
+            break;
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+            KINFO(callback_data->pMessage);
+            break;
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+            KTRACE(callback_data->pMessage);
+            break;
+    }
+    return VK_FALSE;
+}
+
+static i32 find_memory_index(vulkan_context *context, u32 type_filter,
+                             u32 property_flags) {
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(context->device.physical_device,
+                                        &memory_properties);
+
+    for (u32 i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        // Check each memory type to see if its bit is set to 1.
+        if (type_filter & (1 << i) &&
+            (memory_properties.memoryTypes[i].propertyFlags & property_flags) ==
+                property_flags) {
+            return i;
+        }
+    }
+
+    KWARN("Unable to find suitable memory type!");
+    return -1;
+}
+
+static void create_command_buffers(vulkan_context *context) {
+    if (!context->graphics_command_buffers) {
+        context->graphics_command_buffers =
+            darray_reserve(vulkan_command_buffer, context->swapchain.image_count);
+        for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+            kzero_memory(&context->graphics_command_buffers[i],
+                         sizeof(vulkan_command_buffer));
+        }
+    }
+
+    for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+        if (context->graphics_command_buffers[i].handle) {
+            vulkan_command_buffer_free(context, context->device.graphics_command_pool,
+                                       &context->graphics_command_buffers[i]);
+        }
+        kzero_memory(&context->graphics_command_buffers[i],
+                     sizeof(vulkan_command_buffer));
         vulkan_command_buffer_allocate(context,
                                        context->device.graphics_command_pool, true,
                                        &context->graphics_command_buffers[i]);
     }
 
+    // The rest of a frame split to wait on async compute work is recorded to a second buffer.
+    if (context->device.compute_queue) {
+        if (!context->graphics_split_command_buffers) {
+            context->graphics_split_command_buffers =
+                darray_reserve(vulkan_command_buffer, context->swapchain.image_count);
+            for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+                kzero_memory(&context->graphics_split_command_buffers[i], sizeof(vulkan_command_buffer));
+            }
+        }
+        for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+            if (context->graphics_split_command_buffers[i].handle) {
+                vulkan_command_buffer_free(context, context->device.graphics_command_pool,
+                                           &context->graphics_split_command_buffers[i]);
+            }
+            kzero_memory(&context->graphics_split_command_buffers[i], sizeof(vulkan_command_buffer));
+            vulkan_command_buffer_allocate(context, context->device.graphics_command_pool, true,
+                                           &context->graphics_split_command_buffers[i]);
+        }
+    }
+
     KDEBUG("Vulkan command buffers created.");
 }
 
@@ -1231,14 +1905,13 @@ static b8 recreate_swapchain(vulkan_context *context) {
     // Mark as recreating if the dimensions are valid.
     context->recreating_swapchain = true;
 
-    // Wait for any operations to complete.
-    vkDeviceWaitIdle(context->device.logical_device);
-
-    // Requery support
-    vulkan_device_query_swapchain_support(context->device.physical_device,
-                                          context->surface,
-                                          &context->device.swapchain_support);
-    vulkan_device_detect_depth_format(&context->device);
+    // Wait for the frames in flight to complete, as their command buffers and render targets are
+    // replaced. Only rendering needs to finish, not the whole device or presentation, since the
+    // swapchain hands its old images over as it is recreated.
+    if (!vulkan_frame_sync_wait_frames(context)) {
+        context->recreating_swapchain = false;
+        return false;
+    }
 
     vulkan_swapchain_recreate(context, context->framebuffer_width,
                               context->framebuffer_height, &context->swapchain);
@@ -1266,6 +1939,81 @@ static b8 recreate_swapchain(vulkan_context *context) {
     return true;
 }
 
+static VkFormat texture_format_to_vulkan(texture_format format) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC3:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC5:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case TEXTURE_FORMAT_BC7:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        case TEXTURE_FORMAT_ETC2_RGBA8:
+            return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+        case TEXTURE_FORMAT_ASTC_4X4:
+            return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+        case TEXTURE_FORMAT_RGBA16F:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case TEXTURE_FORMAT_R16F:
+            return VK_FORMAT_R16_SFLOAT;
+        case TEXTURE_FORMAT_RGBA8:
+        default:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+b8 vulkan_renderer_texture_format_supported(renderer_plugin *plugin, texture_format format) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    // Each family of compressed formats is enabled as a device feature.
+    VkBool32 feature_enabled;
+    switch (format) {
+        case TEXTURE_FORMAT_RGBA8:
+            return true;
+        case TEXTURE_FORMAT_BC1:
+        case TEXTURE_FORMAT_BC3:
+        case TEXTURE_FORMAT_BC5:
+        case TEXTURE_FORMAT_BC7:
+            feature_enabled = context->device.features.textureCompressionBC;
+            break;
+        case TEXTURE_FORMAT_ETC2_RGBA8:
+            feature_enabled = context->device.features.textureCompressionETC2;
+            break;
+        case TEXTURE_FORMAT_ASTC_4X4:
+            feature_enabled = context->device.features.textureCompressionASTC_LDR;
+            break;
+        case TEXTURE_FORMAT_RGBA16F:
+        case TEXTURE_FORMAT_R16F:
+            feature_enabled = VK_TRUE;
+            break;
+        default:
+            return false;
+    }
+    if (!feature_enabled) {
+        return false;
+    }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context->device.physical_device, texture_format_to_vulkan(format), &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if (texture_format_is_float(format)) {
+        // Float formats are only rendered to, and blended into.
+        required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT;
+    }
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+// How the generated mips of a texture are filtered, from what it holds.
+static vulkan_mip_filter texture_mip_filter_get(const texture *t) {
+    if (t->flags & TEXTURE_FLAG_IS_NORMAL_MAP) {
+        return VULKAN_MIP_FILTER_NORMAL_MAP;
+    }
+    if (t->flags & TEXTURE_FLAG_IS_SRGB) {
+        return VULKAN_MIP_FILTER_SRGB;
+    }
+    return VULKAN_MIP_FILTER_LINEAR;
+}
+
 void vulkan_renderer_texture_create(renderer_plugin *plugin, const u8 *pixels,
                                     texture *t) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
@@ -1274,21 +2022,34 @@ void vulkan_renderer_texture_create(renderer_plugin *plugin, const u8 *pixels,
     t->internal_data =
         (vulkan_image *)kallocate(sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
     vulkan_image *image = (vulkan_image *)t->internal_data;
-    u32 size = t->width * t->height * t->channel_count *
-               (t->type == TEXTURE_TYPE_CUBE ? 6 : t->array_size);
+    u32 layer_count = t->type == TEXTURE_TYPE_CUBE ? 6 : t->array_size;
+    u32 size;
+    if (t->flags & TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS) {
+        size = (u32)texture_format_chain_size(t->format, t->width, t->height, t->mip_levels) * layer_count;
+    } else {
+        size = t->width * t->height * t->channel_count * layer_count;
+    }
 
-    // NOTE: Assumes 8 bits per channel.
-    VkFormat image_format = VK_FORMAT_R8G8B8A8_UNORM;
+    // NOTE: Assumes 8 bits per channel for uncompressed formats.
+    VkFormat image_format = texture_format_to_vulkan(t->format);
 
     // NOTE: Lots of assumptions here, different texture types will require
     // different options here.
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (!texture_format_is_compressed(t->format)) {
+        // Block-compressed formats can't be rendered to.
+        usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    }
+    // Generated mips are written by compute where possible.
+    if (!(t->flags & TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS) && vulkan_mip_downsample_supported(context, image_format, t->width, t->height, t->mip_levels, t->array_size)) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
     vulkan_image_create(
         context, t->type, t->width, t->height, t->array_size, image_format,
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        VK_IMAGE_TILING_OPTIMAL, usage,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, VK_IMAGE_ASPECT_COLOR_BIT,
         t->name, t->mip_levels, image);
+    image->mip_filter = texture_mip_filter_get(t);
 
     // Load the data.
     vulkan_renderer_texture_write_data(plugin, t, 0, size, pixels);
@@ -1296,15 +2057,44 @@ void vulkan_renderer_texture_create(renderer_plugin *plugin, const u8 *pixels,
     t->generation++;
 }
 
+void vulkan_renderer_texture_create_layered(renderer_plugin *plugin, const u8 *const *layer_pixels,
+                                            texture *t) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    t->internal_data =
+        (vulkan_image *)kallocate(sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
+    vulkan_image *image = (vulkan_image *)t->internal_data;
+
+    // NOTE: Layers are only ever uncompressed, 8 bits per channel.
+    VkFormat image_format = texture_format_to_vulkan(t->format);
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (vulkan_mip_downsample_supported(context, image_format, t->width, t->height, t->mip_levels, t->array_size)) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    vulkan_image_create(
+        context, t->type, t->width, t->height, t->array_size, image_format,
+        VK_IMAGE_TILING_OPTIMAL, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, VK_IMAGE_ASPECT_COLOR_BIT,
+        t->name, t->mip_levels, image);
+    image->mip_filter = texture_mip_filter_get(t);
+
+    // Each layer is staged straight from its own pixels. Returns immediately, the copy happens once pending uploads are flushed.
+    u64 layer_size = (u64)t->width * t->height * t->channel_count;
+    if (!vulkan_upload_image_layers(context, image, image_format, t->channel_count, layer_size, (const void *const *)layer_pixels)) {
+        KERROR("Failed to upload layers for texture '%s'.", t->name);
+        return;
+    }
+
+    t->generation++;
+}
+
 void vulkan_renderer_texture_destroy(renderer_plugin *plugin,
                                      struct texture *texture) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vkDeviceWaitIdle(context->device.logical_device);
 
     vulkan_image *image = (vulkan_image *)texture->internal_data;
     if (image) {
-        vulkan_image_destroy(context, image);
-        kzero_memory(image, sizeof(vulkan_image));
+        // Frames in flight may still be using the image, so it is destroyed once they retire.
+        vulkan_deferred_deletion_image(context, image);
 
         kfree(texture->internal_data, sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
     }
@@ -1327,6 +2117,17 @@ static VkFormat channel_count_to_format(u8 channel_count,
     }
 }
 
+// Storage images are moved to the general layout once at creation and kept there.
+static void storage_image_layout_initialize(vulkan_context *context, vulkan_image *image, VkFormat format) {
+    vulkan_upload_flush(context);
+    vulkan_command_buffer temp_command_buffer;
+    VkCommandPool pool = context->device.graphics_command_pool;
+    VkQueue queue = context->device.graphics_queue;
+    vulkan_command_buffer_allocate_and_begin_single_use(context, pool, &temp_command_buffer);
+    vulkan_image_transition_layout(context, &temp_command_buffer, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    vulkan_command_buffer_end_single_use(context, pool, &temp_command_buffer, queue);
+}
+
 void vulkan_renderer_texture_create_writeable(renderer_plugin *plugin, texture *t) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     // Internal data creation.
@@ -1343,8 +2144,15 @@ void vulkan_renderer_texture_create_writeable(renderer_plugin *plugin, texture *
     } else {
         usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
                 VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (t->flags & TEXTURE_FLAG_IS_STORAGE) {
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        }
         aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-        image_format = channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
+        image_format = t->format != TEXTURE_FORMAT_RGBA8 ? texture_format_to_vulkan(t->format) : channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
+    }
+    if (t->flags & TEXTURE_FLAG_MEMORYLESS) {
+        // Only ever rendered to, so it may be lazily allocated.
+        usage = (t->flags & TEXTURE_FLAG_DEPTH ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     }
 
     vulkan_image_create(context, t->type, t->width, t->height, t->array_size, image_format,
@@ -1352,6 +2160,10 @@ void vulkan_renderer_texture_create_writeable(renderer_plugin *plugin, texture *
                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, aspect,
                         t->name, t->mip_levels, image);
 
+    if (t->flags & TEXTURE_FLAG_IS_STORAGE) {
+        storage_image_layout_initialize(context, image, image_format);
+    }
+
     t->generation++;
 }
 
@@ -1363,10 +2175,9 @@ void vulkan_renderer_texture_resize(renderer_plugin *plugin, texture *t,
         // Data is not preserved because there's no reliable way to map the old data
         // to the new since the amount of data differs.
         vulkan_image *image = (vulkan_image *)t->internal_data;
-        vulkan_image_destroy(context, image);
+        vulkan_deferred_deletion_image(context, image);
 
-        VkFormat image_format =
-            channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
+        VkFormat image_format = t->format != TEXTURE_FORMAT_RGBA8 ? texture_format_to_vulkan(t->format) : channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
 
         // Recalculate mip levels if anything other than 1.
         if (t->mip_levels > 1) {
@@ -1380,14 +2191,24 @@ void vulkan_renderer_texture_resize(renderer_plugin *plugin, texture *t,
 
         // TODO: Lots of assumptions here, different texture types will require
         // different options here.
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (t->flags & TEXTURE_FLAG_IS_STORAGE) {
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        }
+        if (t->flags & TEXTURE_FLAG_MEMORYLESS) {
+            usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
         vulkan_image_create(
             context, t->type, new_width, new_height, t->array_size, image_format,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            VK_IMAGE_TILING_OPTIMAL, usage,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, VK_IMAGE_ASPECT_COLOR_BIT,
             t->name, t->mip_levels, image);
 
+        if (t->flags & TEXTURE_FLAG_IS_STORAGE) {
+            storage_image_layout_initialize(context, image, image_format);
+        }
+
         t->generation++;
     }
 }
@@ -1398,38 +2219,44 @@ void vulkan_renderer_texture_write_data(renderer_plugin *plugin, texture *t,
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     vulkan_image *image = (vulkan_image *)t->internal_data;
 
-    VkFormat image_format =
-        channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
-
-    // Staging buffer.
-    u64 staging_offset = 0;
-    renderer_renderbuffer_allocate(&context->staging, size, &staging_offset);
-    vulkan_buffer_load_range(plugin, &context->staging, staging_offset, size, pixels);
+    VkFormat image_format;
+    u32 texel_size;
+    if (texture_format_is_compressed(t->format)) {
+        image_format = texture_format_to_vulkan(t->format);
+        // The size of a single block.
+        texel_size = (u32)texture_format_level_size(t->format, 4, 4);
+    } else {
+        image_format = channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
+        texel_size = t->channel_count;
+    }
 
-    vulkan_command_buffer temp_command_buffer;
-    VkCommandPool pool = context->device.graphics_command_pool;
-    VkQueue queue = context->device.graphics_queue;
-    vulkan_command_buffer_allocate_and_begin_single_use(context, pool, &temp_command_buffer);
+    // Returns immediately, the copy happens once pending uploads are flushed.
+    const texture_format *levels_format = (t->flags & TEXTURE_FLAG_HAS_PRECOMPUTED_MIPS) ? &t->format : 0;
+    if (!vulkan_upload_image(context, image, image_format, texel_size, size, pixels, levels_format)) {
+        KERROR("Failed to upload data for texture '%s'.", t->name);
+        return;
+    }
 
-    // Transition the layout from whatever it is currently to optimal for
-    // recieving data.
-    vulkan_image_transition_layout(context, &temp_command_buffer, image,
-                                   image_format, VK_IMAGE_LAYOUT_UNDEFINED,
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    t->generation++;
+}
 
-    // Copy the data from the buffer.
-    vulkan_image_copy_from_buffer(context, image, ((vulkan_buffer *)context->staging.internal_data)->handle, staging_offset, &temp_command_buffer);
+void vulkan_renderer_texture_write_region(renderer_plugin *plugin, texture *t,
+                                          u32 x, u32 y, u32 width, u32 height,
+                                          const u8 *pixels) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_image *image = (vulkan_image *)t->internal_data;
 
-    if (t->mip_levels <= 1 || !vulkan_image_mipmaps_generate(context, image, &temp_command_buffer)) {
-        // If mip generation isn't needed or fails, fall back to ordinary transition.
-        // Transition from optimal for data reciept to shader-read-only optimal layout.
-        vulkan_image_transition_layout(context, &temp_command_buffer, image,
-                                       image_format,
-                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (texture_format_is_compressed(t->format)) {
+        KERROR("Regions cannot be written to compressed texture '%s'.", t->name);
+        return;
     }
+    VkFormat image_format = channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
 
-    vulkan_command_buffer_end_single_use(context, pool, &temp_command_buffer, queue);
+    // Returns immediately, the copy happens once pending uploads are flushed.
+    if (!vulkan_upload_image_region(context, image, image_format, t->channel_count, x, y, width, height, pixels)) {
+        KERROR("Failed to upload region of texture '%s'.", t->name);
+        return;
+    }
 
     t->generation++;
 }
@@ -1455,17 +2282,23 @@ void vulkan_renderer_texture_read_data(renderer_plugin *plugin, texture *t,
     }
     renderer_renderbuffer_bind(&staging, 0);
 
+    // Pending uploads to the texture must complete first.
+    vulkan_upload_flush(context);
+
     vulkan_command_buffer temp_buffer;
     VkCommandPool pool = context->device.graphics_command_pool;
     VkQueue queue = context->device.graphics_queue;
     vulkan_command_buffer_allocate_and_begin_single_use(context, pool,
                                                         &temp_buffer);
 
+    // Storage images hold what compute shaders wrote to them, so must keep their contents and layout.
+    b8 is_storage = (t->flags & TEXTURE_FLAG_IS_STORAGE) != 0;
+
     // NOTE: transition to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
     // Transition the layout from whatever it is currently to optimal for handing
     // out data.
     vulkan_image_transition_layout(context, &temp_buffer, image,
-                                   image_format, VK_IMAGE_LAYOUT_UNDEFINED,
+                                   image_format, is_storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 
     // Copy the data to the buffer.
@@ -1473,7 +2306,12 @@ void vulkan_renderer_texture_read_data(renderer_plugin *plugin, texture *t,
                                 ((vulkan_buffer *)staging.internal_data)->handle,
                                 &temp_buffer);
 
-    if (t->mip_levels <= 1 || !vulkan_image_mipmaps_generate(context, image, &temp_buffer)) {
+    if (is_storage) {
+        vulkan_image_transition_layout(context, &temp_buffer, image,
+                                       image_format,
+                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       VK_IMAGE_LAYOUT_GENERAL);
+    } else if (t->mip_levels <= 1 || !vulkan_image_mipmaps_generate(context, image, &temp_buffer)) {
         // If mip generation isn't needed or fails, fall back to ordinary transition.
         // Transition from optimal for data reciept to shader-read-only optimal layout.
         vulkan_image_transition_layout(context, &temp_buffer, image,
@@ -1514,6 +2352,9 @@ void vulkan_renderer_texture_read_pixel(renderer_plugin *plugin, texture *t,
     }
     renderer_renderbuffer_bind(&staging, 0);
 
+    // Pending uploads to the texture must complete first.
+    vulkan_upload_flush(context);
+
     vulkan_command_buffer temp_buffer;
     VkCommandPool pool = context->device.graphics_command_pool;
     VkQueue queue = context->device.graphics_queue;
@@ -1529,7 +2370,7 @@ void vulkan_renderer_texture_read_pixel(renderer_plugin *plugin, texture *t,
 
     // Copy the data to the buffer.
     vulkan_image_copy_pixel_to_buffer(
-        context, image, ((vulkan_buffer *)staging.internal_data)->handle,
+        context, image, ((vulkan_buffer *)staging.internal_data)->handle, 0,
         x, y, &temp_buffer);
 
     // Transition from optimal for data reading to shader-read-only optimal
@@ -1550,8 +2391,74 @@ void vulkan_renderer_texture_read_pixel(renderer_plugin *plugin, texture *t,
     renderer_renderbuffer_destroy(&staging);
 }
 
+b8 vulkan_renderer_texture_read_pixel_async(renderer_plugin *plugin, texture *t,
+                                            u32 x, u32 y, renderer_readback_ticket *out_ticket) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_image *image = (vulkan_image *)t->internal_data;
+
+    u64 offset;
+    if (!vulkan_readback_ring_request(context, sizeof(u8) * 4, &offset, out_ticket)) {
+        return false;
+    }
+
+    VkFormat image_format =
+        channel_count_to_format(t->channel_count, VK_FORMAT_R8G8B8A8_UNORM);
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+    VkBuffer buffer = ((vulkan_buffer *)context->readback_ring.buffer.internal_data)->handle;
+
+    // The renderpass which wrote the texture left it in the attachment layout.
+    vulkan_image_transition_layout(context, command_buffer, image,
+                                   image_format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    vulkan_image_copy_pixel_to_buffer(context, image, buffer, offset, x, y, command_buffer);
+
+    vulkan_image_transition_layout(context, command_buffer, image,
+                                   image_format,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Make the copy visible to the host once the frame's fence signals.
+    VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = sizeof(u8) * 4;
+    vkCmdPipelineBarrier(command_buffer->handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, 0, 1, &barrier, 0, 0);
+    return true;
+}
+
+renderer_readback_status vulkan_renderer_readback_resolve(renderer_plugin *plugin, renderer_readback_ticket ticket,
+                                                          u32 size, void *out_data) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return vulkan_readback_ring_resolve(context, ticket, size, out_data);
+}
+
+// Points the UBO binding of the given descriptor set at the start of the uniform ring. The data within it is
+// then selected by the dynamic offset given when the set is bound.
+static void uniform_ring_descriptor_write(vulkan_context *context, VkDescriptorSet set, u32 binding, u64 range) {
+    VkDescriptorBufferInfo buffer_info;
+    buffer_info.buffer = ((vulkan_buffer *)context->uniform_ring.buffer.internal_data)->handle;
+    buffer_info.offset = 0;
+    buffer_info.range = range;
+
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.dstArrayElement = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(context->device.logical_device, 1, &write, 0, 0);
+}
+
 b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shader_config *config, renderpass *pass) {
     // Verify stage support.
+    b8 is_compute = false;
     for (u8 i = 0; i < config->stage_count; ++i) {
         switch (config->stage_configs[i].stage) {
             case SHADER_STAGE_FRAGMENT:
@@ -1561,7 +2468,7 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
                 KWARN("vulkan_renderer_shader_create: VK_SHADER_STAGE_GEOMETRY_BIT is set but not yet supported.");
                 break;
             case SHADER_STAGE_COMPUTE:
-                KWARN("vulkan_renderer_shader_create: SHADER_STAGE_COMPUTE is set but not yet supported.");
+                is_compute = true;
                 break;
             default:
                 KERROR("Unsupported stage type: %d", config->stage_configs[i].name);
@@ -1569,20 +2476,44 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
         }
     }
 
-    s->internal_data = kallocate(sizeof(vulkan_shader), MEMORY_TAG_RENDERER);
+    // A compute shader is its own pipeline, and cannot be mixed with graphics stages.
+    if (is_compute && config->stage_count != 1) {
+        KERROR("vulkan_renderer_shader_create: compute shader '%s' must have exactly one stage.", config->name);
+        return false;
+    }
+    if (!is_compute && !pass) {
+        KERROR("vulkan_renderer_shader_create: graphics shader '%s' requires a renderpass.", config->name);
+        return false;
+    }
+    if (s->global_uniform_storage_count > VULKAN_SHADER_MAX_GLOBAL_STORAGE) {
+        KERROR("vulkan_renderer_shader_create: shader '%s' has %u storage uniforms, max is %u.", config->name, s->global_uniform_storage_count, VULKAN_SHADER_MAX_GLOBAL_STORAGE);
+        return false;
+    }
+
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    b8 uses_bindless_textures = (config->flags & SHADER_FLAG_BINDLESS_TEXTURES) != 0;
+    if (uses_bindless_textures && !context->bindless_textures) {
+        KERROR("vulkan_renderer_shader_create: shader '%s' requires bindless textures, which are not supported by this device.", config->name);
+        return false;
+    }
+
+    s->internal_data = kallocate(sizeof(vulkan_shader), MEMORY_TAG_RENDERER);
 
     // Setup the internal shader.
     vulkan_shader *internal_shader = (vulkan_shader *)s->internal_data;
-    internal_shader->renderpass = pass->internal_data;
+    internal_shader->renderpass = pass ? pass->internal_data : 0;
     internal_shader->local_push_constant_block = kallocate(128, MEMORY_TAG_RENDERER);
+    internal_shader->is_compute = is_compute;
+    internal_shader->bind_point = is_compute ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    internal_shader->push_constant_stages = is_compute ? VK_SHADER_STAGE_COMPUTE_BIT : (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    internal_shader->uses_bindless_textures = uses_bindless_textures;
 
     internal_shader->stage_count = config->stage_count;
 
     // Need a max of 2 descriptor sets, one for global and one for instance.
     // Note that this can mean that only one (or potentially none) exist as well.
     internal_shader->descriptor_set_count = 0;
-    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0;
+    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0 || s->global_uniform_storage_count > 0;
     b8 has_instance = s->instance_uniform_count > 0 || s->instance_uniform_sampler_count > 0;
     kzero_memory(internal_shader->descriptor_sets, sizeof(vulkan_descriptor_set_config) * 2);
     u8 set_count = 0;
@@ -1598,38 +2529,58 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
     // Attributes array.
     kzero_memory(internal_shader->attributes, sizeof(VkVertexInputAttributeDescription) * VULKAN_SHADER_MAX_ATTRIBUTES);
 
-    // Calculate the total number of descriptors needed.
-    u32 frame_count = context->swapchain.image_count;
+    // Calculate the number of descriptors the first pool holds: the globals, and the first few
+    // instances. More pools are added if more instances are acquired.
+    // Descriptor sets are allocated 3 at a time, one per frame.
+    u32 frame_count = 3;
+    u32 pool_instance_count = has_instance ? KMIN(config->max_instances, VULKAN_SHADER_INITIAL_POOL_INSTANCES) : 0;
     // 1 set of globals * framecount + x samplers per instance, per frame.
-    u32 max_sampler_count = (s->global_uniform_sampler_count * frame_count) + (config->max_instances * s->instance_uniform_sampler_count * frame_count);
+    u32 max_sampler_count = (s->global_uniform_sampler_count * frame_count) + (pool_instance_count * s->instance_uniform_sampler_count * frame_count);
     // 1 global (1*framecount) + 1 per instance, per frame.
-    u32 max_ubo_count = frame_count + (config->max_instances * frame_count);
-    // Total number of descriptors needed.
-    u32 max_descriptor_allocate_count = max_ubo_count + max_sampler_count;
+    u32 max_ubo_count = frame_count + (pool_instance_count * frame_count);
+    // Storage buffers/images are global only, so 1 set of each per frame.
+    u32 max_storage_buffer_count = 0;
+    u32 max_storage_image_count = 0;
+    for (u32 i = 0; i < s->global_uniform_storage_count; ++i) {
+        if (config->uniforms[s->global_storage_indices[i]].type == SHADER_UNIFORM_TYPE_STORAGE_BUFFER) {
+            max_storage_buffer_count += frame_count;
+        } else {
+            max_storage_image_count += frame_count;
+        }
+    }
 
-    internal_shader->max_descriptor_set_count = max_descriptor_allocate_count;
+    // 1 global set per frame, plus 1 per instance, per frame.
+    internal_shader->pool_set_count = KMAX((has_global ? frame_count : 0) + (pool_instance_count * frame_count), 1);
     internal_shader->max_instances = config->max_instances;
 
-    // For now, shaders will only ever have these 2 types of descriptor pools.
+    // Shaders use up to 4 types of descriptors: UBOs, samplers, storage buffers and storage images.
     internal_shader->pool_size_count = 0;
     if (max_ubo_count > 0) {
-        internal_shader->pool_sizes[internal_shader->pool_size_count] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, max_ubo_count};
+        internal_shader->pool_sizes[internal_shader->pool_size_count] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, max_ubo_count};
         internal_shader->pool_size_count++;
     }
     if (max_sampler_count > 0) {
         internal_shader->pool_sizes[internal_shader->pool_size_count] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_sampler_count};
         internal_shader->pool_size_count++;
     }
+    if (max_storage_buffer_count > 0) {
+        internal_shader->pool_sizes[internal_shader->pool_size_count] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_storage_buffer_count};
+        internal_shader->pool_size_count++;
+    }
+    if (max_storage_image_count > 0) {
+        internal_shader->pool_sizes[internal_shader->pool_size_count] = (VkDescriptorPoolSize){VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_storage_image_count};
+        internal_shader->pool_size_count++;
+    }
 
     // Global descriptor set config.
     if (has_global) {
         // Global descriptor set config.
         vulkan_descriptor_set_config *set_config = &internal_shader->descriptor_sets[internal_shader->descriptor_set_count];
 
-        // Total bindings are 1 UBO for global (if needed), plus global sampler count.
+        // Total bindings are 1 UBO for global (if needed), plus global sampler count, plus global storage count.
         // This is dynamically allocated now.
         u32 ubo_count = s->global_uniform_count ? 1 : 0;
-        set_config->binding_count = ubo_count + s->global_uniform_sampler_count;
+        set_config->binding_count = ubo_count + s->global_uniform_sampler_count + s->global_uniform_storage_count;
         set_config->bindings = kallocate(sizeof(VkDescriptorSetLayoutBinding) * set_config->binding_count, MEMORY_TAG_ARRAY);
 
         // Global UBO binding is first, if present.
@@ -1637,7 +2588,7 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
         if (s->global_uniform_count > 0) {
             set_config->bindings[global_binding_index].binding = global_binding_index;
             set_config->bindings[global_binding_index].descriptorCount = 1;  // NOTE: the whole UBO is one binding.
-            set_config->bindings[global_binding_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            set_config->bindings[global_binding_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             set_config->bindings[global_binding_index].stageFlags = VK_SHADER_STAGE_ALL;
             global_binding_index++;
         }
@@ -1659,6 +2610,22 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
             }
         }
 
+        // Storage buffers/images follow the samplers, one binding each.
+        set_config->storage_binding_index_start = global_binding_index;
+        if (s->global_uniform_storage_count > 0) {
+            internal_shader->global_storage_uniforms = kallocate(sizeof(vulkan_uniform_storage_state) * s->global_uniform_storage_count, MEMORY_TAG_ARRAY);
+            for (u32 i = 0; i < s->global_uniform_storage_count; ++i) {
+                shader_uniform_config *u = &config->uniforms[s->global_storage_indices[i]];
+                VkDescriptorType type = u->type == SHADER_UNIFORM_TYPE_STORAGE_BUFFER ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                internal_shader->global_storage_uniforms[i].type = type;
+                set_config->bindings[global_binding_index].binding = global_binding_index;
+                set_config->bindings[global_binding_index].descriptorCount = 1;
+                set_config->bindings[global_binding_index].descriptorType = type;
+                set_config->bindings[global_binding_index].stageFlags = VK_SHADER_STAGE_ALL;
+                global_binding_index++;
+            }
+        }
+
         // Increment the set counter.
         internal_shader->descriptor_set_count++;
     }
@@ -1679,7 +2646,7 @@ b8 vulkan_renderer_shader_create(renderer_plugin *plugin, shader *s, const shade
         if (s->instance_uniform_count > 0) {
             set_config->bindings[instance_binding_index].binding = instance_binding_index;
             set_config->bindings[instance_binding_index].descriptorCount = 1;
-            set_config->bindings[instance_binding_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            set_config->bindings[instance_binding_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             set_config->bindings[instance_binding_index].stageFlags = VK_SHADER_STAGE_ALL;
             instance_binding_index++;
         }
@@ -1743,26 +2710,48 @@ void vulkan_renderer_shader_destroy(renderer_plugin *plugin, shader *s) {
             }
         }
 
-        // Descriptor pool
-        if (shader->descriptor_pool) {
-            vkDestroyDescriptorPool(logical_device, shader->descriptor_pool, vk_allocator);
-        }
+        // Pending frees of instance descriptor sets and uniform ranges go along with the pool and buffer.
+        vulkan_deferred_deletion_discard_owner(context, shader);
+
+        // Descriptor pools
+        vulkan_descriptor_allocator_destroy(context, &shader->descriptors);
 
         // Nuke the instance states.
         kfree(shader->instance_states, sizeof(vulkan_shader_instance_state) * shader->max_instances, MEMORY_TAG_ARRAY);
 
-        // Uniform buffer.
-        vulkan_buffer_unmap_memory(plugin, &shader->uniform_buffer, 0, VK_WHOLE_SIZE);
-        shader->mapped_uniform_buffer_block = 0;
-        renderer_renderbuffer_destroy(&shader->uniform_buffer);
-
-        // Pipelines
-        for (u32 i = 0; i < VULKAN_TOPOLOGY_CLASS_MAX; ++i) {
-            if (shader->pipelines[i]) {
-                vulkan_pipeline_destroy(context, shader->pipelines[i]);
+        // Global sampler states.
+        if (shader->global_sampler_uniforms) {
+            for (u32 i = 0; i < s->global_uniform_sampler_count; ++i) {
+                vulkan_uniform_sampler_state *sampler_state = &shader->global_sampler_uniforms[i];
+                u32 array_length = KMAX(sampler_state->uniform->array_length, 1);
+                kfree(sampler_state->descriptor_states, sizeof(vulkan_descriptor_state) * array_length, MEMORY_TAG_ARRAY);
+                kfree(sampler_state->uniform_texture_maps, sizeof(texture_map *) * array_length, MEMORY_TAG_ARRAY);
             }
+            kfree(shader->global_sampler_uniforms, sizeof(vulkan_uniform_sampler_state) * s->global_uniform_sampler_count, MEMORY_TAG_ARRAY);
+            shader->global_sampler_uniforms = 0;
+        }
+
+        // Storage bindings.
+        if (shader->global_storage_uniforms) {
+            kfree(shader->global_storage_uniforms, sizeof(vulkan_uniform_storage_state) * s->global_uniform_storage_count, MEMORY_TAG_ARRAY);
+            shader->global_storage_uniforms = 0;
+        }
+
+        // Uniform values.
+        if (shader->uniform_block) {
+            kfree(shader->uniform_block, shader->uniform_block_size, MEMORY_TAG_RENDERER);
+            shader->uniform_block = 0;
+            shader->uniform_block_size = 0;
         }
 
+        // Pipelines of every variant, then any left from a variant which failed to be created.
+        if (shader->variants) {
+            shader_variants_destroy(context, shader, false);
+            darray_destroy(shader->variants);
+            shader->variants = 0;
+        }
+        shader_pipelines_destroy(context, shader, false);
+
         // Shader modules
         for (u32 i = 0; i < shader->stage_count; ++i) {
             vkDestroyShaderModule(context->device.logical_device, shader->stages[i].handle, context->allocator);
@@ -1774,6 +2763,288 @@ void vulkan_renderer_shader_destroy(renderer_plugin *plugin, shader *s) {
     }
 }
 
+// Adds the descriptions of the given attribute at the next location(s), which for a mat4 is 4 consecutive
+// vec4 locations. Per-vertex attributes come from binding 0, per-instance ones from binding 1.
+static b8 attribute_descriptions_add(const shader *s, const shader_attribute *attribute, const VkFormat *types, u32 offsets[2], u32 *location, VkVertexInputAttributeDescription *out_descriptions) {
+    u32 binding = attribute->per_instance ? 1 : 0;
+    b8 is_matrix = attribute->type == SHADER_ATTRIB_TYPE_MATRIX_4;
+    u32 column_count = is_matrix ? 4 : 1;
+    if (*location + column_count > VULKAN_SHADER_MAX_ATTRIBUTES) {
+        KERROR("Shader '%s' exceeds the maximum of %u vertex attribute locations.", s->name, VULKAN_SHADER_MAX_ATTRIBUTES);
+        return false;
+    }
+    for (u32 c = 0; c < column_count; ++c) {
+        // Setup the new attribute.
+        VkVertexInputAttributeDescription description;
+        description.location = *location;
+        description.binding = binding;
+        description.offset = offsets[binding];
+        description.format = is_matrix ? VK_FORMAT_R32G32B32A32_SFLOAT : types[attribute->type];
+
+        // Push into the attribute collection and add to the stride.
+        out_descriptions[*location] = description;
+
+        offsets[binding] += is_matrix ? sizeof(vec4) : attribute->size;
+        (*location)++;
+    }
+    return true;
+}
+
+// Creates the pipelines of the shader from its current stage modules, with the given value for each of its
+// specialization constants. The descriptor set layouts must exist.
+static b8 shader_pipelines_create(vulkan_context *context, shader *s, vulkan_shader *internal_shader, const shader_variant *variant) {
+    // The shared bindless layout, if used, follows the shader's own sets.
+    u32 pipeline_set_layout_count = internal_shader->descriptor_set_count + (internal_shader->uses_bindless_textures ? 1 : 0);
+
+    // Default viewport/scissor, can be dynamically overidden.
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = (f32)context->framebuffer_height;
+    viewport.width = (f32)context->framebuffer_width;
+    viewport.height = -(f32)context->framebuffer_height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    // Scissor
+    VkRect2D scissor;
+    scissor.offset.x = scissor.offset.y = 0;
+    scissor.extent.width = context->framebuffer_width;
+    scissor.extent.height = context->framebuffer_height;
+
+    VkPipelineShaderStageCreateInfo stage_create_infos[VULKAN_SHADER_MAX_STAGES];
+    kzero_memory(stage_create_infos, sizeof(VkPipelineShaderStageCreateInfo) * VULKAN_SHADER_MAX_STAGES);
+    // Specialization constants are given to every stage. Entries for constants a stage doesn't declare are ignored.
+    VkSpecializationMapEntry specialization_entries[SHADER_MAX_SPECIALIZATIONS];
+    VkSpecializationInfo specialization_info = {0};
+    for (u32 i = 0; i < s->specialization_count; ++i) {
+        specialization_entries[i].constantID = s->specializations[i].id;
+        specialization_entries[i].offset = sizeof(u32) * i;
+        specialization_entries[i].size = sizeof(u32);
+    }
+    specialization_info.mapEntryCount = s->specialization_count;
+    specialization_info.pMapEntries = specialization_entries;
+    specialization_info.dataSize = sizeof(u32) * s->specialization_count;
+    specialization_info.pData = variant->values;
+
+    for (u32 i = 0; i < internal_shader->stage_count; ++i) {
+        stage_create_infos[i] = internal_shader->stages[i].shader_stage_create_info;
+        if (s->specialization_count) {
+            stage_create_infos[i].pSpecializationInfo = &specialization_info;
+        }
+    }
+
+    if (internal_shader->is_compute) {
+        // A compute shader has a single pipeline, kept in the first slot so binding works the same way.
+        internal_shader->pipelines = kallocate(sizeof(vulkan_pipeline *) * VULKAN_TOPOLOGY_CLASS_MAX, MEMORY_TAG_ARRAY);
+        internal_shader->pipelines[0] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+        internal_shader->bound_pipeline_index = 0;
+
+        vulkan_pipeline_config pipeline_config = {0};
+        pipeline_config.descriptor_set_layout_count = pipeline_set_layout_count;
+        pipeline_config.descriptor_set_layouts = internal_shader->descriptor_set_layouts;
+        pipeline_config.stage_count = internal_shader->stage_count;
+        pipeline_config.stages = stage_create_infos;
+        // NOTE: Always one block for the push constant.
+        pipeline_config.push_constant_range_count = 1;
+        range push_constant_range;
+        push_constant_range.offset = 0;
+        push_constant_range.size = s->local_ubo_stride;
+        pipeline_config.push_constant_ranges = &push_constant_range;
+        pipeline_config.name = string_duplicate(s->name);
+
+        b8 pipeline_result = vulkan_compute_pipeline_create(context, &pipeline_config, internal_shader->pipelines[0]);
+
+        kfree(pipeline_config.name, string_length(pipeline_config.name) + 1, MEMORY_TAG_STRING);
+
+        if (!pipeline_result) {
+            KERROR("Failed to load compute pipeline for shader: '%s'.", s->name);
+            return false;
+        }
+    } else {
+        // Only dynamic topology is supported. Create one pipeline per topology class.
+        // If this isn't supported, perhaps a different backend should be used.
+        u32 pipeline_count = 3;
+
+        // Create an array of pointers to pipelines, one per topology class. Null means not supported for this shader.
+        internal_shader->pipelines = kallocate(sizeof(vulkan_pipeline *) * pipeline_count, MEMORY_TAG_ARRAY);
+        // And likewise for the packed vertex layout, if the shader has one.
+        if (internal_shader->packed_attribute_description_count) {
+            internal_shader->packed_pipelines = kallocate(sizeof(vulkan_pipeline *) * pipeline_count, MEMORY_TAG_ARRAY);
+        }
+
+        // Create one pipeline per topology class.
+        // Point class.
+        if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST) {
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_POINT] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+            // Set the supported types for this class.
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_POINT]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST;
+        }
+
+        // Line class.
+        if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST || s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP) {
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+            // Set the supported types for this class.
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST;
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP;
+        }
+
+        // Triangle class.
+        if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST ||
+            s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP ||
+            s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN) {
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+            // Set the supported types for this class.
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST;
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP;
+            internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN;
+        }
+
+        // Loop through and config/create one pipeline per class, plus one with the packed vertex layout
+        // if there is one. Null entries are skipped.
+        for (u32 p = 0; p < pipeline_count * 2; ++p) {
+            u32 i = p % pipeline_count;
+            b8 packed = p >= pipeline_count;
+            if (!internal_shader->pipelines[i] || (packed && !internal_shader->packed_pipelines)) {
+                continue;
+            }
+            vulkan_pipeline *pipeline = internal_shader->pipelines[i];
+            if (packed) {
+                pipeline = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+                pipeline->supported_topology_types = internal_shader->pipelines[i]->supported_topology_types;
+                internal_shader->packed_pipelines[i] = pipeline;
+            }
+
+            vulkan_pipeline_config pipeline_config = {0};
+            pipeline_config.renderpass = internal_shader->renderpass;
+            pipeline_config.stride = packed ? s->packed_attribute_stride : s->attribute_stride;
+            pipeline_config.instance_stride = s->instance_attribute_stride;
+            pipeline_config.attribute_count = packed ? internal_shader->packed_attribute_description_count : internal_shader->attribute_description_count;
+            pipeline_config.attributes = packed ? internal_shader->packed_attributes : internal_shader->attributes;
+            pipeline_config.descriptor_set_layout_count = pipeline_set_layout_count;
+            pipeline_config.descriptor_set_layouts = internal_shader->descriptor_set_layouts;
+            pipeline_config.stage_count = internal_shader->stage_count;
+            pipeline_config.stages = stage_create_infos;
+            pipeline_config.viewport = viewport;
+            pipeline_config.scissor = scissor;
+            pipeline_config.cull_mode = internal_shader->cull_mode;
+            pipeline_config.shader_flags = s->flags | variant->flags;
+            // NOTE: Always one block for the push constant.
+            pipeline_config.push_constant_range_count = 1;
+            range push_constant_range;
+            push_constant_range.offset = 0;
+            push_constant_range.size = s->local_ubo_stride;
+            pipeline_config.push_constant_ranges = &push_constant_range;
+            pipeline_config.name = string_duplicate(s->name);
+            pipeline_config.topology_types = s->topology_types;
+
+            b8 pipeline_result = vulkan_graphics_pipeline_create(context, &pipeline_config, pipeline);
+
+            kfree(pipeline_config.name, string_length(pipeline_config.name) + 1, MEMORY_TAG_STRING);
+
+            if (!pipeline_result) {
+                KERROR("Failed to load graphics pipeline for shader: '%s'.", s->name);
+                return false;
+            }
+        }
+
+        // TODO: Figure out what the default should be here.
+        internal_shader->bound_pipeline_index = 0;
+        b8 pipeline_found = false;
+        for (u32 i = 0; i < pipeline_count; ++i) {
+            if (internal_shader->pipelines[i]) {
+                internal_shader->bound_pipeline_index = i;
+
+                // Extract the first type from the pipeline
+                for (u32 j = 1; j < PRIMITIVE_TOPOLOGY_TYPE_MAX; j = j << 1) {
+                    if (internal_shader->pipelines[i]->supported_topology_types & j) {
+                        switch (j) {
+                            case PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+                                break;
+                            case PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+                                break;
+                            case PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+                                break;
+                            case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                                break;
+                            case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+                                break;
+                            case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN:
+                                internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
+                                break;
+                            default:
+                                KWARN("primitive topology '%u' not supported. Skipping.", j);
+                                break;
+                        }
+
+                        // Break out here and just assume the first one for now. This can be overidden by
+                        // whatever is using the shader if need be.
+                        break;
+                    }
+                }
+                pipeline_found = true;
+                break;
+            }
+        }
+
+        if (!pipeline_found) {
+            // Getting here means that all of the pipelines are null, which they definitely should not be.
+            // This is an extra failsafe to ensure configuration is at least somewhat sane.
+            KERROR("No available topology classes are available, so a pipeline cannot be bound. Check shader configuration.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Destroys the pipelines of the shader. When deferred, they are destroyed once the frames which may use them are done.
+static void shader_pipelines_destroy(vulkan_context *context, vulkan_shader *internal_shader, b8 deferred) {
+    for (u32 i = 0; i < VULKAN_TOPOLOGY_CLASS_MAX; ++i) {
+        vulkan_pipeline *pipelines[2] = {
+            internal_shader->pipelines ? internal_shader->pipelines[i] : 0,
+            internal_shader->packed_pipelines ? internal_shader->packed_pipelines[i] : 0};
+        for (u32 j = 0; j < 2; ++j) {
+            if (!pipelines[j]) {
+                continue;
+            }
+            if (deferred) {
+                vulkan_deferred_deletion_pipeline(context, pipelines[j]);
+            } else {
+                vulkan_pipeline_destroy(context, pipelines[j]);
+            }
+            kfree(pipelines[j], sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
+        }
+    }
+    if (internal_shader->pipelines) {
+        kfree(internal_shader->pipelines, sizeof(vulkan_pipeline *) * VULKAN_TOPOLOGY_CLASS_MAX, MEMORY_TAG_ARRAY);
+        internal_shader->pipelines = 0;
+    }
+    if (internal_shader->packed_pipelines) {
+        kfree(internal_shader->packed_pipelines, sizeof(vulkan_pipeline *) * VULKAN_TOPOLOGY_CLASS_MAX, MEMORY_TAG_ARRAY);
+        internal_shader->packed_pipelines = 0;
+    }
+}
+
+// Destroys the pipelines of every variant of the shader, leaving none bound.
+static void shader_variants_destroy(vulkan_context *context, vulkan_shader *internal_shader, b8 deferred) {
+    u32 variant_count = darray_length(internal_shader->variants);
+    for (u32 i = 0; i < variant_count; ++i) {
+        vulkan_shader_variant *variant = &internal_shader->variants[i];
+        internal_shader->pipelines = variant->pipelines;
+        internal_shader->packed_pipelines = variant->packed_pipelines;
+        shader_pipelines_destroy(context, internal_shader, deferred);
+        variant->pipelines = 0;
+        variant->packed_pipelines = 0;
+    }
+    internal_shader->pipelines = 0;
+    internal_shader->packed_pipelines = 0;
+}
+
 b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     VkDevice logical_device = context->device.logical_device;
@@ -1791,7 +3062,7 @@ b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
 
     // Static lookup table for our types->Vulkan ones.
     static VkFormat *types = 0;
-    static VkFormat t[11];
+    static VkFormat t[16];
     if (!types) {
         t[SHADER_ATTRIB_TYPE_FLOAT32] = VK_FORMAT_R32_SFLOAT;
         t[SHADER_ATTRIB_TYPE_FLOAT32_2] = VK_FORMAT_R32G32_SFLOAT;
@@ -1803,40 +3074,53 @@ b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
         t[SHADER_ATTRIB_TYPE_UINT16] = VK_FORMAT_R16_UINT;
         t[SHADER_ATTRIB_TYPE_INT32] = VK_FORMAT_R32_SINT;
         t[SHADER_ATTRIB_TYPE_UINT32] = VK_FORMAT_R32_UINT;
+        t[SHADER_ATTRIB_TYPE_SNORM8_4] = VK_FORMAT_R8G8B8A8_SNORM;
+        t[SHADER_ATTRIB_TYPE_SNORM16_4] = VK_FORMAT_R16G16B16A16_SNORM;
+        t[SHADER_ATTRIB_TYPE_UNORM8_4] = VK_FORMAT_R8G8B8A8_UNORM;
+        t[SHADER_ATTRIB_TYPE_FLOAT16_2] = VK_FORMAT_R16G16_SFLOAT;
+        t[SHADER_ATTRIB_TYPE_UINT8_4] = VK_FORMAT_R8G8B8A8_UINT;
         types = t;
     }
 
-    // Process attributes
+    // Process attributes. Per-vertex attributes come from binding 0, per-instance ones from binding 1.
+    // A mat4 attribute is fed as 4 consecutive vec4 locations.
     u32 attribute_count = darray_length(s->attributes);
-    u32 offset = 0;
+    u32 offsets[2] = {0, 0};
+    u32 location = 0;
     for (u32 i = 0; i < attribute_count; ++i) {
-        // Setup the new attribute.
-        VkVertexInputAttributeDescription attribute;
-        attribute.location = i;
-        attribute.binding = 0;
-        attribute.offset = offset;
-        attribute.format = types[s->attributes[i].type];
-
-        // Push into the config's attribute collection and add to the stride.
-        internal_shader->attributes[i] = attribute;
+        if (!attribute_descriptions_add(s, &s->attributes[i], types, offsets, &location, internal_shader->attributes)) {
+            return false;
+        }
+    }
+    internal_shader->attribute_description_count = location;
 
-        offset += s->attributes[i].size;
+    // The packed vertex layout, if any, takes the place of the per-vertex attributes. Per-instance
+    // attributes follow it as they would the others.
+    u32 packed_attribute_count = darray_length(s->packed_attributes);
+    if (packed_attribute_count) {
+        offsets[0] = offsets[1] = 0;
+        location = 0;
+        for (u32 i = 0; i < packed_attribute_count; ++i) {
+            if (!attribute_descriptions_add(s, &s->packed_attributes[i], types, offsets, &location, internal_shader->packed_attributes)) {
+                return false;
+            }
+        }
+        for (u32 i = 0; i < attribute_count; ++i) {
+            if (s->attributes[i].per_instance && !attribute_descriptions_add(s, &s->attributes[i], types, offsets, &location, internal_shader->packed_attributes)) {
+                return false;
+            }
+        }
+        internal_shader->packed_attribute_description_count = location;
     }
 
-    // Descriptor pool.
-    VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    pool_info.poolSizeCount = internal_shader->pool_size_count;
-    pool_info.pPoolSizes = internal_shader->pool_sizes;
-    pool_info.maxSets = internal_shader->max_descriptor_set_count;
-    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;  // | VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    // Descriptor pools.
+    VkDescriptorPoolCreateFlags pool_flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;  // | VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
     // NOTE: increase the per-stage descriptor samplers limit on macOS (maxPerStageDescriptorUpdateAfterBindSamplers > maxPerStageDescriptorSamplers)
-    pool_info.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
 #endif
-    // Create descriptor pool.
-    VkResult result = vkCreateDescriptorPool(logical_device, &pool_info, vk_allocator, &internal_shader->descriptor_pool);
-    if (!vulkan_result_is_success(result)) {
-        KERROR("vulkan_shader_initialize failed creating descriptor pool: '%s'", vulkan_result_string(result, true));
+    if (!vulkan_descriptor_allocator_create(context, internal_shader->pool_size_count, internal_shader->pool_sizes, internal_shader->pool_set_count, pool_flags, &internal_shader->descriptors)) {
+        KERROR("vulkan_shader_initialize failed creating descriptor pool.");
         return false;
     }
 
@@ -1847,219 +3131,180 @@ b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
         layout_info.bindingCount = internal_shader->descriptor_sets[i].binding_count;
         layout_info.pBindings = internal_shader->descriptor_sets[i].bindings;
 
-        result = vkCreateDescriptorSetLayout(logical_device, &layout_info, vk_allocator, &internal_shader->descriptor_set_layouts[i]);
+        VkResult result = vkCreateDescriptorSetLayout(logical_device, &layout_info, vk_allocator, &internal_shader->descriptor_set_layouts[i]);
         if (!vulkan_result_is_success(result)) {
             KERROR("vulkan_shader_initialize failed descriptor set layout: '%s'", vulkan_result_string(result, true));
             return false;
         }
     }
+    // The shared bindless layout, if used, follows the shader's own sets.
+    if (internal_shader->uses_bindless_textures) {
+        internal_shader->descriptor_set_layouts[internal_shader->descriptor_set_count] = context->bindless_layout;
+    }
 
-    // Default viewport/scissor, can be dynamically overidden.
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = (f32)context->framebuffer_height;
-    viewport.width = (f32)context->framebuffer_width;
-    viewport.height = -(f32)context->framebuffer_height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // Scissor
-    VkRect2D scissor;
-    scissor.offset.x = scissor.offset.y = 0;
-    scissor.extent.width = context->framebuffer_width;
-    scissor.extent.height = context->framebuffer_height;
-
-    VkPipelineShaderStageCreateInfo stage_create_infos[VULKAN_SHADER_MAX_STAGES];
-    kzero_memory(stage_create_infos, sizeof(VkPipelineShaderStageCreateInfo) * VULKAN_SHADER_MAX_STAGES);
-    for (u32 i = 0; i < internal_shader->stage_count; ++i) {
-        stage_create_infos[i] = internal_shader->stages[i].shader_stage_create_info;
+    if (!shader_pipelines_create(context, s, internal_shader, &s->variants[0])) {
+        return false;
     }
 
-    // Only dynamic topology is supported. Create one pipeline per topology class.
-    // If this isn't supported, perhaps a different backend should be used.
-    u32 pipeline_count = 3;
+    // These are the pipelines of the default variant. Those of other variants are created as they are first used.
+    internal_shader->variants = darray_create(vulkan_shader_variant);
+    vulkan_shader_variant default_variant = {internal_shader->pipelines, internal_shader->packed_pipelines};
+    darray_push(internal_shader->variants, default_variant);
+    internal_shader->bound_variant = 0;
 
-    // Create an array of pointers to pipelines, one per topology class. Null means not supported for this shader.
-    internal_shader->pipelines = kallocate(sizeof(vulkan_pipeline *) * pipeline_count, MEMORY_TAG_ARRAY);
+    // Grab the UBO alignment requirement from the device.
+    s->required_ubo_alignment = context->device.properties.limits.minUniformBufferOffsetAlignment;
 
-    // Create one pipeline per topology class.
-    // Point class.
-    if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST) {
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_POINT] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
-        // Set the supported types for this class.
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_POINT]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST;
-    }
+    // Make sure the UBO is aligned according to device requirements.
+    s->global_ubo_stride = get_aligned(s->global_ubo_size, s->required_ubo_alignment);
+    s->ubo_stride = get_aligned(s->ubo_size, s->required_ubo_alignment);
 
-    // Line class.
-    if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST || s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP) {
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
-        // Set the supported types for this class.
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST;
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_LINE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP;
+    // Uniform values are kept here, with the globals first followed by each instance's, and
+    // copied into the uniform ring as they are applied.
+    internal_shader->uniform_block_size = s->global_ubo_stride + (s->ubo_stride * internal_shader->max_instances);
+    if (internal_shader->uniform_block_size > 0) {
+        internal_shader->uniform_block = kallocate(internal_shader->uniform_block_size, MEMORY_TAG_RENDERER);
     }
+    s->global_ubo_offset = 0;
+    internal_shader->global_ubo_dirty = true;
 
-    // Triangle class.
-    if (s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST ||
-        s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP ||
-        s->topology_types & PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN) {
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE] = kallocate(sizeof(vulkan_pipeline), MEMORY_TAG_VULKAN);
-        // Set the supported types for this class.
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST;
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP;
-        internal_shader->pipelines[VULKAN_TOPOLOGY_CLASS_TRIANGLE]->supported_topology_types |= PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN;
-    }
+    // Global sampler states point at the shader's default global texture maps until others are set.
+    if (s->global_uniform_sampler_count > 0 && !internal_shader->global_sampler_uniforms) {
+        internal_shader->global_sampler_uniforms = kallocate(sizeof(vulkan_uniform_sampler_state) * s->global_uniform_sampler_count, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < s->global_uniform_sampler_count; ++i) {
+            vulkan_uniform_sampler_state *sampler_state = &internal_shader->global_sampler_uniforms[i];
+            sampler_state->uniform = &s->uniforms[s->global_sampler_indices[i]];
 
-    // Loop through and config/create one pipeline per class. Null entries are skipped.
-    for (u32 i = 0; i < pipeline_count; ++i) {
-        if (!internal_shader->pipelines[i]) {
-            continue;
+            u32 array_length = KMAX(sampler_state->uniform->array_length, 1);
+            sampler_state->uniform_texture_maps = kallocate(sizeof(texture_map *) * array_length, MEMORY_TAG_ARRAY);
+            sampler_state->descriptor_states = kallocate(sizeof(vulkan_descriptor_state) * array_length, MEMORY_TAG_ARRAY);
+            for (u32 d = 0; d < array_length; ++d) {
+                sampler_state->uniform_texture_maps[d] = s->global_texture_maps[sampler_state->uniform->location];
+                for (u32 j = 0; j < 3; ++j) {
+                    sampler_state->descriptor_states[d].generations[j] = INVALID_ID_U8;
+                    sampler_state->descriptor_states[d].ids[j] = INVALID_ID;
+                }
+            }
         }
+    }
 
-        vulkan_pipeline_config pipeline_config = {0};
-        pipeline_config.renderpass = internal_shader->renderpass;
-        pipeline_config.stride = s->attribute_stride;
-        pipeline_config.attribute_count = darray_length(s->attributes);
-        pipeline_config.attributes = internal_shader->attributes;
-        pipeline_config.descriptor_set_layout_count = internal_shader->descriptor_set_count;
-        pipeline_config.descriptor_set_layouts = internal_shader->descriptor_set_layouts;
-        pipeline_config.stage_count = internal_shader->stage_count;
-        pipeline_config.stages = stage_create_infos;
-        pipeline_config.viewport = viewport;
-        pipeline_config.scissor = scissor;
-        pipeline_config.cull_mode = internal_shader->cull_mode;
-        pipeline_config.shader_flags = s->flags;
-        // NOTE: Always one block for the push constant.
-        pipeline_config.push_constant_range_count = 1;
-        range push_constant_range;
-        push_constant_range.offset = 0;
-        push_constant_range.size = s->local_ubo_stride;
-        pipeline_config.push_constant_ranges = &push_constant_range;
-        pipeline_config.name = string_duplicate(s->name);
-        pipeline_config.topology_types = s->topology_types;
-
-        b8 pipeline_result = vulkan_graphics_pipeline_create(context, &pipeline_config, internal_shader->pipelines[i]);
+    // Global descriptor sets are needed for a global UBO, samplers or storage bindings.
+    if (s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0 || s->global_uniform_storage_count > 0) {
 
-        kfree(pipeline_config.name, string_length(pipeline_config.name) + 1, MEMORY_TAG_STRING);
+        // Allocate global descriptor sets, one per frame. Global is always the first set.
+        // TODO: this should be dynamic based off the number of swapchain images.
+        VkDescriptorSetLayout global_layouts[3] = {
+            internal_shader->descriptor_set_layouts[0],
+            internal_shader->descriptor_set_layouts[0],
+            internal_shader->descriptor_set_layouts[0]};
 
-        if (!pipeline_result) {
-            KERROR("Failed to load graphics pipeline for shader: '%s'.", s->name);
+        // TODO: this should be dynamic based off the number of swapchain images.
+        if (!vulkan_descriptor_allocator_allocate(context, &internal_shader->descriptors, 3, global_layouts, internal_shader->global_descriptor_sets, 0)) {
+            KERROR("vulkan_shader_initialize failed allocating global descriptor sets for shader '%s'.", s->name);
             return false;
         }
-    }
-
-    // TODO: Figure out what the default should be here.
-    internal_shader->bound_pipeline_index = 0;
-    b8 pipeline_found = false;
-    for (u32 i = 0; i < pipeline_count; ++i) {
-        if (internal_shader->pipelines[i]) {
-            internal_shader->bound_pipeline_index = i;
-
-            // Extract the first type from the pipeline
-            for (u32 j = 1; j < PRIMITIVE_TOPOLOGY_TYPE_MAX; j = j << 1) {
-                if (internal_shader->pipelines[i]->supported_topology_types & j) {
-                    switch (j) {
-                        case PRIMITIVE_TOPOLOGY_TYPE_POINT_LIST:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-                            break;
-                        case PRIMITIVE_TOPOLOGY_TYPE_LINE_LIST:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-                            break;
-                        case PRIMITIVE_TOPOLOGY_TYPE_LINE_STRIP:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
-                            break;
-                        case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_LIST:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-                            break;
-                        case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_STRIP:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
-                            break;
-                        case PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE_FAN:
-                            internal_shader->current_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
-                            break;
-                        default:
-                            KWARN("primitive topology '%u' not supported. Skipping.", j);
-                            break;
-                    }
 
-                    // Break out here and just assume the first one for now. This can be overidden by
-                    // whatever is using the shader if need be.
-                    break;
-                }
+        for (u32 i = 0; i < 3; ++i) {
+            char desc_set_object_name[512] = {0};
+            string_format(desc_set_object_name, "desc_set_shader_%s_global_frame_%u", s->name, i);
+            vulkan_set_debug_object_name(context, VK_OBJECT_TYPE_DESCRIPTOR_SET, internal_shader->global_descriptor_sets[i], desc_set_object_name);
+            // The UBO is always the first binding.
+            if (s->global_uniform_count > 0) {
+                uniform_ring_descriptor_write(context, internal_shader->global_descriptor_sets[i], 0, s->global_ubo_stride);
             }
-            pipeline_found = true;
-            break;
         }
     }
 
-    if (!pipeline_found) {
-        // Getting here means that all of the pipelines are null, which they definitely should not be.
-        // This is an extra failsafe to ensure configuration is at least somewhat sane.
-        KERROR("No available topology classes are available, so a pipeline cannot be bound. Check shader configuration.");
-        return false;
-    }
-
-    // Grab the UBO alignment requirement from the device.
-    s->required_ubo_alignment = context->device.properties.limits.minUniformBufferOffsetAlignment;
-
-    // Make sure the UBO is aligned according to device requirements.
-    s->global_ubo_stride = get_aligned(s->global_ubo_size, s->required_ubo_alignment);
-    s->ubo_stride = get_aligned(s->ubo_size, s->required_ubo_alignment);
+    return true;
+}
 
-    // Uniform  buffer.
-    u64 total_buffer_size = s->global_ubo_stride + (s->ubo_stride * internal_shader->max_instances);
-    char bufname[256];
-    kzero_memory(bufname, 256);
-    string_format(bufname, "renderbuffer_global_uniform");
-    if (!renderer_renderbuffer_create(bufname, RENDERBUFFER_TYPE_UNIFORM, total_buffer_size, RENDERBUFFER_TRACK_TYPE_FREELIST, &internal_shader->uniform_buffer)) {
-        KERROR("Vulkan buffer creation failed for object shader.");
+b8 vulkan_renderer_shader_reload(renderer_plugin *plugin, shader *s) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_shader *internal_shader = (vulkan_shader *)s->internal_data;
+    if (!internal_shader) {
+        KERROR("vulkan_renderer_shader_reload requires an initialized shader.");
         return false;
     }
-    renderer_renderbuffer_bind(&internal_shader->uniform_buffer, 0);
 
-    // Map the entire buffer's memory.
-    internal_shader->mapped_uniform_buffer_block = vulkan_buffer_map_memory(plugin, &internal_shader->uniform_buffer, 0, VK_WHOLE_SIZE);
-
-    // NOTE: All of this below is only allocated if actually needed.
-    //
-    //  Allocate space for the global UBO, whcih should occupy the _stride_ space,
-    //  _not_ the actual size used.
-    if (s->global_ubo_size > 0 && s->global_ubo_stride > 0) {
-        if (!renderer_renderbuffer_allocate(&internal_shader->uniform_buffer, s->global_ubo_stride, &s->global_ubo_offset)) {
-            KERROR("Failed to allocate space for the uniform buffer!");
+    // Compile the new stages first, so the shader is left as it was if any of them fail.
+    vulkan_shader_stage new_stages[VULKAN_SHADER_MAX_STAGES];
+    kzero_memory(new_stages, sizeof(vulkan_shader_stage) * VULKAN_SHADER_MAX_STAGES);
+    for (u32 i = 0; i < internal_shader->stage_count; ++i) {
+        if (!create_shader_module(context, s, &s->stage_configs[i], &new_stages[i])) {
+            KERROR("Unable to create %s shader module for '%s'. The previous version is kept.", s->stage_configs[i].filename, s->name);
+            for (u32 j = 0; j < i; ++j) {
+                vkDestroyShaderModule(context->device.logical_device, new_stages[j].handle, context->allocator);
+            }
             return false;
         }
+    }
+
+    // Set the old pipelines aside and create those of the default variant from the new stages. Descriptor
+    // pools, layouts and instance state are unchanged, so everything bound to the shader carries on as before.
+    vulkan_shader_stage old_stages[VULKAN_SHADER_MAX_STAGES];
+    kcopy_memory(old_stages, internal_shader->stages, sizeof(vulkan_shader_stage) * VULKAN_SHADER_MAX_STAGES);
+    vulkan_pipeline **old_pipelines = internal_shader->pipelines;
+    vulkan_pipeline **old_packed_pipelines = internal_shader->packed_pipelines;
+    u8 bound_pipeline_index = internal_shader->bound_pipeline_index;
+    VkPrimitiveTopology current_topology = internal_shader->current_topology;
 
-        // Allocate global descriptor sets, one per frame. Global is always the first set.
-        // TODO: this should be dynamic based off the number of swapchain images.
-        VkDescriptorSetLayout global_layouts[3] = {
-            internal_shader->descriptor_set_layouts[0],
-            internal_shader->descriptor_set_layouts[0],
-            internal_shader->descriptor_set_layouts[0]};
+    kcopy_memory(internal_shader->stages, new_stages, sizeof(vulkan_shader_stage) * VULKAN_SHADER_MAX_STAGES);
+    internal_shader->pipelines = 0;
+    internal_shader->packed_pipelines = 0;
+    b8 result = shader_pipelines_create(context, s, internal_shader, &s->variants[0]);
 
-        VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-        alloc_info.descriptorPool = internal_shader->descriptor_pool;
-        // TODO: this should be dynamic based off the number of swapchain images.
-        alloc_info.descriptorSetCount = 3;
-        alloc_info.pSetLayouts = global_layouts;
-        VK_CHECK(vkAllocateDescriptorSets(context->device.logical_device, &alloc_info, internal_shader->global_descriptor_sets));
+    // Modules are no longer needed once pipelines are created from them, so whichever set goes unused is destroyed now.
+    vulkan_shader_stage *unused_stages = result ? old_stages : new_stages;
+    for (u32 i = 0; i < internal_shader->stage_count; ++i) {
+        vkDestroyShaderModule(context->device.logical_device, unused_stages[i].handle, context->allocator);
+    }
 
-        for (u32 i = 0; i < 3; ++i) {
-            char desc_set_object_name[512] = {0};
-            string_format(desc_set_object_name, "desc_set_shader_%s_global_frame_%u", s->name, i);
-            vulkan_set_debug_object_name(context, VK_OBJECT_TYPE_DESCRIPTOR_SET, internal_shader->global_descriptor_sets[i], desc_set_object_name);
-        }
+    if (!result) {
+        KERROR("Failed to create pipelines for reloaded shader '%s'. The previous version is kept.", s->name);
+        shader_pipelines_destroy(context, internal_shader, false);
+        kcopy_memory(internal_shader->stages, old_stages, sizeof(vulkan_shader_stage) * VULKAN_SHADER_MAX_STAGES);
+        internal_shader->pipelines = old_pipelines;
+        internal_shader->packed_pipelines = old_packed_pipelines;
+        internal_shader->bound_pipeline_index = bound_pipeline_index;
+        internal_shader->current_topology = current_topology;
+        return false;
     }
 
+    // The old pipelines of every variant may still be in use by frames in flight. Variants other than the
+    // default are created again from the new stages as they are next used.
+    vulkan_pipeline **new_pipelines = internal_shader->pipelines;
+    vulkan_pipeline **new_packed_pipelines = internal_shader->packed_pipelines;
+    shader_variants_destroy(context, internal_shader, true);
+    internal_shader->variants[0].pipelines = new_pipelines;
+    internal_shader->variants[0].packed_pipelines = new_packed_pipelines;
+    internal_shader->bound_variant = 0;
+    internal_shader->pipelines = new_pipelines;
+    internal_shader->packed_pipelines = new_packed_pipelines;
+    internal_shader->bound_pipeline_index = bound_pipeline_index;
+    internal_shader->current_topology = current_topology;
+
     return true;
 }
 
 b8 vulkan_renderer_shader_use(renderer_plugin *plugin, shader *shader) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     vulkan_shader *s = shader->internal_data;
-    vulkan_command_buffer *command_buffer = &context->graphics_command_buffers[context->image_index];
-    vulkan_pipeline_bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, s->pipelines[s->bound_pipeline_index]);
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+    vulkan_pipeline_bind(command_buffer, s->bind_point, s->pipelines[s->bound_pipeline_index]);
+    s->bound_vertex_format = GEOMETRY_VERTEX_FORMAT_STANDARD;
+
+    // The bindless set never changes within a frame, so it is bound once here.
+    if (s->uses_bindless_textures) {
+        vkCmdBindDescriptorSets(command_buffer->handle, s->bind_point,
+                                s->pipelines[s->bound_pipeline_index]->pipeline_layout, s->descriptor_set_count, 1,
+                                &context->bindless_sets[context->current_frame], 0, 0);
+    }
 
     context->bound_shader = shader;
+    // Compute pipelines have no topology.
+    if (s->is_compute) {
+        return true;
+    }
     // Make sure to use the current bound type as well.
     if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
         vkCmdSetPrimitiveTopology(command_buffer->handle, s->current_topology);
@@ -2069,6 +3314,84 @@ b8 vulkan_renderer_shader_use(renderer_plugin *plugin, shader *shader) {
     return true;
 }
 
+b8 vulkan_renderer_shader_vertex_format_set(renderer_plugin *plugin, shader *shader, geometry_vertex_format format) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_shader *s = shader->internal_data;
+    if (s->bound_vertex_format == format) {
+        return true;
+    }
+
+    vulkan_pipeline *pipeline = 0;
+    if (format == GEOMETRY_VERTEX_FORMAT_STANDARD) {
+        pipeline = s->pipelines[s->bound_pipeline_index];
+    } else if (format == GEOMETRY_VERTEX_FORMAT_PACKED && s->packed_pipelines) {
+        pipeline = s->packed_pipelines[s->bound_pipeline_index];
+    }
+    if (!pipeline) {
+        KERROR("Shader '%s' has no pipeline for vertex format %u.", shader->name, format);
+        return false;
+    }
+
+    // The pipeline layouts match, so bound descriptor sets and dynamic state are kept.
+    vulkan_pipeline_bind(current_command_buffer_get(context), s->bind_point, pipeline);
+    s->bound_vertex_format = format;
+    return true;
+}
+
+b8 vulkan_renderer_shader_variant_use(renderer_plugin *plugin, shader *shader, u32 variant_index) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_shader *s = shader->internal_data;
+    if (s->bound_variant == variant_index) {
+        return true;
+    }
+
+    while (darray_length(s->variants) <= variant_index) {
+        vulkan_shader_variant empty_variant = {0};
+        darray_push(s->variants, empty_variant);
+    }
+
+    if (!s->variants[variant_index].pipelines) {
+        // Create the variant's pipelines, which the pipeline cache makes cheap once it has been seen
+        // before. Keep the bound pipelines aside, as creation replaces them.
+        vulkan_pipeline **bound_pipelines = s->pipelines;
+        vulkan_pipeline **bound_packed_pipelines = s->packed_pipelines;
+        u8 bound_pipeline_index = s->bound_pipeline_index;
+        VkPrimitiveTopology current_topology = s->current_topology;
+
+        s->pipelines = 0;
+        s->packed_pipelines = 0;
+        b8 result = shader_pipelines_create(context, shader, s, &shader->variants[variant_index]);
+        if (result) {
+            s->variants[variant_index].pipelines = s->pipelines;
+            s->variants[variant_index].packed_pipelines = s->packed_pipelines;
+        } else {
+            shader_pipelines_destroy(context, s, false);
+        }
+
+        s->pipelines = bound_pipelines;
+        s->packed_pipelines = bound_packed_pipelines;
+        s->bound_pipeline_index = bound_pipeline_index;
+        s->current_topology = current_topology;
+        if (!result) {
+            KERROR("Failed to create the pipelines of variant %u of shader '%s'.", variant_index, shader->name);
+            return false;
+        }
+        KDEBUG("Created variant %u of shader '%s'.", variant_index, shader->name);
+    }
+
+    s->pipelines = s->variants[variant_index].pipelines;
+    s->packed_pipelines = s->variants[variant_index].packed_pipelines;
+    s->bound_variant = variant_index;
+
+    // Bind it with the vertex format in use. The pipeline layouts match, so bound descriptor sets and dynamic state are kept.
+    vulkan_pipeline *pipeline = s->pipelines[s->bound_pipeline_index];
+    if (s->bound_vertex_format == GEOMETRY_VERTEX_FORMAT_PACKED && s->packed_pipelines) {
+        pipeline = s->packed_pipelines[s->bound_pipeline_index];
+    }
+    vulkan_pipeline_bind(current_command_buffer_get(context), s->bind_point, pipeline);
+    return true;
+}
+
 b8 vulkan_renderer_shader_bind_globals(renderer_plugin *plugin, shader *s) {
     if (!s) {
         return false;
@@ -2107,39 +3430,25 @@ b8 vulkan_renderer_shader_bind_local(renderer_plugin *plugin, shader *s) {
 
 b8 vulkan_renderer_shader_apply_globals(renderer_plugin *plugin, shader *s, b8 needs_update, struct frame_data *p_frame_data) {
     // Don't do anything if there are no updatable globals.
-    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0;
+    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0 || s->global_uniform_storage_count > 0;
     if (!has_global) {
         return true;
     }
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     u32 image_index = context->image_index;
     vulkan_shader *internal = s->internal_data;
-    VkCommandBuffer command_buffer = context->graphics_command_buffers[image_index].handle;
+    VkCommandBuffer command_buffer = current_command_buffer_get(context)->handle;
     VkDescriptorSet global_descriptor_set = internal->global_descriptor_sets[image_index];
     if (needs_update) {
-        VkWriteDescriptorSet descriptor_writes[1 + VULKAN_SHADER_MAX_GLOBAL_TEXTURES];
+        VkWriteDescriptorSet descriptor_writes[1 + VULKAN_SHADER_MAX_GLOBAL_TEXTURES + VULKAN_SHADER_MAX_GLOBAL_STORAGE];
+        VkDescriptorBufferInfo storage_buffer_infos[VULKAN_SHADER_MAX_GLOBAL_STORAGE];
+        VkDescriptorImageInfo storage_image_infos[VULKAN_SHADER_MAX_GLOBAL_STORAGE];
 
         u32 descriptor_write_count = 0;
         u32 binding_index = 0;
 
-        // Only update if there is actually a UBO
+        // The UBO descriptor always points at the uniform ring, so never needs updating. It comes first.
         if (s->global_uniform_count > 0) {
-            // Apply UBO first
-            VkDescriptorBufferInfo bufferInfo;
-            bufferInfo.buffer = ((vulkan_buffer *)internal->uniform_buffer.internal_data)->handle;
-            bufferInfo.offset = s->global_ubo_offset;
-            bufferInfo.range = s->global_ubo_stride;
-
-            // Update descriptor sets.
-            VkWriteDescriptorSet ubo_write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-            ubo_write.dstSet = internal->global_descriptor_sets[image_index];
-            ubo_write.dstBinding = binding_index;
-            ubo_write.dstArrayElement = 0;
-            ubo_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            ubo_write.descriptorCount = 1;
-            ubo_write.pBufferInfo = &bufferInfo;
-            descriptor_writes[binding_index] = ubo_write;
-            descriptor_write_count++;
             binding_index++;
         }
 
@@ -2195,7 +3504,7 @@ b8 vulkan_renderer_shader_apply_globals(renderer_plugin *plugin, shader *s, b8 n
                     }
 
                     vulkan_image *image = (vulkan_image *)t->internal_data;
-                    image_infos[d].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    image_infos[d].imageLayout = (t->flags & TEXTURE_FLAG_IS_STORAGE) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                     image_infos[d].imageView = image->view;
                     image_infos[d].sampler = context->samplers[map->internal_id];
 
@@ -2223,15 +3532,65 @@ b8 vulkan_renderer_shader_apply_globals(renderer_plugin *plugin, shader *s, b8 n
             }
         }
 
+        // Iterate storage buffers/images, which follow the samplers.
+        for (u32 sb = 0; sb < s->global_uniform_storage_count; ++sb) {
+            vulkan_uniform_storage_state *storage_state = &internal->global_storage_uniforms[sb];
+
+            VkWriteDescriptorSet storage_descriptor = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            storage_descriptor.dstSet = global_descriptor_set;
+            storage_descriptor.dstBinding = binding_index;
+            storage_descriptor.descriptorType = storage_state->type;
+            storage_descriptor.descriptorCount = 1;
+
+            if (storage_state->type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+                if (!storage_state->buffer) {
+                    KERROR("Storage buffer %u of shader '%s' was not set before applying globals.", sb, s->name);
+                    return false;
+                }
+                storage_buffer_infos[sb].buffer = ((vulkan_buffer *)storage_state->buffer->internal_data)->handle;
+                storage_buffer_infos[sb].offset = 0;
+                storage_buffer_infos[sb].range = VK_WHOLE_SIZE;
+                storage_descriptor.pBufferInfo = &storage_buffer_infos[sb];
+            } else {
+                if (!storage_state->image) {
+                    KERROR("Storage image %u of shader '%s' was not set before applying globals.", sb, s->name);
+                    return false;
+                }
+                // Storage images are always kept in the general layout.
+                storage_image_infos[sb].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                storage_image_infos[sb].imageView = ((vulkan_image *)storage_state->image->internal_data)->view;
+                storage_image_infos[sb].sampler = 0;
+                storage_descriptor.pImageInfo = &storage_image_infos[sb];
+            }
+
+            descriptor_writes[descriptor_write_count] = storage_descriptor;
+            descriptor_write_count++;
+
+            binding_index++;
+        }
+
         if (descriptor_write_count > 0) {
             vkUpdateDescriptorSets(context->device.logical_device, descriptor_write_count, descriptor_writes, 0, 0);
         }
     }
 
+    // Copy the global uniform values into the ring, unless they already are this frame.
+    u32 dynamic_offset_count = 0;
+    if (s->global_uniform_count > 0) {
+        if (internal->global_ubo_dirty || internal->global_ring_frame_number != context->frame_number) {
+            if (!vulkan_uniform_ring_write(context, internal->uniform_block + s->global_ubo_offset, s->global_ubo_stride, &internal->global_ring_offset)) {
+                return false;
+            }
+            internal->global_ring_frame_number = context->frame_number;
+            internal->global_ubo_dirty = false;
+        }
+        dynamic_offset_count = 1;
+    }
+
     // Bind the global descriptor set to be updated.
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+    vkCmdBindDescriptorSets(command_buffer, internal->bind_point,
                             internal->pipelines[internal->bound_pipeline_index]->pipeline_layout, 0, 1,
-                            &global_descriptor_set, 0, 0);
+                            &global_descriptor_set, dynamic_offset_count, &internal->global_ring_offset);
     return true;
 }
 
@@ -2243,7 +3602,7 @@ b8 vulkan_renderer_shader_apply_instance(renderer_plugin *plugin, shader *s, b8
         return false;
     }
     u32 image_index = context->image_index;
-    VkCommandBuffer command_buffer = context->graphics_command_buffers[image_index].handle;
+    VkCommandBuffer command_buffer = current_command_buffer_get(context)->handle;
 
     // Obtain instance data.
     vulkan_shader_instance_state *instance_state = &internal->instance_states[s->bound_instance_id];
@@ -2257,29 +3616,8 @@ b8 vulkan_renderer_shader_apply_instance(renderer_plugin *plugin, shader *s, b8
         u32 descriptor_write_count = 0;
         u32 binding_index = 0;
 
-        // Descriptor 0 - Uniform buffer
+        // Descriptor 0 - Uniform buffer. Always points at the uniform ring, so never needs updating.
         if (s->instance_uniform_count > 0) {
-            // Only do this if the descriptor has not yet been updated.
-            u8 *instance_ubo_generation = &(instance_state->ubo_descriptor_state.generations[image_index]);
-            if (*instance_ubo_generation == INVALID_ID_U8) {
-                VkDescriptorBufferInfo buffer_info;
-                buffer_info.buffer = ((vulkan_buffer *)internal->uniform_buffer.internal_data)->handle;
-                buffer_info.offset = instance_state->offset;
-                buffer_info.range = s->ubo_stride;
-
-                VkWriteDescriptorSet ubo_descriptor = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-                ubo_descriptor.dstSet = instance_descriptor_set;
-                ubo_descriptor.dstBinding = binding_index;
-                ubo_descriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                ubo_descriptor.descriptorCount = 1;
-                ubo_descriptor.pBufferInfo = &buffer_info;
-
-                descriptor_writes[descriptor_write_count] = ubo_descriptor;
-                descriptor_write_count++;
-
-                // Update the frame generation. In this case it is only needed once since this is a buffer.
-                *instance_ubo_generation = 1;
-            }
             binding_index++;
         }
 
@@ -2349,7 +3687,7 @@ b8 vulkan_renderer_shader_apply_instance(renderer_plugin *plugin, shader *s, b8
                     }
 
                     vulkan_image *image = (vulkan_image *)t->internal_data;
-                    image_infos[d].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    image_infos[d].imageLayout = (t->flags & TEXTURE_FLAG_IS_STORAGE) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                     image_infos[d].imageView = image->view;
                     image_infos[d].sampler = context->samplers[map->internal_id];
 
@@ -2385,14 +3723,28 @@ b8 vulkan_renderer_shader_apply_instance(renderer_plugin *plugin, shader *s, b8
     // Determine the descriptor set index which will be first. If there are no globals, for example,
     // this will be 0. If there are globals, this will be 1.
     u32 first_set = 1;
-    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0;
+    b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0 || s->global_uniform_storage_count > 0;
     if (!has_global) {
         first_set = 0;
     }
+
+    // Copy the instance's uniform values into the ring, unless they already are this frame.
+    u32 dynamic_offset_count = 0;
+    if (s->instance_uniform_count > 0) {
+        if (instance_state->ubo_dirty || instance_state->ring_frame_number != context->frame_number) {
+            if (!vulkan_uniform_ring_write(context, internal->uniform_block + instance_state->offset, s->ubo_stride, &instance_state->ring_offset)) {
+                return false;
+            }
+            instance_state->ring_frame_number = context->frame_number;
+            instance_state->ubo_dirty = false;
+        }
+        dynamic_offset_count = 1;
+    }
+
     // Bind the descriptor set to be updated, or in case the shader changed.
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+    vkCmdBindDescriptorSets(command_buffer, internal->bind_point,
                             internal->pipelines[internal->bound_pipeline_index]->pipeline_layout, first_set, 1,
-                            &instance_descriptor_set, 0, 0);
+                            &instance_descriptor_set, dynamic_offset_count, &instance_state->ring_offset);
     return true;
 }
 
@@ -2431,13 +3783,19 @@ static VkFilter convert_filter_type(const char *op, texture_filter filter) {
     }
 }
 
-static b8 create_sampler(vulkan_context *context, texture_map *map, VkSampler *sampler) {
+// The most anisotropy requested, clamped to what the device supports.
+#define SAMPLER_MAX_ANISOTROPY 16
+
+// Packs the settings a sampler is created with, so maps with the same settings can share it.
+static u32 sampler_key(vulkan_context *context, const texture_map *map) {
+    u32 anisotropy = (u32)KMIN((f32)SAMPLER_MAX_ANISOTROPY, context->device.properties.limits.maxSamplerAnisotropy);
+    return (u32)map->filter_minify | ((u32)map->filter_magnify << 4) | ((u32)map->repeat_u << 8) | ((u32)map->repeat_v << 12) | ((u32)map->repeat_w << 16) | (anisotropy << 20) | ((u32)(map->compare_depth ? 1 : 0) << 28);
+}
+
+static b8 create_sampler(vulkan_context *context, const texture_map *map, u32 key, VkSampler *sampler) {
     // Create a sampler for the texture
     VkSamplerCreateInfo sampler_info = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
 
-    // Sync the mip levels with that of the assigned texture.
-    map->mip_levels = map->texture->mip_levels;
-
     sampler_info.minFilter = convert_filter_type("min", map->filter_minify);
     sampler_info.magFilter = convert_filter_type("mag", map->filter_magnify);
 
@@ -2446,30 +3804,80 @@ static b8 create_sampler(vulkan_context *context, texture_map *map, VkSampler *s
     sampler_info.addressModeW = convert_repeat_type("W", map->repeat_w);
 
     // TODO: Configurable
-    sampler_info.anisotropyEnable = VK_TRUE;
-    sampler_info.maxAnisotropy = 16;
+    // Depth comparison samplers filter over the texels around each tap instead.
+    b8 compare = (key >> 28) & 1;
+    sampler_info.anisotropyEnable = compare ? VK_FALSE : VK_TRUE;
+    sampler_info.maxAnisotropy = (f32)((key >> 20) & 0xFF);
     sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
     // sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     sampler_info.unnormalizedCoordinates = VK_FALSE;
-    sampler_info.compareEnable = VK_FALSE;
-    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+    // A reference depth passes, i.e. is lit, where it is no further than the stored depth.
+    sampler_info.compareEnable = compare ? VK_TRUE : VK_FALSE;
+    sampler_info.compareOp = compare ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_ALWAYS;
     sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     sampler_info.mipLodBias = 0.0f;
-    // Use the full range of mips available.
+    // Use the full range of mips available. The image view limits this to the mips the texture has,
+    // so the sampler doesn't depend on the texture and can be shared.
     sampler_info.minLod = 0.0f;
     // NOTE: Uncomment the following line to test the lowest mip level.
     /* sampler_info.minLod = map->texture->mip_levels > 1 ? map->texture->mip_levels : 0.0f; */
-    sampler_info.maxLod = map->texture->mip_levels;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
 
     VkResult result = vkCreateSampler(context->device.logical_device, &sampler_info, context->allocator, sampler);
-    if (!vulkan_result_is_success(VK_SUCCESS)) {
+    if (!vulkan_result_is_success(result)) {
         KERROR("Error creating texture sampler: %s", vulkan_result_string(result, true));
         return false;
     }
 
+    char formatted_name[TEXTURE_NAME_MAX_LENGTH] = {0};
+    string_format(formatted_name, "sampler_%x", key);
+    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_SAMPLER, *sampler, formatted_name);
     return true;
 }
 
+// Obtains a sampler with the map's settings, creating it if no other map uses one. Returns 0 on failure.
+static VkSampler sampler_acquire(vulkan_context *context, texture_map *map) {
+    // Sync the mip levels with that of the assigned texture.
+    map->mip_levels = map->texture->mip_levels;
+
+    u32 key = sampler_key(context, map);
+    u32 entry_count = darray_length(context->sampler_cache);
+    for (u32 i = 0; i < entry_count; ++i) {
+        if (context->sampler_cache[i].key == key) {
+            context->sampler_cache[i].reference_count++;
+            return context->sampler_cache[i].sampler;
+        }
+    }
+
+    vulkan_sampler_cache_entry entry = {0};
+    entry.key = key;
+    entry.reference_count = 1;
+    if (!create_sampler(context, map, key, &entry.sampler)) {
+        return 0;
+    }
+    darray_push(context->sampler_cache, entry);
+    return entry.sampler;
+}
+
+// Drops a reference to a cached sampler, destroying it once frames in flight are done with it if it was the last.
+static void sampler_release(vulkan_context *context, VkSampler sampler) {
+    u32 entry_count = darray_length(context->sampler_cache);
+    for (u32 i = 0; i < entry_count; ++i) {
+        vulkan_sampler_cache_entry *entry = &context->sampler_cache[i];
+        if (entry->sampler == sampler) {
+            entry->reference_count--;
+            if (entry->reference_count == 0) {
+                vulkan_deferred_deletion_sampler(context, sampler);
+                // Order doesn't matter, so move the last entry into its place.
+                context->sampler_cache[i] = context->sampler_cache[entry_count - 1];
+                darray_length_set(context->sampler_cache, entry_count - 1);
+            }
+            return;
+        }
+    }
+    KWARN("sampler_release called for a sampler which is not in the cache.");
+}
+
 b8 vulkan_renderer_texture_map_resources_acquire(renderer_plugin *plugin, texture_map *map) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     // Find a free sampler.
@@ -2486,25 +3894,31 @@ b8 vulkan_renderer_texture_map_resources_acquire(renderer_plugin *plugin, textur
         darray_push(context->samplers, 0);
         selected_id = sampler_count;
     }
-    if (!create_sampler(context, map, &context->samplers[selected_id])) {
+    context->samplers[selected_id] = sampler_acquire(context, map);
+    if (!context->samplers[selected_id]) {
         return false;
     }
-
-    char formatted_name[TEXTURE_NAME_MAX_LENGTH] = {0};
-    string_format(formatted_name, "%s_texmap_sampler", map->texture->name);
-    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_SAMPLER, context->samplers[selected_id], formatted_name);
     map->internal_id = selected_id;
 
+    // Claim the matching bindless slot. The current frame's set is written right away, since the
+    // map may be drawn this frame. Other frames pick it up when they are next prepared.
+    if (context->bindless_textures && selected_id < VULKAN_MAX_BINDLESS_TEXTURES) {
+        context->bindless_textures[selected_id] = map->texture;
+        bindless_slot_sync(context, context->current_frame, selected_id);
+    }
+
     return true;
 }
 
 void vulkan_renderer_texture_map_resources_release(renderer_plugin *plugin, texture_map *map) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     if (map && map->internal_id != INVALID_ID) {
-        // Make sure there's no way this is in use.
-        vkDeviceWaitIdle(context->device.logical_device);
-        vkDestroySampler(context->device.logical_device, context->samplers[map->internal_id], context->allocator);
+        sampler_release(context, context->samplers[map->internal_id]);
         context->samplers[map->internal_id] = 0;
+        // NOTE: Stale entries are left in the bindless sets, which is fine since they are partially bound.
+        if (context->bindless_textures && map->internal_id < VULKAN_MAX_BINDLESS_TEXTURES) {
+            context->bindless_textures[map->internal_id] = 0;
+        }
         map->internal_id = INVALID_ID;
     }
 }
@@ -2512,25 +3926,162 @@ void vulkan_renderer_texture_map_resources_release(renderer_plugin *plugin, text
 b8 vulkan_renderer_texture_map_resources_refresh(renderer_plugin *plugin, texture_map *map) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     if (map && map->internal_id != INVALID_ID) {
-        // Create a new sampler first.
-        VkSampler new_sampler = 0;
-        if (!create_sampler(context, map, &new_sampler)) {
+        // Acquire the new sampler first, so one which is unchanged is kept rather than recreated.
+        VkSampler new_sampler = sampler_acquire(context, map);
+        if (!new_sampler) {
             return false;
         }
 
-        // Take a pointer to the current sampler.
+        // Swap in the new, releasing the old.
         VkSampler old_sampler = context->samplers[map->internal_id];
-
-        // Make sure there's no way this is in use.
-        vkDeviceWaitIdle(context->device.logical_device);
-        // Assign the new.
         context->samplers[map->internal_id] = new_sampler;
-        // Destroy the old.
-        vkDestroySampler(context->device.logical_device, old_sampler, context->allocator);
+        sampler_release(context, old_sampler);
+
+        // Point the bindless slot at the new sampler.
+        if (context->bindless_textures && map->internal_id < VULKAN_MAX_BINDLESS_TEXTURES) {
+            context->bindless_textures[map->internal_id] = map->texture;
+            bindless_slot_sync(context, context->current_frame, map->internal_id);
+        }
+    }
+    return true;
+}
+
+b8 vulkan_renderer_bindless_textures_supported(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return context->bindless_textures != 0;
+}
+
+u32 vulkan_renderer_texture_map_bindless_index_get(renderer_plugin *plugin, const texture_map *map) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    if (!context->bindless_textures || !map || map->internal_id >= VULKAN_MAX_BINDLESS_TEXTURES) {
+        return INVALID_ID;
+    }
+    // Slots share the index of the map's sampler.
+    return map->internal_id;
+}
+
+static b8 bindless_textures_create(vulkan_context *context) {
+    VkDevice logical_device = context->device.logical_device;
+
+    // A single, partially-bound array of combined image samplers which may be updated after being bound.
+    VkDescriptorSetLayoutBinding binding = {0};
+    binding.binding = 0;
+    binding.descriptorCount = VULKAN_MAX_BINDLESS_TEXTURES;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+    VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    binding_flags_info.bindingCount = 1;
+    binding_flags_info.pBindingFlags = &binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layout_info.pNext = &binding_flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+    VkResult result = vkCreateDescriptorSetLayout(logical_device, &layout_info, context->allocator, &context->bindless_layout);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to create bindless descriptor set layout: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VULKAN_MAX_BINDLESS_TEXTURES * VULKAN_MAX_FRAMES_IN_FLIGHT};
+    VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = VULKAN_MAX_FRAMES_IN_FLIGHT;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    result = vkCreateDescriptorPool(logical_device, &pool_info, context->allocator, &context->bindless_pool);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to create bindless descriptor pool: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+
+    VkDescriptorSetLayout layouts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        layouts[i] = context->bindless_layout;
+    }
+    VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.descriptorPool = context->bindless_pool;
+    alloc_info.descriptorSetCount = VULKAN_MAX_FRAMES_IN_FLIGHT;
+    alloc_info.pSetLayouts = layouts;
+    result = vkAllocateDescriptorSets(logical_device, &alloc_info, context->bindless_sets);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to allocate bindless descriptor sets: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+
+    context->bindless_textures = kallocate(sizeof(texture *) * VULKAN_MAX_BINDLESS_TEXTURES, MEMORY_TAG_RENDERER);
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        context->bindless_written[i] = kallocate(sizeof(vulkan_bindless_slot) * VULKAN_MAX_BINDLESS_TEXTURES, MEMORY_TAG_RENDERER);
     }
+
+    KINFO("Bindless textures enabled with %u slots.", VULKAN_MAX_BINDLESS_TEXTURES);
     return true;
 }
 
+static void bindless_textures_destroy(vulkan_context *context) {
+    if (context->bindless_pool) {
+        // NOTE: Destroying the pool frees the sets.
+        vkDestroyDescriptorPool(context->device.logical_device, context->bindless_pool, context->allocator);
+        context->bindless_pool = 0;
+    }
+    if (context->bindless_layout) {
+        vkDestroyDescriptorSetLayout(context->device.logical_device, context->bindless_layout, context->allocator);
+        context->bindless_layout = 0;
+    }
+    if (context->bindless_textures) {
+        kfree(context->bindless_textures, sizeof(texture *) * VULKAN_MAX_BINDLESS_TEXTURES, MEMORY_TAG_RENDERER);
+        context->bindless_textures = 0;
+        for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+            kfree(context->bindless_written[i], sizeof(vulkan_bindless_slot) * VULKAN_MAX_BINDLESS_TEXTURES, MEMORY_TAG_RENDERER);
+            context->bindless_written[i] = 0;
+        }
+    }
+}
+
+// Writes the given slot of the given frame's bindless set if its texture, image or sampler has changed since last written.
+static void bindless_slot_sync(vulkan_context *context, u32 frame_index, u32 slot_index) {
+    vulkan_bindless_slot *written = &context->bindless_written[frame_index][slot_index];
+    texture *t = context->bindless_textures[slot_index];
+    if (!t) {
+        // Free slot. Forget what was written so it is rewritten when next claimed.
+        written->t = 0;
+        return;
+    }
+
+    // Use the default texture while the assigned one is loading, same as per-instance samplers.
+    texture *source = t;
+    if (source->generation == INVALID_ID || !source->internal_data) {
+        source = texture_system_get_default_texture();
+    }
+    vulkan_image *image = (vulkan_image *)source->internal_data;
+    VkSampler sampler = context->samplers[slot_index];
+    if (written->t == t && written->generation == t->generation && written->view == image->view && written->sampler == sampler) {
+        return;
+    }
+
+    VkDescriptorImageInfo image_info;
+    image_info.imageLayout = (source->flags & TEXTURE_FLAG_IS_STORAGE) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = image->view;
+    image_info.sampler = sampler;
+
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = context->bindless_sets[frame_index];
+    write.dstBinding = 0;
+    write.dstArrayElement = slot_index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(context->device.logical_device, 1, &write, 0, 0);
+
+    written->t = t;
+    written->generation = t->generation;
+    written->view = image->view;
+    written->sampler = sampler;
+}
+
 b8 vulkan_renderer_shader_instance_resources_acquire(renderer_plugin *plugin, struct shader *s, const shader_instance_resource_config *config, u32 *out_instance_id) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     vulkan_shader *internal = s->internal_data;
@@ -2586,20 +4137,9 @@ b8 vulkan_renderer_shader_instance_resources_acquire(renderer_plugin *plugin, st
         }
     }
 
-    // Allocate some space in the UBO - by the stride, not the size.
-    u64 size = s->ubo_stride;
-    if (size > 0) {
-        if (!renderer_renderbuffer_allocate(&internal->uniform_buffer, size, &instance_state->offset)) {
-            KERROR("vulkan_material_shader_acquire_resources failed to acquire ubo space");
-            return false;
-        }
-    }
-
-    // UBO binding. NOTE: really only matters where there are instance uniforms, but set them anyway.
-    for (u32 j = 0; j < 3; ++j) {
-        instance_state->ubo_descriptor_state.generations[j] = INVALID_ID_U8;
-        instance_state->ubo_descriptor_state.ids[j] = INVALID_ID_U8;
-    }
+    // Each instance has a fixed place in the uniform block, following the globals - by the stride, not the size.
+    instance_state->offset = s->global_ubo_stride + (s->ubo_stride * (*out_instance_id));
+    instance_state->ubo_dirty = true;
 
     b8 has_global = s->global_uniform_count > 0 || s->global_uniform_sampler_count > 0;
     u8 instance_desc_set_index = has_global ? 1 : 0;
@@ -2610,13 +4150,8 @@ b8 vulkan_renderer_shader_instance_resources_acquire(renderer_plugin *plugin, st
         internal->descriptor_set_layouts[instance_desc_set_index],
         internal->descriptor_set_layouts[instance_desc_set_index]};
 
-    VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    alloc_info.descriptorPool = internal->descriptor_pool;
-    alloc_info.descriptorSetCount = 3;
-    alloc_info.pSetLayouts = layouts;
-    VkResult result = vkAllocateDescriptorSets(context->device.logical_device, &alloc_info, instance_state->descriptor_sets);
-    if (result != VK_SUCCESS) {
-        KERROR("Error allocating instance descriptor sets in shader: '%s'.", vulkan_result_string(result, true));
+    if (!vulkan_descriptor_allocator_allocate(context, &internal->descriptors, 3, layouts, instance_state->descriptor_sets, &instance_state->descriptor_pool)) {
+        KERROR("Error allocating instance descriptor sets in shader: '%s'.", s->name);
         return false;
     }
 
@@ -2624,6 +4159,10 @@ b8 vulkan_renderer_shader_instance_resources_acquire(renderer_plugin *plugin, st
         char desc_set_object_name[512] = {0};
         string_format(desc_set_object_name, "desc_set_shader_%s_instance_frame_%u", s->name, i);
         vulkan_set_debug_object_name(context, VK_OBJECT_TYPE_DESCRIPTOR_SET, instance_state->descriptor_sets[i], desc_set_object_name);
+        // The UBO is always the first binding.
+        if (s->instance_uniform_count > 0) {
+            uniform_ring_descriptor_write(context, instance_state->descriptor_sets[i], 0, s->ubo_stride);
+        }
     }
 
     return true;
@@ -2634,20 +4173,9 @@ b8 vulkan_renderer_shader_instance_resources_release(renderer_plugin *plugin, sh
     vulkan_shader *internal = s->internal_data;
     vulkan_shader_instance_state *instance_state = &internal->instance_states[instance_id];
 
-    // Wait for any pending operations using the descriptor set to finish.
-    vkDeviceWaitIdle(context->device.logical_device);
-
-    // Free 3 descriptor sets (one per frame)
-    VkResult result = vkFreeDescriptorSets(context->device.logical_device, internal->descriptor_pool, 3, instance_state->descriptor_sets);
-    if (result != VK_SUCCESS) {
-        KERROR("Error freeing object shader descriptor sets!");
-    }
-
-    // Invalidate UBO descriptor state.
-    for (u32 j = 0; j < 3; ++j) {
-        instance_state->ubo_descriptor_state.generations[j] = INVALID_ID_U8;
-        instance_state->ubo_descriptor_state.ids[j] = INVALID_ID_U8;
-    }
+    // Free 3 descriptor sets (one per frame), once frames in flight are done with them.
+    vulkan_deferred_deletion_descriptor_sets(context, internal, instance_state->descriptor_pool, instance_state->descriptor_sets);
+    instance_state->descriptor_pool = 0;
 
     // Destroy bindings and their descriptor states/uniforms.
     for (u32 a = 0; a < s->instance_uniform_sampler_count; ++a) {
@@ -2659,11 +4187,6 @@ b8 vulkan_renderer_shader_instance_resources_release(renderer_plugin *plugin, sh
         sampler_state->uniform_texture_maps = 0;
     }
 
-    if (s->ubo_stride != 0) {
-        if (!renderer_renderbuffer_free(&internal->uniform_buffer, s->ubo_stride, instance_state->offset)) {
-            KERROR("vulkan_renderer_shader_release_instance_resources failed to free range from renderbuffer.");
-        }
-    }
     instance_state->offset = INVALID_ID;
     instance_state->id = INVALID_ID;
 
@@ -2693,7 +4216,24 @@ static b8 sampler_state_try_set(vulkan_uniform_sampler_state *sampler_uniforms,
 
 b8 vulkan_renderer_uniform_set(renderer_plugin *plugin, shader *s, shader_uniform *uniform, u32 array_index, const void *value) {
     vulkan_shader *internal = s->internal_data;
-    if (uniform_type_is_sampler(uniform->type)) {
+    if (uniform_type_is_storage(uniform->type)) {
+        // Storage resources are always global.
+        if (uniform->location >= s->global_uniform_storage_count) {
+            KERROR("vulkan_renderer_uniform_set: storage location %u is out of range.", uniform->location);
+            return false;
+        }
+        vulkan_uniform_storage_state *storage_state = &internal->global_storage_uniforms[uniform->location];
+        if (uniform->type == SHADER_UNIFORM_TYPE_STORAGE_BUFFER) {
+            storage_state->buffer = (const renderbuffer *)value;
+        } else {
+            const texture *t = (const texture *)value;
+            if (t && !(t->flags & TEXTURE_FLAG_IS_STORAGE)) {
+                KERROR("vulkan_renderer_uniform_set: texture '%s' was not created as a storage texture.", t->name);
+                return false;
+            }
+            storage_state->image = t;
+        }
+    } else if (uniform_type_is_sampler(uniform->type)) {
         // Samplers can only be assigned at the instance or global level.
         texture_map *map = (texture_map *)value;
         if (uniform->scope == SHADER_SCOPE_GLOBAL) {
@@ -2708,10 +4248,15 @@ b8 vulkan_renderer_uniform_set(renderer_plugin *plugin, shader *s, shader_unifor
             addr += uniform->offset + (uniform->size * array_index);
             kcopy_memory((void *)addr, value, uniform->size);
         } else {
-            // Map the appropriate memory location and copy the data over.
-            u64 addr = (u64)internal->mapped_uniform_buffer_block;
+            // Copy the data over. It reaches the GPU when next applied.
+            u64 addr = (u64)internal->uniform_block;
             addr += s->bound_ubo_offset + uniform->offset + (uniform->size * array_index);
             kcopy_memory((void *)addr, value, uniform->size);
+            if (uniform->scope == SHADER_SCOPE_GLOBAL) {
+                internal->global_ubo_dirty = true;
+            } else {
+                internal->instance_states[s->bound_instance_id].ubo_dirty = true;
+            }
         }
     }
     return true;
@@ -2720,45 +4265,59 @@ b8 vulkan_renderer_uniform_set(renderer_plugin *plugin, shader *s, shader_unifor
 b8 vulkan_renderer_shader_apply_local(renderer_plugin *plugin, shader *s, frame_data *p_frame_data) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     vulkan_shader *internal = s->internal_data;
-    VkCommandBuffer command_buffer = context->graphics_command_buffers[context->image_index].handle;
+    VkCommandBuffer command_buffer = current_command_buffer_get(context)->handle;
     vkCmdPushConstants(
         command_buffer,
         internal->pipelines[internal->bound_pipeline_index]->pipeline_layout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        internal->push_constant_stages,
         0, 128, internal->local_push_constant_block);
     return true;
 }
 
-static b8 create_shader_module(vulkan_context *context, shader *s, shader_stage_config *config, vulkan_shader_stage *out_stage) {
-    shaderc_shader_kind shader_kind;
-    char *shader_type_str = 0;
-    VkShaderStageFlagBits stage;
-    switch (config->stage) {
-        case SHADER_STAGE_VERTEX:
-            shader_kind = shaderc_glsl_default_vertex_shader;
-            shader_type_str = "vertex";
-            stage = VK_SHADER_STAGE_VERTEX_BIT;
-            break;
-        case SHADER_STAGE_FRAGMENT:
-            shader_kind = shaderc_glsl_default_fragment_shader;
-            shader_type_str = "fragment";
-            stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-            break;
-        case SHADER_STAGE_COMPUTE:
-            shader_kind = shaderc_glsl_default_compute_shader;
-            shader_type_str = "compute";
-            stage = VK_SHADER_STAGE_COMPUTE_BIT;
-            break;
-        case SHADER_STAGE_GEOMETRY:
-            shader_kind = shaderc_glsl_default_geometry_shader;
-            shader_type_str = "geometry";
-            stage = VK_SHADER_STAGE_GEOMETRY_BIT;
-            break;
-        default:
-            KERROR("Unsupported shader kind. Unable to create module.");
-            return false;
+b8 vulkan_renderer_shader_local_block_push(renderer_plugin *plugin, shader *s, const void *block, u32 size) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_shader *internal = s->internal_data;
+    VkCommandBuffer command_buffer = current_command_buffer_get(context)->handle;
+    // Pushed straight from the caller's block, with no copy into the local push constant block.
+    vkCmdPushConstants(
+        command_buffer,
+        internal->pipelines[internal->bound_pipeline_index]->pipeline_layout,
+        internal->push_constant_stages,
+        0, KMIN(size, (u32)s->local_ubo_stride), block);
+    return true;
+}
+
+b8 vulkan_renderer_shader_dispatch(renderer_plugin *plugin, shader *s, u32 group_count_x, u32 group_count_y, u32 group_count_z) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_shader *internal = s->internal_data;
+    if (!internal->is_compute) {
+        KERROR("vulkan_renderer_shader_dispatch: shader '%s' is not a compute shader.", s->name);
+        return false;
     }
+    VkCommandBuffer command_buffer = current_command_buffer_get(context)->handle;
+
+    vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
+
+    // Make the writes visible to anything consuming the results afterward, be it vertex/index/indirect
+    // reads of a storage buffer, sampling of a storage image or another dispatch.
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, 0,
+        0, 0);
+    return true;
+}
 
+// Compiles the GLSL source of the given stage to SPIR-V, and creates its module from that.
+static b8 compile_shader_module(vulkan_context *context, shader *s, shader_stage_config *config, shaderc_shader_kind shader_kind, const char *shader_type_str, vulkan_shader_stage *out_stage) {
     KDEBUG("Compiling stage '%s' for shader '%s'...", shader_type_str, s->name);
 
     // Attempt to compile the shader.
@@ -2813,8 +4372,52 @@ static b8 create_shader_module(vulkan_context *context, shader *s, shader_stage_
 
     VK_CHECK(vkCreateShaderModule(context->device.logical_device, &out_stage->create_info, context->allocator, &out_stage->handle));
 
-    // Release the copy of the code.
-    kfree(code, result_length, MEMORY_TAG_RENDERER);
+    // Release the copy of the code.
+    kfree(code, result_length, MEMORY_TAG_RENDERER);
+
+    return true;
+}
+
+static b8 create_shader_module(vulkan_context *context, shader *s, shader_stage_config *config, vulkan_shader_stage *out_stage) {
+    shaderc_shader_kind shader_kind;
+    char *shader_type_str = 0;
+    VkShaderStageFlagBits stage;
+    switch (config->stage) {
+        case SHADER_STAGE_VERTEX:
+            shader_kind = shaderc_glsl_default_vertex_shader;
+            shader_type_str = "vertex";
+            stage = VK_SHADER_STAGE_VERTEX_BIT;
+            break;
+        case SHADER_STAGE_FRAGMENT:
+            shader_kind = shaderc_glsl_default_fragment_shader;
+            shader_type_str = "fragment";
+            stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            break;
+        case SHADER_STAGE_COMPUTE:
+            shader_kind = shaderc_glsl_default_compute_shader;
+            shader_type_str = "compute";
+            stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            break;
+        case SHADER_STAGE_GEOMETRY:
+            shader_kind = shaderc_glsl_default_geometry_shader;
+            shader_type_str = "geometry";
+            stage = VK_SHADER_STAGE_GEOMETRY_BIT;
+            break;
+        default:
+            KERROR("Unsupported shader kind. Unable to create module.");
+            return false;
+    }
+
+    if (config->precompiled) {
+        // Already SPIR-V, compiled by the tools into the shader's bundle.
+        kzero_memory(&out_stage->create_info, sizeof(VkShaderModuleCreateInfo));
+        out_stage->create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        out_stage->create_info.codeSize = config->source_length;
+        out_stage->create_info.pCode = (const u32 *)config->source;
+        VK_CHECK(vkCreateShaderModule(context->device.logical_device, &out_stage->create_info, context->allocator, &out_stage->handle));
+    } else if (!compile_shader_module(context, s, config, shader_kind, shader_type_str, out_stage)) {
+        return false;
+    }
 
     // Shader stage info
     kzero_memory(&out_stage->shader_stage_create_info, sizeof(VkPipelineShaderStageCreateInfo));
@@ -2833,11 +4436,19 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
 
     internal_data->depth = config->depth;
     internal_data->stencil = config->stencil;
+    internal_data->view_count = config->view_count;
 
     // Main subpass
     VkSubpassDescription subpass = {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
+    // How the outputs are used after this pass, as inferred by the rendergraph, if at all.
+    render_target_attachment_usage colour_usage = out_renderpass->colour_usage;
+    render_target_attachment_usage depth_usage = out_renderpass->depth_stencil_usage;
+    b8 depth_present_after = false;
+    // Indicates a colour attachment is sampled afterward by its own usage, if not by that of the pass.
+    b8 colour_attachment_sampled = false;
+
     // Attachments.
     VkAttachmentDescription *attachment_descriptions = darray_create(VkAttachmentDescription);
     VkAttachmentDescription *colour_attachment_descs = darray_create(VkAttachmentDescription);
@@ -2852,11 +4463,15 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
         if (attachment_config->type == RENDER_TARGET_ATTACHMENT_TYPE_COLOUR) {
             // Colour attachment.
             b8 do_clear_colour = (out_renderpass->clear_flags & RENDERPASS_CLEAR_COLOUR_BUFFER_FLAG) != 0;
+            // An attachment may override the usage inferred for the pass.
+            render_target_attachment_usage attachment_usage = attachment_config->usage != RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN ? attachment_config->usage : colour_usage;
+            colour_attachment_sampled |= attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED;
 
             if (attachment_config->source == RENDER_TARGET_ATTACHMENT_SOURCE_DEFAULT) {
                 attachment_desc.format = context->swapchain.image_format.format;
+            } else if (attachment_config->source == RENDER_TARGET_ATTACHMENT_SOURCE_SELF) {
+                attachment_desc.format = texture_format_to_vulkan(attachment_config->format);
             } else {
-                // TODO: configurable format?
                 attachment_desc.format = VK_FORMAT_R8G8B8A8_UNORM;
             }
 
@@ -2869,6 +4484,9 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
                 // If we don't care, the only other thing that needs checking is if the
                 // attachment is being cleared.
                 attachment_desc.loadOp = do_clear_colour ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            } else if (attachment_config->load_operation == RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_CLEAR) {
+                // Always cleared, to zero rather than the clear colour of the pass.
+                attachment_desc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
             } else {
                 // If we are loading, check if we are also clearing. This combination
                 // doesn't make sense, and should be warned about.
@@ -2890,6 +4508,11 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
                     return false;
                 }
             }
+            // Nothing earlier is continued into the attachment, so there is nothing worth loading.
+            b8 colour_load_skipped = out_renderpass->colour_contents_discarded && attachment_desc.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+            if (colour_load_skipped) {
+                attachment_desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            }
 
             // Determine which store operation to use.
             if (attachment_config->store_operation == RENDER_TARGET_ATTACHMENT_STORE_OPERATION_DONT_CARE) {
@@ -2900,6 +4523,13 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
                 KFATAL("Invalid store operation (0x%x) set for colour attachment. Check configuration.", attachment_config->store_operation);
                 return false;
             }
+            // Colour that is never read again does not need to be written back to memory, and anything
+            // read afterward must be stored, regardless of configuration.
+            if (attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_DISCARD) {
+                attachment_desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            } else if (attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_ATTACHMENT || attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED || attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_PRESENT) {
+                attachment_desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            }
 
             // NOTE: these will never be used on a colour attachment.
             attachment_desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -2909,22 +4539,35 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
             // undefined.
             attachment_desc.initialLayout =
                 attachment_config->load_operation ==
-                        RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD
+                            RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD &&
+                        !colour_load_skipped
                     ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
                     : VK_IMAGE_LAYOUT_UNDEFINED;
 
-            // If this is the last pass writing to this attachment, present after
-            // should be set to true.
-            attachment_desc.finalLayout =
-                attachment_config->present_after
-                    ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-                    : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;  // Transitioned to
-                                                                 // after the render
-                                                                 // pass
+            // The final layout is that of the next use, if known from the rendergraph. Otherwise, if
+            // this is the last pass writing to this attachment, present after should be set to true.
+            if (attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_PRESENT) {
+                attachment_desc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            } else if (attachment_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED) {
+                attachment_desc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            } else if (attachment_usage != RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN) {
+                attachment_desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            } else {
+                attachment_desc.finalLayout =
+                    attachment_config->present_after
+                        ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                        : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;  // Transitioned to
+                                                                     // after the render
+                                                                     // pass
+            }
             attachment_desc.flags = 0;
 
             // Push to colour attachments array.
             darray_push(colour_attachment_descs, attachment_desc);
+            if (internal_data->colour_attachment_count < VULKAN_MAX_COLOUR_ATTACHMENTS) {
+                internal_data->colour_attachments[internal_data->colour_attachment_count] = renderpass_attachment_from_description(&attachment_desc);
+            }
+            internal_data->colour_attachment_count++;
         } else if (attachment_config->type & RENDER_TARGET_ATTACHMENT_TYPE_DEPTH || attachment_config->type & RENDER_TARGET_ATTACHMENT_TYPE_STENCIL) {
             // Depth attachment.
             b8 do_clear_depth = (out_renderpass->clear_flags & RENDERPASS_CLEAR_DEPTH_BUFFER_FLAG) != 0;
@@ -2977,6 +4620,17 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
                     return false;
                 }
             }
+            // As for colour, nothing continued means nothing to load.
+            b8 depth_load_skipped = out_renderpass->depth_stencil_contents_discarded &&
+                                    (attachment_desc.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD || attachment_desc.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD);
+            if (depth_load_skipped) {
+                if (attachment_desc.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                    attachment_desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                }
+                if (attachment_desc.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                    attachment_desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                }
+            }
 
             // Determine which store operation to use.
             if (attachment_config->store_operation == RENDER_TARGET_ATTACHMENT_STORE_OPERATION_DONT_CARE) {
@@ -2989,19 +4643,45 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
                 KFATAL("Invalid store operation (0x%x) set for depth attachment. Check configuration.", attachment_config->store_operation);
                 return false;
             }
+            // Depth that is never read again does not need to be written back to memory, and anything
+            // read afterward must be stored, regardless of configuration.
+            if (depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_DISCARD) {
+                attachment_desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachment_desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            } else if (depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_ATTACHMENT || depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED) {
+                attachment_desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                attachment_desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            }
+            // A depth-only format has no stencil to load or store.
+            if (!format_has_stencil(attachment_desc.format)) {
+                attachment_desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachment_desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            }
 
             // If coming from a previous pass, should already be
             // VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL. Otherwise undefined.
+            b8 depth_loaded = attachment_desc.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD || attachment_desc.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
             attachment_desc.initialLayout =
-                attachment_config->load_operation == RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD
+                attachment_config->load_operation == RENDER_TARGET_ATTACHMENT_LOAD_OPERATION_LOAD && depth_loaded
                     ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
                     : VK_IMAGE_LAYOUT_UNDEFINED;
-            // Final layout for depth stencil attachments is always this.
-            attachment_desc.finalLayout =
-                attachment_config->present_after ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            // The final layout is that of the next use, if known from the rendergraph. Otherwise present
+            // after indicates the attachment is sampled afterward.
+            if (depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED) {
+                attachment_desc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            } else if (depth_usage != RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN) {
+                attachment_desc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            } else {
+                attachment_desc.finalLayout =
+                    attachment_config->present_after ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            }
+
+            depth_present_after = attachment_config->present_after;
 
             // Push to colour attachments array.
             darray_push(depth_attachment_descs, attachment_desc);
+            internal_data->depth_attachment = renderpass_attachment_from_description(&attachment_desc);
+            internal_data->has_depth_attachment = true;
         }
         // Push to general array.
         darray_push(attachment_descriptions, attachment_desc);
@@ -3057,15 +4737,58 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
     subpass.preserveAttachmentCount = 0;
     subpass.pPreserveAttachments = 0;
 
-    // Render pass dependencies. TODO: make this configurable.
-    VkSubpassDependency dependency;
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependency.dependencyFlags = 0;
+    // Render pass dependencies, derived from the attachments used. The first waits on writes to the
+    // same attachments by earlier passes before they are loaded, cleared or written.
+    VkPipelineStageFlags attachment_stages = 0;
+    VkAccessFlags attachment_writes = 0;
+    VkAccessFlags attachment_access = 0;
+    if (colour_attachment_count > 0) {
+        attachment_stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        attachment_writes |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        attachment_access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+    if (depth_attachment_count > 0) {
+        attachment_stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        attachment_writes |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        attachment_access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+    // The window image is acquired at the colour output stage, so that stage must always be waited on.
+    attachment_stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkSubpassDependency dependencies[2];
+    u32 dependency_count = 0;
+    dependencies[dependency_count].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[dependency_count].dstSubpass = 0;
+    dependencies[dependency_count].srcStageMask = attachment_stages;
+    dependencies[dependency_count].srcAccessMask = attachment_writes;
+    dependencies[dependency_count].dstStageMask = attachment_stages;
+    dependencies[dependency_count].dstAccessMask = attachment_access;
+    dependencies[dependency_count].dependencyFlags = 0;
+    dependency_count++;
+
+    // If a later pass samples an output of this one, its writes must be made visible to fragment
+    // shader reads once this pass completes.
+    b8 colour_sampled = colour_attachment_count > 0 && (colour_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED || colour_attachment_sampled);
+    b8 depth_sampled = depth_attachment_count > 0 && (depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_SAMPLED || (depth_usage == RENDER_TARGET_ATTACHMENT_USAGE_UNKNOWN && depth_present_after));
+    if (colour_sampled || depth_sampled) {
+        VkSubpassDependency *outgoing = &dependencies[dependency_count];
+        outgoing->srcSubpass = 0;
+        outgoing->dstSubpass = VK_SUBPASS_EXTERNAL;
+        outgoing->srcStageMask = 0;
+        outgoing->srcAccessMask = 0;
+        if (colour_sampled) {
+            outgoing->srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            outgoing->srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        }
+        if (depth_sampled) {
+            outgoing->srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            outgoing->srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        }
+        outgoing->dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        outgoing->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        outgoing->dependencyFlags = 0;
+        dependency_count++;
+    }
 
     // Render pass create.
     VkRenderPassCreateInfo render_pass_create_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
@@ -3074,14 +4797,32 @@ b8 vulkan_renderpass_create(renderer_plugin *plugin, const renderpass_config *co
     render_pass_create_info.pAttachments = attachment_descriptions;
     render_pass_create_info.subpassCount = 1;
     render_pass_create_info.pSubpasses = &subpass;
-    render_pass_create_info.dependencyCount = 1;
-    render_pass_create_info.pDependencies = &dependency;
+    render_pass_create_info.dependencyCount = dependency_count;
+    render_pass_create_info.pDependencies = dependencies;
     render_pass_create_info.pNext = 0;
     render_pass_create_info.flags = 0;
 
-    VK_CHECK(vkCreateRenderPass(context->device.logical_device,
-                                &render_pass_create_info, context->allocator,
-                                &internal_data->handle));
+    // Render to all of the layers at once, if configured to.
+    VkRenderPassMultiviewCreateInfo multiview_create_info = {VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO};
+    u32 view_mask = 0;
+    if (config->view_count > 1) {
+        view_mask = (1u << config->view_count) - 1;
+        multiview_create_info.subpassCount = 1;
+        multiview_create_info.pViewMasks = &view_mask;
+        // The views are likely to be rendered with similar content, so may be rendered concurrently.
+        multiview_create_info.correlationMaskCount = 1;
+        multiview_create_info.pCorrelationMasks = &view_mask;
+        render_pass_create_info.pNext = &multiview_create_info;
+    }
+
+    // With dynamic rendering, the attachments kept above are all that is needed to begin the pass,
+    // and its dependencies become barriers recorded around it, so no renderpass object is created.
+    internal_data->dynamic = (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT) && colour_attachment_count <= VULKAN_MAX_COLOUR_ATTACHMENTS;
+    if (!internal_data->dynamic) {
+        VK_CHECK(vkCreateRenderPass(context->device.logical_device,
+                                    &render_pass_create_info, context->allocator,
+                                    &internal_data->handle));
+    }
 
     // Cleanup
     if (attachment_descriptions) {
@@ -3111,14 +4852,80 @@ void vulkan_renderpass_destroy(renderer_plugin *plugin, renderpass *pass) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     if (pass && pass->internal_data) {
         vulkan_renderpass *internal_data = pass->internal_data;
-        vkDestroyRenderPass(context->device.logical_device, internal_data->handle,
-                            context->allocator);
-        internal_data->handle = 0;
+        if (internal_data->handle) {
+            vkDestroyRenderPass(context->device.logical_device, internal_data->handle,
+                                context->allocator);
+            internal_data->handle = 0;
+        }
         kfree(internal_data, sizeof(vulkan_renderpass), MEMORY_TAG_RENDERER);
         pass->internal_data = 0;
     }
 }
 
+b8 vulkan_renderpass_multiview_supported(renderer_plugin *plugin, u8 view_count) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_MULTIVIEW_BIT) && view_count <= context->device.max_multiview_view_count;
+}
+
+b8 vulkan_renderer_shading_rate_supported(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) != 0;
+}
+
+void vulkan_renderer_shading_rate_set(renderer_plugin *plugin, renderer_shading_rate rate) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+
+    VkExtent2D fragment_size = {1, 1};
+    switch (rate) {
+        default:
+        case RENDERER_SHADING_RATE_1X1:
+            break;
+        case RENDERER_SHADING_RATE_1X2:
+            fragment_size.height = 2;
+            break;
+        case RENDERER_SHADING_RATE_2X1:
+            fragment_size.width = 2;
+            break;
+        case RENDERER_SHADING_RATE_2X2:
+            fragment_size.width = fragment_size.height = 2;
+            break;
+        case RENDERER_SHADING_RATE_4X4:
+            fragment_size.width = fragment_size.height = context->device.max_fragment_shading_rate_size >= 4 ? 4 : 2;
+            break;
+    }
+
+    // Only the per-draw rate is used, so it is kept as-is by both combiners.
+    VkFragmentShadingRateCombinerOpKHR combiner_ops[2] = {VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR, VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR};
+    context->vkCmdSetFragmentShadingRateKHR(command_buffer->handle, &fragment_size, combiner_ops);
+}
+
+b8 vulkan_renderer_occlusion_query_begin(renderer_plugin *plugin, u32 query_index) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return vulkan_occlusion_query_begin(context, current_command_buffer_get(context)->handle, query_index);
+}
+
+void vulkan_renderer_occlusion_query_end(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_occlusion_query_end(context, current_command_buffer_get(context)->handle);
+}
+
+b8 vulkan_renderer_occlusion_query_results_get(renderer_plugin *plugin, u32 max_count, u8 *out_visible, u32 *out_count, u64 *out_frame_number) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    const vulkan_occlusion_queries *queries = &context->occlusion_queries;
+    u32 count = KMIN(max_count, queries->result_count);
+    kcopy_memory(out_visible, queries->results, sizeof(u8) * count);
+    *out_count = count;
+    *out_frame_number = queries->result_frame_number;
+    return true;
+}
+
+b8 vulkan_renderer_weighted_blend_supported(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return context->device.features.independentBlend && vulkan_renderer_texture_format_supported(plugin, TEXTURE_FORMAT_RGBA16F) &&
+           vulkan_renderer_texture_format_supported(plugin, TEXTURE_FORMAT_R16F);
+}
+
 b8 vulkan_renderer_render_target_create(renderer_plugin *plugin,
                                         u8 attachment_count,
                                         render_target_attachment *attachments,
@@ -3128,15 +4935,25 @@ b8 vulkan_renderer_render_target_create(renderer_plugin *plugin,
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     // Max number of attachments
     VkImageView attachment_views[32] = {0};
+    // Multiview passes render to all layers at once, so use the view encapsulating them.
+    b8 is_multiview = ((vulkan_renderpass *)pass->internal_data)->view_count > 1;
     for (u32 i = 0; i < attachment_count; ++i) {
         vulkan_image *internal = (vulkan_image *)attachments[i].texture->internal_data;
-        if (internal->layer_views) {
+        if (internal->layer_views && !is_multiview) {
             attachment_views[i] = internal->layer_views[layer_index];
         } else {
             attachment_views[i] = internal->view;
         }
     }
     kcopy_memory(out_target->attachments, attachments, sizeof(render_target_attachment) * attachment_count);
+    out_target->layer_index = layer_index;
+
+    // Image views are looked up from the attachments each time a dynamic rendering pass begins,
+    // so there is no framebuffer to create.
+    if (((vulkan_renderpass *)pass->internal_data)->dynamic) {
+        out_target->internal_framebuffer = 0;
+        return true;
+    }
 
     VkFramebufferCreateInfo framebuffer_create_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
     framebuffer_create_info.renderPass = ((vulkan_renderpass *)pass->internal_data)->handle;
@@ -3161,18 +4978,22 @@ void vulkan_renderer_render_target_destroy(renderer_plugin *plugin,
                                            render_target *target,
                                            b8 free_internal_memory) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    if (target && target->internal_framebuffer) {
+    if (!target) {
+        return;
+    }
+    // Targets of dynamic rendering passes have no framebuffer.
+    if (target->internal_framebuffer) {
         vkDestroyFramebuffer(context->device.logical_device,
                              (VkFramebuffer)target->internal_framebuffer,
                              context->allocator);
         target->internal_framebuffer = 0;
-        if (free_internal_memory) {
-            kfree(target->attachments,
-                  sizeof(render_target_attachment) * target->attachment_count,
-                  MEMORY_TAG_ARRAY);
-            target->attachments = 0;
-            target->attachment_count = 0;
-        }
+    }
+    if (free_internal_memory && target->attachments) {
+        kfree(target->attachments,
+              sizeof(render_target_attachment) * target->attachment_count,
+              MEMORY_TAG_ARRAY);
+        target->attachments = 0;
+        target->attachment_count = 0;
     }
 }
 
@@ -3212,6 +5033,186 @@ u8 vulkan_renderer_window_attachment_count_get(renderer_plugin *plugin) {
     return (u8)context->swapchain.image_count;
 }
 
+// Destroys whatever was created of a window other than the main one, and the window itself.
+static void window_resources_destroy(vulkan_context *context, vulkan_window *window) {
+    // Waits for the frames in flight, so nothing below is still in use.
+    if (window->swapchain.handle) {
+        vulkan_swapchain_destroy(context, &window->swapchain);
+    }
+
+    // The main window's textures live as long as the renderer, but these go with the window.
+    if (window->swapchain.render_textures) {
+        for (u32 i = 0; i < window->swapchain.image_count; ++i) {
+            kfree(window->swapchain.render_textures[i].internal_data, sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
+        }
+        kfree(window->swapchain.render_textures, sizeof(texture) * window->swapchain.image_count, MEMORY_TAG_RENDERER);
+    }
+    if (window->swapchain.depth_textures) {
+        kfree(window->swapchain.depth_textures, sizeof(texture) * window->swapchain.image_count, MEMORY_TAG_RENDERER);
+    }
+
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (window->image_available_semaphores[i]) {
+            vkDestroySemaphore(context->device.logical_device, window->image_available_semaphores[i], context->allocator);
+        }
+    }
+    if (window->surface) {
+        vkDestroySurfaceKHR(context->instance, window->surface, context->allocator);
+    }
+    kfree(window, sizeof(vulkan_window), MEMORY_TAG_RENDERER);
+}
+
+// Recreates the swapchain of a window other than the main one at its current size.
+static void window_swapchain_recreate(vulkan_context *context, renderer_window *window, vulkan_window *vk_window) {
+    vulkan_swapchain_recreate(context, window->width, window->height, &vk_window->swapchain);
+    vk_window->recreate_pending = false;
+    // Render targets using the attachments must be regenerated.
+    window->attachment_generation++;
+}
+
+b8 vulkan_renderer_window_create(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+
+    u32 slot = INVALID_ID;
+    for (u32 i = 0; i < VULKAN_MAX_WINDOWS; ++i) {
+        if (!context->windows[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == INVALID_ID) {
+        KERROR("Unable to render to another window, as at most %u are supported besides the main one.", VULKAN_MAX_WINDOWS);
+        return false;
+    }
+
+    vulkan_window *vk_window = kallocate(sizeof(vulkan_window), MEMORY_TAG_RENDERER);
+    if (!platform_create_vulkan_window_surface(context, window->platform_window, vk_window)) {
+        KERROR("Failed to create a surface for the window.");
+        window_resources_destroy(context, vk_window);
+        return false;
+    }
+
+    // The device was picked because it can present to the main window, which doesn't guarantee it can present to this one.
+    VkBool32 present_supported = VK_FALSE;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(context->device.physical_device, (u32)context->device.present_queue_index, vk_window->surface, &present_supported));
+    if (!present_supported) {
+        KERROR("The device is unable to present to the window.");
+        window_resources_destroy(context, vk_window);
+        return false;
+    }
+
+    VkSemaphoreCreateInfo semaphore_create_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        VK_CHECK(vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &vk_window->image_available_semaphores[i]));
+    }
+
+    // Presented the same way as the main window.
+    vk_window->swapchain.surface = vk_window->surface;
+    vk_window->swapchain.window_id = slot + 1;
+    vulkan_swapchain_create(context, KMAX(window->width, 1), KMAX(window->height, 1), context->swapchain.flags, &vk_window->swapchain);
+
+    context->windows[slot] = vk_window;
+    window->internal_data = vk_window;
+    return true;
+}
+
+void vulkan_renderer_window_destroy(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    if (!vk_window) {
+        return;
+    }
+
+    for (u32 i = 0; i < VULKAN_MAX_WINDOWS; ++i) {
+        if (context->windows[i] == vk_window) {
+            context->windows[i] = 0;
+        }
+    }
+    window_resources_destroy(context, vk_window);
+    window->internal_data = 0;
+}
+
+void vulkan_renderer_window_resized(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    if (vk_window) {
+        vk_window->recreate_pending = true;
+    }
+}
+
+b8 vulkan_renderer_window_acquire(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    if (!vk_window) {
+        return false;
+    }
+
+    if (vk_window->acquired_frame_number == context->frame_number) {
+        return true;
+    }
+
+    // Nothing can be rendered to a minimized window.
+    if (window->width == 0 || window->height == 0) {
+        return false;
+    }
+
+    // Recreated lazily as the main swapchain is, which also picks up changes to its flags (i.e. vsync).
+    if (vk_window->recreate_pending || vk_window->swapchain.flags != context->swapchain.flags) {
+        vk_window->swapchain.flags = context->swapchain.flags;
+        window_swapchain_recreate(context, window, vk_window);
+    }
+
+    // Waited on by the next submission, as the main window's image is by the first.
+    VkResult result = vkAcquireNextImageKHR(
+        context->device.logical_device,
+        vk_window->swapchain.handle,
+        UINT64_MAX,
+        vk_window->image_available_semaphores[context->current_frame],
+        0,
+        &vk_window->image_index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Skip the window this frame, and render to it again once recreated.
+        window_swapchain_recreate(context, window, vk_window);
+        return false;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        KERROR("Failed to acquire window swapchain image: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+
+    vk_window->acquired_frame_number = context->frame_number;
+    vk_window->image_wait_pending = true;
+    return true;
+}
+
+texture *vulkan_renderer_window_colour_get(renderer_plugin *plugin, renderer_window *window, u8 index) {
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    if (!vk_window || index >= vk_window->swapchain.image_count) {
+        KERROR("Attempting to get window colour attachment index out of range: %u.", index);
+        return 0;
+    }
+
+    return &vk_window->swapchain.render_textures[index];
+}
+
+texture *vulkan_renderer_window_depth_get(renderer_plugin *plugin, renderer_window *window, u8 index) {
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    if (!vk_window || index >= vk_window->swapchain.image_count) {
+        KERROR("Attempting to get window depth attachment index out of range: %u.", index);
+        return 0;
+    }
+
+    return &vk_window->swapchain.depth_textures[index];
+}
+
+u8 vulkan_renderer_window_image_index_get(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    return vk_window ? (u8)vk_window->image_index : 0;
+}
+
+u8 vulkan_renderer_window_image_count_get(renderer_plugin *plugin, renderer_window *window) {
+    vulkan_window *vk_window = (vulkan_window *)window->internal_data;
+    return vk_window ? (u8)vk_window->swapchain.image_count : 0;
+}
+
 b8 vulkan_renderer_is_multithreaded(renderer_plugin *plugin) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     return context->multithreading_enabled;
@@ -3228,6 +5229,23 @@ void vulkan_renderer_flag_enabled_set(renderer_plugin *plugin,
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
     context->swapchain.flags = (enabled ? (context->swapchain.flags | flag)
                                         : (context->swapchain.flags & ~flag));
+    // Only vsync and power saving affect the swapchain.
+    if (flag & (RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT | RENDERER_CONFIG_FLAG_POWER_SAVING_BIT)) {
+        context->render_flag_changed = true;
+    }
+}
+
+void vulkan_renderer_swapchain_settings_get(renderer_plugin *plugin,
+                                            renderer_swapchain_settings *out_settings) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    *out_settings = context->swapchain_settings;
+}
+
+void vulkan_renderer_swapchain_settings_set(renderer_plugin *plugin,
+                                            const renderer_swapchain_settings *settings) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    context->swapchain_settings = *settings;
+    // Recreated as the next frame is prepared, the same as for a flag change.
     context->render_flag_changed = true;
 }
 
@@ -3302,8 +5320,36 @@ b8 vulkan_buffer_create_internal(renderer_plugin *plugin, renderbuffer *buffer)
                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             break;
         case RENDERBUFFER_TYPE_STORAGE:
-            KERROR("Storage buffer not yet supported.");
-            return false;
+            // Written by compute shaders, and may be consumed afterward as vertex, index or indirect data.
+            internal_buffer.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            internal_buffer.memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case RENDERBUFFER_TYPE_INDIRECT: {
+            // Rewritten by the host every frame, so keep it host visible (and device-local when possible).
+            u32 device_local_bits = context->device.supports_device_local_host_visible
+                                        ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                        : 0;
+            internal_buffer.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+            internal_buffer.memory_property_flags =
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | device_local_bits;
+        } break;
+        case RENDERBUFFER_TYPE_DYNAMIC_VERTEX:
+        case RENDERBUFFER_TYPE_INSTANCE: {
+            // Rewritten by the host every frame, so keep it host visible (and device-local when possible).
+            u32 device_local_bits = context->device.supports_device_local_host_visible
+                                        ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                        : 0;
+            internal_buffer.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+            internal_buffer.memory_property_flags =
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | device_local_bits;
+        } break;
         default:
             KERROR("Unsupported buffer type: %i", buffer->type);
             return false;
@@ -3332,19 +5378,12 @@ b8 vulkan_buffer_create_internal(renderer_plugin *plugin, renderbuffer *buffer)
         return false;
     }
 
-    // Allocate memory info
-    VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocate_info.allocationSize = internal_buffer.memory_requirements.size;
-    allocate_info.memoryTypeIndex = (u32)internal_buffer.memory_index;
-
     // Allocate the memory.
-    VkResult result = vkAllocateMemory(context->device.logical_device, &allocate_info,
-                                       context->allocator, &internal_buffer.memory);
-    if (!vulkan_result_is_success(result)) {
-        KERROR("Failed to allocate memory for buffer with error: %s", vulkan_result_string(result, true));
+    if (!vulkan_memory_allocate(context, &internal_buffer.memory_requirements, (u32)internal_buffer.memory_index, true, false, buffer->name, &internal_buffer.memory)) {
+        KERROR("Failed to allocate memory for buffer '%s'.", buffer->name);
+        vkDestroyBuffer(context->device.logical_device, internal_buffer.handle, context->allocator);
         return false;
     }
-    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_DEVICE_MEMORY, internal_buffer.memory, buffer->name);
 
     // Determine if memory is on a device heap.
     b8 is_device_memory = (internal_buffer.memory_property_flags &
@@ -3355,14 +5394,6 @@ b8 vulkan_buffer_create_internal(renderer_plugin *plugin, renderbuffer *buffer)
     kallocate_report(internal_buffer.memory_requirements.size,
                      is_device_memory ? MEMORY_TAG_GPU_LOCAL : MEMORY_TAG_VULKAN);
 
-    if (result != VK_SUCCESS) {
-        KERROR(
-            "Unable to create vulkan buffer because the required memory "
-            "allocation failed. Error: %i",
-            result);
-        return false;
-    }
-
     // Allocate the internal state block of memory at the end once we are sure
     // everything was created successfully.
     buffer->internal_data = kallocate(sizeof(vulkan_buffer), MEMORY_TAG_VULKAN);
@@ -3373,18 +5404,12 @@ b8 vulkan_buffer_create_internal(renderer_plugin *plugin, renderbuffer *buffer)
 
 void vulkan_buffer_destroy_internal(renderer_plugin *plugin, renderbuffer *buffer) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vkDeviceWaitIdle(context->device.logical_device);
     if (buffer) {
         vulkan_buffer *internal_buffer = (vulkan_buffer *)buffer->internal_data;
         if (internal_buffer) {
-            if (internal_buffer->memory) {
-                vkFreeMemory(context->device.logical_device, internal_buffer->memory,
-                             context->allocator);
-                internal_buffer->memory = 0;
-            }
+            // Frames in flight may still be using the buffer, so it is destroyed once they retire.
             if (internal_buffer->handle) {
-                vkDestroyBuffer(context->device.logical_device, internal_buffer->handle,
-                                context->allocator);
+                vulkan_deferred_deletion_buffer(context, internal_buffer->handle, &internal_buffer->memory);
                 internal_buffer->handle = 0;
             }
 
@@ -3432,45 +5457,38 @@ b8 vulkan_buffer_resize(renderer_plugin *plugin, renderbuffer *buffer,
     vkGetBufferMemoryRequirements(context->device.logical_device, new_buffer,
                                   &requirements);
 
-    // Allocate memory info
-    VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocate_info.allocationSize = requirements.size;
-    allocate_info.memoryTypeIndex = (u32)internal_buffer->memory_index;
-
     // Allocate the memory.
-    VkDeviceMemory new_memory;
-    VkResult result = vkAllocateMemory(context->device.logical_device, &allocate_info, context->allocator, &new_memory);
-    if (result != VK_SUCCESS) {
-        KERROR(
-            "Unable to resize vulkan buffer because the required memory "
-            "allocation failed. Error: %i",
-            result);
+    vulkan_memory_allocation new_memory;
+    if (!vulkan_memory_allocate(context, &requirements, (u32)internal_buffer->memory_index, true, false, buffer->name, &new_memory)) {
+        KERROR("Unable to resize vulkan buffer because the required memory allocation failed.");
+        vkDestroyBuffer(context->device.logical_device, new_buffer, context->allocator);
         return false;
     }
-    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_DEVICE_MEMORY, new_memory, buffer->name);
 
     // Bind the new buffer's memory
     VK_CHECK(vkBindBufferMemory(context->device.logical_device, new_buffer,
-                                new_memory, 0));
+                                new_memory.memory, new_memory.offset));
 
     // Copy over the data.
-    vulkan_buffer_copy_range_internal(context, internal_buffer->handle, 0,
-                                      new_buffer, 0, buffer->total_size);
-
-    // Make sure anything potentially using these is finished.
-    // NOTE: We could use vkQueueWaitIdle here if we knew what queue this buffer
-    // would be used with...
-    vkDeviceWaitIdle(context->device.logical_device);
-
-    // Destroy the old
-    if (internal_buffer->memory) {
-        vkFreeMemory(context->device.logical_device, internal_buffer->memory,
-                     context->allocator);
-        internal_buffer->memory = 0;
+    if (vulkan_buffer_is_host_visible(plugin, internal_buffer)) {
+        // Copy on the CPU, since anything written to the new buffer from here on goes directly to it.
+        void *old_data = vulkan_memory_map(context, &internal_buffer->memory, 0, buffer->total_size);
+        void *new_data = vulkan_memory_map(context, &new_memory, 0, buffer->total_size);
+        if (old_data && new_data) {
+            kcopy_memory(new_data, old_data, buffer->total_size);
+        }
+        vulkan_memory_unmap(context, &new_memory);
+        vulkan_memory_unmap(context, &internal_buffer->memory);
+    } else {
+        // Recorded alongside uploads, so it lands before anything loaded into the new buffer afterward.
+        if (!vulkan_upload_copy_buffer(context, internal_buffer->handle, 0, new_buffer, 0, buffer->total_size)) {
+            KERROR("Failed to copy buffer contents during resize.");
+        }
     }
+
+    // Destroy the old once frames in flight (and the copy) are done with it.
     if (internal_buffer->handle) {
-        vkDestroyBuffer(context->device.logical_device, internal_buffer->handle,
-                        context->allocator);
+        vulkan_deferred_deletion_buffer(context, internal_buffer->handle, &internal_buffer->memory);
         internal_buffer->handle = 0;
     }
 
@@ -3501,8 +5519,8 @@ b8 vulkan_buffer_bind(renderer_plugin *plugin, renderbuffer *buffer,
     }
     vulkan_buffer *internal_buffer = (vulkan_buffer *)buffer->internal_data;
     VK_CHECK(vkBindBufferMemory(context->device.logical_device,
-                                internal_buffer->handle, internal_buffer->memory,
-                                offset));
+                                internal_buffer->handle, internal_buffer->memory.memory,
+                                internal_buffer->memory.offset + offset));
     return true;
 }
 
@@ -3524,10 +5542,7 @@ void *vulkan_buffer_map_memory(renderer_plugin *plugin, renderbuffer *buffer,
         return 0;
     }
     vulkan_buffer *internal_buffer = (vulkan_buffer *)buffer->internal_data;
-    void *data;
-    VK_CHECK(vkMapMemory(context->device.logical_device, internal_buffer->memory,
-                         offset, size, 0, &data));
-    return data;
+    return vulkan_memory_map(context, &internal_buffer->memory, offset, size);
 }
 
 void vulkan_buffer_unmap_memory(renderer_plugin *plugin, renderbuffer *buffer,
@@ -3538,7 +5553,7 @@ void vulkan_buffer_unmap_memory(renderer_plugin *plugin, renderbuffer *buffer,
         return;
     }
     vulkan_buffer *internal_buffer = (vulkan_buffer *)buffer->internal_data;
-    vkUnmapMemory(context->device.logical_device, internal_buffer->memory);
+    vulkan_memory_unmap(context, &internal_buffer->memory);
 }
 
 b8 vulkan_buffer_flush(renderer_plugin *plugin, renderbuffer *buffer,
@@ -3551,10 +5566,17 @@ b8 vulkan_buffer_flush(renderer_plugin *plugin, renderbuffer *buffer,
     // NOTE: If not host-coherent, flush the mapped memory range.
     vulkan_buffer *internal_buffer = (vulkan_buffer *)buffer->internal_data;
     if (!vulkan_buffer_is_host_coherent(plugin, internal_buffer)) {
+        // The range must be aligned to the atom size, which sub-allocation offsets need not be.
+        u64 atom_size = context->device.properties.limits.nonCoherentAtomSize;
+        u64 start = internal_buffer->memory.offset + offset;
+        u64 aligned_start = start - (start % atom_size);
         VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
-        range.memory = internal_buffer->memory;
-        range.offset = offset;
-        range.size = size;
+        range.memory = internal_buffer->memory.memory;
+        range.offset = aligned_start;
+        range.size = get_aligned(size + (start - aligned_start), atom_size);
+        if (internal_buffer->memory.block_index == INVALID_ID && range.offset + range.size > internal_buffer->memory.size) {
+            range.size = VK_WHOLE_SIZE;
+        }
         VK_CHECK(
             vkFlushMappedMemoryRanges(context->device.logical_device, 1, &range));
     }
@@ -3592,26 +5614,27 @@ b8 vulkan_buffer_read(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
         renderer_renderbuffer_bind(&read, 0);
         vulkan_buffer *read_internal = (vulkan_buffer *)read.internal_data;
 
-        // Perform the copy from device local to the read buffer.
-        vulkan_buffer_copy_range(plugin, buffer, offset, &read, 0, size);
+        // Perform the copy from device local to the read buffer, waiting for it to complete.
+        vulkan_buffer_copy_range_internal(context, internal_buffer->handle, offset, read_internal->handle, 0, size);
 
         // Map/copy/unmap
-        void *mapped_data;
-        VK_CHECK(vkMapMemory(context->device.logical_device, read_internal->memory,
-                             0, size, 0, &mapped_data));
-        kcopy_memory(*out_memory, mapped_data, size);
-        vkUnmapMemory(context->device.logical_device, read_internal->memory);
+        void *mapped_data = vulkan_memory_map(context, &read_internal->memory, 0, size);
+        if (mapped_data) {
+            kcopy_memory(*out_memory, mapped_data, size);
+            vulkan_memory_unmap(context, &read_internal->memory);
+        }
 
         // Clean up the read buffer.
         renderer_renderbuffer_unbind(&read);
         renderer_renderbuffer_destroy(&read);
     } else {
         // If no staging buffer is needed, map/copy/unmap.
-        void *data_ptr;
-        VK_CHECK(vkMapMemory(context->device.logical_device,
-                             internal_buffer->memory, offset, size, 0, &data_ptr));
+        void *data_ptr = vulkan_memory_map(context, &internal_buffer->memory, offset, size);
+        if (!data_ptr) {
+            return false;
+        }
         kcopy_memory(*out_memory, data_ptr, size);
-        vkUnmapMemory(context->device.logical_device, internal_buffer->memory);
+        vulkan_memory_unmap(context, &internal_buffer->memory);
     }
 
     return true;
@@ -3634,20 +5657,16 @@ b8 vulkan_buffer_load_range(renderer_plugin *plugin, renderbuffer *buffer,
         // not host visible but is device-local, create a staging buffer to load the
         // data into first. Then copy from it to the target buffer.
 
-        // Load the data into the staging buffer.
-        u64 staging_offset = 0;
-        renderer_renderbuffer_allocate(&context->staging, size, &staging_offset);
-        vulkan_buffer_load_range(plugin, &context->staging, staging_offset, size, data);
-
-        // Perform the copy from staging to the device local buffer.
-        vulkan_buffer_copy_range(plugin, &context->staging, staging_offset, buffer, offset, size);
+        // Stage the data and record the copy, which happens once pending uploads are flushed.
+        return vulkan_upload_buffer(context, internal_buffer, offset, size, data);
     } else {
         // If no staging buffer is needed, map/copy/unmap.
-        void *data_ptr;
-        VK_CHECK(vkMapMemory(context->device.logical_device,
-                             internal_buffer->memory, offset, size, 0, &data_ptr));
+        void *data_ptr = vulkan_memory_map(context, &internal_buffer->memory, offset, size);
+        if (!data_ptr) {
+            return false;
+        }
         kcopy_memory(data_ptr, data, size);
-        vkUnmapMemory(context->device.logical_device, internal_buffer->memory);
+        vulkan_memory_unmap(context, &internal_buffer->memory);
     }
 
     return true;
@@ -3657,6 +5676,9 @@ static b8 vulkan_buffer_copy_range_internal(vulkan_context *context,
                                             VkBuffer source, u64 source_offset,
                                             VkBuffer dest, u64 dest_offset,
                                             u64 size) {
+    // Pending uploads to either buffer must complete first.
+    vulkan_upload_flush(context);
+
     // TODO: Assuming queue and pool usage here. Might want dedicated queue.
     VkQueue queue = context->device.graphics_queue;
     vkQueueWaitIdle(queue);
@@ -3692,26 +5714,38 @@ b8 vulkan_buffer_copy_range(renderer_plugin *plugin, renderbuffer *source,
         return false;
     }
 
-    return vulkan_buffer_copy_range_internal(
+    // Recorded along with uploads rather than waited on, since nothing reads the result on the CPU.
+    return vulkan_upload_copy_buffer(
         context, ((vulkan_buffer *)source->internal_data)->handle, source_offset,
         ((vulkan_buffer *)dest->internal_data)->handle, dest_offset, size);
-    return true;
 }
 
-b8 vulkan_buffer_draw(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
-                      u32 element_count, b8 bind_only) {
+void vulkan_renderer_upload_synchronous_set(renderer_plugin *plugin, b8 synchronous) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    // Whatever was batched so far goes out first, so that nothing is left waiting on a later upload.
+    if (synchronous && !vulkan_upload_wait(context)) {
+        KERROR("Failed to complete pending uploads.");
+    }
+    context->upload.synchronous = synchronous;
+}
+
+b8 vulkan_renderer_upload_wait(renderer_plugin *plugin) {
     vulkan_context *context = (vulkan_context *)plugin->internal_context;
-    vulkan_command_buffer *command_buffer =
-        &context->graphics_command_buffers[context->image_index];
+    return vulkan_upload_wait(context);
+}
+
+static b8 vulkan_buffer_draw_internal(vulkan_context *context, renderbuffer *buffer, u64 offset,
+                                      u32 element_count, u32 instance_count, b8 bind_only) {
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
 
-    if (buffer->type == RENDERBUFFER_TYPE_VERTEX) {
+    if (buffer->type == RENDERBUFFER_TYPE_VERTEX || buffer->type == RENDERBUFFER_TYPE_DYNAMIC_VERTEX) {
         // Bind vertex buffer at offset.
         VkDeviceSize offsets[1] = {offset};
         vkCmdBindVertexBuffers(command_buffer->handle, 0, 1,
                                &((vulkan_buffer *)buffer->internal_data)->handle,
                                offsets);
         if (!bind_only) {
-            vkCmdDraw(command_buffer->handle, element_count, 1, 0, 0);
+            vkCmdDraw(command_buffer->handle, element_count, instance_count, 0, 0);
         }
         return true;
     } else if (buffer->type == RENDERBUFFER_TYPE_INDEX) {
@@ -3720,11 +5754,63 @@ b8 vulkan_buffer_draw(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
                              ((vulkan_buffer *)buffer->internal_data)->handle,
                              offset, VK_INDEX_TYPE_UINT32);
         if (!bind_only) {
-            vkCmdDrawIndexed(command_buffer->handle, element_count, 1, 0, 0, 0);
+            vkCmdDrawIndexed(command_buffer->handle, element_count, instance_count, 0, 0, 0);
+        }
+        return true;
+    } else if (buffer->type == RENDERBUFFER_TYPE_INSTANCE || buffer->type == RENDERBUFFER_TYPE_STORAGE) {
+        // NOTE: Storage buffers may also provide per-instance data, such as that written by a compute shader.
+        if (!bind_only) {
+            KERROR("Instance buffers cannot be drawn directly, only bound.");
+            return false;
         }
+        // Bind the per-instance data to binding 1 at offset.
+        VkDeviceSize offsets[1] = {offset};
+        vkCmdBindVertexBuffers(command_buffer->handle, 1, 1,
+                               &((vulkan_buffer *)buffer->internal_data)->handle,
+                               offsets);
         return true;
     } else {
         KERROR("Cannot draw buffer of type: %i", buffer->type);
         return false;
     }
 }
+
+b8 vulkan_buffer_draw(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
+                      u32 element_count, b8 bind_only) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return vulkan_buffer_draw_internal(context, buffer, offset, element_count, 1, bind_only);
+}
+
+b8 vulkan_buffer_draw_instanced(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
+                                u32 element_count, u32 instance_count) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return vulkan_buffer_draw_internal(context, buffer, offset, element_count, instance_count, false);
+}
+
+b8 vulkan_buffer_indirect_draw_supported(renderer_plugin *plugin) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    return (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DRAW_INDIRECT_FIRST_INSTANCE_BIT) != 0;
+}
+
+b8 vulkan_buffer_draw_indirect(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
+                               u32 draw_count) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    // NOTE: Storage buffers are also accepted, so that draw commands may be written by a compute shader.
+    if (!buffer || !buffer->internal_data || (buffer->type != RENDERBUFFER_TYPE_INDIRECT && buffer->type != RENDERBUFFER_TYPE_STORAGE)) {
+        KERROR("vulkan_buffer_draw_indirect requires a valid pointer to an indirect or storage buffer.");
+        return false;
+    }
+    vulkan_command_buffer *command_buffer = current_command_buffer_get(context);
+    VkBuffer handle = ((vulkan_buffer *)buffer->internal_data)->handle;
+    u32 stride = sizeof(renderer_indirect_draw_command);
+
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_MULTI_DRAW_INDIRECT_BIT) {
+        vkCmdDrawIndexedIndirect(command_buffer->handle, handle, offset, draw_count, stride);
+    } else {
+        // Without multi-draw support, only a single draw may be issued per call.
+        for (u32 i = 0; i < draw_count; ++i) {
+            vkCmdDrawIndexedIndirect(command_buffer->handle, handle, offset + (stride * i), 1, stride);
+        }
+    }
+    return true;
+}
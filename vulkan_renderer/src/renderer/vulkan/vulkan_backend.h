@@ -36,6 +36,7 @@ void vulkan_renderer_scissor_reset(renderer_plugin* backend);
 void vulkan_renderer_winding_set(struct renderer_plugin* plugin, renderer_winding winding);
 void vulkan_renderer_set_stencil_test_enabled(struct renderer_plugin* plugin, b8 enabled);
 void vulkan_renderer_set_depth_test_enabled(struct renderer_plugin* plugin, b8 enabled);
+void vulkan_renderer_set_depth_compare_op(struct renderer_plugin* plugin, renderer_compare_op compare_op);
 void vulkan_renderer_set_stencil_reference(struct renderer_plugin* plugin, u32 reference);
 void vulkan_renderer_set_stencil_op(struct renderer_plugin* plugin, renderer_stencil_op fail_op, renderer_stencil_op pass_op, renderer_stencil_op depth_fail_op, renderer_compare_op compare_op);
 void vulkan_renderer_set_stencil_compare_mask(struct renderer_plugin* plugin, u32 compare_mask);
@@ -44,19 +45,33 @@ void vulkan_renderer_set_stencil_write_mask(struct renderer_plugin* plugin, u32
 b8 vulkan_renderer_renderpass_begin(renderer_plugin* backend, renderpass* pass, render_target* target);
 b8 vulkan_renderer_renderpass_end(renderer_plugin* backend, renderpass* pass);
 
+b8 vulkan_renderer_command_list_begin(renderer_plugin* backend, u8 index);
+b8 vulkan_renderer_command_list_end(renderer_plugin* backend, u8 index);
+b8 vulkan_renderer_command_list_execute(renderer_plugin* backend, u8 index);
+b8 vulkan_renderer_async_compute_begin(renderer_plugin* backend);
+void vulkan_renderer_async_compute_end(renderer_plugin* backend);
+b8 vulkan_renderer_async_compute_wait(renderer_plugin* backend);
+
 void vulkan_renderer_texture_create(renderer_plugin* backend, const u8* pixels, texture* texture);
+void vulkan_renderer_texture_create_layered(renderer_plugin* backend, const u8* const* layer_pixels, texture* t);
+b8 vulkan_renderer_texture_format_supported(renderer_plugin* backend, texture_format format);
 void vulkan_renderer_texture_destroy(renderer_plugin* backend, texture* texture);
 void vulkan_renderer_texture_create_writeable(renderer_plugin* backend, texture* t);
 void vulkan_renderer_texture_resize(renderer_plugin* backend, texture* t, u32 new_width, u32 new_height);
 void vulkan_renderer_texture_write_data(renderer_plugin* backend, texture* t, u32 offset, u32 size, const u8* pixels);
+void vulkan_renderer_texture_write_region(renderer_plugin* backend, texture* t, u32 x, u32 y, u32 width, u32 height, const u8* pixels);
 void vulkan_renderer_texture_read_data(renderer_plugin* backend, texture* t, u32 offset, u32 size, void** out_memory);
 void vulkan_renderer_texture_read_pixel(renderer_plugin* backend, texture* t, u32 x, u32 y, u8** out_rgba);
+b8 vulkan_renderer_texture_read_pixel_async(renderer_plugin* backend, texture* t, u32 x, u32 y, renderer_readback_ticket* out_ticket);
+renderer_readback_status vulkan_renderer_readback_resolve(renderer_plugin* backend, renderer_readback_ticket ticket, u32 size, void* out_data);
 
 b8 vulkan_renderer_shader_create(renderer_plugin* backend, struct shader* shader, const shader_config* config, renderpass* pass);
 void vulkan_renderer_shader_destroy(renderer_plugin* backend, struct shader* shader);
 
 b8 vulkan_renderer_shader_initialize(renderer_plugin* backend, struct shader* shader);
+b8 vulkan_renderer_shader_reload(renderer_plugin* backend, struct shader* shader);
 b8 vulkan_renderer_shader_use(renderer_plugin* backend, struct shader* shader);
+b8 vulkan_renderer_shader_vertex_format_set(renderer_plugin* backend, struct shader* shader, geometry_vertex_format format);
 b8 vulkan_renderer_shader_bind_globals(renderer_plugin* backend, struct shader* s);
 b8 vulkan_renderer_shader_bind_instance(renderer_plugin* backend, struct shader* s, u32 instance_id);
 b8 vulkan_renderer_shader_bind_local(renderer_plugin* backend, struct shader* s);
@@ -66,13 +81,25 @@ b8 vulkan_renderer_shader_instance_resources_acquire(renderer_plugin* backend, s
 b8 vulkan_renderer_shader_instance_resources_release(renderer_plugin* backend, struct shader* s, u32 instance_id);
 b8 vulkan_renderer_uniform_set(renderer_plugin* backend, struct shader* frontend_shader, struct shader_uniform* uniform, u32 array_index, const void* value);
 b8 vulkan_renderer_shader_apply_local(renderer_plugin* plugin, struct shader* s, struct frame_data* p_frame_data);
+b8 vulkan_renderer_shader_local_block_push(renderer_plugin* plugin, struct shader* s, const void* block, u32 size);
+b8 vulkan_renderer_shader_variant_use(renderer_plugin* plugin, struct shader* s, u32 variant_index);
+b8 vulkan_renderer_shader_dispatch(renderer_plugin* plugin, struct shader* s, u32 group_count_x, u32 group_count_y, u32 group_count_z);
 
 b8 vulkan_renderer_texture_map_resources_acquire(renderer_plugin* backend, texture_map* map);
 void vulkan_renderer_texture_map_resources_release(renderer_plugin* backend, texture_map* map);
 b8 vulkan_renderer_texture_map_resources_refresh(renderer_plugin* plugin, texture_map* map);
+b8 vulkan_renderer_bindless_textures_supported(renderer_plugin* plugin);
+u32 vulkan_renderer_texture_map_bindless_index_get(renderer_plugin* plugin, const texture_map* map);
 
 b8 vulkan_renderpass_create(renderer_plugin* backend, const renderpass_config* config, renderpass* out_renderpass);
 void vulkan_renderpass_destroy(renderer_plugin* backend, renderpass* pass);
+b8 vulkan_renderpass_multiview_supported(renderer_plugin* backend, u8 view_count);
+b8 vulkan_renderer_weighted_blend_supported(renderer_plugin* backend);
+b8 vulkan_renderer_shading_rate_supported(renderer_plugin* backend);
+void vulkan_renderer_shading_rate_set(renderer_plugin* backend, renderer_shading_rate rate);
+b8 vulkan_renderer_occlusion_query_begin(renderer_plugin* backend, u32 query_index);
+void vulkan_renderer_occlusion_query_end(renderer_plugin* backend);
+b8 vulkan_renderer_occlusion_query_results_get(renderer_plugin* backend, u32 max_count, u8* out_visible, u32* out_count, u64* out_frame_number);
 
 b8 vulkan_renderer_render_target_create(renderer_plugin* backend, u8 attachment_count, render_target_attachment* attachments, renderpass* pass, u32 width, u32 height, u16 layer_index, render_target* out_target);
 void vulkan_renderer_render_target_destroy(renderer_plugin* backend, render_target* target, b8 free_internal_memory);
@@ -82,10 +109,21 @@ texture* vulkan_renderer_depth_attachment_get(renderer_plugin* backend, u8 index
 u8 vulkan_renderer_window_attachment_index_get(renderer_plugin* backend);
 u8 vulkan_renderer_window_attachment_count_get(renderer_plugin* backend);
 
+b8 vulkan_renderer_window_create(renderer_plugin* backend, renderer_window* window);
+void vulkan_renderer_window_destroy(renderer_plugin* backend, renderer_window* window);
+void vulkan_renderer_window_resized(renderer_plugin* backend, renderer_window* window);
+b8 vulkan_renderer_window_acquire(renderer_plugin* backend, renderer_window* window);
+texture* vulkan_renderer_window_colour_get(renderer_plugin* backend, renderer_window* window, u8 index);
+texture* vulkan_renderer_window_depth_get(renderer_plugin* backend, renderer_window* window, u8 index);
+u8 vulkan_renderer_window_image_index_get(renderer_plugin* backend, renderer_window* window);
+u8 vulkan_renderer_window_image_count_get(renderer_plugin* backend, renderer_window* window);
+
 b8 vulkan_renderer_is_multithreaded(renderer_plugin* backend);
 
 b8 vulkan_renderer_flag_enabled_get(renderer_plugin* backend, renderer_config_flags flag);
 void vulkan_renderer_flag_enabled_set(renderer_plugin* backend, renderer_config_flags flag, b8 enabled);
+void vulkan_renderer_swapchain_settings_get(renderer_plugin* backend, renderer_swapchain_settings* out_settings);
+void vulkan_renderer_swapchain_settings_set(renderer_plugin* backend, const renderer_swapchain_settings* settings);
 
 b8 vulkan_buffer_create_internal(renderer_plugin* backend, renderbuffer* buffer);
 void vulkan_buffer_destroy_internal(renderer_plugin* backend, renderbuffer* buffer);
@@ -98,4 +136,9 @@ b8 vulkan_buffer_flush(renderer_plugin* backend, renderbuffer* buffer, u64 offse
 b8 vulkan_buffer_read(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size, void** out_memory);
 b8 vulkan_buffer_load_range(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u64 size, const void* data);
 b8 vulkan_buffer_copy_range(renderer_plugin* backend, renderbuffer* source, u64 source_offset, renderbuffer* dest, u64 dest_offset, u64 size);
+void vulkan_renderer_upload_synchronous_set(renderer_plugin* backend, b8 synchronous);
+b8 vulkan_renderer_upload_wait(renderer_plugin* backend);
 b8 vulkan_buffer_draw(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only);
+b8 vulkan_buffer_draw_instanced(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 element_count, u32 instance_count);
+b8 vulkan_buffer_indirect_draw_supported(renderer_plugin* backend);
+b8 vulkan_buffer_draw_indirect(renderer_plugin* backend, renderbuffer* buffer, u64 offset, u32 draw_count);
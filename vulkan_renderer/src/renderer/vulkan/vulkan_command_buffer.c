@@ -60,6 +60,48 @@ void vulkan_command_buffer_begin(
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING;
 }
 
+void vulkan_command_buffer_begin_secondary(
+    vulkan_command_buffer* command_buffer,
+    VkRenderPass renderpass,
+    VkFramebuffer framebuffer) {
+
+    VkCommandBufferInheritanceInfo inheritance_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance_info.renderPass = renderpass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_CHECK(vkBeginCommandBuffer(command_buffer->handle, &begin_info));
+    command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
+}
+
+void vulkan_command_buffer_begin_secondary_rendering(
+    vulkan_command_buffer* command_buffer,
+    const vulkan_dynamic_rendering* rendering) {
+
+    VkCommandBufferInheritanceRenderingInfoKHR rendering_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR};
+    rendering_info.viewMask = rendering->info.viewMask;
+    rendering_info.colorAttachmentCount = rendering->info.colorAttachmentCount;
+    rendering_info.pColorAttachmentFormats = rendering->colour_formats;
+    rendering_info.depthAttachmentFormat = rendering->depth_format;
+    rendering_info.stencilAttachmentFormat = rendering->stencil_format;
+    rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // There is no renderpass or framebuffer to inherit.
+    VkCommandBufferInheritanceInfo inheritance_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance_info.pNext = &rendering_info;
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_CHECK(vkBeginCommandBuffer(command_buffer->handle, &begin_info));
+    command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
+}
+
 void vulkan_command_buffer_end(vulkan_command_buffer* command_buffer) {
     VK_CHECK(vkEndCommandBuffer(command_buffer->handle));
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING_ENDED;
@@ -53,6 +53,31 @@ void vulkan_command_buffer_begin(
     b8 is_renderpass_continue,
     b8 is_simultaneous_use);
 
+/**
+ * @brief Begins the provided secondary command buffer for recording within
+ * the given renderpass and framebuffer. The renderpass itself must be begun
+ * on the primary command buffer which executes this one.
+ *
+ * @param command_buffer A pointer to the secondary command buffer to begin.
+ * @param renderpass The renderpass the commands will be executed within.
+ * @param framebuffer The framebuffer the commands will be executed with.
+ */
+void vulkan_command_buffer_begin_secondary(
+    vulkan_command_buffer* command_buffer,
+    VkRenderPass renderpass,
+    VkFramebuffer framebuffer);
+
+/**
+ * @brief Begins the provided secondary command buffer for recording within
+ * dynamic rendering begun on the primary command buffer which executes this one.
+ *
+ * @param command_buffer A pointer to the secondary command buffer to begin.
+ * @param rendering A constant pointer to the dynamic rendering the commands will be executed within.
+ */
+void vulkan_command_buffer_begin_secondary_rendering(
+    vulkan_command_buffer* command_buffer,
+    const vulkan_dynamic_rendering* rendering);
+
 /**
  * @brief Ends the given command buffer.
  * 
@@ -0,0 +1,172 @@
+#include "vulkan_deferred_deletion.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "renderer/renderer_frontend.h"
+#include "vulkan_image.h"
+#include "vulkan_memory.h"
+
+static void deletion_push(vulkan_context* context, vulkan_deferred_deletion* deletion) {
+    if (!context->deferred_deletions) {
+        context->deferred_deletions = darray_create(vulkan_deferred_deletion);
+    }
+    // Anything released now may still be referenced by work submitted before the next frame
+    // completes, including the frame being recorded and any uploads flushed ahead of it.
+    deletion->frame_number = context->frame_number + 1;
+    darray_push(context->deferred_deletions, *deletion);
+}
+
+static void deletion_execute(vulkan_context* context, vulkan_deferred_deletion* deletion) {
+    VkDevice device = context->device.logical_device;
+    switch (deletion->type) {
+        case VULKAN_DEFERRED_DELETION_TYPE_IMAGE:
+            vulkan_image_destroy(context, &deletion->image);
+            break;
+        case VULKAN_DEFERRED_DELETION_TYPE_BUFFER:
+            vkDestroyBuffer(device, deletion->buffer.handle, context->allocator);
+            vulkan_memory_free(context, &deletion->buffer.memory);
+            break;
+        case VULKAN_DEFERRED_DELETION_TYPE_SAMPLER:
+            vkDestroySampler(device, deletion->sampler, context->allocator);
+            break;
+        case VULKAN_DEFERRED_DELETION_TYPE_DESCRIPTOR_SETS: {
+            VkResult result = vkFreeDescriptorSets(device, deletion->descriptor_sets.pool, 3, deletion->descriptor_sets.sets);
+            if (result != VK_SUCCESS) {
+                KERROR("Error freeing deferred descriptor sets!");
+            }
+        } break;
+        case VULKAN_DEFERRED_DELETION_TYPE_RENDERBUFFER_RANGE:
+            if (!renderer_renderbuffer_free(deletion->range.buffer, deletion->range.size, deletion->range.offset)) {
+                KERROR("Failed to free deferred renderbuffer range.");
+            }
+            break;
+        case VULKAN_DEFERRED_DELETION_TYPE_PIPELINE:
+            vkDestroyPipeline(device, deletion->pipeline.handle, context->allocator);
+            vkDestroyPipelineLayout(device, deletion->pipeline.layout, context->allocator);
+            break;
+        case VULKAN_DEFERRED_DELETION_TYPE_SWAPCHAIN:
+            for (u32 i = 0; i < deletion->swapchain.view_count; ++i) {
+                vkDestroyImageView(device, deletion->swapchain.views[i], context->allocator);
+            }
+            vkDestroySwapchainKHR(device, deletion->swapchain.handle, context->allocator);
+            break;
+    }
+}
+
+void vulkan_deferred_deletion_image(vulkan_context* context, vulkan_image* image) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_IMAGE;
+    deletion.image = *image;
+    deletion_push(context, &deletion);
+    kzero_memory(image, sizeof(vulkan_image));
+}
+
+void vulkan_deferred_deletion_buffer(vulkan_context* context, VkBuffer handle, vulkan_memory_allocation* memory) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_BUFFER;
+    deletion.buffer.handle = handle;
+    deletion.buffer.memory = *memory;
+    deletion_push(context, &deletion);
+    kzero_memory(memory, sizeof(vulkan_memory_allocation));
+}
+
+void vulkan_deferred_deletion_sampler(vulkan_context* context, VkSampler sampler) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_SAMPLER;
+    deletion.sampler = sampler;
+    deletion_push(context, &deletion);
+}
+
+void vulkan_deferred_deletion_descriptor_sets(vulkan_context* context, void* owner, VkDescriptorPool pool, VkDescriptorSet* sets) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_DESCRIPTOR_SETS;
+    deletion.owner = owner;
+    deletion.descriptor_sets.pool = pool;
+    kcopy_memory(deletion.descriptor_sets.sets, sets, sizeof(VkDescriptorSet) * 3);
+    deletion_push(context, &deletion);
+}
+
+void vulkan_deferred_deletion_renderbuffer_range(vulkan_context* context, void* owner, renderbuffer* buffer, u64 size, u64 offset) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_RENDERBUFFER_RANGE;
+    deletion.owner = owner;
+    deletion.range.buffer = buffer;
+    deletion.range.size = size;
+    deletion.range.offset = offset;
+    deletion_push(context, &deletion);
+}
+
+void vulkan_deferred_deletion_pipeline(vulkan_context* context, vulkan_pipeline* pipeline) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_PIPELINE;
+    deletion.pipeline.handle = pipeline->handle;
+    deletion.pipeline.layout = pipeline->pipeline_layout;
+    deletion_push(context, &deletion);
+    pipeline->handle = 0;
+    pipeline->pipeline_layout = 0;
+}
+
+void vulkan_deferred_deletion_swapchain(vulkan_context* context, VkSwapchainKHR handle, u32 view_count, const VkImageView* views) {
+    vulkan_deferred_deletion deletion = {0};
+    deletion.type = VULKAN_DEFERRED_DELETION_TYPE_SWAPCHAIN;
+    deletion.swapchain.handle = handle;
+    deletion.swapchain.view_count = KMIN(view_count, VULKAN_MAX_SWAPCHAIN_IMAGES);
+    kcopy_memory(deletion.swapchain.views, views, sizeof(VkImageView) * deletion.swapchain.view_count);
+    deletion_push(context, &deletion);
+    // Completed frames don't track presentation, so also give the images queued for presentation
+    // before the swapchain was retired a full set of frames in flight to come off the screen.
+    u32 last = darray_length(context->deferred_deletions) - 1;
+    context->deferred_deletions[last].frame_number += context->swapchain.max_frames_in_flight;
+}
+
+void vulkan_deferred_deletion_process(vulkan_context* context, u64 completed_frame_number) {
+    if (!context->deferred_deletions) {
+        return;
+    }
+
+    // Entries are in release order, so only a prefix can be ready.
+    u32 count = darray_length(context->deferred_deletions);
+    u32 ready_count = 0;
+    while (ready_count < count && context->deferred_deletions[ready_count].frame_number <= completed_frame_number) {
+        deletion_execute(context, &context->deferred_deletions[ready_count]);
+        ready_count++;
+    }
+
+    if (ready_count) {
+        // Shift the rest down. The ranges may overlap, so copy one at a time.
+        u32 remaining = count - ready_count;
+        for (u32 i = 0; i < remaining; ++i) {
+            context->deferred_deletions[i] = context->deferred_deletions[ready_count + i];
+        }
+        darray_length_set(context->deferred_deletions, remaining);
+    }
+}
+
+void vulkan_deferred_deletion_discard_owner(vulkan_context* context, void* owner) {
+    if (!context->deferred_deletions || !owner) {
+        return;
+    }
+
+    u32 count = darray_length(context->deferred_deletions);
+    u32 kept = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (context->deferred_deletions[i].owner != owner) {
+            context->deferred_deletions[kept++] = context->deferred_deletions[i];
+        }
+    }
+    darray_length_set(context->deferred_deletions, kept);
+}
+
+void vulkan_deferred_deletion_flush(vulkan_context* context) {
+    if (!context->deferred_deletions) {
+        return;
+    }
+
+    u32 count = darray_length(context->deferred_deletions);
+    for (u32 i = 0; i < count; ++i) {
+        deletion_execute(context, &context->deferred_deletions[i]);
+    }
+    darray_destroy(context->deferred_deletions);
+    context->deferred_deletions = 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file vulkan_deferred_deletion.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Defers the destruction of resources until the frames which may reference them
+ * have finished executing, so that releasing a resource never has to wait on the GPU.
+ * @version 1.0
+ * @date 2023-11-22
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Queues the given image for destruction. The image is copied and zeroed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the image to be destroyed.
+ */
+void vulkan_deferred_deletion_image(vulkan_context* context, vulkan_image* image);
+
+/**
+ * @brief Queues the given buffer and its memory for destruction.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param handle The buffer to be destroyed.
+ * @param memory A pointer to the memory of the buffer, to be freed. Is zeroed.
+ */
+void vulkan_deferred_deletion_buffer(vulkan_context* context, VkBuffer handle, vulkan_memory_allocation* memory);
+
+/**
+ * @brief Queues the given sampler for destruction.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param sampler The sampler to be destroyed.
+ */
+void vulkan_deferred_deletion_sampler(vulkan_context* context, VkSampler sampler);
+
+/**
+ * @brief Queues the given per-frame descriptor sets to be freed back to their pool.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param owner The owner of the pool, used to discard the entry if the pool is destroyed first.
+ * @param pool The pool the sets were allocated from.
+ * @param sets An array of 3 descriptor sets.
+ */
+void vulkan_deferred_deletion_descriptor_sets(vulkan_context* context, void* owner, VkDescriptorPool pool, VkDescriptorSet* sets);
+
+/**
+ * @brief Queues the given range of a renderbuffer to be freed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param owner The owner of the renderbuffer, used to discard the entry if the renderbuffer is destroyed first.
+ * @param buffer A pointer to the renderbuffer.
+ * @param size The size of the range.
+ * @param offset The offset of the range.
+ */
+void vulkan_deferred_deletion_renderbuffer_range(vulkan_context* context, void* owner, renderbuffer* buffer, u64 size, u64 offset);
+
+/**
+ * @brief Queues the given pipeline and its layout for destruction. The pipeline's handles are zeroed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param pipeline A pointer to the pipeline to be destroyed.
+ */
+void vulkan_deferred_deletion_pipeline(vulkan_context* context, vulkan_pipeline* pipeline);
+
+/**
+ * @brief Queues a retired swapchain and the views of its images for destruction. Kept for longer
+ * than other resources, as its images may still be queued for presentation.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param handle The swapchain to be destroyed.
+ * @param view_count The number of image views.
+ * @param views An array of view_count image views to be destroyed.
+ */
+void vulkan_deferred_deletion_swapchain(vulkan_context* context, VkSwapchainKHR handle, u32 view_count, const VkImageView* views);
+
+/**
+ * @brief Destroys all queued resources released in or before the given frame.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param completed_frame_number The number of the most recent frame known to have finished executing.
+ */
+void vulkan_deferred_deletion_process(vulkan_context* context, u64 completed_frame_number);
+
+/**
+ * @brief Drops queued entries belonging to the given owner without processing them, since
+ * the owner is about to destroy the pool or buffer they refer to.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param owner The owner being destroyed.
+ */
+void vulkan_deferred_deletion_discard_owner(vulkan_context* context, void* owner);
+
+/**
+ * @brief Destroys all queued resources. The device must be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_deferred_deletion_flush(vulkan_context* context);
@@ -0,0 +1,150 @@
+#include "vulkan_descriptor_allocator.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "vulkan_utils.h"
+
+// Creates a pool the given multiple of the first pool's size and adds it to the chain.
+static b8 pool_add(vulkan_context* context, vulkan_descriptor_allocator* allocator, u32 growth) {
+    VkDescriptorPoolSize sizes[VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES];
+    for (u32 i = 0; i < allocator->pool_size_count; ++i) {
+        sizes[i].type = allocator->pool_sizes[i].type;
+        sizes[i].descriptorCount = allocator->pool_sizes[i].descriptorCount * growth;
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.poolSizeCount = allocator->pool_size_count;
+    pool_info.pPoolSizes = sizes;
+    pool_info.maxSets = allocator->set_count * growth;
+    pool_info.flags = allocator->flags;
+
+    VkDescriptorPool pool;
+    VkResult result = vkCreateDescriptorPool(context->device.logical_device, &pool_info, context->allocator, &pool);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to create descriptor pool of %u sets: '%s'", pool_info.maxSets, vulkan_result_string(result, true));
+        return false;
+    }
+    darray_push(allocator->pools, pool);
+    return true;
+}
+
+b8 vulkan_descriptor_allocator_create(vulkan_context* context, u32 pool_size_count, const VkDescriptorPoolSize* pool_sizes, u32 set_count, VkDescriptorPoolCreateFlags flags, vulkan_descriptor_allocator* out_allocator) {
+    if (!out_allocator || pool_size_count > VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES || set_count == 0) {
+        KERROR("vulkan_descriptor_allocator_create requires a valid pointer, at most %u pool sizes and a nonzero set count.", VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES);
+        return false;
+    }
+
+    kzero_memory(out_allocator, sizeof(vulkan_descriptor_allocator));
+    out_allocator->pool_size_count = pool_size_count;
+    kcopy_memory(out_allocator->pool_sizes, pool_sizes, sizeof(VkDescriptorPoolSize) * pool_size_count);
+    out_allocator->set_count = set_count;
+    out_allocator->flags = flags;
+    out_allocator->next_growth = 2;
+    out_allocator->pools = darray_create(VkDescriptorPool);
+
+    if (!pool_add(context, out_allocator, 1)) {
+        vulkan_descriptor_allocator_destroy(context, out_allocator);
+        return false;
+    }
+    return true;
+}
+
+void vulkan_descriptor_allocator_destroy(vulkan_context* context, vulkan_descriptor_allocator* allocator) {
+    if (allocator && allocator->pools) {
+        u32 pool_count = darray_length(allocator->pools);
+        for (u32 i = 0; i < pool_count; ++i) {
+            vkDestroyDescriptorPool(context->device.logical_device, allocator->pools[i], context->allocator);
+        }
+        darray_destroy(allocator->pools);
+        kzero_memory(allocator, sizeof(vulkan_descriptor_allocator));
+    }
+}
+
+// Attempts an allocation from a single pool. Fails quietly if the pool is full.
+static VkResult pool_allocate(vulkan_context* context, VkDescriptorPool pool, VkDescriptorSetAllocateInfo* alloc_info, VkDescriptorSet* out_sets) {
+    alloc_info->descriptorPool = pool;
+    VkResult result = vkAllocateDescriptorSets(context->device.logical_device, alloc_info, out_sets);
+    if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+        KERROR("Failed to allocate descriptor sets: '%s'", vulkan_result_string(result, true));
+    }
+    return result;
+}
+
+b8 vulkan_descriptor_allocator_allocate(vulkan_context* context, vulkan_descriptor_allocator* allocator, u32 count, const VkDescriptorSetLayout* layouts, VkDescriptorSet* out_sets, VkDescriptorPool* out_pool) {
+    VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.descriptorSetCount = count;
+    alloc_info.pSetLayouts = layouts;
+
+    // Start with the pool allocated from last, then try the others, since sets freed back to them
+    // leave room behind.
+    u32 pool_count = darray_length(allocator->pools);
+    for (u32 attempt = 0; attempt < pool_count; ++attempt) {
+        u32 index = (allocator->current_pool + attempt) % pool_count;
+        VkResult result = pool_allocate(context, allocator->pools[index], &alloc_info, out_sets);
+        if (result == VK_SUCCESS) {
+            allocator->current_pool = index;
+            if (out_pool) {
+                *out_pool = alloc_info.descriptorPool;
+            }
+            return true;
+        } else if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            return false;
+        }
+    }
+
+    // Everything is full, so grow.
+    u32 growth = allocator->next_growth;
+    if (!pool_add(context, allocator, growth)) {
+        return false;
+    }
+    allocator->next_growth = KMIN(growth * 2, VULKAN_DESCRIPTOR_ALLOCATOR_MAX_GROWTH);
+    allocator->current_pool = pool_count;
+    KDEBUG("Descriptor allocator grown to %u pools, the newest holding %u sets.", pool_count + 1, allocator->set_count * growth);
+
+    if (pool_allocate(context, allocator->pools[pool_count], &alloc_info, out_sets) != VK_SUCCESS) {
+        KERROR("Failed to allocate %u descriptor sets from a new pool. The pool may be too small for them.", count);
+        return false;
+    }
+    if (out_pool) {
+        *out_pool = alloc_info.descriptorPool;
+    }
+    return true;
+}
+
+void vulkan_descriptor_allocator_reset(vulkan_context* context, vulkan_descriptor_allocator* allocator) {
+    if (allocator && allocator->pools) {
+        u32 pool_count = darray_length(allocator->pools);
+        for (u32 i = 0; i < pool_count; ++i) {
+            VK_CHECK(vkResetDescriptorPool(context->device.logical_device, allocator->pools[i], 0));
+        }
+        allocator->current_pool = 0;
+    }
+}
+
+b8 vulkan_transient_descriptors_create(vulkan_context* context) {
+    // Sized for a set of the kind shaders use: a UBO and a few samplers, with room for storage bindings.
+    VkDescriptorPoolSize pool_sizes[VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT * 4},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT}};
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        // Never freed individually, only reset as a whole.
+        if (!vulkan_descriptor_allocator_create(context, VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES, pool_sizes, VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT, 0, &context->transient_descriptors[i])) {
+            KERROR("Failed to create transient descriptor allocator.");
+            return false;
+        }
+    }
+    return true;
+}
+
+void vulkan_transient_descriptors_destroy(vulkan_context* context) {
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        vulkan_descriptor_allocator_destroy(context, &context->transient_descriptors[i]);
+    }
+}
+
+b8 vulkan_transient_descriptor_allocate(vulkan_context* context, VkDescriptorSetLayout layout, VkDescriptorSet* out_set) {
+    return vulkan_descriptor_allocator_allocate(context, &context->transient_descriptors[context->current_frame], 1, &layout, out_set, 0);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file vulkan_descriptor_allocator.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Allocates descriptor sets from a growable chain of pools, so that pools can start small
+ * and grow with demand instead of being sized for the worst case up front. Used both for sets
+ * which live as long as their owner and, reset each frame, for sets needed only for a single frame.
+ * @version 1.0
+ * @date 2023-12-05
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates a descriptor allocator along with its first pool.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param pool_size_count The number of descriptor types, up to VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES.
+ * @param pool_sizes An array of pool_size_count descriptor counts the first pool holds. Later pools hold multiples of these.
+ * @param set_count The number of sets the first pool holds.
+ * @param flags The flags pools are created with.
+ * @param out_allocator A pointer to hold the allocator.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_descriptor_allocator_create(vulkan_context* context, u32 pool_size_count, const VkDescriptorPoolSize* pool_sizes, u32 set_count, VkDescriptorPoolCreateFlags flags, vulkan_descriptor_allocator* out_allocator);
+
+/**
+ * @brief Destroys the given allocator and its pools, and with them every set allocated from it.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocator A pointer to the allocator to be destroyed.
+ */
+void vulkan_descriptor_allocator_destroy(vulkan_context* context, vulkan_descriptor_allocator* allocator);
+
+/**
+ * @brief Allocates descriptor sets, adding a pool if the existing ones are full. All of the sets
+ * come from the same pool.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocator A pointer to the allocator.
+ * @param count The number of sets to allocate.
+ * @param layouts An array of count layouts, one per set.
+ * @param out_sets An array of count sets to hold the allocated sets.
+ * @param out_pool A pointer to hold the pool the sets came from, needed to free them individually. Optional.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_descriptor_allocator_allocate(vulkan_context* context, vulkan_descriptor_allocator* allocator, u32 count, const VkDescriptorSetLayout* layouts, VkDescriptorSet* out_sets, VkDescriptorPool* out_pool);
+
+/**
+ * @brief Frees every set allocated from the given allocator at once, keeping its pools for reuse.
+ * None of the sets may still be in use by the GPU.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocator A pointer to the allocator.
+ */
+void vulkan_descriptor_allocator_reset(vulkan_context* context, vulkan_descriptor_allocator* allocator);
+
+/**
+ * @brief Creates the transient descriptor allocators, one per frame in flight.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_transient_descriptors_create(vulkan_context* context);
+
+/**
+ * @brief Destroys the transient descriptor allocators. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_transient_descriptors_destroy(vulkan_context* context);
+
+/**
+ * @brief Allocates a descriptor set which is only valid for the frame currently being recorded.
+ * It is freed automatically once the frame completes, and may not be freed otherwise. Must be
+ * called from the thread preparing the frame.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param layout The layout of the set.
+ * @param out_set A pointer to hold the allocated set.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_transient_descriptor_allocate(vulkan_context* context, VkDescriptorSetLayout layout, VkDescriptorSet* out_set);
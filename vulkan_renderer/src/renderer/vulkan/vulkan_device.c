@@ -64,39 +64,49 @@ b8 vulkan_device_create(vulkan_context* context) {
     }
 
     VkDeviceQueueCreateInfo queue_create_infos[32];
-    f32 queue_priorities[2] = {0.9f, 1.0f};
+    f32 queue_priorities[3] = {0.9f, 1.0f, 0.8f};
 
     VkQueueFamilyProperties props[32];
     u32 prop_count;
     vkGetPhysicalDeviceQueueFamilyProperties(context->device.physical_device, &prop_count, 0);
     vkGetPhysicalDeviceQueueFamilyProperties(context->device.physical_device, &prop_count, props);
 
+    // The queues taken from the graphics family: the graphics queue, then a unique present queue if
+    // presentation shares the family, then the async compute queue, as far as the family has queues.
+    u32 graphics_family_available = props[context->device.graphics_queue_index].queueCount;
+    u32 graphics_family_queue_count = 1;
+    if (present_shares_graphics_queue) {
+        if (graphics_family_available > graphics_family_queue_count) {
+            // If the same family is shared between graphic and presentation,
+            // pull from the second index instead of the first for a unique queue.
+            graphics_family_queue_count++;
+        } else {
+            // Don't have available queues, just share them.
+            present_must_share_graphics = true;
+        }
+    }
+    // Async compute uses another queue of the graphics family, which is always compute-capable. Queue
+    // family ownership belongs to the family rather than the queue, so resources are shared between the
+    // queues without ownership transfers. Devices without a spare queue record compute work inline.
+    i32 async_compute_queue_slot = -1;
+    if (graphics_family_available > graphics_family_queue_count) {
+        async_compute_queue_slot = (i32)graphics_family_queue_count;
+        graphics_family_queue_count++;
+    }
+
     for (u32 i = 0; i < index_count; ++i) {
         queue_create_infos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queue_create_infos[i].queueFamilyIndex = indices[i];
-        queue_create_infos[i].queueCount = 1;
-
-        if (present_shares_graphics_queue && indices[i] == context->device.present_queue_index) {
-            if (props[context->device.present_queue_index].queueCount > 1) {
-                // If the same family is shared between graphic and presentation,
-                // pull from the second index instead of the first for a unique queue.
-                queue_create_infos[i].queueCount = 2;
-            } else {
-                // Don't have available queues, just share them.
-                present_must_share_graphics = true;
-            }
-        }
-
-        // TODO: Enable this for a future enhancement.
-        // if (indices[i] == context->device.graphics_queue_index) {
-        //     queue_create_infos[i].queueCount = 2;
-        // }
+        queue_create_infos[i].queueCount = indices[i] == context->device.graphics_queue_index ? graphics_family_queue_count : 1;
         queue_create_infos[i].flags = 0;
         queue_create_infos[i].pNext = 0;
         queue_create_infos[i].pQueuePriorities = queue_priorities;
     }
 
     b8 portability_required = false;
+    b8 dynamic_rendering_extension_available = false;
+    b8 memory_budget_extension_available = false;
+    b8 fragment_shading_rate_extension_available = false;
     u32 available_extension_count = 0;
     VkExtensionProperties* available_extensions = 0;
     VK_CHECK(vkEnumerateDeviceExtensionProperties(context->device.physical_device, 0, &available_extension_count, 0));
@@ -107,14 +117,19 @@ b8 vulkan_device_create(vulkan_context* context) {
             if (strings_equal(available_extensions[i].extensionName, "VK_KHR_portability_subset")) {
                 KINFO("Adding required extension 'VK_KHR_portability_subset'.");
                 portability_required = true;
-                break;
+            } else if (strings_equal(available_extensions[i].extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+                dynamic_rendering_extension_available = true;
+            } else if (strings_equal(available_extensions[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+                memory_budget_extension_available = true;
+            } else if (strings_equal(available_extensions[i].extensionName, VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME)) {
+                fragment_shading_rate_extension_available = true;
             }
         }
     }
     kfree(available_extensions, sizeof(VkExtensionProperties) * available_extension_count, MEMORY_TAG_RENDERER);
 
     // Setup an array large enough to hold all, even if we don't use them all.
-    const char* extension_names[5];
+    const char* extension_names[8];
     u32 ext_idx = 0;
     extension_names[ext_idx] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
     ext_idx++;
@@ -143,16 +158,65 @@ b8 vulkan_device_create(vulkan_context* context) {
         ext_idx++;
     }
 
+    // Dynamic rendering is core as of Vulkan 1.3. Before that it needs the extension, whose own
+    // dependencies are core as of 1.2.
+    b8 dynamic_rendering_is_core = context->device.api_major > 1 || context->device.api_minor >= 3;
+    if ((context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT) && !dynamic_rendering_is_core) {
+        if (dynamic_rendering_extension_available && context->device.api_minor >= 2) {
+            extension_names[ext_idx] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+            ext_idx++;
+        } else {
+            context->device.support_flags &= ~VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT;
+        }
+    }
+
+    // Heap budgets, if the driver reports them. Otherwise they are estimated.
+    if (memory_budget_extension_available) {
+        extension_names[ext_idx] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        ext_idx++;
+        context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_MEMORY_BUDGET_BIT;
+        KINFO("Vulkan device reports memory heap budgets.");
+    } else {
+        KINFO("Vulkan device does not report memory heap budgets. They will be estimated from heap sizes.");
+    }
+
+    // Per-draw fragment shading rates, if supported. The extension depends on renderpass2, which is core as of 1.2.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) {
+        if (fragment_shading_rate_extension_available && (context->device.api_major > 1 || context->device.api_minor >= 2)) {
+            extension_names[ext_idx] = VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME;
+            ext_idx++;
+        } else {
+            context->device.support_flags &= ~VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT;
+        }
+    }
+
     // Request device features.
     // TODO: should be config driven
     VkPhysicalDeviceFeatures device_features = {};
     device_features.samplerAnisotropy = VK_TRUE;  // Request anistrophy
     device_features.fillModeNonSolid = VK_TRUE;   // TODO: Check if supported?
+    // Indirect draw features, if supported.
+    device_features.drawIndirectFirstInstance = (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DRAW_INDIRECT_FIRST_INSTANCE_BIT) ? VK_TRUE : VK_FALSE;
+    device_features.multiDrawIndirect = (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_MULTI_DRAW_INDIRECT_BIT) ? VK_TRUE : VK_FALSE;
+    // Pipeline statistics for GPU profiling, if supported.
+    device_features.pipelineStatisticsQuery = context->device.features.pipelineStatisticsQuery;
+    // Block-compressed texture formats, if supported.
+    device_features.textureCompressionBC = context->device.features.textureCompressionBC;
+    device_features.textureCompressionETC2 = context->device.features.textureCompressionETC2;
+    device_features.textureCompressionASTC_LDR = context->device.features.textureCompressionASTC_LDR;
+    // Independent blend states per colour attachment, for weighted blended transparency, if supported.
+    device_features.independentBlend = context->device.features.independentBlend;
 
     // VK_EXT_descriptor_indexing
     VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT};
     // Partial binding is required for descriptor aliasing.
     descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;  // TODO: Check if supported?
+    // Bindless textures, if supported.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_BINDLESS_TEXTURES_BIT) {
+        descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+        descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
 
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
     // NOTE: On macOS set environment variable to configure MoltenVK for using Metal argument buffers (needed for descriptor indexing).
@@ -185,6 +249,38 @@ b8 vulkan_device_create(vulkan_context* context) {
     device_create_info.ppEnabledLayerNames = 0;
     device_create_info.pNext = &descriptor_indexing_features;
 
+    // Timeline semaphores, if supported.
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_TIMELINE_SEMAPHORE_BIT) {
+        timeline_semaphore_features.timelineSemaphore = VK_TRUE;
+        timeline_semaphore_features.pNext = &descriptor_indexing_features;
+        device_create_info.pNext = &timeline_semaphore_features;
+    }
+
+    // Multiview, if supported.
+    VkPhysicalDeviceMultiviewFeatures multiview_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES};
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_MULTIVIEW_BIT) {
+        multiview_features.multiview = VK_TRUE;
+        multiview_features.pNext = (void*)device_create_info.pNext;
+        device_create_info.pNext = &multiview_features;
+    }
+
+    // Dynamic rendering, if supported.
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR};
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT) {
+        dynamic_rendering_features.dynamicRendering = VK_TRUE;
+        dynamic_rendering_features.pNext = (void*)device_create_info.pNext;
+        device_create_info.pNext = &dynamic_rendering_features;
+    }
+
+    // Per-draw fragment shading rates, if supported.
+    VkPhysicalDeviceFragmentShadingRateFeaturesKHR fragment_shading_rate_features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR};
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) {
+        fragment_shading_rate_features.pipelineFragmentShadingRate = VK_TRUE;
+        fragment_shading_rate_features.pNext = (void*)device_create_info.pNext;
+        device_create_info.pNext = &fragment_shading_rate_features;
+    }
+
     // Create the device.
     VK_CHECK(vkCreateDevice(
         context->device.physical_device,
@@ -212,6 +308,7 @@ b8 vulkan_device_create(vulkan_context* context) {
         context->vkCmdSetStencilOpEXT = (PFN_vkCmdSetStencilOpEXT)vkGetInstanceProcAddr(context->instance, "vkCmdSetStencilOpEXT");
         context->vkCmdSetStencilTestEnableEXT = (PFN_vkCmdSetStencilTestEnableEXT)vkGetInstanceProcAddr(context->instance, "vkCmdSetStencilTestEnableEXT");
         context->vkCmdSetDepthTestEnableEXT = (PFN_vkCmdSetDepthTestEnableEXT)vkGetInstanceProcAddr(context->instance, "vkCmdSetDepthTestEnableEXT");
+        context->vkCmdSetDepthCompareOpEXT = (PFN_vkCmdSetDepthCompareOpEXT)vkGetInstanceProcAddr(context->instance, "vkCmdSetDepthCompareOpEXT");
     } else {
         if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_NATIVE_DYNAMIC_STATE_BIT) {
             KINFO("Vulkan device supports native dynamic state.");
@@ -220,6 +317,33 @@ b8 vulkan_device_create(vulkan_context* context) {
         }
     }
 
+    // Dynamic rendering entry points, which are named by the extension unless it is core.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT) {
+        const char* begin_name = dynamic_rendering_is_core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR";
+        const char* end_name = dynamic_rendering_is_core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR";
+        context->vkCmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(context->device.logical_device, begin_name);
+        context->vkCmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(context->device.logical_device, end_name);
+        if (context->vkCmdBeginRendering && context->vkCmdEndRendering) {
+            KINFO("Vulkan device supports dynamic rendering. Renderpass and framebuffer objects will not be used.");
+        } else {
+            KWARN("Unable to load dynamic rendering functions. Falling back to renderpass objects.");
+            context->device.support_flags &= ~VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT;
+            context->vkCmdBeginRendering = 0;
+            context->vkCmdEndRendering = 0;
+        }
+    }
+
+    // Fragment shading rate entry point.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) {
+        context->vkCmdSetFragmentShadingRateKHR = (PFN_vkCmdSetFragmentShadingRateKHR)vkGetDeviceProcAddr(context->device.logical_device, "vkCmdSetFragmentShadingRateKHR");
+        if (context->vkCmdSetFragmentShadingRateKHR) {
+            KINFO("Vulkan device supports variable rate shading, up to %ux%u.", context->device.max_fragment_shading_rate_size, context->device.max_fragment_shading_rate_size);
+        } else {
+            KWARN("Unable to load fragment shading rate function. Variable rate shading will not be used.");
+            context->device.support_flags &= ~VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT;
+        }
+    }
+
     // Get queues.
     vkGetDeviceQueue(
         context->device.logical_device,
@@ -241,6 +365,18 @@ b8 vulkan_device_create(vulkan_context* context) {
         context->device.transfer_queue_index,
         0,
         &context->device.transfer_queue);
+
+    context->device.compute_queue = 0;
+    if (async_compute_queue_slot >= 0) {
+        vkGetDeviceQueue(
+            context->device.logical_device,
+            context->device.graphics_queue_index,
+            (u32)async_compute_queue_slot,
+            &context->device.compute_queue);
+        KINFO("Async compute queue obtained from the graphics queue family.");
+    } else {
+        KINFO("No spare queue in the graphics queue family. Compute work will be recorded inline.");
+    }
     KINFO("Queues obtained.");
 
     // Create command pool for graphics queue.
@@ -262,6 +398,7 @@ void vulkan_device_destroy(vulkan_context* context) {
     context->device.graphics_queue = 0;
     context->device.present_queue = 0;
     context->device.transfer_queue = 0;
+    context->device.compute_queue = 0;
 
     KINFO("Destroying command pools...");
     vkDestroyCommandPool(
@@ -398,8 +535,7 @@ static b8 select_physical_device(vulkan_context* context) {
     requirements.graphics = true;
     requirements.present = true;
     requirements.transfer = true;
-    // NOTE: Enable this if compute will be required.
-    // requirements.compute = true;
+    requirements.compute = true;
     requirements.sampler_anisotropy = true;
 #if KPLATFORM_APPLE
     requirements.discrete_gpu = false;
@@ -416,6 +552,15 @@ static b8 select_physical_device(vulkan_context* context) {
         VkPhysicalDeviceProperties2 properties2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
         VkPhysicalDeviceDriverProperties driverProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES};
         properties2.pNext = &driverProperties;
+        // Descriptor indexing limits, used to determine bindless texture support.
+        VkPhysicalDeviceDescriptorIndexingProperties descriptor_indexing_properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+        driverProperties.pNext = &descriptor_indexing_properties;
+        // Multiview limits, used to determine how many layers may be rendered at once.
+        VkPhysicalDeviceMultiviewProperties multiview_properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES};
+        descriptor_indexing_properties.pNext = &multiview_properties;
+        // Fragment shading rate limits, used to determine the coarsest rate which may be used.
+        VkPhysicalDeviceFragmentShadingRatePropertiesKHR fragment_shading_rate_properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR};
+        multiview_properties.pNext = &fragment_shading_rate_properties;
         vkGetPhysicalDeviceProperties2(physical_devices[i], &properties2);
         VkPhysicalDeviceProperties properties = properties2.properties;
 
@@ -429,6 +574,21 @@ static b8 select_physical_device(vulkan_context* context) {
         // Check for smooth line rasterisation support via extension.
         VkPhysicalDeviceLineRasterizationFeaturesEXT smooth_line_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_LINE_RASTERIZATION_FEATURES_EXT};
         dynamic_state_next.pNext = &smooth_line_next;
+        // Check for the descriptor indexing features needed for bindless textures.
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+        smooth_line_next.pNext = &descriptor_indexing_next;
+        // Check for timeline semaphore support.
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+        descriptor_indexing_next.pNext = &timeline_semaphore_next;
+        // Check for multiview support, used to render to several layers at once.
+        VkPhysicalDeviceMultiviewFeatures multiview_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES};
+        timeline_semaphore_next.pNext = &multiview_next;
+        // Check for dynamic rendering support, either core or via extension.
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR};
+        multiview_next.pNext = &dynamic_rendering_next;
+        // Check for per-draw fragment shading rate support via extension.
+        VkPhysicalDeviceFragmentShadingRateFeaturesKHR fragment_shading_rate_next = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR};
+        dynamic_rendering_next.pNext = &fragment_shading_rate_next;
         // Perform the query.
         vkGetPhysicalDeviceFeatures2(physical_devices[i], &features2);
 
@@ -509,7 +669,7 @@ static b8 select_physical_device(vulkan_context* context) {
             context->device.graphics_queue_index = queue_info.graphics_family_index;
             context->device.present_queue_index = queue_info.present_family_index;
             context->device.transfer_queue_index = queue_info.transfer_family_index;
-            // NOTE: set compute index here if needed.
+            context->device.compute_queue_index = queue_info.compute_family_index;
 
             // Keep a copy of properties, features and memory info for later use.
             context->device.properties = properties;
@@ -529,6 +689,41 @@ static b8 select_physical_device(vulkan_context* context) {
             if (smooth_line_next.smoothLines) {
                 context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_LINE_SMOOTH_RASTERISATION_BIT;
             }
+            // Check for indirect draw support.
+            if (features.drawIndirectFirstInstance) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_DRAW_INDIRECT_FIRST_INSTANCE_BIT;
+            }
+            if (features.multiDrawIndirect) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_MULTI_DRAW_INDIRECT_BIT;
+            }
+            // Check for bindless texture support.
+            if (descriptor_indexing_next.runtimeDescriptorArray &&
+                descriptor_indexing_next.descriptorBindingPartiallyBound &&
+                descriptor_indexing_next.shaderSampledImageArrayNonUniformIndexing &&
+                descriptor_indexing_next.descriptorBindingSampledImageUpdateAfterBind &&
+                descriptor_indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers >= VULKAN_MAX_BINDLESS_TEXTURES + VULKAN_SHADER_MAX_GLOBAL_TEXTURES + VULKAN_SHADER_MAX_INSTANCE_TEXTURES &&
+                descriptor_indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages >= VULKAN_MAX_BINDLESS_TEXTURES + VULKAN_SHADER_MAX_GLOBAL_TEXTURES + VULKAN_SHADER_MAX_INSTANCE_TEXTURES) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_BINDLESS_TEXTURES_BIT;
+            }
+            // Timeline semaphores are core as of Vulkan 1.2.
+            if ((context->device.api_major > 1 || context->device.api_minor >= 2) && timeline_semaphore_next.timelineSemaphore) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_TIMELINE_SEMAPHORE_BIT;
+            }
+            // Multiview is core as of Vulkan 1.1.
+            if ((context->device.api_major > 1 || context->device.api_minor >= 1) && multiview_next.multiview) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_MULTIVIEW_BIT;
+                context->device.max_multiview_view_count = multiview_properties.maxMultiviewViewCount;
+            }
+            // Dynamic rendering. Whether the extension is also needed is worked out when the logical device is created.
+            if (dynamic_rendering_next.dynamicRendering) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT;
+            }
+            // Per-draw fragment shading rates. Whether the extension is available is worked out when the logical device is created.
+            context->device.max_fragment_shading_rate_size = 1;
+            if (fragment_shading_rate_next.pipelineFragmentShadingRate) {
+                context->device.support_flags |= VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT;
+                context->device.max_fragment_shading_rate_size = KMIN(fragment_shading_rate_properties.maxFragmentSize.width, fragment_shading_rate_properties.maxFragmentSize.height);
+            }
             break;
         }
     }
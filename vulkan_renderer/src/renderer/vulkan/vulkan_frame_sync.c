@@ -0,0 +1,351 @@
+#include "vulkan_frame_sync.h"
+
+#include "core/logger.h"
+#include "core/metrics.h"
+#include "platform/platform.h"
+#include "vulkan_utils.h"
+
+// Returns the number of the latest frame known to have completed, without waiting.
+static u64 completed_frame_get(vulkan_context* context) {
+    if (context->frame_timeline) {
+        u64 value = 0;
+        VkResult result = vkGetSemaphoreCounterValue(context->device.logical_device, context->frame_timeline, &value);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("vkGetSemaphoreCounterValue failed: '%s'", vulkan_result_string(result, true));
+            return context->completed_frame_number;
+        }
+        return KMAX(value, context->completed_frame_number);
+    }
+
+    // Frames complete in order, so walk forward from the last known until one isn't done yet.
+    u64 completed = context->completed_frame_number;
+    while (completed < context->submitted_frame_number) {
+        u64 next = completed + 1;
+        for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+            if (context->in_flight_frame_numbers[i] == next && context->in_flight_submitted[i]) {
+                if (vkGetFenceStatus(context->device.logical_device, context->in_flight_fences[i]) != VK_SUCCESS) {
+                    return completed;
+                }
+                break;
+            }
+        }
+        // Frames which were prepared but never submitted have nothing to wait on.
+        completed = next;
+    }
+    return completed;
+}
+
+// Records the latency of each frame which completed since the last update.
+static void completed_frame_update(vulkan_context* context, u64 completed) {
+    if (completed <= context->completed_frame_number) {
+        return;
+    }
+
+    f64 now = platform_get_absolute_time();
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        u64 number = context->in_flight_frame_numbers[i];
+        if (context->in_flight_submitted[i] && number > context->completed_frame_number && number <= completed) {
+            metrics_frame_latency_set(now - context->in_flight_start_times[i], (u32)(context->submitted_frame_number - number));
+        }
+    }
+    context->completed_frame_number = completed;
+}
+
+b8 vulkan_frame_sync_create(vulkan_context* context) {
+    VkDevice device = context->device.logical_device;
+    b8 use_timeline = (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_TIMELINE_SEMAPHORE_BIT) != 0;
+
+    // Objects are created for the maximum number of frames in flight, since the configured
+    // number may change along with the swapchain.
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkSemaphoreCreateInfo semaphore_create_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VK_CHECK(vkCreateSemaphore(device, &semaphore_create_info, context->allocator, &context->image_available_semaphores[i]));
+        VK_CHECK(vkCreateSemaphore(device, &semaphore_create_info, context->allocator, &context->queue_complete_semaphores[i]));
+        if (context->device.compute_queue) {
+            VK_CHECK(vkCreateSemaphore(device, &semaphore_create_info, context->allocator, &context->async_compute_ready_semaphores[i]));
+            VK_CHECK(vkCreateSemaphore(device, &semaphore_create_info, context->allocator, &context->async_compute_complete_semaphores[i]));
+        }
+
+        if (!use_timeline) {
+            // Create the fence in a signaled state, indicating that the first frame has
+            // already been "rendered". This will prevent the application from waiting
+            // indefinitely for the first frame to render since it cannot be rendered
+            // until a frame is "rendered" before it.
+            VkFenceCreateInfo fence_create_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            VK_CHECK(vkCreateFence(device, &fence_create_info, context->allocator, &context->in_flight_fences[i]));
+        }
+    }
+
+    if (use_timeline) {
+        VkSemaphoreTypeCreateInfo type_create_info = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+        type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_create_info.initialValue = 0;
+        VkSemaphoreCreateInfo semaphore_create_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        semaphore_create_info.pNext = &type_create_info;
+        VkResult result = vkCreateSemaphore(device, &semaphore_create_info, context->allocator, &context->frame_timeline);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to create frame timeline semaphore: '%s'", vulkan_result_string(result, true));
+            return false;
+        }
+        VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_SEMAPHORE, context->frame_timeline, "frame_timeline");
+        KINFO("Using a timeline semaphore for frame synchronization.");
+    }
+
+    return true;
+}
+
+void vulkan_frame_sync_destroy(vulkan_context* context) {
+    VkDevice device = context->device.logical_device;
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (context->image_available_semaphores[i]) {
+            vkDestroySemaphore(device, context->image_available_semaphores[i], context->allocator);
+            context->image_available_semaphores[i] = 0;
+        }
+        if (context->queue_complete_semaphores[i]) {
+            vkDestroySemaphore(device, context->queue_complete_semaphores[i], context->allocator);
+            context->queue_complete_semaphores[i] = 0;
+        }
+        if (context->async_compute_ready_semaphores[i]) {
+            vkDestroySemaphore(device, context->async_compute_ready_semaphores[i], context->allocator);
+            context->async_compute_ready_semaphores[i] = 0;
+        }
+        if (context->async_compute_complete_semaphores[i]) {
+            vkDestroySemaphore(device, context->async_compute_complete_semaphores[i], context->allocator);
+            context->async_compute_complete_semaphores[i] = 0;
+        }
+        if (context->in_flight_fences[i]) {
+            vkDestroyFence(device, context->in_flight_fences[i], context->allocator);
+            context->in_flight_fences[i] = 0;
+        }
+    }
+    if (context->frame_timeline) {
+        vkDestroySemaphore(device, context->frame_timeline, context->allocator);
+        context->frame_timeline = 0;
+    }
+}
+
+b8 vulkan_frame_sync_wait(vulkan_context* context, u32 frame_index) {
+    u64 number = context->in_flight_frame_numbers[frame_index];
+    if (context->in_flight_submitted[frame_index] && number > context->completed_frame_number) {
+        VkResult result;
+        if (context->frame_timeline) {
+            VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &context->frame_timeline;
+            wait_info.pValues = &number;
+            result = vkWaitSemaphores(context->device.logical_device, &wait_info, UINT64_MAX);
+        } else {
+            result = vkWaitForFences(context->device.logical_device, 1, &context->in_flight_fences[frame_index], true, UINT64_MAX);
+        }
+        if (!vulkan_result_is_success(result)) {
+            KFATAL("In-flight frame wait failure! error: %s", vulkan_result_string(result, true));
+            return false;
+        }
+    }
+
+    completed_frame_update(context, completed_frame_get(context));
+    return true;
+}
+
+b8 vulkan_frame_sync_wait_frames(vulkan_context* context) {
+    VkDevice device = context->device.logical_device;
+    VkResult result = VK_SUCCESS;
+    if (context->frame_timeline) {
+        if (context->submitted_frame_number > context->completed_frame_number) {
+            VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &context->frame_timeline;
+            wait_info.pValues = &context->submitted_frame_number;
+            result = vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+        }
+    } else {
+        // Fences are only reset on submission, so only those of submitted frames can be pending.
+        VkFence fences[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        u32 fence_count = 0;
+        for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+            if (context->in_flight_submitted[i]) {
+                fences[fence_count++] = context->in_flight_fences[i];
+            }
+        }
+        if (fence_count) {
+            result = vkWaitForFences(device, fence_count, fences, true, UINT64_MAX);
+        }
+    }
+    if (!vulkan_result_is_success(result)) {
+        KERROR("vulkan_frame_sync_wait_frames frame wait failed: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+    completed_frame_update(context, context->submitted_frame_number);
+    return true;
+}
+
+b8 vulkan_frame_sync_wait_all(vulkan_context* context) {
+    if (!vulkan_frame_sync_wait_frames(context)) {
+        return false;
+    }
+
+    // Presentation may still be using the images, even though rendering to them is done.
+    VkResult result = vkQueueWaitIdle(context->device.present_queue);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("vulkan_frame_sync_wait_all present queue wait failed: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+    return true;
+}
+
+void vulkan_frame_sync_begin(vulkan_context* context, u32 frame_index) {
+    context->frame_number++;
+    context->in_flight_frame_numbers[frame_index] = context->frame_number;
+    context->in_flight_start_times[frame_index] = platform_get_absolute_time();
+    context->in_flight_submitted[frame_index] = false;
+}
+
+// Adds a wait on the image of each other window acquired since the last submission.
+static void window_image_waits_add(vulkan_context* context, VkSemaphore* semaphores, VkPipelineStageFlags* stages, u32* count) {
+    for (u32 i = 0; i < VULKAN_MAX_WINDOWS; ++i) {
+        vulkan_window* window = context->windows[i];
+        if (window && window->image_wait_pending) {
+            semaphores[*count] = window->image_available_semaphores[context->current_frame];
+            stages[*count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            (*count)++;
+            window->image_wait_pending = false;
+        }
+    }
+}
+
+b8 vulkan_frame_sync_submit(vulkan_context* context, VkCommandBuffer command_buffer, u8 draw_index) {
+    u32 frame_index = context->current_frame;
+    u64 number = context->in_flight_frame_numbers[frame_index];
+
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+
+    // Each semaphore waits on the corresponding pipeline stage to complete. 1:1
+    // ratio. VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT prevents subsequent
+    // colour attachment writes from executing until the semaphore signals (i.e.
+    // one frame is presented at a time)
+    VkSemaphore wait_semaphores[2 + VULKAN_MAX_WINDOWS];
+    VkPipelineStageFlags wait_stages[2 + VULKAN_MAX_WINDOWS];
+    u32 wait_count = 0;
+    if (draw_index == 0 && !context->image_wait_submitted) {
+        wait_semaphores[wait_count] = context->image_available_semaphores[frame_index];
+        wait_stages[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_count++;
+    }
+    window_image_waits_add(context, wait_semaphores, wait_stages, &wait_count);
+    // Everything left of the frame was recorded after whatever consumes the async compute results.
+    if (context->async_compute_submitted) {
+        wait_semaphores[wait_count] = context->async_compute_complete_semaphores[frame_index];
+        wait_stages[wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        wait_count++;
+    }
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    context->image_wait_submitted = false;
+    context->async_compute_submitted = false;
+
+    // Only the first submission of the frame waits for the image and signals completion. Since
+    // a signal also covers everything submitted before it, later submissions aren't tracked.
+    VkSemaphore signal_semaphores[2] = {context->queue_complete_semaphores[frame_index], context->frame_timeline};
+    // The value for the binary semaphore is ignored.
+    u64 signal_values[2] = {0, number};
+    VkTimelineSemaphoreSubmitInfo timeline_info = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    VkFence fence = 0;
+    if (draw_index == 0) {
+        submit_info.pSignalSemaphores = signal_semaphores;
+        if (context->frame_timeline) {
+            submit_info.signalSemaphoreCount = 2;
+            timeline_info.signalSemaphoreValueCount = 2;
+            timeline_info.pSignalSemaphoreValues = signal_values;
+            submit_info.pNext = &timeline_info;
+        } else {
+            submit_info.signalSemaphoreCount = 1;
+            // Reset here rather than when the frame begins, so a frame which is prepared but never
+            // submitted doesn't leave its fence unsignaled forever.
+            fence = context->in_flight_fences[frame_index];
+            VK_CHECK(vkResetFences(context->device.logical_device, 1, &fence));
+        }
+    }
+
+    VkResult result = vkQueueSubmit(context->device.graphics_queue, 1, &submit_info, fence);
+    if (result != VK_SUCCESS) {
+        KERROR("vkQueueSubmit failed with result: %s", vulkan_result_string(result, true));
+        return false;
+    }
+
+    if (draw_index == 0) {
+        context->in_flight_submitted[frame_index] = true;
+        context->submitted_frame_number = number;
+    }
+    return true;
+}
+
+b8 vulkan_frame_sync_submit_partial(vulkan_context* context, VkCommandBuffer command_buffer, u8 draw_index) {
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+
+    // The first part of the frame waits on the image, in case it already renders to it. The same goes
+    // for the images of other windows acquired so far.
+    VkSemaphore wait_semaphores[1 + VULKAN_MAX_WINDOWS];
+    VkPipelineStageFlags wait_stages[1 + VULKAN_MAX_WINDOWS];
+    u32 wait_count = 0;
+    if (draw_index == 0 && !context->image_wait_submitted) {
+        wait_semaphores[wait_count] = context->image_available_semaphores[context->current_frame];
+        wait_stages[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_count++;
+        context->image_wait_submitted = true;
+    }
+    window_image_waits_add(context, wait_semaphores, wait_stages, &wait_count);
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+
+    VkResult result = vkQueueSubmit(context->device.graphics_queue, 1, &submit_info, 0);
+    if (result != VK_SUCCESS) {
+        KERROR("vkQueueSubmit (partial frame) failed with result: %s", vulkan_result_string(result, true));
+        return false;
+    }
+    return true;
+}
+
+b8 vulkan_frame_sync_submit_async_compute(vulkan_context* context, VkCommandBuffer command_buffer) {
+    u32 frame_index = context->current_frame;
+
+    // Signal once everything already submitted to the graphics queue has completed, uploads included,
+    // so the compute work sees them and never overwrites anything an earlier frame is still reading.
+    // The part of this frame recorded so far is submitted after this, so still overlaps the compute work.
+    VkSubmitInfo ready_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    ready_info.signalSemaphoreCount = 1;
+    ready_info.pSignalSemaphores = &context->async_compute_ready_semaphores[frame_index];
+    VkResult result = vkQueueSubmit(context->device.graphics_queue, 1, &ready_info, 0);
+    if (result != VK_SUCCESS) {
+        KERROR("vkQueueSubmit (async compute ready) failed with result: %s", vulkan_result_string(result, true));
+        return false;
+    }
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo compute_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    compute_info.waitSemaphoreCount = 1;
+    compute_info.pWaitSemaphores = &context->async_compute_ready_semaphores[frame_index];
+    compute_info.pWaitDstStageMask = &wait_stage;
+    compute_info.commandBufferCount = 1;
+    compute_info.pCommandBuffers = &command_buffer;
+    compute_info.signalSemaphoreCount = 1;
+    compute_info.pSignalSemaphores = &context->async_compute_complete_semaphores[frame_index];
+    result = vkQueueSubmit(context->device.compute_queue, 1, &compute_info, 0);
+    if (result != VK_SUCCESS) {
+        KERROR("vkQueueSubmit (async compute) failed with result: %s", vulkan_result_string(result, true));
+        return false;
+    }
+
+    context->async_compute_submitted = true;
+    return true;
+}
+
+void vulkan_frame_sync_poll(vulkan_context* context) {
+    completed_frame_update(context, completed_frame_get(context));
+}
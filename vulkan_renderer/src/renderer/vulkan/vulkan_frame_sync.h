@@ -0,0 +1,109 @@
+/**
+ * @file vulkan_frame_sync.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Synchronization between the CPU and the frames it has in flight on the GPU. Uses a
+ * timeline semaphore where supported, falling back to a fence per frame in flight otherwise.
+ * Also measures the latency of each frame, from being prepared to completing on the GPU.
+ * @version 1.0
+ * @date 2023-11-23
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the semaphores and fences for all frames in flight.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_create(vulkan_context* context);
+
+/**
+ * @brief Destroys the semaphores and fences for all frames in flight. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_frame_sync_destroy(vulkan_context* context);
+
+/**
+ * @brief Waits for the frame last submitted in the given frame in flight to complete.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_wait(vulkan_context* context, u32 frame_index);
+
+/**
+ * @brief Waits for all submitted frames to complete, without waiting for presentation of them
+ * to finish. Enough before touching per-frame resources, but not before destroying images still
+ * being presented.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_wait_frames(vulkan_context* context);
+
+/**
+ * @brief Waits for all submitted frames to complete and for presentation of them to finish,
+ * without waiting on the rest of the device (i.e. uploads on the transfer queue).
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_wait_all(vulkan_context* context);
+
+/**
+ * @brief Begins a new frame in the given frame in flight, which must have been waited on.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ */
+void vulkan_frame_sync_begin(vulkan_context* context, u32 frame_index);
+
+/**
+ * @brief Submits the given command buffer for the current frame. The first submission of a frame
+ * waits on image availability, unless part of it already did, and signals queue completion and the
+ * completion of the frame. Also waits on any async compute work submitted for it.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The command buffer to be submitted.
+ * @param draw_index The index of this submission within the frame.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_submit(vulkan_context* context, VkCommandBuffer command_buffer, u8 draw_index);
+
+/**
+ * @brief Submits the part of the current frame recorded so far, ahead of the rest of it. Waits on image
+ * availability if it is the first part of the frame, but signals nothing.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The command buffer to be submitted.
+ * @param draw_index The index of this submission within the frame.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_submit_partial(vulkan_context* context, VkCommandBuffer command_buffer, u8 draw_index);
+
+/**
+ * @brief Submits the given command buffer of async compute work for the current frame to the compute
+ * queue. It waits on everything submitted to the graphics queue beforehand, and the next call to
+ * vulkan_frame_sync_submit waits on it.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The command buffer to be submitted.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_frame_sync_submit_async_compute(vulkan_context* context, VkCommandBuffer command_buffer);
+
+/**
+ * @brief Checks, without waiting, for frames which have completed since last checked and
+ * records their latency.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_frame_sync_poll(vulkan_context* context);
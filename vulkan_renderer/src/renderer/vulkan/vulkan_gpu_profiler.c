@@ -0,0 +1,189 @@
+#include "vulkan_gpu_profiler.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "vulkan_utils.h"
+
+// The pipeline statistics gathered per timer, in the order they are returned.
+#define STATISTICS_FLAGS (VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+#define STATISTICS_COUNT 2
+
+b8 vulkan_gpu_profiler_create(vulkan_context* context) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    VkDevice device = context->device.logical_device;
+    profiler->open_timer = INVALID_ID;
+
+    VkQueueFamilyProperties props[32];
+    u32 prop_count = 32;
+    vkGetPhysicalDeviceQueueFamilyProperties(context->device.physical_device, &prop_count, props);
+    u32 valid_bits = props[context->device.graphics_queue_index].timestampValidBits;
+    if (valid_bits == 0 || context->device.properties.limits.timestampPeriod <= 0.0f) {
+        KWARN("Graphics queue does not support timestamps. GPU profiling is disabled.");
+        return true;
+    }
+    profiler->timestamps_supported = true;
+    profiler->timestamp_period = context->device.properties.limits.timestampPeriod;
+    profiler->timestamp_mask = valid_bits >= 64 ? UINT64_MAX : ((1ULL << valid_bits) - 1);
+    profiler->statistics_supported = context->device.features.pipelineStatisticsQuery == VK_TRUE;
+
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkQueryPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = VULKAN_MAX_GPU_TIMERS * 2;
+        VkResult result = vkCreateQueryPool(device, &pool_info, context->allocator, &profiler->timestamp_pools[i]);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to create timestamp query pool: '%s'", vulkan_result_string(result, true));
+            return false;
+        }
+
+        if (profiler->statistics_supported) {
+            pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            pool_info.queryCount = VULKAN_MAX_GPU_TIMERS;
+            pool_info.pipelineStatistics = STATISTICS_FLAGS;
+            result = vkCreateQueryPool(device, &pool_info, context->allocator, &profiler->statistics_pools[i]);
+            if (!vulkan_result_is_success(result)) {
+                KERROR("Failed to create pipeline statistics query pool: '%s'", vulkan_result_string(result, true));
+                return false;
+            }
+        }
+    }
+
+    KINFO("GPU profiling enabled%s.", profiler->statistics_supported ? " with pipeline statistics" : "");
+    return true;
+}
+
+void vulkan_gpu_profiler_destroy(vulkan_context* context) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (profiler->timestamp_pools[i]) {
+            vkDestroyQueryPool(context->device.logical_device, profiler->timestamp_pools[i], context->allocator);
+            profiler->timestamp_pools[i] = 0;
+        }
+        if (profiler->statistics_pools[i]) {
+            vkDestroyQueryPool(context->device.logical_device, profiler->statistics_pools[i], context->allocator);
+            profiler->statistics_pools[i] = 0;
+        }
+    }
+    kzero_memory(profiler, sizeof(vulkan_gpu_profiler));
+}
+
+void vulkan_gpu_profiler_frame_begin(vulkan_context* context, VkCommandBuffer command_buffer) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    if (!profiler->timestamps_supported) {
+        return;
+    }
+
+    u32 frame = context->current_frame;
+    vkCmdResetQueryPool(command_buffer, profiler->timestamp_pools[frame], 0, VULKAN_MAX_GPU_TIMERS * 2);
+    if (profiler->statistics_supported) {
+        vkCmdResetQueryPool(command_buffer, profiler->statistics_pools[frame], 0, VULKAN_MAX_GPU_TIMERS);
+    }
+    profiler->timer_counts[frame] = 0;
+    profiler->open_timer = INVALID_ID;
+}
+
+void vulkan_gpu_profiler_pass_begin(vulkan_context* context, VkCommandBuffer command_buffer, const char* name, b8 statistics) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    u32 frame = context->current_frame;
+    if (!profiler->timestamps_supported || profiler->timer_counts[frame] >= VULKAN_MAX_GPU_TIMERS) {
+        return;
+    }
+    if (profiler->open_timer != INVALID_ID) {
+        KWARN("vulkan_gpu_profiler_pass_begin - A timer is already open. Ignoring nested timer.");
+        return;
+    }
+
+    u32 index = profiler->timer_counts[frame]++;
+    vulkan_gpu_timer* timer = &profiler->timers[frame][index];
+    string_ncopy(timer->name, name ? name : "unnamed", METRICS_GPU_PASS_NAME_MAX - 1);
+    timer->name[METRICS_GPU_PASS_NAME_MAX - 1] = 0;
+    timer->has_statistics = statistics && profiler->statistics_supported;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->timestamp_pools[frame], index * 2);
+    if (timer->has_statistics) {
+        vkCmdBeginQuery(command_buffer, profiler->statistics_pools[frame], index, 0);
+    }
+    profiler->open_timer = index;
+}
+
+void vulkan_gpu_profiler_pass_end(vulkan_context* context, VkCommandBuffer command_buffer) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    if (profiler->open_timer == INVALID_ID) {
+        return;
+    }
+
+    u32 frame = context->current_frame;
+    u32 index = profiler->open_timer;
+    if (profiler->timers[frame][index].has_statistics) {
+        vkCmdEndQuery(command_buffer, profiler->statistics_pools[frame], index);
+    }
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->timestamp_pools[frame], index * 2 + 1);
+    profiler->open_timer = INVALID_ID;
+}
+
+void vulkan_gpu_profiler_resolve(vulkan_context* context, u32 frame_index) {
+    vulkan_gpu_profiler* profiler = &context->profiler;
+    u32 count = profiler->timer_counts[frame_index];
+    if (!profiler->timestamps_supported || !count) {
+        return;
+    }
+
+    VkDevice device = context->device.logical_device;
+    u64 timestamps[VULKAN_MAX_GPU_TIMERS * 2];
+    // The frame has completed, so the results should be available without waiting.
+    VkResult result = vkGetQueryPoolResults(
+        device, profiler->timestamp_pools[frame_index], 0, count * 2, sizeof(timestamps), timestamps,
+        sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        // VK_NOT_READY if the frame was never submitted, in which case there is nothing to report.
+        return;
+    }
+
+    u64 statistics[VULKAN_MAX_GPU_TIMERS * STATISTICS_COUNT];
+    kzero_memory(statistics, sizeof(statistics));
+    if (profiler->statistics_supported) {
+        // Only some timers query statistics, so fetch them one at a time to skip unwritten queries.
+        for (u32 i = 0; i < count; ++i) {
+            if (profiler->timers[frame_index][i].has_statistics) {
+                vkGetQueryPoolResults(
+                    device, profiler->statistics_pools[frame_index], i, 1, sizeof(u64) * STATISTICS_COUNT,
+                    &statistics[i * STATISTICS_COUNT], sizeof(u64) * STATISTICS_COUNT, VK_QUERY_RESULT_64_BIT);
+            }
+        }
+    }
+
+    // Sum timers sharing a name, such as a pass made of several renderpasses, in order of first appearance.
+    metrics_gpu_pass passes[METRICS_MAX_GPU_PASSES];
+    u32 pass_count = 0;
+    // The frame spans from the first timer's start to the latest end of any of them.
+    u64 frame_ticks = 0;
+    for (u32 i = 0; i < count; ++i) {
+        vulkan_gpu_timer* timer = &profiler->timers[frame_index][i];
+        u64 end_ticks = (timestamps[i * 2 + 1] - timestamps[0]) & profiler->timestamp_mask;
+        frame_ticks = KMAX(frame_ticks, end_ticks);
+        metrics_gpu_pass* pass = 0;
+        for (u32 p = 0; p < pass_count; ++p) {
+            if (strings_equal(passes[p].name, timer->name)) {
+                pass = &passes[p];
+                break;
+            }
+        }
+        if (!pass) {
+            if (pass_count >= METRICS_MAX_GPU_PASSES) {
+                continue;
+            }
+            pass = &passes[pass_count++];
+            kzero_memory(pass, sizeof(metrics_gpu_pass));
+            string_ncopy(pass->name, timer->name, METRICS_GPU_PASS_NAME_MAX);
+        }
+
+        u64 ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & profiler->timestamp_mask;
+        pass->ms += ((f64)ticks * profiler->timestamp_period) / 1000000.0;
+        pass->vertex_invocations += statistics[i * STATISTICS_COUNT];
+        pass->fragment_invocations += statistics[i * STATISTICS_COUNT + 1];
+    }
+
+    metrics_gpu_passes_set(passes, pass_count);
+    metrics_gpu_frame_time_set(((f64)frame_ticks * profiler->timestamp_period) / 1000000.0);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file vulkan_gpu_profiler.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Times renderpasses on the GPU using timestamp queries written into per-frame query
+ * pools, and counts their shader invocations with pipeline statistics queries where supported.
+ * Results are read back once a frame has completed and reported via the metrics system.
+ * @version 1.0
+ * @date 2023-11-24
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the query pools used for profiling. Does nothing if the graphics queue
+ * doesn't support timestamps, in which case profiling is disabled.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_gpu_profiler_create(vulkan_context* context);
+
+/**
+ * @brief Destroys the query pools used for profiling. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_gpu_profiler_destroy(vulkan_context* context);
+
+/**
+ * @brief Resets the queries of the current frame. Must be recorded outside of a renderpass,
+ * before any timers of the frame.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The primary command buffer of the current frame.
+ */
+void vulkan_gpu_profiler_frame_begin(vulkan_context* context, VkCommandBuffer command_buffer);
+
+/**
+ * @brief Starts timing a renderpass. Must be recorded outside of the renderpass, just before it begins.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The primary command buffer of the current frame.
+ * @param name The name of the renderpass.
+ * @param statistics Indicates if pipeline statistics should also be queried. Must be false if the
+ * renderpass executes secondary command buffers.
+ */
+void vulkan_gpu_profiler_pass_begin(vulkan_context* context, VkCommandBuffer command_buffer, const char* name, b8 statistics);
+
+/**
+ * @brief Stops timing the renderpass begun last. Must be recorded just after the renderpass ends.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The primary command buffer of the current frame.
+ */
+void vulkan_gpu_profiler_pass_end(vulkan_context* context, VkCommandBuffer command_buffer);
+
+/**
+ * @brief Reads back the results of the given frame in flight, which must have completed, and
+ * reports them via the metrics system.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ */
+void vulkan_gpu_profiler_resolve(vulkan_context* context, u32 frame_index);
@@ -4,11 +4,23 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "defines.h"
+#include "renderer/renderer_utils.h"
 #include "resources/resource_types.h"
 #include "vulkan/vulkan_core.h"
 #include "vulkan_device.h"
+#include "vulkan_memory.h"
 #include "vulkan_utils.h"
 
+static b8 lazily_allocated_memory_available(vulkan_context* context, u32 type_filter) {
+    const VkPhysicalDeviceMemoryProperties* memory = &context->device.memory;
+    for (u32 i = 0; i < memory->memoryTypeCount; ++i) {
+        if ((type_filter & (1 << i)) && (memory->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void vulkan_image_create(
     vulkan_context* context,
     texture_type type,
@@ -37,6 +49,8 @@ void vulkan_image_create(
     out_image->format = format;
     out_image->layer_count = layer_count;
     out_image->layer_views = 0;
+    out_image->usage = usage;
+    out_image->mip_filter = VULKAN_MIP_FILTER_LINEAR;
     if (layer_count < 1) {
         layer_count = 1;
     }
@@ -73,22 +87,28 @@ void vulkan_image_create(
     // Query memory requirements.
     vkGetImageMemoryRequirements(context->device.logical_device, out_image->handle, &out_image->memory_requirements);
 
+    // Transient attachments are backed by tile memory alone where the device has lazily allocated
+    // memory, as tiled GPUs do. Elsewhere they are allocated as usual.
+    if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && lazily_allocated_memory_available(context, out_image->memory_requirements.memoryTypeBits)) {
+        memory_flags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        out_image->memory_flags = memory_flags;
+    }
     i32 memory_type = context->find_memory_index(context, out_image->memory_requirements.memoryTypeBits, memory_flags);
     if (memory_type == -1) {
         KERROR("Required memory type not found. Image not valid.");
+        return;
     }
 
-    // Allocate memory
-    VkMemoryAllocateInfo memory_allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memory_allocate_info.allocationSize = out_image->memory_requirements.size;
-    memory_allocate_info.memoryTypeIndex = memory_type;
-    VK_CHECK(vkAllocateMemory(context->device.logical_device, &memory_allocate_info, context->allocator, &out_image->memory));
-    if (out_image->name) {
-        VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_DEVICE_MEMORY, out_image->memory, out_image->name);
+    // Allocate memory. Attachments are recreated on resize, so they don't take up block space.
+    b8 is_linear = tiling == VK_IMAGE_TILING_LINEAR;
+    b8 dedicated = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+    if (!vulkan_memory_allocate(context, &out_image->memory_requirements, memory_type, is_linear, dedicated, out_image->name, &out_image->memory)) {
+        KERROR("Failed to allocate memory for image '%s'.", out_image->name ? out_image->name : "");
+        return;
     }
 
     // Bind the memory
-    VK_CHECK(vkBindImageMemory(context->device.logical_device, out_image->handle, out_image->memory, 0));  // TODO: configurable memory offset.
+    VK_CHECK(vkBindImageMemory(context->device.logical_device, out_image->handle, out_image->memory.memory, out_image->memory.offset));
 
     // Report the memory as in-use.
     b8 is_device_memory = (out_image->memory_flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -201,6 +221,16 @@ void vulkan_image_transition_layout(
 
         // The fragment stage.
         dest_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        // Writing to part of an image already in use, which keeps its contents.
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        // Once the fragment stage is done reading it...
+        source_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        // Used for copying
+        dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
         // Transitioning from a transfer source layout to a shader-readonly layout.
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -220,6 +250,46 @@ void vulkan_image_transition_layout(
 
         // Used for copying
         dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        // A render target being read back once its renderpass is done writing it.
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        // From the colour output stage to...
+        source_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        // The copying stage.
+        dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+        // Storage images, which are read and written by compute shaders and sampled afterward.
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        // Don't care what stage the pipeline is in at the start.
+        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        // Used by compute and fragment shaders.
+        dest_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_GENERAL && new_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        // A storage image being read back once compute shaders are done writing it.
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        // From the compute stage to...
+        source_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+        // The copying stage.
+        dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+        // A storage image handed back to shaders after being read back.
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        // From the copying stage to...
+        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        // The compute and fragment stages.
+        dest_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     } else {
         KFATAL("unsupported layout transition!");
         return;
@@ -269,6 +339,8 @@ b8 vulkan_image_mipmaps_generate(vulkan_context* context, vulkan_image* image, v
 
     // Iterate each sub-mip level, starting at 1 (i.e. not the base level/full res image).
     // Each mip level uses the previous level as source material for the blitting operation.
+    // Only the barrier making the previous level readable is needed between blits. Levels are
+    // left as transfer sources until the end, where they are all made shader-readable at once.
     for (u32 i = 1; i < image->mip_levels; ++i) {
         barrier.subresourceRange.baseMipLevel = i - 1;
         barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -308,7 +380,7 @@ b8 vulkan_image_mipmaps_generate(vulkan_context* context, vulkan_image* image, v
         blit.dstSubresource.baseArrayLayer = 0;
         blit.dstSubresource.layerCount = image->layer_count;
 
-        // Perform the blit for this layer.
+        // Perform the blit for all layers. For sRGB formats, the texels are filtered in linear space.
         vkCmdBlitImage(
             command_buffer->handle,
             image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -316,21 +388,6 @@ b8 vulkan_image_mipmaps_generate(vulkan_context* context, vulkan_image* image, v
             1, &blit,
             VK_FILTER_LINEAR);
 
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        // Transition the previous mip layer's image subresource to a shader-readable layout.
-        vkCmdPipelineBarrier(
-            command_buffer->handle,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0, 0,
-            0, 0,
-            1, &barrier);
-
         // Split the width and height in half for the next level, if there is one.
         if (mip_width > 1) {
             mip_width /= 2;
@@ -340,14 +397,22 @@ b8 vulkan_image_mipmaps_generate(vulkan_context* context, vulkan_image* image, v
         }
     }
 
-    // Finally, transition the last mipmap level to a shader-readable layout.
-    // This would not have been handled in the above loop since that always transitions
-    // the previous layer.
-    barrier.subresourceRange.baseMipLevel = image->mip_levels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    // Finally, transition every level to a shader-readable layout in a single batch. All but the
+    // last level were blitted from, so are transfer sources, while the last was only written.
+    VkImageMemoryBarrier final_barriers[2] = {barrier, barrier};
+    final_barriers[0].subresourceRange.baseMipLevel = 0;
+    final_barriers[0].subresourceRange.levelCount = image->mip_levels - 1;
+    final_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    final_barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    final_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    final_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    final_barriers[1].subresourceRange.baseMipLevel = image->mip_levels - 1;
+    final_barriers[1].subresourceRange.levelCount = 1;
+    final_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    final_barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    final_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    final_barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
     vkCmdPipelineBarrier(
         command_buffer->handle,
@@ -356,7 +421,7 @@ b8 vulkan_image_mipmaps_generate(vulkan_context* context, vulkan_image* image, v
         0,
         0, 0,
         0, 0,
-        1, &barrier);
+        2, final_barriers);
 
     return true;
 }
@@ -391,6 +456,48 @@ void vulkan_image_copy_from_buffer(
         &region);
 }
 
+void vulkan_image_copy_levels_from_buffer(
+    vulkan_context* context,
+    vulkan_image* image,
+    texture_format format,
+    VkBuffer buffer,
+    u64 offset,
+    vulkan_command_buffer* command_buffer) {
+    VkBufferImageCopy regions[32];
+    u32 level_count = KMIN(image->mip_levels, 32);
+    u32 width = image->width;
+    u32 height = image->height;
+    for (u32 i = 0; i < level_count; ++i) {
+        VkBufferImageCopy* region = &regions[i];
+        kzero_memory(region, sizeof(VkBufferImageCopy));
+        region->bufferOffset = offset;
+        region->bufferRowLength = 0;
+        region->bufferImageHeight = 0;
+
+        region->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region->imageSubresource.mipLevel = i;
+        region->imageSubresource.baseArrayLayer = 0;
+        region->imageSubresource.layerCount = image->layer_count;
+
+        region->imageExtent.width = width;
+        region->imageExtent.height = height;
+        region->imageExtent.depth = 1;
+
+        // Layers of the same level are stored next to each other.
+        offset += texture_format_level_size(format, width, height) * image->layer_count;
+        width = KMAX(width / 2, 1);
+        height = KMAX(height / 2, 1);
+    }
+
+    vkCmdCopyBufferToImage(
+        command_buffer->handle,
+        buffer,
+        image->handle,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        level_count,
+        regions);
+}
+
 void vulkan_image_copy_to_buffer(
     vulkan_context* context,
     vulkan_image* image,
@@ -423,11 +530,12 @@ void vulkan_image_copy_pixel_to_buffer(
     vulkan_context* context,
     vulkan_image* image,
     VkBuffer buffer,
+    u64 buffer_offset,
     u32 x,
     u32 y,
     vulkan_command_buffer* command_buffer) {
     VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
+    region.bufferOffset = buffer_offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
@@ -464,14 +572,13 @@ void vulkan_image_destroy(vulkan_context* context, vulkan_image* image) {
         image->layer_views = 0;
         image->layer_count = 0;
     }
-    if (image->memory) {
-        vkFreeMemory(context->device.logical_device, image->memory, context->allocator);
-        image->memory = 0;
-    }
     if (image->handle) {
         vkDestroyImage(context->device.logical_device, image->handle, context->allocator);
         image->handle = 0;
     }
+    if (image->memory.memory) {
+        vulkan_memory_free(context, &image->memory);
+    }
     if (image->name) {
         kfree(image->name, string_length(image->name) + 1, MEMORY_TAG_STRING);
         image->name = 0;
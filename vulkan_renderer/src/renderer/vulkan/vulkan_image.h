@@ -115,6 +115,24 @@ void vulkan_image_copy_from_buffer(
     u64 offset,
     vulkan_command_buffer* command_buffer);
 
+/**
+ * @brief Copies every mip level of the provided image from the data in buffer, where
+ * the levels are stored in order from largest to smallest, each tightly packed.
+ * @param context The Vulkan context.
+ * @param image The image to copy the buffer's data to.
+ * @param format The format of the data in the buffer, used to determine the size of each level.
+ * @param buffer The buffer whose data will be copied.
+ * @param offset The offset in bytes from the beginning of the buffer.
+ * @param command_buffer A pointer to the command buffer to be used for this operation.
+ */
+void vulkan_image_copy_levels_from_buffer(
+    vulkan_context* context,
+    vulkan_image* image,
+    texture_format format,
+    VkBuffer buffer,
+    u64 offset,
+    vulkan_command_buffer* command_buffer);
+
 /**
  * @brief Copies data in the provided image to the given buffer.
  *
@@ -135,6 +153,7 @@ void vulkan_image_copy_to_buffer(
  * @param context The Vulkan context.
  * @param image The image to copy the image's data from.
  * @param buffer The buffer to copy to.
+ * @param buffer_offset The offset in bytes within the buffer to copy to. Must be a multiple of 4.
  * @param x The x-coordinate of the pixel to copy.
  * @param y The y-coordinate of the pixel to copy.
  * @param command_buffer The command buffer to be used for the copy.
@@ -143,6 +162,7 @@ void vulkan_image_copy_pixel_to_buffer(
     vulkan_context* context,
     vulkan_image* image,
     VkBuffer buffer,
+    u64 buffer_offset,
     u32 x,
     u32 y,
     vulkan_command_buffer* command_buffer);
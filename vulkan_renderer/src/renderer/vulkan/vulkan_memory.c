@@ -0,0 +1,348 @@
+#include "vulkan_memory.h"
+
+#include "containers/darray.h"
+#include "containers/freelist.h"
+#include "core/kmemory.h"
+#include "core/kmutex.h"
+#include "core/logger.h"
+#include "core/metrics.h"
+#include "vulkan_utils.h"
+
+// The size of newly-created blocks. Smaller heaps use an eighth of the heap instead.
+#define VULKAN_MEMORY_BLOCK_SIZE MEBIBYTES(64)
+// Without a budget from the driver, the fraction of each heap assumed to be usable before paging starts.
+#define VULKAN_MEMORY_ESTIMATED_BUDGET_FRACTION 0.8
+
+// Reports the current statistics to the metrics system. Must be called with the lock held.
+static void stats_report(vulkan_memory_allocator* allocator) {
+    metrics_gpu_memory stats;
+    stats.block_count = allocator->block_count;
+    stats.block_bytes = allocator->block_bytes;
+    stats.block_used_bytes = allocator->block_used_bytes;
+    stats.block_allocation_count = allocator->block_allocation_count;
+    stats.dedicated_count = allocator->dedicated_count;
+    stats.dedicated_bytes = allocator->dedicated_bytes;
+    metrics_gpu_memory_set(&stats);
+}
+
+static b8 memory_type_is_host_visible(vulkan_context* context, u32 memory_type_index) {
+    return (context->device.memory.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static u32 heap_index_get(vulkan_context* context, u32 memory_type_index) {
+    return context->device.memory.memoryTypes[memory_type_index].heapIndex;
+}
+
+static u64 block_size_get(vulkan_context* context, u32 memory_type_index) {
+    u32 heap_index = context->device.memory.memoryTypes[memory_type_index].heapIndex;
+    u64 heap_size = context->device.memory.memoryHeaps[heap_index].size;
+    return KMIN(context->memory_allocator.block_size, heap_size / 8);
+}
+
+static b8 block_create(vulkan_context* context, u32 memory_type_index, b8 is_linear, u32* out_block_index) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    vulkan_memory_block block = {0};
+    block.size = block_size_get(context, memory_type_index);
+    block.memory_type_index = memory_type_index;
+    block.is_linear = is_linear;
+
+    VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.allocationSize = block.size;
+    allocate_info.memoryTypeIndex = memory_type_index;
+    VkResult result = vkAllocateMemory(context->device.logical_device, &allocate_info, context->allocator, &block.memory);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to allocate memory block of %lluB for memory type %u: %s", block.size, memory_type_index, vulkan_result_string(result, true));
+        return false;
+    }
+
+    // Host-visible blocks stay mapped, since a given VkDeviceMemory may only be mapped once at a time.
+    if (memory_type_is_host_visible(context, memory_type_index)) {
+        result = vkMapMemory(context->device.logical_device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to map memory block: %s", vulkan_result_string(result, true));
+            vkFreeMemory(context->device.logical_device, block.memory, context->allocator);
+            return false;
+        }
+    }
+
+    // TLSF keeps allocations and frees constant time regardless of how fragmented the block gets.
+    freelist_create_strategy(block.size, FREELIST_STRATEGY_TLSF, &block.free_list_memory_requirement, 0, 0);
+    block.free_list_block = kallocate(block.free_list_memory_requirement, MEMORY_TAG_VULKAN);
+    freelist_create_strategy(block.size, FREELIST_STRATEGY_TLSF, &block.free_list_memory_requirement, block.free_list_block, &block.free_list);
+
+    // Reuse an unused slot if there is one.
+    u32 block_count = darray_length(allocator->blocks);
+    u32 index = INVALID_ID;
+    for (u32 i = 0; i < block_count; ++i) {
+        if (!allocator->blocks[i].memory) {
+            index = i;
+            break;
+        }
+    }
+    if (index == INVALID_ID) {
+        darray_push(allocator->blocks, block);
+        index = block_count;
+    } else {
+        allocator->blocks[index] = block;
+    }
+
+    allocator->block_count++;
+    allocator->block_bytes += block.size;
+    allocator->heap_bytes[heap_index_get(context, memory_type_index)] += block.size;
+    KDEBUG("Created %lluB memory block %u for memory type %u (%s).", block.size, index, memory_type_index, is_linear ? "linear" : "optimal");
+
+    *out_block_index = index;
+    return true;
+}
+
+static void block_destroy(vulkan_context* context, u32 block_index) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    vulkan_memory_block* block = &allocator->blocks[block_index];
+    if (block->mapped) {
+        vkUnmapMemory(context->device.logical_device, block->memory);
+    }
+    vkFreeMemory(context->device.logical_device, block->memory, context->allocator);
+    freelist_destroy(&block->free_list);
+    kfree(block->free_list_block, block->free_list_memory_requirement, MEMORY_TAG_VULKAN);
+
+    allocator->block_count--;
+    allocator->block_bytes -= block->size;
+    allocator->heap_bytes[heap_index_get(context, block->memory_type_index)] -= block->size;
+    kzero_memory(block, sizeof(vulkan_memory_block));
+}
+
+// Attempts to reserve a suitably-aligned range within the given block.
+static b8 block_try_allocate(vulkan_memory_block* block, const VkMemoryRequirements* requirements, vulkan_memory_allocation* out_allocation) {
+    // Reserve enough to be able to align the start of the range.
+    u64 alignment = KMAX(requirements->alignment, 1);
+    u64 reserved_size = requirements->size + alignment - 1;
+    if (block->size - block->used < reserved_size) {
+        return false;
+    }
+    u64 reserved_offset = 0;
+    if (!freelist_allocate_block(&block->free_list, reserved_size, &reserved_offset)) {
+        return false;
+    }
+
+    block->used += reserved_size;
+    block->allocation_count++;
+
+    out_allocation->memory = block->memory;
+    out_allocation->offset = get_aligned(reserved_offset, alignment);
+    out_allocation->size = requirements->size;
+    out_allocation->reserved_offset = reserved_offset;
+    out_allocation->reserved_size = reserved_size;
+    return true;
+}
+
+b8 vulkan_memory_allocator_create(vulkan_context* context) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    kzero_memory(allocator, sizeof(vulkan_memory_allocator));
+    allocator->block_size = VULKAN_MEMORY_BLOCK_SIZE;
+    allocator->blocks = darray_create(vulkan_memory_block);
+    if (!kmutex_create(&allocator->lock)) {
+        KERROR("Failed to create memory allocator mutex.");
+        return false;
+    }
+    return true;
+}
+
+void vulkan_memory_allocator_destroy(vulkan_context* context) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    if (!allocator->blocks) {
+        return;
+    }
+
+    if (allocator->block_allocation_count || allocator->dedicated_count) {
+        KWARN("Memory allocator destroyed with %u sub-allocations and %u dedicated allocations still live.", allocator->block_allocation_count, allocator->dedicated_count);
+    }
+
+    u32 block_count = darray_length(allocator->blocks);
+    for (u32 i = 0; i < block_count; ++i) {
+        if (allocator->blocks[i].memory) {
+            block_destroy(context, i);
+        }
+    }
+    darray_destroy(allocator->blocks);
+    allocator->blocks = 0;
+    kmutex_destroy(&allocator->lock);
+}
+
+b8 vulkan_memory_allocate(vulkan_context* context, const VkMemoryRequirements* requirements, u32 memory_type_index, b8 is_linear, b8 dedicated, const char* name, vulkan_memory_allocation* out_allocation) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    kzero_memory(out_allocation, sizeof(vulkan_memory_allocation));
+
+    // Anything taking up a sizable portion of a block is better off on its own.
+    if (!dedicated && requirements->size > block_size_get(context, memory_type_index) / 2) {
+        dedicated = true;
+    }
+
+    if (dedicated) {
+        VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocate_info.allocationSize = requirements->size;
+        allocate_info.memoryTypeIndex = memory_type_index;
+        VkResult result = vkAllocateMemory(context->device.logical_device, &allocate_info, context->allocator, &out_allocation->memory);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to allocate dedicated memory of %lluB: %s", requirements->size, vulkan_result_string(result, true));
+            return false;
+        }
+        if (name) {
+            VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_DEVICE_MEMORY, out_allocation->memory, name);
+        }
+        out_allocation->offset = 0;
+        out_allocation->size = requirements->size;
+        out_allocation->block_index = INVALID_ID;
+
+        kmutex_lock(&allocator->lock);
+        allocator->dedicated_count++;
+        allocator->dedicated_bytes += requirements->size;
+        out_allocation->heap_index = heap_index_get(context, memory_type_index);
+        allocator->heap_bytes[out_allocation->heap_index] += requirements->size;
+        stats_report(allocator);
+        kmutex_unlock(&allocator->lock);
+        return true;
+    }
+
+    kmutex_lock(&allocator->lock);
+
+    // Try each existing block of the right kind first.
+    b8 allocated = false;
+    u32 block_count = darray_length(allocator->blocks);
+    for (u32 i = 0; i < block_count; ++i) {
+        vulkan_memory_block* block = &allocator->blocks[i];
+        if (block->memory && block->memory_type_index == memory_type_index && block->is_linear == is_linear) {
+            if (block_try_allocate(block, requirements, out_allocation)) {
+                out_allocation->block_index = i;
+                allocated = true;
+                break;
+            }
+        }
+    }
+
+    // Otherwise create a new block.
+    if (!allocated) {
+        u32 block_index = INVALID_ID;
+        if (!block_create(context, memory_type_index, is_linear, &block_index)) {
+            kmutex_unlock(&allocator->lock);
+            return false;
+        }
+        if (!block_try_allocate(&allocator->blocks[block_index], requirements, out_allocation)) {
+            KERROR("Failed to allocate %lluB from a new memory block.", requirements->size);
+            kmutex_unlock(&allocator->lock);
+            return false;
+        }
+        out_allocation->block_index = block_index;
+    }
+    out_allocation->heap_index = heap_index_get(context, memory_type_index);
+
+    allocator->block_allocation_count++;
+    allocator->block_used_bytes += out_allocation->reserved_size;
+    stats_report(allocator);
+    kmutex_unlock(&allocator->lock);
+    return true;
+}
+
+void vulkan_memory_free(vulkan_context* context, vulkan_memory_allocation* allocation) {
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    if (!allocation || !allocation->memory) {
+        return;
+    }
+
+    kmutex_lock(&allocator->lock);
+    if (allocation->block_index == INVALID_ID) {
+        vkFreeMemory(context->device.logical_device, allocation->memory, context->allocator);
+        allocator->dedicated_count--;
+        allocator->dedicated_bytes -= allocation->size;
+        allocator->heap_bytes[allocation->heap_index] -= allocation->size;
+    } else {
+        vulkan_memory_block* block = &allocator->blocks[allocation->block_index];
+        if (!freelist_free_block(&block->free_list, allocation->reserved_size, allocation->reserved_offset)) {
+            KERROR("Failed to free range of memory block %u. Corruption possible?", allocation->block_index);
+        }
+        block->used -= allocation->reserved_size;
+        block->allocation_count--;
+        allocator->block_allocation_count--;
+        allocator->block_used_bytes -= allocation->reserved_size;
+
+        // Keep one empty block of each kind around, so streaming resources in and out doesn't
+        // keep allocating and freeing whole blocks. Any other empty block is released.
+        if (block->allocation_count == 0) {
+            u32 block_count = darray_length(allocator->blocks);
+            for (u32 i = 0; i < block_count; ++i) {
+                vulkan_memory_block* other = &allocator->blocks[i];
+                if (i != allocation->block_index && other->memory && other->allocation_count == 0 &&
+                    other->memory_type_index == block->memory_type_index && other->is_linear == block->is_linear) {
+                    block_destroy(context, allocation->block_index);
+                    break;
+                }
+            }
+        }
+    }
+    stats_report(allocator);
+    kmutex_unlock(&allocator->lock);
+
+    kzero_memory(allocation, sizeof(vulkan_memory_allocation));
+}
+
+void* vulkan_memory_map(vulkan_context* context, const vulkan_memory_allocation* allocation, u64 offset, u64 size) {
+    if (!allocation || !allocation->memory) {
+        return 0;
+    }
+
+    if (allocation->block_index == INVALID_ID) {
+        void* data = 0;
+        VkResult result = vkMapMemory(context->device.logical_device, allocation->memory, offset, size, 0, &data);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to map memory: %s", vulkan_result_string(result, true));
+            return 0;
+        }
+        return data;
+    }
+
+    vulkan_memory_block* block = &context->memory_allocator.blocks[allocation->block_index];
+    if (!block->mapped) {
+        KERROR("vulkan_memory_map called on an allocation which is not host visible.");
+        return 0;
+    }
+    return (u8*)block->mapped + allocation->offset + offset;
+}
+
+void vulkan_memory_unmap(vulkan_context* context, const vulkan_memory_allocation* allocation) {
+    // NOTE: Blocks stay mapped for their whole lifetime.
+    if (allocation && allocation->memory && allocation->block_index == INVALID_ID) {
+        vkUnmapMemory(context->device.logical_device, allocation->memory);
+    }
+}
+
+void vulkan_memory_budget_report(vulkan_context* context) {
+    const VkPhysicalDeviceMemoryProperties* memory = &context->device.memory;
+    metrics_gpu_heap heaps[METRICS_MAX_GPU_HEAPS];
+    u32 heap_count = KMIN(memory->memoryHeapCount, METRICS_MAX_GPU_HEAPS);
+
+    b8 driver_reported = (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_MEMORY_BUDGET_BIT) != 0;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    if (driver_reported) {
+        VkPhysicalDeviceMemoryProperties2 properties2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+        properties2.pNext = &budget_properties;
+        vkGetPhysicalDeviceMemoryProperties2(context->device.physical_device, &properties2);
+    }
+
+    vulkan_memory_allocator* allocator = &context->memory_allocator;
+    kmutex_lock(&allocator->lock);
+    for (u32 i = 0; i < heap_count; ++i) {
+        metrics_gpu_heap* heap = &heaps[i];
+        heap->size = memory->memoryHeaps[i].size;
+        heap->device_local = (memory->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap->driver_reported = driver_reported;
+        if (driver_reported) {
+            heap->budget = budget_properties.heapBudget[i];
+            heap->usage = budget_properties.heapUsage[i];
+        } else {
+            heap->budget = (u64)(heap->size * VULKAN_MEMORY_ESTIMATED_BUDGET_FRACTION);
+            heap->usage = allocator->heap_bytes[i];
+        }
+    }
+    kmutex_unlock(&allocator->lock);
+
+    metrics_gpu_heaps_set(heaps, heap_count);
+}
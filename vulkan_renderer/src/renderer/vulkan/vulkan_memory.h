@@ -0,0 +1,84 @@
+/**
+ * @file vulkan_memory.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief The device memory allocator used for all Vulkan images and buffers. Resources
+ * are sub-allocated from large blocks per memory type, which keeps the number of device
+ * allocations (and their cost) low. Large resources and render targets get dedicated
+ * allocations instead.
+ * @version 1.0
+ * @date 2023-11-20
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the memory allocator for the given context. Must be called after the device is created.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_memory_allocator_create(vulkan_context* context);
+
+/**
+ * @brief Destroys the memory allocator for the given context, freeing all blocks. Any
+ * allocations still live at this point are reported as leaks.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_memory_allocator_destroy(vulkan_context* context);
+
+/**
+ * @brief Allocates device memory meeting the given requirements.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param requirements A constant pointer to the memory requirements of the resource.
+ * @param memory_type_index The memory type to allocate from.
+ * @param is_linear True for buffers (and linearly-tiled images); false for optimally-tiled images.
+ * @param dedicated Forces a dedicated allocation, i.e. for render targets which are recreated on resize.
+ * @param name The name of the resource, used for debugging if a dedicated allocation is made. Optional.
+ * @param out_allocation A pointer to hold the allocation.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_memory_allocate(vulkan_context* context, const VkMemoryRequirements* requirements, u32 memory_type_index, b8 is_linear, b8 dedicated, const char* name, vulkan_memory_allocation* out_allocation);
+
+/**
+ * @brief Frees the given allocation. The resource using it should already be destroyed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocation A pointer to the allocation to be freed. Is zeroed.
+ */
+void vulkan_memory_free(vulkan_context* context, vulkan_memory_allocation* allocation);
+
+/**
+ * @brief Maps a range of the given host-visible allocation. Sub-allocations share their block's
+ * persistent mapping, so must not be mapped via vkMapMemory directly.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocation A constant pointer to the allocation.
+ * @param offset The offset in bytes from the beginning of the allocation.
+ * @param size The size of the range to map.
+ * @return A pointer to the mapped range, or 0 on failure.
+ */
+void* vulkan_memory_map(vulkan_context* context, const vulkan_memory_allocation* allocation, u64 offset, u64 size);
+
+/**
+ * @brief Unmaps the given allocation, previously mapped with vulkan_memory_map.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param allocation A constant pointer to the allocation.
+ */
+void vulkan_memory_unmap(vulkan_context* context, const vulkan_memory_allocation* allocation);
+
+/**
+ * @brief Reports the budget and usage of each memory heap to the metrics system. These come from the
+ * driver where VK_EXT_memory_budget is supported. Otherwise usage is what this allocator has allocated
+ * from each heap, and the budget is estimated from the heap size.
+ *
+ * @param context A pointer to the renderer context.
+ */
+void vulkan_memory_budget_report(vulkan_context* context);
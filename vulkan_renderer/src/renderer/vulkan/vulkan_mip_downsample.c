@@ -0,0 +1,355 @@
+#include "vulkan_mip_downsample.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "renderer/renderer_frontend.h"
+#include "systems/resource_system.h"
+#include "vulkan_descriptor_allocator.h"
+#include "vulkan_pipeline.h"
+#include "vulkan_utils.h"
+
+#include <shaderc/shaderc.h>
+
+// NOTE: Must match the push constants of the downsample shader.
+typedef struct mip_downsample_push_constants {
+    u32 width;
+    u32 height;
+    u32 mip_count;
+    u32 filter_mode;
+    u32 group_count;
+    u32 counter_offset;
+} mip_downsample_push_constants;
+
+// Compiled at runtime, as the stages of frontend shaders are.
+#define MIP_DOWNSAMPLE_SHADER_FILE "shaders/Shader.MipDownsample.comp.glsl"
+// The base level, and each level generated from it.
+#define MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT (VULKAN_MIP_DOWNSAMPLE_MAX_LEVELS + 1)
+// Each workgroup reduces a square tile of the base level this many texels across.
+#define MIP_DOWNSAMPLE_TILE_SIZE 64
+// The last workgroup reduces what is left in a single tile, which bounds the size of the base level.
+#define MIP_DOWNSAMPLE_MAX_SIZE (MIP_DOWNSAMPLE_TILE_SIZE * MIP_DOWNSAMPLE_TILE_SIZE)
+// The number of sets the first descriptor pool of each upload batch holds.
+#define MIP_DOWNSAMPLE_BATCH_SET_COUNT 16
+
+static b8 shader_module_create(vulkan_context* context, VkShaderModule* out_module) {
+    resource text_resource;
+    if (!resource_system_load(MIP_DOWNSAMPLE_SHADER_FILE, RESOURCE_TYPE_TEXT, 0, &text_resource)) {
+        KERROR("Unable to read shader file: %s.", MIP_DOWNSAMPLE_SHADER_FILE);
+        return false;
+    }
+
+    shaderc_compilation_result_t compilation_result = shaderc_compile_into_spv(
+        context->shader_compiler,
+        (const char*)text_resource.data,
+        text_resource.data_size,
+        shaderc_glsl_default_compute_shader,
+        MIP_DOWNSAMPLE_SHADER_FILE,
+        "main",
+        0);
+    resource_system_unload(&text_resource);
+
+    if (!compilation_result) {
+        KERROR("An unknown error occurred while trying to compile the mip downsample shader.");
+        return false;
+    }
+    if (shaderc_result_get_compilation_status(compilation_result) != shaderc_compilation_status_success) {
+        KERROR("Error compiling the mip downsample shader:\n%s", shaderc_result_get_error_message(compilation_result));
+        shaderc_result_release(compilation_result);
+        return false;
+    }
+
+    // Take a copy of the result, since Vulkan requires the code to be u32-aligned.
+    u64 code_size = shaderc_result_get_length(compilation_result);
+    u32* code = kallocate(code_size, MEMORY_TAG_RENDERER);
+    kcopy_memory(code, shaderc_result_get_bytes(compilation_result), code_size);
+    shaderc_result_release(compilation_result);
+
+    VkShaderModuleCreateInfo create_info = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    create_info.codeSize = code_size;
+    create_info.pCode = code;
+    VkResult result = vkCreateShaderModule(context->device.logical_device, &create_info, context->allocator, out_module);
+    kfree(code, code_size, MEMORY_TAG_RENDERER);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to create the mip downsample shader module: '%s'", vulkan_result_string(result, true));
+        return false;
+    }
+    return true;
+}
+
+// Destroys whatever of the downsampler has been created, leaving its state flags alone.
+static void downsampler_release(vulkan_context* context) {
+    vulkan_mip_downsampler* downsampler = &context->mip_downsampler;
+    vulkan_pipeline_destroy(context, &downsampler->pipeline);
+    if (downsampler->set_layout) {
+        vkDestroyDescriptorSetLayout(context->device.logical_device, downsampler->set_layout, context->allocator);
+        downsampler->set_layout = 0;
+    }
+    if (downsampler->counters.internal_data) {
+        renderer_renderbuffer_destroy(&downsampler->counters);
+    }
+}
+
+static b8 downsampler_create(vulkan_context* context) {
+    vulkan_mip_downsampler* downsampler = &context->mip_downsampler;
+    VkDevice device = context->device.logical_device;
+
+    VkShaderModule module;
+    if (!shader_module_create(context, &module)) {
+        return false;
+    }
+
+    // Each level is a storage image of its own, followed by the counters.
+    VkDescriptorSetLayoutBinding bindings[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT + 1] = {0};
+    for (u32 i = 0; i < MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT + 1; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layout_info.bindingCount = MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT + 1;
+    layout_info.pBindings = bindings;
+    VkResult result = vkCreateDescriptorSetLayout(device, &layout_info, context->allocator, &downsampler->set_layout);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Failed to create the mip downsample descriptor set layout: '%s'", vulkan_result_string(result, true));
+        vkDestroyShaderModule(device, module, context->allocator);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stage.module = module;
+    stage.pName = "main";
+
+    range push_constant_range = {0, sizeof(mip_downsample_push_constants)};
+
+    vulkan_pipeline_config config = {0};
+    config.name = "mip_downsample";
+    config.stage_count = 1;
+    config.stages = &stage;
+    config.descriptor_set_layout_count = 1;
+    config.descriptor_set_layouts = &downsampler->set_layout;
+    config.push_constant_range_count = 1;
+    config.push_constant_ranges = &push_constant_range;
+    b8 pipeline_created = vulkan_compute_pipeline_create(context, &config, &downsampler->pipeline);
+
+    // The module is no longer needed either way once the pipeline has been created.
+    vkDestroyShaderModule(device, module, context->allocator);
+    if (!pipeline_created) {
+        KERROR("Failed to create the mip downsample pipeline.");
+        downsampler_release(context);
+        return false;
+    }
+
+    // Each upload batch has counters of its own, so batches in flight on different queues don't share them.
+    u64 counters_size = sizeof(u32) * VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS * VULKAN_UPLOAD_BATCH_COUNT;
+    if (!renderer_renderbuffer_create("mip_downsample_counters", RENDERBUFFER_TYPE_STORAGE, counters_size, RENDERBUFFER_TRACK_TYPE_NONE, &downsampler->counters)) {
+        KERROR("Failed to create the mip downsample counters buffer.");
+        downsampler_release(context);
+        return false;
+    }
+    renderer_renderbuffer_bind(&downsampler->counters, 0);
+
+    KDEBUG("Compute mip downsampler created.");
+    return true;
+}
+
+b8 vulkan_mip_downsample_supported(vulkan_context* context, VkFormat format, u32 width, u32 height, u32 mip_levels, u16 layer_count) {
+    // The shader reads and writes RGBA8 texels.
+    if (format != VK_FORMAT_R8G8B8A8_UNORM || mip_levels <= 1) {
+        return false;
+    }
+    if (width > MIP_DOWNSAMPLE_MAX_SIZE || height > MIP_DOWNSAMPLE_MAX_SIZE || mip_levels > MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT) {
+        return false;
+    }
+    if (layer_count < 1 || layer_count > VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS) {
+        return false;
+    }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context->device.physical_device, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+b8 vulkan_mip_downsample_ready(vulkan_context* context, const vulkan_image* image) {
+    if (!(image->usage & VK_IMAGE_USAGE_STORAGE_BIT) ||
+        !vulkan_mip_downsample_supported(context, image->format, image->width, image->height, image->mip_levels, image->layer_count)) {
+        return false;
+    }
+
+    vulkan_mip_downsampler* downsampler = &context->mip_downsampler;
+    if (!downsampler->is_created) {
+        // The shader can't be compiled until the backend has finished initializing.
+        if (!context->shader_compiler) {
+            return false;
+        }
+        downsampler->is_created = true;
+        downsampler->is_available = downsampler_create(context);
+        if (!downsampler->is_available) {
+            KWARN("Compute mip generation is unavailable. Mips will be generated by blitting instead.");
+        }
+    }
+    return downsampler->is_available;
+}
+
+b8 vulkan_mip_downsample_record(vulkan_context* context, vulkan_image* image, vulkan_upload_batch* batch, vulkan_command_buffer* command_buffer) {
+    vulkan_mip_downsampler* downsampler = &context->mip_downsampler;
+    VkDevice device = context->device.logical_device;
+
+    // The set belongs to the batch, so lives for as long as the work recorded into it.
+    if (!batch->mip_descriptors.pools) {
+        VkDescriptorPoolSize pool_sizes[2] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MIP_DOWNSAMPLE_BATCH_SET_COUNT * MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MIP_DOWNSAMPLE_BATCH_SET_COUNT}};
+        if (!vulkan_descriptor_allocator_create(context, 2, pool_sizes, MIP_DOWNSAMPLE_BATCH_SET_COUNT, 0, &batch->mip_descriptors)) {
+            KERROR("Failed to create the descriptor pools for compute mip generation.");
+            return false;
+        }
+    }
+    VkDescriptorSet set;
+    if (!vulkan_descriptor_allocator_allocate(context, &batch->mip_descriptors, 1, &downsampler->set_layout, &set, 0)) {
+        return false;
+    }
+
+    // Storage images are bound a single level at a time, so each level needs a view of its own.
+    if (!batch->mip_views) {
+        batch->mip_views = darray_create(VkImageView);
+    }
+    VkImageView views[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT];
+    for (u32 i = 0; i < image->mip_levels; ++i) {
+        VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        view_info.image = image->handle;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        view_info.format = image->format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel = i;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = image->layer_count;
+        VkResult result = vkCreateImageView(device, &view_info, context->allocator, &views[i]);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to create a mip level view of image '%s': '%s'", image->name, vulkan_result_string(result, true));
+            return false;
+        }
+        darray_push(batch->mip_views, views[i]);
+    }
+    // Bindings past the last level are never accessed, but must still hold a valid view.
+    for (u32 i = image->mip_levels; i < MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT; ++i) {
+        views[i] = views[image->mip_levels - 1];
+    }
+
+    u32 batch_index = (u32)(batch - context->upload.batches);
+    VkBuffer counters = ((vulkan_buffer*)downsampler->counters.internal_data)->handle;
+    u64 counter_offset = sizeof(u32) * VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS * batch_index;
+    u64 counter_size = sizeof(u32) * image->layer_count;
+
+    VkDescriptorImageInfo image_infos[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT];
+    VkWriteDescriptorSet writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT + 1] = {0};
+    for (u32 i = 0; i < MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT; ++i) {
+        image_infos[i].sampler = 0;
+        image_infos[i].imageView = views[i];
+        image_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[i].descriptorCount = 1;
+        writes[i].pImageInfo = &image_infos[i];
+    }
+    VkDescriptorBufferInfo counter_info;
+    counter_info.buffer = counters;
+    counter_info.offset = 0;
+    counter_info.range = VK_WHOLE_SIZE;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].dstSet = set;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].dstBinding = MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].descriptorCount = 1;
+    writes[MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT].pBufferInfo = &counter_info;
+    vkUpdateDescriptorSets(device, MIP_DOWNSAMPLE_IMAGE_BINDING_COUNT + 1, writes, 0, 0);
+
+    VkCommandBuffer handle = command_buffer->handle;
+
+    // Zero the counters, once the last dispatch of this batch which used them is done.
+    VkBufferMemoryBarrier counter_barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    counter_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    counter_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    counter_barrier.buffer = counters;
+    counter_barrier.offset = counter_offset;
+    counter_barrier.size = counter_size;
+    counter_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    counter_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &counter_barrier, 0, 0);
+    vkCmdFillBuffer(handle, counters, counter_offset, counter_size, 0);
+
+    // Then make them and every level of the image available to the shader.
+    counter_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    counter_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkImageMemoryBarrier image_barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    image_barrier.image = image->handle;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_barrier.subresourceRange.baseMipLevel = 0;
+    image_barrier.subresourceRange.levelCount = image->mip_levels;
+    image_barrier.subresourceRange.baseArrayLayer = 0;
+    image_barrier.subresourceRange.layerCount = image->layer_count;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &counter_barrier, 1, &image_barrier);
+
+    u32 group_count_x = (image->width + MIP_DOWNSAMPLE_TILE_SIZE - 1) / MIP_DOWNSAMPLE_TILE_SIZE;
+    u32 group_count_y = (image->height + MIP_DOWNSAMPLE_TILE_SIZE - 1) / MIP_DOWNSAMPLE_TILE_SIZE;
+    mip_downsample_push_constants push_constants;
+    push_constants.width = image->width;
+    push_constants.height = image->height;
+    push_constants.mip_count = image->mip_levels - 1;
+    push_constants.filter_mode = (u32)image->mip_filter;
+    push_constants.group_count = group_count_x * group_count_y;
+    push_constants.counter_offset = VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS * batch_index;
+
+    vkCmdBindPipeline(handle, VK_PIPELINE_BIND_POINT_COMPUTE, downsampler->pipeline.handle);
+    vkCmdBindDescriptorSets(handle, VK_PIPELINE_BIND_POINT_COMPUTE, downsampler->pipeline.pipeline_layout, 0, 1, &set, 0, 0);
+    vkCmdPushConstants(handle, downsampler->pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(mip_downsample_push_constants), &push_constants);
+    vkCmdDispatch(handle, group_count_x, group_count_y, image->layer_count);
+
+    // Finally, make every level shader-readable at once.
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &image_barrier);
+
+    return true;
+}
+
+void vulkan_mip_downsample_batch_release(vulkan_context* context, vulkan_upload_batch* batch, b8 destroy) {
+    if (batch->mip_views) {
+        u32 view_count = darray_length(batch->mip_views);
+        for (u32 i = 0; i < view_count; ++i) {
+            vkDestroyImageView(context->device.logical_device, batch->mip_views[i], context->allocator);
+        }
+        if (destroy) {
+            darray_destroy(batch->mip_views);
+            batch->mip_views = 0;
+        } else {
+            darray_clear(batch->mip_views);
+        }
+    }
+
+    if (destroy) {
+        vulkan_descriptor_allocator_destroy(context, &batch->mip_descriptors);
+    } else {
+        vulkan_descriptor_allocator_reset(context, &batch->mip_descriptors);
+    }
+}
+
+void vulkan_mip_downsample_destroy(vulkan_context* context) {
+    downsampler_release(context);
+    kzero_memory(&context->mip_downsampler, sizeof(vulkan_mip_downsampler));
+}
@@ -0,0 +1,70 @@
+/**
+ * @file vulkan_mip_downsample.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Generates every mip level of an uploaded image with a single compute dispatch, filtered
+ * to suit what the image holds, in place of a chain of blits.
+ * @version 1.0
+ * @date 2024-01-06
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2024
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Indicates if images of the given format and size can have their mips generated by
+ * compute. Such images must be created with VK_IMAGE_USAGE_STORAGE_BIT to make use of it.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param format The format of the image.
+ * @param width The width of the base level.
+ * @param height The height of the base level.
+ * @param mip_levels The number of mip levels, including the base level.
+ * @param layer_count The number of layers.
+ * @return True if supported; otherwise false.
+ */
+b8 vulkan_mip_downsample_supported(vulkan_context* context, VkFormat format, u32 width, u32 height, u32 mip_levels, u16 layer_count);
+
+/**
+ * @brief Indicates if mips will be generated for the given image by compute, creating the
+ * downsampler on first use. If not, they should be blitted.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the image.
+ * @return True if vulkan_mip_downsample_record may be used for the image; otherwise false.
+ */
+b8 vulkan_mip_downsample_ready(vulkan_context* context, const vulkan_image* image);
+
+/**
+ * @brief Records the generation of all mip levels of the given image from its base level. As with
+ * vulkan_image_mipmaps_generate, every level must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, and
+ * all are left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. The views and descriptor set used are
+ * owned by the upload batch, and released once it retires.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the image, for which vulkan_mip_downsample_ready returned true.
+ * @param batch A pointer to the upload batch the work belongs to.
+ * @param command_buffer A pointer to the command buffer to record to. Must belong to a queue of the graphics family.
+ * @return True on success. If false, nothing was recorded and the mips should be blitted instead.
+ */
+b8 vulkan_mip_downsample_record(vulkan_context* context, vulkan_image* image, vulkan_upload_batch* batch, vulkan_command_buffer* command_buffer);
+
+/**
+ * @brief Releases the views and descriptor sets the given upload batch used for mip generation.
+ * The batch must have finished executing.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param batch A pointer to the upload batch.
+ * @param destroy Indicates if the batch's descriptor pools should be destroyed rather than kept for reuse.
+ */
+void vulkan_mip_downsample_batch_release(vulkan_context* context, vulkan_upload_batch* batch, b8 destroy);
+
+/**
+ * @brief Destroys the downsampler, if it was created. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_mip_downsample_destroy(vulkan_context* context);
@@ -0,0 +1,102 @@
+#include "vulkan_occlusion_query.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "vulkan_utils.h"
+
+b8 vulkan_occlusion_queries_create(vulkan_context* context) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    queries->open_query = INVALID_ID;
+
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkQueryPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        pool_info.queryType = VK_QUERY_TYPE_OCCLUSION;
+        pool_info.queryCount = RENDERER_MAX_OCCLUSION_QUERIES;
+        VkResult result = vkCreateQueryPool(context->device.logical_device, &pool_info, context->allocator, &queries->pools[i]);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Failed to create occlusion query pool: '%s'", vulkan_result_string(result, true));
+            return false;
+        }
+    }
+    return true;
+}
+
+void vulkan_occlusion_queries_destroy(vulkan_context* context) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    for (u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (queries->pools[i]) {
+            vkDestroyQueryPool(context->device.logical_device, queries->pools[i], context->allocator);
+            queries->pools[i] = 0;
+        }
+    }
+    kzero_memory(queries, sizeof(vulkan_occlusion_queries));
+}
+
+void vulkan_occlusion_queries_frame_begin(vulkan_context* context, VkCommandBuffer command_buffer, u64 frame_number) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    u32 frame = context->current_frame;
+    if (!queries->pools[frame]) {
+        return;
+    }
+
+    vkCmdResetQueryPool(command_buffer, queries->pools[frame], 0, RENDERER_MAX_OCCLUSION_QUERIES);
+    queries->counts[frame] = 0;
+    queries->frame_numbers[frame] = frame_number;
+    queries->open_query = INVALID_ID;
+}
+
+b8 vulkan_occlusion_query_begin(vulkan_context* context, VkCommandBuffer command_buffer, u32 query_index) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    u32 frame = context->current_frame;
+    if (!queries->pools[frame] || query_index >= RENDERER_MAX_OCCLUSION_QUERIES) {
+        return false;
+    }
+    if (queries->open_query != INVALID_ID) {
+        KWARN("vulkan_occlusion_query_begin - A query is already open. Ignoring nested query.");
+        return false;
+    }
+
+    // Not precise, as only whether any sample passed is needed, which is cheaper on some hardware.
+    vkCmdBeginQuery(command_buffer, queries->pools[frame], query_index, 0);
+    queries->counts[frame] = KMAX(queries->counts[frame], query_index + 1);
+    queries->open_query = query_index;
+    return true;
+}
+
+void vulkan_occlusion_query_end(vulkan_context* context, VkCommandBuffer command_buffer) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    if (queries->open_query == INVALID_ID) {
+        return;
+    }
+
+    vkCmdEndQuery(command_buffer, queries->pools[context->current_frame], queries->open_query);
+    queries->open_query = INVALID_ID;
+}
+
+void vulkan_occlusion_queries_resolve(vulkan_context* context, u32 frame_index) {
+    vulkan_occlusion_queries* queries = &context->occlusion_queries;
+    u32 count = queries->counts[frame_index];
+    // Frames which were never submitted have nothing to read back, and their queries were never reset.
+    if (!queries->pools[frame_index] || !count || !context->in_flight_submitted[frame_index]) {
+        return;
+    }
+
+    // The sample count of each query, followed by whether it is available. Indices skipped in the
+    // frame are never made available, and are treated as visible so their draws aren't skipped.
+    u64 data[RENDERER_MAX_OCCLUSION_QUERIES * 2];
+    VkResult result = vkGetQueryPoolResults(
+        context->device.logical_device, queries->pools[frame_index], 0, count, sizeof(u64) * 2 * count, data,
+        sizeof(u64) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        KWARN("Failed to read back occlusion queries: '%s'", vulkan_result_string(result, true));
+        return;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        queries->results[i] = (data[i * 2 + 1] == 0 || data[i * 2] > 0) ? 1 : 0;
+    }
+    queries->result_count = count;
+    queries->result_frame_number = queries->frame_numbers[frame_index];
+    // Read back once only, should the frame be waited on again before it is reused.
+    queries->counts[frame_index] = 0;
+}
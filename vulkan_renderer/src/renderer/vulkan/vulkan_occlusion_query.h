@@ -0,0 +1,67 @@
+/**
+ * @file vulkan_occlusion_query.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Occlusion queries written into per-frame query pools, which are read back once a frame
+ * has completed so the frontend can skip what was hidden in the frames which follow.
+ * @version 1.0
+ * @date 2023-12-30
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the query pools used for occlusion queries.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_occlusion_queries_create(vulkan_context* context);
+
+/**
+ * @brief Destroys the query pools used for occlusion queries. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_occlusion_queries_destroy(vulkan_context* context);
+
+/**
+ * @brief Resets the queries of the current frame. Must be recorded outside of a renderpass,
+ * before any queries of the frame.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The primary command buffer of the current frame.
+ * @param frame_number The renderer frame number of the current frame, which its results are returned with.
+ */
+void vulkan_occlusion_queries_frame_begin(vulkan_context* context, VkCommandBuffer command_buffer, u64 frame_number);
+
+/**
+ * @brief Begins an occlusion query. Must be recorded inside a renderpass.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The command buffer the renderpass is being recorded into.
+ * @param query_index The index of the query, which must not have been used yet this frame.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_occlusion_query_begin(vulkan_context* context, VkCommandBuffer command_buffer, u32 query_index);
+
+/**
+ * @brief Ends the open occlusion query, if any. Must be recorded in the same renderpass it was begun in.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param command_buffer The command buffer the renderpass is being recorded into.
+ */
+void vulkan_occlusion_query_end(vulkan_context* context, VkCommandBuffer command_buffer);
+
+/**
+ * @brief Reads back the results of the given frame in flight, which must have completed, keeping
+ * them as the latest results if it issued any queries.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ */
+void vulkan_occlusion_queries_resolve(vulkan_context* context, u32 frame_index);
@@ -7,6 +7,7 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "math/math_types.h"
+#include "platform/filesystem.h"
 #include "renderer/renderer_types.h"
 #include "renderer/vulkan/vulkan_types.h"
 #include "resources/resource_types.h"
@@ -77,7 +78,8 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
     VkPipelineDepthStencilStateCreateInfo depth_stencil = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
     if (config->shader_flags & SHADER_FLAG_DEPTH_TEST) {
         depth_stencil.depthTestEnable = VK_TRUE;
-        if (config->shader_flags & SHADER_FLAG_DEPTH_WRITE) {
+        // Weighted blended geometry is not sorted, so it must not occlude itself.
+        if ((config->shader_flags & SHADER_FLAG_DEPTH_WRITE) && !(config->shader_flags & SHADER_FLAG_BLEND_WEIGHTED)) {
             depth_stencil.depthWriteEnable = VK_TRUE;
         }
         depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
@@ -107,7 +109,7 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
     kzero_memory(&color_blend_attachment_state, sizeof(VkPipelineColorBlendAttachmentState));
     color_blend_attachment_state.blendEnable = VK_TRUE;
     color_blend_attachment_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    color_blend_attachment_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment_state.dstColorBlendFactor = (config->shader_flags & SHADER_FLAG_BLEND_ADDITIVE) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     color_blend_attachment_state.colorBlendOp = VK_BLEND_OP_ADD;
     color_blend_attachment_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
     color_blend_attachment_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
@@ -115,12 +117,49 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
 
     color_blend_attachment_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                                                   VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (config->shader_flags & SHADER_FLAG_COLOUR_WRITE_DISABLED) {
+        color_blend_attachment_state.colorWriteMask = 0;
+    }
 
     VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
     color_blend_state_create_info.logicOpEnable = VK_FALSE;
     color_blend_state_create_info.logicOp = VK_LOGIC_OP_COPY;
     color_blend_state_create_info.attachmentCount = 1;
     color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
+    // Without a renderpass object, or with several colour attachments, the blend states must match
+    // the colour attachments exactly.
+    VkPipelineColorBlendAttachmentState color_blend_attachment_states[VULKAN_MAX_COLOUR_ATTACHMENTS];
+    u32 colour_attachment_count = KMIN(config->renderpass->colour_attachment_count, VULKAN_MAX_COLOUR_ATTACHMENTS);
+    if (config->renderpass->dynamic || colour_attachment_count > 1) {
+        b8 weighted = (config->shader_flags & SHADER_FLAG_BLEND_WEIGHTED) != 0;
+        for (u32 i = 0; i < colour_attachment_count; ++i) {
+            VkPipelineColorBlendAttachmentState* state = &color_blend_attachment_states[i];
+            *state = color_blend_attachment_state;
+            if (weighted) {
+                // Weighted blended transparency accumulates premultiplied, weighted colour into the
+                // second attachment and coverage into the third, leaving the first to be composited.
+                if (i == 1) {
+                    state->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                    state->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                    state->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                    state->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                } else if (i == 2) {
+                    // Stores 1 - the product of (1 - alpha), so it can be cleared to zero.
+                    state->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                    state->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+                    state->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                    state->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+                } else {
+                    state->colorWriteMask = 0;
+                }
+            } else if (i > 0 && context->device.features.independentBlend) {
+                // Other shaders only write the first attachment.
+                state->colorWriteMask = 0;
+            }
+        }
+        color_blend_state_create_info.attachmentCount = colour_attachment_count;
+        color_blend_state_create_info.pAttachments = colour_attachment_count ? color_blend_attachment_states : 0;
+    }
 
     // Dynamic state
     VkDynamicState* dynamic_states = darray_create(VkDynamicState);
@@ -135,25 +174,34 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
         darray_push(dynamic_states, VK_DYNAMIC_STATE_STENCIL_WRITE_MASK);
         darray_push(dynamic_states, VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK);
         darray_push(dynamic_states, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE);
+        darray_push(dynamic_states, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP);
         darray_push(dynamic_states, VK_DYNAMIC_STATE_STENCIL_REFERENCE);
         /* darray_push(dynamic_states, VK_DYNAMIC_STATE_COLOR_WRITE_ENABLE_EXT);
         darray_push(dynamic_states, VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT); */
     }
+    // Per-draw fragment shading rate, if supported.
+    if (context->device.support_flags & VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT) {
+        darray_push(dynamic_states, VK_DYNAMIC_STATE_FRAGMENT_SHADING_RATE_KHR);
+    }
 
     VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
     dynamic_state_create_info.dynamicStateCount = darray_length(dynamic_states);
     dynamic_state_create_info.pDynamicStates = dynamic_states;
 
     // Vertex input
-    VkVertexInputBindingDescription binding_description;
-    binding_description.binding = 0;  // Binding index
-    binding_description.stride = config->stride;
-    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // Move to next data entry for each vertex.
+    VkVertexInputBindingDescription binding_descriptions[2];
+    binding_descriptions[0].binding = 0;  // Binding index
+    binding_descriptions[0].stride = config->stride;
+    binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // Move to next data entry for each vertex.
+    // Per-instance data, if used.
+    binding_descriptions[1].binding = 1;
+    binding_descriptions[1].stride = config->instance_stride;
+    binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;  // Move to next data entry for each instance.
 
     // Attributes
     VkPipelineVertexInputStateCreateInfo vertex_input_info = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexBindingDescriptionCount = config->instance_stride > 0 ? 2 : 1;
+    vertex_input_info.pVertexBindingDescriptions = binding_descriptions;
     vertex_input_info.vertexAttributeDescriptionCount = config->attribute_count;
     vertex_input_info.pVertexAttributeDescriptions = config->attributes;
 
@@ -252,12 +300,32 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
 
     pipeline_create_info.renderPass = config->renderpass->handle;
     pipeline_create_info.subpass = 0;
+
+    // Without a renderpass object, the formats of the attachments rendered to are given directly.
+    VkPipelineRenderingCreateInfoKHR rendering_create_info = {VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR};
+    VkFormat colour_formats[VULKAN_MAX_COLOUR_ATTACHMENTS];
+    if (config->renderpass->dynamic) {
+        const vulkan_renderpass* pass = config->renderpass;
+        for (u32 i = 0; i < pass->colour_attachment_count; ++i) {
+            colour_formats[i] = pass->colour_attachments[i].format;
+        }
+        rendering_create_info.viewMask = pass->view_count > 1 ? (1u << pass->view_count) - 1 : 0;
+        rendering_create_info.colorAttachmentCount = pass->colour_attachment_count;
+        rendering_create_info.pColorAttachmentFormats = pass->colour_attachment_count ? colour_formats : 0;
+        if (pass->has_depth_attachment) {
+            VkFormat depth_format = pass->depth_attachment.format;
+            rendering_create_info.depthAttachmentFormat = depth_format;
+            b8 has_stencil = depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT || depth_format == VK_FORMAT_D16_UNORM_S8_UINT;
+            rendering_create_info.stencilAttachmentFormat = has_stencil ? depth_format : VK_FORMAT_UNDEFINED;
+        }
+        pipeline_create_info.pNext = &rendering_create_info;
+    }
     pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_create_info.basePipelineIndex = -1;
 
     VkResult result = vkCreateGraphicsPipelines(
         context->device.logical_device,
-        VK_NULL_HANDLE,
+        context->pipeline_cache,
         1,
         &pipeline_create_info,
         context->allocator,
@@ -279,6 +347,79 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
     return false;
 }
 
+b8 vulkan_compute_pipeline_create(vulkan_context* context, const vulkan_pipeline_config* config, vulkan_pipeline* out_pipeline) {
+    if (config->stage_count != 1) {
+        KERROR("vulkan_compute_pipeline_create: a compute pipeline requires exactly one stage. Passed count: %u", config->stage_count);
+        return false;
+    }
+
+    // Pipeline layout
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+
+    // Push constants
+    VkPushConstantRange ranges[32];
+    if (config->push_constant_range_count > 0) {
+        if (config->push_constant_range_count > 32) {
+            KERROR("vulkan_compute_pipeline_create: cannot have more than 32 push constant ranges. Passed count: %i", config->push_constant_range_count);
+            return false;
+        }
+
+        kzero_memory(ranges, sizeof(VkPushConstantRange) * 32);
+        for (u32 i = 0; i < config->push_constant_range_count; ++i) {
+            ranges[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            ranges[i].offset = config->push_constant_ranges[i].offset;
+            ranges[i].size = config->push_constant_ranges[i].size;
+        }
+        pipeline_layout_create_info.pushConstantRangeCount = config->push_constant_range_count;
+        pipeline_layout_create_info.pPushConstantRanges = ranges;
+    } else {
+        pipeline_layout_create_info.pushConstantRangeCount = 0;
+        pipeline_layout_create_info.pPushConstantRanges = 0;
+    }
+
+    // Descriptor set layouts
+    pipeline_layout_create_info.setLayoutCount = config->descriptor_set_layout_count;
+    pipeline_layout_create_info.pSetLayouts = config->descriptor_set_layouts;
+
+    // Create the pipeline layout.
+    VK_CHECK(vkCreatePipelineLayout(
+        context->device.logical_device,
+        &pipeline_layout_create_info,
+        context->allocator,
+        &out_pipeline->pipeline_layout));
+
+    char pipeline_layout_name_buf[512] = {0};
+    string_format(pipeline_layout_name_buf, "pipeline_layout_shader_%s", config->name);
+    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_PIPELINE_LAYOUT, out_pipeline->pipeline_layout, pipeline_layout_name_buf);
+
+    // Pipeline create
+    VkComputePipelineCreateInfo pipeline_create_info = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipeline_create_info.stage = config->stages[0];
+    pipeline_create_info.layout = out_pipeline->pipeline_layout;
+    pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_create_info.basePipelineIndex = -1;
+
+    VkResult result = vkCreateComputePipelines(
+        context->device.logical_device,
+        context->pipeline_cache,
+        1,
+        &pipeline_create_info,
+        context->allocator,
+        &out_pipeline->handle);
+
+    char pipeline_name_buf[512] = {0};
+    string_format(pipeline_name_buf, "pipeline_shader_%s", config->name);
+    VK_SET_DEBUG_OBJECT_NAME(context, VK_OBJECT_TYPE_PIPELINE, out_pipeline->handle, pipeline_name_buf);
+
+    if (vulkan_result_is_success(result)) {
+        KDEBUG("Compute pipeline created!");
+        return true;
+    }
+
+    KERROR("vkCreateComputePipelines failed with %s.", vulkan_result_string(result, true));
+    return false;
+}
+
 void vulkan_pipeline_destroy(vulkan_context* context, vulkan_pipeline* pipeline) {
     if (pipeline) {
         // Destroy pipeline
@@ -298,3 +439,145 @@ void vulkan_pipeline_destroy(vulkan_context* context, vulkan_pipeline* pipeline)
 void vulkan_pipeline_bind(vulkan_command_buffer* command_buffer, VkPipelineBindPoint bind_point, vulkan_pipeline* pipeline) {
     vkCmdBindPipeline(command_buffer->handle, bind_point, pipeline->handle);
 }
+
+// Identifies a pipeline cache file written by this backend.
+#define PIPELINE_CACHE_FILE_MAGIC 0x434c504bU  // "KPLC"
+// Bump whenever the file layout changes.
+#define PIPELINE_CACHE_FILE_VERSION 1U
+
+/**
+ * @brief The header of a pipeline cache file. The cache data is only valid for the exact device
+ * and driver it was produced by, so these are checked before handing the data to Vulkan.
+ */
+typedef struct pipeline_cache_file_header {
+    u32 magic;
+    u32 version;
+    u32 vendor_id;
+    u32 device_id;
+    u32 driver_version;
+    u8 cache_uuid[VK_UUID_SIZE];
+    u64 data_size;
+} pipeline_cache_file_header;
+
+static void pipeline_cache_file_header_fill(vulkan_context* context, pipeline_cache_file_header* out_header) {
+    kzero_memory(out_header, sizeof(pipeline_cache_file_header));
+    out_header->magic = PIPELINE_CACHE_FILE_MAGIC;
+    out_header->version = PIPELINE_CACHE_FILE_VERSION;
+    out_header->vendor_id = context->device.properties.vendorID;
+    out_header->device_id = context->device.properties.deviceID;
+    out_header->driver_version = context->device.properties.driverVersion;
+    kcopy_memory(out_header->cache_uuid, context->device.properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Reads previously-saved cache data from the given path, if it exists and matches this device. Returns the size read.
+static u64 pipeline_cache_file_read(vulkan_context* context, const char* path, void** out_data) {
+    *out_data = 0;
+    if (!filesystem_exists(path)) {
+        return 0;
+    }
+    file_handle file;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &file)) {
+        KWARN("Unable to open pipeline cache file '%s'.", path);
+        return 0;
+    }
+
+    pipeline_cache_file_header expected;
+    pipeline_cache_file_header_fill(context, &expected);
+    pipeline_cache_file_header header;
+    u64 bytes_read = 0;
+    if (!filesystem_read(&file, sizeof(pipeline_cache_file_header), &header, &bytes_read) || bytes_read != sizeof(pipeline_cache_file_header)) {
+        KWARN("Pipeline cache file '%s' is truncated. It will be rebuilt.", path);
+        filesystem_close(&file);
+        return 0;
+    }
+    b8 matches = header.magic == expected.magic && header.version == expected.version &&
+                 header.vendor_id == expected.vendor_id && header.device_id == expected.device_id &&
+                 header.driver_version == expected.driver_version;
+    for (u32 i = 0; matches && i < VK_UUID_SIZE; ++i) {
+        matches = header.cache_uuid[i] == expected.cache_uuid[i];
+    }
+    if (!matches) {
+        KINFO("Pipeline cache file '%s' is from a different version, device or driver. It will be rebuilt.", path);
+        filesystem_close(&file);
+        return 0;
+    }
+
+    u64 data_size = header.data_size;
+    void* data = kallocate(data_size, MEMORY_TAG_RENDERER);
+    if (!filesystem_read(&file, data_size, data, &bytes_read) || bytes_read != data_size) {
+        KWARN("Pipeline cache file '%s' is truncated. It will be rebuilt.", path);
+        kfree(data, data_size, MEMORY_TAG_RENDERER);
+        filesystem_close(&file);
+        return 0;
+    }
+    filesystem_close(&file);
+
+    *out_data = data;
+    return data_size;
+}
+
+b8 vulkan_pipeline_cache_create(vulkan_context* context, const char* path) {
+    void* initial_data = 0;
+    u64 initial_size = path ? pipeline_cache_file_read(context, path, &initial_data) : 0;
+
+    VkPipelineCacheCreateInfo cache_create_info = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    cache_create_info.initialDataSize = initial_size;
+    cache_create_info.pInitialData = initial_data;
+    VkResult result = vkCreatePipelineCache(context->device.logical_device, &cache_create_info, context->allocator, &context->pipeline_cache);
+    if (!vulkan_result_is_success(result) && initial_data) {
+        // The driver rejected the data, so start over with an empty cache.
+        KWARN("Pipeline cache data from '%s' was rejected (%s). It will be rebuilt.", path, vulkan_result_string(result, true));
+        cache_create_info.initialDataSize = 0;
+        cache_create_info.pInitialData = 0;
+        result = vkCreatePipelineCache(context->device.logical_device, &cache_create_info, context->allocator, &context->pipeline_cache);
+    }
+    if (initial_data) {
+        kfree(initial_data, initial_size, MEMORY_TAG_RENDERER);
+    }
+    if (!vulkan_result_is_success(result)) {
+        KERROR("vkCreatePipelineCache failed with %s.", vulkan_result_string(result, true));
+        context->pipeline_cache = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (initial_size) {
+        KINFO("Loaded pipeline cache from '%s' (%llu bytes).", path, initial_size);
+    }
+    return true;
+}
+
+void vulkan_pipeline_cache_destroy(vulkan_context* context, const char* path) {
+    if (!context->pipeline_cache) {
+        return;
+    }
+
+    if (path) {
+        size_t data_size = 0;
+        VkResult result = vkGetPipelineCacheData(context->device.logical_device, context->pipeline_cache, &data_size, 0);
+        if (vulkan_result_is_success(result) && data_size > 0) {
+            void* data = kallocate(data_size, MEMORY_TAG_RENDERER);
+            result = vkGetPipelineCacheData(context->device.logical_device, context->pipeline_cache, &data_size, data);
+            if (vulkan_result_is_success(result)) {
+                pipeline_cache_file_header header;
+                pipeline_cache_file_header_fill(context, &header);
+                header.data_size = data_size;
+
+                file_handle file;
+                u64 bytes_written = 0;
+                if (!filesystem_open(path, FILE_MODE_WRITE, true, &file)) {
+                    KWARN("Unable to open pipeline cache file '%s' for writing.", path);
+                } else {
+                    if (!filesystem_write(&file, sizeof(pipeline_cache_file_header), &header, &bytes_written) ||
+                        !filesystem_write(&file, data_size, data, &bytes_written)) {
+                        KWARN("Failed to write pipeline cache file '%s'.", path);
+                    }
+                    filesystem_close(&file);
+                }
+            }
+            kfree(data, data_size, MEMORY_TAG_RENDERER);
+        }
+    }
+
+    vkDestroyPipelineCache(context->device.logical_device, context->pipeline_cache, context->allocator);
+    context->pipeline_cache = VK_NULL_HANDLE;
+}
@@ -25,6 +25,17 @@
  */
 b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipeline_config* config, vulkan_pipeline* out_pipeline);
 
+/**
+ * @brief Creates a new Vulkan compute pipeline. Only the name, stages, descriptor set layouts
+ * and push constant ranges of the config are used, and exactly one (compute) stage is required.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param config A constant pointer to configuration to be used in creating the pipeline.
+ * @param out_pipeline A pointer to hold the newly-created pipeline.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_compute_pipeline_create(vulkan_context* context, const vulkan_pipeline_config* config, vulkan_pipeline* out_pipeline);
+
 /**
  * @brief Destroys the given pipeline.
  *
@@ -41,3 +52,22 @@ void vulkan_pipeline_destroy(vulkan_context* context, vulkan_pipeline* pipeline)
  * @param pipeline A pointer to the pipeline to be bound.
  */
 void vulkan_pipeline_bind(vulkan_command_buffer* command_buffer, VkPipelineBindPoint bind_point, vulkan_pipeline* pipeline);
+
+/**
+ * @brief Creates the pipeline cache used for all pipeline creation, seeded from the file at the
+ * given path if it exists and was written for this exact device and driver version.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param path The path of the cache file to load. Pass 0 to start with an empty cache.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_pipeline_cache_create(vulkan_context* context, const char* path);
+
+/**
+ * @brief Writes the pipeline cache out to the given path, then destroys it. Should be called
+ * after all pipelines have been created, typically at shutdown.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param path The path of the cache file to write. Pass 0 to skip writing.
+ */
+void vulkan_pipeline_cache_destroy(vulkan_context* context, const char* path);
@@ -0,0 +1,115 @@
+#include "vulkan_readback.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "renderer/renderer_frontend.h"
+#include "vulkan_memory.h"
+
+// Copies from images to buffers must be aligned to the texel size. This covers every colour format.
+#define READBACK_ALIGNMENT 16
+
+b8 vulkan_readback_ring_create(vulkan_context* context, u64 frame_size) {
+    vulkan_readback_ring* ring = &context->readback_ring;
+    kzero_memory(ring, sizeof(vulkan_readback_ring));
+    for (u32 i = 0; i < VULKAN_READBACK_MAX_REQUESTS; ++i) {
+        ring->requests[i].ticket = INVALID_ID_U64;
+    }
+
+    ring->frame_size = get_aligned(frame_size, READBACK_ALIGNMENT);
+    u64 total_size = ring->frame_size * VULKAN_MAX_FRAMES_IN_FLIGHT;
+    if (!renderer_renderbuffer_create("readback_ring", RENDERBUFFER_TYPE_READ, total_size, RENDERBUFFER_TRACK_TYPE_NONE, &ring->buffer)) {
+        KERROR("Failed to create readback ring buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&ring->buffer, 0);
+    ring->mapped = vulkan_memory_map(context, &((vulkan_buffer*)ring->buffer.internal_data)->memory, 0, total_size);
+    if (!ring->mapped) {
+        KERROR("Failed to map readback ring buffer.");
+        return false;
+    }
+    ring->resolved = kallocate(total_size, MEMORY_TAG_RENDERER);
+    return true;
+}
+
+void vulkan_readback_ring_destroy(vulkan_context* context) {
+    vulkan_readback_ring* ring = &context->readback_ring;
+    if (ring->buffer.internal_data) {
+        if (ring->mapped) {
+            vulkan_memory_unmap(context, &((vulkan_buffer*)ring->buffer.internal_data)->memory);
+        }
+        renderer_renderbuffer_destroy(&ring->buffer);
+    }
+    if (ring->resolved) {
+        kfree(ring->resolved, ring->frame_size * VULKAN_MAX_FRAMES_IN_FLIGHT, MEMORY_TAG_RENDERER);
+    }
+    kzero_memory(ring, sizeof(vulkan_readback_ring));
+}
+
+void vulkan_readback_ring_frame_begin(vulkan_context* context, u32 frame_index) {
+    vulkan_readback_ring* ring = &context->readback_ring;
+    for (u32 i = 0; i < VULKAN_READBACK_MAX_REQUESTS; ++i) {
+        vulkan_readback_request* request = &ring->requests[i];
+        if (request->ticket == INVALID_ID_U64 || request->frame_index != frame_index) {
+            continue;
+        }
+        if (request->ready) {
+            // Resolved a full trip ago and never fetched. Its data is about to be overwritten.
+            request->ticket = INVALID_ID_U64;
+        } else {
+            // The buffer is host-coherent, so once the frame's fence has been waited on the data can be read.
+            kcopy_memory(ring->resolved + request->offset, ring->mapped + request->offset, request->size);
+            request->ready = true;
+        }
+    }
+
+    ring->frame_index = frame_index;
+    ring->head = 0;
+}
+
+b8 vulkan_readback_ring_request(vulkan_context* context, u32 size, u64* out_offset, u64* out_ticket) {
+    vulkan_readback_ring* ring = &context->readback_ring;
+    u64 aligned_size = get_aligned(size, READBACK_ALIGNMENT);
+    if (ring->head + aligned_size > ring->frame_size) {
+        if (!ring->overflow_reported) {
+            KERROR("vulkan_readback_ring_request - the readback ring is full (%lluB per frame). Increase VULKAN_READBACK_RING_FRAME_SIZE.", ring->frame_size);
+            ring->overflow_reported = true;
+        }
+        return false;
+    }
+
+    for (u32 i = 0; i < VULKAN_READBACK_MAX_REQUESTS; ++i) {
+        vulkan_readback_request* request = &ring->requests[i];
+        if (request->ticket == INVALID_ID_U64) {
+            request->ticket = ring->next_ticket++;
+            request->frame_index = ring->frame_index;
+            request->ready = false;
+            request->offset = (ring->frame_size * ring->frame_index) + ring->head;
+            request->size = size;
+            ring->head += aligned_size;
+
+            *out_offset = request->offset;
+            *out_ticket = request->ticket;
+            return true;
+        }
+    }
+
+    KWARN("vulkan_readback_ring_request - %u reads are already outstanding. Resolve them before requesting more.", VULKAN_READBACK_MAX_REQUESTS);
+    return false;
+}
+
+renderer_readback_status vulkan_readback_ring_resolve(vulkan_context* context, u64 ticket, u32 size, void* out_data) {
+    vulkan_readback_ring* ring = &context->readback_ring;
+    for (u32 i = 0; i < VULKAN_READBACK_MAX_REQUESTS; ++i) {
+        vulkan_readback_request* request = &ring->requests[i];
+        if (request->ticket != ticket) {
+            continue;
+        }
+        if (!request->ready) {
+            return RENDERER_READBACK_STATUS_PENDING;
+        }
+        kcopy_memory(out_data, ring->resolved + request->offset, KMIN(size, request->size));
+        request->ticket = INVALID_ID_U64;
+        return RENDERER_READBACK_STATUS_READY;
+    }
+    return RENDERER_READBACK_STATUS_INVALID;
+}
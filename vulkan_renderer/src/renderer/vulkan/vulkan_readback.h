@@ -0,0 +1,66 @@
+/**
+ * @file vulkan_readback.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A persistently-mapped buffer which images are copied into for the host to read, split
+ * into a region per frame in flight. Copies are recorded into the frame being built and handed a
+ * ticket. Once the frame's fence has been waited on, their data is copied out to the host and the
+ * ticket resolves, so nothing ever waits on the GPU just to read a few bytes back.
+ * @version 1.0
+ * @date 2023-12-03
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the readback ring for the given context.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_size The number of bytes which may be read back by each frame in flight.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_readback_ring_create(vulkan_context* context, u64 frame_size);
+
+/**
+ * @brief Destroys the readback ring for the given context. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_readback_ring_destroy(vulkan_context* context);
+
+/**
+ * @brief Resolves the requests made the last time the given frame in flight was recorded, and
+ * starts allocating from its region. Results resolved the time before are expired, so each
+ * result remains available for a full trip around the frames in flight. The frame must have
+ * completed on the GPU.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ */
+void vulkan_readback_ring_frame_begin(vulkan_context* context, u32 frame_index);
+
+/**
+ * @brief Reserves space in the current frame's region for a copy.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param size The size of the data to be copied, in bytes.
+ * @param out_offset A pointer to hold the offset within the buffer the copy should be written to.
+ * @param out_ticket A pointer to hold the ticket of the request.
+ * @return True on success; false if the region is full or too many requests are outstanding.
+ */
+b8 vulkan_readback_ring_request(vulkan_context* context, u32 size, u64* out_offset, u64* out_ticket);
+
+/**
+ * @brief Fetches the data of a request if it has resolved, releasing the request.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param ticket The ticket of the request.
+ * @param size The number of bytes to copy to out_data. Clamped to the size of the request.
+ * @param out_data A pointer to a block of memory to hold the data.
+ * @return The status of the request.
+ */
+renderer_readback_status vulkan_readback_ring_resolve(vulkan_context* context, u64 ticket, u32 size, void* out_data);
@@ -4,12 +4,14 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "systems/texture_system.h"
+#include "vulkan_deferred_deletion.h"
 #include "vulkan_device.h"
+#include "vulkan_frame_sync.h"
 #include "vulkan_image.h"
 #include "vulkan_utils.h"
 
-static void create(vulkan_context* context, u32 width, u32 height, renderer_config_flags flags, vulkan_swapchain* swapchain);
-static void destroy(vulkan_context* context, vulkan_swapchain* swapchain);
+static void create(vulkan_context* context, u32 width, u32 height, renderer_config_flags flags, VkSwapchainKHR old_handle, vulkan_swapchain* swapchain);
+static void depth_textures_release(vulkan_context* context, vulkan_swapchain* swapchain, b8 deferred);
 
 void vulkan_swapchain_create(
     vulkan_context* context,
@@ -18,7 +20,7 @@ void vulkan_swapchain_create(
     renderer_config_flags flags,
     vulkan_swapchain* out_swapchain) {
     // Simply create a new one.
-    create(context, width, height, flags, out_swapchain);
+    create(context, width, height, flags, 0, out_swapchain);
 }
 
 void vulkan_swapchain_recreate(
@@ -26,20 +28,118 @@ void vulkan_swapchain_recreate(
     u32 width,
     u32 height,
     vulkan_swapchain* swapchain) {
-    // Destroy the old and create a new one.
-    destroy(context, swapchain);
-    create(context, width, height, swapchain->flags, swapchain);
+    // The old swapchain is handed to the new one, which takes over its images as their
+    // presentation finishes. Frames in flight may still use the old views and depth images,
+    // so these go once those frames are done instead of waiting on them here.
+    VkSwapchainKHR old_handle = swapchain->handle;
+    VkImageView old_views[VULKAN_MAX_SWAPCHAIN_IMAGES];
+    u32 old_view_count = KMIN(swapchain->image_count, VULKAN_MAX_SWAPCHAIN_IMAGES);
+    for (u32 i = 0; i < old_view_count; ++i) {
+        vulkan_image* image = (vulkan_image*)swapchain->render_textures[i].internal_data;
+        old_views[i] = image->view;
+        image->view = 0;
+    }
+    depth_textures_release(context, swapchain, true);
+
+    create(context, width, height, swapchain->flags, old_handle, swapchain);
+
+    vulkan_deferred_deletion_swapchain(context, old_handle, old_view_count, old_views);
 }
 
 void vulkan_swapchain_destroy(
     vulkan_context* context,
     vulkan_swapchain* swapchain) {
-    destroy(context, swapchain);
+    // Nothing is handed on, so wait for presentation to finish as well.
+    vulkan_frame_sync_wait_all(context);
+
+    depth_textures_release(context, swapchain, false);
+
+    // Only destroy the views, not the images, since those are owned by the swapchain and are thus
+    // destroyed when it is.
+    for (u32 i = 0; i < swapchain->image_count; ++i) {
+        vulkan_image* image = (vulkan_image*)swapchain->render_textures[i].internal_data;
+        vkDestroyImageView(context->device.logical_device, image->view, context->allocator);
+        image->view = 0;
+    }
+
+    vkDestroySwapchainKHR(context->device.logical_device, swapchain->handle, context->allocator);
+    swapchain->handle = 0;
+}
+
+// Destroys the depth images, either now or once the frames in flight are done with them.
+static void depth_textures_release(vulkan_context* context, vulkan_swapchain* swapchain, b8 deferred) {
+    for (u32 i = 0; i < swapchain->image_count; ++i) {
+        vulkan_image* image = (vulkan_image*)swapchain->depth_textures[i].internal_data;
+        if (!image) {
+            continue;
+        }
+        if (deferred) {
+            vulkan_deferred_deletion_image(context, image);
+        } else {
+            vulkan_image_destroy(context, image);
+        }
+        kfree(image, sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
+        swapchain->depth_textures[i].internal_data = 0;
+    }
+}
+
+static b8 present_mode_supported(vulkan_context* context, VkPresentModeKHR mode) {
+    for (u32 i = 0; i < context->device.swapchain_support.present_mode_count; ++i) {
+        if (context->device.swapchain_support.present_modes[i] == mode) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Picks the present mode to use. FIFO is always supported, so anything unsupported falls back to it.
+static VkPresentModeKHR present_mode_select(vulkan_context* context, renderer_present_mode requested, renderer_config_flags flags) {
+    VkPresentModeKHR mode;
+    switch (requested) {
+        case RENDERER_PRESENT_MODE_FIFO:
+            mode = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        case RENDERER_PRESENT_MODE_FIFO_RELAXED:
+            mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case RENDERER_PRESENT_MODE_MAILBOX:
+            mode = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case RENDERER_PRESENT_MODE_IMMEDIATE:
+            mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+        case RENDERER_PRESENT_MODE_AUTO:
+        default:
+            // FIFO and MAILBOX support vsync, IMMEDIATE does not.
+            // TODO: vsync seems to hold up the game update for some reason.
+            // It theoretically should be post-update and pre-render where that happens.
+            if (flags & RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT) {
+                // Only try for mailbox mode if not in power-saving mode.
+                if ((flags & RENDERER_CONFIG_FLAG_POWER_SAVING_BIT) == 0 && present_mode_supported(context, VK_PRESENT_MODE_MAILBOX_KHR)) {
+                    return VK_PRESENT_MODE_MAILBOX_KHR;
+                }
+                return VK_PRESENT_MODE_FIFO_KHR;
+            }
+            mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+    }
+
+    if (mode != VK_PRESENT_MODE_FIFO_KHR && !present_mode_supported(context, mode)) {
+        KWARN("Requested present mode %u is not supported by the surface. Falling back to FIFO.", mode);
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+    return mode;
 }
 
-static void create(vulkan_context* context, u32 width, u32 height, renderer_config_flags flags, vulkan_swapchain* swapchain) {
+static void create(vulkan_context* context, u32 width, u32 height, renderer_config_flags flags, VkSwapchainKHR old_handle, vulkan_swapchain* swapchain) {
     VkExtent2D swapchain_extent = {width, height};
 
+    // Requery swapchain support.
+    vulkan_device_query_swapchain_support(
+        context->device.physical_device,
+        swapchain->surface,
+        &context->device.swapchain_support);
+
     // Choose a swap surface format.
     b8 found = false;
     for (u32 i = 0; i < context->device.swapchain_support.format_count; ++i) {
@@ -57,32 +157,8 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
         swapchain->image_format = context->device.swapchain_support.formats[0];
     }
 
-    // FIFO and MAILBOX support vsync, IMMEDIATE does not.
-    // TODO: vsync seems to hold up the game update for some reason.
-    // It theoretically should be post-update and pre-render where that happens.
     swapchain->flags = flags;
-    VkPresentModeKHR present_mode;
-    if (flags & RENDERER_CONFIG_FLAG_VSYNC_ENABLED_BIT) {
-        present_mode = VK_PRESENT_MODE_FIFO_KHR;
-        // Only try for mailbox mode if not in power-saving mode.
-        if ((flags & RENDERER_CONFIG_FLAG_POWER_SAVING_BIT) == 0) {
-            for (u32 i = 0; i < context->device.swapchain_support.present_mode_count; ++i) {
-                VkPresentModeKHR mode = context->device.swapchain_support.present_modes[i];
-                if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                    present_mode = mode;
-                    break;
-                }
-            }
-        }
-    } else {
-        present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-    }
-
-    // Requery swapchain support.
-    vulkan_device_query_swapchain_support(
-        context->device.physical_device,
-        context->surface,
-        &context->device.swapchain_support);
+    swapchain->present_mode = present_mode_select(context, context->swapchain_settings.present_mode, flags);
 
     // Swapchain extent
     if (context->device.swapchain_support.capabilities.currentExtent.width != UINT32_MAX) {
@@ -95,16 +171,24 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
     swapchain_extent.width = KCLAMP(swapchain_extent.width, min.width, max.width);
     swapchain_extent.height = KCLAMP(swapchain_extent.height, min.height, max.height);
 
-    u32 image_count = context->device.swapchain_support.capabilities.minImageCount + 1;
-    if (context->device.swapchain_support.capabilities.maxImageCount > 0 && image_count > context->device.swapchain_support.capabilities.maxImageCount) {
-        image_count = context->device.swapchain_support.capabilities.maxImageCount;
+    // Default to one more image than the minimum. Once created, the window attachments are fixed,
+    // so the swapchain may shrink later on but never grow past them.
+    u32 min_image_count = context->device.swapchain_support.capabilities.minImageCount;
+    u32 max_image_count = swapchain->image_count ? swapchain->image_count : VULKAN_MAX_SWAPCHAIN_IMAGES;
+    if (context->device.swapchain_support.capabilities.maxImageCount > 0) {
+        max_image_count = KMIN(max_image_count, context->device.swapchain_support.capabilities.maxImageCount);
     }
+    u32 image_count = context->swapchain_settings.image_count ? context->swapchain_settings.image_count : min_image_count + 1;
+    image_count = KCLAMP(image_count, min_image_count, max_image_count);
 
-    swapchain->max_frames_in_flight = image_count - 1;
+    // Default to double-buffering frames, but never have more in flight than there are images.
+    u32 frames_in_flight = context->swapchain_settings.frames_in_flight ? context->swapchain_settings.frames_in_flight : 2;
+    frames_in_flight = KCLAMP(frames_in_flight, 1, VULKAN_MAX_FRAMES_IN_FLIGHT);
+    swapchain->max_frames_in_flight = KMIN(frames_in_flight, image_count);
 
     // Swapchain create info
     VkSwapchainCreateInfoKHR swapchain_create_info = {VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
-    swapchain_create_info.surface = context->surface;
+    swapchain_create_info.surface = swapchain->surface;
     swapchain_create_info.minImageCount = image_count;
     swapchain_create_info.imageFormat = swapchain->image_format.format;
     swapchain_create_info.imageColorSpace = swapchain->image_format.colorSpace;
@@ -128,26 +212,39 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
 
     swapchain_create_info.preTransform = context->device.swapchain_support.capabilities.currentTransform;
     swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchain_create_info.presentMode = present_mode;
+    swapchain_create_info.presentMode = swapchain->present_mode;
     swapchain_create_info.clipped = VK_TRUE;
-    swapchain_create_info.oldSwapchain = 0;
+    // Handing over the old swapchain lets presentation from it finish without waiting on it here.
+    swapchain_create_info.oldSwapchain = old_handle;
 
     VK_CHECK(vkCreateSwapchainKHR(context->device.logical_device, &swapchain_create_info, context->allocator, &swapchain->handle));
 
-    // Start with a zero frame index.
-    context->current_frame = 0;
+    // Start with a zero frame index. Other windows are rendered to within the main window's frames.
+    if (swapchain == &context->swapchain) {
+        context->current_frame = 0;
+    }
 
-    // Images
-    swapchain->image_count = 0;
-    VK_CHECK(vkGetSwapchainImagesKHR(context->device.logical_device, swapchain->handle, &swapchain->image_count, 0));
+    // Images. The implementation may create more than asked for.
+    VkImage swapchain_images[32];
+    swapchain->handle_image_count = 32;
+    VK_CHECK(vkGetSwapchainImagesKHR(context->device.logical_device, swapchain->handle, &swapchain->handle_image_count, swapchain_images));
     if (!swapchain->render_textures) {
+        if (swapchain->handle_image_count > VULKAN_MAX_SWAPCHAIN_IMAGES) {
+            KFATAL("Swapchain was created with %u images, but at most %u are supported!", swapchain->handle_image_count, VULKAN_MAX_SWAPCHAIN_IMAGES);
+            return;
+        }
+        swapchain->image_count = swapchain->handle_image_count;
         swapchain->render_textures = (texture*)kallocate(sizeof(texture) * swapchain->image_count, MEMORY_TAG_RENDERER);
         // If creating the array, then the internal texture objects aren't created yet either.
         for (u32 i = 0; i < swapchain->image_count; ++i) {
             void* internal_data = kallocate(sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
 
-            char tex_name[38] = "__internal_vulkan_swapchain_image_0__";
-            tex_name[34] = '0' + (char)i;
+            char tex_name[TEXTURE_NAME_MAX_LENGTH] = {0};
+            if (swapchain->window_id) {
+                string_format(tex_name, "__internal_vulkan_window_%u_swapchain_image_%u__", swapchain->window_id, i);
+            } else {
+                string_format(tex_name, "__internal_vulkan_swapchain_image_%u__", i);
+            }
 
             texture_system_wrap_internal(
                 tex_name,
@@ -165,17 +262,20 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
             }
         }
     } else {
+        if (swapchain->handle_image_count > swapchain->image_count) {
+            KFATAL("Swapchain was recreated with %u images, more than the %u window attachments!", swapchain->handle_image_count, swapchain->image_count);
+            return;
+        }
         for (u32 i = 0; i < swapchain->image_count; ++i) {
             // Just update the dimensions.
             texture_system_resize(&swapchain->render_textures[i], swapchain_extent.width, swapchain_extent.height, false);
         }
     }
-    VkImage swapchain_images[32];
-    VK_CHECK(vkGetSwapchainImagesKHR(context->device.logical_device, swapchain->handle, &swapchain->image_count, swapchain_images));
     for (u32 i = 0; i < swapchain->image_count; ++i) {
-        // Update the internal image for each.
+        // Update the internal image for each. Attachments past the images owned by the swapchain
+        // are never acquired, but keep valid images so their render targets can still be created.
         vulkan_image* image = (vulkan_image*)swapchain->render_textures[i].internal_data;
-        image->handle = swapchain_images[i];
+        image->handle = swapchain_images[i % swapchain->handle_image_count];
         image->width = swapchain_extent.width;
         image->height = swapchain_extent.height;
     }
@@ -208,9 +308,13 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
     }
 
     // Create depth/stencil images and its view.
-    for (u32 i = 0; i < context->swapchain.image_count; ++i) {
+    for (u32 i = 0; i < swapchain->image_count; ++i) {
         char formatted_name[TEXTURE_NAME_MAX_LENGTH] = {0};
-        string_format(formatted_name, "__kohi_default_depth_stencil_texture_%u", i);
+        if (swapchain->window_id) {
+            string_format(formatted_name, "__kohi_window_%u_depth_stencil_texture_%u", swapchain->window_id, i);
+        } else {
+            string_format(formatted_name, "__kohi_default_depth_stencil_texture_%u", i);
+        }
 
         vulkan_image* image = kallocate(sizeof(vulkan_image), MEMORY_TAG_TEXTURE);
         vulkan_image_create(
@@ -239,26 +343,9 @@ static void create(vulkan_context* context, u32 width, u32 height, renderer_conf
             true,
             false,
             image,
-            &context->swapchain.depth_textures[i]);
-    }
-
-    KINFO("Swapchain created successfully.");
-}
-
-static void destroy(vulkan_context* context, vulkan_swapchain* swapchain) {
-    vkDeviceWaitIdle(context->device.logical_device);
-
-    for (u32 i = 0; i < context->swapchain.image_count; ++i) {
-        vulkan_image_destroy(context, (vulkan_image*)swapchain->depth_textures[i].internal_data);
-        swapchain->depth_textures[i].internal_data = 0;
+            &swapchain->depth_textures[i]);
     }
 
-    // Only destroy the views, not the images, since those are owned by the swapchain and are thus
-    // destroyed when it is.
-    for (u32 i = 0; i < swapchain->image_count; ++i) {
-        vulkan_image* image = (vulkan_image*)swapchain->render_textures[i].internal_data;
-        vkDestroyImageView(context->device.logical_device, image->view, context->allocator);
-    }
-
-    vkDestroySwapchainKHR(context->device.logical_device, swapchain->handle, context->allocator);
+    KINFO("Swapchain created successfully: %u images (%u window attachments), %u frames in flight, present mode %u.",
+          swapchain->handle_image_count, swapchain->image_count, swapchain->max_frames_in_flight, swapchain->present_mode);
 }
@@ -21,7 +21,7 @@
  * @param width The initial width of the surface area.
  * @param height The initial height of the surface area.
  * @param vsync Indicates if the swapchain should use vsync.
- * @param out_swapchain A pointer to the newly-created swapchain.
+ * @param out_swapchain A pointer to the newly-created swapchain. Its surface (and window id, if not the main window's) must be set.
  */
 void vulkan_swapchain_create(
     vulkan_context* context,
@@ -33,7 +33,9 @@ void vulkan_swapchain_create(
 /**
  * @brief Recreates the given swapchain with the given width and
  * height, replacing the internal swapchain with the newly-created
- * one.
+ * one. The old swapchain is handed to the new one, and it and its
+ * views are destroyed once the frames in flight are done, so this
+ * never waits on the GPU.
  *
  * @param context A pointer to the Vulkan context.
  * @param width The new width of the surface area.
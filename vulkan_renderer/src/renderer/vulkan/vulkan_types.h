@@ -17,6 +17,8 @@
 #include "containers/freelist.h"
 #include "containers/hashtable.h"
 #include "core/asserts.h"
+#include "core/kmutex.h"
+#include "core/metrics.h"
 #include "defines.h"
 #include "renderer/renderer_types.h"
 #include "vulkan/vulkan_core.h"
@@ -32,6 +34,82 @@
 
 struct vulkan_context;
 
+/**
+ * @brief A range of device memory handed out by the memory allocator. Either a range
+ * within a larger shared block, or a dedicated allocation of its own.
+ */
+typedef struct vulkan_memory_allocation {
+    /** @brief The device memory containing the allocation. Shared with other allocations unless dedicated. */
+    VkDeviceMemory memory;
+    /** @brief The offset of the allocation within memory, respecting the required alignment. */
+    u64 offset;
+    /** @brief The size of the allocation. */
+    u64 size;
+    /** @brief The index of the block the allocation was made from, or INVALID_ID if dedicated. */
+    u32 block_index;
+    /** @brief The offset of the range reserved in the block, which includes alignment padding. */
+    u64 reserved_offset;
+    /** @brief The size of the range reserved in the block, which includes alignment padding. */
+    u64 reserved_size;
+    /** @brief The index of the memory heap the allocation was made from. */
+    u32 heap_index;
+} vulkan_memory_allocation;
+
+/** @brief A large device memory allocation which is sub-allocated from. */
+typedef struct vulkan_memory_block {
+    /** @brief The device memory of the block. Null if this slot is unused. */
+    VkDeviceMemory memory;
+    /** @brief The size of the block. */
+    u64 size;
+    /** @brief The number of bytes currently reserved in the block, including alignment padding. */
+    u64 used;
+    /** @brief The memory type of the block. */
+    u32 memory_type_index;
+    /**
+     * @brief Indicates if the block holds linear resources (buffers) as opposed to optimally-tiled
+     * images. Keeping these apart means bufferImageGranularity never needs to be considered.
+     */
+    b8 is_linear;
+    /** @brief The number of live allocations made from the block. */
+    u32 allocation_count;
+    /** @brief Tracks the free ranges of the block. */
+    freelist free_list;
+    /** @brief The memory backing the free list. */
+    void* free_list_block;
+    /** @brief The size of the memory backing the free list. */
+    u64 free_list_memory_requirement;
+    /** @brief The persistently-mapped memory of the block if host visible; otherwise 0. */
+    void* mapped;
+} vulkan_memory_block;
+
+/**
+ * @brief Sub-allocates images and buffers from large per-memory-type blocks, to keep the
+ * number of device allocations low. Large resources and render targets get dedicated allocations.
+ */
+typedef struct vulkan_memory_allocator {
+    /** @brief The size of newly-created blocks. */
+    u64 block_size;
+    /** @brief The blocks, some of which may be unused slots. darray */
+    vulkan_memory_block* blocks;
+    /** @brief Guards the blocks and statistics. */
+    kmutex lock;
+
+    /** @brief The number of live blocks. */
+    u32 block_count;
+    /** @brief The total size of all live blocks. */
+    u64 block_bytes;
+    /** @brief The number of bytes reserved within blocks, including alignment padding. */
+    u64 block_used_bytes;
+    /** @brief The number of live allocations made from blocks. */
+    u32 block_allocation_count;
+    /** @brief The number of live dedicated allocations. */
+    u32 dedicated_count;
+    /** @brief The total size of all live dedicated allocations. */
+    u64 dedicated_bytes;
+    /** @brief The device memory allocated from each heap, by blocks and dedicated allocations alike. */
+    u64 heap_bytes[VK_MAX_MEMORY_HEAPS];
+} vulkan_memory_allocator;
+
 /**
  * @brief Represents a Vulkan-specific buffer.
  * Used to load data onto the GPU.
@@ -44,7 +122,7 @@ typedef struct vulkan_buffer {
     /** @brief Indicates if the buffer's memory is currently locked. */
     b8 is_locked;
     /** @brief The memory used by the buffer. */
-    VkDeviceMemory memory;
+    vulkan_memory_allocation memory;
     /** @brief The memory requirements for this buffer. */
     VkMemoryRequirements memory_requirements;
     /** @brief The index of the memory used by the buffer. */
@@ -75,7 +153,31 @@ typedef enum vulkan_device_support_flag_bits {
 
     /** @brief Indicates if this device supports dynamic state. If not, the renderer will need to generate a separate pipeline per topology type. */
     VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_STATE_BIT = 0x02,
-    VULKAN_DEVICE_SUPPORT_FLAG_LINE_SMOOTH_RASTERISATION_BIT = 0x04
+    VULKAN_DEVICE_SUPPORT_FLAG_LINE_SMOOTH_RASTERISATION_BIT = 0x04,
+
+    /** @brief Indicates if this device supports indirect draws with a nonzero first instance. */
+    VULKAN_DEVICE_SUPPORT_FLAG_DRAW_INDIRECT_FIRST_INSTANCE_BIT = 0x08,
+
+    /** @brief Indicates if this device supports more than one draw per indirect draw call. */
+    VULKAN_DEVICE_SUPPORT_FLAG_MULTI_DRAW_INDIRECT_BIT = 0x10,
+
+    /** @brief Indicates if this device supports the descriptor indexing features required for bindless textures. */
+    VULKAN_DEVICE_SUPPORT_FLAG_BINDLESS_TEXTURES_BIT = 0x20,
+
+    /** @brief Indicates if this device supports timeline semaphores (i.e. using Vulkan API >= 1.2). */
+    VULKAN_DEVICE_SUPPORT_FLAG_TIMELINE_SEMAPHORE_BIT = 0x40,
+
+    /** @brief Indicates if this device supports renderpasses which render to several layers at once (i.e. using Vulkan API >= 1.1). */
+    VULKAN_DEVICE_SUPPORT_FLAG_MULTIVIEW_BIT = 0x80,
+
+    /** @brief Indicates if this device supports rendering without renderpass or framebuffer objects (i.e. using Vulkan API >= 1.3 or VK_KHR_dynamic_rendering). */
+    VULKAN_DEVICE_SUPPORT_FLAG_DYNAMIC_RENDERING_BIT = 0x100,
+
+    /** @brief Indicates if this device reports the budget and usage of its memory heaps (i.e. VK_EXT_memory_budget). */
+    VULKAN_DEVICE_SUPPORT_FLAG_MEMORY_BUDGET_BIT = 0x200,
+
+    /** @brief Indicates if this device supports setting the fragment shading rate per draw (i.e. VK_KHR_fragment_shading_rate with Vulkan API >= 1.2). */
+    VULKAN_DEVICE_SUPPORT_FLAG_FRAGMENT_SHADING_RATE_BIT = 0x400
 } vulkan_device_support_flag_bits;
 
 /** @brief Bitwise flags for device support. @see vulkan_device_support_flag_bits. */
@@ -109,6 +211,11 @@ typedef struct vulkan_device {
     i32 present_queue_index;
     /** @brief The index of the transfer queue. */
     i32 transfer_queue_index;
+    /**
+     * @brief The index of a compute-capable queue family. Async compute uses a queue of the graphics
+     * family instead (see compute_queue), so resources need no queue family ownership transfers.
+     */
+    i32 compute_queue_index;
     /** @brief Indicates if the device supports a memory type that is both host visible and device local. */
     b8 supports_device_local_host_visible;
 
@@ -118,6 +225,8 @@ typedef struct vulkan_device {
     VkQueue present_queue;
     /** @brief A handle to a transfer queue. */
     VkQueue transfer_queue;
+    /** @brief A handle to a second queue of the graphics family, used for async compute. 0 if the family has no spare queue. */
+    VkQueue compute_queue;
 
     /** @brief A handle to a command pool for graphics operations. */
     VkCommandPool graphics_command_pool;
@@ -136,8 +245,24 @@ typedef struct vulkan_device {
 
     /** @brief Indicates support for various features. */
     vulkan_device_support_flags support_flags;
+
+    /** @brief The maximum number of views a multiview renderpass may render at once. 0 if multiview is not supported. */
+    u32 max_multiview_view_count;
+
+    /** @brief The largest block of pixels a single fragment may shade, in each dimension. 1 if variable rate shading is not supported. */
+    u32 max_fragment_shading_rate_size;
 } vulkan_device;
 
+/** @brief How the generated mip levels of an image are filtered. Matches the FILTER_ values of the downsample shader. */
+typedef enum vulkan_mip_filter {
+    /** @brief Texels are averaged as stored. */
+    VULKAN_MIP_FILTER_LINEAR = 0,
+    /** @brief Colour is averaged in linear space, having been decoded from sRGB. */
+    VULKAN_MIP_FILTER_SRGB = 1,
+    /** @brief Texels are decoded to normals, averaged and renormalized. */
+    VULKAN_MIP_FILTER_NORMAL_MAP = 2
+} vulkan_mip_filter;
+
 /**
  * @brief A representation of a Vulkan image. This can be thought
  * of as a texture. Also contains the view and memory used by
@@ -147,7 +272,7 @@ typedef struct vulkan_image {
     /** @brief The handle to the internal image object. */
     VkImage handle;
     /** @brief The memory used by the image. */
-    VkDeviceMemory memory;
+    vulkan_memory_allocation memory;
     /** @brief The view for the image, which is used to access the image. */
     VkImageView view;
     /** @brief If there are multiple layers, one view per layer exists here. */
@@ -168,6 +293,10 @@ typedef struct vulkan_image {
     char* name;
     /** The number of mipmaps to be generated for this image. Must always be at least 1. */
     u32 mip_levels;
+    /** @brief The usage the image was created with. */
+    VkImageUsageFlags usage;
+    /** @brief How generated mip levels are filtered. Only the compute downsampler distinguishes these. */
+    vulkan_mip_filter mip_filter;
 } vulkan_image;
 
 /** @brief Represents the possible states of a renderpass. */
@@ -186,6 +315,25 @@ typedef enum vulkan_render_pass_state {
     NOT_ALLOCATED
 } vulkan_render_pass_state;
 
+/** @brief The most colour attachments a renderpass rendered with dynamic rendering may have. */
+#define VULKAN_MAX_COLOUR_ATTACHMENTS 4
+
+/**
+ * @brief How an attachment of a renderpass rendered with dynamic rendering is loaded, stored
+ * and transitioned, in place of the attachment description of a renderpass object.
+ */
+typedef struct vulkan_renderpass_attachment {
+    VkFormat format;
+    VkAttachmentLoadOp load_op;
+    VkAttachmentStoreOp store_op;
+    VkAttachmentLoadOp stencil_load_op;
+    VkAttachmentStoreOp stencil_store_op;
+    /** @brief The layout the image is in when the renderpass begins. UNDEFINED if its contents are not kept. */
+    VkImageLayout initial_layout;
+    /** @brief The layout the image is transitioned to when the renderpass ends. */
+    VkImageLayout final_layout;
+} vulkan_renderpass_attachment;
+
 /**
  * @brief A representation of the Vulkan renderpass.
  */
@@ -201,8 +349,57 @@ typedef struct vulkan_renderpass {
 
     /** @brief Indicates renderpass state. */
     vulkan_render_pass_state state;
+
+    /** @brief The number of layers rendered at once using multiview. 0 or 1 if multiview is not used. */
+    u8 view_count;
+
+    /**
+     * @brief Indicates the renderpass is begun with dynamic rendering, so has no handle, and its
+     * targets have no framebuffers. The attachments below are used instead.
+     */
+    b8 dynamic;
+    /** @brief The number of colour attachments. Only used with dynamic rendering. */
+    u8 colour_attachment_count;
+    /** @brief The colour attachments, in the order of the target's attachments. Only used with dynamic rendering. */
+    vulkan_renderpass_attachment colour_attachments[VULKAN_MAX_COLOUR_ATTACHMENTS];
+    /** @brief Indicates if there is a depth attachment. Only used with dynamic rendering. */
+    b8 has_depth_attachment;
+    /** @brief The depth (and stencil, if its format has one) attachment. Only used with dynamic rendering. */
+    vulkan_renderpass_attachment depth_attachment;
 } vulkan_renderpass;
 
+/**
+ * @brief Everything needed to begin and end a renderpass on a render target using dynamic
+ * rendering, including the layout transitions a renderpass object would otherwise perform.
+ * Built afresh at each begin from the target's current textures, so resizing them never
+ * requires anything to be recreated.
+ */
+typedef struct vulkan_dynamic_rendering {
+    /** @brief The rendering info. Its attachment pointers point into this structure, so it must not be copied once prepared. */
+    VkRenderingInfoKHR info;
+    VkRenderingAttachmentInfoKHR colour_attachments[VULKAN_MAX_COLOUR_ATTACHMENTS];
+    VkRenderingAttachmentInfoKHR depth_attachment;
+    VkRenderingAttachmentInfoKHR stencil_attachment;
+    /** @brief The formats of the attachments, used for the inheritance info of secondary command buffers. */
+    VkFormat colour_formats[VULKAN_MAX_COLOUR_ATTACHMENTS];
+    VkFormat depth_format;
+    VkFormat stencil_format;
+
+    /** @brief Transitions of the attachments to attachment layouts, recorded before rendering begins. */
+    VkImageMemoryBarrier begin_barriers[VULKAN_MAX_COLOUR_ATTACHMENTS + 1];
+    u32 begin_barrier_count;
+    VkPipelineStageFlags begin_src_stages;
+    VkPipelineStageFlags begin_dst_stages;
+    /** @brief Transitions of the attachments to their final layouts, recorded after rendering ends. */
+    VkImageMemoryBarrier end_barriers[VULKAN_MAX_COLOUR_ATTACHMENTS + 1];
+    u32 end_barrier_count;
+    VkPipelineStageFlags end_src_stages;
+    VkPipelineStageFlags end_dst_stages;
+} vulkan_dynamic_rendering;
+
+/** @brief The most images a swapchain may have, which is also the most window attachments. */
+#define VULKAN_MAX_SWAPCHAIN_IMAGES 3
+
 /**
  * @brief Representation of the Vulkan swapchain.
  */
@@ -210,18 +407,35 @@ typedef struct vulkan_swapchain {
     /** @brief The swapchain image format. */
     VkSurfaceFormatKHR image_format;
     /**
-     * @brief The maximum number of "images in flight" (images simultaneously being rendered to).
-     * Typically one less than the total number of images available.
+     * @brief The maximum number of frames in flight (frames recorded by the CPU but not yet
+     * completed by the GPU). As configured, but never more than the number of images available.
      */
     u8 max_frames_in_flight;
 
     /** @brief Indicates various flags used for swapchain instantiation. */
     renderer_config_flags flags;
 
+    /** @brief The present mode in use. */
+    VkPresentModeKHR present_mode;
+
+    /** @brief The surface the swapchain presents to. */
+    VkSurfaceKHR surface;
+
+    /** @brief 0 for the main window's swapchain, otherwise the id of the window it belongs to, used to name its textures. */
+    u32 window_id;
+
     /** @brief The swapchain internal handle. */
     VkSwapchainKHR handle;
-    /** @brief The number of swapchain images. */
+    /**
+     * @brief The number of window attachments, fixed by the number of images the swapchain was first
+     * created with. Everything sized per window attachment is sized by this.
+     */
     u32 image_count;
+    /**
+     * @brief The number of images owned by the swapchain handle. May be fewer than image_count, in
+     * which case the attachments past it refer to its images again and are never acquired.
+     */
+    u32 handle_image_count;
     /** @brief An array of render targets, which contain swapchain images. */
     texture* render_textures;
 
@@ -232,9 +446,12 @@ typedef struct vulkan_swapchain {
      * @brief Render targets used for on-screen rendering, one per frame.
      * The images contained in these are created and owned by the swapchain.
      * */
-    render_target render_targets[3];
+    render_target render_targets[VULKAN_MAX_SWAPCHAIN_IMAGES];
 } vulkan_swapchain;
 
+/** @brief The most windows which may be rendered to in addition to the main one. */
+#define VULKAN_MAX_WINDOWS 8
+
 /**
  * @brief Represents all of the available states that
  * a command buffer can be in.
@@ -267,6 +484,81 @@ typedef struct vulkan_command_buffer {
     vulkan_command_buffer_state state;
 } vulkan_command_buffer;
 
+/** @brief The maximum number of frames which may be in flight at once. */
+#define VULKAN_MAX_FRAMES_IN_FLIGHT 3
+
+/**
+ * @brief A window rendered to in addition to the main one. Only its surface and swapchain are its
+ * own; it is rendered to within the frames of the main window, and presented along with it.
+ */
+typedef struct vulkan_window {
+    /** @brief The surface of the window. */
+    VkSurfaceKHR surface;
+    /** @brief The swapchain presenting to the surface. */
+    vulkan_swapchain swapchain;
+    /** @brief The semaphores signaled once each frame in flight's image is available, as the main window's are. */
+    VkSemaphore image_available_semaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The index of the image last acquired. */
+    u32 image_index;
+    /** @brief The number of the frame the image was last acquired in, or 0 if never. */
+    u64 acquired_frame_number;
+    /** @brief Indicates if the acquired image has yet to be waited on by a submission. */
+    b8 image_wait_pending;
+    /** @brief Indicates if the swapchain must be recreated before it is next acquired, i.e. as the window was resized. */
+    b8 recreate_pending;
+} vulkan_window;
+
+/** @brief The maximum number of renderpasses which may be recorded into a single command list. */
+#define VULKAN_COMMAND_LIST_MAX_SEGMENTS 8
+
+/**
+ * @brief A single renderpass recorded into a command list. The renderpass is
+ * begun on the primary command buffer when the list is executed, and the
+ * secondary command buffer holding the recorded commands is executed within it.
+ */
+typedef struct vulkan_command_list_segment {
+    /** @brief The begin info for the renderpass. pClearValues points at clear_values. Unused with dynamic rendering. */
+    VkRenderPassBeginInfo begin_info;
+    /** @brief Indicates the renderpass is begun with dynamic rendering, using rendering rather than begin_info. */
+    b8 dynamic;
+    /** @brief What is needed to begin and end the renderpass with dynamic rendering. */
+    vulkan_dynamic_rendering rendering;
+    /** @brief The clear values used when beginning the renderpass. */
+    VkClearValue clear_values[VULKAN_MAX_COLOUR_ATTACHMENTS + 1];
+    /** @brief The index of the secondary command buffer in the current frame's buffers. */
+    u32 buffer_index;
+    /** @brief The name of the renderpass, used to label its GPU timings. */
+    const char* name;
+} vulkan_command_list_segment;
+
+/**
+ * @brief A list of commands recorded on a single thread into secondary command
+ * buffers, which are later executed in order from the primary command buffer.
+ * Each list owns its command pools, so no two threads ever share a pool.
+ */
+typedef struct vulkan_command_list {
+    /** @brief The command pools, one per frame in flight. */
+    VkCommandPool pools[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The secondary command buffers allocated from each pool. @note darray */
+    vulkan_command_buffer* buffers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The number of buffers from each pool used so far this frame. */
+    u32 buffer_used_counts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The number of segments recorded since the list was begun. */
+    u32 segment_count;
+    /** @brief The renderpasses recorded since the list was begun. */
+    vulkan_command_list_segment segments[VULKAN_COMMAND_LIST_MAX_SEGMENTS];
+} vulkan_command_list;
+
+/** @brief The state of the async compute work of the draw being recorded. */
+typedef enum vulkan_async_compute_state {
+    /** @brief No compute work has been recorded. */
+    VULKAN_ASYNC_COMPUTE_STATE_IDLE,
+    /** @brief Compute work has been recorded, but not yet submitted. */
+    VULKAN_ASYNC_COMPUTE_STATE_PENDING,
+    /** @brief Compute work has been submitted. Anything recorded afterward is recorded inline. */
+    VULKAN_ASYNC_COMPUTE_STATE_SUBMITTED
+} vulkan_async_compute_state;
+
 /**
  * @brief Represents a single shader stage.
  */
@@ -296,6 +588,8 @@ typedef struct vulkan_pipeline_config {
     vulkan_renderpass* renderpass;
     /** @brief The stride of the vertex data to be used (ex: sizeof(vertex_3d)) */
     u32 stride;
+    /** @brief The stride of the per-instance data (binding 1). 0 if the pipeline is not instanced. */
+    u32 instance_stride;
     /** @brief The number of attributes. */
     u32 attribute_count;
     /** @brief An array of attributes. */
@@ -350,8 +644,18 @@ typedef struct vulkan_pipeline {
 #define VULKAN_SHADER_MAX_GLOBAL_TEXTURES 31
 /** @brief The maximum number of textures allowed at the instance level. */
 #define VULKAN_SHADER_MAX_INSTANCE_TEXTURES 31
+/** @brief The maximum number of storage buffers/images allowed at the global level. */
+#define VULKAN_SHADER_MAX_GLOBAL_STORAGE 8
+/** @brief The number of entries in the global bindless texture array. */
+#define VULKAN_MAX_BINDLESS_TEXTURES 4096
 /** @brief The maximum number of vertex input attributes allowed. */
 #define VULKAN_SHADER_MAX_ATTRIBUTES 16
+
+/**
+ * @brief The most instances a shader's first descriptor pool is sized for. Pools are added as
+ * more instances are acquired, so a high instance limit doesn't reserve descriptors up front.
+ */
+#define VULKAN_SHADER_INITIAL_POOL_INSTANCES 64
 /**
  * @brief The maximum number of uniforms and samplers allowed at the
  * global, instance and local levels combined. It's probably more than
@@ -372,6 +676,8 @@ typedef struct vulkan_descriptor_set_config {
     VkDescriptorSetLayoutBinding* bindings;
     /** @brief The start index of the sampler bindings. */
     u8 sampler_binding_index_start;
+    /** @brief The start index of the storage buffer/image bindings, which follow the samplers. */
+    u8 storage_binding_index_start;
 } vulkan_descriptor_set_config;
 
 /**
@@ -401,46 +707,100 @@ typedef struct vulkan_uniform_sampler_state {
      */
     vulkan_descriptor_state* descriptor_states;
 } vulkan_uniform_sampler_state;
+
+/**
+ * @brief The resource bound to a global storage buffer/image uniform. Set by calls to
+ * uniform_set and written into the global descriptor set when globals are applied.
+ */
+typedef struct vulkan_uniform_storage_state {
+    /** @brief The descriptor type, either a storage buffer or a storage image. */
+    VkDescriptorType type;
+    /** @brief The bound buffer, if a storage buffer. */
+    const struct renderbuffer* buffer;
+    /** @brief The bound texture, if a storage image. */
+    const struct texture* image;
+} vulkan_uniform_storage_state;
+
 /**
  * @brief The instance-level state for a shader.
  */
 typedef struct vulkan_shader_instance_state {
     /** @brief The instance id. INVALID_ID if not used. */
     u32 id;
-    /** @brief The offset in bytes in the instance uniform buffer. */
+    /** @brief The offset in bytes of the instance's uniform values within the shader's uniform block. */
     u64 offset;
+    /** @brief The offset within the uniform ring of the last copy of the instance's uniform values. */
+    u32 ring_offset;
+    /** @brief The number of the frame in which the instance's uniform values were last copied to the uniform ring. */
+    u64 ring_frame_number;
+    /** @brief Indicates if the instance's uniform values changed since they were last copied to the uniform ring. */
+    b8 ubo_dirty;
 
     /** @brief The descriptor sets for this instance, one per frame. */
     // TODO: handle frame counts other than 3.
     VkDescriptorSet descriptor_sets[3];
-
-    // UBO descriptor
-    vulkan_descriptor_state ubo_descriptor_state;
+    /** @brief The pool the descriptor sets were allocated from, which they are freed back to. */
+    VkDescriptorPool descriptor_pool;
 
     // A mapping of sampler uniforms to descriptors and texture maps.
     vulkan_uniform_sampler_state* sampler_uniforms;
 } vulkan_shader_instance_state;
 
+/** @brief The most descriptor types a descriptor allocator sizes its pools for. */
+#define VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES 4
+/** @brief The most times larger than its first pool a descriptor allocator's pools may grow to. */
+#define VULKAN_DESCRIPTOR_ALLOCATOR_MAX_GROWTH 16
+/** @brief The number of sets the first transient descriptor pool of each frame in flight holds. */
+#define VULKAN_TRANSIENT_DESCRIPTOR_SET_COUNT 64
+
+/**
+ * @brief Allocates descriptor sets from a chain of pools. When the pools run out, another one is
+ * added, each twice the size of the last up to VULKAN_DESCRIPTOR_ALLOCATOR_MAX_GROWTH times the first.
+ */
+typedef struct vulkan_descriptor_allocator {
+    /** @brief The number of descriptor types pools are sized for. */
+    u32 pool_size_count;
+    /** @brief The descriptors of each type held by the first pool. */
+    VkDescriptorPoolSize pool_sizes[VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES];
+    /** @brief The number of sets held by the first pool. */
+    u32 set_count;
+    /** @brief The flags pools are created with. */
+    VkDescriptorPoolCreateFlags flags;
+    /** @brief The size of the next pool, as a multiple of the first. */
+    u32 next_growth;
+    /** @brief The pools, oldest first. Sets are allocated from the newest one which still has room. @note darray */
+    VkDescriptorPool* pools;
+    /** @brief The index of the pool allocated from last. Pools before it were full. */
+    u32 current_pool;
+} vulkan_descriptor_allocator;
+
+/** @brief The pipelines of one variant of a shader, created the first time the variant is used. */
+typedef struct vulkan_shader_variant {
+    /** @brief One pipeline per topology class, as for vulkan_shader. 0 until the variant is first used. */
+    vulkan_pipeline** pipelines;
+    /** @brief As above, with the packed vertex layout. 0 if the shader has no packed vertex layout. */
+    vulkan_pipeline** packed_pipelines;
+} vulkan_shader_variant;
+
 /**
  * @brief Represents a generic Vulkan shader. This uses a set of inputs
  * and parameters, as well as the shader programs contained in SPIR-V
  * files to construct a shader for use in rendering.
  */
 typedef struct vulkan_shader {
-    /** @brief The block of memory mapped to the uniform buffer. */
-    void* mapped_uniform_buffer_block;
+    /**
+     * @brief The values of the global and instance uniforms, as last set. Copied into the uniform
+     * ring whenever they are applied.
+     */
+    u8* uniform_block;
+    /** @brief The size of the uniform block in bytes. */
+    u64 uniform_block_size;
     /** @brief The block of memory used for push constants, 128B. */
     void* local_push_constant_block;
 
     /** @brief The shader identifier. */
     u32 id;
 
-    /**
-     * @brief The max number of descriptor sets that can be allocated from this shader.
-     * Should typically be a decently high number.
-     */
-    u16 max_descriptor_set_count;
-
     /**
      * @brief The total number of descriptor sets configured for this shader.
      * Is 1 if only using global uniforms/samplers; otherwise 2.
@@ -449,9 +809,16 @@ typedef struct vulkan_shader {
     /** @brief Descriptor sets, max of 2. Index 0=global, 1=instance */
     vulkan_descriptor_set_config descriptor_sets[2];
 
+    /** @brief The number of attribute descriptions for this shader. A mat4 attribute takes up 4. */
+    u32 attribute_description_count;
     /** @brief An array of attribute descriptions for this shader. */
     VkVertexInputAttributeDescription attributes[VULKAN_SHADER_MAX_ATTRIBUTES];
 
+    /** @brief The number of attribute descriptions with the packed vertex layout. 0 if the shader has none. */
+    u32 packed_attribute_description_count;
+    /** @brief An array of attribute descriptions with the packed vertex layout. */
+    VkVertexInputAttributeDescription packed_attributes[VULKAN_SHADER_MAX_ATTRIBUTES];
+
     /** @brief Face culling mode, provided by the front end. */
     face_cull_mode cull_mode;
 
@@ -468,33 +835,66 @@ typedef struct vulkan_shader {
 
     u32 pool_size_count;
 
-    /** @brief An array of descriptor pool sizes. */
-    VkDescriptorPoolSize pool_sizes[2];
+    /** @brief An array of the descriptor counts held by the shader's first descriptor pool. */
+    VkDescriptorPoolSize pool_sizes[VULKAN_DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES];
 
-    /** @brief The descriptor pool used for this shader. */
-    VkDescriptorPool descriptor_pool;
+    /** @brief The number of descriptor sets held by the shader's first descriptor pool. */
+    u32 pool_set_count;
+
+    /** @brief Allocates the shader's global and instance descriptor sets, growing as instances are acquired. */
+    vulkan_descriptor_allocator descriptors;
+
+    /**
+     * @brief Descriptor set layouts. Index 0=global, 1=instance. If the shader uses bindless textures,
+     * the context's shared bindless layout follows these at index descriptor_set_count (not owned).
+     */
+    VkDescriptorSetLayout descriptor_set_layouts[3];
 
-    /** @brief Descriptor set layouts, max of 2. Index 0=global, 1=instance. */
-    VkDescriptorSetLayout descriptor_set_layouts[2];
+    /** @brief Indicates if the shader binds the global bindless texture set, at set index descriptor_set_count. */
+    b8 uses_bindless_textures;
 
     /** @brief Global descriptor sets, one per frame. */
     // TODO: handle frame counts other than 3.
     VkDescriptorSet global_descriptor_sets[3];
 
-    // UBO descriptor
-    vulkan_descriptor_state global_ubo_descriptor_state;
+    /** @brief The offset within the uniform ring of the last copy of the global uniform values. */
+    u32 global_ring_offset;
+    /** @brief The number of the frame in which the global uniform values were last copied to the uniform ring. */
+    u64 global_ring_frame_number;
+    /** @brief Indicates if the global uniform values changed since they were last copied to the uniform ring. */
+    b8 global_ubo_dirty;
 
     // A mapping of sampler uniforms to descriptors and texture maps.
     vulkan_uniform_sampler_state* global_sampler_uniforms;
 
-    /** @brief The uniform buffer used by this shader. */
-    renderbuffer uniform_buffer;
+    /** @brief The resources bound to global storage uniforms, indexed by uniform location. */
+    vulkan_uniform_storage_state* global_storage_uniforms;
+
+    /** @brief Indicates if this is a compute shader, which has a single compute pipeline and no renderpass. */
+    b8 is_compute;
+    /** @brief The pipeline bind point, either graphics or compute. */
+    VkPipelineBindPoint bind_point;
+    /** @brief The stages the local push constant block is visible to. */
+    VkShaderStageFlags push_constant_stages;
 
-    /** @brief An array of pointers to pipelines associated with this shader. */
+    /** @brief An array of pointers to the pipelines of the bound variant, one per topology class. */
     vulkan_pipeline** pipelines;
 
+    /**
+     * @brief An array of pointers to pipelines with the packed vertex layout, one per topology class
+     * as above. 0 if the shader has no packed vertex layout.
+     */
+    vulkan_pipeline** packed_pipelines;
+
+    /** @brief The pipelines of each variant of the shader, indexed as the frontend's variants. Darray. */
+    vulkan_shader_variant* variants;
+    /** @brief The index of the bound variant, whose pipelines are those above. */
+    u32 bound_variant;
+
     /** @brief The currently bound pipeline index. */
     u8 bound_pipeline_index;
+    /** @brief The vertex format of the currently bound pipeline. */
+    geometry_vertex_format bound_vertex_format;
     /** @brief The currently-selected topology. */
     VkPrimitiveTopology current_topology;
 
@@ -503,6 +903,299 @@ typedef struct vulkan_shader {
 
 } vulkan_shader;
 
+/** @brief The contents last written to a single entry of a bindless texture descriptor set. */
+typedef struct vulkan_bindless_slot {
+    /** @brief The texture written. Null if never written. */
+    struct texture* t;
+    /** @brief The generation of the texture at the time it was written. */
+    u32 generation;
+    /** @brief The image view written, which changes whenever the texture is swapped out. */
+    VkImageView view;
+    /** @brief The sampler written. */
+    VkSampler sampler;
+} vulkan_bindless_slot;
+
+/** @brief The number of upload batches which may be recorded or in flight at once. */
+#define VULKAN_UPLOAD_BATCH_COUNT 4
+
+/**
+ * @brief A group of uploads recorded together and submitted at once. When a dedicated
+ * transfer queue is used, copies are recorded into the transfer command buffer and
+ * ownership is acquired (and mips generated) in the graphics command buffer. If there
+ * is an async compute queue as well, images whose mips are generated by compute are
+ * acquired and downsampled in the compute command buffer instead, which runs between the two.
+ */
+typedef struct vulkan_upload_batch {
+    /** @brief Records copies and ownership releases. Only used with a dedicated transfer queue. */
+    vulkan_command_buffer transfer_command_buffer;
+    /** @brief Records ownership acquires, mip generation and final layout transitions. */
+    vulkan_command_buffer graphics_command_buffer;
+    /** @brief Records compute mip generation on the async compute queue. Only used with a dedicated transfer queue. */
+    vulkan_command_buffer compute_command_buffer;
+    /** @brief Signaled once all previously-submitted graphics work completes, so in-use data isn't overwritten. */
+    VkSemaphore graphics_complete_semaphore;
+    /** @brief Signaled once the transfer queue copies complete. */
+    VkSemaphore transfer_complete_semaphore;
+    /** @brief Signaled once the compute command buffer completes. */
+    VkSemaphore compute_complete_semaphore;
+    /** @brief Indicates if the compute command buffer is being recorded, having had work added to it. */
+    b8 uses_compute;
+    /** @brief Per-level views created to generate mips by compute, destroyed once the batch retires. @note darray */
+    VkImageView* mip_views;
+    /** @brief The descriptor sets used to generate mips by compute, reset once the batch retires. */
+    vulkan_descriptor_allocator mip_descriptors;
+    /** @brief Signaled once the entire batch has executed. */
+    VkFence fence;
+    /** @brief The number of bytes of the staging ring consumed by this batch, including padding. */
+    u64 ring_bytes;
+    /** @brief The number of uploads recorded into this batch. */
+    u32 upload_count;
+    /** @brief Indicates if the batch is currently being recorded. */
+    b8 is_recording;
+    /** @brief Indicates if the batch has been submitted and not yet retired. */
+    b8 in_flight;
+} vulkan_upload_batch;
+
+/**
+ * @brief Stages uploads to device-local resources through a persistently-mapped ring buffer,
+ * and submits them in batches without waiting on the GPU.
+ */
+typedef struct vulkan_upload_state {
+    /** @brief The staging ring buffer. */
+    renderbuffer ring;
+    /** @brief The persistent mapping of the ring buffer. */
+    u8* ring_mapped;
+    /** @brief The offset at which the next allocation from the ring begins. */
+    u64 ring_head;
+    /** @brief The number of bytes of the ring in use by batches not yet retired. */
+    u64 ring_used;
+    /** @brief Indicates if the transfer queue is in a separate family to the graphics queue. */
+    b8 uses_transfer_queue;
+    /**
+     * @brief Indicates if each upload is submitted and waited on as soon as it is recorded, as
+     * uploads were before they were batched. Only for comparing the two.
+     */
+    b8 synchronous;
+    /** @brief The command pool for the transfer queue. Only used with a dedicated transfer queue. */
+    VkCommandPool transfer_command_pool;
+    /** @brief The index of the batch currently being recorded to. */
+    u32 current_batch;
+    /** @brief The upload batches, used round-robin. */
+    vulkan_upload_batch batches[VULKAN_UPLOAD_BATCH_COUNT];
+} vulkan_upload_state;
+
+/** @brief The number of bytes of uniform data which may be written to the uniform ring by each frame in flight. */
+#define VULKAN_UNIFORM_RING_FRAME_SIZE MEBIBYTES(8)
+
+/**
+ * @brief A persistently-mapped uniform buffer shared by all shaders, with a region per frame in
+ * flight. Global and instance uniforms are copied into it as they are applied, and bound with
+ * dynamic offsets.
+ */
+typedef struct vulkan_uniform_ring {
+    /** @brief The uniform buffer, frame_size bytes per frame in flight. */
+    renderbuffer buffer;
+    /** @brief The persistent mapping of the buffer. */
+    u8* mapped;
+    /** @brief The size in bytes of the region of each frame in flight. */
+    u64 frame_size;
+    /** @brief The alignment of each allocation, as required for dynamic offsets. */
+    u64 alignment;
+    /** @brief The index of the frame in flight whose region is being allocated from. */
+    u32 frame_index;
+    /** @brief The offset within the current region at which the next allocation begins. */
+    volatile u64 head;
+    /** @brief Indicates if running out of space has already been reported. */
+    b8 overflow_reported;
+} vulkan_uniform_ring;
+
+/** @brief The number of bytes of readback data which may be requested by each frame in flight. */
+#define VULKAN_READBACK_RING_FRAME_SIZE KIBIBYTES(64)
+/** @brief The number of asynchronous reads which may be outstanding at once. */
+#define VULKAN_READBACK_MAX_REQUESTS 64
+
+/** @brief An asynchronous read whose data is copied into the readback ring. */
+typedef struct vulkan_readback_request {
+    /** @brief The ticket the request was given, or INVALID_ID_U64 if the slot is free. */
+    u64 ticket;
+    /** @brief The index of the frame in flight the copy was recorded in. */
+    u32 frame_index;
+    /** @brief Set once the frame has completed and the data copied out of the ring. */
+    b8 ready;
+    /** @brief The offset of the data within the ring. */
+    u64 offset;
+    /** @brief The size of the data in bytes. */
+    u32 size;
+} vulkan_readback_request;
+
+/**
+ * @brief A persistently-mapped buffer which images are copied into for the host to read, with
+ * a region per frame in flight. Once a frame completes, the data of its requests is copied into
+ * a host-side shadow of the ring, where it stays until the same region completes again.
+ */
+typedef struct vulkan_readback_ring {
+    /** @brief The readback buffer, frame_size bytes per frame in flight. */
+    renderbuffer buffer;
+    /** @brief The persistent mapping of the buffer. */
+    u8* mapped;
+    /** @brief The host-side copy of the data of completed requests, laid out as the buffer is. */
+    u8* resolved;
+    /** @brief The size in bytes of the region of each frame in flight. */
+    u64 frame_size;
+    /** @brief The index of the frame in flight whose region is being allocated from. */
+    u32 frame_index;
+    /** @brief The offset within the current region at which the next allocation begins. */
+    u64 head;
+    /** @brief The ticket given to the next request. */
+    u64 next_ticket;
+    /** @brief The outstanding requests. */
+    vulkan_readback_request requests[VULKAN_READBACK_MAX_REQUESTS];
+    /** @brief Indicates if running out of space has already been reported. */
+    b8 overflow_reported;
+} vulkan_readback_ring;
+
+/** @brief The types of resources whose destruction may be deferred. */
+typedef enum vulkan_deferred_deletion_type {
+    VULKAN_DEFERRED_DELETION_TYPE_IMAGE,
+    VULKAN_DEFERRED_DELETION_TYPE_BUFFER,
+    VULKAN_DEFERRED_DELETION_TYPE_SAMPLER,
+    VULKAN_DEFERRED_DELETION_TYPE_DESCRIPTOR_SETS,
+    VULKAN_DEFERRED_DELETION_TYPE_RENDERBUFFER_RANGE,
+    VULKAN_DEFERRED_DELETION_TYPE_PIPELINE,
+    VULKAN_DEFERRED_DELETION_TYPE_SWAPCHAIN
+} vulkan_deferred_deletion_type;
+
+/**
+ * @brief A resource which is no longer used, but may still be referenced by frames in flight.
+ * It is destroyed once the frame it was released in has finished executing.
+ */
+typedef struct vulkan_deferred_deletion {
+    /** @brief The type of resource. */
+    vulkan_deferred_deletion_type type;
+    /** @brief The frame number in which the resource was released. */
+    u64 frame_number;
+    /** @brief The object owning the resource, if any. Used to discard entries whose owner is destroyed first. */
+    void* owner;
+    union {
+        /** @brief A copy of the image to be destroyed. */
+        vulkan_image image;
+        /** @brief The buffer to be destroyed, along with its memory. */
+        struct {
+            VkBuffer handle;
+            vulkan_memory_allocation memory;
+        } buffer;
+        /** @brief The sampler to be destroyed. */
+        VkSampler sampler;
+        /** @brief The descriptor sets to be freed, one per frame. */
+        struct {
+            VkDescriptorPool pool;
+            VkDescriptorSet sets[3];
+        } descriptor_sets;
+        /** @brief The range of a renderbuffer to be freed. */
+        struct {
+            renderbuffer* buffer;
+            u64 size;
+            u64 offset;
+        } range;
+        /** @brief The pipeline to be destroyed, along with its layout. */
+        struct {
+            VkPipeline handle;
+            VkPipelineLayout layout;
+        } pipeline;
+        /** @brief A retired swapchain to be destroyed, along with the views of its images. */
+        struct {
+            VkSwapchainKHR handle;
+            u32 view_count;
+            VkImageView views[VULKAN_MAX_SWAPCHAIN_IMAGES];
+        } swapchain;
+    };
+} vulkan_deferred_deletion;
+
+/** @brief The maximum number of renderpasses which may be timed on the GPU per frame. */
+#define VULKAN_MAX_GPU_TIMERS 64
+
+/** @brief A renderpass timed on the GPU. */
+typedef struct vulkan_gpu_timer {
+    /** @brief The name of the renderpass. Copied, since the renderpass may be gone by the time results are read. */
+    char name[METRICS_GPU_PASS_NAME_MAX];
+    /** @brief Indicates if pipeline statistics were also queried for the renderpass. */
+    b8 has_statistics;
+} vulkan_gpu_timer;
+
+/**
+ * @brief Times renderpasses on the GPU using timestamp queries, and optionally counts shader
+ * invocations using pipeline statistics queries. Each frame in flight has its own query pools,
+ * which are read back once the frame has completed.
+ */
+typedef struct vulkan_gpu_profiler {
+    /** @brief Indicates if timestamps are supported on the graphics queue. If not, nothing is timed. */
+    b8 timestamps_supported;
+    /** @brief Indicates if pipeline statistics queries are supported. */
+    b8 statistics_supported;
+    /** @brief The number of nanoseconds per timestamp tick. */
+    f32 timestamp_period;
+    /** @brief Masks off the bits of a timestamp which are not valid. */
+    u64 timestamp_mask;
+    /** @brief Timestamp query pools, two queries per timer, one pool per frame in flight. */
+    VkQueryPool timestamp_pools[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief Pipeline statistics query pools, one query per timer, one pool per frame in flight. */
+    VkQueryPool statistics_pools[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The number of timers recorded in each frame in flight. */
+    u32 timer_counts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The timers recorded in each frame in flight. */
+    vulkan_gpu_timer timers[VULKAN_MAX_FRAMES_IN_FLIGHT][VULKAN_MAX_GPU_TIMERS];
+    /** @brief The index of the timer currently open in the current frame, or INVALID_ID if none. */
+    u32 open_timer;
+} vulkan_gpu_profiler;
+
+/**
+ * @brief Occlusion queries issued by the frontend, e.g. around the bounds of objects to find which
+ * are hidden. Each frame in flight has its own query pool, which is read back once the frame has
+ * completed, so results are a frame or more behind those being issued.
+ */
+typedef struct vulkan_occlusion_queries {
+    /** @brief Occlusion query pools of RENDERER_MAX_OCCLUSION_QUERIES, one per frame in flight. */
+    VkQueryPool pools[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief One past the highest index of the queries issued in each frame in flight. */
+    u32 counts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The renderer frame number each frame in flight's queries were issued in. */
+    u64 frame_numbers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The index of the query currently open in the current frame, or INVALID_ID if none. */
+    u32 open_query;
+    /** @brief The results of the most recently resolved frame with queries: 1 if any sample passed; otherwise 0. */
+    u8 results[RENDERER_MAX_OCCLUSION_QUERIES];
+    /** @brief The number of results. */
+    u32 result_count;
+    /** @brief The renderer frame number the results were issued in. 0 if there are none yet. */
+    u64 result_frame_number;
+} vulkan_occlusion_queries;
+
+/** @brief The most mip levels below the base level generated by the compute downsampler, enough for 4096x4096 images. */
+#define VULKAN_MIP_DOWNSAMPLE_MAX_LEVELS 12
+/** @brief The most layers of an image the compute downsampler generates mips for. */
+#define VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS 64
+
+/**
+ * @brief Generates the mip levels of uploaded RGBA8 images with a single compute dispatch each,
+ * filtered to suit what the image holds. Created the first time it is needed, and if that fails,
+ * mips are generated by blitting instead.
+ */
+typedef struct vulkan_mip_downsampler {
+    /** @brief Indicates if creation has been attempted. */
+    b8 is_created;
+    /** @brief Indicates if creation succeeded, so the downsampler may be used. */
+    b8 is_available;
+    /** @brief The layout of the set holding each level of the image and the counters. */
+    VkDescriptorSetLayout set_layout;
+    /** @brief The compute pipeline. */
+    vulkan_pipeline pipeline;
+    /**
+     * @brief Counts the workgroups of each layer which are done, so the last can produce the smallest
+     * levels. Holds VULKAN_MIP_DOWNSAMPLE_MAX_LAYERS counters per upload batch.
+     */
+    renderbuffer counters;
+} vulkan_mip_downsampler;
+
 // Forward declare shaderc compiler.
 struct shaderc_compiler;
 
@@ -510,6 +1203,16 @@ struct shaderc_compiler;
  * @brief The overall Vulkan context for the backend. Holds and maintains
  * global renderer backend state, Vulkan instance, etc.
  */
+/** @brief A sampler shared by the texture maps whose filter, repeat and anisotropy settings match. */
+typedef struct vulkan_sampler_cache_entry {
+    /** @brief The settings the sampler was created with, packed together. */
+    u32 key;
+    /** @brief The sampler. */
+    VkSampler sampler;
+    /** @brief The number of texture maps using the sampler. */
+    u32 reference_count;
+} vulkan_sampler_cache_entry;
+
 typedef struct vulkan_context {
     /** @brief The instance-level api major version. */
     u32 api_major;
@@ -562,22 +1265,70 @@ typedef struct vulkan_context {
     /** @brief The Vulkan device. */
     vulkan_device device;
 
+    /** @brief The cache used for all pipeline creation, persisted to disk between runs. */
+    VkPipelineCache pipeline_cache;
+
+    /** @brief Allocates the device memory for all images and buffers. */
+    vulkan_memory_allocator memory_allocator;
+
     /** @brief The swapchain. */
     vulkan_swapchain swapchain;
 
+    /** @brief The windows rendered to in addition to the main one, by window id - 1. Zero for free slots. */
+    vulkan_window* windows[VULKAN_MAX_WINDOWS];
+
     /** @brief The graphics command buffers, one per frame. @note: darray */
     vulkan_command_buffer* graphics_command_buffers;
 
-    /** @brief The semaphores used to indicate image availability, one per frame. @note: darray */
-    VkSemaphore* image_available_semaphores;
+    /** @brief Command lists used to record passes in parallel, indexed by list index. */
+    vulkan_command_list command_lists[RENDERER_MAX_COMMAND_LISTS];
+
+    /**
+     * @brief The graphics command buffers the rest of a frame is recorded to once it has been split to
+     * wait for async compute, one per frame. Only allocated if there is an async compute queue. @note: darray
+     */
+    vulkan_command_buffer* graphics_split_command_buffers;
+    /** @brief Indicates if the frame being recorded has been split, so is recorded to graphics_split_command_buffers. */
+    b8 graphics_split;
+    /** @brief The command buffers async compute work is recorded to, one per frame in flight. Only allocated if there is an async compute queue. */
+    vulkan_command_buffer async_compute_command_buffers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief The state of the async compute work of the draw being recorded. */
+    vulkan_async_compute_state async_compute_state;
+    /** @brief Indicates if dispatches are currently recorded to the async compute command buffer. */
+    b8 async_compute_recording;
+
+    /** @brief The semaphores used to indicate image availability, one per frame in flight. */
+    VkSemaphore image_available_semaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /** @brief The semaphores used to indicate queue availability, one per frame in flight. */
+    VkSemaphore queue_complete_semaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /**
+     * @brief Signaled on the graphics queue once everything submitted to it before a frame's async compute
+     * work has completed, and waited on by that work. One per frame in flight.
+     */
+    VkSemaphore async_compute_ready_semaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief Signaled once a frame's async compute work has completed, and waited on by the rest of the frame. One per frame in flight. */
+    VkSemaphore async_compute_complete_semaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief Indicates if part of the frame being recorded was submitted and already waited on image availability. */
+    b8 image_wait_submitted;
+    /** @brief Indicates if async compute work was submitted for the frame being recorded, which the rest of the frame waits on. */
+    b8 async_compute_submitted;
+
+    /**
+     * @brief The in-flight fences, used to indicate to the application when a frame is busy/ready.
+     * Only used if timeline semaphores are not supported.
+     */
+    VkFence in_flight_fences[VULKAN_MAX_FRAMES_IN_FLIGHT];
 
-    /** @brief The semaphores used to indicate queue availability, one per frame. @note: darray */
-    VkSemaphore* queue_complete_semaphores;
+    /**
+     * @brief A timeline semaphore signaled with the number of each frame as it completes, used in
+     * place of the in-flight fences if supported. Otherwise 0.
+     */
+    VkSemaphore frame_timeline;
 
-    /** @brief The current number of in-flight fences. */
-    u32 in_flight_fence_count;
-    /** @brief The in-flight fences, used to indicate to the application when a frame is busy/ready. */
-    VkFence in_flight_fences[2];
+    /** @brief The swapchain settings requested by the frontend, applied whenever the swapchain is (re)created. */
+    renderer_swapchain_settings swapchain_settings;
 
     /** @brief The current image index. */
     u32 image_index;
@@ -585,6 +1336,27 @@ typedef struct vulkan_context {
     /** @brief The current frame. */
     u32 current_frame;
 
+    /** @brief Counts prepared frames. The frame currently being recorded (or last recorded) has this number. */
+    u64 frame_number;
+
+    /** @brief The number of the frame last submitted using each in-flight fence. */
+    u64 in_flight_frame_numbers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /** @brief The time at which each frame in flight was prepared, used to measure frame latency. */
+    f64 in_flight_start_times[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /** @brief Indicates if each frame in flight was submitted, as opposed to prepared and then skipped. */
+    b8 in_flight_submitted[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /** @brief The number of the last frame submitted to the graphics queue. */
+    u64 submitted_frame_number;
+
+    /** @brief The number of the last frame known to have completed on the GPU. */
+    u64 completed_frame_number;
+
+    /** @brief Resources waiting on frames in flight before being destroyed, in release order. @note darray */
+    vulkan_deferred_deletion* deferred_deletions;
+
     /** @brief Indicates if the swapchain is currently being recreated. */
     b8 recreating_swapchain;
 
@@ -596,8 +1368,24 @@ typedef struct vulkan_context {
     /** @brief Indicates if multi-threading is supported by this device. */
     b8 multithreading_enabled;
 
-    /** @brief Collection of samplers. darray */
+    /** @brief The sampler used by each texture map, indexed by texture map internal id. Zero for free slots. darray */
     VkSampler* samplers;
+    /** @brief The samplers created, shared by every texture map with the same settings. darray */
+    vulkan_sampler_cache_entry* sampler_cache;
+
+    /**
+     * @brief The texture assigned to each bindless slot, indexed by texture map internal id
+     * (i.e. sharing the index of its sampler). Null for free slots. Zero if bindless textures are unsupported.
+     */
+    struct texture** bindless_textures;
+    /** @brief Layout of the bindless texture set, shared by all shaders which use it. */
+    VkDescriptorSetLayout bindless_layout;
+    /** @brief The pool from which the bindless sets are allocated. */
+    VkDescriptorPool bindless_pool;
+    /** @brief Bindless texture sets, one per frame in flight so a set is never written while in use. */
+    VkDescriptorSet bindless_sets[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    /** @brief What was last written to each entry of each bindless set, used to only write what changed. */
+    vulkan_bindless_slot* bindless_written[VULKAN_MAX_FRAMES_IN_FLIGHT];
 
     /**
      * @brief A function pointer to find a memory index of the given type and with the given properties.
@@ -612,13 +1400,45 @@ typedef struct vulkan_context {
     PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT;
     PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT;
     PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT;
+    PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT;
     PFN_vkCmdSetStencilOpEXT vkCmdSetStencilOpEXT;
 
+    /** @brief Begins and ends dynamic rendering. The core or extension entry point, whichever the device provides. 0 if unsupported. */
+    PFN_vkCmdBeginRenderingKHR vkCmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR vkCmdEndRendering;
+
+    /** @brief Sets the fragment shading rate of subsequent draws. 0 if unsupported. */
+    PFN_vkCmdSetFragmentShadingRateKHR vkCmdSetFragmentShadingRateKHR;
+
+    /** @brief The renderpass begun with dynamic rendering on the primary command buffer, outside of command lists. */
+    vulkan_dynamic_rendering inline_rendering;
+
     /** @brief A pointer to the currently bound shader. */
     struct shader* bound_shader;
 
-    /** @brief A resusable staging buffer to transfer data from a resource to a GPU-only buffer. */
-    renderbuffer staging;
+    /** @brief Stages and batches uploads to GPU-only buffers and images. */
+    vulkan_upload_state upload;
+
+    /** @brief The uniform buffer which global and instance uniforms are copied into each frame. */
+    vulkan_uniform_ring uniform_ring;
+
+    /**
+     * @brief Descriptor pools for sets only needed for a single frame, one allocator per frame in
+     * flight. Each is reset once its frame has completed.
+     */
+    vulkan_descriptor_allocator transient_descriptors[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    /** @brief The buffer which asynchronous image reads are copied into. */
+    vulkan_readback_ring readback_ring;
+
+    /** @brief Times renderpasses on the GPU. */
+    vulkan_gpu_profiler profiler;
+
+    /** @brief Finds which draws are hidden, for the frontend to skip them in later frames. */
+    vulkan_occlusion_queries occlusion_queries;
+
+    /** @brief Generates the mip levels of uploaded images by compute. */
+    vulkan_mip_downsampler mip_downsampler;
 
     /**
      * Used for dynamic compilation of vulkan shaders (using the shaderc lib.)
@@ -0,0 +1,64 @@
+#include "vulkan_uniform_ring.h"
+
+#include "core/katomic.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "renderer/renderer_frontend.h"
+#include "vulkan_memory.h"
+
+b8 vulkan_uniform_ring_create(vulkan_context* context, u64 frame_size) {
+    vulkan_uniform_ring* ring = &context->uniform_ring;
+    kzero_memory(ring, sizeof(vulkan_uniform_ring));
+
+    // Every frame's region, and so every dynamic offset, must respect the device's alignment.
+    ring->alignment = context->device.properties.limits.minUniformBufferOffsetAlignment;
+    ring->frame_size = get_aligned(frame_size, ring->alignment);
+
+    u64 total_size = ring->frame_size * VULKAN_MAX_FRAMES_IN_FLIGHT;
+    if (!renderer_renderbuffer_create("uniform_ring", RENDERBUFFER_TYPE_UNIFORM, total_size, RENDERBUFFER_TRACK_TYPE_NONE, &ring->buffer)) {
+        KERROR("Failed to create uniform ring buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&ring->buffer, 0);
+    ring->mapped = vulkan_memory_map(context, &((vulkan_buffer*)ring->buffer.internal_data)->memory, 0, total_size);
+    if (!ring->mapped) {
+        KERROR("Failed to map uniform ring buffer.");
+        return false;
+    }
+    return true;
+}
+
+void vulkan_uniform_ring_destroy(vulkan_context* context) {
+    vulkan_uniform_ring* ring = &context->uniform_ring;
+    if (ring->buffer.internal_data) {
+        if (ring->mapped) {
+            vulkan_memory_unmap(context, &((vulkan_buffer*)ring->buffer.internal_data)->memory);
+        }
+        renderer_renderbuffer_destroy(&ring->buffer);
+    }
+    kzero_memory(ring, sizeof(vulkan_uniform_ring));
+}
+
+void vulkan_uniform_ring_frame_begin(vulkan_context* context, u32 frame_index) {
+    vulkan_uniform_ring* ring = &context->uniform_ring;
+    ring->frame_index = frame_index;
+    katomic_store_u64(&ring->head, 0, KATOMIC_ORDER_RELAXED);
+}
+
+b8 vulkan_uniform_ring_write(vulkan_context* context, const void* data, u64 size, u32* out_offset) {
+    vulkan_uniform_ring* ring = &context->uniform_ring;
+    u64 aligned_size = get_aligned(size, ring->alignment);
+    u64 head = katomic_fetch_add_u64(&ring->head, aligned_size, KATOMIC_ORDER_RELAXED);
+    if (head + aligned_size > ring->frame_size) {
+        if (!ring->overflow_reported) {
+            KERROR("vulkan_uniform_ring_write - the uniform ring is full (%lluB per frame). Uniforms will be missing; increase VULKAN_UNIFORM_RING_FRAME_SIZE.", ring->frame_size);
+            ring->overflow_reported = true;
+        }
+        return false;
+    }
+
+    u64 offset = (ring->frame_size * ring->frame_index) + head;
+    kcopy_memory(ring->mapped + offset, data, size);
+    *out_offset = (u32)offset;
+    return true;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file vulkan_uniform_ring.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief A persistently-mapped uniform buffer shared by all shaders, split into a region per
+ * frame in flight. Uniform data is copied into the current frame's region with a bump allocation
+ * whenever it is applied, and bound using a dynamic offset. Descriptors always point at the start
+ * of the buffer, so they never need to be rewritten to change which data is used.
+ * @version 1.0
+ * @date 2023-12-01
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the uniform ring for the given context.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_size The number of bytes which may be written by each frame in flight.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_uniform_ring_create(vulkan_context* context, u64 frame_size);
+
+/**
+ * @brief Destroys the uniform ring for the given context. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_uniform_ring_destroy(vulkan_context* context);
+
+/**
+ * @brief Starts allocating from the region of the given frame in flight, discarding everything
+ * written to it before. The frame must have completed on the GPU.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param frame_index The index of the frame in flight.
+ */
+void vulkan_uniform_ring_frame_begin(vulkan_context* context, u32 frame_index);
+
+/**
+ * @brief Copies the given uniform data into the current frame's region. Safe to call from
+ * multiple threads at once.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param data The data to be copied.
+ * @param size The size of the data in bytes.
+ * @param out_offset A pointer to hold the offset of the copy within the ring, to be used as a dynamic offset.
+ * @return True on success; false if the frame's region is full.
+ */
+b8 vulkan_uniform_ring_write(vulkan_context* context, const void* data, u64 size, u32* out_offset);
@@ -0,0 +1,605 @@
+#include "vulkan_upload.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "renderer/renderer_frontend.h"
+#include "vulkan_command_buffer.h"
+#include "vulkan_image.h"
+#include "vulkan_memory.h"
+#include "vulkan_mip_downsample.h"
+#include "vulkan_utils.h"
+
+// Waits for the given batch to finish executing, then releases its portion of the ring.
+static b8 batch_retire(vulkan_context* context, vulkan_upload_batch* batch) {
+    VkResult result = vkWaitForFences(context->device.logical_device, 1, &batch->fence, true, UINT64_MAX);
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Upload batch fence wait failure! error: %s", vulkan_result_string(result, true));
+        return false;
+    }
+    context->upload.ring_used -= batch->ring_bytes;
+    batch->ring_bytes = 0;
+    vulkan_mip_downsample_batch_release(context, batch, false);
+    batch->in_flight = false;
+    return true;
+}
+
+// Retires batches which have already finished, oldest first, without waiting.
+static void batches_retire_completed(vulkan_context* context) {
+    vulkan_upload_state* upload = &context->upload;
+    for (u32 i = 1; i <= VULKAN_UPLOAD_BATCH_COUNT; ++i) {
+        vulkan_upload_batch* batch = &upload->batches[(upload->current_batch + i) % VULKAN_UPLOAD_BATCH_COUNT];
+        if (!batch->in_flight) {
+            continue;
+        }
+        if (vkGetFenceStatus(context->device.logical_device, batch->fence) != VK_SUCCESS) {
+            // Batches complete in order, so nothing after this one can be done either.
+            break;
+        }
+        batch_retire(context, batch);
+    }
+}
+
+// Waits on the oldest in-flight batch. Returns false if there are none.
+static b8 batch_retire_oldest(vulkan_context* context) {
+    vulkan_upload_state* upload = &context->upload;
+    for (u32 i = 1; i <= VULKAN_UPLOAD_BATCH_COUNT; ++i) {
+        vulkan_upload_batch* batch = &upload->batches[(upload->current_batch + i) % VULKAN_UPLOAD_BATCH_COUNT];
+        if (batch->in_flight) {
+            return batch_retire(context, batch);
+        }
+    }
+    return false;
+}
+
+// Called once an upload has been recorded. Synchronous uploads are submitted and waited on right away.
+static b8 upload_recorded(vulkan_context* context) {
+    if (context->upload.synchronous) {
+        return vulkan_upload_wait(context);
+    }
+    return true;
+}
+
+// Gets the batch currently being recorded to, beginning it if need be.
+static vulkan_upload_batch* batch_current_get(vulkan_context* context) {
+    vulkan_upload_state* upload = &context->upload;
+    vulkan_upload_batch* batch = &upload->batches[upload->current_batch];
+    if (batch->is_recording) {
+        return batch;
+    }
+
+    VK_CHECK(vkResetFences(context->device.logical_device, 1, &batch->fence));
+    vulkan_command_buffer_begin(&batch->graphics_command_buffer, true, false, false);
+    if (upload->uses_transfer_queue) {
+        vulkan_command_buffer_begin(&batch->transfer_command_buffer, true, false, false);
+    } else {
+        // Uploads overwrite data in place, so wait for any work already submitted which may still read it.
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch->graphics_command_buffer.handle, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+    }
+    batch->ring_bytes = 0;
+    batch->upload_count = 0;
+    batch->uses_compute = false;
+    batch->is_recording = true;
+    return batch;
+}
+
+// Gets the command buffer to generate the mips of an image in. With a dedicated transfer queue and an
+// async compute queue, compute mip generation runs on the latter between the copies and the acquires
+// on the graphics queue, rather than in line with rendering.
+static vulkan_command_buffer* mip_command_buffer_get(vulkan_upload_batch* batch, b8 is_compute) {
+    if (!is_compute || !batch->compute_command_buffer.handle) {
+        return &batch->graphics_command_buffer;
+    }
+    if (!batch->uses_compute) {
+        vulkan_command_buffer_begin(&batch->compute_command_buffer, true, false, false);
+        batch->uses_compute = true;
+    }
+    return &batch->compute_command_buffer;
+}
+
+// Reserves a range of the staging ring, waiting on in-flight batches for space if need be.
+static b8 ring_allocate(vulkan_context* context, u64 size, u64 alignment, u64* out_offset, u64* out_consumed) {
+    vulkan_upload_state* upload = &context->upload;
+    u64 capacity = upload->ring.total_size;
+    if (size > capacity) {
+        KERROR("Upload of %lluB is larger than the entire staging ring (%lluB).", size, capacity);
+        return false;
+    }
+
+    while (true) {
+        // NOTE: Alignment need not be a power of 2, since 3-channel texel sizes aren't.
+        u64 offset = ((upload->ring_head + alignment - 1) / alignment) * alignment;
+        u64 padding = offset - upload->ring_head;
+        if (offset + size > capacity) {
+            // Wrap around, wasting the remainder at the end of the ring.
+            padding = capacity - upload->ring_head;
+            offset = 0;
+        }
+        if (upload->ring_used + padding + size <= capacity) {
+            upload->ring_head = offset + size;
+            upload->ring_used += padding + size;
+            *out_offset = offset;
+            *out_consumed = padding + size;
+            return true;
+        }
+
+        // Out of space. Wait on the oldest batch in flight, or submit the current one if there are none.
+        if (!batch_retire_oldest(context)) {
+            vulkan_upload_batch* batch = &upload->batches[upload->current_batch];
+            if (!batch->is_recording || !batch->upload_count) {
+                KERROR("Staging ring is exhausted with no uploads pending.");
+                return false;
+            }
+            if (!vulkan_upload_flush(context)) {
+                return false;
+            }
+        }
+    }
+}
+
+b8 vulkan_upload_create(vulkan_context* context, u64 ring_size) {
+    vulkan_upload_state* upload = &context->upload;
+    kzero_memory(upload, sizeof(vulkan_upload_state));
+    upload->uses_transfer_queue = context->device.transfer_queue_index != context->device.graphics_queue_index;
+
+    if (!renderer_renderbuffer_create("staging", RENDERBUFFER_TYPE_STAGING, ring_size, RENDERBUFFER_TRACK_TYPE_NONE, &upload->ring)) {
+        KERROR("Failed to create staging ring buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&upload->ring, 0);
+    upload->ring_mapped = vulkan_memory_map(context, &((vulkan_buffer*)upload->ring.internal_data)->memory, 0, ring_size);
+    if (!upload->ring_mapped) {
+        KERROR("Failed to map staging ring buffer.");
+        return false;
+    }
+
+    if (upload->uses_transfer_queue) {
+        VkCommandPoolCreateInfo pool_create_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_create_info.queueFamilyIndex = context->device.transfer_queue_index;
+        pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        VK_CHECK(vkCreateCommandPool(context->device.logical_device, &pool_create_info, context->allocator, &upload->transfer_command_pool));
+        KINFO("Uploads will use the dedicated transfer queue.");
+    }
+
+    for (u32 i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; ++i) {
+        vulkan_upload_batch* batch = &upload->batches[i];
+        vulkan_command_buffer_allocate(context, context->device.graphics_command_pool, true, &batch->graphics_command_buffer);
+        if (upload->uses_transfer_queue) {
+            vulkan_command_buffer_allocate(context, upload->transfer_command_pool, true, &batch->transfer_command_buffer);
+
+            VkSemaphoreCreateInfo semaphore_create_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+            VK_CHECK(vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &batch->graphics_complete_semaphore));
+            VK_CHECK(vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &batch->transfer_complete_semaphore));
+
+            // The compute queue belongs to the graphics family, so shares its command pool.
+            if (context->device.compute_queue) {
+                vulkan_command_buffer_allocate(context, context->device.graphics_command_pool, true, &batch->compute_command_buffer);
+                VK_CHECK(vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &batch->compute_complete_semaphore));
+            }
+        }
+
+        // Created signaled, since nothing is in flight yet.
+        VkFenceCreateInfo fence_create_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VK_CHECK(vkCreateFence(context->device.logical_device, &fence_create_info, context->allocator, &batch->fence));
+    }
+
+    return true;
+}
+
+void vulkan_upload_destroy(vulkan_context* context) {
+    vulkan_upload_state* upload = &context->upload;
+    VkDevice device = context->device.logical_device;
+
+    // Anything still pending must execute before its resources go away.
+    vulkan_upload_flush(context);
+    vkDeviceWaitIdle(device);
+
+    for (u32 i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; ++i) {
+        vulkan_upload_batch* batch = &upload->batches[i];
+        if (batch->graphics_command_buffer.handle) {
+            vulkan_command_buffer_free(context, context->device.graphics_command_pool, &batch->graphics_command_buffer);
+        }
+        if (batch->transfer_command_buffer.handle) {
+            vulkan_command_buffer_free(context, upload->transfer_command_pool, &batch->transfer_command_buffer);
+        }
+        if (batch->compute_command_buffer.handle) {
+            vulkan_command_buffer_free(context, context->device.graphics_command_pool, &batch->compute_command_buffer);
+        }
+        if (batch->graphics_complete_semaphore) {
+            vkDestroySemaphore(device, batch->graphics_complete_semaphore, context->allocator);
+        }
+        if (batch->transfer_complete_semaphore) {
+            vkDestroySemaphore(device, batch->transfer_complete_semaphore, context->allocator);
+        }
+        if (batch->compute_complete_semaphore) {
+            vkDestroySemaphore(device, batch->compute_complete_semaphore, context->allocator);
+        }
+        vulkan_mip_downsample_batch_release(context, batch, true);
+        if (batch->fence) {
+            vkDestroyFence(device, batch->fence, context->allocator);
+        }
+        kzero_memory(batch, sizeof(vulkan_upload_batch));
+    }
+
+    if (upload->transfer_command_pool) {
+        vkDestroyCommandPool(device, upload->transfer_command_pool, context->allocator);
+    }
+
+    if (upload->ring.internal_data) {
+        if (upload->ring_mapped) {
+            vulkan_memory_unmap(context, &((vulkan_buffer*)upload->ring.internal_data)->memory);
+        }
+        renderer_renderbuffer_destroy(&upload->ring);
+    }
+
+    kzero_memory(upload, sizeof(vulkan_upload_state));
+}
+
+b8 vulkan_upload_buffer(vulkan_context* context, vulkan_buffer* buffer, u64 offset, u64 size, const void* data) {
+    vulkan_upload_state* upload = &context->upload;
+    u64 ring_offset = 0;
+    u64 consumed = 0;
+    if (!ring_allocate(context, size, 16, &ring_offset, &consumed)) {
+        return false;
+    }
+    kcopy_memory(upload->ring_mapped + ring_offset, data, size);
+
+    vulkan_upload_batch* batch = batch_current_get(context);
+    batch->ring_bytes += consumed;
+    VkCommandBuffer copy_command_buffer = upload->uses_transfer_queue ? batch->transfer_command_buffer.handle : batch->graphics_command_buffer.handle;
+
+    // Copies within a batch are unordered, so make sure earlier ones to the same range land first.
+    if (batch->upload_count) {
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(copy_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+    }
+
+    VkBufferCopy copy_region;
+    copy_region.srcOffset = ring_offset;
+    copy_region.dstOffset = offset;
+    copy_region.size = size;
+    vkCmdCopyBuffer(copy_command_buffer, ((vulkan_buffer*)upload->ring.internal_data)->handle, buffer->handle, 1, &copy_region);
+
+    if (upload->uses_transfer_queue) {
+        // Hand the written range over to the graphics queue.
+        VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        barrier.srcQueueFamilyIndex = context->device.transfer_queue_index;
+        barrier.dstQueueFamilyIndex = context->device.graphics_queue_index;
+        barrier.buffer = buffer->handle;
+        barrier.offset = offset;
+        barrier.size = size;
+
+        // Release
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->transfer_command_buffer.handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 1, &barrier, 0, 0);
+
+        // Acquire
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(batch->graphics_command_buffer.handle, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, 0, 1, &barrier, 0, 0);
+    }
+
+    batch->upload_count++;
+    return upload_recorded(context);
+}
+
+// Records the copy of staged pixels to either the base level or every level of the image.
+static void image_copy_record(vulkan_context* context, vulkan_image* image, VkBuffer buffer, u64 offset, const texture_format* levels_format, vulkan_command_buffer* command_buffer) {
+    if (levels_format) {
+        vulkan_image_copy_levels_from_buffer(context, image, *levels_format, buffer, offset, command_buffer);
+    } else {
+        vulkan_image_copy_from_buffer(context, image, buffer, offset, command_buffer);
+    }
+}
+
+// Records the copy of an entire image from pixels already staged at the given offset of the ring.
+static void image_upload_record(vulkan_context* context, vulkan_image* image, VkFormat format, u64 ring_offset, u64 consumed, const texture_format* levels_format) {
+    vulkan_upload_state* upload = &context->upload;
+    vulkan_upload_batch* batch = batch_current_get(context);
+    batch->ring_bytes += consumed;
+    VkBuffer ring_handle = ((vulkan_buffer*)upload->ring.internal_data)->handle;
+
+    b8 generate_mips = !levels_format && image->mip_levels > 1;
+    b8 compute_mips = generate_mips && vulkan_mip_downsample_ready(context, image);
+    vulkan_command_buffer* mip_command_buffer = mip_command_buffer_get(batch, compute_mips);
+
+    if (upload->uses_transfer_queue) {
+        VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.image = image->handle;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = image->mip_levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = image->layer_count;
+
+        // Transition to be copied into. The old contents are discarded, so no ownership transfer is needed.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch->transfer_command_buffer.handle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+
+        image_copy_record(context, image, ring_handle, ring_offset, levels_format, &batch->transfer_command_buffer);
+
+        // Hand the image over to the graphics family, still as a transfer destination since
+        // mip generation (blitting, or compute) can only happen there.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = context->device.transfer_queue_index;
+        barrier.dstQueueFamilyIndex = context->device.graphics_queue_index;
+
+        // Release
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->transfer_command_buffer.handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+
+        // Acquire
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(mip_command_buffer->handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+    } else {
+        // Transition the layout from whatever it is currently to optimal for recieving data.
+        vulkan_image_transition_layout(context, &batch->graphics_command_buffer, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        image_copy_record(context, image, ring_handle, ring_offset, levels_format, &batch->graphics_command_buffer);
+    }
+
+    // Compute mip generation falls back to blitting if it can't be recorded.
+    b8 mips_generated = false;
+    if (generate_mips) {
+        mips_generated = (compute_mips && vulkan_mip_downsample_record(context, image, batch, mip_command_buffer)) ||
+                         vulkan_image_mipmaps_generate(context, image, mip_command_buffer);
+    }
+    if (!mips_generated) {
+        // If mip generation isn't needed or fails, fall back to ordinary transition.
+        // Transition from optimal for data reciept to shader-read-only optimal layout.
+        vulkan_image_transition_layout(context, mip_command_buffer, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    batch->upload_count++;
+}
+
+b8 vulkan_upload_image(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u64 size, const void* pixels, const texture_format* levels_format) {
+    vulkan_upload_state* upload = &context->upload;
+    u64 ring_offset = 0;
+    u64 consumed = 0;
+    // Copy offsets must be a multiple of the texel size, as well as of 4.
+    if (!ring_allocate(context, size, 16 * KMAX(texel_size, 1), &ring_offset, &consumed)) {
+        return false;
+    }
+    kcopy_memory(upload->ring_mapped + ring_offset, pixels, size);
+
+    image_upload_record(context, image, format, ring_offset, consumed, levels_format);
+    return upload_recorded(context);
+}
+
+b8 vulkan_upload_image_layers(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u64 layer_size, const void* const* layers) {
+    vulkan_upload_state* upload = &context->upload;
+    u64 ring_offset = 0;
+    u64 consumed = 0;
+    if (!ring_allocate(context, layer_size * image->layer_count, 16 * KMAX(texel_size, 1), &ring_offset, &consumed)) {
+        return false;
+    }
+    // Staged back to back, the layers are laid out just as a single block of them would be.
+    for (u32 i = 0; i < image->layer_count; ++i) {
+        kcopy_memory(upload->ring_mapped + ring_offset + layer_size * i, layers[i], layer_size);
+    }
+
+    image_upload_record(context, image, format, ring_offset, consumed, 0);
+    return upload_recorded(context);
+}
+
+b8 vulkan_upload_image_region(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u32 x, u32 y, u32 width, u32 height, const void* pixels) {
+    vulkan_upload_state* upload = &context->upload;
+
+    // The existing contents are kept, so the copy is recorded on the graphics queue, which owns
+    // the image. As with buffer copies, flush either side to stay ordered with transfer queue uploads.
+    if (upload->uses_transfer_queue && !vulkan_upload_flush(context)) {
+        return false;
+    }
+
+    u64 size = (u64)width * height * texel_size;
+    u64 ring_offset = 0;
+    u64 consumed = 0;
+    // Copy offsets must be a multiple of the texel size, as well as of 4.
+    if (!ring_allocate(context, size, 16 * KMAX(texel_size, 1), &ring_offset, &consumed)) {
+        return false;
+    }
+    kcopy_memory(upload->ring_mapped + ring_offset, pixels, size);
+
+    vulkan_upload_batch* batch = batch_current_get(context);
+    batch->ring_bytes += consumed;
+    VkBuffer ring_handle = ((vulkan_buffer*)upload->ring.internal_data)->handle;
+
+    vulkan_image_transition_layout(context, &batch->graphics_command_buffer, image, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = ring_offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = image->layer_count;
+    region.imageOffset.x = (i32)x;
+    region.imageOffset.y = (i32)y;
+    region.imageExtent.width = width;
+    region.imageExtent.height = height;
+    region.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(batch->graphics_command_buffer.handle, ring_handle, image->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    b8 mips_generated = false;
+    if (image->mip_levels > 1) {
+        mips_generated = (vulkan_mip_downsample_ready(context, image) && vulkan_mip_downsample_record(context, image, batch, &batch->graphics_command_buffer)) ||
+                         vulkan_image_mipmaps_generate(context, image, &batch->graphics_command_buffer);
+    }
+    if (!mips_generated) {
+        vulkan_image_transition_layout(context, &batch->graphics_command_buffer, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    batch->upload_count++;
+
+    if (upload->uses_transfer_queue && !vulkan_upload_flush(context)) {
+        return false;
+    }
+    return upload_recorded(context);
+}
+
+b8 vulkan_upload_copy_buffer(vulkan_context* context, VkBuffer source, u64 source_offset, VkBuffer dest, u64 dest_offset, u64 size) {
+    vulkan_upload_state* upload = &context->upload;
+
+    // Buffer-to-buffer copies are recorded on the graphics queue, which owns both buffers. With a
+    // dedicated transfer queue, that runs after the batch's transfer copies, so flush on either side
+    // to keep this ordered with uploads recorded before and after it.
+    if (upload->uses_transfer_queue && !vulkan_upload_flush(context)) {
+        return false;
+    }
+
+    vulkan_upload_batch* batch = batch_current_get(context);
+    if (batch->upload_count) {
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch->graphics_command_buffer.handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+    }
+
+    VkBufferCopy copy_region;
+    copy_region.srcOffset = source_offset;
+    copy_region.dstOffset = dest_offset;
+    copy_region.size = size;
+    vkCmdCopyBuffer(batch->graphics_command_buffer.handle, source, dest, 1, &copy_region);
+    batch->upload_count++;
+
+    if (upload->uses_transfer_queue && !vulkan_upload_flush(context)) {
+        return false;
+    }
+    return upload_recorded(context);
+}
+
+b8 vulkan_upload_flush(vulkan_context* context) {
+    vulkan_upload_state* upload = &context->upload;
+    vulkan_upload_batch* batch = &upload->batches[upload->current_batch];
+    if (!batch->is_recording) {
+        batches_retire_completed(context);
+        return true;
+    }
+
+    // Make buffer copies on the graphics queue visible to whatever comes next. Images are
+    // already handled by their transitions, and transfer queue copies by their acquires.
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(batch->graphics_command_buffer.handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+    vulkan_command_buffer_end(&batch->graphics_command_buffer);
+
+    VkResult result;
+    if (upload->uses_transfer_queue) {
+        vulkan_command_buffer_end(&batch->transfer_command_buffer);
+
+        // Signal once everything already submitted to the graphics queue is done with the data
+        // about to be overwritten.
+        VkSubmitInfo graphics_complete_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        graphics_complete_info.signalSemaphoreCount = 1;
+        graphics_complete_info.pSignalSemaphores = &batch->graphics_complete_semaphore;
+        result = vkQueueSubmit(context->device.graphics_queue, 1, &graphics_complete_info, 0);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Upload vkQueueSubmit (graphics complete) failed: %s", vulkan_result_string(result, true));
+            return false;
+        }
+
+        // The copies.
+        VkPipelineStageFlags transfer_wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo transfer_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        transfer_info.waitSemaphoreCount = 1;
+        transfer_info.pWaitSemaphores = &batch->graphics_complete_semaphore;
+        transfer_info.pWaitDstStageMask = &transfer_wait_stage;
+        transfer_info.commandBufferCount = 1;
+        transfer_info.pCommandBuffers = &batch->transfer_command_buffer.handle;
+        transfer_info.signalSemaphoreCount = 1;
+        transfer_info.pSignalSemaphores = &batch->transfer_complete_semaphore;
+        result = vkQueueSubmit(context->device.transfer_queue, 1, &transfer_info, 0);
+        if (!vulkan_result_is_success(result)) {
+            KERROR("Upload vkQueueSubmit (transfer) failed: %s", vulkan_result_string(result, true));
+            return false;
+        }
+        vulkan_command_buffer_update_submitted(&batch->transfer_command_buffer);
+
+        // Compute mip generation, if any. Only the acquires below wait on it, so rendering already
+        // submitted to the graphics queue carries on alongside it.
+        VkSemaphore graphics_wait_semaphore = batch->transfer_complete_semaphore;
+        if (batch->uses_compute) {
+            vulkan_command_buffer_end(&batch->compute_command_buffer);
+
+            VkPipelineStageFlags compute_wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            VkSubmitInfo compute_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+            compute_info.waitSemaphoreCount = 1;
+            compute_info.pWaitSemaphores = &batch->transfer_complete_semaphore;
+            compute_info.pWaitDstStageMask = &compute_wait_stage;
+            compute_info.commandBufferCount = 1;
+            compute_info.pCommandBuffers = &batch->compute_command_buffer.handle;
+            compute_info.signalSemaphoreCount = 1;
+            compute_info.pSignalSemaphores = &batch->compute_complete_semaphore;
+            result = vkQueueSubmit(context->device.compute_queue, 1, &compute_info, 0);
+            if (!vulkan_result_is_success(result)) {
+                KERROR("Upload vkQueueSubmit (compute) failed: %s", vulkan_result_string(result, true));
+                return false;
+            }
+            vulkan_command_buffer_update_submitted(&batch->compute_command_buffer);
+            graphics_wait_semaphore = batch->compute_complete_semaphore;
+        }
+
+        // The ownership acquires. Anything submitted to the graphics queue after this is
+        // ordered after the wait, so the uploaded data is available to it.
+        VkPipelineStageFlags graphics_wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo graphics_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        graphics_info.waitSemaphoreCount = 1;
+        graphics_info.pWaitSemaphores = &graphics_wait_semaphore;
+        graphics_info.pWaitDstStageMask = &graphics_wait_stage;
+        graphics_info.commandBufferCount = 1;
+        graphics_info.pCommandBuffers = &batch->graphics_command_buffer.handle;
+        result = vkQueueSubmit(context->device.graphics_queue, 1, &graphics_info, batch->fence);
+    } else {
+        VkSubmitInfo graphics_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        graphics_info.commandBufferCount = 1;
+        graphics_info.pCommandBuffers = &batch->graphics_command_buffer.handle;
+        result = vkQueueSubmit(context->device.graphics_queue, 1, &graphics_info, batch->fence);
+    }
+    if (!vulkan_result_is_success(result)) {
+        KERROR("Upload vkQueueSubmit failed: %s", vulkan_result_string(result, true));
+        return false;
+    }
+    vulkan_command_buffer_update_submitted(&batch->graphics_command_buffer);
+
+    batch->is_recording = false;
+    batch->in_flight = true;
+
+    // Move on to the next batch, waiting for it to finish if it's still in flight.
+    upload->current_batch = (upload->current_batch + 1) % VULKAN_UPLOAD_BATCH_COUNT;
+    batches_retire_completed(context);
+    vulkan_upload_batch* next = &upload->batches[upload->current_batch];
+    if (next->in_flight && !batch_retire(context, next)) {
+        return false;
+    }
+
+    return true;
+}
+
+b8 vulkan_upload_wait(vulkan_context* context) {
+    if (!vulkan_upload_flush(context)) {
+        return false;
+    }
+    vulkan_upload_state* upload = &context->upload;
+    for (u32 i = 1; i <= VULKAN_UPLOAD_BATCH_COUNT; ++i) {
+        vulkan_upload_batch* batch = &upload->batches[(upload->current_batch + i) % VULKAN_UPLOAD_BATCH_COUNT];
+        if (batch->in_flight && !batch_retire(context, batch)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file vulkan_upload.h
+ * @author Travis Vroman (travis@kohiengine.com)
+ * @brief Asynchronous uploads of data to device-local buffers and images. Data is copied
+ * into a persistently-mapped staging ring and the copies are recorded into batches, which
+ * are submitted (to the dedicated transfer queue, if there is one) without waiting on the GPU.
+ * @version 1.0
+ * @date 2023-11-21
+ *
+ * @copyright Kohi Game Engine is Copyright (c) Travis Vroman 2021-2023
+ *
+ */
+
+#pragma once
+
+#include "vulkan_types.h"
+
+/**
+ * @brief Creates the upload state for the given context, including the staging ring.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param ring_size The size of the staging ring in bytes.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_create(vulkan_context* context, u64 ring_size);
+
+/**
+ * @brief Destroys the upload state for the given context. The device should be idle.
+ *
+ * @param context A pointer to the Vulkan context.
+ */
+void vulkan_upload_destroy(vulkan_context* context);
+
+/**
+ * @brief Stages the given data and records a copy of it to the given buffer. Returns immediately;
+ * the copy executes once the current batch is flushed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param buffer A pointer to the destination buffer.
+ * @param offset The offset in bytes into the destination buffer.
+ * @param size The size of the data in bytes.
+ * @param data The data to be uploaded.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_buffer(vulkan_context* context, vulkan_buffer* buffer, u64 offset, u64 size, const void* data);
+
+/**
+ * @brief Stages the given pixels and records a copy of them to the given image, which is then
+ * left in the shader-read-only layout with mips generated as needed. Returns immediately;
+ * the copy executes once the current batch is flushed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the destination image.
+ * @param format The format of the image.
+ * @param texel_size The size of a single texel (or, for block-compressed formats, block) in bytes.
+ * @param size The size of the pixel data in bytes.
+ * @param pixels The pixel data to be uploaded.
+ * @param levels_format If not 0, the pixel data holds every mip level of the image in this format,
+ * so none are generated. Otherwise the pixel data holds just the base level.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_image(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u64 size, const void* pixels, const texture_format* levels_format);
+
+/**
+ * @brief As vulkan_upload_image, but stages the base level of each layer of the image from its
+ * own pixel data, which then need not be gathered into a single block beforehand.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the destination image.
+ * @param format The format of the image.
+ * @param texel_size The size of a single texel in bytes.
+ * @param layer_size The size of the pixel data of each layer in bytes.
+ * @param layers An array of pointers to the pixel data of each of the image's layers, in order.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_image_layers(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u64 layer_size, const void* const* layers);
+
+/**
+ * @brief Stages the given pixels and records a copy of them to a rectangle of the base level of
+ * the given image, keeping the rest of its contents. The image must already be in the
+ * shader-read-only layout, and is left there with mips generated as needed. Returns immediately;
+ * the copy executes once the current batch is flushed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param image A pointer to the destination image.
+ * @param format The format of the image.
+ * @param texel_size The size of a single texel in bytes.
+ * @param x The x coordinate of the rectangle in pixels.
+ * @param y The y coordinate of the rectangle in pixels.
+ * @param width The width of the rectangle in pixels.
+ * @param height The height of the rectangle in pixels.
+ * @param pixels The pixel data of the rectangle, tightly packed row by row.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_image_region(vulkan_context* context, vulkan_image* image, VkFormat format, u32 texel_size, u32 x, u32 y, u32 width, u32 height, const void* pixels);
+
+/**
+ * @brief Records a copy between two buffers, ordered after any uploads already recorded and
+ * before any recorded afterward. Returns immediately; the copy executes once the current batch is flushed.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @param source The buffer to copy from.
+ * @param source_offset The offset in bytes into the source buffer.
+ * @param dest The buffer to copy to.
+ * @param dest_offset The offset in bytes into the destination buffer.
+ * @param size The size of the range to copy in bytes.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_copy_buffer(vulkan_context* context, VkBuffer source, u64 source_offset, VkBuffer dest, u64 dest_offset, u64 size);
+
+/**
+ * @brief Submits the current batch, if anything has been recorded to it. Must be called before
+ * anything which depends on pending uploads is submitted to the graphics queue.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_flush(vulkan_context* context);
+
+/**
+ * @brief Submits the current batch, if anything has been recorded to it, then waits for every
+ * batch in flight to finish executing.
+ *
+ * @param context A pointer to the Vulkan context.
+ * @return True on success; otherwise false.
+ */
+b8 vulkan_upload_wait(vulkan_context* context);
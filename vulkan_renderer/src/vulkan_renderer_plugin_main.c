@@ -19,6 +19,7 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->winding_set = vulkan_renderer_winding_set;
     out_plugin->set_stencil_test_enabled = vulkan_renderer_set_stencil_test_enabled;
     out_plugin->set_depth_test_enabled = vulkan_renderer_set_depth_test_enabled;
+    out_plugin->set_depth_compare_op = vulkan_renderer_set_depth_compare_op;
     out_plugin->set_stencil_reference = vulkan_renderer_set_stencil_reference;
     out_plugin->set_stencil_op = vulkan_renderer_set_stencil_op;
     out_plugin->set_stencil_compare_mask = vulkan_renderer_set_stencil_compare_mask;
@@ -28,18 +29,25 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->renderpass_end = vulkan_renderer_renderpass_end;
     out_plugin->resized = vulkan_renderer_backend_on_resized;
     out_plugin->texture_create = vulkan_renderer_texture_create;
+    out_plugin->texture_create_layered = vulkan_renderer_texture_create_layered;
+    out_plugin->texture_format_supported = vulkan_renderer_texture_format_supported;
     out_plugin->texture_destroy = vulkan_renderer_texture_destroy;
     out_plugin->texture_create_writeable = vulkan_renderer_texture_create_writeable;
     out_plugin->texture_resize = vulkan_renderer_texture_resize;
     out_plugin->texture_write_data = vulkan_renderer_texture_write_data;
+    out_plugin->texture_write_region = vulkan_renderer_texture_write_region;
     out_plugin->texture_read_data = vulkan_renderer_texture_read_data;
     out_plugin->texture_read_pixel = vulkan_renderer_texture_read_pixel;
+    out_plugin->texture_read_pixel_async = vulkan_renderer_texture_read_pixel_async;
+    out_plugin->readback_resolve = vulkan_renderer_readback_resolve;
 
     out_plugin->shader_create = vulkan_renderer_shader_create;
     out_plugin->shader_destroy = vulkan_renderer_shader_destroy;
     out_plugin->shader_uniform_set = vulkan_renderer_uniform_set;
     out_plugin->shader_initialize = vulkan_renderer_shader_initialize;
+    out_plugin->shader_reload = vulkan_renderer_shader_reload;
     out_plugin->shader_use = vulkan_renderer_shader_use;
+    out_plugin->shader_vertex_format_set = vulkan_renderer_shader_vertex_format_set;
     out_plugin->shader_bind_globals = vulkan_renderer_shader_bind_globals;
     out_plugin->shader_bind_instance = vulkan_renderer_shader_bind_instance;
     out_plugin->shader_bind_local = vulkan_renderer_shader_bind_local;
@@ -47,11 +55,16 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->shader_apply_globals = vulkan_renderer_shader_apply_globals;
     out_plugin->shader_apply_instance = vulkan_renderer_shader_apply_instance;
     out_plugin->shader_apply_local = vulkan_renderer_shader_apply_local;
+    out_plugin->shader_local_block_push = vulkan_renderer_shader_local_block_push;
+    out_plugin->shader_variant_use = vulkan_renderer_shader_variant_use;
+    out_plugin->shader_dispatch = vulkan_renderer_shader_dispatch;
     out_plugin->shader_instance_resources_acquire = vulkan_renderer_shader_instance_resources_acquire;
     out_plugin->shader_instance_resources_release = vulkan_renderer_shader_instance_resources_release;
 
     out_plugin->texture_map_resources_acquire = vulkan_renderer_texture_map_resources_acquire;
     out_plugin->texture_map_resources_release = vulkan_renderer_texture_map_resources_release;
+    out_plugin->bindless_textures_supported = vulkan_renderer_bindless_textures_supported;
+    out_plugin->texture_map_bindless_index_get = vulkan_renderer_texture_map_bindless_index_get;
 
     out_plugin->render_target_create = vulkan_renderer_render_target_create;
     out_plugin->render_target_destroy = vulkan_renderer_render_target_destroy;
@@ -63,8 +76,16 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->window_attachment_index_get = vulkan_renderer_window_attachment_index_get;
     out_plugin->window_attachment_count_get = vulkan_renderer_window_attachment_count_get;
     out_plugin->is_multithreaded = vulkan_renderer_is_multithreaded;
+    out_plugin->command_list_begin = vulkan_renderer_command_list_begin;
+    out_plugin->command_list_end = vulkan_renderer_command_list_end;
+    out_plugin->command_list_execute = vulkan_renderer_command_list_execute;
+    out_plugin->async_compute_begin = vulkan_renderer_async_compute_begin;
+    out_plugin->async_compute_end = vulkan_renderer_async_compute_end;
+    out_plugin->async_compute_wait = vulkan_renderer_async_compute_wait;
     out_plugin->flag_enabled_get = vulkan_renderer_flag_enabled_get;
     out_plugin->flag_enabled_set = vulkan_renderer_flag_enabled_set;
+    out_plugin->swapchain_settings_get = vulkan_renderer_swapchain_settings_get;
+    out_plugin->swapchain_settings_set = vulkan_renderer_swapchain_settings_set;
 
     out_plugin->renderbuffer_internal_create = vulkan_buffer_create_internal;
     out_plugin->renderbuffer_internal_destroy = vulkan_buffer_destroy_internal;
@@ -77,7 +98,27 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->renderbuffer_resize = vulkan_buffer_resize;
     out_plugin->renderbuffer_load_range = vulkan_buffer_load_range;
     out_plugin->renderbuffer_copy_range = vulkan_buffer_copy_range;
+    out_plugin->upload_synchronous_set = vulkan_renderer_upload_synchronous_set;
+    out_plugin->upload_wait = vulkan_renderer_upload_wait;
     out_plugin->renderbuffer_draw = vulkan_buffer_draw;
+    out_plugin->renderbuffer_draw_instanced = vulkan_buffer_draw_instanced;
+    out_plugin->indirect_draw_supported = vulkan_buffer_indirect_draw_supported;
+    out_plugin->multiview_supported = vulkan_renderpass_multiview_supported;
+    out_plugin->weighted_blend_supported = vulkan_renderer_weighted_blend_supported;
+    out_plugin->shading_rate_supported = vulkan_renderer_shading_rate_supported;
+    out_plugin->shading_rate_set = vulkan_renderer_shading_rate_set;
+    out_plugin->occlusion_query_begin = vulkan_renderer_occlusion_query_begin;
+    out_plugin->occlusion_query_end = vulkan_renderer_occlusion_query_end;
+    out_plugin->occlusion_query_results_get = vulkan_renderer_occlusion_query_results_get;
+    out_plugin->window_create = vulkan_renderer_window_create;
+    out_plugin->window_destroy = vulkan_renderer_window_destroy;
+    out_plugin->window_resized = vulkan_renderer_window_resized;
+    out_plugin->window_acquire = vulkan_renderer_window_acquire;
+    out_plugin->window_colour_get = vulkan_renderer_window_colour_get;
+    out_plugin->window_depth_get = vulkan_renderer_window_depth_get;
+    out_plugin->window_image_index_get = vulkan_renderer_window_image_index_get;
+    out_plugin->window_image_count_get = vulkan_renderer_window_image_count_get;
+    out_plugin->renderbuffer_draw_indirect = vulkan_buffer_draw_indirect;
 
     return true;
 }